@@ -141,6 +141,12 @@ function(add_longhaul_test_directory test_directory)
     endif()
 endfunction()
 
+function(add_perftest_directory test_directory)
+    if (${run_perf_tests})
+        add_subdirectory(${test_directory})
+    endif()
+endfunction()
+
 # For targets which set warning switches as project properties (e.g. XCode)
 function(setSdkTargetBuildProperties stbp_target)
     if(XCODE)
@@ -36,6 +36,21 @@ extern "C"
 #define MAX_BLOCK_COUNT 50000
 #endif
 
+/* A block rejected by storage with a 5xx status is PUT again under the same block ID, up to this many attempts in total */
+#ifndef BLOB_UPLOAD_BLOCK_MAX_ATTEMPTS
+#define BLOB_UPLOAD_BLOCK_MAX_ATTEMPTS 3
+#endif
+
+/* Delay before the Nth retry of a block is N times this value */
+#ifndef BLOB_UPLOAD_BLOCK_RETRY_DELAY_MS
+#define BLOB_UPLOAD_BLOCK_RETRY_DELAY_MS 1000
+#endif
+
+/* Blob_UploadMultipleBlocksInParallel keeps at most this many blocks in flight, each on its own connection and thread */
+#ifndef BLOB_UPLOAD_MAX_PARALLELISM
+#define BLOB_UPLOAD_MAX_PARALLELISM 8
+#endif
+
 #define BLOB_RESULT_VALUES \
     BLOB_OK,               \
     BLOB_ERROR,            \
@@ -46,6 +61,8 @@ extern "C"
 
 DEFINE_ENUM(BLOB_RESULT, BLOB_RESULT_VALUES)
 
+typedef struct BLOB_CONNECTION_TAG* BLOB_CONNECTION_HANDLE;
+
 /**
 * @brief  Synchronously uploads a byte array to blob storage
 *
@@ -61,6 +78,58 @@ DEFINE_ENUM(BLOB_RESULT, BLOB_RESULT_VALUES)
 */
 MOCKABLE_FUNCTION(, BLOB_RESULT, Blob_UploadMultipleBlocksFromSasUri, const char*, SASURI, IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK_EX, getDataCallbackEx, void*, context, unsigned int*, httpStatus, BUFFER_HANDLE, httpResponse, const char*, certificates, HTTP_PROXY_OPTIONS*, proxyOptions)
 
+/**
+* @brief  Synchronously uploads the rest of a blob whose first blocks were uploaded by an earlier, interrupted call
+*
+* @param  SASURI              The URI to use to upload data. It may be a different SAS URI for the same blob.
+* @param  getDataCallbackEx   A callback to be invoked to acquire the file chunks to be uploaded, starting with block @p committedBlockCount.
+* @param  context             Any data provided by the user to serve as context on getDataCallback.
+* @param  httpStatus          A pointer to an out argument receiving the HTTP status (available only when the return value is BLOB_OK)
+* @param  httpResponse        A BUFFER_HANDLE that receives the HTTP response from the server (available only when the return value is BLOB_OK)
+* @param  certificates        A null terminated string containing CA certificates to be used
+* @param  proxyOptions        A structure that contains optional web proxy information
+* @param  committedBlockCount The number of blocks (block IDs 0...committedBlockCount-1) storage already acknowledged
+*
+* @return    A @c BLOB_RESULT. BLOB_OK means the blob has been uploaded successfully. Any other value indicates an error
+*/
+MOCKABLE_FUNCTION(, BLOB_RESULT, Blob_ResumeMultipleBlocksFromSasUri, const char*, SASURI, IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK_EX, getDataCallbackEx, void*, context, unsigned int*, httpStatus, BUFFER_HANDLE, httpResponse, const char*, certificates, HTTP_PROXY_OPTIONS*, proxyOptions, unsigned int, committedBlockCount)
+
+/**
+* @brief  Creates a connection that Blob_UploadMultipleBlocksOnConnection keeps open to one storage host between uploads
+*
+* @param  idleTimeoutSecs   An open connection that has not been used for longer than this is not reused
+*
+* @return    A @c BLOB_CONNECTION_HANDLE, or NULL on failure
+*/
+MOCKABLE_FUNCTION(, BLOB_CONNECTION_HANDLE, Blob_Connection_Create, size_t, idleTimeoutSecs)
+
+/**
+* @brief  Closes the connection kept by @p connection, if any, and frees it
+*/
+MOCKABLE_FUNCTION(, void, Blob_Connection_Destroy, BLOB_CONNECTION_HANDLE, connection)
+
+/**
+* @brief  Same as Blob_ResumeMultipleBlocksFromSasUri, but reuses the connection @p connection kept from the previous upload to the same storage host and keeps it for the next one
+*
+* @param  connection          The connection created by Blob_Connection_Create. It must not be used by two uploads at the same time.
+* @param  committedBlockCount The number of blocks storage already acknowledged, 0 for a new blob
+*
+* @return    A @c BLOB_RESULT. BLOB_OK means the blob has been uploaded successfully. Any other value indicates an error
+*/
+MOCKABLE_FUNCTION(, BLOB_RESULT, Blob_UploadMultipleBlocksOnConnection, BLOB_CONNECTION_HANDLE, connection, const char*, SASURI, IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK_EX, getDataCallbackEx, void*, context, unsigned int*, httpStatus, BUFFER_HANDLE, httpResponse, const char*, certificates, HTTP_PROXY_OPTIONS*, proxyOptions, unsigned int, committedBlockCount)
+
+/**
+* @brief  Same as Blob_UploadMultipleBlocksOnConnection, but PUTs up to @p parallelism blocks at the same time, each on its own connection, before putting the block list
+*
+* @param  connection          The connection created by Blob_Connection_Create, or NULL to open a new one. Only the first of the connections is kept.
+* @param  getDataCallbackEx   Called one call at a time and in block order, but possibly from another thread and while the blocks asked for before are still in flight: FILE_UPLOAD_OK only means no block failed so far. Every block in flight holds a copy of its data.
+* @param  committedBlockCount The number of blocks storage already acknowledged, 0 for a new blob
+* @param  parallelism         The number of blocks in flight at most, 0 or 1 upload one block at a time. It is clamped to BLOB_UPLOAD_MAX_PARALLELISM.
+*
+* @return    A @c BLOB_RESULT. BLOB_OK means the blob has been uploaded successfully. Any other value indicates an error
+*/
+MOCKABLE_FUNCTION(, BLOB_RESULT, Blob_UploadMultipleBlocksInParallel, BLOB_CONNECTION_HANDLE, connection, const char*, SASURI, IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK_EX, getDataCallbackEx, void*, context, unsigned int*, httpStatus, BUFFER_HANDLE, httpResponse, const char*, certificates, HTTP_PROXY_OPTIONS*, proxyOptions, unsigned int, committedBlockCount, size_t, parallelism)
+
 /**
 * @brief  Synchronously uploads a byte array as a new block to blob storage
 *
@@ -0,0 +1,47 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file    iothub_client_coalescing_io.h
+*    @brief    An XIO that gathers the writes made between two DoWork calls of
+*             the I/O it sits on, so that they go down as one send.
+*
+*    @details The MQTT and AMQP over WebSockets transports put it on top of
+*             their WebSocket I/O: every send of the WebSocket I/O is a frame,
+*             and the protocol writes of a DoWork (a PUBLISH, its PUBACKs, an
+*             AMQP transfer and its flow frames...) would otherwise each cost
+*             a WebSocket frame header and a TLS record. The MQTT transport
+*             puts it on top of its TLS I/O, where every send is a TLS record
+*             and usually a syscall.
+*/
+
+#ifndef IOTHUB_CLIENT_COALESCING_IO_H
+#define IOTHUB_CLIENT_COALESCING_IO_H
+
+#include <stddef.h>
+#include "azure_c_shared_utility/xio.h"
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*most bytes sent in one frame until OPTION_WS_COALESCED_FRAME_SIZE (or OPTION_TLS_COALESCED_RECORD_SIZE) says otherwise; a frame and its WebSocket header fit a 16KB TLS record*/
+#define COALESCING_IO_DEFAULT_MAX_FRAME_SIZE 16370
+
+typedef struct COALESCING_IO_CONFIG_TAG
+{
+    /*opened, closed and destroyed with the coalescing I/O, which owns it once xio_create succeeds*/
+    XIO_HANDLE underlying_io;
+} COALESCING_IO_CONFIG;
+
+/**
+* @brief    The IO_INTERFACE_DESCRIPTION to give xio_create, with a COALESCING_IO_CONFIG.
+*/
+MOCKABLE_FUNCTION(, const IO_INTERFACE_DESCRIPTION*, coalescing_io_get_interface_description);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IOTHUB_CLIENT_COALESCING_IO_H
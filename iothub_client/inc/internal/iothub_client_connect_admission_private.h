@@ -0,0 +1,38 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file    iothub_client_connect_admission_private.h
+*    @brief    How the transports ask iothub_client_connect_admission.h to open a connection.
+*/
+
+#ifndef IOTHUB_CLIENT_CONNECT_ADMISSION_PRIVATE_H
+#define IOTHUB_CLIENT_CONNECT_ADMISSION_PRIVATE_H
+
+#include <stdbool.h>
+#include "azure_c_shared_utility/umock_c_prod.h"
+#include "iothub_client_connect_admission.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*true between IoTHubClient_ConnectAdmission_Start and IoTHubClient_ConnectAdmission_Stop*/
+extern bool g_iothub_client_connect_admission_started;
+
+/**
+* @brief    Takes a token from the bucket.
+*
+* @return   true if the connection can be opened now, false if it has to wait.
+*/
+MOCKABLE_FUNCTION(, bool, IoTHubClient_ConnectAdmission_TryAcquire);
+
+/*costs a single test while admission control is not started*/
+#define IOTHUB_CLIENT_CONNECT_ADMITTED()                                                            \
+    (!g_iothub_client_connect_admission_started || IoTHubClient_ConnectAdmission_TryAcquire())
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IOTHUB_CLIENT_CONNECT_ADMISSION_PRIVATE_H
@@ -26,6 +26,7 @@ typedef struct IOTHUB_DIAGNOSTIC_SETTING_DATA_TAG
 {
     uint32_t diagSamplingPercentage;
     uint32_t currentMessageNumber;
+    uint32_t randomState; /*generates the diagnostic ids, 0 until the first sampled message*/
 } IOTHUB_DIAGNOSTIC_SETTING_DATA;
 
 /**
@@ -0,0 +1,69 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file    iothub_client_gzip.h
+*    @brief    gzip (RFC 1952) compression of telemetry payloads and file uploads.
+*
+*    @details  Only built when the SDK is configured with use_payload_compression, which links zlib.
+*            A gzip stream compresses its input incrementally into caller provided buffers, so a
+*            file upload only ever holds one input buffer and one blob block in memory.
+*/
+
+#ifndef IOTHUB_CLIENT_GZIP_H
+#define IOTHUB_CLIENT_GZIP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define GZIP_CONTENT_ENCODING "gzip"
+
+typedef struct GZIP_STREAM_TAG* GZIP_STREAM_HANDLE;
+
+/**
+* @brief    Starts a new gzip stream.
+*
+* @return   A handle to the gzip stream, or NULL on failure.
+*/
+MOCKABLE_FUNCTION(, GZIP_STREAM_HANDLE, gzip_stream_create);
+
+/**
+* @brief    Releases the gzip stream, whether or not it ended.
+*/
+MOCKABLE_FUNCTION(, void, gzip_stream_destroy, GZIP_STREAM_HANDLE, gzip_stream);
+
+/**
+* @brief    Compresses as much of @p input into @p output as fits.
+*
+* @param    input           The next bytes of the uncompressed data. May be NULL if @p input_size is 0.
+* @param    last_input      true once @p input holds the end of the uncompressed data; the stream then
+*                           flushes everything it buffered and writes the gzip trailer.
+* @param    input_consumed  Receives how many bytes of @p input were compressed. The rest has to be
+*                           passed again on the next call.
+* @param    output_written  Receives how many bytes were written to @p output.
+* @param    ended           Set to true once the whole stream, trailer included, has been written.
+*
+* @return   0 on success, non-zero otherwise.
+*/
+MOCKABLE_FUNCTION(, int, gzip_stream_compress, GZIP_STREAM_HANDLE, gzip_stream, const unsigned char*, input, size_t, input_size, bool, last_input, unsigned char*, output, size_t, output_size, size_t*, input_consumed, size_t*, output_written, bool*, ended);
+
+/**
+* @brief    Compresses @p source in one go.
+*
+* @param    compressed       Receives a buffer holding the gzip stream. The caller frees it with free().
+* @param    compressed_size  Receives the size of @p compressed.
+*
+* @return   0 on success, non-zero otherwise.
+*/
+MOCKABLE_FUNCTION(, int, gzip_compress_buffer, const unsigned char*, source, size_t, size, unsigned char**, compressed, size_t*, compressed_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_GZIP_H */
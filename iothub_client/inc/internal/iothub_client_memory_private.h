@@ -0,0 +1,95 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file    iothub_client_memory_private.h
+*    @brief    How the SDK counts the bytes reported by iothub_client_memory.h.
+*/
+
+#ifndef IOTHUB_CLIENT_MEMORY_PRIVATE_H
+#define IOTHUB_CLIENT_MEMORY_PRIVATE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "azure_c_shared_utility/umock_c_prod.h"
+#include "iothub_client_memory.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define IOTHUB_CLIENT_MEMORY_TAG_COUNT ((size_t)IOTHUB_CLIENT_MEMORY_OPTIONS + 1)
+
+/*the bytes held by one client, transport or store; only its owner writes them, under the locks it already holds*/
+typedef struct IOTHUB_CLIENT_MEMORY_COUNTERS_TAG
+{
+    IOTHUB_CLIENT_MEMORY_USAGE usage[IOTHUB_CLIENT_MEMORY_TAG_COUNT];
+    bool registered;
+    struct IOTHUB_CLIENT_MEMORY_COUNTERS_TAG* previous;
+    struct IOTHUB_CLIENT_MEMORY_COUNTERS_TAG* next;
+} IOTHUB_CLIENT_MEMORY_COUNTERS;
+
+/*true between IoTHubClient_Memory_Init and IoTHubClient_Memory_Deinit*/
+extern bool g_iothub_client_memory_accounting;
+
+/**
+* @brief    Starts summing the registered counters. Called by IoTHub_Init.
+*
+* @return   0 on success, non-zero otherwise.
+*/
+MOCKABLE_FUNCTION(, int, IoTHubClient_Memory_Init);
+
+/**
+* @brief    Stops summing. Called by IoTHub_Deinit, once all the clients are destroyed.
+*/
+MOCKABLE_FUNCTION(, void, IoTHubClient_Memory_Deinit);
+
+MOCKABLE_FUNCTION(, void, IoTHubClient_Memory_Register, IOTHUB_CLIENT_MEMORY_COUNTERS*, counters);
+MOCKABLE_FUNCTION(, void, IoTHubClient_Memory_Unregister, IOTHUB_CLIENT_MEMORY_COUNTERS*, counters);
+
+/*counters created before IoTHub_Init keep counting but are not summed*/
+#define IOTHUB_CLIENT_MEMORY_REGISTER(counters)     \
+    do                                              \
+    {                                               \
+        if (g_iothub_client_memory_accounting)      \
+        {                                           \
+            IoTHubClient_Memory_Register(counters); \
+        }                                           \
+    } while (0)
+
+#define IOTHUB_CLIENT_MEMORY_UNREGISTER(counters)     \
+    do                                                \
+    {                                                 \
+        if ((counters)->registered)                   \
+        {                                             \
+            IoTHubClient_Memory_Unregister(counters); \
+        }                                             \
+    } while (0)
+
+/*what is removed must be what was added; the current bytes stop at 0 and SIZE_MAX*/
+#define IOTHUB_CLIENT_MEMORY_ADD(counters, tag, size)                                                                                                     \
+    do                                                                                                                                                    \
+    {                                                                                                                                                     \
+        IOTHUB_CLIENT_MEMORY_USAGE* counted_usage = &(counters)->usage[(tag)];                                                                            \
+        size_t counted_size = (size);                                                                                                                     \
+        counted_usage->current_bytes = (counted_size > SIZE_MAX - counted_usage->current_bytes) ? SIZE_MAX : counted_usage->current_bytes + counted_size; \
+        if (counted_usage->current_bytes > counted_usage->peak_bytes)                                                                                     \
+        {                                                                                                                                                 \
+            counted_usage->peak_bytes = counted_usage->current_bytes;                                                                                     \
+        }                                                                                                                                                 \
+    } while (0)
+
+#define IOTHUB_CLIENT_MEMORY_REMOVE(counters, tag, size)                                                                                \
+    do                                                                                                                                  \
+    {                                                                                                                                   \
+        IOTHUB_CLIENT_MEMORY_USAGE* counted_usage = &(counters)->usage[(tag)];                                                          \
+        size_t counted_size = (size);                                                                                                   \
+        counted_usage->current_bytes = (counted_size < counted_usage->current_bytes) ? counted_usage->current_bytes - counted_size : 0; \
+    } while (0)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IOTHUB_CLIENT_MEMORY_PRIVATE_H
@@ -0,0 +1,62 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file    iothub_client_output_routing.h
+*    @brief    Tells which outputs a message goes to, used by IoTHubClientCore_LL to fan out the
+*            messages of IoTHubClientCore_LL_SendEventToRoutesAsync for each OPTION_OUTPUT_ROUTE.
+*
+*    @details  A route sends the messages whose application property holds a value to an output.
+*            Routes are evaluated in the order they were added.
+*/
+
+#ifndef IOTHUB_CLIENT_OUTPUT_ROUTING_H
+#define IOTHUB_CLIENT_OUTPUT_ROUTING_H
+
+#include <stddef.h>
+#include "azure_c_shared_utility/umock_c_prod.h"
+#include "iothub_message.h"
+#include "iothub_client_core_common.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef struct OUTPUT_ROUTING_TAG* OUTPUT_ROUTING_HANDLE;
+
+/**
+* @brief    Creates a routing without any route.
+*
+* @return   A handle to the routing, or NULL on failure.
+*/
+MOCKABLE_FUNCTION(, OUTPUT_ROUTING_HANDLE, output_routing_create);
+
+/**
+* @brief    Destroys the routing and its routes.
+*/
+MOCKABLE_FUNCTION(, void, output_routing_destroy, OUTPUT_ROUTING_HANDLE, routing);
+
+/**
+* @brief    Adds or (when @p route's remove is true) removes @p route.
+*
+* @details  Adding a route the routing already holds does nothing.
+*
+* @return   0 on success, non-zero otherwise.
+*/
+MOCKABLE_FUNCTION(, int, output_routing_configure, OUTPUT_ROUTING_HANDLE, routing, const IOTHUB_CLIENT_OUTPUT_ROUTE*, route);
+
+/**
+* @brief    Evaluates every route once against the application properties of @p message.
+*
+* @details  @p output_names receives the outputs of the routes matching @p message, each once, in the order of the routes.
+*           The array belongs to the routing and holds until the next call to a function of the routing.
+*
+* @return   The number of outputs in @p output_names, 0 if no route matches.
+*/
+MOCKABLE_FUNCTION(, size_t, output_routing_evaluate, OUTPUT_ROUTING_HANDLE, routing, IOTHUB_MESSAGE_HANDLE, message, const char* const**, output_names);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IOTHUB_CLIENT_OUTPUT_ROUTING_H
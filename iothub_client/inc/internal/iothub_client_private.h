@@ -13,6 +13,7 @@
 
 #include "iothub_message.h"
 #include "internal/iothub_transport_ll_private.h"
+#include "internal/iothub_client_tracing.h"
 #include "iothub_client_core_common.h"
 #include "iothub_client_core_ll.h"
 
@@ -39,6 +40,7 @@ MOCKABLE_FUNCTION(, int, IoTHubClientCore_LL_GetTransportCallbacks, TRANSPORT_CA
 /* (Should be replaced after iothub_client refactor)*/
 MOCKABLE_FUNCTION(, IOTHUB_CLIENT_EDGE_HANDLE, IoTHubClientCore_LL_GetEdgeHandle, IOTHUB_CLIENT_CORE_LL_HANDLE, iotHubClientHandle);
 MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClientCore_LL_GenericMethodInvoke, IOTHUB_CLIENT_CORE_LL_HANDLE, iotHubClientHandle, const char*, deviceId, const char*, moduleId, const char*, methodName, const char*, methodPayload, unsigned int, timeout, int*, responseStatus, unsigned char**, responsePayload, size_t*, responsePayloadSize);
+MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClientCore_LL_GenericMethodInvokeAsync, IOTHUB_CLIENT_CORE_LL_HANDLE, iotHubClientHandle, const char*, deviceId, const char*, moduleId, const char*, methodName, const char*, methodPayload, unsigned int, timeout, IOTHUB_METHOD_INVOKE_CALLBACK, methodInvokeCallback, void*, context);
 #endif
 
 typedef struct IOTHUB_MESSAGE_LIST_TAG
@@ -49,6 +51,15 @@ typedef struct IOTHUB_MESSAGE_LIST_TAG
     DLIST_ENTRY entry;
     tickcounter_ms_t ms_timesOutAfter; /* a value of "0" means "no timeout", if the IOTHUBCLIENT_LL's handle tickcounter > msTimesOutAfer then the message shall timeout*/
     tickcounter_ms_t message_timeout_value;
+    uint64_t send_sequence; /* order in which the message was added to waitingToSend, used to tell whether the transport has taken it */
+    tickcounter_ms_t ms_enqueued; /* only valid if enqueued_stamped, see OPTION_ENABLE_STATISTICS */
+    tickcounter_ms_t ms_published; /* only valid if published_stamped, time of the first publish */
+    bool enqueued_stamped;
+    bool published_stamped;
+    size_t pending_size; /* payload bytes counted against OPTION_MAX_PENDING_BYTES, 0 once released */
+    size_t memory_size; /* bytes counted in IOTHUB_CLIENT_MEMORY_MESSAGE_QUEUE, 0 once released, see iothub_client_memory.h */
+    size_t spill_generation; /* spill log it was read from, which keeps it until it completes, 0 if none, see OPTION_SPILL_DIRECTORY */
+    IOTHUB_CLIENT_TRACE_CONTEXT trace; /* only active while OPTION_TRACE_EXPORTER is set */
 }IOTHUB_MESSAGE_LIST;
 
 typedef struct IOTHUB_DEVICE_TWIN_TAG
@@ -61,6 +72,11 @@ typedef struct IOTHUB_DEVICE_TWIN_TAG
     DLIST_ENTRY entry;
     IOTHUB_CLIENT_CORE_LL_HANDLE client_handle;
     IOTHUB_DEVICE_HANDLE device_handle;
+    tickcounter_ms_t ms_coalesce_until; /* kept in the queue until then so more reported states can be merged into it, 0 if none, see OPTION_TWIN_COALESCE_WINDOW */
+    struct IOTHUB_DEVICE_TWIN_TAG* coalesced; /* reported states merged into this one, completed with it */
+    tickcounter_ms_t ms_sent; /* only valid if sent_stamped, see OPTION_ENABLE_STATISTICS */
+    bool sent_stamped;
+    IOTHUB_CLIENT_TRACE_CONTEXT trace; /* only active while OPTION_TRACE_EXPORTER is set */
 } IOTHUB_DEVICE_TWIN;
 
 union IOTHUB_IDENTITY_INFO_TAG
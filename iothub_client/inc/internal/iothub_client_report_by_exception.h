@@ -0,0 +1,66 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file    iothub_client_report_by_exception.h
+*    @brief    Tells which events hold no news, used by IoTHubClientCore_LL to confirm them without
+*            sending them for each OPTION_REPORT_BY_EXCEPTION.
+*
+*    @details  Each property name has its own filter: the value and time of the last event sent that
+*            held it. Times are the ms of the caller's tickcounter.
+*/
+
+#ifndef IOTHUB_CLIENT_REPORT_BY_EXCEPTION_H
+#define IOTHUB_CLIENT_REPORT_BY_EXCEPTION_H
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+#include "azure_c_shared_utility/tickcounter.h"
+#include "iothub_message.h"
+#include "iothub_client_core_common.h"
+
+#ifdef __cplusplus
+#include <cstdbool>
+extern "C"
+{
+#else
+#include <stdbool.h>
+#endif
+
+typedef struct REPORT_BY_EXCEPTION_TAG* REPORT_BY_EXCEPTION_HANDLE;
+
+/**
+* @brief    Creates a report by exception without any filter.
+*
+* @return   A handle to the report by exception, or NULL on failure.
+*/
+MOCKABLE_FUNCTION(, REPORT_BY_EXCEPTION_HANDLE, report_by_exception_create);
+
+/**
+* @brief    Destroys the report by exception and its filters.
+*/
+MOCKABLE_FUNCTION(, void, report_by_exception_destroy, REPORT_BY_EXCEPTION_HANDLE, report_by_exception);
+
+/**
+* @brief    Adds, replaces or (when @p configuration's deadband is negative) removes the filter of @p configuration's property_name.
+*
+* @details  A filter added or replaced has no last value, so the next event holding the property is sent.
+*
+* @return   0 on success, non-zero otherwise.
+*/
+MOCKABLE_FUNCTION(, int, report_by_exception_configure, REPORT_BY_EXCEPTION_HANDLE, report_by_exception, const IOTHUB_CLIENT_REPORT_BY_EXCEPTION*, configuration);
+
+/**
+* @brief    Tells whether @p message, about to be sent at @p now, holds no news.
+*
+* @details  Only the filtered properties of @p message holding a number count. The message holds no news if it has one,
+*           and each of them is within its deadband of its last value and its heartbeat is not due. Otherwise the filters
+*           of those properties take their values and @p now as the last ones sent.
+*
+* @return   true if @p message need not be sent, false otherwise.
+*/
+MOCKABLE_FUNCTION(, bool, report_by_exception_is_suppressed, REPORT_BY_EXCEPTION_HANDLE, report_by_exception, IOTHUB_MESSAGE_HANDLE, message, tickcounter_ms_t, now);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IOTHUB_CLIENT_REPORT_BY_EXCEPTION_H
@@ -0,0 +1,84 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file    iothub_client_spill_queue.h
+*    @brief    An append-only on-disk log of events, used by IoTHubClientCore_LL to keep
+*            events off the heap while the transport cannot send them.
+*
+*    @details  Events are appended to segment files named iothub_spill_<n>.log in a
+*            directory, and a small iothub_spill.state file records the oldest event not yet
+*            released. Events left in the directory when the queue is destroyed (or the process
+*            dies) are read again, in order, by the next spill queue created on it.
+*/
+
+#ifndef IOTHUB_CLIENT_SPILL_QUEUE_H
+#define IOTHUB_CLIENT_SPILL_QUEUE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "azure_c_shared_utility/umock_c_prod.h"
+#include "iothub_message.h"
+#include "iothub_client_core_common.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef struct SPILL_QUEUE_TAG* SPILL_QUEUE_HANDLE;
+
+/**
+* @brief    Opens the spill queue kept in @p directory, which must exist, creating it if it is empty.
+*
+* @param    directory           Directory holding the segment and state files. Only one spill queue
+*                               may use a directory at a time.
+* @param    max_segment_size    Size in bytes after which a new segment file is started. Segments are
+*                               deleted once all their events are released.
+*
+* @return   A handle to the spill queue, or NULL on failure.
+*/
+MOCKABLE_FUNCTION(, SPILL_QUEUE_HANDLE, spill_queue_create, const char*, directory, size_t, max_segment_size);
+
+/**
+* @brief    Closes the spill queue. Events not yet released stay on disk.
+*/
+MOCKABLE_FUNCTION(, void, spill_queue_destroy, SPILL_QUEUE_HANDLE, spill_queue);
+
+/**
+* @brief    Appends a copy of @p message (payload, system and application properties, output name) to the log.
+*
+* @param    callback    Returned with the event by spill_queue_read_message, unless the event is read
+*                       by a spill queue created later (callbacks do not survive the process).
+*
+* @return   0 if the event was written, non-zero otherwise. @p message still belongs to the caller.
+*/
+MOCKABLE_FUNCTION(, int, spill_queue_push_message, SPILL_QUEUE_HANDLE, spill_queue, IOTHUB_MESSAGE_HANDLE, message, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, callback, void*, context);
+
+/**
+* @brief    Reads the oldest event not yet read, in the order it was pushed.
+*
+* @param    message     Set to a new message the caller owns, or to NULL if no event is left to read.
+*
+* @return   0 on success (including when no event is left), non-zero otherwise.
+*
+* @remarks  A read event stays on disk until it is released with spill_queue_release.
+*/
+MOCKABLE_FUNCTION(, int, spill_queue_read_message, SPILL_QUEUE_HANDLE, spill_queue, IOTHUB_MESSAGE_HANDLE*, message, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK*, callback, void**, context);
+
+/**
+* @brief    Releases the oldest event read and not yet released, so it is removed from disk.
+*
+* @return   0 on success, non-zero if no event is waiting to be released or the state file could not be written.
+*/
+MOCKABLE_FUNCTION(, int, spill_queue_release, SPILL_QUEUE_HANDLE, spill_queue);
+
+/**
+* @brief    Tells whether any event is left to read.
+*/
+MOCKABLE_FUNCTION(, bool, spill_queue_is_empty, SPILL_QUEUE_HANDLE, spill_queue);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IOTHUB_CLIENT_SPILL_QUEUE_H
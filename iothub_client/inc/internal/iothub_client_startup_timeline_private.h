@@ -0,0 +1,42 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file    iothub_client_startup_timeline_private.h
+*    @brief    How the SDK notes the milestones of iothub_client_startup_timeline.h.
+*/
+
+#ifndef IOTHUB_CLIENT_STARTUP_TIMELINE_PRIVATE_H
+#define IOTHUB_CLIENT_STARTUP_TIMELINE_PRIVATE_H
+
+#include <stdbool.h>
+#include "azure_c_shared_utility/umock_c_prod.h"
+#include "iothub_client_startup_timeline.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*true between IoTHubClient_StartupTimeline_Start and IoTHubClient_StartupTimeline_Stop*/
+extern bool g_iothub_client_startup_timeline_started;
+
+/**
+* @brief    Notes that @p milestone is reached, unless it was already.
+*/
+MOCKABLE_FUNCTION(, void, IoTHubClient_StartupTimeline_Mark, IOTHUB_CLIENT_STARTUP_MILESTONE, milestone);
+
+/*costs a single test while the timeline is not started*/
+#define IOTHUB_CLIENT_STARTUP_MARK(milestone)                       \
+    do                                                              \
+    {                                                               \
+        if (g_iothub_client_startup_timeline_started)               \
+        {                                                           \
+            IoTHubClient_StartupTimeline_Mark(milestone);           \
+        }                                                           \
+    } while (0)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IOTHUB_CLIENT_STARTUP_TIMELINE_PRIVATE_H
@@ -0,0 +1,77 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file    iothub_client_telemetry_aggregation.h
+*    @brief    Folds telemetry samples into fixed windows, used by IoTHubClientCore_LL to send
+*            one min/max/mean/count event per window for each OPTION_TELEMETRY_AGGREGATION.
+*
+*    @details  Each output name has its own stage: a window open since its first sample, and a
+*            fixed-size ring of the closed windows not sent yet. Times are the ms of the caller's
+*            tickcounter.
+*/
+
+#ifndef IOTHUB_CLIENT_TELEMETRY_AGGREGATION_H
+#define IOTHUB_CLIENT_TELEMETRY_AGGREGATION_H
+
+#include <stddef.h>
+#include "azure_c_shared_utility/umock_c_prod.h"
+#include "azure_c_shared_utility/tickcounter.h"
+#include "iothub_message.h"
+#include "iothub_client_core_common.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef struct TELEMETRY_AGGREGATION_TAG* TELEMETRY_AGGREGATION_HANDLE;
+
+/**
+* @brief    Hands over an event built by the aggregation.
+*
+* @return   0 if the event was taken, in which case it belongs to the callee, non-zero otherwise.
+*/
+typedef int(*TELEMETRY_AGGREGATION_SEND_CALLBACK)(IOTHUB_MESSAGE_HANDLE message, void* context);
+
+/**
+* @brief    Creates an aggregation without any stage.
+*
+* @return   A handle to the aggregation, or NULL on failure.
+*/
+MOCKABLE_FUNCTION(, TELEMETRY_AGGREGATION_HANDLE, telemetry_aggregation_create);
+
+/**
+* @brief    Destroys the aggregation, dropping the windows not sent yet.
+*/
+MOCKABLE_FUNCTION(, void, telemetry_aggregation_destroy, TELEMETRY_AGGREGATION_HANDLE, aggregation);
+
+/**
+* @brief    Adds, replaces or (when @p configuration's window_ms is 0) removes the stage of @p configuration's output_name.
+*
+* @details  A stage replaced or removed drops its windows not sent yet.
+*
+* @return   0 on success, non-zero otherwise.
+*/
+MOCKABLE_FUNCTION(, int, telemetry_aggregation_configure, TELEMETRY_AGGREGATION_HANDLE, aggregation, const IOTHUB_CLIENT_TELEMETRY_AGGREGATION*, configuration);
+
+/**
+* @brief    Folds @p value into the window of @p output_name open at @p now, closing the window before it if it has ended.
+*
+* @details  If the stage forwards anomalies and @p value is one, an event holding it is built and handed to @p send.
+*
+* @return   0 on success, non-zero if no stage has @p output_name or an anomaly could not be sent; the sample is aggregated anyway in the latter case.
+*/
+MOCKABLE_FUNCTION(, int, telemetry_aggregation_add_sample, TELEMETRY_AGGREGATION_HANDLE, aggregation, const char*, output_name, tickcounter_ms_t, now, double, value, TELEMETRY_AGGREGATION_SEND_CALLBACK, send, void*, context);
+
+/**
+* @brief    Closes the windows ended at @p now and hands an event for each closed window to @p send, oldest first.
+*
+* @details  A window whose event is not taken stays in the ring, and the later windows of its stage wait behind it until the next call.
+*/
+MOCKABLE_FUNCTION(, void, telemetry_aggregation_flush, TELEMETRY_AGGREGATION_HANDLE, aggregation, tickcounter_ms_t, now, TELEMETRY_AGGREGATION_SEND_CALLBACK, send, void*, context);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IOTHUB_CLIENT_TELEMETRY_AGGREGATION_H
@@ -0,0 +1,43 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file    iothub_client_trace_ring_private.h
+*    @brief    How the SDK writes into the trace ring of iothub_client_trace_ring.h.
+*/
+
+#ifndef IOTHUB_CLIENT_TRACE_RING_PRIVATE_H
+#define IOTHUB_CLIENT_TRACE_RING_PRIVATE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "azure_c_shared_utility/umock_c_prod.h"
+#include "iothub_client_trace_ring.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*true between IoTHubClient_TraceRing_Start and IoTHubClient_TraceRing_Stop*/
+extern bool g_iothub_client_trace_ring_started;
+
+/**
+* @brief    Adds a record to the ring. @p source is the client or transport the event is about.
+*/
+MOCKABLE_FUNCTION(, void, IoTHubClient_TraceRing_Record, IOTHUB_CLIENT_TRACE_EVENT, event, const void*, source, uint32_t, value1, uint32_t, value2);
+
+/*costs a single test while tracing is not started*/
+#define IOTHUB_CLIENT_TRACE(event, source, value1, value2)                                          \
+    do                                                                                              \
+    {                                                                                               \
+        if (g_iothub_client_trace_ring_started)                                                     \
+        {                                                                                           \
+            IoTHubClient_TraceRing_Record((event), (source), (uint32_t)(value1), (uint32_t)(value2)); \
+        }                                                                                           \
+    } while (0)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IOTHUB_CLIENT_TRACE_RING_PRIVATE_H
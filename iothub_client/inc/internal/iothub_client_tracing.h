@@ -0,0 +1,85 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file   iothub_client_tracing.h
+*    @brief  Span bookkeeping behind OPTION_TRACE_EXPORTER: trace and span ids, W3C traceparent
+*            propagation and handing finished spans to the exporter.
+*
+*    @details A client keeps one IOTHUB_CLIENT_TRACER, and every traced operation one
+*             IOTHUB_CLIENT_TRACE_CONTEXT. Nothing is allocated. While no exporter is set the
+*             client only tests IoTHubClient_Tracing_IsEnabled.
+*/
+
+#ifndef IOTHUB_CLIENT_TRACING_H
+#define IOTHUB_CLIENT_TRACING_H
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+#include "iothub_client_core_common.h"
+
+#ifdef __cplusplus
+#include <cstddef>
+#include <cstdint>
+extern "C" {
+#else
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#endif
+
+#define TRACEPARENT_PROPERTY_NAME "traceparent"
+#define TRACEPARENT_LENGTH 55 /*"00-" 32 hex digits "-" 16 hex digits "-" 2 hex digits*/
+
+typedef struct IOTHUB_CLIENT_TRACER_TAG
+{
+    IOTHUB_CLIENT_TRACE_EXPORTER exporter; /*on_span_ended is NULL while tracing is off*/
+    uint64_t random_state;
+} IOTHUB_CLIENT_TRACER;
+
+typedef struct IOTHUB_CLIENT_TRACE_CONTEXT_TAG
+{
+    unsigned char trace_id[IOTHUB_CLIENT_TRACE_ID_SIZE];
+    unsigned char span_id[IOTHUB_CLIENT_SPAN_ID_SIZE];
+    unsigned char parent_span_id[IOTHUB_CLIENT_SPAN_ID_SIZE];
+    uint64_t ms_started;
+    uint64_t ms_published; /*only valid if published*/
+    bool published;
+    bool active; /*false once the root span was exported, or if the operation is not traced*/
+} IOTHUB_CLIENT_TRACE_CONTEXT;
+
+#define IoTHubClient_Tracing_IsEnabled(tracer) ((tracer)->exporter.on_span_ended != NULL)
+
+/**
+    * @brief    Sets or, when @p exporter or its callback is NULL, clears the exporter of @p tracer.
+    *
+    * @return   0 upon success
+    */
+MOCKABLE_FUNCTION(, int, IoTHubClient_Tracing_SetExporter, IOTHUB_CLIENT_TRACER*, tracer, const IOTHUB_CLIENT_TRACE_EXPORTER*, exporter);
+
+/**
+    * @brief    Starts the root span of an operation at @p now_ms.
+    *
+    * @param    traceparent    W3C traceparent the operation already carries, or NULL. When it parses
+    *                          the span joins its trace, otherwise a new trace is started.
+    */
+MOCKABLE_FUNCTION(, void, IoTHubClient_Tracing_Start, IOTHUB_CLIENT_TRACER*, tracer, IOTHUB_CLIENT_TRACE_CONTEXT*, context, const char*, traceparent, uint64_t, now_ms);
+
+/**
+    * @brief    Writes the traceparent naming the root span of @p context to @p buffer, which holds
+    *           at least TRACEPARENT_LENGTH + 1 characters.
+    *
+    * @return   0 upon success
+    */
+MOCKABLE_FUNCTION(, int, IoTHubClient_Tracing_FormatTraceparent, const IOTHUB_CLIENT_TRACE_CONTEXT*, context, char*, buffer, size_t, buffer_size);
+
+/**
+    * @brief    Hands a finished span of the operation of @p context to the exporter: its root span
+    *           when @p child is false, otherwise a new child of it.
+    */
+MOCKABLE_FUNCTION(, void, IoTHubClient_Tracing_ExportSpan, IOTHUB_CLIENT_TRACER*, tracer, IOTHUB_CLIENT_SPAN_KIND, kind, const IOTHUB_CLIENT_TRACE_CONTEXT*, context, bool, child, uint64_t, start_ms, uint64_t, end_ms, bool, succeeded, const char*, name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_TRACING_H */
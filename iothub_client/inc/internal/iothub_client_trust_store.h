@@ -0,0 +1,61 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file    iothub_client_trust_store.h
+*    @brief    The trusted certificates of all the clients in the process, kept once for each distinct bundle.
+*
+*    @details  Clients given the same OPTION_TRUSTED_CERT bundle share one refcounted copy of it instead
+*            of each keeping its own, and a certificate file is read once however many clients use it.
+*            The store lives between IoTHub_Init and IoTHub_Deinit; outside of them every acquire gets a
+*            private copy, released the same way.
+*/
+
+#ifndef IOTHUB_CLIENT_TRUST_STORE_H
+#define IOTHUB_CLIENT_TRUST_STORE_H
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+* @brief    Creates the process-wide store. Called by IoTHub_Init.
+*
+* @return   0 on success, non-zero otherwise.
+*/
+MOCKABLE_FUNCTION(, int, trust_store_init);
+
+/**
+* @brief    Frees the store and all it holds. Called by IoTHub_Deinit, once all the clients are destroyed.
+*/
+MOCKABLE_FUNCTION(, void, trust_store_deinit);
+
+/**
+* @brief    Gets the shared copy of @p certificates, adding it to the store if no client has it yet.
+*
+* @return   The shared copy, to be given back with trust_store_release, or NULL on failure.
+*/
+MOCKABLE_FUNCTION(, const char*, trust_store_acquire, const char*, certificates);
+
+/**
+* @brief    Gets the certificates in @p file_name, reading the file only the first time it is asked for.
+*
+* @details  The file contents are kept until trust_store_deinit, so later clients do not read it again.
+*
+* @return   The certificates, to be given back with trust_store_release, or NULL on failure.
+*/
+MOCKABLE_FUNCTION(, const char*, trust_store_acquire_file, const char*, file_name);
+
+/**
+* @brief    Gives back certificates got from trust_store_acquire or trust_store_acquire_file, freeing them once
+*           no client holds them.
+*/
+MOCKABLE_FUNCTION(, void, trust_store_release, const char*, certificates);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IOTHUB_CLIENT_TRUST_STORE_H
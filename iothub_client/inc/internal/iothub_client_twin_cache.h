@@ -0,0 +1,64 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file    iothub_client_twin_cache.h
+*    @brief    A copy of the twin kept in a file, used by IoTHubClientCore_LL to drop the twin
+*            updates that hold nothing newer than what the application was already given.
+*
+*    @details  The file holds the twin as JSON, as received with DEVICE_TWIN_UPDATE_COMPLETE, with the
+*            desired patches received since merged into its "desired" object. Updates are compared
+*            on the desired $version, and the file is rewritten after each one that is kept.
+*/
+
+#ifndef IOTHUB_CLIENT_TWIN_CACHE_H
+#define IOTHUB_CLIENT_TWIN_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "azure_c_shared_utility/umock_c_prod.h"
+#include "iothub_client_core_common.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef struct TWIN_CACHE_TAG* TWIN_CACHE_HANDLE;
+
+/**
+* @brief    Opens the twin cache kept in @p file_path, loading the twin in it if there is one.
+*
+* @details  A file that does not exist or does not hold a JSON object leaves the cache empty.
+*
+* @return   A handle to the twin cache, or NULL on failure.
+*/
+MOCKABLE_FUNCTION(, TWIN_CACHE_HANDLE, twin_cache_create, const char*, file_path);
+
+/**
+* @brief    Closes the twin cache. The file is kept for the next twin cache created on it.
+*/
+MOCKABLE_FUNCTION(, void, twin_cache_destroy, TWIN_CACHE_HANDLE, twin_cache);
+
+/**
+* @brief    Compares @p payload with the cached twin and, if it is newer, keeps it and rewrites the file.
+*
+* @details  A complete twin is newer when its desired $version is not the cached one, a patch when its
+*           $version is above the cached one; an update without a $version is always newer. A patch is
+*           merged into the cached "desired" object, a null member removing the property.
+*
+* @return   true if @p payload should be given to the application, false if it holds nothing newer.
+*/
+MOCKABLE_FUNCTION(, bool, twin_cache_update, TWIN_CACHE_HANDLE, twin_cache, DEVICE_TWIN_UPDATE_STATE, update_state, const unsigned char*, payload, size_t, size);
+
+/**
+* @brief    Gets the cached twin, in the form of a DEVICE_TWIN_UPDATE_COMPLETE payload.
+*
+* @return   The cached twin, owned by the cache and valid until its next update, or NULL if it is empty.
+*/
+MOCKABLE_FUNCTION(, const char*, twin_cache_get_twin, TWIN_CACHE_HANDLE, twin_cache);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IOTHUB_CLIENT_TWIN_CACHE_H
@@ -0,0 +1,66 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file    iothub_client_twin_fanout.h
+*    @brief    The desired property path subscriptions of IoTHubClientCore_LL, each twin update
+*            being parsed once for all of them.
+*
+*    @details  A path names members from the root of the twin, separated by dots, for instance
+*            "desired.motors.left"; a "*" segment matches every member not starting with '$'.
+*            A DEVICE_TWIN_UPDATE_PARTIAL patch is matched as the "desired" object of the twin.
+*            Each subscription is called once for every property of the update found at its path.
+*/
+
+#ifndef IOTHUB_CLIENT_TWIN_FANOUT_H
+#define IOTHUB_CLIENT_TWIN_FANOUT_H
+
+#include <stddef.h>
+#include "azure_c_shared_utility/umock_c_prod.h"
+#include "iothub_client_core_common.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef struct TWIN_FANOUT_TAG* TWIN_FANOUT_HANDLE;
+
+/**
+* @brief    Creates a set of subscriptions, empty.
+*
+* @return   A handle to the subscriptions, or NULL on failure.
+*/
+MOCKABLE_FUNCTION(, TWIN_FANOUT_HANDLE, twin_fanout_create);
+
+/**
+* @brief    Frees the subscriptions.
+*/
+MOCKABLE_FUNCTION(, void, twin_fanout_destroy, TWIN_FANOUT_HANDLE, twin_fanout);
+
+/**
+* @brief    Subscribes @p callback to the properties at @p path, replacing the callback of the same
+*           path, or removes the subscription of @p path if @p callback is NULL.
+*
+* @details  Must not be called from a callback of @p twin_fanout.
+*
+* @return   0 on success, non-zero if @p path is not a valid path, allocating fails or there is
+*           no subscription to remove.
+*/
+MOCKABLE_FUNCTION(, int, twin_fanout_set_callback, TWIN_FANOUT_HANDLE, twin_fanout, const char*, path, IOTHUB_CLIENT_DESIRED_PROPERTY_CALLBACK, callback, void*, userContextCallback);
+
+/**
+* @brief    Gets the number of subscriptions.
+*/
+MOCKABLE_FUNCTION(, size_t, twin_fanout_get_count, TWIN_FANOUT_HANDLE, twin_fanout);
+
+/**
+* @brief    Parses @p payload once and calls the subscriptions whose path it holds, in the order
+*           they were made.
+*/
+MOCKABLE_FUNCTION(, void, twin_fanout_dispatch, TWIN_FANOUT_HANDLE, twin_fanout, DEVICE_TWIN_UPDATE_STATE, update_state, const unsigned char*, payload, size_t, size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IOTHUB_CLIENT_TWIN_FANOUT_H
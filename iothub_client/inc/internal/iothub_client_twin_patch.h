@@ -0,0 +1,37 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file    iothub_client_twin_patch.h
+*    @brief    Merges reported state patches, used by IoTHubClientCore_LL to send the patches
+*            queued within OPTION_TWIN_COALESCE_WINDOW as one.
+*/
+
+#ifndef IOTHUB_CLIENT_TWIN_PATCH_H
+#define IOTHUB_CLIENT_TWIN_PATCH_H
+
+#include <stddef.h>
+#include "azure_c_shared_utility/umock_c_prod.h"
+#include "azure_c_shared_utility/constbuffer.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+* @brief    Applies @p next_patch on top of @p patch, as the hub would when receiving both in order.
+*
+* @details  Members of @p next_patch replace the members of @p patch with the same name, except that
+*           two objects are merged member by member. A null member is kept, so the hub still deletes
+*           the property.
+*
+* @return   A new buffer holding the merged JSON object, or NULL on failure or if either patch is not
+*           a JSON object. @p patch still belongs to the caller.
+*/
+MOCKABLE_FUNCTION(, CONSTBUFFER_HANDLE, twin_patch_merge, CONSTBUFFER_HANDLE, patch, const unsigned char*, next_patch, size_t, next_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IOTHUB_CLIENT_TWIN_PATCH_H
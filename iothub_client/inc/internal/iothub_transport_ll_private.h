@@ -31,6 +31,8 @@ extern "C"
 
     typedef bool (*pfTransport_MessageCallbackFromInput)(MESSAGE_CALLBACK_INFO* messageData, void* ctx);
     typedef bool (*pfTransport_MessageCallback)(MESSAGE_CALLBACK_INFO* messageData, void* ctx);
+    /*returns false, before any slice of the message is taken, if the message shall be delivered through pfTransport_MessageCallback instead*/
+    typedef bool (*pfTransport_MessageChunkCallback)(const unsigned char* chunk, size_t size, size_t offset, size_t total_size, void* ctx);
     typedef void (*pfTransport_ConnectionStatusCallBack)(IOTHUB_CLIENT_CONNECTION_STATUS status, IOTHUB_CLIENT_CONNECTION_STATUS_REASON reason, void* ctx);
     typedef void (*pfTransport_SendComplete_Callback)(PDLIST_ENTRY completed, IOTHUB_CLIENT_CONFIRMATION_RESULT result, void* ctx);
     typedef const char* (*pfTransport_GetOption_Product_Info_Callback)(void* ctx);
@@ -38,6 +40,26 @@ extern "C"
     typedef void (*pfTransport_Twin_RetrievePropertyComplete_Callback)(DEVICE_TWIN_UPDATE_STATE update_state, const unsigned char* payLoad, size_t size, void* ctx);
     typedef int (*pfTransport_DeviceMethod_Complete_Callback)(const char* method_name, const unsigned char* payLoad, size_t size, METHOD_HANDLE response_id, void* ctx);
 
+    struct IOTHUB_MESSAGE_LIST_TAG;
+
+#define TRANSPORT_STATISTIC_VALUES          \
+    TRANSPORT_STATISTIC_EVENT_PUBLISHED,    \
+    TRANSPORT_STATISTIC_EVENT_ACKNOWLEDGED, \
+    TRANSPORT_STATISTIC_EVENT_FAILED,       \
+    TRANSPORT_STATISTIC_BYTES_RECEIVED,     \
+    TRANSPORT_STATISTIC_BATCH_SENT,         \
+    TRANSPORT_STATISTIC_BATCH_CAPACITY,     \
+    TRANSPORT_STATISTIC_AUTHENTICATION_STARTED, \
+    TRANSPORT_STATISTIC_AUTHENTICATED
+
+    DEFINE_ENUM(TRANSPORT_STATISTIC, TRANSPORT_STATISTIC_VALUES);
+
+    /* message is the event concerned, or NULL for bytes that belong to no single event; size is the payload size put on or taken off the wire.
+       The _ACKNOWLEDGED and _FAILED statistics are only for transports that complete events without calling send_complete_cb.
+       Transports that batch events report _BATCH_SENT with the bytes of each batch, followed by _BATCH_CAPACITY with the most bytes that batch could hold.
+       Transports that authenticate each device on their own report _AUTHENTICATION_STARTED when the device starts authenticating and _AUTHENTICATED once it has, both with size 0. */
+    typedef void (*pfTransport_Statistics_Callback)(TRANSPORT_STATISTIC statistic, struct IOTHUB_MESSAGE_LIST_TAG* message, size_t size, void* ctx);
+
     /** @brief    This struct captures device configuration. */
     typedef struct IOTHUB_DEVICE_CONFIG_TAG
     {
@@ -60,12 +82,14 @@ extern "C"
     {
         pfTransport_MessageCallbackFromInput msg_input_cb;
         pfTransport_MessageCallback msg_cb;
+        pfTransport_MessageChunkCallback msg_chunk_cb; /*optional, can be NULL*/
         pfTransport_ConnectionStatusCallBack connection_status_cb;
         pfTransport_SendComplete_Callback send_complete_cb;
         pfTransport_GetOption_Product_Info_Callback prod_info_cb;
         pfTransport_Twin_ReportedStateComplete_Callback twin_rpt_state_complete_cb;
         pfTransport_Twin_RetrievePropertyComplete_Callback twin_retrieve_prop_complete_cb;
         pfTransport_DeviceMethod_Complete_Callback method_complete_cb;
+        pfTransport_Statistics_Callback statistics_cb; /*optional, can be NULL*/
     } TRANSPORT_CALLBACKS_INFO;
 
     typedef STRING_HANDLE (*pfIoTHubTransport_GetHostname)(TRANSPORT_LL_HANDLE handle);
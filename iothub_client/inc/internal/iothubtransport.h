@@ -42,6 +42,10 @@ extern "C"
     MOCKABLE_FUNCTION(, bool, IoTHubTransport_SignalEndWorkerThread, TRANSPORT_HANDLE, transportHandle, IOTHUB_CLIENT_CORE_HANDLE, clientHandle);
     MOCKABLE_FUNCTION(, void, IoTHubTransport_JoinWorkerThread, TRANSPORT_HANDLE, transportHandle, IOTHUB_CLIENT_CORE_HANDLE, clientHandle);
 
+    /** @brief  Asks the worker thread to call the multiplexed DoWork of @p clientHandle on its next tick. The
+    *           worker only calls it for clients that signaled. May be called while holding the transport lock. */
+    MOCKABLE_FUNCTION(, void, IoTHubTransport_SignalClientWork, TRANSPORT_HANDLE, transportHandle, IOTHUB_CLIENT_CORE_HANDLE, clientHandle);
+
 #ifdef __cplusplus
 }
 #endif
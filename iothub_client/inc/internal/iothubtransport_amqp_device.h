@@ -23,6 +23,10 @@ static const char* DEVICE_OPTION_EVENT_SEND_TIMEOUT_SECS = "event_send_timeout_s
 static const char* DEVICE_OPTION_CBS_REQUEST_TIMEOUT_SECS = "cbs_request_timeout_secs";
 static const char* DEVICE_OPTION_SAS_TOKEN_REFRESH_TIME_SECS = "sas_token_refresh_time_secs";
 static const char* DEVICE_OPTION_SAS_TOKEN_LIFETIME_SECS = "sas_token_lifetime_secs";
+static const char* DEVICE_OPTION_BATCH_LINGER_MS = "batch_linger_ms";
+static const char* DEVICE_OPTION_BATCH_MAX_MESSAGES = "batch_max_messages";
+static const char* DEVICE_OPTION_C2D_LINK_CREDIT = "c2d_link_credit";
+static const char* DEVICE_OPTION_TWIN_LINK_IDLE_TIMEOUT_SECS = "twin_link_idle_timeout_secs";
 
 #define DEVICE_STATE_VALUES \
     DEVICE_STATE_STOPPED, \
@@ -86,6 +90,7 @@ typedef struct DEVICE_MESSAGE_DISPOSITION_INFO_TAG
 typedef void(*ON_DEVICE_STATE_CHANGED)(void* context, DEVICE_STATE previous_state, DEVICE_STATE new_state);
 typedef DEVICE_MESSAGE_DISPOSITION_RESULT(*ON_DEVICE_C2D_MESSAGE_RECEIVED)(IOTHUB_MESSAGE_HANDLE message, DEVICE_MESSAGE_DISPOSITION_INFO* disposition_info, void* context);
 typedef void(*ON_DEVICE_D2C_EVENT_SEND_COMPLETE)(IOTHUB_MESSAGE_LIST* message, D2C_EVENT_SEND_RESULT result, void* context);
+typedef void(*ON_DEVICE_D2C_BATCH_SENT)(size_t event_count, size_t batch_size, size_t batch_capacity, void* context);
 typedef void(*DEVICE_SEND_TWIN_UPDATE_COMPLETE_CALLBACK)(DEVICE_TWIN_UPDATE_RESULT result, int status_code, void* context);
 typedef void(*DEVICE_TWIN_UPDATE_RECEIVED_CALLBACK)(DEVICE_TWIN_UPDATE_TYPE update_type, const unsigned char* message, size_t length, void* context);
 
@@ -99,6 +104,10 @@ typedef struct DEVICE_CONFIG_TAG
     ON_DEVICE_STATE_CHANGED on_state_changed_callback;
     void* on_state_changed_context;
 
+    // Optional; invoked each time a batch of D2C events is handed to the AMQP link
+    ON_DEVICE_D2C_BATCH_SENT on_batch_sent_callback;
+    void* on_batch_sent_context;
+
     // Auth module used to generating handle authorization
     // with either SAS Token, x509 Certs, and Device SAS Token
     IOTHUB_AUTHORIZATION_HANDLE authorization_module;
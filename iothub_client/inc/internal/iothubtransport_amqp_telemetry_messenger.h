@@ -20,6 +20,9 @@ extern "C"
 
 
 static const char* TELEMETRY_MESSENGER_OPTION_EVENT_SEND_TIMEOUT_SECS = "telemetry_event_send_timeout_secs";
+static const char* TELEMETRY_MESSENGER_OPTION_BATCH_LINGER_MS = "telemetry_batch_linger_ms";
+static const char* TELEMETRY_MESSENGER_OPTION_BATCH_MAX_MESSAGES = "telemetry_batch_max_messages";
+static const char* TELEMETRY_MESSENGER_OPTION_C2D_LINK_CREDIT = "telemetry_c2d_link_credit";
 static const char* TELEMETRY_MESSENGER_OPTION_SAVED_OPTIONS = "saved_telemetry_messenger_options";
 
 typedef struct TELEMETRY_MESSENGER_INSTANCE* TELEMETRY_MESSENGER_HANDLE;
@@ -65,6 +68,7 @@ typedef struct TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO_TAG
 typedef void(*ON_TELEMETRY_MESSENGER_EVENT_SEND_COMPLETE)(IOTHUB_MESSAGE_LIST* iothub_message_list, TELEMETRY_MESSENGER_EVENT_SEND_COMPLETE_RESULT messenger_event_send_complete_result, void* context);
 typedef void(*ON_TELEMETRY_MESSENGER_STATE_CHANGED_CALLBACK)(void* context, TELEMETRY_MESSENGER_STATE previous_state, TELEMETRY_MESSENGER_STATE new_state);
 typedef TELEMETRY_MESSENGER_DISPOSITION_RESULT(*ON_TELEMETRY_MESSENGER_MESSAGE_RECEIVED)(IOTHUB_MESSAGE_HANDLE message, TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO* disposition_info, void* context);
+typedef void(*ON_TELEMETRY_MESSENGER_BATCH_SENT)(size_t event_count, size_t batch_size, size_t batch_capacity, void* context);
 
 typedef struct TELEMETRY_MESSENGER_CONFIG_TAG
 {
@@ -73,6 +77,8 @@ typedef struct TELEMETRY_MESSENGER_CONFIG_TAG
     char* iothub_host_fqdn;
     ON_TELEMETRY_MESSENGER_STATE_CHANGED_CALLBACK on_state_changed_callback;
     void* on_state_changed_context;
+    ON_TELEMETRY_MESSENGER_BATCH_SENT on_batch_sent_callback;
+    void* on_batch_sent_context;
 } TELEMETRY_MESSENGER_CONFIG;
 
 #define AMQP_BATCHING_RESERVE_SIZE              (1024)
@@ -32,6 +32,7 @@ extern "C"
     MOCKABLE_FUNCTION(, int, iothubtransportamqp_methods_respond, IOTHUBTRANSPORT_AMQP_METHOD_HANDLE, method_handle,
         const unsigned char*, response, size_t, response_size, int, status_code);
     MOCKABLE_FUNCTION(, void, iothubtransportamqp_methods_unsubscribe, IOTHUBTRANSPORT_AMQP_METHODS_HANDLE, iothubtransport_amqp_methods_handle);
+    MOCKABLE_FUNCTION(, int, iothubtransportamqp_methods_set_link_credit, IOTHUBTRANSPORT_AMQP_METHODS_HANDLE, iothubtransport_amqp_methods_handle, size_t, link_credit);
 
 #ifdef __cplusplus
 }
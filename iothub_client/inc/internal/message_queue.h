@@ -11,6 +11,7 @@
 #include "azure_c_shared_utility/macro_utils.h"
 #include "azure_c_shared_utility/umock_c_prod.h"
 #include "azure_c_shared_utility/optionhandler.h"
+#include "iothub_client_core_common.h"
 
 #ifdef __cplusplus
 extern "C"
@@ -30,6 +31,34 @@ typedef void* USER_DEFINED_REASON;
 
 DEFINE_ENUM(MESSAGE_QUEUE_RESULT, MESSAGE_QUEUE_RESULT_STRINGS);
 
+#define MESSAGE_QUEUE_PRIORITY_VALUES   \
+    MESSAGE_QUEUE_PRIORITY_LOW,         \
+    MESSAGE_QUEUE_PRIORITY_NORMAL,      \
+    MESSAGE_QUEUE_PRIORITY_HIGH
+
+/**
+* @brief    Priority class of a queued message. Pending messages are processed strictly by priority
+*           (all HIGH first, then NORMAL, then LOW) and in FIFO order within the same priority.
+*/
+DEFINE_ENUM(MESSAGE_QUEUE_PRIORITY, MESSAGE_QUEUE_PRIORITY_VALUES);
+
+#define MESSAGE_QUEUE_OVERFLOW_POLICY_VALUES          \
+    MESSAGE_QUEUE_OVERFLOW_REJECT,                    \
+    MESSAGE_QUEUE_OVERFLOW_DROP_OLDEST,               \
+    MESSAGE_QUEUE_OVERFLOW_DROP_LOWEST_PRIORITY
+
+/**
+* @brief    What message_queue_add does when the pending messages would exceed the limits set with message_queue_set_max_size:
+*           fail the new message, or drop pending messages (oldest first, or lowest priority first) until it fits.
+*           Dropped messages complete with MESSAGE_QUEUE_CANCELLED.
+*/
+DEFINE_ENUM(MESSAGE_QUEUE_OVERFLOW_POLICY, MESSAGE_QUEUE_OVERFLOW_POLICY_VALUES);
+
+/**
+* @brief    User-provided callback returning the number of bytes a message accounts for in the MESSAGE_QUEUE pending limit.
+*/
+typedef size_t(*MESSAGE_QUEUE_GET_MESSAGE_SIZE)(MQ_MESSAGE_HANDLE message);
+
 /**
 * @brief    User-provided callback invoked by MESSAGE_QUEUE back to the user when a messages completes being processed.
 */
@@ -88,10 +117,26 @@ MOCKABLE_FUNCTION(, void, message_queue_destroy, MESSAGE_QUEUE_HANDLE, message_q
 *
 * @param    message A generic message to be queued and then processed (i.e., sent, consolidated, etc).
 *
+* @remarks  Same as message_queue_add_with_priority with MESSAGE_QUEUE_PRIORITY_NORMAL.
+*
 * @returns    Zero if the no errors occur, non-zero otherwise.
 */
 MOCKABLE_FUNCTION(, int, message_queue_add, MESSAGE_QUEUE_HANDLE, message_queue, MQ_MESSAGE_HANDLE, message, MESSAGE_PROCESSING_COMPLETED_CALLBACK, on_message_processing_completed_callback, void*, user_context);
 
+/**
+* @brief    Adds a new generic message to the MESSAGE_QUEUE pending list of the given priority.
+*
+* @param    message_queue    A @c MESSAGE_QUEUE_HANDLE obtained using message_queue_create.
+*
+* @param    message A generic message to be queued and then processed (i.e., sent, consolidated, etc).
+*
+* @param    priority    Priority class of @c message. On the next message_queue_do_work all pending messages of a
+*                       higher priority are processed before it, regardless of how many lower priority messages are queued.
+*
+* @returns    Zero if the no errors occur, non-zero otherwise.
+*/
+MOCKABLE_FUNCTION(, int, message_queue_add_with_priority, MESSAGE_QUEUE_HANDLE, message_queue, MQ_MESSAGE_HANDLE, message, MESSAGE_QUEUE_PRIORITY, priority, MESSAGE_PROCESSING_COMPLETED_CALLBACK, on_message_processing_completed_callback, void*, user_context);
+
 /**
 * @brief    Causes all messages in-progress to be moved back to the beginning of the pending list.
 *
@@ -126,6 +171,19 @@ MOCKABLE_FUNCTION(, void, message_queue_remove_all, MESSAGE_QUEUE_HANDLE, messag
 */
 MOCKABLE_FUNCTION(, int, message_queue_is_empty, MESSAGE_QUEUE_HANDLE, message_queue, bool*, is_empty);
 
+/**
+* @brief    Gets the number of messages currently in-progress (handed to the processing callback and not yet completed).
+*
+* @param    message_queue    A @c MESSAGE_QUEUE_HANDLE obtained using message_queue_create.
+*
+* @param    @c count Set to the number of in-progress messages.
+*
+* @remarks    The count is maintained as messages move in and out of in-progress, so this call does not scan the queue.
+*
+* @returns    Zero if the no errors occur, non-zero otherwise.
+*/
+MOCKABLE_FUNCTION(, int, message_queue_get_in_progress_count, MESSAGE_QUEUE_HANDLE, message_queue, size_t*, count);
+
 /**
 * @brief    Causes MESSAGE_QUEUE to go through its list of pending messages and move them to in-progress, as well as trigering retry and timeout controls.
 *
@@ -144,6 +202,17 @@ MOCKABLE_FUNCTION(, void, message_queue_do_work, MESSAGE_QUEUE_HANDLE, message_q
 */
 MOCKABLE_FUNCTION(, int, message_queue_set_max_message_enqueued_time_secs, MESSAGE_QUEUE_HANDLE, message_queue, size_t, seconds);
 
+/**
+* @brief    Sets the maximum time, in milliseconds, a message will be within MESSAGE_QUEUE (in either pending or in-progress lists).
+*
+* @param    message_queue    A @c MESSAGE_QUEUE_HANDLE obtained using message_queue_create.
+*
+* @param    milliseconds    Number of milliseconds to set for this timeout. A value of zero de-activates this timeout control.
+*
+* @returns    Zero if the no errors occur, non-zero otherwise.
+*/
+MOCKABLE_FUNCTION(, int, message_queue_set_max_message_enqueued_time_ms, MESSAGE_QUEUE_HANDLE, message_queue, size_t, milliseconds);
+
 /**
 * @brief    Sets the maximum time, in seconds, a message will be in-progress within MESSAGE_QUEUE.
 *
@@ -155,6 +224,17 @@ MOCKABLE_FUNCTION(, int, message_queue_set_max_message_enqueued_time_secs, MESSA
 */
 MOCKABLE_FUNCTION(, int, message_queue_set_max_message_processing_time_secs, MESSAGE_QUEUE_HANDLE, message_queue, size_t, seconds);
 
+/**
+* @brief    Sets the maximum time, in milliseconds, a message will be in-progress within MESSAGE_QUEUE.
+*
+* @param    message_queue    A @c MESSAGE_QUEUE_HANDLE obtained using message_queue_create.
+*
+* @param    milliseconds    Number of milliseconds to set for this timeout. A value of zero de-activates this timeout control.
+*
+* @returns    Zero if the no errors occur, non-zero otherwise.
+*/
+MOCKABLE_FUNCTION(, int, message_queue_set_max_message_processing_time_ms, MESSAGE_QUEUE_HANDLE, message_queue, size_t, milliseconds);
+
 /**
 * @brief    Sets the maximum number of times MESSAGE_QUEUE will try to re-process a message (no counting the initial attempt).
 *
@@ -166,6 +246,39 @@ MOCKABLE_FUNCTION(, int, message_queue_set_max_message_processing_time_secs, MES
 */
 MOCKABLE_FUNCTION(, int, message_queue_set_max_retry_count, MESSAGE_QUEUE_HANDLE, message_queue, size_t, max_retry_count);
 
+/**
+* @brief    Bounds the messages pending in MESSAGE_QUEUE (in-progress messages are not counted, nor dropped).
+*
+* @param    message_queue    A @c MESSAGE_QUEUE_HANDLE obtained using message_queue_create.
+*
+* @param    max_message_count    Maximum number of pending messages. Zero means no limit.
+*
+* @param    max_message_bytes    Maximum sum of the sizes of the pending messages, as returned by @c get_message_size. Zero means no limit.
+*
+* @param    policy    What message_queue_add shall do when a new message does not fit.
+*
+* @param    get_message_size    Returns the size of a message. Required if @c max_message_bytes is not zero.
+*
+* @remarks    A maximum of bytes can only be set while no messages are pending, since sizes are only recorded while it is set.
+*
+* @returns    Zero if the no errors occur, non-zero otherwise.
+*/
+MOCKABLE_FUNCTION(, int, message_queue_set_max_size, MESSAGE_QUEUE_HANDLE, message_queue, size_t, max_message_count, size_t, max_message_bytes, MESSAGE_QUEUE_OVERFLOW_POLICY, policy, MESSAGE_QUEUE_GET_MESSAGE_SIZE, get_message_size);
+
+/**
+* @brief    Sets how long MESSAGE_QUEUE waits before re-processing a message that failed with MESSAGE_QUEUE_RETRYABLE_ERROR.
+*
+* @param    message_queue    A @c MESSAGE_QUEUE_HANDLE obtained using message_queue_create.
+*
+* @param    policy    How the wait grows with the attempts of each message. IOTHUB_CLIENT_RETRY_NONE and IOTHUB_CLIENT_RETRY_IMMEDIATE
+*                     (the default) re-process it at once.
+*
+* @remarks    Messages waiting for their retry stay in place in the pending list; the messages behind them are still processed.
+*
+* @returns    Zero if the no errors occur, non-zero otherwise.
+*/
+MOCKABLE_FUNCTION(, int, message_queue_set_retry_policy, MESSAGE_QUEUE_HANDLE, message_queue, IOTHUB_CLIENT_RETRY_POLICY, policy);
+
 /**
 * @brief    Retrieves a blob with all the options currently set in the instance of MESSAGE_QUEUE.
 *
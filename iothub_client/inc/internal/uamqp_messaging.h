@@ -16,6 +16,14 @@ extern "C"
     MOCKABLE_FUNCTION(, int, message_create_IoTHubMessage_from_uamqp_message, MESSAGE_HANDLE, uamqp_message, IOTHUB_MESSAGE_HANDLE*, iothubclient_message);
     MOCKABLE_FUNCTION(, int, message_create_uamqp_encoding_from_iothub_message, MESSAGE_HANDLE, message_batch_container, IOTHUB_MESSAGE_HANDLE, message_handle, BINARY_DATA*, body_binary_data);
 
+    /* Keeps the last encoded message and application properties, and one encoding buffer, so consecutive messages with the same properties skip re-encoding them. */
+    typedef struct UAMQP_ENCODING_CACHE_TAG* UAMQP_ENCODING_CACHE_HANDLE;
+
+    MOCKABLE_FUNCTION(, UAMQP_ENCODING_CACHE_HANDLE, uamqp_encoding_cache_create);
+    MOCKABLE_FUNCTION(, void, uamqp_encoding_cache_destroy, UAMQP_ENCODING_CACHE_HANDLE, cache);
+    /* Same as message_create_uamqp_encoding_from_iothub_message, but body_binary_data->bytes belongs to the cache: it must not be freed and is only valid until the next call. */
+    MOCKABLE_FUNCTION(, int, message_create_uamqp_encoding_from_iothub_message_with_cache, UAMQP_ENCODING_CACHE_HANDLE, cache, MESSAGE_HANDLE, message_batch_container, IOTHUB_MESSAGE_HANDLE, message_handle, BINARY_DATA*, body_binary_data);
+
 #ifdef __cplusplus
 }
 #endif
@@ -125,6 +125,48 @@ extern "C"
     */
     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_SendEventAsync, IOTHUB_CLIENT_HANDLE, iotHubClientHandle, IOTHUB_MESSAGE_HANDLE, eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, eventConfirmationCallback, void*, userContextCallback);
 
+    /**
+    * @brief    Asynchronous call to send the message specified by @p eventMessageHandle
+    *           without copying it. On success the client takes ownership of the message
+    *           and destroys it once it has been confirmed; the caller must not use
+    *           @p eventMessageHandle afterwards. On failure the caller still owns it.
+    *
+    * @param    iotHubClientHandle            The handle created by a call to the create function.
+    * @param    eventMessageHandle            The handle to an IoT Hub message.
+    * @param    eventConfirmationCallback     The callback receiving confirmation of the delivery
+    *                                         of the IoT Hub message. The user can specify a @c NULL
+    *                                         value here to indicate that no callback is required.
+    * @param    userContextCallback           User specified context that will be provided to the
+    *                                         callback. This can be @c NULL.
+    *
+    *            @b NOTE: The application behavior is undefined if the user calls
+    *            the ::IoTHubClient_Destroy function from within any callback.
+    *
+    * @return    IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_SendEventAsync_TakeOwnership, IOTHUB_CLIENT_HANDLE, iotHubClientHandle, IOTHUB_MESSAGE_HANDLE, eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, eventConfirmationCallback, void*, userContextCallback);
+
+    /**
+    * @brief    Sets a callback that receives, once per DoWork, the confirmations of all
+    *           events that were sent without their own confirmation callback.
+    *
+    * @param    iotHubClientHandle               The handle created by a call to the create function.
+    * @param    eventConfirmationBatchCallback   The callback receiving an array of (userContextCallback,
+    *                                            result) pairs, in completion order. The array is only
+    *                                            valid for the duration of the call. Pass @c NULL to stop
+    *                                            batching.
+    * @param    userContextCallback              User specified context that will be provided to the
+    *                                            callback. This can be @c NULL.
+    *
+    *            While a batch callback is set, ::IoTHubClient_SendEventAsync may be called with a
+    *            @c NULL eventConfirmationCallback and a non-NULL userContextCallback; that context is
+    *            what the batch reports for the message. Events sent with their own callback keep
+    *            receiving it individually. Not supported when the transport is shared.
+    *
+    * @return    IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_SetEventConfirmationBatchCallback, IOTHUB_CLIENT_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_BATCH_CALLBACK, eventConfirmationBatchCallback, void*, userContextCallback);
+
     /**
     * @brief    This function returns the current sending status for IoTHubClient.
     *
@@ -139,6 +181,19 @@ extern "C"
     */
     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_GetSendStatus, IOTHUB_CLIENT_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_STATUS*, iotHubClientStatus);
 
+    /**
+    * @brief    This function returns the counters and latency histograms of the send path.
+    *           They are only collected once OPTION_ENABLE_STATISTICS has been set to true;
+    *           the number of events waiting to be sent is always filled in.
+    *
+    * @param    iotHubClientHandle        The handle created by a call to the create function.
+    * @param    statistics                The statistics are copied to the address pointed
+    *                                     at by this parameter.
+    *
+    * @return    IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_GetStatistics, IOTHUB_CLIENT_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_STATISTICS*, statistics);
+
     /**
     * @brief    Sets up the message callback to be invoked when IoT Hub issues a
     *             message to the device. This is a blocking call.
@@ -320,6 +375,27 @@ extern "C"
     */
     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_SetDeviceMethodCallback, IOTHUB_CLIENT_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC, deviceMethodCallback, void*, userContextCallback);
 
+    /**
+    * @brief    This API sets the callback for the cloud to device method called @p methodName.
+    *           Handlers are looked up by method name before the callback set by
+    *           the method callback API, which keeps receiving every other method.
+    *
+    * @param    iotHubClientHandle        The handle created by a call to the create function.
+    * @param    methodName                The name of the method handled by the callback.
+    * @param    methodCallback            The callback which will be called by IoTHub, or @c NULL
+    *                                     to remove the handler of @p methodName.
+    * @param    userContextCallback       User specified context that will be provided to the
+    *                                     callback. This can be @c NULL.
+    * @param    workerThreadCount         The number of threads running @p methodCallback. With 0 the
+    *                                     callback runs on the thread running every other callback;
+    *                                     otherwise a slow invocation of this method does not delay
+    *                                     other callbacks. The count is fixed by the first
+    *                                     registration of @p methodName.
+    *
+    * @return    IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_SetDeviceMethodHandler, IOTHUB_CLIENT_HANDLE, iotHubClientHandle, const char*, methodName, IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC, methodCallback, void*, userContextCallback, size_t, workerThreadCount);
+
     /**
     * @brief    This API sets callback for async cloud to device method call.
     *
@@ -0,0 +1,49 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file iothub_client_connect_admission.h
+*    @brief How fast the clients of the process may open connections.
+*
+*    @details Once started, the MQTT and AMQP transports of every client of
+*             the process take a token from one shared bucket before they
+*             open a connection, and wait for the next DoWork when there is
+*             none. Start it in gateways hosting many clients so that, when
+*             their uplink comes back, they do not all run their TLS
+*             handshakes at the same time, time them out and retry again.
+*/
+
+#ifndef IOTHUB_CLIENT_CONNECT_ADMISSION_H
+#define IOTHUB_CLIENT_CONNECT_ADMISSION_H
+
+#include <stdint.h>
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+    * @brief    Starts bounding the connections the clients of the process open.
+    *
+    * @param    connects_per_second   Tokens added to the bucket every second.
+    * @param    burst                 Tokens the bucket holds, which is how many
+    *                                 connections can be opened at once. The
+    *                                 bucket starts full.
+    *
+    * @return   0 on success, non-zero if an argument is 0, admission control is
+    *           already started or its lock or clock cannot be created.
+    */
+    MOCKABLE_FUNCTION(, int, IoTHubClient_ConnectAdmission_Start, uint32_t, connects_per_second, uint32_t, burst);
+
+    /**
+    * @brief    Stops bounding the connections. Clients must not be running in
+    *           other threads while it is called.
+    */
+    MOCKABLE_FUNCTION(, void, IoTHubClient_ConnectAdmission_Stop);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_CONNECT_ADMISSION_H */
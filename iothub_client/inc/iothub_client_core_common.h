@@ -6,6 +6,10 @@
 #ifndef IOTHUB_CLIENT_CORE_COMMON_H
 #define IOTHUB_CLIENT_CORE_COMMON_H
 
+#ifndef __cplusplus
+#include <stdbool.h>
+#endif
+
 #include "azure_c_shared_utility/macro_utils.h"
 #include "azure_c_shared_utility/umock_c_prod.h"
 
@@ -45,7 +49,8 @@ extern "C"
     IOTHUB_CLIENT_RETRY_LINEAR_BACKOFF,      \
     IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF,                 \
     IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_JITTER,                 \
-    IOTHUB_CLIENT_RETRY_RANDOM
+    IOTHUB_CLIENT_RETRY_RANDOM,                 \
+    IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_DECORRELATED_JITTER
 
     /** @brief Enumeration passed in by the IoT Hub when the event confirmation
     *           callback is invoked to indicate status of the event processing in
@@ -149,10 +154,176 @@ extern "C"
     DEFINE_ENUM(DEVICE_TWIN_UPDATE_STATE, DEVICE_TWIN_UPDATE_STATE_VALUES);
 
     typedef void(*IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK)(IOTHUB_CLIENT_CONFIRMATION_RESULT result, void* userContextCallback);
+
+    /** @brief One completed event, as delivered to an ::IOTHUB_CLIENT_EVENT_CONFIRMATION_BATCH_CALLBACK. */
+    typedef struct IOTHUB_CLIENT_EVENT_CONFIRMATION_TAG
+    {
+        IOTHUB_CLIENT_CONFIRMATION_RESULT result;
+        void* userContextCallback; /*the context passed to SendEventAsync*/
+    } IOTHUB_CLIENT_EVENT_CONFIRMATION;
+
+    typedef void(*IOTHUB_CLIENT_EVENT_CONFIRMATION_BATCH_CALLBACK)(const IOTHUB_CLIENT_EVENT_CONFIRMATION* confirmations, size_t confirmationCount, void* userContextCallback);
+
+/** @brief Largest payload IoTHubClient_LL_SendSmallEvent copies into a slot of OPTION_SMALL_EVENT_SLOTS. */
+#define IOTHUB_CLIENT_SMALL_EVENT_MAX_SIZE 256
+
+#define IOTHUB_CLIENT_LATENCY_HISTOGRAM_BUCKETS 24
+
+    /** @brief Distribution of one latency, in milliseconds. Bucket 0 counts samples under 1 ms, bucket i counts samples in [2^(i-1), 2^i) ms and the last bucket also counts everything longer. */
+    typedef struct IOTHUB_CLIENT_LATENCY_HISTOGRAM_TAG
+    {
+        uint64_t count;
+        uint64_t sum_ms;
+        uint64_t min_ms;
+        uint64_t max_ms;
+        uint64_t buckets[IOTHUB_CLIENT_LATENCY_HISTOGRAM_BUCKETS];
+    } IOTHUB_CLIENT_LATENCY_HISTOGRAM;
+
+    /** @brief Snapshot of a client's send path, as returned by IoTHubClient_GetStatistics. Only waiting_to_send is filled in unless OPTION_ENABLE_STATISTICS is set. */
+    typedef struct IOTHUB_CLIENT_STATISTICS_TAG
+    {
+        size_t waiting_to_send;     /*events queued and not yet taken by the transport*/
+        uint64_t events_queued;
+        uint64_t events_published;  /*events the transport has put on the wire at least once*/
+        uint64_t events_confirmed;
+        uint64_t events_failed;     /*events completed with any result other than IOTHUB_CLIENT_CONFIRMATION_OK*/
+        uint64_t bytes_sent;        /*event payload bytes, counting every publish attempt*/
+        uint64_t bytes_received;    /*payload bytes of messages, twin documents and method requests received*/
+        uint64_t batches_sent;      /*batches of events put on the wire, by transports that batch them (AMQP)*/
+        uint64_t batch_bytes;       /*bytes of those batches; batch_bytes / batch_capacity is the batch fill ratio*/
+        uint64_t batch_capacity;    /*bytes those batches could have held*/
+        uint64_t messages_received; /*cloud-to-device and input messages handed to the message callbacks*/
+        size_t messages_awaiting_disposition;   /*messages taken by an asynchronous message callback and not yet settled with SendMessageDisposition*/
+        size_t methods_awaiting_response;       /*method requests taken by an inbound method callback and not yet answered*/
+        IOTHUB_CLIENT_LATENCY_HISTOGRAM enqueue_to_publish;
+        IOTHUB_CLIENT_LATENCY_HISTOGRAM publish_to_ack;
+        IOTHUB_CLIENT_LATENCY_HISTOGRAM twin_round_trip;    /*reported state sent to reported state acknowledged*/
+        IOTHUB_CLIENT_LATENCY_HISTOGRAM method_turnaround;  /*method request received to response sent, for IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC callbacks*/
+        IOTHUB_CLIENT_LATENCY_HISTOGRAM time_to_authenticated; /*device started authenticating to authenticated, by transports that authenticate each device on their own (AMQP)*/
+    } IOTHUB_CLIENT_STATISTICS;
+
+#define IOTHUB_CLIENT_SPAN_KIND_VALUES              \
+    IOTHUB_CLIENT_SPAN_EVENT_SEND,                  \
+    IOTHUB_CLIENT_SPAN_EVENT_QUEUE,                 \
+    IOTHUB_CLIENT_SPAN_EVENT_PUBLISH,               \
+    IOTHUB_CLIENT_SPAN_REPORTED_STATE,              \
+    IOTHUB_CLIENT_SPAN_REPORTED_STATE_PUBLISH,      \
+    IOTHUB_CLIENT_SPAN_METHOD_DISPATCH
+
+    /** @brief What a span measures. EVENT_SEND runs from SendEventAsync to the confirmation and has two children: EVENT_QUEUE until the transport first publishes the event and EVENT_PUBLISH from there to the confirmation.
+    *          REPORTED_STATE runs from SendReportedState to the acknowledgement, its child REPORTED_STATE_PUBLISH from the transport taking the reported state. METHOD_DISPATCH runs from a method request to the response of its synchronous callback. */
+    DEFINE_ENUM(IOTHUB_CLIENT_SPAN_KIND, IOTHUB_CLIENT_SPAN_KIND_VALUES);
+
+#define IOTHUB_CLIENT_TRACE_ID_SIZE 16
+#define IOTHUB_CLIENT_SPAN_ID_SIZE 8
+
+    /** @brief One finished span, as handed to an ::IOTHUB_CLIENT_SPAN_EXPORTER_CALLBACK. Only valid for the duration of the callback. */
+    typedef struct IOTHUB_CLIENT_SPAN_TAG
+    {
+        IOTHUB_CLIENT_SPAN_KIND kind;
+        unsigned char trace_id[IOTHUB_CLIENT_TRACE_ID_SIZE];
+        unsigned char span_id[IOTHUB_CLIENT_SPAN_ID_SIZE];
+        unsigned char parent_span_id[IOTHUB_CLIENT_SPAN_ID_SIZE]; /*all zero for a root span without a remote parent*/
+        uint64_t start_ms;      /*milliseconds on the client's monotonic clock, which starts when the client is created*/
+        uint64_t end_ms;
+        bool succeeded;
+        const char* name;       /*the method name for METHOD_DISPATCH, NULL otherwise*/
+    } IOTHUB_CLIENT_SPAN;
+
+    typedef void(*IOTHUB_CLIENT_SPAN_EXPORTER_CALLBACK)(const IOTHUB_CLIENT_SPAN* span, void* context);
+
+    /** @brief Value of OPTION_TRACE_EXPORTER. The exporter is called from DoWork (from the worker thread for the convenience layer) and should hand the span off quickly. */
+    typedef struct IOTHUB_CLIENT_TRACE_EXPORTER_TAG
+    {
+        IOTHUB_CLIENT_SPAN_EXPORTER_CALLBACK on_span_ended;
+        void* context;
+    } IOTHUB_CLIENT_TRACE_EXPORTER;
+
+    /** @brief Value of OPTION_TELEMETRY_AGGREGATION. The samples sent with IoTHubClient_SendTelemetrySample for @p output_name are folded into windows
+    *          of @p window_ms, and one event holding their count, min, max and mean is sent per window that received samples. */
+    typedef struct IOTHUB_CLIENT_TELEMETRY_AGGREGATION_TAG
+    {
+        const char* output_name;        /*NULL for the samples sent without an output name*/
+        uint64_t window_ms;             /*0 removes the aggregation of output_name, dropping the windows not sent yet*/
+        size_t max_pending_windows;     /*closed windows kept while they cannot be sent, the oldest one is dropped beyond; 0 keeps 1*/
+        bool forward_anomalies;         /*samples below anomaly_low or above anomaly_high are also sent right away, each in its own event*/
+        double anomaly_low;
+        double anomaly_high;
+    } IOTHUB_CLIENT_TELEMETRY_AGGREGATION;
+
+    /** @brief Value of OPTION_REPORT_BY_EXCEPTION. An event whose @p property_name holds a number within @p deadband of the one in the last event
+    *          sent is confirmed without being sent, unless @p heartbeat_ms have passed since then. */
+    typedef struct IOTHUB_CLIENT_REPORT_BY_EXCEPTION_TAG
+    {
+        const char* property_name;      /*application property of the event holding the value*/
+        double deadband;                /*negative removes the filter of property_name*/
+        uint64_t heartbeat_ms;          /*0 never forces a send*/
+    } IOTHUB_CLIENT_REPORT_BY_EXCEPTION;
+
+    /** @brief Value of OPTION_OUTPUT_ROUTE. IoTHubModuleClient_LL_SendEventToRoutesAsync sends one event to @p output_name for every message
+    *          whose application property @p property_name holds @p property_value. */
+    typedef struct IOTHUB_CLIENT_OUTPUT_ROUTE_TAG
+    {
+        const char* property_name;      /*NULL routes every message*/
+        const char* property_value;     /*NULL matches any value of property_name*/
+        const char* output_name;
+        bool remove;                    /*removes the route holding the same three strings instead of adding it*/
+    } IOTHUB_CLIENT_OUTPUT_ROUTE;
+
+    /** @brief Value of OPTION_SEND_WINDOW. Events and reported states are held and handed to the transport together once every @p period_ms,
+    *          or as soon as @p max_held events are held or an event holding @p urgent_property is sent. */
+    typedef struct IOTHUB_CLIENT_SEND_WINDOW_TAG
+    {
+        uint64_t period_ms;             /*0 hands everything to the transport as it comes*/
+        size_t max_held;                /*0 holds any number of events*/
+        const char* urgent_property;    /*application property marking the events sent at once, NULL if none are*/
+    } IOTHUB_CLIENT_SEND_WINDOW;
+
+#define IOTHUB_HUB_TIER_VALUES \
+    IOTHUB_HUB_TIER_NONE, \
+    IOTHUB_HUB_TIER_F1, \
+    IOTHUB_HUB_TIER_S1, \
+    IOTHUB_HUB_TIER_S2, \
+    IOTHUB_HUB_TIER_S3
+
+    /** @brief Tier of the hub whose throttling quotas OPTION_RATE_LIMITS shares among the devices.
+    */
+    DEFINE_ENUM(IOTHUB_HUB_TIER, IOTHUB_HUB_TIER_VALUES);
+
+    typedef struct IOTHUB_CLIENT_RATE_LIMIT_TAG
+    {
+        double per_second;              /*0 takes the device's share of the tier's quota, or does not limit without a tier*/
+        size_t burst;                   /*0 allows one second of per_second at once*/
+    } IOTHUB_CLIENT_RATE_LIMIT;
+
+    /** @brief Value of OPTION_RATE_LIMITS. Events, reported states and method responses are handed to the transport no faster than their rate,
+    *          after a burst of up to @p burst of them, so the device stays within its share of the quotas of a hub of @p tier with @p hub_units units. */
+    typedef struct IOTHUB_CLIENT_RATE_LIMITS_TAG
+    {
+        IOTHUB_HUB_TIER tier;           /*IOTHUB_HUB_TIER_NONE only limits the classes given a per_second*/
+        size_t hub_units;               /*0 counts as 1*/
+        size_t devices;                 /*devices sharing the quotas of the hub, 0 counts as 1*/
+        IOTHUB_CLIENT_RATE_LIMIT telemetry;
+        IOTHUB_CLIENT_RATE_LIMIT twin_updates;
+        IOTHUB_CLIENT_RATE_LIMIT method_responses;
+    } IOTHUB_CLIENT_RATE_LIMITS;
+
     typedef void(*IOTHUB_CLIENT_CONNECTION_STATUS_CALLBACK)(IOTHUB_CLIENT_CONNECTION_STATUS result, IOTHUB_CLIENT_CONNECTION_STATUS_REASON reason, void* userContextCallback);
     typedef IOTHUBMESSAGE_DISPOSITION_RESULT (*IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC)(IOTHUB_MESSAGE_HANDLE message, void* userContextCallback);
 
+    /** @brief Receives the payload of a cloud-to-device message in slices, @p offset bytes into a payload of @p totalSize bytes.
+    *          The slice is only valid for the duration of the call; the disposition returned for the last slice is the message's. */
+    typedef IOTHUBMESSAGE_DISPOSITION_RESULT (*IOTHUB_CLIENT_MESSAGE_CHUNK_CALLBACK)(const unsigned char* chunk, size_t size, size_t offset, size_t totalSize, void* userContextCallback);
+
+    /** @brief Receives every cloud-to-device message that arrived during one DoWork call, oldest first.
+    *          The messages stay owned by the client until they are settled with a batch disposition; the array is only valid for the duration of the call. */
+    typedef void(*IOTHUB_CLIENT_MESSAGE_BATCH_CALLBACK)(IOTHUB_MESSAGE_HANDLE* messages, size_t messageCount, void* userContextCallback);
+
     typedef void(*IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK)(DEVICE_TWIN_UPDATE_STATE update_state, const unsigned char* payLoad, size_t size, void* userContextCallback);
+
+    /** @brief Receives a property of a twin update found at the path of a desired property subscription.
+    *          @p path is the path of the property, wildcards replaced by member names, and @p value its JSON, NUL terminated; both are only valid for the duration of the call. */
+    typedef void(*IOTHUB_CLIENT_DESIRED_PROPERTY_CALLBACK)(DEVICE_TWIN_UPDATE_STATE update_state, const char* path, const unsigned char* value, size_t size, void* userContextCallback);
     typedef void(*IOTHUB_CLIENT_REPORTED_STATE_CALLBACK)(int status_code, void* userContextCallback);
     typedef int(*IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC)(const char* method_name, const unsigned char* payload, size_t size, unsigned char** response, size_t* response_size, void* userContextCallback);
     typedef int(*IOTHUB_CLIENT_INBOUND_DEVICE_METHOD_CALLBACK)(const char* method_name, const unsigned char* payload, size_t size, METHOD_HANDLE method_id, void* userContextCallback);
@@ -83,6 +83,23 @@ typedef struct IOTHUB_CLIENT_CORE_LL_HANDLE_DATA_TAG* IOTHUB_CLIENT_LL_HANDLE;
     */
      MOCKABLE_FUNCTION(, IOTHUB_CLIENT_LL_HANDLE, IoTHubClient_LL_CreateWithTransport, const IOTHUB_CLIENT_DEVICE_CONFIG*, config);
 
+    /**
+    * @brief    Creates the IoT Hub clients of many devices sharing one existing
+    *             transport, as a gateway does at startup.
+    *
+    * @param    configs    Array of @p count @c IOTHUB_CLIENT_DEVICE_CONFIG structures,
+    *                      all with the same @c transportHandle and @c protocol
+    * @param    count      Number of elements in @p configs and @p handles
+    * @param    handles    Array of @p count handles that receives the clients
+    *
+    *            The IoT Hub name of the transport and the product info are
+    *            worked out once for the whole batch. Either all the clients are
+    *            created or none is. This is a blocking call.
+    *
+    * @return    IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_CreateBatchWithTransport, const IOTHUB_CLIENT_DEVICE_CONFIG*, configs, size_t, count, IOTHUB_CLIENT_LL_HANDLE*, handles);
+
      /**
      * @brief    Creates a IoT Hub client for communication with an existing IoT
      *             Hub using the device auth module.
@@ -127,6 +144,67 @@ typedef struct IOTHUB_CLIENT_CORE_LL_HANDLE_DATA_TAG* IOTHUB_CLIENT_LL_HANDLE;
     */
      MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_SendEventAsync, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, IOTHUB_MESSAGE_HANDLE, eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, eventConfirmationCallback, void*, userContextCallback);
 
+    /**
+    * @brief    Asynchronous call to send the message specified by @p eventMessageHandle
+    *           without copying it. On success the client takes ownership of the message
+    *           and destroys it once it has been confirmed; the caller must not use
+    *           @p eventMessageHandle afterwards. On failure the caller still owns it.
+    *
+    * @param    iotHubClientHandle            The handle created by a call to the create function.
+    * @param    eventMessageHandle            The handle to an IoT Hub message.
+    * @param    eventConfirmationCallback     The callback receiving confirmation of the delivery
+    *                                         of the IoT Hub message. The user can specify a @c NULL
+    *                                         value here to indicate that no callback is required.
+    * @param    userContextCallback           User specified context that will be provided to the
+    *                                         callback. This can be @c NULL.
+    *
+    *            @b NOTE: The application behavior is undefined if the user calls
+    *            the ::IoTHubClient_LL_Destroy function from within any callback.
+    *
+    * @return    IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_SendEventAsync_TakeOwnership, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, IOTHUB_MESSAGE_HANDLE, eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, eventConfirmationCallback, void*, userContextCallback);
+
+    /**
+    * @brief    Asynchronous call to send a small event without properties, copied into one of
+    *           the slots set by OPTION_SMALL_EVENT_SLOTS and sent from there without copying or
+    *           cloning a message. The slot is free again once the event is confirmed.
+    *
+    * @param    iotHubClientHandle            The handle created by a call to the create function.
+    * @param    payload                       The payload of the event, copied before the call returns.
+    * @param    size                          The size of @p payload, at most IOTHUB_CLIENT_SMALL_EVENT_MAX_SIZE.
+    * @param    eventConfirmationCallback     The callback receiving confirmation of the delivery
+    *                                         of the event. The user can specify a @c NULL
+    *                                         value here to indicate that no callback is required.
+    * @param    userContextCallback           User specified context that will be provided to the
+    *                                         callback. This can be @c NULL.
+    *
+    * @return    IOTHUB_CLIENT_OK upon success or an error code upon failure, IOTHUB_CLIENT_ERROR
+    *            while every slot is in flight or if OPTION_SMALL_EVENT_SLOTS is not set.
+    */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_SendSmallEvent, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, const unsigned char*, payload, size_t, size, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, eventConfirmationCallback, void*, userContextCallback);
+
+    /**
+    * @brief    Sets a callback that receives, once per DoWork, the confirmations of all
+    *           events that were sent without their own confirmation callback.
+    *
+    * @param    iotHubClientHandle               The handle created by a call to the create function.
+    * @param    eventConfirmationBatchCallback   The callback receiving an array of (userContextCallback,
+    *                                            result) pairs, in completion order. The array is only
+    *                                            valid for the duration of the call. Pass @c NULL to stop
+    *                                            batching.
+    * @param    userContextCallback              User specified context that will be provided to the
+    *                                            callback. This can be @c NULL.
+    *
+    *            While a batch callback is set, ::IoTHubClient_LL_SendEventAsync may be called with a
+    *            @c NULL eventConfirmationCallback and a non-NULL userContextCallback; that context is
+    *            what the batch reports for the message. Events sent with their own callback keep
+    *            receiving it individually. Not supported when the transport is shared.
+    *
+    * @return    IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_SetEventConfirmationBatchCallback, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_BATCH_CALLBACK, eventConfirmationBatchCallback, void*, userContextCallback);
+
     /**
     * @brief    This function returns the current sending status for IoTHubClient.
     *
@@ -141,6 +219,19 @@ typedef struct IOTHUB_CLIENT_CORE_LL_HANDLE_DATA_TAG* IOTHUB_CLIENT_LL_HANDLE;
     */
      MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_GetSendStatus, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_STATUS*, iotHubClientStatus);
 
+    /**
+    * @brief    This function returns the counters and latency histograms of the send path.
+    *           They are only collected once OPTION_ENABLE_STATISTICS has been set to true;
+    *           the number of events waiting to be sent is always filled in.
+    *
+    * @param    iotHubClientHandle        The handle created by a call to the create function.
+    * @param    statistics                The statistics are copied to the address pointed
+    *                                     at by this parameter.
+    *
+    * @return    IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_GetStatistics, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_STATISTICS*, statistics);
+
     /**
     * @brief    Sets up the message callback to be invoked when IoT Hub issues a
     *             message to the device. This is a blocking call.
@@ -158,6 +249,63 @@ typedef struct IOTHUB_CLIENT_CORE_LL_HANDLE_DATA_TAG* IOTHUB_CLIENT_LL_HANDLE;
     */
      MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_SetMessageCallback, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC, messageCallback, void*, userContextCallback);
 
+    /**
+    * @brief    Sets up a callback that receives the payload of each message IoT Hub issues to the
+    *           device in slices, without the payload being copied into an IOTHUB_MESSAGE_HANDLE.
+    *           This is a blocking call.
+    *
+    * @param    iotHubClientHandle              The handle created by a call to the create function.
+    * @param    messageChunkCallback            The callback receiving the slices of each payload, in
+    *                                           order; a slice is only valid for the duration of the
+    *                                           call. Pass @c NULL to stop receiving messages.
+    * @param    userContextCallback             User specified context that will be provided to the
+    *                                           callback. This can be @c NULL.
+    *
+    *           Message properties are not delivered. Transports that do not stream payloads hand
+    *           each one over as a single slice. Cannot be used together with
+    *           ::IoTHubClient_LL_SetMessageCallback.
+    *
+    * @return   IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_SetMessageChunkCallback, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_MESSAGE_CHUNK_CALLBACK, messageChunkCallback, void*, userContextCallback);
+
+    /**
+    * @brief    Sets up a callback that receives, at the end of each call to ::IoTHubClient_LL_DoWork,
+    *           all the messages IoT Hub issued to the device during that call in one array.
+    *           This is a blocking call.
+    *
+    * @param    iotHubClientHandle              The handle created by a call to the create function.
+    * @param    messageBatchCallback            The callback receiving the messages; the array is
+    *                                           only valid for the duration of the call. Pass
+    *                                           @c NULL to stop receiving messages.
+    * @param    userContextCallback             User specified context that will be provided to the
+    *                                           callback. This can be @c NULL.
+    *
+    *           The messages stay owned by the client until they are settled with
+    *           ::IoTHubClient_LL_SendMessageDispositionBatch. Cannot be used together with
+    *           ::IoTHubClient_LL_SetMessageCallback or ::IoTHubClient_LL_SetMessageChunkCallback.
+    *
+    * @return   IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_SetMessageBatchCallback, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_MESSAGE_BATCH_CALLBACK, messageBatchCallback, void*, userContextCallback);
+
+    /**
+    * @brief    Settles messages handed to the batch callback with the same disposition.
+    *
+    * @param    iotHubClientHandle              The handle created by a call to the create function.
+    * @param    messages                        The messages to settle, as handed to the batch
+    *                                           callback; they are destroyed by the call.
+    * @param    messageCount                    The number of messages in @p messages.
+    * @param    disposition                     The disposition sent for every message.
+    *
+    *           Settling the messages in the order they were received costs a single pass over
+    *           the messages waiting for their disposition.
+    *
+    * @return   IOTHUB_CLIENT_OK upon success or an error code upon failure; the messages that
+    *           could be settled are settled even if the call fails.
+    */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_SendMessageDispositionBatch, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, IOTHUB_MESSAGE_HANDLE*, messages, size_t, messageCount, IOTHUBMESSAGE_DISPOSITION_RESULT, disposition);
+
     /**
     * @brief    Sets up the connection status callback to be invoked representing the status of
     * the connection to IOT Hub. This is a blocking call.
@@ -299,6 +447,26 @@ typedef struct IOTHUB_CLIENT_CORE_LL_HANDLE_DATA_TAG* IOTHUB_CLIENT_LL_HANDLE;
     */
      MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_SetDeviceTwinCallback, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK, deviceTwinCallback, void*, userContextCallback);
 
+    /**
+    * @brief    This API specifies a callback to be used when a desired state update holds the properties at a path.
+    *
+    * @param    iotHubClientHandle        The handle created by a call to the create function.
+    * @param    path                      The dot separated path of the properties from the root of the twin,
+    *                                     for instance "desired.motors.left". A "*" segment matches every member
+    *                                     whose name does not start with '$', for instance "desired.motors.*".
+    * @param    desiredPropertyCallback   The callback called, with the path and the JSON value of the property,
+    *                                     for every property at path held by a desired state update. Each update
+    *                                     is parsed once for all the paths. @c NULL removes the callback of path.
+    * @param    userContextCallback       User specified context that will be provided to the
+    *                                     callback. This can be @c NULL.
+    *
+    *            @b NOTE: The application behavior is undefined if the user calls
+    *            the ::IoTHubClient_LL_Destroy function from within any callback.
+    *
+    * @return    IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_SetDesiredPropertyCallback, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, const char*, path, IOTHUB_CLIENT_DESIRED_PROPERTY_CALLBACK, desiredPropertyCallback, void*, userContextCallback);
+
     /**
     * @brief    This API sneds a report of the device's properties and their current values.
     *
@@ -328,6 +496,22 @@ typedef struct IOTHUB_CLIENT_CORE_LL_HANDLE_DATA_TAG* IOTHUB_CLIENT_LL_HANDLE;
      */
      MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_SetDeviceMethodCallback, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC, deviceMethodCallback, void*, userContextCallback);
 
+     /**
+     * @brief    This API sets the callback for the cloud to device method called @p methodName.
+     *           Handlers are looked up by method name before the callback set by
+     *           the method callback API, which keeps receiving every other method.
+     *
+     * @param    iotHubClientHandle        The handle created by a call to the create function.
+     * @param    methodName                The name of the method handled by the callback.
+     * @param    methodCallback            The callback which will be called by IoTHub, or @c NULL
+     *                                     to remove the handler of @p methodName.
+     * @param    userContextCallback       User specified context that will be provided to the
+     *                                     callback. This can be @c NULL.
+     *
+     * @return    IOTHUB_CLIENT_OK upon success or an error code upon failure.
+     */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_SetDeviceMethodHandler, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, const char*, methodName, IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC, methodCallback, void*, userContextCallback);
+
      /**
      * @brief    This API sets callback for async cloud to device method call.
      *
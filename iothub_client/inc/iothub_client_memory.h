@@ -0,0 +1,66 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file iothub_client_memory.h
+*    @brief Heap held by the clients of the process, by subsystem.
+*
+*    @details Between IoTHub_Init and IoTHub_Deinit every client and transport
+*             of the process counts the bytes it holds for each subsystem,
+*             and the most it held at once, in counters of its own. Use it to
+*             size the heap of a device and to spot a subsystem that keeps
+*             growing.
+*/
+
+#ifndef IOTHUB_CLIENT_MEMORY_H
+#define IOTHUB_CLIENT_MEMORY_H
+
+#include <stddef.h>
+#include "azure_c_shared_utility/macro_utils.h"
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /* IOTHUB_CLIENT_MEMORY_OPTIONS stays the last tag */
+#define IOTHUB_CLIENT_MEMORY_TAG_VALUES       \
+    IOTHUB_CLIENT_MEMORY_MESSAGE_QUEUE,       \
+    IOTHUB_CLIENT_MEMORY_TRANSPORT,           \
+    IOTHUB_CLIENT_MEMORY_TWIN,                \
+    IOTHUB_CLIENT_MEMORY_OPTIONS
+
+    /** @brief  What the bytes are held for:
+    *           - MESSAGE_QUEUE: the events given to SendEventAsync and not yet confirmed, with their payload.
+    *           - TRANSPORT: what the transports keep for them while they are on the wire.
+    *           - TWIN: the reported states not yet acknowledged, with their payload.
+    *           - OPTIONS: the trusted certificates set with OPTION_TRUSTED_CERT or read from an Edge certificate file.
+    */
+    DEFINE_ENUM(IOTHUB_CLIENT_MEMORY_TAG, IOTHUB_CLIENT_MEMORY_TAG_VALUES);
+
+    typedef struct IOTHUB_CLIENT_MEMORY_USAGE_TAG
+    {
+        size_t current_bytes;
+        size_t peak_bytes;      /*sum of the peaks of the clients alive, each since it was created or the last IoTHubClient_Memory_ResetPeaks*/
+    } IOTHUB_CLIENT_MEMORY_USAGE;
+
+    /**
+    * @brief    Gets the bytes held for @p tag, summed over the clients that
+    *           are alive. A destroyed client no longer counts.
+    *
+    * @return   0 on success, non-zero if @p usage is NULL, @p tag is not a
+    *           tag or IoTHub_Init has not been called.
+    */
+    MOCKABLE_FUNCTION(, int, IoTHubClient_Memory_GetUsage, IOTHUB_CLIENT_MEMORY_TAG, tag, IOTHUB_CLIENT_MEMORY_USAGE*, usage);
+
+    /**
+    * @brief    Brings the peak of every tag down to what it currently holds,
+    *           so the peak of the next phase of the application can be read.
+    */
+    MOCKABLE_FUNCTION(, void, IoTHubClient_Memory_ResetPeaks);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_MEMORY_H */
@@ -33,11 +33,27 @@ extern "C"
     static STATIC_VAR_UNUSED const char* OPTION_CBS_REQUEST_TIMEOUT = "cbs_request_timeout";
 
     static STATIC_VAR_UNUSED const char* OPTION_MIN_POLLING_TIME = "MinimumPollingTime";
+    /* HTTP only (unsigned int seconds): when greater than MinimumPollingTime, empty C2D polls back off exponentially up to this value and a received message is followed by an immediate poll */
+    static STATIC_VAR_UNUSED const char* OPTION_MAX_POLLING_TIME = "MaximumPollingTime";
     static STATIC_VAR_UNUSED const char* OPTION_BATCHING = "Batching";
+    /* Maximum number of registered devices (size_t) an HTTP transport DoWork serves, rotating across calls; 0 (default) serves all of them. Devices served on the shared connection run one synchronous request after another, so this bounds how long one DoWork takes; OPTION_HTTP_DEVICE_WORKERS serves devices concurrently */
+    static STATIC_VAR_UNUSED const char* OPTION_HTTP_DEVICES_PER_DO_WORK = "http_devices_per_do_work";
+    /* Number of devices (size_t) an HTTP transport DoWork serves at a time, each on its own connection, set before the options of the connection; 0 or 1 (default) serves one at a time */
+    static STATIC_VAR_UNUSED const char* OPTION_HTTP_DEVICE_WORKERS = "http_device_workers";
+    /* Maximum number of C2D GET requests (size_t) an HTTP transport DoWork makes for a device while each one returns a message, without waiting for the polling time in between; 1 (default) makes one */
+    static STATIC_VAR_UNUSED const char* OPTION_HTTP_MESSAGES_PER_POLL = "http_messages_per_poll";
 
     /* DEPRECATED:: OPTION_MESSAGE_TIMEOUT is DEPRECATED! Use OPTION_SERVICE_SIDE_KEEP_ALIVE_FREQ_SECS for AMQP; MQTT has no option available. OPTION_MESSAGE_TIMEOUT legacy variable will be kept for back-compat.  */
     static STATIC_VAR_UNUSED const char* OPTION_MESSAGE_TIMEOUT = "messageTimeout";
     static STATIC_VAR_UNUSED const char* OPTION_BLOB_UPLOAD_TIMEOUT_SECS = "blob_upload_timeout_secs";
+    /* bool, file uploads (IoTHubDeviceClient_LL_UploadFileToBlob) keep a "<file>.upload" manifest of the blocks storage acknowledged, so that uploading the same file to the same blob again resumes after them. Off by default */
+    static STATIC_VAR_UNUSED const char* OPTION_BLOB_UPLOAD_RESUMABLE = "blob_upload_resumable";
+    /* bool, file uploads (IoTHubDeviceClient_LL_UploadFileToBlob) upload the gzip stream of the file instead of the file. Needs the SDK built with use_payload_compression. Off by default */
+    static STATIC_VAR_UNUSED const char* OPTION_BLOB_UPLOAD_GZIP = "blob_upload_gzip";
+    /* size_t, seconds an upload to blob keeps its HTTPS connections to the IoT hub and to storage open for the next upload. 0 (the default) closes them after every upload */
+    static STATIC_VAR_UNUSED const char* OPTION_BLOB_UPLOAD_KEEP_ALIVE_SECS = "blob_upload_keep_alive_secs";
+    /* size_t, blocks an upload to blob PUTs at the same time, each on its own HTTPS connection to storage. The IoTHubDeviceClient_LL_UploadMultipleBlocksToBlobEx callback is still called one call at a time and in block order, but possibly from the upload threads. Resumable file uploads (OPTION_BLOB_UPLOAD_RESUMABLE) still PUT one block at a time. 0 or 1 (the default) PUT one block at a time, values above BLOB_UPLOAD_MAX_PARALLELISM (8 unless the SDK is built with another value) are taken as it */
+    static STATIC_VAR_UNUSED const char* OPTION_BLOB_UPLOAD_PARALLELISM = "blob_upload_parallelism";
     static STATIC_VAR_UNUSED const char* OPTION_PRODUCT_INFO = "product_info";
 
     /*
@@ -78,6 +94,123 @@ extern "C"
 
     static STATIC_VAR_UNUSED const char* OPTION_DO_WORK_FREQUENCY_IN_MS = "do_work_freq_ms";
 
+    // unsigned int, upper bound in ms the convenience layer worker thread blocks while idle, or a client on OPTION_WORKER_POOL waits before its next run; 0 (default) keeps fixed-frequency polling
+    static STATIC_VAR_UNUSED const char* OPTION_DO_WORK_MAX_IDLE_MS = "do_work_max_idle_ms";
+
+    // IOTHUB_CLIENT_WORKER_POOL_HANDLE, runs the convenience layer worker on a shared pool instead of a dedicated thread
+    static STATIC_VAR_UNUSED const char* OPTION_WORKER_POOL = "worker_pool";
+
+    // size_t, number of events SendEventAsync can queue without taking the client lock; 0 (default) disables the queue
+    static STATIC_VAR_UNUSED const char* OPTION_SUBMISSION_QUEUE_SIZE = "submission_queue_size";
+
+    // bool, when true user callbacks run on a dedicated thread instead of the DoWork thread
+    static STATIC_VAR_UNUSED const char* OPTION_CALLBACK_DISPATCH_THREAD = "callback_dispatch_thread";
+
+    // size_t, maximum number of threads running UploadToBlobAsync, UploadMultipleBlocksToBlobAsync and GenericMethodInvoke requests, which then wait in a shared queue; 0 (default) spawns one thread per request
+    static STATIC_VAR_UNUSED const char* OPTION_HTTP_WORKER_THREADS = "http_worker_threads";
+
+    // size_t, number of per-event records each client pre-allocates and then recycles instead of calling malloc/free; 0 (default) disables pooling
+    static STATIC_VAR_UNUSED const char* OPTION_EVENT_POOL_SIZE = "event_pool_size";
+
+    // size_t, number of IOTHUB_CLIENT_SMALL_EVENT_MAX_SIZE payload slots allocated at once for IoTHubClient_LL_SendSmallEvent, which fails while they are all in flight; 0 (default) frees them. Cannot be changed while small events are in flight
+    static STATIC_VAR_UNUSED const char* OPTION_SMALL_EVENT_SLOTS = "small_event_slots";
+
+    // bool, collects the counters and latency histograms returned by IoTHubClient_GetStatistics; false (default) skips all bookkeeping
+    static STATIC_VAR_UNUSED const char* OPTION_ENABLE_STATISTICS = "enable_statistics";
+
+    // const IOTHUB_CLIENT_TRACE_EXPORTER*, receives a span for every event, reported state and synchronous method call, and events carry a W3C "traceparent" application property; an exporter whose on_span_ended is NULL turns tracing off again. Off by default
+    static STATIC_VAR_UNUSED const char* OPTION_TRACE_EXPORTER = "trace_exporter";
+
+    // size_t, payload bytes allowed for the events queued or in flight; IoTHubClient_SendEventAsync fails with IOTHUB_CLIENT_ERROR above it. 0 (default) is unbounded
+    static STATIC_VAR_UNUSED const char* OPTION_MAX_PENDING_BYTES = "max_pending_bytes";
+
+    // const char*, existing directory where events are spilled to disk once OPTION_SPILL_THRESHOLD are waiting to be sent; they are sent, in order, as the transport catches up, also by a later process. Off by default, "" turns it off again
+    static STATIC_VAR_UNUSED const char* OPTION_SPILL_DIRECTORY = "spill_directory";
+
+    // size_t, number of events kept in memory waiting to be sent before new ones are spilled to OPTION_SPILL_DIRECTORY, 100 by default
+    static STATIC_VAR_UNUSED const char* OPTION_SPILL_THRESHOLD = "spill_threshold";
+
+    // const IOTHUB_CLIENT_TELEMETRY_AGGREGATION*, aggregates the samples sent with IoTHubClient_SendTelemetrySample for one output name into one min/max/mean/count event per window; set once per output name. Off by default
+    static STATIC_VAR_UNUSED const char* OPTION_TELEMETRY_AGGREGATION = "telemetry_aggregation";
+
+    // const IOTHUB_CLIENT_REPORT_BY_EXCEPTION*, events whose numeric application property has not moved beyond a deadband since the last event sent, and whose heartbeat is not due, are confirmed without being sent; set once per property name. Off by default
+    static STATIC_VAR_UNUSED const char* OPTION_REPORT_BY_EXCEPTION = "report_by_exception";
+
+    // const IOTHUB_CLIENT_OUTPUT_ROUTE*, adds a route of IoTHubModuleClient_LL_SendEventToRoutesAsync, which sends one event per output whose route matches the application properties of the message, all sharing its payload; set once per route. No routes by default
+    static STATIC_VAR_UNUSED const char* OPTION_OUTPUT_ROUTE = "output_route";
+
+    // const IOTHUB_CLIENT_SEND_WINDOW*, holds events and reported states so the radio wakes up once per window to send them together, and aligns the transport's keep alive with the window. Off by default
+    static STATIC_VAR_UNUSED const char* OPTION_SEND_WINDOW = "send_window";
+
+    // const IOTHUB_CLIENT_RATE_LIMITS*, token buckets refilled at the device's share of the hub's quotas hold back events, reported states and method responses beyond it, to avoid throttling disconnects. Off by default
+    static STATIC_VAR_UNUSED const char* OPTION_RATE_LIMITS = "rate_limits";
+
+    // const char*, file the twin is kept in, so twin updates holding no desired $version newer than the last one given to the device twin callback are dropped, and the callback starts from the last twin while the client connects. Off by default, "" turns it off again
+    static STATIC_VAR_UNUSED const char* OPTION_TWIN_CACHE_FILE = "twin_cache_file";
+
+    // tickcounter_ms_t, reported states sent within this many ms of the oldest one still queued are merged into a single patch, and each callback gets the status of that patch; 0 (default) sends each on its own
+    static STATIC_VAR_UNUSED const char* OPTION_TWIN_COALESCE_WINDOW = "twin_coalesce_window";
+
+    // bool, while the client is not connected every reported state is merged into the newest one still queued, newer values replacing older ones key by key, so a single patch is sent once the client connects again; false (default) replays each of them
+    static STATIC_VAR_UNUSED const char* OPTION_TWIN_COALESCE_OFFLINE = "twin_coalesce_offline";
+
+    // bool, MQTT and AMQP: each TLS I/O the transport creates is asked to resume the TLS session of the previous one (ticket or session id), which travels with the TLS options the transport saves before a reconnect; false (default) runs a full handshake every time. TLS adapters without session resumption ignore it
+    static STATIC_VAR_UNUSED const char* OPTION_TLS_SESSION_RESUMPTION = "tls_session_resumption";
+
+    // size_t, MQTT and AMQP over WebSockets: most bytes of the protocol writes made between two DoWork calls sent together in one WebSocket frame, 16370 by default so a frame fits a 16KB TLS record; 0 sends each write in a frame of its own. Writes at least this long are sent on their own
+    static STATIC_VAR_UNUSED const char* OPTION_WS_COALESCED_FRAME_SIZE = "ws_coalesced_frame_size";
+
+    // size_t, MQTT over TLS: most bytes of the MQTT packets written between two DoWork calls given to the TLS IO in one send, so they share TLS records and syscalls; 16370 by default, 0 sends each packet on its own. Packets at least this long are sent on their own
+    static STATIC_VAR_UNUSED const char* OPTION_TLS_COALESCED_RECORD_SIZE = "tls_coalesced_record_size";
+
+    // size_t, MQTT only: telemetry messages published and waiting for their PUBACK before the next ones are held back; 0 (default) is unbounded
+    static STATIC_VAR_UNUSED const char* OPTION_MQTT_MAX_INFLIGHT = "mqtt_max_inflight";
+
+    // bool, MQTT only: resume the session the broker kept across reconnects, skipping the re-subscribe and resending unacknowledged telemetry with its packet ids; false (default) sets the session up again
+    static STATIC_VAR_UNUSED const char* OPTION_MQTT_PERSISTENT_SESSION = "mqtt_persistent_session";
+
+    // tickcounter_ms_t, MQTT only: topics requested within this many ms of the first one still waiting to be subscribed go in a single SUBSCRIBE, so features enabled one call at a time take one round trip; 0 (default) subscribes on the next DoWork
+    static STATIC_VAR_UNUSED const char* OPTION_MQTT_SUBSCRIBE_COALESCE_WINDOW = "mqtt_subscribe_coalesce_window";
+
+    // const char*, MQTT only: telemetry sent to this output ("" for the messages sent without an output name) is published at QoS 0, its confirmation callback called with IOTHUB_CLIENT_CONFIRMATION_OK once it is handed to the connection; it may be lost and is never resent. Unset (default) publishes all telemetry at least once
+    static STATIC_VAR_UNUSED const char* OPTION_MQTT_AT_MOST_ONCE_OUTPUT = "mqtt_at_most_once_output";
+
+    // int, MQTT only: longest keepalive, in seconds, the transport tries from OPTION_KEEP_ALIVE on: each connect after one that lasted 3 keepalives tries a longer one, and one that drops silently sends it back to the last that held, for as long as the transport lives; 0 (default) keeps OPTION_KEEP_ALIVE
+    static STATIC_VAR_UNUSED const char* OPTION_MQTT_ADAPTIVE_KEEP_ALIVE_MAX = "mqtt_adaptive_keep_alive_max";
+
+    // size_t, AMQP only: ms telemetry waits for more events to share its batch before it is sent, unless OPTION_AMQP_BATCH_MAX_MESSAGES are already waiting; 0 (default) sends on the next DoWork
+    static STATIC_VAR_UNUSED const char* OPTION_AMQP_BATCH_LINGER_MS = "amqp_batch_linger_ms";
+
+    // size_t, AMQP only: most events put in a single batch, which is also sent as soon as that many are waiting; 0 (default) fills batches up to the link's max message size
+    static STATIC_VAR_UNUSED const char* OPTION_AMQP_BATCH_MAX_MESSAGES = "amqp_batch_max_messages";
+
+    // size_t, AMQP only: most devices of a multiplexed connection putting their SAS token to CBS at the same time; the others start once one of them is done. 0 (default) is unbounded
+    static STATIC_VAR_UNUSED const char* OPTION_AMQP_CBS_AUTH_WINDOW = "amqp_cbs_auth_window";
+
+    // size_t, AMQP only: link credit the C2D message receiver grants the service, replenished by uAMQP once it is used up; 0 (default) keeps uAMQP's default. Applies to the next receiver link attached
+    static STATIC_VAR_UNUSED const char* OPTION_C2D_LINK_CREDIT = "c2d_link_credit";
+
+    // size_t, AMQP only: link credit the method requests receiver grants the service, replenished the same way; 0 (default) keeps uAMQP's default. Applies to the next subscription to methods
+    static STATIC_VAR_UNUSED const char* OPTION_METHODS_LINK_CREDIT = "methods_link_credit";
+
+    // size_t, AMQP only: the twin links are attached on the first twin operation rather than when the device starts, and detached after this many seconds without a twin subscription or pending twin operation; 0 (default) attaches them at start. Applies from the next connection
+    static STATIC_VAR_UNUSED const char* OPTION_TWIN_LINK_IDLE_TIMEOUT_SECS = "twin_link_idle_timeout_secs";
+
+    // size_t, AMQP only: seconds a registered device can go without sending before it is stopped, releasing its links and SAS token renewal until it has events to send or a twin or subscription request; devices subscribed to messages, methods or twin updates are never stopped. 0 (default) keeps every device started
+    static STATIC_VAR_UNUSED const char* OPTION_AMQP_DEVICE_IDLE_SUSPEND_SECS = "amqp_device_idle_suspend_secs";
+
+    // size_t, AMQP only: sessions of a multiplexed connection the links of the devices are spread over by device id, so the flow control of one session does not hold up the devices on the others; 0 (default) and 1 use a single session. Applies from the next connection
+    static STATIC_VAR_UNUSED const char* OPTION_AMQP_SESSION_COUNT = "amqp_session_count";
+
+    // size_t: method requests taken by an inbound method callback and not answered yet; further ones are answered with status 429 until some are. 0 (default) is unbounded. Set it before subscribing to methods, only the requests taken from then on can be answered
+    static STATIC_VAR_UNUSED const char* OPTION_METHOD_MAX_IN_FLIGHT = "method_max_in_flight";
+
+    // size_t: seconds a method request taken by an inbound method callback waits for IoTHubClient_DeviceMethodResponse before it is answered with status 504 and its late response rejected; 0 (default) waits forever. Set it before subscribing to methods, the same way
+    static STATIC_VAR_UNUSED const char* OPTION_METHOD_RESPONSE_TIMEOUT_SECS = "method_response_timeout_secs";
+
+    // size_t, convenience layer only: threads running the device method callbacks and the method handlers registered without threads of their own, so a slow method does not hold up the other methods and callbacks; 0 (default) runs them on the callback thread. Can only be set once
+    static STATIC_VAR_UNUSED const char* OPTION_METHOD_WORKER_THREADS = "method_worker_threads";
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,105 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file iothub_client_startup_timeline.h
+*    @brief When the clients of the process first reached each step of their start.
+*
+*    @details Once started, the clients and transports of the process note
+*             the first time they create a client, open a connection,
+*             authenticate, subscribe, get the twin and get their first event
+*             confirmed, in milliseconds of a monotonic clock since
+*             IoTHubClient_StartupTimeline_Start. Start it first thing in the
+*             process to see where the time to the first confirmed event of
+*             a device that wakes, sends and sleeps goes.
+*/
+
+#ifndef IOTHUB_CLIENT_STARTUP_TIMELINE_H
+#define IOTHUB_CLIENT_STARTUP_TIMELINE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "azure_c_shared_utility/macro_utils.h"
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /* IOTHUB_CLIENT_STARTUP_FIRST_EVENT_CONFIRMED stays the last milestone */
+#define IOTHUB_CLIENT_STARTUP_MILESTONE_VALUES            \
+    IOTHUB_CLIENT_STARTUP_CLIENT_CREATE_STARTED,          \
+    IOTHUB_CLIENT_STARTUP_CLIENT_CREATED,                 \
+    IOTHUB_CLIENT_STARTUP_CONNECT_STARTED,                \
+    IOTHUB_CLIENT_STARTUP_AUTHENTICATION_STARTED,         \
+    IOTHUB_CLIENT_STARTUP_AUTHENTICATED,                  \
+    IOTHUB_CLIENT_STARTUP_SUBSCRIBE_SENT,                 \
+    IOTHUB_CLIENT_STARTUP_SUBSCRIBED,                     \
+    IOTHUB_CLIENT_STARTUP_TWIN_REQUESTED,                 \
+    IOTHUB_CLIENT_STARTUP_TWIN_RECEIVED,                  \
+    IOTHUB_CLIENT_STARTUP_FIRST_EVENT_QUEUED,             \
+    IOTHUB_CLIENT_STARTUP_FIRST_EVENT_PUBLISHED,          \
+    IOTHUB_CLIENT_STARTUP_FIRST_EVENT_CONFIRMED
+
+    /** @brief  The steps of the start of a client:
+    *           - CLIENT_CREATE_STARTED, CLIENT_CREATED: an IoTHubClientCore_LL_Create* function started and succeeded.
+    *           - CONNECT_STARTED: the transport started opening its connection; what follows, up to
+    *             AUTHENTICATED, includes the name resolution, TCP connect and TLS handshake of the IO layer.
+    *           - AUTHENTICATION_STARTED: AMQP started its CBS authentication.
+    *           - AUTHENTICATED: the client reported IOTHUB_CLIENT_CONNECTION_AUTHENTICATED (CONNACK on MQTT).
+    *           - SUBSCRIBE_SENT, SUBSCRIBED: MQTT sent a SUBSCRIBE and got its SUBACK.
+    *           - TWIN_REQUESTED, TWIN_RECEIVED: the full twin was asked for and delivered to the client.
+    *           - FIRST_EVENT_QUEUED, FIRST_EVENT_PUBLISHED, FIRST_EVENT_CONFIRMED: an event was given to
+    *             SendEventAsync, sent by the transport and confirmed by the hub.
+    */
+    DEFINE_ENUM(IOTHUB_CLIENT_STARTUP_MILESTONE, IOTHUB_CLIENT_STARTUP_MILESTONE_VALUES);
+
+#define IOTHUB_CLIENT_STARTUP_MILESTONE_COUNT ((size_t)IOTHUB_CLIENT_STARTUP_FIRST_EVENT_CONFIRMED + 1)
+
+    typedef struct IOTHUB_CLIENT_STARTUP_MARK_TAG
+    {
+        bool reached;
+        uint32_t ms;        /*milliseconds since IoTHubClient_StartupTimeline_Start*/
+    } IOTHUB_CLIENT_STARTUP_MARK;
+
+    typedef struct IOTHUB_CLIENT_STARTUP_TIMELINE_TAG
+    {
+        IOTHUB_CLIENT_STARTUP_MARK marks[IOTHUB_CLIENT_STARTUP_MILESTONE_COUNT];  /*indexed by IOTHUB_CLIENT_STARTUP_MILESTONE*/
+    } IOTHUB_CLIENT_STARTUP_TIMELINE;
+
+    /**
+    * @brief    Starts noting the milestones, from 0 ms now.
+    *
+    * @return   0 on success, non-zero if the timeline is already started or
+    *           its lock or clock cannot be created.
+    */
+    MOCKABLE_FUNCTION(, int, IoTHubClient_StartupTimeline_Start);
+
+    /**
+    * @brief    Stops noting the milestones and forgets them. Clients must not
+    *           be running in other threads while it is called.
+    */
+    MOCKABLE_FUNCTION(, void, IoTHubClient_StartupTimeline_Stop);
+
+    /**
+    * @brief    Copies the milestones reached so far.
+    *
+    * @return   0 on success, non-zero if @p timeline is NULL or the timeline
+    *           is not started.
+    */
+    MOCKABLE_FUNCTION(, int, IoTHubClient_StartupTimeline_Get, IOTHUB_CLIENT_STARTUP_TIMELINE*, timeline);
+
+    /**
+    * @brief    Formats the milestones reached so far as a JSON object, for
+    *           instance {"CLIENT_CREATE_STARTED":0,"CLIENT_CREATED":3}.
+    *
+    * @return   The JSON, to be released with free, or NULL if the timeline is
+    *           not started or on failure.
+    */
+    MOCKABLE_FUNCTION(, char*, IoTHubClient_StartupTimeline_ToJson);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_STARTUP_TIMELINE_H */
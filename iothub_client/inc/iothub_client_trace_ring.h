@@ -0,0 +1,91 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file iothub_client_trace_ring.h
+*    @brief Binary trace of the clients of the process, cheap enough to leave on in production.
+*
+*    @details Once started, the clients and transports of the process write
+*             a fixed-size record for each event of interest (connection
+*             status changes, MQTT connects, publishes and acks, AMQP device
+*             state changes) into one ring of records. Nothing is formatted:
+*             the ring is read back with IoTHubClient_TraceRing_Dump and
+*             decoded offline. The ring is a single allocation starting with
+*             IOTHUB_CLIENT_TRACE_RING_MAGIC, so it can also be found in the
+*             memory dump of a crashed process.
+*/
+
+#ifndef IOTHUB_CLIENT_TRACE_RING_H
+#define IOTHUB_CLIENT_TRACE_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "azure_c_shared_utility/macro_utils.h"
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define IOTHUB_CLIENT_TRACE_RING_MAGIC "IOTHTRC1"
+
+    /* The values are part of the dump format, new events are only ever added at the end */
+#define IOTHUB_CLIENT_TRACE_EVENT_VALUES          \
+    IOTHUB_CLIENT_TRACE_CONNECTION_STATUS,        \
+    IOTHUB_CLIENT_TRACE_MQTT_CONNECT,             \
+    IOTHUB_CLIENT_TRACE_MQTT_CONNACK,             \
+    IOTHUB_CLIENT_TRACE_MQTT_DISCONNECT,          \
+    IOTHUB_CLIENT_TRACE_MQTT_PUBLISH,             \
+    IOTHUB_CLIENT_TRACE_MQTT_PUBACK,              \
+    IOTHUB_CLIENT_TRACE_AMQP_DEVICE_STATE
+
+    /** @brief  What a trace record is about, and so what its values hold:
+    *           - CONNECTION_STATUS: value1 is the IOTHUB_CLIENT_CONNECTION_STATUS, value2 the reason.
+    *           - MQTT_CONNECT: the CONNECT packet was sent.
+    *           - MQTT_CONNACK: value1 is the CONNACK return code.
+    *           - MQTT_DISCONNECT: the connection was closed.
+    *           - MQTT_PUBLISH: value1 is the packet id of a telemetry message, value2 its payload size.
+    *           - MQTT_PUBACK: value1 is the packet id acknowledged.
+    *           - AMQP_DEVICE_STATE: value1 is the previous DEVICE_STATE, value2 the new one.
+    */
+    DEFINE_ENUM(IOTHUB_CLIENT_TRACE_EVENT, IOTHUB_CLIENT_TRACE_EVENT_VALUES);
+
+    typedef struct IOTHUB_CLIENT_TRACE_RECORD_TAG
+    {
+        uint32_t ms;        /*milliseconds since IoTHubClient_TraceRing_Start*/
+        uint32_t event;     /*IOTHUB_CLIENT_TRACE_EVENT*/
+        uint32_t source;    /*tells apart the clients and transports of the process*/
+        uint32_t value1;
+        uint32_t value2;
+    } IOTHUB_CLIENT_TRACE_RECORD;
+
+    /**
+    * @brief    Starts tracing into a ring of @p record_count records. Once
+    *           the ring is full the oldest records are overwritten.
+    *
+    * @return   0 on success, non-zero if @p record_count is 0, the ring
+    *           cannot be allocated or tracing is already started.
+    */
+    MOCKABLE_FUNCTION(, int, IoTHubClient_TraceRing_Start, size_t, record_count);
+
+    /**
+    * @brief    Stops tracing and frees the ring. Clients must not be running
+    *           in other threads while it is called.
+    */
+    MOCKABLE_FUNCTION(, void, IoTHubClient_TraceRing_Stop);
+
+    /**
+    * @brief    Copies the newest records of the ring, oldest first.
+    *
+    * @param    records         Receives the records.
+    * @param    record_count    Maximum number of records to copy.
+    *
+    * @return   The number of records copied, 0 if tracing is not started.
+    */
+    MOCKABLE_FUNCTION(, size_t, IoTHubClient_TraceRing_Dump, IOTHUB_CLIENT_TRACE_RECORD*, records, size_t, record_count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_TRACE_RING_H */
@@ -0,0 +1,76 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file iothub_client_worker_pool.h
+*    @brief Shared pool of worker threads for IoTHubClientCore instances.
+*
+*    @details By default every IoTHubClientCore instance that does not share
+*             a transport starts its own worker thread. A worker pool lets
+*             many client handles share a fixed number of threads instead.
+*             Clients are spread over one shard per thread; a thread that
+*             finds nothing due in its own shard takes due work from the
+*             other shards. A pool is attached to a client with
+*             OPTION_WORKER_POOL before the client starts its worker.
+*             A client with OPTION_DO_WORK_MAX_IDLE_MS set runs that rarely
+*             while it has nothing to send, and is woken as soon as it is
+*             given new work.
+*/
+
+#ifndef IOTHUB_CLIENT_WORKER_POOL_H
+#define IOTHUB_CLIENT_WORKER_POOL_H
+
+#include <stddef.h>
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    typedef struct IOTHUB_CLIENT_WORKER_POOL_TAG* IOTHUB_CLIENT_WORKER_POOL_HANDLE;
+    typedef struct IOTHUB_CLIENT_WORKER_POOL_ITEM_TAG* IOTHUB_CLIENT_WORKER_POOL_ITEM_HANDLE;
+
+    /** @brief  Runs one unit of work for a registered context and returns
+    *           the number of milliseconds until it should run again.
+    */
+    typedef unsigned int(*IOTHUB_CLIENT_WORKER_POOL_DO_WORK)(void* context);
+
+    /**
+    * @brief    Creates a pool of @p thread_count worker threads.
+    *
+    * @param    thread_count    Number of threads (and shards). Must be greater than 0.
+    *
+    * @return   A non-NULL handle on success, NULL otherwise.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_WORKER_POOL_HANDLE, IoTHubClientWorkerPool_Create, size_t, thread_count);
+
+    /**
+    * @brief    Stops and joins all worker threads and frees the pool.
+    *           All clients using the pool must be destroyed first.
+    */
+    MOCKABLE_FUNCTION(, void, IoTHubClientWorkerPool_Destroy, IOTHUB_CLIENT_WORKER_POOL_HANDLE, workerPoolHandle);
+
+    /**
+    * @brief    Schedules @p doWork to be called for @p context on the least
+    *           loaded shard. The first call happens as soon as a thread is free.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_WORKER_POOL_ITEM_HANDLE, IoTHubClientWorkerPool_Add, IOTHUB_CLIENT_WORKER_POOL_HANDLE, workerPoolHandle, IOTHUB_CLIENT_WORKER_POOL_DO_WORK, doWork, void*, context);
+
+    /**
+    * @brief    Unschedules an item. If its doWork is running on a pool thread
+    *           this call blocks until it returns. Must not be called from doWork.
+    */
+    MOCKABLE_FUNCTION(, void, IoTHubClientWorkerPool_Remove, IOTHUB_CLIENT_WORKER_POOL_HANDLE, workerPoolHandle, IOTHUB_CLIENT_WORKER_POOL_ITEM_HANDLE, itemHandle);
+
+    /**
+    * @brief    Makes an item due now instead of when its last doWork asked.
+    *           If its doWork is running, it runs again as soon as it returns.
+    *           May be called from any thread, including from doWork.
+    */
+    MOCKABLE_FUNCTION(, void, IoTHubClientWorkerPool_Wake, IOTHUB_CLIENT_WORKER_POOL_HANDLE, workerPoolHandle, IOTHUB_CLIENT_WORKER_POOL_ITEM_HANDLE, itemHandle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_WORKER_POOL_H */
@@ -125,6 +125,86 @@ extern "C"
     */
     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubDeviceClient_SendEventAsync, IOTHUB_DEVICE_CLIENT_HANDLE, iotHubClientHandle, IOTHUB_MESSAGE_HANDLE, eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, eventConfirmationCallback, void*, userContextCallback);
 
+    /**
+    * @brief    Asynchronous call to send the message specified by @p eventMessageHandle
+    *           without copying it. On success the client takes ownership of the message
+    *           and destroys it once it has been confirmed; the caller must not use
+    *           @p eventMessageHandle afterwards. On failure the caller still owns it.
+    *
+    * @param    iotHubClientHandle            The handle created by a call to the create function.
+    * @param    eventMessageHandle            The handle to an IoT Hub message.
+    * @param    eventConfirmationCallback     The callback receiving confirmation of the delivery
+    *                                         of the IoT Hub message. The user can specify a @c NULL
+    *                                         value here to indicate that no callback is required.
+    * @param    userContextCallback           User specified context that will be provided to the
+    *                                         callback. This can be @c NULL.
+    *
+    *            @b NOTE: The application behavior is undefined if the user calls
+    *            the ::IoTHubDeviceClient_Destroy function from within any callback.
+    *
+    * @return    IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubDeviceClient_SendEventAsync_TakeOwnership, IOTHUB_DEVICE_CLIENT_HANDLE, iotHubClientHandle, IOTHUB_MESSAGE_HANDLE, eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, eventConfirmationCallback, void*, userContextCallback);
+
+    /**
+    * @brief    Asynchronous call to send the @p eventMessageCount messages of @p eventMessageHandles
+    *           as one batch. The messages are copied and queued together, all or none of them,
+    *           so that the transport can send them in a single transfer (AMQP, HTTP with
+    *           OPTION_BATCHING) or in back to back publishes (MQTT).
+    *
+    * @param    iotHubClientHandle            The handle created by a call to the create function.
+    * @param    eventMessageHandles           The handles to the IoT Hub messages of the batch.
+    * @param    eventMessageCount             The number of messages in @p eventMessageHandles.
+    * @param    eventConfirmationCallback     The callback called once, when every message of the batch
+    *                                         has been confirmed, with IOTHUB_CLIENT_CONFIRMATION_OK if
+    *                                         they were all delivered and with the first failure otherwise.
+    *                                         The user can specify a @c NULL value here to indicate that
+    *                                         no callback is required.
+    * @param    userContextCallback           User specified context that will be provided to the
+    *                                         callback. This can be @c NULL.
+    *
+    *            @b NOTE: The application behavior is undefined if the user calls
+    *            the ::IoTHubDeviceClient_Destroy function from within any callback.
+    *
+    * @return    IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubDeviceClient_SendEventBatchAsync, IOTHUB_DEVICE_CLIENT_HANDLE, iotHubClientHandle, IOTHUB_MESSAGE_HANDLE*, eventMessageHandles, size_t, eventMessageCount, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, eventConfirmationCallback, void*, userContextCallback);
+
+    /**
+    * @brief    Sets a callback that receives, once per DoWork, the confirmations of all
+    *           events that were sent without their own confirmation callback.
+    *
+    * @param    iotHubClientHandle               The handle created by a call to the create function.
+    * @param    eventConfirmationBatchCallback   The callback receiving an array of (userContextCallback,
+    *                                            result) pairs, in completion order. The array is only
+    *                                            valid for the duration of the call. Pass @c NULL to stop
+    *                                            batching.
+    * @param    userContextCallback              User specified context that will be provided to the
+    *                                            callback. This can be @c NULL.
+    *
+    *            While a batch callback is set, ::IoTHubDeviceClient_SendEventAsync may be called with a
+    *            @c NULL eventConfirmationCallback and a non-NULL userContextCallback; that context is
+    *            what the batch reports for the message. Events sent with their own callback keep
+    *            receiving it individually. Not supported when the transport is shared.
+    *
+    * @return    IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubDeviceClient_SetEventConfirmationBatchCallback, IOTHUB_DEVICE_CLIENT_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_BATCH_CALLBACK, eventConfirmationBatchCallback, void*, userContextCallback);
+
+    /**
+    * @brief    Folds the telemetry sample @p value into the window of the aggregation set by
+    *           OPTION_TELEMETRY_AGGREGATION for the events sent without an output name. One event
+    *           holding the count, min, max and mean of the samples is sent per window, by the
+    *           worker thread once the window has ended.
+    *
+    * @param    iotHubClientHandle    The handle created by a call to the create function.
+    * @param    value                 The sample.
+    *
+    * @return   IOTHUB_CLIENT_OK upon success or an error code upon failure, IOTHUB_CLIENT_ERROR
+    *           if no aggregation is set for the events sent without an output name.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubDeviceClient_SendTelemetrySample, IOTHUB_DEVICE_CLIENT_HANDLE, iotHubClientHandle, double, value);
+
     /**
     * @brief    This function returns the current sending status for IoTHubClient.
     *
@@ -139,6 +219,19 @@ extern "C"
     */
     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubDeviceClient_GetSendStatus, IOTHUB_DEVICE_CLIENT_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_STATUS*, iotHubClientStatus);
 
+    /**
+    * @brief    This function returns the counters and latency histograms of the send path.
+    *           They are only collected once OPTION_ENABLE_STATISTICS has been set to true;
+    *           the number of events waiting to be sent is always filled in.
+    *
+    * @param    iotHubClientHandle        The handle created by a call to the create function.
+    * @param    statistics                The statistics are copied to the address pointed
+    *                                     at by this parameter.
+    *
+    * @return    IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubDeviceClient_GetStatistics, IOTHUB_DEVICE_CLIENT_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_STATISTICS*, statistics);
+
     /**
     * @brief    Sets up the message callback to be invoked when IoT Hub issues a
     *           message to the device. This is a blocking call.
@@ -336,6 +429,27 @@ extern "C"
     */
     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubDeviceClient_SetDeviceMethodCallback, IOTHUB_DEVICE_CLIENT_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC, deviceMethodCallback, void*, userContextCallback);
 
+    /**
+    * @brief    This API sets the callback for the cloud to device method called @p methodName.
+    *           Handlers are looked up by method name before the callback set by
+    *           the method callback API, which keeps receiving every other method.
+    *
+    * @param    iotHubClientHandle        The handle created by a call to the create function.
+    * @param    methodName                The name of the method handled by the callback.
+    * @param    methodCallback            The callback which will be called by IoTHub, or @c NULL
+    *                                     to remove the handler of @p methodName.
+    * @param    userContextCallback       User specified context that will be provided to the
+    *                                     callback. This can be @c NULL.
+    * @param    workerThreadCount         The number of threads running @p methodCallback. With 0 the
+    *                                     callback runs on the thread running every other callback;
+    *                                     otherwise a slow invocation of this method does not delay
+    *                                     other callbacks. The count is fixed by the first
+    *                                     registration of @p methodName.
+    *
+    * @return    IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubDeviceClient_SetDeviceMethodHandler, IOTHUB_DEVICE_CLIENT_HANDLE, iotHubClientHandle, const char*, methodName, IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC, methodCallback, void*, userContextCallback, size_t, workerThreadCount);
+
     /**
     * @brief    This API responds to an asnyc method callback identified the methodId.
     *
@@ -44,6 +44,9 @@ DEFINE_ENUM(IOTHUBMESSAGE_CONTENT_TYPE, IOTHUBMESSAGE_CONTENT_TYPE_VALUES);
 
 typedef struct IOTHUB_MESSAGE_HANDLE_DATA_TAG* IOTHUB_MESSAGE_HANDLE;
 
+/** @brief  An immutable set of application properties that many messages can share. */
+typedef struct IOTHUB_MESSAGE_PROPERTY_SET_TAG* IOTHUB_MESSAGE_PROPERTY_SET_HANDLE;
+
 /** @brief diagnostic related data*/
 typedef struct IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DATA_TAG
 {
@@ -65,6 +68,43 @@ static const char DIAG_CREATION_TIME_UTC_PROPERTY_NAME[] = "diag_creation_time_u
 */
 MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_HANDLE, IoTHubMessage_CreateFromByteArray, const unsigned char*, byteArray, size_t, size);
 
+/** @brief  Called once no message refers to the bytes given to IoTHubMessage_CreateFromByteArrayNoCopy anymore. */
+typedef void(*IOTHUB_MESSAGE_RELEASE_CALLBACK)(const unsigned char* byteArray, size_t size, void* context);
+
+/**
+* @brief   Creates a new IoT hub message over a byte array owned by the caller,
+*          without copying it. The type of the message will be set to
+*          @c IOTHUBMESSAGE_BYTEARRAY.
+*
+* @param   byteArray       The bytes of the message. They must stay valid and
+*                          unchanged until @p releaseCallback is called.
+* @param   size            The size of the byte array.
+* @param   releaseCallback Called once the message, and every clone of it, is
+*                          destroyed. For a message sent with SendEventAsync that
+*                          is after its confirmation callback. May be NULL.
+* @param   releaseContext  Passed to @p releaseCallback.
+*
+* @return  A valid @c IOTHUB_MESSAGE_HANDLE if the message was successfully
+*          created or @c NULL in case an error occurs, in which case
+*          @p releaseCallback is not called.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_HANDLE, IoTHubMessage_CreateFromByteArrayNoCopy, const unsigned char*, byteArray, size_t, size, IOTHUB_MESSAGE_RELEASE_CALLBACK, releaseCallback, void*, releaseContext);
+
+#ifdef USE_PAYLOAD_COMPRESSION
+/**
+* @brief   Creates a new IoT hub message holding the gzip compressed copy of a
+*          byte array, with its content encoding system property set to "gzip".
+*          Only available when the SDK is built with use_payload_compression.
+*
+* @param   byteArray   The byte array to be compressed into the message.
+* @param   size        The size of the byte array.
+*
+* @return  A valid @c IOTHUB_MESSAGE_HANDLE if the message was successfully
+*          created or @c NULL in case an error occurs.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_HANDLE, IoTHubMessage_CreateCompressedFromByteArray, const unsigned char*, byteArray, size_t, size);
+#endif /* USE_PAYLOAD_COMPRESSION */
+
 /**
 * @brief   Creates a new IoT hub message from a null terminated string.  The
 *          type of the message will be set to @c IOTHUBMESSAGE_STRING.
@@ -81,6 +121,9 @@ MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_HANDLE, IoTHubMessage_CreateFromString, const
 * @brief   Creates a new IoT hub message with the content identical to that
 *          of the @p iotHubMessageHandle parameter.
 *
+*          The payload of a byte array message is immutable and shared with the
+*          clone rather than copied, so cloning costs only the properties.
+*
 * @param   iotHubMessageHandle Handle to the message that is to be cloned.
 *
 * @return  A valid @c IOTHUB_MESSAGE_HANDLE if the message was successfully
@@ -204,6 +247,76 @@ MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_RESULT, IoTHubMessage_SetProperty, IOTHUB_MES
 */
 MOCKABLE_FUNCTION(, const char*, IoTHubMessage_GetProperty, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle, const char*, key);
 
+/**
+* @brief   Gets all the properties of a IotHub Message.
+*
+* @param   iotHubMessageHandle Handle to the message.
+*
+* @param   keys receives the names of the properties.
+*
+* @param   values receives the values of the properties, in the same order as @p keys.
+*
+* @param   count receives the number of properties.
+*
+* @return  An @c IOTHUB_MESSAGE_RESULT value. The arrays stay valid until the message is changed or destroyed.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_RESULT, IoTHubMessage_GetProperties, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle, const char* const**, keys, const char* const**, values, size_t*, count);
+
+/**
+* @brief   Creates an immutable set of application properties, checked and
+*          copied once, that any number of messages can then refer to with
+*          IoTHubMessage_SetPropertySet.
+*
+* @param   keys    The names of the properties. They must be unique.
+* @param   values  The values of the properties, in the same order as @p keys.
+* @param   count   The number of properties, at least one.
+*
+* @return  A valid @c IOTHUB_MESSAGE_PROPERTY_SET_HANDLE or @c NULL if an argument
+*          is invalid or a character is not printable US-ASCII.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_PROPERTY_SET_HANDLE, IoTHubMessagePropertySet_Create, const char* const*, keys, const char* const*, values, size_t, count);
+
+/**
+* @brief   Takes another reference on a property set, without copying it.
+*
+* @param   propertySet Handle to the property set.
+*
+* @return  @p propertySet, to be released with IoTHubMessagePropertySet_Destroy.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_PROPERTY_SET_HANDLE, IoTHubMessagePropertySet_Clone, IOTHUB_MESSAGE_PROPERTY_SET_HANDLE, propertySet);
+
+/**
+* @brief   Releases a reference on a property set. The set is freed once no
+*          handle and no message refers to it anymore.
+*
+* @param   propertySet Handle to the property set.
+*/
+MOCKABLE_FUNCTION(, void, IoTHubMessagePropertySet_Destroy, IOTHUB_MESSAGE_PROPERTY_SET_HANDLE, propertySet);
+
+/**
+* @brief   Makes a property set the properties of a IotHub Message, without
+*          copying them. The message keeps a reference on the set; changing a
+*          property of the message afterwards gives it its own copy first.
+*
+* @param   iotHubMessageHandle Handle to the message. It must not have
+*                              properties of its own yet.
+*
+* @param   propertySet Handle to the property set, replacing any previous one.
+*
+* @return  An @c IOTHUB_MESSAGE_RESULT value.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_RESULT, IoTHubMessage_SetPropertySet, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle, IOTHUB_MESSAGE_PROPERTY_SET_HANDLE, propertySet);
+
+/**
+* @brief   Gets the property set of a IotHub Message.
+*
+* @param   iotHubMessageHandle Handle to the message.
+*
+* @return  The property set the properties of the message are, or @c NULL if
+*          the message holds its own. The message owns the reference.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_PROPERTY_SET_HANDLE, IoTHubMessage_GetPropertySet, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle);
+
 /**
 * @brief   Gets the MessageId from the IOTHUB_MESSAGE_HANDLE.
 *
@@ -96,6 +96,48 @@ extern "C"
     */
      MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubModuleClient_LL_SendEventAsync, IOTHUB_MODULE_CLIENT_LL_HANDLE, iotHubModuleClientHandle, IOTHUB_MESSAGE_HANDLE, eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, eventConfirmationCallback, void*, userContextCallback);
 
+    /**
+    * @brief    Asynchronous call to send the message specified by @p eventMessageHandle
+    *           without copying it. On success the client takes ownership of the message
+    *           and destroys it once it has been confirmed; the caller must not use
+    *           @p eventMessageHandle afterwards. On failure the caller still owns it.
+    *
+    * @param    iotHubModuleClientHandle      The handle created by a call to the create function.
+    * @param    eventMessageHandle            The handle to an IoT Hub message.
+    * @param    eventConfirmationCallback     The callback receiving confirmation of the delivery
+    *                                         of the IoT Hub message. The user can specify a @c NULL
+    *                                         value here to indicate that no callback is required.
+    * @param    userContextCallback           User specified context that will be provided to the
+    *                                         callback. This can be @c NULL.
+    *
+    *            @b NOTE: The application behavior is undefined if the user calls
+    *            the ::IoTHubModuleClient_LL_Destroy function from within any callback.
+    *
+    * @return    IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubModuleClient_LL_SendEventAsync_TakeOwnership, IOTHUB_MODULE_CLIENT_LL_HANDLE, iotHubModuleClientHandle, IOTHUB_MESSAGE_HANDLE, eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, eventConfirmationCallback, void*, userContextCallback);
+
+    /**
+    * @brief    Sets a callback that receives, once per DoWork, the confirmations of all
+    *           events that were sent without their own confirmation callback.
+    *
+    * @param    iotHubModuleClientHandle         The handle created by a call to the create function.
+    * @param    eventConfirmationBatchCallback   The callback receiving an array of (userContextCallback,
+    *                                            result) pairs, in completion order. The array is only
+    *                                            valid for the duration of the call. Pass @c NULL to stop
+    *                                            batching.
+    * @param    userContextCallback              User specified context that will be provided to the
+    *                                            callback. This can be @c NULL.
+    *
+    *            While a batch callback is set, ::IoTHubModuleClient_LL_SendEventAsync may be called with a
+    *            @c NULL eventConfirmationCallback and a non-NULL userContextCallback; that context is
+    *            what the batch reports for the message. Events sent with their own callback keep
+    *            receiving it individually. Not supported when the transport is shared.
+    *
+    * @return    IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubModuleClient_LL_SetEventConfirmationBatchCallback, IOTHUB_MODULE_CLIENT_LL_HANDLE, iotHubModuleClientHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_BATCH_CALLBACK, eventConfirmationBatchCallback, void*, userContextCallback);
+
     /**
     * @brief    This function returns the current sending status for IoTHubClient.
     *
@@ -110,6 +152,19 @@ extern "C"
     */
      MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubModuleClient_LL_GetSendStatus, IOTHUB_MODULE_CLIENT_LL_HANDLE, iotHubModuleClientHandle, IOTHUB_CLIENT_STATUS*, iotHubClientStatus);
 
+    /**
+    * @brief    This function returns the counters and latency histograms of the send path.
+    *           They are only collected once OPTION_ENABLE_STATISTICS has been set to true;
+    *           the number of events waiting to be sent is always filled in.
+    *
+    * @param    iotHubModuleClientHandle  The handle created by a call to the create function.
+    * @param    statistics                The statistics are copied to the address pointed
+    *                                     at by this parameter.
+    *
+    * @return    IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubModuleClient_LL_GetStatistics, IOTHUB_MODULE_CLIENT_LL_HANDLE, iotHubModuleClientHandle, IOTHUB_CLIENT_STATISTICS*, statistics);
+
     /**
     * @brief    Sets up the message callback to be invoked when Edge issues a
     *             message to the module. This is a blocking call.
@@ -268,6 +323,26 @@ extern "C"
     */
      MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubModuleClient_LL_SetModuleTwinCallback, IOTHUB_MODULE_CLIENT_LL_HANDLE, iotHubModuleClientHandle, IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK, moduleTwinCallback, void*, userContextCallback);
 
+    /**
+    * @brief   This API specifies a callback to be used when a desired state update holds the properties at a path.
+    *
+    * @param   iotHubModuleClientHandle  The handle created by a call to the create function.
+    * @param   path                      The dot separated path of the properties from the root of the twin,
+    *                                    for instance "desired.motors.left". A "*" segment matches every member
+    *                                    whose name does not start with '$', for instance "desired.motors.*".
+    * @param   desiredPropertyCallback   The callback called, with the path and the JSON value of the property,
+    *                                    for every property at path held by a desired state update. Each update
+    *                                    is parsed once for all the paths. @c NULL removes the callback of path.
+    * @param   userContextCallback       User specified context that will be provided to the
+    *                                    callback. This can be @c NULL.
+    *
+    *           @b NOTE: The application behavior is undefined if the user calls
+    *           the ::IoTHubModuleClient_LL_Destroy function from within any callback.
+    *
+    * @return   IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubModuleClient_LL_SetDesiredPropertyCallback, IOTHUB_MODULE_CLIENT_LL_HANDLE, iotHubModuleClientHandle, const char*, path, IOTHUB_CLIENT_DESIRED_PROPERTY_CALLBACK, desiredPropertyCallback, void*, userContextCallback);
+
     /**
     * @brief    This API sneds a report of the module's properties and their current values.
     *
@@ -312,6 +387,22 @@ extern "C"
      */
      MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubModuleClient_LL_SetModuleMethodCallback, IOTHUB_MODULE_CLIENT_LL_HANDLE, iotHubModuleClientHandle, IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC, moduleMethodCallback, void*, userContextCallback);
 
+     /**
+     * @brief    This API sets the callback for the cloud to module method called @p methodName.
+     *           Handlers are looked up by method name before the callback set by
+     *           the method callback API, which keeps receiving every other method.
+     *
+     * @param    iotHubModuleClientHandle        The handle created by a call to the create function.
+     * @param    methodName                The name of the method handled by the callback.
+     * @param    methodCallback            The callback which will be called by IoTHub, or @c NULL
+     *                                     to remove the handler of @p methodName.
+     * @param    userContextCallback       User specified context that will be provided to the
+     *                                     callback. This can be @c NULL.
+     *
+     * @return    IOTHUB_CLIENT_OK upon success or an error code upon failure.
+     */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubModuleClient_LL_SetModuleMethodHandler, IOTHUB_MODULE_CLIENT_LL_HANDLE, iotHubModuleClientHandle, const char*, methodName, IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC, methodCallback, void*, userContextCallback);
+
     /**
     * @brief    Asynchronous call to send the message specified by @p eventMessageHandle.
     *
@@ -335,6 +426,66 @@ extern "C"
     */
     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubModuleClient_LL_SendEventToOutputAsync, IOTHUB_MODULE_CLIENT_LL_HANDLE, iotHubModuleClientHandle, IOTHUB_MESSAGE_HANDLE, eventMessageHandle, const char*, outputName, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, eventConfirmationCallback, void*, userContextCallback);
 
+    /**
+    * @brief    Asynchronous call to send the message specified by @p eventMessageHandle
+    *           without copying it. On success the client takes ownership of the message
+    *           and destroys it once it has been confirmed; the caller must not use
+    *           @p eventMessageHandle afterwards. On failure the caller still owns it.
+    *
+    * @param    iotHubModuleClientHandle      The handle created by a call to the create function.
+    * @param    eventMessageHandle            The handle to an IoT Hub message.
+    * @param    outputName                    The name of the queue to send the message to.
+    * @param    eventConfirmationCallback     The callback receiving confirmation of the delivery
+    *                                         of the IoT Hub message. The user can specify a @c NULL
+    *                                         value here to indicate that no callback is required.
+    * @param    userContextCallback           User specified context that will be provided to the
+    *                                         callback. This can be @c NULL.
+    *
+    *            @b NOTE: The application behavior is undefined if the user calls
+    *            the ::IoTHubModuleClient_LL_Destroy function from within any callback.
+    *
+    * @return    IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubModuleClient_LL_SendEventToOutputAsync_TakeOwnership, IOTHUB_MODULE_CLIENT_LL_HANDLE, iotHubModuleClientHandle, IOTHUB_MESSAGE_HANDLE, eventMessageHandle, const char*, outputName, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, eventConfirmationCallback, void*, userContextCallback);
+
+    /**
+    * @brief    Asynchronous call to send the message specified by @p eventMessageHandle to every output
+    *           of the routes set by OPTION_OUTPUT_ROUTE that match its application properties. The
+    *           routes are evaluated once, and the events share the payload and properties of the
+    *           message, so sending to N outputs does not copy them N times.
+    *
+    * @param    iotHubModuleClientHandle    The handle created by a call to the create function.
+    * @param    eventMessageHandle          The handle to an IoT Hub message.
+    * @param    eventConfirmationCallback   The callback specified by the module for receiving
+    *                                       confirmation of the delivery of the events, called once
+    *                                       all of them have completed, with
+    *                                       IOTHUB_CLIENT_CONFIRMATION_OK only if they all succeeded.
+    * @param    userContextCallback         User specified context that will be provided to the
+    *                                       callback. This can be @c NULL.
+    *
+    *           @b NOTE: The application behavior is undefined if the user calls
+    *           the ::IoTHubModuleClient_LL_Destroy function from within any callback.
+    *
+    * @return   IOTHUB_CLIENT_OK upon success or an error code upon failure, IOTHUB_CLIENT_ERROR
+    *           if no route matches the message, in which case nothing is sent.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubModuleClient_LL_SendEventToRoutesAsync, IOTHUB_MODULE_CLIENT_LL_HANDLE, iotHubModuleClientHandle, IOTHUB_MESSAGE_HANDLE, eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, eventConfirmationCallback, void*, userContextCallback);
+
+    /**
+    * @brief    Folds the telemetry sample @p value into the window of the aggregation set by
+    *           OPTION_TELEMETRY_AGGREGATION for @p outputName. One event holding the count, min,
+    *           max and mean of the samples is sent to @p outputName per window, by
+    *           ::IoTHubModuleClient_LL_DoWork once the window has ended.
+    *
+    * @param    iotHubModuleClientHandle    The handle created by a call to the create function.
+    * @param    outputName                  The name of the queue the aggregated events are sent to.
+    * @param    value                       The sample.
+    *
+    * @return   IOTHUB_CLIENT_OK upon success or an error code upon failure, IOTHUB_CLIENT_ERROR
+    *           if no aggregation is set for @p outputName.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubModuleClient_LL_SendTelemetrySample, IOTHUB_MODULE_CLIENT_LL_HANDLE, iotHubModuleClientHandle, const char*, outputName, double, value);
+
     /**
     * @brief    This API sets callback for  method call that is directed to specified 'inputName' queue (e.g. messages from IoTHubClient_SendEventToOutputAsync)
     *
@@ -394,6 +545,45 @@ extern "C"
     */
     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubModuleClient_LL_ModuleMethodInvoke, IOTHUB_MODULE_CLIENT_LL_HANDLE, iotHubModuleClientHandle, const char*, deviceId, const char*, moduleId, const char*, methodName, const char*, methodPayload, unsigned int, timeout, int*, responseStatus, unsigned char**, responsePayload, size_t*, responsePayloadSize);
 
+    /*
+    * @brief    This API invokes a device method on a specified device without blocking.
+    *           The request is sent and its response received from IoTHubModuleClient_LL_DoWork,
+    *           so many invokes can be in flight on one thread.
+    *
+    * @param    iotHubModuleClientHandle        The handle created by a call to a create function
+    * @param    deviceId                        The device id of the device to invoke a method on
+    * @param    methodName                      The name of the method
+    * @param    methodPayload                   The method payload (in json format)
+    * @param    timeout                         The time in seconds before a timeout occurs
+    * @param    methodInvokeCallback            Called from IoTHubModuleClient_LL_DoWork with the response, or with an
+    *                                           error if the invoke fails, times out or the handle is destroyed first.
+    *                                           The response payload is freed when the callback returns.
+    * @param    context                         User specified context that will be provided to the callback
+    *
+    * @return   IOTHUB_CLIENT_OK upon success, or an error code upon failure.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubModuleClient_LL_DeviceMethodInvokeAsync, IOTHUB_MODULE_CLIENT_LL_HANDLE, iotHubModuleClientHandle, const char*, deviceId, const char*, methodName, const char*, methodPayload, unsigned int, timeout, IOTHUB_METHOD_INVOKE_CALLBACK, methodInvokeCallback, void*, context);
+
+    /*
+    * @brief    This API invokes a module method on a specified module without blocking.
+    *           The request is sent and its response received from IoTHubModuleClient_LL_DoWork,
+    *           so many invokes can be in flight on one thread.
+    *
+    * @param    iotHubModuleClientHandle        The handle created by a call to a create function
+    * @param    deviceId                        The device id of the device to invoke a method on
+    * @param    moduleId                        The module id of the module to invoke a method on
+    * @param    methodName                      The name of the method
+    * @param    methodPayload                   The method payload (in json format)
+    * @param    timeout                         The time in seconds before a timeout occurs
+    * @param    methodInvokeCallback            Called from IoTHubModuleClient_LL_DoWork with the response, or with an
+    *                                           error if the invoke fails, times out or the handle is destroyed first.
+    *                                           The response payload is freed when the callback returns.
+    * @param    context                         User specified context that will be provided to the callback
+    *
+    * @return   IOTHUB_CLIENT_OK upon success, or an error code upon failure.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubModuleClient_LL_ModuleMethodInvokeAsync, IOTHUB_MODULE_CLIENT_LL_HANDLE, iotHubModuleClientHandle, const char*, deviceId, const char*, moduleId, const char*, methodName, const char*, methodPayload, unsigned int, timeout, IOTHUB_METHOD_INVOKE_CALLBACK, methodInvokeCallback, void*, context);
+
 #endif /*USE_EDGE_MODULES*/
 
 #ifdef __cplusplus
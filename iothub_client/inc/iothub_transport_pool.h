@@ -0,0 +1,65 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file iothub_transport_pool.h
+*    @brief Pool of shared transports spreading multiplexed devices over several connections.
+*
+*    @details A TRANSPORT_HANDLE carries every device created on it over one
+*             connection served by one worker thread. A transport pool creates
+*             @c connection_count such transports and picks one per device id by
+*             consistent hashing, so a device always lands on the same
+*             connection and growing the pool from K to K+1 connections only
+*             moves about 1/(K+1) of the devices. Each connection starts its
+*             worker thread when its first client does.
+*
+*             A client is created on its connection with
+*             IoTHubClient_CreateWithTransport(IoTHubTransportPool_GetTransport(pool, deviceId), config).
+*/
+
+#ifndef IOTHUB_TRANSPORT_POOL_H
+#define IOTHUB_TRANSPORT_POOL_H
+
+#include <stddef.h>
+#include "azure_c_shared_utility/umock_c_prod.h"
+#include "iothub_transport_ll.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    typedef struct IOTHUB_TRANSPORT_POOL_TAG* IOTHUB_TRANSPORT_POOL_HANDLE;
+
+    /**
+    * @brief    Creates @p connection_count transports of @p protocol to the same IoT hub.
+    *
+    * @param    connection_count    Number of connections. Must be greater than 0.
+    *
+    * @return   A non-NULL handle on success, NULL otherwise.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_TRANSPORT_POOL_HANDLE, IoTHubTransportPool_Create, IOTHUB_CLIENT_TRANSPORT_PROVIDER, protocol, const char*, iotHubName, const char*, iotHubSuffix, size_t, connection_count);
+
+    /**
+    * @brief    Destroys every transport of the pool and frees it.
+    *           All clients created on the pool must be destroyed first.
+    */
+    MOCKABLE_FUNCTION(, void, IoTHubTransportPool_Destroy, IOTHUB_TRANSPORT_POOL_HANDLE, transportPoolHandle);
+
+    /**
+    * @brief    Returns the transport @p deviceId is assigned to. The same device id
+    *           always gets the same transport of a given pool.
+    *
+    * @return   The transport, or NULL if an argument is NULL.
+    */
+    MOCKABLE_FUNCTION(, TRANSPORT_HANDLE, IoTHubTransportPool_GetTransport, IOTHUB_TRANSPORT_POOL_HANDLE, transportPoolHandle, const char*, deviceId);
+
+    /**
+    * @brief    Returns the number of connections of the pool, or 0 if @p transportPoolHandle is NULL.
+    */
+    MOCKABLE_FUNCTION(, size_t, IoTHubTransportPool_GetConnectionCount, IOTHUB_TRANSPORT_POOL_HANDLE, transportPoolHandle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_TRANSPORT_POOL_H */
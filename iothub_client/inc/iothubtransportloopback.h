@@ -0,0 +1,56 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef IOTHUBTRANSPORTLOOPBACK_H
+#define IOTHUBTRANSPORTLOOPBACK_H
+
+#include "iothub_transport_ll.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#include <cstddef>
+#else
+#include <stddef.h>
+#endif
+
+    /* Milliseconds (unsigned int) the transport waits before confirming an event, acknowledging a reported state or answering
+       a twin request, 0 (the default) for the next DoWork. */
+#define OPTION_LOOPBACK_LATENCY                 "loopback_latency"
+
+    /* Cloud-to-device messages, desired properties patches and method invocations injected per second (unsigned int) once the
+       client subscribes to them, 0 (the default) for none. */
+#define OPTION_LOOPBACK_C2D_RATE                "loopback_c2d_rate"
+#define OPTION_LOOPBACK_DESIRED_RATE            "loopback_desired_rate"
+#define OPTION_LOOPBACK_METHOD_RATE             "loopback_method_rate"
+
+    /* Size in bytes (size_t) of the payload of the injected cloud-to-device messages and method invocations, 16 by default. */
+#define OPTION_LOOPBACK_PAYLOAD_SIZE            "loopback_payload_size"
+
+    typedef struct LOOPBACK_TRANSPORT_STATISTICS_TAG
+    {
+        size_t events_confirmed;
+        size_t messages_injected;
+        size_t messages_disposed;
+        size_t desired_patches_injected;
+        size_t reported_states_acknowledged;
+        size_t twin_requests_answered;
+        size_t methods_injected;
+        size_t method_responses;
+    } LOOPBACK_TRANSPORT_STATISTICS;
+
+    /* A transport that never touches the network, used to measure the client on its own: events are confirmed with
+       IOTHUB_CLIENT_CONFIRMATION_OK and reported states with status 204, and cloud-to-device messages, desired properties
+       and method invocations are generated at the rates of the options above. It supports a single device, and nothing is
+       injected on input queues. */
+    extern const TRANSPORT_PROVIDER* Loopback_Protocol(void);
+
+    /* The counters of every loopback transport of the process, since it started or since the last Loopback_ResetStatistics. */
+    extern void Loopback_GetStatistics(LOOPBACK_TRANSPORT_STATISTICS* statistics);
+    extern void Loopback_ResetStatistics(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*IOTHUBTRANSPORTLOOPBACK_H*/
@@ -0,0 +1,21 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef IOTHUBTRANSPORTMQTT_LOCAL_H
+#define IOTHUBTRANSPORTMQTT_LOCAL_H
+
+#include "iothub_transport_ll.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+    /* MQTT to an edgeHub on the same host, over the unix domain socket named by the
+       EdgeHubLocalSocket environment variable and without TLS. */
+    extern const TRANSPORT_PROVIDER* MQTT_Local_Protocol(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*IOTHUBTRANSPORTMQTT_LOCAL_H*/
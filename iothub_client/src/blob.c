@@ -3,14 +3,51 @@
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <stdbool.h>
 #include "azure_c_shared_utility/gballoc.h"
 #include "internal/blob.h"
 #include "internal/iothub_client_ll_uploadtoblob.h"
 
 #include "azure_c_shared_utility/httpapiex.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/lock.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/base64.h"
 #include "azure_c_shared_utility/shared_util_options.h"
+#include "azure_c_shared_utility/agenttime.h"
+
+typedef struct BLOB_CONNECTION_TAG
+{
+    size_t idleTimeoutSecs;
+    char* hostname; /*storage host httpApiExHandle is connected to*/
+    HTTPAPIEX_HANDLE httpApiExHandle; /*NULL while no connection is kept*/
+    time_t lastUsed;
+} BLOB_CONNECTION;
+
+/*the blocks of an upload PUT by several connections at the same time, all fields past lock guarded by it*/
+typedef struct BLOB_PARALLEL_UPLOAD_TAG
+{
+    const char* relativePath;
+    IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK_EX getDataCallbackEx;
+    void* context;
+    LOCK_HANDLE lock; /*also makes the calls to getDataCallbackEx one at a time*/
+    unsigned int nextBlockID;
+    int noMoreBlocks;
+    int isError;
+    BLOB_RESULT result;
+    unsigned int* httpStatus;
+    BUFFER_HANDLE httpResponse;
+} BLOB_PARALLEL_UPLOAD;
+
+/*the thread calling the upload or one of the threads it started, PUTting blocks on its own connection*/
+typedef struct BLOB_UPLOAD_WORKER_TAG
+{
+    BLOB_PARALLEL_UPLOAD* upload;
+    HTTPAPIEX_HANDLE httpApiExHandle;
+    STRING_HANDLE blockIDList; /*Blob_UploadBlock adds every block ID to it, the list committed is built from the block count instead*/
+    BUFFER_HANDLE httpResponse;
+    THREAD_HANDLE thread;
+} BLOB_UPLOAD_WORKER;
 
 BLOB_RESULT Blob_UploadBlock(
         HTTPAPIEX_HANDLE httpApiExHandle,
@@ -87,33 +124,48 @@ BLOB_RESULT Blob_UploadBlock(
                         }
                         else
                         {
-                            /*Codes_SRS_BLOB_02_024: [ Blob_UploadMultipleBlocksFromSasUri shall call HTTPAPIEX_ExecuteRequest with a PUT operation, passing httpStatus and httpResponse. ]*/
-                            if (HTTPAPIEX_ExecuteRequest(
-                                httpApiExHandle,
-                                HTTPAPI_REQUEST_PUT,
-                                STRING_c_str(newRelativePath),
-                                NULL,
-                                requestContent,
-                                httpStatus,
-                                NULL,
-                                httpResponse) != HTTPAPIEX_OK
-                                )
-                            {
-                                /*Codes_SRS_BLOB_02_025: [ If HTTPAPIEX_ExecuteRequest fails then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_HTTP_ERROR. ]*/
-                                LogError("unable to HTTPAPIEX_ExecuteRequest");
-                                result = BLOB_HTTP_ERROR;
-                            }
-                            else if (*httpStatus >= 300)
-                            {
-                                /*Codes_SRS_BLOB_02_026: [ Otherwise, if HTTP response code is >=300 then Blob_UploadMultipleBlocksFromSasUri shall succeed and return BLOB_OK. ]*/
-                                LogError("HTTP status from storage does not indicate success (%d)", (int)*httpStatus);
-                                result = BLOB_OK;
-                            }
-                            else
+                            unsigned int attempt = 0;
+                            bool retryBlock;
+                            do
                             {
-                                /*Codes_SRS_BLOB_02_027: [ Otherwise Blob_UploadMultipleBlocksFromSasUri shall continue execution. ]*/
-                                result = BLOB_OK;
-                            }
+                                retryBlock = false;
+                                attempt++;
+
+                                /*Codes_SRS_BLOB_02_024: [ Blob_UploadMultipleBlocksFromSasUri shall call HTTPAPIEX_ExecuteRequest with a PUT operation, passing httpStatus and httpResponse. ]*/
+                                if (HTTPAPIEX_ExecuteRequest(
+                                    httpApiExHandle,
+                                    HTTPAPI_REQUEST_PUT,
+                                    STRING_c_str(newRelativePath),
+                                    NULL,
+                                    requestContent,
+                                    httpStatus,
+                                    NULL,
+                                    httpResponse) != HTTPAPIEX_OK
+                                    )
+                                {
+                                    /*Codes_SRS_BLOB_02_025: [ If HTTPAPIEX_ExecuteRequest fails then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_HTTP_ERROR. ]*/
+                                    LogError("unable to HTTPAPIEX_ExecuteRequest");
+                                    result = BLOB_HTTP_ERROR;
+                                }
+                                else if ((*httpStatus >= 500) && (attempt < BLOB_UPLOAD_BLOCK_MAX_ATTEMPTS))
+                                {
+                                    /*Codes_SRS_BLOB_41_001: [ If the HTTP response code is >=500 then Blob_UploadMultipleBlocksFromSasUri shall wait attempt * BLOB_UPLOAD_BLOCK_RETRY_DELAY_MS milliseconds and PUT the same block again with the same block ID, up to BLOB_UPLOAD_BLOCK_MAX_ATTEMPTS attempts in total. ]*/
+                                    LogInfo("storage returned HTTP status %d for block %u, retrying (attempt %u of %u)", (int)*httpStatus, blockID, attempt + 1, (unsigned int)BLOB_UPLOAD_BLOCK_MAX_ATTEMPTS);
+                                    ThreadAPI_Sleep(attempt * BLOB_UPLOAD_BLOCK_RETRY_DELAY_MS);
+                                    retryBlock = true;
+                                }
+                                else if (*httpStatus >= 300)
+                                {
+                                    /*Codes_SRS_BLOB_02_026: [ Otherwise, if HTTP response code is >=300 then Blob_UploadMultipleBlocksFromSasUri shall succeed and return BLOB_OK. ]*/
+                                    LogError("HTTP status from storage does not indicate success (%d)", (int)*httpStatus);
+                                    result = BLOB_OK;
+                                }
+                                else
+                                {
+                                    /*Codes_SRS_BLOB_02_027: [ Otherwise Blob_UploadMultipleBlocksFromSasUri shall continue execution. ]*/
+                                    result = BLOB_OK;
+                                }
+                            } while (retryBlock);
                         }
                         STRING_delete(newRelativePath);
                     }
@@ -125,7 +177,322 @@ BLOB_RESULT Blob_UploadBlock(
     return result;
 }
 
-BLOB_RESULT Blob_UploadMultipleBlocksFromSasUri(const char* SASURI, IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK_EX getDataCallbackEx, void* context, unsigned int* httpStatus, BUFFER_HANDLE httpResponse, const char* certificates, HTTP_PROXY_OPTIONS *proxyOptions)
+/*adds the block IDs firstBlockID...endBlockID-1 to the XML, returns 0 on success*/
+static int add_block_ids(STRING_HANDLE blockIDList, unsigned int firstBlockID, unsigned int endBlockID)
+{
+    int result = 0;
+    unsigned int blockID;
+    for (blockID = firstBlockID; (blockID < endBlockID) && (blockID < MAX_BLOCK_COUNT) && (result == 0); blockID++)
+    {
+        char temp[7]; /*this will contain 000000... 049999*/
+        if (sprintf(temp, "%6u", (unsigned int)blockID) != 6) /*produces 000000... 049999*/
+        {
+            LogError("failed to sprintf");
+            result = __FAILURE__;
+        }
+        else
+        {
+            STRING_HANDLE blockIdString = Base64_Encode_Bytes((const unsigned char*)temp, 6);
+            if (blockIdString == NULL)
+            {
+                LogError("unable to Base64_Encode_Bytes");
+                result = __FAILURE__;
+            }
+            else
+            {
+                if (!(
+                    (STRING_concat(blockIDList, "<Latest>") == 0) &&
+                    (STRING_concat_with_STRING(blockIDList, blockIdString) == 0) &&
+                    (STRING_concat(blockIDList, "</Latest>") == 0)
+                    ))
+                {
+                    LogError("unable to STRING_concat");
+                    result = __FAILURE__;
+                }
+                STRING_delete(blockIdString);
+            }
+        }
+    }
+    return result;
+}
+
+/*returns the kept connection if it goes to hostname and has not been idle for too long, NULL otherwise. The connection is no longer kept afterwards*/
+static HTTPAPIEX_HANDLE take_kept_connection(BLOB_CONNECTION* connection, const char* hostname)
+{
+    HTTPAPIEX_HANDLE result = connection->httpApiExHandle;
+
+    if (result != NULL)
+    {
+        time_t now = get_time(NULL);
+
+        /*Codes_SRS_BLOB_41_006: [ `Blob_UploadMultipleBlocksOnConnection` shall reuse the HTTPAPIEX_HANDLE kept by `connection` when it goes to the hostname of `SASURI` and has been idle for at most the idle timeout, without setting its options again. ]*/
+        if ((strcmp(connection->hostname, hostname) != 0) ||
+            (now == (time_t)-1) ||
+            (get_difftime(now, connection->lastUsed) > (double)connection->idleTimeoutSecs))
+        {
+            /*Codes_SRS_BLOB_41_007: [ Otherwise `Blob_UploadMultipleBlocksOnConnection` shall destroy the kept HTTPAPIEX_HANDLE and create a new one like `Blob_UploadMultipleBlocksFromSasUri` does. ]*/
+            HTTPAPIEX_Destroy(result);
+            result = NULL;
+        }
+        free(connection->hostname);
+        connection->hostname = NULL;
+        connection->httpApiExHandle = NULL;
+    }
+
+    return result;
+}
+
+static void keep_connection(BLOB_CONNECTION* connection, HTTPAPIEX_HANDLE httpApiExHandle, char* hostname)
+{
+    connection->httpApiExHandle = httpApiExHandle;
+    connection->hostname = hostname;
+    connection->lastUsed = get_time(NULL);
+}
+
+/*opens one more connection to the storage host, with the same options as the first one*/
+static HTTPAPIEX_HANDLE create_worker_connection(const char* hostname, const char* certificates, HTTP_PROXY_OPTIONS *proxyOptions)
+{
+    HTTPAPIEX_HANDLE result = HTTPAPIEX_Create(hostname);
+
+    if (result == NULL)
+    {
+        LogError("unable to create a HTTPAPIEX_HANDLE");
+    }
+    else if ((certificates != NULL) && (HTTPAPIEX_SetOption(result, "TrustedCerts", certificates) == HTTPAPIEX_ERROR))
+    {
+        LogError("failure in setting trusted certificates");
+        HTTPAPIEX_Destroy(result);
+        result = NULL;
+    }
+    else if ((proxyOptions != NULL && proxyOptions->host_address != NULL) && HTTPAPIEX_SetOption(result, OPTION_HTTP_PROXY, proxyOptions) == HTTPAPIEX_ERROR)
+    {
+        LogError("failure in setting proxy options");
+        HTTPAPIEX_Destroy(result);
+        result = NULL;
+    }
+
+    return result;
+}
+
+/*asks getDataCallbackEx for the next block and PUTs it until there is none left or the upload failed*/
+static void upload_next_blocks(BLOB_UPLOAD_WORKER* worker)
+{
+    BLOB_PARALLEL_UPLOAD* upload = worker->upload;
+
+    /*a worker that cannot lock leaves the blocks to the others*/
+    if (Lock(upload->lock) != LOCK_OK)
+    {
+        LogError("failed locking for upload_next_blocks");
+    }
+    else
+    {
+        while ((upload->noMoreBlocks == 0) && (upload->isError == 0))
+        {
+            unsigned char const * source; /* data set by getDataCallbackEx */
+            size_t size; /* source size set by getDataCallbackEx */
+            unsigned int blockID = upload->nextBlockID;
+            BUFFER_HANDLE requestContent = NULL;
+
+            /*Codes_SRS_BLOB_41_013: [ `getDataCallbackEx` shall be called one call at a time and in block order, with `FILE_UPLOAD_OK` as long as no block failed, while the blocks asked for before may still be in flight. ]*/
+            IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_RESULT getDataReturnValue = upload->getDataCallbackEx(FILE_UPLOAD_OK, &source, &size, upload->context);
+            if (getDataReturnValue == IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_ABORT)
+            {
+                /*Codes_SRS_BLOB_99_004: [ If `getDataCallbackEx` returns `IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_RESULT_ABORT`, then `Blob_UploadMultipleBlocksFromSasUri` shall exit the loop and return `BLOB_ABORTED`. ]*/
+                LogInfo("Upload to blob has been aborted by the user");
+                upload->noMoreBlocks = 1;
+                upload->result = BLOB_ABORTED;
+            }
+            else if (source == NULL || size == 0)
+            {
+                /*Codes_SRS_BLOB_99_002: [ If the size of the block returned by `getDataCallbackEx` is 0 or if the data is NULL, then `Blob_UploadMultipleBlocksFromSasUri` shall exit the loop. ]*/
+                upload->noMoreBlocks = 1;
+            }
+            else if (size > BLOCK_SIZE)
+            {
+                /*Codes_SRS_BLOB_99_001: [ If the size of the block returned by `getDataCallbackEx` is bigger than 4MB, then `Blob_UploadMultipleBlocksFromSasUri` shall fail and return `BLOB_INVALID_ARG`. ]*/
+                LogError("tried to upload block of size %lu, max allowed size is %d", (unsigned long)size, BLOCK_SIZE);
+                upload->result = BLOB_INVALID_ARG;
+                upload->isError = 1;
+            }
+            else if (blockID >= MAX_BLOCK_COUNT)
+            {
+                /*Codes_SRS_BLOB_99_003: [ If `getDataCallbackEx` returns more than 50000 blocks, then `Blob_UploadMultipleBlocksFromSasUri` shall fail and return `BLOB_INVALID_ARG`. ]*/
+                LogError("unable to upload more than %lu blocks in one blob", (unsigned long)MAX_BLOCK_COUNT);
+                upload->result = BLOB_INVALID_ARG;
+                upload->isError = 1;
+            }
+            /*the block is copied before the lock is released, getDataCallbackEx may reuse its buffer for the next one*/
+            else if ((requestContent = BUFFER_create(source, size)) == NULL)
+            {
+                /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_ERROR ]*/
+                LogError("unable to BUFFER_create");
+                upload->result = BLOB_ERROR;
+                upload->isError = 1;
+            }
+            else
+            {
+                unsigned int httpStatus = 0;
+                BLOB_RESULT blockResult;
+
+                upload->nextBlockID++;
+                (void)Unlock(upload->lock);
+
+                blockResult = Blob_UploadBlock(worker->httpApiExHandle, upload->relativePath, requestContent, blockID, worker->blockIDList, &httpStatus, worker->httpResponse);
+                BUFFER_delete(requestContent);
+                (void)STRING_empty(worker->blockIDList);
+
+                if (Lock(upload->lock) != LOCK_OK)
+                {
+                    LogError("unable to Lock - - will still proceed to report the block");
+                }
+
+                if ((blockResult != BLOB_OK) || (httpStatus >= 300))
+                {
+                    LogError("unable to Blob_UploadBlock. Returned value=%d, httpStatus=%u", blockResult, httpStatus);
+
+                    /*Codes_SRS_BLOB_41_014: [ Once a block failed, no block shall be asked for, the blocks in flight shall be waited for and the first block that failed shall be reported with its result, HTTP status and HTTP response as `Blob_UploadMultipleBlocksFromSasUri` reports a block that failed. ]*/
+                    /*Codes_SRS_BLOB_41_018: [ Once `getDataCallbackEx` aborted the upload, `Blob_UploadMultipleBlocksInParallel` shall return `BLOB_ABORTED` even if a block still in flight then fails. ]*/
+                    if ((upload->isError == 0) && (upload->result != BLOB_ABORTED))
+                    {
+                        upload->isError = 1;
+                        upload->result = blockResult;
+                        if (blockResult == BLOB_OK)
+                        {
+                            const unsigned char* response = BUFFER_u_char(worker->httpResponse);
+                            size_t responseLength = BUFFER_length(worker->httpResponse);
+                            *upload->httpStatus = httpStatus;
+                            (void)BUFFER_build(upload->httpResponse, response, responseLength);
+                        }
+                    }
+                }
+            }
+        }
+        (void)Unlock(upload->lock);
+    }
+}
+
+static int BlobUploadWorker_Thread(void* threadArgument)
+{
+    upload_next_blocks((BLOB_UPLOAD_WORKER*)threadArgument);
+    ThreadAPI_Exit(0);
+    return 0;
+}
+
+/*the thread calling the upload PUTs blocks too, on httpApiExHandle, so up to parallelism - 1 threads are started*/
+static void upload_blocks_in_parallel(BLOB_PARALLEL_UPLOAD* upload, HTTPAPIEX_HANDLE httpApiExHandle, const char* hostname, const char* certificates, HTTP_PROXY_OPTIONS *proxyOptions, size_t parallelism)
+{
+    BLOB_UPLOAD_WORKER* workers;
+
+    /*Codes_SRS_BLOB_41_017: [ If `parallelism` is greater than `BLOB_UPLOAD_MAX_PARALLELISM`, `Blob_UploadMultipleBlocksInParallel` shall PUT up to `BLOB_UPLOAD_MAX_PARALLELISM` blocks at the same time. ]*/
+    if (parallelism > BLOB_UPLOAD_MAX_PARALLELISM)
+    {
+        LogInfo("uploading %lu blocks at a time instead of %lu", (unsigned long)BLOB_UPLOAD_MAX_PARALLELISM, (unsigned long)parallelism);
+        parallelism = BLOB_UPLOAD_MAX_PARALLELISM;
+    }
+
+    if ((upload->lock = Lock_Init()) == NULL)
+    {
+        /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_ERROR ]*/
+        LogError("Lock_Init failed");
+        upload->result = BLOB_ERROR;
+        upload->isError = 1;
+    }
+    else
+    {
+        if ((workers = (BLOB_UPLOAD_WORKER*)malloc(parallelism * sizeof(BLOB_UPLOAD_WORKER))) == NULL)
+        {
+            LogError("failed allocating %lu block upload workers", (unsigned long)parallelism);
+            upload->result = BLOB_ERROR;
+            upload->isError = 1;
+        }
+        else
+        {
+            size_t workerCount = 0;
+            size_t threadsStarted = 0;
+            size_t index;
+            int res;
+
+            /*Codes_SRS_BLOB_41_015: [ Every block upload worker but the calling thread shall have its own HTTPAPIEX_HANDLE to the storage host, created with the same options; if a worker cannot be created or started, the blocks shall be uploaded by the workers started before it. ]*/
+            while (workerCount < parallelism)
+            {
+                BLOB_UPLOAD_WORKER* worker = &workers[workerCount];
+                worker->upload = upload;
+                worker->httpApiExHandle = (workerCount == 0) ? httpApiExHandle : create_worker_connection(hostname, certificates, proxyOptions);
+                worker->blockIDList = NULL;
+                worker->httpResponse = NULL;
+
+                if ((worker->httpApiExHandle == NULL) ||
+                    ((worker->blockIDList = STRING_new()) == NULL) ||
+                    ((worker->httpResponse = BUFFER_new()) == NULL))
+                {
+                    LogError("failed creating block upload worker %lu", (unsigned long)workerCount);
+                    if (worker->blockIDList != NULL)
+                    {
+                        STRING_delete(worker->blockIDList);
+                    }
+                    if ((workerCount != 0) && (worker->httpApiExHandle != NULL))
+                    {
+                        HTTPAPIEX_Destroy(worker->httpApiExHandle);
+                    }
+                    break;
+                }
+                workerCount++;
+            }
+
+            while ((threadsStarted + 1 < workerCount) &&
+                (ThreadAPI_Create(&workers[threadsStarted + 1].thread, BlobUploadWorker_Thread, &workers[threadsStarted + 1]) == THREADAPI_OK))
+            {
+                threadsStarted++;
+            }
+
+            if (workerCount == 0)
+            {
+                upload->result = BLOB_ERROR;
+                upload->isError = 1;
+            }
+            else
+            {
+                if (threadsStarted + 1 < parallelism)
+                {
+                    LogInfo("uploading %lu blocks at a time instead of %lu", (unsigned long)(threadsStarted + 1), (unsigned long)parallelism);
+                }
+
+                /*Codes_SRS_BLOB_41_012: [ If `parallelism` is greater than 1, `Blob_UploadMultipleBlocksInParallel` shall PUT up to `parallelism` blocks at the same time and wait for all of them before putting the block list. ]*/
+                upload_next_blocks(&workers[0]);
+
+                for (index = 1; index <= threadsStarted; index++)
+                {
+                    if (ThreadAPI_Join(workers[index].thread, &res) != THREADAPI_OK)
+                    {
+                        LogError("ThreadAPI_Join failed for block upload worker thread");
+                    }
+                }
+
+                /*a worker stops only at the last block or at a failure, otherwise the block list would miss blocks*/
+                if ((upload->noMoreBlocks == 0) && (upload->isError == 0))
+                {
+                    LogError("block upload workers stopped before the last block");
+                    upload->result = BLOB_ERROR;
+                    upload->isError = 1;
+                }
+            }
+
+            for (index = 0; index < workerCount; index++)
+            {
+                BUFFER_delete(workers[index].httpResponse);
+                STRING_delete(workers[index].blockIDList);
+                if (index != 0)
+                {
+                    HTTPAPIEX_Destroy(workers[index].httpApiExHandle);
+                }
+            }
+            free(workers);
+        }
+        Lock_Deinit(upload->lock);
+    }
+}
+
+static BLOB_RESULT upload_multiple_blocks(BLOB_CONNECTION* connection, const char* SASURI, IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK_EX getDataCallbackEx, void* context, unsigned int* httpStatus, BUFFER_HANDLE httpResponse, const char* certificates, HTTP_PROXY_OPTIONS *proxyOptions, unsigned int committedBlockCount, size_t parallelism)
 {
     BLOB_RESULT result;
     /*Codes_SRS_BLOB_02_001: [ If SASURI is NULL then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_INVALID_ARG. ]*/
@@ -179,11 +546,18 @@ BLOB_RESULT Blob_UploadMultipleBlocksFromSasUri(const char* SASURI, IOTHUB_CLIEN
                     else
                     {
                         HTTPAPIEX_HANDLE httpApiExHandle;
+                        bool reused;
                         (void)memcpy(hostname, hostnameBegin, hostnameSize);
                         hostname[hostnameSize] = '\0';
 
-                        /*Codes_SRS_BLOB_02_018: [ Blob_UploadMultipleBlocksFromSasUri shall create a new HTTPAPI_EX_HANDLE by calling HTTPAPIEX_Create passing the hostname. ]*/
-                        httpApiExHandle = HTTPAPIEX_Create(hostname);
+                        httpApiExHandle = (connection == NULL) ? NULL : take_kept_connection(connection, hostname);
+                        reused = (httpApiExHandle != NULL);
+                        if (!reused)
+                        {
+                            /*Codes_SRS_BLOB_02_018: [ Blob_UploadMultipleBlocksFromSasUri shall create a new HTTPAPI_EX_HANDLE by calling HTTPAPIEX_Create passing the hostname. ]*/
+                            httpApiExHandle = HTTPAPIEX_Create(hostname);
+                        }
+
                         if (httpApiExHandle == NULL)
                         {
                             /*Codes_SRS_BLOB_02_007: [ If HTTPAPIEX_Create fails then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_ERROR. ]*/
@@ -192,12 +566,12 @@ BLOB_RESULT Blob_UploadMultipleBlocksFromSasUri(const char* SASURI, IOTHUB_CLIEN
                         }
                         else
                         {
-                            if ((certificates != NULL)&& (HTTPAPIEX_SetOption(httpApiExHandle, "TrustedCerts", certificates) == HTTPAPIEX_ERROR))
+                            if ((!reused) && (certificates != NULL)&& (HTTPAPIEX_SetOption(httpApiExHandle, "TrustedCerts", certificates) == HTTPAPIEX_ERROR))
                             {
                                 LogError("failure in setting trusted certificates");
                                 result = BLOB_ERROR;
                             }
-                            else if ((proxyOptions != NULL && proxyOptions->host_address != NULL) && HTTPAPIEX_SetOption(httpApiExHandle, OPTION_HTTP_PROXY, proxyOptions) == HTTPAPIEX_ERROR)
+                            else if ((!reused) && (proxyOptions != NULL && proxyOptions->host_address != NULL) && HTTPAPIEX_SetOption(httpApiExHandle, OPTION_HTTP_PROXY, proxyOptions) == HTTPAPIEX_ERROR)
                             {
                                 LogError("failure in setting proxy options");
                                 result = BLOB_ERROR;
@@ -218,14 +592,50 @@ BLOB_RESULT Blob_UploadMultipleBlocksFromSasUri(const char* SASURI, IOTHUB_CLIEN
                                 else
                                 {
                                     /*Codes_SRS_BLOB_02_021: [ For every block returned by `getDataCallbackEx` the following operations shall happen: ]*/
-                                    unsigned int blockID = 0; /* incremented for each new block */
+                                    unsigned int blockID = committedBlockCount; /* incremented for each new block */
                                     unsigned int isError = 0; /* set to 1 if a block upload fails or if getDataCallbackEx returns incorrect blocks to upload */
                                     unsigned int uploadOneMoreBlock = 1; /* set to 1 while getDataCallbackEx returns correct blocks to upload */
                                     unsigned char const * source; /* data set by getDataCallbackEx */
                                     size_t size; /* source size set by getDataCallbackEx */
                                     IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_RESULT getDataReturnValue;
 
-                                    do
+                                    /*Codes_SRS_BLOB_41_003: [ `Blob_ResumeMultipleBlocksFromSasUri` shall add the BASE64 encoded IDs of the first `committedBlockCount` blocks to the XML block list before any new block; if that fails it shall fail and return `BLOB_ERROR`. ]*/
+                                    if (add_block_ids(blockIDList, 0, committedBlockCount) != 0)
+                                    {
+                                        /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_ERROR ]*/
+                                        LogError("unable to add the committed block IDs");
+                                        result = BLOB_ERROR;
+                                        isError = 1;
+                                    }
+                                    else if (parallelism > 1)
+                                    {
+                                        BLOB_PARALLEL_UPLOAD upload;
+                                        upload.relativePath = relativePath;
+                                        upload.getDataCallbackEx = getDataCallbackEx;
+                                        upload.context = context;
+                                        upload.nextBlockID = committedBlockCount;
+                                        upload.noMoreBlocks = 0;
+                                        upload.isError = 0;
+                                        upload.result = BLOB_OK;
+                                        upload.httpStatus = httpStatus;
+                                        upload.httpResponse = httpResponse;
+
+                                        upload_blocks_in_parallel(&upload, httpApiExHandle, hostname, certificates, proxyOptions, parallelism);
+                                        result = upload.result;
+                                        isError = upload.isError;
+                                        uploadOneMoreBlock = 0;
+
+                                        /*Codes_SRS_BLOB_41_016: [ Once every block was acknowledged, `Blob_UploadMultipleBlocksInParallel` shall add the BASE64 encoded IDs of the new blocks to the XML block list in block order, whatever the order storage acknowledged them in. ]*/
+                                        if ((isError == 0) && (result == BLOB_OK) && (add_block_ids(blockIDList, committedBlockCount, upload.nextBlockID) != 0))
+                                        {
+                                            /*Codes_SRS_BLOB_02_033: [ If any previous operation that doesn't have an explicit failure description fails then Blob_UploadMultipleBlocksFromSasUri shall fail and return BLOB_ERROR ]*/
+                                            LogError("unable to add the block IDs");
+                                            result = BLOB_ERROR;
+                                            isError = 1;
+                                        }
+                                    }
+
+                                    while (uploadOneMoreBlock && !isError)
                                     {
                                         getDataReturnValue = getDataCallbackEx(FILE_UPLOAD_OK, &source, &size, context);
                                         if (getDataReturnValue == IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_ABORT)
@@ -292,7 +702,6 @@ BLOB_RESULT Blob_UploadMultipleBlocksFromSasUri(const char* SASURI, IOTHUB_CLIEN
                                             blockID++;
                                         }
                                     }
-                                    while(uploadOneMoreBlock && !isError);
 
                                     if (isError || result != BLOB_OK)
                                     {
@@ -369,9 +778,23 @@ BLOB_RESULT Blob_UploadMultipleBlocksFromSasUri(const char* SASURI, IOTHUB_CLIEN
                                 }
 
                             }
-                            HTTPAPIEX_Destroy(httpApiExHandle);
+
+                            if ((connection != NULL) && ((result == BLOB_OK) || (result == BLOB_ABORTED)))
+                            {
+                                /*Codes_SRS_BLOB_41_008: [ Unless the upload failed, `Blob_UploadMultipleBlocksOnConnection` shall keep the HTTPAPIEX_HANDLE in `connection` instead of destroying it. ]*/
+                                keep_connection(connection, httpApiExHandle, hostname);
+                                hostname = NULL;
+                            }
+                            else
+                            {
+                                HTTPAPIEX_Destroy(httpApiExHandle);
+                            }
+                        }
+
+                        if (hostname != NULL) /*NULL once connection keeps it*/
+                        {
+                            free(hostname);
                         }
-                        free(hostname);
                     }
                 }
             }
@@ -379,3 +802,91 @@ BLOB_RESULT Blob_UploadMultipleBlocksFromSasUri(const char* SASURI, IOTHUB_CLIEN
     }
     return result;
 }
+
+BLOB_RESULT Blob_UploadMultipleBlocksFromSasUri(const char* SASURI, IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK_EX getDataCallbackEx, void* context, unsigned int* httpStatus, BUFFER_HANDLE httpResponse, const char* certificates, HTTP_PROXY_OPTIONS *proxyOptions)
+{
+    return upload_multiple_blocks(NULL, SASURI, getDataCallbackEx, context, httpStatus, httpResponse, certificates, proxyOptions, 0, 1);
+}
+
+BLOB_RESULT Blob_ResumeMultipleBlocksFromSasUri(const char* SASURI, IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK_EX getDataCallbackEx, void* context, unsigned int* httpStatus, BUFFER_HANDLE httpResponse, const char* certificates, HTTP_PROXY_OPTIONS *proxyOptions, unsigned int committedBlockCount)
+{
+    BLOB_RESULT result;
+    /*Codes_SRS_BLOB_41_002: [ If `committedBlockCount` is greater than `MAX_BLOCK_COUNT` then `Blob_ResumeMultipleBlocksFromSasUri` shall fail and return `BLOB_INVALID_ARG`. ]*/
+    if (committedBlockCount > MAX_BLOCK_COUNT)
+    {
+        LogError("unable to resume after %u blocks, at most %lu blocks fit in one blob", committedBlockCount, (unsigned long)MAX_BLOCK_COUNT);
+        result = BLOB_INVALID_ARG;
+    }
+    else
+    {
+        /*Codes_SRS_BLOB_41_004: [ Otherwise `Blob_ResumeMultipleBlocksFromSasUri` shall behave as `Blob_UploadMultipleBlocksFromSasUri`, numbering the first block it asks `getDataCallbackEx` for `committedBlockCount`. ]*/
+        result = upload_multiple_blocks(NULL, SASURI, getDataCallbackEx, context, httpStatus, httpResponse, certificates, proxyOptions, committedBlockCount, 1);
+    }
+    return result;
+}
+
+BLOB_CONNECTION_HANDLE Blob_Connection_Create(size_t idleTimeoutSecs)
+{
+    BLOB_CONNECTION* result;
+
+    /*Codes_SRS_BLOB_41_005: [ `Blob_Connection_Create` shall allocate a connection that keeps no HTTPAPIEX_HANDLE yet, or return NULL if that fails. ]*/
+    if ((result = (BLOB_CONNECTION*)malloc(sizeof(BLOB_CONNECTION))) == NULL)
+    {
+        LogError("unable to allocate the blob connection");
+    }
+    else
+    {
+        result->idleTimeoutSecs = idleTimeoutSecs;
+        result->hostname = NULL;
+        result->httpApiExHandle = NULL;
+        result->lastUsed = (time_t)-1;
+    }
+
+    return result;
+}
+
+void Blob_Connection_Destroy(BLOB_CONNECTION_HANDLE connection)
+{
+    if (connection != NULL)
+    {
+        /*Codes_SRS_BLOB_41_009: [ `Blob_Connection_Destroy` shall destroy the kept HTTPAPIEX_HANDLE, if any, and free `connection`. ]*/
+        if (connection->httpApiExHandle != NULL)
+        {
+            HTTPAPIEX_Destroy(connection->httpApiExHandle);
+        }
+        free(connection->hostname);
+        free(connection);
+    }
+}
+
+BLOB_RESULT Blob_UploadMultipleBlocksOnConnection(BLOB_CONNECTION_HANDLE connection, const char* SASURI, IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK_EX getDataCallbackEx, void* context, unsigned int* httpStatus, BUFFER_HANDLE httpResponse, const char* certificates, HTTP_PROXY_OPTIONS *proxyOptions, unsigned int committedBlockCount)
+{
+    BLOB_RESULT result;
+    /*Codes_SRS_BLOB_41_010: [ If `connection` is NULL or `committedBlockCount` is greater than `MAX_BLOCK_COUNT` then `Blob_UploadMultipleBlocksOnConnection` shall fail and return `BLOB_INVALID_ARG`. ]*/
+    if ((connection == NULL) || (committedBlockCount > MAX_BLOCK_COUNT))
+    {
+        LogError("invalid argument connection=%p, committedBlockCount=%u", connection, committedBlockCount);
+        result = BLOB_INVALID_ARG;
+    }
+    else
+    {
+        result = upload_multiple_blocks(connection, SASURI, getDataCallbackEx, context, httpStatus, httpResponse, certificates, proxyOptions, committedBlockCount, 1);
+    }
+    return result;
+}
+
+BLOB_RESULT Blob_UploadMultipleBlocksInParallel(BLOB_CONNECTION_HANDLE connection, const char* SASURI, IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK_EX getDataCallbackEx, void* context, unsigned int* httpStatus, BUFFER_HANDLE httpResponse, const char* certificates, HTTP_PROXY_OPTIONS *proxyOptions, unsigned int committedBlockCount, size_t parallelism)
+{
+    BLOB_RESULT result;
+    /*Codes_SRS_BLOB_41_011: [ If `committedBlockCount` is greater than `MAX_BLOCK_COUNT` then `Blob_UploadMultipleBlocksInParallel` shall fail and return `BLOB_INVALID_ARG`. ]*/
+    if (committedBlockCount > MAX_BLOCK_COUNT)
+    {
+        LogError("unable to resume after %u blocks, at most %lu blocks fit in one blob", committedBlockCount, (unsigned long)MAX_BLOCK_COUNT);
+        result = BLOB_INVALID_ARG;
+    }
+    else
+    {
+        result = upload_multiple_blocks(connection, SASURI, getDataCallbackEx, context, httpStatus, httpResponse, certificates, proxyOptions, committedBlockCount, parallelism);
+    }
+    return result;
+}
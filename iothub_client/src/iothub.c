@@ -7,6 +7,8 @@
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/macro_utils.h"
 #include "iothub.h"
+#include "internal/iothub_client_memory_private.h"
+#include "internal/iothub_client_trust_store.h"
 
 int IoTHub_Init(void)
 {
@@ -16,6 +18,19 @@ int IoTHub_Init(void)
         LogError("Platform initialization failed");
         result = __FAILURE__;
     }
+    else if (IoTHubClient_Memory_Init() != 0)
+    {
+        LogError("Memory accounting initialization failed");
+        platform_deinit();
+        result = __FAILURE__;
+    }
+    else if (trust_store_init() != 0)
+    {
+        LogError("Trust store initialization failed");
+        IoTHubClient_Memory_Deinit();
+        platform_deinit();
+        result = __FAILURE__;
+    }
     else
     {
         result = 0;
@@ -25,5 +40,7 @@ int IoTHub_Init(void)
 
 void IoTHub_Deinit(void)
 {
+    trust_store_deinit();
+    IoTHubClient_Memory_Deinit();
     platform_deinit();
 }
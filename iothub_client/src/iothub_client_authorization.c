@@ -2,6 +2,8 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
 #include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/macro_utils.h"
 #include "azure_c_shared_utility/umock_c_prod.h"
@@ -10,6 +12,10 @@
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/strings.h"
 #include "azure_c_shared_utility/sastoken.h"
+#include "azure_c_shared_utility/base64.h"
+#include "azure_c_shared_utility/buffer_.h"
+#include "azure_c_shared_utility/urlencode.h"
+#include "azure_c_shared_utility/sha.h"
 #include "azure_c_shared_utility/shared_util_options.h"
 
 #ifdef USE_PROV_MODULE
@@ -17,9 +23,13 @@
 #endif
 
 #include "internal/iothub_client_authorization.h"
+#include "internal/iothub_client_trust_store.h"
 
 #define DEFAULT_SAS_TOKEN_EXPIRY_TIME_SECS          3600
 #define INDEFINITE_TIME                             ((time_t)(-1))
+#define SAS_TOKEN_FORMAT                            "SharedAccessSignature sr=%s&sig=%s&se=%s"
+#define SAS_TOKEN_KEY_NAME_FORMAT                   "&skn=%s"
+#define DEVICE_AUTH_TOKEN_REUSE_DIVISOR             10
 
 typedef struct IOTHUB_AUTHORIZATION_DATA_TAG
 {
@@ -31,7 +41,15 @@ typedef struct IOTHUB_AUTHORIZATION_DATA_TAG
     IOTHUB_CREDENTIAL_TYPE cred_type;
 #ifdef USE_PROV_MODULE
     IOTHUB_SECURITY_HANDLE device_auth_handle;
+    char* device_auth_token;                /*last token signed by the HSM, followed in the same allocation by its scope and key name*/
+    const char* device_auth_token_scope;
+    const char* device_auth_token_key_name;
+    size_t device_auth_token_expiry;
 #endif
+    bool is_key_schedule_set;
+    HMACContext key_schedule;       /*HMAC-SHA256 state once the decoded device key pads are hashed*/
+    char* signed_scope;             /*scope hashed into scope_schedule, NULL until the first SAS token*/
+    HMACContext scope_schedule;     /*key_schedule once signed_scope and the newline are hashed*/
 } IOTHUB_AUTHORIZATION_DATA;
 
 static int get_seconds_since_epoch(size_t* seconds)
@@ -51,6 +69,182 @@ static int get_seconds_since_epoch(size_t* seconds)
     return result;
 }
 
+static int set_key_schedule(IOTHUB_AUTHORIZATION_DATA* handle)
+{
+    int result;
+    BUFFER_HANDLE decoded_key;
+
+    if ((decoded_key = Base64_Decoder(handle->device_key)) == NULL)
+    {
+        LogError("Failed decoding the device key");
+        result = __FAILURE__;
+    }
+    else
+    {
+        if (hmacReset(&handle->key_schedule, SHA256, BUFFER_u_char(decoded_key), (int)BUFFER_length(decoded_key)) != shaSuccess)
+        {
+            LogError("Failed computing the device key pads");
+            result = __FAILURE__;
+        }
+        else
+        {
+            handle->is_key_schedule_set = true;
+            result = 0;
+        }
+        BUFFER_delete(decoded_key);
+    }
+
+    return result;
+}
+
+static int set_scope_schedule(IOTHUB_AUTHORIZATION_DATA* handle, const char* scope)
+{
+    int result;
+    char* signed_scope;
+
+    if (mallocAndStrcpy_s(&signed_scope, scope) != 0)
+    {
+        LogError("Failed copying the sas token scope");
+        result = __FAILURE__;
+    }
+    else
+    {
+        handle->scope_schedule = handle->key_schedule;
+        if ((hmacInput(&handle->scope_schedule, (const unsigned char*)scope, (int)strlen(scope)) != shaSuccess) ||
+            (hmacInput(&handle->scope_schedule, (const unsigned char*)"\n", 1) != shaSuccess))
+        {
+            LogError("Failed hashing the sas token scope");
+            free(signed_scope);
+            free(handle->signed_scope);
+            handle->signed_scope = NULL;
+            result = __FAILURE__;
+        }
+        else
+        {
+            free(handle->signed_scope);
+            handle->signed_scope = signed_scope;
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+static char* create_sas_token(IOTHUB_AUTHORIZATION_DATA* handle, const char* scope, const char* key_name, size_t expiry_time)
+{
+    char* result;
+    char expiry_string[32];
+    uint8_t signature[USHAMaxHashSize];
+    HMACContext signature_context;
+    STRING_HANDLE base64_signature;
+
+    /* Codes_SRS_IoTHub_Authorization_41_001: [ IoTHubClient_Auth_Get_SasToken shall decode the device key and compute its HMAC-SHA256 pads only once per handle. ] */
+    if (!handle->is_key_schedule_set && set_key_schedule(handle) != 0)
+    {
+        result = NULL;
+    }
+    /* Codes_SRS_IoTHub_Authorization_41_002: [ IoTHubClient_Auth_Get_SasToken shall only hash scope again when it differs from the scope of the previous sas token. ] */
+    else if ((handle->signed_scope == NULL || strcmp(handle->signed_scope, scope) != 0) && set_scope_schedule(handle, scope) != 0)
+    {
+        result = NULL;
+    }
+    else
+    {
+        (void)snprintf(expiry_string, sizeof(expiry_string), "%lu", (unsigned long)expiry_time);
+
+        /* Codes_SRS_IoTHub_Authorization_41_003: [ The signature shall be the HMAC-SHA256 of scope, a newline and the expiry time, base64 and then URL encoded. ] */
+        signature_context = handle->scope_schedule;
+        if ((hmacInput(&signature_context, (const unsigned char*)expiry_string, (int)strlen(expiry_string)) != shaSuccess) ||
+            (hmacResult(&signature_context, signature) != shaSuccess))
+        {
+            LogError("Failed computing the sas token signature");
+            result = NULL;
+        }
+        else if ((base64_signature = Base64_Encode_Bytes(signature, SHA256HashSize)) == NULL)
+        {
+            LogError("Failed encoding the sas token signature");
+            result = NULL;
+        }
+        else
+        {
+            STRING_HANDLE encoded_signature;
+
+            if ((encoded_signature = URL_Encode(base64_signature)) == NULL)
+            {
+                LogError("Failed URL encoding the sas token signature");
+                result = NULL;
+            }
+            else
+            {
+                const char* signature_string = STRING_c_str(encoded_signature);
+                size_t key_name_length = (key_name == NULL) ? 0 : strlen(key_name);
+                size_t length = strlen(SAS_TOKEN_FORMAT) + strlen(scope) + strlen(signature_string) + strlen(expiry_string) +
+                    ((key_name_length > 0) ? strlen(SAS_TOKEN_KEY_NAME_FORMAT) + key_name_length : 0) + 1;
+
+                if ((result = (char*)malloc(length)) == NULL)
+                {
+                    LogError("Failed allocating the sas token");
+                }
+                else
+                {
+                    /* Codes_SRS_IoTHub_Authorization_41_004: [ The sas token shall be "SharedAccessSignature sr=<scope>&sig=<signature>&se=<expiry time>", followed by "&skn=<key_name>" if key_name is not empty. ] */
+                    int written = snprintf(result, length, SAS_TOKEN_FORMAT, scope, signature_string, expiry_string);
+                    if (key_name_length > 0 && written > 0)
+                    {
+                        (void)snprintf(result + written, length - written, SAS_TOKEN_KEY_NAME_FORMAT, key_name);
+                    }
+                }
+                STRING_delete(encoded_signature);
+            }
+            STRING_delete(base64_signature);
+        }
+    }
+
+    return result;
+}
+
+#ifdef USE_PROV_MODULE
+static bool is_device_auth_token_reusable(const IOTHUB_AUTHORIZATION_DATA* handle, const char* scope, const char* key_name, size_t sec_since_epoch)
+{
+    /* A token signed less than a tenth of its lifetime ago still outlives the transport refresh, which comes at 80% of the lifetime at most */
+    return (handle->device_auth_token != NULL) &&
+        (strcmp(handle->device_auth_token_scope, scope) == 0) &&
+        (strcmp(handle->device_auth_token_key_name, (key_name == NULL) ? "" : key_name) == 0) &&
+        (handle->device_auth_token_expiry >= sec_since_epoch + handle->token_expiry_time_sec - handle->token_expiry_time_sec / DEVICE_AUTH_TOKEN_REUSE_DIVISOR);
+}
+
+static void store_device_auth_token(IOTHUB_AUTHORIZATION_DATA* handle, const char* scope, const char* key_name, const char* sas_token, size_t expiry_time)
+{
+    size_t sas_token_size = strlen(sas_token) + 1;
+    size_t scope_size = strlen(scope) + 1;
+    size_t key_name_size = ((key_name == NULL) ? 0 : strlen(key_name)) + 1;
+    char* stored_token = (char*)malloc(sas_token_size + scope_size + key_name_size);
+
+    if (stored_token == NULL)
+    {
+        LogError("Failed caching the sas token, the next one will be signed again");
+    }
+    else
+    {
+        char* stored_scope = stored_token + sas_token_size;
+        char* stored_key_name = stored_scope + scope_size;
+
+        (void)memcpy(stored_token, sas_token, sas_token_size);
+        (void)memcpy(stored_scope, scope, scope_size);
+        (void)memcpy(stored_key_name, (key_name == NULL) ? "" : key_name, key_name_size);
+        handle->device_auth_token_scope = stored_scope;
+        handle->device_auth_token_key_name = stored_key_name;
+        handle->device_auth_token_expiry = expiry_time;
+    }
+
+    if (handle->device_auth_token != NULL)
+    {
+        free(handle->device_auth_token);
+    }
+    handle->device_auth_token = stored_token;
+}
+#endif
+
 IOTHUB_AUTHORIZATION_HANDLE IoTHubClient_Auth_Create(const char* device_key, const char* device_id, const char* device_sas_token, const char *module_id)
 {
     IOTHUB_AUTHORIZATION_DATA* result;
@@ -179,6 +373,7 @@ IOTHUB_AUTHORIZATION_HANDLE IoTHubClient_Auth_CreateFromDeviceAuth(const char* d
             else
             {
                 DEVICE_AUTH_TYPE auth_type = iothub_device_auth_get_type(result->device_auth_handle);
+                result->token_expiry_time_sec = DEFAULT_SAS_TOKEN_EXPIRY_TIME_SECS;
                 if (auth_type == AUTH_TYPE_SAS || auth_type == AUTH_TYPE_SYMM_KEY)
                 {
                     result->cred_type = IOTHUB_CREDENTIAL_TYPE_DEVICE_AUTH;
@@ -206,11 +401,13 @@ void IoTHubClient_Auth_Destroy(IOTHUB_AUTHORIZATION_HANDLE handle)
         /* Codes_SRS_IoTHub_Authorization_07_006: [ IoTHubClient_Auth_Destroy shall free all resources associated with the IOTHUB_AUTHORIZATION_HANDLE handle. ] */
 #ifdef USE_PROV_MODULE
         iothub_device_auth_destroy(handle->device_auth_handle);
+        free(handle->device_auth_token);
 #endif
         free(handle->device_key);
         free(handle->device_id);
         free(handle->module_id);
         free(handle->device_sas_token);
+        free(handle->signed_scope);
         free(handle);
     }
 }
@@ -384,6 +581,15 @@ char* IoTHubClient_Auth_Get_SasToken(IOTHUB_AUTHORIZATION_HANDLE handle, const c
                 LogError("failure getting seconds from epoch");
                 result = NULL;
             }
+            /* Codes_SRS_IoTHub_Authorization_41_005: [ For a device auth handle, IoTHubClient_Auth_Get_SasToken shall return a copy of the previous sas token, without calling the HSM, when scope and key_name are the same and the token was signed less than a tenth of the token lifetime ago. ] */
+            else if ((scope != NULL) && is_device_auth_token_reusable(handle, scope, key_name, sec_since_epoch))
+            {
+                if (mallocAndStrcpy_s(&result, handle->device_auth_token) != 0)
+                {
+                    LogError("failure allocating Sas Token");
+                    result = NULL;
+                }
+            }
             else
             {
                 memset(&dev_auth_cred, 0, sizeof(DEVICE_AUTH_CREDENTIAL_INFO));
@@ -406,6 +612,11 @@ char* IoTHubClient_Auth_Get_SasToken(IOTHUB_AUTHORIZATION_HANDLE handle, const c
                         LogError("failure allocating Sas Token");
                         result = NULL;
                     }
+                    else if (scope != NULL)
+                    {
+                        /* Codes_SRS_IoTHub_Authorization_41_006: [ IoTHubClient_Auth_Get_SasToken shall keep the last sas token signed by the HSM with its scope, key_name and expiry time; failing to keep it shall not fail the call. ] */
+                        store_device_auth_token(handle, scope, key_name, result, expiry_time);
+                    }
                     free(cred_result);
                 }
             }
@@ -441,7 +652,6 @@ char* IoTHubClient_Auth_Get_SasToken(IOTHUB_AUTHORIZATION_HANDLE handle, const c
             }
             else
             {
-                STRING_HANDLE sas_token;
                 size_t sec_since_epoch;
 
                 /* Codes_SRS_IoTHub_Authorization_07_010: [ IoTHubClient_Auth_Get_SasToken` shall construct the expiration time using the handle->token_expiry_time_sec added to epoch time. ] */
@@ -454,23 +664,12 @@ char* IoTHubClient_Auth_Get_SasToken(IOTHUB_AUTHORIZATION_HANDLE handle, const c
                 else
                 {
                     /* Codes_SRS_IoTHub_Authorization_07_011: [ IoTHubClient_Auth_Get_ConnString shall call SASToken_CreateString to construct the sas token. ] */
+                    /* Codes_SRS_IoTHub_Authorization_07_012: [ On success IoTHubClient_Auth_Get_ConnString shall allocate and return the sas token in a char*. ] */
                     size_t expiry_time = sec_since_epoch + handle->token_expiry_time_sec;
-                    if ( (sas_token = SASToken_CreateString(handle->device_key, scope, key_name, expiry_time)) == NULL)
+                    if ((result = create_sas_token(handle, scope, key_name, expiry_time)) == NULL)
                     {
                         /* Codes_SRS_IoTHub_Authorization_07_020: [ If any error is encountered IoTHubClient_Auth_Get_ConnString shall return NULL. ] */
                         LogError("Failed creating sas_token");
-                        result = NULL;
-                    }
-                    else
-                    {
-                        /* Codes_SRS_IoTHub_Authorization_07_012: [ On success IoTHubClient_Auth_Get_ConnString shall allocate and return the sas token in a char*. ] */
-                        if (mallocAndStrcpy_s(&result, STRING_c_str(sas_token) ) != 0)
-                        {
-                            /* Codes_SRS_IoTHub_Authorization_07_020: [ If any error is encountered IoTHubClient_Auth_Get_ConnString shall return NULL. ] */
-                            LogError("Failed copying result");
-                            result = NULL;
-                        }
-                        STRING_delete(sas_token);
                     }
                 }
             }
@@ -588,78 +787,41 @@ SAS_TOKEN_STATUS IoTHubClient_Auth_Is_SasToken_Valid(IOTHUB_AUTHORIZATION_HANDLE
 
 #ifdef USE_EDGE_MODULES
 
-// For debugging C modules, the environment can set the environment variable 'EdgeModuleCACertificateFile' to provide
-// trusted certificates.  We'd otherwise usually get these from trusted Edge service, but this complicates debugging experience.
-// EdgeModuleCACertificateFile and the related EdgeHubConnectionString can be set either manually or by tooling (e.g. VS Code).
-static char* read_ca_certificate_from_file(const char* certificate_file_name)
+// IoTHubClient_Auth_Get_TrustBundle retrieves a trust bundle - namely a PEM indicating the certificates the client should
+// trust as root authorities - to caller.  If certificate_file_name, we read this from a local file.  This should in general
+// be limited only to debugging modules on Edge.  If certificate_file_name is NULL, we invoke into the underlying 
+// HSM to retrieve this.
+char* IoTHubClient_Auth_Get_TrustBundle(IOTHUB_AUTHORIZATION_HANDLE handle, const char* certificate_file_name)
 {
     char* result;
-    FILE *file_stream = NULL;
-
-    if ((file_stream = fopen(certificate_file_name, "r")) == NULL)
-    {
-        LogError("Cannot read file %s, errno=%d", certificate_file_name, errno);
-        result = NULL;
-    }
-    else if (fseek(file_stream, 0, SEEK_END) != 0)
+    if (handle == NULL)
     {
-        LogError("fseek on file %s fails, errno=%d", certificate_file_name, errno);
+        LogError("Security Handle is NULL");
         result = NULL;
     }
-    else 
+    else if (certificate_file_name != NULL)
     {
-        long int file_size = ftell(file_stream);
-        if (file_size < 0)
-        {
-            LogError("ftell fails reading %s, errno=%d",  certificate_file_name, errno);
-            result = NULL;
-        }
-        else if (file_size == 0)
+        // For debugging C modules, the environment can set the environment variable 'EdgeModuleCACertificateFile' to provide
+        // trusted certificates.  We'd otherwise usually get these from trusted Edge service, but this complicates debugging experience.
+        // EdgeModuleCACertificateFile and the related EdgeHubConnectionString can be set either manually or by tooling (e.g. VS Code).
+        // The trust store reads the file once for all the modules of the process.
+        const char* certificates = trust_store_acquire_file(certificate_file_name);
+
+        if (certificates == NULL)
         {
-            LogError("file %s is 0 bytes, which is not valid certificate",  certificate_file_name);
+            LogError("Failed reading trusted certificates from %s", certificate_file_name);
             result = NULL;
         }
         else
         {
-            rewind(file_stream);
-
-            if ((result = calloc(1, file_size + 1)) == NULL)
+            if (mallocAndStrcpy_s(&result, certificates) != 0)
             {
-                LogError("Cannot allocate %lu bytes", (unsigned long)file_size);
-            }
-            else if ((fread(result, 1, file_size, file_stream) == 0) || (ferror(file_stream) != 0))
-            {
-                LogError("fread failed on file %s, errno=%d", certificate_file_name, errno);
-                free(result);
+                LogError("Failed copying trusted certificates of %s", certificate_file_name);
                 result = NULL;
             }
+            trust_store_release(certificates);
         }
     }
-
-    if (file_stream != NULL)
-    {
-        fclose(file_stream);
-    }
-
-    return result;
-}
-
-// IoTHubClient_Auth_Get_TrustBundle retrieves a trust bundle - namely a PEM indicating the certificates the client should
-// trust as root authorities - to caller.  If certificate_file_name, we read this from a local file.  This should in general
-// be limited only to debugging modules on Edge.  If certificate_file_name is NULL, we invoke into the underlying 
-// HSM to retrieve this.
-char* IoTHubClient_Auth_Get_TrustBundle(IOTHUB_AUTHORIZATION_HANDLE handle, const char* certificate_file_name)
-{
-    char* result;
-    if (handle == NULL)
-    {
-        LogError("Security Handle is NULL");
-        result = NULL;
-    }
-    else if (certificate_file_name != NULL)
-    {
-        result = read_ca_certificate_from_file(certificate_file_name);
-    }
     else
     {
         result = iothub_device_auth_get_trust_bundle(handle->device_auth_handle);
@@ -679,6 +841,14 @@ int IoTHubClient_Auth_Set_SasToken_Expiry(IOTHUB_AUTHORIZATION_HANDLE handle, si
     else
     {
         handle->token_expiry_time_sec = expiry_time_seconds;
+#ifdef USE_PROV_MODULE
+        /* Codes_SRS_IoTHub_Authorization_41_007: [ IoTHubClient_Auth_Set_SasToken_Expiry shall drop the kept sas token so that the next one is signed with the new lifetime. ] */
+        if (handle->device_auth_token != NULL)
+        {
+            free(handle->device_auth_token);
+            handle->device_auth_token = NULL;
+        }
+#endif
         result = 0;
     }
     return result;
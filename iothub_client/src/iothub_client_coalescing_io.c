@@ -0,0 +1,603 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/xio.h"
+#include "azure_c_shared_utility/optionhandler.h"
+#include "azure_c_shared_utility/singlylinkedlist.h"
+
+#include "iothub_client_options.h"
+#include "internal/iothub_client_coalescing_io.h"
+
+#define RESULT_OK 0
+#define INITIAL_PENDING_WRITE_COUNT 4
+
+static const char* COALESCING_IO_OPTION_UNDERLYING_OPTIONS = "coalescing_io_underlying_options";
+
+typedef struct PENDING_WRITE_TAG
+{
+    ON_SEND_COMPLETE on_send_complete;
+    void* callback_context;
+} PENDING_WRITE;
+
+typedef struct COALESCED_FRAME_TAG
+{
+    SINGLYLINKEDLIST_HANDLE frames_in_flight;
+    LIST_ITEM_HANDLE list_item;
+    PENDING_WRITE* writes;
+    size_t write_count;
+} COALESCED_FRAME;
+
+typedef struct COALESCING_IO_INSTANCE_TAG
+{
+    XIO_HANDLE underlying_io;
+    bool is_open;
+    ON_IO_OPEN_COMPLETE on_io_open_complete;
+    void* on_io_open_complete_context;
+    ON_IO_ERROR on_io_error;
+    void* on_io_error_context;
+    size_t max_frame_size;
+    // Bytes of the writes waiting for the next frame, and their callbacks.
+    unsigned char* frame_bytes;
+    size_t frame_size;
+    PENDING_WRITE* frame_writes;
+    size_t frame_write_count;
+    size_t frame_write_capacity;
+    // COALESCED_FRAME* handed to underlying_io and not completed yet.
+    SINGLYLINKEDLIST_HANDLE frames_in_flight;
+} COALESCING_IO_INSTANCE;
+
+static void complete_writes(PENDING_WRITE* writes, size_t write_count, IO_SEND_RESULT send_result)
+{
+    size_t i;
+
+    for (i = 0; i < write_count; i++)
+    {
+        if (writes[i].on_send_complete != NULL)
+        {
+            writes[i].on_send_complete(writes[i].callback_context, send_result);
+        }
+    }
+
+    free(writes);
+}
+
+static void complete_buffered_writes(COALESCING_IO_INSTANCE* coalescing_io, IO_SEND_RESULT send_result)
+{
+    PENDING_WRITE* writes = coalescing_io->frame_writes;
+    size_t write_count = coalescing_io->frame_write_count;
+
+    coalescing_io->frame_writes = NULL;
+    coalescing_io->frame_write_count = 0;
+    coalescing_io->frame_write_capacity = 0;
+    coalescing_io->frame_size = 0;
+
+    complete_writes(writes, write_count, send_result);
+}
+
+static void on_frame_send_complete(void* context, IO_SEND_RESULT send_result)
+{
+    COALESCED_FRAME* frame = (COALESCED_FRAME*)context;
+
+    /* Codes_SRS_IOTHUB_CLIENT_COALESCING_IO_41_020: [ When the send of a frame completes, the `on_send_complete` of each of its writes shall be called with the send result, in the order they were written. ]*/
+    (void)singlylinkedlist_remove(frame->frames_in_flight, frame->list_item);
+    complete_writes(frame->writes, frame->write_count, send_result);
+    free(frame);
+}
+
+static int send_frame(COALESCING_IO_INSTANCE* coalescing_io)
+{
+    int result;
+
+    if (coalescing_io->frame_write_count == 0)
+    {
+        result = RESULT_OK;
+    }
+    else
+    {
+        COALESCED_FRAME* frame;
+
+        if ((frame = (COALESCED_FRAME*)malloc(sizeof(COALESCED_FRAME))) == NULL)
+        {
+            /* Codes_SRS_IOTHUB_CLIENT_COALESCING_IO_41_019: [ If the frame cannot be sent, the `on_send_complete` of each of its writes shall be called with `IO_SEND_ERROR`. ]*/
+            LogError("Cannot allocate a coalesced frame of %lu writes", (unsigned long)coalescing_io->frame_write_count);
+            complete_buffered_writes(coalescing_io, IO_SEND_ERROR);
+            result = __FAILURE__;
+        }
+        else
+        {
+            size_t frame_size = coalescing_io->frame_size;
+
+            frame->frames_in_flight = coalescing_io->frames_in_flight;
+            frame->writes = coalescing_io->frame_writes;
+            frame->write_count = coalescing_io->frame_write_count;
+
+            coalescing_io->frame_writes = NULL;
+            coalescing_io->frame_write_count = 0;
+            coalescing_io->frame_write_capacity = 0;
+            coalescing_io->frame_size = 0;
+
+            // The frame is in the list before xio_send, which may complete it before returning.
+            if ((frame->list_item = singlylinkedlist_add(coalescing_io->frames_in_flight, frame)) == NULL)
+            {
+                LogError("Cannot track a coalesced frame of %lu writes", (unsigned long)frame->write_count);
+                complete_writes(frame->writes, frame->write_count, IO_SEND_ERROR);
+                free(frame);
+                result = __FAILURE__;
+            }
+            /* Codes_SRS_IOTHUB_CLIENT_COALESCING_IO_41_018: [ Sending the frame shall call `xio_send` on the underlying IO with the bytes of all the writes buffered, in the order they were written. ]*/
+            else if (xio_send(coalescing_io->underlying_io, coalescing_io->frame_bytes, frame_size, on_frame_send_complete, frame) != 0)
+            {
+                LogError("Cannot send a coalesced frame of %lu bytes", (unsigned long)frame_size);
+                (void)singlylinkedlist_remove(coalescing_io->frames_in_flight, frame->list_item);
+                complete_writes(frame->writes, frame->write_count, IO_SEND_ERROR);
+                free(frame);
+                result = __FAILURE__;
+            }
+            else
+            {
+                result = RESULT_OK;
+            }
+        }
+    }
+
+    return result;
+}
+
+static int buffer_write(COALESCING_IO_INSTANCE* coalescing_io, const void* buffer, size_t size, ON_SEND_COMPLETE on_send_complete, void* callback_context)
+{
+    int result;
+
+    if (coalescing_io->frame_write_count == coalescing_io->frame_write_capacity)
+    {
+        size_t new_capacity = (coalescing_io->frame_write_capacity == 0) ? INITIAL_PENDING_WRITE_COUNT : coalescing_io->frame_write_capacity * 2;
+        PENDING_WRITE* new_writes = (PENDING_WRITE*)realloc(coalescing_io->frame_writes, new_capacity * sizeof(PENDING_WRITE));
+
+        if (new_writes == NULL)
+        {
+            LogError("Cannot grow the writes of the frame to %lu", (unsigned long)new_capacity);
+        }
+        else
+        {
+            coalescing_io->frame_writes = new_writes;
+            coalescing_io->frame_write_capacity = new_capacity;
+        }
+    }
+
+    if (coalescing_io->frame_write_count == coalescing_io->frame_write_capacity)
+    {
+        /* Codes_SRS_IOTHUB_CLIENT_COALESCING_IO_41_017: [ If the write cannot be kept, `coalescing_io_send` shall fail and return a non-zero value. ]*/
+        result = __FAILURE__;
+    }
+    else
+    {
+        /* Codes_SRS_IOTHUB_CLIENT_COALESCING_IO_41_014: [ If the write fits in the frame, `coalescing_io_send` shall copy `buffer` to the frame, keep `on_send_complete` and `callback_context` for when the frame is sent and return 0. ]*/
+        (void)memcpy(coalescing_io->frame_bytes + coalescing_io->frame_size, buffer, size);
+        coalescing_io->frame_size += size;
+        coalescing_io->frame_writes[coalescing_io->frame_write_count].on_send_complete = on_send_complete;
+        coalescing_io->frame_writes[coalescing_io->frame_write_count].callback_context = callback_context;
+        coalescing_io->frame_write_count++;
+        result = RESULT_OK;
+    }
+
+    return result;
+}
+
+static void on_underlying_io_open_complete(void* context, IO_OPEN_RESULT open_result)
+{
+    COALESCING_IO_INSTANCE* coalescing_io = (COALESCING_IO_INSTANCE*)context;
+
+    /* Codes_SRS_IOTHUB_CLIENT_COALESCING_IO_41_009: [ When the open of the underlying IO completes, the coalescing IO shall be open if `open_result` is `IO_OPEN_OK`, and `on_io_open_complete` shall be called with `open_result`. ]*/
+    coalescing_io->is_open = (open_result == IO_OPEN_OK);
+
+    if (coalescing_io->on_io_open_complete != NULL)
+    {
+        coalescing_io->on_io_open_complete(coalescing_io->on_io_open_complete_context, open_result);
+    }
+}
+
+static void* coalescing_io_clone_option(const char* name, const void* value)
+{
+    void* result;
+
+    if ((name == NULL) || (value == NULL))
+    {
+        LogError("Invalid argument name %p value %p", name, value);
+        result = NULL;
+    }
+    else if (strcmp(name, OPTION_WS_COALESCED_FRAME_SIZE) == 0)
+    {
+        if ((result = malloc(sizeof(size_t))) == NULL)
+        {
+            LogError("Cannot clone option %s", name);
+        }
+        else
+        {
+            *(size_t*)result = *(const size_t*)value;
+        }
+    }
+    else if (strcmp(name, COALESCING_IO_OPTION_UNDERLYING_OPTIONS) == 0)
+    {
+        if ((result = (void*)OptionHandler_Clone((OPTIONHANDLER_HANDLE)value)) == NULL)
+        {
+            LogError("Cannot clone option %s", name);
+        }
+    }
+    else
+    {
+        LogError("Option %s is not a coalescing IO option", name);
+        result = NULL;
+    }
+
+    return result;
+}
+
+static void coalescing_io_destroy_option(const char* name, const void* value)
+{
+    if ((name == NULL) || (value == NULL))
+    {
+        LogError("Invalid argument name %p value %p", name, value);
+    }
+    else if (strcmp(name, OPTION_WS_COALESCED_FRAME_SIZE) == 0)
+    {
+        free((void*)value);
+    }
+    else if (strcmp(name, COALESCING_IO_OPTION_UNDERLYING_OPTIONS) == 0)
+    {
+        OptionHandler_Destroy((OPTIONHANDLER_HANDLE)value);
+    }
+    else
+    {
+        LogError("Option %s is not a coalescing IO option", name);
+    }
+}
+
+static CONCRETE_IO_HANDLE coalescing_io_create(void* io_create_parameters)
+{
+    COALESCING_IO_INSTANCE* result;
+    const COALESCING_IO_CONFIG* config = (const COALESCING_IO_CONFIG*)io_create_parameters;
+
+    /* Codes_SRS_IOTHUB_CLIENT_COALESCING_IO_41_002: [ If `io_create_parameters` is NULL or its `underlying_io` is NULL, `coalescing_io_create` shall fail and return NULL. ]*/
+    if ((config == NULL) || (config->underlying_io == NULL))
+    {
+        LogError("Invalid argument io_create_parameters %p", io_create_parameters);
+        result = NULL;
+    }
+    /* Codes_SRS_IOTHUB_CLIENT_COALESCING_IO_41_003: [ `coalescing_io_create` shall allocate the instance, a list of the frames in flight and a frame buffer of `COALESCING_IO_DEFAULT_MAX_FRAME_SIZE` bytes; if any of them fails it shall free the others and return NULL, leaving `underlying_io` to the caller. ]*/
+    else if ((result = (COALESCING_IO_INSTANCE*)malloc(sizeof(COALESCING_IO_INSTANCE))) == NULL)
+    {
+        LogError("Cannot allocate the coalescing IO");
+    }
+    else
+    {
+        memset(result, 0, sizeof(COALESCING_IO_INSTANCE));
+
+        if ((result->frames_in_flight = singlylinkedlist_create()) == NULL)
+        {
+            LogError("Cannot create the frames in flight of the coalescing IO");
+            free(result);
+            result = NULL;
+        }
+        else if ((result->frame_bytes = (unsigned char*)malloc(COALESCING_IO_DEFAULT_MAX_FRAME_SIZE)) == NULL)
+        {
+            LogError("Cannot allocate the frame of the coalescing IO");
+            singlylinkedlist_destroy(result->frames_in_flight);
+            free(result);
+            result = NULL;
+        }
+        else
+        {
+            /* Codes_SRS_IOTHUB_CLIENT_COALESCING_IO_41_004: [ On success `coalescing_io_create` shall take ownership of `underlying_io` and return the new instance. ]*/
+            result->underlying_io = config->underlying_io;
+            result->max_frame_size = COALESCING_IO_DEFAULT_MAX_FRAME_SIZE;
+        }
+    }
+
+    return (CONCRETE_IO_HANDLE)result;
+}
+
+static void coalescing_io_destroy(CONCRETE_IO_HANDLE coalescing_io_handle)
+{
+    /* Codes_SRS_IOTHUB_CLIENT_COALESCING_IO_41_005: [ If `coalescing_io_handle` is NULL, `coalescing_io_destroy` shall do nothing. ]*/
+    if (coalescing_io_handle != NULL)
+    {
+        COALESCING_IO_INSTANCE* coalescing_io = (COALESCING_IO_INSTANCE*)coalescing_io_handle;
+        LIST_ITEM_HANDLE list_item;
+
+        /* Codes_SRS_IOTHUB_CLIENT_COALESCING_IO_41_006: [ `coalescing_io_destroy` shall call the `on_send_complete` of the writes not sent yet with `IO_SEND_CANCELLED`, destroy the underlying IO with `xio_destroy`, call the `on_send_complete` of the writes of the frames it did not complete with `IO_SEND_CANCELLED` and free the instance. ]*/
+        complete_buffered_writes(coalescing_io, IO_SEND_CANCELLED);
+        xio_destroy(coalescing_io->underlying_io);
+
+        while ((list_item = singlylinkedlist_get_head_item(coalescing_io->frames_in_flight)) != NULL)
+        {
+            on_frame_send_complete((void*)singlylinkedlist_item_get_value(list_item), IO_SEND_CANCELLED);
+        }
+
+        singlylinkedlist_destroy(coalescing_io->frames_in_flight);
+        free(coalescing_io->frame_bytes);
+        free(coalescing_io);
+    }
+}
+
+static int coalescing_io_open(CONCRETE_IO_HANDLE coalescing_io_handle, ON_IO_OPEN_COMPLETE on_io_open_complete, void* on_io_open_complete_context, ON_BYTES_RECEIVED on_bytes_received, void* on_bytes_received_context, ON_IO_ERROR on_io_error, void* on_io_error_context)
+{
+    int result;
+
+    /* Codes_SRS_IOTHUB_CLIENT_COALESCING_IO_41_007: [ If `coalescing_io_handle` is NULL, `coalescing_io_open` shall fail and return a non-zero value. ]*/
+    if (coalescing_io_handle == NULL)
+    {
+        LogError("Invalid argument coalescing_io_handle is NULL");
+        result = __FAILURE__;
+    }
+    else
+    {
+        COALESCING_IO_INSTANCE* coalescing_io = (COALESCING_IO_INSTANCE*)coalescing_io_handle;
+
+        coalescing_io->on_io_open_complete = on_io_open_complete;
+        coalescing_io->on_io_open_complete_context = on_io_open_complete_context;
+        coalescing_io->on_io_error = on_io_error;
+        coalescing_io->on_io_error_context = on_io_error_context;
+
+        /* Codes_SRS_IOTHUB_CLIENT_COALESCING_IO_41_008: [ `coalescing_io_open` shall call `xio_open` on the underlying IO with `on_bytes_received`, `on_io_error` and their contexts, and fail and return a non-zero value if it fails. ]*/
+        if (xio_open(coalescing_io->underlying_io, on_underlying_io_open_complete, coalescing_io, on_bytes_received, on_bytes_received_context, on_io_error, on_io_error_context) != 0)
+        {
+            LogError("Cannot open the underlying IO");
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = RESULT_OK;
+        }
+    }
+
+    return result;
+}
+
+static int coalescing_io_close(CONCRETE_IO_HANDLE coalescing_io_handle, ON_IO_CLOSE_COMPLETE on_io_close_complete, void* callback_context)
+{
+    int result;
+
+    /* Codes_SRS_IOTHUB_CLIENT_COALESCING_IO_41_010: [ If `coalescing_io_handle` is NULL, `coalescing_io_close` shall fail and return a non-zero value. ]*/
+    if (coalescing_io_handle == NULL)
+    {
+        LogError("Invalid argument coalescing_io_handle is NULL");
+        result = __FAILURE__;
+    }
+    else
+    {
+        COALESCING_IO_INSTANCE* coalescing_io = (COALESCING_IO_INSTANCE*)coalescing_io_handle;
+
+        /* Codes_SRS_IOTHUB_CLIENT_COALESCING_IO_41_011: [ `coalescing_io_close` shall send the writes buffered, so that the last ones (an MQTT DISCONNECT, an AMQP close) go out, stop being open and return the result of `xio_close` on the underlying IO with `on_io_close_complete` and `callback_context`. ]*/
+        if (coalescing_io->is_open)
+        {
+            (void)send_frame(coalescing_io);
+        }
+        coalescing_io->is_open = false;
+
+        result = xio_close(coalescing_io->underlying_io, on_io_close_complete, callback_context);
+    }
+
+    return result;
+}
+
+static int coalescing_io_send(CONCRETE_IO_HANDLE coalescing_io_handle, const void* buffer, size_t size, ON_SEND_COMPLETE on_send_complete, void* callback_context)
+{
+    int result;
+    COALESCING_IO_INSTANCE* coalescing_io = (COALESCING_IO_INSTANCE*)coalescing_io_handle;
+
+    /* Codes_SRS_IOTHUB_CLIENT_COALESCING_IO_41_012: [ If `coalescing_io_handle` or `buffer` is NULL or `size` is 0, `coalescing_io_send` shall fail and return a non-zero value. ]*/
+    if ((coalescing_io == NULL) || (buffer == NULL) || (size == 0))
+    {
+        LogError("Invalid argument coalescing_io_handle %p buffer %p size %lu", coalescing_io_handle, buffer, (unsigned long)size);
+        result = __FAILURE__;
+    }
+    /* Codes_SRS_IOTHUB_CLIENT_COALESCING_IO_41_013: [ If the coalescing IO is not open, `coalescing_io_send` shall fail and return a non-zero value. ]*/
+    else if (!coalescing_io->is_open)
+    {
+        LogError("Cannot send, the coalescing IO is not open");
+        result = __FAILURE__;
+    }
+    else if ((size < coalescing_io->max_frame_size) && (size <= coalescing_io->max_frame_size - coalescing_io->frame_size))
+    {
+        result = buffer_write(coalescing_io, buffer, size, on_send_complete, callback_context);
+    }
+    /* Codes_SRS_IOTHUB_CLIENT_COALESCING_IO_41_015: [ If the write does not fit in the frame, `coalescing_io_send` shall send the frame first, and fail and return a non-zero value if that fails. ]*/
+    else if (send_frame(coalescing_io) != 0)
+    {
+        LogError("Cannot send the frame before a write of %lu bytes", (unsigned long)size);
+        result = __FAILURE__;
+    }
+    else if (size < coalescing_io->max_frame_size)
+    {
+        result = buffer_write(coalescing_io, buffer, size, on_send_complete, callback_context);
+    }
+    /* Codes_SRS_IOTHUB_CLIENT_COALESCING_IO_41_016: [ A write of at least the maximum frame size shall be sent on its own with `xio_send` on the underlying IO with `on_send_complete` and `callback_context`, and `coalescing_io_send` shall fail and return a non-zero value if it fails. ]*/
+    else if (xio_send(coalescing_io->underlying_io, buffer, size, on_send_complete, callback_context) != 0)
+    {
+        LogError("Cannot send a write of %lu bytes", (unsigned long)size);
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = RESULT_OK;
+    }
+
+    return result;
+}
+
+static void coalescing_io_dowork(CONCRETE_IO_HANDLE coalescing_io_handle)
+{
+    /* Codes_SRS_IOTHUB_CLIENT_COALESCING_IO_41_021: [ If `coalescing_io_handle` is NULL, `coalescing_io_dowork` shall do nothing. ]*/
+    if (coalescing_io_handle != NULL)
+    {
+        COALESCING_IO_INSTANCE* coalescing_io = (COALESCING_IO_INSTANCE*)coalescing_io_handle;
+        bool frame_lost = false;
+
+        /* Codes_SRS_IOTHUB_CLIENT_COALESCING_IO_41_022: [ `coalescing_io_dowork` shall send the frame, call `xio_dowork` on the underlying IO and send the frame again, so that the writes made from the callbacks of the underlying IO go out in the same DoWork. ]*/
+        if (coalescing_io->is_open && (send_frame(coalescing_io) != 0))
+        {
+            frame_lost = true;
+        }
+
+        xio_dowork(coalescing_io->underlying_io);
+
+        if (coalescing_io->is_open && (send_frame(coalescing_io) != 0))
+        {
+            frame_lost = true;
+        }
+
+        /* Codes_SRS_IOTHUB_CLIENT_COALESCING_IO_41_023: [ If a frame cannot be sent, `coalescing_io_dowork` shall call the `on_io_error` given to `coalescing_io_open`, since the bytes of the stream that follow it cannot be understood. ]*/
+        if (frame_lost && (coalescing_io->on_io_error != NULL))
+        {
+            coalescing_io->on_io_error(coalescing_io->on_io_error_context);
+        }
+    }
+}
+
+static int coalescing_io_setoption(CONCRETE_IO_HANDLE coalescing_io_handle, const char* optionName, const void* value)
+{
+    int result;
+    COALESCING_IO_INSTANCE* coalescing_io = (COALESCING_IO_INSTANCE*)coalescing_io_handle;
+
+    /* Codes_SRS_IOTHUB_CLIENT_COALESCING_IO_41_024: [ If `coalescing_io_handle` or `optionName` is NULL, `coalescing_io_setoption` shall fail and return a non-zero value. ]*/
+    if ((coalescing_io == NULL) || (optionName == NULL))
+    {
+        LogError("Invalid argument coalescing_io_handle %p optionName %p", coalescing_io_handle, optionName);
+        result = __FAILURE__;
+    }
+    /* Codes_SRS_IOTHUB_CLIENT_COALESCING_IO_41_031: [ `OPTION_TLS_COALESCED_RECORD_SIZE` shall be the same option as `OPTION_WS_COALESCED_FRAME_SIZE`. ]*/
+    else if ((strcmp(optionName, OPTION_WS_COALESCED_FRAME_SIZE) == 0) || (strcmp(optionName, OPTION_TLS_COALESCED_RECORD_SIZE) == 0))
+    {
+        /* Codes_SRS_IOTHUB_CLIENT_COALESCING_IO_41_025: [ If `optionName` is `OPTION_WS_COALESCED_FRAME_SIZE`, `coalescing_io_setoption` shall send the frame and make the frame buffer `*(size_t*)value` bytes long, freeing it for 0; if `value` is NULL or this fails it shall keep the previous size and return a non-zero value. ]*/
+        if (value == NULL)
+        {
+            LogError("Invalid argument value is NULL for option %s", optionName);
+            result = __FAILURE__;
+        }
+        else if (send_frame(coalescing_io) != 0)
+        {
+            LogError("Cannot send the frame before resizing it");
+            result = __FAILURE__;
+        }
+        else
+        {
+            size_t max_frame_size = *(const size_t*)value;
+
+            if (max_frame_size == 0)
+            {
+                free(coalescing_io->frame_bytes);
+                coalescing_io->frame_bytes = NULL;
+                coalescing_io->max_frame_size = 0;
+                result = RESULT_OK;
+            }
+            else
+            {
+                unsigned char* frame_bytes = (unsigned char*)realloc(coalescing_io->frame_bytes, max_frame_size);
+
+                if (frame_bytes == NULL)
+                {
+                    LogError("Cannot resize the frame to %lu bytes", (unsigned long)max_frame_size);
+                    result = __FAILURE__;
+                }
+                else
+                {
+                    coalescing_io->frame_bytes = frame_bytes;
+                    coalescing_io->max_frame_size = max_frame_size;
+                    result = RESULT_OK;
+                }
+            }
+        }
+    }
+    else if (strcmp(optionName, COALESCING_IO_OPTION_UNDERLYING_OPTIONS) == 0)
+    {
+        /* Codes_SRS_IOTHUB_CLIENT_COALESCING_IO_41_026: [ If `optionName` is `coalescing_io_underlying_options`, `coalescing_io_setoption` shall give the options to the underlying IO with `OptionHandler_FeedOptions`, and fail and return a non-zero value if it fails. ]*/
+        if (OptionHandler_FeedOptions((OPTIONHANDLER_HANDLE)value, coalescing_io->underlying_io) != OPTIONHANDLER_OK)
+        {
+            LogError("Cannot feed the saved options to the underlying IO");
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = RESULT_OK;
+        }
+    }
+    else
+    {
+        /* Codes_SRS_IOTHUB_CLIENT_COALESCING_IO_41_027: [ Otherwise `coalescing_io_setoption` shall return the result of `xio_setoption` on the underlying IO with `optionName` and `value`. ]*/
+        result = xio_setoption(coalescing_io->underlying_io, optionName, value);
+    }
+
+    return result;
+}
+
+static OPTIONHANDLER_HANDLE coalescing_io_retrieveoptions(CONCRETE_IO_HANDLE coalescing_io_handle)
+{
+    OPTIONHANDLER_HANDLE result;
+    COALESCING_IO_INSTANCE* coalescing_io = (COALESCING_IO_INSTANCE*)coalescing_io_handle;
+
+    /* Codes_SRS_IOTHUB_CLIENT_COALESCING_IO_41_028: [ If `coalescing_io_handle` is NULL, `coalescing_io_retrieveoptions` shall return NULL. ]*/
+    if (coalescing_io == NULL)
+    {
+        LogError("Invalid argument coalescing_io_handle is NULL");
+        result = NULL;
+    }
+    /* Codes_SRS_IOTHUB_CLIENT_COALESCING_IO_41_029: [ `coalescing_io_retrieveoptions` shall return an `OPTIONHANDLER_HANDLE` holding `OPTION_WS_COALESCED_FRAME_SIZE` and, as `coalescing_io_underlying_options`, the options `xio_retrieveoptions` returns for the underlying IO. ]*/
+    else if ((result = OptionHandler_Create(coalescing_io_clone_option, coalescing_io_destroy_option, coalescing_io_setoption)) == NULL)
+    {
+        /* Codes_SRS_IOTHUB_CLIENT_COALESCING_IO_41_030: [ If any of this fails, `coalescing_io_retrieveoptions` shall free what it created and return NULL. ]*/
+        LogError("Cannot create the options of the coalescing IO");
+    }
+    else if (OptionHandler_AddOption(result, OPTION_WS_COALESCED_FRAME_SIZE, &coalescing_io->max_frame_size) != OPTIONHANDLER_OK)
+    {
+        LogError("Cannot save option %s", OPTION_WS_COALESCED_FRAME_SIZE);
+        OptionHandler_Destroy(result);
+        result = NULL;
+    }
+    else
+    {
+        OPTIONHANDLER_HANDLE underlying_options;
+
+        if ((underlying_options = xio_retrieveoptions(coalescing_io->underlying_io)) == NULL)
+        {
+            LogError("Cannot retrieve the options of the underlying IO");
+            OptionHandler_Destroy(result);
+            result = NULL;
+        }
+        else
+        {
+            if (OptionHandler_AddOption(result, COALESCING_IO_OPTION_UNDERLYING_OPTIONS, underlying_options) != OPTIONHANDLER_OK)
+            {
+                LogError("Cannot save the options of the underlying IO");
+                OptionHandler_Destroy(result);
+                result = NULL;
+            }
+
+            OptionHandler_Destroy(underlying_options);
+        }
+    }
+
+    return result;
+}
+
+static const IO_INTERFACE_DESCRIPTION coalescing_io_interface_description =
+{
+    coalescing_io_retrieveoptions,
+    coalescing_io_create,
+    coalescing_io_destroy,
+    coalescing_io_open,
+    coalescing_io_close,
+    coalescing_io_send,
+    coalescing_io_dowork,
+    coalescing_io_setoption
+};
+
+const IO_INTERFACE_DESCRIPTION* coalescing_io_get_interface_description(void)
+{
+    /* Codes_SRS_IOTHUB_CLIENT_COALESCING_IO_41_001: [ `coalescing_io_get_interface_description` shall return a pointer to an `IO_INTERFACE_DESCRIPTION` holding the functions of the coalescing IO. ]*/
+    return &coalescing_io_interface_description;
+}
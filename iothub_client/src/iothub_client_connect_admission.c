@@ -0,0 +1,139 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/tickcounter.h"
+
+#include "iothub_client_connect_admission.h"
+#include "internal/iothub_client_connect_admission_private.h"
+
+#define RESULT_OK 0
+/*the bucket counts thousandths of a token, so that a token per second refills by one every millisecond*/
+#define MILLITOKENS_PER_TOKEN 1000
+
+bool g_iothub_client_connect_admission_started = false;
+
+static LOCK_HANDLE g_connect_admission_lock = NULL;
+static TICK_COUNTER_HANDLE g_connect_admission_tick_counter = NULL;
+static uint64_t g_connect_admission_rate;
+static uint64_t g_connect_admission_capacity;
+static uint64_t g_connect_admission_millitokens;
+static tickcounter_ms_t g_connect_admission_last_refill;
+
+static void destroy_connect_admission(void)
+{
+    if (g_connect_admission_tick_counter != NULL)
+    {
+        tickcounter_destroy(g_connect_admission_tick_counter);
+        g_connect_admission_tick_counter = NULL;
+    }
+    if (g_connect_admission_lock != NULL)
+    {
+        (void)Lock_Deinit(g_connect_admission_lock);
+        g_connect_admission_lock = NULL;
+    }
+}
+
+int IoTHubClient_ConnectAdmission_Start(uint32_t connects_per_second, uint32_t burst)
+{
+    int result;
+
+    /*Codes_SRS_IOTHUB_CLIENT_CONNECT_ADMISSION_41_001: [ If connects_per_second or burst is 0, IoTHubClient_ConnectAdmission_Start shall fail and return a non-zero value. ]*/
+    if ((connects_per_second == 0) || (burst == 0))
+    {
+        LogError("Invalid argument connects_per_second %lu burst %lu", (unsigned long)connects_per_second, (unsigned long)burst);
+        result = __FAILURE__;
+    }
+    /*Codes_SRS_IOTHUB_CLIENT_CONNECT_ADMISSION_41_002: [ If admission control is already started, IoTHubClient_ConnectAdmission_Start shall fail and return a non-zero value. ]*/
+    else if (g_connect_admission_lock != NULL)
+    {
+        LogError("Connect admission control is already started");
+        result = __FAILURE__;
+    }
+    /*Codes_SRS_IOTHUB_CLIENT_CONNECT_ADMISSION_41_003: [ IoTHubClient_ConnectAdmission_Start shall create a lock and a tick counter; if either fails it shall free the other and return a non-zero value. ]*/
+    else if ((g_connect_admission_lock = Lock_Init()) == NULL)
+    {
+        LogError("Cannot create the lock of connect admission control");
+        result = __FAILURE__;
+    }
+    else if ((g_connect_admission_tick_counter = tickcounter_create()) == NULL)
+    {
+        LogError("Cannot create the tick counter of connect admission control");
+        destroy_connect_admission();
+        result = __FAILURE__;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_CONNECT_ADMISSION_41_004: [ On success IoTHubClient_ConnectAdmission_Start shall fill the bucket with burst tokens, start admitting the connections and return 0. ]*/
+        g_connect_admission_rate = connects_per_second;
+        g_connect_admission_capacity = (uint64_t)burst * MILLITOKENS_PER_TOKEN;
+        g_connect_admission_millitokens = g_connect_admission_capacity;
+        g_connect_admission_last_refill = 0;
+        g_iothub_client_connect_admission_started = true;
+        result = RESULT_OK;
+    }
+
+    return result;
+}
+
+void IoTHubClient_ConnectAdmission_Stop(void)
+{
+    /*Codes_SRS_IOTHUB_CLIENT_CONNECT_ADMISSION_41_005: [ IoTHubClient_ConnectAdmission_Stop shall stop admitting the connections and free the lock and the tick counter; it shall do nothing if admission control is not started. ]*/
+    g_iothub_client_connect_admission_started = false;
+    destroy_connect_admission();
+}
+
+bool IoTHubClient_ConnectAdmission_TryAcquire(void)
+{
+    bool result;
+    tickcounter_ms_t now;
+
+    /*Codes_SRS_IOTHUB_CLIENT_CONNECT_ADMISSION_41_006: [ If admission control is not started, IoTHubClient_ConnectAdmission_TryAcquire shall return true. ]*/
+    if (g_connect_admission_lock == NULL)
+    {
+        result = true;
+    }
+    /*Codes_SRS_IOTHUB_CLIENT_CONNECT_ADMISSION_41_007: [ If the time cannot be got or the lock cannot be taken, IoTHubClient_ConnectAdmission_TryAcquire shall return true, so that no connection waits forever. ]*/
+    else if (tickcounter_get_current_ms(g_connect_admission_tick_counter, &now) != 0)
+    {
+        LogError("Cannot get the time of connect admission control");
+        result = true;
+    }
+    else if (Lock(g_connect_admission_lock) != LOCK_OK)
+    {
+        LogError("Cannot lock connect admission control");
+        result = true;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_CONNECT_ADMISSION_41_008: [ IoTHubClient_ConnectAdmission_TryAcquire shall add to the bucket connects_per_second tokens for every second since it was last refilled, without exceeding burst tokens. ]*/
+        if (now > g_connect_admission_last_refill)
+        {
+            uint64_t refill = (uint64_t)(now - g_connect_admission_last_refill) * g_connect_admission_rate;
+            uint64_t room = g_connect_admission_capacity - g_connect_admission_millitokens;
+            g_connect_admission_millitokens += (refill < room) ? refill : room;
+            g_connect_admission_last_refill = now;
+        }
+
+        /*Codes_SRS_IOTHUB_CLIENT_CONNECT_ADMISSION_41_009: [ If the bucket holds a whole token, IoTHubClient_ConnectAdmission_TryAcquire shall take it and return true; otherwise it shall return false. ]*/
+        if (g_connect_admission_millitokens >= MILLITOKENS_PER_TOKEN)
+        {
+            g_connect_admission_millitokens -= MILLITOKENS_PER_TOKEN;
+            result = true;
+        }
+        else
+        {
+            result = false;
+        }
+
+        (void)Unlock(g_connect_admission_lock);
+    }
+
+    return result;
+}
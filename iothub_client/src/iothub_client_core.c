@@ -7,6 +7,7 @@
 
 #include <signal.h>
 #include <stddef.h>
+#include <limits.h>
 #include "azure_c_shared_utility/optimize_size.h"
 #include "azure_c_shared_utility/crt_abstractions.h"
 #include "iothub_client_core.h"
@@ -16,10 +17,12 @@
 #include "internal/iothubtransport.h"
 #include "azure_c_shared_utility/threadapi.h"
 #include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/singlylinkedlist.h"
 #include "azure_c_shared_utility/vector.h"
 #include "iothub_client_options.h"
+#include "iothub_client_worker_pool.h"
 #include "azure_c_shared_utility/tickcounter.h"
 
 
@@ -27,6 +30,14 @@
 
 struct IOTHUB_QUEUE_CONTEXT_TAG;
 
+typedef struct SUBMISSION_RECORD_TAG
+{
+    IOTHUB_MESSAGE_HANDLE message; /*clone owned by the submission queue*/
+    IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback;
+    struct IOTHUB_QUEUE_CONTEXT_TAG* queue_context; /*NULL when eventConfirmationCallback is NULL*/
+    void* userContextCallback; /*passed straight to the LL when eventConfirmationCallback is NULL*/
+} SUBMISSION_RECORD;
+
 typedef struct IOTHUB_CLIENT_CORE_INSTANCE_TAG
 {
     IOTHUB_CLIENT_CORE_LL_HANDLE IoTHubClientLLHandle;
@@ -37,8 +48,11 @@ typedef struct IOTHUB_CLIENT_CORE_INSTANCE_TAG
     SINGLYLINKEDLIST_HANDLE httpWorkerThreadInfoList; /*list containing HTTPWORKER_THREAD_INFO*/
     int created_with_transport_handle;
     VECTOR_HANDLE saved_user_callback_list;
+    int signal_transport_work; /*set while the shared transport worker may be told about saved callbacks, guarded by LockHandle*/
     IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK desired_state_callback;
     IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK event_confirm_callback;
+    IOTHUB_CLIENT_EVENT_CONFIRMATION_BATCH_CALLBACK event_confirm_batch_callback;
+    void* event_confirm_batch_user_context;
     IOTHUB_CLIENT_REPORTED_STATE_CALLBACK reported_state_callback;
     IOTHUB_CLIENT_CONNECTION_STATUS_CALLBACK connection_status_callback;
     IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC device_method_callback;
@@ -50,6 +64,38 @@ typedef struct IOTHUB_CLIENT_CORE_INSTANCE_TAG
     struct IOTHUB_QUEUE_CONTEXT_TAG* method_user_context;
     uint16_t do_work_freq_ms;
     tickcounter_ms_t currentMessageTimeout;
+    COND_HANDLE do_work_condition; /*only created when OPTION_DO_WORK_MAX_IDLE_MS is set*/
+    LOCK_HANDLE do_work_lock; /*guards do_work_pending and the wait on do_work_condition, never held across LL calls*/
+    unsigned int do_work_max_idle_ms;
+    int do_work_pending;
+    IOTHUB_CLIENT_WORKER_POOL_HANDLE worker_pool; /*set through OPTION_WORKER_POOL, replaces ThreadHandle*/
+    IOTHUB_CLIENT_WORKER_POOL_ITEM_HANDLE worker_pool_item;
+    LOCK_HANDLE submission_lock; /*only guards the submission ring, never held across LL calls*/
+    SUBMISSION_RECORD* submission_ring; /*created when OPTION_SUBMISSION_QUEUE_SIZE is set*/
+    SUBMISSION_RECORD* submission_drain_buffer;
+    size_t submission_capacity;
+    size_t submission_head;
+    size_t submission_count;
+    size_t submission_contention_count;
+    THREAD_HANDLE callback_dispatch_thread; /*started when OPTION_CALLBACK_DISPATCH_THREAD is set*/
+    LOCK_HANDLE callback_dispatch_lock; /*only guards callback_dispatch_list and stop_callback_dispatch*/
+    COND_HANDLE callback_dispatch_condition;
+    VECTOR_HANDLE callback_dispatch_list; /*USER_CALLBACK_INFO batches handed over by the worker*/
+    int stop_callback_dispatch;
+    LOCK_HANDLE event_pool_lock; /*created when OPTION_EVENT_POOL_SIZE is set, only guards event_pool*/
+    struct IOTHUB_QUEUE_CONTEXT_TAG** event_pool; /*free event confirmation contexts kept for reuse*/
+    size_t event_pool_count;
+    size_t event_pool_size;
+    THREAD_HANDLE* http_worker_threads; /*allocated when OPTION_HTTP_WORKER_THREADS is set, threads are started on demand*/
+    size_t http_worker_thread_count;
+    size_t http_worker_threads_started;
+    size_t http_worker_threads_idle;
+    LOCK_HANDLE http_worker_lock; /*only guards http_worker_queue, the counters above and stop_http_workers*/
+    COND_HANDLE http_worker_condition;
+    SINGLYLINKEDLIST_HANDLE http_worker_queue; /*HTTPWORKER_THREAD_INFO waiting for a pool thread*/
+    int stop_http_workers;
+    SINGLYLINKEDLIST_HANDLE method_handlers; /*METHOD_HANDLER_INFO, created by the first IoTHubClientCore_SetDeviceMethodHandler and kept until destroy*/
+    struct METHOD_WORKER_POOL_TAG* method_worker_pool; /*set by OPTION_METHOD_WORKER_THREADS, runs the methods otherwise dispatched with the other callbacks*/
 } IOTHUB_CLIENT_CORE_INSTANCE;
 
 typedef enum HTTPWORKER_THREAD_TYPE_TAG
@@ -86,6 +132,8 @@ typedef struct HTTPWORKER_THREAD_INFO_TAG
     HTTPWORKER_THREAD_TYPE workerThreadType;
     char* destinationFileName;
     THREAD_HANDLE threadHandle;
+    THREAD_START_FUNC httpWorkerThreadFunc;
+    int runsOnHttpWorkerPool; /*the job was queued to a pool thread, there is no threadHandle to exit or join*/
     LOCK_HANDLE lockGarbage;
     int canBeGarbageCollected; /*flag indicating that the structure can be freed because the thread deadling with it finished*/
     IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle;
@@ -103,7 +151,9 @@ typedef struct HTTPWORKER_THREAD_INFO_TAG
     CALLBACK_TYPE_DEVICE_METHOD,        \
     CALLBACK_TYPE_INBOUD_DEVICE_METHOD, \
     CALLBACK_TYPE_MESSAGE,              \
-    CALLBACK_TYPE_INPUTMESSAGE
+    CALLBACK_TYPE_INPUTMESSAGE,         \
+    CALLBACK_TYPE_EVENT_CONFIRM_BATCH,  \
+    CALLBACK_TYPE_METHOD_HANDLER
 
 DEFINE_ENUM(USER_CALLBACK_TYPE, USER_CALLBACK_TYPE_VALUES)
 DEFINE_ENUM_STRINGS(USER_CALLBACK_TYPE, USER_CALLBACK_TYPE_VALUES)
@@ -122,6 +172,12 @@ typedef struct EVENT_CONFIRM_CALLBACK_INFO_TAG
     IOTHUB_CLIENT_CONFIRMATION_RESULT confirm_result;
 } EVENT_CONFIRM_CALLBACK_INFO;
 
+typedef struct EVENT_CONFIRM_BATCH_CALLBACK_INFO_TAG
+{
+    IOTHUB_CLIENT_EVENT_CONFIRMATION* confirmations;
+    size_t count;
+} EVENT_CONFIRM_BATCH_CALLBACK_INFO;
+
 typedef struct REPORTED_STATE_CALLBACK_INFO_TAG
 {
     int status_code;
@@ -138,6 +194,7 @@ typedef struct METHOD_CALLBACK_INFO_TAG
     STRING_HANDLE method_name;
     BUFFER_HANDLE payload;
     METHOD_HANDLE method_id;
+    struct METHOD_HANDLER_INFO_TAG* handler; /*NULL for the device method callback*/
 } METHOD_CALLBACK_INFO;
 
 typedef struct INPUTMESSAGE_CALLBACK_INFO_TAG
@@ -154,6 +211,7 @@ typedef struct USER_CALLBACK_INFO_TAG
     {
         DEVICE_TWIN_CALLBACK_INFO dev_twin_cb_info;
         EVENT_CONFIRM_CALLBACK_INFO event_confirm_cb_info;
+        EVENT_CONFIRM_BATCH_CALLBACK_INFO event_confirm_batch_cb_info;
         REPORTED_STATE_CALLBACK_INFO reported_state_cb_info;
         CONNECTION_STATUS_CALLBACK_INFO connection_status_cb_info;
         METHOD_CALLBACK_INFO method_cb_info;
@@ -168,6 +226,172 @@ typedef struct IOTHUB_QUEUE_CONTEXT_TAG
     void* userContextCallback;
 } IOTHUB_QUEUE_CONTEXT;
 
+typedef struct METHOD_WORKER_POOL_TAG
+{
+    IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientHandle;
+    THREAD_HANDLE* threads; /*threads are started on demand*/
+    size_t thread_count;
+    size_t threads_started;
+    size_t threads_idle;
+    LOCK_HANDLE lock; /*only guards queue, the counters above and stop*/
+    COND_HANDLE condition;
+    SINGLYLINKEDLIST_HANDLE queue; /*METHOD_CALLBACK_INFO waiting for a worker thread*/
+    int stop;
+} METHOD_WORKER_POOL;
+
+typedef struct METHOD_HANDLER_INFO_TAG
+{
+    IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientHandle;
+    STRING_HANDLE method_name;
+    IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC methodCallback; /*guarded by LockHandle, NULL once the handler was removed*/
+    void* userContextCallback;
+    METHOD_WORKER_POOL* worker_pool; /*NULL when the method runs on the threads shared by the other methods*/
+} METHOD_HANDLER_INFO;
+
+/*must be called with LockHandle held*/
+static int push_user_callback(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance, USER_CALLBACK_INFO* queue_cb_info)
+{
+    int result = VECTOR_push_back(iotHubClientInstance->saved_user_callback_list, queue_cb_info, 1);
+
+    /*Codes_SRS_IOTHUBCLIENT_41_039: [ When the transport connection is shared, saving a user callback shall call IoTHubTransport_SignalClientWork so the transport worker thread delivers it. ]*/
+    if ((result == 0) && (iotHubClientInstance->signal_transport_work != 0))
+    {
+        IoTHubTransport_SignalClientWork(iotHubClientInstance->TransportHandle, iotHubClientInstance);
+    }
+
+    return result;
+}
+
+static IOTHUB_QUEUE_CONTEXT* get_event_queue_context(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance)
+{
+    IOTHUB_QUEUE_CONTEXT* result = NULL;
+
+    if (iotHubClientInstance->event_pool_lock != NULL)
+    {
+        if (Lock(iotHubClientInstance->event_pool_lock) != LOCK_OK)
+        {
+            LogError("failed locking event pool");
+        }
+        else
+        {
+            if (iotHubClientInstance->event_pool_count > 0)
+            {
+                result = iotHubClientInstance->event_pool[--iotHubClientInstance->event_pool_count];
+            }
+            (void)Unlock(iotHubClientInstance->event_pool_lock);
+        }
+    }
+
+    if (result == NULL)
+    {
+        result = (IOTHUB_QUEUE_CONTEXT*)malloc(sizeof(IOTHUB_QUEUE_CONTEXT));
+    }
+
+    if (result != NULL)
+    {
+        result->iotHubClientHandle = iotHubClientInstance;
+    }
+
+    return result;
+}
+
+static void release_event_queue_context(IOTHUB_QUEUE_CONTEXT* queue_context)
+{
+    IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance = queue_context->iotHubClientHandle;
+    bool pooled = false;
+
+    if (iotHubClientInstance->event_pool_lock != NULL)
+    {
+        if (Lock(iotHubClientInstance->event_pool_lock) != LOCK_OK)
+        {
+            LogError("failed locking event pool");
+        }
+        else
+        {
+            if (iotHubClientInstance->event_pool_count < iotHubClientInstance->event_pool_size)
+            {
+                iotHubClientInstance->event_pool[iotHubClientInstance->event_pool_count++] = queue_context;
+                pooled = true;
+            }
+            (void)Unlock(iotHubClientInstance->event_pool_lock);
+        }
+    }
+
+    if (!pooled)
+    {
+        free(queue_context);
+    }
+}
+
+/*grows or shrinks the pool so that it holds pool_size free contexts*/
+static IOTHUB_CLIENT_RESULT set_event_pool_size(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance, size_t pool_size)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if (pool_size > SIZE_MAX / sizeof(IOTHUB_QUEUE_CONTEXT*))
+    {
+        result = IOTHUB_CLIENT_ERROR;
+        LogError("Invalid value: OPTION_EVENT_POOL_SIZE is too large");
+    }
+    else if ((iotHubClientInstance->event_pool_lock == NULL) &&
+        ((iotHubClientInstance->event_pool_lock = Lock_Init()) == NULL))
+    {
+        result = IOTHUB_CLIENT_ERROR;
+        LogError("Lock_Init failed for event pool");
+    }
+    else if (Lock(iotHubClientInstance->event_pool_lock) != LOCK_OK)
+    {
+        result = IOTHUB_CLIENT_ERROR;
+        LogError("failed locking event pool");
+    }
+    else
+    {
+        while (iotHubClientInstance->event_pool_count > pool_size)
+        {
+            free(iotHubClientInstance->event_pool[--iotHubClientInstance->event_pool_count]);
+        }
+
+        if (pool_size > iotHubClientInstance->event_pool_size)
+        {
+            IOTHUB_QUEUE_CONTEXT** new_pool = (IOTHUB_QUEUE_CONTEXT**)realloc(iotHubClientInstance->event_pool, pool_size * sizeof(IOTHUB_QUEUE_CONTEXT*));
+            if (new_pool == NULL)
+            {
+                result = IOTHUB_CLIENT_ERROR;
+                LogError("Failed allocating event pool");
+            }
+            else
+            {
+                iotHubClientInstance->event_pool = new_pool;
+                iotHubClientInstance->event_pool_size = pool_size;
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        else
+        {
+            iotHubClientInstance->event_pool_size = pool_size;
+            result = IOTHUB_CLIENT_OK;
+        }
+
+        while ((result == IOTHUB_CLIENT_OK) && (iotHubClientInstance->event_pool_count < iotHubClientInstance->event_pool_size))
+        {
+            IOTHUB_QUEUE_CONTEXT* queue_context = (IOTHUB_QUEUE_CONTEXT*)malloc(sizeof(IOTHUB_QUEUE_CONTEXT));
+            if (queue_context == NULL)
+            {
+                result = IOTHUB_CLIENT_ERROR;
+                LogError("Failed pre-allocating event pool entries");
+            }
+            else
+            {
+                iotHubClientInstance->event_pool[iotHubClientInstance->event_pool_count++] = queue_context;
+            }
+        }
+
+        (void)Unlock(iotHubClientInstance->event_pool_lock);
+    }
+
+    return result;
+}
+
 typedef struct IOTHUB_QUEUE_CONSOLIDATED_CONTEXT_TAG
 {
     IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientHandle;
@@ -239,7 +463,7 @@ static void garbageCollectorImpl(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstan
             if (threadInfo->canBeGarbageCollected == 1)
             {
                 int notUsed;
-                if (ThreadAPI_Join(threadInfo->threadHandle, &notUsed) != THREADAPI_OK)
+                if ((threadInfo->runsOnHttpWorkerPool == 0) && (ThreadAPI_Join(threadInfo->threadHandle, &notUsed) != THREADAPI_OK))
                 {
                     LogError("unable to ThreadAPI_Join");
                 }
@@ -263,6 +487,199 @@ static void garbageCollectorImpl(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstan
 }
 
 
+static IOTHUB_CLIENT_RESULT create_http_worker_pool(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance, size_t thread_count)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if ((iotHubClientInstance->http_worker_queue = singlylinkedlist_create()) == NULL)
+    {
+        LogError("singlylinkedlist_create failed for http worker queue");
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else if ((iotHubClientInstance->http_worker_lock = Lock_Init()) == NULL)
+    {
+        LogError("Lock_Init failed for http worker pool");
+        singlylinkedlist_destroy(iotHubClientInstance->http_worker_queue);
+        iotHubClientInstance->http_worker_queue = NULL;
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else if ((iotHubClientInstance->http_worker_condition = Condition_Init()) == NULL)
+    {
+        LogError("Condition_Init failed for http worker pool");
+        Lock_Deinit(iotHubClientInstance->http_worker_lock);
+        iotHubClientInstance->http_worker_lock = NULL;
+        singlylinkedlist_destroy(iotHubClientInstance->http_worker_queue);
+        iotHubClientInstance->http_worker_queue = NULL;
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else if ((iotHubClientInstance->http_worker_threads = (THREAD_HANDLE*)malloc(thread_count * sizeof(THREAD_HANDLE))) == NULL)
+    {
+        LogError("Failed allocating http worker thread handles");
+        Condition_Deinit(iotHubClientInstance->http_worker_condition);
+        iotHubClientInstance->http_worker_condition = NULL;
+        Lock_Deinit(iotHubClientInstance->http_worker_lock);
+        iotHubClientInstance->http_worker_lock = NULL;
+        singlylinkedlist_destroy(iotHubClientInstance->http_worker_queue);
+        iotHubClientInstance->http_worker_queue = NULL;
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else
+    {
+        iotHubClientInstance->http_worker_thread_count = thread_count;
+        iotHubClientInstance->http_worker_threads_started = 0;
+        iotHubClientInstance->http_worker_threads_idle = 0;
+        iotHubClientInstance->stop_http_workers = 0;
+        result = IOTHUB_CLIENT_OK;
+    }
+
+    return result;
+}
+
+#if !defined(DONT_USE_UPLOADTOBLOB) || defined(USE_EDGE_MODULES)
+static int HttpWorker_Thread(void* threadArgument)
+{
+    IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_CORE_INSTANCE*)threadArgument;
+    int stop = 0;
+
+    while (stop == 0)
+    {
+        if (Lock(iotHubClientInstance->http_worker_lock) != LOCK_OK)
+        {
+            LogError("failed locking for HttpWorker_Thread");
+            (void)ThreadAPI_Sleep(DO_WORK_FREQ_DEFAULT);
+        }
+        else
+        {
+            HTTPWORKER_THREAD_INFO* threadInfo = NULL;
+            LIST_ITEM_HANDLE item = singlylinkedlist_get_head_item(iotHubClientInstance->http_worker_queue);
+
+            if ((item == NULL) && (iotHubClientInstance->stop_http_workers == 0))
+            {
+                /*Condition_Wait releases http_worker_lock while blocked and reacquires it before returning*/
+                iotHubClientInstance->http_worker_threads_idle++;
+                (void)Condition_Wait(iotHubClientInstance->http_worker_condition, iotHubClientInstance->http_worker_lock, 0);
+                iotHubClientInstance->http_worker_threads_idle--;
+                item = singlylinkedlist_get_head_item(iotHubClientInstance->http_worker_queue);
+            }
+
+            if (item != NULL)
+            {
+                /* Codes_SRS_IOTHUBCLIENT_41_037: [ A pool thread shall take the queued jobs in the order they were queued and run each one to completion without holding any client lock. ] */
+                threadInfo = (HTTPWORKER_THREAD_INFO*)singlylinkedlist_item_get_value(item);
+                (void)singlylinkedlist_remove(iotHubClientInstance->http_worker_queue, item);
+            }
+            else if (iotHubClientInstance->stop_http_workers != 0)
+            {
+                stop = 1;
+            }
+            (void)Unlock(iotHubClientInstance->http_worker_lock);
+
+            if (threadInfo != NULL)
+            {
+                /*threadInfo belongs to the garbage collector once the job marked it, it is not touched afterwards*/
+                (void)threadInfo->httpWorkerThreadFunc(threadInfo);
+            }
+        }
+    }
+
+    ThreadAPI_Exit(0);
+    return 0;
+}
+
+/*must be called with LockHandle held, after threadInfo was added to httpWorkerThreadInfoList*/
+static IOTHUB_CLIENT_RESULT queue_http_worker_job(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance, HTTPWORKER_THREAD_INFO* threadInfo)
+{
+    IOTHUB_CLIENT_RESULT result;
+    LIST_ITEM_HANDLE item;
+
+    if (Lock(iotHubClientInstance->http_worker_lock) != LOCK_OK)
+    {
+        LogError("failed locking for queue_http_worker_job");
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else
+    {
+        if ((item = singlylinkedlist_add(iotHubClientInstance->http_worker_queue, threadInfo)) == NULL)
+        {
+            LogError("Adding item to http worker queue failed");
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else
+        {
+            /* Codes_SRS_IOTHUBCLIENT_41_036: [ If `OPTION_HTTP_WORKER_THREADS` was set, the job shall be queued to the pool instead of spawning a thread, and a pool thread shall be started only when none is idle and fewer than `OPTION_HTTP_WORKER_THREADS` are running. ] */
+            if ((iotHubClientInstance->http_worker_threads_idle == 0) &&
+                (iotHubClientInstance->http_worker_threads_started < iotHubClientInstance->http_worker_thread_count))
+            {
+                if (ThreadAPI_Create(&iotHubClientInstance->http_worker_threads[iotHubClientInstance->http_worker_threads_started], HttpWorker_Thread, iotHubClientInstance) != THREADAPI_OK)
+                {
+                    LogError("ThreadAPI_Create failed for http worker thread, the job waits for a running one");
+                }
+                else
+                {
+                    iotHubClientInstance->http_worker_threads_started++;
+                }
+            }
+
+            if (iotHubClientInstance->http_worker_threads_started == 0)
+            {
+                LogError("no http worker thread is running");
+                (void)singlylinkedlist_remove(iotHubClientInstance->http_worker_queue, item);
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                if (Condition_Post(iotHubClientInstance->http_worker_condition) != COND_OK)
+                {
+                    LogError("Condition_Post failed");
+                }
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        (void)Unlock(iotHubClientInstance->http_worker_lock);
+    }
+
+    return result;
+}
+#endif // !defined(DONT_USE_UPLOADTOBLOB) || defined(USE_EDGE_MODULES)
+
+/*the pool threads run every job already queued before they exit*/
+static void stop_http_worker_pool(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance)
+{
+    size_t index;
+    int res;
+
+    if (Lock(iotHubClientInstance->http_worker_lock) != LOCK_OK)
+    {
+        LogError("unable to Lock - - will still proceed to try to end the http worker threads without locking");
+    }
+    iotHubClientInstance->stop_http_workers = 1;
+    for (index = 0; index < iotHubClientInstance->http_worker_threads_started; index++)
+    {
+        if (Condition_Post(iotHubClientInstance->http_worker_condition) != COND_OK)
+        {
+            LogError("Condition_Post failed");
+        }
+    }
+    if (Unlock(iotHubClientInstance->http_worker_lock) != LOCK_OK)
+    {
+        LogError("unable to Unlock");
+    }
+
+    for (index = 0; index < iotHubClientInstance->http_worker_threads_started; index++)
+    {
+        if (ThreadAPI_Join(iotHubClientInstance->http_worker_threads[index], &res) != THREADAPI_OK)
+        {
+            LogError("ThreadAPI_Join failed for http worker thread");
+        }
+    }
+
+    Condition_Deinit(iotHubClientInstance->http_worker_condition);
+    Lock_Deinit(iotHubClientInstance->http_worker_lock);
+    singlylinkedlist_destroy(iotHubClientInstance->http_worker_queue);
+    free(iotHubClientInstance->http_worker_threads);
+    iotHubClientInstance->http_worker_threads = NULL;
+}
+
 static bool iothub_ll_message_callback(MESSAGE_CALLBACK_INFO* messageData, void* userContextCallback)
 {
     bool result;
@@ -278,7 +695,7 @@ static bool iothub_ll_message_callback(MESSAGE_CALLBACK_INFO* messageData, void*
         queue_cb_info.type = CALLBACK_TYPE_MESSAGE;
         queue_cb_info.userContextCallback = queue_context->userContextCallback;
         queue_cb_info.iothub_callback.message_cb_info = messageData;
-        if (VECTOR_push_back(queue_context->iotHubClientHandle->saved_user_callback_list, &queue_cb_info, 1) == 0)
+        if (push_user_callback(queue_context->iotHubClientHandle, &queue_cb_info) == 0)
         {
             result = true;
         }
@@ -291,77 +708,510 @@ static bool iothub_ll_message_callback(MESSAGE_CALLBACK_INFO* messageData, void*
     return result;
 }
 
-static bool iothub_ll_inputmessage_callback(MESSAGE_CALLBACK_INFO* message_cb_info, void* userContextCallback)
+static bool iothub_ll_inputmessage_callback(MESSAGE_CALLBACK_INFO* message_cb_info, void* userContextCallback)
+{
+    bool result;
+    IOTHUB_INPUTMESSAGE_CALLBACK_CONTEXT *inputMessageCallbackContext = (IOTHUB_INPUTMESSAGE_CALLBACK_CONTEXT *)userContextCallback;
+    if (inputMessageCallbackContext == NULL)
+    {
+        LogError("invalid parameter userContextCallback(NULL)");
+        result = false;
+    }
+    else
+    {
+        USER_CALLBACK_INFO queue_cb_info;
+        queue_cb_info.type = CALLBACK_TYPE_INPUTMESSAGE;
+        queue_cb_info.userContextCallback = inputMessageCallbackContext->userContextCallback;
+        queue_cb_info.iothub_callback.inputmessage_cb_info.eventHandlerCallback = inputMessageCallbackContext->eventHandlerCallback;
+        queue_cb_info.iothub_callback.inputmessage_cb_info.message_cb_info = message_cb_info;
+
+        if (push_user_callback(inputMessageCallbackContext->iotHubClientHandle, &queue_cb_info) == 0)
+        {
+            result = true;
+        }
+        else
+        {
+            LogError("message callback vector push failed.");
+            result = false;
+        }
+    }
+
+    return result;
+}
+
+static int copy_method_callback_info(METHOD_CALLBACK_INFO* method_cb_info, const char* method_name, const unsigned char* payload, size_t size, METHOD_HANDLE method_id)
+{
+    int result;
+    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_002: [ IOTHUB_CLIENT_INBOUND_DEVICE_METHOD_CALLBACK shall copy the method_name and payload. ] */
+    method_cb_info->method_id = method_id;
+    method_cb_info->handler = NULL;
+    if ((method_cb_info->method_name = STRING_construct(method_name)) == NULL)
+    {
+        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_003: [ If a failure is encountered IOTHUB_CLIENT_INBOUND_DEVICE_METHOD_CALLBACK shall return a non-NULL value. ]*/
+        LogError("STRING_construct failed");
+        result = __FAILURE__;
+    }
+    else if ((method_cb_info->payload = BUFFER_create(payload, size)) == NULL)
+    {
+        STRING_delete(method_cb_info->method_name);
+        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_003: [ If a failure is encountered IOTHUB_CLIENT_INBOUND_DEVICE_METHOD_CALLBACK shall return a non-NULL value. ]*/
+        LogError("BUFFER_create failed");
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = 0;
+    }
+    return result;
+}
+
+static void free_method_callback_info(METHOD_CALLBACK_INFO* method_cb_info)
+{
+    BUFFER_delete(method_cb_info->payload);
+    STRING_delete(method_cb_info->method_name);
+}
+
+static int make_method_calback_queue_context(USER_CALLBACK_INFO* queue_cb_info, const char* method_name, const unsigned char* payload, size_t size, METHOD_HANDLE method_id, IOTHUB_QUEUE_CONTEXT* queue_context)
+{
+    int result;
+    queue_cb_info->userContextCallback = queue_context->userContextCallback;
+    if (copy_method_callback_info(&queue_cb_info->iothub_callback.method_cb_info, method_name, payload, size, method_id) != 0)
+    {
+        result = __FAILURE__;
+    }
+    else if (push_user_callback(queue_context->iotHubClientHandle, queue_cb_info) == 0)
+    {
+        result = 0;
+    }
+    else
+    {
+        STRING_delete(queue_cb_info->iothub_callback.method_cb_info.method_name);
+        BUFFER_delete(queue_cb_info->iothub_callback.method_cb_info.payload);
+        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_003: [ If a failure is encountered IOTHUB_CLIENT_INBOUND_DEVICE_METHOD_CALLBACK shall return a non-NULL value. ]*/
+        LogError("VECTOR_push_back failed");
+        result = __FAILURE__;
+    }
+    return result;
+}
+
+/*runs the callback without holding any lock, sends its response and frees method_cb_info*/
+static void invoke_device_method_callback(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle, IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC device_method_callback, void* userContextCallback, METHOD_CALLBACK_INFO* method_cb_info)
+{
+    const char* method_name = STRING_c_str(method_cb_info->method_name);
+    const unsigned char* payload = BUFFER_u_char(method_cb_info->payload);
+    size_t payload_len = BUFFER_length(method_cb_info->payload);
+
+    unsigned char* payload_resp = NULL;
+    size_t response_size = 0;
+    int status = device_method_callback(method_name, payload, payload_len, &payload_resp, &response_size, userContextCallback);
+
+    if (payload_resp && (response_size > 0))
+    {
+        IOTHUB_CLIENT_RESULT result = IoTHubClientCore_DeviceMethodResponse(iotHubClientHandle, method_cb_info->method_id, (const unsigned char*)payload_resp, response_size, status);
+        if (result != IOTHUB_CLIENT_OK)
+        {
+            LogError("IoTHubClientCore_LL_DeviceMethodResponse failed");
+        }
+    }
+
+    free_method_callback_info(method_cb_info);
+
+    if (payload_resp)
+    {
+        free(payload_resp);
+    }
+}
+
+static void run_method_handler(METHOD_HANDLER_INFO* handler, METHOD_CALLBACK_INFO* method_cb_info)
+{
+    IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC method_callback = NULL;
+    void* userContextCallback = NULL;
+
+    if (Lock(handler->iotHubClientHandle->LockHandle) != LOCK_OK)
+    {
+        LogError("failed locking for run_method_handler");
+    }
+    else
+    {
+        method_callback = handler->methodCallback;
+        userContextCallback = handler->userContextCallback;
+        (void)Unlock(handler->iotHubClientHandle->LockHandle);
+    }
+
+    if (method_callback != NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_41_043: [ A method handler callback shall be called without holding any client lock, and its response shall be sent with IoTHubClient_DeviceMethodResponse. ]*/
+        invoke_device_method_callback(handler->iotHubClientHandle, method_callback, userContextCallback, method_cb_info);
+    }
+    else
+    {
+        free_method_callback_info(method_cb_info);
+    }
+}
+
+/*the device method callback is read when the method runs, so a queued method answers to the callback set last*/
+static void run_method_invocation(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance, METHOD_CALLBACK_INFO* method_cb_info)
+{
+    if (method_cb_info->handler != NULL)
+    {
+        run_method_handler(method_cb_info->handler, method_cb_info);
+    }
+    else
+    {
+        IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC device_method_callback = NULL;
+        IOTHUB_CLIENT_INBOUND_DEVICE_METHOD_CALLBACK inbound_device_method_callback = NULL;
+        void* userContextCallback = NULL;
+
+        if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+        {
+            LogError("failed locking for run_method_invocation");
+        }
+        else
+        {
+            device_method_callback = iotHubClientInstance->device_method_callback;
+            inbound_device_method_callback = iotHubClientInstance->inbound_device_method_callback;
+            if (iotHubClientInstance->method_user_context != NULL)
+            {
+                userContextCallback = iotHubClientInstance->method_user_context->userContextCallback;
+            }
+            (void)Unlock(iotHubClientInstance->LockHandle);
+        }
+
+        if (device_method_callback != NULL)
+        {
+            invoke_device_method_callback(iotHubClientInstance, device_method_callback, userContextCallback, method_cb_info);
+        }
+        else
+        {
+            if (inbound_device_method_callback != NULL)
+            {
+                /*the method is answered later through IoTHubClientCore_DeviceMethodResponse, possibly after methods received after it*/
+                inbound_device_method_callback(STRING_c_str(method_cb_info->method_name), BUFFER_u_char(method_cb_info->payload), BUFFER_length(method_cb_info->payload), method_cb_info->method_id, userContextCallback);
+            }
+            free_method_callback_info(method_cb_info);
+        }
+    }
+}
+
+static int MethodWorker_Thread(void* threadArgument)
+{
+    METHOD_WORKER_POOL* pool = (METHOD_WORKER_POOL*)threadArgument;
+    int stop = 0;
+
+    while (stop == 0)
+    {
+        if (Lock(pool->lock) != LOCK_OK)
+        {
+            LogError("failed locking for MethodWorker_Thread");
+            (void)ThreadAPI_Sleep(DO_WORK_FREQ_DEFAULT);
+        }
+        else
+        {
+            METHOD_CALLBACK_INFO* method_cb_info = NULL;
+            LIST_ITEM_HANDLE item = singlylinkedlist_get_head_item(pool->queue);
+
+            if ((item == NULL) && (pool->stop == 0))
+            {
+                pool->threads_idle++;
+                (void)Condition_Wait(pool->condition, pool->lock, 0);
+                pool->threads_idle--;
+                item = singlylinkedlist_get_head_item(pool->queue);
+            }
+
+            if (item != NULL)
+            {
+                method_cb_info = (METHOD_CALLBACK_INFO*)singlylinkedlist_item_get_value(item);
+                (void)singlylinkedlist_remove(pool->queue, item);
+            }
+            else if (pool->stop != 0)
+            {
+                stop = 1;
+            }
+            (void)Unlock(pool->lock);
+
+            if (method_cb_info != NULL)
+            {
+                run_method_invocation(pool->iotHubClientHandle, method_cb_info);
+                free(method_cb_info);
+            }
+        }
+    }
+
+    ThreadAPI_Exit(0);
+    return 0;
+}
+
+static int queue_method_invocation(METHOD_WORKER_POOL* pool, METHOD_CALLBACK_INFO* method_cb_info)
+{
+    int result;
+    LIST_ITEM_HANDLE item;
+
+    if (Lock(pool->lock) != LOCK_OK)
+    {
+        LogError("failed locking for queue_method_invocation");
+        result = __FAILURE__;
+    }
+    else
+    {
+        if ((item = singlylinkedlist_add(pool->queue, method_cb_info)) == NULL)
+        {
+            LogError("Adding item to method worker queue failed");
+            result = __FAILURE__;
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBCLIENT_41_044: [ When workerThreadCount is not 0, invocations of the method shall be queued to its own threads, a thread being started only when none is idle and fewer than workerThreadCount are running. ]*/
+            if ((pool->threads_idle == 0) &&
+                (pool->threads_started < pool->thread_count))
+            {
+                if (ThreadAPI_Create(&pool->threads[pool->threads_started], MethodWorker_Thread, pool) != THREADAPI_OK)
+                {
+                    LogError("ThreadAPI_Create failed for method worker thread, the invocation waits for a running one");
+                }
+                else
+                {
+                    pool->threads_started++;
+                }
+            }
+
+            if (pool->threads_started == 0)
+            {
+                LogError("no method worker thread is running");
+                (void)singlylinkedlist_remove(pool->queue, item);
+                result = __FAILURE__;
+            }
+            else
+            {
+                if (Condition_Post(pool->condition) != COND_OK)
+                {
+                    LogError("Condition_Post failed");
+                }
+                result = 0;
+            }
+        }
+        (void)Unlock(pool->lock);
+    }
+
+    return result;
+}
+
+/*returns 0 when the invocation was queued, in which case the pool owns it*/
+static int queue_method_callback(METHOD_WORKER_POOL* pool, METHOD_HANDLER_INFO* handler, const char* method_name, const unsigned char* payload, size_t size, METHOD_HANDLE method_id)
+{
+    int result;
+    METHOD_CALLBACK_INFO* method_cb_info = (METHOD_CALLBACK_INFO*)malloc(sizeof(METHOD_CALLBACK_INFO));
+
+    if (method_cb_info == NULL)
+    {
+        LogError("failed allocating method invocation");
+        result = __FAILURE__;
+    }
+    else if (copy_method_callback_info(method_cb_info, method_name, payload, size, method_id) != 0)
+    {
+        free(method_cb_info);
+        result = __FAILURE__;
+    }
+    else
+    {
+        method_cb_info->handler = handler;
+        if (queue_method_invocation(pool, method_cb_info) != 0)
+        {
+            free_method_callback_info(method_cb_info);
+            free(method_cb_info);
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+static void destroy_method_worker_pool(METHOD_WORKER_POOL* pool)
+{
+    size_t index;
+    int res;
+
+    /*the worker threads run every invocation already queued before they exit*/
+    if (Lock(pool->lock) != LOCK_OK)
+    {
+        LogError("unable to Lock - - will still proceed to try to end the method worker threads without locking");
+    }
+    pool->stop = 1;
+    for (index = 0; index < pool->threads_started; index++)
+    {
+        if (Condition_Post(pool->condition) != COND_OK)
+        {
+            LogError("Condition_Post failed");
+        }
+    }
+    if (Unlock(pool->lock) != LOCK_OK)
+    {
+        LogError("unable to Unlock");
+    }
+
+    for (index = 0; index < pool->threads_started; index++)
+    {
+        if (ThreadAPI_Join(pool->threads[index], &res) != THREADAPI_OK)
+        {
+            LogError("ThreadAPI_Join failed for method worker thread");
+        }
+    }
+
+    Condition_Deinit(pool->condition);
+    Lock_Deinit(pool->lock);
+    singlylinkedlist_destroy(pool->queue);
+    free(pool->threads);
+    free(pool);
+}
+
+static METHOD_WORKER_POOL* create_method_worker_pool(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance, size_t thread_count)
+{
+    METHOD_WORKER_POOL* result;
+
+    if ((result = (METHOD_WORKER_POOL*)malloc(sizeof(METHOD_WORKER_POOL))) == NULL)
+    {
+        LogError("failed allocating method worker pool");
+    }
+    else
+    {
+        memset(result, 0, sizeof(METHOD_WORKER_POOL));
+        result->iotHubClientHandle = iotHubClientInstance;
+
+        if ((result->queue = singlylinkedlist_create()) == NULL)
+        {
+            LogError("singlylinkedlist_create failed");
+            free(result);
+            result = NULL;
+        }
+        else if ((result->lock = Lock_Init()) == NULL)
+        {
+            LogError("Lock_Init failed");
+            singlylinkedlist_destroy(result->queue);
+            free(result);
+            result = NULL;
+        }
+        else if ((result->condition = Condition_Init()) == NULL)
+        {
+            LogError("Condition_Init failed");
+            Lock_Deinit(result->lock);
+            singlylinkedlist_destroy(result->queue);
+            free(result);
+            result = NULL;
+        }
+        else if ((result->threads = (THREAD_HANDLE*)malloc(thread_count * sizeof(THREAD_HANDLE))) == NULL)
+        {
+            LogError("failed allocating %lu method worker threads", (unsigned long)thread_count);
+            Condition_Deinit(result->condition);
+            Lock_Deinit(result->lock);
+            singlylinkedlist_destroy(result->queue);
+            free(result);
+            result = NULL;
+        }
+        else
+        {
+            result->thread_count = thread_count;
+        }
+    }
+
+    return result;
+}
+
+static int iothub_ll_method_handler_callback(const char* method_name, const unsigned char* payload, size_t size, METHOD_HANDLE method_id, void* userContextCallback)
 {
-    bool result;
-    IOTHUB_INPUTMESSAGE_CALLBACK_CONTEXT *inputMessageCallbackContext = (IOTHUB_INPUTMESSAGE_CALLBACK_CONTEXT *)userContextCallback;
-    if (inputMessageCallbackContext == NULL)
+    int result;
+    if (userContextCallback == NULL)
     {
         LogError("invalid parameter userContextCallback(NULL)");
-        result = false;
+        result = __FAILURE__;
     }
     else
     {
-        USER_CALLBACK_INFO queue_cb_info;
-        queue_cb_info.type = CALLBACK_TYPE_INPUTMESSAGE;
-        queue_cb_info.userContextCallback = inputMessageCallbackContext->userContextCallback;
-        queue_cb_info.iothub_callback.inputmessage_cb_info.eventHandlerCallback = inputMessageCallbackContext->eventHandlerCallback;
-        queue_cb_info.iothub_callback.inputmessage_cb_info.message_cb_info = message_cb_info;
+        METHOD_HANDLER_INFO* handler = (METHOD_HANDLER_INFO*)userContextCallback;
+        METHOD_WORKER_POOL* pool = (handler->worker_pool != NULL) ? handler->worker_pool : handler->iotHubClientHandle->method_worker_pool;
 
-        if (VECTOR_push_back(inputMessageCallbackContext->iotHubClientHandle->saved_user_callback_list, &queue_cb_info, 1) == 0)
+        if (pool == NULL)
         {
-            result = true;
+            /*Codes_SRS_IOTHUBCLIENT_41_042: [ When workerThreadCount is 0, invocations of the method shall be delivered on the thread delivering every other callback, or queued to the OPTION_METHOD_WORKER_THREADS threads if set. ]*/
+            USER_CALLBACK_INFO queue_cb_info;
+            queue_cb_info.type = CALLBACK_TYPE_METHOD_HANDLER;
+            queue_cb_info.userContextCallback = NULL;
+
+            if (copy_method_callback_info(&queue_cb_info.iothub_callback.method_cb_info, method_name, payload, size, method_id) != 0)
+            {
+                result = __FAILURE__;
+            }
+            else
+            {
+                queue_cb_info.iothub_callback.method_cb_info.handler = handler;
+                if (push_user_callback(handler->iotHubClientHandle, &queue_cb_info) != 0)
+                {
+                    LogError("VECTOR_push_back failed");
+                    free_method_callback_info(&queue_cb_info.iothub_callback.method_cb_info);
+                    result = __FAILURE__;
+                }
+                else
+                {
+                    result = 0;
+                }
+            }
         }
         else
         {
-            LogError("message callback vector push failed.");
-            result = false;
+            result = queue_method_callback(pool, handler, method_name, payload, size, method_id);
         }
     }
-
     return result;
 }
 
-static int make_method_calback_queue_context(USER_CALLBACK_INFO* queue_cb_info, const char* method_name, const unsigned char* payload, size_t size, METHOD_HANDLE method_id, IOTHUB_QUEUE_CONTEXT* queue_context)
+static void destroy_method_handler(METHOD_HANDLER_INFO* handler)
 {
-    int result;
-    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_002: [ IOTHUB_CLIENT_INBOUND_DEVICE_METHOD_CALLBACK shall copy the method_name and payload. ] */
-    queue_cb_info->userContextCallback = queue_context->userContextCallback;
-    queue_cb_info->iothub_callback.method_cb_info.method_id = method_id;
-    if ((queue_cb_info->iothub_callback.method_cb_info.method_name = STRING_construct(method_name)) == NULL)
+    if (handler->worker_pool != NULL)
     {
-        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_003: [ If a failure is encountered IOTHUB_CLIENT_INBOUND_DEVICE_METHOD_CALLBACK shall return a non-NULL value. ]*/
-        LogError("STRING_construct failed");
-        result = __FAILURE__;
+        destroy_method_worker_pool(handler->worker_pool);
+    }
+    STRING_delete(handler->method_name);
+    free(handler);
+}
+
+static METHOD_HANDLER_INFO* create_method_handler(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance, const char* methodName, size_t workerThreadCount)
+{
+    METHOD_HANDLER_INFO* result;
+
+    if ((result = (METHOD_HANDLER_INFO*)malloc(sizeof(METHOD_HANDLER_INFO))) == NULL)
+    {
+        LogError("failed allocating method handler");
     }
     else
     {
-        if ((queue_cb_info->iothub_callback.method_cb_info.payload = BUFFER_create(payload, size)) == NULL)
+        memset(result, 0, sizeof(METHOD_HANDLER_INFO));
+        result->iotHubClientHandle = iotHubClientInstance;
+
+        if ((result->method_name = STRING_construct(methodName)) == NULL)
         {
-            STRING_delete(queue_cb_info->iothub_callback.method_cb_info.method_name);
-            /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_003: [ If a failure is encountered IOTHUB_CLIENT_INBOUND_DEVICE_METHOD_CALLBACK shall return a non-NULL value. ]*/
-            LogError("BUFFER_create failed");
-            result = __FAILURE__;
+            LogError("failed copying method name");
+            free(result);
+            result = NULL;
         }
-        else
+        else if ((workerThreadCount > 0) && ((result->worker_pool = create_method_worker_pool(iotHubClientInstance, workerThreadCount)) == NULL))
         {
-            if (VECTOR_push_back(queue_context->iotHubClientHandle->saved_user_callback_list, queue_cb_info, 1) == 0)
-            {
-                result = 0;
-            }
-            else
-            {
-                STRING_delete(queue_cb_info->iothub_callback.method_cb_info.method_name);
-                BUFFER_delete(queue_cb_info->iothub_callback.method_cb_info.payload);
-                /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_003: [ If a failure is encountered IOTHUB_CLIENT_INBOUND_DEVICE_METHOD_CALLBACK shall return a non-NULL value. ]*/
-                LogError("VECTOR_push_back failed");
-                result = __FAILURE__;
-            }
+            STRING_delete(result->method_name);
+            free(result);
+            result = NULL;
         }
     }
+
     return result;
 }
 
+static bool is_method_handler_for_match(LIST_ITEM_HANDLE list_item, const void* match_context)
+{
+    const METHOD_HANDLER_INFO* handler = (const METHOD_HANDLER_INFO*)singlylinkedlist_item_get_value(list_item);
+    return (strcmp(STRING_c_str(handler->method_name), (const char*)match_context) == 0);
+}
+
 static int iothub_ll_device_method_callback(const char* method_name, const unsigned char* payload, size_t size, METHOD_HANDLE method_id, void* userContextCallback)
 {
     int result;
@@ -375,14 +1225,22 @@ static int iothub_ll_device_method_callback(const char* method_name, const unsig
     {
         IOTHUB_QUEUE_CONTEXT* queue_context = (IOTHUB_QUEUE_CONTEXT*)userContextCallback;
 
-        USER_CALLBACK_INFO queue_cb_info;
-        queue_cb_info.type = CALLBACK_TYPE_DEVICE_METHOD;
-
-        result = make_method_calback_queue_context(&queue_cb_info, method_name, payload, size, method_id, queue_context);
-        if (result != 0)
+        if (queue_context->iotHubClientHandle->method_worker_pool != NULL)
         {
-            LogError("construction of method calback queue context failed");
-            result = __FAILURE__;
+            /*Codes_SRS_IOTHUBCLIENT_41_049: [ While OPTION_METHOD_WORKER_THREADS is set, the device method callback shall be called on those threads, so methods run concurrently and may be answered in any order. ]*/
+            result = queue_method_callback(queue_context->iotHubClientHandle->method_worker_pool, NULL, method_name, payload, size, method_id);
+        }
+        else
+        {
+            USER_CALLBACK_INFO queue_cb_info;
+            queue_cb_info.type = CALLBACK_TYPE_DEVICE_METHOD;
+
+            result = make_method_calback_queue_context(&queue_cb_info, method_name, payload, size, method_id, queue_context);
+            if (result != 0)
+            {
+                LogError("construction of method calback queue context failed");
+                result = __FAILURE__;
+            }
         }
     }
     return result;
@@ -401,14 +1259,21 @@ static int iothub_ll_inbound_device_method_callback(const char* method_name, con
     {
         IOTHUB_QUEUE_CONTEXT* queue_context = (IOTHUB_QUEUE_CONTEXT*)userContextCallback;
 
-        USER_CALLBACK_INFO queue_cb_info;
-        queue_cb_info.type = CALLBACK_TYPE_INBOUD_DEVICE_METHOD;
-
-        result = make_method_calback_queue_context(&queue_cb_info, method_name, payload, size, method_id, queue_context);
-        if (result != 0)
+        if (queue_context->iotHubClientHandle->method_worker_pool != NULL)
         {
-            LogError("construction of method calback queue context failed");
-            result = __FAILURE__;
+            result = queue_method_callback(queue_context->iotHubClientHandle->method_worker_pool, NULL, method_name, payload, size, method_id);
+        }
+        else
+        {
+            USER_CALLBACK_INFO queue_cb_info;
+            queue_cb_info.type = CALLBACK_TYPE_INBOUD_DEVICE_METHOD;
+
+            result = make_method_calback_queue_context(&queue_cb_info, method_name, payload, size, method_id, queue_context);
+            if (result != 0)
+            {
+                LogError("construction of method calback queue context failed");
+                result = __FAILURE__;
+            }
         }
     }
     return result;
@@ -424,7 +1289,7 @@ static void iothub_ll_connection_status_callback(IOTHUB_CLIENT_CONNECTION_STATUS
         queue_cb_info.userContextCallback = queue_context->userContextCallback;
         queue_cb_info.iothub_callback.connection_status_cb_info.status_reason = reason;
         queue_cb_info.iothub_callback.connection_status_cb_info.connection_status = result;
-        if (VECTOR_push_back(queue_context->iotHubClientHandle->saved_user_callback_list, &queue_cb_info, 1) != 0)
+        if (push_user_callback(queue_context->iotHubClientHandle, &queue_cb_info) != 0)
         {
             LogError("connection status callback vector push failed.");
         }
@@ -440,11 +1305,36 @@ static void iothub_ll_event_confirm_callback(IOTHUB_CLIENT_CONFIRMATION_RESULT r
         queue_cb_info.type = CALLBACK_TYPE_EVENT_CONFIRM;
         queue_cb_info.userContextCallback = queue_context->userContextCallback;
         queue_cb_info.iothub_callback.event_confirm_cb_info.confirm_result = result;
-        if (VECTOR_push_back(queue_context->iotHubClientHandle->saved_user_callback_list, &queue_cb_info, 1) != 0)
+        if (push_user_callback(queue_context->iotHubClientHandle, &queue_cb_info) != 0)
         {
             LogError("event confirm callback vector push failed.");
         }
-        free(queue_context);
+        /* Codes_SRS_IOTHUBCLIENT_41_028: [ Event confirmation contexts shall be returned to the pool while it holds fewer than `OPTION_EVENT_POOL_SIZE` entries, and freed otherwise. ] */
+        release_event_queue_context(queue_context);
+    }
+}
+
+static void iothub_ll_event_confirm_batch_callback(const IOTHUB_CLIENT_EVENT_CONFIRMATION* confirmations, size_t confirmationCount, void* userContextCallback)
+{
+    IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_CORE_INSTANCE*)userContextCallback;
+    USER_CALLBACK_INFO queue_cb_info;
+
+    /* Codes_SRS_IOTHUBCLIENT_41_023: [ Each batch reported by the LL layer shall be copied with a single allocation and queued as one user callback. ] */
+    queue_cb_info.type = CALLBACK_TYPE_EVENT_CONFIRM_BATCH;
+    queue_cb_info.userContextCallback = iotHubClientInstance->event_confirm_batch_user_context;
+    queue_cb_info.iothub_callback.event_confirm_batch_cb_info.count = confirmationCount;
+    if ((queue_cb_info.iothub_callback.event_confirm_batch_cb_info.confirmations = (IOTHUB_CLIENT_EVENT_CONFIRMATION*)malloc(confirmationCount * sizeof(IOTHUB_CLIENT_EVENT_CONFIRMATION))) == NULL)
+    {
+        LogError("failed allocating %lu batched confirmations", (unsigned long)confirmationCount);
+    }
+    else
+    {
+        (void)memcpy(queue_cb_info.iothub_callback.event_confirm_batch_cb_info.confirmations, confirmations, confirmationCount * sizeof(IOTHUB_CLIENT_EVENT_CONFIRMATION));
+        if (push_user_callback(iotHubClientInstance, &queue_cb_info) != 0)
+        {
+            LogError("event confirm batch callback vector push failed.");
+            free(queue_cb_info.iothub_callback.event_confirm_batch_cb_info.confirmations);
+        }
     }
 }
 
@@ -457,7 +1347,7 @@ static void iothub_ll_reported_state_callback(int status_code, void* userContext
         queue_cb_info.type = CALLBACK_TYPE_REPORTED_STATE;
         queue_cb_info.userContextCallback = queue_context->userContextCallback;
         queue_cb_info.iothub_callback.reported_state_cb_info.status_code = status_code;
-        if (VECTOR_push_back(queue_context->iotHubClientHandle->saved_user_callback_list, &queue_cb_info, 1) != 0)
+        if (push_user_callback(queue_context->iotHubClientHandle, &queue_cb_info) != 0)
         {
             LogError("reported state callback vector push failed.");
         }
@@ -503,7 +1393,7 @@ static void iothub_ll_device_twin_callback(DEVICE_TWIN_UPDATE_STATE update_state
         }
         if (push_to_vector == 0)
         {
-            if (VECTOR_push_back(queue_context->iotHubClientHandle->saved_user_callback_list, &queue_cb_info, 1) != 0)
+            if (push_user_callback(queue_context->iotHubClientHandle, &queue_cb_info) != 0)
             {
                 if (queue_cb_info.iothub_callback.dev_twin_cb_info.payLoad != NULL)
                 {
@@ -553,7 +1443,7 @@ static void iothub_ll_get_device_twin_async_callback(DEVICE_TWIN_UPDATE_STATE up
             }
         }
 
-        if (VECTOR_push_back(queue_context->iotHubClientHandle->saved_user_callback_list, &queue_cb_info, 1) != 0)
+        if (push_user_callback(queue_context->iotHubClientHandle, &queue_cb_info) != 0)
         {
             LogError("device twin callback userContextCallback vector push failed.");
 
@@ -576,6 +1466,7 @@ static void dispatch_user_callbacks(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientIns
 
     IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK desired_state_callback = NULL;
     IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK event_confirm_callback = NULL;
+    IOTHUB_CLIENT_EVENT_CONFIRMATION_BATCH_CALLBACK event_confirm_batch_callback = NULL;
     IOTHUB_CLIENT_REPORTED_STATE_CALLBACK reported_state_callback = NULL;
     IOTHUB_CLIENT_CONNECTION_STATUS_CALLBACK connection_status_callback = NULL;
     IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC device_method_callback = NULL;
@@ -593,6 +1484,7 @@ static void dispatch_user_callbacks(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientIns
     {
         desired_state_callback = iotHubClientInstance->desired_state_callback;
         event_confirm_callback = iotHubClientInstance->event_confirm_callback;
+        event_confirm_batch_callback = iotHubClientInstance->event_confirm_batch_callback;
         reported_state_callback = iotHubClientInstance->reported_state_callback;
         connection_status_callback = iotHubClientInstance->connection_status_callback;
         device_method_callback = iotHubClientInstance->device_method_callback;
@@ -652,6 +1544,14 @@ static void dispatch_user_callbacks(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientIns
                     event_confirm_callback(queued_cb->iothub_callback.event_confirm_cb_info.confirm_result, queued_cb->userContextCallback);
                 }
                 break;
+            case CALLBACK_TYPE_EVENT_CONFIRM_BATCH:
+                /* Codes_SRS_IOTHUBCLIENT_41_024: [ A queued batch shall be delivered with one call to the batch callback passing the whole array. ] */
+                if (event_confirm_batch_callback)
+                {
+                    event_confirm_batch_callback(queued_cb->iothub_callback.event_confirm_batch_cb_info.confirmations, queued_cb->iothub_callback.event_confirm_batch_cb_info.count, queued_cb->userContextCallback);
+                }
+                free(queued_cb->iothub_callback.event_confirm_batch_cb_info.confirmations);
+                break;
             case CALLBACK_TYPE_REPORTED_STATE:
                 if (reported_state_callback)
                 {
@@ -667,32 +1567,12 @@ static void dispatch_user_callbacks(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientIns
             case CALLBACK_TYPE_DEVICE_METHOD:
                 if (device_method_callback)
                 {
-                    const char* method_name = STRING_c_str(queued_cb->iothub_callback.method_cb_info.method_name);
-                    const unsigned char* payload = BUFFER_u_char(queued_cb->iothub_callback.method_cb_info.payload);
-                    size_t payload_len = BUFFER_length(queued_cb->iothub_callback.method_cb_info.payload);
-
-                    unsigned char* payload_resp = NULL;
-                    size_t response_size = 0;
-                    int status = device_method_callback(method_name, payload, payload_len, &payload_resp, &response_size, queued_cb->userContextCallback);
-
-                    if (payload_resp && (response_size > 0))
-                    {
-                        IOTHUB_CLIENT_RESULT result = IoTHubClientCore_DeviceMethodResponse(method_user_context_handle, queued_cb->iothub_callback.method_cb_info.method_id, (const unsigned char*)payload_resp, response_size, status);
-                        if (result != IOTHUB_CLIENT_OK)
-                        {
-                            LogError("IoTHubClientCore_LL_DeviceMethodResponse failed");
-                        }
-                    }
-
-                    BUFFER_delete(queued_cb->iothub_callback.method_cb_info.payload);
-                    STRING_delete(queued_cb->iothub_callback.method_cb_info.method_name);
-
-                    if (payload_resp)
-                    {
-                        free(payload_resp);
-                    }
+                    invoke_device_method_callback(method_user_context_handle, device_method_callback, queued_cb->userContextCallback, &queued_cb->iothub_callback.method_cb_info);
                 }
                 break;
+            case CALLBACK_TYPE_METHOD_HANDLER:
+                run_method_handler(queued_cb->iothub_callback.method_cb_info.handler, &queued_cb->iothub_callback.method_cb_info);
+                break;
             case CALLBACK_TYPE_INBOUD_DEVICE_METHOD:
                 if (inbound_device_method_callback)
                 {
@@ -748,13 +1628,333 @@ static void dispatch_user_callbacks(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientIns
                 }
                 break;
 
-            default:
-                LogError("Invalid callback type '%s'", ENUM_TO_STRING(USER_CALLBACK_TYPE, queued_cb->type));
-                break;
+            default:
+                LogError("Invalid callback type '%s'", ENUM_TO_STRING(USER_CALLBACK_TYPE, queued_cb->type));
+                break;
+            }
+        }
+    }
+    VECTOR_destroy(call_backs);
+}
+
+static int CallbackDispatch_Thread(void* threadArgument)
+{
+    IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_CORE_INSTANCE*)threadArgument;
+    int stop = 0;
+
+    while (stop == 0)
+    {
+        if (Lock(iotHubClientInstance->callback_dispatch_lock) != LOCK_OK)
+        {
+            LogError("failed locking for CallbackDispatch_Thread");
+            (void)ThreadAPI_Sleep(DO_WORK_FREQ_DEFAULT);
+        }
+        else
+        {
+            VECTOR_HANDLE call_backs = NULL;
+
+            if ((VECTOR_size(iotHubClientInstance->callback_dispatch_list) == 0) && (iotHubClientInstance->stop_callback_dispatch == 0))
+            {
+                /*Condition_Wait releases callback_dispatch_lock while blocked and reacquires it before returning*/
+                (void)Condition_Wait(iotHubClientInstance->callback_dispatch_condition, iotHubClientInstance->callback_dispatch_lock, 0);
+            }
+
+            if (VECTOR_size(iotHubClientInstance->callback_dispatch_list) != 0)
+            {
+                /* Codes_SRS_IOTHUBCLIENT_41_020: [ The dispatch thread shall take every callback handed over so far in a single swap and invoke them in order without holding any client lock. ] */
+                call_backs = VECTOR_move(iotHubClientInstance->callback_dispatch_list);
+            }
+            else if (iotHubClientInstance->stop_callback_dispatch != 0)
+            {
+                stop = 1;
+            }
+            (void)Unlock(iotHubClientInstance->callback_dispatch_lock);
+
+            if (call_backs != NULL)
+            {
+                dispatch_user_callbacks(iotHubClientInstance, call_backs);
+            }
+        }
+    }
+
+    ThreadAPI_Exit(0);
+    return 0;
+}
+
+static void deliver_user_callbacks(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance, VECTOR_HANDLE call_backs)
+{
+    size_t callbacks_length;
+
+    if (iotHubClientInstance->callback_dispatch_thread == NULL)
+    {
+        dispatch_user_callbacks(iotHubClientInstance, call_backs);
+    }
+    else if ((callbacks_length = VECTOR_size(call_backs)) == 0)
+    {
+        VECTOR_destroy(call_backs);
+    }
+    else if (Lock(iotHubClientInstance->callback_dispatch_lock) != LOCK_OK)
+    {
+        LogError("failed locking for deliver_user_callbacks, dispatching on the worker thread");
+        dispatch_user_callbacks(iotHubClientInstance, call_backs);
+    }
+    else
+    {
+        /* Codes_SRS_IOTHUBCLIENT_41_019: [ When a dispatch thread is running, the worker shall append the moved callbacks to the dispatch list and signal the dispatch thread instead of invoking them itself. ] */
+        if (VECTOR_push_back(iotHubClientInstance->callback_dispatch_list, VECTOR_front(call_backs), callbacks_length) != 0)
+        {
+            (void)Unlock(iotHubClientInstance->callback_dispatch_lock);
+            LogError("VECTOR_push_back failed, dispatching on the worker thread");
+            dispatch_user_callbacks(iotHubClientInstance, call_backs);
+        }
+        else
+        {
+            if (Condition_Post(iotHubClientInstance->callback_dispatch_condition) != COND_OK)
+            {
+                LogError("Condition_Post failed");
+            }
+            (void)Unlock(iotHubClientInstance->callback_dispatch_lock);
+            VECTOR_destroy(call_backs);
+        }
+    }
+}
+
+static IOTHUB_CLIENT_RESULT start_callback_dispatch_thread(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if ((iotHubClientInstance->callback_dispatch_list = VECTOR_create(sizeof(USER_CALLBACK_INFO))) == NULL)
+    {
+        LogError("VECTOR_create failed for callback dispatch list");
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else if ((iotHubClientInstance->callback_dispatch_lock = Lock_Init()) == NULL)
+    {
+        LogError("Lock_Init failed for callback dispatch");
+        VECTOR_destroy(iotHubClientInstance->callback_dispatch_list);
+        iotHubClientInstance->callback_dispatch_list = NULL;
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else if ((iotHubClientInstance->callback_dispatch_condition = Condition_Init()) == NULL)
+    {
+        LogError("Condition_Init failed for callback dispatch");
+        Lock_Deinit(iotHubClientInstance->callback_dispatch_lock);
+        iotHubClientInstance->callback_dispatch_lock = NULL;
+        VECTOR_destroy(iotHubClientInstance->callback_dispatch_list);
+        iotHubClientInstance->callback_dispatch_list = NULL;
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else
+    {
+        iotHubClientInstance->stop_callback_dispatch = 0;
+        if (ThreadAPI_Create(&iotHubClientInstance->callback_dispatch_thread, CallbackDispatch_Thread, iotHubClientInstance) != THREADAPI_OK)
+        {
+            LogError("ThreadAPI_Create failed for callback dispatch thread");
+            iotHubClientInstance->callback_dispatch_thread = NULL;
+            Condition_Deinit(iotHubClientInstance->callback_dispatch_condition);
+            iotHubClientInstance->callback_dispatch_condition = NULL;
+            Lock_Deinit(iotHubClientInstance->callback_dispatch_lock);
+            iotHubClientInstance->callback_dispatch_lock = NULL;
+            VECTOR_destroy(iotHubClientInstance->callback_dispatch_list);
+            iotHubClientInstance->callback_dispatch_list = NULL;
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else
+        {
+            result = IOTHUB_CLIENT_OK;
+        }
+    }
+
+    return result;
+}
+
+/*the dispatch thread delivers everything already handed over before it exits*/
+static void stop_callback_dispatch_thread(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance)
+{
+    int res;
+
+    if (Lock(iotHubClientInstance->callback_dispatch_lock) != LOCK_OK)
+    {
+        LogError("unable to Lock - - will still proceed to try to end the dispatch thread without locking");
+    }
+    iotHubClientInstance->stop_callback_dispatch = 1;
+    if (Condition_Post(iotHubClientInstance->callback_dispatch_condition) != COND_OK)
+    {
+        LogError("Condition_Post failed");
+    }
+    if (Unlock(iotHubClientInstance->callback_dispatch_lock) != LOCK_OK)
+    {
+        LogError("unable to Unlock");
+    }
+
+    if (ThreadAPI_Join(iotHubClientInstance->callback_dispatch_thread, &res) != THREADAPI_OK)
+    {
+        LogError("ThreadAPI_Join failed for callback dispatch thread");
+    }
+
+    Condition_Deinit(iotHubClientInstance->callback_dispatch_condition);
+    Lock_Deinit(iotHubClientInstance->callback_dispatch_lock);
+    VECTOR_destroy(iotHubClientInstance->callback_dispatch_list);
+    iotHubClientInstance->callback_dispatch_thread = NULL;
+}
+
+static void signal_work_available(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance)
+{
+    if (iotHubClientInstance->worker_pool_item != NULL)
+    {
+        /* Codes_SRS_IOTHUBCLIENT_41_059: [ When a worker pool is used and `do_work_max_idle_ms` is set, API calls that post new work shall make the client due on the pool with `IoTHubClientWorkerPool_Wake`. ] */
+        if (iotHubClientInstance->do_work_max_idle_ms != 0)
+        {
+            IoTHubClientWorkerPool_Wake(iotHubClientInstance->worker_pool, iotHubClientInstance->worker_pool_item);
+        }
+    }
+    else if (iotHubClientInstance->do_work_condition != NULL)
+    {
+        if (Lock(iotHubClientInstance->do_work_lock) != LOCK_OK)
+        {
+            LogError("failed locking for signaling the worker");
+        }
+        else
+        {
+            iotHubClientInstance->do_work_pending = 1;
+            if (Condition_Post(iotHubClientInstance->do_work_condition) != COND_OK)
+            {
+                LogError("Condition_Post failed");
+            }
+            (void)Unlock(iotHubClientInstance->do_work_lock);
+        }
+    }
+}
+
+/*must be called with LockHandle held*/
+static void drain_submission_queue(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance)
+{
+    size_t drained;
+    size_t index;
+
+    if (Lock(iotHubClientInstance->submission_lock) != LOCK_OK)
+    {
+        LogError("failed locking submission queue");
+        drained = 0;
+    }
+    else
+    {
+        /*copy out in FIFO order so producers are released before any LL work starts*/
+        drained = iotHubClientInstance->submission_count;
+        for (index = 0; index < drained; index++)
+        {
+            iotHubClientInstance->submission_drain_buffer[index] = iotHubClientInstance->submission_ring[(iotHubClientInstance->submission_head + index) % iotHubClientInstance->submission_capacity];
+        }
+        iotHubClientInstance->submission_head = 0;
+        iotHubClientInstance->submission_count = 0;
+        (void)Unlock(iotHubClientInstance->submission_lock);
+    }
+
+    for (index = 0; index < drained; index++)
+    {
+        SUBMISSION_RECORD* record = &iotHubClientInstance->submission_drain_buffer[index];
+        IOTHUB_CLIENT_RESULT result;
+
+        iotHubClientInstance->event_confirm_callback = record->eventConfirmationCallback;
+        /*the queued message is already a private copy (or was handed over), so the LL layer takes it as is*/
+        if (record->queue_context == NULL)
+        {
+            result = IoTHubClientCore_LL_SendEventAsync_TakeOwnership(iotHubClientInstance->IoTHubClientLLHandle, record->message, NULL, record->userContextCallback);
+        }
+        else
+        {
+            result = IoTHubClientCore_LL_SendEventAsync_TakeOwnership(iotHubClientInstance->IoTHubClientLLHandle, record->message, iothub_ll_event_confirm_callback, record->queue_context);
+            if (result != IOTHUB_CLIENT_OK)
+            {
+                /*the caller already got IOTHUB_CLIENT_OK, so the failure is reported through the confirmation*/
+                iothub_ll_event_confirm_callback(IOTHUB_CLIENT_CONFIRMATION_ERROR, record->queue_context);
+            }
+        }
+
+        if (result != IOTHUB_CLIENT_OK)
+        {
+            LogError("IoTHubClientCore_LL_SendEventAsync failed for a queued submission");
+            IoTHubMessage_Destroy(record->message);
+        }
+    }
+}
+
+/*returns 0 if the message was queued, non-zero if the caller has to fall back to the locked path*/
+static int submit_event(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback, bool takeOwnership, IOTHUB_CLIENT_RESULT* result)
+{
+    int queued = __FAILURE__;
+    bool was_empty = false;
+    SUBMISSION_RECORD record;
+
+    record.eventConfirmationCallback = eventConfirmationCallback;
+    record.queue_context = NULL;
+    record.userContextCallback = userContextCallback;
+
+    if ((record.message = (takeOwnership ? eventMessageHandle : IoTHubMessage_Clone(eventMessageHandle))) == NULL)
+    {
+        LogError("IoTHubMessage_Clone failed");
+        *result = IOTHUB_CLIENT_ERROR;
+        queued = 0;
+    }
+    else if ((eventConfirmationCallback != NULL) &&
+        ((record.queue_context = get_event_queue_context(iotHubClientInstance)) == NULL))
+    {
+        LogError("Failed allocating QUEUE_CONTEXT");
+        if (!takeOwnership)
+        {
+            IoTHubMessage_Destroy(record.message);
+        }
+        *result = IOTHUB_CLIENT_ERROR;
+        queued = 0;
+    }
+    else
+    {
+        if (record.queue_context != NULL)
+        {
+            record.queue_context->userContextCallback = userContextCallback;
+        }
+
+        if (Lock(iotHubClientInstance->submission_lock) != LOCK_OK)
+        {
+            LogError("failed locking submission queue");
+        }
+        else
+        {
+            if (iotHubClientInstance->submission_count < iotHubClientInstance->submission_capacity)
+            {
+                was_empty = (iotHubClientInstance->submission_count == 0);
+                iotHubClientInstance->submission_ring[(iotHubClientInstance->submission_head + iotHubClientInstance->submission_count) % iotHubClientInstance->submission_capacity] = record;
+                iotHubClientInstance->submission_count++;
+                *result = IOTHUB_CLIENT_OK;
+                queued = 0;
+            }
+            else
+            {
+                iotHubClientInstance->submission_contention_count++;
+            }
+            (void)Unlock(iotHubClientInstance->submission_lock);
+        }
+
+        if (queued != 0)
+        {
+            if (record.queue_context != NULL)
+            {
+                release_event_queue_context(record.queue_context);
+            }
+            if (!takeOwnership)
+            {
+                IoTHubMessage_Destroy(record.message);
             }
         }
+        else if (was_empty &&
+            ((iotHubClientInstance->do_work_condition != NULL) || (iotHubClientInstance->worker_pool_item != NULL)))
+        {
+            /* Codes_SRS_IOTHUBCLIENT_41_060: [ When a submission makes the queue non-empty, `IoTHubClient_SendEventAsync` shall signal the worker without taking the client lock; the worker shall re-check the submission queue under the lock it waits with, so the wakeup cannot be lost between the worker checking for work and waiting. ] */
+            signal_work_available(iotHubClientInstance);
+        }
     }
-    VECTOR_destroy(call_backs);
+
+    return queued;
 }
 
 static void ScheduleWork_Thread_ForMultiplexing(void* iotHubClientHandle)
@@ -773,7 +1973,7 @@ static void ScheduleWork_Thread_ForMultiplexing(void* iotHubClientHandle)
         }
         else
         {
-            dispatch_user_callbacks(iotHubClientInstance, call_backs);
+            deliver_user_callbacks(iotHubClientInstance, call_backs);
         }
     }
     else
@@ -782,10 +1982,82 @@ static void ScheduleWork_Thread_ForMultiplexing(void* iotHubClientHandle)
     }
 }
 
+static unsigned int ScheduleWork_ForWorkerPool(void* iotHubClientHandle)
+{
+    IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_CORE_INSTANCE*)iotHubClientHandle;
+    unsigned int result = DO_WORK_FREQ_DEFAULT;
+
+    /* Codes_SRS_IOTHUBCLIENT_41_011: [ When a worker pool is used, each scheduled run shall perform one iteration of the worker thread loop and return `do_work_freq_ms` as the delay until the next run. ] */
+    if (Lock(iotHubClientInstance->LockHandle) == LOCK_OK)
+    {
+        if (iotHubClientInstance->submission_ring != NULL)
+        {
+            drain_submission_queue(iotHubClientInstance);
+        }
+        IoTHubClientCore_LL_DoWork(iotHubClientInstance->IoTHubClientLLHandle);
+
+        garbageCollectorImpl(iotHubClientInstance);
+        VECTOR_HANDLE call_backs = VECTOR_move(iotHubClientInstance->saved_user_callback_list);
+        result = iotHubClientInstance->do_work_freq_ms;
+        if (iotHubClientInstance->do_work_max_idle_ms != 0)
+        {
+            /* Codes_SRS_IOTHUBCLIENT_41_058: [ When a worker pool is used and `do_work_max_idle_ms` is set, a run that leaves no outstanding sends shall return `do_work_max_idle_ms` instead of `do_work_freq_ms`. ] */
+            IOTHUB_CLIENT_STATUS send_status;
+            if ((IoTHubClientCore_LL_GetSendStatus(iotHubClientInstance->IoTHubClientLLHandle, &send_status) == IOTHUB_CLIENT_OK) &&
+                (send_status == IOTHUB_CLIENT_SEND_STATUS_IDLE))
+            {
+                result = iotHubClientInstance->do_work_max_idle_ms;
+            }
+        }
+        (void)Unlock(iotHubClientInstance->LockHandle);
+        if (call_backs == NULL)
+        {
+            LogError("VECTOR_move failed");
+        }
+        else
+        {
+            deliver_user_callbacks(iotHubClientInstance, call_backs);
+        }
+    }
+    else
+    {
+        LogError("failed locking for ScheduleWork_ForWorkerPool");
+    }
+
+    return result;
+}
+
+static void wait_for_work(IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance, unsigned int timeout_in_ms)
+{
+    if (Lock(iotHubClientInstance->do_work_lock) == LOCK_OK)
+    {
+        size_t queued = 0;
+        /*a submission queued after the last drain may have signaled before do_work_pending was cleared by the previous wait*/
+        if ((iotHubClientInstance->submission_ring != NULL) && (Lock(iotHubClientInstance->submission_lock) == LOCK_OK))
+        {
+            queued = iotHubClientInstance->submission_count;
+            (void)Unlock(iotHubClientInstance->submission_lock);
+        }
+        if ((iotHubClientInstance->do_work_pending == 0) && (iotHubClientInstance->StopThread == 0) && (queued == 0))
+        {
+            /*Condition_Wait releases do_work_lock while blocked and reacquires it before returning*/
+            (void)Condition_Wait(iotHubClientInstance->do_work_condition, iotHubClientInstance->do_work_lock, (int)timeout_in_ms);
+        }
+        iotHubClientInstance->do_work_pending = 0;
+        (void)Unlock(iotHubClientInstance->do_work_lock);
+    }
+    else
+    {
+        LogError("failed locking for wait_for_work");
+        (void)ThreadAPI_Sleep(DO_WORK_FREQ_DEFAULT);
+    }
+}
+
 static int ScheduleWork_Thread(void* threadArgument)
 {
     IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_CORE_INSTANCE*)threadArgument;
     uint16_t sleeptime_in_ms = DO_WORK_FREQ_DEFAULT;
+    unsigned int waittime_in_ms = 0;
     while (1)
     {
         if (Lock(iotHubClientInstance->LockHandle) == LOCK_OK)
@@ -800,11 +2072,34 @@ static int ScheduleWork_Thread(void* threadArgument)
             {
                 /* Codes_SRS_IOTHUBCLIENT_01_037: [The thread created by IoTHubClient_SendEvent or IoTHubClient_SetMessageCallback shall call IoTHubClientCore_LL_DoWork every 1 ms by default.] */
                 /* Codes_SRS_IOTHUBCLIENT_01_039: [All calls to IoTHubClientCore_LL_DoWork shall be protected by the lock created in IotHubClient_Create.] */
+                if (iotHubClientInstance->submission_ring != NULL)
+                {
+                    /* Codes_SRS_IOTHUBCLIENT_41_016: [ The worker shall hand all queued submissions to `IoTHubClientCore_LL_SendEventAsync` before calling `IoTHubClientCore_LL_DoWork`. ] */
+                    drain_submission_queue(iotHubClientInstance);
+                }
                 IoTHubClientCore_LL_DoWork(iotHubClientInstance->IoTHubClientLLHandle);
 
                 garbageCollectorImpl(iotHubClientInstance);
                 VECTOR_HANDLE call_backs = VECTOR_move(iotHubClientInstance->saved_user_callback_list);
                 sleeptime_in_ms = iotHubClientInstance->do_work_freq_ms; // Update the sleepval within the locked thread. 
+                if ((iotHubClientInstance->do_work_condition != NULL) && (iotHubClientInstance->do_work_max_idle_ms != 0))
+                {
+                    /* Codes_SRS_IOTHUBCLIENT_41_009: [ While the client has outstanding sends the thread shall keep waking every `do_work_freq_ms`, otherwise it shall block for at most `do_work_max_idle_ms` or until an API call posts new work. ] */
+                    IOTHUB_CLIENT_STATUS send_status;
+                    if ((IoTHubClientCore_LL_GetSendStatus(iotHubClientInstance->IoTHubClientLLHandle, &send_status) != IOTHUB_CLIENT_OK) ||
+                        (send_status == IOTHUB_CLIENT_SEND_STATUS_BUSY))
+                    {
+                        waittime_in_ms = sleeptime_in_ms;
+                    }
+                    else
+                    {
+                        waittime_in_ms = iotHubClientInstance->do_work_max_idle_ms;
+                    }
+                }
+                else
+                {
+                    waittime_in_ms = 0;
+                }
                 (void)Unlock(iotHubClientInstance->LockHandle);
                 if (call_backs == NULL)
                 {
@@ -812,7 +2107,7 @@ static int ScheduleWork_Thread(void* threadArgument)
                 }
                 else
                 {
-                    dispatch_user_callbacks(iotHubClientInstance, call_backs);
+                    deliver_user_callbacks(iotHubClientInstance, call_backs);
                 }
 
     
@@ -823,8 +2118,15 @@ static int ScheduleWork_Thread(void* threadArgument)
             /*Codes_SRS_IOTHUBCLIENT_01_040: [If acquiring the lock fails, IoTHubClientCore_LL_DoWork shall not be called.]*/
             /*no code, shall retry*/
         }
-        /* Codes_SRS_IOTHUBCLIENT_041_02: [The thread shall sleep for a specified time in ms as provided through IoTHubClientCore_SetOption, with a default of 1 ms ] */
-        (void)ThreadAPI_Sleep(sleeptime_in_ms);
+        if (waittime_in_ms != 0)
+        {
+            wait_for_work(iotHubClientInstance, waittime_in_ms);
+        }
+        else
+        {
+            /* Codes_SRS_IOTHUBCLIENT_041_02: [The thread shall sleep for a specified time in ms as provided through IoTHubClientCore_SetOption, with a default of 1 ms ] */
+            (void)ThreadAPI_Sleep(sleeptime_in_ms);
+        }
     }
 
     ThreadAPI_Exit(0);
@@ -836,7 +2138,21 @@ static IOTHUB_CLIENT_RESULT StartWorkerThreadIfNeeded(IOTHUB_CLIENT_CORE_INSTANC
     IOTHUB_CLIENT_RESULT result;
     if (iotHubClientInstance->TransportHandle == NULL)
     {
-        if (iotHubClientInstance->ThreadHandle == NULL)
+        if (iotHubClientInstance->worker_pool != NULL)
+        {
+            /* Codes_SRS_IOTHUBCLIENT_41_012: [ If a worker pool was set, the client shall be scheduled on the pool by calling `IoTHubClientWorkerPool_Add` instead of creating a thread. ] */
+            if (iotHubClientInstance->worker_pool_item == NULL &&
+                (iotHubClientInstance->worker_pool_item = IoTHubClientWorkerPool_Add(iotHubClientInstance->worker_pool, ScheduleWork_ForWorkerPool, iotHubClientInstance)) == NULL)
+            {
+                LogError("IoTHubClientWorkerPool_Add failed");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        else if (iotHubClientInstance->ThreadHandle == NULL)
         {
             iotHubClientInstance->StopThread = 0;
             if (ThreadAPI_Create(&iotHubClientInstance->ThreadHandle, ScheduleWork_Thread, iotHubClientInstance) != THREADAPI_OK)
@@ -903,6 +2219,7 @@ static IOTHUB_CLIENT_CORE_INSTANCE* create_iothub_instance(CREATE_HUB_INSTANCE_T
             {
                 result->TransportHandle = transportHandle;
                 result->created_with_transport_handle = 0;
+                result->signal_transport_work = (transportHandle != NULL) ? 1 : 0;
                 if (config != NULL)
                 {
                     if (transportHandle != NULL)
@@ -1164,6 +2481,14 @@ void IoTHubClientCore_Destroy(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle)
 
         if (iotHubClientInstance->TransportHandle != NULL)
         {
+            /*Codes_SRS_IOTHUBCLIENT_41_040: [ IoTHubClient_Destroy shall stop signaling the transport worker thread, under the serializing lock, before ending it. ]*/
+            if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+            {
+                LogError("unable to Lock - - will still proceed to stop signaling the transport worker thread");
+            }
+            iotHubClientInstance->signal_transport_work = 0;
+            (void)Unlock(iotHubClientInstance->LockHandle);
+
             /*Codes_SRS_IOTHUBCLIENT_01_007: [ The thread created as part of executing IoTHubClient_SendEventAsync or IoTHubClient_SetNotificationMessageCallback shall be joined. ]*/
             joinTransportThread = IoTHubTransport_SignalEndWorkerThread(iotHubClientInstance->TransportHandle, iotHubClientHandle);
         }
@@ -1181,6 +2506,7 @@ void IoTHubClientCore_Destroy(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle)
         if (iotHubClientInstance->ThreadHandle != NULL)
         {
             iotHubClientInstance->StopThread = 1;
+            signal_work_available(iotHubClientInstance);
             joinClientThread = true;
         }
         else
@@ -1210,6 +2536,43 @@ void IoTHubClientCore_Destroy(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle)
             IoTHubTransport_JoinWorkerThread(iotHubClientInstance->TransportHandle, iotHubClientHandle);
         }
 
+        if (iotHubClientInstance->worker_pool_item != NULL)
+        {
+            /* Codes_SRS_IOTHUBCLIENT_41_013: [ `IoTHubClient_Destroy` shall remove the client from its worker pool by calling `IoTHubClientWorkerPool_Remove`. ] */
+            IoTHubClientWorkerPool_Remove(iotHubClientInstance->worker_pool, iotHubClientInstance->worker_pool_item);
+        }
+
+        if (iotHubClientInstance->callback_dispatch_thread != NULL)
+        {
+            /* Codes_SRS_IOTHUBCLIENT_41_021: [ `IoTHubClient_Destroy` shall signal the dispatch thread, which shall deliver all callbacks already handed over before it is joined. ] */
+            stop_callback_dispatch_thread(iotHubClientInstance);
+        }
+
+        if (iotHubClientInstance->http_worker_threads != NULL)
+        {
+            /* Codes_SRS_IOTHUBCLIENT_41_038: [ `IoTHubClient_Destroy` shall signal the http worker pool threads, which shall run all jobs already queued before they are joined. ] */
+            stop_http_worker_pool(iotHubClientInstance);
+        }
+
+        if (iotHubClientInstance->method_worker_pool != NULL)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_41_050: [ IoTHubClient_Destroy shall signal the OPTION_METHOD_WORKER_THREADS threads, which shall run all methods already queued before they are joined, ahead of the method handler threads. ]*/
+            destroy_method_worker_pool(iotHubClientInstance->method_worker_pool);
+            iotHubClientInstance->method_worker_pool = NULL;
+        }
+
+        if (iotHubClientInstance->method_handlers != NULL)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_41_045: [ IoTHubClient_Destroy shall signal the method handler threads, which shall run all invocations already queued before they are joined, and free every method handler. ]*/
+            LIST_ITEM_HANDLE item;
+            while ((item = singlylinkedlist_get_head_item(iotHubClientInstance->method_handlers)) != NULL)
+            {
+                destroy_method_handler((METHOD_HANDLER_INFO*)singlylinkedlist_item_get_value(item));
+                (void)singlylinkedlist_remove(iotHubClientInstance->method_handlers, item);
+            }
+            singlylinkedlist_destroy(iotHubClientInstance->method_handlers);
+        }
+
         if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
         {
             LogError("unable to Lock - - will still proceed to try to end the thread without locking");
@@ -1230,6 +2593,25 @@ void IoTHubClientCore_Destroy(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle)
         /* Codes_SRS_IOTHUBCLIENT_01_006: [That includes destroying the IoTHubClientCore_LL instance by calling IoTHubClientCore_LL_Destroy.] */
         IoTHubClientCore_LL_Destroy(iotHubClientInstance->IoTHubClientLLHandle);
 
+        if (iotHubClientInstance->submission_ring != NULL)
+        {
+            /* Codes_SRS_IOTHUBCLIENT_41_017: [ `IoTHubClient_Destroy` shall complete events still in the submission queue with `IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY`. ] */
+            size_t pending;
+            for (pending = 0; pending < iotHubClientInstance->submission_count; pending++)
+            {
+                SUBMISSION_RECORD* record = &iotHubClientInstance->submission_ring[(iotHubClientInstance->submission_head + pending) % iotHubClientInstance->submission_capacity];
+                if (record->queue_context != NULL)
+                {
+                    iotHubClientInstance->event_confirm_callback = record->eventConfirmationCallback;
+                    iothub_ll_event_confirm_callback(IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY, record->queue_context);
+                }
+                IoTHubMessage_Destroy(record->message);
+            }
+            free(iotHubClientInstance->submission_ring);
+            free(iotHubClientInstance->submission_drain_buffer);
+            Lock_Deinit(iotHubClientInstance->submission_lock);
+        }
+
         if (Unlock(iotHubClientInstance->LockHandle) != LOCK_OK)
         {
             LogError("unable to Unlock");
@@ -1243,7 +2625,7 @@ void IoTHubClientCore_Destroy(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle)
             USER_CALLBACK_INFO* queue_cb_info = (USER_CALLBACK_INFO*)VECTOR_element(iotHubClientInstance->saved_user_callback_list, index);
             if (queue_cb_info != NULL)
             {
-                if ((queue_cb_info->type == CALLBACK_TYPE_DEVICE_METHOD) || (queue_cb_info->type == CALLBACK_TYPE_INBOUD_DEVICE_METHOD))
+                if ((queue_cb_info->type == CALLBACK_TYPE_DEVICE_METHOD) || (queue_cb_info->type == CALLBACK_TYPE_INBOUD_DEVICE_METHOD) || (queue_cb_info->type == CALLBACK_TYPE_METHOD_HANDLER))
                 {
                     STRING_delete(queue_cb_info->iothub_callback.method_cb_info.method_name);
                     BUFFER_delete(queue_cb_info->iothub_callback.method_cb_info.payload);
@@ -1262,15 +2644,38 @@ void IoTHubClientCore_Destroy(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle)
                         iotHubClientInstance->event_confirm_callback(queue_cb_info->iothub_callback.event_confirm_cb_info.confirm_result, queue_cb_info->userContextCallback);
                     }
                 }
+                else if (queue_cb_info->type == CALLBACK_TYPE_EVENT_CONFIRM_BATCH)
+                {
+                    if (iotHubClientInstance->event_confirm_batch_callback)
+                    {
+                        iotHubClientInstance->event_confirm_batch_callback(queue_cb_info->iothub_callback.event_confirm_batch_cb_info.confirmations, queue_cb_info->iothub_callback.event_confirm_batch_cb_info.count, queue_cb_info->userContextCallback);
+                    }
+                    free(queue_cb_info->iothub_callback.event_confirm_batch_cb_info.confirmations);
+                }
             }
         }
         VECTOR_destroy(iotHubClientInstance->saved_user_callback_list);
 
+        if (iotHubClientInstance->event_pool_lock != NULL)
+        {
+            while (iotHubClientInstance->event_pool_count > 0)
+            {
+                free(iotHubClientInstance->event_pool[--iotHubClientInstance->event_pool_count]);
+            }
+            free(iotHubClientInstance->event_pool);
+            Lock_Deinit(iotHubClientInstance->event_pool_lock);
+        }
+
         if (iotHubClientInstance->TransportHandle == NULL)
         {
             /* Codes_SRS_IOTHUBCLIENT_01_032: [If the lock was allocated in IoTHubClient_Create, it shall be also freed..] */
             Lock_Deinit(iotHubClientInstance->LockHandle);
         }
+        if (iotHubClientInstance->do_work_condition != NULL)
+        {
+            Condition_Deinit(iotHubClientInstance->do_work_condition);
+            Lock_Deinit(iotHubClientInstance->do_work_lock);
+        }
         if (iotHubClientInstance->devicetwin_user_context != NULL)
         {
             free(iotHubClientInstance->devicetwin_user_context);
@@ -1291,7 +2696,14 @@ void IoTHubClientCore_Destroy(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle)
     }
 }
 
-IOTHUB_CLIENT_RESULT IoTHubClientCore_SendEventAsync(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+static IOTHUB_CLIENT_RESULT ll_send_event_async(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientLLHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback, bool takeOwnership)
+{
+    return takeOwnership ?
+        IoTHubClientCore_LL_SendEventAsync_TakeOwnership(iotHubClientLLHandle, eventMessageHandle, eventConfirmationCallback, userContextCallback) :
+        IoTHubClientCore_LL_SendEventAsync(iotHubClientLLHandle, eventMessageHandle, eventConfirmationCallback, userContextCallback);
+}
+
+static IOTHUB_CLIENT_RESULT send_event_async(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback, bool takeOwnership)
 {
     IOTHUB_CLIENT_RESULT result;
 
@@ -1312,6 +2724,15 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_SendEventAsync(IOTHUB_CLIENT_CORE_HANDLE i
             result = IOTHUB_CLIENT_ERROR;
             LogError("Could not start worker thread");
         }
+        /* Codes_SRS_IOTHUBCLIENT_41_015: [ If a submission queue was configured, `IoTHubClient_SendEventAsync` shall clone the message into the queue without taking the client lock; if the queue is full it shall count the contention and fall back to calling `IoTHubClientCore_LL_SendEventAsync` under the lock. ] */
+        else if ((iotHubClientInstance->submission_ring != NULL) &&
+            (submit_event(iotHubClientInstance, eventMessageHandle, eventConfirmationCallback, userContextCallback, takeOwnership, &result) == 0))
+        {
+            if (result != IOTHUB_CLIENT_OK)
+            {
+                LogError("Could not queue the event");
+            }
+        }
         else
         {
             /* Codes_SRS_IOTHUBCLIENT_01_025: [IoTHubClient_SendEventAsync shall be made thread-safe by using the lock created in IoTHubClient_Create.] */
@@ -1323,6 +2744,12 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_SendEventAsync(IOTHUB_CLIENT_CORE_HANDLE i
             }
             else
             {
+                if (iotHubClientInstance->submission_ring != NULL)
+                {
+                    /* Codes_SRS_IOTHUBCLIENT_41_061: [ Before falling back to the lock, `IoTHubClient_SendEventAsync` shall hand the queued submissions to the LL layer so events keep the order in which they were submitted. ] */
+                    drain_submission_queue(iotHubClientInstance);
+                }
+
                 if (iotHubClientInstance->created_with_transport_handle == 0)
                 {
                     iotHubClientInstance->event_confirm_callback = eventConfirmationCallback;
@@ -1330,12 +2757,13 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_SendEventAsync(IOTHUB_CLIENT_CORE_HANDLE i
 
                 if (iotHubClientInstance->created_with_transport_handle != 0 || eventConfirmationCallback == NULL)
                 {
-                    result = IoTHubClientCore_LL_SendEventAsync(iotHubClientInstance->IoTHubClientLLHandle, eventMessageHandle, eventConfirmationCallback, userContextCallback);
+                    result = ll_send_event_async(iotHubClientInstance->IoTHubClientLLHandle, eventMessageHandle, eventConfirmationCallback, userContextCallback, takeOwnership);
                 }
                 else
                 {
                     /* Codes_SRS_IOTHUBCLIENT_07_001: [ IoTHubClient_SendEventAsync shall allocate a IOTHUB_QUEUE_CONTEXT object to be sent to the IoTHubClientCore_LL_SendEventAsync function as a user context. ] */
-                    IOTHUB_QUEUE_CONTEXT* queue_context = (IOTHUB_QUEUE_CONTEXT*)malloc(sizeof(IOTHUB_QUEUE_CONTEXT));
+                    /* Codes_SRS_IOTHUBCLIENT_41_027: [ If `OPTION_EVENT_POOL_SIZE` was set, the IOTHUB_QUEUE_CONTEXT shall be taken from the pool when one is available. ] */
+                    IOTHUB_QUEUE_CONTEXT* queue_context = get_event_queue_context(iotHubClientInstance);
                     if (queue_context == NULL)
                     {
                         result = IOTHUB_CLIENT_ERROR;
@@ -1343,22 +2771,195 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_SendEventAsync(IOTHUB_CLIENT_CORE_HANDLE i
                     }
                     else
                     {
-                        queue_context->iotHubClientHandle = iotHubClientInstance;
                         queue_context->userContextCallback = userContextCallback;
                         /* Codes_SRS_IOTHUBCLIENT_01_012: [IoTHubClient_SendEventAsync shall call IoTHubClientCore_LL_SendEventAsync, while passing the IoTHubClientCore_LL handle created by IoTHubClient_Create and the parameters eventMessageHandle, eventConfirmationCallback and userContextCallback.] */
                         /* Codes_SRS_IOTHUBCLIENT_01_013: [When IoTHubClientCore_LL_SendEventAsync is called, IoTHubClient_SendEventAsync shall return the result of IoTHubClientCore_LL_SendEventAsync.] */
-                        result = IoTHubClientCore_LL_SendEventAsync(iotHubClientInstance->IoTHubClientLLHandle, eventMessageHandle, iothub_ll_event_confirm_callback, queue_context);
+                        result = ll_send_event_async(iotHubClientInstance->IoTHubClientLLHandle, eventMessageHandle, iothub_ll_event_confirm_callback, queue_context, takeOwnership);
                         if (result != IOTHUB_CLIENT_OK)
                         {
                             LogError("IoTHubClientCore_LL_SendEventAsync failed");
-                            free(queue_context);
+                            release_event_queue_context(queue_context);
                         }
                     }
                 }
 
-                /* Codes_SRS_IOTHUBCLIENT_01_025: [IoTHubClient_SendEventAsync shall be made thread-safe by using the lock created in IoTHubClient_Create.] */
-                (void)Unlock(iotHubClientInstance->LockHandle);
+                if (result == IOTHUB_CLIENT_OK)
+                {
+                    signal_work_available(iotHubClientInstance);
+                }
+
+                /* Codes_SRS_IOTHUBCLIENT_01_025: [IoTHubClient_SendEventAsync shall be made thread-safe by using the lock created in IoTHubClient_Create.] */
+                (void)Unlock(iotHubClientInstance->LockHandle);
+            }
+        }
+    }
+
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClientCore_SendEventAsync(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    return send_event_async(iotHubClientHandle, eventMessageHandle, eventConfirmationCallback, userContextCallback, false);
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClientCore_SendEventAsync_TakeOwnership(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    /* Codes_SRS_IOTHUBCLIENT_41_030: [ `IoTHubClientCore_SendEventAsync_TakeOwnership` shall behave like `IoTHubClientCore_SendEventAsync` but hand `eventMessageHandle` itself to the submission queue or to `IoTHubClientCore_LL_SendEventAsync_TakeOwnership` instead of cloning it. ] */
+    /* Codes_SRS_IOTHUBCLIENT_41_031: [ If `IoTHubClientCore_SendEventAsync_TakeOwnership` fails, `eventMessageHandle` shall still belong to the caller. ] */
+    return send_event_async(iotHubClientHandle, eventMessageHandle, eventConfirmationCallback, userContextCallback, true);
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClientCore_SendEventBatchAsync(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE* eventMessageHandles, size_t eventMessageCount, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if (iotHubClientHandle == NULL)
+    {
+        /* Codes_SRS_IOTHUBCLIENT_41_051: [ If `iotHubClientHandle` is `NULL`, `IoTHubClientCore_SendEventBatchAsync` shall return `IOTHUB_CLIENT_INVALID_ARG`. ] */
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LogError("NULL iothubClientHandle");
+    }
+    else
+    {
+        IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_CORE_INSTANCE*)iotHubClientHandle;
+
+        /* Codes_SRS_IOTHUBCLIENT_41_052: [ `IoTHubClientCore_SendEventBatchAsync` shall start the worker thread if it was not previously started and return `IOTHUB_CLIENT_ERROR` if it cannot. ] */
+        if ((result = StartWorkerThreadIfNeeded(iotHubClientInstance)) != IOTHUB_CLIENT_OK)
+        {
+            result = IOTHUB_CLIENT_ERROR;
+            LogError("Could not start worker thread");
+        }
+        else if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+        {
+            result = IOTHUB_CLIENT_ERROR;
+            LogError("Could not acquire lock");
+        }
+        else
+        {
+            /* Codes_SRS_IOTHUBCLIENT_41_053: [ `IoTHubClientCore_SendEventBatchAsync` shall hand all queued submissions to the LL layer and then call `IoTHubClientCore_LL_SendEventBatchAsync`, all under one acquisition of the lock, and return its result. ] */
+            if (iotHubClientInstance->submission_ring != NULL)
+            {
+                drain_submission_queue(iotHubClientInstance);
+            }
+
+            if (iotHubClientInstance->created_with_transport_handle == 0)
+            {
+                iotHubClientInstance->event_confirm_callback = eventConfirmationCallback;
+            }
+
+            if (iotHubClientInstance->created_with_transport_handle != 0 || eventConfirmationCallback == NULL)
+            {
+                result = IoTHubClientCore_LL_SendEventBatchAsync(iotHubClientInstance->IoTHubClientLLHandle, eventMessageHandles, eventMessageCount, eventConfirmationCallback, userContextCallback);
+            }
+            else
+            {
+                /* Codes_SRS_IOTHUBCLIENT_41_054: [ The confirmation of the batch shall be dispatched like the one of `IoTHubClient_SendEventAsync`, through a single IOTHUB_QUEUE_CONTEXT released if `IoTHubClientCore_LL_SendEventBatchAsync` fails. ] */
+                IOTHUB_QUEUE_CONTEXT* queue_context = get_event_queue_context(iotHubClientInstance);
+                if (queue_context == NULL)
+                {
+                    result = IOTHUB_CLIENT_ERROR;
+                    LogError("Failed allocating QUEUE_CONTEXT");
+                }
+                else
+                {
+                    queue_context->userContextCallback = userContextCallback;
+                    result = IoTHubClientCore_LL_SendEventBatchAsync(iotHubClientInstance->IoTHubClientLLHandle, eventMessageHandles, eventMessageCount, iothub_ll_event_confirm_callback, queue_context);
+                    if (result != IOTHUB_CLIENT_OK)
+                    {
+                        LogError("IoTHubClientCore_LL_SendEventBatchAsync failed");
+                        release_event_queue_context(queue_context);
+                    }
+                }
+            }
+
+            if (result == IOTHUB_CLIENT_OK)
+            {
+                signal_work_available(iotHubClientInstance);
+            }
+
+            (void)Unlock(iotHubClientInstance->LockHandle);
+        }
+    }
+
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClientCore_SendTelemetrySample(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle, const char* outputName, double value)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if (iotHubClientHandle == NULL)
+    {
+        /* Codes_SRS_IOTHUBCLIENT_41_055: [ If `iotHubClientHandle` is `NULL`, `IoTHubClientCore_SendTelemetrySample` shall return `IOTHUB_CLIENT_INVALID_ARG`. ] */
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LogError("NULL iothubClientHandle");
+    }
+    else
+    {
+        IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_CORE_INSTANCE*)iotHubClientHandle;
+
+        /* Codes_SRS_IOTHUBCLIENT_41_056: [ `IoTHubClientCore_SendTelemetrySample` shall start the worker thread if it was not previously started and return `IOTHUB_CLIENT_ERROR` if it cannot, so the windows are sent as they end. ] */
+        if ((result = StartWorkerThreadIfNeeded(iotHubClientInstance)) != IOTHUB_CLIENT_OK)
+        {
+            result = IOTHUB_CLIENT_ERROR;
+            LogError("Could not start worker thread");
+        }
+        else if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+        {
+            result = IOTHUB_CLIENT_ERROR;
+            LogError("Could not acquire lock");
+        }
+        else
+        {
+            /* Codes_SRS_IOTHUBCLIENT_41_057: [ `IoTHubClientCore_SendTelemetrySample` shall call `IoTHubClientCore_LL_SendTelemetrySample` while holding the lock and return its result. ] */
+            result = IoTHubClientCore_LL_SendTelemetrySample(iotHubClientInstance->IoTHubClientLLHandle, outputName, value);
+
+            (void)Unlock(iotHubClientInstance->LockHandle);
+        }
+    }
+
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClientCore_SetEventConfirmationBatchCallback(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_BATCH_CALLBACK eventConfirmationBatchCallback, void* userContextCallback)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if (iotHubClientHandle == NULL)
+    {
+        /* Codes_SRS_IOTHUBCLIENT_41_022: [ If `iotHubClientHandle` is `NULL`, `IoTHubClient_SetEventConfirmationBatchCallback` shall return `IOTHUB_CLIENT_INVALID_ARG`. ] */
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LogError("NULL iothubClientHandle");
+    }
+    else
+    {
+        IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_CORE_INSTANCE*)iotHubClientHandle;
+
+        /* Codes_SRS_IOTHUBCLIENT_41_025: [ `IoTHubClient_SetEventConfirmationBatchCallback` shall start the worker thread if it was not previously started. ] */
+        if ((result = StartWorkerThreadIfNeeded(iotHubClientInstance)) != IOTHUB_CLIENT_OK)
+        {
+            result = IOTHUB_CLIENT_ERROR;
+            LogError("Could not start worker thread");
+        }
+        else if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+        {
+            result = IOTHUB_CLIENT_ERROR;
+            LogError("Could not acquire lock");
+        }
+        else
+        {
+            /* Codes_SRS_IOTHUBCLIENT_41_026: [ `IoTHubClient_SetEventConfirmationBatchCallback` shall call `IoTHubClientCore_LL_SetEventConfirmationBatchCallback` with an internal callback that queues each batch for the user, or with `NULL` when `eventConfirmationBatchCallback` is `NULL`, and return its result. ] */
+            result = IoTHubClientCore_LL_SetEventConfirmationBatchCallback(iotHubClientInstance->IoTHubClientLLHandle, (eventConfirmationBatchCallback == NULL) ? NULL : iothub_ll_event_confirm_batch_callback, iotHubClientInstance);
+            if (result != IOTHUB_CLIENT_OK)
+            {
+                LogError("IoTHubClientCore_LL_SetEventConfirmationBatchCallback failed");
             }
+            else
+            {
+                iotHubClientInstance->event_confirm_batch_callback = eventConfirmationBatchCallback;
+                iotHubClientInstance->event_confirm_batch_user_context = userContextCallback;
+            }
+            (void)Unlock(iotHubClientInstance->LockHandle);
         }
     }
 
@@ -1400,6 +3001,37 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_GetSendStatus(IOTHUB_CLIENT_CORE_HANDLE io
     return result;
 }
 
+IOTHUB_CLIENT_RESULT IoTHubClientCore_GetStatistics(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle, IOTHUB_CLIENT_STATISTICS* statistics)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if (iotHubClientHandle == NULL)
+    {
+        /* Codes_SRS_IOTHUBCLIENT_41_033: [ If iotHubClientHandle is NULL, IoTHubClientCore_GetStatistics shall return IOTHUB_CLIENT_INVALID_ARG. ] */
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LogError("NULL iothubClientHandle");
+    }
+    else
+    {
+        IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_CORE_INSTANCE*)iotHubClientHandle;
+
+        /* Codes_SRS_IOTHUBCLIENT_41_034: [ IoTHubClientCore_GetStatistics shall call IoTHubClientCore_LL_GetStatistics while holding the lock created in IoTHubClient_Create and return its result, or IOTHUB_CLIENT_ERROR if acquiring the lock fails. ] */
+        if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+        {
+            result = IOTHUB_CLIENT_ERROR;
+            LogError("Could not acquire lock");
+        }
+        else
+        {
+            result = IoTHubClientCore_LL_GetStatistics(iotHubClientInstance->IoTHubClientLLHandle, statistics);
+
+            (void)Unlock(iotHubClientInstance->LockHandle);
+        }
+    }
+
+    return result;
+}
+
 IOTHUB_CLIENT_RESULT IoTHubClientCore_SetMessageCallback(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle, IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC messageCallback, void* userContextCallback)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -1753,6 +3385,162 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_SetOption(IOTHUB_CLIENT_CORE_HANDLE iotHub
                     LogError("invalid value: OPTION_MESSAGE_TIMEOUT cannot exceed the value of OPTION_DO_WORK_FREQUENCY_IN_MS ");
                 }
             }
+            /* Codes_SRS_IOTHUBCLIENT_41_007: [ If parameter `optionName` is `OPTION_DO_WORK_MAX_IDLE_MS` then `IoTHubClientCore_SetOption` shall set `do_work_max_idle_ms` parameter of `IoTHubClientInstance`, creating the wakeup condition if needed ]*/
+            else if (strcmp(OPTION_DO_WORK_MAX_IDLE_MS, optionName) == 0)
+            {
+                unsigned int max_idle_ms = *(const unsigned int*)value;
+
+                /* Codes_SRS_IOTHUBCLIENT_41_008: [ If the client was created with a shared transport or the value exceeds INT_MAX, `IoTHubClientCore_SetOption` shall return `IOTHUB_CLIENT_ERROR` ]*/
+                if (iotHubClientInstance->TransportHandle != NULL)
+                {
+                    result = IOTHUB_CLIENT_ERROR;
+                    LogError("Invalid option: OPTION_DO_WORK_MAX_IDLE_MS is not supported when the transport is shared");
+                }
+                else if (max_idle_ms > INT_MAX)
+                {
+                    result = IOTHUB_CLIENT_ERROR;
+                    LogError("Invalid value: OPTION_DO_WORK_MAX_IDLE_MS cannot exceed %d", INT_MAX);
+                }
+                else if ((max_idle_ms != 0) && (iotHubClientInstance->do_work_condition == NULL) &&
+                    ((iotHubClientInstance->do_work_lock = Lock_Init()) == NULL))
+                {
+                    result = IOTHUB_CLIENT_ERROR;
+                    LogError("Lock_Init failed");
+                }
+                else if ((max_idle_ms != 0) && (iotHubClientInstance->do_work_condition == NULL) &&
+                    ((iotHubClientInstance->do_work_condition = Condition_Init()) == NULL))
+                {
+                    result = IOTHUB_CLIENT_ERROR;
+                    LogError("Condition_Init failed");
+                    Lock_Deinit(iotHubClientInstance->do_work_lock);
+                    iotHubClientInstance->do_work_lock = NULL;
+                }
+                else
+                {
+                    iotHubClientInstance->do_work_max_idle_ms = max_idle_ms;
+                    if (max_idle_ms == 0 && iotHubClientInstance->do_work_condition != NULL)
+                    {
+                        /*wake the worker so it goes back to fixed-frequency sleeping*/
+                        signal_work_available(iotHubClientInstance);
+                    }
+                    result = IOTHUB_CLIENT_OK;
+                }
+            }
+            /* Codes_SRS_IOTHUBCLIENT_41_014: [ If parameter `optionName` is `OPTION_SUBMISSION_QUEUE_SIZE` then `IoTHubClientCore_SetOption` shall allocate a submission queue of that many entries; it shall fail with `IOTHUB_CLIENT_ERROR` if the value is 0, the transport is shared or a queue already exists ]*/
+            else if (strcmp(OPTION_SUBMISSION_QUEUE_SIZE, optionName) == 0)
+            {
+                size_t capacity = *(const size_t*)value;
+
+                if ((capacity == 0) || (capacity > SIZE_MAX / sizeof(SUBMISSION_RECORD)) || (iotHubClientInstance->TransportHandle != NULL) || (iotHubClientInstance->submission_ring != NULL))
+                {
+                    result = IOTHUB_CLIENT_ERROR;
+                    LogError("Invalid option: OPTION_SUBMISSION_QUEUE_SIZE must be non-zero, can only be set once and cannot be used with a shared transport");
+                }
+                else if ((iotHubClientInstance->submission_lock = Lock_Init()) == NULL)
+                {
+                    result = IOTHUB_CLIENT_ERROR;
+                    LogError("Lock_Init failed for submission queue");
+                }
+                else if ((iotHubClientInstance->submission_drain_buffer = (SUBMISSION_RECORD*)malloc(capacity * sizeof(SUBMISSION_RECORD))) == NULL)
+                {
+                    result = IOTHUB_CLIENT_ERROR;
+                    LogError("Failed allocating submission drain buffer");
+                    Lock_Deinit(iotHubClientInstance->submission_lock);
+                    iotHubClientInstance->submission_lock = NULL;
+                }
+                else if ((iotHubClientInstance->submission_ring = (SUBMISSION_RECORD*)malloc(capacity * sizeof(SUBMISSION_RECORD))) == NULL)
+                {
+                    result = IOTHUB_CLIENT_ERROR;
+                    LogError("Failed allocating submission queue");
+                    free(iotHubClientInstance->submission_drain_buffer);
+                    iotHubClientInstance->submission_drain_buffer = NULL;
+                    Lock_Deinit(iotHubClientInstance->submission_lock);
+                    iotHubClientInstance->submission_lock = NULL;
+                }
+                else
+                {
+                    iotHubClientInstance->submission_capacity = capacity;
+                    result = IOTHUB_CLIENT_OK;
+                }
+            }
+            /* Codes_SRS_IOTHUBCLIENT_41_010: [ If parameter `optionName` is `OPTION_WORKER_POOL` then `IoTHubClientCore_SetOption` shall store the pool, failing with `IOTHUB_CLIENT_ERROR` if the transport is shared or the worker has already started ]*/
+            else if (strcmp(OPTION_WORKER_POOL, optionName) == 0)
+            {
+                if ((iotHubClientInstance->TransportHandle != NULL) || (iotHubClientInstance->ThreadHandle != NULL) || (iotHubClientInstance->worker_pool_item != NULL))
+                {
+                    result = IOTHUB_CLIENT_ERROR;
+                    LogError("Invalid option: OPTION_WORKER_POOL must be set before the worker starts and cannot be used with a shared transport");
+                }
+                else
+                {
+                    iotHubClientInstance->worker_pool = (IOTHUB_CLIENT_WORKER_POOL_HANDLE)value;
+                    result = IOTHUB_CLIENT_OK;
+                }
+            }
+            /* Codes_SRS_IOTHUBCLIENT_41_018: [ If parameter `optionName` is `OPTION_CALLBACK_DISPATCH_THREAD` and the value is true then `IoTHubClientCore_SetOption` shall start a thread dedicated to invoking user callbacks; it shall fail with `IOTHUB_CLIENT_ERROR` if the transport is shared or the worker has already started ]*/
+            else if (strcmp(OPTION_CALLBACK_DISPATCH_THREAD, optionName) == 0)
+            {
+                if ((iotHubClientInstance->TransportHandle != NULL) || (iotHubClientInstance->ThreadHandle != NULL) || (iotHubClientInstance->worker_pool_item != NULL))
+                {
+                    result = IOTHUB_CLIENT_ERROR;
+                    LogError("Invalid option: OPTION_CALLBACK_DISPATCH_THREAD must be set before the worker starts and cannot be used with a shared transport");
+                }
+                else if ((*(const bool*)value == false) || (iotHubClientInstance->callback_dispatch_thread != NULL))
+                {
+                    result = IOTHUB_CLIENT_OK;
+                }
+                else
+                {
+                    result = start_callback_dispatch_thread(iotHubClientInstance);
+                }
+            }
+            /* Codes_SRS_IOTHUBCLIENT_41_035: [ If parameter `optionName` is `OPTION_HTTP_WORKER_THREADS` then `IoTHubClientCore_SetOption` shall create a queue shared by file uploads and method invocations, served by at most that many threads; it shall fail with `IOTHUB_CLIENT_ERROR` if the value is 0 or the pool already exists ]*/
+            else if (strcmp(OPTION_HTTP_WORKER_THREADS, optionName) == 0)
+            {
+                size_t thread_count = *(const size_t*)value;
+
+                if ((thread_count == 0) || (thread_count > SIZE_MAX / sizeof(THREAD_HANDLE)) || (iotHubClientInstance->http_worker_threads != NULL))
+                {
+                    result = IOTHUB_CLIENT_ERROR;
+                    LogError("Invalid option: OPTION_HTTP_WORKER_THREADS must be non-zero and can only be set once");
+                }
+                else
+                {
+                    result = create_http_worker_pool(iotHubClientInstance, thread_count);
+                }
+            }
+            /* Codes_SRS_IOTHUBCLIENT_41_048: [ If parameter `optionName` is `OPTION_METHOD_WORKER_THREADS` then `IoTHubClientCore_SetOption` shall create a pool of at most that many threads running the device method callback and the method handlers without threads of their own; it shall fail with `IOTHUB_CLIENT_ERROR` if the value is 0 or the pool already exists ]*/
+            else if (strcmp(OPTION_METHOD_WORKER_THREADS, optionName) == 0)
+            {
+                size_t thread_count = *(const size_t*)value;
+
+                if ((thread_count == 0) || (thread_count > SIZE_MAX / sizeof(THREAD_HANDLE)) || (iotHubClientInstance->method_worker_pool != NULL))
+                {
+                    result = IOTHUB_CLIENT_ERROR;
+                    LogError("Invalid option: OPTION_METHOD_WORKER_THREADS must be non-zero and can only be set once");
+                }
+                else if ((iotHubClientInstance->method_worker_pool = create_method_worker_pool(iotHubClientInstance, thread_count)) == NULL)
+                {
+                    result = IOTHUB_CLIENT_ERROR;
+                    LogError("create_method_worker_pool failed");
+                }
+                else
+                {
+                    result = IOTHUB_CLIENT_OK;
+                }
+            }
+            /* Codes_SRS_IOTHUBCLIENT_41_029: [ If parameter `optionName` is `OPTION_EVENT_POOL_SIZE` then `IoTHubClientCore_SetOption` shall pre-allocate that many event confirmation contexts and then call `IoTHubClientCore_LL_SetOption` passing the same parameters and return what it returns. ]*/
+            else if (strcmp(OPTION_EVENT_POOL_SIZE, optionName) == 0)
+            {
+                if ((result = set_event_pool_size(iotHubClientInstance, *(const size_t*)value)) != IOTHUB_CLIENT_OK)
+                {
+                    LogError("set_event_pool_size failed");
+                }
+                else if ((result = IoTHubClientCore_LL_SetOption(iotHubClientInstance->IoTHubClientLLHandle, optionName, value)) != IOTHUB_CLIENT_OK)
+                {
+                    LogError("IoTHubClientCore_LL_SetOption failed");
+                }
+            }
             else
             {
                 /*Codes_SRS_IOTHUBCLIENT_02_038: [If optionName doesn't match one of the options handled by this module then IoTHubClient_SetOption shall call IoTHubClientCore_LL_SetOption passing the same parameters and return what IoTHubClientCore_LL_SetOption returns.] */
@@ -1768,6 +3556,40 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_SetOption(IOTHUB_CLIENT_CORE_HANDLE iotHub
     return result;
 }
 
+IOTHUB_CLIENT_RESULT IoTHubClientCore_GetSubmissionContentionCount(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle, size_t* contentionCount)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if ((iotHubClientHandle == NULL) || (contentionCount == NULL))
+    {
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LogError("invalid arg (iotHubClientHandle=%p, contentionCount=%p)", iotHubClientHandle, contentionCount);
+    }
+    else
+    {
+        IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_CORE_INSTANCE*)iotHubClientHandle;
+
+        if (iotHubClientInstance->submission_ring == NULL)
+        {
+            *contentionCount = 0;
+            result = IOTHUB_CLIENT_OK;
+        }
+        else if (Lock(iotHubClientInstance->submission_lock) != LOCK_OK)
+        {
+            result = IOTHUB_CLIENT_ERROR;
+            LogError("Could not acquire lock");
+        }
+        else
+        {
+            *contentionCount = iotHubClientInstance->submission_contention_count;
+            result = IOTHUB_CLIENT_OK;
+            (void)Unlock(iotHubClientInstance->submission_lock);
+        }
+    }
+
+    return result;
+}
+
 IOTHUB_CLIENT_RESULT IoTHubClientCore_SetDeviceTwinCallback(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle, IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK deviceTwinCallback, void* userContextCallback)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -1913,6 +3735,11 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_SendReportedState(IOTHUB_CLIENT_CORE_HANDL
                     }
                 }
 
+                if (result == IOTHUB_CLIENT_OK)
+                {
+                    signal_work_available(iotHubClientInstance);
+                }
+
                 (void)Unlock(iotHubClientInstance->LockHandle);
             }
         }
@@ -1975,6 +3802,10 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_GetTwinAsync(IOTHUB_CLIENT_CORE_HANDLE iot
                         LogError("IoTHubClientCore_LL_GetTwinAsync failed");
                         free(queueContext);
                     }
+                    else
+                    {
+                        signal_work_available(iotHubClientInstance);
+                    }
 
                     (void)Unlock(iotHubClientInstance->LockHandle);
                 }
@@ -2150,6 +3981,103 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_SetDeviceMethodCallback_Ex(IOTHUB_CLIENT_C
     return result;
 }
 
+IOTHUB_CLIENT_RESULT IoTHubClientCore_SetDeviceMethodHandler(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle, const char* methodName, IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC deviceMethodCallback, void* userContextCallback, size_t workerThreadCount)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    /*Codes_SRS_IOTHUBCLIENT_41_041: [ If iotHubClientHandle or methodName is NULL, or workerThreadCount is too large to allocate, IoTHubClient_SetDeviceMethodHandler shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+    if ((iotHubClientHandle == NULL) || (methodName == NULL) || (workerThreadCount > SIZE_MAX / sizeof(THREAD_HANDLE)))
+    {
+        LogError("invalid arg iotHubClientHandle=%p, methodName=%p, workerThreadCount=%lu", iotHubClientHandle, methodName, (unsigned long)workerThreadCount);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        IOTHUB_CLIENT_CORE_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_CORE_INSTANCE*)iotHubClientHandle;
+
+        if ((result = StartWorkerThreadIfNeeded(iotHubClientInstance)) != IOTHUB_CLIENT_OK)
+        {
+            result = IOTHUB_CLIENT_ERROR;
+            LogError("Could not start worker thread");
+        }
+        else if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+        {
+            result = IOTHUB_CLIENT_ERROR;
+            LogError("Could not acquire lock");
+        }
+        else
+        {
+            LIST_ITEM_HANDLE item = NULL;
+            METHOD_HANDLER_INFO* handler = NULL;
+            bool is_new_handler = false;
+
+            if ((iotHubClientInstance->method_handlers == NULL) &&
+                ((iotHubClientInstance->method_handlers = singlylinkedlist_create()) == NULL))
+            {
+                LogError("singlylinkedlist_create failed");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                if ((item = singlylinkedlist_find(iotHubClientInstance->method_handlers, is_method_handler_for_match, methodName)) != NULL)
+                {
+                    handler = (METHOD_HANDLER_INFO*)singlylinkedlist_item_get_value(item);
+                }
+                is_new_handler = (item == NULL);
+
+                if (deviceMethodCallback == NULL)
+                {
+                    /*Codes_SRS_IOTHUBCLIENT_41_046: [ If deviceMethodCallback is NULL, IoTHubClient_SetDeviceMethodHandler shall call IoTHubClientCore_LL_SetDeviceMethodHandler_Ex with a NULL callback and return its result; invocations already queued for the method shall be dropped. ]*/
+                    result = IoTHubClientCore_LL_SetDeviceMethodHandler_Ex(iotHubClientInstance->IoTHubClientLLHandle, methodName, NULL, NULL);
+                    if (handler != NULL)
+                    {
+                        /*the record stays until destroy, its threads and queued callbacks still point to it*/
+                        handler->methodCallback = NULL;
+                        handler->userContextCallback = NULL;
+                    }
+                }
+                else if ((handler == NULL) &&
+                    ((handler = create_method_handler(iotHubClientInstance, methodName, workerThreadCount)) == NULL))
+                {
+                    result = IOTHUB_CLIENT_ERROR;
+                }
+                else if (is_new_handler && ((item = singlylinkedlist_add(iotHubClientInstance->method_handlers, handler)) == NULL))
+                {
+                    LogError("Adding method handler to list failed");
+                    destroy_method_handler(handler);
+                    result = IOTHUB_CLIENT_ERROR;
+                }
+                else
+                {
+                    IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC previous_callback = handler->methodCallback;
+                    void* previous_context = handler->userContextCallback;
+
+                    /*Codes_SRS_IOTHUBCLIENT_41_047: [ IoTHubClient_SetDeviceMethodHandler shall call IoTHubClientCore_LL_SetDeviceMethodHandler_Ex and return its result; the worker threads of a method are fixed by its first registration. ]*/
+                    handler->methodCallback = deviceMethodCallback;
+                    handler->userContextCallback = userContextCallback;
+                    if ((result = IoTHubClientCore_LL_SetDeviceMethodHandler_Ex(iotHubClientInstance->IoTHubClientLLHandle, methodName, iothub_ll_method_handler_callback, handler)) != IOTHUB_CLIENT_OK)
+                    {
+                        LogError("IoTHubClientCore_LL_SetDeviceMethodHandler_Ex failed");
+                        if (is_new_handler)
+                        {
+                            (void)singlylinkedlist_remove(iotHubClientInstance->method_handlers, item);
+                            destroy_method_handler(handler);
+                        }
+                        else
+                        {
+                            handler->methodCallback = previous_callback;
+                            handler->userContextCallback = previous_context;
+                        }
+                    }
+                }
+            }
+
+            (void)Unlock(iotHubClientInstance->LockHandle);
+        }
+    }
+    return result;
+}
+
 IOTHUB_CLIENT_RESULT IoTHubClientCore_DeviceMethodResponse(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle, METHOD_HANDLE methodId, const unsigned char* response, size_t respSize, int statusCode)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -2178,6 +4106,10 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_DeviceMethodResponse(IOTHUB_CLIENT_CORE_HA
             {
                 LogError("IoTHubClientCore_LL_DeviceMethodResponse failed");
             }
+            else
+            {
+                signal_work_available(iotHubClientInstance);
+            }
             (void)Unlock(iotHubClientInstance->LockHandle);
         }
     }
@@ -2205,11 +4137,23 @@ static IOTHUB_CLIENT_RESULT startHttpWorkerThread(IOTHUB_CLIENT_CORE_HANDLE iotH
     }
     else
     {
+        threadInfo->httpWorkerThreadFunc = httpWorkerThreadFunc;
+        threadInfo->runsOnHttpWorkerPool = (threadInfo->iotHubClientHandle->http_worker_threads != NULL) ? 1 : 0;
+
         if ((item = singlylinkedlist_add(threadInfo->iotHubClientHandle->httpWorkerThreadInfoList, threadInfo)) == NULL)
         {
             LogError("Adding item to list failed");
             result = IOTHUB_CLIENT_ERROR;
         }
+        else if (threadInfo->runsOnHttpWorkerPool != 0)
+        {
+            if ((result = queue_http_worker_job(threadInfo->iotHubClientHandle, threadInfo)) != IOTHUB_CLIENT_OK)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_02_053: [ If copying to the structure or spawning the thread fails, then IoTHubClient_UploadToBlobAsync shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+                LogError("unable to queue_http_worker_job");
+                (void)singlylinkedlist_remove(threadInfo->iotHubClientHandle->httpWorkerThreadInfoList, item);
+            }
+        }
         else if (ThreadAPI_Create(&threadInfo->threadHandle, httpWorkerThreadFunc, threadInfo) != THREADAPI_OK)
         {
             /*Codes_SRS_IOTHUBCLIENT_02_053: [ If copying to the structure or spawning the thread fails, then IoTHubClient_UploadToBlobAsync shall fail and return IOTHUB_CLIENT_ERROR. ]*/
@@ -2230,6 +4174,9 @@ static IOTHUB_CLIENT_RESULT startHttpWorkerThread(IOTHUB_CLIENT_CORE_HANDLE iotH
 
 static int markThreadReadyToBeGarbageCollected(HTTPWORKER_THREAD_INFO* threadInfo)
 {
+    /*read before marking, the garbage collector may free threadInfo as soon as it is disposable*/
+    int runsOnHttpWorkerPool = threadInfo->runsOnHttpWorkerPool;
+
     /*Codes_SRS_IOTHUBCLIENT_02_071: [ The thread shall mark itself as disposable. ]*/
     if (Lock(threadInfo->lockGarbage) != LOCK_OK)
     {
@@ -2246,7 +4193,11 @@ static int markThreadReadyToBeGarbageCollected(HTTPWORKER_THREAD_INFO* threadInf
         }
     }
 
-    ThreadAPI_Exit(0);
+    /*a pool thread goes back to the queue instead of exiting*/
+    if (runsOnHttpWorkerPool == 0)
+    {
+        ThreadAPI_Exit(0);
+    }
     return 0;
 }
 
@@ -2472,7 +4423,7 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_UploadMultipleBlocksToBlobAsync(IOTHUB_CLI
 
 #endif /*DONT_USE_UPLOADTOBLOB*/
 
-IOTHUB_CLIENT_RESULT IoTHubClientCore_SendEventToOutputAsync(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, const char* outputName, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+static IOTHUB_CLIENT_RESULT send_event_to_output_async(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, const char* outputName, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback, bool takeOwnership)
 {
     IOTHUB_CLIENT_RESULT result;
 
@@ -2491,7 +4442,7 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_SendEventToOutputAsync(IOTHUB_CLIENT_CORE_
             result = IOTHUB_CLIENT_ERROR;
         }
         // Codes_SRS_IOTHUBCLIENT_31_102: [ `IoTHubClient_SendEventToOutputAsync` shall invoke `IoTHubClient_SendEventAsync` to send the message. ]
-        else if ((result = IoTHubClientCore_SendEventAsync(iotHubClientHandle, eventMessageHandle, eventConfirmationCallback, userContextCallback)) != IOTHUB_CLIENT_OK)
+        else if ((result = send_event_async(iotHubClientHandle, eventMessageHandle, eventConfirmationCallback, userContextCallback, takeOwnership)) != IOTHUB_CLIENT_OK)
         {
             LogError("Call into IoTHubClient_SendEventAsync failed, result=%d", result);
         }
@@ -2500,6 +4451,17 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_SendEventToOutputAsync(IOTHUB_CLIENT_CORE_
     return result;
 }
 
+IOTHUB_CLIENT_RESULT IoTHubClientCore_SendEventToOutputAsync(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, const char* outputName, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    return send_event_to_output_async(iotHubClientHandle, eventMessageHandle, outputName, eventConfirmationCallback, userContextCallback, false);
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClientCore_SendEventToOutputAsync_TakeOwnership(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, const char* outputName, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    /* Codes_SRS_IOTHUBCLIENT_41_032: [ `IoTHubClientCore_SendEventToOutputAsync_TakeOwnership` shall set the output name and then send `eventMessageHandle` the same way as `IoTHubClientCore_SendEventAsync_TakeOwnership`. ] */
+    return send_event_to_output_async(iotHubClientHandle, eventMessageHandle, outputName, eventConfirmationCallback, userContextCallback, true);
+}
+
 
 IOTHUB_CLIENT_RESULT IoTHubClientCore_SetInputMessageCallback(IOTHUB_CLIENT_CORE_HANDLE iotHubClientHandle, const char* inputName, IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC eventHandlerCallback, void* userContextCallback)
 {
@@ -3,6 +3,7 @@
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <limits.h>
 #include <string.h>
 #include <errno.h>
 
@@ -24,7 +25,20 @@
 #include "iothub_transport_ll.h"
 #include "internal/iothub_client_authorization.h"
 #include "internal/iothub_client_private.h"
+#include "internal/iothub_client_memory_private.h"
+#include "internal/iothub_client_trace_ring_private.h"
+#include "internal/iothub_client_startup_timeline_private.h"
+#ifndef DONT_USE_DIAGNOSTICS
 #include "internal/iothub_client_diagnostic.h"
+#endif
+#include "internal/iothub_client_spill_queue.h"
+#include "internal/iothub_client_telemetry_aggregation.h"
+#include "internal/iothub_client_output_routing.h"
+#include "internal/iothub_client_report_by_exception.h"
+#include "internal/iothub_client_twin_cache.h"
+#include "internal/iothub_client_twin_patch.h"
+#include "internal/iothub_client_twin_fanout.h"
+#include "internal/iothub_client_tracing.h"
 #include "internal/iothubtransport.h"
 
 #ifndef DONT_USE_UPLOADTOBLOB
@@ -39,6 +53,19 @@
 
 #define LOG_ERROR_RESULT LogError("result = %s", ENUM_TO_STRING(IOTHUB_CLIENT_RESULT, result));
 #define INDEFINITE_TIME ((time_t)(-1))
+#define CONFIRMATION_BATCH_INITIAL_CAPACITY 16
+#define RECEIVED_BATCH_INITIAL_CAPACITY 16
+#define MESSAGE_TIMEOUT_HEAP_INITIAL_CAPACITY 16
+#define SPILL_THRESHOLD_DEFAULT 100
+#define SPILL_SEGMENT_SIZE (1024 * 1024)
+#define INPUT_NAME_BUCKET_COUNT 32
+#define METHOD_HANDLER_BUCKET_COUNT 32
+#define METHOD_IN_FLIGHT_INITIAL_CAPACITY 8
+#define METHOD_BUSY_STATUS 429
+#define METHOD_TIMEOUT_STATUS 504
+#define RATE_LIMIT_TOKEN 1000000 /*the buckets count millionths of a token, so that even rates below one per second refill every ms*/
+#define FNV_OFFSET_BASIS 2166136261u
+#define FNV_PRIME 16777619u
 
 DEFINE_ENUM_STRINGS(IOTHUB_CLIENT_FILE_UPLOAD_RESULT, IOTHUB_CLIENT_FILE_UPLOAD_RESULT_VALUES);
 DEFINE_ENUM_STRINGS(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_RESULT_VALUES);
@@ -59,7 +86,9 @@ DEFINE_ENUM_STRINGS(IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_RESULT, IOTHUB_CLIENT_FIL
 #define CALLBACK_TYPE_VALUES \
     CALLBACK_TYPE_NONE,      \
     CALLBACK_TYPE_SYNC,    \
-    CALLBACK_TYPE_ASYNC
+    CALLBACK_TYPE_ASYNC,   \
+    CALLBACK_TYPE_CHUNK,   \
+    CALLBACK_TYPE_BATCH
 
 DEFINE_ENUM(CALLBACK_TYPE, CALLBACK_TYPE_VALUES)
 DEFINE_ENUM_STRINGS(CALLBACK_TYPE, CALLBACK_TYPE_VALUES)
@@ -72,6 +101,15 @@ typedef struct IOTHUB_METHOD_CALLBACK_DATA_TAG
     void* userContextCallback;
 }IOTHUB_METHOD_CALLBACK_DATA;
 
+typedef struct IOTHUB_METHOD_HANDLER_TAG
+{
+    STRING_HANDLE methodName;
+    uint32_t methodNameHash;
+    size_t methodNameLength;
+    IOTHUB_METHOD_CALLBACK_DATA callback;
+    struct IOTHUB_METHOD_HANDLER_TAG* nextInBucket;
+}IOTHUB_METHOD_HANDLER;
+
 typedef struct IOTHUB_EVENT_CALLBACK_TAG
 {
     STRING_HANDLE inputName;
@@ -79,6 +117,9 @@ typedef struct IOTHUB_EVENT_CALLBACK_TAG
     IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC_EX callbackAsyncEx;
     void* userContextCallback;
     void* userContextCallbackEx;
+    uint32_t inputNameHash;
+    size_t inputNameLength;
+    struct IOTHUB_EVENT_CALLBACK_TAG* nextInBucket;
 }IOTHUB_EVENT_CALLBACK;
 
 typedef struct IOTHUB_MESSAGE_CALLBACK_DATA_TAG
@@ -86,15 +127,73 @@ typedef struct IOTHUB_MESSAGE_CALLBACK_DATA_TAG
     CALLBACK_TYPE type;
     IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC callbackSync;
     IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC_EX callbackAsync;
+    IOTHUB_CLIENT_MESSAGE_CHUNK_CALLBACK callbackChunk;
+    IOTHUB_CLIENT_MESSAGE_BATCH_CALLBACK callbackBatch;
     void* userContextCallback;
 }IOTHUB_MESSAGE_CALLBACK_DATA;
 
+/*one confirmation for all the events of an IoTHubClientCore_LL_SendEventBatchAsync call*/
+typedef struct EVENT_BATCH_CONFIRMATION_TAG
+{
+    IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK callback;
+    void* userContextCallback;
+    size_t pending;
+    IOTHUB_CLIENT_CONFIRMATION_RESULT result;
+} EVENT_BATCH_CONFIRMATION;
+
 typedef struct GET_TWIN_CONTEXT_TAG
 {
     IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK callback;
     void* context;
 } GET_TWIN_CONTEXT;
 
+/*the heap never dereferences "message" until the message is known to still be in waitingToSend, since the transport may have taken and freed it*/
+typedef struct MESSAGE_TIMEOUT_TAG
+{
+    tickcounter_ms_t ms_timesOutAfter;
+    tickcounter_ms_t message_timeout_value;
+    uint64_t send_sequence;
+    IOTHUB_MESSAGE_LIST* message;
+}MESSAGE_TIMEOUT;
+
+typedef struct METHOD_IN_FLIGHT_TAG
+{
+    METHOD_HANDLE method_id;
+    tickcounter_ms_t ms_received;
+}METHOD_IN_FLIGHT;
+
+/*the refill and the content of a bucket are in millionths of a token*/
+typedef struct RATE_LIMIT_BUCKET_TAG
+{
+    uint64_t refill_per_ms; /*0 does not limit*/
+    uint64_t capacity;
+    uint64_t level;
+}RATE_LIMIT_BUCKET;
+
+/*the response is kept right after it, in the same allocation*/
+typedef struct PENDING_METHOD_RESPONSE_TAG
+{
+    DLIST_ENTRY entry;
+    METHOD_HANDLE method_id;
+    const unsigned char* response;
+    size_t response_size;
+    int status_response;
+}PENDING_METHOD_RESPONSE;
+
+typedef struct SUPPRESSED_EVENT_TAG
+{
+    IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK callback;
+    void* context;
+}SUPPRESSED_EVENT;
+
+/*lent to the message of one IoTHubClientCore_LL_SendSmallEvent call, and back on the free list once that message is destroyed, wherever that happens*/
+typedef struct SMALL_EVENT_SLOT_TAG
+{
+    unsigned char payload[IOTHUB_CLIENT_SMALL_EVENT_MAX_SIZE];
+    struct IOTHUB_CLIENT_CORE_LL_HANDLE_DATA_TAG* handleData;
+    struct SMALL_EVENT_SLOT_TAG* nextFree;
+}SMALL_EVENT_SLOT;
+
 typedef struct IOTHUB_CLIENT_CORE_LL_HANDLE_DATA_TAG
 {
     DLIST_ENTRY waitingToSend;
@@ -106,6 +205,8 @@ typedef struct IOTHUB_CLIENT_CORE_LL_HANDLE_DATA_TAG
     TRANSPORT_PROVIDER_FIELDS;
     IOTHUB_MESSAGE_CALLBACK_DATA messageCallback;
     IOTHUB_METHOD_CALLBACK_DATA methodCallback;
+    IOTHUB_METHOD_HANDLER* methodHandlerBuckets[METHOD_HANDLER_BUCKET_COUNT]; /*per method handlers chained by hash of their method name, tried before methodCallback*/
+    size_t methodHandlerCount;
     IOTHUB_CLIENT_CONNECTION_STATUS_CALLBACK conStatusCallback;
     void* conStatusUserContextCallback;
     time_t lastMessageReceiveTime;
@@ -126,10 +227,80 @@ typedef struct IOTHUB_CLIENT_CORE_LL_HANDLE_DATA_TAG
     bool complete_twin_update_encountered;
     IOTHUB_AUTHORIZATION_HANDLE authorization_module;
     STRING_HANDLE product_info;
+#ifndef DONT_USE_DIAGNOSTICS
     IOTHUB_DIAGNOSTIC_SETTING_DATA diagnostic_setting;
+#endif
     SINGLYLINKEDLIST_HANDLE event_callbacks;  // List of IOTHUB_EVENT_CALLBACK's
+    IOTHUB_EVENT_CALLBACK* inputNameBuckets[INPUT_NAME_BUCKET_COUNT]; /*the named event_callbacks chained by hash of their input name*/
+    IOTHUB_EVENT_CALLBACK* defaultEventCallback; /*the event_callback registered without an input name*/
+    IOTHUB_CLIENT_EVENT_CONFIRMATION_BATCH_CALLBACK eventConfirmationBatchCallback;
+    void* eventConfirmationBatchContextCallback;
+    IOTHUB_CLIENT_EVENT_CONFIRMATION* confirmationBatch; /*completions collected until the end of the current DoWork*/
+    size_t confirmationBatchCount;
+    size_t confirmationBatchCapacity;
+    MESSAGE_CALLBACK_INFO** receivedBatch; /*messages kept for the batch callback; the first receivedBatchDelivered were handed to it and wait for their disposition*/
+    IOTHUB_MESSAGE_HANDLE* receivedBatchMessages; /*the message of each entry of receivedBatch, as handed to the batch callback*/
+    size_t receivedBatchCount;
+    size_t receivedBatchDelivered;
+    size_t receivedBatchSettled; /*entries settled since receivedBatch was last compacted, their slot is NULL*/
+    size_t receivedBatchCapacity;
+    MESSAGE_TIMEOUT* messageTimeouts; /*min-heap on deadline of the messages sent with a timeout*/
+    size_t messageTimeoutCount;
+    size_t messageTimeoutCapacity;
+    uint64_t nextSendSequence;
+    IOTHUB_MESSAGE_LIST** messageListPool; /*free IOTHUB_MESSAGE_LIST records kept for reuse, see OPTION_EVENT_POOL_SIZE*/
+    size_t messageListPoolCount;
+    size_t messageListPoolSize;
+    SMALL_EVENT_SLOT* smallEventSlots; /*all the slots in a single allocation, NULL unless OPTION_SMALL_EVENT_SLOTS is set*/
+    SMALL_EVENT_SLOT* freeSmallEventSlots; /*the most recently released first*/
+    size_t smallEventSlotCount;
+    size_t smallEventSlotsInUse;
+    bool statisticsEnabled;
+    IOTHUB_CLIENT_STATISTICS statistics; /*only updated while OPTION_ENABLE_STATISTICS is set, waiting_to_send is computed by GetStatistics*/
+    bool authenticationStarted;
+    tickcounter_ms_t msAuthenticationStarted;
+    size_t maxPendingBytes; /*0 means unbounded, see OPTION_MAX_PENDING_BYTES*/
+    size_t pendingBytes; /*payload bytes of the events queued or in flight since OPTION_MAX_PENDING_BYTES was set*/
+    IOTHUB_CLIENT_MEMORY_COUNTERS memoryCounters;
+    SPILL_QUEUE_HANDLE spillQueue; /*NULL unless OPTION_SPILL_DIRECTORY is set*/
+    size_t spillGeneration; /*counts the spill logs opened, so events read from a spill log closed since are not released from the current one*/
+    size_t spillThreshold;
+    tickcounter_ms_t twinCoalesceWindow; /*0 sends every reported state on its own, see OPTION_TWIN_COALESCE_WINDOW*/
+    bool twinCoalesceOffline; /*see OPTION_TWIN_COALESCE_OFFLINE*/
+    bool twinConnected; /*false until the transport first takes a reported state or authenticates, and again once it reports it is not connected*/
+    TELEMETRY_AGGREGATION_HANDLE telemetryAggregation; /*NULL until OPTION_TELEMETRY_AGGREGATION is first set*/
+    OUTPUT_ROUTING_HANDLE outputRouting; /*NULL until OPTION_OUTPUT_ROUTE is first set*/
+    REPORT_BY_EXCEPTION_HANDLE reportByException; /*NULL until OPTION_REPORT_BY_EXCEPTION is first set*/
+    SUPPRESSED_EVENT* suppressedEvents; /*events with no news, confirmed by the next DoWork*/
+    size_t suppressedEventCount;
+    size_t suppressedEventCapacity;
+    tickcounter_ms_t sendWindowPeriod; /*0 hands events to the transport as they come, see OPTION_SEND_WINDOW*/
+    size_t sendWindowMaxHeld;
+    char* sendWindowUrgentProperty;
+    tickcounter_ms_t sendWindowOpensAt;
+    bool sendWindowOpen; /*set by DoWork when the window opened or held events were released since the previous DoWork*/
+    DLIST_ENTRY heldEvents; /*events queued while the window is closed, initialized when OPTION_SEND_WINDOW is first set*/
+    size_t heldEventCount;
+    uint64_t heldSequenceStart; /*every event from this send_sequence on is in heldEvents while heldEventCount is not 0*/
+    RATE_LIMIT_BUCKET eventRateLimit; /*see OPTION_RATE_LIMITS, events beyond it wait in heldEvents*/
+    RATE_LIMIT_BUCKET twinRateLimit;
+    RATE_LIMIT_BUCKET methodRateLimit;
+    tickcounter_ms_t rateLimitsRefilledAt;
+    DLIST_ENTRY pendingMethodResponses; /*method responses beyond methodRateLimit, initialized when OPTION_RATE_LIMITS is first set*/
+    TWIN_CACHE_HANDLE twinCache; /*NULL unless OPTION_TWIN_CACHE_FILE is set*/
+    TWIN_FANOUT_HANDLE twinFanout; /*desired property subscriptions, NULL while there are none*/
+    IOTHUB_CLIENT_TRACER tracer; /*off unless OPTION_TRACE_EXPORTER is set*/
+    bool methodTracking; /*set by OPTION_METHOD_MAX_IN_FLIGHT or OPTION_METHOD_RESPONSE_TIMEOUT_SECS, from then on only the ids in methodsInFlight can be answered*/
+    size_t methodMaxInFlight; /*0 is unbounded*/
+    tickcounter_ms_t methodResponseTimeout; /*0 waits for the response forever*/
+    METHOD_IN_FLIGHT* methodsInFlight; /*inbound method requests taken and not answered yet, in arrival order*/
+    size_t methodsInFlightCount;
+    size_t methodsInFlightCapacity;
 }IOTHUB_CLIENT_CORE_LL_HANDLE_DATA;
 
+static const char METHOD_BUSY_RESPONSE[] = "{\"message\":\"too many method requests in flight\"}";
+static const char METHOD_TIMEOUT_RESPONSE[] = "{\"message\":\"method response timed out\"}";
+
 static const char HOSTNAME_TOKEN[] = "HostName";
 static const char DEVICEID_TOKEN[] = "DeviceId";
 static const char X509_TOKEN[] = "x509";
@@ -327,8 +498,151 @@ static bool is_event_equal_for_match(LIST_ITEM_HANDLE list_item, const void* mat
     return is_event_equal((IOTHUB_EVENT_CALLBACK*)singlylinkedlist_item_get_value(list_item), (const char*)match_context);
 }
 
+// Hashes an input or method name and measures it in the same pass, so a lookup reads the name only once.
+static uint32_t hash_name(const char* name, size_t* length)
+{
+    uint32_t hash = FNV_OFFSET_BASIS;
+    const char* position;
+    for (position = name; *position != '\0'; position++)
+    {
+        hash ^= (unsigned char)*position;
+        hash *= FNV_PRIME;
+    }
+    *length = (size_t)(position - name);
+    return hash;
+}
+
+static void index_event_callback(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, IOTHUB_EVENT_CALLBACK* event_callback, const char* input_name)
+{
+    if (input_name == NULL)
+    {
+        handleData->defaultEventCallback = event_callback;
+    }
+    else
+    {
+        IOTHUB_EVENT_CALLBACK** bucket;
+        event_callback->inputNameHash = hash_name(input_name, &event_callback->inputNameLength);
+        bucket = &handleData->inputNameBuckets[event_callback->inputNameHash % INPUT_NAME_BUCKET_COUNT];
+        event_callback->nextInBucket = *bucket;
+        *bucket = event_callback;
+    }
+}
+
+static void unindex_event_callback(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, IOTHUB_EVENT_CALLBACK* event_callback)
+{
+    if (handleData->defaultEventCallback == event_callback)
+    {
+        handleData->defaultEventCallback = NULL;
+    }
+    else
+    {
+        IOTHUB_EVENT_CALLBACK** link = &handleData->inputNameBuckets[event_callback->inputNameHash % INPUT_NAME_BUCKET_COUNT];
+        while ((*link != NULL) && (*link != event_callback))
+        {
+            link = &(*link)->nextInBucket;
+        }
+        if (*link != NULL)
+        {
+            *link = event_callback->nextInBucket;
+        }
+    }
+}
+
+// The name is a slice (pointer and length), the string is only read when hash and length both match.
+static IOTHUB_EVENT_CALLBACK* find_event_callback(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, const char* input_name, size_t input_name_length, uint32_t input_name_hash)
+{
+    IOTHUB_EVENT_CALLBACK* result = handleData->inputNameBuckets[input_name_hash % INPUT_NAME_BUCKET_COUNT];
+    while (result != NULL)
+    {
+        if ((result->inputNameHash == input_name_hash) && (result->inputNameLength == input_name_length))
+        {
+            const char* event_input_name = STRING_c_str(result->inputName);
+            if ((event_input_name != NULL) && (memcmp(event_input_name, input_name, input_name_length) == 0))
+            {
+                break;
+            }
+        }
+        result = result->nextInBucket;
+    }
+    return result;
+}
+
+// Returns the link holding the handler of method_name, or the NULL link ending its bucket.
+static IOTHUB_METHOD_HANDLER** find_method_handler_link(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, const char* method_name, size_t method_name_length, uint32_t method_name_hash)
+{
+    IOTHUB_METHOD_HANDLER** result = &handleData->methodHandlerBuckets[method_name_hash % METHOD_HANDLER_BUCKET_COUNT];
+    while (*result != NULL)
+    {
+        if (((*result)->methodNameHash == method_name_hash) && ((*result)->methodNameLength == method_name_length))
+        {
+            const char* handler_method_name = STRING_c_str((*result)->methodName);
+            if ((handler_method_name != NULL) && (memcmp(handler_method_name, method_name, method_name_length) == 0))
+            {
+                break;
+            }
+        }
+        result = &(*result)->nextInBucket;
+    }
+    return result;
+}
+
+static const IOTHUB_METHOD_CALLBACK_DATA* get_method_callback(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, const char* method_name)
+{
+    const IOTHUB_METHOD_CALLBACK_DATA* result = &handleData->methodCallback;
+    if ((handleData->methodHandlerCount > 0) && (method_name != NULL))
+    {
+        size_t method_name_length;
+        uint32_t method_name_hash = hash_name(method_name, &method_name_length);
+        IOTHUB_METHOD_HANDLER* handler = *find_method_handler_link(handleData, method_name, method_name_length, method_name_hash);
+        if (handler != NULL)
+        {
+            result = &handler->callback;
+        }
+    }
+    return result;
+}
+
+static void delete_method_handlers(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData)
+{
+    size_t index;
+    for (index = 0; index < METHOD_HANDLER_BUCKET_COUNT; index++)
+    {
+        while (handleData->methodHandlerBuckets[index] != NULL)
+        {
+            IOTHUB_METHOD_HANDLER* handler = handleData->methodHandlerBuckets[index];
+            handleData->methodHandlerBuckets[index] = handler->nextInBucket;
+            STRING_delete(handler->methodName);
+            free(handler);
+        }
+    }
+    handleData->methodHandlerCount = 0;
+}
+
+/*a reported state is counted with the records of the reported states merged into it*/
+static size_t get_reported_state_memory_size(IOTHUB_DEVICE_TWIN* client_item)
+{
+    const CONSTBUFFER* data = CONSTBUFFER_GetContent(client_item->report_data_handle);
+    size_t result = sizeof(IOTHUB_DEVICE_TWIN) + ((data == NULL) ? 0 : data->size);
+    IOTHUB_DEVICE_TWIN* merged_item;
+
+    for (merged_item = client_item->coalesced; merged_item != NULL; merged_item = merged_item->coalesced)
+    {
+        result += sizeof(IOTHUB_DEVICE_TWIN);
+    }
+
+    return result;
+}
+
 static void device_twin_data_destroy(IOTHUB_DEVICE_TWIN* client_item)
 {
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_129: [ Every queued reported state shall count its records and its payload in IOTHUB_CLIENT_MEMORY_TWIN of the memory counters of the client until it is destroyed. ]*/
+    IOTHUB_CLIENT_MEMORY_REMOVE(&((IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)client_item->client_handle)->memoryCounters, IOTHUB_CLIENT_MEMORY_TWIN, get_reported_state_memory_size(client_item));
+    while (client_item->coalesced != NULL)
+    {
+        IOTHUB_DEVICE_TWIN* merged_item = client_item->coalesced;
+        client_item->coalesced = merged_item->coalesced;
+        free(merged_item);
+    }
     CONSTBUFFER_DecRef(client_item->report_data_handle);
     free(client_item);
 }
@@ -411,12 +725,189 @@ static void destroy_module_method_module(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* hand
 #endif
 }
 
+static int get_message_payload(IOTHUB_MESSAGE_HANDLE messageHandle, const unsigned char** buffer, size_t* size)
+{
+    int result;
+    const char* text;
+
+    if (IoTHubMessage_GetContentType(messageHandle) == IOTHUBMESSAGE_BYTEARRAY)
+    {
+        result = (IoTHubMessage_GetByteArray(messageHandle, buffer, size) == IOTHUB_MESSAGE_OK) ? 0 : __FAILURE__;
+    }
+    else if ((text = IoTHubMessage_GetString(messageHandle)) != NULL)
+    {
+        *buffer = (const unsigned char*)text;
+        *size = strlen(text);
+        result = 0;
+    }
+    else
+    {
+        result = __FAILURE__;
+    }
+
+    return result;
+}
+
+/*drops the slots of the settled messages, so receivedBatch only moves while no batch callback is running*/
+static void compact_received_messages(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData)
+{
+    size_t read;
+    size_t write = 0;
+    size_t delivered = 0;
+
+    for (read = 0; read < handleData->receivedBatchCount; read++)
+    {
+        if (handleData->receivedBatch[read] != NULL)
+        {
+            if (read < handleData->receivedBatchDelivered)
+            {
+                delivered++;
+            }
+            handleData->receivedBatch[write] = handleData->receivedBatch[read];
+            handleData->receivedBatchMessages[write] = handleData->receivedBatchMessages[read];
+            write++;
+        }
+    }
+
+    handleData->receivedBatchCount = write;
+    handleData->receivedBatchDelivered = delivered;
+    handleData->receivedBatchSettled = 0;
+}
+
+static bool add_received_message(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, MESSAGE_CALLBACK_INFO* messageData)
+{
+    bool result;
+
+    if (handleData->receivedBatchSettled > 0)
+    {
+        compact_received_messages(handleData);
+    }
+
+    if (handleData->receivedBatchCount < handleData->receivedBatchCapacity)
+    {
+        result = true;
+    }
+    else
+    {
+        size_t new_capacity = (handleData->receivedBatchCapacity == 0) ? RECEIVED_BATCH_INITIAL_CAPACITY : handleData->receivedBatchCapacity * 2;
+        MESSAGE_CALLBACK_INFO** new_batch;
+        IOTHUB_MESSAGE_HANDLE* new_messages;
+
+        if ((new_capacity < handleData->receivedBatchCapacity) || (new_capacity > SIZE_MAX / sizeof(MESSAGE_CALLBACK_INFO*)))
+        {
+            LogError("received message batch cannot grow past %lu messages", (unsigned long)handleData->receivedBatchCapacity);
+            result = false;
+        }
+        else if ((new_batch = (MESSAGE_CALLBACK_INFO**)realloc(handleData->receivedBatch, new_capacity * sizeof(MESSAGE_CALLBACK_INFO*))) == NULL)
+        {
+            LogError("failure growing the received message batch");
+            result = false;
+        }
+        else
+        {
+            /*the grown array is kept even if the other one cannot grow, the capacity tells what both can hold*/
+            handleData->receivedBatch = new_batch;
+            if ((new_messages = (IOTHUB_MESSAGE_HANDLE*)realloc(handleData->receivedBatchMessages, new_capacity * sizeof(IOTHUB_MESSAGE_HANDLE))) == NULL)
+            {
+                LogError("failure growing the received message batch");
+                result = false;
+            }
+            else
+            {
+                handleData->receivedBatchMessages = new_messages;
+                handleData->receivedBatchCapacity = new_capacity;
+                result = true;
+            }
+        }
+    }
+
+    if (result)
+    {
+        handleData->receivedBatch[handleData->receivedBatchCount] = messageData;
+        handleData->receivedBatchMessages[handleData->receivedBatchCount] = messageData->messageHandle;
+        handleData->receivedBatchCount++;
+    }
+
+    return result;
+}
+
+/*abandons the kept messages from index first on, those handed to the batch callback included when first is 0*/
+static void abandon_received_messages(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, size_t first)
+{
+    size_t index;
+
+    for (index = first; index < handleData->receivedBatchCount; index++)
+    {
+        if (handleData->receivedBatch[index] != NULL)
+        {
+            if (handleData->IoTHubTransport_SendMessageDisposition(handleData->receivedBatch[index], IOTHUBMESSAGE_ABANDONED) != IOTHUB_CLIENT_OK)
+            {
+                LogError("IoTHubTransport_SendMessageDisposition failed");
+            }
+            if (handleData->statisticsEnabled && handleData->statistics.messages_awaiting_disposition > 0)
+            {
+                handleData->statistics.messages_awaiting_disposition--;
+            }
+        }
+    }
+
+    handleData->receivedBatchCount = first;
+    if (handleData->receivedBatchDelivered > first)
+    {
+        handleData->receivedBatchDelivered = first;
+    }
+    if (first == 0)
+    {
+        handleData->receivedBatchSettled = 0;
+    }
+}
+
+static void deliver_received_messages(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData)
+{
+    if (handleData->receivedBatchCount > handleData->receivedBatchDelivered)
+    {
+        size_t first = handleData->receivedBatchDelivered;
+        handleData->receivedBatchDelivered = handleData->receivedBatchCount;
+        handleData->messageCallback.callbackBatch(&handleData->receivedBatchMessages[first], handleData->receivedBatchCount - first, handleData->messageCallback.userContextCallback);
+    }
+}
+
+/*returns receivedBatchDelivered if message is not waiting for its disposition; the search starts at *cursor, so messages settled in the order they were received cost one pass*/
+static size_t find_received_message(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_HANDLE message, size_t* cursor)
+{
+    size_t result = handleData->receivedBatchDelivered;
+    size_t searched;
+
+    for (searched = 0; searched < handleData->receivedBatchDelivered; searched++)
+    {
+        size_t index = *cursor + searched;
+        if (index >= handleData->receivedBatchDelivered)
+        {
+            index -= handleData->receivedBatchDelivered;
+        }
+
+        if ((handleData->receivedBatch[index] != NULL) && (handleData->receivedBatchMessages[index] == message))
+        {
+            result = index;
+            *cursor = (index + 1 == handleData->receivedBatchDelivered) ? 0 : index + 1;
+            break;
+        }
+    }
+
+    return result;
+}
+
 static bool invoke_message_callback(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, MESSAGE_CALLBACK_INFO* messageData)
 {
     bool result;
     /* Codes_SRS_IOTHUBCLIENT_LL_09_004: [IoTHubClient_LL_GetLastMessageReceiveTime shall return lastMessageReceiveTime in localtime] */
     handleData->lastMessageReceiveTime = get_time(NULL);
 
+    if (handleData->statisticsEnabled)
+    {
+        handleData->statistics.messages_received++;
+    }
+
     switch (handleData->messageCallback.type)
     {
         case CALLBACK_TYPE_NONE:
@@ -447,6 +938,47 @@ static bool invoke_message_callback(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleDat
             {
                 LogError("messageCallbackEx failed");
             }
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_045: [ While statistics are enabled, every message received shall be counted in messages_received, and every message taken by an asynchronous message callback shall be counted in messages_awaiting_disposition until IoTHubClientCore_LL_SendMessageDisposition is called for it. ]*/
+            else if (handleData->statisticsEnabled)
+            {
+                handleData->statistics.messages_awaiting_disposition++;
+            }
+            break;
+        }
+        case CALLBACK_TYPE_CHUNK:
+        {
+            const unsigned char* payload;
+            size_t size;
+
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_042: [ If the transport delivers a whole message while a chunk callback is set, IoTHubClient_LL_MessageCallback shall pass its payload to messageChunkCallback as a single slice and send the disposition it returns to the underlying layer. ]*/
+            if (get_message_payload(messageData->messageHandle, &payload, &size) != 0)
+            {
+                LogError("failure getting the message payload");
+                result = false;
+            }
+            else
+            {
+                IOTHUBMESSAGE_DISPOSITION_RESULT cb_result = handleData->messageCallback.callbackChunk(payload, size, 0, size, handleData->messageCallback.userContextCallback);
+                if (handleData->IoTHubTransport_SendMessageDisposition(messageData, cb_result) != IOTHUB_CLIENT_OK)
+                {
+                    LogError("IoTHubTransport_SendMessageDisposition failed");
+                }
+                result = true;
+            }
+            break;
+        }
+        case CALLBACK_TYPE_BATCH:
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_139: [ If a batch callback is set, IoTHubClient_LL_MessageCallback shall keep the message until the end of IoTHubClientCore_LL_DoWork and return true, or return false if it cannot be kept; a kept message is counted in messages_awaiting_disposition. ]*/
+            result = add_received_message(handleData, messageData);
+            if (!result)
+            {
+                LogError("failure keeping the message for the batch callback");
+            }
+            else if (handleData->statisticsEnabled)
+            {
+                handleData->statistics.messages_awaiting_disposition++;
+            }
             break;
         }
         default:
@@ -485,1343 +1017,3250 @@ static STRING_HANDLE make_product_info(const char* product)
     return result;
 }
 
-static void IoTHubClientCore_LL_SendComplete(PDLIST_ENTRY completed, IOTHUB_CLIENT_CONFIRMATION_RESULT result, void* ctx)
+static void flush_event_confirmations(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData)
 {
-    /*Codes_SRS_IOTHUBCLIENT_LL_02_022: [If parameter completed is NULL, or parameter handle is NULL then IoTHubClientCore_LL_SendBatch shall return.]*/
-    if (
-        (ctx == NULL) ||
-        (completed == NULL)
-        )
+    if (handleData->confirmationBatchCount != 0)
     {
-        /*"shall return"*/
-        LogError("invalid arg");
+        size_t count = handleData->confirmationBatchCount;
+        handleData->confirmationBatchCount = 0;
+        handleData->eventConfirmationBatchCallback(handleData->confirmationBatch, count, handleData->eventConfirmationBatchContextCallback);
     }
-    else
+}
+
+static void add_event_confirmation(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, IOTHUB_CLIENT_CONFIRMATION_RESULT result, void* context)
+{
+    bool has_room = (handleData->confirmationBatchCount < handleData->confirmationBatchCapacity);
+
+    if (!has_room)
     {
-        /*Codes_SRS_IOTHUBCLIENT_LL_02_027: [If parameter result is IOTHUB_CLIENT_CONFIRMATION_ERROR then IoTHubClientCore_LL_SendComplete shall call all the non-NULL callbacks with the result parameter set to IOTHUB_CLIENT_CONFIRMATION_ERROR and the context set to the context passed originally in the SendEventAsync call.] */
-        /*Codes_SRS_IOTHUBCLIENT_LL_02_025: [If parameter result is IOTHUB_CLIENT_CONFIRMATION_OK then IoTHubClientCore_LL_SendComplete shall call all the non-NULL callbacks with the result parameter set to IOTHUB_CLIENT_CONFIRMATION_OK and the context set to the context passed originally in the SendEventAsync call.]*/
-        PDLIST_ENTRY oldest;
-        while ((oldest = DList_RemoveHeadList(completed)) != completed)
+        size_t new_capacity = (handleData->confirmationBatchCapacity == 0) ? CONFIRMATION_BATCH_INITIAL_CAPACITY : handleData->confirmationBatchCapacity * 2;
+        IOTHUB_CLIENT_EVENT_CONFIRMATION* new_batch;
+
+        if ((new_capacity < handleData->confirmationBatchCapacity) || (new_capacity > SIZE_MAX / sizeof(IOTHUB_CLIENT_EVENT_CONFIRMATION)))
         {
-            IOTHUB_MESSAGE_LIST* messageList = (IOTHUB_MESSAGE_LIST*)containingRecord(oldest, IOTHUB_MESSAGE_LIST, entry);
-            /*Codes_SRS_IOTHUBCLIENT_LL_02_026: [If any callback is NULL then there shall not be a callback call.]*/
-            if (messageList->callback != NULL)
-            {
-                messageList->callback(result, messageList->context);
-            }
-            IoTHubMessage_Destroy(messageList->messageHandle);
-            free(messageList);
+            LogError("confirmation batch cannot grow past %lu entries", (unsigned long)handleData->confirmationBatchCapacity);
+        }
+        else if ((new_batch = (IOTHUB_CLIENT_EVENT_CONFIRMATION*)realloc(handleData->confirmationBatch, new_capacity * sizeof(IOTHUB_CLIENT_EVENT_CONFIRMATION))) == NULL)
+        {
+            LogError("failure growing the confirmation batch");
+        }
+        else
+        {
+            handleData->confirmationBatch = new_batch;
+            handleData->confirmationBatchCapacity = new_capacity;
+            has_room = true;
         }
     }
+
+    if (has_room)
+    {
+        handleData->confirmationBatch[handleData->confirmationBatchCount].result = result;
+        handleData->confirmationBatch[handleData->confirmationBatchCount].userContextCallback = context;
+        handleData->confirmationBatchCount++;
+    }
+    else
+    {
+        /*no memory to hold it until the end of DoWork, so deliver what is pending plus this one now*/
+        IOTHUB_CLIENT_EVENT_CONFIRMATION single;
+        single.result = result;
+        single.userContextCallback = context;
+        flush_event_confirmations(handleData);
+        handleData->eventConfirmationBatchCallback(&single, 1, handleData->eventConfirmationBatchContextCallback);
+    }
 }
 
-static void IoTHubClientCore_LL_RetrievePropertyComplete(DEVICE_TWIN_UPDATE_STATE update_state, const unsigned char* payLoad, size_t size, void* ctx)
+/*records are individually allocated so that a transport that frees one itself (as AMQP does) only makes the pool smaller*/
+static IOTHUB_MESSAGE_LIST* get_message_list(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData)
 {
-    if (ctx == NULL)
+    IOTHUB_MESSAGE_LIST* result;
+    if (handleData->messageListPoolCount > 0)
     {
-        /* Codes_SRS_IOTHUBCLIENT_LL_07_013: [ If handle is NULL then IoTHubClientCore_LL_RetrievePropertyComplete shall do nothing.] */
-        LogError("Invalid argument ctx NULL");
+        result = handleData->messageListPool[--handleData->messageListPoolCount];
     }
     else
     {
-        IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)ctx;
-        /* Codes_SRS_IOTHUBCLIENT_LL_07_014: [ If deviceTwinCallback is NULL then IoTHubClientCore_LL_RetrievePropertyComplete shall do nothing.] */
-        if (handleData->deviceTwinCallback)
-        {
-            /* Codes_SRS_IOTHUBCLIENT_LL_07_015: [ If the the update_state parameter is DEVICE_TWIN_UPDATE_PARTIAL and a DEVICE_TWIN_UPDATE_COMPLETE has not been previously recieved then IoTHubClientCore_LL_RetrievePropertyComplete shall do nothing.] */
-            if (update_state == DEVICE_TWIN_UPDATE_COMPLETE)
-            {
-                handleData->complete_twin_update_encountered = true;
-            }
-            if (handleData->complete_twin_update_encountered)
-            {
-                /* Codes_SRS_IOTHUBCLIENT_LL_07_016: [ If deviceTwinCallback is set and DEVICE_TWIN_UPDATE_COMPLETE has been encountered then IoTHubClientCore_LL_RetrievePropertyComplete shall call deviceTwinCallback.] */
-                handleData->deviceTwinCallback(update_state, payLoad, size, handleData->deviceTwinContextCallback);
-            }
-        }
+        result = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST));
     }
+    return result;
 }
 
-static void IoTHubClientCore_LL_ReportedStateComplete(uint32_t item_id, int status_code, void* ctx)
+static void release_message_list(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_LIST* messageList)
 {
-    /* Codes_SRS_IOTHUBCLIENT_LL_07_002: [ if handle or queue_handle are NULL then IoTHubClientCore_LL_ReportedStateComplete shall do nothing. ] */
-    if (ctx == NULL)
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_011: [ A completed IOTHUB_MESSAGE_LIST record shall be kept for reuse while the pool holds fewer than OPTION_EVENT_POOL_SIZE records, and freed otherwise. ]*/
+    if (handleData->messageListPoolCount < handleData->messageListPoolSize)
     {
-        /*"shall return"*/
-        LogError("Invalid argument handle=%p", ctx);
+        handleData->messageListPool[handleData->messageListPoolCount++] = messageList;
     }
     else
     {
-        IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)ctx;
+        free(messageList);
+    }
+}
 
-        /* Codes_SRS_IOTHUBCLIENT_LL_07_003: [ IoTHubClientCore_LL_ReportedStateComplete shall enumerate through the IOTHUB_DEVICE_TWIN structures in queue_handle. ]*/
-        DLIST_ENTRY* client_item = handleData->iot_ack_queue.Flink;
-        while (client_item != &(handleData->iot_ack_queue)) /*while we are not at the end of the list*/
+static void release_small_event_slot(const unsigned char* byteArray, size_t size, void* context)
+{
+    SMALL_EVENT_SLOT* slot = (SMALL_EVENT_SLOT*)context;
+    (void)byteArray;
+    (void)size;
+
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_158: [ A slot shall be free again once the message of its event is destroyed, whether the event completed, timed out, was spilled, suppressed or failed to be queued. ]*/
+    slot->nextFree = slot->handleData->freeSmallEventSlots;
+    slot->handleData->freeSmallEventSlots = slot;
+    slot->handleData->smallEventSlotsInUse--;
+}
+
+static IOTHUB_CLIENT_RESULT set_small_event_slot_count(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, size_t slot_count)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if (handleData->smallEventSlotsInUse > 0)
+    {
+        result = IOTHUB_CLIENT_ERROR;
+        LogError("OPTION_SMALL_EVENT_SLOTS cannot be changed while %lu small events are in flight", (unsigned long)handleData->smallEventSlotsInUse);
+    }
+    else if (slot_count > SIZE_MAX / sizeof(SMALL_EVENT_SLOT))
+    {
+        result = IOTHUB_CLIENT_ERROR;
+        LogError("Invalid value: OPTION_SMALL_EVENT_SLOTS is too large");
+    }
+    else
+    {
+        SMALL_EVENT_SLOT* slots;
+
+        if (slot_count == 0)
         {
-            PDLIST_ENTRY next_item = client_item->Flink;
-            IOTHUB_DEVICE_TWIN* queue_data = containingRecord(client_item, IOTHUB_DEVICE_TWIN, entry);
-            if (queue_data->item_id == item_id)
+            slots = NULL;
+            result = IOTHUB_CLIENT_OK;
+        }
+        else if ((slots = (SMALL_EVENT_SLOT*)malloc(slot_count * sizeof(SMALL_EVENT_SLOT))) == NULL)
+        {
+            result = IOTHUB_CLIENT_ERROR;
+            LogError("failure allocating the small event slots");
+        }
+        else
+        {
+            size_t index;
+            for (index = 0; index < slot_count; index++)
             {
-                if (queue_data->reported_state_callback != NULL)
-                {
-                    queue_data->reported_state_callback(status_code, queue_data->context);
-                }
-                /*Codes_SRS_IOTHUBCLIENT_LL_07_009: [ IoTHubClientCore_LL_ReportedStateComplete shall remove the IOTHUB_DEVICE_TWIN item from the ack queue.]*/
-                DList_RemoveEntryList(client_item);
-                device_twin_data_destroy(queue_data);
-                break;
+                slots[index].handleData = handleData;
+                slots[index].nextFree = (index + 1 < slot_count) ? &slots[index + 1] : NULL;
             }
-            client_item = next_item;
+            result = IOTHUB_CLIENT_OK;
+        }
+
+        if (result == IOTHUB_CLIENT_OK)
+        {
+            free(handleData->smallEventSlots);
+            handleData->smallEventSlots = slots;
+            handleData->freeSmallEventSlots = slots;
+            handleData->smallEventSlotCount = slot_count;
         }
     }
+
+    return result;
 }
 
-static void IoTHubClientCore_LL_ConnectionStatusCallBack(IOTHUB_CLIENT_CONNECTION_STATUS status, IOTHUB_CLIENT_CONNECTION_STATUS_REASON reason, void* ctx)
+static IOTHUB_CLIENT_RESULT set_message_list_pool_size(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, size_t pool_size)
 {
-    /*Codes_SRS_IOTHUBCLIENT_LL_25_113: [If parameter connectionStatus is NULL or parameter handle is NULL then IoTHubClientCore_LL_ConnectionStatusCallBack shall return.]*/
-    if (ctx == NULL)
+    IOTHUB_CLIENT_RESULT result;
+
+    while (handleData->messageListPoolCount > pool_size)
     {
-        /*"shall return"*/
-        LogError("invalid arg");
+        free(handleData->messageListPool[--handleData->messageListPoolCount]);
+    }
+
+    if (pool_size > SIZE_MAX / sizeof(IOTHUB_MESSAGE_LIST*))
+    {
+        result = IOTHUB_CLIENT_ERROR;
+        LogError("Invalid value: OPTION_EVENT_POOL_SIZE is too large");
+    }
+    else if (pool_size > handleData->messageListPoolSize)
+    {
+        IOTHUB_MESSAGE_LIST** new_pool = (IOTHUB_MESSAGE_LIST**)realloc(handleData->messageListPool, pool_size * sizeof(IOTHUB_MESSAGE_LIST*));
+        if (new_pool == NULL)
+        {
+            result = IOTHUB_CLIENT_ERROR;
+            LogError("failure allocating the message list pool");
+        }
+        else
+        {
+            handleData->messageListPool = new_pool;
+            handleData->messageListPoolSize = pool_size;
+            result = IOTHUB_CLIENT_OK;
+        }
     }
     else
     {
-        IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)ctx;
+        handleData->messageListPoolSize = pool_size;
+        result = IOTHUB_CLIENT_OK;
+    }
 
-        /*Codes_SRS_IOTHUBCLIENT_LL_25_114: [IoTHubClientCore_LL_ConnectionStatusCallBack shall call non-callback set by the user from IoTHubClientCore_LL_SetConnectionStatusCallback passing the status, reason and the passed userContextCallback.]*/
-        if (handleData->conStatusCallback != NULL)
+    while ((result == IOTHUB_CLIENT_OK) && (handleData->messageListPoolCount < handleData->messageListPoolSize))
+    {
+        IOTHUB_MESSAGE_LIST* messageList = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST));
+        if (messageList == NULL)
         {
-            handleData->conStatusCallback(status, reason, handleData->conStatusUserContextCallback);
+            result = IOTHUB_CLIENT_ERROR;
+            LogError("failure pre-allocating the message list pool");
+        }
+        else
+        {
+            handleData->messageListPool[handleData->messageListPoolCount++] = messageList;
         }
     }
 
+    return result;
 }
 
-static const char* IoTHubClientCore_LL_GetProductInfo(void* ctx)
+static void record_latency(IOTHUB_CLIENT_LATENCY_HISTOGRAM* histogram, tickcounter_ms_t latency_ms)
 {
-    const char* result;
-    if (ctx == NULL)
+    size_t bucket = 0;
+    tickcounter_ms_t bucket_end = 1;
+    while ((latency_ms >= bucket_end) && (bucket < IOTHUB_CLIENT_LATENCY_HISTOGRAM_BUCKETS - 1))
     {
-        result = NULL;
-        LogError("invalid argument ctx %p", ctx);
+        bucket++;
+        bucket_end <<= 1;
     }
-    else
+
+    if ((histogram->count == 0) || (latency_ms < histogram->min_ms))
     {
-        IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* iothub_data = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)ctx;
-        result = STRING_c_str(iothub_data->product_info);
+        histogram->min_ms = latency_ms;
     }
-    return result;
+    if (latency_ms > histogram->max_ms)
+    {
+        histogram->max_ms = latency_ms;
+    }
+    histogram->count++;
+    histogram->sum_ms += latency_ms;
+    histogram->buckets[bucket]++;
 }
 
-static bool IoTHubClientCore_LL_MessageCallbackFromInput(MESSAGE_CALLBACK_INFO* messageData, void* ctx)
+/*returns true and sets now if the current time could be read*/
+static bool get_statistics_time(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, tickcounter_ms_t* now)
 {
     bool result;
-    IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)ctx;
-
-    if ((handleData == NULL) || messageData == NULL)
+    if (tickcounter_get_current_ms(handleData->tickCounter, now) != 0)
     {
-        // Codes_SRS_IOTHUBCLIENT_LL_31_137: [ If either parameter `handle` or `messageData` is `NULL` then `IoTHubClient_LL_MessageCallbackFromInput` shall return `false`.** ]
-        LogError("invalid argument: handle(%p), messageData(%p)", handleData, messageData);
+        LogError("unable to get the current ms, the sample will not be recorded");
         result = false;
     }
-    else if (messageData->messageHandle == NULL)
+    else
     {
-        // Codes_SRS_IOTHUBCLIENT_LL_31_137: [ If either parameter `handle` or `messageData` is `NULL` then `IoTHubClient_LL_MessageCallbackFromInput` shall return `false`.** ]
-        LogError("invalid argument messageData->messageHandle(NULL)");
-        result = false;
+        result = true;
     }
-    else if (handleData->event_callbacks == NULL)
+    return result;
+}
+
+static void start_trace(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, IOTHUB_CLIENT_TRACE_CONTEXT* trace, const char* traceparent)
+{
+    tickcounter_ms_t now;
+    if (IoTHubClient_Tracing_IsEnabled(&handleData->tracer) && get_statistics_time(handleData, &now))
     {
-        LogError("Callback from input called but no input specific callbacks registered");
-        result = false;
+        IoTHubClient_Tracing_Start(&handleData->tracer, trace, traceparent, now);
     }
     else
     {
-        const char* inputName = IoTHubMessage_GetInputName(messageData->messageHandle);
-
-        LIST_ITEM_HANDLE item_handle = NULL;
-
-        item_handle = singlylinkedlist_find(handleData->event_callbacks, is_event_equal_for_match, (const void*)inputName);
+        trace->active = false;
+    }
+}
 
-        if (item_handle == NULL)
+static void start_event_trace(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_LIST* messageList)
+{
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_071: [ While a trace exporter is set, IoTHubClientCore_LL_SendEventAsync shall start an EVENT_SEND span, in the trace of the event's "traceparent" property if it holds a valid one, and set that property to the new span. ]*/
+    if (!IoTHubClient_Tracing_IsEnabled(&handleData->tracer))
+    {
+        messageList->trace.active = false;
+    }
+    else
+    {
+        start_trace(handleData, &messageList->trace, IoTHubMessage_GetProperty(messageList->messageHandle, TRACEPARENT_PROPERTY_NAME));
+        if (messageList->trace.active)
         {
-            // Codes_SRS_IOTHUBCLIENT_LL_31_138: [ If there is no registered handler for the inputName from `IoTHubMessage_GetInputName`, then `IoTHubClient_LL_MessageCallbackFromInput` shall attempt invoke the default handler handler.** ]
-            item_handle = singlylinkedlist_find(handleData->event_callbacks, is_event_equal_for_match, NULL);
+            char traceparent[TRACEPARENT_LENGTH + 1];
+            if (IoTHubClient_Tracing_FormatTraceparent(&messageList->trace, traceparent, sizeof(traceparent)) != 0 ||
+                IoTHubMessage_SetProperty(messageList->messageHandle, TRACEPARENT_PROPERTY_NAME, traceparent) != IOTHUB_MESSAGE_OK)
+            {
+                LogError("unable to set the traceparent of the event, its spans are still exported");
+            }
         }
+    }
+}
 
-        if (item_handle == NULL)
+static void record_event_publish_trace(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_LIST* messageList)
+{
+    tickcounter_ms_t now;
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_072: [ The first publish of a traced event shall end its EVENT_QUEUE span and start its EVENT_PUBLISH span. ]*/
+    if (messageList->trace.active && !messageList->trace.published && get_statistics_time(handleData, &now))
+    {
+        messageList->trace.published = true;
+        messageList->trace.ms_published = now;
+        IoTHubClient_Tracing_ExportSpan(&handleData->tracer, IOTHUB_CLIENT_SPAN_EVENT_QUEUE, &messageList->trace, true, messageList->trace.ms_started, now, true, NULL);
+    }
+}
+
+static void record_event_completion_trace(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_LIST* messageList, IOTHUB_CLIENT_CONFIRMATION_RESULT result)
+{
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_073: [ The completion of a traced event shall end its EVENT_PUBLISH span, if it was published, and its EVENT_SEND span; both succeed only for IOTHUB_CLIENT_CONFIRMATION_OK. ]*/
+    if (messageList->trace.active)
+    {
+        tickcounter_ms_t now;
+        bool succeeded = (result == IOTHUB_CLIENT_CONFIRMATION_OK);
+        if (!get_statistics_time(handleData, &now))
         {
-            LogError("Could not find callback (explicit or default) for input queue %s", inputName);
-            result = false;
+            now = messageList->trace.published ? messageList->trace.ms_published : messageList->trace.ms_started;
         }
-        else
+        if (messageList->trace.published)
         {
-            IOTHUB_EVENT_CALLBACK* event_callback = (IOTHUB_EVENT_CALLBACK*)singlylinkedlist_item_get_value(item_handle);
-            if (NULL == event_callback)
-            {
-                LogError("singlylinkedlist_item_get_value for event_callback failed");
-                result = false;
-            }
-            else
-            {
-                // Codes_SRS_IOTHUBCLIENT_LL_09_004: [IoTHubClient_LL_GetLastMessageReceiveTime shall return lastMessageReceiveTime in localtime]
-                handleData->lastMessageReceiveTime = get_time(NULL);
-
-                if (event_callback->callbackAsyncEx != NULL)
-                {
-                    // Codes_SRS_IOTHUBCLIENT_LL_31_139: [ `IoTHubClient_LL_MessageCallbackFromInput` shall the callback from the given inputName queue if it has been registered.** ]
-                    result = event_callback->callbackAsyncEx(messageData, event_callback->userContextCallbackEx);
-                }
-                else
-                {
-                    // Codes_SRS_IOTHUBCLIENT_LL_31_139: [ `IoTHubClient_LL_MessageCallbackFromInput` shall the callback from the given inputName queue if it has been registered.** ]
-                    IOTHUBMESSAGE_DISPOSITION_RESULT cb_result = event_callback->callbackAsync(messageData->messageHandle, event_callback->userContextCallback);
-
-                    // Codes_SRS_IOTHUBCLIENT_LL_31_140: [ `IoTHubClient_LL_MessageCallbackFromInput` shall send the message disposition as returned by the client to the underlying layer and return `true` if an input queue match is found.** ]
-                    if (handleData->IoTHubTransport_SendMessageDisposition(messageData, cb_result) != IOTHUB_CLIENT_OK)
-                    {
-                        LogError("IoTHubTransport_SendMessageDisposition failed");
-                    }
-                    result = true;
-                }
-            }
+            IoTHubClient_Tracing_ExportSpan(&handleData->tracer, IOTHUB_CLIENT_SPAN_EVENT_PUBLISH, &messageList->trace, true, messageList->trace.ms_published, now, succeeded, NULL);
         }
+        IoTHubClient_Tracing_ExportSpan(&handleData->tracer, IOTHUB_CLIENT_SPAN_EVENT_SEND, &messageList->trace, false, messageList->trace.ms_started, now, succeeded, NULL);
+        messageList->trace.active = false;
     }
-    return result;
 }
 
-static bool IoTHubClientCore_LL_MessageCallback(MESSAGE_CALLBACK_INFO* messageData, void* ctx)
+static void record_event_completion(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_LIST* messageList, IOTHUB_CLIENT_CONFIRMATION_RESULT result)
 {
-    bool result;
-    if ((ctx == NULL) || messageData == NULL)
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_018: [ While statistics are enabled, every completed event shall be counted as confirmed or failed, and the time from its first publish to its confirmation shall be recorded in publish_to_ack. ]*/
+    if (result == IOTHUB_CLIENT_CONFIRMATION_OK)
     {
-        /*Codes_SRS_IOTHUBCLIENT_LL_02_029: [If parameter handle is NULL then IoTHubClient_LL_MessageCallback shall return IOTHUBMESSAGE_ABANDONED.] */
-        LogError("invalid argument: ctx(%p), messageData(%p)", ctx, messageData);
-        result = false;
+        tickcounter_ms_t now;
+        handleData->statistics.events_confirmed++;
+        if (messageList->published_stamped && get_statistics_time(handleData, &now))
+        {
+            record_latency(&handleData->statistics.publish_to_ack, now - messageList->ms_published);
+        }
     }
-    else if (messageData->messageHandle == NULL)
+    else
     {
-        /*Codes_SRS_IOTHUBCLIENT_LL_10_004: [If messageHandle field of paramger messageData is NULL then IoTHubClient_LL_MessageCallback shall return IOTHUBMESSAGE_ABANDONED.] */
-        LogError("invalid argument messageData->messageHandle(NULL)");
-        result = false;
+        handleData->statistics.events_failed++;
     }
-    else
+}
+
+static size_t get_event_payload_size(IOTHUB_MESSAGE_HANDLE messageHandle)
+{
+    size_t result;
+    const unsigned char* buffer;
+
+    if (get_message_payload(messageHandle, &buffer, &result) != 0)
     {
-        IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)ctx;
-        return invoke_message_callback(handleData, messageData);
+        result = 0;
     }
+
     return result;
 }
 
-static int IoTHubClientCore_LL_DeviceMethodComplete(const char* method_name, const unsigned char* payLoad, size_t size, METHOD_HANDLE response_id, void* ctx)
+static void release_pending_event(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_LIST* messageList, bool destroyed)
+{
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_026: [ When an event completes, its payload size shall no longer count against OPTION_MAX_PENDING_BYTES. ]*/
+    handleData->pendingBytes -= (messageList->pending_size <= handleData->pendingBytes) ? messageList->pending_size : handleData->pendingBytes;
+    messageList->pending_size = 0;
+
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_127: [ When an event completes, the bytes counted for it in IOTHUB_CLIENT_MEMORY_MESSAGE_QUEUE shall be removed. ]*/
+    IOTHUB_CLIENT_MEMORY_REMOVE(&handleData->memoryCounters, IOTHUB_CLIENT_MEMORY_MESSAGE_QUEUE, messageList->memory_size);
+    messageList->memory_size = 0;
+
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_031: [ An event read from the spill log shall be removed from it once it completes, unless it completes because the client or its transport is destroyed. ]*/
+    if (messageList->spill_generation != 0)
+    {
+        if (!destroyed && (messageList->spill_generation == handleData->spillGeneration) && (handleData->spillQueue != NULL) && (spill_queue_release(handleData->spillQueue) != 0))
+        {
+            LogError("Failed releasing a spilled event");
+        }
+        messageList->spill_generation = 0;
+    }
+}
+
+static void IoTHubClientCore_LL_StatisticsCallback(TRANSPORT_STATISTIC statistic, IOTHUB_MESSAGE_LIST* messageList, size_t size, void* ctx)
 {
-    int result;
     if (ctx == NULL)
     {
-        /* Codes_SRS_IOTHUBCLIENT_LL_07_017: [ If handle or response is NULL then IoTHubClientCore_LL_DeviceMethodComplete shall return 500. ] */
-        LogError("Invalid argument ctx=%p", ctx);
-        result = __FAILURE__;
+        LogError("Invalid argument ctx NULL");
     }
     else
     {
-        /* Codes_SRS_IOTHUBCLIENT_LL_07_018: [ If deviceMethodCallback is not NULL IoTHubClientCore_LL_DeviceMethodComplete shall execute deviceMethodCallback and return the status. ] */
         IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)ctx;
-        switch (handleData->methodCallback.type)
+
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_132: [ While the startup timeline is started, the transport reporting TRANSPORT_STATISTIC_AUTHENTICATION_STARTED, TRANSPORT_STATISTIC_EVENT_PUBLISHED or TRANSPORT_STATISTIC_EVENT_ACKNOWLEDGED shall mark IOTHUB_CLIENT_STARTUP_AUTHENTICATION_STARTED, IOTHUB_CLIENT_STARTUP_FIRST_EVENT_PUBLISHED or IOTHUB_CLIENT_STARTUP_FIRST_EVENT_CONFIRMED. ]*/
+        if (statistic == TRANSPORT_STATISTIC_AUTHENTICATION_STARTED)
         {
-            case CALLBACK_TYPE_SYNC:
+            IOTHUB_CLIENT_STARTUP_MARK(IOTHUB_CLIENT_STARTUP_AUTHENTICATION_STARTED);
+        }
+        else if (statistic == TRANSPORT_STATISTIC_EVENT_PUBLISHED)
+        {
+            IOTHUB_CLIENT_STARTUP_MARK(IOTHUB_CLIENT_STARTUP_FIRST_EVENT_PUBLISHED);
+        }
+        else if (statistic == TRANSPORT_STATISTIC_EVENT_ACKNOWLEDGED)
+        {
+            IOTHUB_CLIENT_STARTUP_MARK(IOTHUB_CLIENT_STARTUP_FIRST_EVENT_CONFIRMED);
+        }
+
+        /*transports that complete events themselves (AMQP) only report it here*/
+        if ((messageList != NULL) && ((statistic == TRANSPORT_STATISTIC_EVENT_ACKNOWLEDGED) || (statistic == TRANSPORT_STATISTIC_EVENT_FAILED)))
+        {
+            release_pending_event(handleData, messageList, false);
+            record_event_completion_trace(handleData, messageList, (statistic == TRANSPORT_STATISTIC_EVENT_ACKNOWLEDGED) ? IOTHUB_CLIENT_CONFIRMATION_OK : IOTHUB_CLIENT_CONFIRMATION_ERROR);
+        }
+        else if ((messageList != NULL) && (statistic == TRANSPORT_STATISTIC_EVENT_PUBLISHED))
+        {
+            record_event_publish_trace(handleData, messageList);
+        }
+
+        if (handleData->statisticsEnabled)
+        {
+            switch (statistic)
             {
-                unsigned char* payload_resp = NULL;
-                size_t response_size = 0;
-                result = handleData->methodCallback.callbackSync(method_name, payLoad, size, &payload_resp, &response_size, handleData->methodCallback.userContextCallback);
-                /* Codes_SRS_IOTHUBCLIENT_LL_07_020: [ deviceMethodCallback shall build the BUFFER_HANDLE with the response payload from the IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC callback. ] */
-                if (payload_resp != NULL && response_size > 0)
-                {
-                    result = handleData->IoTHubTransport_DeviceMethod_Response(handleData->deviceHandle, response_id, payload_resp, response_size, result);
-                }
-                else
-                {
-                    result = __FAILURE__;
-                }
-                if (payload_resp != NULL)
+                case TRANSPORT_STATISTIC_EVENT_PUBLISHED:
+                    /*Codes_SRS_IOTHUBCLIENT_LL_41_019: [ While statistics are enabled, every publish reported by the transport shall add its size to bytes_sent; the first publish of an event shall count it as published and record the time since it was queued in enqueue_to_publish. ]*/
+                    handleData->statistics.bytes_sent += size;
+                    if ((messageList != NULL) && !messageList->published_stamped && get_statistics_time(handleData, &messageList->ms_published))
+                    {
+                        messageList->published_stamped = true;
+                        handleData->statistics.events_published++;
+                        if (messageList->enqueued_stamped)
+                        {
+                            record_latency(&handleData->statistics.enqueue_to_publish, messageList->ms_published - messageList->ms_enqueued);
+                        }
+                    }
+                    break;
+                case TRANSPORT_STATISTIC_EVENT_ACKNOWLEDGED:
+                case TRANSPORT_STATISTIC_EVENT_FAILED:
+                    if (messageList != NULL)
+                    {
+                        record_event_completion(handleData, messageList, (statistic == TRANSPORT_STATISTIC_EVENT_ACKNOWLEDGED) ? IOTHUB_CLIENT_CONFIRMATION_OK : IOTHUB_CLIENT_CONFIRMATION_ERROR);
+                    }
+                    break;
+                case TRANSPORT_STATISTIC_BYTES_RECEIVED:
+                    handleData->statistics.bytes_received += size;
+                    break;
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_043: [ While statistics are enabled, every batch reported by the transport shall be counted in batches_sent, its size added to batch_bytes and its capacity added to batch_capacity. ]*/
+                case TRANSPORT_STATISTIC_BATCH_SENT:
+                    handleData->statistics.batches_sent++;
+                    handleData->statistics.batch_bytes += size;
+                    break;
+                case TRANSPORT_STATISTIC_BATCH_CAPACITY:
+                    handleData->statistics.batch_capacity += size;
+                    break;
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_044: [ While statistics are enabled, the time from the transport reporting that the device started authenticating to it reporting the device authenticated shall be recorded in time_to_authenticated. ]*/
+                case TRANSPORT_STATISTIC_AUTHENTICATION_STARTED:
+                    handleData->authenticationStarted = get_statistics_time(handleData, &handleData->msAuthenticationStarted);
+                    break;
+                case TRANSPORT_STATISTIC_AUTHENTICATED:
                 {
-                    free(payload_resp);
+                    tickcounter_ms_t now;
+                    if (handleData->authenticationStarted && get_statistics_time(handleData, &now))
+                    {
+                        record_latency(&handleData->statistics.time_to_authenticated, now - handleData->msAuthenticationStarted);
+                    }
+                    handleData->authenticationStarted = false;
+                    break;
                 }
-                break;
+                default:
+                    LogError("Unknown statistic %d", (int)statistic);
+                    break;
             }
-            case CALLBACK_TYPE_ASYNC:
-                result = handleData->methodCallback.callbackAsync(method_name, payLoad, size, response_id, handleData->methodCallback.userContextCallback);
-                break;
-            default:
-                /* Codes_SRS_IOTHUBCLIENT_LL_07_019: [ If deviceMethodCallback is NULL IoTHubClientCore_LL_DeviceMethodComplete shall return 404. ] */
-                result = 0;
-                break;
         }
     }
-    return result;
 }
 
-static IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* initialize_iothub_client(const IOTHUB_CLIENT_CONFIG* client_config, const IOTHUB_CLIENT_DEVICE_CONFIG* device_config, bool use_dev_auth, const char* module_id)
+static void complete_event(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_LIST* messageList, IOTHUB_CLIENT_CONFIRMATION_RESULT result)
 {
-    IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* result;
-    srand((unsigned int)time(NULL));
-    STRING_HANDLE product_info = make_product_info(NULL);
-    if (product_info == NULL)
+    release_pending_event(handleData, messageList, (result == IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY));
+    record_event_completion_trace(handleData, messageList, result);
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_134: [ While the startup timeline is started, a queued event shall mark IOTHUB_CLIENT_STARTUP_FIRST_EVENT_QUEUED and an event completed with IOTHUB_CLIENT_CONFIRMATION_OK IOTHUB_CLIENT_STARTUP_FIRST_EVENT_CONFIRMED. ]*/
+    if (result == IOTHUB_CLIENT_CONFIRMATION_OK)
     {
-        LogError("failed to initialize product info");
-        result = NULL;
+        IOTHUB_CLIENT_STARTUP_MARK(IOTHUB_CLIENT_STARTUP_FIRST_EVENT_CONFIRMED);
     }
-    else
+
+    if (handleData->statisticsEnabled)
     {
-        result = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)malloc(sizeof(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA));
-        if (result == NULL)
-        {
-            LogError("failure allocating IOTHUB_CLIENT_CORE_LL_HANDLE_DATA");
-            STRING_delete(product_info);
+        record_event_completion(handleData, messageList, result);
+    }
+
+    /*Codes_SRS_IOTHUBCLIENT_LL_02_026: [If any callback is NULL then there shall not be a callback call.]*/
+    if (messageList->callback != NULL)
+    {
+        messageList->callback(result, messageList->context);
+    }
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_003: [ If a batch confirmation callback is set, the completion of every event sent without its own callback shall be recorded as a (`userContextCallback`, `result`) pair for the batch. ]*/
+    else if (handleData->eventConfirmationBatchCallback != NULL)
+    {
+        add_event_confirmation(handleData, result, messageList->context);
+    }
+}
+
+static IOTHUB_CLIENT_RESULT suppress_event(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback, bool takeOwnership)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if (handleData->suppressedEventCount == handleData->suppressedEventCapacity)
+    {
+        size_t new_capacity = (handleData->suppressedEventCapacity == 0) ? CONFIRMATION_BATCH_INITIAL_CAPACITY : handleData->suppressedEventCapacity * 2;
+        SUPPRESSED_EVENT* new_events;
+
+        if ((new_capacity < handleData->suppressedEventCapacity) || (new_capacity > SIZE_MAX / sizeof(SUPPRESSED_EVENT)) ||
+            ((new_events = (SUPPRESSED_EVENT*)realloc(handleData->suppressedEvents, new_capacity * sizeof(SUPPRESSED_EVENT))) == NULL))
+        {
+            LogError("failure growing the suppressed events past %lu entries", (unsigned long)handleData->suppressedEventCapacity);
         }
         else
         {
-            IOTHUB_CLIENT_CONFIG actual_config;
-            const IOTHUB_CLIENT_CONFIG* config = NULL;
-            char* IoTHubName = NULL;
-            char* IoTHubSuffix = NULL;
+            handleData->suppressedEvents = new_events;
+            handleData->suppressedEventCapacity = new_capacity;
+        }
+    }
 
-            memset(result, 0, sizeof(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA));
-            if (use_dev_auth)
+    if (handleData->suppressedEventCount == handleData->suppressedEventCapacity)
+    {
+        result = IOTHUB_CLIENT_ERROR;
+        LOG_ERROR_RESULT;
+    }
+    else
+    {
+        handleData->suppressedEvents[handleData->suppressedEventCount].callback = eventConfirmationCallback;
+        handleData->suppressedEvents[handleData->suppressedEventCount].context = userContextCallback;
+        handleData->suppressedEventCount++;
+        if (handleData->statisticsEnabled)
+        {
+            handleData->statistics.events_queued++;
+        }
+        if (takeOwnership)
+        {
+            IoTHubMessage_Destroy(eventMessageHandle);
+        }
+        result = IOTHUB_CLIENT_OK;
+    }
+
+    return result;
+}
+
+static void complete_suppressed_events(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData)
+{
+    /*the callbacks may suppress more events, those wait for the next call*/
+    size_t count = handleData->suppressedEventCount;
+    size_t index;
+    IOTHUB_MESSAGE_LIST messageList;
+
+    (void)memset(&messageList, 0, sizeof(messageList));
+    for (index = 0; index < count; index++)
+    {
+        messageList.callback = handleData->suppressedEvents[index].callback;
+        messageList.context = handleData->suppressedEvents[index].context;
+        complete_event(handleData, &messageList, IOTHUB_CLIENT_CONFIRMATION_OK);
+    }
+
+    handleData->suppressedEventCount -= count;
+    if (handleData->suppressedEventCount > 0)
+    {
+        (void)memmove(handleData->suppressedEvents, handleData->suppressedEvents + count, handleData->suppressedEventCount * sizeof(SUPPRESSED_EVENT));
+    }
+}
+
+static void IoTHubClientCore_LL_SendComplete(PDLIST_ENTRY completed, IOTHUB_CLIENT_CONFIRMATION_RESULT result, void* ctx)
+{
+    /*Codes_SRS_IOTHUBCLIENT_LL_02_022: [If parameter completed is NULL, or parameter handle is NULL then IoTHubClientCore_LL_SendBatch shall return.]*/
+    if (
+        (ctx == NULL) ||
+        (completed == NULL)
+        )
+    {
+        /*"shall return"*/
+        LogError("invalid arg");
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_02_027: [If parameter result is IOTHUB_CLIENT_CONFIRMATION_ERROR then IoTHubClientCore_LL_SendComplete shall call all the non-NULL callbacks with the result parameter set to IOTHUB_CLIENT_CONFIRMATION_ERROR and the context set to the context passed originally in the SendEventAsync call.] */
+        /*Codes_SRS_IOTHUBCLIENT_LL_02_025: [If parameter result is IOTHUB_CLIENT_CONFIRMATION_OK then IoTHubClientCore_LL_SendComplete shall call all the non-NULL callbacks with the result parameter set to IOTHUB_CLIENT_CONFIRMATION_OK and the context set to the context passed originally in the SendEventAsync call.]*/
+        PDLIST_ENTRY oldest;
+        while ((oldest = DList_RemoveHeadList(completed)) != completed)
+        {
+            IOTHUB_MESSAGE_LIST* messageList = (IOTHUB_MESSAGE_LIST*)containingRecord(oldest, IOTHUB_MESSAGE_LIST, entry);
+            complete_event((IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)ctx, messageList, result);
+            IoTHubMessage_Destroy(messageList->messageHandle);
+            release_message_list((IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)ctx, messageList);
+        }
+    }
+}
+
+static void IoTHubClientCore_LL_RetrievePropertyComplete(DEVICE_TWIN_UPDATE_STATE update_state, const unsigned char* payLoad, size_t size, void* ctx)
+{
+    if (ctx == NULL)
+    {
+        /* Codes_SRS_IOTHUBCLIENT_LL_07_013: [ If handle is NULL then IoTHubClientCore_LL_RetrievePropertyComplete shall do nothing.] */
+        LogError("Invalid argument ctx NULL");
+    }
+    else
+    {
+        IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)ctx;
+        /* Codes_SRS_IOTHUBCLIENT_LL_07_014: [ If deviceTwinCallback is NULL then IoTHubClientCore_LL_RetrievePropertyComplete shall do nothing.] */
+        if ((handleData->deviceTwinCallback != NULL) || (handleData->twinFanout != NULL))
+        {
+            /* Codes_SRS_IOTHUBCLIENT_LL_07_015: [ If the the update_state parameter is DEVICE_TWIN_UPDATE_PARTIAL and a DEVICE_TWIN_UPDATE_COMPLETE has not been previously recieved then IoTHubClientCore_LL_RetrievePropertyComplete shall do nothing.] */
+            if (update_state == DEVICE_TWIN_UPDATE_COMPLETE)
             {
-                if ((result->authorization_module = IoTHubClient_Auth_CreateFromDeviceAuth(client_config->deviceId, module_id)) == NULL)
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_133: [ While the startup timeline is started, a complete twin shall mark IOTHUB_CLIENT_STARTUP_TWIN_RECEIVED. ]*/
+                IOTHUB_CLIENT_STARTUP_MARK(IOTHUB_CLIENT_STARTUP_TWIN_RECEIVED);
+                handleData->complete_twin_update_encountered = true;
+            }
+            if (handleData->complete_twin_update_encountered)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_119: [ If a twin cache file is set, IoTHubClientCore_LL_RetrievePropertyComplete shall not call deviceTwinCallback for a complete twin whose desired $version is the cached one, nor for a desired patch whose $version is not above it. ]*/
+                if ((handleData->twinCache == NULL) || twin_cache_update(handleData->twinCache, update_state, payLoad, size))
                 {
-                    LogError("Failed create authorization module");
-                    free(result);
-                    STRING_delete(product_info);
-                    result = NULL;
+                    /* Codes_SRS_IOTHUBCLIENT_LL_07_016: [ If deviceTwinCallback is set and DEVICE_TWIN_UPDATE_COMPLETE has been encountered then IoTHubClientCore_LL_RetrievePropertyComplete shall call deviceTwinCallback.] */
+                    if (handleData->deviceTwinCallback != NULL)
+                    {
+                        handleData->deviceTwinCallback(update_state, payLoad, size, handleData->deviceTwinContextCallback);
+                    }
+                    /*Codes_SRS_IOTHUBCLIENT_LL_41_150: [ IoTHubClientCore_LL_RetrievePropertyComplete shall then give the update to the desired property subscriptions, which parse it once and call only the subscriptions whose path it holds. ]*/
+                    if (handleData->twinFanout != NULL)
+                    {
+                        twin_fanout_dispatch(handleData->twinFanout, update_state, payLoad, size);
+                    }
                 }
             }
-            else
+        }
+    }
+}
+
+static void record_reported_state_trace(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, IOTHUB_DEVICE_TWIN* queue_data, int status_code)
+{
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_075: [ The acknowledgement of a traced reported state shall end its REPORTED_STATE_PUBLISH span, if the transport took it, and its REPORTED_STATE span; both succeed only for a 2xx status_code. ]*/
+    tickcounter_ms_t now;
+    if (queue_data->trace.active && get_statistics_time(handleData, &now))
+    {
+        bool succeeded = (status_code >= 200 && status_code < 300);
+        if (queue_data->trace.published)
+        {
+            IoTHubClient_Tracing_ExportSpan(&handleData->tracer, IOTHUB_CLIENT_SPAN_REPORTED_STATE_PUBLISH, &queue_data->trace, true, queue_data->trace.ms_published, now, succeeded, NULL);
+        }
+        IoTHubClient_Tracing_ExportSpan(&handleData->tracer, IOTHUB_CLIENT_SPAN_REPORTED_STATE, &queue_data->trace, false, queue_data->trace.ms_started, now, succeeded, NULL);
+    }
+    queue_data->trace.active = false;
+}
+
+static void IoTHubClientCore_LL_ReportedStateComplete(uint32_t item_id, int status_code, void* ctx)
+{
+    /* Codes_SRS_IOTHUBCLIENT_LL_07_002: [ if handle or queue_handle are NULL then IoTHubClientCore_LL_ReportedStateComplete shall do nothing. ] */
+    if (ctx == NULL)
+    {
+        /*"shall return"*/
+        LogError("Invalid argument handle=%p", ctx);
+    }
+    else
+    {
+        IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)ctx;
+
+        /* Codes_SRS_IOTHUBCLIENT_LL_07_003: [ IoTHubClientCore_LL_ReportedStateComplete shall enumerate through the IOTHUB_DEVICE_TWIN structures in queue_handle. ]*/
+        DLIST_ENTRY* client_item = handleData->iot_ack_queue.Flink;
+        while (client_item != &(handleData->iot_ack_queue)) /*while we are not at the end of the list*/
+        {
+            PDLIST_ENTRY next_item = client_item->Flink;
+            IOTHUB_DEVICE_TWIN* queue_data = containingRecord(client_item, IOTHUB_DEVICE_TWIN, entry);
+            if (queue_data->item_id == item_id)
             {
-                const char* device_key;
-                const char* device_id;
-                const char* sas_token;
-                if (device_config == NULL)
+                tickcounter_ms_t now;
+                IOTHUB_DEVICE_TWIN* merged_item;
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_020: [ While statistics are enabled, the time from the transport taking a reported state to its acknowledgement shall be recorded in twin_round_trip. ]*/
+                if (handleData->statisticsEnabled && queue_data->sent_stamped && get_statistics_time(handleData, &now))
                 {
-                    device_key = client_config->deviceKey;
-                    device_id = client_config->deviceId;
-                    sas_token = client_config->deviceSasToken;
+                    record_latency(&handleData->statistics.twin_round_trip, now - queue_data->ms_sent);
                 }
-                else
+                record_reported_state_trace(handleData, queue_data, status_code);
+                if (queue_data->reported_state_callback != NULL)
                 {
-                    device_key = device_config->deviceKey;
-                    device_id = device_config->deviceId;
-                    sas_token = device_config->deviceSasToken;
+                    queue_data->reported_state_callback(status_code, queue_data->context);
                 }
-
-                /* Codes_SRS_IOTHUBCLIENT_LL_07_029: [ IoTHubClientCore_LL_Create shall create the Auth module with the device_key, device_id, and/or deviceSasToken values ] */
-                if ((result->authorization_module = IoTHubClient_Auth_Create(device_key, device_id, sas_token, module_id)) == NULL)
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_036: [ IoTHubClientCore_LL_ReportedStateComplete shall then call, in the order they were sent, the callbacks of the reported states merged into the completed one, with the same status_code. ]*/
+                merged_item = queue_data->coalesced;
+                while (merged_item != NULL)
                 {
-                    LogError("Failed create authorization module");
-                    free(result);
-                    STRING_delete(product_info);
-                    result = NULL;
+                    record_reported_state_trace(handleData, merged_item, status_code);
+                    if (merged_item->reported_state_callback != NULL)
+                    {
+                        merged_item->reported_state_callback(status_code, merged_item->context);
+                    }
+                    merged_item = merged_item->coalesced;
                 }
+                /*Codes_SRS_IOTHUBCLIENT_LL_07_009: [ IoTHubClientCore_LL_ReportedStateComplete shall remove the IOTHUB_DEVICE_TWIN item from the ack queue.]*/
+                DList_RemoveEntryList(client_item);
+                device_twin_data_destroy(queue_data);
+                break;
             }
+            client_item = next_item;
+        }
+    }
+}
 
-            if (result != NULL)
-            {
-                TRANSPORT_CALLBACKS_INFO transport_cb;
-                memset(&transport_cb, 0, sizeof(TRANSPORT_CALLBACKS_INFO));
-                transport_cb.send_complete_cb = IoTHubClientCore_LL_SendComplete;
-                transport_cb.twin_retrieve_prop_complete_cb = IoTHubClientCore_LL_RetrievePropertyComplete;
-                transport_cb.twin_rpt_state_complete_cb = IoTHubClientCore_LL_ReportedStateComplete;
-                transport_cb.connection_status_cb = IoTHubClientCore_LL_ConnectionStatusCallBack;
-                transport_cb.prod_info_cb = IoTHubClientCore_LL_GetProductInfo;
-                transport_cb.msg_input_cb = IoTHubClientCore_LL_MessageCallbackFromInput;
-                transport_cb.msg_cb = IoTHubClientCore_LL_MessageCallback;
-                transport_cb.method_complete_cb = IoTHubClientCore_LL_DeviceMethodComplete;
+static void IoTHubClientCore_LL_ConnectionStatusCallBack(IOTHUB_CLIENT_CONNECTION_STATUS status, IOTHUB_CLIENT_CONNECTION_STATUS_REASON reason, void* ctx)
+{
+    /*Codes_SRS_IOTHUBCLIENT_LL_25_113: [If parameter connectionStatus is NULL or parameter handle is NULL then IoTHubClientCore_LL_ConnectionStatusCallBack shall return.]*/
+    if (ctx == NULL)
+    {
+        /*"shall return"*/
+        LogError("invalid arg");
+    }
+    else
+    {
+        IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)ctx;
 
-                if (client_config != NULL)
-                {
-                    IOTHUBTRANSPORT_CONFIG lowerLayerConfig;
-                    memset(&lowerLayerConfig, 0, sizeof(IOTHUBTRANSPORT_CONFIG));
-                    /*Codes_SRS_IOTHUBCLIENT_LL_02_006: [IoTHubClientCore_LL_Create shall populate a structure of type IOTHUBTRANSPORT_CONFIG with the information from config parameter and the previous DLIST and shall pass that to the underlying layer _Create function.]*/
-                    lowerLayerConfig.upperConfig = client_config;
-                    lowerLayerConfig.waitingToSend = &(result->waitingToSend);
-                    lowerLayerConfig.auth_module_handle = result->authorization_module;
-                    lowerLayerConfig.moduleId = module_id;
+        IOTHUB_CLIENT_TRACE(IOTHUB_CLIENT_TRACE_CONNECTION_STATUS, handleData, status, reason);
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_131: [ While the startup timeline is started, IOTHUB_CLIENT_CONNECTION_AUTHENTICATED shall mark IOTHUB_CLIENT_STARTUP_AUTHENTICATED. ]*/
+        if (status == IOTHUB_CLIENT_CONNECTION_AUTHENTICATED)
+        {
+            IOTHUB_CLIENT_STARTUP_MARK(IOTHUB_CLIENT_STARTUP_AUTHENTICATED);
+        }
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_154: [ The client shall be taken as connected from IOTHUB_CLIENT_CONNECTION_AUTHENTICATED, or from the transport taking a reported state, until any other status, or until IoTHubTransport_ProcessItem returns IOTHUB_PROCESS_NOT_CONNECTED. ]*/
+        handleData->twinConnected = (status == IOTHUB_CLIENT_CONNECTION_AUTHENTICATED);
 
-                    setTransportProtocol(result, (TRANSPORT_PROVIDER*)client_config->protocol());
-                    if ((result->transportHandle = result->IoTHubTransport_Create(&lowerLayerConfig, &transport_cb, result)) == NULL)
-                    {
-                        /*Codes_SRS_IOTHUBCLIENT_LL_02_007: [If the underlaying layer _Create function fails them IoTHubClientCore_LL_Create shall fail and return NULL.] */
-                        LogError("underlying transport failed");
-                        destroy_blob_upload_module(result);
-                        destroy_module_method_module(result);
-                        tickcounter_destroy(result->tickCounter);
-                        IoTHubClient_Auth_Destroy(result->authorization_module);
-                        STRING_delete(product_info);
-                        free(result);
-                        result = NULL;
-                    }
-                    else
-                    {
-                        /*Codes_SRS_IOTHUBCLIENT_LL_02_008: [Otherwise, IoTHubClientCore_LL_Create shall succeed and return a non-NULL handle.] */
-                        result->isSharedTransport = false;
-                        config = client_config;
-                    }
-                }
-                else
-                {
-                    STRING_HANDLE transport_hostname = NULL;
+        /*Codes_SRS_IOTHUBCLIENT_LL_25_114: [IoTHubClientCore_LL_ConnectionStatusCallBack shall call non-callback set by the user from IoTHubClientCore_LL_SetConnectionStatusCallback passing the status, reason and the passed userContextCallback.]*/
+        if (handleData->conStatusCallback != NULL)
+        {
+            handleData->conStatusCallback(status, reason, handleData->conStatusUserContextCallback);
+        }
+    }
 
-                    result->transportHandle = device_config->transportHandle;
-                    setTransportProtocol(result, (TRANSPORT_PROVIDER*)device_config->protocol());
+}
 
-                    if (result->IoTHubTransport_SetCallbackContext(result->transportHandle, result) != 0)
-                    {
-                        LogError("unable to set transport callbacks");
-                        IoTHubClient_Auth_Destroy(result->authorization_module);
-                        STRING_delete(product_info);
-                        free(result);
-                        result = NULL;
-                    }
-                    else if ((transport_hostname = result->IoTHubTransport_GetHostname(result->transportHandle)) == NULL)
-                    {
-                        /*Codes_SRS_IOTHUBCLIENT_LL_02_097: [ If creating the data structures fails or instantiating the IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE fails then IoTHubClientCore_LL_CreateWithTransport shall fail and return NULL. ]*/
-                        LogError("unable to determine the transport IoTHub name");
-                        IoTHubClient_Auth_Destroy(result->authorization_module);
-                        STRING_delete(product_info);
-                        free(result);
-                        result = NULL;
-                    }
-                    else
-                    {
-                        const char* hostname = STRING_c_str(transport_hostname);
-                        /*Codes_SRS_IOTHUBCLIENT_LL_02_096: [ IoTHubClientCore_LL_CreateWithTransport shall create the data structures needed to instantiate a IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE. ]*/
-                        /*the first '.' says where the iothubname finishes*/
-                        const char* whereIsDot = strchr(hostname, '.');
-                        if (whereIsDot == NULL)
-                        {
-                            /*Codes_SRS_IOTHUBCLIENT_LL_02_097: [ If creating the data structures fails or instantiating the IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE fails then IoTHubClientCore_LL_CreateWithTransport shall fail and return NULL. ]*/
-                            LogError("unable to determine the IoTHub name");
-                            IoTHubClient_Auth_Destroy(result->authorization_module);
-                            STRING_delete(product_info);
-                            free(result);
-                            result = NULL;
-                        }
-                        else
-                        {
-                            size_t suffix_len = strlen(whereIsDot);
-                            /*Codes_SRS_IOTHUBCLIENT_LL_02_096: [ IoTHubClientCore_LL_CreateWithTransport shall create the data structures needed to instantiate a IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE. ]*/
-                            IoTHubName = (char*)malloc(whereIsDot - hostname + 1);
-                            if (IoTHubName == NULL)
-                            {
-                                /*Codes_SRS_IOTHUBCLIENT_LL_02_097: [ If creating the data structures fails or instantiating the IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE fails then IoTHubClientCore_LL_CreateWithTransport shall fail and return NULL. ]*/
-                                LogError("unable to malloc");
-                                IoTHubClient_Auth_Destroy(result->authorization_module);
-                                STRING_delete(product_info);
-                                free(result);
-                                result = NULL;
-                            }
-                            else if ((IoTHubSuffix = (char*)malloc(suffix_len + 1)) == NULL)
-                            {
-                                /*Codes_SRS_IOTHUBCLIENT_LL_02_097: [ If creating the data structures fails or instantiating the IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE fails then IoTHubClientCore_LL_CreateWithTransport shall fail and return NULL. ]*/
-                                LogError("unable to malloc");
-                                IoTHubClient_Auth_Destroy(result->authorization_module);
-                                STRING_delete(product_info);
-                                free(result);
-                                result = NULL;
-                            }
-                            else
-                            {
-                                memset(IoTHubName, 0, whereIsDot - hostname + 1);
-                                (void)memcpy(IoTHubName, hostname, whereIsDot - hostname);
-                                (void)strcpy(IoTHubSuffix, whereIsDot+1);
+static const char* IoTHubClientCore_LL_GetProductInfo(void* ctx)
+{
+    const char* result;
+    if (ctx == NULL)
+    {
+        result = NULL;
+        LogError("invalid argument ctx %p", ctx);
+    }
+    else
+    {
+        IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* iothub_data = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)ctx;
+        result = STRING_c_str(iothub_data->product_info);
+    }
+    return result;
+}
 
-                                actual_config.deviceId = device_config->deviceId;
-                                actual_config.deviceKey = device_config->deviceKey;
-                                actual_config.deviceSasToken = device_config->deviceSasToken;
-                                actual_config.iotHubName = IoTHubName;
-                                actual_config.iotHubSuffix = IoTHubSuffix;
-                                actual_config.protocol = NULL; /*irrelevant to IoTHubClientCore_LL_UploadToBlob*/
-                                actual_config.protocolGatewayHostName = NULL; /*irrelevant to IoTHubClientCore_LL_UploadToBlob*/
+static bool IoTHubClientCore_LL_MessageCallbackFromInput(MESSAGE_CALLBACK_INFO* messageData, void* ctx)
+{
+    bool result;
+    IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)ctx;
 
-                                config = &actual_config;
+    if ((handleData == NULL) || messageData == NULL)
+    {
+        // Codes_SRS_IOTHUBCLIENT_LL_31_137: [ If either parameter `handle` or `messageData` is `NULL` then `IoTHubClient_LL_MessageCallbackFromInput` shall return `false`.** ]
+        LogError("invalid argument: handle(%p), messageData(%p)", handleData, messageData);
+        result = false;
+    }
+    else if (messageData->messageHandle == NULL)
+    {
+        // Codes_SRS_IOTHUBCLIENT_LL_31_137: [ If either parameter `handle` or `messageData` is `NULL` then `IoTHubClient_LL_MessageCallbackFromInput` shall return `false`.** ]
+        LogError("invalid argument messageData->messageHandle(NULL)");
+        result = false;
+    }
+    else if (handleData->event_callbacks == NULL)
+    {
+        LogError("Callback from input called but no input specific callbacks registered");
+        result = false;
+    }
+    else
+    {
+        const char* inputName = IoTHubMessage_GetInputName(messageData->messageHandle);
+        IOTHUB_EVENT_CALLBACK* event_callback = NULL;
 
-                                /*Codes_SRS_IOTHUBCLIENT_LL_02_008: [Otherwise, IoTHubClientCore_LL_Create shall succeed and return a non-NULL handle.] */
-                                result->isSharedTransport = true;
-                            }
-                        }
-                    }
-                    STRING_delete(transport_hostname);
-                }
-            }
-            if (result != NULL)
-            {
-                if (create_blob_upload_module(result, config) != 0)
-                {
-                    LogError("unable to create blob upload");
-                    // Codes_SRS_IOTHUBCLIENT_LL_09_010: [ If any failure occurs `IoTHubClientCore_LL_Create` shall destroy the `transportHandle` only if it has created it ]
-                    if (!result->isSharedTransport)
-                    {
-                        result->IoTHubTransport_Destroy(result->transportHandle);
-                    }
-                    destroy_blob_upload_module(result);
-                    IoTHubClient_Auth_Destroy(result->authorization_module);
-                    STRING_delete(product_info);
-                    free(result);
-                    result = NULL;
-                }
-                else if ((module_id != NULL) && create_edge_handle(result, config, module_id) != 0)
-                {
-                    LogError("unable to create module method handle");
-                    if (!result->isSharedTransport)
-                    {
-                        result->IoTHubTransport_Destroy(result->transportHandle);
-                    }
-                    destroy_blob_upload_module(result);
-                    IoTHubClient_Auth_Destroy(result->authorization_module);
-                    STRING_delete(product_info);
-                    free(result);
-                    result = NULL;
-                }
-                else
-                {
-                    if ((result->tickCounter = tickcounter_create()) == NULL)
-                    {
-                        LogError("unable to get a tickcounter");
-                        // Codes_SRS_IOTHUBCLIENT_LL_09_010: [ If any failure occurs `IoTHubClientCore_LL_Create` shall destroy the `transportHandle` only if it has created it ]
-                        if (!result->isSharedTransport)
-                        {
-                            result->IoTHubTransport_Destroy(result->transportHandle);
-                        }
-                        destroy_blob_upload_module(result);
-                        destroy_module_method_module(result);
-                        IoTHubClient_Auth_Destroy(result->authorization_module);
-                        STRING_delete(product_info);
-                        free(result);
-                        result = NULL;
-                    }
-                    else
-                    {
-                        /*Codes_SRS_IOTHUBCLIENT_LL_02_004: [Otherwise IoTHubClientCore_LL_Create shall initialize a new DLIST (further called "waitingToSend") containing records with fields of the following types: IOTHUB_MESSAGE_HANDLE, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, void*.]*/
-                        DList_InitializeListHead(&(result->waitingToSend));
-                        DList_InitializeListHead(&(result->iot_msg_queue));
-                        DList_InitializeListHead(&(result->iot_ack_queue));
-                        result->messageCallback.type = CALLBACK_TYPE_NONE;
-                        result->lastMessageReceiveTime = INDEFINITE_TIME;
-                        result->data_msg_id = 1;
-                        result->product_info = product_info;
+        if (inputName != NULL)
+        {
+            // Codes_SRS_IOTHUBCLIENT_LL_41_080: [ `IoTHubClient_LL_MessageCallbackFromInput` shall find the handler of the inputName in an index keyed by the hash of the input name, comparing the names only when hash and length match. ]
+            size_t inputNameLength;
+            uint32_t inputNameHash = hash_name(inputName, &inputNameLength);
+            event_callback = find_event_callback(handleData, inputName, inputNameLength, inputNameHash);
+        }
 
-                        IOTHUB_DEVICE_CONFIG deviceConfig;
-                        deviceConfig.deviceId = config->deviceId;
-                        deviceConfig.deviceKey = config->deviceKey;
-                        deviceConfig.deviceSasToken = config->deviceSasToken;
-                        deviceConfig.authorization_module = result->authorization_module;
-                        deviceConfig.moduleId = module_id;
+        if (event_callback == NULL)
+        {
+            // Codes_SRS_IOTHUBCLIENT_LL_31_138: [ If there is no registered handler for the inputName from `IoTHubMessage_GetInputName`, then `IoTHubClient_LL_MessageCallbackFromInput` shall attempt invoke the default handler handler.** ]
+            event_callback = handleData->defaultEventCallback;
+        }
 
-                        /*Codes_SRS_IOTHUBCLIENT_LL_17_008: [IoTHubClientCore_LL_Create shall call the transport _Register function with a populated structure of type IOTHUB_DEVICE_CONFIG and waitingToSend list.] */
-                        if ((result->deviceHandle = result->IoTHubTransport_Register(result->transportHandle, &deviceConfig, &(result->waitingToSend))) == NULL)
-                        {
-                            LogError("Registering device in transport failed");
-                            IoTHubClient_Auth_Destroy(result->authorization_module);
-                            // Codes_SRS_IOTHUBCLIENT_LL_09_010: [ If any failure occurs `IoTHubClientCore_LL_Create` shall destroy the `transportHandle` only if it has created it ]
-                            if (!result->isSharedTransport)
-                            {
-                                result->IoTHubTransport_Destroy(result->transportHandle);
-                            }
-                            destroy_blob_upload_module(result);
-                            destroy_module_method_module(result);
-                            tickcounter_destroy(result->tickCounter);
-                            STRING_delete(product_info);
-                            free(result);
-                            result = NULL;
-                        }
-                        else
-                        {
-                            /*Codes_SRS_IOTHUBCLIENT_LL_02_042: [ By default, messages shall not timeout. ]*/
-                            result->currentMessageTimeout = 0;
-                            result->current_device_twin_timeout = 0;
+        if (event_callback == NULL)
+        {
+            LogError("Could not find callback (explicit or default) for input queue %s", inputName);
+            result = false;
+        }
+        else
+        {
+            // Codes_SRS_IOTHUBCLIENT_LL_09_004: [IoTHubClient_LL_GetLastMessageReceiveTime shall return lastMessageReceiveTime in localtime]
+            handleData->lastMessageReceiveTime = get_time(NULL);
 
-                            result->diagnostic_setting.currentMessageNumber = 0;
-                            result->diagnostic_setting.diagSamplingPercentage = 0;
-                            /*Codes_SRS_IOTHUBCLIENT_LL_25_124: [ `IoTHubClientCore_LL_Create` shall set the default retry policy as Exponential backoff with jitter and if succeed and return a `non-NULL` handle. ]*/
-                            if (IoTHubClientCore_LL_SetRetryPolicy(result, IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_JITTER, 0) != IOTHUB_CLIENT_OK)
-                            {
-                                LogError("Setting default retry policy in transport failed");
-                                result->IoTHubTransport_Unregister(result->deviceHandle);
-                                IoTHubClient_Auth_Destroy(result->authorization_module);
-                                // Codes_SRS_IOTHUBCLIENT_LL_09_010: [ If any failure occurs `IoTHubClientCore_LL_Create` shall destroy the `transportHandle` only if it has created it ]
-                                if (!result->isSharedTransport)
-                                {
-                                    result->IoTHubTransport_Destroy(result->transportHandle);
-                                }
-                                destroy_blob_upload_module(result);
-                                destroy_module_method_module(result);
-                                tickcounter_destroy(result->tickCounter);
-                                STRING_delete(product_info);
-                                free(result);
-                                result = NULL;
-                            }
-                        }
-                    }
-                }
+            if (handleData->statisticsEnabled)
+            {
+                handleData->statistics.messages_received++;
             }
-            if (IoTHubName)
+
+            if (event_callback->callbackAsyncEx != NULL)
             {
-                free(IoTHubName);
+                // Codes_SRS_IOTHUBCLIENT_LL_31_139: [ `IoTHubClient_LL_MessageCallbackFromInput` shall the callback from the given inputName queue if it has been registered.** ]
+                result = event_callback->callbackAsyncEx(messageData, event_callback->userContextCallbackEx);
+                if (result && handleData->statisticsEnabled)
+                {
+                    handleData->statistics.messages_awaiting_disposition++;
+                }
             }
-            if (IoTHubSuffix)
+            else
             {
-                free(IoTHubSuffix);
+                // Codes_SRS_IOTHUBCLIENT_LL_31_139: [ `IoTHubClient_LL_MessageCallbackFromInput` shall the callback from the given inputName queue if it has been registered.** ]
+                IOTHUBMESSAGE_DISPOSITION_RESULT cb_result = event_callback->callbackAsync(messageData->messageHandle, event_callback->userContextCallback);
+
+                // Codes_SRS_IOTHUBCLIENT_LL_31_140: [ `IoTHubClient_LL_MessageCallbackFromInput` shall send the message disposition as returned by the client to the underlying layer and return `true` if an input queue match is found.** ]
+                if (handleData->IoTHubTransport_SendMessageDisposition(messageData, cb_result) != IOTHUB_CLIENT_OK)
+                {
+                    LogError("IoTHubTransport_SendMessageDisposition failed");
+                }
+                result = true;
             }
         }
     }
     return result;
 }
 
-static uint32_t get_next_item_id(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData)
+static bool IoTHubClientCore_LL_MessageCallback(MESSAGE_CALLBACK_INFO* messageData, void* ctx)
 {
-    if (handleData->data_msg_id+1 >= UINT32_MAX)
+    bool result;
+    if ((ctx == NULL) || messageData == NULL)
     {
-        handleData->data_msg_id = 1;
+        /*Codes_SRS_IOTHUBCLIENT_LL_02_029: [If parameter handle is NULL then IoTHubClient_LL_MessageCallback shall return IOTHUBMESSAGE_ABANDONED.] */
+        LogError("invalid argument: ctx(%p), messageData(%p)", ctx, messageData);
+        result = false;
+    }
+    else if (messageData->messageHandle == NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_004: [If messageHandle field of paramger messageData is NULL then IoTHubClient_LL_MessageCallback shall return IOTHUBMESSAGE_ABANDONED.] */
+        LogError("invalid argument messageData->messageHandle(NULL)");
+        result = false;
     }
     else
     {
-        handleData->data_msg_id++;
+        IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)ctx;
+        return invoke_message_callback(handleData, messageData);
     }
-    return handleData->data_msg_id;
+    return result;
 }
 
-static IOTHUB_DEVICE_TWIN* dev_twin_data_create(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, uint32_t id, const unsigned char* reportedState, size_t size, IOTHUB_CLIENT_REPORTED_STATE_CALLBACK reportedStateCallback, void* userContextCallback)
+static bool IoTHubClientCore_LL_MessageChunkCallback(const unsigned char* chunk, size_t size, size_t offset, size_t total_size, void* ctx)
 {
-    IOTHUB_DEVICE_TWIN* result = (IOTHUB_DEVICE_TWIN*)malloc(sizeof(IOTHUB_DEVICE_TWIN) );
-    if (result != NULL)
+    bool result;
+    IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)ctx;
+
+    if (handleData == NULL || handleData->messageCallback.type != CALLBACK_TYPE_CHUNK)
     {
-        result->report_data_handle = CONSTBUFFER_Create(reportedState, size);
-        if (result->report_data_handle == NULL)
-        {
-            LogError("Failure allocating reported state data");
-            free(result);
-            result = NULL;
-        }
-        else
-        {
-            result->item_id = id;
-            result->ms_timesOutAfter = 0;
-            result->context = userContextCallback;
-            result->reported_state_callback = reportedStateCallback;
-            result->client_handle = handleData;
-            result->device_handle = handleData->deviceHandle;
-        }
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_041: [ When the transport hands over a slice of a message payload, IoTHubClient_LL_MessageChunkCallback shall pass it to messageChunkCallback and return true, or return false if no chunk callback is set so the transport delivers the whole message instead. ]*/
+        result = false;
     }
     else
     {
-        LogError("Failure allocating device twin information");
+        if (offset == 0)
+        {
+            handleData->lastMessageReceiveTime = get_time(NULL);
+        }
+        /*the transport does not dispose of streamed messages, so the disposition is not used*/
+        (void)handleData->messageCallback.callbackChunk(chunk, size, offset, total_size, handleData->messageCallback.userContextCallback);
+        result = true;
     }
+
     return result;
 }
 
-static void on_get_device_twin_completed(DEVICE_TWIN_UPDATE_STATE update_state, const unsigned char* payLoad, size_t size, void* userContextCallback)
+/*makes room for one more method in flight, returns 0 on success, any other value is error*/
+static int reserve_method_in_flight(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData)
 {
-    if (userContextCallback == NULL)
+    int result;
+
+    if (handleData->methodsInFlightCount == handleData->methodsInFlightCapacity)
     {
-        LogError("Invalid argument (userContextCallback=NULL)");
+        size_t new_capacity = (handleData->methodsInFlightCapacity == 0) ? METHOD_IN_FLIGHT_INITIAL_CAPACITY : handleData->methodsInFlightCapacity * 2;
+        METHOD_IN_FLIGHT* new_methods;
+
+        if ((new_capacity < handleData->methodsInFlightCapacity) || (new_capacity > SIZE_MAX / sizeof(METHOD_IN_FLIGHT)))
+        {
+            LogError("methods in flight cannot grow past %lu entries", (unsigned long)handleData->methodsInFlightCapacity);
+            new_methods = NULL;
+        }
+        else if ((new_methods = (METHOD_IN_FLIGHT*)realloc(handleData->methodsInFlight, new_capacity * sizeof(METHOD_IN_FLIGHT))) == NULL)
+        {
+            LogError("failure growing the methods in flight");
+        }
+        else
+        {
+            handleData->methodsInFlight = new_methods;
+            handleData->methodsInFlightCapacity = new_capacity;
+        }
+
+        result = (new_methods == NULL) ? __FAILURE__ : 0;
     }
     else
     {
-        GET_TWIN_CONTEXT* getTwinCtx = (GET_TWIN_CONTEXT*)userContextCallback;
+        result = 0;
+    }
 
-        getTwinCtx->callback(update_state, payLoad, size, getTwinCtx->context);
+    return result;
+}
 
-        free(getTwinCtx);
+static void remove_method_in_flight(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, size_t index)
+{
+    handleData->methodsInFlightCount--;
+    (void)memmove(&handleData->methodsInFlight[index], &handleData->methodsInFlight[index + 1], (handleData->methodsInFlightCount - index) * sizeof(METHOD_IN_FLIGHT));
+}
+
+/*returns false if method_id is not in flight*/
+static bool take_method_in_flight(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, METHOD_HANDLE method_id)
+{
+    bool result = false;
+    size_t index;
+
+    for (index = 0; index < handleData->methodsInFlightCount; index++)
+    {
+        if (handleData->methodsInFlight[index].method_id == method_id)
+        {
+            remove_method_in_flight(handleData, index);
+            result = true;
+            break;
+        }
     }
+
+    return result;
 }
 
-static void delete_event(IOTHUB_EVENT_CALLBACK* event_callback)
+/*the quotas of a hub, in operations per second: the greater of minimum and per_unit times the units of the hub*/
+typedef struct HUB_TIER_QUOTA_TAG
 {
-    STRING_delete(event_callback->inputName);
-    free(event_callback->userContextCallbackEx);
-    free(event_callback);
+    double telemetry_minimum;
+    double telemetry_per_unit;
+    double twin_minimum;
+    double twin_per_unit;
+    double method_minimum; /*the throughput of direct methods, counted in 4 KB responses*/
+    double method_per_unit;
+}HUB_TIER_QUOTA;
+
+/*indexed by IOTHUB_HUB_TIER*/
+static const HUB_TIER_QUOTA HUB_TIER_QUOTAS[] =
+{
+    { 0, 0, 0, 0, 0, 0 },               /*IOTHUB_HUB_TIER_NONE*/
+    { 100, 0, 10, 0, 40, 0 },           /*IOTHUB_HUB_TIER_F1*/
+    { 100, 12, 10, 1, 0, 40 },          /*IOTHUB_HUB_TIER_S1*/
+    { 120, 120, 0, 50, 0, 120 },        /*IOTHUB_HUB_TIER_S2*/
+    { 0, 6000, 0, 300, 0, 6000 }        /*IOTHUB_HUB_TIER_S3*/
+};
+
+static double get_tier_share(double minimum, double per_unit, size_t units, size_t devices)
+{
+    double hubRate = per_unit * (double)units;
+    return ((hubRate < minimum) ? minimum : hubRate) / (double)devices;
 }
 
-static void delete_event_callback(const void* item, const void* action_context, bool* continue_processing)
+static void configure_rate_limit(RATE_LIMIT_BUCKET* bucket, const IOTHUB_CLIENT_RATE_LIMIT* limit, double tierShare)
 {
-    (void)action_context;
-    delete_event((IOTHUB_EVENT_CALLBACK*)item);
-    *continue_processing = true;
+    double perSecond = (limit->per_second != 0) ? limit->per_second : tierShare;
+
+    if (perSecond == 0)
+    {
+        bucket->refill_per_ms = 0;
+        bucket->capacity = 0;
+    }
+    else
+    {
+        /*a token per second is RATE_LIMIT_TOKEN / 1000 per ms*/
+        uint64_t refill = (uint64_t)(perSecond * (RATE_LIMIT_TOKEN / 1000));
+        uint64_t burst = (limit->burst != 0) ? (uint64_t)limit->burst : (uint64_t)perSecond;
+
+        bucket->refill_per_ms = (refill == 0) ? 1 : refill;
+        if (burst == 0)
+        {
+            burst = 1;
+        }
+        bucket->capacity = (burst > UINT64_MAX / RATE_LIMIT_TOKEN) ? (UINT64_MAX / RATE_LIMIT_TOKEN) * RATE_LIMIT_TOKEN : burst * RATE_LIMIT_TOKEN;
+    }
+    bucket->level = bucket->capacity;
 }
 
-static void delete_event_callback_list(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData)
+static bool is_rate_limited(const IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData)
 {
-    if (handleData->event_callbacks != NULL)
+    return (handleData->eventRateLimit.refill_per_ms != 0) || (handleData->twinRateLimit.refill_per_ms != 0) || (handleData->methodRateLimit.refill_per_ms != 0);
+}
+
+static void refill_rate_limit(RATE_LIMIT_BUCKET* bucket, tickcounter_ms_t elapsed)
+{
+    if ((bucket->refill_per_ms != 0) && (bucket->level < bucket->capacity))
     {
-        singlylinkedlist_foreach(handleData->event_callbacks, delete_event_callback, NULL);
-        singlylinkedlist_destroy(handleData->event_callbacks);
-        handleData->event_callbacks = NULL;
+        uint64_t room = bucket->capacity - bucket->level;
+        /*compared before multiplying, so that a long pause cannot overflow*/
+        if (elapsed >= room / bucket->refill_per_ms)
+        {
+            bucket->level = bucket->capacity;
+        }
+        else
+        {
+            bucket->level += elapsed * bucket->refill_per_ms;
+        }
     }
 }
 
+static void refill_rate_limits(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData)
+{
+    tickcounter_ms_t nowTick;
 
-IOTHUB_CLIENT_CORE_LL_HANDLE IoTHubClientCore_LL_CreateFromDeviceAuth(const char* iothub_uri, const char* device_id, IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol)
+    if (tickcounter_get_current_ms(handleData->tickCounter, &nowTick) != 0)
+    {
+        LogError("unable to get the current ms, the rate limits are not refilled");
+    }
+    else
+    {
+        tickcounter_ms_t elapsed = nowTick - handleData->rateLimitsRefilledAt;
+        refill_rate_limit(&handleData->eventRateLimit, elapsed);
+        refill_rate_limit(&handleData->twinRateLimit, elapsed);
+        refill_rate_limit(&handleData->methodRateLimit, elapsed);
+        handleData->rateLimitsRefilledAt = nowTick;
+    }
+}
+
+static bool has_rate_limit_token(const RATE_LIMIT_BUCKET* bucket)
 {
-    IOTHUB_CLIENT_CORE_LL_HANDLE result;
-    if (iothub_uri == NULL || protocol == NULL || device_id == NULL)
+    return (bucket->refill_per_ms == 0) || (bucket->level >= RATE_LIMIT_TOKEN);
+}
+
+/*only called once has_rate_limit_token said there is one*/
+static void take_rate_limit_token(RATE_LIMIT_BUCKET* bucket)
+{
+    if (bucket->refill_per_ms != 0)
     {
-        LogError("Input parameter is NULL: iothub_uri: %p  protocol: %p device_id: %p", iothub_uri, protocol, device_id);
-        result = NULL;
+        bucket->level -= RATE_LIMIT_TOKEN;
+    }
+}
+
+static int respond_to_method(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, METHOD_HANDLE method_id, const unsigned char* response, size_t response_size, int status_response)
+{
+    int result;
+
+    if (handleData->methodRateLimit.refill_per_ms == 0)
+    {
+        result = handleData->IoTHubTransport_DeviceMethod_Response(handleData->deviceHandle, method_id, response, response_size, status_response);
     }
     else
     {
-#ifdef USE_PROV_MODULE
-        IOTHUB_CLIENT_CONFIG* config = (IOTHUB_CLIENT_CONFIG*)malloc(sizeof(IOTHUB_CLIENT_CONFIG));
-        if (config == NULL)
+        refill_rate_limits(handleData);
+        if (DList_IsListEmpty(&(handleData->pendingMethodResponses)) && has_rate_limit_token(&handleData->methodRateLimit))
         {
-            /* Codes_SRS_IOTHUBCLIENT_LL_12_012: [If the allocation failed IoTHubClientCore_LL_CreateFromConnectionString  returns NULL]  */
-            LogError("Malloc failed");
-            result = NULL;
+            take_rate_limit_token(&handleData->methodRateLimit);
+            result = handleData->IoTHubTransport_DeviceMethod_Response(handleData->deviceHandle, method_id, response, response_size, status_response);
         }
         else
         {
-            const char* iterator;
-            const char* initial;
-            char* iothub_name = NULL;
-            char* iothub_suffix = NULL;
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_169: [ A method response beyond the method_responses rate of `rate_limits` shall be copied and sent by the first IoTHubClientCore_LL_DoWork whose bucket holds a token, after the ones kept before it; if it cannot be copied the response shall fail. ]*/
+            PENDING_METHOD_RESPONSE* pending;
+            if ((pending = (PENDING_METHOD_RESPONSE*)malloc(sizeof(PENDING_METHOD_RESPONSE) + response_size)) == NULL)
+            {
+                LogError("Failed allocating the rate limited response of method request %p", method_id);
+                result = __FAILURE__;
+            }
+            else
+            {
+                pending->method_id = method_id;
+                pending->response = (const unsigned char*)(pending + 1);
+                pending->response_size = response_size;
+                pending->status_response = status_response;
+                if (response_size > 0)
+                {
+                    (void)memcpy(pending + 1, response, response_size);
+                }
+                DList_InsertTailList(&(handleData->pendingMethodResponses), &(pending->entry));
+                result = 0;
+            }
+        }
+    }
 
-            memset(config, 0, sizeof(IOTHUB_CLIENT_CONFIG));
-            config->protocol = protocol;
-            config->deviceId = device_id;
+    return result;
+}
 
-            // Find the iothub suffix
-            initial = iterator = iothub_uri;
-            while (iterator != NULL && *iterator != '\0')
+static void send_pending_method_responses(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData)
+{
+    while (!DList_IsListEmpty(&(handleData->pendingMethodResponses)) && has_rate_limit_token(&handleData->methodRateLimit))
+    {
+        PENDING_METHOD_RESPONSE* pending = containingRecord(DList_RemoveHeadList(&(handleData->pendingMethodResponses)), PENDING_METHOD_RESPONSE, entry);
+        take_rate_limit_token(&handleData->methodRateLimit);
+        if (handleData->IoTHubTransport_DeviceMethod_Response(handleData->deviceHandle, pending->method_id, pending->response, pending->response_size, pending->status_response) != 0)
+        {
+            LogError("IoTHubTransport_DeviceMethod_Response failed for a rate limited method response");
+        }
+        free(pending);
+    }
+}
+
+static void DoMethodTimeouts(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData)
+{
+    tickcounter_ms_t nowTick;
+
+    if (tickcounter_get_current_ms(handleData->tickCounter, &nowTick) != 0)
+    {
+        LogError("unable to get the current ms, method timeouts will not be processed");
+    }
+    else
+    {
+        /*requests are kept in arrival order, so the first one that has not expired ends the pass*/
+        while ((handleData->methodsInFlightCount > 0) && ((nowTick - handleData->methodsInFlight[0].ms_received) > handleData->methodResponseTimeout))
+        {
+            METHOD_HANDLE method_id = handleData->methodsInFlight[0].method_id;
+            remove_method_in_flight(handleData, 0);
+
+            if (handleData->statisticsEnabled && handleData->statistics.methods_awaiting_response > 0)
             {
-                if (*iterator == '.')
+                handleData->statistics.methods_awaiting_response--;
+            }
+
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_089: [ IoTHubClientCore_LL_DoWork shall answer with status 504 every method request taken more than OPTION_METHOD_RESPONSE_TIMEOUT_SECS ago and not answered yet, and forget its method id. ]*/
+            LogError("method request not answered in %lu ms, responding 504", (unsigned long)handleData->methodResponseTimeout);
+            if (handleData->IoTHubTransport_DeviceMethod_Response(handleData->deviceHandle, method_id, (const unsigned char*)METHOD_TIMEOUT_RESPONSE, sizeof(METHOD_TIMEOUT_RESPONSE) - 1, METHOD_TIMEOUT_STATUS) != 0)
+            {
+                LogError("IoTHubTransport_DeviceMethod_Response failed for a timed out method");
+            }
+        }
+    }
+}
+
+static int IoTHubClientCore_LL_DeviceMethodComplete(const char* method_name, const unsigned char* payLoad, size_t size, METHOD_HANDLE response_id, void* ctx)
+{
+    int result;
+    if (ctx == NULL)
+    {
+        /* Codes_SRS_IOTHUBCLIENT_LL_07_017: [ If handle or response is NULL then IoTHubClientCore_LL_DeviceMethodComplete shall return 500. ] */
+        LogError("Invalid argument ctx=%p", ctx);
+        result = __FAILURE__;
+    }
+    else
+    {
+        /* Codes_SRS_IOTHUBCLIENT_LL_07_018: [ If deviceMethodCallback is not NULL IoTHubClientCore_LL_DeviceMethodComplete shall execute deviceMethodCallback and return the status. ] */
+        IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)ctx;
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_084: [ If a handler was registered for method_name, IoTHubClientCore_LL_DeviceMethodComplete shall call it, found through a table keyed by the hash of the method name, instead of the device method callback. ]*/
+        const IOTHUB_METHOD_CALLBACK_DATA* method_callback = get_method_callback(handleData, method_name);
+        switch (method_callback->type)
+        {
+            case CALLBACK_TYPE_SYNC:
+            {
+                unsigned char* payload_resp = NULL;
+                size_t response_size = 0;
+                tickcounter_ms_t ms_received = 0;
+                bool traced = IoTHubClient_Tracing_IsEnabled(&handleData->tracer);
+                bool received_stamped = (handleData->statisticsEnabled || traced) && get_statistics_time(handleData, &ms_received);
+                result = method_callback->callbackSync(method_name, payLoad, size, &payload_resp, &response_size, method_callback->userContextCallback);
+                /* Codes_SRS_IOTHUBCLIENT_LL_07_020: [ deviceMethodCallback shall build the BUFFER_HANDLE with the response payload from the IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC callback. ] */
+                if (payload_resp != NULL && response_size > 0)
                 {
-                    size_t length = iterator - initial;
-                    iothub_name = (char*)malloc(length + 1);
-                    if (iothub_name != NULL)
+                    result = respond_to_method(handleData, response_id, payload_resp, response_size, result);
+                }
+                else
+                {
+                    result = __FAILURE__;
+                }
+                if (payload_resp != NULL)
+                {
+                    free(payload_resp);
+                }
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_021: [ While statistics are enabled, the time from receiving a method request to sending the response of a synchronous method callback shall be recorded in method_turnaround. ]*/
+                tickcounter_ms_t now;
+                if (received_stamped && get_statistics_time(handleData, &now))
+                {
+                    if (handleData->statisticsEnabled)
                     {
-                        memset(iothub_name, 0, length + 1);
-                        memcpy(iothub_name, initial, length);
-                        config->iotHubName = iothub_name;
-
-                        length = strlen(initial) - length - 1;
-                        iothub_suffix = (char*)malloc(length + 1);
-                        if (iothub_suffix != NULL)
-                        {
-                            memset(iothub_suffix, 0, length + 1);
-                            memcpy(iothub_suffix, iterator + 1, length);
-                            config->iotHubSuffix = iothub_suffix;
-                            break;
-                        }
-                        else
-                        {
-                            LogError("Failed to allocate iothub suffix");
-                            free(iothub_name);
-                            iothub_name = NULL;
-                            result = NULL;
-                        }
+                        record_latency(&handleData->statistics.method_turnaround, now - ms_received);
                     }
-                    else
+                    /*Codes_SRS_IOTHUBCLIENT_LL_41_076: [ While a trace exporter is set, a synchronous method callback shall be traced by a METHOD_DISPATCH span named after the method, from the request to the response, which succeeds if the response was sent. ]*/
+                    if (traced)
                     {
-                        LogError("Failed to allocate iothub name");
-                        result = NULL;
+                        IOTHUB_CLIENT_TRACE_CONTEXT trace;
+                        IoTHubClient_Tracing_Start(&handleData->tracer, &trace, NULL, ms_received);
+                        IoTHubClient_Tracing_ExportSpan(&handleData->tracer, IOTHUB_CLIENT_SPAN_METHOD_DISPATCH, &trace, false, ms_received, now, (result == 0), method_name);
                     }
                 }
-                iterator++;
-            }
-
-            if (config->iotHubName == NULL || config->iotHubSuffix == NULL)
-            {
-                LogError("initialize iothub client");
-                result = NULL;
+                break;
             }
-            else
+            case CALLBACK_TYPE_ASYNC:
             {
-                IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = initialize_iothub_client(config, NULL, true, NULL);
-                if (handleData == NULL)
+                tickcounter_ms_t ms_received = 0;
+
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_087: [ While OPTION_METHOD_MAX_IN_FLIGHT requests taken by an inbound method callback are not answered yet, IoTHubClientCore_LL_DeviceMethodComplete shall answer further ones with status 429 without calling the callback. ]*/
+                if (handleData->methodTracking && (handleData->methodMaxInFlight > 0) && (handleData->methodsInFlightCount >= handleData->methodMaxInFlight))
                 {
-                    LogError("initialize iothub client");
-                    result = NULL;
+                    LogError("%lu method requests already in flight, responding 429", (unsigned long)handleData->methodsInFlightCount);
+                    result = handleData->IoTHubTransport_DeviceMethod_Response(handleData->deviceHandle, response_id, (const unsigned char*)METHOD_BUSY_RESPONSE, sizeof(METHOD_BUSY_RESPONSE) - 1, METHOD_BUSY_STATUS);
+                }
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_088: [ Once OPTION_METHOD_MAX_IN_FLIGHT or OPTION_METHOD_RESPONSE_TIMEOUT_SECS was set, every method request taken by an inbound method callback shall be recorded as in flight until it is answered or times out; if it cannot be recorded IoTHubClientCore_LL_DeviceMethodComplete shall fail without calling the callback. ]*/
+                else if (handleData->methodTracking && ((reserve_method_in_flight(handleData) != 0) || (tickcounter_get_current_ms(handleData->tickCounter, &ms_received) != 0)))
+                {
+                    LogError("unable to record the method request in flight");
+                    result = __FAILURE__;
                 }
                 else
                 {
-                    result = handleData;
+                    result = method_callback->callbackAsync(method_name, payLoad, size, response_id, method_callback->userContextCallback);
+                    if (result == 0 && handleData->methodTracking)
+                    {
+                        handleData->methodsInFlight[handleData->methodsInFlightCount].method_id = response_id;
+                        handleData->methodsInFlight[handleData->methodsInFlightCount].ms_received = ms_received;
+                        handleData->methodsInFlightCount++;
+                    }
+                    /*Codes_SRS_IOTHUBCLIENT_LL_41_046: [ While statistics are enabled, every method request taken by an inbound method callback shall be counted in methods_awaiting_response until IoTHubClientCore_LL_DeviceMethodResponse is called for it. ]*/
+                    if (result == 0 && handleData->statisticsEnabled)
+                    {
+                        handleData->statistics.methods_awaiting_response++;
+                    }
                 }
+                break;
             }
-
-            free(iothub_name);
-            free(iothub_suffix);
-            free(config);
+            default:
+                /* Codes_SRS_IOTHUBCLIENT_LL_07_019: [ If deviceMethodCallback is NULL IoTHubClientCore_LL_DeviceMethodComplete shall return 404. ] */
+                result = 0;
+                break;
         }
-#else
-        LogError("HSM module is not included");
-        result = NULL;
-#endif
     }
     return result;
 }
 
-IOTHUB_CLIENT_CORE_LL_HANDLE IoTHubClientCore_LL_CreateFromConnectionString(const char* connectionString, IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol)
+// What IoTHubClientCore_LL_CreateBatchWithTransport works out once for all the clients it creates
+typedef struct CLIENT_CREATE_SHARED_DATA_TAG
 {
-    IOTHUB_CLIENT_CORE_LL_HANDLE result;
+    STRING_HANDLE product_info;
+    const char* iothub_name;
+    const char* iothub_suffix;
+} CLIENT_CREATE_SHARED_DATA;
 
-    /* Codes_SRS_IOTHUBCLIENT_LL_12_003: [IoTHubClientCore_LL_CreateFromConnectionString shall verify the input parameter and if it is NULL then return NULL] */
-    if (connectionString == NULL)
+static void set_shared_transport_config(IOTHUB_CLIENT_CONFIG* actual_config, const IOTHUB_CLIENT_DEVICE_CONFIG* device_config, const char* iothub_name, const char* iothub_suffix)
+{
+    actual_config->deviceId = device_config->deviceId;
+    actual_config->deviceKey = device_config->deviceKey;
+    actual_config->deviceSasToken = device_config->deviceSasToken;
+    actual_config->iotHubName = iothub_name;
+    actual_config->iotHubSuffix = iothub_suffix;
+    actual_config->protocol = NULL; /*irrelevant to IoTHubClientCore_LL_UploadToBlob*/
+    actual_config->protocolGatewayHostName = NULL; /*irrelevant to IoTHubClientCore_LL_UploadToBlob*/
+}
+
+static IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* initialize_iothub_client(const IOTHUB_CLIENT_CONFIG* client_config, const IOTHUB_CLIENT_DEVICE_CONFIG* device_config, bool use_dev_auth, const char* module_id, const CLIENT_CREATE_SHARED_DATA* shared_data)
+{
+    IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* result;
+    STRING_HANDLE product_info;
+
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_130: [ While the startup timeline is started, `IoTHubClientCore_LL_Create` shall mark IOTHUB_CLIENT_STARTUP_CLIENT_CREATE_STARTED when it starts and IOTHUB_CLIENT_STARTUP_CLIENT_CREATED when it succeeds. ]*/
+    IOTHUB_CLIENT_STARTUP_MARK(IOTHUB_CLIENT_STARTUP_CLIENT_CREATE_STARTED);
+
+    if (shared_data == NULL)
     {
-        LogError("Input parameter is NULL: connectionString");
-        result = NULL;
+        srand((unsigned int)time(NULL));
+        product_info = make_product_info(NULL);
     }
-    else if (protocol == NULL)
+    else
     {
-        LogError("Input parameter is NULL: protocol");
+        product_info = STRING_clone(shared_data->product_info);
+    }
+    if (product_info == NULL)
+    {
+        LogError("failed to initialize product info");
         result = NULL;
     }
     else
     {
-        /* Codes_SRS_IOTHUBCLIENT_LL_12_004: [IoTHubClientCore_LL_CreateFromConnectionString shall allocate IOTHUB_CLIENT_CONFIG structure] */
-        IOTHUB_CLIENT_CONFIG* config = (IOTHUB_CLIENT_CONFIG*) malloc(sizeof(IOTHUB_CLIENT_CONFIG));
-        if (config == NULL)
+        result = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)malloc(sizeof(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA));
+        if (result == NULL)
         {
-            /* Codes_SRS_IOTHUBCLIENT_LL_12_012: [If the allocation failed IoTHubClientCore_LL_CreateFromConnectionString  returns NULL]  */
-            LogError("Malloc failed");
-            result = NULL;
+            LogError("failure allocating IOTHUB_CLIENT_CORE_LL_HANDLE_DATA");
+            STRING_delete(product_info);
         }
         else
         {
-            STRING_TOKENIZER_HANDLE tokenizer1 = NULL;
-            STRING_HANDLE connString = NULL;
-            STRING_HANDLE tokenString = NULL;
-            STRING_HANDLE valueString = NULL;
-            STRING_HANDLE hostNameString = NULL;
-            STRING_HANDLE hostSuffixString = NULL;
-            STRING_HANDLE deviceIdString = NULL;
-            STRING_HANDLE deviceKeyString = NULL;
-            STRING_HANDLE deviceSasTokenString = NULL;
-            STRING_HANDLE protocolGateway = NULL;
-            STRING_HANDLE moduleId = NULL;
-
-            memset(config, 0, sizeof(*config));
-            config->protocol = protocol;
-
-            /* Codes_SRS_IOTHUBCLIENT_LL_04_002: [If it does not, it shall pass the protocolGatewayHostName NULL.] */
-            config->protocolGatewayHostName = NULL;
+            IOTHUB_CLIENT_CONFIG actual_config;
+            const IOTHUB_CLIENT_CONFIG* config = NULL;
+            char* IoTHubName = NULL;
+            char* IoTHubSuffix = NULL;
 
-            if ((connString = STRING_construct(connectionString)) == NULL)
-            {
-                LogError("Error constructing connectiong String");
-                result = NULL;
-            }
-            else if ((tokenizer1 = STRING_TOKENIZER_create(connString)) == NULL)
-            {
-                LogError("Error creating Tokenizer");
-                result = NULL;
-            }
-            else if ((tokenString = STRING_new()) == NULL)
-            {
-                LogError("Error creating Token String");
-                result = NULL;
-            }
-            else if ((valueString = STRING_new()) == NULL)
-            {
-                LogError("Error creating Value String");
-                result = NULL;
-            }
-            else if ((hostNameString = STRING_new()) == NULL)
+            memset(result, 0, sizeof(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA));
+            if (use_dev_auth)
             {
-                LogError("Error creating HostName String");
-                result = NULL;
+                if ((result->authorization_module = IoTHubClient_Auth_CreateFromDeviceAuth(client_config->deviceId, module_id)) == NULL)
+                {
+                    LogError("Failed create authorization module");
+                    free(result);
+                    STRING_delete(product_info);
+                    result = NULL;
+                }
             }
-            else if ((hostSuffixString = STRING_new()) == NULL)
+            else
             {
-                LogError("Error creating HostSuffix String");
-                result = NULL;
+                const char* device_key;
+                const char* device_id;
+                const char* sas_token;
+                if (device_config == NULL)
+                {
+                    device_key = client_config->deviceKey;
+                    device_id = client_config->deviceId;
+                    sas_token = client_config->deviceSasToken;
+                }
+                else
+                {
+                    device_key = device_config->deviceKey;
+                    device_id = device_config->deviceId;
+                    sas_token = device_config->deviceSasToken;
+                }
+
+                /* Codes_SRS_IOTHUBCLIENT_LL_07_029: [ IoTHubClientCore_LL_Create shall create the Auth module with the device_key, device_id, and/or deviceSasToken values ] */
+                if ((result->authorization_module = IoTHubClient_Auth_Create(device_key, device_id, sas_token, module_id)) == NULL)
+                {
+                    LogError("Failed create authorization module");
+                    free(result);
+                    STRING_delete(product_info);
+                    result = NULL;
+                }
             }
-            /* Codes_SRS_IOTHUBCLIENT_LL_12_005: [IoTHubClientCore_LL_CreateFromConnectionString shall try to parse the connectionString input parameter for the following structure: "Key1=value1;key2=value2;key3=value3..."] */
-            /* Codes_SRS_IOTHUBCLIENT_LL_12_006: [IoTHubClientCore_LL_CreateFromConnectionString shall verify the existence of the following Key/Value pairs in the connection string: HostName, DeviceId, SharedAccessKey, SharedAccessSignature or x509]  */
-            else
+
+            if (result != NULL)
             {
-                int isx509found = 0;
-                bool use_provisioning = false;
-                while ((STRING_TOKENIZER_get_next_token(tokenizer1, tokenString, "=") == 0))
+                TRANSPORT_CALLBACKS_INFO transport_cb;
+                memset(&transport_cb, 0, sizeof(TRANSPORT_CALLBACKS_INFO));
+                transport_cb.send_complete_cb = IoTHubClientCore_LL_SendComplete;
+                transport_cb.twin_retrieve_prop_complete_cb = IoTHubClientCore_LL_RetrievePropertyComplete;
+                transport_cb.twin_rpt_state_complete_cb = IoTHubClientCore_LL_ReportedStateComplete;
+                transport_cb.connection_status_cb = IoTHubClientCore_LL_ConnectionStatusCallBack;
+                transport_cb.prod_info_cb = IoTHubClientCore_LL_GetProductInfo;
+                transport_cb.msg_input_cb = IoTHubClientCore_LL_MessageCallbackFromInput;
+                transport_cb.msg_cb = IoTHubClientCore_LL_MessageCallback;
+                transport_cb.msg_chunk_cb = IoTHubClientCore_LL_MessageChunkCallback;
+                transport_cb.method_complete_cb = IoTHubClientCore_LL_DeviceMethodComplete;
+                transport_cb.statistics_cb = IoTHubClientCore_LL_StatisticsCallback;
+
+                if (client_config != NULL)
                 {
-                    if (STRING_TOKENIZER_get_next_token(tokenizer1, valueString, ";") != 0)
+                    IOTHUBTRANSPORT_CONFIG lowerLayerConfig;
+                    memset(&lowerLayerConfig, 0, sizeof(IOTHUBTRANSPORT_CONFIG));
+                    /*Codes_SRS_IOTHUBCLIENT_LL_02_006: [IoTHubClientCore_LL_Create shall populate a structure of type IOTHUBTRANSPORT_CONFIG with the information from config parameter and the previous DLIST and shall pass that to the underlying layer _Create function.]*/
+                    lowerLayerConfig.upperConfig = client_config;
+                    lowerLayerConfig.waitingToSend = &(result->waitingToSend);
+                    lowerLayerConfig.auth_module_handle = result->authorization_module;
+                    lowerLayerConfig.moduleId = module_id;
+
+                    setTransportProtocol(result, (TRANSPORT_PROVIDER*)client_config->protocol());
+                    if ((result->transportHandle = result->IoTHubTransport_Create(&lowerLayerConfig, &transport_cb, result)) == NULL)
                     {
-                        LogError("Tokenizer error");
-                        break;
+                        /*Codes_SRS_IOTHUBCLIENT_LL_02_007: [If the underlaying layer _Create function fails them IoTHubClientCore_LL_Create shall fail and return NULL.] */
+                        LogError("underlying transport failed");
+                        destroy_blob_upload_module(result);
+                        destroy_module_method_module(result);
+                        tickcounter_destroy(result->tickCounter);
+                        IoTHubClient_Auth_Destroy(result->authorization_module);
+                        STRING_delete(product_info);
+                        free(result);
+                        result = NULL;
                     }
                     else
                     {
-                        if (tokenString != NULL)
+                        /*Codes_SRS_IOTHUBCLIENT_LL_02_008: [Otherwise, IoTHubClientCore_LL_Create shall succeed and return a non-NULL handle.] */
+                        result->isSharedTransport = false;
+                        config = client_config;
+                    }
+                }
+                else
+                {
+                    STRING_HANDLE transport_hostname = NULL;
+
+                    result->transportHandle = device_config->transportHandle;
+                    setTransportProtocol(result, (TRANSPORT_PROVIDER*)device_config->protocol());
+
+                    if (result->IoTHubTransport_SetCallbackContext(result->transportHandle, result) != 0)
+                    {
+                        LogError("unable to set transport callbacks");
+                        IoTHubClient_Auth_Destroy(result->authorization_module);
+                        STRING_delete(product_info);
+                        free(result);
+                        result = NULL;
+                    }
+                    else if (shared_data != NULL)
+                    {
+                        /*Codes_SRS_IOTHUBCLIENT_LL_41_124: [ IoTHubClientCore_LL_CreateBatchWithTransport shall create each client as IoTHubClientCore_LL_CreateWithTransport does, with the IoT Hub name and product info worked out once for the batch. ]*/
+                        set_shared_transport_config(&actual_config, device_config, shared_data->iothub_name, shared_data->iothub_suffix);
+                        config = &actual_config;
+                        result->isSharedTransport = true;
+                    }
+                    else if ((transport_hostname = result->IoTHubTransport_GetHostname(result->transportHandle)) == NULL)
+                    {
+                        /*Codes_SRS_IOTHUBCLIENT_LL_02_097: [ If creating the data structures fails or instantiating the IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE fails then IoTHubClientCore_LL_CreateWithTransport shall fail and return NULL. ]*/
+                        LogError("unable to determine the transport IoTHub name");
+                        IoTHubClient_Auth_Destroy(result->authorization_module);
+                        STRING_delete(product_info);
+                        free(result);
+                        result = NULL;
+                    }
+                    else
+                    {
+                        const char* hostname = STRING_c_str(transport_hostname);
+                        /*Codes_SRS_IOTHUBCLIENT_LL_02_096: [ IoTHubClientCore_LL_CreateWithTransport shall create the data structures needed to instantiate a IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE. ]*/
+                        /*the first '.' says where the iothubname finishes*/
+                        const char* whereIsDot = strchr(hostname, '.');
+                        if (whereIsDot == NULL)
                         {
-                            /* Codes_SRS_IOTHUBCLIENT_LL_12_010: [IoTHubClientCore_LL_CreateFromConnectionString shall fill up the IOTHUB_CLIENT_CONFIG structure using the following mapping: iotHubName = Name, iotHubSuffix = Suffix, deviceId = DeviceId, deviceKey = SharedAccessKey or deviceSasToken = SharedAccessSignature] */
-                            const char* s_token = STRING_c_str(tokenString);
-                            if (strcmp(s_token, HOSTNAME_TOKEN) == 0)
+                            /*Codes_SRS_IOTHUBCLIENT_LL_02_097: [ If creating the data structures fails or instantiating the IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE fails then IoTHubClientCore_LL_CreateWithTransport shall fail and return NULL. ]*/
+                            LogError("unable to determine the IoTHub name");
+                            IoTHubClient_Auth_Destroy(result->authorization_module);
+                            STRING_delete(product_info);
+                            free(result);
+                            result = NULL;
+                        }
+                        else
+                        {
+                            size_t suffix_len = strlen(whereIsDot);
+                            /*Codes_SRS_IOTHUBCLIENT_LL_02_096: [ IoTHubClientCore_LL_CreateWithTransport shall create the data structures needed to instantiate a IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE. ]*/
+                            IoTHubName = (char*)malloc(whereIsDot - hostname + 1);
+                            if (IoTHubName == NULL)
                             {
-                                /* Codes_SRS_IOTHUBCLIENT_LL_12_009: [IoTHubClientCore_LL_CreateFromConnectionString shall split the value of HostName to Name and Suffix using the first "." as a separator] */
-                                STRING_TOKENIZER_HANDLE tokenizer2 = NULL;
-                                if ((tokenizer2 = STRING_TOKENIZER_create(valueString)) == NULL)
-                                {
-                                    LogError("Error creating Tokenizer");
-                                    break;
-                                }
-                                else
-                                {
-                                    /* Codes_SRS_IOTHUBCLIENT_LL_12_015: [If the string split failed, IoTHubClientCore_LL_CreateFromConnectionString returns NULL ] */
-                                    if (STRING_TOKENIZER_get_next_token(tokenizer2, hostNameString, ".") != 0)
-                                    {
-                                        LogError("Tokenizer error");
-                                        STRING_TOKENIZER_destroy(tokenizer2);
-                                        break;
-                                    }
-                                    else
-                                    {
-                                        config->iotHubName = STRING_c_str(hostNameString);
-                                        if (STRING_TOKENIZER_get_next_token(tokenizer2, hostSuffixString, ";") != 0)
-                                        {
-                                            LogError("Tokenizer error");
-                                            STRING_TOKENIZER_destroy(tokenizer2);
-                                            break;
-                                        }
-                                        else
-                                        {
-                                            config->iotHubSuffix = STRING_c_str(hostSuffixString);
-                                        }
-                                    }
-                                    STRING_TOKENIZER_destroy(tokenizer2);
-                                }
+                                /*Codes_SRS_IOTHUBCLIENT_LL_02_097: [ If creating the data structures fails or instantiating the IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE fails then IoTHubClientCore_LL_CreateWithTransport shall fail and return NULL. ]*/
+                                LogError("unable to malloc");
+                                IoTHubClient_Auth_Destroy(result->authorization_module);
+                                STRING_delete(product_info);
+                                free(result);
+                                result = NULL;
                             }
-                            else if (strcmp(s_token, DEVICEID_TOKEN) == 0)
+                            else if ((IoTHubSuffix = (char*)malloc(suffix_len + 1)) == NULL)
                             {
-                                deviceIdString = STRING_clone(valueString);
-                                if (deviceIdString != NULL)
-                                {
-                                    config->deviceId = STRING_c_str(deviceIdString);
-                                }
-                                else
-                                {
-                                    LogError("Failure cloning device id string");
-                                    break;
-                                }
+                                /*Codes_SRS_IOTHUBCLIENT_LL_02_097: [ If creating the data structures fails or instantiating the IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE fails then IoTHubClientCore_LL_CreateWithTransport shall fail and return NULL. ]*/
+                                LogError("unable to malloc");
+                                IoTHubClient_Auth_Destroy(result->authorization_module);
+                                STRING_delete(product_info);
+                                free(result);
+                                result = NULL;
                             }
-                            else if (strcmp(s_token, DEVICEKEY_TOKEN) == 0)
+                            else
                             {
-                                deviceKeyString = STRING_clone(valueString);
-                                if (deviceKeyString != NULL)
-                                {
-                                    config->deviceKey = STRING_c_str(deviceKeyString);
-                                }
-                                else
-                                {
-                                    LogError("Failure cloning device key string");
-                                    break;
-                                }
-                            }
-                            else if (strcmp(s_token, DEVICESAS_TOKEN) == 0)
-                            {
-                                deviceSasTokenString = STRING_clone(valueString);
-                                if (deviceSasTokenString != NULL)
-                                {
-                                    config->deviceSasToken = STRING_c_str(deviceSasTokenString);
-                                }
-                                else
-                                {
-                                    LogError("Failure cloning device sasToken string");
-                                    break;
-                                }
-                            }
-                            else if (strcmp(s_token, X509_TOKEN) == 0)
-                            {
-                                if (strcmp(STRING_c_str(valueString), X509_TOKEN_ONLY_ACCEPTABLE_VALUE) != 0)
-                                {
-                                    LogError("x509 option has wrong value, the only acceptable one is \"true\"");
-                                    break;
-                                }
-                                else
-                                {
-                                    isx509found = 1;
-                                }
-                            }
-                            else if (strcmp(s_token, PROVISIONING_TOKEN) == 0)
-                            {
-                                if (strcmp(STRING_c_str(valueString), PROVISIONING_ACCEPTABLE_VALUE) != 0)
-                                {
-                                    LogError("provisioning option has wrong value, the only acceptable one is \"true\"");
-                                    break;
-                                }
-                                else
-                                {
-                                    use_provisioning = 1;
-                                }
-                            }
+                                memset(IoTHubName, 0, whereIsDot - hostname + 1);
+                                (void)memcpy(IoTHubName, hostname, whereIsDot - hostname);
+                                (void)strcpy(IoTHubSuffix, whereIsDot+1);
 
-                            /* Codes_SRS_IOTHUBCLIENT_LL_04_001: [IoTHubClientCore_LL_CreateFromConnectionString shall verify the existence of key/value pair GatewayHostName. If it does exist it shall pass the value to IoTHubClientCore_LL_Create API.] */
-                            else if (strcmp(s_token, PROTOCOL_GATEWAY_HOST_TOKEN) == 0)
-                            {
-                                protocolGateway = STRING_clone(valueString);
-                                if (protocolGateway != NULL)
-                                {
-                                    config->protocolGatewayHostName = STRING_c_str(protocolGateway);
-                                }
-                                else
-                                {
-                                    LogError("Failure cloning protocol Gateway Name");
-                                    break;
-                                }
-                            }
-                            /*Codes_SRS_IOTHUBCLIENT_LL_31_126: [IoTHubClient_LL_CreateFromConnectionString shall optionally parse ModuleId, if present.] */
-                            else if (strcmp(s_token, MODULE_ID_TOKEN) == 0)
-                            {
-                                moduleId = STRING_clone(valueString);
-                                if (moduleId == NULL)
-                                {
-                                    LogError("Failure cloning moduleId string");
-                                    break;
-                                }
+                                set_shared_transport_config(&actual_config, device_config, IoTHubName, IoTHubSuffix);
+                                config = &actual_config;
+
+                                /*Codes_SRS_IOTHUBCLIENT_LL_02_008: [Otherwise, IoTHubClientCore_LL_Create shall succeed and return a non-NULL handle.] */
+                                result->isSharedTransport = true;
                             }
                         }
                     }
+                    STRING_delete(transport_hostname);
                 }
-                /* parsing is done - check the result */
-                if (config->iotHubName == NULL)
+            }
+            if (result != NULL)
+            {
+                if (create_blob_upload_module(result, config) != 0)
                 {
-                    LogError("iotHubName is not found");
+                    LogError("unable to create blob upload");
+                    // Codes_SRS_IOTHUBCLIENT_LL_09_010: [ If any failure occurs `IoTHubClientCore_LL_Create` shall destroy the `transportHandle` only if it has created it ]
+                    if (!result->isSharedTransport)
+                    {
+                        result->IoTHubTransport_Destroy(result->transportHandle);
+                    }
+                    destroy_blob_upload_module(result);
+                    IoTHubClient_Auth_Destroy(result->authorization_module);
+                    STRING_delete(product_info);
+                    free(result);
                     result = NULL;
                 }
-                else if (config->iotHubSuffix == NULL)
+                else if ((module_id != NULL) && create_edge_handle(result, config, module_id) != 0)
                 {
-                    LogError("iotHubSuffix is not found");
+                    LogError("unable to create module method handle");
+                    if (!result->isSharedTransport)
+                    {
+                        result->IoTHubTransport_Destroy(result->transportHandle);
+                    }
+                    destroy_blob_upload_module(result);
+                    IoTHubClient_Auth_Destroy(result->authorization_module);
+                    STRING_delete(product_info);
+                    free(result);
                     result = NULL;
                 }
-                else if (config->deviceId == NULL)
+                else
+                {
+                    if ((result->tickCounter = tickcounter_create()) == NULL)
+                    {
+                        LogError("unable to get a tickcounter");
+                        // Codes_SRS_IOTHUBCLIENT_LL_09_010: [ If any failure occurs `IoTHubClientCore_LL_Create` shall destroy the `transportHandle` only if it has created it ]
+                        if (!result->isSharedTransport)
+                        {
+                            result->IoTHubTransport_Destroy(result->transportHandle);
+                        }
+                        destroy_blob_upload_module(result);
+                        destroy_module_method_module(result);
+                        IoTHubClient_Auth_Destroy(result->authorization_module);
+                        STRING_delete(product_info);
+                        free(result);
+                        result = NULL;
+                    }
+                    else
+                    {
+                        /*Codes_SRS_IOTHUBCLIENT_LL_02_004: [Otherwise IoTHubClientCore_LL_Create shall initialize a new DLIST (further called "waitingToSend") containing records with fields of the following types: IOTHUB_MESSAGE_HANDLE, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, void*.]*/
+                        DList_InitializeListHead(&(result->waitingToSend));
+                        DList_InitializeListHead(&(result->iot_msg_queue));
+                        DList_InitializeListHead(&(result->iot_ack_queue));
+                        result->messageCallback.type = CALLBACK_TYPE_NONE;
+                        result->lastMessageReceiveTime = INDEFINITE_TIME;
+                        result->data_msg_id = 1;
+                        result->product_info = product_info;
+
+                        IOTHUB_DEVICE_CONFIG deviceConfig;
+                        deviceConfig.deviceId = config->deviceId;
+                        deviceConfig.deviceKey = config->deviceKey;
+                        deviceConfig.deviceSasToken = config->deviceSasToken;
+                        deviceConfig.authorization_module = result->authorization_module;
+                        deviceConfig.moduleId = module_id;
+
+                        /*Codes_SRS_IOTHUBCLIENT_LL_17_008: [IoTHubClientCore_LL_Create shall call the transport _Register function with a populated structure of type IOTHUB_DEVICE_CONFIG and waitingToSend list.] */
+                        if ((result->deviceHandle = result->IoTHubTransport_Register(result->transportHandle, &deviceConfig, &(result->waitingToSend))) == NULL)
+                        {
+                            LogError("Registering device in transport failed");
+                            IoTHubClient_Auth_Destroy(result->authorization_module);
+                            // Codes_SRS_IOTHUBCLIENT_LL_09_010: [ If any failure occurs `IoTHubClientCore_LL_Create` shall destroy the `transportHandle` only if it has created it ]
+                            if (!result->isSharedTransport)
+                            {
+                                result->IoTHubTransport_Destroy(result->transportHandle);
+                            }
+                            destroy_blob_upload_module(result);
+                            destroy_module_method_module(result);
+                            tickcounter_destroy(result->tickCounter);
+                            STRING_delete(product_info);
+                            free(result);
+                            result = NULL;
+                        }
+                        else
+                        {
+                            /*Codes_SRS_IOTHUBCLIENT_LL_02_042: [ By default, messages shall not timeout. ]*/
+                            result->currentMessageTimeout = 0;
+                            result->current_device_twin_timeout = 0;
+                            result->spillThreshold = SPILL_THRESHOLD_DEFAULT;
+
+#ifndef DONT_USE_DIAGNOSTICS
+                            result->diagnostic_setting.currentMessageNumber = 0;
+                            result->diagnostic_setting.diagSamplingPercentage = 0;
+                            result->diagnostic_setting.randomState = 0;
+#endif
+                            (void)memset(&result->tracer, 0, sizeof(result->tracer));
+                            /*Codes_SRS_IOTHUBCLIENT_LL_25_124: [ `IoTHubClientCore_LL_Create` shall set the default retry policy as Exponential backoff with jitter and if succeed and return a `non-NULL` handle. ]*/
+                            if (IoTHubClientCore_LL_SetRetryPolicy(result, IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_JITTER, 0) != IOTHUB_CLIENT_OK)
+                            {
+                                LogError("Setting default retry policy in transport failed");
+                                result->IoTHubTransport_Unregister(result->deviceHandle);
+                                IoTHubClient_Auth_Destroy(result->authorization_module);
+                                // Codes_SRS_IOTHUBCLIENT_LL_09_010: [ If any failure occurs `IoTHubClientCore_LL_Create` shall destroy the `transportHandle` only if it has created it ]
+                                if (!result->isSharedTransport)
+                                {
+                                    result->IoTHubTransport_Destroy(result->transportHandle);
+                                }
+                                destroy_blob_upload_module(result);
+                                destroy_module_method_module(result);
+                                tickcounter_destroy(result->tickCounter);
+                                STRING_delete(product_info);
+                                free(result);
+                                result = NULL;
+                            }
+                        }
+                    }
+                }
+            }
+            if (IoTHubName)
+            {
+                free(IoTHubName);
+            }
+            if (IoTHubSuffix)
+            {
+                free(IoTHubSuffix);
+            }
+        }
+    }
+    if (result != NULL)
+    {
+        IOTHUB_CLIENT_MEMORY_REGISTER(&result->memoryCounters);
+        IOTHUB_CLIENT_STARTUP_MARK(IOTHUB_CLIENT_STARTUP_CLIENT_CREATED);
+    }
+    return result;
+}
+
+static uint32_t get_next_item_id(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData)
+{
+    if (handleData->data_msg_id+1 >= UINT32_MAX)
+    {
+        handleData->data_msg_id = 1;
+    }
+    else
+    {
+        handleData->data_msg_id++;
+    }
+    return handleData->data_msg_id;
+}
+
+static IOTHUB_DEVICE_TWIN* dev_twin_data_create(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, uint32_t id, const unsigned char* reportedState, size_t size, IOTHUB_CLIENT_REPORTED_STATE_CALLBACK reportedStateCallback, void* userContextCallback)
+{
+    IOTHUB_DEVICE_TWIN* result = (IOTHUB_DEVICE_TWIN*)malloc(sizeof(IOTHUB_DEVICE_TWIN) );
+    if (result != NULL)
+    {
+        result->report_data_handle = CONSTBUFFER_Create(reportedState, size);
+        if (result->report_data_handle == NULL)
+        {
+            LogError("Failure allocating reported state data");
+            free(result);
+            result = NULL;
+        }
+        else
+        {
+            result->item_id = id;
+            result->ms_timesOutAfter = 0;
+            result->ms_coalesce_until = 0;
+            result->coalesced = NULL;
+            result->sent_stamped = false;
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_074: [ While a trace exporter is set, IoTHubClientCore_LL_SendReportedState shall start a REPORTED_STATE span, and the transport taking the reported state shall start its REPORTED_STATE_PUBLISH span. ]*/
+            start_trace(handleData, &result->trace, NULL);
+            result->context = userContextCallback;
+            result->reported_state_callback = reportedStateCallback;
+            result->client_handle = handleData;
+            result->device_handle = handleData->deviceHandle;
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_129: [ Every queued reported state shall count its records and its payload in IOTHUB_CLIENT_MEMORY_TWIN of the memory counters of the client until it is destroyed. ]*/
+            IOTHUB_CLIENT_MEMORY_ADD(&handleData->memoryCounters, IOTHUB_CLIENT_MEMORY_TWIN, sizeof(IOTHUB_DEVICE_TWIN) + size);
+        }
+    }
+    else
+    {
+        LogError("Failure allocating device twin information");
+    }
+    return result;
+}
+
+static int coalesce_reported_state(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, const unsigned char* reportedState, size_t size, IOTHUB_CLIENT_REPORTED_STATE_CALLBACK reportedStateCallback, void* userContextCallback)
+{
+    int result;
+    tickcounter_ms_t now;
+
+    if (DList_IsListEmpty(&(handleData->iot_msg_queue)))
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        /*only the newest queued reported state is merged into, so the hub still gets the patches in order*/
+        IOTHUB_DEVICE_TWIN* pending = containingRecord(handleData->iot_msg_queue.Blink, IOTHUB_DEVICE_TWIN, entry);
+        IOTHUB_DEVICE_TWIN* merged_item;
+        CONSTBUFFER_HANDLE merged_data;
+
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_153: [ If `twin_coalesce_offline` is set and the client is not connected, IoTHubClientCore_LL_SendReportedState shall merge reportedState into the newest queued reported state with twin_patch_merge whatever its `twin_coalesce_window`, and queue it on its own if they cannot be merged. ]*/
+        if (!(handleData->twinCoalesceOffline && !handleData->twinConnected) &&
+            (pending->ms_coalesce_until == 0 ||
+            tickcounter_get_current_ms(handleData->tickCounter, &now) != 0 ||
+            now >= pending->ms_coalesce_until))
+        {
+            result = __FAILURE__;
+        }
+        else if ((merged_item = (IOTHUB_DEVICE_TWIN*)malloc(sizeof(IOTHUB_DEVICE_TWIN))) == NULL)
+        {
+            LogError("Failure allocating device twin information");
+            result = __FAILURE__;
+        }
+        else if ((merged_data = twin_patch_merge(pending->report_data_handle, reportedState, size)) == NULL)
+        {
+            LogInfo("Reported state cannot be merged, sending it on its own");
+            free(merged_item);
+            result = __FAILURE__;
+        }
+        else
+        {
+            IOTHUB_DEVICE_TWIN* last = pending;
+
+            IOTHUB_CLIENT_MEMORY_REMOVE(&handleData->memoryCounters, IOTHUB_CLIENT_MEMORY_TWIN, get_reported_state_memory_size(pending));
+            (void)memset(merged_item, 0, sizeof(IOTHUB_DEVICE_TWIN));
+            merged_item->reported_state_callback = reportedStateCallback;
+            merged_item->context = userContextCallback;
+            merged_item->client_handle = handleData;
+            merged_item->device_handle = handleData->deviceHandle;
+            start_trace(handleData, &merged_item->trace, NULL);
+            while (last->coalesced != NULL)
+            {
+                last = last->coalesced;
+            }
+            last->coalesced = merged_item;
+
+            CONSTBUFFER_DecRef(pending->report_data_handle);
+            pending->report_data_handle = merged_data;
+            IOTHUB_CLIENT_MEMORY_ADD(&handleData->memoryCounters, IOTHUB_CLIENT_MEMORY_TWIN, get_reported_state_memory_size(pending));
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+static void on_get_device_twin_completed(DEVICE_TWIN_UPDATE_STATE update_state, const unsigned char* payLoad, size_t size, void* userContextCallback)
+{
+    if (userContextCallback == NULL)
+    {
+        LogError("Invalid argument (userContextCallback=NULL)");
+    }
+    else
+    {
+        GET_TWIN_CONTEXT* getTwinCtx = (GET_TWIN_CONTEXT*)userContextCallback;
+
+        getTwinCtx->callback(update_state, payLoad, size, getTwinCtx->context);
+
+        free(getTwinCtx);
+    }
+}
+
+static void delete_event(IOTHUB_EVENT_CALLBACK* event_callback)
+{
+    STRING_delete(event_callback->inputName);
+    free(event_callback->userContextCallbackEx);
+    free(event_callback);
+}
+
+static void delete_event_callback(const void* item, const void* action_context, bool* continue_processing)
+{
+    (void)action_context;
+    delete_event((IOTHUB_EVENT_CALLBACK*)item);
+    *continue_processing = true;
+}
+
+static void delete_event_callback_list(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData)
+{
+    if (handleData->event_callbacks != NULL)
+    {
+        singlylinkedlist_foreach(handleData->event_callbacks, delete_event_callback, NULL);
+        singlylinkedlist_destroy(handleData->event_callbacks);
+        handleData->event_callbacks = NULL;
+        memset(handleData->inputNameBuckets, 0, sizeof(handleData->inputNameBuckets));
+        handleData->defaultEventCallback = NULL;
+    }
+}
+
+
+IOTHUB_CLIENT_CORE_LL_HANDLE IoTHubClientCore_LL_CreateFromDeviceAuth(const char* iothub_uri, const char* device_id, IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol)
+{
+    IOTHUB_CLIENT_CORE_LL_HANDLE result;
+    if (iothub_uri == NULL || protocol == NULL || device_id == NULL)
+    {
+        LogError("Input parameter is NULL: iothub_uri: %p  protocol: %p device_id: %p", iothub_uri, protocol, device_id);
+        result = NULL;
+    }
+    else
+    {
+#ifdef USE_PROV_MODULE
+        IOTHUB_CLIENT_CONFIG* config = (IOTHUB_CLIENT_CONFIG*)malloc(sizeof(IOTHUB_CLIENT_CONFIG));
+        if (config == NULL)
+        {
+            /* Codes_SRS_IOTHUBCLIENT_LL_12_012: [If the allocation failed IoTHubClientCore_LL_CreateFromConnectionString  returns NULL]  */
+            LogError("Malloc failed");
+            result = NULL;
+        }
+        else
+        {
+            const char* iterator;
+            const char* initial;
+            char* iothub_name = NULL;
+            char* iothub_suffix = NULL;
+
+            memset(config, 0, sizeof(IOTHUB_CLIENT_CONFIG));
+            config->protocol = protocol;
+            config->deviceId = device_id;
+
+            // Find the iothub suffix
+            initial = iterator = iothub_uri;
+            while (iterator != NULL && *iterator != '\0')
+            {
+                if (*iterator == '.')
+                {
+                    size_t length = iterator - initial;
+                    iothub_name = (char*)malloc(length + 1);
+                    if (iothub_name != NULL)
+                    {
+                        memset(iothub_name, 0, length + 1);
+                        memcpy(iothub_name, initial, length);
+                        config->iotHubName = iothub_name;
+
+                        length = strlen(initial) - length - 1;
+                        iothub_suffix = (char*)malloc(length + 1);
+                        if (iothub_suffix != NULL)
+                        {
+                            memset(iothub_suffix, 0, length + 1);
+                            memcpy(iothub_suffix, iterator + 1, length);
+                            config->iotHubSuffix = iothub_suffix;
+                            break;
+                        }
+                        else
+                        {
+                            LogError("Failed to allocate iothub suffix");
+                            free(iothub_name);
+                            iothub_name = NULL;
+                            result = NULL;
+                        }
+                    }
+                    else
+                    {
+                        LogError("Failed to allocate iothub name");
+                        result = NULL;
+                    }
+                }
+                iterator++;
+            }
+
+            if (config->iotHubName == NULL || config->iotHubSuffix == NULL)
+            {
+                LogError("initialize iothub client");
+                result = NULL;
+            }
+            else
+            {
+                IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = initialize_iothub_client(config, NULL, true, NULL, NULL);
+                if (handleData == NULL)
+                {
+                    LogError("initialize iothub client");
+                    result = NULL;
+                }
+                else
+                {
+                    result = handleData;
+                }
+            }
+
+            free(iothub_name);
+            free(iothub_suffix);
+            free(config);
+        }
+#else
+        LogError("HSM module is not included");
+        result = NULL;
+#endif
+    }
+    return result;
+}
+
+IOTHUB_CLIENT_CORE_LL_HANDLE IoTHubClientCore_LL_CreateFromConnectionString(const char* connectionString, IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol)
+{
+    IOTHUB_CLIENT_CORE_LL_HANDLE result;
+
+    /* Codes_SRS_IOTHUBCLIENT_LL_12_003: [IoTHubClientCore_LL_CreateFromConnectionString shall verify the input parameter and if it is NULL then return NULL] */
+    if (connectionString == NULL)
+    {
+        LogError("Input parameter is NULL: connectionString");
+        result = NULL;
+    }
+    else if (protocol == NULL)
+    {
+        LogError("Input parameter is NULL: protocol");
+        result = NULL;
+    }
+    else
+    {
+        /* Codes_SRS_IOTHUBCLIENT_LL_12_004: [IoTHubClientCore_LL_CreateFromConnectionString shall allocate IOTHUB_CLIENT_CONFIG structure] */
+        IOTHUB_CLIENT_CONFIG* config = (IOTHUB_CLIENT_CONFIG*) malloc(sizeof(IOTHUB_CLIENT_CONFIG));
+        if (config == NULL)
+        {
+            /* Codes_SRS_IOTHUBCLIENT_LL_12_012: [If the allocation failed IoTHubClientCore_LL_CreateFromConnectionString  returns NULL]  */
+            LogError("Malloc failed");
+            result = NULL;
+        }
+        else
+        {
+            STRING_TOKENIZER_HANDLE tokenizer1 = NULL;
+            STRING_HANDLE connString = NULL;
+            STRING_HANDLE tokenString = NULL;
+            STRING_HANDLE valueString = NULL;
+            STRING_HANDLE hostNameString = NULL;
+            STRING_HANDLE hostSuffixString = NULL;
+            STRING_HANDLE deviceIdString = NULL;
+            STRING_HANDLE deviceKeyString = NULL;
+            STRING_HANDLE deviceSasTokenString = NULL;
+            STRING_HANDLE protocolGateway = NULL;
+            STRING_HANDLE moduleId = NULL;
+
+            memset(config, 0, sizeof(*config));
+            config->protocol = protocol;
+
+            /* Codes_SRS_IOTHUBCLIENT_LL_04_002: [If it does not, it shall pass the protocolGatewayHostName NULL.] */
+            config->protocolGatewayHostName = NULL;
+
+            if ((connString = STRING_construct(connectionString)) == NULL)
+            {
+                LogError("Error constructing connectiong String");
+                result = NULL;
+            }
+            else if ((tokenizer1 = STRING_TOKENIZER_create(connString)) == NULL)
+            {
+                LogError("Error creating Tokenizer");
+                result = NULL;
+            }
+            else if ((tokenString = STRING_new()) == NULL)
+            {
+                LogError("Error creating Token String");
+                result = NULL;
+            }
+            else if ((valueString = STRING_new()) == NULL)
+            {
+                LogError("Error creating Value String");
+                result = NULL;
+            }
+            else if ((hostNameString = STRING_new()) == NULL)
+            {
+                LogError("Error creating HostName String");
+                result = NULL;
+            }
+            else if ((hostSuffixString = STRING_new()) == NULL)
+            {
+                LogError("Error creating HostSuffix String");
+                result = NULL;
+            }
+            /* Codes_SRS_IOTHUBCLIENT_LL_12_005: [IoTHubClientCore_LL_CreateFromConnectionString shall try to parse the connectionString input parameter for the following structure: "Key1=value1;key2=value2;key3=value3..."] */
+            /* Codes_SRS_IOTHUBCLIENT_LL_12_006: [IoTHubClientCore_LL_CreateFromConnectionString shall verify the existence of the following Key/Value pairs in the connection string: HostName, DeviceId, SharedAccessKey, SharedAccessSignature or x509]  */
+            else
+            {
+                int isx509found = 0;
+                bool use_provisioning = false;
+                while ((STRING_TOKENIZER_get_next_token(tokenizer1, tokenString, "=") == 0))
+                {
+                    if (STRING_TOKENIZER_get_next_token(tokenizer1, valueString, ";") != 0)
+                    {
+                        LogError("Tokenizer error");
+                        break;
+                    }
+                    else
+                    {
+                        if (tokenString != NULL)
+                        {
+                            /* Codes_SRS_IOTHUBCLIENT_LL_12_010: [IoTHubClientCore_LL_CreateFromConnectionString shall fill up the IOTHUB_CLIENT_CONFIG structure using the following mapping: iotHubName = Name, iotHubSuffix = Suffix, deviceId = DeviceId, deviceKey = SharedAccessKey or deviceSasToken = SharedAccessSignature] */
+                            const char* s_token = STRING_c_str(tokenString);
+                            if (strcmp(s_token, HOSTNAME_TOKEN) == 0)
+                            {
+                                /* Codes_SRS_IOTHUBCLIENT_LL_12_009: [IoTHubClientCore_LL_CreateFromConnectionString shall split the value of HostName to Name and Suffix using the first "." as a separator] */
+                                STRING_TOKENIZER_HANDLE tokenizer2 = NULL;
+                                if ((tokenizer2 = STRING_TOKENIZER_create(valueString)) == NULL)
+                                {
+                                    LogError("Error creating Tokenizer");
+                                    break;
+                                }
+                                else
+                                {
+                                    /* Codes_SRS_IOTHUBCLIENT_LL_12_015: [If the string split failed, IoTHubClientCore_LL_CreateFromConnectionString returns NULL ] */
+                                    if (STRING_TOKENIZER_get_next_token(tokenizer2, hostNameString, ".") != 0)
+                                    {
+                                        LogError("Tokenizer error");
+                                        STRING_TOKENIZER_destroy(tokenizer2);
+                                        break;
+                                    }
+                                    else
+                                    {
+                                        config->iotHubName = STRING_c_str(hostNameString);
+                                        if (STRING_TOKENIZER_get_next_token(tokenizer2, hostSuffixString, ";") != 0)
+                                        {
+                                            LogError("Tokenizer error");
+                                            STRING_TOKENIZER_destroy(tokenizer2);
+                                            break;
+                                        }
+                                        else
+                                        {
+                                            config->iotHubSuffix = STRING_c_str(hostSuffixString);
+                                        }
+                                    }
+                                    STRING_TOKENIZER_destroy(tokenizer2);
+                                }
+                            }
+                            else if (strcmp(s_token, DEVICEID_TOKEN) == 0)
+                            {
+                                deviceIdString = STRING_clone(valueString);
+                                if (deviceIdString != NULL)
+                                {
+                                    config->deviceId = STRING_c_str(deviceIdString);
+                                }
+                                else
+                                {
+                                    LogError("Failure cloning device id string");
+                                    break;
+                                }
+                            }
+                            else if (strcmp(s_token, DEVICEKEY_TOKEN) == 0)
+                            {
+                                deviceKeyString = STRING_clone(valueString);
+                                if (deviceKeyString != NULL)
+                                {
+                                    config->deviceKey = STRING_c_str(deviceKeyString);
+                                }
+                                else
+                                {
+                                    LogError("Failure cloning device key string");
+                                    break;
+                                }
+                            }
+                            else if (strcmp(s_token, DEVICESAS_TOKEN) == 0)
+                            {
+                                deviceSasTokenString = STRING_clone(valueString);
+                                if (deviceSasTokenString != NULL)
+                                {
+                                    config->deviceSasToken = STRING_c_str(deviceSasTokenString);
+                                }
+                                else
+                                {
+                                    LogError("Failure cloning device sasToken string");
+                                    break;
+                                }
+                            }
+                            else if (strcmp(s_token, X509_TOKEN) == 0)
+                            {
+                                if (strcmp(STRING_c_str(valueString), X509_TOKEN_ONLY_ACCEPTABLE_VALUE) != 0)
+                                {
+                                    LogError("x509 option has wrong value, the only acceptable one is \"true\"");
+                                    break;
+                                }
+                                else
+                                {
+                                    isx509found = 1;
+                                }
+                            }
+                            else if (strcmp(s_token, PROVISIONING_TOKEN) == 0)
+                            {
+                                if (strcmp(STRING_c_str(valueString), PROVISIONING_ACCEPTABLE_VALUE) != 0)
+                                {
+                                    LogError("provisioning option has wrong value, the only acceptable one is \"true\"");
+                                    break;
+                                }
+                                else
+                                {
+                                    use_provisioning = 1;
+                                }
+                            }
+
+                            /* Codes_SRS_IOTHUBCLIENT_LL_04_001: [IoTHubClientCore_LL_CreateFromConnectionString shall verify the existence of key/value pair GatewayHostName. If it does exist it shall pass the value to IoTHubClientCore_LL_Create API.] */
+                            else if (strcmp(s_token, PROTOCOL_GATEWAY_HOST_TOKEN) == 0)
+                            {
+                                protocolGateway = STRING_clone(valueString);
+                                if (protocolGateway != NULL)
+                                {
+                                    config->protocolGatewayHostName = STRING_c_str(protocolGateway);
+                                }
+                                else
+                                {
+                                    LogError("Failure cloning protocol Gateway Name");
+                                    break;
+                                }
+                            }
+                            /*Codes_SRS_IOTHUBCLIENT_LL_31_126: [IoTHubClient_LL_CreateFromConnectionString shall optionally parse ModuleId, if present.] */
+                            else if (strcmp(s_token, MODULE_ID_TOKEN) == 0)
+                            {
+                                moduleId = STRING_clone(valueString);
+                                if (moduleId == NULL)
+                                {
+                                    LogError("Failure cloning moduleId string");
+                                    break;
+                                }
+                            }
+                        }
+                    }
+                }
+                /* parsing is done - check the result */
+                if (config->iotHubName == NULL)
+                {
+                    LogError("iotHubName is not found");
+                    result = NULL;
+                }
+                else if (config->iotHubSuffix == NULL)
+                {
+                    LogError("iotHubSuffix is not found");
+                    result = NULL;
+                }
+                else if (config->deviceId == NULL)
+                {
+                    LogError("deviceId is not found");
+                    result = NULL;
+                }
+                else if (!(
+                    ((!use_provisioning && !isx509found) && (config->deviceSasToken == NULL) ^ (config->deviceKey == NULL)) ||
+                    ((use_provisioning || isx509found) && (config->deviceSasToken == NULL) && (config->deviceKey == NULL))
+                    ))
+                {
+                    LogError("invalid combination of x509, provisioning, deviceSasToken and deviceKey");
+                    result = NULL;
+                }
+                else
+                {
+                    /* Codes_SRS_IOTHUBCLIENT_LL_12_011: [IoTHubClientCore_LL_CreateFromConnectionString shall call into the IoTHubClientCore_LL_Create API with the current structure and returns with the return value of it] */
+                    result = initialize_iothub_client(config, NULL, use_provisioning, STRING_c_str(moduleId), NULL);
+                    if (result == NULL)
+                    {
+                        LogError("IoTHubClientCore_LL_Create failed");
+                    }
+                    else
+                    {
+                        /*return as is*/
+                    }
+                }
+            }
+            if (deviceSasTokenString != NULL)
+                STRING_delete(deviceSasTokenString);
+            if (deviceKeyString != NULL)
+                STRING_delete(deviceKeyString);
+            if (deviceIdString != NULL)
+                STRING_delete(deviceIdString);
+            if (hostSuffixString != NULL)
+                STRING_delete(hostSuffixString);
+            if (hostNameString != NULL)
+                STRING_delete(hostNameString);
+            if (valueString != NULL)
+                STRING_delete(valueString);
+            if (tokenString != NULL)
+                STRING_delete(tokenString);
+            if (connString != NULL)
+                STRING_delete(connString);
+            if (protocolGateway != NULL)
+                STRING_delete(protocolGateway);
+            if (moduleId != NULL)
+                STRING_delete(moduleId);
+
+            if (tokenizer1 != NULL)
+                STRING_TOKENIZER_destroy(tokenizer1);
+
+            free(config);
+        }
+    }
+    return result;
+}
+
+IOTHUB_CLIENT_CORE_LL_HANDLE IoTHubClientCore_LL_CreateImpl(const IOTHUB_CLIENT_CONFIG* config, const char* module_id, bool use_dev_auth)
+{
+    IOTHUB_CLIENT_CORE_LL_HANDLE result;
+    /*Codes_SRS_IOTHUBCLIENT_LL_02_001: [IoTHubClientCore_LL_Create shall return NULL if config parameter is NULL or protocol field is NULL.]*/
+    if(
+        (config == NULL) ||
+        (config->protocol == NULL)
+        )
+    {
+        result = NULL;
+        LogError("invalid configuration (NULL detected)");
+    }
+    else
+    {
+        IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = initialize_iothub_client(config, NULL, use_dev_auth, module_id, NULL);
+        if (handleData == NULL)
+        {
+            LogError("initialize iothub client");
+            result = NULL;
+        }
+        else
+        {
+            result = handleData;
+        }
+    }
+
+    return result;
+}
+
+IOTHUB_CLIENT_CORE_LL_HANDLE IoTHubClientCore_LL_Create(const IOTHUB_CLIENT_CONFIG* config)
+{
+    return IoTHubClientCore_LL_CreateImpl(config, NULL, false);
+}
+
+#ifdef USE_EDGE_MODULES
+IOTHUB_CLIENT_CORE_LL_HANDLE IoTHubClientCore_LL_CreateFromEnvironment(IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol)
+{
+    IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* result;
+    EDGE_ENVIRONMENT_VARIABLES edge_environment_variables;
+
+    memset(&edge_environment_variables, 0, sizeof(edge_environment_variables));
+
+    if (retrieve_edge_environment_variabes(&edge_environment_variables) != 0)
+    {
+        LogError("retrieve_edge_environment_variabes failed");
+        result = NULL;
+    }
+    // The presence of a connection string environment variable means we use it, ignoring other settings
+    else if (edge_environment_variables.connection_string != NULL)
+    {
+        if ((result = IoTHubClientCore_LL_CreateFromConnectionString(edge_environment_variables.connection_string, protocol)) == NULL)
+        {
+            LogError("IoTHubClientCore_LL_CreateFromConnectionString fails");
+        }
+    }
+    else if (iothub_security_init(IOTHUB_SECURITY_TYPE_HTTP_EDGE) != 0)
+    {
+        LogError("iothub_security_init failed");
+        result = NULL;
+    }
+    else
+    {
+        IOTHUB_CLIENT_CONFIG client_config;
+
+        memset(&client_config, 0, sizeof(client_config));
+        client_config.protocol = protocol;
+        client_config.deviceId = edge_environment_variables.device_id;
+        client_config.iotHubName = edge_environment_variables.iothub_name;
+        client_config.iotHubSuffix = edge_environment_variables.iothub_suffix;
+        client_config.protocolGatewayHostName = edge_environment_variables.gatewayhostname;
+
+        if ((result = IoTHubClientCore_LL_CreateImpl(&client_config, edge_environment_variables.module_id, true)) == NULL)
+        {
+            LogError("IoTHubClientCore_LL_CreateImpl fails");
+        }
+    }
+
+    if (result != NULL)
+    {
+        // Because the Edge Hub almost always use self-signed certificates, we need to specify which certificates to trust.  We need to do 
+        // this regardless of how we created the underlying IOTHUB_CLIENT_CORE_LL_HANDLE_DATA.
+        IOTHUB_CLIENT_RESULT setTrustResult;
+        char* trustedCertificate = IoTHubClient_Auth_Get_TrustBundle(result->authorization_module, edge_environment_variables.ca_trusted_certificate_file);
+        
+        if (trustedCertificate == NULL)
+        {
+            LogError("IoTHubClient_Auth_Get_TrustBundle failed");
+            IoTHubClientCore_LL_Destroy(result);
+            result = NULL;
+        }
+        else if ((setTrustResult = IoTHubClientCore_LL_SetOption(result, OPTION_TRUSTED_CERT, trustedCertificate)) != IOTHUB_CLIENT_OK)
+        {
+            LogError("IoTHubClientCore_LL_SetOption failed, err = %d", setTrustResult);
+            IoTHubClientCore_LL_Destroy(result);
+            result = NULL;
+        }
+        
+        free(trustedCertificate);
+    }
+
+    free(edge_environment_variables.iothub_buffer);
+    return result;
+}
+#endif
+
+
+IOTHUB_CLIENT_CORE_LL_HANDLE IoTHubClientCore_LL_CreateWithTransport(const IOTHUB_CLIENT_DEVICE_CONFIG * config)
+{
+    IOTHUB_CLIENT_CORE_LL_HANDLE result;
+    /*Codes_SRS_IOTHUBCLIENT_LL_17_001: [IoTHubClientCore_LL_CreateWithTransport shall return NULL if config parameter is NULL, or protocol field is NULL or transportHandle is NULL.]*/
+    if (
+        (config == NULL) ||
+        (config->protocol == NULL) ||
+        (config->transportHandle == NULL) ||
+        /*Codes_SRS_IOTHUBCLIENT_LL_02_098: [ IoTHubClientCore_LL_CreateWithTransport shall fail and return NULL if both config->deviceKey AND config->deviceSasToken are NULL. ]*/
+        ((config->deviceKey == NULL) && (config->deviceSasToken == NULL))
+        )
+    {
+        result = NULL;
+        LogError("invalid configuration (NULL detected)");
+    }
+    else
+    {
+        result = initialize_iothub_client(NULL, config, false, NULL, NULL);
+    }
+    return result;
+}
+
+static bool is_batch_config_valid(const IOTHUB_CLIENT_DEVICE_CONFIG* configs, size_t count)
+{
+    bool result = true;
+    size_t index;
+
+    for (index = 0; index < count && result; index++)
+    {
+        const IOTHUB_CLIENT_DEVICE_CONFIG* config = &configs[index];
+        if ((config->protocol == NULL) ||
+            (config->transportHandle == NULL) ||
+            ((config->deviceKey == NULL) && (config->deviceSasToken == NULL)) ||
+            (config->protocol != configs[0].protocol) ||
+            (config->transportHandle != configs[0].transportHandle))
+        {
+            LogError("invalid configuration at index %lu", (unsigned long)index);
+            result = false;
+        }
+    }
+
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_CreateBatchWithTransport(const IOTHUB_CLIENT_DEVICE_CONFIG* configs, size_t count, IOTHUB_CLIENT_CORE_LL_HANDLE* handles)
+{
+    IOTHUB_CLIENT_RESULT result;
+    STRING_HANDLE transport_hostname = NULL;
+    const char* whereIsDot = NULL;
+    char* hostname_copy = NULL;
+    CLIENT_CREATE_SHARED_DATA shared_data;
+
+    memset(&shared_data, 0, sizeof(CLIENT_CREATE_SHARED_DATA));
+
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_122: [ If configs or handles is NULL, count is 0, or any config would fail IoTHubClientCore_LL_CreateWithTransport or does not have the transportHandle and protocol of the first, IoTHubClientCore_LL_CreateBatchWithTransport shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+    if ((configs == NULL) || (handles == NULL) || (count == 0) || !is_batch_config_valid(configs, count))
+    {
+        LogError("invalid argument configs=%p, count=%lu, handles=%p", configs, (unsigned long)count, handles);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_123: [ IoTHubClientCore_LL_CreateBatchWithTransport shall get the IoT Hub name from the transport and make the product info once for all the clients. ]*/
+    else if ((transport_hostname = ((TRANSPORT_PROVIDER*)configs[0].protocol())->IoTHubTransport_GetHostname(configs[0].transportHandle)) == NULL)
+    {
+        LogError("unable to determine the transport IoTHub name");
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else if ((whereIsDot = strchr(STRING_c_str(transport_hostname), '.')) == NULL)
+    {
+        LogError("unable to determine the IoTHub name");
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else if (mallocAndStrcpy_s(&hostname_copy, STRING_c_str(transport_hostname)) != 0)
+    {
+        LogError("unable to copy the IoTHub name");
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else if ((shared_data.product_info = make_product_info(NULL)) == NULL)
+    {
+        LogError("failed to initialize product info");
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else
+    {
+        size_t name_length = whereIsDot - STRING_c_str(transport_hostname);
+        size_t index;
+
+        /*the name and the suffix are both taken out of the one copy*/
+        hostname_copy[name_length] = '\0';
+        shared_data.iothub_name = hostname_copy;
+        shared_data.iothub_suffix = hostname_copy + name_length + 1;
+
+        srand((unsigned int)time(NULL));
+        result = IOTHUB_CLIENT_OK;
+
+        for (index = 0; index < count; index++)
+        {
+            if ((handles[index] = initialize_iothub_client(NULL, &configs[index], false, NULL, &shared_data)) == NULL)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_125: [ If creating any of the clients fails, IoTHubClientCore_LL_CreateBatchWithTransport shall destroy the ones already created, set all handles to NULL and return IOTHUB_CLIENT_ERROR. ]*/
+                size_t created;
+                LogError("failed creating the client at index %lu", (unsigned long)index);
+                for (created = 0; created < index; created++)
+                {
+                    IoTHubClientCore_LL_Destroy(handles[created]);
+                }
+                memset(handles, 0, count * sizeof(IOTHUB_CLIENT_CORE_LL_HANDLE));
+                result = IOTHUB_CLIENT_ERROR;
+                break;
+            }
+        }
+    }
+
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_126: [ On success IoTHubClientCore_LL_CreateBatchWithTransport shall fill handles with count clients, each to be destroyed with IoTHubClientCore_LL_Destroy, and return IOTHUB_CLIENT_OK. ]*/
+    STRING_delete(shared_data.product_info);
+    if (hostname_copy != NULL)
+    {
+        free(hostname_copy);
+    }
+    STRING_delete(transport_hostname);
+
+    return result;
+}
+
+void IoTHubClientCore_LL_Destroy(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle)
+{
+    /*Codes_SRS_IOTHUBCLIENT_LL_02_009: [IoTHubClientCore_LL_Destroy shall do nothing if parameter iotHubClientHandle is NULL.]*/
+    if (iotHubClientHandle != NULL)
+    {
+        PDLIST_ENTRY unsend;
+        /*Codes_SRS_IOTHUBCLIENT_LL_17_010: [IoTHubClientCore_LL_Destroy  shall call the underlaying layer's _Unregister function] */
+        IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)iotHubClientHandle;
+        if (handleData->receivedBatchCount > 0)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_144: [ IoTHubClientCore_LL_Destroy shall abandon the messages kept for the batch callback that were not settled, before calling the underlying layer's _Unregister function. ]*/
+            abandon_received_messages(handleData, 0);
+        }
+        handleData->IoTHubTransport_Unregister(handleData->deviceHandle);
+        if (handleData->isSharedTransport == false)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_02_010: [If iotHubClientHandle was not created by IoTHubClientCore_LL_CreateWithTransport, IoTHubClientCore_LL_Destroy  shall call the underlaying layer's _Destroy function.] */
+            handleData->IoTHubTransport_Destroy(handleData->transportHandle);
+        }
+        /*if any, remove the items currently not send*/
+        while ((unsend = DList_RemoveHeadList(&(handleData->waitingToSend))) != &(handleData->waitingToSend))
+        {
+            IOTHUB_MESSAGE_LIST* temp = containingRecord(unsend, IOTHUB_MESSAGE_LIST, entry);
+            /*Codes_SRS_IOTHUBCLIENT_LL_02_033: [Otherwise, IoTHubClientCore_LL_Destroy shall complete all the event message callbacks that are in the waitingToSend list with the result IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY.] */
+            complete_event(handleData, temp, IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY);
+            IoTHubMessage_Destroy(temp->messageHandle);
+            free(temp);
+        }
+        if (handleData->heldEventCount > 0)
+        {
+            while ((unsend = DList_RemoveHeadList(&(handleData->heldEvents))) != &(handleData->heldEvents))
+            {
+                IOTHUB_MESSAGE_LIST* temp = containingRecord(unsend, IOTHUB_MESSAGE_LIST, entry);
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_115: [ IoTHubClientCore_LL_Destroy shall complete the events held by `send_window` with IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY, after the ones in waitingToSend. ]*/
+                complete_event(handleData, temp, IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY);
+                IoTHubMessage_Destroy(temp->messageHandle);
+                free(temp);
+            }
+        }
+        if (handleData->sendWindowUrgentProperty != NULL)
+        {
+            free(handleData->sendWindowUrgentProperty);
+        }
+        if (handleData->pendingMethodResponses.Flink != NULL)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_171: [ IoTHubClientCore_LL_Destroy shall drop the method responses held back by `rate_limits`. ]*/
+            while ((unsend = DList_RemoveHeadList(&(handleData->pendingMethodResponses))) != &(handleData->pendingMethodResponses))
+            {
+                free(containingRecord(unsend, PENDING_METHOD_RESPONSE, entry));
+            }
+        }
+
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_121: [ IoTHubClientCore_LL_Destroy shall close the twin cache; the twin stays in its file. ]*/
+        if (handleData->twinCache != NULL)
+        {
+            twin_cache_destroy(handleData->twinCache);
+        }
+
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_151: [ IoTHubClientCore_LL_Destroy shall free the desired property subscriptions. ]*/
+        if (handleData->twinFanout != NULL)
+        {
+            twin_fanout_destroy(handleData->twinFanout);
+        }
+
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_032: [ IoTHubClientCore_LL_Destroy shall close the spill log; events still in it shall be sent by the next client that sets the same OPTION_SPILL_DIRECTORY. ]*/
+        if (handleData->spillQueue != NULL)
+        {
+            spill_queue_destroy(handleData->spillQueue);
+        }
+
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_104: [ IoTHubClientCore_LL_Destroy shall drop the aggregation windows not sent yet. ]*/
+        if (handleData->telemetryAggregation != NULL)
+        {
+            telemetry_aggregation_destroy(handleData->telemetryAggregation);
+        }
+        if (handleData->outputRouting != NULL)
+        {
+            output_routing_destroy(handleData->outputRouting);
+        }
+
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_107: [ IoTHubClientCore_LL_Destroy shall complete the suppressed events not completed yet with IOTHUB_CLIENT_CONFIRMATION_OK. ]*/
+        if (handleData->suppressedEventCount > 0)
+        {
+            complete_suppressed_events(handleData);
+        }
+        if (handleData->suppressedEvents != NULL)
+        {
+            free(handleData->suppressedEvents);
+        }
+        if (handleData->reportByException != NULL)
+        {
+            report_by_exception_destroy(handleData->reportByException);
+        }
+
+        if (handleData->eventConfirmationBatchCallback != NULL)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_005: [ IoTHubClientCore_LL_Destroy shall deliver any confirmations still recorded for the batch before freeing the handle. ]*/
+            flush_event_confirmations(handleData);
+        }
+        if (handleData->confirmationBatch != NULL)
+        {
+            free(handleData->confirmationBatch);
+        }
+        if (handleData->receivedBatch != NULL)
+        {
+            free(handleData->receivedBatch);
+        }
+        if (handleData->receivedBatchMessages != NULL)
+        {
+            free(handleData->receivedBatchMessages);
+        }
+        if (handleData->messageTimeouts != NULL)
+        {
+            free(handleData->messageTimeouts);
+        }
+        if (handleData->methodsInFlight != NULL)
+        {
+            free(handleData->methodsInFlight);
+        }
+        if (handleData->messageListPool != NULL)
+        {
+            while (handleData->messageListPoolCount > 0)
+            {
+                free(handleData->messageListPool[--handleData->messageListPoolCount]);
+            }
+            free(handleData->messageListPool);
+        }
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_159: [ IoTHubClientCore_LL_Destroy shall free the small event slots once the events still using them were completed. ]*/
+        if (handleData->smallEventSlots != NULL)
+        {
+            if (handleData->smallEventSlotsInUse > 0)
+            {
+                LogError("%lu small events were not completed by the transport", (unsigned long)handleData->smallEventSlotsInUse);
+            }
+            free(handleData->smallEventSlots);
+        }
+
+        /* Codes_SRS_IOTHUBCLIENT_LL_07_007: [ IoTHubClientCore_LL_Destroy shall iterate the device twin queues and destroy any remaining items. ] */
+        while ((unsend = DList_RemoveHeadList(&(handleData->iot_msg_queue))) != &(handleData->iot_msg_queue))
+        {
+            IOTHUB_DEVICE_TWIN* temp = containingRecord(unsend, IOTHUB_DEVICE_TWIN, entry);
+            device_twin_data_destroy(temp);
+        }
+        while ((unsend = DList_RemoveHeadList(&(handleData->iot_ack_queue))) != &(handleData->iot_ack_queue))
+        {
+            IOTHUB_DEVICE_TWIN* temp = containingRecord(unsend, IOTHUB_DEVICE_TWIN, entry);
+            device_twin_data_destroy(temp);
+        }
+
+        /* Codes_SRS_IOTHUBCLIENT_LL_31_141: [ IoTHubClient_LL_Destroy shall iterate registered callbacks for input queues and destroy any remaining items. ] */
+        delete_event_callback_list(handleData);
+        delete_method_handlers(handleData);
+
+        /*Codes_SRS_IOTHUBCLIENT_LL_17_011: [IoTHubClientCore_LL_Destroy  shall free the resources allocated by IoTHubClient (if any).] */
+        IoTHubClient_Auth_Destroy(handleData->authorization_module);
+        tickcounter_destroy(handleData->tickCounter);
+#ifndef DONT_USE_UPLOADTOBLOB
+        IoTHubClient_LL_UploadToBlob_Destroy(handleData->uploadToBlobHandle);
+#endif
+#ifdef USE_EDGE_MODULES
+        IoTHubClient_EdgeHandle_Destroy(handleData->methodHandle);
+#endif
+        STRING_delete(handleData->product_info);
+        IOTHUB_CLIENT_MEMORY_UNREGISTER(&handleData->memoryCounters);
+        free(handleData);
+    }
+}
+
+static bool message_timeout_is_earlier(const MESSAGE_TIMEOUT* left, const MESSAGE_TIMEOUT* right)
+{
+    return (left->ms_timesOutAfter + left->message_timeout_value) < (right->ms_timesOutAfter + right->message_timeout_value);
+}
+
+static void swap_message_timeouts(MESSAGE_TIMEOUT* heap, size_t left, size_t right)
+{
+    MESSAGE_TIMEOUT temp = heap[left];
+    heap[left] = heap[right];
+    heap[right] = temp;
+}
+
+/*makes room for "needed" more message timeouts, returns 0 on success, any other value is error*/
+static int reserve_message_timeouts(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, size_t needed)
+{
+    int result;
+
+    if (handleData->messageTimeoutCapacity - handleData->messageTimeoutCount < needed)
+    {
+        size_t new_capacity = (handleData->messageTimeoutCapacity == 0) ? MESSAGE_TIMEOUT_HEAP_INITIAL_CAPACITY : handleData->messageTimeoutCapacity * 2;
+        MESSAGE_TIMEOUT* new_heap;
+
+        while ((new_capacity > handleData->messageTimeoutCapacity) && (new_capacity - handleData->messageTimeoutCount < needed))
+        {
+            new_capacity *= 2;
+        }
+
+        if ((new_capacity <= handleData->messageTimeoutCapacity) || (new_capacity - handleData->messageTimeoutCount < needed) || (new_capacity > SIZE_MAX / sizeof(MESSAGE_TIMEOUT)))
+        {
+            LogError("message timeouts cannot grow past %lu entries", (unsigned long)handleData->messageTimeoutCapacity);
+            new_heap = NULL;
+        }
+        else if ((new_heap = (MESSAGE_TIMEOUT*)realloc(handleData->messageTimeouts, new_capacity * sizeof(MESSAGE_TIMEOUT))) == NULL)
+        {
+            LogError("failure growing the message timeouts");
+        }
+        else
+        {
+            handleData->messageTimeouts = new_heap;
+            handleData->messageTimeoutCapacity = new_capacity;
+        }
+
+        result = (new_heap == NULL) ? __FAILURE__ : 0;
+    }
+    else
+    {
+        result = 0;
+    }
+
+    return result;
+}
+
+/*returns 0 on success, any other value is error*/
+static int add_message_timeout(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_LIST* message)
+{
+    int result = reserve_message_timeouts(handleData, 1);
+
+    if (result == 0)
+    {
+        MESSAGE_TIMEOUT* heap = handleData->messageTimeouts;
+        size_t index = handleData->messageTimeoutCount++;
+
+        heap[index].ms_timesOutAfter = message->ms_timesOutAfter;
+        heap[index].message_timeout_value = message->message_timeout_value;
+        heap[index].send_sequence = message->send_sequence;
+        heap[index].message = message;
+
+        while ((index > 0) && message_timeout_is_earlier(&heap[index], &heap[(index - 1) / 2]))
+        {
+            swap_message_timeouts(heap, index, (index - 1) / 2);
+            index = (index - 1) / 2;
+        }
+    }
+
+    return result;
+}
+
+static void remove_earliest_message_timeout(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData)
+{
+    MESSAGE_TIMEOUT* heap = handleData->messageTimeouts;
+    size_t count = --handleData->messageTimeoutCount;
+    size_t index = 0;
+
+    heap[0] = heap[count];
+    while (true)
+    {
+        size_t earliest = index;
+        size_t left = (2 * index) + 1;
+        size_t right = left + 1;
+
+        if ((left < count) && message_timeout_is_earlier(&heap[left], &heap[earliest]))
+        {
+            earliest = left;
+        }
+        if ((right < count) && message_timeout_is_earlier(&heap[right], &heap[earliest]))
+        {
+            earliest = right;
+        }
+        if (earliest == index)
+        {
+            break;
+        }
+        swap_message_timeouts(heap, index, earliest);
+        index = earliest;
+    }
+}
+
+/*events are only held while no newer event went to waitingToSend, so the held ones are exactly the newest send_sequence numbers*/
+static bool is_held_event(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, const MESSAGE_TIMEOUT* messageTimeout)
+{
+    return (handleData->heldEventCount > 0) && (messageTimeout->send_sequence >= handleData->heldSequenceStart);
+}
+
+static void release_held_events(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData)
+{
+    PDLIST_ENTRY entry;
+    while ((entry = DList_RemoveHeadList(&(handleData->heldEvents))) != &(handleData->heldEvents))
+    {
+        DList_InsertTailList(&(handleData->waitingToSend), entry);
+    }
+    handleData->heldEventCount = 0;
+    /*the radio is woken up for them anyway, so reported states go along*/
+    handleData->sendWindowOpen = true;
+}
+
+/*without a telemetry rate in `rate_limits` every held event goes, otherwise as many as the bucket holds tokens for*/
+static void release_allowed_events(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData)
+{
+    if (handleData->eventRateLimit.refill_per_ms == 0)
+    {
+        release_held_events(handleData);
+    }
+    else
+    {
+        while ((handleData->heldEventCount > 0) && has_rate_limit_token(&handleData->eventRateLimit))
+        {
+            DList_InsertTailList(&(handleData->waitingToSend), DList_RemoveHeadList(&(handleData->heldEvents)));
+            handleData->heldEventCount--;
+            take_rate_limit_token(&handleData->eventRateLimit);
+        }
+
+        if (handleData->heldEventCount > 0)
+        {
+            handleData->heldSequenceStart = containingRecord(handleData->heldEvents.Flink, IOTHUB_MESSAGE_LIST, entry)->send_sequence;
+        }
+    }
+}
+
+/*transports only ever take messages from the head of waitingToSend (and put them back there in order), so a message is still
+waiting exactly when its sequence number is not older than the one of the current head*/
+static bool is_waiting_to_send(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, const MESSAGE_TIMEOUT* messageTimeout)
+{
+    bool result;
+    if (handleData->waitingToSend.Flink == &(handleData->waitingToSend))
+    {
+        result = false;
+    }
+    else
+    {
+        IOTHUB_MESSAGE_LIST* head = containingRecord(handleData->waitingToSend.Flink, IOTHUB_MESSAGE_LIST, entry);
+        result = (messageTimeout->send_sequence >= head->send_sequence);
+    }
+    return result;
+}
+
+/*Codes_SRS_IOTHUBCLIENT_LL_02_044: [ Messages already delivered to IoTHubClientCore_LL shall not have their timeouts modified by a new call to IoTHubClientCore_LL_SetOption. ]*/
+/*returns 0 on success, any other value is error*/
+static int attach_ms_timesOutAfter(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_LIST *newEntry)
+{
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_007: [ Every message added to waitingToSend shall be stamped with a sequence number one greater than the previous message's. ]*/
+    newEntry->send_sequence = handleData->nextSendSequence;
+
+    int result;
+    /*Codes_SRS_IOTHUBCLIENT_LL_02_043: [ Calling IoTHubClientCore_LL_SetOption with value set to "0" shall disable the timeout mechanism for all new messages. ]*/
+    if (handleData->currentMessageTimeout == 0)
+    {
+        newEntry->ms_timesOutAfter = 0; /*do not timeout*/
+        newEntry->message_timeout_value = 0;
+        result = 0;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_02_039: [ "messageTimeout" - once IoTHubClientCore_LL_SendEventAsync is called the message shall timeout after value miliseconds. Value is a pointer to a tickcounter_ms_t. ]*/
+        if (tickcounter_get_current_ms(handleData->tickCounter, &newEntry->ms_timesOutAfter) != 0)
+        {
+            result = __FAILURE__;
+            LogError("unable to get the current relative tickcount");
+        }
+        else
+        {
+            newEntry->message_timeout_value = handleData->currentMessageTimeout;
+            result = 0;
+        }
+    }
+    return result;
+}
+
+/*a message that was not queued goes back to the caller when ownership was being transferred*/
+static void destroy_unqueued_message(IOTHUB_MESSAGE_HANDLE messageHandle, bool takeOwnership)
+{
+    if (!takeOwnership)
+    {
+        IoTHubMessage_Destroy(messageHandle);
+    }
+}
+
+/*counts the events in waitingToSend, stopping at limit*/
+static size_t count_waiting_to_send(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, size_t limit)
+{
+    size_t result = 0;
+    PDLIST_ENTRY entry = handleData->waitingToSend.Flink;
+
+    while ((result < limit) && (entry != &(handleData->waitingToSend)))
+    {
+        result++;
+        entry = entry->Flink;
+    }
+
+    return result;
+}
+
+static bool should_spill_event(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData)
+{
+    /*once anything is spilled new events follow it, so they are still sent in order*/
+    return (handleData->spillQueue != NULL) &&
+        (!spill_queue_is_empty(handleData->spillQueue) || (count_waiting_to_send(handleData, handleData->spillThreshold) >= handleData->spillThreshold));
+}
+
+/*fills in everything a record needs once it is certain to be queued; its send_sequence must already be set*/
+static void stamp_queued_event(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_LIST* newEntry, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback, size_t payloadSize, size_t spillGeneration)
+{
+    handleData->nextSendSequence++;
+    newEntry->callback = eventConfirmationCallback;
+    newEntry->context = userContextCallback;
+    newEntry->published_stamped = false;
+    newEntry->pending_size = payloadSize;
+    handleData->pendingBytes += payloadSize;
+    newEntry->spill_generation = spillGeneration;
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_128: [ Every queued event shall count its record and its payload in IOTHUB_CLIENT_MEMORY_MESSAGE_QUEUE of the memory counters of the client until it completes. ]*/
+    /*the payload is only measured already while OPTION_MAX_PENDING_BYTES is set, and is not worth measuring for counters that are not summed*/
+    newEntry->memory_size = sizeof(IOTHUB_MESSAGE_LIST) + ((handleData->maxPendingBytes > 0) ? payloadSize : (handleData->memoryCounters.registered ? get_event_payload_size(newEntry->messageHandle) : 0));
+    IOTHUB_CLIENT_MEMORY_ADD(&handleData->memoryCounters, IOTHUB_CLIENT_MEMORY_MESSAGE_QUEUE, newEntry->memory_size);
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_134: [ While the startup timeline is started, a queued event shall mark IOTHUB_CLIENT_STARTUP_FIRST_EVENT_QUEUED and an event completed with IOTHUB_CLIENT_CONFIRMATION_OK IOTHUB_CLIENT_STARTUP_FIRST_EVENT_CONFIRMED. ]*/
+    IOTHUB_CLIENT_STARTUP_MARK(IOTHUB_CLIENT_STARTUP_FIRST_EVENT_QUEUED);
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_017: [ While statistics are enabled, IoTHubClientCore_LL_SendEventAsync shall count the event as queued and stamp it with the current time. ]*/
+    if (handleData->statisticsEnabled)
+    {
+        handleData->statistics.events_queued++;
+        newEntry->enqueued_stamped = get_statistics_time(handleData, &newEntry->ms_enqueued);
+    }
+    else
+    {
+        newEntry->enqueued_stamped = false;
+    }
+    start_event_trace(handleData, newEntry);
+}
+
+static IOTHUB_CLIENT_RESULT queue_event(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback, bool takeOwnership, size_t payloadSize, size_t spillGeneration)
+{
+    IOTHUB_CLIENT_RESULT result;
+    IOTHUB_MESSAGE_LIST *newEntry;
+
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_010: [ IoTHubClientCore_LL_SendEventAsync shall take the IOTHUB_MESSAGE_LIST record from the pool when one is available and allocate it otherwise. ]*/
+    if ((newEntry = get_message_list(handleData)) == NULL)
+    {
+        result = IOTHUB_CLIENT_ERROR;
+        LOG_ERROR_RESULT;
+    }
+    else
+    {
+        if (attach_ms_timesOutAfter(handleData, newEntry) != 0)
+        {
+            result = IOTHUB_CLIENT_ERROR;
+            LOG_ERROR_RESULT;
+            release_message_list(handleData, newEntry);
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_02_013: [IoTHubClientCore_LL_SendEventAsync shall add the DLIST waitingToSend a new record cloning the information from eventMessageHandle, eventConfirmationCallback, userContextCallback.]*/
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_013: [ IoTHubClientCore_LL_SendEventAsync_TakeOwnership shall queue eventMessageHandle itself instead of a clone. ]*/
+            if ((newEntry->messageHandle = (takeOwnership ? eventMessageHandle : IoTHubMessage_Clone(eventMessageHandle))) == NULL)
+            {
+                result = IOTHUB_CLIENT_ERROR;
+                release_message_list(handleData, newEntry);
+                LOG_ERROR_RESULT;
+            }
+#ifndef DONT_USE_DIAGNOSTICS
+            else if (IoTHubClient_Diagnostic_AddIfNecessary(&handleData->diagnostic_setting, newEntry->messageHandle) != 0)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_02_014: [If cloning and/or adding the information/diagnostic fails for any reason, IoTHubClientCore_LL_SendEventAsync shall fail and return IOTHUB_CLIENT_ERROR.] */
+                result = IOTHUB_CLIENT_ERROR;
+                destroy_unqueued_message(newEntry->messageHandle, takeOwnership);
+                release_message_list(handleData, newEntry);
+                LOG_ERROR_RESULT;
+            }
+#endif /*DONT_USE_DIAGNOSTICS*/
+            else if ((newEntry->ms_timesOutAfter != 0) && (add_message_timeout(handleData, newEntry) != 0))
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_02_014: [If cloning and/or adding the information/diagnostic fails for any reason, IoTHubClientCore_LL_SendEventAsync shall fail and return IOTHUB_CLIENT_ERROR.] */
+                result = IOTHUB_CLIENT_ERROR;
+                destroy_unqueued_message(newEntry->messageHandle, takeOwnership);
+                release_message_list(handleData, newEntry);
+                LOG_ERROR_RESULT;
+            }
+            else
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_02_013: [IoTHubClientCore_LL_SendEventAsync shall add the DLIST waitingToSend a new record cloning the information from eventMessageHandle, eventConfirmationCallback, userContextCallback.]*/
+                stamp_queued_event(handleData, newEntry, eventConfirmationCallback, userContextCallback, payloadSize, spillGeneration);
+                if ((handleData->sendWindowPeriod == 0) && (handleData->eventRateLimit.refill_per_ms == 0))
                 {
-                    LogError("deviceId is not found");
-                    result = NULL;
+                    DList_InsertTailList(&(handleData->waitingToSend), &(newEntry->entry));
                 }
-                else if (!(
-                    ((!use_provisioning && !isx509found) && (config->deviceSasToken == NULL) ^ (config->deviceKey == NULL)) ||
-                    ((use_provisioning || isx509found) && (config->deviceSasToken == NULL) && (config->deviceKey == NULL))
-                    ))
+                else if ((handleData->sendWindowUrgentProperty != NULL) && (IoTHubMessage_GetProperty(newEntry->messageHandle, handleData->sendWindowUrgentProperty) != NULL))
                 {
-                    LogError("invalid combination of x509, provisioning, deviceSasToken and deviceKey");
-                    result = NULL;
+                    /*Codes_SRS_IOTHUBCLIENT_LL_41_110: [ If `send_window` is set and eventMessageHandle holds the urgent_property, IoTHubClientCore_LL_SendEventAsync shall move the held events to waitingToSend, oldest first, and then queue eventMessageHandle after them. ]*/
+                    release_held_events(handleData);
+                    DList_InsertTailList(&(handleData->waitingToSend), &(newEntry->entry));
                 }
                 else
                 {
-                    /* Codes_SRS_IOTHUBCLIENT_LL_12_011: [IoTHubClientCore_LL_CreateFromConnectionString shall call into the IoTHubClientCore_LL_Create API with the current structure and returns with the return value of it] */
-                    result = initialize_iothub_client(config, NULL, use_provisioning, STRING_c_str(moduleId));
-                    if (result == NULL)
+                    /*Codes_SRS_IOTHUBCLIENT_LL_41_109: [ If `send_window` is set, IoTHubClientCore_LL_SendEventAsync shall hold the event until the window opens instead of adding it to waitingToSend, and move all the held events to waitingToSend, oldest first, once max_held of them are held. ]*/
+                    /*Codes_SRS_IOTHUBCLIENT_LL_41_166: [ If `rate_limits` limits telemetry, IoTHubClientCore_LL_SendEventAsync shall hold the event instead of adding it to waitingToSend. ]*/
+                    if (handleData->heldEventCount == 0)
                     {
-                        LogError("IoTHubClientCore_LL_Create failed");
+                        handleData->heldSequenceStart = newEntry->send_sequence;
                     }
-                    else
+                    DList_InsertTailList(&(handleData->heldEvents), &(newEntry->entry));
+                    handleData->heldEventCount++;
+                    if ((handleData->sendWindowMaxHeld > 0) && (handleData->heldEventCount >= handleData->sendWindowMaxHeld))
                     {
-                        /*return as is*/
+                        release_held_events(handleData);
                     }
                 }
+                /*Codes_SRS_IOTHUBCLIENT_LL_02_015: [Otherwise IoTHubClientCore_LL_SendEventAsync shall succeed and return IOTHUB_CLIENT_OK.] */
+                result = IOTHUB_CLIENT_OK;
             }
-            if (deviceSasTokenString != NULL)
-                STRING_delete(deviceSasTokenString);
-            if (deviceKeyString != NULL)
-                STRING_delete(deviceKeyString);
-            if (deviceIdString != NULL)
-                STRING_delete(deviceIdString);
-            if (hostSuffixString != NULL)
-                STRING_delete(hostSuffixString);
-            if (hostNameString != NULL)
-                STRING_delete(hostNameString);
-            if (valueString != NULL)
-                STRING_delete(valueString);
-            if (tokenString != NULL)
-                STRING_delete(tokenString);
-            if (connString != NULL)
-                STRING_delete(connString);
-            if (protocolGateway != NULL)
-                STRING_delete(protocolGateway);
-            if (moduleId != NULL)
-                STRING_delete(moduleId);
-
-            if (tokenizer1 != NULL)
-                STRING_TOKENIZER_destroy(tokenizer1);
-
-            free(config);
         }
     }
     return result;
 }
 
-IOTHUB_CLIENT_CORE_LL_HANDLE IoTHubClientCore_LL_CreateImpl(const IOTHUB_CLIENT_CONFIG* config, const char* module_id, bool use_dev_auth)
+static bool is_event_suppressed(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_HANDLE eventMessageHandle)
 {
-    IOTHUB_CLIENT_CORE_LL_HANDLE result;
-    /*Codes_SRS_IOTHUBCLIENT_LL_02_001: [IoTHubClientCore_LL_Create shall return NULL if config parameter is NULL or protocol field is NULL.]*/
-    if(
-        (config == NULL) ||
-        (config->protocol == NULL)
+    tickcounter_ms_t nowTick;
+    return (handleData->reportByException != NULL) &&
+        (tickcounter_get_current_ms(handleData->tickCounter, &nowTick) == 0) &&
+        report_by_exception_is_suppressed(handleData->reportByException, eventMessageHandle, nowTick);
+}
+
+static IOTHUB_CLIENT_RESULT send_event_async(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback, bool takeOwnership)
+{
+    IOTHUB_CLIENT_RESULT result;
+    /*Codes_SRS_IOTHUBCLIENT_LL_02_011: [IoTHubClientCore_LL_SendEventAsync shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter iotHubClientHandle or eventMessageHandle is NULL.]*/
+    if (
+        (iotHubClientHandle == NULL) ||
+        (eventMessageHandle == NULL) ||
+        /*Codes_SRS_IOTHUBCLIENT_LL_02_012: [IoTHubClientCore_LL_SendEventAsync shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter eventConfirmationCallback is NULL and userContextCallback is not NULL.] */
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_006: [ If a batch confirmation callback is set, IoTHubClientCore_LL_SendEventAsync shall accept a NULL eventConfirmationCallback with a non-NULL userContextCallback. ]*/
+        ((eventConfirmationCallback == NULL) && (userContextCallback != NULL) && (iotHubClientHandle->eventConfirmationBatchCallback == NULL))
         )
     {
-        result = NULL;
-        LogError("invalid configuration (NULL detected)");
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LOG_ERROR_RESULT;
     }
-    else
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_105: [ If OPTION_REPORT_BY_EXCEPTION is set and eventMessageHandle holds no news, IoTHubClientCore_LL_SendEventAsync shall record its confirmation instead of queuing it and succeed, destroying eventMessageHandle if it took it; it shall return IOTHUB_CLIENT_ERROR if the confirmation cannot be recorded. ]*/
+    else if (is_event_suppressed(iotHubClientHandle, eventMessageHandle))
     {
-        IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = initialize_iothub_client(config, NULL, use_dev_auth, module_id);
-        if (handleData == NULL)
+        result = suppress_event(iotHubClientHandle, eventMessageHandle, eventConfirmationCallback, userContextCallback, takeOwnership);
+    }
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_028: [ If a spill directory is set and the spill log is not empty or waitingToSend holds OPTION_SPILL_THRESHOLD events, IoTHubClientCore_LL_SendEventAsync shall append eventMessageHandle to the spill log instead of queuing it, and return IOTHUB_CLIENT_ERROR if it cannot be written. ]*/
+    else if (should_spill_event(iotHubClientHandle))
+    {
+        if (spill_queue_push_message(iotHubClientHandle->spillQueue, eventMessageHandle, eventConfirmationCallback, userContextCallback) != 0)
         {
-            LogError("initialize iothub client");
-            result = NULL;
+            result = IOTHUB_CLIENT_ERROR;
+            LOG_ERROR_RESULT;
         }
         else
         {
-            result = handleData;
+            /*the spill log has its own copy*/
+            if (takeOwnership)
+            {
+                IoTHubMessage_Destroy(eventMessageHandle);
+            }
+            result = IOTHUB_CLIENT_OK;
         }
     }
+    else
+    {
+        /*the payload is only measured while a limit is set*/
+        size_t payloadSize = (iotHubClientHandle->maxPendingBytes > 0) ? get_event_payload_size(eventMessageHandle) : 0;
 
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_025: [ If OPTION_MAX_PENDING_BYTES is set and queuing eventMessageHandle would take the payload bytes of the events not yet completed above it, IoTHubClientCore_LL_SendEventAsync shall fail and return IOTHUB_CLIENT_ERROR without queuing it. ]*/
+        if ((iotHubClientHandle->maxPendingBytes > 0) && ((iotHubClientHandle->pendingBytes > iotHubClientHandle->maxPendingBytes) || (payloadSize > iotHubClientHandle->maxPendingBytes - iotHubClientHandle->pendingBytes)))
+        {
+            LogError("Event of %lu bytes rejected, %lu of the %lu pending bytes allowed are in use", (unsigned long)payloadSize, (unsigned long)iotHubClientHandle->pendingBytes, (unsigned long)iotHubClientHandle->maxPendingBytes);
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else
+        {
+            result = queue_event(iotHubClientHandle, eventMessageHandle, eventConfirmationCallback, userContextCallback, takeOwnership, payloadSize, 0);
+        }
+    }
     return result;
 }
 
-IOTHUB_CLIENT_CORE_LL_HANDLE IoTHubClientCore_LL_Create(const IOTHUB_CLIENT_CONFIG* config)
+IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SendEventAsync(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
 {
-    return IoTHubClientCore_LL_CreateImpl(config, NULL, false);
+    return send_event_async(iotHubClientHandle, eventMessageHandle, eventConfirmationCallback, userContextCallback, false);
 }
 
-#ifdef USE_EDGE_MODULES
-IOTHUB_CLIENT_CORE_LL_HANDLE IoTHubClientCore_LL_CreateFromEnvironment(IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol)
+IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SendEventAsync_TakeOwnership(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
 {
-    IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* result;
-    EDGE_ENVIRONMENT_VARIABLES edge_environment_variables;
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_014: [ If IoTHubClientCore_LL_SendEventAsync_TakeOwnership fails, eventMessageHandle shall still belong to the caller. ]*/
+    return send_event_async(iotHubClientHandle, eventMessageHandle, eventConfirmationCallback, userContextCallback, true);
+}
 
-    memset(&edge_environment_variables, 0, sizeof(edge_environment_variables));
+IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SendSmallEvent(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, const unsigned char* payload, size_t size, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    IOTHUB_CLIENT_RESULT result;
+    SMALL_EVENT_SLOT* slot;
+    IOTHUB_MESSAGE_HANDLE message;
 
-    if (retrieve_edge_environment_variabes(&edge_environment_variables) != 0)
-    {
-        LogError("retrieve_edge_environment_variabes failed");
-        result = NULL;
-    }
-    // The presence of a connection string environment variable means we use it, ignoring other settings
-    else if (edge_environment_variables.connection_string != NULL)
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_155: [ IoTHubClientCore_LL_SendSmallEvent shall fail and return IOTHUB_CLIENT_INVALID_ARG if iotHubClientHandle is NULL, payload is NULL and size is not 0, or size is larger than IOTHUB_CLIENT_SMALL_EVENT_MAX_SIZE. ]*/
+    if ((iotHubClientHandle == NULL) || ((payload == NULL) && (size != 0)) || (size > IOTHUB_CLIENT_SMALL_EVENT_MAX_SIZE))
     {
-        if ((result = IoTHubClientCore_LL_CreateFromConnectionString(edge_environment_variables.connection_string, protocol)) == NULL)
-        {
-            LogError("IoTHubClientCore_LL_CreateFromConnectionString fails");
-        }
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LogError("Invalid argument iotHubClientHandle=%p, payload=%p, size=%lu", iotHubClientHandle, payload, (unsigned long)size);
     }
-    else if (iothub_security_init(IOTHUB_SECURITY_TYPE_HTTP_EDGE) != 0)
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_156: [ IoTHubClientCore_LL_SendSmallEvent shall fail and return IOTHUB_CLIENT_ERROR if no slot set by OPTION_SMALL_EVENT_SLOTS is free. ]*/
+    else if ((slot = iotHubClientHandle->freeSmallEventSlots) == NULL)
     {
-        LogError("iothub_security_init failed");
-        result = NULL;
+        result = IOTHUB_CLIENT_ERROR;
+        LogError("No small event slot is free, %lu of %lu in flight", (unsigned long)iotHubClientHandle->smallEventSlotsInUse, (unsigned long)iotHubClientHandle->smallEventSlotCount);
     }
     else
     {
-        IOTHUB_CLIENT_CONFIG client_config;
-
-        memset(&client_config, 0, sizeof(client_config));
-        client_config.protocol = protocol;
-        client_config.deviceId = edge_environment_variables.device_id;
-        client_config.iotHubName = edge_environment_variables.iothub_name;
-        client_config.iotHubSuffix = edge_environment_variables.iothub_suffix;
-        client_config.protocolGatewayHostName = edge_environment_variables.gatewayhostname;
-
-        if ((result = IoTHubClientCore_LL_CreateImpl(&client_config, edge_environment_variables.module_id, true)) == NULL)
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_157: [ IoTHubClientCore_LL_SendSmallEvent shall copy payload into a free slot and send, like IoTHubClientCore_LL_SendEventAsync_TakeOwnership, a message created with IoTHubMessage_CreateFromByteArrayNoCopy over the slot, so neither the payload nor a clone of the message is allocated. ]*/
+        if (size > 0)
         {
-            LogError("IoTHubClientCore_LL_CreateImpl fails");
+            (void)memcpy(slot->payload, payload, size);
         }
-    }
 
-    if (result != NULL)
-    {
-        // Because the Edge Hub almost always use self-signed certificates, we need to specify which certificates to trust.  We need to do 
-        // this regardless of how we created the underlying IOTHUB_CLIENT_CORE_LL_HANDLE_DATA.
-        IOTHUB_CLIENT_RESULT setTrustResult;
-        char* trustedCertificate = IoTHubClient_Auth_Get_TrustBundle(result->authorization_module, edge_environment_variables.ca_trusted_certificate_file);
-        
-        if (trustedCertificate == NULL)
+        if ((message = IoTHubMessage_CreateFromByteArrayNoCopy(slot->payload, size, release_small_event_slot, slot)) == NULL)
         {
-            LogError("IoTHubClient_Auth_Get_TrustBundle failed");
-            IoTHubClientCore_LL_Destroy(result);
-            result = NULL;
+            result = IOTHUB_CLIENT_ERROR;
+            LogError("Failure creating the small event message");
         }
-        else if ((setTrustResult = IoTHubClientCore_LL_SetOption(result, OPTION_TRUSTED_CERT, trustedCertificate)) != IOTHUB_CLIENT_OK)
+        else
         {
-            LogError("IoTHubClientCore_LL_SetOption failed, err = %d", setTrustResult);
-            IoTHubClientCore_LL_Destroy(result);
-            result = NULL;
+            iotHubClientHandle->freeSmallEventSlots = slot->nextFree;
+            iotHubClientHandle->smallEventSlotsInUse++;
+
+            if ((result = send_event_async(iotHubClientHandle, message, eventConfirmationCallback, userContextCallback, true)) != IOTHUB_CLIENT_OK)
+            {
+                /*gives the slot back*/
+                IoTHubMessage_Destroy(message);
+            }
         }
-        
-        free(trustedCertificate);
     }
 
-    free(edge_environment_variables.iothub_buffer);
     return result;
 }
-#endif
 
+/*aggregated events are queued like any other event, without a confirmation callback*/
+static int send_aggregated_event(IOTHUB_MESSAGE_HANDLE message, void* context)
+{
+    return (send_event_async((IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)context, message, NULL, NULL, true) == IOTHUB_CLIENT_OK) ? 0 : __FAILURE__;
+}
 
-IOTHUB_CLIENT_CORE_LL_HANDLE IoTHubClientCore_LL_CreateWithTransport(const IOTHUB_CLIENT_DEVICE_CONFIG * config)
+IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SendTelemetrySample(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, const char* outputName, double value)
 {
-    IOTHUB_CLIENT_CORE_LL_HANDLE result;
-    /*Codes_SRS_IOTHUBCLIENT_LL_17_001: [IoTHubClientCore_LL_CreateWithTransport shall return NULL if config parameter is NULL, or protocol field is NULL or transportHandle is NULL.]*/
-    if (
-        (config == NULL) ||
-        (config->protocol == NULL) ||
-        (config->transportHandle == NULL) ||
-        /*Codes_SRS_IOTHUBCLIENT_LL_02_098: [ IoTHubClientCore_LL_CreateWithTransport shall fail and return NULL if both config->deviceKey AND config->deviceSasToken are NULL. ]*/
-        ((config->deviceKey == NULL) && (config->deviceSasToken == NULL))
-        )
+    IOTHUB_CLIENT_RESULT result;
+    tickcounter_ms_t nowTick;
+
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_100: [ IoTHubClientCore_LL_SendTelemetrySample shall fail and return IOTHUB_CLIENT_INVALID_ARG if iotHubClientHandle is NULL or OPTION_TELEMETRY_AGGREGATION was never set. ]*/
+    if ((iotHubClientHandle == NULL) || (iotHubClientHandle->telemetryAggregation == NULL))
     {
-        result = NULL;
-        LogError("invalid configuration (NULL detected)");
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LOG_ERROR_RESULT;
+    }
+    else if (tickcounter_get_current_ms(iotHubClientHandle->tickCounter, &nowTick) != 0)
+    {
+        result = IOTHUB_CLIENT_ERROR;
+        LOG_ERROR_RESULT;
+    }
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_101: [ IoTHubClientCore_LL_SendTelemetrySample shall fold value into the window of outputName open now, and queue an event holding value at once if it is outside the anomaly bounds of outputName; it shall return IOTHUB_CLIENT_ERROR if outputName has no aggregation or that event cannot be queued. ]*/
+    else if (telemetry_aggregation_add_sample(iotHubClientHandle->telemetryAggregation, outputName, nowTick, value, send_aggregated_event, iotHubClientHandle) != 0)
+    {
+        result = IOTHUB_CLIENT_ERROR;
+        LOG_ERROR_RESULT;
     }
     else
     {
-        result = initialize_iothub_client(NULL, config, false, NULL);
+        result = IOTHUB_CLIENT_OK;
     }
+
     return result;
 }
 
-void IoTHubClientCore_LL_Destroy(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle)
+static void on_event_batch_confirmation(IOTHUB_CLIENT_CONFIRMATION_RESULT result, void* userContextCallback)
 {
-    /*Codes_SRS_IOTHUBCLIENT_LL_02_009: [IoTHubClientCore_LL_Destroy shall do nothing if parameter iotHubClientHandle is NULL.]*/
-    if (iotHubClientHandle != NULL)
+    EVENT_BATCH_CONFIRMATION* batch = (EVENT_BATCH_CONFIRMATION*)userContextCallback;
+
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_099: [ Once every event of the batch has completed, eventConfirmationCallback shall be called once with IOTHUB_CLIENT_CONFIRMATION_OK if they all succeeded and with the first other result otherwise. ]*/
+    if ((result != IOTHUB_CLIENT_CONFIRMATION_OK) && (batch->result == IOTHUB_CLIENT_CONFIRMATION_OK))
     {
-        PDLIST_ENTRY unsend;
-        /*Codes_SRS_IOTHUBCLIENT_LL_17_010: [IoTHubClientCore_LL_Destroy  shall call the underlaying layer's _Unregister function] */
-        IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)iotHubClientHandle;
-        handleData->IoTHubTransport_Unregister(handleData->deviceHandle);
-        if (handleData->isSharedTransport == false)
-        {
-            /*Codes_SRS_IOTHUBCLIENT_LL_02_010: [If iotHubClientHandle was not created by IoTHubClientCore_LL_CreateWithTransport, IoTHubClientCore_LL_Destroy  shall call the underlaying layer's _Destroy function.] */
-            handleData->IoTHubTransport_Destroy(handleData->transportHandle);
-        }
-        /*if any, remove the items currently not send*/
-        while ((unsend = DList_RemoveHeadList(&(handleData->waitingToSend))) != &(handleData->waitingToSend))
-        {
-            IOTHUB_MESSAGE_LIST* temp = containingRecord(unsend, IOTHUB_MESSAGE_LIST, entry);
-            /*Codes_SRS_IOTHUBCLIENT_LL_02_033: [Otherwise, IoTHubClientCore_LL_Destroy shall complete all the event message callbacks that are in the waitingToSend list with the result IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY.] */
-            if (temp->callback != NULL)
-            {
-                temp->callback(IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY, temp->context);
-            }
-            IoTHubMessage_Destroy(temp->messageHandle);
-            free(temp);
-        }
+        batch->result = result;
+    }
 
-        /* Codes_SRS_IOTHUBCLIENT_LL_07_007: [ IoTHubClientCore_LL_Destroy shall iterate the device twin queues and destroy any remaining items. ] */
-        while ((unsend = DList_RemoveHeadList(&(handleData->iot_msg_queue))) != &(handleData->iot_msg_queue))
-        {
-            IOTHUB_DEVICE_TWIN* temp = containingRecord(unsend, IOTHUB_DEVICE_TWIN, entry);
-            device_twin_data_destroy(temp);
-        }
-        while ((unsend = DList_RemoveHeadList(&(handleData->iot_ack_queue))) != &(handleData->iot_ack_queue))
-        {
-            IOTHUB_DEVICE_TWIN* temp = containingRecord(unsend, IOTHUB_DEVICE_TWIN, entry);
-            device_twin_data_destroy(temp);
-        }
+    if (--batch->pending == 0)
+    {
+        batch->callback(batch->result, batch->userContextCallback);
+        free(batch);
+    }
+}
 
-        /* Codes_SRS_IOTHUBCLIENT_LL_31_141: [ IoTHubClient_LL_Destroy shall iterate registered callbacks for input queues and destroy any remaining items. ] */
-        delete_event_callback_list(handleData);
+static bool is_event_batch_valid(IOTHUB_MESSAGE_HANDLE* eventMessageHandles, size_t eventMessageCount)
+{
+    bool result = true;
+    size_t index;
 
-        /*Codes_SRS_IOTHUBCLIENT_LL_17_011: [IoTHubClientCore_LL_Destroy  shall free the resources allocated by IoTHubClient (if any).] */
-        IoTHubClient_Auth_Destroy(handleData->authorization_module);
-        tickcounter_destroy(handleData->tickCounter);
-#ifndef DONT_USE_UPLOADTOBLOB
-        IoTHubClient_LL_UploadToBlob_Destroy(handleData->uploadToBlobHandle);
-#endif
-#ifdef USE_EDGE_MODULES
-        IoTHubClient_EdgeHandle_Destroy(handleData->methodHandle);
-#endif
-        STRING_delete(handleData->product_info);
-        free(handleData);
+    for (index = 0; (index < eventMessageCount) && result; index++)
+    {
+        if (eventMessageHandles[index] == NULL)
+        {
+            LogError("message %lu of the batch is NULL", (unsigned long)index);
+            result = false;
+        }
     }
+
+    return result;
 }
 
-/*Codes_SRS_IOTHUBCLIENT_LL_02_044: [ Messages already delivered to IoTHubClientCore_LL shall not have their timeouts modified by a new call to IoTHubClientCore_LL_SetOption. ]*/
-/*returns 0 on success, any other value is error*/
-static int attach_ms_timesOutAfter(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_LIST *newEntry)
+static void discard_event_batch(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, PDLIST_ENTRY batchList)
 {
-    int result;
-    /*Codes_SRS_IOTHUBCLIENT_LL_02_043: [ Calling IoTHubClientCore_LL_SetOption with value set to "0" shall disable the timeout mechanism for all new messages. ]*/
-    if (handleData->currentMessageTimeout == 0)
+    PDLIST_ENTRY prepared;
+    while ((prepared = DList_RemoveHeadList(batchList)) != batchList)
     {
-        newEntry->ms_timesOutAfter = 0; /*do not timeout*/
-        newEntry->message_timeout_value = 0;
-        result = 0;
+        IOTHUB_MESSAGE_LIST* messageList = containingRecord(prepared, IOTHUB_MESSAGE_LIST, entry);
+        IoTHubMessage_Destroy(messageList->messageHandle);
+        release_message_list(handleData, messageList);
     }
-    else
+}
+
+/*clones every message of the batch into a record of "batchList" and adds up their payload, returns 0 on success; on failure nothing is left in "batchList".
+With "outputNames", the single message of "eventMessageHandles" is cloned once for each of the "recordCount" outputs instead*/
+static int prepare_event_batch(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_HANDLE* eventMessageHandles, const char* const* outputNames, size_t recordCount, PDLIST_ENTRY batchList, size_t* payloadSize)
+{
+    int result = 0;
+    size_t index;
+
+    *payloadSize = 0;
+    for (index = 0; (index < recordCount) && (result == 0); index++)
     {
-        /*Codes_SRS_IOTHUBCLIENT_LL_02_039: [ "messageTimeout" - once IoTHubClientCore_LL_SendEventAsync is called the message shall timeout after value miliseconds. Value is a pointer to a tickcounter_ms_t. ]*/
-        if (tickcounter_get_current_ms(handleData->tickCounter, &newEntry->ms_timesOutAfter) != 0)
+        IOTHUB_MESSAGE_HANDLE source = eventMessageHandles[(outputNames == NULL) ? index : 0];
+        IOTHUB_MESSAGE_LIST* newEntry;
+
+        if ((newEntry = get_message_list(handleData)) == NULL)
+        {
+            LogError("unable to allocate a record for message %lu of the batch", (unsigned long)index);
+            result = __FAILURE__;
+        }
+        else if ((newEntry->messageHandle = IoTHubMessage_Clone(source)) == NULL)
         {
+            LogError("unable to clone message %lu of the batch", (unsigned long)index);
+            release_message_list(handleData, newEntry);
+            result = __FAILURE__;
+        }
+        else if ((outputNames != NULL) && (IoTHubMessage_SetOutputName(newEntry->messageHandle, outputNames[index]) != IOTHUB_MESSAGE_OK))
+        {
+            LogError("unable to set output %s on the message", outputNames[index]);
+            IoTHubMessage_Destroy(newEntry->messageHandle);
+            release_message_list(handleData, newEntry);
+            result = __FAILURE__;
+        }
+#ifndef DONT_USE_DIAGNOSTICS
+        else if (IoTHubClient_Diagnostic_AddIfNecessary(&handleData->diagnostic_setting, newEntry->messageHandle) != 0)
+        {
+            LogError("unable to add diagnostic information to message %lu of the batch", (unsigned long)index);
+            IoTHubMessage_Destroy(newEntry->messageHandle);
+            release_message_list(handleData, newEntry);
             result = __FAILURE__;
-            LogError("unable to get the current relative tickcount");
         }
+#endif /*DONT_USE_DIAGNOSTICS*/
         else
         {
-            newEntry->message_timeout_value = handleData->currentMessageTimeout;
-            result = 0;
+            /*the payload is only measured while a limit is set*/
+            newEntry->pending_size = (handleData->maxPendingBytes > 0) ? get_event_payload_size(source) : 0;
+            *payloadSize = (newEntry->pending_size > SIZE_MAX - *payloadSize) ? SIZE_MAX : *payloadSize + newEntry->pending_size;
+            DList_InsertTailList(batchList, &(newEntry->entry));
         }
     }
+
+    if (result != 0)
+    {
+        discard_event_batch(handleData, batchList);
+    }
+
     return result;
 }
 
-IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SendEventAsync(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+/*queues the records of the batch (or, with "outputNames", of the fan out of eventMessageHandles[0]) all or none, behind a single confirmation*/
+static IOTHUB_CLIENT_RESULT send_event_batch(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* iotHubClientHandle, IOTHUB_MESSAGE_HANDLE* eventMessageHandles, const char* const* outputNames, size_t eventMessageCount, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
 {
     IOTHUB_CLIENT_RESULT result;
-    /*Codes_SRS_IOTHUBCLIENT_LL_02_011: [IoTHubClientCore_LL_SendEventAsync shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter iotHubClientHandle or eventMessageHandle is NULL.]*/
-    if (
-        (iotHubClientHandle == NULL) ||
-        (eventMessageHandle == NULL) ||
-        /*Codes_SRS_IOTHUBCLIENT_LL_02_012: [IoTHubClientCore_LL_SendEventAsync shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter eventConfirmationCallback is NULL and userContextCallback is not NULL.] */
-        ((eventConfirmationCallback == NULL) && (userContextCallback != NULL))
-        )
+    size_t payloadSize;
+    tickcounter_ms_t nowTick = 0;
+    EVENT_BATCH_CONFIRMATION* batch = NULL;
+
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_094: [ If events are being spilled, IoTHubClientCore_LL_SendEventBatchAsync shall fail and return IOTHUB_CLIENT_ERROR without queuing any of the messages. ]*/
+    if (should_spill_event(iotHubClientHandle))
     {
-        result = IOTHUB_CLIENT_INVALID_ARG;
+        LogError("a batch cannot be queued while events are being spilled");
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    /*the timeouts are reserved up front so that nothing can fail once the first record is queued*/
+    else if ((iotHubClientHandle->currentMessageTimeout != 0) &&
+        ((tickcounter_get_current_ms(iotHubClientHandle->tickCounter, &nowTick) != 0) || (reserve_message_timeouts(iotHubClientHandle, eventMessageCount) != 0)))
+    {
+        result = IOTHUB_CLIENT_ERROR;
+        LOG_ERROR_RESULT;
+    }
+    else if ((eventConfirmationCallback != NULL) && ((batch = (EVENT_BATCH_CONFIRMATION*)malloc(sizeof(EVENT_BATCH_CONFIRMATION))) == NULL))
+    {
+        result = IOTHUB_CLIENT_ERROR;
         LOG_ERROR_RESULT;
     }
     else
     {
-        IOTHUB_MESSAGE_LIST *newEntry = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST));
-        if (newEntry == NULL)
+        DLIST_ENTRY batchList;
+        DList_InitializeListHead(&batchList);
+
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_096: [ IoTHubClientCore_LL_SendEventBatchAsync shall clone every message of the batch; if any of them cannot be prepared it shall fail, return IOTHUB_CLIENT_ERROR and queue none of them. ]*/
+        if (prepare_event_batch(iotHubClientHandle, eventMessageHandles, outputNames, eventMessageCount, &batchList, &payloadSize) != 0)
         {
             result = IOTHUB_CLIENT_ERROR;
             LOG_ERROR_RESULT;
+            free(batch);
+        }
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_095: [ If OPTION_MAX_PENDING_BYTES is set and queuing the whole batch would take the pending payload bytes above it, IoTHubClientCore_LL_SendEventBatchAsync shall fail and return IOTHUB_CLIENT_ERROR without queuing any of the messages. ]*/
+        else if ((iotHubClientHandle->maxPendingBytes > 0) && ((iotHubClientHandle->pendingBytes > iotHubClientHandle->maxPendingBytes) || (payloadSize > iotHubClientHandle->maxPendingBytes - iotHubClientHandle->pendingBytes)))
+        {
+            LogError("Batch of %lu bytes rejected, %lu of the %lu pending bytes allowed are in use", (unsigned long)payloadSize, (unsigned long)iotHubClientHandle->pendingBytes, (unsigned long)iotHubClientHandle->maxPendingBytes);
+            result = IOTHUB_CLIENT_ERROR;
+            discard_event_batch(iotHubClientHandle, &batchList);
+            free(batch);
         }
         else
         {
-            IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)iotHubClientHandle;
+            PDLIST_ENTRY entry;
 
-            if (attach_ms_timesOutAfter(handleData, newEntry) != 0)
+            if (batch != NULL)
             {
-                result = IOTHUB_CLIENT_ERROR;
-                LOG_ERROR_RESULT;
-                free(newEntry);
+                batch->callback = eventConfirmationCallback;
+                batch->userContextCallback = userContextCallback;
+                batch->pending = eventMessageCount;
+                batch->result = IOTHUB_CLIENT_CONFIRMATION_OK;
             }
-            else
+
+            for (entry = batchList.Flink; entry != &batchList; entry = entry->Flink)
             {
-                /*Codes_SRS_IOTHUBCLIENT_LL_02_013: [IoTHubClientCore_LL_SendEventAsync shall add the DLIST waitingToSend a new record cloning the information from eventMessageHandle, eventConfirmationCallback, userContextCallback.]*/
-                if ((newEntry->messageHandle = IoTHubMessage_Clone(eventMessageHandle)) == NULL)
-                {
-                    result = IOTHUB_CLIENT_ERROR;
-                    free(newEntry);
-                    LOG_ERROR_RESULT;
-                }
-                else if (IoTHubClient_Diagnostic_AddIfNecessary(&handleData->diagnostic_setting, newEntry->messageHandle) != 0)
-                {
-                    /*Codes_SRS_IOTHUBCLIENT_LL_02_014: [If cloning and/or adding the information/diagnostic fails for any reason, IoTHubClientCore_LL_SendEventAsync shall fail and return IOTHUB_CLIENT_ERROR.] */
-                    result = IOTHUB_CLIENT_ERROR;
-                    IoTHubMessage_Destroy(newEntry->messageHandle);
-                    free(newEntry);
-                    LOG_ERROR_RESULT;
-                }
-                else
+                IOTHUB_MESSAGE_LIST* newEntry = containingRecord(entry, IOTHUB_MESSAGE_LIST, entry);
+
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_007: [ Every message added to waitingToSend shall be stamped with a sequence number one greater than the previous message's. ]*/
+                newEntry->send_sequence = iotHubClientHandle->nextSendSequence;
+                newEntry->ms_timesOutAfter = nowTick;
+                newEntry->message_timeout_value = iotHubClientHandle->currentMessageTimeout;
+                if (newEntry->ms_timesOutAfter != 0)
                 {
-                    /*Codes_SRS_IOTHUBCLIENT_LL_02_013: [IoTHubClientCore_LL_SendEventAsync shall add the DLIST waitingToSend a new record cloning the information from eventMessageHandle, eventConfirmationCallback, userContextCallback.]*/
-                    newEntry->callback = eventConfirmationCallback;
-                    newEntry->context = userContextCallback;
-                    DList_InsertTailList(&(iotHubClientHandle->waitingToSend), &(newEntry->entry));
-                    /*Codes_SRS_IOTHUBCLIENT_LL_02_015: [Otherwise IoTHubClientCore_LL_SendEventAsync shall succeed and return IOTHUB_CLIENT_OK.] */
-                    result = IOTHUB_CLIENT_OK;
+                    (void)add_message_timeout(iotHubClientHandle, newEntry); /*cannot fail, room was reserved*/
                 }
+                stamp_queued_event(iotHubClientHandle, newEntry, (batch == NULL) ? NULL : on_event_batch_confirmation, batch, newEntry->pending_size, 0);
+            }
+
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_111: [ IoTHubClientCore_LL_SendEventBatchAsync shall move the events held by `send_window` to waitingToSend, oldest first, before the batch. ]*/
+            if (iotHubClientHandle->heldEventCount > 0)
+            {
+                release_held_events(iotHubClientHandle);
             }
+
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_097: [ IoTHubClientCore_LL_SendEventBatchAsync shall append all the records to waitingToSend at once, in the order of eventMessageHandles, so that the transport can send them together. ]*/
+            DList_AppendTailList(&(iotHubClientHandle->waitingToSend), &batchList);
+            DList_RemoveEntryList(&batchList);
+
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_098: [ Otherwise IoTHubClientCore_LL_SendEventBatchAsync shall succeed and return IOTHUB_CLIENT_OK. ]*/
+            result = IOTHUB_CLIENT_OK;
         }
     }
+
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SendEventBatchAsync(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE* eventMessageHandles, size_t eventMessageCount, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_093: [ IoTHubClientCore_LL_SendEventBatchAsync shall fail and return IOTHUB_CLIENT_INVALID_ARG if iotHubClientHandle or eventMessageHandles is NULL, eventMessageCount is 0, any of the messages is NULL, or eventConfirmationCallback is NULL and userContextCallback is not. ]*/
+    if ((iotHubClientHandle == NULL) || (eventMessageHandles == NULL) || (eventMessageCount == 0) ||
+        ((eventConfirmationCallback == NULL) && (userContextCallback != NULL)))
+    {
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LOG_ERROR_RESULT;
+    }
+    else if (!is_event_batch_valid(eventMessageHandles, eventMessageCount))
+    {
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LOG_ERROR_RESULT;
+    }
+    else
+    {
+        result = send_event_batch(iotHubClientHandle, eventMessageHandles, NULL, eventMessageCount, eventConfirmationCallback, userContextCallback);
+    }
+
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SendEventToRoutesAsync(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    IOTHUB_CLIENT_RESULT result;
+    const char* const* outputNames;
+    size_t outputCount;
+
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_161: [ IoTHubClientCore_LL_SendEventToRoutesAsync shall fail and return IOTHUB_CLIENT_INVALID_ARG if iotHubClientHandle or eventMessageHandle is NULL, eventConfirmationCallback is NULL and userContextCallback is not, or OPTION_OUTPUT_ROUTE was never set. ]*/
+    if ((iotHubClientHandle == NULL) || (eventMessageHandle == NULL) || (iotHubClientHandle->outputRouting == NULL) ||
+        ((eventConfirmationCallback == NULL) && (userContextCallback != NULL)))
+    {
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LOG_ERROR_RESULT;
+    }
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_162: [ IoTHubClientCore_LL_SendEventToRoutesAsync shall evaluate the routes once against the application properties of eventMessageHandle, and fail and return IOTHUB_CLIENT_ERROR if none matches. ]*/
+    else if ((outputCount = output_routing_evaluate(iotHubClientHandle->outputRouting, eventMessageHandle, &outputNames)) == 0)
+    {
+        LogError("no route matches the message");
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_163: [ IoTHubClientCore_LL_SendEventToRoutesAsync shall queue a clone of eventMessageHandle, sharing its payload and properties, for each output of the matching routes, all or none, the same way as IoTHubClientCore_LL_SendEventBatchAsync, so that eventConfirmationCallback is called once for all of them. ]*/
+    else
+    {
+        result = send_event_batch(iotHubClientHandle, &eventMessageHandle, outputNames, outputCount, eventConfirmationCallback, userContextCallback);
+    }
+
     return result;
 }
 
@@ -1851,6 +4290,18 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SetMessageCallback(IOTHUB_CLIENT_CORE_L
                 LogError("Invalid workflow sequence. Please unsubscribe using the IoTHubClientCore_LL_SetMessageCallback_Ex function.");
                 result = IOTHUB_CLIENT_ERROR;
             }
+            else if (handleData->messageCallback.type == CALLBACK_TYPE_CHUNK)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_10_010: [If parameter messageCallback is NULL and the _SetMessageCallback had not been called to subscribe for messages, then IoTHubClientCore_LL_SetMessageCallback shall fail and return IOTHUB_CLIENT_ERROR.] */
+                LogError("Invalid workflow sequence. Please unsubscribe using the IoTHubClientCore_LL_SetMessageChunkCallback function.");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else if (handleData->messageCallback.type == CALLBACK_TYPE_BATCH)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_136: [ While a batch callback is set, IoTHubClientCore_LL_SetMessageCallback, IoTHubClientCore_LL_SetMessageCallback_Ex and IoTHubClientCore_LL_SetMessageChunkCallback shall fail and return IOTHUB_CLIENT_ERROR, and IoTHubClientCore_LL_SetMessageBatchCallback shall fail and return IOTHUB_CLIENT_ERROR while another message callback is set. ]*/
+                LogError("Invalid workflow sequence. Please unsubscribe using the IoTHubClientCore_LL_SetMessageBatchCallback function.");
+                result = IOTHUB_CLIENT_ERROR;
+            }
             else
             {
                 /*Codes_SRS_IOTHUBCLIENT_LL_02_019: [If parameter messageCallback is NULL then IoTHubClientCore_LL_SetMessageCallback shall call the underlying layer's _Unsubscribe function and return IOTHUB_CLIENT_OK.] */
@@ -1870,6 +4321,18 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SetMessageCallback(IOTHUB_CLIENT_CORE_L
                 LogError("Invalid workflow sequence. Please unsubscribe using the IoTHubClientCore_LL_SetMessageCallback_Ex function before subscribing with MessageCallback.");
                 result = IOTHUB_CLIENT_ERROR;
             }
+            else if (handleData->messageCallback.type == CALLBACK_TYPE_CHUNK)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_038: [ While a chunk callback is set, IoTHubClientCore_LL_SetMessageCallback and IoTHubClientCore_LL_SetMessageCallback_Ex shall fail and return IOTHUB_CLIENT_ERROR, and IoTHubClientCore_LL_SetMessageChunkCallback shall fail and return IOTHUB_CLIENT_ERROR while a message callback is set. ]*/
+                LogError("Invalid workflow sequence. Please unsubscribe using the IoTHubClientCore_LL_SetMessageChunkCallback function before subscribing with MessageCallback.");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else if (handleData->messageCallback.type == CALLBACK_TYPE_BATCH)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_136: [ While a batch callback is set, IoTHubClientCore_LL_SetMessageCallback, IoTHubClientCore_LL_SetMessageCallback_Ex and IoTHubClientCore_LL_SetMessageChunkCallback shall fail and return IOTHUB_CLIENT_ERROR, and IoTHubClientCore_LL_SetMessageBatchCallback shall fail and return IOTHUB_CLIENT_ERROR while another message callback is set. ]*/
+                LogError("Invalid workflow sequence. Please unsubscribe using the IoTHubClientCore_LL_SetMessageBatchCallback function before subscribing with MessageCallback.");
+                result = IOTHUB_CLIENT_ERROR;
+            }
             else
             {
                 if (handleData->IoTHubTransport_Subscribe(handleData->deviceHandle) == 0)
@@ -1922,6 +4385,18 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SetMessageCallback_Ex(IOTHUB_CLIENT_COR
                 LogError("Invalid workflow sequence. Please unsubscribe using the IoTHubClientCore_LL_SetMessageCallback function.");
                 result = IOTHUB_CLIENT_ERROR;
             }
+            else if (handleData->messageCallback.type == CALLBACK_TYPE_CHUNK)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_10_018: [If parameter messageCallback is NULL and IoTHubClientCore_LL_SetMessageCallback_Ex had not been used to subscribe for messages, then IoTHubClientCore_LL_SetMessageCallback_Ex shall fail and return IOTHUB_CLIENT_ERROR.] */
+                LogError("Invalid workflow sequence. Please unsubscribe using the IoTHubClientCore_LL_SetMessageChunkCallback function.");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else if (handleData->messageCallback.type == CALLBACK_TYPE_BATCH)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_136: [ While a batch callback is set, IoTHubClientCore_LL_SetMessageCallback, IoTHubClientCore_LL_SetMessageCallback_Ex and IoTHubClientCore_LL_SetMessageChunkCallback shall fail and return IOTHUB_CLIENT_ERROR, and IoTHubClientCore_LL_SetMessageBatchCallback shall fail and return IOTHUB_CLIENT_ERROR while another message callback is set. ]*/
+                LogError("Invalid workflow sequence. Please unsubscribe using the IoTHubClientCore_LL_SetMessageBatchCallback function.");
+                result = IOTHUB_CLIENT_ERROR;
+            }
             else
             {
                 /*Codes_SRS_IOTHUBCLIENT_LL_10_023: [If parameter messageCallback is NULL then IoTHubClientCore_LL_SetMessageCallback_Ex shall call the underlying layer's _Unsubscribe function and return IOTHUB_CLIENT_OK.] */
@@ -1941,6 +4416,18 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SetMessageCallback_Ex(IOTHUB_CLIENT_COR
                 LogError("Invalid workflow sequence. Please unsubscribe using the IoTHubClientCore_LL_MessageCallbackEx function before subscribing with MessageCallback.");
                 result = IOTHUB_CLIENT_ERROR;
             }
+            else if (handleData->messageCallback.type == CALLBACK_TYPE_CHUNK)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_038: [ While a chunk callback is set, IoTHubClientCore_LL_SetMessageCallback and IoTHubClientCore_LL_SetMessageCallback_Ex shall fail and return IOTHUB_CLIENT_ERROR, and IoTHubClientCore_LL_SetMessageChunkCallback shall fail and return IOTHUB_CLIENT_ERROR while a message callback is set. ]*/
+                LogError("Invalid workflow sequence. Please unsubscribe using the IoTHubClientCore_LL_SetMessageChunkCallback function before subscribing with MessageCallback_Ex.");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else if (handleData->messageCallback.type == CALLBACK_TYPE_BATCH)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_136: [ While a batch callback is set, IoTHubClientCore_LL_SetMessageCallback, IoTHubClientCore_LL_SetMessageCallback_Ex and IoTHubClientCore_LL_SetMessageChunkCallback shall fail and return IOTHUB_CLIENT_ERROR, and IoTHubClientCore_LL_SetMessageBatchCallback shall fail and return IOTHUB_CLIENT_ERROR while another message callback is set. ]*/
+                LogError("Invalid workflow sequence. Please unsubscribe using the IoTHubClientCore_LL_SetMessageBatchCallback function before subscribing with MessageCallback_Ex.");
+                result = IOTHUB_CLIENT_ERROR;
+            }
             else
             {
                 if (handleData->IoTHubTransport_Subscribe(handleData->deviceHandle) == 0)
@@ -1967,6 +4454,130 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SetMessageCallback_Ex(IOTHUB_CLIENT_COR
     return result;
 }
 
+IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SetMessageChunkCallback(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_MESSAGE_CHUNK_CALLBACK messageChunkCallback, void* userContextCallback)
+{
+    IOTHUB_CLIENT_RESULT result;
+    if (iotHubClientHandle == NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_037: [ IoTHubClientCore_LL_SetMessageChunkCallback shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter iotHubClientHandle is NULL. ]*/
+        LogError("Invalid argument - iotHubClientHandle is NULL");
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)iotHubClientHandle;
+        if (messageChunkCallback == NULL)
+        {
+            if (handleData->messageCallback.type != CALLBACK_TYPE_CHUNK)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_040: [ If parameter messageChunkCallback is NULL and no chunk callback is set, IoTHubClientCore_LL_SetMessageChunkCallback shall fail and return IOTHUB_CLIENT_ERROR; otherwise it shall call the underlying layer's _Unsubscribe function and return IOTHUB_CLIENT_OK. ]*/
+                LogError("not currently set to receive messages in chunks.");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                handleData->IoTHubTransport_Unsubscribe(handleData->deviceHandle);
+                handleData->messageCallback.type = CALLBACK_TYPE_NONE;
+                handleData->messageCallback.callbackChunk = NULL;
+                handleData->messageCallback.userContextCallback = NULL;
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        else
+        {
+            if (handleData->messageCallback.type == CALLBACK_TYPE_SYNC || handleData->messageCallback.type == CALLBACK_TYPE_ASYNC)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_038: [ While a chunk callback is set, IoTHubClientCore_LL_SetMessageCallback and IoTHubClientCore_LL_SetMessageCallback_Ex shall fail and return IOTHUB_CLIENT_ERROR, and IoTHubClientCore_LL_SetMessageChunkCallback shall fail and return IOTHUB_CLIENT_ERROR while a message callback is set. ]*/
+                LogError("Invalid workflow sequence. Please unsubscribe the message callback before subscribing with MessageChunkCallback.");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else if (handleData->messageCallback.type == CALLBACK_TYPE_BATCH)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_136: [ While a batch callback is set, IoTHubClientCore_LL_SetMessageCallback, IoTHubClientCore_LL_SetMessageCallback_Ex and IoTHubClientCore_LL_SetMessageChunkCallback shall fail and return IOTHUB_CLIENT_ERROR, and IoTHubClientCore_LL_SetMessageBatchCallback shall fail and return IOTHUB_CLIENT_ERROR while another message callback is set. ]*/
+                LogError("Invalid workflow sequence. Please unsubscribe using the IoTHubClientCore_LL_SetMessageBatchCallback function before subscribing with MessageChunkCallback.");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else if (handleData->IoTHubTransport_Subscribe(handleData->deviceHandle) == 0)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_039: [ If parameter messageChunkCallback is non-NULL then IoTHubClientCore_LL_SetMessageChunkCallback shall call the underlying layer's _Subscribe function, and fail and return IOTHUB_CLIENT_ERROR if it fails. ]*/
+                handleData->messageCallback.type = CALLBACK_TYPE_CHUNK;
+                handleData->messageCallback.callbackChunk = messageChunkCallback;
+                handleData->messageCallback.userContextCallback = userContextCallback;
+                result = IOTHUB_CLIENT_OK;
+            }
+            else
+            {
+                LogError("IoTHubTransport_Subscribe failed");
+                handleData->messageCallback.type = CALLBACK_TYPE_NONE;
+                handleData->messageCallback.callbackChunk = NULL;
+                handleData->messageCallback.userContextCallback = NULL;
+                result = IOTHUB_CLIENT_ERROR;
+            }
+        }
+    }
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SetMessageBatchCallback(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_MESSAGE_BATCH_CALLBACK messageBatchCallback, void* userContextCallback)
+{
+    IOTHUB_CLIENT_RESULT result;
+    if (iotHubClientHandle == NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_135: [ IoTHubClientCore_LL_SetMessageBatchCallback shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter iotHubClientHandle is NULL. ]*/
+        LogError("Invalid argument - iotHubClientHandle is NULL");
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)iotHubClientHandle;
+        if (messageBatchCallback == NULL)
+        {
+            if (handleData->messageCallback.type != CALLBACK_TYPE_BATCH)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_138: [ If parameter messageBatchCallback is NULL and no batch callback is set, IoTHubClientCore_LL_SetMessageBatchCallback shall fail and return IOTHUB_CLIENT_ERROR; otherwise it shall call the underlying layer's _Unsubscribe function, abandon the messages kept but not yet handed to the batch callback and return IOTHUB_CLIENT_OK. ]*/
+                LogError("not currently set to receive messages in batches.");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                handleData->IoTHubTransport_Unsubscribe(handleData->deviceHandle);
+                /*the messages already handed over keep waiting for their disposition*/
+                abandon_received_messages(handleData, handleData->receivedBatchDelivered);
+                handleData->messageCallback.type = CALLBACK_TYPE_NONE;
+                handleData->messageCallback.callbackBatch = NULL;
+                handleData->messageCallback.userContextCallback = NULL;
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        else
+        {
+            if (handleData->messageCallback.type == CALLBACK_TYPE_SYNC || handleData->messageCallback.type == CALLBACK_TYPE_ASYNC || handleData->messageCallback.type == CALLBACK_TYPE_CHUNK)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_136: [ While a batch callback is set, IoTHubClientCore_LL_SetMessageCallback, IoTHubClientCore_LL_SetMessageCallback_Ex and IoTHubClientCore_LL_SetMessageChunkCallback shall fail and return IOTHUB_CLIENT_ERROR, and IoTHubClientCore_LL_SetMessageBatchCallback shall fail and return IOTHUB_CLIENT_ERROR while another message callback is set. ]*/
+                LogError("Invalid workflow sequence. Please unsubscribe the message callback before subscribing with MessageBatchCallback.");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else if (handleData->IoTHubTransport_Subscribe(handleData->deviceHandle) == 0)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_137: [ If parameter messageBatchCallback is non-NULL then IoTHubClientCore_LL_SetMessageBatchCallback shall call the underlying layer's _Subscribe function, and fail and return IOTHUB_CLIENT_ERROR if it fails. ]*/
+                handleData->messageCallback.type = CALLBACK_TYPE_BATCH;
+                handleData->messageCallback.callbackBatch = messageBatchCallback;
+                handleData->messageCallback.userContextCallback = userContextCallback;
+                result = IOTHUB_CLIENT_OK;
+            }
+            else
+            {
+                LogError("IoTHubTransport_Subscribe failed");
+                handleData->messageCallback.type = CALLBACK_TYPE_NONE;
+                handleData->messageCallback.callbackBatch = NULL;
+                handleData->messageCallback.userContextCallback = NULL;
+                result = IOTHUB_CLIENT_ERROR;
+            }
+        }
+    }
+    return result;
+}
+
 IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SendMessageDisposition(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, MESSAGE_CALLBACK_INFO* message_data, IOTHUBMESSAGE_DISPOSITION_RESULT disposition)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -1981,6 +4592,66 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SendMessageDisposition(IOTHUB_CLIENT_CO
         IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)iotHubClientHandle;
         /*Codes_SRS_IOTHUBCLIENT_LL_10_027: [IoTHubClientCore_LL_SendMessageDisposition shall return the result from calling the underlying layer's _Send_Message_Disposition.]*/
         result = handleData->IoTHubTransport_SendMessageDisposition(message_data, disposition);
+
+        /*statistics may have been enabled after the message was taken*/
+        if (handleData->statisticsEnabled && handleData->statistics.messages_awaiting_disposition > 0)
+        {
+            handleData->statistics.messages_awaiting_disposition--;
+        }
+    }
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SendMessageDispositionBatch(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE* messages, size_t messageCount, IOTHUBMESSAGE_DISPOSITION_RESULT disposition)
+{
+    IOTHUB_CLIENT_RESULT result;
+    if ((iotHubClientHandle == NULL) || (messages == NULL) || (messageCount == 0))
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_141: [ IoTHubClientCore_LL_SendMessageDispositionBatch shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter iotHubClientHandle or messages is NULL, or messageCount is 0. ]*/
+        LogError("Invalid argument handle=%%p, messages=%%p, messageCount=%%lu", iotHubClientHandle, messages, (unsigned long)messageCount);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)iotHubClientHandle;
+        size_t cursor = 0;
+        size_t index;
+
+        result = IOTHUB_CLIENT_OK;
+        for (index = 0; index < messageCount; index++)
+        {
+            size_t found = find_received_message(handleData, messages[index], &cursor);
+            if (found == handleData->receivedBatchDelivered)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_143: [ IoTHubClientCore_LL_SendMessageDispositionBatch shall skip a message that is not waiting for its disposition after being handed to the batch callback, and return IOTHUB_CLIENT_INVALID_ARG once it has settled the others. ]*/
+                LogError("message %%p is not waiting for its disposition", messages[index]);
+                if (result == IOTHUB_CLIENT_OK)
+                {
+                    result = IOTHUB_CLIENT_INVALID_ARG;
+                }
+            }
+            else
+            {
+                MESSAGE_CALLBACK_INFO* messageData = handleData->receivedBatch[found];
+                handleData->receivedBatch[found] = NULL;
+                handleData->receivedBatchSettled++;
+
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_142: [ IoTHubClientCore_LL_SendMessageDispositionBatch shall send disposition for every message through the underlying layer's _SendMessageDisposition, and return IOTHUB_CLIENT_ERROR once it has tried them all if any of them fails. ]*/
+                if (handleData->IoTHubTransport_SendMessageDisposition(messageData, disposition) != IOTHUB_CLIENT_OK)
+                {
+                    LogError("IoTHubTransport_SendMessageDisposition failed");
+                    if (result == IOTHUB_CLIENT_OK)
+                    {
+                        result = IOTHUB_CLIENT_ERROR;
+                    }
+                }
+
+                if (handleData->statisticsEnabled && handleData->statistics.messages_awaiting_disposition > 0)
+                {
+                    handleData->statistics.messages_awaiting_disposition--;
+                }
+            }
+        }
     }
     return result;
 }
@@ -1994,27 +4665,75 @@ static void DoTimeouts(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData)
     }
     else
     {
-        DLIST_ENTRY* currentItemInWaitingToSend = handleData->waitingToSend.Flink;
-        while (currentItemInWaitingToSend != &(handleData->waitingToSend)) /*while we are not at the end of the list*/
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_008: [ DoTimeouts shall only look at messages whose timeout has expired, earliest deadline first. ]*/
+        while (handleData->messageTimeoutCount > 0)
+        {
+            MESSAGE_TIMEOUT earliest = handleData->messageTimeouts[0];
+            /*Codes_SRS_IOTHUBCLIENT_LL_02_041: [ If more than value miliseconds have passed since the call to IoTHubClientCore_LL_SendEventAsync then the message callback shall be called with a status code of IOTHUB_CLIENT_CONFIRMATION_TIMEOUT. ]*/
+            if ((nowTick - earliest.ms_timesOutAfter) <= earliest.message_timeout_value)
+            {
+                break;
+            }
+
+            remove_earliest_message_timeout(handleData);
+
+            bool held = is_held_event(handleData, &earliest);
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_009: [ An expired message that the transport has already taken from waitingToSend shall be left to the transport. ]*/
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_113: [ An expired message still held by `send_window` shall time out like one in waitingToSend. ]*/
+            if (held || is_waiting_to_send(handleData, &earliest))
+            {
+                IOTHUB_MESSAGE_LIST* fullEntry = earliest.message;
+                DList_RemoveEntryList(&(fullEntry->entry));
+                if (held)
+                {
+                    handleData->heldEventCount--;
+                }
+                complete_event(handleData, fullEntry, IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT);
+                IoTHubMessage_Destroy(fullEntry->messageHandle); /*because it has been cloned*/
+                release_message_list(handleData, fullEntry);
+            }
+        }
+    }
+}
+
+static void drain_spill_queue(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData)
+{
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_030: [ Before calling the transport's _DoWork, IoTHubClientCore_LL_DoWork shall move events from the spill log to waitingToSend, oldest first, until waitingToSend holds OPTION_SPILL_THRESHOLD events or the spill log is empty. ]*/
+    size_t waiting = count_waiting_to_send(handleData, handleData->spillThreshold);
+
+    while ((waiting < handleData->spillThreshold) && !spill_queue_is_empty(handleData->spillQueue))
+    {
+        IOTHUB_MESSAGE_HANDLE message;
+        IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK callback;
+        void* context;
+
+        if (spill_queue_read_message(handleData->spillQueue, &message, &callback, &context) != 0)
         {
-            IOTHUB_MESSAGE_LIST* fullEntry = containingRecord(currentItemInWaitingToSend, IOTHUB_MESSAGE_LIST, entry);
-            /*Codes_SRS_IOTHUBCLIENT_LL_02_041: [ If more than value miliseconds have passed since the call to IoTHubClientCore_LL_SendEventAsync then the message callback shall be called with a status code of IOTHUB_CLIENT_CONFIRMATION_TIMEOUT. ]*/
-            if ((fullEntry->ms_timesOutAfter != 0) && ((nowTick - fullEntry->ms_timesOutAfter) > fullEntry->message_timeout_value))
+            LogError("Failed reading from the spill log");
+            break;
+        }
+        else if (message == NULL)
+        {
+            break;
+        }
+        else
+        {
+            size_t payloadSize = (handleData->maxPendingBytes > 0) ? get_event_payload_size(message) : 0;
+
+            if (queue_event(handleData, message, callback, context, true, payloadSize, handleData->spillGeneration) != IOTHUB_CLIENT_OK)
             {
-                PDLIST_ENTRY theNext = currentItemInWaitingToSend->Flink; /*need to save the next item, because the below operations are destructive*/
-                DList_RemoveEntryList(currentItemInWaitingToSend);
-                if (fullEntry->callback != NULL)
+                /*the event cannot go back to the spill log, so it fails like an event that could not be sent*/
+                LogError("Failed queuing a spilled event");
+                IoTHubMessage_Destroy(message);
+                (void)spill_queue_release(handleData->spillQueue);
+                if (callback != NULL)
                 {
-                    fullEntry->callback(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, fullEntry->context);
+                    callback(IOTHUB_CLIENT_CONFIRMATION_ERROR, context);
                 }
-                IoTHubMessage_Destroy(fullEntry->messageHandle); /*because it has been cloned*/
-                free(fullEntry);
-                currentItemInWaitingToSend = theNext;
-            }
-            else
-            {
-                currentItemInWaitingToSend = currentItemInWaitingToSend->Flink;
+                break;
             }
+
+            waiting++;
         }
     }
 }
@@ -2026,20 +4745,105 @@ void IoTHubClientCore_LL_DoWork(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle)
     {
         IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)iotHubClientHandle;
         DoTimeouts(handleData);
+        if ((handleData->methodResponseTimeout > 0) && (handleData->methodsInFlightCount > 0))
+        {
+            DoMethodTimeouts(handleData);
+        }
+
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_120: [ If a twin cache file is set and holds a twin, IoTHubClientCore_LL_DoWork shall call deviceTwinCallback with it as DEVICE_TWIN_UPDATE_COMPLETE once, before any twin is received, so the application starts from the twin it last saw while the client connects. ]*/
+        if ((handleData->twinCache != NULL) && ((handleData->deviceTwinCallback != NULL) || (handleData->twinFanout != NULL)) && !handleData->complete_twin_update_encountered)
+        {
+            const char* cachedTwin = twin_cache_get_twin(handleData->twinCache);
+            if (cachedTwin != NULL)
+            {
+                handleData->complete_twin_update_encountered = true;
+                if (handleData->deviceTwinCallback != NULL)
+                {
+                    handleData->deviceTwinCallback(DEVICE_TWIN_UPDATE_COMPLETE, (const unsigned char*)cachedTwin, strlen(cachedTwin), handleData->deviceTwinContextCallback);
+                }
+                if (handleData->twinFanout != NULL)
+                {
+                    twin_fanout_dispatch(handleData->twinFanout, DEVICE_TWIN_UPDATE_COMPLETE, (const unsigned char*)cachedTwin, strlen(cachedTwin));
+                }
+            }
+        }
+
+        if (is_rate_limited(handleData))
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_165: [ While `rate_limits` is set, IoTHubClientCore_LL_DoWork shall add to each bucket the tokens of the time passed since it was last refilled, up to its burst. ]*/
+            refill_rate_limits(handleData);
+        }
+
+        bool holdReportedStates = false;
+        if (handleData->sendWindowPeriod != 0)
+        {
+            tickcounter_ms_t now;
+            if (tickcounter_get_current_ms(handleData->tickCounter, &now) != 0)
+            {
+                LogError("unable to get the current ms, the send window is kept open");
+                handleData->sendWindowOpen = true;
+            }
+            else if (now >= handleData->sendWindowOpensAt)
+            {
+                handleData->sendWindowOpensAt = now + handleData->sendWindowPeriod;
+                handleData->sendWindowOpen = true;
+            }
+
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_112: [ If `send_window` is set, IoTHubClientCore_LL_DoWork shall move the held events to waitingToSend, oldest first, and give the transport the queued reported states only once period_ms have passed since the previous window opened, or events were released on their own since the previous call. ]*/
+            if (handleData->sendWindowOpen)
+            {
+                if (handleData->heldEventCount > 0)
+                {
+                    release_allowed_events(handleData);
+                }
+                handleData->sendWindowOpen = false;
+            }
+            else
+            {
+                holdReportedStates = true;
+            }
+        }
+        else if (handleData->heldEventCount > 0)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_167: [ IoTHubClientCore_LL_DoWork shall move to waitingToSend, oldest first, as many held events as the telemetry bucket holds tokens for, taking one token per event; while `send_window` is set, only when the window opens. ]*/
+            release_allowed_events(handleData);
+        }
 
         /*Codes_SRS_IOTHUBCLIENT_LL_07_008: [ IoTHubClientCore_LL_DoWork shall iterate the message queue and execute the underlying transports IoTHubTransport_ProcessItem function for each item. ] */
-        DLIST_ENTRY* client_item = handleData->iot_msg_queue.Flink;
+        DLIST_ENTRY* client_item = holdReportedStates ? &(handleData->iot_msg_queue) : handleData->iot_msg_queue.Flink;
         while (client_item != &(handleData->iot_msg_queue)) /*while we are not at the end of the list*/
         {
             PDLIST_ENTRY next_item = client_item->Flink;
 
             IOTHUB_DEVICE_TWIN* queue_data = containingRecord(client_item, IOTHUB_DEVICE_TWIN, entry);
             IOTHUB_IDENTITY_INFO identity_info;
+
+            if (queue_data->ms_coalesce_until != 0)
+            {
+                tickcounter_ms_t now;
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_035: [ IoTHubClientCore_LL_DoWork shall not give the transport a reported state, nor the ones queued after it, until its `twin_coalesce_window` has passed. ]*/
+                if (tickcounter_get_current_ms(handleData->tickCounter, &now) == 0 && now < queue_data->ms_coalesce_until)
+                {
+                    break;
+                }
+                queue_data->ms_coalesce_until = 0;
+            }
+
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_168: [ IoTHubClientCore_LL_DoWork shall not give the transport a reported state, nor the ones queued after it, while the twin_updates bucket of `rate_limits` holds no token, and take one token per reported state the transport takes. ]*/
+            if (!has_rate_limit_token(&handleData->twinRateLimit))
+            {
+                break;
+            }
+
             identity_info.device_twin = queue_data;
             IOTHUB_PROCESS_ITEM_RESULT process_results =  handleData->IoTHubTransport_ProcessItem(handleData->transportHandle, IOTHUB_TYPE_DEVICE_TWIN, &identity_info);
             if (process_results == IOTHUB_PROCESS_CONTINUE || process_results == IOTHUB_PROCESS_NOT_CONNECTED)
             {
                 /*Codes_SRS_IOTHUBCLIENT_LL_07_010: [ If 'IoTHubTransport_ProcessItem' returns IOTHUB_PROCESS_CONTINUE or IOTHUB_PROCESS_NOT_CONNECTED IoTHubClientCore_LL_DoWork shall continue on to call the underlaying layer's _DoWork function. ]*/
+                if (process_results == IOTHUB_PROCESS_NOT_CONNECTED)
+                {
+                    handleData->twinConnected = false;
+                }
                 break;
             }
             else
@@ -2047,8 +4851,20 @@ void IoTHubClientCore_LL_DoWork(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle)
                 DList_RemoveEntryList(client_item);
                 if (process_results == IOTHUB_PROCESS_OK)
                 {
+                    handleData->twinConnected = true;
+                    take_rate_limit_token(&handleData->twinRateLimit);
                     /*Codes_SRS_IOTHUBCLIENT_LL_07_011: [ If 'IoTHubTransport_ProcessItem' returns IOTHUB_PROCESS_OK IoTHubClientCore_LL_DoWork shall add the IOTHUB_DEVICE_TWIN to the ack queue. ]*/
                     DList_InsertTailList(&(iotHubClientHandle->iot_ack_queue), &(queue_data->entry));
+                    if (handleData->statisticsEnabled)
+                    {
+                        queue_data->sent_stamped = get_statistics_time(handleData, &queue_data->ms_sent);
+                    }
+                    tickcounter_ms_t now;
+                    if (queue_data->trace.active && get_statistics_time(handleData, &now))
+                    {
+                        queue_data->trace.published = true;
+                        queue_data->trace.ms_published = now;
+                    }
                 }
                 else
                 {
@@ -2061,9 +4877,81 @@ void IoTHubClientCore_LL_DoWork(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle)
             client_item = next_item;
         }
 
+        tickcounter_ms_t nowTick;
+        if ((handleData->telemetryAggregation != NULL) && (tickcounter_get_current_ms(handleData->tickCounter, &nowTick) == 0))
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_102: [ Before draining the spill log, IoTHubClientCore_LL_DoWork shall close the aggregation windows that have ended and queue one event per closed window, oldest first; a window whose event cannot be queued is kept for the next call. ]*/
+            telemetry_aggregation_flush(handleData->telemetryAggregation, nowTick, send_aggregated_event, handleData);
+        }
+
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_108: [ IoTHubClientCore_LL_DoWork shall complete the events suppressed before it was called with IOTHUB_CLIENT_CONFIRMATION_OK, in the order they were sent. ]*/
+        if (handleData->suppressedEventCount > 0)
+        {
+            complete_suppressed_events(handleData);
+        }
+
+        if (handleData->spillQueue != NULL)
+        {
+            drain_spill_queue(handleData);
+        }
+
+        if (handleData->pendingMethodResponses.Flink != NULL)
+        {
+            send_pending_method_responses(handleData);
+        }
+
         /*Codes_SRS_IOTHUBCLIENT_LL_02_021: [Otherwise, IoTHubClientCore_LL_DoWork shall invoke the underlaying layer's _DoWork function.]*/
         handleData->IoTHubTransport_DoWork(handleData->transportHandle);
+
+#ifdef USE_EDGE_MODULES
+        if (handleData->methodHandle != NULL)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_078: [ If the client was created for an Edge module, IoTHubClientCore_LL_DoWork shall call IoTHubClient_Edge_DoWork to drive the asynchronous method invokes. ]*/
+            IoTHubClient_Edge_DoWork(handleData->methodHandle);
+        }
+#endif
+
+        if (handleData->eventConfirmationBatchCallback != NULL)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_004: [ At the end of IoTHubClientCore_LL_DoWork, if any confirmations were recorded for the batch, the batch callback shall be called once with all of them. ]*/
+            flush_event_confirmations(handleData);
+        }
+
+        if (handleData->messageCallback.type == CALLBACK_TYPE_BATCH)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_140: [ At the end of IoTHubClientCore_LL_DoWork, if messages were kept for the batch callback since it was last called, messageBatchCallback shall be called once with all of them, oldest first. ]*/
+            deliver_received_messages(handleData);
+        }
+    }
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_GetStatistics(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_STATISTICS* statistics)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_022: [ IoTHubClientCore_LL_GetStatistics shall return IOTHUB_CLIENT_INVALID_ARG if iotHubClientHandle or statistics is NULL. ]*/
+    if (iotHubClientHandle == NULL || statistics == NULL)
+    {
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LOG_ERROR_RESULT;
     }
+    else
+    {
+        IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)iotHubClientHandle;
+        PDLIST_ENTRY entry;
+
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_023: [ IoTHubClientCore_LL_GetStatistics shall copy the collected statistics to statistics, set waiting_to_send to the number of events in waitingToSend and return IOTHUB_CLIENT_OK. ]*/
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_114: [ The events held by `send_window` shall be counted in waiting_to_send. ]*/
+        *statistics = handleData->statistics;
+        statistics->waiting_to_send = handleData->heldEventCount;
+        for (entry = handleData->waitingToSend.Flink; entry != &(handleData->waitingToSend); entry = entry->Flink)
+        {
+            statistics->waiting_to_send++;
+        }
+        result = IOTHUB_CLIENT_OK;
+    }
+
+    return result;
 }
 
 IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_GetSendStatus(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_STATUS *iotHubClientStatus)
@@ -2109,6 +4997,37 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SetConnectionStatusCallback(IOTHUB_CLIE
     return result;
 }
 
+IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SetEventConfirmationBatchCallback(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_BATCH_CALLBACK eventConfirmationBatchCallback, void* userContextCallback)
+{
+    IOTHUB_CLIENT_RESULT result;
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_001: [ IoTHubClientCore_LL_SetEventConfirmationBatchCallback shall return IOTHUB_CLIENT_INVALID_ARG if called with NULL parameter iotHubClientHandle. ]*/
+    if (iotHubClientHandle == NULL)
+    {
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LOG_ERROR_RESULT;
+    }
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_002: [ If the handle was created with a shared transport, IoTHubClientCore_LL_SetEventConfirmationBatchCallback shall return IOTHUB_CLIENT_ERROR. ]*/
+    else if (iotHubClientHandle->isSharedTransport)
+    {
+        result = IOTHUB_CLIENT_ERROR;
+        LogError("batch confirmations are not supported when the transport is shared");
+    }
+    else
+    {
+        IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)iotHubClientHandle;
+        if (handleData->eventConfirmationBatchCallback != NULL)
+        {
+            /*whatever was recorded so far belongs to the previous callback*/
+            flush_event_confirmations(handleData);
+        }
+        handleData->eventConfirmationBatchCallback = eventConfirmationBatchCallback;
+        handleData->eventConfirmationBatchContextCallback = userContextCallback;
+        result = IOTHUB_CLIENT_OK;
+    }
+
+    return result;
+}
+
 IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SetRetryPolicy(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_RETRY_POLICY retryPolicy, size_t retryTimeoutLimitInSeconds)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -2185,48 +5104,329 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_GetLastMessageReceiveTime(IOTHUB_CLIENT
         /* Codes_SRS_IOTHUBCLIENT_LL_09_002: [IoTHubClientCore_LL_GetLastMessageReceiveTime shall return IOTHUB_CLIENT_INDEFINITE_TIME - and not set 'lastMessageReceiveTime' - if it is unable to provide the time for the last commands] */
         if (handleData->lastMessageReceiveTime == INDEFINITE_TIME)
         {
-            result = IOTHUB_CLIENT_INDEFINITE_TIME;
-            LOG_ERROR_RESULT;
+            result = IOTHUB_CLIENT_INDEFINITE_TIME;
+            LOG_ERROR_RESULT;
+        }
+        else
+        {
+            /* Codes_SRS_IOTHUBCLIENT_LL_09_003: [IoTHubClientCore_LL_GetLastMessageReceiveTime shall return IOTHUB_CLIENT_OK if it wrote in the lastMessageReceiveTime the time when the last command was received] */
+            /* Codes_SRS_IOTHUBCLIENT_LL_09_004: [IoTHubClientCore_LL_GetLastMessageReceiveTime shall return lastMessageReceiveTime in localtime] */
+            *lastMessageReceiveTime = handleData->lastMessageReceiveTime;
+            result = IOTHUB_CLIENT_OK;
+        }
+    }
+
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SetOption(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, const char* optionName, const void* value)
+{
+
+    IOTHUB_CLIENT_RESULT result;
+    /*Codes_SRS_IOTHUBCLIENT_LL_02_034: [If iotHubClientHandle is NULL then IoTHubClientCore_LL_SetOption shall return IOTHUB_CLIENT_INVALID_ARG.]*/
+    /*Codes_SRS_IOTHUBCLIENT_LL_02_035: [If optionName is NULL then IoTHubClientCore_LL_SetOption shall return IOTHUB_CLIENT_INVALID_ARG.] */
+    /*Codes_SRS_IOTHUBCLIENT_LL_02_036: [If value is NULL then IoTHubClientCore_LL_SetOption shall return IOTHUB_CLIENT_INVALID_ARG.] */
+    if (
+        (iotHubClientHandle == NULL) ||
+        (optionName == NULL) ||
+        (value == NULL)
+        )
+    {
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LogError("invalid argument (NULL)");
+    }
+    else
+    {
+        IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)iotHubClientHandle;
+
+        /*Codes_SRS_IOTHUBCLIENT_LL_02_039: [ "messageTimeout" - once IoTHubClientCore_LL_SendEventAsync is called the message shall timeout after value miliseconds. Value is a pointer to a tickcounter_ms_t. ]*/
+        if (strcmp(optionName, OPTION_MESSAGE_TIMEOUT) == 0)
+        {
+            /*this is an option handled by IoTHubClientCore_LL*/
+            /*Codes_SRS_IOTHUBCLIENT_LL_02_043: [ Calling IoTHubClientCore_LL_SetOption with value set to "0" shall disable the timeout mechanism for all new messages. ]*/
+            handleData->currentMessageTimeout = *(const tickcounter_ms_t*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_012: [ "event_pool_size" - IoTHubClientCore_LL_SetOption shall pre-allocate that many IOTHUB_MESSAGE_LIST records for reuse, freeing any beyond it, and return IOTHUB_CLIENT_ERROR if they cannot be allocated. Value is a pointer to a size_t. ]*/
+        else if (strcmp(optionName, OPTION_EVENT_POOL_SIZE) == 0)
+        {
+            result = set_message_list_pool_size(handleData, *(const size_t*)value);
+        }
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_160: [ "small_event_slots" - IoTHubClientCore_LL_SetOption shall replace the slots of IoTHubClientCore_LL_SendSmallEvent with this many slots allocated at once, 0 freeing them, and return IOTHUB_CLIENT_ERROR if small events are in flight or the slots cannot be allocated. Value is a pointer to a size_t. ]*/
+        else if (strcmp(optionName, OPTION_SMALL_EVENT_SLOTS) == 0)
+        {
+            result = set_small_event_slot_count(handleData, *(const size_t*)value);
+        }
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_016: [ "enable_statistics" - IoTHubClientCore_LL_SetOption shall start (true) or stop (false) collecting statistics; values already collected shall be kept. Value is a pointer to a bool. ]*/
+        else if (strcmp(optionName, OPTION_ENABLE_STATISTICS) == 0)
+        {
+            handleData->statisticsEnabled = *(const bool*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_091: [ "method_max_in_flight" - IoTHubClientCore_LL_SetOption shall bound the method requests taken by an inbound method callback and not answered yet; 0 (default) removes the bound. Value is a pointer to a size_t. ]*/
+        else if (strcmp(optionName, OPTION_METHOD_MAX_IN_FLIGHT) == 0)
+        {
+            handleData->methodMaxInFlight = *(const size_t*)value;
+            handleData->methodTracking = true;
+            result = IOTHUB_CLIENT_OK;
+        }
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_092: [ "method_response_timeout_secs" - IoTHubClientCore_LL_SetOption shall set the seconds a method request taken by an inbound method callback waits for its response; 0 (default) waits forever. Value is a pointer to a size_t. ]*/
+        else if (strcmp(optionName, OPTION_METHOD_RESPONSE_TIMEOUT_SECS) == 0)
+        {
+            handleData->methodResponseTimeout = (tickcounter_ms_t)(*(const size_t*)value) * 1000;
+            handleData->methodTracking = true;
+            result = IOTHUB_CLIENT_OK;
+        }
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_077: [ "trace_exporter" - IoTHubClientCore_LL_SetOption shall copy the exporter, which receives the spans of the operations started from then on; an exporter whose on_span_ended is NULL turns tracing off. Value is a pointer to an IOTHUB_CLIENT_TRACE_EXPORTER. ]*/
+        else if (strcmp(optionName, OPTION_TRACE_EXPORTER) == 0)
+        {
+            if (IoTHubClient_Tracing_SetExporter(&handleData->tracer, (const IOTHUB_CLIENT_TRACE_EXPORTER*)value) != 0)
+            {
+                LogError("unable to set the trace exporter");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_024: [ "max_pending_bytes" - IoTHubClientCore_LL_SetOption shall bound the payload bytes of the events queued or in flight; events queued before the option was set are not counted and 0 (default) removes the bound. Value is a pointer to a size_t. ]*/
+        else if (strcmp(optionName, OPTION_MAX_PENDING_BYTES) == 0)
+        {
+            handleData->maxPendingBytes = *(const size_t*)value;
+            if (handleData->pendingBytes > handleData->maxPendingBytes)
+            {
+                LogInfo("%lu pending bytes already above the new limit, new events are rejected until they complete", (unsigned long)handleData->pendingBytes);
+            }
+            result = IOTHUB_CLIENT_OK;
+        }
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_027: [ "spill_directory" - IoTHubClientCore_LL_SetOption shall open the spill log kept in that existing directory, closing any spill log opened before, and return IOTHUB_CLIENT_ERROR if it cannot be opened. An empty string closes the spill log; the events in it stay on disk. Value is a const char*. ]*/
+        else if (strcmp(optionName, OPTION_SPILL_DIRECTORY) == 0)
+        {
+            SPILL_QUEUE_HANDLE spillQueue;
+
+            if (*(const char*)value == '\0')
+            {
+                if (handleData->spillQueue != NULL)
+                {
+                    spill_queue_destroy(handleData->spillQueue);
+                    handleData->spillQueue = NULL;
+                }
+                result = IOTHUB_CLIENT_OK;
+            }
+            else if ((spillQueue = spill_queue_create((const char*)value, SPILL_SEGMENT_SIZE)) == NULL)
+            {
+                LogError("Failed opening the spill log in %s", (const char*)value);
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                if (handleData->spillQueue != NULL)
+                {
+                    spill_queue_destroy(handleData->spillQueue);
+                }
+                handleData->spillQueue = spillQueue;
+                handleData->spillGeneration++;
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_118: [ "twin_cache_file" - IoTHubClientCore_LL_SetOption shall open the twin cache kept in that file, closing any twin cache opened before, and return IOTHUB_CLIENT_ERROR if it cannot be opened. An empty string closes the twin cache; the twin stays in its file. Value is a const char*. ]*/
+        else if (strcmp(optionName, OPTION_TWIN_CACHE_FILE) == 0)
+        {
+            TWIN_CACHE_HANDLE twinCache;
+
+            if (*(const char*)value == '\0')
+            {
+                if (handleData->twinCache != NULL)
+                {
+                    twin_cache_destroy(handleData->twinCache);
+                    handleData->twinCache = NULL;
+                }
+                result = IOTHUB_CLIENT_OK;
+            }
+            else if ((twinCache = twin_cache_create((const char*)value)) == NULL)
+            {
+                LogError("Failed opening the twin cache in %s", (const char*)value);
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                if (handleData->twinCache != NULL)
+                {
+                    twin_cache_destroy(handleData->twinCache);
+                }
+                handleData->twinCache = twinCache;
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_029: [ "spill_threshold" - IoTHubClientCore_LL_SetOption shall set how many events waitingToSend holds before new events are spilled, and return IOTHUB_CLIENT_INVALID_ARG if it is 0. Value is a pointer to a size_t. ]*/
+        else if (strcmp(optionName, OPTION_SPILL_THRESHOLD) == 0)
+        {
+            if (*(const size_t*)value == 0)
+            {
+                LogError("spill_threshold cannot be 0");
+                result = IOTHUB_CLIENT_INVALID_ARG;
+            }
+            else
+            {
+                handleData->spillThreshold = *(const size_t*)value;
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_033: [ "twin_coalesce_window" - IoTHubClientCore_LL_SetOption shall set how many milliseconds a queued reported state waits for more reported states to be merged into it; 0 (default) sends each on its own. Value is a pointer to a tickcounter_ms_t. ]*/
+        else if (strcmp(optionName, OPTION_TWIN_COALESCE_WINDOW) == 0)
+        {
+            handleData->twinCoalesceWindow = *(const tickcounter_ms_t*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_152: [ "twin_coalesce_offline" - IoTHubClientCore_LL_SetOption shall set whether the reported states sent while the client is not connected are merged into the newest one still queued; false (default) queues each on its own. Value is a pointer to a bool. ]*/
+        else if (strcmp(optionName, OPTION_TWIN_COALESCE_OFFLINE) == 0)
+        {
+            handleData->twinCoalesceOffline = *(const bool*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_103: [ "telemetry_aggregation" - IoTHubClientCore_LL_SetOption shall add or replace the aggregation of the samples of output_name, or remove it if window_ms is 0, dropping the windows of the previous aggregation not sent yet, and return IOTHUB_CLIENT_ERROR if it cannot be allocated. Value is a pointer to an IOTHUB_CLIENT_TELEMETRY_AGGREGATION. ]*/
+        else if (strcmp(optionName, OPTION_TELEMETRY_AGGREGATION) == 0)
+        {
+            if ((handleData->telemetryAggregation == NULL) && ((handleData->telemetryAggregation = telemetry_aggregation_create()) == NULL))
+            {
+                LogError("Failed creating the telemetry aggregation");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else if (telemetry_aggregation_configure(handleData->telemetryAggregation, (const IOTHUB_CLIENT_TELEMETRY_AGGREGATION*)value) != 0)
+            {
+                LogError("Failed setting the telemetry aggregation");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_164: [ "output_route" - IoTHubClientCore_LL_SetOption shall add the route to the routes of IoTHubClientCore_LL_SendEventToRoutesAsync, or remove it if remove is true, and return IOTHUB_CLIENT_ERROR if it cannot be allocated or is not valid. Value is a pointer to an IOTHUB_CLIENT_OUTPUT_ROUTE. ]*/
+        else if (strcmp(optionName, OPTION_OUTPUT_ROUTE) == 0)
+        {
+            if ((handleData->outputRouting == NULL) && ((handleData->outputRouting = output_routing_create()) == NULL))
+            {
+                LogError("Failed creating the output routing");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else if (output_routing_configure(handleData->outputRouting, (const IOTHUB_CLIENT_OUTPUT_ROUTE*)value) != 0)
+            {
+                LogError("Failed setting the output route");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                result = IOTHUB_CLIENT_OK;
+            }
         }
-        else
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_106: [ "report_by_exception" - IoTHubClientCore_LL_SetOption shall add or replace the filter of the events holding property_name, or remove it if deadband is negative, and return IOTHUB_CLIENT_ERROR if it cannot be allocated. Value is a pointer to an IOTHUB_CLIENT_REPORT_BY_EXCEPTION. ]*/
+        else if (strcmp(optionName, OPTION_REPORT_BY_EXCEPTION) == 0)
         {
-            /* Codes_SRS_IOTHUBCLIENT_LL_09_003: [IoTHubClientCore_LL_GetLastMessageReceiveTime shall return IOTHUB_CLIENT_OK if it wrote in the lastMessageReceiveTime the time when the last command was received] */
-            /* Codes_SRS_IOTHUBCLIENT_LL_09_004: [IoTHubClientCore_LL_GetLastMessageReceiveTime shall return lastMessageReceiveTime in localtime] */
-            *lastMessageReceiveTime = handleData->lastMessageReceiveTime;
-            result = IOTHUB_CLIENT_OK;
+            if ((handleData->reportByException == NULL) && ((handleData->reportByException = report_by_exception_create()) == NULL))
+            {
+                LogError("Failed creating the report by exception");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else if (report_by_exception_configure(handleData->reportByException, (const IOTHUB_CLIENT_REPORT_BY_EXCEPTION*)value) != 0)
+            {
+                LogError("Failed setting the report by exception");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                result = IOTHUB_CLIENT_OK;
+            }
         }
-    }
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_116: [ "send_window" - IoTHubClientCore_LL_SetOption shall hold events and reported states for up to period_ms, or release the held ones and stop holding if period_ms is 0, and return IOTHUB_CLIENT_ERROR if urgent_property cannot be copied. Value is a pointer to an IOTHUB_CLIENT_SEND_WINDOW. ]*/
+        else if (strcmp(optionName, OPTION_SEND_WINDOW) == 0)
+        {
+            const IOTHUB_CLIENT_SEND_WINDOW* sendWindow = (const IOTHUB_CLIENT_SEND_WINDOW*)value;
+            char* urgentProperty = NULL;
 
-    return result;
-}
+            if ((sendWindow->period_ms != 0) && (sendWindow->urgent_property != NULL) && (mallocAndStrcpy_s(&urgentProperty, sendWindow->urgent_property) != 0))
+            {
+                LogError("Failed copying the urgent property of the send window");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                if (handleData->heldEvents.Flink == NULL)
+                {
+                    DList_InitializeListHead(&(handleData->heldEvents));
+                }
+                if (handleData->sendWindowUrgentProperty != NULL)
+                {
+                    free(handleData->sendWindowUrgentProperty);
+                }
+                handleData->sendWindowUrgentProperty = urgentProperty;
+                handleData->sendWindowPeriod = sendWindow->period_ms;
+                handleData->sendWindowMaxHeld = sendWindow->max_held;
+                /*the first DoWork opens the window*/
+                handleData->sendWindowOpensAt = 0;
 
-IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SetOption(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, const char* optionName, const void* value)
-{
+                if (sendWindow->period_ms == 0)
+                {
+                    if (handleData->heldEventCount > 0)
+                    {
+                        release_allowed_events(handleData);
+                    }
+                }
+                else
+                {
+                    /*Codes_SRS_IOTHUBCLIENT_LL_41_117: [ If period_ms is not 0, IoTHubClientCore_LL_SetOption shall set the transport's OPTION_KEEP_ALIVE to period_ms rounded up to seconds, so pings do not wake the radio between windows; transports without the option are left as they are. ]*/
+                    tickcounter_ms_t keepAliveSeconds = (sendWindow->period_ms + 999) / 1000;
+                    int keepAlive = (keepAliveSeconds > INT_MAX) ? INT_MAX : (int)keepAliveSeconds;
+                    if (handleData->IoTHubTransport_SetOption(handleData->transportHandle, OPTION_KEEP_ALIVE, &keepAlive) != IOTHUB_CLIENT_OK)
+                    {
+                        LogInfo("The transport keep alive could not be aligned with the send window");
+                    }
+                }
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_170: [ `rate_limits` - IoTHubClientCore_LL_SetOption shall refill a full bucket at per_second tokens per second, up to burst tokens, for each class whose per_second is not 0, or at the device's share of the quotas of tier otherwise, and not limit the classes left without a rate; it shall return IOTHUB_CLIENT_INVALID_ARG if a per_second is negative or tier is not known. Value is a pointer to an IOTHUB_CLIENT_RATE_LIMITS. ]*/
+        else if (strcmp(optionName, OPTION_RATE_LIMITS) == 0)
+        {
+            const IOTHUB_CLIENT_RATE_LIMITS* rateLimits = (const IOTHUB_CLIENT_RATE_LIMITS*)value;
 
-    IOTHUB_CLIENT_RESULT result;
-    /*Codes_SRS_IOTHUBCLIENT_LL_02_034: [If iotHubClientHandle is NULL then IoTHubClientCore_LL_SetOption shall return IOTHUB_CLIENT_INVALID_ARG.]*/
-    /*Codes_SRS_IOTHUBCLIENT_LL_02_035: [If optionName is NULL then IoTHubClientCore_LL_SetOption shall return IOTHUB_CLIENT_INVALID_ARG.] */
-    /*Codes_SRS_IOTHUBCLIENT_LL_02_036: [If value is NULL then IoTHubClientCore_LL_SetOption shall return IOTHUB_CLIENT_INVALID_ARG.] */
-    if (
-        (iotHubClientHandle == NULL) ||
-        (optionName == NULL) ||
-        (value == NULL)
-        )
-    {
-        result = IOTHUB_CLIENT_INVALID_ARG;
-        LogError("invalid argument (NULL)");
-    }
-    else
-    {
-        IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)iotHubClientHandle;
+            if ((rateLimits->telemetry.per_second < 0) || (rateLimits->twin_updates.per_second < 0) || (rateLimits->method_responses.per_second < 0) ||
+                ((size_t)rateLimits->tier >= sizeof(HUB_TIER_QUOTAS) / sizeof(HUB_TIER_QUOTAS[0])))
+            {
+                LogError("Invalid rate limits (tier=%d)", (int)rateLimits->tier);
+                result = IOTHUB_CLIENT_INVALID_ARG;
+            }
+            else
+            {
+                const HUB_TIER_QUOTA* quota = &HUB_TIER_QUOTAS[rateLimits->tier];
+                size_t units = (rateLimits->hub_units == 0) ? 1 : rateLimits->hub_units;
+                size_t devices = (rateLimits->devices == 0) ? 1 : rateLimits->devices;
 
-        /*Codes_SRS_IOTHUBCLIENT_LL_02_039: [ "messageTimeout" - once IoTHubClientCore_LL_SendEventAsync is called the message shall timeout after value miliseconds. Value is a pointer to a tickcounter_ms_t. ]*/
-        if (strcmp(optionName, OPTION_MESSAGE_TIMEOUT) == 0)
-        {
-            /*this is an option handled by IoTHubClientCore_LL*/
-            /*Codes_SRS_IOTHUBCLIENT_LL_02_043: [ Calling IoTHubClientCore_LL_SetOption with value set to "0" shall disable the timeout mechanism for all new messages. ]*/
-            handleData->currentMessageTimeout = *(const tickcounter_ms_t*)value;
-            result = IOTHUB_CLIENT_OK;
+                if (handleData->heldEvents.Flink == NULL)
+                {
+                    DList_InitializeListHead(&(handleData->heldEvents));
+                }
+                if (handleData->pendingMethodResponses.Flink == NULL)
+                {
+                    DList_InitializeListHead(&(handleData->pendingMethodResponses));
+                }
+
+                configure_rate_limit(&handleData->eventRateLimit, &rateLimits->telemetry, get_tier_share(quota->telemetry_minimum, quota->telemetry_per_unit, units, devices));
+                configure_rate_limit(&handleData->twinRateLimit, &rateLimits->twin_updates, get_tier_share(quota->twin_minimum, quota->twin_per_unit, units, devices));
+                configure_rate_limit(&handleData->methodRateLimit, &rateLimits->method_responses, get_tier_share(quota->method_minimum, quota->method_per_unit, units, devices));
+                if (is_rate_limited(handleData) && (tickcounter_get_current_ms(handleData->tickCounter, &handleData->rateLimitsRefilledAt) != 0))
+                {
+                    LogError("unable to get the current ms, the rate limits start refilling at the next DoWork");
+                }
+
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_176: [ If `rate_limits` no longer limits telemetry and `send_window` is not set, IoTHubClientCore_LL_SetOption shall move the held events to waitingToSend, oldest first, before any event queued after it. ]*/
+                if ((handleData->eventRateLimit.refill_per_ms == 0) && (handleData->sendWindowPeriod == 0) && (handleData->heldEventCount > 0))
+                {
+                    release_held_events(handleData);
+                }
+                result = IOTHUB_CLIENT_OK;
+            }
         }
         else if (strcmp(optionName, OPTION_PRODUCT_INFO) == 0)
         {
@@ -2251,6 +5451,7 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SetOption(IOTHUB_CLIENT_CORE_LL_HANDLE
         }
         else if (strcmp(optionName, OPTION_DIAGNOSTIC_SAMPLING_PERCENTAGE) == 0)
         {
+#ifndef DONT_USE_DIAGNOSTICS
             uint32_t percentage = *(uint32_t*)value;
             if (percentage > 100)
             {
@@ -2265,6 +5466,10 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SetOption(IOTHUB_CLIENT_CORE_LL_HANDLE
                 handleData->diagnostic_setting.currentMessageNumber = 0;
                 result = IOTHUB_CLIENT_OK;
             }
+#else
+            LogError("%s option being set with DONT_USE_DIAGNOSTICS compiler switch", optionName);
+            result = IOTHUB_CLIENT_ERROR;
+#endif /*DONT_USE_DIAGNOSTICS*/
         }
         else if ((strcmp(optionName, OPTION_BLOB_UPLOAD_TIMEOUT_SECS) == 0) || (strcmp(optionName, OPTION_CURL_VERBOSE) == 0))
         {
@@ -2334,14 +5539,18 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SetDeviceTwinCallback(IOTHUB_CLIENT_COR
         if (deviceTwinCallback == NULL)
         {
             /* Codes_SRS_IOTHUBCLIENT_LL_10_006: [ If deviceTwinCallback is NULL, then IoTHubClientCore_LL_SetDeviceTwinCallback shall call the underlying layer's _Unsubscribe function and return IOTHUB_CLIENT_OK.] */
-            handleData->IoTHubTransport_Unsubscribe_DeviceTwin(handleData->transportHandle);
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_149: [ While desired property subscriptions remain, removing the device twin callback shall not unsubscribe from the twin and setting it shall not subscribe again. ]*/
+            if (handleData->twinFanout == NULL)
+            {
+                handleData->IoTHubTransport_Unsubscribe_DeviceTwin(handleData->transportHandle);
+            }
             handleData->deviceTwinCallback = NULL;
             result = IOTHUB_CLIENT_OK;
         }
         else
         {
             /* Codes_SRS_IOTHUBCLIENT_LL_10_002: [ If deviceTwinCallback is not NULL, then IoTHubClientCore_LL_SetDeviceTwinCallback shall call the underlying layer's _Subscribe function.] */
-            if (handleData->IoTHubTransport_Subscribe_DeviceTwin(handleData->transportHandle) == 0)
+            if ((handleData->twinFanout != NULL) || (handleData->IoTHubTransport_Subscribe_DeviceTwin(handleData->transportHandle) == 0))
             {
                 handleData->deviceTwinCallback = deviceTwinCallback;
                 handleData->deviceTwinContextCallback = userContextCallback;
@@ -2358,6 +5567,58 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SetDeviceTwinCallback(IOTHUB_CLIENT_COR
     return result;
 }
 
+IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SetDesiredPropertyCallback(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, const char* path, IOTHUB_CLIENT_DESIRED_PROPERTY_CALLBACK desiredPropertyCallback, void* userContextCallback)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_146: [ If iotHubClientHandle or path is NULL, IoTHubClientCore_LL_SetDesiredPropertyCallback shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+    if ((iotHubClientHandle == NULL) || (path == NULL))
+    {
+        LogError("Invalid argument iotHubClientHandle=%p, path=%p", iotHubClientHandle, path);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)iotHubClientHandle;
+        bool firstSubscription = (handleData->twinFanout == NULL);
+
+        if (firstSubscription && ((desiredPropertyCallback == NULL) || ((handleData->twinFanout = twin_fanout_create()) == NULL)))
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_148: [ If the callback is NULL, IoTHubClientCore_LL_SetDesiredPropertyCallback shall remove the subscription of path, return IOTHUB_CLIENT_ERROR if there is none, and unsubscribe from the twin when the last subscription is removed while no device twin callback is set. ]*/
+            LogError("Failed setting the desired property callback of %s", path);
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_147: [ IoTHubClientCore_LL_SetDesiredPropertyCallback shall store the callback of path, replacing the one already registered, and subscribe to the twin when the first subscription is made while no device twin callback is set; it shall return IOTHUB_CLIENT_ERROR if path is not a dot separated path, or allocating or subscribing fails. ]*/
+        else if (twin_fanout_set_callback(handleData->twinFanout, path, desiredPropertyCallback, userContextCallback) != 0)
+        {
+            LogError("Failed setting the desired property callback of %s", path);
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else if (firstSubscription && (handleData->deviceTwinCallback == NULL) && (handleData->IoTHubTransport_Subscribe_DeviceTwin(handleData->transportHandle) != 0))
+        {
+            LogError("Failed subscribing to the twin");
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else
+        {
+            result = IOTHUB_CLIENT_OK;
+        }
+
+        if ((handleData->twinFanout != NULL) && ((twin_fanout_get_count(handleData->twinFanout) == 0) || (firstSubscription && (result != IOTHUB_CLIENT_OK))))
+        {
+            twin_fanout_destroy(handleData->twinFanout);
+            handleData->twinFanout = NULL;
+
+            if (!firstSubscription && (handleData->deviceTwinCallback == NULL))
+            {
+                handleData->IoTHubTransport_Unsubscribe_DeviceTwin(handleData->transportHandle);
+            }
+        }
+    }
+
+    return result;
+}
+
 IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SendReportedState(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, const unsigned char* reportedState, size_t size, IOTHUB_CLIENT_REPORTED_STATE_CALLBACK reportedStateCallback, void* userContextCallback)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -2372,29 +5633,44 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SendReportedState(IOTHUB_CLIENT_CORE_LL
     else
     {
         IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)iotHubClientHandle;
-        /* Codes_SRS_IOTHUBCLIENT_LL_10_014: [IoTHubClientCore_LL_SendReportedState shall construct and queue the reported a Device_Twin structure for transmition by the underlying transport.] */
-        IOTHUB_DEVICE_TWIN* client_data = dev_twin_data_create(handleData, get_next_item_id(handleData), reportedState, size, reportedStateCallback, userContextCallback);
-        if (client_data == NULL)
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_034: [ If `twin_coalesce_window` is set and the newest queued reported state is still within its window, IoTHubClientCore_LL_SendReportedState shall merge reportedState into it with twin_patch_merge instead of queuing a new one, and queue it on its own if they cannot be merged. ]*/
+        if ((handleData->twinCoalesceWindow != 0 || handleData->twinCoalesceOffline) &&
+            coalesce_reported_state(handleData, reportedState, size, reportedStateCallback, userContextCallback) == 0)
         {
-            /* Codes_SRS_IOTHUBCLIENT_LL_10_015: [If any error is encountered IoTHubClientCore_LL_SendReportedState shall return IOTHUB_CLIENT_ERROR.] */
-            LogError("Failure constructing device twin data");
-            result = IOTHUB_CLIENT_ERROR;
+            result = IOTHUB_CLIENT_OK;
         }
         else
         {
-            if (handleData->IoTHubTransport_Subscribe_DeviceTwin(handleData->transportHandle) != 0)
+            /* Codes_SRS_IOTHUBCLIENT_LL_10_014: [IoTHubClientCore_LL_SendReportedState shall construct and queue the reported a Device_Twin structure for transmition by the underlying transport.] */
+            IOTHUB_DEVICE_TWIN* client_data = dev_twin_data_create(handleData, get_next_item_id(handleData), reportedState, size, reportedStateCallback, userContextCallback);
+            if (client_data == NULL)
             {
-                LogError("Failure adding device twin data to queue");
-                device_twin_data_destroy(client_data);
+                /* Codes_SRS_IOTHUBCLIENT_LL_10_015: [If any error is encountered IoTHubClientCore_LL_SendReportedState shall return IOTHUB_CLIENT_ERROR.] */
+                LogError("Failure constructing device twin data");
                 result = IOTHUB_CLIENT_ERROR;
             }
             else
             {
-                /* Codes_SRS_IOTHUBCLIENT_LL_07_001: [ IoTHubClientCore_LL_SendReportedState shall queue the constructed reportedState data to be consumed by the targeted transport. ] */
-                DList_InsertTailList(&(iotHubClientHandle->iot_msg_queue), &(client_data->entry));
+                if (handleData->IoTHubTransport_Subscribe_DeviceTwin(handleData->transportHandle) != 0)
+                {
+                    LogError("Failure adding device twin data to queue");
+                    device_twin_data_destroy(client_data);
+                    result = IOTHUB_CLIENT_ERROR;
+                }
+                else
+                {
+                    tickcounter_ms_t now;
+                    if (handleData->twinCoalesceWindow != 0 && tickcounter_get_current_ms(handleData->tickCounter, &now) == 0)
+                    {
+                        client_data->ms_coalesce_until = now + handleData->twinCoalesceWindow;
+                    }
 
-                /* Codes_SRS_IOTHUBCLIENT_LL_10_016: [ Otherwise IoTHubClientCore_LL_SendReportedState shall succeed and return IOTHUB_CLIENT_OK.] */
-                result = IOTHUB_CLIENT_OK;
+                    /* Codes_SRS_IOTHUBCLIENT_LL_07_001: [ IoTHubClientCore_LL_SendReportedState shall queue the constructed reportedState data to be consumed by the targeted transport. ] */
+                    DList_InsertTailList(&(iotHubClientHandle->iot_msg_queue), &(client_data->entry));
+
+                    /* Codes_SRS_IOTHUBCLIENT_LL_10_016: [ Otherwise IoTHubClientCore_LL_SendReportedState shall succeed and return IOTHUB_CLIENT_OK.] */
+                    result = IOTHUB_CLIENT_OK;
+                }
             }
         }
     }
@@ -2488,7 +5764,11 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SetDeviceMethodCallback(IOTHUB_CLIENT_C
                 /*Codes_SRS_IOTHUBCLIENT_LL_02_019: [If parameter messageCallback is NULL then IoTHubClientCore_LL_SetMessageCallback shall call the underlying layer's _Unsubscribe function and return IOTHUB_CLIENT_OK.] */
                 /*Codes_SRS_IOTHUBCLIENT_LL_12_018: [If deviceMethodCallback is NULL, then IoTHubClientCore_LL_SetDeviceMethodCallback shall call the underlying layer's IoTHubTransport_Unsubscribe_DeviceMethod function and return IOTHUB_CLIENT_OK. ] */
                 /*Codes_SRS_IOTHUBCLIENT_LL_12_022: [ Otherwise IoTHubClientCore_LL_SetDeviceMethodCallback shall succeed and return IOTHUB_CLIENT_OK. ]*/
-                handleData->IoTHubTransport_Unsubscribe_DeviceMethod(handleData->deviceHandle);
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_085: [ While method handlers are registered, removing the device method callback shall not unsubscribe from methods and setting it shall not subscribe again. ]*/
+                if (handleData->methodHandlerCount == 0)
+                {
+                    handleData->IoTHubTransport_Unsubscribe_DeviceMethod(handleData->deviceHandle);
+                }
                 handleData->methodCallback.type = CALLBACK_TYPE_NONE;
                 handleData->methodCallback.callbackSync = NULL;
                 handleData->methodCallback.userContextCallback = NULL;
@@ -2506,7 +5786,7 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SetDeviceMethodCallback(IOTHUB_CLIENT_C
             else
             {
                 /*Codes_SRS_IOTHUBCLIENT_LL_12_019: [ If deviceMethodCallback is not NULL, then IoTHubClientCore_LL_SetDeviceMethodCallback shall call the underlying layer's IoTHubTransport_Subscribe_DeviceMethod function. ]*/
-                if (handleData->IoTHubTransport_Subscribe_DeviceMethod(handleData->deviceHandle) == 0)
+                if ((handleData->methodHandlerCount > 0) || (handleData->IoTHubTransport_Subscribe_DeviceMethod(handleData->deviceHandle) == 0))
                 {
                     /*Codes_SRS_IOTHUBCLIENT_LL_12_022: [ Otherwise IoTHubClientCore_LL_SetDeviceMethodCallback shall succeed and return IOTHUB_CLIENT_OK. ]*/
                     handleData->methodCallback.type = CALLBACK_TYPE_SYNC;
@@ -2561,7 +5841,11 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SetDeviceMethodCallback_Ex(IOTHUB_CLIEN
             else
             {
                 /* Codes_SRS_IOTHUBCLIENT_LL_07_022: [ If inboundDeviceMethodCallback is NULL then IoTHubClientCore_LL_SetDeviceMethodCallback_Ex shall call the underlying layer's IoTHubTransport_Unsubscribe_DeviceMethod function and return IOTHUB_CLIENT_OK.] */
-                handleData->IoTHubTransport_Unsubscribe_DeviceMethod(handleData->deviceHandle);
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_085: [ While method handlers are registered, removing the device method callback shall not unsubscribe from methods and setting it shall not subscribe again. ]*/
+                if (handleData->methodHandlerCount == 0)
+                {
+                    handleData->IoTHubTransport_Unsubscribe_DeviceMethod(handleData->deviceHandle);
+                }
                 handleData->methodCallback.type = CALLBACK_TYPE_NONE;
                 handleData->methodCallback.callbackAsync = NULL;
                 handleData->methodCallback.userContextCallback = NULL;
@@ -2579,7 +5863,7 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SetDeviceMethodCallback_Ex(IOTHUB_CLIEN
             else
             {
                 /* Codes_SRS_IOTHUBCLIENT_LL_07_023: [ If inboundDeviceMethodCallback is non-NULL then IoTHubClientCore_LL_SetDeviceMethodCallback_Ex shall call the underlying layer's IoTHubTransport_Subscribe_DeviceMethod function.]*/
-                if (handleData->IoTHubTransport_Subscribe_DeviceMethod(handleData->deviceHandle) == 0)
+                if ((handleData->methodHandlerCount > 0) || (handleData->IoTHubTransport_Subscribe_DeviceMethod(handleData->deviceHandle) == 0))
                 {
                     handleData->methodCallback.type = CALLBACK_TYPE_ASYNC;
                     handleData->methodCallback.callbackAsync = inboundDeviceMethodCallback;
@@ -2603,6 +5887,104 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SetDeviceMethodCallback_Ex(IOTHUB_CLIEN
     return result;
 }
 
+static IOTHUB_CLIENT_RESULT set_device_method_handler(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, const char* methodName, CALLBACK_TYPE type, IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC callbackSync, IOTHUB_CLIENT_INBOUND_DEVICE_METHOD_CALLBACK callbackAsync, void* userContextCallback)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_081: [ If iotHubClientHandle or methodName is NULL, IoTHubClientCore_LL_SetDeviceMethodHandler shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+    if ((iotHubClientHandle == NULL) || (methodName == NULL))
+    {
+        LogError("Invalid argument iotHubClientHandle=%p, methodName=%p", iotHubClientHandle, methodName);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)iotHubClientHandle;
+        size_t methodNameLength;
+        uint32_t methodNameHash = hash_name(methodName, &methodNameLength);
+        IOTHUB_METHOD_HANDLER** link = find_method_handler_link(handleData, methodName, methodNameLength, methodNameHash);
+        IOTHUB_METHOD_HANDLER* handler = *link;
+
+        if (type == CALLBACK_TYPE_NONE)
+        {
+            if (handler == NULL)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_083: [ If the callback is NULL, IoTHubClientCore_LL_SetDeviceMethodHandler shall remove the handler of methodName, return IOTHUB_CLIENT_ERROR if there is none, and unsubscribe from methods when the last handler is removed while no device method callback is set. ]*/
+                LogError("No handler is registered for method %s", methodName);
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                *link = handler->nextInBucket;
+                STRING_delete(handler->methodName);
+                free(handler);
+                handleData->methodHandlerCount--;
+
+                if ((handleData->methodHandlerCount == 0) && (handleData->methodCallback.type == CALLBACK_TYPE_NONE))
+                {
+                    handleData->IoTHubTransport_Unsubscribe_DeviceMethod(handleData->deviceHandle);
+                }
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        else if (handler != NULL)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_082: [ IoTHubClientCore_LL_SetDeviceMethodHandler shall store the callback of methodName, replacing the one already registered, and subscribe to methods when the first handler is registered while no device method callback is set; it shall return IOTHUB_CLIENT_ERROR if allocating or subscribing fails. ]*/
+            handler->callback.type = type;
+            handler->callback.callbackSync = callbackSync;
+            handler->callback.callbackAsync = callbackAsync;
+            handler->callback.userContextCallback = userContextCallback;
+            result = IOTHUB_CLIENT_OK;
+        }
+        else if ((handler = (IOTHUB_METHOD_HANDLER*)malloc(sizeof(IOTHUB_METHOD_HANDLER))) == NULL)
+        {
+            LogError("Failed allocating method handler");
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else if ((handler->methodName = STRING_construct(methodName)) == NULL)
+        {
+            LogError("Failed copying method name");
+            free(handler);
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else if ((handleData->methodHandlerCount == 0) &&
+            (handleData->methodCallback.type == CALLBACK_TYPE_NONE) &&
+            (handleData->IoTHubTransport_Subscribe_DeviceMethod(handleData->deviceHandle) != 0))
+        {
+            LogError("IoTHubTransport_Subscribe_DeviceMethod failed");
+            STRING_delete(handler->methodName);
+            free(handler);
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else
+        {
+            handler->methodNameHash = methodNameHash;
+            handler->methodNameLength = methodNameLength;
+            handler->callback.type = type;
+            handler->callback.callbackSync = callbackSync;
+            handler->callback.callbackAsync = callbackAsync;
+            handler->callback.userContextCallback = userContextCallback;
+            handler->nextInBucket = NULL;
+            *link = handler;
+            handleData->methodHandlerCount++;
+            result = IOTHUB_CLIENT_OK;
+        }
+    }
+
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SetDeviceMethodHandler(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, const char* methodName, IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC deviceMethodCallback, void* userContextCallback)
+{
+    return set_device_method_handler(iotHubClientHandle, methodName, (deviceMethodCallback == NULL) ? CALLBACK_TYPE_NONE : CALLBACK_TYPE_SYNC, deviceMethodCallback, NULL, userContextCallback);
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SetDeviceMethodHandler_Ex(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, const char* methodName, IOTHUB_CLIENT_INBOUND_DEVICE_METHOD_CALLBACK inboundDeviceMethodCallback, void* userContextCallback)
+{
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_086: [ IoTHubClientCore_LL_SetDeviceMethodHandler_Ex shall behave as IoTHubClientCore_LL_SetDeviceMethodHandler for a handler that answers later through IoTHubClientCore_LL_DeviceMethodResponse. ]*/
+    return set_device_method_handler(iotHubClientHandle, methodName, (inboundDeviceMethodCallback == NULL) ? CALLBACK_TYPE_NONE : CALLBACK_TYPE_ASYNC, NULL, inboundDeviceMethodCallback, userContextCallback);
+}
+
 IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_DeviceMethodResponse(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, METHOD_HANDLE methodId, const unsigned char* response, size_t response_size, int status_response)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -2615,15 +5997,30 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_DeviceMethodResponse(IOTHUB_CLIENT_CORE
     else
     {
         IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_CORE_LL_HANDLE_DATA*)iotHubClientHandle;
-        /* Codes_SRS_IOTHUBCLIENT_LL_07_027: [ IoTHubClientCore_LL_DeviceMethodResponse shall call the IoTHubTransport_DeviceMethod_Response transport function.] */
-        if (handleData->IoTHubTransport_DeviceMethod_Response(handleData->deviceHandle, methodId, response, response_size, status_response) != 0)
+
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_090: [ Once OPTION_METHOD_MAX_IN_FLIGHT or OPTION_METHOD_RESPONSE_TIMEOUT_SECS was set, IoTHubClientCore_LL_DeviceMethodResponse shall return IOTHUB_CLIENT_ERROR without calling the transport for a methodId that is not in flight, for instance one that already timed out. ]*/
+        if (handleData->methodTracking && !take_method_in_flight(handleData, methodId))
         {
-            LogError("IoTHubTransport_DeviceMethod_Response failed");
+            LogError("method request %p is not in flight, it may have timed out", methodId);
             result = IOTHUB_CLIENT_ERROR;
         }
         else
         {
-            result = IOTHUB_CLIENT_OK;
+            if (handleData->statisticsEnabled && handleData->statistics.methods_awaiting_response > 0)
+            {
+                handleData->statistics.methods_awaiting_response--;
+            }
+
+            /* Codes_SRS_IOTHUBCLIENT_LL_07_027: [ IoTHubClientCore_LL_DeviceMethodResponse shall call the IoTHubTransport_DeviceMethod_Response transport function.] */
+            if (respond_to_method(handleData, methodId, response, response_size, status_response) != 0)
+            {
+                LogError("IoTHubTransport_DeviceMethod_Response failed");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                result = IOTHUB_CLIENT_OK;
+            }
         }
     }
     return result;
@@ -2713,9 +6110,30 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_UploadMultipleBlocksToBlobEx(IOTHUB_CLI
     }
     return result;
 }
+
+IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_UploadFileToBlob(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, const char* destinationFileName, const char* sourceFilePath)
+{
+    IOTHUB_CLIENT_RESULT result;
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_052: [ If `iotHubClientHandle`, `destinationFileName` or `sourceFilePath` is `NULL` then `IoTHubClientCore_LL_UploadFileToBlob` shall fail and return `IOTHUB_CLIENT_INVALID_ARG`. ]*/
+    if (
+        (iotHubClientHandle == NULL) ||
+        (destinationFileName == NULL) ||
+        (sourceFilePath == NULL)
+        )
+    {
+        LogError("invalid parameters IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle=%p, destinationFileName=%p, sourceFilePath=%p", iotHubClientHandle, destinationFileName, sourceFilePath);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_053: [ Otherwise `IoTHubClientCore_LL_UploadFileToBlob` shall call `IoTHubClient_LL_UploadFileToBlob_Impl` and return its result. ]*/
+        result = IoTHubClient_LL_UploadFileToBlob_Impl(iotHubClientHandle->uploadToBlobHandle, destinationFileName, sourceFilePath);
+    }
+    return result;
+}
 #endif // DONT_USE_UPLOADTOBLOB
 
-IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SendEventToOutputAsync(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, const char* outputName, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+static IOTHUB_CLIENT_RESULT send_event_to_output_async(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, const char* outputName, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback, bool takeOwnership)
 {
     IOTHUB_CLIENT_RESULT result;
 
@@ -2734,7 +6152,7 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SendEventToOutputAsync(IOTHUB_CLIENT_CO
             result = IOTHUB_CLIENT_ERROR;
         }
         // Codes_SRS_IOTHUBCLIENT_LL_31_129: [ `IoTHubClient_LL_SendEventToOutputAsync` shall invoke `IoTHubClient_LL_SendEventAsync` to send the message. ]
-        else if ((result = IoTHubClientCore_LL_SendEventAsync(iotHubClientHandle, eventMessageHandle, eventConfirmationCallback, userContextCallback)) != IOTHUB_CLIENT_OK)
+        else if ((result = send_event_async(iotHubClientHandle, eventMessageHandle, eventConfirmationCallback, userContextCallback, takeOwnership)) != IOTHUB_CLIENT_OK)
         {
             LogError("Call into IoTHubClient_LL_SendEventAsync failed, result=%d", result);
         }
@@ -2743,6 +6161,17 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SendEventToOutputAsync(IOTHUB_CLIENT_CO
     return result;
 }
 
+IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SendEventToOutputAsync(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, const char* outputName, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    return send_event_to_output_async(iotHubClientHandle, eventMessageHandle, outputName, eventConfirmationCallback, userContextCallback, false);
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_SendEventToOutputAsync_TakeOwnership(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, const char* outputName, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_015: [ IoTHubClientCore_LL_SendEventToOutputAsync_TakeOwnership shall set the output name on eventMessageHandle and queue it the same way as IoTHubClientCore_LL_SendEventAsync_TakeOwnership. ]*/
+    return send_event_to_output_async(iotHubClientHandle, eventMessageHandle, outputName, eventConfirmationCallback, userContextCallback, true);
+}
+
 
 static IOTHUB_CLIENT_RESULT create_event_handler_callback(IOTHUB_CLIENT_CORE_LL_HANDLE_DATA* handleData, const char* inputName, IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC callbackSync, IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC_EX callbackSyncEx, void* userContextCallback, void* userContextCallbackEx, size_t userContextCallbackExLength)
 {
@@ -2818,6 +6247,11 @@ static IOTHUB_CLIENT_RESULT create_event_handler_callback(IOTHUB_CLIENT_CORE_LL_
                 }
                 else
                 {
+                    if (add_to_list == true)
+                    {
+                        index_event_callback(handleData, event_callback, inputName);
+                    }
+
                     if (userContextCallbackEx != NULL)
                     {
                         // Codes_SRS_IOTHUBCLIENT_LL_31_141: [`IoTHubClient_LL_SetInputMessageCallbackEx` shall copy the data passed in extended context. ]
@@ -2858,6 +6292,7 @@ static IOTHUB_CLIENT_RESULT remove_event_unsubscribe_if_needed(IOTHUB_CLIENT_COR
         }
         else
         {
+            unindex_event_callback(handleData, event_callback);
             delete_event(event_callback);
             // Codes_SRS_IOTHUBCLIENT_LL_31_131: [ If `eventHandlerCallback` is NULL, `IoTHubClient_LL_SetInputMessageCallback` shall remove the `inputName` from its callback list if present. ]
             if (singlylinkedlist_remove(handleData->event_callbacks, item_handle) != 0)
@@ -2949,7 +6384,9 @@ int IoTHubClientCore_LL_GetTransportCallbacks(TRANSPORT_CALLBACKS_INFO* transpor
         transport_cb->prod_info_cb = IoTHubClientCore_LL_GetProductInfo;
         transport_cb->msg_input_cb = IoTHubClientCore_LL_MessageCallbackFromInput;
         transport_cb->msg_cb = IoTHubClientCore_LL_MessageCallback;
+        transport_cb->msg_chunk_cb = IoTHubClientCore_LL_MessageChunkCallback;
         transport_cb->method_complete_cb = IoTHubClientCore_LL_DeviceMethodComplete;
+        transport_cb->statistics_cb = IoTHubClientCore_LL_StatisticsCallback;
         result = 0;
     }
     return result;
@@ -2978,6 +6415,28 @@ IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_GenericMethodInvoke(IOTHUB_CLIENT_CORE_
     }
     return result;
 }
+
+IOTHUB_CLIENT_RESULT IoTHubClientCore_LL_GenericMethodInvokeAsync(IOTHUB_CLIENT_CORE_LL_HANDLE iotHubClientHandle, const char* deviceId, const char* moduleId, const char* methodName, const char* methodPayload, unsigned int timeout, IOTHUB_METHOD_INVOKE_CALLBACK methodInvokeCallback, void* context)
+{
+    IOTHUB_CLIENT_RESULT result;
+    if (iotHubClientHandle != NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_079: [ IoTHubClientCore_LL_GenericMethodInvokeAsync shall queue the invoke on the Edge handle and return without waiting for the response, which is reported from IoTHubClientCore_LL_DoWork. ]*/
+        if (moduleId != NULL)
+        {
+            result = IoTHubClient_Edge_ModuleMethodInvokeAsync(iotHubClientHandle->methodHandle, deviceId, moduleId, methodName, methodPayload, timeout, methodInvokeCallback, context);
+        }
+        else
+        {
+            result = IoTHubClient_Edge_DeviceMethodInvokeAsync(iotHubClientHandle->methodHandle, deviceId, methodName, methodPayload, timeout, methodInvokeCallback, context);
+        }
+    }
+    else
+    {
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    return result;
+}
 #endif
 
 /*end*/
@@ -8,28 +8,22 @@
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/agenttime.h"
-#include "azure_c_shared_utility/buffer_.h"
 
 #include "internal/iothub_client_diagnostic.h"
 
 #define TIME_STRING_BUFFER_LEN 30
+#define DIAGNOSTIC_ID_LENGTH 8
 
 static const int BASE_36 = 36;
 
 #define INDEFINITE_TIME ((time_t)-1)
 
-static char* get_epoch_time(char* timeBuffer)
+static char* get_epoch_time(time_t epochTime, char* timeBuffer)
 {
     char* result;
-    time_t epochTime;
     int timeLen = sizeof(time_t);
 
-    if ((epochTime = get_time(NULL)) == INDEFINITE_TIME)
-    {
-        LogError("Failed getting current time");
-        result = NULL;
-    }
-    else if (timeLen == sizeof(int64_t))
+    if (timeLen == sizeof(int64_t))
     {
         if (sprintf(timeBuffer, "%"PRIu64, (int64_t)epochTime) < 0)
         {
@@ -67,17 +61,31 @@ static char get_base36_char(unsigned char value)
     return value <= 9 ? '0' + value : 'a' + value - 10;
 }
 
-static char* generate_eight_random_characters(char *randomString)
+/*xorshift32, a few instructions per draw and no shared state unlike rand()*/
+static uint32_t get_next_random(IOTHUB_DIAGNOSTIC_SETTING_DATA* diagSetting)
+{
+    uint32_t state = diagSetting->randomState;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    diagSetting->randomState = state;
+    return state;
+}
+
+static char* generate_eight_random_characters(IOTHUB_DIAGNOSTIC_SETTING_DATA* diagSetting, char *randomString)
 {
     int i;
     char* randomStringPos = randomString;
-    for (i = 0; i < 4; ++i)
+    for (i = 0; i < 2; ++i)
     {
-        int rawRandom = rand();
-        int first = rawRandom % BASE_36;
-        int second = rawRandom / BASE_36 % BASE_36;
-        *randomStringPos++ = get_base36_char((unsigned char)first);
-        *randomStringPos++ = get_base36_char((unsigned char)second);
+        /*36^4 fits in 32 bits, so each draw gives four characters*/
+        uint32_t rawRandom = get_next_random(diagSetting);
+        int j;
+        for (j = 0; j < 4; ++j)
+        {
+            *randomStringPos++ = get_base36_char((unsigned char)(rawRandom % BASE_36));
+            rawRandom /= BASE_36;
+        }
     }
     *randomStringPos = 0;
 
@@ -105,50 +113,30 @@ static bool should_add_diagnostic_info(IOTHUB_DIAGNOSTIC_SETTING_DATA* diagSetti
     return result;
 }
 
-static IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DATA* prepare_message_diagnostic_data()
+static int prepare_message_diagnostic_data(IOTHUB_DIAGNOSTIC_SETTING_DATA* diagSetting, char* diagId, char* timeBuffer)
 {
-    IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DATA* result = (IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DATA*)malloc(sizeof(IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DATA));
-    if (result == NULL)
+    int result;
+    time_t epochTime;
+
+    if ((epochTime = get_time(NULL)) == INDEFINITE_TIME)
     {
-        LogError("malloc for DiagnosticData failed");
+        LogError("Failed getting current time");
+        result = __FAILURE__;
+    }
+    else if (get_epoch_time(epochTime, timeBuffer) == NULL)
+    {
+        LogError("Failed formatting current time");
+        result = __FAILURE__;
     }
     else
     {
-        char* diagId = (char*)malloc(9);
-        if (diagId == NULL)
-        {
-            LogError("malloc for diagId failed");
-            free(result);
-            result = NULL;
-        }
-        else
+        if (diagSetting->randomState == 0)
         {
-            char* timeBuffer;
-
-            (void)generate_eight_random_characters(diagId);
-            result->diagnosticId = diagId;
-
-            timeBuffer = (char*)malloc(TIME_STRING_BUFFER_LEN);
-            if (timeBuffer == NULL)
-            {
-                LogError("malloc for timeBuffer failed");
-                free(result->diagnosticId);
-                free(result);
-                result = NULL;
-            }
-            else if (get_epoch_time(timeBuffer) == NULL)
-            {
-                LogError("Failed getting current time");
-                free(result->diagnosticId);
-                free(result);
-                free(timeBuffer);
-                result = NULL;
-            }
-            else
-            {
-                result->diagnosticCreationTimeUtc = timeBuffer;
-            }
+            /*Codes_SRS_IOTHUB_DIAGNOSTIC_41_002: [ The diagnostic id shall be 8 base 36 characters from a xorshift generator kept in `randomState`, seeded from the current time on the first sampled message. ]*/
+            diagSetting->randomState = ((uint32_t)epochTime ^ (uint32_t)(uintptr_t)diagSetting) | 1;
         }
+        (void)generate_eight_random_characters(diagSetting, diagId);
+        result = 0;
     }
     return result;
 }
@@ -167,14 +155,21 @@ int IoTHubClient_Diagnostic_AddIfNecessary(IOTHUB_DIAGNOSTIC_SETTING_DATA* diagS
         /* Codes_SRS_IOTHUB_DIAGNOSTIC_13_004: [ If diagSamplingPercentage is equal to 100, diagnostic properties should be added to all messages]*/
         /* Codes_SRS_IOTHUB_DIAGNOSTIC_13_005: [ If diagSamplingPercentage is between(0, 100), diagnostic properties should be added based on percentage]*/
 
-        IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DATA* diagnosticData;
-        if ((diagnosticData = prepare_message_diagnostic_data()) == NULL)
+        /* Codes_SRS_IOTHUB_DIAGNOSTIC_41_001: [ IoTHubClient_Diagnostic_AddIfNecessary shall build the diagnostic id and creation time on the stack, without allocating memory. ]*/
+        char diagId[DIAGNOSTIC_ID_LENGTH + 1];
+        char timeBuffer[TIME_STRING_BUFFER_LEN];
+        IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DATA diagnosticData;
+
+        if (prepare_message_diagnostic_data(diagSetting, diagId, timeBuffer) != 0)
         {
             result = __FAILURE__;
         }
         else
         {
-            if (IoTHubMessage_SetDiagnosticPropertyData(messageHandle, diagnosticData) != IOTHUB_MESSAGE_OK)
+            diagnosticData.diagnosticId = diagId;
+            diagnosticData.diagnosticCreationTimeUtc = timeBuffer;
+
+            if (IoTHubMessage_SetDiagnosticPropertyData(messageHandle, &diagnosticData) != IOTHUB_MESSAGE_OK)
             {
                 /* Codes_SRS_IOTHUB_DIAGNOSTIC_13_002: [ IoTHubClient_Diagnostic_AddIfNecessary should return nonezero if failing to add diagnostic property. ]*/
                 result = __FAILURE__;
@@ -183,11 +178,6 @@ int IoTHubClient_Diagnostic_AddIfNecessary(IOTHUB_DIAGNOSTIC_SETTING_DATA* diagS
             {
                 result = 0;
             }
-
-            free(diagnosticData->diagnosticCreationTimeUtc);
-            free(diagnosticData->diagnosticId);
-            free(diagnosticData);
-            diagnosticData = NULL;
         }
     }
     else
@@ -14,6 +14,12 @@
 #include "azure_c_shared_utility/shared_util_options.h"
 #include "azure_c_shared_utility/crt_abstractions.h"
 #include "azure_c_shared_utility/envvariable.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/agenttime.h"
+#include "azure_c_shared_utility/singlylinkedlist.h"
+#include "azure_c_shared_utility/platform.h"
+#include "azure_c_shared_utility/tlsio.h"
+#include "azure_uhttp_c/uhttp.h"
 
 #include "parson.h"
 
@@ -26,8 +32,8 @@
 #define  HTTP_HEADER_KEY_AUTHORIZATION  "Authorization"
 #define  HTTP_HEADER_VAL_AUTHORIZATION  " "
 #define  HTTP_HEADER_KEY_MODULE_ID  "x-ms-edge-moduleId"
-#define  HTTP_HEADER_VAL_MODULE_ID  " "
 #define  HTTP_HEADER_KEY_REQUEST_ID  "Request-Id"
+#define  HTTP_HEADER_VAL_REQUEST_ID  " "
 #define  HTTP_HEADER_KEY_USER_AGENT  "User-Agent"
 #define  HTTP_HEADER_VAL_USER_AGENT  CLIENT_DEVICE_TYPE_PREFIX CLIENT_DEVICE_BACKSLASH IOTHUB_SDK_VERSION
 #define  HTTP_HEADER_KEY_CONTENT_TYPE  "Content-Type"
@@ -35,6 +41,7 @@
 #define  UID_LENGTH 37
 
 #define SASTOKEN_LIFETIME 3600
+#define INDEFINITE_TIME ((time_t)(-1))
 
 static const char* const URL_API_VERSION = "?api-version=2018-06-27";
 static const char* const RELATIVE_PATH_FMT_MODULE_METHOD = "/twins/%s/modules/%s/methods%s";
@@ -45,14 +52,81 @@ static const char* const SCOPE_FMT = "%s/devices/%s/modules/%s";
 static const char* ENVIRONMENT_VAR_EDGEHUB_CACERTIFICATEFILE = "EdgeModuleCACertificateFile";
 
 
+/*a connection whose SAS token has less than this many seconds left gets a new token before its next invoke*/
+#define SASTOKEN_REFRESH_MARGIN 300
+
+typedef struct EDGE_HTTP_CONNECTION_TAG
+{
+    HTTPAPIEX_HANDLE httpApiExHandle;
+    HTTP_HEADERS_HANDLE httpHeader;
+    size_t sasTokenGeneration;  /*generation of the SAS token in the Authorization header, 0 while it has none*/
+} EDGE_HTTP_CONNECTION;
+
+/*asynchronous invokes are spread over at most this many connections, the others wait for one to be free*/
+#define EDGE_ASYNC_CONNECTION_COUNT 4
+/*seconds an asynchronous invoke may wait for edgeHub beyond the timeout of the method itself*/
+#define EDGE_ASYNC_TIMEOUT_MARGIN 30
+#define HTTPS_PORT_NUM 443
+
+typedef enum EDGE_ASYNC_CONNECTION_STATE_TAG
+{
+    EDGE_ASYNC_CONNECTION_OPENING,
+    EDGE_ASYNC_CONNECTION_IDLE,
+    EDGE_ASYNC_CONNECTION_BUSY,
+    EDGE_ASYNC_CONNECTION_FAILED
+} EDGE_ASYNC_CONNECTION_STATE;
+
+struct EDGE_ASYNC_CONNECTION_TAG;
+
+typedef struct EDGE_ASYNC_INVOKE_TAG
+{
+    BUFFER_HANDLE httpPayloadBuffer;
+    STRING_HANDLE relativePath;
+    unsigned int timeout;
+    time_t queuedTime;
+    IOTHUB_METHOD_INVOKE_CALLBACK methodInvokeCallback;
+    void* context;
+    struct EDGE_ASYNC_CONNECTION_TAG* connection;   /*connection carrying the request, NULL while it waits for one*/
+    bool completed;
+    IOTHUB_CLIENT_RESULT result;
+    int responseStatus;
+    unsigned char* responsePayload;
+    size_t responsePayloadSize;
+} EDGE_ASYNC_INVOKE;
+
+typedef struct EDGE_ASYNC_CONNECTION_TAG
+{
+    HTTP_CLIENT_HANDLE httpClient;
+    HTTP_HEADERS_HANDLE httpHeader;
+    size_t sasTokenGeneration;
+    EDGE_ASYNC_CONNECTION_STATE state;
+    EDGE_ASYNC_INVOKE* invoke;  /*invoke in flight, NULL unless the connection is busy*/
+} EDGE_ASYNC_CONNECTION;
+
 typedef struct IOTHUB_CLIENT_EDGE_HANDLE_DATA_TAG
 {
     char* hostname;
     char* deviceId;
     char* moduleId;
     IOTHUB_AUTHORIZATION_HANDLE authorizationHandle;
+    LOCK_HANDLE lock;                       /*guards the fields below, invokes run on several threads*/
+    EDGE_HTTP_CONNECTION* idleConnection;   /*connection kept open between invokes, NULL while none is idle*/
+    char* sasToken;
+    time_t sasTokenExpiry;
+    size_t sasTokenGeneration;
+    /*asynchronous invokes are only touched by the thread calling IoTHubClient_Edge_DoWork, they need no lock*/
+    SINGLYLINKEDLIST_HANDLE asyncInvokes;   /*EDGE_ASYNC_INVOKE*, in call order; NULL until the first one*/
+    EDGE_ASYNC_CONNECTION* asyncConnections[EDGE_ASYNC_CONNECTION_COUNT];
 } IOTHUB_CLIENT_EDGE_HANDLE_DATA;
 
+static void destroyAsyncInvokes(IOTHUB_CLIENT_EDGE_HANDLE moduleMethodHandle);
+
+static void destroyHttpConnection(EDGE_HTTP_CONNECTION* connection)
+{
+    HTTPAPIEX_Destroy(connection->httpApiExHandle);
+    HTTPHeaders_Free(connection->httpHeader);
+    free(connection);
+}
 
 IOTHUB_CLIENT_EDGE_HANDLE IoTHubClient_EdgeHandle_Create(const IOTHUB_CLIENT_CONFIG* config, IOTHUB_AUTHORIZATION_HANDLE authorizationHandle, const char* module_id)
 {
@@ -91,6 +165,12 @@ IOTHUB_CLIENT_EDGE_HANDLE IoTHubClient_EdgeHandle_Create(const IOTHUB_CLIENT_CON
             IoTHubClient_EdgeHandle_Destroy(handleData);
             handleData = NULL;
         }
+        else if ((handleData->lock = Lock_Init()) == NULL)
+        {
+            LogError("Lock_Init failed");
+            IoTHubClient_EdgeHandle_Destroy(handleData);
+            handleData = NULL;
+        }
     }
 
     return (IOTHUB_CLIENT_EDGE_HANDLE)handleData;
@@ -100,6 +180,16 @@ void IoTHubClient_EdgeHandle_Destroy(IOTHUB_CLIENT_EDGE_HANDLE methodHandle)
 {
     if (methodHandle != NULL)
     {
+        destroyAsyncInvokes(methodHandle);
+        if (methodHandle->idleConnection != NULL)
+        {
+            destroyHttpConnection(methodHandle->idleConnection);
+        }
+        if (methodHandle->lock != NULL)
+        {
+            Lock_Deinit(methodHandle->lock);
+        }
+        free(methodHandle->sasToken);
         free(methodHandle->hostname);
         free(methodHandle->deviceId);
         free(methodHandle->moduleId);
@@ -108,154 +198,267 @@ void IoTHubClient_EdgeHandle_Destroy(IOTHUB_CLIENT_EDGE_HANDLE methodHandle)
     }
 }
 
-static const char* generateGuid(void)
-{
-    char* result;
-
-    if ((result = malloc(UID_LENGTH)) != NULL)
-    {
-        result[0] = '\0';
-        if (UniqueId_Generate(result, UID_LENGTH) != UNIQUEID_OK)
-        {
-            LogError("UniqueId_Generate failed");
-            free((void*)result);
-            result = NULL;
-        }
-    }
-    return (const char*)result;
-}
-
-static HTTP_HEADERS_HANDLE createHttpHeader()
+static HTTP_HEADERS_HANDLE createHttpHeader(IOTHUB_CLIENT_EDGE_HANDLE moduleMethodHandle)
 {
     HTTP_HEADERS_HANDLE httpHeader;
-    const char* guid;
+    STRING_HANDLE moduleHeader;
+    const char* moduleHeader_s;
 
-    if ((httpHeader = HTTPHeaders_Alloc()) == NULL)
-    {
-        LogError("HTTPHeaders_Alloc failed");
-    }
-    else if (HTTPHeaders_AddHeaderNameValuePair(httpHeader, HTTP_HEADER_KEY_AUTHORIZATION, HTTP_HEADER_VAL_AUTHORIZATION) != HTTP_HEADERS_OK)
+    // Only Authorization and Request-Id change between invokes; they are replaced before each request.
+    if ((moduleHeader = STRING_construct_sprintf("%s/%s", moduleMethodHandle->deviceId, moduleMethodHandle->moduleId)) == NULL)
     {
-        LogError("HTTPHeaders_AddHeaderNameValuePair failed for Authorization header");
-        HTTPHeaders_Free(httpHeader);
+        LogError("Failure constructing module ID header");
         httpHeader = NULL;
     }
-    else if (HTTPHeaders_AddHeaderNameValuePair(httpHeader, HTTP_HEADER_KEY_MODULE_ID, HTTP_HEADER_VAL_MODULE_ID) != HTTP_HEADERS_OK)
+    else if ((moduleHeader_s = STRING_c_str(moduleHeader)) == NULL)
     {
-        LogError("HTTPHeaders_AddHeaderNameValuePair failed for module ID header");
-        HTTPHeaders_Free(httpHeader);
+        LogError("Failure constructing module ID header");
+        STRING_delete(moduleHeader);
         httpHeader = NULL;
     }
-    else if ((guid = generateGuid()) == NULL)
+    else
     {
-        LogError("GUID creation failed");
-        HTTPHeaders_Free(httpHeader);
-        httpHeader = NULL;
+        if ((httpHeader = HTTPHeaders_Alloc()) == NULL)
+        {
+            LogError("HTTPHeaders_Alloc failed");
+        }
+        else if (HTTPHeaders_AddHeaderNameValuePair(httpHeader, HTTP_HEADER_KEY_AUTHORIZATION, HTTP_HEADER_VAL_AUTHORIZATION) != HTTP_HEADERS_OK)
+        {
+            LogError("HTTPHeaders_AddHeaderNameValuePair failed for Authorization header");
+            HTTPHeaders_Free(httpHeader);
+            httpHeader = NULL;
+        }
+        else if (HTTPHeaders_AddHeaderNameValuePair(httpHeader, HTTP_HEADER_KEY_MODULE_ID, moduleHeader_s) != HTTP_HEADERS_OK)
+        {
+            LogError("HTTPHeaders_AddHeaderNameValuePair failed for module ID header");
+            HTTPHeaders_Free(httpHeader);
+            httpHeader = NULL;
+        }
+        else if (HTTPHeaders_AddHeaderNameValuePair(httpHeader, HTTP_HEADER_KEY_REQUEST_ID, HTTP_HEADER_VAL_REQUEST_ID) != HTTP_HEADERS_OK)
+        {
+            LogError("HTTPHeaders_AddHeaderNameValuePair failed for RequestId header");
+            HTTPHeaders_Free(httpHeader);
+            httpHeader = NULL;
+        }
+        else if (HTTPHeaders_AddHeaderNameValuePair(httpHeader, HTTP_HEADER_KEY_USER_AGENT, HTTP_HEADER_VAL_USER_AGENT) != HTTP_HEADERS_OK)
+        {
+            LogError("HTTPHeaders_AddHeaderNameValuePair failed for User-Agent header");
+            HTTPHeaders_Free(httpHeader);
+            httpHeader = NULL;
+        }
+        else if (HTTPHeaders_AddHeaderNameValuePair(httpHeader, HTTP_HEADER_KEY_CONTENT_TYPE, HTTP_HEADER_VAL_CONTENT_TYPE) != HTTP_HEADERS_OK)
+        {
+            LogError("HTTPHeaders_AddHeaderNameValuePair failed for Content-Type header");
+            HTTPHeaders_Free(httpHeader);
+            httpHeader = NULL;
+        }
+
+        STRING_delete(moduleHeader);
     }
-    else if (HTTPHeaders_AddHeaderNameValuePair(httpHeader, HTTP_HEADER_KEY_REQUEST_ID, guid) != HTTP_HEADERS_OK)
+
+    return httpHeader;
+}
+
+static EDGE_HTTP_CONNECTION* createHttpConnection(IOTHUB_CLIENT_EDGE_HANDLE moduleMethodHandle)
+{
+    EDGE_HTTP_CONNECTION* result;
+    char* trustedCertificate;
+
+    if ((result = malloc(sizeof(EDGE_HTTP_CONNECTION))) == NULL)
     {
-        LogError("HTTPHeaders_AddHeaderNameValuePair failed for RequestId header");
-        free((void*)guid);
-        HTTPHeaders_Free(httpHeader);
-        httpHeader = NULL;
+        LogError("memory allocation error");
     }
-    else if (HTTPHeaders_AddHeaderNameValuePair(httpHeader, HTTP_HEADER_KEY_USER_AGENT, HTTP_HEADER_VAL_USER_AGENT) != HTTP_HEADERS_OK)
+    else
     {
-        LogError("HTTPHeaders_AddHeaderNameValuePair failed for User-Agent header");
-        free((void*)guid);
-        HTTPHeaders_Free(httpHeader);
-        httpHeader = NULL;
+        // The environment variable ENVIRONMENT_VAR_EDGEHUB_CACERTIFICATEFILE is *optional*; it will not be present in 
+        // fact in the vast majority of production scenarios.  Its presence has underlying layer override where it 
+        // retrieves trusted certificates from.
+        const char* caTrustedCertificateFile = environment_get_variable(ENVIRONMENT_VAR_EDGEHUB_CACERTIFICATEFILE);
+
+        memset(result, 0, sizeof(EDGE_HTTP_CONNECTION));
+
+        if ((result->httpHeader = createHttpHeader(moduleMethodHandle)) == NULL)
+        {
+            LogError("HttpHeader creation failed");
+            free(result);
+            result = NULL;
+        }
+        else if ((result->httpApiExHandle = HTTPAPIEX_Create(moduleMethodHandle->hostname)) == NULL)
+        {
+            LogError("HTTPAPIEX_Create failed");
+            HTTPHeaders_Free(result->httpHeader);
+            free(result);
+            result = NULL;
+        }
+        else if ((trustedCertificate = IoTHubClient_Auth_Get_TrustBundle(moduleMethodHandle->authorizationHandle, caTrustedCertificateFile)) == NULL)
+        {
+            LogError("Failed to get TrustBundle");
+            destroyHttpConnection(result);
+            result = NULL;
+        }
+        else
+        {
+            if (HTTPAPIEX_SetOption(result->httpApiExHandle, OPTION_TRUSTED_CERT, trustedCertificate) != HTTPAPIEX_OK)
+            {
+                LogError("Setting trusted certificate failed");
+                destroyHttpConnection(result);
+                result = NULL;
+            }
+
+            free(trustedCertificate);
+        }
     }
-    else if (HTTPHeaders_AddHeaderNameValuePair(httpHeader, HTTP_HEADER_KEY_CONTENT_TYPE, HTTP_HEADER_VAL_CONTENT_TYPE) != HTTP_HEADERS_OK)
+
+    return result;
+}
+
+/*must be called with the lock held*/
+static IOTHUB_CLIENT_RESULT refreshSasToken(IOTHUB_CLIENT_EDGE_HANDLE moduleMethodHandle)
+{
+    IOTHUB_CLIENT_RESULT result;
+    time_t now = get_time(NULL);
+
+    if ((moduleMethodHandle->sasToken != NULL) && (now != INDEFINITE_TIME) &&
+        (get_difftime(moduleMethodHandle->sasTokenExpiry, now) > SASTOKEN_REFRESH_MARGIN))
     {
-        LogError("HTTPHeaders_AddHeaderNameValuePair failed for Content-Type header");
-        free((void*)guid);
-        HTTPHeaders_Free(httpHeader);
-        httpHeader = NULL;
+        result = IOTHUB_CLIENT_OK;
     }
     else
     {
-        free((void*)guid);
+        STRING_HANDLE scope;
+        const char* scope_s;
+        char* sastoken;
+
+        if ((scope = STRING_construct_sprintf(SCOPE_FMT, moduleMethodHandle->hostname, moduleMethodHandle->deviceId, moduleMethodHandle->moduleId)) == NULL)
+        {
+            LogError("Failed constructing scope");
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else
+        {
+            if ((scope_s = STRING_c_str(scope)) == NULL)
+            {
+                LogError("SasToken generation failed");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else if ((sastoken = IoTHubClient_Auth_Get_SasToken(moduleMethodHandle->authorizationHandle, scope_s, SASTOKEN_LIFETIME, NULL)) == NULL)
+            {
+                LogError("SasToken generation failed");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                free(moduleMethodHandle->sasToken);
+                moduleMethodHandle->sasToken = sastoken;
+                // Without a clock the token cannot be aged, so a new one is made for every invoke.
+                moduleMethodHandle->sasTokenExpiry = (now == INDEFINITE_TIME) ? INDEFINITE_TIME : now + SASTOKEN_LIFETIME;
+                moduleMethodHandle->sasTokenGeneration++;
+                result = IOTHUB_CLIENT_OK;
+            }
+
+            STRING_delete(scope);
+        }
     }
 
-    return httpHeader;
+    return result;
 }
 
-static IOTHUB_CLIENT_RESULT populateHttpHeader(HTTP_HEADERS_HANDLE httpHeader,  IOTHUB_CLIENT_EDGE_HANDLE moduleMethodHandle)
+static IOTHUB_CLIENT_RESULT populateHttpHeader(HTTP_HEADERS_HANDLE httpHeader, size_t* sasTokenGeneration, IOTHUB_CLIENT_EDGE_HANDLE moduleMethodHandle)
 {
     IOTHUB_CLIENT_RESULT result;
-    STRING_HANDLE scope;
-    const char* scope_s;
-    STRING_HANDLE moduleHeader;
-    const char* moduleHeader_s;
-    char* sastoken;
+    char guid[UID_LENGTH];
 
-    if ((scope = STRING_construct_sprintf(SCOPE_FMT, moduleMethodHandle->hostname, moduleMethodHandle->deviceId, moduleMethodHandle->moduleId)) == NULL)
+    if (Lock(moduleMethodHandle->lock) != LOCK_OK)
     {
-        LogError("Failed constructing scope");
-        HTTPHeaders_Free(httpHeader);
+        LogError("Failed to lock");
         result = IOTHUB_CLIENT_ERROR;
     }
-    else if ((scope_s = STRING_c_str(scope)) == NULL)
+    else
     {
-        LogError("SasToken generation failed");
-        HTTPHeaders_Free(httpHeader);
-        STRING_delete(scope);
-        result = IOTHUB_CLIENT_ERROR;
+        if (refreshSasToken(moduleMethodHandle) != IOTHUB_CLIENT_OK)
+        {
+            LogError("SasToken generation failed");
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else if ((*sasTokenGeneration != moduleMethodHandle->sasTokenGeneration) &&
+            (HTTPHeaders_ReplaceHeaderNameValuePair(httpHeader, HTTP_HEADER_KEY_AUTHORIZATION, moduleMethodHandle->sasToken) != HTTP_HEADERS_OK))
+        {
+            LogError("Failure updating Http Headers");
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else
+        {
+            *sasTokenGeneration = moduleMethodHandle->sasTokenGeneration;
+            result = IOTHUB_CLIENT_OK;
+        }
+
+        (void)Unlock(moduleMethodHandle->lock);
     }
-    else if ((sastoken = IoTHubClient_Auth_Get_SasToken(moduleMethodHandle->authorizationHandle, scope_s, SASTOKEN_LIFETIME, NULL)) == NULL)
+
+    if (result == IOTHUB_CLIENT_OK)
     {
-        LogError("SasToken generation failed");
-        HTTPHeaders_Free(httpHeader);
-        STRING_delete(scope);
-        result = IOTHUB_CLIENT_ERROR;
+        guid[0] = '\0';
+        if (UniqueId_Generate(guid, UID_LENGTH) != UNIQUEID_OK)
+        {
+            LogError("UniqueId_Generate failed");
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else if (HTTPHeaders_ReplaceHeaderNameValuePair(httpHeader, HTTP_HEADER_KEY_REQUEST_ID, guid) != HTTP_HEADERS_OK)
+        {
+            LogError("HTTPHeaders_ReplaceHeaderNameValuePair failed for RequestId header");
+            result = IOTHUB_CLIENT_ERROR;
+        }
     }
-    else if (HTTPHeaders_ReplaceHeaderNameValuePair(httpHeader, HTTP_HEADER_KEY_AUTHORIZATION, sastoken) != HTTP_HEADERS_OK)
+
+    return result;
+}
+
+static EDGE_HTTP_CONNECTION* acquireHttpConnection(IOTHUB_CLIENT_EDGE_HANDLE moduleMethodHandle)
+{
+    EDGE_HTTP_CONNECTION* result = NULL;
+
+    if (Lock(moduleMethodHandle->lock) != LOCK_OK)
     {
-        LogError("Failure updating Http Headers");
-        HTTPHeaders_Free(httpHeader);
-        STRING_delete(scope);
-        free(sastoken);
-        result = IOTHUB_CLIENT_ERROR;
+        LogError("Failed to lock, opening a new connection");
     }
-    else if ((moduleHeader = STRING_construct_sprintf("%s/%s", moduleMethodHandle->deviceId, moduleMethodHandle->moduleId)) == NULL)
+    else
     {
-        LogError("Failure updating Http Headers");
-        HTTPHeaders_Free(httpHeader);
-        STRING_delete(scope);
-        free(sastoken);
-        result = IOTHUB_CLIENT_ERROR;
+        result = moduleMethodHandle->idleConnection;
+        moduleMethodHandle->idleConnection = NULL;
+        (void)Unlock(moduleMethodHandle->lock);
     }
-    else if ((moduleHeader_s = STRING_c_str(moduleHeader)) == NULL)
+
+    if (result == NULL)
     {
-        LogError("Failure updating Http Headers");
-        HTTPHeaders_Free(httpHeader);
-        STRING_delete(scope);
-        free(sastoken);
-        STRING_delete(moduleHeader);
-        result = IOTHUB_CLIENT_ERROR;
+        result = createHttpConnection(moduleMethodHandle);
     }
-    else if (HTTPHeaders_ReplaceHeaderNameValuePair(httpHeader, HTTP_HEADER_KEY_MODULE_ID, moduleHeader_s) != HTTP_HEADERS_OK)
+
+    return result;
+}
+
+static void releaseHttpConnection(IOTHUB_CLIENT_EDGE_HANDLE moduleMethodHandle, EDGE_HTTP_CONNECTION* connection)
+{
+    // Concurrent invokes each open their own connection; only one is kept for the next invoke.
+    if (Lock(moduleMethodHandle->lock) != LOCK_OK)
     {
-        LogError("Failure updating Http Headers");
-        HTTPHeaders_Free(httpHeader);
-        STRING_delete(scope);
-        free(sastoken);
-        STRING_delete(moduleHeader);
-        result = IOTHUB_CLIENT_ERROR;
+        LogError("Failed to lock, closing the connection");
+        destroyHttpConnection(connection);
     }
     else
     {
-        STRING_delete(scope);
-        STRING_delete(moduleHeader);
-        free(sastoken);
-        result = IOTHUB_CLIENT_OK;
+        if (moduleMethodHandle->idleConnection == NULL)
+        {
+            moduleMethodHandle->idleConnection = connection;
+        }
+        else
+        {
+            destroyHttpConnection(connection);
+        }
+        (void)Unlock(moduleMethodHandle->lock);
     }
-
-    return result;
 }
 
-static IOTHUB_CLIENT_RESULT parseResponseJson(BUFFER_HANDLE responseJson, int* responseStatus, unsigned char** responsePayload, size_t* responsePayloadSize)
+static IOTHUB_CLIENT_RESULT parseResponseContent(const unsigned char* content, size_t contentLength, int* responseStatus, unsigned char** responsePayload, size_t* responsePayloadSize)
 {
     IOTHUB_CLIENT_RESULT result;
     JSON_Value* root_value;
@@ -265,14 +468,8 @@ static IOTHUB_CLIENT_RESULT parseResponseJson(BUFFER_HANDLE responseJson, int* r
     char* payload;
     STRING_HANDLE jsonStringHandle;
     const char* jsonStr;
-    unsigned char* bufferStr;
 
-    if ((bufferStr = BUFFER_u_char(responseJson)) == NULL)
-    {
-        LogError("BUFFER_u_char failed");
-        result = IOTHUB_CLIENT_ERROR;
-    }
-    else if ((jsonStringHandle = STRING_from_byte_array(bufferStr, BUFFER_length(responseJson))) == NULL)
+    if ((jsonStringHandle = STRING_from_byte_array(content, contentLength)) == NULL)
     {
         LogError("STRING_construct_n failed");
         result = IOTHUB_CLIENT_ERROR;
@@ -331,6 +528,24 @@ static IOTHUB_CLIENT_RESULT parseResponseJson(BUFFER_HANDLE responseJson, int* r
     return result;
 }
 
+static IOTHUB_CLIENT_RESULT parseResponseJson(BUFFER_HANDLE responseJson, int* responseStatus, unsigned char** responsePayload, size_t* responsePayloadSize)
+{
+    IOTHUB_CLIENT_RESULT result;
+    unsigned char* bufferStr;
+
+    if ((bufferStr = BUFFER_u_char(responseJson)) == NULL)
+    {
+        LogError("BUFFER_u_char failed");
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else
+    {
+        result = parseResponseContent(bufferStr, BUFFER_length(responseJson), responseStatus, responsePayload, responsePayloadSize);
+    }
+
+    return result;
+}
+
 static BUFFER_HANDLE createMethodPayloadJson(const char* methodName, unsigned int timeout, const char* payload)
 {
     STRING_HANDLE stringHandle;
@@ -376,70 +591,48 @@ static IOTHUB_CLIENT_RESULT sendHttpRequestMethod(IOTHUB_CLIENT_EDGE_HANDLE modu
 {
     IOTHUB_CLIENT_RESULT result;
 
-    HTTPAPIEX_HANDLE httpExApiHandle;
-    HTTP_HEADERS_HANDLE httpHeader;
+    EDGE_HTTP_CONNECTION* connection;
     STRING_HANDLE relativePath;
     const char* relativePath_s;
-    char* trustedCertificate;
     unsigned int statusCode = 0;
 
-    // The environment variable ENVIRONMENT_VAR_EDGEHUB_CACERTIFICATEFILE is *optional*; it will not be present in 
-    // fact in the vast majority of production scenarios.  Its presence has underlying layer override where it 
-    // retrieves trusted certificates from.
-    const char* caTrustedCertificateFile = environment_get_variable(ENVIRONMENT_VAR_EDGEHUB_CACERTIFICATEFILE);
-
-    if ((httpHeader = createHttpHeader()) == NULL)
+    if ((connection = acquireHttpConnection(moduleMethodHandle)) == NULL)
     {
-        LogError("HttpHeader creation failed");
+        LogError("Http connection creation failed");
         result = IOTHUB_CLIENT_ERROR;
     }
-    else if (populateHttpHeader(httpHeader, moduleMethodHandle) != IOTHUB_CLIENT_OK)
+    else if (populateHttpHeader(connection->httpHeader, &connection->sasTokenGeneration, moduleMethodHandle) != IOTHUB_CLIENT_OK)
     {
         LogError("HttpHeader creation failed");
+        releaseHttpConnection(moduleMethodHandle, connection);
         result = IOTHUB_CLIENT_ERROR;
     }
     else if ((relativePath = createRelativePath(deviceId, moduleId)) == NULL)
     {
         LogError("Failure creating relative path");
-        HTTPHeaders_Free(httpHeader);
+        releaseHttpConnection(moduleMethodHandle, connection);
         result = IOTHUB_CLIENT_ERROR;
     }
     else if ((relativePath_s = STRING_c_str(relativePath)) == NULL)
     {
-        LogError("HTTPAPIEX_Create failed");
-        HTTPHeaders_Free(httpHeader);
-        STRING_delete(relativePath);
-        result = IOTHUB_CLIENT_ERROR;
-    }
-    else if ((httpExApiHandle = HTTPAPIEX_Create(moduleMethodHandle->hostname)) == NULL)
-    {
-        LogError("HTTPAPIEX_Create failed");
-        HTTPHeaders_Free(httpHeader);
-        STRING_delete(relativePath);
-        result = IOTHUB_CLIENT_ERROR;
-    }
-    else if ((trustedCertificate = IoTHubClient_Auth_Get_TrustBundle(moduleMethodHandle->authorizationHandle, caTrustedCertificateFile)) == NULL)
-    {
-        LogError("Failed to get TrustBundle");
-        HTTPHeaders_Free(httpHeader);
+        LogError("Failure creating relative path");
+        releaseHttpConnection(moduleMethodHandle, connection);
         STRING_delete(relativePath);
-        HTTPAPIEX_Destroy(httpExApiHandle);
         result = IOTHUB_CLIENT_ERROR;
     }
     else
     {
-        if (HTTPAPIEX_SetOption(httpExApiHandle, OPTION_TRUSTED_CERT, trustedCertificate) != HTTPAPIEX_OK)
-        {
-            LogError("Setting trusted certificate failed");
-            result = IOTHUB_CLIENT_ERROR;
-        }
-        else if (HTTPAPIEX_ExecuteRequest(httpExApiHandle, HTTPAPI_REQUEST_POST, relativePath_s, httpHeader, deviceJsonBuffer, &statusCode, NULL, responseBuffer) != HTTPAPIEX_OK)
+        if (HTTPAPIEX_ExecuteRequest(connection->httpApiExHandle, HTTPAPI_REQUEST_POST, relativePath_s, connection->httpHeader, deviceJsonBuffer, &statusCode, NULL, responseBuffer) != HTTPAPIEX_OK)
         {
             LogError("HTTPAPIEX_ExecuteRequest failed");
+            // The state of the connection is unknown, the next invoke opens a new one.
+            destroyHttpConnection(connection);
             result = IOTHUB_CLIENT_ERROR;
         }
         else
         {
+            releaseHttpConnection(moduleMethodHandle, connection);
+
             if (statusCode == 200)
             {
                 result = IOTHUB_CLIENT_OK;
@@ -451,10 +644,7 @@ static IOTHUB_CLIENT_RESULT sendHttpRequestMethod(IOTHUB_CLIENT_EDGE_HANDLE modu
             }
         }
 
-        HTTPHeaders_Free(httpHeader);
         STRING_delete(relativePath);
-        HTTPAPIEX_Destroy(httpExApiHandle);
-        free(trustedCertificate);
     }
 
     return result;
@@ -534,4 +724,444 @@ IOTHUB_CLIENT_RESULT IoTHubClient_Edge_ModuleMethodInvoke(IOTHUB_CLIENT_EDGE_HAN
     }
     return result;
 }
+
+static void completeAsyncInvoke(EDGE_ASYNC_INVOKE* invoke, IOTHUB_CLIENT_RESULT result)
+{
+    if (invoke->connection != NULL)
+    {
+        invoke->connection->invoke = NULL;
+        invoke->connection = NULL;
+    }
+    invoke->completed = true;
+    invoke->result = result;
+}
+
+static void freeAsyncInvoke(EDGE_ASYNC_INVOKE* invoke)
+{
+    BUFFER_delete(invoke->httpPayloadBuffer);
+    STRING_delete(invoke->relativePath);
+    free(invoke->responsePayload);
+    free(invoke);
+}
+
+static void on_edge_async_http_error(void* callback_ctx, HTTP_CALLBACK_REASON error_result)
+{
+    EDGE_ASYNC_CONNECTION* connection = (EDGE_ASYNC_CONNECTION*)callback_ctx;
+
+    LogError("edgeHub connection error, reason=%d", error_result);
+    connection->state = EDGE_ASYNC_CONNECTION_FAILED;
+}
+
+static void on_edge_async_http_connected(void* callback_ctx, HTTP_CALLBACK_REASON open_result)
+{
+    EDGE_ASYNC_CONNECTION* connection = (EDGE_ASYNC_CONNECTION*)callback_ctx;
+
+    if (open_result != HTTP_CALLBACK_REASON_OK)
+    {
+        LogError("Failed opening edgeHub connection, reason=%d", open_result);
+        connection->state = EDGE_ASYNC_CONNECTION_FAILED;
+    }
+    else if (connection->state == EDGE_ASYNC_CONNECTION_OPENING)
+    {
+        connection->state = EDGE_ASYNC_CONNECTION_IDLE;
+    }
+}
+
+static void on_edge_async_http_reply(void* callback_ctx, HTTP_CALLBACK_REASON request_result, const unsigned char* content, size_t content_length, unsigned int status_code, HTTP_HEADERS_HANDLE response_headers)
+{
+    EDGE_ASYNC_CONNECTION* connection = (EDGE_ASYNC_CONNECTION*)callback_ctx;
+    EDGE_ASYNC_INVOKE* invoke = connection->invoke;
+    (void)response_headers;
+
+    if (invoke == NULL)
+    {
+        // The invoke timed out or the handle is being destroyed.
+        LogError("edgeHub reply without a pending method invoke");
+    }
+    else if (request_result != HTTP_CALLBACK_REASON_OK)
+    {
+        LogError("Failure sending HTTP request for method invoke, reason=%d", request_result);
+        completeAsyncInvoke(invoke, IOTHUB_CLIENT_ERROR);
+        connection->state = EDGE_ASYNC_CONNECTION_FAILED;
+    }
+    else
+    {
+        IOTHUB_CLIENT_RESULT result;
+
+        if (status_code != 200)
+        {
+            LogError("Http Failure status code %d.", status_code);
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else if (content == NULL)
+        {
+            LogError("Http response has no content");
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else if ((result = parseResponseContent(content, content_length, &invoke->responseStatus, &invoke->responsePayload, &invoke->responsePayloadSize)) != IOTHUB_CLIENT_OK)
+        {
+            LogError("Failure parsing response");
+        }
+
+        completeAsyncInvoke(invoke, result);
+        connection->state = EDGE_ASYNC_CONNECTION_IDLE;
+    }
+}
+
+static EDGE_ASYNC_CONNECTION* openAsyncConnection(IOTHUB_CLIENT_EDGE_HANDLE moduleMethodHandle)
+{
+    EDGE_ASYNC_CONNECTION* result;
+
+    if ((result = malloc(sizeof(EDGE_ASYNC_CONNECTION))) == NULL)
+    {
+        LogError("memory allocation error");
+    }
+    else
+    {
+        const char* caTrustedCertificateFile = environment_get_variable(ENVIRONMENT_VAR_EDGEHUB_CACERTIFICATEFILE);
+        const IO_INTERFACE_DESCRIPTION* tlsioInterface;
+        TLSIO_CONFIG tlsioConfig;
+        char* trustedCertificate;
+
+        memset(result, 0, sizeof(EDGE_ASYNC_CONNECTION));
+        result->state = EDGE_ASYNC_CONNECTION_OPENING;
+
+        memset(&tlsioConfig, 0, sizeof(TLSIO_CONFIG));
+        tlsioConfig.hostname = moduleMethodHandle->hostname;
+        tlsioConfig.port = HTTPS_PORT_NUM;
+
+        if ((result->httpHeader = createHttpHeader(moduleMethodHandle)) == NULL)
+        {
+            LogError("HttpHeader creation failed");
+            free(result);
+            result = NULL;
+        }
+        else if ((tlsioInterface = platform_get_default_tlsio()) == NULL)
+        {
+            LogError("platform_get_default_tlsio failed");
+            HTTPHeaders_Free(result->httpHeader);
+            free(result);
+            result = NULL;
+        }
+        else if ((result->httpClient = uhttp_client_create(tlsioInterface, &tlsioConfig, on_edge_async_http_error, result)) == NULL)
+        {
+            LogError("uhttp_client_create failed");
+            HTTPHeaders_Free(result->httpHeader);
+            free(result);
+            result = NULL;
+        }
+        else if ((trustedCertificate = IoTHubClient_Auth_Get_TrustBundle(moduleMethodHandle->authorizationHandle, caTrustedCertificateFile)) == NULL)
+        {
+            LogError("Failed to get TrustBundle");
+            uhttp_client_destroy(result->httpClient);
+            HTTPHeaders_Free(result->httpHeader);
+            free(result);
+            result = NULL;
+        }
+        else
+        {
+            if (uhttp_client_set_trusted_cert(result->httpClient, trustedCertificate) != HTTP_CLIENT_OK)
+            {
+                LogError("Setting trusted certificate failed");
+                uhttp_client_destroy(result->httpClient);
+                HTTPHeaders_Free(result->httpHeader);
+                free(result);
+                result = NULL;
+            }
+            else if (uhttp_client_open(result->httpClient, moduleMethodHandle->hostname, HTTPS_PORT_NUM, on_edge_async_http_connected, result) != HTTP_CLIENT_OK)
+            {
+                LogError("uhttp_client_open failed");
+                uhttp_client_destroy(result->httpClient);
+                HTTPHeaders_Free(result->httpHeader);
+                free(result);
+                result = NULL;
+            }
+
+            free(trustedCertificate);
+        }
+    }
+
+    return result;
+}
+
+static void closeAsyncConnection(EDGE_ASYNC_CONNECTION* connection)
+{
+    if (connection->invoke != NULL)
+    {
+        completeAsyncInvoke(connection->invoke, IOTHUB_CLIENT_ERROR);
+    }
+    uhttp_client_close(connection->httpClient, NULL, NULL);
+    uhttp_client_destroy(connection->httpClient);
+    HTTPHeaders_Free(connection->httpHeader);
+    free(connection);
+}
+
+static void sendAsyncInvoke(IOTHUB_CLIENT_EDGE_HANDLE moduleMethodHandle, EDGE_ASYNC_CONNECTION* connection, EDGE_ASYNC_INVOKE* invoke)
+{
+    const char* relativePath_s;
+    const unsigned char* content;
+
+    if (populateHttpHeader(connection->httpHeader, &connection->sasTokenGeneration, moduleMethodHandle) != IOTHUB_CLIENT_OK)
+    {
+        LogError("HttpHeader creation failed");
+        completeAsyncInvoke(invoke, IOTHUB_CLIENT_ERROR);
+    }
+    else if ((relativePath_s = STRING_c_str(invoke->relativePath)) == NULL)
+    {
+        LogError("Failure creating relative path");
+        completeAsyncInvoke(invoke, IOTHUB_CLIENT_ERROR);
+    }
+    else if ((content = BUFFER_u_char(invoke->httpPayloadBuffer)) == NULL)
+    {
+        LogError("BUFFER_u_char failed");
+        completeAsyncInvoke(invoke, IOTHUB_CLIENT_ERROR);
+    }
+    else if (uhttp_client_execute_request(connection->httpClient, HTTP_CLIENT_REQUEST_POST, relativePath_s, connection->httpHeader, content, BUFFER_length(invoke->httpPayloadBuffer), on_edge_async_http_reply, connection) != HTTP_CLIENT_OK)
+    {
+        LogError("uhttp_client_execute_request failed");
+        completeAsyncInvoke(invoke, IOTHUB_CLIENT_ERROR);
+        connection->state = EDGE_ASYNC_CONNECTION_FAILED;
+    }
+    else
+    {
+        connection->invoke = invoke;
+        connection->state = EDGE_ASYNC_CONNECTION_BUSY;
+        invoke->connection = connection;
+    }
+}
+
+static bool isAsyncInvokeCompleted(LIST_ITEM_HANDLE list_item, const void* match_context)
+{
+    (void)match_context;
+    return ((const EDGE_ASYNC_INVOKE*)singlylinkedlist_item_get_value(list_item))->completed;
+}
+
+static void reportCompletedAsyncInvokes(IOTHUB_CLIENT_EDGE_HANDLE moduleMethodHandle)
+{
+    LIST_ITEM_HANDLE list_item;
+
+    // A callback may queue another invoke, so the list is searched again after each one.
+    while ((list_item = singlylinkedlist_find(moduleMethodHandle->asyncInvokes, isAsyncInvokeCompleted, NULL)) != NULL)
+    {
+        EDGE_ASYNC_INVOKE* invoke = (EDGE_ASYNC_INVOKE*)singlylinkedlist_item_get_value(list_item);
+        (void)singlylinkedlist_remove(moduleMethodHandle->asyncInvokes, list_item);
+
+        if (invoke->methodInvokeCallback != NULL)
+        {
+            invoke->methodInvokeCallback(invoke->result, invoke->responseStatus, invoke->responsePayload, invoke->responsePayloadSize, invoke->context);
+        }
+        freeAsyncInvoke(invoke);
+    }
+}
+
+static void destroyAsyncInvokes(IOTHUB_CLIENT_EDGE_HANDLE moduleMethodHandle)
+{
+    size_t index;
+    LIST_ITEM_HANDLE list_item;
+
+    for (index = 0; index < EDGE_ASYNC_CONNECTION_COUNT; index++)
+    {
+        if (moduleMethodHandle->asyncConnections[index] != NULL)
+        {
+            closeAsyncConnection(moduleMethodHandle->asyncConnections[index]);
+            moduleMethodHandle->asyncConnections[index] = NULL;
+        }
+    }
+
+    if (moduleMethodHandle->asyncInvokes != NULL)
+    {
+        for (list_item = singlylinkedlist_get_head_item(moduleMethodHandle->asyncInvokes); list_item != NULL; list_item = singlylinkedlist_get_next_item(list_item))
+        {
+            EDGE_ASYNC_INVOKE* invoke = (EDGE_ASYNC_INVOKE*)singlylinkedlist_item_get_value(list_item);
+            if (!invoke->completed)
+            {
+                completeAsyncInvoke(invoke, IOTHUB_CLIENT_ERROR);
+            }
+        }
+
+        reportCompletedAsyncInvokes(moduleMethodHandle);
+        singlylinkedlist_destroy(moduleMethodHandle->asyncInvokes);
+        moduleMethodHandle->asyncInvokes = NULL;
+    }
+}
+
+static IOTHUB_CLIENT_RESULT IoTHubClient_Edge_GenericMethodInvokeAsync(IOTHUB_CLIENT_EDGE_HANDLE moduleMethodHandle, const char* deviceId, const char* moduleId, const char* methodName, const char* methodPayload, unsigned int timeout, IOTHUB_METHOD_INVOKE_CALLBACK methodInvokeCallback, void* context)
+{
+    IOTHUB_CLIENT_RESULT result;
+    EDGE_ASYNC_INVOKE* invoke;
+
+    if ((moduleMethodHandle->asyncInvokes == NULL) && ((moduleMethodHandle->asyncInvokes = singlylinkedlist_create()) == NULL))
+    {
+        LogError("singlylinkedlist_create failed");
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else if ((invoke = malloc(sizeof(EDGE_ASYNC_INVOKE))) == NULL)
+    {
+        LogError("memory allocation error");
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else
+    {
+        memset(invoke, 0, sizeof(EDGE_ASYNC_INVOKE));
+        invoke->timeout = timeout;
+        invoke->methodInvokeCallback = methodInvokeCallback;
+        invoke->context = context;
+
+        if ((invoke->httpPayloadBuffer = createMethodPayloadJson(methodName, timeout, methodPayload)) == NULL)
+        {
+            LogError("BUFFER creation failed for httpPayloadBuffer");
+            free(invoke);
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else if ((invoke->relativePath = createRelativePath(deviceId, moduleId)) == NULL)
+        {
+            LogError("Failure creating relative path");
+            BUFFER_delete(invoke->httpPayloadBuffer);
+            free(invoke);
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else if (singlylinkedlist_add(moduleMethodHandle->asyncInvokes, invoke) == NULL)
+        {
+            LogError("singlylinkedlist_add failed");
+            freeAsyncInvoke(invoke);
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else
+        {
+            invoke->queuedTime = get_time(NULL);
+            result = IOTHUB_CLIENT_OK;
+        }
+    }
+
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_Edge_DeviceMethodInvokeAsync(IOTHUB_CLIENT_EDGE_HANDLE moduleMethodHandle, const char* deviceId, const char* methodName, const char* methodPayload, unsigned int timeout, IOTHUB_METHOD_INVOKE_CALLBACK methodInvokeCallback, void* context)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if ((moduleMethodHandle == NULL) || (deviceId == NULL) || (methodName == NULL) || (methodPayload == NULL))
+    {
+        LogError("Input parameter cannot be NULL");
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        result = IoTHubClient_Edge_GenericMethodInvokeAsync(moduleMethodHandle, deviceId, NULL, methodName, methodPayload, timeout, methodInvokeCallback, context);
+    }
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_Edge_ModuleMethodInvokeAsync(IOTHUB_CLIENT_EDGE_HANDLE moduleMethodHandle, const char* deviceId, const char* moduleId, const char* methodName, const char* methodPayload, unsigned int timeout, IOTHUB_METHOD_INVOKE_CALLBACK methodInvokeCallback, void* context)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if ((moduleMethodHandle == NULL) || (deviceId == NULL) || (moduleId == NULL) || (methodName == NULL) || (methodPayload == NULL))
+    {
+        LogError("Input parameter cannot be NULL");
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        result = IoTHubClient_Edge_GenericMethodInvokeAsync(moduleMethodHandle, deviceId, moduleId, methodName, methodPayload, timeout, methodInvokeCallback, context);
+    }
+    return result;
+}
+
+void IoTHubClient_Edge_DoWork(IOTHUB_CLIENT_EDGE_HANDLE moduleMethodHandle)
+{
+    if ((moduleMethodHandle != NULL) && (moduleMethodHandle->asyncInvokes != NULL))
+    {
+        time_t now = get_time(NULL);
+        size_t waiting = 0;
+        size_t opening = 0;
+        size_t index;
+        LIST_ITEM_HANDLE list_item;
+
+        for (index = 0; index < EDGE_ASYNC_CONNECTION_COUNT; index++)
+        {
+            if (moduleMethodHandle->asyncConnections[index] != NULL)
+            {
+                uhttp_client_dowork(moduleMethodHandle->asyncConnections[index]->httpClient);
+            }
+        }
+
+        for (list_item = singlylinkedlist_get_head_item(moduleMethodHandle->asyncInvokes); list_item != NULL; list_item = singlylinkedlist_get_next_item(list_item))
+        {
+            EDGE_ASYNC_INVOKE* invoke = (EDGE_ASYNC_INVOKE*)singlylinkedlist_item_get_value(list_item);
+
+            if ((!invoke->completed) && (now != INDEFINITE_TIME) && (invoke->queuedTime != INDEFINITE_TIME) &&
+                (get_difftime(now, invoke->queuedTime) > (double)invoke->timeout + EDGE_ASYNC_TIMEOUT_MARGIN))
+            {
+                LogError("Method invoke timed out");
+                if (invoke->connection != NULL)
+                {
+                    // A late reply must not be taken for the next request.
+                    invoke->connection->state = EDGE_ASYNC_CONNECTION_FAILED;
+                }
+                completeAsyncInvoke(invoke, IOTHUB_CLIENT_ERROR);
+            }
+        }
+
+        for (index = 0; index < EDGE_ASYNC_CONNECTION_COUNT; index++)
+        {
+            if ((moduleMethodHandle->asyncConnections[index] != NULL) && (moduleMethodHandle->asyncConnections[index]->state == EDGE_ASYNC_CONNECTION_FAILED))
+            {
+                closeAsyncConnection(moduleMethodHandle->asyncConnections[index]);
+                moduleMethodHandle->asyncConnections[index] = NULL;
+            }
+        }
+
+        for (list_item = singlylinkedlist_get_head_item(moduleMethodHandle->asyncInvokes); list_item != NULL; list_item = singlylinkedlist_get_next_item(list_item))
+        {
+            EDGE_ASYNC_INVOKE* invoke = (EDGE_ASYNC_INVOKE*)singlylinkedlist_item_get_value(list_item);
+
+            if ((!invoke->completed) && (invoke->connection == NULL))
+            {
+                EDGE_ASYNC_CONNECTION* connection = NULL;
+
+                for (index = 0; index < EDGE_ASYNC_CONNECTION_COUNT; index++)
+                {
+                    if ((moduleMethodHandle->asyncConnections[index] != NULL) && (moduleMethodHandle->asyncConnections[index]->state == EDGE_ASYNC_CONNECTION_IDLE))
+                    {
+                        connection = moduleMethodHandle->asyncConnections[index];
+                        break;
+                    }
+                }
+
+                if (connection != NULL)
+                {
+                    sendAsyncInvoke(moduleMethodHandle, connection, invoke);
+                }
+                else
+                {
+                    waiting++;
+                }
+            }
+        }
+
+        // Open connections for the invokes left waiting, up to EDGE_ASYNC_CONNECTION_COUNT in all.
+        for (index = 0; index < EDGE_ASYNC_CONNECTION_COUNT; index++)
+        {
+            if ((moduleMethodHandle->asyncConnections[index] != NULL) && (moduleMethodHandle->asyncConnections[index]->state == EDGE_ASYNC_CONNECTION_OPENING))
+            {
+                opening++;
+            }
+        }
+        for (index = 0; (index < EDGE_ASYNC_CONNECTION_COUNT) && (opening < waiting); index++)
+        {
+            if (moduleMethodHandle->asyncConnections[index] == NULL)
+            {
+                if ((moduleMethodHandle->asyncConnections[index] = openAsyncConnection(moduleMethodHandle)) == NULL)
+                {
+                    LogError("Failed opening edgeHub connection, invokes keep waiting");
+                    break;
+                }
+                opening++;
+            }
+        }
+
+        reportCompletedAsyncInvokes(moduleMethodHandle);
+    }
+}
 #endif /* USE_EDGE_MODULES */
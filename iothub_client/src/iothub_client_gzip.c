@@ -0,0 +1,194 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <zlib.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+#include "internal/iothub_client_gzip.h"
+
+#define GZIP_WINDOW_BITS    (MAX_WBITS + 16) /*+16 makes zlib write a gzip header and trailer instead of a zlib wrapper*/
+#define GZIP_MEMORY_LEVEL   8 /*zlib's default, about 256KB of state*/
+#define GZIP_MAX_CHUNK      (UINT_MAX / 2) /*zlib counts in uInt, larger inputs are compressed in several calls*/
+
+typedef struct GZIP_STREAM_TAG
+{
+    z_stream stream;
+    bool ended;
+} GZIP_STREAM;
+
+/*zlib allocates its state through these so that it goes to the same heap as the rest of the SDK*/
+static voidpf gzip_alloc(voidpf opaque, uInt items, uInt size)
+{
+    (void)opaque;
+    return (((size_t)items * size) / size != items) ? Z_NULL : malloc((size_t)items * size);
+}
+
+static void gzip_free(voidpf opaque, voidpf address)
+{
+    (void)opaque;
+    free(address);
+}
+
+GZIP_STREAM_HANDLE gzip_stream_create(void)
+{
+    GZIP_STREAM* result;
+
+    if ((result = (GZIP_STREAM*)malloc(sizeof(GZIP_STREAM))) == NULL)
+    {
+        /*Codes_SRS_GZIP_41_002: [ If any failure occurs, `gzip_stream_create` shall release all memory it allocated and return NULL. ]*/
+        LogError("unable to allocate the gzip stream");
+    }
+    else
+    {
+        int zlib_result;
+
+        memset(result, 0, sizeof(GZIP_STREAM));
+        result->stream.zalloc = gzip_alloc;
+        result->stream.zfree = gzip_free;
+        result->stream.opaque = Z_NULL;
+
+        /*Codes_SRS_GZIP_41_001: [ `gzip_stream_create` shall initialize a zlib deflate stream writing a gzip header and trailer, at the default compression level. ]*/
+        if ((zlib_result = deflateInit2(&result->stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, GZIP_WINDOW_BITS, GZIP_MEMORY_LEVEL, Z_DEFAULT_STRATEGY)) != Z_OK)
+        {
+            /*Codes_SRS_GZIP_41_002: [ If any failure occurs, `gzip_stream_create` shall release all memory it allocated and return NULL. ]*/
+            LogError("deflateInit2 failed (%d)", zlib_result);
+            free(result);
+            result = NULL;
+        }
+    }
+
+    return result;
+}
+
+void gzip_stream_destroy(GZIP_STREAM_HANDLE gzip_stream)
+{
+    if (gzip_stream == NULL)
+    {
+        LogError("invalid argument gzip_stream is NULL");
+    }
+    else
+    {
+        /*Codes_SRS_GZIP_41_003: [ `gzip_stream_destroy` shall release the zlib stream and the memory of `gzip_stream`. ]*/
+        (void)deflateEnd(&gzip_stream->stream);
+        free(gzip_stream);
+    }
+}
+
+int gzip_stream_compress(GZIP_STREAM_HANDLE gzip_stream, const unsigned char* input, size_t input_size, bool last_input, unsigned char* output, size_t output_size, size_t* input_consumed, size_t* output_written, bool* ended)
+{
+    int result;
+
+    /*Codes_SRS_GZIP_41_004: [ If `gzip_stream`, `output`, `input_consumed`, `output_written` or `ended` is NULL, or `input` is NULL while `input_size` is not 0, `gzip_stream_compress` shall fail and return a non-zero value. ]*/
+    if (gzip_stream == NULL || output == NULL || input_consumed == NULL || output_written == NULL || ended == NULL || (input == NULL && input_size != 0))
+    {
+        LogError("invalid argument gzip_stream=%p, input=%p, output=%p, input_consumed=%p, output_written=%p, ended=%p", gzip_stream, input, output, input_consumed, output_written, ended);
+        result = __FAILURE__;
+    }
+    else if (gzip_stream->ended)
+    {
+        /*Codes_SRS_GZIP_41_005: [ Once the stream ended, `gzip_stream_compress` shall consume and write nothing, set `ended` to true and return 0. ]*/
+        *input_consumed = 0;
+        *output_written = 0;
+        *ended = true;
+        result = 0;
+    }
+    else
+    {
+        /*only the last chunk of the last input may finish the stream*/
+        uInt input_chunk = (uInt)((input_size > GZIP_MAX_CHUNK) ? GZIP_MAX_CHUNK : input_size);
+        uInt output_chunk = (uInt)((output_size > GZIP_MAX_CHUNK) ? GZIP_MAX_CHUNK : output_size);
+        int flush = (last_input && input_chunk == input_size) ? Z_FINISH : Z_NO_FLUSH;
+        int zlib_result;
+
+        gzip_stream->stream.next_in = (Bytef*)input;
+        gzip_stream->stream.avail_in = input_chunk;
+        gzip_stream->stream.next_out = output;
+        gzip_stream->stream.avail_out = output_chunk;
+
+        /*Codes_SRS_GZIP_41_006: [ `gzip_stream_compress` shall deflate as much of `input` into `output` as fits, and report how many bytes it consumed and wrote. ]*/
+        zlib_result = deflate(&gzip_stream->stream, flush);
+        if (zlib_result != Z_OK && zlib_result != Z_STREAM_END && zlib_result != Z_BUF_ERROR)
+        {
+            /*Codes_SRS_GZIP_41_008: [ If deflating fails then `gzip_stream_compress` shall fail and return a non-zero value. ]*/
+            LogError("deflate failed (%d)", zlib_result);
+            result = __FAILURE__;
+        }
+        else
+        {
+            *input_consumed = input_chunk - gzip_stream->stream.avail_in;
+            *output_written = output_chunk - gzip_stream->stream.avail_out;
+
+            /*Codes_SRS_GZIP_41_007: [ When `last_input` is true `gzip_stream_compress` shall flush the stream and set `ended` to true once the gzip trailer has been written. ]*/
+            gzip_stream->ended = (zlib_result == Z_STREAM_END);
+            *ended = gzip_stream->ended;
+            result = 0;
+        }
+
+        gzip_stream->stream.next_in = Z_NULL;
+        gzip_stream->stream.next_out = Z_NULL;
+    }
+
+    return result;
+}
+
+int gzip_compress_buffer(const unsigned char* source, size_t size, unsigned char** compressed, size_t* compressed_size)
+{
+    int result;
+
+    /*Codes_SRS_GZIP_41_009: [ If `compressed` or `compressed_size` is NULL, `source` is NULL while `size` is not 0, or `size` does not fit in one zlib call, `gzip_compress_buffer` shall fail and return a non-zero value. ]*/
+    if (compressed == NULL || compressed_size == NULL || (source == NULL && size != 0) || size > GZIP_MAX_CHUNK)
+    {
+        LogError("invalid argument source=%p, size=%lu, compressed=%p, compressed_size=%p", source, (unsigned long)size, compressed, compressed_size);
+        result = __FAILURE__;
+    }
+    else
+    {
+        GZIP_STREAM_HANDLE gzip_stream = gzip_stream_create();
+        if (gzip_stream == NULL)
+        {
+            /*Codes_SRS_GZIP_41_011: [ If any failure occurs, `gzip_compress_buffer` shall release all memory it allocated and return a non-zero value. ]*/
+            LogError("unable to create the gzip stream");
+            result = __FAILURE__;
+        }
+        else
+        {
+            /*Codes_SRS_GZIP_41_010: [ `gzip_compress_buffer` shall allocate a buffer of the worst case compressed size of `source` and compress `source` into it with a single `gzip_stream_compress` call. ]*/
+            uLong bound = deflateBound(&gzip_stream->stream, (uLong)size);
+            unsigned char* buffer = (unsigned char*)malloc(bound);
+            if (buffer == NULL)
+            {
+                /*Codes_SRS_GZIP_41_011: [ If any failure occurs, `gzip_compress_buffer` shall release all memory it allocated and return a non-zero value. ]*/
+                LogError("unable to allocate %lu bytes for the compressed payload", (unsigned long)bound);
+                result = __FAILURE__;
+            }
+            else
+            {
+                size_t consumed;
+                size_t written;
+                bool ended;
+
+                if (gzip_stream_compress(gzip_stream, source, size, true, buffer, bound, &consumed, &written, &ended) != 0 || !ended)
+                {
+                    /*Codes_SRS_GZIP_41_011: [ If any failure occurs, `gzip_compress_buffer` shall release all memory it allocated and return a non-zero value. ]*/
+                    LogError("unable to compress the payload");
+                    free(buffer);
+                    result = __FAILURE__;
+                }
+                else
+                {
+                    *compressed = buffer;
+                    *compressed_size = written;
+                    result = 0;
+                }
+            }
+            gzip_stream_destroy(gzip_stream);
+        }
+    }
+
+    return result;
+}
@@ -41,6 +41,11 @@ IOTHUB_CLIENT_LL_HANDLE IoTHubClient_LL_CreateWithTransport(const IOTHUB_CLIENT_
     return (IOTHUB_CLIENT_LL_HANDLE)IoTHubClientCore_LL_CreateWithTransport(config);
 }
 
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_CreateBatchWithTransport(const IOTHUB_CLIENT_DEVICE_CONFIG* configs, size_t count, IOTHUB_CLIENT_LL_HANDLE* handles)
+{
+    return IoTHubClientCore_LL_CreateBatchWithTransport(configs, count, (IOTHUB_CLIENT_CORE_LL_HANDLE*)handles);
+}
+
 IOTHUB_CLIENT_LL_HANDLE IoTHubClient_LL_CreateFromDeviceAuth(const char* iothub_uri, const char* device_id, IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol)
 {
     return (IOTHUB_CLIENT_LL_HANDLE)IoTHubClientCore_LL_CreateFromDeviceAuth(iothub_uri, device_id, protocol);
@@ -56,16 +61,51 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_SendEventAsync(IOTHUB_CLIENT_LL_HANDLE iotH
     return IoTHubClientCore_LL_SendEventAsync((IOTHUB_CLIENT_CORE_LL_HANDLE)iotHubClientHandle, eventMessageHandle, eventConfirmationCallback, userContextCallback);
 }
 
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_SendEventAsync_TakeOwnership(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    return IoTHubClientCore_LL_SendEventAsync_TakeOwnership((IOTHUB_CLIENT_CORE_LL_HANDLE)iotHubClientHandle, eventMessageHandle, eventConfirmationCallback, userContextCallback);
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_SendSmallEvent(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, const unsigned char* payload, size_t size, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    return IoTHubClientCore_LL_SendSmallEvent((IOTHUB_CLIENT_CORE_LL_HANDLE)iotHubClientHandle, payload, size, eventConfirmationCallback, userContextCallback);
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_SetEventConfirmationBatchCallback(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_BATCH_CALLBACK eventConfirmationBatchCallback, void* userContextCallback)
+{
+    return IoTHubClientCore_LL_SetEventConfirmationBatchCallback((IOTHUB_CLIENT_CORE_LL_HANDLE)iotHubClientHandle, eventConfirmationBatchCallback, userContextCallback);
+}
+
 IOTHUB_CLIENT_RESULT IoTHubClient_LL_GetSendStatus(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_STATUS *iotHubClientStatus)
 {
     return IoTHubClientCore_LL_GetSendStatus((IOTHUB_CLIENT_CORE_LL_HANDLE)iotHubClientHandle, iotHubClientStatus);
 }
 
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_GetStatistics(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_STATISTICS* statistics)
+{
+    return IoTHubClientCore_LL_GetStatistics((IOTHUB_CLIENT_CORE_LL_HANDLE)iotHubClientHandle, statistics);
+}
+
 IOTHUB_CLIENT_RESULT IoTHubClient_LL_SetMessageCallback(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC messageCallback, void* userContextCallback)
 {
     return IoTHubClientCore_LL_SetMessageCallback((IOTHUB_CLIENT_CORE_LL_HANDLE)iotHubClientHandle, messageCallback, userContextCallback);
 }
 
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_SetMessageChunkCallback(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_MESSAGE_CHUNK_CALLBACK messageChunkCallback, void* userContextCallback)
+{
+    return IoTHubClientCore_LL_SetMessageChunkCallback((IOTHUB_CLIENT_CORE_LL_HANDLE)iotHubClientHandle, messageChunkCallback, userContextCallback);
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_SetMessageBatchCallback(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_MESSAGE_BATCH_CALLBACK messageBatchCallback, void* userContextCallback)
+{
+    return IoTHubClientCore_LL_SetMessageBatchCallback((IOTHUB_CLIENT_CORE_LL_HANDLE)iotHubClientHandle, messageBatchCallback, userContextCallback);
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_SendMessageDispositionBatch(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE* messages, size_t messageCount, IOTHUBMESSAGE_DISPOSITION_RESULT disposition)
+{
+    return IoTHubClientCore_LL_SendMessageDispositionBatch((IOTHUB_CLIENT_CORE_LL_HANDLE)iotHubClientHandle, messages, messageCount, disposition);
+}
+
 IOTHUB_CLIENT_RESULT IoTHubClient_LL_SetConnectionStatusCallback(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_CONNECTION_STATUS_CALLBACK connectionStatusCallback, void * userContextCallback)
 {
     return IoTHubClientCore_LL_SetConnectionStatusCallback((IOTHUB_CLIENT_CORE_LL_HANDLE)iotHubClientHandle, connectionStatusCallback, userContextCallback);
@@ -96,6 +136,11 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_SetDeviceTwinCallback(IOTHUB_CLIENT_LL_HAND
     return IoTHubClientCore_LL_SetDeviceTwinCallback((IOTHUB_CLIENT_CORE_LL_HANDLE)iotHubClientHandle, deviceTwinCallback, userContextCallback);
 }
 
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_SetDesiredPropertyCallback(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, const char* path, IOTHUB_CLIENT_DESIRED_PROPERTY_CALLBACK desiredPropertyCallback, void* userContextCallback)
+{
+    return IoTHubClientCore_LL_SetDesiredPropertyCallback((IOTHUB_CLIENT_CORE_LL_HANDLE)iotHubClientHandle, path, desiredPropertyCallback, userContextCallback);
+}
+
 IOTHUB_CLIENT_RESULT IoTHubClient_LL_SetOption(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, const char* optionName, const void* value)
 {
     return IoTHubClientCore_LL_SetOption((IOTHUB_CLIENT_CORE_LL_HANDLE)iotHubClientHandle, optionName, value);
@@ -111,6 +156,11 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_SetDeviceMethodCallback(IOTHUB_CLIENT_LL_HA
     return IoTHubClientCore_LL_SetDeviceMethodCallback((IOTHUB_CLIENT_CORE_LL_HANDLE)iotHubClientHandle, deviceMethodCallback, userContextCallback);
 }
 
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_SetDeviceMethodHandler(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, const char* methodName, IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC methodCallback, void* userContextCallback)
+{
+    return IoTHubClientCore_LL_SetDeviceMethodHandler((IOTHUB_CLIENT_CORE_LL_HANDLE)iotHubClientHandle, methodName, methodCallback, userContextCallback);
+}
+
 IOTHUB_CLIENT_RESULT IoTHubClient_LL_SetDeviceMethodCallback_Ex(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_INBOUND_DEVICE_METHOD_CALLBACK inboundDeviceMethodCallback, void* userContextCallback)
 {
     return IoTHubClientCore_LL_SetDeviceMethodCallback_Ex((IOTHUB_CLIENT_CORE_LL_HANDLE)iotHubClientHandle, inboundDeviceMethodCallback, userContextCallback);
@@ -4,6 +4,8 @@
 #ifndef DONT_USE_UPLOADTOBLOB
 
 #include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
 #include <string.h>
 #include "azure_c_shared_utility/optimize_size.h"
 #include "azure_c_shared_utility/gballoc.h"
@@ -14,6 +16,8 @@
 #include "azure_c_shared_utility/httpapiexsas.h"
 #include "azure_c_shared_utility/shared_util_options.h"
 #include "azure_c_shared_utility/urlencode.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/agenttime.h"
 
 #include "iothub_client_core_ll.h"
 #include "iothub_client_options.h"
@@ -24,8 +28,14 @@
 #include "internal/iothub_client_ll_uploadtoblob.h"
 #include "internal/iothub_client_authorization.h"
 #include "internal/blob.h"
+#include "internal/iothub_client_trust_store.h"
+#ifdef USE_PAYLOAD_COMPRESSION
+#include "internal/iothub_client_gzip.h"
+#endif
 
 #define API_VERSION "?api-version=2016-11-14"
+#define UPLOAD_MANIFEST_SUFFIX ".upload"
+#define FILE_COMPRESSION_INPUT_SIZE (64 * 1024)
 
 #ifdef WINCE
 #include <stdarg.h>
@@ -75,10 +85,18 @@ typedef struct IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA_TAG
         char* supplied_sas_token;
     } credentials;
     
-    char* certificates;
+    const char* certificates; /*shared through the trust store*/
     HTTP_PROXY_OPTIONS http_proxy_options;
     UPOADTOBLOB_CURL_VERBOSITY curl_verbosity_level;
     size_t blob_upload_timeout_secs;
+    bool resumable_file_uploads;
+    bool gzip_file_uploads;
+    size_t keep_alive_secs;
+    size_t blob_upload_parallelism;
+    LOCK_HANDLE connection_lock; /*created with the first non-zero keep_alive_secs, uploads run concurrently on the core's worker threads*/
+    HTTPAPIEX_HANDLE hub_connection; /*kept between uploads, NULL while an upload is using it*/
+    time_t hub_connection_last_used;
+    BLOB_CONNECTION_HANDLE blob_connection; /*kept between uploads, NULL while an upload is using it*/
 }IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA;
 
 typedef struct BLOB_UPLOAD_CONTEXT_TAG
@@ -88,7 +106,27 @@ typedef struct BLOB_UPLOAD_CONTEXT_TAG
     size_t remainingSizeToUpload; /* size not yet uploaded */
 } BLOB_UPLOAD_CONTEXT;
 
-static int send_http_sas_request(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA* upload_client, const char* uri_resource, HTTPAPIEX_HANDLE http_api_handle, const char* relative_path, HTTP_HEADERS_HANDLE request_header, BUFFER_HANDLE blobBuffer, BUFFER_HANDLE response_buff)
+typedef struct FILE_UPLOAD_CONTEXT_TAG
+{
+    FILE* sourceFile; /* file being uploaded */
+    unsigned char* block; /* the one BLOCK_SIZE buffer every block is read into */
+    bool readFailed; /* set when reading sourceFile fails mid-upload */
+    const char* destinationFileName; /* blob name recorded in the manifest */
+    char* manifestPath; /* NULL unless blob_upload_resumable is on */
+    unsigned int acknowledgedBlocks; /* blocks storage has acknowledged, including the ones of an interrupted earlier upload */
+    bool blockPending; /* a block was handed out and storage has not acknowledged it yet */
+#ifdef USE_PAYLOAD_COMPRESSION
+    GZIP_STREAM_HANDLE gzip; /* NULL unless blob_upload_gzip is on */
+    unsigned char* input; /* the FILE_COMPRESSION_INPUT_SIZE buffer the file is read into before being compressed */
+    size_t inputStart; /* first byte of input not compressed yet */
+    size_t inputLength; /* bytes of input not compressed yet */
+    bool inputEnded; /* the whole file has been read into input */
+    bool compressionEnded; /* the whole gzip stream has been handed out */
+#endif
+} FILE_UPLOAD_CONTEXT;
+
+/*connection_failed is set when the request could not be carried out, which leaves http_api_handle unfit to be kept*/
+static int send_http_sas_request(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA* upload_client, const char* uri_resource, HTTPAPIEX_HANDLE http_api_handle, const char* relative_path, HTTP_HEADERS_HANDLE request_header, BUFFER_HANDLE blobBuffer, BUFFER_HANDLE response_buff, bool* connection_failed)
 {
     int result;
     unsigned int statusCode;
@@ -108,6 +146,7 @@ static int send_http_sas_request(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA* uplo
         {
             /*Codes_SRS_IOTHUBCLIENT_LL_02_076: [ If HTTPAPIEX_ExecuteRequest call fails then IoTHubClient_LL_UploadMultipleBlocksToBlob(Ex) shall fail and return IOTHUB_CLIENT_ERROR. ]*/
             result = __FAILURE__;
+            *connection_failed = true;
             LogError("unable to HTTPAPIEX_ExecuteRequest");
         }
         else if (statusCode >= 300)
@@ -124,7 +163,7 @@ static int send_http_sas_request(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA* uplo
     return result;
 }
 
-static int send_http_request(HTTPAPIEX_HANDLE http_api_handle, const char* relative_path, HTTP_HEADERS_HANDLE request_header, BUFFER_HANDLE blobBuffer, BUFFER_HANDLE response_buff)
+static int send_http_request(HTTPAPIEX_HANDLE http_api_handle, const char* relative_path, HTTP_HEADERS_HANDLE request_header, BUFFER_HANDLE blobBuffer, BUFFER_HANDLE response_buff, bool* connection_failed)
 {
     int result;
     unsigned int statusCode;
@@ -134,6 +173,7 @@ static int send_http_request(HTTPAPIEX_HANDLE http_api_handle, const char* relat
     {
         /*Codes_SRS_IOTHUBCLIENT_LL_02_076: [ If HTTPAPIEX_ExecuteRequest call fails then IoTHubClient_LL_UploadMultipleBlocksToBlob(Ex) shall fail and return IOTHUB_CLIENT_ERROR. ]*/
         result = __FAILURE__;
+        *connection_failed = true;
         LogError("unable to HTTPAPIEX_ExecuteRequest");
     }
     else if (statusCode >= 300)
@@ -323,7 +363,7 @@ IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE IoTHubClient_LL_UploadToBlob_Create(const I
 }
 
 /*returns 0 when correlationId, sasUri contain data*/
-static int IoTHubClient_LL_UploadToBlob_step1and2(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA* upload_data, HTTPAPIEX_HANDLE iotHubHttpApiExHandle, HTTP_HEADERS_HANDLE requestHttpHeaders, const char* destinationFileName, STRING_HANDLE correlationId, STRING_HANDLE sasUri)
+static int IoTHubClient_LL_UploadToBlob_step1and2(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA* upload_data, HTTPAPIEX_HANDLE iotHubHttpApiExHandle, HTTP_HEADERS_HANDLE requestHttpHeaders, const char* destinationFileName, STRING_HANDLE correlationId, STRING_HANDLE sasUri, bool* hubConnectionFailed)
 {
     int result;
 
@@ -398,7 +438,7 @@ static int IoTHubClient_LL_UploadToBlob_step1and2(IOTHUB_CLIENT_LL_UPLOADTOBLOB_
                             case IOTHUB_CREDENTIAL_TYPE_X509_ECC:
                             case IOTHUB_CREDENTIAL_TYPE_X509:
                             {
-                                if (send_http_request(iotHubHttpApiExHandle, STRING_c_str(relativePath), requestHttpHeaders, blobBuffer, responseContent) != 0)
+                                if (send_http_request(iotHubHttpApiExHandle, STRING_c_str(relativePath), requestHttpHeaders, blobBuffer, responseContent, hubConnectionFailed) != 0)
                                 {
                                     /*Codes_SRS_IOTHUBCLIENT_LL_02_076: [ If HTTPAPIEX_ExecuteRequest call fails then IoTHubClient_LL_UploadMultipleBlocksToBlob(Ex) shall fail and return IOTHUB_CLIENT_ERROR. ]*/
                                     result = __FAILURE__;
@@ -447,7 +487,7 @@ static int IoTHubClient_LL_UploadToBlob_step1and2(IOTHUB_CLIENT_LL_UPLOADTOBLOB_
                                                     result = __FAILURE__;
                                                     LogError("unable to HTTPHeaders_AddHeaderNameValuePair");
                                                 }
-                                                else if (send_http_request(iotHubHttpApiExHandle, STRING_c_str(relativePath), requestHttpHeaders, blobBuffer, responseContent) != 0)
+                                                else if (send_http_request(iotHubHttpApiExHandle, STRING_c_str(relativePath), requestHttpHeaders, blobBuffer, responseContent, hubConnectionFailed) != 0)
                                                 {
                                                     /*Codes_SRS_IOTHUBCLIENT_LL_02_076: [ If HTTPAPIEX_ExecuteRequest call fails then IoTHubClient_LL_UploadMultipleBlocksToBlob(Ex) shall fail and return IOTHUB_CLIENT_ERROR. ]*/
                                                     result = __FAILURE__;
@@ -463,7 +503,7 @@ static int IoTHubClient_LL_UploadToBlob_step1and2(IOTHUB_CLIENT_LL_UPLOADTOBLOB_
                                     }
                                     else
                                     {
-                                        if (send_http_sas_request(upload_data, STRING_c_str(uri_resource), iotHubHttpApiExHandle, STRING_c_str(relativePath), requestHttpHeaders, blobBuffer, responseContent) != 0)
+                                        if (send_http_sas_request(upload_data, STRING_c_str(uri_resource), iotHubHttpApiExHandle, STRING_c_str(relativePath), requestHttpHeaders, blobBuffer, responseContent, hubConnectionFailed) != 0)
                                         {
                                             /*Codes_SRS_IOTHUBCLIENT_LL_02_076: [ If HTTPAPIEX_ExecuteRequest call fails then IoTHubClient_LL_UploadMultipleBlocksToBlob(Ex) shall fail and return IOTHUB_CLIENT_ERROR. ]*/
                                             result = __FAILURE__;
@@ -487,7 +527,7 @@ static int IoTHubClient_LL_UploadToBlob_step1and2(IOTHUB_CLIENT_LL_UPLOADTOBLOB_
                                     result = __FAILURE__;
                                     LogError("unable to HTTPHeaders_AddHeaderNameValuePair");
                                 }
-                                else if (send_http_request(iotHubHttpApiExHandle, STRING_c_str(relativePath), requestHttpHeaders, blobBuffer, responseContent) != 0)
+                                else if (send_http_request(iotHubHttpApiExHandle, STRING_c_str(relativePath), requestHttpHeaders, blobBuffer, responseContent, hubConnectionFailed) != 0)
                                 {
                                     /*Codes_SRS_IOTHUBCLIENT_LL_02_076: [ If HTTPAPIEX_ExecuteRequest call fails then IoTHubClient_LL_UploadMultipleBlocksToBlob(Ex) shall fail and return IOTHUB_CLIENT_ERROR. ]*/
                                     result = __FAILURE__;
@@ -538,7 +578,7 @@ static int IoTHubClient_LL_UploadToBlob_step1and2(IOTHUB_CLIENT_LL_UPLOADTOBLOB_
 }
 
 /*returns 0 when the IoTHub has been informed about the file upload status*/
-static int IoTHubClient_LL_UploadToBlob_step3(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA* upload_data, STRING_HANDLE correlationId, HTTPAPIEX_HANDLE iotHubHttpApiExHandle, HTTP_HEADERS_HANDLE requestHttpHeaders, BUFFER_HANDLE messageBody)
+static int IoTHubClient_LL_UploadToBlob_step3(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA* upload_data, STRING_HANDLE correlationId, HTTPAPIEX_HANDLE iotHubHttpApiExHandle, HTTP_HEADERS_HANDLE requestHttpHeaders, BUFFER_HANDLE messageBody, bool* hubConnectionFailed)
 {
     int result;
     /*here is step 3. depending on the outcome of step 2 it needs to inform IoTHub about the file upload status*/
@@ -568,7 +608,7 @@ static int IoTHubClient_LL_UploadToBlob_step3(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HAND
             case IOTHUB_CREDENTIAL_TYPE_X509_ECC:
             case IOTHUB_CREDENTIAL_TYPE_DEVICE_AUTH:
             {
-                if (send_http_request(iotHubHttpApiExHandle, STRING_c_str(relativePathNotification), requestHttpHeaders, messageBody, NULL) != 0)
+                if (send_http_request(iotHubHttpApiExHandle, STRING_c_str(relativePathNotification), requestHttpHeaders, messageBody, NULL, hubConnectionFailed) != 0)
                 {
                     LogError("unable to execute HTTPAPIEX_ExecuteRequest");
                     result = __FAILURE__;
@@ -589,7 +629,7 @@ static int IoTHubClient_LL_UploadToBlob_step3(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HAND
                 }
                 else
                 {
-                    if (send_http_sas_request(upload_data, STRING_c_str(uriResource), iotHubHttpApiExHandle, STRING_c_str(relativePathNotification), requestHttpHeaders, messageBody, NULL) != 0)
+                    if (send_http_sas_request(upload_data, STRING_c_str(uriResource), iotHubHttpApiExHandle, STRING_c_str(relativePathNotification), requestHttpHeaders, messageBody, NULL, hubConnectionFailed) != 0)
                     {
                         LogError("unable to execute HTTPAPIEX_ExecuteRequest");
                         result = __FAILURE__;
@@ -657,7 +697,169 @@ static HTTPAPIEX_RESULT set_transfer_timeout(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDL
     return result;
 }
 
-IOTHUB_CLIENT_RESULT IoTHubClient_LL_UploadMultipleBlocksToBlob_Impl(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE handle, const char* destinationFileName, IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK_EX getDataCallbackEx, void* context)
+static IOTHUB_CLIENT_RESULT configure_hub_connection(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA* upload_data, HTTPAPIEX_HANDLE iotHubHttpApiExHandle)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    /*Codes_SRS_IOTHUBCLIENT_LL_30_020: [ If the blob_upload_timeout_secs option has been set to non-zero, IoTHubClient_LL_UploadMultipleBlocksToBlob(Ex) shall set the timeout on the underlying transport accordingly. ]*/
+    if (set_transfer_timeout(upload_data, iotHubHttpApiExHandle) != HTTPAPIEX_OK)
+    {
+        LogError("unable to set blob transfer timeout");
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else
+    {
+        if (upload_data->curl_verbosity_level != UPOADTOBLOB_CURL_VERBOSITY_UNSET)
+        {
+            size_t curl_verbose = (upload_data->curl_verbosity_level == UPOADTOBLOB_CURL_VERBOSITY_ON);
+            (void)HTTPAPIEX_SetOption(iotHubHttpApiExHandle, OPTION_CURL_VERBOSE, &curl_verbose);
+        }
+
+        /*transmit the x509certificate and x509privatekey*/
+        /*Codes_SRS_IOTHUBCLIENT_LL_02_106: [ - x509certificate and x509privatekey saved options shall be passed on the HTTPAPIEX_SetOption ]*/
+        if ((upload_data->cred_type == IOTHUB_CREDENTIAL_TYPE_X509 || upload_data->cred_type == IOTHUB_CREDENTIAL_TYPE_X509_ECC) &&
+            ((HTTPAPIEX_SetOption(iotHubHttpApiExHandle, OPTION_X509_CERT, upload_data->credentials.x509_credentials.x509certificate) != HTTPAPIEX_OK) ||
+            (HTTPAPIEX_SetOption(iotHubHttpApiExHandle, OPTION_X509_PRIVATE_KEY, upload_data->credentials.x509_credentials.x509privatekey) != HTTPAPIEX_OK))
+            )
+        {
+            LogError("unable to HTTPAPIEX_SetOption for x509 certificate");
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        /*Codes_SRS_IOTHUBCLIENT_LL_02_111: [ If certificates is non-NULL then certificates shall be passed to HTTPAPIEX_SetOption with optionName TrustedCerts. ]*/
+        else if ((upload_data->certificates != NULL) && (HTTPAPIEX_SetOption(iotHubHttpApiExHandle, OPTION_TRUSTED_CERT, upload_data->certificates) != HTTPAPIEX_OK))
+        {
+            LogError("unable to set TrustedCerts!");
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else if (upload_data->http_proxy_options.host_address != NULL)
+        {
+            HTTP_PROXY_OPTIONS proxy_options;
+            proxy_options = upload_data->http_proxy_options;
+
+            if (HTTPAPIEX_SetOption(iotHubHttpApiExHandle, OPTION_HTTP_PROXY, &proxy_options) != HTTPAPIEX_OK)
+            {
+                LogError("unable to set http proxy!");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        else
+        {
+            result = IOTHUB_CLIENT_OK;
+        }
+    }
+    return result;
+}
+
+/*the kept connections are only touched with connection_lock held; connection_lock is NULL until keep-alive is turned on, and then nothing is kept*/
+static HTTPAPIEX_HANDLE take_hub_connection(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA* upload_data)
+{
+    HTTPAPIEX_HANDLE result = NULL;
+
+    if (upload_data->connection_lock != NULL && Lock(upload_data->connection_lock) == LOCK_OK)
+    {
+        result = upload_data->hub_connection;
+        upload_data->hub_connection = NULL;
+        (void)Unlock(upload_data->connection_lock);
+
+        if (result != NULL)
+        {
+            time_t now = get_time(NULL);
+            if (now == INDEFINITE_TIME || get_difftime(now, upload_data->hub_connection_last_used) > (double)upload_data->keep_alive_secs)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_065: [ A kept HTTPAPIEX_HANDLE that has been idle for longer than `OPTION_BLOB_UPLOAD_KEEP_ALIVE_SECS` shall be destroyed and a new one created. ]*/
+                HTTPAPIEX_Destroy(result);
+                result = NULL;
+            }
+        }
+    }
+
+    return result;
+}
+
+static void release_hub_connection(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA* upload_data, HTTPAPIEX_HANDLE iotHubHttpApiExHandle, bool keep)
+{
+    if (keep && upload_data->keep_alive_secs != 0 && upload_data->connection_lock != NULL && Lock(upload_data->connection_lock) == LOCK_OK)
+    {
+        /*another upload running at the same time may have kept its own connection already*/
+        HTTPAPIEX_HANDLE displaced = upload_data->hub_connection;
+        upload_data->hub_connection = iotHubHttpApiExHandle;
+        upload_data->hub_connection_last_used = get_time(NULL);
+        (void)Unlock(upload_data->connection_lock);
+
+        if (displaced != NULL)
+        {
+            HTTPAPIEX_Destroy(displaced);
+        }
+    }
+    else
+    {
+        HTTPAPIEX_Destroy(iotHubHttpApiExHandle);
+    }
+}
+
+static BLOB_CONNECTION_HANDLE take_blob_connection(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA* upload_data)
+{
+    BLOB_CONNECTION_HANDLE result = NULL;
+
+    if (upload_data->keep_alive_secs != 0 && upload_data->connection_lock != NULL && Lock(upload_data->connection_lock) == LOCK_OK)
+    {
+        result = upload_data->blob_connection;
+        upload_data->blob_connection = NULL;
+        (void)Unlock(upload_data->connection_lock);
+
+        if (result == NULL && (result = Blob_Connection_Create(upload_data->keep_alive_secs)) == NULL)
+        {
+            /*not fatal, the blocks are then uploaded on a connection of their own*/
+            LogError("unable to create a storage connection cache");
+        }
+    }
+
+    return result;
+}
+
+static void release_blob_connection(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA* upload_data, BLOB_CONNECTION_HANDLE blobConnection)
+{
+    BLOB_CONNECTION_HANDLE displaced = blobConnection;
+
+    if (upload_data->connection_lock != NULL && Lock(upload_data->connection_lock) == LOCK_OK)
+    {
+        displaced = upload_data->blob_connection;
+        upload_data->blob_connection = blobConnection;
+        (void)Unlock(upload_data->connection_lock);
+    }
+
+    if (displaced != NULL)
+    {
+        Blob_Connection_Destroy(displaced);
+    }
+}
+
+static void drop_kept_connections(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA* upload_data)
+{
+    if (upload_data->connection_lock != NULL && Lock(upload_data->connection_lock) == LOCK_OK)
+    {
+        HTTPAPIEX_HANDLE hubConnection = upload_data->hub_connection;
+        BLOB_CONNECTION_HANDLE blobConnection = upload_data->blob_connection;
+        upload_data->hub_connection = NULL;
+        upload_data->blob_connection = NULL;
+        (void)Unlock(upload_data->connection_lock);
+
+        if (hubConnection != NULL)
+        {
+            HTTPAPIEX_Destroy(hubConnection);
+        }
+        if (blobConnection != NULL)
+        {
+            Blob_Connection_Destroy(blobConnection);
+        }
+    }
+}
+
+static IOTHUB_CLIENT_RESULT upload_multiple_blocks_to_blob(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE handle, const char* destinationFileName, IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK_EX getDataCallbackEx, void* context, unsigned int committedBlockCount, size_t parallelism)
 {
     IOTHUB_CLIENT_RESULT result;
 
@@ -673,204 +875,188 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_UploadMultipleBlocksToBlob_Impl(IOTHUB_CLIE
     {
         IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA* upload_data = (IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA*)handle;
 
-        /*Codes_SRS_IOTHUBCLIENT_LL_02_064: [ IoTHubClient_LL_UploadMultipleBlocksToBlob(Ex) shall create an HTTPAPIEX_HANDLE to the IoTHub hostname. ]*/
-        HTTPAPIEX_HANDLE iotHubHttpApiExHandle = HTTPAPIEX_Create(upload_data->hostname);
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_063: [ If `OPTION_BLOB_UPLOAD_KEEP_ALIVE_SECS` is not 0 and an HTTPAPIEX_HANDLE to the IoTHub hostname kept from a previous upload has been idle for at most that many seconds, IoTHubClient_LL_UploadMultipleBlocksToBlob(Ex) shall reuse it without setting its options again. ]*/
+        HTTPAPIEX_HANDLE iotHubHttpApiExHandle = take_hub_connection(upload_data);
+        bool reused = (iotHubHttpApiExHandle != NULL);
+        if (!reused)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_02_064: [ IoTHubClient_LL_UploadMultipleBlocksToBlob(Ex) shall create an HTTPAPIEX_HANDLE to the IoTHub hostname. ]*/
+            iotHubHttpApiExHandle = HTTPAPIEX_Create(upload_data->hostname);
+        }
+
         /*Codes_SRS_IOTHUBCLIENT_LL_02_065: [ If creating the HTTPAPIEX_HANDLE fails then IoTHubClient_LL_UploadMultipleBlocksToBlob(Ex) shall fail and return IOTHUB_CLIENT_ERROR. ]*/
         if (iotHubHttpApiExHandle == NULL)
         {
             LogError("unable to HTTPAPIEX_Create");
             result = IOTHUB_CLIENT_ERROR;
         }
-        /*Codes_SRS_IOTHUBCLIENT_LL_30_020: [ If the blob_upload_timeout_secs option has been set to non-zero, IoTHubClient_LL_UploadMultipleBlocksToBlob(Ex) shall set the timeout on the underlying transport accordingly. ]*/
-        else if (set_transfer_timeout(upload_data, iotHubHttpApiExHandle) != HTTPAPIEX_OK)
-        {
-            LogError("unable to set blob transfer timeout");
-            result = IOTHUB_CLIENT_ERROR;
-        }
         else
         {
-            if (upload_data->curl_verbosity_level != UPOADTOBLOB_CURL_VERBOSITY_UNSET)
-            {
-                size_t curl_verbose = (upload_data->curl_verbosity_level == UPOADTOBLOB_CURL_VERBOSITY_ON);
-                (void)HTTPAPIEX_SetOption(iotHubHttpApiExHandle, OPTION_CURL_VERBOSE, &curl_verbose);
-            }
+            bool hubConnectionFailed;
 
-            /*transmit the x509certificate and x509privatekey*/
-            /*Codes_SRS_IOTHUBCLIENT_LL_02_106: [ - x509certificate and x509privatekey saved options shall be passed on the HTTPAPIEX_SetOption ]*/
-            if ((upload_data->cred_type == IOTHUB_CREDENTIAL_TYPE_X509 || upload_data->cred_type == IOTHUB_CREDENTIAL_TYPE_X509_ECC) &&
-                ((HTTPAPIEX_SetOption(iotHubHttpApiExHandle, OPTION_X509_CERT, upload_data->credentials.x509_credentials.x509certificate) != HTTPAPIEX_OK) ||
-                (HTTPAPIEX_SetOption(iotHubHttpApiExHandle, OPTION_X509_PRIVATE_KEY, upload_data->credentials.x509_credentials.x509privatekey) != HTTPAPIEX_OK))
-                )
-            {
-                LogError("unable to HTTPAPIEX_SetOption for x509 certificate");
-                result = IOTHUB_CLIENT_ERROR;
-            }
-            else
+            result = reused ? IOTHUB_CLIENT_OK : configure_hub_connection(upload_data, iotHubHttpApiExHandle);
+            /*a connection whose options could not all be set is never kept*/
+            hubConnectionFailed = (result != IOTHUB_CLIENT_OK);
+
+            if (result == IOTHUB_CLIENT_OK)
             {
-                /*Codes_SRS_IOTHUBCLIENT_LL_02_111: [ If certificates is non-NULL then certificates shall be passed to HTTPAPIEX_SetOption with optionName TrustedCerts. ]*/
-                if ((upload_data->certificates != NULL) && (HTTPAPIEX_SetOption(iotHubHttpApiExHandle, OPTION_TRUSTED_CERT, upload_data->certificates) != HTTPAPIEX_OK))
+                STRING_HANDLE sasUri;
+                STRING_HANDLE correlationId;
+                if ((correlationId = STRING_new()) == NULL)
+                {
+                    LogError("unable to STRING_new");
+                    result = IOTHUB_CLIENT_ERROR;
+                }
+                else if ((sasUri = STRING_new()) == NULL)
                 {
-                    LogError("unable to set TrustedCerts!");
+                    LogError("unable to create sas uri");
                     result = IOTHUB_CLIENT_ERROR;
+                    STRING_delete(correlationId);
                 }
                 else
                 {
-
-                    if (upload_data->http_proxy_options.host_address != NULL)
+                    /*Codes_SRS_IOTHUBCLIENT_LL_02_070: [ IoTHubClient_LL_UploadMultipleBlocksToBlob(Ex) shall create request HTTP headers. ]*/
+                    HTTP_HEADERS_HANDLE requestHttpHeaders = HTTPHeaders_Alloc(); /*these are build by step 1 and used by step 3 too*/
+                    if (requestHttpHeaders == NULL)
                     {
-                        HTTP_PROXY_OPTIONS proxy_options;
-                        proxy_options = upload_data->http_proxy_options;
-
-                        if (HTTPAPIEX_SetOption(iotHubHttpApiExHandle, OPTION_HTTP_PROXY, &proxy_options) != HTTPAPIEX_OK)
-                        {
-                            LogError("unable to set http proxy!");
-                            result = IOTHUB_CLIENT_ERROR;
-                        }
-                        else
-                        {
-                            result = IOTHUB_CLIENT_OK;
-                        }
+                        LogError("unable to HTTPHeaders_Alloc");
+                        result = IOTHUB_CLIENT_ERROR;
                     }
                     else
                     {
-                        result = IOTHUB_CLIENT_OK;
-                    }
-
-                    if (result != IOTHUB_CLIENT_ERROR)
-                    {
-                        STRING_HANDLE sasUri;
-                        STRING_HANDLE correlationId;
-                        if ((correlationId = STRING_new()) == NULL)
-                        {
-                            LogError("unable to STRING_new");
-                            result = IOTHUB_CLIENT_ERROR;
-                        }
-                        else if ((sasUri = STRING_new()) == NULL)
+                        /*do step 1*/
+                        if (IoTHubClient_LL_UploadToBlob_step1and2(upload_data, iotHubHttpApiExHandle, requestHttpHeaders, destinationFileName, correlationId, sasUri, &hubConnectionFailed) != 0)
                         {
-                            LogError("unable to create sas uri");
+                            LogError("error in IoTHubClient_LL_UploadToBlob_step1");
                             result = IOTHUB_CLIENT_ERROR;
-                            STRING_delete(correlationId);
                         }
                         else
                         {
-                            /*Codes_SRS_IOTHUBCLIENT_LL_02_070: [ IoTHubClient_LL_UploadMultipleBlocksToBlob(Ex) shall create request HTTP headers. ]*/
-                            HTTP_HEADERS_HANDLE requestHttpHeaders = HTTPHeaders_Alloc(); /*these are build by step 1 and used by step 3 too*/
-                            if (requestHttpHeaders == NULL)
+                            /*do step 2.*/
+
+                            unsigned int httpResponse;
+                            BUFFER_HANDLE responseToIoTHub = BUFFER_new();
+                            if (responseToIoTHub == NULL)
                             {
-                                LogError("unable to HTTPHeaders_Alloc");
                                 result = IOTHUB_CLIENT_ERROR;
+                                LogError("unable to BUFFER_new");
                             }
                             else
                             {
-                                /*do step 1*/
-                                if (IoTHubClient_LL_UploadToBlob_step1and2(upload_data, iotHubHttpApiExHandle, requestHttpHeaders, destinationFileName, correlationId, sasUri) != 0)
+                                /*Codes_SRS_IOTHUBCLIENT_LL_02_083: [ IoTHubClient_LL_UploadMultipleBlocksToBlob(Ex) shall call Blob_UploadFromSasUri and capture the HTTP return code and HTTP body. ]*/
+                                /*Codes_SRS_IOTHUBCLIENT_LL_41_056: [ When resuming after `committedBlockCount` acknowledged blocks, `IoTHubClient_LL_UploadFileToBlob_Impl` shall call `Blob_ResumeMultipleBlocksFromSasUri` with the new SasUri instead of `Blob_UploadMultipleBlocksFromSasUri`. ]*/
+                                BLOB_RESULT uploadMultipleBlocksResult;
+                                BLOB_CONNECTION_HANDLE blobConnection = take_blob_connection(upload_data);
+                                if (parallelism > 1)
                                 {
-                                    LogError("error in IoTHubClient_LL_UploadToBlob_step1");
-                                    result = IOTHUB_CLIENT_ERROR;
+                                    /*Codes_SRS_IOTHUBCLIENT_LL_41_173: [ If the parallelism of the upload is greater than 1, IoTHubClient_LL_UploadMultipleBlocksToBlob(Ex) shall upload the blocks with `Blob_UploadMultipleBlocksInParallel`, passing the kept storage connection if `OPTION_BLOB_UPLOAD_KEEP_ALIVE_SECS` is not 0 and NULL otherwise. ]*/
+                                    uploadMultipleBlocksResult = Blob_UploadMultipleBlocksInParallel(blobConnection, STRING_c_str(sasUri), getDataCallbackEx, context, &httpResponse, responseToIoTHub, upload_data->certificates, &(upload_data->http_proxy_options), committedBlockCount, parallelism);
+                                    if (blobConnection != NULL)
+                                    {
+                                        release_blob_connection(upload_data, blobConnection);
+                                    }
+                                }
+                                else if (blobConnection != NULL)
+                                {
+                                    /*Codes_SRS_IOTHUBCLIENT_LL_41_066: [ If `OPTION_BLOB_UPLOAD_KEEP_ALIVE_SECS` is not 0, IoTHubClient_LL_UploadMultipleBlocksToBlob(Ex) shall upload the blocks with `Blob_UploadMultipleBlocksOnConnection` so that the storage connection is kept for the next upload. ]*/
+                                    uploadMultipleBlocksResult = Blob_UploadMultipleBlocksOnConnection(blobConnection, STRING_c_str(sasUri), getDataCallbackEx, context, &httpResponse, responseToIoTHub, upload_data->certificates, &(upload_data->http_proxy_options), committedBlockCount);
+                                    release_blob_connection(upload_data, blobConnection);
                                 }
                                 else
                                 {
-                                    /*do step 2.*/
+                                    uploadMultipleBlocksResult = (committedBlockCount == 0) ?
+                                        Blob_UploadMultipleBlocksFromSasUri(STRING_c_str(sasUri), getDataCallbackEx, context, &httpResponse, responseToIoTHub, upload_data->certificates, &(upload_data->http_proxy_options)) :
+                                        Blob_ResumeMultipleBlocksFromSasUri(STRING_c_str(sasUri), getDataCallbackEx, context, &httpResponse, responseToIoTHub, upload_data->certificates, &(upload_data->http_proxy_options), committedBlockCount);
+                                }
+                                if (uploadMultipleBlocksResult == BLOB_ABORTED)
+                                {
+                                    /*Codes_SRS_IOTHUBCLIENT_LL_99_008: [ If step 2 is aborted by the client, then the HTTP message body shall look like:  ]*/
+                                    LogInfo("Blob_UploadFromSasUri aborted file upload");
 
-                                    unsigned int httpResponse;
-                                    BUFFER_HANDLE responseToIoTHub = BUFFER_new();
-                                    if (responseToIoTHub == NULL)
+                                    if (BUFFER_build(responseToIoTHub, (const unsigned char*)FILE_UPLOAD_ABORTED_BODY, sizeof(FILE_UPLOAD_ABORTED_BODY) / sizeof(FILE_UPLOAD_ABORTED_BODY[0])) == 0)
                                     {
-                                        result = IOTHUB_CLIENT_ERROR;
-                                        LogError("unable to BUFFER_new");
+                                        if (IoTHubClient_LL_UploadToBlob_step3(upload_data, correlationId, iotHubHttpApiExHandle, requestHttpHeaders, responseToIoTHub, &hubConnectionFailed) != 0)
+                                        {
+                                            LogError("IoTHubClient_LL_UploadToBlob_step3 failed");
+                                            result = IOTHUB_CLIENT_ERROR;
+                                        }
+                                        else
+                                        {
+                                            /*Codes_SRS_IOTHUBCLIENT_LL_99_009: [ If step 2 is aborted by the client and if step 3 succeeds, then `IoTHubClient_LL_UploadMultipleBlocksToBlob(Ex)` shall return `IOTHUB_CLIENT_OK`. ] */
+                                            result = IOTHUB_CLIENT_OK;
+                                        }
                                     }
                                     else
                                     {
-                                        /*Codes_SRS_IOTHUBCLIENT_LL_02_083: [ IoTHubClient_LL_UploadMultipleBlocksToBlob(Ex) shall call Blob_UploadFromSasUri and capture the HTTP return code and HTTP body. ]*/
-                                        BLOB_RESULT uploadMultipleBlocksResult = Blob_UploadMultipleBlocksFromSasUri(STRING_c_str(sasUri), getDataCallbackEx, context, &httpResponse, responseToIoTHub, upload_data->certificates, &(upload_data->http_proxy_options));
-                                        if (uploadMultipleBlocksResult == BLOB_ABORTED)
-                                        {
-                                            /*Codes_SRS_IOTHUBCLIENT_LL_99_008: [ If step 2 is aborted by the client, then the HTTP message body shall look like:  ]*/
-                                            LogInfo("Blob_UploadFromSasUri aborted file upload");
+                                        LogError("Unable to BUFFER_build, can't perform IoTHubClient_LL_UploadToBlob_step3");
+                                        result = IOTHUB_CLIENT_ERROR;
+                                    }
+                                }
+                                else if (uploadMultipleBlocksResult != BLOB_OK)
+                                {
+                                    /*Codes_SRS_IOTHUBCLIENT_LL_02_084: [ If Blob_UploadFromSasUri fails then IoTHubClient_LL_UploadMultipleBlocksToBlob(Ex) shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+                                    LogError("unable to Blob_UploadFromSasUri");
 
-                                            if (BUFFER_build(responseToIoTHub, (const unsigned char*)FILE_UPLOAD_ABORTED_BODY, sizeof(FILE_UPLOAD_ABORTED_BODY) / sizeof(FILE_UPLOAD_ABORTED_BODY[0])) == 0)
-                                            {
-                                                if (IoTHubClient_LL_UploadToBlob_step3(upload_data, correlationId, iotHubHttpApiExHandle, requestHttpHeaders, responseToIoTHub) != 0)
-                                                {
-                                                    LogError("IoTHubClient_LL_UploadToBlob_step3 failed");
-                                                    result = IOTHUB_CLIENT_ERROR;
-                                                }
-                                                else
-                                                {
-                                                    /*Codes_SRS_IOTHUBCLIENT_LL_99_009: [ If step 2 is aborted by the client and if step 3 succeeds, then `IoTHubClient_LL_UploadMultipleBlocksToBlob(Ex)` shall return `IOTHUB_CLIENT_OK`. ] */
-                                                    result = IOTHUB_CLIENT_OK;
-                                                }
-                                            }
-                                            else
-                                            {
-                                                LogError("Unable to BUFFER_build, can't perform IoTHubClient_LL_UploadToBlob_step3");
-                                                result = IOTHUB_CLIENT_ERROR;
-                                            }
+                                    /*do step 3*/ /*try*/
+                                    /*Codes_SRS_IOTHUBCLIENT_LL_02_091: [ If step 2 fails without establishing an HTTP dialogue, then the HTTP message body shall look like: ]*/
+                                    if (BUFFER_build(responseToIoTHub, (const unsigned char*)FILE_UPLOAD_FAILED_BODY, sizeof(FILE_UPLOAD_FAILED_BODY) / sizeof(FILE_UPLOAD_FAILED_BODY[0])) == 0)
+                                    {
+                                        if (IoTHubClient_LL_UploadToBlob_step3(upload_data, correlationId, iotHubHttpApiExHandle, requestHttpHeaders, responseToIoTHub, &hubConnectionFailed) != 0)
+                                        {
+                                            LogError("IoTHubClient_LL_UploadToBlob_step3 failed");
                                         }
-                                        else if (uploadMultipleBlocksResult != BLOB_OK)
+                                    }
+                                    result = IOTHUB_CLIENT_ERROR;
+                                }
+                                else
+                                {
+                                    /*must make a json*/
+                                    STRING_HANDLE req_string = STRING_construct_sprintf("{\"isSuccess\":%s, \"statusCode\":%d, \"statusDescription\":\"%s\"}", ((httpResponse < 300) ? "true" : "false"), httpResponse, BUFFER_u_char(responseToIoTHub));
+                                    if (req_string == NULL)
+                                    {
+                                        LogError("Failure constructing string");
+                                        result = IOTHUB_CLIENT_ERROR;
+                                    }
+                                    else
+                                    {
+                                        /*do again snprintf*/
+                                        BUFFER_HANDLE toBeTransmitted = NULL;
+                                        size_t req_string_len = STRING_length(req_string);
+                                        const char* required_string = STRING_c_str(req_string);
+                                        if ((toBeTransmitted = BUFFER_create((const unsigned char*)required_string, req_string_len)) == NULL)
                                         {
-                                            /*Codes_SRS_IOTHUBCLIENT_LL_02_084: [ If Blob_UploadFromSasUri fails then IoTHubClient_LL_UploadMultipleBlocksToBlob(Ex) shall fail and return IOTHUB_CLIENT_ERROR. ]*/
-                                            LogError("unable to Blob_UploadFromSasUri");
-
-                                            /*do step 3*/ /*try*/
-                                            /*Codes_SRS_IOTHUBCLIENT_LL_02_091: [ If step 2 fails without establishing an HTTP dialogue, then the HTTP message body shall look like: ]*/
-                                            if (BUFFER_build(responseToIoTHub, (const unsigned char*)FILE_UPLOAD_FAILED_BODY, sizeof(FILE_UPLOAD_FAILED_BODY) / sizeof(FILE_UPLOAD_FAILED_BODY[0])) == 0)
-                                            {
-                                                if (IoTHubClient_LL_UploadToBlob_step3(upload_data, correlationId, iotHubHttpApiExHandle, requestHttpHeaders, responseToIoTHub) != 0)
-                                                {
-                                                    LogError("IoTHubClient_LL_UploadToBlob_step3 failed");
-                                                }
-                                            }
+                                            LogError("unable to BUFFER_create");
                                             result = IOTHUB_CLIENT_ERROR;
                                         }
                                         else
                                         {
-                                            /*must make a json*/
-                                            STRING_HANDLE req_string = STRING_construct_sprintf("{\"isSuccess\":%s, \"statusCode\":%d, \"statusDescription\":\"%s\"}", ((httpResponse < 300) ? "true" : "false"), httpResponse, BUFFER_u_char(responseToIoTHub));
-                                            if (req_string == NULL)
+                                            if (IoTHubClient_LL_UploadToBlob_step3(upload_data, correlationId, iotHubHttpApiExHandle, requestHttpHeaders, toBeTransmitted, &hubConnectionFailed) != 0)
                                             {
-                                                LogError("Failure constructing string");
+                                                LogError("IoTHubClient_LL_UploadToBlob_step3 failed");
                                                 result = IOTHUB_CLIENT_ERROR;
                                             }
                                             else
                                             {
-                                                /*do again snprintf*/
-                                                BUFFER_HANDLE toBeTransmitted = NULL;
-                                                size_t req_string_len = STRING_length(req_string);
-                                                const char* required_string = STRING_c_str(req_string);
-                                                if ((toBeTransmitted = BUFFER_create((const unsigned char*)required_string, req_string_len)) == NULL)
-                                                {
-                                                    LogError("unable to BUFFER_create");
-                                                    result = IOTHUB_CLIENT_ERROR;
-                                                }
-                                                else
-                                                {
-                                                    if (IoTHubClient_LL_UploadToBlob_step3(upload_data, correlationId, iotHubHttpApiExHandle, requestHttpHeaders, toBeTransmitted) != 0)
-                                                    {
-                                                        LogError("IoTHubClient_LL_UploadToBlob_step3 failed");
-                                                        result = IOTHUB_CLIENT_ERROR;
-                                                    }
-                                                    else
-                                                    {
-                                                        result = (httpResponse < 300) ? IOTHUB_CLIENT_OK : IOTHUB_CLIENT_ERROR;
-                                                    }
-                                                    BUFFER_delete(toBeTransmitted);
-                                                }
-                                                STRING_delete(req_string);
+                                                result = (httpResponse < 300) ? IOTHUB_CLIENT_OK : IOTHUB_CLIENT_ERROR;
                                             }
+                                            BUFFER_delete(toBeTransmitted);
                                         }
-                                        BUFFER_delete(responseToIoTHub);
+                                        STRING_delete(req_string);
                                     }
                                 }
-                                HTTPHeaders_Free(requestHttpHeaders);
+                                BUFFER_delete(responseToIoTHub);
                             }
-                            STRING_delete(sasUri);
-                            STRING_delete(correlationId);
                         }
+                        HTTPHeaders_Free(requestHttpHeaders);
                     }
+                    STRING_delete(sasUri);
+                    STRING_delete(correlationId);
                 }
             }
-            HTTPAPIEX_Destroy(iotHubHttpApiExHandle);
+
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_064: [ If `OPTION_BLOB_UPLOAD_KEEP_ALIVE_SECS` is not 0 and the upload succeeded, IoTHubClient_LL_UploadMultipleBlocksToBlob(Ex) shall keep the HTTPAPIEX_HANDLE for the next upload instead of destroying it. ]*/
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_145: [ If the upload failed but every `HTTPAPIEX_ExecuteRequest` to the IoTHub hostname was carried out, IoTHubClient_LL_UploadMultipleBlocksToBlob(Ex) shall keep the HTTPAPIEX_HANDLE as well, so that the next upload does not open a new connection (and proxy tunnel) to the IoTHub. ]*/
+            release_hub_connection(upload_data, iotHubHttpApiExHandle, !hubConnectionFailed);
         }
 
         /*Codes_SRS_IOTHUBCLIENT_LL_99_003: [ If `IoTHubClient_LL_UploadMultipleBlocksToBlob(Ex)` return `IOTHUB_CLIENT_OK`, it shall call `getDataCallbackEx` with `result` set to `FILE_UPLOAD_OK`, and `data` and `size` set to NULL. ]*/
@@ -880,6 +1066,12 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_UploadMultipleBlocksToBlob_Impl(IOTHUB_CLIE
     return result;
 }
 
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_UploadMultipleBlocksToBlob_Impl(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE handle, const char* destinationFileName, IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK_EX getDataCallbackEx, void* context)
+{
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_174: [ `IoTHubClient_LL_UploadMultipleBlocksToBlob_Impl` shall upload with the parallelism set by `OPTION_BLOB_UPLOAD_PARALLELISM`. ]*/
+    return upload_multiple_blocks_to_blob(handle, destinationFileName, getDataCallbackEx, context, 0, (handle == NULL) ? 0 : ((IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA*)handle)->blob_upload_parallelism);
+}
+
 IOTHUB_CLIENT_RESULT IoTHubClient_LL_UploadToBlob_Impl(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE handle, const char* destinationFileName, const unsigned char* source, size_t size)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -909,6 +1101,332 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_UploadToBlob_Impl(IOTHUB_CLIENT_LL_UPLOADTO
     return result;
 }
 
+/*the manifest is "<acknowledged blocks>\n<destinationFileName>"*/
+static void write_upload_manifest(const FILE_UPLOAD_CONTEXT* uploadContext)
+{
+    FILE* manifest = fopen(uploadContext->manifestPath, "wb");
+    if (manifest == NULL)
+    {
+        LogError("unable to open upload manifest %s, the upload will not be resumable", uploadContext->manifestPath);
+    }
+    else
+    {
+        if (fprintf(manifest, "%u\n%s", uploadContext->acknowledgedBlocks, uploadContext->destinationFileName) < 0)
+        {
+            LogError("unable to write upload manifest %s, the upload will not be resumable", uploadContext->manifestPath);
+        }
+        (void)fclose(manifest);
+    }
+}
+
+/*returns the blocks acknowledged by an earlier upload of the same file to destinationFileName, 0 if there was none*/
+static unsigned int read_upload_manifest(const char* manifestPath, const char* destinationFileName)
+{
+    unsigned int result = 0;
+    FILE* manifest = fopen(manifestPath, "rb");
+    if (manifest != NULL)
+    {
+        unsigned int acknowledgedBlocks;
+        if (fscanf(manifest, "%u", &acknowledgedBlocks) == 1 && fgetc(manifest) == '\n')
+        {
+            /*the name has to match exactly: read one character more than expected to detect a longer name*/
+            size_t destinationLength = strlen(destinationFileName);
+            char* recordedDestination = (char*)malloc(destinationLength + 1);
+            if (recordedDestination == NULL)
+            {
+                LogError("unable to allocate memory to read the upload manifest");
+            }
+            else
+            {
+                if ((fread(recordedDestination, 1, destinationLength + 1, manifest) == destinationLength) &&
+                    (memcmp(recordedDestination, destinationFileName, destinationLength) == 0))
+                {
+                    result = acknowledgedBlocks;
+                }
+                free(recordedDestination);
+            }
+        }
+        (void)fclose(manifest);
+    }
+    return result;
+}
+
+#ifdef USE_PAYLOAD_COMPRESSION
+static int start_file_compression(FILE_UPLOAD_CONTEXT* uploadContext)
+{
+    int result;
+
+    if ((uploadContext->gzip = gzip_stream_create()) == NULL)
+    {
+        LogError("unable to create the gzip stream");
+        result = __FAILURE__;
+    }
+    else if ((uploadContext->input = (unsigned char*)malloc(FILE_COMPRESSION_INPUT_SIZE)) == NULL)
+    {
+        LogError("unable to allocate the compression input buffer");
+        gzip_stream_destroy(uploadContext->gzip);
+        uploadContext->gzip = NULL;
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = 0;
+    }
+
+    return result;
+}
+
+static void stop_file_compression(FILE_UPLOAD_CONTEXT* uploadContext)
+{
+    if (uploadContext->gzip != NULL)
+    {
+        gzip_stream_destroy(uploadContext->gzip);
+        free(uploadContext->input);
+    }
+}
+
+/*fills the block with the next BLOCK_SIZE bytes of the gzip stream of the file (fewer for the last block), returns 0 on success*/
+static int read_compressed_block(FILE_UPLOAD_CONTEXT* uploadContext, size_t* blockSize)
+{
+    int result = 0;
+
+    *blockSize = 0;
+    while ((result == 0) && (*blockSize < BLOCK_SIZE) && !uploadContext->compressionEnded)
+    {
+        size_t consumed;
+        size_t written;
+
+        if ((uploadContext->inputLength == 0) && !uploadContext->inputEnded)
+        {
+            uploadContext->inputStart = 0;
+            uploadContext->inputLength = fread(uploadContext->input, 1, FILE_COMPRESSION_INPUT_SIZE, uploadContext->sourceFile);
+            if (uploadContext->inputLength < FILE_COMPRESSION_INPUT_SIZE)
+            {
+                if (ferror(uploadContext->sourceFile))
+                {
+                    result = __FAILURE__;
+                }
+                else
+                {
+                    uploadContext->inputEnded = true;
+                }
+            }
+        }
+
+        if (result != 0)
+        {
+            /*reported by the caller*/
+        }
+        else if (gzip_stream_compress(uploadContext->gzip, uploadContext->input + uploadContext->inputStart, uploadContext->inputLength, uploadContext->inputEnded,
+            uploadContext->block + *blockSize, BLOCK_SIZE - *blockSize, &consumed, &written, &uploadContext->compressionEnded) != 0)
+        {
+            LogError("unable to compress the file to upload");
+            result = __FAILURE__;
+        }
+        else
+        {
+            uploadContext->inputStart += consumed;
+            uploadContext->inputLength -= consumed;
+            *blockSize += written;
+        }
+    }
+
+    return result;
+}
+#endif /* USE_PAYLOAD_COMPRESSION */
+
+// this callback reads the source file block by block into the same buffer to be fed to IoTHubClient_LL_UploadMultipleBlocksToBlob(Ex)_Impl
+static IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_RESULT FileUpload_GetFileData_Callback(IOTHUB_CLIENT_FILE_UPLOAD_RESULT result, unsigned char const ** data, size_t* size, void* context)
+{
+    IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_RESULT getDataResult = IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_OK;
+    FILE_UPLOAD_CONTEXT* uploadContext = (FILE_UPLOAD_CONTEXT*)context;
+
+    if (data == NULL || size == NULL)
+    {
+        // This is the last call, nothing to do
+    }
+    else if (result != FILE_UPLOAD_OK)
+    {
+        // Last call failed
+        *data = NULL;
+        *size = 0;
+    }
+    else
+    {
+        size_t bytesRead;
+        int readResult;
+
+        if (uploadContext->blockPending)
+        {
+            /*being asked for the next block means storage acknowledged the previous one*/
+            uploadContext->blockPending = false;
+            uploadContext->acknowledgedBlocks++;
+            if (uploadContext->manifestPath != NULL)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_054: [ If `blob_upload_resumable` is on, every time storage acknowledges a block `IoTHubClient_LL_UploadFileToBlob_Impl` shall record `destinationFileName` and the number of acknowledged blocks in the manifest file `sourceFilePath` + ".upload". ]*/
+                write_upload_manifest(uploadContext);
+            }
+        }
+
+#ifdef USE_PAYLOAD_COMPRESSION
+        if (uploadContext->gzip != NULL)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_059: [ If `blob_upload_gzip` is on, `IoTHubClient_LL_UploadFileToBlob_Impl` shall upload the gzip stream of the file instead of the file, compressing it `FILE_COMPRESSION_INPUT_SIZE` bytes at a time into the same block buffer. ]*/
+            readResult = read_compressed_block(uploadContext, &bytesRead);
+        }
+        else
+#endif
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_048: [ For every block, `IoTHubClient_LL_UploadFileToBlob_Impl` shall read up to `BLOCK_SIZE` bytes of the file into the same buffer and hand that buffer to the upload. ]*/
+            bytesRead = fread(uploadContext->block, 1, BLOCK_SIZE, uploadContext->sourceFile);
+            readResult = ((bytesRead == 0) && ferror(uploadContext->sourceFile)) ? __FAILURE__ : 0;
+        }
+
+        if (readResult != 0)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_049: [ If reading the file fails, `IoTHubClient_LL_UploadFileToBlob_Impl` shall abort the upload and return `IOTHUB_CLIENT_ERROR`. ]*/
+            LogError("failure reading the file to upload");
+            uploadContext->readFailed = true;
+            getDataResult = IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_ABORT;
+        }
+        else if (bytesRead > 0)
+        {
+            *data = uploadContext->block;
+            *size = bytesRead;
+            uploadContext->blockPending = true;
+        }
+        else
+        {
+            // End of file, everything has been uploaded
+            *data = NULL;
+            *size = 0;
+        }
+    }
+
+    return getDataResult;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_UploadFileToBlob_Impl(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE handle, const char* destinationFileName, const char* sourceFilePath)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    /*Codes_SRS_IOTHUBCLIENT_LL_41_047: [ If `handle`, `destinationFileName` or `sourceFilePath` is `NULL` then `IoTHubClient_LL_UploadFileToBlob_Impl` shall fail and return `IOTHUB_CLIENT_INVALID_ARG`. ]*/
+    if (handle == NULL || destinationFileName == NULL || sourceFilePath == NULL)
+    {
+        LogError("Invalid parameter handle:%p destinationFileName:%p sourceFilePath:%p", handle, destinationFileName, sourceFilePath);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA* upload_data = (IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE_DATA*)handle;
+        FILE_UPLOAD_CONTEXT context;
+        bool resumable = upload_data->resumable_file_uploads;
+        context.readFailed = false;
+        context.destinationFileName = destinationFileName;
+        context.manifestPath = NULL;
+        context.acknowledgedBlocks = 0;
+        context.blockPending = false;
+#ifdef USE_PAYLOAD_COMPRESSION
+        context.gzip = NULL;
+        context.input = NULL;
+        context.inputStart = 0;
+        context.inputLength = 0;
+        context.inputEnded = false;
+        context.compressionEnded = false;
+        if (upload_data->gzip_file_uploads && resumable)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_060: [ If `blob_upload_gzip` is on, `IoTHubClient_LL_UploadFileToBlob_Impl` shall ignore `blob_upload_resumable`. ]*/
+            LogInfo("compressed file uploads cannot be resumed, %s will be uploaded from the start", sourceFilePath);
+            resumable = false;
+        }
+#endif
+
+        /*Codes_SRS_IOTHUBCLIENT_LL_41_050: [ If the file cannot be opened or the block buffer cannot be allocated then `IoTHubClient_LL_UploadFileToBlob_Impl` shall fail and return `IOTHUB_CLIENT_ERROR`. ]*/
+        if ((context.sourceFile = fopen(sourceFilePath, "rb")) == NULL)
+        {
+            LogError("unable to open file %s", sourceFilePath);
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else
+        {
+            if ((context.block = (unsigned char*)malloc(BLOCK_SIZE)) == NULL)
+            {
+                LogError("unable to allocate the upload block buffer");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else if (resumable && ((context.manifestPath = (char*)malloc(strlen(sourceFilePath) + sizeof(UPLOAD_MANIFEST_SUFFIX))) == NULL))
+            {
+                LogError("unable to allocate the upload manifest path");
+                result = IOTHUB_CLIENT_ERROR;
+                free(context.block);
+            }
+#ifdef USE_PAYLOAD_COMPRESSION
+            else if (upload_data->gzip_file_uploads && (start_file_compression(&context) != 0))
+            {
+                LogError("unable to start compressing the file to upload");
+                result = IOTHUB_CLIENT_ERROR;
+                free(context.block);
+            }
+#endif
+            else
+            {
+                unsigned int skippedBlocks;
+
+                if (context.manifestPath != NULL)
+                {
+                    (void)strcpy(context.manifestPath, sourceFilePath);
+                    (void)strcat(context.manifestPath, UPLOAD_MANIFEST_SUFFIX);
+
+                    /*Codes_SRS_IOTHUBCLIENT_LL_41_055: [ If `blob_upload_resumable` is on and the manifest records blocks acknowledged for the same `destinationFileName`, `IoTHubClient_LL_UploadFileToBlob_Impl` shall skip that many blocks of the file. ]*/
+                    context.acknowledgedBlocks = read_upload_manifest(context.manifestPath, destinationFileName);
+                }
+
+                /*seeking one block at a time keeps the offset within a long on every platform*/
+                for (skippedBlocks = 0; skippedBlocks < context.acknowledgedBlocks; skippedBlocks++)
+                {
+                    if (fseek(context.sourceFile, BLOCK_SIZE, SEEK_CUR) != 0)
+                    {
+                        LogError("unable to skip the blocks already uploaded, uploading %s from the start", sourceFilePath);
+                        rewind(context.sourceFile);
+                        context.acknowledgedBlocks = 0;
+                        break;
+                    }
+                }
+
+                if (context.acknowledgedBlocks > 0)
+                {
+                    LogInfo("resuming upload of %s after %u blocks", sourceFilePath, context.acknowledgedBlocks);
+                }
+
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_051: [ `IoTHubClient_LL_UploadFileToBlob_Impl` shall call `IoTHubClient_LL_UploadMultipleBlocksToBlob_Impl` with a callback reading the file and return its result. ]*/
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_175: [ When the upload keeps a manifest, `IoTHubClient_LL_UploadFileToBlob_Impl` shall upload one block at a time whatever `OPTION_BLOB_UPLOAD_PARALLELISM` is, since being asked for the next block is what acknowledges the previous one. ]*/
+                result = upload_multiple_blocks_to_blob(handle, destinationFileName, FileUpload_GetFileData_Callback, &context, context.acknowledgedBlocks, (context.manifestPath != NULL) ? 1 : upload_data->blob_upload_parallelism);
+                if (context.readFailed)
+                {
+                    /*Codes_SRS_IOTHUBCLIENT_LL_41_049: [ If reading the file fails, `IoTHubClient_LL_UploadFileToBlob_Impl` shall abort the upload and return `IOTHUB_CLIENT_ERROR`. ]*/
+                    result = IOTHUB_CLIENT_ERROR;
+                }
+
+                if (context.manifestPath != NULL)
+                {
+                    if (result == IOTHUB_CLIENT_OK)
+                    {
+                        /*Codes_SRS_IOTHUBCLIENT_LL_41_057: [ Once the upload succeeds, `IoTHubClient_LL_UploadFileToBlob_Impl` shall delete the manifest file. ]*/
+                        (void)remove(context.manifestPath);
+                    }
+                    free(context.manifestPath);
+                }
+#ifdef USE_PAYLOAD_COMPRESSION
+                stop_file_compression(&context);
+#endif
+                free(context.block);
+            }
+            (void)fclose(context.sourceFile);
+        }
+    }
+    return result;
+}
+
 void IoTHubClient_LL_UploadToBlob_Destroy(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE handle)
 {
     if (handle == NULL)
@@ -930,10 +1448,7 @@ void IoTHubClient_LL_UploadToBlob_Destroy(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h
         }
 
         free((void*)upload_data->hostname);
-        if (upload_data->certificates != NULL)
-        {
-            free(upload_data->certificates);
-        }
+        trust_store_release(upload_data->certificates);
         if (upload_data->http_proxy_options.host_address != NULL)
         {
             free((char *)upload_data->http_proxy_options.host_address);
@@ -946,6 +1461,12 @@ void IoTHubClient_LL_UploadToBlob_Destroy(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h
         {
             free((char *)upload_data->http_proxy_options.password);
         }
+        if (upload_data->connection_lock != NULL)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_070: [ `IoTHubClient_LL_UploadToBlob_Destroy` shall destroy the kept connections. ]*/
+            drop_kept_connections(upload_data);
+            (void)Lock_Deinit(upload_data->connection_lock);
+        }
         free(upload_data);
     }
 }
@@ -1036,18 +1557,15 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_UploadToBlob_SetOption(IOTHUB_CLIENT_LL_UPL
             }
             else
             {
-                char* tempCopy;
-                if (mallocAndStrcpy_s(&tempCopy, value) != 0)
+                const char* tempCopy;
+                if ((tempCopy = trust_store_acquire((const char*)value)) == NULL)
                 {
-                    LogError("failure in mallocAndStrcpy_s");
+                    LogError("failure in trust_store_acquire");
                     result = IOTHUB_CLIENT_ERROR;
                 }
                 else
                 {
-                    if (upload_data->certificates != NULL)
-                    {
-                        free(upload_data->certificates);
-                    }
+                    trust_store_release(upload_data->certificates);
                     upload_data->certificates = tempCopy;
                     result = IOTHUB_CLIENT_OK;
                 }
@@ -1122,11 +1640,56 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_UploadToBlob_SetOption(IOTHUB_CLIENT_LL_UPL
             upload_data->blob_upload_timeout_secs = *(size_t*)value;
             result = IOTHUB_CLIENT_OK;
         }
+        else if (strcmp(optionName, OPTION_BLOB_UPLOAD_RESUMABLE) == 0)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_058: [ If optionName is `OPTION_BLOB_UPLOAD_RESUMABLE` then `IoTHubClient_LL_UploadToBlob_SetOption` shall save the bool pointed to by `value` and return `IOTHUB_CLIENT_OK`. ]*/
+            upload_data->resumable_file_uploads = *(bool*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
+        else if (strcmp(optionName, OPTION_BLOB_UPLOAD_GZIP) == 0)
+        {
+#ifdef USE_PAYLOAD_COMPRESSION
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_061: [ If optionName is `OPTION_BLOB_UPLOAD_GZIP` then `IoTHubClient_LL_UploadToBlob_SetOption` shall save the bool pointed to by `value` and return `IOTHUB_CLIENT_OK`. ]*/
+            upload_data->gzip_file_uploads = *(bool*)value;
+            result = IOTHUB_CLIENT_OK;
+#else
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_062: [ If the SDK is built without `use_payload_compression`, setting `OPTION_BLOB_UPLOAD_GZIP` shall fail and return `IOTHUB_CLIENT_ERROR`. ]*/
+            LogError("option %s needs the SDK to be built with use_payload_compression", optionName);
+            result = IOTHUB_CLIENT_ERROR;
+#endif
+        }
+        else if (strcmp(optionName, OPTION_BLOB_UPLOAD_KEEP_ALIVE_SECS) == 0)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_067: [ If optionName is `OPTION_BLOB_UPLOAD_KEEP_ALIVE_SECS` then `IoTHubClient_LL_UploadToBlob_SetOption` shall save the size_t pointed to by `value` and return `IOTHUB_CLIENT_OK`. ]*/
+            if (upload_data->connection_lock == NULL && *(size_t*)value != 0 && (upload_data->connection_lock = Lock_Init()) == NULL)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_41_068: [ If creating the lock guarding the kept connections fails, `IoTHubClient_LL_UploadToBlob_SetOption` shall fail and return `IOTHUB_CLIENT_ERROR`. ]*/
+                LogError("unable to create the lock for option %s", optionName);
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                upload_data->keep_alive_secs = *(size_t*)value;
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        else if (strcmp(optionName, OPTION_BLOB_UPLOAD_PARALLELISM) == 0)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_172: [ If optionName is `OPTION_BLOB_UPLOAD_PARALLELISM` then `IoTHubClient_LL_UploadToBlob_SetOption` shall save the size_t pointed to by `value` and return `IOTHUB_CLIENT_OK`. ]*/
+            upload_data->blob_upload_parallelism = *(size_t*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
         else
         {
             /*Codes_SRS_IOTHUBCLIENT_LL_02_102: [ If an unknown option is presented then IoTHubClient_LL_UploadToBlob_SetOption shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
             result = IOTHUB_CLIENT_INVALID_ARG;
         }
+
+        if (result == IOTHUB_CLIENT_OK)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_41_069: [ When an option is set successfully, `IoTHubClient_LL_UploadToBlob_SetOption` shall destroy the kept connections so that the next upload applies the new options. ]*/
+            drop_kept_connections(upload_data);
+        }
     }
     return result;
 }
@@ -0,0 +1,191 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/lock.h"
+
+#include "iothub_client_memory.h"
+#include "internal/iothub_client_memory_private.h"
+
+#define RESULT_OK 0
+
+DEFINE_ENUM_STRINGS(IOTHUB_CLIENT_MEMORY_TAG, IOTHUB_CLIENT_MEMORY_TAG_VALUES);
+
+bool g_iothub_client_memory_accounting = false;
+
+/*guards the list only, the counters in it are written by their owners without it*/
+static LOCK_HANDLE g_memory_lock = NULL;
+static IOTHUB_CLIENT_MEMORY_COUNTERS* g_memory_counters = NULL;
+
+int IoTHubClient_Memory_Init(void)
+{
+    int result;
+
+    /*Codes_SRS_IOTHUB_CLIENT_MEMORY_41_001: [ IoTHubClient_Memory_Init shall create a lock and fail with a non-zero value if it cannot. ]*/
+    if ((g_memory_lock = Lock_Init()) == NULL)
+    {
+        LogError("Cannot create the lock of the memory accounting");
+        result = __FAILURE__;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_MEMORY_41_002: [ IoTHubClient_Memory_Init shall start with no counters registered and set `g_iothub_client_memory_accounting`, so that the clients, transports and stores created after it register their counters. ]*/
+        g_memory_counters = NULL;
+        g_iothub_client_memory_accounting = true;
+        result = RESULT_OK;
+    }
+
+    return result;
+}
+
+void IoTHubClient_Memory_Deinit(void)
+{
+    /*Codes_SRS_IOTHUB_CLIENT_MEMORY_41_003: [ IoTHubClient_Memory_Deinit shall stop registering counters, forget the ones still registered and free the lock; it shall do nothing if counting is not started. ]*/
+    g_iothub_client_memory_accounting = false;
+    if (g_memory_lock != NULL)
+    {
+        while (g_memory_counters != NULL)
+        {
+            IOTHUB_CLIENT_MEMORY_COUNTERS* counters = g_memory_counters;
+            g_memory_counters = counters->next;
+            counters->registered = false;
+        }
+        (void)Lock_Deinit(g_memory_lock);
+        g_memory_lock = NULL;
+    }
+}
+
+void IoTHubClient_Memory_Register(IOTHUB_CLIENT_MEMORY_COUNTERS* counters)
+{
+    if ((counters == NULL) || (counters->registered) || (g_memory_lock == NULL))
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_MEMORY_41_004: [ If counters is NULL or already registered, or counting is not started, IoTHubClient_Memory_Register shall do nothing. ]*/
+    }
+    else if (Lock(g_memory_lock) != LOCK_OK)
+    {
+        LogError("Cannot lock the memory accounting");
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_MEMORY_41_005: [ IoTHubClient_Memory_Register shall add counters to the counters summed by IoTHubClient_Memory_GetUsage. ]*/
+        counters->previous = NULL;
+        counters->next = g_memory_counters;
+        if (g_memory_counters != NULL)
+        {
+            g_memory_counters->previous = counters;
+        }
+        g_memory_counters = counters;
+        counters->registered = true;
+
+        (void)Unlock(g_memory_lock);
+    }
+}
+
+void IoTHubClient_Memory_Unregister(IOTHUB_CLIENT_MEMORY_COUNTERS* counters)
+{
+    if ((counters == NULL) || (!counters->registered) || (g_memory_lock == NULL))
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_MEMORY_41_010: [ If counters is NULL or not registered, or counting is not started, IoTHubClient_Memory_Unregister shall do nothing. ]*/
+    }
+    else if (Lock(g_memory_lock) != LOCK_OK)
+    {
+        LogError("Cannot lock the memory accounting");
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_MEMORY_41_006: [ IoTHubClient_Memory_Unregister shall remove counters from the counters summed, so that what its owner held no longer counts. ]*/
+        if (counters->previous != NULL)
+        {
+            counters->previous->next = counters->next;
+        }
+        else
+        {
+            g_memory_counters = counters->next;
+        }
+        if (counters->next != NULL)
+        {
+            counters->next->previous = counters->previous;
+        }
+        counters->previous = NULL;
+        counters->next = NULL;
+        counters->registered = false;
+
+        (void)Unlock(g_memory_lock);
+    }
+}
+
+static size_t add_saturated(size_t left, size_t right)
+{
+    return (right > SIZE_MAX - left) ? SIZE_MAX : left + right;
+}
+
+int IoTHubClient_Memory_GetUsage(IOTHUB_CLIENT_MEMORY_TAG tag, IOTHUB_CLIENT_MEMORY_USAGE* usage)
+{
+    int result;
+
+    /*Codes_SRS_IOTHUB_CLIENT_MEMORY_41_007: [ If usage is NULL, tag is not a tag or counting is not started, IoTHubClient_Memory_GetUsage shall fail and return a non-zero value. ]*/
+    if ((usage == NULL) || ((size_t)tag >= IOTHUB_CLIENT_MEMORY_TAG_COUNT))
+    {
+        LogError("Invalid argument (usage=%p, tag=%d)", (void*)usage, (int)tag);
+        result = __FAILURE__;
+    }
+    else if (g_memory_lock == NULL)
+    {
+        LogError("Memory accounting is not started, IoTHub_Init was not called");
+        result = __FAILURE__;
+    }
+    else if (Lock(g_memory_lock) != LOCK_OK)
+    {
+        LogError("Cannot lock the memory accounting");
+        result = __FAILURE__;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_MEMORY_41_008: [ IoTHubClient_Memory_GetUsage shall set usage to the sum of the current and of the peak bytes of tag of the registered counters and return 0. ]*/
+        /*the counters are read without the locks of their owners, so an update in flight may be missed*/
+        IOTHUB_CLIENT_MEMORY_COUNTERS* counters;
+
+        usage->current_bytes = 0;
+        usage->peak_bytes = 0;
+        for (counters = g_memory_counters; counters != NULL; counters = counters->next)
+        {
+            usage->current_bytes = add_saturated(usage->current_bytes, counters->usage[tag].current_bytes);
+            usage->peak_bytes = add_saturated(usage->peak_bytes, counters->usage[tag].peak_bytes);
+        }
+        (void)Unlock(g_memory_lock);
+        result = RESULT_OK;
+    }
+
+    return result;
+}
+
+void IoTHubClient_Memory_ResetPeaks(void)
+{
+    if (g_memory_lock == NULL)
+    {
+        LogError("Memory accounting is not started, IoTHub_Init was not called");
+    }
+    else if (Lock(g_memory_lock) != LOCK_OK)
+    {
+        LogError("Cannot lock the memory accounting");
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_MEMORY_41_009: [ IoTHubClient_Memory_ResetPeaks shall set the peak bytes of every tag of the registered counters to their current bytes. ]*/
+        /*like GetUsage this does not take the locks of the owners, a peak they raise meanwhile may be reset with the others*/
+        IOTHUB_CLIENT_MEMORY_COUNTERS* counters;
+        for (counters = g_memory_counters; counters != NULL; counters = counters->next)
+        {
+            size_t index;
+            for (index = 0; index < IOTHUB_CLIENT_MEMORY_TAG_COUNT; index++)
+            {
+                counters->usage[index].peak_bytes = counters->usage[index].current_bytes;
+            }
+        }
+        (void)Unlock(g_memory_lock);
+    }
+}
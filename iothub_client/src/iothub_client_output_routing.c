@@ -0,0 +1,250 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <string.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+#include "internal/iothub_client_output_routing.h"
+
+#define RESULT_OK 0
+
+/*the strings of a route are kept right after it, in the same allocation*/
+typedef struct OUTPUT_ROUTE_TAG
+{
+    struct OUTPUT_ROUTE_TAG* next;
+    const char* property_name;
+    const char* property_value;
+    const char* output_name;
+} OUTPUT_ROUTE;
+
+typedef struct OUTPUT_ROUTING_TAG
+{
+    OUTPUT_ROUTE* routes;
+    size_t route_count;
+    const char** output_names; /*room for route_count outputs, filled by output_routing_evaluate*/
+} OUTPUT_ROUTING;
+
+static bool are_equal(const char* left, const char* right)
+{
+    return ((left == NULL) || (right == NULL)) ? (left == right) : (strcmp(left, right) == 0);
+}
+
+static bool is_route(const OUTPUT_ROUTE* route, const IOTHUB_CLIENT_OUTPUT_ROUTE* configuration)
+{
+    return are_equal(route->property_name, configuration->property_name) &&
+        are_equal(route->property_value, configuration->property_value) &&
+        (strcmp(route->output_name, configuration->output_name) == 0);
+}
+
+static OUTPUT_ROUTE** find_route(OUTPUT_ROUTING* routing, const IOTHUB_CLIENT_OUTPUT_ROUTE* configuration)
+{
+    OUTPUT_ROUTE** result = &routing->routes;
+
+    while ((*result != NULL) && !is_route(*result, configuration))
+    {
+        result = &(*result)->next;
+    }
+
+    return result;
+}
+
+static const char* copy_string(char** position, const char* value)
+{
+    const char* result;
+
+    if (value == NULL)
+    {
+        result = NULL;
+    }
+    else
+    {
+        size_t length = strlen(value) + 1;
+        (void)memcpy(*position, value, length);
+        result = *position;
+        *position += length;
+    }
+
+    return result;
+}
+
+static OUTPUT_ROUTE* create_route(const IOTHUB_CLIENT_OUTPUT_ROUTE* configuration)
+{
+    size_t size = sizeof(OUTPUT_ROUTE) + strlen(configuration->output_name) + 1 +
+        ((configuration->property_name == NULL) ? 0 : strlen(configuration->property_name) + 1) +
+        ((configuration->property_value == NULL) ? 0 : strlen(configuration->property_value) + 1);
+    OUTPUT_ROUTE* result;
+
+    if ((result = (OUTPUT_ROUTE*)malloc(size)) == NULL)
+    {
+        LogError("Failed allocating the route to %s", configuration->output_name);
+    }
+    else
+    {
+        char* position = (char*)(result + 1);
+
+        result->next = NULL;
+        result->property_name = copy_string(&position, configuration->property_name);
+        result->property_value = copy_string(&position, configuration->property_value);
+        result->output_name = copy_string(&position, configuration->output_name);
+    }
+
+    return result;
+}
+
+/*a route without a property matches every message, and one without a value any message holding the property*/
+static bool is_matching(const OUTPUT_ROUTE* route, IOTHUB_MESSAGE_HANDLE message)
+{
+    bool result;
+
+    if (route->property_name == NULL)
+    {
+        result = true;
+    }
+    else
+    {
+        const char* value = IoTHubMessage_GetProperty(message, route->property_name);
+        result = (value != NULL) && ((route->property_value == NULL) || (strcmp(value, route->property_value) == 0));
+    }
+
+    return result;
+}
+
+OUTPUT_ROUTING_HANDLE output_routing_create(void)
+{
+    OUTPUT_ROUTING* result;
+
+    /*Codes_SRS_OUTPUT_ROUTING_41_001: [ output_routing_create shall return a new routing without any route, or NULL if it cannot be allocated. ]*/
+    if ((result = (OUTPUT_ROUTING*)malloc(sizeof(OUTPUT_ROUTING))) == NULL)
+    {
+        LogError("Failed allocating the output routing");
+    }
+    else
+    {
+        result->routes = NULL;
+        result->route_count = 0;
+        result->output_names = NULL;
+    }
+
+    return result;
+}
+
+void output_routing_destroy(OUTPUT_ROUTING_HANDLE routing)
+{
+    /*Codes_SRS_OUTPUT_ROUTING_41_002: [ output_routing_destroy shall free all the routes; it shall do nothing if routing is NULL. ]*/
+    if (routing != NULL)
+    {
+        while (routing->routes != NULL)
+        {
+            OUTPUT_ROUTE* route = routing->routes;
+            routing->routes = route->next;
+            free(route);
+        }
+        free((void*)routing->output_names);
+        free(routing);
+    }
+}
+
+int output_routing_configure(OUTPUT_ROUTING_HANDLE routing, const IOTHUB_CLIENT_OUTPUT_ROUTE* route)
+{
+    int result;
+
+    /*Codes_SRS_OUTPUT_ROUTING_41_003: [ If routing, route or its output_name is NULL, or route has a property_value but no property_name, output_routing_configure shall fail and return a non-zero value. ]*/
+    if ((routing == NULL) || (route == NULL) || (route->output_name == NULL) || ((route->property_name == NULL) && (route->property_value != NULL)))
+    {
+        LogError("Invalid argument (routing=%p, route=%p)", routing, route);
+        result = __FAILURE__;
+    }
+    else
+    {
+        OUTPUT_ROUTE** position = find_route(routing, route);
+
+        if (route->remove)
+        {
+            /*Codes_SRS_OUTPUT_ROUTING_41_004: [ If remove is true, output_routing_configure shall remove the route holding the same property_name, property_value and output_name, if any, and succeed. ]*/
+            OUTPUT_ROUTE* removed;
+            if ((removed = *position) != NULL)
+            {
+                *position = removed->next;
+                free(removed);
+                routing->route_count--;
+            }
+            result = RESULT_OK;
+        }
+        else if (*position != NULL)
+        {
+            /*Codes_SRS_OUTPUT_ROUTING_41_005: [ Otherwise output_routing_configure shall append the route after the others, unless the routing already holds it, and fail leaving the routes as they were if it cannot be allocated. ]*/
+            result = RESULT_OK;
+        }
+        else
+        {
+            const char** output_names;
+            OUTPUT_ROUTE* added;
+
+            if ((output_names = (const char**)realloc((void*)routing->output_names, (routing->route_count + 1) * sizeof(const char*))) == NULL)
+            {
+                LogError("Failed allocating the outputs of %lu routes", (unsigned long)(routing->route_count + 1));
+                result = __FAILURE__;
+            }
+            else
+            {
+                /*the larger array is kept even if the route cannot be added*/
+                routing->output_names = output_names;
+
+                if ((added = create_route(route)) == NULL)
+                {
+                    result = __FAILURE__;
+                }
+                else
+                {
+                    *position = added;
+                    routing->route_count++;
+                    result = RESULT_OK;
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+size_t output_routing_evaluate(OUTPUT_ROUTING_HANDLE routing, IOTHUB_MESSAGE_HANDLE message, const char* const** output_names)
+{
+    size_t result = 0;
+
+    /*Codes_SRS_OUTPUT_ROUTING_41_006: [ If routing, message or output_names is NULL, output_routing_evaluate shall return 0. ]*/
+    if ((routing == NULL) || (message == NULL) || (output_names == NULL))
+    {
+        LogError("Invalid argument (routing=%p, message=%p, output_names=%p)", routing, message, output_names);
+    }
+    else
+    {
+        OUTPUT_ROUTE* route;
+
+        /*Codes_SRS_OUTPUT_ROUTING_41_007: [ A route shall match message if it has no property_name, or message has the application property property_name holding property_value, or holding any value if property_value is NULL. ]*/
+        /*Codes_SRS_OUTPUT_ROUTING_41_008: [ output_routing_evaluate shall evaluate every route once and set output_names to the outputs of the routes that match, each once, in the order of the routes, and return their number. ]*/
+        for (route = routing->routes; route != NULL; route = route->next)
+        {
+            if (is_matching(route, message))
+            {
+                size_t index = 0;
+
+                while ((index < result) && (strcmp(routing->output_names[index], route->output_name) != 0))
+                {
+                    index++;
+                }
+
+                if (index == result)
+                {
+                    routing->output_names[result++] = route->output_name;
+                }
+            }
+        }
+
+        *output_names = routing->output_names;
+    }
+
+    return result;
+}
@@ -0,0 +1,227 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <string.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+#include "internal/iothub_client_report_by_exception.h"
+
+#define RESULT_OK 0
+
+typedef struct REPORT_FILTER_TAG
+{
+    struct REPORT_FILTER_TAG* next;
+    char* property_name;
+    double deadband;
+    tickcounter_ms_t heartbeat_ms;
+    bool has_last; /*false until an event holding the property is sent*/
+    double last_value;
+    tickcounter_ms_t last_sent;
+    bool has_value; /*the property of the event being checked holds a number, kept in value*/
+    double value;
+} REPORT_FILTER;
+
+typedef struct REPORT_BY_EXCEPTION_TAG
+{
+    REPORT_FILTER* filters;
+} REPORT_BY_EXCEPTION;
+
+static REPORT_FILTER** find_filter(REPORT_BY_EXCEPTION* report_by_exception, const char* property_name)
+{
+    REPORT_FILTER** result = &report_by_exception->filters;
+
+    while ((*result != NULL) && (strcmp((*result)->property_name, property_name) != 0))
+    {
+        result = &(*result)->next;
+    }
+
+    return result;
+}
+
+static void destroy_filter(REPORT_FILTER* filter)
+{
+    free(filter->property_name);
+    free(filter);
+}
+
+static REPORT_FILTER* create_filter(const IOTHUB_CLIENT_REPORT_BY_EXCEPTION* configuration)
+{
+    REPORT_FILTER* result;
+
+    if ((result = (REPORT_FILTER*)malloc(sizeof(REPORT_FILTER))) == NULL)
+    {
+        LogError("Failed allocating the report filter");
+    }
+    else
+    {
+        (void)memset(result, 0, sizeof(REPORT_FILTER));
+
+        if ((result->property_name = (char*)malloc(strlen(configuration->property_name) + 1)) == NULL)
+        {
+            LogError("Failed allocating the property name of the report filter");
+            free(result);
+            result = NULL;
+        }
+        else
+        {
+            (void)strcpy(result->property_name, configuration->property_name);
+            result->deadband = configuration->deadband;
+            result->heartbeat_ms = configuration->heartbeat_ms;
+        }
+    }
+
+    return result;
+}
+
+static bool parse_number(const char* text, double* value)
+{
+    char* end;
+    bool result;
+
+    if ((text == NULL) || (*text == '\0'))
+    {
+        result = false;
+    }
+    else
+    {
+        *value = strtod(text, &end);
+        result = (*end == '\0');
+    }
+
+    return result;
+}
+
+REPORT_BY_EXCEPTION_HANDLE report_by_exception_create(void)
+{
+    REPORT_BY_EXCEPTION* result;
+
+    /*Codes_SRS_REPORT_BY_EXCEPTION_41_001: [ report_by_exception_create shall return a new report by exception without any filter, or NULL if it cannot be allocated. ]*/
+    if ((result = (REPORT_BY_EXCEPTION*)malloc(sizeof(REPORT_BY_EXCEPTION))) == NULL)
+    {
+        LogError("Failed allocating the report by exception");
+    }
+    else
+    {
+        result->filters = NULL;
+    }
+
+    return result;
+}
+
+void report_by_exception_destroy(REPORT_BY_EXCEPTION_HANDLE report_by_exception)
+{
+    /*Codes_SRS_REPORT_BY_EXCEPTION_41_002: [ report_by_exception_destroy shall free all the filters; it shall do nothing if report_by_exception is NULL. ]*/
+    if (report_by_exception != NULL)
+    {
+        while (report_by_exception->filters != NULL)
+        {
+            REPORT_FILTER* filter = report_by_exception->filters;
+            report_by_exception->filters = filter->next;
+            destroy_filter(filter);
+        }
+        free(report_by_exception);
+    }
+}
+
+int report_by_exception_configure(REPORT_BY_EXCEPTION_HANDLE report_by_exception, const IOTHUB_CLIENT_REPORT_BY_EXCEPTION* configuration)
+{
+    int result;
+
+    /*Codes_SRS_REPORT_BY_EXCEPTION_41_003: [ If report_by_exception, configuration or its property_name is NULL, report_by_exception_configure shall fail and return a non-zero value. ]*/
+    if ((report_by_exception == NULL) || (configuration == NULL) || (configuration->property_name == NULL))
+    {
+        LogError("Invalid argument (report_by_exception=%p, configuration=%p)", report_by_exception, configuration);
+        result = __FAILURE__;
+    }
+    else
+    {
+        REPORT_FILTER** position = find_filter(report_by_exception, configuration->property_name);
+        REPORT_FILTER* filter;
+
+        if (configuration->deadband < 0)
+        {
+            /*Codes_SRS_REPORT_BY_EXCEPTION_41_004: [ If deadband is negative, report_by_exception_configure shall remove the filter of property_name, if any, and succeed. ]*/
+            if ((filter = *position) != NULL)
+            {
+                *position = filter->next;
+                destroy_filter(filter);
+            }
+            result = RESULT_OK;
+        }
+        /*Codes_SRS_REPORT_BY_EXCEPTION_41_005: [ Otherwise report_by_exception_configure shall create a filter for property_name without a last value, replacing any filter of property_name, and fail leaving the previous filter in place if it cannot be allocated. ]*/
+        else if ((filter = create_filter(configuration)) == NULL)
+        {
+            result = __FAILURE__;
+        }
+        else
+        {
+            if (*position != NULL)
+            {
+                filter->next = (*position)->next;
+                destroy_filter(*position);
+            }
+            *position = filter;
+            result = RESULT_OK;
+        }
+    }
+
+    return result;
+}
+
+bool report_by_exception_is_suppressed(REPORT_BY_EXCEPTION_HANDLE report_by_exception, IOTHUB_MESSAGE_HANDLE message, tickcounter_ms_t now)
+{
+    bool result;
+
+    /*Codes_SRS_REPORT_BY_EXCEPTION_41_006: [ If report_by_exception or message is NULL, report_by_exception_is_suppressed shall return false. ]*/
+    if ((report_by_exception == NULL) || (message == NULL))
+    {
+        LogError("Invalid argument (report_by_exception=%p, message=%p)", report_by_exception, message);
+        result = false;
+    }
+    else
+    {
+        REPORT_FILTER* filter;
+        bool has_news = false;
+        bool has_value = false;
+
+        /*Codes_SRS_REPORT_BY_EXCEPTION_41_007: [ Only the filtered properties of message whose value is a number shall count; report_by_exception_is_suppressed shall return false if message has none. ]*/
+        /*Codes_SRS_REPORT_BY_EXCEPTION_41_008: [ A property shall be news if its filter has no last value, its value is more than deadband away from the last one, or heartbeat_ms is not 0 and have passed since the last one was sent. ]*/
+        for (filter = report_by_exception->filters; filter != NULL; filter = filter->next)
+        {
+            filter->has_value = parse_number(IoTHubMessage_GetProperty(message, filter->property_name), &filter->value);
+            if (filter->has_value)
+            {
+                has_value = true;
+                if (!filter->has_last ||
+                    (filter->value - filter->last_value > filter->deadband) ||
+                    (filter->last_value - filter->value > filter->deadband) ||
+                    ((filter->heartbeat_ms != 0) && (now - filter->last_sent >= filter->heartbeat_ms)))
+                {
+                    has_news = true;
+                }
+            }
+        }
+
+        /*Codes_SRS_REPORT_BY_EXCEPTION_41_009: [ report_by_exception_is_suppressed shall return true if none of the properties that count is news. ]*/
+        result = has_value && !has_news;
+
+        /*Codes_SRS_REPORT_BY_EXCEPTION_41_010: [ Otherwise the filters of the properties that count shall take their values and now as the last ones sent, and report_by_exception_is_suppressed shall return false. ]*/
+        if (has_news)
+        {
+            for (filter = report_by_exception->filters; filter != NULL; filter = filter->next)
+            {
+                if (filter->has_value)
+                {
+                    filter->has_last = true;
+                    filter->last_value = filter->value;
+                    filter->last_sent = now;
+                }
+            }
+        }
+    }
+
+    return result;
+}
@@ -4,6 +4,7 @@
 #include "internal/iothub_client_retry_control.h"
 
 #include <math.h>
+#include <limits.h>
 
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/agenttime.h"
@@ -20,6 +21,7 @@ typedef struct RETRY_CONTROL_INSTANCE_TAG
 
     unsigned int initial_wait_time_in_secs;
     unsigned int max_jitter_percent;
+    unsigned int max_wait_time_in_secs;
 
     unsigned int retry_count;
     time_t first_retry_time;
@@ -44,7 +46,8 @@ static void* retry_control_clone_option(const char* name, const void* value)
         result = NULL;
     }
     else if (strcmp(RETRY_CONTROL_OPTION_INITIAL_WAIT_TIME_IN_SECS, name) == 0 ||
-            strcmp(RETRY_CONTROL_OPTION_MAX_JITTER_PERCENT, name) == 0)
+            strcmp(RETRY_CONTROL_OPTION_MAX_JITTER_PERCENT, name) == 0 ||
+            strcmp(RETRY_CONTROL_OPTION_MAX_WAIT_TIME_IN_SECS, name) == 0)
     {
         unsigned int* cloned_value;
 
@@ -76,7 +79,8 @@ static void retry_control_destroy_option(const char* name, const void* value)
         LogError("Failed to destroy option (either name (%p) or value (%p) are NULL)", name, value);
     }
     else if (strcmp(RETRY_CONTROL_OPTION_INITIAL_WAIT_TIME_IN_SECS, name) == 0 ||
-        strcmp(RETRY_CONTROL_OPTION_MAX_JITTER_PERCENT, name) == 0)
+        strcmp(RETRY_CONTROL_OPTION_MAX_JITTER_PERCENT, name) == 0 ||
+        strcmp(RETRY_CONTROL_OPTION_MAX_WAIT_TIME_IN_SECS, name) == 0)
     {
         free((void*)value);
     }
@@ -154,7 +158,17 @@ static int evaluate_retry_action(RETRY_CONTROL_INSTANCE* retry_control, RETRY_AC
     return result;
 }
 
-static unsigned int calculate_next_wait_time(RETRY_CONTROL_INSTANCE* retry_control)
+static bool is_jittered_policy(IOTHUB_CLIENT_RETRY_POLICY policy)
+{
+    return (policy == IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_JITTER || policy == IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_DECORRELATED_JITTER);
+}
+
+static unsigned int to_wait_time(double wait_time_in_secs)
+{
+    return (wait_time_in_secs >= (double)UINT_MAX) ? UINT_MAX : (unsigned int)wait_time_in_secs;
+}
+
+static unsigned int calculate_wait_time(const RETRY_CONTROL_INSTANCE* retry_control, unsigned int retry_count, unsigned int previous_wait_time_in_secs)
 {
     unsigned int result;
 
@@ -166,19 +180,19 @@ static unsigned int calculate_next_wait_time(RETRY_CONTROL_INSTANCE* retry_contr
     // Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_030: [If `retry_control->policy` is IOTHUB_CLIENT_RETRY_LINEAR_BACKOFF, `calculate_next_wait_time` shall return (`retry_control->initial_wait_time_in_secs` * (`retry_control->retry_count`))]
     else if (retry_control->policy == IOTHUB_CLIENT_RETRY_LINEAR_BACKOFF)
     {
-        result = retry_control->initial_wait_time_in_secs * (retry_control->retry_count);
+        result = retry_control->initial_wait_time_in_secs * (retry_count);
     }
     // Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_031: [If `retry_control->policy` is IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF, `calculate_next_wait_time` shall return (pow(2, `retry_control->retry_count` - 1) * `retry_control->initial_wait_time_in_secs`)]
     else if (retry_control->policy == IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF)
     {
-        result = (unsigned int)(pow(2, retry_control->retry_count - 1) * retry_control->initial_wait_time_in_secs);
+        result = (unsigned int)(pow(2, retry_count - 1) * retry_control->initial_wait_time_in_secs);
     }
     // Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_032: [If `retry_control->policy` is IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_JITTER, `calculate_next_wait_time` shall return ((pow(2, `retry_control->retry_count` - 1) * `retry_control->initial_wait_time_in_secs`) * (1 + (`retry_control->max_jitter_percent` / 100) * (rand() / RAND_MAX)))]
     else if (retry_control->policy == IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_JITTER)
     {
         double jitter_percent = (retry_control->max_jitter_percent / 100.0) * (rand() / ((double)RAND_MAX));
 
-        result = (unsigned int)(pow(2, retry_control->retry_count - 1) * retry_control->initial_wait_time_in_secs * (1 + jitter_percent));
+        result = (unsigned int)(pow(2, retry_count - 1) * retry_control->initial_wait_time_in_secs * (1 + jitter_percent));
     }
     // Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_033: [If `retry_control->policy` is IOTHUB_CLIENT_RETRY_RANDOM, `calculate_next_wait_time` shall return (`retry_control->initial_wait_time_in_secs` * (rand() / RAND_MAX))]
     else if (retry_control->policy == IOTHUB_CLIENT_RETRY_RANDOM)
@@ -186,6 +200,16 @@ static unsigned int calculate_next_wait_time(RETRY_CONTROL_INSTANCE* retry_contr
         double random_percent = ((double)rand() / (double)RAND_MAX);
         result = (unsigned int)(retry_control->initial_wait_time_in_secs * random_percent);
     }
+    // Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_001: [If `retry_control->policy` is IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_DECORRELATED_JITTER, `calculate_next_wait_time` shall return a random wait time between `retry_control->initial_wait_time_in_secs` and 3 times the previous wait time (`retry_control->initial_wait_time_in_secs` on the first retry)]
+    else if (retry_control->policy == IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_DECORRELATED_JITTER)
+    {
+        // Each device draws its next wait from its own previous one, so devices that failed together drift apart instead of retrying in waves
+        double previous_wait_time = (previous_wait_time_in_secs == 0) ? retry_control->initial_wait_time_in_secs : previous_wait_time_in_secs;
+        double upper_bound = 3.0 * previous_wait_time;
+        double random_percent = ((double)rand() / (double)RAND_MAX);
+
+        result = to_wait_time(retry_control->initial_wait_time_in_secs + (upper_bound - retry_control->initial_wait_time_in_secs) * random_percent);
+    }
     else
     {
         LogError("Failed to calculate the next wait time (policy %d is not expected)", retry_control->policy);
@@ -193,9 +217,20 @@ static unsigned int calculate_next_wait_time(RETRY_CONTROL_INSTANCE* retry_contr
         result = 0;
     }
 
+    // Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_002: [If `retry_control->max_wait_time_in_secs` is not 0, `calculate_next_wait_time` shall return at most `retry_control->max_wait_time_in_secs`]
+    if (retry_control->max_wait_time_in_secs != 0 && result > retry_control->max_wait_time_in_secs)
+    {
+        result = retry_control->max_wait_time_in_secs;
+    }
+
     return result;
 }
 
+static unsigned int calculate_next_wait_time(RETRY_CONTROL_INSTANCE* retry_control)
+{
+    return calculate_wait_time(retry_control, retry_control->retry_count, retry_control->current_wait_time_in_secs);
+}
+
 
 // ========== Public API ========== //
 
@@ -283,9 +318,10 @@ RETRY_CONTROL_HANDLE retry_control_create(IOTHUB_CLIENT_RETRY_POLICY policy, uns
         retry_control->policy = policy;
         retry_control->max_retry_time_in_secs = max_retry_time_in_secs;
 
-        // Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_005: [If `policy` is IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF or IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_JITTER, `retry_control->initial_wait_time_in_secs` shall be set to 1]
+        // Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_005: [If `policy` is IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF, IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_JITTER or IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_DECORRELATED_JITTER, `retry_control->initial_wait_time_in_secs` shall be set to 1]
         if (retry_control->policy == IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF ||
-            retry_control->policy == IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_JITTER)
+            retry_control->policy == IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_JITTER ||
+            retry_control->policy == IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_DECORRELATED_JITTER)
         {
             retry_control->initial_wait_time_in_secs = 1;
         }
@@ -379,6 +415,72 @@ int retry_control_should_retry(RETRY_CONTROL_HANDLE retry_control_handle, RETRY_
     return result;
 }
 
+int retry_control_set_retry_after(RETRY_CONTROL_HANDLE retry_control_handle, unsigned int retry_after_in_secs)
+{
+    int result;
+
+    // Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_003: [If `retry_control_handle` is NULL, `retry_control_set_retry_after` shall fail and return non-zero]
+    if (retry_control_handle == NULL)
+    {
+        LogError("Failed to set the retry-after hint (retry_control_handle is NULL)");
+        result = __FAILURE__;
+    }
+    else
+    {
+        RETRY_CONTROL_INSTANCE* retry_control = (RETRY_CONTROL_INSTANCE*)retry_control_handle;
+        double retry_after = retry_after_in_secs;
+
+        // Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_004: [If `retry_control->policy` is IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_JITTER or IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_DECORRELATED_JITTER, `retry_after_in_secs` shall be increased by up to `retry_control->max_jitter_percent` percent at random]
+        if (is_jittered_policy(retry_control->policy))
+        {
+            retry_after *= 1 + (retry_control->max_jitter_percent / 100.0) * (rand() / ((double)RAND_MAX));
+        }
+
+        // Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_005: [`retry_control->current_wait_time_in_secs` shall be raised to `retry_after_in_secs` if it is lower, ignoring `max_wait_time_in_secs`, so that the pending retry waits at least as long as the service asked]
+        if (retry_control->current_wait_time_in_secs < to_wait_time(retry_after))
+        {
+            retry_control->current_wait_time_in_secs = to_wait_time(retry_after);
+        }
+
+        // Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_006: [If no errors occur, `retry_control_set_retry_after` shall return 0]
+        result = RESULT_OK;
+    }
+
+    return result;
+}
+
+int retry_control_get_wait_time(RETRY_CONTROL_HANDLE retry_control_handle, unsigned int retry_count, unsigned int previous_wait_time_in_secs, unsigned int* wait_time_in_secs)
+{
+    int result;
+
+    // Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_009: [If `retry_control_handle` or `wait_time_in_secs` are NULL, or `retry_count` is 0, `retry_control_get_wait_time` shall fail and return non-zero]
+    if (retry_control_handle == NULL || wait_time_in_secs == NULL || retry_count == 0)
+    {
+        LogError("Failed to get the wait time (retry_control_handle=%p, wait_time_in_secs=%p, retry_count=%u)", retry_control_handle, wait_time_in_secs, retry_count);
+        result = __FAILURE__;
+    }
+    else
+    {
+        RETRY_CONTROL_INSTANCE* retry_control = (RETRY_CONTROL_INSTANCE*)retry_control_handle;
+
+        // Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_010: [If `retry_control->policy` is IOTHUB_CLIENT_RETRY_NONE or IOTHUB_CLIENT_RETRY_IMMEDIATE, `wait_time_in_secs` shall be set to 0]
+        if (retry_control->policy == IOTHUB_CLIENT_RETRY_NONE || retry_control->policy == IOTHUB_CLIENT_RETRY_IMMEDIATE)
+        {
+            *wait_time_in_secs = 0;
+        }
+        // Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_011: [Otherwise `wait_time_in_secs` shall be set as calculate_next_wait_time() would for the `retry_count`-th retry after a wait of `previous_wait_time_in_secs`, without changing the state of `retry_control`]
+        else
+        {
+            *wait_time_in_secs = calculate_wait_time(retry_control, retry_count, previous_wait_time_in_secs);
+        }
+
+        // Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_012: [If no errors occur, `retry_control_get_wait_time` shall return 0]
+        result = RESULT_OK;
+    }
+
+    return result;
+}
+
 int retry_control_set_option(RETRY_CONTROL_HANDLE retry_control_handle, const char* name, const void* value)
 {
     int result;
@@ -431,6 +533,14 @@ int retry_control_set_option(RETRY_CONTROL_HANDLE retry_control_handle, const ch
                 result = RESULT_OK;
             }
         }
+        else if (strcmp(RETRY_CONTROL_OPTION_MAX_WAIT_TIME_IN_SECS, name) == 0)
+        {
+            // Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_007: [If `name` is "max_wait_time_in_secs", value shall be saved on `retry_control->max_wait_time_in_secs`; 0 means no limit]
+            retry_control->max_wait_time_in_secs = *((unsigned int*)value);
+
+            // Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_044: [If no errors occur, retry_control_set_option shall return 0]
+            result = RESULT_OK;
+        }
         else if (strcmp(RETRY_CONTROL_OPTION_SAVED_OPTIONS, name) == 0)
         {
             // Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_041: [If `name` is "retry_control_options", value shall be fed to `retry_control` using OptionHandler_FeedOptions]
@@ -489,6 +599,13 @@ OPTIONHANDLER_HANDLE retry_control_retrieve_options(RETRY_CONTROL_HANDLE retry_c
                 LogError("Failed to retrieve options (OptionHandler_Create failed for option '%s')", RETRY_CONTROL_OPTION_INITIAL_WAIT_TIME_IN_SECS);
                 result = NULL;
             }
+            // Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_008: [`retry_control->max_wait_time_in_secs` shall be added to `options` using OptionHandler_Add]
+            else if (OptionHandler_AddOption(options, RETRY_CONTROL_OPTION_MAX_WAIT_TIME_IN_SECS, (void*)&retry_control->max_wait_time_in_secs) != OPTIONHANDLER_OK)
+            {
+                // Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_052: [If any call to OptionHandler_Add fails, `retry_control_retrieve_options` shall fail and return NULL]
+                LogError("Failed to retrieve options (OptionHandler_Create failed for option '%s')", RETRY_CONTROL_OPTION_MAX_WAIT_TIME_IN_SECS);
+                result = NULL;
+            }
             // Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_051: [`retry_control->max_jitter_percent` shall be added to `options` using OptionHandler_Add]
             else if (OptionHandler_AddOption(options, RETRY_CONTROL_OPTION_MAX_JITTER_PERCENT, (void*)&retry_control->max_jitter_percent) != OPTIONHANDLER_OK)
             {
@@ -0,0 +1,982 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/map.h"
+
+#include "internal/iothub_client_spill_queue.h"
+
+#define RESULT_OK 0
+
+#define SPILL_SEGMENT_FILE_FORMAT   "%s/iothub_spill_%08lu.log"
+#define SPILL_STATE_FILE_FORMAT     "%s/iothub_spill.state"
+#define SPILL_FILE_NAME_EXTRA_SIZE  32
+
+#define SPILL_RECORD_MAGIC          0x4C505349 /*"ISPL"*/
+#define SPILL_STATE_MAGIC           0x54535349 /*"ISST"*/
+#define SPILL_STATE_VERSION         1
+#define SPILL_RECORD_HEADER_SIZE    12 /*magic, body length, body checksum*/
+#define SPILL_STATE_SIZE            28 /*magic, version, session, released segment and offset, write segment, checksum*/
+#define SPILL_MAX_RECORD_SIZE       (4 * 1024 * 1024) /*well above the largest IoT Hub message, anything longer is a torn record*/
+#define SPILL_NULL_STRING           0xFFFFFFFF
+#define SPILL_RING_INITIAL_CAPACITY 8
+
+#define SPILL_PAYLOAD_BYTEARRAY     0
+#define SPILL_PAYLOAD_STRING        1
+
+typedef struct SPILL_POSITION_TAG
+{
+    uint32_t segment;
+    uint32_t offset;
+} SPILL_POSITION;
+
+typedef struct SPILL_CALLBACK_TAG
+{
+    IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK callback;
+    void* context;
+} SPILL_CALLBACK;
+
+// FIFO of fixed size items, grown by doubling
+typedef struct SPILL_RING_TAG
+{
+    unsigned char* items;
+    size_t item_size;
+    size_t head;
+    size_t count;
+    size_t capacity;
+} SPILL_RING;
+
+typedef struct SPILL_QUEUE_TAG
+{
+    char* directory;
+    size_t max_segment_size;
+    uint32_t session; /*incremented every time the directory is opened, tells events pushed by this spill queue apart*/
+
+    FILE* state_file;
+    FILE* write_file; /*NULL if the current segment could not be opened, retried on the next push*/
+    FILE* read_file;
+    uint32_t read_file_segment;
+
+    SPILL_POSITION write_position; /*end of the last event pushed*/
+    SPILL_POSITION read_position; /*start of the next event to read*/
+    SPILL_POSITION released_position; /*start of the oldest event not released, as saved in the state file*/
+
+    SPILL_RING read_ends; /*SPILL_POSITION after each event read but not released, oldest first*/
+    SPILL_RING callbacks; /*SPILL_CALLBACK of each event pushed by this spill queue and not read yet, oldest first*/
+} SPILL_QUEUE;
+
+typedef struct SPILL_DECODER_TAG
+{
+    const unsigned char* position;
+    size_t remaining;
+} SPILL_DECODER;
+
+static void ring_initialize(SPILL_RING* ring, size_t item_size)
+{
+    ring->items = NULL;
+    ring->item_size = item_size;
+    ring->head = 0;
+    ring->count = 0;
+    ring->capacity = 0;
+}
+
+static int ring_push(SPILL_RING* ring, const void* item)
+{
+    int result;
+
+    if (ring->count == ring->capacity)
+    {
+        size_t new_capacity = (ring->capacity == 0) ? SPILL_RING_INITIAL_CAPACITY : ring->capacity * 2;
+        unsigned char* new_items = (unsigned char*)malloc(new_capacity * ring->item_size);
+
+        if (new_items == NULL)
+        {
+            LogError("Failed growing the ring to %lu items", (unsigned long)new_capacity);
+            result = __FAILURE__;
+        }
+        else
+        {
+            size_t i;
+            for (i = 0; i < ring->count; i++)
+            {
+                (void)memcpy(new_items + i * ring->item_size, ring->items + ((ring->head + i) % ring->capacity) * ring->item_size, ring->item_size);
+            }
+
+            free(ring->items);
+            ring->items = new_items;
+            ring->head = 0;
+            ring->capacity = new_capacity;
+            result = RESULT_OK;
+        }
+    }
+    else
+    {
+        result = RESULT_OK;
+    }
+
+    if (result == RESULT_OK)
+    {
+        (void)memcpy(ring->items + ((ring->head + ring->count) % ring->capacity) * ring->item_size, item, ring->item_size);
+        ring->count++;
+    }
+
+    return result;
+}
+
+static bool ring_pop(SPILL_RING* ring, void* item)
+{
+    bool result;
+
+    if (ring->count == 0)
+    {
+        result = false;
+    }
+    else
+    {
+        (void)memcpy(item, ring->items + ring->head * ring->item_size, ring->item_size);
+        ring->head = (ring->head + 1) % ring->capacity;
+        ring->count--;
+        result = true;
+    }
+
+    return result;
+}
+
+static void put_uint32(unsigned char* buffer, uint32_t value)
+{
+    buffer[0] = (unsigned char)(value & 0xFF);
+    buffer[1] = (unsigned char)((value >> 8) & 0xFF);
+    buffer[2] = (unsigned char)((value >> 16) & 0xFF);
+    buffer[3] = (unsigned char)((value >> 24) & 0xFF);
+}
+
+static uint32_t get_uint32(const unsigned char* buffer)
+{
+    return (uint32_t)buffer[0] | ((uint32_t)buffer[1] << 8) | ((uint32_t)buffer[2] << 16) | ((uint32_t)buffer[3] << 24);
+}
+
+// FNV-1a, only used to detect records torn by a crash
+static uint32_t get_checksum(const unsigned char* buffer, size_t size)
+{
+    uint32_t result = 2166136261U;
+    size_t i;
+
+    for (i = 0; i < size; i++)
+    {
+        result = (result ^ buffer[i]) * 16777619U;
+    }
+
+    return result;
+}
+
+static bool is_same_position(const SPILL_POSITION* a, const SPILL_POSITION* b)
+{
+    return (a->segment == b->segment) && (a->offset == b->offset);
+}
+
+static char* create_file_name(const char* directory, const char* format, uint32_t segment)
+{
+    size_t size = strlen(directory) + SPILL_FILE_NAME_EXTRA_SIZE;
+    char* result = (char*)malloc(size);
+
+    if (result == NULL)
+    {
+        LogError("Failed allocating the file name");
+    }
+    else if (snprintf(result, size, format, directory, (unsigned long)segment) < 0)
+    {
+        LogError("Failed formatting the file name");
+        free(result);
+        result = NULL;
+    }
+
+    return result;
+}
+
+static FILE* open_file(const char* directory, const char* format, uint32_t segment, const char* mode)
+{
+    FILE* result;
+    char* file_name;
+
+    if ((file_name = create_file_name(directory, format, segment)) == NULL)
+    {
+        result = NULL;
+    }
+    else
+    {
+        result = fopen(file_name, mode);
+        free(file_name);
+    }
+
+    return result;
+}
+
+static void delete_segment(SPILL_QUEUE* spill_queue, uint32_t segment)
+{
+    char* file_name;
+
+    if ((file_name = create_file_name(spill_queue->directory, SPILL_SEGMENT_FILE_FORMAT, segment)) != NULL)
+    {
+        (void)remove(file_name);
+        free(file_name);
+    }
+}
+
+static int save_state(SPILL_QUEUE* spill_queue)
+{
+    int result;
+    unsigned char state[SPILL_STATE_SIZE];
+
+    put_uint32(state, SPILL_STATE_MAGIC);
+    put_uint32(state + 4, SPILL_STATE_VERSION);
+    put_uint32(state + 8, spill_queue->session);
+    put_uint32(state + 12, spill_queue->released_position.segment);
+    put_uint32(state + 16, spill_queue->released_position.offset);
+    put_uint32(state + 20, spill_queue->write_position.segment);
+    put_uint32(state + 24, get_checksum(state, SPILL_STATE_SIZE - 4));
+
+    if ((fseek(spill_queue->state_file, 0, SEEK_SET) != 0) ||
+        (fwrite(state, 1, SPILL_STATE_SIZE, spill_queue->state_file) != SPILL_STATE_SIZE) ||
+        (fflush(spill_queue->state_file) != 0))
+    {
+        LogError("Failed writing the spill queue state, errno=%d", errno);
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = RESULT_OK;
+    }
+
+    return result;
+}
+
+static int load_state(SPILL_QUEUE* spill_queue)
+{
+    int result;
+    unsigned char state[SPILL_STATE_SIZE];
+
+    if (fread(state, 1, SPILL_STATE_SIZE, spill_queue->state_file) != SPILL_STATE_SIZE)
+    {
+        // a state file shorter than a state was created but never written, so the directory is empty
+        spill_queue->session = 0;
+        spill_queue->released_position.segment = 0;
+        spill_queue->released_position.offset = 0;
+        spill_queue->write_position.segment = 0;
+        result = RESULT_OK;
+    }
+    else if ((get_uint32(state) != SPILL_STATE_MAGIC) ||
+        (get_uint32(state + 4) != SPILL_STATE_VERSION) ||
+        (get_uint32(state + 24) != get_checksum(state, SPILL_STATE_SIZE - 4)))
+    {
+        LogError("Invalid spill queue state file");
+        result = __FAILURE__;
+    }
+    else
+    {
+        // segments written before are never appended to again, the last one may end with a record torn by a crash
+        spill_queue->session = get_uint32(state + 8) + 1;
+        spill_queue->released_position.segment = get_uint32(state + 12);
+        spill_queue->released_position.offset = get_uint32(state + 16);
+        spill_queue->write_position.segment = get_uint32(state + 20) + 1;
+        result = RESULT_OK;
+    }
+
+    return result;
+}
+
+static void close_write_file(SPILL_QUEUE* spill_queue)
+{
+    if (spill_queue->write_file != NULL)
+    {
+        (void)fclose(spill_queue->write_file);
+        spill_queue->write_file = NULL;
+    }
+}
+
+static void close_read_file(SPILL_QUEUE* spill_queue)
+{
+    if (spill_queue->read_file != NULL)
+    {
+        (void)fclose(spill_queue->read_file);
+        spill_queue->read_file = NULL;
+    }
+}
+
+// Starts the segment write_position.segment, which must not contain any event yet
+static int open_write_segment(SPILL_QUEUE* spill_queue)
+{
+    int result;
+
+    if ((spill_queue->write_file = open_file(spill_queue->directory, SPILL_SEGMENT_FILE_FORMAT, spill_queue->write_position.segment, "wb")) == NULL)
+    {
+        LogError("Failed creating spill segment %lu, errno=%d", (unsigned long)spill_queue->write_position.segment, errno);
+        result = __FAILURE__;
+    }
+    else if (save_state(spill_queue) != 0)
+    {
+        close_write_file(spill_queue);
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = RESULT_OK;
+    }
+
+    return result;
+}
+
+// Moves writing to a new segment, so a full or torn segment is never appended to
+static void start_next_write_segment(SPILL_QUEUE* spill_queue)
+{
+    close_write_file(spill_queue);
+
+    // an empty segment can be reused as is, the reader has nothing to skip in it
+    if (spill_queue->write_position.offset > 0)
+    {
+        spill_queue->write_position.segment++;
+        spill_queue->write_position.offset = 0;
+    }
+
+    (void)open_write_segment(spill_queue);
+}
+
+static size_t get_string_encoded_size(const char* value)
+{
+    return 4 + ((value == NULL) ? 0 : strlen(value) + 1);
+}
+
+static unsigned char* encode_bytes(unsigned char* position, const unsigned char* bytes, size_t size)
+{
+    put_uint32(position, (uint32_t)size);
+    if (size > 0)
+    {
+        (void)memcpy(position + 4, bytes, size);
+    }
+    return position + 4 + size;
+}
+
+static unsigned char* encode_string(unsigned char* position, const char* value)
+{
+    unsigned char* result;
+
+    if (value == NULL)
+    {
+        put_uint32(position, SPILL_NULL_STRING);
+        result = position + 4;
+    }
+    else
+    {
+        // the terminator is kept so decoded strings can be used in place
+        result = encode_bytes(position, (const unsigned char*)value, strlen(value) + 1);
+    }
+
+    return result;
+}
+
+static bool decode_uint32(SPILL_DECODER* decoder, uint32_t* value)
+{
+    bool result;
+
+    if (decoder->remaining < 4)
+    {
+        result = false;
+    }
+    else
+    {
+        *value = get_uint32(decoder->position);
+        decoder->position += 4;
+        decoder->remaining -= 4;
+        result = true;
+    }
+
+    return result;
+}
+
+static bool decode_bytes(SPILL_DECODER* decoder, const unsigned char** bytes, size_t* size)
+{
+    bool result;
+    uint32_t length;
+
+    if (!decode_uint32(decoder, &length) || (length > decoder->remaining))
+    {
+        result = false;
+    }
+    else
+    {
+        *bytes = decoder->position;
+        *size = length;
+        decoder->position += length;
+        decoder->remaining -= length;
+        result = true;
+    }
+
+    return result;
+}
+
+static bool decode_string(SPILL_DECODER* decoder, const char** value)
+{
+    bool result;
+    const unsigned char* bytes;
+    size_t size;
+
+    if ((decoder->remaining >= 4) && (get_uint32(decoder->position) == SPILL_NULL_STRING))
+    {
+        decoder->position += 4;
+        decoder->remaining -= 4;
+        *value = NULL;
+        result = true;
+    }
+    else if (!decode_bytes(decoder, &bytes, &size) || (size == 0) || (bytes[size - 1] != '\0'))
+    {
+        result = false;
+    }
+    else
+    {
+        *value = (const char*)bytes;
+        result = true;
+    }
+
+    return result;
+}
+
+// Encodes message as a record: the header, then the session, the payload, the system properties, the output name
+// and the application properties
+static unsigned char* encode_message(SPILL_QUEUE* spill_queue, IOTHUB_MESSAGE_HANDLE message, size_t* record_size)
+{
+    unsigned char* result;
+    IOTHUBMESSAGE_CONTENT_TYPE content_type = IoTHubMessage_GetContentType(message);
+    const unsigned char* payload;
+    size_t payload_size;
+    const char*const* keys;
+    const char*const* values;
+    size_t property_count;
+
+    if (content_type == IOTHUBMESSAGE_BYTEARRAY)
+    {
+        if (IoTHubMessage_GetByteArray(message, &payload, &payload_size) != IOTHUB_MESSAGE_OK)
+        {
+            payload = NULL;
+            payload_size = 0;
+        }
+    }
+    else if ((payload = (const unsigned char*)IoTHubMessage_GetString(message)) != NULL)
+    {
+        payload_size = strlen((const char*)payload) + 1;
+    }
+    else
+    {
+        payload_size = 0;
+    }
+
+    if ((content_type != IOTHUBMESSAGE_BYTEARRAY) && (payload == NULL))
+    {
+        LogError("Message has no payload");
+        result = NULL;
+    }
+    else if (IoTHubMessage_GetProperties(message, &keys, &values, &property_count) != IOTHUB_MESSAGE_OK)
+    {
+        LogError("Failed getting the message properties");
+        result = NULL;
+    }
+    else
+    {
+        const char* message_id = IoTHubMessage_GetMessageId(message);
+        const char* correlation_id = IoTHubMessage_GetCorrelationId(message);
+        const char* content_type_property = IoTHubMessage_GetContentTypeSystemProperty(message);
+        const char* content_encoding = IoTHubMessage_GetContentEncodingSystemProperty(message);
+        const char* output_name = IoTHubMessage_GetOutputName(message);
+        size_t body_size = 4 + 1 + 4 + payload_size +
+            get_string_encoded_size(message_id) +
+            get_string_encoded_size(correlation_id) +
+            get_string_encoded_size(content_type_property) +
+            get_string_encoded_size(content_encoding) +
+            get_string_encoded_size(output_name) +
+            4;
+        size_t i;
+
+        for (i = 0; i < property_count; i++)
+        {
+            body_size += get_string_encoded_size(keys[i]) + get_string_encoded_size(values[i]);
+        }
+
+        if (body_size > SPILL_MAX_RECORD_SIZE)
+        {
+            LogError("Message of %lu bytes is too large to spill", (unsigned long)body_size);
+            result = NULL;
+        }
+        else if ((result = (unsigned char*)malloc(SPILL_RECORD_HEADER_SIZE + body_size)) == NULL)
+        {
+            LogError("Failed allocating a record of %lu bytes", (unsigned long)body_size);
+        }
+        else
+        {
+            unsigned char* body = result + SPILL_RECORD_HEADER_SIZE;
+            unsigned char* position = body;
+
+            put_uint32(position, spill_queue->session);
+            position[4] = (content_type == IOTHUBMESSAGE_BYTEARRAY) ? SPILL_PAYLOAD_BYTEARRAY : SPILL_PAYLOAD_STRING;
+            position = encode_bytes(position + 5, payload, payload_size);
+            position = encode_string(position, message_id);
+            position = encode_string(position, correlation_id);
+            position = encode_string(position, content_type_property);
+            position = encode_string(position, content_encoding);
+            position = encode_string(position, output_name);
+            put_uint32(position, (uint32_t)property_count);
+            position += 4;
+            for (i = 0; i < property_count; i++)
+            {
+                position = encode_string(position, keys[i]);
+                position = encode_string(position, values[i]);
+            }
+
+            put_uint32(result, SPILL_RECORD_MAGIC);
+            put_uint32(result + 4, (uint32_t)body_size);
+            put_uint32(result + 8, get_checksum(body, body_size));
+            *record_size = SPILL_RECORD_HEADER_SIZE + body_size;
+        }
+    }
+
+    return result;
+}
+
+static IOTHUB_MESSAGE_HANDLE decode_message(SPILL_DECODER* decoder)
+{
+    IOTHUB_MESSAGE_HANDLE result;
+    const unsigned char* payload;
+    size_t payload_size;
+    unsigned char payload_type;
+
+    if (decoder->remaining < 1)
+    {
+        result = NULL;
+    }
+    else
+    {
+        payload_type = decoder->position[0];
+        decoder->position++;
+        decoder->remaining--;
+
+        if (!decode_bytes(decoder, &payload, &payload_size))
+        {
+            LogError("Invalid spilled payload");
+            result = NULL;
+        }
+        else if (payload_type == SPILL_PAYLOAD_BYTEARRAY)
+        {
+            result = IoTHubMessage_CreateFromByteArray(payload, payload_size);
+        }
+        else if ((payload_size == 0) || (payload[payload_size - 1] != '\0'))
+        {
+            LogError("Invalid spilled string payload");
+            result = NULL;
+        }
+        else
+        {
+            result = IoTHubMessage_CreateFromString((const char*)payload);
+        }
+    }
+
+    if (result != NULL)
+    {
+        const char* message_id;
+        const char* correlation_id;
+        const char* content_type;
+        const char* content_encoding;
+        const char* output_name;
+        uint32_t property_count;
+        uint32_t i;
+        bool succeeded;
+
+        succeeded =
+            decode_string(decoder, &message_id) &&
+            decode_string(decoder, &correlation_id) &&
+            decode_string(decoder, &content_type) &&
+            decode_string(decoder, &content_encoding) &&
+            decode_string(decoder, &output_name) &&
+            decode_uint32(decoder, &property_count) &&
+            ((message_id == NULL) || (IoTHubMessage_SetMessageId(result, message_id) == IOTHUB_MESSAGE_OK)) &&
+            ((correlation_id == NULL) || (IoTHubMessage_SetCorrelationId(result, correlation_id) == IOTHUB_MESSAGE_OK)) &&
+            ((content_type == NULL) || (IoTHubMessage_SetContentTypeSystemProperty(result, content_type) == IOTHUB_MESSAGE_OK)) &&
+            ((content_encoding == NULL) || (IoTHubMessage_SetContentEncodingSystemProperty(result, content_encoding) == IOTHUB_MESSAGE_OK)) &&
+            ((output_name == NULL) || (IoTHubMessage_SetOutputName(result, output_name) == IOTHUB_MESSAGE_OK));
+
+        for (i = 0; succeeded && (i < property_count); i++)
+        {
+            const char* key;
+            const char* value;
+
+            succeeded =
+                decode_string(decoder, &key) && (key != NULL) &&
+                decode_string(decoder, &value) && (value != NULL) &&
+                (IoTHubMessage_SetProperty(result, key, value) == IOTHUB_MESSAGE_OK);
+        }
+
+        if (!succeeded)
+        {
+            LogError("Failed restoring the spilled message properties");
+            IoTHubMessage_Destroy(result);
+            result = NULL;
+        }
+    }
+
+    return result;
+}
+
+static bool is_at_end_of_read_file(SPILL_QUEUE* spill_queue)
+{
+    bool result;
+    int next = fgetc(spill_queue->read_file);
+
+    if (next == EOF)
+    {
+        result = true;
+    }
+    else
+    {
+        (void)ungetc(next, spill_queue->read_file);
+        result = false;
+    }
+
+    return result;
+}
+
+// Reads the body of the record at read_position into a new buffer. *body is NULL if there is no valid record there.
+static int read_record(SPILL_QUEUE* spill_queue, unsigned char** body, size_t* body_size)
+{
+    int result;
+    unsigned char header[SPILL_RECORD_HEADER_SIZE];
+
+    *body = NULL;
+
+    if ((spill_queue->read_file != NULL) && (spill_queue->read_file_segment != spill_queue->read_position.segment))
+    {
+        close_read_file(spill_queue);
+    }
+
+    if ((spill_queue->read_file == NULL) &&
+        ((spill_queue->read_file = open_file(spill_queue->directory, SPILL_SEGMENT_FILE_FORMAT, spill_queue->read_position.segment, "rb")) != NULL))
+    {
+        spill_queue->read_file_segment = spill_queue->read_position.segment;
+    }
+
+    if (spill_queue->read_file == NULL)
+    {
+        // a segment deleted or never created holds no record
+        result = RESULT_OK;
+    }
+    else if ((fseek(spill_queue->read_file, (long)spill_queue->read_position.offset, SEEK_SET) != 0) ||
+        (fread(header, 1, SPILL_RECORD_HEADER_SIZE, spill_queue->read_file) != SPILL_RECORD_HEADER_SIZE) ||
+        (get_uint32(header) != SPILL_RECORD_MAGIC) ||
+        (get_uint32(header + 4) > SPILL_MAX_RECORD_SIZE))
+    {
+        result = RESULT_OK;
+    }
+    else if ((*body = (unsigned char*)malloc(get_uint32(header + 4))) == NULL)
+    {
+        LogError("Failed allocating a record of %lu bytes", (unsigned long)get_uint32(header + 4));
+        result = __FAILURE__;
+    }
+    else
+    {
+        *body_size = get_uint32(header + 4);
+
+        if ((fread(*body, 1, *body_size, spill_queue->read_file) != *body_size) ||
+            (get_checksum(*body, *body_size) != get_uint32(header + 8)))
+        {
+            free(*body);
+            *body = NULL;
+        }
+
+        result = RESULT_OK;
+    }
+
+    return result;
+}
+
+SPILL_QUEUE_HANDLE spill_queue_create(const char* directory, size_t max_segment_size)
+{
+    SPILL_QUEUE* result;
+
+    // Codes_SRS_SPILL_QUEUE_41_001: [If `directory` is NULL or `max_segment_size` is zero, spill_queue_create shall fail and return NULL]
+    if ((directory == NULL) || (max_segment_size == 0))
+    {
+        LogError("Invalid argument (directory=%p, max_segment_size=%lu)", directory, (unsigned long)max_segment_size);
+        result = NULL;
+    }
+    // Codes_SRS_SPILL_QUEUE_41_002: [If any failure occurs, spill_queue_create shall release all memory it allocated, close any file it opened and return NULL]
+    else if ((result = (SPILL_QUEUE*)malloc(sizeof(SPILL_QUEUE))) == NULL)
+    {
+        LogError("Failed allocating the spill queue");
+    }
+    else
+    {
+        size_t directory_length = strlen(directory);
+
+        memset(result, 0, sizeof(SPILL_QUEUE));
+        result->max_segment_size = max_segment_size;
+        ring_initialize(&result->read_ends, sizeof(SPILL_POSITION));
+        ring_initialize(&result->callbacks, sizeof(SPILL_CALLBACK));
+
+        if ((result->directory = (char*)malloc(directory_length + 1)) == NULL)
+        {
+            LogError("Failed copying the spill directory");
+            spill_queue_destroy(result);
+            result = NULL;
+        }
+        else
+        {
+            (void)memcpy(result->directory, directory, directory_length + 1);
+
+            // Codes_SRS_SPILL_QUEUE_41_003: [spill_queue_create shall open the state file of `directory`, creating it if it does not exist]
+            if (((result->state_file = open_file(directory, SPILL_STATE_FILE_FORMAT, 0, "r+b")) == NULL) &&
+                ((result->state_file = open_file(directory, SPILL_STATE_FILE_FORMAT, 0, "w+b")) == NULL))
+            {
+                LogError("Failed opening the spill queue state in %s, errno=%d", directory, errno);
+                spill_queue_destroy(result);
+                result = NULL;
+            }
+            // Codes_SRS_SPILL_QUEUE_41_004: [Events not released by a previous spill queue on `directory` shall be read first, starting at the position saved in the state file]
+            else if (load_state(result) != 0)
+            {
+                spill_queue_destroy(result);
+                result = NULL;
+            }
+            else
+            {
+                result->read_position = result->released_position;
+                result->write_position.offset = 0;
+
+                // Codes_SRS_SPILL_QUEUE_41_005: [spill_queue_create shall start a new segment, so segments written before are never appended to]
+                if (open_write_segment(result) != 0)
+                {
+                    spill_queue_destroy(result);
+                    result = NULL;
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+void spill_queue_destroy(SPILL_QUEUE_HANDLE spill_queue)
+{
+    // Codes_SRS_SPILL_QUEUE_41_006: [If `spill_queue` is NULL, spill_queue_destroy shall return]
+    if (spill_queue != NULL)
+    {
+        // Codes_SRS_SPILL_QUEUE_41_007: [spill_queue_destroy shall close all files and release all memory of `spill_queue`; events not released shall stay on disk]
+        close_read_file(spill_queue);
+        close_write_file(spill_queue);
+
+        if (spill_queue->state_file != NULL)
+        {
+            (void)fclose(spill_queue->state_file);
+        }
+
+        free(spill_queue->read_ends.items);
+        free(spill_queue->callbacks.items);
+        free(spill_queue->directory);
+        free(spill_queue);
+    }
+}
+
+int spill_queue_push_message(SPILL_QUEUE_HANDLE spill_queue, IOTHUB_MESSAGE_HANDLE message, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK callback, void* context)
+{
+    int result;
+
+    // Codes_SRS_SPILL_QUEUE_41_008: [If `spill_queue` or `message` is NULL, spill_queue_push_message shall fail and return non-zero]
+    if ((spill_queue == NULL) || (message == NULL))
+    {
+        LogError("Invalid argument (spill_queue=%p, message=%p)", spill_queue, message);
+        result = __FAILURE__;
+    }
+    else if ((spill_queue->write_file == NULL) && (open_write_segment(spill_queue) != 0))
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        unsigned char* record;
+        size_t record_size;
+        SPILL_CALLBACK spill_callback;
+
+        spill_callback.callback = callback;
+        spill_callback.context = context;
+
+        // Codes_SRS_SPILL_QUEUE_41_009: [spill_queue_push_message shall encode the payload, message id, correlation id, content type, content encoding, output name and application properties of `message` as one record]
+        if ((record = encode_message(spill_queue, message, &record_size)) == NULL)
+        {
+            result = __FAILURE__;
+        }
+        // Codes_SRS_SPILL_QUEUE_41_010: [`callback` and `context` shall be kept in memory, in order, until the record is read]
+        else if (ring_push(&spill_queue->callbacks, &spill_callback) != 0)
+        {
+            result = __FAILURE__;
+        }
+        // Codes_SRS_SPILL_QUEUE_41_011: [spill_queue_push_message shall append the record to the current segment and flush it]
+        else if ((fwrite(record, 1, record_size, spill_queue->write_file) != record_size) ||
+            (fflush(spill_queue->write_file) != 0))
+        {
+            // Codes_SRS_SPILL_QUEUE_41_012: [If the record cannot be written, spill_queue_push_message shall start a new segment, so a partly written record is only ever at the end of a segment, and return non-zero]
+            LogError("Failed writing a record of %lu bytes to spill segment %lu, errno=%d", (unsigned long)record_size, (unsigned long)spill_queue->write_position.segment, errno);
+            spill_queue->callbacks.count--;
+            start_next_write_segment(spill_queue);
+            result = __FAILURE__;
+        }
+        else
+        {
+            spill_queue->write_position.offset += (uint32_t)record_size;
+
+            // Codes_SRS_SPILL_QUEUE_41_013: [Once the current segment holds `max_segment_size` bytes or more, a new segment shall be started]
+            if (spill_queue->write_position.offset >= spill_queue->max_segment_size)
+            {
+                start_next_write_segment(spill_queue);
+            }
+
+            // Codes_SRS_SPILL_QUEUE_41_014: [On success spill_queue_push_message shall return 0]
+            result = RESULT_OK;
+        }
+
+        free(record);
+    }
+
+    return result;
+}
+
+int spill_queue_read_message(SPILL_QUEUE_HANDLE spill_queue, IOTHUB_MESSAGE_HANDLE* message, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK* callback, void** context)
+{
+    int result;
+
+    // Codes_SRS_SPILL_QUEUE_41_015: [If `spill_queue`, `message`, `callback` or `context` is NULL, spill_queue_read_message shall fail and return non-zero]
+    if ((spill_queue == NULL) || (message == NULL) || (callback == NULL) || (context == NULL))
+    {
+        LogError("Invalid argument (spill_queue=%p, message=%p, callback=%p, context=%p)", spill_queue, message, callback, context);
+        result = __FAILURE__;
+    }
+    else
+    {
+        *message = NULL;
+        *callback = NULL;
+        *context = NULL;
+        result = RESULT_OK;
+
+        // Codes_SRS_SPILL_QUEUE_41_016: [If no event is left to read, spill_queue_read_message shall set `message` to NULL and return 0]
+        while ((result == RESULT_OK) && (*message == NULL) && !is_same_position(&spill_queue->read_position, &spill_queue->write_position))
+        {
+            unsigned char* body;
+            size_t body_size;
+
+            if (read_record(spill_queue, &body, &body_size) != 0)
+            {
+                result = __FAILURE__;
+            }
+            else if (body == NULL)
+            {
+                // Codes_SRS_SPILL_QUEUE_41_017: [A missing, torn or corrupted record shall end its segment, and reading shall continue with the next segment]
+                if (spill_queue->read_position.segment < spill_queue->write_position.segment)
+                {
+                    spill_queue->read_position.segment++;
+                    spill_queue->read_position.offset = 0;
+                }
+                else
+                {
+                    LogError("Spill segment %lu is shorter than written", (unsigned long)spill_queue->read_position.segment);
+                    spill_queue->read_position = spill_queue->write_position;
+                }
+            }
+            else
+            {
+                SPILL_DECODER decoder;
+                SPILL_POSITION end;
+                SPILL_CALLBACK spill_callback;
+                uint32_t session;
+
+                decoder.position = body;
+                decoder.remaining = body_size;
+                end.segment = spill_queue->read_position.segment;
+                end.offset = spill_queue->read_position.offset + SPILL_RECORD_HEADER_SIZE + (uint32_t)body_size;
+
+                // Codes_SRS_SPILL_QUEUE_41_018: [spill_queue_read_message shall create a new message from the oldest record not read, in the order records were pushed]
+                if (!decode_uint32(&decoder, &session) || ((*message = decode_message(&decoder)) == NULL))
+                {
+                    LogError("Failed restoring a spilled message");
+                    result = __FAILURE__;
+                }
+                // Codes_SRS_SPILL_QUEUE_41_019: [The record shall be kept on disk until it is released]
+                else if (ring_push(&spill_queue->read_ends, &end) != 0)
+                {
+                    IoTHubMessage_Destroy(*message);
+                    *message = NULL;
+                    result = __FAILURE__;
+                }
+                else
+                {
+                    // Codes_SRS_SPILL_QUEUE_41_020: [`callback` and `context` shall be the ones given when the record was pushed if it was pushed by `spill_queue`, and NULL otherwise]
+                    if ((session == spill_queue->session) && ring_pop(&spill_queue->callbacks, &spill_callback))
+                    {
+                        *callback = spill_callback.callback;
+                        *context = spill_callback.context;
+                    }
+
+                    spill_queue->read_position = end;
+
+                    // move on past the end of a finished segment now, so spill_queue_is_empty sees the last event was read
+                    if ((spill_queue->read_position.segment < spill_queue->write_position.segment) && is_at_end_of_read_file(spill_queue))
+                    {
+                        spill_queue->read_position.segment++;
+                        spill_queue->read_position.offset = 0;
+                    }
+                }
+
+                free(body);
+            }
+        }
+    }
+
+    return result;
+}
+
+int spill_queue_release(SPILL_QUEUE_HANDLE spill_queue)
+{
+    int result;
+    SPILL_POSITION end;
+
+    // Codes_SRS_SPILL_QUEUE_41_021: [If `spill_queue` is NULL or no event read is waiting to be released, spill_queue_release shall fail and return non-zero]
+    if ((spill_queue == NULL) || !ring_pop(&spill_queue->read_ends, &end))
+    {
+        LogError("Invalid argument or nothing to release (spill_queue=%p)", spill_queue);
+        result = __FAILURE__;
+    }
+    else
+    {
+        uint32_t first_segment = spill_queue->released_position.segment;
+
+        // Codes_SRS_SPILL_QUEUE_41_022: [spill_queue_release shall save the end of the oldest event read and not released as the position to start reading from]
+        spill_queue->released_position = end;
+        result = save_state(spill_queue);
+
+        // Codes_SRS_SPILL_QUEUE_41_023: [Segments holding only released events shall be deleted]
+        if (result == RESULT_OK)
+        {
+            while (first_segment < end.segment)
+            {
+                delete_segment(spill_queue, first_segment++);
+            }
+        }
+    }
+
+    return result;
+}
+
+bool spill_queue_is_empty(SPILL_QUEUE_HANDLE spill_queue)
+{
+    // Codes_SRS_SPILL_QUEUE_41_024: [spill_queue_is_empty shall return true if `spill_queue` is NULL or every event pushed was read, and false otherwise]
+    return (spill_queue == NULL) || is_same_position(&spill_queue->read_position, &spill_queue->write_position);
+}
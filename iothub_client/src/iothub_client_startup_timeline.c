@@ -0,0 +1,206 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/tickcounter.h"
+
+#include "iothub_client_startup_timeline.h"
+#include "internal/iothub_client_startup_timeline_private.h"
+
+#define RESULT_OK 0
+#define MILESTONE_NAME_PREFIX "IOTHUB_CLIENT_STARTUP_"
+
+DEFINE_ENUM_STRINGS(IOTHUB_CLIENT_STARTUP_MILESTONE, IOTHUB_CLIENT_STARTUP_MILESTONE_VALUES);
+
+bool g_iothub_client_startup_timeline_started = false;
+
+static LOCK_HANDLE g_startup_timeline_lock = NULL;
+static TICK_COUNTER_HANDLE g_startup_timeline_tick_counter = NULL;
+static IOTHUB_CLIENT_STARTUP_TIMELINE g_startup_timeline;
+
+static void destroy_startup_timeline(void)
+{
+    if (g_startup_timeline_tick_counter != NULL)
+    {
+        tickcounter_destroy(g_startup_timeline_tick_counter);
+        g_startup_timeline_tick_counter = NULL;
+    }
+    if (g_startup_timeline_lock != NULL)
+    {
+        (void)Lock_Deinit(g_startup_timeline_lock);
+        g_startup_timeline_lock = NULL;
+    }
+}
+
+/*writes the JSON of timeline into buffer, or only measures it when buffer is NULL; returns its length without the terminator*/
+static int format_startup_timeline(const IOTHUB_CLIENT_STARTUP_TIMELINE* timeline, char* buffer, size_t buffer_size)
+{
+    int length = 0;
+    bool first = true;
+    size_t index;
+
+    for (index = 0; (index < IOTHUB_CLIENT_STARTUP_MILESTONE_COUNT) && (length >= 0); index++)
+    {
+        if (timeline->marks[index].reached)
+        {
+            const char* name = ENUM_TO_STRING(IOTHUB_CLIENT_STARTUP_MILESTONE, (IOTHUB_CLIENT_STARTUP_MILESTONE)index) + (sizeof(MILESTONE_NAME_PREFIX) - 1);
+            int written = snprintf((buffer == NULL) ? NULL : buffer + length, (buffer == NULL) ? 0 : buffer_size - (size_t)length,
+                "%s\"%s\":%lu", first ? "{" : ",", name, (unsigned long)timeline->marks[index].ms);
+            length = (written < 0) ? -1 : length + written;
+            first = false;
+        }
+    }
+
+    if (length >= 0)
+    {
+        int written = snprintf((buffer == NULL) ? NULL : buffer + length, (buffer == NULL) ? 0 : buffer_size - (size_t)length, "%s", first ? "{}" : "}");
+        length = (written < 0) ? -1 : length + written;
+    }
+
+    return length;
+}
+
+int IoTHubClient_StartupTimeline_Start(void)
+{
+    int result;
+
+    /*Codes_SRS_IOTHUB_CLIENT_STARTUP_TIMELINE_41_001: [ If the timeline is already started, IoTHubClient_StartupTimeline_Start shall fail and return a non-zero value. ]*/
+    if (g_startup_timeline_lock != NULL)
+    {
+        LogError("The startup timeline is already started");
+        result = __FAILURE__;
+    }
+    /*Codes_SRS_IOTHUB_CLIENT_STARTUP_TIMELINE_41_002: [ IoTHubClient_StartupTimeline_Start shall create a lock and a tick counter; if either fails it shall free the other and return a non-zero value. ]*/
+    else if ((g_startup_timeline_lock = Lock_Init()) == NULL)
+    {
+        LogError("Cannot create the lock of the startup timeline");
+        result = __FAILURE__;
+    }
+    else if ((g_startup_timeline_tick_counter = tickcounter_create()) == NULL)
+    {
+        LogError("Cannot create the tick counter of the startup timeline");
+        destroy_startup_timeline();
+        result = __FAILURE__;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_STARTUP_TIMELINE_41_003: [ On success IoTHubClient_StartupTimeline_Start shall clear every milestone, start noting them and return 0. ]*/
+        (void)memset(&g_startup_timeline, 0, sizeof(g_startup_timeline));
+        g_iothub_client_startup_timeline_started = true;
+        result = RESULT_OK;
+    }
+
+    return result;
+}
+
+void IoTHubClient_StartupTimeline_Stop(void)
+{
+    /*Codes_SRS_IOTHUB_CLIENT_STARTUP_TIMELINE_41_004: [ IoTHubClient_StartupTimeline_Stop shall stop noting the milestones and free the lock and the tick counter; it shall do nothing if the timeline is not started. ]*/
+    g_iothub_client_startup_timeline_started = false;
+    destroy_startup_timeline();
+}
+
+void IoTHubClient_StartupTimeline_Mark(IOTHUB_CLIENT_STARTUP_MILESTONE milestone)
+{
+    tickcounter_ms_t now;
+
+    /*Codes_SRS_IOTHUB_CLIENT_STARTUP_TIMELINE_41_005: [ If the timeline is not started or milestone is not a milestone, IoTHubClient_StartupTimeline_Mark shall do nothing. ]*/
+    if ((g_startup_timeline_lock == NULL) || ((size_t)milestone >= IOTHUB_CLIENT_STARTUP_MILESTONE_COUNT))
+    {
+        /*the timeline is not started*/
+    }
+    /*Codes_SRS_IOTHUB_CLIENT_STARTUP_TIMELINE_41_006: [ If milestone was already reached, IoTHubClient_StartupTimeline_Mark shall do nothing. ]*/
+    else if (g_startup_timeline.marks[milestone].reached)
+    {
+        /*only the first time counts; checked again under the lock*/
+    }
+    else if (tickcounter_get_current_ms(g_startup_timeline_tick_counter, &now) != 0)
+    {
+        LogError("Cannot get the time of milestone %s", ENUM_TO_STRING(IOTHUB_CLIENT_STARTUP_MILESTONE, milestone));
+    }
+    else if (Lock(g_startup_timeline_lock) != LOCK_OK)
+    {
+        LogError("Cannot lock the startup timeline");
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_STARTUP_TIMELINE_41_007: [ IoTHubClient_StartupTimeline_Mark shall note milestone as reached at the milliseconds since IoTHubClient_StartupTimeline_Start. ]*/
+        IOTHUB_CLIENT_STARTUP_MARK* mark = &g_startup_timeline.marks[milestone];
+        if (!mark->reached)
+        {
+            mark->reached = true;
+            mark->ms = (uint32_t)now;
+        }
+
+        (void)Unlock(g_startup_timeline_lock);
+    }
+}
+
+int IoTHubClient_StartupTimeline_Get(IOTHUB_CLIENT_STARTUP_TIMELINE* timeline)
+{
+    int result;
+
+    /*Codes_SRS_IOTHUB_CLIENT_STARTUP_TIMELINE_41_008: [ If timeline is NULL or the timeline is not started, IoTHubClient_StartupTimeline_Get shall fail and return a non-zero value. ]*/
+    if (timeline == NULL)
+    {
+        LogError("Invalid argument timeline NULL");
+        result = __FAILURE__;
+    }
+    else if (g_startup_timeline_lock == NULL)
+    {
+        LogError("The startup timeline is not started");
+        result = __FAILURE__;
+    }
+    else if (Lock(g_startup_timeline_lock) != LOCK_OK)
+    {
+        LogError("Cannot lock the startup timeline");
+        result = __FAILURE__;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_STARTUP_TIMELINE_41_009: [ IoTHubClient_StartupTimeline_Get shall copy every milestone to timeline and return 0. ]*/
+        *timeline = g_startup_timeline;
+        (void)Unlock(g_startup_timeline_lock);
+        result = RESULT_OK;
+    }
+
+    return result;
+}
+
+char* IoTHubClient_StartupTimeline_ToJson(void)
+{
+    char* result;
+    IOTHUB_CLIENT_STARTUP_TIMELINE timeline;
+    int length;
+
+    /*Codes_SRS_IOTHUB_CLIENT_STARTUP_TIMELINE_41_010: [ If the timeline cannot be got, IoTHubClient_StartupTimeline_ToJson shall return NULL. ]*/
+    if (IoTHubClient_StartupTimeline_Get(&timeline) != 0)
+    {
+        result = NULL;
+    }
+    else if ((length = format_startup_timeline(&timeline, NULL, 0)) < 0)
+    {
+        LogError("Cannot format the startup timeline");
+        result = NULL;
+    }
+    /*Codes_SRS_IOTHUB_CLIENT_STARTUP_TIMELINE_41_011: [ If allocating the JSON fails, IoTHubClient_StartupTimeline_ToJson shall return NULL. ]*/
+    else if ((result = (char*)malloc((size_t)length + 1)) == NULL)
+    {
+        LogError("Cannot allocate %d bytes for the startup timeline", length + 1);
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_STARTUP_TIMELINE_41_012: [ IoTHubClient_StartupTimeline_ToJson shall return a JSON object with, in milestone order, the name of every milestone reached without its IOTHUB_CLIENT_STARTUP_ prefix and its milliseconds. ]*/
+        (void)format_startup_timeline(&timeline, result, (size_t)length + 1);
+    }
+
+    return result;
+}
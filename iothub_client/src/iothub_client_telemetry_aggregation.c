@@ -0,0 +1,378 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+#include "internal/iothub_client_telemetry_aggregation.h"
+
+#define RESULT_OK 0
+
+#define AGGREGATE_EVENT_FORMAT          "{\"count\":%lu,\"min\":%.17g,\"max\":%.17g,\"mean\":%.17g,\"windowMs\":%lu,\"droppedWindows\":%lu}"
+#define ANOMALY_EVENT_FORMAT            "{\"value\":%.17g,\"anomaly\":true}"
+#define AGGREGATE_EVENT_CONTENT_TYPE    "application%2Fjson"
+#define AGGREGATE_EVENT_CONTENT_ENCODING "utf-8"
+
+typedef struct TELEMETRY_WINDOW_TAG
+{
+    tickcounter_ms_t start; /*time of the first sample*/
+    size_t count;
+    double min;
+    double max;
+    double sum;
+} TELEMETRY_WINDOW;
+
+typedef struct TELEMETRY_STAGE_TAG
+{
+    struct TELEMETRY_STAGE_TAG* next;
+    char* output_name; /*NULL for the samples sent without an output name*/
+    tickcounter_ms_t window_ms;
+    bool forward_anomalies;
+    double anomaly_low;
+    double anomaly_high;
+    TELEMETRY_WINDOW current; /*open while its count is not 0*/
+    TELEMETRY_WINDOW* closed; /*ring of the closed windows not sent yet, oldest first*/
+    size_t closed_head;
+    size_t closed_count;
+    size_t closed_capacity;
+    size_t dropped; /*windows dropped from the full ring since the last event sent*/
+} TELEMETRY_STAGE;
+
+typedef struct TELEMETRY_AGGREGATION_TAG
+{
+    TELEMETRY_STAGE* stages;
+} TELEMETRY_AGGREGATION;
+
+static bool is_same_output_name(const char* left, const char* right)
+{
+    return (left == NULL || right == NULL) ? (left == right) : (strcmp(left, right) == 0);
+}
+
+static TELEMETRY_STAGE** find_stage(TELEMETRY_AGGREGATION* aggregation, const char* output_name)
+{
+    TELEMETRY_STAGE** result = &aggregation->stages;
+
+    while ((*result != NULL) && !is_same_output_name((*result)->output_name, output_name))
+    {
+        result = &(*result)->next;
+    }
+
+    return result;
+}
+
+static void destroy_stage(TELEMETRY_STAGE* stage)
+{
+    free(stage->output_name);
+    free(stage->closed);
+    free(stage);
+}
+
+static TELEMETRY_STAGE* create_stage(const IOTHUB_CLIENT_TELEMETRY_AGGREGATION* configuration)
+{
+    TELEMETRY_STAGE* result;
+    size_t capacity = (configuration->max_pending_windows == 0) ? 1 : configuration->max_pending_windows;
+
+    if ((result = (TELEMETRY_STAGE*)malloc(sizeof(TELEMETRY_STAGE))) == NULL)
+    {
+        LogError("Failed allocating the telemetry stage");
+    }
+    else
+    {
+        (void)memset(result, 0, sizeof(TELEMETRY_STAGE));
+
+        if ((configuration->output_name != NULL) && ((result->output_name = (char*)malloc(strlen(configuration->output_name) + 1)) == NULL))
+        {
+            LogError("Failed allocating the output name of the telemetry stage");
+            destroy_stage(result);
+            result = NULL;
+        }
+        else if ((capacity > SIZE_MAX / sizeof(TELEMETRY_WINDOW)) || ((result->closed = (TELEMETRY_WINDOW*)malloc(capacity * sizeof(TELEMETRY_WINDOW))) == NULL))
+        {
+            LogError("Failed allocating %lu closed windows", (unsigned long)capacity);
+            destroy_stage(result);
+            result = NULL;
+        }
+        else
+        {
+            if (result->output_name != NULL)
+            {
+                (void)strcpy(result->output_name, configuration->output_name);
+            }
+            result->window_ms = configuration->window_ms;
+            result->forward_anomalies = configuration->forward_anomalies;
+            result->anomaly_low = configuration->anomaly_low;
+            result->anomaly_high = configuration->anomaly_high;
+            result->closed_capacity = capacity;
+        }
+    }
+
+    return result;
+}
+
+static void close_window(TELEMETRY_STAGE* stage)
+{
+    /*Codes_SRS_TELEMETRY_AGGREGATION_41_008: [ If the ring of closed windows is full, the oldest closed window shall be dropped and counted in the next event sent. ]*/
+    if (stage->closed_count == stage->closed_capacity)
+    {
+        stage->closed_head = (stage->closed_head + 1) % stage->closed_capacity;
+        stage->closed_count--;
+        stage->dropped++;
+    }
+
+    stage->closed[(stage->closed_head + stage->closed_count) % stage->closed_capacity] = stage->current;
+    stage->closed_count++;
+    stage->current.count = 0;
+}
+
+static IOTHUB_MESSAGE_HANDLE create_json_event(const TELEMETRY_STAGE* stage, const char* json, int length)
+{
+    IOTHUB_MESSAGE_HANDLE result;
+
+    if ((result = IoTHubMessage_CreateFromByteArray((const unsigned char*)json, (size_t)length)) == NULL)
+    {
+        LogError("Failed creating the aggregated event");
+    }
+    else if ((IoTHubMessage_SetContentTypeSystemProperty(result, AGGREGATE_EVENT_CONTENT_TYPE) != IOTHUB_MESSAGE_OK) ||
+        (IoTHubMessage_SetContentEncodingSystemProperty(result, AGGREGATE_EVENT_CONTENT_ENCODING) != IOTHUB_MESSAGE_OK) ||
+        ((stage->output_name != NULL) && (IoTHubMessage_SetOutputName(result, stage->output_name) != IOTHUB_MESSAGE_OK)))
+    {
+        LogError("Failed setting the properties of the aggregated event");
+        IoTHubMessage_Destroy(result);
+        result = NULL;
+    }
+
+    return result;
+}
+
+static IOTHUB_MESSAGE_HANDLE create_window_event(const TELEMETRY_STAGE* stage, const TELEMETRY_WINDOW* window)
+{
+    IOTHUB_MESSAGE_HANDLE result;
+    char json[256];
+    /*Codes_SRS_TELEMETRY_AGGREGATION_41_010: [ The event of a window shall be a JSON object holding its count, min, max and mean, the window length and the windows dropped since the last event, with content type application/json and the output name of its stage. ]*/
+    int length = snprintf(json, sizeof(json), AGGREGATE_EVENT_FORMAT, (unsigned long)window->count, window->min, window->max, window->sum / (double)window->count,
+        (unsigned long)stage->window_ms, (unsigned long)stage->dropped);
+
+    if ((length < 0) || ((size_t)length >= sizeof(json)))
+    {
+        LogError("Failed formatting the aggregated event");
+        result = NULL;
+    }
+    else
+    {
+        result = create_json_event(stage, json, length);
+    }
+
+    return result;
+}
+
+static IOTHUB_MESSAGE_HANDLE create_anomaly_event(const TELEMETRY_STAGE* stage, double value)
+{
+    IOTHUB_MESSAGE_HANDLE result;
+    char json[64];
+    int length = snprintf(json, sizeof(json), ANOMALY_EVENT_FORMAT, value);
+
+    if ((length < 0) || ((size_t)length >= sizeof(json)))
+    {
+        LogError("Failed formatting the anomaly event");
+        result = NULL;
+    }
+    else
+    {
+        result = create_json_event(stage, json, length);
+    }
+
+    return result;
+}
+
+TELEMETRY_AGGREGATION_HANDLE telemetry_aggregation_create(void)
+{
+    TELEMETRY_AGGREGATION* result;
+
+    /*Codes_SRS_TELEMETRY_AGGREGATION_41_001: [ telemetry_aggregation_create shall return a new aggregation without any stage, or NULL if it cannot be allocated. ]*/
+    if ((result = (TELEMETRY_AGGREGATION*)malloc(sizeof(TELEMETRY_AGGREGATION))) == NULL)
+    {
+        LogError("Failed allocating the telemetry aggregation");
+    }
+    else
+    {
+        result->stages = NULL;
+    }
+
+    return result;
+}
+
+void telemetry_aggregation_destroy(TELEMETRY_AGGREGATION_HANDLE aggregation)
+{
+    /*Codes_SRS_TELEMETRY_AGGREGATION_41_002: [ telemetry_aggregation_destroy shall free all the stages, dropping the windows not sent yet; it shall do nothing if aggregation is NULL. ]*/
+    if (aggregation != NULL)
+    {
+        while (aggregation->stages != NULL)
+        {
+            TELEMETRY_STAGE* stage = aggregation->stages;
+            aggregation->stages = stage->next;
+            destroy_stage(stage);
+        }
+        free(aggregation);
+    }
+}
+
+int telemetry_aggregation_configure(TELEMETRY_AGGREGATION_HANDLE aggregation, const IOTHUB_CLIENT_TELEMETRY_AGGREGATION* configuration)
+{
+    int result;
+
+    /*Codes_SRS_TELEMETRY_AGGREGATION_41_003: [ If aggregation or configuration is NULL, telemetry_aggregation_configure shall fail and return a non-zero value. ]*/
+    if ((aggregation == NULL) || (configuration == NULL))
+    {
+        LogError("Invalid argument (aggregation=%p, configuration=%p)", aggregation, configuration);
+        result = __FAILURE__;
+    }
+    else
+    {
+        TELEMETRY_STAGE** position = find_stage(aggregation, configuration->output_name);
+        TELEMETRY_STAGE* stage;
+
+        if (configuration->window_ms == 0)
+        {
+            /*Codes_SRS_TELEMETRY_AGGREGATION_41_004: [ If window_ms is 0, telemetry_aggregation_configure shall remove the stage of output_name, if any, dropping its windows not sent yet, and succeed. ]*/
+            if ((stage = *position) != NULL)
+            {
+                *position = stage->next;
+                destroy_stage(stage);
+            }
+            result = RESULT_OK;
+        }
+        /*Codes_SRS_TELEMETRY_AGGREGATION_41_005: [ Otherwise telemetry_aggregation_configure shall create a stage for output_name with a ring of max_pending_windows closed windows (1 if it is 0), replacing any stage of output_name, and fail leaving the previous stage in place if it cannot be allocated. ]*/
+        else if ((stage = create_stage(configuration)) == NULL)
+        {
+            result = __FAILURE__;
+        }
+        else
+        {
+            if (*position != NULL)
+            {
+                stage->next = (*position)->next;
+                destroy_stage(*position);
+            }
+            *position = stage;
+            result = RESULT_OK;
+        }
+    }
+
+    return result;
+}
+
+int telemetry_aggregation_add_sample(TELEMETRY_AGGREGATION_HANDLE aggregation, const char* output_name, tickcounter_ms_t now, double value, TELEMETRY_AGGREGATION_SEND_CALLBACK send, void* context)
+{
+    int result;
+    TELEMETRY_STAGE* stage;
+
+    /*Codes_SRS_TELEMETRY_AGGREGATION_41_006: [ If aggregation or send is NULL, or no stage has output_name, telemetry_aggregation_add_sample shall fail and return a non-zero value. ]*/
+    if ((aggregation == NULL) || (send == NULL))
+    {
+        LogError("Invalid argument (aggregation=%p, send=%p)", aggregation, send);
+        result = __FAILURE__;
+    }
+    else if ((stage = *find_stage(aggregation, output_name)) == NULL)
+    {
+        LogError("No telemetry aggregation is set for output %s", (output_name == NULL) ? "(none)" : output_name);
+        result = __FAILURE__;
+    }
+    else
+    {
+        /*Codes_SRS_TELEMETRY_AGGREGATION_41_007: [ telemetry_aggregation_add_sample shall close the open window if window_ms have passed since its first sample, then fold value into the open window, opening one at now if there is none. ]*/
+        if ((stage->current.count > 0) && (now - stage->current.start >= stage->window_ms))
+        {
+            close_window(stage);
+        }
+
+        if (stage->current.count == 0)
+        {
+            stage->current.start = now;
+            stage->current.min = value;
+            stage->current.max = value;
+            stage->current.sum = value;
+        }
+        else
+        {
+            stage->current.min = (value < stage->current.min) ? value : stage->current.min;
+            stage->current.max = (value > stage->current.max) ? value : stage->current.max;
+            stage->current.sum += value;
+        }
+        stage->current.count++;
+
+        /*Codes_SRS_TELEMETRY_AGGREGATION_41_009: [ If the stage forwards anomalies and value is below anomaly_low or above anomaly_high, telemetry_aggregation_add_sample shall hand an event holding value to send, and fail if it cannot be built or is not taken. ]*/
+        if (stage->forward_anomalies && ((value < stage->anomaly_low) || (value > stage->anomaly_high)))
+        {
+            IOTHUB_MESSAGE_HANDLE message = create_anomaly_event(stage, value);
+
+            if (message == NULL)
+            {
+                result = __FAILURE__;
+            }
+            else if (send(message, context) != 0)
+            {
+                LogError("The anomaly event was not taken");
+                IoTHubMessage_Destroy(message);
+                result = __FAILURE__;
+            }
+            else
+            {
+                result = RESULT_OK;
+            }
+        }
+        else
+        {
+            result = RESULT_OK;
+        }
+    }
+
+    return result;
+}
+
+void telemetry_aggregation_flush(TELEMETRY_AGGREGATION_HANDLE aggregation, tickcounter_ms_t now, TELEMETRY_AGGREGATION_SEND_CALLBACK send, void* context)
+{
+    if ((aggregation == NULL) || (send == NULL))
+    {
+        LogError("Invalid argument (aggregation=%p, send=%p)", aggregation, send);
+    }
+    else
+    {
+        TELEMETRY_STAGE* stage;
+
+        for (stage = aggregation->stages; stage != NULL; stage = stage->next)
+        {
+            /*Codes_SRS_TELEMETRY_AGGREGATION_41_011: [ telemetry_aggregation_flush shall close the open window of every stage if window_ms have passed since its first sample. ]*/
+            if ((stage->current.count > 0) && (now - stage->current.start >= stage->window_ms))
+            {
+                close_window(stage);
+            }
+
+            /*Codes_SRS_TELEMETRY_AGGREGATION_41_012: [ telemetry_aggregation_flush shall hand the event of every closed window to send, oldest first, and keep a window and the ones after it in the same stage if its event cannot be built or is not taken. ]*/
+            while (stage->closed_count > 0)
+            {
+                IOTHUB_MESSAGE_HANDLE message = create_window_event(stage, &stage->closed[stage->closed_head]);
+
+                if (message == NULL)
+                {
+                    break;
+                }
+                else if (send(message, context) != 0)
+                {
+                    IoTHubMessage_Destroy(message);
+                    break;
+                }
+                else
+                {
+                    stage->closed_head = (stage->closed_head + 1) % stage->closed_capacity;
+                    stage->closed_count--;
+                    stage->dropped = 0;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,180 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/tickcounter.h"
+
+#include "iothub_client_trace_ring.h"
+#include "internal/iothub_client_trace_ring_private.h"
+
+#define RESULT_OK 0
+
+DEFINE_ENUM_STRINGS(IOTHUB_CLIENT_TRACE_EVENT, IOTHUB_CLIENT_TRACE_EVENT_VALUES);
+
+/*the layout a dump decoder finds after IOTHUB_CLIENT_TRACE_RING_MAGIC; the records follow in the same allocation*/
+typedef struct TRACE_RING_TAG
+{
+    char magic[8];
+    uint32_t record_size;
+    uint32_t capacity;
+    uint64_t written; /*records ever written, the next one goes to written % capacity*/
+    IOTHUB_CLIENT_TRACE_RECORD* records;
+} TRACE_RING;
+
+bool g_iothub_client_trace_ring_started = false;
+
+static TRACE_RING* g_trace_ring = NULL;
+static LOCK_HANDLE g_trace_ring_lock = NULL;
+static TICK_COUNTER_HANDLE g_trace_ring_tick_counter = NULL;
+
+static void destroy_trace_ring(void)
+{
+    if (g_trace_ring_tick_counter != NULL)
+    {
+        tickcounter_destroy(g_trace_ring_tick_counter);
+        g_trace_ring_tick_counter = NULL;
+    }
+    if (g_trace_ring_lock != NULL)
+    {
+        (void)Lock_Deinit(g_trace_ring_lock);
+        g_trace_ring_lock = NULL;
+    }
+    if (g_trace_ring != NULL)
+    {
+        free(g_trace_ring);
+        g_trace_ring = NULL;
+    }
+}
+
+int IoTHubClient_TraceRing_Start(size_t record_count)
+{
+    int result;
+
+    /*Codes_SRS_IOTHUB_CLIENT_TRACE_RING_41_001: [ If record_count is 0 or does not fit the dump format, IoTHubClient_TraceRing_Start shall fail and return a non-zero value. ]*/
+    if ((record_count == 0) || (record_count > UINT32_MAX) || (record_count > (SIZE_MAX - sizeof(TRACE_RING)) / sizeof(IOTHUB_CLIENT_TRACE_RECORD)))
+    {
+        LogError("Invalid record count %lu", (unsigned long)record_count);
+        result = __FAILURE__;
+    }
+    /*Codes_SRS_IOTHUB_CLIENT_TRACE_RING_41_002: [ If tracing is already started, IoTHubClient_TraceRing_Start shall fail and return a non-zero value. ]*/
+    else if (g_trace_ring != NULL)
+    {
+        LogError("Tracing is already started");
+        result = __FAILURE__;
+    }
+    /*Codes_SRS_IOTHUB_CLIENT_TRACE_RING_41_003: [ IoTHubClient_TraceRing_Start shall allocate the ring and its records in one block starting with IOTHUB_CLIENT_TRACE_RING_MAGIC, and create a lock and a tick counter; if any of them fails it shall free the others and return a non-zero value. ]*/
+    else if ((g_trace_ring = (TRACE_RING*)malloc(sizeof(TRACE_RING) + record_count * sizeof(IOTHUB_CLIENT_TRACE_RECORD))) == NULL)
+    {
+        LogError("Cannot allocate a ring of %lu records", (unsigned long)record_count);
+        result = __FAILURE__;
+    }
+    else if ((g_trace_ring_lock = Lock_Init()) == NULL)
+    {
+        LogError("Cannot create the lock of the trace ring");
+        destroy_trace_ring();
+        result = __FAILURE__;
+    }
+    else if ((g_trace_ring_tick_counter = tickcounter_create()) == NULL)
+    {
+        LogError("Cannot create the tick counter of the trace ring");
+        destroy_trace_ring();
+        result = __FAILURE__;
+    }
+    else
+    {
+        (void)memcpy(g_trace_ring->magic, IOTHUB_CLIENT_TRACE_RING_MAGIC, sizeof(g_trace_ring->magic));
+        g_trace_ring->record_size = (uint32_t)sizeof(IOTHUB_CLIENT_TRACE_RECORD);
+        g_trace_ring->capacity = (uint32_t)record_count;
+        g_trace_ring->written = 0;
+        g_trace_ring->records = (IOTHUB_CLIENT_TRACE_RECORD*)(g_trace_ring + 1);
+
+        /*Codes_SRS_IOTHUB_CLIENT_TRACE_RING_41_004: [ On success IoTHubClient_TraceRing_Start shall start tracing and return 0. ]*/
+        g_iothub_client_trace_ring_started = true;
+        result = RESULT_OK;
+    }
+
+    return result;
+}
+
+void IoTHubClient_TraceRing_Stop(void)
+{
+    /*Codes_SRS_IOTHUB_CLIENT_TRACE_RING_41_005: [ IoTHubClient_TraceRing_Stop shall stop tracing and free the ring, its lock and its tick counter; it shall do nothing if tracing is not started. ]*/
+    g_iothub_client_trace_ring_started = false;
+    destroy_trace_ring();
+}
+
+void IoTHubClient_TraceRing_Record(IOTHUB_CLIENT_TRACE_EVENT event, const void* source, uint32_t value1, uint32_t value2)
+{
+    tickcounter_ms_t now;
+
+    /*Codes_SRS_IOTHUB_CLIENT_TRACE_RING_41_006: [ If tracing is not started, IoTHubClient_TraceRing_Record shall do nothing. ]*/
+    if (g_trace_ring == NULL)
+    {
+        /*tracing is not started*/
+    }
+    else if (tickcounter_get_current_ms(g_trace_ring_tick_counter, &now) != 0)
+    {
+        LogError("Cannot get the time of trace event %s", ENUM_TO_STRING(IOTHUB_CLIENT_TRACE_EVENT, event));
+    }
+    else if (Lock(g_trace_ring_lock) != LOCK_OK)
+    {
+        LogError("Cannot lock the trace ring");
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_TRACE_RING_41_007: [ IoTHubClient_TraceRing_Record shall write event, source folded to 32 bits, value1, value2 and the milliseconds since IoTHubClient_TraceRing_Start over the oldest record of the ring. ]*/
+        uintptr_t source_bits = (uintptr_t)source;
+        IOTHUB_CLIENT_TRACE_RECORD* record = &g_trace_ring->records[g_trace_ring->written % g_trace_ring->capacity];
+
+        record->ms = (uint32_t)now;
+        record->event = (uint32_t)event;
+        record->source = (uint32_t)(source_bits ^ (uintptr_t)((uint64_t)source_bits >> 32));
+        record->value1 = value1;
+        record->value2 = value2;
+        g_trace_ring->written++;
+
+        (void)Unlock(g_trace_ring_lock);
+    }
+}
+
+size_t IoTHubClient_TraceRing_Dump(IOTHUB_CLIENT_TRACE_RECORD* records, size_t record_count)
+{
+    size_t result;
+
+    /*Codes_SRS_IOTHUB_CLIENT_TRACE_RING_41_008: [ If records is NULL or tracing is not started, IoTHubClient_TraceRing_Dump shall return 0. ]*/
+    if ((records == NULL) || (g_trace_ring == NULL))
+    {
+        result = 0;
+    }
+    else if (Lock(g_trace_ring_lock) != LOCK_OK)
+    {
+        LogError("Cannot lock the trace ring");
+        result = 0;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUB_CLIENT_TRACE_RING_41_009: [ IoTHubClient_TraceRing_Dump shall copy the newest record_count records still in the ring into records, oldest first, and return how many it copied. ]*/
+        uint64_t available = (g_trace_ring->written < g_trace_ring->capacity) ? g_trace_ring->written : g_trace_ring->capacity;
+        uint64_t first;
+        size_t index;
+
+        result = (available < record_count) ? (size_t)available : record_count;
+        first = g_trace_ring->written - result;
+
+        for (index = 0; index < result; index++)
+        {
+            records[index] = g_trace_ring->records[(first + index) % g_trace_ring->capacity];
+        }
+
+        (void)Unlock(g_trace_ring_lock);
+    }
+
+    return result;
+}
@@ -0,0 +1,249 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <string.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/agenttime.h"
+
+#include "internal/iothub_client_tracing.h"
+
+#define INDEFINITE_TIME ((time_t)-1)
+#define TRACE_FLAGS_SAMPLED 0x01
+
+static const char HEX_DIGITS[] = "0123456789abcdef";
+
+/*xorshift64*, ids only need to be unique, not unpredictable*/
+static uint64_t get_next_random(IOTHUB_CLIENT_TRACER* tracer)
+{
+    uint64_t state = tracer->random_state;
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    tracer->random_state = state;
+    return state * 2685821657736338717ULL;
+}
+
+static void generate_id(IOTHUB_CLIENT_TRACER* tracer, unsigned char* id, size_t size)
+{
+    size_t i = 0;
+    while (i < size)
+    {
+        uint64_t random = get_next_random(tracer);
+        size_t j;
+        for (j = 0; j < sizeof(random) && i < size; j++, i++)
+        {
+            id[i] = (unsigned char)(random >> (j * 8));
+        }
+    }
+}
+
+static bool is_zero_id(const unsigned char* id, size_t size)
+{
+    unsigned char bits = 0;
+    size_t i;
+    for (i = 0; i < size; i++)
+    {
+        bits |= id[i];
+    }
+    return (bits == 0);
+}
+
+static int hex_value(char c)
+{
+    int result;
+    if (c >= '0' && c <= '9')
+    {
+        result = c - '0';
+    }
+    else if (c >= 'a' && c <= 'f')
+    {
+        result = c - 'a' + 10;
+    }
+    else
+    {
+        result = -1;
+    }
+    return result;
+}
+
+static int parse_hex(const char* text, unsigned char* bytes, size_t size)
+{
+    int result = 0;
+    size_t i;
+    for (i = 0; i < size; i++)
+    {
+        int high = hex_value(text[2 * i]);
+        int low = hex_value(text[(2 * i) + 1]);
+        if (high < 0 || low < 0)
+        {
+            result = __FAILURE__;
+            break;
+        }
+        bytes[i] = (unsigned char)((high << 4) | low);
+    }
+    return result;
+}
+
+static char* write_hex(char* text, const unsigned char* bytes, size_t size)
+{
+    size_t i;
+    for (i = 0; i < size; i++)
+    {
+        *text++ = HEX_DIGITS[bytes[i] >> 4];
+        *text++ = HEX_DIGITS[bytes[i] & 0x0F];
+    }
+    return text;
+}
+
+/*version "-" trace-id "-" parent-id "-" trace-flags, see https://www.w3.org/TR/trace-context/ */
+static int parse_traceparent(const char* traceparent, unsigned char* trace_id, unsigned char* parent_span_id)
+{
+    int result;
+    unsigned char version;
+
+    if (strlen(traceparent) < TRACEPARENT_LENGTH ||
+        traceparent[2] != '-' || traceparent[35] != '-' || traceparent[52] != '-' ||
+        parse_hex(traceparent, &version, 1) != 0 || version == 0xFF ||
+        (version == 0 && traceparent[TRACEPARENT_LENGTH] != '\0') ||
+        parse_hex(traceparent + 3, trace_id, IOTHUB_CLIENT_TRACE_ID_SIZE) != 0 ||
+        parse_hex(traceparent + 36, parent_span_id, IOTHUB_CLIENT_SPAN_ID_SIZE) != 0 ||
+        is_zero_id(trace_id, IOTHUB_CLIENT_TRACE_ID_SIZE) ||
+        is_zero_id(parent_span_id, IOTHUB_CLIENT_SPAN_ID_SIZE))
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = 0;
+    }
+    return result;
+}
+
+int IoTHubClient_Tracing_SetExporter(IOTHUB_CLIENT_TRACER* tracer, const IOTHUB_CLIENT_TRACE_EXPORTER* exporter)
+{
+    int result;
+
+    /* Codes_SRS_IOTHUB_TRACING_41_001: [ If tracer is NULL, IoTHubClient_Tracing_SetExporter shall return a non-zero value. ]*/
+    if (tracer == NULL)
+    {
+        LogError("Invalid argument tracer is NULL");
+        result = __FAILURE__;
+    }
+    else if (exporter == NULL || exporter->on_span_ended == NULL)
+    {
+        /* Codes_SRS_IOTHUB_TRACING_41_002: [ If exporter or its on_span_ended is NULL, IoTHubClient_Tracing_SetExporter shall turn tracing off and return 0. ]*/
+        tracer->exporter.on_span_ended = NULL;
+        tracer->exporter.context = NULL;
+        result = 0;
+    }
+    else
+    {
+        /* Codes_SRS_IOTHUB_TRACING_41_003: [ Otherwise IoTHubClient_Tracing_SetExporter shall copy exporter and, the first time, seed the id generator from the current time. ]*/
+        if (tracer->random_state == 0)
+        {
+            time_t now = get_time(NULL);
+            tracer->random_state = ((uint64_t)((now == INDEFINITE_TIME) ? 0 : now) << 32) ^ (uint64_t)(uintptr_t)tracer ^ 0x9E3779B97F4A7C15ULL;
+            if (tracer->random_state == 0)
+            {
+                tracer->random_state = 1;
+            }
+        }
+        tracer->exporter = *exporter;
+        result = 0;
+    }
+
+    return result;
+}
+
+void IoTHubClient_Tracing_Start(IOTHUB_CLIENT_TRACER* tracer, IOTHUB_CLIENT_TRACE_CONTEXT* context, const char* traceparent, uint64_t now_ms)
+{
+    if (tracer == NULL || context == NULL)
+    {
+        LogError("Invalid argument tracer=%p, context=%p", tracer, context);
+    }
+    else
+    {
+        /* Codes_SRS_IOTHUB_TRACING_41_004: [ If traceparent is a valid W3C traceparent, IoTHubClient_Tracing_Start shall take the trace id and the parent span id from it. ]*/
+        if (traceparent == NULL || parse_traceparent(traceparent, context->trace_id, context->parent_span_id) != 0)
+        {
+            /* Codes_SRS_IOTHUB_TRACING_41_005: [ Otherwise IoTHubClient_Tracing_Start shall generate a new trace id and leave the parent span id zero. ]*/
+            generate_id(tracer, context->trace_id, IOTHUB_CLIENT_TRACE_ID_SIZE);
+            (void)memset(context->parent_span_id, 0, IOTHUB_CLIENT_SPAN_ID_SIZE);
+        }
+
+        /* Codes_SRS_IOTHUB_TRACING_41_006: [ IoTHubClient_Tracing_Start shall generate the span id of the root span, start it at now_ms and mark context active. ]*/
+        generate_id(tracer, context->span_id, IOTHUB_CLIENT_SPAN_ID_SIZE);
+        context->ms_started = now_ms;
+        context->ms_published = 0;
+        context->published = false;
+        context->active = true;
+    }
+}
+
+int IoTHubClient_Tracing_FormatTraceparent(const IOTHUB_CLIENT_TRACE_CONTEXT* context, char* buffer, size_t buffer_size)
+{
+    int result;
+
+    /* Codes_SRS_IOTHUB_TRACING_41_007: [ If context or buffer is NULL, or buffer_size is less than TRACEPARENT_LENGTH + 1, IoTHubClient_Tracing_FormatTraceparent shall return a non-zero value. ]*/
+    if (context == NULL || buffer == NULL || buffer_size < TRACEPARENT_LENGTH + 1)
+    {
+        LogError("Invalid argument context=%p, buffer=%p, buffer_size=%lu", context, buffer, (unsigned long)buffer_size);
+        result = __FAILURE__;
+    }
+    else
+    {
+        /* Codes_SRS_IOTHUB_TRACING_41_008: [ IoTHubClient_Tracing_FormatTraceparent shall write "00-<trace id>-<root span id>-01" in lowercase hex. ]*/
+        unsigned char flags = TRACE_FLAGS_SAMPLED;
+        char* position = buffer;
+        *position++ = '0';
+        *position++ = '0';
+        *position++ = '-';
+        position = write_hex(position, context->trace_id, IOTHUB_CLIENT_TRACE_ID_SIZE);
+        *position++ = '-';
+        position = write_hex(position, context->span_id, IOTHUB_CLIENT_SPAN_ID_SIZE);
+        *position++ = '-';
+        position = write_hex(position, &flags, 1);
+        *position = '\0';
+        result = 0;
+    }
+
+    return result;
+}
+
+void IoTHubClient_Tracing_ExportSpan(IOTHUB_CLIENT_TRACER* tracer, IOTHUB_CLIENT_SPAN_KIND kind, const IOTHUB_CLIENT_TRACE_CONTEXT* context, bool child, uint64_t start_ms, uint64_t end_ms, bool succeeded, const char* name)
+{
+    if (tracer == NULL || context == NULL)
+    {
+        LogError("Invalid argument tracer=%p, context=%p", tracer, context);
+    }
+    /* Codes_SRS_IOTHUB_TRACING_41_009: [ If tracing is off, IoTHubClient_Tracing_ExportSpan shall do nothing. ]*/
+    else if (IoTHubClient_Tracing_IsEnabled(tracer))
+    {
+        IOTHUB_CLIENT_SPAN span;
+
+        span.kind = kind;
+        (void)memcpy(span.trace_id, context->trace_id, IOTHUB_CLIENT_TRACE_ID_SIZE);
+        if (child)
+        {
+            /* Codes_SRS_IOTHUB_TRACING_41_010: [ A child span shall get a new span id and the root span of context as its parent. ]*/
+            generate_id(tracer, span.span_id, IOTHUB_CLIENT_SPAN_ID_SIZE);
+            (void)memcpy(span.parent_span_id, context->span_id, IOTHUB_CLIENT_SPAN_ID_SIZE);
+        }
+        else
+        {
+            /* Codes_SRS_IOTHUB_TRACING_41_011: [ The root span shall use the span id and the parent span id of context. ]*/
+            (void)memcpy(span.span_id, context->span_id, IOTHUB_CLIENT_SPAN_ID_SIZE);
+            (void)memcpy(span.parent_span_id, context->parent_span_id, IOTHUB_CLIENT_SPAN_ID_SIZE);
+        }
+        span.start_ms = start_ms;
+        span.end_ms = (end_ms < start_ms) ? start_ms : end_ms;
+        span.succeeded = succeeded;
+        span.name = name;
+
+        /* Codes_SRS_IOTHUB_TRACING_41_012: [ IoTHubClient_Tracing_ExportSpan shall call on_span_ended with the span and the exporter context. ]*/
+        tracer->exporter.on_span_ended(&span, tracer->exporter.context);
+    }
+}
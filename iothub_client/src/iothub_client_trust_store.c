@@ -0,0 +1,387 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/crt_abstractions.h"
+#include "azure_c_shared_utility/lock.h"
+
+#include "internal/iothub_client_memory_private.h"
+#include "internal/iothub_client_trust_store.h"
+
+#define RESULT_OK 0
+
+#define FNV_OFFSET_BASIS    2166136261u
+#define FNV_PRIME           16777619u
+
+typedef struct TRUST_STORE_ENTRY_TAG
+{
+    struct TRUST_STORE_ENTRY_TAG* next;
+    size_t ref_count;
+    bool shared; /*false for the private copies given while there is no store*/
+    char* file_name; /*non-NULL for the contents of a file, which the store holds one reference on*/
+    uint32_t hash;
+    size_t length;
+    size_t memory_size; /*of the allocation, length can get shorter once a file is read*/
+    char* certificates; /*follows the entry in the same allocation*/
+} TRUST_STORE_ENTRY;
+
+static LOCK_HANDLE g_trust_store_lock = NULL;
+static TRUST_STORE_ENTRY* g_trust_store_entries = NULL;
+static IOTHUB_CLIENT_MEMORY_COUNTERS g_trust_store_memory_counters; /*only the shared copies, which are under g_trust_store_lock*/
+
+static uint32_t hash_certificates(const char* certificates, size_t length)
+{
+    uint32_t result = FNV_OFFSET_BASIS;
+    size_t index;
+
+    for (index = 0; index < length; index++)
+    {
+        result = (result ^ (unsigned char)certificates[index]) * FNV_PRIME;
+    }
+
+    return result;
+}
+
+static TRUST_STORE_ENTRY* create_entry(size_t length)
+{
+    TRUST_STORE_ENTRY* result;
+
+    if ((result = (TRUST_STORE_ENTRY*)calloc(1, sizeof(TRUST_STORE_ENTRY) + length + 1)) == NULL)
+    {
+        LogError("Cannot allocate %lu bytes", (unsigned long)(sizeof(TRUST_STORE_ENTRY) + length + 1));
+    }
+    else
+    {
+        result->ref_count = 1;
+        result->shared = (g_trust_store_lock != NULL);
+        result->length = length;
+        result->certificates = (char*)(result + 1);
+        result->memory_size = sizeof(TRUST_STORE_ENTRY) + length + 1;
+        /*Codes_SRS_TRUST_STORE_41_014: [ Every shared copy of certificates shall be counted in IOTHUB_CLIENT_MEMORY_OPTIONS of the memory counters of the store until it is freed. ]*/
+        if (result->shared)
+        {
+            IOTHUB_CLIENT_MEMORY_ADD(&g_trust_store_memory_counters, IOTHUB_CLIENT_MEMORY_OPTIONS, result->memory_size);
+        }
+    }
+
+    return result;
+}
+
+static void destroy_entry(TRUST_STORE_ENTRY* entry)
+{
+    if (entry->shared)
+    {
+        IOTHUB_CLIENT_MEMORY_REMOVE(&g_trust_store_memory_counters, IOTHUB_CLIENT_MEMORY_OPTIONS, entry->memory_size);
+    }
+    if (entry->file_name != NULL)
+    {
+        free(entry->file_name);
+    }
+    free(entry);
+}
+
+static void add_entry(TRUST_STORE_ENTRY* entry)
+{
+    entry->hash = hash_certificates(entry->certificates, entry->length);
+    entry->next = g_trust_store_entries;
+    g_trust_store_entries = entry;
+}
+
+static TRUST_STORE_ENTRY* find_certificates(const char* certificates, size_t length)
+{
+    TRUST_STORE_ENTRY* result = g_trust_store_entries;
+    uint32_t hash = hash_certificates(certificates, length);
+
+    while ((result != NULL) &&
+        ((result->hash != hash) || (result->length != length) || (memcmp(result->certificates, certificates, length) != 0)))
+    {
+        result = result->next;
+    }
+
+    return result;
+}
+
+static TRUST_STORE_ENTRY* find_file(const char* file_name)
+{
+    TRUST_STORE_ENTRY* result = g_trust_store_entries;
+
+    while ((result != NULL) && ((result->file_name == NULL) || (strcmp(result->file_name, file_name) != 0)))
+    {
+        result = result->next;
+    }
+
+    return result;
+}
+
+static TRUST_STORE_ENTRY* read_file(const char* file_name)
+{
+    TRUST_STORE_ENTRY* result;
+    FILE *file_stream = NULL;
+
+    if ((file_stream = fopen(file_name, "r")) == NULL)
+    {
+        LogError("Cannot read file %s, errno=%d", file_name, errno);
+        result = NULL;
+    }
+    else if (fseek(file_stream, 0, SEEK_END) != 0)
+    {
+        LogError("fseek on file %s fails, errno=%d", file_name, errno);
+        result = NULL;
+    }
+    else
+    {
+        long int file_size = ftell(file_stream);
+        if (file_size < 0)
+        {
+            LogError("ftell fails reading %s, errno=%d", file_name, errno);
+            result = NULL;
+        }
+        else if (file_size == 0)
+        {
+            LogError("file %s is 0 bytes, which is not valid certificate", file_name);
+            result = NULL;
+        }
+        else
+        {
+            rewind(file_stream);
+
+            if ((result = create_entry((size_t)file_size)) == NULL)
+            {
+                LogError("Failed allocating the certificates of %s", file_name);
+            }
+            else if ((fread(result->certificates, 1, file_size, file_stream) == 0) || (ferror(file_stream) != 0))
+            {
+                LogError("fread failed on file %s, errno=%d", file_name, errno);
+                destroy_entry(result);
+                result = NULL;
+            }
+            else
+            {
+                /*text mode reads can be shorter than the file*/
+                result->length = strlen(result->certificates);
+            }
+        }
+    }
+
+    if (file_stream != NULL)
+    {
+        fclose(file_stream);
+    }
+
+    return result;
+}
+
+int trust_store_init(void)
+{
+    int result;
+
+    // Codes_SRS_TRUST_STORE_41_001: [ trust_store_init shall create the lock of the store, and fail with a non-zero value if it cannot. ]
+    if (g_trust_store_lock != NULL)
+    {
+        result = RESULT_OK;
+    }
+    else if ((g_trust_store_lock = Lock_Init()) == NULL)
+    {
+        LogError("Failed creating the trust store lock");
+        result = __FAILURE__;
+    }
+    else
+    {
+        IOTHUB_CLIENT_MEMORY_REGISTER(&g_trust_store_memory_counters);
+        result = RESULT_OK;
+    }
+
+    return result;
+}
+
+void trust_store_deinit(void)
+{
+    // Codes_SRS_TRUST_STORE_41_002: [ trust_store_deinit shall free every entry of the store and its lock; it shall do nothing if the store is not initialized. ]
+    if (g_trust_store_lock != NULL)
+    {
+        while (g_trust_store_entries != NULL)
+        {
+            TRUST_STORE_ENTRY* entry = g_trust_store_entries;
+            g_trust_store_entries = entry->next;
+
+            /*the contents of a file keep the reference of the store, anything more is a client not destroyed*/
+            if (entry->ref_count > ((entry->file_name != NULL) ? 1 : 0))
+            {
+                LogError("Trust store entry still held at deinit, ref_count=%lu", (unsigned long)entry->ref_count);
+            }
+            destroy_entry(entry);
+        }
+
+        IOTHUB_CLIENT_MEMORY_UNREGISTER(&g_trust_store_memory_counters);
+        Lock_Deinit(g_trust_store_lock);
+        g_trust_store_lock = NULL;
+    }
+}
+
+const char* trust_store_acquire(const char* certificates)
+{
+    const char* result;
+
+    // Codes_SRS_TRUST_STORE_41_003: [ If certificates is NULL, trust_store_acquire shall fail and return NULL. ]
+    if (certificates == NULL)
+    {
+        LogError("Invalid argument certificates=%p", certificates);
+        result = NULL;
+    }
+    // Codes_SRS_TRUST_STORE_41_004: [ If the store is not initialized, trust_store_acquire shall return a private copy of certificates. ]
+    else if (g_trust_store_lock == NULL)
+    {
+        size_t length = strlen(certificates);
+        TRUST_STORE_ENTRY* entry;
+
+        if ((entry = create_entry(length)) == NULL)
+        {
+            LogError("Failed copying the certificates");
+            result = NULL;
+        }
+        else
+        {
+            (void)memcpy(entry->certificates, certificates, length);
+            result = entry->certificates;
+        }
+    }
+    else if (Lock(g_trust_store_lock) != LOCK_OK)
+    {
+        LogError("Failed locking the trust store");
+        result = NULL;
+    }
+    else
+    {
+        size_t length = strlen(certificates);
+        TRUST_STORE_ENTRY* entry;
+
+        // Codes_SRS_TRUST_STORE_41_005: [ trust_store_acquire shall return the copy already in the store of the same certificates, adding a reference to it. ]
+        if ((entry = find_certificates(certificates, length)) != NULL)
+        {
+            entry->ref_count++;
+            result = entry->certificates;
+        }
+        // Codes_SRS_TRUST_STORE_41_006: [ Otherwise trust_store_acquire shall add a copy of certificates to the store and return it; if that fails it shall return NULL. ]
+        else if ((entry = create_entry(length)) == NULL)
+        {
+            LogError("Failed copying the certificates");
+            result = NULL;
+        }
+        else
+        {
+            (void)memcpy(entry->certificates, certificates, length);
+            add_entry(entry);
+            result = entry->certificates;
+        }
+
+        (void)Unlock(g_trust_store_lock);
+    }
+
+    return result;
+}
+
+const char* trust_store_acquire_file(const char* file_name)
+{
+    const char* result;
+
+    // Codes_SRS_TRUST_STORE_41_007: [ If file_name is NULL, trust_store_acquire_file shall fail and return NULL. ]
+    if (file_name == NULL)
+    {
+        LogError("Invalid argument file_name=%p", file_name);
+        result = NULL;
+    }
+    // Codes_SRS_TRUST_STORE_41_008: [ If the store is not initialized, trust_store_acquire_file shall return a private copy of the contents of file_name. ]
+    else if (g_trust_store_lock == NULL)
+    {
+        TRUST_STORE_ENTRY* entry = read_file(file_name);
+        result = (entry == NULL) ? NULL : entry->certificates;
+    }
+    else if (Lock(g_trust_store_lock) != LOCK_OK)
+    {
+        LogError("Failed locking the trust store");
+        result = NULL;
+    }
+    else
+    {
+        TRUST_STORE_ENTRY* entry;
+
+        // Codes_SRS_TRUST_STORE_41_009: [ trust_store_acquire_file shall return the contents of a file already read into the store, adding a reference to them. ]
+        if ((entry = find_file(file_name)) != NULL)
+        {
+            entry->ref_count++;
+            result = entry->certificates;
+        }
+        // Codes_SRS_TRUST_STORE_41_010: [ Otherwise trust_store_acquire_file shall read file_name into the store, held there until trust_store_deinit, and return its contents; if that fails it shall return NULL. ]
+        else if ((entry = read_file(file_name)) == NULL)
+        {
+            result = NULL;
+        }
+        else if (mallocAndStrcpy_s(&entry->file_name, file_name) != 0)
+        {
+            LogError("Failed copying the file name %s", file_name);
+            destroy_entry(entry);
+            result = NULL;
+        }
+        else
+        {
+            entry->ref_count++;
+            add_entry(entry);
+            result = entry->certificates;
+        }
+
+        (void)Unlock(g_trust_store_lock);
+    }
+
+    return result;
+}
+
+void trust_store_release(const char* certificates)
+{
+    // Codes_SRS_TRUST_STORE_41_011: [ If certificates is NULL, trust_store_release shall do nothing. ]
+    if (certificates != NULL)
+    {
+        TRUST_STORE_ENTRY* entry = ((TRUST_STORE_ENTRY*)(void*)certificates) - 1;
+
+        // Codes_SRS_TRUST_STORE_41_012: [ trust_store_release shall free a private copy. ]
+        if (!entry->shared)
+        {
+            destroy_entry(entry);
+        }
+        else if (g_trust_store_lock == NULL)
+        {
+            LogError("Trust store already deinitialized");
+        }
+        else if (Lock(g_trust_store_lock) != LOCK_OK)
+        {
+            LogError("Failed locking the trust store");
+        }
+        else
+        {
+            // Codes_SRS_TRUST_STORE_41_013: [ trust_store_release shall remove a reference to a shared copy, and free it once it has none left. ]
+            if (--entry->ref_count == 0)
+            {
+                TRUST_STORE_ENTRY** link = &g_trust_store_entries;
+
+                while ((*link != NULL) && (*link != entry))
+                {
+                    link = &(*link)->next;
+                }
+                if (*link != NULL)
+                {
+                    *link = entry->next;
+                }
+                destroy_entry(entry);
+            }
+
+            (void)Unlock(g_trust_store_lock);
+        }
+    }
+}
@@ -0,0 +1,365 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "parson.h"
+
+#include "internal/iothub_client_twin_cache.h"
+
+#define RESULT_OK 0
+
+#define TWIN_CACHE_TEMP_SUFFIX      ".tmp"
+#define TWIN_CACHE_MAX_FILE_SIZE    (128 * 1024) /*well above the largest twin, anything longer is not one*/
+
+static const char* DESIRED_NAME = "desired";
+static const char* VERSION_NAME = "$version";
+static const char* DESIRED_VERSION_NAME = "desired.$version";
+
+typedef struct TWIN_CACHE_TAG
+{
+    char* file_path;
+    char* twin; /*serialized, NULL while the cache is empty*/
+    bool has_version;
+    double version; /*desired $version of twin*/
+} TWIN_CACHE;
+
+static JSON_Value* parse_object(const unsigned char* payload, size_t size)
+{
+    JSON_Value* result;
+    char* json = (char*)malloc(size + 1);
+
+    if (json == NULL)
+    {
+        LogError("Failed allocating the twin copy");
+        result = NULL;
+    }
+    else
+    {
+        (void)memcpy(json, payload, size);
+        json[size] = '\0';
+
+        if ((result = json_parse_string(json)) == NULL)
+        {
+            LogError("Twin is not valid JSON");
+        }
+        else if (json_value_get_type(result) != JSONObject)
+        {
+            LogError("Twin is not a JSON object");
+            json_value_free(result);
+            result = NULL;
+        }
+        free(json);
+    }
+
+    return result;
+}
+
+// Applies a desired patch the way the hub does: nulls remove, objects are merged member by member
+static int apply_patch(JSON_Object* target, const JSON_Object* patch)
+{
+    int result = RESULT_OK;
+    size_t count = json_object_get_count(patch);
+    size_t index;
+
+    for (index = 0; index < count && result == RESULT_OK; index++)
+    {
+        const char* name = json_object_get_name(patch, index);
+        JSON_Value* value = json_object_get_value_at(patch, index);
+        JSON_Object* target_member = json_object_get_object(target, name);
+
+        if (json_value_get_type(value) == JSONNull)
+        {
+            (void)json_object_remove(target, name);
+        }
+        else if (target_member != NULL && json_value_get_type(value) == JSONObject)
+        {
+            result = apply_patch(target_member, json_value_get_object(value));
+        }
+        else
+        {
+            JSON_Value* copy = json_value_deep_copy(value);
+            if (copy == NULL)
+            {
+                LogError("Failed copying desired property %s", name);
+                result = __FAILURE__;
+            }
+            else if (json_object_set_value(target, name, copy) != JSONSuccess)
+            {
+                LogError("Failed setting desired property %s", name);
+                json_value_free(copy);
+                result = __FAILURE__;
+            }
+        }
+    }
+
+    return result;
+}
+
+static void save_twin(TWIN_CACHE* twin_cache)
+{
+    size_t path_length = strlen(twin_cache->file_path);
+    char* temp_path = (char*)malloc(path_length + sizeof(TWIN_CACHE_TEMP_SUFFIX));
+
+    if (temp_path == NULL)
+    {
+        LogError("Failed allocating the twin cache file name");
+    }
+    else
+    {
+        FILE* file;
+        size_t twin_length = strlen(twin_cache->twin);
+
+        (void)memcpy(temp_path, twin_cache->file_path, path_length);
+        (void)memcpy(temp_path + path_length, TWIN_CACHE_TEMP_SUFFIX, sizeof(TWIN_CACHE_TEMP_SUFFIX));
+
+        // Codes_SRS_TWIN_CACHE_41_009: [ twin_cache_update shall write the twin to a temporary file and rename it over file_path, so an interrupted write leaves the previous twin in place; failing to do so shall only be logged. ]
+        if ((file = fopen(temp_path, "wb")) == NULL)
+        {
+            LogError("Failed opening %s, errno=%d", temp_path, errno);
+        }
+        else
+        {
+            bool written = (fwrite(twin_cache->twin, 1, twin_length, file) == twin_length);
+
+            if ((fclose(file) != 0) || !written)
+            {
+                LogError("Failed writing %s, errno=%d", temp_path, errno);
+                (void)remove(temp_path);
+            }
+            /*rename does not replace an existing file everywhere*/
+            else if ((rename(temp_path, twin_cache->file_path) != 0) &&
+                ((remove(twin_cache->file_path) != 0) || (rename(temp_path, twin_cache->file_path) != 0)))
+            {
+                LogError("Failed replacing %s, errno=%d", twin_cache->file_path, errno);
+                (void)remove(temp_path);
+            }
+        }
+        free(temp_path);
+    }
+}
+
+// Takes the twin held by twin_value as the cached one
+static int set_twin(TWIN_CACHE* twin_cache, JSON_Value* twin_value)
+{
+    int result;
+    char* serialized;
+    JSON_Object* twin_object = json_value_get_object(twin_value);
+
+    if ((serialized = json_serialize_to_string(twin_value)) == NULL)
+    {
+        LogError("Failed serializing the twin");
+        result = __FAILURE__;
+    }
+    else
+    {
+        if (twin_cache->twin != NULL)
+        {
+            json_free_serialized_string(twin_cache->twin);
+        }
+        twin_cache->twin = serialized;
+        twin_cache->has_version = (json_value_get_type(json_object_dotget_value(twin_object, DESIRED_VERSION_NAME)) == JSONNumber);
+        twin_cache->version = twin_cache->has_version ? json_object_dotget_number(twin_object, DESIRED_VERSION_NAME) : 0;
+        result = RESULT_OK;
+    }
+
+    return result;
+}
+
+static void load_twin(TWIN_CACHE* twin_cache)
+{
+    FILE* file;
+
+    if ((file = fopen(twin_cache->file_path, "rb")) != NULL)
+    {
+        unsigned char* content = (unsigned char*)malloc(TWIN_CACHE_MAX_FILE_SIZE);
+
+        if (content == NULL)
+        {
+            LogError("Failed allocating the twin cache content");
+        }
+        else
+        {
+            size_t size = fread(content, 1, TWIN_CACHE_MAX_FILE_SIZE, file);
+            JSON_Value* twin_value;
+
+            if ((size == 0) || (size == TWIN_CACHE_MAX_FILE_SIZE))
+            {
+                LogError("%s does not hold a twin", twin_cache->file_path);
+            }
+            else if ((twin_value = parse_object(content, size)) != NULL)
+            {
+                (void)set_twin(twin_cache, twin_value);
+                json_value_free(twin_value);
+            }
+            free(content);
+        }
+        (void)fclose(file);
+    }
+}
+
+static bool update_complete_twin(TWIN_CACHE* twin_cache, const unsigned char* payload, size_t size)
+{
+    bool result;
+    JSON_Value* twin_value;
+
+    if ((twin_value = parse_object(payload, size)) == NULL)
+    {
+        result = true;
+    }
+    else
+    {
+        JSON_Object* twin_object = json_value_get_object(twin_value);
+
+        // Codes_SRS_TWIN_CACHE_41_006: [ A DEVICE_TWIN_UPDATE_COMPLETE twin whose desired $version is the cached one shall not be newer. ]
+        if (twin_cache->has_version &&
+            (json_value_get_type(json_object_dotget_value(twin_object, DESIRED_VERSION_NAME)) == JSONNumber) &&
+            (json_object_dotget_number(twin_object, DESIRED_VERSION_NAME) == twin_cache->version))
+        {
+            result = false;
+        }
+        else
+        {
+            // Codes_SRS_TWIN_CACHE_41_007: [ Any other DEVICE_TWIN_UPDATE_COMPLETE twin shall replace the cached one and be newer. ]
+            result = true;
+            if (set_twin(twin_cache, twin_value) == RESULT_OK)
+            {
+                save_twin(twin_cache);
+            }
+        }
+        json_value_free(twin_value);
+    }
+
+    return result;
+}
+
+static bool update_desired_patch(TWIN_CACHE* twin_cache, const unsigned char* payload, size_t size)
+{
+    bool result;
+    JSON_Value* patch_value;
+
+    if ((patch_value = parse_object(payload, size)) == NULL)
+    {
+        result = true;
+    }
+    else
+    {
+        JSON_Object* patch_object = json_value_get_object(patch_value);
+        bool has_version = (json_value_get_type(json_object_get_value(patch_object, VERSION_NAME)) == JSONNumber);
+
+        // Codes_SRS_TWIN_CACHE_41_008: [ A DEVICE_TWIN_UPDATE_PARTIAL patch whose $version is not above the cached one shall not be newer; any other patch shall be merged into the cached "desired" object, a null member removing the property, and be newer. ]
+        if (twin_cache->has_version && has_version && (json_object_get_number(patch_object, VERSION_NAME) <= twin_cache->version))
+        {
+            result = false;
+        }
+        else
+        {
+            JSON_Value* twin_value;
+
+            result = true;
+
+            /*a patch arriving before any twin cannot be merged into anything, the next complete twin is taken as it is*/
+            if ((twin_cache->twin != NULL) &&
+                ((twin_value = parse_object((const unsigned char*)twin_cache->twin, strlen(twin_cache->twin))) != NULL))
+            {
+                JSON_Object* desired = json_object_get_object(json_value_get_object(twin_value), DESIRED_NAME);
+
+                if ((desired != NULL) &&
+                    (apply_patch(desired, patch_object) == RESULT_OK) &&
+                    (set_twin(twin_cache, twin_value) == RESULT_OK))
+                {
+                    save_twin(twin_cache);
+                }
+                json_value_free(twin_value);
+            }
+        }
+        json_value_free(patch_value);
+    }
+
+    return result;
+}
+
+TWIN_CACHE_HANDLE twin_cache_create(const char* file_path)
+{
+    TWIN_CACHE* result;
+
+    // Codes_SRS_TWIN_CACHE_41_001: [ If file_path is NULL or empty, twin_cache_create shall fail and return NULL. ]
+    if ((file_path == NULL) || (*file_path == '\0'))
+    {
+        LogError("Invalid argument file_path=%p", file_path);
+        result = NULL;
+    }
+    // Codes_SRS_TWIN_CACHE_41_002: [ If any allocation fails, twin_cache_create shall release all memory it allocated and return NULL. ]
+    else if ((result = (TWIN_CACHE*)malloc(sizeof(TWIN_CACHE))) == NULL)
+    {
+        LogError("Failed allocating the twin cache");
+    }
+    else
+    {
+        size_t path_length = strlen(file_path);
+
+        memset(result, 0, sizeof(TWIN_CACHE));
+        if ((result->file_path = (char*)malloc(path_length + 1)) == NULL)
+        {
+            LogError("Failed copying the twin cache file name");
+            free(result);
+            result = NULL;
+        }
+        else
+        {
+            (void)memcpy(result->file_path, file_path, path_length + 1);
+
+            // Codes_SRS_TWIN_CACHE_41_003: [ twin_cache_create shall load the twin in file_path; a file that does not exist or does not hold a JSON object shall leave the cache empty. ]
+            load_twin(result);
+        }
+    }
+
+    return result;
+}
+
+void twin_cache_destroy(TWIN_CACHE_HANDLE twin_cache)
+{
+    // Codes_SRS_TWIN_CACHE_41_004: [ twin_cache_destroy shall free the cache and keep its file; it shall do nothing if twin_cache is NULL. ]
+    if (twin_cache != NULL)
+    {
+        if (twin_cache->twin != NULL)
+        {
+            json_free_serialized_string(twin_cache->twin);
+        }
+        free(twin_cache->file_path);
+        free(twin_cache);
+    }
+}
+
+bool twin_cache_update(TWIN_CACHE_HANDLE twin_cache, DEVICE_TWIN_UPDATE_STATE update_state, const unsigned char* payload, size_t size)
+{
+    bool result;
+
+    // Codes_SRS_TWIN_CACHE_41_005: [ If twin_cache or payload is NULL, or size is 0, twin_cache_update shall return true without changing the cache; an update that is not a JSON object shall be newer and leave the cache as it is. ]
+    if ((twin_cache == NULL) || (payload == NULL) || (size == 0))
+    {
+        LogError("Invalid argument twin_cache=%p, payload=%p, size=%lu", twin_cache, payload, (unsigned long)size);
+        result = true;
+    }
+    else if (update_state == DEVICE_TWIN_UPDATE_COMPLETE)
+    {
+        result = update_complete_twin(twin_cache, payload, size);
+    }
+    else
+    {
+        result = update_desired_patch(twin_cache, payload, size);
+    }
+
+    return result;
+}
+
+const char* twin_cache_get_twin(TWIN_CACHE_HANDLE twin_cache)
+{
+    // Codes_SRS_TWIN_CACHE_41_010: [ twin_cache_get_twin shall return the cached twin, or NULL if twin_cache is NULL or the cache is empty. ]
+    return (twin_cache == NULL) ? NULL : twin_cache->twin;
+}
@@ -0,0 +1,342 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <string.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "parson.h"
+
+#include "internal/iothub_client_twin_fanout.h"
+
+#define RESULT_OK 0
+
+static const char* DESIRED_NAME = "desired";
+static const char* WILDCARD_SEGMENT = "*";
+
+typedef struct TWIN_FANOUT_SUBSCRIPTION_TAG
+{
+    char* path;         /*as subscribed, followed in the same allocation by segments*/
+    char* segments;     /*path with its dots replaced by '\0'*/
+    size_t segment_count;
+    IOTHUB_CLIENT_DESIRED_PROPERTY_CALLBACK callback;
+    void* userContextCallback;
+    struct TWIN_FANOUT_SUBSCRIPTION_TAG* next;
+} TWIN_FANOUT_SUBSCRIPTION;
+
+typedef struct TWIN_FANOUT_TAG
+{
+    TWIN_FANOUT_SUBSCRIPTION* subscriptions; /*in subscription order*/
+    size_t count;
+} TWIN_FANOUT;
+
+static void free_subscription(TWIN_FANOUT_SUBSCRIPTION* subscription)
+{
+    free(subscription->path);
+    free(subscription);
+}
+
+// A path is made of non-empty segments separated by single dots
+static size_t count_segments(const char* path)
+{
+    size_t result = 1;
+    const char* current;
+
+    if ((path[0] == '.') || (path[0] == '\0'))
+    {
+        result = 0;
+    }
+    else
+    {
+        for (current = path; *current != '\0'; current++)
+        {
+            if (*current == '.')
+            {
+                if ((current[1] == '.') || (current[1] == '\0'))
+                {
+                    result = 0;
+                    break;
+                }
+                result++;
+            }
+        }
+    }
+
+    return result;
+}
+
+static TWIN_FANOUT_SUBSCRIPTION** find_subscription_link(TWIN_FANOUT* twin_fanout, const char* path)
+{
+    TWIN_FANOUT_SUBSCRIPTION** result = &twin_fanout->subscriptions;
+
+    while ((*result != NULL) && (strcmp((*result)->path, path) != 0))
+    {
+        result = &(*result)->next;
+    }
+
+    return result;
+}
+
+static char* join_path(const char* path, const char* name)
+{
+    char* result;
+    size_t path_length = (path == NULL) ? 0 : strlen(path);
+    size_t name_length = strlen(name);
+
+    if ((result = (char*)malloc(path_length + 1 + name_length + 1)) == NULL)
+    {
+        LogError("Failed allocating the path of property %s", name);
+    }
+    else if (path == NULL)
+    {
+        (void)memcpy(result, name, name_length + 1);
+    }
+    else
+    {
+        (void)memcpy(result, path, path_length);
+        result[path_length] = '.';
+        (void)memcpy(result + path_length + 1, name, name_length + 1);
+    }
+
+    return result;
+}
+
+static void report_property(const TWIN_FANOUT_SUBSCRIPTION* subscription, DEVICE_TWIN_UPDATE_STATE update_state, const char* path, const JSON_Value* value)
+{
+    char* json = json_serialize_to_string(value);
+
+    if (json == NULL)
+    {
+        LogError("Failed serializing property %s", path);
+    }
+    else
+    {
+        /*Codes_SRS_TWIN_FANOUT_41_011: [ For every property found, twin_fanout_dispatch shall call the callback of the subscription with update_state, the path of the property, its wildcards replaced by member names, and the serialized property. ]*/
+        subscription->callback(update_state, path, (const unsigned char*)json, strlen(json), subscription->userContextCallback);
+        json_free_serialized_string(json);
+    }
+}
+
+static void find_properties(const TWIN_FANOUT_SUBSCRIPTION* subscription, DEVICE_TWIN_UPDATE_STATE update_state, const JSON_Value* value, const char* segment, size_t remaining_segments, const char* path)
+{
+    if (remaining_segments == 0)
+    {
+        report_property(subscription, update_state, path, value);
+    }
+    else if (json_value_get_type(value) == JSONObject)
+    {
+        JSON_Object* object = json_value_get_object(value);
+        const char* next_segment = segment + strlen(segment) + 1;
+
+        if (strcmp(segment, WILDCARD_SEGMENT) == 0)
+        {
+            /*Codes_SRS_TWIN_FANOUT_41_010: [ A `*` segment shall match every member of the object, in the order of the update, except the members whose name starts with `$`. ]*/
+            size_t count = json_object_get_count(object);
+            size_t index;
+
+            for (index = 0; index < count; index++)
+            {
+                const char* name = json_object_get_name(object, index);
+                if (name[0] != '$')
+                {
+                    char* member_path = join_path(path, name);
+                    if (member_path != NULL)
+                    {
+                        find_properties(subscription, update_state, json_object_get_value_at(object, index), next_segment, remaining_segments - 1, member_path);
+                        free(member_path);
+                    }
+                }
+            }
+        }
+        else
+        {
+            /*Codes_SRS_TWIN_FANOUT_41_009: [ A segment other than `*` shall match the member of that name, if the update holds one; the subscription shall not be called when a segment matches nothing. ]*/
+            JSON_Value* member = json_object_get_value(object, segment);
+            if (member != NULL)
+            {
+                char* member_path = join_path(path, segment);
+                if (member_path != NULL)
+                {
+                    find_properties(subscription, update_state, member, next_segment, remaining_segments - 1, member_path);
+                    free(member_path);
+                }
+            }
+        }
+    }
+}
+
+TWIN_FANOUT_HANDLE twin_fanout_create(void)
+{
+    TWIN_FANOUT* result;
+
+    /*Codes_SRS_TWIN_FANOUT_41_001: [ twin_fanout_create shall allocate a set of subscriptions, empty, and return it; it shall return NULL if allocating fails. ]*/
+    if ((result = (TWIN_FANOUT*)malloc(sizeof(TWIN_FANOUT))) == NULL)
+    {
+        LogError("Failed allocating the desired property subscriptions");
+    }
+    else
+    {
+        result->subscriptions = NULL;
+        result->count = 0;
+    }
+
+    return result;
+}
+
+void twin_fanout_destroy(TWIN_FANOUT_HANDLE twin_fanout)
+{
+    /*Codes_SRS_TWIN_FANOUT_41_002: [ twin_fanout_destroy shall free every subscription and the set; it shall do nothing if twin_fanout is NULL. ]*/
+    if (twin_fanout != NULL)
+    {
+        while (twin_fanout->subscriptions != NULL)
+        {
+            TWIN_FANOUT_SUBSCRIPTION* subscription = twin_fanout->subscriptions;
+            twin_fanout->subscriptions = subscription->next;
+            free_subscription(subscription);
+        }
+        free(twin_fanout);
+    }
+}
+
+int twin_fanout_set_callback(TWIN_FANOUT_HANDLE twin_fanout, const char* path, IOTHUB_CLIENT_DESIRED_PROPERTY_CALLBACK callback, void* userContextCallback)
+{
+    int result;
+    size_t segment_count;
+
+    /*Codes_SRS_TWIN_FANOUT_41_003: [ If twin_fanout or path is NULL, or path is empty, starts or ends with a dot or holds two dots in a row, twin_fanout_set_callback shall fail and return a non-zero value. ]*/
+    if ((twin_fanout == NULL) || (path == NULL) || ((segment_count = count_segments(path)) == 0))
+    {
+        LogError("Invalid argument twin_fanout=%p, path=%s", twin_fanout, (path == NULL) ? "NULL" : path);
+        result = __FAILURE__;
+    }
+    else
+    {
+        TWIN_FANOUT_SUBSCRIPTION** link = find_subscription_link(twin_fanout, path);
+        TWIN_FANOUT_SUBSCRIPTION* subscription = *link;
+
+        if (callback == NULL)
+        {
+            if (subscription == NULL)
+            {
+                /*Codes_SRS_TWIN_FANOUT_41_005: [ If callback is NULL, twin_fanout_set_callback shall remove the subscription of path and return 0, or fail and return a non-zero value if there is none. ]*/
+                LogError("No desired property subscription for %s", path);
+                result = __FAILURE__;
+            }
+            else
+            {
+                *link = subscription->next;
+                free_subscription(subscription);
+                twin_fanout->count--;
+                result = RESULT_OK;
+            }
+        }
+        else if (subscription != NULL)
+        {
+            /*Codes_SRS_TWIN_FANOUT_41_004: [ twin_fanout_set_callback shall store callback and userContextCallback for path, after the existing subscriptions or in place of the one of the same path, and return 0; if allocating fails it shall return a non-zero value. ]*/
+            subscription->callback = callback;
+            subscription->userContextCallback = userContextCallback;
+            result = RESULT_OK;
+        }
+        else if ((subscription = (TWIN_FANOUT_SUBSCRIPTION*)malloc(sizeof(TWIN_FANOUT_SUBSCRIPTION))) == NULL)
+        {
+            LogError("Failed allocating the desired property subscription for %s", path);
+            result = __FAILURE__;
+        }
+        else
+        {
+            size_t path_size = strlen(path) + 1;
+
+            if ((subscription->path = (char*)malloc(2 * path_size)) == NULL)
+            {
+                LogError("Failed copying the path %s", path);
+                free(subscription);
+                result = __FAILURE__;
+            }
+            else
+            {
+                char* current;
+
+                (void)memcpy(subscription->path, path, path_size);
+                subscription->segments = subscription->path + path_size;
+                (void)memcpy(subscription->segments, path, path_size);
+                for (current = subscription->segments; *current != '\0'; current++)
+                {
+                    if (*current == '.')
+                    {
+                        *current = '\0';
+                    }
+                }
+
+                subscription->segment_count = segment_count;
+                subscription->callback = callback;
+                subscription->userContextCallback = userContextCallback;
+                subscription->next = NULL;
+                *link = subscription;
+                twin_fanout->count++;
+                result = RESULT_OK;
+            }
+        }
+    }
+
+    return result;
+}
+
+size_t twin_fanout_get_count(TWIN_FANOUT_HANDLE twin_fanout)
+{
+    /*Codes_SRS_TWIN_FANOUT_41_006: [ twin_fanout_get_count shall return the number of subscriptions, or 0 if twin_fanout is NULL. ]*/
+    return (twin_fanout == NULL) ? 0 : twin_fanout->count;
+}
+
+void twin_fanout_dispatch(TWIN_FANOUT_HANDLE twin_fanout, DEVICE_TWIN_UPDATE_STATE update_state, const unsigned char* payload, size_t size)
+{
+    /*Codes_SRS_TWIN_FANOUT_41_007: [ If twin_fanout or payload is NULL, or there is no subscription, twin_fanout_dispatch shall do nothing. ]*/
+    if ((twin_fanout != NULL) && (payload != NULL) && (twin_fanout->subscriptions != NULL))
+    {
+        /*Codes_SRS_TWIN_FANOUT_41_008: [ twin_fanout_dispatch shall parse payload once for all the subscriptions, and do nothing if it is not a JSON object or allocating fails. ]*/
+        char* json = (char*)malloc(size + 1);
+
+        if (json == NULL)
+        {
+            LogError("Failed allocating the twin copy");
+        }
+        else
+        {
+            JSON_Value* root;
+
+            (void)memcpy(json, payload, size);
+            json[size] = '\0';
+
+            if ((root = json_parse_string(json)) == NULL)
+            {
+                LogError("Twin is not valid JSON");
+            }
+            else
+            {
+                if (json_value_get_type(root) != JSONObject)
+                {
+                    LogError("Twin is not a JSON object");
+                }
+                else
+                {
+                    const TWIN_FANOUT_SUBSCRIPTION* subscription;
+
+                    for (subscription = twin_fanout->subscriptions; subscription != NULL; subscription = subscription->next)
+                    {
+                        if (update_state == DEVICE_TWIN_UPDATE_COMPLETE)
+                        {
+                            find_properties(subscription, update_state, root, subscription->segments, subscription->segment_count, NULL);
+                        }
+                        /*Codes_SRS_TWIN_FANOUT_41_012: [ A DEVICE_TWIN_UPDATE_PARTIAL payload shall be matched as the `desired` object of the twin; only the paths starting with `desired` can match it. ]*/
+                        else if (strcmp(subscription->segments, DESIRED_NAME) == 0)
+                        {
+                            find_properties(subscription, update_state, root, subscription->segments + strlen(DESIRED_NAME) + 1, subscription->segment_count - 1, DESIRED_NAME);
+                        }
+                    }
+                }
+                json_value_free(root);
+            }
+            free(json);
+        }
+    }
+}
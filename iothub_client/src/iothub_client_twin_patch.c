@@ -0,0 +1,144 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <string.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "parson.h"
+
+#include "internal/iothub_client_twin_patch.h"
+
+#define RESULT_OK 0
+
+static JSON_Value* parse_patch(const unsigned char* patch, size_t size)
+{
+    JSON_Value* result;
+    char* json = (char*)malloc(size + 1);
+
+    if (json == NULL)
+    {
+        LogError("Failed allocating the reported state copy");
+        result = NULL;
+    }
+    else
+    {
+        (void)memcpy(json, patch, size);
+        json[size] = '\0';
+
+        if ((result = json_parse_string(json)) == NULL)
+        {
+            LogError("Reported state is not valid JSON");
+        }
+        else if (json_value_get_type(result) != JSONObject)
+        {
+            LogError("Reported state is not a JSON object");
+            json_value_free(result);
+            result = NULL;
+        }
+        free(json);
+    }
+
+    return result;
+}
+
+static int merge_object(JSON_Object* target, const JSON_Object* source)
+{
+    int result = RESULT_OK;
+    size_t count = json_object_get_count(source);
+    size_t index;
+
+    for (index = 0; index < count && result == RESULT_OK; index++)
+    {
+        const char* name = json_object_get_name(source, index);
+        JSON_Value* value = json_object_get_value_at(source, index);
+        JSON_Object* target_member = json_object_get_object(target, name);
+
+        /* Codes_SRS_TWIN_PATCH_41_002: [ Two objects with the same name shall be merged member by member; any other member of next_patch shall replace the member of patch with the same name, a null member included. ] */
+        if (target_member != NULL && json_value_get_type(value) == JSONObject)
+        {
+            result = merge_object(target_member, json_value_get_object(value));
+        }
+        else
+        {
+            JSON_Value* copy = json_value_deep_copy(value);
+            if (copy == NULL)
+            {
+                LogError("Failed copying reported property %s", name);
+                result = __FAILURE__;
+            }
+            else if (json_object_set_value(target, name, copy) != JSONSuccess)
+            {
+                LogError("Failed setting reported property %s", name);
+                json_value_free(copy);
+                result = __FAILURE__;
+            }
+        }
+    }
+
+    return result;
+}
+
+CONSTBUFFER_HANDLE twin_patch_merge(CONSTBUFFER_HANDLE patch, const unsigned char* next_patch, size_t next_size)
+{
+    CONSTBUFFER_HANDLE result;
+    const CONSTBUFFER* content;
+
+    /* Codes_SRS_TWIN_PATCH_41_001: [ If patch or next_patch are NULL, or next_size is 0, twin_patch_merge shall fail and return NULL. ] */
+    if (patch == NULL || next_patch == NULL || next_size == 0)
+    {
+        LogError("Invalid argument patch=%p, next_patch=%p, next_size=%lu", patch, next_patch, (unsigned long)next_size);
+        result = NULL;
+    }
+    else if ((content = CONSTBUFFER_GetContent(patch)) == NULL)
+    {
+        LogError("Failed retrieving the reported state content");
+        result = NULL;
+    }
+    else
+    {
+        JSON_Value* merged;
+        JSON_Value* next;
+
+        /* Codes_SRS_TWIN_PATCH_41_003: [ If either patch is not a JSON object, twin_patch_merge shall fail and return NULL. ] */
+        if ((merged = parse_patch(content->buffer, content->size)) == NULL)
+        {
+            result = NULL;
+        }
+        else
+        {
+            if ((next = parse_patch(next_patch, next_size)) == NULL)
+            {
+                result = NULL;
+            }
+            else
+            {
+                char* serialized;
+
+                if (merge_object(json_value_get_object(merged), json_value_get_object(next)) != RESULT_OK)
+                {
+                    result = NULL;
+                }
+                else if ((serialized = json_serialize_to_string(merged)) == NULL)
+                {
+                    LogError("Failed serializing the merged reported state");
+                    result = NULL;
+                }
+                else
+                {
+                    /* Codes_SRS_TWIN_PATCH_41_004: [ Otherwise twin_patch_merge shall return a new CONSTBUFFER_HANDLE holding the merged JSON object, leaving patch untouched. ] */
+                    if ((result = CONSTBUFFER_Create((const unsigned char*)serialized, strlen(serialized))) == NULL)
+                    {
+                        LogError("Failed allocating the merged reported state");
+                    }
+                    json_free_serialized_string(serialized);
+                }
+                json_value_free(next);
+            }
+            json_value_free(merged);
+        }
+    }
+
+    return result;
+}
@@ -0,0 +1,427 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/doublylinkedlist.h"
+#include "azure_c_shared_utility/tickcounter.h"
+
+#include "iothub_client_worker_pool.h"
+
+#define WORKER_POOL_MAX_IDLE_SLEEP_MS 10
+
+struct IOTHUB_CLIENT_WORKER_POOL_TAG;
+
+typedef struct WORKER_POOL_SHARD_TAG
+{
+    struct IOTHUB_CLIENT_WORKER_POOL_TAG* pool;
+    size_t index;
+    THREAD_HANDLE threadHandle;
+    LOCK_HANDLE lockHandle;
+    DLIST_ENTRY readyItems; /*IOTHUB_CLIENT_WORKER_POOL_ITEMs not currently running, earliest nextRunTime first*/
+    size_t itemCount; /*ready and running items owned by this shard*/
+} WORKER_POOL_SHARD;
+
+typedef struct IOTHUB_CLIENT_WORKER_POOL_ITEM_TAG
+{
+    DLIST_ENTRY entry;
+    WORKER_POOL_SHARD* shard;
+    IOTHUB_CLIENT_WORKER_POOL_DO_WORK doWork;
+    void* context;
+    tickcounter_ms_t nextRunTime;
+    int running;
+    int removed;
+    int woken; /*IoTHubClientWorkerPool_Wake was called while doWork was running*/
+} IOTHUB_CLIENT_WORKER_POOL_ITEM;
+
+typedef struct IOTHUB_CLIENT_WORKER_POOL_TAG
+{
+    WORKER_POOL_SHARD* shards;
+    size_t shardCount;
+    TICK_COUNTER_HANDLE tickCounter;
+    sig_atomic_t stopThreads;
+} IOTHUB_CLIENT_WORKER_POOL;
+
+/* Used for Unit test */
+const size_t IoTHubClientWorkerPool_ThreadTerminationOffset = offsetof(IOTHUB_CLIENT_WORKER_POOL, stopThreads);
+
+static tickcounter_ms_t get_current_ms(IOTHUB_CLIENT_WORKER_POOL* pool)
+{
+    tickcounter_ms_t result;
+    if (tickcounter_get_current_ms(pool->tickCounter, &result) != 0)
+    {
+        LogError("tickcounter_get_current_ms failed");
+        result = 0;
+    }
+    return result;
+}
+
+/*must be called with the shard lock held*/
+static void insert_ready_item(WORKER_POOL_SHARD* shard, IOTHUB_CLIENT_WORKER_POOL_ITEM* item)
+{
+    /*items are almost always re-inserted with the largest deadline, so search from the tail*/
+    PDLIST_ENTRY insertAfter = shard->readyItems.Blink;
+    while (insertAfter != &shard->readyItems)
+    {
+        IOTHUB_CLIENT_WORKER_POOL_ITEM* other = containingRecord(insertAfter, IOTHUB_CLIENT_WORKER_POOL_ITEM, entry);
+        if (other->nextRunTime <= item->nextRunTime)
+        {
+            break;
+        }
+        insertAfter = insertAfter->Blink;
+    }
+    DList_InsertHeadList(insertAfter, &item->entry);
+}
+
+static IOTHUB_CLIENT_WORKER_POOL_ITEM* take_due_item(WORKER_POOL_SHARD* shard, tickcounter_ms_t now, tickcounter_ms_t* waitTime)
+{
+    IOTHUB_CLIENT_WORKER_POOL_ITEM* result = NULL;
+
+    if (Lock(shard->lockHandle) != LOCK_OK)
+    {
+        LogError("failed locking worker pool shard");
+    }
+    else
+    {
+        if (!DList_IsListEmpty(&shard->readyItems))
+        {
+            IOTHUB_CLIENT_WORKER_POOL_ITEM* head = containingRecord(shard->readyItems.Flink, IOTHUB_CLIENT_WORKER_POOL_ITEM, entry);
+            if (head->nextRunTime <= now)
+            {
+                (void)DList_RemoveEntryList(&head->entry);
+                head->running = 1;
+                result = head;
+            }
+            else if (waitTime != NULL && (head->nextRunTime - now) < *waitTime)
+            {
+                *waitTime = head->nextRunTime - now;
+            }
+        }
+        (void)Unlock(shard->lockHandle);
+    }
+
+    return result;
+}
+
+static void finish_item(IOTHUB_CLIENT_WORKER_POOL_ITEM* item, tickcounter_ms_t now, unsigned int interval_ms)
+{
+    WORKER_POOL_SHARD* shard = item->shard;
+
+    if (Lock(shard->lockHandle) != LOCK_OK)
+    {
+        LogError("failed locking worker pool shard, item will not be rescheduled");
+    }
+    else
+    {
+        item->running = 0;
+        if (!item->removed)
+        {
+            item->nextRunTime = item->woken ? now : now + interval_ms;
+            item->woken = 0;
+            insert_ready_item(shard, item);
+        }
+        (void)Unlock(shard->lockHandle);
+    }
+}
+
+static int worker_pool_thread(void* threadArgument)
+{
+    WORKER_POOL_SHARD* ownShard = (WORKER_POOL_SHARD*)threadArgument;
+    IOTHUB_CLIENT_WORKER_POOL* pool = ownShard->pool;
+
+    while (!pool->stopThreads)
+    {
+        tickcounter_ms_t now = get_current_ms(pool);
+        tickcounter_ms_t waitTime = WORKER_POOL_MAX_IDLE_SLEEP_MS;
+        IOTHUB_CLIENT_WORKER_POOL_ITEM* item = take_due_item(ownShard, now, &waitTime);
+
+        if (item == NULL)
+        {
+            /*nothing due locally: steal due work from the other shards, nearest neighbour first*/
+            size_t i;
+            for (i = 1; i < pool->shardCount && item == NULL; i++)
+            {
+                item = take_due_item(&pool->shards[(ownShard->index + i) % pool->shardCount], now, NULL);
+            }
+        }
+
+        if (item != NULL)
+        {
+            unsigned int interval_ms = item->doWork(item->context);
+            finish_item(item, get_current_ms(pool), interval_ms);
+        }
+        else
+        {
+            (void)ThreadAPI_Sleep((unsigned int)(waitTime == 0 ? 1 : waitTime));
+        }
+    }
+
+    ThreadAPI_Exit(0);
+    return 0;
+}
+
+static void stop_and_join_threads(IOTHUB_CLIENT_WORKER_POOL* pool, size_t startedThreads)
+{
+    size_t i;
+
+    pool->stopThreads = 1;
+    for (i = 0; i < startedThreads; i++)
+    {
+        int res;
+        if (ThreadAPI_Join(pool->shards[i].threadHandle, &res) != THREADAPI_OK)
+        {
+            LogError("ThreadAPI_Join failed for worker pool thread %lu", (unsigned long)i);
+        }
+    }
+}
+
+static void free_shards(IOTHUB_CLIENT_WORKER_POOL* pool, size_t initializedShards)
+{
+    size_t i;
+
+    for (i = 0; i < initializedShards; i++)
+    {
+        WORKER_POOL_SHARD* shard = &pool->shards[i];
+        if (!DList_IsListEmpty(&shard->readyItems) || shard->itemCount != 0)
+        {
+            LogError("worker pool destroyed while %lu item(s) are still registered", (unsigned long)shard->itemCount);
+            while (!DList_IsListEmpty(&shard->readyItems))
+            {
+                PDLIST_ENTRY entry = DList_RemoveHeadList(&shard->readyItems);
+                free(containingRecord(entry, IOTHUB_CLIENT_WORKER_POOL_ITEM, entry));
+            }
+        }
+        Lock_Deinit(shard->lockHandle);
+    }
+    free(pool->shards);
+}
+
+IOTHUB_CLIENT_WORKER_POOL_HANDLE IoTHubClientWorkerPool_Create(size_t thread_count)
+{
+    IOTHUB_CLIENT_WORKER_POOL* result;
+
+    if (thread_count == 0)
+    {
+        LogError("invalid argument thread_count (0)");
+        result = NULL;
+    }
+    else if ((result = (IOTHUB_CLIENT_WORKER_POOL*)malloc(sizeof(IOTHUB_CLIENT_WORKER_POOL))) == NULL)
+    {
+        LogError("failed allocating worker pool");
+    }
+    else
+    {
+        memset(result, 0, sizeof(IOTHUB_CLIENT_WORKER_POOL));
+
+        if ((result->tickCounter = tickcounter_create()) == NULL)
+        {
+            LogError("tickcounter_create failed");
+            free(result);
+            result = NULL;
+        }
+        else if ((result->shards = (WORKER_POOL_SHARD*)malloc(thread_count * sizeof(WORKER_POOL_SHARD))) == NULL)
+        {
+            LogError("failed allocating %lu worker pool shards", (unsigned long)thread_count);
+            tickcounter_destroy(result->tickCounter);
+            free(result);
+            result = NULL;
+        }
+        else
+        {
+            size_t initializedShards;
+            size_t startedThreads;
+
+            memset(result->shards, 0, thread_count * sizeof(WORKER_POOL_SHARD));
+            result->shardCount = thread_count;
+
+            for (initializedShards = 0; initializedShards < thread_count; initializedShards++)
+            {
+                WORKER_POOL_SHARD* shard = &result->shards[initializedShards];
+                shard->pool = result;
+                shard->index = initializedShards;
+                DList_InitializeListHead(&shard->readyItems);
+                if ((shard->lockHandle = Lock_Init()) == NULL)
+                {
+                    LogError("Lock_Init failed for worker pool shard %lu", (unsigned long)initializedShards);
+                    break;
+                }
+            }
+
+            startedThreads = 0;
+            if (initializedShards == thread_count)
+            {
+                for (; startedThreads < thread_count; startedThreads++)
+                {
+                    if (ThreadAPI_Create(&result->shards[startedThreads].threadHandle, worker_pool_thread, &result->shards[startedThreads]) != THREADAPI_OK)
+                    {
+                        LogError("ThreadAPI_Create failed for worker pool thread %lu", (unsigned long)startedThreads);
+                        break;
+                    }
+                }
+            }
+
+            if (startedThreads != thread_count)
+            {
+                stop_and_join_threads(result, startedThreads);
+                free_shards(result, initializedShards);
+                tickcounter_destroy(result->tickCounter);
+                free(result);
+                result = NULL;
+            }
+        }
+    }
+
+    return result;
+}
+
+void IoTHubClientWorkerPool_Destroy(IOTHUB_CLIENT_WORKER_POOL_HANDLE workerPoolHandle)
+{
+    if (workerPoolHandle == NULL)
+    {
+        LogError("invalid argument workerPoolHandle (NULL)");
+    }
+    else
+    {
+        stop_and_join_threads(workerPoolHandle, workerPoolHandle->shardCount);
+        free_shards(workerPoolHandle, workerPoolHandle->shardCount);
+        tickcounter_destroy(workerPoolHandle->tickCounter);
+        free(workerPoolHandle);
+    }
+}
+
+IOTHUB_CLIENT_WORKER_POOL_ITEM_HANDLE IoTHubClientWorkerPool_Add(IOTHUB_CLIENT_WORKER_POOL_HANDLE workerPoolHandle, IOTHUB_CLIENT_WORKER_POOL_DO_WORK doWork, void* context)
+{
+    IOTHUB_CLIENT_WORKER_POOL_ITEM* result;
+
+    if (workerPoolHandle == NULL || doWork == NULL)
+    {
+        LogError("invalid argument (workerPoolHandle=%p, doWork=%p)", workerPoolHandle, doWork);
+        result = NULL;
+    }
+    else if ((result = (IOTHUB_CLIENT_WORKER_POOL_ITEM*)malloc(sizeof(IOTHUB_CLIENT_WORKER_POOL_ITEM))) == NULL)
+    {
+        LogError("failed allocating worker pool item");
+    }
+    else
+    {
+        /*itemCount is only a placement hint, a stale read just makes the shards slightly less even*/
+        WORKER_POOL_SHARD* shard = &workerPoolHandle->shards[0];
+        size_t i;
+        for (i = 1; i < workerPoolHandle->shardCount; i++)
+        {
+            if (workerPoolHandle->shards[i].itemCount < shard->itemCount)
+            {
+                shard = &workerPoolHandle->shards[i];
+            }
+        }
+
+        result->shard = shard;
+        result->doWork = doWork;
+        result->context = context;
+        result->running = 0;
+        result->removed = 0;
+        result->woken = 0;
+        result->nextRunTime = get_current_ms(workerPoolHandle);
+
+        if (Lock(shard->lockHandle) != LOCK_OK)
+        {
+            LogError("failed locking worker pool shard");
+            free(result);
+            result = NULL;
+        }
+        else
+        {
+            insert_ready_item(shard, result);
+            shard->itemCount++;
+            (void)Unlock(shard->lockHandle);
+        }
+    }
+
+    return result;
+}
+
+void IoTHubClientWorkerPool_Remove(IOTHUB_CLIENT_WORKER_POOL_HANDLE workerPoolHandle, IOTHUB_CLIENT_WORKER_POOL_ITEM_HANDLE itemHandle)
+{
+    if (workerPoolHandle == NULL || itemHandle == NULL)
+    {
+        LogError("invalid argument (workerPoolHandle=%p, itemHandle=%p)", workerPoolHandle, itemHandle);
+    }
+    else
+    {
+        WORKER_POOL_SHARD* shard = itemHandle->shard;
+        int done = 0;
+
+        while (!done)
+        {
+            if (Lock(shard->lockHandle) != LOCK_OK)
+            {
+                LogError("failed locking worker pool shard");
+            }
+            else
+            {
+                if (!itemHandle->running)
+                {
+                    if (!itemHandle->removed)
+                    {
+                        (void)DList_RemoveEntryList(&itemHandle->entry);
+                    }
+                    shard->itemCount--;
+                    done = 1;
+                }
+                else
+                {
+                    /*a pool thread is inside doWork, finish_item will not re-queue it*/
+                    itemHandle->removed = 1;
+                }
+                (void)Unlock(shard->lockHandle);
+            }
+
+            if (!done)
+            {
+                (void)ThreadAPI_Sleep(1);
+            }
+        }
+
+        free(itemHandle);
+    }
+}
+
+void IoTHubClientWorkerPool_Wake(IOTHUB_CLIENT_WORKER_POOL_HANDLE workerPoolHandle, IOTHUB_CLIENT_WORKER_POOL_ITEM_HANDLE itemHandle)
+{
+    if (workerPoolHandle == NULL || itemHandle == NULL)
+    {
+        LogError("invalid argument (workerPoolHandle=%p, itemHandle=%p)", workerPoolHandle, itemHandle);
+    }
+    else
+    {
+        WORKER_POOL_SHARD* shard = itemHandle->shard;
+        tickcounter_ms_t now = get_current_ms(workerPoolHandle);
+
+        if (Lock(shard->lockHandle) != LOCK_OK)
+        {
+            LogError("failed locking worker pool shard");
+        }
+        else
+        {
+            if (itemHandle->running)
+            {
+                itemHandle->woken = 1;
+            }
+            else if (itemHandle->nextRunTime > now)
+            {
+                (void)DList_RemoveEntryList(&itemHandle->entry);
+                itemHandle->nextRunTime = now;
+                insert_ready_item(shard, itemHandle);
+            }
+            (void)Unlock(shard->lockHandle);
+        }
+    }
+}
@@ -2,12 +2,18 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
 #include "azure_c_shared_utility/optimize_size.h"
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/xlogging.h"
-#include "azure_c_shared_utility/buffer_.h"
+#include "azure_c_shared_utility/constbuffer.h"
+#include "azure_c_shared_utility/refcount.h"
 
 #include "iothub_message.h"
+#ifdef USE_PAYLOAD_COMPRESSION
+#include "internal/iothub_client_gzip.h"
+#endif
 
 DEFINE_ENUM_STRINGS(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_RESULT_VALUES);
 DEFINE_ENUM_STRINGS(IOTHUBMESSAGE_CONTENT_TYPE, IOTHUBMESSAGE_CONTENT_TYPE_VALUES);
@@ -15,15 +21,63 @@ DEFINE_ENUM_STRINGS(IOTHUBMESSAGE_CONTENT_TYPE, IOTHUBMESSAGE_CONTENT_TYPE_VALUE
 #define LOG_IOTHUB_MESSAGE_ERROR() \
     LogError("(result = %s)", ENUM_TO_STRING(IOTHUB_MESSAGE_RESULT, result));
 
+#define INLINE_PROPERTY_COUNT           5 /*most messages carry a handful of properties, beyond that they move to a MAP_HANDLE*/
+#define PROPERTY_ARENA_MINIMUM_SIZE     64
+
+typedef struct INLINE_PROPERTIES_TAG
+{
+    size_t count;
+    const char* keys[INLINE_PROPERTY_COUNT];
+    const char* values[INLINE_PROPERTY_COUNT];
+    char* arena; /*all keys and values, NUL terminated, in a single allocation*/
+    size_t arena_used;
+    size_t arena_size;
+} INLINE_PROPERTIES;
+
+/*bytes owned by the caller of IoTHubMessage_CreateFromByteArrayNoCopy, shared by the message and all its clones*/
+typedef struct BORROWED_PAYLOAD_TAG
+{
+    const unsigned char* buffer;
+    size_t size;
+    IOTHUB_MESSAGE_RELEASE_CALLBACK releaseCallback;
+    void* releaseContext;
+} BORROWED_PAYLOAD;
+
+DEFINE_REFCOUNT_TYPE(BORROWED_PAYLOAD);
+
+/*properties checked and copied once, shared by every message that refers to them*/
+typedef struct IOTHUB_MESSAGE_PROPERTY_SET_TAG
+{
+    size_t count;
+    const char** keys; /*the keys and values arrays and all their text, in a single allocation*/
+    const char** values;
+} IOTHUB_MESSAGE_PROPERTY_SET;
+
+DEFINE_REFCOUNT_TYPE(IOTHUB_MESSAGE_PROPERTY_SET);
+
+#define DIAGNOSTIC_ID_MAX_LENGTH                    32 /*the SDK generates 8 characters*/
+#define DIAGNOSTIC_CREATION_TIME_UTC_MAX_LENGTH     32 /*the SDK writes the epoch time in decimal, at most 20 digits*/
+
+/*diagnostic data is copied into the message itself, so sampled messages cost no extra allocations*/
+typedef struct INLINE_DIAGNOSTIC_DATA_TAG
+{
+    IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DATA data; /*points into the buffers below once set*/
+    char diagnosticId[DIAGNOSTIC_ID_MAX_LENGTH + 1];
+    char diagnosticCreationTimeUtc[DIAGNOSTIC_CREATION_TIME_UTC_MAX_LENGTH + 1];
+} INLINE_DIAGNOSTIC_DATA;
+
 typedef struct IOTHUB_MESSAGE_HANDLE_DATA_TAG
 {
     IOTHUBMESSAGE_CONTENT_TYPE contentType;
     union
     {
-        BUFFER_HANDLE byteArray;
+        CONSTBUFFER_HANDLE byteArray; /*immutable, shared by the message and all its clones*/
         STRING_HANDLE string;
     } value;
-    MAP_HANDLE properties;
+    BORROWED_PAYLOAD* borrowedPayload; /*replaces value.byteArray when the bytes belong to the caller*/
+    INLINE_PROPERTIES inline_properties;
+    MAP_HANDLE properties; /*NULL while the properties fit in inline_properties, then it holds all of them*/
+    IOTHUB_MESSAGE_PROPERTY_SET* property_set; /*when not NULL it holds the properties, inline_properties and properties are empty*/
     char* messageId;
     char* correlationId;
     char* userDefinedContentType;
@@ -32,23 +86,48 @@ typedef struct IOTHUB_MESSAGE_HANDLE_DATA_TAG
     char* inputName;
     char* connectionModuleId;
     char* connectionDeviceId;
-    IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DATA_HANDLE diagnosticData;
+    INLINE_DIAGNOSTIC_DATA diagnosticData; /*diagnosticData.data.diagnosticId is NULL while not set*/
 }IOTHUB_MESSAGE_HANDLE_DATA;
 
+#define US_ASCII_WORD_ONES      ((size_t)-1 / 0xFF) /*0x01 in every byte of a size_t*/
+#define US_ASCII_WORD_HIGH_BITS (US_ASCII_WORD_ONES * 0x80)
+
 static bool ContainsOnlyUsAscii(const char* asciiValue)
 {
     bool result = true;
-    const char* iterator = asciiValue;
-    while (iterator != NULL && *iterator != '\0')
+
+    if (asciiValue != NULL)
     {
-        // Allow only printable ascii char
-        if (*iterator < ' ' || *iterator > '~')
+        const unsigned char* iterator = (const unsigned char*)asciiValue;
+        size_t length = strlen(asciiValue);
+
+        /*a size_t at a time: the first term sets the high bit of a byte when some byte is below ' ', the second when some
+        byte is above '~' (the "hasless" and "hasmore" tricks), so a word of printable characters leaves all high bits clear*/
+        while (length >= sizeof(size_t))
         {
-            result = false;
-            break;
+            size_t word;
+            (void)memcpy(&word, iterator, sizeof(word));
+            if (((((word - US_ASCII_WORD_ONES * ' ') & ~word) | ((word + US_ASCII_WORD_ONES * (0x7F - '~')) | word)) & US_ASCII_WORD_HIGH_BITS) != 0)
+            {
+                result = false;
+                break;
+            }
+            iterator += sizeof(word);
+            length -= sizeof(word);
+        }
+
+        while (result && length > 0)
+        {
+            // Allow only printable ascii char
+            if (*iterator < ' ' || *iterator > '~')
+            {
+                result = false;
+            }
+            iterator++;
+            length--;
         }
-        iterator++;
     }
+
     return result;
 }
 
@@ -67,78 +146,348 @@ static int ValidateAsciiCharactersFilter(const char* mapKey, const char* mapValu
     return result;
 }
 
-static void DestroyDiagnosticPropertyData(IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DATA_HANDLE diagnosticHandle)
+static int find_inline_property(const INLINE_PROPERTIES* properties, const char* key, size_t* index)
 {
-    if (diagnosticHandle != NULL)
+    int result = __FAILURE__;
+    size_t i;
+
+    for (i = 0; i < properties->count; i++)
     {
-        free(diagnosticHandle->diagnosticId);
-        free(diagnosticHandle->diagnosticCreationTimeUtc);
+        if (strcmp(properties->keys[i], key) == 0)
+        {
+            *index = i;
+            result = 0;
+            break;
+        }
     }
-    free(diagnosticHandle);
+
+    return result;
 }
 
-static void DestroyMessageData(IOTHUB_MESSAGE_HANDLE_DATA* handleData)
+/*makes room for extra_size more bytes; the arena is rebuilt without the values overwritten since, and the previous one is handed back
+to the caller to free once it copied its key and value in, as those may point into it*/
+static int reserve_property_arena(INLINE_PROPERTIES* properties, size_t extra_size, char** previous_arena)
 {
-    if (handleData->contentType == IOTHUBMESSAGE_BYTEARRAY)
+    int result;
+
+    *previous_arena = NULL;
+
+    if (properties->arena_used + extra_size <= properties->arena_size)
     {
-        BUFFER_delete(handleData->value.byteArray);
+        result = 0;
     }
-    else if (handleData->contentType == IOTHUBMESSAGE_STRING)
+    else
     {
-        STRING_delete(handleData->value.string);
+        size_t live_size = 0;
+        size_t new_size;
+        char* new_arena;
+        size_t i;
+
+        for (i = 0; i < properties->count; i++)
+        {
+            live_size += strlen(properties->keys[i]) + strlen(properties->values[i]) + 2;
+        }
+
+        new_size = (live_size + extra_size) * 2;
+        if (new_size < PROPERTY_ARENA_MINIMUM_SIZE)
+        {
+            new_size = PROPERTY_ARENA_MINIMUM_SIZE;
+        }
+
+        if ((new_arena = (char*)malloc(new_size)) == NULL)
+        {
+            LogError("unable to allocate %lu bytes for the message properties", (unsigned long)new_size);
+            result = __FAILURE__;
+        }
+        else
+        {
+            size_t used = 0;
+
+            for (i = 0; i < properties->count; i++)
+            {
+                size_t key_size = strlen(properties->keys[i]) + 1;
+                size_t value_size = strlen(properties->values[i]) + 1;
+
+                (void)memcpy(new_arena + used, properties->keys[i], key_size);
+                properties->keys[i] = new_arena + used;
+                used += key_size;
+                (void)memcpy(new_arena + used, properties->values[i], value_size);
+                properties->values[i] = new_arena + used;
+                used += value_size;
+            }
+
+            *previous_arena = properties->arena;
+            properties->arena = new_arena;
+            properties->arena_used = used;
+            properties->arena_size = new_size;
+            result = 0;
+        }
     }
 
-    Map_Destroy(handleData->properties);
-    free(handleData->messageId);
-    handleData->messageId = NULL;
-    free(handleData->correlationId);
-    handleData->correlationId = NULL;
-    free(handleData->userDefinedContentType);
-    free(handleData->contentEncoding);
-    DestroyDiagnosticPropertyData(handleData->diagnosticData);
-    free(handleData->outputName);
-    free(handleData->inputName);
-    free(handleData->connectionModuleId);
-    free(handleData->connectionDeviceId);
-    free(handleData);
+    return result;
 }
 
-static IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DATA_HANDLE CloneDiagnosticPropertyData(const IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DATA* source)
+static const char* append_to_property_arena(INLINE_PROPERTIES* properties, const char* text, size_t size)
 {
-    IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DATA_HANDLE result = NULL;
-    if (source == NULL)
+    char* result = properties->arena + properties->arena_used;
+    (void)memcpy(result, text, size);
+    properties->arena_used += size;
+    return result;
+}
+
+static int set_inline_property(INLINE_PROPERTIES* properties, const char* key, const char* value)
+{
+    int result;
+    size_t index;
+    size_t value_size = strlen(value) + 1;
+    bool exists = (find_inline_property(properties, key, &index) == 0);
+
+    if (exists && strlen(properties->values[index]) + 1 >= value_size)
     {
-        LogError("Invalid argument - source is NULL");
+        /*the new value fits where the old one was*/
+        (void)memmove((char*)properties->values[index], value, value_size);
+        result = 0;
     }
     else
     {
-        result = (IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DATA_HANDLE)malloc(sizeof(IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DATA));
-        if (result == NULL)
+        size_t key_size = exists ? 0 : strlen(key) + 1;
+        char* previous_arena;
+
+        if (reserve_property_arena(properties, key_size + value_size, &previous_arena) != 0)
         {
-            LogError("malloc failed");
+            result = __FAILURE__;
         }
         else
         {
-            result->diagnosticCreationTimeUtc = NULL;
-            result->diagnosticId = NULL;
-            if (source->diagnosticCreationTimeUtc != NULL && mallocAndStrcpy_s(&result->diagnosticCreationTimeUtc, source->diagnosticCreationTimeUtc) != 0)
+            if (exists)
             {
-                LogError("mallocAndStrcpy_s for diagnosticCreationTimeUtc failed");
-                free(result);
-                result = NULL;
+                properties->values[index] = append_to_property_arena(properties, value, value_size);
             }
-            else if (source->diagnosticId != NULL && mallocAndStrcpy_s(&result->diagnosticId, source->diagnosticId) != 0)
+            else
             {
-                LogError("mallocAndStrcpy_s for diagnosticId failed");
-                free(result->diagnosticCreationTimeUtc);
-                free(result);
-                result = NULL;
+                properties->keys[properties->count] = append_to_property_arena(properties, key, key_size);
+                properties->values[properties->count] = append_to_property_arena(properties, value, value_size);
+                properties->count++;
             }
+
+            free(previous_arena);
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+static int clone_inline_properties(INLINE_PROPERTIES* destination, const INLINE_PROPERTIES* source)
+{
+    int result;
+
+    if (source->arena == NULL)
+    {
+        result = 0;
+    }
+    else if ((destination->arena = (char*)malloc(source->arena_used)) == NULL)
+    {
+        LogError("unable to allocate %lu bytes for the message properties", (unsigned long)source->arena_used);
+        result = __FAILURE__;
+    }
+    else
+    {
+        size_t i;
+
+        (void)memcpy(destination->arena, source->arena, source->arena_used);
+        for (i = 0; i < source->count; i++)
+        {
+            destination->keys[i] = destination->arena + (source->keys[i] - source->arena);
+            destination->values[i] = destination->arena + (source->values[i] - source->arena);
         }
+        destination->count = source->count;
+        destination->arena_used = source->arena_used;
+        destination->arena_size = source->arena_used;
+        result = 0;
     }
+
     return result;
 }
 
+/*once the map exists it holds all the properties; IoTHubMessage_Properties hands it out for the caller to change*/
+static int move_properties_to_map(IOTHUB_MESSAGE_HANDLE_DATA* handleData)
+{
+    int result;
+    MAP_HANDLE properties;
+
+    if ((properties = Map_Create(ValidateAsciiCharactersFilter)) == NULL)
+    {
+        LogError("Map_Create for properties failed");
+        result = __FAILURE__;
+    }
+    else
+    {
+        size_t i;
+
+        result = 0;
+        for (i = 0; i < handleData->inline_properties.count; i++)
+        {
+            if (Map_AddOrUpdate(properties, handleData->inline_properties.keys[i], handleData->inline_properties.values[i]) != MAP_OK)
+            {
+                LogError("Failure adding property to internal map");
+                result = __FAILURE__;
+                break;
+            }
+        }
+
+        if (result != 0)
+        {
+            Map_Destroy(properties);
+        }
+        else
+        {
+            free(handleData->inline_properties.arena);
+            memset(&handleData->inline_properties, 0, sizeof(handleData->inline_properties));
+            handleData->properties = properties;
+        }
+    }
+
+    return result;
+}
+
+static void release_property_set(IOTHUB_MESSAGE_PROPERTY_SET* property_set)
+{
+    if (DEC_REF(IOTHUB_MESSAGE_PROPERTY_SET, property_set) == DEC_RETURN_ZERO)
+    {
+        free((void*)property_set->keys);
+        free(property_set);
+    }
+}
+
+/*gives the message its own copy of the properties of its property set, before they change*/
+static int copy_properties_from_set(IOTHUB_MESSAGE_HANDLE_DATA* handleData)
+{
+    int result = 0;
+    const IOTHUB_MESSAGE_PROPERTY_SET* property_set = handleData->property_set;
+    size_t i;
+
+    if (property_set->count > INLINE_PROPERTY_COUNT)
+    {
+        MAP_HANDLE properties;
+
+        if ((properties = Map_Create(ValidateAsciiCharactersFilter)) == NULL)
+        {
+            LogError("Map_Create for properties failed");
+            result = __FAILURE__;
+        }
+        else
+        {
+            for (i = 0; i < property_set->count; i++)
+            {
+                if (Map_AddOrUpdate(properties, property_set->keys[i], property_set->values[i]) != MAP_OK)
+                {
+                    LogError("Failure adding property to internal map");
+                    result = __FAILURE__;
+                    break;
+                }
+            }
+
+            if (result != 0)
+            {
+                Map_Destroy(properties);
+            }
+            else
+            {
+                handleData->properties = properties;
+            }
+        }
+    }
+    else
+    {
+        for (i = 0; i < property_set->count; i++)
+        {
+            if (set_inline_property(&handleData->inline_properties, property_set->keys[i], property_set->values[i]) != 0)
+            {
+                LogError("Failure adding property to the message");
+                result = __FAILURE__;
+                break;
+            }
+        }
+
+        if (result != 0)
+        {
+            free(handleData->inline_properties.arena);
+            memset(&handleData->inline_properties, 0, sizeof(handleData->inline_properties));
+        }
+    }
+
+    if (result == 0)
+    {
+        release_property_set(handleData->property_set);
+        handleData->property_set = NULL;
+    }
+
+    return result;
+}
+
+static void release_borrowed_payload(BORROWED_PAYLOAD* payload)
+{
+    if (DEC_REF(BORROWED_PAYLOAD, payload) == DEC_RETURN_ZERO)
+    {
+        /*Codes_SRS_IOTHUBMESSAGE_41_021: [ Once the message and all its clones are destroyed, `releaseCallback` shall be called with `byteArray`, `size` and `releaseContext`, unless it is NULL. ]*/
+        if (payload->releaseCallback != NULL)
+        {
+            payload->releaseCallback(payload->buffer, payload->size, payload->releaseContext);
+        }
+        free(payload);
+    }
+}
+
+static void DestroyMessageData(IOTHUB_MESSAGE_HANDLE_DATA* handleData)
+{
+    if (handleData->contentType == IOTHUBMESSAGE_BYTEARRAY)
+    {
+        if (handleData->borrowedPayload != NULL)
+        {
+            release_borrowed_payload(handleData->borrowedPayload);
+        }
+        else if (handleData->value.byteArray != NULL)
+        {
+            CONSTBUFFER_DecRef(handleData->value.byteArray);
+        }
+    }
+    else if (handleData->contentType == IOTHUBMESSAGE_STRING)
+    {
+        STRING_delete(handleData->value.string);
+    }
+
+    if (handleData->properties != NULL)
+    {
+        Map_Destroy(handleData->properties);
+    }
+    if (handleData->property_set != NULL)
+    {
+        release_property_set(handleData->property_set);
+    }
+    free(handleData->inline_properties.arena);
+    free(handleData->messageId);
+    handleData->messageId = NULL;
+    free(handleData->correlationId);
+    handleData->correlationId = NULL;
+    free(handleData->userDefinedContentType);
+    free(handleData->contentEncoding);
+    free(handleData->outputName);
+    free(handleData->inputName);
+    free(handleData->connectionModuleId);
+    free(handleData->connectionDeviceId);
+    free(handleData);
+}
+
+static void set_inline_diagnostic_data(INLINE_DIAGNOSTIC_DATA* target, const char* diagnosticId, const char* diagnosticCreationTimeUtc)
+{
+    /*memmove, the source may be the data of this same message*/
+    (void)memmove(target->diagnosticId, diagnosticId, strlen(diagnosticId) + 1);
+    (void)memmove(target->diagnosticCreationTimeUtc, diagnosticCreationTimeUtc, strlen(diagnosticCreationTimeUtc) + 1);
+    target->data.diagnosticId = target->diagnosticId;
+    target->data.diagnosticCreationTimeUtc = target->diagnosticCreationTimeUtc;
+}
+
 IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromByteArray(const unsigned char* byteArray, size_t size)
 {
     IOTHUB_MESSAGE_HANDLE_DATA* result;
@@ -187,22 +536,15 @@ IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromByteArray(const unsigned char* byt
             }
             if (result != NULL)
             {
-                /*Codes_SRS_IOTHUBMESSAGE_02_022: [IoTHubMessage_CreateFromByteArray shall call BUFFER_create passing byteArray and size as parameters.] */
-                if ((result->value.byteArray = BUFFER_create(source, size)) == NULL)
+                /*Codes_SRS_IOTHUBMESSAGE_41_015: [ IoTHubMessage_CreateFromByteArray shall copy byteArray into an immutable payload with CONSTBUFFER_Create. ]*/
+                if ((result->value.byteArray = CONSTBUFFER_Create(source, size)) == NULL)
                 {
-                    LogError("BUFFER_create failed");
-                    /*Codes_SRS_IOTHUBMESSAGE_02_024: [If there are any errors then IoTHubMessage_CreateFromByteArray shall return NULL.] */
-                    DestroyMessageData(result);
-                    result = NULL;
-                }
-                /*Codes_SRS_IOTHUBMESSAGE_02_023: [IoTHubMessage_CreateFromByteArray shall call Map_Create to create the message properties.] */
-                else if ((result->properties = Map_Create(ValidateAsciiCharactersFilter)) == NULL)
-                {
-                    LogError("Map_Create for properties failed");
+                    LogError("CONSTBUFFER_Create failed");
                     /*Codes_SRS_IOTHUBMESSAGE_02_024: [If there are any errors then IoTHubMessage_CreateFromByteArray shall return NULL.] */
                     DestroyMessageData(result);
                     result = NULL;
                 }
+                /*Codes_SRS_IOTHUBMESSAGE_41_005: [ A new message shall start with no properties and allocate none. ]*/
                 /*Codes_SRS_IOTHUBMESSAGE_02_025: [Otherwise, IoTHubMessage_CreateFromByteArray shall return a non-NULL handle.] */
             }
         }
@@ -210,6 +552,88 @@ IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromByteArray(const unsigned char* byt
     return result;
 }
 
+IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromByteArrayNoCopy(const unsigned char* byteArray, size_t size, IOTHUB_MESSAGE_RELEASE_CALLBACK releaseCallback, void* releaseContext)
+{
+    IOTHUB_MESSAGE_HANDLE_DATA* result;
+
+    /*Codes_SRS_IOTHUBMESSAGE_41_018: [ If `byteArray` is NULL and `size` is not zero then `IoTHubMessage_CreateFromByteArrayNoCopy` shall return NULL. ]*/
+    if ((byteArray == NULL) && (size != 0))
+    {
+        LogError("Invalid argument - byteArray is NULL");
+        result = NULL;
+    }
+    else if ((result = (IOTHUB_MESSAGE_HANDLE_DATA*)malloc(sizeof(IOTHUB_MESSAGE_HANDLE_DATA))) == NULL)
+    {
+        /*Codes_SRS_IOTHUBMESSAGE_41_020: [ If there are any errors then `IoTHubMessage_CreateFromByteArrayNoCopy` shall return NULL, without calling `releaseCallback`. ]*/
+        LogError("unable to malloc");
+    }
+    else
+    {
+        memset(result, 0, sizeof(*result));
+        result->contentType = IOTHUBMESSAGE_BYTEARRAY;
+
+        /*Codes_SRS_IOTHUBMESSAGE_41_019: [ `IoTHubMessage_CreateFromByteArrayNoCopy` shall create a BYTEARRAY message whose payload points to `byteArray`, without copying it. ]*/
+        if ((result->borrowedPayload = REFCOUNT_TYPE_CREATE(BORROWED_PAYLOAD)) == NULL)
+        {
+            /*Codes_SRS_IOTHUBMESSAGE_41_020: [ If there are any errors then `IoTHubMessage_CreateFromByteArrayNoCopy` shall return NULL, without calling `releaseCallback`. ]*/
+            LogError("unable to allocate the payload reference");
+            free(result);
+            result = NULL;
+        }
+        else
+        {
+            result->borrowedPayload->buffer = byteArray;
+            result->borrowedPayload->size = size;
+            result->borrowedPayload->releaseCallback = releaseCallback;
+            result->borrowedPayload->releaseContext = releaseContext;
+        }
+    }
+
+    return result;
+}
+
+#ifdef USE_PAYLOAD_COMPRESSION
+IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateCompressedFromByteArray(const unsigned char* byteArray, size_t size)
+{
+    IOTHUB_MESSAGE_HANDLE result;
+    unsigned char* compressed;
+    size_t compressedSize;
+
+    /*Codes_SRS_IOTHUBMESSAGE_41_001: [ If `byteArray` is NULL and `size` is not zero then `IoTHubMessage_CreateCompressedFromByteArray` shall return NULL. ]*/
+    if ((byteArray == NULL) && (size != 0))
+    {
+        LogError("Invalid argument - byteArray is NULL");
+        result = NULL;
+    }
+    /*Codes_SRS_IOTHUBMESSAGE_41_002: [ `IoTHubMessage_CreateCompressedFromByteArray` shall compress `byteArray` with `gzip_compress_buffer`. ]*/
+    else if (gzip_compress_buffer(byteArray, size, &compressed, &compressedSize) != 0)
+    {
+        /*Codes_SRS_IOTHUBMESSAGE_41_004: [ If there are any errors then `IoTHubMessage_CreateCompressedFromByteArray` shall return NULL. ]*/
+        LogError("gzip_compress_buffer failed");
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBMESSAGE_41_003: [ `IoTHubMessage_CreateCompressedFromByteArray` shall create the message with `IoTHubMessage_CreateFromByteArray` from the compressed bytes and set its content encoding to "gzip". ]*/
+        if ((result = IoTHubMessage_CreateFromByteArray(compressed, compressedSize)) == NULL)
+        {
+            /*Codes_SRS_IOTHUBMESSAGE_41_004: [ If there are any errors then `IoTHubMessage_CreateCompressedFromByteArray` shall return NULL. ]*/
+            LogError("IoTHubMessage_CreateFromByteArray failed");
+        }
+        else if (IoTHubMessage_SetContentEncodingSystemProperty(result, GZIP_CONTENT_ENCODING) != IOTHUB_MESSAGE_OK)
+        {
+            /*Codes_SRS_IOTHUBMESSAGE_41_004: [ If there are any errors then `IoTHubMessage_CreateCompressedFromByteArray` shall return NULL. ]*/
+            LogError("IoTHubMessage_SetContentEncodingSystemProperty failed");
+            IoTHubMessage_Destroy(result);
+            result = NULL;
+        }
+        free(compressed);
+    }
+
+    return result;
+}
+#endif /* USE_PAYLOAD_COMPRESSION */
+
 IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromString(const char* source)
 {
     IOTHUB_MESSAGE_HANDLE_DATA* result;
@@ -241,14 +665,7 @@ IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromString(const char* source)
                 DestroyMessageData(result);
                 result = NULL;
             }
-            /*Codes_SRS_IOTHUBMESSAGE_02_028: [IoTHubMessage_CreateFromString shall call Map_Create to create the message properties.] */
-            else if ((result->properties = Map_Create(ValidateAsciiCharactersFilter)) == NULL)
-            {
-                LogError("Map_Create for properties failed");
-                /*Codes_SRS_IOTHUBMESSAGE_02_029: [If there are any encountered in the execution of IoTHubMessage_CreateFromString then IoTHubMessage_CreateFromString shall return NULL.] */
-                DestroyMessageData(result);
-                result = NULL;
-            }
+            /*Codes_SRS_IOTHUBMESSAGE_41_005: [ A new message shall start with no properties and allocate none. ]*/
             /*Codes_SRS_IOTHUBMESSAGE_02_031: [Otherwise, IoTHubMessage_CreateFromString shall return a non-NULL handle.] */
         }
     }
@@ -281,6 +698,19 @@ IOTHUB_MESSAGE_HANDLE IoTHubMessage_Clone(IOTHUB_MESSAGE_HANDLE iotHubMessageHan
             memset(result, 0, sizeof(*result));
             result->contentType = source->contentType;
 
+            if (source->property_set != NULL)
+            {
+                /*Codes_SRS_IOTHUBMESSAGE_41_035: [ IoTHubMessage_Clone shall share the property set of `iotHubMessageHandle` with the clone, without copying it. ]*/
+                INC_REF(IOTHUB_MESSAGE_PROPERTY_SET, source->property_set);
+                result->property_set = source->property_set;
+            }
+
+            if (source->diagnosticData.data.diagnosticId != NULL)
+            {
+                /*Codes_SRS_IOTHUBMESSAGE_41_026: [ IoTHubMessage_Clone shall copy the diagnostic data of `iotHubMessageHandle` into the clone without allocating memory. ]*/
+                set_inline_diagnostic_data(&result->diagnosticData, source->diagnosticData.diagnosticId, source->diagnosticData.diagnosticCreationTimeUtc);
+            }
+
             if (source->messageId != NULL && mallocAndStrcpy_s(&result->messageId, source->messageId) != 0)
             {
                 LogError("unable to Copy messageId");
@@ -305,12 +735,6 @@ IOTHUB_MESSAGE_HANDLE IoTHubMessage_Clone(IOTHUB_MESSAGE_HANDLE iotHubMessageHan
                 DestroyMessageData(result);
                 result = NULL;
             }
-            else if (source->diagnosticData != NULL && (result->diagnosticData = CloneDiagnosticPropertyData(source->diagnosticData)) == NULL)
-            {
-                LogError("unable to copy CloneDiagnosticPropertyData");
-                DestroyMessageData(result);
-                result = NULL;
-            }
             else if (source->outputName != NULL && mallocAndStrcpy_s(&result->outputName, source->outputName) != 0)
             {
                 LogError("unable to copy outputName");
@@ -337,19 +761,32 @@ IOTHUB_MESSAGE_HANDLE IoTHubMessage_Clone(IOTHUB_MESSAGE_HANDLE iotHubMessageHan
             }
             else if (source->contentType == IOTHUBMESSAGE_BYTEARRAY)
             {
-                /*Codes_SRS_IOTHUBMESSAGE_02_006: [IoTHubMessage_Clone shall clone to content by a call to BUFFER_clone] */
-                if ((result->value.byteArray = BUFFER_clone(source->value.byteArray)) == NULL)
+                if (source->borrowedPayload != NULL)
+                {
+                    /*Codes_SRS_IOTHUBMESSAGE_41_022: [ IoTHubMessage_Clone shall share a payload created by `IoTHubMessage_CreateFromByteArrayNoCopy` with the clone, without copying it. ]*/
+                    (void)INC_REF(BORROWED_PAYLOAD, source->borrowedPayload);
+                    result->borrowedPayload = source->borrowedPayload;
+                }
+                else
+                {
+                    /*Codes_SRS_IOTHUBMESSAGE_41_016: [ IoTHubMessage_Clone shall share the payload of a BYTEARRAY message with the clone by taking a reference on it with CONSTBUFFER_IncRef, without copying it. ]*/
+                    CONSTBUFFER_IncRef(source->value.byteArray);
+                    result->value.byteArray = source->value.byteArray;
+                }
+
+                /*Codes_SRS_IOTHUBMESSAGE_02_005: [IoTHubMessage_Clone shall clone the properties map by using Map_Clone.] */
+                if (source->properties != NULL && (result->properties = Map_Clone(source->properties)) == NULL)
                 {
                     /*Codes_SRS_IOTHUBMESSAGE_03_004: [IoTHubMessage_Clone shall return NULL if it fails for any reason.]*/
-                    LogError("unable to BUFFER_clone");
+                    LogError("unable to Map_Clone");
                     DestroyMessageData(result);
                     result = NULL;
                 }
-                /*Codes_SRS_IOTHUBMESSAGE_02_005: [IoTHubMessage_Clone shall clone the properties map by using Map_Clone.] */
-                else if ((result->properties = Map_Clone(source->properties)) == NULL)
+                /*Codes_SRS_IOTHUBMESSAGE_41_006: [ If the properties of `iotHubMessageHandle` are not in a map, `IoTHubMessage_Clone` shall copy all of them with a single allocation. ]*/
+                else if (source->properties == NULL && clone_inline_properties(&result->inline_properties, &source->inline_properties) != 0)
                 {
                     /*Codes_SRS_IOTHUBMESSAGE_03_004: [IoTHubMessage_Clone shall return NULL if it fails for any reason.]*/
-                    LogError("unable to Map_Clone");
+                    LogError("unable to clone the message properties");
                     DestroyMessageData(result);
                     result = NULL;
                 }
@@ -366,13 +803,21 @@ IOTHUB_MESSAGE_HANDLE IoTHubMessage_Clone(IOTHUB_MESSAGE_HANDLE iotHubMessageHan
                     result = NULL;
                 }
                 /*Codes_SRS_IOTHUBMESSAGE_02_005: [IoTHubMessage_Clone shall clone the properties map by using Map_Clone.] */
-                else if ((result->properties = Map_Clone(source->properties)) == NULL)
+                else if (source->properties != NULL && (result->properties = Map_Clone(source->properties)) == NULL)
                 {
                     /*Codes_SRS_IOTHUBMESSAGE_03_004: [IoTHubMessage_Clone shall return NULL if it fails for any reason.]*/
                     LogError("unable to Map_Clone");
                     DestroyMessageData(result);
                     result = NULL;
                 }
+                /*Codes_SRS_IOTHUBMESSAGE_41_006: [ If the properties of `iotHubMessageHandle` are not in a map, `IoTHubMessage_Clone` shall copy all of them with a single allocation. ]*/
+                else if (source->properties == NULL && clone_inline_properties(&result->inline_properties, &source->inline_properties) != 0)
+                {
+                    /*Codes_SRS_IOTHUBMESSAGE_03_004: [IoTHubMessage_Clone shall return NULL if it fails for any reason.]*/
+                    LogError("unable to clone the message properties");
+                    DestroyMessageData(result);
+                    result = NULL;
+                }
             }
         }
     }
@@ -401,14 +846,29 @@ IOTHUB_MESSAGE_RESULT IoTHubMessage_GetByteArray(IOTHUB_MESSAGE_HANDLE iotHubMes
             result = IOTHUB_MESSAGE_INVALID_ARG;
             LogError("invalid type of message %s", ENUM_TO_STRING(IOTHUBMESSAGE_CONTENT_TYPE, handleData->contentType));
         }
-        else
+        else if (handleData->borrowedPayload != NULL)
         {
-            /*Codes_SRS_IOTHUBMESSAGE_01_011: [The pointer shall be obtained by using BUFFER_u_char and it shall be copied in the buffer argument.]*/
-            *buffer = BUFFER_u_char(handleData->value.byteArray);
-            /*Codes_SRS_IOTHUBMESSAGE_01_012: [The size of the associated data shall be obtained by using BUFFER_length and it shall be copied to the size argument.]*/
-            *size = BUFFER_length(handleData->value.byteArray);
+            /*Codes_SRS_IOTHUBMESSAGE_41_023: [ For a message created by `IoTHubMessage_CreateFromByteArrayNoCopy`, IoTHubMessage_GetByteArray shall return the bytes of the caller. ]*/
+            *buffer = handleData->borrowedPayload->buffer;
+            *size = handleData->borrowedPayload->size;
             result = IOTHUB_MESSAGE_OK;
         }
+        else
+        {
+            /*Codes_SRS_IOTHUBMESSAGE_41_017: [ The pointer and the size shall be obtained with CONSTBUFFER_GetContent and copied in the buffer and size arguments. ]*/
+            const CONSTBUFFER* content = CONSTBUFFER_GetContent(handleData->value.byteArray);
+            if (content == NULL)
+            {
+                LogError("unable to CONSTBUFFER_GetContent");
+                result = IOTHUB_MESSAGE_ERROR;
+            }
+            else
+            {
+                *buffer = content->buffer;
+                *size = content->size;
+                result = IOTHUB_MESSAGE_OK;
+            }
+        }
     }
     return result;
 }
@@ -468,7 +928,66 @@ MAP_HANDLE IoTHubMessage_Properties(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
     {
         /*Codes_SRS_IOTHUBMESSAGE_02_002: [Otherwise, for any non-NULL iotHubMessageHandle it shall return a non-NULL MAP_HANDLE.]*/
         IOTHUB_MESSAGE_HANDLE_DATA* handleData = (IOTHUB_MESSAGE_HANDLE_DATA*)iotHubMessageHandle;
-        result = handleData->properties;
+
+        /*Codes_SRS_IOTHUBMESSAGE_41_036: [ If the message has a property set, `IoTHubMessage_Properties` shall first copy its properties into the message and release it; if that fails it shall return NULL. ]*/
+        if (handleData->property_set != NULL && copy_properties_from_set(handleData) != 0)
+        {
+            LogError("unable to copy the property set into the message");
+            result = NULL;
+        }
+        /*Codes_SRS_IOTHUBMESSAGE_41_007: [ The first call to `IoTHubMessage_Properties` shall move the properties of the message to a map created with `Map_Create`, which holds them from then on. ]*/
+        else if (handleData->properties == NULL && move_properties_to_map(handleData) != 0)
+        {
+            /*Codes_SRS_IOTHUBMESSAGE_41_008: [ If creating the map fails, `IoTHubMessage_Properties` shall return NULL. ]*/
+            LogError("unable to create the properties map");
+            result = NULL;
+        }
+        else
+        {
+            result = handleData->properties;
+        }
+    }
+    return result;
+}
+
+IOTHUB_MESSAGE_RESULT IoTHubMessage_GetProperties(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle, const char* const** keys, const char* const** values, size_t* count)
+{
+    IOTHUB_MESSAGE_RESULT result;
+    /*Codes_SRS_IOTHUBMESSAGE_41_009: [ If `iotHubMessageHandle`, `keys`, `values` or `count` is NULL, `IoTHubMessage_GetProperties` shall return IOTHUB_MESSAGE_INVALID_ARG. ]*/
+    if (iotHubMessageHandle == NULL || keys == NULL || values == NULL || count == NULL)
+    {
+        LogError("invalid parameter (NULL) to IoTHubMessage_GetProperties iotHubMessageHandle=%p, keys=%p, values=%p, count=%p", iotHubMessageHandle, keys, values, count);
+        result = IOTHUB_MESSAGE_INVALID_ARG;
+    }
+    else if (iotHubMessageHandle->property_set != NULL)
+    {
+        /*Codes_SRS_IOTHUBMESSAGE_41_037: [ If the message has a property set, `IoTHubMessage_GetProperties` shall return the keys and values of the set, without allocating. ]*/
+        *keys = iotHubMessageHandle->property_set->keys;
+        *values = iotHubMessageHandle->property_set->values;
+        *count = iotHubMessageHandle->property_set->count;
+        result = IOTHUB_MESSAGE_OK;
+    }
+    else if (iotHubMessageHandle->properties != NULL)
+    {
+        /*Codes_SRS_IOTHUBMESSAGE_41_010: [ If the properties are in a map, `IoTHubMessage_GetProperties` shall return them with `Map_GetInternals`. ]*/
+        if (Map_GetInternals(iotHubMessageHandle->properties, keys, values, count) != MAP_OK)
+        {
+            /*Codes_SRS_IOTHUBMESSAGE_41_012: [ If `Map_GetInternals` fails, `IoTHubMessage_GetProperties` shall return IOTHUB_MESSAGE_ERROR. ]*/
+            LogError("unable to Map_GetInternals");
+            result = IOTHUB_MESSAGE_ERROR;
+        }
+        else
+        {
+            result = IOTHUB_MESSAGE_OK;
+        }
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBMESSAGE_41_011: [ Otherwise `IoTHubMessage_GetProperties` shall return the keys and values stored in the message, without allocating. ]*/
+        *keys = iotHubMessageHandle->inline_properties.keys;
+        *values = iotHubMessageHandle->inline_properties.values;
+        *count = iotHubMessageHandle->inline_properties.count;
+        result = IOTHUB_MESSAGE_OK;
     }
     return result;
 }
@@ -481,6 +1000,45 @@ IOTHUB_MESSAGE_RESULT IoTHubMessage_SetProperty(IOTHUB_MESSAGE_HANDLE msg_handle
         LogError("invalid parameter (NULL) to IoTHubMessage_SetProperty iotHubMessageHandle=%p, key=%p, value=%p", msg_handle, key, value);
         result = IOTHUB_MESSAGE_INVALID_ARG;
     }
+    /*Codes_SRS_IOTHUBMESSAGE_41_038: [ If the message has a property set, `IoTHubMessage_SetProperty` shall first copy its properties into the message and release it; if that fails it shall return IOTHUB_MESSAGE_ERROR. ]*/
+    else if (msg_handle->property_set != NULL && copy_properties_from_set(msg_handle) != 0)
+    {
+        LogError("unable to copy the property set into the message");
+        result = IOTHUB_MESSAGE_ERROR;
+    }
+    else if (msg_handle->properties == NULL)
+    {
+        size_t index;
+
+        if (ValidateAsciiCharactersFilter(key, value) != 0)
+        {
+            LogError("property key and value may only contain printable US-ASCII characters");
+            result = IOTHUB_MESSAGE_ERROR;
+        }
+        /*Codes_SRS_IOTHUBMESSAGE_41_013: [ While the message holds fewer than 5 properties, or `key` is one of them, `IoTHubMessage_SetProperty` shall store `key` and `value` in the message itself, packing all keys and values in one allocation. ]*/
+        else if (msg_handle->inline_properties.count < INLINE_PROPERTY_COUNT || find_inline_property(&msg_handle->inline_properties, key, &index) == 0)
+        {
+            if (set_inline_property(&msg_handle->inline_properties, key, value) != 0)
+            {
+                LogError("Failure adding property to the message");
+                result = IOTHUB_MESSAGE_ERROR;
+            }
+            else
+            {
+                result = IOTHUB_MESSAGE_OK;
+            }
+        }
+        /*Codes_SRS_IOTHUBMESSAGE_41_014: [ Otherwise `IoTHubMessage_SetProperty` shall move the properties to a map created with `Map_Create` and add `key` and `value` to it with `Map_AddOrUpdate`. ]*/
+        else if (move_properties_to_map(msg_handle) != 0 || Map_AddOrUpdate(msg_handle->properties, key, value) != MAP_OK)
+        {
+            LogError("Failure adding property to internal map");
+            result = IOTHUB_MESSAGE_ERROR;
+        }
+        else
+        {
+            result = IOTHUB_MESSAGE_OK;
+        }
+    }
     else
     {
         if (Map_AddOrUpdate(msg_handle->properties, key, value) != MAP_OK)
@@ -504,6 +1062,19 @@ const char* IoTHubMessage_GetProperty(IOTHUB_MESSAGE_HANDLE msg_handle, const ch
         LogError("invalid parameter (NULL) to IoTHubMessage_GetProperty iotHubMessageHandle=%p, key=%p", msg_handle, key);
         result = NULL;
     }
+    else if (msg_handle->property_set != NULL)
+    {
+        size_t i;
+        for (i = 0; i < msg_handle->property_set->count && strcmp(msg_handle->property_set->keys[i], key) != 0; i++)
+        {
+        }
+        result = (i < msg_handle->property_set->count) ? msg_handle->property_set->values[i] : NULL;
+    }
+    else if (msg_handle->properties == NULL)
+    {
+        size_t index;
+        result = (find_inline_property(&msg_handle->inline_properties, key, &index) == 0) ? msg_handle->inline_properties.values[index] : NULL;
+    }
     else
     {
         bool key_exists = false;
@@ -520,6 +1091,142 @@ const char* IoTHubMessage_GetProperty(IOTHUB_MESSAGE_HANDLE msg_handle, const ch
     return result;
 }
 
+IOTHUB_MESSAGE_PROPERTY_SET_HANDLE IoTHubMessagePropertySet_Create(const char* const* keys, const char* const* values, size_t count)
+{
+    IOTHUB_MESSAGE_PROPERTY_SET* result;
+    size_t text_size = 0;
+    size_t i;
+    bool is_valid = (keys != NULL) && (values != NULL) && (count > 0) && (count <= SIZE_MAX / (4 * sizeof(const char*)));
+
+    for (i = 0; is_valid && i < count; i++)
+    {
+        size_t j;
+
+        if (keys[i] == NULL || values[i] == NULL || ValidateAsciiCharactersFilter(keys[i], values[i]) != 0)
+        {
+            is_valid = false;
+        }
+        else
+        {
+            for (j = 0; j < i && strcmp(keys[j], keys[i]) != 0; j++)
+            {
+            }
+            is_valid = (j == i);
+            text_size += strlen(keys[i]) + strlen(values[i]) + 2;
+        }
+    }
+
+    if (!is_valid)
+    {
+        /*Codes_SRS_IOTHUBMESSAGE_41_027: [ If `keys` or `values` is NULL, `count` is zero, any key or value is NULL or not printable US-ASCII, or a key appears twice, `IoTHubMessagePropertySet_Create` shall return NULL. ]*/
+        LogError("invalid properties for IoTHubMessagePropertySet_Create keys=%p, values=%p, count=%lu", keys, values, (unsigned long)count);
+        result = NULL;
+    }
+    else if ((result = REFCOUNT_TYPE_CREATE(IOTHUB_MESSAGE_PROPERTY_SET)) == NULL)
+    {
+        /*Codes_SRS_IOTHUBMESSAGE_41_029: [ If there are any errors then `IoTHubMessagePropertySet_Create` shall return NULL. ]*/
+        LogError("unable to malloc the property set");
+    }
+    /*Codes_SRS_IOTHUBMESSAGE_41_028: [ `IoTHubMessagePropertySet_Create` shall copy the keys and values, with all their text, into a single allocation. ]*/
+    else if ((result->keys = (const char**)malloc(2 * count * sizeof(const char*) + text_size)) == NULL)
+    {
+        LogError("unable to malloc %lu bytes for the properties", (unsigned long)(2 * count * sizeof(const char*) + text_size));
+        free(result);
+        result = NULL;
+    }
+    else
+    {
+        char* text = (char*)(result->keys + 2 * count);
+
+        result->count = count;
+        result->values = result->keys + count;
+        for (i = 0; i < count; i++)
+        {
+            size_t key_size = strlen(keys[i]) + 1;
+            size_t value_size = strlen(values[i]) + 1;
+
+            (void)memcpy(text, keys[i], key_size);
+            result->keys[i] = text;
+            text += key_size;
+            (void)memcpy(text, values[i], value_size);
+            result->values[i] = text;
+            text += value_size;
+        }
+    }
+
+    return result;
+}
+
+IOTHUB_MESSAGE_PROPERTY_SET_HANDLE IoTHubMessagePropertySet_Clone(IOTHUB_MESSAGE_PROPERTY_SET_HANDLE propertySet)
+{
+    /*Codes_SRS_IOTHUBMESSAGE_41_030: [ If `propertySet` is NULL, `IoTHubMessagePropertySet_Clone` shall return NULL. ]*/
+    if (propertySet == NULL)
+    {
+        LogError("invalid parameter (NULL) to IoTHubMessagePropertySet_Clone");
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBMESSAGE_41_031: [ Otherwise `IoTHubMessagePropertySet_Clone` shall take a reference on `propertySet` and return it. ]*/
+        INC_REF(IOTHUB_MESSAGE_PROPERTY_SET, propertySet);
+    }
+    return propertySet;
+}
+
+void IoTHubMessagePropertySet_Destroy(IOTHUB_MESSAGE_PROPERTY_SET_HANDLE propertySet)
+{
+    /*Codes_SRS_IOTHUBMESSAGE_41_032: [ `IoTHubMessagePropertySet_Destroy` shall release a reference on `propertySet`, freeing it once no handle and no message refers to it; it shall do nothing if `propertySet` is NULL. ]*/
+    if (propertySet != NULL)
+    {
+        release_property_set(propertySet);
+    }
+}
+
+IOTHUB_MESSAGE_RESULT IoTHubMessage_SetPropertySet(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle, IOTHUB_MESSAGE_PROPERTY_SET_HANDLE propertySet)
+{
+    IOTHUB_MESSAGE_RESULT result;
+    if (iotHubMessageHandle == NULL || propertySet == NULL)
+    {
+        /*Codes_SRS_IOTHUBMESSAGE_41_033: [ If `iotHubMessageHandle` or `propertySet` is NULL, `IoTHubMessage_SetPropertySet` shall return IOTHUB_MESSAGE_INVALID_ARG. ]*/
+        LogError("invalid parameter (NULL) to IoTHubMessage_SetPropertySet iotHubMessageHandle=%p, propertySet=%p", iotHubMessageHandle, propertySet);
+        result = IOTHUB_MESSAGE_INVALID_ARG;
+    }
+    else if (iotHubMessageHandle->inline_properties.count != 0 || iotHubMessageHandle->properties != NULL)
+    {
+        /*Codes_SRS_IOTHUBMESSAGE_41_034: [ If the message already holds properties of its own, `IoTHubMessage_SetPropertySet` shall return IOTHUB_MESSAGE_ERROR. ]*/
+        LogError("the message already has properties of its own");
+        result = IOTHUB_MESSAGE_ERROR;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBMESSAGE_41_039: [ Otherwise `IoTHubMessage_SetPropertySet` shall take a reference on `propertySet`, release any previous property set of the message and return IOTHUB_MESSAGE_OK. ]*/
+        INC_REF(IOTHUB_MESSAGE_PROPERTY_SET, propertySet);
+        if (iotHubMessageHandle->property_set != NULL)
+        {
+            release_property_set(iotHubMessageHandle->property_set);
+        }
+        iotHubMessageHandle->property_set = propertySet;
+        result = IOTHUB_MESSAGE_OK;
+    }
+    return result;
+}
+
+IOTHUB_MESSAGE_PROPERTY_SET_HANDLE IoTHubMessage_GetPropertySet(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
+{
+    IOTHUB_MESSAGE_PROPERTY_SET_HANDLE result;
+    if (iotHubMessageHandle == NULL)
+    {
+        /*Codes_SRS_IOTHUBMESSAGE_41_040: [ If `iotHubMessageHandle` is NULL, `IoTHubMessage_GetPropertySet` shall return NULL. ]*/
+        LogError("invalid parameter (NULL) to IoTHubMessage_GetPropertySet");
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBMESSAGE_41_041: [ Otherwise `IoTHubMessage_GetPropertySet` shall return the property set of the message, or NULL if it has none. ]*/
+        result = iotHubMessageHandle->property_set;
+    }
+    return result;
+}
+
 const char* IoTHubMessage_GetCorrelationId(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
 {
     const char* result;
@@ -749,7 +1456,7 @@ const IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DATA* IoTHubMessage_GetDiagnosticProper
     else
     {
         /* Codes_SRS_IOTHUBMESSAGE_10_002: [IoTHubMessage_GetDiagnosticPropertyData shall return the diagnosticData as a const IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DATA*.] */
-        result = iotHubMessageHandle->diagnosticData;
+        result = (iotHubMessageHandle->diagnosticData.data.diagnosticId == NULL) ? NULL : &iotHubMessageHandle->diagnosticData.data;
     }
     return result;
 }
@@ -769,26 +1476,20 @@ IOTHUB_MESSAGE_RESULT IoTHubMessage_SetDiagnosticPropertyData(IOTHUB_MESSAGE_HAN
             diagnosticData == NULL ? NULL : diagnosticData->diagnosticCreationTimeUtc);
         result = IOTHUB_MESSAGE_INVALID_ARG;
     }
+    else if (strlen(diagnosticData->diagnosticId) > DIAGNOSTIC_ID_MAX_LENGTH ||
+        strlen(diagnosticData->diagnosticCreationTimeUtc) > DIAGNOSTIC_CREATION_TIME_UTC_MAX_LENGTH)
+    {
+        /*Codes_SRS_IOTHUBMESSAGE_41_025: [ If `diagnosticId` or `diagnosticCreationTimeUtc` is longer than 32 characters, IoTHubMessage_SetDiagnosticPropertyData shall return IOTHUB_MESSAGE_INVALID_ARG. ]*/
+        LogError("Invalid argument (diagnosticId or diagnosticCreationTimeUtc longer than 32 characters)");
+        result = IOTHUB_MESSAGE_INVALID_ARG;
+    }
     else
     {
-        // Codes_SRS_IOTHUBMESSAGE_10_004: [If the IOTHUB_MESSAGE_HANDLE `diagnosticData` is not NULL it shall be deallocated.]
-        if (iotHubMessageHandle->diagnosticData != NULL)
-        {
-            DestroyDiagnosticPropertyData(iotHubMessageHandle->diagnosticData);
-            iotHubMessageHandle->diagnosticData = NULL;
-        }
+        /*Codes_SRS_IOTHUBMESSAGE_41_024: [ IoTHubMessage_SetDiagnosticPropertyData shall copy `diagnosticData` into the message, replacing any previous value, without allocating memory. ]*/
+        set_inline_diagnostic_data(&iotHubMessageHandle->diagnosticData, diagnosticData->diagnosticId, diagnosticData->diagnosticCreationTimeUtc);
 
-        // Codes_SRS_IOTHUBMESSAGE_10_005: [If the allocation or the copying of `diagnosticData` fails, then IoTHubMessage_SetDiagnosticPropertyData shall return IOTHUB_MESSAGE_ERROR.]
-        if ((iotHubMessageHandle->diagnosticData = CloneDiagnosticPropertyData(diagnosticData)) == NULL)
-        {
-            LogError("Failed saving a copy of diagnosticData");
-            result = IOTHUB_MESSAGE_ERROR;
-        }
-        else
-        {
-            // Codes_SRS_IOTHUBMESSAGE_10_006: [If IoTHubMessage_SetDiagnosticPropertyData finishes successfully it shall return IOTHUB_MESSAGE_OK.]
-            result = IOTHUB_MESSAGE_OK;
-        }
+        // Codes_SRS_IOTHUBMESSAGE_10_006: [If IoTHubMessage_SetDiagnosticPropertyData finishes successfully it shall return IOTHUB_MESSAGE_OK.]
+        result = IOTHUB_MESSAGE_OK;
     }
     return result;
 }
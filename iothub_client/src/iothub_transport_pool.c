@@ -0,0 +1,249 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+#include "iothub_transport_pool.h"
+
+/*each connection owns this many points of the hash ring, which keeps the share of every connection within a few percent of 1/K*/
+#define TRANSPORT_POOL_POINTS_PER_CONNECTION 128
+
+#define FNV_OFFSET_BASIS 2166136261u
+#define FNV_PRIME 16777619u
+
+typedef struct TRANSPORT_POOL_POINT_TAG
+{
+    uint32_t hash;
+    size_t connection;
+} TRANSPORT_POOL_POINT;
+
+typedef struct IOTHUB_TRANSPORT_POOL_TAG
+{
+    TRANSPORT_HANDLE* transports;
+    size_t connectionCount;
+    TRANSPORT_POOL_POINT* ring; /*sorted by hash*/
+    size_t ringSize;
+} IOTHUB_TRANSPORT_POOL;
+
+static uint32_t hash_bytes(uint32_t hash, const unsigned char* bytes, size_t length)
+{
+    size_t i;
+    for (i = 0; i < length; i++)
+    {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+/*FNV-1a spreads short, similar keys (device ids, point numbers) poorly over the high bits, so mix them in*/
+static uint32_t finalize_hash(uint32_t hash)
+{
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bu;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35u;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+static uint32_t get_device_hash(const char* deviceId)
+{
+    return finalize_hash(hash_bytes(FNV_OFFSET_BASIS, (const unsigned char*)deviceId, strlen(deviceId)));
+}
+
+/*a point only depends on its connection and replica numbers, so the points of the first K connections are the same in every pool of K or more*/
+static uint32_t get_point_hash(size_t connection, size_t replica)
+{
+    unsigned char bytes[8];
+    size_t i;
+    for (i = 0; i < 4; i++)
+    {
+        bytes[i] = (unsigned char)(connection >> (i * 8));
+        bytes[i + 4] = (unsigned char)(replica >> (i * 8));
+    }
+    return finalize_hash(hash_bytes(FNV_OFFSET_BASIS, bytes, sizeof(bytes)));
+}
+
+static int compare_points(const void* left, const void* right)
+{
+    const TRANSPORT_POOL_POINT* leftPoint = (const TRANSPORT_POOL_POINT*)left;
+    const TRANSPORT_POOL_POINT* rightPoint = (const TRANSPORT_POOL_POINT*)right;
+    int result;
+
+    if (leftPoint->hash != rightPoint->hash)
+    {
+        result = (leftPoint->hash < rightPoint->hash) ? -1 : 1;
+    }
+    else if (leftPoint->connection != rightPoint->connection)
+    {
+        /*ties are broken the same way in every pool so collisions do not move devices either*/
+        result = (leftPoint->connection < rightPoint->connection) ? -1 : 1;
+    }
+    else
+    {
+        result = 0;
+    }
+
+    return result;
+}
+
+static void destroy_transports(IOTHUB_TRANSPORT_POOL* pool, size_t count)
+{
+    size_t i;
+    for (i = 0; i < count; i++)
+    {
+        IoTHubTransport_Destroy(pool->transports[i]);
+    }
+}
+
+IOTHUB_TRANSPORT_POOL_HANDLE IoTHubTransportPool_Create(IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol, const char* iotHubName, const char* iotHubSuffix, size_t connection_count)
+{
+    IOTHUB_TRANSPORT_POOL* result;
+
+    /*Codes_SRS_IOTHUBTRANSPORTPOOL_41_001: [ If protocol, iotHubName or iotHubSuffix is NULL, or connection_count is 0, IoTHubTransportPool_Create shall return NULL. ]*/
+    if (protocol == NULL || iotHubName == NULL || iotHubSuffix == NULL || connection_count == 0)
+    {
+        LogError("Invalid argument protocol=%p, iotHubName=%p, iotHubSuffix=%p, connection_count=%lu", protocol, iotHubName, iotHubSuffix, (unsigned long)connection_count);
+        result = NULL;
+    }
+    /*Codes_SRS_IOTHUBTRANSPORTPOOL_41_002: [ If connection_count is larger than the hash ring can hold, IoTHubTransportPool_Create shall return NULL. ]*/
+    else if ((connection_count > UINT32_MAX) || (connection_count > SIZE_MAX / (TRANSPORT_POOL_POINTS_PER_CONNECTION * sizeof(TRANSPORT_POOL_POINT))))
+    {
+        LogError("connection_count %lu is too large", (unsigned long)connection_count);
+        result = NULL;
+    }
+    else if ((result = (IOTHUB_TRANSPORT_POOL*)malloc(sizeof(IOTHUB_TRANSPORT_POOL))) == NULL)
+    {
+        LogError("failed allocating transport pool");
+    }
+    else
+    {
+        memset(result, 0, sizeof(IOTHUB_TRANSPORT_POOL));
+        result->ringSize = connection_count * TRANSPORT_POOL_POINTS_PER_CONNECTION;
+
+        if ((result->transports = (TRANSPORT_HANDLE*)malloc(connection_count * sizeof(TRANSPORT_HANDLE))) == NULL)
+        {
+            LogError("failed allocating %lu transports", (unsigned long)connection_count);
+            free(result);
+            result = NULL;
+        }
+        else if ((result->ring = (TRANSPORT_POOL_POINT*)malloc(result->ringSize * sizeof(TRANSPORT_POOL_POINT))) == NULL)
+        {
+            LogError("failed allocating the hash ring");
+            free(result->transports);
+            free(result);
+            result = NULL;
+        }
+        else
+        {
+            size_t createdTransports;
+
+            /*Codes_SRS_IOTHUBTRANSPORTPOOL_41_003: [ IoTHubTransportPool_Create shall create connection_count transports by calling IoTHubTransport_Create. ]*/
+            for (createdTransports = 0; createdTransports < connection_count; createdTransports++)
+            {
+                if ((result->transports[createdTransports] = IoTHubTransport_Create(protocol, iotHubName, iotHubSuffix)) == NULL)
+                {
+                    LogError("IoTHubTransport_Create failed for connection %lu", (unsigned long)createdTransports);
+                    break;
+                }
+            }
+
+            if (createdTransports != connection_count)
+            {
+                /*Codes_SRS_IOTHUBTRANSPORTPOOL_41_004: [ If any allocation or transport creation fails, IoTHubTransportPool_Create shall destroy the transports it created, free all resources and return NULL. ]*/
+                destroy_transports(result, createdTransports);
+                free(result->ring);
+                free(result->transports);
+                free(result);
+                result = NULL;
+            }
+            else
+            {
+                size_t connection;
+                size_t point = 0;
+
+                /*Codes_SRS_IOTHUBTRANSPORTPOOL_41_005: [ IoTHubTransportPool_Create shall place a fixed number of points per connection on a hash ring, each point depending only on its connection number. ]*/
+                for (connection = 0; connection < connection_count; connection++)
+                {
+                    size_t replica;
+                    for (replica = 0; replica < TRANSPORT_POOL_POINTS_PER_CONNECTION; replica++)
+                    {
+                        result->ring[point].hash = get_point_hash(connection, replica);
+                        result->ring[point].connection = connection;
+                        point++;
+                    }
+                }
+                qsort(result->ring, result->ringSize, sizeof(TRANSPORT_POOL_POINT), compare_points);
+                result->connectionCount = connection_count;
+            }
+        }
+    }
+
+    return result;
+}
+
+void IoTHubTransportPool_Destroy(IOTHUB_TRANSPORT_POOL_HANDLE transportPoolHandle)
+{
+    /*Codes_SRS_IOTHUBTRANSPORTPOOL_41_006: [ If transportPoolHandle is NULL, IoTHubTransportPool_Destroy shall do nothing. ]*/
+    if (transportPoolHandle != NULL)
+    {
+        /*Codes_SRS_IOTHUBTRANSPORTPOOL_41_007: [ IoTHubTransportPool_Destroy shall destroy every transport of the pool and free the pool. ]*/
+        destroy_transports(transportPoolHandle, transportPoolHandle->connectionCount);
+        free(transportPoolHandle->ring);
+        free(transportPoolHandle->transports);
+        free(transportPoolHandle);
+    }
+}
+
+TRANSPORT_HANDLE IoTHubTransportPool_GetTransport(IOTHUB_TRANSPORT_POOL_HANDLE transportPoolHandle, const char* deviceId)
+{
+    TRANSPORT_HANDLE result;
+
+    /*Codes_SRS_IOTHUBTRANSPORTPOOL_41_008: [ If transportPoolHandle or deviceId is NULL, IoTHubTransportPool_GetTransport shall return NULL. ]*/
+    if (transportPoolHandle == NULL || deviceId == NULL)
+    {
+        LogError("Invalid argument transportPoolHandle=%p, deviceId=%p", transportPoolHandle, deviceId);
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBTRANSPORTPOOL_41_009: [ IoTHubTransportPool_GetTransport shall return the transport owning the first point of the ring at or after the hash of deviceId, wrapping around to the first point. ]*/
+        uint32_t hash = get_device_hash(deviceId);
+        size_t low = 0;
+        size_t high = transportPoolHandle->ringSize;
+
+        while (low < high)
+        {
+            size_t middle = low + ((high - low) / 2);
+            if (transportPoolHandle->ring[middle].hash < hash)
+            {
+                low = middle + 1;
+            }
+            else
+            {
+                high = middle;
+            }
+        }
+
+        if (low == transportPoolHandle->ringSize)
+        {
+            low = 0;
+        }
+        result = transportPoolHandle->transports[transportPoolHandle->ring[low].connection];
+    }
+
+    return result;
+}
+
+size_t IoTHubTransportPool_GetConnectionCount(IOTHUB_TRANSPORT_POOL_HANDLE transportPoolHandle)
+{
+    /*Codes_SRS_IOTHUBTRANSPORTPOOL_41_010: [ IoTHubTransportPool_GetConnectionCount shall return the number of connections of the pool, or 0 if transportPoolHandle is NULL. ]*/
+    return (transportPoolHandle == NULL) ? 0 : transportPoolHandle->connectionCount;
+}
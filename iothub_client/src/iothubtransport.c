@@ -11,6 +11,7 @@
 #include "internal/iothub_client_private.h"
 #include "azure_c_shared_utility/threadapi.h"
 #include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/vector.h"
 
@@ -29,11 +30,65 @@ typedef struct TRANSPORT_HANDLE_DATA_TAG
     VECTOR_HANDLE clients;
     LOCK_HANDLE clientsLockHandle;
     IOTHUB_CLIENT_MULTIPLEXED_DO_WORK clientDoWork;
+    /*clients that called IoTHubTransport_SignalClientWork since the last tick. workLockHandle is
+    only ever taken last, so clients may signal while holding the transport lock*/
+    VECTOR_HANDLE clientsWithWork;
+    VECTOR_HANDLE clientsDoingWork; /*swapped with clientsWithWork by the worker, so a tick allocates nothing*/
+    LOCK_HANDLE workLockHandle;
+    COND_HANDLE workCondition;
 } TRANSPORT_HANDLE_DATA;
 
+#define WORKER_TICK_MS 1
+
 /* Used for Unit test */
 const size_t IoTHubTransport_ThreadTerminationOffset = offsetof(TRANSPORT_HANDLE_DATA, stopThread);
 
+static void destroy_work_queue(TRANSPORT_HANDLE_DATA* transportData)
+{
+    if (transportData->workCondition != NULL)
+    {
+        Condition_Deinit(transportData->workCondition);
+    }
+    if (transportData->workLockHandle != NULL)
+    {
+        Lock_Deinit(transportData->workLockHandle);
+    }
+    if (transportData->clientsDoingWork != NULL)
+    {
+        VECTOR_destroy(transportData->clientsDoingWork);
+    }
+    if (transportData->clientsWithWork != NULL)
+    {
+        VECTOR_destroy(transportData->clientsWithWork);
+    }
+}
+
+static int create_work_queue(TRANSPORT_HANDLE_DATA* transportData)
+{
+    int result;
+
+    transportData->clientsDoingWork = NULL;
+    transportData->workLockHandle = NULL;
+    transportData->workCondition = NULL;
+
+    /*Codes_SRS_IOTHUBTRANSPORT_41_001: [ IoTHubTransport_Create shall create the list of clients with pending work, the lock guarding it and the condition the worker thread waits on. ]*/
+    if (((transportData->clientsWithWork = VECTOR_create(sizeof(IOTHUB_CLIENT_CORE_HANDLE))) == NULL) ||
+        ((transportData->clientsDoingWork = VECTOR_create(sizeof(IOTHUB_CLIENT_CORE_HANDLE))) == NULL) ||
+        ((transportData->workLockHandle = Lock_Init()) == NULL) ||
+        ((transportData->workCondition = Condition_Init()) == NULL))
+    {
+        LogError("client work queue not created.");
+        destroy_work_queue(transportData);
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = 0;
+    }
+
+    return result;
+}
+
 TRANSPORT_HANDLE IoTHubTransport_Create(IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol, const char* iotHubName, const char* iotHubSuffix)
 {
     TRANSPORT_HANDLE_DATA *result;
@@ -121,6 +176,16 @@ TRANSPORT_HANDLE IoTHubTransport_Create(IOTHUB_CLIENT_TRANSPORT_PROVIDER protoco
                         free(result);
                         result = NULL;
                     }
+                    else if (create_work_queue(result) != 0)
+                    {
+                        /*Codes_SRS_IOTHUBTRANSPORT_41_002: [ If creating the work list, its lock or the condition fails, IoTHubTransport_Create shall release all resources it created and return NULL. ]*/
+                        VECTOR_destroy(result->clients);
+                        Lock_Deinit(result->clientsLockHandle);
+                        Lock_Deinit(result->lockHandle);
+                        transportProtocol->IoTHubTransport_Destroy(result->transportLLHandle);
+                        free(result);
+                        result = NULL;
+                    }
                     else
                     {
                         /*Codes_SRS_IOTHUBTRANSPORT_17_001: [ IoTHubTransport_Create shall return a non-NULL handle on success.]*/
@@ -155,17 +220,36 @@ static void multiplexed_client_do_work(TRANSPORT_HANDLE_DATA* transportData)
     }
     else
     {
-        size_t numberOfClients;
-        size_t iterator;
-
-        numberOfClients = VECTOR_size(transportData->clients);
-        for (iterator = 0; iterator < numberOfClients; iterator++)
+        if (Lock(transportData->workLockHandle) != LOCK_OK)
+        {
+            LogError("failed to lock the client work list");
+        }
+        else
         {
-            IOTHUB_CLIENT_CORE_HANDLE* clientHandle = (IOTHUB_CLIENT_CORE_HANDLE*)VECTOR_element(transportData->clients, iterator);
+            VECTOR_HANDLE clientsWithWork = transportData->clientsWithWork;
+            size_t numberOfClients;
+            size_t iterator;
+
+            transportData->clientsWithWork = transportData->clientsDoingWork;
+            transportData->clientsDoingWork = clientsWithWork;
+            (void)Unlock(transportData->workLockHandle);
+
+            /*Codes_SRS_IOTHUBTRANSPORT_41_003: [ Each tick the worker thread shall call the client DoWork only for the clients that signaled work since the previous tick, once per client. ]*/
+            /*clients stay in clientsWithWork only while registered, and clientsLockHandle keeps them registered until this loop ends*/
+            numberOfClients = VECTOR_size(clientsWithWork);
+            for (iterator = 0; iterator < numberOfClients; iterator++)
+            {
+                IOTHUB_CLIENT_CORE_HANDLE* clientHandle = (IOTHUB_CLIENT_CORE_HANDLE*)VECTOR_element(clientsWithWork, iterator);
+
+                if (clientHandle != NULL)
+                {
+                    transportData->clientDoWork(*clientHandle);
+                }
+            }
 
-            if (clientHandle != NULL)
+            if (numberOfClients > 0)
             {
-                transportData->clientDoWork(*clientHandle);
+                VECTOR_clear(clientsWithWork);
             }
         }
 
@@ -176,6 +260,24 @@ static void multiplexed_client_do_work(TRANSPORT_HANDLE_DATA* transportData)
     }
 }
 
+static void wait_for_client_work(TRANSPORT_HANDLE_DATA* transportData)
+{
+    if (Lock(transportData->workLockHandle) != LOCK_OK)
+    {
+        LogError("failed to lock for wait_for_client_work");
+        ThreadAPI_Sleep(WORKER_TICK_MS);
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBTRANSPORT_41_004: [ Between ticks the worker thread shall wait on the condition for at most 1 ms, and not at all if a client signaled work or the thread was told to end. ]*/
+        if ((VECTOR_size(transportData->clientsWithWork) == 0) && (transportData->stopThread == 0))
+        {
+            (void)Condition_Wait(transportData->workCondition, transportData->workLockHandle, WORKER_TICK_MS);
+        }
+        (void)Unlock(transportData->workLockHandle);
+    }
+}
+
 static int transport_worker_thread(void* threadArgument)
 {
     TRANSPORT_HANDLE_DATA* transportData = (TRANSPORT_HANDLE_DATA*)threadArgument;
@@ -203,7 +305,7 @@ static int transport_worker_thread(void* threadArgument)
         multiplexed_client_do_work(transportData);
 
         /*Codes_SRS_IOTHUBTRANSPORT_17_029: [ The thread shall call lower layer transport DoWork every 1 ms. ]*/
-        ThreadAPI_Sleep(1);
+        wait_for_client_work(transportData);
     }
 
     ThreadAPI_Exit(0);
@@ -289,6 +391,8 @@ static void stop_worker_thread(TRANSPORT_HANDLE_DATA* transportData)
         (void)Unlock(transportData->lockHandle);
     }
 
+    /*wakes the worker thread if it is waiting for client work*/
+    (void)Condition_Post(transportData->workCondition);
 }
 
 static void wait_worker_thread(TRANSPORT_HANDLE_DATA * transportData)
@@ -324,6 +428,21 @@ static bool signal_end_worker_thread(TRANSPORT_HANDLE_DATA * transportData, IOTH
         {
             /*Codes_SRS_IOTHUBTRANSPORT_17_026: [ IoTHubTransport_EndWorkerThread shall remove clientHandlehandle from handle list. ]*/
             VECTOR_erase(transportData->clients, element, 1);
+
+            /*Codes_SRS_IOTHUBTRANSPORT_41_005: [ IoTHubTransport_EndWorkerThread shall also remove clientHandle from the clients with pending work. ]*/
+            if (Lock(transportData->workLockHandle) != LOCK_OK)
+            {
+                LogError("failed to lock the client work list");
+            }
+            else
+            {
+                void* pending = VECTOR_find_if(transportData->clientsWithWork, find_by_handle, clientHandle);
+                if (pending != NULL)
+                {
+                    VECTOR_erase(transportData->clientsWithWork, pending, 1);
+                }
+                (void)Unlock(transportData->workLockHandle);
+            }
         }
         /*Codes_SRS_IOTHUBTRANSPORT_17_025: [ If the worker thread does not exist, then IoTHubTransport_EndWorkerThread shall return. ]*/
         if (transportData->workerThreadHandle != NULL)
@@ -365,6 +484,7 @@ void IoTHubTransport_Destroy(TRANSPORT_HANDLE transportHandle)
         (transportData->IoTHubTransport_Destroy)(transportData->transportLLHandle);
         VECTOR_destroy(transportData->clients);
         Lock_Deinit(transportData->clientsLockHandle);
+        destroy_work_queue(transportData);
         free(transportHandle);
     }
 }
@@ -463,3 +583,34 @@ void IoTHubTransport_JoinWorkerThread(TRANSPORT_HANDLE transportHandle, IOTHUB_C
         wait_worker_thread(transportData);
     }
 }
+
+void IoTHubTransport_SignalClientWork(TRANSPORT_HANDLE transportHandle, IOTHUB_CLIENT_CORE_HANDLE clientHandle)
+{
+    /*Codes_SRS_IOTHUBTRANSPORT_41_006: [ If transportHandle or clientHandle is NULL, IoTHubTransport_SignalClientWork shall do nothing. ]*/
+    if (transportHandle == NULL || clientHandle == NULL)
+    {
+        LogError("Invalid argument transportHandle=%p, clientHandle=%p", transportHandle, clientHandle);
+    }
+    else
+    {
+        TRANSPORT_HANDLE_DATA * transportData = (TRANSPORT_HANDLE_DATA*)transportHandle;
+        if (Lock(transportData->workLockHandle) != LOCK_OK)
+        {
+            LogError("failed to lock the client work list");
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBTRANSPORT_41_007: [ IoTHubTransport_SignalClientWork shall add clientHandle to the clients with pending work, unless it is already there, and wake the worker thread. ]*/
+            if ((VECTOR_find_if(transportData->clientsWithWork, find_by_handle, clientHandle) == NULL) &&
+                (VECTOR_push_back(transportData->clientsWithWork, &clientHandle, 1) != 0))
+            {
+                LogError("Failed adding client to the work list (VECTOR_push_back failed)");
+            }
+            else
+            {
+                (void)Condition_Post(transportData->workCondition);
+            }
+            (void)Unlock(transportData->workLockHandle);
+        }
+    }
+}
@@ -16,6 +16,8 @@
 #define IOTHUB_DEVICES_MODULE_PATH_FMT            "%s/devices/%s/modules/%s"
 #define DEFAULT_CBS_REQUEST_TIMEOUT_SECS          UINT32_MAX
 #define SAS_REFRESH_MULTIPLIER                    .8
+#define SAS_REFRESH_JITTER_MULTIPLIER             .1
+#define SAS_REFRESH_JITTER_STEPS                  1000
 
 typedef struct AUTHENTICATION_INSTANCE_TAG
 {
@@ -38,6 +40,7 @@ typedef struct AUTHENTICATION_INSTANCE_TAG
     bool is_sas_token_refresh_in_progress;
 
     time_t current_sas_token_put_time;
+    double sas_token_refresh_multiplier;
 
     // Auth module used to generating handle authorization
     // with either SAS Token, x509 Certs, and Device SAS Token
@@ -126,7 +129,8 @@ static int verify_sas_token_refresh_timeout(AUTHENTICATION_INSTANCE* instance, b
             result = __FAILURE__;
             LogError("Failed verifying if SAS token refresh timed out (get_time failed)");
         }
-        else if ((uint32_t)get_difftime(current_time, instance->current_sas_token_put_time) >= (sas_token_expiry*SAS_REFRESH_MULTIPLIER))
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_41_001: [The SAS token shall be refreshed once the time since `instance->current_sas_token_put_time` reaches `instance->sas_token_refresh_multiplier` of the SAS token expiry]
+        else if ((uint32_t)get_difftime(current_time, instance->current_sas_token_put_time) >= (sas_token_expiry*instance->sas_token_refresh_multiplier))
         {
             *is_timed_out = true;
             result = RESULT_OK;
@@ -140,6 +144,29 @@ static int verify_sas_token_refresh_timeout(AUTHENTICATION_INSTANCE* instance, b
     return result;
 }
 
+// Spreads the SAS token refreshes of devices created together over SAS_REFRESH_JITTER_MULTIPLIER of the token lifetime,
+// using the device and module ids so each device always refreshes at the same point.
+static double get_sas_token_refresh_multiplier(const char* device_id, const char* module_id)
+{
+    size_t hash = 5381;
+    const char* c;
+
+    for (c = device_id; *c != '\0'; c++)
+    {
+        hash = ((hash << 5) + hash) + (unsigned char)*c;
+    }
+
+    if (module_id != NULL)
+    {
+        for (c = module_id; *c != '\0'; c++)
+        {
+            hash = ((hash << 5) + hash) + (unsigned char)*c;
+        }
+    }
+
+    return SAS_REFRESH_MULTIPLIER - SAS_REFRESH_JITTER_MULTIPLIER * (double)(hash % SAS_REFRESH_JITTER_STEPS) / SAS_REFRESH_JITTER_STEPS;
+}
+
 static STRING_HANDLE create_device_and_module_path(STRING_HANDLE iothub_host_fqdn, const char* device_id, const char* module_id)
 {
     STRING_HANDLE devices_and_modules_path;
@@ -557,6 +584,9 @@ AUTHENTICATION_HANDLE authentication_create(const AUTHENTICATION_CONFIG* config)
 
                 instance->module_id = IoTHubClient_Auth_Get_ModuleId(config->authorization_module);
 
+                // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_41_002: [authentication_create() shall set `instance->sas_token_refresh_multiplier` between 0.7 and 0.8, derived from the device and module ids]
+                instance->sas_token_refresh_multiplier = get_sas_token_refresh_multiplier(instance->device_id, instance->module_id);
+
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_018: [authentication_create() shall save `config->on_state_changed_callback` and `config->on_state_changed_callback_context` into `instance->on_state_changed_callback` and `instance->on_state_changed_callback_context`.]
                 instance->on_state_changed_callback = config->on_state_changed_callback;
                 instance->on_state_changed_callback_context = config->on_state_changed_callback_context;
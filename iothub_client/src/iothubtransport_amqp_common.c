@@ -2,6 +2,7 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
 #include <stdlib.h>
+#include <string.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <time.h>
@@ -31,6 +32,9 @@
 #include "internal/iothub_client_private.h"
 #include "internal/iothubtransportamqp_methods.h"
 #include "internal/iothub_client_retry_control.h"
+#include "internal/iothub_client_trace_ring_private.h"
+#include "internal/iothub_client_startup_timeline_private.h"
+#include "internal/iothub_client_connect_admission_private.h"
 #include "internal/iothubtransport_amqp_common.h"
 #include "internal/iothubtransport_amqp_connection.h"
 #include "internal/iothubtransport_amqp_device.h"
@@ -51,6 +55,7 @@
 // DEFAULT_MAX_RETRY_TIME_IN_SECS = 0 means infinite retry.
 #define DEFAULT_MAX_RETRY_TIME_IN_SECS            0
 #define MAX_SERVICE_KEEP_ALIVE_RATIO              0.9
+#define DEVICE_INDEX_BUCKET_COUNT                 64
 
 // ---------- Data Definitions ---------- //
 
@@ -103,8 +108,10 @@ typedef struct AMQP_TRANSPORT_INSTANCE_TAG
     AMQP_CONNECTION_STATE amqp_connection_state;                        // Current state of the amqp_connection.
     AMQP_TRANSPORT_AUTHENTICATION_MODE preferred_authentication_mode;   // Used to avoid registered devices using different authentication modes.
     SINGLYLINKEDLIST_HANDLE registered_devices;                         // List of devices currently registered in this transport.
+    struct AMQP_TRANSPORT_DEVICE_INSTANCE_TAG* device_index[DEVICE_INDEX_BUCKET_COUNT]; // Registered devices by hash of their id, so registering does not scan registered_devices.
     bool is_trace_on;                                                   // Turns logging on and off.
     OPTIONHANDLER_HANDLE saved_tls_options;                             // Here are the options from the xio layer if any is saved.
+    bool saved_tls_options_current;                                     // No option was passed to `tls_io` since `saved_tls_options` was taken.
     AMQP_TRANSPORT_STATE state;                                         // Current state of the transport.
     RETRY_CONTROL_HANDLE connection_retry_control;                      // Controls when the re-connection attempt should occur.
     size_t svc2cl_keep_alive_timeout_secs;                       // Service to device keep alive frequency
@@ -117,6 +124,16 @@ typedef struct AMQP_TRANSPORT_INSTANCE_TAG
 
     size_t option_cbs_request_timeout_secs;                             // Device-specific option.
     size_t option_send_event_timeout_secs;                              // Device-specific option.
+    size_t option_batch_linger_ms;                                      // Device-specific option.
+    size_t option_batch_max_messages;                                   // Device-specific option.
+    size_t option_c2d_link_credit;                                      // Device-specific option.
+    size_t option_twin_link_idle_timeout_secs;                          // Device-specific option.
+    size_t option_methods_link_credit;                                  // Applied to the methods handle of each registered device.
+    bool option_tls_session_resumption;                                 // Applied to every TLS I/O created.
+    size_t option_cbs_auth_window;                                      // Most registered devices allowed in DEVICE_STATE_STARTING at once; 0 is unbounded.
+    size_t number_of_devices_starting;                                  // Registered devices currently in DEVICE_STATE_STARTING.
+    size_t option_device_idle_suspend_secs;                             // Seconds a registered device may stay idle before it is suspended; 0 never suspends.
+    size_t option_amqp_session_count;                                   // Sessions the devices' links are spread over, on the next connection; 0 or 1 is a single session.
 
                                                                         // Auth module used to generating handle authorization
     IOTHUB_AUTHORIZATION_HANDLE authorization_module;                   // with either SAS Token, x509 Certs, and Device SAS Token
@@ -142,6 +159,14 @@ typedef struct AMQP_TRANSPORT_DEVICE_INSTANCE_TAG
     bool subscribe_methods_needed;                                       // Indicates if should subscribe for device methods.
     // is the transport subscribed for methods?
     bool subscribed_for_methods;                                         // Indicates if device is subscribed for device methods.
+    bool subscribed_for_messages;                                        // Indicates if device is subscribed for C2D messages.
+    bool subscribed_for_twin;                                            // Indicates if device is subscribed for twin updates.
+
+    bool is_suspended;                                                  // Stopped for being idle; started again on the next DoWork once it has work to do.
+    time_t time_of_last_activity;                                       // Time the device last started, sent events or got a twin request; used to suspend idle devices.
+
+    size_t device_id_hash;                                              // Hash of the device id, used to place the device in `transport_instance->device_index`.
+    struct AMQP_TRANSPORT_DEVICE_INSTANCE_TAG* next_in_index;           // Next device in the same `transport_instance->device_index` bucket.
 
     TRANSPORT_CALLBACKS_INFO transport_callbacks;
     void* transport_ctx;
@@ -271,6 +296,16 @@ static void raise_connection_status_callback_retry_expired(const void* item, con
     *continue_processing = true;
 }
 
+// @brief
+//     Forwards a statistic to the upper layer, if it collects them.
+static void report_statistic(const TRANSPORT_CALLBACKS_INFO* transport_callbacks, void* transport_ctx, TRANSPORT_STATISTIC statistic, IOTHUB_MESSAGE_LIST* message, size_t size)
+{
+    if (transport_callbacks->statistics_cb != NULL)
+    {
+        transport_callbacks->statistics_cb(statistic, message, size, transport_ctx);
+    }
+}
+
 // @brief
 //     Saves the new state, if it is different than the previous one.
 static void on_device_state_changed_callback(void* context, DEVICE_STATE previous_state, DEVICE_STATE new_state)
@@ -279,13 +314,32 @@ static void on_device_state_changed_callback(void* context, DEVICE_STATE previou
     if (context != NULL && new_state != previous_state)
     {
         AMQP_TRANSPORT_DEVICE_INSTANCE* registered_device = (AMQP_TRANSPORT_DEVICE_INSTANCE*)context;
+        IOTHUB_CLIENT_TRACE(IOTHUB_CLIENT_TRACE_AMQP_DEVICE_STATE, registered_device, previous_state, new_state);
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_062: [If `new_state` shall be saved into the `registered_device` instance]
         registered_device->device_state = new_state;
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_063: [If `registered_device->time_of_last_state_change` shall be set using get_time()]
         registered_device->time_of_last_state_change = get_time(NULL);
 
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_004: [Devices entering DEVICE_STATE_STARTING shall be counted in `instance->number_of_devices_starting`, and no longer counted once they leave it]
+        if (new_state == DEVICE_STATE_STARTING)
+        {
+            registered_device->transport_instance->number_of_devices_starting++;
+
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_006: [If `new_state` is DEVICE_STATE_STARTING, TRANSPORT_STATISTIC_AUTHENTICATION_STARTED shall be reported]
+            report_statistic(&registered_device->transport_callbacks, registered_device->transport_ctx, TRANSPORT_STATISTIC_AUTHENTICATION_STARTED, NULL, 0);
+        }
+        else if (previous_state == DEVICE_STATE_STARTING && registered_device->transport_instance->number_of_devices_starting > 0)
+        {
+            registered_device->transport_instance->number_of_devices_starting--;
+        }
+
         if (new_state == DEVICE_STATE_STARTED)
         {
+            registered_device->time_of_last_activity = registered_device->time_of_last_state_change;
+
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_007: [If `new_state` is DEVICE_STATE_STARTED, TRANSPORT_STATISTIC_AUTHENTICATED shall be reported]
+            report_statistic(&registered_device->transport_callbacks, registered_device->transport_ctx, TRANSPORT_STATISTIC_AUTHENTICATED, NULL, 0);
+
             // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_127: [If `new_state` is DEVICE_STATE_STARTED, retry_control_reset() shall be invoked passing `instance->connection_retry_control`]
             reset_retry_control(registered_device);
 
@@ -295,7 +349,12 @@ static void on_device_state_changed_callback(void* context, DEVICE_STATE previou
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_121: [If `new_state` is DEVICE_STATE_STOPPED, IoTHubClientCore_LL_ConnectionStatusCallBack shall be invoked with IOTHUB_CLIENT_CONNECTION_UNAUTHENTICATED and IOTHUB_CLIENT_CONNECTION_OK]
         else if (new_state == DEVICE_STATE_STOPPED)
         {
-            if (registered_device->transport_instance->state == AMQP_TRANSPORT_STATE_CONNECTED ||
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_020: [If `new_state` is DEVICE_STATE_STOPPED and the device is suspended, the connection status callback shall not be invoked]
+            if (registered_device->is_suspended)
+            {
+                LogInfo("Device '%s' suspended while idle", STRING_c_str(registered_device->device_id));
+            }
+            else if (registered_device->transport_instance->state == AMQP_TRANSPORT_STATE_CONNECTED ||
                 registered_device->transport_instance->state == AMQP_TRANSPORT_STATE_BEING_DESTROYED)
             {
                 registered_device->transport_callbacks.connection_status_cb(IOTHUB_CLIENT_CONNECTION_UNAUTHENTICATED, IOTHUB_CLIENT_CONNECTION_OK, registered_device->transport_ctx);
@@ -366,6 +425,69 @@ static bool is_device_registered(AMQP_TRANSPORT_DEVICE_INSTANCE* amqp_device_ins
     return is_device_registered_ex(amqp_device_instance->transport_instance->registered_devices, device_id, &list_item);
 }
 
+static size_t get_device_id_hash(const char* device_id)
+{
+    // djb2
+    size_t result = 5381;
+
+    while (*device_id != '\0')
+    {
+        result = (result * 33) ^ (unsigned char)*device_id++;
+    }
+
+    return result;
+}
+
+// @brief       Finds a registered device by id using `transport->device_index`.
+// @returns     The registered device, or NULL if no device with that id is registered.
+static AMQP_TRANSPORT_DEVICE_INSTANCE* find_indexed_device(AMQP_TRANSPORT_INSTANCE* transport, const char* device_id)
+{
+    size_t hash = get_device_id_hash(device_id);
+    AMQP_TRANSPORT_DEVICE_INSTANCE* result = transport->device_index[hash % DEVICE_INDEX_BUCKET_COUNT];
+
+    while (result != NULL)
+    {
+        const char* indexed_device_id;
+
+        if (result->device_id_hash == hash &&
+            (indexed_device_id = STRING_c_str(result->device_id)) != NULL &&
+            strcmp(indexed_device_id, device_id) == 0)
+        {
+            break;
+        }
+
+        result = result->next_in_index;
+    }
+
+    return result;
+}
+
+static void add_device_to_index(AMQP_TRANSPORT_INSTANCE* transport, AMQP_TRANSPORT_DEVICE_INSTANCE* device, const char* device_id)
+{
+    AMQP_TRANSPORT_DEVICE_INSTANCE** bucket;
+
+    device->device_id_hash = get_device_id_hash(device_id);
+    bucket = &transport->device_index[device->device_id_hash % DEVICE_INDEX_BUCKET_COUNT];
+    device->next_in_index = *bucket;
+    *bucket = device;
+}
+
+static void remove_device_from_index(AMQP_TRANSPORT_INSTANCE* transport, AMQP_TRANSPORT_DEVICE_INSTANCE* device)
+{
+    AMQP_TRANSPORT_DEVICE_INSTANCE** link = &transport->device_index[device->device_id_hash % DEVICE_INDEX_BUCKET_COUNT];
+
+    while (*link != NULL && *link != device)
+    {
+        link = &(*link)->next_in_index;
+    }
+
+    if (*link != NULL)
+    {
+        *link = device->next_in_index;
+        device->next_in_index = NULL;
+    }
+}
+
 static size_t get_number_of_registered_devices(AMQP_TRANSPORT_INSTANCE* transport)
 {
     size_t result = 0;
@@ -462,12 +584,60 @@ static DEVICE_MESSAGE_DISPOSITION_RESULT get_device_disposition_result_from(IOTH
     return device_disposition_result;
 }
 
+static size_t get_message_payload_size(IOTHUB_MESSAGE_HANDLE message)
+{
+    size_t result;
+    IOTHUBMESSAGE_CONTENT_TYPE content_type = IoTHubMessage_GetContentType(message);
+
+    if (content_type == IOTHUBMESSAGE_BYTEARRAY)
+    {
+        const unsigned char* buffer;
+        if (IoTHubMessage_GetByteArray(message, &buffer, &result) != IOTHUB_MESSAGE_OK)
+        {
+            result = 0;
+        }
+    }
+    else if (content_type == IOTHUBMESSAGE_STRING)
+    {
+        const char* string = IoTHubMessage_GetString(message);
+        result = (string == NULL) ? 0 : strlen(string);
+    }
+    else
+    {
+        result = 0;
+    }
+
+    return result;
+}
+
+// @brief
+//     Same as report_statistic, with the size of the payload of `payload`. The size is only computed if the upper layer collects statistics.
+static void report_message_statistic(const TRANSPORT_CALLBACKS_INFO* transport_callbacks, void* transport_ctx, TRANSPORT_STATISTIC statistic, IOTHUB_MESSAGE_LIST* message, IOTHUB_MESSAGE_HANDLE payload)
+{
+    if (transport_callbacks->statistics_cb != NULL)
+    {
+        report_statistic(transport_callbacks, transport_ctx, statistic, message, get_message_payload_size(payload));
+    }
+}
+
+// Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_001: [Each batch of events sent by a registered device shall be reported as TRANSPORT_STATISTIC_BATCH_SENT with its size, followed by TRANSPORT_STATISTIC_BATCH_CAPACITY with the maximum batch size]
+static void on_device_batch_sent(size_t event_count, size_t batch_size, size_t batch_capacity, void* context)
+{
+    AMQP_TRANSPORT_DEVICE_INSTANCE* registered_device = (AMQP_TRANSPORT_DEVICE_INSTANCE*)context;
+
+    (void)event_count;
+    report_statistic(&registered_device->transport_callbacks, registered_device->transport_ctx, TRANSPORT_STATISTIC_BATCH_SENT, NULL, batch_size);
+    report_statistic(&registered_device->transport_callbacks, registered_device->transport_ctx, TRANSPORT_STATISTIC_BATCH_CAPACITY, NULL, batch_capacity);
+}
+
 static DEVICE_MESSAGE_DISPOSITION_RESULT on_message_received(IOTHUB_MESSAGE_HANDLE message, DEVICE_MESSAGE_DISPOSITION_INFO* disposition_info, void* context)
 {
     AMQP_TRANSPORT_DEVICE_INSTANCE* amqp_device_instance = (AMQP_TRANSPORT_DEVICE_INSTANCE*)context;
     DEVICE_MESSAGE_DISPOSITION_RESULT device_disposition_result;
     MESSAGE_CALLBACK_INFO* message_data;
 
+    report_message_statistic(&amqp_device_instance->transport_callbacks, amqp_device_instance->transport_ctx, TRANSPORT_STATISTIC_BYTES_RECEIVED, NULL, message);
+
     if ((message_data = MESSAGE_CALLBACK_INFO_Create(message, disposition_info, amqp_device_instance)) == NULL)
     {
         LogError("Failed processing message received (failed to assemble callback info)");
@@ -514,6 +684,8 @@ static int on_method_request_received(void* context, const char* method_name, co
     int result;
     AMQP_TRANSPORT_DEVICE_INSTANCE* device_state = (AMQP_TRANSPORT_DEVICE_INSTANCE*)context;
 
+    report_statistic(&device_state->transport_callbacks, device_state->transport_ctx, TRANSPORT_STATISTIC_BYTES_RECEIVED, NULL, request_size);
+
     /* Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_01_017: [ `on_methods_request_received` shall call the `IoTHubClientCore_LL_DeviceMethodComplete` passing the method name, request buffer and size and the newly created BUFFER handle. ]*/
     /* Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_01_022: [ The status code shall be the return value of the call to `IoTHubClientCore_LL_DeviceMethodComplete`. ]*/
     if (device_state->transport_callbacks.method_complete_cb(method_name, request, request_size, (void*)method_handle, device_state->transport_ctx) != 0)
@@ -540,7 +712,8 @@ static int subscribe_methods(AMQP_TRANSPORT_DEVICE_INSTANCE* deviceState)
     {
         SESSION_HANDLE session_handle;
 
-        if ((amqp_connection_get_session_handle(deviceState->transport_instance->amqp_connection, &session_handle)) != RESULT_OK)
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_023: [The methods shall be subscribed on the session of the device, got using amqp_connection_get_session_handle_by_key() with the hash of the device id]
+        if ((amqp_connection_get_session_handle_by_key(deviceState->transport_instance->amqp_connection, deviceState->device_id_hash, &session_handle)) != RESULT_OK)
         {
             LogError("Device '%s' failed subscribing for methods (failed getting session handle)", STRING_c_str(deviceState->device_id));
             result = __FAILURE__;
@@ -594,6 +767,8 @@ static void on_device_twin_update_received_callback(DEVICE_TWIN_UPDATE_TYPE upda
     {
         AMQP_TRANSPORT_DEVICE_INSTANCE* registered_device = (AMQP_TRANSPORT_DEVICE_INSTANCE*)context;
 
+        report_statistic(&registered_device->transport_instance->transport_callbacks, registered_device->transport_instance->transport_ctx, TRANSPORT_STATISTIC_BYTES_RECEIVED, NULL, length);
+
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_138: [If `update_type` is DEVICE_TWIN_UPDATE_TYPE_PARTIAL IoTHubClientCore_LL_RetrievePropertyComplete shall be invoked passing `context` as handle, `DEVICE_TWIN_UPDATE_PARTIAL`, `payload` and `size`.]
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_139: [If `update_type` is DEVICE_TWIN_UPDATE_TYPE_COMPLETE IoTHubClientCore_LL_RetrievePropertyComplete shall be invoked passing `context` as handle, `DEVICE_TWIN_UPDATE_COMPLETE`, `payload` and `size`.]
         registered_device->transport_instance->transport_callbacks.twin_retrieve_prop_complete_cb((update_type == DEVICE_TWIN_UPDATE_TYPE_COMPLETE ? DEVICE_TWIN_UPDATE_COMPLETE : DEVICE_TWIN_UPDATE_PARTIAL),
@@ -631,6 +806,10 @@ static void on_device_get_twin_completed_callback(DEVICE_TWIN_UPDATE_TYPE update
 //     and the options previously set must persist.
 //
 //     If no TLS I/O instance was created yet, results in failure.
+//
+//     Retrieving the options clones every certificate and key of the TLS I/O, so the saved ones are kept
+//     if no option was passed to it since; with TLS session resumption they are always retrieved again,
+//     as they carry the TLS session of the last connection.
 // @returns
 //     0 if succeeds, non-zero otherwise.
 static int save_underlying_io_transport_options(AMQP_TRANSPORT_INSTANCE* transport_instance)
@@ -642,6 +821,13 @@ static int save_underlying_io_transport_options(AMQP_TRANSPORT_INSTANCE* transpo
         LogError("failed saving underlying I/O transport options (tls_io instance is NULL)");
         result = __FAILURE__;
     }
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_025: [If `instance->saved_tls_options` is set, no option was passed to `instance->tls_io` since it was retrieved and `instance->option_tls_session_resumption` is false, it shall be kept instead of retrieved again]
+    else if (transport_instance->saved_tls_options != NULL &&
+        transport_instance->saved_tls_options_current &&
+        !transport_instance->option_tls_session_resumption)
+    {
+        result = RESULT_OK;
+    }
     else
     {
         OPTIONHANDLER_HANDLE fresh_options;
@@ -655,6 +841,7 @@ static int save_underlying_io_transport_options(AMQP_TRANSPORT_INSTANCE* transpo
         {
             OPTIONHANDLER_HANDLE previous_options = transport_instance->saved_tls_options;
             transport_instance->saved_tls_options = fresh_options;
+            transport_instance->saved_tls_options_current = true;
 
             if (previous_options != NULL)
             {
@@ -756,6 +943,13 @@ static int get_new_underlying_io_transport(AMQP_TRANSPORT_INSTANCE* transport_in
             result = RESULT_OK;
         }
 
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_013: [If `instance->option_tls_session_resumption` is true, the new TLS I/O shall get OPTION_TLS_SESSION_RESUMPTION with xio_setoption() before the saved options are restored; a failure shall be logged and ignored]
+        if (transport_instance->option_tls_session_resumption &&
+            xio_setoption(*xio_handle, OPTION_TLS_SESSION_RESUMPTION, &transport_instance->option_tls_session_resumption) != RESULT_OK)
+        {
+            LogInfo("The TLS I/O does not support session resumption; reconnections will run a full handshake");
+        }
+
         if (restore_underlying_io_transport_options(transport_instance, *xio_handle) != RESULT_OK)
         {
             /*pessimistically hope TLS will fail, be recreated and options re-given*/
@@ -803,6 +997,9 @@ static int establish_amqp_connection(AMQP_TRANSPORT_INSTANCE* transport_instance
 {
     int result;
 
+    /*opening the TLS I/O resolves the name, connects and runs the handshake; the CBS authentication follows*/
+    IOTHUB_CLIENT_STARTUP_MARK(IOTHUB_CLIENT_STARTUP_CONNECT_STARTED);
+
     if (transport_instance->preferred_authentication_mode == AMQP_TRANSPORT_AUTHENTICATION_MODE_NOT_SET)
     {
         LogError("Failed establishing connection (transport doesn't have a preferred authentication mode set; unexpected!).");
@@ -831,6 +1028,8 @@ static int establish_amqp_connection(AMQP_TRANSPORT_INSTANCE* transport_instance
         amqp_connection_config.svc2cl_keep_alive_timeout_secs = transport_instance->svc2cl_keep_alive_timeout_secs;
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_99_001: [AMQP connection will be configured using the `remote_idle_timeout_ratio` value from SetOption ]
         amqp_connection_config.cl2svc_keep_alive_send_ratio = transport_instance->cl2svc_keep_alive_send_ratio;
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_022: [`instance->option_amqp_session_count` shall be set into `AMQP_CONNECTION_CONFIG->session_count`]
+        amqp_connection_config.session_count = transport_instance->option_amqp_session_count;
 
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_027: [If `transport->preferred_authentication_method` is CBS, AMQP_CONNECTION_CONFIG shall be set with `create_sasl_io` = true and `create_cbs_connection` = true]
         if (transport_instance->preferred_authentication_mode == AMQP_TRANSPORT_AUTHENTICATION_MODE_CBS)
@@ -1047,6 +1246,10 @@ static void on_event_send_complete(IOTHUB_MESSAGE_LIST* message, D2C_EVENT_SEND_
         message->callback(iothub_send_result, message->context);
     }
 
+    // the upper layer never sees this event again, so its completion is reported here
+    report_statistic(&registered_device->transport_callbacks, registered_device->transport_ctx,
+        (result == D2C_EVENT_SEND_COMPLETE_RESULT_OK) ? TRANSPORT_STATISTIC_EVENT_ACKNOWLEDGED : TRANSPORT_STATISTIC_EVENT_FAILED, message, 0);
+
     // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_057: [`message->messageHandle` shall be destroyed using IoTHubMessage_Destroy]
     IoTHubMessage_Destroy(message->messageHandle);
     // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_058: [`message` shall be destroyed using free]
@@ -1077,11 +1280,72 @@ static int send_pending_events(AMQP_TRANSPORT_DEVICE_INSTANCE* device_state)
             on_event_send_complete(message, D2C_EVENT_SEND_COMPLETE_RESULT_ERROR_FAIL_SENDING, device_state);
             break;
         }
+        else
+        {
+            report_message_statistic(&device_state->transport_callbacks, device_state->transport_ctx, TRANSPORT_STATISTIC_EVENT_PUBLISHED, message, message->messageHandle);
+        }
     }
 
     return result;
 }
 
+// @brief    Verifies if the device has nothing to do and has had nothing to do for `option_device_idle_suspend_secs`.
+// @returns  true if the device can be suspended, false otherwise.
+static bool is_device_idle(AMQP_TRANSPORT_DEVICE_INSTANCE* registered_device)
+{
+    bool result;
+    DEVICE_SEND_STATUS send_status;
+    bool is_timed_out;
+
+    if (registered_device->subscribe_methods_needed ||
+        registered_device->subscribed_for_messages ||
+        registered_device->subscribed_for_twin ||
+        !DList_IsListEmpty(registered_device->waiting_to_send))
+    {
+        result = false;
+    }
+    else if (device_get_send_status(registered_device->device_handle, &send_status) != RESULT_OK || send_status == DEVICE_SEND_STATUS_BUSY)
+    {
+        // Events still waiting for their confirmation count as activity.
+        registered_device->time_of_last_activity = get_time(NULL);
+        result = false;
+    }
+    else if (is_timeout_reached(registered_device->time_of_last_activity, (unsigned int)registered_device->transport_instance->option_device_idle_suspend_secs, &is_timed_out) != RESULT_OK)
+    {
+        LogError("Failed verifying if device '%s' is idle (is_timeout_reached failed)", STRING_c_str(registered_device->device_id));
+        result = false;
+    }
+    else
+    {
+        result = is_timed_out;
+    }
+
+    return result;
+}
+
+static void suspend_device(AMQP_TRANSPORT_DEVICE_INSTANCE* registered_device)
+{
+    // Set before stopping, so the DEVICE_STATE_STOPPED notification already sees it.
+    registered_device->is_suspended = true;
+
+    if (device_stop(registered_device->device_handle) != RESULT_OK)
+    {
+        LogError("Failed suspending idle device '%s' (device_stop failed)", STRING_c_str(registered_device->device_id));
+        registered_device->is_suspended = false;
+    }
+}
+
+// @brief    Lets a suspended device be started on the next DoWork, and restarts its idle time.
+static void resume_device(AMQP_TRANSPORT_DEVICE_INSTANCE* registered_device)
+{
+    registered_device->is_suspended = false;
+
+    if (registered_device->transport_instance->option_device_idle_suspend_secs > 0)
+    {
+        registered_device->time_of_last_activity = get_time(NULL);
+    }
+}
+
 // @brief
 //     Auxiliary function for the public DoWork API, performing DoWork activities (authenticate, messaging) for a specific device.
 // @requires
@@ -1100,10 +1364,26 @@ static int IoTHubTransport_AMQP_Common_Device_DoWork(AMQP_TRANSPORT_DEVICE_INSTA
             SESSION_HANDLE session_handle;
             CBS_HANDLE cbs_handle = NULL;
 
-            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_039: [amqp_connection_get_session_handle() shall be invoked on `instance->connection`]
-            if (amqp_connection_get_session_handle(registered_device->transport_instance->amqp_connection, &session_handle) != RESULT_OK)
+            if (registered_device->is_suspended && !DList_IsListEmpty(registered_device->waiting_to_send))
+            {
+                registered_device->is_suspended = false;
+            }
+
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_018: [If the device is suspended, it shall not be started until it has events waiting to be sent or is resumed by a twin or subscription request]
+            if (registered_device->is_suspended)
+            {
+                result = RESULT_OK;
+            }
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_005: [If `instance->option_cbs_auth_window` devices are already in DEVICE_STATE_STARTING, the device shall not be started until one of them leaves that state]
+            else if (registered_device->transport_instance->option_cbs_auth_window > 0 &&
+                registered_device->transport_instance->number_of_devices_starting >= registered_device->transport_instance->option_cbs_auth_window)
+            {
+                result = RESULT_OK;
+            }
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_039: [amqp_connection_get_session_handle_by_key() shall be invoked on `instance->connection` with the hash of the device id]
+            else if (amqp_connection_get_session_handle_by_key(registered_device->transport_instance->amqp_connection, registered_device->device_id_hash, &session_handle) != RESULT_OK)
             {
-                // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_040: [If amqp_connection_get_session_handle() fails, IoTHubTransport_AMQP_Common_DoWork shall fail and return]
+                // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_040: [If amqp_connection_get_session_handle_by_key() fails, IoTHubTransport_AMQP_Common_DoWork shall fail and return]
                 LogError("Failed performing DoWork for device '%s' (failed to get the amqp_connection session_handle)", STRING_c_str(registered_device->device_id));
                 result = __FAILURE__;
             }
@@ -1195,6 +1475,13 @@ static int IoTHubTransport_AMQP_Common_Device_DoWork(AMQP_TRANSPORT_DEVICE_INSTA
         {
             registered_device->number_of_previous_failures = 0;
             result = RESULT_OK;
+
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_017: [If `instance->option_device_idle_suspend_secs` is not 0, a device with no subscriptions, no events waiting or in flight and no activity for that many seconds shall be suspended using device_stop()]
+            if (registered_device->transport_instance->option_device_idle_suspend_secs > 0 &&
+                is_device_idle(registered_device))
+            {
+                suspend_device(registered_device);
+            }
         }
     }
 
@@ -1223,6 +1510,51 @@ static int replicate_device_options_to(AMQP_TRANSPORT_DEVICE_INSTANCE* dev_insta
         LogError("Failed to apply option DEVICE_OPTION_EVENT_SEND_TIMEOUT_SECS to device '%s' (device_set_option failed)", STRING_c_str(dev_instance->device_id));
         result = __FAILURE__;
     }
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_002: [The batching options shall only be replicated to a new registered device if they were set to a non-zero value]
+    else if (dev_instance->transport_instance->option_batch_linger_ms > 0 &&
+        device_set_option(
+        dev_instance->device_handle,
+        DEVICE_OPTION_BATCH_LINGER_MS,
+        &dev_instance->transport_instance->option_batch_linger_ms) != RESULT_OK)
+    {
+        LogError("Failed to apply option DEVICE_OPTION_BATCH_LINGER_MS to device '%s' (device_set_option failed)", STRING_c_str(dev_instance->device_id));
+        result = __FAILURE__;
+    }
+    else if (dev_instance->transport_instance->option_batch_max_messages > 0 &&
+        device_set_option(
+        dev_instance->device_handle,
+        DEVICE_OPTION_BATCH_MAX_MESSAGES,
+        &dev_instance->transport_instance->option_batch_max_messages) != RESULT_OK)
+    {
+        LogError("Failed to apply option DEVICE_OPTION_BATCH_MAX_MESSAGES to device '%s' (device_set_option failed)", STRING_c_str(dev_instance->device_id));
+        result = __FAILURE__;
+    }
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_009: [The link credit options shall only be replicated to a new registered device if they were set to a non-zero value]
+    else if (dev_instance->transport_instance->option_c2d_link_credit > 0 &&
+        device_set_option(
+        dev_instance->device_handle,
+        DEVICE_OPTION_C2D_LINK_CREDIT,
+        &dev_instance->transport_instance->option_c2d_link_credit) != RESULT_OK)
+    {
+        LogError("Failed to apply option DEVICE_OPTION_C2D_LINK_CREDIT to device '%s' (device_set_option failed)", STRING_c_str(dev_instance->device_id));
+        result = __FAILURE__;
+    }
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_015: [The twin link idle timeout shall only be replicated to a new registered device if it was set to a non-zero value]
+    else if (dev_instance->transport_instance->option_twin_link_idle_timeout_secs > 0 &&
+        device_set_option(
+        dev_instance->device_handle,
+        DEVICE_OPTION_TWIN_LINK_IDLE_TIMEOUT_SECS,
+        &dev_instance->transport_instance->option_twin_link_idle_timeout_secs) != RESULT_OK)
+    {
+        LogError("Failed to apply option DEVICE_OPTION_TWIN_LINK_IDLE_TIMEOUT_SECS to device '%s' (device_set_option failed)", STRING_c_str(dev_instance->device_id));
+        result = __FAILURE__;
+    }
+    else if (dev_instance->transport_instance->option_methods_link_credit > 0 &&
+        iothubtransportamqp_methods_set_link_credit(dev_instance->methods_handle, dev_instance->transport_instance->option_methods_link_credit) != 0)
+    {
+        LogError("Failed to apply option OPTION_METHODS_LINK_CREDIT to device '%s' (iothubtransportamqp_methods_set_link_credit failed)", STRING_c_str(dev_instance->device_id));
+        result = __FAILURE__;
+    }
     else if (auth_mode == DEVICE_AUTH_MODE_CBS)
     {
         if (device_set_option(
@@ -1260,6 +1592,22 @@ static const char* get_device_option_name_from(const char* iothubclient_option_n
     {
         device_option_name = DEVICE_OPTION_EVENT_SEND_TIMEOUT_SECS;
     }
+    else if (strcmp(OPTION_AMQP_BATCH_LINGER_MS, iothubclient_option_name) == 0)
+    {
+        device_option_name = DEVICE_OPTION_BATCH_LINGER_MS;
+    }
+    else if (strcmp(OPTION_AMQP_BATCH_MAX_MESSAGES, iothubclient_option_name) == 0)
+    {
+        device_option_name = DEVICE_OPTION_BATCH_MAX_MESSAGES;
+    }
+    else if (strcmp(OPTION_C2D_LINK_CREDIT, iothubclient_option_name) == 0)
+    {
+        device_option_name = DEVICE_OPTION_C2D_LINK_CREDIT;
+    }
+    else if (strcmp(OPTION_TWIN_LINK_IDLE_TIMEOUT_SECS, iothubclient_option_name) == 0)
+    {
+        device_option_name = DEVICE_OPTION_TWIN_LINK_IDLE_TIMEOUT_SECS;
+    }
     else
     {
         device_option_name = NULL;
@@ -1314,6 +1662,35 @@ static int IoTHubTransport_AMQP_Common_Device_SetOption(TRANSPORT_LL_HANDLE hand
     return result;
 }
 
+static int set_methods_link_credit_on_registered_devices(AMQP_TRANSPORT_INSTANCE* instance)
+{
+    int result = RESULT_OK;
+    LIST_ITEM_HANDLE list_item = singlylinkedlist_get_head_item(instance->registered_devices);
+
+    while (list_item != NULL)
+    {
+        AMQP_TRANSPORT_DEVICE_INSTANCE* registered_device;
+
+        if ((registered_device = (AMQP_TRANSPORT_DEVICE_INSTANCE*)singlylinkedlist_item_get_value(list_item)) == NULL)
+        {
+            LogError("failed setting the methods link credit to registered device (singlylinkedlist_item_get_value failed)");
+            result = __FAILURE__;
+            break;
+        }
+        else if (iothubtransportamqp_methods_set_link_credit(registered_device->methods_handle, instance->option_methods_link_credit) != 0)
+        {
+            LogError("failed setting the methods link credit to registered device '%s' (iothubtransportamqp_methods_set_link_credit failed)",
+                STRING_c_str(registered_device->device_id));
+            result = __FAILURE__;
+            break;
+        }
+
+        list_item = singlylinkedlist_get_next_item(list_item);
+    }
+
+    return result;
+}
+
 static void internal_destroy_instance(AMQP_TRANSPORT_INSTANCE* instance)
 {
     if (instance != NULL)
@@ -1352,37 +1729,6 @@ static void internal_destroy_instance(AMQP_TRANSPORT_INSTANCE* instance)
     }
 }
 
-// ---------- SendMessageDisposition helpers ---------- //
-
-static DEVICE_MESSAGE_DISPOSITION_INFO* create_device_message_disposition_info_from(MESSAGE_CALLBACK_INFO* message_data)
-{
-    DEVICE_MESSAGE_DISPOSITION_INFO* result;
-
-    if ((result = (DEVICE_MESSAGE_DISPOSITION_INFO*)malloc(sizeof(DEVICE_MESSAGE_DISPOSITION_INFO))) == NULL)
-    {
-        LogError("Failed creating DEVICE_MESSAGE_DISPOSITION_INFO (malloc failed)");
-    }
-    else if (mallocAndStrcpy_s(&result->source, message_data->transportContext->link_name) != RESULT_OK)
-    {
-        LogError("Failed creating DEVICE_MESSAGE_DISPOSITION_INFO (mallocAndStrcpy_s failed)");
-        free(result);
-        result = NULL;
-    }
-    else
-    {
-        result->message_id = message_data->transportContext->message_id;
-    }
-
-    return result;
-}
-
-static void destroy_device_message_disposition_info(DEVICE_MESSAGE_DISPOSITION_INFO* device_message_disposition_info)
-{
-    free(device_message_disposition_info->source);
-    free(device_message_disposition_info);
-}
-
-
 // ---------- API functions ---------- //
 
 TRANSPORT_LL_HANDLE IoTHubTransport_AMQP_Common_Create(const IOTHUBTRANSPORT_CONFIG* config, AMQP_GET_IO_TRANSPORT get_io_transport, TRANSPORT_CALLBACKS_INFO* cb_info, void* ctx)
@@ -1468,6 +1814,7 @@ TRANSPORT_LL_HANDLE IoTHubTransport_AMQP_Common_Create(const IOTHUBTRANSPORT_CON
                 instance->transport_callbacks.twin_rpt_state_complete_cb = cb_info->twin_rpt_state_complete_cb;
                 instance->transport_callbacks.twin_retrieve_prop_complete_cb = cb_info->twin_retrieve_prop_complete_cb;
                 instance->transport_callbacks.method_complete_cb = cb_info->method_complete_cb;
+                instance->transport_callbacks.statistics_cb = cb_info->statistics_cb;
 
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_012: [If IoTHubTransport_AMQP_Common_Create succeeds it shall return a pointer to `instance`.]
                 result = (TRANSPORT_LL_HANDLE)instance;
@@ -1528,6 +1875,9 @@ IOTHUB_PROCESS_ITEM_RESULT IoTHubTransport_AMQP_Common_ProcessItem(TRANSPORT_LL_
                 }
                 else
                 {
+                    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_019: [A twin request or subscription shall resume the device if it is suspended]
+                    resume_device(registered_device);
+
                     // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_150: [If no errors occur, `IoTHubTransport_AMQP_Common_ProcessItem` shall return IOTHUB_PROCESS_OK.]
                     result = IOTHUB_PROCESS_OK;
                 }
@@ -1593,7 +1943,12 @@ void IoTHubTransport_AMQP_Common_DoWork(TRANSPORT_LL_HANDLE handle)
 
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_019: [If `instance->amqp_connection` is NULL, it shall be established]
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_12_003: [AMQP connection will be configured using the `svc2cl_keep_alive_timeout_secs` value from SetOption ]
-                if (transport_instance->amqp_connection == NULL && establish_amqp_connection(transport_instance) != RESULT_OK)
+                // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_027: [If `instance->amqp_connection` is NULL and connect admission control is started and has no token, the connection shall not be established on this call]
+                if (transport_instance->amqp_connection == NULL && !IOTHUB_CLIENT_CONNECT_ADMITTED())
+                {
+                    /*the clients of the process used the tokens up; try again on the next call*/
+                }
+                else if (transport_instance->amqp_connection == NULL && establish_amqp_connection(transport_instance) != RESULT_OK)
                 {
                     LogError("AMQP transport failed to establish connection with service.");
 
@@ -1670,6 +2025,9 @@ int IoTHubTransport_AMQP_Common_Subscribe(IOTHUB_DEVICE_HANDLE handle)
         }
         else
         {
+            amqp_device_instance->subscribed_for_messages = true;
+            resume_device(amqp_device_instance);
+
             // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_088: [If no failures occur, IoTHubTransport_AMQP_Common_Subscribe shall return 0]
             result = RESULT_OK;
         }
@@ -1694,10 +2052,15 @@ void IoTHubTransport_AMQP_Common_Unsubscribe(IOTHUB_DEVICE_HANDLE handle)
         {
             LogError("Device '%s' failed unsubscribing to cloud-to-device messages (device is not registered)", STRING_c_str(amqp_device_instance->device_id));
         }
-        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_095: [device_unsubscribe_message() shall be invoked passing `amqp_device_instance->device_handle`]
-        else if (device_unsubscribe_message(amqp_device_instance->device_handle) != RESULT_OK)
+        else
         {
-            LogError("Device '%s' failed unsubscribing to cloud-to-device messages (device_unsubscribe_message failed)", STRING_c_str(amqp_device_instance->device_id));
+            amqp_device_instance->subscribed_for_messages = false;
+
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_095: [device_unsubscribe_message() shall be invoked passing `amqp_device_instance->device_handle`]
+            if (device_unsubscribe_message(amqp_device_instance->device_handle) != RESULT_OK)
+            {
+                LogError("Device '%s' failed unsubscribing to cloud-to-device messages (device_unsubscribe_message failed)", STRING_c_str(amqp_device_instance->device_id));
+            }
         }
     }
 }
@@ -1747,6 +2110,10 @@ int IoTHubTransport_AMQP_Common_Subscribe_DeviceTwin(IOTHUB_DEVICE_HANDLE handle
                     break;
                 }
 
+                IOTHUB_CLIENT_STARTUP_MARK(IOTHUB_CLIENT_STARTUP_TWIN_REQUESTED);
+                registered_device->subscribed_for_twin = true;
+                resume_device(registered_device);
+
                 list_item = singlylinkedlist_get_next_item(list_item);
             }
         }
@@ -1783,8 +2150,11 @@ void IoTHubTransport_AMQP_Common_Unsubscribe_DeviceTwin(IOTHUB_DEVICE_HANDLE han
                     LogError("Failed retrieving registered device information");
                     break;
                 }
+
+                registered_device->subscribed_for_twin = false;
+
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_142: [device_unsubscribe_for_twin_updates() shall be invoked for the registered device]
-                else if (device_unsubscribe_for_twin_updates(registered_device->device_handle) != RESULT_OK)
+                if (device_unsubscribe_for_twin_updates(registered_device->device_handle) != RESULT_OK)
                 {
                     // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_143: [If `device_unsubscribe_for_twin_updates` fails, the error shall be ignored]
                     LogError("Failed unsubscribing for device Twin updates");
@@ -1842,6 +2212,9 @@ IOTHUB_CLIENT_RESULT IoTHubTransport_AMQP_Common_GetTwinAsync(IOTHUB_DEVICE_HAND
                 }
                 else
                 {
+                    IOTHUB_CLIENT_STARTUP_MARK(IOTHUB_CLIENT_STARTUP_TWIN_REQUESTED);
+                    resume_device(registered_device);
+
                     // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_157: [ If no errors occur, `IoTHubTransport_AMQP_Common_GetTwinAsync` shall return IOTHUB_CLIENT_OK ]
                     result = IOTHUB_CLIENT_OK;
                 }
@@ -1869,6 +2242,7 @@ int IoTHubTransport_AMQP_Common_Subscribe_DeviceMethod(IOTHUB_DEVICE_HANDLE hand
         /* Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_01_005: [ If the transport is already subscribed to receive C2D method requests, `IoTHubTransport_AMQP_Common_Subscribe_DeviceMethod` shall perform no additional action and return 0. ]*/
         device_state->subscribe_methods_needed = true;
         device_state->subscribed_for_methods = false;
+        resume_device(device_state);
         result = 0;
     }
 
@@ -1995,6 +2369,28 @@ IOTHUB_CLIENT_RESULT IoTHubTransport_AMQP_Common_SetOption(TRANSPORT_LL_HANDLE h
             is_device_specific_option = true;
             transport_instance->option_send_event_timeout_secs = *(size_t*)value;
         }
+        else if (strcmp(OPTION_AMQP_BATCH_LINGER_MS, option) == 0)
+        {
+            is_device_specific_option = true;
+            transport_instance->option_batch_linger_ms = *(size_t*)value;
+        }
+        else if (strcmp(OPTION_AMQP_BATCH_MAX_MESSAGES, option) == 0)
+        {
+            is_device_specific_option = true;
+            transport_instance->option_batch_max_messages = *(size_t*)value;
+        }
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_010: [If `option` is `OPTION_C2D_LINK_CREDIT`, `value` shall be saved and passed to every registered device as DEVICE_OPTION_C2D_LINK_CREDIT]
+        else if (strcmp(OPTION_C2D_LINK_CREDIT, option) == 0)
+        {
+            is_device_specific_option = true;
+            transport_instance->option_c2d_link_credit = *(size_t*)value;
+        }
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_016: [If `option` is `OPTION_TWIN_LINK_IDLE_TIMEOUT_SECS`, `value` shall be saved and passed to every registered device as DEVICE_OPTION_TWIN_LINK_IDLE_TIMEOUT_SECS]
+        else if (strcmp(OPTION_TWIN_LINK_IDLE_TIMEOUT_SECS, option) == 0)
+        {
+            is_device_specific_option = true;
+            transport_instance->option_twin_link_idle_timeout_secs = *(size_t*)value;
+        }
         else
         {
             is_device_specific_option = false;
@@ -2013,6 +2409,52 @@ IOTHUB_CLIENT_RESULT IoTHubTransport_AMQP_Common_SetOption(TRANSPORT_LL_HANDLE h
                 result = IOTHUB_CLIENT_OK;
             }
         }
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_008: [If `option` is `OPTION_AMQP_CBS_AUTH_WINDOW`, `value` shall be saved on `instance->option_cbs_auth_window`]
+        else if (strcmp(OPTION_AMQP_CBS_AUTH_WINDOW, option) == 0)
+        {
+            transport_instance->option_cbs_auth_window = *(size_t*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_021: [If `option` is `OPTION_AMQP_DEVICE_IDLE_SUSPEND_SECS`, `value` shall be saved on `instance->option_device_idle_suspend_secs`]
+        else if (strcmp(OPTION_AMQP_DEVICE_IDLE_SUSPEND_SECS, option) == 0)
+        {
+            transport_instance->option_device_idle_suspend_secs = *(size_t*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_024: [If `option` is `OPTION_AMQP_SESSION_COUNT`, `value` shall be saved on `instance->option_amqp_session_count`]
+        else if (strcmp(OPTION_AMQP_SESSION_COUNT, option) == 0)
+        {
+            transport_instance->option_amqp_session_count = *(size_t*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_011: [If `option` is `OPTION_METHODS_LINK_CREDIT`, `value` shall be saved and set on the methods handle of every registered device using iothubtransportamqp_methods_set_link_credit]
+        else if (strcmp(OPTION_METHODS_LINK_CREDIT, option) == 0)
+        {
+            transport_instance->option_methods_link_credit = *(size_t*)value;
+
+            if (set_methods_link_credit_on_registered_devices(transport_instance) != RESULT_OK)
+            {
+                LogError("transport failed setting option '%s' (failed setting option on one or more registered devices)", option);
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_014: [If `option` is `OPTION_TLS_SESSION_RESUMPTION`, `value` shall be saved and applied to `instance->tls_io`, if created, using xio_setoption(); a failure of xio_setoption() shall be logged and ignored]
+        else if (strcmp(OPTION_TLS_SESSION_RESUMPTION, option) == 0)
+        {
+            transport_instance->option_tls_session_resumption = *(bool*)value;
+
+            if (transport_instance->tls_io != NULL &&
+                xio_setoption(transport_instance->tls_io, OPTION_TLS_SESSION_RESUMPTION, value) != RESULT_OK)
+            {
+                LogInfo("The TLS I/O does not support session resumption; reconnections will run a full handshake");
+            }
+
+            result = IOTHUB_CLIENT_OK;
+        }
         else if ((strcmp(OPTION_SERVICE_SIDE_KEEP_ALIVE_FREQ_SECS, option) == 0) || (strcmp(OPTION_C2D_KEEP_ALIVE_FREQ_SECS, option) == 0))
         {
             transport_instance->svc2cl_keep_alive_timeout_secs = *(size_t*)value;
@@ -2164,10 +2606,8 @@ IOTHUB_CLIENT_RESULT IoTHubTransport_AMQP_Common_SetOption(TRANSPORT_LL_HANDLE h
                 }
                 else
                 {
-                    if (save_underlying_io_transport_options(transport_instance) != RESULT_OK)
-                    {
-                        LogError("IoTHubTransport_AMQP_Common_SetOption failed to save underlying I/O options; failure will be ignored");
-                    }
+                    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_026: [Once an option is passed to `instance->tls_io`, `instance->saved_tls_options` shall be retrieved again on the next connection retry]
+                    transport_instance->saved_tls_options_current = false;
 
                     // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_03_001: [If no failures occur, IoTHubTransport_AMQP_Common_SetOption shall return IOTHUB_CLIENT_OK.]
                     result = IOTHUB_CLIENT_OK;
@@ -2198,11 +2638,11 @@ IOTHUB_DEVICE_HANDLE IoTHubTransport_AMQP_Common_Register(TRANSPORT_LL_HANDLE ha
     }
     else
     {
-        LIST_ITEM_HANDLE list_item;
         AMQP_TRANSPORT_INSTANCE* transport_instance = (AMQP_TRANSPORT_INSTANCE*)handle;
 
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_064: [If the device is already registered, IoTHubTransport_AMQP_Common_Register shall fail and return NULL.]
-        if (is_device_registered_ex(transport_instance->registered_devices, device->deviceId, &list_item))
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_003: [IoTHubTransport_AMQP_Common_Register shall look the device id up in `instance->device_index` instead of scanning `instance->registered_devices`]
+        if (find_indexed_device(transport_instance, device->deviceId) != NULL)
         {
             LogError("IoTHubTransport_AMQP_Common_Register failed (device '%s' already registered on this transport instance)", device->deviceId);
             result = NULL;
@@ -2267,6 +2707,8 @@ IOTHUB_DEVICE_HANDLE IoTHubTransport_AMQP_Common_Register(TRANSPORT_LL_HANDLE ha
                     device_config.authentication_mode = get_authentication_mode(device);
                     device_config.on_state_changed_callback = on_device_state_changed_callback;
                     device_config.on_state_changed_context = amqp_device_instance;
+                    device_config.on_batch_sent_callback = on_device_batch_sent;
+                    device_config.on_batch_sent_context = amqp_device_instance;
                     device_config.product_info = local_product_info;
 
                     // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_071: [`amqp_device_instance->device_handle` shall be set using device_create()]
@@ -2304,6 +2746,8 @@ IOTHUB_DEVICE_HANDLE IoTHubTransport_AMQP_Common_Register(TRANSPORT_LL_HANDLE ha
                             }
                             else
                             {
+                                add_device_to_index(transport_instance, amqp_device_instance, device->deviceId);
+
                                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_076: [If the device is the first being registered on the transport, IoTHubTransport_AMQP_Common_Register shall save its authentication mode as the transport preferred authentication mode]
                                 if (transport_instance->preferred_authentication_mode == AMQP_TRANSPORT_AUTHENTICATION_MODE_NOT_SET &&
                                     is_first_device_being_registered)
@@ -2374,6 +2818,8 @@ void IoTHubTransport_AMQP_Common_Unregister(IOTHUB_DEVICE_HANDLE deviceHandle)
             }
             else
             {
+                remove_device_from_index(registered_device->transport_instance, registered_device);
+
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_01_012: [IoTHubTransport_AMQP_Common_Unregister shall destroy the C2D methods handler by calling iothubtransportamqp_methods_destroy]
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_083: [IoTHubTransport_AMQP_Common_Unregister shall free all the memory allocated for the `device_instance`]
                 internal_destroy_amqp_device_instance(registered_device);
@@ -2479,34 +2925,25 @@ IOTHUB_CLIENT_RESULT IoTHubTransport_AMQP_Common_SendMessageDisposition(MESSAGE_
         }
         else
         {
-            DEVICE_MESSAGE_DISPOSITION_INFO* device_message_disposition_info;
+            DEVICE_MESSAGE_DISPOSITION_INFO device_message_disposition_info;
 
             /* Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_10_004: [IoTHubTransport_AMQP_Common_SendMessageDisposition shall convert the given IOTHUBMESSAGE_DISPOSITION_RESULT to the equivalent AMQP_VALUE and will return the result of calling messagereceiver_send_message_disposition. ] */
             DEVICE_MESSAGE_DISPOSITION_RESULT device_disposition_result = get_device_disposition_result_from(disposition);
 
-            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_112: [A DEVICE_MESSAGE_DISPOSITION_INFO instance shall be created with a copy of the `link_name` and `message_id` contained in `message_data`]
-            if ((device_message_disposition_info = create_device_message_disposition_info_from(message_data)) == NULL)
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_012: [A DEVICE_MESSAGE_DISPOSITION_INFO instance shall be filled on the stack with the `link_name` and `message_id` contained in `message_data`, without copying the link name]
+            device_message_disposition_info.source = message_data->transportContext->link_name;
+            device_message_disposition_info.message_id = (unsigned long)message_data->transportContext->message_id;
+
+            /* Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_10_003: [IoTHubTransport_AMQP_Common_SendMessageDisposition shall fail and return IOTHUB_CLIENT_ERROR if the POST message fails, otherwise return IOTHUB_CLIENT_OK.] */
+            if (device_send_message_disposition(message_data->transportContext->device_state->device_handle, &device_message_disposition_info, device_disposition_result) != RESULT_OK)
             {
-                // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_113: [If the DEVICE_MESSAGE_DISPOSITION_INFO fails to be created, `IoTHubTransport_AMQP_Common_SendMessageDisposition()` shall fail and return IOTHUB_CLIENT_ERROR]
-                LogError("Device '%s' failed sending message disposition (failed creating DEVICE_MESSAGE_DISPOSITION_RESULT)", STRING_c_str(message_data->transportContext->device_state->device_id));
+                LogError("Device '%s' failed sending message disposition (device_send_message_disposition failed)", STRING_c_str(message_data->transportContext->device_state->device_id));
                 result = IOTHUB_CLIENT_ERROR;
             }
             else
             {
-                /* Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_10_003: [IoTHubTransport_AMQP_Common_SendMessageDisposition shall fail and return IOTHUB_CLIENT_ERROR if the POST message fails, otherwise return IOTHUB_CLIENT_OK.] */
-                if (device_send_message_disposition(message_data->transportContext->device_state->device_handle, device_message_disposition_info, device_disposition_result) != RESULT_OK)
-                {
-                    LogError("Device '%s' failed sending message disposition (device_send_message_disposition failed)", STRING_c_str(message_data->transportContext->device_state->device_id));
-                    result = IOTHUB_CLIENT_ERROR;
-                }
-                else
-                {
-                    IoTHubMessage_Destroy(message_data->messageHandle);
-                    result = IOTHUB_CLIENT_OK;
-                }
-
-                // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_114: [`IoTHubTransport_AMQP_Common_SendMessageDisposition()` shall destroy the DEVICE_MESSAGE_DISPOSITION_INFO instance]
-                destroy_device_message_disposition_info(device_message_disposition_info);
+                IoTHubMessage_Destroy(message_data->messageHandle);
+                result = IOTHUB_CLIENT_OK;
             }
         }
 
@@ -27,6 +27,8 @@ typedef struct AMQP_CONNECTION_INSTANCE_TAG
     CBS_HANDLE cbs_handle;
     CONNECTION_HANDLE connection_handle;
     SESSION_HANDLE session_handle;
+    SESSION_HANDLE* additional_sessions;
+    size_t additional_session_count;
     XIO_HANDLE sasl_io;
     SASL_MECHANISM_HANDLE sasl_mechanism;
     bool has_cbs;
@@ -228,32 +230,80 @@ static int create_connection_handle(AMQP_CONNECTION_INSTANCE* instance)
     return result;
 }
 
-static int create_session_handle(AMQP_CONNECTION_INSTANCE* instance)
+static SESSION_HANDLE create_session(CONNECTION_HANDLE connection_handle)
 {
-    int result;
+    SESSION_HANDLE result;
 
     // Codes_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_024: [`instance->session_handle` shall be created using session_create(), passing `instance->connection_handle`]
-    if ((instance->session_handle = session_create(instance->connection_handle, NULL, NULL)) == NULL)
+    if ((result = session_create(connection_handle, NULL, NULL)) == NULL)
     {
-        // Codes_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_025: [If session_create() fails, amqp_connection_create() shall fail and return NULL]
-        result = __FAILURE__;
-        LogError("Failed creating the AMQP connection (connection_create2 failed)");
+        LogError("Failed creating the AMQP session (session_create failed)");
     }
     else
     {
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_026: [The `instance->session_handle` incoming window size shall be set as UINT_MAX using session_set_incoming_window()]
-        if (session_set_incoming_window(instance->session_handle, (uint32_t)DEFAULT_INCOMING_WINDOW_SIZE) != 0)
+        if (session_set_incoming_window(result, (uint32_t)DEFAULT_INCOMING_WINDOW_SIZE) != 0)
         {
             LogError("Failed to set the AMQP session incoming window size.");
         }
 
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_027: [The `instance->session_handle` outgoing window size shall be set as 100 using session_set_outgoing_window()]
-        if (session_set_outgoing_window(instance->session_handle, DEFAULT_OUTGOING_WINDOW_SIZE) != 0)
+        if (session_set_outgoing_window(result, DEFAULT_OUTGOING_WINDOW_SIZE) != 0)
         {
             LogError("Failed to set the AMQP session outgoing window size.");
         }
+    }
+
+    return result;
+}
+
+static int create_session_handle(AMQP_CONNECTION_INSTANCE* instance)
+{
+    int result;
+
+    if ((instance->session_handle = create_session(instance->connection_handle)) == NULL)
+    {
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_025: [If session_create() fails, amqp_connection_create() shall fail and return NULL]
+        result = __FAILURE__;
+        LogError("Failed creating the AMQP connection (connection_create2 failed)");
+    }
+    else
+    {
+        result = RESULT_OK;
+    }
+
+    return result;
+}
 
+static int create_additional_sessions(AMQP_CONNECTION_INSTANCE* instance, size_t session_count)
+{
+    int result;
+
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_41_002: [amqp_connection_create() shall allocate an array for the `config->session_count - 1` sessions beyond `instance->session_handle`]
+    if ((instance->additional_sessions = (SESSION_HANDLE*)malloc((session_count - 1) * sizeof(SESSION_HANDLE))) == NULL)
+    {
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_41_004: [If malloc() or any session_create() fails, amqp_connection_create() shall fail and return NULL]
+        result = __FAILURE__;
+        LogError("Failed allocating the additional AMQP sessions");
+    }
+    else
+    {
         result = RESULT_OK;
+
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_41_003: [Each additional session shall be created and have its windows set the same way as `instance->session_handle`]
+        while (instance->additional_session_count < session_count - 1)
+        {
+            SESSION_HANDLE session_handle;
+
+            if ((session_handle = create_session(instance->connection_handle)) == NULL)
+            {
+                result = __FAILURE__;
+                LogError("Failed creating the additional AMQP session %lu", (unsigned long)(instance->additional_session_count + 1));
+                break;
+            }
+
+            instance->additional_sessions[instance->additional_session_count++] = session_handle;
+        }
     }
 
     return result;
@@ -307,6 +357,19 @@ void amqp_connection_destroy(AMQP_CONNECTION_HANDLE conn_handle)
             session_destroy(instance->session_handle);
         }
 
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_41_005: [amqp_connection_destroy() shall destroy the additional sessions using session_destroy() and free their array]
+        if (instance->additional_sessions != NULL)
+        {
+            size_t index;
+
+            for (index = 0; index < instance->additional_session_count; index++)
+            {
+                session_destroy(instance->additional_sessions[index]);
+            }
+
+            free(instance->additional_sessions);
+        }
+
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_067: [amqp_connection_destroy() shall destroy `instance->connection_handle` if set using connection_destroy()]
         if (instance->connection_handle != NULL)
         {
@@ -414,6 +477,12 @@ AMQP_CONNECTION_HANDLE amqp_connection_create(AMQP_CONNECTION_CONFIG* config)
                     result = NULL;
                     LogError("amqp_connection_create failed (failed creating the AMQP session)");
                 }
+                // Codes_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_41_001: [Only if `config->session_count` is greater than 1, amqp_connection_create() shall create `config->session_count - 1` sessions beyond `instance->session_handle`]
+                else if (config->session_count > 1 && create_additional_sessions(instance, config->session_count) != RESULT_OK)
+                {
+                    result = NULL;
+                    LogError("amqp_connection_create failed (failed creating the additional AMQP sessions)");
+                }
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_028: [Only if `config->create_cbs_connection` is true, amqp_connection_create() shall create and open the CBS_HANDLE]
                 else if (config->create_cbs_connection && create_cbs_handle(instance) != RESULT_OK)
                 {
@@ -479,6 +548,31 @@ int amqp_connection_get_session_handle(AMQP_CONNECTION_HANDLE conn_handle, SESSI
     return result;
 }
 
+int amqp_connection_get_session_handle_by_key(AMQP_CONNECTION_HANDLE conn_handle, size_t key, SESSION_HANDLE* session_handle)
+{
+    int result;
+
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_41_006: [If `conn_handle` or `session_handle` are NULL, amqp_connection_get_session_handle_by_key() shall fail and return __FAILURE__]
+    if (conn_handle == NULL || session_handle == NULL)
+    {
+        result = __FAILURE__;
+        LogError("amqp_connection_get_session_handle_by_key failed (conn_handle=%p, session_handle=%p)", conn_handle, session_handle);
+    }
+    else
+    {
+        AMQP_CONNECTION_INSTANCE* instance = (AMQP_CONNECTION_INSTANCE*)conn_handle;
+        size_t index = key % (instance->additional_session_count + 1);
+
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_41_007: [`session_handle` shall be set to the session at `key` modulo the number of sessions, where index 0 is `instance->session_handle`]
+        *session_handle = (index == 0) ? instance->session_handle : instance->additional_sessions[index - 1];
+
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_41_008: [amqp_connection_get_session_handle_by_key() shall return success code 0]
+        result = RESULT_OK;
+    }
+
+    return result;
+}
+
 int amqp_connection_get_cbs_handle(AMQP_CONNECTION_HANDLE conn_handle, CBS_HANDLE* cbs_handle)
 {
     int result;
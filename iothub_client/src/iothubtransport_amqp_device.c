@@ -56,6 +56,11 @@ typedef struct DEVICE_INSTANCE_TAG
     size_t twin_msgr_state_change_timeout_secs;
     DEVICE_TWIN_UPDATE_RECEIVED_CALLBACK on_device_twin_update_received_callback;
     void* on_device_twin_update_received_context;
+
+    size_t twin_link_idle_timeout_secs; // 0 attaches the twin links when the device starts, see DEVICE_OPTION_TWIN_LINK_IDLE_TIMEOUT_SECS
+    bool twin_links_lazy; // taken from twin_link_idle_timeout_secs when the device starts
+    bool twin_in_use; // a twin operation was requested since the twin links were last detached
+    time_t twin_last_used_time;
 } AMQP_DEVICE_INSTANCE;
 
 typedef struct DEVICE_SEND_EVENT_TASK_TAG
@@ -127,6 +132,83 @@ static int is_timeout_reached(time_t start_time, size_t timeout_in_secs, int *is
     return result;
 }
 
+static void mark_twin_in_use(AMQP_DEVICE_INSTANCE* instance)
+{
+    // Only lazy twin links track their use
+    if (instance->twin_links_lazy || instance->twin_link_idle_timeout_secs > 0)
+    {
+        instance->twin_in_use = true;
+        instance->twin_last_used_time = get_time(NULL);
+    }
+}
+
+// @brief
+//     Attaches the twin links of a started device once a twin operation needs them, and detaches them once idle.
+static void process_lazy_twin_messenger(AMQP_DEVICE_INSTANCE* instance)
+{
+    if (instance->twin_msgr_state == TWIN_MESSENGER_STATE_ERROR)
+    {
+        LogError("Device '%s' twin messenger reported unexpected state %d", instance->config->device_id, instance->twin_msgr_state);
+        update_state(instance, DEVICE_STATE_ERROR_MSG);
+    }
+    else if (instance->twin_msgr_state == TWIN_MESSENGER_STATE_STOPPED)
+    {
+        if (instance->twin_in_use &&
+            twin_messenger_start(instance->twin_messenger_handle, instance->session_handle) != RESULT_OK)
+        {
+            LogError("Device '%s' twin messenger failed to be started (messenger_start failed)", instance->config->device_id);
+            update_state(instance, DEVICE_STATE_ERROR_MSG);
+        }
+    }
+    else if (instance->twin_msgr_state == TWIN_MESSENGER_STATE_STARTING)
+    {
+        int is_timed_out;
+        if (is_timeout_reached(instance->twin_msgr_state_last_changed_time, instance->twin_msgr_state_change_timeout_secs, &is_timed_out) != RESULT_OK)
+        {
+            LogError("Device '%s' failed verifying the timeout for twin messenger start (is_timeout_reached failed)", instance->config->device_id);
+            update_state(instance, DEVICE_STATE_ERROR_MSG);
+        }
+        else if (is_timed_out == 1)
+        {
+            LogError("Device '%s' twin messenger did not complete starting within expected timeout (%lu)", instance->config->device_id, (unsigned long)instance->twin_msgr_state_change_timeout_secs);
+            update_state(instance, DEVICE_STATE_ERROR_MSG);
+        }
+    }
+    // A subscription keeps the twin links attached, and 0 never detaches them
+    else if (instance->twin_msgr_state == TWIN_MESSENGER_STATE_STARTED &&
+        instance->on_device_twin_update_received_callback == NULL &&
+        instance->twin_link_idle_timeout_secs > 0)
+    {
+        TWIN_MESSENGER_SEND_STATUS send_status;
+        int is_timed_out;
+
+        if (twin_messenger_get_send_status(instance->twin_messenger_handle, &send_status) != RESULT_OK)
+        {
+            LogError("Device '%s' failed getting the twin messenger send status", instance->config->device_id);
+        }
+        else if (send_status == TWIN_MESSENGER_SEND_STATUS_BUSY)
+        {
+            instance->twin_last_used_time = get_time(NULL);
+        }
+        else if (is_timeout_reached(instance->twin_last_used_time, instance->twin_link_idle_timeout_secs, &is_timed_out) != RESULT_OK)
+        {
+            LogError("Device '%s' failed verifying the twin links idle timeout (is_timeout_reached failed)", instance->config->device_id);
+        }
+        else if (is_timed_out == 1)
+        {
+            if (twin_messenger_stop(instance->twin_messenger_handle) != RESULT_OK)
+            {
+                LogError("Device '%s' failed detaching the idle twin links (twin_messenger_stop failed)", instance->config->device_id);
+                update_state(instance, DEVICE_STATE_ERROR_MSG);
+            }
+            else
+            {
+                instance->twin_in_use = false;
+            }
+        }
+    }
+}
+
 
 //---------- Callback Handlers ----------//
 
@@ -344,62 +426,6 @@ static void on_get_twin_completed(TWIN_UPDATE_TYPE update_type, const char* payl
 
 //---------- Message Dispostion ----------//
 
-static DEVICE_MESSAGE_DISPOSITION_INFO* create_device_message_disposition_info_from(TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO* messenger_disposition_info)
-{
-    DEVICE_MESSAGE_DISPOSITION_INFO* device_disposition_info;
-
-    if ((device_disposition_info = (DEVICE_MESSAGE_DISPOSITION_INFO*)malloc(sizeof(DEVICE_MESSAGE_DISPOSITION_INFO))) == NULL)
-    {
-        LogError("Failed creating DEVICE_MESSAGE_DISPOSITION_INFO (malloc failed)");
-    }
-    else if (mallocAndStrcpy_s(&device_disposition_info->source, messenger_disposition_info->source) != RESULT_OK)
-    {
-        LogError("Failed creating DEVICE_MESSAGE_DISPOSITION_INFO (mallocAndStrcpy_s failed)");
-        free(device_disposition_info);
-        device_disposition_info = NULL;
-    }
-    else
-    {
-        device_disposition_info->message_id = messenger_disposition_info->message_id;
-    }
-
-    return device_disposition_info;
-}
-
-static void destroy_device_disposition_info(DEVICE_MESSAGE_DISPOSITION_INFO* disposition_info)
-{
-    free(disposition_info->source);
-    free(disposition_info);
-}
-
-static TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO* create_messenger_disposition_info(DEVICE_MESSAGE_DISPOSITION_INFO* device_disposition_info)
-{
-    TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO* messenger_disposition_info;
-
-    if ((messenger_disposition_info = (TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO*)malloc(sizeof(TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO))) == NULL)
-    {
-        LogError("Failed creating TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO (malloc failed)");
-    }
-    else if (mallocAndStrcpy_s(&messenger_disposition_info->source, device_disposition_info->source) != RESULT_OK)
-    {
-        LogError("Failed creating TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO (mallocAndStrcpy_s failed)");
-        free(messenger_disposition_info);
-        messenger_disposition_info = NULL;
-    }
-    else
-    {
-        messenger_disposition_info->message_id = (delivery_number)device_disposition_info->message_id;
-    }
-
-    return messenger_disposition_info;
-}
-
-static void destroy_messenger_disposition_info(TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO* messenger_disposition_info)
-{
-    free(messenger_disposition_info->source);
-    free(messenger_disposition_info);
-}
-
 static TELEMETRY_MESSENGER_DISPOSITION_RESULT get_messenger_message_disposition_result_from(DEVICE_MESSAGE_DISPOSITION_RESULT device_disposition_result)
 {
     TELEMETRY_MESSENGER_DISPOSITION_RESULT messenger_disposition_result;
@@ -448,28 +474,20 @@ static TELEMETRY_MESSENGER_DISPOSITION_RESULT on_messenger_message_received_call
         }
         else
         {
-            DEVICE_MESSAGE_DISPOSITION_INFO* device_message_disposition_info;
+            DEVICE_MESSAGE_DISPOSITION_INFO device_message_disposition_info;
+            DEVICE_MESSAGE_DISPOSITION_RESULT device_disposition_result;
 
-            // Codes_SRS_DEVICE_09_119: [A DEVICE_MESSAGE_DISPOSITION_INFO instance shall be created containing a copy of `disposition_info->source` and `disposition_info->message_id`]
-            if ((device_message_disposition_info = create_device_message_disposition_info_from(disposition_info)) == NULL)
-            {
-                // Codes_SRS_DEVICE_09_120: [If the DEVICE_MESSAGE_DISPOSITION_INFO instance fails to be created, on_messenger_message_received_callback shall return TELEMETRY_MESSENGER_DISPOSITION_RESULT_RELEASED]
-                LogError("Device '%s' failed receiving incoming C2D message (failed creating DEVICE_MESSAGE_DISPOSITION_INFO)", device_instance->config->device_id);
-                msgr_disposition_result = TELEMETRY_MESSENGER_DISPOSITION_RESULT_RELEASED;
-            }
-            else
-            {
-                // Codes_SRS_DEVICE_09_071: [The user callback shall be invoked, passing the context it provided]
-                DEVICE_MESSAGE_DISPOSITION_RESULT device_disposition_result = device_instance->on_message_received_callback(iothub_message_handle, device_message_disposition_info, device_instance->on_message_received_context);
+            // Codes_SRS_DEVICE_41_004: [A DEVICE_MESSAGE_DISPOSITION_INFO instance shall be filled on the stack with `disposition_info->source` and `disposition_info->message_id`, without copying the source]
+            device_message_disposition_info.source = disposition_info->source;
+            device_message_disposition_info.message_id = (unsigned long)disposition_info->message_id;
 
-                // Codes_SRS_DEVICE_09_072: [If the user callback returns DEVICE_MESSAGE_DISPOSITION_RESULT_ACCEPTED, on_messenger_message_received_callback shall return TELEMETRY_MESSENGER_DISPOSITION_RESULT_ACCEPTED]
-                // Codes_SRS_DEVICE_09_073: [If the user callback returns DEVICE_MESSAGE_DISPOSITION_RESULT_REJECTED, on_messenger_message_received_callback shall return TELEMETRY_MESSENGER_DISPOSITION_RESULT_REJECTED]
-                // Codes_SRS_DEVICE_09_074: [If the user callback returns DEVICE_MESSAGE_DISPOSITION_RESULT_RELEASED, on_messenger_message_received_callback shall return TELEMETRY_MESSENGER_DISPOSITION_RESULT_RELEASED]
-                msgr_disposition_result = get_messenger_message_disposition_result_from(device_disposition_result);
+            // Codes_SRS_DEVICE_09_071: [The user callback shall be invoked, passing the context it provided]
+            device_disposition_result = device_instance->on_message_received_callback(iothub_message_handle, &device_message_disposition_info, device_instance->on_message_received_context);
 
-                // Codes_SRS_DEVICE_09_121: [on_messenger_message_received_callback shall release the memory allocated for DEVICE_MESSAGE_DISPOSITION_INFO]
-                destroy_device_disposition_info(device_message_disposition_info);
-            }
+            // Codes_SRS_DEVICE_09_072: [If the user callback returns DEVICE_MESSAGE_DISPOSITION_RESULT_ACCEPTED, on_messenger_message_received_callback shall return TELEMETRY_MESSENGER_DISPOSITION_RESULT_ACCEPTED]
+            // Codes_SRS_DEVICE_09_073: [If the user callback returns DEVICE_MESSAGE_DISPOSITION_RESULT_REJECTED, on_messenger_message_received_callback shall return TELEMETRY_MESSENGER_DISPOSITION_RESULT_REJECTED]
+            // Codes_SRS_DEVICE_09_074: [If the user callback returns DEVICE_MESSAGE_DISPOSITION_RESULT_RELEASED, on_messenger_message_received_callback shall return TELEMETRY_MESSENGER_DISPOSITION_RESULT_RELEASED]
+            msgr_disposition_result = get_messenger_message_disposition_result_from(device_disposition_result);
         }
     }
 
@@ -519,6 +537,8 @@ static DEVICE_CONFIG* clone_device_config(DEVICE_CONFIG *config)
             new_config->authentication_mode = config->authentication_mode;
             new_config->on_state_changed_callback = config->on_state_changed_callback;
             new_config->on_state_changed_context = config->on_state_changed_context;
+            new_config->on_batch_sent_callback = config->on_batch_sent_callback;
+            new_config->on_batch_sent_context = config->on_batch_sent_context;
             new_config->device_id = IoTHubClient_Auth_Get_DeviceId(config->authorization_module);
             new_config->module_id = IoTHubClient_Auth_Get_ModuleId(config->authorization_module);
             result = RESULT_OK;
@@ -603,6 +623,9 @@ static int create_telemetry_messenger_instance(AMQP_DEVICE_INSTANCE* instance, c
     messenger_config.iothub_host_fqdn = instance->config->iothub_host_fqdn;
     messenger_config.on_state_changed_callback = on_messenger_state_changed_callback;
     messenger_config.on_state_changed_context = instance;
+    // Codes_SRS_DEVICE_41_001: [`config->on_batch_sent_callback` and `config->on_batch_sent_context` shall be passed to the telemetry messenger]
+    messenger_config.on_batch_sent_callback = instance->config->on_batch_sent_callback;
+    messenger_config.on_batch_sent_context = instance->config->on_batch_sent_context;
 
     if ((instance->messenger_handle = telemetry_messenger_create(&messenger_config, pi)) == NULL)
     {
@@ -828,6 +851,9 @@ int device_start_async(AMQP_DEVICE_HANDLE handle, SESSION_HANDLE session_handle,
             instance->session_handle = session_handle;
             instance->cbs_handle = cbs_handle;
 
+            // Codes_SRS_DEVICE_41_007: [If DEVICE_OPTION_TWIN_LINK_IDLE_TIMEOUT_SECS is not 0, the twin links shall not be attached while the device starts, but once a twin operation is requested, until the device stops]
+            instance->twin_links_lazy = (instance->twin_link_idle_timeout_secs > 0);
+
             // Codes_SRS_DEVICE_09_022: [The device state shall be updated to DEVICE_STATE_STARTING, and state changed callback invoked]
             update_state(instance, DEVICE_STATE_STARTING);
 
@@ -1020,8 +1046,13 @@ void device_do_work(AMQP_DEVICE_HANDLE handle)
                     number_of_messengers_started++;
                 }
 
+                if (instance->twin_links_lazy && !instance->twin_in_use && instance->twin_msgr_state == TWIN_MESSENGER_STATE_STOPPED)
+                {
+                    // Twin links not needed yet do not hold the device back
+                    number_of_messengers_started++;
+                }
                 // Codes_SRS_DEVICE_09_125: [If TWIN messenger state is TWIN_MESSENGER_STATE_STOPPED, twin_messenger_start shall be invoked]
-                if (instance->twin_msgr_state == TWIN_MESSENGER_STATE_STOPPED)
+                else if (instance->twin_msgr_state == TWIN_MESSENGER_STATE_STOPPED)
                 {
                     if (twin_messenger_start(instance->twin_messenger_handle, instance->session_handle) != RESULT_OK)
                     {
@@ -1101,8 +1132,13 @@ void device_do_work(AMQP_DEVICE_HANDLE handle)
                     update_state(instance, DEVICE_STATE_ERROR_MSG);
                 }
 
+                // Codes_SRS_DEVICE_41_008: [If the twin links are lazy, a started device shall attach them when a twin operation is requested, and detach them with twin_messenger_stop once DEVICE_OPTION_TWIN_LINK_IDLE_TIMEOUT_SECS passed without a twin subscription or pending twin operation]
+                if (instance->twin_links_lazy)
+                {
+                    process_lazy_twin_messenger(instance);
+                }
                 // Codes_SRS_DEVICE_09_133: [If TWIN messenger state is not TWIN_MESSENGER_STATE_STARTED, the device state shall be updated to DEVICE_STATE_ERROR_MSG]
-                if (instance->twin_msgr_state != TWIN_MESSENGER_STATE_STARTED)
+                else if (instance->twin_msgr_state != TWIN_MESSENGER_STATE_STARTED)
                 {
                     LogError("Device '%s' is started but TWIN messenger reported unexpected state %d", instance->config->device_id, instance->twin_msgr_state);
                     update_state(instance, DEVICE_STATE_ERROR_MSG);
@@ -1335,34 +1371,24 @@ int device_send_message_disposition(AMQP_DEVICE_HANDLE device_handle, DEVICE_MES
     else
     {
         AMQP_DEVICE_INSTANCE* device = (AMQP_DEVICE_INSTANCE*)device_handle;
-        TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO* messenger_disposition_info;
+        TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO messenger_disposition_info;
+        TELEMETRY_MESSENGER_DISPOSITION_RESULT messenger_disposition_result = get_messenger_message_disposition_result_from(disposition_result);
 
-        // Codes_SRS_DEVICE_09_113: [A TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO instance shall be created with a copy of the `source` and `message_id` contained in `disposition_info`]
-        if ((messenger_disposition_info = create_messenger_disposition_info(disposition_info)) == NULL)
+        // Codes_SRS_DEVICE_41_005: [A TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO instance shall be filled on the stack with the `source` and `message_id` contained in `disposition_info`, without copying the source]
+        messenger_disposition_info.source = disposition_info->source;
+        messenger_disposition_info.message_id = (delivery_number)disposition_info->message_id;
+
+        // Codes_SRS_DEVICE_09_115: [`telemetry_messenger_send_message_disposition()` shall be invoked passing the TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO instance and the corresponding TELEMETRY_MESSENGER_DISPOSITION_RESULT]
+        if (telemetry_messenger_send_message_disposition(device->messenger_handle, &messenger_disposition_info, messenger_disposition_result) != RESULT_OK)
         {
-            // Codes_SRS_DEVICE_09_114: [If the TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO fails to be created, device_send_message_disposition() shall fail and return __FAILURE__]
-            LogError("Failed sending message disposition (failed to create TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO)");
+            // Codes_SRS_DEVICE_09_116: [If `telemetry_messenger_send_message_disposition()` fails, device_send_message_disposition() shall fail and return __FAILURE__]
+            LogError("Failed sending message disposition (telemetry_messenger_send_message_disposition failed)");
             result = __FAILURE__;
         }
         else
         {
-            TELEMETRY_MESSENGER_DISPOSITION_RESULT messenger_disposition_result = get_messenger_message_disposition_result_from(disposition_result);
-
-            // Codes_SRS_DEVICE_09_115: [`telemetry_messenger_send_message_disposition()` shall be invoked passing the TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO instance and the corresponding TELEMETRY_MESSENGER_DISPOSITION_RESULT]
-            if (telemetry_messenger_send_message_disposition(device->messenger_handle, messenger_disposition_info, messenger_disposition_result) != RESULT_OK)
-            {
-                // Codes_SRS_DEVICE_09_116: [If `telemetry_messenger_send_message_disposition()` fails, device_send_message_disposition() shall fail and return __FAILURE__]
-                LogError("Failed sending message disposition (telemetry_messenger_send_message_disposition failed)");
-                result = __FAILURE__;
-            }
-            else
-            {
-                // Codes_SRS_DEVICE_09_118: [If no failures occurr, device_send_message_disposition() shall return 0]
-                result = RESULT_OK;
-            }
-
-            // Codes_SRS_DEVICE_09_117: [device_send_message_disposition() shall destroy the TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO instance]
-            destroy_messenger_disposition_info(messenger_disposition_info);
+            // Codes_SRS_DEVICE_09_118: [If no failures occurr, device_send_message_disposition() shall return 0]
+            result = RESULT_OK;
         }
     }
 
@@ -1442,6 +1468,41 @@ int device_set_option(AMQP_DEVICE_HANDLE handle, const char* name, void* value)
                 result = RESULT_OK;
             }
         }
+        else if (strcmp(DEVICE_OPTION_BATCH_LINGER_MS, name) == 0 ||
+                 strcmp(DEVICE_OPTION_BATCH_MAX_MESSAGES, name) == 0)
+        {
+            const char* messenger_option_name = (strcmp(DEVICE_OPTION_BATCH_LINGER_MS, name) == 0 ? TELEMETRY_MESSENGER_OPTION_BATCH_LINGER_MS : TELEMETRY_MESSENGER_OPTION_BATCH_MAX_MESSAGES);
+
+            // Codes_SRS_DEVICE_41_002: [If `name` is DEVICE_OPTION_BATCH_LINGER_MS or DEVICE_OPTION_BATCH_MAX_MESSAGES, it shall be passed along with `value` to telemetry_messenger_set_option]
+            if (telemetry_messenger_set_option(instance->messenger_handle, messenger_option_name, value) != RESULT_OK)
+            {
+                LogError("failed setting option for device '%s' (failed setting messenger option '%s')", instance->config->device_id, name);
+                result = __FAILURE__;
+            }
+            else
+            {
+                result = RESULT_OK;
+            }
+        }
+        else if (strcmp(DEVICE_OPTION_C2D_LINK_CREDIT, name) == 0)
+        {
+            // Codes_SRS_DEVICE_41_003: [If `name` is DEVICE_OPTION_C2D_LINK_CREDIT, `value` shall be passed to telemetry_messenger_set_option as TELEMETRY_MESSENGER_OPTION_C2D_LINK_CREDIT]
+            if (telemetry_messenger_set_option(instance->messenger_handle, TELEMETRY_MESSENGER_OPTION_C2D_LINK_CREDIT, value) != RESULT_OK)
+            {
+                LogError("failed setting option for device '%s' (failed setting messenger option '%s')", instance->config->device_id, name);
+                result = __FAILURE__;
+            }
+            else
+            {
+                result = RESULT_OK;
+            }
+        }
+        else if (strcmp(DEVICE_OPTION_TWIN_LINK_IDLE_TIMEOUT_SECS, name) == 0)
+        {
+            // Codes_SRS_DEVICE_41_006: [If `name` is DEVICE_OPTION_TWIN_LINK_IDLE_TIMEOUT_SECS, `value` shall be saved on `instance->twin_link_idle_timeout_secs`, and apply from the next device start]
+            instance->twin_link_idle_timeout_secs = *(size_t*)value;
+            result = RESULT_OK;
+        }
         else if (strcmp(DEVICE_OPTION_SAVED_AUTH_OPTIONS, name) == 0)
         {
             // Codes_SRS_DEVICE_09_088: [If `name` is DEVICE_OPTION_SAVED_AUTH_OPTIONS but CBS authentication is not being used, device_set_option shall return a non-zero result]
@@ -1601,6 +1662,9 @@ int device_send_twin_update_async(AMQP_DEVICE_HANDLE handle, CONSTBUFFER_HANDLE
             twin_ctx->on_send_twin_update_complete_callback = on_send_twin_update_complete_callback;
             twin_ctx->context = context;
 
+            // Codes_SRS_DEVICE_41_009: [device_send_twin_update_async, device_subscribe_for_twin_updates and device_get_twin_async shall mark the twin links as in use]
+            mark_twin_in_use(instance);
+
             // Codes_SRS_DEVICE_09_138: [The twin report shall be sent using twin_messenger_report_state_async, passing `on_report_state_complete_callback` and `twin_ctx`]
             if (twin_messenger_report_state_async(instance->twin_messenger_handle, data, on_report_state_complete_callback, (const void*)twin_ctx) != 0)
             {
@@ -1640,6 +1704,9 @@ int device_subscribe_for_twin_updates(AMQP_DEVICE_HANDLE handle, DEVICE_TWIN_UPD
         instance->on_device_twin_update_received_callback = on_device_twin_update_received_callback;
         instance->on_device_twin_update_received_context = context;
 
+        // Codes_SRS_DEVICE_41_009: [device_send_twin_update_async, device_subscribe_for_twin_updates and device_get_twin_async shall mark the twin links as in use]
+        mark_twin_in_use(instance);
+
         // Codes_SRS_DEVICE_09_144: [twin_messenger_subscribe shall be invoked passing `on_twin_state_update_callback`]
         if (twin_messenger_subscribe(instance->twin_messenger_handle, on_twin_state_update_callback, (void*)instance) != 0)
         {
@@ -1718,6 +1785,9 @@ int device_get_twin_async(AMQP_DEVICE_HANDLE handle, DEVICE_TWIN_UPDATE_RECEIVED
             twin_ctx->on_get_twin_completed_callback = on_device_get_twin_completed_callback;
             twin_ctx->context = context;
 
+            // Codes_SRS_DEVICE_41_009: [device_send_twin_update_async, device_subscribe_for_twin_updates and device_get_twin_async shall mark the twin links as in use]
+            mark_twin_in_use(instance);
+
             // Codes_SRS_DEVICE_09_153: [twin_messenger_get_twin_async shall be invoked ]
             if (twin_messenger_get_twin_async(instance->twin_messenger_handle, on_get_twin_completed, twin_ctx) != 0)
             {
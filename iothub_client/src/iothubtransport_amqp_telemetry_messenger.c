@@ -11,6 +11,7 @@
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/uniqueid.h"
 #include "azure_c_shared_utility/singlylinkedlist.h"
+#include "azure_c_shared_utility/tickcounter.h"
 #include "azure_uamqp_c/link.h"
 #include "azure_uamqp_c/messaging.h"
 #include "azure_uamqp_c/message_sender.h"
@@ -46,6 +47,9 @@ typedef struct TELEMETRY_MESSENGER_INSTANCE_TAG
     STRING_HANDLE module_id;
     STRING_HANDLE product_info;
     STRING_HANDLE iothub_host_fqdn;
+    STRING_HANDLE event_send_address;          // Link addresses and attach properties only depend on the device, so they outlive each link.
+    STRING_HANDLE message_receive_address;
+    AMQP_VALUE link_attach_properties;
     SINGLYLINKEDLIST_HANDLE waiting_to_send;   // List of MESSENGER_SEND_EVENT_CALLER_INFORMATION's
     SINGLYLINKEDLIST_HANDLE in_progress_list;  // List of MESSENGER_SEND_EVENT_TASK's
     TELEMETRY_MESSENGER_STATE state;
@@ -72,6 +76,14 @@ typedef struct TELEMETRY_MESSENGER_INSTANCE_TAG
     size_t event_send_timeout_secs;
     time_t last_message_sender_state_change_time;
     time_t last_message_receiver_state_change_time;
+
+    size_t batch_linger_ms;
+    size_t batch_max_messages;
+    size_t c2d_link_credit;                    // 0 leaves the receiver link with uAMQP's default credit.
+    TICK_COUNTER_HANDLE batch_tick_counter;
+    ON_TELEMETRY_MESSENGER_BATCH_SENT on_batch_sent_callback;
+    void* on_batch_sent_context;
+    UAMQP_ENCODING_CACHE_HANDLE encoding_cache;
 } TELEMETRY_MESSENGER_INSTANCE;
 
 // MESSENGER_SEND_EVENT_CALLER_INFORMATION corresponds to a message sent from the API, including
@@ -81,6 +93,7 @@ typedef struct MESSENGER_SEND_EVENT_CALLER_INFORMATION_TAG
     IOTHUB_MESSAGE_LIST* message;
     ON_TELEMETRY_MESSENGER_EVENT_SEND_COMPLETE on_event_send_complete_callback;
     void* context;
+    tickcounter_ms_t enqueue_time;
 } MESSENGER_SEND_EVENT_CALLER_INFORMATION;
 
 // MESSENGER_SEND_EVENT_TASK interfaces with underlying uAMQP layer.  It receives the callback
@@ -309,7 +322,7 @@ static void update_messenger_state(TELEMETRY_MESSENGER_INSTANCE* instance, TELEM
     }
 }
 
-static void attach_device_client_type_to_link(LINK_HANDLE link, STRING_HANDLE product_info)
+static AMQP_VALUE create_link_attach_properties(STRING_HANDLE product_info)
 {
     fields attach_properties;
     AMQP_VALUE device_client_type_key_name;
@@ -324,22 +337,24 @@ static void attach_device_client_type_to_link(LINK_HANDLE link, STRING_HANDLE pr
         if ((device_client_type_key_name = amqpvalue_create_symbol("com.microsoft:client-version")) == NULL)
         {
             LogError("Failed to create the key name for the device client type.");
+            amqpvalue_destroy(attach_properties);
+            attach_properties = NULL;
         }
         else
         {
             if ((device_client_type_value = amqpvalue_create_string(STRING_c_str(product_info))) == NULL)
             {
                 LogError("Failed to create the key value for the device client type.");
+                amqpvalue_destroy(attach_properties);
+                attach_properties = NULL;
             }
             else
             {
                 if (amqpvalue_set_map_value(attach_properties, device_client_type_key_name, device_client_type_value) != 0)
                 {
                     LogError("Failed to set the property map for the device client type");
-                }
-                else if (link_set_attach_properties(link, attach_properties) != 0)
-                {
-                    LogError("Unable to attach the device client type to the link properties");
+                    amqpvalue_destroy(attach_properties);
+                    attach_properties = NULL;
                 }
 
                 amqpvalue_destroy(device_client_type_value);
@@ -347,9 +362,57 @@ static void attach_device_client_type_to_link(LINK_HANDLE link, STRING_HANDLE pr
 
             amqpvalue_destroy(device_client_type_key_name);
         }
+    }
+
+    return attach_properties;
+}
+
+static void attach_device_client_type_to_link(TELEMETRY_MESSENGER_INSTANCE* instance, LINK_HANDLE link)
+{
+    if (instance->link_attach_properties == NULL)
+    {
+        LogError("Device client type not attached to the link (no attach properties)");
+    }
+    else if (link_set_attach_properties(link, instance->link_attach_properties) != 0)
+    {
+        LogError("Unable to attach the device client type to the link properties");
+    }
+}
+
+static int create_link_addresses(TELEMETRY_MESSENGER_INSTANCE* instance)
+{
+    int result;
+    STRING_HANDLE devices_and_modules_path;
+
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_033: [A variable, named `devices_and_modules_path`, shall be created concatenating `instance->iothub_host_fqdn`, "/devices/" and `instance->device_id` (and "/modules/" and `instance->module_id` if modules are present)]
+    if ((devices_and_modules_path = create_devices_and_modules_path(instance->iothub_host_fqdn, instance->device_id, instance->module_id)) == NULL)
+    {
+        LogError("Failed creating the link addresses (failed creating the 'devices_and_modules_path')");
+        result = __FAILURE__;
+    }
+    else
+    {
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_035: [A variable, named `event_send_address`, shall be created concatenating "amqps://", `devices_and_modules_path` and "/messages/events"]
+        if ((instance->event_send_address = create_event_send_address(devices_and_modules_path)) == NULL)
+        {
+            LogError("Failed creating the link addresses (failed creating the 'event_send_address')");
+            result = __FAILURE__;
+        }
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_070: [A variable, named `message_receive_address`, shall be created concatenating "amqps://", `devices_and_modules_path` and "/messages/devicebound"]
+        else if ((instance->message_receive_address = create_message_receive_address(devices_and_modules_path)) == NULL)
+        {
+            LogError("Failed creating the link addresses (failed creating the 'message_receive_address')");
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = RESULT_OK;
+        }
 
-        amqpvalue_destroy(attach_properties);
+        STRING_delete(devices_and_modules_path);
     }
+
+    return result;
 }
 
 static void destroy_event_sender(TELEMETRY_MESSENGER_INSTANCE* instance)
@@ -399,25 +462,9 @@ static int create_event_sender(TELEMETRY_MESSENGER_INSTANCE* instance)
     STRING_HANDLE source_name = NULL;
     AMQP_VALUE source = NULL;
     AMQP_VALUE target = NULL;
-    STRING_HANDLE devices_and_modules_path = NULL;
-    STRING_HANDLE event_send_address = NULL;
 
-    // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_033: [A variable, named `devices_and_modules_path`, shall be created concatenating `instance->iothub_host_fqdn`, "/devices/" and `instance->device_id` (and "/modules/" and `instance->module_id` if modules are present)]
-    if ((devices_and_modules_path = create_devices_and_modules_path(instance->iothub_host_fqdn, instance->device_id, instance->module_id)) == NULL)
-    {
-        // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_034: [If `devices_and_modules_path` fails to be created, telemetry_messenger_do_work() shall fail and return]
-        result = __FAILURE__;
-        LogError("Failed creating the message sender (failed creating the 'devices_and_modules_path')");
-    }
-    // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_035: [A variable, named `event_send_address`, shall be created concatenating "amqps://", `devices_and_modules_path` and "/messages/events"]
-    else if ((event_send_address = create_event_send_address(devices_and_modules_path)) == NULL)
-    {
-        // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_036: [If `event_send_address` fails to be created, telemetry_messenger_do_work() shall fail and return]
-        result = __FAILURE__;
-        LogError("Failed creating the message sender (failed creating the 'event_send_address')");
-    }
     // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_037: [A `link_name` variable shall be created using an unique string label per AMQP session]
-    else if ((link_name = create_link_name(MESSAGE_SENDER_LINK_NAME_PREFIX, STRING_c_str(instance->device_id))) == NULL)
+    if ((link_name = create_link_name(MESSAGE_SENDER_LINK_NAME_PREFIX, STRING_c_str(instance->device_id))) == NULL)
     {
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_038: [If `link_name` fails to be created, telemetry_messenger_do_work() shall fail and return]
         result = __FAILURE__;
@@ -436,7 +483,7 @@ static int create_event_sender(TELEMETRY_MESSENGER_INSTANCE* instance)
         LogError("Failed creating the message sender (messaging_create_source failed)");
     }
     // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_041: [A `target` variable shall be created with messaging_create_target() using `event_send_address`]
-    else if ((target = messaging_create_target(STRING_c_str(event_send_address))) == NULL)
+    else if ((target = messaging_create_target(STRING_c_str(instance->event_send_address))) == NULL)
     {
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_042: [If `target` fails to be created, telemetry_messenger_do_work() shall fail and return]
         result = __FAILURE__;
@@ -460,7 +507,7 @@ static int create_event_sender(TELEMETRY_MESSENGER_INSTANCE* instance)
 
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_049: [`instance->sender_link` should have a property "com.microsoft:client-version" set as `CLIENT_DEVICE_TYPE_PREFIX/IOTHUB_SDK_VERSION`, using amqpvalue_set_map_value() and link_set_attach_properties()]
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_050: [If amqpvalue_set_map_value() or link_set_attach_properties() fail, the failure shall be ignored]
-        attach_device_client_type_to_link(instance->sender_link, instance->product_info);
+        attach_device_client_type_to_link(instance, instance->sender_link);
 
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_051: [`instance->message_sender` shall be created using messagesender_create(), passing the `instance->sender_link` and `on_event_sender_state_changed_callback`]
         if ((instance->message_sender = messagesender_create(instance->sender_link, on_event_sender_state_changed_callback, (void*)instance)) == NULL)
@@ -496,10 +543,6 @@ static int create_event_sender(TELEMETRY_MESSENGER_INSTANCE* instance)
         amqpvalue_destroy(source);
     if (target != NULL)
         amqpvalue_destroy(target);
-    if (devices_and_modules_path != NULL)
-        STRING_delete(devices_and_modules_path);
-    if (event_send_address != NULL)
-        STRING_delete(event_send_address);
 
     return result;
 }
@@ -556,57 +599,33 @@ static void on_message_receiver_state_changed_callback(const void* context, MESS
     }
 }
 
-static TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO* create_message_disposition_info(TELEMETRY_MESSENGER_INSTANCE* messenger)
+static int fill_message_disposition_info(TELEMETRY_MESSENGER_INSTANCE* messenger, TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO* disposition_info)
 {
-    TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO* result;
+    int result;
+    delivery_number message_id;
+    const char* link_name;
 
-    if ((result = (TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO*)malloc(sizeof(TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO))) == NULL)
+    if (messagereceiver_get_received_message_id(messenger->message_receiver, &message_id) != RESULT_OK)
     {
-        LogError("Failed creating TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO container (malloc failed)");
-        result = NULL;
+        LogError("Failed filling TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO (messagereceiver_get_received_message_id failed)");
+        result = __FAILURE__;
+    }
+    else if (messagereceiver_get_link_name(messenger->message_receiver, &link_name) != RESULT_OK)
+    {
+        LogError("Failed filling TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO (messagereceiver_get_link_name failed)");
+        result = __FAILURE__;
     }
     else
     {
-        delivery_number message_id;
-
-        if (messagereceiver_get_received_message_id(messenger->message_receiver, &message_id) != RESULT_OK)
-        {
-            LogError("Failed creating TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO container (messagereceiver_get_received_message_id failed)");
-            free(result);
-            result = NULL;
-        }
-        else
-        {
-            const char* link_name;
-
-            if (messagereceiver_get_link_name(messenger->message_receiver, &link_name) != RESULT_OK)
-            {
-                LogError("Failed creating TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO container (messagereceiver_get_link_name failed)");
-                free(result);
-                result = NULL;
-            }
-            else if (mallocAndStrcpy_s(&result->source, link_name) != RESULT_OK)
-            {
-                LogError("Failed creating TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO container (failed copying link name)");
-                free(result);
-                result = NULL;
-            }
-            else
-            {
-                result->message_id = message_id;
-            }
-        }
+        // The link name is owned by the message receiver, which outlives the on_message_received callback.
+        disposition_info->source = (char*)link_name;
+        disposition_info->message_id = message_id;
+        result = RESULT_OK;
     }
 
     return result;
 }
 
-static void destroy_message_disposition_info(TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO* disposition_info)
-{
-    free(disposition_info->source);
-    free(disposition_info);
-}
-
 static AMQP_VALUE create_uamqp_disposition_result_from(TELEMETRY_MESSENGER_DISPOSITION_RESULT disposition_result)
 {
     AMQP_VALUE uamqp_disposition_result;
@@ -652,10 +671,10 @@ static AMQP_VALUE on_message_received_internal_callback(const void* context, MES
     else
     {
         TELEMETRY_MESSENGER_INSTANCE* instance = (TELEMETRY_MESSENGER_INSTANCE*)context;
-        TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO* message_disposition_info;
+        TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO message_disposition_info;
 
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_186: [A TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO instance shall be created containing the source link name and message delivery ID]
-        if ((message_disposition_info = create_message_disposition_info(instance)) == NULL)
+        if (fill_message_disposition_info(instance, &message_disposition_info) != RESULT_OK)
         {
             // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_187: [**If the TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO instance fails to be created, on_message_received_internal_callback shall return messaging_delivery_released()]
             LogError("on_message_received_internal_callback failed (failed creating TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO).");
@@ -664,10 +683,8 @@ static AMQP_VALUE on_message_received_internal_callback(const void* context, MES
         else
         {
             // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_123: [`instance->on_message_received_callback` shall be invoked passing the IOTHUB_MESSAGE_HANDLE and TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO instance]
-            TELEMETRY_MESSENGER_DISPOSITION_RESULT disposition_result = instance->on_message_received_callback(iothub_message, message_disposition_info, instance->on_message_received_context);
-
-            // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_188: [The memory allocated for the TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO instance shall be released]
-            destroy_message_disposition_info(message_disposition_info);
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_012: [The TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO instance shall not be allocated; its `source` shall refer to the link name of `instance->message_receiver` and it shall only be valid while `instance->on_message_received_callback` runs]
+            TELEMETRY_MESSENGER_DISPOSITION_RESULT disposition_result = instance->on_message_received_callback(iothub_message, &message_disposition_info, instance->on_message_received_context);
 
             // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_125: [If `instance->on_message_received_callback` returns TELEMETRY_MESSENGER_DISPOSITION_RESULT_ACCEPTED, on_message_received_internal_callback shall return the result of messaging_delivery_accepted()]
             // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_126: [If `instance->on_message_received_callback` returns TELEMETRY_MESSENGER_DISPOSITION_RESULT_RELEASED, on_message_received_internal_callback shall return the result of messaging_delivery_released()]
@@ -683,29 +700,13 @@ static int create_message_receiver(TELEMETRY_MESSENGER_INSTANCE* instance)
 {
     int result;
 
-    STRING_HANDLE devices_and_modules_path = NULL;
-    STRING_HANDLE message_receive_address = NULL;
     STRING_HANDLE link_name = NULL;
     STRING_HANDLE target_name = NULL;
     AMQP_VALUE source = NULL;
     AMQP_VALUE target = NULL;
 
-    // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_068: [A variable, named `devices_and_modules_path`, shall be created concatenating `instance->iothub_host_fqdn`, "/devices/" and `instance->device_id` (and "/modules/" and `instance->module_id` if modules are present)]
-    if ((devices_and_modules_path = create_devices_and_modules_path(instance->iothub_host_fqdn, instance->device_id, instance->module_id)) == NULL)
-    {
-        // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_069: [If `devices_and_modules_path` fails to be created, telemetry_messenger_do_work() shall fail and return]
-        result = __FAILURE__;
-        LogError("Failed creating the message receiver (failed creating the 'devices_and_modules_path')");
-    }
-    // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_070: [A variable, named `message_receive_address`, shall be created concatenating "amqps://", `devices_and_modules_path` and "/messages/devicebound"]
-    else if ((message_receive_address = create_message_receive_address(devices_and_modules_path)) == NULL)
-    {
-        // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_071: [If `message_receive_address` fails to be created, telemetry_messenger_do_work() shall fail and return]
-        result = __FAILURE__;
-        LogError("Failed creating the message receiver (failed creating the 'message_receive_address')");
-    }
     // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_072: [A `link_name` variable shall be created using an unique string label per AMQP session]
-    else if ((link_name = create_link_name(MESSAGE_RECEIVER_LINK_NAME_PREFIX, STRING_c_str(instance->device_id))) == NULL)
+    if ((link_name = create_link_name(MESSAGE_RECEIVER_LINK_NAME_PREFIX, STRING_c_str(instance->device_id))) == NULL)
     {
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_073: [If `link_name` fails to be created, telemetry_messenger_do_work() shall fail and return]
         result = __FAILURE__;
@@ -724,7 +725,7 @@ static int create_message_receiver(TELEMETRY_MESSENGER_INSTANCE* instance)
         LogError("Failed creating the message receiver (messaging_create_target failed)");
     }
     // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_076: [A `source` variable shall be created with messaging_create_source() using `message_receive_address`]
-    else if ((source = messaging_create_source(STRING_c_str(message_receive_address))) == NULL)
+    else if ((source = messaging_create_source(STRING_c_str(instance->message_receive_address))) == NULL)
     {
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_077: [If `source` fails to be created, telemetry_messenger_do_work() shall fail and return]
         result = __FAILURE__;
@@ -753,9 +754,16 @@ static int create_message_receiver(TELEMETRY_MESSENGER_INSTANCE* instance)
             LogError("Failed setting message receiver link max message size.");
         }
 
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_011: [If `instance->c2d_link_credit` is set, it shall be set as the `instance->receiver_link` maximum link credit using link_set_max_link_credit(); if it fails, it shall be logged and ignored]
+        if (instance->c2d_link_credit > 0 &&
+            link_set_max_link_credit(instance->receiver_link, (uint32_t)instance->c2d_link_credit) != RESULT_OK)
+        {
+            LogError("Failed setting message receiver link credit.");
+        }
+
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_084: [`instance->receiver_link` should have a property "com.microsoft:client-version" set as `CLIENT_DEVICE_TYPE_PREFIX/IOTHUB_SDK_VERSION`, using amqpvalue_set_map_value() and link_set_attach_properties()]
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_085: [If amqpvalue_set_map_value() or link_set_attach_properties() fail, the failure shall be ignored]
-        attach_device_client_type_to_link(instance->receiver_link, instance->product_info);
+        attach_device_client_type_to_link(instance, instance->receiver_link);
 
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_086: [`instance->message_receiver` shall be created using messagereceiver_create(), passing the `instance->receiver_link` and `on_messagereceiver_state_changed_callback`]
         if ((instance->message_receiver = messagereceiver_create(instance->receiver_link, on_message_receiver_state_changed_callback, (void*)instance)) == NULL)
@@ -782,10 +790,6 @@ static int create_message_receiver(TELEMETRY_MESSENGER_INSTANCE* instance)
         }
     }
 
-    if (devices_and_modules_path != NULL)
-        STRING_delete(devices_and_modules_path);
-    if (message_receive_address != NULL)
-        STRING_delete(message_receive_address);
     if (link_name != NULL)
         STRING_delete(link_name);
     if (target_name != NULL)
@@ -1092,6 +1096,7 @@ typedef struct SEND_PENDING_EVENTS_STATE_TAG
     MESSENGER_SEND_EVENT_TASK* task;
     MESSAGE_HANDLE message_batch_container;
     uint64_t bytes_pending;
+    size_t messages_pending;
 } SEND_PENDING_EVENTS_STATE;
 
 
@@ -1130,7 +1135,7 @@ static void invoke_callback_on_error(MESSENGER_SEND_EVENT_CALLER_INFORMATION* ca
 }
 
 // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_31_194: [When message is ready to send, invoke AMQP's messagesender_send and free temporary values associated with this batch.]
-static int send_batched_message_and_reset_state(TELEMETRY_MESSENGER_INSTANCE* instance, SEND_PENDING_EVENTS_STATE *send_pending_events_state)
+static int send_batched_message_and_reset_state(TELEMETRY_MESSENGER_INSTANCE* instance, SEND_PENDING_EVENTS_STATE *send_pending_events_state, uint64_t max_messagesize)
 {
     int result;
 
@@ -1142,6 +1147,13 @@ static int send_batched_message_and_reset_state(TELEMETRY_MESSENGER_INSTANCE* in
     else
     {
         send_pending_events_state->task->send_time = get_time(NULL);
+
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_004: [If `on_batch_sent_callback` was provided, it shall be invoked with the number of events and bytes in the batch and the maximum batch size of the link.]
+        if (instance->on_batch_sent_callback != NULL)
+        {
+            instance->on_batch_sent_callback(send_pending_events_state->messages_pending, (size_t)send_pending_events_state->bytes_pending, (size_t)max_messagesize, instance->on_batch_sent_context);
+        }
+
         result = RESULT_OK;
     }
 
@@ -1176,6 +1188,37 @@ static int get_max_message_size_for_batching(TELEMETRY_MESSENGER_INSTANCE* insta
     return result;
 }
 
+// @brief
+//     Evaluates if the events waiting to be sent shall be held for a little longer so more of them get into the same batch.
+// @returns
+//     true if the oldest event waiting was enqueued less than `batch_linger_ms` ago and fewer than `batch_max_messages` are waiting, false otherwise.
+static bool is_batch_lingering(TELEMETRY_MESSENGER_INSTANCE* instance)
+{
+    bool result = false;
+    LIST_ITEM_HANDLE list_item;
+    tickcounter_ms_t current_ms;
+
+    if ((list_item = singlylinkedlist_get_head_item(instance->waiting_to_send)) != NULL &&
+        tickcounter_get_current_ms(instance->batch_tick_counter, &current_ms) == 0)
+    {
+        MESSENGER_SEND_EVENT_CALLER_INFORMATION* oldest = (MESSENGER_SEND_EVENT_CALLER_INFORMATION*)singlylinkedlist_item_get_value(list_item);
+
+        if (current_ms - oldest->enqueue_time < (tickcounter_ms_t)instance->batch_linger_ms)
+        {
+            size_t waiting_count = 1;
+
+            while (waiting_count < instance->batch_max_messages && (list_item = singlylinkedlist_get_next_item(list_item)) != NULL)
+            {
+                waiting_count++;
+            }
+
+            result = (instance->batch_max_messages == 0 || waiting_count < instance->batch_max_messages);
+        }
+    }
+
+    return result;
+}
+
 static int send_pending_events(TELEMETRY_MESSENGER_INSTANCE* instance)
 {
     int result = RESULT_OK;
@@ -1194,11 +1237,7 @@ static int send_pending_events(TELEMETRY_MESSENGER_INSTANCE* instance)
     // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_31_199: [Errors specific to a message (e.g. failure to encode) are NOT fatal but we'll keep processing.  More general errors (e.g. out of memory) will stop processing.]
     while ((caller_info = get_next_caller_message_to_send(instance)) != NULL)
     {
-        if (body_binary_data.bytes != NULL)
-        {
-            // Free here as this may have been set during previous run through loop.
-            free((unsigned char*)body_binary_data.bytes);
-        }
+        // The encoded bytes belong to instance->encoding_cache, which reuses them for the next message.
         memset(&body_binary_data, 0, sizeof(body_binary_data));
 
         if ((0 == max_messagesize) && (get_max_message_size_for_batching(instance, &max_messagesize)) != 0)
@@ -1218,7 +1257,8 @@ static int send_pending_events(TELEMETRY_MESSENGER_INSTANCE* instance)
             break;
         }
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_31_200: [Retrieve an AMQP encoded representation of this message for later appending to main batched message.  On error, invoke callback but continue send loop; this is NOT a fatal error.]
-        else if (message_create_uamqp_encoding_from_iothub_message(send_pending_events_state.message_batch_container, caller_info->message->messageHandle, &body_binary_data) != RESULT_OK)
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_006: [Messages shall be encoded with message_create_uamqp_encoding_from_iothub_message_with_cache using `instance->encoding_cache`, whose bytes shall not be freed by the messenger]
+        else if (message_create_uamqp_encoding_from_iothub_message_with_cache(instance->encoding_cache, send_pending_events_state.message_batch_container, caller_info->message->messageHandle, &body_binary_data) != RESULT_OK)
         {
             // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_31_201: [If message_create_uamqp_encoding_from_iothub_message fails, invoke callback with TELEMETRY_MESSENGER_EVENT_SEND_COMPLETE_RESULT_ERROR_CANNOT_PARSE]
             LogError("message_create_uamqp_encoding_from_iothub_message() failed.  Will continue to try to process messages, result");
@@ -1251,7 +1291,7 @@ static int send_pending_events(TELEMETRY_MESSENGER_INSTANCE* instance)
         if (body_binary_data.length + send_pending_events_state.bytes_pending > max_messagesize)
         {
             // If we tried to add the current message, we would overflow.  Send what we've queued immediately.
-            if (send_batched_message_and_reset_state(instance, &send_pending_events_state) != RESULT_OK)
+            if (send_batched_message_and_reset_state(instance, &send_pending_events_state, max_messagesize) != RESULT_OK)
             {
                 LogError("send_batched_message_and_reset_state failed");
                 result = __FAILURE__;
@@ -1276,22 +1316,29 @@ static int send_pending_events(TELEMETRY_MESSENGER_INSTANCE* instance)
         }
 
         send_pending_events_state.bytes_pending += body_binary_data.length;
+        send_pending_events_state.messages_pending++;
+
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_003: [If `batch_max_messages` is set and the batched message holds that many events, it shall be sent and the next event shall start a new batched message.]
+        if (instance->batch_max_messages > 0 && send_pending_events_state.messages_pending >= instance->batch_max_messages)
+        {
+            if (send_batched_message_and_reset_state(instance, &send_pending_events_state, max_messagesize) != RESULT_OK)
+            {
+                LogError("send_batched_message_and_reset_state failed");
+                result = __FAILURE__;
+                break;
+            }
+        }
     }
 
     if ((result == 0) && (send_pending_events_state.bytes_pending != 0))
     {
-        if (send_batched_message_and_reset_state(instance, &send_pending_events_state) != RESULT_OK)
+        if (send_batched_message_and_reset_state(instance, &send_pending_events_state, max_messagesize) != RESULT_OK)
         {
             LogError("send_batched_message_and_reset_state failed");
             result = __FAILURE__;
         }
     }
 
-    if (body_binary_data.bytes != NULL)
-    {
-        free((unsigned char*)body_binary_data.bytes);
-    }
-
     // A non-NULL task indicates error, since otherwise send_batched_message_and_reset_state would've sent off messages and reset send_pending_events_state
     if (send_pending_events_state.task != NULL)
     {
@@ -1393,6 +1440,9 @@ static void* telemetry_messenger_clone_option(const char* name, const void* valu
     else
     {
         if (strcmp(TELEMETRY_MESSENGER_OPTION_EVENT_SEND_TIMEOUT_SECS, name) == 0 ||
+            strcmp(TELEMETRY_MESSENGER_OPTION_BATCH_LINGER_MS, name) == 0 ||
+            strcmp(TELEMETRY_MESSENGER_OPTION_BATCH_MAX_MESSAGES, name) == 0 ||
+            strcmp(TELEMETRY_MESSENGER_OPTION_C2D_LINK_CREDIT, name) == 0 ||
             strcmp(TELEMETRY_MESSENGER_OPTION_SAVED_OPTIONS, name) == 0)
         {
             result = (void*)value;
@@ -1622,6 +1672,12 @@ int telemetry_messenger_send_async(TELEMETRY_MESSENGER_HANDLE messenger_handle,
             caller_info->on_event_send_complete_callback = on_messenger_event_send_complete_callback;
             caller_info->context = context;
 
+            if (instance->batch_tick_counter != NULL &&
+                tickcounter_get_current_ms(instance->batch_tick_counter, &caller_info->enqueue_time) != 0)
+            {
+                LogError("Failed reading the enqueue time of the event; it will not linger");
+            }
+
             // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_143: [If no failures occur, telemetry_messenger_send_async() shall return zero]
             result = RESULT_OK;
         }
@@ -1881,7 +1937,9 @@ void telemetry_messenger_do_work(TELEMETRY_MESSENGER_HANDLE messenger_handle)
             {
                 update_messenger_state(instance, TELEMETRY_MESSENGER_STATE_ERROR);
             }
-            else if (send_pending_events(instance) != RESULT_OK && instance->event_send_retry_limit > 0)
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_002: [If `batch_linger_ms` is set, no events shall be sent while the oldest event waiting is younger than `batch_linger_ms` and fewer than `batch_max_messages` events are waiting.]
+            else if ((instance->batch_linger_ms == 0 || !is_batch_lingering(instance)) &&
+                send_pending_events(instance) != RESULT_OK && instance->event_send_retry_limit > 0)
             {
                 instance->event_send_error_count++;
 
@@ -1962,6 +2020,25 @@ void telemetry_messenger_destroy(TELEMETRY_MESSENGER_HANDLE messenger_handle)
 
         STRING_delete(instance->product_info);
 
+        STRING_delete(instance->event_send_address);
+
+        STRING_delete(instance->message_receive_address);
+
+        if (instance->link_attach_properties != NULL)
+        {
+            amqpvalue_destroy(instance->link_attach_properties);
+        }
+
+        if (instance->batch_tick_counter != NULL)
+        {
+            tickcounter_destroy(instance->batch_tick_counter);
+        }
+
+        if (instance->encoding_cache != NULL)
+        {
+            uamqp_encoding_cache_destroy(instance->encoding_cache);
+        }
+
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_114: [telemetry_messenger_destroy() shall destroy `instance` with free()]
         (void)free(instance);
     }
@@ -2051,14 +2128,32 @@ TELEMETRY_MESSENGER_HANDLE telemetry_messenger_create(const TELEMETRY_MESSENGER_
                 handle = NULL;
                 LogError("telemetry_messenger_create failed (singlylinkedlist_create failed to create in_progress_list)");
             }
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_007: [`instance->encoding_cache` shall be set using uamqp_encoding_cache_create(); if it fails, telemetry_messenger_create() shall fail and return NULL]
+            else if ((instance->encoding_cache = uamqp_encoding_cache_create()) == NULL)
+            {
+                handle = NULL;
+                LogError("telemetry_messenger_create failed (uamqp_encoding_cache_create failed)");
+            }
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_008: [telemetry_messenger_create() shall create `instance->event_send_address` and `instance->message_receive_address` once, to be used by every message sender and receiver link; if it fails, telemetry_messenger_create() shall fail and return NULL]
+            else if (create_link_addresses(instance) != RESULT_OK)
+            {
+                handle = NULL;
+                LogError("telemetry_messenger_create failed (create_link_addresses failed)");
+            }
             else
             {
+                // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_009: [telemetry_messenger_create() shall create the "com.microsoft:client-version" link attach properties once; if it fails, links shall be created without them]
+                instance->link_attach_properties = create_link_attach_properties(instance->product_info);
+
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_013: [`messenger_config->on_state_changed_callback` shall be saved into `instance->on_state_changed_callback`]
                 instance->on_state_changed_callback = messenger_config->on_state_changed_callback;
 
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_014: [`messenger_config->on_state_changed_context` shall be saved into `instance->on_state_changed_context`]
                 instance->on_state_changed_context = messenger_config->on_state_changed_context;
 
+                instance->on_batch_sent_callback = messenger_config->on_batch_sent_callback;
+                instance->on_batch_sent_context = messenger_config->on_batch_sent_context;
+
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_015: [If no failures occurr, telemetry_messenger_create() shall return a handle to `instance`]
                 handle = (TELEMETRY_MESSENGER_HANDLE)instance;
             }
@@ -2094,6 +2189,33 @@ int telemetry_messenger_set_option(TELEMETRY_MESSENGER_HANDLE messenger_handle,
             instance->event_send_timeout_secs = *((size_t*)value);
             result = RESULT_OK;
         }
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_001: [If name matches TELEMETRY_MESSENGER_OPTION_BATCH_LINGER_MS, `value` shall be saved on `instance->batch_linger_ms`, creating the tick counter used to age the waiting events if needed]
+        else if (strcmp(TELEMETRY_MESSENGER_OPTION_BATCH_LINGER_MS, name) == 0)
+        {
+            if (*((size_t*)value) > 0 && instance->batch_tick_counter == NULL &&
+                (instance->batch_tick_counter = tickcounter_create()) == NULL)
+            {
+                LogError("telemetry_messenger_set_option failed (tickcounter_create failed)");
+                result = __FAILURE__;
+            }
+            else
+            {
+                instance->batch_linger_ms = *((size_t*)value);
+                result = RESULT_OK;
+            }
+        }
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_005: [If name matches TELEMETRY_MESSENGER_OPTION_BATCH_MAX_MESSAGES, `value` shall be saved on `instance->batch_max_messages`]
+        else if (strcmp(TELEMETRY_MESSENGER_OPTION_BATCH_MAX_MESSAGES, name) == 0)
+        {
+            instance->batch_max_messages = *((size_t*)value);
+            result = RESULT_OK;
+        }
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_010: [If name matches TELEMETRY_MESSENGER_OPTION_C2D_LINK_CREDIT, `value` shall be saved on `instance->c2d_link_credit`, to be used by the next message receiver created]
+        else if (strcmp(TELEMETRY_MESSENGER_OPTION_C2D_LINK_CREDIT, name) == 0)
+        {
+            instance->c2d_link_credit = *((size_t*)value);
+            result = RESULT_OK;
+        }
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_169: [If name matches TELEMETRY_MESSENGER_OPTION_SAVED_OPTIONS, `value` shall be applied using OptionHandler_FeedOptions]
         else if (strcmp(TELEMETRY_MESSENGER_OPTION_SAVED_OPTIONS, name) == 0)
         {
@@ -2152,6 +2274,24 @@ OPTIONHANDLER_HANDLE telemetry_messenger_retrieve_options(TELEMETRY_MESSENGER_HA
                 LogError("Failed to retrieve options from messenger instance (OptionHandler_Create failed for option '%s')", TELEMETRY_MESSENGER_OPTION_EVENT_SEND_TIMEOUT_SECS);
                 result = NULL;
             }
+            else if (instance->batch_linger_ms > 0 &&
+                OptionHandler_AddOption(options, TELEMETRY_MESSENGER_OPTION_BATCH_LINGER_MS, (void*)&instance->batch_linger_ms) != OPTIONHANDLER_OK)
+            {
+                LogError("Failed to retrieve options from messenger instance (OptionHandler_Create failed for option '%s')", TELEMETRY_MESSENGER_OPTION_BATCH_LINGER_MS);
+                result = NULL;
+            }
+            else if (instance->batch_max_messages > 0 &&
+                OptionHandler_AddOption(options, TELEMETRY_MESSENGER_OPTION_BATCH_MAX_MESSAGES, (void*)&instance->batch_max_messages) != OPTIONHANDLER_OK)
+            {
+                LogError("Failed to retrieve options from messenger instance (OptionHandler_Create failed for option '%s')", TELEMETRY_MESSENGER_OPTION_BATCH_MAX_MESSAGES);
+                result = NULL;
+            }
+            else if (instance->c2d_link_credit > 0 &&
+                OptionHandler_AddOption(options, TELEMETRY_MESSENGER_OPTION_C2D_LINK_CREDIT, (void*)&instance->c2d_link_credit) != OPTIONHANDLER_OK)
+            {
+                LogError("Failed to retrieve options from messenger instance (OptionHandler_Create failed for option '%s')", TELEMETRY_MESSENGER_OPTION_C2D_LINK_CREDIT);
+                result = NULL;
+            }
             else
             {
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_179: [If no failures occur, telemetry_messenger_retrieve_options shall return the OPTIONHANDLER_HANDLE instance]
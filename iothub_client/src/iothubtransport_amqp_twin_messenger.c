@@ -49,6 +49,10 @@ DEFINE_ENUM_STRINGS(TWIN_UPDATE_TYPE, TWIN_UPDATE_TYPE_VALUES);
 #define DEFAULT_MAX_TWIN_SUBSCRIPTION_ERROR_COUNT       3
 #define DEFAULT_TWIN_OPERATION_TIMEOUT_SECS             300.0
 
+#define TWIN_OPERATION_INDEX_SIZE                       64
+#define TWIN_OPERATION_CORRELATION_ID_FORMAT            "%lu"
+#define TWIN_OPERATION_CORRELATION_ID_BUFFER_SIZE       24
+
 static char* DEFAULT_TWIN_SEND_LINK_SOURCE_NAME =       "twin";
 static char* DEFAULT_TWIN_RECEIVE_LINK_TARGET_NAME =    "twin";
 
@@ -98,6 +102,9 @@ typedef struct TWIN_MESSENGER_INSTANCE_TAG
 
     SINGLYLINKEDLIST_HANDLE pending_patches;
     SINGLYLINKEDLIST_HANDLE operations;
+    // Operations in flight, by correlation id modulo TWIN_OPERATION_INDEX_SIZE. Collisions are only found in `operations`.
+    struct TWIN_OPERATION_CONTEXT_TAG* operations_index[TWIN_OPERATION_INDEX_SIZE];
+    unsigned long next_correlation_id;
 
     TWIN_MESSENGER_STATE_CHANGED_CALLBACK on_state_changed_callback;
     void* on_state_changed_context;
@@ -120,11 +127,19 @@ typedef struct TWIN_PATCH_OPERATION_CONTEXT_TAG
     time_t time_enqueued;
 } TWIN_PATCH_OPERATION_CONTEXT;
 
+typedef struct TWIN_GET_WAITER_TAG
+{
+    TWIN_STATE_UPDATE_CALLBACK callback;
+    const void* context;
+    struct TWIN_GET_WAITER_TAG* next;
+} TWIN_GET_WAITER;
+
 typedef struct TWIN_OPERATION_CONTEXT_TAG
 {
     TWIN_OPERATION_TYPE type;
     TWIN_MESSENGER_INSTANCE* msgr;
-    char* correlation_id;
+    unsigned long correlation_id;
+    LIST_ITEM_HANDLE list_item;
     union {
         struct REPORTED_PROPERTIES_TAG
         {
@@ -136,6 +151,7 @@ typedef struct TWIN_OPERATION_CONTEXT_TAG
         {
             TWIN_STATE_UPDATE_CALLBACK callback;
             const void* context;
+            TWIN_GET_WAITER* waiters; // Later on-demand GET requests sharing this response.
         } get_twin;
     } cb;
     time_t time_sent;
@@ -210,7 +226,7 @@ static int set_message_correlation_id(MESSAGE_HANDLE message, const char* value)
     return result;
 }
 
-static int get_message_correlation_id(MESSAGE_HANDLE message, char** correlation_id)
+static int get_message_correlation_id(MESSAGE_HANDLE message, bool* has_correlation_id, unsigned long* correlation_id)
 {
     int result;
 
@@ -224,32 +240,37 @@ static int get_message_correlation_id(MESSAGE_HANDLE message, char** correlation
     }
     else if (properties == NULL)
     {
-        *correlation_id = NULL;
+        *has_correlation_id = false;
         result = RESULT_OK;
     }
     else
     {
         if (properties_get_correlation_id(properties, &amqp_value) != 0 || amqp_value == NULL)
         {
-            *correlation_id = NULL;
+            *has_correlation_id = false;
             result = RESULT_OK;
         }
         else
         {
             const char* value;
+            char* value_end;
 
             if (amqpvalue_get_string(amqp_value, &value) != 0)
             {
                 LogError("Failed retrieving string from AMQP value");
                 result = __FAILURE__;
             }
-            else if (mallocAndStrcpy_s(correlation_id, value) != 0)
-            {
-                LogError("Failed cloning correlation-id");
-                result = __FAILURE__;
-            }
             else
             {
+                // Correlation-ids not in the format used by create_amqp_message_for_twin_operation() can't match any request.
+                *correlation_id = strtoul(value, &value_end, 10);
+                *has_correlation_id = (value_end != value && *value_end == '\0');
+
+                if (!*has_correlation_id)
+                {
+                    LogError("Unexpected TWIN correlation-id %s", value);
+                }
+
                 result = RESULT_OK;
             }
         }
@@ -399,17 +420,10 @@ static TWIN_OPERATION_CONTEXT* create_twin_operation_context(TWIN_MESSENGER_INST
     {
         memset(result, 0, sizeof(TWIN_OPERATION_CONTEXT));
 
-        if ((result->correlation_id = generate_unique_id()) == NULL)
-        {
-            LogError("Failed setting context correlation-id (%s, %s)", ENUM_TO_STRING(TWIN_OPERATION_TYPE, type), twin_msgr->device_id);
-            free(result);
-            result = NULL;
-        }
-        else
-        {
-            result->type = type;
-            result->msgr = twin_msgr;
-        }
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_41_002: [Each TWIN operation shall be identified by the next value of a per-messenger counter, only formatted as a string when the request message is created]
+        result->correlation_id = ++twin_msgr->next_correlation_id;
+        result->type = type;
+        result->msgr = twin_msgr;
     }
 
     return result;
@@ -418,7 +432,30 @@ static TWIN_OPERATION_CONTEXT* create_twin_operation_context(TWIN_MESSENGER_INST
 static bool find_twin_operation_by_correlation_id(LIST_ITEM_HANDLE list_item, const void* match_context)
 {
     TWIN_OPERATION_CONTEXT* twin_op_ctx = (TWIN_OPERATION_CONTEXT*)singlylinkedlist_item_get_value(list_item);
-    return (strcmp(twin_op_ctx->correlation_id, (const char*)match_context) == 0);
+    return (twin_op_ctx->correlation_id == *(const unsigned long*)match_context);
+}
+
+static TWIN_OPERATION_CONTEXT** get_twin_operation_index_slot(TWIN_MESSENGER_INSTANCE* twin_msgr, unsigned long correlation_id)
+{
+    return &twin_msgr->operations_index[correlation_id % TWIN_OPERATION_INDEX_SIZE];
+}
+
+static LIST_ITEM_HANDLE find_twin_operation(TWIN_MESSENGER_INSTANCE* twin_msgr, unsigned long correlation_id)
+{
+    LIST_ITEM_HANDLE result;
+    TWIN_OPERATION_CONTEXT* indexed_op_ctx = *get_twin_operation_index_slot(twin_msgr, correlation_id);
+
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_41_003: [The TWIN operation for an incoming message shall be looked up by correlation-id in `twin_msgr->operations_index`, searching `twin_msgr->operations` only if it is not indexed]
+    if (indexed_op_ctx != NULL && indexed_op_ctx->correlation_id == correlation_id)
+    {
+        result = indexed_op_ctx->list_item;
+    }
+    else
+    {
+        result = singlylinkedlist_find(twin_msgr->operations, find_twin_operation_by_correlation_id, (const void*)&correlation_id);
+    }
+
+    return result;
 }
 
 static bool find_twin_operation_by_type(LIST_ITEM_HANDLE list_item, const void* match_context)
@@ -429,21 +466,56 @@ static bool find_twin_operation_by_type(LIST_ITEM_HANDLE list_item, const void*
 
 static void destroy_twin_operation_context(TWIN_OPERATION_CONTEXT* op_ctx)
 {
-    free(op_ctx->correlation_id);
+    TWIN_OPERATION_CONTEXT** index_slot = get_twin_operation_index_slot(op_ctx->msgr, op_ctx->correlation_id);
+
+    if (op_ctx->type == TWIN_OPERATION_TYPE_GET_ON_DEMAND)
+    {
+        while (op_ctx->cb.get_twin.waiters != NULL)
+        {
+            TWIN_GET_WAITER* waiter = op_ctx->cb.get_twin.waiters;
+            op_ctx->cb.get_twin.waiters = waiter->next;
+            free(waiter);
+        }
+    }
+
+    if (*index_slot == op_ctx)
+    {
+        *index_slot = NULL;
+    }
+
     free(op_ctx);
 }
 
+static void complete_get_twin_operation(TWIN_OPERATION_CONTEXT* twin_op_ctx, const char* payload, size_t size)
+{
+    TWIN_GET_WAITER* waiter;
+
+    twin_op_ctx->cb.get_twin.callback(TWIN_UPDATE_TYPE_COMPLETE, payload, size, (void*)twin_op_ctx->cb.get_twin.context);
+
+    for (waiter = twin_op_ctx->cb.get_twin.waiters; waiter != NULL; waiter = waiter->next)
+    {
+        waiter->callback(TWIN_UPDATE_TYPE_COMPLETE, payload, size, (void*)waiter->context);
+    }
+}
+
 static int add_twin_operation_context_to_queue(TWIN_OPERATION_CONTEXT* twin_op_ctx)
 {
     int result;
 
-    if (singlylinkedlist_add(twin_op_ctx->msgr->operations, (const void*)twin_op_ctx) == NULL)
+    if ((twin_op_ctx->list_item = singlylinkedlist_add(twin_op_ctx->msgr->operations, (const void*)twin_op_ctx)) == NULL)
     {
-        LogError("Failed adding TWIN operation context to queue (%s, %s)", ENUM_TO_STRING(TWIN_OPERATION_TYPE, twin_op_ctx->type), twin_op_ctx->correlation_id);
+        LogError("Failed adding TWIN operation context to queue (%s, %lu)", ENUM_TO_STRING(TWIN_OPERATION_TYPE, twin_op_ctx->type), twin_op_ctx->correlation_id);
         result = __FAILURE__;
     }
     else
     {
+        TWIN_OPERATION_CONTEXT** index_slot = get_twin_operation_index_slot(twin_op_ctx->msgr, twin_op_ctx->correlation_id);
+
+        if (*index_slot == NULL)
+        {
+            *index_slot = twin_op_ctx;
+        }
+
         result = RESULT_OK;
     }
 
@@ -453,20 +525,20 @@ static int add_twin_operation_context_to_queue(TWIN_OPERATION_CONTEXT* twin_op_c
 static int remove_twin_operation_context_from_queue(TWIN_OPERATION_CONTEXT* twin_op_ctx)
 {
     int result;
-    LIST_ITEM_HANDLE list_item;
 
-    if ((list_item = singlylinkedlist_find(twin_op_ctx->msgr->operations, find_twin_operation_by_correlation_id, (const void*)twin_op_ctx->correlation_id)) == NULL)
+    if (twin_op_ctx->list_item == NULL)
     {
         result = RESULT_OK;
     }
-    else if (singlylinkedlist_remove(twin_op_ctx->msgr->operations, list_item) != 0)
+    else if (singlylinkedlist_remove(twin_op_ctx->msgr->operations, twin_op_ctx->list_item) != 0)
     {
-        LogError("Failed removing TWIN operation context from queue (%s, %s, %s)",
+        LogError("Failed removing TWIN operation context from queue (%s, %s, %lu)",
             twin_op_ctx->msgr->device_id, ENUM_TO_STRING(TWIN_OPERATION_TYPE, twin_op_ctx->type), twin_op_ctx->correlation_id);
         result = __FAILURE__;
     }
     else
     {
+        twin_op_ctx->list_item = NULL;
         result = RESULT_OK;
     }
 
@@ -477,14 +549,14 @@ static int remove_twin_operation_context_from_queue(TWIN_OPERATION_CONTEXT* twin
 //---------- TWIN <-> AMQP Translation Functions ----------//
 
 static int parse_incoming_twin_message(MESSAGE_HANDLE message,
-    char** correlation_id,
+    bool* has_correlation_id, unsigned long* correlation_id,
     bool* has_version, int64_t* version,
     bool* has_status_code, int* status_code,
     bool* has_twin_report, BINARY_DATA* twin_report)
 {
     int result;
 
-    if (get_message_correlation_id(message, correlation_id) != 0)
+    if (get_message_correlation_id(message, has_correlation_id, correlation_id) != 0)
     {
         LogError("Failed retrieving correlation ID from received TWIN message.");
         result = __FAILURE__;
@@ -638,12 +710,6 @@ static int parse_incoming_twin_message(MESSAGE_HANDLE message,
                 }
             }
         }
-
-        if (result != RESULT_OK)
-        {
-            free(*correlation_id);
-            *correlation_id = NULL;
-        }
     }
 
     return result;
@@ -728,10 +794,11 @@ static const char* get_twin_operation_name(TWIN_OPERATION_TYPE op_type)
     return result;
 }
 
-static MESSAGE_HANDLE create_amqp_message_for_twin_operation(TWIN_OPERATION_TYPE op_type, char* correlation_id, CONSTBUFFER_HANDLE data)
+static MESSAGE_HANDLE create_amqp_message_for_twin_operation(TWIN_OPERATION_TYPE op_type, unsigned long correlation_id, CONSTBUFFER_HANDLE data)
 {
     MESSAGE_HANDLE result;
     const char* twin_op_name;
+    char correlation_id_string[TWIN_OPERATION_CORRELATION_ID_BUFFER_SIZE];
 
     if ((twin_op_name = get_twin_operation_name(op_type))== NULL)
     {
@@ -789,8 +856,9 @@ static MESSAGE_HANDLE create_amqp_message_for_twin_operation(TWIN_OPERATION_TYPE
                 message_destroy(result);
                 result = NULL;
             }
-            // Codes_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_068: [The `correlation-id` property of `amqp_message` shall be set with an UUID string]
-            else if (set_message_correlation_id(result, correlation_id) != RESULT_OK)
+            // Codes_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_068: [The `correlation-id` property of `amqp_message` shall be set with the correlation-id of the TWIN operation, as a decimal string]
+            else if (snprintf(correlation_id_string, sizeof(correlation_id_string), TWIN_OPERATION_CORRELATION_ID_FORMAT, correlation_id) <= 0 ||
+                set_message_correlation_id(result, correlation_id_string) != RESULT_OK)
             {
                 // Codes_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_069: [If setting `correlation-id` fails, message_create_for_twin_operation shall fail and return NULL]
                 LogError("Failed AMQP message correlation-id (%s)", twin_op_name);
@@ -920,13 +988,13 @@ static void on_amqp_send_complete_callback(AMQP_MESSENGER_SEND_RESULT result, AM
             {
                 if (twin_op_ctx->cb.get_twin.callback != NULL)
                 {
-                    twin_op_ctx->cb.get_twin.callback(TWIN_UPDATE_TYPE_COMPLETE, NULL, 0, (void*)twin_op_ctx->cb.get_twin.context);
+                    complete_get_twin_operation(twin_op_ctx, NULL, 0);
                 }
             }
             else if (reason != AMQP_MESSENGER_REASON_MESSENGER_DESTROYED)
             {
                 // Codes_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_096: [If operation is a GET/PUT/DELETE, if a failure occurs the TWIN messenger shall attempt to subscribe/unsubscribe again]
-                LogError("Failed sending TWIN operation request (%s, %s, %s, %s, %s)",
+                LogError("Failed sending TWIN operation request (%s, %s, %lu, %s, %s)",
                     twin_op_ctx->msgr->device_id,
                     ENUM_TO_STRING(TWIN_OPERATION_TYPE, twin_op_ctx->type),
                     twin_op_ctx->correlation_id,
@@ -966,19 +1034,19 @@ static int send_twin_operation_request(TWIN_MESSENGER_INSTANCE* twin_msgr, TWIN_
 
     if ((amqp_message = create_amqp_message_for_twin_operation(op_ctx->type, op_ctx->correlation_id, data)) == NULL)
     {
-        LogError("Failed creating request message (%s, %s, %s)", twin_msgr->device_id, ENUM_TO_STRING(TWIN_OPERATION_TYPE, op_ctx->type), op_ctx->correlation_id);
+        LogError("Failed creating request message (%s, %s, %lu)", twin_msgr->device_id, ENUM_TO_STRING(TWIN_OPERATION_TYPE, op_ctx->type), op_ctx->correlation_id);
         result = __FAILURE__;
     }
     else
     {
         if ((op_ctx->time_sent = get_time(NULL)) == INDEFINITE_TIME)
         {
-            LogError("Failed setting TWIN operation sent time (%s, %s, %s)", twin_msgr->device_id, ENUM_TO_STRING(TWIN_OPERATION_TYPE, op_ctx->type), op_ctx->correlation_id);
+            LogError("Failed setting TWIN operation sent time (%s, %s, %lu)", twin_msgr->device_id, ENUM_TO_STRING(TWIN_OPERATION_TYPE, op_ctx->type), op_ctx->correlation_id);
             result = __FAILURE__;
         }
         else if (amqp_messenger_send_async(twin_msgr->amqp_msgr, amqp_message, on_amqp_send_complete_callback, (void*)op_ctx) != 0)
         {
-            LogError("Failed sending request message for (%s, %s, %s)", twin_msgr->device_id, ENUM_TO_STRING(TWIN_OPERATION_TYPE, op_ctx->type), op_ctx->correlation_id);
+            LogError("Failed sending request message for (%s, %s, %lu)", twin_msgr->device_id, ENUM_TO_STRING(TWIN_OPERATION_TYPE, op_ctx->type), op_ctx->correlation_id);
             result = __FAILURE__;
         }
         else
@@ -1056,7 +1124,7 @@ static bool remove_expired_twin_operation_request(const void* item, const void*
         }
         else
         {
-            LogError("Twin operation timed out (%s, %s, %s)", twin_msgr->device_id, ENUM_TO_STRING(TWIN_OPERATION_TYPE, twin_op_ctx->type), twin_op_ctx->correlation_id);
+            LogError("Twin operation timed out (%s, %s, %lu)", twin_msgr->device_id, ENUM_TO_STRING(TWIN_OPERATION_TYPE, twin_op_ctx->type), twin_op_ctx->correlation_id);
             result = true;
             *continue_processing = true;
 
@@ -1094,7 +1162,7 @@ static bool remove_expired_twin_operation_request(const void* item, const void*
             }
             else if (twin_op_ctx->type == TWIN_OPERATION_TYPE_GET_ON_DEMAND)
             {
-                twin_op_ctx->cb.get_twin.callback(TWIN_UPDATE_TYPE_COMPLETE, NULL, 0, twin_op_ctx->cb.get_twin.context);
+                complete_get_twin_operation(twin_op_ctx, NULL, 0);
             }
 
             destroy_twin_operation_context(twin_op_ctx);
@@ -1386,7 +1454,8 @@ static AMQP_MESSENGER_DISPOSITION_RESULT on_amqp_message_received_callback(MESSA
     {
         TWIN_MESSENGER_INSTANCE* twin_msgr = (TWIN_MESSENGER_INSTANCE*)context;
 
-        char* correlation_id;
+        bool has_correlation_id;
+        unsigned long correlation_id;
 
         bool has_status_code;
         int status_code;
@@ -1400,20 +1469,20 @@ static AMQP_MESSENGER_DISPOSITION_RESULT on_amqp_message_received_callback(MESSA
         amqp_messenger_destroy_disposition_info(disposition_info);
         disposition_result = AMQP_MESSENGER_DISPOSITION_RESULT_ACCEPTED;
 
-        if (parse_incoming_twin_message(message, &correlation_id, &has_version, &version, &has_status_code, &status_code, &has_twin_report, &twin_report) != 0)
+        if (parse_incoming_twin_message(message, &has_correlation_id, &correlation_id, &has_version, &version, &has_status_code, &status_code, &has_twin_report, &twin_report) != 0)
         {
             LogError("Failed parsing incoming TWIN message (%s)", twin_msgr->device_id);
         }
         else
         {
-            if (correlation_id != NULL)
+            if (has_correlation_id)
             {
                 // It is supposed to be a request sent previously (reported properties PATCH, GET, PUT or DELETE).
 
                 LIST_ITEM_HANDLE list_item;
-                if ((list_item = singlylinkedlist_find(twin_msgr->operations, find_twin_operation_by_correlation_id, (const void*)correlation_id)) == NULL)
+                if ((list_item = find_twin_operation(twin_msgr, correlation_id)) == NULL)
                 {
-                    LogError("Could not find context of TWIN incoming message (%s, %s)", twin_msgr->device_id, correlation_id);
+                    LogError("Could not find context of TWIN incoming message (%s, %lu)", twin_msgr->device_id, correlation_id);
                 }
                 else
                 {
@@ -1421,7 +1490,7 @@ static AMQP_MESSENGER_DISPOSITION_RESULT on_amqp_message_received_callback(MESSA
 
                     if ((twin_op_ctx = (TWIN_OPERATION_CONTEXT*)singlylinkedlist_item_get_value(list_item)) == NULL)
                     {
-                        LogError("Could not get context for incoming TWIN message (%s, %s)", twin_msgr->device_id, correlation_id);
+                        LogError("Could not get context for incoming TWIN message (%s, %lu)", twin_msgr->device_id, correlation_id);
                     }
                     else
                     {
@@ -1430,7 +1499,7 @@ static AMQP_MESSENGER_DISPOSITION_RESULT on_amqp_message_received_callback(MESSA
                             if (!has_status_code)
                             {
                                 // Codes_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_086: [If `message` is a failed response for a PATCH request, the `on_report_state_complete_callback` shall be invoked if provided passing RESULT_ERROR and the status_code zero]
-                                LogError("Received an incoming TWIN message for a PATCH operation, but with no status code (%s, %s)", twin_msgr->device_id, correlation_id);
+                                LogError("Received an incoming TWIN message for a PATCH operation, but with no status code (%s, %lu)", twin_msgr->device_id, correlation_id);
 
                                 disposition_result = AMQP_MESSENGER_DISPOSITION_RESULT_REJECTED;
 
@@ -1453,7 +1522,7 @@ static AMQP_MESSENGER_DISPOSITION_RESULT on_amqp_message_received_callback(MESSA
                             if (!has_twin_report)
                             {
                                 // Codes_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_089: [If `message` is a failed response for a GET request, the TWIN messenger shall attempt to send another GET request]
-                                LogError("Received an incoming TWIN message for a GET operation, but with no report (%s, %s)", twin_msgr->device_id, correlation_id);
+                                LogError("Received an incoming TWIN message for a GET operation, but with no report (%s, %lu)", twin_msgr->device_id, correlation_id);
 
                                 disposition_result = AMQP_MESSENGER_DISPOSITION_RESULT_REJECTED;
 
@@ -1488,15 +1557,15 @@ static AMQP_MESSENGER_DISPOSITION_RESULT on_amqp_message_received_callback(MESSA
                         {
                             if (!has_twin_report)
                             {
-                                LogError("Received an incoming TWIN message for a GET operation, but with no report (%s, %s)", twin_msgr->device_id, correlation_id);
+                                LogError("Received an incoming TWIN message for a GET operation, but with no report (%s, %lu)", twin_msgr->device_id, correlation_id);
 
                                 disposition_result = AMQP_MESSENGER_DISPOSITION_RESULT_REJECTED;
 
-                                twin_op_ctx->cb.get_twin.callback(TWIN_UPDATE_TYPE_COMPLETE, NULL, 0, twin_op_ctx->cb.get_twin.context);
+                                complete_get_twin_operation(twin_op_ctx, NULL, 0);
                             }
                             else
                             {
-                                twin_op_ctx->cb.get_twin.callback(TWIN_UPDATE_TYPE_COMPLETE, (const char*)twin_report.bytes, twin_report.length, twin_op_ctx->cb.get_twin.context);
+                                complete_get_twin_operation(twin_op_ctx, (const char*)twin_report.bytes, twin_report.length);
                             }
                         }
                         else if (twin_op_ctx->type == TWIN_OPERATION_TYPE_PUT)
@@ -1507,13 +1576,13 @@ static AMQP_MESSENGER_DISPOSITION_RESULT on_amqp_message_received_callback(MESSA
 
                                 if (!has_status_code)
                                 {
-                                    LogError("Received an incoming TWIN message for a PUT operation, but with no status code (%s, %s)", twin_msgr->device_id, correlation_id);
+                                    LogError("Received an incoming TWIN message for a PUT operation, but with no status code (%s, %lu)", twin_msgr->device_id, correlation_id);
 
                                     subscription_succeeded = false;
                                 }
                                 else if (status_code < 200 || status_code >= 300)
                                 {
-                                    LogError("Received status code %d for TWIN subscription request (%s, %s)", status_code, twin_msgr->device_id, correlation_id);
+                                    LogError("Received status code %d for TWIN subscription request (%s, %lu)", status_code, twin_msgr->device_id, correlation_id);
 
                                     subscription_succeeded = false;
                                 }
@@ -1542,13 +1611,13 @@ static AMQP_MESSENGER_DISPOSITION_RESULT on_amqp_message_received_callback(MESSA
 
                                 if (!has_status_code)
                                 {
-                                    LogError("Received an incoming TWIN message for a DELETE operation, but with no status code (%s, %s)", twin_msgr->device_id, correlation_id);
+                                    LogError("Received an incoming TWIN message for a DELETE operation, but with no status code (%s, %lu)", twin_msgr->device_id, correlation_id);
 
                                     unsubscription_succeeded = false;
                                 }
                                 else if (status_code < 200 || status_code >= 300)
                                 {
-                                    LogError("Received status code %d for TWIN unsubscription request (%s, %s)", status_code, twin_msgr->device_id, correlation_id);
+                                    LogError("Received status code %d for TWIN unsubscription request (%s, %lu)", status_code, twin_msgr->device_id, correlation_id);
 
                                     unsubscription_succeeded = false;
                                 }
@@ -1577,14 +1646,12 @@ static AMQP_MESSENGER_DISPOSITION_RESULT on_amqp_message_received_callback(MESSA
                     if (singlylinkedlist_remove(twin_msgr->operations, list_item) != 0)
                     {
                         // Codes_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_093: [The corresponding TWIN request failed to be removed from `twin_msgr->operations`, `twin_msgr->state` shall be set to TWIN_MESSENGER_STATE_ERROR and informed to the user]
-                        LogError("Failed removing context for incoming TWIN message (%s, %s)",
+                        LogError("Failed removing context for incoming TWIN message (%s, %lu)",
                             twin_msgr->device_id, correlation_id);
 
                         update_state(twin_msgr, TWIN_MESSENGER_STATE_ERROR);
                     }
                 }
-
-                free(correlation_id);
             }
             else if (has_twin_report)
             {
@@ -1914,9 +1981,42 @@ int twin_messenger_get_twin_async(TWIN_MESSENGER_HANDLE twin_msgr_handle, TWIN_S
     else
     {
         TWIN_MESSENGER_INSTANCE* twin_msgr = (TWIN_MESSENGER_INSTANCE*)twin_msgr_handle;
+        TWIN_OPERATION_TYPE twin_op_type = TWIN_OPERATION_TYPE_GET_ON_DEMAND;
         TWIN_OPERATION_CONTEXT* twin_op_ctx;
+        LIST_ITEM_HANDLE list_item;
+
+        if ((list_item = singlylinkedlist_find(twin_msgr->operations, find_twin_operation_by_type, &twin_op_type)) != NULL)
+        {
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_41_001: [ If an on-demand GET request is already waiting for its response, the request shall share that response instead of sending its own ]
+            TWIN_GET_WAITER* waiter;
+
+            if ((waiter = (TWIN_GET_WAITER*)malloc(sizeof(TWIN_GET_WAITER))) == NULL)
+            {
+                LogError("Failed creating a waiter for TWIN request (%s, TWIN_OPERATION_TYPE_GET_ON_DEMAND)", twin_msgr->device_id);
+                // Codes_SRS_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_113: [If any failures occurr, twin_messenger_get_twin_async() shall return a non-zero value ]
+                result = __FAILURE__;
+            }
+            else
+            {
+                TWIN_GET_WAITER** last;
+
+                twin_op_ctx = (TWIN_OPERATION_CONTEXT*)singlylinkedlist_item_get_value(list_item);
+                last = &twin_op_ctx->cb.get_twin.waiters;
+
+                while (*last != NULL)
+                {
+                    last = &(*last)->next;
+                }
 
-        if ((twin_op_ctx = create_twin_operation_context(twin_msgr, TWIN_OPERATION_TYPE_GET_ON_DEMAND)) == NULL)
+                waiter->callback = on_get_twin_completed_callback;
+                waiter->context = context;
+                waiter->next = NULL;
+                *last = waiter;
+
+                result = RESULT_OK;
+            }
+        }
+        else if ((twin_op_ctx = create_twin_operation_context(twin_msgr, TWIN_OPERATION_TYPE_GET_ON_DEMAND)) == NULL)
         {
             LogError("Failed creating a context for TWIN request (%s, TWIN_OPERATION_TYPE_GET_ON_DEMAND)", twin_msgr->device_id);
             // Codes_SRS_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_113: [If any failures occurr, twin_messenger_get_twin_async() shall return a non-zero value ]  
@@ -2,6 +2,7 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <ctype.h>
 
 #include "azure_c_shared_utility/optimize_size.h"
@@ -16,12 +17,15 @@
 #include "azure_c_shared_utility/tickcounter.h"
 #include "azure_c_shared_utility/tlsio.h"
 #include "azure_c_shared_utility/platform.h"
-#include "azure_c_shared_utility/string_tokenizer.h"
 #include "azure_c_shared_utility/shared_util_options.h"
 #include "azure_c_shared_utility/urlencode.h"
 
 #include "internal/iothub_client_private.h"
+#include "internal/iothub_client_memory_private.h"
 #include "internal/iothub_client_retry_control.h"
+#include "internal/iothub_client_trace_ring_private.h"
+#include "internal/iothub_client_startup_timeline_private.h"
+#include "internal/iothub_client_connect_admission_private.h"
 #include "internal/iothub_transport_ll_private.h"
 #include "internal/iothubtransport_mqtt_common.h"
 #include "internal/iothubtransport.h"
@@ -53,8 +57,10 @@
 #define DEFAULT_RETRY_POLICY                IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_JITTER
 #define DEFAULT_RETRY_TIMEOUT_IN_SECONDS    0
 #define MAX_DISCONNECT_VALUE                50
+#define THROTTLED_RETRY_AFTER_IN_SECONDS    10 // CONNACK "server unavailable" is how the hub reports throttling
 
 #define ON_DEMAND_GET_TWIN_REQUEST_TIMEOUT_SECS    60
+#define KEEP_ALIVE_PROBE_INTERVALS          3 // keepalive intervals a connection has to survive for its interval to be kept
 
 static const char TOPIC_DEVICE_TWIN_PREFIX[] = "$iothub/twin";
 static const char TOPIC_DEVICE_METHOD_PREFIX[] = "$iothub/methods";
@@ -101,6 +107,9 @@ static const char* DIAGNOSTIC_CONTEXT_CREATION_TIME_UTC_PROPERTY = "creationtime
 #define SUBSCRIBE_INPUT_QUEUE_TOPIC             0x0010
 #define SUBSCRIBE_TOPIC_COUNT                   5
 
+#define TELEMETRY_ACK_INDEX_INITIAL_SIZE        16
+#define TOPIC_VALUE_BUFFER_SIZE                 128
+
 DEFINE_ENUM_STRINGS(MQTT_CLIENT_EVENT_ERROR, MQTT_CLIENT_EVENT_ERROR_VALUES)
 
 typedef struct SYSTEM_PROPERTY_INFO_TAG
@@ -109,6 +118,14 @@ typedef struct SYSTEM_PROPERTY_INFO_TAG
     size_t propLength;
 } SYSTEM_PROPERTY_INFO;
 
+typedef struct TOPIC_SLICE_TAG
+{
+    const char* value;
+    size_t length;
+} TOPIC_SLICE;
+
+typedef IOTHUB_MESSAGE_RESULT(*MESSAGE_PROPERTY_SETTER)(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle, const char* value);
+
 static SYSTEM_PROPERTY_INFO sysPropList[] = {
     { "%24.exp", 7 },
     { "%24.mid", 7 },
@@ -125,7 +142,8 @@ static SYSTEM_PROPERTY_INFO sysPropList[] = {
     { "%24.cmid", 8 }
 };
 
-static const int slashes_to_reach_input_name = 5;
+// Segments after the "devices/<deviceId>/modules/<moduleId>/" prefix of the input queue topic up to the input name ("inputs", then the name).
+static const int segments_to_reach_input_name = 2;
 
 typedef enum DEVICE_TWIN_MSG_TYPE_TAG
 {
@@ -150,6 +168,12 @@ typedef enum MQTT_CLIENT_STATUS_TAG
     MQTT_CLIENT_STATUS_EXECUTE_DISCONNECT
 } MQTT_CLIENT_STATUS;
 
+typedef struct ENCODED_VALUE_CACHE_TAG
+{
+    char* value;
+    STRING_HANDLE encoded_value;
+} ENCODED_VALUE_CACHE;
+
 typedef struct MQTTTRANSPORT_HANDLE_DATA_TAG
 {
     // Topic control
@@ -162,6 +186,7 @@ typedef struct MQTTTRANSPORT_HANDLE_DATA_TAG
     STRING_HANDLE topic_DeviceMethods;
 
     uint32_t topics_ToSubscribe;
+    uint32_t topics_Subscribed; /*topics the broker holds in the current MQTT session*/
 
     // Connection related constants
     STRING_HANDLE hostAddress;
@@ -194,10 +219,16 @@ typedef struct MQTTTRANSPORT_HANDLE_DATA_TAG
     MQTT_CLIENT_STATUS mqttClientStatus;
     bool isDestroyCalled;
     bool isRetryExpiredCallbackSet;
+    bool isWaitingConnectAdmission; /*the retry policy allowed the connection, which waits for a token of the connect admission control*/
     bool device_twin_get_sent;
     bool twin_resp_sub_recv;
     bool isRecoverableError;
     uint16_t keepAliveValue;
+    uint16_t keep_alive_adaptive_max; /*OPTION_MQTT_ADAPTIVE_KEEP_ALIVE_MAX, 0 keeps keepAliveValue as it is*/
+    uint16_t keep_alive_good; /*largest keepalive a connection survived, or the one set with OPTION_KEEP_ALIVE*/
+    uint16_t keep_alive_ceiling; /*smallest keepalive a connection silently dropped with, 0 while none did*/
+    uint16_t keep_alive_next; /*keepalive for the next connect, 0 keeps keepAliveValue*/
+    bool keep_alive_confirmed; /*the connection survived KEEP_ALIVE_PROBE_INTERVALS with keepAliveValue*/
     uint16_t connect_timeout_in_sec;
     tickcounter_ms_t mqtt_connect_time;
     size_t connectFailCount;
@@ -206,6 +237,7 @@ typedef struct MQTTTRANSPORT_HANDLE_DATA_TAG
     bool raw_trace;
     TICK_COUNTER_HANDLE msgTickCounter;
     OPTIONHANDLER_HANDLE saved_tls_options; // Here are the options from the xio layer if any is saved.
+    bool saved_tls_options_current;         // No option was passed down to the xio layer since saved_tls_options was taken.
 
     // Internal lists for message tracking
     PDLIST_ENTRY waitingToSend;
@@ -218,8 +250,32 @@ typedef struct MQTTTRANSPORT_HANDLE_DATA_TAG
 
     // Telemetry specific
     DLIST_ENTRY telemetry_waitingForAck;
+    size_t telemetry_inflight_count; /*entries in telemetry_waitingForAck*/
+    IOTHUB_CLIENT_MEMORY_COUNTERS memory_counters; /*telemetry_waitingForAck, summed by IoTHubClient_Memory_GetUsage*/
+    // Open addressing index from packet id to the telemetry_waitingForAck entry, used to match PUBACKs
+    struct MQTT_MESSAGE_DETAILS_LIST_TAG** telemetry_ack_index;
+    size_t telemetry_ack_index_size; /*power of 2*/
+    struct MQTT_MESSAGE_DETAILS_LIST_TAG* telemetry_ack_index_inline[TELEMETRY_ACK_INDEX_INITIAL_SIZE];
+    size_t max_inflight; /*OPTION_MQTT_MAX_INFLIGHT, 0 is unbounded*/
+    bool persistent_session; /*OPTION_MQTT_PERSISTENT_SESSION*/
+    char* at_most_once_output; /*OPTION_MQTT_AT_MOST_ONCE_OUTPUT, NULL publishes all telemetry at least once*/
+    tickcounter_ms_t subscribe_coalesce_window; /*OPTION_MQTT_SUBSCRIBE_COALESCE_WINDOW, 0 subscribes on the next DoWork*/
+    tickcounter_ms_t subscribe_window_start; /*when the topics waiting in topics_ToSubscribe were first seen*/
+    bool subscribe_window_started;
+    bool tls_session_resumption; /*OPTION_TLS_SESSION_RESUMPTION*/
+    bool telemetry_resend_pending; /*resend telemetry_waitingForAck as soon as publishing resumes*/
     bool auto_url_encode_decode;
 
+    // Telemetry topic scratch, rebuilt in place for every publish
+    STRING_HANDLE telemetry_topic;
+    // Url encoded values from the last publish, reused while the next message repeats them
+    STRING_HANDLE encoded_user_properties;
+    char* user_properties; /*keys and values encoded_user_properties was built from, each NULL terminated*/
+    size_t user_properties_count;
+    IOTHUB_MESSAGE_PROPERTY_SET_HANDLE user_properties_set; /*the property set encoded_user_properties was built from, NULL if none*/
+    ENCODED_VALUE_CACHE content_type_cache;
+    ENCODED_VALUE_CACHE content_encoding_cache;
+
     // Controls frequency of reconnection logic.
     RETRY_CONTROL_HANDLE retry_control_handle;
 
@@ -238,6 +294,13 @@ typedef struct MQTTTRANSPORT_HANDLE_DATA_TAG
     int disconnect_recv_flag;
 } MQTTTRANSPORT_HANDLE_DATA, *PMQTTTRANSPORT_HANDLE_DATA;
 
+typedef struct MQTT_DEVICE_TWIN_WAITER_TAG
+{
+    IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK userCallback;
+    void* userContext;
+    struct MQTT_DEVICE_TWIN_WAITER_TAG* next;
+} MQTT_DEVICE_TWIN_WAITER;
+
 typedef struct MQTT_DEVICE_TWIN_ITEM_TAG
 {
     tickcounter_ms_t msgEnqueueTime;
@@ -251,6 +314,7 @@ typedef struct MQTT_DEVICE_TWIN_ITEM_TAG
     DLIST_ENTRY entry;
     IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK userCallback;
     void* userContext;
+    MQTT_DEVICE_TWIN_WAITER* waiters; /*later on-demand GET requests sharing this response*/
 } MQTT_DEVICE_TWIN_ITEM;
 
 typedef struct MQTT_MESSAGE_DETAILS_LIST_TAG
@@ -298,6 +362,54 @@ static void set_saved_tls_options(PMQTTTRANSPORT_HANDLE_DATA transport, OPTIONHA
     transport->saved_tls_options = new_options;
 }
 
+/* Taking the options clones every certificate and key of the xio, so the snapshot is kept across reconnects and only taken again once an option was passed down since,
+   or every time with tls_session_resumption, the TLS session of the last connection being part of the options */
+static void save_tls_options(PMQTTTRANSPORT_HANDLE_DATA transport)
+{
+    if (transport->saved_tls_options == NULL || !transport->saved_tls_options_current || transport->tls_session_resumption)
+    {
+        set_saved_tls_options(transport, xio_retrieveoptions(transport->xioTransport));
+        transport->saved_tls_options_current = (transport->saved_tls_options != NULL);
+    }
+}
+
+static void free_encoded_value_cache(ENCODED_VALUE_CACHE* cache)
+{
+    if (cache->value != NULL)
+    {
+        free(cache->value);
+        STRING_delete(cache->encoded_value);
+        cache->value = NULL;
+        cache->encoded_value = NULL;
+    }
+}
+
+static void free_telemetry_topic_cache(MQTTTRANSPORT_HANDLE_DATA* transport_data)
+{
+    if (transport_data->telemetry_topic != NULL)
+    {
+        STRING_delete(transport_data->telemetry_topic);
+        transport_data->telemetry_topic = NULL;
+    }
+    if (transport_data->encoded_user_properties != NULL)
+    {
+        STRING_delete(transport_data->encoded_user_properties);
+        transport_data->encoded_user_properties = NULL;
+    }
+    if (transport_data->user_properties != NULL)
+    {
+        free(transport_data->user_properties);
+        transport_data->user_properties = NULL;
+    }
+    if (transport_data->user_properties_set != NULL)
+    {
+        IoTHubMessagePropertySet_Destroy(transport_data->user_properties_set);
+        transport_data->user_properties_set = NULL;
+    }
+    free_encoded_value_cache(&transport_data->content_type_cache);
+    free_encoded_value_cache(&transport_data->content_encoding_cache);
+}
+
 static void free_transport_handle_data(MQTTTRANSPORT_HANDLE_DATA* transport_data)
 {
     if (transport_data->mqttClient != NULL)
@@ -328,6 +440,15 @@ static void free_transport_handle_data(MQTTTRANSPORT_HANDLE_DATA* transport_data
     STRING_delete(transport_data->topic_DeviceMethods);
     STRING_delete(transport_data->topic_InputQueue);
 
+    free_telemetry_topic_cache(transport_data);
+    free(transport_data->at_most_once_output);
+
+    if ((transport_data->telemetry_ack_index != NULL) && (transport_data->telemetry_ack_index != transport_data->telemetry_ack_index_inline))
+    {
+        free(transport_data->telemetry_ack_index);
+    }
+
+    IOTHUB_CLIENT_MEMORY_UNREGISTER(&transport_data->memory_counters);
     free(transport_data);
 }
 
@@ -405,128 +526,157 @@ static const char* retrieve_mqtt_return_codes(CONNECT_RETURN_CODE rtn_code)
 }
 #endif // NO_LOGGING
 
-static int retrieve_device_method_rid_info(const char* resp_topic, STRING_HANDLE method_name, STRING_HANDLE request_id)
+// Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_41_008: [ Inbound topics shall be parsed in place as slices of the topic name, allocating only for the values that are kept. ]
+static bool get_next_topic_slice(const char** cursor, const char* delimiters, TOPIC_SLICE* slice)
 {
-    int result;
-    STRING_TOKENIZER_HANDLE token_handle = STRING_TOKENIZER_create_from_char(resp_topic);
-    if (token_handle == NULL)
+    bool result;
+    const char* position = *cursor;
+
+    // Empty segments are skipped, the same way STRING_TOKENIZER does.
+    while (*position != '\0' && strchr(delimiters, *position) != NULL)
     {
-        LogError("Failed creating token from device twin topic.");
-        result = __FAILURE__;
+        position++;
+    }
+
+    if (*position == '\0')
+    {
+        result = false;
     }
     else
     {
-        STRING_HANDLE token_value;
-        if ((token_value = STRING_new()) == NULL)
+        slice->value = position;
+        while (*position != '\0' && strchr(delimiters, *position) == NULL)
         {
-            LogError("Failed allocating new string .");
-            result = __FAILURE__;
+            position++;
         }
-        else
+        slice->length = (size_t)(position - slice->value);
+        result = true;
+    }
+
+    *cursor = position;
+    return result;
+}
+
+static bool topic_slice_equals(const TOPIC_SLICE* slice, const char* value)
+{
+    size_t value_length = strlen(value);
+    return (slice->length == value_length) && (memcmp(slice->value, value, value_length) == 0);
+}
+
+static bool topic_slice_starts_with(const TOPIC_SLICE* slice, const char* prefix)
+{
+    size_t prefix_length = strlen(prefix);
+    return (slice->length >= prefix_length) && (memcmp(slice->value, prefix, prefix_length) == 0);
+}
+
+static bool topic_slice_ends_with(const TOPIC_SLICE* slice, const char* suffix)
+{
+    size_t suffix_length = strlen(suffix);
+    return (slice->length > suffix_length) && (memcmp(slice->value + slice->length - suffix_length, suffix, suffix_length) == 0);
+}
+
+static size_t topic_slice_to_number(const TOPIC_SLICE* slice)
+{
+    size_t result = 0;
+    size_t index;
+    for (index = 0; index < slice->length && slice->value[index] >= '0' && slice->value[index] <= '9'; index++)
+    {
+        result = (result * 10) + (size_t)(slice->value[index] - '0');
+    }
+    return result;
+}
+
+// Returns a NULL terminated copy of the slice, in buffer when it fits and on the heap otherwise.
+static char* copy_topic_slice(const TOPIC_SLICE* slice, char* buffer, size_t buffer_size)
+{
+    char* result;
+    if (slice->length < buffer_size)
+    {
+        result = buffer;
+    }
+    else if ((result = (char*)malloc(slice->length + 1)) == NULL)
+    {
+        LogError("Failed allocating copy of topic value");
+    }
+
+    if (result != NULL)
+    {
+        (void)memcpy(result, slice->value, slice->length);
+        result[slice->length] = '\0';
+    }
+    return result;
+}
+
+static void free_topic_slice_copy(char* copy, char* buffer)
+{
+    if (copy != buffer)
+    {
+        free(copy);
+    }
+}
+
+static int retrieve_device_method_rid_info(const char* resp_topic, TOPIC_SLICE* method_name, TOPIC_SLICE* request_id)
+{
+    int result = __FAILURE__;
+    const char* cursor = resp_topic;
+    size_t token_index = 0;
+    TOPIC_SLICE token;
+
+    while (get_next_topic_slice(&cursor, "/", &token))
+    {
+        if (token_index == 3)
         {
-            size_t token_index = 0;
-            size_t request_id_length = strlen(REQUEST_ID_PROPERTY);
-            result = __FAILURE__;
-            while (STRING_TOKENIZER_get_next_token(token_handle, token_value, "/") == 0)
+            *method_name = token;
+        }
+        else if (token_index == 4)
+        {
+            if (topic_slice_starts_with(&token, REQUEST_ID_PROPERTY))
             {
-                if (token_index == 3)
-                {
-                    if (STRING_concat_with_STRING(method_name, token_value) != 0)
-                    {
-                        LogError("Failed STRING_concat_with_STRING.");
-                        result = __FAILURE__;
-                        break;
-                    }
-                }
-                else if (token_index == 4)
-                {
-                    if (STRING_length(token_value) >= request_id_length)
-                    {
-                        const char* request_id_value = STRING_c_str(token_value);
-                        if (memcmp(request_id_value, REQUEST_ID_PROPERTY, request_id_length) == 0)
-                        {
-                            if (STRING_concat(request_id, request_id_value + request_id_length) != 0)
-                            {
-                                LogError("Failed STRING_concat failed.");
-                                result = __FAILURE__;
-                            }
-                            else
-                            {
-                                result = 0;
-                            }
-                            break;
-                        }
-                    }
-                }
-                token_index++;
+                size_t request_id_length = strlen(REQUEST_ID_PROPERTY);
+                request_id->value = token.value + request_id_length;
+                request_id->length = token.length - request_id_length;
+                result = 0;
+                break;
             }
-            STRING_delete(token_value);
         }
-        STRING_TOKENIZER_destroy(token_handle);
+        token_index++;
     }
     return result;
 }
 
 static int parse_device_twin_topic_info(const char* resp_topic, bool* patch_msg, size_t* request_id, int* status_code)
 {
-    int result;
-    STRING_TOKENIZER_HANDLE token_handle = STRING_TOKENIZER_create_from_char(resp_topic);
-    if (token_handle == NULL)
-    {
-        LogError("Failed creating token from device twin topic.");
-        result = __FAILURE__;
-        *status_code = 0;
-        *request_id = 0;
-        *patch_msg = false;
-    }
-    else
+    int result = __FAILURE__;
+    const char* cursor = resp_topic;
+    size_t token_count = 0;
+    TOPIC_SLICE token;
+
+    *status_code = 0;
+    *request_id = 0;
+    *patch_msg = false;
+
+    while (get_next_topic_slice(&cursor, "/", &token))
     {
-        STRING_HANDLE token_value;
-        if ((token_value = STRING_new()) == NULL)
+        if (token_count == 2)
         {
-            LogError("Failed allocating new string .");
-            result = __FAILURE__;
-            *status_code = 0;
-            *request_id = 0;
-            *patch_msg = false;
+            if (topic_slice_equals(&token, "PATCH"))
+            {
+                *patch_msg = true;
+                result = 0;
+                break;
+            }
         }
-        else
+        else if (token_count == 3)
         {
-            result = __FAILURE__;
-            size_t token_count = 0;
-            while (STRING_TOKENIZER_get_next_token(token_handle, token_value, "/") == 0)
+            *status_code = (int)topic_slice_to_number(&token);
+            if (get_next_topic_slice(&cursor, "/?$rid=", &token))
             {
-                if (token_count == 2)
-                {
-                    if (strcmp(STRING_c_str(token_value), "PATCH") == 0)
-                    {
-                        *patch_msg = true;
-                        *status_code = 0;
-                        *request_id = 0;
-                        result = 0;
-                        break;
-                    }
-                    else
-                    {
-                        *patch_msg = false;
-                    }
-                }
-                else if (token_count == 3)
-                {
-                    *status_code = (int)atol(STRING_c_str(token_value));
-                    if (STRING_TOKENIZER_get_next_token(token_handle, token_value, "/?$rid=") == 0)
-                    {
-                        *request_id = (size_t)atol(STRING_c_str(token_value));
-                    }
-                    *patch_msg = false;
-                    result = 0;
-                    break;
-                }
-                token_count++;
+                *request_id = topic_slice_to_number(&token);
             }
-            STRING_delete(token_value);
+            result = 0;
+            break;
         }
-        STRING_TOKENIZER_destroy(token_handle);
+        token_count++;
     }
     return result;
 }
@@ -557,9 +707,10 @@ static int InternStrnicmp(const char* s1, const char* s2, size_t n)
     return result;
 }
 
-static IOTHUB_IDENTITY_TYPE retrieve_topic_type(const char* topic_resp, const char* input_queue)
+static IOTHUB_IDENTITY_TYPE retrieve_topic_type(const char* topic_resp, const char* input_queue, size_t* input_queue_prefix_length)
 {
     IOTHUB_IDENTITY_TYPE type;
+    *input_queue_prefix_length = 0;
     if (InternStrnicmp(topic_resp, TOPIC_DEVICE_TWIN_PREFIX, sizeof(TOPIC_DEVICE_TWIN_PREFIX) - 1) == 0)
     {
         type = IOTHUB_TYPE_DEVICE_TWIN;
@@ -572,6 +723,7 @@ static IOTHUB_IDENTITY_TYPE retrieve_topic_type(const char* topic_resp, const ch
     else if ((input_queue != NULL) && InternStrnicmp(topic_resp, input_queue, strlen(input_queue) - 1) == 0)
     {
         type = IOTHUB_TYPE_EVENT_QUEUE;
+        *input_queue_prefix_length = strlen(input_queue) - 1;
     }
     else
     {
@@ -589,51 +741,170 @@ static void sendMsgComplete(IOTHUB_MESSAGE_LIST* iothubMsgList, PMQTTTRANSPORT_H
     transport_data->transport_callbacks.send_complete_cb(&messageCompleted, confirmResult, transport_data->transport_ctx);
 }
 
-static int addUserPropertiesTouMqttMessage(IOTHUB_MESSAGE_HANDLE iothub_message_handle, STRING_HANDLE topic_string, size_t* index_ptr, bool urlencode)
+static bool are_user_properties_cached(PMQTTTRANSPORT_HANDLE_DATA transport_data, const char* const* propertyKeys, const char* const* propertyValues, size_t propertyCount)
+{
+    bool result;
+    if ((transport_data->user_properties == NULL) || (transport_data->user_properties_count != propertyCount))
+    {
+        result = false;
+    }
+    else
+    {
+        const char* cached = transport_data->user_properties;
+        size_t index;
+        result = true;
+        for (index = 0; index < propertyCount && result; index++)
+        {
+            if (strcmp(cached, propertyKeys[index]) != 0)
+            {
+                result = false;
+            }
+            else
+            {
+                cached += strlen(cached) + 1;
+                if (strcmp(cached, propertyValues[index]) != 0)
+                {
+                    result = false;
+                }
+                cached += strlen(cached) + 1;
+            }
+        }
+    }
+    return result;
+}
+
+static int cache_encoded_user_properties(PMQTTTRANSPORT_HANDLE_DATA transport_data, const char* const* propertyKeys, const char* const* propertyValues, size_t propertyCount)
 {
     int result = 0;
-    const char* const* propertyKeys;
-    const char* const* propertyValues;
-    size_t propertyCount;
-    size_t index = *index_ptr;
-    MAP_HANDLE properties_map = IoTHubMessage_Properties(iothub_message_handle);
-    if (properties_map != NULL)
+    size_t length = 0;
+    size_t index;
+
+    if (transport_data->user_properties != NULL)
+    {
+        free(transport_data->user_properties);
+        transport_data->user_properties = NULL;
+    }
+
+    if (transport_data->encoded_user_properties == NULL)
+    {
+        if ((transport_data->encoded_user_properties = STRING_new()) == NULL)
+        {
+            LogError("Failed creating the encoded properties string.");
+            result = __FAILURE__;
+        }
+    }
+    else if (STRING_empty(transport_data->encoded_user_properties) != 0)
+    {
+        LogError("Failed clearing the encoded properties string.");
+        result = __FAILURE__;
+    }
+
+    for (index = 0; index < propertyCount && result == 0; index++)
+    {
+        STRING_HANDLE property_key = URL_EncodeString(propertyKeys[index]);
+        STRING_HANDLE property_value = URL_EncodeString(propertyValues[index]);
+        if ((property_key == NULL) || (property_value == NULL))
+        {
+            LogError("Failed URL Encoding properties");
+            result = __FAILURE__;
+        }
+        else if (STRING_sprintf(transport_data->encoded_user_properties, "%s=%s%s", STRING_c_str(property_key), STRING_c_str(property_value), propertyCount - 1 == index ? "" : PROPERTY_SEPARATOR) != 0)
+        {
+            LogError("Failed constructing property string.");
+            result = __FAILURE__;
+        }
+        STRING_delete(property_key);
+        STRING_delete(property_value);
+        length += strlen(propertyKeys[index]) + strlen(propertyValues[index]) + 2;
+    }
+
+    if (result == 0)
     {
-        if (Map_GetInternals(properties_map, &propertyKeys, &propertyValues, &propertyCount) != MAP_OK)
+        if ((transport_data->user_properties = (char*)malloc(length)) == NULL)
         {
-            LogError("Failed to get the internals of the property map.");
+            LogError("Failed allocating the cached properties.");
             result = __FAILURE__;
         }
         else
         {
-            if (propertyCount != 0)
+            char* cached = transport_data->user_properties;
+            for (index = 0; index < propertyCount; index++)
             {
-                for (index = 0; index < propertyCount && result == 0; index++)
+                size_t key_length = strlen(propertyKeys[index]) + 1;
+                size_t value_length = strlen(propertyValues[index]) + 1;
+                (void)memcpy(cached, propertyKeys[index], key_length);
+                cached += key_length;
+                (void)memcpy(cached, propertyValues[index], value_length);
+                cached += value_length;
+            }
+            transport_data->user_properties_count = propertyCount;
+        }
+    }
+    return result;
+}
+
+static int addUserPropertiesTouMqttMessage(PMQTTTRANSPORT_HANDLE_DATA transport_data, IOTHUB_MESSAGE_HANDLE iothub_message_handle, STRING_HANDLE topic_string, size_t* index_ptr, bool urlencode)
+{
+    int result = 0;
+    const char* const* propertyKeys;
+    const char* const* propertyValues;
+    size_t propertyCount;
+    size_t index = *index_ptr;
+    if (IoTHubMessage_GetProperties(iothub_message_handle, &propertyKeys, &propertyValues, &propertyCount) != IOTHUB_MESSAGE_OK)
+    {
+        LogError("Failed to get the properties of the message.");
+        result = __FAILURE__;
+    }
+    else
+    {
+        if (propertyCount != 0)
+        {
+            if (urlencode)
+            {
+                IOTHUB_MESSAGE_PROPERTY_SET_HANDLE property_set = IoTHubMessage_GetPropertySet(iothub_message_handle);
+
+                // Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_41_026: [ When url encoding is on and the message refers to the same property set as the previous message, `IoTHubTransport_MQTT_Common_DoWork` shall reuse the previous url encoding without comparing the properties. ]
+                if ((property_set == NULL) || (property_set != transport_data->user_properties_set))
                 {
-                    if (urlencode)
+                    if (transport_data->user_properties_set != NULL)
                     {
-                        STRING_HANDLE property_key = URL_EncodeString(propertyKeys[index]);
-                        STRING_HANDLE property_value = URL_EncodeString(propertyValues[index]);
-                        if ((property_key == NULL) || (property_value == NULL))
-                        {
-                            LogError("Failed URL Encoding properties");
-                            result = __FAILURE__;
-                        }
-                        else if (STRING_sprintf(topic_string, "%s=%s%s", STRING_c_str(property_key), STRING_c_str(property_value), propertyCount - 1 == index ? "" : PROPERTY_SEPARATOR) != 0)
-                        {
-                            LogError("Failed constructing property string.");
-                            result = __FAILURE__;
-                        }
-                        STRING_delete(property_key);
-                        STRING_delete(property_value);
+                        IoTHubMessagePropertySet_Destroy(transport_data->user_properties_set);
+                        transport_data->user_properties_set = NULL;
                     }
-                    else
+
+                    // Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_41_004: [ When url encoding is on and the message carries the same user properties as the previous message, `IoTHubTransport_MQTT_Common_DoWork` shall reuse their previous url encoding instead of encoding them again. ]
+                    if (!are_user_properties_cached(transport_data, propertyKeys, propertyValues, propertyCount) &&
+                        cache_encoded_user_properties(transport_data, propertyKeys, propertyValues, propertyCount) != 0)
                     {
-                        if (STRING_sprintf(topic_string, "%s=%s%s", propertyKeys[index], propertyValues[index], propertyCount - 1 == index ? "" : PROPERTY_SEPARATOR) != 0)
-                        {
-                            LogError("Failed constructing property string.");
-                            result = __FAILURE__;
-                        }
+                        LogError("Failed URL Encoding properties");
+                        result = __FAILURE__;
+                    }
+                    else if (property_set != NULL)
+                    {
+                        // Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_41_027: [ `IoTHubTransport_MQTT_Common_DoWork` shall keep a reference on the property set the url encoding was built from, released when the encoding is rebuilt and on destroy. ]
+                        transport_data->user_properties_set = IoTHubMessagePropertySet_Clone(property_set);
+                    }
+                }
+
+                if (result != 0)
+                {
+                    // the encoding could not be built
+                }
+                else if (STRING_concat_with_STRING(topic_string, transport_data->encoded_user_properties) != 0)
+                {
+                    LogError("Failed constructing property string.");
+                    result = __FAILURE__;
+                }
+                index = propertyCount;
+            }
+            else
+            {
+                for (index = 0; index < propertyCount && result == 0; index++)
+                {
+                    if (STRING_sprintf(topic_string, "%s=%s%s", propertyKeys[index], propertyValues[index], propertyCount - 1 == index ? "" : PROPERTY_SEPARATOR) != 0)
+                    {
+                        LogError("Failed constructing property string.");
+                        result = __FAILURE__;
                     }
                 }
             }
@@ -643,11 +914,58 @@ static int addUserPropertiesTouMqttMessage(IOTHUB_MESSAGE_HANDLE iothub_message_
     return result;
 }
 
-static int addSystemPropertyToTopicString(STRING_HANDLE topic_string, size_t index, const char* property_key, const char* property_value, bool urlencode)
+static const char* get_encoded_value(ENCODED_VALUE_CACHE* cache, const char* value)
+{
+    const char* result;
+    if ((cache->value != NULL) && (strcmp(cache->value, value) == 0))
+    {
+        result = STRING_c_str(cache->encoded_value);
+    }
+    else
+    {
+        char* value_copy;
+        STRING_HANDLE encoded_value = URL_EncodeString(value);
+        if (encoded_value == NULL)
+        {
+            LogError("Failed URL encoding value.");
+            result = NULL;
+        }
+        else if (mallocAndStrcpy_s(&value_copy, value) != 0)
+        {
+            LogError("Failed copying value.");
+            STRING_delete(encoded_value);
+            result = NULL;
+        }
+        else
+        {
+            free_encoded_value_cache(cache);
+            cache->value = value_copy;
+            cache->encoded_value = encoded_value;
+            result = STRING_c_str(encoded_value);
+        }
+    }
+    return result;
+}
+
+static int addSystemPropertyToTopicString(STRING_HANDLE topic_string, size_t index, const char* property_key, const char* property_value, bool urlencode, ENCODED_VALUE_CACHE* cache)
 {
     int result = 0;
 
-    if (urlencode)
+    if (urlencode && (cache != NULL))
+    {
+        const char* encoded_property_value = get_encoded_value(cache, property_value);
+        if (encoded_property_value == NULL)
+        {
+            LogError("Failed URL encoding %s.", property_key);
+            result = __FAILURE__;
+        }
+        else if (STRING_sprintf(topic_string, "%s%%24.%s=%s", index == 0 ? "" : PROPERTY_SEPARATOR, property_key, encoded_property_value) != 0)
+        {
+            LogError("Failed setting %s.", property_key);
+            result = __FAILURE__;
+        }
+    }
+    else if (urlencode)
     {
         STRING_HANDLE encoded_property_value = URL_EncodeString(property_value);
         if (encoded_property_value == NULL)
@@ -673,7 +991,7 @@ static int addSystemPropertyToTopicString(STRING_HANDLE topic_string, size_t ind
     return result;
 }
 
-static int addSystemPropertiesTouMqttMessage(IOTHUB_MESSAGE_HANDLE iothub_message_handle, STRING_HANDLE topic_string, size_t* index_ptr, bool urlencode)
+static int addSystemPropertiesTouMqttMessage(PMQTTTRANSPORT_HANDLE_DATA transport_data, IOTHUB_MESSAGE_HANDLE iothub_message_handle, STRING_HANDLE topic_string, size_t* index_ptr, bool urlencode)
 {
     (void)urlencode;
     int result = 0;
@@ -683,7 +1001,7 @@ static int addSystemPropertiesTouMqttMessage(IOTHUB_MESSAGE_HANDLE iothub_messag
     const char* correlation_id = IoTHubMessage_GetCorrelationId(iothub_message_handle);
     if (correlation_id != NULL)
     {
-        result = addSystemPropertyToTopicString(topic_string, index, CORRELATION_ID_PROPERTY, correlation_id, urlencode);
+        result = addSystemPropertyToTopicString(topic_string, index, CORRELATION_ID_PROPERTY, correlation_id, urlencode, NULL);
         index++;
     }
     /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_07_053: [ IoTHubTransport_MQTT_Common_DoWork shall check for the MessageId property and if found add the value as a system property in the format of $.mid=<id> ] */
@@ -692,17 +1010,18 @@ static int addSystemPropertiesTouMqttMessage(IOTHUB_MESSAGE_HANDLE iothub_messag
         const char* msg_id = IoTHubMessage_GetMessageId(iothub_message_handle);
         if (msg_id != NULL)
         {
-            result = addSystemPropertyToTopicString(topic_string, index, MESSAGE_ID_PROPERTY, msg_id, urlencode);
+            result = addSystemPropertyToTopicString(topic_string, index, MESSAGE_ID_PROPERTY, msg_id, urlencode, NULL);
             index++;
         }
     }
     // Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_09_010: [ `IoTHubTransport_MQTT_Common_DoWork` shall check for the ContentType property and if found add the `value` as a system property in the format of `$.ct=<value>` ]
+    // Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_41_005: [ When url encoding is on and the ContentType or ContentEncoding is the same as in the previous message, `IoTHubTransport_MQTT_Common_DoWork` shall reuse its previous url encoding. ]
     if (result == 0)
     {
         const char* content_type = IoTHubMessage_GetContentTypeSystemProperty(iothub_message_handle);
         if (content_type != NULL)
         {
-            result = addSystemPropertyToTopicString(topic_string, index, CONTENT_TYPE_PROPERTY, content_type, urlencode);
+            result = addSystemPropertyToTopicString(topic_string, index, CONTENT_TYPE_PROPERTY, content_type, urlencode, &transport_data->content_type_cache);
             index++;
         }
     }
@@ -712,7 +1031,7 @@ static int addSystemPropertiesTouMqttMessage(IOTHUB_MESSAGE_HANDLE iothub_messag
         const char* content_encoding = IoTHubMessage_GetContentEncodingSystemProperty(iothub_message_handle);
         if (content_encoding != NULL)
         {
-            result = addSystemPropertyToTopicString(topic_string, index, CONTENT_ENCODING_PROPERTY, content_encoding, urlencode);
+            result = addSystemPropertyToTopicString(topic_string, index, CONTENT_ENCODING_PROPERTY, content_encoding, urlencode, &transport_data->content_encoding_cache);
             index++;
         }
     }
@@ -788,34 +1107,46 @@ static int addDiagnosticPropertiesTouMqttMessage(IOTHUB_MESSAGE_HANDLE iothub_me
 }
 
 
-static STRING_HANDLE addPropertiesTouMqttMessage(IOTHUB_MESSAGE_HANDLE iothub_message_handle, const char* eventTopic, bool urlencode)
+static STRING_HANDLE addPropertiesTouMqttMessage(PMQTTTRANSPORT_HANDLE_DATA transport_data, IOTHUB_MESSAGE_HANDLE iothub_message_handle, const char* eventTopic, bool urlencode)
 {
     size_t index = 0;
-    STRING_HANDLE result = STRING_construct(eventTopic);
+    STRING_HANDLE result;
+
+    // Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_41_006: [ `IoTHubTransport_MQTT_Common_DoWork` shall build every telemetry topic in a single string owned by the transport, created on the first publish and freed on destroy. ]
+    if (transport_data->telemetry_topic == NULL)
+    {
+        result = transport_data->telemetry_topic = STRING_construct(eventTopic);
+    }
+    else if (STRING_copy(transport_data->telemetry_topic, eventTopic) != 0)
+    {
+        result = NULL;
+    }
+    else
+    {
+        result = transport_data->telemetry_topic;
+    }
+
     if (result == NULL)
     {
         LogError("Failed to create event topic string handle");
     }
-    else if (addUserPropertiesTouMqttMessage(iothub_message_handle, result, &index, urlencode) != 0)
+    else if (addUserPropertiesTouMqttMessage(transport_data, iothub_message_handle, result, &index, urlencode) != 0)
     {
         LogError("Failed adding Properties to uMQTT Message");
-        STRING_delete(result);
         result = NULL;
     }
-    else if (addSystemPropertiesTouMqttMessage(iothub_message_handle, result, &index, urlencode) != 0)
+    else if (addSystemPropertiesTouMqttMessage(transport_data, iothub_message_handle, result, &index, urlencode) != 0)
     {
         LogError("Failed adding System Properties to uMQTT Message");
-        STRING_delete(result);
         result = NULL;
     }
     else if (addDiagnosticPropertiesTouMqttMessage(iothub_message_handle, result, &index) != 0)
     {
         LogError("Failed adding Diagnostic Properties to uMQTT Message");
-        STRING_delete(result);
         result = NULL;
     }
 
-    // Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_31_060: [ `IoTHubTransport_MQTT_Common_DoWork` shall check for the OutputName property and if found add the alue as a system property in the format of $.on=<value> ]
+    // Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_31_060: [ `IoTHubTransport_MQTT_Common_DoWork` shall check for the OutputName property and if found add the alue as a system property in the format of $.on=<value> ]
     if (result != NULL)
     {
         const char* output_name = IoTHubMessage_GetOutputName(iothub_message_handle);
@@ -824,7 +1155,6 @@ static STRING_HANDLE addPropertiesTouMqttMessage(IOTHUB_MESSAGE_HANDLE iothub_me
             if (STRING_sprintf(result, "%s%%24.on=%s/", index == 0 ? "" : PROPERTY_SEPARATOR, output_name) != 0)
             {
                 LogError("Failed setting output name.");
-                STRING_delete(result);
                 result = NULL;
             }
             index++;
@@ -834,10 +1164,149 @@ static STRING_HANDLE addPropertiesTouMqttMessage(IOTHUB_MESSAGE_HANDLE iothub_me
     return result;
 }
 
-static int publish_mqtt_telemetry_msg(PMQTTTRANSPORT_HANDLE_DATA transport_data, MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry, const unsigned char* payload, size_t len)
+static void report_statistic(PMQTTTRANSPORT_HANDLE_DATA transport_data, TRANSPORT_STATISTIC statistic, IOTHUB_MESSAGE_LIST* message, size_t size)
+{
+    if (transport_data->transport_callbacks.statistics_cb != NULL)
+    {
+        transport_data->transport_callbacks.statistics_cb(statistic, message, size, transport_data->transport_ctx);
+    }
+}
+
+static void insert_in_telemetry_ack_index(MQTT_MESSAGE_DETAILS_LIST** index, size_t size, MQTT_MESSAGE_DETAILS_LIST* entry)
+{
+    size_t slot = entry->packet_id & (size - 1);
+    while (index[slot] != NULL)
+    {
+        slot = (slot + 1) & (size - 1);
+    }
+    index[slot] = entry;
+}
+
+static int reserve_telemetry_waiting_for_ack(PMQTTTRANSPORT_HANDLE_DATA transport_data)
+{
+    int result;
+
+    // The index is kept at most 3/4 full, so probes stay short and always end on an empty slot
+    if ((transport_data->telemetry_inflight_count + 1) * 4 <= transport_data->telemetry_ack_index_size * 3)
+    {
+        result = 0;
+    }
+    else
+    {
+        size_t new_size = transport_data->telemetry_ack_index_size * 2;
+        MQTT_MESSAGE_DETAILS_LIST** new_index = (MQTT_MESSAGE_DETAILS_LIST**)malloc(new_size * sizeof(MQTT_MESSAGE_DETAILS_LIST*));
+        if (new_index == NULL)
+        {
+            LogError("Failure allocating the PUBACK index.");
+            result = __FAILURE__;
+        }
+        else
+        {
+            size_t slot;
+            memset(new_index, 0, new_size * sizeof(MQTT_MESSAGE_DETAILS_LIST*));
+            for (slot = 0; slot < transport_data->telemetry_ack_index_size; slot++)
+            {
+                if (transport_data->telemetry_ack_index[slot] != NULL)
+                {
+                    insert_in_telemetry_ack_index(new_index, new_size, transport_data->telemetry_ack_index[slot]);
+                }
+            }
+            if (transport_data->telemetry_ack_index != transport_data->telemetry_ack_index_inline)
+            {
+                free(transport_data->telemetry_ack_index);
+            }
+            transport_data->telemetry_ack_index = new_index;
+            transport_data->telemetry_ack_index_size = new_size;
+            result = 0;
+        }
+    }
+    return result;
+}
+
+static void add_telemetry_waiting_for_ack(PMQTTTRANSPORT_HANDLE_DATA transport_data, MQTT_MESSAGE_DETAILS_LIST* entry)
+{
+    DList_InsertTailList(&(transport_data->telemetry_waitingForAck), &(entry->entry));
+    insert_in_telemetry_ack_index(transport_data->telemetry_ack_index, transport_data->telemetry_ack_index_size, entry);
+    transport_data->telemetry_inflight_count++;
+    /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_41_025: [ Every telemetry message waiting for its PUBACK shall count its details in IOTHUB_CLIENT_MEMORY_TRANSPORT of the memory counters of the transport, which are registered with the memory accounting while the transport exists. ] */
+    IOTHUB_CLIENT_MEMORY_ADD(&transport_data->memory_counters, IOTHUB_CLIENT_MEMORY_TRANSPORT, sizeof(MQTT_MESSAGE_DETAILS_LIST));
+}
+
+static MQTT_MESSAGE_DETAILS_LIST* find_telemetry_waiting_for_ack(PMQTTTRANSPORT_HANDLE_DATA transport_data, uint16_t packet_id)
+{
+    MQTT_MESSAGE_DETAILS_LIST* result = NULL;
+    size_t mask = transport_data->telemetry_ack_index_size - 1;
+    size_t slot = packet_id & mask;
+    while ((result == NULL) && (transport_data->telemetry_ack_index[slot] != NULL))
+    {
+        if (transport_data->telemetry_ack_index[slot]->packet_id == packet_id)
+        {
+            result = transport_data->telemetry_ack_index[slot];
+        }
+        slot = (slot + 1) & mask;
+    }
+    return result;
+}
+
+static void remove_telemetry_waiting_for_ack(PMQTTTRANSPORT_HANDLE_DATA transport_data, MQTT_MESSAGE_DETAILS_LIST* entry)
+{
+    MQTT_MESSAGE_DETAILS_LIST** index = transport_data->telemetry_ack_index;
+    size_t mask = transport_data->telemetry_ack_index_size - 1;
+    size_t slot = entry->packet_id & mask;
+
+    IOTHUB_CLIENT_MEMORY_REMOVE(&transport_data->memory_counters, IOTHUB_CLIENT_MEMORY_TRANSPORT, sizeof(MQTT_MESSAGE_DETAILS_LIST));
+
+    while ((index[slot] != NULL) && (index[slot] != entry))
+    {
+        slot = (slot + 1) & mask;
+    }
+    if (index[slot] == entry)
+    {
+        // Shift back the entries that probed past the freed slot, so no lookup stops early on it
+        size_t next = (slot + 1) & mask;
+        index[slot] = NULL;
+        while (index[next] != NULL)
+        {
+            size_t home = index[next]->packet_id & mask;
+            if (((next - home) & mask) >= ((next - slot) & mask))
+            {
+                index[slot] = index[next];
+                index[next] = NULL;
+                slot = next;
+            }
+            next = (next + 1) & mask;
+        }
+    }
+
+    (void)DList_RemoveEntryList(&(entry->entry));
+    transport_data->telemetry_inflight_count--;
+}
+
+static bool is_telemetry_window_full(PMQTTTRANSPORT_HANDLE_DATA transport_data)
+{
+    return (transport_data->max_inflight != 0) && (transport_data->telemetry_inflight_count >= transport_data->max_inflight);
+}
+
+static bool is_at_most_once_telemetry(PMQTTTRANSPORT_HANDLE_DATA transport_data, IOTHUB_MESSAGE_HANDLE messageHandle)
+{
+    bool result;
+    if (transport_data->at_most_once_output == NULL)
+    {
+        result = false;
+    }
+    else
+    {
+        /*an empty output name stands for the messages sent without one*/
+        const char* output_name = IoTHubMessage_GetOutputName(messageHandle);
+        result = (strcmp((output_name == NULL) ? "" : output_name, transport_data->at_most_once_output) == 0);
+    }
+    return result;
+}
+
+static int publish_mqtt_telemetry_msg(PMQTTTRANSPORT_HANDLE_DATA transport_data, MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry, QOS_VALUE qos, const unsigned char* payload, size_t len)
 {
     int result;
-    STRING_HANDLE msgTopic = addPropertiesTouMqttMessage(mqttMsgEntry->iotHubMessageEntry->messageHandle, STRING_c_str(transport_data->topic_MqttEvent), transport_data->auto_url_encode_decode);
+    STRING_HANDLE msgTopic = addPropertiesTouMqttMessage(transport_data, mqttMsgEntry->iotHubMessageEntry->messageHandle, STRING_c_str(transport_data->topic_MqttEvent), transport_data->auto_url_encode_decode);
     if (msgTopic == NULL)
     {
         LogError("Failed adding properties to mqtt message");
@@ -845,7 +1314,7 @@ static int publish_mqtt_telemetry_msg(PMQTTTRANSPORT_HANDLE_DATA transport_data,
     }
     else
     {
-        MQTT_MESSAGE_HANDLE mqttMsg = mqttmessage_create_in_place(mqttMsgEntry->packet_id, STRING_c_str(msgTopic), DELIVER_AT_LEAST_ONCE, payload, len);
+        MQTT_MESSAGE_HANDLE mqttMsg = mqttmessage_create_in_place(mqttMsgEntry->packet_id, STRING_c_str(msgTopic), qos, payload, len);
         if (mqttMsg == NULL)
         {
             LogError("Failed creating mqtt message");
@@ -868,12 +1337,13 @@ static int publish_mqtt_telemetry_msg(PMQTTTRANSPORT_HANDLE_DATA transport_data,
                 else
                 {
                     mqttMsgEntry->retryCount++;
+                    IOTHUB_CLIENT_TRACE(IOTHUB_CLIENT_TRACE_MQTT_PUBLISH, transport_data, mqttMsgEntry->packet_id, len);
+                    report_statistic(transport_data, TRANSPORT_STATISTIC_EVENT_PUBLISHED, mqttMsgEntry->iotHubMessageEntry, len);
                     result = 0;
                 }
             }
             mqttmessage_destroy(mqttMsg);
         }
-        STRING_delete(msgTopic);
     }
     return result;
 }
@@ -918,9 +1388,47 @@ static int publish_device_method_message(MQTTTRANSPORT_HANDLE_DATA* transport_da
 
 static void destroy_device_twin_get_message(MQTT_DEVICE_TWIN_ITEM* msg_entry)
 {
+    while (msg_entry->waiters != NULL)
+    {
+        MQTT_DEVICE_TWIN_WAITER* waiter = msg_entry->waiters;
+        msg_entry->waiters = waiter->next;
+        free(waiter);
+    }
     free(msg_entry);
 }
 
+static void complete_get_twin_request(MQTT_DEVICE_TWIN_ITEM* msg_entry, const unsigned char* payload, size_t size)
+{
+    MQTT_DEVICE_TWIN_WAITER* waiter;
+
+    msg_entry->userCallback(DEVICE_TWIN_UPDATE_COMPLETE, payload, size, msg_entry->userContext);
+
+    for (waiter = msg_entry->waiters; waiter != NULL; waiter = waiter->next)
+    {
+        waiter->userCallback(DEVICE_TWIN_UPDATE_COMPLETE, payload, size, waiter->userContext);
+    }
+}
+
+static MQTT_DEVICE_TWIN_ITEM* find_on_demand_get_twin_request(PDLIST_ENTRY list)
+{
+    MQTT_DEVICE_TWIN_ITEM* result = NULL;
+    PDLIST_ENTRY list_item = list->Flink;
+
+    while (list_item != list && result == NULL)
+    {
+        MQTT_DEVICE_TWIN_ITEM* msg_entry = containingRecord(list_item, MQTT_DEVICE_TWIN_ITEM, entry);
+
+        if (msg_entry->device_twin_msg_type == RETRIEVE_PROPERTIES && msg_entry->userCallback != NULL)
+        {
+            result = msg_entry;
+        }
+
+        list_item = list_item->Flink;
+    }
+
+    return result;
+}
+
 static MQTT_DEVICE_TWIN_ITEM* create_device_twin_get_message(MQTTTRANSPORT_HANDLE_DATA* transport_data)
 {
     MQTT_DEVICE_TWIN_ITEM* result;
@@ -941,6 +1449,7 @@ static MQTT_DEVICE_TWIN_ITEM* create_device_twin_get_message(MQTTTRANSPORT_HANDL
         result->device_twin_data = NULL;
         result->userCallback = NULL;
         result->userContext = NULL;
+        result->waiters = NULL;
     }
 
     return result;
@@ -973,6 +1482,7 @@ static int publish_device_twin_get_message(MQTTTRANSPORT_HANDLE_DATA* transport_
             }
             else
             {
+                IOTHUB_CLIENT_STARTUP_MARK(IOTHUB_CLIENT_STARTUP_TWIN_REQUESTED);
                 DList_InsertTailList(&transport_data->ack_waiting_queue, &mqtt_info->entry);
                 result = 0;
             }
@@ -1026,7 +1536,7 @@ static void removeExpiredPendingGetTwinRequests(PMQTTTRANSPORT_HANDLE_DATA trans
             if (((current_ms - msg_entry->msgEnqueueTime) / 1000) >= ON_DEMAND_GET_TWIN_REQUEST_TIMEOUT_SECS)
             {
                 (void)DList_RemoveEntryList(listItem);
-                msg_entry->userCallback(DEVICE_TWIN_UPDATE_COMPLETE, NULL, 0, msg_entry->userContext);
+                complete_get_twin_request(msg_entry, NULL, 0);
                 destroy_device_twin_get_message(msg_entry);
             }
 
@@ -1055,7 +1565,7 @@ static void removeExpiredGetTwinRequestsPendingAck(PMQTTTRANSPORT_HANDLE_DATA tr
                 if (((current_ms - msg_entry->msgEnqueueTime) / 1000) >= ON_DEMAND_GET_TWIN_REQUEST_TIMEOUT_SECS)
                 {
                     (void)DList_RemoveEntryList(listItem);
-                    msg_entry->userCallback(DEVICE_TWIN_UPDATE_COMPLETE, NULL, 0, msg_entry->userContext);
+                    complete_get_twin_request(msg_entry, NULL, 0);
                     destroy_device_twin_get_message(msg_entry);
                 }
             }
@@ -1164,147 +1674,209 @@ static int subscribeToNotifyStateIfNeeded(PMQTTTRANSPORT_HANDLE_DATA transport_d
 }
 
 
-static bool isSystemProperty(const char* tokenData)
+static bool isSystemProperty(const TOPIC_SLICE* token)
 {
     bool result = false;
     size_t propCount = sizeof(sysPropList) / sizeof(sysPropList[0]);
     size_t index = 0;
     for (index = 0; index < propCount; index++)
     {
-        if (memcmp(tokenData, sysPropList[index].propName, sysPropList[index].propLength) == 0)
-        {
-            result = true;
-            break;
-        }
+        if (token->length >= sysPropList[index].propLength && memcmp(token->value, sysPropList[index].propName, sysPropList[index].propLength) == 0)
+        {
+            result = true;
+            break;
+        }
+    }
+    return result;
+}
+
+// Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_31_061: [ If the message is sent to an input queue, `IoTHubTransport_MQTT_Common_DoWork` shall parse out to the input queue name and store it in the message with IoTHubMessage_SetInputName ]
+// Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_31_062: [ If IoTHubTransport_MQTT_Common_DoWork receives a malformatted inputQueue, it shall fail ]
+// Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_41_017: [ The input name shall be read as the slice following the input queue prefix already matched by retrieve_topic_type, without rescanning the device and module segments. ]
+static int addInputNamePropertyToMessage(IOTHUB_MESSAGE_HANDLE IoTHubMessage, const char* topic_name, size_t input_queue_prefix_length)
+{
+    int result = __FAILURE__;
+    int number_tokens_read = 0;
+    const char* cursor = topic_name + input_queue_prefix_length;
+    TOPIC_SLICE token;
+
+    while (get_next_topic_slice(&cursor, "/", &token))
+    {
+        number_tokens_read++;
+        if (number_tokens_read == segments_to_reach_input_name)
+        {
+            char buffer[TOPIC_VALUE_BUFFER_SIZE];
+            char* input_name = copy_topic_slice(&token, buffer, sizeof(buffer));
+            if (input_name == NULL)
+            {
+                LogError("Failed copying input name");
+                result = __FAILURE__;
+            }
+            else
+            {
+                if ((IOTHUB_MESSAGE_OK != IoTHubMessage_SetInputName(IoTHubMessage, input_name)))
+                {
+                    LogError("Failed adding input name to msg");
+                    result = __FAILURE__;
+                }
+                else
+                {
+                    result = 0;
+                }
+                free_topic_slice_copy(input_name, buffer);
+            }
+            break;
+        }
+    }
+
+    if (number_tokens_read != segments_to_reach_input_name)
+    {
+        LogError("Not enough '/' to contain input name.  Got %d segments after the module, need at least %d", number_tokens_read, segments_to_reach_input_name);
+        result = __FAILURE__;
+    }
+
+    return result;
+}
+
+// Not finding a system property to map to isn't an error, the property is then skipped without being copied.
+static MESSAGE_PROPERTY_SETTER get_system_property_setter(const TOPIC_SLICE* propName)
+{
+    MESSAGE_PROPERTY_SETTER result;
+
+    // Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_31_063: [ If type is IOTHUB_TYPE_TELEMETRY and the system property `$.cdid` is defined, its value shall be set on the IOTHUB_MESSAGE_HANDLE's ConnectionDeviceId property ]
+    if (topic_slice_ends_with(propName, CONNECTION_DEVICE_ID))
+    {
+        result = IoTHubMessage_SetConnectionDeviceId;
+    }
+    // Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_31_064: [ If type is IOTHUB_TYPE_TELEMETRY and the system property `$.cmid` is defined, its value shall be set on the IOTHUB_MESSAGE_HANDLE's ConnectionModuleId property ]
+    else if (topic_slice_ends_with(propName, CONNECTION_MODULE_ID_PROPERTY))
+    {
+        result = IoTHubMessage_SetConnectionModuleId;
+    }
+    else if (topic_slice_ends_with(propName, MESSAGE_ID_PROPERTY))
+    {
+        result = IoTHubMessage_SetMessageId;
+    }
+    else if (topic_slice_ends_with(propName, CORRELATION_ID_PROPERTY))
+    {
+        result = IoTHubMessage_SetCorrelationId;
+    }
+    // Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_09_012: [ If type is IOTHUB_TYPE_TELEMETRY and the system property `$.ct` is defined, its value shall be set on the IOTHUB_MESSAGE_HANDLE's ContentType property ]
+    else if (topic_slice_ends_with(propName, CONTENT_TYPE_PROPERTY))
+    {
+        result = IoTHubMessage_SetContentTypeSystemProperty;
+    }
+    // Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_09_013: [ If type is IOTHUB_TYPE_TELEMETRY and the system property `$.ce` is defined, its value shall be set on the IOTHUB_MESSAGE_HANDLE's ContentEncoding property ]
+    else if (topic_slice_ends_with(propName, CONTENT_ENCODING_PROPERTY))
+    {
+        result = IoTHubMessage_SetContentEncodingSystemProperty;
+    }
+    else
+    {
+        result = NULL;
     }
+
     return result;
 }
 
-// Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_31_061: [ If the message is sent to an input queue, `IoTHubTransport_MQTT_Common_DoWork` shall parse out to the input queue name and store it in the message with IoTHubMessage_SetInputName ]
-// Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_31_062: [ If IoTHubTransport_MQTT_Common_DoWork receives a malformatted inputQueue, it shall fail ]
-static int addInputNamePropertyToMessage(IOTHUB_MESSAGE_HANDLE IoTHubMessage, const char* topic_name)
+static int setMqttMessageSystemProperty(IOTHUB_MESSAGE_HANDLE IoTHubMessage, MESSAGE_PROPERTY_SETTER setter, const TOPIC_SLICE* propValue, bool urldecode)
 {
-    int result = __FAILURE__;
-    int number_tokens_read = 0;
+    int result;
+    char buffer[TOPIC_VALUE_BUFFER_SIZE];
+    char* value = copy_topic_slice(propValue, buffer, sizeof(buffer));
 
-    STRING_TOKENIZER_HANDLE token_handle = STRING_TOKENIZER_create_from_char(topic_name);
-    if (token_handle == NULL)
+    if (value == NULL)
     {
-        LogError("STRING_TOKENIZER_create_from_char failed\n");
+        LogError("Failed copying system property value");
         result = __FAILURE__;
     }
     else
     {
-        STRING_HANDLE token_value;
-        if ((token_value = STRING_new()) == NULL)
-        {
-            LogError("Failed allocating token_value");
-        }
-        else
+        if (urldecode)
         {
-            while (STRING_TOKENIZER_get_next_token(token_handle, token_value, "/") == 0)
+            STRING_HANDLE propValue_decoded;
+            if ((propValue_decoded = URL_DecodeString(value)) == NULL)
             {
-                number_tokens_read++;
-                if (number_tokens_read == (slashes_to_reach_input_name + 1))
+                LogError("Failed to URL decode property value");
+                result = __FAILURE__;
+            }
+            else
+            {
+                if (setter(IoTHubMessage, STRING_c_str(propValue_decoded)) != IOTHUB_MESSAGE_OK)
                 {
-                    if ((IOTHUB_MESSAGE_OK != IoTHubMessage_SetInputName(IoTHubMessage, STRING_c_str(token_value))))
-                    {
-                        LogError("Failed adding input name to msg");
-                        result = __FAILURE__;
-                    }
-                    else
-                    {
-                        result = 0;
-                    }
-                    break;
+                    LogError("Failed to set IOTHUB_MESSAGE_HANDLE system property.");
+                    result = __FAILURE__;
+                }
+                else
+                {
+                    result = 0;
                 }
+                STRING_delete(propValue_decoded);
             }
         }
-        STRING_delete(token_value);
-
-        if (number_tokens_read != (slashes_to_reach_input_name + 1))
+        else if (setter(IoTHubMessage, value) != IOTHUB_MESSAGE_OK)
         {
-            LogError("Not enough '/' to contain input name.  Got %d, need at least %d", number_tokens_read, (slashes_to_reach_input_name + 1));
+            LogError("Failed to set IOTHUB_MESSAGE_HANDLE system property.");
             result = __FAILURE__;
         }
-        STRING_TOKENIZER_destroy(token_handle);
+        else
+        {
+            result = 0;
+        }
+        free_topic_slice_copy(value, buffer);
     }
 
     return result;
 }
 
-static int setMqttMessagePropertyIfPossible(IOTHUB_MESSAGE_HANDLE IoTHubMessage, const char* propName, const char* propValue, size_t nameLen)
+static int addMqttMessageUserProperty(MAP_HANDLE propertyMap, const TOPIC_SLICE* token, size_t nameLen, bool urldecode)
 {
-    // Not finding a system property to map to isn't an error.
-    int result = 0;
+    int result;
+    char buffer[TOPIC_VALUE_BUFFER_SIZE];
+    // The name and the value are copied in one go, splitting them on the '='.
+    char* propName = copy_topic_slice(token, buffer, sizeof(buffer));
 
-    if (nameLen > 4)
+    if (propName == NULL)
     {
-        if (strcmp((const char*)&propName[nameLen - 4], CONNECTION_DEVICE_ID) == 0)
-        {
-            // Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_31_063: [ If type is IOTHUB_TYPE_TELEMETRY and the system property `$.cdid` is defined, its value shall be set on the IOTHUB_MESSAGE_HANDLE's ConnectionDeviceId property ]
-            if (IoTHubMessage_SetConnectionDeviceId(IoTHubMessage, propValue) != IOTHUB_MESSAGE_OK)
-            {
-                LogError("Failed to set IOTHUB_MESSAGE_HANDLE 'messageId' property.");
-                result = __FAILURE__;
-            }
-            return result;
-        }
-        if (strcmp((const char*)&propName[nameLen - 4], CONNECTION_MODULE_ID_PROPERTY) == 0)
-        {
-            // Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_31_064: [ If type is IOTHUB_TYPE_TELEMETRY and the system property `$.cmid` is defined, its value shall be set on the IOTHUB_MESSAGE_HANDLE's ConnectionModuleId property ]
-            if (IoTHubMessage_SetConnectionModuleId(IoTHubMessage, propValue) != IOTHUB_MESSAGE_OK)
-            {
-                LogError("Failed to set IOTHUB_MESSAGE_HANDLE 'correlationId' property.");
-                result = __FAILURE__;
-            }
-            return result;
-        }
+        LogError("Failed allocating property information");
+        result = __FAILURE__;
     }
-    if (nameLen > 3)
+    else
     {
-        if (strcmp((const char*)&propName[nameLen - 3], MESSAGE_ID_PROPERTY) == 0)
+        const char* propValue = propName + nameLen + 1;
+        propName[nameLen] = '\0';
+
+        if (urldecode)
         {
-            if (IoTHubMessage_SetMessageId(IoTHubMessage, propValue) != IOTHUB_MESSAGE_OK)
+            STRING_HANDLE propName_decoded = URL_DecodeString(propName);
+            STRING_HANDLE propValue_decoded = URL_DecodeString(propValue);
+            if (propName_decoded == NULL || propValue_decoded == NULL)
             {
-                LogError("Failed to set IOTHUB_MESSAGE_HANDLE 'messageId' property.");
+                LogError("Failed to URL decode property");
                 result = __FAILURE__;
             }
-            return result;
-        }
-        else if (strcmp((const char*)&propName[nameLen - 3], CORRELATION_ID_PROPERTY) == 0)
-        {
-            if (IoTHubMessage_SetCorrelationId(IoTHubMessage, propValue) != IOTHUB_MESSAGE_OK)
+            else if (Map_AddOrUpdate(propertyMap, STRING_c_str(propName_decoded), STRING_c_str(propValue_decoded)) != MAP_OK)
             {
-                LogError("Failed to set IOTHUB_MESSAGE_HANDLE 'correlationId' property.");
+                LogError("Map_AddOrUpdate failed.");
                 result = __FAILURE__;
             }
-            return result;
-        }
-    }
-
-    if (nameLen > 2)
-    {
-        // Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_09_012: [ If type is IOTHUB_TYPE_TELEMETRY and the system property `$.ct` is defined, its value shall be set on the IOTHUB_MESSAGE_HANDLE's ContentType property ]
-        if (strcmp((const char*)&propName[nameLen - 2], CONTENT_TYPE_PROPERTY) == 0)
-        {
-            if (IoTHubMessage_SetContentTypeSystemProperty(IoTHubMessage, propValue) != IOTHUB_MESSAGE_OK)
+            else
             {
-                LogError("Failed to set IOTHUB_MESSAGE_HANDLE 'customContentType' property.");
-                result = __FAILURE__;
+                result = 0;
             }
-            return result;
+            STRING_delete(propName_decoded);
+            STRING_delete(propValue_decoded);
         }
-        // Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_09_013: [ If type is IOTHUB_TYPE_TELEMETRY and the system property `$.ce` is defined, its value shall be set on the IOTHUB_MESSAGE_HANDLE's ContentEncoding property ]
-        else if (strcmp((const char*)&propName[nameLen - 2], CONTENT_ENCODING_PROPERTY) == 0)
+        else if (Map_AddOrUpdate(propertyMap, propName, propValue) != MAP_OK)
         {
-            if (IoTHubMessage_SetContentEncodingSystemProperty(IoTHubMessage, propValue) != IOTHUB_MESSAGE_OK)
-            {
-                LogError("Failed to set IOTHUB_MESSAGE_HANDLE 'contentEncoding' property.");
-                result = __FAILURE__;
-            }
-            return result;
+            LogError("Map_AddOrUpdate failed.");
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = 0;
         }
+        free_topic_slice_copy(propName, buffer);
     }
 
     return result;
@@ -1313,164 +1885,54 @@ static int setMqttMessagePropertyIfPossible(IOTHUB_MESSAGE_HANDLE IoTHubMessage,
 static int extractMqttProperties(IOTHUB_MESSAGE_HANDLE IoTHubMessage, const char* topic_name, bool urldecode)
 {
     int result;
-    STRING_TOKENIZER_HANDLE token = STRING_TOKENIZER_create_from_char(topic_name);
-    if (token != NULL)
+    MAP_HANDLE propertyMap = IoTHubMessage_Properties(IoTHubMessage);
+    if (propertyMap == NULL)
     {
-        MAP_HANDLE propertyMap = IoTHubMessage_Properties(IoTHubMessage);
-        if (propertyMap == NULL)
-        {
-            LogError("Failure to retrieve IoTHubMessage_properties.");
-            result = __FAILURE__;
-        }
-        else
+        LogError("Failure to retrieve IoTHubMessage_properties.");
+        result = __FAILURE__;
+    }
+    else
+    {
+        const char* cursor = topic_name;
+        TOPIC_SLICE token;
+
+        result = 0;
+
+        while (result == 0 && get_next_topic_slice(&cursor, PROPERTY_SEPARATOR, &token))
         {
-            STRING_HANDLE output = STRING_new();
-            if (output == NULL)
-            {
-                LogError("Failure to allocate STRING_new.");
-                result = __FAILURE__;
-            }
-            else
+            // Tokens without a value carry nothing to extract.
+            const char* separator = (const char*)memchr(token.value, '=', token.length);
+            if (separator != NULL)
             {
-                result = 0;
+                TOPIC_SLICE propName;
+                propName.value = token.value;
+                propName.length = (size_t)(separator - token.value);
 
-                while (STRING_TOKENIZER_get_next_token(token, output, PROPERTY_SEPARATOR) == 0 && result == 0)
+                if (isSystemProperty(&token))
                 {
-                    const char* tokenData = STRING_c_str(output);
-                    size_t tokenLen = strlen(tokenData);
-                    if (tokenData == NULL || tokenLen == 0)
-                    {
-                        break;
-                    }
-                    else
+                    MESSAGE_PROPERTY_SETTER setter = get_system_property_setter(&propName);
+                    if (setter != NULL)
                     {
-                        if (isSystemProperty(tokenData))
-                        {
-                            const char* iterator = tokenData;
-                            while (iterator != NULL && *iterator != '\0' && result == 0)
-                            {
-                                if (*iterator == '=')
-                                {
-                                    char* propName = NULL;
-                                    char* propValue = NULL;
-                                    size_t nameLen = iterator - tokenData;
-                                    size_t valLen = tokenLen - (nameLen + 1) + 1;
+                        TOPIC_SLICE propValue;
+                        propValue.value = separator + 1;
+                        propValue.length = token.length - (propName.length + 1);
 
-                                    if ((propName = malloc(nameLen + 1)) == NULL || (propValue = malloc(valLen + 1)) == NULL)
-                                    {
-                                        LogError("Failed allocating property name (%p) and/or value (%p)", propName, propValue);
-                                        free(propName);
-                                        result = __FAILURE__;
-                                    }
-                                    else
-                                    {
-                                        memcpy(propName, tokenData, nameLen);
-                                        propName[nameLen] = '\0';
-
-                                        memcpy(propValue, iterator + 1, valLen);
-                                        propValue[valLen] = '\0';
-
-                                        if (urldecode)
-                                        {
-                                            STRING_HANDLE propValue_decoded;
-                                            if ((propValue_decoded = URL_DecodeString(propValue)) == NULL)
-                                            {
-                                                LogError("Failed to URL decode property value");
-                                                result = __FAILURE__;
-                                            }
-                                            else if (setMqttMessagePropertyIfPossible(IoTHubMessage, propName, STRING_c_str(propValue_decoded), nameLen) != 0)
-                                            {
-                                                LogError("Unable to set message property");
-                                                result = __FAILURE__;
-                                            }
-                                            STRING_delete(propValue_decoded);
-                                        }
-                                        else
-                                        {
-                                            if (setMqttMessagePropertyIfPossible(IoTHubMessage, propName, propValue, nameLen) != 0)
-                                            {
-                                                LogError("Unable to set message property");
-                                                result = __FAILURE__;
-                                            }
-                                        }
-                                        free(propName);
-                                        free(propValue);
-                                    }
-                                    break;
-                                }
-                                iterator++;
-                            }
-                        }
-                        else //User Properties
+                        if (setMqttMessageSystemProperty(IoTHubMessage, setter, &propValue, urldecode) != 0)
                         {
-                            const char* iterator = tokenData;
-                            while (iterator != NULL && *iterator != '\0' && result == 0)
-                            {
-                                if (*iterator == '=')
-                                {
-                                    char* propName = NULL;
-                                    char* propValue = NULL;
-                                    size_t nameLen = iterator - tokenData;
-                                    size_t valLen = tokenLen - (nameLen + 1) + 1;
-
-                                    if ((propName = (char*)malloc(nameLen + 1)) == NULL || (propValue = (char*)malloc(valLen + 1)) == NULL)
-                                    {
-                                        free(propName);
-                                        LogError("Failed allocating property information");
-                                        result = __FAILURE__;
-                                    }
-                                    else
-                                    {
-                                        memcpy(propName, tokenData, nameLen);
-                                        propName[nameLen] = '\0';
-
-                                        memcpy(propValue, iterator + 1, valLen);
-                                        propValue[valLen] = '\0';
-
-                                        if (urldecode)
-                                        {
-                                            STRING_HANDLE propName_decoded = URL_DecodeString(propName);
-                                            STRING_HANDLE propValue_decoded = URL_DecodeString(propValue);
-                                            if (propName_decoded == NULL || propValue_decoded == NULL)
-                                            {
-                                                LogError("Failed to URL decode property");
-                                                result = __FAILURE__;
-                                            }
-                                            else if (Map_AddOrUpdate(propertyMap, STRING_c_str(propName_decoded), STRING_c_str(propValue_decoded)) != MAP_OK)
-                                            {
-                                                LogError("Map_AddOrUpdate failed.");
-                                                result = __FAILURE__;
-                                            }
-                                            STRING_delete(propName_decoded);
-                                            STRING_delete(propValue_decoded);
-                                        }
-                                        else
-                                        {
-                                            if (Map_AddOrUpdate(propertyMap, propName, propValue) != MAP_OK)
-                                            {
-                                                LogError("Map_AddOrUpdate failed.");
-                                                result = __FAILURE__;
-                                            }
-                                        }
-                                        free(propName);
-                                        free(propValue);
-                                    }
-                                    break;
-                                }
-                                iterator++;
-                            }
+                            LogError("Unable to set message property");
+                            result = __FAILURE__;
                         }
                     }
                 }
-                STRING_delete(output);
+                else //User Properties
+                {
+                    if (addMqttMessageUserProperty(propertyMap, &token, propName.length, urldecode) != 0)
+                    {
+                        result = __FAILURE__;
+                    }
+                }
             }
         }
-        STRING_TOKENIZER_destroy(token);
-    }
-    else
-    {
-        LogError("Unable to create Tokenizer object.");
-        result = __FAILURE__;
     }
     return result;
 }
@@ -1490,7 +1952,8 @@ static void mqtt_notification_callback(MQTT_MESSAGE_HANDLE msgHandle, void* call
         {
             PMQTTTRANSPORT_HANDLE_DATA transportData = (PMQTTTRANSPORT_HANDLE_DATA)callbackCtx;
 
-            IOTHUB_IDENTITY_TYPE type = retrieve_topic_type(topic_resp, STRING_c_str(transportData->topic_InputQueue));
+            size_t input_queue_prefix_length;
+            IOTHUB_IDENTITY_TYPE type = retrieve_topic_type(topic_resp, STRING_c_str(transportData->topic_InputQueue), &input_queue_prefix_length);
             if (type == IOTHUB_TYPE_DEVICE_TWIN)
             {
                 size_t request_id;
@@ -1503,6 +1966,7 @@ static void mqtt_notification_callback(MQTT_MESSAGE_HANDLE msgHandle, void* call
                 else
                 {
                     const APP_PAYLOAD* payload = mqttmessage_getApplicationMsg(msgHandle);
+                    report_statistic(transportData, TRANSPORT_STATISTIC_BYTES_RECEIVED, NULL, payload->length);
                     if (notification_msg)
                     {
                         transportData->transport_callbacks.twin_retrieve_prop_complete_cb(DEVICE_TWIN_UPDATE_PARTIAL, payload->message, payload->length, transportData->transport_ctx);
@@ -1530,7 +1994,7 @@ static void mqtt_notification_callback(MQTT_MESSAGE_HANDLE msgHandle, void* call
                                     else
                                     {
                                         // This is a on-demand get twin request.
-                                        msg_entry->userCallback(DEVICE_TWIN_UPDATE_COMPLETE, payload->message, payload->length, msg_entry->userContext);
+                                        complete_get_twin_request(msg_entry, payload->message, payload->length);
                                     }
                                 }
                                 else
@@ -1551,10 +2015,11 @@ static void mqtt_notification_callback(MQTT_MESSAGE_HANDLE msgHandle, void* call
             }
             else if (type == IOTHUB_TYPE_DEVICE_METHODS)
             {
-                STRING_HANDLE method_name = STRING_new();
-                if (method_name == NULL)
+                TOPIC_SLICE method_name;
+                TOPIC_SLICE request_id;
+                if (retrieve_device_method_rid_info(topic_resp, &method_name, &request_id) != 0)
                 {
-                    LogError("Failure: allocating method_name string value");
+                    LogError("Failure: retrieve device topic info");
                 }
                 else
                 {
@@ -1565,15 +2030,18 @@ static void mqtt_notification_callback(MQTT_MESSAGE_HANDLE msgHandle, void* call
                     }
                     else
                     {
-                        dev_method_info->request_id = STRING_new();
+                        char method_name_buffer[TOPIC_VALUE_BUFFER_SIZE];
+                        char* method_name_value;
+                        // The request id is kept until the method response goes out, the method name only for the callback.
+                        dev_method_info->request_id = STRING_construct_n(request_id.value, request_id.length);
                         if (dev_method_info->request_id == NULL)
                         {
                             LogError("Failure constructing request_id string");
                             free(dev_method_info);
                         }
-                        else if (retrieve_device_method_rid_info(topic_resp, method_name, dev_method_info->request_id) != 0)
+                        else if ((method_name_value = copy_topic_slice(&method_name, method_name_buffer, sizeof(method_name_buffer))) == NULL)
                         {
-                            LogError("Failure: retrieve device topic info");
+                            LogError("Failure copying method_name value");
                             STRING_delete(dev_method_info->request_id);
                             free(dev_method_info);
                         }
@@ -1581,28 +2049,37 @@ static void mqtt_notification_callback(MQTT_MESSAGE_HANDLE msgHandle, void* call
                         {
                             /* CodesSRS_IOTHUB_MQTT_TRANSPORT_07_053: [ If type is IOTHUB_TYPE_DEVICE_METHODS, then on success mqtt_notification_callback shall call IoTHubClientCore_LL_DeviceMethodComplete. ] */
                             const APP_PAYLOAD* payload = mqttmessage_getApplicationMsg(msgHandle);
-                            if (transportData->transport_callbacks.method_complete_cb(STRING_c_str(method_name), payload->message, payload->length, (void*)dev_method_info, transportData->transport_ctx) != 0)
+                            report_statistic(transportData, TRANSPORT_STATISTIC_BYTES_RECEIVED, NULL, payload->length);
+                            if (transportData->transport_callbacks.method_complete_cb(method_name_value, payload->message, payload->length, (void*)dev_method_info, transportData->transport_ctx) != 0)
                             {
                                 LogError("Failure: IoTHubClientCore_LL_DeviceMethodComplete");
                                 STRING_delete(dev_method_info->request_id);
                                 free(dev_method_info);
                             }
+                            free_topic_slice_copy(method_name_value, method_name_buffer);
                         }
                     }
-                    STRING_delete(method_name);
                 }
             }
             else
             {
                 const APP_PAYLOAD* appPayload = mqttmessage_getApplicationMsg(msgHandle);
-                IOTHUB_MESSAGE_HANDLE IoTHubMessage = IoTHubMessage_CreateFromByteArray(appPayload->message, appPayload->length);
-                if (IoTHubMessage == NULL)
+                IOTHUB_MESSAGE_HANDLE IoTHubMessage;
+                report_statistic(transportData, TRANSPORT_STATISTIC_BYTES_RECEIVED, NULL, appPayload->length);
+                // Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_41_012: [ If the client takes cloud-to-device payloads in chunks, the payload shall be handed to msg_chunk_cb from the receive buffer as one slice instead of being copied into an IOTHUB_MESSAGE_HANDLE. ]
+                if (type != IOTHUB_TYPE_EVENT_QUEUE &&
+                    transportData->transport_callbacks.msg_chunk_cb != NULL &&
+                    transportData->transport_callbacks.msg_chunk_cb(appPayload->message, appPayload->length, 0, appPayload->length, transportData->transport_ctx))
+                {
+                    // the payload was delivered; QoS 1 messages are acknowledged by the MQTT client
+                }
+                else if ((IoTHubMessage = IoTHubMessage_CreateFromByteArray(appPayload->message, appPayload->length)) == NULL)
                 {
                     LogError("Failure: IotHub Message creation has failed.");
                 }
                 else
                 {
-                    if ((type == IOTHUB_TYPE_EVENT_QUEUE) && (addInputNamePropertyToMessage(IoTHubMessage, topic_resp) != 0))
+                    if ((type == IOTHUB_TYPE_EVENT_QUEUE) && (addInputNamePropertyToMessage(IoTHubMessage, topic_resp, input_queue_prefix_length) != 0))
                     {
                         LogError("failure adding input name to property.");
                     }
@@ -1652,6 +2129,30 @@ static void mqtt_notification_callback(MQTT_MESSAGE_HANDLE msgHandle, void* call
     }
 }
 
+static void resume_persistent_session(PMQTTTRANSPORT_HANDLE_DATA transport_data, bool session_present)
+{
+    if (session_present)
+    {
+        // Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_41_010: [ When the CONNACK of a persistent session reports the session as present, the topics already subscribed in that session shall not be subscribed again. ]
+        transport_data->topics_ToSubscribe &= ~transport_data->topics_Subscribed;
+        if (transport_data->topics_ToSubscribe == UNSUBSCRIBE_FROM_TOPIC)
+        {
+            // Nothing left to subscribe, carry on as if the SUBACK had arrived
+            transport_data->currPacketState = SUBACK_TYPE;
+        }
+    }
+    else
+    {
+        // The broker started a new session, every subscription has to be sent again
+        transport_data->topics_Subscribed = UNSUBSCRIBE_FROM_TOPIC;
+    }
+
+    if (transport_data->telemetry_inflight_count > 0)
+    {
+        transport_data->telemetry_resend_pending = true;
+    }
+}
+
 static void mqtt_operation_complete_callback(MQTT_CLIENT_HANDLE handle, MQTT_CLIENT_EVENT_RESULT actionResult, const void* msgInfo, void* callbackCtx)
 {
     (void)handle;
@@ -1667,20 +2168,16 @@ static void mqtt_operation_complete_callback(MQTT_CLIENT_HANDLE handle, MQTT_CLI
                 const PUBLISH_ACK* puback = (const PUBLISH_ACK*)msgInfo;
                 if (puback != NULL)
                 {
-                    PDLIST_ENTRY currentListEntry = transport_data->telemetry_waitingForAck.Flink;
-                    while (currentListEntry != &transport_data->telemetry_waitingForAck)
-                    {
-                        MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry = containingRecord(currentListEntry, MQTT_MESSAGE_DETAILS_LIST, entry);
-                        DLIST_ENTRY saveListEntry;
-                        saveListEntry.Flink = currentListEntry->Flink;
+                    IOTHUB_CLIENT_TRACE(IOTHUB_CLIENT_TRACE_MQTT_PUBACK, transport_data, puback->packetId, 0);
 
-                        if (puback->packetId == mqttMsgEntry->packet_id)
-                        {
-                            (void)DList_RemoveEntryList(currentListEntry); //First remove the item from Waiting for Ack List.
-                            sendMsgComplete(mqttMsgEntry->iotHubMessageEntry, transport_data, IOTHUB_CLIENT_CONFIRMATION_OK);
-                            free(mqttMsgEntry);
-                        }
-                        currentListEntry = saveListEntry.Flink;
+                    /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_41_007: [ The acknowledged telemetry message shall be found by its packet id through an index, without walking the messages waiting for their PUBACK. ] */
+                    MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry = find_telemetry_waiting_for_ack(transport_data, puback->packetId);
+                    if (mqttMsgEntry != NULL)
+                    {
+                        /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_41_003: [ A telemetry message shall leave the in-flight window once it is acknowledged, fails or times out. ] */
+                        remove_telemetry_waiting_for_ack(transport_data, mqttMsgEntry); //First remove the item from Waiting for Ack List.
+                        sendMsgComplete(mqttMsgEntry->iotHubMessageEntry, transport_data, IOTHUB_CLIENT_CONFIRMATION_OK);
+                        free(mqttMsgEntry);
                     }
                 }
                 else
@@ -1694,6 +2191,8 @@ static void mqtt_operation_complete_callback(MQTT_CLIENT_HANDLE handle, MQTT_CLI
                 const CONNECT_ACK* connack = (const CONNECT_ACK*)msgInfo;
                 if (connack != NULL)
                 {
+                    IOTHUB_CLIENT_TRACE(IOTHUB_CLIENT_TRACE_MQTT_CONNACK, transport_data, connack->returnCode, 0);
+
                     if (connack->returnCode == CONNECTION_ACCEPTED)
                     {
                         // The connect packet has been acked
@@ -1704,12 +2203,19 @@ static void mqtt_operation_complete_callback(MQTT_CLIENT_HANDLE handle, MQTT_CLI
                         // Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_09_008: [ Upon successful connection the retry control shall be reset using retry_control_reset() ]
                         retry_control_reset(transport_data->retry_control_handle);
 
+                        if (transport_data->persistent_session)
+                        {
+                            resume_persistent_session(transport_data, connack->isSessionPresent);
+                        }
+
                         transport_data->transport_callbacks.connection_status_cb(IOTHUB_CLIENT_CONNECTION_AUTHENTICATED, IOTHUB_CLIENT_CONNECTION_OK, transport_data->transport_ctx);
                     }
                     else
                     {
                         if (connack->returnCode == CONN_REFUSED_SERVER_UNAVAIL)
                         {
+                            // Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_41_014: [ If the CONNACK reports the server as unavailable, the next reconnection shall wait at least THROTTLED_RETRY_AFTER_IN_SECONDS, set with retry_control_set_retry_after() ]
+                            (void)retry_control_set_retry_after(transport_data->retry_control_handle, THROTTLED_RETRY_AFTER_IN_SECONDS);
                             transport_data->transport_callbacks.connection_status_cb(IOTHUB_CLIENT_CONNECTION_UNAUTHENTICATED, IOTHUB_CLIENT_CONNECTION_DEVICE_DISABLED, transport_data->transport_ctx);
                         }
                         else if (connack->returnCode == CONN_REFUSED_BAD_USERNAME_PASSWORD || connack->returnCode == CONN_REFUSED_ID_REJECTED)
@@ -1750,6 +2256,7 @@ static void mqtt_operation_complete_callback(MQTT_CLIENT_HANDLE handle, MQTT_CLI
                         }
                     }
                     // The subscribed packet has been acked
+                    IOTHUB_CLIENT_STARTUP_MARK(IOTHUB_CLIENT_STARTUP_SUBSCRIBED);
                     transport_data->currPacketState = SUBACK_TYPE;
 
                     // Is this a twin message
@@ -1773,6 +2280,7 @@ static void mqtt_operation_complete_callback(MQTT_CLIENT_HANDLE handle, MQTT_CLI
             case MQTT_CLIENT_ON_DISCONNECT:
             {
                 // Close the client so we can reconnect again
+                IOTHUB_CLIENT_TRACE(IOTHUB_CLIENT_TRACE_MQTT_DISCONNECT, transport_data, 0, 0);
                 transport_data->mqttClientStatus = MQTT_CLIENT_STATUS_NOT_CONNECTED;
                 break;
             }
@@ -1793,8 +2301,7 @@ static void ResetConnectionIfNecessary(PMQTTTRANSPORT_HANDLE_DATA transport_data
 {
     if (transport_data->xioTransport != NULL && transport_data->conn_attempted)
     {
-        OPTIONHANDLER_HANDLE options = xio_retrieveoptions(transport_data->xioTransport);
-        set_saved_tls_options(transport_data, options);
+        save_tls_options(transport_data);
 
         xio_destroy(transport_data->xioTransport);
         transport_data->xioTransport = NULL;
@@ -1816,13 +2323,13 @@ static void DisconnectFromClient(PMQTTTRANSPORT_HANDLE_DATA transport_data)
     {
         if (!transport_data->isDestroyCalled)
         {
-            OPTIONHANDLER_HANDLE options = xio_retrieveoptions(transport_data->xioTransport);
-            set_saved_tls_options(transport_data, options);
+            save_tls_options(transport_data);
         }
         // Ensure the disconnect message is sent
         if (transport_data->mqttClientStatus == MQTT_CLIENT_STATUS_CONNECTED)
         {
             transport_data->disconnect_recv_flag = 0;
+            IOTHUB_CLIENT_TRACE(IOTHUB_CLIENT_TRACE_MQTT_DISCONNECT, transport_data, 0, 0);
             (void)mqtt_client_disconnect(transport_data->mqttClient, mqtt_disconnect_cb, &transport_data->disconnect_recv_flag);
             size_t disconnect_ctr = 0;
             do
@@ -1841,6 +2348,60 @@ static void DisconnectFromClient(PMQTTTRANSPORT_HANDLE_DATA transport_data)
     }
 }
 
+static void reset_adaptive_keep_alive(PMQTTTRANSPORT_HANDLE_DATA transport_data)
+{
+    transport_data->keep_alive_good = transport_data->keepAliveValue;
+    transport_data->keep_alive_ceiling = 0;
+    transport_data->keep_alive_next = 0;
+    transport_data->keep_alive_confirmed = false;
+}
+
+// Next keepalive to try: halfway to the interval known to drop, or half as long again while none did
+static uint16_t get_next_keep_alive_probe(PMQTTTRANSPORT_HANDLE_DATA transport_data)
+{
+    size_t good = transport_data->keep_alive_good;
+    size_t next = (transport_data->keep_alive_ceiling != 0) ? good + (transport_data->keep_alive_ceiling - good) / 2 : good + good / 2 + 1;
+
+    if (next > transport_data->keep_alive_adaptive_max)
+    {
+        next = transport_data->keep_alive_adaptive_max;
+    }
+    return (uint16_t)((next > good) ? next : 0);
+}
+
+static void update_adaptive_keep_alive(PMQTTTRANSPORT_HANDLE_DATA transport_data)
+{
+    tickcounter_ms_t current_ms;
+
+    /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_41_022: [ When `mqtt_adaptive_keep_alive_max` is set and the connection has lasted KEEP_ALIVE_PROBE_INTERVALS keepalive intervals, its keepalive shall be kept as good and the next connect shall try a longer one, halfway to the shortest keepalive known to drop and no longer than `mqtt_adaptive_keep_alive_max`. ] */
+    if ((transport_data->keep_alive_adaptive_max != 0) &&
+        !transport_data->keep_alive_confirmed &&
+        (transport_data->mqttClientStatus == MQTT_CLIENT_STATUS_CONNECTED) &&
+        (tickcounter_get_current_ms(transport_data->msgTickCounter, &current_ms) == 0) &&
+        ((current_ms - transport_data->mqtt_connect_time) / 1000 >= (tickcounter_ms_t)transport_data->keepAliveValue * KEEP_ALIVE_PROBE_INTERVALS))
+    {
+        transport_data->keep_alive_confirmed = true;
+        if (transport_data->keepAliveValue > transport_data->keep_alive_good)
+        {
+            transport_data->keep_alive_good = transport_data->keepAliveValue;
+        }
+        transport_data->keep_alive_next = get_next_keep_alive_probe(transport_data);
+    }
+}
+
+static void on_keep_alive_probe_dropped(PMQTTTRANSPORT_HANDLE_DATA transport_data)
+{
+    /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_41_023: [ If a connection trying a keepalive longer than the good one drops on a missing ping response or a communication error before it is kept, that keepalive shall be known to drop and the next connect shall go back to the good one. ] */
+    if ((transport_data->keep_alive_adaptive_max != 0) &&
+        !transport_data->keep_alive_confirmed &&
+        (transport_data->keepAliveValue > transport_data->keep_alive_good))
+    {
+        LogInfo("Connection dropped with a keepalive of %u seconds, going back to %u seconds", (unsigned int)transport_data->keepAliveValue, (unsigned int)transport_data->keep_alive_good);
+        transport_data->keep_alive_ceiling = transport_data->keepAliveValue;
+        transport_data->keep_alive_next = transport_data->keep_alive_good;
+    }
+}
+
 static void mqtt_error_callback(MQTT_CLIENT_HANDLE handle, MQTT_CLIENT_EVENT_ERROR error, void* callbackCtx)
 {
     (void)handle;
@@ -1856,12 +2417,14 @@ static void mqtt_error_callback(MQTT_CLIENT_HANDLE handle, MQTT_CLIENT_EVENT_ERR
             }
             case MQTT_CLIENT_COMMUNICATION_ERROR:
             {
+                on_keep_alive_probe_dropped(transport_data);
                 transport_data->transport_callbacks.connection_status_cb(IOTHUB_CLIENT_CONNECTION_UNAUTHENTICATED, IOTHUB_CLIENT_CONNECTION_COMMUNICATION_ERROR, transport_data->transport_ctx);
                 break;
             }
             case MQTT_CLIENT_NO_PING_RESPONSE:
             {
                 LogError("Mqtt Ping Response was not encountered.  Reconnecting device...");
+                on_keep_alive_probe_dropped(transport_data);
                 break;
             }
             case MQTT_CLIENT_PARSE_ERROR:
@@ -1908,14 +2471,49 @@ static void mqtt_error_callback(MQTT_CLIENT_HANDLE handle, MQTT_CLIENT_EVENT_ERR
     }
 }
 
+static bool is_subscribe_window_open(PMQTTTRANSPORT_HANDLE_DATA transport_data)
+{
+    bool result;
+    tickcounter_ms_t current_ms;
+
+    if (transport_data->subscribe_coalesce_window == 0)
+    {
+        result = false;
+    }
+    else if (tickcounter_get_current_ms(transport_data->msgTickCounter, &current_ms) != 0)
+    {
+        LogError("Failure: tickcounter_get_current_ms failed, subscribing without waiting for more topics.");
+        result = false;
+    }
+    else if (!transport_data->subscribe_window_started)
+    {
+        transport_data->subscribe_window_started = true;
+        transport_data->subscribe_window_start = current_ms;
+        result = true;
+    }
+    else
+    {
+        result = ((current_ms - transport_data->subscribe_window_start) < transport_data->subscribe_coalesce_window);
+    }
+
+    return result;
+}
+
 static void SubscribeToMqttProtocol(PMQTTTRANSPORT_HANDLE_DATA transport_data)
 {
-    if (transport_data->topics_ToSubscribe != UNSUBSCRIBE_FROM_TOPIC)
+    /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_41_018: [ While `mqtt_subscribe_coalesce_window` ms have not passed since IoTHubTransport_MQTT_Common_DoWork first found topics to subscribe, it shall keep them waiting, so the topics requested meanwhile go in the same SUBSCRIBE. ] */
+    if (transport_data->topics_ToSubscribe != UNSUBSCRIBE_FROM_TOPIC && is_subscribe_window_open(transport_data))
+    {
+        // currPacketState is kept, so this runs again on the next DoWork
+    }
+    else if (transport_data->topics_ToSubscribe != UNSUBSCRIBE_FROM_TOPIC)
     {
         uint32_t topic_subscription = 0;
         size_t subscribe_count = 0;
         uint16_t packet_id = get_next_packet_id(transport_data);
         SUBSCRIBE_PAYLOAD subscribe[SUBSCRIBE_TOPIC_COUNT];
+
+        transport_data->subscribe_window_started = false;
         if ((transport_data->topic_MqttMessage != NULL) && (SUBSCRIBE_TELEMETRY_TOPIC & transport_data->topics_ToSubscribe))
         {
             subscribe[subscribe_count].subscribeTopic = STRING_c_str(transport_data->topic_MqttMessage);
@@ -1964,7 +2562,9 @@ static void SubscribeToMqttProtocol(PMQTTTRANSPORT_HANDLE_DATA transport_data)
             else
             {
                 /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_018: [On success IoTHubTransport_MQTT_Common_Subscribe shall return 0.] */
+                IOTHUB_CLIENT_STARTUP_MARK(IOTHUB_CLIENT_STARTUP_SUBSCRIBE_SENT);
                 transport_data->topics_ToSubscribe &= ~topic_subscription;
+                transport_data->topics_Subscribed |= topic_subscription;
                 transport_data->currPacketState = SUBSCRIBE_TYPE;
             }
         }
@@ -2025,6 +2625,8 @@ static void process_queued_ack_messages(PMQTTTRANSPORT_HANDLE_DATA transport_dat
 {
     PDLIST_ENTRY current_entry = transport_data->telemetry_waitingForAck.Flink;
     tickcounter_ms_t current_ms;
+    // Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_41_011: [ When a persistent session is resumed, the telemetry messages still waiting for their PUBACK shall be published again with their original packet ids as soon as publishing resumes, without waiting for the resend timeout. ]
+    bool resend_now = transport_data->telemetry_resend_pending && (transport_data->currPacketState == PUBLISH_TYPE);
     (void)tickcounter_get_current_ms(transport_data->msgTickCounter, &current_ms);
     while (current_entry != &transport_data->telemetry_waitingForAck)
     {
@@ -2032,12 +2634,12 @@ static void process_queued_ack_messages(PMQTTTRANSPORT_HANDLE_DATA transport_dat
         DLIST_ENTRY nextListEntry;
         nextListEntry.Flink = current_entry->Flink;
 
-        if (((current_ms - msg_detail_entry->msgPublishTime) / 1000) > RESEND_TIMEOUT_VALUE_MIN)
+        if (resend_now || ((current_ms - msg_detail_entry->msgPublishTime) / 1000) > RESEND_TIMEOUT_VALUE_MIN)
         {
             if (msg_detail_entry->retryCount >= MAX_SEND_RECOUNT_LIMIT)
             {
                 sendMsgComplete(msg_detail_entry->iotHubMessageEntry, transport_data, IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT);
-                (void)DList_RemoveEntryList(current_entry);
+                remove_telemetry_waiting_for_ack(transport_data, msg_detail_entry);
                 free(msg_detail_entry);
 
                 DisconnectFromClient(transport_data);
@@ -2052,14 +2654,14 @@ static void process_queued_ack_messages(PMQTTTRANSPORT_HANDLE_DATA transport_dat
                     const unsigned char* messagePayload = NULL;
                     if (!RetrieveMessagePayload(msg_detail_entry->iotHubMessageEntry->messageHandle, &messagePayload, &messageLength))
                     {
-                        (void)DList_RemoveEntryList(current_entry);
+                        remove_telemetry_waiting_for_ack(transport_data, msg_detail_entry);
                         sendMsgComplete(msg_detail_entry->iotHubMessageEntry, transport_data, IOTHUB_CLIENT_CONFIRMATION_ERROR);
                     }
                     else
                     {
-                        if (publish_mqtt_telemetry_msg(transport_data, msg_detail_entry, messagePayload, messageLength) != 0)
+                        if (publish_mqtt_telemetry_msg(transport_data, msg_detail_entry, DELIVER_AT_LEAST_ONCE, messagePayload, messageLength) != 0)
                         {
-                            (void)DList_RemoveEntryList(current_entry);
+                            remove_telemetry_waiting_for_ack(transport_data, msg_detail_entry);
                             sendMsgComplete(msg_detail_entry->iotHubMessageEntry, transport_data, IOTHUB_CLIENT_CONFIRMATION_ERROR);
                             free(msg_detail_entry);
                         }
@@ -2074,6 +2676,11 @@ static void process_queued_ack_messages(PMQTTTRANSPORT_HANDLE_DATA transport_dat
         }
         current_entry = nextListEntry.Flink;
     }
+
+    if (resend_now)
+    {
+        transport_data->telemetry_resend_pending = false;
+    }
 }
 
 static int GetTransportProviderIfNecessary(PMQTTTRANSPORT_HANDLE_DATA transport_data)
@@ -2102,6 +2709,14 @@ static int GetTransportProviderIfNecessary(PMQTTTRANSPORT_HANDLE_DATA transport_
         else
         {
             transport_data->conn_attempted = true;
+
+            /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_41_015: [ When `tls_session_resumption` is on, every new xio shall get OPTION_TLS_SESSION_RESUMPTION with xio_setoption before the saved TLS options are fed to it; a failure shall be logged and ignored. ] */
+            if (transport_data->tls_session_resumption &&
+                xio_setoption(transport_data->xioTransport, OPTION_TLS_SESSION_RESUMPTION, &transport_data->tls_session_resumption) != 0)
+            {
+                LogInfo("The TLS layer does not support session resumption, reconnects will run a full handshake.");
+            }
+
             if (transport_data->saved_tls_options != NULL)
             {
                 if (OptionHandler_FeedOptions(transport_data->saved_tls_options, transport_data->xioTransport) != OPTIONHANDLER_OK)
@@ -2111,8 +2726,7 @@ static int GetTransportProviderIfNecessary(PMQTTTRANSPORT_HANDLE_DATA transport_
                 }
                 else
                 {
-                    // The tlsio has the options, so our copy can be deleted
-                    set_saved_tls_options(transport_data, NULL);
+                    // The tlsio has the options; our copy stays for the next reconnect
                     result = 0;
                 }
             }
@@ -2251,6 +2865,12 @@ static int SendMqttConnectMsg(PMQTTTRANSPORT_HANDLE_DATA transport_data)
             {
                 options.password = sasToken;
             }
+            if (transport_data->keep_alive_next != 0)
+            {
+                transport_data->keepAliveValue = transport_data->keep_alive_next;
+                transport_data->keep_alive_next = 0;
+            }
+            transport_data->keep_alive_confirmed = false;
             options.keepAliveInterval = transport_data->keepAliveValue;
             options.useCleanSession = false;
             options.qualityOfServiceValue = DELIVER_AT_LEAST_ONCE;
@@ -2299,17 +2919,27 @@ static int InitializeConnection(PMQTTTRANSPORT_HANDLE_DATA transport_data)
         if (transport_data->mqttClientStatus == MQTT_CLIENT_STATUS_NOT_CONNECTED && transport_data->isRecoverableError)
         {
             // Note: in case retry_control_should_retry fails, the reconnection shall be attempted anyway (defaulting to policy IOTHUB_CLIENT_RETRY_IMMEDIATE).
-            if(retry_control_should_retry(transport_data->retry_control_handle, &retry_action) != 0 || retry_action == RETRY_ACTION_RETRY_NOW)
+            if (transport_data->isWaitingConnectAdmission || retry_control_should_retry(transport_data->retry_control_handle, &retry_action) != 0 || retry_action == RETRY_ACTION_RETRY_NOW)
             {
-                if (tickcounter_get_current_ms(transport_data->msgTickCounter, &transport_data->connectTick) != 0)
+                // Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_41_028: [ If connect admission control is started and has no token, IoTHubTransport_MQTT_Common_DoWork shall not connect, and shall connect on a later call without asking the retry policy again once a token is available. ]
+                if (!IOTHUB_CLIENT_CONNECT_ADMITTED())
+                {
+                    transport_data->isWaitingConnectAdmission = true;
+                    result = 0;
+                }
+                else if (tickcounter_get_current_ms(transport_data->msgTickCounter, &transport_data->connectTick) != 0)
                 {
+                    transport_data->isWaitingConnectAdmission = false;
                     transport_data->connectFailCount++;
                     result = __FAILURE__;
                 }
                 else
                 {
+                    transport_data->isWaitingConnectAdmission = false;
                     ResetConnectionIfNecessary(transport_data);
 
+                    /*opening the IO resolves the name, connects and runs the TLS handshake; CONNACK ends it*/
+                    IOTHUB_CLIENT_STARTUP_MARK(IOTHUB_CLIENT_STARTUP_CONNECT_STARTED);
                     if (SendMqttConnectMsg(transport_data) != 0)
                     {
                         transport_data->connectFailCount++;
@@ -2317,6 +2947,7 @@ static int InitializeConnection(PMQTTTRANSPORT_HANDLE_DATA transport_data)
                     }
                     else
                     {
+                        IOTHUB_CLIENT_TRACE(IOTHUB_CLIENT_TRACE_MQTT_CONNECT, transport_data, 0, 0);
                         transport_data->mqttClientStatus = MQTT_CLIENT_STATUS_CONNECTING;
                         transport_data->connectFailCount = 0;
                         result = 0;
@@ -2451,6 +3082,8 @@ static PMQTTTRANSPORT_HANDLE_DATA InitializeTransportHandleData(const IOTHUB_CLI
     else
     {
         memset(state, 0, sizeof(MQTTTRANSPORT_HANDLE_DATA));
+        state->telemetry_ack_index = state->telemetry_ack_index_inline;
+        state->telemetry_ack_index_size = TELEMETRY_ACK_INDEX_INITIAL_SIZE;
         if ((state->msgTickCounter = tickcounter_create()) == NULL)
         {
             LogError("Invalid Argument: iotHubName is empty");
@@ -2541,6 +3174,7 @@ static PMQTTTRANSPORT_HANDLE_DATA InitializeTransportHandleData(const IOTHUB_CLI
 
                         state->isDestroyCalled = false;
                         state->isRetryExpiredCallbackSet = false;
+                        state->isWaitingConnectAdmission = false;
                         state->isRegistered = false;
                         state->device_twin_get_sent = false;
                         state->xioTransport = NULL;
@@ -2642,6 +3276,7 @@ TRANSPORT_LL_HANDLE IoTHubTransport_MQTT_Common_Create(const IOTHUBTRANSPORT_CON
 
             result->transport_ctx = ctx;
             memcpy(&result->transport_callbacks, cb_info, sizeof(TRANSPORT_CALLBACKS_INFO));
+            IOTHUB_CLIENT_MEMORY_REGISTER(&result->memory_counters);
         }
     }
     /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_009: [If any error is encountered then IoTHubTransport_MQTT_Common_Create shall return NULL.] */
@@ -2664,6 +3299,8 @@ void IoTHubTransport_MQTT_Common_Destroy(TRANSPORT_LL_HANDLE handle)
         {
             PDLIST_ENTRY currentEntry = DList_RemoveHeadList(&transport_data->telemetry_waitingForAck);
             MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry = containingRecord(currentEntry, MQTT_MESSAGE_DETAILS_LIST, entry);
+            transport_data->telemetry_inflight_count--;
+            IOTHUB_CLIENT_MEMORY_REMOVE(&transport_data->memory_counters, IOTHUB_CLIENT_MEMORY_TRANSPORT, sizeof(MQTT_MESSAGE_DETAILS_LIST));
             sendMsgComplete(mqttMsgEntry->iotHubMessageEntry, transport_data, IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY);
             free(mqttMsgEntry);
         }
@@ -2678,7 +3315,7 @@ void IoTHubTransport_MQTT_Common_Destroy(TRANSPORT_LL_HANDLE handle)
             }
             else
             {
-                mqtt_device_twin->userCallback(DEVICE_TWIN_UPDATE_COMPLETE, NULL, 0, mqtt_device_twin->userContext);
+                complete_get_twin_request(mqtt_device_twin, NULL, 0);
             }
 
             destroy_device_twin_get_message(mqtt_device_twin);
@@ -2689,7 +3326,7 @@ void IoTHubTransport_MQTT_Common_Destroy(TRANSPORT_LL_HANDLE handle)
 
             MQTT_DEVICE_TWIN_ITEM* mqtt_device_twin = containingRecord(currentEntry, MQTT_DEVICE_TWIN_ITEM, entry);
 
-            mqtt_device_twin->userCallback(DEVICE_TWIN_UPDATE_COMPLETE, NULL, 0, mqtt_device_twin->userContext);
+            complete_get_twin_request(mqtt_device_twin, NULL, 0);
 
             destroy_device_twin_get_message(mqtt_device_twin);
         }
@@ -2751,6 +3388,7 @@ void IoTHubTransport_MQTT_Common_Unsubscribe_DeviceTwin(TRANSPORT_LL_HANDLE hand
         {
             /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_049: [If subscribe_state is set to IOTHUB_DEVICE_TWIN_DESIRED_STATE then IoTHubTransport_MQTT_Common_Unsubscribe_DeviceTwin shall unsubscribe from the topic_GetState to the mqtt client.] */
             transport_data->topics_ToSubscribe &= ~SUBSCRIBE_GET_REPORTED_STATE_TOPIC;
+            transport_data->topics_Subscribed &= ~SUBSCRIBE_GET_REPORTED_STATE_TOPIC;
             STRING_delete(transport_data->topic_GetState);
             transport_data->topic_GetState = NULL;
         }
@@ -2758,6 +3396,7 @@ void IoTHubTransport_MQTT_Common_Unsubscribe_DeviceTwin(TRANSPORT_LL_HANDLE hand
         {
             /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_050: [If subscribe_state is set to IOTHUB_DEVICE_TWIN_NOTIFICATION_STATE then IoTHubTransport_MQTT_Common_Unsubscribe_DeviceTwin shall unsubscribe from the topic_NotifyState to the mqtt client.] */
             transport_data->topics_ToSubscribe &= ~SUBSCRIBE_NOTIFICATION_STATE_TOPIC;
+            transport_data->topics_Subscribed &= ~SUBSCRIBE_NOTIFICATION_STATE_TOPIC;
             STRING_delete(transport_data->topic_NotifyState);
             transport_data->topic_NotifyState = NULL;
         }
@@ -2783,7 +3422,36 @@ IOTHUB_CLIENT_RESULT IoTHubTransport_MQTT_Common_GetTwinAsync(IOTHUB_DEVICE_HAND
         PMQTTTRANSPORT_HANDLE_DATA transport_data = (PMQTTTRANSPORT_HANDLE_DATA)handle;
         MQTT_DEVICE_TWIN_ITEM* mqtt_info;
 
-        if ((mqtt_info = create_device_twin_get_message(transport_data)) == NULL)
+        if ((mqtt_info = find_on_demand_get_twin_request(&transport_data->pending_get_twin_queue)) != NULL ||
+            (mqtt_info = find_on_demand_get_twin_request(&transport_data->ack_waiting_queue)) != NULL)
+        {
+            // Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_41_013: [ If an on-demand GET request is already queued or waiting for its response, the request shall share that response instead of publishing its own. ]
+            MQTT_DEVICE_TWIN_WAITER* waiter;
+
+            if ((waiter = (MQTT_DEVICE_TWIN_WAITER*)malloc(sizeof(MQTT_DEVICE_TWIN_WAITER))) == NULL)
+            {
+                LogError("Failed allocating the get twin request waiter");
+                // Codes_SRS_IOTHUB_MQTT_TRANSPORT_09_003: [ If any failure occurs, IoTHubTransport_MQTT_Common_GetTwinAsync shall return IOTHUB_CLIENT_ERROR ]
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                MQTT_DEVICE_TWIN_WAITER** last = &mqtt_info->waiters;
+
+                while (*last != NULL)
+                {
+                    last = &(*last)->next;
+                }
+
+                waiter->userCallback = completionCallback;
+                waiter->userContext = callbackContext;
+                waiter->next = NULL;
+                *last = waiter;
+
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        else if ((mqtt_info = create_device_twin_get_message(transport_data)) == NULL)
         {
             LogError("Failed creating the device twin get request message");
             // Codes_SRS_IOTHUB_MQTT_TRANSPORT_09_003: [ If any failure occurs, IoTHubTransport_MQTT_Common_GetTwinAsync shall return IOTHUB_CLIENT_ERROR ]
@@ -2881,6 +3549,7 @@ void IoTHubTransport_MQTT_Common_Unsubscribe_DeviceMethod(TRANSPORT_LL_HANDLE ha
             STRING_delete(transport_data->topic_DeviceMethods);
             transport_data->topic_DeviceMethods = NULL;
             transport_data->topics_ToSubscribe &= ~SUBSCRIBE_DEVICE_METHOD_TOPIC;
+            transport_data->topics_Subscribed &= ~SUBSCRIBE_DEVICE_METHOD_TOPIC;
         }
     }
     else
@@ -2985,6 +3654,7 @@ void IoTHubTransport_MQTT_Common_Unsubscribe(TRANSPORT_LL_HANDLE handle)
         STRING_delete(transport_data->topic_MqttMessage);
         transport_data->topic_MqttMessage = NULL;
         transport_data->topics_ToSubscribe &= ~SUBSCRIBE_TELEMETRY_TOPIC;
+        transport_data->topics_Subscribed &= ~SUBSCRIBE_TELEMETRY_TOPIC;
     }
     else
     {
@@ -3105,7 +3775,8 @@ void IoTHubTransport_MQTT_Common_DoWork(TRANSPORT_LL_HANDLE handle)
             {
                 PDLIST_ENTRY currentListEntry = transport_data->waitingToSend->Flink;
                 /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_027: [IoTHubTransport_MQTT_Common_DoWork shall inspect the "waitingToSend" DLIST passed in config structure.] */
-                while (currentListEntry != transport_data->waitingToSend)
+                /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_41_002: [ While `mqtt_max_inflight` telemetry messages wait for their PUBACK, IoTHubTransport_MQTT_Common_DoWork shall leave the rest in "waitingToSend", and publish them, oldest first, as acknowledgements free the window. ] */
+                while ((currentListEntry != transport_data->waitingToSend) && !is_telemetry_window_full(transport_data))
                 {
                     IOTHUB_MESSAGE_LIST* iothubMsgList = containingRecord(currentListEntry, IOTHUB_MESSAGE_LIST, entry);
                     DLIST_ENTRY savedFromCurrentListEntry;
@@ -3120,20 +3791,35 @@ void IoTHubTransport_MQTT_Common_DoWork(TRANSPORT_LL_HANDLE handle)
                         sendMsgComplete(iothubMsgList, transport_data, IOTHUB_CLIENT_CONFIRMATION_ERROR);
                         LogError("Failure result from IoTHubMessage_GetData");
                     }
+                    /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_41_020: [ A telemetry message sent to the `mqtt_at_most_once_output` output shall be published with DELIVER_AT_MOST_ONCE and completed with IOTHUB_CLIENT_CONFIRMATION_OK as soon as mqtt_client_publish succeeds, without waiting for a PUBACK. ] */
+                    else if (is_at_most_once_telemetry(transport_data, iothubMsgList->messageHandle))
+                    {
+                        MQTT_MESSAGE_DETAILS_LIST mqttMsgEntry;
+                        mqttMsgEntry.retryCount = 0;
+                        mqttMsgEntry.iotHubMessageEntry = iothubMsgList;
+                        mqttMsgEntry.packet_id = 0; /*QoS 0 publishes carry no packet id*/
+
+                        (void)(DList_RemoveEntryList(currentListEntry));
+                        sendMsgComplete(iothubMsgList, transport_data,
+                            (publish_mqtt_telemetry_msg(transport_data, &mqttMsgEntry, DELIVER_AT_MOST_ONCE, messagePayload, messageLength) == 0) ? IOTHUB_CLIENT_CONFIRMATION_OK : IOTHUB_CLIENT_CONFIRMATION_ERROR);
+                    }
                     else
                     {
                         /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_029: [IoTHubTransport_MQTT_Common_DoWork shall create a MQTT_MESSAGE_HANDLE and pass this to a call to mqtt_client_publish.] */
-                        MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry = (MQTT_MESSAGE_DETAILS_LIST*)malloc(sizeof(MQTT_MESSAGE_DETAILS_LIST));
-                        if (mqttMsgEntry == NULL)
+                        MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry = NULL;
+                        if (reserve_telemetry_waiting_for_ack(transport_data) != 0 ||
+                            (mqttMsgEntry = (MQTT_MESSAGE_DETAILS_LIST*)malloc(sizeof(MQTT_MESSAGE_DETAILS_LIST))) == NULL)
                         {
                             LogError("Allocation Error: Failure allocating MQTT Message Detail List.");
+                            /*leave this message and the ones after it in waitingToSend, messages are only ever taken from its head*/
+                            savedFromCurrentListEntry.Flink = transport_data->waitingToSend;
                         }
                         else
                         {
                             mqttMsgEntry->retryCount = 0;
                             mqttMsgEntry->iotHubMessageEntry = iothubMsgList;
                             mqttMsgEntry->packet_id = get_next_packet_id(transport_data);
-                            if (publish_mqtt_telemetry_msg(transport_data, mqttMsgEntry, messagePayload, messageLength) != 0)
+                            if (publish_mqtt_telemetry_msg(transport_data, mqttMsgEntry, DELIVER_AT_LEAST_ONCE, messagePayload, messageLength) != 0)
                             {
                                 (void)(DList_RemoveEntryList(currentListEntry));
                                 sendMsgComplete(iothubMsgList, transport_data, IOTHUB_CLIENT_CONFIRMATION_ERROR);
@@ -3144,7 +3830,7 @@ void IoTHubTransport_MQTT_Common_DoWork(TRANSPORT_LL_HANDLE handle)
                                 // Remove the message from the waiting queue ...
                                 (void)(DList_RemoveEntryList(currentListEntry));
                                 // and add it to the ack queue
-                                DList_InsertTailList(&(transport_data->telemetry_waitingForAck), &(mqttMsgEntry->entry));
+                                add_telemetry_waiting_for_ack(transport_data, mqttMsgEntry);
                             }
                         }
                     }
@@ -3153,6 +3839,7 @@ void IoTHubTransport_MQTT_Common_DoWork(TRANSPORT_LL_HANDLE handle)
 
                 sendPendingGetTwinRequests(transport_data);
             }
+            update_adaptive_keep_alive(transport_data);
             /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_030: [IoTHubTransport_MQTT_Common_DoWork shall call mqtt_client_dowork everytime it is called if it is connected.] */
             mqtt_client_dowork(transport_data->mqttClient);
         }
@@ -3229,6 +3916,67 @@ IOTHUB_CLIENT_RESULT IoTHubTransport_MQTT_Common_SetOption(TRANSPORT_LL_HANDLE h
             transport_data->auto_url_encode_decode = *((bool*)value);
             result = IOTHUB_CLIENT_OK;
         }
+        /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_41_001: [ If the option parameter is set to "mqtt_max_inflight" then the value shall be a size_t* bounding the telemetry messages published and waiting for their PUBACK; 0 (default) leaves it unbounded. ] */
+        else if (strcmp(OPTION_MQTT_MAX_INFLIGHT, option) == 0)
+        {
+            transport_data->max_inflight = *((const size_t*)value);
+            result = IOTHUB_CLIENT_OK;
+        }
+        /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_41_009: [ If the option parameter is set to "mqtt_persistent_session" then the value shall be a bool* that, when true, resumes the MQTT session the broker kept across reconnects instead of setting it up again; false is the default. ] */
+        else if (strcmp(OPTION_MQTT_PERSISTENT_SESSION, option) == 0)
+        {
+            transport_data->persistent_session = *((const bool*)value);
+            result = IOTHUB_CLIENT_OK;
+        }
+        /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_41_019: [ If the option parameter is set to "mqtt_subscribe_coalesce_window" then the value shall be a tickcounter_ms_t* holding the topics to subscribe for that long to send them in a single SUBSCRIBE; 0 is the default. ] */
+        else if (strcmp(OPTION_MQTT_SUBSCRIBE_COALESCE_WINDOW, option) == 0)
+        {
+            transport_data->subscribe_coalesce_window = *((const tickcounter_ms_t*)value);
+            result = IOTHUB_CLIENT_OK;
+        }
+        /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_41_024: [ If the option parameter is set to "mqtt_adaptive_keep_alive_max" then the value shall be an int* bounding the keepalive the transport learns, starting over from the "keepalive" one; 0 (default) keeps the "keepalive" one. ] */
+        else if (strcmp(OPTION_MQTT_ADAPTIVE_KEEP_ALIVE_MAX, option) == 0)
+        {
+            int* keepAliveMaxOption = (int*)value;
+            if (*keepAliveMaxOption < 0 || *keepAliveMaxOption > UINT16_MAX)
+            {
+                LogError("Invalid mqtt_adaptive_keep_alive_max %d", *keepAliveMaxOption);
+                result = IOTHUB_CLIENT_INVALID_ARG;
+            }
+            else
+            {
+                transport_data->keep_alive_adaptive_max = (uint16_t)(*keepAliveMaxOption);
+                reset_adaptive_keep_alive(transport_data);
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_41_021: [ If the option parameter is set to "mqtt_at_most_once_output" then the value shall be a const char* naming the output whose telemetry is published at most once, "" standing for the messages sent without an output name; if copying it fails IoTHubTransport_MQTT_Common_SetOption shall return IOTHUB_CLIENT_ERROR. ] */
+        else if (strcmp(OPTION_MQTT_AT_MOST_ONCE_OUTPUT, option) == 0)
+        {
+            char* output_copy;
+            if (mallocAndStrcpy_s(&output_copy, (const char*)value) != 0)
+            {
+                LogError("Failed copying the at most once output name");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                free(transport_data->at_most_once_output);
+                transport_data->at_most_once_output = output_copy;
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_41_016: [ If the option parameter is set to "tls_session_resumption" then the value shall be a bool* applied to the current xio, if any, and to every xio created after it; false is the default. ] */
+        else if (strcmp(OPTION_TLS_SESSION_RESUMPTION, option) == 0)
+        {
+            transport_data->tls_session_resumption = *((const bool*)value);
+            if (transport_data->xioTransport != NULL &&
+                xio_setoption(transport_data->xioTransport, OPTION_TLS_SESSION_RESUMPTION, value) != 0)
+            {
+                LogInfo("The TLS layer does not support session resumption, reconnects will run a full handshake.");
+            }
+            result = IOTHUB_CLIENT_OK;
+        }
         else if (strcmp(OPTION_CONNECTION_TIMEOUT, option) == 0)
         {
             int* connection_time = (int*)value;
@@ -3246,6 +3994,7 @@ IOTHUB_CLIENT_RESULT IoTHubTransport_MQTT_Common_SetOption(TRANSPORT_LL_HANDLE h
             if (*keepAliveOption != transport_data->keepAliveValue)
             {
                 transport_data->keepAliveValue = (uint16_t)(*keepAliveOption);
+                reset_adaptive_keep_alive(transport_data);
                 if (transport_data->mqttClientStatus != MQTT_CLIENT_STATUS_NOT_CONNECTED)
                 {
                     /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_038: [If the client is connected when the keepalive is set then IoTHubTransport_MQTT_Common_SetOption shall disconnect and reconnect with the specified keepalive value.] */
@@ -3351,6 +4100,7 @@ IOTHUB_CLIENT_RESULT IoTHubTransport_MQTT_Common_SetOption(TRANSPORT_LL_HANDLE h
             {
                 if (xio_setoption(transport_data->xioTransport, option, value) == 0)
                 {
+                    transport_data->saved_tls_options_current = false;
                     result = IOTHUB_CLIENT_OK;
                 }
                 else
@@ -3561,6 +4311,7 @@ void IoTHubTransport_MQTT_Common_Unsubscribe_InputQueue(TRANSPORT_LL_HANDLE hand
         STRING_delete(transport_data->topic_InputQueue);
         transport_data->topic_InputQueue = NULL;
         transport_data->topics_ToSubscribe &= ~SUBSCRIBE_INPUT_QUEUE_TOPIC;
+        transport_data->topics_Subscribed &= ~SUBSCRIBE_INPUT_QUEUE_TOPIC;
     }
     else
     {
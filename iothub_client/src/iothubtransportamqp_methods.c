@@ -42,6 +42,7 @@ typedef struct IOTHUBTRANSPORT_AMQP_METHODS_TAG
     size_t method_request_handle_count;
     bool receiver_link_disconnected;
     bool sender_link_disconnected;
+    size_t receiver_link_credit;
 } IOTHUBTRANSPORT_AMQP_METHODS;
 
 typedef enum MESSAGE_OUTCOME_TAG
@@ -194,6 +195,26 @@ void iothubtransportamqp_methods_destroy(IOTHUBTRANSPORT_AMQP_METHODS_HANDLE iot
     }
 }
 
+int iothubtransportamqp_methods_set_link_credit(IOTHUBTRANSPORT_AMQP_METHODS_HANDLE iothubtransport_amqp_methods_handle, size_t link_credit)
+{
+    int result;
+
+    /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_41_001: [ If `iothubtransport_amqp_methods_handle` is NULL, `iothubtransportamqp_methods_set_link_credit` shall fail and return a non-zero value. ]*/
+    if (iothubtransport_amqp_methods_handle == NULL)
+    {
+        LogError("NULL handle");
+        result = __FAILURE__;
+    }
+    else
+    {
+        /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_41_002: [ `iothubtransportamqp_methods_set_link_credit` shall save `link_credit` to be used by the next `iothubtransportamqp_methods_subscribe` and return 0. ]*/
+        iothubtransport_amqp_methods_handle->receiver_link_credit = link_credit;
+        result = 0;
+    }
+
+    return result;
+}
+
 static void call_methods_unsubscribed_if_needed(IOTHUBTRANSPORT_AMQP_METHODS_HANDLE amqp_methods_handle)
 {
     if (amqp_methods_handle->receiver_link_disconnected && amqp_methods_handle->sender_link_disconnected)
@@ -748,6 +769,13 @@ int iothubtransportamqp_methods_subscribe(IOTHUBTRANSPORT_AMQP_METHODS_HANDLE io
                         }
                         else
                         {
+                            /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_41_003: [ If a link credit was set, it shall be set on the receiver link by calling `link_set_max_link_credit`; if that fails, the failure shall be logged and ignored. ]*/
+                            if ((iothubtransport_amqp_methods_handle->receiver_link_credit > 0) &&
+                                (link_set_max_link_credit(iothubtransport_amqp_methods_handle->receiver_link, (uint32_t)iothubtransport_amqp_methods_handle->receiver_link_credit) != 0))
+                            {
+                                LogError("Cannot set the receiver link credit");
+                            }
+
                             /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_025: [ - `source` shall be the a source value created by calling `messaging_create_source`. ]*/
                             /* Codes_SRS_IOTHUBTRANSPORT_AMQP_METHODS_01_026: [ The address string used to create the target shall be `responses`. ]*/
                             AMQP_VALUE sender_source = messaging_create_source("responses");
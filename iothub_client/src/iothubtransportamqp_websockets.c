@@ -4,6 +4,7 @@
 #include "iothubtransportamqp_websockets.h"
 #include "azure_c_shared_utility/wsio.h"
 #include "internal/iothubtransport_amqp_common.h"
+#include "internal/iothub_client_coalescing_io.h"
 #include "azure_c_shared_utility/tlsio.h"
 #include "azure_c_shared_utility/http_proxy_io.h"
 #include "azure_c_shared_utility/platform.h"
@@ -97,7 +98,23 @@ static XIO_HANDLE getWebSocketsIOTransport(const char* fqdn, const AMQP_TRANSPOR
 
         /* Codes_SRS_IoTHubTransportAMQP_WS_09_004: [getWebSocketsIOTransport shall return the XIO_HANDLE created using xio_create().] */
         /* Codes_SRS_IOTHUBTRANSPORTAMQP_WS_01_002: [ `getIoTransportProvider` shall call `xio_create` while passing the WebSocket IO interface description to it and the WebSocket configuration as a WSIO_CONFIG structure, filled as below: ]*/
-        result = xio_create(io_interface_description, &ws_io_config);
+        if ((result = xio_create(io_interface_description, &ws_io_config)) != NULL)
+        {
+            COALESCING_IO_CONFIG coalescing_io_config;
+            XIO_HANDLE coalescing_io;
+
+            /* Codes_SRS_IOTHUBTRANSPORTAMQP_WS_41_001: [ `getIoTransportProvider` shall put the WebSocket IO under a coalescing IO, created with `xio_create`, the interface returned by `coalescing_io_get_interface_description` and a `COALESCING_IO_CONFIG` whose `underlying_io` is the WebSocket IO, and return the coalescing IO. ]*/
+            coalescing_io_config.underlying_io = result;
+            if ((coalescing_io = xio_create(coalescing_io_get_interface_description(), &coalescing_io_config)) == NULL)
+            {
+                /* Codes_SRS_IOTHUBTRANSPORTAMQP_WS_41_002: [ If the coalescing IO cannot be created, `getIoTransportProvider` shall return the WebSocket IO. ]*/
+                LogError("Cannot coalesce the writes of the WebSocket IO, each goes in a frame of its own");
+            }
+            else
+            {
+                result = coalescing_io;
+            }
+        }
     }
 
     return result;
@@ -25,6 +25,9 @@
 #include "azure_c_shared_utility/vector.h"
 #include "azure_c_shared_utility/httpheaders.h"
 #include "azure_c_shared_utility/agenttime.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+#include "azure_c_shared_utility/threadapi.h"
 
 #define IOTHUB_APP_PREFIX "iothub-app-"
 static const char* IOTHUB_MESSAGE_ID = "iothub-messageid";
@@ -55,19 +58,57 @@ static const char* IOTHUB_AUTH_HEADER_VALUE = "Authorization";
 /*forward declaration*/
 static int appendMapToJSON(STRING_HANDLE existing, const char* const* keys, const char* const* values, size_t count);
 
+typedef struct HTTP_DEVICE_WORKERS_TAG HTTP_DEVICE_WORKERS;
+static void destroy_deviceWorkers(HTTP_DEVICE_WORKERS* workers);
+
 typedef struct HTTPTRANSPORT_HANDLE_DATA_TAG
 {
     STRING_HANDLE hostName;
     HTTPAPIEX_HANDLE httpApiExHandle;
+    /*the settings below are only written by _SetOption, which never runs during _DoWork, so device workers only read them; polling state is kept per device*/
     bool doBatchedTransfers;
     unsigned int getMinimumPollingTime;
+    unsigned int getMaximumPollingTime;
     VECTOR_HANDLE perDeviceList;
+    size_t devicesPerDoWork; /*requests on httpApiExHandle are synchronous, so a DoWork lasts as long as the requests of every device it serves*/
+    size_t nextDeviceIndex;
+    size_t messagesPerPoll;
+    HTTP_DEVICE_WORKERS* deviceWorkers; /*NULL unless "http_device_workers" is greater than 1*/
+    bool connectionOptionsSet; /*an option was passed down to httpApiExHandle, which the connections of device workers could not replay*/
 
+    /*the upper layer is not thread safe, so while device workers run, calls into it go through enter_upper_layer*/
     TRANSPORT_CALLBACKS_INFO transport_callbacks;
     void* transport_ctx;
 
 }HTTPTRANSPORT_HANDLE_DATA;
 
+/*a thread serving the devices of a round next to the one calling IoTHubTransportHttp_DoWork, on its own connection*/
+typedef struct HTTP_DEVICE_WORKER_TAG
+{
+    HTTP_DEVICE_WORKERS* workers;
+    HTTPAPIEX_HANDLE httpApiExHandle;
+    THREAD_HANDLE thread;
+} HTTP_DEVICE_WORKER;
+
+struct HTTP_DEVICE_WORKERS_TAG
+{
+    HTTPTRANSPORT_HANDLE_DATA* handleData;
+    LOCK_HANDLE lock; /*guards the round and serializes the calls into the upper layer*/
+    COND_HANDLE roundStarted;
+    COND_HANDLE roundEnded;
+    HTTP_DEVICE_WORKER* workers;
+    size_t workerCount;
+    size_t threadsStarted;
+    int stop;
+
+    /*the round: the devices served by the current call to IoTHubTransportHttp_DoWork, all fields guarded by lock*/
+    size_t firstDevice;
+    size_t deviceListSize;
+    size_t devicesToServe;
+    size_t nextDevice;
+    size_t devicesServed;
+};
+
 typedef struct HTTPTRANSPORT_PERDEVICE_DATA_TAG
 {
     HTTPTRANSPORT_HANDLE_DATA* transportHandle;
@@ -78,12 +119,16 @@ typedef struct HTTPTRANSPORT_PERDEVICE_DATA_TAG
     STRING_HANDLE eventHTTPrelativePath;
     STRING_HANDLE messageHTTPrelativePath;
     HTTP_HEADERS_HANDLE eventHTTPrequestHeaders;
+    HTTP_HEADERS_HANDLE unbatchedEventHTTPrequestHeaders; /*clone of eventHTTPrequestHeaders with the octet-stream Content-Type, created by the first individual event*/
     HTTP_HEADERS_HANDLE messageHTTPrequestHeaders;
     STRING_HANDLE abandonHTTPrelativePathBegin;
     HTTPAPIEX_SAS_HANDLE sasObject;
+    HTTPAPIEX_HANDLE httpApiExHandle; /*the connection serving the device: the transport's, unless a device worker is serving it*/
     bool DoWork_PullMessage;
     time_t lastPollTime;
     bool isFirstPoll;
+    size_t emptyPollCount;
+    bool inMessageCallback; /*set while msg_cb runs under enter_upper_layer, so the dispositions it sends do not enter it again*/
 
     void* device_transport_ctx;
     PDLIST_ENTRY waitingToSend;
@@ -244,34 +289,49 @@ static int retrieve_message_properties(HTTP_HEADERS_HANDLE resp_header, IOTHUB_M
     return result;
 }
 
-static int set_system_properties(IOTHUB_MESSAGE_LIST* message, HTTP_HEADERS_HANDLE headers)
+typedef struct MESSAGE_SYSTEM_PROPERTIES_TAG
 {
-    int result;
-    const char* msgId;
-    const char* corrId;
-    const char* content_type;
+    const char* messageId;
+    const char* correlationId;
+    const char* contentType;
     const char* contentEncoding;
+} MESSAGE_SYSTEM_PROPERTIES;
+
+/*returns true if the message has at least one system property to be sent as HTTP header*/
+static bool get_system_properties(IOTHUB_MESSAGE_LIST* message, MESSAGE_SYSTEM_PROPERTIES* systemProperties)
+{
+    systemProperties->messageId = IoTHubMessage_GetMessageId(message->messageHandle);
+    systemProperties->correlationId = IoTHubMessage_GetCorrelationId(message->messageHandle);
+    systemProperties->contentType = IoTHubMessage_GetContentTypeSystemProperty(message->messageHandle);
+    systemProperties->contentEncoding = IoTHubMessage_GetContentEncodingSystemProperty(message->messageHandle);
+
+    return (systemProperties->messageId != NULL) || (systemProperties->correlationId != NULL) ||
+        (systemProperties->contentType != NULL) || (systemProperties->contentEncoding != NULL);
+}
+
+static int set_system_properties(const MESSAGE_SYSTEM_PROPERTIES* systemProperties, HTTP_HEADERS_HANDLE headers)
+{
+    int result;
 
     // Add the Message Id and the Correlation Id
-    msgId = IoTHubMessage_GetMessageId(message->messageHandle);
-    if (msgId != NULL && HTTPHeaders_ReplaceHeaderNameValuePair(headers, IOTHUB_MESSAGE_ID, msgId) != HTTP_HEADERS_OK)
+    if (systemProperties->messageId != NULL && HTTPHeaders_ReplaceHeaderNameValuePair(headers, IOTHUB_MESSAGE_ID, systemProperties->messageId) != HTTP_HEADERS_OK)
     {
         LogError("unable to HTTPHeaders_ReplaceHeaderNameValuePair");
         result = __LINE__;
     }
-    else if ((corrId = IoTHubMessage_GetCorrelationId(message->messageHandle)) != NULL && HTTPHeaders_ReplaceHeaderNameValuePair(headers, IOTHUB_CORRELATION_ID, corrId) != HTTP_HEADERS_OK)
+    else if (systemProperties->correlationId != NULL && HTTPHeaders_ReplaceHeaderNameValuePair(headers, IOTHUB_CORRELATION_ID, systemProperties->correlationId) != HTTP_HEADERS_OK)
     {
         LogError("unable to HTTPHeaders_ReplaceHeaderNameValuePair");
         result = __LINE__;
     }
     // Codes_SRS_TRANSPORTMULTITHTTP_09_001: [ If the IoTHubMessage being sent contains property `content-type` it shall be added to the HTTP headers as "iothub-contenttype":"value". ]
-    else if ((content_type = IoTHubMessage_GetContentTypeSystemProperty(message->messageHandle)) != NULL && HTTPHeaders_ReplaceHeaderNameValuePair(headers, IOTHUB_CONTENT_TYPE_D2C, content_type) != HTTP_HEADERS_OK)
+    else if (systemProperties->contentType != NULL && HTTPHeaders_ReplaceHeaderNameValuePair(headers, IOTHUB_CONTENT_TYPE_D2C, systemProperties->contentType) != HTTP_HEADERS_OK)
     {
         LogError("unable to HTTPHeaders_ReplaceHeaderNameValuePair (content-type)");
         result = __LINE__;
     }
     // Codes_SRS_TRANSPORTMULTITHTTP_09_002: [ If the IoTHubMessage being sent contains property `content-encoding` it shall be added to the HTTP headers as "iothub-contentencoding":"value". ]
-    else if ((contentEncoding = IoTHubMessage_GetContentEncodingSystemProperty(message->messageHandle)) != NULL && HTTPHeaders_ReplaceHeaderNameValuePair(headers, IOTHUB_CONTENT_ENCODING_D2C, contentEncoding) != HTTP_HEADERS_OK)
+    else if (systemProperties->contentEncoding != NULL && HTTPHeaders_ReplaceHeaderNameValuePair(headers, IOTHUB_CONTENT_ENCODING_D2C, systemProperties->contentEncoding) != HTTP_HEADERS_OK)
     {
         LogError("unable to HTTPHeaders_ReplaceHeaderNameValuePair (content-encoding)");
         result = __LINE__;
@@ -283,16 +343,12 @@ static int set_system_properties(IOTHUB_MESSAGE_LIST* message, HTTP_HEADERS_HAND
     return result;
 }
 
-static bool set_message_properties(IOTHUB_MESSAGE_LIST* message, size_t* msg_size, HTTP_HEADERS_HANDLE headers, HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData)
+static bool get_message_properties(IOTHUB_MESSAGE_LIST* message, size_t* msg_size, const char*const** keys, const char*const** values, size_t* count, HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData)
 {
     bool result = true;
 
-    /*Codes_SRS_TRANSPORTMULTITHTTP_17_078: [Every message property "property":"value" shall be added to the HTTP headers as an individual header "iothub-app-property":"value".] */
     MAP_HANDLE map = IoTHubMessage_Properties(message->messageHandle);
-    const char*const* keys;
-    const char*const* values;
-    size_t count;
-    if (Map_GetInternals(map, &keys, &values, &count) != MAP_OK)
+    if (Map_GetInternals(map, keys, values, count) != MAP_OK)
     {
         /*Codes_SRS_TRANSPORTMULTITHTTP_17_079: [If any HTTP header operation fails, _DoWork shall advance to the next action.] */
         LogError("unable to Map_GetInternals");
@@ -300,10 +356,10 @@ static bool set_message_properties(IOTHUB_MESSAGE_LIST* message, size_t* msg_siz
     }
     else
     {
-        for (size_t index = 0; index < count; index++)
+        for (size_t index = 0; index < *count; index++)
         {
             /*Codes_SRS_TRANSPORTMULTITHTTP_17_074: [Every property name shall add  to the message size the length of the property name + the length of the property value + 16 bytes.] */
-            *msg_size += (strlen(values[index]) + strlen(keys[index]) + MAXIMUM_PROPERTY_OVERHEAD);
+            *msg_size += (strlen((*values)[index]) + strlen((*keys)[index]) + MAXIMUM_PROPERTY_OVERHEAD);
             if (*msg_size > MAXIMUM_MESSAGE_SIZE)
             {
                 /*Codes_SRS_TRANSPORTMULTITHTTP_17_072: [The message size shall be limited to 255KB -1 bytes.] */
@@ -313,27 +369,38 @@ static bool set_message_properties(IOTHUB_MESSAGE_LIST* message, size_t* msg_siz
                 result = false;
                 break;
             }
-            else
+        }
+    }
+    return result;
+}
+
+static bool set_message_properties(const char*const* keys, const char*const* values, size_t count, HTTP_HEADERS_HANDLE headers)
+{
+    bool result = true;
+
+    /*Codes_SRS_TRANSPORTMULTITHTTP_17_078: [Every message property "property":"value" shall be added to the HTTP headers as an individual header "iothub-app-property":"value".] */
+    for (size_t index = 0; index < count; index++)
+    {
+        STRING_HANDLE app_construct = STRING_construct_sprintf("%s%s", IOTHUB_APP_PREFIX, keys[index]);
+        if (app_construct == NULL)
+        {
+            /*Codes_SRS_TRANSPORTMULTITHTTP_17_079: [If any HTTP header operation fails, _DoWork shall advance to the next action.] */
+            LogError("Unable to construct app header");
+            result = false;
+            break;
+        }
+        else
+        {
+            if (HTTPHeaders_ReplaceHeaderNameValuePair(headers, STRING_c_str(app_construct), values[index]) != HTTP_HEADERS_OK)
             {
-                STRING_HANDLE app_construct = STRING_construct_sprintf("%s%s", IOTHUB_APP_PREFIX, keys[index]);
-                if (app_construct == NULL)
-                {
-                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_079: [If any HTTP header operation fails, _DoWork shall advance to the next action.] */
-                    LogError("Unable to construct app header");
-                    result = false;
-                    break;
-                }
-                else
-                {
-                    if (HTTPHeaders_ReplaceHeaderNameValuePair(headers, STRING_c_str(app_construct), values[index]) != HTTP_HEADERS_OK)
-                    {
-                        /*Codes_SRS_TRANSPORTMULTITHTTP_17_079: [If any HTTP header operation fails, _DoWork shall advance to the next action.] */
-                        LogError("Unable to add app properties to http header");
-                        result = false;
-                        break;
-                    }
-                    STRING_delete(app_construct);
-                }
+                /*Codes_SRS_TRANSPORTMULTITHTTP_17_079: [If any HTTP header operation fails, _DoWork shall advance to the next action.] */
+                LogError("Unable to add app properties to http header");
+                result = false;
+            }
+            STRING_delete(app_construct);
+            if (!result)
+            {
+                break;
             }
         }
     }
@@ -386,9 +453,72 @@ static void destroy_eventHTTPrequestHeaders(HTTPTRANSPORT_PERDEVICE_DATA* handle
     handleData->eventHTTPrequestHeaders = NULL;
 }
 
-static HTTP_HEADERS_RESULT addUserAgentHeaderInfo(HTTPTRANSPORT_HANDLE_DATA* transport_data, HTTP_HEADERS_HANDLE eventHTTPrequestHeaders)
+static void destroy_unbatchedEventHTTPrequestHeaders(HTTPTRANSPORT_PERDEVICE_DATA* handleData)
+{
+    if (handleData->unbatchedEventHTTPrequestHeaders != NULL)
+    {
+        HTTPHeaders_Free(handleData->unbatchedEventHTTPrequestHeaders);
+        handleData->unbatchedEventHTTPrequestHeaders = NULL;
+    }
+}
+
+static HTTP_HEADERS_HANDLE get_unbatchedEventHTTPrequestHeaders(HTTPTRANSPORT_PERDEVICE_DATA* handleData)
+{
+    if (handleData->unbatchedEventHTTPrequestHeaders == NULL)
+    {
+        HTTP_HEADERS_HANDLE headers = HTTPHeaders_Clone(handleData->eventHTTPrequestHeaders);
+        if (headers == NULL)
+        {
+            LogError("HTTPHeaders_Clone failed");
+        }
+        /*Codes_SRS_TRANSPORTMULTITHTTP_17_077: [The cloned HTTP headers shall have the HTTP header "Content-Type" set to "application/octet-stream".] */
+        else if (HTTPHeaders_ReplaceHeaderNameValuePair(headers, CONTENT_TYPE, APPLICATION_OCTET_STREAM) != HTTP_HEADERS_OK)
+        {
+            LogError("HTTPHeaders_ReplaceHeaderNameValuePair failed");
+            HTTPHeaders_Free(headers);
+        }
+        else
+        {
+            handleData->unbatchedEventHTTPrequestHeaders = headers;
+        }
+    }
+    return handleData->unbatchedEventHTTPrequestHeaders;
+}
+
+/*Codes_SRS_TRANSPORTMULTITHTTP_41_019: [ While device workers are used, every call into the upper layer made while serving a device shall be made under the lock of the device workers, so that no two devices call into it at the same time. ]*/
+static bool enter_upper_layer(HTTPTRANSPORT_HANDLE_DATA* handleData)
+{
+    bool result = false;
+
+    if (handleData->deviceWorkers != NULL)
+    {
+        if (Lock(handleData->deviceWorkers->lock) != LOCK_OK)
+        {
+            LogError("unable to Lock - - will still proceed to call the upper layer");
+        }
+        else
+        {
+            result = true;
+        }
+    }
+
+    return result;
+}
+
+static void leave_upper_layer(HTTPTRANSPORT_HANDLE_DATA* handleData, bool entered)
+{
+    if (entered)
+    {
+        (void)Unlock(handleData->deviceWorkers->lock);
+    }
+}
+
+/*Codes_SRS_TRANSPORTMULTITHTTP_41_020: [ While device workers are used, the product info shall be read from the upper layer under the lock of the device workers, unless it is read for a disposition sent from the message callback, which already holds it. ]*/
+/*deviceData is NULL when no device is being served*/
+static HTTP_HEADERS_RESULT addUserAgentHeaderInfo(HTTPTRANSPORT_HANDLE_DATA* transport_data, HTTPTRANSPORT_PERDEVICE_DATA* deviceData, HTTP_HEADERS_HANDLE eventHTTPrequestHeaders)
 {
     HTTP_HEADERS_RESULT result;
+    bool entered = ((deviceData != NULL) && deviceData->inMessageCallback) ? false : enter_upper_layer(transport_data);
     const char* product_info = transport_data->transport_callbacks.prod_info_cb(transport_data->transport_ctx);
     if (product_info == NULL)
     {
@@ -396,8 +526,10 @@ static HTTP_HEADERS_RESULT addUserAgentHeaderInfo(HTTPTRANSPORT_HANDLE_DATA* tra
     }
     else
     {
+        /*product_info belongs to the upper layer, so it is copied before leaving it*/
         result = HTTPHeaders_AddHeaderNameValuePair(eventHTTPrequestHeaders, "User-Agent", product_info);
     }
+    leave_upper_layer(transport_data, entered);
     return result;
 }
 
@@ -442,7 +574,7 @@ static bool create_eventHTTPrequestHeaders(HTTPTRANSPORT_PERDEVICE_DATA* handleD
                     (is_x509_used || (HTTPHeaders_AddHeaderNameValuePair(handleData->eventHTTPrequestHeaders, IOTHUB_AUTH_HEADER_VALUE, " ") == HTTP_HEADERS_OK)) &&
                     (HTTPHeaders_AddHeaderNameValuePair(handleData->eventHTTPrequestHeaders, "Accept", "application/json") == HTTP_HEADERS_OK) &&
                     (HTTPHeaders_AddHeaderNameValuePair(handleData->eventHTTPrequestHeaders, "Connection", "Keep-Alive") == HTTP_HEADERS_OK) &&
-                    (addUserAgentHeaderInfo(transport_data, handleData->eventHTTPrequestHeaders) == HTTP_HEADERS_OK)
+                    (addUserAgentHeaderInfo(transport_data, NULL, handleData->eventHTTPrequestHeaders) == HTTP_HEADERS_OK)
                     ))
                 {
                     /*Codes_SRS_TRANSPORTMULTITHTTP_17_022: [ If creating the event HTTP request headers fails, then IoTHubTransportHttp_Register shall fail and return NULL.] */
@@ -482,7 +614,7 @@ static bool create_messageHTTPrequestHeaders(HTTPTRANSPORT_PERDEVICE_DATA* handl
     else
     {
         if (!(
-            (addUserAgentHeaderInfo(transport_data, handleData->messageHTTPrequestHeaders) == HTTP_HEADERS_OK) &&
+            (addUserAgentHeaderInfo(transport_data, NULL, handleData->messageHTTPrequestHeaders) == HTTP_HEADERS_OK) &&
             (is_x509_used || (HTTPHeaders_AddHeaderNameValuePair(handleData->messageHTTPrequestHeaders, IOTHUB_AUTH_HEADER_VALUE, " ") == HTTP_HEADERS_OK))
             ))
         {
@@ -821,9 +953,13 @@ static IOTHUB_DEVICE_HANDLE IoTHubTransportHttp_Register(TRANSPORT_LL_HANDLE han
                 /*Codes_SRS_TRANSPORTMULTITHTTP_17_128: [ IoTHubTransportHttp_Register shall mark this device as unsubscribed. ]*/
                 result->DoWork_PullMessage = false;
                 result->isFirstPoll = true;
+                result->emptyPollCount = 0;
+                result->inMessageCallback = false;
+                result->unbatchedEventHTTPrequestHeaders = NULL;
                 result->waitingToSend = waitingToSend;
                 DList_InitializeListHead(&(result->eventConfirmations));
                 result->transportHandle = (HTTPTRANSPORT_HANDLE_DATA *)handle;
+                result->httpApiExHandle = handleData->httpApiExHandle;
             }
             else
             {
@@ -856,6 +992,7 @@ static void destroy_perDeviceData(HTTPTRANSPORT_PERDEVICE_DATA * perDeviceItem)
     destroy_eventHTTPrelativePath(perDeviceItem);
     destroy_messageHTTPrelativePath(perDeviceItem);
     destroy_eventHTTPrequestHeaders(perDeviceItem);
+    destroy_unbatchedEventHTTPrequestHeaders(perDeviceItem);
     destroy_messageHTTPrequestHeaders(perDeviceItem);
     destroy_abandonHTTPrelativePathBegin(perDeviceItem);
     destroy_SASObject(perDeviceItem);
@@ -1065,6 +1202,12 @@ static TRANSPORT_LL_HANDLE IoTHubTransportHttp_Create(const IOTHUBTRANSPORT_CONF
                 /*Codes_SRS_TRANSPORTMULTITHTTP_17_011: [ Otherwise, IoTHubTransportHttp_Create shall succeed and return a non-NULL value. ]*/
                 result->doBatchedTransfers = false;
                 result->getMinimumPollingTime = DEFAULT_GETMINIMUMPOLLINGTIME;
+                result->getMaximumPollingTime = 0;
+                result->devicesPerDoWork = 0;
+                result->messagesPerPoll = 1;
+                result->nextDeviceIndex = 0;
+                result->deviceWorkers = NULL;
+                result->connectionOptionsSet = false;
 
                 result->transport_ctx = ctx;
                 memcpy(&result->transport_callbacks, cb_info, sizeof(TRANSPORT_CALLBACKS_INFO));
@@ -1101,6 +1244,12 @@ static void IoTHubTransportHttp_Destroy(TRANSPORT_LL_HANDLE handle)
             free(perDeviceItem);
         }
 
+        /*the device workers are idle between two calls to IoTHubTransportHttp_DoWork*/
+        if (handleData->deviceWorkers != NULL)
+        {
+            destroy_deviceWorkers(handleData->deviceWorkers);
+        }
+
         destroy_hostName((HTTPTRANSPORT_HANDLE_DATA *)handle);
         destroy_httpApiExHandle((HTTPTRANSPORT_HANDLE_DATA *)handle);
         destroy_perDeviceList((HTTPTRANSPORT_HANDLE_DATA *)handle);
@@ -1320,7 +1469,8 @@ static int appendMapToJSON(STRING_HANDLE existing, const char* const* keys, cons
 
 /*makes the following string:{"body":"base64 encoding of the message content"[,"properties":{"a":"valueOfA"}]}*/
 /*return NULL if there was a failure, or a non-NULL STRING_HANDLE that contains the intended data*/
-static STRING_HANDLE make1EventJSONitem(PDLIST_ENTRY item, size_t *messageSizeContribution)
+/*when the message cannot fit in sizeBudget it is not encoded at all: NULL is returned and *messageSizeContribution is set above sizeBudget*/
+static STRING_HANDLE make1EventJSONitem(PDLIST_ENTRY item, size_t sizeBudget, size_t *messageSizeContribution)
 {
     STRING_HANDLE result; /*temp wants to contain :{"body":"base64 encoding of the message content"[,"properties":{"a":"valueOfA"}]}*/
     IOTHUB_MESSAGE_LIST* message = containingRecord(item, IOTHUB_MESSAGE_LIST, entry);
@@ -1346,6 +1496,13 @@ static STRING_HANDLE make1EventJSONitem(PDLIST_ENTRY item, size_t *messageSizeCo
                 STRING_delete(result);
                 result = NULL;
             }
+            /*Codes_SRS_TRANSPORTMULTITHTTP_41_006: [If the length of the payload + 384 already exceeds the space left in the batch, the message shall not be encoded.]*/
+            else if (size + MAXIMUM_PAYLOAD_OVERHEAD > sizeBudget)
+            {
+                *messageSizeContribution = size + MAXIMUM_PAYLOAD_OVERHEAD;
+                STRING_delete(result);
+                result = NULL;
+            }
             else
             {
                 STRING_HANDLE encoded = Base64_Encode_Bytes(source, size);
@@ -1398,6 +1555,13 @@ static STRING_HANDLE make1EventJSONitem(PDLIST_ENTRY item, size_t *messageSizeCo
                 STRING_delete(result);
                 result = NULL;
             }
+            /*Codes_SRS_TRANSPORTMULTITHTTP_41_006: [If the length of the payload + 384 already exceeds the space left in the batch, the message shall not be encoded.]*/
+            else if (strlen(source) + MAXIMUM_PAYLOAD_OVERHEAD > sizeBudget)
+            {
+                *messageSizeContribution = strlen(source) + MAXIMUM_PAYLOAD_OVERHEAD;
+                STRING_delete(result);
+                result = NULL;
+            }
             else
             {
                 STRING_HANDLE asJson = STRING_new_JSON(source);
@@ -1472,13 +1636,13 @@ static MAKE_PAYLOAD_RESULT makePayload(HTTPTRANSPORT_PERDEVICE_DATA* deviceData,
         result = MAKE_PAYLOAD_OK; /*optimistically initializing it*/
         while (keepGoing && ((actual = deviceData->waitingToSend->Flink) != deviceData->waitingToSend))
         {
-            size_t messageSize;
-            STRING_HANDLE temp = make1EventJSONitem(actual, &messageSize);
+            size_t messageSize = 0;
+            STRING_HANDLE temp = make1EventJSONitem(actual, MAXIMUM_MESSAGE_SIZE - allMessagesSize, &messageSize);
             if (isFirst)
             {
                 isFirst = false;
                 /*Codes_SRS_TRANSPORTMULTITHTTP_17_067: [If there is no valid payload, IoTHubTransportHttp_DoWork shall advance to the next activity.]*/
-                if (temp == NULL) /*first item failed to create, nothing to send*/
+                if ((temp == NULL) && (messageSize == 0)) /*first item failed to create, nothing to send*/
                 {
                     result = MAKE_PAYLOAD_ERROR;
                     STRING_delete(*payload);
@@ -1516,7 +1680,10 @@ static MAKE_PAYLOAD_RESULT makePayload(HTTPTRANSPORT_PERDEVICE_DATA* deviceData,
                             allMessagesSize += messageSize;
                         }
                     }
-                    STRING_delete(temp);
+                    if (temp != NULL) /*an item that does not fit was never encoded*/
+                    {
+                        STRING_delete(temp);
+                    }
                 }
             }
             else
@@ -1524,7 +1691,7 @@ static MAKE_PAYLOAD_RESULT makePayload(HTTPTRANSPORT_PERDEVICE_DATA* deviceData,
                 /*there is at least 1 item already in the payload*/
                 if (temp == NULL)
                 {
-                    /*there are multiple payloads encoded, the last one had an internal error, just go with those - closing the payload happens "after the loop"*/
+                    /*there are multiple payloads encoded, the last one either had an internal error or does not fit, just go with those - closing the payload happens "after the loop"*/
                     /*Codes_SRS_TRANSPORTMULTITHTTP_17_066: [If at any point during construction of the string there are errors, IoTHubTransportHttp_DoWork shall use the so far constructed string as payload.]*/
                     result = MAKE_PAYLOAD_OK;
                     keepGoing = false;
@@ -1578,6 +1745,37 @@ static void reversePutListBackIn(PDLIST_ENTRY source, PDLIST_ENTRY destination)
     DList_InitializeListHead(source);
 }
 
+static void complete_events(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData, IOTHUB_CLIENT_CONFIRMATION_RESULT confirmationResult)
+{
+    bool entered = enter_upper_layer(handleData);
+    handleData->transport_callbacks.send_complete_cb(&(deviceData->eventConfirmations), confirmationResult, deviceData->device_transport_ctx); // takes care of emptying the list too
+    leave_upper_layer(handleData, entered);
+}
+
+static void report_statistic(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData, TRANSPORT_STATISTIC statistic, IOTHUB_MESSAGE_LIST* message, size_t size)
+{
+    if (handleData->transport_callbacks.statistics_cb != NULL)
+    {
+        bool entered = enter_upper_layer(handleData);
+        handleData->transport_callbacks.statistics_cb(statistic, message, size, deviceData->device_transport_ctx);
+        leave_upper_layer(handleData, entered);
+    }
+}
+
+/*every event of a batch is published by the same request, whose size is not attributed to any one of them*/
+static void report_batch_published(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData, PDLIST_ENTRY batch, size_t size)
+{
+    if (handleData->transport_callbacks.statistics_cb != NULL)
+    {
+        PDLIST_ENTRY entry;
+        for (entry = batch->Flink; entry != batch; entry = entry->Flink)
+        {
+            report_statistic(handleData, deviceData, TRANSPORT_STATISTIC_EVENT_PUBLISHED, containingRecord(entry, IOTHUB_MESSAGE_LIST, entry), 0);
+        }
+        report_statistic(handleData, deviceData, TRANSPORT_STATISTIC_EVENT_PUBLISHED, NULL, size);
+    }
+}
+
 static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData)
 {
 
@@ -1626,7 +1824,7 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
                             unsigned int statusCode;
                             if (HTTPAPIEX_SAS_ExecuteRequest(
                                 deviceData->sasObject,
-                                handleData->httpApiExHandle,
+                                deviceData->httpApiExHandle,
                                 HTTPAPI_REQUEST_POST,
                                 STRING_c_str(deviceData->eventHTTPrelativePath),
                                 deviceData->eventHTTPrequestHeaders,
@@ -1643,10 +1841,11 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
                             }
                             else
                             {
+                                report_batch_published(handleData, deviceData, &(deviceData->eventConfirmations), STRING_length(payload));
                                 if (statusCode < 300)
                                 {
                                     /*Codes_SRS_TRANSPORTMULTITHTTP_17_070: [If HTTPAPIEX_SAS_ExecuteRequest does not fail and http status code <300 then IoTHubTransportHttp_DoWork shall call IoTHubClientCore_LL_SendComplete. Parameter PDLIST_ENTRY completed shall point to a list containing all the items batched, and parameter IOTHUB_CLIENT_CONFIRMATION_RESULT result shall be set to IOTHUB_CLIENT_CONFIRMATION_OK. The batched items shall be removed from waitingToSend.] */
-                                    handleData->transport_callbacks.send_complete_cb(&(deviceData->eventConfirmations), IOTHUB_CLIENT_CONFIRMATION_OK, deviceData->device_transport_ctx);
+                                    complete_events(handleData, deviceData, IOTHUB_CLIENT_CONFIRMATION_OK);
                                 }
                                 else
                                 {
@@ -1664,7 +1863,7 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
                 }
                 case MAKE_PAYLOAD_FIRST_ITEM_DOES_NOT_FIT:
                 {
-                    handleData->transport_callbacks.send_complete_cb(&(deviceData->eventConfirmations), IOTHUB_CLIENT_CONFIRMATION_ERROR, deviceData->device_transport_ctx); // takes care of emptying the list too
+                    complete_events(handleData, deviceData, IOTHUB_CLIENT_CONFIRMATION_ERROR); // takes care of emptying the list too
                     break;
                 }
                 case MAKE_PAYLOAD_ERROR:
@@ -1722,102 +1921,114 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
                 {
                     PDLIST_ENTRY head = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
                     DList_InsertTailList(&(deviceData->eventConfirmations), head);
-                    handleData->transport_callbacks.send_complete_cb(&(deviceData->eventConfirmations), IOTHUB_CLIENT_CONFIRMATION_ERROR, deviceData->device_transport_ctx); // takes care of emptying the list too
+                    complete_events(handleData, deviceData, IOTHUB_CLIENT_CONFIRMATION_ERROR); // takes care of emptying the list too
                 }
                 else
                 {
                     /*Codes_SRS_TRANSPORTMULTITHTTP_17_071: [If option SetBatching is false then _Dowork shall send individual event message as specced below.] */
                     /*Codes_SRS_TRANSPORTMULTITHTTP_17_076: [A clone of the event HTTP request headers shall be created.]*/
-                    HTTP_HEADERS_HANDLE clonedEventHTTPrequestHeaders = HTTPHeaders_Clone(deviceData->eventHTTPrequestHeaders);
-                    if (clonedEventHTTPrequestHeaders == NULL)
+                    /*Codes_SRS_TRANSPORTMULTITHTTP_41_007: [The clone shall be created once per device and reused by the following individual events.]*/
+                    HTTP_HEADERS_HANDLE deviceEventHTTPrequestHeaders = get_unbatchedEventHTTPrequestHeaders(deviceData);
+                    const char*const* keys;
+                    const char*const* values;
+                    size_t count;
+
+                    if (deviceEventHTTPrequestHeaders == NULL)
                     {
                         /*Codes_SRS_TRANSPORTMULTITHTTP_17_079: [If any HTTP header operation fails, _DoWork shall advance to the next action.] */
-                        LogError("HTTPHeaders_Clone failed");
                     }
-                    else
+                    // get_message_properties returning false does not necessarily mean the the function failed, it just means
+                    // the the adding of messages should not continue and should try the next time.  So you should not log if this 
+                    // returns false
+                    else if (get_message_properties(message, &messageSize, &keys, &values, &count, handleData, deviceData))
                     {
-                        /*Codes_SRS_TRANSPORTMULTITHTTP_17_077: [The cloned HTTP headers shall have the HTTP header "Content-Type" set to "application/octet-stream".] */
-                        if (HTTPHeaders_ReplaceHeaderNameValuePair(clonedEventHTTPrequestHeaders, CONTENT_TYPE, APPLICATION_OCTET_STREAM) != HTTP_HEADERS_OK)
+                        MESSAGE_SYSTEM_PROPERTIES systemProperties;
+                        HTTP_HEADERS_HANDLE requestHeaders;
+                        bool hasSystemProperties = get_system_properties(message, &systemProperties);
+
+                        /*Codes_SRS_TRANSPORTMULTITHTTP_41_008: [If the message has neither properties nor system properties, the device's event HTTP request headers shall be used as they are; otherwise they shall be cloned and the message headers added to the clone.]*/
+                        if (!hasSystemProperties && (count == 0))
+                        {
+                            requestHeaders = deviceEventHTTPrequestHeaders;
+                        }
+                        else if ((requestHeaders = HTTPHeaders_Clone(deviceEventHTTPrequestHeaders)) == NULL)
                         {
                             /*Codes_SRS_TRANSPORTMULTITHTTP_17_079: [If any HTTP header operation fails, _DoWork shall advance to the next action.] */
-                            LogError("HTTPHeaders_ReplaceHeaderNameValuePair failed");
+                            LogError("HTTPHeaders_Clone failed");
                         }
-                        else
+                        else if (!set_message_properties(keys, values, count, requestHeaders) || (set_system_properties(&systemProperties, requestHeaders) != 0))
                         {
-                            // set_message_properties returning false does not necessarily mean the the function failed, it just means
-                            // the the adding of messages should not continue and should try the next time.  So you should not log if this 
-                            // returns false
-                            if (set_message_properties(message, &messageSize, clonedEventHTTPrequestHeaders, handleData, deviceData))
-                            {
+                            /*Codes_SRS_TRANSPORTMULTITHTTP_17_079: [If any HTTP header operation fails, _DoWork shall advance to the next action.] */
+                            HTTPHeaders_Free(requestHeaders);
+                            requestHeaders = NULL;
+                        }
 
-                                if (set_system_properties(message, clonedEventHTTPrequestHeaders) != 0)
+                        if (requestHeaders != NULL)
+                        {
+                            BUFFER_HANDLE toBeSend = BUFFER_create(messageContent, originalMessageSize);
+                            if (toBeSend == NULL)
+                            {
+                                LogError("unable to BUFFER_new");
+                            }
+                            else
+                            {
+                                unsigned int statusCode = 0;
+                                HTTPAPIEX_RESULT r;
+                                if (deviceData->deviceSasToken != NULL)
                                 {
-                                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_079: [If any HTTP header operation fails, _DoWork shall advance to the next action.] */
+                                    /*Codes_SRS_TRANSPORTMULTITHTTP_03_001: [if a deviceSasToken exists, HTTPHeaders_ReplaceHeaderNameValuePair shall be invoked with "Authorization" as its second argument and STRING_c_str (deviceSasToken) as its third argument.]*/
+                                    if (HTTPHeaders_ReplaceHeaderNameValuePair(requestHeaders, IOTHUB_AUTH_HEADER_VALUE, STRING_c_str(deviceData->deviceSasToken)) != HTTP_HEADERS_OK)
+                                    {
+                                        r = HTTPAPIEX_ERROR;
+                                        /*Codes_SRS_TRANSPORTMULTITHTTP_03_002: [If the result of the invocation of HTTPHeaders_ReplaceHeaderNameValuePair is NOT HTTP_HEADERS_OK then fallthrough.]*/
+                                        LogError("Unable to replace the old SAS Token.");
+                                    }
+                                    /*Codes_SRS_TRANSPORTMULTITHTTP_03_003: [If a deviceSasToken exists, IoTHubTransportHttp_DoWork shall call HTTPAPIEX_ExecuteRequest passing the following parameters] */
+                                    else if ((r = HTTPAPIEX_ExecuteRequest(
+                                        deviceData->httpApiExHandle, HTTPAPI_REQUEST_POST, STRING_c_str(deviceData->eventHTTPrelativePath),
+                                        requestHeaders, toBeSend, &statusCode, NULL, NULL)) != HTTPAPIEX_OK)
+                                    {
+                                        LogError("Unable to HTTPAPIEX_ExecuteRequest.");
+                                    }
                                 }
                                 else
                                 {
-                                    BUFFER_HANDLE toBeSend = BUFFER_create(messageContent, originalMessageSize);
-                                    if (toBeSend == NULL)
+                                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_080: [If a deviceSasToken does not exist, IoTHubTransportHttp_DoWork shall call HTTPAPIEX_SAS_ExecuteRequest passing the following parameters] */
+                                    if ((r = HTTPAPIEX_SAS_ExecuteRequest(deviceData->sasObject, deviceData->httpApiExHandle, HTTPAPI_REQUEST_POST, STRING_c_str(deviceData->eventHTTPrelativePath), 
+                                        requestHeaders, toBeSend, &statusCode, NULL, NULL )) != HTTPAPIEX_OK)
                                     {
-                                        LogError("unable to BUFFER_new");
+                                        LogError("unable to HTTPAPIEX_SAS_ExecuteRequest");
+                                    }
+                                }
+                                if (r == HTTPAPIEX_OK)
+                                {
+                                    report_statistic(handleData, deviceData, TRANSPORT_STATISTIC_EVENT_PUBLISHED, message, originalMessageSize);
+                                    if (statusCode < 300)
+                                    {
+                                        /*Codes_SRS_TRANSPORTMULTITHTTP_17_082: [If HTTPAPIEX_SAS_ExecuteRequest does not fail and http status code <300 then IoTHubTransportHttp_DoWork shall call IoTHubClientCore_LL_SendComplete. Parameter PDLIST_ENTRY completed shall point to a list the item send, and parameter IOTHUB_CLIENT_CONFIRMATION_RESULT result shall be set to IOTHUB_CLIENT_CONFIRMATION_OK. The item shall be removed from waitingToSend.] */
+                                        PDLIST_ENTRY justSent = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
+                                        DList_InsertTailList(&(deviceData->eventConfirmations), justSent);
+                                        complete_events(handleData, deviceData, IOTHUB_CLIENT_CONFIRMATION_OK); // takes care of emptying the list too
                                     }
                                     else
                                     {
-                                        unsigned int statusCode = 0;
-                                        HTTPAPIEX_RESULT r;
-                                        if (deviceData->deviceSasToken != NULL)
-                                        {
-                                            /*Codes_SRS_TRANSPORTMULTITHTTP_03_001: [if a deviceSasToken exists, HTTPHeaders_ReplaceHeaderNameValuePair shall be invoked with "Authorization" as its second argument and STRING_c_str (deviceSasToken) as its third argument.]*/
-                                            if (HTTPHeaders_ReplaceHeaderNameValuePair(clonedEventHTTPrequestHeaders, IOTHUB_AUTH_HEADER_VALUE, STRING_c_str(deviceData->deviceSasToken)) != HTTP_HEADERS_OK)
-                                            {
-                                                r = HTTPAPIEX_ERROR;
-                                                /*Codes_SRS_TRANSPORTMULTITHTTP_03_002: [If the result of the invocation of HTTPHeaders_ReplaceHeaderNameValuePair is NOT HTTP_HEADERS_OK then fallthrough.]*/
-                                                LogError("Unable to replace the old SAS Token.");
-                                            }
-                                            /*Codes_SRS_TRANSPORTMULTITHTTP_03_003: [If a deviceSasToken exists, IoTHubTransportHttp_DoWork shall call HTTPAPIEX_ExecuteRequest passing the following parameters] */
-                                            else if ((r = HTTPAPIEX_ExecuteRequest(
-                                                handleData->httpApiExHandle, HTTPAPI_REQUEST_POST, STRING_c_str(deviceData->eventHTTPrelativePath),
-                                                clonedEventHTTPrequestHeaders, toBeSend, &statusCode, NULL, NULL)) != HTTPAPIEX_OK)
-                                            {
-                                                LogError("Unable to HTTPAPIEX_ExecuteRequest.");
-                                            }
-                                        }
-                                        else
-                                        {
-                                            /*Codes_SRS_TRANSPORTMULTITHTTP_17_080: [If a deviceSasToken does not exist, IoTHubTransportHttp_DoWork shall call HTTPAPIEX_SAS_ExecuteRequest passing the following parameters] */
-                                            if ((r = HTTPAPIEX_SAS_ExecuteRequest(deviceData->sasObject, handleData->httpApiExHandle, HTTPAPI_REQUEST_POST, STRING_c_str(deviceData->eventHTTPrelativePath), 
-                                                clonedEventHTTPrequestHeaders, toBeSend, &statusCode, NULL, NULL )) != HTTPAPIEX_OK)
-                                            {
-                                                LogError("unable to HTTPAPIEX_SAS_ExecuteRequest");
-                                            }
-                                        }
-                                        if (r == HTTPAPIEX_OK)
-                                        {
-                                            if (statusCode < 300)
-                                            {
-                                                /*Codes_SRS_TRANSPORTMULTITHTTP_17_082: [If HTTPAPIEX_SAS_ExecuteRequest does not fail and http status code <300 then IoTHubTransportHttp_DoWork shall call IoTHubClientCore_LL_SendComplete. Parameter PDLIST_ENTRY completed shall point to a list the item send, and parameter IOTHUB_CLIENT_CONFIRMATION_RESULT result shall be set to IOTHUB_CLIENT_CONFIRMATION_OK. The item shall be removed from waitingToSend.] */
-                                                PDLIST_ENTRY justSent = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
-                                                DList_InsertTailList(&(deviceData->eventConfirmations), justSent);
-                                                handleData->transport_callbacks.send_complete_cb(&(deviceData->eventConfirmations), IOTHUB_CLIENT_CONFIRMATION_OK, deviceData->device_transport_ctx); // takes care of emptying the list too
-                                            }
-                                            else
-                                            {
-                                                /*Codes_SRS_TRANSPORTMULTITHTTP_17_081: [If HTTPAPIEX_SAS_ExecuteRequest fails or the http status code >=300 then IoTHubTransportHttp_DoWork shall not do any other action (it is assumed at the next _DoWork it shall be retried).] */
-                                                LogError("unexpected HTTP status code (%u)", statusCode);
-                                            }
-                                        }
-                                        else if (r == HTTPAPIEX_RECOVERYFAILED)
-                                        {
-                                            PDLIST_ENTRY justSent = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
-                                            DList_InsertTailList(&(deviceData->eventConfirmations), justSent);
-                                            handleData->transport_callbacks.send_complete_cb(&(deviceData->eventConfirmations), IOTHUB_CLIENT_CONFIRMATION_ERROR, deviceData->device_transport_ctx); // takes care of emptying the list too
-                                        }
+                                        /*Codes_SRS_TRANSPORTMULTITHTTP_17_081: [If HTTPAPIEX_SAS_ExecuteRequest fails or the http status code >=300 then IoTHubTransportHttp_DoWork shall not do any other action (it is assumed at the next _DoWork it shall be retried).] */
+                                        LogError("unexpected HTTP status code (%u)", statusCode);
                                     }
-                                    BUFFER_delete(toBeSend);
                                 }
+                                else if (r == HTTPAPIEX_RECOVERYFAILED)
+                                {
+                                    PDLIST_ENTRY justSent = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
+                                    DList_InsertTailList(&(deviceData->eventConfirmations), justSent);
+                                    complete_events(handleData, deviceData, IOTHUB_CLIENT_CONFIRMATION_ERROR); // takes care of emptying the list too
+                                }
+                            }
+                            BUFFER_delete(toBeSend);
+                            if (requestHeaders != deviceEventHTTPrequestHeaders)
+                            {
+                                HTTPHeaders_Free(requestHeaders);
                             }
                         }
-                        HTTPHeaders_Free(clonedEventHTTPrequestHeaders);
                     }
                 }
             }
@@ -1906,7 +2117,7 @@ static bool abandonOrAcceptMessage(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTR
                 else
                 {
                     if (!(
-                        (addUserAgentHeaderInfo(handleData, abandonRequestHttpHeaders) == HTTP_HEADERS_OK) &&
+                        (addUserAgentHeaderInfo(handleData, deviceData, abandonRequestHttpHeaders) == HTTP_HEADERS_OK) &&
                         (HTTPHeaders_AddHeaderNameValuePair(abandonRequestHttpHeaders, IOTHUB_AUTH_HEADER_VALUE, " ") == HTTP_HEADERS_OK) &&
                         (HTTPHeaders_AddHeaderNameValuePair(abandonRequestHttpHeaders, "If-Match", ETag) == HTTP_HEADERS_OK)
                         ))
@@ -1932,7 +2143,7 @@ static bool abandonOrAcceptMessage(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTR
                                 result = false;
                             }
                             else if ((r = HTTPAPIEX_ExecuteRequest(
-                                handleData->httpApiExHandle,
+                                deviceData->httpApiExHandle,
                                 (action == IOTHUBMESSAGE_ABANDONED) ? HTTPAPI_REQUEST_POST : HTTPAPI_REQUEST_DELETE,                               /*-requestType: POST                                                                                                       */
                                 STRING_c_str(fullAbandonRelativePath),              /*-relativePath: abandon relative path begin (as created by _Create) + value of ETag + "/abandon?api-version=2016-11-14"   */
                                 abandonRequestHttpHeaders,                          /*- requestHttpHeadersHandle: an HTTP headers instance containing the following                                            */
@@ -1951,7 +2162,7 @@ static bool abandonOrAcceptMessage(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTR
                         }
                         else if ((r = HTTPAPIEX_SAS_ExecuteRequest(
                             deviceData->sasObject,
-                            handleData->httpApiExHandle,
+                            deviceData->httpApiExHandle,
                             (action == IOTHUBMESSAGE_ABANDONED) ? HTTPAPI_REQUEST_POST : HTTPAPI_REQUEST_DELETE,                               /*-requestType: POST                                                                                                       */
                             STRING_c_str(fullAbandonRelativePath),              /*-relativePath: abandon relative path begin (as created by _Create) + value of ETag + "/abandon?api-version=2016-11-14"   */
                             abandonRequestHttpHeaders,                          /*- requestHttpHeadersHandle: an HTTP headers instance containing the following                                            */
@@ -2058,6 +2269,14 @@ static IOTHUB_CLIENT_RESULT IoTHubTransportHttp_SendMessageDisposition(MESSAGE_C
     return result;
 }
 
+/*the message received over the response content owns it from then on*/
+static void release_response_content(const unsigned char* byteArray, size_t size, void* context)
+{
+    (void)byteArray;
+    (void)size;
+    BUFFER_delete((BUFFER_HANDLE)context);
+}
+
 static MESSAGE_CALLBACK_INFO* MESSAGE_CALLBACK_INFO_Create(IOTHUB_MESSAGE_HANDLE received_message, HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData, const char* etagValue)
 {
     MESSAGE_CALLBACK_INFO* result = (MESSAGE_CALLBACK_INFO*)malloc(sizeof(MESSAGE_CALLBACK_INFO));
@@ -2109,141 +2328,189 @@ static MESSAGE_CALLBACK_INFO* MESSAGE_CALLBACK_INFO_Create(IOTHUB_MESSAGE_HANDLE
     return result;
 }
 
-static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData)
+static bool isAdaptivePollingEnabled(HTTPTRANSPORT_HANDLE_DATA* handleData)
 {
-    /*Codes_SRS_TRANSPORTMULTITHTTP_17_083: [ If device is not subscribed then _DoWork shall advance to the next action. ] */
-    if (deviceData->DoWork_PullMessage)
+    return handleData->getMaximumPollingTime > handleData->getMinimumPollingTime;
+}
+
+static unsigned int getPollingInterval(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData)
+{
+    unsigned int result = handleData->getMinimumPollingTime;
+
+    if (isAdaptivePollingEnabled(handleData))
     {
-        /*Codes_SRS_TRANSPORTMULTITHTTP_17_123: [After client creation, the first GET shall be allowed no matter what the value of GetMinimumPollingTime.] */
-        /*Codes_SRS_TRANSPORTMULTITHTTP_17_124: [If time is not available then all calls shall be treated as if they are the first one.] */
-        /*Codes_SRS_TRANSPORTMULTITHTTP_17_122: [A GET request that happens earlier than GetMinimumPollingTime shall be ignored.] */
-        time_t timeNow = get_time(NULL);
-        bool isPollingAllowed = deviceData->isFirstPoll || (timeNow == (time_t)(-1)) || (get_difftime(timeNow, deviceData->lastPollTime) > handleData->getMinimumPollingTime);
-        if (isPollingAllowed)
+        /*Codes_SRS_TRANSPORTMULTITHTTP_41_003: [ If "MaximumPollingTime" is greater than "MinimumPollingTime", the time between 2 consecutive GET requests shall double for every consecutive response with status code 204, without exceeding "MaximumPollingTime". ]*/
+        size_t i;
+        for (i = 0; i < deviceData->emptyPollCount && result < handleData->getMaximumPollingTime; i++)
+        {
+            result = (result == 0) ? 1 : ((result > handleData->getMaximumPollingTime / 2) ? handleData->getMaximumPollingTime : result * 2);
+        }
+    }
+
+    return result;
+}
+
+/*returns true if the GET was answered with a message*/
+static bool PollMessage(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData, time_t timeNow)
+{
+    bool result = false;
+    HTTP_HEADERS_HANDLE responseHTTPHeaders = HTTPHeaders_Alloc();
+    if (responseHTTPHeaders == NULL)
+    {
+        /*Codes_SRS_TRANSPORTMULTITHTTP_17_085: [If the call to HTTPAPIEX_SAS_ExecuteRequest did not executed successfully or building any part of the prerequisites of the call fails, then _DoWork shall advance to the next action in this description.] */
+        LogError("unable to HTTPHeaders_Alloc");
+    }
+    else
+    {
+        BUFFER_HANDLE responseContent = BUFFER_new();
+        if (responseContent == NULL)
+        {
+            /*Codes_SRS_TRANSPORTMULTITHTTP_17_085: [If the call to HTTPAPIEX_SAS_ExecuteRequest did not executed successfully or building any part of the prerequisites of the call fails, then _DoWork shall advance to the next action in this description.] */
+            LogError("unable to BUFFER_new");
+        }
+        else
         {
-            HTTP_HEADERS_HANDLE responseHTTPHeaders = HTTPHeaders_Alloc();
-            if (responseHTTPHeaders == NULL)
+            unsigned int statusCode = 0;
+            HTTPAPIEX_RESULT r;
+            if (deviceData->deviceSasToken != NULL)
+            {
+                /*Codes_SRS_TRANSPORTMULTITHTTP_03_001: [if a deviceSasToken exists, HTTPHeaders_ReplaceHeaderNameValuePair shall be invoked with "Authorization" as its second argument and STRING_c_str (deviceSasToken) as its third argument.]*/
+                if (HTTPHeaders_ReplaceHeaderNameValuePair(deviceData->messageHTTPrequestHeaders, IOTHUB_AUTH_HEADER_VALUE, STRING_c_str(deviceData->deviceSasToken)) != HTTP_HEADERS_OK)
+                {
+                    r = HTTPAPIEX_ERROR;
+                    /*Codes_SRS_TRANSPORTMULTITHTTP_03_002: [If the result of the invocation of HTTPHeaders_ReplaceHeaderNameValuePair is NOT HTTP_HEADERS_OK then fallthrough.]*/
+                    LogError("Unable to replace the old SAS Token.");
+                }
+                else if ((r = HTTPAPIEX_ExecuteRequest(
+                    deviceData->httpApiExHandle,
+                    HTTPAPI_REQUEST_GET,                                            /*requestType: GET*/
+                    STRING_c_str(deviceData->messageHTTPrelativePath),         /*relativePath: the message HTTP relative path*/
+                    deviceData->messageHTTPrequestHeaders,                     /*requestHttpHeadersHandle: message HTTP request headers created by _Create*/
+                    NULL,                                                           /*requestContent: NULL*/
+                    &statusCode,                                                    /*statusCode: a pointer to unsigned int which shall be later examined*/
+                    responseHTTPHeaders,                                            /*responseHeadearsHandle: a new instance of HTTP headers*/
+                    responseContent                                                 /*responseContent: a new instance of buffer*/
+                )) != HTTPAPIEX_OK)
+                {
+                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_085: [If the call to HTTPAPIEX_SAS_ExecuteRequest did not executed successfully or building any part of the prerequisites of the call fails, then _DoWork shall advance to the next action in this description.] */
+                    LogError("Unable to HTTPAPIEX_ExecuteRequest.");
+                }
+            }
+
+            /*Codes_SRS_TRANSPORTMULTITHTTP_17_084: [Otherwise, IoTHubTransportHttp_DoWork shall call HTTPAPIEX_SAS_ExecuteRequest passing the following parameters
+            requestType: GET
+            relativePath: the message HTTP relative path
+            requestHttpHeadersHandle: message HTTP request headers created by _Create
+            requestContent: NULL
+            statusCode: a pointer to unsigned int which shall be later examined
+            responseHeadearsHandle: a new instance of HTTP headers
+            responseContent: a new instance of buffer]
+            */
+            else if ((r = HTTPAPIEX_SAS_ExecuteRequest(
+                deviceData->sasObject,
+                deviceData->httpApiExHandle,
+                HTTPAPI_REQUEST_GET,                                            /*requestType: GET*/
+                STRING_c_str(deviceData->messageHTTPrelativePath),         /*relativePath: the message HTTP relative path*/
+                deviceData->messageHTTPrequestHeaders,                     /*requestHttpHeadersHandle: message HTTP request headers created by _Create*/
+                NULL,                                                           /*requestContent: NULL*/
+                &statusCode,                                                    /*statusCode: a pointer to unsigned int which shall be later examined*/
+                responseHTTPHeaders,                                            /*responseHeadearsHandle: a new instance of HTTP headers*/
+                responseContent                                                 /*responseContent: a new instance of buffer*/
+            )) != HTTPAPIEX_OK)
             {
                 /*Codes_SRS_TRANSPORTMULTITHTTP_17_085: [If the call to HTTPAPIEX_SAS_ExecuteRequest did not executed successfully or building any part of the prerequisites of the call fails, then _DoWork shall advance to the next action in this description.] */
-                LogError("unable to HTTPHeaders_Alloc");
+                LogError("unable to HTTPAPIEX_SAS_ExecuteRequest");
             }
-            else
+            if (r == HTTPAPIEX_OK)
             {
-                BUFFER_HANDLE responseContent = BUFFER_new();
-                if (responseContent == NULL)
+                /*HTTP dialogue was succesfull*/
+                if (timeNow == (time_t)(-1))
                 {
-                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_085: [If the call to HTTPAPIEX_SAS_ExecuteRequest did not executed successfully or building any part of the prerequisites of the call fails, then _DoWork shall advance to the next action in this description.] */
-                    LogError("unable to BUFFER_new");
+                    deviceData->isFirstPoll = true;
                 }
                 else
                 {
-                    unsigned int statusCode = 0;
-                    HTTPAPIEX_RESULT r;
-                    if (deviceData->deviceSasToken != NULL)
+                    deviceData->isFirstPoll = false;
+                    deviceData->lastPollTime = timeNow;
+                }
+                if (statusCode == 204)
+                {
+                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_086: [If the HTTPAPIEX_SAS_ExecuteRequest executed successfully then status code shall be examined. Any status code different than 200 causes _DoWork to advance to the next action.] */
+                    /*this is an expected status code, means "no commands", but logging that creates panic*/
+
+                    if (isAdaptivePollingEnabled(handleData) && getPollingInterval(handleData, deviceData) < handleData->getMaximumPollingTime)
                     {
-                        /*Codes_SRS_TRANSPORTMULTITHTTP_03_001: [if a deviceSasToken exists, HTTPHeaders_ReplaceHeaderNameValuePair shall be invoked with "Authorization" as its second argument and STRING_c_str (deviceSasToken) as its third argument.]*/
-                        if (HTTPHeaders_ReplaceHeaderNameValuePair(deviceData->messageHTTPrequestHeaders, IOTHUB_AUTH_HEADER_VALUE, STRING_c_str(deviceData->deviceSasToken)) != HTTP_HEADERS_OK)
-                        {
-                            r = HTTPAPIEX_ERROR;
-                            /*Codes_SRS_TRANSPORTMULTITHTTP_03_002: [If the result of the invocation of HTTPHeaders_ReplaceHeaderNameValuePair is NOT HTTP_HEADERS_OK then fallthrough.]*/
-                            LogError("Unable to replace the old SAS Token.");
-                        }
-                        else if ((r = HTTPAPIEX_ExecuteRequest(
-                            handleData->httpApiExHandle,
-                            HTTPAPI_REQUEST_GET,                                            /*requestType: GET*/
-                            STRING_c_str(deviceData->messageHTTPrelativePath),         /*relativePath: the message HTTP relative path*/
-                            deviceData->messageHTTPrequestHeaders,                     /*requestHttpHeadersHandle: message HTTP request headers created by _Create*/
-                            NULL,                                                           /*requestContent: NULL*/
-                            &statusCode,                                                    /*statusCode: a pointer to unsigned int which shall be later examined*/
-                            responseHTTPHeaders,                                            /*responseHeadearsHandle: a new instance of HTTP headers*/
-                            responseContent                                                 /*responseContent: a new instance of buffer*/
-                        )) != HTTPAPIEX_OK)
-                        {
-                            /*Codes_SRS_TRANSPORTMULTITHTTP_17_085: [If the call to HTTPAPIEX_SAS_ExecuteRequest did not executed successfully or building any part of the prerequisites of the call fails, then _DoWork shall advance to the next action in this description.] */
-                            LogError("Unable to HTTPAPIEX_ExecuteRequest.");
-                        }
+                        deviceData->emptyPollCount++;
                     }
+                }
+                else if (statusCode != 200)
+                {
+                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_086: [If the HTTPAPIEX_SAS_ExecuteRequest executed successfully then status code shall be examined. Any status code different than 200 causes _DoWork to advance to the next action.] */
+                    LogError("expected status code was 200, but actually was received %u... moving on", statusCode);
+                }
+                else
+                {
+                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_087: [If status code is 200, then _DoWork shall make a copy of the value of the "ETag" http header.]*/
+                    const char* etagValue = HTTPHeaders_FindHeaderValue(responseHTTPHeaders, "ETag");
 
-                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_084: [Otherwise, IoTHubTransportHttp_DoWork shall call HTTPAPIEX_SAS_ExecuteRequest passing the following parameters
-                    requestType: GET
-                    relativePath: the message HTTP relative path
-                    requestHttpHeadersHandle: message HTTP request headers created by _Create
-                    requestContent: NULL
-                    statusCode: a pointer to unsigned int which shall be later examined
-                    responseHeadearsHandle: a new instance of HTTP headers
-                    responseContent: a new instance of buffer]
-                    */
-                    else if ((r = HTTPAPIEX_SAS_ExecuteRequest(
-                        deviceData->sasObject,
-                        handleData->httpApiExHandle,
-                        HTTPAPI_REQUEST_GET,                                            /*requestType: GET*/
-                        STRING_c_str(deviceData->messageHTTPrelativePath),         /*relativePath: the message HTTP relative path*/
-                        deviceData->messageHTTPrequestHeaders,                     /*requestHttpHeadersHandle: message HTTP request headers created by _Create*/
-                        NULL,                                                           /*requestContent: NULL*/
-                        &statusCode,                                                    /*statusCode: a pointer to unsigned int which shall be later examined*/
-                        responseHTTPHeaders,                                            /*responseHeadearsHandle: a new instance of HTTP headers*/
-                        responseContent                                                 /*responseContent: a new instance of buffer*/
-                    )) != HTTPAPIEX_OK)
+                    /*Codes_SRS_TRANSPORTMULTITHTTP_41_004: [ If "MaximumPollingTime" is greater than "MinimumPollingTime", a response with status code 200 shall reset the polling interval to "MinimumPollingTime" and allow the next GET request without waiting, to drain bursts of messages. ]*/
+                    deviceData->emptyPollCount = 0;
+                    if (isAdaptivePollingEnabled(handleData))
                     {
-                        /*Codes_SRS_TRANSPORTMULTITHTTP_17_085: [If the call to HTTPAPIEX_SAS_ExecuteRequest did not executed successfully or building any part of the prerequisites of the call fails, then _DoWork shall advance to the next action in this description.] */
-                        LogError("unable to HTTPAPIEX_SAS_ExecuteRequest");
+                        deviceData->isFirstPoll = true;
                     }
-                    if (r == HTTPAPIEX_OK)
+                    if (etagValue == NULL)
                     {
-                        /*HTTP dialogue was succesfull*/
-                        if (timeNow == (time_t)(-1))
-                        {
-                            deviceData->isFirstPoll = true;
-                        }
-                        else
-                        {
-                            deviceData->isFirstPoll = false;
-                            deviceData->lastPollTime = timeNow;
-                        }
-                        if (statusCode == 204)
-                        {
-                            /*Codes_SRS_TRANSPORTMULTITHTTP_17_086: [If the HTTPAPIEX_SAS_ExecuteRequest executed successfully then status code shall be examined. Any status code different than 200 causes _DoWork to advance to the next action.] */
-                            /*this is an expected status code, means "no commands", but logging that creates panic*/
-
-                            /*do nothing, advance to next action*/
-                        }
-                        else if (statusCode != 200)
+                        LogError("unable to find a received header called \"E-Tag\"");
+                    }
+                    else
+                    {
+                        /*Codes_SRS_TRANSPORTMULTITHTTP_17_088: [If no such header is found or is invalid, then _DoWork shall advance to the next action.]*/
+                        size_t etagsize = strlen(etagValue);
+                        if (
+                            (etagsize < 2) ||
+                            (etagValue[0] != '"') ||
+                            (etagValue[etagsize - 1] != '"')
+                            )
                         {
-                            /*Codes_SRS_TRANSPORTMULTITHTTP_17_086: [If the HTTPAPIEX_SAS_ExecuteRequest executed successfully then status code shall be examined. Any status code different than 200 causes _DoWork to advance to the next action.] */
-                            LogError("expected status code was 200, but actually was received %u... moving on", statusCode);
+                            LogError("ETag is not a valid quoted string");
                         }
                         else
                         {
-                            /*Codes_SRS_TRANSPORTMULTITHTTP_17_087: [If status code is 200, then _DoWork shall make a copy of the value of the "ETag" http header.]*/
-                            const char* etagValue = HTTPHeaders_FindHeaderValue(responseHTTPHeaders, "ETag");
-                            if (etagValue == NULL)
+                            const unsigned char* resp_content;
+                            size_t resp_len;
+                            result = true;
+                            /*Codes_SRS_TRANSPORTMULTITHTTP_17_089: [_DoWork shall assemble an IOTHUBMESSAGE_HANDLE from the received HTTP content (using the responseContent buffer).] */
+                            resp_content = BUFFER_u_char(responseContent);
+                            resp_len = BUFFER_length(responseContent);
+                            report_statistic(handleData, deviceData, TRANSPORT_STATISTIC_BYTES_RECEIVED, NULL, resp_len);
+                            /*Codes_SRS_TRANSPORTMULTITHTTP_41_009: [ The message shall be created over the responseContent buffer with IoTHubMessage_CreateFromByteArrayNoCopy, which takes ownership of the buffer instead of copying the content. ]*/
+                            IOTHUB_MESSAGE_HANDLE receivedMessage = IoTHubMessage_CreateFromByteArrayNoCopy(resp_content, resp_len, release_response_content, responseContent);
+                            if (receivedMessage == NULL)
                             {
-                                LogError("unable to find a received header called \"E-Tag\"");
+                                /*Codes_SRS_TRANSPORTMULTITHTTP_17_092: [If assembling the message fails in any way, then _DoWork shall "abandon" the message.]*/
+                                LogError("unable to IoTHubMessage_CreateFromByteArrayNoCopy, trying to abandon the message... ");
+                                if (!abandonOrAcceptMessage(handleData, deviceData, etagValue, IOTHUBMESSAGE_ABANDONED))
+                                {
+                                    LogError("HTTP Transport layer failed to report ABANDON disposition");
+                                }
                             }
                             else
                             {
-                                /*Codes_SRS_TRANSPORTMULTITHTTP_17_088: [If no such header is found or is invalid, then _DoWork shall advance to the next action.]*/
-                                size_t etagsize = strlen(etagValue);
-                                if (
-                                    (etagsize < 2) ||
-                                    (etagValue[0] != '"') ||
-                                    (etagValue[etagsize - 1] != '"')
-                                    )
+                                if (retrieve_message_properties(responseHTTPHeaders, receivedMessage) != 0)
                                 {
-                                    LogError("ETag is not a valid quoted string");
+                                    if (!abandonOrAcceptMessage(handleData, deviceData, etagValue, IOTHUBMESSAGE_ABANDONED))
+                                    {
+                                        LogError("HTTP Transport layer failed to report ABANDON disposition");
+                                    }
                                 }
                                 else
                                 {
-                                    const unsigned char* resp_content;
-                                    size_t resp_len;
-                                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_089: [_DoWork shall assemble an IOTHUBMESSAGE_HANDLE from the received HTTP content (using the responseContent buffer).] */
-                                    resp_content = BUFFER_u_char(responseContent);
-                                    resp_len = BUFFER_length(responseContent);
-                                    IOTHUB_MESSAGE_HANDLE receivedMessage = IoTHubMessage_CreateFromByteArray(resp_content, resp_len);
-                                    if (receivedMessage == NULL)
+                                    MESSAGE_CALLBACK_INFO* messageData = MESSAGE_CALLBACK_INFO_Create(receivedMessage, handleData, deviceData, etagValue);
+                                    if (messageData == NULL)
                                     {
-                                        /*Codes_SRS_TRANSPORTMULTITHTTP_17_092: [If assembling the message fails in any way, then _DoWork shall "abandon" the message.]*/
-                                        LogError("unable to IoTHubMessage_CreateFromByteArray, trying to abandon the message... ");
+                                        /*Codes_SRS_TRANSPORTMULTITHTTP_10_006: [If assembling the transport context fails, _DoWork shall "abandon" the message.] */
+                                        LogError("failed to assemble callback info");
                                         if (!abandonOrAcceptMessage(handleData, deviceData, etagValue, IOTHUBMESSAGE_ABANDONED))
                                         {
                                             LogError("HTTP Transport layer failed to report ABANDON disposition");
@@ -2251,54 +2518,63 @@ static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERD
                                     }
                                     else
                                     {
-                                        if (retrieve_message_properties(responseHTTPHeaders, receivedMessage) != 0)
+                                        bool abandon;
+                                        bool entered = enter_upper_layer(handleData);
+                                        deviceData->inMessageCallback = entered;
+                                        if (handleData->transport_callbacks.msg_cb(messageData, deviceData->device_transport_ctx))
                                         {
-                                            if (!abandonOrAcceptMessage(handleData, deviceData, etagValue, IOTHUBMESSAGE_ABANDONED))
-                                            {
-                                                LogError("HTTP Transport layer failed to report ABANDON disposition");
-                                            }
+                                            abandon = false;
                                         }
                                         else
                                         {
-                                            MESSAGE_CALLBACK_INFO* messageData = MESSAGE_CALLBACK_INFO_Create(receivedMessage, handleData, deviceData, etagValue);
-                                            if (messageData == NULL)
-                                            {
-                                                /*Codes_SRS_TRANSPORTMULTITHTTP_10_006: [If assembling the transport context fails, _DoWork shall "abandon" the message.] */
-                                                LogError("failed to assemble callback info");
-                                                if (!abandonOrAcceptMessage(handleData, deviceData, etagValue, IOTHUBMESSAGE_ABANDONED))
-                                                {
-                                                    LogError("HTTP Transport layer failed to report ABANDON disposition");
-                                                }
-                                            }
-                                            else
-                                            {
-                                                bool abandon;
-                                                if (handleData->transport_callbacks.msg_cb(messageData, deviceData->device_transport_ctx))
-                                                {
-                                                    abandon = false;
-                                                }
-                                                else
-                                                {
-                                                    LogError("IoTHubClientCore_LL_MessageCallback failed");
-                                                    abandon = true;
-                                                }
-
-                                                /*Codes_SRS_TRANSPORTMULTITHTTP_17_096: [If IoTHubClientCore_LL_MessageCallback returns false then _DoWork shall "abandon" the message.] */
-                                                if (abandon)
-                                                {
-                                                    (void)IoTHubTransportHttp_SendMessageDisposition(messageData, IOTHUBMESSAGE_ABANDONED);
-                                                }
-                                            }
+                                            LogError("IoTHubClientCore_LL_MessageCallback failed");
+                                            abandon = true;
+                                        }
+                                        deviceData->inMessageCallback = false;
+                                        leave_upper_layer(handleData, entered);
+
+                                        /*Codes_SRS_TRANSPORTMULTITHTTP_17_096: [If IoTHubClientCore_LL_MessageCallback returns false then _DoWork shall "abandon" the message.] */
+                                        if (abandon)
+                                        {
+                                            (void)IoTHubTransportHttp_SendMessageDisposition(messageData, IOTHUBMESSAGE_ABANDONED);
                                         }
-                                        IoTHubMessage_Destroy(receivedMessage);
                                     }
                                 }
+                                responseContent = NULL;
+                                IoTHubMessage_Destroy(receivedMessage);
                             }
                         }
                     }
-                    BUFFER_delete(responseContent);
                 }
-                HTTPHeaders_Free(responseHTTPHeaders);
+            }
+            if (responseContent != NULL)
+            {
+                BUFFER_delete(responseContent);
+            }
+        }
+        HTTPHeaders_Free(responseHTTPHeaders);
+    }
+
+    return result;
+}
+
+static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData)
+{
+    /*Codes_SRS_TRANSPORTMULTITHTTP_17_083: [ If device is not subscribed then _DoWork shall advance to the next action. ] */
+    if (deviceData->DoWork_PullMessage)
+    {
+        /*Codes_SRS_TRANSPORTMULTITHTTP_17_123: [After client creation, the first GET shall be allowed no matter what the value of GetMinimumPollingTime.] */
+        /*Codes_SRS_TRANSPORTMULTITHTTP_17_124: [If time is not available then all calls shall be treated as if they are the first one.] */
+        /*Codes_SRS_TRANSPORTMULTITHTTP_17_122: [A GET request that happens earlier than GetMinimumPollingTime shall be ignored.] */
+        time_t timeNow = get_time(NULL);
+        bool isPollingAllowed = deviceData->isFirstPoll || (timeNow == (time_t)(-1)) || (get_difftime(timeNow, deviceData->lastPollTime) > getPollingInterval(handleData, deviceData));
+        if (isPollingAllowed)
+        {
+            size_t polls = 1;
+            /*Codes_SRS_TRANSPORTMULTITHTTP_41_010: [ While a GET is answered with a message and the device is still subscribed, _DoWork shall issue the next GET for the device without waiting for the polling time, up to "http_messages_per_poll" GET requests per device and call. ]*/
+            while (PollMessage(handleData, deviceData, timeNow) && deviceData->DoWork_PullMessage && (polls < handleData->messagesPerPoll))
+            {
+                polls++;
             }
         }
         else
@@ -2318,6 +2594,232 @@ static IOTHUB_PROCESS_ITEM_RESULT IoTHubTransportHttp_ProcessItem(TRANSPORT_LL_H
     return IOTHUB_PROCESS_ERROR;
 }
 
+/*called and returns with the lock held, which is released while a device is served*/
+static void serve_round(HTTP_DEVICE_WORKERS* workers, HTTPAPIEX_HANDLE httpApiExHandle)
+{
+    HTTPTRANSPORT_HANDLE_DATA* handleData = workers->handleData;
+
+    while (workers->nextDevice < workers->devicesToServe)
+    {
+        IOTHUB_DEVICE_HANDLE* listItem = (IOTHUB_DEVICE_HANDLE *)VECTOR_element(handleData->perDeviceList, (workers->firstDevice + workers->nextDevice) % workers->deviceListSize);
+        HTTPTRANSPORT_PERDEVICE_DATA* deviceData = *(HTTPTRANSPORT_PERDEVICE_DATA**)(listItem);
+        workers->nextDevice++;
+        (void)Unlock(workers->lock);
+
+        /*Codes_SRS_TRANSPORTMULTITHTTP_41_013: [ If "http_device_workers" is greater than 1, IoTHubTransportHttp_DoWork shall serve that many devices at a time, each device worker on its own connection, and return once every device of the call has been served. ]*/
+        deviceData->httpApiExHandle = httpApiExHandle;
+        DoEvent(handleData, deviceData);
+        DoMessages(handleData, deviceData);
+        deviceData->httpApiExHandle = handleData->httpApiExHandle;
+
+        if (Lock(workers->lock) != LOCK_OK)
+        {
+            LogError("unable to Lock - - will still proceed to count the device as served");
+        }
+        workers->devicesServed++;
+        if ((workers->devicesServed == workers->devicesToServe) && (Condition_Post(workers->roundEnded) != COND_OK))
+        {
+            LogError("Condition_Post failed");
+        }
+    }
+}
+
+static int HttpDeviceWorker_Thread(void* threadArgument)
+{
+    HTTP_DEVICE_WORKER* worker = (HTTP_DEVICE_WORKER*)threadArgument;
+    HTTP_DEVICE_WORKERS* workers = worker->workers;
+
+    /*a worker that cannot lock leaves its devices to the others and to the thread calling IoTHubTransportHttp_DoWork*/
+    if (Lock(workers->lock) != LOCK_OK)
+    {
+        LogError("failed locking for HttpDeviceWorker_Thread");
+    }
+    else
+    {
+        while (workers->stop == 0)
+        {
+            if (workers->nextDevice < workers->devicesToServe)
+            {
+                serve_round(workers, worker->httpApiExHandle);
+            }
+            else
+            {
+                /*Condition_Wait releases the lock while blocked and reacquires it before returning*/
+                (void)Condition_Wait(workers->roundStarted, workers->lock, 0);
+            }
+        }
+        (void)Unlock(workers->lock);
+    }
+
+    ThreadAPI_Exit(0);
+    return 0;
+}
+
+static void destroy_deviceWorkers(HTTP_DEVICE_WORKERS* workers)
+{
+    size_t index;
+    int res;
+
+    /*Codes_SRS_TRANSPORTMULTITHTTP_41_016: [ IoTHubTransportHttp_Destroy shall stop and join the device workers and destroy their connections. ]*/
+    if (Lock(workers->lock) != LOCK_OK)
+    {
+        LogError("unable to Lock - - will still proceed to try to end the device worker threads without locking");
+    }
+    workers->stop = 1;
+    for (index = 0; index < workers->threadsStarted; index++)
+    {
+        if (Condition_Post(workers->roundStarted) != COND_OK)
+        {
+            LogError("Condition_Post failed");
+        }
+    }
+    if (Unlock(workers->lock) != LOCK_OK)
+    {
+        LogError("unable to Unlock");
+    }
+
+    for (index = 0; index < workers->threadsStarted; index++)
+    {
+        if (ThreadAPI_Join(workers->workers[index].thread, &res) != THREADAPI_OK)
+        {
+            LogError("ThreadAPI_Join failed for device worker thread");
+        }
+    }
+
+    for (index = 0; index < workers->workerCount; index++)
+    {
+        HTTPAPIEX_Destroy(workers->workers[index].httpApiExHandle);
+    }
+
+    Condition_Deinit(workers->roundEnded);
+    Condition_Deinit(workers->roundStarted);
+    Lock_Deinit(workers->lock);
+    free(workers->workers);
+    free(workers);
+}
+
+/*the thread calling IoTHubTransportHttp_DoWork is a worker too, so workerCount threads are started for workerCount + 1 device workers*/
+static HTTP_DEVICE_WORKERS* create_deviceWorkers(HTTPTRANSPORT_HANDLE_DATA* handleData, size_t workerCount)
+{
+    HTTP_DEVICE_WORKERS* result;
+
+    if ((result = (HTTP_DEVICE_WORKERS*)malloc(sizeof(HTTP_DEVICE_WORKERS))) == NULL)
+    {
+        LogError("failed allocating device workers");
+    }
+    else
+    {
+        memset(result, 0, sizeof(HTTP_DEVICE_WORKERS));
+        result->handleData = handleData;
+
+        if ((result->lock = Lock_Init()) == NULL)
+        {
+            LogError("Lock_Init failed");
+            free(result);
+            result = NULL;
+        }
+        else if ((result->roundStarted = Condition_Init()) == NULL)
+        {
+            LogError("Condition_Init failed");
+            Lock_Deinit(result->lock);
+            free(result);
+            result = NULL;
+        }
+        else if ((result->roundEnded = Condition_Init()) == NULL)
+        {
+            LogError("Condition_Init failed");
+            Condition_Deinit(result->roundStarted);
+            Lock_Deinit(result->lock);
+            free(result);
+            result = NULL;
+        }
+        else if ((result->workers = (HTTP_DEVICE_WORKER*)malloc(workerCount * sizeof(HTTP_DEVICE_WORKER))) == NULL)
+        {
+            LogError("failed allocating %lu device workers", (unsigned long)workerCount);
+            Condition_Deinit(result->roundEnded);
+            Condition_Deinit(result->roundStarted);
+            Lock_Deinit(result->lock);
+            free(result);
+            result = NULL;
+        }
+        else
+        {
+            /*a connection per device worker, so that the requests of a device never wait for those of another*/
+            while ((result->workerCount < workerCount) &&
+                ((result->workers[result->workerCount].httpApiExHandle = HTTPAPIEX_Create(STRING_c_str(handleData->hostName))) != NULL))
+            {
+                result->workers[result->workerCount].workers = result;
+                result->workerCount++;
+            }
+
+            if (result->workerCount == workerCount)
+            {
+                while ((result->threadsStarted < workerCount) &&
+                    (ThreadAPI_Create(&result->workers[result->threadsStarted].thread, HttpDeviceWorker_Thread, &result->workers[result->threadsStarted]) == THREADAPI_OK))
+                {
+                    result->threadsStarted++;
+                }
+            }
+
+            /*Codes_SRS_TRANSPORTMULTITHTTP_41_015: [ If a connection or a thread of the device workers cannot be created, IoTHubTransportHttp_SetOption shall free the device workers, keep serving one device at a time and return IOTHUB_CLIENT_ERROR. ]*/
+            if (result->threadsStarted < workerCount)
+            {
+                LogError("failed starting %lu device workers (%lu connections, %lu threads)", (unsigned long)workerCount, (unsigned long)result->workerCount, (unsigned long)result->threadsStarted);
+                destroy_deviceWorkers(result);
+                result = NULL;
+            }
+        }
+    }
+
+    return result;
+}
+
+/*returns false, leaving the devices to be served one at a time, if the round cannot be started*/
+static bool serve_devices_on_workers(HTTP_DEVICE_WORKERS* workers, size_t firstDevice, size_t deviceListSize, size_t devicesToServe)
+{
+    bool result;
+
+    if (Lock(workers->lock) != LOCK_OK)
+    {
+        LogError("failed locking device workers, serving the devices one at a time");
+        result = false;
+    }
+    else
+    {
+        size_t index;
+
+        workers->firstDevice = firstDevice;
+        workers->deviceListSize = deviceListSize;
+        workers->devicesToServe = devicesToServe;
+        workers->nextDevice = 0;
+        workers->devicesServed = 0;
+
+        for (index = 0; index < workers->threadsStarted; index++)
+        {
+            if (Condition_Post(workers->roundStarted) != COND_OK)
+            {
+                LogError("Condition_Post failed");
+            }
+        }
+
+        /*the calling thread serves devices too, on the connection of the transport*/
+        serve_round(workers, workers->handleData->httpApiExHandle);
+
+        while (workers->devicesServed < workers->devicesToServe)
+        {
+            (void)Condition_Wait(workers->roundEnded, workers->lock, 0);
+        }
+
+        workers->devicesToServe = 0;
+        workers->nextDevice = 0;
+        workers->devicesServed = 0;
+        (void)Unlock(workers->lock);
+        result = true;
+    }
+
+    return result;
+}
+
 static void IoTHubTransportHttp_DoWork(TRANSPORT_LL_HANDLE handle)
 {
     /*Codes_SRS_TRANSPORTMULTITHTTP_17_049: [ If handle is NULL, then IoTHubTransportHttp_DoWork shall do nothing. ]*/
@@ -2326,15 +2828,30 @@ static void IoTHubTransportHttp_DoWork(TRANSPORT_LL_HANDLE handle)
         HTTPTRANSPORT_HANDLE_DATA* handleData = (HTTPTRANSPORT_HANDLE_DATA*)handle;
         IOTHUB_DEVICE_HANDLE* listItem;
         size_t deviceListSize = VECTOR_size(handleData->perDeviceList);
+        size_t devicesToServe = deviceListSize;
+        size_t firstDevice = 0;
+
+        /*Codes_SRS_TRANSPORTMULTITHTTP_41_001: [ If "http_devices_per_do_work" is set and fewer than the registered devices, IoTHubTransportHttp_DoWork shall only serve that many devices, starting with the device following the last one served by the previous call. ]*/
+        if (handleData->devicesPerDoWork != 0 && handleData->devicesPerDoWork < deviceListSize)
+        {
+            devicesToServe = handleData->devicesPerDoWork;
+            firstDevice = handleData->nextDeviceIndex % deviceListSize;
+            handleData->nextDeviceIndex = (firstDevice + devicesToServe) % deviceListSize;
+        }
+
         /*Codes_SRS_TRANSPORTMULTITHTTP_17_052: [ IoTHubTransportHttp_DoWork shall perform a round-robin loop through every deviceHandle in the transport device list. ]*/
         /*Codes_SRS_TRANSPORTMULTITHTTP_17_050: [ IoTHubTransportHttp_DoWork shall call loop through the device list. ] */
         /*Codes_SRS_TRANSPORTMULTITHTTP_17_051: [ IF the list is empty, then IoTHubTransportHttp_DoWork shall do nothing. ]*/
-        for (size_t i = 0; i < deviceListSize; i++)
+        if ((handleData->deviceWorkers == NULL) || (devicesToServe < 2) ||
+            !serve_devices_on_workers(handleData->deviceWorkers, firstDevice, deviceListSize, devicesToServe))
         {
-            listItem = (IOTHUB_DEVICE_HANDLE *)VECTOR_element(handleData->perDeviceList, i);
-            HTTPTRANSPORT_PERDEVICE_DATA* perDeviceItem = *(HTTPTRANSPORT_PERDEVICE_DATA**)(listItem);
-            DoEvent(handleData, perDeviceItem);
-            DoMessages(handleData, perDeviceItem);
+            for (size_t i = 0; i < devicesToServe; i++)
+            {
+                listItem = (IOTHUB_DEVICE_HANDLE *)VECTOR_element(handleData->perDeviceList, (firstDevice + i) % deviceListSize);
+                HTTPTRANSPORT_PERDEVICE_DATA* perDeviceItem = *(HTTPTRANSPORT_PERDEVICE_DATA**)(listItem);
+                DoEvent(handleData, perDeviceItem);
+                DoMessages(handleData, perDeviceItem);
+            }
         }
     }
     else
@@ -2419,6 +2936,66 @@ static IOTHUB_CLIENT_RESULT IoTHubTransportHttp_SetOption(TRANSPORT_LL_HANDLE ha
             handleData->getMinimumPollingTime = *(unsigned int*)value;
             result = IOTHUB_CLIENT_OK;
         }
+        /*Codes_SRS_TRANSPORTMULTITHTTP_41_005: [ "MaximumPollingTime" ] */
+        else if (strcmp(OPTION_MAX_POLLING_TIME, option) == 0)
+        {
+            handleData->getMaximumPollingTime = *(unsigned int*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
+        /*Codes_SRS_TRANSPORTMULTITHTTP_41_002: [ "http_devices_per_do_work" ] */
+        else if (strcmp(OPTION_HTTP_DEVICES_PER_DO_WORK, option) == 0)
+        {
+            handleData->devicesPerDoWork = *(size_t*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
+        /*Codes_SRS_TRANSPORTMULTITHTTP_41_011: [ "http_messages_per_poll" ] */
+        else if (strcmp(OPTION_HTTP_MESSAGES_PER_POLL, option) == 0)
+        {
+            if (*(size_t*)value == 0)
+            {
+                /*Codes_SRS_TRANSPORTMULTITHTTP_41_012: [ If "http_messages_per_poll" is 0, IoTHubTransportHttp_SetOption shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+                LogError("http_messages_per_poll cannot be 0");
+                result = IOTHUB_CLIENT_INVALID_ARG;
+            }
+            else
+            {
+                handleData->messagesPerPoll = *(size_t*)value;
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        /*Codes_SRS_TRANSPORTMULTITHTTP_41_014: [ "http_device_workers" ] */
+        else if (strcmp(OPTION_HTTP_DEVICE_WORKERS, option) == 0)
+        {
+            size_t deviceWorkers = *(size_t*)value;
+
+            if ((deviceWorkers > 1) && handleData->connectionOptionsSet)
+            {
+                /*Codes_SRS_TRANSPORTMULTITHTTP_41_017: [ If an option was already passed down to HTTPAPIEX_SetOption, setting "http_device_workers" greater than 1 shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+                LogError("http_device_workers must be set before the options of the connection");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                if (handleData->deviceWorkers != NULL)
+                {
+                    destroy_deviceWorkers(handleData->deviceWorkers);
+                    handleData->deviceWorkers = NULL;
+                }
+
+                if (deviceWorkers < 2)
+                {
+                    result = IOTHUB_CLIENT_OK;
+                }
+                else if ((handleData->deviceWorkers = create_deviceWorkers(handleData, deviceWorkers - 1)) == NULL)
+                {
+                    result = IOTHUB_CLIENT_ERROR;
+                }
+                else
+                {
+                    result = IOTHUB_CLIENT_OK;
+                }
+            }
+        }
         else
         {
             /*Codes_SRS_TRANSPORTMULTITHTTP_17_126: [ "TrustedCerts"] */
@@ -2427,6 +3004,21 @@ static IOTHUB_CLIENT_RESULT IoTHubTransportHttp_SetOption(TRANSPORT_LL_HANDLE ha
             /*Codes_SRS_TRANSPORTMULTITHTTP_17_118: [Otherwise, IoTHubTransport_Http shall call HTTPAPIEX_SetOption with the same parameters and return the translated code.] */
             HTTPAPIEX_RESULT HTTPAPIEX_result = HTTPAPIEX_SetOption(handleData->httpApiExHandle, option, value);
             /*Codes_SRS_TRANSPORTMULTITHTTP_17_119: [The following table translates HTTPAPIEX return codes to IOTHUB_CLIENT_RESULT return codes:] */
+            if (HTTPAPIEX_result == HTTPAPIEX_OK)
+            {
+                handleData->connectionOptionsSet = true;
+
+                /*Codes_SRS_TRANSPORTMULTITHTTP_41_018: [ The option shall also be passed down to the connection of every device worker, and IoTHubTransportHttp_SetOption shall return the first error of those. ]*/
+                if (handleData->deviceWorkers != NULL)
+                {
+                    size_t index;
+                    for (index = 0; (index < handleData->deviceWorkers->workerCount) && (HTTPAPIEX_result == HTTPAPIEX_OK); index++)
+                    {
+                        HTTPAPIEX_result = HTTPAPIEX_SetOption(handleData->deviceWorkers->workers[index].httpApiExHandle, option, value);
+                    }
+                }
+            }
+
             if (HTTPAPIEX_result == HTTPAPIEX_OK)
             {
                 result = IOTHUB_CLIENT_OK;
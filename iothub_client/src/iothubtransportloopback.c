@@ -0,0 +1,803 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/doublylinkedlist.h"
+#include "azure_c_shared_utility/strings.h"
+#include "azure_c_shared_utility/tickcounter.h"
+#include "internal/iothub_client_private.h"
+#include "internal/iothubtransport.h"
+#include "internal/iothub_transport_ll_private.h"
+#include "iothubtransportloopback.h"
+
+#define DEFAULT_PAYLOAD_SIZE            16
+#define PAYLOAD_FILL                    'x'
+#define REPORTED_STATE_STATUS_CODE      204
+#define TWIN_PAYLOAD_BUFFER_SIZE        64
+
+static const char* FULL_TWIN_FORMAT = "{\"desired\":{\"$version\":%lu},\"reported\":{\"$version\":1}}";
+static const char* DESIRED_PATCH_FORMAT = "{\"loopback\":%lu,\"$version\":%lu}";
+static const char* INJECTED_METHOD_NAME = "loopback";
+
+typedef enum LOOPBACK_RESPONSE_TYPE_TAG
+{
+    LOOPBACK_RESPONSE_EVENTS,
+    LOOPBACK_RESPONSE_REPORTED_STATE,
+    LOOPBACK_RESPONSE_GET_TWIN,
+    LOOPBACK_RESPONSE_FULL_TWIN
+} LOOPBACK_RESPONSE_TYPE;
+
+// What the hub would answer once the latency has passed; responses all wait the same time, so they are kept in the order they were made
+typedef struct LOOPBACK_RESPONSE_TAG
+{
+    LOOPBACK_RESPONSE_TYPE type;
+    tickcounter_ms_t due_ms;
+    DLIST_ENTRY events;
+    uint32_t item_id;
+    IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK get_twin_callback;
+    void* get_twin_context;
+    struct LOOPBACK_RESPONSE_TAG* next;
+} LOOPBACK_RESPONSE;
+
+typedef struct LOOPBACK_INJECTION_TAG
+{
+    unsigned int rate;
+    bool subscribed;
+    bool restart;
+    tickcounter_ms_t started_ms;
+    uint64_t injected;
+} LOOPBACK_INJECTION;
+
+typedef struct LOOPBACK_TRANSPORT_TAG
+{
+    TRANSPORT_CALLBACKS_INFO transport_cb;
+    void* transport_ctx;
+    PDLIST_ENTRY waitingToSend;
+    STRING_HANDLE hostname;
+    TICK_COUNTER_HANDLE tick_counter;
+    bool registered;
+    bool connected;
+
+    unsigned int latency;
+    LOOPBACK_RESPONSE* responses_head;
+    LOOPBACK_RESPONSE* responses_tail;
+    size_t pending_event_responses;
+
+    unsigned char* payload;
+    size_t payload_size;
+    LOOPBACK_INJECTION c2d;
+    LOOPBACK_INJECTION desired;
+    LOOPBACK_INJECTION method;
+    unsigned long desired_version;
+    uintptr_t last_method_id;
+} LOOPBACK_TRANSPORT;
+
+static LOOPBACK_TRANSPORT_STATISTICS g_statistics;
+
+static int set_payload_size(LOOPBACK_TRANSPORT* transport, size_t payload_size)
+{
+    int result;
+    // Never 0 bytes, so that the buffer is a valid pointer for an empty payload too
+    unsigned char* payload = (unsigned char*)realloc(transport->payload, payload_size == 0 ? 1 : payload_size);
+
+    if (payload == NULL)
+    {
+        LogError("Failed allocating a payload of %lu bytes", (unsigned long)payload_size);
+        result = __FAILURE__;
+    }
+    else
+    {
+        (void)memset(payload, PAYLOAD_FILL, payload_size);
+        transport->payload = payload;
+        transport->payload_size = payload_size;
+        result = 0;
+    }
+
+    return result;
+}
+
+static LOOPBACK_RESPONSE* queue_response(LOOPBACK_TRANSPORT* transport, LOOPBACK_RESPONSE_TYPE type)
+{
+    tickcounter_ms_t current_ms;
+    LOOPBACK_RESPONSE* result;
+
+    if (tickcounter_get_current_ms(transport->tick_counter, &current_ms) != 0)
+    {
+        LogError("Failed getting the current time");
+        result = NULL;
+    }
+    else if ((result = (LOOPBACK_RESPONSE*)malloc(sizeof(LOOPBACK_RESPONSE))) == NULL)
+    {
+        LogError("Failed allocating the response");
+    }
+    else
+    {
+        (void)memset(result, 0, sizeof(LOOPBACK_RESPONSE));
+        result->type = type;
+        result->due_ms = current_ms + transport->latency;
+        DList_InitializeListHead(&result->events);
+
+        if (transport->responses_tail == NULL)
+        {
+            transport->responses_head = result;
+        }
+        else
+        {
+            transport->responses_tail->next = result;
+        }
+        transport->responses_tail = result;
+    }
+
+    return result;
+}
+
+static void deliver_full_twin(LOOPBACK_TRANSPORT* transport, IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK callback, void* context)
+{
+    char payload[TWIN_PAYLOAD_BUFFER_SIZE];
+    int length = snprintf(payload, sizeof(payload), FULL_TWIN_FORMAT, transport->desired_version);
+
+    g_statistics.twin_requests_answered++;
+    if (callback != NULL)
+    {
+        callback(DEVICE_TWIN_UPDATE_COMPLETE, (const unsigned char*)payload, (size_t)length, context);
+    }
+    else
+    {
+        transport->transport_cb.twin_retrieve_prop_complete_cb(DEVICE_TWIN_UPDATE_COMPLETE, (const unsigned char*)payload, (size_t)length, transport->transport_ctx);
+    }
+}
+
+static void complete_response(LOOPBACK_TRANSPORT* transport, LOOPBACK_RESPONSE* response)
+{
+    switch (response->type)
+    {
+        case LOOPBACK_RESPONSE_EVENTS:
+            transport->pending_event_responses--;
+            transport->transport_cb.send_complete_cb(&response->events, IOTHUB_CLIENT_CONFIRMATION_OK, transport->transport_ctx);
+            break;
+        case LOOPBACK_RESPONSE_REPORTED_STATE:
+            g_statistics.reported_states_acknowledged++;
+            transport->transport_cb.twin_rpt_state_complete_cb(response->item_id, REPORTED_STATE_STATUS_CODE, transport->transport_ctx);
+            break;
+        case LOOPBACK_RESPONSE_GET_TWIN:
+            deliver_full_twin(transport, response->get_twin_callback, response->get_twin_context);
+            break;
+        case LOOPBACK_RESPONSE_FULL_TWIN:
+        default:
+            deliver_full_twin(transport, NULL, NULL);
+            break;
+    }
+}
+
+static void destroy_responses(LOOPBACK_TRANSPORT* transport)
+{
+    LOOPBACK_RESPONSE* response;
+
+    while ((response = transport->responses_head) != NULL)
+    {
+        transport->responses_head = response->next;
+        if (response->type == LOOPBACK_RESPONSE_EVENTS)
+        {
+            /* Codes_SRS_IOTHUB_LOOPBACK_TRANSPORT_41_012: [ Events still waiting for their latency when the transport is destroyed or the device unregistered shall be completed with IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY. ] */
+            transport->transport_cb.send_complete_cb(&response->events, IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY, transport->transport_ctx);
+        }
+        free(response);
+    }
+    transport->responses_tail = NULL;
+    transport->pending_event_responses = 0;
+}
+
+static void take_waiting_events(LOOPBACK_TRANSPORT* transport)
+{
+    DLIST_ENTRY completed;
+    PDLIST_ENTRY target;
+    PDLIST_ENTRY entry;
+    LOOPBACK_RESPONSE* response = NULL;
+
+    if (transport->latency == 0)
+    {
+        DList_InitializeListHead(&completed);
+        target = &completed;
+    }
+    else if ((response = queue_response(transport, LOOPBACK_RESPONSE_EVENTS)) == NULL)
+    {
+        // The events stay in waitingToSend until the next DoWork
+        target = NULL;
+    }
+    else
+    {
+        transport->pending_event_responses++;
+        target = &response->events;
+    }
+
+    if (target != NULL)
+    {
+        while ((entry = transport->waitingToSend->Flink) != transport->waitingToSend)
+        {
+            IOTHUB_MESSAGE_LIST* message = containingRecord(entry, IOTHUB_MESSAGE_LIST, entry);
+            (void)DList_RemoveEntryList(entry);
+            DList_InsertTailList(target, entry);
+
+            if (transport->transport_cb.statistics_cb != NULL)
+            {
+                transport->transport_cb.statistics_cb(TRANSPORT_STATISTIC_EVENT_PUBLISHED, message, 0, transport->transport_ctx);
+            }
+            g_statistics.events_confirmed++;
+        }
+
+        if (response == NULL)
+        {
+            /* Codes_SRS_IOTHUB_LOOPBACK_TRANSPORT_41_003: [ Without OPTION_LOOPBACK_LATENCY, IoTHubTransport_DoWork shall confirm every event of waitingToSend with IOTHUB_CLIENT_CONFIRMATION_OK. ] */
+            transport->transport_cb.send_complete_cb(&completed, IOTHUB_CLIENT_CONFIRMATION_OK, transport->transport_ctx);
+        }
+    }
+}
+
+static uint64_t get_injections_due(LOOPBACK_INJECTION* injection, tickcounter_ms_t current_ms)
+{
+    uint64_t result;
+
+    if (!injection->subscribed || injection->rate == 0)
+    {
+        result = 0;
+    }
+    else
+    {
+        uint64_t scheduled;
+
+        if (injection->restart)
+        {
+            injection->started_ms = current_ms;
+            injection->injected = 0;
+            injection->restart = false;
+        }
+
+        // What a DoWork called too late missed is made up on the next one, the rate holds on average
+        scheduled = ((uint64_t)(current_ms - injection->started_ms) * injection->rate) / 1000;
+        result = scheduled - injection->injected;
+        injection->injected = scheduled;
+    }
+
+    return result;
+}
+
+static void inject_message(LOOPBACK_TRANSPORT* transport)
+{
+    IOTHUB_MESSAGE_HANDLE message;
+    MESSAGE_CALLBACK_INFO* message_data;
+
+    if ((message = IoTHubMessage_CreateFromByteArray(transport->payload, transport->payload_size)) == NULL)
+    {
+        LogError("Failed creating the cloud-to-device message");
+    }
+    else if ((message_data = (MESSAGE_CALLBACK_INFO*)malloc(sizeof(MESSAGE_CALLBACK_INFO))) == NULL)
+    {
+        LogError("Failed allocating the cloud-to-device message data");
+        IoTHubMessage_Destroy(message);
+    }
+    else
+    {
+        message_data->messageHandle = message;
+        message_data->transportContext = NULL;
+
+        g_statistics.messages_injected++;
+        if (!transport->transport_cb.msg_cb(message_data, transport->transport_ctx))
+        {
+            LogError("The client did not take the cloud-to-device message");
+            IoTHubMessage_Destroy(message);
+            free(message_data);
+        }
+    }
+}
+
+static void inject_desired_patch(LOOPBACK_TRANSPORT* transport)
+{
+    char payload[TWIN_PAYLOAD_BUFFER_SIZE];
+    int length;
+
+    transport->desired_version++;
+    length = snprintf(payload, sizeof(payload), DESIRED_PATCH_FORMAT, transport->desired_version, transport->desired_version);
+
+    g_statistics.desired_patches_injected++;
+    transport->transport_cb.twin_retrieve_prop_complete_cb(DEVICE_TWIN_UPDATE_PARTIAL, (const unsigned char*)payload, (size_t)length, transport->transport_ctx);
+}
+
+static void inject_method(LOOPBACK_TRANSPORT* transport)
+{
+    // Responses only need telling apart, the id stands for the method handle without allocating one
+    METHOD_HANDLE method_id = (METHOD_HANDLE)(++transport->last_method_id);
+
+    g_statistics.methods_injected++;
+    if (transport->transport_cb.method_complete_cb(INJECTED_METHOD_NAME, transport->payload, transport->payload_size, method_id, transport->transport_ctx) != 0)
+    {
+        LogError("The client did not take the method invocation");
+    }
+}
+
+static TRANSPORT_LL_HANDLE Loopback_Create(const IOTHUBTRANSPORT_CONFIG* config, TRANSPORT_CALLBACKS_INFO* cb_info, void* ctx)
+{
+    LOOPBACK_TRANSPORT* result;
+
+    /* Codes_SRS_IOTHUB_LOOPBACK_TRANSPORT_41_001: [ If config, config->upperConfig or cb_info are NULL, or cb_info is missing a callback, IoTHubTransport_Create shall return NULL. ] */
+    if (config == NULL || config->upperConfig == NULL || cb_info == NULL || IoTHub_Transport_ValidateCallbacks(cb_info) != 0)
+    {
+        LogError("Invalid argument (config=%p, cb_info=%p)", config, cb_info);
+        result = NULL;
+    }
+    else if ((result = (LOOPBACK_TRANSPORT*)malloc(sizeof(LOOPBACK_TRANSPORT))) == NULL)
+    {
+        LogError("Failed allocating LOOPBACK_TRANSPORT");
+    }
+    else
+    {
+        (void)memset(result, 0, sizeof(LOOPBACK_TRANSPORT));
+
+        /* Codes_SRS_IOTHUB_LOOPBACK_TRANSPORT_41_002: [ If any allocation fails, IoTHubTransport_Create shall free what it allocated and return NULL. ] */
+        if ((result->hostname = STRING_construct_sprintf("%s.%s", config->upperConfig->iotHubName, config->upperConfig->iotHubSuffix)) == NULL)
+        {
+            LogError("Failed constructing the hostname");
+            free(result);
+            result = NULL;
+        }
+        else if ((result->tick_counter = tickcounter_create()) == NULL)
+        {
+            LogError("Failed creating the tick counter");
+            STRING_delete(result->hostname);
+            free(result);
+            result = NULL;
+        }
+        else if (set_payload_size(result, DEFAULT_PAYLOAD_SIZE) != 0)
+        {
+            tickcounter_destroy(result->tick_counter);
+            STRING_delete(result->hostname);
+            free(result);
+            result = NULL;
+        }
+        else
+        {
+            result->transport_cb = *cb_info;
+            result->transport_ctx = ctx;
+            result->waitingToSend = config->waitingToSend;
+            result->desired_version = 1;
+        }
+    }
+
+    return result;
+}
+
+static void Loopback_Destroy(TRANSPORT_LL_HANDLE handle)
+{
+    if (handle != NULL)
+    {
+        LOOPBACK_TRANSPORT* transport = (LOOPBACK_TRANSPORT*)handle;
+        destroy_responses(transport);
+        tickcounter_destroy(transport->tick_counter);
+        STRING_delete(transport->hostname);
+        free(transport->payload);
+        free(transport);
+    }
+}
+
+static IOTHUB_DEVICE_HANDLE Loopback_Register(TRANSPORT_LL_HANDLE handle, const IOTHUB_DEVICE_CONFIG* device, PDLIST_ENTRY waitingToSend)
+{
+    IOTHUB_DEVICE_HANDLE result;
+    LOOPBACK_TRANSPORT* transport = (LOOPBACK_TRANSPORT*)handle;
+
+    /* Codes_SRS_IOTHUB_LOOPBACK_TRANSPORT_41_013: [ IoTHubTransport_Register shall fail and return NULL if a device is already registered. ] */
+    if (transport == NULL || device == NULL || waitingToSend == NULL || transport->registered)
+    {
+        LogError("Loopback transport supports exactly one device (handle=%p, device=%p, waitingToSend=%p)", handle, device, waitingToSend);
+        result = NULL;
+    }
+    else
+    {
+        transport->waitingToSend = waitingToSend;
+        transport->registered = true;
+        result = (IOTHUB_DEVICE_HANDLE)transport;
+    }
+
+    return result;
+}
+
+static void Loopback_Unregister(IOTHUB_DEVICE_HANDLE deviceHandle)
+{
+    if (deviceHandle != NULL)
+    {
+        LOOPBACK_TRANSPORT* transport = (LOOPBACK_TRANSPORT*)deviceHandle;
+        destroy_responses(transport);
+        transport->registered = false;
+        transport->connected = false;
+        transport->c2d.subscribed = false;
+        transport->desired.subscribed = false;
+        transport->method.subscribed = false;
+    }
+}
+
+static void Loopback_DoWork(TRANSPORT_LL_HANDLE handle)
+{
+    LOOPBACK_TRANSPORT* transport = (LOOPBACK_TRANSPORT*)handle;
+    tickcounter_ms_t current_ms;
+
+    if (transport == NULL || !transport->registered)
+    {
+        // Nothing to do until a device is registered
+    }
+    else if (tickcounter_get_current_ms(transport->tick_counter, &current_ms) != 0)
+    {
+        LogError("Failed getting the current time");
+    }
+    else
+    {
+        LOOPBACK_RESPONSE* response;
+        uint64_t due;
+
+        if (!transport->connected)
+        {
+            /* Codes_SRS_IOTHUB_LOOPBACK_TRANSPORT_41_014: [ The first IoTHubTransport_DoWork after a device is registered shall report IOTHUB_CLIENT_CONNECTION_AUTHENTICATED through connection_status_cb. ] */
+            transport->connected = true;
+            transport->transport_cb.connection_status_cb(IOTHUB_CLIENT_CONNECTION_AUTHENTICATED, IOTHUB_CLIENT_CONNECTION_OK, transport->transport_ctx);
+        }
+
+        if (!DList_IsListEmpty(transport->waitingToSend))
+        {
+            take_waiting_events(transport);
+        }
+
+        /* Codes_SRS_IOTHUB_LOOPBACK_TRANSPORT_41_005: [ IoTHubTransport_DoWork shall complete, in the order they were made, the responses whose latency has passed. ] */
+        while ((response = transport->responses_head) != NULL && response->due_ms <= current_ms)
+        {
+            transport->responses_head = response->next;
+            if (transport->responses_head == NULL)
+            {
+                transport->responses_tail = NULL;
+            }
+            complete_response(transport, response);
+            free(response);
+        }
+
+        /* Codes_SRS_IOTHUB_LOOPBACK_TRANSPORT_41_008: [ Once the client subscribes to them, IoTHubTransport_DoWork shall inject cloud-to-device messages through msg_cb, desired properties patches through twin_retrieve_prop_complete_cb and method invocations through method_complete_cb, each for as many as their rate has scheduled since the subscription or the last change of the rate. ] */
+        for (due = get_injections_due(&transport->c2d, current_ms); due > 0; due--)
+        {
+            inject_message(transport);
+        }
+        for (due = get_injections_due(&transport->desired, current_ms); due > 0; due--)
+        {
+            inject_desired_patch(transport);
+        }
+        for (due = get_injections_due(&transport->method, current_ms); due > 0; due--)
+        {
+            inject_method(transport);
+        }
+    }
+}
+
+static IOTHUB_CLIENT_RESULT Loopback_GetSendStatus(IOTHUB_DEVICE_HANDLE handle, IOTHUB_CLIENT_STATUS* iotHubClientStatus)
+{
+    IOTHUB_CLIENT_RESULT result;
+    LOOPBACK_TRANSPORT* transport = (LOOPBACK_TRANSPORT*)handle;
+
+    if (transport == NULL || iotHubClientStatus == NULL)
+    {
+        LogError("Invalid argument (handle=%p, iotHubClientStatus=%p)", handle, iotHubClientStatus);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        *iotHubClientStatus = ((transport->waitingToSend == NULL || DList_IsListEmpty(transport->waitingToSend)) && transport->pending_event_responses == 0) ?
+            IOTHUB_CLIENT_SEND_STATUS_IDLE : IOTHUB_CLIENT_SEND_STATUS_BUSY;
+        result = IOTHUB_CLIENT_OK;
+    }
+
+    return result;
+}
+
+static STRING_HANDLE Loopback_GetHostname(TRANSPORT_LL_HANDLE handle)
+{
+    return (handle == NULL) ? NULL : STRING_clone(((LOOPBACK_TRANSPORT*)handle)->hostname);
+}
+
+static void set_injection_rate(LOOPBACK_INJECTION* injection, unsigned int rate)
+{
+    injection->rate = rate;
+    injection->restart = true;
+}
+
+static IOTHUB_CLIENT_RESULT Loopback_SetOption(TRANSPORT_LL_HANDLE handle, const char* optionName, const void* value)
+{
+    IOTHUB_CLIENT_RESULT result;
+    LOOPBACK_TRANSPORT* transport = (LOOPBACK_TRANSPORT*)handle;
+
+    if (transport == NULL || optionName == NULL || value == NULL)
+    {
+        LogError("Invalid argument (handle=%p, optionName=%p, value=%p)", handle, optionName, value);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else if (strcmp(optionName, OPTION_LOOPBACK_LATENCY) == 0)
+    {
+        /* Codes_SRS_IOTHUB_LOOPBACK_TRANSPORT_41_004: [ With OPTION_LOOPBACK_LATENCY, events, reported states and twin requests shall be answered by the first IoTHubTransport_DoWork after that many milliseconds. ] */
+        transport->latency = *(const unsigned int*)value;
+        result = IOTHUB_CLIENT_OK;
+    }
+    else if (strcmp(optionName, OPTION_LOOPBACK_C2D_RATE) == 0)
+    {
+        set_injection_rate(&transport->c2d, *(const unsigned int*)value);
+        result = IOTHUB_CLIENT_OK;
+    }
+    else if (strcmp(optionName, OPTION_LOOPBACK_DESIRED_RATE) == 0)
+    {
+        set_injection_rate(&transport->desired, *(const unsigned int*)value);
+        result = IOTHUB_CLIENT_OK;
+    }
+    else if (strcmp(optionName, OPTION_LOOPBACK_METHOD_RATE) == 0)
+    {
+        set_injection_rate(&transport->method, *(const unsigned int*)value);
+        result = IOTHUB_CLIENT_OK;
+    }
+    else if (strcmp(optionName, OPTION_LOOPBACK_PAYLOAD_SIZE) == 0)
+    {
+        /* Codes_SRS_IOTHUB_LOOPBACK_TRANSPORT_41_009: [ If the payload of OPTION_LOOPBACK_PAYLOAD_SIZE cannot be allocated, IoTHubTransport_SetOption shall return IOTHUB_CLIENT_ERROR and keep the previous payload. ] */
+        result = (set_payload_size(transport, *(const size_t*)value) == 0) ? IOTHUB_CLIENT_OK : IOTHUB_CLIENT_ERROR;
+    }
+    else
+    {
+        /* Codes_SRS_IOTHUB_LOOPBACK_TRANSPORT_41_010: [ IoTHubTransport_SetOption shall accept and ignore every other option, so that an application configured for a network transport runs unchanged. ] */
+        result = IOTHUB_CLIENT_OK;
+    }
+
+    return result;
+}
+
+static int Loopback_SetRetryPolicy(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIENT_RETRY_POLICY retryPolicy, size_t retryTimeoutLimitInSeconds)
+{
+    (void)handle;
+    (void)retryPolicy;
+    (void)retryTimeoutLimitInSeconds;
+    return 0;
+}
+
+static int Loopback_SetCallbackContext(TRANSPORT_LL_HANDLE handle, void* ctx)
+{
+    int result;
+
+    if (handle == NULL)
+    {
+        LogError("Invalid argument handle=NULL");
+        result = __FAILURE__;
+    }
+    else
+    {
+        ((LOOPBACK_TRANSPORT*)handle)->transport_ctx = ctx;
+        result = 0;
+    }
+
+    return result;
+}
+
+static int subscribe_injection(IOTHUB_DEVICE_HANDLE handle, size_t injection_offset)
+{
+    int result;
+
+    if (handle == NULL)
+    {
+        LogError("Invalid argument handle=NULL");
+        result = __FAILURE__;
+    }
+    else
+    {
+        LOOPBACK_INJECTION* injection = (LOOPBACK_INJECTION*)((unsigned char*)handle + injection_offset);
+        injection->subscribed = true;
+        injection->restart = true;
+        result = 0;
+    }
+
+    return result;
+}
+
+static void unsubscribe_injection(IOTHUB_DEVICE_HANDLE handle, size_t injection_offset)
+{
+    if (handle != NULL)
+    {
+        ((LOOPBACK_INJECTION*)((unsigned char*)handle + injection_offset))->subscribed = false;
+    }
+}
+
+static int Loopback_Subscribe(IOTHUB_DEVICE_HANDLE handle)
+{
+    return subscribe_injection(handle, offsetof(LOOPBACK_TRANSPORT, c2d));
+}
+
+static void Loopback_Unsubscribe(IOTHUB_DEVICE_HANDLE handle)
+{
+    unsubscribe_injection(handle, offsetof(LOOPBACK_TRANSPORT, c2d));
+}
+
+static int Loopback_Subscribe_DeviceMethod(IOTHUB_DEVICE_HANDLE handle)
+{
+    return subscribe_injection(handle, offsetof(LOOPBACK_TRANSPORT, method));
+}
+
+static void Loopback_Unsubscribe_DeviceMethod(IOTHUB_DEVICE_HANDLE handle)
+{
+    unsubscribe_injection(handle, offsetof(LOOPBACK_TRANSPORT, method));
+}
+
+static int Loopback_Subscribe_DeviceTwin(IOTHUB_DEVICE_HANDLE handle)
+{
+    int result;
+
+    /* Codes_SRS_IOTHUB_LOOPBACK_TRANSPORT_41_007: [ IoTHubTransport_Subscribe_DeviceTwin shall queue the full twin for twin_retrieve_prop_complete_cb, as a hub does on subscription, and fail if it cannot. ] */
+    if (handle == NULL || queue_response((LOOPBACK_TRANSPORT*)handle, LOOPBACK_RESPONSE_FULL_TWIN) == NULL)
+    {
+        LogError("Failed subscribing to the twin");
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = subscribe_injection(handle, offsetof(LOOPBACK_TRANSPORT, desired));
+    }
+
+    return result;
+}
+
+static void Loopback_Unsubscribe_DeviceTwin(IOTHUB_DEVICE_HANDLE handle)
+{
+    unsubscribe_injection(handle, offsetof(LOOPBACK_TRANSPORT, desired));
+}
+
+static int Loopback_Subscribe_InputQueue(IOTHUB_DEVICE_HANDLE handle)
+{
+    (void)handle;
+    return 0;
+}
+
+static void Loopback_Unsubscribe_InputQueue(IOTHUB_DEVICE_HANDLE handle)
+{
+    (void)handle;
+}
+
+static IOTHUB_CLIENT_RESULT Loopback_SendMessageDisposition(MESSAGE_CALLBACK_INFO* messageData, IOTHUBMESSAGE_DISPOSITION_RESULT disposition)
+{
+    IOTHUB_CLIENT_RESULT result;
+    (void)disposition;
+
+    if (messageData == NULL || messageData->messageHandle == NULL)
+    {
+        LogError("Invalid argument messageData=%p", messageData);
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else
+    {
+        /* Codes_SRS_IOTHUB_LOOPBACK_TRANSPORT_41_011: [ IoTHubTransport_SendMessageDisposition shall destroy the message and free messageData. ] */
+        g_statistics.messages_disposed++;
+        IoTHubMessage_Destroy(messageData->messageHandle);
+        result = IOTHUB_CLIENT_OK;
+    }
+    free(messageData);
+
+    return result;
+}
+
+static int Loopback_DeviceMethod_Response(IOTHUB_DEVICE_HANDLE handle, METHOD_HANDLE methodId, const unsigned char* response, size_t response_size, int status_response)
+{
+    int result;
+    (void)response;
+    (void)response_size;
+    (void)status_response;
+
+    if (handle == NULL || methodId == NULL)
+    {
+        LogError("Invalid argument (handle=%p, methodId=%p)", handle, methodId);
+        result = __FAILURE__;
+    }
+    else
+    {
+        g_statistics.method_responses++;
+        result = 0;
+    }
+
+    return result;
+}
+
+static IOTHUB_PROCESS_ITEM_RESULT Loopback_ProcessItem(TRANSPORT_LL_HANDLE handle, IOTHUB_IDENTITY_TYPE item_type, IOTHUB_IDENTITY_INFO* iothub_item)
+{
+    IOTHUB_PROCESS_ITEM_RESULT result;
+    LOOPBACK_RESPONSE* response;
+
+    if (handle == NULL || iothub_item == NULL)
+    {
+        LogError("Invalid argument (handle=%p, iothub_item=%p)", handle, iothub_item);
+        result = IOTHUB_PROCESS_ERROR;
+    }
+    else if (item_type != IOTHUB_TYPE_DEVICE_TWIN)
+    {
+        result = IOTHUB_PROCESS_CONTINUE;
+    }
+    /* Codes_SRS_IOTHUB_LOOPBACK_TRANSPORT_41_006: [ IoTHubTransport_ProcessItem shall queue the acknowledgement of a reported state, completed through twin_rpt_state_complete_cb with status 204, and return IOTHUB_PROCESS_ERROR if it cannot. ] */
+    else if ((response = queue_response((LOOPBACK_TRANSPORT*)handle, LOOPBACK_RESPONSE_REPORTED_STATE)) == NULL)
+    {
+        result = IOTHUB_PROCESS_ERROR;
+    }
+    else
+    {
+        response->item_id = iothub_item->device_twin->item_id;
+        result = IOTHUB_PROCESS_OK;
+    }
+
+    return result;
+}
+
+static IOTHUB_CLIENT_RESULT Loopback_GetTwinAsync(IOTHUB_DEVICE_HANDLE handle, IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK completionCallback, void* callbackContext)
+{
+    IOTHUB_CLIENT_RESULT result;
+    LOOPBACK_RESPONSE* response;
+
+    if (handle == NULL || completionCallback == NULL)
+    {
+        LogError("Invalid argument (handle=%p, completionCallback=%p)", handle, completionCallback);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else if ((response = queue_response((LOOPBACK_TRANSPORT*)handle, LOOPBACK_RESPONSE_GET_TWIN)) == NULL)
+    {
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else
+    {
+        response->get_twin_callback = completionCallback;
+        response->get_twin_context = callbackContext;
+        result = IOTHUB_CLIENT_OK;
+    }
+
+    return result;
+}
+
+static TRANSPORT_PROVIDER loopback_provider =
+{
+    Loopback_SendMessageDisposition,    /*pfIotHubTransport_SendMessageDisposition IoTHubTransport_SendMessageDisposition;*/
+    Loopback_Subscribe_DeviceMethod,    /*pfIoTHubTransport_Subscribe_DeviceMethod IoTHubTransport_Subscribe_DeviceMethod;*/
+    Loopback_Unsubscribe_DeviceMethod,  /*pfIoTHubTransport_Unsubscribe_DeviceMethod IoTHubTransport_Unsubscribe_DeviceMethod;*/
+    Loopback_DeviceMethod_Response,     /*pfIoTHubTransport_DeviceMethod_Response IoTHubTransport_DeviceMethod_Response;*/
+    Loopback_Subscribe_DeviceTwin,      /*pfIoTHubTransport_Subscribe_DeviceTwin IoTHubTransport_Subscribe_DeviceTwin;*/
+    Loopback_Unsubscribe_DeviceTwin,    /*pfIoTHubTransport_Unsubscribe_DeviceTwin IoTHubTransport_Unsubscribe_DeviceTwin;*/
+    Loopback_ProcessItem,               /*pfIoTHubTransport_ProcessItem IoTHubTransport_ProcessItem;*/
+    Loopback_GetHostname,               /*pfIoTHubTransport_GetHostname IoTHubTransport_GetHostname;*/
+    Loopback_SetOption,                 /*pfIoTHubTransport_SetOption IoTHubTransport_SetOption;*/
+    Loopback_Create,                    /*pfIoTHubTransport_Create IoTHubTransport_Create;*/
+    Loopback_Destroy,                   /*pfIoTHubTransport_Destroy IoTHubTransport_Destroy;*/
+    Loopback_Register,                  /*pfIotHubTransport_Register IoTHubTransport_Register;*/
+    Loopback_Unregister,                /*pfIotHubTransport_Unregister IoTHubTransport_Unegister;*/
+    Loopback_Subscribe,                 /*pfIoTHubTransport_Subscribe IoTHubTransport_Subscribe;*/
+    Loopback_Unsubscribe,               /*pfIoTHubTransport_Unsubscribe IoTHubTransport_Unsubscribe;*/
+    Loopback_DoWork,                    /*pfIoTHubTransport_DoWork IoTHubTransport_DoWork;*/
+    Loopback_SetRetryPolicy,            /*pfIoTHubTransport_DoWork IoTHubTransport_SetRetryPolicy;*/
+    Loopback_GetSendStatus,             /*pfIoTHubTransport_GetSendStatus IoTHubTransport_GetSendStatus;*/
+    Loopback_Subscribe_InputQueue,      /*pfIoTHubTransport_Subscribe_InputQueue IoTHubTransport_Subscribe_InputQueue; */
+    Loopback_Unsubscribe_InputQueue,    /*pfIoTHubTransport_Unsubscribe_InputQueue IoTHubTransport_Unsubscribe_InputQueue; */
+    Loopback_SetCallbackContext,        /*pfIoTHubTransport_SetCallbackContext IoTHubTransport_SetCallbackContext; */
+    Loopback_GetTwinAsync               /*pfIoTHubTransport_GetTwinAsync IoTHubTransport_GetTwinAsync;*/
+};
+
+const TRANSPORT_PROVIDER* Loopback_Protocol(void)
+{
+    return &loopback_provider;
+}
+
+void Loopback_GetStatistics(LOOPBACK_TRANSPORT_STATISTICS* statistics)
+{
+    /* Codes_SRS_IOTHUB_LOOPBACK_TRANSPORT_41_015: [ Loopback_GetStatistics shall copy the counters of every loopback transport of the process into statistics, and Loopback_ResetStatistics shall set them to 0. ] */
+    if (statistics != NULL)
+    {
+        *statistics = g_statistics;
+    }
+}
+
+void Loopback_ResetStatistics(void)
+{
+    (void)memset(&g_statistics, 0, sizeof(g_statistics));
+}
@@ -7,6 +7,7 @@
 #include "azure_c_shared_utility/tlsio.h"
 #include "azure_c_shared_utility/platform.h"
 #include "internal/iothubtransport_mqtt_common.h"
+#include "internal/iothub_client_coalescing_io.h"
 #include "azure_c_shared_utility/xlogging.h"
 
 static XIO_HANDLE getIoTransportProvider(const char* fully_qualified_name, const MQTT_TRANSPORT_PROXY_OPTIONS* mqtt_transport_proxy_options)
@@ -38,7 +39,23 @@ static XIO_HANDLE getIoTransportProvider(const char* fully_qualified_name, const
         tls_io_config.underlying_io_parameters = NULL;
 
         /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_012: [ `getIoTransportProvider` shall return the `XIO_HANDLE` returned by `xio_create`. ] */
-        result = xio_create(io_interface_description, &tls_io_config);
+        if ((result = xio_create(io_interface_description, &tls_io_config)) != NULL)
+        {
+            COALESCING_IO_CONFIG coalescing_io_config;
+            XIO_HANDLE coalescing_io;
+
+            /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_001: [ `getIoTransportProvider` shall put the TLS IO under a coalescing IO, created with `xio_create`, the interface returned by `coalescing_io_get_interface_description` and a `COALESCING_IO_CONFIG` whose `underlying_io` is the TLS IO, and return the coalescing IO. ]*/
+            coalescing_io_config.underlying_io = result;
+            if ((coalescing_io = xio_create(coalescing_io_get_interface_description(), &coalescing_io_config)) == NULL)
+            {
+                /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_41_002: [ If the coalescing IO cannot be created, `getIoTransportProvider` shall return the TLS IO. ]*/
+                LogError("Cannot coalesce the writes of the TLS IO, each goes in a record of its own");
+            }
+            else
+            {
+                result = coalescing_io;
+            }
+        }
     }
     return result;
 }
@@ -0,0 +1,215 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <string.h>
+#include "iothubtransportmqtt_local.h"
+#include "azure_c_shared_utility/xio.h"
+#include "azure_c_shared_utility/socketio.h"
+#include "azure_c_shared_utility/envvariable.h"
+#include "azure_c_shared_utility/shared_util_options.h"
+#include "internal/iothubtransport_mqtt_common.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+static const char* ENVIRONMENT_VAR_EDGEHUB_LOCAL_SOCKET = "EdgeHubLocalSocket";
+
+static XIO_HANDLE getLocalIoTransportProvider(const char* fully_qualified_name, const MQTT_TRANSPORT_PROXY_OPTIONS* mqtt_transport_proxy_options)
+{
+    XIO_HANDLE result;
+    const char* socket_path;
+    const IO_INTERFACE_DESCRIPTION* io_interface_description;
+    (void)fully_qualified_name;
+    (void)mqtt_transport_proxy_options;
+
+    /* Codes_SRS_IOTHUB_MQTT_LOCAL_TRANSPORT_41_001: [ If the EdgeHubLocalSocket environment variable is not set, getLocalIoTransportProvider shall return NULL. ] */
+    if ((socket_path = environment_get_variable(ENVIRONMENT_VAR_EDGEHUB_LOCAL_SOCKET)) == NULL)
+    {
+        LogError("Environment variable %s is not set", ENVIRONMENT_VAR_EDGEHUB_LOCAL_SOCKET);
+        result = NULL;
+    }
+    /* Codes_SRS_IOTHUB_MQTT_LOCAL_TRANSPORT_41_002: [ If socketio_get_interface_description returns NULL, getLocalIoTransportProvider shall return NULL. ] */
+    else if ((io_interface_description = socketio_get_interface_description()) == NULL)
+    {
+        LogError("Failure constructing the provider interface");
+        result = NULL;
+    }
+    else
+    {
+        /* Codes_SRS_IOTHUB_MQTT_LOCAL_TRANSPORT_41_003: [ getLocalIoTransportProvider shall create a socket IO whose hostname is the socket path and whose port is 0. ] */
+        SOCKETIO_CONFIG socketio_config;
+        socketio_config.hostname = socket_path;
+        socketio_config.port = 0;
+        socketio_config.accepted_socket = NULL;
+
+        if ((result = xio_create(io_interface_description, &socketio_config)) == NULL)
+        {
+            LogError("Failure creating the socket IO for %s", socket_path);
+        }
+        /* Codes_SRS_IOTHUB_MQTT_LOCAL_TRANSPORT_41_004: [ getLocalIoTransportProvider shall set OPTION_ADDRESS_TYPE to OPTION_ADDRESS_TYPE_DOMAIN_SOCKET on the socket IO. ] */
+        else if (xio_setoption(result, OPTION_ADDRESS_TYPE, OPTION_ADDRESS_TYPE_DOMAIN_SOCKET) != 0)
+        {
+            /* Codes_SRS_IOTHUB_MQTT_LOCAL_TRANSPORT_41_005: [ If setting OPTION_ADDRESS_TYPE fails, getLocalIoTransportProvider shall destroy the socket IO and return NULL. ] */
+            LogError("The socket IO of this platform does not support unix domain sockets");
+            xio_destroy(result);
+            result = NULL;
+        }
+    }
+
+    return result;
+}
+
+static TRANSPORT_LL_HANDLE IoTHubTransportMqtt_Local_Create(const IOTHUBTRANSPORT_CONFIG* config, TRANSPORT_CALLBACKS_INFO* cb_info, void* ctx)
+{
+    return IoTHubTransport_MQTT_Common_Create(config, getLocalIoTransportProvider, cb_info, ctx);
+}
+
+static void IoTHubTransportMqtt_Local_Destroy(TRANSPORT_LL_HANDLE handle)
+{
+    IoTHubTransport_MQTT_Common_Destroy(handle);
+}
+
+static int IoTHubTransportMqtt_Local_Subscribe(IOTHUB_DEVICE_HANDLE handle)
+{
+    return IoTHubTransport_MQTT_Common_Subscribe(handle);
+}
+
+static void IoTHubTransportMqtt_Local_Unsubscribe(IOTHUB_DEVICE_HANDLE handle)
+{
+    IoTHubTransport_MQTT_Common_Unsubscribe(handle);
+}
+
+static int IoTHubTransportMqtt_Local_Subscribe_DeviceMethod(IOTHUB_DEVICE_HANDLE handle)
+{
+    return IoTHubTransport_MQTT_Common_Subscribe_DeviceMethod(handle);
+}
+
+static void IoTHubTransportMqtt_Local_Unsubscribe_DeviceMethod(IOTHUB_DEVICE_HANDLE handle)
+{
+    IoTHubTransport_MQTT_Common_Unsubscribe_DeviceMethod(handle);
+}
+
+static int IoTHubTransportMqtt_Local_Subscribe_DeviceTwin(IOTHUB_DEVICE_HANDLE handle)
+{
+    return IoTHubTransport_MQTT_Common_Subscribe_DeviceTwin(handle);
+}
+
+static void IoTHubTransportMqtt_Local_Unsubscribe_DeviceTwin(IOTHUB_DEVICE_HANDLE handle)
+{
+    IoTHubTransport_MQTT_Common_Unsubscribe_DeviceTwin(handle);
+}
+
+static IOTHUB_CLIENT_RESULT IoTHubTransportMqtt_Local_GetTwinAsync(IOTHUB_DEVICE_HANDLE handle, IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK completionCallback, void* callbackContext)
+{
+    return IoTHubTransport_MQTT_Common_GetTwinAsync(handle, completionCallback, callbackContext);
+}
+
+static int IoTHubTransportMqtt_Local_DeviceMethod_Response(IOTHUB_DEVICE_HANDLE handle, METHOD_HANDLE methodId, const unsigned char* response, size_t response_size, int status_response)
+{
+    return IoTHubTransport_MQTT_Common_DeviceMethod_Response(handle, methodId, response, response_size, status_response);
+}
+
+static IOTHUB_CLIENT_RESULT IoTHubTransportMqtt_Local_SendMessageDisposition(MESSAGE_CALLBACK_INFO* message_data, IOTHUBMESSAGE_DISPOSITION_RESULT disposition)
+{
+    return IoTHubTransport_MQTT_Common_SendMessageDisposition(message_data, disposition);
+}
+
+static IOTHUB_PROCESS_ITEM_RESULT IoTHubTransportMqtt_Local_ProcessItem(TRANSPORT_LL_HANDLE handle, IOTHUB_IDENTITY_TYPE item_type, IOTHUB_IDENTITY_INFO* iothub_item)
+{
+    return IoTHubTransport_MQTT_Common_ProcessItem(handle, item_type, iothub_item);
+}
+
+static void IoTHubTransportMqtt_Local_DoWork(TRANSPORT_LL_HANDLE handle)
+{
+    IoTHubTransport_MQTT_Common_DoWork(handle);
+}
+
+static int IoTHubTransportMqtt_Local_SetRetryPolicy(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIENT_RETRY_POLICY retryPolicy, size_t retryTimeoutLimitInSeconds)
+{
+    return IoTHubTransport_MQTT_Common_SetRetryPolicy(handle, retryPolicy, retryTimeoutLimitInSeconds);
+}
+
+static IOTHUB_CLIENT_RESULT IoTHubTransportMqtt_Local_GetSendStatus(IOTHUB_DEVICE_HANDLE handle, IOTHUB_CLIENT_STATUS *iotHubClientStatus)
+{
+    return IoTHubTransport_MQTT_Common_GetSendStatus(handle, iotHubClientStatus);
+}
+
+static IOTHUB_CLIENT_RESULT IoTHubTransportMqtt_Local_SetOption(TRANSPORT_LL_HANDLE handle, const char* option, const void* value)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if ((handle != NULL) && (option != NULL) && (strcmp(option, OPTION_TRUSTED_CERT) == 0))
+    {
+        /* Codes_SRS_IOTHUB_MQTT_LOCAL_TRANSPORT_41_006: [ IoTHubTransportMqtt_Local_SetOption shall accept and ignore OPTION_TRUSTED_CERT, as there is no TLS layer to give it to. ] */
+        LogInfo("The local socket to edgeHub does not use TLS, %s is ignored", option);
+        result = IOTHUB_CLIENT_OK;
+    }
+    else
+    {
+        /* Codes_SRS_IOTHUB_MQTT_LOCAL_TRANSPORT_41_007: [ Otherwise IoTHubTransportMqtt_Local_SetOption shall call into IoTHubTransport_MQTT_Common_SetOption. ] */
+        result = IoTHubTransport_MQTT_Common_SetOption(handle, option, value);
+    }
+
+    return result;
+}
+
+static IOTHUB_DEVICE_HANDLE IoTHubTransportMqtt_Local_Register(TRANSPORT_LL_HANDLE handle, const IOTHUB_DEVICE_CONFIG* device, PDLIST_ENTRY waitingToSend)
+{
+    return IoTHubTransport_MQTT_Common_Register(handle, device, waitingToSend);
+}
+
+static void IoTHubTransportMqtt_Local_Unregister(IOTHUB_DEVICE_HANDLE deviceHandle)
+{
+    IoTHubTransport_MQTT_Common_Unregister(deviceHandle);
+}
+
+static STRING_HANDLE IoTHubTransportMqtt_Local_GetHostname(TRANSPORT_LL_HANDLE handle)
+{
+    return IoTHubTransport_MQTT_Common_GetHostname(handle);
+}
+
+static int IotHubTransportMqtt_Local_Subscribe_InputQueue(IOTHUB_DEVICE_HANDLE handle)
+{
+    return IoTHubTransport_MQTT_Common_Subscribe_InputQueue(handle);
+}
+
+static void IotHubTransportMqtt_Local_Unsubscribe_InputQueue(IOTHUB_DEVICE_HANDLE handle)
+{
+    IoTHubTransport_MQTT_Common_Unsubscribe_InputQueue(handle);
+}
+
+static int IotHubTransportMqtt_Local_SetCallbackContext(TRANSPORT_LL_HANDLE handle, void* ctx)
+{
+    return IoTHubTransport_MQTT_SetCallbackContext(handle, ctx);
+}
+
+/* Codes_SRS_IOTHUB_MQTT_LOCAL_TRANSPORT_41_008: [ MQTT_Local_Protocol shall return a TRANSPORT_PROVIDER whose functions call into the matching IoTHubTransport_MQTT_Common functions, except SetOption. ] */
+static TRANSPORT_PROVIDER myfunc =
+{
+    IoTHubTransportMqtt_Local_SendMessageDisposition,     /*pfIotHubTransport_SendMessageDisposition IoTHubTransport_SendMessageDisposition;*/
+    IoTHubTransportMqtt_Local_Subscribe_DeviceMethod,     /*pfIoTHubTransport_Subscribe_DeviceMethod IoTHubTransport_Subscribe_DeviceMethod;*/
+    IoTHubTransportMqtt_Local_Unsubscribe_DeviceMethod,   /*pfIoTHubTransport_Unsubscribe_DeviceMethod IoTHubTransport_Unsubscribe_DeviceMethod;*/
+    IoTHubTransportMqtt_Local_DeviceMethod_Response,      /*pfIoTHubTransport_DeviceMethod_Response IoTHubTransport_DeviceMethod_Response;*/
+    IoTHubTransportMqtt_Local_Subscribe_DeviceTwin,       /*pfIoTHubTransport_Subscribe_DeviceTwin IoTHubTransport_Subscribe_DeviceTwin;*/
+    IoTHubTransportMqtt_Local_Unsubscribe_DeviceTwin,     /*pfIoTHubTransport_Unsubscribe_DeviceTwin IoTHubTransport_Unsubscribe_DeviceTwin;*/
+    IoTHubTransportMqtt_Local_ProcessItem,                /*pfIoTHubTransport_ProcessItem IoTHubTransport_ProcessItem;*/
+    IoTHubTransportMqtt_Local_GetHostname,                /*pfIoTHubTransport_GetHostname IoTHubTransport_GetHostname;*/
+    IoTHubTransportMqtt_Local_SetOption,                  /*pfIoTHubTransport_SetOption IoTHubTransport_SetOption;*/
+    IoTHubTransportMqtt_Local_Create,                     /*pfIoTHubTransport_Create IoTHubTransport_Create;*/
+    IoTHubTransportMqtt_Local_Destroy,                    /*pfIoTHubTransport_Destroy IoTHubTransport_Destroy;*/
+    IoTHubTransportMqtt_Local_Register,                   /*pfIotHubTransport_Register IoTHubTransport_Register;*/
+    IoTHubTransportMqtt_Local_Unregister,                 /*pfIotHubTransport_Unregister IoTHubTransport_Unegister;*/
+    IoTHubTransportMqtt_Local_Subscribe,                  /*pfIoTHubTransport_Subscribe IoTHubTransport_Subscribe;*/
+    IoTHubTransportMqtt_Local_Unsubscribe,                /*pfIoTHubTransport_Unsubscribe IoTHubTransport_Unsubscribe;*/
+    IoTHubTransportMqtt_Local_DoWork,                     /*pfIoTHubTransport_DoWork IoTHubTransport_DoWork;*/
+    IoTHubTransportMqtt_Local_SetRetryPolicy,             /*pfIoTHubTransport_DoWork IoTHubTransport_SetRetryPolicy;*/
+    IoTHubTransportMqtt_Local_GetSendStatus,              /*pfIoTHubTransport_GetSendStatus IoTHubTransport_GetSendStatus;*/
+    IotHubTransportMqtt_Local_Subscribe_InputQueue,       /*pfIoTHubTransport_Subscribe_InputQueue IoTHubTransport_Subscribe_InputQueue; */
+    IotHubTransportMqtt_Local_Unsubscribe_InputQueue,     /*pfIoTHubTransport_Unsubscribe_InputQueue IoTHubTransport_Unsubscribe_InputQueue; */
+    IotHubTransportMqtt_Local_SetCallbackContext,         /*pfIoTHubTransport_SetCallbackContext IoTHubTransport_SetCallbackContext; */
+    IoTHubTransportMqtt_Local_GetTwinAsync                /*pfIoTHubTransport_GetTwinAsync IoTHubTransport_GetTwinAsync;*/
+};
+
+extern const TRANSPORT_PROVIDER* MQTT_Local_Protocol(void)
+{
+    return &myfunc;
+}
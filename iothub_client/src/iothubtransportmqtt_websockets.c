@@ -9,6 +9,7 @@
 #include "azure_c_shared_utility/http_proxy_io.h"
 #include "iothubtransportmqtt_websockets.h"
 #include "internal/iothubtransport_mqtt_common.h"
+#include "internal/iothub_client_coalescing_io.h"
 
 static XIO_HANDLE getWebSocketsIOTransport(const char* fully_qualified_name, const MQTT_TRANSPORT_PROXY_OPTIONS* mqtt_transport_proxy_options)
 {
@@ -95,7 +96,23 @@ static XIO_HANDLE getWebSocketsIOTransport(const char* fully_qualified_name, con
 
         /* Codes_SRS_IOTHUB_MQTT_WEBSOCKET_TRANSPORT_07_012: [ `getIoTransportProvider` shall return the `XIO_HANDLE` returned by `xio_create`. ] */
         /* Codes_SRS_IOTHUB_MQTT_WEBSOCKET_TRANSPORT_01_002: [ `getIoTransportProvider` shall call `xio_create` while passing the WebSocket IO interface description to it and the WebSocket configuration as a WSIO_CONFIG structure, filled as below ]*/
-        result = xio_create(io_interface_description, &ws_io_config);
+        if ((result = xio_create(io_interface_description, &ws_io_config)) != NULL)
+        {
+            COALESCING_IO_CONFIG coalescing_io_config;
+            XIO_HANDLE coalescing_io;
+
+            /* Codes_SRS_IOTHUB_MQTT_WEBSOCKET_TRANSPORT_41_001: [ `getIoTransportProvider` shall put the WebSocket IO under a coalescing IO, created with `xio_create`, the interface returned by `coalescing_io_get_interface_description` and a `COALESCING_IO_CONFIG` whose `underlying_io` is the WebSocket IO, and return the coalescing IO. ]*/
+            coalescing_io_config.underlying_io = result;
+            if ((coalescing_io = xio_create(coalescing_io_get_interface_description(), &coalescing_io_config)) == NULL)
+            {
+                /* Codes_SRS_IOTHUB_MQTT_WEBSOCKET_TRANSPORT_41_002: [ If the coalescing IO cannot be created, `getIoTransportProvider` shall return the WebSocket IO. ]*/
+                LogError("Cannot coalesce the writes of the WebSocket IO, each goes in a frame of its own");
+            }
+            else
+            {
+                result = coalescing_io;
+            }
+        }
     }
     return result;
 }
@@ -3,58 +3,336 @@
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include "azure_c_shared_utility/optimize_size.h"
 #include "azure_c_shared_utility/crt_abstractions.h"
 #include "azure_c_shared_utility/gballoc.h"
-#include "azure_c_shared_utility/agenttime.h"
+#include "azure_c_shared_utility/tickcounter.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/singlylinkedlist.h"
 
 typedef struct MESSAGE_QUEUE_TAG MESSAGE_QUEUE;
 
 #include "internal/message_queue.h"
+#include "internal/iothub_client_memory_private.h"
+#include "internal/iothub_client_retry_control.h"
 
 #define RESULT_OK 0
-#define INDEFINITE_TIME ((time_t)(-1))
+#define INDEFINITE_TIME ((tickcounter_ms_t)(-1))
+#define MILLISECONDS_PER_SECOND 1000
+#define PRIORITY_LANE_COUNT ((size_t)MESSAGE_QUEUE_PRIORITY_HIGH + 1)
+#ifdef MESSAGE_QUEUE_STATIC_POOL_SIZE
+// Smallest power of two that keeps a full pool at most 3/4 of the in-progress index
+#define IN_PROGRESS_INDEX_INITIAL_SIZE get_in_progress_index_initial_size()
+#else
+#define IN_PROGRESS_INDEX_INITIAL_SIZE 16
+#endif
 
 static const char* SAVED_OPTION_MAX_RETRY_COUNT = "SAVED_OPTION_MAX_RETRY_COUNT";
-static const char* SAVED_OPTION_MAX_ENQUEUE_TIME_SECS = "SAVED_OPTION_MAX_ENQUEUE_TIME_SECS";
-static const char* SAVED_OPTION_MAX_PROCESSING_TIME_SECS = "SAVED_OPTION_MAX_PROCESSING_TIME_SECS";
+static const char* SAVED_OPTION_MAX_ENQUEUE_TIME_MS = "SAVED_OPTION_MAX_ENQUEUE_TIME_MS";
+static const char* SAVED_OPTION_MAX_PROCESSING_TIME_MS = "SAVED_OPTION_MAX_PROCESSING_TIME_MS";
+static const char* SAVED_OPTION_RETRY_POLICY = "SAVED_OPTION_RETRY_POLICY";
 
 
+typedef struct IN_PROGRESS_INDEX_ENTRY_TAG
+{
+    MQ_MESSAGE_HANDLE message;
+    LIST_ITEM_HANDLE list_item;
+} IN_PROGRESS_INDEX_ENTRY;
+
+typedef struct MESSAGE_QUEUE_ITEM_TAG
+{
+    MQ_MESSAGE_HANDLE message;
+    MESSAGE_PROCESSING_COMPLETED_CALLBACK on_message_processing_completed_callback;
+    void* user_context;
+    tickcounter_ms_t enqueue_time;
+    tickcounter_ms_t processing_start_time;
+    size_t number_of_attempts;
+    MESSAGE_QUEUE_PRIORITY priority;
+    size_t size;
+    // Set while the item waits in its pending list for `backoff_wait_secs` after `backoff_start_time` before being retried.
+    bool backing_off;
+    tickcounter_ms_t backoff_start_time;
+    unsigned int backoff_wait_secs;
+#ifdef MESSAGE_QUEUE_STATIC_POOL_SIZE
+    struct MESSAGE_QUEUE_ITEM_TAG* next_free;
+#endif
+} MESSAGE_QUEUE_ITEM;
+
 struct MESSAGE_QUEUE_TAG
 {
-    size_t max_message_enqueued_time_secs;
-    size_t max_message_processing_time_secs;
+    // All the times of the queue are read from this monotonic clock, so that its timeouts have millisecond
+    // resolution and do not move when the wall clock is adjusted.
+    TICK_COUNTER_HANDLE tick_counter;
+    size_t max_message_enqueued_time_ms;
+    size_t max_message_processing_time_ms;
     size_t max_retry_count;
 
     PROCESS_MESSAGE_CALLBACK on_process_message_callback;
     void* on_process_message_context;
 
-    SINGLYLINKEDLIST_HANDLE pending;
+    // One pending list per MESSAGE_QUEUE_PRIORITY. The MESSAGE_QUEUE_PRIORITY_NORMAL list is created with
+    // the queue, the others only once a message of that priority is added (NULL until then).
+    SINGLYLINKEDLIST_HANDLE pending[PRIORITY_LANE_COUNT];
     SINGLYLINKEDLIST_HANDLE in_progress;
+
+    // Open-addressing index of `in_progress` keyed by message pointer, so completions do not scan the list.
+    // `in_progress_index_size` is a power of two and the index is kept at most 3/4 full.
+    IN_PROGRESS_INDEX_ENTRY* in_progress_index;
+    size_t in_progress_index_size;
+    size_t in_progress_count;
+
+    // Lower bound of the enqueue time of the messages in `in_progress` (which is ordered by processing start, not
+    // enqueue time). It is tightened whenever in_progress is scanned, and lets process_timeouts skip that scan
+    // while no in-progress message can have exceeded `max_message_enqueued_time_ms`.
+    tickcounter_ms_t in_progress_earliest_enqueue_time;
+
+    // Bounds of the pending lists (zero means unbounded) and what message_queue_add does when they are reached.
+    size_t max_pending_count;
+    size_t max_pending_bytes;
+    MESSAGE_QUEUE_OVERFLOW_POLICY overflow_policy;
+    MESSAGE_QUEUE_GET_MESSAGE_SIZE get_message_size;
+    size_t pending_count;
+    size_t pending_bytes;
+
+    // Paces the retries of each message (NULL retries at once); `backing_off_count` pending items are not due yet,
+    // and while it is zero the pending lists are processed from their heads without reading the clock.
+    RETRY_CONTROL_HANDLE retry_control;
+    size_t retry_policy;
+    size_t backing_off_count;
+
+    // The `mq_item`s in use, summed with the other queues and clients by IoTHubClient_Memory_GetUsage.
+    IOTHUB_CLIENT_MEMORY_COUNTERS memory_counters;
+
+#ifdef MESSAGE_QUEUE_STATIC_POOL_SIZE
+    // Every mq_item comes from `item_pool`, allocated with the queue; unused items are chained from `free_items`.
+    // The in-progress index is sized for a full pool when the queue is created, so it never grows either.
+    MESSAGE_QUEUE_ITEM item_pool[MESSAGE_QUEUE_STATIC_POOL_SIZE];
+    MESSAGE_QUEUE_ITEM* free_items;
+#endif
 };
 
-typedef struct MESSAGE_QUEUE_ITEM_TAG
+
+
+// ---------- Helper Functions ---------- //
+
+#ifdef MESSAGE_QUEUE_STATIC_POOL_SIZE
+static size_t get_in_progress_index_initial_size(void)
 {
-    MQ_MESSAGE_HANDLE message;
-    MESSAGE_PROCESSING_COMPLETED_CALLBACK on_message_processing_completed_callback;
-    void* user_context;
-    time_t enqueue_time;
-    time_t processing_start_time;
-    size_t number_of_attempts;
-} MESSAGE_QUEUE_ITEM;
+    size_t result = 16;
+    while (result * 3 < (size_t)MESSAGE_QUEUE_STATIC_POOL_SIZE * 4)
+    {
+        result *= 2;
+    }
+    return result;
+}
+#endif
 
+static MESSAGE_QUEUE_ITEM* create_mq_item(MESSAGE_QUEUE_HANDLE message_queue)
+{
+    MESSAGE_QUEUE_ITEM* result;
+#ifdef MESSAGE_QUEUE_STATIC_POOL_SIZE
+    // Codes_SRS_MESSAGE_QUEUE_41_026: [If MESSAGE_QUEUE_STATIC_POOL_SIZE is defined, `mq_item` shall be taken from the pool of `message_queue` instead, and message_queue_add shall fail and return non-zero when the pool is empty]
+    if ((result = message_queue->free_items) != NULL)
+    {
+        message_queue->free_items = result->next_free;
+    }
+#else
+    result = (MESSAGE_QUEUE_ITEM*)malloc(sizeof(MESSAGE_QUEUE_ITEM));
+#endif
+    // Codes_SRS_MESSAGE_QUEUE_41_027: [Every `mq_item` in use shall be counted in IOTHUB_CLIENT_MEMORY_TRANSPORT of the memory counters of `message_queue`, which are registered with the memory accounting while the queue exists]
+    if (result != NULL)
+    {
+        IOTHUB_CLIENT_MEMORY_ADD(&message_queue->memory_counters, IOTHUB_CLIENT_MEMORY_TRANSPORT, sizeof(MESSAGE_QUEUE_ITEM));
+    }
+    return result;
+}
 
+static void destroy_mq_item(MESSAGE_QUEUE_HANDLE message_queue, MESSAGE_QUEUE_ITEM* mq_item)
+{
+    IOTHUB_CLIENT_MEMORY_REMOVE(&message_queue->memory_counters, IOTHUB_CLIENT_MEMORY_TRANSPORT, sizeof(MESSAGE_QUEUE_ITEM));
+#ifdef MESSAGE_QUEUE_STATIC_POOL_SIZE
+    mq_item->next_free = message_queue->free_items;
+    message_queue->free_items = mq_item;
+#else
+    free(mq_item);
+#endif
+}
 
-// ---------- Helper Functions ---------- //
+static size_t get_in_progress_index_slot(MESSAGE_QUEUE_HANDLE message_queue, MQ_MESSAGE_HANDLE message)
+{
+    // Fibonacci hashing; the low bits of heap pointers carry little entropy.
+    return (size_t)(((uintptr_t)message >> 3) * (uintptr_t)2654435761u) & (message_queue->in_progress_index_size - 1);
+}
+
+static void insert_into_in_progress_index(MESSAGE_QUEUE_HANDLE message_queue, MQ_MESSAGE_HANDLE message, LIST_ITEM_HANDLE list_item)
+{
+    size_t slot = get_in_progress_index_slot(message_queue, message);
+
+    while (message_queue->in_progress_index[slot].list_item != NULL)
+    {
+        slot = (slot + 1) & (message_queue->in_progress_index_size - 1);
+    }
+
+    message_queue->in_progress_index[slot].message = message;
+    message_queue->in_progress_index[slot].list_item = list_item;
+}
+
+static int grow_in_progress_index(MESSAGE_QUEUE_HANDLE message_queue)
+{
+    int result;
+    IN_PROGRESS_INDEX_ENTRY* new_index;
+    size_t new_size = message_queue->in_progress_index_size * 2;
+
+    if ((new_index = (IN_PROGRESS_INDEX_ENTRY*)malloc(new_size * sizeof(IN_PROGRESS_INDEX_ENTRY))) == NULL)
+    {
+        LogError("failed growing in-progress index to %lu entries", (unsigned long)new_size);
+        result = __FAILURE__;
+    }
+    else
+    {
+        IN_PROGRESS_INDEX_ENTRY* old_index = message_queue->in_progress_index;
+        size_t old_size = message_queue->in_progress_index_size;
+        size_t i;
+
+        memset(new_index, 0, new_size * sizeof(IN_PROGRESS_INDEX_ENTRY));
+        message_queue->in_progress_index = new_index;
+        message_queue->in_progress_index_size = new_size;
+
+        for (i = 0; i < old_size; i++)
+        {
+            if (old_index[i].list_item != NULL)
+            {
+                insert_into_in_progress_index(message_queue, old_index[i].message, old_index[i].list_item);
+            }
+        }
+
+        free(old_index);
+        result = RESULT_OK;
+    }
+
+    return result;
+}
+
+static int add_to_in_progress_index(MESSAGE_QUEUE_HANDLE message_queue, MQ_MESSAGE_HANDLE message, LIST_ITEM_HANDLE list_item)
+{
+    int result;
+
+    if ((message_queue->in_progress_count + 1) * 4 > message_queue->in_progress_index_size * 3 &&
+        grow_in_progress_index(message_queue) != RESULT_OK)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        insert_into_in_progress_index(message_queue, message, list_item);
+        message_queue->in_progress_count++;
+        result = RESULT_OK;
+    }
+
+    return result;
+}
 
-static bool find_item_by_message_ptr(LIST_ITEM_HANDLE list_item, const void* match_context)
+static LIST_ITEM_HANDLE find_in_progress_list_item(MESSAGE_QUEUE_HANDLE message_queue, MQ_MESSAGE_HANDLE message)
 {
-    MESSAGE_QUEUE_ITEM* current_item = (MESSAGE_QUEUE_ITEM*)singlylinkedlist_item_get_value(list_item);
-    MQ_MESSAGE_HANDLE* target_item = (MQ_MESSAGE_HANDLE*)match_context;
+    size_t slot = get_in_progress_index_slot(message_queue, message);
 
-    return (current_item->message == target_item);
+    while (message_queue->in_progress_index[slot].list_item != NULL && message_queue->in_progress_index[slot].message != message)
+    {
+        slot = (slot + 1) & (message_queue->in_progress_index_size - 1);
+    }
+
+    return message_queue->in_progress_index[slot].list_item;
+}
+
+static void remove_from_in_progress_index(MESSAGE_QUEUE_HANDLE message_queue, LIST_ITEM_HANDLE list_item, MQ_MESSAGE_HANDLE message)
+{
+    size_t mask = message_queue->in_progress_index_size - 1;
+    size_t slot = get_in_progress_index_slot(message_queue, message);
+
+    while (message_queue->in_progress_index[slot].list_item != NULL && message_queue->in_progress_index[slot].list_item != list_item)
+    {
+        slot = (slot + 1) & mask;
+    }
+
+    if (message_queue->in_progress_index[slot].list_item != NULL)
+    {
+        size_t next = (slot + 1) & mask;
+
+        // Backward-shift deletion: pull later entries of the probe sequence into the hole so lookups never stop early.
+        while (message_queue->in_progress_index[next].list_item != NULL)
+        {
+            size_t home = get_in_progress_index_slot(message_queue, message_queue->in_progress_index[next].message);
+
+            if (((next - home) & mask) >= ((next - slot) & mask))
+            {
+                message_queue->in_progress_index[slot] = message_queue->in_progress_index[next];
+                slot = next;
+            }
+
+            next = (next + 1) & mask;
+        }
+
+        message_queue->in_progress_index[slot].message = NULL;
+        message_queue->in_progress_index[slot].list_item = NULL;
+        message_queue->in_progress_count--;
+    }
+}
+
+static int remove_from_list(MESSAGE_QUEUE_HANDLE message_queue, SINGLYLINKEDLIST_HANDLE list, LIST_ITEM_HANDLE list_item, MESSAGE_QUEUE_ITEM* mq_item)
+{
+    int result;
+
+    if (singlylinkedlist_remove(list, list_item) != 0)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        if (list == message_queue->in_progress)
+        {
+            remove_from_in_progress_index(message_queue, list_item, mq_item->message);
+        }
+        else if (list == message_queue->pending[mq_item->priority])
+        {
+            message_queue->pending_count--;
+            message_queue->pending_bytes -= mq_item->size;
+
+            if (mq_item->backing_off)
+            {
+                mq_item->backing_off = false;
+                message_queue->backing_off_count--;
+            }
+        }
+
+        result = RESULT_OK;
+    }
+
+    return result;
+}
+
+static int add_to_pending(MESSAGE_QUEUE_HANDLE message_queue, MESSAGE_QUEUE_ITEM* mq_item)
+{
+    int result;
+
+    if (singlylinkedlist_add(message_queue->pending[mq_item->priority], (const void*)mq_item) == NULL)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        message_queue->pending_count++;
+        message_queue->pending_bytes += mq_item->size;
+
+        if (mq_item->backing_off)
+        {
+            message_queue->backing_off_count++;
+        }
+
+        result = RESULT_OK;
+    }
+
+    return result;
 }
 
 static void fire_message_callback(MESSAGE_QUEUE_ITEM* mq_item, MESSAGE_QUEUE_RESULT result, void* reason)
@@ -70,11 +348,55 @@ static void fire_message_callback(MESSAGE_QUEUE_ITEM* mq_item, MESSAGE_QUEUE_RES
     }
 }
 
+static tickcounter_ms_t get_current_time(MESSAGE_QUEUE_HANDLE message_queue)
+{
+    tickcounter_ms_t result;
+
+    if (tickcounter_get_current_ms(message_queue->tick_counter, &result) != 0)
+    {
+        result = INDEFINITE_TIME;
+    }
+
+    return result;
+}
+
+static tickcounter_ms_t get_elapsed_time(tickcounter_ms_t current_time, tickcounter_ms_t start_time)
+{
+    return (current_time > start_time ? current_time - start_time : 0);
+}
+
 static bool should_retry_sending(MESSAGE_QUEUE_HANDLE message_queue, MESSAGE_QUEUE_ITEM* mq_item, MESSAGE_QUEUE_RESULT result)
 {
     return (result == MESSAGE_QUEUE_RETRYABLE_ERROR && mq_item->number_of_attempts <= message_queue->max_retry_count);
 }
 
+static void start_backoff(MESSAGE_QUEUE_HANDLE message_queue, MESSAGE_QUEUE_ITEM* mq_item)
+{
+    unsigned int wait_secs;
+    tickcounter_ms_t current_time;
+
+    // Codes_SRS_MESSAGE_QUEUE_41_030: [If a retry policy is set, the wait before the retry shall be obtained using retry_control_get_wait_time() passing `mq_item->number_of_attempts` and the previous wait of `mq_item`]
+    if (retry_control_get_wait_time(message_queue->retry_control, (unsigned int)mq_item->number_of_attempts, mq_item->backoff_wait_secs, &wait_secs) != 0)
+    {
+        // Codes_SRS_MESSAGE_QUEUE_41_032: [If retry_control_get_wait_time() or tickcounter_get_current_ms() fail, the message shall be retried without waiting]
+        LogError("failed getting the retry wait time of message (%p); retrying it at once", mq_item->message);
+    }
+    else if (wait_secs > 0)
+    {
+        if ((current_time = get_current_time(message_queue)) == INDEFINITE_TIME)
+        {
+            LogError("failed getting the time of retry of message (%p); retrying it at once", mq_item->message);
+        }
+        else
+        {
+            // Codes_SRS_MESSAGE_QUEUE_41_031: [If the wait is not zero, the message shall not be processed again until that many seconds after tickcounter_get_current_ms()]
+            mq_item->backing_off = true;
+            mq_item->backoff_start_time = current_time;
+            mq_item->backoff_wait_secs = wait_secs;
+        }
+    }
+}
+
 static int retry_sending_message(MESSAGE_QUEUE_HANDLE message_queue, LIST_ITEM_HANDLE list_item)
 {
     int result;
@@ -82,12 +404,18 @@ static int retry_sending_message(MESSAGE_QUEUE_HANDLE message_queue, LIST_ITEM_H
 
     mq_item = (MESSAGE_QUEUE_ITEM*)singlylinkedlist_item_get_value(list_item);
 
-    if (singlylinkedlist_remove(message_queue->in_progress, list_item))
+    if (message_queue->retry_control != NULL)
+    {
+        start_backoff(message_queue, mq_item);
+    }
+
+    if (remove_from_list(message_queue, message_queue->in_progress, list_item, mq_item) != RESULT_OK)
     {
         LogError("Failed removing message from in-progress list");
         result = __FAILURE__;
     }
-    else if (singlylinkedlist_add(message_queue->pending, (const void*)mq_item) == NULL)
+    // Codes_SRS_MESSAGE_QUEUE_41_004: [A message to be re-sent shall be moved back to the pending list of its own priority]
+    else if (add_to_pending(message_queue, mq_item) != RESULT_OK)
     {
         LogError("Failed moving message back to pending list");
         result = __FAILURE__;
@@ -100,12 +428,12 @@ static int retry_sending_message(MESSAGE_QUEUE_HANDLE message_queue, LIST_ITEM_H
     return result;
 }
 
-static void dequeue_message_and_fire_callback(SINGLYLINKEDLIST_HANDLE list, LIST_ITEM_HANDLE list_item, MESSAGE_QUEUE_RESULT result, void* reason)
+static void dequeue_message_and_fire_callback(MESSAGE_QUEUE_HANDLE message_queue, SINGLYLINKEDLIST_HANDLE list, LIST_ITEM_HANDLE list_item, MESSAGE_QUEUE_RESULT result, void* reason)
 {
     MESSAGE_QUEUE_ITEM* mq_item = (MESSAGE_QUEUE_ITEM*)singlylinkedlist_item_get_value(list_item);
 
     // Codes_SRS_MESSAGE_QUEUE_09_045: [If `message` is present in `message_queue->in_progress`, it shall be removed]
-    if (singlylinkedlist_remove(list, list_item))
+    if (remove_from_list(message_queue, list, list_item, mq_item) != RESULT_OK)
     {
         LogError("failed removing message from list (%p)", list);
     }
@@ -114,7 +442,7 @@ static void dequeue_message_and_fire_callback(SINGLYLINKEDLIST_HANDLE list, LIST
     fire_message_callback(mq_item, result, reason);
 
     // Codes_SRS_MESSAGE_QUEUE_09_050: [The `mq_item` related to `message` shall be freed]
-    free(mq_item);
+    destroy_mq_item(message_queue, mq_item);
 }
 
 static void on_process_message_completed_callback(MESSAGE_QUEUE_HANDLE message_queue, MQ_MESSAGE_HANDLE message, MESSAGE_QUEUE_RESULT result, USER_DEFINED_REASON reason)
@@ -128,7 +456,8 @@ static void on_process_message_completed_callback(MESSAGE_QUEUE_HANDLE message_q
     {
         LIST_ITEM_HANDLE list_item;
 
-        if ((list_item = singlylinkedlist_find(message_queue->in_progress, find_item_by_message_ptr, message)) == NULL)
+        // Codes_SRS_MESSAGE_QUEUE_41_007: [`message` shall be looked up in `message_queue->in_progress` through the in-progress index, without scanning the list]
+        if ((list_item = find_in_progress_list_item(message_queue, message)) == NULL)
         {
             // Codes_SRS_MESSAGE_QUEUE_09_044: [If `message` is not present in `message_queue->in_progress`, it shall be ignored]
             LogError("on_process_message_completed_callback invoked for a message not in the in-progress list (%p)", message);
@@ -141,73 +470,192 @@ static void on_process_message_completed_callback(MESSAGE_QUEUE_HANDLE message_q
             // Codes_SRS_MESSAGE_QUEUE_09_048: [If `result` is MESSAGE_QUEUE_RETRYABLE_ERROR and `mq_item->number_of_attempts` is greater than `message_queue->max_retry_count`, result shall be changed to MESSAGE_QUEUE_ERROR]
             if (!should_retry_sending(message_queue, mq_item, result) || retry_sending_message(message_queue, list_item) != RESULT_OK)
             {
-                dequeue_message_and_fire_callback(message_queue->in_progress, list_item, result, reason);
+                dequeue_message_and_fire_callback(message_queue, message_queue->in_progress, list_item, result, reason);
             }
         }
     }
 }
 
-static void process_timeouts(MESSAGE_QUEUE_HANDLE message_queue)
+static bool pending_limits_exceeded(MESSAGE_QUEUE_HANDLE message_queue, size_t additional_bytes)
+{
+    return (message_queue->max_pending_count > 0 && message_queue->pending_count + 1 > message_queue->max_pending_count) ||
+        (message_queue->max_pending_bytes > 0 && message_queue->pending_bytes + additional_bytes > message_queue->max_pending_bytes);
+}
+
+// Returns the pending list whose head shall be dropped to make room for a message of `priority`, or NULL if none may be.
+static SINGLYLINKEDLIST_HANDLE get_overflow_victim_list(MESSAGE_QUEUE_HANDLE message_queue, MESSAGE_QUEUE_PRIORITY priority)
 {
-    time_t current_time;
+    SINGLYLINKEDLIST_HANDLE result = NULL;
+    size_t lane;
 
-    if ((current_time = get_time(NULL)) == INDEFINITE_TIME)
+    if (message_queue->overflow_policy == MESSAGE_QUEUE_OVERFLOW_DROP_OLDEST)
     {
-        LogError("failed processing timeouts (get_time failed)");
+        MESSAGE_QUEUE_ITEM* oldest_item = NULL;
+
+        for (lane = 0; lane < PRIORITY_LANE_COUNT; lane++)
+        {
+            LIST_ITEM_HANDLE head;
+
+            if (message_queue->pending[lane] != NULL && (head = singlylinkedlist_get_head_item(message_queue->pending[lane])) != NULL)
+            {
+                MESSAGE_QUEUE_ITEM* mq_item = (MESSAGE_QUEUE_ITEM*)singlylinkedlist_item_get_value(head);
+
+                if (mq_item != NULL && (oldest_item == NULL || mq_item->enqueue_time < oldest_item->enqueue_time))
+                {
+                    oldest_item = mq_item;
+                    result = message_queue->pending[lane];
+                }
+            }
+        }
+    }
+    else if (message_queue->overflow_policy == MESSAGE_QUEUE_OVERFLOW_DROP_LOWEST_PRIORITY)
+    {
+        // Only messages of the same or lower priority than the one being added may be dropped for it.
+        for (lane = 0; lane <= (size_t)priority && result == NULL; lane++)
+        {
+            if (message_queue->pending[lane] != NULL && singlylinkedlist_get_head_item(message_queue->pending[lane]) != NULL)
+            {
+                result = message_queue->pending[lane];
+            }
+        }
+    }
+
+    return result;
+}
+
+static int make_room_for_message(MESSAGE_QUEUE_HANDLE message_queue, MESSAGE_QUEUE_PRIORITY priority, size_t message_size)
+{
+    int result;
+
+    if (message_queue->max_pending_bytes > 0 && message_size > message_queue->max_pending_bytes)
+    {
+        // Codes_SRS_MESSAGE_QUEUE_41_020: [A message larger than the maximum pending bytes shall be rejected without dropping any message]
+        LogError("message of %lu bytes exceeds the maximum pending bytes (%lu)", (unsigned long)message_size, (unsigned long)message_queue->max_pending_bytes);
+        result = __FAILURE__;
     }
     else
     {
-        // Codes_SRS_MESSAGE_QUEUE_09_035: [If `message_queue->max_message_enqueued_time_secs` is greater than zero, `message_queue->in_progress` and `message_queue->pending` items shall be checked for timeout]
-        if (message_queue->max_message_enqueued_time_secs > 0)
+        result = RESULT_OK;
+
+        while (pending_limits_exceeded(message_queue, message_size))
         {
-            LIST_ITEM_HANDLE list_item = singlylinkedlist_get_head_item(message_queue->pending);
+            SINGLYLINKEDLIST_HANDLE victim_list;
 
-            while (list_item != NULL)
+            // Codes_SRS_MESSAGE_QUEUE_41_021: [If `message_queue->overflow_policy` is MESSAGE_QUEUE_OVERFLOW_REJECT, message_queue_add shall fail and return non-zero]
+            // Codes_SRS_MESSAGE_QUEUE_41_022: [If `message_queue->overflow_policy` is MESSAGE_QUEUE_OVERFLOW_DROP_OLDEST, the pending message enqueued first shall be removed and its callback invoked with MESSAGE_QUEUE_CANCELLED, until `message` fits]
+            // Codes_SRS_MESSAGE_QUEUE_41_023: [If `message_queue->overflow_policy` is MESSAGE_QUEUE_OVERFLOW_DROP_LOWEST_PRIORITY, the oldest pending message of the lowest priority not above `priority` shall be removed and its callback invoked with MESSAGE_QUEUE_CANCELLED, until `message` fits]
+            // Codes_SRS_MESSAGE_QUEUE_41_024: [If no pending message can be removed and `message` still does not fit, message_queue_add shall fail and return non-zero]
+            if ((victim_list = get_overflow_victim_list(message_queue, priority)) == NULL)
             {
-                LIST_ITEM_HANDLE current_list_item = list_item;
-                MESSAGE_QUEUE_ITEM* mq_item = (MESSAGE_QUEUE_ITEM*)singlylinkedlist_item_get_value(current_list_item);
+                result = __FAILURE__;
+                break;
+            }
+            else
+            {
+                dequeue_message_and_fire_callback(message_queue, victim_list, singlylinkedlist_get_head_item(victim_list), MESSAGE_QUEUE_CANCELLED, NULL);
+            }
+        }
+    }
 
-                list_item = singlylinkedlist_get_next_item(list_item);
+    return result;
+}
 
-                if (mq_item == NULL)
-                {
-                    LogError("failed processing timeouts (unexpected NULL pointer to MESSAGE_QUEUE_ITEM)");
-                }
-                else if (get_difftime(current_time, mq_item->enqueue_time) >= message_queue->max_message_enqueued_time_secs)
-                {
-                    // Codes_SRS_MESSAGE_QUEUE_09_036: [If any items are in `message_queue` lists for `message_queue->max_message_enqueued_time_secs` or more, they shall be removed and `message_queue->on_message_processing_completed_callback` invoked with MESSAGE_QUEUE_TIMEOUT]
-                    dequeue_message_and_fire_callback(message_queue->pending, current_list_item, MESSAGE_QUEUE_TIMEOUT, NULL);
-                }
-                else
+static void process_pending_list_timeouts(MESSAGE_QUEUE_HANDLE message_queue, SINGLYLINKEDLIST_HANDLE pending, tickcounter_ms_t current_time)
+{
+    LIST_ITEM_HANDLE list_item = singlylinkedlist_get_head_item(pending);
+
+    while (list_item != NULL)
+    {
+        LIST_ITEM_HANDLE current_list_item = list_item;
+        MESSAGE_QUEUE_ITEM* mq_item = (MESSAGE_QUEUE_ITEM*)singlylinkedlist_item_get_value(current_list_item);
+
+        list_item = singlylinkedlist_get_next_item(list_item);
+
+        if (mq_item == NULL)
+        {
+            LogError("failed processing timeouts (unexpected NULL pointer to MESSAGE_QUEUE_ITEM)");
+        }
+        else if (get_elapsed_time(current_time, mq_item->enqueue_time) >= message_queue->max_message_enqueued_time_ms)
+        {
+            // Codes_SRS_MESSAGE_QUEUE_09_036: [If any items are in `message_queue` lists for `message_queue->max_message_enqueued_time_ms` or more, they shall be removed and `message_queue->on_message_processing_completed_callback` invoked with MESSAGE_QUEUE_TIMEOUT]
+            dequeue_message_and_fire_callback(message_queue, pending, current_list_item, MESSAGE_QUEUE_TIMEOUT, NULL);
+        }
+        else
+        {
+            // The pending list order is already based on enqueue time, so if one message is not expired, later ones won't be either.
+            break;
+        }
+    }
+}
+
+static void process_timeouts(MESSAGE_QUEUE_HANDLE message_queue)
+{
+    tickcounter_ms_t current_time;
+
+    if ((current_time = get_current_time(message_queue)) == INDEFINITE_TIME)
+    {
+        LogError("failed processing timeouts (tickcounter_get_current_ms failed)");
+    }
+    else
+    {
+        // Codes_SRS_MESSAGE_QUEUE_09_035: [If `message_queue->max_message_enqueued_time_ms` is greater than zero, `message_queue->in_progress` and `message_queue->pending` items shall be checked for timeout]
+        if (message_queue->max_message_enqueued_time_ms > 0)
+        {
+            LIST_ITEM_HANDLE list_item;
+            size_t lane;
+
+            // Codes_SRS_MESSAGE_QUEUE_41_005: [The pending lists of all priorities shall be checked for timeout]
+            for (lane = PRIORITY_LANE_COUNT; lane > 0; lane--)
+            {
+                if (message_queue->pending[lane - 1] != NULL)
                 {
-                    // The pending list order is already based on enqueue time, so if one message is not expired, later ones won't be either.
-                    break;
+                    process_pending_list_timeouts(message_queue, message_queue->pending[lane - 1], current_time);
                 }
             }
 
-            list_item = singlylinkedlist_get_head_item(message_queue->in_progress);
-
-            while (list_item != NULL)
+            // Codes_SRS_MESSAGE_QUEUE_41_013: [`message_queue->in_progress` shall only be checked for enqueue timeout if it is not empty and its earliest enqueue time is `message_queue->max_message_enqueued_time_ms` or more in the past]
+            if (message_queue->in_progress_count > 0 &&
+                get_elapsed_time(current_time, message_queue->in_progress_earliest_enqueue_time) >= message_queue->max_message_enqueued_time_ms)
             {
-                LIST_ITEM_HANDLE current_list_item = list_item;
-                MESSAGE_QUEUE_ITEM* mq_item = (MESSAGE_QUEUE_ITEM*)singlylinkedlist_item_get_value(current_list_item);
+                bool any_remaining = false;
+                tickcounter_ms_t oldest_remaining_age = 0;
 
-                list_item = singlylinkedlist_get_next_item(list_item);
+                list_item = singlylinkedlist_get_head_item(message_queue->in_progress);
 
-                if (mq_item == NULL)
+                while (list_item != NULL)
                 {
-                    LogError("failed processing timeouts (unexpected NULL pointer to MESSAGE_QUEUE_ITEM)");
-                }
-                else if (get_difftime(current_time, mq_item->enqueue_time) >= message_queue->max_message_enqueued_time_secs)
-                {
-                    // Codes_SRS_MESSAGE_QUEUE_09_038: [If any items are in `message_queue->in_progress` for `message_queue->max_message_processing_time_secs` or more, they shall be removed and `message_queue->on_message_processing_completed_callback` invoked with MESSAGE_QUEUE_TIMEOUT]
-                    dequeue_message_and_fire_callback(message_queue->in_progress, current_list_item, MESSAGE_QUEUE_TIMEOUT, NULL);
+                    LIST_ITEM_HANDLE current_list_item = list_item;
+                    MESSAGE_QUEUE_ITEM* mq_item = (MESSAGE_QUEUE_ITEM*)singlylinkedlist_item_get_value(current_list_item);
+
+                    list_item = singlylinkedlist_get_next_item(list_item);
+
+                    if (mq_item == NULL)
+                    {
+                        LogError("failed processing timeouts (unexpected NULL pointer to MESSAGE_QUEUE_ITEM)");
+                    }
+                    else
+                    {
+                        tickcounter_ms_t age = get_elapsed_time(current_time, mq_item->enqueue_time);
+
+                        if (age >= message_queue->max_message_enqueued_time_ms)
+                        {
+                            // Codes_SRS_MESSAGE_QUEUE_09_038: [If any items are in `message_queue->in_progress` for `message_queue->max_message_processing_time_ms` or more, they shall be removed and `message_queue->on_message_processing_completed_callback` invoked with MESSAGE_QUEUE_TIMEOUT]
+                            dequeue_message_and_fire_callback(message_queue, message_queue->in_progress, current_list_item, MESSAGE_QUEUE_TIMEOUT, NULL);
+                        }
+                        else if (!any_remaining || age > oldest_remaining_age)
+                        {
+                            // Codes_SRS_MESSAGE_QUEUE_41_014: [The earliest enqueue time of `message_queue->in_progress` shall be updated with the messages that did not expire]
+                            any_remaining = true;
+                            oldest_remaining_age = age;
+                            message_queue->in_progress_earliest_enqueue_time = mq_item->enqueue_time;
+                        }
+                    }
                 }
             }
         }
 
-        // Codes_SRS_MESSAGE_QUEUE_09_037: [If `message_queue->max_message_processing_time_secs` is greater than zero, `message_queue->in_progress` items shall be checked for timeout]
-        if (message_queue->max_message_processing_time_secs > 0)
+        // Codes_SRS_MESSAGE_QUEUE_09_037: [If `message_queue->max_message_processing_time_ms` is greater than zero, `message_queue->in_progress` items shall be checked for timeout]
+        if (message_queue->max_message_processing_time_ms > 0)
         {
             LIST_ITEM_HANDLE list_item = singlylinkedlist_get_head_item(message_queue->in_progress);
 
@@ -222,9 +670,9 @@ static void process_timeouts(MESSAGE_QUEUE_HANDLE message_queue)
                 {
                     LogError("failed processing timeouts (unexpected NULL pointer to MESSAGE_QUEUE_ITEM)");
                 }
-                else if (get_difftime(current_time, mq_item->processing_start_time) >= message_queue->max_message_processing_time_secs)
+                else if (get_elapsed_time(current_time, mq_item->processing_start_time) >= message_queue->max_message_processing_time_ms)
                 {
-                    dequeue_message_and_fire_callback(message_queue->in_progress, current_list_item, MESSAGE_QUEUE_TIMEOUT, NULL);
+                    dequeue_message_and_fire_callback(message_queue, message_queue->in_progress, current_list_item, MESSAGE_QUEUE_TIMEOUT, NULL);
                 }
                 else
                 {
@@ -236,11 +684,52 @@ static void process_timeouts(MESSAGE_QUEUE_HANDLE message_queue)
     }
 }
 
-static void process_pending_messages(MESSAGE_QUEUE_HANDLE message_queue)
+static bool is_due(MESSAGE_QUEUE_HANDLE message_queue, MESSAGE_QUEUE_ITEM* mq_item, tickcounter_ms_t* current_time)
+{
+    bool result;
+
+    if (!mq_item->backing_off)
+    {
+        result = true;
+    }
+    else if (*current_time == INDEFINITE_TIME && (*current_time = get_current_time(message_queue)) == INDEFINITE_TIME)
+    {
+        LogError("failed getting the time to check retry of message (%p)", mq_item->message);
+        result = true;
+    }
+    else
+    {
+        result = (get_elapsed_time(*current_time, mq_item->backoff_start_time) >= (tickcounter_ms_t)mq_item->backoff_wait_secs * MILLISECONDS_PER_SECOND);
+    }
+
+    return result;
+}
+
+// Returns the first item of `pending` that is not backing off, or whose wait is over, or NULL if there is none.
+static LIST_ITEM_HANDLE get_next_due_item(MESSAGE_QUEUE_HANDLE message_queue, SINGLYLINKEDLIST_HANDLE pending, tickcounter_ms_t* current_time)
+{
+    LIST_ITEM_HANDLE result = singlylinkedlist_get_head_item(pending);
+
+    if (message_queue->backing_off_count > 0)
+    {
+        MESSAGE_QUEUE_ITEM* mq_item;
+
+        while (result != NULL && (mq_item = (MESSAGE_QUEUE_ITEM*)singlylinkedlist_item_get_value(result)) != NULL && !is_due(message_queue, mq_item, current_time))
+        {
+            result = singlylinkedlist_get_next_item(result);
+        }
+    }
+
+    return result;
+}
+
+static void process_pending_list(MESSAGE_QUEUE_HANDLE message_queue, SINGLYLINKEDLIST_HANDLE pending, tickcounter_ms_t* current_time)
 {
     LIST_ITEM_HANDLE list_item;
+    LIST_ITEM_HANDLE in_progress_item;
 
-    while ((list_item = singlylinkedlist_get_head_item(message_queue->pending)) != NULL)
+    // Codes_SRS_MESSAGE_QUEUE_41_033: [Messages backing off shall be skipped, in their place in the pending list, until their wait is over, while the messages behind them are processed]
+    while ((list_item = get_next_due_item(message_queue, pending, current_time)) != NULL)
     {
         MESSAGE_QUEUE_ITEM* mq_item = (MESSAGE_QUEUE_ITEM*)singlylinkedlist_item_get_value(list_item);
 
@@ -249,7 +738,7 @@ static void process_pending_messages(MESSAGE_QUEUE_HANDLE message_queue)
             LogError("internal error, failed to retrieve list node value");
             break;
         }
-        else if (singlylinkedlist_remove(message_queue->pending, list_item) != 0)
+        else if (remove_from_list(message_queue, pending, list_item, mq_item) != RESULT_OK)
         {
             LogError("failed moving message out of pending list (%p)", mq_item->message);
 
@@ -263,10 +752,10 @@ static void process_pending_messages(MESSAGE_QUEUE_HANDLE message_queue)
 
             break; // Trying to avoid an infinite loop
         }
-        // Codes_SRS_MESSAGE_QUEUE_09_040: [`mq_item->processing_start_time` shall be set using get_time()]
-        else if ((mq_item->processing_start_time = get_time(NULL)) == INDEFINITE_TIME)
+        // Codes_SRS_MESSAGE_QUEUE_09_040: [`mq_item->processing_start_time` shall be set using tickcounter_get_current_ms()]
+        else if ((mq_item->processing_start_time = get_current_time(message_queue)) == INDEFINITE_TIME)
         {
-            // Codes_SRS_MESSAGE_QUEUE_09_041: [If get_time() fails, `mq_item` shall be removed from `message_queue->in_progress`]
+            // Codes_SRS_MESSAGE_QUEUE_09_041: [If tickcounter_get_current_ms() fails, `mq_item` shall be removed from `message_queue->in_progress`]
             LogError("failed setting message processing_start_time (%p)", mq_item->message);
 
             // Codes_SRS_MESSAGE_QUEUE_09_042: [If any failures occur, `mq_item->on_message_processing_completed_callback` shall be invoked with MESSAGE_QUEUE_ERROR and `mq_item` freed]
@@ -275,10 +764,10 @@ static void process_pending_messages(MESSAGE_QUEUE_HANDLE message_queue)
                 mq_item->on_message_processing_completed_callback(mq_item->message, MESSAGE_QUEUE_ERROR, NULL, mq_item->user_context);
             }
 
-            free(mq_item);
+            destroy_mq_item(message_queue, mq_item);
         }
         // Codes_SRS_MESSAGE_QUEUE_09_039: [Each `mq_item` in `message_queue->pending` shall be moved to `message_queue->in_progress`]
-        else if (singlylinkedlist_add(message_queue->in_progress, (const void*)mq_item) == NULL)
+        else if ((in_progress_item = singlylinkedlist_add(message_queue->in_progress, (const void*)mq_item)) == NULL)
         {
             LogError("failed moving message to in-progress list (%p)", mq_item->message);
 
@@ -288,10 +777,30 @@ static void process_pending_messages(MESSAGE_QUEUE_HANDLE message_queue)
                 mq_item->on_message_processing_completed_callback(mq_item->message, MESSAGE_QUEUE_ERROR, NULL, mq_item->user_context);
             }
 
-            free(mq_item);
+            destroy_mq_item(message_queue, mq_item);
+        }
+        // Codes_SRS_MESSAGE_QUEUE_41_008: [`mq_item` shall be added to the in-progress index, which shall be doubled in size using malloc() when it becomes more than 3/4 full]
+        else if (add_to_in_progress_index(message_queue, mq_item->message, in_progress_item) != RESULT_OK)
+        {
+            LogError("failed indexing in-progress message (%p)", mq_item->message);
+
+            (void)singlylinkedlist_remove(message_queue->in_progress, in_progress_item);
+
+            // Codes_SRS_MESSAGE_QUEUE_09_042: [If any failures occur, `mq_item->on_message_processing_completed_callback` shall be invoked with MESSAGE_QUEUE_ERROR and `mq_item` freed]
+            if (mq_item->on_message_processing_completed_callback != NULL)
+            {
+                mq_item->on_message_processing_completed_callback(mq_item->message, MESSAGE_QUEUE_ERROR, NULL, mq_item->user_context);
+            }
+
+            destroy_mq_item(message_queue, mq_item);
         }
         else
         {
+            if (message_queue->in_progress_count == 1 || mq_item->enqueue_time < message_queue->in_progress_earliest_enqueue_time)
+            {
+                message_queue->in_progress_earliest_enqueue_time = mq_item->enqueue_time;
+            }
+
             mq_item->number_of_attempts++;
 
             // Codes_SRS_MESSAGE_QUEUE_09_043: [If no failures occur, `message_queue->on_process_message_callback` shall be invoked passing `mq_item->message` and `on_process_message_completed_callback`]
@@ -300,6 +809,22 @@ static void process_pending_messages(MESSAGE_QUEUE_HANDLE message_queue)
     }
 }
 
+static void process_pending_messages(MESSAGE_QUEUE_HANDLE message_queue)
+{
+    size_t lane;
+    // Read once, by the first check of a message backing off
+    tickcounter_ms_t current_time = INDEFINITE_TIME;
+
+    // Codes_SRS_MESSAGE_QUEUE_41_003: [message_queue_do_work shall process all pending messages of a priority before any pending message of a lower priority]
+    for (lane = PRIORITY_LANE_COUNT; lane > 0; lane--)
+    {
+        if (message_queue->pending[lane - 1] != NULL)
+        {
+            process_pending_list(message_queue, message_queue->pending[lane - 1], &current_time);
+        }
+    }
+}
+
 static void* cloneOption(const char* name, const void* value)
 {
     void* result;
@@ -309,9 +834,10 @@ static void* cloneOption(const char* name, const void* value)
         LogError("invalid argument (name=%p, value=%p)", name, value);
         result = NULL;
     }
-    else if (strcmp(SAVED_OPTION_MAX_ENQUEUE_TIME_SECS, name) == 0 ||
-        strcmp(SAVED_OPTION_MAX_PROCESSING_TIME_SECS, name) == 0 ||
-        strcmp(SAVED_OPTION_MAX_RETRY_COUNT, name) == 0)
+    else if (strcmp(SAVED_OPTION_MAX_ENQUEUE_TIME_MS, name) == 0 ||
+        strcmp(SAVED_OPTION_MAX_PROCESSING_TIME_MS, name) == 0 ||
+        strcmp(SAVED_OPTION_MAX_RETRY_COUNT, name) == 0 ||
+        strcmp(SAVED_OPTION_RETRY_POLICY, name) == 0)
     {
         if ((result = malloc(sizeof(size_t))) == NULL)
         {
@@ -337,9 +863,10 @@ static void destroyOption(const char* name, const void* value)
     {
         LogError("invalid argument (name=%p, value=%p)", name, value);
     }
-    else if (strcmp(SAVED_OPTION_MAX_ENQUEUE_TIME_SECS, name) == 0 ||
-        strcmp(SAVED_OPTION_MAX_PROCESSING_TIME_SECS, name) == 0 ||
-        strcmp(SAVED_OPTION_MAX_RETRY_COUNT, name) == 0)
+    else if (strcmp(SAVED_OPTION_MAX_ENQUEUE_TIME_MS, name) == 0 ||
+        strcmp(SAVED_OPTION_MAX_PROCESSING_TIME_MS, name) == 0 ||
+        strcmp(SAVED_OPTION_MAX_RETRY_COUNT, name) == 0 ||
+        strcmp(SAVED_OPTION_RETRY_POLICY, name) == 0)
     {
         free((void*)value);
     }
@@ -359,25 +886,35 @@ void message_queue_remove_all(MESSAGE_QUEUE_HANDLE message_queue)
     if (message_queue != NULL)
     {
         LIST_ITEM_HANDLE list_item;
+        size_t lane;
 
         // Codes_SRS_MESSAGE_QUEUE_09_027: [Each `mq_item` in `message_queue->pending` and `message_queue->in_progress` lists shall be removed]
         while ((list_item = singlylinkedlist_get_head_item(message_queue->in_progress)) != NULL)
         {
             // Codes_SRS_MESSAGE_QUEUE_09_028: [`message_queue->on_message_processing_completed_callback` shall be invoked with MESSAGE_QUEUE_CANCELLED for each `mq_item` removed]
             // Codes_SRS_MESSAGE_QUEUE_09_029: [Each `mq_item` shall be freed]
-            dequeue_message_and_fire_callback(message_queue->in_progress, list_item, MESSAGE_QUEUE_CANCELLED, NULL);
+            dequeue_message_and_fire_callback(message_queue, message_queue->in_progress, list_item, MESSAGE_QUEUE_CANCELLED, NULL);
         }
 
-        while ((list_item = singlylinkedlist_get_head_item(message_queue->pending)) != NULL)
+        for (lane = PRIORITY_LANE_COUNT; lane > 0; lane--)
         {
-            // Codes_SRS_MESSAGE_QUEUE_09_028: [`message_queue->on_message_processing_completed_callback` shall be invoked with MESSAGE_QUEUE_CANCELLED for each `mq_item` removed]
-            // Codes_SRS_MESSAGE_QUEUE_09_029: [Each `mq_item` shall be freed]
-            dequeue_message_and_fire_callback(message_queue->pending, list_item, MESSAGE_QUEUE_CANCELLED, NULL);
+            SINGLYLINKEDLIST_HANDLE pending = message_queue->pending[lane - 1];
+
+            if (pending != NULL)
+            {
+                while ((list_item = singlylinkedlist_get_head_item(pending)) != NULL)
+                {
+                    // Codes_SRS_MESSAGE_QUEUE_09_028: [`message_queue->on_message_processing_completed_callback` shall be invoked with MESSAGE_QUEUE_CANCELLED for each `mq_item` removed]
+                    // Codes_SRS_MESSAGE_QUEUE_09_029: [Each `mq_item` shall be freed]
+                    dequeue_message_and_fire_callback(message_queue, pending, list_item, MESSAGE_QUEUE_CANCELLED, NULL);
+                }
+            }
         }
     }
 }
 
-static int move_messages_between_lists(SINGLYLINKEDLIST_HANDLE from_list, SINGLYLINKEDLIST_HANDLE to_list)
+// Moves every item of from_list to the end of to_lists[item priority], in order.
+static int move_messages_between_lists(MESSAGE_QUEUE_HANDLE message_queue, SINGLYLINKEDLIST_HANDLE from_list, SINGLYLINKEDLIST_HANDLE* to_lists)
 {
     int result;
     LIST_ITEM_HANDLE list_item;
@@ -386,22 +923,24 @@ static int move_messages_between_lists(SINGLYLINKEDLIST_HANDLE from_list, SINGLY
 
     while ((list_item = singlylinkedlist_get_head_item(from_list)) != NULL)
     {
-        if (singlylinkedlist_remove(from_list, list_item) != 0)
+        MESSAGE_QUEUE_ITEM* mq_item = (MESSAGE_QUEUE_ITEM*)singlylinkedlist_item_get_value(list_item);
+
+        if (remove_from_list(message_queue, from_list, list_item, mq_item) != RESULT_OK)
         {
             LogError("failed removing message from list");
             result = __FAILURE__;
+            break;
         }
         else
         {
-            MESSAGE_QUEUE_ITEM* mq_item = (MESSAGE_QUEUE_ITEM*)singlylinkedlist_item_get_value(list_item);
-
-            if (singlylinkedlist_add(to_list, (const void*)mq_item) != 0)
+            if ((to_lists == message_queue->pending ? add_to_pending(message_queue, mq_item) :
+                (singlylinkedlist_add(to_lists[mq_item->priority], (const void*)mq_item) == NULL ? __FAILURE__ : RESULT_OK)) != RESULT_OK)
             {
                 LogError("failed moving message to list");
 
                 fire_message_callback(mq_item, MESSAGE_QUEUE_CANCELLED, NULL);
 
-                free(mq_item);
+                destroy_mq_item(message_queue, mq_item);
 
                 result = __FAILURE__;
 
@@ -411,6 +950,7 @@ static int move_messages_between_lists(SINGLYLINKEDLIST_HANDLE from_list, SINGLY
             {
                 mq_item->number_of_attempts = 0;
                 mq_item->processing_start_time = INDEFINITE_TIME;
+                mq_item->backoff_wait_secs = 0;
             }
         }
     }
@@ -438,25 +978,38 @@ int message_queue_move_all_back_to_pending(MESSAGE_QUEUE_HANDLE message_queue)
         }
         else
         {
-            if (move_messages_between_lists(message_queue->in_progress, temp_list) != 0)
+            SINGLYLINKEDLIST_HANDLE to_temp_list[PRIORITY_LANE_COUNT];
+            size_t lane;
+
+            for (lane = 0; lane < PRIORITY_LANE_COUNT; lane++)
+            {
+                to_temp_list[lane] = temp_list;
+            }
+
+            result = RESULT_OK;
+
+            if (move_messages_between_lists(message_queue, message_queue->in_progress, to_temp_list) != 0)
             {
                 LogError("failed moving in-progress message to temporary list");
                 result = __FAILURE__;
             }
-            else if (move_messages_between_lists(message_queue->pending, temp_list) != 0)
+
+            for (lane = PRIORITY_LANE_COUNT; lane > 0 && result == RESULT_OK; lane--)
             {
-                LogError("failed moving pending message to temporary list");
-                result = __FAILURE__;
+                if (message_queue->pending[lane - 1] != NULL &&
+                    move_messages_between_lists(message_queue, message_queue->pending[lane - 1], to_temp_list) != 0)
+                {
+                    LogError("failed moving pending message to temporary list");
+                    result = __FAILURE__;
+                }
             }
-            else if (move_messages_between_lists(temp_list, message_queue->pending) != 0)
+
+            // Codes_SRS_MESSAGE_QUEUE_41_006: [message_queue_move_all_back_to_pending shall move each message back to the pending list of its priority, in-progress messages first]
+            if (result == RESULT_OK && move_messages_between_lists(message_queue, temp_list, message_queue->pending) != 0)
             {
                 LogError("failed moving pending message to temporary list");
                 result = __FAILURE__;
             }
-            else
-            {
-                result = RESULT_OK;
-            }
 
             if (result != RESULT_OK)
             {
@@ -464,7 +1017,7 @@ int message_queue_move_all_back_to_pending(MESSAGE_QUEUE_HANDLE message_queue)
 
                 while ((list_item = singlylinkedlist_get_head_item(temp_list)) != NULL)
                 {
-                    dequeue_message_and_fire_callback(temp_list, list_item, MESSAGE_QUEUE_CANCELLED, NULL);
+                    dequeue_message_and_fire_callback(message_queue, temp_list, list_item, MESSAGE_QUEUE_CANCELLED, NULL);
                 }
             }
 
@@ -480,13 +1033,18 @@ void message_queue_destroy(MESSAGE_QUEUE_HANDLE message_queue)
     // Codes_SRS_MESSAGE_QUEUE_09_013: [If `message_queue` is NULL, message_queue_destroy shall return immediately]
     if (message_queue != NULL)
     {
+        size_t lane;
+
         // Codes_SRS_MESSAGE_QUEUE_09_014: [message_queue_destroy shall invoke message_queue_remove_all]
         message_queue_remove_all(message_queue);
 
         // Codes_SRS_MESSAGE_QUEUE_09_015: [message_queue_destroy shall free all memory allocated and pointed by `message_queue`]
-        if (message_queue->pending != NULL)
+        for (lane = 0; lane < PRIORITY_LANE_COUNT; lane++)
         {
-            singlylinkedlist_destroy(message_queue->pending);
+            if (message_queue->pending[lane] != NULL)
+            {
+                singlylinkedlist_destroy(message_queue->pending[lane]);
+            }
         }
 
         if (message_queue->in_progress != NULL)
@@ -494,6 +1052,22 @@ void message_queue_destroy(MESSAGE_QUEUE_HANDLE message_queue)
             singlylinkedlist_destroy(message_queue->in_progress);
         }
 
+        if (message_queue->in_progress_index != NULL)
+        {
+            free(message_queue->in_progress_index);
+        }
+
+        if (message_queue->tick_counter != NULL)
+        {
+            tickcounter_destroy(message_queue->tick_counter);
+        }
+
+        if (message_queue->retry_control != NULL)
+        {
+            retry_control_destroy(message_queue->retry_control);
+        }
+
+        IOTHUB_CLIENT_MEMORY_UNREGISTER(&message_queue->memory_counters);
         free(message_queue);
     }
 }
@@ -526,7 +1100,7 @@ MESSAGE_QUEUE_HANDLE message_queue_create(MESSAGE_QUEUE_CONFIG* config)
         memset(result, 0, sizeof(MESSAGE_QUEUE));
 
         // Codes_SRS_MESSAGE_QUEUE_09_006: [`message_queue->pending` shall be set using singlylinkedlist_create()]
-        if ((result->pending = singlylinkedlist_create()) == NULL)
+        if ((result->pending[MESSAGE_QUEUE_PRIORITY_NORMAL] = singlylinkedlist_create()) == NULL)
         {
             // Codes_SRS_MESSAGE_QUEUE_09_007: [If singlylinkedlist_create fails, message_queue_create shall fail and return NULL]
             LogError("failed allocating MESSAGE_QUEUE pending list");
@@ -543,15 +1117,49 @@ MESSAGE_QUEUE_HANDLE message_queue_create(MESSAGE_QUEUE_CONFIG* config)
             message_queue_destroy(result);
             result = NULL;
         }
+        // Codes_SRS_MESSAGE_QUEUE_41_009: [The in-progress index shall be allocated with IN_PROGRESS_INDEX_INITIAL_SIZE entries using malloc()]
+        else if ((result->in_progress_index = (IN_PROGRESS_INDEX_ENTRY*)malloc(IN_PROGRESS_INDEX_INITIAL_SIZE * sizeof(IN_PROGRESS_INDEX_ENTRY))) == NULL)
+        {
+            // Codes_SRS_MESSAGE_QUEUE_41_010: [If the in-progress index cannot be allocated, message_queue_create shall fail and return NULL]
+            LogError("failed allocating MESSAGE_QUEUE in-progress index");
+            // Codes_SRS_MESSAGE_QUEUE_09_011: [If any failures occur, message_queue_create shall release all memory it has allocated]
+            message_queue_destroy(result);
+            result = NULL;
+        }
+        // Codes_SRS_MESSAGE_QUEUE_41_038: [`message_queue->tick_counter` shall be set using tickcounter_create()]
+        else if ((result->tick_counter = tickcounter_create()) == NULL)
+        {
+            // Codes_SRS_MESSAGE_QUEUE_41_039: [If tickcounter_create fails, message_queue_create shall fail and return NULL]
+            LogError("failed creating MESSAGE_QUEUE tick counter");
+            // Codes_SRS_MESSAGE_QUEUE_09_011: [If any failures occur, message_queue_create shall release all memory it has allocated]
+            message_queue_destroy(result);
+            result = NULL;
+        }
         else
         {
+            memset(result->in_progress_index, 0, IN_PROGRESS_INDEX_INITIAL_SIZE * sizeof(IN_PROGRESS_INDEX_ENTRY));
+            result->in_progress_index_size = IN_PROGRESS_INDEX_INITIAL_SIZE;
+
+#ifdef MESSAGE_QUEUE_STATIC_POOL_SIZE
+            // Codes_SRS_MESSAGE_QUEUE_41_025: [If MESSAGE_QUEUE_STATIC_POOL_SIZE is defined, `message_queue` shall hold a pool of that many `mq_item`s and the in-progress index shall be allocated big enough that it never grows]
+            {
+                size_t index;
+                for (index = 0; index < MESSAGE_QUEUE_STATIC_POOL_SIZE; index++)
+                {
+                    destroy_mq_item(result, &result->item_pool[index]);
+                }
+            }
+#endif
+
             // Codes_SRS_MESSAGE_QUEUE_09_010: [All arguments in `config` shall be saved into `message_queue`]
             // Codes_SRS_MESSAGE_QUEUE_09_012: [If no failures occur, message_queue_create shall return the `message_queue` pointer]
 
-            result->max_message_enqueued_time_secs = config->max_message_enqueued_time_secs;
-            result->max_message_processing_time_secs = config->max_message_processing_time_secs;
+            result->max_message_enqueued_time_ms = config->max_message_enqueued_time_secs * MILLISECONDS_PER_SECOND;
+            result->max_message_processing_time_ms = config->max_message_processing_time_secs * MILLISECONDS_PER_SECOND;
             result->max_retry_count = config->max_retry_count;
             result->on_process_message_callback = config->on_process_message_callback;
+
+            IOTHUB_CLIENT_MEMORY_REGISTER(&result->memory_counters);
         }
     }
 
@@ -559,21 +1167,41 @@ MESSAGE_QUEUE_HANDLE message_queue_create(MESSAGE_QUEUE_CONFIG* config)
 }
 
 int message_queue_add(MESSAGE_QUEUE_HANDLE message_queue, MQ_MESSAGE_HANDLE message, MESSAGE_PROCESSING_COMPLETED_CALLBACK on_message_processing_completed_callback, void* user_context)
+{
+    return message_queue_add_with_priority(message_queue, message, MESSAGE_QUEUE_PRIORITY_NORMAL, on_message_processing_completed_callback, user_context);
+}
+
+int message_queue_add_with_priority(MESSAGE_QUEUE_HANDLE message_queue, MQ_MESSAGE_HANDLE message, MESSAGE_QUEUE_PRIORITY priority, MESSAGE_PROCESSING_COMPLETED_CALLBACK on_message_processing_completed_callback, void* user_context)
 {
     int result;
 
     // Codes_SRS_MESSAGE_QUEUE_09_016: [If `message_queue` or `message` are NULL, message_queue_add shall fail and return non-zero]
-    if (message_queue == NULL || message == NULL)
+    // Codes_SRS_MESSAGE_QUEUE_41_001: [If `priority` is not a valid MESSAGE_QUEUE_PRIORITY, message_queue_add_with_priority shall fail and return non-zero]
+    if (message_queue == NULL || message == NULL || (size_t)priority >= PRIORITY_LANE_COUNT)
     {
-        LogError("invalid argument (message_queue=%p, message=%p)", message_queue, message);
+        LogError("invalid argument (message_queue=%p, message=%p, priority=%d)", message_queue, message, (int)priority);
+        result = __FAILURE__;
+    }
+    // Codes_SRS_MESSAGE_QUEUE_41_002: [The pending list of `priority` shall be created using singlylinkedlist_create() when the first message of that priority is added]
+    else if (message_queue->pending[priority] == NULL && (message_queue->pending[priority] = singlylinkedlist_create()) == NULL)
+    {
+        LogError("failed creating pending list for priority %d", (int)priority);
         result = __FAILURE__;
     }
     else
     {
         MESSAGE_QUEUE_ITEM* mq_item;
+        size_t message_size = (message_queue->max_pending_bytes > 0 ? message_queue->get_message_size(message) : 0);
 
+        // Codes_SRS_MESSAGE_QUEUE_41_019: [If adding `message` would exceed the maximum pending count or bytes, message_queue_add shall apply `message_queue->overflow_policy`]
+        if ((message_queue->max_pending_count > 0 || message_queue->max_pending_bytes > 0) &&
+            make_room_for_message(message_queue, priority, message_size) != RESULT_OK)
+        {
+            LogError("message queue is full, message rejected (%p)", message);
+            result = __FAILURE__;
+        }
         // Codes_SRS_MESSAGE_QUEUE_09_017: [message_queue_add shall allocate a structure (aka `mq_item`) to save the `message`]
-        if ((mq_item = (MESSAGE_QUEUE_ITEM*)malloc(sizeof(MESSAGE_QUEUE_ITEM))) == NULL)
+        else if ((mq_item = create_mq_item(message_queue)) == NULL)
         {
             // Codes_SRS_MESSAGE_QUEUE_09_018: [If `mq_item` cannot be allocated, message_queue_add shall fail and return non-zero]
             LogError("failed creating container for message");
@@ -582,23 +1210,25 @@ int message_queue_add(MESSAGE_QUEUE_HANDLE message_queue, MQ_MESSAGE_HANDLE mess
         else
         {
             memset(mq_item, 0, sizeof(MESSAGE_QUEUE_ITEM));
+            mq_item->priority = priority;
+            mq_item->size = message_size;
 
-            // Codes_SRS_MESSAGE_QUEUE_09_019: [`mq_item->enqueue_time` shall be set using get_time()]
-            if ((mq_item->enqueue_time = get_time(NULL)) == INDEFINITE_TIME)
+            // Codes_SRS_MESSAGE_QUEUE_09_019: [`mq_item->enqueue_time` shall be set using tickcounter_get_current_ms()]
+            if ((mq_item->enqueue_time = get_current_time(message_queue)) == INDEFINITE_TIME)
             {
-                // Codes_SRS_MESSAGE_QUEUE_09_020: [If get_time fails, message_queue_add shall fail and return non-zero]
+                // Codes_SRS_MESSAGE_QUEUE_09_020: [If tickcounter_get_current_ms fails, message_queue_add shall fail and return non-zero]
                 LogError("failed setting message enqueue time");
                 // Codes_SRS_MESSAGE_QUEUE_09_024: [If any failures occur, message_queue_add shall release all memory it has allocated]
-                free(mq_item);
+                destroy_mq_item(message_queue, mq_item);
                 result = __FAILURE__;
             }
             // Codes_SRS_MESSAGE_QUEUE_09_021: [`mq_item` shall be added to `message_queue->pending` list]
-            else if (singlylinkedlist_add(message_queue->pending, (const void*)mq_item) == NULL)
+            else if (add_to_pending(message_queue, mq_item) != RESULT_OK)
             {
                 // Codes_SRS_MESSAGE_QUEUE_09_022: [`mq_item` fails to be added to `message_queue->pending`, message_queue_add shall fail and return non-zero]
                 LogError("failed enqueing message");
                 // Codes_SRS_MESSAGE_QUEUE_09_024: [If any failures occur, message_queue_add shall release all memory it has allocated]
-                free(mq_item);
+                destroy_mq_item(message_queue, mq_item);
                 result = __FAILURE__;
             }
             else
@@ -631,7 +1261,18 @@ int message_queue_is_empty(MESSAGE_QUEUE_HANDLE message_queue, bool* is_empty)
     {
         // Codes_SRS_MESSAGE_QUEUE_09_031: [If `message_queue->pending` and `message_queue->in_progress` are empty, `is_empty` shall be set to true]
         // Codes_SRS_MESSAGE_QUEUE_09_032: [Otherwise `is_empty` shall be set to false]
-        *is_empty = (singlylinkedlist_get_head_item(message_queue->pending) == NULL && singlylinkedlist_get_head_item(message_queue->in_progress) == NULL);
+        size_t lane;
+
+        *is_empty = (singlylinkedlist_get_head_item(message_queue->pending[MESSAGE_QUEUE_PRIORITY_NORMAL]) == NULL && singlylinkedlist_get_head_item(message_queue->in_progress) == NULL);
+
+        for (lane = 0; lane < PRIORITY_LANE_COUNT && *is_empty; lane++)
+        {
+            if (lane != MESSAGE_QUEUE_PRIORITY_NORMAL && message_queue->pending[lane] != NULL)
+            {
+                *is_empty = (singlylinkedlist_get_head_item(message_queue->pending[lane]) == NULL);
+            }
+        }
+
         // Codes_SRS_MESSAGE_QUEUE_09_033: [If no failures occur, message_queue_is_empty shall return 0]
         result = RESULT_OK;
     }
@@ -639,6 +1280,26 @@ int message_queue_is_empty(MESSAGE_QUEUE_HANDLE message_queue, bool* is_empty)
     return result;
 }
 
+int message_queue_get_in_progress_count(MESSAGE_QUEUE_HANDLE message_queue, size_t* count)
+{
+    int result;
+
+    // Codes_SRS_MESSAGE_QUEUE_41_011: [If `message_queue` or `count` are NULL, message_queue_get_in_progress_count shall fail and return non-zero]
+    if (message_queue == NULL || count == NULL)
+    {
+        LogError("invalid argument (message_queue=%p, count=%p)", message_queue, count);
+        result = __FAILURE__;
+    }
+    else
+    {
+        // Codes_SRS_MESSAGE_QUEUE_41_012: [`count` shall be set to the number of messages in `message_queue->in_progress` and message_queue_get_in_progress_count shall return 0]
+        *count = message_queue->in_progress_count;
+        result = RESULT_OK;
+    }
+
+    return result;
+}
+
 void message_queue_do_work(MESSAGE_QUEUE_HANDLE message_queue)
 {
     // Codes_SRS_MESSAGE_QUEUE_09_034: [If `message_queue` is NULL, message_queue_do_work shall return immediately]
@@ -650,10 +1311,18 @@ void message_queue_do_work(MESSAGE_QUEUE_HANDLE message_queue)
 }
 
 int message_queue_set_max_message_enqueued_time_secs(MESSAGE_QUEUE_HANDLE message_queue, size_t seconds)
+{
+    // Codes_SRS_MESSAGE_QUEUE_09_051: [If `message_queue` is NULL, message_queue_set_max_message_enqueued_time_secs shall fail and return non-zero]
+    // Codes_SRS_MESSAGE_QUEUE_09_053: [`seconds` shall be saved into `message_queue->max_message_enqueued_time_ms` in milliseconds]
+    // Codes_SRS_MESSAGE_QUEUE_09_054: [If no failures occur, message_queue_set_max_message_enqueued_time_secs shall return 0]
+    return message_queue_set_max_message_enqueued_time_ms(message_queue, seconds * MILLISECONDS_PER_SECOND);
+}
+
+int message_queue_set_max_message_enqueued_time_ms(MESSAGE_QUEUE_HANDLE message_queue, size_t milliseconds)
 {
     int result;
 
-    // Codes_SRS_MESSAGE_QUEUE_09_051: [If `message_queue` is NULL, message_queue_set_max_message_enqueued_time_secs shall fail and return non-zero]
+    // Codes_SRS_MESSAGE_QUEUE_41_040: [If `message_queue` is NULL, message_queue_set_max_message_enqueued_time_ms shall fail and return non-zero]
     if (message_queue == NULL)
     {
         LogError("invalid argument (message_queue is NULL)");
@@ -661,9 +1330,8 @@ int message_queue_set_max_message_enqueued_time_secs(MESSAGE_QUEUE_HANDLE messag
     }
     else
     {
-        // Codes_SRS_MESSAGE_QUEUE_09_053: [`seconds` shall be saved into `message_queue->max_message_enqueued_time_secs`]
-        message_queue->max_message_enqueued_time_secs = seconds;
-        // Codes_SRS_MESSAGE_QUEUE_09_054: [If no failures occur, message_queue_set_max_message_enqueued_time_secs shall return 0]
+        // Codes_SRS_MESSAGE_QUEUE_41_041: [`milliseconds` shall be saved into `message_queue->max_message_enqueued_time_ms` and message_queue_set_max_message_enqueued_time_ms shall return 0]
+        message_queue->max_message_enqueued_time_ms = milliseconds;
         result = RESULT_OK;
     }
 
@@ -671,10 +1339,18 @@ int message_queue_set_max_message_enqueued_time_secs(MESSAGE_QUEUE_HANDLE messag
 }
 
 int message_queue_set_max_message_processing_time_secs(MESSAGE_QUEUE_HANDLE message_queue, size_t seconds)
+{
+    // Codes_SRS_MESSAGE_QUEUE_09_055: [If `message_queue` is NULL, message_queue_set_max_message_processing_time_secs shall fail and return non-zero]
+    // Codes_SRS_MESSAGE_QUEUE_09_057: [`seconds` shall be saved into `message_queue->max_message_processing_time_ms` in milliseconds]
+    // Codes_SRS_MESSAGE_QUEUE_09_058: [If no failures occur, message_queue_set_max_message_processing_time_secs shall return 0]
+    return message_queue_set_max_message_processing_time_ms(message_queue, seconds * MILLISECONDS_PER_SECOND);
+}
+
+int message_queue_set_max_message_processing_time_ms(MESSAGE_QUEUE_HANDLE message_queue, size_t milliseconds)
 {
     int result;
 
-    // Codes_SRS_MESSAGE_QUEUE_09_055: [If `message_queue` is NULL, message_queue_set_max_message_processing_time_secs shall fail and return non-zero]
+    // Codes_SRS_MESSAGE_QUEUE_41_042: [If `message_queue` is NULL, message_queue_set_max_message_processing_time_ms shall fail and return non-zero]
     if (message_queue == NULL)
     {
         LogError("invalid argument (message_queue is NULL)");
@@ -682,9 +1358,40 @@ int message_queue_set_max_message_processing_time_secs(MESSAGE_QUEUE_HANDLE mess
     }
     else
     {
-        // Codes_SRS_MESSAGE_QUEUE_09_057: [`seconds` shall be saved into `message_queue->max_message_processing_time_secs`]
-        message_queue->max_message_processing_time_secs = seconds;
-        // Codes_SRS_MESSAGE_QUEUE_09_058: [If no failures occur, message_queue_set_max_message_processing_time_secs shall return 0]
+        // Codes_SRS_MESSAGE_QUEUE_41_043: [`milliseconds` shall be saved into `message_queue->max_message_processing_time_ms` and message_queue_set_max_message_processing_time_ms shall return 0]
+        message_queue->max_message_processing_time_ms = milliseconds;
+        result = RESULT_OK;
+    }
+
+    return result;
+}
+
+int message_queue_set_max_size(MESSAGE_QUEUE_HANDLE message_queue, size_t max_message_count, size_t max_message_bytes, MESSAGE_QUEUE_OVERFLOW_POLICY policy, MESSAGE_QUEUE_GET_MESSAGE_SIZE get_message_size)
+{
+    int result;
+
+    // Codes_SRS_MESSAGE_QUEUE_41_015: [If `message_queue` is NULL or `policy` is not a valid MESSAGE_QUEUE_OVERFLOW_POLICY, message_queue_set_max_size shall fail and return non-zero]
+    // Codes_SRS_MESSAGE_QUEUE_41_016: [If `max_message_bytes` is greater than zero and `get_message_size` is NULL, message_queue_set_max_size shall fail and return non-zero]
+    if (message_queue == NULL ||
+        (policy != MESSAGE_QUEUE_OVERFLOW_REJECT && policy != MESSAGE_QUEUE_OVERFLOW_DROP_OLDEST && policy != MESSAGE_QUEUE_OVERFLOW_DROP_LOWEST_PRIORITY) ||
+        (max_message_bytes > 0 && get_message_size == NULL))
+    {
+        LogError("invalid argument (message_queue=%p, policy=%d, max_message_bytes=%lu, get_message_size=%p)", message_queue, (int)policy, (unsigned long)max_message_bytes, get_message_size);
+        result = __FAILURE__;
+    }
+    // Codes_SRS_MESSAGE_QUEUE_41_017: [Sizes of pending messages are only tracked while a maximum of bytes is set, so it shall not be set while messages are pending]
+    else if (max_message_bytes > 0 && message_queue->max_pending_bytes == 0 && message_queue->pending_count > 0)
+    {
+        LogError("the maximum pending bytes cannot be set while messages are pending");
+        result = __FAILURE__;
+    }
+    else
+    {
+        // Codes_SRS_MESSAGE_QUEUE_41_018: [The limits, `policy` and `get_message_size` shall be saved into `message_queue` and message_queue_set_max_size shall return 0; a limit of zero means unbounded]
+        message_queue->max_pending_count = max_message_count;
+        message_queue->max_pending_bytes = max_message_bytes;
+        message_queue->overflow_policy = policy;
+        message_queue->get_message_size = get_message_size;
         result = RESULT_OK;
     }
 
@@ -712,6 +1419,56 @@ int message_queue_set_max_retry_count(MESSAGE_QUEUE_HANDLE message_queue, size_t
     return result;
 }
 
+int message_queue_set_retry_policy(MESSAGE_QUEUE_HANDLE message_queue, IOTHUB_CLIENT_RETRY_POLICY policy)
+{
+    int result;
+
+    // Codes_SRS_MESSAGE_QUEUE_41_028: [If `message_queue` is NULL, message_queue_set_retry_policy shall fail and return non-zero]
+    if (message_queue == NULL)
+    {
+        LogError("invalid argument (message_queue is NULL)");
+        result = __FAILURE__;
+    }
+    // Codes_SRS_MESSAGE_QUEUE_41_029: [If `policy` is IOTHUB_CLIENT_RETRY_NONE or IOTHUB_CLIENT_RETRY_IMMEDIATE, messages shall be retried without waiting, the previous retry control destroyed, and message_queue_set_retry_policy shall return 0]
+    else if (policy == IOTHUB_CLIENT_RETRY_NONE || policy == IOTHUB_CLIENT_RETRY_IMMEDIATE)
+    {
+        if (message_queue->retry_control != NULL)
+        {
+            retry_control_destroy(message_queue->retry_control);
+            message_queue->retry_control = NULL;
+        }
+
+        message_queue->retry_policy = (size_t)policy;
+        result = RESULT_OK;
+    }
+    else
+    {
+        RETRY_CONTROL_HANDLE retry_control;
+
+        // Codes_SRS_MESSAGE_QUEUE_41_034: [Otherwise a retry control shall be created using retry_control_create() passing `policy` and no maximum retry time]
+        if ((retry_control = retry_control_create(policy, 0)) == NULL)
+        {
+            // Codes_SRS_MESSAGE_QUEUE_41_035: [If retry_control_create() fails, message_queue_set_retry_policy shall fail, keep the previous policy and return non-zero]
+            LogError("failed creating the retry control of policy %d", (int)policy);
+            result = __FAILURE__;
+        }
+        else
+        {
+            // Codes_SRS_MESSAGE_QUEUE_41_036: [The previous retry control shall be destroyed and message_queue_set_retry_policy shall return 0; messages already backing off shall keep their wait]
+            if (message_queue->retry_control != NULL)
+            {
+                retry_control_destroy(message_queue->retry_control);
+            }
+
+            message_queue->retry_control = retry_control;
+            message_queue->retry_policy = (size_t)policy;
+            result = RESULT_OK;
+        }
+    }
+
+    return result;
+}
+
 static int setOption(void* handle, const char* name, const void* value)
 {
     int result;
@@ -721,9 +1478,9 @@ static int setOption(void* handle, const char* name, const void* value)
         LogError("invalid argument (handle=%p, name=%p, value=%p)", handle, name, value);
         result = __FAILURE__;
     }
-    else if (strcmp(SAVED_OPTION_MAX_ENQUEUE_TIME_SECS, name) == 0)
+    else if (strcmp(SAVED_OPTION_MAX_ENQUEUE_TIME_MS, name) == 0)
     {
-        if (message_queue_set_max_message_enqueued_time_secs((MESSAGE_QUEUE_HANDLE)handle, *(size_t*)value) != RESULT_OK)
+        if (message_queue_set_max_message_enqueued_time_ms((MESSAGE_QUEUE_HANDLE)handle, *(size_t*)value) != RESULT_OK)
         {
             LogError("failed setting option %s", name);
             result = __FAILURE__;
@@ -733,9 +1490,9 @@ static int setOption(void* handle, const char* name, const void* value)
             result = RESULT_OK;
         }
     }
-    else if (strcmp(SAVED_OPTION_MAX_PROCESSING_TIME_SECS, name) == 0)
+    else if (strcmp(SAVED_OPTION_MAX_PROCESSING_TIME_MS, name) == 0)
     {
-        if (message_queue_set_max_message_processing_time_secs((MESSAGE_QUEUE_HANDLE)handle, *(size_t*)value) != RESULT_OK)
+        if (message_queue_set_max_message_processing_time_ms((MESSAGE_QUEUE_HANDLE)handle, *(size_t*)value) != RESULT_OK)
         {
             LogError("failed setting option %s", name);
             result = __FAILURE__;
@@ -757,6 +1514,18 @@ static int setOption(void* handle, const char* name, const void* value)
             result = RESULT_OK;
         }
     }
+    else if (strcmp(SAVED_OPTION_RETRY_POLICY, name) == 0)
+    {
+        if (message_queue_set_retry_policy((MESSAGE_QUEUE_HANDLE)handle, (IOTHUB_CLIENT_RETRY_POLICY)*(size_t*)value) != RESULT_OK)
+        {
+            LogError("failed setting option %s", name);
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = RESULT_OK;
+        }
+    }
     else
     {
         LogError("option %s is invalid", name);
@@ -783,17 +1552,17 @@ OPTIONHANDLER_HANDLE message_queue_retrieve_options(MESSAGE_QUEUE_HANDLE message
         LogError("failed creating OPTIONHANDLER_HANDLE");
     }
     // Codes_SRS_MESSAGE_QUEUE_09_065: [Each option of `instance` shall be added to the OPTIONHANDLER_HANDLE instance using OptionHandler_AddOption]
-    else if (OptionHandler_AddOption(result, SAVED_OPTION_MAX_ENQUEUE_TIME_SECS, &message_queue->max_message_enqueued_time_secs) != OPTIONHANDLER_OK)
+    else if (OptionHandler_AddOption(result, SAVED_OPTION_MAX_ENQUEUE_TIME_MS, &message_queue->max_message_enqueued_time_ms) != OPTIONHANDLER_OK)
     {
-        LogError("failed retrieving options (failed adding %s)", SAVED_OPTION_MAX_ENQUEUE_TIME_SECS);
+        LogError("failed retrieving options (failed adding %s)", SAVED_OPTION_MAX_ENQUEUE_TIME_MS);
         // Codes_SRS_MESSAGE_QUEUE_09_067: [If message_queue_retrieve_options fails, any allocated memory shall be freed]
         OptionHandler_Destroy(result);
         // Codes_SRS_MESSAGE_QUEUE_09_066: [If OptionHandler_AddOption fails, message_queue_retrieve_options shall fail and return NULL]
         result = NULL;
     }
-    else if (OptionHandler_AddOption(result, SAVED_OPTION_MAX_PROCESSING_TIME_SECS, &message_queue->max_message_processing_time_secs) != OPTIONHANDLER_OK)
+    else if (OptionHandler_AddOption(result, SAVED_OPTION_MAX_PROCESSING_TIME_MS, &message_queue->max_message_processing_time_ms) != OPTIONHANDLER_OK)
     {
-        LogError("failed retrieving options (failed adding %s)", SAVED_OPTION_MAX_PROCESSING_TIME_SECS);
+        LogError("failed retrieving options (failed adding %s)", SAVED_OPTION_MAX_PROCESSING_TIME_MS);
         // Codes_SRS_MESSAGE_QUEUE_09_067: [If message_queue_retrieve_options fails, any allocated memory shall be freed]
         OptionHandler_Destroy(result);
         // Codes_SRS_MESSAGE_QUEUE_09_066: [If OptionHandler_AddOption fails, message_queue_retrieve_options shall fail and return NULL]
@@ -801,7 +1570,17 @@ OPTIONHANDLER_HANDLE message_queue_retrieve_options(MESSAGE_QUEUE_HANDLE message
     }
     else if (OptionHandler_AddOption(result, SAVED_OPTION_MAX_RETRY_COUNT, &message_queue->max_retry_count) != OPTIONHANDLER_OK)
     {
-        LogError("failed retrieving options (failed adding %s)", SAVED_OPTION_MAX_PROCESSING_TIME_SECS);
+        LogError("failed retrieving options (failed adding %s)", SAVED_OPTION_MAX_PROCESSING_TIME_MS);
+        // Codes_SRS_MESSAGE_QUEUE_09_067: [If message_queue_retrieve_options fails, any allocated memory shall be freed]
+        OptionHandler_Destroy(result);
+        // Codes_SRS_MESSAGE_QUEUE_09_066: [If OptionHandler_AddOption fails, message_queue_retrieve_options shall fail and return NULL]
+        result = NULL;
+    }
+    // Codes_SRS_MESSAGE_QUEUE_41_037: [The retry policy shall only be added if one that waits is set]
+    else if (message_queue->retry_control != NULL &&
+        OptionHandler_AddOption(result, SAVED_OPTION_RETRY_POLICY, &message_queue->retry_policy) != OPTIONHANDLER_OK)
+    {
+        LogError("failed retrieving options (failed adding %s)", SAVED_OPTION_RETRY_POLICY);
         // Codes_SRS_MESSAGE_QUEUE_09_067: [If message_queue_retrieve_options fails, any allocated memory shall be freed]
         OptionHandler_Destroy(result);
         // Codes_SRS_MESSAGE_QUEUE_09_066: [If OptionHandler_AddOption fails, message_queue_retrieve_options shall fail and return NULL]
@@ -29,6 +29,28 @@
 #define AMQP_DIAGNOSTIC_CONTEXT_KEY "Correlation-Context"
 #define AMQP_DIAGNOSTIC_CREATION_TIME_UTC_KEY "creationtimeutc"
 
+// An AMQP section already encoded, with the name/value pairs it was encoded from.
+typedef struct ENCODED_SECTION_TAG
+{
+    unsigned char* bytes;
+    size_t length;
+    char** names;
+    char** values;
+    size_t count;
+} ENCODED_SECTION;
+
+typedef struct UAMQP_ENCODING_CACHE_TAG
+{
+    ENCODED_SECTION message_properties;
+    ENCODED_SECTION application_properties;
+    unsigned char* buffer;
+    size_t buffer_size;
+    size_t length;
+} UAMQP_ENCODING_CACHE;
+
+// Smallest encoding buffer allocated; it then doubles until the largest message of a batch fits.
+#define ENCODING_BUFFER_MIN_SIZE 256
+
 static int encode_callback(void* context, const unsigned char* bytes, size_t length)
 {
     BINARY_DATA* message_body_binary = (BINARY_DATA*)context;
@@ -202,7 +224,7 @@ static int create_message_properties_to_encode(IOTHUB_MESSAGE_HANDLE messageHand
         LogError("Failed on amqpvalue_create_properties()");
         result = __FAILURE__;
     }
-    else if ((amqpvalue_get_encoded_size(*message_properties, message_properties_length)) != 0)
+    else if (message_properties_length != NULL && (amqpvalue_get_encoded_size(*message_properties, message_properties_length)) != 0)
     {
         LogError("Failed on amqpvalue_get_encoded_size()");
         result = __FAILURE__;
@@ -305,21 +327,15 @@ static int override_fault_injection_properties_if_needed(MESSAGE_HANDLE message_
 // Codes_SRS_UAMQP_MESSAGING_31_117: [Get application message properties associated with the IOTHUB_MESSAGE_HANDLE to encode, returning the properties and their encoded length.]
 static int create_application_properties_to_encode(MESSAGE_HANDLE message_batch_container, IOTHUB_MESSAGE_HANDLE messageHandle, AMQP_VALUE *application_properties, size_t *application_properties_length)
 {
-    MAP_HANDLE properties_map;
     const char* const* property_keys;
     const char* const* property_values;
     size_t property_count = 0;
     AMQP_VALUE uamqp_properties_map = NULL;
     int result;
 
-    if ((properties_map = IoTHubMessage_Properties(messageHandle)) == NULL)
-    {
-        LogError("Failed to get property map from IoTHub message.");
-        result = __FAILURE__;
-    }
-    else if (Map_GetInternals(properties_map, &property_keys, &property_values, &property_count) != 0)
+    if (IoTHubMessage_GetProperties(messageHandle, &property_keys, &property_values, &property_count) != IOTHUB_MESSAGE_OK)
     {
-        LogError("Failed reading the incoming uAMQP message properties");
+        LogError("Failed to get the properties of the IoTHub message.");
         result = __FAILURE__;
     }
     else if (property_count > 0)
@@ -377,7 +393,7 @@ static int create_application_properties_to_encode(MESSAGE_HANDLE message_batch_
                         LogError("Failed amqpvalue_create_application_properties");
                         result = __FAILURE__;
                     }
-                    else if (amqpvalue_get_encoded_size(*application_properties, application_properties_length) != 0)
+                    else if (application_properties_length != NULL && amqpvalue_get_encoded_size(*application_properties, application_properties_length) != 0)
                     {
                         LogError("Failed amqpvalue_get_encoded_size");
                         result = __FAILURE__;
@@ -489,7 +505,7 @@ static int create_message_annotations_to_encode(IOTHUB_MESSAGE_HANDLE messageHan
                 LogError("Failed creating message annotations");
                 result = __FAILURE__;
             }
-            else if (amqpvalue_get_encoded_size(*message_annotations, message_annotations_length) != 0)
+            else if (message_annotations_length != NULL && amqpvalue_get_encoded_size(*message_annotations, message_annotations_length) != 0)
             {
                 LogError("Failed getting size of annotations");
                 result = __FAILURE__;
@@ -554,7 +570,7 @@ static int create_data_to_encode(IOTHUB_MESSAGE_HANDLE messageHandle, AMQP_VALUE
             LogError("amqpvalue_create_data failed");
             result = __FAILURE__;
         }
-        else if (amqpvalue_get_encoded_size(*data_value, data_length) != 0)
+        else if (data_length != NULL && amqpvalue_get_encoded_size(*data_value, data_length) != 0)
         {
             LogError("amqpvalue_get_encoded_size failed");
             result = __FAILURE__;
@@ -568,6 +584,313 @@ static int create_data_to_encode(IOTHUB_MESSAGE_HANDLE messageHandle, AMQP_VALUE
     return result;
 }
 
+static void clear_encoded_section(ENCODED_SECTION* section)
+{
+    size_t i;
+
+    for (i = 0; i < section->count; i++)
+    {
+        free(section->names[i]);
+        free(section->values[i]);
+    }
+
+    free(section->names);
+    free(section->values);
+    free(section->bytes);
+    memset(section, 0, sizeof(ENCODED_SECTION));
+}
+
+static bool is_same_string(const char* first, const char* second)
+{
+    return (first == NULL || second == NULL) ? (first == second) : (strcmp(first, second) == 0);
+}
+
+static bool encoded_section_matches(const ENCODED_SECTION* section, const char* const* names, const char* const* values, size_t count)
+{
+    bool result = (section->bytes != NULL && section->count == count);
+    size_t i;
+
+    for (i = 0; result && i < count; i++)
+    {
+        result = is_same_string(section->names[i], names[i]) && is_same_string(section->values[i], values[i]);
+    }
+
+    return result;
+}
+
+static char* copy_string_if_present(const char* source, bool* failed)
+{
+    char* result;
+
+    if (source == NULL)
+    {
+        result = NULL;
+    }
+    else
+    {
+        size_t size = strlen(source) + 1;
+
+        if ((result = (char*)malloc(size)) == NULL)
+        {
+            *failed = true;
+        }
+        else
+        {
+            (void)memcpy(result, source, size);
+        }
+    }
+
+    return result;
+}
+
+// Keeps a copy of a section just encoded, so the next message encoded from the same name/value pairs reuses it.
+// Failing to do so is not an error; the next message is then encoded from scratch.
+static void save_encoded_section(ENCODED_SECTION* section, const char* const* names, const char* const* values, size_t count, const unsigned char* bytes, size_t length)
+{
+    bool failed = false;
+    size_t i;
+
+    clear_encoded_section(section);
+
+    if ((section->names = (char**)malloc(count * sizeof(char*))) == NULL ||
+        (section->values = (char**)malloc(count * sizeof(char*))) == NULL)
+    {
+        failed = true;
+    }
+    else
+    {
+        for (i = 0; i < count; i++)
+        {
+            section->names[i] = copy_string_if_present(names[i], &failed);
+            section->values[i] = copy_string_if_present(values[i], &failed);
+            section->count++;
+        }
+
+        if (!failed)
+        {
+            if ((section->bytes = (unsigned char*)malloc(length)) == NULL)
+            {
+                failed = true;
+            }
+            else
+            {
+                (void)memcpy(section->bytes, bytes, length);
+                section->length = length;
+            }
+        }
+    }
+
+    if (failed)
+    {
+        LogError("Failed caching an encoded AMQP section; it will be encoded again for the next message");
+        clear_encoded_section(section);
+    }
+}
+
+static int append_to_encoding_buffer(UAMQP_ENCODING_CACHE* cache, const unsigned char* bytes, size_t length)
+{
+    int result;
+
+    if (cache->length + length > cache->buffer_size)
+    {
+        size_t new_size = (cache->buffer_size < ENCODING_BUFFER_MIN_SIZE) ? ENCODING_BUFFER_MIN_SIZE : cache->buffer_size;
+        unsigned char* new_buffer;
+
+        while (new_size < cache->length + length)
+        {
+            new_size *= 2;
+        }
+
+        if ((new_buffer = (unsigned char*)malloc(new_size)) == NULL)
+        {
+            LogError("Failed growing the encoding buffer to %lu bytes", (unsigned long)new_size);
+        }
+        else
+        {
+            if (cache->length > 0)
+            {
+                (void)memcpy(new_buffer, cache->buffer, cache->length);
+            }
+
+            free(cache->buffer);
+            cache->buffer = new_buffer;
+            cache->buffer_size = new_size;
+        }
+    }
+
+    if (cache->length + length > cache->buffer_size)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        (void)memcpy(cache->buffer + cache->length, bytes, length);
+        cache->length += length;
+        result = RESULT_OK;
+    }
+
+    return result;
+}
+
+static int encode_to_buffer_callback(void* context, const unsigned char* bytes, size_t length)
+{
+    return append_to_encoding_buffer((UAMQP_ENCODING_CACHE*)context, bytes, length);
+}
+
+static int encode_section(UAMQP_ENCODING_CACHE* cache, const ENCODED_SECTION* cached_section, AMQP_VALUE value, size_t* section_end)
+{
+    int result;
+
+    if (cached_section != NULL)
+    {
+        result = append_to_encoding_buffer(cache, cached_section->bytes, cached_section->length);
+    }
+    else
+    {
+        result = amqpvalue_encode(value, &encode_to_buffer_callback, cache);
+    }
+
+    *section_end = cache->length;
+
+    return result;
+}
+
+static int create_uamqp_encoding_with_cache(UAMQP_ENCODING_CACHE* cache, MESSAGE_HANDLE message_batch_container, IOTHUB_MESSAGE_HANDLE message_handle, BINARY_DATA* body_binary_data)
+{
+    int result;
+
+    const ENCODED_SECTION* cached_message_properties = NULL;
+    const ENCODED_SECTION* cached_application_properties = NULL;
+    bool message_properties_cacheable = false;
+    bool application_properties_cacheable = false;
+    const char* content_type = NULL;
+    const char* content_encoding = NULL;
+    const char* const* property_keys = NULL;
+    const char* const* property_values = NULL;
+    size_t property_count = 0;
+    size_t message_properties_end = 0;
+    size_t application_properties_end = 0;
+    size_t annotations_end = 0;
+
+    AMQP_VALUE message_properties = NULL;
+    AMQP_VALUE application_properties = NULL;
+    AMQP_VALUE message_annotations = NULL;
+    AMQP_VALUE data_value = NULL;
+
+    body_binary_data->bytes = NULL;
+    body_binary_data->length = 0;
+    cache->length = 0;
+
+    // Codes_SRS_UAMQP_MESSAGING_41_003: [With a cache, message properties without message-id and correlation-id shall be copied from the cache if they were last encoded from the same content-type and content-encoding.]
+    if (IoTHubMessage_GetMessageId(message_handle) == NULL && IoTHubMessage_GetCorrelationId(message_handle) == NULL)
+    {
+        message_properties_cacheable = true;
+        content_type = IoTHubMessage_GetContentTypeSystemProperty(message_handle);
+        content_encoding = IoTHubMessage_GetContentEncodingSystemProperty(message_handle);
+
+        if (encoded_section_matches(&cache->message_properties, &content_type, &content_encoding, 1))
+        {
+            cached_message_properties = &cache->message_properties;
+        }
+    }
+
+    // Codes_SRS_UAMQP_MESSAGING_41_004: [With a cache, application properties shall be copied from the cache if they were last encoded from the same keys and values.]
+    if (IoTHubMessage_GetProperties(message_handle, &property_keys, &property_values, &property_count) == IOTHUB_MESSAGE_OK &&
+        property_count > 0)
+    {
+        application_properties_cacheable = true;
+
+        if (encoded_section_matches(&cache->application_properties, property_keys, property_values, property_count))
+        {
+            cached_application_properties = &cache->application_properties;
+        }
+    }
+
+    // Codes_SRS_UAMQP_MESSAGING_41_007: [With a cache, sections shall not be sized with amqpvalue_get_encoded_size but encoded once, in order, straight into the cache buffer.]
+    if (cached_message_properties == NULL && create_message_properties_to_encode(message_handle, &message_properties, NULL) != RESULT_OK)
+    {
+        LogError("create_message_properties_to_encode() failed");
+        result = __FAILURE__;
+    }
+    else if (cached_application_properties == NULL && create_application_properties_to_encode(message_batch_container, message_handle, &application_properties, NULL) != RESULT_OK)
+    {
+        LogError("create_application_properties_to_encode() failed");
+        result = __FAILURE__;
+    }
+    else if (create_message_annotations_to_encode(message_handle, &message_annotations, NULL) != RESULT_OK)
+    {
+        LogError("create_message_annotations_to_encode() failed");
+        result = __FAILURE__;
+    }
+    else if (create_data_to_encode(message_handle, &data_value, NULL) != RESULT_OK)
+    {
+        LogError("create_data_to_encode() failed");
+        result = __FAILURE__;
+    }
+    else if (encode_section(cache, cached_message_properties, message_properties, &message_properties_end) != RESULT_OK)
+    {
+        LogError("amqpvalue_encode() for message properties failed");
+        result = __FAILURE__;
+    }
+    // No application properties section is encoded when there are none, or when they are overridden for fault injection.
+    else if ((cached_application_properties != NULL || application_properties != NULL) &&
+        encode_section(cache, cached_application_properties, application_properties, &application_properties_end) != RESULT_OK)
+    {
+        LogError("amqpvalue_encode() for application properties failed");
+        result = __FAILURE__;
+    }
+    else if (message_annotations != NULL && encode_section(cache, NULL, message_annotations, &annotations_end) != RESULT_OK)
+    {
+        LogError("amqpvalue_encode() for message annotations failed");
+        result = __FAILURE__;
+    }
+    else if (amqpvalue_encode(data_value, &encode_to_buffer_callback, cache) != RESULT_OK)
+    {
+        LogError("amqpvalue_encode() for data value failed");
+        result = __FAILURE__;
+    }
+    else
+    {
+        // Codes_SRS_UAMQP_MESSAGING_41_005: [With a cache, the encoding shall be written to a buffer owned by the cache and reused by the next message, growing it when needed.]
+        body_binary_data->bytes = cache->buffer;
+        body_binary_data->length = cache->length;
+
+        if (message_properties_cacheable && cached_message_properties == NULL)
+        {
+            save_encoded_section(&cache->message_properties, &content_type, &content_encoding, 1, cache->buffer, message_properties_end);
+        }
+
+        if (application_properties_cacheable && cached_application_properties == NULL && application_properties != NULL)
+        {
+            save_encoded_section(&cache->application_properties, property_keys, property_values, property_count, cache->buffer + message_properties_end, application_properties_end - message_properties_end);
+        }
+
+        result = RESULT_OK;
+    }
+
+    if (NULL != data_value)
+    {
+        amqpvalue_destroy(data_value);
+    }
+
+    if (NULL != application_properties)
+    {
+        amqpvalue_destroy(application_properties);
+    }
+
+    if (NULL != message_annotations)
+    {
+        amqpvalue_destroy(message_annotations);
+    }
+
+    if (NULL != message_properties)
+    {
+        amqpvalue_destroy(message_properties);
+    }
+
+    return result;
+}
+
 // Codes_SRS_UAMQP_MESSAGING_31_120: [Create a blob that contains AMQP encoding of IOTHUB_MESSAGE_HANDLE.]
 // Codes_SRS_UAMQP_MESSAGING_31_121: [Any errors during `message_create_uamqp_encoding_from_iothub_message` stop processing on this message.]
 int message_create_uamqp_encoding_from_iothub_message(MESSAGE_HANDLE message_batch_container, IOTHUB_MESSAGE_HANDLE message_handle, BINARY_DATA* body_binary_data)
@@ -661,6 +984,53 @@ int message_create_uamqp_encoding_from_iothub_message(MESSAGE_HANDLE message_bat
     return result;
 }
 
+UAMQP_ENCODING_CACHE_HANDLE uamqp_encoding_cache_create(void)
+{
+    UAMQP_ENCODING_CACHE* result;
+
+    // Codes_SRS_UAMQP_MESSAGING_41_001: [uamqp_encoding_cache_create shall allocate an empty cache, returning NULL if it fails.]
+    if ((result = (UAMQP_ENCODING_CACHE*)malloc(sizeof(UAMQP_ENCODING_CACHE))) == NULL)
+    {
+        LogError("Failed allocating the AMQP encoding cache");
+    }
+    else
+    {
+        memset(result, 0, sizeof(UAMQP_ENCODING_CACHE));
+    }
+
+    return result;
+}
+
+void uamqp_encoding_cache_destroy(UAMQP_ENCODING_CACHE_HANDLE cache)
+{
+    // Codes_SRS_UAMQP_MESSAGING_41_002: [uamqp_encoding_cache_destroy shall free the cached sections and the encoding buffer; a NULL cache is ignored.]
+    if (cache != NULL)
+    {
+        clear_encoded_section(&cache->message_properties);
+        clear_encoded_section(&cache->application_properties);
+        free(cache->buffer);
+        free(cache);
+    }
+}
+
+// Codes_SRS_UAMQP_MESSAGING_41_006: [If `cache` is NULL, message_create_uamqp_encoding_from_iothub_message_with_cache shall fail and return a non-zero value.]
+int message_create_uamqp_encoding_from_iothub_message_with_cache(UAMQP_ENCODING_CACHE_HANDLE cache, MESSAGE_HANDLE message_batch_container, IOTHUB_MESSAGE_HANDLE message_handle, BINARY_DATA* body_binary_data)
+{
+    int result;
+
+    if (cache == NULL)
+    {
+        LogError("Invalid argument (cache is NULL)");
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = create_uamqp_encoding_with_cache(cache, message_batch_container, message_handle, body_binary_data);
+    }
+
+    return result;
+}
+
 static int readMessageIdFromuAQMPMessage(IOTHUB_MESSAGE_HANDLE iothub_message_handle, PROPERTIES_HANDLE uamqp_message_properties)
 {
     int result;
@@ -30,6 +30,9 @@ static void my_gballoc_free(void* s)
 #include "azure_c_shared_utility/httpheaders.h"
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/shared_util_options.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/agenttime.h"
+#include "azure_c_shared_utility/lock.h"
 #undef ENABLE_MOCKS
 
 #include "internal/blob.h"
@@ -102,6 +105,36 @@ static void my_STRING_delete(STRING_HANDLE h)
     my_gballoc_free((void*)h);
 }
 
+static STRING_HANDLE my_STRING_new(void)
+{
+    return my_STRING_construct("");
+}
+
+static BUFFER_HANDLE my_BUFFER_new(void)
+{
+    return (BUFFER_HANDLE)my_gballoc_malloc(1);
+}
+
+static LOCK_HANDLE my_Lock_Init(void)
+{
+    return (LOCK_HANDLE)my_gballoc_malloc(1);
+}
+
+static LOCK_RESULT my_Lock_Deinit(LOCK_HANDLE handle)
+{
+    my_gballoc_free(handle);
+    return LOCK_OK;
+}
+
+/*the block upload workers never run, so the thread calling the upload PUTs every block*/
+static THREADAPI_RESULT my_ThreadAPI_Create(THREAD_HANDLE* threadHandle, THREAD_START_FUNC func, void* arg)
+{
+    (void)func;
+    (void)arg;
+    *threadHandle = (THREAD_HANDLE)0x4442;
+    return THREADAPI_OK;
+}
+
 static STRING_HANDLE my_Base64_Encode_Bytes(const unsigned char* source, size_t size)
 {
     (void)source;
@@ -132,6 +165,8 @@ static BUFFER_HANDLE testValidBufferHandle; /*assigned in TEST_SUITE_INITIALIZE*
 static unsigned int httpResponse; /*used as out parameter in every call to Blob_....*/
 static const unsigned int TwoHundred = 200;
 static const unsigned int FourHundredFour = 404;
+static const unsigned int FiveHundredThree = 503;
+static const time_t TEST_TIME_VALUE = (time_t)1000;
 
 
 /**
@@ -271,11 +306,31 @@ TEST_SUITE_INITIALIZE(TestSuiteInitialize)
     REGISTER_GLOBAL_MOCK_RETURN(STRING_c_str, "a");
     REGISTER_GLOBAL_MOCK_HOOK(STRING_delete, my_STRING_delete);
 
+    REGISTER_GLOBAL_MOCK_RETURN(get_time, TEST_TIME_VALUE);
+    REGISTER_GLOBAL_MOCK_RETURN(get_difftime, 0.0);
+
+    REGISTER_GLOBAL_MOCK_HOOK(STRING_new, my_STRING_new);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(STRING_new, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_new, my_BUFFER_new);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(BUFFER_new, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(Lock_Init, my_Lock_Init);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock_Init, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(Lock_Deinit, my_Lock_Deinit);
+    REGISTER_GLOBAL_MOCK_HOOK(ThreadAPI_Create, my_ThreadAPI_Create);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(ThreadAPI_Create, THREADAPI_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(ThreadAPI_Join, THREADAPI_OK);
+
     REGISTER_UMOCK_ALIAS_TYPE(HTTP_HEADERS_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(HTTPAPIEX_HANDLE, void*);
 
     REGISTER_UMOCK_ALIAS_TYPE(BUFFER_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(STRING_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(time_t, long);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(THREAD_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(THREAD_START_FUNC, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(THREADAPI_RESULT, int);
 
     REGISTER_TYPE(HTTPAPI_REQUEST_TYPE, HTTPAPI_REQUEST_TYPE);
     REGISTER_TYPE(HTTPAPIEX_RESULT, HTTPAPIEX_RESULT);
@@ -1623,4 +1678,756 @@ TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_returns_BLOB_ABORTED_when_call
     gballoc_free(fakeContext.fakeData);
 }
 
+/*the calls of Blob_UploadBlock, onWorker when a block upload worker PUTs it with its own status and response*/
+static void setup_block_put_expectations(const unsigned int* statusCodes, size_t statusCodesCount, bool onWorker)
+{
+    /*here some sprintf happens and that produces a string in the form: 000000...049999*/
+    STRICT_EXPECTED_CALL(Base64_Encode_Bytes(IGNORED_PTR_ARG, 6)) /*this is converting the produced blockID string to a base64 representation*/
+        .IgnoreArgument_source();
+
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "<Latest>")) /*this is building the XML*/
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is building the XML*/
+        .IgnoreArgument_s1()
+        .IgnoreArgument_s2();
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "</Latest>")) /*this is building the XML*/
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(STRING_construct("/something?a=b")); /*this is building the relativePath*/
+
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "&comp=block&blockid=")) /*this is building the relativePath*/
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*this is building the relativePath by adding the blockId (base64 encoded_*/
+        .IgnoreArgument_s1()
+        .IgnoreArgument_s2();
+
+    for (size_t attempt = 0; attempt < statusCodesCount; attempt++)
+    {
+        STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)) /*this is getting the relative path as const char* */
+            .IgnoreArgument_handle();
+
+        if (onWorker)
+        {
+            STRICT_EXPECTED_CALL(HTTPAPIEX_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_PUT, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG))
+                .IgnoreArgument_handle()
+                .IgnoreArgument_relativePath()
+                .IgnoreArgument_requestContent()
+                .IgnoreArgument_responseContent()
+                .CopyOutArgumentBuffer_statusCode(&statusCodes[attempt], sizeof(statusCodes[attempt]));
+        }
+        else
+        {
+            STRICT_EXPECTED_CALL(HTTPAPIEX_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_PUT, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG, &httpResponse, NULL, testValidBufferHandle))
+                .IgnoreArgument_handle()
+                .IgnoreArgument_relativePath()
+                .IgnoreArgument_requestContent()
+                .CopyOutArgumentBuffer_statusCode(&statusCodes[attempt], sizeof(statusCodes[attempt]));
+        }
+
+        if ((statusCodes[attempt] >= 500) && (attempt + 1 < BLOB_UPLOAD_BLOCK_MAX_ATTEMPTS))
+        {
+            STRICT_EXPECTED_CALL(ThreadAPI_Sleep((unsigned int)((attempt + 1) * BLOB_UPLOAD_BLOCK_RETRY_DELAY_MS))); /*this is backing off before the same block is PUT again*/
+        }
+    }
+
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)) /*this is unbuilding the relativePath*/
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)) /*this is unbuilding the blockID string to a base64 representation*/
+        .IgnoreArgument_handle();
+}
+
+static void setup_single_block_put_expectations(const unsigned char* content, const unsigned int* statusCodes, size_t statusCodesCount)
+{
+    STRICT_EXPECTED_CALL(BUFFER_create(content, 1)); /*this is the content to be uploaded by this call*/
+
+    setup_block_put_expectations(statusCodes, statusCodesCount, false);
+
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG)) /*this was the content to be uploaded*/
+        .IgnoreArgument_handle();
+}
+
+/*Tests_SRS_BLOB_41_001: [ If the HTTP response code is >=500 then Blob_UploadMultipleBlocksFromSasUri shall wait attempt * BLOB_UPLOAD_BLOCK_RETRY_DELAY_MS milliseconds and PUT the same block again with the same block ID, up to BLOB_UPLOAD_BLOCK_MAX_ATTEMPTS attempts in total. ]*/
+TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_retries_a_block_rejected_with_503)
+{
+    ///arrange
+    unsigned char c = '3';
+    const unsigned int statusCodes[] = { 503, 201 };
+    context.size = 1;
+    context.source = &c;
+    context.toUpload = context.size;
+
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is creating a copy of the hostname */
+        .IgnoreArgument_size();
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Create("h.h")); /*this is creating the httpapiex handle to storage (it is always the same host)*/
+    STRICT_EXPECTED_CALL(STRING_construct("<?xml version=\"1.0\" encoding=\"utf-8\"?>\r\n<BlockList>")); /*this is starting to build the XML used in Put Block List operation*/
+
+    setup_single_block_put_expectations(&c, statusCodes, sizeof(statusCodes) / sizeof(statusCodes[0]));
+
+    /*this part is Put Block list*/
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "</BlockList>")) /*This is closing the XML*/
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(STRING_construct("/something?a=b")); /*this is building the relative path for the Put BLock list*/
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "&comp=blocklist")) /*This is still building relative path for Put Block list*/
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)) /*this is getting the XML as const char* so it can be passed to _ExecuteRequest*/
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(BUFFER_create(IGNORED_PTR_ARG, IGNORED_NUM_ARG)) /*this is creating the XML body as BUFFER_HANDLE*/
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)) /*this is getting the relative path*/
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(HTTPAPIEX_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_PUT, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG, &httpResponse, NULL, testValidBufferHandle))
+        .IgnoreArgument_handle()
+        .IgnoreArgument_relativePath()
+        .IgnoreArgument_requestContent()
+        .CopyOutArgumentBuffer_statusCode(&TwoHundred, sizeof(TwoHundred));
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG)) /*This is the XML as BUFFER_HANDLE*/
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)) /*this is destroying the relative path for Put Block List*/
+        .IgnoreArgument_handle();
+
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))/*this is the XML string used for Put Block List operation*/
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG)) /*this is the HTTPAPIEX handle*/
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*this is freeing the copy of hte hostname*/
+        .IgnoreArgument_ptr();
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result);
+    ASSERT_ARE_EQUAL(int, 200, (int)httpResponse);
+
+    ///cleanup
+}
+
+/*Tests_SRS_BLOB_41_001: [ If the HTTP response code is >=500 then Blob_UploadMultipleBlocksFromSasUri shall wait attempt * BLOB_UPLOAD_BLOCK_RETRY_DELAY_MS milliseconds and PUT the same block again with the same block ID, up to BLOB_UPLOAD_BLOCK_MAX_ATTEMPTS attempts in total. ]*/
+/*Tests_SRS_BLOB_02_026: [ Otherwise, if HTTP response code is >=300 then Blob_UploadMultipleBlocksFromSasUri shall succeed and return BLOB_OK. ]*/
+TEST_FUNCTION(Blob_UploadMultipleBlocksFromSasUri_stops_retrying_a_block_after_the_maximum_attempts)
+{
+    ///arrange
+    unsigned char c = '3';
+    unsigned int statusCodes[BLOB_UPLOAD_BLOCK_MAX_ATTEMPTS];
+    for (size_t i = 0; i < BLOB_UPLOAD_BLOCK_MAX_ATTEMPTS; i++)
+    {
+        statusCodes[i] = FiveHundredThree;
+    }
+    context.size = 1;
+    context.source = &c;
+    context.toUpload = context.size;
+
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is creating a copy of the hostname */
+        .IgnoreArgument_size();
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Create("h.h")); /*this is creating the httpapiex handle to storage (it is always the same host)*/
+    STRICT_EXPECTED_CALL(STRING_construct("<?xml version=\"1.0\" encoding=\"utf-8\"?>\r\n<BlockList>")); /*this is starting to build the XML used in Put Block List operation*/
+
+    setup_single_block_put_expectations(&c, statusCodes, BLOB_UPLOAD_BLOCK_MAX_ATTEMPTS);
+
+    /*this part is Put Block list*/ /*notice: no op because the block was never accepted*/
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))/*this is the XML string used for Put Block List operation*/
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG)) /*this is the HTTPAPIEX handle*/
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*this is freeing the copy of hte hostname*/
+        .IgnoreArgument_ptr();
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result);
+    ASSERT_ARE_EQUAL(int, 503, (int)httpResponse);
+
+    ///cleanup
+    httpResponse = TwoHundred;
+}
+
+/*Tests_SRS_BLOB_41_002: [ If `committedBlockCount` is greater than `MAX_BLOCK_COUNT` then `Blob_ResumeMultipleBlocksFromSasUri` shall fail and return `BLOB_INVALID_ARG`. ]*/
+TEST_FUNCTION(Blob_ResumeMultipleBlocksFromSasUri_when_committedBlockCount_is_one_over_maximum_fails)
+{
+    ///arrange
+    unsigned char c = '3';
+    context.size = 1;
+    context.source = &c;
+    context.toUpload = context.size;
+
+    umock_c_reset_all_calls();
+
+    ///act
+    BLOB_RESULT result = Blob_ResumeMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL, MAX_BLOCK_COUNT + 1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_INVALID_ARG, result);
+
+    ///cleanup
+}
+
+/*Tests_SRS_BLOB_41_003: [ `Blob_ResumeMultipleBlocksFromSasUri` shall add the BASE64 encoded IDs of the first `committedBlockCount` blocks to the XML block list before any new block; if that fails it shall fail and return `BLOB_ERROR`. ]*/
+/*Tests_SRS_BLOB_41_004: [ Otherwise `Blob_ResumeMultipleBlocksFromSasUri` shall behave as `Blob_UploadMultipleBlocksFromSasUri`, numbering the first block it asks `getDataCallbackEx` for `committedBlockCount`. ]*/
+TEST_FUNCTION(Blob_ResumeMultipleBlocksFromSasUri_lists_the_committed_blocks_before_the_new_ones)
+{
+    ///arrange
+    unsigned char c = '3';
+    const unsigned int statusCodes[] = { 201 };
+    context.size = 1;
+    context.source = &c;
+    context.toUpload = context.size;
+
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is creating a copy of the hostname */
+        .IgnoreArgument_size();
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Create("h.h")); /*this is creating the httpapiex handle to storage (it is always the same host)*/
+    STRICT_EXPECTED_CALL(STRING_construct("<?xml version=\"1.0\" encoding=\"utf-8\"?>\r\n<BlockList>")); /*this is starting to build the XML used in Put Block List operation*/
+
+    /*this is the block uploaded by the interrupted upload: it is only listed, not uploaded again*/
+    STRICT_EXPECTED_CALL(Base64_Encode_Bytes(IGNORED_PTR_ARG, 6))
+        .IgnoreArgument_source();
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "<Latest>"))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument_s1()
+        .IgnoreArgument_s2();
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "</Latest>"))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+
+    setup_single_block_put_expectations(&c, statusCodes, sizeof(statusCodes) / sizeof(statusCodes[0]));
+
+    /*this part is Put Block list*/
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "</BlockList>")) /*This is closing the XML*/
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(STRING_construct("/something?a=b")); /*this is building the relative path for the Put BLock list*/
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "&comp=blocklist")) /*This is still building relative path for Put Block list*/
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)) /*this is getting the XML as const char* so it can be passed to _ExecuteRequest*/
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(BUFFER_create(IGNORED_PTR_ARG, IGNORED_NUM_ARG)) /*this is creating the XML body as BUFFER_HANDLE*/
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)) /*this is getting the relative path*/
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(HTTPAPIEX_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_PUT, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG, &httpResponse, NULL, testValidBufferHandle))
+        .IgnoreArgument_handle()
+        .IgnoreArgument_relativePath()
+        .IgnoreArgument_requestContent()
+        .CopyOutArgumentBuffer_statusCode(&TwoHundred, sizeof(TwoHundred));
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG)) /*This is the XML as BUFFER_HANDLE*/
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)) /*this is destroying the relative path for Put Block List*/
+        .IgnoreArgument_handle();
+
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))/*this is the XML string used for Put Block List operation*/
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG)) /*this is the HTTPAPIEX handle*/
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*this is freeing the copy of hte hostname*/
+        .IgnoreArgument_ptr();
+
+    ///act
+    BLOB_RESULT result = Blob_ResumeMultipleBlocksFromSasUri("https://h.h/something?a=b", FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL, 1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result);
+    ASSERT_ARE_EQUAL(int, 200, (int)httpResponse);
+
+    ///cleanup
+}
+
+/*Tests_SRS_BLOB_41_010: [ If `connection` is NULL or `committedBlockCount` is greater than `MAX_BLOCK_COUNT` then `Blob_UploadMultipleBlocksOnConnection` shall fail and return `BLOB_INVALID_ARG`. ]*/
+TEST_FUNCTION(Blob_UploadMultipleBlocksOnConnection_with_NULL_connection_fails)
+{
+    ///arrange
+    umock_c_reset_all_calls();
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksOnConnection(NULL, "https://h.h/something?a=b", FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL, 0);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_INVALID_ARG, result);
+
+    ///cleanup
+}
+
+static void setup_put_block_list_expectations(void)
+{
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "</BlockList>")) /*This is closing the XML*/
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(STRING_construct("/something?a=b")); /*this is building the relative path for the Put BLock list*/
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "&comp=blocklist")) /*This is still building relative path for Put Block list*/
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)) /*this is getting the XML as const char* so it can be passed to _ExecuteRequest*/
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(BUFFER_create(IGNORED_PTR_ARG, IGNORED_NUM_ARG)) /*this is creating the XML body as BUFFER_HANDLE*/
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)) /*this is getting the relative path*/
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(HTTPAPIEX_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_PUT, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG, &httpResponse, NULL, testValidBufferHandle))
+        .IgnoreArgument_handle()
+        .IgnoreArgument_relativePath()
+        .IgnoreArgument_requestContent()
+        .CopyOutArgumentBuffer_statusCode(&TwoHundred, sizeof(TwoHundred));
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG)) /*This is the XML as BUFFER_HANDLE*/
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)) /*this is destroying the relative path for Put Block List*/
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))/*this is the XML string used for Put Block List operation*/
+        .IgnoreArgument_handle();
+}
+
+/*Tests_SRS_BLOB_41_005: [ `Blob_Connection_Create` shall allocate a connection that keeps no HTTPAPIEX_HANDLE yet, or return NULL if that fails. ]*/
+/*Tests_SRS_BLOB_41_008: [ Unless the upload failed, `Blob_UploadMultipleBlocksOnConnection` shall keep the HTTPAPIEX_HANDLE in `connection` instead of destroying it. ]*/
+TEST_FUNCTION(Blob_UploadMultipleBlocksOnConnection_keeps_the_connection)
+{
+    ///arrange
+    unsigned char c = '3';
+    const unsigned int statusCodes[] = { 201 };
+    BLOB_CONNECTION_HANDLE connection = Blob_Connection_Create(30);
+    ASSERT_IS_NOT_NULL(connection);
+    context.size = 1;
+    context.source = &c;
+    context.toUpload = context.size;
+
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is creating a copy of the hostname */
+        .IgnoreArgument_size();
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Create("h.h")); /*nothing is kept yet*/
+    STRICT_EXPECTED_CALL(STRING_construct("<?xml version=\"1.0\" encoding=\"utf-8\"?>\r\n<BlockList>"));
+    setup_single_block_put_expectations(&c, statusCodes, sizeof(statusCodes) / sizeof(statusCodes[0]));
+    setup_put_block_list_expectations();
+    STRICT_EXPECTED_CALL(get_time(NULL)); /*this is stamping the kept connection, neither it nor the hostname are freed*/
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksOnConnection(connection, "https://h.h/something?a=b", FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL, 0);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result);
+
+    ///cleanup
+    Blob_Connection_Destroy(connection);
+}
+
+/*Tests_SRS_BLOB_41_006: [ `Blob_UploadMultipleBlocksOnConnection` shall reuse the HTTPAPIEX_HANDLE kept by `connection` when it goes to the hostname of `SASURI` and has been idle for at most the idle timeout, without setting its options again. ]*/
+TEST_FUNCTION(Blob_UploadMultipleBlocksOnConnection_reuses_the_kept_connection_to_the_same_host)
+{
+    ///arrange
+    unsigned char c = '3';
+    const unsigned int statusCodes[] = { 201 };
+    BLOB_CONNECTION_HANDLE connection = Blob_Connection_Create(30);
+    context.size = 1;
+    context.source = &c;
+    context.toUpload = context.size;
+    (void)Blob_UploadMultipleBlocksOnConnection(connection, "https://h.h/something?a=b", FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, "certificates", NULL, 0);
+    context.toUpload = context.size;
+
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is creating a copy of the hostname */
+        .IgnoreArgument_size();
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(get_difftime(TEST_TIME_VALUE, TEST_TIME_VALUE)); /*not idle for longer than 30 seconds*/
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)); /*this is the hostname the connection kept*/
+    STRICT_EXPECTED_CALL(STRING_construct("<?xml version=\"1.0\" encoding=\"utf-8\"?>\r\n<BlockList>")); /*no HTTPAPIEX_Create and no TrustedCerts*/
+    setup_single_block_put_expectations(&c, statusCodes, sizeof(statusCodes) / sizeof(statusCodes[0]));
+    setup_put_block_list_expectations();
+    STRICT_EXPECTED_CALL(get_time(NULL));
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksOnConnection(connection, "https://h.h/something?a=b", FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, "certificates", NULL, 0);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result);
+
+    ///cleanup
+    Blob_Connection_Destroy(connection);
+}
+
+/*Tests_SRS_BLOB_41_007: [ Otherwise `Blob_UploadMultipleBlocksOnConnection` shall destroy the kept HTTPAPIEX_HANDLE and create a new one like `Blob_UploadMultipleBlocksFromSasUri` does. ]*/
+TEST_FUNCTION(Blob_UploadMultipleBlocksOnConnection_replaces_an_idle_connection)
+{
+    ///arrange
+    unsigned char c = '3';
+    const unsigned int statusCodes[] = { 201 };
+    BLOB_CONNECTION_HANDLE connection = Blob_Connection_Create(30);
+    context.size = 1;
+    context.source = &c;
+    context.toUpload = context.size;
+    (void)Blob_UploadMultipleBlocksOnConnection(connection, "https://h.h/something?a=b", FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL, 0);
+    context.toUpload = context.size;
+
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is creating a copy of the hostname */
+        .IgnoreArgument_size();
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(get_difftime(TEST_TIME_VALUE, TEST_TIME_VALUE))
+        .SetReturn(31.0); /*idle for longer than 30 seconds*/
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG)); /*this is the idle connection*/
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)); /*this is the hostname the connection kept*/
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Create("h.h"));
+    STRICT_EXPECTED_CALL(STRING_construct("<?xml version=\"1.0\" encoding=\"utf-8\"?>\r\n<BlockList>"));
+    setup_single_block_put_expectations(&c, statusCodes, sizeof(statusCodes) / sizeof(statusCodes[0]));
+    setup_put_block_list_expectations();
+    STRICT_EXPECTED_CALL(get_time(NULL));
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksOnConnection(connection, "https://h.h/something?a=b", FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL, 0);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result);
+
+    ///cleanup
+    Blob_Connection_Destroy(connection);
+}
+
+/*Tests_SRS_BLOB_41_009: [ `Blob_Connection_Destroy` shall destroy the kept HTTPAPIEX_HANDLE, if any, and free `connection`. ]*/
+TEST_FUNCTION(Blob_Connection_Destroy_closes_the_kept_connection)
+{
+    ///arrange
+    unsigned char c = '3';
+    BLOB_CONNECTION_HANDLE connection = Blob_Connection_Create(30);
+    context.size = 1;
+    context.source = &c;
+    context.toUpload = context.size;
+    (void)Blob_UploadMultipleBlocksOnConnection(connection, "https://h.h/something?a=b", FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL, 0);
+
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)); /*this is the hostname*/
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)); /*this is the connection*/
+
+    ///act
+    Blob_Connection_Destroy(connection);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_BLOB_41_011: [ If `committedBlockCount` is greater than `MAX_BLOCK_COUNT` then `Blob_UploadMultipleBlocksInParallel` shall fail and return `BLOB_INVALID_ARG`. ]*/
+TEST_FUNCTION(Blob_UploadMultipleBlocksInParallel_when_committedBlockCount_is_one_over_maximum_fails)
+{
+    ///arrange
+    unsigned char c = '3';
+    context.size = 1;
+    context.source = &c;
+    context.toUpload = context.size;
+
+    umock_c_reset_all_calls();
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksInParallel(NULL, "https://h.h/something?a=b", FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL, MAX_BLOCK_COUNT + 1, 2);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_INVALID_ARG, result);
+
+    ///cleanup
+}
+
+/*the one block of context PUT by the thread calling the upload, between the workers being set up and torn down*/
+static void setup_parallel_block_put_expectations(const unsigned char* content, const unsigned int* statusCodes, size_t statusCodesCount)
+{
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(BUFFER_create(content, 1)); /*this is the copy of the block kept while it is in flight*/
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+
+    setup_block_put_expectations(statusCodes, statusCodesCount, true);
+
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG)) /*this was the content to be uploaded*/
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(STRING_empty(IGNORED_PTR_ARG)) /*this is emptying the block ID list of the worker*/
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+}
+
+static void setup_put_block_list_expectations(void)
+{
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "</BlockList>")) /*This is closing the XML*/
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(STRING_construct("/something?a=b")); /*this is building the relative path for the Put BLock list*/
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "&comp=blocklist")) /*This is still building relative path for Put Block list*/
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)) /*this is getting the XML as const char* so it can be passed to _ExecuteRequest*/
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(BUFFER_create(IGNORED_PTR_ARG, IGNORED_NUM_ARG)) /*this is creating the XML body as BUFFER_HANDLE*/
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)) /*this is getting the relative path*/
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(HTTPAPIEX_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_PUT, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG, &httpResponse, NULL, testValidBufferHandle))
+        .IgnoreArgument_handle()
+        .IgnoreArgument_relativePath()
+        .IgnoreArgument_requestContent()
+        .CopyOutArgumentBuffer_statusCode(&TwoHundred, sizeof(TwoHundred));
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG)) /*This is the XML as BUFFER_HANDLE*/
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)) /*this is destroying the relative path for Put Block List*/
+        .IgnoreArgument_handle();
+}
+
+/*Tests_SRS_BLOB_41_012: [ If `parallelism` is greater than 1, `Blob_UploadMultipleBlocksInParallel` shall PUT up to `parallelism` blocks at the same time and wait for all of them before putting the block list. ]*/
+/*Tests_SRS_BLOB_41_015: [ Every block upload worker but the calling thread shall have its own HTTPAPIEX_HANDLE to the storage host, created with the same options; if a worker cannot be created or started, the blocks shall be uploaded by the workers started before it. ]*/
+/*Tests_SRS_BLOB_41_016: [ Once every block was acknowledged, `Blob_UploadMultipleBlocksInParallel` shall add the BASE64 encoded IDs of the new blocks to the XML block list in block order, whatever the order storage acknowledged them in. ]*/
+TEST_FUNCTION(Blob_UploadMultipleBlocksInParallel_puts_the_blocks_with_one_connection_per_worker)
+{
+    ///arrange
+    unsigned char c = '3';
+    const unsigned int statusCodes[] = { 201 };
+    context.size = 1;
+    context.source = &c;
+    context.toUpload = context.size;
+
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is creating a copy of the hostname */
+        .IgnoreArgument_size();
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Create("h.h")); /*this is the connection of the thread calling the upload*/
+    STRICT_EXPECTED_CALL(STRING_construct("<?xml version=\"1.0\" encoding=\"utf-8\"?>\r\n<BlockList>")); /*this is starting to build the XML used in Put Block List operation*/
+
+    /*this is setting up the 2 workers*/
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument_size();
+    STRICT_EXPECTED_CALL(STRING_new());
+    STRICT_EXPECTED_CALL(BUFFER_new());
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Create("h.h")); /*this is the connection of the second worker*/
+    STRICT_EXPECTED_CALL(STRING_new());
+    STRICT_EXPECTED_CALL(BUFFER_new());
+    STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+
+    setup_parallel_block_put_expectations(&c, statusCodes, sizeof(statusCodes) / sizeof(statusCodes[0]));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)) /*no block left*/
+        .IgnoreArgument_handle();
+
+    /*this is tearing down the workers*/
+    STRICT_EXPECTED_CALL(ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG)) /*this is the connection of the second worker*/
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument_ptr();
+    STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+
+    /*this is listing the block uploaded by the workers*/
+    STRICT_EXPECTED_CALL(Base64_Encode_Bytes(IGNORED_PTR_ARG, 6))
+        .IgnoreArgument_source();
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "<Latest>"))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument_s1()
+        .IgnoreArgument_s2();
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "</Latest>"))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+
+    setup_put_block_list_expectations();
+
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))/*this is the XML string used for Put Block List operation*/
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG)) /*this is the HTTPAPIEX handle*/
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*this is freeing the copy of hte hostname*/
+        .IgnoreArgument_ptr();
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksInParallel(NULL, "https://h.h/something?a=b", FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL, 0, 2);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result);
+    ASSERT_ARE_EQUAL(int, 200, (int)httpResponse);
+
+    ///cleanup
+}
+
+/*Tests_SRS_BLOB_41_017: [ If `parallelism` is greater than `BLOB_UPLOAD_MAX_PARALLELISM`, `Blob_UploadMultipleBlocksInParallel` shall PUT up to `BLOB_UPLOAD_MAX_PARALLELISM` blocks at the same time. ]*/
+TEST_FUNCTION(Blob_UploadMultipleBlocksInParallel_starts_at_most_BLOB_UPLOAD_MAX_PARALLELISM_workers)
+{
+    ///arrange
+    unsigned char c = '3';
+    const unsigned int statusCodes[] = { 201 };
+    size_t index;
+    context.size = 1;
+    context.source = &c;
+    context.toUpload = context.size;
+
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is creating a copy of the hostname */
+        .IgnoreArgument_size();
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Create("h.h")); /*this is the connection of the thread calling the upload*/
+    STRICT_EXPECTED_CALL(STRING_construct("<?xml version=\"1.0\" encoding=\"utf-8\"?>\r\n<BlockList>")); /*this is starting to build the XML used in Put Block List operation*/
+
+    /*this is setting up BLOB_UPLOAD_MAX_PARALLELISM workers, not one more*/
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument_size();
+    STRICT_EXPECTED_CALL(STRING_new());
+    STRICT_EXPECTED_CALL(BUFFER_new());
+    for (index = 1; index < BLOB_UPLOAD_MAX_PARALLELISM; index++)
+    {
+        STRICT_EXPECTED_CALL(HTTPAPIEX_Create("h.h"));
+        STRICT_EXPECTED_CALL(STRING_new());
+        STRICT_EXPECTED_CALL(BUFFER_new());
+    }
+    for (index = 1; index < BLOB_UPLOAD_MAX_PARALLELISM; index++)
+    {
+        STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+    }
+
+    setup_parallel_block_put_expectations(&c, statusCodes, sizeof(statusCodes) / sizeof(statusCodes[0]));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)) /*no block left*/
+        .IgnoreArgument_handle();
+
+    /*this is tearing down the workers*/
+    for (index = 1; index < BLOB_UPLOAD_MAX_PARALLELISM; index++)
+    {
+        STRICT_EXPECTED_CALL(ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+    }
+    for (index = 0; index < BLOB_UPLOAD_MAX_PARALLELISM; index++)
+    {
+        STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle();
+        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle();
+        if (index != 0)
+        {
+            STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG))
+                .IgnoreArgument_handle();
+        }
+    }
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument_ptr();
+    STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+
+    /*this is listing the block uploaded by the workers*/
+    STRICT_EXPECTED_CALL(Base64_Encode_Bytes(IGNORED_PTR_ARG, 6))
+        .IgnoreArgument_source();
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "<Latest>"))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument_s1()
+        .IgnoreArgument_s2();
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "</Latest>"))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+
+    setup_put_block_list_expectations();
+
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))/*this is the XML string used for Put Block List operation*/
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG)) /*this is the HTTPAPIEX handle*/
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*this is freeing the copy of hte hostname*/
+        .IgnoreArgument_ptr();
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksInParallel(NULL, "https://h.h/something?a=b", FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL, 0, BLOB_UPLOAD_MAX_PARALLELISM + 1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result);
+    ASSERT_ARE_EQUAL(int, 200, (int)httpResponse);
+
+    ///cleanup
+}
+
+/*Tests_SRS_BLOB_41_014: [ Once a block failed, no block shall be asked for, the blocks in flight shall be waited for and the first block that failed shall be reported with its result, HTTP status and HTTP response as `Blob_UploadMultipleBlocksFromSasUri` reports a block that failed. ]*/
+/*Tests_SRS_BLOB_41_015: [ Every block upload worker but the calling thread shall have its own HTTPAPIEX_HANDLE to the storage host, created with the same options; if a worker cannot be created or started, the blocks shall be uploaded by the workers started before it. ]*/
+TEST_FUNCTION(Blob_UploadMultipleBlocksInParallel_reports_the_block_that_failed_and_does_not_put_the_block_list)
+{
+    ///arrange
+    unsigned char c = '3';
+    const unsigned int statusCodes[] = { 404 };
+    context.size = 1;
+    context.source = &c;
+    context.toUpload = context.size;
+
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is creating a copy of the hostname */
+        .IgnoreArgument_size();
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Create("h.h")); /*this is the connection of the thread calling the upload*/
+    STRICT_EXPECTED_CALL(STRING_construct("<?xml version=\"1.0\" encoding=\"utf-8\"?>\r\n<BlockList>")); /*this is starting to build the XML used in Put Block List operation*/
+
+    /*the second worker cannot connect, so the thread calling the upload PUTs the blocks alone*/
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument_size();
+    STRICT_EXPECTED_CALL(STRING_new());
+    STRICT_EXPECTED_CALL(BUFFER_new());
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Create("h.h"))
+        .SetReturn(NULL);
+
+    setup_parallel_block_put_expectations(&c, statusCodes, sizeof(statusCodes) / sizeof(statusCodes[0]));
+    STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG)) /*this is copying the response of the block that failed*/
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(BUFFER_build(testValidBufferHandle, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .IgnoreArgument_source()
+        .IgnoreArgument_size();
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument_ptr();
+    STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument_handle();
+
+    /*this part is Put Block list*/ /*notice: no op because the block was never accepted*/
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))/*this is the XML string used for Put Block List operation*/
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG)) /*this is the HTTPAPIEX handle*/
+        .IgnoreArgument_handle();
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*this is freeing the copy of hte hostname*/
+        .IgnoreArgument_ptr();
+
+    ///act
+    BLOB_RESULT result = Blob_UploadMultipleBlocksInParallel(NULL, "https://h.h/something?a=b", FileUpload_GetData_Callback, &context, &httpResponse, testValidBufferHandle, NULL, NULL, 0, 2);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(BLOB_RESULT, BLOB_OK, result);
+    ASSERT_ARE_EQUAL(int, 404, (int)httpResponse);
+
+    ///cleanup
+    httpResponse = TwoHundred;
+}
+
 END_TEST_SUITE(blob_ut);
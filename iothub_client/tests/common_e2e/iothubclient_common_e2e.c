@@ -38,6 +38,7 @@
 #include "azure_c_shared_utility/threadapi.h"
 #include "azure_c_shared_utility/shared_util_options.h"
 #include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/tickcounter.h"
 #include "azure_c_shared_utility/lock.h"
 
 #ifdef SET_TRUSTED_CERT_IN_SAMPLES
@@ -93,6 +94,8 @@ typedef struct EXPECTED_SEND_DATA_TAG
     IOTHUB_CLIENT_CONFIRMATION_RESULT result;
     LOCK_HANDLE lock;
     IOTHUB_MESSAGE_HANDLE msgHandle;
+    tickcounter_ms_t confirmedMs;   // only set while a recovery benchmark runs
+    size_t timesFound;              // only counted by the recovery benchmark
 } EXPECTED_SEND_DATA;
 
 typedef struct EXPECTED_RECEIVE_DATA_TAG
@@ -109,10 +112,15 @@ typedef struct CONNECTION_STATUS_DATA_TAG
     LOCK_HANDLE lock;
     IOTHUB_CLIENT_CONNECTION_STATUS currentStatus;
     IOTHUB_CLIENT_CONNECTION_STATUS_REASON currentStatusReason;
+    tickcounter_ms_t faultMs;       // only set while a recovery benchmark runs
+    tickcounter_ms_t restoredMs;    // only set while a recovery benchmark runs
 } CONNECTION_STATUS_INFO;
 
 static CONNECTION_STATUS_INFO g_connection_status_info;
 
+// Created by the recovery benchmark to time the connection status changes and confirmations.
+static TICK_COUNTER_HANDLE g_recovery_tick_counter = NULL;
+
 static void openCompleteCallback(void* context)
 {
     LogInfo("Open completed, context: %s", (char*)context);
@@ -174,11 +182,19 @@ static void connection_status_callback(IOTHUB_CLIENT_CONNECTION_STATUS status, I
             (status == IOTHUB_CLIENT_CONNECTION_UNAUTHENTICATED))
         {
             connection_status_info->connFaultHappened = true;
+            if (g_recovery_tick_counter != NULL)
+            {
+                (void)tickcounter_get_current_ms(g_recovery_tick_counter, &connection_status_info->faultMs);
+            }
         }
         if ((connection_status_info->currentStatus == IOTHUB_CLIENT_CONNECTION_UNAUTHENTICATED) &&
             (status == IOTHUB_CLIENT_CONNECTION_AUTHENTICATED))
         {
             connection_status_info->connRestored = true;
+            if (g_recovery_tick_counter != NULL)
+            {
+                (void)tickcounter_get_current_ms(g_recovery_tick_counter, &connection_status_info->restoredMs);
+            }
         }
         connection_status_info->currentStatus = status;
         connection_status_info->currentStatusReason = reason;
@@ -202,6 +218,10 @@ static void ReceiveConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_RESULT result
         {
             expectedData->dataWasRecv = true;
             expectedData->result = result;
+            if (g_recovery_tick_counter != NULL)
+            {
+                (void)tickcounter_get_current_ms(g_recovery_tick_counter, &expectedData->confirmedMs);
+            }
             (void)Unlock(expectedData->lock);
         }
     }
@@ -557,6 +577,22 @@ static void setconnectionstatuscallback_on_device_or_module()
     ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result, "Could not set connection Status Callback");
 }
 
+static void setretrypolicy_on_device_or_module(IOTHUB_CLIENT_RETRY_POLICY retryPolicy, size_t retryTimeoutLimitInSeconds)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if (iothub_moduleclient_handle != NULL)
+    {
+        result = IoTHubModuleClient_SetRetryPolicy(iothub_moduleclient_handle, retryPolicy, retryTimeoutLimitInSeconds);
+    }
+    else
+    {
+        result = IoTHubDeviceClient_SetRetryPolicy(iothub_deviceclient_handle, retryPolicy, retryTimeoutLimitInSeconds);
+    }
+
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result, "Could not set the retry policy");
+}
+
 static void sendeventasync_on_device_or_module(IOTHUB_MESSAGE_HANDLE msgHandle, EXPECTED_SEND_DATA* sendData)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -1468,6 +1504,142 @@ void e2e_c2d_with_svc_fault_ctrl(IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol, cons
     destroy_d2c_message_handle(d2cMessage);
 }
 
+// How many messages the recovery benchmark queues while the connection is down.
+#define RECOVERY_BACKLOG_MESSAGE_COUNT   20
+#define RECOVERY_RETRY_TIMEOUT_LIMIT_SECS 300
+
+typedef struct RECOVERY_BACKLOG_TAG
+{
+    EXPECTED_SEND_DATA* messages[RECOVERY_BACKLOG_MESSAGE_COUNT];
+    size_t count;
+} RECOVERY_BACKLOG;
+
+// Counts every copy of a backlog message the service receives, so duplicates can be reported.
+static int IoTHubBacklogCallback(void* context, const char* data, size_t size)
+{
+    RECOVERY_BACKLOG* backlog = (RECOVERY_BACKLOG*)context;
+    size_t i;
+
+    for (i = 0; i < backlog->count; i++)
+    {
+        EXPECTED_SEND_DATA* expectedData = backlog->messages[i];
+
+        if ((strlen(expectedData->expectedString) == size) &&
+            (memcmp(expectedData->expectedString, data, size) == 0))
+        {
+            expectedData->wasFound = true;
+            expectedData->timesFound++;
+            break;
+        }
+    }
+
+    return 0; // keep listening until the drain time is over, duplicates can arrive late
+}
+
+// Measures how long a client takes to recover from a connection killed through fault injection:
+// the time from the fault to the first message published after it, the rate the messages queued
+// during the outage drain at once reconnected, and how many of them the service got more than once.
+static void e2e_d2c_with_svc_fault_ctrl_recovery_benchmark(IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol, const char* faultOperationType, const char* faultOperationCloseReason, const char* faultOperationDelayInSecs, IOTHUB_CLIENT_RETRY_POLICY retryPolicy)
+{
+    IOTHUB_PROVISIONED_DEVICE* deviceToUse = IoTHubAccount_GetSASDevice(g_iothubAcctInfo);
+    D2C_MESSAGE_HANDLE d2cMessageInitial;
+    D2C_MESSAGE_HANDLE d2cMessageFaultInjection;
+    RECOVERY_BACKLOG backlog;
+    tickcounter_ms_t firstConfirmedMs = 0;
+    tickcounter_ms_t lastConfirmedMs = 0;
+    size_t duplicates = 0;
+    size_t lost = 0;
+    size_t i;
+
+    // arrange
+    g_recovery_tick_counter = tickcounter_create();
+    ASSERT_IS_NOT_NULL(g_recovery_tick_counter, "Could not create the tick counter of the recovery benchmark");
+
+    clear_connection_status_info_flags();
+
+    client_connect_to_hub(deviceToUse, protocol);
+    setretrypolicy_on_device_or_module(retryPolicy, RECOVERY_RETRY_TIMEOUT_LIMIT_SECS);
+
+    LogInfo("Send message and wait for confirmation...");
+    d2cMessageInitial = client_create_and_send_d2c(TEST_MESSAGE_CREATE_BYTE_ARRAY);
+    ASSERT_IS_TRUE(client_wait_for_d2c_confirmation(d2cMessageInitial, IOTHUB_CLIENT_CONFIRMATION_OK), "Failure sending data to IotHub");
+
+    // act
+    LogInfo("Send server fault control message...");
+    d2cMessageFaultInjection = send_error_injection_message(faultOperationType, faultOperationCloseReason, faultOperationDelayInSecs);
+
+    LogInfo("wait for fault...");
+    ASSERT_IS_TRUE(client_wait_for_connection_fault(), "Fault injection failed - no fault happened");
+
+    LogInfo("Queue %d messages while the connection is down...", RECOVERY_BACKLOG_MESSAGE_COUNT);
+    for (i = 0; i < RECOVERY_BACKLOG_MESSAGE_COUNT; i++)
+    {
+        backlog.messages[i] = (EXPECTED_SEND_DATA*)client_create_and_send_d2c(TEST_MESSAGE_CREATE_BYTE_ARRAY);
+    }
+    backlog.count = RECOVERY_BACKLOG_MESSAGE_COUNT;
+
+    LogInfo("wait for restore...");
+    ASSERT_IS_TRUE(client_wait_for_connection_restored(), "Fault injection failed - connection has not been restored");
+
+    LogInfo("wait for the queued messages to be confirmed...");
+    for (i = 0; i < backlog.count; i++)
+    {
+        ASSERT_IS_TRUE(client_wait_for_d2c_confirmation((D2C_MESSAGE_HANDLE)backlog.messages[i], IOTHUB_CLIENT_CONFIRMATION_OK), "Queued message was not sent after the connection was restored");
+
+        if (i == 0 || backlog.messages[i]->confirmedMs < firstConfirmedMs)
+        {
+            firstConfirmedMs = backlog.messages[i]->confirmedMs;
+        }
+        if (backlog.messages[i]->confirmedMs > lastConfirmedMs)
+        {
+            lastConfirmedMs = backlog.messages[i]->confirmedMs;
+        }
+    }
+
+    destroy_on_device_or_module();
+
+    // assert
+    IOTHUB_TEST_HANDLE iotHubTestHandle = IoTHubTest_Initialize(IoTHubAccount_GetEventHubConnectionString(g_iothubAcctInfo), IoTHubAccount_GetIoTHubConnString(g_iothubAcctInfo), deviceToUse->deviceId, IoTHubAccount_GetEventhubListenName(g_iothubAcctInfo), IoTHubAccount_GetEventhubAccessKey(g_iothubAcctInfo), IoTHubAccount_GetSharedAccessSignature(g_iothubAcctInfo), IoTHubAccount_GetEventhubConsumerGroup(g_iothubAcctInfo));
+    ASSERT_IS_NOT_NULL(iotHubTestHandle, "Could not initialize IoTHubTest in order to listen for events");
+
+    LogInfo("Listening for the queued messages for %d seconds...", MAX_SERVICE_EVENT_WAIT_TIME_SECONDS);
+    IOTHUB_TEST_CLIENT_RESULT result = IoTHubTest_ListenForEvent(iotHubTestHandle, IoTHubBacklogCallback, IoTHubAccount_GetIoTHubPartitionCount(g_iothubAcctInfo), &backlog, time(NULL) - SERVICE_EVENT_WAIT_TIME_DELTA_SECONDS, MAX_SERVICE_EVENT_WAIT_TIME_SECONDS);
+    ASSERT_ARE_EQUAL(IOTHUB_TEST_CLIENT_RESULT, IOTHUB_TEST_CLIENT_OK, result, "Listening for the events failed");
+    IoTHubTest_Deinit(iotHubTestHandle);
+
+    for (i = 0; i < backlog.count; i++)
+    {
+        if (backlog.messages[i]->timesFound == 0)
+        {
+            lost++;
+        }
+        else
+        {
+            duplicates += backlog.messages[i]->timesFound - 1;
+        }
+    }
+
+    LogInfo("Recovery benchmark: fault=%s, retry policy=%s; fault to reconnected=%lu ms, fault to first publish=%lu ms; %lu messages drained in %lu ms (%.1f msg/s); duplicates=%lu, lost=%lu",
+        faultOperationType, ENUM_TO_STRING(IOTHUB_CLIENT_RETRY_POLICY, retryPolicy),
+        (unsigned long)(g_connection_status_info.restoredMs - g_connection_status_info.faultMs), (unsigned long)(firstConfirmedMs - g_connection_status_info.faultMs),
+        (unsigned long)backlog.count, (unsigned long)(lastConfirmedMs - firstConfirmedMs),
+        (lastConfirmedMs > firstConfirmedMs ? (backlog.count * 1000.0) / (lastConfirmedMs - firstConfirmedMs) : 0.0),
+        (unsigned long)duplicates, (unsigned long)lost);
+
+    ASSERT_ARE_EQUAL(size_t, 0, lost, "Queued messages did not reach the service");
+
+    // cleanup
+    for (i = 0; i < backlog.count; i++)
+    {
+        destroy_d2c_message_handle((D2C_MESSAGE_HANDLE)backlog.messages[i]);
+    }
+    destroy_d2c_message_handle(d2cMessageFaultInjection);
+    destroy_d2c_message_handle(d2cMessageInitial);
+
+    tickcounter_destroy(g_recovery_tick_counter);
+    g_recovery_tick_counter = NULL;
+}
+
 
 //***********************************************************
 // D2C
@@ -1614,3 +1786,16 @@ void e2e_c2d_svc_fault_ctrl_MQTT_shut_down(IOTHUB_CLIENT_TRANSPORT_PROVIDER prot
 {
     e2e_c2d_with_svc_fault_ctrl(protocol, "ShutDownMqtt", "byebye", "1");
 }
+
+//***********************************************************
+// Recovery benchmark
+//***********************************************************
+void e2e_d2c_svc_fault_ctrl_recovery_benchmark_kill_TCP_connection(IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol, IOTHUB_CLIENT_RETRY_POLICY retryPolicy)
+{
+    e2e_d2c_with_svc_fault_ctrl_recovery_benchmark(protocol, "KillTcp", "boom", "1", retryPolicy);
+}
+
+void e2e_d2c_svc_fault_ctrl_recovery_benchmark_AMQP_kill_connection(IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol, IOTHUB_CLIENT_RETRY_POLICY retryPolicy)
+{
+    e2e_d2c_with_svc_fault_ctrl_recovery_benchmark(protocol, "KillAmqpConnection", "Connection fault", "1", retryPolicy);
+}
@@ -73,6 +73,9 @@ extern void e2e_c2d_svc_fault_ctrl_message_quota_exceeded(IOTHUB_CLIENT_TRANSPOR
 extern void e2e_c2d_svc_fault_ctrl_auth_error(IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol);
 extern void e2e_c2d_svc_fault_ctrl_MQTT_shut_down(IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol);
 
+extern void e2e_d2c_svc_fault_ctrl_recovery_benchmark_kill_TCP_connection(IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol, IOTHUB_CLIENT_RETRY_POLICY retryPolicy);
+extern void e2e_d2c_svc_fault_ctrl_recovery_benchmark_AMQP_kill_connection(IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol, IOTHUB_CLIENT_RETRY_POLICY retryPolicy);
+
 typedef void* D2C_MESSAGE_HANDLE;
 
 extern bool client_wait_for_d2c_confirmation(D2C_MESSAGE_HANDLE d2cMessage, IOTHUB_CLIENT_CONFIRMATION_RESULT expectedClientResult);
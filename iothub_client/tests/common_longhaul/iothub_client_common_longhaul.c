@@ -560,7 +560,7 @@ static unsigned int generate_unique_id(IOTHUB_LONGHAUL_RESOURCES* iotHubLonghaul
 
 typedef int(*RUN_ON_LOOP_ACTION)(const void* context);
 
-static int run_on_loop(RUN_ON_LOOP_ACTION action, size_t iterationDurationInSeconds, size_t totalDurationInSeconds, const void* action_context)
+static int run_on_loop(IOTHUB_CLIENT_STATISTICS_HANDLE stats, RUN_ON_LOOP_ACTION action, size_t iterationDurationInSeconds, size_t totalDurationInSeconds, const void* action_context)
 {
     int result;
     time_t start_time;
@@ -601,6 +601,9 @@ static int run_on_loop(RUN_ON_LOOP_ACTION action, size_t iterationDurationInSeco
             {
                 double wait_time_secs = iterationDurationInSeconds - difftime(current_time, iteration_start_time);
 
+                // A missing sample only leaves a gap in the resource history, it does not fail the run.
+                (void)iothub_client_statistics_add_resource_sample(stats);
+
                 if (wait_time_secs > 0)
                 {
                     ThreadAPI_Sleep((unsigned int)(1000 * wait_time_secs));
@@ -615,6 +618,23 @@ static int run_on_loop(RUN_ON_LOOP_ACTION action, size_t iterationDurationInSeco
 }
 
 
+static void log_resource_summary(IOTHUB_CLIENT_STATISTICS_HANDLE stats_handle)
+{
+    IOTHUB_CLIENT_STATISTICS_RESOURCE_SUMMARY summary;
+
+    if (iothub_client_statistics_get_resource_summary(stats_handle, &summary) != 0)
+    {
+        LogError("Failed gettting resource summary");
+    }
+    else if (summary.samples > 0)
+    {
+        LogInfo("Resources: samples=%lu; rss: first=%lu kb, last=%lu kb, max=%lu kb; open fds: first=%lu, last=%lu, max=%lu; cpu=%f secs",
+            (unsigned long)summary.samples, (unsigned long)summary.first_rss_kb, (unsigned long)summary.last_rss_kb, (unsigned long)summary.max_rss_kb,
+            (unsigned long)summary.first_open_fds, (unsigned long)summary.last_open_fds, (unsigned long)summary.max_open_fds, summary.cpu_secs);
+    }
+}
+
+
 // Public APIs
 
 IOTHUB_ACCOUNT_INFO_HANDLE longhaul_get_account_info(IOTHUB_LONGHAUL_RESOURCES_HANDLE handle)
@@ -1643,7 +1663,7 @@ int longhaul_run_telemetry_tests(IOTHUB_LONGHAUL_RESOURCES_HANDLE handle, size_t
                 int loop_result;
                 IOTHUB_CLIENT_STATISTICS_HANDLE stats_handle;
 
-                loop_result = run_on_loop(send_telemetry, iterationDurationInSeconds, totalDurationInSeconds, iotHubLonghaulRsrcs);
+                loop_result = run_on_loop(iotHubLonghaulRsrcs->iotHubClientStats, send_telemetry, iterationDurationInSeconds, totalDurationInSeconds, iotHubLonghaulRsrcs);
 
                 ThreadAPI_Sleep((unsigned int)iterationDurationInSeconds * 1000 * 10); // Extra time for the last messages.
 
@@ -1666,8 +1686,10 @@ int longhaul_run_telemetry_tests(IOTHUB_LONGHAUL_RESOURCES_HANDLE handle, size_t
                     }
                     else
                     {
-                        LogInfo("Summary: Messages sent=%lu, received=%lu; travel time: min=%f secs, max=%f secs",
-                            (unsigned long)summary.messages_sent, (unsigned long)summary.messages_received, summary.min_travel_time_secs, summary.max_travel_time_secs);
+                        LogInfo("Summary: Messages sent=%lu, received=%lu; travel time: min=%f secs, max=%f secs, p50=%f secs, p99=%f secs, p999=%f secs",
+                            (unsigned long)summary.messages_sent, (unsigned long)summary.messages_received, summary.min_travel_time_secs, summary.max_travel_time_secs,
+                            summary.travel_time_percentiles.p50_secs, summary.travel_time_percentiles.p99_secs, summary.travel_time_percentiles.p999_secs);
+                        log_resource_summary(stats_handle);
 
                         if (summary.messages_sent == 0 || summary.messages_received != summary.messages_sent || summary.max_travel_time_secs > MAX_TELEMETRY_TRAVEL_TIME_SECS)
                         {
@@ -1721,7 +1743,7 @@ int longhaul_run_c2d_tests(IOTHUB_LONGHAUL_RESOURCES_HANDLE handle, size_t itera
             int loop_result;
             IOTHUB_CLIENT_STATISTICS_HANDLE stats_handle;
 
-            loop_result = run_on_loop(send_c2d, iterationDurationInSeconds, totalDurationInSeconds, iotHubLonghaul);
+            loop_result = run_on_loop(iotHubLonghaul->iotHubClientStats, send_c2d, iterationDurationInSeconds, totalDurationInSeconds, iotHubLonghaul);
 
             ThreadAPI_Sleep((unsigned int)iterationDurationInSeconds * 1000 * 10); // Extra time for the last messages.
 
@@ -1744,8 +1766,10 @@ int longhaul_run_c2d_tests(IOTHUB_LONGHAUL_RESOURCES_HANDLE handle, size_t itera
                 }
                 else
                 {
-                    LogInfo("Summary: Messages sent=%lu, received=%lu; travel time: min=%f secs, max=%f secs",
-                        (unsigned long)summary.messages_sent, (unsigned long)summary.messages_received, summary.min_travel_time_secs, summary.max_travel_time_secs);
+                    LogInfo("Summary: Messages sent=%lu, received=%lu; travel time: min=%f secs, max=%f secs, p50=%f secs, p99=%f secs, p999=%f secs",
+                        (unsigned long)summary.messages_sent, (unsigned long)summary.messages_received, summary.min_travel_time_secs, summary.max_travel_time_secs,
+                        summary.travel_time_percentiles.p50_secs, summary.travel_time_percentiles.p99_secs, summary.travel_time_percentiles.p999_secs);
+                    log_resource_summary(stats_handle);
 
                     if (summary.messages_sent == 0 || summary.messages_received != summary.messages_sent || summary.max_travel_time_secs > MAX_C2D_TRAVEL_TIME_SECS)
                     {
@@ -1799,7 +1823,7 @@ int longhaul_run_device_methods_tests(IOTHUB_LONGHAUL_RESOURCES_HANDLE handle, s
             // Wait for the service to ack the device subscription...
             ThreadAPI_Sleep(DEVICE_METHOD_SUB_WAIT_TIME_MS);
 
-            loop_result = run_on_loop(invoke_device_method, iterationDurationInSeconds, totalDurationInSeconds, iotHubLonghaul);
+            loop_result = run_on_loop(iotHubLonghaul->iotHubClientStats, invoke_device_method, iterationDurationInSeconds, totalDurationInSeconds, iotHubLonghaul);
 
             stats_handle = longhaul_get_statistics(iotHubLonghaul);
 
@@ -1820,8 +1844,10 @@ int longhaul_run_device_methods_tests(IOTHUB_LONGHAUL_RESOURCES_HANDLE handle, s
                 }
                 else
                 {
-                    LogInfo("Summary: Methods invoked=%lu, received=%lu; travel time: min=%f secs, max=%f secs",
-                        (unsigned long)summary.methods_invoked, (unsigned long)summary.methods_received, summary.min_travel_time_secs, summary.max_travel_time_secs);
+                    LogInfo("Summary: Methods invoked=%lu, received=%lu; travel time: min=%f secs, max=%f secs, p50=%f secs, p99=%f secs, p999=%f secs",
+                        (unsigned long)summary.methods_invoked, (unsigned long)summary.methods_received, summary.min_travel_time_secs, summary.max_travel_time_secs,
+                        summary.travel_time_percentiles.p50_secs, summary.travel_time_percentiles.p99_secs, summary.travel_time_percentiles.p999_secs);
+                    log_resource_summary(stats_handle);
 
                     if (summary.methods_invoked == 0 || summary.methods_received != summary.methods_invoked || summary.max_travel_time_secs > MAX_DEVICE_METHOD_TRAVEL_TIME_SECS)
                     {
@@ -1940,7 +1966,7 @@ int longhaul_run_twin_desired_properties_tests(IOTHUB_LONGHAUL_RESOURCES_HANDLE
             int loop_result;
             IOTHUB_CLIENT_STATISTICS_HANDLE stats_handle;
 
-            loop_result = run_on_loop(update_device_twin_desired_property, iterationDurationInSeconds, totalDurationInSeconds, iotHubLonghaul);
+            loop_result = run_on_loop(iotHubLonghaul->iotHubClientStats, update_device_twin_desired_property, iterationDurationInSeconds, totalDurationInSeconds, iotHubLonghaul);
 
             stats_handle = longhaul_get_statistics(iotHubLonghaul);
 
@@ -1961,8 +1987,10 @@ int longhaul_run_twin_desired_properties_tests(IOTHUB_LONGHAUL_RESOURCES_HANDLE
                 }
                 else
                 {
-                    LogInfo("Summary: Updates sent=%lu, received=%lu; travel time: min=%f secs, max=%f secs",
-                        (unsigned long)summary.updates_sent, (unsigned long)summary.updates_received, summary.min_travel_time_secs, summary.max_travel_time_secs);
+                    LogInfo("Summary: Updates sent=%lu, received=%lu; travel time: min=%f secs, max=%f secs, p50=%f secs, p99=%f secs, p999=%f secs",
+                        (unsigned long)summary.updates_sent, (unsigned long)summary.updates_received, summary.min_travel_time_secs, summary.max_travel_time_secs,
+                        summary.travel_time_percentiles.p50_secs, summary.travel_time_percentiles.p99_secs, summary.travel_time_percentiles.p999_secs);
+                    log_resource_summary(stats_handle);
 
                     if (summary.updates_sent == 0 || summary.updates_received != summary.updates_sent || summary.max_travel_time_secs > MAX_TWIN_DESIRED_PROP_TRAVEL_TIME_SECS)
                     {
@@ -2013,7 +2041,7 @@ int longhaul_run_twin_reported_properties_tests(IOTHUB_LONGHAUL_RESOURCES_HANDLE
             int loop_result;
             IOTHUB_CLIENT_STATISTICS_HANDLE stats_handle;
 
-            loop_result = run_on_loop(update_device_twin_reported_property, iterationDurationInSeconds, totalDurationInSeconds, iotHubLonghaul);
+            loop_result = run_on_loop(iotHubLonghaul->iotHubClientStats, update_device_twin_reported_property, iterationDurationInSeconds, totalDurationInSeconds, iotHubLonghaul);
 
             // One last check...
             ThreadAPI_Sleep((unsigned int)iterationDurationInSeconds * 1000);
@@ -2038,8 +2066,10 @@ int longhaul_run_twin_reported_properties_tests(IOTHUB_LONGHAUL_RESOURCES_HANDLE
                 }
                 else
                 {
-                    LogInfo("Summary: Updates sent=%lu, received=%lu; travel time: min=%f secs, max=%f secs",
-                        (unsigned long)summary.updates_sent, (unsigned long)summary.updates_received, summary.min_travel_time_secs, summary.max_travel_time_secs);
+                    LogInfo("Summary: Updates sent=%lu, received=%lu; travel time: min=%f secs, max=%f secs, p50=%f secs, p99=%f secs, p999=%f secs",
+                        (unsigned long)summary.updates_sent, (unsigned long)summary.updates_received, summary.min_travel_time_secs, summary.max_travel_time_secs,
+                        summary.travel_time_percentiles.p50_secs, summary.travel_time_percentiles.p99_secs, summary.travel_time_percentiles.p999_secs);
+                    log_resource_summary(stats_handle);
 
                     if (summary.updates_sent == 0 || summary.updates_received != summary.updates_sent || summary.max_travel_time_secs > MAX_TWIN_REPORTED_PROP_TRAVEL_TIME_SECS)
                     {
@@ -3,6 +3,12 @@
 
 #include <stdbool.h>
 #include <limits.h>
+#ifdef __linux__
+#include <stdio.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/resource.h>
+#endif
 #include "iothub_client_statistics.h"
 #include "azure_c_shared_utility/optimize_size.h"
 #include "azure_c_shared_utility/xlogging.h"
@@ -34,8 +40,95 @@ typedef struct IOTHUB_CLIENT_STATISTICS_TAG
     SINGLYLINKEDLIST_HANDLE device_methods;
     SINGLYLINKEDLIST_HANDLE twin_reported_properties;
     SINGLYLINKEDLIST_HANDLE twin_desired_properties;
+    SINGLYLINKEDLIST_HANDLE resource_samples;
 } IOTHUB_CLIENT_STATISTICS;
 
+typedef struct TRAVEL_TIMES_TAG
+{
+    double* values;
+    size_t count;
+    size_t capacity;
+    bool failed;
+} TRAVEL_TIMES;
+
+static void add_travel_time(TRAVEL_TIMES* travel_times, double travel_time)
+{
+    if (travel_times->count == travel_times->capacity && !travel_times->failed)
+    {
+        size_t new_capacity = (travel_times->capacity == 0 ? 64 : travel_times->capacity * 2);
+        double* new_values;
+
+        if ((new_values = (double*)realloc(travel_times->values, new_capacity * sizeof(double))) == NULL)
+        {
+            LogError("Failed growing the travel times to %lu", (unsigned long)new_capacity);
+            travel_times->failed = true;
+        }
+        else
+        {
+            travel_times->values = new_values;
+            travel_times->capacity = new_capacity;
+        }
+    }
+
+    if (!travel_times->failed)
+    {
+        travel_times->values[travel_times->count++] = travel_time;
+    }
+}
+
+static int compare_travel_times(const void* left, const void* right)
+{
+    double left_value = *(const double*)left;
+    double right_value = *(const double*)right;
+
+    return (left_value < right_value) ? -1 : ((left_value > right_value) ? 1 : 0);
+}
+
+// Nearest rank: the smallest travel time that at least percentile% of them do not exceed.
+static double get_sorted_percentile(const double* values, size_t count, double percentile)
+{
+    double exact_rank = (percentile * count) / 100.0;
+    size_t rank = (size_t)exact_rank;
+
+    if ((double)rank < exact_rank)
+    {
+        rank++;
+    }
+
+    return values[(rank == 0 ? 0 : rank - 1)];
+}
+
+// The statistics keep every travel time already, so the percentiles are exact rather than bucketed.
+static int get_travel_time_percentiles(TRAVEL_TIMES* travel_times, IOTHUB_CLIENT_STATISTICS_PERCENTILES* percentiles)
+{
+    int result;
+
+    (void)memset(percentiles, 0, sizeof(IOTHUB_CLIENT_STATISTICS_PERCENTILES));
+
+    if (travel_times->failed)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        if (travel_times->count > 0)
+        {
+            qsort(travel_times->values, travel_times->count, sizeof(double), compare_travel_times);
+
+            percentiles->p50_secs = get_sorted_percentile(travel_times->values, travel_times->count, 50.0);
+            percentiles->p99_secs = get_sorted_percentile(travel_times->values, travel_times->count, 99.0);
+            percentiles->p999_secs = get_sorted_percentile(travel_times->values, travel_times->count, 99.9);
+        }
+
+        result = 0;
+    }
+
+    free(travel_times->values);
+    travel_times->values = NULL;
+
+    return result;
+}
+
 static bool destroy_connection_status_info(const void* item, const void* match_context, bool* continue_processing)
 {
     (void)match_context;
@@ -76,6 +169,14 @@ static bool destroy_twin_reported_property_info(const void* item, const void* ma
     return true;
 }
 
+static bool destroy_resource_sample_info(const void* item, const void* match_context, bool* continue_processing)
+{
+    (void)match_context;
+    free((void*)item);
+    *continue_processing = true;
+    return true;
+}
+
 static bool destroy_twin_desired_property_info(const void* item, const void* match_context, bool* continue_processing)
 {
     (void)match_context;
@@ -144,6 +245,15 @@ void iothub_client_statistics_destroy(IOTHUB_CLIENT_STATISTICS_HANDLE handle)
             singlylinkedlist_destroy(stats->twin_desired_properties);
         }
 
+        if (stats->resource_samples != NULL)
+        {
+            if (singlylinkedlist_remove_if(stats->resource_samples, destroy_resource_sample_info, NULL) != 0)
+            {
+                LogError("Failed releasing resource samples");
+            }
+            singlylinkedlist_destroy(stats->resource_samples);
+        }
+
         free(handle);
     }
 }
@@ -196,6 +306,12 @@ IOTHUB_CLIENT_STATISTICS_HANDLE iothub_client_statistics_create(void)
             iothub_client_statistics_destroy(stats);
             stats = NULL;
         }
+        else if ((stats->resource_samples = singlylinkedlist_create()) == NULL)
+        {
+            LogError("Failed creating list for resource samples");
+            iothub_client_statistics_destroy(stats);
+            stats = NULL;
+        }
     }
 
     return stats;
@@ -586,6 +702,66 @@ static void serialize_device_twin_desired_event(const void* item, const void* ac
     *continue_processing = true;
 }
 
+static void serialize_resource_sample(const void* item, const void* action_context, bool* continue_processing)
+{
+    JSON_Array* resources_array = json_value_get_array((const JSON_Value*)action_context);
+
+    if (resources_array == NULL)
+    {
+        LogError("Failed to retrieve the resource samples json array");
+    }
+    else
+    {
+        RESOURCE_SAMPLE_INFO* info = (RESOURCE_SAMPLE_INFO*)item;
+        JSON_Value* info_json;
+
+        if ((info_json = json_value_init_object()) == NULL)
+        {
+            LogError("Failed creating resource sample json");
+        }
+        else
+        {
+            JSON_Object* info_json_obj;
+
+            if ((info_json_obj = json_value_get_object(info_json)) == NULL)
+            {
+                LogError("Failed getting json object");
+                json_value_free(info_json);
+            }
+            else
+            {
+                if (json_object_set_string(info_json_obj, "time", (info->time == INDEFINITE_TIME ? "undefined" : ctime(&info->time))) != JSONSuccess)
+                {
+                    LogError("Failed serializing resource sample time");
+                    json_value_free(info_json);
+                }
+                else if (json_object_set_number(info_json_obj, "rss kb", (double)info->rss_kb) != JSONSuccess)
+                {
+                    LogError("Failed serializing resource sample rss");
+                    json_value_free(info_json);
+                }
+                else if (json_object_set_number(info_json_obj, "cpu secs", info->cpu_secs) != JSONSuccess)
+                {
+                    LogError("Failed serializing resource sample cpu time");
+                    json_value_free(info_json);
+                }
+                else if (json_object_set_number(info_json_obj, "open fds", (double)info->open_fds) != JSONSuccess)
+                {
+                    LogError("Failed serializing resource sample open fds");
+                    json_value_free(info_json);
+                }
+                else if (json_array_append_value(resources_array, info_json) != 0)
+                {
+                    LogError("Failed appending resource sample json");
+                    json_value_free(info_json);
+                }
+            }
+        }
+    }
+
+    *continue_processing = true;
+}
+
 char* iothub_client_statistics_to_json(IOTHUB_CLIENT_STATISTICS_HANDLE handle)
 {
     char* result;
@@ -622,6 +798,7 @@ char* iothub_client_statistics_to_json(IOTHUB_CLIENT_STATISTICS_HANDLE handle)
                 JSON_Value* methods_array;
                 JSON_Value* twin_desired_array;
                 JSON_Value* twin_reported_array;
+                JSON_Value* resources_array;
 
                 // Connection Status
                 if ((conn_status_array = json_value_init_array()) == NULL)
@@ -707,6 +884,20 @@ char* iothub_client_statistics_to_json(IOTHUB_CLIENT_STATISTICS_HANDLE handle)
                     LogError("Failed adding device twin reported properties events array to json object");
                 }
 
+                // Resources
+                if ((resources_array = json_value_init_array()) == NULL)
+                {
+                    LogError("Failed creating json array for resource samples");
+                }
+                else if (singlylinkedlist_foreach(stats->resource_samples, serialize_resource_sample, resources_array) != 0)
+                {
+                    LogError("Failed adding resource sample to json array");
+                }
+                else if ((json_object_set_value(root_object, "resources", resources_array)) != JSONSuccess)
+                {
+                    LogError("Failed adding resource samples array to json object");
+                }
+
                 if ((result = json_serialize_to_string_pretty(root_value)) == NULL)
                 {
                     LogError("Failed serializing json to string");
@@ -859,6 +1050,7 @@ int iothub_client_statistics_get_telemetry_summary(IOTHUB_CLIENT_STATISTICS_HAND
     {
         IOTHUB_CLIENT_STATISTICS_HANDLE stats = (IOTHUB_CLIENT_STATISTICS*)handle;
         LIST_ITEM_HANDLE list_item;
+        TRAVEL_TIMES travel_times = { NULL, 0, 0, false };
 
         (void)memset(summary, 0, sizeof(IOTHUB_CLIENT_STATISTICS_TELEMETRY_SUMMARY));
         summary->min_travel_time_secs = LONG_MAX;
@@ -875,6 +1067,8 @@ int iothub_client_statistics_get_telemetry_summary(IOTHUB_CLIENT_STATISTICS_HAND
             {
                 double travel_time = difftime(telemetry_info->time_received, telemetry_info->time_sent);
 
+                add_travel_time(&travel_times, travel_time);
+
                 if (travel_time < summary->min_travel_time_secs)
                 {
                     summary->min_travel_time_secs = travel_time;
@@ -891,7 +1085,7 @@ int iothub_client_statistics_get_telemetry_summary(IOTHUB_CLIENT_STATISTICS_HAND
             list_item = singlylinkedlist_get_next_item(list_item);
         }
 
-        result = 0;
+        result = get_travel_time_percentiles(&travel_times, &summary->travel_time_percentiles);
     }
 
     return result;
@@ -994,6 +1188,7 @@ int iothub_client_statistics_get_c2d_summary(IOTHUB_CLIENT_STATISTICS_HANDLE han
     {
         IOTHUB_CLIENT_STATISTICS_HANDLE stats = (IOTHUB_CLIENT_STATISTICS*)handle;
         LIST_ITEM_HANDLE list_item;
+        TRAVEL_TIMES travel_times = { NULL, 0, 0, false };
 
         (void)memset(summary, 0, sizeof(IOTHUB_CLIENT_STATISTICS_C2D_SUMMARY));
         summary->min_travel_time_secs = LONG_MAX;
@@ -1012,6 +1207,8 @@ int iothub_client_statistics_get_c2d_summary(IOTHUB_CLIENT_STATISTICS_HANDLE han
                 {
                     double travel_time = difftime(c2d_msg_info->time_received, c2d_msg_info->time_sent);
 
+                    add_travel_time(&travel_times, travel_time);
+
                     if (travel_time < summary->min_travel_time_secs)
                     {
                         summary->min_travel_time_secs = travel_time;
@@ -1029,7 +1226,7 @@ int iothub_client_statistics_get_c2d_summary(IOTHUB_CLIENT_STATISTICS_HANDLE han
             list_item = singlylinkedlist_get_next_item(list_item);
         }
 
-        result = 0;
+        result = get_travel_time_percentiles(&travel_times, &summary->travel_time_percentiles);
     }
 
     return result;
@@ -1125,6 +1322,7 @@ int iothub_client_statistics_get_device_method_summary(IOTHUB_CLIENT_STATISTICS_
     {
         IOTHUB_CLIENT_STATISTICS_HANDLE stats = (IOTHUB_CLIENT_STATISTICS*)handle;
         LIST_ITEM_HANDLE list_item;
+        TRAVEL_TIMES travel_times = { NULL, 0, 0, false };
 
         (void)memset(summary, 0, sizeof(IOTHUB_CLIENT_STATISTICS_DEVICE_METHOD_SUMMARY));
         summary->min_travel_time_secs = LONG_MAX;
@@ -1143,6 +1341,8 @@ int iothub_client_statistics_get_device_method_summary(IOTHUB_CLIENT_STATISTICS_
                 {
                     double travel_time = difftime(device_method_info->time_received, device_method_info->time_invoked);
 
+                    add_travel_time(&travel_times, travel_time);
+
                     if (travel_time < summary->min_travel_time_secs)
                     {
                         summary->min_travel_time_secs = travel_time;
@@ -1160,7 +1360,7 @@ int iothub_client_statistics_get_device_method_summary(IOTHUB_CLIENT_STATISTICS_
             list_item = singlylinkedlist_get_next_item(list_item);
         }
 
-        result = 0;
+        result = get_travel_time_percentiles(&travel_times, &summary->travel_time_percentiles);
     }
 
     return result;
@@ -1265,6 +1465,7 @@ int iothub_client_statistics_get_device_twin_desired_summary(IOTHUB_CLIENT_STATI
     {
         IOTHUB_CLIENT_STATISTICS_HANDLE stats = (IOTHUB_CLIENT_STATISTICS*)handle;
         LIST_ITEM_HANDLE list_item;
+        TRAVEL_TIMES travel_times = { NULL, 0, 0, false };
 
         (void)memset(summary, 0, sizeof(IOTHUB_CLIENT_STATISTICS_DEVICE_TWIN_SUMMARY));
         summary->min_travel_time_secs = LONG_MAX;
@@ -1283,6 +1484,8 @@ int iothub_client_statistics_get_device_twin_desired_summary(IOTHUB_CLIENT_STATI
                 {
                     double travel_time = difftime(device_twin_info->time_received, device_twin_info->time_updated);
 
+                    add_travel_time(&travel_times, travel_time);
+
                     if (travel_time < summary->min_travel_time_secs)
                     {
                         summary->min_travel_time_secs = travel_time;
@@ -1300,7 +1503,7 @@ int iothub_client_statistics_get_device_twin_desired_summary(IOTHUB_CLIENT_STATI
             list_item = singlylinkedlist_get_next_item(list_item);
         }
 
-        result = 0;
+        result = get_travel_time_percentiles(&travel_times, &summary->travel_time_percentiles);
     }
 
     return result;
@@ -1400,6 +1603,7 @@ int iothub_client_statistics_get_device_twin_reported_summary(IOTHUB_CLIENT_STAT
     {
         IOTHUB_CLIENT_STATISTICS_HANDLE stats = (IOTHUB_CLIENT_STATISTICS*)handle;
         LIST_ITEM_HANDLE list_item;
+        TRAVEL_TIMES travel_times = { NULL, 0, 0, false };
 
         (void)memset(summary, 0, sizeof(IOTHUB_CLIENT_STATISTICS_DEVICE_TWIN_SUMMARY));
         summary->min_travel_time_secs = LONG_MAX;
@@ -1416,6 +1620,8 @@ int iothub_client_statistics_get_device_twin_reported_summary(IOTHUB_CLIENT_STAT
             {
                 double travel_time = difftime(device_twin_info->time_received, device_twin_info->time_sent);
 
+                add_travel_time(&travel_times, travel_time);
+
                 if (travel_time < summary->min_travel_time_secs)
                 {
                     summary->min_travel_time_secs = travel_time;
@@ -1432,8 +1638,180 @@ int iothub_client_statistics_get_device_twin_reported_summary(IOTHUB_CLIENT_STAT
             list_item = singlylinkedlist_get_next_item(list_item);
         }
 
+        result = get_travel_time_percentiles(&travel_times, &summary->travel_time_percentiles);
+    }
+
+    return result;
+}
+
+#ifdef __linux__
+static int get_process_resources(RESOURCE_SAMPLE_INFO* info)
+{
+    int result;
+    FILE* statm;
+    unsigned long total_pages;
+    unsigned long resident_pages;
+
+    if ((statm = fopen("/proc/self/statm", "r")) == NULL)
+    {
+        LogError("Failed opening /proc/self/statm");
+        result = __FAILURE__;
+    }
+    else
+    {
+        if (fscanf(statm, "%lu %lu", &total_pages, &resident_pages) != 2)
+        {
+            LogError("Failed reading /proc/self/statm");
+            result = __FAILURE__;
+        }
+        else
+        {
+            struct rusage usage;
+            DIR* fd_dir;
+
+            info->rss_kb = (size_t)(resident_pages * (unsigned long)sysconf(_SC_PAGESIZE) / 1024);
+
+            if (getrusage(RUSAGE_SELF, &usage) != 0)
+            {
+                LogError("Failed getting the process CPU time");
+                result = __FAILURE__;
+            }
+            else if ((fd_dir = opendir("/proc/self/fd")) == NULL)
+            {
+                LogError("Failed opening /proc/self/fd");
+                result = __FAILURE__;
+            }
+            else
+            {
+                size_t entries = 0;
+
+                info->cpu_secs = (double)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000000.0;
+
+                while (readdir(fd_dir) != NULL)
+                {
+                    entries++;
+                }
+                (void)closedir(fd_dir);
+
+                // ".", ".." and the descriptor of fd_dir itself
+                info->open_fds = (entries > 3 ? entries - 3 : 0);
+                result = 0;
+            }
+        }
+
+        (void)fclose(statm);
+    }
+
+    return result;
+}
+#else
+static int get_process_resources(RESOURCE_SAMPLE_INFO* info)
+{
+    (void)info;
+    LogError("Resource sampling is not supported on this platform");
+    return __FAILURE__;
+}
+#endif
+
+int iothub_client_statistics_add_resource_sample(IOTHUB_CLIENT_STATISTICS_HANDLE handle)
+{
+    int result;
+
+    if (handle == NULL)
+    {
+        LogError("Invalid argument (handle is NULL)");
+        result = __FAILURE__;
+    }
+    else
+    {
+        RESOURCE_SAMPLE_INFO* sample;
+
+        if ((sample = (RESOURCE_SAMPLE_INFO*)malloc(sizeof(RESOURCE_SAMPLE_INFO))) == NULL)
+        {
+            LogError("Failed allocating RESOURCE_SAMPLE_INFO");
+            result = __FAILURE__;
+        }
+        else if (get_process_resources(sample) != 0)
+        {
+            LogError("Failed sampling the process resources");
+            free(sample);
+            result = __FAILURE__;
+        }
+        else
+        {
+            IOTHUB_CLIENT_STATISTICS_HANDLE stats = (IOTHUB_CLIENT_STATISTICS*)handle;
+
+            if ((sample->time = time(NULL)) == INDEFINITE_TIME)
+            {
+                LogError("Failed setting the resource sample time");
+            }
+
+            if (singlylinkedlist_add(stats->resource_samples, sample) == NULL)
+            {
+                LogError("Failed adding RESOURCE_SAMPLE_INFO");
+                free(sample);
+                result = __FAILURE__;
+            }
+            else
+            {
+                result = 0;
+            }
+        }
+    }
+
+    return result;
+}
+
+int iothub_client_statistics_get_resource_summary(IOTHUB_CLIENT_STATISTICS_HANDLE handle, IOTHUB_CLIENT_STATISTICS_RESOURCE_SUMMARY* summary)
+{
+    int result;
+
+    if (handle == NULL || summary == NULL)
+    {
+        LogError("Invalid argument (handle=%p, summary=%p)", handle, summary);
+        result = __FAILURE__;
+    }
+    else
+    {
+        IOTHUB_CLIENT_STATISTICS_HANDLE stats = (IOTHUB_CLIENT_STATISTICS*)handle;
+        LIST_ITEM_HANDLE list_item;
+        double first_cpu_secs = 0;
+
+        (void)memset(summary, 0, sizeof(IOTHUB_CLIENT_STATISTICS_RESOURCE_SUMMARY));
+
+        list_item = singlylinkedlist_get_head_item(stats->resource_samples);
+
+        while (list_item != NULL)
+        {
+            RESOURCE_SAMPLE_INFO* sample = (RESOURCE_SAMPLE_INFO*)singlylinkedlist_item_get_value(list_item);
+
+            if (summary->samples == 0)
+            {
+                summary->first_rss_kb = sample->rss_kb;
+                summary->first_open_fds = sample->open_fds;
+                first_cpu_secs = sample->cpu_secs;
+            }
+
+            if (sample->rss_kb > summary->max_rss_kb)
+            {
+                summary->max_rss_kb = sample->rss_kb;
+            }
+
+            if (sample->open_fds > summary->max_open_fds)
+            {
+                summary->max_open_fds = sample->open_fds;
+            }
+
+            summary->last_rss_kb = sample->rss_kb;
+            summary->last_open_fds = sample->open_fds;
+            summary->cpu_secs = sample->cpu_secs - first_cpu_secs;
+            summary->samples = summary->samples + 1;
+
+            list_item = singlylinkedlist_get_next_item(list_item);
+        }
+
         result = 0;
     }
 
     return result;
-}
\ No newline at end of file
+}
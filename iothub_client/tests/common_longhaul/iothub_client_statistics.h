@@ -40,6 +40,13 @@ DEFINE_ENUM(DEVICE_METHOD_EVENT_TYPE, DEVICE_METHOD_EVENT_TYPE_VALUES)
 DEFINE_ENUM(DEVICE_TWIN_EVENT_TYPE, DEVICE_TWIN_EVENT_TYPE_VALUES)
 
 
+typedef struct IOTHUB_CLIENT_STATISTICS_PERCENTILES_TAG
+{
+    double p50_secs;
+    double p99_secs;
+    double p999_secs;
+} IOTHUB_CLIENT_STATISTICS_PERCENTILES;
+
 typedef struct TELEMETRY_INFO_TAG
 {
     size_t message_id;
@@ -59,6 +66,7 @@ typedef struct IOTHUB_CLIENT_STATISTICS_TELEMETRY_SUMMARY_TAG
     size_t messages_received;
     double min_travel_time_secs;
     double max_travel_time_secs;
+    IOTHUB_CLIENT_STATISTICS_PERCENTILES travel_time_percentiles;
 } IOTHUB_CLIENT_STATISTICS_TELEMETRY_SUMMARY;
 
 typedef struct C2D_MESSAGE_INFO_TAG
@@ -80,6 +88,7 @@ typedef struct IOTHUB_CLIENT_STATISTICS_C2D_SUMMARY_TAG
     size_t messages_received;
     double min_travel_time_secs;
     double max_travel_time_secs;
+    IOTHUB_CLIENT_STATISTICS_PERCENTILES travel_time_percentiles;
 } IOTHUB_CLIENT_STATISTICS_C2D_SUMMARY;
 
 typedef struct DEVICE_METHOD_INFO_TAG
@@ -98,6 +107,7 @@ typedef struct IOTHUB_CLIENT_STATISTICS_DEVICE_METHOD_SUMMARY_TAG
     size_t methods_received;
     double min_travel_time_secs;
     double max_travel_time_secs;
+    IOTHUB_CLIENT_STATISTICS_PERCENTILES travel_time_percentiles;
 } IOTHUB_CLIENT_STATISTICS_DEVICE_METHOD_SUMMARY;
 
 typedef struct DEVICE_TWIN_DESIRED_INFO_TAG
@@ -129,8 +139,29 @@ typedef struct IOTHUB_CLIENT_STATISTICS_DEVICE_TWIN_SUMMARY_TAG
     size_t updates_received;
     double min_travel_time_secs;
     double max_travel_time_secs;
+    IOTHUB_CLIENT_STATISTICS_PERCENTILES travel_time_percentiles;
 } IOTHUB_CLIENT_STATISTICS_DEVICE_TWIN_SUMMARY;
 
+typedef struct RESOURCE_SAMPLE_INFO_TAG
+{
+    time_t time;
+    size_t rss_kb;
+    double cpu_secs;
+    size_t open_fds;
+} RESOURCE_SAMPLE_INFO;
+
+typedef struct IOTHUB_CLIENT_STATISTICS_RESOURCE_SUMMARY_TAG
+{
+    size_t samples;
+    size_t first_rss_kb;
+    size_t last_rss_kb;
+    size_t max_rss_kb;
+    size_t first_open_fds;
+    size_t last_open_fds;
+    size_t max_open_fds;
+    double cpu_secs;        // between the first and the last sample
+} IOTHUB_CLIENT_STATISTICS_RESOURCE_SUMMARY;
+
 typedef struct IOTHUB_CLIENT_STATISTICS_TAG* IOTHUB_CLIENT_STATISTICS_HANDLE;
 
 extern IOTHUB_CLIENT_STATISTICS_HANDLE iothub_client_statistics_create(void);
@@ -159,6 +190,11 @@ extern int iothub_client_statistics_add_device_twin_reported_info(IOTHUB_CLIENT_
 
 extern int iothub_client_statistics_get_device_twin_reported_summary(IOTHUB_CLIENT_STATISTICS_HANDLE handle, IOTHUB_CLIENT_STATISTICS_DEVICE_TWIN_SUMMARY* summary);
 
+// Samples the resident memory, CPU time and open file descriptors of the process (Linux only).
+extern int iothub_client_statistics_add_resource_sample(IOTHUB_CLIENT_STATISTICS_HANDLE handle);
+
+extern int iothub_client_statistics_get_resource_summary(IOTHUB_CLIENT_STATISTICS_HANDLE handle, IOTHUB_CLIENT_STATISTICS_RESOURCE_SUMMARY* summary);
+
 extern void iothub_client_statistics_destroy(IOTHUB_CLIENT_STATISTICS_HANDLE handle);
 
 #endif // IOTHUB_CLIENT_STATISTICS_H
@@ -29,7 +29,11 @@ static void my_gballoc_free(void* ptr)
 #include "azure_c_shared_utility/agenttime.h"
 #include "azure_c_shared_utility/strings.h"
 #include "azure_c_shared_utility/sastoken.h"
+#include "azure_c_shared_utility/base64.h"
+#include "azure_c_shared_utility/buffer_.h"
+#include "azure_c_shared_utility/urlencode.h"
 #include "azure_c_shared_utility/xio.h"
+#include "internal/iothub_client_trust_store.h"
 
 #ifdef USE_PROV_MODULE
 #include "azure_prov_client/internal/iothub_auth_client.h"
@@ -50,6 +54,7 @@ static const char* TEST_KEYNAME_VALUE = "Test_keyname_value";
 static const char* TEST_REG_CERT = "Test_certificate";
 static const char* TEST_REG_PK = "Test_private_key";
 static size_t TEST_EXPIRY_TIME = 1;
+static const unsigned char TEST_DECODED_KEY[] = { 0x01, 0x02, 0x03, 0x04 };
 
 #define TEST_TIME_VALUE                     (time_t)123456
 
@@ -79,6 +84,29 @@ static STRING_HANDLE my_SASToken_CreateString(const char* key, const char* scope
     return (STRING_HANDLE)my_gballoc_malloc(1);
 }
 
+static BUFFER_HANDLE my_Base64_Decoder(const char* source)
+{
+    (void)source;
+    return (BUFFER_HANDLE)my_gballoc_malloc(1);
+}
+
+static void my_BUFFER_delete(BUFFER_HANDLE handle)
+{
+    my_gballoc_free(handle);
+}
+
+static STRING_HANDLE my_Base64_Encode_Bytes(const unsigned char* source, size_t size)
+{
+    (void)source;
+    (void)size;
+    return (STRING_HANDLE)my_gballoc_malloc(1);
+}
+
+static STRING_HANDLE my_URL_Encode(STRING_HANDLE input)
+{
+    (void)input;
+    return (STRING_HANDLE)my_gballoc_malloc(1);
+}
 
 static STRING_HANDLE my_STRING_construct(const char* psz)
 {
@@ -139,6 +167,7 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_AUTHORIZATION_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(time_t, long long);
     REGISTER_UMOCK_ALIAS_TYPE(STRING_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(BUFFER_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(XDA_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_SECURITY_HANDLE, void*);
 
@@ -152,6 +181,16 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_HOOK(SASToken_CreateString, my_SASToken_CreateString);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(SASToken_CreateString, NULL);
 
+    REGISTER_GLOBAL_MOCK_HOOK(Base64_Decoder, my_Base64_Decoder);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Base64_Decoder, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(BUFFER_u_char, (unsigned char*)TEST_DECODED_KEY);
+    REGISTER_GLOBAL_MOCK_RETURN(BUFFER_length, sizeof(TEST_DECODED_KEY));
+    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_delete, my_BUFFER_delete);
+    REGISTER_GLOBAL_MOCK_HOOK(Base64_Encode_Bytes, my_Base64_Encode_Bytes);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Base64_Encode_Bytes, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(URL_Encode, my_URL_Encode);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(URL_Encode, NULL);
+
     REGISTER_GLOBAL_MOCK_RETURN(get_time, TEST_TIME_VALUE);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(get_time, ((time_t)(-1)));
 
@@ -222,13 +261,27 @@ static void setup_IoTHubClient_Auth_Create_mocks(bool device_key, bool module_id
     }
 }
 
-static void setup_IoTHubClient_Auth_Get_ConnString_mocks()
+static void setup_IoTHubClient_Auth_Get_ConnString_mocks(bool key_schedule_set, bool scope_changed)
 {
     STRICT_EXPECTED_CALL(get_time(NULL));
     STRICT_EXPECTED_CALL(get_difftime(IGNORED_NUM_ARG, IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(SASToken_CreateString(IGNORED_PTR_ARG, SCOPE_NAME, IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    if (!key_schedule_set)
+    {
+        STRICT_EXPECTED_CALL(Base64_Decoder(DEVICE_KEY));
+        STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+    }
+    if (scope_changed)
+    {
+        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, SCOPE_NAME));
+        STRICT_EXPECTED_CALL(gballoc_free(NULL));
+    }
+    STRICT_EXPECTED_CALL(Base64_Encode_Bytes(IGNORED_PTR_ARG, 32));
+    STRICT_EXPECTED_CALL(URL_Encode(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
 }
 
@@ -489,12 +542,14 @@ TEST_FUNCTION(IoTHubClient_Auth_Destroy_succeed)
 
 #ifdef USE_PROV_MODULE
     STRICT_EXPECTED_CALL(iothub_device_auth_destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
 #endif
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
 
     //act
     IoTHubClient_Auth_Destroy(handle);
@@ -786,6 +841,7 @@ TEST_FUNCTION(IoTHubClient_Auth_Get_ConnString_device_auth_succeed)
 
     STRICT_EXPECTED_CALL(iothub_device_auth_generate_credentials(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
 
     //act
@@ -799,6 +855,113 @@ TEST_FUNCTION(IoTHubClient_Auth_Get_ConnString_device_auth_succeed)
     free(conn_string);
     IoTHubClient_Auth_Destroy(handle);
 }
+
+/* Tests_SRS_IoTHub_Authorization_41_005: [ For a device auth handle, IoTHubClient_Auth_Get_SasToken shall return a copy of the previous sas token, without calling the HSM, when scope and key_name are the same and the token was signed less than a tenth of the token lifetime ago. ] */
+TEST_FUNCTION(IoTHubClient_Auth_Get_SasToken_device_auth_reuses_recent_token)
+{
+    //arrange
+    IOTHUB_AUTHORIZATION_HANDLE handle = IoTHubClient_Auth_CreateFromDeviceAuth(DEVICE_ID, NULL);
+    char* first_token = IoTHubClient_Auth_Get_SasToken(handle, SCOPE_NAME, TEST_EXPIRY_TIME, NULL);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(get_time(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(get_difftime(IGNORED_NUM_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+    //act
+    char* conn_string = IoTHubClient_Auth_Get_SasToken(handle, SCOPE_NAME, TEST_EXPIRY_TIME, NULL);
+
+    //assert
+    ASSERT_IS_NOT_NULL(conn_string);
+    ASSERT_ARE_EQUAL(char_ptr, first_token, conn_string);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    free(first_token);
+    free(conn_string);
+    IoTHubClient_Auth_Destroy(handle);
+}
+
+/* Tests_SRS_IoTHub_Authorization_41_005: [ For a device auth handle, IoTHubClient_Auth_Get_SasToken shall return a copy of the previous sas token, without calling the HSM, when scope and key_name are the same and the token was signed less than a tenth of the token lifetime ago. ] */
+/* Tests_SRS_IoTHub_Authorization_41_006: [ IoTHubClient_Auth_Get_SasToken shall keep the last sas token signed by the HSM with its scope, key_name and expiry time; failing to keep it shall not fail the call. ] */
+TEST_FUNCTION(IoTHubClient_Auth_Get_SasToken_device_auth_signs_again_once_token_ages)
+{
+    //arrange
+    IOTHUB_AUTHORIZATION_HANDLE handle = IoTHubClient_Auth_CreateFromDeviceAuth(DEVICE_ID, NULL);
+    char* first_token = IoTHubClient_Auth_Get_SasToken(handle, SCOPE_NAME, TEST_EXPIRY_TIME, NULL);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(get_time(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(get_difftime(IGNORED_NUM_ARG, IGNORED_NUM_ARG)).SetReturn(1000);
+    STRICT_EXPECTED_CALL(iothub_device_auth_generate_credentials(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    char* conn_string = IoTHubClient_Auth_Get_SasToken(handle, SCOPE_NAME, TEST_EXPIRY_TIME, NULL);
+
+    //assert
+    ASSERT_IS_NOT_NULL(conn_string);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    free(first_token);
+    free(conn_string);
+    IoTHubClient_Auth_Destroy(handle);
+}
+
+/* Tests_SRS_IoTHub_Authorization_41_005: [ For a device auth handle, IoTHubClient_Auth_Get_SasToken shall return a copy of the previous sas token, without calling the HSM, when scope and key_name are the same and the token was signed less than a tenth of the token lifetime ago. ] */
+TEST_FUNCTION(IoTHubClient_Auth_Get_SasToken_device_auth_other_scope_signs_again)
+{
+    //arrange
+    IOTHUB_AUTHORIZATION_HANDLE handle = IoTHubClient_Auth_CreateFromDeviceAuth(DEVICE_ID, NULL);
+    char* first_token = IoTHubClient_Auth_Get_SasToken(handle, SCOPE_NAME, TEST_EXPIRY_TIME, NULL);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(get_time(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(get_difftime(IGNORED_NUM_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(iothub_device_auth_generate_credentials(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    char* conn_string = IoTHubClient_Auth_Get_SasToken(handle, "other_scope", TEST_EXPIRY_TIME, NULL);
+
+    //assert
+    ASSERT_IS_NOT_NULL(conn_string);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    free(first_token);
+    free(conn_string);
+    IoTHubClient_Auth_Destroy(handle);
+}
+
+/* Tests_SRS_IoTHub_Authorization_41_007: [ IoTHubClient_Auth_Set_SasToken_Expiry shall drop the kept sas token so that the next one is signed with the new lifetime. ] */
+TEST_FUNCTION(IoTHubClient_Auth_Set_SasToken_Expiry_drops_device_auth_token)
+{
+    //arrange
+    IOTHUB_AUTHORIZATION_HANDLE handle = IoTHubClient_Auth_CreateFromDeviceAuth(DEVICE_ID, NULL);
+    char* first_token = IoTHubClient_Auth_Get_SasToken(handle, SCOPE_NAME, TEST_EXPIRY_TIME, NULL);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    int result = IoTHubClient_Auth_Set_SasToken_Expiry(handle, 4800);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    free(first_token);
+    IoTHubClient_Auth_Destroy(handle);
+}
 #endif
 
 TEST_FUNCTION(IoTHubClient_Auth_Get_ConnString_succeed)
@@ -807,13 +970,37 @@ TEST_FUNCTION(IoTHubClient_Auth_Get_ConnString_succeed)
     IOTHUB_AUTHORIZATION_HANDLE handle = IoTHubClient_Auth_Create(DEVICE_KEY, DEVICE_ID, NULL, NULL);
     umock_c_reset_all_calls();
 
-    setup_IoTHubClient_Auth_Get_ConnString_mocks();
+    setup_IoTHubClient_Auth_Get_ConnString_mocks(false, true);
 
     //act
     char* conn_string = IoTHubClient_Auth_Get_SasToken(handle, SCOPE_NAME, TEST_EXPIRY_TIME, NULL);
 
     //assert
     ASSERT_IS_NOT_NULL(conn_string);
+    ASSERT_IS_TRUE(strncmp(conn_string, "SharedAccessSignature sr=Scope_name&sig=Test_string_value&se=", 61) == 0);
+    ASSERT_IS_NULL(strstr(conn_string, "&skn="));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    free(conn_string);
+    IoTHubClient_Auth_Destroy(handle);
+}
+
+/* Tests_SRS_IoTHub_Authorization_41_004: [ The sas token shall be "SharedAccessSignature sr=<scope>&sig=<signature>&se=<expiry time>", followed by "&skn=<key_name>" if key_name is not empty. ] */
+TEST_FUNCTION(IoTHubClient_Auth_Get_ConnString_key_name_succeed)
+{
+    //arrange
+    IOTHUB_AUTHORIZATION_HANDLE handle = IoTHubClient_Auth_Create(DEVICE_KEY, DEVICE_ID, NULL, NULL);
+    umock_c_reset_all_calls();
+
+    setup_IoTHubClient_Auth_Get_ConnString_mocks(false, true);
+
+    //act
+    char* conn_string = IoTHubClient_Auth_Get_SasToken(handle, SCOPE_NAME, TEST_EXPIRY_TIME, TEST_KEYNAME_VALUE);
+
+    //assert
+    ASSERT_IS_NOT_NULL(conn_string);
+    ASSERT_IS_NOT_NULL(strstr(conn_string, "&skn=Test_keyname_value"));
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     //cleanup
@@ -821,6 +1008,64 @@ TEST_FUNCTION(IoTHubClient_Auth_Get_ConnString_succeed)
     IoTHubClient_Auth_Destroy(handle);
 }
 
+/* Tests_SRS_IoTHub_Authorization_41_001: [ IoTHubClient_Auth_Get_SasToken shall decode the device key and compute its HMAC-SHA256 pads only once per handle. ] */
+/* Tests_SRS_IoTHub_Authorization_41_002: [ IoTHubClient_Auth_Get_SasToken shall only hash scope again when it differs from the scope of the previous sas token. ] */
+TEST_FUNCTION(IoTHubClient_Auth_Get_ConnString_reuses_key_schedule_succeed)
+{
+    //arrange
+    IOTHUB_AUTHORIZATION_HANDLE handle = IoTHubClient_Auth_Create(DEVICE_KEY, DEVICE_ID, NULL, NULL);
+    char* first_token = IoTHubClient_Auth_Get_SasToken(handle, SCOPE_NAME, TEST_EXPIRY_TIME, NULL);
+    umock_c_reset_all_calls();
+
+    setup_IoTHubClient_Auth_Get_ConnString_mocks(true, false);
+
+    //act
+    char* conn_string = IoTHubClient_Auth_Get_SasToken(handle, SCOPE_NAME, TEST_EXPIRY_TIME, NULL);
+
+    //assert
+    ASSERT_IS_NOT_NULL(first_token);
+    ASSERT_IS_NOT_NULL(conn_string);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    free(first_token);
+    free(conn_string);
+    IoTHubClient_Auth_Destroy(handle);
+}
+
+/* Tests_SRS_IoTHub_Authorization_41_002: [ IoTHubClient_Auth_Get_SasToken shall only hash scope again when it differs from the scope of the previous sas token. ] */
+TEST_FUNCTION(IoTHubClient_Auth_Get_ConnString_new_scope_succeed)
+{
+    //arrange
+    IOTHUB_AUTHORIZATION_HANDLE handle = IoTHubClient_Auth_Create(DEVICE_KEY, DEVICE_ID, NULL, NULL);
+    char* first_token = IoTHubClient_Auth_Get_SasToken(handle, "other_scope", TEST_EXPIRY_TIME, NULL);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(get_difftime(IGNORED_NUM_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, SCOPE_NAME));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Base64_Encode_Bytes(IGNORED_PTR_ARG, 32));
+    STRICT_EXPECTED_CALL(URL_Encode(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+
+    //act
+    char* conn_string = IoTHubClient_Auth_Get_SasToken(handle, SCOPE_NAME, TEST_EXPIRY_TIME, NULL);
+
+    //assert
+    ASSERT_IS_NOT_NULL(first_token);
+    ASSERT_IS_NOT_NULL(conn_string);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    free(first_token);
+    free(conn_string);
+    IoTHubClient_Auth_Destroy(handle);
+}
+
 TEST_FUNCTION(IoTHubClient_Auth_Get_ModuleId_succeed)
 {
     //arrange
@@ -851,11 +1096,11 @@ TEST_FUNCTION(IoTHubClient_Auth_Get_ConnString_fail)
     int negativeTestsInitResult = umock_c_negative_tests_init();
     ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
 
-    setup_IoTHubClient_Auth_Get_ConnString_mocks();
+    setup_IoTHubClient_Auth_Get_ConnString_mocks(false, true);
 
     umock_c_negative_tests_snapshot();
 
-    size_t calls_cannot_fail[] = { 1, 3, 5 };
+    size_t calls_cannot_fail[] = { 1, 3, 4, 5, 7, 10, 12, 13 };
 
     //act
     size_t count = umock_c_negative_tests_call_count();
@@ -866,6 +1111,10 @@ TEST_FUNCTION(IoTHubClient_Auth_Get_ConnString_fail)
             continue;
         }
 
+        // a fresh handle each time, since a successful key decode would be cached
+        IoTHubClient_Auth_Destroy(handle);
+        handle = IoTHubClient_Auth_Create(DEVICE_KEY, DEVICE_ID, NULL, NULL);
+
         umock_c_negative_tests_reset();
         umock_c_negative_tests_fail_call(index);
 
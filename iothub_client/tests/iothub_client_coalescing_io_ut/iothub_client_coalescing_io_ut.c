@@ -0,0 +1,982 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#endif
+
+void* real_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+void* real_realloc(void* ptr, size_t size)
+{
+    return realloc(ptr, size);
+}
+
+void real_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umock_c_negative_tests.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+#include "umocktypes_bool.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xio.h"
+#include "azure_c_shared_utility/optionhandler.h"
+#include "azure_c_shared_utility/singlylinkedlist.h"
+#undef ENABLE_MOCKS
+
+#include "iothub_client_options.h"
+#include "internal/iothub_client_coalescing_io.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    SINGLYLINKEDLIST_HANDLE real_singlylinkedlist_create(void);
+    void real_singlylinkedlist_destroy(SINGLYLINKEDLIST_HANDLE list);
+    LIST_ITEM_HANDLE real_singlylinkedlist_add(SINGLYLINKEDLIST_HANDLE list, const void* item);
+    int real_singlylinkedlist_remove(SINGLYLINKEDLIST_HANDLE list, LIST_ITEM_HANDLE item_handle);
+    LIST_ITEM_HANDLE real_singlylinkedlist_get_head_item(SINGLYLINKEDLIST_HANDLE list);
+    const void* real_singlylinkedlist_item_get_value(LIST_ITEM_HANDLE item_handle);
+
+#ifdef __cplusplus
+}
+#endif
+
+static TEST_MUTEX_HANDLE g_testByTest;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+
+// Data definitions
+
+#define TEST_UNDERLYING_IO                  (XIO_HANDLE)0x4343
+#define TEST_OPTIONHANDLER_HANDLE           (OPTIONHANDLER_HANDLE)0x4344
+#define TEST_UNDERLYING_OPTIONHANDLER       (OPTIONHANDLER_HANDLE)0x4345
+#define TEST_BYTES_RECEIVED_CONTEXT         (void*)0x4346
+#define TEST_IO_ERROR_CONTEXT               (void*)0x4347
+#define TEST_OPEN_COMPLETE_CONTEXT          (void*)0x4348
+#define TEST_CLOSE_COMPLETE_CONTEXT         (void*)0x4349
+#define TEST_MAX_SENDS                      8
+#define TEST_MAX_SENT_BYTES                 64
+
+static const unsigned char TEST_WRITE_1[] = { 0x30, 0x02 };
+static const unsigned char TEST_WRITE_2[] = { 0x40, 0x02, 0x00, 0x01 };
+
+static ON_IO_OPEN_COMPLETE g_on_underlying_io_open_complete;
+static void* g_on_underlying_io_open_complete_context;
+
+static size_t g_xio_send_call_count;
+static unsigned char g_sent_bytes[TEST_MAX_SENT_BYTES];
+static size_t g_sent_size;
+static ON_SEND_COMPLETE g_on_underlying_send_complete;
+static void* g_on_underlying_send_complete_context;
+static int g_xio_send_result;
+
+static size_t g_send_complete_count;
+static void* g_send_complete_contexts[TEST_MAX_SENDS];
+static IO_SEND_RESULT g_send_complete_results[TEST_MAX_SENDS];
+
+static size_t g_open_complete_count;
+static IO_OPEN_RESULT g_open_complete_result;
+static size_t g_io_error_count;
+
+static void test_on_send_complete(void* context, IO_SEND_RESULT send_result)
+{
+    if (g_send_complete_count < TEST_MAX_SENDS)
+    {
+        g_send_complete_contexts[g_send_complete_count] = context;
+        g_send_complete_results[g_send_complete_count] = send_result;
+    }
+    g_send_complete_count++;
+}
+
+static void test_on_io_open_complete(void* context, IO_OPEN_RESULT open_result)
+{
+    (void)context;
+    g_open_complete_count++;
+    g_open_complete_result = open_result;
+}
+
+static void test_on_bytes_received(void* context, const unsigned char* buffer, size_t size)
+{
+    (void)context;
+    (void)buffer;
+    (void)size;
+}
+
+static void test_on_io_error(void* context)
+{
+    (void)context;
+    g_io_error_count++;
+}
+
+static void test_on_io_close_complete(void* context)
+{
+    (void)context;
+}
+
+static int my_xio_open(XIO_HANDLE xio, ON_IO_OPEN_COMPLETE on_io_open_complete, void* on_io_open_complete_context, ON_BYTES_RECEIVED on_bytes_received, void* on_bytes_received_context, ON_IO_ERROR on_io_error, void* on_io_error_context)
+{
+    (void)xio;
+    (void)on_bytes_received;
+    (void)on_bytes_received_context;
+    (void)on_io_error;
+    (void)on_io_error_context;
+    g_on_underlying_io_open_complete = on_io_open_complete;
+    g_on_underlying_io_open_complete_context = on_io_open_complete_context;
+    return 0;
+}
+
+static int my_xio_send(XIO_HANDLE xio, const void* buffer, size_t size, ON_SEND_COMPLETE on_send_complete, void* callback_context)
+{
+    (void)xio;
+    g_xio_send_call_count++;
+
+    if (g_xio_send_result == 0)
+    {
+        ASSERT_IS_TRUE(size <= TEST_MAX_SENT_BYTES);
+        (void)memcpy(g_sent_bytes, buffer, size);
+        g_sent_size = size;
+        g_on_underlying_send_complete = on_send_complete;
+        g_on_underlying_send_complete_context = callback_context;
+    }
+
+    return g_xio_send_result;
+}
+
+static void reset_test_data(void)
+{
+    g_on_underlying_io_open_complete = NULL;
+    g_on_underlying_io_open_complete_context = NULL;
+    g_xio_send_call_count = 0;
+    memset(g_sent_bytes, 0, sizeof(g_sent_bytes));
+    g_sent_size = 0;
+    g_on_underlying_send_complete = NULL;
+    g_on_underlying_send_complete_context = NULL;
+    g_xio_send_result = 0;
+    g_send_complete_count = 0;
+    memset(g_send_complete_contexts, 0, sizeof(g_send_complete_contexts));
+    memset(g_send_complete_results, 0, sizeof(g_send_complete_results));
+    g_open_complete_count = 0;
+    g_open_complete_result = IO_OPEN_ERROR;
+    g_io_error_count = 0;
+}
+
+static CONCRETE_IO_HANDLE create_coalescing_io(void)
+{
+    COALESCING_IO_CONFIG config;
+    CONCRETE_IO_HANDLE result;
+
+    config.underlying_io = TEST_UNDERLYING_IO;
+    result = coalescing_io_get_interface_description()->concrete_io_create(&config);
+    ASSERT_IS_NOT_NULL(result);
+    umock_c_reset_all_calls();
+
+    return result;
+}
+
+static CONCRETE_IO_HANDLE create_open_coalescing_io(void)
+{
+    CONCRETE_IO_HANDLE result = create_coalescing_io();
+
+    ASSERT_ARE_EQUAL(int, 0, coalescing_io_get_interface_description()->concrete_io_open(result, test_on_io_open_complete, TEST_OPEN_COMPLETE_CONTEXT, test_on_bytes_received, TEST_BYTES_RECEIVED_CONTEXT, test_on_io_error, TEST_IO_ERROR_CONTEXT));
+    g_on_underlying_io_open_complete(g_on_underlying_io_open_complete_context, IO_OPEN_OK);
+    umock_c_reset_all_calls();
+
+    return result;
+}
+
+static void register_global_mock_hooks(void)
+{
+    REGISTER_UMOCK_ALIAS_TYPE(XIO_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(OPTIONHANDLER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(OPTIONHANDLER_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(SINGLYLINKEDLIST_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LIST_ITEM_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_IO_OPEN_COMPLETE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_BYTES_RECEIVED, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_IO_ERROR, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_IO_CLOSE_COMPLETE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_SEND_COMPLETE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(pfCloneOption, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(pfDestroyOption, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(pfSetOption, void*);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, real_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_realloc, real_realloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_realloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, real_free);
+
+    REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_create, real_singlylinkedlist_create);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(singlylinkedlist_create, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_destroy, real_singlylinkedlist_destroy);
+    REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_add, real_singlylinkedlist_add);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(singlylinkedlist_add, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_remove, real_singlylinkedlist_remove);
+    REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_get_head_item, real_singlylinkedlist_get_head_item);
+    REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_item_get_value, real_singlylinkedlist_item_get_value);
+
+    REGISTER_GLOBAL_MOCK_HOOK(xio_open, my_xio_open);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(xio_open, 1);
+    REGISTER_GLOBAL_MOCK_HOOK(xio_send, my_xio_send);
+    REGISTER_GLOBAL_MOCK_RETURN(xio_close, 0);
+    REGISTER_GLOBAL_MOCK_RETURN(xio_setoption, 0);
+    REGISTER_GLOBAL_MOCK_RETURN(xio_retrieveoptions, TEST_UNDERLYING_OPTIONHANDLER);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(xio_retrieveoptions, NULL);
+
+    REGISTER_GLOBAL_MOCK_RETURN(OptionHandler_Create, TEST_OPTIONHANDLER_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(OptionHandler_Create, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(OptionHandler_AddOption, OPTIONHANDLER_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(OptionHandler_AddOption, OPTIONHANDLER_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(OptionHandler_FeedOptions, OPTIONHANDLER_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(OptionHandler_FeedOptions, OPTIONHANDLER_ERROR);
+}
+
+
+BEGIN_TEST_SUITE(iothub_client_coalescing_io_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    int result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_bool_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    register_global_mock_hooks();
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    reset_test_data();
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_001: [ `coalescing_io_get_interface_description` shall return a pointer to an `IO_INTERFACE_DESCRIPTION` holding the functions of the coalescing IO. ]
+TEST_FUNCTION(coalescing_io_get_interface_description_succeeds)
+{
+    // act
+    const IO_INTERFACE_DESCRIPTION* result = coalescing_io_get_interface_description();
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_IS_NOT_NULL(result->concrete_io_retrieveoptions);
+    ASSERT_IS_NOT_NULL(result->concrete_io_create);
+    ASSERT_IS_NOT_NULL(result->concrete_io_destroy);
+    ASSERT_IS_NOT_NULL(result->concrete_io_open);
+    ASSERT_IS_NOT_NULL(result->concrete_io_close);
+    ASSERT_IS_NOT_NULL(result->concrete_io_send);
+    ASSERT_IS_NOT_NULL(result->concrete_io_dowork);
+    ASSERT_IS_NOT_NULL(result->concrete_io_setoption);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_002: [ If `io_create_parameters` is NULL or its `underlying_io` is NULL, `coalescing_io_create` shall fail and return NULL. ]
+TEST_FUNCTION(coalescing_io_create_NULL_parameters_fails)
+{
+    // act
+    CONCRETE_IO_HANDLE result = coalescing_io_get_interface_description()->concrete_io_create(NULL);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_002: [ If `io_create_parameters` is NULL or its `underlying_io` is NULL, `coalescing_io_create` shall fail and return NULL. ]
+TEST_FUNCTION(coalescing_io_create_NULL_underlying_io_fails)
+{
+    // arrange
+    COALESCING_IO_CONFIG config;
+    config.underlying_io = NULL;
+
+    // act
+    CONCRETE_IO_HANDLE result = coalescing_io_get_interface_description()->concrete_io_create(&config);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_003: [ `coalescing_io_create` shall allocate the instance, a list of the frames in flight and a frame buffer of `COALESCING_IO_DEFAULT_MAX_FRAME_SIZE` bytes; if any of them fails it shall free the others and return NULL, leaving `underlying_io` to the caller. ]
+// Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_004: [ On success `coalescing_io_create` shall take ownership of `underlying_io` and return the new instance. ]
+TEST_FUNCTION(coalescing_io_create_succeeds)
+{
+    // arrange
+    COALESCING_IO_CONFIG config;
+    config.underlying_io = TEST_UNDERLYING_IO;
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_create());
+    STRICT_EXPECTED_CALL(gballoc_malloc(COALESCING_IO_DEFAULT_MAX_FRAME_SIZE));
+
+    // act
+    CONCRETE_IO_HANDLE result = coalescing_io_get_interface_description()->concrete_io_create(&config);
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    coalescing_io_get_interface_description()->concrete_io_destroy(result);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_003: [ `coalescing_io_create` shall allocate the instance, a list of the frames in flight and a frame buffer of `COALESCING_IO_DEFAULT_MAX_FRAME_SIZE` bytes; if any of them fails it shall free the others and return NULL, leaving `underlying_io` to the caller. ]
+TEST_FUNCTION(coalescing_io_create_negative_tests)
+{
+    // arrange
+    COALESCING_IO_CONFIG config;
+    size_t i;
+    config.underlying_io = TEST_UNDERLYING_IO;
+
+    ASSERT_ARE_EQUAL(int, 0, umock_c_negative_tests_init());
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_create());
+    STRICT_EXPECTED_CALL(gballoc_malloc(COALESCING_IO_DEFAULT_MAX_FRAME_SIZE));
+    umock_c_negative_tests_snapshot();
+
+    for (i = 0; i < umock_c_negative_tests_call_count(); i++)
+    {
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(i);
+
+        // act
+        CONCRETE_IO_HANDLE result = coalescing_io_get_interface_description()->concrete_io_create(&config);
+
+        // assert
+        ASSERT_IS_NULL(result, "On failed call %lu", (unsigned long)i);
+    }
+
+    // cleanup
+    umock_c_negative_tests_deinit();
+}
+
+// Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_005: [ If `coalescing_io_handle` is NULL, `coalescing_io_destroy` shall do nothing. ]
+TEST_FUNCTION(coalescing_io_destroy_NULL_handle_does_nothing)
+{
+    // act
+    coalescing_io_get_interface_description()->concrete_io_destroy(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_006: [ `coalescing_io_destroy` shall call the `on_send_complete` of the writes not sent yet with `IO_SEND_CANCELLED`, destroy the underlying IO with `xio_destroy`, call the `on_send_complete` of the writes of the frames it did not complete with `IO_SEND_CANCELLED` and free the instance. ]
+TEST_FUNCTION(coalescing_io_destroy_cancels_the_writes)
+{
+    // arrange
+    CONCRETE_IO_HANDLE handle = create_open_coalescing_io();
+    ASSERT_ARE_EQUAL(int, 0, coalescing_io_get_interface_description()->concrete_io_send(handle, TEST_WRITE_1, sizeof(TEST_WRITE_1), test_on_send_complete, (void*)1));
+    coalescing_io_get_interface_description()->concrete_io_dowork(handle);
+    ASSERT_ARE_EQUAL(int, 0, coalescing_io_get_interface_description()->concrete_io_send(handle, TEST_WRITE_2, sizeof(TEST_WRITE_2), test_on_send_complete, (void*)2));
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(xio_destroy(TEST_UNDERLYING_IO));
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    coalescing_io_get_interface_description()->concrete_io_destroy(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 2, g_send_complete_count);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)2, g_send_complete_contexts[0]);
+    ASSERT_ARE_EQUAL(int, IO_SEND_CANCELLED, g_send_complete_results[0]);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)1, g_send_complete_contexts[1]);
+    ASSERT_ARE_EQUAL(int, IO_SEND_CANCELLED, g_send_complete_results[1]);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_007: [ If `coalescing_io_handle` is NULL, `coalescing_io_open` shall fail and return a non-zero value. ]
+TEST_FUNCTION(coalescing_io_open_NULL_handle_fails)
+{
+    // act
+    int result = coalescing_io_get_interface_description()->concrete_io_open(NULL, test_on_io_open_complete, NULL, test_on_bytes_received, NULL, test_on_io_error, NULL);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_008: [ `coalescing_io_open` shall call `xio_open` on the underlying IO with `on_bytes_received`, `on_io_error` and their contexts, and fail and return a non-zero value if it fails. ]
+TEST_FUNCTION(coalescing_io_open_succeeds)
+{
+    // arrange
+    CONCRETE_IO_HANDLE handle = create_coalescing_io();
+
+    STRICT_EXPECTED_CALL(xio_open(TEST_UNDERLYING_IO, IGNORED_PTR_ARG, handle, test_on_bytes_received, TEST_BYTES_RECEIVED_CONTEXT, test_on_io_error, TEST_IO_ERROR_CONTEXT));
+
+    // act
+    int result = coalescing_io_get_interface_description()->concrete_io_open(handle, test_on_io_open_complete, TEST_OPEN_COMPLETE_CONTEXT, test_on_bytes_received, TEST_BYTES_RECEIVED_CONTEXT, test_on_io_error, TEST_IO_ERROR_CONTEXT);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    coalescing_io_get_interface_description()->concrete_io_destroy(handle);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_008: [ `coalescing_io_open` shall call `xio_open` on the underlying IO with `on_bytes_received`, `on_io_error` and their contexts, and fail and return a non-zero value if it fails. ]
+TEST_FUNCTION(coalescing_io_open_fails_when_xio_open_fails)
+{
+    // arrange
+    CONCRETE_IO_HANDLE handle = create_coalescing_io();
+
+    STRICT_EXPECTED_CALL(xio_open(TEST_UNDERLYING_IO, IGNORED_PTR_ARG, handle, test_on_bytes_received, TEST_BYTES_RECEIVED_CONTEXT, test_on_io_error, TEST_IO_ERROR_CONTEXT))
+        .SetReturn(1);
+
+    // act
+    int result = coalescing_io_get_interface_description()->concrete_io_open(handle, test_on_io_open_complete, TEST_OPEN_COMPLETE_CONTEXT, test_on_bytes_received, TEST_BYTES_RECEIVED_CONTEXT, test_on_io_error, TEST_IO_ERROR_CONTEXT);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    coalescing_io_get_interface_description()->concrete_io_destroy(handle);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_009: [ When the open of the underlying IO completes, the coalescing IO shall be open if `open_result` is `IO_OPEN_OK`, and `on_io_open_complete` shall be called with `open_result`. ]
+TEST_FUNCTION(coalescing_io_open_complete_error_leaves_the_io_closed)
+{
+    // arrange
+    CONCRETE_IO_HANDLE handle = create_coalescing_io();
+    ASSERT_ARE_EQUAL(int, 0, coalescing_io_get_interface_description()->concrete_io_open(handle, test_on_io_open_complete, TEST_OPEN_COMPLETE_CONTEXT, test_on_bytes_received, TEST_BYTES_RECEIVED_CONTEXT, test_on_io_error, TEST_IO_ERROR_CONTEXT));
+
+    // act
+    g_on_underlying_io_open_complete(g_on_underlying_io_open_complete_context, IO_OPEN_ERROR);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, g_open_complete_count);
+    ASSERT_ARE_EQUAL(int, IO_OPEN_ERROR, g_open_complete_result);
+    ASSERT_ARE_NOT_EQUAL(int, 0, coalescing_io_get_interface_description()->concrete_io_send(handle, TEST_WRITE_1, sizeof(TEST_WRITE_1), test_on_send_complete, NULL));
+
+    // cleanup
+    coalescing_io_get_interface_description()->concrete_io_destroy(handle);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_010: [ If `coalescing_io_handle` is NULL, `coalescing_io_close` shall fail and return a non-zero value. ]
+TEST_FUNCTION(coalescing_io_close_NULL_handle_fails)
+{
+    // act
+    int result = coalescing_io_get_interface_description()->concrete_io_close(NULL, test_on_io_close_complete, NULL);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_011: [ `coalescing_io_close` shall send the writes buffered, so that the last ones (an MQTT DISCONNECT, an AMQP close) go out, stop being open and return the result of `xio_close` on the underlying IO with `on_io_close_complete` and `callback_context`. ]
+TEST_FUNCTION(coalescing_io_close_sends_the_buffered_writes)
+{
+    // arrange
+    CONCRETE_IO_HANDLE handle = create_open_coalescing_io();
+    ASSERT_ARE_EQUAL(int, 0, coalescing_io_get_interface_description()->concrete_io_send(handle, TEST_WRITE_1, sizeof(TEST_WRITE_1), test_on_send_complete, NULL));
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(xio_send(TEST_UNDERLYING_IO, IGNORED_PTR_ARG, sizeof(TEST_WRITE_1), IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(xio_close(TEST_UNDERLYING_IO, test_on_io_close_complete, TEST_CLOSE_COMPLETE_CONTEXT));
+
+    // act
+    int result = coalescing_io_get_interface_description()->concrete_io_close(handle, test_on_io_close_complete, TEST_CLOSE_COMPLETE_CONTEXT);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, coalescing_io_get_interface_description()->concrete_io_send(handle, TEST_WRITE_1, sizeof(TEST_WRITE_1), test_on_send_complete, NULL));
+
+    // cleanup
+    coalescing_io_get_interface_description()->concrete_io_destroy(handle);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_012: [ If `coalescing_io_handle` or `buffer` is NULL or `size` is 0, `coalescing_io_send` shall fail and return a non-zero value. ]
+TEST_FUNCTION(coalescing_io_send_invalid_arguments_fail)
+{
+    // arrange
+    CONCRETE_IO_HANDLE handle = create_open_coalescing_io();
+
+    // act
+    int result_null_handle = coalescing_io_get_interface_description()->concrete_io_send(NULL, TEST_WRITE_1, sizeof(TEST_WRITE_1), test_on_send_complete, NULL);
+    int result_null_buffer = coalescing_io_get_interface_description()->concrete_io_send(handle, NULL, sizeof(TEST_WRITE_1), test_on_send_complete, NULL);
+    int result_0_size = coalescing_io_get_interface_description()->concrete_io_send(handle, TEST_WRITE_1, 0, test_on_send_complete, NULL);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result_null_handle);
+    ASSERT_ARE_NOT_EQUAL(int, 0, result_null_buffer);
+    ASSERT_ARE_NOT_EQUAL(int, 0, result_0_size);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    coalescing_io_get_interface_description()->concrete_io_destroy(handle);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_013: [ If the coalescing IO is not open, `coalescing_io_send` shall fail and return a non-zero value. ]
+TEST_FUNCTION(coalescing_io_send_not_open_fails)
+{
+    // arrange
+    CONCRETE_IO_HANDLE handle = create_coalescing_io();
+
+    // act
+    int result = coalescing_io_get_interface_description()->concrete_io_send(handle, TEST_WRITE_1, sizeof(TEST_WRITE_1), test_on_send_complete, NULL);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    coalescing_io_get_interface_description()->concrete_io_destroy(handle);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_014: [ If the write fits in the frame, `coalescing_io_send` shall copy `buffer` to the frame, keep `on_send_complete` and `callback_context` for when the frame is sent and return 0. ]
+TEST_FUNCTION(coalescing_io_send_buffers_the_write)
+{
+    // arrange
+    CONCRETE_IO_HANDLE handle = create_open_coalescing_io();
+
+    STRICT_EXPECTED_CALL(gballoc_realloc(NULL, IGNORED_NUM_ARG));
+
+    // act
+    int result = coalescing_io_get_interface_description()->concrete_io_send(handle, TEST_WRITE_1, sizeof(TEST_WRITE_1), test_on_send_complete, (void*)1);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 0, g_xio_send_call_count);
+    ASSERT_ARE_EQUAL(size_t, 0, g_send_complete_count);
+
+    // cleanup
+    coalescing_io_get_interface_description()->concrete_io_destroy(handle);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_017: [ If the write cannot be kept, `coalescing_io_send` shall fail and return a non-zero value. ]
+TEST_FUNCTION(coalescing_io_send_fails_when_realloc_fails)
+{
+    // arrange
+    CONCRETE_IO_HANDLE handle = create_open_coalescing_io();
+
+    STRICT_EXPECTED_CALL(gballoc_realloc(NULL, IGNORED_NUM_ARG))
+        .SetReturn(NULL);
+
+    // act
+    int result = coalescing_io_get_interface_description()->concrete_io_send(handle, TEST_WRITE_1, sizeof(TEST_WRITE_1), test_on_send_complete, (void*)1);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 0, g_send_complete_count);
+
+    // cleanup
+    coalescing_io_get_interface_description()->concrete_io_destroy(handle);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_018: [ Sending the frame shall call `xio_send` on the underlying IO with the bytes of all the writes buffered, in the order they were written. ]
+// Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_022: [ `coalescing_io_dowork` shall send the frame, call `xio_dowork` on the underlying IO and send the frame again, so that the writes made from the callbacks of the underlying IO go out in the same DoWork. ]
+TEST_FUNCTION(coalescing_io_dowork_sends_the_writes_in_one_frame)
+{
+    // arrange
+    CONCRETE_IO_HANDLE handle = create_open_coalescing_io();
+    ASSERT_ARE_EQUAL(int, 0, coalescing_io_get_interface_description()->concrete_io_send(handle, TEST_WRITE_1, sizeof(TEST_WRITE_1), test_on_send_complete, (void*)1));
+    ASSERT_ARE_EQUAL(int, 0, coalescing_io_get_interface_description()->concrete_io_send(handle, TEST_WRITE_2, sizeof(TEST_WRITE_2), test_on_send_complete, (void*)2));
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(xio_send(TEST_UNDERLYING_IO, IGNORED_PTR_ARG, sizeof(TEST_WRITE_1) + sizeof(TEST_WRITE_2), IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(xio_dowork(TEST_UNDERLYING_IO));
+
+    // act
+    coalescing_io_get_interface_description()->concrete_io_dowork(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 1, g_xio_send_call_count);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(g_sent_bytes, TEST_WRITE_1, sizeof(TEST_WRITE_1)));
+    ASSERT_ARE_EQUAL(int, 0, memcmp(g_sent_bytes + sizeof(TEST_WRITE_1), TEST_WRITE_2, sizeof(TEST_WRITE_2)));
+    ASSERT_ARE_EQUAL(size_t, 0, g_send_complete_count);
+
+    // cleanup
+    coalescing_io_get_interface_description()->concrete_io_destroy(handle);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_020: [ When the send of a frame completes, the `on_send_complete` of each of its writes shall be called with the send result, in the order they were written. ]
+TEST_FUNCTION(coalescing_io_frame_send_complete_completes_each_write)
+{
+    // arrange
+    CONCRETE_IO_HANDLE handle = create_open_coalescing_io();
+    ASSERT_ARE_EQUAL(int, 0, coalescing_io_get_interface_description()->concrete_io_send(handle, TEST_WRITE_1, sizeof(TEST_WRITE_1), test_on_send_complete, (void*)1));
+    ASSERT_ARE_EQUAL(int, 0, coalescing_io_get_interface_description()->concrete_io_send(handle, TEST_WRITE_2, sizeof(TEST_WRITE_2), test_on_send_complete, (void*)2));
+    coalescing_io_get_interface_description()->concrete_io_dowork(handle);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    g_on_underlying_send_complete(g_on_underlying_send_complete_context, IO_SEND_OK);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 2, g_send_complete_count);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)1, g_send_complete_contexts[0]);
+    ASSERT_ARE_EQUAL(int, IO_SEND_OK, g_send_complete_results[0]);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)2, g_send_complete_contexts[1]);
+    ASSERT_ARE_EQUAL(int, IO_SEND_OK, g_send_complete_results[1]);
+
+    // cleanup
+    coalescing_io_get_interface_description()->concrete_io_destroy(handle);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_015: [ If the write does not fit in the frame, `coalescing_io_send` shall send the frame first, and fail and return a non-zero value if that fails. ]
+TEST_FUNCTION(coalescing_io_send_a_write_that_does_not_fit_sends_the_frame_first)
+{
+    // arrange
+    size_t max_frame_size = sizeof(TEST_WRITE_1) + sizeof(TEST_WRITE_2) - 1;
+    CONCRETE_IO_HANDLE handle = create_open_coalescing_io();
+    ASSERT_ARE_EQUAL(int, 0, coalescing_io_get_interface_description()->concrete_io_setoption(handle, OPTION_WS_COALESCED_FRAME_SIZE, &max_frame_size));
+    ASSERT_ARE_EQUAL(int, 0, coalescing_io_get_interface_description()->concrete_io_send(handle, TEST_WRITE_1, sizeof(TEST_WRITE_1), test_on_send_complete, (void*)1));
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(xio_send(TEST_UNDERLYING_IO, IGNORED_PTR_ARG, sizeof(TEST_WRITE_1), IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_realloc(NULL, IGNORED_NUM_ARG));
+
+    // act
+    int result = coalescing_io_get_interface_description()->concrete_io_send(handle, TEST_WRITE_2, sizeof(TEST_WRITE_2), test_on_send_complete, (void*)2);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, memcmp(g_sent_bytes, TEST_WRITE_1, sizeof(TEST_WRITE_1)));
+
+    // cleanup
+    coalescing_io_get_interface_description()->concrete_io_destroy(handle);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_016: [ A write of at least the maximum frame size shall be sent on its own with `xio_send` on the underlying IO with `on_send_complete` and `callback_context`, and `coalescing_io_send` shall fail and return a non-zero value if it fails. ]
+TEST_FUNCTION(coalescing_io_send_a_write_of_the_maximum_frame_size_is_sent_on_its_own)
+{
+    // arrange
+    size_t max_frame_size = sizeof(TEST_WRITE_2);
+    CONCRETE_IO_HANDLE handle = create_open_coalescing_io();
+    ASSERT_ARE_EQUAL(int, 0, coalescing_io_get_interface_description()->concrete_io_setoption(handle, OPTION_WS_COALESCED_FRAME_SIZE, &max_frame_size));
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(xio_send(TEST_UNDERLYING_IO, IGNORED_PTR_ARG, sizeof(TEST_WRITE_2), test_on_send_complete, (void*)2));
+
+    // act
+    int result = coalescing_io_get_interface_description()->concrete_io_send(handle, TEST_WRITE_2, sizeof(TEST_WRITE_2), test_on_send_complete, (void*)2);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    coalescing_io_get_interface_description()->concrete_io_destroy(handle);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_016: [ A write of at least the maximum frame size shall be sent on its own with `xio_send` on the underlying IO with `on_send_complete` and `callback_context`, and `coalescing_io_send` shall fail and return a non-zero value if it fails. ]
+// Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_025: [ If `optionName` is `OPTION_WS_COALESCED_FRAME_SIZE`, `coalescing_io_setoption` shall send the frame and make the frame buffer `*(size_t*)value` bytes long, freeing it for 0; if `value` is NULL or this fails it shall keep the previous size and return a non-zero value. ]
+TEST_FUNCTION(coalescing_io_send_with_0_frame_size_sends_each_write)
+{
+    // arrange
+    size_t max_frame_size = 0;
+    CONCRETE_IO_HANDLE handle = create_open_coalescing_io();
+    ASSERT_ARE_EQUAL(int, 0, coalescing_io_get_interface_description()->concrete_io_setoption(handle, OPTION_WS_COALESCED_FRAME_SIZE, &max_frame_size));
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(xio_send(TEST_UNDERLYING_IO, IGNORED_PTR_ARG, sizeof(TEST_WRITE_1), test_on_send_complete, (void*)1));
+    STRICT_EXPECTED_CALL(xio_send(TEST_UNDERLYING_IO, IGNORED_PTR_ARG, sizeof(TEST_WRITE_2), test_on_send_complete, (void*)2));
+
+    // act
+    int result1 = coalescing_io_get_interface_description()->concrete_io_send(handle, TEST_WRITE_1, sizeof(TEST_WRITE_1), test_on_send_complete, (void*)1);
+    int result2 = coalescing_io_get_interface_description()->concrete_io_send(handle, TEST_WRITE_2, sizeof(TEST_WRITE_2), test_on_send_complete, (void*)2);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result1);
+    ASSERT_ARE_EQUAL(int, 0, result2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    coalescing_io_get_interface_description()->concrete_io_destroy(handle);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_031: [ `OPTION_TLS_COALESCED_RECORD_SIZE` shall be the same option as `OPTION_WS_COALESCED_FRAME_SIZE`. ]
+TEST_FUNCTION(coalescing_io_send_with_0_tls_record_size_sends_each_write)
+{
+    // arrange
+    size_t max_record_size = 0;
+    CONCRETE_IO_HANDLE handle = create_open_coalescing_io();
+    ASSERT_ARE_EQUAL(int, 0, coalescing_io_get_interface_description()->concrete_io_setoption(handle, OPTION_TLS_COALESCED_RECORD_SIZE, &max_record_size));
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(xio_send(TEST_UNDERLYING_IO, IGNORED_PTR_ARG, sizeof(TEST_WRITE_1), test_on_send_complete, (void*)1));
+
+    // act
+    int result = coalescing_io_get_interface_description()->concrete_io_send(handle, TEST_WRITE_1, sizeof(TEST_WRITE_1), test_on_send_complete, (void*)1);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    coalescing_io_get_interface_description()->concrete_io_destroy(handle);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_019: [ If the frame cannot be sent, the `on_send_complete` of each of its writes shall be called with `IO_SEND_ERROR`. ]
+// Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_023: [ If a frame cannot be sent, `coalescing_io_dowork` shall call the `on_io_error` given to `coalescing_io_open`, since the bytes of the stream that follow it cannot be understood. ]
+TEST_FUNCTION(coalescing_io_dowork_frame_send_failure_fails_the_writes_and_indicates_an_error)
+{
+    // arrange
+    CONCRETE_IO_HANDLE handle = create_open_coalescing_io();
+    ASSERT_ARE_EQUAL(int, 0, coalescing_io_get_interface_description()->concrete_io_send(handle, TEST_WRITE_1, sizeof(TEST_WRITE_1), test_on_send_complete, (void*)1));
+    ASSERT_ARE_EQUAL(int, 0, coalescing_io_get_interface_description()->concrete_io_send(handle, TEST_WRITE_2, sizeof(TEST_WRITE_2), test_on_send_complete, (void*)2));
+    umock_c_reset_all_calls();
+    g_xio_send_result = 1;
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(xio_send(TEST_UNDERLYING_IO, IGNORED_PTR_ARG, sizeof(TEST_WRITE_1) + sizeof(TEST_WRITE_2), IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(xio_dowork(TEST_UNDERLYING_IO));
+
+    // act
+    coalescing_io_get_interface_description()->concrete_io_dowork(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 2, g_send_complete_count);
+    ASSERT_ARE_EQUAL(int, IO_SEND_ERROR, g_send_complete_results[0]);
+    ASSERT_ARE_EQUAL(int, IO_SEND_ERROR, g_send_complete_results[1]);
+    ASSERT_ARE_EQUAL(size_t, 1, g_io_error_count);
+
+    // cleanup
+    coalescing_io_get_interface_description()->concrete_io_destroy(handle);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_021: [ If `coalescing_io_handle` is NULL, `coalescing_io_dowork` shall do nothing. ]
+TEST_FUNCTION(coalescing_io_dowork_NULL_handle_does_nothing)
+{
+    // act
+    coalescing_io_get_interface_description()->concrete_io_dowork(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_024: [ If `coalescing_io_handle` or `optionName` is NULL, `coalescing_io_setoption` shall fail and return a non-zero value. ]
+TEST_FUNCTION(coalescing_io_setoption_invalid_arguments_fail)
+{
+    // arrange
+    size_t max_frame_size = 0;
+    CONCRETE_IO_HANDLE handle = create_coalescing_io();
+
+    // act
+    int result_null_handle = coalescing_io_get_interface_description()->concrete_io_setoption(NULL, OPTION_WS_COALESCED_FRAME_SIZE, &max_frame_size);
+    int result_null_name = coalescing_io_get_interface_description()->concrete_io_setoption(handle, NULL, &max_frame_size);
+    int result_null_value = coalescing_io_get_interface_description()->concrete_io_setoption(handle, OPTION_WS_COALESCED_FRAME_SIZE, NULL);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result_null_handle);
+    ASSERT_ARE_NOT_EQUAL(int, 0, result_null_name);
+    ASSERT_ARE_NOT_EQUAL(int, 0, result_null_value);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    coalescing_io_get_interface_description()->concrete_io_destroy(handle);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_025: [ If `optionName` is `OPTION_WS_COALESCED_FRAME_SIZE`, `coalescing_io_setoption` shall send the frame and make the frame buffer `*(size_t*)value` bytes long, freeing it for 0; if `value` is NULL or this fails it shall keep the previous size and return a non-zero value. ]
+TEST_FUNCTION(coalescing_io_setoption_frame_size_fails_when_realloc_fails)
+{
+    // arrange
+    size_t max_frame_size = 1024;
+    CONCRETE_IO_HANDLE handle = create_coalescing_io();
+
+    STRICT_EXPECTED_CALL(gballoc_realloc(IGNORED_PTR_ARG, max_frame_size))
+        .SetReturn(NULL);
+
+    // act
+    int result = coalescing_io_get_interface_description()->concrete_io_setoption(handle, OPTION_WS_COALESCED_FRAME_SIZE, &max_frame_size);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    coalescing_io_get_interface_description()->concrete_io_destroy(handle);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_026: [ If `optionName` is `coalescing_io_underlying_options`, `coalescing_io_setoption` shall give the options to the underlying IO with `OptionHandler_FeedOptions`, and fail and return a non-zero value if it fails. ]
+TEST_FUNCTION(coalescing_io_setoption_underlying_options_feeds_them_to_the_underlying_io)
+{
+    // arrange
+    CONCRETE_IO_HANDLE handle = create_coalescing_io();
+
+    STRICT_EXPECTED_CALL(OptionHandler_FeedOptions(TEST_UNDERLYING_OPTIONHANDLER, TEST_UNDERLYING_IO));
+
+    // act
+    int result = coalescing_io_get_interface_description()->concrete_io_setoption(handle, "coalescing_io_underlying_options", TEST_UNDERLYING_OPTIONHANDLER);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    coalescing_io_get_interface_description()->concrete_io_destroy(handle);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_027: [ Otherwise `coalescing_io_setoption` shall return the result of `xio_setoption` on the underlying IO with `optionName` and `value`. ]
+TEST_FUNCTION(coalescing_io_setoption_passes_other_options_down)
+{
+    // arrange
+    int value = 1;
+    CONCRETE_IO_HANDLE handle = create_coalescing_io();
+
+    STRICT_EXPECTED_CALL(xio_setoption(TEST_UNDERLYING_IO, "TrustedCerts", &value))
+        .SetReturn(1);
+
+    // act
+    int result = coalescing_io_get_interface_description()->concrete_io_setoption(handle, "TrustedCerts", &value);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 1, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    coalescing_io_get_interface_description()->concrete_io_destroy(handle);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_028: [ If `coalescing_io_handle` is NULL, `coalescing_io_retrieveoptions` shall return NULL. ]
+TEST_FUNCTION(coalescing_io_retrieveoptions_NULL_handle_fails)
+{
+    // act
+    OPTIONHANDLER_HANDLE result = coalescing_io_get_interface_description()->concrete_io_retrieveoptions(NULL);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_029: [ `coalescing_io_retrieveoptions` shall return an `OPTIONHANDLER_HANDLE` holding `OPTION_WS_COALESCED_FRAME_SIZE` and, as `coalescing_io_underlying_options`, the options `xio_retrieveoptions` returns for the underlying IO. ]
+TEST_FUNCTION(coalescing_io_retrieveoptions_succeeds)
+{
+    // arrange
+    CONCRETE_IO_HANDLE handle = create_coalescing_io();
+
+    STRICT_EXPECTED_CALL(OptionHandler_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(OptionHandler_AddOption(TEST_OPTIONHANDLER_HANDLE, OPTION_WS_COALESCED_FRAME_SIZE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(xio_retrieveoptions(TEST_UNDERLYING_IO));
+    STRICT_EXPECTED_CALL(OptionHandler_AddOption(TEST_OPTIONHANDLER_HANDLE, "coalescing_io_underlying_options", TEST_UNDERLYING_OPTIONHANDLER));
+    STRICT_EXPECTED_CALL(OptionHandler_Destroy(TEST_UNDERLYING_OPTIONHANDLER));
+
+    // act
+    OPTIONHANDLER_HANDLE result = coalescing_io_get_interface_description()->concrete_io_retrieveoptions(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(void_ptr, TEST_OPTIONHANDLER_HANDLE, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    coalescing_io_get_interface_description()->concrete_io_destroy(handle);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_COALESCING_IO_41_030: [ If any of this fails, `coalescing_io_retrieveoptions` shall free what it created and return NULL. ]
+TEST_FUNCTION(coalescing_io_retrieveoptions_negative_tests)
+{
+    // arrange
+    CONCRETE_IO_HANDLE handle = create_coalescing_io();
+    size_t i;
+
+    ASSERT_ARE_EQUAL(int, 0, umock_c_negative_tests_init());
+
+    STRICT_EXPECTED_CALL(OptionHandler_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(OptionHandler_AddOption(TEST_OPTIONHANDLER_HANDLE, OPTION_WS_COALESCED_FRAME_SIZE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(xio_retrieveoptions(TEST_UNDERLYING_IO));
+    STRICT_EXPECTED_CALL(OptionHandler_AddOption(TEST_OPTIONHANDLER_HANDLE, "coalescing_io_underlying_options", TEST_UNDERLYING_OPTIONHANDLER));
+    umock_c_negative_tests_snapshot();
+
+    for (i = 0; i < umock_c_negative_tests_call_count(); i++)
+    {
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(i);
+
+        // act
+        OPTIONHANDLER_HANDLE result = coalescing_io_get_interface_description()->concrete_io_retrieveoptions(handle);
+
+        // assert
+        ASSERT_IS_NULL(result, "On failed call %lu", (unsigned long)i);
+    }
+
+    // cleanup
+    umock_c_negative_tests_deinit();
+    coalescing_io_get_interface_description()->concrete_io_destroy(handle);
+}
+
+END_TEST_SUITE(iothub_client_coalescing_io_ut)
@@ -0,0 +1,391 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#endif
+
+void* real_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+void real_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umock_c_negative_tests.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+#include "umocktypes_bool.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/tickcounter.h"
+#undef ENABLE_MOCKS
+
+#include "iothub_client_connect_admission.h"
+#include "internal/iothub_client_connect_admission_private.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+
+// Data definitions
+
+#define TEST_TICK_COUNTER_HANDLE            (TICK_COUNTER_HANDLE)0x4242
+#define TEST_CONNECTS_PER_SECOND            2
+#define TEST_BURST                          3
+
+static tickcounter_ms_t g_current_ms;
+
+static LOCK_HANDLE my_Lock_Init(void)
+{
+    return (LOCK_HANDLE)real_malloc(1);
+}
+
+static LOCK_RESULT my_Lock_Deinit(LOCK_HANDLE handle)
+{
+    real_free(handle);
+    return LOCK_OK;
+}
+
+static int my_tickcounter_get_current_ms(TICK_COUNTER_HANDLE tick_counter, tickcounter_ms_t* current_ms)
+{
+    (void)tick_counter;
+    *current_ms = g_current_ms;
+    return 0;
+}
+
+static void start_test_admission(void)
+{
+    ASSERT_ARE_EQUAL(int, 0, IoTHubClient_ConnectAdmission_Start(TEST_CONNECTS_PER_SECOND, TEST_BURST));
+    umock_c_reset_all_calls();
+}
+
+static void acquire_test_tokens(size_t count)
+{
+    size_t index;
+    for (index = 0; index < count; index++)
+    {
+        ASSERT_IS_TRUE(IoTHubClient_ConnectAdmission_TryAcquire());
+    }
+    umock_c_reset_all_calls();
+}
+
+static void register_global_mock_hooks(void)
+{
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(TICK_COUNTER_HANDLE, void*);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, real_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, real_free);
+
+    REGISTER_GLOBAL_MOCK_HOOK(Lock_Init, my_Lock_Init);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock_Init, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(Lock_Deinit, my_Lock_Deinit);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock, LOCK_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+
+    REGISTER_GLOBAL_MOCK_RETURN(tickcounter_create, TEST_TICK_COUNTER_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(tickcounter_create, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(tickcounter_get_current_ms, my_tickcounter_get_current_ms);
+}
+
+
+BEGIN_TEST_SUITE(iothub_client_connect_admission_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    int result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_bool_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    register_global_mock_hooks();
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    g_current_ms = 0;
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    IoTHubClient_ConnectAdmission_Stop();
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_CONNECT_ADMISSION_41_001: [ If connects_per_second or burst is 0, IoTHubClient_ConnectAdmission_Start shall fail and return a non-zero value. ]
+TEST_FUNCTION(IoTHubClient_ConnectAdmission_Start_0_connects_per_second_fails)
+{
+    // act
+    int result = IoTHubClient_ConnectAdmission_Start(0, TEST_BURST);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_IS_FALSE(g_iothub_client_connect_admission_started);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUB_CLIENT_CONNECT_ADMISSION_41_001: [ If connects_per_second or burst is 0, IoTHubClient_ConnectAdmission_Start shall fail and return a non-zero value. ]
+TEST_FUNCTION(IoTHubClient_ConnectAdmission_Start_0_burst_fails)
+{
+    // act
+    int result = IoTHubClient_ConnectAdmission_Start(TEST_CONNECTS_PER_SECOND, 0);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_IS_FALSE(g_iothub_client_connect_admission_started);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUB_CLIENT_CONNECT_ADMISSION_41_003: [ IoTHubClient_ConnectAdmission_Start shall create a lock and a tick counter; if either fails it shall free the other and return a non-zero value. ]
+// Tests_SRS_IOTHUB_CLIENT_CONNECT_ADMISSION_41_004: [ On success IoTHubClient_ConnectAdmission_Start shall fill the bucket with burst tokens, start admitting the connections and return 0. ]
+TEST_FUNCTION(IoTHubClient_ConnectAdmission_Start_succeeds)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(tickcounter_create());
+
+    // act
+    int result = IoTHubClient_ConnectAdmission_Start(TEST_CONNECTS_PER_SECOND, TEST_BURST);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_IS_TRUE(g_iothub_client_connect_admission_started);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUB_CLIENT_CONNECT_ADMISSION_41_003: [ IoTHubClient_ConnectAdmission_Start shall create a lock and a tick counter; if either fails it shall free the other and return a non-zero value. ]
+TEST_FUNCTION(IoTHubClient_ConnectAdmission_Start_fails_when_a_dependency_fails)
+{
+    // arrange
+    size_t index;
+    ASSERT_ARE_EQUAL(int, 0, umock_c_negative_tests_init());
+
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(tickcounter_create());
+    umock_c_negative_tests_snapshot();
+
+    for (index = 0; index < umock_c_negative_tests_call_count(); index++)
+    {
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(index);
+
+        // act
+        int result = IoTHubClient_ConnectAdmission_Start(TEST_CONNECTS_PER_SECOND, TEST_BURST);
+
+        // assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result, "On failed call %lu", (unsigned long)index);
+        ASSERT_IS_FALSE(g_iothub_client_connect_admission_started);
+    }
+
+    umock_c_negative_tests_deinit();
+
+    // a failed start leaves nothing behind
+    ASSERT_ARE_EQUAL(int, 0, IoTHubClient_ConnectAdmission_Start(TEST_CONNECTS_PER_SECOND, TEST_BURST));
+}
+
+// Tests_SRS_IOTHUB_CLIENT_CONNECT_ADMISSION_41_002: [ If admission control is already started, IoTHubClient_ConnectAdmission_Start shall fail and return a non-zero value. ]
+TEST_FUNCTION(IoTHubClient_ConnectAdmission_Start_twice_fails)
+{
+    // arrange
+    start_test_admission();
+
+    // act
+    int result = IoTHubClient_ConnectAdmission_Start(TEST_CONNECTS_PER_SECOND, TEST_BURST);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_IS_TRUE(g_iothub_client_connect_admission_started);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUB_CLIENT_CONNECT_ADMISSION_41_005: [ IoTHubClient_ConnectAdmission_Stop shall stop admitting the connections and free the lock and the tick counter; it shall do nothing if admission control is not started. ]
+TEST_FUNCTION(IoTHubClient_ConnectAdmission_Stop_frees_the_bucket)
+{
+    // arrange
+    start_test_admission();
+
+    STRICT_EXPECTED_CALL(tickcounter_destroy(TEST_TICK_COUNTER_HANDLE));
+    STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG));
+
+    // act
+    IoTHubClient_ConnectAdmission_Stop();
+
+    // assert
+    ASSERT_IS_FALSE(g_iothub_client_connect_admission_started);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUB_CLIENT_CONNECT_ADMISSION_41_005: [ IoTHubClient_ConnectAdmission_Stop shall stop admitting the connections and free the lock and the tick counter; it shall do nothing if admission control is not started. ]
+TEST_FUNCTION(IoTHubClient_ConnectAdmission_Stop_not_started_does_nothing)
+{
+    // act
+    IoTHubClient_ConnectAdmission_Stop();
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUB_CLIENT_CONNECT_ADMISSION_41_006: [ If admission control is not started, IoTHubClient_ConnectAdmission_TryAcquire shall return true. ]
+TEST_FUNCTION(IoTHubClient_ConnectAdmission_TryAcquire_not_started_admits)
+{
+    // act
+    bool result = IoTHubClient_ConnectAdmission_TryAcquire();
+
+    // assert
+    ASSERT_IS_TRUE(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUB_CLIENT_CONNECT_ADMISSION_41_004: [ On success IoTHubClient_ConnectAdmission_Start shall fill the bucket with burst tokens, start admitting the connections and return 0. ]
+// Tests_SRS_IOTHUB_CLIENT_CONNECT_ADMISSION_41_009: [ If the bucket holds a whole token, IoTHubClient_ConnectAdmission_TryAcquire shall take it and return true; otherwise it shall return false. ]
+TEST_FUNCTION(IoTHubClient_ConnectAdmission_TryAcquire_admits_burst_connections)
+{
+    // arrange
+    start_test_admission();
+
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    // act
+    bool result = IoTHubClient_ConnectAdmission_TryAcquire();
+
+    // assert
+    ASSERT_IS_TRUE(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_TRUE(IoTHubClient_ConnectAdmission_TryAcquire());
+    ASSERT_IS_TRUE(IoTHubClient_ConnectAdmission_TryAcquire());
+    ASSERT_IS_FALSE(IoTHubClient_ConnectAdmission_TryAcquire());
+}
+
+// Tests_SRS_IOTHUB_CLIENT_CONNECT_ADMISSION_41_008: [ IoTHubClient_ConnectAdmission_TryAcquire shall add to the bucket connects_per_second tokens for every second since it was last refilled, without exceeding burst tokens. ]
+TEST_FUNCTION(IoTHubClient_ConnectAdmission_TryAcquire_refills_at_connects_per_second)
+{
+    // arrange
+    start_test_admission();
+    acquire_test_tokens(TEST_BURST);
+
+    // half a token
+    g_current_ms = 250;
+    ASSERT_IS_FALSE(IoTHubClient_ConnectAdmission_TryAcquire());
+
+    // a whole token
+    g_current_ms = 500;
+
+    // act
+    bool result = IoTHubClient_ConnectAdmission_TryAcquire();
+
+    // assert
+    ASSERT_IS_TRUE(result);
+    ASSERT_IS_FALSE(IoTHubClient_ConnectAdmission_TryAcquire());
+}
+
+// Tests_SRS_IOTHUB_CLIENT_CONNECT_ADMISSION_41_008: [ IoTHubClient_ConnectAdmission_TryAcquire shall add to the bucket connects_per_second tokens for every second since it was last refilled, without exceeding burst tokens. ]
+TEST_FUNCTION(IoTHubClient_ConnectAdmission_TryAcquire_refills_up_to_burst)
+{
+    // arrange
+    size_t index;
+    start_test_admission();
+    acquire_test_tokens(TEST_BURST);
+
+    g_current_ms = 60000;
+
+    // act
+    for (index = 0; index < TEST_BURST; index++)
+    {
+        ASSERT_IS_TRUE(IoTHubClient_ConnectAdmission_TryAcquire());
+    }
+    bool result = IoTHubClient_ConnectAdmission_TryAcquire();
+
+    // assert
+    ASSERT_IS_FALSE(result);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_CONNECT_ADMISSION_41_007: [ If the time cannot be got or the lock cannot be taken, IoTHubClient_ConnectAdmission_TryAcquire shall return true, so that no connection waits forever. ]
+TEST_FUNCTION(IoTHubClient_ConnectAdmission_TryAcquire_admits_when_the_time_cannot_be_got)
+{
+    // arrange
+    start_test_admission();
+    acquire_test_tokens(TEST_BURST);
+
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG))
+        .SetReturn(1);
+
+    // act
+    bool result = IoTHubClient_ConnectAdmission_TryAcquire();
+
+    // assert
+    ASSERT_IS_TRUE(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUB_CLIENT_CONNECT_ADMISSION_41_007: [ If the time cannot be got or the lock cannot be taken, IoTHubClient_ConnectAdmission_TryAcquire shall return true, so that no connection waits forever. ]
+TEST_FUNCTION(IoTHubClient_ConnectAdmission_TryAcquire_admits_when_Lock_fails)
+{
+    // arrange
+    start_test_admission();
+    acquire_test_tokens(TEST_BURST);
+
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .SetReturn(LOCK_ERROR);
+
+    // act
+    bool result = IoTHubClient_ConnectAdmission_TryAcquire();
+
+    // assert
+    ASSERT_IS_TRUE(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+END_TEST_SUITE(iothub_client_connect_admission_ut)
@@ -0,0 +1,346 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <cstring>
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#endif
+
+#include <zlib.h>
+
+void* real_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+void real_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+#include "umocktypes_bool.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#undef ENABLE_MOCKS
+
+#include "internal/iothub_client_gzip.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+
+// Data definitions
+
+#define TEST_PAYLOAD_SIZE       (256 * 1024)
+#define TEST_INPUT_CHUNK_SIZE   1000
+#define TEST_OUTPUT_CHUNK_SIZE  37 /*small enough that the stream has to be drained over many calls*/
+
+static unsigned char* create_test_payload(void)
+{
+    static const char pattern[] = "{\"temperature\":21.5,\"humidity\":40}";
+    unsigned char* payload = (unsigned char*)real_malloc(TEST_PAYLOAD_SIZE);
+    size_t i;
+
+    ASSERT_IS_NOT_NULL(payload);
+    for (i = 0; i < TEST_PAYLOAD_SIZE; i++)
+    {
+        payload[i] = (unsigned char)pattern[i % (sizeof(pattern) - 1)];
+    }
+
+    return payload;
+}
+
+// checks that compressed is the gzip stream of expected
+static void assert_gunzips_to(const unsigned char* compressed, size_t compressed_size, const unsigned char* expected, size_t expected_size)
+{
+    unsigned char* inflated = (unsigned char*)real_malloc(expected_size + 1);
+    z_stream stream;
+    int inflate_result;
+
+    ASSERT_IS_NOT_NULL(inflated);
+    memset(&stream, 0, sizeof(stream));
+    ASSERT_ARE_EQUAL(int, Z_OK, inflateInit2(&stream, MAX_WBITS + 16));
+
+    stream.next_in = (Bytef*)compressed;
+    stream.avail_in = (uInt)compressed_size;
+    stream.next_out = inflated;
+    stream.avail_out = (uInt)(expected_size + 1);
+    inflate_result = inflate(&stream, Z_FINISH);
+
+    ASSERT_ARE_EQUAL(int, Z_STREAM_END, inflate_result);
+    ASSERT_ARE_EQUAL(size_t, expected_size, (size_t)stream.total_out);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(inflated, expected, expected_size));
+
+    (void)inflateEnd(&stream);
+    real_free(inflated);
+}
+
+static void register_global_mock_hooks(void)
+{
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, real_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, real_free);
+}
+
+
+BEGIN_TEST_SUITE(iothub_client_gzip_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    int result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_bool_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    register_global_mock_hooks();
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+
+// Tests_SRS_GZIP_41_002: [ If any failure occurs, `gzip_stream_create` shall release all memory it allocated and return NULL. ]
+TEST_FUNCTION(gzip_stream_create_malloc_fails)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .SetReturn(NULL);
+
+    // act
+    GZIP_STREAM_HANDLE gzip_stream = gzip_stream_create();
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(gzip_stream);
+}
+
+// Tests_SRS_GZIP_41_001: [ `gzip_stream_create` shall initialize a zlib deflate stream writing a gzip header and trailer, at the default compression level. ]
+// Tests_SRS_GZIP_41_003: [ `gzip_stream_destroy` shall release the zlib stream and the memory of `gzip_stream`. ]
+TEST_FUNCTION(gzip_stream_create_and_destroy_succeed)
+{
+    // act
+    GZIP_STREAM_HANDLE gzip_stream = gzip_stream_create();
+
+    // assert
+    ASSERT_IS_NOT_NULL(gzip_stream);
+
+    // cleanup
+    gzip_stream_destroy(gzip_stream);
+}
+
+// Tests_SRS_GZIP_41_004: [ If `gzip_stream`, `output`, `input_consumed`, `output_written` or `ended` is NULL, or `input` is NULL while `input_size` is not 0, `gzip_stream_compress` shall fail and return a non-zero value. ]
+TEST_FUNCTION(gzip_stream_compress_NULL_gzip_stream_fails)
+{
+    // arrange
+    unsigned char input[1] = { 'a' };
+    unsigned char output[64];
+    size_t consumed;
+    size_t written;
+    bool ended;
+
+    // act
+    int result = gzip_stream_compress(NULL, input, sizeof(input), true, output, sizeof(output), &consumed, &written, &ended);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+}
+
+// Tests_SRS_GZIP_41_004: [ If `gzip_stream`, `output`, `input_consumed`, `output_written` or `ended` is NULL, or `input` is NULL while `input_size` is not 0, `gzip_stream_compress` shall fail and return a non-zero value. ]
+TEST_FUNCTION(gzip_stream_compress_NULL_input_with_size_fails)
+{
+    // arrange
+    unsigned char output[64];
+    size_t consumed;
+    size_t written;
+    bool ended;
+    GZIP_STREAM_HANDLE gzip_stream = gzip_stream_create();
+    ASSERT_IS_NOT_NULL(gzip_stream);
+    umock_c_reset_all_calls();
+
+    // act
+    int result = gzip_stream_compress(gzip_stream, NULL, 1, true, output, sizeof(output), &consumed, &written, &ended);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+    // cleanup
+    gzip_stream_destroy(gzip_stream);
+}
+
+// Tests_SRS_GZIP_41_006: [ `gzip_stream_compress` shall deflate as much of `input` into `output` as fits, and report how many bytes it consumed and wrote. ]
+// Tests_SRS_GZIP_41_007: [ When `last_input` is true `gzip_stream_compress` shall flush the stream and set `ended` to true once the gzip trailer has been written. ]
+TEST_FUNCTION(gzip_stream_compress_in_small_chunks_produces_a_gzip_stream)
+{
+    // arrange
+    unsigned char* payload = create_test_payload();
+    unsigned char* compressed = (unsigned char*)real_malloc(TEST_PAYLOAD_SIZE);
+    size_t payload_position = 0;
+    size_t compressed_size = 0;
+    bool ended = false;
+    GZIP_STREAM_HANDLE gzip_stream = gzip_stream_create();
+    ASSERT_IS_NOT_NULL(compressed);
+    ASSERT_IS_NOT_NULL(gzip_stream);
+
+    // act
+    while (!ended)
+    {
+        size_t input_size = (TEST_PAYLOAD_SIZE - payload_position > TEST_INPUT_CHUNK_SIZE) ? TEST_INPUT_CHUNK_SIZE : TEST_PAYLOAD_SIZE - payload_position;
+        size_t consumed;
+        size_t written;
+
+        ASSERT_IS_TRUE(compressed_size + TEST_OUTPUT_CHUNK_SIZE <= TEST_PAYLOAD_SIZE);
+        ASSERT_ARE_EQUAL(int, 0, gzip_stream_compress(gzip_stream, payload + payload_position, input_size, payload_position + input_size == TEST_PAYLOAD_SIZE,
+            compressed + compressed_size, TEST_OUTPUT_CHUNK_SIZE, &consumed, &written, &ended));
+        ASSERT_IS_TRUE(consumed <= input_size);
+        ASSERT_IS_TRUE(written <= TEST_OUTPUT_CHUNK_SIZE);
+
+        payload_position += consumed;
+        compressed_size += written;
+    }
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, TEST_PAYLOAD_SIZE, payload_position);
+    ASSERT_IS_TRUE(compressed_size < TEST_PAYLOAD_SIZE / 10);
+    assert_gunzips_to(compressed, compressed_size, payload, TEST_PAYLOAD_SIZE);
+
+    // cleanup
+    gzip_stream_destroy(gzip_stream);
+    real_free(compressed);
+    real_free(payload);
+}
+
+// Tests_SRS_GZIP_41_005: [ Once the stream ended, `gzip_stream_compress` shall consume and write nothing, set `ended` to true and return 0. ]
+TEST_FUNCTION(gzip_stream_compress_after_the_end_writes_nothing)
+{
+    // arrange
+    unsigned char input[1] = { 'a' };
+    unsigned char output[64];
+    size_t consumed;
+    size_t written;
+    bool ended = false;
+    GZIP_STREAM_HANDLE gzip_stream = gzip_stream_create();
+    ASSERT_IS_NOT_NULL(gzip_stream);
+    ASSERT_ARE_EQUAL(int, 0, gzip_stream_compress(gzip_stream, input, sizeof(input), true, output, sizeof(output), &consumed, &written, &ended));
+    ASSERT_IS_TRUE(ended);
+    umock_c_reset_all_calls();
+
+    // act
+    ended = false;
+    int result = gzip_stream_compress(gzip_stream, input, sizeof(input), true, output, sizeof(output), &consumed, &written, &ended);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 0, consumed);
+    ASSERT_ARE_EQUAL(size_t, 0, written);
+    ASSERT_IS_TRUE(ended);
+
+    // cleanup
+    gzip_stream_destroy(gzip_stream);
+}
+
+// Tests_SRS_GZIP_41_009: [ If `compressed` or `compressed_size` is NULL, `source` is NULL while `size` is not 0, or `size` does not fit in one zlib call, `gzip_compress_buffer` shall fail and return a non-zero value. ]
+TEST_FUNCTION(gzip_compress_buffer_NULL_compressed_fails)
+{
+    // arrange
+    unsigned char source[1] = { 'a' };
+    size_t compressed_size;
+
+    // act
+    int result = gzip_compress_buffer(source, sizeof(source), NULL, &compressed_size);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+}
+
+// Tests_SRS_GZIP_41_010: [ `gzip_compress_buffer` shall allocate a buffer of the worst case compressed size of `source` and compress `source` into it with a single `gzip_stream_compress` call. ]
+TEST_FUNCTION(gzip_compress_buffer_succeeds)
+{
+    // arrange
+    unsigned char* payload = create_test_payload();
+    unsigned char* compressed = NULL;
+    size_t compressed_size = 0;
+
+    // act
+    int result = gzip_compress_buffer(payload, TEST_PAYLOAD_SIZE, &compressed, &compressed_size);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_IS_NOT_NULL(compressed);
+    assert_gunzips_to(compressed, compressed_size, payload, TEST_PAYLOAD_SIZE);
+
+    // cleanup
+    free(compressed);
+    real_free(payload);
+}
+
+// Tests_SRS_GZIP_41_010: [ `gzip_compress_buffer` shall allocate a buffer of the worst case compressed size of `source` and compress `source` into it with a single `gzip_stream_compress` call. ]
+TEST_FUNCTION(gzip_compress_buffer_empty_source_succeeds)
+{
+    // arrange
+    unsigned char* compressed = NULL;
+    size_t compressed_size = 0;
+
+    // act
+    int result = gzip_compress_buffer(NULL, 0, &compressed, &compressed_size);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_IS_NOT_NULL(compressed);
+    assert_gunzips_to(compressed, compressed_size, (const unsigned char*)"", 0);
+
+    // cleanup
+    free(compressed);
+}
+
+END_TEST_SUITE(iothub_client_gzip_ut)
@@ -0,0 +1,529 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#endif
+
+void* real_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+void real_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umock_c_negative_tests.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/lock.h"
+#undef ENABLE_MOCKS
+
+#include "iothub_client_memory.h"
+#include "internal/iothub_client_memory_private.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+
+// Data definitions
+
+#define TEST_SIZE                           100
+
+static IOTHUB_CLIENT_MEMORY_COUNTERS g_first_counters;
+static IOTHUB_CLIENT_MEMORY_COUNTERS g_second_counters;
+
+static LOCK_HANDLE my_Lock_Init(void)
+{
+    return (LOCK_HANDLE)real_malloc(1);
+}
+
+static LOCK_RESULT my_Lock_Deinit(LOCK_HANDLE handle)
+{
+    real_free(handle);
+    return LOCK_OK;
+}
+
+static void init_test_accounting(void)
+{
+    ASSERT_ARE_EQUAL(int, 0, IoTHubClient_Memory_Init());
+    umock_c_reset_all_calls();
+}
+
+static IOTHUB_CLIENT_MEMORY_USAGE get_test_usage(IOTHUB_CLIENT_MEMORY_TAG tag)
+{
+    IOTHUB_CLIENT_MEMORY_USAGE result;
+    ASSERT_ARE_EQUAL(int, 0, IoTHubClient_Memory_GetUsage(tag, &result));
+    return result;
+}
+
+static void register_global_mock_hooks(void)
+{
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, real_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, real_free);
+
+    REGISTER_GLOBAL_MOCK_HOOK(Lock_Init, my_Lock_Init);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock_Init, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(Lock_Deinit, my_Lock_Deinit);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock, LOCK_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+}
+
+
+BEGIN_TEST_SUITE(iothub_client_memory_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    int result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    register_global_mock_hooks();
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    (void)memset(&g_first_counters, 0, sizeof(g_first_counters));
+    (void)memset(&g_second_counters, 0, sizeof(g_second_counters));
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    IoTHubClient_Memory_Deinit();
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_MEMORY_41_001: [ IoTHubClient_Memory_Init shall create a lock and fail with a non-zero value if it cannot. ]
+TEST_FUNCTION(IoTHubClient_Memory_Init_Lock_Init_fails)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(Lock_Init()).SetReturn(NULL);
+
+    // act
+    int result = IoTHubClient_Memory_Init();
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_IS_FALSE(g_iothub_client_memory_accounting);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUB_CLIENT_MEMORY_41_001: [ IoTHubClient_Memory_Init shall create a lock and fail with a non-zero value if it cannot. ]
+// Tests_SRS_IOTHUB_CLIENT_MEMORY_41_002: [ IoTHubClient_Memory_Init shall start with no counters registered and set `g_iothub_client_memory_accounting`, so that the clients, transports and stores created after it register their counters. ]
+TEST_FUNCTION(IoTHubClient_Memory_Init_starts_with_no_counters)
+{
+    // arrange
+    IOTHUB_CLIENT_MEMORY_USAGE usage;
+    init_test_accounting();
+    IoTHubClient_Memory_Register(&g_first_counters);
+    IOTHUB_CLIENT_MEMORY_ADD(&g_first_counters, IOTHUB_CLIENT_MEMORY_TWIN, TEST_SIZE);
+    IoTHubClient_Memory_Deinit();
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock_Init());
+
+    // act
+    int result = IoTHubClient_Memory_Init();
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_IS_TRUE(g_iothub_client_memory_accounting);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    usage = get_test_usage(IOTHUB_CLIENT_MEMORY_TWIN);
+    ASSERT_ARE_EQUAL(size_t, 0, usage.current_bytes);
+    ASSERT_ARE_EQUAL(size_t, 0, usage.peak_bytes);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_MEMORY_41_003: [ IoTHubClient_Memory_Deinit shall stop registering counters, forget the ones still registered and free the lock; it shall do nothing if counting is not started. ]
+TEST_FUNCTION(IoTHubClient_Memory_Deinit_frees_the_lock)
+{
+    // arrange
+    init_test_accounting();
+    IoTHubClient_Memory_Register(&g_first_counters);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG));
+
+    // act
+    IoTHubClient_Memory_Deinit();
+
+    // assert
+    ASSERT_IS_FALSE(g_iothub_client_memory_accounting);
+    ASSERT_IS_FALSE(g_first_counters.registered);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUB_CLIENT_MEMORY_41_003: [ IoTHubClient_Memory_Deinit shall stop registering counters, forget the ones still registered and free the lock; it shall do nothing if counting is not started. ]
+TEST_FUNCTION(IoTHubClient_Memory_Deinit_not_started_does_nothing)
+{
+    // act
+    IoTHubClient_Memory_Deinit();
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUB_CLIENT_MEMORY_41_004: [ If counters is NULL or already registered, or counting is not started, IoTHubClient_Memory_Register shall do nothing. ]
+// Tests_SRS_IOTHUB_CLIENT_MEMORY_41_010: [ If counters is NULL or not registered, or counting is not started, IoTHubClient_Memory_Unregister shall do nothing. ]
+TEST_FUNCTION(IoTHubClient_Memory_Register_not_started_does_nothing)
+{
+    // act
+    IoTHubClient_Memory_Register(&g_first_counters);
+    IoTHubClient_Memory_Unregister(&g_first_counters);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_FALSE(g_first_counters.registered);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_MEMORY_41_004: [ If counters is NULL or already registered, or counting is not started, IoTHubClient_Memory_Register shall do nothing. ]
+TEST_FUNCTION(IoTHubClient_Memory_Register_NULL_does_nothing)
+{
+    // arrange
+    init_test_accounting();
+
+    // act
+    IoTHubClient_Memory_Register(NULL);
+    IoTHubClient_Memory_Unregister(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUB_CLIENT_MEMORY_41_004: [ If counters is NULL or already registered, or counting is not started, IoTHubClient_Memory_Register shall do nothing. ]
+TEST_FUNCTION(IoTHubClient_Memory_Register_twice_counts_once)
+{
+    // arrange
+    IOTHUB_CLIENT_MEMORY_USAGE usage;
+    init_test_accounting();
+    IoTHubClient_Memory_Register(&g_first_counters);
+    IOTHUB_CLIENT_MEMORY_ADD(&g_first_counters, IOTHUB_CLIENT_MEMORY_TRANSPORT, TEST_SIZE);
+    umock_c_reset_all_calls();
+
+    // act
+    IoTHubClient_Memory_Register(&g_first_counters);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    usage = get_test_usage(IOTHUB_CLIENT_MEMORY_TRANSPORT);
+    ASSERT_ARE_EQUAL(size_t, TEST_SIZE, usage.current_bytes);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_MEMORY_41_005: [ IoTHubClient_Memory_Register shall add counters to the counters summed by IoTHubClient_Memory_GetUsage. ]
+TEST_FUNCTION(IoTHubClient_Memory_Register_succeeds)
+{
+    // arrange
+    init_test_accounting();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    // act
+    IoTHubClient_Memory_Register(&g_first_counters);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_TRUE(g_first_counters.registered);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_MEMORY_41_005: [ IoTHubClient_Memory_Register shall add counters to the counters summed by IoTHubClient_Memory_GetUsage. ]
+TEST_FUNCTION(IoTHubClient_Memory_Register_Lock_fails)
+{
+    // arrange
+    init_test_accounting();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).SetReturn(LOCK_ERROR);
+
+    // act
+    IoTHubClient_Memory_Register(&g_first_counters);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_FALSE(g_first_counters.registered);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_MEMORY_41_006: [ IoTHubClient_Memory_Unregister shall remove counters from the counters summed, so that what its owner held no longer counts. ]
+TEST_FUNCTION(IoTHubClient_Memory_Unregister_drops_what_the_owner_held)
+{
+    // arrange
+    IOTHUB_CLIENT_MEMORY_USAGE usage;
+    init_test_accounting();
+    IoTHubClient_Memory_Register(&g_first_counters);
+    IoTHubClient_Memory_Register(&g_second_counters);
+    IOTHUB_CLIENT_MEMORY_ADD(&g_first_counters, IOTHUB_CLIENT_MEMORY_OPTIONS, TEST_SIZE);
+    IOTHUB_CLIENT_MEMORY_ADD(&g_second_counters, IOTHUB_CLIENT_MEMORY_OPTIONS, 2 * TEST_SIZE);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    // act
+    IoTHubClient_Memory_Unregister(&g_second_counters);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_FALSE(g_second_counters.registered);
+    usage = get_test_usage(IOTHUB_CLIENT_MEMORY_OPTIONS);
+    ASSERT_ARE_EQUAL(size_t, TEST_SIZE, usage.current_bytes);
+    ASSERT_ARE_EQUAL(size_t, TEST_SIZE, usage.peak_bytes);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_MEMORY_41_006: [ IoTHubClient_Memory_Unregister shall remove counters from the counters summed, so that what its owner held no longer counts. ]
+TEST_FUNCTION(IoTHubClient_Memory_Unregister_first_keeps_the_others)
+{
+    // arrange
+    IOTHUB_CLIENT_MEMORY_USAGE usage;
+    init_test_accounting();
+    IoTHubClient_Memory_Register(&g_first_counters);
+    IoTHubClient_Memory_Register(&g_second_counters);
+    IOTHUB_CLIENT_MEMORY_ADD(&g_first_counters, IOTHUB_CLIENT_MEMORY_OPTIONS, TEST_SIZE);
+    IOTHUB_CLIENT_MEMORY_ADD(&g_second_counters, IOTHUB_CLIENT_MEMORY_OPTIONS, 2 * TEST_SIZE);
+
+    // act
+    IoTHubClient_Memory_Unregister(&g_first_counters);
+
+    // assert
+    usage = get_test_usage(IOTHUB_CLIENT_MEMORY_OPTIONS);
+    ASSERT_ARE_EQUAL(size_t, 2 * TEST_SIZE, usage.current_bytes);
+    IoTHubClient_Memory_Unregister(&g_second_counters);
+    usage = get_test_usage(IOTHUB_CLIENT_MEMORY_OPTIONS);
+    ASSERT_ARE_EQUAL(size_t, 0, usage.current_bytes);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_MEMORY_41_010: [ If counters is NULL or not registered, or counting is not started, IoTHubClient_Memory_Unregister shall do nothing. ]
+TEST_FUNCTION(IoTHubClient_Memory_Unregister_not_registered_does_nothing)
+{
+    // arrange
+    IOTHUB_CLIENT_MEMORY_USAGE usage;
+    init_test_accounting();
+    IoTHubClient_Memory_Register(&g_first_counters);
+    IOTHUB_CLIENT_MEMORY_ADD(&g_first_counters, IOTHUB_CLIENT_MEMORY_TWIN, TEST_SIZE);
+    umock_c_reset_all_calls();
+
+    // act
+    IoTHubClient_Memory_Unregister(&g_second_counters);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    usage = get_test_usage(IOTHUB_CLIENT_MEMORY_TWIN);
+    ASSERT_ARE_EQUAL(size_t, TEST_SIZE, usage.current_bytes);
+}
+
+TEST_FUNCTION(IOTHUB_CLIENT_MEMORY_ADD_and_REMOVE_track_current_and_peak)
+{
+    // act
+    IOTHUB_CLIENT_MEMORY_ADD(&g_first_counters, IOTHUB_CLIENT_MEMORY_TRANSPORT, TEST_SIZE);
+    IOTHUB_CLIENT_MEMORY_ADD(&g_first_counters, IOTHUB_CLIENT_MEMORY_TRANSPORT, TEST_SIZE);
+    IOTHUB_CLIENT_MEMORY_REMOVE(&g_first_counters, IOTHUB_CLIENT_MEMORY_TRANSPORT, TEST_SIZE);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, TEST_SIZE, g_first_counters.usage[IOTHUB_CLIENT_MEMORY_TRANSPORT].current_bytes);
+    ASSERT_ARE_EQUAL(size_t, 2 * TEST_SIZE, g_first_counters.usage[IOTHUB_CLIENT_MEMORY_TRANSPORT].peak_bytes);
+    ASSERT_ARE_EQUAL(size_t, 0, g_first_counters.usage[IOTHUB_CLIENT_MEMORY_OPTIONS].current_bytes);
+}
+
+TEST_FUNCTION(IOTHUB_CLIENT_MEMORY_REMOVE_stops_at_0)
+{
+    // arrange
+    IOTHUB_CLIENT_MEMORY_ADD(&g_first_counters, IOTHUB_CLIENT_MEMORY_OPTIONS, TEST_SIZE);
+
+    // act
+    IOTHUB_CLIENT_MEMORY_REMOVE(&g_first_counters, IOTHUB_CLIENT_MEMORY_OPTIONS, 2 * TEST_SIZE);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 0, g_first_counters.usage[IOTHUB_CLIENT_MEMORY_OPTIONS].current_bytes);
+    ASSERT_ARE_EQUAL(size_t, TEST_SIZE, g_first_counters.usage[IOTHUB_CLIENT_MEMORY_OPTIONS].peak_bytes);
+}
+
+TEST_FUNCTION(IOTHUB_CLIENT_MEMORY_REGISTER_not_started_does_nothing)
+{
+    // act
+    IOTHUB_CLIENT_MEMORY_REGISTER(&g_first_counters);
+    IOTHUB_CLIENT_MEMORY_UNREGISTER(&g_first_counters);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_FALSE(g_first_counters.registered);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_MEMORY_41_007: [ If usage is NULL, tag is not a tag or counting is not started, IoTHubClient_Memory_GetUsage shall fail and return a non-zero value. ]
+TEST_FUNCTION(IoTHubClient_Memory_GetUsage_NULL_usage_fails)
+{
+    // arrange
+    init_test_accounting();
+
+    // act
+    int result = IoTHubClient_Memory_GetUsage(IOTHUB_CLIENT_MEMORY_TWIN, NULL);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUB_CLIENT_MEMORY_41_007: [ If usage is NULL, tag is not a tag or counting is not started, IoTHubClient_Memory_GetUsage shall fail and return a non-zero value. ]
+TEST_FUNCTION(IoTHubClient_Memory_GetUsage_invalid_tag_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_MEMORY_USAGE usage;
+    init_test_accounting();
+
+    // act
+    int result = IoTHubClient_Memory_GetUsage((IOTHUB_CLIENT_MEMORY_TAG)(IOTHUB_CLIENT_MEMORY_OPTIONS + 1), &usage);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUB_CLIENT_MEMORY_41_007: [ If usage is NULL, tag is not a tag or counting is not started, IoTHubClient_Memory_GetUsage shall fail and return a non-zero value. ]
+TEST_FUNCTION(IoTHubClient_Memory_GetUsage_not_started_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_MEMORY_USAGE usage;
+
+    // act
+    int result = IoTHubClient_Memory_GetUsage(IOTHUB_CLIENT_MEMORY_TWIN, &usage);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUB_CLIENT_MEMORY_41_008: [ IoTHubClient_Memory_GetUsage shall set usage to the sum of the current and of the peak bytes of tag of the registered counters and return 0. ]
+TEST_FUNCTION(IoTHubClient_Memory_GetUsage_sums_the_registered_counters)
+{
+    // arrange
+    IOTHUB_CLIENT_MEMORY_USAGE usage;
+    init_test_accounting();
+    IoTHubClient_Memory_Register(&g_first_counters);
+    IoTHubClient_Memory_Register(&g_second_counters);
+    IOTHUB_CLIENT_MEMORY_ADD(&g_first_counters, IOTHUB_CLIENT_MEMORY_MESSAGE_QUEUE, 2 * TEST_SIZE);
+    IOTHUB_CLIENT_MEMORY_REMOVE(&g_first_counters, IOTHUB_CLIENT_MEMORY_MESSAGE_QUEUE, TEST_SIZE);
+    IOTHUB_CLIENT_MEMORY_ADD(&g_second_counters, IOTHUB_CLIENT_MEMORY_MESSAGE_QUEUE, TEST_SIZE);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    // act
+    int result = IoTHubClient_Memory_GetUsage(IOTHUB_CLIENT_MEMORY_MESSAGE_QUEUE, &usage);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 2 * TEST_SIZE, usage.current_bytes);
+    ASSERT_ARE_EQUAL(size_t, 3 * TEST_SIZE, usage.peak_bytes);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_MEMORY_41_008: [ IoTHubClient_Memory_GetUsage shall set usage to the sum of the current and of the peak bytes of tag of the registered counters and return 0. ]
+TEST_FUNCTION(IoTHubClient_Memory_GetUsage_saturates)
+{
+    // arrange
+    IOTHUB_CLIENT_MEMORY_USAGE usage;
+    init_test_accounting();
+    IoTHubClient_Memory_Register(&g_first_counters);
+    IoTHubClient_Memory_Register(&g_second_counters);
+    IOTHUB_CLIENT_MEMORY_ADD(&g_first_counters, IOTHUB_CLIENT_MEMORY_TWIN, SIZE_MAX - TEST_SIZE);
+    IOTHUB_CLIENT_MEMORY_ADD(&g_second_counters, IOTHUB_CLIENT_MEMORY_TWIN, 2 * TEST_SIZE);
+
+    // act
+    usage = get_test_usage(IOTHUB_CLIENT_MEMORY_TWIN);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, SIZE_MAX, usage.current_bytes);
+    ASSERT_ARE_EQUAL(size_t, SIZE_MAX, usage.peak_bytes);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_MEMORY_41_008: [ IoTHubClient_Memory_GetUsage shall set usage to the sum of the current and of the peak bytes of tag of the registered counters and return 0. ]
+TEST_FUNCTION(IoTHubClient_Memory_GetUsage_Lock_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_MEMORY_USAGE usage;
+    init_test_accounting();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).SetReturn(LOCK_ERROR);
+
+    // act
+    int result = IoTHubClient_Memory_GetUsage(IOTHUB_CLIENT_MEMORY_MESSAGE_QUEUE, &usage);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUB_CLIENT_MEMORY_41_009: [ IoTHubClient_Memory_ResetPeaks shall set the peak bytes of every tag of the registered counters to their current bytes. ]
+TEST_FUNCTION(IoTHubClient_Memory_ResetPeaks_brings_peaks_to_current)
+{
+    // arrange
+    IOTHUB_CLIENT_MEMORY_USAGE usage;
+    init_test_accounting();
+    IoTHubClient_Memory_Register(&g_first_counters);
+    IOTHUB_CLIENT_MEMORY_ADD(&g_first_counters, IOTHUB_CLIENT_MEMORY_TWIN, 2 * TEST_SIZE);
+    IOTHUB_CLIENT_MEMORY_REMOVE(&g_first_counters, IOTHUB_CLIENT_MEMORY_TWIN, TEST_SIZE);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    // act
+    IoTHubClient_Memory_ResetPeaks();
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    usage = get_test_usage(IOTHUB_CLIENT_MEMORY_TWIN);
+    ASSERT_ARE_EQUAL(size_t, TEST_SIZE, usage.current_bytes);
+    ASSERT_ARE_EQUAL(size_t, TEST_SIZE, usage.peak_bytes);
+}
+
+END_TEST_SUITE(iothub_client_memory_ut)
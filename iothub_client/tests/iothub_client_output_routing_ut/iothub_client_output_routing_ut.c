@@ -0,0 +1,455 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <cstring>
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#endif
+
+#if defined _MSC_VER
+#pragma warning(disable: 4054) /* MSC incorrectly fires this */
+#endif
+
+void* real_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+void* real_realloc(void* ptr, size_t size)
+{
+    return realloc(ptr, size);
+}
+
+void real_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umock_c_negative_tests.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+#include "umocktypes_bool.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "iothub_message.h"
+#undef ENABLE_MOCKS
+
+#include "internal/iothub_client_output_routing.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+
+// Data definitions
+
+#define TEST_PROPERTY_NAME                  "level"
+#define TEST_OTHER_PROPERTY_NAME            "site"
+#define TEST_ALERTS_OUTPUT                  "alerts"
+#define TEST_ARCHIVE_OUTPUT                 "archive"
+#define TEST_SITE_OUTPUT                    "site"
+
+
+// Fake messages, holding the values of the two test properties
+
+typedef struct TEST_MESSAGE_TAG
+{
+    const char* level;
+    const char* site;
+} TEST_MESSAGE;
+
+static const char* TEST_IoTHubMessage_GetProperty(IOTHUB_MESSAGE_HANDLE handle, const char* key)
+{
+    TEST_MESSAGE* message = (TEST_MESSAGE*)handle;
+    const char* result;
+
+    if (strcmp(key, TEST_PROPERTY_NAME) == 0)
+    {
+        result = message->level;
+    }
+    else if (strcmp(key, TEST_OTHER_PROPERTY_NAME) == 0)
+    {
+        result = message->site;
+    }
+    else
+    {
+        result = NULL;
+    }
+
+    return result;
+}
+
+static size_t evaluate(OUTPUT_ROUTING_HANDLE routing, const char* level, const char* site, const char* const** output_names)
+{
+    TEST_MESSAGE message;
+    message.level = level;
+    message.site = site;
+    return output_routing_evaluate(routing, (IOTHUB_MESSAGE_HANDLE)&message, output_names);
+}
+
+static IOTHUB_CLIENT_OUTPUT_ROUTE get_test_route(const char* property_name, const char* property_value, const char* output_name)
+{
+    IOTHUB_CLIENT_OUTPUT_ROUTE route;
+    route.property_name = property_name;
+    route.property_value = property_value;
+    route.output_name = output_name;
+    route.remove = false;
+    return route;
+}
+
+static void add_route(OUTPUT_ROUTING_HANDLE routing, const char* property_name, const char* property_value, const char* output_name)
+{
+    IOTHUB_CLIENT_OUTPUT_ROUTE route = get_test_route(property_name, property_value, output_name);
+    ASSERT_ARE_EQUAL(int, 0, output_routing_configure(routing, &route));
+}
+
+static void register_global_mock_hooks(void)
+{
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, real_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_realloc, real_realloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_realloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, real_free);
+
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetProperty, TEST_IoTHubMessage_GetProperty);
+}
+
+static void register_umock_alias_types(void)
+{
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_RESULT, int);
+}
+
+
+BEGIN_TEST_SUITE(iothub_client_output_routing_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    int result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_bool_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    register_umock_alias_types();
+    register_global_mock_hooks();
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+
+// Tests_SRS_OUTPUT_ROUTING_41_001: [output_routing_create shall return a new routing without any route, or NULL if it cannot be allocated]
+TEST_FUNCTION(create_malloc_fails)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .SetReturn(NULL);
+
+    // act
+    OUTPUT_ROUTING_HANDLE routing = output_routing_create();
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(routing);
+}
+
+// Tests_SRS_OUTPUT_ROUTING_41_001: [output_routing_create shall return a new routing without any route, or NULL if it cannot be allocated]
+TEST_FUNCTION(create_routes_nothing)
+{
+    // arrange
+    const char* const* output_names;
+    OUTPUT_ROUTING_HANDLE routing = output_routing_create();
+
+    // act
+    size_t result = evaluate(routing, "critical", NULL, &output_names);
+
+    // assert
+    ASSERT_IS_NOT_NULL(routing);
+    ASSERT_ARE_EQUAL(size_t, 0, result);
+
+    // cleanup
+    output_routing_destroy(routing);
+}
+
+// Tests_SRS_OUTPUT_ROUTING_41_003: [If `routing`, `route` or its `output_name` is NULL, or `route` has a `property_value` but no `property_name`, output_routing_configure shall fail and return a non-zero value]
+TEST_FUNCTION(configure_NULL_output_name_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_OUTPUT_ROUTE route = get_test_route(TEST_PROPERTY_NAME, "critical", NULL);
+    OUTPUT_ROUTING_HANDLE routing = output_routing_create();
+    umock_c_reset_all_calls();
+
+    // act
+    int result = output_routing_configure(routing, &route);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+    // cleanup
+    output_routing_destroy(routing);
+}
+
+// Tests_SRS_OUTPUT_ROUTING_41_003: [If `routing`, `route` or its `output_name` is NULL, or `route` has a `property_value` but no `property_name`, output_routing_configure shall fail and return a non-zero value]
+TEST_FUNCTION(configure_value_without_property_name_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_OUTPUT_ROUTE route = get_test_route(NULL, "critical", TEST_ALERTS_OUTPUT);
+    OUTPUT_ROUTING_HANDLE routing = output_routing_create();
+    umock_c_reset_all_calls();
+
+    // act
+    int result = output_routing_configure(routing, &route);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+    // cleanup
+    output_routing_destroy(routing);
+}
+
+// Tests_SRS_OUTPUT_ROUTING_41_005: [Otherwise output_routing_configure shall append the route after the others, unless the routing already holds it, and fail leaving the routes as they were if it cannot be allocated]
+TEST_FUNCTION(configure_malloc_fails_keeps_the_routes)
+{
+    // arrange
+    const char* const* output_names;
+    IOTHUB_CLIENT_OUTPUT_ROUTE route = get_test_route(NULL, NULL, TEST_ARCHIVE_OUTPUT);
+    OUTPUT_ROUTING_HANDLE routing = output_routing_create();
+    add_route(routing, TEST_PROPERTY_NAME, "critical", TEST_ALERTS_OUTPUT);
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(gballoc_realloc(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .SetReturn(NULL);
+
+    // act
+    int result = output_routing_configure(routing, &route);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 1, evaluate(routing, "critical", NULL, &output_names));
+    ASSERT_ARE_EQUAL(char_ptr, TEST_ALERTS_OUTPUT, output_names[0]);
+
+    // cleanup
+    output_routing_destroy(routing);
+}
+
+// Tests_SRS_OUTPUT_ROUTING_41_005: [Otherwise output_routing_configure shall append the route after the others, unless the routing already holds it, and fail leaving the routes as they were if it cannot be allocated]
+TEST_FUNCTION(configure_realloc_fails_keeps_the_routes)
+{
+    // arrange
+    const char* const* output_names;
+    IOTHUB_CLIENT_OUTPUT_ROUTE route = get_test_route(NULL, NULL, TEST_ARCHIVE_OUTPUT);
+    OUTPUT_ROUTING_HANDLE routing = output_routing_create();
+    add_route(routing, TEST_PROPERTY_NAME, "critical", TEST_ALERTS_OUTPUT);
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(gballoc_realloc(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .SetReturn(NULL);
+
+    // act
+    int result = output_routing_configure(routing, &route);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 1, evaluate(routing, "critical", NULL, &output_names));
+    ASSERT_ARE_EQUAL(char_ptr, TEST_ALERTS_OUTPUT, output_names[0]);
+
+    // cleanup
+    output_routing_destroy(routing);
+}
+
+// Tests_SRS_OUTPUT_ROUTING_41_005: [Otherwise output_routing_configure shall append the route after the others, unless the routing already holds it, and fail leaving the routes as they were if it cannot be allocated]
+TEST_FUNCTION(configure_the_same_route_twice_adds_it_once)
+{
+    // arrange
+    IOTHUB_CLIENT_OUTPUT_ROUTE route = get_test_route(TEST_PROPERTY_NAME, "critical", TEST_ALERTS_OUTPUT);
+    OUTPUT_ROUTING_HANDLE routing = output_routing_create();
+    add_route(routing, TEST_PROPERTY_NAME, "critical", TEST_ALERTS_OUTPUT);
+    umock_c_reset_all_calls();
+
+    // act
+    int result = output_routing_configure(routing, &route);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    // cleanup
+    output_routing_destroy(routing);
+}
+
+// Tests_SRS_OUTPUT_ROUTING_41_004: [If `remove` is true, output_routing_configure shall remove the route holding the same `property_name`, `property_value` and `output_name`, if any, and succeed]
+TEST_FUNCTION(configure_remove_removes_the_route)
+{
+    // arrange
+    const char* const* output_names;
+    IOTHUB_CLIENT_OUTPUT_ROUTE route = get_test_route(TEST_PROPERTY_NAME, "critical", TEST_ALERTS_OUTPUT);
+    OUTPUT_ROUTING_HANDLE routing = output_routing_create();
+    add_route(routing, TEST_PROPERTY_NAME, "critical", TEST_ALERTS_OUTPUT);
+    add_route(routing, NULL, NULL, TEST_ARCHIVE_OUTPUT);
+    route.remove = true;
+
+    // act
+    int result = output_routing_configure(routing, &route);
+    int again = output_routing_configure(routing, &route);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(int, 0, again);
+    ASSERT_ARE_EQUAL(size_t, 1, evaluate(routing, "critical", NULL, &output_names));
+    ASSERT_ARE_EQUAL(char_ptr, TEST_ARCHIVE_OUTPUT, output_names[0]);
+
+    // cleanup
+    output_routing_destroy(routing);
+}
+
+// Tests_SRS_OUTPUT_ROUTING_41_006: [If `routing`, `message` or `output_names` is NULL, output_routing_evaluate shall return 0]
+TEST_FUNCTION(evaluate_NULL_message_returns_0)
+{
+    // arrange
+    const char* const* output_names;
+    OUTPUT_ROUTING_HANDLE routing = output_routing_create();
+    add_route(routing, NULL, NULL, TEST_ARCHIVE_OUTPUT);
+    umock_c_reset_all_calls();
+
+    // act
+    size_t result = output_routing_evaluate(routing, NULL, &output_names);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 0, result);
+
+    // cleanup
+    output_routing_destroy(routing);
+}
+
+// Tests_SRS_OUTPUT_ROUTING_41_007: [A route shall match `message` if it has no `property_name`, or `message` has the application property `property_name` holding `property_value`, or holding any value if `property_value` is NULL]
+TEST_FUNCTION(evaluate_matches_the_property_value)
+{
+    // arrange
+    const char* const* output_names;
+    OUTPUT_ROUTING_HANDLE routing = output_routing_create();
+    add_route(routing, TEST_PROPERTY_NAME, "critical", TEST_ALERTS_OUTPUT);
+
+    // act
+    size_t matching = evaluate(routing, "critical", NULL, &output_names);
+    size_t other_value = evaluate(routing, "info", NULL, &output_names);
+    size_t missing = evaluate(routing, NULL, "plant", &output_names);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, matching);
+    ASSERT_ARE_EQUAL(size_t, 0, other_value);
+    ASSERT_ARE_EQUAL(size_t, 0, missing);
+
+    // cleanup
+    output_routing_destroy(routing);
+}
+
+// Tests_SRS_OUTPUT_ROUTING_41_007: [A route shall match `message` if it has no `property_name`, or `message` has the application property `property_name` holding `property_value`, or holding any value if `property_value` is NULL]
+TEST_FUNCTION(evaluate_matches_any_value_and_every_message)
+{
+    // arrange
+    const char* const* output_names;
+    OUTPUT_ROUTING_HANDLE routing = output_routing_create();
+    add_route(routing, TEST_OTHER_PROPERTY_NAME, NULL, TEST_SITE_OUTPUT);
+    add_route(routing, NULL, NULL, TEST_ARCHIVE_OUTPUT);
+
+    // act
+    size_t with_site = evaluate(routing, NULL, "plant", &output_names);
+    size_t without_site = evaluate(routing, "info", NULL, &output_names);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 2, with_site);
+    ASSERT_ARE_EQUAL(size_t, 1, without_site);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_ARCHIVE_OUTPUT, output_names[0]);
+
+    // cleanup
+    output_routing_destroy(routing);
+}
+
+// Tests_SRS_OUTPUT_ROUTING_41_008: [output_routing_evaluate shall evaluate every route once and set `output_names` to the outputs of the routes that match, each once, in the order of the routes, and return their number]
+TEST_FUNCTION(evaluate_returns_each_output_once_in_the_order_of_the_routes)
+{
+    // arrange
+    const char* const* output_names;
+    OUTPUT_ROUTING_HANDLE routing = output_routing_create();
+    add_route(routing, TEST_PROPERTY_NAME, "critical", TEST_ALERTS_OUTPUT);
+    add_route(routing, NULL, NULL, TEST_ARCHIVE_OUTPUT);
+    add_route(routing, TEST_OTHER_PROPERTY_NAME, "plant", TEST_ALERTS_OUTPUT);
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetProperty(IGNORED_PTR_ARG, TEST_PROPERTY_NAME));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetProperty(IGNORED_PTR_ARG, TEST_OTHER_PROPERTY_NAME));
+
+    // act
+    size_t result = evaluate(routing, "critical", "plant", &output_names);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 2, result);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_ALERTS_OUTPUT, output_names[0]);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_ARCHIVE_OUTPUT, output_names[1]);
+
+    // cleanup
+    output_routing_destroy(routing);
+}
+
+// Tests_SRS_OUTPUT_ROUTING_41_002: [output_routing_destroy shall free all the routes; it shall do nothing if `routing` is NULL]
+TEST_FUNCTION(destroy_NULL)
+{
+    // arrange
+    umock_c_reset_all_calls();
+
+    // act
+    output_routing_destroy(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+END_TEST_SUITE(iothub_client_output_routing_ut)
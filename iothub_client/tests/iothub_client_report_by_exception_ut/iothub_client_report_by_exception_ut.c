@@ -0,0 +1,376 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <cstring>
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#endif
+
+#if defined _MSC_VER
+#pragma warning(disable: 4054) /* MSC incorrectly fires this */
+#endif
+
+void* real_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+void real_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umock_c_negative_tests.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+#include "umocktypes_bool.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "iothub_message.h"
+#undef ENABLE_MOCKS
+
+#include "internal/iothub_client_report_by_exception.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+
+// Data definitions
+
+#define TEST_PROPERTY_NAME                  "temperature"
+#define TEST_OTHER_PROPERTY_NAME            "pressure"
+#define TEST_DEADBAND                       0.5
+#define TEST_HEARTBEAT_MS                   60000
+
+
+// Fake messages, holding the values of the two test properties
+
+typedef struct TEST_MESSAGE_TAG
+{
+    const char* temperature;
+    const char* pressure;
+} TEST_MESSAGE;
+
+static const char* TEST_IoTHubMessage_GetProperty(IOTHUB_MESSAGE_HANDLE handle, const char* key)
+{
+    TEST_MESSAGE* message = (TEST_MESSAGE*)handle;
+    const char* result;
+
+    if (strcmp(key, TEST_PROPERTY_NAME) == 0)
+    {
+        result = message->temperature;
+    }
+    else if (strcmp(key, TEST_OTHER_PROPERTY_NAME) == 0)
+    {
+        result = message->pressure;
+    }
+    else
+    {
+        result = NULL;
+    }
+
+    return result;
+}
+
+static bool is_suppressed(REPORT_BY_EXCEPTION_HANDLE report_by_exception, const char* temperature, const char* pressure, tickcounter_ms_t now)
+{
+    TEST_MESSAGE message;
+    message.temperature = temperature;
+    message.pressure = pressure;
+    return report_by_exception_is_suppressed(report_by_exception, (IOTHUB_MESSAGE_HANDLE)&message, now);
+}
+
+static IOTHUB_CLIENT_REPORT_BY_EXCEPTION get_test_configuration(const char* property_name)
+{
+    IOTHUB_CLIENT_REPORT_BY_EXCEPTION configuration;
+    configuration.property_name = property_name;
+    configuration.deadband = TEST_DEADBAND;
+    configuration.heartbeat_ms = TEST_HEARTBEAT_MS;
+    return configuration;
+}
+
+static REPORT_BY_EXCEPTION_HANDLE create_configured_report_by_exception(void)
+{
+    IOTHUB_CLIENT_REPORT_BY_EXCEPTION configuration = get_test_configuration(TEST_PROPERTY_NAME);
+    REPORT_BY_EXCEPTION_HANDLE report_by_exception = report_by_exception_create();
+    ASSERT_IS_NOT_NULL(report_by_exception);
+    ASSERT_ARE_EQUAL(int, 0, report_by_exception_configure(report_by_exception, &configuration));
+    return report_by_exception;
+}
+
+static void register_global_mock_hooks(void)
+{
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, real_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, real_free);
+
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetProperty, TEST_IoTHubMessage_GetProperty);
+}
+
+static void register_umock_alias_types(void)
+{
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_RESULT, int);
+}
+
+
+BEGIN_TEST_SUITE(iothub_client_report_by_exception_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    int result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_bool_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    register_umock_alias_types();
+    register_global_mock_hooks();
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+
+// Tests_SRS_REPORT_BY_EXCEPTION_41_001: [report_by_exception_create shall return a new report by exception without any filter, or NULL if it cannot be allocated]
+TEST_FUNCTION(create_malloc_fails)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .SetReturn(NULL);
+
+    // act
+    REPORT_BY_EXCEPTION_HANDLE report_by_exception = report_by_exception_create();
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(report_by_exception);
+}
+
+// Tests_SRS_REPORT_BY_EXCEPTION_41_003: [If `report_by_exception`, `configuration` or its `property_name` is NULL, report_by_exception_configure shall fail and return a non-zero value]
+TEST_FUNCTION(configure_NULL_property_name_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_REPORT_BY_EXCEPTION configuration = get_test_configuration(NULL);
+    REPORT_BY_EXCEPTION_HANDLE report_by_exception = report_by_exception_create();
+    umock_c_reset_all_calls();
+
+    // act
+    int result = report_by_exception_configure(report_by_exception, &configuration);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+    // cleanup
+    report_by_exception_destroy(report_by_exception);
+}
+
+// Tests_SRS_REPORT_BY_EXCEPTION_41_005: [Otherwise report_by_exception_configure shall create a filter for `property_name` without a last value, replacing any filter of `property_name`, and fail leaving the previous filter in place if it cannot be allocated]
+TEST_FUNCTION(configure_malloc_fails_keeps_the_previous_filter)
+{
+    // arrange
+    IOTHUB_CLIENT_REPORT_BY_EXCEPTION configuration = get_test_configuration(TEST_PROPERTY_NAME);
+    REPORT_BY_EXCEPTION_HANDLE report_by_exception = create_configured_report_by_exception();
+    ASSERT_IS_FALSE(is_suppressed(report_by_exception, "20", NULL, 0));
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .SetReturn(NULL);
+
+    // act
+    int result = report_by_exception_configure(report_by_exception, &configuration);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_IS_TRUE(is_suppressed(report_by_exception, "20", NULL, 1));
+
+    // cleanup
+    report_by_exception_destroy(report_by_exception);
+}
+
+// Tests_SRS_REPORT_BY_EXCEPTION_41_004: [If `deadband` is negative, report_by_exception_configure shall remove the filter of `property_name`, if any, and succeed]
+TEST_FUNCTION(configure_negative_deadband_removes_the_filter)
+{
+    // arrange
+    IOTHUB_CLIENT_REPORT_BY_EXCEPTION configuration = get_test_configuration(TEST_PROPERTY_NAME);
+    REPORT_BY_EXCEPTION_HANDLE report_by_exception = create_configured_report_by_exception();
+    ASSERT_IS_FALSE(is_suppressed(report_by_exception, "20", NULL, 0));
+    configuration.deadband = -1.0;
+
+    // act
+    int result = report_by_exception_configure(report_by_exception, &configuration);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_IS_FALSE(is_suppressed(report_by_exception, "20", NULL, 1));
+
+    // cleanup
+    report_by_exception_destroy(report_by_exception);
+}
+
+// Tests_SRS_REPORT_BY_EXCEPTION_41_006: [If `report_by_exception` or `message` is NULL, report_by_exception_is_suppressed shall return false]
+TEST_FUNCTION(is_suppressed_NULL_message_returns_false)
+{
+    // arrange
+    REPORT_BY_EXCEPTION_HANDLE report_by_exception = create_configured_report_by_exception();
+    umock_c_reset_all_calls();
+
+    // act
+    bool result = report_by_exception_is_suppressed(report_by_exception, NULL, 0);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_FALSE(result);
+
+    // cleanup
+    report_by_exception_destroy(report_by_exception);
+}
+
+// Tests_SRS_REPORT_BY_EXCEPTION_41_007: [Only the filtered properties of `message` whose value is a number shall count; report_by_exception_is_suppressed shall return false if `message` has none]
+TEST_FUNCTION(is_suppressed_without_a_number_returns_false)
+{
+    // arrange
+    REPORT_BY_EXCEPTION_HANDLE report_by_exception = create_configured_report_by_exception();
+    ASSERT_IS_FALSE(is_suppressed(report_by_exception, "20", NULL, 0));
+
+    // act
+    bool missing = is_suppressed(report_by_exception, NULL, "1013", 1);
+    bool not_a_number = is_suppressed(report_by_exception, "warm", NULL, 2);
+
+    // assert
+    ASSERT_IS_FALSE(missing);
+    ASSERT_IS_FALSE(not_a_number);
+    ASSERT_IS_TRUE(is_suppressed(report_by_exception, "20", NULL, 3));
+
+    // cleanup
+    report_by_exception_destroy(report_by_exception);
+}
+
+// Tests_SRS_REPORT_BY_EXCEPTION_41_008: [A property shall be news if its filter has no last value, its value is more than `deadband` away from the last one, or `heartbeat_ms` is not 0 and have passed since the last one was sent]
+// Tests_SRS_REPORT_BY_EXCEPTION_41_009: [report_by_exception_is_suppressed shall return true if none of the properties that count is news]
+// Tests_SRS_REPORT_BY_EXCEPTION_41_010: [Otherwise the filters of the properties that count shall take their values and `now` as the last ones sent, and report_by_exception_is_suppressed shall return false]
+TEST_FUNCTION(is_suppressed_compares_with_the_last_value_sent)
+{
+    // arrange
+    REPORT_BY_EXCEPTION_HANDLE report_by_exception = create_configured_report_by_exception();
+
+    // act
+    bool first = is_suppressed(report_by_exception, "20", NULL, 0);
+    bool within = is_suppressed(report_by_exception, "20.4", NULL, 1);
+    bool drifted = is_suppressed(report_by_exception, "20.8", NULL, 2);
+    bool below = is_suppressed(report_by_exception, "20.5", NULL, 3);
+
+    // assert
+    ASSERT_IS_FALSE(first);
+    ASSERT_IS_TRUE(within);
+    ASSERT_IS_FALSE(drifted);
+    ASSERT_IS_TRUE(below);
+
+    // cleanup
+    report_by_exception_destroy(report_by_exception);
+}
+
+// Tests_SRS_REPORT_BY_EXCEPTION_41_008: [A property shall be news if its filter has no last value, its value is more than `deadband` away from the last one, or `heartbeat_ms` is not 0 and have passed since the last one was sent]
+TEST_FUNCTION(is_suppressed_sends_the_heartbeat)
+{
+    // arrange
+    REPORT_BY_EXCEPTION_HANDLE report_by_exception = create_configured_report_by_exception();
+    ASSERT_IS_FALSE(is_suppressed(report_by_exception, "20", NULL, 0));
+
+    // act
+    bool before = is_suppressed(report_by_exception, "20", NULL, TEST_HEARTBEAT_MS - 1);
+    bool due = is_suppressed(report_by_exception, "20", NULL, TEST_HEARTBEAT_MS);
+    bool after = is_suppressed(report_by_exception, "20", NULL, TEST_HEARTBEAT_MS + 1);
+
+    // assert
+    ASSERT_IS_TRUE(before);
+    ASSERT_IS_FALSE(due);
+    ASSERT_IS_TRUE(after);
+
+    // cleanup
+    report_by_exception_destroy(report_by_exception);
+}
+
+// Tests_SRS_REPORT_BY_EXCEPTION_41_009: [report_by_exception_is_suppressed shall return true if none of the properties that count is news]
+// Tests_SRS_REPORT_BY_EXCEPTION_41_010: [Otherwise the filters of the properties that count shall take their values and `now` as the last ones sent, and report_by_exception_is_suppressed shall return false]
+TEST_FUNCTION(is_suppressed_sends_when_any_property_is_news)
+{
+    // arrange
+    IOTHUB_CLIENT_REPORT_BY_EXCEPTION configuration = get_test_configuration(TEST_OTHER_PROPERTY_NAME);
+    REPORT_BY_EXCEPTION_HANDLE report_by_exception = create_configured_report_by_exception();
+    ASSERT_ARE_EQUAL(int, 0, report_by_exception_configure(report_by_exception, &configuration));
+    ASSERT_IS_FALSE(is_suppressed(report_by_exception, "20", "1013", 0));
+
+    // act
+    bool pressure_moved = is_suppressed(report_by_exception, "20.4", "1015", 1);
+    bool both_within = is_suppressed(report_by_exception, "20.4", "1015", 2);
+
+    // assert
+    ASSERT_IS_FALSE(pressure_moved);
+    ASSERT_IS_TRUE(both_within);
+    ASSERT_IS_FALSE(is_suppressed(report_by_exception, "21", "1015", 3));
+    ASSERT_IS_TRUE(is_suppressed(report_by_exception, "21.1", "1015", 4));
+
+    // cleanup
+    report_by_exception_destroy(report_by_exception);
+}
+
+// Tests_SRS_REPORT_BY_EXCEPTION_41_002: [report_by_exception_destroy shall free all the filters; it shall do nothing if `report_by_exception` is NULL]
+TEST_FUNCTION(destroy_NULL)
+{
+    // arrange
+    umock_c_reset_all_calls();
+
+    // act
+    report_by_exception_destroy(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+END_TEST_SUITE(iothub_client_report_by_exception_ut)
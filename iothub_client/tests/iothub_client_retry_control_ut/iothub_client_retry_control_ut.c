@@ -488,6 +488,7 @@ TEST_FUNCTION(Retrieve_Options_NULL_handle)
 // Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_007: [`retry_control->max_jitter_percent` shall be set to 5]
 // Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_046: [An instance of OPTIONHANDLER_HANDLE (a.k.a. `options`) shall be created using OptionHandler_Create]
 // Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_050: [`retry_control->initial_wait_time_in_secs` shall be added to `options` using OptionHandler_Add]
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_008: [`retry_control->max_wait_time_in_secs` shall be added to `options` using OptionHandler_Add]
 // Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_051: [`retry_control->max_jitter_percent` shall be added to `options` using OptionHandler_Add]
 // Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_054: [If no errors occur, `retry_control_retrieve_options` shall return the OPTIONHANDLER_HANDLE instance]
 TEST_FUNCTION(Retrieve_Options_success)
@@ -501,6 +502,8 @@ TEST_FUNCTION(Retrieve_Options_success)
     EXPECTED_CALL(OptionHandler_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(OptionHandler_AddOption(TEST_OPTIONHANDLER_HANDLE, RETRY_CONTROL_OPTION_INITIAL_WAIT_TIME_IN_SECS, IGNORED_PTR_ARG))
         .IgnoreArgument_value();
+    STRICT_EXPECTED_CALL(OptionHandler_AddOption(TEST_OPTIONHANDLER_HANDLE, RETRY_CONTROL_OPTION_MAX_WAIT_TIME_IN_SECS, IGNORED_PTR_ARG))
+        .IgnoreArgument_value();
     STRICT_EXPECTED_CALL(OptionHandler_AddOption(TEST_OPTIONHANDLER_HANDLE, RETRY_CONTROL_OPTION_MAX_JITTER_PERCENT, IGNORED_PTR_ARG))
         .IgnoreArgument_value();
 
@@ -532,6 +535,8 @@ TEST_FUNCTION(Retrieve_Options_failure_checks)
     EXPECTED_CALL(OptionHandler_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(OptionHandler_AddOption(TEST_OPTIONHANDLER_HANDLE, RETRY_CONTROL_OPTION_INITIAL_WAIT_TIME_IN_SECS, IGNORED_PTR_ARG))
         .IgnoreArgument_value();
+    STRICT_EXPECTED_CALL(OptionHandler_AddOption(TEST_OPTIONHANDLER_HANDLE, RETRY_CONTROL_OPTION_MAX_WAIT_TIME_IN_SECS, IGNORED_PTR_ARG))
+        .IgnoreArgument_value();
     STRICT_EXPECTED_CALL(OptionHandler_AddOption(TEST_OPTIONHANDLER_HANDLE, RETRY_CONTROL_OPTION_MAX_JITTER_PERCENT, IGNORED_PTR_ARG))
         .IgnoreArgument_value();
     umock_c_negative_tests_snapshot();
@@ -953,6 +958,52 @@ TEST_FUNCTION(Should_Retry_INTERVAL_success)
     retry_control_destroy(handle);
 }
 
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_005: [If `policy` is IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF, IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_JITTER or IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_DECORRELATED_JITTER, `retry_control->initial_wait_time_in_secs` shall be set to 1]
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_001: [If `retry_control->policy` is IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_DECORRELATED_JITTER, `calculate_next_wait_time` shall return a random wait time between `retry_control->initial_wait_time_in_secs` and 3 times the previous wait time (`retry_control->initial_wait_time_in_secs` on the first retry)]
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_002: [If `retry_control->max_wait_time_in_secs` is not 0, `calculate_next_wait_time` shall return at most `retry_control->max_wait_time_in_secs`]
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_007: [If `name` is "max_wait_time_in_secs", value shall be saved on `retry_control->max_wait_time_in_secs`; 0 means no limit]
+TEST_FUNCTION(Should_Retry_EXPONENTIAL_BACKOFF_WITH_DECORRELATED_JITTER_capped_success)
+{
+    // arrange
+    unsigned int max_retry_time_in_secs = 10;
+    RETRY_CONTROL_HANDLE handle = create_retry_control(IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_DECORRELATED_JITTER, max_retry_time_in_secs);
+
+    // with the cap equal to the initial wait the random draw always lands on the cap
+    unsigned int option_value = 1;
+    int set_option_result = retry_control_set_option(handle, RETRY_CONTROL_OPTION_MAX_WAIT_TIME_IN_SECS, &option_value);
+
+    int expected_retry_times[] = { 0, 1, 1, 1, 1 };
+
+    // act
+    // assert
+    run_and_verify_should_retry_times(handle, expected_retry_times, 5, max_retry_time_in_secs);
+    ASSERT_ARE_EQUAL(int, 0, set_option_result);
+
+    // cleanup
+    retry_control_destroy(handle);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_002: [If `retry_control->max_wait_time_in_secs` is not 0, `calculate_next_wait_time` shall return at most `retry_control->max_wait_time_in_secs`]
+TEST_FUNCTION(Should_Retry_EXPONENTIAL_BACKOFF_max_wait_time_success)
+{
+    // arrange
+    unsigned int max_retry_time_in_secs = 15;
+    RETRY_CONTROL_HANDLE handle = create_retry_control(IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF, max_retry_time_in_secs);
+
+    unsigned int option_value = 2;
+    int set_option_result = retry_control_set_option(handle, RETRY_CONTROL_OPTION_MAX_WAIT_TIME_IN_SECS, &option_value);
+
+    int expected_retry_times[] = { 0, 1, 2, 2, 2 };
+
+    // act
+    // assert
+    run_and_verify_should_retry_times(handle, expected_retry_times, 5, max_retry_time_in_secs);
+    ASSERT_ARE_EQUAL(int, 0, set_option_result);
+
+    // cleanup
+    retry_control_destroy(handle);
+}
+
 // Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_006: [Otherwise `retry_control->initial_wait_time_in_secs` shall be set to 5]
 // Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_030: [If `retry_control->policy_name` is IOTHUB_CLIENT_RETRY_LINEAR_BACKOFF, `calculate_next_wait_time` shall return (`retry_control->initial_wait_time_in_secs` * (`retry_control->retry_count`))]
 TEST_FUNCTION(Should_Retry_LINEAR_BACKOFF_success)
@@ -1114,6 +1165,196 @@ TEST_FUNCTION(Should_Retry_RETRY_NONE_success)
     retry_control_destroy(handle);
 }
 
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_003: [If `retry_control_handle` is NULL, `retry_control_set_retry_after` shall fail and return non-zero]
+TEST_FUNCTION(Set_Retry_After_NULL_handle)
+{
+    // arrange
+    umock_c_reset_all_calls();
+
+    // act
+    int result = retry_control_set_retry_after(NULL, 10);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+    // cleanup
+}
+
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_005: [`retry_control->current_wait_time_in_secs` shall be raised to `retry_after_in_secs` if it is lower, ignoring `max_wait_time_in_secs`, so that the pending retry waits at least as long as the service asked]
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_006: [If no errors occur, `retry_control_set_retry_after` shall return 0]
+TEST_FUNCTION(Set_Retry_After_extends_wait_time_success)
+{
+    // arrange
+    unsigned int max_retry_time_in_secs = 20;
+    RETRY_CONTROL_HANDLE handle = create_retry_control(IOTHUB_CLIENT_RETRY_INTERVAL, max_retry_time_in_secs);
+
+    time_t first_time = TEST_current_time;
+    time_t interval_time = add_seconds(first_time, 5);
+    time_t retry_after_time = add_seconds(first_time, 10);
+
+    run_and_verify_should_retry(handle, INDEFINITE_TIME, INDEFINITE_TIME, first_time, 0, 0, RETRY_ACTION_RETRY_NOW, true);
+
+    // act
+    int result = retry_control_set_retry_after(handle, 10);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    run_and_verify_should_retry(handle, first_time, first_time, interval_time, 5, 5, RETRY_ACTION_RETRY_LATER, false);
+    run_and_verify_should_retry(handle, first_time, first_time, retry_after_time, 10, 10, RETRY_ACTION_RETRY_NOW, false);
+
+    // cleanup
+    retry_control_destroy(handle);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_005: [`retry_control->current_wait_time_in_secs` shall be raised to `retry_after_in_secs` if it is lower, ignoring `max_wait_time_in_secs`, so that the pending retry waits at least as long as the service asked]
+TEST_FUNCTION(Set_Retry_After_shorter_than_wait_time_success)
+{
+    // arrange
+    unsigned int max_retry_time_in_secs = 20;
+    RETRY_CONTROL_HANDLE handle = create_retry_control(IOTHUB_CLIENT_RETRY_INTERVAL, max_retry_time_in_secs);
+
+    time_t first_time = TEST_current_time;
+    time_t retry_after_time = add_seconds(first_time, 2);
+    time_t interval_time = add_seconds(first_time, 5);
+
+    run_and_verify_should_retry(handle, INDEFINITE_TIME, INDEFINITE_TIME, first_time, 0, 0, RETRY_ACTION_RETRY_NOW, true);
+
+    // act
+    int result = retry_control_set_retry_after(handle, 2);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    run_and_verify_should_retry(handle, first_time, first_time, retry_after_time, 2, 2, RETRY_ACTION_RETRY_LATER, false);
+    run_and_verify_should_retry(handle, first_time, first_time, interval_time, 5, 5, RETRY_ACTION_RETRY_NOW, false);
+
+    // cleanup
+    retry_control_destroy(handle);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_009: [If `retry_control_handle` or `wait_time_in_secs` are NULL, or `retry_count` is 0, `retry_control_get_wait_time` shall fail and return non-zero]
+TEST_FUNCTION(Get_Wait_Time_NULL_handle)
+{
+    // arrange
+    unsigned int wait_time_in_secs;
+    umock_c_reset_all_calls();
+
+    // act
+    int result = retry_control_get_wait_time(NULL, 1, 0, &wait_time_in_secs);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+    // cleanup
+}
+
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_009: [If `retry_control_handle` or `wait_time_in_secs` are NULL, or `retry_count` is 0, `retry_control_get_wait_time` shall fail and return non-zero]
+TEST_FUNCTION(Get_Wait_Time_NULL_wait_time_in_secs)
+{
+    // arrange
+    RETRY_CONTROL_HANDLE handle = create_retry_control(IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF, 0);
+    umock_c_reset_all_calls();
+
+    // act
+    int result = retry_control_get_wait_time(handle, 1, 0, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+    // cleanup
+    retry_control_destroy(handle);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_009: [If `retry_control_handle` or `wait_time_in_secs` are NULL, or `retry_count` is 0, `retry_control_get_wait_time` shall fail and return non-zero]
+TEST_FUNCTION(Get_Wait_Time_zero_retry_count)
+{
+    // arrange
+    unsigned int wait_time_in_secs;
+    RETRY_CONTROL_HANDLE handle = create_retry_control(IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF, 0);
+    umock_c_reset_all_calls();
+
+    // act
+    int result = retry_control_get_wait_time(handle, 0, 0, &wait_time_in_secs);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+    // cleanup
+    retry_control_destroy(handle);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_010: [If `retry_control->policy` is IOTHUB_CLIENT_RETRY_NONE or IOTHUB_CLIENT_RETRY_IMMEDIATE, `wait_time_in_secs` shall be set to 0]
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_012: [If no errors occur, `retry_control_get_wait_time` shall return 0]
+TEST_FUNCTION(Get_Wait_Time_IMMEDIATE_success)
+{
+    // arrange
+    unsigned int wait_time_in_secs = 1234;
+    RETRY_CONTROL_HANDLE handle = create_retry_control(IOTHUB_CLIENT_RETRY_IMMEDIATE, 0);
+    umock_c_reset_all_calls();
+
+    // act
+    int result = retry_control_get_wait_time(handle, 3, 0, &wait_time_in_secs);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(int, 0, wait_time_in_secs);
+
+    // cleanup
+    retry_control_destroy(handle);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_011: [Otherwise `wait_time_in_secs` shall be set as calculate_next_wait_time() would for the `retry_count`-th retry after a wait of `previous_wait_time_in_secs`, without changing the state of `retry_control`]
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_012: [If no errors occur, `retry_control_get_wait_time` shall return 0]
+TEST_FUNCTION(Get_Wait_Time_EXPONENTIAL_BACKOFF_success)
+{
+    // arrange
+    unsigned int wait_time_1;
+    unsigned int wait_time_4;
+    RETRY_CONTROL_HANDLE handle = create_retry_control(IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF, 0);
+    umock_c_reset_all_calls();
+
+    // act
+    int result_1 = retry_control_get_wait_time(handle, 1, 0, &wait_time_1);
+    int result_4 = retry_control_get_wait_time(handle, 4, 4, &wait_time_4);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result_1);
+    ASSERT_ARE_EQUAL(int, 0, result_4);
+    ASSERT_ARE_EQUAL(int, 1, wait_time_1);
+    ASSERT_ARE_EQUAL(int, 8, wait_time_4);
+
+    // The retry state was not touched, so the first retry of the instance is still immediate
+    run_and_verify_should_retry(handle, INDEFINITE_TIME, INDEFINITE_TIME, TEST_current_time, 0, 0, RETRY_ACTION_RETRY_NOW, true);
+
+    // cleanup
+    retry_control_destroy(handle);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_41_011: [Otherwise `wait_time_in_secs` shall be set as calculate_next_wait_time() would for the `retry_count`-th retry after a wait of `previous_wait_time_in_secs`, without changing the state of `retry_control`]
+TEST_FUNCTION(Get_Wait_Time_LINEAR_BACKOFF_success)
+{
+    // arrange
+    unsigned int wait_time_in_secs;
+    RETRY_CONTROL_HANDLE handle = create_retry_control(IOTHUB_CLIENT_RETRY_LINEAR_BACKOFF, 0);
+    umock_c_reset_all_calls();
+
+    // act
+    int result = retry_control_get_wait_time(handle, 3, 10, &wait_time_in_secs);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(int, 15, wait_time_in_secs);
+
+    // cleanup
+    retry_control_destroy(handle);
+}
+
 // Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_034: [If `retry_control_handle` is NULL, `retry_control_reset` shall return]
 // Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_035: [`retry_control` shall have fields `retry_count` and `current_wait_time_in_secs` set to 0 (zero), `first_retry_time` and `last_retry_time` set to INDEFINITE_TIME]
 TEST_FUNCTION(Reset_success)
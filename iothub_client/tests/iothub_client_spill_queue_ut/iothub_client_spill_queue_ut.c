@@ -0,0 +1,699 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <cstring>
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#endif
+
+#if defined _MSC_VER
+#pragma warning(disable: 4054) /* MSC incorrectly fires this */
+#endif
+
+void* real_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+void real_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umock_c_negative_tests.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+#include "umocktypes_bool.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/map.h"
+#include "iothub_message.h"
+#undef ENABLE_MOCKS
+
+#include "internal/iothub_client_spill_queue.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+
+// Data definitions
+
+// the tests run in the working directory and remove the files they create
+#define TEST_DIRECTORY                      "."
+#define TEST_STATE_FILE                     "./iothub_spill.state"
+#define TEST_SEGMENT_FILE_FORMAT            "./iothub_spill_%08lu.log"
+#define TEST_MAX_SEGMENTS                   32
+#define TEST_MAX_SEGMENT_SIZE               (64 * 1024)
+#define TEST_SMALL_SEGMENT_SIZE             1
+#define TEST_MAX_PROPERTIES                 4
+#define TEST_CALLBACK_CONTEXT               (void*)0x7771
+
+
+// Fake messages, holding just what the spill queue reads and writes
+
+typedef struct TEST_MESSAGE_TAG
+{
+    IOTHUBMESSAGE_CONTENT_TYPE content_type;
+    unsigned char* payload;
+    size_t payload_size;
+    char* message_id;
+    char* correlation_id;
+    char* content_type_property;
+    char* content_encoding;
+    char* output_name;
+    size_t property_count;
+    char* keys[TEST_MAX_PROPERTIES];
+    char* values[TEST_MAX_PROPERTIES];
+} TEST_MESSAGE;
+
+static char* copy_string(const char* value)
+{
+    char* result = (char*)real_malloc(strlen(value) + 1);
+    ASSERT_IS_NOT_NULL(result);
+    (void)strcpy(result, value);
+    return result;
+}
+
+static IOTHUB_MESSAGE_HANDLE TEST_IoTHubMessage_CreateFromByteArray(const unsigned char* byteArray, size_t size)
+{
+    TEST_MESSAGE* message = (TEST_MESSAGE*)real_malloc(sizeof(TEST_MESSAGE));
+    ASSERT_IS_NOT_NULL(message);
+    (void)memset(message, 0, sizeof(TEST_MESSAGE));
+    message->content_type = IOTHUBMESSAGE_BYTEARRAY;
+    message->payload = (unsigned char*)real_malloc(size + 1);
+    ASSERT_IS_NOT_NULL(message->payload);
+    if (size > 0)
+    {
+        (void)memcpy(message->payload, byteArray, size);
+    }
+    message->payload_size = size;
+    return (IOTHUB_MESSAGE_HANDLE)message;
+}
+
+static IOTHUB_MESSAGE_HANDLE TEST_IoTHubMessage_CreateFromString(const char* source)
+{
+    TEST_MESSAGE* message = (TEST_MESSAGE*)TEST_IoTHubMessage_CreateFromByteArray((const unsigned char*)source, strlen(source) + 1);
+    message->content_type = IOTHUBMESSAGE_STRING;
+    return (IOTHUB_MESSAGE_HANDLE)message;
+}
+
+static void TEST_IoTHubMessage_Destroy(IOTHUB_MESSAGE_HANDLE handle)
+{
+    TEST_MESSAGE* message = (TEST_MESSAGE*)handle;
+    size_t i;
+
+    real_free(message->payload);
+    real_free(message->message_id);
+    real_free(message->correlation_id);
+    real_free(message->content_type_property);
+    real_free(message->content_encoding);
+    real_free(message->output_name);
+    for (i = 0; i < message->property_count; i++)
+    {
+        real_free(message->keys[i]);
+        real_free(message->values[i]);
+    }
+    real_free(message);
+}
+
+static IOTHUBMESSAGE_CONTENT_TYPE TEST_IoTHubMessage_GetContentType(IOTHUB_MESSAGE_HANDLE handle)
+{
+    return ((TEST_MESSAGE*)handle)->content_type;
+}
+
+static IOTHUB_MESSAGE_RESULT TEST_IoTHubMessage_GetByteArray(IOTHUB_MESSAGE_HANDLE handle, const unsigned char** buffer, size_t* size)
+{
+    *buffer = ((TEST_MESSAGE*)handle)->payload;
+    *size = ((TEST_MESSAGE*)handle)->payload_size;
+    return IOTHUB_MESSAGE_OK;
+}
+
+static const char* TEST_IoTHubMessage_GetString(IOTHUB_MESSAGE_HANDLE handle)
+{
+    return (const char*)((TEST_MESSAGE*)handle)->payload;
+}
+
+static const char* TEST_IoTHubMessage_GetMessageId(IOTHUB_MESSAGE_HANDLE handle)
+{
+    return ((TEST_MESSAGE*)handle)->message_id;
+}
+
+static IOTHUB_MESSAGE_RESULT TEST_IoTHubMessage_SetMessageId(IOTHUB_MESSAGE_HANDLE handle, const char* value)
+{
+    ((TEST_MESSAGE*)handle)->message_id = copy_string(value);
+    return IOTHUB_MESSAGE_OK;
+}
+
+static const char* TEST_IoTHubMessage_GetCorrelationId(IOTHUB_MESSAGE_HANDLE handle)
+{
+    return ((TEST_MESSAGE*)handle)->correlation_id;
+}
+
+static IOTHUB_MESSAGE_RESULT TEST_IoTHubMessage_SetCorrelationId(IOTHUB_MESSAGE_HANDLE handle, const char* value)
+{
+    ((TEST_MESSAGE*)handle)->correlation_id = copy_string(value);
+    return IOTHUB_MESSAGE_OK;
+}
+
+static const char* TEST_IoTHubMessage_GetContentTypeSystemProperty(IOTHUB_MESSAGE_HANDLE handle)
+{
+    return ((TEST_MESSAGE*)handle)->content_type_property;
+}
+
+static IOTHUB_MESSAGE_RESULT TEST_IoTHubMessage_SetContentTypeSystemProperty(IOTHUB_MESSAGE_HANDLE handle, const char* value)
+{
+    ((TEST_MESSAGE*)handle)->content_type_property = copy_string(value);
+    return IOTHUB_MESSAGE_OK;
+}
+
+static const char* TEST_IoTHubMessage_GetContentEncodingSystemProperty(IOTHUB_MESSAGE_HANDLE handle)
+{
+    return ((TEST_MESSAGE*)handle)->content_encoding;
+}
+
+static IOTHUB_MESSAGE_RESULT TEST_IoTHubMessage_SetContentEncodingSystemProperty(IOTHUB_MESSAGE_HANDLE handle, const char* value)
+{
+    ((TEST_MESSAGE*)handle)->content_encoding = copy_string(value);
+    return IOTHUB_MESSAGE_OK;
+}
+
+static const char* TEST_IoTHubMessage_GetOutputName(IOTHUB_MESSAGE_HANDLE handle)
+{
+    return ((TEST_MESSAGE*)handle)->output_name;
+}
+
+static IOTHUB_MESSAGE_RESULT TEST_IoTHubMessage_SetOutputName(IOTHUB_MESSAGE_HANDLE handle, const char* value)
+{
+    ((TEST_MESSAGE*)handle)->output_name = copy_string(value);
+    return IOTHUB_MESSAGE_OK;
+}
+
+static IOTHUB_MESSAGE_RESULT TEST_IoTHubMessage_SetProperty(IOTHUB_MESSAGE_HANDLE handle, const char* key, const char* value)
+{
+    TEST_MESSAGE* message = (TEST_MESSAGE*)handle;
+    ASSERT_IS_TRUE(message->property_count < TEST_MAX_PROPERTIES);
+    message->keys[message->property_count] = copy_string(key);
+    message->values[message->property_count] = copy_string(value);
+    message->property_count++;
+    return IOTHUB_MESSAGE_OK;
+}
+
+static IOTHUB_MESSAGE_RESULT TEST_IoTHubMessage_GetProperties(IOTHUB_MESSAGE_HANDLE handle, const char*const** keys, const char*const** values, size_t* count)
+{
+    TEST_MESSAGE* message = (TEST_MESSAGE*)handle;
+    *keys = (const char*const*)message->keys;
+    *values = (const char*const*)message->values;
+    *count = message->property_count;
+    return IOTHUB_MESSAGE_OK;
+}
+
+static void test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_RESULT result, void* userContextCallback)
+{
+    (void)result;
+    (void)userContextCallback;
+}
+
+
+// Helpers
+
+static void remove_test_files(void)
+{
+    unsigned long i;
+    char file_name[64];
+
+    (void)remove(TEST_STATE_FILE);
+    for (i = 0; i < TEST_MAX_SEGMENTS; i++)
+    {
+        (void)snprintf(file_name, sizeof(file_name), TEST_SEGMENT_FILE_FORMAT, i);
+        (void)remove(file_name);
+    }
+}
+
+static size_t count_segment_files(void)
+{
+    size_t result = 0;
+    unsigned long i;
+    char file_name[64];
+
+    for (i = 0; i < TEST_MAX_SEGMENTS; i++)
+    {
+        FILE* file;
+        (void)snprintf(file_name, sizeof(file_name), TEST_SEGMENT_FILE_FORMAT, i);
+        if ((file = fopen(file_name, "rb")) != NULL)
+        {
+            (void)fclose(file);
+            result++;
+        }
+    }
+
+    return result;
+}
+
+static IOTHUB_MESSAGE_HANDLE create_test_message(const char* message_id)
+{
+    IOTHUB_MESSAGE_HANDLE message = TEST_IoTHubMessage_CreateFromString("payload");
+    (void)TEST_IoTHubMessage_SetMessageId(message, message_id);
+    return message;
+}
+
+static void push_test_message(SPILL_QUEUE_HANDLE spill_queue, const char* message_id)
+{
+    IOTHUB_MESSAGE_HANDLE message = create_test_message(message_id);
+    ASSERT_ARE_EQUAL(int, 0, spill_queue_push_message(spill_queue, message, test_event_confirmation_callback, TEST_CALLBACK_CONTEXT));
+    TEST_IoTHubMessage_Destroy(message);
+}
+
+static void read_test_message(SPILL_QUEUE_HANDLE spill_queue, const char* expected_message_id)
+{
+    IOTHUB_MESSAGE_HANDLE message;
+    IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK callback;
+    void* context;
+
+    ASSERT_ARE_EQUAL(int, 0, spill_queue_read_message(spill_queue, &message, &callback, &context));
+    ASSERT_IS_NOT_NULL(message);
+    ASSERT_ARE_EQUAL(char_ptr, expected_message_id, TEST_IoTHubMessage_GetMessageId(message));
+    TEST_IoTHubMessage_Destroy(message);
+}
+
+static void register_global_mock_hooks(void)
+{
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, real_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, real_free);
+
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_CreateFromByteArray, TEST_IoTHubMessage_CreateFromByteArray);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_CreateFromString, TEST_IoTHubMessage_CreateFromString);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_Destroy, TEST_IoTHubMessage_Destroy);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetContentType, TEST_IoTHubMessage_GetContentType);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetByteArray, TEST_IoTHubMessage_GetByteArray);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetString, TEST_IoTHubMessage_GetString);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetMessageId, TEST_IoTHubMessage_GetMessageId);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_SetMessageId, TEST_IoTHubMessage_SetMessageId);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetCorrelationId, TEST_IoTHubMessage_GetCorrelationId);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_SetCorrelationId, TEST_IoTHubMessage_SetCorrelationId);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetContentTypeSystemProperty, TEST_IoTHubMessage_GetContentTypeSystemProperty);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_SetContentTypeSystemProperty, TEST_IoTHubMessage_SetContentTypeSystemProperty);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetContentEncodingSystemProperty, TEST_IoTHubMessage_GetContentEncodingSystemProperty);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_SetContentEncodingSystemProperty, TEST_IoTHubMessage_SetContentEncodingSystemProperty);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetOutputName, TEST_IoTHubMessage_GetOutputName);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_SetOutputName, TEST_IoTHubMessage_SetOutputName);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetProperties, TEST_IoTHubMessage_GetProperties);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_SetProperty, TEST_IoTHubMessage_SetProperty);
+}
+
+static void register_umock_alias_types(void)
+{
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(MAP_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUBMESSAGE_CONTENT_TYPE, int);
+    REGISTER_UMOCK_ALIAS_TYPE(MAP_RESULT, int);
+}
+
+
+BEGIN_TEST_SUITE(iothub_client_spill_queue_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    int result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_bool_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    register_umock_alias_types();
+    register_global_mock_hooks();
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+    remove_test_files();
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    remove_test_files();
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+
+// Tests_SRS_SPILL_QUEUE_41_001: [If `directory` is NULL or `max_segment_size` is zero, spill_queue_create shall fail and return NULL]
+TEST_FUNCTION(create_NULL_directory)
+{
+    // arrange
+    umock_c_reset_all_calls();
+
+    // act
+    SPILL_QUEUE_HANDLE spill_queue = spill_queue_create(NULL, TEST_MAX_SEGMENT_SIZE);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(spill_queue);
+}
+
+// Tests_SRS_SPILL_QUEUE_41_001: [If `directory` is NULL or `max_segment_size` is zero, spill_queue_create shall fail and return NULL]
+TEST_FUNCTION(create_zero_max_segment_size)
+{
+    // arrange
+    umock_c_reset_all_calls();
+
+    // act
+    SPILL_QUEUE_HANDLE spill_queue = spill_queue_create(TEST_DIRECTORY, 0);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(spill_queue);
+}
+
+// Tests_SRS_SPILL_QUEUE_41_002: [If any failure occurs, spill_queue_create shall release all memory it allocated, close any file it opened and return NULL]
+TEST_FUNCTION(create_malloc_fails)
+{
+    // arrange
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .SetReturn(NULL);
+
+    // act
+    SPILL_QUEUE_HANDLE spill_queue = spill_queue_create(TEST_DIRECTORY, TEST_MAX_SEGMENT_SIZE);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(spill_queue);
+}
+
+// Tests_SRS_SPILL_QUEUE_41_003: [spill_queue_create shall open the state file of `directory`, creating it if it does not exist]
+// Tests_SRS_SPILL_QUEUE_41_005: [spill_queue_create shall start a new segment, so segments written before are never appended to]
+// Tests_SRS_SPILL_QUEUE_41_024: [spill_queue_is_empty shall return true if `spill_queue` is NULL or every event pushed was read, and false otherwise]
+TEST_FUNCTION(create_empty_directory_succeeds)
+{
+    // arrange
+    FILE* state_file;
+
+    // act
+    SPILL_QUEUE_HANDLE spill_queue = spill_queue_create(TEST_DIRECTORY, TEST_MAX_SEGMENT_SIZE);
+
+    // assert
+    ASSERT_IS_NOT_NULL(spill_queue);
+    ASSERT_IS_TRUE(spill_queue_is_empty(spill_queue));
+    state_file = fopen(TEST_STATE_FILE, "rb");
+    ASSERT_IS_NOT_NULL(state_file);
+    (void)fclose(state_file);
+    ASSERT_ARE_EQUAL(size_t, 1, count_segment_files());
+
+    // cleanup
+    spill_queue_destroy(spill_queue);
+}
+
+// Tests_SRS_SPILL_QUEUE_41_008: [If `spill_queue` or `message` is NULL, spill_queue_push_message shall fail and return non-zero]
+TEST_FUNCTION(push_message_NULL_message)
+{
+    // arrange
+    SPILL_QUEUE_HANDLE spill_queue = spill_queue_create(TEST_DIRECTORY, TEST_MAX_SEGMENT_SIZE);
+    umock_c_reset_all_calls();
+
+    // act
+    int result = spill_queue_push_message(spill_queue, NULL, test_event_confirmation_callback, TEST_CALLBACK_CONTEXT);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_IS_TRUE(spill_queue_is_empty(spill_queue));
+
+    // cleanup
+    spill_queue_destroy(spill_queue);
+}
+
+// Tests_SRS_SPILL_QUEUE_41_009: [spill_queue_push_message shall encode the payload, message id, correlation id, content type, content encoding, output name and application properties of `message` as one record]
+// Tests_SRS_SPILL_QUEUE_41_014: [On success spill_queue_push_message shall return 0]
+// Tests_SRS_SPILL_QUEUE_41_018: [spill_queue_read_message shall create a new message from the oldest record not read, in the order records were pushed]
+// Tests_SRS_SPILL_QUEUE_41_020: [`callback` and `context` shall be the ones given when the record was pushed if it was pushed by `spill_queue`, and NULL otherwise]
+TEST_FUNCTION(push_and_read_message_keeps_the_message)
+{
+    // arrange
+    static const unsigned char payload[] = { 0x00, 0x01, 0xFF };
+    IOTHUB_MESSAGE_HANDLE message = TEST_IoTHubMessage_CreateFromByteArray(payload, sizeof(payload));
+    IOTHUB_MESSAGE_HANDLE read_message;
+    IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK callback;
+    void* context;
+    const unsigned char* read_payload;
+    size_t read_payload_size;
+    SPILL_QUEUE_HANDLE spill_queue = spill_queue_create(TEST_DIRECTORY, TEST_MAX_SEGMENT_SIZE);
+    (void)TEST_IoTHubMessage_SetMessageId(message, "id");
+    (void)TEST_IoTHubMessage_SetCorrelationId(message, "correlation");
+    (void)TEST_IoTHubMessage_SetContentTypeSystemProperty(message, "application/json");
+    (void)TEST_IoTHubMessage_SetOutputName(message, "output");
+    (void)TEST_IoTHubMessage_SetProperty(message, "key", "value");
+
+    // act
+    int result = spill_queue_push_message(spill_queue, message, test_event_confirmation_callback, TEST_CALLBACK_CONTEXT);
+    int read_result = spill_queue_read_message(spill_queue, &read_message, &callback, &context);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(int, 0, read_result);
+    ASSERT_IS_NOT_NULL(read_message);
+    ASSERT_ARE_EQUAL(int, (int)IOTHUBMESSAGE_BYTEARRAY, (int)TEST_IoTHubMessage_GetContentType(read_message));
+    (void)TEST_IoTHubMessage_GetByteArray(read_message, &read_payload, &read_payload_size);
+    ASSERT_ARE_EQUAL(size_t, sizeof(payload), read_payload_size);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(payload, read_payload, sizeof(payload)));
+    ASSERT_ARE_EQUAL(char_ptr, "id", TEST_IoTHubMessage_GetMessageId(read_message));
+    ASSERT_ARE_EQUAL(char_ptr, "correlation", TEST_IoTHubMessage_GetCorrelationId(read_message));
+    ASSERT_ARE_EQUAL(char_ptr, "application/json", TEST_IoTHubMessage_GetContentTypeSystemProperty(read_message));
+    ASSERT_IS_NULL(TEST_IoTHubMessage_GetContentEncodingSystemProperty(read_message));
+    ASSERT_ARE_EQUAL(char_ptr, "output", TEST_IoTHubMessage_GetOutputName(read_message));
+    ASSERT_ARE_EQUAL(size_t, 1, ((TEST_MESSAGE*)read_message)->property_count);
+    ASSERT_ARE_EQUAL(char_ptr, "key", ((TEST_MESSAGE*)read_message)->keys[0]);
+    ASSERT_ARE_EQUAL(char_ptr, "value", ((TEST_MESSAGE*)read_message)->values[0]);
+    ASSERT_IS_TRUE(callback == test_event_confirmation_callback);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_CALLBACK_CONTEXT, context);
+    ASSERT_IS_TRUE(spill_queue_is_empty(spill_queue));
+
+    // cleanup
+    TEST_IoTHubMessage_Destroy(message);
+    TEST_IoTHubMessage_Destroy(read_message);
+    spill_queue_destroy(spill_queue);
+}
+
+// Tests_SRS_SPILL_QUEUE_41_018: [spill_queue_read_message shall create a new message from the oldest record not read, in the order records were pushed]
+TEST_FUNCTION(read_message_in_push_order)
+{
+    // arrange
+    SPILL_QUEUE_HANDLE spill_queue = spill_queue_create(TEST_DIRECTORY, TEST_MAX_SEGMENT_SIZE);
+    push_test_message(spill_queue, "1");
+    push_test_message(spill_queue, "2");
+    push_test_message(spill_queue, "3");
+
+    // act
+    // assert
+    read_test_message(spill_queue, "1");
+    read_test_message(spill_queue, "2");
+    read_test_message(spill_queue, "3");
+
+    // cleanup
+    spill_queue_destroy(spill_queue);
+}
+
+// Tests_SRS_SPILL_QUEUE_41_015: [If `spill_queue`, `message`, `callback` or `context` is NULL, spill_queue_read_message shall fail and return non-zero]
+TEST_FUNCTION(read_message_NULL_message)
+{
+    // arrange
+    IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK callback;
+    void* context;
+    SPILL_QUEUE_HANDLE spill_queue = spill_queue_create(TEST_DIRECTORY, TEST_MAX_SEGMENT_SIZE);
+    umock_c_reset_all_calls();
+
+    // act
+    int result = spill_queue_read_message(spill_queue, NULL, &callback, &context);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+    // cleanup
+    spill_queue_destroy(spill_queue);
+}
+
+// Tests_SRS_SPILL_QUEUE_41_016: [If no event is left to read, spill_queue_read_message shall set `message` to NULL and return 0]
+TEST_FUNCTION(read_message_empty_returns_NULL_message)
+{
+    // arrange
+    IOTHUB_MESSAGE_HANDLE message = (IOTHUB_MESSAGE_HANDLE)0x1;
+    IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK callback;
+    void* context;
+    SPILL_QUEUE_HANDLE spill_queue = spill_queue_create(TEST_DIRECTORY, TEST_MAX_SEGMENT_SIZE);
+
+    // act
+    int result = spill_queue_read_message(spill_queue, &message, &callback, &context);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_IS_NULL(message);
+
+    // cleanup
+    spill_queue_destroy(spill_queue);
+}
+
+// Tests_SRS_SPILL_QUEUE_41_004: [Events not released by a previous spill queue on `directory` shall be read first, starting at the position saved in the state file]
+// Tests_SRS_SPILL_QUEUE_41_007: [spill_queue_destroy shall close all files and release all memory of `spill_queue`; events not released shall stay on disk]
+// Tests_SRS_SPILL_QUEUE_41_019: [The record shall be kept on disk until it is released]
+// Tests_SRS_SPILL_QUEUE_41_022: [spill_queue_release shall save the end of the oldest event read and not released as the position to start reading from]
+TEST_FUNCTION(create_resumes_after_the_released_events)
+{
+    // arrange
+    IOTHUB_MESSAGE_HANDLE message;
+    IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK callback;
+    void* context;
+    SPILL_QUEUE_HANDLE spill_queue = spill_queue_create(TEST_DIRECTORY, TEST_MAX_SEGMENT_SIZE);
+    push_test_message(spill_queue, "1");
+    push_test_message(spill_queue, "2");
+    read_test_message(spill_queue, "1");
+    read_test_message(spill_queue, "2");
+    ASSERT_ARE_EQUAL(int, 0, spill_queue_release(spill_queue));
+    spill_queue_destroy(spill_queue);
+
+    // act
+    spill_queue = spill_queue_create(TEST_DIRECTORY, TEST_MAX_SEGMENT_SIZE);
+
+    // assert
+    ASSERT_IS_NOT_NULL(spill_queue);
+    ASSERT_IS_FALSE(spill_queue_is_empty(spill_queue));
+    ASSERT_ARE_EQUAL(int, 0, spill_queue_read_message(spill_queue, &message, &callback, &context));
+    ASSERT_IS_NOT_NULL(message);
+    ASSERT_ARE_EQUAL(char_ptr, "2", TEST_IoTHubMessage_GetMessageId(message));
+    ASSERT_IS_NULL(callback);
+    ASSERT_IS_NULL(context);
+    ASSERT_IS_TRUE(spill_queue_is_empty(spill_queue));
+
+    // cleanup
+    TEST_IoTHubMessage_Destroy(message);
+    spill_queue_destroy(spill_queue);
+}
+
+// Tests_SRS_SPILL_QUEUE_41_017: [A missing, torn or corrupted record shall end its segment, and reading shall continue with the next segment]
+TEST_FUNCTION(read_message_skips_a_torn_record)
+{
+    // arrange
+    IOTHUB_MESSAGE_HANDLE message;
+    IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK callback;
+    void* context;
+    FILE* segment;
+    char file_name[64];
+    SPILL_QUEUE_HANDLE spill_queue = spill_queue_create(TEST_DIRECTORY, TEST_MAX_SEGMENT_SIZE);
+    push_test_message(spill_queue, "1");
+    spill_queue_destroy(spill_queue);
+
+    // a crash in the middle of writing a record leaves its first bytes at the end of the segment
+    (void)snprintf(file_name, sizeof(file_name), TEST_SEGMENT_FILE_FORMAT, 0UL);
+    segment = fopen(file_name, "ab");
+    ASSERT_IS_NOT_NULL(segment);
+    (void)fwrite("ISPL", 1, 4, segment);
+    (void)fclose(segment);
+
+    spill_queue = spill_queue_create(TEST_DIRECTORY, TEST_MAX_SEGMENT_SIZE);
+    push_test_message(spill_queue, "2");
+
+    // act
+    // assert
+    read_test_message(spill_queue, "1");
+    read_test_message(spill_queue, "2");
+    ASSERT_ARE_EQUAL(int, 0, spill_queue_read_message(spill_queue, &message, &callback, &context));
+    ASSERT_IS_NULL(message);
+
+    // cleanup
+    spill_queue_destroy(spill_queue);
+}
+
+// Tests_SRS_SPILL_QUEUE_41_013: [Once the current segment holds `max_segment_size` bytes or more, a new segment shall be started]
+// Tests_SRS_SPILL_QUEUE_41_023: [Segments holding only released events shall be deleted]
+TEST_FUNCTION(release_deletes_released_segments)
+{
+    // arrange
+    SPILL_QUEUE_HANDLE spill_queue = spill_queue_create(TEST_DIRECTORY, TEST_SMALL_SEGMENT_SIZE);
+    push_test_message(spill_queue, "1");
+    push_test_message(spill_queue, "2");
+    push_test_message(spill_queue, "3");
+    ASSERT_ARE_EQUAL(size_t, 4, count_segment_files());
+    read_test_message(spill_queue, "1");
+    read_test_message(spill_queue, "2");
+
+    // act
+    ASSERT_ARE_EQUAL(int, 0, spill_queue_release(spill_queue));
+    ASSERT_ARE_EQUAL(int, 0, spill_queue_release(spill_queue));
+
+    // assert
+    // the segment of "2" goes once a later event is released
+    ASSERT_ARE_EQUAL(size_t, 3, count_segment_files());
+
+    // cleanup
+    spill_queue_destroy(spill_queue);
+}
+
+// Tests_SRS_SPILL_QUEUE_41_021: [If `spill_queue` is NULL or no event read is waiting to be released, spill_queue_release shall fail and return non-zero]
+TEST_FUNCTION(release_nothing_read_fails)
+{
+    // arrange
+    SPILL_QUEUE_HANDLE spill_queue = spill_queue_create(TEST_DIRECTORY, TEST_MAX_SEGMENT_SIZE);
+    push_test_message(spill_queue, "1");
+
+    // act
+    int result = spill_queue_release(spill_queue);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+    // cleanup
+    spill_queue_destroy(spill_queue);
+}
+
+// Tests_SRS_SPILL_QUEUE_41_006: [If `spill_queue` is NULL, spill_queue_destroy shall return]
+TEST_FUNCTION(destroy_NULL)
+{
+    // arrange
+    umock_c_reset_all_calls();
+
+    // act
+    spill_queue_destroy(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+END_TEST_SUITE(iothub_client_spill_queue_ut)
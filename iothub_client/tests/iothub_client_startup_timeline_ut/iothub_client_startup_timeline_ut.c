@@ -0,0 +1,468 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#endif
+
+void* real_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+void real_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umock_c_negative_tests.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/tickcounter.h"
+#undef ENABLE_MOCKS
+
+#include "iothub_client_startup_timeline.h"
+#include "internal/iothub_client_startup_timeline_private.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+
+// Data definitions
+
+#define TEST_TICK_COUNTER_HANDLE            (TICK_COUNTER_HANDLE)0x4242
+
+static tickcounter_ms_t g_current_ms;
+
+static LOCK_HANDLE my_Lock_Init(void)
+{
+    return (LOCK_HANDLE)real_malloc(1);
+}
+
+static LOCK_RESULT my_Lock_Deinit(LOCK_HANDLE handle)
+{
+    real_free(handle);
+    return LOCK_OK;
+}
+
+static int my_tickcounter_get_current_ms(TICK_COUNTER_HANDLE tick_counter, tickcounter_ms_t* current_ms)
+{
+    (void)tick_counter;
+    *current_ms = g_current_ms;
+    return 0;
+}
+
+static void start_test_timeline(void)
+{
+    ASSERT_ARE_EQUAL(int, 0, IoTHubClient_StartupTimeline_Start());
+    umock_c_reset_all_calls();
+}
+
+static void mark_test_milestone(IOTHUB_CLIENT_STARTUP_MILESTONE milestone, tickcounter_ms_t ms)
+{
+    g_current_ms = ms;
+    IoTHubClient_StartupTimeline_Mark(milestone);
+    umock_c_reset_all_calls();
+}
+
+static void register_global_mock_hooks(void)
+{
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(TICK_COUNTER_HANDLE, void*);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, real_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, real_free);
+
+    REGISTER_GLOBAL_MOCK_HOOK(Lock_Init, my_Lock_Init);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock_Init, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(Lock_Deinit, my_Lock_Deinit);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock, LOCK_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+
+    REGISTER_GLOBAL_MOCK_RETURN(tickcounter_create, TEST_TICK_COUNTER_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(tickcounter_create, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(tickcounter_get_current_ms, my_tickcounter_get_current_ms);
+}
+
+
+BEGIN_TEST_SUITE(iothub_client_startup_timeline_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    int result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    register_global_mock_hooks();
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    g_current_ms = 0;
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    IoTHubClient_StartupTimeline_Stop();
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_STARTUP_TIMELINE_41_002: [ IoTHubClient_StartupTimeline_Start shall create a lock and a tick counter; if either fails it shall free the other and return a non-zero value. ]
+// Tests_SRS_IOTHUB_CLIENT_STARTUP_TIMELINE_41_003: [ On success IoTHubClient_StartupTimeline_Start shall clear every milestone, start noting them and return 0. ]
+TEST_FUNCTION(IoTHubClient_StartupTimeline_Start_succeeds)
+{
+    // arrange
+    IOTHUB_CLIENT_STARTUP_TIMELINE timeline;
+    size_t index;
+
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(tickcounter_create());
+
+    // act
+    int result = IoTHubClient_StartupTimeline_Start();
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_IS_TRUE(g_iothub_client_startup_timeline_started);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, IoTHubClient_StartupTimeline_Get(&timeline));
+    for (index = 0; index < IOTHUB_CLIENT_STARTUP_MILESTONE_COUNT; index++)
+    {
+        ASSERT_IS_FALSE(timeline.marks[index].reached);
+    }
+}
+
+// Tests_SRS_IOTHUB_CLIENT_STARTUP_TIMELINE_41_002: [ IoTHubClient_StartupTimeline_Start shall create a lock and a tick counter; if either fails it shall free the other and return a non-zero value. ]
+TEST_FUNCTION(IoTHubClient_StartupTimeline_Start_fails_when_a_dependency_fails)
+{
+    // arrange
+    size_t index;
+    ASSERT_ARE_EQUAL(int, 0, umock_c_negative_tests_init());
+
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(tickcounter_create());
+    umock_c_negative_tests_snapshot();
+
+    for (index = 0; index < umock_c_negative_tests_call_count(); index++)
+    {
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(index);
+
+        // act
+        int result = IoTHubClient_StartupTimeline_Start();
+
+        // assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result, "On failed call %lu", (unsigned long)index);
+        ASSERT_IS_FALSE(g_iothub_client_startup_timeline_started);
+    }
+
+    umock_c_negative_tests_deinit();
+
+    // a failed start leaves nothing behind
+    ASSERT_ARE_EQUAL(int, 0, IoTHubClient_StartupTimeline_Start());
+}
+
+// Tests_SRS_IOTHUB_CLIENT_STARTUP_TIMELINE_41_001: [ If the timeline is already started, IoTHubClient_StartupTimeline_Start shall fail and return a non-zero value. ]
+TEST_FUNCTION(IoTHubClient_StartupTimeline_Start_twice_fails)
+{
+    // arrange
+    start_test_timeline();
+
+    // act
+    int result = IoTHubClient_StartupTimeline_Start();
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_IS_TRUE(g_iothub_client_startup_timeline_started);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUB_CLIENT_STARTUP_TIMELINE_41_003: [ On success IoTHubClient_StartupTimeline_Start shall clear every milestone, start noting them and return 0. ]
+TEST_FUNCTION(IoTHubClient_StartupTimeline_Start_after_Stop_clears_the_milestones)
+{
+    // arrange
+    IOTHUB_CLIENT_STARTUP_TIMELINE timeline;
+    start_test_timeline();
+    mark_test_milestone(IOTHUB_CLIENT_STARTUP_CLIENT_CREATED, 10);
+    IoTHubClient_StartupTimeline_Stop();
+
+    // act
+    int result = IoTHubClient_StartupTimeline_Start();
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(int, 0, IoTHubClient_StartupTimeline_Get(&timeline));
+    ASSERT_IS_FALSE(timeline.marks[IOTHUB_CLIENT_STARTUP_CLIENT_CREATED].reached);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_STARTUP_TIMELINE_41_004: [ IoTHubClient_StartupTimeline_Stop shall stop noting the milestones and free the lock and the tick counter; it shall do nothing if the timeline is not started. ]
+TEST_FUNCTION(IoTHubClient_StartupTimeline_Stop_frees_the_timeline)
+{
+    // arrange
+    start_test_timeline();
+
+    STRICT_EXPECTED_CALL(tickcounter_destroy(TEST_TICK_COUNTER_HANDLE));
+    STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG));
+
+    // act
+    IoTHubClient_StartupTimeline_Stop();
+
+    // assert
+    ASSERT_IS_FALSE(g_iothub_client_startup_timeline_started);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUB_CLIENT_STARTUP_TIMELINE_41_004: [ IoTHubClient_StartupTimeline_Stop shall stop noting the milestones and free the lock and the tick counter; it shall do nothing if the timeline is not started. ]
+TEST_FUNCTION(IoTHubClient_StartupTimeline_Stop_not_started_does_nothing)
+{
+    // act
+    IoTHubClient_StartupTimeline_Stop();
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUB_CLIENT_STARTUP_TIMELINE_41_005: [ If the timeline is not started or milestone is not a milestone, IoTHubClient_StartupTimeline_Mark shall do nothing. ]
+TEST_FUNCTION(IoTHubClient_StartupTimeline_Mark_not_started_does_nothing)
+{
+    // act
+    IoTHubClient_StartupTimeline_Mark(IOTHUB_CLIENT_STARTUP_CLIENT_CREATED);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUB_CLIENT_STARTUP_TIMELINE_41_005: [ If the timeline is not started or milestone is not a milestone, IoTHubClient_StartupTimeline_Mark shall do nothing. ]
+TEST_FUNCTION(IoTHubClient_StartupTimeline_Mark_invalid_milestone_does_nothing)
+{
+    // arrange
+    start_test_timeline();
+
+    // act
+    IoTHubClient_StartupTimeline_Mark((IOTHUB_CLIENT_STARTUP_MILESTONE)IOTHUB_CLIENT_STARTUP_MILESTONE_COUNT);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUB_CLIENT_STARTUP_TIMELINE_41_007: [ IoTHubClient_StartupTimeline_Mark shall note milestone as reached at the milliseconds since IoTHubClient_StartupTimeline_Start. ]
+TEST_FUNCTION(IoTHubClient_StartupTimeline_Mark_notes_the_milestone)
+{
+    // arrange
+    IOTHUB_CLIENT_STARTUP_TIMELINE timeline;
+    start_test_timeline();
+    g_current_ms = 1234;
+
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    // act
+    IoTHubClient_StartupTimeline_Mark(IOTHUB_CLIENT_STARTUP_AUTHENTICATED);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, IoTHubClient_StartupTimeline_Get(&timeline));
+    ASSERT_IS_TRUE(timeline.marks[IOTHUB_CLIENT_STARTUP_AUTHENTICATED].reached);
+    ASSERT_ARE_EQUAL(uint32_t, 1234, timeline.marks[IOTHUB_CLIENT_STARTUP_AUTHENTICATED].ms);
+    ASSERT_IS_FALSE(timeline.marks[IOTHUB_CLIENT_STARTUP_CONNECT_STARTED].reached);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_STARTUP_TIMELINE_41_006: [ If milestone was already reached, IoTHubClient_StartupTimeline_Mark shall do nothing. ]
+TEST_FUNCTION(IoTHubClient_StartupTimeline_Mark_keeps_the_first_time)
+{
+    // arrange
+    IOTHUB_CLIENT_STARTUP_TIMELINE timeline;
+    start_test_timeline();
+    mark_test_milestone(IOTHUB_CLIENT_STARTUP_SUBSCRIBED, 100);
+    g_current_ms = 200;
+
+    // act
+    IoTHubClient_StartupTimeline_Mark(IOTHUB_CLIENT_STARTUP_SUBSCRIBED);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, IoTHubClient_StartupTimeline_Get(&timeline));
+    ASSERT_ARE_EQUAL(uint32_t, 100, timeline.marks[IOTHUB_CLIENT_STARTUP_SUBSCRIBED].ms);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_STARTUP_TIMELINE_41_007: [ IoTHubClient_StartupTimeline_Mark shall note milestone as reached at the milliseconds since IoTHubClient_StartupTimeline_Start. ]
+TEST_FUNCTION(IoTHubClient_StartupTimeline_Mark_tickcounter_fails_notes_nothing)
+{
+    // arrange
+    IOTHUB_CLIENT_STARTUP_TIMELINE timeline;
+    start_test_timeline();
+
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG)).SetReturn(__LINE__);
+
+    // act
+    IoTHubClient_StartupTimeline_Mark(IOTHUB_CLIENT_STARTUP_TWIN_RECEIVED);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, IoTHubClient_StartupTimeline_Get(&timeline));
+    ASSERT_IS_FALSE(timeline.marks[IOTHUB_CLIENT_STARTUP_TWIN_RECEIVED].reached);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_STARTUP_TIMELINE_41_008: [ If timeline is NULL or the timeline is not started, IoTHubClient_StartupTimeline_Get shall fail and return a non-zero value. ]
+TEST_FUNCTION(IoTHubClient_StartupTimeline_Get_NULL_timeline_fails)
+{
+    // arrange
+    start_test_timeline();
+
+    // act
+    int result = IoTHubClient_StartupTimeline_Get(NULL);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUB_CLIENT_STARTUP_TIMELINE_41_008: [ If timeline is NULL or the timeline is not started, IoTHubClient_StartupTimeline_Get shall fail and return a non-zero value. ]
+TEST_FUNCTION(IoTHubClient_StartupTimeline_Get_not_started_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_STARTUP_TIMELINE timeline;
+
+    // act
+    int result = IoTHubClient_StartupTimeline_Get(&timeline);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUB_CLIENT_STARTUP_TIMELINE_41_009: [ IoTHubClient_StartupTimeline_Get shall copy every milestone to timeline and return 0. ]
+TEST_FUNCTION(IoTHubClient_StartupTimeline_Get_Lock_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_STARTUP_TIMELINE timeline;
+    start_test_timeline();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).SetReturn(LOCK_ERROR);
+
+    // act
+    int result = IoTHubClient_StartupTimeline_Get(&timeline);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUB_CLIENT_STARTUP_TIMELINE_41_010: [ If the timeline cannot be got, IoTHubClient_StartupTimeline_ToJson shall return NULL. ]
+TEST_FUNCTION(IoTHubClient_StartupTimeline_ToJson_not_started_returns_NULL)
+{
+    // act
+    char* result = IoTHubClient_StartupTimeline_ToJson();
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUB_CLIENT_STARTUP_TIMELINE_41_011: [ If allocating the JSON fails, IoTHubClient_StartupTimeline_ToJson shall return NULL. ]
+TEST_FUNCTION(IoTHubClient_StartupTimeline_ToJson_malloc_fails_returns_NULL)
+{
+    // arrange
+    start_test_timeline();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)).SetReturn(NULL);
+
+    // act
+    char* result = IoTHubClient_StartupTimeline_ToJson();
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUB_CLIENT_STARTUP_TIMELINE_41_012: [ IoTHubClient_StartupTimeline_ToJson shall return a JSON object with, in milestone order, the name of every milestone reached without its IOTHUB_CLIENT_STARTUP_ prefix and its milliseconds. ]
+TEST_FUNCTION(IoTHubClient_StartupTimeline_ToJson_nothing_reached_is_empty)
+{
+    // arrange
+    start_test_timeline();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+
+    // act
+    char* result = IoTHubClient_StartupTimeline_ToJson();
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, "{}", result);
+
+    // cleanup
+    free(result);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_STARTUP_TIMELINE_41_012: [ IoTHubClient_StartupTimeline_ToJson shall return a JSON object with, in milestone order, the name of every milestone reached without its IOTHUB_CLIENT_STARTUP_ prefix and its milliseconds. ]
+TEST_FUNCTION(IoTHubClient_StartupTimeline_ToJson_lists_reached_milestones_in_order)
+{
+    // arrange
+    start_test_timeline();
+    mark_test_milestone(IOTHUB_CLIENT_STARTUP_FIRST_EVENT_CONFIRMED, 2500);
+    mark_test_milestone(IOTHUB_CLIENT_STARTUP_CLIENT_CREATE_STARTED, 0);
+    mark_test_milestone(IOTHUB_CLIENT_STARTUP_AUTHENTICATED, 1200);
+
+    // act
+    char* result = IoTHubClient_StartupTimeline_ToJson();
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, "{\"CLIENT_CREATE_STARTED\":0,\"AUTHENTICATED\":1200,\"FIRST_EVENT_CONFIRMED\":2500}", result);
+
+    // cleanup
+    free(result);
+}
+
+END_TEST_SUITE(iothub_client_startup_timeline_ut)
@@ -0,0 +1,505 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <cstring>
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#endif
+
+#if defined _MSC_VER
+#pragma warning(disable: 4054) /* MSC incorrectly fires this */
+#endif
+
+void* real_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+void real_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umock_c_negative_tests.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+#include "umocktypes_bool.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "iothub_message.h"
+#undef ENABLE_MOCKS
+
+#include "internal/iothub_client_telemetry_aggregation.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+
+// Data definitions
+
+#define TEST_OUTPUT_NAME                    "temperature"
+#define TEST_OTHER_OUTPUT_NAME              "pressure"
+#define TEST_WINDOW_MS                      1000
+#define TEST_MAX_PENDING_WINDOWS            2
+#define TEST_MAX_SENT_EVENTS                8
+#define TEST_CALLBACK_CONTEXT               (void*)0x7772
+
+
+// Fake messages, holding just what the aggregation writes
+
+typedef struct TEST_MESSAGE_TAG
+{
+    char* payload;
+    char* content_type;
+    char* content_encoding;
+    char* output_name;
+} TEST_MESSAGE;
+
+static char* copy_string(const char* value)
+{
+    char* result = (char*)real_malloc(strlen(value) + 1);
+    ASSERT_IS_NOT_NULL(result);
+    (void)strcpy(result, value);
+    return result;
+}
+
+static IOTHUB_MESSAGE_HANDLE TEST_IoTHubMessage_CreateFromByteArray(const unsigned char* byteArray, size_t size)
+{
+    TEST_MESSAGE* message = (TEST_MESSAGE*)real_malloc(sizeof(TEST_MESSAGE));
+    ASSERT_IS_NOT_NULL(message);
+    (void)memset(message, 0, sizeof(TEST_MESSAGE));
+    message->payload = (char*)real_malloc(size + 1);
+    ASSERT_IS_NOT_NULL(message->payload);
+    (void)memcpy(message->payload, byteArray, size);
+    message->payload[size] = '\0';
+    return (IOTHUB_MESSAGE_HANDLE)message;
+}
+
+static void TEST_IoTHubMessage_Destroy(IOTHUB_MESSAGE_HANDLE handle)
+{
+    TEST_MESSAGE* message = (TEST_MESSAGE*)handle;
+    real_free(message->payload);
+    real_free(message->content_type);
+    real_free(message->content_encoding);
+    real_free(message->output_name);
+    real_free(message);
+}
+
+static IOTHUB_MESSAGE_RESULT TEST_IoTHubMessage_SetContentTypeSystemProperty(IOTHUB_MESSAGE_HANDLE handle, const char* value)
+{
+    ((TEST_MESSAGE*)handle)->content_type = copy_string(value);
+    return IOTHUB_MESSAGE_OK;
+}
+
+static IOTHUB_MESSAGE_RESULT TEST_IoTHubMessage_SetContentEncodingSystemProperty(IOTHUB_MESSAGE_HANDLE handle, const char* value)
+{
+    ((TEST_MESSAGE*)handle)->content_encoding = copy_string(value);
+    return IOTHUB_MESSAGE_OK;
+}
+
+static IOTHUB_MESSAGE_RESULT TEST_IoTHubMessage_SetOutputName(IOTHUB_MESSAGE_HANDLE handle, const char* value)
+{
+    ((TEST_MESSAGE*)handle)->output_name = copy_string(value);
+    return IOTHUB_MESSAGE_OK;
+}
+
+
+// The send callback keeps the events it takes, until g_send_result makes it refuse them
+
+static TEST_MESSAGE* g_sent_events[TEST_MAX_SENT_EVENTS];
+static size_t g_sent_event_count;
+static int g_send_result;
+static void* g_send_context;
+
+static int test_send(IOTHUB_MESSAGE_HANDLE message, void* context)
+{
+    g_send_context = context;
+    if (g_send_result == 0)
+    {
+        ASSERT_IS_TRUE(g_sent_event_count < TEST_MAX_SENT_EVENTS);
+        g_sent_events[g_sent_event_count++] = (TEST_MESSAGE*)message;
+    }
+    return g_send_result;
+}
+
+static void destroy_sent_events(void)
+{
+    size_t i;
+    for (i = 0; i < g_sent_event_count; i++)
+    {
+        TEST_IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)g_sent_events[i]);
+    }
+    g_sent_event_count = 0;
+}
+
+static IOTHUB_CLIENT_TELEMETRY_AGGREGATION get_test_configuration(void)
+{
+    IOTHUB_CLIENT_TELEMETRY_AGGREGATION configuration;
+    (void)memset(&configuration, 0, sizeof(configuration));
+    configuration.output_name = TEST_OUTPUT_NAME;
+    configuration.window_ms = TEST_WINDOW_MS;
+    configuration.max_pending_windows = TEST_MAX_PENDING_WINDOWS;
+    configuration.anomaly_low = -10.0;
+    configuration.anomaly_high = 100.0;
+    return configuration;
+}
+
+static TELEMETRY_AGGREGATION_HANDLE create_configured_aggregation(const IOTHUB_CLIENT_TELEMETRY_AGGREGATION* configuration)
+{
+    TELEMETRY_AGGREGATION_HANDLE aggregation = telemetry_aggregation_create();
+    ASSERT_IS_NOT_NULL(aggregation);
+    ASSERT_ARE_EQUAL(int, 0, telemetry_aggregation_configure(aggregation, configuration));
+    return aggregation;
+}
+
+static void register_global_mock_hooks(void)
+{
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, real_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, real_free);
+
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_CreateFromByteArray, TEST_IoTHubMessage_CreateFromByteArray);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubMessage_CreateFromByteArray, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_Destroy, TEST_IoTHubMessage_Destroy);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_SetContentTypeSystemProperty, TEST_IoTHubMessage_SetContentTypeSystemProperty);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_SetContentEncodingSystemProperty, TEST_IoTHubMessage_SetContentEncodingSystemProperty);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_SetOutputName, TEST_IoTHubMessage_SetOutputName);
+}
+
+static void register_umock_alias_types(void)
+{
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_RESULT, int);
+}
+
+
+BEGIN_TEST_SUITE(iothub_client_telemetry_aggregation_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    int result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_bool_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    register_umock_alias_types();
+    register_global_mock_hooks();
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+    g_sent_event_count = 0;
+    g_send_result = 0;
+    g_send_context = NULL;
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    destroy_sent_events();
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+
+// Tests_SRS_TELEMETRY_AGGREGATION_41_001: [telemetry_aggregation_create shall return a new aggregation without any stage, or NULL if it cannot be allocated]
+TEST_FUNCTION(create_malloc_fails)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .SetReturn(NULL);
+
+    // act
+    TELEMETRY_AGGREGATION_HANDLE aggregation = telemetry_aggregation_create();
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(aggregation);
+}
+
+// Tests_SRS_TELEMETRY_AGGREGATION_41_003: [If `aggregation` or `configuration` is NULL, telemetry_aggregation_configure shall fail and return a non-zero value]
+TEST_FUNCTION(configure_NULL_configuration_fails)
+{
+    // arrange
+    TELEMETRY_AGGREGATION_HANDLE aggregation = telemetry_aggregation_create();
+    umock_c_reset_all_calls();
+
+    // act
+    int result = telemetry_aggregation_configure(aggregation, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+    // cleanup
+    telemetry_aggregation_destroy(aggregation);
+}
+
+// Tests_SRS_TELEMETRY_AGGREGATION_41_005: [Otherwise telemetry_aggregation_configure shall create a stage for `output_name` with a ring of `max_pending_windows` closed windows (1 if it is 0), replacing any stage of `output_name`, and fail leaving the previous stage in place if it cannot be allocated]
+TEST_FUNCTION(configure_malloc_fails_keeps_the_previous_stage)
+{
+    // arrange
+    IOTHUB_CLIENT_TELEMETRY_AGGREGATION configuration = get_test_configuration();
+    TELEMETRY_AGGREGATION_HANDLE aggregation = create_configured_aggregation(&configuration);
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .SetReturn(NULL);
+
+    // act
+    int result = telemetry_aggregation_configure(aggregation, &configuration);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(int, 0, telemetry_aggregation_add_sample(aggregation, TEST_OUTPUT_NAME, 0, 1.0, test_send, TEST_CALLBACK_CONTEXT));
+
+    // cleanup
+    telemetry_aggregation_destroy(aggregation);
+}
+
+// Tests_SRS_TELEMETRY_AGGREGATION_41_004: [If `window_ms` is 0, telemetry_aggregation_configure shall remove the stage of `output_name`, if any, dropping its windows not sent yet, and succeed]
+// Tests_SRS_TELEMETRY_AGGREGATION_41_006: [If `aggregation` or `send` is NULL, or no stage has `output_name`, telemetry_aggregation_add_sample shall fail and return a non-zero value]
+TEST_FUNCTION(configure_zero_window_removes_the_stage)
+{
+    // arrange
+    IOTHUB_CLIENT_TELEMETRY_AGGREGATION configuration = get_test_configuration();
+    TELEMETRY_AGGREGATION_HANDLE aggregation = create_configured_aggregation(&configuration);
+    ASSERT_ARE_EQUAL(int, 0, telemetry_aggregation_add_sample(aggregation, TEST_OUTPUT_NAME, 0, 1.0, test_send, TEST_CALLBACK_CONTEXT));
+    configuration.window_ms = 0;
+
+    // act
+    int result = telemetry_aggregation_configure(aggregation, &configuration);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_NOT_EQUAL(int, 0, telemetry_aggregation_add_sample(aggregation, TEST_OUTPUT_NAME, 0, 1.0, test_send, TEST_CALLBACK_CONTEXT));
+    telemetry_aggregation_flush(aggregation, 2 * TEST_WINDOW_MS, test_send, TEST_CALLBACK_CONTEXT);
+    ASSERT_ARE_EQUAL(size_t, 0, g_sent_event_count);
+
+    // cleanup
+    telemetry_aggregation_destroy(aggregation);
+}
+
+// Tests_SRS_TELEMETRY_AGGREGATION_41_006: [If `aggregation` or `send` is NULL, or no stage has `output_name`, telemetry_aggregation_add_sample shall fail and return a non-zero value]
+TEST_FUNCTION(add_sample_unknown_output_name_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_TELEMETRY_AGGREGATION configuration = get_test_configuration();
+    TELEMETRY_AGGREGATION_HANDLE aggregation = create_configured_aggregation(&configuration);
+    umock_c_reset_all_calls();
+
+    // act
+    int result = telemetry_aggregation_add_sample(aggregation, TEST_OTHER_OUTPUT_NAME, 0, 1.0, test_send, TEST_CALLBACK_CONTEXT);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_NOT_EQUAL(int, 0, telemetry_aggregation_add_sample(aggregation, NULL, 0, 1.0, test_send, TEST_CALLBACK_CONTEXT));
+
+    // cleanup
+    telemetry_aggregation_destroy(aggregation);
+}
+
+// Tests_SRS_TELEMETRY_AGGREGATION_41_007: [telemetry_aggregation_add_sample shall close the open window if `window_ms` have passed since its first sample, then fold `value` into the open window, opening one at `now` if there is none]
+// Tests_SRS_TELEMETRY_AGGREGATION_41_010: [The event of a window shall be a JSON object holding its count, min, max and mean, the window length and the windows dropped since the last event, with content type application/json and the output name of its stage]
+// Tests_SRS_TELEMETRY_AGGREGATION_41_012: [telemetry_aggregation_flush shall hand the event of every closed window to `send`, oldest first, and keep a window and the ones after it in the same stage if its event cannot be built or is not taken]
+TEST_FUNCTION(flush_sends_one_event_per_window)
+{
+    // arrange
+    IOTHUB_CLIENT_TELEMETRY_AGGREGATION configuration = get_test_configuration();
+    TELEMETRY_AGGREGATION_HANDLE aggregation = create_configured_aggregation(&configuration);
+    ASSERT_ARE_EQUAL(int, 0, telemetry_aggregation_add_sample(aggregation, TEST_OUTPUT_NAME, 100, 1.0, test_send, TEST_CALLBACK_CONTEXT));
+    ASSERT_ARE_EQUAL(int, 0, telemetry_aggregation_add_sample(aggregation, TEST_OUTPUT_NAME, 500, 4.0, test_send, TEST_CALLBACK_CONTEXT));
+    ASSERT_ARE_EQUAL(int, 0, telemetry_aggregation_add_sample(aggregation, TEST_OUTPUT_NAME, 900, 7.0, test_send, TEST_CALLBACK_CONTEXT));
+    ASSERT_ARE_EQUAL(int, 0, telemetry_aggregation_add_sample(aggregation, TEST_OUTPUT_NAME, 1100, 2.0, test_send, TEST_CALLBACK_CONTEXT));
+    ASSERT_ARE_EQUAL(size_t, 0, g_sent_event_count);
+
+    // act
+    telemetry_aggregation_flush(aggregation, 1200, test_send, TEST_CALLBACK_CONTEXT);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, g_sent_event_count);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_CALLBACK_CONTEXT, g_send_context);
+    ASSERT_ARE_EQUAL(char_ptr, "{\"count\":3,\"min\":1,\"max\":7,\"mean\":4,\"windowMs\":1000,\"droppedWindows\":0}", g_sent_events[0]->payload);
+    ASSERT_ARE_EQUAL(char_ptr, "application%2Fjson", g_sent_events[0]->content_type);
+    ASSERT_ARE_EQUAL(char_ptr, "utf-8", g_sent_events[0]->content_encoding);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_OUTPUT_NAME, g_sent_events[0]->output_name);
+
+    // cleanup
+    telemetry_aggregation_destroy(aggregation);
+}
+
+// Tests_SRS_TELEMETRY_AGGREGATION_41_011: [telemetry_aggregation_flush shall close the open window of every stage if `window_ms` have passed since its first sample]
+TEST_FUNCTION(flush_closes_the_ended_windows_of_every_stage)
+{
+    // arrange
+    IOTHUB_CLIENT_TELEMETRY_AGGREGATION configuration = get_test_configuration();
+    TELEMETRY_AGGREGATION_HANDLE aggregation = create_configured_aggregation(&configuration);
+    configuration.output_name = NULL;
+    ASSERT_ARE_EQUAL(int, 0, telemetry_aggregation_configure(aggregation, &configuration));
+    ASSERT_ARE_EQUAL(int, 0, telemetry_aggregation_add_sample(aggregation, TEST_OUTPUT_NAME, 0, 1.0, test_send, TEST_CALLBACK_CONTEXT));
+    ASSERT_ARE_EQUAL(int, 0, telemetry_aggregation_add_sample(aggregation, NULL, 500, 2.0, test_send, TEST_CALLBACK_CONTEXT));
+
+    // act
+    telemetry_aggregation_flush(aggregation, TEST_WINDOW_MS, test_send, TEST_CALLBACK_CONTEXT);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, g_sent_event_count);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_OUTPUT_NAME, g_sent_events[0]->output_name);
+    telemetry_aggregation_flush(aggregation, 500 + TEST_WINDOW_MS, test_send, TEST_CALLBACK_CONTEXT);
+    ASSERT_ARE_EQUAL(size_t, 2, g_sent_event_count);
+    ASSERT_IS_NULL(g_sent_events[1]->output_name);
+
+    // cleanup
+    telemetry_aggregation_destroy(aggregation);
+}
+
+// Tests_SRS_TELEMETRY_AGGREGATION_41_012: [telemetry_aggregation_flush shall hand the event of every closed window to `send`, oldest first, and keep a window and the ones after it in the same stage if its event cannot be built or is not taken]
+TEST_FUNCTION(flush_keeps_the_windows_not_taken)
+{
+    // arrange
+    IOTHUB_CLIENT_TELEMETRY_AGGREGATION configuration = get_test_configuration();
+    TELEMETRY_AGGREGATION_HANDLE aggregation = create_configured_aggregation(&configuration);
+    ASSERT_ARE_EQUAL(int, 0, telemetry_aggregation_add_sample(aggregation, TEST_OUTPUT_NAME, 0, 1.0, test_send, TEST_CALLBACK_CONTEXT));
+    ASSERT_ARE_EQUAL(int, 0, telemetry_aggregation_add_sample(aggregation, TEST_OUTPUT_NAME, 1000, 2.0, test_send, TEST_CALLBACK_CONTEXT));
+    g_send_result = __LINE__;
+    telemetry_aggregation_flush(aggregation, 2000, test_send, TEST_CALLBACK_CONTEXT);
+    ASSERT_ARE_EQUAL(size_t, 0, g_sent_event_count);
+    g_send_result = 0;
+
+    // act
+    telemetry_aggregation_flush(aggregation, 2000, test_send, TEST_CALLBACK_CONTEXT);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 2, g_sent_event_count);
+    ASSERT_ARE_EQUAL(char_ptr, "{\"count\":1,\"min\":1,\"max\":1,\"mean\":1,\"windowMs\":1000,\"droppedWindows\":0}", g_sent_events[0]->payload);
+    ASSERT_ARE_EQUAL(char_ptr, "{\"count\":1,\"min\":2,\"max\":2,\"mean\":2,\"windowMs\":1000,\"droppedWindows\":0}", g_sent_events[1]->payload);
+
+    // cleanup
+    telemetry_aggregation_destroy(aggregation);
+}
+
+// Tests_SRS_TELEMETRY_AGGREGATION_41_008: [If the ring of closed windows is full, the oldest closed window shall be dropped and counted in the next event sent]
+TEST_FUNCTION(add_sample_full_ring_drops_the_oldest_window)
+{
+    // arrange
+    IOTHUB_CLIENT_TELEMETRY_AGGREGATION configuration = get_test_configuration();
+    TELEMETRY_AGGREGATION_HANDLE aggregation = create_configured_aggregation(&configuration);
+    ASSERT_ARE_EQUAL(int, 0, telemetry_aggregation_add_sample(aggregation, TEST_OUTPUT_NAME, 0, 1.0, test_send, TEST_CALLBACK_CONTEXT));
+    ASSERT_ARE_EQUAL(int, 0, telemetry_aggregation_add_sample(aggregation, TEST_OUTPUT_NAME, 1000, 2.0, test_send, TEST_CALLBACK_CONTEXT));
+    ASSERT_ARE_EQUAL(int, 0, telemetry_aggregation_add_sample(aggregation, TEST_OUTPUT_NAME, 2000, 3.0, test_send, TEST_CALLBACK_CONTEXT));
+
+    // act
+    int result = telemetry_aggregation_add_sample(aggregation, TEST_OUTPUT_NAME, 3000, 4.0, test_send, TEST_CALLBACK_CONTEXT);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    telemetry_aggregation_flush(aggregation, 3000, test_send, TEST_CALLBACK_CONTEXT);
+    ASSERT_ARE_EQUAL(size_t, 2, g_sent_event_count);
+    ASSERT_ARE_EQUAL(char_ptr, "{\"count\":1,\"min\":2,\"max\":2,\"mean\":2,\"windowMs\":1000,\"droppedWindows\":1}", g_sent_events[0]->payload);
+    ASSERT_ARE_EQUAL(char_ptr, "{\"count\":1,\"min\":3,\"max\":3,\"mean\":3,\"windowMs\":1000,\"droppedWindows\":0}", g_sent_events[1]->payload);
+
+    // cleanup
+    telemetry_aggregation_destroy(aggregation);
+}
+
+// Tests_SRS_TELEMETRY_AGGREGATION_41_009: [If the stage forwards anomalies and `value` is below `anomaly_low` or above `anomaly_high`, telemetry_aggregation_add_sample shall hand an event holding `value` to `send`, and fail if it cannot be built or is not taken]
+TEST_FUNCTION(add_sample_forwards_an_anomaly)
+{
+    // arrange
+    IOTHUB_CLIENT_TELEMETRY_AGGREGATION configuration = get_test_configuration();
+    TELEMETRY_AGGREGATION_HANDLE aggregation;
+    configuration.forward_anomalies = true;
+    aggregation = create_configured_aggregation(&configuration);
+
+    // act
+    int result = telemetry_aggregation_add_sample(aggregation, TEST_OUTPUT_NAME, 0, 150.0, test_send, TEST_CALLBACK_CONTEXT);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 1, g_sent_event_count);
+    ASSERT_ARE_EQUAL(char_ptr, "{\"value\":150,\"anomaly\":true}", g_sent_events[0]->payload);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_OUTPUT_NAME, g_sent_events[0]->output_name);
+
+    // cleanup
+    telemetry_aggregation_destroy(aggregation);
+}
+
+// Tests_SRS_TELEMETRY_AGGREGATION_41_009: [If the stage forwards anomalies and `value` is below `anomaly_low` or above `anomaly_high`, telemetry_aggregation_add_sample shall hand an event holding `value` to `send`, and fail if it cannot be built or is not taken]
+TEST_FUNCTION(add_sample_anomaly_not_taken_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_TELEMETRY_AGGREGATION configuration = get_test_configuration();
+    TELEMETRY_AGGREGATION_HANDLE aggregation;
+    configuration.forward_anomalies = true;
+    aggregation = create_configured_aggregation(&configuration);
+    g_send_result = __LINE__;
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(IoTHubMessage_CreateFromByteArray(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_SetContentTypeSystemProperty(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_SetContentEncodingSystemProperty(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_SetOutputName(IGNORED_PTR_ARG, TEST_OUTPUT_NAME));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(IGNORED_PTR_ARG));
+
+    // act
+    int result = telemetry_aggregation_add_sample(aggregation, TEST_OUTPUT_NAME, 0, -20.0, test_send, TEST_CALLBACK_CONTEXT);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+    // cleanup
+    telemetry_aggregation_destroy(aggregation);
+}
+
+// Tests_SRS_TELEMETRY_AGGREGATION_41_002: [telemetry_aggregation_destroy shall free all the stages, dropping the windows not sent yet; it shall do nothing if `aggregation` is NULL]
+TEST_FUNCTION(destroy_NULL)
+{
+    // arrange
+    umock_c_reset_all_calls();
+
+    // act
+    telemetry_aggregation_destroy(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+END_TEST_SUITE(iothub_client_telemetry_aggregation_ut)
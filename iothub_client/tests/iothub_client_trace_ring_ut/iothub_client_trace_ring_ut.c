@@ -0,0 +1,391 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#endif
+
+void* real_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+void real_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umock_c_negative_tests.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/tickcounter.h"
+#undef ENABLE_MOCKS
+
+#include "iothub_client_trace_ring.h"
+#include "internal/iothub_client_trace_ring_private.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+
+// Data definitions
+
+#define TEST_TICK_COUNTER_HANDLE            (TICK_COUNTER_HANDLE)0x4242
+#define TEST_RECORD_COUNT                   4
+#define TEST_SOURCE                         ((const void*)0x1234)
+
+static tickcounter_ms_t g_current_ms;
+
+static LOCK_HANDLE my_Lock_Init(void)
+{
+    return (LOCK_HANDLE)real_malloc(1);
+}
+
+static LOCK_RESULT my_Lock_Deinit(LOCK_HANDLE handle)
+{
+    real_free(handle);
+    return LOCK_OK;
+}
+
+static int my_tickcounter_get_current_ms(TICK_COUNTER_HANDLE tick_counter, tickcounter_ms_t* current_ms)
+{
+    (void)tick_counter;
+    *current_ms = g_current_ms;
+    return 0;
+}
+
+static void start_test_ring(void)
+{
+    ASSERT_ARE_EQUAL(int, 0, IoTHubClient_TraceRing_Start(TEST_RECORD_COUNT));
+    umock_c_reset_all_calls();
+}
+
+static void record_test_events(uint32_t first_value, size_t count)
+{
+    size_t index;
+    for (index = 0; index < count; index++)
+    {
+        g_current_ms = 10 * (first_value + index);
+        IoTHubClient_TraceRing_Record(IOTHUB_CLIENT_TRACE_MQTT_PUBLISH, TEST_SOURCE, (uint32_t)(first_value + index), 0);
+    }
+    umock_c_reset_all_calls();
+}
+
+static void register_global_mock_hooks(void)
+{
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(TICK_COUNTER_HANDLE, void*);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, real_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, real_free);
+
+    REGISTER_GLOBAL_MOCK_HOOK(Lock_Init, my_Lock_Init);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock_Init, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(Lock_Deinit, my_Lock_Deinit);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock, LOCK_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+
+    REGISTER_GLOBAL_MOCK_RETURN(tickcounter_create, TEST_TICK_COUNTER_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(tickcounter_create, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(tickcounter_get_current_ms, my_tickcounter_get_current_ms);
+}
+
+
+BEGIN_TEST_SUITE(iothub_client_trace_ring_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    int result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    register_global_mock_hooks();
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    g_current_ms = 0;
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    IoTHubClient_TraceRing_Stop();
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_TRACE_RING_41_001: [ If record_count is 0 or does not fit the dump format, IoTHubClient_TraceRing_Start shall fail and return a non-zero value. ]
+TEST_FUNCTION(IoTHubClient_TraceRing_Start_zero_records_fails)
+{
+    // act
+    int result = IoTHubClient_TraceRing_Start(0);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_IS_FALSE(g_iothub_client_trace_ring_started);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUB_CLIENT_TRACE_RING_41_003: [ IoTHubClient_TraceRing_Start shall allocate the ring and its records in one block starting with IOTHUB_CLIENT_TRACE_RING_MAGIC, and create a lock and a tick counter; if any of them fails it shall free the others and return a non-zero value. ]
+// Tests_SRS_IOTHUB_CLIENT_TRACE_RING_41_004: [ On success IoTHubClient_TraceRing_Start shall start tracing and return 0. ]
+TEST_FUNCTION(IoTHubClient_TraceRing_Start_succeeds)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(tickcounter_create());
+
+    // act
+    int result = IoTHubClient_TraceRing_Start(TEST_RECORD_COUNT);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_IS_TRUE(g_iothub_client_trace_ring_started);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUB_CLIENT_TRACE_RING_41_003: [ IoTHubClient_TraceRing_Start shall allocate the ring and its records in one block starting with IOTHUB_CLIENT_TRACE_RING_MAGIC, and create a lock and a tick counter; if any of them fails it shall free the others and return a non-zero value. ]
+TEST_FUNCTION(IoTHubClient_TraceRing_Start_fails_when_a_dependency_fails)
+{
+    // arrange
+    size_t index;
+    ASSERT_ARE_EQUAL(int, 0, umock_c_negative_tests_init());
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(tickcounter_create());
+    umock_c_negative_tests_snapshot();
+
+    for (index = 0; index < umock_c_negative_tests_call_count(); index++)
+    {
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(index);
+
+        // act
+        int result = IoTHubClient_TraceRing_Start(TEST_RECORD_COUNT);
+
+        // assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result, "On failed call %lu", (unsigned long)index);
+        ASSERT_IS_FALSE(g_iothub_client_trace_ring_started);
+    }
+
+    umock_c_negative_tests_deinit();
+
+    // a failed start leaves nothing behind
+    ASSERT_ARE_EQUAL(int, 0, IoTHubClient_TraceRing_Start(TEST_RECORD_COUNT));
+}
+
+// Tests_SRS_IOTHUB_CLIENT_TRACE_RING_41_002: [ If tracing is already started, IoTHubClient_TraceRing_Start shall fail and return a non-zero value. ]
+TEST_FUNCTION(IoTHubClient_TraceRing_Start_twice_fails)
+{
+    // arrange
+    start_test_ring();
+
+    // act
+    int result = IoTHubClient_TraceRing_Start(TEST_RECORD_COUNT);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_IS_TRUE(g_iothub_client_trace_ring_started);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUB_CLIENT_TRACE_RING_41_005: [ IoTHubClient_TraceRing_Stop shall stop tracing and free the ring, its lock and its tick counter; it shall do nothing if tracing is not started. ]
+TEST_FUNCTION(IoTHubClient_TraceRing_Stop_frees_the_ring)
+{
+    // arrange
+    start_test_ring();
+
+    STRICT_EXPECTED_CALL(tickcounter_destroy(TEST_TICK_COUNTER_HANDLE));
+    STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    IoTHubClient_TraceRing_Stop();
+
+    // assert
+    ASSERT_IS_FALSE(g_iothub_client_trace_ring_started);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUB_CLIENT_TRACE_RING_41_005: [ IoTHubClient_TraceRing_Stop shall stop tracing and free the ring, its lock and its tick counter; it shall do nothing if tracing is not started. ]
+TEST_FUNCTION(IoTHubClient_TraceRing_Stop_not_started_does_nothing)
+{
+    // act
+    IoTHubClient_TraceRing_Stop();
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUB_CLIENT_TRACE_RING_41_006: [ If tracing is not started, IoTHubClient_TraceRing_Record shall do nothing. ]
+TEST_FUNCTION(IoTHubClient_TraceRing_Record_not_started_does_nothing)
+{
+    // act
+    IoTHubClient_TraceRing_Record(IOTHUB_CLIENT_TRACE_MQTT_CONNECT, TEST_SOURCE, 0, 0);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUB_CLIENT_TRACE_RING_41_007: [ IoTHubClient_TraceRing_Record shall write event, source folded to 32 bits, value1, value2 and the milliseconds since IoTHubClient_TraceRing_Start over the oldest record of the ring. ]
+TEST_FUNCTION(IoTHubClient_TraceRing_Record_writes_a_record)
+{
+    // arrange
+    IOTHUB_CLIENT_TRACE_RECORD record;
+    start_test_ring();
+    g_current_ms = 1234;
+
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    // act
+    IoTHubClient_TraceRing_Record(IOTHUB_CLIENT_TRACE_CONNECTION_STATUS, TEST_SOURCE, 1, 2);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 1, IoTHubClient_TraceRing_Dump(&record, 1));
+    ASSERT_ARE_EQUAL(uint32_t, 1234, record.ms);
+    ASSERT_ARE_EQUAL(uint32_t, (uint32_t)IOTHUB_CLIENT_TRACE_CONNECTION_STATUS, record.event);
+    ASSERT_ARE_EQUAL(uint32_t, 0x1234, record.source);
+    ASSERT_ARE_EQUAL(uint32_t, 1, record.value1);
+    ASSERT_ARE_EQUAL(uint32_t, 2, record.value2);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_TRACE_RING_41_007: [ IoTHubClient_TraceRing_Record shall write event, source folded to 32 bits, value1, value2 and the milliseconds since IoTHubClient_TraceRing_Start over the oldest record of the ring. ]
+TEST_FUNCTION(IoTHubClient_TraceRing_Record_tickcounter_fails_writes_nothing)
+{
+    // arrange
+    IOTHUB_CLIENT_TRACE_RECORD record;
+    start_test_ring();
+
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG)).SetReturn(__LINE__);
+
+    // act
+    IoTHubClient_TraceRing_Record(IOTHUB_CLIENT_TRACE_CONNECTION_STATUS, TEST_SOURCE, 1, 2);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 0, IoTHubClient_TraceRing_Dump(&record, 1));
+}
+
+// Tests_SRS_IOTHUB_CLIENT_TRACE_RING_41_007: [ IoTHubClient_TraceRing_Record shall write event, source folded to 32 bits, value1, value2 and the milliseconds since IoTHubClient_TraceRing_Start over the oldest record of the ring. ]
+// Tests_SRS_IOTHUB_CLIENT_TRACE_RING_41_009: [ IoTHubClient_TraceRing_Dump shall copy the newest record_count records still in the ring into records, oldest first, and return how many it copied. ]
+TEST_FUNCTION(IoTHubClient_TraceRing_Record_full_ring_overwrites_oldest)
+{
+    // arrange
+    IOTHUB_CLIENT_TRACE_RECORD records[TEST_RECORD_COUNT + 2];
+    size_t index;
+    start_test_ring();
+    record_test_events(1, TEST_RECORD_COUNT + 2);
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    // act
+    size_t result = IoTHubClient_TraceRing_Dump(records, TEST_RECORD_COUNT + 2);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, TEST_RECORD_COUNT, result);
+    for (index = 0; index < TEST_RECORD_COUNT; index++)
+    {
+        ASSERT_ARE_EQUAL(uint32_t, (uint32_t)(3 + index), records[index].value1);
+        ASSERT_ARE_EQUAL(uint32_t, (uint32_t)(10 * (3 + index)), records[index].ms);
+    }
+}
+
+// Tests_SRS_IOTHUB_CLIENT_TRACE_RING_41_009: [ IoTHubClient_TraceRing_Dump shall copy the newest record_count records still in the ring into records, oldest first, and return how many it copied. ]
+TEST_FUNCTION(IoTHubClient_TraceRing_Dump_copies_newest_records)
+{
+    // arrange
+    IOTHUB_CLIENT_TRACE_RECORD records[2];
+    start_test_ring();
+    record_test_events(1, 3);
+
+    // act
+    size_t result = IoTHubClient_TraceRing_Dump(records, 2);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 2, result);
+    ASSERT_ARE_EQUAL(uint32_t, 2, records[0].value1);
+    ASSERT_ARE_EQUAL(uint32_t, 3, records[1].value1);
+}
+
+// Tests_SRS_IOTHUB_CLIENT_TRACE_RING_41_008: [ If records is NULL or tracing is not started, IoTHubClient_TraceRing_Dump shall return 0. ]
+TEST_FUNCTION(IoTHubClient_TraceRing_Dump_NULL_records_returns_0)
+{
+    // arrange
+    start_test_ring();
+    record_test_events(1, 1);
+
+    // act
+    size_t result = IoTHubClient_TraceRing_Dump(NULL, 1);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUB_CLIENT_TRACE_RING_41_008: [ If records is NULL or tracing is not started, IoTHubClient_TraceRing_Dump shall return 0. ]
+TEST_FUNCTION(IoTHubClient_TraceRing_Dump_not_started_returns_0)
+{
+    // arrange
+    IOTHUB_CLIENT_TRACE_RECORD record;
+
+    // act
+    size_t result = IoTHubClient_TraceRing_Dump(&record, 1);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+END_TEST_SUITE(iothub_client_trace_ring_ut)
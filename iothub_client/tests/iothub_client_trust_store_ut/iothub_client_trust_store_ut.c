@@ -0,0 +1,457 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <cstring>
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#endif
+
+void* real_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+void* real_calloc(size_t nmemb, size_t size)
+{
+    return calloc(nmemb, size);
+}
+
+void real_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umock_c_negative_tests.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/crt_abstractions.h"
+#include "internal/iothub_client_memory_private.h"
+#undef ENABLE_MOCKS
+
+#include "internal/iothub_client_trust_store.h"
+
+/*nothing is counted unless IoTHub_Init starts the memory accounting*/
+bool g_iothub_client_memory_accounting = false;
+
+static TEST_MUTEX_HANDLE g_testByTest;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+
+// Data definitions
+
+#define TEST_FILE_PATH                      "./iothub_trust_store_ut.pem"
+#define TEST_CERTIFICATES                   "-----BEGIN CERTIFICATE-----\nMIIDdzCCAl+gAwIBAgIEAgAAuTANBgkqhkiG9w0BAQUFADBa\n-----END CERTIFICATE-----\n"
+#define TEST_OTHER_CERTIFICATES             "-----BEGIN CERTIFICATE-----\nMIIDjjCCAnagAwIBAgIQAzrx5qcRqaC7KGSxHQn65TANBgkq\n-----END CERTIFICATE-----\n"
+
+static LOCK_HANDLE my_Lock_Init(void)
+{
+    return (LOCK_HANDLE)real_malloc(1);
+}
+
+static LOCK_RESULT my_Lock_Deinit(LOCK_HANDLE handle)
+{
+    real_free(handle);
+    return LOCK_OK;
+}
+
+static int my_mallocAndStrcpy_s(char** destination, const char* source)
+{
+    size_t length = strlen(source);
+    *destination = (char*)real_malloc(length + 1);
+    (void)memcpy(*destination, source, length + 1);
+    return 0;
+}
+
+static void write_test_file(const char* content)
+{
+    FILE* file = fopen(TEST_FILE_PATH, "wb");
+    ASSERT_IS_NOT_NULL(file);
+    ASSERT_ARE_EQUAL(size_t, strlen(content), fwrite(content, 1, strlen(content), file));
+    ASSERT_ARE_EQUAL(int, 0, fclose(file));
+}
+
+static void init_test_store(void)
+{
+    ASSERT_ARE_EQUAL(int, 0, trust_store_init());
+    umock_c_reset_all_calls();
+}
+
+static void register_global_mock_hooks(void)
+{
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_MEMORY_COUNTERS*, void*);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, real_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_calloc, real_calloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_calloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, real_free);
+
+    REGISTER_GLOBAL_MOCK_HOOK(Lock_Init, my_Lock_Init);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock_Init, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(Lock_Deinit, my_Lock_Deinit);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock, LOCK_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+
+    REGISTER_GLOBAL_MOCK_HOOK(mallocAndStrcpy_s, my_mallocAndStrcpy_s);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(mallocAndStrcpy_s, __LINE__);
+}
+
+
+BEGIN_TEST_SUITE(iothub_client_trust_store_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    int result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    register_global_mock_hooks();
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    (void)remove(TEST_FILE_PATH);
+
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    (void)remove(TEST_FILE_PATH);
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    g_iothub_client_memory_accounting = false;
+    trust_store_deinit();
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+// Tests_SRS_TRUST_STORE_41_001: [ trust_store_init shall create the lock of the store, and fail with a non-zero value if it cannot. ]
+TEST_FUNCTION(trust_store_init_Lock_Init_fails)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(Lock_Init()).SetReturn(NULL);
+
+    // act
+    int result = trust_store_init();
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_TRUST_STORE_41_003: [ If certificates is NULL, trust_store_acquire shall fail and return NULL. ]
+TEST_FUNCTION(trust_store_acquire_NULL_fails)
+{
+    // arrange
+    init_test_store();
+
+    // act
+    const char* result = trust_store_acquire(NULL);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_TRUST_STORE_41_004: [ If the store is not initialized, trust_store_acquire shall return a private copy of certificates. ]
+// Tests_SRS_TRUST_STORE_41_012: [ trust_store_release shall free a private copy. ]
+TEST_FUNCTION(trust_store_acquire_without_init_returns_private_copy)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(gballoc_calloc(1, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_calloc(1, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    const char* first = trust_store_acquire(TEST_CERTIFICATES);
+    const char* second = trust_store_acquire(TEST_CERTIFICATES);
+    ASSERT_ARE_NOT_EQUAL(void_ptr, (void*)first, (void*)second);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_CERTIFICATES, second);
+    trust_store_release(first);
+    trust_store_release(second);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_TRUST_STORE_41_014: [ Every shared copy of certificates shall be counted in IOTHUB_CLIENT_MEMORY_OPTIONS of the memory counters of the store until it is freed. ]
+TEST_FUNCTION(trust_store_copies_are_counted_in_options_memory)
+{
+    // arrange
+    IOTHUB_CLIENT_MEMORY_COUNTERS* counters = NULL;
+    const char* certificates;
+    size_t held_bytes;
+    g_iothub_client_memory_accounting = true;
+
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(IoTHubClient_Memory_Register(IGNORED_PTR_ARG))
+        .CaptureArgumentValue_counters(&counters);
+    ASSERT_ARE_EQUAL(int, 0, trust_store_init());
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NOT_NULL(counters);
+
+    // act
+    certificates = trust_store_acquire(TEST_CERTIFICATES);
+    held_bytes = counters->usage[IOTHUB_CLIENT_MEMORY_OPTIONS].current_bytes;
+    trust_store_release(certificates);
+
+    // assert
+    ASSERT_IS_TRUE(held_bytes > sizeof(TEST_CERTIFICATES));
+    ASSERT_ARE_EQUAL(size_t, held_bytes, counters->usage[IOTHUB_CLIENT_MEMORY_OPTIONS].peak_bytes);
+    ASSERT_ARE_EQUAL(size_t, 0, counters->usage[IOTHUB_CLIENT_MEMORY_OPTIONS].current_bytes);
+}
+
+// Tests_SRS_TRUST_STORE_41_005: [ trust_store_acquire shall return the copy already in the store of the same certificates, adding a reference to it. ]
+// Tests_SRS_TRUST_STORE_41_006: [ Otherwise trust_store_acquire shall add a copy of certificates to the store and return it; if that fails it shall return NULL. ]
+TEST_FUNCTION(trust_store_acquire_same_certificates_shares_copy)
+{
+    // arrange
+    char certificates[sizeof(TEST_CERTIFICATES)];
+    const char* first;
+    const char* second;
+
+    init_test_store();
+    (void)memcpy(certificates, TEST_CERTIFICATES, sizeof(TEST_CERTIFICATES));
+    first = trust_store_acquire(TEST_CERTIFICATES);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    // act
+    second = trust_store_acquire(certificates);
+
+    // assert
+    ASSERT_IS_NOT_NULL(first);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)first, (void*)second);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_CERTIFICATES, second);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    trust_store_release(first);
+    trust_store_release(second);
+}
+
+// Tests_SRS_TRUST_STORE_41_006: [ Otherwise trust_store_acquire shall add a copy of certificates to the store and return it; if that fails it shall return NULL. ]
+TEST_FUNCTION(trust_store_acquire_other_certificates_adds_copy)
+{
+    // arrange
+    const char* first;
+    const char* second;
+
+    init_test_store();
+    first = trust_store_acquire(TEST_CERTIFICATES);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_calloc(1, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    // act
+    second = trust_store_acquire(TEST_OTHER_CERTIFICATES);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(void_ptr, (void*)first, (void*)second);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_OTHER_CERTIFICATES, second);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    trust_store_release(first);
+    trust_store_release(second);
+}
+
+// Tests_SRS_TRUST_STORE_41_006: [ Otherwise trust_store_acquire shall add a copy of certificates to the store and return it; if that fails it shall return NULL. ]
+TEST_FUNCTION(trust_store_acquire_calloc_fails)
+{
+    // arrange
+    init_test_store();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_calloc(1, IGNORED_NUM_ARG)).SetReturn(NULL);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    // act
+    const char* result = trust_store_acquire(TEST_CERTIFICATES);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_TRUST_STORE_41_013: [ trust_store_release shall remove a reference to a shared copy, and free it once it has none left. ]
+TEST_FUNCTION(trust_store_release_last_reference_frees_copy)
+{
+    // arrange
+    const char* first;
+    const char* second;
+
+    init_test_store();
+    first = trust_store_acquire(TEST_CERTIFICATES);
+    second = trust_store_acquire(TEST_CERTIFICATES);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    // act
+    trust_store_release(first);
+    trust_store_release(second);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_TRUST_STORE_41_011: [ If certificates is NULL, trust_store_release shall do nothing. ]
+TEST_FUNCTION(trust_store_release_NULL_does_nothing)
+{
+    // arrange
+    init_test_store();
+
+    // act
+    trust_store_release(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_TRUST_STORE_41_007: [ If file_name is NULL, trust_store_acquire_file shall fail and return NULL. ]
+TEST_FUNCTION(trust_store_acquire_file_NULL_fails)
+{
+    // arrange
+    init_test_store();
+
+    // act
+    const char* result = trust_store_acquire_file(NULL);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_TRUST_STORE_41_010: [ Otherwise trust_store_acquire_file shall read file_name into the store, held there until trust_store_deinit, and return its contents; if that fails it shall return NULL. ]
+TEST_FUNCTION(trust_store_acquire_file_missing_fails)
+{
+    // arrange
+    init_test_store();
+
+    // act
+    const char* result = trust_store_acquire_file(TEST_FILE_PATH);
+
+    // assert
+    ASSERT_IS_NULL(result);
+}
+
+// Tests_SRS_TRUST_STORE_41_009: [ trust_store_acquire_file shall return the contents of a file already read into the store, adding a reference to them. ]
+// Tests_SRS_TRUST_STORE_41_010: [ Otherwise trust_store_acquire_file shall read file_name into the store, held there until trust_store_deinit, and return its contents; if that fails it shall return NULL. ]
+TEST_FUNCTION(trust_store_acquire_file_reads_file_once)
+{
+    // arrange
+    const char* first;
+    const char* second;
+
+    init_test_store();
+    write_test_file(TEST_CERTIFICATES);
+    first = trust_store_acquire_file(TEST_FILE_PATH);
+    trust_store_release(first);
+    (void)remove(TEST_FILE_PATH);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    // act
+    second = trust_store_acquire_file(TEST_FILE_PATH);
+
+    // assert
+    ASSERT_ARE_EQUAL(void_ptr, (void*)first, (void*)second);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_CERTIFICATES, second);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    trust_store_release(second);
+}
+
+// Tests_SRS_TRUST_STORE_41_008: [ If the store is not initialized, trust_store_acquire_file shall return a private copy of the contents of file_name. ]
+TEST_FUNCTION(trust_store_acquire_file_without_init_returns_private_copy)
+{
+    // arrange
+    write_test_file(TEST_CERTIFICATES);
+
+    STRICT_EXPECTED_CALL(gballoc_calloc(1, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    const char* result = trust_store_acquire_file(TEST_FILE_PATH);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_CERTIFICATES, result);
+    trust_store_release(result);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_TRUST_STORE_41_002: [ trust_store_deinit shall free every entry of the store and its lock; it shall do nothing if the store is not initialized. ]
+TEST_FUNCTION(trust_store_deinit_frees_file_contents)
+{
+    // arrange
+    init_test_store();
+    write_test_file(TEST_CERTIFICATES);
+    trust_store_release(trust_store_acquire_file(TEST_FILE_PATH));
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG));
+
+    // act
+    trust_store_deinit();
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+END_TEST_SUITE(iothub_client_trust_store_ut)
@@ -0,0 +1,359 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <cstring>
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#endif
+
+#if defined _MSC_VER
+#pragma warning(disable: 4054) /* MSC incorrectly fires this */
+#endif
+
+void* real_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+void real_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umock_c_negative_tests.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#undef ENABLE_MOCKS
+
+#include "internal/iothub_client_twin_cache.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+
+// Data definitions
+
+#define TEST_FILE_PATH                      "./iothub_twin_cache_ut.json"
+#define TEST_TWIN                           "{\"desired\":{\"rate\":5,\"mode\":\"fast\",\"$version\":3},\"reported\":{\"rate\":5,\"$version\":7}}"
+#define TEST_SAME_VERSION_TWIN              "{\"desired\":{\"rate\":6,\"$version\":3},\"reported\":{\"$version\":8}}"
+#define TEST_NEWER_TWIN                     "{\"desired\":{\"rate\":6,\"$version\":4},\"reported\":{\"$version\":8}}"
+#define TEST_OLD_PATCH                      "{\"rate\":1,\"$version\":3}"
+#define TEST_PATCH                          "{\"rate\":10,\"mode\":null,\"$version\":4}"
+#define TEST_PATCHED_TWIN                   "{\"desired\":{\"rate\":10,\"$version\":4},\"reported\":{\"rate\":5,\"$version\":7}}"
+#define TEST_NOT_JSON                       "{\"rate\":"
+
+
+static void write_test_file(const char* content)
+{
+    FILE* file = fopen(TEST_FILE_PATH, "wb");
+    ASSERT_IS_NOT_NULL(file);
+    ASSERT_ARE_EQUAL(size_t, strlen(content), fwrite(content, 1, strlen(content), file));
+    ASSERT_ARE_EQUAL(int, 0, fclose(file));
+}
+
+static bool update(TWIN_CACHE_HANDLE twin_cache, DEVICE_TWIN_UPDATE_STATE update_state, const char* payload)
+{
+    return twin_cache_update(twin_cache, update_state, (const unsigned char*)payload, strlen(payload));
+}
+
+static TWIN_CACHE_HANDLE create_test_cache(const char* content)
+{
+    TWIN_CACHE_HANDLE result;
+    write_test_file(content);
+    result = twin_cache_create(TEST_FILE_PATH);
+    ASSERT_IS_NOT_NULL(result);
+    umock_c_reset_all_calls();
+    return result;
+}
+
+static void register_global_mock_hooks(void)
+{
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, real_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, real_free);
+}
+
+
+BEGIN_TEST_SUITE(iothub_client_twin_cache_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    int result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    register_global_mock_hooks();
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    (void)remove(TEST_FILE_PATH);
+
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    (void)remove(TEST_FILE_PATH);
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+
+// Tests_SRS_TWIN_CACHE_41_001: [ If file_path is NULL or empty, twin_cache_create shall fail and return NULL. ]
+TEST_FUNCTION(create_NULL_file_path_fails)
+{
+    // arrange
+
+    // act
+    TWIN_CACHE_HANDLE result = twin_cache_create(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(result);
+}
+
+// Tests_SRS_TWIN_CACHE_41_002: [ If any allocation fails, twin_cache_create shall release all memory it allocated and return NULL. ]
+TEST_FUNCTION(create_fails_when_the_file_path_cannot_be_copied)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(TEST_FILE_PATH)))
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    TWIN_CACHE_HANDLE result = twin_cache_create(TEST_FILE_PATH);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(result);
+}
+
+// Tests_SRS_TWIN_CACHE_41_003: [ twin_cache_create shall load the twin in file_path; a file that does not exist or does not hold a JSON object shall leave the cache empty. ]
+// Tests_SRS_TWIN_CACHE_41_010: [ twin_cache_get_twin shall return the cached twin, or NULL if twin_cache is NULL or the cache is empty. ]
+TEST_FUNCTION(create_without_a_file_is_empty)
+{
+    // arrange
+
+    // act
+    TWIN_CACHE_HANDLE result = twin_cache_create(TEST_FILE_PATH);
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_IS_NULL(twin_cache_get_twin(result));
+
+    // cleanup
+    twin_cache_destroy(result);
+}
+
+// Tests_SRS_TWIN_CACHE_41_003: [ twin_cache_create shall load the twin in file_path; a file that does not exist or does not hold a JSON object shall leave the cache empty. ]
+TEST_FUNCTION(create_with_a_file_that_is_not_a_twin_is_empty)
+{
+    // arrange
+    write_test_file(TEST_NOT_JSON);
+
+    // act
+    TWIN_CACHE_HANDLE result = twin_cache_create(TEST_FILE_PATH);
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_IS_NULL(twin_cache_get_twin(result));
+
+    // cleanup
+    twin_cache_destroy(result);
+}
+
+// Tests_SRS_TWIN_CACHE_41_003: [ twin_cache_create shall load the twin in file_path; a file that does not exist or does not hold a JSON object shall leave the cache empty. ]
+TEST_FUNCTION(create_loads_the_twin_in_the_file)
+{
+    // arrange
+    write_test_file(TEST_TWIN);
+
+    // act
+    TWIN_CACHE_HANDLE result = twin_cache_create(TEST_FILE_PATH);
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_TWIN, twin_cache_get_twin(result));
+
+    // cleanup
+    twin_cache_destroy(result);
+}
+
+// Tests_SRS_TWIN_CACHE_41_004: [ twin_cache_destroy shall free the cache and keep its file; it shall do nothing if twin_cache is NULL. ]
+TEST_FUNCTION(destroy_NULL_does_nothing)
+{
+    // arrange
+
+    // act
+    twin_cache_destroy(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_TWIN_CACHE_41_005: [ If twin_cache or payload is NULL, or size is 0, twin_cache_update shall return true without changing the cache; an update that is not a JSON object shall be newer and leave the cache as it is. ]
+TEST_FUNCTION(update_NULL_payload_is_newer)
+{
+    // arrange
+    TWIN_CACHE_HANDLE twin_cache = create_test_cache(TEST_TWIN);
+
+    // act
+    bool result = twin_cache_update(twin_cache, DEVICE_TWIN_UPDATE_PARTIAL, NULL, 1);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_TRUE(result);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_TWIN, twin_cache_get_twin(twin_cache));
+
+    // cleanup
+    twin_cache_destroy(twin_cache);
+}
+
+// Tests_SRS_TWIN_CACHE_41_006: [ A DEVICE_TWIN_UPDATE_COMPLETE twin whose desired $version is the cached one shall not be newer. ]
+TEST_FUNCTION(update_complete_twin_with_the_cached_version_is_not_newer)
+{
+    // arrange
+    TWIN_CACHE_HANDLE twin_cache = create_test_cache(TEST_TWIN);
+
+    // act
+    bool result = update(twin_cache, DEVICE_TWIN_UPDATE_COMPLETE, TEST_SAME_VERSION_TWIN);
+
+    // assert
+    ASSERT_IS_FALSE(result);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_TWIN, twin_cache_get_twin(twin_cache));
+
+    // cleanup
+    twin_cache_destroy(twin_cache);
+}
+
+// Tests_SRS_TWIN_CACHE_41_007: [ Any other DEVICE_TWIN_UPDATE_COMPLETE twin shall replace the cached one and be newer. ]
+// Tests_SRS_TWIN_CACHE_41_009: [ twin_cache_update shall write the twin to a temporary file and rename it over file_path, so an interrupted write leaves the previous twin in place; failing to do so shall only be logged. ]
+TEST_FUNCTION(update_complete_twin_with_another_version_replaces_the_file)
+{
+    // arrange
+    TWIN_CACHE_HANDLE twin_cache = create_test_cache(TEST_TWIN);
+    TWIN_CACHE_HANDLE reopened;
+
+    // act
+    bool result = update(twin_cache, DEVICE_TWIN_UPDATE_COMPLETE, TEST_NEWER_TWIN);
+
+    // assert
+    ASSERT_IS_TRUE(result);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_NEWER_TWIN, twin_cache_get_twin(twin_cache));
+    reopened = twin_cache_create(TEST_FILE_PATH);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_NEWER_TWIN, twin_cache_get_twin(reopened));
+
+    // cleanup
+    twin_cache_destroy(reopened);
+    twin_cache_destroy(twin_cache);
+}
+
+// Tests_SRS_TWIN_CACHE_41_008: [ A DEVICE_TWIN_UPDATE_PARTIAL patch whose $version is not above the cached one shall not be newer; any other patch shall be merged into the cached "desired" object, a null member removing the property, and be newer. ]
+TEST_FUNCTION(update_patch_with_an_old_version_is_not_newer)
+{
+    // arrange
+    TWIN_CACHE_HANDLE twin_cache = create_test_cache(TEST_TWIN);
+
+    // act
+    bool result = update(twin_cache, DEVICE_TWIN_UPDATE_PARTIAL, TEST_OLD_PATCH);
+
+    // assert
+    ASSERT_IS_FALSE(result);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_TWIN, twin_cache_get_twin(twin_cache));
+
+    // cleanup
+    twin_cache_destroy(twin_cache);
+}
+
+// Tests_SRS_TWIN_CACHE_41_008: [ A DEVICE_TWIN_UPDATE_PARTIAL patch whose $version is not above the cached one shall not be newer; any other patch shall be merged into the cached "desired" object, a null member removing the property, and be newer. ]
+TEST_FUNCTION(update_patch_is_merged_into_the_desired_properties)
+{
+    // arrange
+    TWIN_CACHE_HANDLE twin_cache = create_test_cache(TEST_TWIN);
+    TWIN_CACHE_HANDLE reopened;
+
+    // act
+    bool result = update(twin_cache, DEVICE_TWIN_UPDATE_PARTIAL, TEST_PATCH);
+
+    // assert
+    ASSERT_IS_TRUE(result);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_PATCHED_TWIN, twin_cache_get_twin(twin_cache));
+    ASSERT_IS_FALSE(update(twin_cache, DEVICE_TWIN_UPDATE_PARTIAL, TEST_PATCH));
+    reopened = twin_cache_create(TEST_FILE_PATH);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_PATCHED_TWIN, twin_cache_get_twin(reopened));
+
+    // cleanup
+    twin_cache_destroy(reopened);
+    twin_cache_destroy(twin_cache);
+}
+
+// Tests_SRS_TWIN_CACHE_41_008: [ A DEVICE_TWIN_UPDATE_PARTIAL patch whose $version is not above the cached one shall not be newer; any other patch shall be merged into the cached "desired" object, a null member removing the property, and be newer. ]
+TEST_FUNCTION(update_patch_without_a_cached_twin_is_newer)
+{
+    // arrange
+    TWIN_CACHE_HANDLE twin_cache = twin_cache_create(TEST_FILE_PATH);
+
+    // act
+    bool result = update(twin_cache, DEVICE_TWIN_UPDATE_PARTIAL, TEST_PATCH);
+
+    // assert
+    ASSERT_IS_TRUE(result);
+    ASSERT_IS_NULL(twin_cache_get_twin(twin_cache));
+
+    // cleanup
+    twin_cache_destroy(twin_cache);
+}
+
+// Tests_SRS_TWIN_CACHE_41_010: [ twin_cache_get_twin shall return the cached twin, or NULL if twin_cache is NULL or the cache is empty. ]
+TEST_FUNCTION(get_twin_NULL_returns_NULL)
+{
+    // arrange
+
+    // act
+    const char* result = twin_cache_get_twin(NULL);
+
+    // assert
+    ASSERT_IS_NULL(result);
+}
+
+END_TEST_SUITE(iothub_client_twin_cache_ut)
@@ -0,0 +1,496 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <cstring>
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#endif
+
+#if defined _MSC_VER
+#pragma warning(disable: 4054) /* MSC incorrectly fires this */
+#endif
+
+void* real_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+void real_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umock_c_negative_tests.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#undef ENABLE_MOCKS
+
+#include "internal/iothub_client_twin_fanout.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+
+// Data definitions
+
+#define TEST_TWIN                           "{\"desired\":{\"motors\":{\"left\":{\"speed\":5},\"right\":{\"speed\":7},\"$note\":1},\"rate\":2,\"$version\":3},\"reported\":{\"rate\":2}}"
+#define TEST_PATCH                          "{\"motors\":{\"left\":{\"speed\":9}},\"$version\":4}"
+#define TEST_NOT_AN_OBJECT                  "[1,2]"
+#define TEST_NOT_JSON                       "{\"rate\":"
+#define TEST_CONTEXT                        ((void*)0x4242)
+#define TEST_OTHER_CONTEXT                  ((void*)0x4343)
+#define MAX_TEST_CALLS                      8
+
+typedef struct TEST_CALL_TAG
+{
+    DEVICE_TWIN_UPDATE_STATE update_state;
+    char path[64];
+    char value[64];
+    void* context;
+} TEST_CALL;
+
+static TEST_CALL g_calls[MAX_TEST_CALLS];
+static size_t g_call_count;
+
+static void test_desired_property_callback(DEVICE_TWIN_UPDATE_STATE update_state, const char* path, const unsigned char* value, size_t size, void* userContextCallback)
+{
+    ASSERT_IS_TRUE(g_call_count < MAX_TEST_CALLS);
+    ASSERT_IS_TRUE(strlen(path) < sizeof(g_calls[0].path));
+    ASSERT_IS_TRUE(size < sizeof(g_calls[0].value));
+
+    g_calls[g_call_count].update_state = update_state;
+    (void)strcpy(g_calls[g_call_count].path, path);
+    (void)memcpy(g_calls[g_call_count].value, value, size);
+    g_calls[g_call_count].value[size] = '\0';
+    g_calls[g_call_count].context = userContextCallback;
+    g_call_count++;
+}
+
+static void dispatch(TWIN_FANOUT_HANDLE twin_fanout, DEVICE_TWIN_UPDATE_STATE update_state, const char* payload)
+{
+    twin_fanout_dispatch(twin_fanout, update_state, (const unsigned char*)payload, strlen(payload));
+}
+
+static TWIN_FANOUT_HANDLE create_test_fanout(const char* path)
+{
+    TWIN_FANOUT_HANDLE result = twin_fanout_create();
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(int, 0, twin_fanout_set_callback(result, path, test_desired_property_callback, TEST_CONTEXT));
+    umock_c_reset_all_calls();
+    return result;
+}
+
+static void register_global_mock_hooks(void)
+{
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, real_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, real_free);
+}
+
+
+BEGIN_TEST_SUITE(iothub_client_twin_fanout_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    int result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    register_global_mock_hooks();
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    memset(g_calls, 0, sizeof(g_calls));
+    g_call_count = 0;
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+
+// Tests_SRS_TWIN_FANOUT_41_001: [ twin_fanout_create shall allocate a set of subscriptions, empty, and return it; it shall return NULL if allocating fails. ]
+// Tests_SRS_TWIN_FANOUT_41_006: [ twin_fanout_get_count shall return the number of subscriptions, or 0 if twin_fanout is NULL. ]
+TEST_FUNCTION(create_succeeds_empty)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+
+    // act
+    TWIN_FANOUT_HANDLE result = twin_fanout_create();
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(size_t, 0, twin_fanout_get_count(result));
+
+    // cleanup
+    twin_fanout_destroy(result);
+}
+
+// Tests_SRS_TWIN_FANOUT_41_001: [ twin_fanout_create shall allocate a set of subscriptions, empty, and return it; it shall return NULL if allocating fails. ]
+TEST_FUNCTION(create_fails_when_allocating_fails)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .SetReturn(NULL);
+
+    // act
+    TWIN_FANOUT_HANDLE result = twin_fanout_create();
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(result);
+}
+
+// Tests_SRS_TWIN_FANOUT_41_002: [ twin_fanout_destroy shall free every subscription and the set; it shall do nothing if twin_fanout is NULL. ]
+TEST_FUNCTION(destroy_NULL_does_nothing)
+{
+    // arrange
+
+    // act
+    twin_fanout_destroy(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_TWIN_FANOUT_41_002: [ twin_fanout_destroy shall free every subscription and the set; it shall do nothing if twin_fanout is NULL. ]
+TEST_FUNCTION(destroy_frees_the_subscriptions)
+{
+    // arrange
+    TWIN_FANOUT_HANDLE twin_fanout = create_test_fanout("desired.rate");
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(twin_fanout));
+
+    // act
+    twin_fanout_destroy(twin_fanout);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_TWIN_FANOUT_41_003: [ If twin_fanout or path is NULL, or path is empty, starts or ends with a dot or holds two dots in a row, twin_fanout_set_callback shall fail and return a non-zero value. ]
+TEST_FUNCTION(set_callback_NULL_handle_fails)
+{
+    // arrange
+
+    // act
+    int result = twin_fanout_set_callback(NULL, "desired.rate", test_desired_property_callback, TEST_CONTEXT);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+}
+
+// Tests_SRS_TWIN_FANOUT_41_003: [ If twin_fanout or path is NULL, or path is empty, starts or ends with a dot or holds two dots in a row, twin_fanout_set_callback shall fail and return a non-zero value. ]
+TEST_FUNCTION(set_callback_invalid_paths_fail)
+{
+    // arrange
+    const char* invalid_paths[] = { NULL, "", ".desired", "desired.", "desired..rate" };
+    TWIN_FANOUT_HANDLE twin_fanout = twin_fanout_create();
+    size_t index;
+    umock_c_reset_all_calls();
+
+    for (index = 0; index < sizeof(invalid_paths) / sizeof(invalid_paths[0]); index++)
+    {
+        // act
+        int result = twin_fanout_set_callback(twin_fanout, invalid_paths[index], test_desired_property_callback, TEST_CONTEXT);
+
+        // assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    }
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 0, twin_fanout_get_count(twin_fanout));
+
+    // cleanup
+    twin_fanout_destroy(twin_fanout);
+}
+
+// Tests_SRS_TWIN_FANOUT_41_004: [ twin_fanout_set_callback shall store callback and userContextCallback for path, after the existing subscriptions or in place of the one of the same path, and return 0; if allocating fails it shall return a non-zero value. ]
+TEST_FUNCTION(set_callback_fails_when_the_path_cannot_be_copied)
+{
+    // arrange
+    TWIN_FANOUT_HANDLE twin_fanout = twin_fanout_create();
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(2 * sizeof("desired.rate")))
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    int result = twin_fanout_set_callback(twin_fanout, "desired.rate", test_desired_property_callback, TEST_CONTEXT);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 0, twin_fanout_get_count(twin_fanout));
+
+    // cleanup
+    twin_fanout_destroy(twin_fanout);
+}
+
+// Tests_SRS_TWIN_FANOUT_41_004: [ twin_fanout_set_callback shall store callback and userContextCallback for path, after the existing subscriptions or in place of the one of the same path, and return 0; if allocating fails it shall return a non-zero value. ]
+TEST_FUNCTION(set_callback_replaces_the_callback_of_the_same_path)
+{
+    // arrange
+    TWIN_FANOUT_HANDLE twin_fanout = create_test_fanout("desired.rate");
+
+    // act
+    int result = twin_fanout_set_callback(twin_fanout, "desired.rate", test_desired_property_callback, TEST_OTHER_CONTEXT);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 1, twin_fanout_get_count(twin_fanout));
+    dispatch(twin_fanout, DEVICE_TWIN_UPDATE_COMPLETE, TEST_TWIN);
+    ASSERT_ARE_EQUAL(size_t, 1, g_call_count);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_OTHER_CONTEXT, g_calls[0].context);
+
+    // cleanup
+    twin_fanout_destroy(twin_fanout);
+}
+
+// Tests_SRS_TWIN_FANOUT_41_005: [ If callback is NULL, twin_fanout_set_callback shall remove the subscription of path and return 0, or fail and return a non-zero value if there is none. ]
+TEST_FUNCTION(set_callback_NULL_removes_the_subscription)
+{
+    // arrange
+    TWIN_FANOUT_HANDLE twin_fanout = create_test_fanout("desired.rate");
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    int result = twin_fanout_set_callback(twin_fanout, "desired.rate", NULL, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 0, twin_fanout_get_count(twin_fanout));
+
+    // cleanup
+    twin_fanout_destroy(twin_fanout);
+}
+
+// Tests_SRS_TWIN_FANOUT_41_005: [ If callback is NULL, twin_fanout_set_callback shall remove the subscription of path and return 0, or fail and return a non-zero value if there is none. ]
+TEST_FUNCTION(set_callback_NULL_without_a_subscription_fails)
+{
+    // arrange
+    TWIN_FANOUT_HANDLE twin_fanout = create_test_fanout("desired.rate");
+
+    // act
+    int result = twin_fanout_set_callback(twin_fanout, "desired.mode", NULL, NULL);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 1, twin_fanout_get_count(twin_fanout));
+
+    // cleanup
+    twin_fanout_destroy(twin_fanout);
+}
+
+// Tests_SRS_TWIN_FANOUT_41_006: [ twin_fanout_get_count shall return the number of subscriptions, or 0 if twin_fanout is NULL. ]
+TEST_FUNCTION(get_count_NULL_returns_0)
+{
+    // arrange
+
+    // act
+    size_t result = twin_fanout_get_count(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 0, result);
+}
+
+// Tests_SRS_TWIN_FANOUT_41_007: [ If twin_fanout or payload is NULL, or there is no subscription, twin_fanout_dispatch shall do nothing. ]
+TEST_FUNCTION(dispatch_NULL_payload_does_nothing)
+{
+    // arrange
+    TWIN_FANOUT_HANDLE twin_fanout = create_test_fanout("desired.rate");
+
+    // act
+    twin_fanout_dispatch(twin_fanout, DEVICE_TWIN_UPDATE_COMPLETE, NULL, 1);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 0, g_call_count);
+
+    // cleanup
+    twin_fanout_destroy(twin_fanout);
+}
+
+// Tests_SRS_TWIN_FANOUT_41_007: [ If twin_fanout or payload is NULL, or there is no subscription, twin_fanout_dispatch shall do nothing. ]
+TEST_FUNCTION(dispatch_without_subscriptions_does_not_parse)
+{
+    // arrange
+    TWIN_FANOUT_HANDLE twin_fanout = twin_fanout_create();
+    umock_c_reset_all_calls();
+
+    // act
+    dispatch(twin_fanout, DEVICE_TWIN_UPDATE_COMPLETE, TEST_TWIN);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    twin_fanout_destroy(twin_fanout);
+}
+
+// Tests_SRS_TWIN_FANOUT_41_008: [ twin_fanout_dispatch shall parse payload once for all the subscriptions, and do nothing if it is not a JSON object or allocating fails. ]
+TEST_FUNCTION(dispatch_not_an_object_does_nothing)
+{
+    // arrange
+    TWIN_FANOUT_HANDLE twin_fanout = create_test_fanout("*");
+
+    // act
+    dispatch(twin_fanout, DEVICE_TWIN_UPDATE_COMPLETE, TEST_NOT_AN_OBJECT);
+    dispatch(twin_fanout, DEVICE_TWIN_UPDATE_COMPLETE, TEST_NOT_JSON);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 0, g_call_count);
+
+    // cleanup
+    twin_fanout_destroy(twin_fanout);
+}
+
+// Tests_SRS_TWIN_FANOUT_41_008: [ twin_fanout_dispatch shall parse payload once for all the subscriptions, and do nothing if it is not a JSON object or allocating fails. ]
+TEST_FUNCTION(dispatch_does_nothing_when_the_copy_cannot_be_allocated)
+{
+    // arrange
+    TWIN_FANOUT_HANDLE twin_fanout = create_test_fanout("desired.rate");
+    STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(TEST_TWIN)))
+        .SetReturn(NULL);
+
+    // act
+    dispatch(twin_fanout, DEVICE_TWIN_UPDATE_COMPLETE, TEST_TWIN);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 0, g_call_count);
+
+    // cleanup
+    twin_fanout_destroy(twin_fanout);
+}
+
+// Tests_SRS_TWIN_FANOUT_41_009: [ A segment other than `*` shall match the member of that name, if the update holds one; the subscription shall not be called when a segment matches nothing. ]
+// Tests_SRS_TWIN_FANOUT_41_011: [ For every property found, twin_fanout_dispatch shall call the callback of the subscription with update_state, the path of the property, its wildcards replaced by member names, and the serialized property. ]
+TEST_FUNCTION(dispatch_complete_twin_calls_the_named_path)
+{
+    // arrange
+    TWIN_FANOUT_HANDLE twin_fanout = create_test_fanout("desired.motors.left");
+    ASSERT_ARE_EQUAL(int, 0, twin_fanout_set_callback(twin_fanout, "desired.fans", test_desired_property_callback, TEST_OTHER_CONTEXT));
+
+    // act
+    dispatch(twin_fanout, DEVICE_TWIN_UPDATE_COMPLETE, TEST_TWIN);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, g_call_count);
+    ASSERT_ARE_EQUAL(int, (int)DEVICE_TWIN_UPDATE_COMPLETE, (int)g_calls[0].update_state);
+    ASSERT_ARE_EQUAL(char_ptr, "desired.motors.left", g_calls[0].path);
+    ASSERT_ARE_EQUAL(char_ptr, "{\"speed\":5}", g_calls[0].value);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_CONTEXT, g_calls[0].context);
+
+    // cleanup
+    twin_fanout_destroy(twin_fanout);
+}
+
+// Tests_SRS_TWIN_FANOUT_41_010: [ A `*` segment shall match every member of the object, in the order of the update, except the members whose name starts with `$`. ]
+TEST_FUNCTION(dispatch_wildcard_calls_every_member)
+{
+    // arrange
+    TWIN_FANOUT_HANDLE twin_fanout = create_test_fanout("desired.motors.*.speed");
+
+    // act
+    dispatch(twin_fanout, DEVICE_TWIN_UPDATE_COMPLETE, TEST_TWIN);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 2, g_call_count);
+    ASSERT_ARE_EQUAL(char_ptr, "desired.motors.left.speed", g_calls[0].path);
+    ASSERT_ARE_EQUAL(char_ptr, "5", g_calls[0].value);
+    ASSERT_ARE_EQUAL(char_ptr, "desired.motors.right.speed", g_calls[1].path);
+    ASSERT_ARE_EQUAL(char_ptr, "7", g_calls[1].value);
+
+    // cleanup
+    twin_fanout_destroy(twin_fanout);
+}
+
+// Tests_SRS_TWIN_FANOUT_41_012: [ A DEVICE_TWIN_UPDATE_PARTIAL payload shall be matched as the `desired` object of the twin; only the paths starting with `desired` can match it. ]
+TEST_FUNCTION(dispatch_patch_is_matched_as_desired)
+{
+    // arrange
+    TWIN_FANOUT_HANDLE twin_fanout = create_test_fanout("desired.motors.*");
+    ASSERT_ARE_EQUAL(int, 0, twin_fanout_set_callback(twin_fanout, "motors", test_desired_property_callback, TEST_OTHER_CONTEXT));
+
+    // act
+    dispatch(twin_fanout, DEVICE_TWIN_UPDATE_PARTIAL, TEST_PATCH);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, g_call_count);
+    ASSERT_ARE_EQUAL(int, (int)DEVICE_TWIN_UPDATE_PARTIAL, (int)g_calls[0].update_state);
+    ASSERT_ARE_EQUAL(char_ptr, "desired.motors.left", g_calls[0].path);
+    ASSERT_ARE_EQUAL(char_ptr, "{\"speed\":9}", g_calls[0].value);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_CONTEXT, g_calls[0].context);
+
+    // cleanup
+    twin_fanout_destroy(twin_fanout);
+}
+
+// Tests_SRS_TWIN_FANOUT_41_012: [ A DEVICE_TWIN_UPDATE_PARTIAL payload shall be matched as the `desired` object of the twin; only the paths starting with `desired` can match it. ]
+TEST_FUNCTION(dispatch_patch_to_desired_calls_with_the_whole_patch)
+{
+    // arrange
+    TWIN_FANOUT_HANDLE twin_fanout = create_test_fanout("desired");
+
+    // act
+    dispatch(twin_fanout, DEVICE_TWIN_UPDATE_PARTIAL, TEST_PATCH);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 1, g_call_count);
+    ASSERT_ARE_EQUAL(char_ptr, "desired", g_calls[0].path);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_PATCH, g_calls[0].value);
+
+    // cleanup
+    twin_fanout_destroy(twin_fanout);
+}
+
+END_TEST_SUITE(iothub_client_twin_fanout_ut)
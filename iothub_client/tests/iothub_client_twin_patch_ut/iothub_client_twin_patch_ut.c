@@ -0,0 +1,400 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <cstring>
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#endif
+
+#if defined _MSC_VER
+#pragma warning(disable: 4054) /* MSC incorrectly fires this */
+#endif
+
+void* real_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+void real_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umock_c_negative_tests.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/constbuffer.h"
+#undef ENABLE_MOCKS
+
+#include "internal/iothub_client_twin_patch.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+
+// Data definitions
+
+#define TEST_PATCH                          "{\"temperature\":20,\"config\":{\"rate\":5,\"mode\":\"fast\"}}"
+#define TEST_NOT_AN_OBJECT                  "[1,2]"
+#define TEST_NOT_JSON                       "{\"temperature\":"
+
+
+// Fake constbuffers, holding a copy of their content
+
+typedef struct TEST_CONSTBUFFER_TAG
+{
+    CONSTBUFFER content;
+    unsigned char* buffer;
+} TEST_CONSTBUFFER;
+
+static CONSTBUFFER_HANDLE TEST_CONSTBUFFER_Create(const unsigned char* source, size_t size)
+{
+    TEST_CONSTBUFFER* result = (TEST_CONSTBUFFER*)real_malloc(sizeof(TEST_CONSTBUFFER));
+    ASSERT_IS_NOT_NULL(result);
+    result->buffer = (unsigned char*)real_malloc(size + 1);
+    ASSERT_IS_NOT_NULL(result->buffer);
+    (void)memcpy(result->buffer, source, size);
+    result->buffer[size] = '\0';
+    result->content.buffer = result->buffer;
+    result->content.size = size;
+    return (CONSTBUFFER_HANDLE)result;
+}
+
+static const CONSTBUFFER* TEST_CONSTBUFFER_GetContent(CONSTBUFFER_HANDLE constbufferHandle)
+{
+    return &((TEST_CONSTBUFFER*)constbufferHandle)->content;
+}
+
+static void TEST_CONSTBUFFER_DecRef(CONSTBUFFER_HANDLE constbufferHandle)
+{
+    TEST_CONSTBUFFER* constbuffer = (TEST_CONSTBUFFER*)constbufferHandle;
+    real_free(constbuffer->buffer);
+    real_free(constbuffer);
+}
+
+static CONSTBUFFER_HANDLE create_patch(const char* json)
+{
+    return TEST_CONSTBUFFER_Create((const unsigned char*)json, strlen(json));
+}
+
+static CONSTBUFFER_HANDLE merge(CONSTBUFFER_HANDLE patch, const char* next_patch)
+{
+    return twin_patch_merge(patch, (const unsigned char*)next_patch, strlen(next_patch));
+}
+
+static void assert_patch_content(const char* expected, CONSTBUFFER_HANDLE patch)
+{
+    ASSERT_IS_NOT_NULL(patch);
+    ASSERT_ARE_EQUAL(char_ptr, expected, (const char*)((TEST_CONSTBUFFER*)patch)->buffer);
+}
+
+static void register_global_mock_hooks(void)
+{
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, real_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, real_free);
+
+    REGISTER_GLOBAL_MOCK_HOOK(CONSTBUFFER_Create, TEST_CONSTBUFFER_Create);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(CONSTBUFFER_Create, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(CONSTBUFFER_GetContent, TEST_CONSTBUFFER_GetContent);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(CONSTBUFFER_GetContent, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(CONSTBUFFER_DecRef, TEST_CONSTBUFFER_DecRef);
+}
+
+static void register_umock_alias_types(void)
+{
+    REGISTER_UMOCK_ALIAS_TYPE(CONSTBUFFER_HANDLE, void*);
+}
+
+
+BEGIN_TEST_SUITE(iothub_client_twin_patch_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    int result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    register_umock_alias_types();
+    register_global_mock_hooks();
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+
+// Tests_SRS_TWIN_PATCH_41_001: [ If patch or next_patch are NULL, or next_size is 0, twin_patch_merge shall fail and return NULL. ]
+TEST_FUNCTION(merge_NULL_patch)
+{
+    // arrange
+    umock_c_reset_all_calls();
+
+    // act
+    CONSTBUFFER_HANDLE result = merge(NULL, TEST_PATCH);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(result);
+}
+
+// Tests_SRS_TWIN_PATCH_41_001: [ If patch or next_patch are NULL, or next_size is 0, twin_patch_merge shall fail and return NULL. ]
+TEST_FUNCTION(merge_NULL_next_patch)
+{
+    // arrange
+    CONSTBUFFER_HANDLE patch = create_patch(TEST_PATCH);
+    umock_c_reset_all_calls();
+
+    // act
+    CONSTBUFFER_HANDLE result = twin_patch_merge(patch, NULL, 1);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(result);
+
+    // cleanup
+    TEST_CONSTBUFFER_DecRef(patch);
+}
+
+// Tests_SRS_TWIN_PATCH_41_001: [ If patch or next_patch are NULL, or next_size is 0, twin_patch_merge shall fail and return NULL. ]
+TEST_FUNCTION(merge_zero_next_size)
+{
+    // arrange
+    CONSTBUFFER_HANDLE patch = create_patch(TEST_PATCH);
+    umock_c_reset_all_calls();
+
+    // act
+    CONSTBUFFER_HANDLE result = twin_patch_merge(patch, (const unsigned char*)TEST_PATCH, 0);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(result);
+
+    // cleanup
+    TEST_CONSTBUFFER_DecRef(patch);
+}
+
+// Tests_SRS_TWIN_PATCH_41_002: [ Two objects with the same name shall be merged member by member; any other member of next_patch shall replace the member of patch with the same name, a null member included. ]
+// Tests_SRS_TWIN_PATCH_41_004: [ Otherwise twin_patch_merge shall return a new CONSTBUFFER_HANDLE holding the merged JSON object, leaving patch untouched. ]
+TEST_FUNCTION(merge_succeeds)
+{
+    // arrange
+    CONSTBUFFER_HANDLE patch = create_patch(TEST_PATCH);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(CONSTBUFFER_GetContent(patch));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+
+    // act
+    CONSTBUFFER_HANDLE result = merge(patch, "{\"humidity\":40,\"temperature\":21}");
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    assert_patch_content("{\"temperature\":21,\"config\":{\"rate\":5,\"mode\":\"fast\"},\"humidity\":40}", result);
+    assert_patch_content(TEST_PATCH, patch);
+
+    // cleanup
+    TEST_CONSTBUFFER_DecRef(result);
+    TEST_CONSTBUFFER_DecRef(patch);
+}
+
+// Tests_SRS_TWIN_PATCH_41_002: [ Two objects with the same name shall be merged member by member; any other member of next_patch shall replace the member of patch with the same name, a null member included. ]
+TEST_FUNCTION(merge_nested_objects_succeeds)
+{
+    // arrange
+    CONSTBUFFER_HANDLE patch = create_patch(TEST_PATCH);
+    umock_c_reset_all_calls();
+
+    // act
+    CONSTBUFFER_HANDLE result = merge(patch, "{\"config\":{\"rate\":10,\"limits\":{\"max\":3}}}");
+
+    // assert
+    assert_patch_content("{\"temperature\":20,\"config\":{\"rate\":10,\"mode\":\"fast\",\"limits\":{\"max\":3}}}", result);
+
+    // cleanup
+    TEST_CONSTBUFFER_DecRef(result);
+    TEST_CONSTBUFFER_DecRef(patch);
+}
+
+// Tests_SRS_TWIN_PATCH_41_002: [ Two objects with the same name shall be merged member by member; any other member of next_patch shall replace the member of patch with the same name, a null member included. ]
+TEST_FUNCTION(merge_null_member_is_kept)
+{
+    // arrange
+    CONSTBUFFER_HANDLE patch = create_patch(TEST_PATCH);
+    umock_c_reset_all_calls();
+
+    // act
+    CONSTBUFFER_HANDLE result = merge(patch, "{\"config\":null,\"humidity\":null}");
+
+    // assert
+    assert_patch_content("{\"temperature\":20,\"config\":null,\"humidity\":null}", result);
+
+    // cleanup
+    TEST_CONSTBUFFER_DecRef(result);
+    TEST_CONSTBUFFER_DecRef(patch);
+}
+
+// Tests_SRS_TWIN_PATCH_41_002: [ Two objects with the same name shall be merged member by member; any other member of next_patch shall replace the member of patch with the same name, a null member included. ]
+TEST_FUNCTION(merge_object_replaces_value_succeeds)
+{
+    // arrange
+    CONSTBUFFER_HANDLE patch = create_patch(TEST_PATCH);
+    umock_c_reset_all_calls();
+
+    // act
+    CONSTBUFFER_HANDLE result = merge(patch, "{\"temperature\":{\"inside\":19},\"config\":7}");
+
+    // assert
+    assert_patch_content("{\"temperature\":{\"inside\":19},\"config\":7}", result);
+
+    // cleanup
+    TEST_CONSTBUFFER_DecRef(result);
+    TEST_CONSTBUFFER_DecRef(patch);
+}
+
+// Tests_SRS_TWIN_PATCH_41_003: [ If either patch is not a JSON object, twin_patch_merge shall fail and return NULL. ]
+TEST_FUNCTION(merge_next_patch_not_an_object_fails)
+{
+    // arrange
+    CONSTBUFFER_HANDLE patch = create_patch(TEST_PATCH);
+    umock_c_reset_all_calls();
+
+    // act
+    CONSTBUFFER_HANDLE result = merge(patch, TEST_NOT_AN_OBJECT);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    assert_patch_content(TEST_PATCH, patch);
+
+    // cleanup
+    TEST_CONSTBUFFER_DecRef(patch);
+}
+
+// Tests_SRS_TWIN_PATCH_41_003: [ If either patch is not a JSON object, twin_patch_merge shall fail and return NULL. ]
+TEST_FUNCTION(merge_patch_not_an_object_fails)
+{
+    // arrange
+    CONSTBUFFER_HANDLE patch = create_patch(TEST_NOT_AN_OBJECT);
+    umock_c_reset_all_calls();
+
+    // act
+    CONSTBUFFER_HANDLE result = merge(patch, TEST_PATCH);
+
+    // assert
+    ASSERT_IS_NULL(result);
+
+    // cleanup
+    TEST_CONSTBUFFER_DecRef(patch);
+}
+
+// Tests_SRS_TWIN_PATCH_41_003: [ If either patch is not a JSON object, twin_patch_merge shall fail and return NULL. ]
+TEST_FUNCTION(merge_next_patch_not_json_fails)
+{
+    // arrange
+    CONSTBUFFER_HANDLE patch = create_patch(TEST_PATCH);
+    umock_c_reset_all_calls();
+
+    // act
+    CONSTBUFFER_HANDLE result = merge(patch, TEST_NOT_JSON);
+
+    // assert
+    ASSERT_IS_NULL(result);
+
+    // cleanup
+    TEST_CONSTBUFFER_DecRef(patch);
+}
+
+// Tests_SRS_TWIN_PATCH_41_004: [ Otherwise twin_patch_merge shall return a new CONSTBUFFER_HANDLE holding the merged JSON object, leaving patch untouched. ]
+TEST_FUNCTION(merge_fails)
+{
+    // arrange
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    CONSTBUFFER_HANDLE patch = create_patch(TEST_PATCH);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(CONSTBUFFER_GetContent(patch));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    umock_c_negative_tests_snapshot();
+
+    size_t count = umock_c_negative_tests_call_count();
+    for (size_t index = 0; index < count; index++)
+    {
+        if (index == 2 || index == 4)
+        {
+            continue;
+        }
+
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(index);
+
+        char tmp_msg[64];
+        sprintf(tmp_msg, "twin_patch_merge failure in test %lu/%lu", (unsigned long)index, (unsigned long)count);
+
+        // act
+        CONSTBUFFER_HANDLE result = merge(patch, "{\"humidity\":40}");
+
+        // assert
+        ASSERT_IS_NULL_WITH_MSG(result, tmp_msg);
+    }
+
+    // cleanup
+    umock_c_negative_tests_deinit();
+    TEST_CONSTBUFFER_DecRef(patch);
+}
+
+END_TEST_SUITE(iothub_client_twin_patch_ut)
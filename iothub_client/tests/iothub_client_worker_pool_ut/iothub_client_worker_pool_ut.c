@@ -0,0 +1,574 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#endif
+
+#include <signal.h>
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umock_c_negative_tests.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+#include "umocktypes_bool.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/doublylinkedlist.h"
+#include "azure_c_shared_utility/tickcounter.h"
+
+MOCKABLE_FUNCTION(, unsigned int, test_do_work, void*, context);
+#undef ENABLE_MOCKS
+
+#include "iothub_client_worker_pool.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+    void real_DList_InitializeListHead(PDLIST_ENTRY listHead);
+    int real_DList_IsListEmpty(const PDLIST_ENTRY listHead);
+    void real_DList_InsertTailList(PDLIST_ENTRY listHead, PDLIST_ENTRY listEntry);
+    void real_DList_InsertHeadList(PDLIST_ENTRY listHead, PDLIST_ENTRY listEntry);
+    void real_DList_AppendTailList(PDLIST_ENTRY listHead, PDLIST_ENTRY ListToAppend);
+    int real_DList_RemoveEntryList(PDLIST_ENTRY listEntry);
+    PDLIST_ENTRY real_DList_RemoveHeadList(PDLIST_ENTRY listHead);
+
+    extern const size_t IoTHubClientWorkerPool_ThreadTerminationOffset;
+#ifdef __cplusplus
+}
+#endif
+
+#define MAX_TEST_THREADS        4
+#define TEST_DO_WORK_INTERVAL   5
+
+static TICK_COUNTER_HANDLE TEST_TICK_COUNTER_HANDLE = (TICK_COUNTER_HANDLE)0x5001;
+static THREAD_HANDLE TEST_THREAD_HANDLE = (THREAD_HANDLE)0x5002;
+static void* TEST_CONTEXT = (void*)0x5003;
+
+static TEST_MUTEX_HANDLE test_serialize_mutex;
+
+static THREAD_START_FUNC g_thread_funcs[MAX_TEST_THREADS];
+static void* g_thread_args[MAX_TEST_THREADS];
+static size_t g_thread_count;
+static tickcounter_ms_t g_current_ms;
+static IOTHUB_CLIENT_WORKER_POOL_HANDLE g_pool;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+static void stop_pool_threads(void)
+{
+    *(sig_atomic_t*)(((char*)g_pool) + IoTHubClientWorkerPool_ThreadTerminationOffset) = 1;
+}
+
+static LOCK_HANDLE my_Lock_Init(void)
+{
+    return (LOCK_HANDLE)my_gballoc_malloc(1);
+}
+
+static LOCK_RESULT my_Lock_Deinit(LOCK_HANDLE handle)
+{
+    my_gballoc_free(handle);
+    return LOCK_OK;
+}
+
+static THREADAPI_RESULT my_ThreadAPI_Create(THREAD_HANDLE* threadHandle, THREAD_START_FUNC func, void* arg)
+{
+    *threadHandle = TEST_THREAD_HANDLE;
+    g_thread_funcs[g_thread_count] = func;
+    g_thread_args[g_thread_count] = arg;
+    g_thread_count++;
+    return THREADAPI_OK;
+}
+
+static void my_ThreadAPI_Sleep(unsigned int milliseconds)
+{
+    (void)milliseconds;
+    stop_pool_threads();
+}
+
+static int my_tickcounter_get_current_ms(TICK_COUNTER_HANDLE tick_counter, tickcounter_ms_t* current_ms)
+{
+    (void)tick_counter;
+    *current_ms = g_current_ms;
+    return 0;
+}
+
+static unsigned int my_test_do_work(void* context)
+{
+    (void)context;
+    stop_pool_threads();
+    return TEST_DO_WORK_INTERVAL;
+}
+
+static void reset_test_data(void)
+{
+    memset(g_thread_funcs, 0, sizeof(g_thread_funcs));
+    memset(g_thread_args, 0, sizeof(g_thread_args));
+    g_thread_count = 0;
+    g_current_ms = 100;
+    g_pool = NULL;
+}
+
+static void set_expected_calls_for_create(size_t thread_count)
+{
+    size_t i;
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(tickcounter_create());
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    for (i = 0; i < thread_count; i++)
+    {
+        STRICT_EXPECTED_CALL(DList_InitializeListHead(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(Lock_Init());
+    }
+    for (i = 0; i < thread_count; i++)
+    {
+        STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    }
+}
+
+static void set_expected_calls_for_add(void)
+{
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_InsertHeadList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+}
+
+BEGIN_TEST_SUITE(iothub_client_worker_pool_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    int result;
+
+    test_serialize_mutex = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(test_serialize_mutex);
+
+    umock_c_init(on_umock_c_error);
+    result = umocktypes_bool_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(THREAD_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(THREAD_START_FUNC, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(THREADAPI_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(TICK_COUNTER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(PDLIST_ENTRY, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(const PDLIST_ENTRY, void*);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+    REGISTER_GLOBAL_MOCK_HOOK(Lock_Init, my_Lock_Init);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock_Init, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(Lock_Deinit, my_Lock_Deinit);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock, LOCK_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+
+    REGISTER_GLOBAL_MOCK_HOOK(ThreadAPI_Create, my_ThreadAPI_Create);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(ThreadAPI_Create, THREADAPI_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(ThreadAPI_Join, THREADAPI_OK);
+    REGISTER_GLOBAL_MOCK_HOOK(ThreadAPI_Sleep, my_ThreadAPI_Sleep);
+
+    REGISTER_GLOBAL_MOCK_RETURN(tickcounter_create, TEST_TICK_COUNTER_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(tickcounter_create, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(tickcounter_get_current_ms, my_tickcounter_get_current_ms);
+
+    REGISTER_GLOBAL_MOCK_HOOK(DList_InitializeListHead, real_DList_InitializeListHead);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_IsListEmpty, real_DList_IsListEmpty);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_InsertTailList, real_DList_InsertTailList);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_InsertHeadList, real_DList_InsertHeadList);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_AppendTailList, real_DList_AppendTailList);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_RemoveEntryList, real_DList_RemoveEntryList);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_RemoveHeadList, real_DList_RemoveHeadList);
+
+    REGISTER_GLOBAL_MOCK_HOOK(test_do_work, my_test_do_work);
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(test_serialize_mutex);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    TEST_MUTEX_ACQUIRE(test_serialize_mutex);
+    umock_c_reset_all_calls();
+    reset_test_data();
+}
+
+TEST_FUNCTION_CLEANUP(method_cleanup)
+{
+    reset_test_data();
+    TEST_MUTEX_RELEASE(test_serialize_mutex);
+}
+
+TEST_FUNCTION(IoTHubClientWorkerPool_Create_thread_count_0_fail)
+{
+    // act
+    IOTHUB_CLIENT_WORKER_POOL_HANDLE result = IoTHubClientWorkerPool_Create(0);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(IoTHubClientWorkerPool_Create_succeed)
+{
+    // arrange
+    set_expected_calls_for_create(2);
+
+    // act
+    IOTHUB_CLIENT_WORKER_POOL_HANDLE result = IoTHubClientWorkerPool_Create(2);
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(size_t, 2, g_thread_count);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClientWorkerPool_Destroy(result);
+}
+
+TEST_FUNCTION(IoTHubClientWorkerPool_Create_fail)
+{
+    // arrange
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    set_expected_calls_for_create(2);
+    umock_c_negative_tests_snapshot();
+
+    size_t calls_that_cannot_fail[] = { 3, 5 }; /*DList_InitializeListHead*/
+
+    size_t count = umock_c_negative_tests_call_count();
+    for (size_t index = 0; index < count; index++)
+    {
+        if (index == calls_that_cannot_fail[0] || index == calls_that_cannot_fail[1])
+        {
+            continue;
+        }
+
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(index);
+        g_thread_count = 0;
+
+        char tmp_msg[64];
+        sprintf(tmp_msg, "IoTHubClientWorkerPool_Create failure in test %lu/%lu", (unsigned long)index, (unsigned long)count);
+
+        // act
+        IOTHUB_CLIENT_WORKER_POOL_HANDLE result = IoTHubClientWorkerPool_Create(2);
+
+        // assert
+        ASSERT_IS_NULL_WITH_MSG(result, tmp_msg);
+    }
+
+    // cleanup
+    umock_c_negative_tests_deinit();
+}
+
+TEST_FUNCTION(IoTHubClientWorkerPool_Destroy_NULL_succeed)
+{
+    // act
+    IoTHubClientWorkerPool_Destroy(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(IoTHubClientWorkerPool_Destroy_succeed)
+{
+    // arrange
+    IOTHUB_CLIENT_WORKER_POOL_HANDLE pool = IoTHubClientWorkerPool_Create(1);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(ThreadAPI_Join(TEST_THREAD_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(tickcounter_destroy(TEST_TICK_COUNTER_HANDLE));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    IoTHubClientWorkerPool_Destroy(pool);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(IoTHubClientWorkerPool_Add_NULL_pool_fail)
+{
+    // act
+    IOTHUB_CLIENT_WORKER_POOL_ITEM_HANDLE result = IoTHubClientWorkerPool_Add(NULL, test_do_work, TEST_CONTEXT);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(IoTHubClientWorkerPool_Add_NULL_do_work_fail)
+{
+    // arrange
+    IOTHUB_CLIENT_WORKER_POOL_HANDLE pool = IoTHubClientWorkerPool_Create(1);
+    umock_c_reset_all_calls();
+
+    // act
+    IOTHUB_CLIENT_WORKER_POOL_ITEM_HANDLE result = IoTHubClientWorkerPool_Add(pool, NULL, TEST_CONTEXT);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClientWorkerPool_Destroy(pool);
+}
+
+TEST_FUNCTION(IoTHubClientWorkerPool_Add_succeed)
+{
+    // arrange
+    IOTHUB_CLIENT_WORKER_POOL_HANDLE pool = IoTHubClientWorkerPool_Create(2);
+    umock_c_reset_all_calls();
+
+    set_expected_calls_for_add();
+
+    // act
+    IOTHUB_CLIENT_WORKER_POOL_ITEM_HANDLE result = IoTHubClientWorkerPool_Add(pool, test_do_work, TEST_CONTEXT);
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClientWorkerPool_Remove(pool, result);
+    IoTHubClientWorkerPool_Destroy(pool);
+}
+
+TEST_FUNCTION(IoTHubClientWorkerPool_Add_Lock_fail)
+{
+    // arrange
+    IOTHUB_CLIENT_WORKER_POOL_HANDLE pool = IoTHubClientWorkerPool_Create(1);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).SetReturn(LOCK_ERROR);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    IOTHUB_CLIENT_WORKER_POOL_ITEM_HANDLE result = IoTHubClientWorkerPool_Add(pool, test_do_work, TEST_CONTEXT);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClientWorkerPool_Destroy(pool);
+}
+
+TEST_FUNCTION(IoTHubClientWorkerPool_Remove_succeed)
+{
+    // arrange
+    IOTHUB_CLIENT_WORKER_POOL_HANDLE pool = IoTHubClientWorkerPool_Create(1);
+    IOTHUB_CLIENT_WORKER_POOL_ITEM_HANDLE item = IoTHubClientWorkerPool_Add(pool, test_do_work, TEST_CONTEXT);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(item));
+
+    // act
+    IoTHubClientWorkerPool_Remove(pool, item);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClientWorkerPool_Destroy(pool);
+}
+
+TEST_FUNCTION(IoTHubClientWorkerPool_Wake_NULL_item_does_nothing)
+{
+    // arrange
+    IOTHUB_CLIENT_WORKER_POOL_HANDLE pool = IoTHubClientWorkerPool_Create(1);
+    umock_c_reset_all_calls();
+
+    // act
+    IoTHubClientWorkerPool_Wake(pool, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClientWorkerPool_Destroy(pool);
+}
+
+TEST_FUNCTION(IoTHubClientWorkerPool_Wake_makes_item_due_now)
+{
+    // arrange
+    g_pool = IoTHubClientWorkerPool_Create(1);
+    IOTHUB_CLIENT_WORKER_POOL_ITEM_HANDLE item = IoTHubClientWorkerPool_Add(g_pool, test_do_work, TEST_CONTEXT);
+    g_current_ms -= 50; /*the item becomes due in 50 ms*/
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_InsertHeadList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    // act
+    IoTHubClientWorkerPool_Wake(g_pool, item);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    /*the pool thread now finds it due instead of sleeping*/
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(test_do_work(TEST_CONTEXT));
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_InsertHeadList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(ThreadAPI_Exit(0));
+
+    (void)g_thread_funcs[0](g_thread_args[0]);
+
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClientWorkerPool_Remove(g_pool, item);
+    IoTHubClientWorkerPool_Destroy(g_pool);
+}
+
+TEST_FUNCTION(IoTHubClientWorkerPool_thread_runs_due_item_and_reschedules_it)
+{
+    // arrange
+    g_pool = IoTHubClientWorkerPool_Create(1);
+    IOTHUB_CLIENT_WORKER_POOL_ITEM_HANDLE item = IoTHubClientWorkerPool_Add(g_pool, test_do_work, TEST_CONTEXT);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(test_do_work(TEST_CONTEXT));
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_InsertHeadList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(ThreadAPI_Exit(0));
+
+    // act
+    (void)g_thread_funcs[0](g_thread_args[0]);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClientWorkerPool_Remove(g_pool, item);
+    IoTHubClientWorkerPool_Destroy(g_pool);
+}
+
+TEST_FUNCTION(IoTHubClientWorkerPool_thread_steals_due_item_from_other_shard)
+{
+    // arrange
+    g_pool = IoTHubClientWorkerPool_Create(2);
+    /*both shards are empty so the item lands on shard 0*/
+    IOTHUB_CLIENT_WORKER_POOL_ITEM_HANDLE item = IoTHubClientWorkerPool_Add(g_pool, test_do_work, TEST_CONTEXT);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(test_do_work(TEST_CONTEXT));
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_InsertHeadList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(ThreadAPI_Exit(0));
+
+    // act
+    (void)g_thread_funcs[1](g_thread_args[1]);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClientWorkerPool_Remove(g_pool, item);
+    IoTHubClientWorkerPool_Destroy(g_pool);
+}
+
+TEST_FUNCTION(IoTHubClientWorkerPool_thread_sleeps_until_next_deadline)
+{
+    // arrange
+    g_pool = IoTHubClientWorkerPool_Create(1);
+    IOTHUB_CLIENT_WORKER_POOL_ITEM_HANDLE item = IoTHubClientWorkerPool_Add(g_pool, test_do_work, TEST_CONTEXT);
+    g_current_ms -= 3; /*the item becomes due in 3 ms*/
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(ThreadAPI_Sleep(3));
+    STRICT_EXPECTED_CALL(ThreadAPI_Exit(0));
+
+    // act
+    (void)g_thread_funcs[0](g_thread_args[0]);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClientWorkerPool_Remove(g_pool, item);
+    IoTHubClientWorkerPool_Destroy(g_pool);
+}
+
+END_TEST_SUITE(iothub_client_worker_pool_ut)
@@ -0,0 +1,435 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#endif
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umock_c_negative_tests.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "iothub_transport_ll.h"
+#undef ENABLE_MOCKS
+
+#include "iothub_transport_pool.h"
+
+#define TEST_IOTHUBNAME "theNameoftheIotHub"
+#define TEST_IOTHUBSUFFIX "theSuffixoftheIotHubHostname"
+#define TEST_TRANSPORT_HANDLE_BASE 0x5000
+#define TEST_DEVICE_COUNT 1000
+
+static TEST_MUTEX_HANDLE test_serialize_mutex;
+static size_t g_transports_created;
+
+static const TRANSPORT_PROVIDER* provideFAKE(void)
+{
+    return NULL;
+}
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+static TRANSPORT_HANDLE my_IoTHubTransport_Create(IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol, const char* iotHubName, const char* iotHubSuffix)
+{
+    (void)protocol;
+    (void)iotHubName;
+    (void)iotHubSuffix;
+    return (TRANSPORT_HANDLE)(uintptr_t)(TEST_TRANSPORT_HANDLE_BASE + g_transports_created++);
+}
+
+/*transports are numbered in creation order, which is the connection number within a pool*/
+static size_t get_connection(IOTHUB_TRANSPORT_POOL_HANDLE pool, const char* deviceId)
+{
+    return (size_t)((uintptr_t)IoTHubTransportPool_GetTransport(pool, deviceId) - TEST_TRANSPORT_HANDLE_BASE);
+}
+
+static IOTHUB_TRANSPORT_POOL_HANDLE create_pool(size_t connection_count)
+{
+    IOTHUB_TRANSPORT_POOL_HANDLE result;
+    g_transports_created = 0;
+    result = IoTHubTransportPool_Create(provideFAKE, TEST_IOTHUBNAME, TEST_IOTHUBSUFFIX, connection_count);
+    ASSERT_IS_NOT_NULL(result);
+    return result;
+}
+
+static void set_expected_calls_for_create(size_t connection_count)
+{
+    size_t i;
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    for (i = 0; i < connection_count; i++)
+    {
+        STRICT_EXPECTED_CALL(IoTHubTransport_Create(provideFAKE, TEST_IOTHUBNAME, TEST_IOTHUBSUFFIX));
+    }
+}
+
+BEGIN_TEST_SUITE(iothub_transport_pool_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    int result;
+
+    test_serialize_mutex = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(test_serialize_mutex);
+
+    umock_c_init(on_umock_c_error);
+    result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_UMOCK_ALIAS_TYPE(TRANSPORT_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(TRANSPORT_LL_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_TRANSPORT_PROVIDER, void*);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubTransport_Create, my_IoTHubTransport_Create);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubTransport_Create, NULL);
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(test_serialize_mutex);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    TEST_MUTEX_ACQUIRE(test_serialize_mutex);
+    umock_c_reset_all_calls();
+    g_transports_created = 0;
+}
+
+TEST_FUNCTION_CLEANUP(method_cleanup)
+{
+    TEST_MUTEX_RELEASE(test_serialize_mutex);
+}
+
+/* Tests_SRS_IOTHUBTRANSPORTPOOL_41_001: [ If protocol, iotHubName or iotHubSuffix is NULL, or connection_count is 0, IoTHubTransportPool_Create shall return NULL. ]*/
+TEST_FUNCTION(IoTHubTransportPool_Create_protocol_NULL_fail)
+{
+    // act
+    IOTHUB_TRANSPORT_POOL_HANDLE result = IoTHubTransportPool_Create(NULL, TEST_IOTHUBNAME, TEST_IOTHUBSUFFIX, 2);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUBTRANSPORTPOOL_41_001: [ If protocol, iotHubName or iotHubSuffix is NULL, or connection_count is 0, IoTHubTransportPool_Create shall return NULL. ]*/
+TEST_FUNCTION(IoTHubTransportPool_Create_iothub_name_NULL_fail)
+{
+    // act
+    IOTHUB_TRANSPORT_POOL_HANDLE result = IoTHubTransportPool_Create(provideFAKE, NULL, TEST_IOTHUBSUFFIX, 2);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUBTRANSPORTPOOL_41_001: [ If protocol, iotHubName or iotHubSuffix is NULL, or connection_count is 0, IoTHubTransportPool_Create shall return NULL. ]*/
+TEST_FUNCTION(IoTHubTransportPool_Create_iothub_suffix_NULL_fail)
+{
+    // act
+    IOTHUB_TRANSPORT_POOL_HANDLE result = IoTHubTransportPool_Create(provideFAKE, TEST_IOTHUBNAME, NULL, 2);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUBTRANSPORTPOOL_41_001: [ If protocol, iotHubName or iotHubSuffix is NULL, or connection_count is 0, IoTHubTransportPool_Create shall return NULL. ]*/
+TEST_FUNCTION(IoTHubTransportPool_Create_connection_count_0_fail)
+{
+    // act
+    IOTHUB_TRANSPORT_POOL_HANDLE result = IoTHubTransportPool_Create(provideFAKE, TEST_IOTHUBNAME, TEST_IOTHUBSUFFIX, 0);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUBTRANSPORTPOOL_41_002: [ If connection_count is larger than the hash ring can hold, IoTHubTransportPool_Create shall return NULL. ]*/
+TEST_FUNCTION(IoTHubTransportPool_Create_connection_count_too_large_fail)
+{
+    // act
+    IOTHUB_TRANSPORT_POOL_HANDLE result = IoTHubTransportPool_Create(provideFAKE, TEST_IOTHUBNAME, TEST_IOTHUBSUFFIX, SIZE_MAX);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUBTRANSPORTPOOL_41_003: [ IoTHubTransportPool_Create shall create connection_count transports by calling IoTHubTransport_Create. ]*/
+TEST_FUNCTION(IoTHubTransportPool_Create_succeed)
+{
+    // arrange
+    set_expected_calls_for_create(3);
+
+    // act
+    IOTHUB_TRANSPORT_POOL_HANDLE result = IoTHubTransportPool_Create(provideFAKE, TEST_IOTHUBNAME, TEST_IOTHUBSUFFIX, 3);
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 3, IoTHubTransportPool_GetConnectionCount(result));
+
+    // cleanup
+    IoTHubTransportPool_Destroy(result);
+}
+
+/* Tests_SRS_IOTHUBTRANSPORTPOOL_41_004: [ If any allocation or transport creation fails, IoTHubTransportPool_Create shall destroy the transports it created, free all resources and return NULL. ]*/
+TEST_FUNCTION(IoTHubTransportPool_Create_fail)
+{
+    // arrange
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    set_expected_calls_for_create(3);
+    umock_c_negative_tests_snapshot();
+
+    size_t count = umock_c_negative_tests_call_count();
+    for (size_t index = 0; index < count; index++)
+    {
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(index);
+
+        char tmp_msg[64];
+        sprintf(tmp_msg, "IoTHubTransportPool_Create failure in test %lu/%lu", (unsigned long)index, (unsigned long)count);
+
+        // act
+        IOTHUB_TRANSPORT_POOL_HANDLE result = IoTHubTransportPool_Create(provideFAKE, TEST_IOTHUBNAME, TEST_IOTHUBSUFFIX, 3);
+
+        // assert
+        ASSERT_IS_NULL_WITH_MSG(result, tmp_msg);
+    }
+
+    // cleanup
+    umock_c_negative_tests_deinit();
+}
+
+/* Tests_SRS_IOTHUBTRANSPORTPOOL_41_004: [ If any allocation or transport creation fails, IoTHubTransportPool_Create shall destroy the transports it created, free all resources and return NULL. ]*/
+TEST_FUNCTION(IoTHubTransportPool_Create_transport_fail_destroys_created_transports)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(IoTHubTransport_Create(provideFAKE, TEST_IOTHUBNAME, TEST_IOTHUBSUFFIX));
+    STRICT_EXPECTED_CALL(IoTHubTransport_Create(provideFAKE, TEST_IOTHUBNAME, TEST_IOTHUBSUFFIX));
+    STRICT_EXPECTED_CALL(IoTHubTransport_Create(provideFAKE, TEST_IOTHUBNAME, TEST_IOTHUBSUFFIX)).SetReturn(NULL);
+    STRICT_EXPECTED_CALL(IoTHubTransport_Destroy((TRANSPORT_HANDLE)(uintptr_t)TEST_TRANSPORT_HANDLE_BASE));
+    STRICT_EXPECTED_CALL(IoTHubTransport_Destroy((TRANSPORT_HANDLE)(uintptr_t)(TEST_TRANSPORT_HANDLE_BASE + 1)));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    IOTHUB_TRANSPORT_POOL_HANDLE result = IoTHubTransportPool_Create(provideFAKE, TEST_IOTHUBNAME, TEST_IOTHUBSUFFIX, 3);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUBTRANSPORTPOOL_41_006: [ If transportPoolHandle is NULL, IoTHubTransportPool_Destroy shall do nothing. ]*/
+TEST_FUNCTION(IoTHubTransportPool_Destroy_NULL_succeed)
+{
+    // act
+    IoTHubTransportPool_Destroy(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUBTRANSPORTPOOL_41_007: [ IoTHubTransportPool_Destroy shall destroy every transport of the pool and free the pool. ]*/
+TEST_FUNCTION(IoTHubTransportPool_Destroy_succeed)
+{
+    // arrange
+    IOTHUB_TRANSPORT_POOL_HANDLE pool = create_pool(2);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(IoTHubTransport_Destroy((TRANSPORT_HANDLE)(uintptr_t)TEST_TRANSPORT_HANDLE_BASE));
+    STRICT_EXPECTED_CALL(IoTHubTransport_Destroy((TRANSPORT_HANDLE)(uintptr_t)(TEST_TRANSPORT_HANDLE_BASE + 1)));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    IoTHubTransportPool_Destroy(pool);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUBTRANSPORTPOOL_41_008: [ If transportPoolHandle or deviceId is NULL, IoTHubTransportPool_GetTransport shall return NULL. ]*/
+TEST_FUNCTION(IoTHubTransportPool_GetTransport_NULL_pool_fail)
+{
+    // act
+    TRANSPORT_HANDLE result = IoTHubTransportPool_GetTransport(NULL, "device");
+
+    // assert
+    ASSERT_IS_NULL(result);
+}
+
+/* Tests_SRS_IOTHUBTRANSPORTPOOL_41_008: [ If transportPoolHandle or deviceId is NULL, IoTHubTransportPool_GetTransport shall return NULL. ]*/
+TEST_FUNCTION(IoTHubTransportPool_GetTransport_NULL_device_id_fail)
+{
+    // arrange
+    IOTHUB_TRANSPORT_POOL_HANDLE pool = create_pool(2);
+
+    // act
+    TRANSPORT_HANDLE result = IoTHubTransportPool_GetTransport(pool, NULL);
+
+    // assert
+    ASSERT_IS_NULL(result);
+
+    // cleanup
+    IoTHubTransportPool_Destroy(pool);
+}
+
+/* Tests_SRS_IOTHUBTRANSPORTPOOL_41_009: [ IoTHubTransportPool_GetTransport shall return the transport owning the first point of the ring at or after the hash of deviceId, wrapping around to the first point. ]*/
+TEST_FUNCTION(IoTHubTransportPool_GetTransport_same_device_same_transport)
+{
+    // arrange
+    IOTHUB_TRANSPORT_POOL_HANDLE pool = create_pool(4);
+    umock_c_reset_all_calls();
+
+    // act
+    TRANSPORT_HANDLE first = IoTHubTransportPool_GetTransport(pool, "device42");
+    TRANSPORT_HANDLE second = IoTHubTransportPool_GetTransport(pool, "device42");
+
+    // assert
+    ASSERT_IS_NOT_NULL(first);
+    ASSERT_ARE_EQUAL(void_ptr, first, second);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubTransportPool_Destroy(pool);
+}
+
+/* Tests_SRS_IOTHUBTRANSPORTPOOL_41_009: [ IoTHubTransportPool_GetTransport shall return the transport owning the first point of the ring at or after the hash of deviceId, wrapping around to the first point. ]*/
+TEST_FUNCTION(IoTHubTransportPool_GetTransport_single_connection_returns_it)
+{
+    // arrange
+    IOTHUB_TRANSPORT_POOL_HANDLE pool = create_pool(1);
+    char deviceId[32];
+    size_t i;
+
+    // act
+    // assert
+    for (i = 0; i < 100; i++)
+    {
+        (void)sprintf(deviceId, "device%lu", (unsigned long)i);
+        ASSERT_ARE_EQUAL(size_t, 0, get_connection(pool, deviceId));
+    }
+
+    // cleanup
+    IoTHubTransportPool_Destroy(pool);
+}
+
+/* Tests_SRS_IOTHUBTRANSPORTPOOL_41_005: [ IoTHubTransportPool_Create shall place a fixed number of points per connection on a hash ring, each point depending only on its connection number. ]*/
+TEST_FUNCTION(IoTHubTransportPool_GetTransport_spreads_devices_over_connections)
+{
+    // arrange
+    IOTHUB_TRANSPORT_POOL_HANDLE pool = create_pool(4);
+    size_t devices_per_connection[4] = { 0 };
+    char deviceId[32];
+    size_t i;
+
+    // act
+    for (i = 0; i < TEST_DEVICE_COUNT; i++)
+    {
+        (void)sprintf(deviceId, "device%lu", (unsigned long)i);
+        devices_per_connection[get_connection(pool, deviceId)]++;
+    }
+
+    // assert
+    for (i = 0; i < 4; i++)
+    {
+        ASSERT_IS_TRUE(devices_per_connection[i] > (TEST_DEVICE_COUNT / 4) * 3 / 4);
+        ASSERT_IS_TRUE(devices_per_connection[i] < (TEST_DEVICE_COUNT / 4) * 5 / 4);
+    }
+
+    // cleanup
+    IoTHubTransportPool_Destroy(pool);
+}
+
+/* Tests_SRS_IOTHUBTRANSPORTPOOL_41_005: [ IoTHubTransportPool_Create shall place a fixed number of points per connection on a hash ring, each point depending only on its connection number. ]*/
+TEST_FUNCTION(IoTHubTransportPool_GetTransport_growing_pool_only_moves_devices_to_new_connection)
+{
+    // arrange
+    IOTHUB_TRANSPORT_POOL_HANDLE pool4 = create_pool(4);
+    IOTHUB_TRANSPORT_POOL_HANDLE pool5 = create_pool(5);
+    size_t moved = 0;
+    char deviceId[32];
+    size_t i;
+
+    // act
+    // assert
+    for (i = 0; i < TEST_DEVICE_COUNT; i++)
+    {
+        size_t before;
+        size_t after;
+
+        (void)sprintf(deviceId, "device%lu", (unsigned long)i);
+        before = get_connection(pool4, deviceId);
+        after = get_connection(pool5, deviceId);
+        if (before != after)
+        {
+            ASSERT_ARE_EQUAL(size_t, 4, after);
+            moved++;
+        }
+    }
+    ASSERT_IS_TRUE(moved > 0);
+    ASSERT_IS_TRUE(moved < TEST_DEVICE_COUNT / 3);
+
+    // cleanup
+    IoTHubTransportPool_Destroy(pool4);
+    IoTHubTransportPool_Destroy(pool5);
+}
+
+/* Tests_SRS_IOTHUBTRANSPORTPOOL_41_010: [ IoTHubTransportPool_GetConnectionCount shall return the number of connections of the pool, or 0 if transportPoolHandle is NULL. ]*/
+TEST_FUNCTION(IoTHubTransportPool_GetConnectionCount_NULL_returns_0)
+{
+    // act
+    size_t result = IoTHubTransportPool_GetConnectionCount(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 0, result);
+}
+
+END_TEST_SUITE(iothub_transport_pool_ut)
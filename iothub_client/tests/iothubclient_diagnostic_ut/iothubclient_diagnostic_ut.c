@@ -10,6 +10,7 @@
 #include <stddef.h>
 #include <stdint.h>
 #endif
+#include <string.h>
 
 static void* my_gballoc_malloc(size_t size)
 {
@@ -58,6 +59,19 @@ static IOTHUB_MESSAGE_HANDLE TEST_MESSAGE_HANDLE = (IOTHUB_MESSAGE_HANDLE)0x12;
 
 #define INDEFINITE_TIME ((time_t)-1)
 static time_t g_current_time;
+static char g_diagnostic_id[2][16];
+static size_t g_diagnostic_id_count;
+
+static IOTHUB_MESSAGE_RESULT my_IoTHubMessage_SetDiagnosticPropertyData(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle, const IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DATA* diagnosticData)
+{
+    (void)iotHubMessageHandle;
+    if (g_diagnostic_id_count < 2 && strlen(diagnosticData->diagnosticId) < sizeof(g_diagnostic_id[0]))
+    {
+        (void)strcpy(g_diagnostic_id[g_diagnostic_id_count], diagnosticData->diagnosticId);
+    }
+    g_diagnostic_id_count++;
+    return IOTHUB_MESSAGE_OK;
+}
 
 BEGIN_TEST_SUITE(iothubclient_diagnostic_ut)
 
@@ -82,7 +96,7 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
 
-    REGISTER_GLOBAL_MOCK_RETURN(IoTHubMessage_SetDiagnosticPropertyData, IOTHUB_MESSAGE_OK);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_SetDiagnosticPropertyData, my_IoTHubMessage_SetDiagnosticPropertyData);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubMessage_SetDiagnosticPropertyData, IOTHUB_MESSAGE_ERROR);
 
     REGISTER_GLOBAL_MOCK_RETURN(Map_Add, MAP_OK);
@@ -155,9 +169,7 @@ TEST_FUNCTION(IoTHubClient_Diagnostic_AddIfNecessary_fails)
 
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(get_time(NULL));
     STRICT_EXPECTED_CALL(IoTHubMessage_SetDiagnosticPropertyData(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 
     umock_c_negative_tests_snapshot();
@@ -210,14 +222,8 @@ TEST_FUNCTION(IoTHubClient_Diagnostic_AddIfNecessary_no_diag_info_with_percentag
     umock_c_reset_all_calls();
 
 
-    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
     EXPECTED_CALL(get_time(NULL));
     STRICT_EXPECTED_CALL(IoTHubMessage_SetDiagnosticPropertyData(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
-    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
-    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
 
     //act
     int result = IoTHubClient_Diagnostic_AddIfNecessary(&diag_setting, TEST_MESSAGE_HANDLE);
@@ -240,14 +246,8 @@ TEST_FUNCTION(IoTHubClient_Diagnostic_AddIfNecessary_no_diag_info_with_normal_pe
 
     umock_c_reset_all_calls();
 
-    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
     EXPECTED_CALL(get_time(NULL));
     STRICT_EXPECTED_CALL(IoTHubMessage_SetDiagnosticPropertyData(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
-    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
-    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
 
     //act
     for (uint32_t index = 0; index < 2; ++index)
@@ -261,4 +261,43 @@ TEST_FUNCTION(IoTHubClient_Diagnostic_AddIfNecessary_no_diag_info_with_normal_pe
     }
 }
 
+/* Tests_SRS_IOTHUB_DIAGNOSTIC_41_001: [ IoTHubClient_Diagnostic_AddIfNecessary shall build the diagnostic id and creation time on the stack, without allocating memory. ]*/
+/* Tests_SRS_IOTHUB_DIAGNOSTIC_41_002: [ The diagnostic id shall be 8 base 36 characters from a xorshift generator kept in `randomState`, seeded from the current time on the first sampled message. ]*/
+TEST_FUNCTION(IoTHubClient_Diagnostic_AddIfNecessary_generates_distinct_ids_without_allocating)
+{
+    //arrange
+    IOTHUB_DIAGNOSTIC_SETTING_DATA diag_setting =
+    {
+        100,    /*diagnostic sampling percentage*/
+        0,      /*message number*/
+        0       /*random state*/
+    };
+    size_t i;
+    g_diagnostic_id_count = 0;
+
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(IoTHubMessage_SetDiagnosticPropertyData(TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(IoTHubMessage_SetDiagnosticPropertyData(TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG));
+
+    //act
+    int result1 = IoTHubClient_Diagnostic_AddIfNecessary(&diag_setting, TEST_MESSAGE_HANDLE);
+    int result2 = IoTHubClient_Diagnostic_AddIfNecessary(&diag_setting, TEST_MESSAGE_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result1);
+    ASSERT_ARE_EQUAL(int, 0, result2);
+    ASSERT_ARE_EQUAL(size_t, 2, g_diagnostic_id_count);
+    ASSERT_IS_FALSE(diag_setting.randomState == 0);
+    for (i = 0; i < 2; i++)
+    {
+        ASSERT_ARE_EQUAL(size_t, 8, strlen(g_diagnostic_id[i]));
+        ASSERT_ARE_EQUAL(size_t, 8, strspn(g_diagnostic_id[i], "0123456789abcdefghijklmnopqrstuvwxyz"));
+    }
+    ASSERT_IS_FALSE(strcmp(g_diagnostic_id[0], g_diagnostic_id[1]) == 0);
+}
+
 END_TEST_SUITE(iothubclient_diagnostic_ut)
@@ -42,6 +42,12 @@ static void real_free(void* ptr)
 #include "azure_c_shared_utility/uniqueid.h"
 #include "azure_c_shared_utility/crt_abstractions.h"
 #include "azure_c_shared_utility/envvariable.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/agenttime.h"
+#include "azure_c_shared_utility/singlylinkedlist.h"
+#include "azure_c_shared_utility/platform.h"
+#include "azure_c_shared_utility/tlsio.h"
+#include "azure_uhttp_c/uhttp.h"
 #include "internal/iothub_client_authorization.h"
 #include "parson.h"
 
@@ -80,6 +86,15 @@ extern "C"
     int STRING_sprintf(STRING_HANDLE handle, const char* format, ...);
     STRING_HANDLE STRING_construct_sprintf(const char* format, ...);
 
+    SINGLYLINKEDLIST_HANDLE real_singlylinkedlist_create(void);
+    void real_singlylinkedlist_destroy(SINGLYLINKEDLIST_HANDLE list);
+    LIST_ITEM_HANDLE real_singlylinkedlist_add(SINGLYLINKEDLIST_HANDLE list, const void* item);
+    int real_singlylinkedlist_remove(SINGLYLINKEDLIST_HANDLE list, LIST_ITEM_HANDLE item_handle);
+    LIST_ITEM_HANDLE real_singlylinkedlist_get_head_item(SINGLYLINKEDLIST_HANDLE list);
+    LIST_ITEM_HANDLE real_singlylinkedlist_get_next_item(LIST_ITEM_HANDLE item_handle);
+    LIST_ITEM_HANDLE real_singlylinkedlist_find(SINGLYLINKEDLIST_HANDLE list, LIST_MATCH_FUNCTION match_function, const void* match_context);
+    const void* real_singlylinkedlist_item_get_value(LIST_ITEM_HANDLE item_handle);
+
 #ifdef __cplusplus
 }
 #endif
@@ -108,6 +123,8 @@ static const IOTHUB_AUTHORIZATION_HANDLE TEST_AUTHORIZATION_HANDLE = (IOTHUB_AUT
 static const IOTHUB_CLIENT_EDGE_HANDLE TEST_MODULE_CLIENT_METHOD_HANDLE = (IOTHUB_CLIENT_EDGE_HANDLE)0x0002;
 static JSON_Object* DUMMY_JSON_OBJECT = (JSON_Object*)0x0003;
 static JSON_Value* DUMMY_JSON_VALUE = (JSON_Value*)0x0004;
+static const IO_INTERFACE_DESCRIPTION* TEST_TLSIO_INTERFACE = (const IO_INTERFACE_DESCRIPTION*)0x0005;
+static void* TEST_CALLBACK_CONTEXT = (void*)0x0006;
 
 static const char* TEST_DEVICE_ID = "deviceId";
 static const char* TEST_DEVICE_ID2 = "otherDeviceId";
@@ -117,6 +134,7 @@ static const char* TEST_GATEWAY_HOST_NAME = "GatewayHostName";
 static const char* TEST_METHOD_NAME = "methodName";
 static const char* TEST_METHOD_PAYLOAD = "{payload:payload}";
 static unsigned int TEST_TIMEOUT = 47;
+static const time_t TEST_TIME = (time_t)1530000000;
 
 static const char* DUMMY_STRING = "string";
 static unsigned char* DUMMY_USTRING = (unsigned char*)"unsigned-string";
@@ -124,6 +142,18 @@ static double DUMMY_NUMBER = 47;
 static unsigned int DUMMY_UINT = 47;
 
 
+static time_t g_current_time;
+
+static ON_HTTP_OPEN_COMPLETE_CALLBACK g_on_http_open;
+static void* g_http_open_ctx;
+static ON_HTTP_REQUEST_CALLBACK g_on_http_reply;
+static void* g_http_reply_ctx;
+
+static size_t g_method_invoke_callback_count;
+static IOTHUB_CLIENT_RESULT g_method_invoke_callback_result;
+static int g_method_invoke_callback_status;
+static void* g_method_invoke_callback_context;
+
 static TEST_MUTEX_HANDLE g_testByTest;
 DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
 
@@ -237,6 +267,76 @@ static char* my_IoTHubClient_Auth_Get_TrustBundle(IOTHUB_AUTHORIZATION_HANDLE ha
     return (char*)real_malloc(1);
 }
 
+static LOCK_HANDLE my_Lock_Init(void)
+{
+    return (LOCK_HANDLE)real_malloc(1);
+}
+
+static LOCK_RESULT my_Lock_Deinit(LOCK_HANDLE handle)
+{
+    real_free(handle);
+    return LOCK_OK;
+}
+
+static time_t my_get_time(time_t* currentTime)
+{
+    (void)currentTime;
+    return g_current_time;
+}
+
+static double my_get_difftime(time_t stopTime, time_t startTime)
+{
+    return difftime(stopTime, startTime);
+}
+
+static HTTP_CLIENT_HANDLE my_uhttp_client_create(const IO_INTERFACE_DESCRIPTION* io_interface_desc, const void* xio_param, ON_HTTP_ERROR_CALLBACK on_http_error, void* callback_ctx)
+{
+    (void)io_interface_desc;
+    (void)xio_param;
+    (void)on_http_error;
+    (void)callback_ctx;
+    return (HTTP_CLIENT_HANDLE)real_malloc(1);
+}
+
+static HTTP_CLIENT_RESULT my_uhttp_client_open(HTTP_CLIENT_HANDLE handle, const char* host, int port_num, ON_HTTP_OPEN_COMPLETE_CALLBACK on_connect, void* callback_ctx)
+{
+    (void)handle;
+    (void)host;
+    (void)port_num;
+    g_on_http_open = on_connect;
+    g_http_open_ctx = callback_ctx;
+    return HTTP_CLIENT_OK;
+}
+
+static HTTP_CLIENT_RESULT my_uhttp_client_execute_request(HTTP_CLIENT_HANDLE handle, HTTP_CLIENT_REQUEST_TYPE request_type, const char* relative_path,
+    HTTP_HEADERS_HANDLE http_header_handle, const unsigned char* content, size_t content_length, ON_HTTP_REQUEST_CALLBACK on_request_callback, void* callback_ctx)
+{
+    (void)handle;
+    (void)request_type;
+    (void)relative_path;
+    (void)http_header_handle;
+    (void)content;
+    (void)content_length;
+    g_on_http_reply = on_request_callback;
+    g_http_reply_ctx = callback_ctx;
+    return HTTP_CLIENT_OK;
+}
+
+static void my_uhttp_client_destroy(HTTP_CLIENT_HANDLE handle)
+{
+    real_free(handle);
+}
+
+static void test_method_invoke_callback(IOTHUB_CLIENT_RESULT result, int responseStatus, unsigned char* responsePayload, size_t responsePayloadSize, void* context)
+{
+    (void)responsePayload;
+    (void)responsePayloadSize;
+    g_method_invoke_callback_count++;
+    g_method_invoke_callback_result = result;
+    g_method_invoke_callback_status = responseStatus;
+    g_method_invoke_callback_context = context;
+}
+
 static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
 {
     char temp_str[256];
@@ -280,37 +380,91 @@ static void createMethodPayloadExpectedCalls()
     STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));   //cannot fail
 }
 
-static void sendHttpRequestMethodExpectedCalls()
+static void createHttpConnectionExpectedCalls()
 {
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).CallCannotFail();   //cannot fail (opens a new connection)
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).CallCannotFail();
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(environment_get_variable(IGNORED_PTR_ARG)).CallCannotFail();
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
     STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(UniqueId_Generate(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));   //cannot fail
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Create(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubClient_Auth_Get_TrustBundle(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPAPIEX_SetOption(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));    //cannot fail
+}
 
+static void newSasTokenExpectedCalls()
+{
     STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(IoTHubClient_Auth_Get_SasToken(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));    //cannot fail
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));   //cannot fail
     STRICT_EXPECTED_CALL(HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+}
+
+static void executeRequestExpectedCalls()
+{
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).CallCannotFail();
+    STRICT_EXPECTED_CALL(UniqueId_Generate(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPAPIEX_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_POST, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).CallCannotFail();   //cannot fail (closes the connection)
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).CallCannotFail();
     STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));   //cannot fail
-    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));   //cannot fail
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));    //cannot fail
+}
+
+static void sendHttpRequestMethodExpectedCalls()
+{
+    createHttpConnectionExpectedCalls();
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(get_time(IGNORED_PTR_ARG)).CallCannotFail();   //cannot fail (a new token is made for every invoke)
+    newSasTokenExpectedCalls();
+    executeRequestExpectedCalls();
+}
+
+static void sendHttpRequestMethodOnOpenConnectionExpectedCalls()
+{
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(get_time(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(get_difftime(IGNORED_NUM_ARG, IGNORED_NUM_ARG));
+}
 
+static void methodInvokeAsyncExpectedCalls()
+{
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    createMethodPayloadExpectedCalls();
+    STRICT_EXPECTED_CALL(singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(get_time(IGNORED_PTR_ARG)).CallCannotFail();   //cannot fail (the invoke then never times out)
+}
+
+static void openAsyncConnectionExpectedCalls()
+{
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(environment_get_variable(IGNORED_PTR_ARG)).CallCannotFail();
     STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(HTTPAPIEX_Create(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));   //cannot fail
+    STRICT_EXPECTED_CALL(platform_get_default_tlsio());
+    STRICT_EXPECTED_CALL(uhttp_client_create(TEST_TLSIO_INTERFACE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(IoTHubClient_Auth_Get_TrustBundle(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(HTTPAPIEX_SetOption(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(HTTPAPIEX_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_POST, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG));    //cannot fail
-    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));       //cannot fail
-    STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG));   //cannot fail
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));        //cannot fail
+    STRICT_EXPECTED_CALL(uhttp_client_set_trusted_cert(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(uhttp_client_open(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 443, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));    //cannot fail
 }
 
 static void parseResponseJsonExpectedCalls()
@@ -354,6 +508,19 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_UMOCK_ALIAS_TYPE(HTTPAPIEX_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_AUTHORIZATION_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(HTTPAPI_REQUEST_TYPE, int);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(time_t, long);
+    REGISTER_UMOCK_ALIAS_TYPE(SINGLYLINKEDLIST_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LIST_ITEM_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LIST_MATCH_FUNCTION, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(HTTP_CLIENT_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(HTTP_CLIENT_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(HTTP_CLIENT_REQUEST_TYPE, int);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_HTTP_ERROR_CALLBACK, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_HTTP_OPEN_COMPLETE_CALLBACK, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_HTTP_REQUEST_CALLBACK, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_HTTP_CLOSED_CALLBACK, void*);
 
 
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, real_malloc);
@@ -418,6 +585,42 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubClient_Auth_Get_SasToken, NULL);
     REGISTER_GLOBAL_MOCK_HOOK(IoTHubClient_Auth_Get_TrustBundle, my_IoTHubClient_Auth_Get_TrustBundle);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubClient_Auth_Get_TrustBundle, NULL);
+
+    REGISTER_GLOBAL_MOCK_HOOK(Lock_Init, my_Lock_Init);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock_Init, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(Lock_Deinit, my_Lock_Deinit);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock, LOCK_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Unlock, LOCK_ERROR);
+
+    REGISTER_GLOBAL_MOCK_HOOK(get_time, my_get_time);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(get_time, (time_t)(-1));
+    REGISTER_GLOBAL_MOCK_HOOK(get_difftime, my_get_difftime);
+
+    REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_create, real_singlylinkedlist_create);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(singlylinkedlist_create, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_destroy, real_singlylinkedlist_destroy);
+    REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_add, real_singlylinkedlist_add);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(singlylinkedlist_add, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_remove, real_singlylinkedlist_remove);
+    REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_get_head_item, real_singlylinkedlist_get_head_item);
+    REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_get_next_item, real_singlylinkedlist_get_next_item);
+    REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_find, real_singlylinkedlist_find);
+    REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_item_get_value, real_singlylinkedlist_item_get_value);
+
+    REGISTER_GLOBAL_MOCK_RETURN(platform_get_default_tlsio, TEST_TLSIO_INTERFACE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(platform_get_default_tlsio, NULL);
+
+    REGISTER_GLOBAL_MOCK_HOOK(uhttp_client_create, my_uhttp_client_create);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(uhttp_client_create, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(uhttp_client_open, my_uhttp_client_open);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(uhttp_client_open, HTTP_CLIENT_ERROR);
+    REGISTER_GLOBAL_MOCK_HOOK(uhttp_client_execute_request, my_uhttp_client_execute_request);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(uhttp_client_execute_request, HTTP_CLIENT_ERROR);
+    REGISTER_GLOBAL_MOCK_HOOK(uhttp_client_destroy, my_uhttp_client_destroy);
+    REGISTER_GLOBAL_MOCK_RETURN(uhttp_client_set_trusted_cert, HTTP_CLIENT_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(uhttp_client_set_trusted_cert, HTTP_CLIENT_ERROR);
 }
 
 TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
@@ -429,6 +632,18 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
 
     umock_c_negative_tests_deinit();
     umock_c_reset_all_calls();
+
+    g_current_time = TEST_TIME;
+
+    g_on_http_open = NULL;
+    g_http_open_ctx = NULL;
+    g_on_http_reply = NULL;
+    g_http_reply_ctx = NULL;
+
+    g_method_invoke_callback_count = 0;
+    g_method_invoke_callback_result = IOTHUB_CLIENT_OK;
+    g_method_invoke_callback_status = 0;
+    g_method_invoke_callback_context = NULL;
 }
 
 TEST_SUITE_CLEANUP(suite_cleanup)
@@ -496,6 +711,7 @@ TEST_FUNCTION(IoTHubClient_EdgeHandle_Create_SUCCESS)
     STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock_Init());
 
     //act
     IOTHUB_CLIENT_EDGE_HANDLE handle = IoTHubClient_EdgeHandle_Create(&config, TEST_AUTHORIZATION_HANDLE, TEST_MODULE_ID);
@@ -522,6 +738,7 @@ TEST_FUNCTION(IoTHubClient_EdgeHandle_Create_FAIL)
     STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock_Init());
 
     umock_c_negative_tests_snapshot();
 
@@ -573,6 +790,39 @@ TEST_FUNCTION(IoTHubClient_EdgeHandle_Destroy_SUCCESS)
 
     umock_c_reset_all_calls();
 
+    STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(NULL));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    IoTHubClient_EdgeHandle_Destroy(handle);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+}
+
+TEST_FUNCTION(IoTHubClient_EdgeHandle_Destroy_closes_open_connection)
+{
+    //arrange
+    IOTHUB_CLIENT_EDGE_HANDLE handle = create_module_client_method_handle();
+    int responseStatus;
+    unsigned char* responsePayload;
+    size_t responsePayloadSize;
+
+    (void)IoTHubClient_Edge_DeviceMethodInvoke(handle, TEST_DEVICE_ID2, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_TIMEOUT, &responseStatus, &responsePayload, &responsePayloadSize);
+    free(responsePayload);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
@@ -762,7 +1012,7 @@ TEST_FUNCTION(IoTHubClient_Edge_DeviceMethodInvoke_FAIL)
     int negativeTestsInitResult = umock_c_negative_tests_init();
     ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
 
-    IOTHUB_CLIENT_EDGE_HANDLE handle = create_module_client_method_handle();
+    IOTHUB_CLIENT_EDGE_HANDLE handle;
     int responseStatus;
     unsigned char* responsePayload;
     size_t responsePayloadSize;
@@ -784,6 +1034,10 @@ TEST_FUNCTION(IoTHubClient_Edge_DeviceMethodInvoke_FAIL)
     {
         if (umock_c_negative_tests_can_call_fail(index))
         {
+            // every attempt starts without an open connection or a SAS token
+            umock_c_reset_all_calls();
+            handle = create_module_client_method_handle();
+
             umock_c_negative_tests_reset();
             umock_c_negative_tests_fail_call(index);
 
@@ -792,13 +1046,121 @@ TEST_FUNCTION(IoTHubClient_Edge_DeviceMethodInvoke_FAIL)
 
             //assert
             ASSERT_IS_TRUE(result == IOTHUB_CLIENT_ERROR, "IoTHubClient_EdgeHandle_Create_FAIL failure in test %lu", (unsigned long)index);
+
+            //cleanup
+            IoTHubClient_EdgeHandle_Destroy(handle);
         }
     }
 
     //cleanup
+    umock_c_negative_tests_deinit();
+}
+
+TEST_FUNCTION(IoTHubClient_Edge_DeviceMethodInvoke_reuses_connection_and_SAS_token)
+{
+    //arrange
+    IOTHUB_CLIENT_EDGE_HANDLE handle = create_module_client_method_handle();
+    int responseStatus;
+    unsigned char* responsePayload;
+    size_t responsePayloadSize;
+
+    (void)IoTHubClient_Edge_DeviceMethodInvoke(handle, TEST_DEVICE_ID2, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_TIMEOUT, &responseStatus, &responsePayload, &responsePayloadSize);
+    free(responsePayload);
+    umock_c_reset_all_calls();
+
+    createMethodPayloadExpectedCalls();
+    STRICT_EXPECTED_CALL(BUFFER_new());
+    sendHttpRequestMethodOnOpenConnectionExpectedCalls();
+    executeRequestExpectedCalls();
+    parseResponseJsonExpectedCalls();
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_Edge_DeviceMethodInvoke(handle, TEST_DEVICE_ID2, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_TIMEOUT, &responseStatus, &responsePayload, &responsePayloadSize);
+
+    //assert
+    ASSERT_IS_TRUE(result == IOTHUB_CLIENT_OK);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    free(responsePayload);
     IoTHubClient_EdgeHandle_Destroy(handle);
+}
 
-    umock_c_negative_tests_deinit();
+TEST_FUNCTION(IoTHubClient_Edge_DeviceMethodInvoke_refreshes_SAS_token_near_expiry)
+{
+    //arrange
+    IOTHUB_CLIENT_EDGE_HANDLE handle = create_module_client_method_handle();
+    int responseStatus;
+    unsigned char* responsePayload;
+    size_t responsePayloadSize;
+
+    (void)IoTHubClient_Edge_DeviceMethodInvoke(handle, TEST_DEVICE_ID2, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_TIMEOUT, &responseStatus, &responsePayload, &responsePayloadSize);
+    free(responsePayload);
+    umock_c_reset_all_calls();
+
+    g_current_time = TEST_TIME + 3600 - 60;
+
+    createMethodPayloadExpectedCalls();
+    STRICT_EXPECTED_CALL(BUFFER_new());
+    sendHttpRequestMethodOnOpenConnectionExpectedCalls();
+    newSasTokenExpectedCalls();
+    executeRequestExpectedCalls();
+    parseResponseJsonExpectedCalls();
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_Edge_DeviceMethodInvoke(handle, TEST_DEVICE_ID2, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_TIMEOUT, &responseStatus, &responsePayload, &responsePayloadSize);
+
+    //assert
+    ASSERT_IS_TRUE(result == IOTHUB_CLIENT_OK);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    free(responsePayload);
+    IoTHubClient_EdgeHandle_Destroy(handle);
+}
+
+TEST_FUNCTION(IoTHubClient_Edge_DeviceMethodInvoke_closes_connection_on_HTTP_failure)
+{
+    //arrange
+    IOTHUB_CLIENT_EDGE_HANDLE handle = create_module_client_method_handle();
+    int responseStatus;
+    unsigned char* responsePayload;
+    size_t responsePayloadSize;
+
+    umock_c_reset_all_calls();
+
+    createMethodPayloadExpectedCalls();
+    STRICT_EXPECTED_CALL(BUFFER_new());
+    createHttpConnectionExpectedCalls();
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(get_time(IGNORED_PTR_ARG));
+    newSasTokenExpectedCalls();
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(UniqueId_Generate(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPAPIEX_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_POST, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG))
+        .SetReturn(HTTPAPIEX_ERROR);
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_Edge_DeviceMethodInvoke(handle, TEST_DEVICE_ID2, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_TIMEOUT, &responseStatus, &responsePayload, &responsePayloadSize);
+
+    //assert
+    ASSERT_IS_TRUE(result == IOTHUB_CLIENT_ERROR);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_EdgeHandle_Destroy(handle);
 }
 
 TEST_FUNCTION(IoTHubClient_Edge_ModuleMethodInvoke_NULL_ARG_moduleMethodHandle)
@@ -997,7 +1359,7 @@ TEST_FUNCTION(IoTHubClient_Edge_ModuleMethodInvoke_FAIL)
     int negativeTestsInitResult = umock_c_negative_tests_init();
     ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
 
-    IOTHUB_CLIENT_EDGE_HANDLE handle = create_module_client_method_handle();
+    IOTHUB_CLIENT_EDGE_HANDLE handle;
     int responseStatus;
     unsigned char* responsePayload;
     size_t responsePayloadSize;
@@ -1019,6 +1381,10 @@ TEST_FUNCTION(IoTHubClient_Edge_ModuleMethodInvoke_FAIL)
     {
         if (umock_c_negative_tests_can_call_fail(index))
         {
+            // every attempt starts without an open connection or a SAS token
+            umock_c_reset_all_calls();
+            handle = create_module_client_method_handle();
+
             umock_c_negative_tests_reset();
             umock_c_negative_tests_fail_call(index);
 
@@ -1027,12 +1393,342 @@ TEST_FUNCTION(IoTHubClient_Edge_ModuleMethodInvoke_FAIL)
 
             //assert
             ASSERT_IS_TRUE(result == IOTHUB_CLIENT_ERROR, "IoTHubClient_Edge_ModuleMethodInvoke_FAIL failure in test %lu", (unsigned long)index);
+
+            //cleanup
+            IoTHubClient_EdgeHandle_Destroy(handle);
         }
     }
 
+    //cleanup
+    umock_c_negative_tests_deinit();
+}
+
+TEST_FUNCTION(IoTHubClient_Edge_DeviceMethodInvokeAsync_NULL_ARG_handle)
+{
+    //arrange
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_Edge_DeviceMethodInvokeAsync(NULL, TEST_DEVICE_ID2, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_TIMEOUT, test_method_invoke_callback, TEST_CALLBACK_CONTEXT);
+
+    //assert
+    ASSERT_IS_TRUE(result == IOTHUB_CLIENT_INVALID_ARG);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+}
+
+TEST_FUNCTION(IoTHubClient_Edge_DeviceMethodInvokeAsync_NULL_ARG_deviceId)
+{
+    //arrange
+    IOTHUB_CLIENT_EDGE_HANDLE handle = create_module_client_method_handle();
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_Edge_DeviceMethodInvokeAsync(handle, NULL, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_TIMEOUT, test_method_invoke_callback, TEST_CALLBACK_CONTEXT);
+
+    //assert
+    ASSERT_IS_TRUE(result == IOTHUB_CLIENT_INVALID_ARG);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_EdgeHandle_Destroy(handle);
+}
+
+TEST_FUNCTION(IoTHubClient_Edge_DeviceMethodInvokeAsync_NULL_ARG_methodName)
+{
+    //arrange
+    IOTHUB_CLIENT_EDGE_HANDLE handle = create_module_client_method_handle();
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_Edge_DeviceMethodInvokeAsync(handle, TEST_DEVICE_ID2, NULL, TEST_METHOD_PAYLOAD, TEST_TIMEOUT, test_method_invoke_callback, TEST_CALLBACK_CONTEXT);
+
+    //assert
+    ASSERT_IS_TRUE(result == IOTHUB_CLIENT_INVALID_ARG);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_EdgeHandle_Destroy(handle);
+}
+
+TEST_FUNCTION(IoTHubClient_Edge_DeviceMethodInvokeAsync_NULL_ARG_methodPayload)
+{
+    //arrange
+    IOTHUB_CLIENT_EDGE_HANDLE handle = create_module_client_method_handle();
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_Edge_DeviceMethodInvokeAsync(handle, TEST_DEVICE_ID2, TEST_METHOD_NAME, NULL, TEST_TIMEOUT, test_method_invoke_callback, TEST_CALLBACK_CONTEXT);
+
+    //assert
+    ASSERT_IS_TRUE(result == IOTHUB_CLIENT_INVALID_ARG);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_EdgeHandle_Destroy(handle);
+}
+
+TEST_FUNCTION(IoTHubClient_Edge_ModuleMethodInvokeAsync_NULL_ARG_moduleId)
+{
+    //arrange
+    IOTHUB_CLIENT_EDGE_HANDLE handle = create_module_client_method_handle();
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_Edge_ModuleMethodInvokeAsync(handle, TEST_DEVICE_ID2, NULL, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_TIMEOUT, test_method_invoke_callback, TEST_CALLBACK_CONTEXT);
+
+    //assert
+    ASSERT_IS_TRUE(result == IOTHUB_CLIENT_INVALID_ARG);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
     //cleanup
     IoTHubClient_EdgeHandle_Destroy(handle);
+}
+
+TEST_FUNCTION(IoTHubClient_Edge_ModuleMethodInvokeAsync_SUCCESS)
+{
+    //arrange
+    IOTHUB_CLIENT_EDGE_HANDLE handle = create_module_client_method_handle();
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(singlylinkedlist_create());
+    methodInvokeAsyncExpectedCalls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_Edge_ModuleMethodInvokeAsync(handle, TEST_DEVICE_ID2, TEST_MODULE_ID2, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_TIMEOUT, test_method_invoke_callback, TEST_CALLBACK_CONTEXT);
+
+    //assert
+    ASSERT_IS_TRUE(result == IOTHUB_CLIENT_OK);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 0, g_method_invoke_callback_count);
+
+    //cleanup
+    IoTHubClient_EdgeHandle_Destroy(handle);
+}
+
+TEST_FUNCTION(IoTHubClient_Edge_ModuleMethodInvokeAsync_FAIL)
+{
+    //arrange
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    IOTHUB_CLIENT_EDGE_HANDLE handle;
+
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(singlylinkedlist_create());
+    methodInvokeAsyncExpectedCalls();
+
+    umock_c_negative_tests_snapshot();
+
+    size_t count = umock_c_negative_tests_call_count();
+
+    for (size_t index = 0; index < count; index++)
+    {
+        if (umock_c_negative_tests_can_call_fail(index))
+        {
+            umock_c_reset_all_calls();
+            handle = create_module_client_method_handle();
+
+            umock_c_negative_tests_reset();
+            umock_c_negative_tests_fail_call(index);
+
+            //act
+            IOTHUB_CLIENT_RESULT result = IoTHubClient_Edge_ModuleMethodInvokeAsync(handle, TEST_DEVICE_ID2, TEST_MODULE_ID2, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_TIMEOUT, test_method_invoke_callback, TEST_CALLBACK_CONTEXT);
+
+            //assert
+            ASSERT_IS_TRUE(result == IOTHUB_CLIENT_ERROR, "IoTHubClient_Edge_ModuleMethodInvokeAsync_FAIL failure in test %lu", (unsigned long)index);
+
+            //cleanup
+            IoTHubClient_EdgeHandle_Destroy(handle);
+        }
+    }
+
+    //cleanup
     umock_c_negative_tests_deinit();
+    ASSERT_ARE_EQUAL(size_t, 0, g_method_invoke_callback_count);
+}
+
+TEST_FUNCTION(IoTHubClient_Edge_DoWork_without_invokes_does_nothing)
+{
+    //arrange
+    IOTHUB_CLIENT_EDGE_HANDLE handle = create_module_client_method_handle();
+    umock_c_reset_all_calls();
+
+    //act
+    IoTHubClient_Edge_DoWork(handle);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_EdgeHandle_Destroy(handle);
+}
+
+TEST_FUNCTION(IoTHubClient_Edge_DoWork_opens_connection_for_waiting_invoke)
+{
+    //arrange
+    IOTHUB_CLIENT_EDGE_HANDLE handle = create_module_client_method_handle();
+    (void)IoTHubClient_Edge_DeviceMethodInvokeAsync(handle, TEST_DEVICE_ID2, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_TIMEOUT, test_method_invoke_callback, TEST_CALLBACK_CONTEXT);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(get_time(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(get_difftime(IGNORED_NUM_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
+    openAsyncConnectionExpectedCalls();
+    STRICT_EXPECTED_CALL(singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+
+    //act
+    IoTHubClient_Edge_DoWork(handle);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NOT_NULL(g_on_http_open);
+    ASSERT_IS_NULL(g_on_http_reply);
+    ASSERT_ARE_EQUAL(size_t, 0, g_method_invoke_callback_count);
+
+    //cleanup
+    IoTHubClient_EdgeHandle_Destroy(handle);
+}
+
+TEST_FUNCTION(IoTHubClient_Edge_DoWork_sends_invoke_once_connected)
+{
+    //arrange
+    IOTHUB_CLIENT_EDGE_HANDLE handle = create_module_client_method_handle();
+    (void)IoTHubClient_Edge_DeviceMethodInvokeAsync(handle, TEST_DEVICE_ID2, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_TIMEOUT, test_method_invoke_callback, TEST_CALLBACK_CONTEXT);
+    IoTHubClient_Edge_DoWork(handle);
+    g_on_http_open(g_http_open_ctx, HTTP_CALLBACK_REASON_OK);
+    umock_c_reset_all_calls();
+
+    //act
+    IoTHubClient_Edge_DoWork(handle);
+
+    //assert
+    ASSERT_IS_NOT_NULL(g_on_http_reply);
+    ASSERT_ARE_EQUAL(size_t, 0, g_method_invoke_callback_count);
+
+    //cleanup
+    IoTHubClient_EdgeHandle_Destroy(handle);
+}
+
+TEST_FUNCTION(IoTHubClient_Edge_DoWork_reports_reply_to_callback)
+{
+    //arrange
+    IOTHUB_CLIENT_EDGE_HANDLE handle = create_module_client_method_handle();
+    (void)IoTHubClient_Edge_DeviceMethodInvokeAsync(handle, TEST_DEVICE_ID2, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_TIMEOUT, test_method_invoke_callback, TEST_CALLBACK_CONTEXT);
+    IoTHubClient_Edge_DoWork(handle);
+    g_on_http_open(g_http_open_ctx, HTTP_CALLBACK_REASON_OK);
+    IoTHubClient_Edge_DoWork(handle);
+    g_on_http_reply(g_http_reply_ctx, HTTP_CALLBACK_REASON_OK, DUMMY_USTRING, strlen((const char*)DUMMY_USTRING), 200, NULL);
+    umock_c_reset_all_calls();
+
+    //act
+    IoTHubClient_Edge_DoWork(handle);
+
+    //assert
+    ASSERT_ARE_EQUAL(size_t, 1, g_method_invoke_callback_count);
+    ASSERT_IS_TRUE(g_method_invoke_callback_result == IOTHUB_CLIENT_OK);
+    ASSERT_ARE_EQUAL(int, (int)DUMMY_NUMBER, g_method_invoke_callback_status);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_CALLBACK_CONTEXT, g_method_invoke_callback_context);
+
+    //cleanup
+    IoTHubClient_EdgeHandle_Destroy(handle);
+    ASSERT_ARE_EQUAL(size_t, 1, g_method_invoke_callback_count);
+}
+
+TEST_FUNCTION(IoTHubClient_Edge_DoWork_reports_error_status_to_callback)
+{
+    //arrange
+    IOTHUB_CLIENT_EDGE_HANDLE handle = create_module_client_method_handle();
+    (void)IoTHubClient_Edge_DeviceMethodInvokeAsync(handle, TEST_DEVICE_ID2, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_TIMEOUT, test_method_invoke_callback, TEST_CALLBACK_CONTEXT);
+    IoTHubClient_Edge_DoWork(handle);
+    g_on_http_open(g_http_open_ctx, HTTP_CALLBACK_REASON_OK);
+    IoTHubClient_Edge_DoWork(handle);
+    g_on_http_reply(g_http_reply_ctx, HTTP_CALLBACK_REASON_OK, NULL, 0, 404, NULL);
+    umock_c_reset_all_calls();
+
+    //act
+    IoTHubClient_Edge_DoWork(handle);
+
+    //assert
+    ASSERT_ARE_EQUAL(size_t, 1, g_method_invoke_callback_count);
+    ASSERT_IS_TRUE(g_method_invoke_callback_result == IOTHUB_CLIENT_ERROR);
+
+    //cleanup
+    IoTHubClient_EdgeHandle_Destroy(handle);
+}
+
+TEST_FUNCTION(IoTHubClient_Edge_DoWork_times_out_invoke)
+{
+    //arrange
+    IOTHUB_CLIENT_EDGE_HANDLE handle = create_module_client_method_handle();
+    (void)IoTHubClient_Edge_DeviceMethodInvokeAsync(handle, TEST_DEVICE_ID2, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_TIMEOUT, test_method_invoke_callback, TEST_CALLBACK_CONTEXT);
+    IoTHubClient_Edge_DoWork(handle);
+    g_on_http_open(g_http_open_ctx, HTTP_CALLBACK_REASON_OK);
+    IoTHubClient_Edge_DoWork(handle);
+    g_current_time = TEST_TIME + TEST_TIMEOUT + 31;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(uhttp_client_close(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(uhttp_client_destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG));
+
+    //act
+    IoTHubClient_Edge_DoWork(handle);
+
+    //assert
+    ASSERT_ARE_EQUAL(size_t, 1, g_method_invoke_callback_count);
+    ASSERT_IS_TRUE(g_method_invoke_callback_result == IOTHUB_CLIENT_ERROR);
+
+    //cleanup
+    IoTHubClient_EdgeHandle_Destroy(handle);
+    ASSERT_ARE_EQUAL(size_t, 1, g_method_invoke_callback_count);
+}
+
+TEST_FUNCTION(IoTHubClient_Edge_DoWork_fails_invoke_when_send_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_EDGE_HANDLE handle = create_module_client_method_handle();
+    (void)IoTHubClient_Edge_DeviceMethodInvokeAsync(handle, TEST_DEVICE_ID2, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_TIMEOUT, test_method_invoke_callback, TEST_CALLBACK_CONTEXT);
+    IoTHubClient_Edge_DoWork(handle);
+    g_on_http_open(g_http_open_ctx, HTTP_CALLBACK_REASON_OK);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(uhttp_client_execute_request(IGNORED_PTR_ARG, HTTP_CLIENT_REQUEST_POST, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .SetReturn(HTTP_CLIENT_ERROR);
+
+    //act
+    IoTHubClient_Edge_DoWork(handle);
+
+    //assert
+    ASSERT_ARE_EQUAL(size_t, 1, g_method_invoke_callback_count);
+    ASSERT_IS_TRUE(g_method_invoke_callback_result == IOTHUB_CLIENT_ERROR);
+
+    //cleanup
+    IoTHubClient_EdgeHandle_Destroy(handle);
+}
+
+TEST_FUNCTION(IoTHubClient_EdgeHandle_Destroy_fails_pending_invokes)
+{
+    //arrange
+    IOTHUB_CLIENT_EDGE_HANDLE handle = create_module_client_method_handle();
+    (void)IoTHubClient_Edge_DeviceMethodInvokeAsync(handle, TEST_DEVICE_ID2, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_TIMEOUT, test_method_invoke_callback, TEST_CALLBACK_CONTEXT);
+    IoTHubClient_Edge_DoWork(handle);
+    umock_c_reset_all_calls();
+
+    //act
+    IoTHubClient_EdgeHandle_Destroy(handle);
+
+    //assert
+    ASSERT_ARE_EQUAL(size_t, 1, g_method_invoke_callback_count);
+    ASSERT_IS_TRUE(g_method_invoke_callback_result == IOTHUB_CLIENT_ERROR);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_CALLBACK_CONTEXT, g_method_invoke_callback_context);
 }
 
 END_TEST_SUITE(iothubclient_edge_ut)
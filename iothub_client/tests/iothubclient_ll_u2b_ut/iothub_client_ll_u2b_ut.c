@@ -3,8 +3,10 @@
 
 #ifdef __cplusplus
 #include <cstdlib>
+#include <cstdio>
 #else
 #include <stdlib.h>
+#include <stdio.h>
 #endif
 
 static void* my_gballoc_malloc(size_t size)
@@ -38,6 +40,7 @@ static void* my_gballoc_calloc(size_t nmemb, size_t size)
 #define ENABLE_MOCKS
 
 #include "azure_c_shared_utility/agenttime.h"
+#include "azure_c_shared_utility/lock.h"
 #include "azure_c_shared_utility/httpapiex.h"
 #include "azure_c_shared_utility/httpapiexsas.h"
 #include "azure_c_shared_utility/strings.h"
@@ -47,6 +50,7 @@ static void* my_gballoc_calloc(size_t nmemb, size_t size)
 
 #include "internal/blob.h"
 #include "internal/iothub_client_authorization.h"
+#include "internal/iothub_client_trust_store.h"
 
 #include "parson.h"
 
@@ -79,6 +83,8 @@ static const char* const TEST_CERT = "test_cert";
 static const unsigned char* TEST_SOURCE = (const unsigned char*)0x3;
 static const size_t TEST_SOURCE_LENGTH = 3;
 static const char* const TEST_DESTINATION_FILENAME = "text.txt";
+static const char* const TEST_SOURCE_FILE_PATH = "iothub_client_ll_u2b_ut_source.bin";
+static const char* const TEST_MANIFEST_FILE_PATH = "iothub_client_ll_u2b_ut_source.bin.upload";
 
 #ifdef __cplusplus
 extern "C"
@@ -195,6 +201,20 @@ static void my_HTTPAPIEX_Destroy(HTTPAPIEX_HANDLE handle)
     my_gballoc_free(handle);
 }
 
+static BLOB_RESULT my_Blob_UploadMultipleBlocksOnConnection(BLOB_CONNECTION_HANDLE connection, const char* SASURI, IOTHUB_CLIENT_FILE_UPLOAD_GET_DATA_CALLBACK_EX getDataCallbackEx, void* context, unsigned int* httpStatus, BUFFER_HANDLE httpResponse, const char* certificates, HTTP_PROXY_OPTIONS* proxyOptions, unsigned int committedBlockCount)
+{
+    (void)connection;
+    (void)SASURI;
+    (void)getDataCallbackEx;
+    (void)context;
+    (void)httpResponse;
+    (void)certificates;
+    (void)proxyOptions;
+    (void)committedBlockCount;
+    *httpStatus = 200;
+    return BLOB_OK;
+}
+
 static HTTPAPIEX_SAS_HANDLE my_HTTPAPIEX_SAS_Create(STRING_HANDLE key, STRING_HANDLE uriResource, STRING_HANDLE keyName)
 {
     (void)key;
@@ -270,6 +290,11 @@ static int my_mallocAndStrcpy_s(char** destination, const char* source)
     return 0;
 }
 
+static const char* my_trust_store_acquire(const char* certificates)
+{
+    return certificates;
+}
+
 static char* my_IoTHubClient_Auth_Get_SasToken(IOTHUB_AUTHORIZATION_HANDLE handle, const char* scope, size_t expiry_time_relative_seconds, const char* key_name)
 {
     (void)handle;
@@ -430,6 +455,8 @@ static unsigned char TestValid_BUFFER_u_char[] = { '3', '\0' };
 static char TEST_DEFAULT_STRING_VALUE[2] = { '3', '\0' };
 
 static IOTHUB_AUTHORIZATION_HANDLE TEST_AUTH_HANDLE = (IOTHUB_AUTHORIZATION_HANDLE)0x123456;
+static LOCK_HANDLE TEST_LOCK_HANDLE = (LOCK_HANDLE)0x4244;
+static BLOB_CONNECTION_HANDLE TEST_BLOB_CONNECTION = (BLOB_CONNECTION_HANDLE)0x4245;
 
 // We store many return values during run of UploadToBlob UT to make sure they're processed correctly later.
 // We need these to exist outside the scope of setup_upload_to_blob_happypath, which is deleted prior to invoking UT itself.
@@ -484,6 +511,9 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_TYPE(IOTHUB_CREDENTIAL_TYPE, IOTHUB_CREDENTIAL_TYPE);
     REGISTER_TYPE(BLOB_RESULT, BLOB_RESULT);
     REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(time_t, long);
+    REGISTER_UMOCK_ALIAS_TYPE(BLOB_CONNECTION_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(BUFFER_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(char **, void*);
     REGISTER_UMOCK_ALIAS_TYPE(STRING_HANDLE, void*);
@@ -565,9 +595,26 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
 
     REGISTER_GLOBAL_MOCK_RETURN(Blob_UploadMultipleBlocksFromSasUri, BLOB_OK);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(Blob_UploadMultipleBlocksFromSasUri, BLOB_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(Blob_ResumeMultipleBlocksFromSasUri, BLOB_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Blob_ResumeMultipleBlocksFromSasUri, BLOB_ERROR);
+    REGISTER_GLOBAL_MOCK_HOOK(Blob_UploadMultipleBlocksOnConnection, my_Blob_UploadMultipleBlocksOnConnection);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Blob_UploadMultipleBlocksOnConnection, BLOB_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(Blob_UploadMultipleBlocksInParallel, BLOB_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Blob_UploadMultipleBlocksInParallel, BLOB_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(Blob_Connection_Create, TEST_BLOB_CONNECTION);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Blob_Connection_Create, NULL);
+
+    REGISTER_GLOBAL_MOCK_RETURN(Lock_Init, TEST_LOCK_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock_Init, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock_Deinit, LOCK_OK);
 
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(mallocAndStrcpy_s, __FAILURE__);
     REGISTER_GLOBAL_MOCK_HOOK(mallocAndStrcpy_s, my_mallocAndStrcpy_s);
+
+    REGISTER_GLOBAL_MOCK_HOOK(trust_store_acquire, my_trust_store_acquire);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(trust_store_acquire, NULL);
 }
 
 TEST_SUITE_CLEANUP(TestClassCleanup)
@@ -721,7 +768,7 @@ static void setup_steps_3(IOTHUB_CREDENTIAL_TYPE cred_type)
     STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
 }
 
-static void setup_Blob_UploadMultipleBlocksFromSasUri_mocks(IOTHUB_CREDENTIAL_TYPE cred_type, bool blob_fail)
+static void setup_Blob_UploadMultipleBlocksFromSasUri_mocks(IOTHUB_CREDENTIAL_TYPE cred_type, bool blob_fail, unsigned int committed_block_count)
 {
     STRICT_EXPECTED_CALL(BUFFER_new());
     STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)).CallCannotFail();
@@ -740,8 +787,16 @@ static void setup_Blob_UploadMultipleBlocksFromSasUri_mocks(IOTHUB_CREDENTIAL_TY
     else
     {
         status_code = 200;
-        STRICT_EXPECTED_CALL(Blob_UploadMultipleBlocksFromSasUri(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .CopyOutArgumentBuffer_httpStatus(&status_code, sizeof(status_code)).CallCannotFail();
+        if (committed_block_count == 0)
+        {
+            STRICT_EXPECTED_CALL(Blob_UploadMultipleBlocksFromSasUri(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+                .CopyOutArgumentBuffer_httpStatus(&status_code, sizeof(status_code)).CallCannotFail();
+        }
+        else
+        {
+            STRICT_EXPECTED_CALL(Blob_ResumeMultipleBlocksFromSasUri(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, committed_block_count))
+                .CopyOutArgumentBuffer_httpStatus(&status_code, sizeof(status_code)).CallCannotFail();
+        }
 
         STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG)).CallCannotFail();
         STRICT_EXPECTED_CALL(STRING_length(IGNORED_PTR_ARG)).CallCannotFail();
@@ -754,7 +809,7 @@ static void setup_Blob_UploadMultipleBlocksFromSasUri_mocks(IOTHUB_CREDENTIAL_TY
     }
 }
 
-static void setup_upload_blocks_mocks(IOTHUB_CREDENTIAL_TYPE cred_type, bool proxy, bool set_timeout, bool trusted_cert, bool blob_fail)
+static void setup_resumed_upload_blocks_mocks(IOTHUB_CREDENTIAL_TYPE cred_type, bool proxy, bool set_timeout, bool trusted_cert, bool blob_fail, unsigned int committed_block_count)
 {
     STRICT_EXPECTED_CALL(HTTPAPIEX_Create(IGNORED_PTR_ARG));
     if (set_timeout)
@@ -781,7 +836,7 @@ static void setup_upload_blocks_mocks(IOTHUB_CREDENTIAL_TYPE cred_type, bool pro
 
     setup_steps_1_and_2_mocks(cred_type);
 
-    setup_Blob_UploadMultipleBlocksFromSasUri_mocks(cred_type, blob_fail);
+    setup_Blob_UploadMultipleBlocksFromSasUri_mocks(cred_type, blob_fail, committed_block_count);
 
     STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG));
@@ -790,6 +845,11 @@ static void setup_upload_blocks_mocks(IOTHUB_CREDENTIAL_TYPE cred_type, bool pro
     STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG));
 }
 
+static void setup_upload_blocks_mocks(IOTHUB_CREDENTIAL_TYPE cred_type, bool proxy, bool set_timeout, bool trusted_cert, bool blob_fail)
+{
+    setup_resumed_upload_blocks_mocks(cred_type, proxy, set_timeout, trusted_cert, blob_fail, 0);
+}
+
 TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_Create_sas_token_succeeds)
 {
     //arrange
@@ -1314,7 +1374,8 @@ TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_SetOption_x509_trusted_cert_succeeds)
     IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS, TEST_AUTH_HANDLE);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_CERT));
+    STRICT_EXPECTED_CALL(trust_store_acquire(TEST_CERT));
+    STRICT_EXPECTED_CALL(trust_store_release(NULL));
 
     //act
     IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadToBlob_SetOption(h, OPTION_TRUSTED_CERT, TEST_CERT);
@@ -1364,4 +1425,461 @@ TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_SetOption_x509_timeout_succeeds)
     IoTHubClient_LL_UploadToBlob_Destroy(h);
 }
 
+/*Tests_SRS_IOTHUBCLIENT_LL_41_047: [ If `handle`, `destinationFileName` or `sourceFilePath` is `NULL` then `IoTHubClient_LL_UploadFileToBlob_Impl` shall fail and return `IOTHUB_CLIENT_INVALID_ARG`. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadFileToBlob_Impl_sourceFilePath_NULL_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS, TEST_AUTH_HANDLE);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadFileToBlob_Impl(h, TEST_DESTINATION_FILENAME, NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_050: [ If the file cannot be opened or the block buffer cannot be allocated then `IoTHubClient_LL_UploadFileToBlob_Impl` shall fail and return `IOTHUB_CLIENT_ERROR`. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadFileToBlob_Impl_missing_file_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS, TEST_AUTH_HANDLE);
+    (void)remove(TEST_SOURCE_FILE_PATH);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadFileToBlob_Impl(h, TEST_DESTINATION_FILENAME, TEST_SOURCE_FILE_PATH);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_051: [ `IoTHubClient_LL_UploadFileToBlob_Impl` shall call `IoTHubClient_LL_UploadMultipleBlocksToBlob_Impl` with a callback reading the file and return its result. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadFileToBlob_Impl_succeeds)
+{
+    //arrange
+    FILE* sourceFile = fopen(TEST_SOURCE_FILE_PATH, "wb");
+    ASSERT_IS_NOT_NULL(sourceFile);
+    ASSERT_ARE_EQUAL(size_t, 1, fwrite("3", 1, 1, sourceFile));
+    (void)fclose(sourceFile);
+
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS, TEST_AUTH_HANDLE);
+    (void)IoTHubClient_LL_UploadToBlob_SetOption(h, OPTION_TRUSTED_CERT, TEST_CERT);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(BLOCK_SIZE));
+    setup_upload_blocks_mocks(IOTHUB_CREDENTIAL_TYPE_SAS_TOKEN, false, false, true, false);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadFileToBlob_Impl(h, TEST_DESTINATION_FILENAME, TEST_SOURCE_FILE_PATH);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+    (void)remove(TEST_SOURCE_FILE_PATH);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_058: [ If optionName is `OPTION_BLOB_UPLOAD_RESUMABLE` then `IoTHubClient_LL_UploadToBlob_SetOption` shall save the bool pointed to by `value` and return `IOTHUB_CLIENT_OK`. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_SetOption_resumable_succeeds)
+{
+    //arrange
+    bool resumable = true;
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS, TEST_AUTH_HANDLE);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadToBlob_SetOption(h, OPTION_BLOB_UPLOAD_RESUMABLE, &resumable);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_067: [ If optionName is `OPTION_BLOB_UPLOAD_KEEP_ALIVE_SECS` then `IoTHubClient_LL_UploadToBlob_SetOption` shall save the size_t pointed to by `value` and return `IOTHUB_CLIENT_OK`. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_41_069: [ When an option is set successfully, `IoTHubClient_LL_UploadToBlob_SetOption` shall destroy the kept connections so that the next upload applies the new options. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_SetOption_keep_alive_succeeds)
+{
+    //arrange
+    size_t keep_alive = 30;
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS, TEST_AUTH_HANDLE);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadToBlob_SetOption(h, OPTION_BLOB_UPLOAD_KEEP_ALIVE_SECS, &keep_alive);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_068: [ If creating the lock guarding the kept connections fails, `IoTHubClient_LL_UploadToBlob_SetOption` shall fail and return `IOTHUB_CLIENT_ERROR`. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_SetOption_keep_alive_Lock_Init_fails)
+{
+    //arrange
+    size_t keep_alive = 30;
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS, TEST_AUTH_HANDLE);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock_Init()).SetReturn(NULL);
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadToBlob_SetOption(h, OPTION_BLOB_UPLOAD_KEEP_ALIVE_SECS, &keep_alive);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_063: [ If `OPTION_BLOB_UPLOAD_KEEP_ALIVE_SECS` is not 0 and an HTTPAPIEX_HANDLE to the IoTHub hostname kept from a previous upload has been idle for at most that many seconds, IoTHubClient_LL_UploadMultipleBlocksToBlob(Ex) shall reuse it without setting its options again. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_41_064: [ If `OPTION_BLOB_UPLOAD_KEEP_ALIVE_SECS` is not 0 and the upload succeeded, IoTHubClient_LL_UploadMultipleBlocksToBlob(Ex) shall keep the HTTPAPIEX_HANDLE for the next upload instead of destroying it. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_41_066: [ If `OPTION_BLOB_UPLOAD_KEEP_ALIVE_SECS` is not 0, IoTHubClient_LL_UploadMultipleBlocksToBlob(Ex) shall upload the blocks with `Blob_UploadMultipleBlocksOnConnection` so that the storage connection is kept for the next upload. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_Impl_with_keep_alive_reuses_the_connections)
+{
+    //arrange
+    size_t keep_alive = 30;
+    unsigned int status_code = 200;
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS, TEST_AUTH_HANDLE);
+    (void)IoTHubClient_LL_UploadToBlob_SetOption(h, OPTION_TRUSTED_CERT, TEST_CERT);
+    (void)IoTHubClient_LL_UploadToBlob_SetOption(h, OPTION_BLOB_UPLOAD_KEEP_ALIVE_SECS, &keep_alive);
+    (void)IoTHubClient_LL_UploadToBlob_Impl(h, TEST_DESTINATION_FILENAME, TEST_SOURCE, TEST_SOURCE_LENGTH);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(get_difftime(IGNORED_NUM_ARG, IGNORED_NUM_ARG)).SetReturn(1.0);
+
+    STRICT_EXPECTED_CALL(STRING_new());
+    STRICT_EXPECTED_CALL(STRING_new());
+    STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
+
+    setup_steps_1_and_2_mocks(IOTHUB_CREDENTIAL_TYPE_SAS_TOKEN);
+
+    STRICT_EXPECTED_CALL(BUFFER_new());
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)).CallCannotFail();
+    STRICT_EXPECTED_CALL(Blob_UploadMultipleBlocksOnConnection(TEST_BLOB_CONNECTION, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, 0))
+        .CopyOutArgumentBuffer_httpStatus(&status_code, sizeof(status_code));
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG)).CallCannotFail();
+    STRICT_EXPECTED_CALL(STRING_length(IGNORED_PTR_ARG)).CallCannotFail();
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)).CallCannotFail();
+    STRICT_EXPECTED_CALL(BUFFER_create(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    setup_steps_3(IOTHUB_CREDENTIAL_TYPE_SAS_TOKEN);
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadToBlob_Impl(h, TEST_DESTINATION_FILENAME, TEST_SOURCE, TEST_SOURCE_LENGTH);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_172: [ If optionName is `OPTION_BLOB_UPLOAD_PARALLELISM` then `IoTHubClient_LL_UploadToBlob_SetOption` shall save the size_t pointed to by `value` and return `IOTHUB_CLIENT_OK`. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_SetOption_parallelism_succeeds)
+{
+    //arrange
+    size_t parallelism = 4;
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS, TEST_AUTH_HANDLE);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadToBlob_SetOption(h, OPTION_BLOB_UPLOAD_PARALLELISM, &parallelism);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_173: [ If the parallelism of the upload is greater than 1, IoTHubClient_LL_UploadMultipleBlocksToBlob(Ex) shall upload the blocks with `Blob_UploadMultipleBlocksInParallel`, passing the kept storage connection if `OPTION_BLOB_UPLOAD_KEEP_ALIVE_SECS` is not 0 and NULL otherwise. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_41_174: [ `IoTHubClient_LL_UploadMultipleBlocksToBlob_Impl` shall upload with the parallelism set by `OPTION_BLOB_UPLOAD_PARALLELISM`. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_Impl_with_parallelism_uploads_the_blocks_in_parallel)
+{
+    //arrange
+    size_t parallelism = 4;
+    unsigned int status_code = 200;
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS, TEST_AUTH_HANDLE);
+    (void)IoTHubClient_LL_UploadToBlob_SetOption(h, OPTION_BLOB_UPLOAD_PARALLELISM, &parallelism);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Create(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_new());
+    STRICT_EXPECTED_CALL(STRING_new());
+    STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
+
+    setup_steps_1_and_2_mocks(IOTHUB_CREDENTIAL_TYPE_SAS_TOKEN);
+
+    STRICT_EXPECTED_CALL(BUFFER_new());
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)).CallCannotFail();
+    STRICT_EXPECTED_CALL(Blob_UploadMultipleBlocksInParallel(NULL, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, 0, 4))
+        .CopyOutArgumentBuffer_httpStatus(&status_code, sizeof(status_code));
+    STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG)).CallCannotFail();
+    STRICT_EXPECTED_CALL(STRING_length(IGNORED_PTR_ARG)).CallCannotFail();
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)).CallCannotFail();
+    STRICT_EXPECTED_CALL(BUFFER_create(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    setup_steps_3(IOTHUB_CREDENTIAL_TYPE_SAS_TOKEN);
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadToBlob_Impl(h, TEST_DESTINATION_FILENAME, TEST_SOURCE, TEST_SOURCE_LENGTH);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_065: [ A kept HTTPAPIEX_HANDLE that has been idle for longer than `OPTION_BLOB_UPLOAD_KEEP_ALIVE_SECS` shall be destroyed and a new one created. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_Impl_with_keep_alive_replaces_an_idle_hub_connection)
+{
+    //arrange
+    size_t keep_alive = 30;
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS, TEST_AUTH_HANDLE);
+    (void)IoTHubClient_LL_UploadToBlob_SetOption(h, OPTION_BLOB_UPLOAD_KEEP_ALIVE_SECS, &keep_alive);
+    (void)IoTHubClient_LL_UploadToBlob_Impl(h, TEST_DESTINATION_FILENAME, TEST_SOURCE, TEST_SOURCE_LENGTH);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(get_difftime(IGNORED_NUM_ARG, IGNORED_NUM_ARG)).SetReturn(31.0);
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Create(IGNORED_PTR_ARG)).SetReturn(NULL); /*stops the upload right after the new connection*/
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadToBlob_Impl(h, TEST_DESTINATION_FILENAME, TEST_SOURCE, TEST_SOURCE_LENGTH);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_145: [ If the upload failed but every `HTTPAPIEX_ExecuteRequest` to the IoTHub hostname was carried out, IoTHubClient_LL_UploadMultipleBlocksToBlob(Ex) shall keep the HTTPAPIEX_HANDLE as well, so that the next upload does not open a new connection (and proxy tunnel) to the IoTHub. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_Impl_with_keep_alive_keeps_the_hub_connection_when_storage_fails)
+{
+    //arrange
+    size_t keep_alive = 30;
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS, TEST_AUTH_HANDLE);
+    (void)IoTHubClient_LL_UploadToBlob_SetOption(h, OPTION_BLOB_UPLOAD_KEEP_ALIVE_SECS, &keep_alive);
+    (void)IoTHubClient_LL_UploadToBlob_Impl(h, TEST_DESTINATION_FILENAME, TEST_SOURCE, TEST_SOURCE_LENGTH);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(get_difftime(IGNORED_NUM_ARG, IGNORED_NUM_ARG)).SetReturn(1.0);
+
+    STRICT_EXPECTED_CALL(STRING_new());
+    STRICT_EXPECTED_CALL(STRING_new());
+    STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
+
+    setup_steps_1_and_2_mocks(IOTHUB_CREDENTIAL_TYPE_SAS_TOKEN);
+
+    STRICT_EXPECTED_CALL(BUFFER_new());
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)).CallCannotFail();
+    STRICT_EXPECTED_CALL(Blob_UploadMultipleBlocksOnConnection(TEST_BLOB_CONNECTION, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, 0))
+        .SetReturn(BLOB_ERROR);
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(BUFFER_build(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    setup_steps_3(IOTHUB_CREDENTIAL_TYPE_SAS_TOKEN);
+
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadToBlob_Impl(h, TEST_DESTINATION_FILENAME, TEST_SOURCE, TEST_SOURCE_LENGTH);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_145: [ If the upload failed but every `HTTPAPIEX_ExecuteRequest` to the IoTHub hostname was carried out, IoTHubClient_LL_UploadMultipleBlocksToBlob(Ex) shall keep the HTTPAPIEX_HANDLE as well, so that the next upload does not open a new connection (and proxy tunnel) to the IoTHub. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_Impl_with_keep_alive_destroys_the_hub_connection_when_a_request_fails)
+{
+    //arrange
+    size_t keep_alive = 30;
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS, TEST_AUTH_HANDLE);
+    (void)IoTHubClient_LL_UploadToBlob_SetOption(h, OPTION_BLOB_UPLOAD_KEEP_ALIVE_SECS, &keep_alive);
+    (void)IoTHubClient_LL_UploadToBlob_Impl(h, TEST_DESTINATION_FILENAME, TEST_SOURCE, TEST_SOURCE_LENGTH);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(get_difftime(IGNORED_NUM_ARG, IGNORED_NUM_ARG)).SetReturn(1.0);
+
+    STRICT_EXPECTED_CALL(STRING_new());
+    STRICT_EXPECTED_CALL(STRING_new());
+    STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
+
+    STRICT_EXPECTED_CALL(STRING_length(IGNORED_PTR_ARG)).CallCannotFail();
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)).CallCannotFail();
+    STRICT_EXPECTED_CALL(BUFFER_create(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_new());
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)).CallCannotFail();
+    STRICT_EXPECTED_CALL(HTTPAPIEX_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_POST, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG))
+        .SetReturn(HTTPAPIEX_ERROR);
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+
+    STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadToBlob_Impl(h, TEST_DESTINATION_FILENAME, TEST_SOURCE, TEST_SOURCE_LENGTH);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+}
+
+#ifdef USE_PAYLOAD_COMPRESSION
+/*Tests_SRS_IOTHUBCLIENT_LL_41_061: [ If optionName is `OPTION_BLOB_UPLOAD_GZIP` then `IoTHubClient_LL_UploadToBlob_SetOption` shall save the bool pointed to by `value` and return `IOTHUB_CLIENT_OK`. ]*/
+#else
+/*Tests_SRS_IOTHUBCLIENT_LL_41_062: [ If the SDK is built without `use_payload_compression`, setting `OPTION_BLOB_UPLOAD_GZIP` shall fail and return `IOTHUB_CLIENT_ERROR`. ]*/
+#endif
+TEST_FUNCTION(IoTHubClient_LL_UploadToBlob_SetOption_gzip)
+{
+    //arrange
+    bool gzip = true;
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS, TEST_AUTH_HANDLE);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadToBlob_SetOption(h, OPTION_BLOB_UPLOAD_GZIP, &gzip);
+
+    //assert
+#ifdef USE_PAYLOAD_COMPRESSION
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+#else
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+#endif
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_41_055: [ If `blob_upload_resumable` is on and the manifest records blocks acknowledged for the same `destinationFileName`, `IoTHubClient_LL_UploadFileToBlob_Impl` shall skip that many blocks of the file. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_41_056: [ When resuming after `committedBlockCount` acknowledged blocks, `IoTHubClient_LL_UploadFileToBlob_Impl` shall call `Blob_ResumeMultipleBlocksFromSasUri` with the new SasUri instead of `Blob_UploadMultipleBlocksFromSasUri`. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_41_057: [ Once the upload succeeds, `IoTHubClient_LL_UploadFileToBlob_Impl` shall delete the manifest file. ]*/
+TEST_FUNCTION(IoTHubClient_LL_UploadFileToBlob_Impl_resumes_from_manifest)
+{
+    //arrange
+    bool resumable = true;
+    FILE* sourceFile = fopen(TEST_SOURCE_FILE_PATH, "wb");
+    ASSERT_IS_NOT_NULL(sourceFile);
+    ASSERT_ARE_EQUAL(size_t, 1, fwrite("3", 1, 1, sourceFile));
+    (void)fclose(sourceFile);
+    FILE* manifestFile = fopen(TEST_MANIFEST_FILE_PATH, "wb");
+    ASSERT_IS_NOT_NULL(manifestFile);
+    ASSERT_IS_TRUE(fprintf(manifestFile, "2\n%s", TEST_DESTINATION_FILENAME) > 0);
+    (void)fclose(manifestFile);
+
+    IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE h = IoTHubClient_LL_UploadToBlob_Create(&TEST_CONFIG_SAS, TEST_AUTH_HANDLE);
+    (void)IoTHubClient_LL_UploadToBlob_SetOption(h, OPTION_TRUSTED_CERT, TEST_CERT);
+    (void)IoTHubClient_LL_UploadToBlob_SetOption(h, OPTION_BLOB_UPLOAD_RESUMABLE, &resumable);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(BLOCK_SIZE));
+    STRICT_EXPECTED_CALL(gballoc_malloc(strlen(TEST_MANIFEST_FILE_PATH) + 1));
+    STRICT_EXPECTED_CALL(gballoc_malloc(strlen(TEST_DESTINATION_FILENAME) + 1));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    setup_resumed_upload_blocks_mocks(IOTHUB_CREDENTIAL_TYPE_SAS_TOKEN, false, false, true, false, 2);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_UploadFileToBlob_Impl(h, TEST_DESTINATION_FILENAME, TEST_SOURCE_FILE_PATH);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    manifestFile = fopen(TEST_MANIFEST_FILE_PATH, "rb");
+    ASSERT_IS_NULL(manifestFile);
+
+    //cleanup
+    IoTHubClient_LL_UploadToBlob_Destroy(h);
+    (void)remove(TEST_SOURCE_FILE_PATH);
+}
+
 END_TEST_SUITE(iothubclient_ll_uploadtoblob_ut)
@@ -0,0 +1,58 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "testrunnerswitcher.h"
+#include "iothubclient_common_e2e.h"
+#include "iothubtransportmqtt.h"
+
+BEGIN_TEST_SUITE(iothubclient_mqtt_recovery_e2e_sfc)
+
+    TEST_SUITE_INITIALIZE(TestClassInitialize)
+    {
+        e2e_init(TEST_MQTT, false);
+    }
+
+    TEST_SUITE_CLEANUP(TestClassCleanup)
+    {
+        e2e_deinit();
+    }
+
+    // ***********************************************************
+    // Time to recover from a killed connection, for each retry policy
+    // ***********************************************************
+    TEST_FUNCTION(IoTHub_MQTT_e2e_recovery_kill_Tcp_retry_immediate)
+    {
+        e2e_d2c_svc_fault_ctrl_recovery_benchmark_kill_TCP_connection(MQTT_Protocol, IOTHUB_CLIENT_RETRY_IMMEDIATE);
+    }
+
+    TEST_FUNCTION(IoTHub_MQTT_e2e_recovery_kill_Tcp_retry_interval)
+    {
+        e2e_d2c_svc_fault_ctrl_recovery_benchmark_kill_TCP_connection(MQTT_Protocol, IOTHUB_CLIENT_RETRY_INTERVAL);
+    }
+
+    TEST_FUNCTION(IoTHub_MQTT_e2e_recovery_kill_Tcp_retry_linear_backoff)
+    {
+        e2e_d2c_svc_fault_ctrl_recovery_benchmark_kill_TCP_connection(MQTT_Protocol, IOTHUB_CLIENT_RETRY_LINEAR_BACKOFF);
+    }
+
+    TEST_FUNCTION(IoTHub_MQTT_e2e_recovery_kill_Tcp_retry_exponential_backoff)
+    {
+        e2e_d2c_svc_fault_ctrl_recovery_benchmark_kill_TCP_connection(MQTT_Protocol, IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF);
+    }
+
+    TEST_FUNCTION(IoTHub_MQTT_e2e_recovery_kill_Tcp_retry_exponential_backoff_with_jitter)
+    {
+        e2e_d2c_svc_fault_ctrl_recovery_benchmark_kill_TCP_connection(MQTT_Protocol, IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_JITTER);
+    }
+
+    TEST_FUNCTION(IoTHub_MQTT_e2e_recovery_kill_Tcp_retry_random)
+    {
+        e2e_d2c_svc_fault_ctrl_recovery_benchmark_kill_TCP_connection(MQTT_Protocol, IOTHUB_CLIENT_RETRY_RANDOM);
+    }
+
+    TEST_FUNCTION(IoTHub_MQTT_e2e_recovery_kill_Tcp_retry_exponential_backoff_with_decorrelated_jitter)
+    {
+        e2e_d2c_svc_fault_ctrl_recovery_benchmark_kill_TCP_connection(MQTT_Protocol, IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_DECORRELATED_JITTER);
+    }
+
+END_TEST_SUITE(iothubclient_mqtt_recovery_e2e_sfc)
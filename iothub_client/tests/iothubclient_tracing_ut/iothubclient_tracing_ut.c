@@ -0,0 +1,333 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#endif
+#include <string.h>
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+#include "umocktypes_bool.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/agenttime.h"
+#undef ENABLE_MOCKS
+
+#include "internal/iothub_client_tracing.h"
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+static TEST_MUTEX_HANDLE g_testByTest;
+
+#define TEST_TRACEPARENT "00-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-01"
+static const unsigned char TEST_TRACE_ID[IOTHUB_CLIENT_TRACE_ID_SIZE] = { 0x4b, 0xf9, 0x2f, 0x35, 0x77, 0xb3, 0x4d, 0xa6, 0xa3, 0xce, 0x92, 0x9d, 0x0e, 0x0e, 0x47, 0x36 };
+static const unsigned char TEST_PARENT_SPAN_ID[IOTHUB_CLIENT_SPAN_ID_SIZE] = { 0x00, 0xf0, 0x67, 0xaa, 0x0b, 0xa9, 0x02, 0xb7 };
+static const unsigned char ZERO_SPAN_ID[IOTHUB_CLIENT_SPAN_ID_SIZE] = { 0 };
+
+static size_t g_span_count;
+static IOTHUB_CLIENT_SPAN g_last_span;
+static void* g_last_span_context;
+
+static void test_on_span_ended(const IOTHUB_CLIENT_SPAN* span, void* context)
+{
+    g_span_count++;
+    g_last_span = *span;
+    g_last_span_context = context;
+}
+
+static void set_test_exporter(IOTHUB_CLIENT_TRACER* tracer)
+{
+    IOTHUB_CLIENT_TRACE_EXPORTER exporter;
+    exporter.on_span_ended = test_on_span_ended;
+    exporter.context = (void*)0x42;
+
+    memset(tracer, 0, sizeof(IOTHUB_CLIENT_TRACER));
+    ASSERT_ARE_EQUAL(int, 0, IoTHubClient_Tracing_SetExporter(tracer, &exporter));
+}
+
+BEGIN_TEST_SUITE(iothubclient_tracing_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    int result;
+
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    (void)umock_c_init(on_umock_c_error);
+
+    result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_bool_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+    REGISTER_GLOBAL_MOCK_RETURN(get_time, (time_t)1500000000);
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("Could not acquire test serialization mutex.");
+    }
+    umock_c_reset_all_calls();
+    g_span_count = 0;
+    memset(&g_last_span, 0, sizeof(g_last_span));
+    g_last_span_context = NULL;
+}
+
+TEST_FUNCTION_CLEANUP(method_cleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/* Tests_SRS_IOTHUB_TRACING_41_001: [ If tracer is NULL, IoTHubClient_Tracing_SetExporter shall return a non-zero value. ]*/
+TEST_FUNCTION(IoTHubClient_Tracing_SetExporter_with_NULL_tracer_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_TRACE_EXPORTER exporter = { test_on_span_ended, NULL };
+
+    //act
+    int result = IoTHubClient_Tracing_SetExporter(NULL, &exporter);
+
+    //assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+}
+
+/* Tests_SRS_IOTHUB_TRACING_41_003: [ Otherwise IoTHubClient_Tracing_SetExporter shall copy exporter and, the first time, seed the id generator from the current time. ]*/
+TEST_FUNCTION(IoTHubClient_Tracing_SetExporter_enables_tracing)
+{
+    //arrange
+    IOTHUB_CLIENT_TRACER tracer;
+    IOTHUB_CLIENT_TRACE_EXPORTER exporter = { test_on_span_ended, (void*)0x42 };
+    memset(&tracer, 0, sizeof(tracer));
+
+    STRICT_EXPECTED_CALL(get_time(NULL));
+
+    //act
+    int result = IoTHubClient_Tracing_SetExporter(&tracer, &exporter);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_TRUE(IoTHubClient_Tracing_IsEnabled(&tracer));
+    ASSERT_IS_TRUE(tracer.exporter.context == (void*)0x42);
+    ASSERT_IS_FALSE(tracer.random_state == 0);
+}
+
+/* Tests_SRS_IOTHUB_TRACING_41_002: [ If exporter or its on_span_ended is NULL, IoTHubClient_Tracing_SetExporter shall turn tracing off and return 0. ]*/
+TEST_FUNCTION(IoTHubClient_Tracing_SetExporter_with_NULL_exporter_disables_tracing)
+{
+    //arrange
+    IOTHUB_CLIENT_TRACER tracer;
+    set_test_exporter(&tracer);
+    umock_c_reset_all_calls();
+
+    //act
+    int result = IoTHubClient_Tracing_SetExporter(&tracer, NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_FALSE(IoTHubClient_Tracing_IsEnabled(&tracer));
+}
+
+/* Tests_SRS_IOTHUB_TRACING_41_004: [ If traceparent is a valid W3C traceparent, IoTHubClient_Tracing_Start shall take the trace id and the parent span id from it. ]*/
+/* Tests_SRS_IOTHUB_TRACING_41_006: [ IoTHubClient_Tracing_Start shall generate the span id of the root span, start it at now_ms and mark context active. ]*/
+TEST_FUNCTION(IoTHubClient_Tracing_Start_joins_incoming_traceparent)
+{
+    //arrange
+    IOTHUB_CLIENT_TRACER tracer;
+    IOTHUB_CLIENT_TRACE_CONTEXT context;
+    set_test_exporter(&tracer);
+    memset(&context, 0, sizeof(context));
+
+    //act
+    IoTHubClient_Tracing_Start(&tracer, &context, TEST_TRACEPARENT, 1234);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, 0, memcmp(TEST_TRACE_ID, context.trace_id, IOTHUB_CLIENT_TRACE_ID_SIZE));
+    ASSERT_ARE_EQUAL(int, 0, memcmp(TEST_PARENT_SPAN_ID, context.parent_span_id, IOTHUB_CLIENT_SPAN_ID_SIZE));
+    ASSERT_ARE_NOT_EQUAL(int, 0, memcmp(ZERO_SPAN_ID, context.span_id, IOTHUB_CLIENT_SPAN_ID_SIZE));
+    ASSERT_IS_TRUE(context.ms_started == 1234);
+    ASSERT_IS_TRUE(context.active);
+    ASSERT_IS_FALSE(context.published);
+}
+
+/* Tests_SRS_IOTHUB_TRACING_41_005: [ Otherwise IoTHubClient_Tracing_Start shall generate a new trace id and leave the parent span id zero. ]*/
+TEST_FUNCTION(IoTHubClient_Tracing_Start_with_invalid_traceparent_starts_new_trace)
+{
+    static const char* invalid_traceparents[] =
+    {
+        "",
+        "00-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7",
+        "00-4BF92F3577B34DA6A3CE929D0E0E4736-00f067aa0ba902b7-01",
+        "00-00000000000000000000000000000000-00f067aa0ba902b7-01",
+        "00-4bf92f3577b34da6a3ce929d0e0e4736-0000000000000000-01",
+        "ff-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-01",
+        "00-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-01-extra"
+    };
+    size_t index;
+
+    for (index = 0; index < sizeof(invalid_traceparents) / sizeof(invalid_traceparents[0]); index++)
+    {
+        //arrange
+        IOTHUB_CLIENT_TRACER tracer;
+        IOTHUB_CLIENT_TRACE_CONTEXT context;
+        set_test_exporter(&tracer);
+        memset(&context, 0, sizeof(context));
+
+        //act
+        IoTHubClient_Tracing_Start(&tracer, &context, invalid_traceparents[index], 0);
+
+        //assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, memcmp(TEST_TRACE_ID, context.trace_id, IOTHUB_CLIENT_TRACE_ID_SIZE));
+        ASSERT_ARE_EQUAL(int, 0, memcmp(ZERO_SPAN_ID, context.parent_span_id, IOTHUB_CLIENT_SPAN_ID_SIZE));
+        ASSERT_IS_TRUE(context.active);
+    }
+}
+
+/* Tests_SRS_IOTHUB_TRACING_41_007: [ If context or buffer is NULL, or buffer_size is less than TRACEPARENT_LENGTH + 1, IoTHubClient_Tracing_FormatTraceparent shall return a non-zero value. ]*/
+TEST_FUNCTION(IoTHubClient_Tracing_FormatTraceparent_with_short_buffer_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_TRACE_CONTEXT context;
+    char buffer[TRACEPARENT_LENGTH];
+    memset(&context, 0, sizeof(context));
+
+    //act
+    int result = IoTHubClient_Tracing_FormatTraceparent(&context, buffer, sizeof(buffer));
+
+    //assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+}
+
+/* Tests_SRS_IOTHUB_TRACING_41_008: [ IoTHubClient_Tracing_FormatTraceparent shall write "00-<trace id>-<root span id>-01" in lowercase hex. ]*/
+TEST_FUNCTION(IoTHubClient_Tracing_FormatTraceparent_round_trips)
+{
+    //arrange
+    IOTHUB_CLIENT_TRACER tracer;
+    IOTHUB_CLIENT_TRACE_CONTEXT context;
+    IOTHUB_CLIENT_TRACE_CONTEXT joined;
+    char buffer[TRACEPARENT_LENGTH + 1];
+    set_test_exporter(&tracer);
+    IoTHubClient_Tracing_Start(&tracer, &context, NULL, 0);
+
+    //act
+    int result = IoTHubClient_Tracing_FormatTraceparent(&context, buffer, sizeof(buffer));
+
+    //assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, TRACEPARENT_LENGTH, strlen(buffer));
+    ASSERT_ARE_EQUAL(int, 0, strncmp("00-", buffer, 3));
+    ASSERT_ARE_EQUAL(char_ptr, "-01", buffer + TRACEPARENT_LENGTH - 3);
+
+    IoTHubClient_Tracing_Start(&tracer, &joined, buffer, 0);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(context.trace_id, joined.trace_id, IOTHUB_CLIENT_TRACE_ID_SIZE));
+    ASSERT_ARE_EQUAL(int, 0, memcmp(context.span_id, joined.parent_span_id, IOTHUB_CLIENT_SPAN_ID_SIZE));
+}
+
+/* Tests_SRS_IOTHUB_TRACING_41_009: [ If tracing is off, IoTHubClient_Tracing_ExportSpan shall do nothing. ]*/
+TEST_FUNCTION(IoTHubClient_Tracing_ExportSpan_when_disabled_does_nothing)
+{
+    //arrange
+    IOTHUB_CLIENT_TRACER tracer;
+    IOTHUB_CLIENT_TRACE_CONTEXT context;
+    set_test_exporter(&tracer);
+    IoTHubClient_Tracing_Start(&tracer, &context, NULL, 0);
+    (void)IoTHubClient_Tracing_SetExporter(&tracer, NULL);
+
+    //act
+    IoTHubClient_Tracing_ExportSpan(&tracer, IOTHUB_CLIENT_SPAN_EVENT_SEND, &context, false, 0, 10, true, NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(size_t, 0, g_span_count);
+}
+
+/* Tests_SRS_IOTHUB_TRACING_41_011: [ The root span shall use the span id and the parent span id of context. ]*/
+/* Tests_SRS_IOTHUB_TRACING_41_012: [ IoTHubClient_Tracing_ExportSpan shall call on_span_ended with the span and the exporter context. ]*/
+TEST_FUNCTION(IoTHubClient_Tracing_ExportSpan_root_span_succeeds)
+{
+    //arrange
+    IOTHUB_CLIENT_TRACER tracer;
+    IOTHUB_CLIENT_TRACE_CONTEXT context;
+    set_test_exporter(&tracer);
+    IoTHubClient_Tracing_Start(&tracer, &context, TEST_TRACEPARENT, 100);
+
+    //act
+    IoTHubClient_Tracing_ExportSpan(&tracer, IOTHUB_CLIENT_SPAN_EVENT_SEND, &context, false, 100, 250, false, "name");
+
+    //assert
+    ASSERT_ARE_EQUAL(size_t, 1, g_span_count);
+    ASSERT_IS_TRUE(g_last_span_context == (void*)0x42);
+    ASSERT_ARE_EQUAL(int, (int)IOTHUB_CLIENT_SPAN_EVENT_SEND, (int)g_last_span.kind);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(TEST_TRACE_ID, g_last_span.trace_id, IOTHUB_CLIENT_TRACE_ID_SIZE));
+    ASSERT_ARE_EQUAL(int, 0, memcmp(context.span_id, g_last_span.span_id, IOTHUB_CLIENT_SPAN_ID_SIZE));
+    ASSERT_ARE_EQUAL(int, 0, memcmp(TEST_PARENT_SPAN_ID, g_last_span.parent_span_id, IOTHUB_CLIENT_SPAN_ID_SIZE));
+    ASSERT_IS_TRUE(g_last_span.start_ms == 100);
+    ASSERT_IS_TRUE(g_last_span.end_ms == 250);
+    ASSERT_IS_FALSE(g_last_span.succeeded);
+    ASSERT_ARE_EQUAL(char_ptr, "name", g_last_span.name);
+}
+
+/* Tests_SRS_IOTHUB_TRACING_41_010: [ A child span shall get a new span id and the root span of context as its parent. ]*/
+TEST_FUNCTION(IoTHubClient_Tracing_ExportSpan_child_span_succeeds)
+{
+    //arrange
+    IOTHUB_CLIENT_TRACER tracer;
+    IOTHUB_CLIENT_TRACE_CONTEXT context;
+    set_test_exporter(&tracer);
+    IoTHubClient_Tracing_Start(&tracer, &context, NULL, 100);
+
+    //act
+    IoTHubClient_Tracing_ExportSpan(&tracer, IOTHUB_CLIENT_SPAN_EVENT_QUEUE, &context, true, 100, 50, true, NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(size_t, 1, g_span_count);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(context.trace_id, g_last_span.trace_id, IOTHUB_CLIENT_TRACE_ID_SIZE));
+    ASSERT_ARE_EQUAL(int, 0, memcmp(context.span_id, g_last_span.parent_span_id, IOTHUB_CLIENT_SPAN_ID_SIZE));
+    ASSERT_ARE_NOT_EQUAL(int, 0, memcmp(context.span_id, g_last_span.span_id, IOTHUB_CLIENT_SPAN_ID_SIZE));
+    ASSERT_IS_TRUE(g_last_span.end_ms == 100);
+    ASSERT_IS_TRUE(g_last_span.succeeded);
+}
+
+END_TEST_SUITE(iothubclient_tracing_ut)
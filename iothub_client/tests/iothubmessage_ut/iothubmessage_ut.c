@@ -31,9 +31,13 @@ static void my_gballoc_free(void* ptr)
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/optimize_size.h"
 #include "azure_c_shared_utility/buffer_.h"
+#include "azure_c_shared_utility/constbuffer.h"
 #include "azure_c_shared_utility/strings.h"
 #include "azure_c_shared_utility/lock.h"
 #include "azure_c_shared_utility/map.h"
+#ifdef USE_PAYLOAD_COMPRESSION
+#include "internal/iothub_client_gzip.h"
+#endif
 
 #undef ENABLE_MOCKS
 
@@ -118,6 +122,56 @@ static void my_Map_Destroy(MAP_HANDLE handle)
     my_gballoc_free(handle);
 }
 
+typedef struct TEST_CONSTBUFFER_TAG
+{
+    CONSTBUFFER content;
+    size_t ref_count;
+} TEST_CONSTBUFFER;
+
+static CONSTBUFFER_HANDLE my_CONSTBUFFER_Create(const unsigned char* source, size_t size)
+{
+    TEST_CONSTBUFFER* result = (TEST_CONSTBUFFER*)my_gballoc_malloc(sizeof(TEST_CONSTBUFFER));
+    unsigned char* copy = (unsigned char*)my_gballoc_malloc(size + 1);
+    (void)memcpy(copy, source, size);
+    result->content.buffer = copy;
+    result->content.size = size;
+    result->ref_count = 1;
+    return (CONSTBUFFER_HANDLE)result;
+}
+
+static void my_CONSTBUFFER_IncRef(CONSTBUFFER_HANDLE constbufferHandle)
+{
+    ((TEST_CONSTBUFFER*)constbufferHandle)->ref_count++;
+}
+
+static void my_CONSTBUFFER_DecRef(CONSTBUFFER_HANDLE constbufferHandle)
+{
+    TEST_CONSTBUFFER* constbuffer = (TEST_CONSTBUFFER*)constbufferHandle;
+    if (--constbuffer->ref_count == 0)
+    {
+        my_gballoc_free((void*)constbuffer->content.buffer);
+        my_gballoc_free(constbuffer);
+    }
+}
+
+static const CONSTBUFFER* my_CONSTBUFFER_GetContent(CONSTBUFFER_HANDLE constbufferHandle)
+{
+    return &((TEST_CONSTBUFFER*)constbufferHandle)->content;
+}
+
+static size_t g_release_count;
+static const unsigned char* g_released_byteArray;
+static size_t g_released_size;
+static void* g_released_context;
+
+static void test_release_callback(const unsigned char* byteArray, size_t size, void* context)
+{
+    g_release_count++;
+    g_released_byteArray = byteArray;
+    g_released_size = size;
+    g_released_context = context;
+}
+
 static int my_mallocAndStrcpy_s(char** destination, const char* source)
 {
     *destination = (char*)my_gballoc_malloc(strlen(source)+1);
@@ -125,6 +179,20 @@ static int my_mallocAndStrcpy_s(char** destination, const char* source)
     return 0;
 }
 
+#ifdef USE_PAYLOAD_COMPRESSION
+static const unsigned char TEST_COMPRESSED[2] = { 0x1f, 0x8b };
+
+static int my_gzip_compress_buffer(const unsigned char* source, size_t size, unsigned char** compressed, size_t* compressed_size)
+{
+    (void)source;
+    (void)size;
+    *compressed = (unsigned char*)my_gballoc_malloc(sizeof(TEST_COMPRESSED));
+    memcpy(*compressed, TEST_COMPRESSED, sizeof(TEST_COMPRESSED));
+    *compressed_size = sizeof(TEST_COMPRESSED);
+    return 0;
+}
+#endif
+
 typedef const char*(*PFN_MESSAGE_GET_STRING)(IOTHUB_MESSAGE_HANDLE handle);
 typedef IOTHUB_MESSAGE_RESULT(*PFN_MESSAGE_SET_STRING)(IOTHUB_MESSAGE_HANDLE handle, const char *string);
 
@@ -277,6 +345,7 @@ TEST_SUITE_INITIALIZE(suite_init)
 
     REGISTER_UMOCK_ALIAS_TYPE(MAP_FILTER_CALLBACK, void*);
     REGISTER_UMOCK_ALIAS_TYPE(BUFFER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(CONSTBUFFER_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(MAP_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(STRING_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(MAP_RESULT, int);
@@ -296,6 +365,12 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_HOOK(BUFFER_length, real_BUFFER_length);
     REGISTER_GLOBAL_MOCK_HOOK(BUFFER_clone, real_BUFFER_clone);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(BUFFER_clone, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(CONSTBUFFER_Create, my_CONSTBUFFER_Create);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(CONSTBUFFER_Create, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(CONSTBUFFER_IncRef, my_CONSTBUFFER_IncRef);
+    REGISTER_GLOBAL_MOCK_HOOK(CONSTBUFFER_DecRef, my_CONSTBUFFER_DecRef);
+    REGISTER_GLOBAL_MOCK_HOOK(CONSTBUFFER_GetContent, my_CONSTBUFFER_GetContent);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(CONSTBUFFER_GetContent, NULL);
 
     REGISTER_STRING_GLOBAL_MOCK_HOOK;
 
@@ -310,6 +385,11 @@ TEST_SUITE_INITIALIZE(suite_init)
 
     REGISTER_GLOBAL_MOCK_HOOK(mallocAndStrcpy_s, my_mallocAndStrcpy_s);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(mallocAndStrcpy_s, __FAILURE__);
+
+#ifdef USE_PAYLOAD_COMPRESSION
+    REGISTER_GLOBAL_MOCK_HOOK(gzip_compress_buffer, my_gzip_compress_buffer);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gzip_compress_buffer, __FAILURE__);
+#endif
 }
 
 TEST_SUITE_CLEANUP(suite_cleanup)
@@ -354,8 +434,8 @@ static int should_skip_index(size_t current_index, const size_t skip_array[], si
     return result;
 }
 
-/*Tests_SRS_IOTHUBMESSAGE_02_022: [IoTHubMessage_CreateFromByteArray shall call BUFFER_create passing byteArray and size as parameters.]*/
-/*Tests_SRS_IOTHUBMESSAGE_02_023: [IoTHubMessage_CreateFromByteArray shall call Map_Create to create the message properties.]*/
+/*Tests_SRS_IOTHUBMESSAGE_41_015: [ IoTHubMessage_CreateFromByteArray shall copy byteArray into an immutable payload with CONSTBUFFER_Create. ]*/
+/*Tests_SRS_IOTHUBMESSAGE_41_005: [ A new message shall start with no properties and allocate none. ]*/
 /*Tests_SRS_IOTHUBMESSAGE_02_025: [Otherwise, IoTHubMessage_CreateFromByteArray shall return a non-NULL handle.] */
 /*Tests_SRS_IOTHUBMESSAGE_02_026: [The type of the new message shall be IOTHUBMESSAGE_BYTEARRAY.] */
 /*Tests_SRS_IOTHUBMESSAGE_02_009: [Otherwise IoTHubMessage_GetContentType shall return the type of the message.] */
@@ -363,8 +443,7 @@ TEST_FUNCTION(IoTHubMessage_CreateFromByteArray_happy_path)
 {
     // arrange
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(BUFFER_create(c, 1));
-    STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(CONSTBUFFER_Create(c, 1));
 
     //act
     IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
@@ -398,8 +477,7 @@ TEST_FUNCTION(IoTHubMessage_CreateFromByteArray_succeeds_when_size_0_and_buffer_
 {
     // arrange
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(BUFFER_create(IGNORED_PTR_ARG, 0)).IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, 0));
 
     //act
     IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(NULL, 0);
@@ -417,8 +495,7 @@ TEST_FUNCTION(IoTHubMessage_CreateFromByteArray_succeeds_when_size_0_and_buffer_
 {
     //arrange
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(BUFFER_create(IGNORED_PTR_ARG, 0)).IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, 0));
 
     //act
     IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 0);
@@ -439,8 +516,7 @@ TEST_FUNCTION(IoTHubMessage_CreateFromByteArray_fails)
 
     // arrange
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(BUFFER_create(c, 1));
-    STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(CONSTBUFFER_Create(c, 1));
 
     umock_c_negative_tests_snapshot();
 
@@ -464,8 +540,210 @@ TEST_FUNCTION(IoTHubMessage_CreateFromByteArray_fails)
     umock_c_negative_tests_deinit();
 }
 
+/*Tests_SRS_IOTHUBMESSAGE_41_019: [ `IoTHubMessage_CreateFromByteArrayNoCopy` shall create a BYTEARRAY message whose payload points to `byteArray`, without copying it. ]*/
+/*Tests_SRS_IOTHUBMESSAGE_41_023: [ For a message created by `IoTHubMessage_CreateFromByteArrayNoCopy`, IoTHubMessage_GetByteArray shall return the bytes of the caller. ]*/
+/*Tests_SRS_IOTHUBMESSAGE_41_021: [ Once the message and all its clones are destroyed, `releaseCallback` shall be called with `byteArray`, `size` and `releaseContext`, unless it is NULL. ]*/
+TEST_FUNCTION(IoTHubMessage_CreateFromByteArrayNoCopy_happy_path)
+{
+    // arrange
+    const unsigned char* byteArray;
+    size_t size;
+    g_release_count = 0;
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+
+    //act
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArrayNoCopy(c, 1, test_release_callback, (void*)0x4242);
+
+    //assert
+    ASSERT_IS_NOT_NULL(h);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(IOTHUBMESSAGE_CONTENT_TYPE, IOTHUBMESSAGE_BYTEARRAY, IoTHubMessage_GetContentType(h));
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, IoTHubMessage_GetByteArray(h, &byteArray, &size));
+    ASSERT_ARE_EQUAL(void_ptr, (void*)c, (void*)byteArray);
+    ASSERT_ARE_EQUAL(size_t, 1, size);
+    ASSERT_ARE_EQUAL(size_t, 0, g_release_count);
+
+    IoTHubMessage_Destroy(h);
+    ASSERT_ARE_EQUAL(size_t, 1, g_release_count);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)c, (void*)g_released_byteArray);
+    ASSERT_ARE_EQUAL(size_t, 1, g_released_size);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)0x4242, g_released_context);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_018: [ If `byteArray` is NULL and `size` is not zero then `IoTHubMessage_CreateFromByteArrayNoCopy` shall return NULL. ]*/
+TEST_FUNCTION(IoTHubMessage_CreateFromByteArrayNoCopy_fails_when_size_non_zero_buffer_NULL)
+{
+    //arrange
+    g_release_count = 0;
+
+    //act
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArrayNoCopy(NULL, 1, test_release_callback, NULL);
+
+    //assert
+    ASSERT_IS_NULL(h);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 0, g_release_count);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_021: [ Once the message and all its clones are destroyed, `releaseCallback` shall be called with `byteArray`, `size` and `releaseContext`, unless it is NULL. ]*/
+TEST_FUNCTION(IoTHubMessage_CreateFromByteArrayNoCopy_with_NULL_releaseCallback_succeeds)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h;
+
+    //act
+    h = IoTHubMessage_CreateFromByteArrayNoCopy(NULL, 0, NULL, NULL);
+
+    //assert
+    ASSERT_IS_NOT_NULL(h);
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_020: [ If there are any errors then `IoTHubMessage_CreateFromByteArrayNoCopy` shall return NULL, without calling `releaseCallback`. ]*/
+TEST_FUNCTION(IoTHubMessage_CreateFromByteArrayNoCopy_fails)
+{
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+    g_release_count = 0;
+
+    // arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+
+    umock_c_negative_tests_snapshot();
+
+    //act
+    size_t count = umock_c_negative_tests_call_count();
+    for (size_t index = 0; index < count; index++)
+    {
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(index);
+
+        char tmp_msg[64];
+        sprintf(tmp_msg, "IoTHubMessage_CreateFromByteArrayNoCopy failure in test %lu/%lu", (unsigned long)index, (unsigned long)count);
+
+        IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArrayNoCopy(c, 1, test_release_callback, NULL);
+
+        //assert
+        ASSERT_IS_NULL(h, tmp_msg);
+        ASSERT_ARE_EQUAL(size_t, 0, g_release_count, tmp_msg);
+    }
+
+    //cleanup
+    umock_c_negative_tests_deinit();
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_022: [ IoTHubMessage_Clone shall share a payload created by `IoTHubMessage_CreateFromByteArrayNoCopy` with the clone, without copying it. ]*/
+/*Tests_SRS_IOTHUBMESSAGE_41_021: [ Once the message and all its clones are destroyed, `releaseCallback` shall be called with `byteArray`, `size` and `releaseContext`, unless it is NULL. ]*/
+TEST_FUNCTION(IoTHubMessage_Clone_of_NoCopy_message_releases_after_the_last_destroy)
+{
+    //arrange
+    const unsigned char* byteArray;
+    size_t size;
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArrayNoCopy(c, 1, test_release_callback, NULL);
+    g_release_count = 0;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+
+    //act
+    IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+
+    //assert
+    ASSERT_IS_NOT_NULL(r);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, IoTHubMessage_GetByteArray(r, &byteArray, &size));
+    ASSERT_ARE_EQUAL(void_ptr, (void*)c, (void*)byteArray);
+
+    IoTHubMessage_Destroy(h);
+    ASSERT_ARE_EQUAL(size_t, 0, g_release_count);
+    IoTHubMessage_Destroy(r);
+    ASSERT_ARE_EQUAL(size_t, 1, g_release_count);
+}
+
+#ifdef USE_PAYLOAD_COMPRESSION
+/*Tests_SRS_IOTHUBMESSAGE_41_002: [ `IoTHubMessage_CreateCompressedFromByteArray` shall compress `byteArray` with `gzip_compress_buffer`. ]*/
+/*Tests_SRS_IOTHUBMESSAGE_41_003: [ `IoTHubMessage_CreateCompressedFromByteArray` shall create the message with `IoTHubMessage_CreateFromByteArray` from the compressed bytes and set its content encoding to "gzip". ]*/
+TEST_FUNCTION(IoTHubMessage_CreateCompressedFromByteArray_happy_path)
+{
+    // arrange
+    const unsigned char* byteArray;
+    size_t size;
+
+    STRICT_EXPECTED_CALL(gzip_compress_buffer(c, 1, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, sizeof(TEST_COMPRESSED)));
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, "gzip"));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateCompressedFromByteArray(c, 1);
+
+    //assert
+    ASSERT_IS_NOT_NULL(h);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(IOTHUBMESSAGE_CONTENT_TYPE, IOTHUBMESSAGE_BYTEARRAY, IoTHubMessage_GetContentType(h));
+    ASSERT_ARE_EQUAL(char_ptr, "gzip", IoTHubMessage_GetContentEncodingSystemProperty(h));
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, IoTHubMessage_GetByteArray(h, &byteArray, &size));
+    ASSERT_ARE_EQUAL(size_t, sizeof(TEST_COMPRESSED), size);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(byteArray, TEST_COMPRESSED, size));
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_001: [ If `byteArray` is NULL and `size` is not zero then `IoTHubMessage_CreateCompressedFromByteArray` shall return NULL. ]*/
+TEST_FUNCTION(IoTHubMessage_CreateCompressedFromByteArray_fails_when_size_non_zero_buffer_NULL)
+{
+    //act
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateCompressedFromByteArray(NULL, 1);
+
+    //assert
+    ASSERT_IS_NULL(h);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_004: [ If there are any errors then `IoTHubMessage_CreateCompressedFromByteArray` shall return NULL. ]*/
+TEST_FUNCTION(IoTHubMessage_CreateCompressedFromByteArray_fails)
+{
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    // arrange
+    STRICT_EXPECTED_CALL(gzip_compress_buffer(c, 1, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, sizeof(TEST_COMPRESSED)));
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, "gzip"));
+
+    umock_c_negative_tests_snapshot();
+
+    //act
+    size_t count = umock_c_negative_tests_call_count();
+    for (size_t index = 0; index < count; index++)
+    {
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(index);
+
+        char tmp_msg[64];
+        sprintf(tmp_msg, "IoTHubMessage_CreateCompressedFromByteArray failure in test %lu/%lu", (unsigned long)index, (unsigned long)count);
+
+        IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateCompressedFromByteArray(c, 1);
+
+        //assert
+        ASSERT_IS_NULL(h, tmp_msg);
+    }
+
+    //cleanup
+    umock_c_negative_tests_deinit();
+}
+#endif /* USE_PAYLOAD_COMPRESSION */
+
 /*Tests_SRS_IOTHUBMESSAGE_02_027: [IoTHubMessage_CreateFromString shall call STRING_construct passing source as parameter.] */
-/*Tests_SRS_IOTHUBMESSAGE_02_028: [IoTHubMessage_CreateFromString shall call Map_Create to create the message properties.] */
+/*Tests_SRS_IOTHUBMESSAGE_41_005: [ A new message shall start with no properties and allocate none. ]*/
 /*Tests_SRS_IOTHUBMESSAGE_02_031: [Otherwise, IoTHubMessage_CreateFromString shall return a non-NULL handle.] */
 /*Tests_SRS_IOTHUBMESSAGE_02_032: [The type of the new message shall be IOTHUBMESSAGE_STRING.] */
 /*Tests_SRS_IOTHUBMESSAGE_02_009: [Otherwise IoTHubMessage_GetContentType shall return the type of the message.] */
@@ -474,7 +752,6 @@ TEST_FUNCTION(IoTHubMessage_CreateFromString_happy_path)
     //arrange
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(STRING_construct("a"));
-    STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
 
     //act
     IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString("a");
@@ -512,7 +789,6 @@ TEST_FUNCTION(IoTHubMessage_CreateFromString_fails)
     // arrange
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(STRING_construct("a"));
-    STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
 
     umock_c_negative_tests_snapshot();
 
@@ -540,6 +816,7 @@ TEST_FUNCTION(IoTHubMessage_Map_Filter_validate_Ascii_char_SUCCEED)
 {
     //arrange
     IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    (void)IoTHubMessage_Properties(h);
     umock_c_reset_all_calls();
 
     //act
@@ -557,6 +834,7 @@ TEST_FUNCTION(IoTHubMessage_Map_Filter_invalidate_Ascii_key_fail)
 {
     //arrange
     IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    (void)IoTHubMessage_Properties(h);
     umock_c_reset_all_calls();
 
     //act
@@ -574,6 +852,7 @@ TEST_FUNCTION(IoTHubMessage_Map_Filter_invalidate_Ascii_value_fail)
 {
     //arrange
     IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    (void)IoTHubMessage_Properties(h);
     umock_c_reset_all_calls();
 
     //act
@@ -587,6 +866,37 @@ TEST_FUNCTION(IoTHubMessage_Map_Filter_invalidate_Ascii_value_fail)
     IoTHubMessage_Destroy(h);
 }
 
+/* Tests_SRS_IOTHUBMESSAGE_07_008: [ValidateAsciiCharactersFilter shall loop through the mapKey and mapValue strings to ensure that they only contain valid US-Ascii characters Ascii value 32 - 126.] */
+TEST_FUNCTION(IoTHubMessage_Map_Filter_checks_every_character_of_long_strings)
+{
+    //arrange
+    static const char printable[] = " !\"#$%&'()*+,-./0123456789:;<=>?@ABCDEFGHIJKLMNOPQRSTUVWXYZ[\\]^_`abcdefghijklmnopqrstuvwxyz{|}~";
+    static const char invalid_characters[] = { '\x01', '\x1F', '\x7F', '\x80', '\xFF' };
+    char value[sizeof(printable)];
+    size_t position;
+    size_t i;
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    (void)IoTHubMessage_Properties(h);
+    umock_c_reset_all_calls();
+
+    //act
+    //assert
+    ASSERT_ARE_EQUAL(int, 0, g_mapFilterFunc(printable, printable));
+    for (position = 0; position < sizeof(printable) - 1; position++)
+    {
+        for (i = 0; i < sizeof(invalid_characters); i++)
+        {
+            (void)memcpy(value, printable, sizeof(printable));
+            value[position] = invalid_characters[i];
+            ASSERT_ARE_NOT_EQUAL(int, 0, g_mapFilterFunc(TEST_VALID_MAP_KEY, value));
+        }
+    }
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
 /*Tests_SRS_IOTHUBMESSAGE_01_004: [If iotHubMessageHandle is NULL, IoTHubMessage_Destroy shall do nothing.] */
 TEST_FUNCTION(IoTHubMessage_Destroy_With_NULL_handle_does_nothing)
 {
@@ -608,8 +918,8 @@ TEST_FUNCTION(IoTHubMessage_Destroy_destroys_a_BYTEARRAY_IoTHubMEssage)
     IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(Map_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(CONSTBUFFER_DecRef(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
@@ -638,7 +948,7 @@ TEST_FUNCTION(IoTHubMessage_Destroy_destroys_a_STRING_IoTHubMessage)
     umock_c_reset_all_calls();
 
     STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(Map_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
@@ -659,8 +969,7 @@ TEST_FUNCTION(IoTHubMessage_Destroy_destroys_a_STRING_IoTHubMessage)
     //cleanup
 }
 
-/*Tests_SRS_IOTHUBMESSAGE_01_011: [The pointer shall be obtained by using BUFFER_u_char and it shall be copied in the buffer argument.]*/
-/*Tests_SRS_IOTHUBMESSAGE_01_012: [The size of the associated data shall be obtained by using BUFFER_length and it shall be copied to the size argument.]*/
+/*Tests_SRS_IOTHUBMESSAGE_41_017: [ The pointer and the size shall be obtained with CONSTBUFFER_GetContent and copied in the buffer and size arguments. ]*/
 /*Tests_SRS_IOTHUBMESSAGE_02_033: [IoTHubMessage_GetByteArray shall return IOTHUBMESSAGE_OK when all oeprations complete succesfully.] */
 TEST_FUNCTION(IoTHubMessage_GetByteArray_happy_path)
 {
@@ -670,8 +979,7 @@ TEST_FUNCTION(IoTHubMessage_GetByteArray_happy_path)
     size_t size;
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(CONSTBUFFER_GetContent(IGNORED_PTR_ARG));
 
     //act
     IOTHUB_MESSAGE_RESULT r = IoTHubMessage_GetByteArray(h, &byteArray, &size);
@@ -743,8 +1051,8 @@ TEST_FUNCTION(IoTHubMessage_GetByteArray_with_STRING_fails)
 }
 
 /*Tests_SRS_IOTHUBMESSAGE_03_001: [IoTHubMessage_Clone shall create a new IoT hub message with data content identical to that of the iotHubMessageHandle parameter.]*/
-/*Tests_SRS_IOTHUBMESSAGE_02_006: [IoTHubMessage_Clone shall clone the content by a call to BUFFER_clone or STRING_clone] */
-/*Tests_SRS_IOTHUBMESSAGE_02_005: [IoTHubMessage_Clone shall clone the properties map by using Map_Clone.] */
+/*Tests_SRS_IOTHUBMESSAGE_41_016: [ IoTHubMessage_Clone shall share the payload of a BYTEARRAY message with the clone by taking a reference on it with CONSTBUFFER_IncRef, without copying it. ]*/
+/*Tests_SRS_IOTHUBMESSAGE_41_006: [ If the properties of `iotHubMessageHandle` are not in a map, `IoTHubMessage_Clone` shall copy all of them with a single allocation. ]*/
 /*Tests_SRS_IOTHUBMESSAGE_03_002: [IoTHubMessage_Clone shall return upon success a non-NULL handle to the newly created IoT hub message.]*/
 TEST_FUNCTION(IoTHubMessage_Clone_with_BYTE_ARRAY_happy_path)
 {
@@ -753,8 +1061,7 @@ TEST_FUNCTION(IoTHubMessage_Clone_with_BYTE_ARRAY_happy_path)
     umock_c_reset_all_calls();
 
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(BUFFER_clone(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(Map_Clone(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(CONSTBUFFER_IncRef(IGNORED_PTR_ARG));
 
     //act
     IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
@@ -768,6 +1075,33 @@ TEST_FUNCTION(IoTHubMessage_Clone_with_BYTE_ARRAY_happy_path)
     IoTHubMessage_Destroy(h);
 }
 
+/*Tests_SRS_IOTHUBMESSAGE_41_016: [ IoTHubMessage_Clone shall share the payload of a BYTEARRAY message with the clone by taking a reference on it with CONSTBUFFER_IncRef, without copying it. ]*/
+TEST_FUNCTION(IoTHubMessage_Clone_with_BYTE_ARRAY_shares_the_payload)
+{
+    //arrange
+    const unsigned char* source_byteArray;
+    const unsigned char* clone_byteArray;
+    size_t source_size;
+    size_t clone_size;
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+    (void)IoTHubMessage_GetByteArray(h, &source_byteArray, &source_size);
+    umock_c_reset_all_calls();
+
+    //act
+    IoTHubMessage_Destroy(h);
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_GetByteArray(r, &clone_byteArray, &clone_size);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, result);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)source_byteArray, (void*)clone_byteArray);
+    ASSERT_ARE_EQUAL(size_t, 1, clone_size);
+    ASSERT_ARE_EQUAL(uint8_t, c[0], clone_byteArray[0]);
+
+    ///cleanup
+    IoTHubMessage_Destroy(r);
+}
+
 TEST_FUNCTION(IoTHubMessage_Clone_handle_NULL_fail)
 {
     //arrange
@@ -793,9 +1127,7 @@ TEST_FUNCTION(IoTHubMessage_Clone_with_BYTE_ARRAY_fails)
     int negativeTestsInitResult = umock_c_negative_tests_init();
     ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
 
-    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(BUFFER_clone(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(Map_Clone(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)); /*taking a reference on the payload cannot fail*/
 
     umock_c_negative_tests_snapshot();
 
@@ -822,7 +1154,7 @@ TEST_FUNCTION(IoTHubMessage_Clone_with_BYTE_ARRAY_fails)
 
 /*Tests_SRS_IOTHUBMESSAGE_03_001: [IoTHubMessage_Clone shall create a new IoT hub message with data content identical to that of the iotHubMessageHandle parameter.]*/
 /*Tests_SRS_IOTHUBMESSAGE_02_006: [IoTHubMessage_Clone shall clone the content by a call to BUFFER_clone or STRING_clone] */
-/*Tests_SRS_IOTHUBMESSAGE_02_005: [IoTHubMessage_Clone shall clone the properties map by using Map_Clone.] */
+/*Tests_SRS_IOTHUBMESSAGE_41_006: [ If the properties of `iotHubMessageHandle` are not in a map, `IoTHubMessage_Clone` shall copy all of them with a single allocation. ]*/
 /*Tests_SRS_IOTHUBMESSAGE_03_002: [IoTHubMessage_Clone shall return upon success a non-NULL handle to the newly created IoT hub message.]*/
 TEST_FUNCTION(IoTHubMessage_Clone_with_STRING_happy_path)
 {
@@ -832,7 +1164,6 @@ TEST_FUNCTION(IoTHubMessage_Clone_with_STRING_happy_path)
 
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(STRING_clone(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(Map_Clone(IGNORED_PTR_ARG));
 
     ///act
     IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
@@ -858,7 +1189,6 @@ TEST_FUNCTION(IoTHubMessage_Clone_with_STRING_fails)
 
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(STRING_clone(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(Map_Clone(IGNORED_PTR_ARG));
 
     umock_c_negative_tests_snapshot();
 
@@ -883,42 +1213,257 @@ TEST_FUNCTION(IoTHubMessage_Clone_with_STRING_fails)
     umock_c_negative_tests_deinit();
 }
 
-/*Tests_SRS_IOTHUBMESSAGE_02_002: [Otherwise, for any non-NULL iotHubMessageHandle it shall return a non-NULL MAP_HANDLE.] */
-TEST_FUNCTION(IoTHubMessage_Properties_happy_path)
+/*Tests_SRS_IOTHUBMESSAGE_41_006: [ If the properties of `iotHubMessageHandle` are not in a map, `IoTHubMessage_Clone` shall copy all of them with a single allocation. ]*/
+TEST_FUNCTION(IoTHubMessage_Clone_copies_inline_properties_in_one_allocation)
 {
-    ///arrange
-    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    (void)IoTHubMessage_SetProperty(h, TEST_PROPERTY_KEY, TEST_PROPERTY_VALUE);
+    (void)IoTHubMessage_SetProperty(h, TEST_VALID_MAP_KEY, TEST_VALID_MAP_VALUE);
     umock_c_reset_all_calls();
 
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(CONSTBUFFER_IncRef(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+
     //act
-    MAP_HANDLE r = IoTHubMessage_Properties(h);
+    IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
 
     //assert
     ASSERT_IS_NOT_NULL(r);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, TEST_PROPERTY_VALUE, IoTHubMessage_GetProperty(r, TEST_PROPERTY_KEY));
+    ASSERT_ARE_EQUAL(char_ptr, TEST_VALID_MAP_VALUE, IoTHubMessage_GetProperty(r, TEST_VALID_MAP_KEY));
 
-    //cleanup
+    ///cleanup
+    IoTHubMessage_Destroy(r);
     IoTHubMessage_Destroy(h);
 }
 
-/*Tests_SRS_IOTHUBMESSAGE_02_001: [If iotHubMessageHandle is NULL then IoTHubMessage_Properties shall return NULL.] */
-TEST_FUNCTION(IoTHubMessage_Properties_with_NULL_handle_retuns_NULL)
+/*Tests_SRS_IOTHUBMESSAGE_02_005: [IoTHubMessage_Clone shall clone the properties map by using Map_Clone.] */
+TEST_FUNCTION(IoTHubMessage_Clone_with_properties_map_calls_Map_Clone)
 {
     //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    (void)IoTHubMessage_Properties(h);
+    umock_c_reset_all_calls();
 
-    //act
-    MAP_HANDLE r = IoTHubMessage_Properties(NULL);
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(STRING_clone(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Map_Clone(IGNORED_PTR_ARG));
 
-    //assert
-    ASSERT_IS_NULL(r);
+    ///act
+    IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(r);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-    //cleanup
+    ///cleanup
+    IoTHubMessage_Destroy(r);
+    IoTHubMessage_Destroy(h);
 }
 
-/*Tests_SRS_IOTHUBMESSAGE_02_008: [If any parameter is NULL then IoTHubMessage_GetContentType shall return IOTHUBMESSAGE_UNKNOWN.] */
-TEST_FUNCTION(IoTHubMessage_GetContentType_with_NULL_handle_fails)
-{
+/*Tests_SRS_IOTHUBMESSAGE_02_002: [Otherwise, for any non-NULL iotHubMessageHandle it shall return a non-NULL MAP_HANDLE.] */
+/*Tests_SRS_IOTHUBMESSAGE_41_007: [ The first call to `IoTHubMessage_Properties` shall move the properties of the message to a map created with `Map_Create`, which holds them from then on. ]*/
+TEST_FUNCTION(IoTHubMessage_Properties_happy_path)
+{
+    ///arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
+
+    //act
+    MAP_HANDLE r = IoTHubMessage_Properties(h);
+
+    //assert
+    ASSERT_IS_NOT_NULL(r);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_02_001: [If iotHubMessageHandle is NULL then IoTHubMessage_Properties shall return NULL.] */
+TEST_FUNCTION(IoTHubMessage_Properties_with_NULL_handle_retuns_NULL)
+{
+    //arrange
+
+    //act
+    MAP_HANDLE r = IoTHubMessage_Properties(NULL);
+
+    //assert
+    ASSERT_IS_NULL(r);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_007: [ The first call to `IoTHubMessage_Properties` shall move the properties of the message to a map created with `Map_Create`, which holds them from then on. ]*/
+TEST_FUNCTION(IoTHubMessage_Properties_moves_the_properties_to_the_map_once)
+{
+    ///arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    (void)IoTHubMessage_SetProperty(h, TEST_PROPERTY_KEY, TEST_PROPERTY_VALUE);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Map_AddOrUpdate(IGNORED_PTR_ARG, TEST_PROPERTY_KEY, TEST_PROPERTY_VALUE));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    MAP_HANDLE r = IoTHubMessage_Properties(h);
+    MAP_HANDLE r2 = IoTHubMessage_Properties(h);
+
+    //assert
+    ASSERT_IS_NOT_NULL(r);
+    ASSERT_ARE_EQUAL(void_ptr, r, r2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_008: [ If creating the map fails, `IoTHubMessage_Properties` shall return NULL. ]*/
+TEST_FUNCTION(IoTHubMessage_Properties_Map_Create_fails)
+{
+    ///arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    (void)IoTHubMessage_SetProperty(h, TEST_PROPERTY_KEY, TEST_PROPERTY_VALUE);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG)).SetReturn(NULL);
+
+    //act
+    MAP_HANDLE r = IoTHubMessage_Properties(h);
+
+    //assert
+    ASSERT_IS_NULL(r);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, TEST_PROPERTY_VALUE, IoTHubMessage_GetProperty(h, TEST_PROPERTY_KEY));
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_009: [ If `iotHubMessageHandle`, `keys`, `values` or `count` is NULL, `IoTHubMessage_GetProperties` shall return IOTHUB_MESSAGE_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubMessage_GetProperties_NULL_arguments_fail)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    const char* const* keys;
+    const char* const* values;
+    size_t count;
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_MESSAGE_RESULT result1 = IoTHubMessage_GetProperties(NULL, &keys, &values, &count);
+    IOTHUB_MESSAGE_RESULT result2 = IoTHubMessage_GetProperties(h, NULL, &values, &count);
+    IOTHUB_MESSAGE_RESULT result3 = IoTHubMessage_GetProperties(h, &keys, NULL, &count);
+    IOTHUB_MESSAGE_RESULT result4 = IoTHubMessage_GetProperties(h, &keys, &values, NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_INVALID_ARG, result1);
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_INVALID_ARG, result2);
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_INVALID_ARG, result3);
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_INVALID_ARG, result4);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_011: [ Otherwise `IoTHubMessage_GetProperties` shall return the keys and values stored in the message, without allocating. ]*/
+TEST_FUNCTION(IoTHubMessage_GetProperties_returns_inline_properties)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    const char* const* keys;
+    const char* const* values;
+    size_t count;
+    (void)IoTHubMessage_SetProperty(h, TEST_PROPERTY_KEY, TEST_PROPERTY_VALUE);
+    (void)IoTHubMessage_SetProperty(h, TEST_VALID_MAP_KEY, TEST_VALID_MAP_VALUE);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_GetProperties(h, &keys, &values, &count);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 2, count);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_PROPERTY_KEY, keys[0]);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_PROPERTY_VALUE, values[0]);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_VALID_MAP_KEY, keys[1]);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_VALID_MAP_VALUE, values[1]);
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_010: [ If the properties are in a map, `IoTHubMessage_GetProperties` shall return them with `Map_GetInternals`. ]*/
+TEST_FUNCTION(IoTHubMessage_GetProperties_with_properties_map_calls_Map_GetInternals)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    const char* const* keys;
+    const char* const* values;
+    size_t count;
+    const char* test_keys[] = { TEST_PROPERTY_KEY };
+    const char* test_values[] = { TEST_PROPERTY_VALUE };
+    const char* const* test_keys_ptr = test_keys;
+    const char* const* test_values_ptr = test_values;
+    size_t test_count = 1;
+    (void)IoTHubMessage_Properties(h);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Map_GetInternals(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(2, &test_keys_ptr, sizeof(test_keys_ptr))
+        .CopyOutArgumentBuffer(3, &test_values_ptr, sizeof(test_values_ptr))
+        .CopyOutArgumentBuffer(4, &test_count, sizeof(test_count));
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_GetProperties(h, &keys, &values, &count);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 1, count);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_PROPERTY_KEY, keys[0]);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_PROPERTY_VALUE, values[0]);
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_012: [ If `Map_GetInternals` fails, `IoTHubMessage_GetProperties` shall return IOTHUB_MESSAGE_ERROR. ]*/
+TEST_FUNCTION(IoTHubMessage_GetProperties_Map_GetInternals_fails)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    const char* const* keys;
+    const char* const* values;
+    size_t count;
+    (void)IoTHubMessage_Properties(h);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Map_GetInternals(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG)).SetReturn(MAP_ERROR);
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_GetProperties(h, &keys, &values, &count);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_02_008: [If any parameter is NULL then IoTHubMessage_GetContentType shall return IOTHUBMESSAGE_UNKNOWN.] */
+TEST_FUNCTION(IoTHubMessage_GetContentType_with_NULL_handle_fails)
+{
     //arrange
 
     //act
@@ -1655,66 +2200,86 @@ TEST_FUNCTION(IoTHubMessage_SetDiagnosticPropertyData_NULL_DiagnosticData_Fails)
     IoTHubMessage_Destroy(h);
 }
 
-// Tests_SRS_IOTHUBMESSAGE_10_004: [If the IOTHUB_MESSAGE_HANDLE `diagnosticData` is not NULL it shall be deallocated.]
+/*Tests_SRS_IOTHUBMESSAGE_41_024: [ IoTHubMessage_SetDiagnosticPropertyData shall copy `diagnosticData` into the message, replacing any previous value, without allocating memory. ]*/
 TEST_FUNCTION(IoTHubMessage_SetDiagnosticPropertyData_DiagnosticData_Not_NULL_SUCCEED)
 {
     //arrange
     IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    const IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DATA* diagnosticData;
     (void)IoTHubMessage_SetDiagnosticPropertyData(h, &TEST_DIAGNOSTIC_DATA);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-
     //act
     IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetDiagnosticPropertyData(h, &TEST_DIAGNOSTIC_DATA2);
 
     //assert
     ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    diagnosticData = IoTHubMessage_GetDiagnosticPropertyData(h);
+    ASSERT_IS_NOT_NULL(diagnosticData);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_DIAGNOSTIC_DATA2.diagnosticId, diagnosticData->diagnosticId);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_DIAGNOSTIC_DATA2.diagnosticCreationTimeUtc, diagnosticData->diagnosticCreationTimeUtc);
 
     //cleanup
     IoTHubMessage_Destroy(h);
 }
 
-// Tests_SRS_IOTHUBMESSAGE_10_005: [If the allocation or the copying of `diagnosticData` fails, then IoTHubMessage_SetDiagnosticPropertyData shall return IOTHUB_MESSAGE_ERROR.]
-TEST_FUNCTION(IoTHubMessage_SetDiagnosticPropertyData_Fails)
+/*Tests_SRS_IOTHUBMESSAGE_41_025: [ If `diagnosticId` or `diagnosticCreationTimeUtc` is longer than 32 characters, IoTHubMessage_SetDiagnosticPropertyData shall return IOTHUB_MESSAGE_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubMessage_SetDiagnosticPropertyData_too_long_fails)
 {
-    // arrange
-    ASSERT_ARE_EQUAL(int, 0, umock_c_negative_tests_init());
-
+    //arrange
+    char tooLong[34];
+    IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DATA longId;
+    IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DATA longTime;
     IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
-
+    (void)IoTHubMessage_SetDiagnosticPropertyData(h, &TEST_DIAGNOSTIC_DATA);
+    (void)memset(tooLong, 'a', sizeof(tooLong) - 1);
+    tooLong[sizeof(tooLong) - 1] = '\0';
+    longId.diagnosticId = tooLong;
+    longId.diagnosticCreationTimeUtc = TEST_DIAGNOSTIC_DATA.diagnosticCreationTimeUtc;
+    longTime.diagnosticId = TEST_DIAGNOSTIC_DATA.diagnosticId;
+    longTime.diagnosticCreationTimeUtc = tooLong;
     umock_c_reset_all_calls();
-    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-    umock_c_negative_tests_snapshot();
 
     //act
-    size_t count = umock_c_negative_tests_call_count();
-    for (size_t index = 0; index < count; index++)
-    {
-        umock_c_negative_tests_reset();
-        umock_c_negative_tests_fail_call(index);
+    IOTHUB_MESSAGE_RESULT result1 = IoTHubMessage_SetDiagnosticPropertyData(h, &longId);
+    IOTHUB_MESSAGE_RESULT result2 = IoTHubMessage_SetDiagnosticPropertyData(h, &longTime);
 
-        char tmp_msg[64];
-        sprintf(tmp_msg, "Failed in test %lu/%lu", (unsigned long)index, (unsigned long)count);
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_INVALID_ARG, result1);
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_INVALID_ARG, result2);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_DIAGNOSTIC_DATA.diagnosticId, IoTHubMessage_GetDiagnosticPropertyData(h)->diagnosticId);
 
-        //act
-        IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetDiagnosticPropertyData(h, &TEST_DIAGNOSTIC_DATA);
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
 
-        //assert
-        ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_ERROR, result, tmp_msg);
-    }
+/*Tests_SRS_IOTHUBMESSAGE_41_026: [ IoTHubMessage_Clone shall copy the diagnostic data of `iotHubMessageHandle` into the clone without allocating memory. ]*/
+TEST_FUNCTION(IoTHubMessage_Clone_copies_DiagnosticData)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    const IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DATA* diagnosticData;
+    (void)IoTHubMessage_SetDiagnosticPropertyData(h, &TEST_DIAGNOSTIC_DATA);
+    umock_c_reset_all_calls();
 
-    //cleanup
-    umock_c_negative_tests_deinit();
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(CONSTBUFFER_IncRef(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+
+    //assert
+    ASSERT_IS_NOT_NULL(r);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
     IoTHubMessage_Destroy(h);
+    diagnosticData = IoTHubMessage_GetDiagnosticPropertyData(r);
+    ASSERT_IS_NOT_NULL(diagnosticData);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_DIAGNOSTIC_DATA.diagnosticId, diagnosticData->diagnosticId);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_DIAGNOSTIC_DATA.diagnosticCreationTimeUtc, diagnosticData->diagnosticCreationTimeUtc);
+
+    //cleanup
+    IoTHubMessage_Destroy(r);
 }
 
 // Tests_SRS_IOTHUBMESSAGE_10_006: [If IoTHubMessage_SetDiagnosticPropertyData finishes successfully it shall return IOTHUB_MESSAGE_OK.]
@@ -1724,10 +2289,6 @@ TEST_FUNCTION(IoTHubMessage_SetDiagnosticPropertyData_SUCCEED)
     IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-
     //act
     IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetDiagnosticPropertyData(h, &TEST_DIAGNOSTIC_DATA);
 
@@ -1787,10 +2348,11 @@ TEST_FUNCTION(IoTHubMessage_SetProperty_value_NULL_Fail)
     IoTHubMessage_Destroy(h);
 }
 
-TEST_FUNCTION(IoTHubMessage_SetProperty_Fail)
+TEST_FUNCTION(IoTHubMessage_SetProperty_with_properties_map_Fail)
 {
     //arrange
     IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    (void)IoTHubMessage_Properties(h);
     umock_c_reset_all_calls();
 
     STRICT_EXPECTED_CALL(Map_AddOrUpdate(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG)).SetReturn(MAP_ERROR);
@@ -1806,10 +2368,11 @@ TEST_FUNCTION(IoTHubMessage_SetProperty_Fail)
     IoTHubMessage_Destroy(h);
 }
 
-TEST_FUNCTION(IoTHubMessage_SetProperty_Succeed)
+TEST_FUNCTION(IoTHubMessage_SetProperty_with_properties_map_Succeed)
 {
     //arrange
     IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    (void)IoTHubMessage_Properties(h);
     umock_c_reset_all_calls();
 
     STRICT_EXPECTED_CALL(Map_AddOrUpdate(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
@@ -1825,6 +2388,123 @@ TEST_FUNCTION(IoTHubMessage_SetProperty_Succeed)
     IoTHubMessage_Destroy(h);
 }
 
+/*Tests_SRS_IOTHUBMESSAGE_41_013: [ While the message holds fewer than 5 properties, or `key` is one of them, `IoTHubMessage_SetProperty` shall store `key` and `value` in the message itself, packing all keys and values in one allocation. ]*/
+TEST_FUNCTION(IoTHubMessage_SetProperty_stores_the_property_inline)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(NULL));
+
+    //act
+    IOTHUB_MESSAGE_RESULT result1 = IoTHubMessage_SetProperty(h, TEST_PROPERTY_KEY, TEST_PROPERTY_VALUE);
+    IOTHUB_MESSAGE_RESULT result2 = IoTHubMessage_SetProperty(h, TEST_VALID_MAP_KEY, TEST_VALID_MAP_VALUE);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, result1);
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, result2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, TEST_PROPERTY_VALUE, IoTHubMessage_GetProperty(h, TEST_PROPERTY_KEY));
+    ASSERT_ARE_EQUAL(char_ptr, TEST_VALID_MAP_VALUE, IoTHubMessage_GetProperty(h, TEST_VALID_MAP_KEY));
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_013: [ While the message holds fewer than 5 properties, or `key` is one of them, `IoTHubMessage_SetProperty` shall store `key` and `value` in the message itself, packing all keys and values in one allocation. ]*/
+TEST_FUNCTION(IoTHubMessage_SetProperty_overwrites_an_inline_property)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    (void)IoTHubMessage_SetProperty(h, TEST_PROPERTY_KEY, TEST_PROPERTY_VALUE);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetProperty(h, TEST_PROPERTY_KEY, TEST_STRING_VALUE);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, TEST_STRING_VALUE, IoTHubMessage_GetProperty(h, TEST_PROPERTY_KEY));
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_013: [ While the message holds fewer than 5 properties, or `key` is one of them, `IoTHubMessage_SetProperty` shall store `key` and `value` in the message itself, packing all keys and values in one allocation. ]*/
+TEST_FUNCTION(IoTHubMessage_SetProperty_inline_malloc_fails)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)).SetReturn(NULL);
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetProperty(h, TEST_PROPERTY_KEY, TEST_PROPERTY_VALUE);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(IoTHubMessage_GetProperty(h, TEST_PROPERTY_KEY));
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+TEST_FUNCTION(IoTHubMessage_SetProperty_invalid_ascii_fails)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_MESSAGE_RESULT result1 = IoTHubMessage_SetProperty(h, TEST_INVALID_MAP_KEY, TEST_VALID_MAP_VALUE);
+    IOTHUB_MESSAGE_RESULT result2 = IoTHubMessage_SetProperty(h, TEST_VALID_MAP_KEY, TEST_INVALID_MAP_VALUE);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_ERROR, result1);
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_ERROR, result2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_014: [ Otherwise `IoTHubMessage_SetProperty` shall move the properties to a map created with `Map_Create` and add `key` and `value` to it with `Map_AddOrUpdate`. ]*/
+TEST_FUNCTION(IoTHubMessage_SetProperty_sixth_property_moves_the_properties_to_a_map)
+{
+    //arrange
+    static const char* keys[] = { "k1", "k2", "k3", "k4", "k5" };
+    size_t i;
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    for (i = 0; i < sizeof(keys) / sizeof(keys[0]); i++)
+    {
+        ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, IoTHubMessage_SetProperty(h, keys[i], TEST_PROPERTY_VALUE));
+    }
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
+    for (i = 0; i < sizeof(keys) / sizeof(keys[0]); i++)
+    {
+        STRICT_EXPECTED_CALL(Map_AddOrUpdate(IGNORED_PTR_ARG, keys[i], TEST_PROPERTY_VALUE));
+    }
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Map_AddOrUpdate(IGNORED_PTR_ARG, TEST_PROPERTY_KEY, TEST_PROPERTY_VALUE));
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetProperty(h, TEST_PROPERTY_KEY, TEST_PROPERTY_VALUE);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
 TEST_FUNCTION(IoTHubMessage_GetProperty_handle_NULL_Fail)
 {
     //arrange
@@ -1856,10 +2536,11 @@ TEST_FUNCTION(IoTHubMessage_GetProperty_key_NULL_Fail)
     IoTHubMessage_Destroy(h);
 }
 
-TEST_FUNCTION(IoTHubMessage_GetProperty_Succeed)
+TEST_FUNCTION(IoTHubMessage_GetProperty_with_properties_map_Succeed)
 {
     //arrange
     IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    (void)IoTHubMessage_Properties(h);
     umock_c_reset_all_calls();
 
     bool key_exist = true;
@@ -1878,10 +2559,11 @@ TEST_FUNCTION(IoTHubMessage_GetProperty_Succeed)
     IoTHubMessage_Destroy(h);
 }
 
-TEST_FUNCTION(IoTHubMessage_GetProperty_Fail)
+TEST_FUNCTION(IoTHubMessage_GetProperty_with_properties_map_Fail)
 {
     //arrange
     IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    (void)IoTHubMessage_Properties(h);
     umock_c_reset_all_calls();
 
     bool key_exist = false;
@@ -1899,6 +2581,42 @@ TEST_FUNCTION(IoTHubMessage_GetProperty_Fail)
 }
 
 // Tests_SRS_IOTHUBMESSAGE_31_036: [If any of the parameters are NULL then IoTHubMessage_SetOutputName shall return a IOTHUB_MESSAGE_INVALID_ARG value.]
+TEST_FUNCTION(IoTHubMessage_GetProperty_inline_Succeed)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    (void)IoTHubMessage_SetProperty(h, TEST_PROPERTY_KEY, TEST_PROPERTY_VALUE);
+    umock_c_reset_all_calls();
+
+    //act
+    const char* result = IoTHubMessage_GetProperty(h, TEST_PROPERTY_KEY);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, TEST_PROPERTY_VALUE, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+TEST_FUNCTION(IoTHubMessage_GetProperty_inline_not_found_Fail)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    (void)IoTHubMessage_SetProperty(h, TEST_VALID_MAP_KEY, TEST_VALID_MAP_VALUE);
+    umock_c_reset_all_calls();
+
+    //act
+    const char* result = IoTHubMessage_GetProperty(h, TEST_PROPERTY_KEY);
+
+    //assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
 TEST_FUNCTION(IoTHubMessage_SetOutputName_NULL_handle_Fails)
 {
     set_string_NULL_handle_fails_impl(IoTHubMessage_SetOutputName, TEST_OUTPUT_NAME);
@@ -2066,6 +2784,197 @@ TEST_FUNCTION(IoTHubMessage_GetConnectionDeviceId_SUCCEED)
     get_string_succeeds_impl(IoTHubMessage_SetConnectionDeviceId, IoTHubMessage_GetConnectionDeviceId, TEST_CONNECTION_DEVICE_ID);
 }
 
+/*Tests_SRS_IOTHUBMESSAGE_41_027: [ If `keys` or `values` is NULL, `count` is zero, any key or value is NULL or not printable US-ASCII, or a key appears twice, `IoTHubMessagePropertySet_Create` shall return NULL. ]*/
+TEST_FUNCTION(IoTHubMessagePropertySet_Create_with_invalid_properties_fails)
+{
+    //arrange
+    const char* keys[] = { TEST_PROPERTY_KEY, TEST_VALID_MAP_KEY };
+    const char* values[] = { TEST_PROPERTY_VALUE, TEST_VALID_MAP_VALUE };
+    const char* invalid_keys[] = { TEST_PROPERTY_KEY, TEST_INVALID_MAP_KEY };
+    const char* duplicate_keys[] = { TEST_PROPERTY_KEY, TEST_PROPERTY_KEY };
+    const char* null_values[] = { TEST_PROPERTY_VALUE, NULL };
+
+    //act
+    IOTHUB_MESSAGE_PROPERTY_SET_HANDLE result1 = IoTHubMessagePropertySet_Create(NULL, values, 2);
+    IOTHUB_MESSAGE_PROPERTY_SET_HANDLE result2 = IoTHubMessagePropertySet_Create(keys, NULL, 2);
+    IOTHUB_MESSAGE_PROPERTY_SET_HANDLE result3 = IoTHubMessagePropertySet_Create(keys, values, 0);
+    IOTHUB_MESSAGE_PROPERTY_SET_HANDLE result4 = IoTHubMessagePropertySet_Create(invalid_keys, values, 2);
+    IOTHUB_MESSAGE_PROPERTY_SET_HANDLE result5 = IoTHubMessagePropertySet_Create(duplicate_keys, values, 2);
+    IOTHUB_MESSAGE_PROPERTY_SET_HANDLE result6 = IoTHubMessagePropertySet_Create(keys, null_values, 2);
+
+    //assert
+    ASSERT_IS_NULL(result1);
+    ASSERT_IS_NULL(result2);
+    ASSERT_IS_NULL(result3);
+    ASSERT_IS_NULL(result4);
+    ASSERT_IS_NULL(result5);
+    ASSERT_IS_NULL(result6);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_028: [ `IoTHubMessagePropertySet_Create` shall copy the keys and values, with all their text, into a single allocation. ]*/
+/*Tests_SRS_IOTHUBMESSAGE_41_037: [ If the message has a property set, `IoTHubMessage_GetProperties` shall return the keys and values of the set, without allocating. ]*/
+/*Tests_SRS_IOTHUBMESSAGE_41_039: [ Otherwise `IoTHubMessage_SetPropertySet` shall take a reference on `propertySet`, release any previous property set of the message and return IOTHUB_MESSAGE_OK. ]*/
+/*Tests_SRS_IOTHUBMESSAGE_41_041: [ Otherwise `IoTHubMessage_GetPropertySet` shall return the property set of the message, or NULL if it has none. ]*/
+TEST_FUNCTION(IoTHubMessage_SetPropertySet_shares_the_properties_of_the_set)
+{
+    //arrange
+    const char* keys[] = { TEST_PROPERTY_KEY, TEST_VALID_MAP_KEY };
+    const char* values[] = { TEST_PROPERTY_VALUE, TEST_VALID_MAP_VALUE };
+    const char* const* message_keys;
+    const char* const* message_values;
+    size_t count;
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    IOTHUB_MESSAGE_PROPERTY_SET_HANDLE set = IoTHubMessagePropertySet_Create(keys, values, 2);
+    ASSERT_IS_NOT_NULL(set);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetPropertySet(h, set);
+    IOTHUB_MESSAGE_RESULT get_result = IoTHubMessage_GetProperties(h, &message_keys, &message_values, &count);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, result);
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, get_result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_TRUE(set == IoTHubMessage_GetPropertySet(h));
+    ASSERT_ARE_EQUAL(size_t, 2, count);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_PROPERTY_KEY, message_keys[0]);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_VALID_MAP_VALUE, message_values[1]);
+    ASSERT_IS_TRUE(keys[0] != message_keys[0]);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_VALID_MAP_VALUE, IoTHubMessage_GetProperty(h, TEST_VALID_MAP_KEY));
+    ASSERT_IS_NULL(IoTHubMessage_GetProperty(h, TEST_OUTPUT_NAME));
+
+    //cleanup
+    IoTHubMessagePropertySet_Destroy(set);
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_033: [ If `iotHubMessageHandle` or `propertySet` is NULL, `IoTHubMessage_SetPropertySet` shall return IOTHUB_MESSAGE_INVALID_ARG. ]*/
+/*Tests_SRS_IOTHUBMESSAGE_41_034: [ If the message already holds properties of its own, `IoTHubMessage_SetPropertySet` shall return IOTHUB_MESSAGE_ERROR. ]*/
+TEST_FUNCTION(IoTHubMessage_SetPropertySet_fails_when_the_message_has_its_own_properties)
+{
+    //arrange
+    const char* keys[] = { TEST_PROPERTY_KEY };
+    const char* values[] = { TEST_PROPERTY_VALUE };
+    IOTHUB_MESSAGE_PROPERTY_SET_HANDLE set = IoTHubMessagePropertySet_Create(keys, values, 1);
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    (void)IoTHubMessage_SetProperty(h, TEST_VALID_MAP_KEY, TEST_VALID_MAP_VALUE);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_MESSAGE_RESULT result1 = IoTHubMessage_SetPropertySet(NULL, set);
+    IOTHUB_MESSAGE_RESULT result2 = IoTHubMessage_SetPropertySet(h, NULL);
+    IOTHUB_MESSAGE_RESULT result3 = IoTHubMessage_SetPropertySet(h, set);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_INVALID_ARG, result1);
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_INVALID_ARG, result2);
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_ERROR, result3);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(IoTHubMessage_GetPropertySet(h));
+
+    //cleanup
+    IoTHubMessagePropertySet_Destroy(set);
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_035: [ IoTHubMessage_Clone shall share the property set of `iotHubMessageHandle` with the clone, without copying it. ]*/
+/*Tests_SRS_IOTHUBMESSAGE_41_032: [ `IoTHubMessagePropertySet_Destroy` shall release a reference on `propertySet`, freeing it once no handle and no message refers to it; it shall do nothing if `propertySet` is NULL. ]*/
+TEST_FUNCTION(IoTHubMessage_Clone_shares_the_property_set)
+{
+    //arrange
+    const char* keys[] = { TEST_PROPERTY_KEY };
+    const char* values[] = { TEST_PROPERTY_VALUE };
+    IOTHUB_MESSAGE_PROPERTY_SET_HANDLE set = IoTHubMessagePropertySet_Create(keys, values, 1);
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    (void)IoTHubMessage_SetPropertySet(h, set);
+    IoTHubMessagePropertySet_Destroy(set);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(CONSTBUFFER_IncRef(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+
+    //assert
+    ASSERT_IS_NOT_NULL(r);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_TRUE(IoTHubMessage_GetPropertySet(h) == IoTHubMessage_GetPropertySet(r));
+
+    IoTHubMessage_Destroy(h);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_PROPERTY_VALUE, IoTHubMessage_GetProperty(r, TEST_PROPERTY_KEY));
+
+    //cleanup
+    IoTHubMessage_Destroy(r);
+    IoTHubMessagePropertySet_Destroy(NULL);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_038: [ If the message has a property set, `IoTHubMessage_SetProperty` shall first copy its properties into the message and release it; if that fails it shall return IOTHUB_MESSAGE_ERROR. ]*/
+TEST_FUNCTION(IoTHubMessage_SetProperty_copies_the_property_set_into_the_message)
+{
+    //arrange
+    const char* keys[] = { TEST_PROPERTY_KEY };
+    const char* values[] = { TEST_PROPERTY_VALUE };
+    IOTHUB_MESSAGE_PROPERTY_SET_HANDLE set = IoTHubMessagePropertySet_Create(keys, values, 1);
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    IOTHUB_MESSAGE_HANDLE r;
+    (void)IoTHubMessage_SetPropertySet(h, set);
+    r = IoTHubMessage_Clone(h);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetProperty(h, TEST_VALID_MAP_KEY, TEST_VALID_MAP_VALUE);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, result);
+    ASSERT_IS_NULL(IoTHubMessage_GetPropertySet(h));
+    ASSERT_ARE_EQUAL(char_ptr, TEST_PROPERTY_VALUE, IoTHubMessage_GetProperty(h, TEST_PROPERTY_KEY));
+    ASSERT_ARE_EQUAL(char_ptr, TEST_VALID_MAP_VALUE, IoTHubMessage_GetProperty(h, TEST_VALID_MAP_KEY));
+    ASSERT_IS_TRUE(set == IoTHubMessage_GetPropertySet(r));
+    ASSERT_IS_NULL(IoTHubMessage_GetProperty(r, TEST_VALID_MAP_KEY));
+
+    //cleanup
+    IoTHubMessage_Destroy(r);
+    IoTHubMessage_Destroy(h);
+    IoTHubMessagePropertySet_Destroy(set);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_41_036: [ If the message has a property set, `IoTHubMessage_Properties` shall first copy its properties into the message and release it; if that fails it shall return NULL. ]*/
+TEST_FUNCTION(IoTHubMessage_Properties_copies_the_property_set_into_the_map)
+{
+    //arrange
+    const char* keys[] = { TEST_PROPERTY_KEY };
+    const char* values[] = { TEST_PROPERTY_VALUE };
+    IOTHUB_MESSAGE_PROPERTY_SET_HANDLE set = IoTHubMessagePropertySet_Create(keys, values, 1);
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    (void)IoTHubMessage_SetPropertySet(h, set);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Map_AddOrUpdate(IGNORED_PTR_ARG, TEST_PROPERTY_KEY, TEST_PROPERTY_VALUE));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    MAP_HANDLE result = IoTHubMessage_Properties(h);
+
+    //assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(IoTHubMessage_GetPropertySet(h));
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+    IoTHubMessagePropertySet_Destroy(set);
+}
+
 END_TEST_SUITE(iothubmessage_ut)
 
 
@@ -47,6 +47,7 @@ void real_free(void* ptr)
 #include "azure_c_shared_utility/singlylinkedlist.h"
 #include "azure_c_shared_utility/uniqueid.h"
 #include "azure_c_shared_utility/optionhandler.h"
+#include "azure_c_shared_utility/tickcounter.h"
 #include "azure_uamqp_c/link.h"
 #include "azure_uamqp_c/messaging.h"
 #include "azure_uamqp_c/message_sender.h"
@@ -150,6 +151,8 @@ static SINGLYLINKEDLIST_HANDLE TEST_IN_PROGRESS_LIST;
 #define TEST_CALLBACK_LIST1                               (SINGLYLINKEDLIST_HANDLE)0x4486
 #define INDEFINITE_TIME                                   ((time_t)-1)
 #define TEST_DISPOSITION_AMQP_VALUE                       (AMQP_VALUE)0x4487
+#define TEST_TICK_COUNTER_HANDLE                          (TICK_COUNTER_HANDLE)0x4490
+#define TEST_ENCODING_CACHE_HANDLE                        (UAMQP_ENCODING_CACHE_HANDLE)0x4491
 
 static delivery_number TEST_DELIVERY_NUMBER;
 
@@ -454,8 +457,9 @@ static MESSENGER_DO_WORK_EXP_CALL_PROFILE* get_msgr_do_work_exp_call_profile(TEL
     return &g_do_work_profile;
 }
 
-static int TEST_message_create_uamqp_encoding_from_iothub_message(MESSAGE_HANDLE message_batch_container, IOTHUB_MESSAGE_HANDLE message_handle, BINARY_DATA* body_binary_data)
+static int TEST_message_create_uamqp_encoding_from_iothub_message_with_cache(UAMQP_ENCODING_CACHE_HANDLE cache, MESSAGE_HANDLE message_batch_container, IOTHUB_MESSAGE_HANDLE message_handle, BINARY_DATA* body_binary_data)
 {
+    (void)cache;
     (void)message_batch_container;
     (void)message_handle;
     (void)body_binary_data;
@@ -778,37 +782,19 @@ static void set_expected_calls_for_telemetry_messenger_create(TELEMETRY_MESSENGE
     STRICT_EXPECTED_CALL(STRING_construct(config->iothub_host_fqdn)).SetReturn(TEST_IOTHUB_HOST_FQDN_STRING_HANDLE);
     STRICT_EXPECTED_CALL(singlylinkedlist_create()).SetReturn(TEST_WAIT_TO_SEND_LIST);
     STRICT_EXPECTED_CALL(singlylinkedlist_create()).SetReturn(TEST_IN_PROGRESS_LIST);
-}
-
-static void set_expected_calls_for_attach_device_client_type_to_link(LINK_HANDLE link_handle, int amqpvalue_set_map_value_result, int link_set_attach_properties_result)
-{
-    STRICT_EXPECTED_CALL(amqpvalue_create_map());
-    STRICT_EXPECTED_CALL(amqpvalue_create_symbol("com.microsoft:client-version"));
-    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(amqpvalue_create_string(TEST_IOTHUB_HOST_FQDN));
-
-    STRICT_EXPECTED_CALL(amqpvalue_set_map_value(TEST_LINK_ATTACH_PROPERTIES, TEST_LINK_DEVICE_TYPE_NAME_AMQP_VALUE, TEST_LINK_DEVICE_TYPE_VALUE_AMQP_VALUE)).SetReturn(amqpvalue_set_map_value_result);
-
-    if (amqpvalue_set_map_value_result == 0)
-    {
-        STRICT_EXPECTED_CALL(link_set_attach_properties(link_handle, TEST_LINK_ATTACH_PROPERTIES)).SetReturn(link_set_attach_properties_result);
-    }
+    STRICT_EXPECTED_CALL(uamqp_encoding_cache_create()).SetReturn(TEST_ENCODING_CACHE_HANDLE);
 
-    STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_LINK_DEVICE_TYPE_VALUE_AMQP_VALUE));
-    STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_LINK_DEVICE_TYPE_NAME_AMQP_VALUE));
-    STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_LINK_ATTACH_PROPERTIES));
-}
-
-static void set_expected_calls_for_message_receiver_create(bool testing_modules)
-{
-    // create_event_sender()
+    // create_link_addresses()
     // create_devices_path()
-    STRING_HANDLE module_handle = testing_modules ? TEST_MODULE_ID_STRING_HANDLE : NULL;
-    const char* module_name = testing_modules ? TEST_MODULE_ID : NULL;
     STRICT_EXPECTED_CALL(STRING_new()).SetReturn(TEST_DEVICES_PATH_STRING_HANDLE);
     STRICT_EXPECTED_CALL(STRING_c_str(TEST_IOTHUB_HOST_FQDN_STRING_HANDLE)).SetReturn(TEST_IOTHUB_HOST_FQDN);
     STRICT_EXPECTED_CALL(STRING_c_str(TEST_DEVICE_ID_STRING_HANDLE)).SetReturn(TEST_DEVICE_ID);
-    STRICT_EXPECTED_CALL(STRING_c_str(module_handle)).SetReturn(module_name);
+    STRICT_EXPECTED_CALL(STRING_c_str(config->module_id != NULL ? TEST_MODULE_ID_STRING_HANDLE : NULL)).SetReturn(config->module_id);
+    // EXPECTED: STRING_sprintf
+
+    // create_event_send_address()
+    STRICT_EXPECTED_CALL(STRING_new()).SetReturn(TEST_EVENT_SEND_ADDRESS_STRING_HANDLE);
+    STRICT_EXPECTED_CALL(STRING_c_str(TEST_DEVICES_PATH_STRING_HANDLE)).SetReturn(TEST_DEVICES_PATH_CHAR_PTR);
     // EXPECTED: STRING_sprintf
 
     // create_message_receive_address()
@@ -816,6 +802,24 @@ static void set_expected_calls_for_message_receiver_create(bool testing_modules)
     STRICT_EXPECTED_CALL(STRING_c_str(TEST_DEVICES_PATH_STRING_HANDLE)).SetReturn(TEST_DEVICES_PATH_CHAR_PTR);
     // EXPECTED: STRING_sprintf
 
+    STRICT_EXPECTED_CALL(STRING_delete(TEST_DEVICES_PATH_STRING_HANDLE));
+
+    // create_link_attach_properties()
+    STRICT_EXPECTED_CALL(amqpvalue_create_map());
+    STRICT_EXPECTED_CALL(amqpvalue_create_symbol("com.microsoft:client-version"));
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(amqpvalue_create_string(TEST_IOTHUB_HOST_FQDN));
+    STRICT_EXPECTED_CALL(amqpvalue_set_map_value(TEST_LINK_ATTACH_PROPERTIES, TEST_LINK_DEVICE_TYPE_NAME_AMQP_VALUE, TEST_LINK_DEVICE_TYPE_VALUE_AMQP_VALUE));
+    STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_LINK_DEVICE_TYPE_VALUE_AMQP_VALUE));
+    STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_LINK_DEVICE_TYPE_NAME_AMQP_VALUE));
+}
+
+static void set_expected_calls_for_message_receiver_create(bool testing_modules)
+{
+    // create_message_receiver()
+    // The link addresses are built once by telemetry_messenger_create().
+    (void)testing_modules;
+
     STRICT_EXPECTED_CALL(STRING_c_str(TEST_DEVICE_ID_STRING_HANDLE)).SetReturn(TEST_DEVICE_ID);
 
     // create_link_name()
@@ -843,7 +847,7 @@ static void set_expected_calls_for_message_receiver_create(bool testing_modules)
 
     STRICT_EXPECTED_CALL(link_set_max_message_size(TEST_MESSAGE_RECEIVER_LINK_HANDLE, MESSAGE_RECEIVER_MAX_LINK_SIZE));
 
-    set_expected_calls_for_attach_device_client_type_to_link(TEST_MESSAGE_RECEIVER_LINK_HANDLE, 0, 0);
+    STRICT_EXPECTED_CALL(link_set_attach_properties(TEST_MESSAGE_RECEIVER_LINK_HANDLE, TEST_LINK_ATTACH_PROPERTIES));
 
     STRICT_EXPECTED_CALL(messagereceiver_create(TEST_MESSAGE_RECEIVER_LINK_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
@@ -852,8 +856,6 @@ static void set_expected_calls_for_message_receiver_create(bool testing_modules)
         .IgnoreArgument(2)
         .IgnoreArgument(3);
 
-    STRICT_EXPECTED_CALL(STRING_delete(TEST_DEVICES_PATH_STRING_HANDLE));
-    STRICT_EXPECTED_CALL(STRING_delete(TEST_MESSAGE_RECEIVE_ADDRESS_STRING_HANDLE));
     STRICT_EXPECTED_CALL(STRING_delete(TEST_MESSAGE_RECEIVER_LINK_NAME_STRING_HANDLE));
     STRICT_EXPECTED_CALL(STRING_delete(TEST_MESSAGE_RECEIVER_TARGET_NAME_STRING_HANDLE));
     STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_MESSAGE_RECEIVER_SOURCE_AMQP_VALUE));
@@ -928,20 +930,8 @@ static int send_events(TELEMETRY_MESSENGER_HANDLE handle, int number_of_events)
 static void set_expected_calls_for_message_sender_create(bool testing_modules)
 {
     // create_event_sender()
-    // create_devices_path()
-    STRING_HANDLE module_handle = testing_modules ? TEST_MODULE_ID_STRING_HANDLE : NULL;
-    const char* module_name = testing_modules ? TEST_MODULE_ID : NULL;
-
-    STRICT_EXPECTED_CALL(STRING_new()).SetReturn(TEST_DEVICES_PATH_STRING_HANDLE);
-    STRICT_EXPECTED_CALL(STRING_c_str(TEST_IOTHUB_HOST_FQDN_STRING_HANDLE)).SetReturn(TEST_IOTHUB_HOST_FQDN);
-    STRICT_EXPECTED_CALL(STRING_c_str(TEST_DEVICE_ID_STRING_HANDLE)).SetReturn(TEST_DEVICE_ID);
-    STRICT_EXPECTED_CALL(STRING_c_str(module_handle)).SetReturn(module_name);
-    // EXPECTED: STRING_sprintf
-
-    // create_event_send_address()
-    STRICT_EXPECTED_CALL(STRING_new()).SetReturn(TEST_EVENT_SEND_ADDRESS_STRING_HANDLE);
-    STRICT_EXPECTED_CALL(STRING_c_str(TEST_DEVICES_PATH_STRING_HANDLE)).SetReturn(TEST_DEVICES_PATH_CHAR_PTR);
-    // EXPECTED: STRING_sprintf
+    // The link addresses are built once by telemetry_messenger_create().
+    (void)testing_modules;
 
     STRICT_EXPECTED_CALL(STRING_c_str(TEST_DEVICE_ID_STRING_HANDLE));
 
@@ -968,7 +958,7 @@ static void set_expected_calls_for_message_sender_create(bool testing_modules)
     STRICT_EXPECTED_CALL(link_set_max_message_size(TEST_EVENT_SENDER_LINK_HANDLE, MESSAGE_SENDER_MAX_LINK_SIZE)).SetReturn(TEST_link_set_max_message_size_result);
 
     // attach_device_client_type_to_link()
-    set_expected_calls_for_attach_device_client_type_to_link(TEST_EVENT_SENDER_LINK_HANDLE, 0, 0);
+    STRICT_EXPECTED_CALL(link_set_attach_properties(TEST_EVENT_SENDER_LINK_HANDLE, TEST_LINK_ATTACH_PROPERTIES));
 
     STRICT_EXPECTED_CALL(messagesender_create(TEST_EVENT_SENDER_LINK_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
@@ -979,8 +969,6 @@ static void set_expected_calls_for_message_sender_create(bool testing_modules)
     STRICT_EXPECTED_CALL(STRING_delete(TEST_EVENT_SENDER_SOURCE_NAME_STRING_HANDLE));
     STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_EVENT_SENDER_SOURCE_AMQP_VALUE));
     STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_EVENT_SENDER_TARGET_AMQP_VALUE));
-    STRICT_EXPECTED_CALL(STRING_delete(TEST_DEVICES_PATH_STRING_HANDLE));
-    STRICT_EXPECTED_CALL(STRING_delete(TEST_EVENT_SEND_ADDRESS_STRING_HANDLE));
 }
 
 static void set_expected_calls_for_telemetry_messenger_start(TELEMETRY_MESSENGER_CONFIG* config, TELEMETRY_MESSENGER_HANDLE messenger_handle)
@@ -1379,8 +1367,8 @@ static void set_expected_calls_for_message_do_work_send_pending_events(SEND_PEND
 
         TEST_amqp_data.length = test_config->test_events[i].number_bytes_encoded;
 
-        STRICT_EXPECTED_CALL(message_create_uamqp_encoding_from_iothub_message(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .CopyOutArgumentBuffer(3, &TEST_amqp_data, sizeof(TEST_amqp_data)).SetReturn(message_create_uamqp_encoding_from_iothub_message_return);
+        STRICT_EXPECTED_CALL(message_create_uamqp_encoding_from_iothub_message_with_cache(TEST_ENCODING_CACHE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .CopyOutArgumentBuffer(4, &TEST_amqp_data, sizeof(TEST_amqp_data)).SetReturn(message_create_uamqp_encoding_from_iothub_message_return);
 
         if ((SEND_PENDING_EXPECT_ERROR_TOO_LARGE == expected_action) || (SEND_PENDING_EXPECT_CREATE_MESSAGE_FAILURE == expected_action))
         {
@@ -1527,6 +1515,10 @@ static void set_expected_calls_for_telemetry_messenger_destroy(TELEMETRY_MESSENG
     STRICT_EXPECTED_CALL(STRING_delete(TEST_DEVICE_ID_STRING_HANDLE));
     STRICT_EXPECTED_CALL(STRING_delete(testing_modules ? TEST_MODULE_ID_STRING_HANDLE : NULL));
     STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(TEST_EVENT_SEND_ADDRESS_STRING_HANDLE));
+    STRICT_EXPECTED_CALL(STRING_delete(TEST_MESSAGE_RECEIVE_ADDRESS_STRING_HANDLE));
+    STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_LINK_ATTACH_PROPERTIES));
+    STRICT_EXPECTED_CALL(uamqp_encoding_cache_destroy(TEST_ENCODING_CACHE_HANDLE));
     STRICT_EXPECTED_CALL(free(messenger_handle));
 }
 
@@ -1539,24 +1531,14 @@ static int TEST_messagereceiver_get_link_name(MESSAGE_RECEIVER_HANDLE message_re
     return TEST_messagereceiver_get_link_name_result;
 }
 
-static void set_expected_calls_for_create_message_disposition_info()
+static void set_expected_calls_for_fill_message_disposition_info()
 {
-    STRICT_EXPECTED_CALL(malloc(sizeof(TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO)));
     STRICT_EXPECTED_CALL(messagereceiver_get_received_message_id(TEST_MESSAGE_RECEIVER_HANDLE, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
         .CopyOutArgumentBuffer(2, &TEST_DELIVERY_NUMBER, sizeof(delivery_number));
 
     STRICT_EXPECTED_CALL(messagereceiver_get_link_name(TEST_MESSAGE_RECEIVER_HANDLE, IGNORED_PTR_ARG))
         .IgnoreArgument(2);
-    static char* link_name = TEST_MESSAGE_RECEIVER_LINK_NAME_CHAR_PTR;
-    EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .CopyOutArgumentBuffer_destination(&link_name, sizeof(char*));
-}
-
-static void set_expected_calls_for_destroy_message_disposition_info()
-{
-    EXPECTED_CALL(free(IGNORED_PTR_ARG));
-    EXPECTED_CALL(free(IGNORED_PTR_ARG));
 }
 
 static void set_expected_calls_for_on_message_received_internal_callback(TELEMETRY_MESSENGER_DISPOSITION_RESULT disposition_result)
@@ -1564,9 +1546,7 @@ static void set_expected_calls_for_on_message_received_internal_callback(TELEMET
     TEST_on_new_message_received_callback_result = disposition_result;
     STRICT_EXPECTED_CALL(message_create_IoTHubMessage_from_uamqp_message(TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG)).IgnoreArgument(2);
 
-    set_expected_calls_for_create_message_disposition_info();
-
-    set_expected_calls_for_destroy_message_disposition_info();
+    set_expected_calls_for_fill_message_disposition_info();
 
     if (disposition_result == TELEMETRY_MESSENGER_DISPOSITION_RESULT_ACCEPTED)
     {
@@ -1710,6 +1690,7 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_UMOCK_ALIAS_TYPE(TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO, void*);
     REGISTER_UMOCK_ALIAS_TYPE(BINARY_DATA, void*);
     REGISTER_UMOCK_ALIAS_TYPE(LIST_ACTION_FUNCTION, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(TICK_COUNTER_HANDLE, void*);
     type_size = sizeof(time_t);
     if (type_size == sizeof(uint64_t))
     {
@@ -1730,7 +1711,9 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_GLOBAL_MOCK_HOOK(messagesender_send_async, TEST_messagesender_send_async);
     REGISTER_GLOBAL_MOCK_HOOK(messagereceiver_create, TEST_messagereceiver_create);
     REGISTER_GLOBAL_MOCK_HOOK(messagereceiver_open, TEST_messagereceiver_open);
-    REGISTER_GLOBAL_MOCK_HOOK(message_create_uamqp_encoding_from_iothub_message, TEST_message_create_uamqp_encoding_from_iothub_message);
+    REGISTER_UMOCK_ALIAS_TYPE(UAMQP_ENCODING_CACHE_HANDLE, void*);
+    REGISTER_GLOBAL_MOCK_HOOK(message_create_uamqp_encoding_from_iothub_message_with_cache, TEST_message_create_uamqp_encoding_from_iothub_message_with_cache);
+    REGISTER_GLOBAL_MOCK_RETURN(uamqp_encoding_cache_create, TEST_ENCODING_CACHE_HANDLE);
     REGISTER_GLOBAL_MOCK_HOOK(message_create_IoTHubMessage_from_uamqp_message, TEST_message_create_IoTHubMessage_from_uamqp_message);
     REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_add, TEST_singlylinkedlist_add);
     REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_get_head_item, TEST_singlylinkedlist_get_head_item);
@@ -2029,6 +2012,9 @@ TEST_FUNCTION(telemetry_messenger_create_with_module_success)
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_011: [If STRING_construct() fails, telemetry_messenger_create() shall fail and return NULL]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_166: [If singlylinkedlist_create() fails, telemetry_messenger_create() shall fail and return NULL]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_133: [If singlylinkedlist_create() fails, telemetry_messenger_create() shall fail and return NULL]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_007: [`instance->encoding_cache` shall be set using uamqp_encoding_cache_create(); if it fails, telemetry_messenger_create() shall fail and return NULL]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_008: [telemetry_messenger_create() shall create `instance->event_send_address` and `instance->message_receive_address` once, to be used by every message sender and receiver link; if it fails, telemetry_messenger_create() shall fail and return NULL]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_009: [telemetry_messenger_create() shall create the "com.microsoft:client-version" link attach properties once; if it fails, links shall be created without them]
 TEST_FUNCTION(telemetry_messenger_create_failure_checks)
 {
     // arrange
@@ -2044,7 +2030,7 @@ TEST_FUNCTION(telemetry_messenger_create_failure_checks)
     size_t i;
     for (i = 0; i < umock_c_negative_tests_call_count(); i++)
     {
-        if (i == 3)
+        if (i == 3 || i == 8 || i == 9 || i == 10 || i == 12 || i >= 14)
         {
             // These expected calls do not cause the API to fail.
             continue;
@@ -2476,6 +2462,104 @@ TEST_FUNCTION(telemetry_messenger_do_work_send_events_rollover_multiple_message_
     test_send_events(&test_send_rollover_multiple_messages_after_config, false);
 }
 
+static size_t TEST_on_batch_sent_event_count;
+static size_t TEST_on_batch_sent_batch_size;
+static size_t TEST_on_batch_sent_batch_capacity;
+static void TEST_on_batch_sent(size_t event_count, size_t batch_size, size_t batch_capacity, void* context)
+{
+    (void)context;
+    TEST_on_batch_sent_event_count = event_count;
+    TEST_on_batch_sent_batch_size = batch_size;
+    TEST_on_batch_sent_batch_capacity = batch_capacity;
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_003: [If `batch_max_messages` is set and the batched message holds that many events, it shall be sent and the next event shall start a new batched message.]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_004: [If `on_batch_sent_callback` was provided, it shall be invoked with the number of events and bytes in the batch and the maximum batch size of the link.]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_006: [Messages shall be encoded with message_create_uamqp_encoding_from_iothub_message_with_cache using `instance->encoding_cache`, whose bytes shall not be freed by the messenger]
+TEST_FUNCTION(telemetry_messenger_do_work_send_events_batch_max_messages_success)
+{
+    // arrange
+    TELEMETRY_MESSENGER_CONFIG* config = get_messenger_config();
+    config->on_batch_sent_callback = TEST_on_batch_sent;
+    TELEMETRY_MESSENGER_HANDLE handle = create_and_start_messenger2(config, false);
+
+    size_t batch_max_messages = 2;
+    ASSERT_ARE_EQUAL(int, 0, telemetry_messenger_set_option(handle, TELEMETRY_MESSENGER_OPTION_BATCH_MAX_MESSAGES, &batch_max_messages));
+    ASSERT_ARE_EQUAL(int, 2, send_events(handle, 2));
+
+    time_t current_time = time(NULL);
+    uint64_t peer_max_message_size = 100 + AMQP_BATCHING_RESERVE_SIZE;
+    BINARY_DATA binary_data;
+    memset(&binary_data, 0, sizeof(binary_data));
+    TEST_amqp_data.length = 10;
+
+    umock_c_reset_all_calls();
+    set_expected_calls_for_process_event_send_timeouts(0, DEFAULT_EVENT_SEND_TIMEOUT_SECS, current_time);
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_WAIT_TO_SEND_LIST));
+    STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_remove(TEST_WAIT_TO_SEND_LIST, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(link_get_peer_max_message_size(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(2, &peer_max_message_size, sizeof(peer_max_message_size));
+    set_expected_calls_for_create_send_pending_events_state();
+    STRICT_EXPECTED_CALL(message_create_uamqp_encoding_from_iothub_message_with_cache(TEST_ENCODING_CACHE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(4, &TEST_amqp_data, sizeof(TEST_amqp_data));
+    STRICT_EXPECTED_CALL(singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(message_add_body_amqp_data(IGNORED_PTR_ARG, binary_data));
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_WAIT_TO_SEND_LIST));
+    STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_remove(TEST_WAIT_TO_SEND_LIST, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(message_create_uamqp_encoding_from_iothub_message_with_cache(TEST_ENCODING_CACHE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(4, &TEST_amqp_data, sizeof(TEST_amqp_data));
+    STRICT_EXPECTED_CALL(singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(message_add_body_amqp_data(IGNORED_PTR_ARG, binary_data));
+    set_expected_calls_for_send_batched_message_and_reset_state(current_time);
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_WAIT_TO_SEND_LIST));
+
+    // act
+    telemetry_messenger_do_work(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 2, TEST_on_batch_sent_event_count);
+    ASSERT_ARE_EQUAL(size_t, 20, TEST_on_batch_sent_batch_size);
+    ASSERT_ARE_EQUAL(size_t, 100, TEST_on_batch_sent_batch_capacity);
+
+    // cleanup
+    telemetry_messenger_destroy(handle);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_002: [If `batch_linger_ms` is set, no events shall be sent while the oldest event waiting is younger than `batch_linger_ms` and fewer than `batch_max_messages` events are waiting.]
+TEST_FUNCTION(telemetry_messenger_do_work_send_events_batch_linger_holds_events)
+{
+    // arrange
+    TELEMETRY_MESSENGER_CONFIG* config = get_messenger_config();
+    TELEMETRY_MESSENGER_HANDLE handle = create_and_start_messenger2(config, false);
+
+    size_t batch_linger_ms = 1000;
+    tickcounter_ms_t current_ms = 0;
+    STRICT_EXPECTED_CALL(tickcounter_create()).SetReturn(TEST_TICK_COUNTER_HANDLE);
+    ASSERT_ARE_EQUAL(int, 0, telemetry_messenger_set_option(handle, TELEMETRY_MESSENGER_OPTION_BATCH_LINGER_MS, &batch_linger_ms));
+    ASSERT_ARE_EQUAL(int, 1, send_events(handle, 1));
+
+    time_t current_time = time(NULL);
+
+    umock_c_reset_all_calls();
+    set_expected_calls_for_process_event_send_timeouts(0, DEFAULT_EVENT_SEND_TIMEOUT_SECS, current_time);
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_WAIT_TO_SEND_LIST));
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(2, &current_ms, sizeof(current_ms));
+    STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+
+    // act
+    telemetry_messenger_do_work(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    telemetry_messenger_destroy(handle);
+}
+
 TEST_FUNCTION(telemetry_messenger_do_work_send_single_message_too_big_config)
 {
     test_send_events(&test_send_only_message_too_big_config, false);
@@ -2508,7 +2592,6 @@ TEST_FUNCTION(telemetry_messenger_do_work_send_middle_message_too_big_and_rollov
 
 
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_067: [If `instance->receive_messages` is true and `instance->message_receiver` is NULL, a message_receiver shall be created]
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_068: [A variable, named `devices_and_modules_path`, shall be created concatenating `instance->iothub_host_fqdn`, "/devices/" and `instance->device_id`]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_070: [A variable, named `message_receive_address`, shall be created concatenating "amqps://", `devices_and_modules_path` and "/messages/devicebound"]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_072: [A `link_name` variable shall be created using an unique string label per AMQP session]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_074: [A `target` variable shall be created with messaging_create_target() using an unique string label per AMQP session]
@@ -2542,8 +2625,6 @@ TEST_FUNCTION(telemetry_messenger_do_work_create_message_receiver)
     telemetry_messenger_destroy(handle);
 }
 
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_069: [If `devices_and_modules_path` fails to be created, telemetry_messenger_do_work() shall fail and return]
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_071: [If `message_receive_address` fails to be created, telemetry_messenger_do_work() shall fail and return]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_073: [If `link_name` fails to be created, telemetry_messenger_do_work() shall fail and return]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_075: [If `target` fails to be created, telemetry_messenger_do_work() shall fail and return]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_077: [If `source` fails to be created, telemetry_messenger_do_work() shall fail and return]
@@ -2573,8 +2654,7 @@ TEST_FUNCTION(telemetry_messenger_do_work_create_message_receiver_failure_checks
     size_t i;
     for (i = 0; i < umock_c_negative_tests_call_count(); i++)
     {
-        if (i == 1 || i == 2 || i == 4 || i == 5 || i == 9 || i == 11 || i == 12 ||
-            i == 14 || i == 16 || i == 19 || (i >= 20 && i <= 27) || (i >= 30 && i <= 35) )
+        if (i == 0 || i == 4 || i == 6 || i == 7 || i == 9 || i == 11 || i == 14 || i == 15 || i >= 18)
         {
             // These expected calls do not cause the API to fail.
             continue;
@@ -2599,8 +2679,6 @@ TEST_FUNCTION(telemetry_messenger_do_work_create_message_receiver_failure_checks
     telemetry_messenger_destroy(handle);
 }
 
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_034: [If `devices_and_modules_path` fails to be created, telemetry_messenger_do_work() shall fail and return]
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_036: [If `event_send_address` fails to be created, telemetry_messenger_do_work() shall fail and return]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_038: [If `link_name` fails to be created, telemetry_messenger_do_work() shall fail and return]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_040: [If `source` fails to be created, telemetry_messenger_do_work() shall fail and return]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_042: [If `target` fails to be created, telemetry_messenger_do_work() shall fail and return]
@@ -2621,8 +2699,7 @@ TEST_FUNCTION(telemetry_messenger_do_work_create_message_sender_failure_checks)
     size_t n = 10;
     for (i = 0; i < n; i++)
     {
-        if (i == 1 || i == 2 || i == 3 || i == 5 || i == 6 || i == 10 || i == 12 || i == 13 ||
-            i == 15 || i == 17 || i == 19 || (i >= 20 && i <= 36))
+        if (i == 0 || i == 4 || i == 6 || i == 7 || i == 9 || i == 11 || i >= 13)
         {
             continue; // These expected calls do not cause the API to fail.
         }
@@ -2951,7 +3028,7 @@ TEST_FUNCTION(messenger_on_message_received_internal_callback_ACCEPTED)
 
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_126: [If `instance->on_message_received_callback` returns TELEMETRY_MESSENGER_DISPOSITION_RESULT_RELEASED, on_message_received_internal_callback shall return the result of messaging_delivery_released()]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_186: [A TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO instance shall be created containing the source link name and message delivery ID]
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_188: [The memory allocated for the TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO instance shall be released]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_012: [The TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO instance shall not be allocated; its `source` shall refer to the link name of `instance->message_receiver` and it shall only be valid while `instance->on_message_received_callback` runs]
 TEST_FUNCTION(messenger_on_message_received_internal_callback_RELEASED)
 {
     // arrange
@@ -3034,7 +3111,9 @@ TEST_FUNCTION(messenger_on_message_received_internal_callback_create_TELEMETRY_M
     umock_c_reset_all_calls();
     TEST_on_new_message_received_callback_result = TELEMETRY_MESSENGER_DISPOSITION_RESULT_ACCEPTED;
     STRICT_EXPECTED_CALL(message_create_IoTHubMessage_from_uamqp_message(TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG)).IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(malloc(sizeof(TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO))).SetReturn(NULL);
+    STRICT_EXPECTED_CALL(messagereceiver_get_received_message_id(TEST_MESSAGE_RECEIVER_HANDLE, IGNORED_PTR_ARG))
+        .IgnoreArgument(2)
+        .SetReturn(1);
     STRICT_EXPECTED_CALL(messaging_delivery_released());
 
     // act
@@ -3317,6 +3396,71 @@ TEST_FUNCTION(telemetry_messenger_set_option_EVENT_SEND_TIMEOUT_SECS)
     telemetry_messenger_destroy(handle);
 }
 
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_001: [If name matches TELEMETRY_MESSENGER_OPTION_BATCH_LINGER_MS, `value` shall be saved on `instance->batch_linger_ms`, creating the tick counter used to age the waiting events if needed]
+TEST_FUNCTION(telemetry_messenger_set_option_BATCH_LINGER_MS)
+{
+    // arrange
+    TELEMETRY_MESSENGER_CONFIG* config = get_messenger_config();
+    TELEMETRY_MESSENGER_HANDLE handle = create_and_start_messenger2(config, false);
+
+    size_t value = 50;
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(tickcounter_create()).SetReturn(TEST_TICK_COUNTER_HANDLE);
+
+    // act
+    int result = telemetry_messenger_set_option(handle, TELEMETRY_MESSENGER_OPTION_BATCH_LINGER_MS, &value);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    telemetry_messenger_destroy(handle);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_001: [If name matches TELEMETRY_MESSENGER_OPTION_BATCH_LINGER_MS, `value` shall be saved on `instance->batch_linger_ms`, creating the tick counter used to age the waiting events if needed]
+TEST_FUNCTION(telemetry_messenger_set_option_BATCH_LINGER_MS_tickcounter_create_fails)
+{
+    // arrange
+    TELEMETRY_MESSENGER_CONFIG* config = get_messenger_config();
+    TELEMETRY_MESSENGER_HANDLE handle = create_and_start_messenger2(config, false);
+
+    size_t value = 50;
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(tickcounter_create()).SetReturn(NULL);
+
+    // act
+    int result = telemetry_messenger_set_option(handle, TELEMETRY_MESSENGER_OPTION_BATCH_LINGER_MS, &value);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    telemetry_messenger_destroy(handle);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_41_005: [If name matches TELEMETRY_MESSENGER_OPTION_BATCH_MAX_MESSAGES, `value` shall be saved on `instance->batch_max_messages`]
+TEST_FUNCTION(telemetry_messenger_set_option_BATCH_MAX_MESSAGES)
+{
+    // arrange
+    TELEMETRY_MESSENGER_CONFIG* config = get_messenger_config();
+    TELEMETRY_MESSENGER_HANDLE handle = create_and_start_messenger2(config, false);
+
+    size_t value = 16;
+    umock_c_reset_all_calls();
+
+    // act
+    int result = telemetry_messenger_set_option(handle, TELEMETRY_MESSENGER_OPTION_BATCH_MAX_MESSAGES, &value);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    telemetry_messenger_destroy(handle);
+}
+
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_169: [If name matches TELEMETRY_MESSENGER_OPTION_SAVED_OPTIONS, `value` shall be applied using OptionHandler_FeedOptions]
 TEST_FUNCTION(telemetry_messenger_set_option_SAVED_OPTIONS)
 {
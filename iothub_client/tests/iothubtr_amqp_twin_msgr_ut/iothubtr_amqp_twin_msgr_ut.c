@@ -147,6 +147,7 @@ static const unsigned char* TWIN_REPORTED_PROPERTIES = (const unsigned char*)"{
 static int TWIN_REPORTED_PROPERTIES_LENGTH = 117;
 
 static time_t g_initial_time;
+static const char* g_expected_correlation_id;
 static time_t g_initial_time_plus_30_secs;
 static time_t g_initial_time_plus_60_secs;
 static time_t g_initial_time_plus_90_secs;
@@ -499,7 +500,6 @@ static void set_process_timeouts_expected_calls(time_t current_time, size_t numb
     for (i = 0; i < number_of_expired_pending_operations; i++)
     {
         STRICT_EXPECTED_CALL(get_difftime(current_time, IGNORED_NUM_ARG)).SetReturn(10000000); // Simulate it's expired for sure.
-        STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG)); // correlation id
         STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
     }
 
@@ -512,7 +512,6 @@ static void set_process_timeouts_expected_calls(time_t current_time, size_t numb
 static void set_create_twin_operation_context_expected_calls()
 {
     STRICT_EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
-    set_generate_unique_id_expected_calls();
 }
 
 static void set_add_map_item_expected_calls(const char* name, const char* value)
@@ -545,7 +544,14 @@ static void set_set_message_correlation_id_expected_calls()
 {
     STRICT_EXPECTED_CALL(message_get_properties(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(properties_create());
-    STRICT_EXPECTED_CALL(amqpvalue_create_string(IGNORED_PTR_ARG));
+    if (g_expected_correlation_id == NULL)
+    {
+        STRICT_EXPECTED_CALL(amqpvalue_create_string(IGNORED_PTR_ARG));
+    }
+    else
+    {
+        STRICT_EXPECTED_CALL(amqpvalue_create_string(g_expected_correlation_id));
+    }
     STRICT_EXPECTED_CALL(properties_set_correlation_id(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(message_set_properties(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(amqpvalue_destroy(IGNORED_PTR_ARG));
@@ -864,6 +870,8 @@ static void register_global_mock_returns()
 
 static void reset_test_data()
 {
+    g_expected_correlation_id = NULL;
+
     g_STRING_sprintf_call_count = 0;
     g_STRING_sprintf_fail_on_count = -1;
     saved_STRING_sprintf_handle = NULL;
@@ -1521,6 +1529,7 @@ TEST_FUNCTION(twin_messenger_get_twin_async_success)
     TWIN_MESSENGER_HANDLE handle = create_twin_messenger(config);
 
     umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     set_create_twin_operation_context_expected_calls();
     STRICT_EXPECTED_CALL(singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 
@@ -1541,6 +1550,60 @@ TEST_FUNCTION(twin_messenger_get_twin_async_success)
 }
 
 
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_41_002: [Each TWIN operation shall be identified by the next value of a per-messenger counter, only formatted as a string when the request message is created]
+TEST_FUNCTION(twin_messenger_get_twin_async_correlation_id_from_counter)
+{
+    // arrange
+    TWIN_MESSENGER_CONFIG* config = get_twin_messenger_config();
+    TWIN_MESSENGER_HANDLE handle = create_twin_messenger(config);
+
+    umock_c_reset_all_calls();
+    g_expected_correlation_id = "1";
+    STRICT_EXPECTED_CALL(singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    set_create_twin_operation_context_expected_calls();
+    STRICT_EXPECTED_CALL(singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+    set_create_amqp_message_for_twin_operation_expected_calls(TWIN_OPERATION_TYPE_GET);
+    STRICT_EXPECTED_CALL(get_time(IGNORED_PTR_ARG)).SetReturn(g_initial_time);
+    STRICT_EXPECTED_CALL(amqp_messenger_send_async(TEST_AMQP_MESSENGER_HANDLE, TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(message_destroy(IGNORED_PTR_ARG));
+
+    // act
+    int result = twin_messenger_get_twin_async(handle, on_twin_get_completed_callback, (void*)0x4567);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    // cleanup
+    twin_messenger_destroy(handle);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_41_001: [ If an on-demand GET request is already waiting for its response, the request shall share that response instead of sending its own ]
+TEST_FUNCTION(twin_messenger_get_twin_async_pending_request_shares_response)
+{
+    // arrange
+    TWIN_MESSENGER_CONFIG* config = get_twin_messenger_config();
+    TWIN_MESSENGER_HANDLE handle = create_twin_messenger(config);
+    (void)twin_messenger_get_twin_async(handle, on_twin_get_completed_callback, (void*)0x4567);
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+
+    // act
+    int result = twin_messenger_get_twin_async(handle, on_twin_get_completed_callback, (void*)0x4568);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    // cleanup
+    twin_messenger_destroy(handle);
+}
+
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_109: [If `twin_msgr_handle` or `on_twin_state_update_callback` are NULL, twin_messenger_get_twin_async() shall fail and return a non-zero value]  
 TEST_FUNCTION(twin_messenger_get_twin_async_NULL_handle)
 {
@@ -1587,7 +1650,8 @@ TEST_FUNCTION(twin_messenger_get_twin_async_failure_checks)
     TWIN_MESSENGER_HANDLE handle = create_twin_messenger(config);
 
     umock_c_reset_all_calls();
-    set_create_twin_operation_context_expected_calls(); // 0 - 2
+    STRICT_EXPECTED_CALL(singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG)).CallCannotFail();
+    set_create_twin_operation_context_expected_calls(); // 1
     STRICT_EXPECTED_CALL(singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 
     set_create_amqp_message_for_twin_operation_expected_calls(TWIN_OPERATION_TYPE_GET);
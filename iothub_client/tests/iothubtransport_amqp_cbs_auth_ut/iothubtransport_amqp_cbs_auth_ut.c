@@ -477,6 +477,29 @@ static AUTHENTICATION_HANDLE create_and_start_authentication(AUTHENTICATION_CONF
     return handle;
 }
 
+static AUTHENTICATION_HANDLE create_started_authentication(AUTHENTICATION_CONFIG* config, time_t current_time)
+{
+    AUTHENTICATION_HANDLE handle = create_and_start_authentication(config, false);
+
+    AUTHENTICATION_DO_WORK_EXPECTED_STATE *exp_state = get_do_work_expected_state_struct();
+    exp_state->current_state = AUTHENTICATION_STATE_STARTING;
+    exp_state->sas_token_to_use = TEST_PRIMARY_DEVICE_KEY_STRING_HANDLE;
+    exp_state->sastoken_expiration_time = (size_t)(difftime(current_time, (time_t)0) + DEFAULT_SAS_TOKEN_LIFETIME_SECS);
+
+    crank_authentication_do_work(config, handle, current_time, exp_state, IOTHUB_CREDENTIAL_TYPE_DEVICE_KEY);
+    saved_cbs_put_token_on_operation_complete(saved_cbs_put_token_context, CBS_OPERATION_RESULT_OK, 0, "all good");
+
+    return handle;
+}
+
+static void set_expected_calls_for_sas_token_refresh_check(time_t current_time, time_t put_time, double elapsed_secs)
+{
+    STRICT_EXPECTED_CALL(IoTHubClient_Auth_Get_Credential_Type(IGNORED_PTR_ARG)).SetReturn(IOTHUB_CREDENTIAL_TYPE_DEVICE_KEY);
+    STRICT_EXPECTED_CALL(IoTHubClient_Auth_Get_SasToken_Expiry(IGNORED_PTR_ARG)).SetReturn(3600);
+    STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(current_time);
+    STRICT_EXPECTED_CALL(get_difftime(current_time, put_time)).SetReturn(elapsed_secs);
+}
+
 static void reset_test_data()
 {
     saved_malloc_returns_count = 0;
@@ -1342,6 +1365,58 @@ TEST_FUNCTION(authentication_do_work_DEVICE_AUTH_sas_token_refresh_check)
     authentication_destroy(handle);
 }
 
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_41_001: [The SAS token shall be refreshed once the time since `instance->current_sas_token_put_time` reaches `instance->sas_token_refresh_multiplier` of the SAS token expiry]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_41_002: [authentication_create() shall set `instance->sas_token_refresh_multiplier` between 0.7 and 0.8, derived from the device and module ids]
+TEST_FUNCTION(authentication_do_work_sas_token_refresh_is_due_by_the_end_of_the_jitter_window)
+{
+    // arrange
+    AUTHENTICATION_CONFIG* config = get_auth_config(USE_DEVICE_KEYS);
+    time_t current_time = time(NULL);
+    AUTHENTICATION_HANDLE handle = create_started_authentication(config, current_time);
+    time_t next_time = add_seconds(current_time, 2880);
+    ASSERT_IS_TRUE(INDEFINITE_TIME != next_time, "failed to computer 'next_time'");
+
+    umock_c_reset_all_calls();
+    set_expected_calls_for_sas_token_refresh_check(next_time, current_time, 2880);
+    STRICT_EXPECTED_CALL(STRING_c_str(TEST_IOTHUB_HOST_FQDN_STRING_HANDLE));
+    set_expected_calls_for_put_SAS_token_to_cbs(handle, next_time, TEST_GENERATED_SAS_TOKEN_STRING_HANDLE);
+    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(TEST_DEVICES_PATH_STRING_HANDLE));
+
+    // act
+    authentication_do_work(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    authentication_destroy(handle);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_41_001: [The SAS token shall be refreshed once the time since `instance->current_sas_token_put_time` reaches `instance->sas_token_refresh_multiplier` of the SAS token expiry]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_41_002: [authentication_create() shall set `instance->sas_token_refresh_multiplier` between 0.7 and 0.8, derived from the device and module ids]
+TEST_FUNCTION(authentication_do_work_sas_token_refresh_is_not_due_before_the_jitter_window)
+{
+    // arrange
+    AUTHENTICATION_CONFIG* config = get_auth_config(USE_DEVICE_KEYS);
+    time_t current_time = time(NULL);
+    AUTHENTICATION_HANDLE handle = create_started_authentication(config, current_time);
+    time_t next_time = add_seconds(current_time, 2519);
+    ASSERT_IS_TRUE(INDEFINITE_TIME != next_time, "failed to computer 'next_time'");
+
+    umock_c_reset_all_calls();
+    set_expected_calls_for_sas_token_refresh_check(next_time, current_time, 2519);
+
+    // act
+    authentication_do_work(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    authentication_destroy(handle);
+}
+
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_067: [authentication_do_work() shall create a SAS token using `instance->device_primary_key`, unless it has failed previously]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_071: [A STRING_HANDLE, referred to as `devices_and_modules_path`, shall be created from: iothub_host_fqdn + "/devices/" + device_id (+ "/modules/" + module_id if a module)]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_117: [An empty STRING_HANDLE, referred to as `sasTokenKeyName`, shall be created using STRING_new()]
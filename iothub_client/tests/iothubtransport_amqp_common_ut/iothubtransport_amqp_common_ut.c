@@ -109,6 +109,9 @@ extern "C"
 #include "internal/iothub_client_private.h"
 #include "iothub_client_version.h"
 #include "internal/iothub_client_retry_control.h"
+#include "internal/iothub_client_trace_ring_private.h"
+#include "internal/iothub_client_startup_timeline_private.h"
+#include "internal/iothub_client_connect_admission_private.h"
 #include "internal/iothubtransportamqp_methods.h"
 #include "internal/iothubtransport_amqp_connection.h"
 #include "internal/iothubtransport_amqp_device.h"
@@ -128,6 +131,11 @@ MOCKABLE_FUNCTION(, int, Transport_DeviceMethod_Complete_Callback, const char*,
 
 #include "internal/iothubtransport_amqp_common.h"
 
+/*the transports and clients only write into the trace ring while it is started*/
+bool g_iothub_client_trace_ring_started = false;
+bool g_iothub_client_startup_timeline_started = false;
+bool g_iothub_client_connect_admission_started = false;
+
 TEST_DEFINE_ENUM_TYPE(AMQP_CONNECTION_STATE, AMQP_CONNECTION_STATE_VALUES);
 IMPLEMENT_UMOCK_C_ENUM_TYPE(AMQP_CONNECTION_STATE, AMQP_CONNECTION_STATE_VALUES);
 
@@ -495,21 +503,6 @@ static MESSAGE_DISPOSITION_CONTEXT* TRANSPORT_CONTEXT_DATA_create2(IOTHUB_DEVICE
     return result;
 }
 
-static void set_expected_calls_for_create_device_message_disposition_info()
-{
-    STRICT_EXPECTED_CALL(malloc(sizeof(DEVICE_MESSAGE_DISPOSITION_INFO)));
-
-    static char* source = TEST_MESSAGE_SOURCE_CHAR_PTR;
-    EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .CopyOutArgumentBuffer_destination(&source, sizeof(char*));
-}
-
-static void set_expected_calls_for_destroy_device_message_disposition_info()
-{
-    EXPECTED_CALL(free(IGNORED_PTR_ARG));
-    EXPECTED_CALL(free(IGNORED_PTR_ARG));
-}
-
 static void set_expected_calls_for_SendMessageDisposition(IOTHUBMESSAGE_DISPOSITION_RESULT iothc_disposition_result)
 {
     DEVICE_MESSAGE_DISPOSITION_RESULT device_disposition_result;
@@ -531,7 +524,6 @@ static void set_expected_calls_for_SendMessageDisposition(IOTHUBMESSAGE_DISPOSIT
         device_disposition_result = DEVICE_MESSAGE_DISPOSITION_RESULT_NONE;
     }
 
-    set_expected_calls_for_create_device_message_disposition_info();
     STRICT_EXPECTED_CALL(device_send_message_disposition(TEST_DEVICE_HANDLE, IGNORED_PTR_ARG, device_disposition_result))
         .IgnoreArgument(2);
 
@@ -540,8 +532,6 @@ static void set_expected_calls_for_SendMessageDisposition(IOTHUBMESSAGE_DISPOSIT
     STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG)).IgnoreArgument_ptr();
     STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG)).IgnoreArgument_ptr();
     STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG)).IgnoreArgument_ptr();
-
-    set_expected_calls_for_destroy_device_message_disposition_info();
 }
 
 // @param registered_device
@@ -557,7 +547,8 @@ static void set_expected_calls_for_is_device_registered(IOTHUB_DEVICE_CONFIG* de
 
 static void set_expected_calls_for_Register(IOTHUB_DEVICE_CONFIG* device_config, bool is_using_cbs)
 {
-    set_expected_calls_for_is_device_registered_ex(device_config, NULL);
+    // find_indexed_device
+    // Nothing to expect (no device with the same id hash is registered).
 
     // is_device_credential_acceptable
     // Nothing to expect.
@@ -620,7 +611,7 @@ static void set_expected_calls_for_establish_amqp_connection()
 
 static void set_expected_calls_for_subscribe_methods()
 {
-    STRICT_EXPECTED_CALL(amqp_connection_get_session_handle(TEST_AMQP_CONNECTION_HANDLE, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(amqp_connection_get_session_handle_by_key(TEST_AMQP_CONNECTION_HANDLE, IGNORED_NUM_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument_session_handle();
 
     STRICT_EXPECTED_CALL(iothubtransportamqp_methods_subscribe(TEST_IOTHUBTRANSPORTAMQP_METHODS, TEST_SESSION_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -658,7 +649,7 @@ static void set_expected_calls_for_Device_DoWork(PDLIST_ENTRY wts, int wts_lengt
 {
     if (current_device_state == DEVICE_STATE_STOPPED)
     {
-        STRICT_EXPECTED_CALL(amqp_connection_get_session_handle(TEST_AMQP_CONNECTION_HANDLE, IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(amqp_connection_get_session_handle_by_key(TEST_AMQP_CONNECTION_HANDLE, IGNORED_NUM_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument_session_handle();
 
         if (is_using_cbs)
@@ -797,14 +788,17 @@ static void set_expected_calls_for_prepare_device_for_connection_retry(DEVICE_ST
     }
 }
 
-static void set_expected_calls_for_prepare_for_connection_retry(int number_of_registered_devices, DEVICE_STATE current_device_state)
+static void set_expected_calls_for_prepare_for_connection_retry(int number_of_registered_devices, DEVICE_STATE current_device_state, bool retrieve_options)
 {
     RETRY_ACTION retry_action = RETRY_ACTION_RETRY_NOW;
     STRICT_EXPECTED_CALL(retry_control_should_retry(TEST_RETRY_CONTROL_HANDLE, IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer_retry_action(&retry_action, sizeof(RETRY_ACTION));
 
-    STRICT_EXPECTED_CALL(xio_retrieveoptions(TEST_UNDERLYING_IO_TRANSPORT))
-        .SetReturn(TEST_OPTIONHANDLER_HANDLE);
+    if (retrieve_options)
+    {
+        STRICT_EXPECTED_CALL(xio_retrieveoptions(TEST_UNDERLYING_IO_TRANSPORT))
+            .SetReturn(TEST_OPTIONHANDLER_HANDLE);
+    }
 
     EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
 
@@ -855,6 +849,7 @@ static ON_AMQP_CONNECTION_STATE_CHANGED TEST_amqp_connection_create_saved_on_sta
 static const void* TEST_amqp_connection_create_saved_on_state_changed_context;
 static size_t TEST_amqp_connection_create_saved_c2d_keep_alive_freq_secs;
 static double TEST_amqp_connection_create_saved_cl2svc_keep_alive_send_ratio;
+static size_t TEST_amqp_connection_create_saved_session_count;
 static AMQP_CONNECTION_HANDLE TEST_amqp_connection_create_return;
 static AMQP_CONNECTION_HANDLE TEST_amqp_connection_create(AMQP_CONNECTION_CONFIG* config)
 {
@@ -864,15 +859,17 @@ static AMQP_CONNECTION_HANDLE TEST_amqp_connection_create(AMQP_CONNECTION_CONFIG
     TEST_amqp_connection_create_saved_on_state_changed_context = config->on_state_changed_context;
     TEST_amqp_connection_create_saved_c2d_keep_alive_freq_secs = config->svc2cl_keep_alive_timeout_secs;
     TEST_amqp_connection_create_saved_cl2svc_keep_alive_send_ratio = config->cl2svc_keep_alive_send_ratio;
+    TEST_amqp_connection_create_saved_session_count = config->session_count;
 
     return TEST_amqp_connection_create_return;
 }
 
 static SESSION_HANDLE TEST_amqp_connection_get_session_handle_session_handle;
 static int TEST_amqp_connection_get_session_handle_return;
-static int TEST_amqp_connection_get_session_handle(AMQP_CONNECTION_HANDLE conn_handle, SESSION_HANDLE* session_handle)
+static int TEST_amqp_connection_get_session_handle_by_key(AMQP_CONNECTION_HANDLE conn_handle, size_t key, SESSION_HANDLE* session_handle)
 {
     (void)conn_handle;
+    (void)key;
     *session_handle = TEST_amqp_connection_get_session_handle_session_handle;
 
     return TEST_amqp_connection_get_session_handle_return;
@@ -1159,7 +1156,7 @@ static void register_global_mock_hooks()
     REGISTER_GLOBAL_MOCK_HOOK(DList_InitializeListHead, my_DList_InitializeListHead);
 
     REGISTER_GLOBAL_MOCK_HOOK(amqp_connection_create, TEST_amqp_connection_create);
-    REGISTER_GLOBAL_MOCK_HOOK(amqp_connection_get_session_handle, TEST_amqp_connection_get_session_handle);
+    REGISTER_GLOBAL_MOCK_HOOK(amqp_connection_get_session_handle_by_key, TEST_amqp_connection_get_session_handle_by_key);
     REGISTER_GLOBAL_MOCK_HOOK(amqp_connection_get_cbs_handle, TEST_amqp_connection_get_cbs_handle);
 
     REGISTER_GLOBAL_MOCK_HOOK(get_difftime, TEST_get_difftime);
@@ -1221,10 +1218,13 @@ static void register_global_mock_returns()
 
     REGISTER_GLOBAL_MOCK_RETURN(retry_control_create, TEST_RETRY_CONTROL_HANDLE);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(retry_control_create, NULL);
+
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubClient_ConnectAdmission_TryAcquire, true);
 }
 
 static void reset_test_data()
 {
+    g_iothub_client_connect_admission_started = false;
     g_STRING_sprintf_call_count = 0;
     g_STRING_sprintf_fail_on_count = 0;
 
@@ -1393,7 +1393,7 @@ TEST_FUNCTION(when_creating_the_methods_handler_fails_then_IoTHubTransport_AMQP_
     size_t n = umock_c_negative_tests_call_count();
     for (i = 0; i < n; i++)
     {
-        if (i == 0 || i == 2 || i == 3 || i == 4 || i == 5 || i == 7 || i == 8 || i == 13)
+        if (i == 1 || i == 2 || i == 3 || i == 4 || i == 6 || i == 7 || i == 12)
         {
             // These expected calls do not cause the API to fail.
             continue;
@@ -2218,6 +2218,7 @@ TEST_FUNCTION(Register_NULL_config_device_id)
 }
 
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_064: [If the device is already registered, IoTHubTransport_AMQP_Common_Register shall fail and return NULL.]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_003: [IoTHubTransport_AMQP_Common_Register shall look the device id up in `instance->device_index` instead of scanning `instance->registered_devices`]
 TEST_FUNCTION(Register_device_already_registered)
 {
     // arrange
@@ -2225,20 +2226,22 @@ TEST_FUNCTION(Register_device_already_registered)
     TRANSPORT_LL_HANDLE handle = create_transport();
 
     IOTHUB_DEVICE_CONFIG* device_config = create_device_config(TEST_DEVICE_ID_CHAR_PTR, true);
+    IOTHUB_DEVICE_HANDLE registered_device_handle = register_device(handle, device_config, &TEST_waitingToSend, true);
 
-    STRICT_EXPECTED_CALL(singlylinkedlist_find(TEST_REGISTERED_DEVICES_LIST, IGNORED_PTR_ARG, device_config->deviceId))
-        .IgnoreArgument(2)
-        .SetReturn(TEST_LIST_ITEM_HANDLE);
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(STRING_c_str(TEST_DEVICE_ID_STRING_HANDLE))
+        .SetReturn(TEST_DEVICE_ID_CHAR_PTR);
 
     // act
     IOTHUB_DEVICE_HANDLE device_handle = IoTHubTransport_AMQP_Common_Register(handle, device_config, &TEST_waitingToSend);
 
     // assert
+    ASSERT_IS_NOT_NULL(registered_device_handle);
     ASSERT_IS_NULL(device_handle);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     // cleanup
-    destroy_transport(handle, device_handle, NULL);
+    destroy_transport(handle, registered_device_handle, NULL);
 }
 
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_065: [IoTHubTransport_AMQP_Common_Register shall fail and return NULL if the device is not using an authentication mode compatible with the currently used by the transport.]
@@ -2257,10 +2260,6 @@ TEST_FUNCTION(Register_CBS_transport_X509_credentials)
 
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(singlylinkedlist_find(TEST_REGISTERED_DEVICES_LIST, IGNORED_PTR_ARG, device_config2->deviceId))
-        .IgnoreArgument(2)
-        .SetReturn(NULL);
-
     // act
     IOTHUB_DEVICE_HANDLE device_handle2 = IoTHubTransport_AMQP_Common_Register(handle, device_config2, &TEST_waitingToSend);
 
@@ -2289,10 +2288,6 @@ TEST_FUNCTION(Register_X509_transport_CBS_credentials)
 
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(singlylinkedlist_find(TEST_REGISTERED_DEVICES_LIST, IGNORED_PTR_ARG, device_config2->deviceId))
-        .IgnoreArgument(2)
-        .SetReturn(NULL);
-
     // act
     IOTHUB_DEVICE_HANDLE device_handle2 = IoTHubTransport_AMQP_Common_Register(handle, device_config2, &TEST_waitingToSend);
 
@@ -2328,7 +2323,7 @@ TEST_FUNCTION(Register_failure_checks)
     size_t i, n = umock_c_negative_tests_call_count();
     for (i = 0; i < n; i++)
     {
-        if (i == 0 || i == 2 || i == 3 || i == 4 || i >= 5)
+        if (i == 1 || i == 2 || i == 3 || i >= 4)
         {
             // These expected calls do not cause the API to fail.
             continue;
@@ -2917,8 +2912,6 @@ TEST_FUNCTION(SetOption_xio_option_success)
         .IgnoreArgument(2)
         .IgnoreArgument(3)
         .SetReturn(0);
-    STRICT_EXPECTED_CALL(xio_retrieveoptions(TEST_UNDERLYING_IO_TRANSPORT))
-        .SetReturn(TEST_OPTIONHANDLER_HANDLE);
 
     // act
     IOTHUB_CLIENT_RESULT result = IoTHubTransport_AMQP_Common_SetOption(handle, "Some XIO option name", &value);
@@ -2993,6 +2986,70 @@ TEST_FUNCTION(SetOption_xio_option_fails)
     destroy_transport(handle, device_handle, NULL);
 }
 
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_014: [If `option` is `OPTION_TLS_SESSION_RESUMPTION`, `value` shall be saved and applied to `instance->tls_io`, if created, using xio_setoption(); a failure of xio_setoption() shall be logged and ignored]
+TEST_FUNCTION(SetOption_tls_session_resumption_without_tls_io_success)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+
+    IOTHUB_DEVICE_CONFIG* device_config = create_device_config(TEST_DEVICE_ID_CHAR_PTR, true);
+    IOTHUB_DEVICE_HANDLE device_handle = register_device(handle, device_config, &TEST_waitingToSend, true);
+    ASSERT_IS_NOT_NULL(device_handle);
+
+    bool value = true;
+
+    umock_c_reset_all_calls();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_TLS_SESSION_RESUMPTION, &value);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    destroy_transport(handle, device_handle, NULL);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_013: [If `instance->option_tls_session_resumption` is true, the new TLS I/O shall get OPTION_TLS_SESSION_RESUMPTION with xio_setoption() before the saved options are restored; a failure shall be logged and ignored]
+TEST_FUNCTION(SetOption_tls_session_resumption_applied_to_new_tls_io)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+
+    IOTHUB_DEVICE_CONFIG* device_config = create_device_config(TEST_DEVICE_ID_CHAR_PTR, true);
+    IOTHUB_DEVICE_HANDLE device_handle = register_device(handle, device_config, &TEST_waitingToSend, true);
+    ASSERT_IS_NOT_NULL(device_handle);
+
+    bool value = true;
+    (void)IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_TLS_SESSION_RESUMPTION, &value);
+
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(STRING_c_str(TEST_IOTHUB_HOST_FQDN_STRING_HANDLE))
+        .SetReturn(TEST_IOTHUB_HOST_FQDN_CHAR_PTR);
+    // the TLS adapter does not support session resumption, which is not an error
+    STRICT_EXPECTED_CALL(xio_setoption(TEST_UNDERLYING_IO_TRANSPORT, OPTION_TLS_SESSION_RESUMPTION, IGNORED_PTR_ARG))
+        .IgnoreArgument(3)
+        .SetReturn(1);
+    STRICT_EXPECTED_CALL(xio_setoption(TEST_UNDERLYING_IO_TRANSPORT, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(2)
+        .IgnoreArgument(3)
+        .SetReturn(0);
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransport_AMQP_Common_SetOption(handle, "Some XIO option name", &value);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    destroy_transport(handle, device_handle, NULL);
+}
+
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_99_002: [If `OPTION_AMQP_REMOTE_IDLE_TIMEOUT_RATIO` value is 0, the test will fail]
 TEST_FUNCTION(SetOption_cl2svc_keep_alive_send_ratio_fail_for_zero)
 {
@@ -3999,6 +4056,35 @@ TEST_FUNCTION(on_message_received_fails)
     destroy_transport(handle, device_handle, NULL);
 }
 
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_027: [If `instance->amqp_connection` is NULL and connect admission control is started and has no token, the connection shall not be established on this call]
+TEST_FUNCTION(DoWork_waits_for_connect_admission)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+
+    IOTHUB_DEVICE_CONFIG* device_config = create_device_config(TEST_DEVICE_ID_CHAR_PTR, true);
+    IOTHUB_DEVICE_HANDLE device_handle = register_device(handle, device_config, &TEST_waitingToSend, true);
+    ASSERT_IS_NOT_NULL(device_handle);
+
+    g_iothub_client_connect_admission_started = true;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_REGISTERED_DEVICES_LIST));
+    STRICT_EXPECTED_CALL(IoTHubClient_ConnectAdmission_TryAcquire())
+        .SetReturn(false);
+
+    // act
+    IoTHubTransport_AMQP_Common_DoWork(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(TEST_amqp_connection_create_saved_on_state_changed_callback);
+
+    // cleanup
+    destroy_transport(handle, device_handle, NULL);
+}
+
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_019: [If `instance->amqp_connection` is NULL, it shall be established]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_020: [If the amqp_connection is OPENED, the transport shall iterate through each registered device and perform a device-specific do_work on each]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_022: [If `instance->amqp_connection` is not NULL, amqp_connection_do_work shall be invoked]
@@ -4008,8 +4094,8 @@ TEST_FUNCTION(on_message_received_fails)
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_110: [If amqp_connection_create() succeeds, IoTHubTransport_AMQP_Common_DoWork shall proceed to invoke amqp_connection_do_work]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_036: [If the device state is DEVICE_STATE_STOPPED, it shall be started]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_037: [If transport is using CBS authentication, amqp_connection_get_cbs_handle() shall be invoked on `instance->connection`]
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_039: [amqp_connection_get_session_handle() shall be invoked on `instance->connection`]
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_040: [If amqp_connection_get_session_handle() fails, IoTHubTransport_AMQP_Common_DoWork shall fail and return]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_039: [amqp_connection_get_session_handle_by_key() shall be invoked on `instance->connection` with the hash of the device id]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_040: [If amqp_connection_get_session_handle_by_key() fails, IoTHubTransport_AMQP_Common_DoWork shall fail and return]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_041: [The device handle shall be started using device_start_async()]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_059: [`new_state` shall be saved in to the transport instance]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_061: [If `new_state` is the same as `previous_state`, on_device_state_changed_callback shall return]
@@ -4065,6 +4151,166 @@ TEST_FUNCTION(DoWork_success)
     destroy_transport(handle, device_handle, NULL);
 }
 
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_004: [Devices entering DEVICE_STATE_STARTING shall be counted in `instance->number_of_devices_starting`, and no longer counted once they leave it]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_005: [If `instance->option_cbs_auth_window` devices are already in DEVICE_STATE_STARTING, the device shall not be started until one of them leaves that state]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_008: [If `option` is `OPTION_AMQP_CBS_AUTH_WINDOW`, `value` shall be saved on `instance->option_cbs_auth_window`]
+TEST_FUNCTION(DoWork_cbs_auth_window_holds_back_device_start)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+    size_t cbs_auth_window = 1;
+
+    IOTHUB_DEVICE_CONFIG* device_config = create_device_config(TEST_DEVICE_ID_CHAR_PTR, true);
+    IOTHUB_DEVICE_HANDLE device_handle1 = register_device(handle, device_config, &TEST_waitingToSend, true);
+    ASSERT_IS_NOT_NULL(device_handle1);
+    void* device1_context = TEST_device_create_saved_on_state_changed_context;
+
+    umock_c_reset_all_calls();
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_AMQP_CBS_AUTH_WINDOW, &cbs_auth_window));
+
+    crank_transport(handle, &TEST_waitingToSend, 0, DEVICE_STATE_STOPPED, false, true, false, false, 1, TEST_current_time, false);
+
+    TEST_amqp_connection_create_saved_on_state_changed_callback(
+        TEST_amqp_connection_create_saved_on_state_changed_context,
+        AMQP_CONNECTION_STATE_CLOSED, AMQP_CONNECTION_STATE_OPENED);
+
+    crank_transport(handle, &TEST_waitingToSend, 0, DEVICE_STATE_STOPPED, true, true, true, true, 1, TEST_current_time, false);
+
+    STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(TEST_current_time);
+    TEST_device_create_saved_on_state_changed_callback(device1_context, DEVICE_STATE_STOPPED, DEVICE_STATE_STARTING);
+
+    device_config = create_device_config(TEST_DEVICE_ID_2_CHAR_PTR, true);
+    IOTHUB_DEVICE_HANDLE device_handle2 = register_device(handle, device_config, &TEST_waitingToSend, true);
+    ASSERT_IS_NOT_NULL(device_handle2);
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_REGISTERED_DEVICES_LIST));
+    EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+    set_expected_calls_for_Device_DoWork(&TEST_waitingToSend, 0, DEVICE_STATE_STARTING, true, TEST_current_time, false);
+    EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
+    EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(device_do_work(TEST_DEVICE_HANDLE));
+    EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(amqp_connection_do_work(TEST_AMQP_CONNECTION_HANDLE));
+
+    // act
+    IoTHubTransport_AMQP_Common_DoWork(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // arrange
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(TEST_current_time);
+    STRICT_EXPECTED_CALL(retry_control_reset(TEST_RETRY_CONTROL_HANDLE));
+    STRICT_EXPECTED_CALL(Transport_ConnectionStatusCallBack(IOTHUB_CLIENT_CONNECTION_AUTHENTICATED, IOTHUB_CLIENT_CONNECTION_OK, IGNORED_PTR_ARG));
+    TEST_device_create_saved_on_state_changed_callback(device1_context, DEVICE_STATE_STARTING, DEVICE_STATE_STARTED);
+
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_REGISTERED_DEVICES_LIST));
+    EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+    set_expected_calls_for_Device_DoWork(&TEST_waitingToSend, 0, DEVICE_STATE_STARTED, true, TEST_current_time, false);
+    EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
+    EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+    set_expected_calls_for_Device_DoWork(&TEST_waitingToSend, 0, DEVICE_STATE_STOPPED, true, TEST_current_time, false);
+    EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(amqp_connection_do_work(TEST_AMQP_CONNECTION_HANDLE));
+
+    // act
+    IoTHubTransport_AMQP_Common_DoWork(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    destroy_transport(handle, device_handle1, device_handle2);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_017: [If `instance->option_device_idle_suspend_secs` is not 0, a device with no subscriptions, no events waiting or in flight and no activity for that many seconds shall be suspended using device_stop()]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_018: [If the device is suspended, it shall not be started until it has events waiting to be sent or is resumed by a twin or subscription request]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_020: [If `new_state` is DEVICE_STATE_STOPPED and the device is suspended, the connection status callback shall not be invoked]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_021: [If `option` is `OPTION_AMQP_DEVICE_IDLE_SUSPEND_SECS`, `value` shall be saved on `instance->option_device_idle_suspend_secs`]
+TEST_FUNCTION(DoWork_suspends_idle_device_until_it_has_events_to_send)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+    size_t idle_suspend_secs = 60;
+    DEVICE_SEND_STATUS send_status = DEVICE_SEND_STATUS_IDLE;
+    bool is_timed_out = true;
+
+    IOTHUB_DEVICE_CONFIG* device_config = create_device_config(TEST_DEVICE_ID_CHAR_PTR, true);
+    IOTHUB_DEVICE_HANDLE device_handle = register_device(handle, device_config, &TEST_waitingToSend, true);
+    ASSERT_IS_NOT_NULL(device_handle);
+
+    crank_transport_ready_after_create(handle, &TEST_waitingToSend, 0, false, true, 1, TEST_current_time, false);
+
+    umock_c_reset_all_calls();
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_AMQP_DEVICE_IDLE_SUSPEND_SECS, &idle_suspend_secs));
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_REGISTERED_DEVICES_LIST));
+    EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+    set_expected_calls_for_send_pending_events(&TEST_waitingToSend, 0);
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&TEST_waitingToSend))
+        .SetReturn(1);
+    STRICT_EXPECTED_CALL(device_get_send_status(TEST_DEVICE_HANDLE, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(2, &send_status, sizeof(DEVICE_SEND_STATUS));
+    STRICT_EXPECTED_CALL(is_timeout_reached(TEST_current_time, (unsigned int)idle_suspend_secs, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(3, &is_timed_out, sizeof(bool));
+    STRICT_EXPECTED_CALL(device_stop(TEST_DEVICE_HANDLE));
+    STRICT_EXPECTED_CALL(device_do_work(TEST_DEVICE_HANDLE));
+    EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(amqp_connection_do_work(TEST_AMQP_CONNECTION_HANDLE));
+
+    // act
+    IoTHubTransport_AMQP_Common_DoWork(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // arrange
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(TEST_current_time);
+    STRICT_EXPECTED_CALL(STRING_c_str(TEST_DEVICE_ID_STRING_HANDLE))
+        .SetReturn(TEST_DEVICE_ID_CHAR_PTR);
+    TEST_device_create_saved_on_state_changed_callback(TEST_device_create_saved_on_state_changed_context,
+        DEVICE_STATE_STARTED, DEVICE_STATE_STOPPED);
+
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_REGISTERED_DEVICES_LIST));
+    EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&TEST_waitingToSend))
+        .SetReturn(1);
+    STRICT_EXPECTED_CALL(device_do_work(TEST_DEVICE_HANDLE));
+    EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(amqp_connection_do_work(TEST_AMQP_CONNECTION_HANDLE));
+
+    // act
+    IoTHubTransport_AMQP_Common_DoWork(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // arrange
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_REGISTERED_DEVICES_LIST));
+    EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&TEST_waitingToSend))
+        .SetReturn(0);
+    set_expected_calls_for_Device_DoWork(&TEST_waitingToSend, 0, DEVICE_STATE_STOPPED, true, TEST_current_time, false);
+    EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(amqp_connection_do_work(TEST_AMQP_CONNECTION_HANDLE));
+
+    // act
+    IoTHubTransport_AMQP_Common_DoWork(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    destroy_transport(handle, device_handle, NULL);
+}
+
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_115: [If the AMQP connection is closed by the service side, the connection retry logic shall be triggered]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_126: [The connection retry shall be attempted only if retry_control_should_retry() returns RETRY_ACTION_NOW, or if it fails]
 TEST_FUNCTION(on_amqp_connection_state_changed_CLOSED_unexpectedly)
@@ -4094,12 +4340,127 @@ TEST_FUNCTION(on_amqp_connection_state_changed_CLOSED_unexpectedly)
         TEST_amqp_connection_create_saved_on_state_changed_context,
         AMQP_CONNECTION_STATE_OPENED, AMQP_CONNECTION_STATE_CLOSED);
 
-    set_expected_calls_for_prepare_for_connection_retry(1, DEVICE_STATE_STOPPED);
+    set_expected_calls_for_prepare_for_connection_retry(1, DEVICE_STATE_STOPPED, true);
+    IoTHubTransport_AMQP_Common_DoWork(handle);
+
+    set_expected_calls_for_DoWork2(&TEST_waitingToSend, 0, DEVICE_STATE_STOPPED, false, true, true, false, false, 1, TEST_current_time, false);
+    IoTHubTransport_AMQP_Common_DoWork(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    destroy_transport(handle, device_handle, NULL);
+}
+
+static void close_amqp_connection_and_reconnect(TRANSPORT_LL_HANDLE handle)
+{
+    set_expected_calls_for_DoWork(&TEST_waitingToSend, 0, DEVICE_STATE_STOPPED, false, true, false, false, 1, TEST_current_time, false);
+    IoTHubTransport_AMQP_Common_DoWork(handle);
+
+    TEST_amqp_connection_create_saved_on_state_changed_callback(
+        TEST_amqp_connection_create_saved_on_state_changed_context,
+        AMQP_CONNECTION_STATE_CLOSED, AMQP_CONNECTION_STATE_OPENED);
+
+    set_expected_calls_for_DoWork(&TEST_waitingToSend, 0, DEVICE_STATE_STOPPED, true, true, true, true, 1, TEST_current_time, false);
+    IoTHubTransport_AMQP_Common_DoWork(handle);
+
+    TEST_amqp_connection_create_saved_on_state_changed_callback(
+        TEST_amqp_connection_create_saved_on_state_changed_context,
+        AMQP_CONNECTION_STATE_OPENED, AMQP_CONNECTION_STATE_CLOSED);
+
+    set_expected_calls_for_prepare_for_connection_retry(1, DEVICE_STATE_STOPPED, true);
     IoTHubTransport_AMQP_Common_DoWork(handle);
 
     set_expected_calls_for_DoWork2(&TEST_waitingToSend, 0, DEVICE_STATE_STOPPED, false, true, true, false, false, 1, TEST_current_time, false);
     IoTHubTransport_AMQP_Common_DoWork(handle);
 
+    // the new connection opens and gets closed by the service again
+    TEST_amqp_connection_create_saved_on_state_changed_callback(
+        TEST_amqp_connection_create_saved_on_state_changed_context,
+        AMQP_CONNECTION_STATE_CLOSED, AMQP_CONNECTION_STATE_OPENED);
+    TEST_amqp_connection_create_saved_on_state_changed_callback(
+        TEST_amqp_connection_create_saved_on_state_changed_context,
+        AMQP_CONNECTION_STATE_OPENED, AMQP_CONNECTION_STATE_CLOSED);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_025: [If `instance->saved_tls_options` is set, no option was passed to `instance->tls_io` since it was retrieved and `instance->option_tls_session_resumption` is false, it shall be kept instead of retrieved again]
+TEST_FUNCTION(connection_retry_keeps_saved_tls_options)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+
+    IOTHUB_DEVICE_CONFIG* device_config = create_device_config(TEST_DEVICE_ID_CHAR_PTR, true);
+    IOTHUB_DEVICE_HANDLE device_handle = register_device(handle, device_config, &TEST_waitingToSend, true);
+    ASSERT_IS_NOT_NULL(device_handle);
+
+    close_amqp_connection_and_reconnect(handle);
+
+    umock_c_reset_all_calls();
+    set_expected_calls_for_prepare_for_connection_retry(1, DEVICE_STATE_STOPPED, false);
+
+    // act
+    IoTHubTransport_AMQP_Common_DoWork(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    destroy_transport(handle, device_handle, NULL);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_025: [If `instance->saved_tls_options` is set, no option was passed to `instance->tls_io` since it was retrieved and `instance->option_tls_session_resumption` is false, it shall be kept instead of retrieved again]
+TEST_FUNCTION(connection_retry_with_tls_session_resumption_retrieves_tls_options)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+
+    IOTHUB_DEVICE_CONFIG* device_config = create_device_config(TEST_DEVICE_ID_CHAR_PTR, true);
+    IOTHUB_DEVICE_HANDLE device_handle = register_device(handle, device_config, &TEST_waitingToSend, true);
+    ASSERT_IS_NOT_NULL(device_handle);
+
+    bool value = true;
+    (void)IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_TLS_SESSION_RESUMPTION, &value);
+
+    close_amqp_connection_and_reconnect(handle);
+
+    umock_c_reset_all_calls();
+    set_expected_calls_for_prepare_for_connection_retry(1, DEVICE_STATE_STOPPED, true);
+
+    // act
+    IoTHubTransport_AMQP_Common_DoWork(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    destroy_transport(handle, device_handle, NULL);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_026: [Once an option is passed to `instance->tls_io`, `instance->saved_tls_options` shall be retrieved again on the next connection retry]
+TEST_FUNCTION(connection_retry_after_xio_option_retrieves_tls_options)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+
+    IOTHUB_DEVICE_CONFIG* device_config = create_device_config(TEST_DEVICE_ID_CHAR_PTR, true);
+    IOTHUB_DEVICE_HANDLE device_handle = register_device(handle, device_config, &TEST_waitingToSend, true);
+    ASSERT_IS_NOT_NULL(device_handle);
+
+    close_amqp_connection_and_reconnect(handle);
+
+    bool value = true;
+    (void)IoTHubTransport_AMQP_Common_SetOption(handle, "Some XIO option name", &value);
+
+    umock_c_reset_all_calls();
+    set_expected_calls_for_prepare_for_connection_retry(1, DEVICE_STATE_STOPPED, true);
+
+    // act
+    IoTHubTransport_AMQP_Common_DoWork(handle);
+
     // assert
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
@@ -4277,6 +4638,39 @@ TEST_FUNCTION(DoWork_configures_AMQP_connection_using_cl2svc_keep_alive_send_rat
     destroy_transport(handle, device_handle, NULL);
 }
 
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_022: [`instance->option_amqp_session_count` shall be set into `AMQP_CONNECTION_CONFIG->session_count`]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_024: [If `option` is `OPTION_AMQP_SESSION_COUNT`, `value` shall be saved on `instance->option_amqp_session_count`]
+TEST_FUNCTION(DoWork_configures_AMQP_connection_using_amqp_session_count)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+
+    const char* certificate = TEST_X509_CERTIFICATE;
+    const char* private_key = TEST_X509_PRIVATE_KEY;
+    size_t session_count = 4;
+    (void)IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_X509_CERT, certificate);
+    (void)IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_X509_PRIVATE_KEY, private_key);
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_AMQP_SESSION_COUNT, &session_count));
+
+    IOTHUB_DEVICE_CONFIG* device_config = create_device_config_for_x509(TEST_DEVICE_ID_CHAR_PTR);
+    IOTHUB_DEVICE_HANDLE device_handle = register_device(handle, device_config, &TEST_waitingToSend, false);
+    ASSERT_IS_NOT_NULL(device_handle);
+
+    umock_c_reset_all_calls();
+    set_expected_calls_for_DoWork(&TEST_waitingToSend, 0, DEVICE_STATE_STOPPED, true, true, false, false, 1, TEST_current_time, false);
+
+    // act
+    IoTHubTransport_AMQP_Common_DoWork(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 4, TEST_amqp_connection_create_saved_session_count);
+
+    // cleanup
+    destroy_transport(handle, device_handle, NULL);
+}
+
 
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_121: [If `new_state` is DEVICE_STATE_STOPPED, IoTHubClientCore_LL_ConnectionStatusCallBack shall be invoked with IOTHUB_CLIENT_CONNECTION_UNAUTHENTICATED and IOTHUB_CLIENT_CONNECTION_OK]
 TEST_FUNCTION(ConnectionStatusCallBack_UNAUTH_OK)
@@ -4544,8 +4938,7 @@ TEST_FUNCTION(IoTHubTransport_AMQP_Common_SendMessageDisposition_NULL_CONTEXT_fa
 }
 
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_10_004: [IoTHubTransport_AMQP_Common_SendMessageDisposition shall convert the given IOTHUBMESSAGE_DISPOSITION_RESULT to the equivalent DEVICE_MESSAGE_DISPOSITION_RESULT and send it via device_send_message_disposition.]
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_112: [A DEVICE_MESSAGE_DISPOSITION_INFO instance shall be created with a copy of the `link_name` and `message_id` contained in `message_data`]
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_114: [`IoTHubTransport_AMQP_Common_SendMessageDisposition()` shall destroy the DEVICE_MESSAGE_DISPOSITION_INFO instance]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_41_012: [A DEVICE_MESSAGE_DISPOSITION_INFO instance shall be filled on the stack with the `link_name` and `message_id` contained in `message_data`, without copying the link name]
 TEST_FUNCTION(IoTHubTransport_AMQP_Common_SendMessageDisposition_ACCEPTED_succeeds)
 {
     // arrange
@@ -4592,49 +4985,11 @@ TEST_FUNCTION(IoTHubTransport_AMQP_Common_SendMessageDisposition_ACCEPTED_fails)
     data->transportContext = TRANSPORT_CONTEXT_DATA_create2(device_handle);
 
     umock_c_reset_all_calls();
-    set_expected_calls_for_create_device_message_disposition_info();
     STRICT_EXPECTED_CALL(device_send_message_disposition(TEST_DEVICE_HANDLE, IGNORED_PTR_ARG, DEVICE_MESSAGE_DISPOSITION_RESULT_ACCEPTED))
         .IgnoreArgument(2)
         .SetReturn(1);
     EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG))
         .SetReturn(TEST_DEVICE_ID_CHAR_PTR);
-    set_expected_calls_for_destroy_device_message_disposition_info();
-    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
-
-    // act
-    IOTHUB_CLIENT_RESULT result = IoTHubTransport_AMQP_Common_SendMessageDisposition(data, IOTHUBMESSAGE_ACCEPTED);
-
-    // assert
-    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
-
-    // cleanup
-    destroy_transport(handle, device_handle, NULL);
-}
-
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_113: [If the DEVICE_MESSAGE_DISPOSITION_INFO fails to be created, `IoTHubTransport_AMQP_Common_SendMessageDisposition()` shall fail and return IOTHUB_CLIENT_ERROR]
-TEST_FUNCTION(IoTHubTransport_AMQP_Common_SendMessageDisposition_DEVICE_MESSAGE_DISPOSITION_INFO_create_fails)
-{
-    // arrange
-    initialize_test_variables();
-    TRANSPORT_LL_HANDLE handle = create_transport();
-
-    IOTHUB_DEVICE_CONFIG* device_config = create_device_config(TEST_DEVICE_ID_CHAR_PTR, false);
-    IOTHUB_DEVICE_HANDLE device_handle = register_device(handle, device_config, &TEST_waitingToSend, true);
-    ASSERT_IS_NOT_NULL(device_handle);
-
-    MESSAGE_CALLBACK_INFO* data = (MESSAGE_CALLBACK_INFO*)malloc(sizeof(MESSAGE_CALLBACK_INFO));
-    memset(data, 0, sizeof(MESSAGE_CALLBACK_INFO));
-    data->messageHandle = TEST_IOTHUB_MESSAGE_HANDLE;
-    data->transportContext = TRANSPORT_CONTEXT_DATA_create2(device_handle);
-
-    umock_c_reset_all_calls();
-    STRICT_EXPECTED_CALL(malloc(sizeof(DEVICE_MESSAGE_DISPOSITION_INFO)))
-        .SetReturn(NULL);
-    EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG))
-        .SetReturn(TEST_DEVICE_ID_CHAR_PTR);
     STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
@@ -4697,13 +5052,11 @@ TEST_FUNCTION(IoTHubTransport_AMQP_Common_SendMessageDisposition_ABANDONED_fails
     data->transportContext = TRANSPORT_CONTEXT_DATA_create2(device_handle);
 
     umock_c_reset_all_calls();
-    set_expected_calls_for_create_device_message_disposition_info();
     STRICT_EXPECTED_CALL(device_send_message_disposition(TEST_DEVICE_HANDLE, IGNORED_PTR_ARG, DEVICE_MESSAGE_DISPOSITION_RESULT_RELEASED))
         .IgnoreArgument(2)
         .SetReturn(1);
     EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG))
         .SetReturn(TEST_DEVICE_ID_CHAR_PTR);
-    set_expected_calls_for_destroy_device_message_disposition_info();
     STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
@@ -4766,13 +5119,11 @@ TEST_FUNCTION(IoTHubTransport_AMQP_Common_SendMessageDisposition_REJECTED_fails)
     data->transportContext = TRANSPORT_CONTEXT_DATA_create2(device_handle);
 
     umock_c_reset_all_calls();
-    set_expected_calls_for_create_device_message_disposition_info();
     STRICT_EXPECTED_CALL(device_send_message_disposition(TEST_DEVICE_HANDLE, IGNORED_PTR_ARG, DEVICE_MESSAGE_DISPOSITION_RESULT_REJECTED))
         .IgnoreArgument(2)
         .SetReturn(1);
     EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG))
         .SetReturn(TEST_DEVICE_ID_CHAR_PTR);
-    set_expected_calls_for_destroy_device_message_disposition_info();
     STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
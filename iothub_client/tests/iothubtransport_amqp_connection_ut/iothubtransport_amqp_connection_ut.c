@@ -83,6 +83,7 @@ static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
 #define TEST_UNIQUE_ID                                    "ab345cd00829ef12"
 #define TEST_SESSION_HANDLE                               (SESSION_HANDLE)0x4453
 #define TEST_CBS_HANDLE                                   (CBS_HANDLE)0x4454
+#define TEST_ADDITIONAL_SESSION_HANDLE(index)             (SESSION_HANDLE)(0x4460 + (index))
 
 // Helpers
 static int saved_malloc_returns_count = 0;
@@ -166,6 +167,7 @@ static AMQP_CONNECTION_CONFIG* get_amqp_connection_config()
     global_amqp_connection_config.is_trace_on = true;
     global_amqp_connection_config.svc2cl_keep_alive_timeout_secs = 123;
     global_amqp_connection_config.cl2svc_keep_alive_send_ratio   = 0.5;
+    global_amqp_connection_config.session_count = 0;
 
     return &global_amqp_connection_config;
 }
@@ -222,6 +224,22 @@ static void set_exp_calls_for_amqp_connection_create(AMQP_CONNECTION_CONFIG* amq
     STRICT_EXPECTED_CALL(session_set_incoming_window(TEST_SESSION_HANDLE, (uint32_t)DEFAULT_INCOMING_WINDOW_SIZE));
     STRICT_EXPECTED_CALL(session_set_outgoing_window(TEST_SESSION_HANDLE, (uint32_t)DEFAULT_OUTGOING_WINDOW_SIZE));
 
+    // Additional sessions
+    if (amqp_connection_config->session_count > 1)
+    {
+        size_t i;
+
+        STRICT_EXPECTED_CALL(malloc(IGNORED_NUM_ARG)).IgnoreArgument(1);
+
+        for (i = 0; i < amqp_connection_config->session_count - 1; i++)
+        {
+            STRICT_EXPECTED_CALL(session_create(TEST_CONNECTION_HANDLE, NULL, NULL))
+                .SetReturn(TEST_ADDITIONAL_SESSION_HANDLE(i));
+            STRICT_EXPECTED_CALL(session_set_incoming_window(TEST_ADDITIONAL_SESSION_HANDLE(i), (uint32_t)DEFAULT_INCOMING_WINDOW_SIZE));
+            STRICT_EXPECTED_CALL(session_set_outgoing_window(TEST_ADDITIONAL_SESSION_HANDLE(i), (uint32_t)DEFAULT_OUTGOING_WINDOW_SIZE));
+        }
+    }
+
     // CBS
     if (amqp_connection_config->create_cbs_connection)
     {
@@ -238,6 +256,19 @@ static void set_exp_calls_for_amqp_connection_destroy(AMQP_CONNECTION_CONFIG* co
     }
 
     STRICT_EXPECTED_CALL(session_destroy(TEST_SESSION_HANDLE));
+
+    if (config->session_count > 1)
+    {
+        size_t i;
+
+        for (i = 0; i < config->session_count - 1; i++)
+        {
+            STRICT_EXPECTED_CALL(session_destroy(TEST_ADDITIONAL_SESSION_HANDLE(i)));
+        }
+
+        STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+    }
+
     STRICT_EXPECTED_CALL(connection_destroy(TEST_CONNECTION_HANDLE));
 
     if (config->create_sasl_io || config->create_cbs_connection)
@@ -947,6 +978,210 @@ TEST_FUNCTION(amqp_connection_get_session_handle_success)
     amqp_connection_destroy(handle);
 }
 
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_41_001: [Only if `config->session_count` is greater than 1, amqp_connection_create() shall create `config->session_count - 1` sessions beyond `instance->session_handle`]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_41_002: [amqp_connection_create() shall allocate an array for the `config->session_count - 1` sessions beyond `instance->session_handle`]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_41_003: [Each additional session shall be created and have its windows set the same way as `instance->session_handle`]
+TEST_FUNCTION(amqp_connection_create_with_session_count_success)
+{
+    // arrange
+    AMQP_CONNECTION_CONFIG* config = get_amqp_connection_config();
+    config->session_count = 3;
+
+    umock_c_reset_all_calls();
+    set_exp_calls_for_amqp_connection_create(config);
+
+    // act
+    AMQP_CONNECTION_HANDLE handle = amqp_connection_create(config);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NOT_NULL(handle);
+
+    // cleanup
+    amqp_connection_destroy(handle);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_41_004: [If malloc() or any session_create() fails, amqp_connection_create() shall fail and return NULL]
+TEST_FUNCTION(amqp_connection_create_with_session_count_negative_checks)
+{
+    // arrange
+    ASSERT_ARE_EQUAL(int, 0, umock_c_negative_tests_init());
+
+    AMQP_CONNECTION_CONFIG* config = get_amqp_connection_config();
+    config->session_count = 2;
+
+    umock_c_reset_all_calls();
+    set_exp_calls_for_amqp_connection_create(config);
+    umock_c_negative_tests_snapshot();
+
+    // act
+    for (size_t i = 0; i < umock_c_negative_tests_call_count(); i++)
+    {
+        // arrange
+        char error_msg[64];
+
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(i);
+
+        TEST_connection_create2_result = TEST_CONNECTION_HANDLE;
+
+        if (i == 2  || // saslmssbcbs_get_interface
+            i == 4  || // saslclientio_get_interface_description
+            i == 9  || // STRING_c_str(instance->iothub_fqdn) for connection_create2
+            i == 13 || // connection_set_trace
+            i == 14 || // free(unique_container_id)
+            i == 16 || // session_set_incoming_window
+            i == 17 || // session_set_outgoing_window
+            i == 20 || // session_set_incoming_window (additional session)
+            i == 21)   // session_set_outgoing_window (additional session)
+        {
+            continue; // these lines have functions that do not return anything (void) or do not cause failures.
+        }
+        else if (i == 10) // connection_create2
+        {
+            TEST_connection_create2_result = NULL;
+        }
+
+        AMQP_CONNECTION_HANDLE handle = amqp_connection_create(config);
+
+        // assert
+        sprintf(error_msg, "On failed call %lu", (unsigned long)i);
+        ASSERT_IS_NULL(handle, error_msg);
+    }
+
+    // cleanup
+    umock_c_negative_tests_reset();
+    umock_c_negative_tests_deinit();
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_41_005: [amqp_connection_destroy() shall destroy the additional sessions using session_destroy() and free their array]
+TEST_FUNCTION(amqp_connection_destroy_with_session_count_success)
+{
+    // arrange
+    AMQP_CONNECTION_CONFIG* config = get_amqp_connection_config();
+    config->session_count = 3;
+
+    umock_c_reset_all_calls();
+    set_exp_calls_for_amqp_connection_create(config);
+    AMQP_CONNECTION_HANDLE handle = amqp_connection_create(config);
+
+    umock_c_reset_all_calls();
+    set_exp_calls_for_amqp_connection_destroy(config, handle);
+
+    // act
+    amqp_connection_destroy(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_41_006: [If `conn_handle` or `session_handle` are NULL, amqp_connection_get_session_handle_by_key() shall fail and return __FAILURE__]
+TEST_FUNCTION(amqp_connection_get_session_handle_by_key_NULL_handle)
+{
+    // arrange
+    SESSION_HANDLE session_handle;
+
+    // act
+    int result = amqp_connection_get_session_handle_by_key(NULL, 1, &session_handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, result, 0);
+
+    // cleanup
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_41_006: [If `conn_handle` or `session_handle` are NULL, amqp_connection_get_session_handle_by_key() shall fail and return __FAILURE__]
+TEST_FUNCTION(amqp_connection_get_session_handle_by_key_NULL_session_handle)
+{
+    // arrange
+    AMQP_CONNECTION_CONFIG* config = get_amqp_connection_config();
+
+    umock_c_reset_all_calls();
+    set_exp_calls_for_amqp_connection_create(config);
+
+    AMQP_CONNECTION_HANDLE handle = amqp_connection_create(config);
+
+    umock_c_reset_all_calls();
+
+    // act
+    int result = amqp_connection_get_session_handle_by_key(handle, 1, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, result, 0);
+
+    // cleanup
+    amqp_connection_destroy(handle);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_41_007: [`session_handle` shall be set to the session at `key` modulo the number of sessions, where index 0 is `instance->session_handle`]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_41_008: [amqp_connection_get_session_handle_by_key() shall return success code 0]
+TEST_FUNCTION(amqp_connection_get_session_handle_by_key_single_session_success)
+{
+    // arrange
+    AMQP_CONNECTION_CONFIG* config = get_amqp_connection_config();
+
+    umock_c_reset_all_calls();
+    set_exp_calls_for_amqp_connection_create(config);
+
+    AMQP_CONNECTION_HANDLE handle = amqp_connection_create(config);
+
+    umock_c_reset_all_calls();
+
+    SESSION_HANDLE session_handle;
+
+    // act
+    int result = amqp_connection_get_session_handle_by_key(handle, 7, &session_handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, result, 0);
+    ASSERT_ARE_EQUAL(void_ptr, session_handle, TEST_SESSION_HANDLE);
+
+    // cleanup
+    amqp_connection_destroy(handle);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_41_007: [`session_handle` shall be set to the session at `key` modulo the number of sessions, where index 0 is `instance->session_handle`]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_41_008: [amqp_connection_get_session_handle_by_key() shall return success code 0]
+TEST_FUNCTION(amqp_connection_get_session_handle_by_key_multiple_sessions_success)
+{
+    // arrange
+    AMQP_CONNECTION_CONFIG* config = get_amqp_connection_config();
+    config->session_count = 3;
+
+    umock_c_reset_all_calls();
+    set_exp_calls_for_amqp_connection_create(config);
+
+    AMQP_CONNECTION_HANDLE handle = amqp_connection_create(config);
+
+    umock_c_reset_all_calls();
+
+    SESSION_HANDLE session_handle_0;
+    SESSION_HANDLE session_handle_1;
+    SESSION_HANDLE session_handle_2;
+
+    // act
+    int result_0 = amqp_connection_get_session_handle_by_key(handle, 6, &session_handle_0);
+    int result_1 = amqp_connection_get_session_handle_by_key(handle, 7, &session_handle_1);
+    int result_2 = amqp_connection_get_session_handle_by_key(handle, 8, &session_handle_2);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, result_0, 0);
+    ASSERT_ARE_EQUAL(int, result_1, 0);
+    ASSERT_ARE_EQUAL(int, result_2, 0);
+    ASSERT_ARE_EQUAL(void_ptr, session_handle_0, TEST_SESSION_HANDLE);
+    ASSERT_ARE_EQUAL(void_ptr, session_handle_1, TEST_ADDITIONAL_SESSION_HANDLE(0));
+    ASSERT_ARE_EQUAL(void_ptr, session_handle_2, TEST_ADDITIONAL_SESSION_HANDLE(1));
+
+    // cleanup
+    amqp_connection_destroy(handle);
+}
+
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_047: [If `conn_handle` is NULL, amqp_connection_get_cbs_handle() shall fail and return __FAILURE__]
 TEST_FUNCTION(amqp_connection_get_cbs_handle_NULL_handle)
 {
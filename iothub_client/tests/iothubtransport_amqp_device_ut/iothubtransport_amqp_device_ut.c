@@ -797,6 +797,20 @@ static AMQP_DEVICE_HANDLE create_and_start_and_crank_device(DEVICE_CONFIG* confi
     return handle;
 }
 
+static AMQP_DEVICE_HANDLE create_and_start_and_crank_lazy_twin_device(DEVICE_CONFIG* config, time_t current_time, size_t idle_timeout_secs)
+{
+    AMQP_DEVICE_HANDLE handle = create_device(config, current_time);
+    (void)device_set_option(handle, DEVICE_OPTION_TWIN_LINK_IDLE_TIMEOUT_SECS, &idle_timeout_secs);
+    (void)device_start_async(handle, TEST_SESSION_HANDLE, NULL);
+
+    device_do_work(handle);
+    set_messenger_state(TELEMETRY_MESSENGER_STATE_STOPPED, TELEMETRY_MESSENGER_STATE_STARTING, current_time);
+    set_messenger_state(TELEMETRY_MESSENGER_STATE_STARTING, TELEMETRY_MESSENGER_STATE_STARTED, current_time);
+    device_do_work(handle);
+
+    return handle;
+}
+
 
 BEGIN_TEST_SUITE(iothubtransport_amqp_device_ut)
 
@@ -2731,8 +2745,7 @@ TEST_FUNCTION(on_messenger_message_received_callback_NULL_context)
 // Tests_SRS_DEVICE_09_072: [If the user callback returns DEVICE_MESSAGE_DISPOSITION_RESULT_ACCEPTED, on_messenger_message_received_callback shall return TELEMETRY_MESSENGER_DISPOSITION_RESULT_ACCEPTED]
 // Tests_SRS_DEVICE_09_073: [If the user callback returns DEVICE_MESSAGE_DISPOSITION_RESULT_REJECTED, on_messenger_message_received_callback shall return TELEMETRY_MESSENGER_DISPOSITION_RESULT_REJECTED]
 // Tests_SRS_DEVICE_09_074: [If the user callback returns DEVICE_MESSAGE_DISPOSITION_RESULT_RELEASED, on_messenger_message_received_callback shall return TELEMETRY_MESSENGER_DISPOSITION_RESULT_RELEASED]
-// Tests_SRS_DEVICE_09_119: [A DEVICE_MESSAGE_DISPOSITION_INFO instance shall be created containing a copy of `disposition_info->source` and `disposition_info->message_id`]
-// Tests_SRS_DEVICE_09_121: [on_messenger_message_received_callback shall release the memory allocated for DEVICE_MESSAGE_DISPOSITION_INFO]
+// Tests_SRS_DEVICE_41_004: [A DEVICE_MESSAGE_DISPOSITION_INFO instance shall be filled on the stack with `disposition_info->source` and `disposition_info->message_id`, without copying the source]
 TEST_FUNCTION(on_messenger_message_received_callback_succeess)
 {
     // arrange
@@ -2773,10 +2786,6 @@ TEST_FUNCTION(on_messenger_message_received_callback_succeess)
         disposition_info.message_id = TEST_MESSAGE_ID;
 
         umock_c_reset_all_calls();
-        STRICT_EXPECTED_CALL(malloc(sizeof(DEVICE_MESSAGE_DISPOSITION_INFO)));
-        EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-        EXPECTED_CALL(free(IGNORED_PTR_ARG));
-        EXPECTED_CALL(free(IGNORED_PTR_ARG));
 
         TELEMETRY_MESSENGER_DISPOSITION_RESULT result = TEST_telemetry_messenger_subscribe_for_messages_saved_on_message_received_callback(
             TEST_IOTHUB_MESSAGE_HANDLE,
@@ -2792,69 +2801,8 @@ TEST_FUNCTION(on_messenger_message_received_callback_succeess)
     device_destroy(handle);
 }
 
-// Tests_SRS_DEVICE_09_120: [If the DEVICE_MESSAGE_DISPOSITION_INFO instance fails to be created, on_messenger_message_received_callback shall return TELEMETRY_MESSENGER_DISPOSITION_RESULT_RELEASED]
-TEST_FUNCTION(on_messenger_message_received_callback_failure_checks)
-{
-    // arrange
-    ASSERT_ARE_EQUAL(int, 0, umock_c_negative_tests_init());
-
-    DEVICE_CONFIG* config = get_device_config(DEVICE_AUTH_MODE_CBS);
-    AMQP_DEVICE_HANDLE handle = create_and_start_and_crank_device(config, TEST_current_time);
-
-    umock_c_reset_all_calls();
-    TEST_telemetry_messenger_subscribe_for_messages_return = 0;
-    STRICT_EXPECTED_CALL(telemetry_messenger_subscribe_for_messages(TEST_TELEMETRY_MESSENGER_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(2)
-        .IgnoreArgument(3);
-
-    (void)device_subscribe_message(handle, TEST_on_message_received, handle);
-    ASSERT_IS_NOT_NULL(TEST_telemetry_messenger_subscribe_for_messages_saved_on_message_received_callback);
-
-    TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO disposition_info;
-    disposition_info.source = TEST_MESSAGE_SOURCE_NAME_CHAR_PTR;
-    disposition_info.message_id = TEST_MESSAGE_ID;
-
-    umock_c_reset_all_calls();
-    STRICT_EXPECTED_CALL(malloc(sizeof(DEVICE_MESSAGE_DISPOSITION_INFO)));
-    EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-    EXPECTED_CALL(free(IGNORED_PTR_ARG));
-    EXPECTED_CALL(free(IGNORED_PTR_ARG));
-    umock_c_negative_tests_snapshot();
-
-    // act
-    size_t i;
-    for (i = 0; i < umock_c_negative_tests_call_count(); i++)
-    {
-        if (i == 2 || i == 3)
-        {
-            // These expected calls do not cause the API to fail.
-            continue;
-        }
-
-        // arrange
-        char error_msg[64];
-
-        umock_c_negative_tests_reset();
-        umock_c_negative_tests_fail_call(i);
-
-        TELEMETRY_MESSENGER_DISPOSITION_RESULT result = TEST_telemetry_messenger_subscribe_for_messages_saved_on_message_received_callback(
-            TEST_IOTHUB_MESSAGE_HANDLE,
-            &disposition_info,
-            TEST_telemetry_messenger_subscribe_for_messages_saved_context);
-
-        // assert
-        sprintf(error_msg, "On failed call %lu", (unsigned long)i);
-        ASSERT_ARE_EQUAL(int, TELEMETRY_MESSENGER_DISPOSITION_RESULT_RELEASED, result, error_msg);
-    }
-
-    // cleanup
-    device_destroy(handle);
-    umock_c_negative_tests_deinit();
-}
-
-// Tests_SRS_DEVICE_09_113: [A TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO instance shall be created with a copy of the `source` and `message_id` contained in `disposition_info`]
+// Tests_SRS_DEVICE_41_005: [A TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO instance shall be filled on the stack with the `source` and `message_id` contained in `disposition_info`, without copying the source]
 // Tests_SRS_DEVICE_09_115: [`telemetry_messenger_send_message_disposition()` shall be invoked passing the TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO instance and the corresponding TELEMETRY_MESSENGER_DISPOSITION_RESULT]
-// Tests_SRS_DEVICE_09_117: [device_send_message_disposition() shall destroy the TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO instance]
 // Tests_SRS_DEVICE_09_118: [If no failures occurr, device_send_message_disposition() shall return 0]
 TEST_FUNCTION(device_send_message_disposition_succeess)
 {
@@ -2867,12 +2815,8 @@ TEST_FUNCTION(device_send_message_disposition_succeess)
     disposition_info.message_id = TEST_MESSAGE_ID;
 
     umock_c_reset_all_calls();
-    STRICT_EXPECTED_CALL(malloc(sizeof(TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO)));
-    EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(telemetry_messenger_send_message_disposition(TEST_TELEMETRY_MESSENGER_HANDLE, IGNORED_PTR_ARG, TELEMETRY_MESSENGER_DISPOSITION_RESULT_ACCEPTED))
         .IgnoreArgument(2);
-    EXPECTED_CALL(free(IGNORED_PTR_ARG));
-    EXPECTED_CALL(free(IGNORED_PTR_ARG));
 
     // act
     int result = device_send_message_disposition(handle, &disposition_info, DEVICE_MESSAGE_DISPOSITION_RESULT_ACCEPTED);
@@ -2949,7 +2893,6 @@ TEST_FUNCTION(device_send_message_NULL_disposition_info_source)
     device_destroy(handle);
 }
 
-// Tests_SRS_DEVICE_09_114: [If the TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO fails to be created, device_send_message_disposition() shall fail and return __FAILURE__]
 // Tests_SRS_DEVICE_09_116: [If `telemetry_messenger_send_message_disposition()` fails, device_send_message_disposition() shall fail and return __FAILURE__]
 TEST_FUNCTION(device_send_message_disposition_failure_checks)
 {
@@ -2964,23 +2907,14 @@ TEST_FUNCTION(device_send_message_disposition_failure_checks)
     disposition_info.message_id = TEST_MESSAGE_ID;
 
     umock_c_reset_all_calls();
-    STRICT_EXPECTED_CALL(malloc(sizeof(TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO)));
-    EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(telemetry_messenger_send_message_disposition(TEST_TELEMETRY_MESSENGER_HANDLE, IGNORED_PTR_ARG, TELEMETRY_MESSENGER_DISPOSITION_RESULT_ACCEPTED))
         .IgnoreArgument(2);
-    EXPECTED_CALL(free(IGNORED_PTR_ARG));
-    EXPECTED_CALL(free(IGNORED_PTR_ARG));
     umock_c_negative_tests_snapshot();
 
     // act
     size_t i;
     for (i = 0; i < umock_c_negative_tests_call_count(); i++)
     {
-        if (i == 3 || i == 4)
-        {
-            continue;
-        }
-
         // arrange
         char error_msg[64];
 
@@ -3132,4 +3066,117 @@ TEST_FUNCTION(device_get_twin_async_NULL_callback)
     device_destroy(handle);
 }
 
+// Tests_SRS_DEVICE_41_006: [If `name` is DEVICE_OPTION_TWIN_LINK_IDLE_TIMEOUT_SECS, `value` shall be saved on `instance->twin_link_idle_timeout_secs`, and apply from the next device start]
+TEST_FUNCTION(device_set_option_twin_link_idle_timeout_succeeds)
+{
+    // arrange
+    DEVICE_CONFIG* config = get_device_config(DEVICE_AUTH_MODE_X509);
+    AMQP_DEVICE_HANDLE handle = create_device(config, TEST_current_time);
+    size_t value = 30;
+
+    umock_c_reset_all_calls();
+
+    // act
+    int result = device_set_option(handle, DEVICE_OPTION_TWIN_LINK_IDLE_TIMEOUT_SECS, &value);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    // cleanup
+    device_destroy(handle);
+}
+
+// Tests_SRS_DEVICE_41_007: [If DEVICE_OPTION_TWIN_LINK_IDLE_TIMEOUT_SECS is not 0, the twin links shall not be attached while the device starts, but once a twin operation is requested, until the device stops]
+TEST_FUNCTION(device_do_work_lazy_twin_links_do_not_hold_the_device_start)
+{
+    // arrange
+    DEVICE_CONFIG* config = get_device_config(DEVICE_AUTH_MODE_X509);
+    AMQP_DEVICE_HANDLE handle = create_device(config, TEST_current_time);
+    size_t value = 30;
+    (void)device_set_option(handle, DEVICE_OPTION_TWIN_LINK_IDLE_TIMEOUT_SECS, &value);
+    (void)device_start_async(handle, TEST_SESSION_HANDLE, NULL);
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(telemetry_messenger_start(TEST_TELEMETRY_MESSENGER_HANDLE, TEST_SESSION_HANDLE));
+    device_do_work(handle);
+    set_messenger_state(TELEMETRY_MESSENGER_STATE_STOPPED, TELEMETRY_MESSENGER_STATE_STARTING, TEST_current_time);
+    set_messenger_state(TELEMETRY_MESSENGER_STATE_STARTING, TELEMETRY_MESSENGER_STATE_STARTED, TEST_current_time);
+
+    STRICT_EXPECTED_CALL(telemetry_messenger_do_work(TEST_TELEMETRY_MESSENGER_HANDLE));
+
+    // act
+    device_do_work(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, DEVICE_STATE_STARTING, TEST_on_state_changed_callback_saved_previous_state);
+    ASSERT_ARE_EQUAL(int, DEVICE_STATE_STARTED, TEST_on_state_changed_callback_saved_new_state);
+
+    // cleanup
+    device_destroy(handle);
+}
+
+// Tests_SRS_DEVICE_41_008: [If the twin links are lazy, a started device shall attach them when a twin operation is requested, and detach them with twin_messenger_stop once DEVICE_OPTION_TWIN_LINK_IDLE_TIMEOUT_SECS passed without a twin subscription or pending twin operation]
+// Tests_SRS_DEVICE_41_009: [device_send_twin_update_async, device_subscribe_for_twin_updates and device_get_twin_async shall mark the twin links as in use]
+TEST_FUNCTION(device_do_work_lazy_twin_links_attach_on_the_first_twin_operation)
+{
+    // arrange
+    DEVICE_CONFIG* config = get_device_config(DEVICE_AUTH_MODE_X509);
+    AMQP_DEVICE_HANDLE handle = create_and_start_and_crank_lazy_twin_device(config, TEST_current_time, 30);
+    (void)device_get_twin_async(handle, on_device_get_twin_completed_callback, (void*)0x4567);
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(twin_messenger_start(TEST_TWIN_MESSENGER_HANDLE, TEST_SESSION_HANDLE));
+    STRICT_EXPECTED_CALL(telemetry_messenger_do_work(TEST_TELEMETRY_MESSENGER_HANDLE));
+
+    // act
+    device_do_work(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, DEVICE_STATE_STARTED, TEST_on_state_changed_callback_saved_new_state);
+
+    // cleanup
+    free(get_twin_context);
+    device_destroy(handle);
+}
+
+// Tests_SRS_DEVICE_41_008: [If the twin links are lazy, a started device shall attach them when a twin operation is requested, and detach them with twin_messenger_stop once DEVICE_OPTION_TWIN_LINK_IDLE_TIMEOUT_SECS passed without a twin subscription or pending twin operation]
+TEST_FUNCTION(device_do_work_lazy_twin_links_detach_once_idle)
+{
+    // arrange
+    DEVICE_CONFIG* config = get_device_config(DEVICE_AUTH_MODE_X509);
+    time_t t0 = TEST_current_time;
+    time_t t1 = add_seconds(t0, 31);
+    TWIN_MESSENGER_SEND_STATUS send_status = TWIN_MESSENGER_SEND_STATUS_IDLE;
+    AMQP_DEVICE_HANDLE handle = create_and_start_and_crank_lazy_twin_device(config, t0, 30);
+
+    STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(t0);
+    (void)device_get_twin_async(handle, on_device_get_twin_completed_callback, (void*)0x4567);
+    device_do_work(handle);
+    set_twin_messenger_state(TWIN_MESSENGER_STATE_STOPPED, TWIN_MESSENGER_STATE_STARTING, t0);
+    set_twin_messenger_state(TWIN_MESSENGER_STATE_STARTING, TWIN_MESSENGER_STATE_STARTED, t0);
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(twin_messenger_get_send_status(TEST_TWIN_MESSENGER_HANDLE, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer_send_status(&send_status, sizeof(send_status))
+        .SetReturn(0);
+    set_expected_calls_for_is_timeout_reached(t1);
+    STRICT_EXPECTED_CALL(twin_messenger_stop(TEST_TWIN_MESSENGER_HANDLE));
+    STRICT_EXPECTED_CALL(telemetry_messenger_do_work(TEST_TELEMETRY_MESSENGER_HANDLE));
+    STRICT_EXPECTED_CALL(twin_messenger_do_work(TEST_TWIN_MESSENGER_HANDLE));
+
+    // act
+    device_do_work(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, DEVICE_STATE_STARTED, TEST_on_state_changed_callback_saved_new_state);
+
+    // cleanup
+    free(get_twin_context);
+    device_destroy(handle);
+}
+
 END_TEST_SUITE(iothubtransport_amqp_device_ut)
@@ -37,6 +37,7 @@ static void my_gballoc_free(void* ptr)
 #define ENABLE_MOCKS
 #include "azure_c_shared_utility/threadapi.h"
 #include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/vector.h"
 #include "azure_c_shared_utility/crt_abstractions.h"
@@ -136,6 +137,7 @@ static void* threadFuncArg = NULL;
 static size_t g_num_of_calls = 0;
 static size_t g_how_many_dowork_calls = 0;
 static TRANSPORT_HANDLE g_transport_handle = NULL;
+static bool g_end_both_clients = false;
 
 static const TRANSPORT_PROVIDER* provideFAKE(void);
 
@@ -210,9 +212,10 @@ static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
 }
 
 static size_t clientDoWork_calls = 0;
+static void* clientDoWork_last_handle = NULL;
 static void clientDoWork(void* clientHandle)
 {
-    (void)clientHandle;
+    clientDoWork_last_handle = clientHandle;
     clientDoWork_calls++;
 }
 
@@ -227,6 +230,16 @@ static LOCK_RESULT my_Lock_Deinit(LOCK_HANDLE handle)
     return LOCK_OK;
 }
 
+static COND_HANDLE my_Condition_Init(void)
+{
+    return (COND_HANDLE)my_gballoc_malloc(1);
+}
+
+static void my_Condition_Deinit(COND_HANDLE handle)
+{
+    my_gballoc_free(handle);
+}
+
 static VECTOR_HANDLE my_VECTOR_create(size_t elementSize)
 {
     (void)elementSize;
@@ -265,6 +278,10 @@ static void my_FAKE_IoTHubTransport_DoWork(TRANSPORT_LL_HANDLE handle)
     if ((g_transport_handle != NULL) && (g_num_of_calls >= g_how_many_dowork_calls))
     {
         (void)IoTHubTransport_SignalEndWorkerThread(g_transport_handle, TEST_IOTHUB_CLIENT_CORE_HANDLE1);
+        if (g_end_both_clients)
+        {
+            (void)IoTHubTransport_SignalEndWorkerThread(g_transport_handle, TEST_IOTHUB_CLIENT_CORE_HANDLE2);
+        }
     }
     g_num_of_calls++;
 }
@@ -284,12 +301,14 @@ TEST_SUITE_INITIALIZE(suite_init)
 
     REGISTER_UMOCK_ALIAS_TYPE(TRANSPORT_LL_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(COND_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(VECTOR_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(THREAD_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(THREAD_START_FUNC, void*);
     REGISTER_UMOCK_ALIAS_TYPE(PREDICATE_FUNCTION, void*);
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_CORE_LL_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(COND_RESULT, int);
 
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
@@ -308,6 +327,12 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock, LOCK_ERROR);
 
+    REGISTER_GLOBAL_MOCK_HOOK(Condition_Init, my_Condition_Init);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Condition_Init, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(Condition_Deinit, my_Condition_Deinit);
+    REGISTER_GLOBAL_MOCK_RETURN(Condition_Post, COND_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(Condition_Wait, COND_TIMEOUT);
+
     REGISTER_GLOBAL_MOCK_HOOK(VECTOR_create, real_VECTOR_create);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(VECTOR_create, NULL);
     REGISTER_GLOBAL_MOCK_HOOK(VECTOR_move, real_VECTOR_move);
@@ -346,12 +371,13 @@ TEST_FUNCTION_INITIALIZE(method_init)
     umock_c_reset_all_calls();
 
     clientDoWork_calls = 0;
+    clientDoWork_last_handle = NULL;
     threadFunc = NULL;
     threadFuncArg = NULL;
     g_num_of_calls = 0;
     g_how_many_dowork_calls = 0;
     g_transport_handle = NULL;
-
+    g_end_both_clients = false;
 }
 
 TEST_FUNCTION_CLEANUP(method_cleanup)
@@ -381,6 +407,18 @@ static void setup_IoTHubTransport_Create(void)
     STRICT_EXPECTED_CALL(Lock_Init());
     STRICT_EXPECTED_CALL(Lock_Init());
     STRICT_EXPECTED_CALL(VECTOR_create(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(VECTOR_create(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(VECTOR_create(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(Condition_Init());
+}
+
+static void setup_destroy_work_queue(void)
+{
+    STRICT_EXPECTED_CALL(Condition_Deinit(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(VECTOR_destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(VECTOR_destroy(IGNORED_PTR_ARG));
 }
 
 TEST_FUNCTION(IoTHubTransport_Create_provider_NULL_fail)
@@ -451,6 +489,8 @@ TEST_FUNCTION(IoTHubTransport_Create_success)
 
 //Tests_SRS_IOTHUBTRANSPORT_17_009: [ IoTHubTransport_Create shall clean up any resources it creates if the function does not succeed. ]
 //Tests_SRS_IOTHUBTRANSPORT_17_039: [ If the Vector creation fails, IoTHubTransport_Create shall return NULL. ]
+//Tests_SRS_IOTHUBTRANSPORT_41_001: [ IoTHubTransport_Create shall create the list of clients with pending work, the lock guarding it and the condition the worker thread waits on. ]
+//Tests_SRS_IOTHUBTRANSPORT_41_002: [ If creating the work list, its lock or the condition fails, IoTHubTransport_Create shall release all resources it created and return NULL. ]
 TEST_FUNCTION(IoTHubTransport_Create_fails)
 {
     int negativeTestsInitResult = umock_c_negative_tests_init();
@@ -504,10 +544,12 @@ TEST_FUNCTION(IoTHubTransport_Destroy_success)
     //arrange
     STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Condition_Post(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Destroy(TEST_TRANSPORT_LL_HANDLE));
     STRICT_EXPECTED_CALL(VECTOR_destroy(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG));
+    setup_destroy_work_queue();
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
 
     //act
@@ -529,11 +571,13 @@ TEST_FUNCTION(IoTHubTransport_Destroy_worker_thread_success)
     //arrange
     STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Condition_Post(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Destroy(TEST_TRANSPORT_LL_HANDLE));
     STRICT_EXPECTED_CALL(VECTOR_destroy(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG));
+    setup_destroy_work_queue();
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
 
     //act
@@ -554,11 +598,13 @@ TEST_FUNCTION(IoTHubTransport_Destroy_fails)
 
     //arrange
     STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).SetReturn(LOCK_ERROR);
+    STRICT_EXPECTED_CALL(Condition_Post(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Destroy(TEST_TRANSPORT_LL_HANDLE));
     STRICT_EXPECTED_CALL(VECTOR_destroy(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG));
+    setup_destroy_work_queue();
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
 
     //act
@@ -715,9 +761,13 @@ TEST_FUNCTION(IoTHubTransport_SignalEndWorkerThread_success)
     STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(VECTOR_erase(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, TEST_IOTHUB_CLIENT_CORE_HANDLE1));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Condition_Post(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
 
     //act
@@ -743,6 +793,9 @@ TEST_FUNCTION(IoTHubTransport_SignalEndWorkerThread_2_clients_success)
     STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, TEST_IOTHUB_CLIENT_CORE_HANDLE1));
     STRICT_EXPECTED_CALL(VECTOR_erase(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1));
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, TEST_IOTHUB_CLIENT_CORE_HANDLE1));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
 
@@ -790,6 +843,7 @@ TEST_FUNCTION(IoTHubTransport_GetLock_success)
     IoTHubTransport_Destroy(handle);
 }
 
+//Tests_SRS_IOTHUBTRANSPORT_41_004: [ Between ticks the worker thread shall wait on the condition for at most 1 ms, and not at all if a client signaled work or the thread was told to end. ]
 TEST_FUNCTION(IoTHubTransport_worker_thread_runs_every_1_ms)
 {
     //arrange
@@ -811,20 +865,28 @@ TEST_FUNCTION(IoTHubTransport_worker_thread_runs_every_1_ms)
             STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
             STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
             STRICT_EXPECTED_CALL(VECTOR_erase(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1));
+            STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+            STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+            STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
             STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG));
             STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
             STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+            STRICT_EXPECTED_CALL(Condition_Post(IGNORED_PTR_ARG));
             STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
         }
         STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
         STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
         STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG));
         if (index != g_how_many_dowork_calls)
         {
-            STRICT_EXPECTED_CALL(VECTOR_element(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+            STRICT_EXPECTED_CALL(Condition_Wait(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1));
         }
         STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
-        STRICT_EXPECTED_CALL(ThreadAPI_Sleep(1));
     }
     STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
@@ -834,8 +896,8 @@ TEST_FUNCTION(IoTHubTransport_worker_thread_runs_every_1_ms)
     threadFunc(threadFuncArg);
 
     //assert
-    //ASSERT_IS_FALSE(result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 0, clientDoWork_calls);
 
     //cleanup
     (void)IoTHubTransport_SignalEndWorkerThread(handle, TEST_IOTHUB_CLIENT_CORE_HANDLE1);
@@ -843,6 +905,140 @@ TEST_FUNCTION(IoTHubTransport_worker_thread_runs_every_1_ms)
     IoTHubTransport_Destroy(handle);
 }
 
+//Tests_SRS_IOTHUBTRANSPORT_41_003: [ Each tick the worker thread shall call the client DoWork only for the clients that signaled work since the previous tick, once per client. ]
+TEST_FUNCTION(IoTHubTransport_worker_thread_calls_only_signaled_clients)
+{
+    //arrange
+    TRANSPORT_HANDLE handle = NULL;
+    handle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
+    (void)IoTHubTransport_StartWorkerThread(handle, TEST_IOTHUB_CLIENT_CORE_HANDLE1, clientDoWork);
+    (void)IoTHubTransport_StartWorkerThread(handle, TEST_IOTHUB_CLIENT_CORE_HANDLE2, clientDoWork);
+    IoTHubTransport_SignalClientWork(handle, TEST_IOTHUB_CLIENT_CORE_HANDLE2);
+    IoTHubTransport_SignalClientWork(handle, TEST_IOTHUB_CLIENT_CORE_HANDLE2);
+    g_transport_handle = handle;
+    g_end_both_clients = true;
+    g_how_many_dowork_calls = 1;
+    umock_c_reset_all_calls();
+
+    //act
+    threadFunc(threadFuncArg);
+
+    //assert
+    ASSERT_ARE_EQUAL(size_t, 1, clientDoWork_calls);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_IOTHUB_CLIENT_CORE_HANDLE2, clientDoWork_last_handle);
+
+    //cleanup
+    IoTHubTransport_Destroy(handle);
+}
+
+//Tests_SRS_IOTHUBTRANSPORT_41_005: [ IoTHubTransport_EndWorkerThread shall also remove clientHandle from the clients with pending work. ]
+TEST_FUNCTION(IoTHubTransport_SignalEndWorkerThread_removes_pending_work)
+{
+    //arrange
+    TRANSPORT_HANDLE handle = NULL;
+    handle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
+    (void)IoTHubTransport_StartWorkerThread(handle, TEST_IOTHUB_CLIENT_CORE_HANDLE1, clientDoWork);
+    (void)IoTHubTransport_StartWorkerThread(handle, TEST_IOTHUB_CLIENT_CORE_HANDLE2, clientDoWork);
+    IoTHubTransport_SignalClientWork(handle, TEST_IOTHUB_CLIENT_CORE_HANDLE2);
+    g_transport_handle = handle;
+    g_end_both_clients = true;
+    g_how_many_dowork_calls = 0;
+    umock_c_reset_all_calls();
+
+    //act
+    threadFunc(threadFuncArg);
+
+    //assert
+    ASSERT_ARE_EQUAL(size_t, 0, clientDoWork_calls);
+
+    //cleanup
+    IoTHubTransport_Destroy(handle);
+}
+
+//Tests_SRS_IOTHUBTRANSPORT_41_006: [ If transportHandle or clientHandle is NULL, IoTHubTransport_SignalClientWork shall do nothing. ]
+TEST_FUNCTION(IoTHubTransport_SignalClientWork_handle_NULL_fail)
+{
+    //arrange
+
+    //act
+    IoTHubTransport_SignalClientWork(NULL, TEST_IOTHUB_CLIENT_CORE_HANDLE1);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+}
+
+//Tests_SRS_IOTHUBTRANSPORT_41_006: [ If transportHandle or clientHandle is NULL, IoTHubTransport_SignalClientWork shall do nothing. ]
+TEST_FUNCTION(IoTHubTransport_SignalClientWork_client_NULL_fail)
+{
+    //arrange
+    TRANSPORT_HANDLE handle = NULL;
+    handle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
+    umock_c_reset_all_calls();
+
+    //act
+    IoTHubTransport_SignalClientWork(handle, NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransport_Destroy(handle);
+}
+
+//Tests_SRS_IOTHUBTRANSPORT_41_007: [ IoTHubTransport_SignalClientWork shall add clientHandle to the clients with pending work, unless it is already there, and wake the worker thread. ]
+TEST_FUNCTION(IoTHubTransport_SignalClientWork_success)
+{
+    //arrange
+    TRANSPORT_HANDLE handle = NULL;
+    handle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
+    (void)IoTHubTransport_StartWorkerThread(handle, TEST_IOTHUB_CLIENT_CORE_HANDLE1, clientDoWork);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, TEST_IOTHUB_CLIENT_CORE_HANDLE1));
+    STRICT_EXPECTED_CALL(VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1));
+    STRICT_EXPECTED_CALL(Condition_Post(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    //act
+    IoTHubTransport_SignalClientWork(handle, TEST_IOTHUB_CLIENT_CORE_HANDLE1);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    (void)IoTHubTransport_SignalEndWorkerThread(handle, TEST_IOTHUB_CLIENT_CORE_HANDLE1);
+    IoTHubTransport_Destroy(handle);
+}
+
+//Tests_SRS_IOTHUBTRANSPORT_41_007: [ IoTHubTransport_SignalClientWork shall add clientHandle to the clients with pending work, unless it is already there, and wake the worker thread. ]
+TEST_FUNCTION(IoTHubTransport_SignalClientWork_twice_adds_once)
+{
+    //arrange
+    TRANSPORT_HANDLE handle = NULL;
+    handle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
+    (void)IoTHubTransport_StartWorkerThread(handle, TEST_IOTHUB_CLIENT_CORE_HANDLE1, clientDoWork);
+    IoTHubTransport_SignalClientWork(handle, TEST_IOTHUB_CLIENT_CORE_HANDLE1);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, TEST_IOTHUB_CLIENT_CORE_HANDLE1));
+    STRICT_EXPECTED_CALL(Condition_Post(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+    //act
+    IoTHubTransport_SignalClientWork(handle, TEST_IOTHUB_CLIENT_CORE_HANDLE1);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    (void)IoTHubTransport_SignalEndWorkerThread(handle, TEST_IOTHUB_CLIENT_CORE_HANDLE1);
+    IoTHubTransport_Destroy(handle);
+}
+
 TEST_FUNCTION(IoTHubTransport_JoinWorkerThread_handle_NULL_fail)
 {
     //arrange
@@ -41,6 +41,7 @@ static void real_free(void* ptr)
 #include "azure_c_shared_utility/http_proxy_io.h"
 #include "internal/iothubtransport_amqp_common.h"
 #include "internal/iothub_transport_ll_private.h"
+#include "internal/iothub_client_coalescing_io.h"
 
 MOCKABLE_FUNCTION(, bool, Transport_MessageCallbackFromInput, MESSAGE_CALLBACK_INFO*, messageData, void*, ctx);
 MOCKABLE_FUNCTION(, bool, Transport_MessageCallback, MESSAGE_CALLBACK_INFO*, messageData, void*, ctx);
@@ -70,6 +71,7 @@ static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
 #define TEST_IOTHUBTRANSPORT_CONFIG_HANDLE  ((IOTHUBTRANSPORT_CONFIG*)0x4240)
 #define TEST_XIO_INTERFACE                  ((const IO_INTERFACE_DESCRIPTION*)0x4247)
 #define TEST_XIO_HANDLE                     ((XIO_HANDLE)0x4248)
+#define TEST_WSIO_HANDLE                    ((XIO_HANDLE)0x4251)
 #define TEST_TRANSPORT_LL_HANDLE            ((TRANSPORT_LL_HANDLE)0x4249)
 #define TEST_STRING_HANDLE                  ((STRING_HANDLE)0x4250)
 #define TEST_STRING                         "SOME TEXT"
@@ -82,6 +84,7 @@ static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
 static IO_INTERFACE_DESCRIPTION* TEST_WSIO_INTERFACE_DESCRIPTION = (IO_INTERFACE_DESCRIPTION*)0x1182;
 static IO_INTERFACE_DESCRIPTION* TEST_TLSIO_INTERFACE_DESCRIPTION = (IO_INTERFACE_DESCRIPTION*)0x1183;
 static IO_INTERFACE_DESCRIPTION* TEST_HTTP_PROXY_IO_INTERFACE_DESCRIPTION = (IO_INTERFACE_DESCRIPTION*)0x1185;
+static IO_INTERFACE_DESCRIPTION* TEST_COALESCING_IO_INTERFACE_DESCRIPTION = (IO_INTERFACE_DESCRIPTION*)0x1186;
 
 static const IOTHUBTRANSPORT_CONFIG* saved_IoTHubTransport_AMQP_Common_Create_config;
 static AMQP_GET_IO_TRANSPORT saved_IoTHubTransport_AMQP_Common_Create_get_io_transport;
@@ -610,6 +613,7 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_GLOBAL_MOCK_RETURN(wsio_get_interface_description, TEST_WSIO_INTERFACE_DESCRIPTION);
     REGISTER_GLOBAL_MOCK_RETURN(platform_get_default_tlsio, TEST_TLSIO_INTERFACE_DESCRIPTION);
     REGISTER_GLOBAL_MOCK_RETURN(http_proxy_io_get_interface_description, TEST_HTTP_PROXY_IO_INTERFACE_DESCRIPTION);
+    REGISTER_GLOBAL_MOCK_RETURN(coalescing_io_get_interface_description, TEST_COALESCING_IO_INTERFACE_DESCRIPTION);
 }
 
 TEST_SUITE_CLEANUP(TestClassCleanup)
@@ -719,6 +723,8 @@ TEST_FUNCTION(AMQP_Create_getWebSocketsIOTransport_with_NULL_proxy_options_sets_
     STRICT_EXPECTED_CALL(platform_get_default_tlsio());
     STRICT_EXPECTED_CALL(xio_create(TEST_WSIO_INTERFACE_DESCRIPTION, &wsio_config))
         .ValidateArgumentValue_io_create_parameters_AsType(UMOCK_TYPE(WSIO_CONFIG*));
+    STRICT_EXPECTED_CALL(coalescing_io_get_interface_description());
+    STRICT_EXPECTED_CALL(xio_create(TEST_COALESCING_IO_INTERFACE_DESCRIPTION, IGNORED_PTR_ARG));
 
     // act
     underlying_io_transport = saved_IoTHubTransport_AMQP_Common_Create_get_io_transport(TEST_STRING, NULL);
@@ -728,6 +734,61 @@ TEST_FUNCTION(AMQP_Create_getWebSocketsIOTransport_with_NULL_proxy_options_sets_
     ASSERT_ARE_EQUAL(void_ptr, underlying_io_transport, TEST_XIO_HANDLE);
 }
 
+/* Tests_SRS_IOTHUBTRANSPORTAMQP_WS_41_001: [ `getIoTransportProvider` shall put the WebSocket IO under a coalescing IO, created with `xio_create`, the interface returned by `coalescing_io_get_interface_description` and a `COALESCING_IO_CONFIG` whose `underlying_io` is the WebSocket IO, and return the coalescing IO. ]*/
+TEST_FUNCTION(AMQP_Create_getWebSocketsIOTransport_returns_the_coalescing_IO)
+{
+    // arrange
+    TRANSPORT_PROVIDER* provider = (TRANSPORT_PROVIDER*)AMQP_Protocol_over_WebSocketsTls();
+    COALESCING_IO_CONFIG coalescing_io_config;
+    XIO_HANDLE underlying_io_transport;
+
+    (void)provider->IoTHubTransport_Create(TEST_IOTHUBTRANSPORT_CONFIG_HANDLE, g_transport_cb_info, g_transport_cb_ctx);
+    umock_c_reset_all_calls();
+
+    coalescing_io_config.underlying_io = TEST_WSIO_HANDLE;
+
+    STRICT_EXPECTED_CALL(wsio_get_interface_description());
+    STRICT_EXPECTED_CALL(platform_get_default_tlsio());
+    STRICT_EXPECTED_CALL(xio_create(TEST_WSIO_INTERFACE_DESCRIPTION, IGNORED_PTR_ARG))
+        .SetReturn(TEST_WSIO_HANDLE);
+    STRICT_EXPECTED_CALL(coalescing_io_get_interface_description());
+    STRICT_EXPECTED_CALL(xio_create(TEST_COALESCING_IO_INTERFACE_DESCRIPTION, &coalescing_io_config))
+        .ValidateArgumentBuffer(2, &coalescing_io_config, sizeof(coalescing_io_config));
+
+    // act
+    underlying_io_transport = saved_IoTHubTransport_AMQP_Common_Create_get_io_transport(TEST_STRING, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(void_ptr, underlying_io_transport, TEST_XIO_HANDLE);
+}
+
+/* Tests_SRS_IOTHUBTRANSPORTAMQP_WS_41_002: [ If the coalescing IO cannot be created, `getIoTransportProvider` shall return the WebSocket IO. ]*/
+TEST_FUNCTION(when_the_coalescing_IO_cannot_be_created_AMQP_Create_getWebSocketsIOTransport_returns_the_WebSocket_IO)
+{
+    // arrange
+    TRANSPORT_PROVIDER* provider = (TRANSPORT_PROVIDER*)AMQP_Protocol_over_WebSocketsTls();
+    XIO_HANDLE underlying_io_transport;
+
+    (void)provider->IoTHubTransport_Create(TEST_IOTHUBTRANSPORT_CONFIG_HANDLE, g_transport_cb_info, g_transport_cb_ctx);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(wsio_get_interface_description());
+    STRICT_EXPECTED_CALL(platform_get_default_tlsio());
+    STRICT_EXPECTED_CALL(xio_create(TEST_WSIO_INTERFACE_DESCRIPTION, IGNORED_PTR_ARG))
+        .SetReturn(TEST_WSIO_HANDLE);
+    STRICT_EXPECTED_CALL(coalescing_io_get_interface_description());
+    STRICT_EXPECTED_CALL(xio_create(TEST_COALESCING_IO_INTERFACE_DESCRIPTION, IGNORED_PTR_ARG))
+        .SetReturn(NULL);
+
+    // act
+    underlying_io_transport = saved_IoTHubTransport_AMQP_Common_Create_get_io_transport(TEST_STRING, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(void_ptr, underlying_io_transport, TEST_WSIO_HANDLE);
+}
+
 /* Tests_SRS_IOTHUBTRANSPORTAMQP_WS_09_003: [If `io_interface_description` is NULL getWebSocketsIOTransport shall return NULL.] */
 TEST_FUNCTION(when_wsio_get_interface_description_returns_NULL_AMQP_Create_getWebSocketsIOTransport_returns_NULL)
 {
@@ -772,6 +833,8 @@ TEST_FUNCTION(when_TLSIIO_interface_is_NULL_AMQP_Create_getWebSocketsIOTransport
         .SetReturn(NULL);
     STRICT_EXPECTED_CALL(xio_create(TEST_WSIO_INTERFACE_DESCRIPTION, &wsio_config))
         .ValidateArgumentValue_io_create_parameters_AsType(UMOCK_TYPE(WSIO_CONFIG*));
+    STRICT_EXPECTED_CALL(coalescing_io_get_interface_description());
+    STRICT_EXPECTED_CALL(xio_create(TEST_COALESCING_IO_INTERFACE_DESCRIPTION, IGNORED_PTR_ARG));
 
     // act
     underlying_io_transport = saved_IoTHubTransport_AMQP_Common_Create_get_io_transport(TEST_STRING, NULL);
@@ -830,6 +893,8 @@ TEST_FUNCTION(AMQP_Create_getWebSocketsIOTransport_with_proxy_options_sets_up_ws
     STRICT_EXPECTED_CALL(http_proxy_io_get_interface_description());
     STRICT_EXPECTED_CALL(xio_create(TEST_WSIO_INTERFACE_DESCRIPTION, &wsio_config))
         .ValidateArgumentValue_io_create_parameters_AsType(UMOCK_TYPE(WSIO_CONFIG*));
+    STRICT_EXPECTED_CALL(coalescing_io_get_interface_description());
+    STRICT_EXPECTED_CALL(xio_create(TEST_COALESCING_IO_INTERFACE_DESCRIPTION, IGNORED_PTR_ARG));
 
     // act
     underlying_io_transport = saved_IoTHubTransport_AMQP_Common_Create_get_io_transport(TEST_STRING, &amqp_proxy_options);
@@ -875,6 +940,8 @@ TEST_FUNCTION(when_http_proxy_io_get_interface_description_returns_NULL_AMQP_Cre
         .SetReturn(NULL);
     STRICT_EXPECTED_CALL(xio_create(TEST_WSIO_INTERFACE_DESCRIPTION, &wsio_config))
         .ValidateArgumentValue_io_create_parameters_AsType(UMOCK_TYPE(WSIO_CONFIG*));
+    STRICT_EXPECTED_CALL(coalescing_io_get_interface_description());
+    STRICT_EXPECTED_CALL(xio_create(TEST_COALESCING_IO_INTERFACE_DESCRIPTION, IGNORED_PTR_ARG));
 
     // act
     underlying_io_transport = saved_IoTHubTransport_AMQP_Common_Create_get_io_transport(TEST_STRING, &amqp_proxy_options);
@@ -0,0 +1,777 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#endif
+
+#if defined _MSC_VER
+#pragma warning(disable: 4054) /* MSC incorrectly fires this */
+#endif
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void* my_gballoc_realloc(void* ptr, size_t size)
+{
+    return realloc(ptr, size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umock_c_negative_tests.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_bool.h"
+#include "umocktypes_stdint.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/doublylinkedlist.h"
+#include "azure_c_shared_utility/tickcounter.h"
+#include "iothub_message.h"
+#include "internal/iothub_client_private.h"
+#include "internal/iothub_transport_ll_private.h"
+#undef ENABLE_MOCKS
+
+#include "azure_c_shared_utility/strings.h"
+#include "internal/iothubtransport.h"
+#include "iothubtransportloopback.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+    void real_DList_InitializeListHead(PDLIST_ENTRY listHead);
+    int real_DList_IsListEmpty(const PDLIST_ENTRY listHead);
+    void real_DList_InsertTailList(PDLIST_ENTRY listHead, PDLIST_ENTRY listEntry);
+    void real_DList_InsertHeadList(PDLIST_ENTRY listHead, PDLIST_ENTRY listEntry);
+    void real_DList_AppendTailList(PDLIST_ENTRY listHead, PDLIST_ENTRY ListToAppend);
+    int real_DList_RemoveEntryList(PDLIST_ENTRY listEntry);
+    PDLIST_ENTRY real_DList_RemoveHeadList(PDLIST_ENTRY listHead);
+
+    STRING_HANDLE STRING_construct_sprintf(const char* format, ...)
+    {
+        (void)format;
+        return (STRING_HANDLE)my_gballoc_malloc(1);
+    }
+
+    void STRING_delete(STRING_HANDLE handle)
+    {
+        my_gballoc_free(handle);
+    }
+
+    STRING_HANDLE STRING_clone(STRING_HANDLE handle)
+    {
+        (void)handle;
+        return (STRING_HANDLE)my_gballoc_malloc(1);
+    }
+#ifdef __cplusplus
+}
+#endif
+
+#define TEST_EVENT_COUNT    3
+
+static const char* TEST_DEVICE_ID = "thisIsDeviceID";
+static const char* TEST_IOTHUB_NAME = "thisIsIotHubName";
+static const char* TEST_IOTHUB_SUFFIX = "thisIsIotHubSuffix";
+static const char* TEST_UNKNOWN_OPTION = "TrustedCerts";
+static TICK_COUNTER_HANDLE TEST_TICK_COUNTER_HANDLE = (TICK_COUNTER_HANDLE)0x4301;
+static IOTHUB_MESSAGE_HANDLE TEST_MESSAGE_HANDLE = (IOTHUB_MESSAGE_HANDLE)0x4302;
+static void* TEST_TRANSPORT_CONTEXT = (void*)0x4303;
+
+static TEST_MUTEX_HANDLE test_serialize_mutex;
+
+static const TRANSPORT_PROVIDER* g_provider;
+static IOTHUB_CLIENT_CONFIG g_client_config;
+static IOTHUBTRANSPORT_CONFIG g_transport_config;
+static TRANSPORT_CALLBACKS_INFO g_transport_cb;
+static IOTHUB_DEVICE_CONFIG g_device_config;
+static DLIST_ENTRY g_waitingToSend;
+static IOTHUB_MESSAGE_LIST g_events[TEST_EVENT_COUNT];
+static tickcounter_ms_t g_current_ms;
+
+static size_t g_connected_count;
+static size_t g_events_completed;
+static IOTHUB_CLIENT_CONFIRMATION_RESULT g_events_result;
+static size_t g_messages_received;
+static bool g_message_accepted;
+static MESSAGE_CALLBACK_INFO* g_last_message_data;
+static size_t g_reported_count;
+static uint32_t g_reported_item_id;
+static int g_reported_status;
+static size_t g_twin_complete_count;
+static size_t g_twin_partial_count;
+static size_t g_methods_received;
+static METHOD_HANDLE g_last_method_id;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+TEST_DEFINE_ENUM_TYPE(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_RESULT_VALUES);
+IMPLEMENT_UMOCK_C_ENUM_TYPE(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_RESULT_VALUES);
+TEST_DEFINE_ENUM_TYPE(IOTHUB_CLIENT_CONFIRMATION_RESULT, IOTHUB_CLIENT_CONFIRMATION_RESULT_VALUES);
+TEST_DEFINE_ENUM_TYPE(IOTHUB_PROCESS_ITEM_RESULT, IOTHUB_PROCESS_ITEM_RESULT_VALUE);
+
+static int my_tickcounter_get_current_ms(TICK_COUNTER_HANDLE tick_counter, tickcounter_ms_t* current_ms)
+{
+    (void)tick_counter;
+    *current_ms = g_current_ms;
+    return 0;
+}
+
+static bool on_msg_input(MESSAGE_CALLBACK_INFO* messageData, void* ctx)
+{
+    (void)messageData;
+    (void)ctx;
+    return false;
+}
+
+static bool on_msg(MESSAGE_CALLBACK_INFO* messageData, void* ctx)
+{
+    (void)ctx;
+    g_messages_received++;
+    if (g_message_accepted)
+    {
+        // Disposed right away, the way the client does for a callback that returns IOTHUBMESSAGE_ACCEPTED
+        (void)g_provider->IoTHubTransport_SendMessageDisposition(messageData, IOTHUBMESSAGE_ACCEPTED);
+    }
+    else
+    {
+        g_last_message_data = messageData;
+    }
+    return true;
+}
+
+static void on_connection_status(IOTHUB_CLIENT_CONNECTION_STATUS status, IOTHUB_CLIENT_CONNECTION_STATUS_REASON reason, void* ctx)
+{
+    (void)ctx;
+    if (status == IOTHUB_CLIENT_CONNECTION_AUTHENTICATED && reason == IOTHUB_CLIENT_CONNECTION_OK)
+    {
+        g_connected_count++;
+    }
+}
+
+static void on_send_complete(PDLIST_ENTRY completed, IOTHUB_CLIENT_CONFIRMATION_RESULT result, void* ctx)
+{
+    PDLIST_ENTRY entry;
+    (void)ctx;
+
+    g_events_result = result;
+    while ((entry = real_DList_RemoveHeadList(completed)) != completed)
+    {
+        g_events_completed++;
+    }
+}
+
+static const char* on_product_info(void* ctx)
+{
+    (void)ctx;
+    return "loopback_ut";
+}
+
+static void on_reported_state_complete(uint32_t item_id, int status_code, void* ctx)
+{
+    (void)ctx;
+    g_reported_count++;
+    g_reported_item_id = item_id;
+    g_reported_status = status_code;
+}
+
+static void on_twin_retrieved(DEVICE_TWIN_UPDATE_STATE update_state, const unsigned char* payLoad, size_t size, void* ctx)
+{
+    (void)payLoad;
+    (void)size;
+    (void)ctx;
+    if (update_state == DEVICE_TWIN_UPDATE_COMPLETE)
+    {
+        g_twin_complete_count++;
+    }
+    else
+    {
+        g_twin_partial_count++;
+    }
+}
+
+static int on_method(const char* method_name, const unsigned char* payLoad, size_t size, METHOD_HANDLE response_id, void* ctx)
+{
+    (void)method_name;
+    (void)payLoad;
+    (void)size;
+    (void)ctx;
+    g_methods_received++;
+    g_last_method_id = response_id;
+    return 0;
+}
+
+static void reset_test_data(void)
+{
+    size_t index;
+
+    (void)memset(&g_client_config, 0, sizeof(g_client_config));
+    g_client_config.protocol = Loopback_Protocol;
+    g_client_config.deviceId = TEST_DEVICE_ID;
+    g_client_config.iotHubName = TEST_IOTHUB_NAME;
+    g_client_config.iotHubSuffix = TEST_IOTHUB_SUFFIX;
+
+    real_DList_InitializeListHead(&g_waitingToSend);
+    (void)memset(&g_transport_config, 0, sizeof(g_transport_config));
+    g_transport_config.upperConfig = &g_client_config;
+    g_transport_config.waitingToSend = &g_waitingToSend;
+
+    (void)memset(&g_device_config, 0, sizeof(g_device_config));
+    g_device_config.deviceId = TEST_DEVICE_ID;
+
+    (void)memset(&g_transport_cb, 0, sizeof(g_transport_cb));
+    g_transport_cb.msg_input_cb = on_msg_input;
+    g_transport_cb.msg_cb = on_msg;
+    g_transport_cb.connection_status_cb = on_connection_status;
+    g_transport_cb.send_complete_cb = on_send_complete;
+    g_transport_cb.prod_info_cb = on_product_info;
+    g_transport_cb.twin_rpt_state_complete_cb = on_reported_state_complete;
+    g_transport_cb.twin_retrieve_prop_complete_cb = on_twin_retrieved;
+    g_transport_cb.method_complete_cb = on_method;
+
+    (void)memset(g_events, 0, sizeof(g_events));
+    for (index = 0; index < TEST_EVENT_COUNT; index++)
+    {
+        g_events[index].messageHandle = TEST_MESSAGE_HANDLE;
+    }
+
+    g_current_ms = 1000;
+    g_connected_count = 0;
+    g_events_completed = 0;
+    g_events_result = IOTHUB_CLIENT_CONFIRMATION_ERROR;
+    g_messages_received = 0;
+    g_message_accepted = true;
+    g_last_message_data = NULL;
+    g_reported_count = 0;
+    g_reported_item_id = 0;
+    g_reported_status = 0;
+    g_twin_complete_count = 0;
+    g_twin_partial_count = 0;
+    g_methods_received = 0;
+    g_last_method_id = NULL;
+
+    Loopback_ResetStatistics();
+}
+
+static void queue_test_events(void)
+{
+    size_t index;
+    for (index = 0; index < TEST_EVENT_COUNT; index++)
+    {
+        real_DList_InsertTailList(&g_waitingToSend, &g_events[index].entry);
+    }
+}
+
+static TRANSPORT_LL_HANDLE create_registered_transport(void)
+{
+    TRANSPORT_LL_HANDLE handle = g_provider->IoTHubTransport_Create(&g_transport_config, &g_transport_cb, TEST_TRANSPORT_CONTEXT);
+    ASSERT_IS_NOT_NULL(handle);
+    ASSERT_IS_NOT_NULL(g_provider->IoTHubTransport_Register(handle, &g_device_config, &g_waitingToSend));
+    umock_c_reset_all_calls();
+    return handle;
+}
+
+static void set_expected_calls_for_create(void)
+{
+    STRICT_EXPECTED_CALL(IoTHub_Transport_ValidateCallbacks(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(tickcounter_create());
+    STRICT_EXPECTED_CALL(gballoc_realloc(NULL, IGNORED_NUM_ARG));
+}
+
+BEGIN_TEST_SUITE(iothubtransportloopback_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    int result;
+
+    test_serialize_mutex = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(test_serialize_mutex);
+
+    umock_c_init(on_umock_c_error);
+    result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_bool_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_UMOCK_ALIAS_TYPE(TICK_COUNTER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(PDLIST_ENTRY, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(const PDLIST_ENTRY, void*);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_realloc, my_gballoc_realloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_realloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+    REGISTER_GLOBAL_MOCK_RETURN(tickcounter_create, TEST_TICK_COUNTER_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(tickcounter_create, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(tickcounter_get_current_ms, my_tickcounter_get_current_ms);
+
+    REGISTER_GLOBAL_MOCK_HOOK(DList_InitializeListHead, real_DList_InitializeListHead);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_IsListEmpty, real_DList_IsListEmpty);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_InsertTailList, real_DList_InsertTailList);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_InsertHeadList, real_DList_InsertHeadList);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_AppendTailList, real_DList_AppendTailList);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_RemoveEntryList, real_DList_RemoveEntryList);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_RemoveHeadList, real_DList_RemoveHeadList);
+
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHub_Transport_ValidateCallbacks, 0);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHub_Transport_ValidateCallbacks, __LINE__);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubMessage_CreateFromByteArray, TEST_MESSAGE_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubMessage_CreateFromByteArray, NULL);
+
+    g_provider = Loopback_Protocol();
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+    TEST_MUTEX_DESTROY(test_serialize_mutex);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    TEST_MUTEX_ACQUIRE(test_serialize_mutex);
+    reset_test_data();
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(method_cleanup)
+{
+    TEST_MUTEX_RELEASE(test_serialize_mutex);
+}
+
+/* Tests_SRS_IOTHUB_LOOPBACK_TRANSPORT_41_001: [ If config, config->upperConfig or cb_info are NULL, or cb_info is missing a callback, IoTHubTransport_Create shall return NULL. ] */
+TEST_FUNCTION(Loopback_Create_NULL_config_fails)
+{
+    // act
+    TRANSPORT_LL_HANDLE handle = g_provider->IoTHubTransport_Create(NULL, &g_transport_cb, TEST_TRANSPORT_CONTEXT);
+
+    // assert
+    ASSERT_IS_NULL(handle);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_LOOPBACK_TRANSPORT_41_001: [ If config, config->upperConfig or cb_info are NULL, or cb_info is missing a callback, IoTHubTransport_Create shall return NULL. ] */
+TEST_FUNCTION(Loopback_Create_invalid_callbacks_fails)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(IoTHub_Transport_ValidateCallbacks(IGNORED_PTR_ARG)).SetReturn(__LINE__);
+
+    // act
+    TRANSPORT_LL_HANDLE handle = g_provider->IoTHubTransport_Create(&g_transport_config, &g_transport_cb, TEST_TRANSPORT_CONTEXT);
+
+    // assert
+    ASSERT_IS_NULL(handle);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+TEST_FUNCTION(Loopback_Create_succeeds)
+{
+    // arrange
+    set_expected_calls_for_create();
+
+    // act
+    TRANSPORT_LL_HANDLE handle = g_provider->IoTHubTransport_Create(&g_transport_config, &g_transport_cb, TEST_TRANSPORT_CONTEXT);
+
+    // assert
+    ASSERT_IS_NOT_NULL(handle);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    g_provider->IoTHubTransport_Destroy(handle);
+}
+
+/* Tests_SRS_IOTHUB_LOOPBACK_TRANSPORT_41_002: [ If any allocation fails, IoTHubTransport_Create shall free what it allocated and return NULL. ] */
+TEST_FUNCTION(Loopback_Create_fails_when_an_allocation_fails)
+{
+    // arrange
+    size_t index;
+    size_t count;
+    ASSERT_ARE_EQUAL(int, 0, umock_c_negative_tests_init());
+
+    set_expected_calls_for_create();
+    umock_c_negative_tests_snapshot();
+
+    count = umock_c_negative_tests_call_count();
+    for (index = 0; index < count; index++)
+    {
+        char tmp_msg[64];
+        TRANSPORT_LL_HANDLE handle;
+
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(index);
+        (void)sprintf(tmp_msg, "IoTHubTransport_Create failure in test %lu/%lu", (unsigned long)index, (unsigned long)count);
+
+        // act
+        handle = g_provider->IoTHubTransport_Create(&g_transport_config, &g_transport_cb, TEST_TRANSPORT_CONTEXT);
+
+        // assert
+        ASSERT_IS_NULL_WITH_MSG(handle, tmp_msg);
+    }
+
+    // cleanup
+    umock_c_negative_tests_deinit();
+}
+
+/* Tests_SRS_IOTHUB_LOOPBACK_TRANSPORT_41_013: [ IoTHubTransport_Register shall fail and return NULL if a device is already registered. ] */
+TEST_FUNCTION(Loopback_Register_second_device_fails)
+{
+    // arrange
+    TRANSPORT_LL_HANDLE handle = create_registered_transport();
+
+    // act
+    IOTHUB_DEVICE_HANDLE device = g_provider->IoTHubTransport_Register(handle, &g_device_config, &g_waitingToSend);
+
+    // assert
+    ASSERT_IS_NULL(device);
+
+    // cleanup
+    g_provider->IoTHubTransport_Destroy(handle);
+}
+
+/* Tests_SRS_IOTHUB_LOOPBACK_TRANSPORT_41_014: [ The first IoTHubTransport_DoWork after a device is registered shall report IOTHUB_CLIENT_CONNECTION_AUTHENTICATED through connection_status_cb. ] */
+/* Tests_SRS_IOTHUB_LOOPBACK_TRANSPORT_41_003: [ Without OPTION_LOOPBACK_LATENCY, IoTHubTransport_DoWork shall confirm every event of waitingToSend with IOTHUB_CLIENT_CONFIRMATION_OK. ] */
+TEST_FUNCTION(Loopback_DoWork_confirms_events)
+{
+    // arrange
+    LOOPBACK_TRANSPORT_STATISTICS statistics;
+    IOTHUB_CLIENT_STATUS status;
+    TRANSPORT_LL_HANDLE handle = create_registered_transport();
+    queue_test_events();
+
+    // act
+    g_provider->IoTHubTransport_DoWork(handle);
+    g_provider->IoTHubTransport_DoWork(handle);
+
+    // assert
+    Loopback_GetStatistics(&statistics);
+    ASSERT_ARE_EQUAL(size_t, 1, g_connected_count);
+    ASSERT_ARE_EQUAL(size_t, TEST_EVENT_COUNT, g_events_completed);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_CONFIRMATION_RESULT, IOTHUB_CLIENT_CONFIRMATION_OK, g_events_result);
+    ASSERT_ARE_EQUAL(size_t, TEST_EVENT_COUNT, statistics.events_confirmed);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, g_provider->IoTHubTransport_GetSendStatus(handle, &status));
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_SEND_STATUS_IDLE, status);
+
+    // cleanup
+    g_provider->IoTHubTransport_Destroy(handle);
+}
+
+/* Tests_SRS_IOTHUB_LOOPBACK_TRANSPORT_41_004: [ With OPTION_LOOPBACK_LATENCY, events, reported states and twin requests shall be answered by the first IoTHubTransport_DoWork after that many milliseconds. ] */
+/* Tests_SRS_IOTHUB_LOOPBACK_TRANSPORT_41_005: [ IoTHubTransport_DoWork shall complete, in the order they were made, the responses whose latency has passed. ] */
+TEST_FUNCTION(Loopback_DoWork_with_latency_confirms_events_after_the_latency)
+{
+    // arrange
+    unsigned int latency = 50;
+    IOTHUB_CLIENT_STATUS status;
+    TRANSPORT_LL_HANDLE handle = create_registered_transport();
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, g_provider->IoTHubTransport_SetOption(handle, OPTION_LOOPBACK_LATENCY, &latency));
+    queue_test_events();
+
+    // act
+    g_provider->IoTHubTransport_DoWork(handle);
+    g_current_ms += latency - 1;
+    g_provider->IoTHubTransport_DoWork(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 0, g_events_completed);
+    ASSERT_IS_TRUE(real_DList_IsListEmpty(&g_waitingToSend));
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, g_provider->IoTHubTransport_GetSendStatus(handle, &status));
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_SEND_STATUS_BUSY, status);
+
+    // act
+    g_current_ms++;
+    g_provider->IoTHubTransport_DoWork(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, TEST_EVENT_COUNT, g_events_completed);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_CONFIRMATION_RESULT, IOTHUB_CLIENT_CONFIRMATION_OK, g_events_result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, g_provider->IoTHubTransport_GetSendStatus(handle, &status));
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_SEND_STATUS_IDLE, status);
+
+    // cleanup
+    g_provider->IoTHubTransport_Destroy(handle);
+}
+
+/* Tests_SRS_IOTHUB_LOOPBACK_TRANSPORT_41_012: [ Events still waiting for their latency when the transport is destroyed or the device unregistered shall be completed with IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY. ] */
+TEST_FUNCTION(Loopback_Destroy_completes_events_waiting_for_the_latency)
+{
+    // arrange
+    unsigned int latency = 50;
+    TRANSPORT_LL_HANDLE handle = create_registered_transport();
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, g_provider->IoTHubTransport_SetOption(handle, OPTION_LOOPBACK_LATENCY, &latency));
+    queue_test_events();
+    g_provider->IoTHubTransport_DoWork(handle);
+
+    // act
+    g_provider->IoTHubTransport_Destroy(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, TEST_EVENT_COUNT, g_events_completed);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_CONFIRMATION_RESULT, IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY, g_events_result);
+}
+
+/* Tests_SRS_IOTHUB_LOOPBACK_TRANSPORT_41_006: [ IoTHubTransport_ProcessItem shall queue the acknowledgement of a reported state, completed through twin_rpt_state_complete_cb with status 204, and return IOTHUB_PROCESS_ERROR if it cannot. ] */
+TEST_FUNCTION(Loopback_ProcessItem_acknowledges_the_reported_state)
+{
+    // arrange
+    IOTHUB_DEVICE_TWIN device_twin;
+    IOTHUB_IDENTITY_INFO identity;
+    TRANSPORT_LL_HANDLE handle = create_registered_transport();
+    (void)memset(&device_twin, 0, sizeof(device_twin));
+    device_twin.item_id = 42;
+    identity.device_twin = &device_twin;
+
+    // act
+    IOTHUB_PROCESS_ITEM_RESULT result = g_provider->IoTHubTransport_ProcessItem(handle, IOTHUB_TYPE_DEVICE_TWIN, &identity);
+    g_provider->IoTHubTransport_DoWork(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_PROCESS_ITEM_RESULT, IOTHUB_PROCESS_OK, result);
+    ASSERT_ARE_EQUAL(size_t, 1, g_reported_count);
+    ASSERT_ARE_EQUAL(uint32_t, 42, g_reported_item_id);
+    ASSERT_ARE_EQUAL(int, 204, g_reported_status);
+
+    // cleanup
+    g_provider->IoTHubTransport_Destroy(handle);
+}
+
+/* Tests_SRS_IOTHUB_LOOPBACK_TRANSPORT_41_006: [ IoTHubTransport_ProcessItem shall queue the acknowledgement of a reported state, completed through twin_rpt_state_complete_cb with status 204, and return IOTHUB_PROCESS_ERROR if it cannot. ] */
+TEST_FUNCTION(Loopback_ProcessItem_malloc_fails)
+{
+    // arrange
+    IOTHUB_DEVICE_TWIN device_twin;
+    IOTHUB_IDENTITY_INFO identity;
+    TRANSPORT_LL_HANDLE handle = create_registered_transport();
+    (void)memset(&device_twin, 0, sizeof(device_twin));
+    identity.device_twin = &device_twin;
+
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)).SetReturn(NULL);
+
+    // act
+    IOTHUB_PROCESS_ITEM_RESULT result = g_provider->IoTHubTransport_ProcessItem(handle, IOTHUB_TYPE_DEVICE_TWIN, &identity);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_PROCESS_ITEM_RESULT, IOTHUB_PROCESS_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    g_provider->IoTHubTransport_Destroy(handle);
+}
+
+/* Tests_SRS_IOTHUB_LOOPBACK_TRANSPORT_41_007: [ IoTHubTransport_Subscribe_DeviceTwin shall queue the full twin for twin_retrieve_prop_complete_cb, as a hub does on subscription, and fail if it cannot. ] */
+TEST_FUNCTION(Loopback_Subscribe_DeviceTwin_delivers_the_full_twin)
+{
+    // arrange
+    TRANSPORT_LL_HANDLE handle = create_registered_transport();
+
+    // act
+    int result = g_provider->IoTHubTransport_Subscribe_DeviceTwin((IOTHUB_DEVICE_HANDLE)handle);
+    g_provider->IoTHubTransport_DoWork(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 1, g_twin_complete_count);
+    ASSERT_ARE_EQUAL(size_t, 0, g_twin_partial_count);
+
+    // cleanup
+    g_provider->IoTHubTransport_Destroy(handle);
+}
+
+/* Tests_SRS_IOTHUB_LOOPBACK_TRANSPORT_41_008: [ Once the client subscribes to them, IoTHubTransport_DoWork shall inject cloud-to-device messages through msg_cb, desired properties patches through twin_retrieve_prop_complete_cb and method invocations through method_complete_cb, each for as many as their rate has scheduled since the subscription or the last change of the rate. ] */
+/* Tests_SRS_IOTHUB_LOOPBACK_TRANSPORT_41_011: [ IoTHubTransport_SendMessageDisposition shall destroy the message and free messageData. ] */
+TEST_FUNCTION(Loopback_DoWork_injects_messages_at_the_rate)
+{
+    // arrange
+    LOOPBACK_TRANSPORT_STATISTICS statistics;
+    unsigned int rate = 100;
+    TRANSPORT_LL_HANDLE handle = create_registered_transport();
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, g_provider->IoTHubTransport_SetOption(handle, OPTION_LOOPBACK_C2D_RATE, &rate));
+    ASSERT_ARE_EQUAL(int, 0, g_provider->IoTHubTransport_Subscribe((IOTHUB_DEVICE_HANDLE)handle));
+    g_provider->IoTHubTransport_DoWork(handle);
+
+    // act
+    g_current_ms += 50;
+    g_provider->IoTHubTransport_DoWork(handle);
+    g_current_ms += 25;
+    g_provider->IoTHubTransport_DoWork(handle);
+
+    // assert
+    Loopback_GetStatistics(&statistics);
+    ASSERT_ARE_EQUAL(size_t, 7, g_messages_received);
+    ASSERT_ARE_EQUAL(size_t, 7, statistics.messages_injected);
+    ASSERT_ARE_EQUAL(size_t, 7, statistics.messages_disposed);
+
+    // cleanup
+    g_provider->IoTHubTransport_Destroy(handle);
+}
+
+/* Tests_SRS_IOTHUB_LOOPBACK_TRANSPORT_41_008: [ Once the client subscribes to them, IoTHubTransport_DoWork shall inject cloud-to-device messages through msg_cb, desired properties patches through twin_retrieve_prop_complete_cb and method invocations through method_complete_cb, each for as many as their rate has scheduled since the subscription or the last change of the rate. ] */
+TEST_FUNCTION(Loopback_DoWork_does_not_inject_without_subscription)
+{
+    // arrange
+    unsigned int rate = 1000;
+    TRANSPORT_LL_HANDLE handle = create_registered_transport();
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, g_provider->IoTHubTransport_SetOption(handle, OPTION_LOOPBACK_C2D_RATE, &rate));
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, g_provider->IoTHubTransport_SetOption(handle, OPTION_LOOPBACK_METHOD_RATE, &rate));
+    g_provider->IoTHubTransport_DoWork(handle);
+
+    // act
+    g_current_ms += 100;
+    g_provider->IoTHubTransport_DoWork(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 0, g_messages_received);
+    ASSERT_ARE_EQUAL(size_t, 0, g_methods_received);
+
+    // cleanup
+    g_provider->IoTHubTransport_Destroy(handle);
+}
+
+/* Tests_SRS_IOTHUB_LOOPBACK_TRANSPORT_41_008: [ Once the client subscribes to them, IoTHubTransport_DoWork shall inject cloud-to-device messages through msg_cb, desired properties patches through twin_retrieve_prop_complete_cb and method invocations through method_complete_cb, each for as many as their rate has scheduled since the subscription or the last change of the rate. ] */
+TEST_FUNCTION(Loopback_DoWork_injects_desired_patches_and_methods)
+{
+    // arrange
+    LOOPBACK_TRANSPORT_STATISTICS statistics;
+    unsigned int desired_rate = 10;
+    unsigned int method_rate = 20;
+    TRANSPORT_LL_HANDLE handle = create_registered_transport();
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, g_provider->IoTHubTransport_SetOption(handle, OPTION_LOOPBACK_DESIRED_RATE, &desired_rate));
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, g_provider->IoTHubTransport_SetOption(handle, OPTION_LOOPBACK_METHOD_RATE, &method_rate));
+    ASSERT_ARE_EQUAL(int, 0, g_provider->IoTHubTransport_Subscribe_DeviceTwin((IOTHUB_DEVICE_HANDLE)handle));
+    ASSERT_ARE_EQUAL(int, 0, g_provider->IoTHubTransport_Subscribe_DeviceMethod((IOTHUB_DEVICE_HANDLE)handle));
+    g_provider->IoTHubTransport_DoWork(handle);
+
+    // act
+    g_current_ms += 500;
+    g_provider->IoTHubTransport_DoWork(handle);
+    ASSERT_ARE_EQUAL(int, 0, g_provider->IoTHubTransport_DeviceMethod_Response((IOTHUB_DEVICE_HANDLE)handle, g_last_method_id, NULL, 0, 200));
+
+    // assert
+    Loopback_GetStatistics(&statistics);
+    ASSERT_ARE_EQUAL(size_t, 1, g_twin_complete_count);
+    ASSERT_ARE_EQUAL(size_t, 5, g_twin_partial_count);
+    ASSERT_ARE_EQUAL(size_t, 10, g_methods_received);
+    ASSERT_IS_NOT_NULL(g_last_method_id);
+    ASSERT_ARE_EQUAL(size_t, 5, statistics.desired_patches_injected);
+    ASSERT_ARE_EQUAL(size_t, 10, statistics.methods_injected);
+    ASSERT_ARE_EQUAL(size_t, 1, statistics.method_responses);
+
+    // cleanup
+    g_provider->IoTHubTransport_Destroy(handle);
+}
+
+/* Tests_SRS_IOTHUB_LOOPBACK_TRANSPORT_41_011: [ IoTHubTransport_SendMessageDisposition shall destroy the message and free messageData. ] */
+TEST_FUNCTION(Loopback_SendMessageDisposition_destroys_the_message)
+{
+    // arrange
+    unsigned int rate = 1000;
+    TRANSPORT_LL_HANDLE handle = create_registered_transport();
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, g_provider->IoTHubTransport_SetOption(handle, OPTION_LOOPBACK_C2D_RATE, &rate));
+    ASSERT_ARE_EQUAL(int, 0, g_provider->IoTHubTransport_Subscribe((IOTHUB_DEVICE_HANDLE)handle));
+    g_provider->IoTHubTransport_DoWork(handle);
+    g_message_accepted = false;
+    g_current_ms += 1;
+    g_provider->IoTHubTransport_DoWork(handle);
+    ASSERT_IS_NOT_NULL(g_last_message_data);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(gballoc_free(g_last_message_data));
+
+    // act
+    IOTHUB_CLIENT_RESULT result = g_provider->IoTHubTransport_SendMessageDisposition(g_last_message_data, IOTHUBMESSAGE_ACCEPTED);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    g_provider->IoTHubTransport_Destroy(handle);
+}
+
+/* Tests_SRS_IOTHUB_LOOPBACK_TRANSPORT_41_009: [ If the payload of OPTION_LOOPBACK_PAYLOAD_SIZE cannot be allocated, IoTHubTransport_SetOption shall return IOTHUB_CLIENT_ERROR and keep the previous payload. ] */
+TEST_FUNCTION(Loopback_SetOption_payload_size_realloc_fails)
+{
+    // arrange
+    size_t payload_size = 1024;
+    TRANSPORT_LL_HANDLE handle = create_registered_transport();
+
+    STRICT_EXPECTED_CALL(gballoc_realloc(IGNORED_PTR_ARG, payload_size)).SetReturn(NULL);
+
+    // act
+    IOTHUB_CLIENT_RESULT result = g_provider->IoTHubTransport_SetOption(handle, OPTION_LOOPBACK_PAYLOAD_SIZE, &payload_size);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    g_provider->IoTHubTransport_Destroy(handle);
+}
+
+/* Tests_SRS_IOTHUB_LOOPBACK_TRANSPORT_41_010: [ IoTHubTransport_SetOption shall accept and ignore every other option, so that an application configured for a network transport runs unchanged. ] */
+TEST_FUNCTION(Loopback_SetOption_ignores_other_options)
+{
+    // arrange
+    TRANSPORT_LL_HANDLE handle = create_registered_transport();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = g_provider->IoTHubTransport_SetOption(handle, TEST_UNKNOWN_OPTION, "certificates");
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    g_provider->IoTHubTransport_Destroy(handle);
+}
+
+/* Tests_SRS_IOTHUB_LOOPBACK_TRANSPORT_41_015: [ Loopback_GetStatistics shall copy the counters of every loopback transport of the process into statistics, and Loopback_ResetStatistics shall set them to 0. ] */
+TEST_FUNCTION(Loopback_ResetStatistics_clears_the_counters)
+{
+    // arrange
+    LOOPBACK_TRANSPORT_STATISTICS statistics;
+    TRANSPORT_LL_HANDLE handle = create_registered_transport();
+    queue_test_events();
+    g_provider->IoTHubTransport_DoWork(handle);
+
+    // act
+    Loopback_ResetStatistics();
+
+    // assert
+    Loopback_GetStatistics(&statistics);
+    ASSERT_ARE_EQUAL(size_t, 0, statistics.events_confirmed);
+
+    // cleanup
+    g_provider->IoTHubTransport_Destroy(handle);
+}
+
+END_TEST_SUITE(iothubtransportloopback_ut)
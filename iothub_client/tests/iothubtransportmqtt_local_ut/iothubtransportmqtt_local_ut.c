@@ -0,0 +1,352 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#else
+#include <stdlib.h>
+#endif
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umock_c_negative_tests.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+
+#if defined _MSC_VER
+#pragma warning(disable: 4054) /* MSC incorrectly fires this */
+#endif
+
+#define ENABLE_MOCKS
+
+#include "azure_c_shared_utility/gballoc.h"
+
+#include "azure_c_shared_utility/xio.h"
+#include "azure_c_shared_utility/socketio.h"
+#include "azure_c_shared_utility/envvariable.h"
+#include "internal/iothubtransport_mqtt_common.h"
+#include "internal/iothubtransport.h"
+
+#undef ENABLE_MOCKS
+
+#include "azure_c_shared_utility/shared_util_options.h"
+#include "iothubtransportmqtt_local.h"
+
+static const char* TEST_STRING_VALUE = "FULLY_QUALIFIED_HOSTNAME";
+static const char* TEST_SOCKET_PATH = "/var/run/iotedge/edgehub.sock";
+static const char* TEST_DEVICE_ID = "thisIsDeviceID";
+static const char* TEST_DEVICE_KEY = "thisIsDeviceKey";
+static const char* TEST_IOTHUB_NAME = "thisIsIotHubName";
+static const char* TEST_IOTHUB_SUFFIX = "thisIsIotHubSuffix";
+static const char* TEST_PROTOCOL_GATEWAY_HOSTNAME = "thisIsAGatewayHostName.net";
+
+static const char* TEST_OPTION_NAME = "TEST_OPTION_NAME";
+static const char* TEST_OPTION_VALUE = "test_option_value";
+
+static const TRANSPORT_LL_HANDLE TEST_TRANSPORT_HANDLE = (TRANSPORT_LL_HANDLE)0x4444;
+static XIO_HANDLE TEST_XIO_HANDLE = (XIO_HANDLE)0x1126;
+static IOTHUB_DEVICE_HANDLE TEST_DEVICE_HANDLE = (IOTHUB_DEVICE_HANDLE)0x1181;
+static IO_INTERFACE_DESCRIPTION* TEST_SOCKETIO_INTERFACE_DESCRIPTION = (IO_INTERFACE_DESCRIPTION*)0x1182;
+
+static TRANSPORT_CALLBACKS_INFO* transport_cb_info = (TRANSPORT_CALLBACKS_INFO*)0x227733;
+
+static IOTHUB_CLIENT_CONFIG g_iothubClientConfig = { 0 };
+static DLIST_ENTRY g_waitingToSend;
+
+static MQTT_GET_IO_TRANSPORT g_get_io_transport;
+static const char* g_socketio_hostname;
+static int g_socketio_port;
+
+TEST_DEFINE_ENUM_TYPE(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_RESULT_VALUES);
+IMPLEMENT_UMOCK_C_ENUM_TYPE(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_RESULT_VALUES);
+
+static TEST_MUTEX_HANDLE test_serialize_mutex;
+
+static pfIoTHubTransport_SetOption                  IoTHubTransportMqtt_Local_SetOption;
+static pfIoTHubTransport_Create                     IoTHubTransportMqtt_Local_Create;
+static pfIoTHubTransport_Destroy                    IoTHubTransportMqtt_Local_Destroy;
+static pfIotHubTransport_Register                   IoTHubTransportMqtt_Local_Register;
+static pfIoTHubTransport_DoWork                     IoTHubTransportMqtt_Local_DoWork;
+
+static TRANSPORT_LL_HANDLE my_IoTHubTransport_MQTT_Common_Create(const IOTHUBTRANSPORT_CONFIG* config, MQTT_GET_IO_TRANSPORT get_io_transport, TRANSPORT_CALLBACKS_INFO* cb_info, void* ctx)
+{
+    (void)config;
+    (void)cb_info;
+    (void)ctx;
+    g_get_io_transport = get_io_transport;
+    return TEST_TRANSPORT_HANDLE;
+}
+
+static XIO_HANDLE my_xio_create(const IO_INTERFACE_DESCRIPTION* io_interface_description, const void* xio_create_parameters)
+{
+    const SOCKETIO_CONFIG* socketio_config = (const SOCKETIO_CONFIG*)xio_create_parameters;
+    (void)io_interface_description;
+    g_socketio_hostname = socketio_config->hostname;
+    g_socketio_port = socketio_config->port;
+    return TEST_XIO_HANDLE;
+}
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    (void)error_code;
+    ASSERT_FAIL("umock_c reported error");
+}
+
+BEGIN_TEST_SUITE(iothubtransportmqtt_local_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    test_serialize_mutex = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(test_serialize_mutex);
+
+    umock_c_init(on_umock_c_error);
+
+    REGISTER_UMOCK_ALIAS_TYPE(XIO_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(TRANSPORT_LL_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(MQTT_GET_IO_TRANSPORT, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_DEVICE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(PDLIST_ENTRY, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(const PDLIST_ENTRY, void*);
+
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubTransport_MQTT_Common_Create, my_IoTHubTransport_MQTT_Common_Create);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubTransport_MQTT_Common_SetOption, IOTHUB_CLIENT_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubTransport_MQTT_Common_Register, TEST_DEVICE_HANDLE);
+
+    REGISTER_GLOBAL_MOCK_RETURN(environment_get_variable, TEST_SOCKET_PATH);
+    REGISTER_GLOBAL_MOCK_RETURN(socketio_get_interface_description, TEST_SOCKETIO_INTERFACE_DESCRIPTION);
+    REGISTER_GLOBAL_MOCK_HOOK(xio_create, my_xio_create);
+    REGISTER_GLOBAL_MOCK_RETURN(xio_setoption, 0);
+
+    IoTHubTransportMqtt_Local_SetOption = ((TRANSPORT_PROVIDER*)MQTT_Local_Protocol())->IoTHubTransport_SetOption;
+    IoTHubTransportMqtt_Local_Create = ((TRANSPORT_PROVIDER*)MQTT_Local_Protocol())->IoTHubTransport_Create;
+    IoTHubTransportMqtt_Local_Destroy = ((TRANSPORT_PROVIDER*)MQTT_Local_Protocol())->IoTHubTransport_Destroy;
+    IoTHubTransportMqtt_Local_Register = ((TRANSPORT_PROVIDER*)MQTT_Local_Protocol())->IoTHubTransport_Register;
+    IoTHubTransportMqtt_Local_DoWork = ((TRANSPORT_PROVIDER*)MQTT_Local_Protocol())->IoTHubTransport_DoWork;
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+    TEST_MUTEX_DESTROY(test_serialize_mutex);
+}
+
+static void reset_test_data()
+{
+    memset(&g_waitingToSend, 0, sizeof(g_waitingToSend));
+    memset(&g_get_io_transport, 0, sizeof(g_get_io_transport));
+    g_socketio_hostname = NULL;
+    g_socketio_port = -1;
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    TEST_MUTEX_ACQUIRE(test_serialize_mutex);
+
+    reset_test_data();
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    reset_test_data();
+    TEST_MUTEX_RELEASE(test_serialize_mutex);
+}
+
+static TRANSPORT_LL_HANDLE create_local_transport(IOTHUBTRANSPORT_CONFIG* config)
+{
+    g_iothubClientConfig.protocol = MQTT_Local_Protocol;
+    g_iothubClientConfig.deviceId = TEST_DEVICE_ID;
+    g_iothubClientConfig.deviceKey = TEST_DEVICE_KEY;
+    g_iothubClientConfig.deviceSasToken = NULL;
+    g_iothubClientConfig.iotHubName = TEST_IOTHUB_NAME;
+    g_iothubClientConfig.iotHubSuffix = TEST_IOTHUB_SUFFIX;
+    g_iothubClientConfig.protocolGatewayHostName = TEST_PROTOCOL_GATEWAY_HOSTNAME;
+    config->waitingToSend = &g_waitingToSend;
+    config->upperConfig = &g_iothubClientConfig;
+
+    return IoTHubTransportMqtt_Local_Create(config, transport_cb_info, NULL);
+}
+
+TEST_FUNCTION(IoTHubTransportMqtt_Local_Create_success)
+{
+    // arrange
+    IOTHUBTRANSPORT_CONFIG config = { 0 };
+
+    STRICT_EXPECTED_CALL(IoTHubTransport_MQTT_Common_Create(&config, IGNORED_PTR_ARG, transport_cb_info, NULL));
+
+    // act
+    TRANSPORT_LL_HANDLE handle = create_local_transport(&config);
+
+    // assert
+    ASSERT_IS_NOT_NULL(handle);
+    ASSERT_IS_NOT_NULL(g_get_io_transport);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+}
+
+/* Tests_SRS_IOTHUB_MQTT_LOCAL_TRANSPORT_41_003: [ getLocalIoTransportProvider shall create a socket IO whose hostname is the socket path and whose port is 0. ] */
+/* Tests_SRS_IOTHUB_MQTT_LOCAL_TRANSPORT_41_004: [ getLocalIoTransportProvider shall set OPTION_ADDRESS_TYPE to OPTION_ADDRESS_TYPE_DOMAIN_SOCKET on the socket IO. ] */
+TEST_FUNCTION(IoTHubTransportMqtt_Local_getLocalIoTransportProvider_creates_domain_socket_io)
+{
+    // arrange
+    IOTHUBTRANSPORT_CONFIG config = { 0 };
+    (void)create_local_transport(&config);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(environment_get_variable(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(socketio_get_interface_description());
+    STRICT_EXPECTED_CALL(xio_create(TEST_SOCKETIO_INTERFACE_DESCRIPTION, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(xio_setoption(TEST_XIO_HANDLE, OPTION_ADDRESS_TYPE, IGNORED_PTR_ARG));
+
+    // act
+    XIO_HANDLE xioTest = g_get_io_transport(TEST_STRING_VALUE, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(void_ptr, TEST_XIO_HANDLE, xioTest);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_SOCKET_PATH, g_socketio_hostname);
+    ASSERT_ARE_EQUAL(int, 0, g_socketio_port);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_MQTT_LOCAL_TRANSPORT_41_001: [ If the EdgeHubLocalSocket environment variable is not set, getLocalIoTransportProvider shall return NULL. ] */
+TEST_FUNCTION(IoTHubTransportMqtt_Local_getLocalIoTransportProvider_without_socket_path_fails)
+{
+    // arrange
+    IOTHUBTRANSPORT_CONFIG config = { 0 };
+    (void)create_local_transport(&config);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(environment_get_variable(IGNORED_PTR_ARG)).SetReturn(NULL);
+
+    // act
+    XIO_HANDLE xioTest = g_get_io_transport(TEST_STRING_VALUE, NULL);
+
+    // assert
+    ASSERT_IS_NULL(xioTest);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_MQTT_LOCAL_TRANSPORT_41_002: [ If socketio_get_interface_description returns NULL, getLocalIoTransportProvider shall return NULL. ] */
+TEST_FUNCTION(IoTHubTransportMqtt_Local_getLocalIoTransportProvider_socketio_get_interface_description_NULL_fails)
+{
+    // arrange
+    IOTHUBTRANSPORT_CONFIG config = { 0 };
+    (void)create_local_transport(&config);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(environment_get_variable(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(socketio_get_interface_description()).SetReturn(NULL);
+
+    // act
+    XIO_HANDLE xioTest = g_get_io_transport(TEST_STRING_VALUE, NULL);
+
+    // assert
+    ASSERT_IS_NULL(xioTest);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_MQTT_LOCAL_TRANSPORT_41_005: [ If setting OPTION_ADDRESS_TYPE fails, getLocalIoTransportProvider shall destroy the socket IO and return NULL. ] */
+TEST_FUNCTION(IoTHubTransportMqtt_Local_getLocalIoTransportProvider_without_domain_socket_support_fails)
+{
+    // arrange
+    IOTHUBTRANSPORT_CONFIG config = { 0 };
+    (void)create_local_transport(&config);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(environment_get_variable(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(socketio_get_interface_description());
+    STRICT_EXPECTED_CALL(xio_create(TEST_SOCKETIO_INTERFACE_DESCRIPTION, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(xio_setoption(TEST_XIO_HANDLE, OPTION_ADDRESS_TYPE, IGNORED_PTR_ARG)).SetReturn(__LINE__);
+    STRICT_EXPECTED_CALL(xio_destroy(TEST_XIO_HANDLE));
+
+    // act
+    XIO_HANDLE xioTest = g_get_io_transport(TEST_STRING_VALUE, NULL);
+
+    // assert
+    ASSERT_IS_NULL(xioTest);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_MQTT_LOCAL_TRANSPORT_41_006: [ IoTHubTransportMqtt_Local_SetOption shall accept and ignore OPTION_TRUSTED_CERT, as there is no TLS layer to give it to. ] */
+TEST_FUNCTION(IoTHubTransportMqtt_Local_SetOption_ignores_trusted_cert)
+{
+    // arrange
+    IOTHUBTRANSPORT_CONFIG config = { 0 };
+    TRANSPORT_LL_HANDLE handle = create_local_transport(&config);
+    umock_c_reset_all_calls();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransportMqtt_Local_SetOption(handle, OPTION_TRUSTED_CERT, TEST_OPTION_VALUE);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+}
+
+/* Tests_SRS_IOTHUB_MQTT_LOCAL_TRANSPORT_41_007: [ Otherwise IoTHubTransportMqtt_Local_SetOption shall call into IoTHubTransport_MQTT_Common_SetOption. ] */
+TEST_FUNCTION(IoTHubTransportMqtt_Local_SetOption_success)
+{
+    // arrange
+    IOTHUBTRANSPORT_CONFIG config = { 0 };
+    TRANSPORT_LL_HANDLE handle = create_local_transport(&config);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(IoTHubTransport_MQTT_Common_SetOption(handle, TEST_OPTION_NAME, TEST_OPTION_VALUE));
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransportMqtt_Local_SetOption(handle, TEST_OPTION_NAME, TEST_OPTION_VALUE);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+}
+
+/* Tests_SRS_IOTHUB_MQTT_LOCAL_TRANSPORT_41_008: [ MQTT_Local_Protocol shall return a TRANSPORT_PROVIDER whose functions call into the matching IoTHubTransport_MQTT_Common functions, except SetOption. ] */
+TEST_FUNCTION(IoTHubTransportMqtt_Local_Register_success)
+{
+    // arrange
+    IOTHUBTRANSPORT_CONFIG config = { 0 };
+    IOTHUB_DEVICE_CONFIG deviceConfig = { 0 };
+    TRANSPORT_LL_HANDLE handle = create_local_transport(&config);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(IoTHubTransport_MQTT_Common_Register(handle, &deviceConfig, &g_waitingToSend));
+
+    // act
+    IOTHUB_DEVICE_HANDLE devHandle = IoTHubTransportMqtt_Local_Register(handle, &deviceConfig, &g_waitingToSend);
+
+    // assert
+    ASSERT_ARE_EQUAL(void_ptr, TEST_DEVICE_HANDLE, devHandle);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+}
+
+/* Tests_SRS_IOTHUB_MQTT_LOCAL_TRANSPORT_41_008: [ MQTT_Local_Protocol shall return a TRANSPORT_PROVIDER whose functions call into the matching IoTHubTransport_MQTT_Common functions, except SetOption. ] */
+TEST_FUNCTION(IoTHubTransportMqtt_Local_DoWork_and_Destroy_success)
+{
+    // arrange
+    IOTHUBTRANSPORT_CONFIG config = { 0 };
+    TRANSPORT_LL_HANDLE handle = create_local_transport(&config);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(IoTHubTransport_MQTT_Common_DoWork(handle));
+    STRICT_EXPECTED_CALL(IoTHubTransport_MQTT_Common_Destroy(handle));
+
+    // act
+    IoTHubTransportMqtt_Local_DoWork(handle);
+    IoTHubTransportMqtt_Local_Destroy(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+}
+
+END_TEST_SUITE(iothubtransportmqtt_local_ut)
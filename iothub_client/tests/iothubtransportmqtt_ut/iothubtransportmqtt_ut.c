@@ -34,6 +34,7 @@ static void real_free(void* ptr)
 #include "azure_c_shared_utility/tlsio.h"
 #include "internal/iothubtransport_mqtt_common.h"
 #include "internal/iothubtransport.h"
+#include "internal/iothub_client_coalescing_io.h"
 
 #undef ENABLE_MOCKS
 
@@ -57,6 +58,8 @@ static IOTHUB_DEVICE_HANDLE TEST_DEVICE_HANDLE = (IOTHUB_DEVICE_HANDLE)0x1181;
 static IO_INTERFACE_DESCRIPTION* TEST_WSIO_INTERFACE_DESCRIPTION = (IO_INTERFACE_DESCRIPTION*)0x1182;
 static IO_INTERFACE_DESCRIPTION* TEST_TLSIO_INTERFACE_DESCRIPTION = (IO_INTERFACE_DESCRIPTION*)0x1183;
 static IO_INTERFACE_DESCRIPTION* TEST_HTTP_PROXY_IO_INTERFACE_DESCRIPTION = (IO_INTERFACE_DESCRIPTION*)0x1185;
+static IO_INTERFACE_DESCRIPTION* TEST_COALESCING_IO_INTERFACE_DESCRIPTION = (IO_INTERFACE_DESCRIPTION*)0x1186;
+static XIO_HANDLE TEST_TLSIO_HANDLE = (XIO_HANDLE)0x1187;
 
 static TRANSPORT_CALLBACKS_INFO* g_transport_cb_info = (TRANSPORT_CALLBACKS_INFO*)0x227733;
 static void* g_transport_cb_ctx = (void*)0x499922;
@@ -330,6 +333,7 @@ TEST_SUITE_INITIALIZE(suite_init)
 
     REGISTER_GLOBAL_MOCK_RETURN(platform_get_default_tlsio, TEST_TLSIO_INTERFACE_DESCRIPTION);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(platform_get_default_tlsio, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(coalescing_io_get_interface_description, TEST_COALESCING_IO_INTERFACE_DESCRIPTION);
 
     IoTHubTransportMqtt_SendMessageDisposition = ((TRANSPORT_PROVIDER*)MQTT_Protocol())->IoTHubTransport_SendMessageDisposition;
     IoTHubTransportMqtt_GetHostname = ((TRANSPORT_PROVIDER*)MQTT_Protocol())->IoTHubTransport_GetHostname;
@@ -438,6 +442,8 @@ TEST_FUNCTION(IoTHubTransportMqtt_getSocketsIOTransport_success)
     STRICT_EXPECTED_CALL(platform_get_default_tlsio());
     STRICT_EXPECTED_CALL(xio_create(TEST_TLSIO_INTERFACE_DESCRIPTION, &tlsio_config))
         .ValidateArgumentValue_io_create_parameters_AsType(UMOCK_TYPE(TLSIO_CONFIG*));
+    STRICT_EXPECTED_CALL(coalescing_io_get_interface_description());
+    STRICT_EXPECTED_CALL(xio_create(TEST_COALESCING_IO_INTERFACE_DESCRIPTION, IGNORED_PTR_ARG));
 
     ASSERT_IS_NOT_NULL(g_get_io_transport);
 
@@ -482,6 +488,8 @@ TEST_FUNCTION(IoTHubTransportMqtt_getSocketsIOTransport_ignores_proxy_options)
     STRICT_EXPECTED_CALL(platform_get_default_tlsio());
     STRICT_EXPECTED_CALL(xio_create(TEST_TLSIO_INTERFACE_DESCRIPTION, &tlsio_config))
         .ValidateArgumentValue_io_create_parameters_AsType(UMOCK_TYPE(TLSIO_CONFIG*));
+    STRICT_EXPECTED_CALL(coalescing_io_get_interface_description());
+    STRICT_EXPECTED_CALL(xio_create(TEST_COALESCING_IO_INTERFACE_DESCRIPTION, IGNORED_PTR_ARG));
 
     ASSERT_IS_NOT_NULL(g_get_io_transport);
 
@@ -493,6 +501,59 @@ TEST_FUNCTION(IoTHubTransportMqtt_getSocketsIOTransport_ignores_proxy_options)
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 }
 
+/* Tests_SRS_IOTHUB_MQTT_TRANSPORT_41_001: [ `getIoTransportProvider` shall put the TLS IO under a coalescing IO, created with `xio_create`, the interface returned by `coalescing_io_get_interface_description` and a `COALESCING_IO_CONFIG` whose `underlying_io` is the TLS IO, and return the coalescing IO. ]*/
+TEST_FUNCTION(IoTHubTransportMqtt_getSocketsIOTransport_returns_the_coalescing_IO)
+{
+    // arrange
+    IOTHUBTRANSPORT_CONFIG config = { 0 };
+    XIO_HANDLE xioTest;
+    COALESCING_IO_CONFIG coalescing_io_config;
+    SetupIothubTransportConfig(&config, TEST_DEVICE_ID, TEST_DEVICE_KEY, TEST_IOTHUB_NAME, TEST_IOTHUB_SUFFIX, TEST_PROTOCOL_GATEWAY_HOSTNAME);
+    (void)IoTHubTransportMqtt_Create(&config, g_transport_cb_info, NULL);
+    umock_c_reset_all_calls();
+
+    coalescing_io_config.underlying_io = TEST_TLSIO_HANDLE;
+
+    STRICT_EXPECTED_CALL(platform_get_default_tlsio());
+    STRICT_EXPECTED_CALL(xio_create(TEST_TLSIO_INTERFACE_DESCRIPTION, IGNORED_PTR_ARG))
+        .SetReturn(TEST_TLSIO_HANDLE);
+    STRICT_EXPECTED_CALL(coalescing_io_get_interface_description());
+    STRICT_EXPECTED_CALL(xio_create(TEST_COALESCING_IO_INTERFACE_DESCRIPTION, &coalescing_io_config))
+        .ValidateArgumentBuffer(2, &coalescing_io_config, sizeof(coalescing_io_config));
+
+    // act
+    xioTest = g_get_io_transport(TEST_STRING_VALUE, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(void_ptr, TEST_XIO_HANDLE, xioTest);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_MQTT_TRANSPORT_41_002: [ If the coalescing IO cannot be created, `getIoTransportProvider` shall return the TLS IO. ]*/
+TEST_FUNCTION(IoTHubTransportMqtt_getSocketsIOTransport_returns_the_TLS_IO_when_the_coalescing_IO_fails)
+{
+    // arrange
+    IOTHUBTRANSPORT_CONFIG config = { 0 };
+    XIO_HANDLE xioTest;
+    SetupIothubTransportConfig(&config, TEST_DEVICE_ID, TEST_DEVICE_KEY, TEST_IOTHUB_NAME, TEST_IOTHUB_SUFFIX, TEST_PROTOCOL_GATEWAY_HOSTNAME);
+    (void)IoTHubTransportMqtt_Create(&config, g_transport_cb_info, NULL);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(platform_get_default_tlsio());
+    STRICT_EXPECTED_CALL(xio_create(TEST_TLSIO_INTERFACE_DESCRIPTION, IGNORED_PTR_ARG))
+        .SetReturn(TEST_TLSIO_HANDLE);
+    STRICT_EXPECTED_CALL(coalescing_io_get_interface_description());
+    STRICT_EXPECTED_CALL(xio_create(TEST_COALESCING_IO_INTERFACE_DESCRIPTION, IGNORED_PTR_ARG))
+        .SetReturn(NULL);
+
+    // act
+    xioTest = g_get_io_transport(TEST_STRING_VALUE, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(void_ptr, TEST_TLSIO_HANDLE, xioTest);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
 /* Tests_SRS_IOTHUB_MQTT_TRANSPORT_07_013: [ If `platform_get_default_tlsio` returns NULL, `getIoTransportProvider` shall return NULL. ] */
 TEST_FUNCTION(IoTHubTransportMqtt_getSocketsIOTransport_platform_get_default_tlsio_NULL_fail)
 {
@@ -37,6 +37,7 @@ static void real_free(void* ptr)
 #include "azure_c_shared_utility/http_proxy_io.h"
 #include "internal/iothubtransport_mqtt_common.h"
 #include "internal/iothubtransport.h"
+#include "internal/iothub_client_coalescing_io.h"
 
 #undef ENABLE_MOCKS
 
@@ -60,6 +61,8 @@ static IOTHUB_DEVICE_HANDLE TEST_DEVICE_HANDLE = (IOTHUB_DEVICE_HANDLE)0x1181;
 static IO_INTERFACE_DESCRIPTION* TEST_WSIO_INTERFACE_DESCRIPTION = (IO_INTERFACE_DESCRIPTION*)0x1182;
 static IO_INTERFACE_DESCRIPTION* TEST_TLSIO_INTERFACE_DESCRIPTION = (IO_INTERFACE_DESCRIPTION*)0x1183;
 static IO_INTERFACE_DESCRIPTION* TEST_HTTP_PROXY_IO_INTERFACE_DESCRIPTION = (IO_INTERFACE_DESCRIPTION*)0x1185;
+static IO_INTERFACE_DESCRIPTION* TEST_COALESCING_IO_INTERFACE_DESCRIPTION = (IO_INTERFACE_DESCRIPTION*)0x1186;
+static XIO_HANDLE TEST_WSIO_HANDLE = (XIO_HANDLE)0x1187;
 
 static TRANSPORT_CALLBACKS_INFO* transport_cb_info = (TRANSPORT_CALLBACKS_INFO*)0x227733;
 
@@ -626,6 +629,7 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_RETURN(wsio_get_interface_description, TEST_WSIO_INTERFACE_DESCRIPTION);
     REGISTER_GLOBAL_MOCK_RETURN(platform_get_default_tlsio, TEST_TLSIO_INTERFACE_DESCRIPTION);
     REGISTER_GLOBAL_MOCK_RETURN(http_proxy_io_get_interface_description, TEST_HTTP_PROXY_IO_INTERFACE_DESCRIPTION);
+    REGISTER_GLOBAL_MOCK_RETURN(coalescing_io_get_interface_description, TEST_COALESCING_IO_INTERFACE_DESCRIPTION);
 
     /* Tests_SRS_IOTHUB_MQTT_WEBSOCKET_TRANSPORT_07_011: [ This function shall return a pointer to a structure of type TRANSPORT_PROVIDER having the following values for its fields:
 
@@ -764,6 +768,8 @@ TEST_FUNCTION(IoTHubTransportMqtt_WS_getWebSocketsIOTransport_with_NULL_uses_a_s
     STRICT_EXPECTED_CALL(platform_get_default_tlsio());
     STRICT_EXPECTED_CALL(xio_create(TEST_WSIO_INTERFACE_DESCRIPTION, &wsio_config))
         .ValidateArgumentValue_io_create_parameters_AsType(UMOCK_TYPE(WSIO_CONFIG*));
+    STRICT_EXPECTED_CALL(coalescing_io_get_interface_description());
+    STRICT_EXPECTED_CALL(xio_create(TEST_COALESCING_IO_INTERFACE_DESCRIPTION, IGNORED_PTR_ARG));
 
     ASSERT_IS_NOT_NULL(g_get_io_transport);
 
@@ -775,6 +781,61 @@ TEST_FUNCTION(IoTHubTransportMqtt_WS_getWebSocketsIOTransport_with_NULL_uses_a_s
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 }
 
+/* Tests_SRS_IOTHUB_MQTT_WEBSOCKET_TRANSPORT_41_001: [ `getIoTransportProvider` shall put the WebSocket IO under a coalescing IO, created with `xio_create`, the interface returned by `coalescing_io_get_interface_description` and a `COALESCING_IO_CONFIG` whose `underlying_io` is the WebSocket IO, and return the coalescing IO. ]*/
+TEST_FUNCTION(IoTHubTransportMqtt_WS_getWebSocketsIOTransport_returns_the_coalescing_IO)
+{
+    // arrange
+    IOTHUBTRANSPORT_CONFIG config = { 0 };
+    XIO_HANDLE xioTest;
+    COALESCING_IO_CONFIG coalescing_io_config;
+    SetupIothubTransportConfig(&config, TEST_DEVICE_ID, TEST_DEVICE_KEY, TEST_IOTHUB_NAME, TEST_IOTHUB_SUFFIX, TEST_PROTOCOL_GATEWAY_HOSTNAME);
+    (void)IoTHubTransportMqtt_WS_Create(&config, transport_cb_info, NULL);
+    umock_c_reset_all_calls();
+
+    coalescing_io_config.underlying_io = TEST_WSIO_HANDLE;
+
+    STRICT_EXPECTED_CALL(wsio_get_interface_description());
+    STRICT_EXPECTED_CALL(platform_get_default_tlsio());
+    STRICT_EXPECTED_CALL(xio_create(TEST_WSIO_INTERFACE_DESCRIPTION, IGNORED_PTR_ARG))
+        .SetReturn(TEST_WSIO_HANDLE);
+    STRICT_EXPECTED_CALL(coalescing_io_get_interface_description());
+    STRICT_EXPECTED_CALL(xio_create(TEST_COALESCING_IO_INTERFACE_DESCRIPTION, &coalescing_io_config))
+        .ValidateArgumentBuffer(2, &coalescing_io_config, sizeof(coalescing_io_config));
+
+    // act
+    xioTest = g_get_io_transport(TEST_STRING_VALUE, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(void_ptr, TEST_XIO_HANDLE, xioTest);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUB_MQTT_WEBSOCKET_TRANSPORT_41_002: [ If the coalescing IO cannot be created, `getIoTransportProvider` shall return the WebSocket IO. ]*/
+TEST_FUNCTION(IoTHubTransportMqtt_WS_getWebSocketsIOTransport_returns_the_WebSocket_IO_when_the_coalescing_IO_fails)
+{
+    // arrange
+    IOTHUBTRANSPORT_CONFIG config = { 0 };
+    XIO_HANDLE xioTest;
+    SetupIothubTransportConfig(&config, TEST_DEVICE_ID, TEST_DEVICE_KEY, TEST_IOTHUB_NAME, TEST_IOTHUB_SUFFIX, TEST_PROTOCOL_GATEWAY_HOSTNAME);
+    (void)IoTHubTransportMqtt_WS_Create(&config, transport_cb_info, NULL);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(wsio_get_interface_description());
+    STRICT_EXPECTED_CALL(platform_get_default_tlsio());
+    STRICT_EXPECTED_CALL(xio_create(TEST_WSIO_INTERFACE_DESCRIPTION, IGNORED_PTR_ARG))
+        .SetReturn(TEST_WSIO_HANDLE);
+    STRICT_EXPECTED_CALL(coalescing_io_get_interface_description());
+    STRICT_EXPECTED_CALL(xio_create(TEST_COALESCING_IO_INTERFACE_DESCRIPTION, IGNORED_PTR_ARG))
+        .SetReturn(NULL);
+
+    // act
+    xioTest = g_get_io_transport(TEST_STRING_VALUE, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(void_ptr, TEST_WSIO_HANDLE, xioTest);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
 /* Tests_SRS_IOTHUB_MQTT_WEBSOCKET_TRANSPORT_01_015: [ - If `mqtt_transport_proxy_options` is not NULL, `underlying_io_interface` shall be set to the HTTP proxy IO interface description. ]*/
 /* Tests_SRS_IOTHUB_MQTT_WEBSOCKET_TRANSPORT_01_016: [ - If `mqtt_transport_proxy_options` is not NULL `underlying_io_parameters` shall be set to the HTTP proxy IO arguments. ]*/
 /* Tests_SRS_IOTHUB_MQTT_WEBSOCKET_TRANSPORT_01_022: [ `getIoTransportProvider` shall obtain the HTTP proxy IO interface handle by calling `http_proxy_io_get_interface_description`. ]*/
@@ -824,6 +885,8 @@ TEST_FUNCTION(IoTHubTransportMqtt_WS_getWebSocketsIOTransport_with_proxy_setting
     STRICT_EXPECTED_CALL(http_proxy_io_get_interface_description());
     STRICT_EXPECTED_CALL(xio_create(TEST_WSIO_INTERFACE_DESCRIPTION, &wsio_config))
         .ValidateArgumentValue_io_create_parameters_AsType(UMOCK_TYPE(WSIO_CONFIG*));
+    STRICT_EXPECTED_CALL(coalescing_io_get_interface_description());
+    STRICT_EXPECTED_CALL(xio_create(TEST_COALESCING_IO_INTERFACE_DESCRIPTION, IGNORED_PTR_ARG));
 
     ASSERT_IS_NOT_NULL(g_get_io_transport);
 
@@ -879,6 +942,8 @@ TEST_FUNCTION(when_socket_io_interface_is_NULL_getWebSocketsIOTransport_with_pro
         .SetReturn(NULL);
     STRICT_EXPECTED_CALL(xio_create(TEST_WSIO_INTERFACE_DESCRIPTION, &wsio_config))
         .ValidateArgumentValue_io_create_parameters_AsType(UMOCK_TYPE(WSIO_CONFIG*));
+    STRICT_EXPECTED_CALL(coalescing_io_get_interface_description());
+    STRICT_EXPECTED_CALL(xio_create(TEST_COALESCING_IO_INTERFACE_DESCRIPTION, IGNORED_PTR_ARG));
 
     ASSERT_IS_NOT_NULL(g_get_io_transport);
 
@@ -919,6 +984,8 @@ TEST_FUNCTION(when_tlsio_interface_is_NULL_getWebSocketsIOTransport_with_proxy_s
         .SetReturn(NULL);
     STRICT_EXPECTED_CALL(xio_create(TEST_WSIO_INTERFACE_DESCRIPTION, &wsio_config))
         .ValidateArgumentValue_io_create_parameters_AsType(UMOCK_TYPE(WSIO_CONFIG*));
+    STRICT_EXPECTED_CALL(coalescing_io_get_interface_description());
+    STRICT_EXPECTED_CALL(xio_create(TEST_COALESCING_IO_INTERFACE_DESCRIPTION, IGNORED_PTR_ARG));
 
     ASSERT_IS_NOT_NULL(g_get_io_transport);
 
@@ -953,6 +1020,8 @@ TEST_FUNCTION(when_tlsio_interface_is_NULL_getWebSocketsIOTransport_with_NULL_pr
         .SetReturn(NULL);
     STRICT_EXPECTED_CALL(xio_create(TEST_WSIO_INTERFACE_DESCRIPTION, &wsio_config))
         .ValidateArgumentValue_io_create_parameters_AsType(UMOCK_TYPE(WSIO_CONFIG*));
+    STRICT_EXPECTED_CALL(coalescing_io_get_interface_description());
+    STRICT_EXPECTED_CALL(xio_create(TEST_COALESCING_IO_INTERFACE_DESCRIPTION, IGNORED_PTR_ARG));
 
     ASSERT_IS_NOT_NULL(g_get_io_transport);
 
@@ -41,12 +41,17 @@ void real_free(void* ptr)
 #define ENABLE_MOCKS
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/optionhandler.h"
-#include "azure_c_shared_utility/agenttime.h"
+#include "azure_c_shared_utility/tickcounter.h"
 #include "azure_c_shared_utility/singlylinkedlist.h"
+#include "internal/iothub_client_memory_private.h"
+#include "internal/iothub_client_retry_control.h"
 #undef ENABLE_MOCKS
 
 #include "internal/message_queue.h"
 
+/*nothing is counted unless IoTHub_Init starts the memory accounting*/
+bool g_iothub_client_memory_accounting = false;
+
 static TEST_MUTEX_HANDLE g_testByTest;
 
 DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
@@ -61,7 +66,6 @@ static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
 
 // Data definitions
 
-#define INDEFINITE_TIME                     ((time_t)-1)
 #define TEST_OPTIONHANDLER_HANDLE           (OPTIONHANDLER_HANDLE)0x7771
 #define TEST_PROCESS_MESSAGE_CONTEXT        (void*)0x7772
 #define TEST_PROCESS_COMPLETE_CONTEXT       (void*)0x7773
@@ -72,10 +76,17 @@ static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
 #define TEST_LIST_ITEM_HANDLE               (LIST_ITEM_HANDLE)0x7779
 #define TEST_LIST_ITEM_VALUE                (void*)0x7780
 #define TEST_REASON                         (void*)0x7781
+#define TEST_RETRY_CONTROL_HANDLE           (RETRY_CONTROL_HANDLE)0x7782
+#define TEST_TICK_COUNTER_HANDLE            (TICK_COUNTER_HANDLE)0x7783
 
 
 static MQ_MESSAGE_HANDLE TEST_BASE_MQ_MESSAGE_HANDLE[10];
-static time_t TEST_current_time;
+// More in-progress messages than fit in the initial in-progress index (16 entries, grown past 3/4 full),
+// but few enough for saved_malloc_returns.
+#define TEST_INDEX_GROWTH_MESSAGE_COUNT 14
+static tickcounter_ms_t TEST_current_time;
+// What tickcounter_get_current_ms returns; set by the helpers that expect the calls
+static tickcounter_ms_t TEST_tickcounter_current_ms;
 
 
 typedef struct TEST_MESSAGE_EXPIRATION_PROFILE_TAG
@@ -129,6 +140,16 @@ static OPTIONHANDLER_RESULT TEST_OptionHandler_AddOption(OPTIONHANDLER_HANDLE ha
     return TEST_OptionHandler_AddOption_result;
 }
 
+static unsigned int TEST_retry_control_get_wait_time_result;
+static int TEST_retry_control_get_wait_time(RETRY_CONTROL_HANDLE retry_control_handle, unsigned int retry_count, unsigned int previous_wait_time_in_secs, unsigned int* wait_time_in_secs)
+{
+    (void)retry_control_handle;
+    (void)retry_count;
+    (void)previous_wait_time_in_secs;
+    *wait_time_in_secs = TEST_retry_control_get_wait_time_result;
+    return 0;
+}
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -147,30 +168,38 @@ extern "C"
 }
 #endif
 
-static time_t add_seconds(time_t base_time, int seconds)
+static tickcounter_ms_t add_seconds(tickcounter_ms_t base_time, int seconds)
 {
-    time_t new_time;
-    struct tm *bd_new_time;
+    return base_time + (tickcounter_ms_t)seconds * 1000;
+}
 
-    if ((bd_new_time = localtime(&base_time)) == NULL)
-    {
-        new_time = INDEFINITE_TIME;
-    }
-    else
-    {
-        bd_new_time->tm_sec += seconds;
-        new_time = mktime(bd_new_time);
-    }
+static int my_tickcounter_get_current_ms(TICK_COUNTER_HANDLE tick_counter, tickcounter_ms_t* current_ms)
+{
+    (void)tick_counter;
+    *current_ms = TEST_tickcounter_current_ms;
+    return 0;
+}
 
-    return new_time;
+static void set_get_current_time_expected_call(tickcounter_ms_t current_time)
+{
+    TEST_tickcounter_current_ms = current_time;
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG));
 }
 
 static MESSAGE_QUEUE_HANDLE TEST_on_process_message_callback_message_queue;
 static MQ_MESSAGE_HANDLE TEST_on_process_message_callback_message;
 static PROCESS_MESSAGE_COMPLETED_CALLBACK TEST_on_process_message_callback_on_process_message_completed_callback;
 static void* TEST_on_process_message_callback_context;
+static MQ_MESSAGE_HANDLE TEST_on_process_message_callback_processing_order[10];
+static size_t TEST_on_process_message_callback_count;
 static void TEST_on_process_message_callback(MESSAGE_QUEUE_HANDLE message_queue, MQ_MESSAGE_HANDLE message, PROCESS_MESSAGE_COMPLETED_CALLBACK on_process_message_completed_callback, void* user_context)
 {
+    if (TEST_on_process_message_callback_count < 10)
+    {
+        TEST_on_process_message_callback_processing_order[TEST_on_process_message_callback_count] = message;
+    }
+    TEST_on_process_message_callback_count++;
+
     TEST_on_process_message_callback_message_queue = message_queue;
     TEST_on_process_message_callback_message = message;
     TEST_on_process_message_callback_on_process_message_completed_callback = on_process_message_completed_callback;
@@ -210,6 +239,18 @@ static void TEST_on_message_processing_completed_callback(MQ_MESSAGE_HANDLE mess
     }
 }
 
+static size_t TEST_get_message_size(MQ_MESSAGE_HANDLE message)
+{
+    (void)message;
+    return 4;
+}
+
+static void add_message_with_priority(MESSAGE_QUEUE_HANDLE mq, MQ_MESSAGE_HANDLE message, MESSAGE_QUEUE_PRIORITY priority)
+{
+    int result = message_queue_add_with_priority(mq, message, priority, TEST_on_message_processing_completed_callback, TEST_USER_CONTEXT);
+    ASSERT_ARE_EQUAL(int, 0, result, "failed adding message to queue");
+}
+
 static MESSAGE_QUEUE_CONFIG g_config;
 static MESSAGE_QUEUE_CONFIG* get_message_queue_config()
 {
@@ -226,6 +267,8 @@ static void set_message_queue_create_expected_calls()
     STRICT_EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(singlylinkedlist_create());
     STRICT_EXPECTED_CALL(singlylinkedlist_create());
+    STRICT_EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(tickcounter_create());
 }
 
 static void set_dequeue_message_and_fire_callback_expected_calls()
@@ -242,21 +285,20 @@ static void set_retry_sending_message_expected_calls()
     STRICT_EXPECTED_CALL(singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 }
 
-static void set_on_message_processing_completed_callback_expected_calls(int number_of_messages, int message_order_in_list, bool should_retry)
+static void set_retry_sending_message_with_backoff_expected_calls(unsigned int number_of_attempts, unsigned int previous_wait_time_in_secs, tickcounter_ms_t current_time)
 {
-    int i;
-
-    STRICT_EXPECTED_CALL(singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-
-    for (i = 0; i < number_of_messages; i++)
-    {
-        // Invoked by singlylinkedlist_find.
-        STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
-
-        if (i == message_order_in_list) break;
-    }
+    STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(retry_control_get_wait_time(TEST_RETRY_CONTROL_HANDLE, number_of_attempts, previous_wait_time_in_secs, IGNORED_PTR_ARG));
+    set_get_current_time_expected_call(current_time);
+    STRICT_EXPECTED_CALL(singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+}
 
-    if (i == message_order_in_list)
+static void set_on_message_processing_completed_callback_expected_calls(int number_of_messages, int message_order_in_list, bool should_retry)
+{
+    // The message is found through the in-progress index, so no list calls are made for the lookup.
+    if (message_order_in_list >= 0 && message_order_in_list < number_of_messages)
     {
         STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
 
@@ -299,16 +341,28 @@ static void set_message_queue_destroy_expected_calls(size_t number_of_messages_p
     STRICT_EXPECTED_CALL(singlylinkedlist_destroy(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(singlylinkedlist_destroy(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(tickcounter_destroy(TEST_TICK_COUNTER_HANDLE));
+    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
 }
 
-static void set_message_queue_add_expected_calls(time_t current_time)
+static void set_message_queue_add_expected_calls(tickcounter_ms_t current_time)
 {
     STRICT_EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(current_time);
+    set_get_current_time_expected_call(current_time);
     STRICT_EXPECTED_CALL(singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 }
 
-static void add_messages(MESSAGE_QUEUE_HANDLE mq, size_t number_of_messages, time_t current_time)
+static void set_message_queue_add_with_priority_expected_calls(tickcounter_ms_t current_time, bool should_create_list)
+{
+    if (should_create_list)
+    {
+        STRICT_EXPECTED_CALL(singlylinkedlist_create());
+    }
+
+    set_message_queue_add_expected_calls(current_time);
+}
+
+static void add_messages(MESSAGE_QUEUE_HANDLE mq, size_t number_of_messages, tickcounter_ms_t current_time)
 {
     size_t i;
     for (i = 0; i < number_of_messages; i++)
@@ -333,13 +387,13 @@ static MESSAGE_QUEUE_HANDLE create_message_queue(MESSAGE_QUEUE_CONFIG* config)
     return message_queue_create(config);
 }
 
-static void set_process_timeouts_expected_calls(MESSAGE_QUEUE_HANDLE mq, time_t current_time,
+static void set_process_timeouts_expected_calls(MESSAGE_QUEUE_HANDLE mq, tickcounter_ms_t current_time,
     size_t number_of_messages_pending, size_t number_of_messages_in_progress,
     TEST_MESSAGE_EXPIRATION_PROFILE* expiration_profile
     )
 {
     (void)mq;
-    STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(current_time);
+    set_get_current_time_expected_call(current_time);
 
     if (expiration_profile->max_message_enqueued_time_secs > 0)
     {
@@ -355,38 +409,45 @@ static void set_process_timeouts_expected_calls(MESSAGE_QUEUE_HANDLE mq, time_t
 
             if (j < expiration_profile->expired_pending_messages_size && i == expiration_profile->expired_pending_messages[j])
             {
-                STRICT_EXPECTED_CALL(get_difftime(IGNORED_NUM_ARG, IGNORED_NUM_ARG)).SetReturn(expiration_profile->max_message_enqueued_time_secs + 1);
                 set_dequeue_message_and_fire_callback_expected_calls();
                 number_of_messages_pending--;
                 j++;
             }
             else
             {
-                STRICT_EXPECTED_CALL(get_difftime(IGNORED_NUM_ARG, IGNORED_NUM_ARG)).SetReturn(0);
                 break;
             }
         }
 
-        // in progress messages, max queued time
-        STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
-
-        for (i = 0, j = 0; i < number_of_messages_in_progress; i++)
+        // in progress messages, max queued time (only walked if the earliest enqueue time has expired)
+        if (number_of_messages_in_progress > 0)
         {
-            STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
-            STRICT_EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
+            bool any_expired = (expiration_profile->expired_enqueued_in_progress_messages_size > 0);
+            size_t number_of_messages_in_progress_remaining = number_of_messages_in_progress;
 
-            if (j < expiration_profile->expired_enqueued_in_progress_messages_size && i == expiration_profile->expired_enqueued_in_progress_messages[j])
-            {
-                STRICT_EXPECTED_CALL(get_difftime(IGNORED_NUM_ARG, IGNORED_NUM_ARG)).SetReturn(expiration_profile->max_message_enqueued_time_secs + 1);
-                set_dequeue_message_and_fire_callback_expected_calls();
-                //set_dequeue_message_and_fire_callback_expected_calls(number_of_messages_in_progress, expiration_profile->expired_enqueued_in_progress_messages[j] - i, false);
-                number_of_messages_in_progress--;
-                j++;
-            }
-            else
+
+            if (any_expired)
             {
-                STRICT_EXPECTED_CALL(get_difftime(IGNORED_NUM_ARG, IGNORED_NUM_ARG)).SetReturn(0);
+                STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
+
+                for (i = 0, j = 0; i < number_of_messages_in_progress; i++)
+                {
+                    STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+                    STRICT_EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
+
+                    if (j < expiration_profile->expired_enqueued_in_progress_messages_size && i == expiration_profile->expired_enqueued_in_progress_messages[j])
+                    {
+                        set_dequeue_message_and_fire_callback_expected_calls();
+                        number_of_messages_in_progress_remaining--;
+                        j++;
+                    }
+                    else
+                    {
+                    }
+                }
             }
+
+            number_of_messages_in_progress = number_of_messages_in_progress_remaining;
         }
     }
 
@@ -404,21 +465,19 @@ static void set_process_timeouts_expected_calls(MESSAGE_QUEUE_HANDLE mq, time_t
 
             if (j < expiration_profile->expired_in_progress_messages_size && i == expiration_profile->expired_in_progress_messages[j])
             {
-                STRICT_EXPECTED_CALL(get_difftime(IGNORED_NUM_ARG, IGNORED_NUM_ARG)).SetReturn(expiration_profile->max_message_processing_time_secs + 1);
                 set_dequeue_message_and_fire_callback_expected_calls();
                 number_of_messages_in_progress--;
                 j++;
             }
             else
             {
-                STRICT_EXPECTED_CALL(get_difftime(IGNORED_NUM_ARG, IGNORED_NUM_ARG)).SetReturn(0);
                 break;
             }
         }
     }
 }
 
-static void set_process_pending_messages_calls(MESSAGE_QUEUE_HANDLE mq, time_t current_time, size_t number_of_messages_pending)
+static void set_process_pending_messages_calls(MESSAGE_QUEUE_HANDLE mq, tickcounter_ms_t current_time, size_t number_of_messages_pending)
 {
     (void)mq;
     STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
@@ -429,14 +488,14 @@ static void set_process_pending_messages_calls(MESSAGE_QUEUE_HANDLE mq, time_t c
     {
         STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
         STRICT_EXPECTED_CALL(singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-        STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(current_time);
+        set_get_current_time_expected_call(current_time);
         STRICT_EXPECTED_CALL(singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 
         STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
     }
 }
 
-static void set_message_queue_do_work_expected_calls(MESSAGE_QUEUE_HANDLE mq, time_t current_time,
+static void set_message_queue_do_work_expected_calls(MESSAGE_QUEUE_HANDLE mq, tickcounter_ms_t current_time,
     size_t number_of_messages_pending, size_t number_of_messages_in_progress,
     TEST_MESSAGE_EXPIRATION_PROFILE* expiration_profile)
 {
@@ -444,7 +503,7 @@ static void set_message_queue_do_work_expected_calls(MESSAGE_QUEUE_HANDLE mq, ti
     set_process_pending_messages_calls(mq, current_time, number_of_messages_pending);
 }
 
-static void crank_message_queue(MESSAGE_QUEUE_HANDLE mq, time_t current_time,
+static void crank_message_queue(MESSAGE_QUEUE_HANDLE mq, tickcounter_ms_t current_time,
     size_t number_of_messages_pending, size_t number_of_messages_in_progress,
     TEST_MESSAGE_EXPIRATION_PROFILE* expiration_profile)
 {
@@ -480,7 +539,7 @@ static void set_message_queue_retrieve_options_expected_calls()
 
 static void reset_test_data()
 {
-    TEST_current_time = time(NULL);
+    TEST_current_time = 1000;
 
     saved_malloc_returns_count = 0;
     memset(saved_malloc_returns, 0, sizeof(saved_malloc_returns));
@@ -488,10 +547,14 @@ static void reset_test_data()
     TEST_OptionHandler_AddOption_saved_value = 0;
     TEST_OptionHandler_AddOption_result = OPTIONHANDLER_OK;
 
+    TEST_retry_control_get_wait_time_result = 0;
+
     TEST_on_process_message_callback_message_queue = NULL;
     TEST_on_process_message_callback_message = NULL;
     TEST_on_process_message_callback_on_process_message_completed_callback = NULL;
     TEST_on_process_message_callback_context = NULL;
+    memset(TEST_on_process_message_callback_processing_order, 0, sizeof(TEST_on_process_message_callback_processing_order));
+    TEST_on_process_message_callback_count = 0;
 
     TEST_on_message_processing_completed_callback_message = NULL;
     TEST_on_message_processing_completed_callback_result = MESSAGE_QUEUE_SUCCESS;
@@ -514,7 +577,7 @@ static void reset_test_data()
 
 static void register_umock_alias_types()
 {
-    REGISTER_UMOCK_ALIAS_TYPE(time_t, long long);
+    REGISTER_UMOCK_ALIAS_TYPE(TICK_COUNTER_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(OPTIONHANDLER_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(OPTIONHANDLER_RESULT, int);
     REGISTER_UMOCK_ALIAS_TYPE(pfCloneOption, void*);
@@ -524,6 +587,8 @@ static void register_umock_alias_types()
     REGISTER_UMOCK_ALIAS_TYPE(LIST_ITEM_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(LIST_MATCH_FUNCTION, void*);
     REGISTER_UMOCK_ALIAS_TYPE(MQ_MESSAGE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(RETRY_CONTROL_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_RETRY_POLICY, int);
 }
 
 static void register_global_mock_hooks()
@@ -531,6 +596,8 @@ static void register_global_mock_hooks()
     REGISTER_GLOBAL_MOCK_HOOK(malloc, TEST_malloc);
     REGISTER_GLOBAL_MOCK_HOOK(free, TEST_free);
     REGISTER_GLOBAL_MOCK_HOOK(OptionHandler_AddOption, TEST_OptionHandler_AddOption);
+    REGISTER_GLOBAL_MOCK_HOOK(retry_control_get_wait_time, TEST_retry_control_get_wait_time);
+    REGISTER_GLOBAL_MOCK_HOOK(tickcounter_get_current_ms, my_tickcounter_get_current_ms);
     REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_create, real_singlylinkedlist_create);
     REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_destroy, real_singlylinkedlist_destroy);
     REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_add, real_singlylinkedlist_add);
@@ -564,7 +631,13 @@ static void register_global_mock_returns()
     REGISTER_GLOBAL_MOCK_RETURN(singlylinkedlist_item_get_value, TEST_LIST_ITEM_VALUE);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(singlylinkedlist_item_get_value, NULL);
 
-    REGISTER_GLOBAL_MOCK_FAIL_RETURN(get_time, INDEFINITE_TIME);
+    REGISTER_GLOBAL_MOCK_RETURN(tickcounter_create, TEST_TICK_COUNTER_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(tickcounter_create, NULL);
+
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(tickcounter_get_current_ms, 1);
+
+    REGISTER_GLOBAL_MOCK_RETURN(retry_control_create, TEST_RETRY_CONTROL_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(retry_control_create, NULL);
 }
 
 
@@ -672,6 +745,8 @@ TEST_FUNCTION(create_NULL_on_process_message_callback)
 // Tests_SRS_MESSAGE_QUEUE_09_007: [If singlylinkedlist_create fails, message_queue_create shall fail and return NULL]
 // Tests_SRS_MESSAGE_QUEUE_09_009: [If singlylinkedlist_create fails, message_queue_create shall fail and return NULL]
 // Tests_SRS_MESSAGE_QUEUE_09_011: [If any failures occur, message_queue_create shall release all memory it has allocated]
+// Tests_SRS_MESSAGE_QUEUE_41_010: [If the in-progress index cannot be allocated, message_queue_create shall fail and return NULL]
+// Tests_SRS_MESSAGE_QUEUE_41_039: [If tickcounter_create fails, message_queue_create shall fail and return NULL]
 TEST_FUNCTION(create_failure_checks)
 {
     // arrange
@@ -709,6 +784,7 @@ TEST_FUNCTION(create_failure_checks)
 // Tests_SRS_MESSAGE_QUEUE_09_008: [`message_queue->in_progress` shall be set using singlylinkedlist_create()]
 // Tests_SRS_MESSAGE_QUEUE_09_010: [All arguments in `config` shall be saved into `message_queue`]
 // Tests_SRS_MESSAGE_QUEUE_09_012: [If no failures occur, message_queue_create shall return the `message_queue` pointer]
+// Tests_SRS_MESSAGE_QUEUE_41_009: [The in-progress index shall be allocated with IN_PROGRESS_INDEX_INITIAL_SIZE entries using malloc()]
 TEST_FUNCTION(create_success)
 {
     // arrange
@@ -843,7 +919,7 @@ TEST_FUNCTION(add_NULL_message_handle)
 }
 
 // Tests_SRS_MESSAGE_QUEUE_09_017: [message_queue_add shall allocate a structure (aka `mq_item`) to save the `message`]
-// Tests_SRS_MESSAGE_QUEUE_09_019: [`mq_item->enqueue_time` shall be set using get_time()]
+// Tests_SRS_MESSAGE_QUEUE_09_019: [`mq_item->enqueue_time` shall be set using tickcounter_get_current_ms()]
 // Tests_SRS_MESSAGE_QUEUE_09_021: [`mq_item` shall be added to `message_queue->pending` list]
 // Tests_SRS_MESSAGE_QUEUE_09_023: [`message` shall be saved into `mq_item->message`]
 // Tests_SRS_MESSAGE_QUEUE_09_025: [If no failures occur, message_queue_add shall return 0]
@@ -867,7 +943,7 @@ TEST_FUNCTION(add_success)
 }
 
 // Tests_SRS_MESSAGE_QUEUE_09_018: [If `mq_item` cannot be allocated, message_queue_add shall fail and return non-zero]
-// Tests_SRS_MESSAGE_QUEUE_09_020: [If get_time fails, message_queue_add shall fail and return non-zero]
+// Tests_SRS_MESSAGE_QUEUE_09_020: [If tickcounter_get_current_ms fails, message_queue_add shall fail and return non-zero]
 // Tests_SRS_MESSAGE_QUEUE_09_022: [`mq_item` fails to be added to `message_queue->pending`, message_queue_add shall fail and return non-zero]
 // Tests_SRS_MESSAGE_QUEUE_09_024: [If any failures occur, message_queue_add shall release all memory it has allocated]
 TEST_FUNCTION(add_failure_checks)
@@ -903,6 +979,68 @@ TEST_FUNCTION(add_failure_checks)
 }
 
 
+// Tests_SRS_MESSAGE_QUEUE_41_001: [If `priority` is not a valid MESSAGE_QUEUE_PRIORITY, message_queue_add_with_priority shall fail and return non-zero]
+TEST_FUNCTION(add_with_priority_invalid_priority)
+{
+    // arrange
+    MESSAGE_QUEUE_HANDLE mq = create_message_queue(USE_DEFAULT_CONFIG);
+
+    umock_c_reset_all_calls();
+
+    // act
+    int result = message_queue_add_with_priority(mq, TEST_BASE_MQ_MESSAGE_HANDLE[0], (MESSAGE_QUEUE_PRIORITY)(MESSAGE_QUEUE_PRIORITY_HIGH + 1), TEST_on_message_processing_completed_callback, TEST_USER_CONTEXT);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+    // cleanup
+    message_queue_destroy(mq);
+}
+
+// Tests_SRS_MESSAGE_QUEUE_41_002: [The pending list of `priority` shall be created using singlylinkedlist_create() when the first message of that priority is added]
+TEST_FUNCTION(add_with_priority_HIGH_success)
+{
+    // arrange
+    MESSAGE_QUEUE_HANDLE mq = create_message_queue(USE_DEFAULT_CONFIG);
+
+    umock_c_reset_all_calls();
+    set_message_queue_add_with_priority_expected_calls(TEST_current_time, true);
+    set_message_queue_add_with_priority_expected_calls(TEST_current_time, false);
+
+    // act
+    int result1 = message_queue_add_with_priority(mq, TEST_BASE_MQ_MESSAGE_HANDLE[0], MESSAGE_QUEUE_PRIORITY_HIGH, TEST_on_message_processing_completed_callback, TEST_USER_CONTEXT);
+    int result2 = message_queue_add_with_priority(mq, TEST_BASE_MQ_MESSAGE_HANDLE[1], MESSAGE_QUEUE_PRIORITY_HIGH, TEST_on_message_processing_completed_callback, TEST_USER_CONTEXT);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result1);
+    ASSERT_ARE_EQUAL(int, 0, result2);
+
+    // cleanup
+    message_queue_destroy(mq);
+}
+
+// Tests_SRS_MESSAGE_QUEUE_41_002: [The pending list of `priority` shall be created using singlylinkedlist_create() when the first message of that priority is added]
+TEST_FUNCTION(add_with_priority_LOW_create_list_fails)
+{
+    // arrange
+    MESSAGE_QUEUE_HANDLE mq = create_message_queue(USE_DEFAULT_CONFIG);
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(singlylinkedlist_create()).SetReturn(NULL);
+
+    // act
+    int result = message_queue_add_with_priority(mq, TEST_BASE_MQ_MESSAGE_HANDLE[0], MESSAGE_QUEUE_PRIORITY_LOW, TEST_on_message_processing_completed_callback, TEST_USER_CONTEXT);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+    // cleanup
+    message_queue_destroy(mq);
+}
+
 // Tests_SRS_MESSAGE_QUEUE_09_030: [If `message_queue` or `is_empty` are NULL, message_queue_is_empty shall fail and return non-zero]
 TEST_FUNCTION(is_empty_NULL_handle)
 {
@@ -1040,6 +1178,122 @@ TEST_FUNCTION(is_empty_1_pending_1_in_progress_success)
     message_queue_destroy(mq);
 }
 
+// Tests_SRS_MESSAGE_QUEUE_41_011: [If `message_queue` or `count` are NULL, message_queue_get_in_progress_count shall fail and return non-zero]
+TEST_FUNCTION(get_in_progress_count_NULL_handle)
+{
+    // arrange
+    size_t count;
+
+    umock_c_reset_all_calls();
+
+    // act
+    int result = message_queue_get_in_progress_count(NULL, &count);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+    // cleanup
+}
+
+// Tests_SRS_MESSAGE_QUEUE_41_011: [If `message_queue` or `count` are NULL, message_queue_get_in_progress_count shall fail and return non-zero]
+TEST_FUNCTION(get_in_progress_count_NULL_count)
+{
+    // arrange
+    MESSAGE_QUEUE_HANDLE mq = create_message_queue(USE_DEFAULT_CONFIG);
+
+    umock_c_reset_all_calls();
+
+    // act
+    int result = message_queue_get_in_progress_count(mq, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+    // cleanup
+    message_queue_destroy(mq);
+}
+
+// Tests_SRS_MESSAGE_QUEUE_41_012: [`count` shall be set to the number of messages in `message_queue->in_progress` and message_queue_get_in_progress_count shall return 0]
+TEST_FUNCTION(get_in_progress_count_success)
+{
+    // arrange
+    size_t count_before;
+    size_t count_in_progress;
+    size_t count_after;
+    MESSAGE_QUEUE_HANDLE mq = create_message_queue(USE_DEFAULT_CONFIG);
+
+    add_messages(mq, 3, TEST_current_time);
+    (void)message_queue_get_in_progress_count(mq, &count_before);
+    crank_message_queue(mq, TEST_current_time, 3, 0, NULL);
+    add_messages(mq, 1, TEST_current_time);
+
+    umock_c_reset_all_calls();
+
+    // act
+    int result1 = message_queue_get_in_progress_count(mq, &count_in_progress);
+    TEST_on_process_message_callback_on_process_message_completed_callback(mq, TEST_BASE_MQ_MESSAGE_HANDLE[1], MESSAGE_QUEUE_SUCCESS, NULL);
+    int result2 = message_queue_get_in_progress_count(mq, &count_after);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result1);
+    ASSERT_ARE_EQUAL(int, 0, result2);
+    ASSERT_ARE_EQUAL(size_t, 0, count_before);
+    ASSERT_ARE_EQUAL(size_t, 3, count_in_progress);
+    ASSERT_ARE_EQUAL(size_t, 2, count_after);
+    ASSERT_ARE_EQUAL(void_ptr, (void_ptr)TEST_BASE_MQ_MESSAGE_HANDLE[1], (void_ptr)TEST_on_message_processing_completed_callback_message);
+
+    // cleanup
+    message_queue_destroy(mq);
+}
+
+// Tests_SRS_MESSAGE_QUEUE_41_007: [`message` shall be looked up in `message_queue->in_progress` through the in-progress index, without scanning the list]
+// Tests_SRS_MESSAGE_QUEUE_41_008: [`mq_item` shall be added to the in-progress index, which shall be doubled in size using malloc() when it becomes more than 3/4 full]
+TEST_FUNCTION(on_message_processing_completed_callback_out_of_order_after_index_growth)
+{
+    // arrange
+    MQ_MESSAGE_HANDLE messages[TEST_INDEX_GROWTH_MESSAGE_COUNT];
+    size_t count;
+    size_t i;
+    MESSAGE_QUEUE_HANDLE mq = create_message_queue(USE_DEFAULT_CONFIG);
+
+    for (i = 0; i < TEST_INDEX_GROWTH_MESSAGE_COUNT; i++)
+    {
+        messages[i] = (MQ_MESSAGE_HANDLE)real_malloc(sizeof(char));
+        ASSERT_IS_NOT_NULL(messages[i]);
+        ASSERT_ARE_EQUAL(int, 0, message_queue_add(mq, messages[i], TEST_on_message_processing_completed_callback, TEST_USER_CONTEXT));
+    }
+
+    message_queue_do_work(mq);
+
+    umock_c_reset_all_calls();
+
+    // act
+    for (i = 0; i < TEST_INDEX_GROWTH_MESSAGE_COUNT; i += 2)
+    {
+        TEST_on_process_message_callback_on_process_message_completed_callback(mq, messages[TEST_INDEX_GROWTH_MESSAGE_COUNT - 1 - i], MESSAGE_QUEUE_SUCCESS, NULL);
+    }
+
+    for (i = 1; i < TEST_INDEX_GROWTH_MESSAGE_COUNT; i += 2)
+    {
+        TEST_on_process_message_callback_on_process_message_completed_callback(mq, messages[TEST_INDEX_GROWTH_MESSAGE_COUNT - 1 - i], MESSAGE_QUEUE_SUCCESS, NULL);
+    }
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, message_queue_get_in_progress_count(mq, &count));
+    ASSERT_ARE_EQUAL(size_t, 0, count);
+    ASSERT_ARE_EQUAL(size_t, TEST_INDEX_GROWTH_MESSAGE_COUNT, TEST_on_message_processing_completed_callback_SUCCESS_result_count);
+
+    // cleanup
+    message_queue_destroy(mq);
+
+    for (i = 0; i < TEST_INDEX_GROWTH_MESSAGE_COUNT; i++)
+    {
+        real_free(messages[i]);
+    }
+}
+
 // Tests_SRS_MESSAGE_QUEUE_09_034: [If `message_queue` is NULL, message_queue_do_work shall return immediately]
 TEST_FUNCTION(do_work_NULL_handle)
 {
@@ -1056,7 +1310,7 @@ TEST_FUNCTION(do_work_NULL_handle)
 }
 
 // Tests_SRS_MESSAGE_QUEUE_09_039: [Each `mq_item` in `message_queue->pending` shall be moved to `message_queue->in_progress`]
-// Tests_SRS_MESSAGE_QUEUE_09_040: [`mq_item->processing_start_time` shall be set using get_time()]
+// Tests_SRS_MESSAGE_QUEUE_09_040: [`mq_item->processing_start_time` shall be set using tickcounter_get_current_ms()]
 // Tests_SRS_MESSAGE_QUEUE_09_043: [If no failures occur, `message_queue->on_process_message_callback` shall be invoked passing `mq_item->message` and `on_process_message_completed_callback`]
 TEST_FUNCTION(do_work_NO_EXPIRATION_success)
 {
@@ -1081,7 +1335,56 @@ TEST_FUNCTION(do_work_NO_EXPIRATION_success)
     message_queue_destroy(mq);
 }
 
-// Tests_SRS_MESSAGE_QUEUE_09_041: [If get_time() fails, `mq_item` shall be removed from `message_queue->in_progress`]
+// Tests_SRS_MESSAGE_QUEUE_41_003: [message_queue_do_work shall process all pending messages of a priority before any pending message of a lower priority]
+TEST_FUNCTION(do_work_processes_HIGH_before_NORMAL_before_LOW)
+{
+    // arrange
+    MESSAGE_QUEUE_HANDLE mq = create_message_queue(USE_DEFAULT_CONFIG);
+
+    ASSERT_ARE_EQUAL(int, 0, message_queue_add_with_priority(mq, TEST_BASE_MQ_MESSAGE_HANDLE[0], MESSAGE_QUEUE_PRIORITY_LOW, TEST_on_message_processing_completed_callback, TEST_USER_CONTEXT));
+    ASSERT_ARE_EQUAL(int, 0, message_queue_add_with_priority(mq, TEST_BASE_MQ_MESSAGE_HANDLE[1], MESSAGE_QUEUE_PRIORITY_NORMAL, TEST_on_message_processing_completed_callback, TEST_USER_CONTEXT));
+    ASSERT_ARE_EQUAL(int, 0, message_queue_add_with_priority(mq, TEST_BASE_MQ_MESSAGE_HANDLE[2], MESSAGE_QUEUE_PRIORITY_HIGH, TEST_on_message_processing_completed_callback, TEST_USER_CONTEXT));
+    ASSERT_ARE_EQUAL(int, 0, message_queue_add_with_priority(mq, TEST_BASE_MQ_MESSAGE_HANDLE[3], MESSAGE_QUEUE_PRIORITY_HIGH, TEST_on_message_processing_completed_callback, TEST_USER_CONTEXT));
+
+    umock_c_reset_all_calls();
+
+    // act
+    message_queue_do_work(mq);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 4, TEST_on_process_message_callback_count);
+    ASSERT_ARE_EQUAL(void_ptr, (void_ptr)TEST_BASE_MQ_MESSAGE_HANDLE[2], (void_ptr)TEST_on_process_message_callback_processing_order[0]);
+    ASSERT_ARE_EQUAL(void_ptr, (void_ptr)TEST_BASE_MQ_MESSAGE_HANDLE[3], (void_ptr)TEST_on_process_message_callback_processing_order[1]);
+    ASSERT_ARE_EQUAL(void_ptr, (void_ptr)TEST_BASE_MQ_MESSAGE_HANDLE[1], (void_ptr)TEST_on_process_message_callback_processing_order[2]);
+    ASSERT_ARE_EQUAL(void_ptr, (void_ptr)TEST_BASE_MQ_MESSAGE_HANDLE[0], (void_ptr)TEST_on_process_message_callback_processing_order[3]);
+
+    // cleanup
+    message_queue_destroy(mq);
+}
+
+// Tests_SRS_MESSAGE_QUEUE_09_032: [Otherwise `is_empty` shall be set to false]
+TEST_FUNCTION(is_empty_HIGH_pending_only_success)
+{
+    // arrange
+    MESSAGE_QUEUE_HANDLE mq = create_message_queue(USE_DEFAULT_CONFIG);
+
+    ASSERT_ARE_EQUAL(int, 0, message_queue_add_with_priority(mq, TEST_BASE_MQ_MESSAGE_HANDLE[0], MESSAGE_QUEUE_PRIORITY_HIGH, TEST_on_message_processing_completed_callback, TEST_USER_CONTEXT));
+
+    umock_c_reset_all_calls();
+
+    // act
+    bool is_empty;
+    int result = message_queue_is_empty(mq, &is_empty);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_IS_FALSE(is_empty);
+
+    // cleanup
+    message_queue_destroy(mq);
+}
+
+// Tests_SRS_MESSAGE_QUEUE_09_041: [If tickcounter_get_current_ms() fails, `mq_item` shall be removed from `message_queue->in_progress`]
 // Tests_SRS_MESSAGE_QUEUE_09_042: [If any failures occur, `mq_item->on_message_processing_completed_callback` shall be invoked with MESSAGE_QUEUE_ERROR and `mq_item` freed]
 TEST_FUNCTION(do_work_NO_EXPIRATION_failure_checks)
 {
@@ -1141,14 +1444,14 @@ TEST_FUNCTION(do_work_NO_EXPIRATION_failure_checks)
     umock_c_negative_tests_deinit();
 }
 
-// Tests_SRS_MESSAGE_QUEUE_09_059: [If `message_queue` is NULL, message_queue_set_max_retry_count shall fail and return non-zero]
-TEST_FUNCTION(message_queue_set_max_retry_count_NULL_handle)
+// Tests_SRS_MESSAGE_QUEUE_41_015: [If `message_queue` is NULL or `policy` is not a valid MESSAGE_QUEUE_OVERFLOW_POLICY, message_queue_set_max_size shall fail and return non-zero]
+TEST_FUNCTION(message_queue_set_max_size_NULL_handle)
 {
     // arrange
     umock_c_reset_all_calls();
 
     // act
-    int result = message_queue_set_max_retry_count(NULL, 2);
+    int result = message_queue_set_max_size(NULL, 10, 0, MESSAGE_QUEUE_OVERFLOW_REJECT, NULL);
 
     // assert
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
@@ -1157,9 +1460,8 @@ TEST_FUNCTION(message_queue_set_max_retry_count_NULL_handle)
     // cleanup
 }
 
-// Tests_SRS_MESSAGE_QUEUE_09_060: [`max_retry_count` shall be saved into `message_queue->max_retry_count`]
-// Tests_SRS_MESSAGE_QUEUE_09_061: [If no failures occur, message_queue_set_max_retry_count shall return 0]
-TEST_FUNCTION(message_queue_set_max_retry_count_success)
+// Tests_SRS_MESSAGE_QUEUE_41_015: [If `message_queue` is NULL or `policy` is not a valid MESSAGE_QUEUE_OVERFLOW_POLICY, message_queue_set_max_size shall fail and return non-zero]
+TEST_FUNCTION(message_queue_set_max_size_invalid_policy)
 {
     // arrange
     MESSAGE_QUEUE_HANDLE mq = create_message_queue(USE_DEFAULT_CONFIG);
@@ -1167,79 +1469,93 @@ TEST_FUNCTION(message_queue_set_max_retry_count_success)
     umock_c_reset_all_calls();
 
     // act
-    int result = message_queue_set_max_retry_count(mq, 2);
+    int result = message_queue_set_max_size(mq, 10, 0, (MESSAGE_QUEUE_OVERFLOW_POLICY)(MESSAGE_QUEUE_OVERFLOW_DROP_LOWEST_PRIORITY + 1), NULL);
 
     // assert
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
-    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
 
     // cleanup
     message_queue_destroy(mq);
 }
 
-// Tests_SRS_MESSAGE_QUEUE_09_055: [If `message_queue` is NULL, message_queue_set_max_message_processing_time_secs shall fail and return non-zero]
-TEST_FUNCTION(message_queue_set_max_message_processing_time_secs_NULL_handle)
+// Tests_SRS_MESSAGE_QUEUE_41_016: [If `max_message_bytes` is greater than zero and `get_message_size` is NULL, message_queue_set_max_size shall fail and return non-zero]
+TEST_FUNCTION(message_queue_set_max_size_bytes_without_get_message_size)
 {
     // arrange
+    MESSAGE_QUEUE_HANDLE mq = create_message_queue(USE_DEFAULT_CONFIG);
+
     umock_c_reset_all_calls();
 
     // act
-    int result = message_queue_set_max_message_processing_time_secs(NULL, 60);
+    int result = message_queue_set_max_size(mq, 0, 1024, MESSAGE_QUEUE_OVERFLOW_REJECT, NULL);
 
     // assert
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
     ASSERT_ARE_NOT_EQUAL(int, 0, result);
 
     // cleanup
+    message_queue_destroy(mq);
 }
 
-// Tests_SRS_MESSAGE_QUEUE_09_057: [`seconds` shall be saved into `message_queue->max_message_processing_time_secs`]
-// Tests_SRS_MESSAGE_QUEUE_09_058: [If no failures occur, message_queue_set_max_message_processing_time_secs shall return 0]
-TEST_FUNCTION(message_queue_set_max_message_processing_time_secs_success)
+// Tests_SRS_MESSAGE_QUEUE_41_017: [Sizes of pending messages are only tracked while a maximum of bytes is set, so it shall not be set while messages are pending]
+TEST_FUNCTION(message_queue_set_max_size_bytes_with_pending_messages_fails)
 {
     // arrange
     MESSAGE_QUEUE_HANDLE mq = create_message_queue(USE_DEFAULT_CONFIG);
+    add_messages(mq, 1, TEST_current_time);
 
     umock_c_reset_all_calls();
 
     // act
-    int result = message_queue_set_max_message_processing_time_secs(mq, 60);
+    int result = message_queue_set_max_size(mq, 0, 1024, MESSAGE_QUEUE_OVERFLOW_REJECT, TEST_get_message_size);
 
     // assert
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
-    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
 
     // cleanup
     message_queue_destroy(mq);
 }
 
-// Tests_SRS_MESSAGE_QUEUE_09_051: [If `message_queue` is NULL, message_queue_set_max_message_enqueued_time_secs shall fail and return non-zero]
-TEST_FUNCTION(message_queue_set_max_message_enqueued_time_secs_NULL_handle)
+// Tests_SRS_MESSAGE_QUEUE_41_018: [The limits, `policy` and `get_message_size` shall be saved into `message_queue` and message_queue_set_max_size shall return 0; a limit of zero means unbounded]
+// Tests_SRS_MESSAGE_QUEUE_41_019: [If adding `message` would exceed the maximum pending count or bytes, message_queue_add shall apply `message_queue->overflow_policy`]
+// Tests_SRS_MESSAGE_QUEUE_41_021: [If `message_queue->overflow_policy` is MESSAGE_QUEUE_OVERFLOW_REJECT, message_queue_add shall fail and return non-zero]
+TEST_FUNCTION(add_max_count_REJECT)
 {
     // arrange
+    MESSAGE_QUEUE_HANDLE mq = create_message_queue(USE_DEFAULT_CONFIG);
+    ASSERT_ARE_EQUAL(int, 0, message_queue_set_max_size(mq, 2, 0, MESSAGE_QUEUE_OVERFLOW_REJECT, NULL));
+    add_messages(mq, 2, TEST_current_time);
+
     umock_c_reset_all_calls();
 
     // act
-    int result = message_queue_set_max_message_enqueued_time_secs(NULL, 60);
+    int result = message_queue_add(mq, TEST_BASE_MQ_MESSAGE_HANDLE[2], TEST_on_message_processing_completed_callback, TEST_USER_CONTEXT);
 
     // assert
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
     ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(int, 0, (int)TEST_on_message_processing_completed_callback_CANCELLED_result_count);
 
     // cleanup
+    message_queue_destroy(mq);
 }
 
-// Tests_SRS_MESSAGE_QUEUE_09_053: [`seconds` shall be saved into `message_queue->max_message_enqueued_time_secs`]
-// Tests_SRS_MESSAGE_QUEUE_09_054: [If no failures occur, message_queue_set_max_message_enqueued_time_secs shall return 0]
-TEST_FUNCTION(message_queue_set_max_message_enqueued_time_secs_success)
+// Tests_SRS_MESSAGE_QUEUE_41_019: [If adding `message` would exceed the maximum pending count or bytes, message_queue_add shall apply `message_queue->overflow_policy`]
+TEST_FUNCTION(add_max_count_does_not_count_in_progress_messages)
 {
     // arrange
     MESSAGE_QUEUE_HANDLE mq = create_message_queue(USE_DEFAULT_CONFIG);
+    ASSERT_ARE_EQUAL(int, 0, message_queue_set_max_size(mq, 1, 0, MESSAGE_QUEUE_OVERFLOW_REJECT, NULL));
+    add_messages(mq, 1, TEST_current_time);
+    crank_message_queue(mq, TEST_current_time, 1, 0, NULL);
 
     umock_c_reset_all_calls();
+    set_message_queue_add_expected_calls(TEST_current_time);
 
     // act
-    int result = message_queue_set_max_message_enqueued_time_secs(mq, 60);
+    int result = message_queue_add(mq, TEST_BASE_MQ_MESSAGE_HANDLE[1], TEST_on_message_processing_completed_callback, TEST_USER_CONTEXT);
 
     // assert
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
@@ -1249,9 +1565,380 @@ TEST_FUNCTION(message_queue_set_max_message_enqueued_time_secs_success)
     message_queue_destroy(mq);
 }
 
-
-// Tests_SRS_MESSAGE_QUEUE_09_062: [If `message_queue` is NULL, message_queue_retrieve_options shall fail and return NULL]
-TEST_FUNCTION(message_queue_retrieve_options_NULL_handle)
+// Tests_SRS_MESSAGE_QUEUE_41_022: [If `message_queue->overflow_policy` is MESSAGE_QUEUE_OVERFLOW_DROP_OLDEST, the pending message enqueued first shall be removed and its callback invoked with MESSAGE_QUEUE_CANCELLED, until `message` fits]
+TEST_FUNCTION(add_max_count_DROP_OLDEST)
+{
+    // arrange
+    MESSAGE_QUEUE_HANDLE mq = create_message_queue(USE_DEFAULT_CONFIG);
+    ASSERT_ARE_EQUAL(int, 0, message_queue_set_max_size(mq, 2, 0, MESSAGE_QUEUE_OVERFLOW_DROP_OLDEST, NULL));
+    add_message_with_priority(mq, TEST_BASE_MQ_MESSAGE_HANDLE[0], MESSAGE_QUEUE_PRIORITY_NORMAL);
+    add_message_with_priority(mq, TEST_BASE_MQ_MESSAGE_HANDLE[1], MESSAGE_QUEUE_PRIORITY_HIGH);
+
+    umock_c_reset_all_calls();
+
+    // act
+    int result = message_queue_add(mq, TEST_BASE_MQ_MESSAGE_HANDLE[2], TEST_on_message_processing_completed_callback, TEST_USER_CONTEXT);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(int, 1, (int)TEST_on_message_processing_completed_callback_CANCELLED_result_count);
+    ASSERT_ARE_EQUAL(void_ptr, (void_ptr)TEST_BASE_MQ_MESSAGE_HANDLE[0], (void_ptr)TEST_on_message_processing_completed_callback_message);
+
+    // cleanup
+    message_queue_destroy(mq);
+}
+
+// Tests_SRS_MESSAGE_QUEUE_41_023: [If `message_queue->overflow_policy` is MESSAGE_QUEUE_OVERFLOW_DROP_LOWEST_PRIORITY, the oldest pending message of the lowest priority not above `priority` shall be removed and its callback invoked with MESSAGE_QUEUE_CANCELLED, until `message` fits]
+TEST_FUNCTION(add_max_count_DROP_LOWEST_PRIORITY)
+{
+    // arrange
+    MESSAGE_QUEUE_HANDLE mq = create_message_queue(USE_DEFAULT_CONFIG);
+    ASSERT_ARE_EQUAL(int, 0, message_queue_set_max_size(mq, 2, 0, MESSAGE_QUEUE_OVERFLOW_DROP_LOWEST_PRIORITY, NULL));
+    add_message_with_priority(mq, TEST_BASE_MQ_MESSAGE_HANDLE[0], MESSAGE_QUEUE_PRIORITY_HIGH);
+    add_message_with_priority(mq, TEST_BASE_MQ_MESSAGE_HANDLE[1], MESSAGE_QUEUE_PRIORITY_LOW);
+
+    umock_c_reset_all_calls();
+
+    // act
+    int result = message_queue_add(mq, TEST_BASE_MQ_MESSAGE_HANDLE[2], TEST_on_message_processing_completed_callback, TEST_USER_CONTEXT);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(int, 1, (int)TEST_on_message_processing_completed_callback_CANCELLED_result_count);
+    ASSERT_ARE_EQUAL(void_ptr, (void_ptr)TEST_BASE_MQ_MESSAGE_HANDLE[1], (void_ptr)TEST_on_message_processing_completed_callback_message);
+
+    // cleanup
+    message_queue_destroy(mq);
+}
+
+// Tests_SRS_MESSAGE_QUEUE_41_024: [If no pending message can be removed and `message` still does not fit, message_queue_add shall fail and return non-zero]
+TEST_FUNCTION(add_max_count_DROP_LOWEST_PRIORITY_only_higher_priority_pending)
+{
+    // arrange
+    MESSAGE_QUEUE_HANDLE mq = create_message_queue(USE_DEFAULT_CONFIG);
+    ASSERT_ARE_EQUAL(int, 0, message_queue_set_max_size(mq, 2, 0, MESSAGE_QUEUE_OVERFLOW_DROP_LOWEST_PRIORITY, NULL));
+    add_message_with_priority(mq, TEST_BASE_MQ_MESSAGE_HANDLE[0], MESSAGE_QUEUE_PRIORITY_HIGH);
+    add_message_with_priority(mq, TEST_BASE_MQ_MESSAGE_HANDLE[1], MESSAGE_QUEUE_PRIORITY_NORMAL);
+
+    umock_c_reset_all_calls();
+
+    // act
+    int result = message_queue_add_with_priority(mq, TEST_BASE_MQ_MESSAGE_HANDLE[2], MESSAGE_QUEUE_PRIORITY_LOW, TEST_on_message_processing_completed_callback, TEST_USER_CONTEXT);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(int, 0, (int)TEST_on_message_processing_completed_callback_CANCELLED_result_count);
+
+    // cleanup
+    message_queue_destroy(mq);
+}
+
+// Tests_SRS_MESSAGE_QUEUE_41_022: [If `message_queue->overflow_policy` is MESSAGE_QUEUE_OVERFLOW_DROP_OLDEST, the pending message enqueued first shall be removed and its callback invoked with MESSAGE_QUEUE_CANCELLED, until `message` fits]
+TEST_FUNCTION(add_max_bytes_DROP_OLDEST)
+{
+    // arrange
+    MESSAGE_QUEUE_HANDLE mq = create_message_queue(USE_DEFAULT_CONFIG);
+    ASSERT_ARE_EQUAL(int, 0, message_queue_set_max_size(mq, 0, 10, MESSAGE_QUEUE_OVERFLOW_DROP_OLDEST, TEST_get_message_size));
+    add_message_with_priority(mq, TEST_BASE_MQ_MESSAGE_HANDLE[0], MESSAGE_QUEUE_PRIORITY_NORMAL);
+    add_message_with_priority(mq, TEST_BASE_MQ_MESSAGE_HANDLE[1], MESSAGE_QUEUE_PRIORITY_NORMAL);
+
+    umock_c_reset_all_calls();
+
+    // act
+    int result = message_queue_add(mq, TEST_BASE_MQ_MESSAGE_HANDLE[2], TEST_on_message_processing_completed_callback, TEST_USER_CONTEXT);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(int, 1, (int)TEST_on_message_processing_completed_callback_CANCELLED_result_count);
+    ASSERT_ARE_EQUAL(void_ptr, (void_ptr)TEST_BASE_MQ_MESSAGE_HANDLE[0], (void_ptr)TEST_on_message_processing_completed_callback_message);
+
+    // cleanup
+    message_queue_destroy(mq);
+}
+
+// Tests_SRS_MESSAGE_QUEUE_41_020: [A message larger than the maximum pending bytes shall be rejected without dropping any message]
+TEST_FUNCTION(add_max_bytes_message_too_large)
+{
+    // arrange
+    MESSAGE_QUEUE_HANDLE mq = create_message_queue(USE_DEFAULT_CONFIG);
+    ASSERT_ARE_EQUAL(int, 0, message_queue_set_max_size(mq, 0, 3, MESSAGE_QUEUE_OVERFLOW_DROP_OLDEST, TEST_get_message_size));
+
+    umock_c_reset_all_calls();
+
+    // act
+    int result = message_queue_add(mq, TEST_BASE_MQ_MESSAGE_HANDLE[0], TEST_on_message_processing_completed_callback, TEST_USER_CONTEXT);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+    // cleanup
+    message_queue_destroy(mq);
+}
+
+// Tests_SRS_MESSAGE_QUEUE_09_059: [If `message_queue` is NULL, message_queue_set_max_retry_count shall fail and return non-zero]
+TEST_FUNCTION(message_queue_set_max_retry_count_NULL_handle)
+{
+    // arrange
+    umock_c_reset_all_calls();
+
+    // act
+    int result = message_queue_set_max_retry_count(NULL, 2);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+    // cleanup
+}
+
+// Tests_SRS_MESSAGE_QUEUE_09_060: [`max_retry_count` shall be saved into `message_queue->max_retry_count`]
+// Tests_SRS_MESSAGE_QUEUE_09_061: [If no failures occur, message_queue_set_max_retry_count shall return 0]
+TEST_FUNCTION(message_queue_set_max_retry_count_success)
+{
+    // arrange
+    MESSAGE_QUEUE_HANDLE mq = create_message_queue(USE_DEFAULT_CONFIG);
+
+    umock_c_reset_all_calls();
+
+    // act
+    int result = message_queue_set_max_retry_count(mq, 2);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    // cleanup
+    message_queue_destroy(mq);
+}
+
+// Tests_SRS_MESSAGE_QUEUE_09_055: [If `message_queue` is NULL, message_queue_set_max_message_processing_time_secs shall fail and return non-zero]
+TEST_FUNCTION(message_queue_set_max_message_processing_time_secs_NULL_handle)
+{
+    // arrange
+    umock_c_reset_all_calls();
+
+    // act
+    int result = message_queue_set_max_message_processing_time_secs(NULL, 60);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+    // cleanup
+}
+
+// Tests_SRS_MESSAGE_QUEUE_09_057: [`seconds` shall be saved into `message_queue->max_message_processing_time_ms` in milliseconds]
+// Tests_SRS_MESSAGE_QUEUE_09_058: [If no failures occur, message_queue_set_max_message_processing_time_secs shall return 0]
+TEST_FUNCTION(message_queue_set_max_message_processing_time_secs_success)
+{
+    // arrange
+    MESSAGE_QUEUE_HANDLE mq = create_message_queue(USE_DEFAULT_CONFIG);
+
+    umock_c_reset_all_calls();
+
+    // act
+    int result = message_queue_set_max_message_processing_time_secs(mq, 60);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    // cleanup
+    message_queue_destroy(mq);
+}
+
+// Tests_SRS_MESSAGE_QUEUE_09_051: [If `message_queue` is NULL, message_queue_set_max_message_enqueued_time_secs shall fail and return non-zero]
+TEST_FUNCTION(message_queue_set_max_message_enqueued_time_secs_NULL_handle)
+{
+    // arrange
+    umock_c_reset_all_calls();
+
+    // act
+    int result = message_queue_set_max_message_enqueued_time_secs(NULL, 60);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+    // cleanup
+}
+
+// Tests_SRS_MESSAGE_QUEUE_09_053: [`seconds` shall be saved into `message_queue->max_message_enqueued_time_ms` in milliseconds]
+// Tests_SRS_MESSAGE_QUEUE_09_054: [If no failures occur, message_queue_set_max_message_enqueued_time_secs shall return 0]
+TEST_FUNCTION(message_queue_set_max_message_enqueued_time_secs_success)
+{
+    // arrange
+    MESSAGE_QUEUE_HANDLE mq = create_message_queue(USE_DEFAULT_CONFIG);
+
+    umock_c_reset_all_calls();
+
+    // act
+    int result = message_queue_set_max_message_enqueued_time_secs(mq, 60);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    // cleanup
+    message_queue_destroy(mq);
+}
+
+// Tests_SRS_MESSAGE_QUEUE_41_040: [If `message_queue` is NULL, message_queue_set_max_message_enqueued_time_ms shall fail and return non-zero]
+TEST_FUNCTION(message_queue_set_max_message_enqueued_time_ms_NULL_handle)
+{
+    // arrange
+    umock_c_reset_all_calls();
+
+    // act
+    int result = message_queue_set_max_message_enqueued_time_ms(NULL, 250);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+    // cleanup
+}
+
+// Tests_SRS_MESSAGE_QUEUE_41_041: [`milliseconds` shall be saved into `message_queue->max_message_enqueued_time_ms` and message_queue_set_max_message_enqueued_time_ms shall return 0]
+TEST_FUNCTION(message_queue_set_max_message_enqueued_time_ms_success)
+{
+    // arrange
+    MESSAGE_QUEUE_HANDLE mq = create_message_queue(USE_DEFAULT_CONFIG);
+
+    umock_c_reset_all_calls();
+
+    // act
+    int result = message_queue_set_max_message_enqueued_time_ms(mq, 250);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    // cleanup
+    message_queue_destroy(mq);
+}
+
+// Tests_SRS_MESSAGE_QUEUE_41_042: [If `message_queue` is NULL, message_queue_set_max_message_processing_time_ms shall fail and return non-zero]
+TEST_FUNCTION(message_queue_set_max_message_processing_time_ms_NULL_handle)
+{
+    // arrange
+    umock_c_reset_all_calls();
+
+    // act
+    int result = message_queue_set_max_message_processing_time_ms(NULL, 250);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+    // cleanup
+}
+
+// Tests_SRS_MESSAGE_QUEUE_41_043: [`milliseconds` shall be saved into `message_queue->max_message_processing_time_ms` and message_queue_set_max_message_processing_time_ms shall return 0]
+TEST_FUNCTION(message_queue_set_max_message_processing_time_ms_success)
+{
+    // arrange
+    MESSAGE_QUEUE_HANDLE mq = create_message_queue(USE_DEFAULT_CONFIG);
+
+    umock_c_reset_all_calls();
+
+    // act
+    int result = message_queue_set_max_message_processing_time_ms(mq, 250);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    // cleanup
+    message_queue_destroy(mq);
+}
+
+
+// Tests_SRS_MESSAGE_QUEUE_41_028: [If `message_queue` is NULL, message_queue_set_retry_policy shall fail and return non-zero]
+TEST_FUNCTION(message_queue_set_retry_policy_NULL_handle)
+{
+    // arrange
+    umock_c_reset_all_calls();
+
+    // act
+    int result = message_queue_set_retry_policy(NULL, IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+    // cleanup
+}
+
+// Tests_SRS_MESSAGE_QUEUE_41_034: [Otherwise a retry control shall be created using retry_control_create() passing `policy` and no maximum retry time]
+// Tests_SRS_MESSAGE_QUEUE_41_036: [The previous retry control shall be destroyed and message_queue_set_retry_policy shall return 0; messages already backing off shall keep their wait]
+TEST_FUNCTION(message_queue_set_retry_policy_success)
+{
+    // arrange
+    MESSAGE_QUEUE_HANDLE mq = create_message_queue(USE_DEFAULT_CONFIG);
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(retry_control_create(IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_JITTER, 0));
+    STRICT_EXPECTED_CALL(retry_control_create(IOTHUB_CLIENT_RETRY_LINEAR_BACKOFF, 0));
+    STRICT_EXPECTED_CALL(retry_control_destroy(TEST_RETRY_CONTROL_HANDLE));
+
+    // act
+    int result1 = message_queue_set_retry_policy(mq, IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_JITTER);
+    int result2 = message_queue_set_retry_policy(mq, IOTHUB_CLIENT_RETRY_LINEAR_BACKOFF);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result1);
+    ASSERT_ARE_EQUAL(int, 0, result2);
+
+    // cleanup
+    message_queue_destroy(mq);
+}
+
+// Tests_SRS_MESSAGE_QUEUE_41_035: [If retry_control_create() fails, message_queue_set_retry_policy shall fail, keep the previous policy and return non-zero]
+TEST_FUNCTION(message_queue_set_retry_policy_retry_control_create_fails)
+{
+    // arrange
+    MESSAGE_QUEUE_HANDLE mq = create_message_queue(USE_DEFAULT_CONFIG);
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(retry_control_create(IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF, 0)).SetReturn(NULL);
+
+    // act
+    int result = message_queue_set_retry_policy(mq, IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+    // cleanup
+    message_queue_destroy(mq);
+}
+
+// Tests_SRS_MESSAGE_QUEUE_41_029: [If `policy` is IOTHUB_CLIENT_RETRY_NONE or IOTHUB_CLIENT_RETRY_IMMEDIATE, messages shall be retried without waiting, the previous retry control destroyed, and message_queue_set_retry_policy shall return 0]
+TEST_FUNCTION(message_queue_set_retry_policy_IMMEDIATE_success)
+{
+    // arrange
+    MESSAGE_QUEUE_HANDLE mq = create_message_queue(USE_DEFAULT_CONFIG);
+    (void)message_queue_set_retry_policy(mq, IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF);
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(retry_control_destroy(TEST_RETRY_CONTROL_HANDLE));
+
+    // act
+    int result = message_queue_set_retry_policy(mq, IOTHUB_CLIENT_RETRY_IMMEDIATE);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    // cleanup
+    message_queue_destroy(mq);
+}
+
+// Tests_SRS_MESSAGE_QUEUE_09_062: [If `message_queue` is NULL, message_queue_retrieve_options shall fail and return NULL]
+TEST_FUNCTION(message_queue_retrieve_options_NULL_handle)
 {
     // arrange
     umock_c_reset_all_calls();
@@ -1288,6 +1975,29 @@ TEST_FUNCTION(message_queue_retrieve_options_success)
     message_queue_destroy(mq);
 }
 
+// Tests_SRS_MESSAGE_QUEUE_41_037: [The retry policy shall only be added if one that waits is set]
+TEST_FUNCTION(message_queue_retrieve_options_with_retry_policy_success)
+{
+    // arrange
+    MESSAGE_QUEUE_HANDLE mq = create_message_queue(USE_DEFAULT_CONFIG);
+    (void)message_queue_set_retry_policy(mq, IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF);
+
+    umock_c_reset_all_calls();
+    set_message_queue_retrieve_options_expected_calls();
+    STRICT_EXPECTED_CALL(OptionHandler_AddOption(TEST_OPTIONHANDLER_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+    // act
+    OPTIONHANDLER_HANDLE result = message_queue_retrieve_options(mq);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(int, (int)IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF, (int)TEST_OptionHandler_AddOption_saved_value);
+
+    // cleanup
+    message_queue_destroy(mq);
+}
+
 // Tests_SRS_MESSAGE_QUEUE_09_064: [If an OPTIONHANDLER_HANDLE instance fails to be created, message_queue_retrieve_options shall fail and return NULL]
 // Tests_SRS_MESSAGE_QUEUE_09_066: [If OptionHandler_AddOption fails, message_queue_retrieve_options shall fail and return NULL]
 // Tests_SRS_MESSAGE_QUEUE_09_067: [If message_queue_retrieve_options fails, any allocated memory shall be freed]
@@ -1378,6 +2088,7 @@ TEST_FUNCTION(on_message_processing_completed_callback_NULL_message_queue)
 }
 
 // Tests_SRS_MESSAGE_QUEUE_09_044: [If `message` is not present in `message_queue->in_progress`, it shall be ignored]
+// Tests_SRS_MESSAGE_QUEUE_41_007: [`message` shall be looked up in `message_queue->in_progress` through the in-progress index, without scanning the list]
 TEST_FUNCTION(on_message_processing_completed_callback_MESSAGE_not_present)
 {
     // arrange
@@ -1476,6 +2187,151 @@ TEST_FUNCTION(on_message_processing_completed_callback_RETRYABLE_ERROR)
     message_queue_destroy(mq);
 }
 
+// Tests_SRS_MESSAGE_QUEUE_41_030: [If a retry policy is set, the wait before the retry shall be obtained using retry_control_get_wait_time() passing `mq_item->number_of_attempts` and the previous wait of `mq_item`]
+// Tests_SRS_MESSAGE_QUEUE_41_031: [If the wait is not zero, the message shall not be processed again until that many seconds after tickcounter_get_current_ms()]
+TEST_FUNCTION(on_message_processing_completed_callback_RETRYABLE_ERROR_backs_off)
+{
+    // arrange
+    MESSAGE_QUEUE_HANDLE mq = create_message_queue(USE_DEFAULT_CONFIG);
+    (void)message_queue_set_max_retry_count(mq, 2);
+    (void)message_queue_set_retry_policy(mq, IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF);
+    TEST_retry_control_get_wait_time_result = 4;
+
+    add_messages(mq, 1, TEST_current_time);
+    crank_message_queue(mq, TEST_current_time, 1, 0, NULL);
+    ASSERT_ARE_EQUAL(int, 1, (int)TEST_on_process_message_callback_count);
+
+    umock_c_reset_all_calls();
+    set_retry_sending_message_with_backoff_expected_calls(1, 0, TEST_current_time);
+
+    // act
+    TEST_on_process_message_callback_on_process_message_completed_callback(mq,
+        TEST_on_process_message_callback_message, MESSAGE_QUEUE_RETRYABLE_ERROR, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // not due yet
+    umock_c_reset_all_calls();
+    set_process_timeouts_expected_calls(mq, add_seconds(TEST_current_time, 3), 1, 0, &TEST_test_message_expiration_profile);
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+    set_get_current_time_expected_call(add_seconds(TEST_current_time, 3));
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
+
+    message_queue_do_work(mq);
+
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 1, (int)TEST_on_process_message_callback_count);
+
+    // due
+    umock_c_reset_all_calls();
+    set_process_timeouts_expected_calls(mq, add_seconds(TEST_current_time, 4), 1, 0, &TEST_test_message_expiration_profile);
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+    set_get_current_time_expected_call(add_seconds(TEST_current_time, 4));
+    STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    set_get_current_time_expected_call(add_seconds(TEST_current_time, 4));
+    STRICT_EXPECTED_CALL(singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
+
+    message_queue_do_work(mq);
+
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 2, (int)TEST_on_process_message_callback_count);
+    ASSERT_ARE_EQUAL(int, 0, (int)TEST_on_message_processing_completed_callback_ERROR_result_count);
+
+    // the second retry waits again, from the previous wait
+    umock_c_reset_all_calls();
+    set_retry_sending_message_with_backoff_expected_calls(2, 4, add_seconds(TEST_current_time, 4));
+
+    TEST_on_process_message_callback_on_process_message_completed_callback(mq,
+        TEST_on_process_message_callback_message, MESSAGE_QUEUE_RETRYABLE_ERROR, NULL);
+
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    message_queue_destroy(mq);
+}
+
+// Tests_SRS_MESSAGE_QUEUE_41_033: [Messages backing off shall be skipped, in their place in the pending list, until their wait is over, while the messages behind them are processed]
+TEST_FUNCTION(do_work_processes_new_messages_behind_message_backing_off)
+{
+    // arrange
+    MESSAGE_QUEUE_HANDLE mq = create_message_queue(USE_DEFAULT_CONFIG);
+    (void)message_queue_set_max_retry_count(mq, 2);
+    (void)message_queue_set_retry_policy(mq, IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF);
+    TEST_retry_control_get_wait_time_result = 4;
+
+    add_messages(mq, 1, TEST_current_time);
+    crank_message_queue(mq, TEST_current_time, 1, 0, NULL);
+    TEST_on_process_message_callback_on_process_message_completed_callback(mq,
+        TEST_on_process_message_callback_message, MESSAGE_QUEUE_RETRYABLE_ERROR, NULL);
+
+    umock_c_reset_all_calls();
+    set_message_queue_add_expected_calls(TEST_current_time);
+    ASSERT_ARE_EQUAL(int, 0, message_queue_add(mq, TEST_BASE_MQ_MESSAGE_HANDLE[1], TEST_on_message_processing_completed_callback, TEST_USER_CONTEXT));
+
+    umock_c_reset_all_calls();
+    set_process_timeouts_expected_calls(mq, TEST_current_time, 2, 0, &TEST_test_message_expiration_profile);
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+    set_get_current_time_expected_call(TEST_current_time);
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    set_get_current_time_expected_call(TEST_current_time);
+    STRICT_EXPECTED_CALL(singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
+
+    // act
+    message_queue_do_work(mq);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 2, (int)TEST_on_process_message_callback_count);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)TEST_BASE_MQ_MESSAGE_HANDLE[1], (void*)TEST_on_process_message_callback_message);
+
+    // cleanup
+    message_queue_destroy(mq);
+}
+
+// Tests_SRS_MESSAGE_QUEUE_41_032: [If retry_control_get_wait_time() or tickcounter_get_current_ms() fail, the message shall be retried without waiting]
+TEST_FUNCTION(on_message_processing_completed_callback_RETRYABLE_ERROR_get_wait_time_fails)
+{
+    // arrange
+    MESSAGE_QUEUE_HANDLE mq = create_message_queue(USE_DEFAULT_CONFIG);
+    (void)message_queue_set_max_retry_count(mq, 2);
+    (void)message_queue_set_retry_policy(mq, IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF);
+
+    add_messages(mq, 1, TEST_current_time);
+    crank_message_queue(mq, TEST_current_time, 1, 0, NULL);
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(retry_control_get_wait_time(TEST_RETRY_CONTROL_HANDLE, 1, 0, IGNORED_PTR_ARG)).SetReturn(1);
+    STRICT_EXPECTED_CALL(singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    set_message_queue_do_work_expected_calls(mq, TEST_current_time, 1, 0, &TEST_test_message_expiration_profile);
+
+    // act
+    TEST_on_process_message_callback_on_process_message_completed_callback(mq,
+        TEST_on_process_message_callback_message, MESSAGE_QUEUE_RETRYABLE_ERROR, NULL);
+    message_queue_do_work(mq);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 2, (int)TEST_on_process_message_callback_count);
+
+    // cleanup
+    message_queue_destroy(mq);
+}
+
 // Tests_SRS_MESSAGE_QUEUE_09_035: [If `message_queue->max_message_enqueued_time_secs` is greater than zero, `message_queue->in_progress` and `message_queue->pending` items shall be checked for timeout]
 // Tests_SRS_MESSAGE_QUEUE_09_036: [If any items are in `message_queue` lists for `message_queue->max_message_enqueued_time_secs` or more, they shall be removed and `message_queue->on_message_processing_completed_callback` invoked with MESSAGE_QUEUE_TIMEOUT]
 TEST_FUNCTION(do_work_pending_queue_timeout)
@@ -1486,7 +2342,7 @@ TEST_FUNCTION(do_work_pending_queue_timeout)
 
     add_messages(mq, 1, TEST_current_time);
 
-    time_t t1 = add_seconds(TEST_current_time, 10);
+    tickcounter_ms_t t1 = add_seconds(TEST_current_time, 10);
 
     TEST_MESSAGE_EXPIRATION_PROFILE exp_prof;
     exp_prof.max_message_enqueued_time_secs = 10;
@@ -1517,6 +2373,77 @@ TEST_FUNCTION(do_work_pending_queue_timeout)
     message_queue_destroy(mq);
 }
 
+// Tests_SRS_MESSAGE_QUEUE_41_041: [`milliseconds` shall be saved into `message_queue->max_message_enqueued_time_ms` and message_queue_set_max_message_enqueued_time_ms shall return 0]
+// Tests_SRS_MESSAGE_QUEUE_09_036: [If any items are in `message_queue` lists for `message_queue->max_message_enqueued_time_ms` or more, they shall be removed and `message_queue->on_message_processing_completed_callback` invoked with MESSAGE_QUEUE_TIMEOUT]
+TEST_FUNCTION(do_work_pending_queue_sub_second_timeout)
+{
+    // arrange
+    MESSAGE_QUEUE_HANDLE mq = create_message_queue(USE_DEFAULT_CONFIG);
+    (void)message_queue_set_max_message_enqueued_time_ms(mq, 250);
+
+    add_messages(mq, 1, TEST_current_time);
+
+    TEST_MESSAGE_EXPIRATION_PROFILE exp_prof;
+    exp_prof.max_message_enqueued_time_secs = 0.25;
+    exp_prof.max_message_processing_time_secs = 0;
+    size_t expired_pending_messages[] = { 0 };
+    exp_prof.expired_pending_messages = expired_pending_messages;
+    exp_prof.expired_pending_messages_size = 1;
+    exp_prof.expired_in_progress_messages = NULL;
+    exp_prof.expired_in_progress_messages_size = 0;
+    exp_prof.expired_enqueued_in_progress_messages = NULL;
+    exp_prof.expired_enqueued_in_progress_messages_size = 0;
+
+    umock_c_reset_all_calls();
+    set_process_timeouts_expected_calls(mq, TEST_current_time + 250, 1, 0, &exp_prof);
+    set_process_pending_messages_calls(mq, TEST_current_time + 250, 0);
+
+    // act
+    message_queue_do_work(mq);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, (int)TEST_on_process_message_callback_count);
+    ASSERT_ARE_EQUAL(int, 1, (int)TEST_on_message_processing_completed_callback_TIMEOUT_result_count);
+
+    // cleanup
+    message_queue_destroy(mq);
+}
+
+// Tests_SRS_MESSAGE_QUEUE_09_036: [If any items are in `message_queue` lists for `message_queue->max_message_enqueued_time_ms` or more, they shall be removed and `message_queue->on_message_processing_completed_callback` invoked with MESSAGE_QUEUE_TIMEOUT]
+TEST_FUNCTION(do_work_pending_queue_sub_second_not_expired)
+{
+    // arrange
+    MESSAGE_QUEUE_HANDLE mq = create_message_queue(USE_DEFAULT_CONFIG);
+    (void)message_queue_set_max_message_enqueued_time_ms(mq, 250);
+
+    add_messages(mq, 1, TEST_current_time);
+
+    TEST_MESSAGE_EXPIRATION_PROFILE exp_prof;
+    exp_prof.max_message_enqueued_time_secs = 0.25;
+    exp_prof.max_message_processing_time_secs = 0;
+    exp_prof.expired_pending_messages = NULL;
+    exp_prof.expired_pending_messages_size = 0;
+    exp_prof.expired_in_progress_messages = NULL;
+    exp_prof.expired_in_progress_messages_size = 0;
+    exp_prof.expired_enqueued_in_progress_messages = NULL;
+    exp_prof.expired_enqueued_in_progress_messages_size = 0;
+
+    umock_c_reset_all_calls();
+    set_message_queue_do_work_expected_calls(mq, TEST_current_time + 249, 1, 0, &exp_prof);
+
+    // act
+    message_queue_do_work(mq);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 1, (int)TEST_on_process_message_callback_count);
+    ASSERT_ARE_EQUAL(int, 0, (int)TEST_on_message_processing_completed_callback_TIMEOUT_result_count);
+
+    // cleanup
+    message_queue_destroy(mq);
+}
+
 // Tests_SRS_MESSAGE_QUEUE_09_037: [If `message_queue->max_message_processing_time_secs` is greater than zero, `message_queue->in_progress` items shall be checked for timeout]
 // Tests_SRS_MESSAGE_QUEUE_09_038: [If any items are in `message_queue->in_progress` for `message_queue->max_message_processing_time_secs` or more, they shall be removed and `message_queue->on_message_processing_completed_callback` invoked with MESSAGE_QUEUE_TIMEOUT]
 TEST_FUNCTION(do_work_in_progress_processing_timeout)
@@ -1529,7 +2456,7 @@ TEST_FUNCTION(do_work_in_progress_processing_timeout)
 
     (void)message_queue_set_max_message_processing_time_secs(mq, 10);
 
-    time_t t1 = add_seconds(TEST_current_time, 10);
+    tickcounter_ms_t t1 = add_seconds(TEST_current_time, 10);
 
     TEST_MESSAGE_EXPIRATION_PROFILE exp_prof;
     exp_prof.max_message_enqueued_time_secs = 0;
@@ -1572,7 +2499,7 @@ TEST_FUNCTION(do_work_in_progress_queue_timeout)
 
     (void)message_queue_set_max_message_enqueued_time_secs(mq, 10);
 
-    time_t t1 = add_seconds(TEST_current_time, 10);
+    tickcounter_ms_t t1 = add_seconds(TEST_current_time, 10);
 
     TEST_MESSAGE_EXPIRATION_PROFILE exp_prof;
     exp_prof.max_message_enqueued_time_secs = 10;
@@ -1603,4 +2530,31 @@ TEST_FUNCTION(do_work_in_progress_queue_timeout)
     message_queue_destroy(mq);
 }
 
+// Tests_SRS_MESSAGE_QUEUE_41_013: [`message_queue->in_progress` shall only be checked for enqueue timeout if it is not empty and its earliest enqueue time is `message_queue->max_message_enqueued_time_secs` or more in the past]
+TEST_FUNCTION(do_work_in_progress_queue_not_expired_skips_scan)
+{
+    // arrange
+    MESSAGE_QUEUE_HANDLE mq = create_message_queue(USE_DEFAULT_CONFIG);
+
+    add_messages(mq, 3, TEST_current_time);
+    crank_message_queue(mq, TEST_current_time, 3, 0, NULL);
+
+    (void)message_queue_set_max_message_enqueued_time_secs(mq, 10);
+
+    umock_c_reset_all_calls();
+    set_get_current_time_expected_call(add_seconds(TEST_current_time, 9));
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
+    set_process_pending_messages_calls(mq, add_seconds(TEST_current_time, 9), 0);
+
+    // act
+    message_queue_do_work(mq);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, (int)TEST_on_message_processing_completed_callback_TIMEOUT_result_count);
+
+    // cleanup
+    message_queue_destroy(mq);
+}
+
 END_TEST_SUITE(message_queue_ut)
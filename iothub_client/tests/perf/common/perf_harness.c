@@ -0,0 +1,193 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 199309L
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "azure_c_shared_utility/xlogging.h"
+#include "perf_harness.h"
+
+#ifdef PERF_WRAP_ALLOCATIONS
+/* The perf executables are linked with -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc
+   so that every allocation made by the statically linked SDK libraries goes through here.
+   The load benchmarks allocate from several threads, so the counter is updated atomically
+   (the wrapping is only enabled for GNU ld, whose toolchains provide the __sync builtins). */
+static size_t g_allocation_count = 0;
+
+extern void* __real_malloc(size_t size);
+extern void* __real_calloc(size_t nmemb, size_t size);
+extern void* __real_realloc(void* ptr, size_t size);
+
+void* __wrap_malloc(size_t size)
+{
+    (void)__sync_fetch_and_add(&g_allocation_count, 1);
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t nmemb, size_t size)
+{
+    (void)__sync_fetch_and_add(&g_allocation_count, 1);
+    return __real_calloc(nmemb, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size)
+{
+    (void)__sync_fetch_and_add(&g_allocation_count, 1);
+    return __real_realloc(ptr, size);
+}
+
+size_t perf_get_allocation_count(void)
+{
+    return __sync_fetch_and_add(&g_allocation_count, 0);
+}
+#else
+size_t perf_get_allocation_count(void)
+{
+    return 0;
+}
+#endif
+
+uint64_t perf_get_time_ns(void)
+{
+#ifdef _WIN32
+    static LARGE_INTEGER frequency = { 0 };
+    LARGE_INTEGER counter;
+    if (frequency.QuadPart == 0)
+    {
+        (void)QueryPerformanceFrequency(&frequency);
+    }
+    (void)QueryPerformanceCounter(&counter);
+    return (uint64_t)((double)counter.QuadPart * 1000000000.0 / (double)frequency.QuadPart);
+#else
+    struct timespec now;
+    (void)clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+#endif
+}
+
+static int compare_samples(const void* left, const void* right)
+{
+    uint64_t a = *(const uint64_t*)left;
+    uint64_t b = *(const uint64_t*)right;
+    return (a < b) ? -1 : ((a > b) ? 1 : 0);
+}
+
+static uint64_t get_percentile(const uint64_t* sorted_samples, size_t count, size_t percentile)
+{
+    size_t index = (count * percentile) / 100;
+    if (index >= count)
+    {
+        index = count - 1;
+    }
+    return sorted_samples[index];
+}
+
+int perf_run(const char* name, size_t iterations, PERF_OPERATION operation, void* context, PERF_RESULT* result)
+{
+    int run_result;
+    uint64_t* samples;
+
+    if (name == NULL || iterations == 0 || operation == NULL)
+    {
+        LogError("Invalid argument (name=%p, iterations=%lu, operation=%p)", name, (unsigned long)iterations, operation);
+        run_result = __FAILURE__;
+    }
+    else if ((samples = (uint64_t*)malloc(iterations * sizeof(uint64_t))) == NULL)
+    {
+        LogError("Failed allocating %lu samples", (unsigned long)iterations);
+        run_result = __FAILURE__;
+    }
+    else
+    {
+        size_t warm_up = iterations / 10;
+        size_t i;
+
+        run_result = 0;
+
+        for (i = 0; i < warm_up && run_result == 0; i++)
+        {
+            run_result = operation(context);
+        }
+
+        if (run_result != 0)
+        {
+            LogError("%s: warm up run failed", name);
+        }
+        else
+        {
+            PERF_RESULT measured;
+            size_t allocations_before = perf_get_allocation_count();
+            size_t allocations_after;
+            uint64_t start = perf_get_time_ns();
+            uint64_t elapsed;
+
+            for (i = 0; i < iterations; i++)
+            {
+                uint64_t run_start = perf_get_time_ns();
+                if (operation(context) != 0)
+                {
+                    LogError("%s: run %lu failed", name, (unsigned long)i);
+                    run_result = __FAILURE__;
+                    break;
+                }
+                samples[i] = perf_get_time_ns() - run_start;
+            }
+
+            elapsed = perf_get_time_ns() - start;
+            allocations_after = perf_get_allocation_count();
+
+            if (run_result == 0)
+            {
+                qsort(samples, iterations, sizeof(uint64_t), compare_samples);
+
+                measured.iterations = iterations;
+                measured.ops_per_second = (elapsed == 0) ? 0.0 : ((double)iterations * 1000000000.0 / (double)elapsed);
+                measured.p50_ns = get_percentile(samples, iterations, 50);
+                measured.p99_ns = get_percentile(samples, iterations, 99);
+                measured.max_ns = samples[iterations - 1];
+#ifdef PERF_WRAP_ALLOCATIONS
+                measured.allocations_per_op = (double)(allocations_after - allocations_before) / (double)iterations;
+#else
+                (void)allocations_before;
+                (void)allocations_after;
+                measured.allocations_per_op = -1.0;
+#endif
+
+                if (measured.allocations_per_op < 0)
+                {
+                    (void)printf("%-48s %8lu ops %12.0f ops/s  p50 %8.2f us  p99 %8.2f us  max %9.2f us  allocs/op n/a\r\n",
+                        name, (unsigned long)iterations, measured.ops_per_second,
+                        (double)measured.p50_ns / 1000.0, (double)measured.p99_ns / 1000.0, (double)measured.max_ns / 1000.0);
+                }
+                else
+                {
+                    (void)printf("%-48s %8lu ops %12.0f ops/s  p50 %8.2f us  p99 %8.2f us  max %9.2f us  allocs/op %6.2f\r\n",
+                        name, (unsigned long)iterations, measured.ops_per_second,
+                        (double)measured.p50_ns / 1000.0, (double)measured.p99_ns / 1000.0, (double)measured.max_ns / 1000.0,
+                        measured.allocations_per_op);
+                }
+
+                if (result != NULL)
+                {
+                    *result = measured;
+                }
+            }
+        }
+
+        free(samples);
+    }
+
+    return run_result;
+}
@@ -0,0 +1,63 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file perf_harness.h
+*    @brief Minimal timing harness shared by the iothub_client microbenchmarks.
+*
+*    @details Every benchmark is a single operation that is run a fixed number of
+*             times after a short warm up. The harness times each run, sorts the
+*             samples and prints throughput, p50/p99/max latency and, where the
+*             allocator can be observed, the number of allocations per run.
+*/
+
+#ifndef PERF_HARNESS_H
+#define PERF_HARNESS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /** @brief  Runs the operation under test once. Returns 0 on success. */
+    typedef int(*PERF_OPERATION)(void* context);
+
+    typedef struct PERF_RESULT_TAG
+    {
+        size_t iterations;
+        double ops_per_second;
+        uint64_t p50_ns;
+        uint64_t p99_ns;
+        uint64_t max_ns;
+        /* -1 when the allocator is not observable on this platform */
+        double allocations_per_op;
+    } PERF_RESULT;
+
+    /**
+    * @brief    Current value of a monotonic clock in nanoseconds.
+    */
+    extern uint64_t perf_get_time_ns(void);
+
+    /**
+    * @brief    Number of malloc/calloc/realloc calls made by the process so far,
+    *           or 0 if allocations cannot be counted on this platform.
+    */
+    extern size_t perf_get_allocation_count(void);
+
+    /**
+    * @brief    Runs @p operation @p iterations times (after @p iterations / 10
+    *           warm up runs) and prints one result line prefixed with @p name.
+    *
+    * @param    result    Optional, receives the measured values.
+    *
+    * @return   0 if every run of @p operation succeeded, non-zero otherwise.
+    */
+    extern int perf_run(const char* name, size_t iterations, PERF_OPERATION operation, void* context, PERF_RESULT* result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PERF_HARNESS_H */
@@ -0,0 +1,229 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "perf_load.h"
+
+typedef struct PERF_LOAD_WORKER_TAG
+{
+    PERF_OPERATION operation;
+    void* context;
+    size_t operations;
+    uint64_t* samples;
+    size_t sampleCount;
+    size_t failures;
+    uint64_t start_ns;
+    uint64_t end_ns;
+    THREAD_HANDLE thread;
+} PERF_LOAD_WORKER;
+
+static int run_worker(void* arg)
+{
+    PERF_LOAD_WORKER* worker = (PERF_LOAD_WORKER*)arg;
+    size_t warm_up = worker->operations / 10;
+    size_t i;
+
+    for (i = 0; i < warm_up; i++)
+    {
+        if (worker->operation(worker->context) != 0)
+        {
+            worker->failures++;
+        }
+    }
+
+    worker->start_ns = perf_get_time_ns();
+    for (i = 0; i < worker->operations; i++)
+    {
+        uint64_t run_start = perf_get_time_ns();
+        if (worker->operation(worker->context) != 0)
+        {
+            worker->failures++;
+        }
+        else
+        {
+            worker->samples[worker->sampleCount++] = perf_get_time_ns() - run_start;
+        }
+    }
+    worker->end_ns = perf_get_time_ns();
+
+    return 0;
+}
+
+static int compare_samples(const void* left, const void* right)
+{
+    uint64_t a = *(const uint64_t*)left;
+    uint64_t b = *(const uint64_t*)right;
+    return (a < b) ? -1 : ((a > b) ? 1 : 0);
+}
+
+static uint64_t get_permille(const uint64_t* sorted_samples, size_t count, size_t permille)
+{
+    size_t index = (count * permille) / 1000;
+    if (index >= count)
+    {
+        index = count - 1;
+    }
+    return sorted_samples[index];
+}
+
+static void print_load_result(const char* name, const PERF_LOAD_RESULT* measured)
+{
+    (void)printf("%-40s %3lu thr %8lu ops %10.0f ops/s  p50 %9.2f us  p99 %9.2f us  p999 %9.2f us  max %10.2f us  failed %lu",
+        name, (unsigned long)measured->threads, (unsigned long)measured->operations, measured->ops_per_second,
+        (double)measured->p50_ns / 1000.0, (double)measured->p99_ns / 1000.0, (double)measured->p999_ns / 1000.0, (double)measured->max_ns / 1000.0,
+        (unsigned long)measured->failures);
+    if (measured->allocations_per_op < 0)
+    {
+        (void)printf("  allocs/op n/a\r\n");
+    }
+    else
+    {
+        (void)printf("  allocs/op %6.2f\r\n", measured->allocations_per_op);
+    }
+}
+
+int perf_run_load(const char* name, size_t threads, size_t operationsPerThread, PERF_OPERATION operation, void** contexts, PERF_LOAD_RESULT* result)
+{
+    int run_result;
+    PERF_LOAD_WORKER* workers;
+    uint64_t* samples;
+
+    if (name == NULL || threads == 0 || operationsPerThread == 0 || operation == NULL || contexts == NULL)
+    {
+        LogError("Invalid argument (name=%p, threads=%lu, operationsPerThread=%lu, operation=%p, contexts=%p)",
+            name, (unsigned long)threads, (unsigned long)operationsPerThread, operation, contexts);
+        run_result = __FAILURE__;
+    }
+    else if ((workers = (PERF_LOAD_WORKER*)calloc(threads, sizeof(PERF_LOAD_WORKER))) == NULL)
+    {
+        LogError("Failed allocating %lu workers", (unsigned long)threads);
+        run_result = __FAILURE__;
+    }
+    else
+    {
+        if ((samples = (uint64_t*)malloc(threads * operationsPerThread * sizeof(uint64_t))) == NULL)
+        {
+            LogError("Failed allocating %lu samples", (unsigned long)(threads * operationsPerThread));
+            run_result = __FAILURE__;
+        }
+        else
+        {
+            size_t allocations_before;
+            size_t allocations_after;
+            size_t started;
+            size_t i;
+
+            run_result = 0;
+
+            for (i = 0; i < threads; i++)
+            {
+                workers[i].operation = operation;
+                workers[i].context = contexts[i];
+                workers[i].operations = operationsPerThread;
+                workers[i].samples = samples + (i * operationsPerThread);
+            }
+
+            allocations_before = perf_get_allocation_count();
+
+            for (started = 0; started < threads; started++)
+            {
+                if (ThreadAPI_Create(&workers[started].thread, run_worker, &workers[started]) != THREADAPI_OK)
+                {
+                    LogError("%s: failed starting worker %lu", name, (unsigned long)started);
+                    run_result = __FAILURE__;
+                    break;
+                }
+            }
+
+            for (i = 0; i < started; i++)
+            {
+                int thread_result;
+                (void)ThreadAPI_Join(workers[i].thread, &thread_result);
+            }
+
+            allocations_after = perf_get_allocation_count();
+
+            if (run_result == 0)
+            {
+                PERF_LOAD_RESULT measured;
+                uint64_t first_start = workers[0].start_ns;
+                uint64_t last_end = workers[0].end_ns;
+                size_t sampleCount = 0;
+                size_t warm_up_operations = threads * (operationsPerThread / 10);
+
+                measured.threads = threads;
+                measured.failures = 0;
+
+                /* compact the per thread samples so they can be sorted together */
+                for (i = 0; i < threads; i++)
+                {
+                    size_t j;
+                    for (j = 0; j < workers[i].sampleCount; j++)
+                    {
+                        samples[sampleCount++] = workers[i].samples[j];
+                    }
+                    measured.failures += workers[i].failures;
+                    if (workers[i].start_ns < first_start)
+                    {
+                        first_start = workers[i].start_ns;
+                    }
+                    if (workers[i].end_ns > last_end)
+                    {
+                        last_end = workers[i].end_ns;
+                    }
+                }
+
+                measured.operations = sampleCount;
+                measured.ops_per_second = (last_end == first_start) ? 0.0 : ((double)sampleCount * 1000000000.0 / (double)(last_end - first_start));
+
+                if (sampleCount == 0)
+                {
+                    measured.p50_ns = measured.p99_ns = measured.p999_ns = measured.max_ns = 0;
+                }
+                else
+                {
+                    qsort(samples, sampleCount, sizeof(uint64_t), compare_samples);
+                    measured.p50_ns = get_permille(samples, sampleCount, 500);
+                    measured.p99_ns = get_permille(samples, sampleCount, 990);
+                    measured.p999_ns = get_permille(samples, sampleCount, 999);
+                    measured.max_ns = samples[sampleCount - 1];
+                }
+
+#ifdef PERF_WRAP_ALLOCATIONS
+                /* the warm up runs allocate as much as the measured ones, so they are part of the average */
+                measured.allocations_per_op = (double)(allocations_after - allocations_before) / (double)(threads * operationsPerThread + warm_up_operations);
+#else
+                (void)allocations_before;
+                (void)allocations_after;
+                (void)warm_up_operations;
+                measured.allocations_per_op = -1.0;
+#endif
+
+                print_load_result(name, &measured);
+
+                if (measured.failures != 0)
+                {
+                    LogError("%s: %lu runs failed", name, (unsigned long)measured.failures);
+                    run_result = __FAILURE__;
+                }
+
+                if (result != NULL)
+                {
+                    *result = measured;
+                }
+            }
+
+            free(samples);
+        }
+
+        free(workers);
+    }
+
+    return run_result;
+}
@@ -0,0 +1,61 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file perf_load.h
+*    @brief Concurrent load generator built on top of perf_harness.
+*
+*    @details perf_run_load starts one thread per worker context, every thread
+*             runs the operation a fixed number of times after a short warm up
+*             and records the latency of each run. The samples of all threads
+*             are merged to report sustained throughput, p50/p99/p999/max
+*             latency and, where the allocator can be observed, the number of
+*             allocations per operation.
+*/
+
+#ifndef PERF_LOAD_H
+#define PERF_LOAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "perf_harness.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    typedef struct PERF_LOAD_RESULT_TAG
+    {
+        size_t threads;
+        size_t operations;
+        size_t failures;
+        double ops_per_second;
+        uint64_t p50_ns;
+        uint64_t p99_ns;
+        uint64_t p999_ns;
+        uint64_t max_ns;
+        /* -1 when the allocator is not observable on this platform */
+        double allocations_per_op;
+    } PERF_LOAD_RESULT;
+
+    /**
+    * @brief    Runs @p operation @p operationsPerThread times on each of @p threads
+    *           threads (after @p operationsPerThread / 10 warm up runs per thread)
+    *           and prints one result line prefixed with @p name.
+    *
+    * @param    contexts    One context per thread, handed to every run of @p operation on that thread.
+    * @param    result      Optional, receives the measured values.
+    *
+    * @details  A failed run is counted and excluded from the latency samples, the
+    *           thread carries on with its remaining runs.
+    *
+    * @return   0 if every run of @p operation succeeded, non-zero otherwise.
+    */
+    extern int perf_run_load(const char* name, size_t threads, size_t operationsPerThread, PERF_OPERATION operation, void** contexts, PERF_LOAD_RESULT* result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PERF_LOAD_H */
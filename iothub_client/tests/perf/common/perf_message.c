@@ -0,0 +1,60 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "azure_c_shared_utility/xlogging.h"
+#include "perf_message.h"
+
+IOTHUB_MESSAGE_HANDLE perf_create_telemetry_message(size_t payload_size, size_t property_count)
+{
+    IOTHUB_MESSAGE_HANDLE result;
+    unsigned char* payload;
+
+    if ((payload = (unsigned char*)malloc(payload_size == 0 ? 1 : payload_size)) == NULL)
+    {
+        LogError("Failed allocating %lu bytes of payload", (unsigned long)payload_size);
+        result = NULL;
+    }
+    else
+    {
+        (void)memset(payload, 'x', payload_size);
+
+        if ((result = IoTHubMessage_CreateFromByteArray(payload, payload_size)) == NULL)
+        {
+            LogError("IoTHubMessage_CreateFromByteArray failed");
+        }
+        else if (IoTHubMessage_SetMessageId(result, "perf-message-id-0001") != IOTHUB_MESSAGE_OK ||
+            IoTHubMessage_SetCorrelationId(result, "perf-correlation-id-0001") != IOTHUB_MESSAGE_OK ||
+            IoTHubMessage_SetContentTypeSystemProperty(result, "application%2fjson") != IOTHUB_MESSAGE_OK ||
+            IoTHubMessage_SetContentEncodingSystemProperty(result, "utf-8") != IOTHUB_MESSAGE_OK)
+        {
+            LogError("Failed setting system properties");
+            IoTHubMessage_Destroy(result);
+            result = NULL;
+        }
+        else
+        {
+            size_t i;
+            for (i = 0; i < property_count; i++)
+            {
+                char key[32];
+                char value[32];
+                (void)sprintf(key, "property%lu", (unsigned long)i);
+                (void)sprintf(value, "value of property %lu", (unsigned long)i);
+                if (IoTHubMessage_SetProperty(result, key, value) != IOTHUB_MESSAGE_OK)
+                {
+                    LogError("Failed setting property %s", key);
+                    IoTHubMessage_Destroy(result);
+                    result = NULL;
+                    break;
+                }
+            }
+        }
+
+        free(payload);
+    }
+
+    return result;
+}
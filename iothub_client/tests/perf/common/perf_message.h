@@ -0,0 +1,28 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef PERF_MESSAGE_H
+#define PERF_MESSAGE_H
+
+#include <stddef.h>
+#include "iothub_message.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+    * @brief    Creates the telemetry message every benchmark uses: a byte array
+    *           body of @p payload_size bytes, message id, correlation id, content
+    *           type and encoding, and @p property_count application properties.
+    *
+    * @return   A message the caller must destroy, or NULL on failure.
+    */
+    extern IOTHUB_MESSAGE_HANDLE perf_create_telemetry_message(size_t payload_size, size_t property_count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PERF_MESSAGE_H */
@@ -0,0 +1,290 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+// Measures the client side of SendEventAsync -> transport publish -> confirmation, and of
+// the cloud-to-device messages and methods it receives, against the loopback transport,
+// so no protocol or network cost is included.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/platform.h"
+#include "iothub_client_ll.h"
+#include "iothub_client_options.h"
+#include "iothub_message.h"
+#include "common/perf_harness.h"
+#include "common/perf_message.h"
+#include "iothubtransportloopback.h"
+
+#define PERF_ITERATIONS             20000
+#define PERF_PAYLOAD_SIZE           256
+#define PERF_PROPERTY_COUNT         4
+#define PERF_SMALL_PAYLOAD_SIZE     64
+#define PERF_SMALL_EVENT_SLOTS      16
+#define PERF_INBOUND_RATE           100000
+
+static const char* PERF_CONNECTION_STRING = "HostName=perf.azure-devices.net;DeviceId=perf-device;SharedAccessKey=cGVyZi1kZXZpY2Uta2V5LXBlcmYtZGV2aWNlLWtleQ==";
+
+typedef struct PERF_CLIENT_CONTEXT_TAG
+{
+    IOTHUB_CLIENT_LL_HANDLE client;
+    IOTHUB_MESSAGE_HANDLE message;
+    unsigned char small_payload[PERF_SMALL_PAYLOAD_SIZE];
+    size_t confirmed;
+    size_t failed;
+} PERF_CLIENT_CONTEXT;
+
+static void on_event_confirmed(IOTHUB_CLIENT_CONFIRMATION_RESULT result, void* userContextCallback)
+{
+    PERF_CLIENT_CONTEXT* context = (PERF_CLIENT_CONTEXT*)userContextCallback;
+    if (result == IOTHUB_CLIENT_CONFIRMATION_OK)
+    {
+        context->confirmed++;
+    }
+    else
+    {
+        context->failed++;
+    }
+}
+
+static int send_event(void* ctx)
+{
+    PERF_CLIENT_CONTEXT* context = (PERF_CLIENT_CONTEXT*)ctx;
+    return (IoTHubClient_LL_SendEventAsync(context->client, context->message, on_event_confirmed, context) == IOTHUB_CLIENT_OK) ? 0 : __FAILURE__;
+}
+
+static int send_event_and_confirm(void* ctx)
+{
+    PERF_CLIENT_CONTEXT* context = (PERF_CLIENT_CONTEXT*)ctx;
+    int result;
+
+    if (IoTHubClient_LL_SendEventAsync(context->client, context->message, on_event_confirmed, context) != IOTHUB_CLIENT_OK)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        IoTHubClient_LL_DoWork(context->client);
+        result = 0;
+    }
+
+    return result;
+}
+
+static int send_event_take_ownership_and_confirm(void* ctx)
+{
+    PERF_CLIENT_CONTEXT* context = (PERF_CLIENT_CONTEXT*)ctx;
+    IOTHUB_MESSAGE_HANDLE message;
+    int result;
+
+    /* the clone is timed on purpose: SendEventAsync pays for the same clone internally */
+    if ((message = IoTHubMessage_Clone(context->message)) == NULL)
+    {
+        result = __FAILURE__;
+    }
+    else if (IoTHubClient_LL_SendEventAsync_TakeOwnership(context->client, message, on_event_confirmed, context) != IOTHUB_CLIENT_OK)
+    {
+        IoTHubMessage_Destroy(message);
+        result = __FAILURE__;
+    }
+    else
+    {
+        IoTHubClient_LL_DoWork(context->client);
+        result = 0;
+    }
+
+    return result;
+}
+
+static int send_small_event_and_confirm(void* ctx)
+{
+    PERF_CLIENT_CONTEXT* context = (PERF_CLIENT_CONTEXT*)ctx;
+    int result;
+
+    if (IoTHubClient_LL_SendSmallEvent(context->client, context->small_payload, sizeof(context->small_payload), on_event_confirmed, context) != IOTHUB_CLIENT_OK)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        IoTHubClient_LL_DoWork(context->client);
+        result = 0;
+    }
+
+    return result;
+}
+
+static IOTHUBMESSAGE_DISPOSITION_RESULT on_message_received(IOTHUB_MESSAGE_HANDLE message, void* userContextCallback)
+{
+    (void)message;
+    (void)userContextCallback;
+    return IOTHUBMESSAGE_ACCEPTED;
+}
+
+static int on_method_invoked(const char* method_name, const unsigned char* payload, size_t size, unsigned char** response, size_t* response_size, void* userContextCallback)
+{
+    static const char METHOD_RESPONSE[] = "{}";
+    (void)method_name;
+    (void)payload;
+    (void)size;
+    (void)userContextCallback;
+
+    if ((*response = (unsigned char*)malloc(sizeof(METHOD_RESPONSE) - 1)) == NULL)
+    {
+        *response_size = 0;
+    }
+    else
+    {
+        (void)memcpy(*response, METHOD_RESPONSE, sizeof(METHOD_RESPONSE) - 1);
+        *response_size = sizeof(METHOD_RESPONSE) - 1;
+    }
+    return 200;
+}
+
+static int receive_inbound(void* ctx)
+{
+    PERF_CLIENT_CONTEXT* context = (PERF_CLIENT_CONTEXT*)ctx;
+    IoTHubClient_LL_DoWork(context->client);
+    return 0;
+}
+
+static int drain_client(PERF_CLIENT_CONTEXT* context)
+{
+    IOTHUB_CLIENT_STATUS status;
+
+    IoTHubClient_LL_DoWork(context->client);
+
+    return (IoTHubClient_LL_GetSendStatus(context->client, &status) == IOTHUB_CLIENT_OK && status == IOTHUB_CLIENT_SEND_STATUS_IDLE && context->failed == 0) ? 0 : __FAILURE__;
+}
+
+static int run_client_benchmark(const char* name, PERF_OPERATION operation, bool enable_statistics, size_t pool_size)
+{
+    int result;
+    PERF_CLIENT_CONTEXT context;
+
+    context.confirmed = 0;
+    context.failed = 0;
+    (void)memset(context.small_payload, 'x', sizeof(context.small_payload));
+
+    if ((context.client = IoTHubClient_LL_CreateFromConnectionString(PERF_CONNECTION_STRING, Loopback_Protocol)) == NULL)
+    {
+        LogError("IoTHubClient_LL_CreateFromConnectionString failed");
+        result = __FAILURE__;
+    }
+    else
+    {
+        if ((context.message = perf_create_telemetry_message(PERF_PAYLOAD_SIZE, PERF_PROPERTY_COUNT)) == NULL)
+        {
+            LogError("Failed creating the telemetry message");
+            result = __FAILURE__;
+        }
+        else
+        {
+            if (enable_statistics && IoTHubClient_LL_SetOption(context.client, OPTION_ENABLE_STATISTICS, &enable_statistics) != IOTHUB_CLIENT_OK)
+            {
+                LogError("Failed enabling statistics");
+                result = __FAILURE__;
+            }
+            /* the small event path only avoids every allocation of the client with both the slots and the record pool */
+            else if (pool_size > 0 &&
+                (IoTHubClient_LL_SetOption(context.client, OPTION_SMALL_EVENT_SLOTS, &pool_size) != IOTHUB_CLIENT_OK ||
+                IoTHubClient_LL_SetOption(context.client, OPTION_EVENT_POOL_SIZE, &pool_size) != IOTHUB_CLIENT_OK))
+            {
+                LogError("Failed setting the small event slots");
+                result = __FAILURE__;
+            }
+            else if (perf_run(name, PERF_ITERATIONS, operation, &context, NULL) != 0)
+            {
+                result = __FAILURE__;
+            }
+            else if (drain_client(&context) != 0)
+            {
+                LogError("%s: %lu events were not confirmed", name, (unsigned long)context.failed);
+                result = __FAILURE__;
+            }
+            else
+            {
+                result = 0;
+            }
+
+            IoTHubMessage_Destroy(context.message);
+        }
+
+        IoTHubClient_LL_Destroy(context.client);
+    }
+
+    return result;
+}
+
+/* DoWork while the loopback transport injects cloud-to-device messages and method invocations, each at PERF_INBOUND_RATE per second */
+static int run_inbound_benchmark(const char* name)
+{
+    int result;
+    PERF_CLIENT_CONTEXT context;
+    unsigned int rate = PERF_INBOUND_RATE;
+
+    (void)memset(&context, 0, sizeof(context));
+
+    if ((context.client = IoTHubClient_LL_CreateFromConnectionString(PERF_CONNECTION_STRING, Loopback_Protocol)) == NULL)
+    {
+        LogError("IoTHubClient_LL_CreateFromConnectionString failed");
+        result = __FAILURE__;
+    }
+    else
+    {
+        if (IoTHubClient_LL_SetMessageCallback(context.client, on_message_received, &context) != IOTHUB_CLIENT_OK ||
+            IoTHubClient_LL_SetDeviceMethodCallback(context.client, on_method_invoked, &context) != IOTHUB_CLIENT_OK ||
+            IoTHubClient_LL_SetOption(context.client, OPTION_LOOPBACK_C2D_RATE, &rate) != IOTHUB_CLIENT_OK ||
+            IoTHubClient_LL_SetOption(context.client, OPTION_LOOPBACK_METHOD_RATE, &rate) != IOTHUB_CLIENT_OK)
+        {
+            LogError("Failed subscribing to the inbound traffic");
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = perf_run(name, PERF_ITERATIONS, receive_inbound, &context, NULL);
+        }
+
+        IoTHubClient_LL_Destroy(context.client);
+    }
+
+    return result;
+}
+
+int main(void)
+{
+    int result;
+
+    if (platform_init() != 0)
+    {
+        LogError("platform_init failed");
+        result = __FAILURE__;
+    }
+    else
+    {
+        LOOPBACK_TRANSPORT_STATISTICS statistics;
+        result = 0;
+
+        /* only the enqueue: events pile up in waitingToSend and are confirmed after the run */
+        result |= run_client_benchmark("IoTHubClient_LL_SendEventAsync", send_event, false, 0);
+        /* enqueue, loopback publish and confirmation of one event per run */
+        result |= run_client_benchmark("IoTHubClient_LL_SendEventAsync+DoWork", send_event_and_confirm, false, 0);
+        result |= run_client_benchmark("IoTHubClient_LL_SendEventAsync+DoWork (stats)", send_event_and_confirm, true, 0);
+        result |= run_client_benchmark("IoTHubClient_LL_SendEventAsync_TakeOwnership+DoWork", send_event_take_ownership_and_confirm, false, 0);
+        result |= run_client_benchmark("IoTHubClient_LL_SendSmallEvent+DoWork (64 B)", send_small_event_and_confirm, false, PERF_SMALL_EVENT_SLOTS);
+
+        result |= run_inbound_benchmark("IoTHubClient_LL_DoWork (inbound messages and methods)");
+
+        Loopback_GetStatistics(&statistics);
+        (void)printf("loopback confirmed %lu events, injected %lu messages (%lu disposed) and %lu methods (%lu answered)\r\n",
+            (unsigned long)statistics.events_confirmed, (unsigned long)statistics.messages_injected, (unsigned long)statistics.messages_disposed,
+            (unsigned long)statistics.methods_injected, (unsigned long)statistics.method_responses);
+
+        platform_deinit();
+    }
+
+    return result;
+}
@@ -0,0 +1,63 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+// Measures IoTHubMessage_Clone, which every SendEventAsync pays for once per event.
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "azure_c_shared_utility/xlogging.h"
+#include "iothub_message.h"
+#include "common/perf_harness.h"
+#include "common/perf_message.h"
+
+#define PERF_ITERATIONS             100000
+
+static int clone_and_destroy(void* ctx)
+{
+    int result;
+    IOTHUB_MESSAGE_HANDLE clone;
+
+    if ((clone = IoTHubMessage_Clone((IOTHUB_MESSAGE_HANDLE)ctx)) == NULL)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        IoTHubMessage_Destroy(clone);
+        result = 0;
+    }
+
+    return result;
+}
+
+static int run_clone_benchmark(const char* name, size_t payload_size, size_t property_count)
+{
+    int result;
+    IOTHUB_MESSAGE_HANDLE message;
+
+    if ((message = perf_create_telemetry_message(payload_size, property_count)) == NULL)
+    {
+        LogError("Failed creating the telemetry message");
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = perf_run(name, PERF_ITERATIONS, clone_and_destroy, message, NULL);
+        IoTHubMessage_Destroy(message);
+    }
+
+    return result;
+}
+
+int main(void)
+{
+    int result = 0;
+
+    result |= run_clone_benchmark("IoTHubMessage_Clone (256 B, 0 properties)", 256, 0);
+    result |= run_clone_benchmark("IoTHubMessage_Clone (256 B, 4 properties)", 256, 4);
+    result |= run_clone_benchmark("IoTHubMessage_Clone (4 KB, 4 properties)", 4096, 4);
+    result |= run_clone_benchmark("IoTHubMessage_Clone (256 B, 16 properties)", 256, 16);
+
+    return result;
+}
@@ -0,0 +1,75 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+// Measures building the MQTT publish topic (event topic plus system, user and
+// diagnostic properties) for one telemetry message.
+//
+// Topic building is static to the MQTT transport, so the transport source is
+// compiled into this benchmark directly. The executable therefore links umqtt
+// but not iothub_client_mqtt_transport.
+
+#include "../../src/iothubtransport_mqtt_common.c"
+
+#include <stdio.h>
+#include "common/perf_harness.h"
+#include "common/perf_message.h"
+
+#define PERF_ITERATIONS             100000
+#define PERF_EVENT_TOPIC            "devices/perf-device/messages/events/"
+
+typedef struct PERF_TOPIC_CONTEXT_TAG
+{
+    IOTHUB_MESSAGE_HANDLE message;
+    bool urlencode;
+} PERF_TOPIC_CONTEXT;
+
+static int build_topic(void* ctx)
+{
+    PERF_TOPIC_CONTEXT* context = (PERF_TOPIC_CONTEXT*)ctx;
+    int result;
+    STRING_HANDLE topic;
+
+    if ((topic = addPropertiesTouMqttMessage(context->message, PERF_EVENT_TOPIC, context->urlencode)) == NULL)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        STRING_delete(topic);
+        result = 0;
+    }
+
+    return result;
+}
+
+static int run_topic_benchmark(const char* name, size_t property_count, bool urlencode)
+{
+    int result;
+    PERF_TOPIC_CONTEXT context;
+
+    if ((context.message = perf_create_telemetry_message(256, property_count)) == NULL)
+    {
+        LogError("Failed creating the telemetry message");
+        result = __FAILURE__;
+    }
+    else
+    {
+        context.urlencode = urlencode;
+        result = perf_run(name, PERF_ITERATIONS, build_topic, &context, NULL);
+        IoTHubMessage_Destroy(context.message);
+    }
+
+    return result;
+}
+
+int main(void)
+{
+    int result = 0;
+
+    result |= run_topic_benchmark("MQTT event topic (0 properties)", 0, false);
+    result |= run_topic_benchmark("MQTT event topic (4 properties)", 4, false);
+    result |= run_topic_benchmark("MQTT event topic (4 properties, url encoded)", 4, true);
+    result |= run_topic_benchmark("MQTT event topic (16 properties)", 16, false);
+
+    return result;
+}
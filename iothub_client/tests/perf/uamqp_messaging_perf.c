@@ -0,0 +1,113 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+// Measures message_create_uamqp_encoding_from_iothub_message, which the AMQP
+// telemetry messenger calls once per event when it fills a batch, with and
+// without the per-messenger encoding cache.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_uamqp_c/message.h"
+#include "azure_uamqp_c/amqp_definitions.h"
+#include "iothub_message.h"
+#include "internal/uamqp_messaging.h"
+#include "common/perf_harness.h"
+#include "common/perf_message.h"
+
+#define PERF_ITERATIONS             100000
+
+typedef struct PERF_ENCODING_CONTEXT_TAG
+{
+    MESSAGE_HANDLE message_batch_container;
+    IOTHUB_MESSAGE_HANDLE message;
+    UAMQP_ENCODING_CACHE_HANDLE cache;
+} PERF_ENCODING_CONTEXT;
+
+static int encode_message(void* ctx)
+{
+    PERF_ENCODING_CONTEXT* context = (PERF_ENCODING_CONTEXT*)ctx;
+    int result;
+    BINARY_DATA body_binary_data;
+
+    body_binary_data.bytes = NULL;
+    body_binary_data.length = 0;
+
+    if (context->cache != NULL)
+    {
+        // The encoded bytes belong to the cache.
+        result = message_create_uamqp_encoding_from_iothub_message_with_cache(context->cache, context->message_batch_container, context->message, &body_binary_data);
+    }
+    else
+    {
+        if (message_create_uamqp_encoding_from_iothub_message(context->message_batch_container, context->message, &body_binary_data) != 0)
+        {
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = 0;
+        }
+
+        if (body_binary_data.bytes != NULL)
+        {
+            free((unsigned char*)body_binary_data.bytes);
+        }
+    }
+
+    return result;
+}
+
+static int run_encoding_benchmark(const char* name, size_t payload_size, size_t property_count, bool use_cache)
+{
+    int result;
+    PERF_ENCODING_CONTEXT context;
+
+    context.cache = NULL;
+
+    if ((context.message_batch_container = message_create()) == NULL)
+    {
+        LogError("message_create failed");
+        result = __FAILURE__;
+    }
+    else if (use_cache && (context.cache = uamqp_encoding_cache_create()) == NULL)
+    {
+        LogError("uamqp_encoding_cache_create failed");
+        message_destroy(context.message_batch_container);
+        result = __FAILURE__;
+    }
+    else
+    {
+        if ((context.message = perf_create_telemetry_message(payload_size, property_count)) == NULL)
+        {
+            LogError("Failed creating the telemetry message");
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = perf_run(name, PERF_ITERATIONS, encode_message, &context, NULL);
+            IoTHubMessage_Destroy(context.message);
+        }
+
+        uamqp_encoding_cache_destroy(context.cache);
+        message_destroy(context.message_batch_container);
+    }
+
+    return result;
+}
+
+int main(void)
+{
+    int result = 0;
+
+    result |= run_encoding_benchmark("AMQP encoding (256 B, 0 properties)", 256, 0, false);
+    result |= run_encoding_benchmark("AMQP encoding (256 B, 4 properties)", 256, 4, false);
+    result |= run_encoding_benchmark("AMQP encoding (4 KB, 4 properties)", 4096, 4, false);
+    result |= run_encoding_benchmark("AMQP encoding (256 B, 16 properties)", 256, 16, false);
+    result |= run_encoding_benchmark("AMQP cached encoding (256 B, 4 properties)", 256, 4, true);
+    result |= run_encoding_benchmark("AMQP cached encoding (256 B, 16 properties)", 256, 16, true);
+
+    return result;
+}
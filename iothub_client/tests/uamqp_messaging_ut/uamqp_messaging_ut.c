@@ -166,7 +166,7 @@ static int test_amqpvalue_get_uuid(AMQP_VALUE value, uuid* uuid_value)
     return test_amqpvalue_get_uuid_return;
 }
 
-static void set_exp_calls_for_create_encoded_annotations_properties(bool has_diagnostic_properties)
+static void set_exp_calls_for_create_encoded_annotations_properties(bool has_diagnostic_properties, bool sized)
 {
     size_t encoding_size = TEST_AMQP_ENCODING_SIZE;
 
@@ -190,8 +190,11 @@ static void set_exp_calls_for_create_encoded_annotations_properties(bool has_dia
         STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
 
         STRICT_EXPECTED_CALL(amqpvalue_create_message_annotations(TEST_AMQP_VALUE));
-        STRICT_EXPECTED_CALL(amqpvalue_get_encoded_size(TEST_AMQP_VALUE, IGNORED_PTR_ARG))
-            .CopyOutArgumentBuffer(2, &encoding_size, sizeof(encoding_size));
+        if (sized)
+        {
+            STRICT_EXPECTED_CALL(amqpvalue_get_encoded_size(TEST_AMQP_VALUE, IGNORED_PTR_ARG))
+                .CopyOutArgumentBuffer(2, &encoding_size, sizeof(encoding_size));
+        }
         STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
         STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
     }
@@ -201,7 +204,7 @@ static void set_exp_calls_for_create_encoded_annotations_properties(bool has_dia
     }
 }
 
-static void set_exp_calls_for_create_encoded_message_properties(bool has_message_id, bool has_correlation_id, const char* content_type, const char* content_encoding)
+static void set_exp_calls_for_create_encoded_message_properties(bool has_message_id, bool has_correlation_id, const char* content_type, const char* content_encoding, bool sized)
 {
     size_t encoding_size = TEST_AMQP_ENCODING_SIZE;
 
@@ -248,17 +251,19 @@ static void set_exp_calls_for_create_encoded_message_properties(bool has_message
     }
 
     STRICT_EXPECTED_CALL(amqpvalue_create_properties(TEST_PROPERTIES_HANDLE));
-    STRICT_EXPECTED_CALL(amqpvalue_get_encoded_size(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .CopyOutArgumentBuffer(2, &encoding_size, sizeof(encoding_size));
+    if (sized)
+    {
+        STRICT_EXPECTED_CALL(amqpvalue_get_encoded_size(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .CopyOutArgumentBuffer(2, &encoding_size, sizeof(encoding_size));
+    }
     STRICT_EXPECTED_CALL(properties_destroy(TEST_PROPERTIES_HANDLE));
 }
 
-static void set_exp_calls_for_create_encoded_application_properties(size_t number_of_app_properties)
+static void set_exp_calls_for_create_encoded_application_properties(size_t number_of_app_properties, bool sized)
 {
     size_t encoding_size = TEST_AMQP_ENCODING_SIZE;
 
-    STRICT_EXPECTED_CALL(IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE)); //16
-    STRICT_EXPECTED_CALL(Map_GetInternals(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetProperties(TEST_IOTHUB_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG)) //16
         .CopyOutArgumentBuffer(2, &TEST_MAP_KEYS, sizeof(TEST_MAP_KEYS))
         .CopyOutArgumentBuffer(3, &TEST_MAP_VALUES, sizeof(TEST_MAP_VALUES))
         .CopyOutArgumentBuffer(4, &number_of_app_properties, sizeof(number_of_app_properties));
@@ -277,13 +282,16 @@ static void set_exp_calls_for_create_encoded_application_properties(size_t numbe
         }
 
         STRICT_EXPECTED_CALL(amqpvalue_create_application_properties(TEST_AMQP_VALUE));
-        STRICT_EXPECTED_CALL(amqpvalue_get_encoded_size(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .CopyOutArgumentBuffer(2, &encoding_size, sizeof(encoding_size));
+        if (sized)
+        {
+            STRICT_EXPECTED_CALL(amqpvalue_get_encoded_size(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+                .CopyOutArgumentBuffer(2, &encoding_size, sizeof(encoding_size));
+        }
         STRICT_EXPECTED_CALL(amqpvalue_destroy(IGNORED_PTR_ARG));
     }
 }
 
-static void set_exp_calls_for_create_encoded_data(IOTHUBMESSAGE_CONTENT_TYPE msg_content_type)
+static void set_exp_calls_for_create_encoded_data(IOTHUBMESSAGE_CONTENT_TYPE msg_content_type, bool sized)
 {
     size_t encoding_size = TEST_AMQP_ENCODING_SIZE;
 
@@ -301,16 +309,19 @@ static void set_exp_calls_for_create_encoded_data(IOTHUBMESSAGE_CONTENT_TYPE msg
     data d;
     memset(&d, 0, sizeof(d));
     STRICT_EXPECTED_CALL(amqpvalue_create_data(d)).IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(amqpvalue_get_encoded_size(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .CopyOutArgumentBuffer(2, &encoding_size, sizeof(encoding_size));
+    if (sized)
+    {
+        STRICT_EXPECTED_CALL(amqpvalue_get_encoded_size(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .CopyOutArgumentBuffer(2, &encoding_size, sizeof(encoding_size));
+    }
 }
 
 static void set_exp_calls_for_message_create_uamqp_encoding_from_iothub_message(size_t number_of_app_properties, IOTHUBMESSAGE_CONTENT_TYPE msg_content_type, bool has_message_id, bool has_correlation_id, bool has_diag_properties, const char* content_type, const char* content_encoding)
 {
-    set_exp_calls_for_create_encoded_message_properties(has_message_id, has_correlation_id, content_type, content_encoding);
-    set_exp_calls_for_create_encoded_application_properties(number_of_app_properties);
-    set_exp_calls_for_create_encoded_annotations_properties(has_diag_properties);
-    set_exp_calls_for_create_encoded_data(msg_content_type);
+    set_exp_calls_for_create_encoded_message_properties(has_message_id, has_correlation_id, content_type, content_encoding, true);
+    set_exp_calls_for_create_encoded_application_properties(number_of_app_properties, true);
+    set_exp_calls_for_create_encoded_annotations_properties(has_diag_properties, true);
+    set_exp_calls_for_create_encoded_data(msg_content_type, true);
 
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
         .SetReturn(g_encoding_buffer);
@@ -340,6 +351,66 @@ static void set_exp_calls_for_message_create_uamqp_encoding_from_iothub_message(
     STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
 }
 
+static unsigned char TEST_ENCODED_SECTION[TEST_AMQP_ENCODING_SIZE] = { 0x00, 0x53, 0x73, 0xc0, 0x00 };
+
+static int test_amqpvalue_encode(AMQP_VALUE value, AMQPVALUE_ENCODER_OUTPUT encoder_output, void* context)
+{
+    (void)value;
+    return encoder_output(context, TEST_ENCODED_SECTION, sizeof(TEST_ENCODED_SECTION));
+}
+
+static void set_exp_calls_for_encoding_cache_lookup(size_t number_of_app_properties, const char* content_type, const char* content_encoding)
+{
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetMessageId(TEST_IOTHUB_MESSAGE_HANDLE)).SetReturn(NULL);
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetCorrelationId(TEST_IOTHUB_MESSAGE_HANDLE)).SetReturn(NULL);
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentTypeSystemProperty(TEST_IOTHUB_MESSAGE_HANDLE)).SetReturn(content_type);
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentEncodingSystemProperty(TEST_IOTHUB_MESSAGE_HANDLE)).SetReturn(content_encoding);
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetProperties(TEST_IOTHUB_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(2, &TEST_MAP_KEYS, sizeof(TEST_MAP_KEYS))
+        .CopyOutArgumentBuffer(3, &TEST_MAP_VALUES, sizeof(TEST_MAP_VALUES))
+        .CopyOutArgumentBuffer(4, &number_of_app_properties, sizeof(number_of_app_properties));
+}
+
+// Encoding with an empty cache: every section is encoded, then the properties sections are saved.
+static void set_exp_calls_for_message_create_uamqp_encoding_with_empty_cache(size_t number_of_app_properties, const char* content_type, const char* content_encoding)
+{
+    size_t i;
+
+    set_exp_calls_for_encoding_cache_lookup(number_of_app_properties, content_type, content_encoding);
+    set_exp_calls_for_create_encoded_message_properties(false, false, content_type, content_encoding, false);
+    set_exp_calls_for_create_encoded_application_properties(number_of_app_properties, false);
+    set_exp_calls_for_create_encoded_annotations_properties(false, false);
+    set_exp_calls_for_create_encoded_data(IOTHUBMESSAGE_BYTEARRAY, false);
+
+    STRICT_EXPECTED_CALL(amqpvalue_encode(TEST_AMQP_VALUE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)); // the encoding buffer grows on the first bytes written
+    STRICT_EXPECTED_CALL(gballoc_free(NULL));
+    STRICT_EXPECTED_CALL(amqpvalue_encode(TEST_AMQP_VALUE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(amqpvalue_encode(TEST_AMQP_VALUE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+    // message properties: the empty section is cleared, then names, values, content type, content encoding and bytes are saved
+    STRICT_EXPECTED_CALL(gballoc_free(NULL));
+    STRICT_EXPECTED_CALL(gballoc_free(NULL));
+    STRICT_EXPECTED_CALL(gballoc_free(NULL));
+    for (i = 0; i < 5; i++)
+    {
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    }
+
+    // application properties: the empty section is cleared, then names, values, each name and value and bytes are saved
+    STRICT_EXPECTED_CALL(gballoc_free(NULL));
+    STRICT_EXPECTED_CALL(gballoc_free(NULL));
+    STRICT_EXPECTED_CALL(gballoc_free(NULL));
+    for (i = 0; i < 3 + 2 * number_of_app_properties; i++)
+    {
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    }
+
+    STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
+    STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
+    STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
+}
+
 static void set_exp_calls_for_message_create_IoTHubMessage_from_uamqp_message(
     size_t number_of_properties,
     bool has_message_id,
@@ -564,6 +635,9 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_GLOBAL_MOCK_RETURN(IoTHubMessage_Properties, TEST_MAP_HANDLE);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubMessage_Properties, NULL);
 
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubMessage_GetProperties, IOTHUB_MESSAGE_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubMessage_GetProperties, IOTHUB_MESSAGE_ERROR);
+
     REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_create_map, TEST_AMQP_VALUE);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(amqpvalue_create_map, NULL);
 
@@ -908,20 +982,20 @@ TEST_FUNCTION(message_create_from_iothub_message_BYTEARRAY_return_errors_fails)
             (i == 4) || // amqpvalue_destroy
             (i == 8) || // amqpvalue_destroy
             (i == 15) || // properties_destroy
+            (i == 21) || // amqpvalue_destroy
             (i == 22) || // amqpvalue_destroy
-            (i == 23) || // amqpvalue_destroy
-            (i == 26) || // amqpvalue_destroy
-            (i == 27) || //IoTHubMessage_GetDiagnosticPropertyData is optional
+            (i == 25) || // amqpvalue_destroy
+            (i == 26) || //IoTHubMessage_GetDiagnosticPropertyData is optional
+            (i == 31) || // amqpvalue_destroy
             (i == 32) || // amqpvalue_destroy
-            (i == 33) || // amqpvalue_destroy
+            (i == 37) || // amqpvalue_destroy
             (i == 38) || // amqpvalue_destroy
-            (i == 39) || // amqpvalue_destroy
-            (i == 42) || // free
-            (i == 43) || // amqpvalue_destroy
+            (i == 41) || // free
+            (i == 42) || // amqpvalue_destroy
+            (i == 52) || // amqpvalue_destroy
             (i == 53) || // amqpvalue_destroy
             (i == 54) || // amqpvalue_destroy
-            (i == 55) || // amqpvalue_destroy
-            (i == 56) // amqpvalue_destroy
+            (i == 55) // amqpvalue_destroy
             )
         {
             continue; // these lines have functions that do not return anything (void).
@@ -971,20 +1045,20 @@ TEST_FUNCTION(message_create_from_iothub_message_STRING_return_errors_fails)
             (i == 4) || // amqpvalue_destroy
             (i == 8) || // amqpvalue_destroy
             (i == 15) || // properties_destroy
+            (i == 21) || // amqpvalue_destroy
             (i == 22) || // amqpvalue_destroy
-            (i == 23) || // amqpvalue_destroy
-            (i == 26) || // amqpvalue_destroy
-            (i == 27) || //IoTHubMessage_GetDiagnosticPropertyData is optional
+            (i == 25) || // amqpvalue_destroy
+            (i == 26) || //IoTHubMessage_GetDiagnosticPropertyData is optional
+            (i == 31) || // amqpvalue_destroy
             (i == 32) || // amqpvalue_destroy
-            (i == 33) || // amqpvalue_destroy
+            (i == 37) || // amqpvalue_destroy
             (i == 38) || // amqpvalue_destroy
-            (i == 39) || // amqpvalue_destroy
-            (i == 42) || // free
-            (i == 43) || // amqpvalue_destroy
+            (i == 41) || // free
+            (i == 42) || // amqpvalue_destroy
+            (i == 52) || // amqpvalue_destroy
             (i == 53) || // amqpvalue_destroy
             (i == 54) || // amqpvalue_destroy
-            (i == 55) || // amqpvalue_destroy
-            (i == 56) // amqpvalue_destroy
+            (i == 55) // amqpvalue_destroy
            )
         {
             continue; // these lines have functions that do not return anything (void).
@@ -1006,6 +1080,154 @@ TEST_FUNCTION(message_create_from_iothub_message_STRING_return_errors_fails)
     umock_c_negative_tests_deinit();
 }
 
+// Tests_SRS_UAMQP_MESSAGING_41_001: [uamqp_encoding_cache_create shall allocate an empty cache, returning NULL if it fails.]
+// Tests_SRS_UAMQP_MESSAGING_41_002: [uamqp_encoding_cache_destroy shall free the cached sections and the encoding buffer; a NULL cache is ignored.]
+TEST_FUNCTION(uamqp_encoding_cache_create_and_destroy_success)
+{
+    // arrange
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    // names, values and bytes of both (empty) sections
+    STRICT_EXPECTED_CALL(gballoc_free(NULL));
+    STRICT_EXPECTED_CALL(gballoc_free(NULL));
+    STRICT_EXPECTED_CALL(gballoc_free(NULL));
+    STRICT_EXPECTED_CALL(gballoc_free(NULL));
+    STRICT_EXPECTED_CALL(gballoc_free(NULL));
+    STRICT_EXPECTED_CALL(gballoc_free(NULL));
+    STRICT_EXPECTED_CALL(gballoc_free(NULL)); // buffer
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    UAMQP_ENCODING_CACHE_HANDLE cache = uamqp_encoding_cache_create();
+    uamqp_encoding_cache_destroy(cache);
+    uamqp_encoding_cache_destroy(NULL);
+
+    // assert
+    ASSERT_IS_NOT_NULL(cache);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_UAMQP_MESSAGING_41_001: [uamqp_encoding_cache_create shall allocate an empty cache, returning NULL if it fails.]
+TEST_FUNCTION(uamqp_encoding_cache_create_malloc_fails)
+{
+    // arrange
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)).SetReturn(NULL);
+
+    // act
+    UAMQP_ENCODING_CACHE_HANDLE cache = uamqp_encoding_cache_create();
+
+    // assert
+    ASSERT_IS_NULL(cache);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_UAMQP_MESSAGING_41_006: [If `cache` is NULL, message_create_uamqp_encoding_from_iothub_message_with_cache shall fail and return a non-zero value.]
+TEST_FUNCTION(message_create_uamqp_encoding_from_iothub_message_with_cache_NULL_cache_fails)
+{
+    // arrange
+    BINARY_DATA binary_data;
+    memset(&binary_data, 0, sizeof(binary_data));
+    umock_c_reset_all_calls();
+
+    // act
+    int result = message_create_uamqp_encoding_from_iothub_message_with_cache(NULL, NULL, TEST_IOTHUB_MESSAGE_HANDLE, &binary_data);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_UAMQP_MESSAGING_41_003: [With a cache, message properties without message-id and correlation-id shall be copied from the cache if they were last encoded from the same content-type and content-encoding.]
+// Tests_SRS_UAMQP_MESSAGING_41_004: [With a cache, application properties shall be copied from the cache if they were last encoded from the same keys and values.]
+// Tests_SRS_UAMQP_MESSAGING_41_005: [With a cache, the encoding shall be written to a buffer owned by the cache and reused by the next message, growing it when needed.]
+// Tests_SRS_UAMQP_MESSAGING_41_007: [With a cache, sections shall not be sized with amqpvalue_get_encoded_size but encoded once, in order, straight into the cache buffer.]
+TEST_FUNCTION(message_create_uamqp_encoding_from_iothub_message_with_cache_reuses_encoded_sections)
+{
+    // arrange
+    UAMQP_ENCODING_CACHE_HANDLE cache = uamqp_encoding_cache_create();
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_encode, test_amqpvalue_encode);
+    BINARY_DATA first_binary_data;
+    BINARY_DATA binary_data;
+    memset(&first_binary_data, 0, sizeof(first_binary_data));
+    memset(&binary_data, 0, sizeof(binary_data));
+
+    umock_c_reset_all_calls();
+    set_exp_calls_for_message_create_uamqp_encoding_with_empty_cache(1, TEST_CONTENT_TYPE, TEST_CONTENT_ENCODING);
+    ASSERT_ARE_EQUAL(int, 0, message_create_uamqp_encoding_from_iothub_message_with_cache(cache, NULL, TEST_IOTHUB_MESSAGE_HANDLE, &first_binary_data));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    umock_c_reset_all_calls();
+    set_exp_calls_for_encoding_cache_lookup(1, TEST_CONTENT_TYPE, TEST_CONTENT_ENCODING);
+    set_exp_calls_for_create_encoded_annotations_properties(false, false);
+    set_exp_calls_for_create_encoded_data(IOTHUBMESSAGE_BYTEARRAY, false);
+    STRICT_EXPECTED_CALL(amqpvalue_encode(TEST_AMQP_VALUE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
+
+    // act
+    int result = message_create_uamqp_encoding_from_iothub_message_with_cache(cache, NULL, TEST_IOTHUB_MESSAGE_HANDLE, &binary_data);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(void_ptr, first_binary_data.bytes, binary_data.bytes);
+    ASSERT_ARE_EQUAL(size_t, TEST_AMQP_ENCODING_SIZE * 3, binary_data.length);
+
+    // cleanup
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_encode, NULL);
+    uamqp_encoding_cache_destroy(cache);
+}
+
+// Tests_SRS_UAMQP_MESSAGING_41_004: [With a cache, application properties shall be copied from the cache if they were last encoded from the same keys and values.]
+TEST_FUNCTION(message_create_uamqp_encoding_from_iothub_message_with_cache_changed_property_value_is_encoded)
+{
+    // arrange
+    UAMQP_ENCODING_CACHE_HANDLE cache = uamqp_encoding_cache_create();
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_encode, test_amqpvalue_encode);
+    char* original_value = TEST_MAP_VALUES[0];
+    BINARY_DATA binary_data;
+    memset(&binary_data, 0, sizeof(binary_data));
+
+    umock_c_reset_all_calls();
+    set_exp_calls_for_message_create_uamqp_encoding_with_empty_cache(1, TEST_CONTENT_TYPE, TEST_CONTENT_ENCODING);
+    ASSERT_ARE_EQUAL(int, 0, message_create_uamqp_encoding_from_iothub_message_with_cache(cache, NULL, TEST_IOTHUB_MESSAGE_HANDLE, &binary_data));
+
+    TEST_MAP_VALUES[0] = "Another value";
+
+    umock_c_reset_all_calls();
+    set_exp_calls_for_encoding_cache_lookup(1, TEST_CONTENT_TYPE, TEST_CONTENT_ENCODING);
+    set_exp_calls_for_create_encoded_application_properties(1, false);
+    set_exp_calls_for_create_encoded_annotations_properties(false, false);
+    set_exp_calls_for_create_encoded_data(IOTHUBMESSAGE_BYTEARRAY, false);
+    STRICT_EXPECTED_CALL(amqpvalue_encode(TEST_AMQP_VALUE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(amqpvalue_encode(TEST_AMQP_VALUE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    // previous application properties are released before saving the new ones
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
+    STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
+
+    // act
+    int result = message_create_uamqp_encoding_from_iothub_message_with_cache(cache, NULL, TEST_IOTHUB_MESSAGE_HANDLE, &binary_data);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    // cleanup
+    REGISTER_GLOBAL_MOCK_HOOK(amqpvalue_encode, NULL);
+    TEST_MAP_VALUES[0] = original_value;
+    uamqp_encoding_cache_destroy(cache);
+}
+
 // Tests_SRS_UAMQP_MESSAGING_09_001: [The body type of the uAMQP message shall be retrieved using message_get_body_type().]
 // Tests_SRS_UAMQP_MESSAGING_09_003: [If the uAMQP message body type is MESSAGE_BODY_TYPE_DATA, the body data shall be treated as binary data.]
 // Tests_SRS_UAMQP_MESSAGING_09_004: [The uAMQP message body data shall be retrieved using message_get_body_amqp_data_in_place().]
@@ -0,0 +1,36 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef IOTHUB_SC_HTTP_POOL_H
+#define IOTHUB_SC_HTTP_POOL_H
+
+#include "azure_c_shared_utility/macro_utils.h"
+#include "azure_c_shared_utility/buffer_.h"
+#include "azure_c_shared_utility/httpheaders.h"
+#include "azure_c_shared_utility/httpapiex.h"
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*idle keep-alive connections kept per pool; further concurrent requests open a connection for their own use*/
+#define IOTHUB_SC_HTTP_POOL_MAX_IDLE_CONNECTIONS 4
+
+/*lifetime of a generated SAS token and how long before its expiry it is regenerated, in seconds*/
+#define IOTHUB_SC_HTTP_POOL_SAS_TOKEN_LIFETIME 3600
+#define IOTHUB_SC_HTTP_POOL_SAS_TOKEN_REFRESH_MARGIN 300
+
+typedef struct IOTHUB_SC_HTTP_POOL_TAG* IOTHUB_SC_HTTP_POOL_HANDLE;
+
+MOCKABLE_FUNCTION(, IOTHUB_SC_HTTP_POOL_HANDLE, IoTHubSCHttpPool_Create, const char*, hostname, const char*, sharedAccessKey, const char*, keyName, const char*, deviceId);
+MOCKABLE_FUNCTION(, IOTHUB_SC_HTTP_POOL_HANDLE, IoTHubSCHttpPool_Clone, IOTHUB_SC_HTTP_POOL_HANDLE, httpPoolHandle);
+MOCKABLE_FUNCTION(, void, IoTHubSCHttpPool_Destroy, IOTHUB_SC_HTTP_POOL_HANDLE, httpPoolHandle);
+MOCKABLE_FUNCTION(, HTTPAPIEX_RESULT, IoTHubSCHttpPool_ExecuteRequest, IOTHUB_SC_HTTP_POOL_HANDLE, httpPoolHandle, HTTPAPI_REQUEST_TYPE, requestType, const char*, relativePath, HTTP_HEADERS_HANDLE, requestHttpHeadersHandle, BUFFER_HANDLE, requestContent, unsigned int*, statusCode, HTTP_HEADERS_HANDLE, responseHttpHeadersHandle, BUFFER_HANDLE, responseContent);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IOTHUB_SC_HTTP_POOL_H
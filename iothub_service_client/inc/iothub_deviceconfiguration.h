@@ -9,6 +9,7 @@
 #include "azure_c_shared_utility/crt_abstractions.h"
 #include "azure_c_shared_utility/singlylinkedlist.h"
 #include <time.h>
+#include <stdbool.h>
 #include "iothub_service_client_auth.h"
 
 #include "azure_c_shared_utility/umock_c_prod.h"
@@ -133,6 +134,27 @@ MOCKABLE_FUNCTION(, void, IoTHubDeviceConfiguration_Destroy, IOTHUB_SERVICE_CLIE
 */
 MOCKABLE_FUNCTION(, IOTHUB_DEVICE_CONFIGURATION_RESULT, IoTHubDeviceConfiguration_GetConfigurations, IOTHUB_SERVICE_CLIENT_DEVICE_CONFIGURATION_HANDLE, serviceClientDeviceConfigurationHandle, size_t, maxConfigurationsCount, SINGLYLINKEDLIST_HANDLE, configurationsList);
 
+/** @brief  Callback receiving the configurations enumerated by IoTHubDeviceConfiguration_EnumerateConfigurations.
+*
+* @param    context         The context given to IoTHubDeviceConfiguration_EnumerateConfigurations.
+* @param    configuration   Read-only view of the configuration, only valid during the call: copy what has to be kept.
+*
+* @return   true to continue the enumeration, false to stop it.
+*/
+typedef bool(*IOTHUB_DEVICE_CONFIGURATION_ENUMERATE_CALLBACK)(void* context, const IOTHUB_DEVICE_CONFIGURATION* configuration);
+
+/** @brief  Retrieves the same configurations as IoTHubDeviceConfiguration_GetConfigurations, but hands them one by one
+*           to a callback as read-only views into the parsed response instead of copying each of them into a list.
+*
+* @param    serviceClientDeviceConfigurationHandle    The handle created by a call to the create function.
+* @param    maxConfigurationsCount                    Maximum number of configurations requested
+* @param    configurationCallback                     Called once per configuration.
+* @param    context                                   User context passed to configurationCallback.
+*
+* @return   IOTHUB_DEVICE_CONFIGURATION_OK upon success or an error code upon failure.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_DEVICE_CONFIGURATION_RESULT, IoTHubDeviceConfiguration_EnumerateConfigurations, IOTHUB_SERVICE_CLIENT_DEVICE_CONFIGURATION_HANDLE, serviceClientDeviceConfigurationHandle, size_t, maxConfigurationsCount, IOTHUB_DEVICE_CONFIGURATION_ENUMERATE_CALLBACK, configurationCallback, void*, context);
+
 /** @brief  Retrieves the Configuration info for specified configurationId from IoT Hub.
 *
 * @param    serviceClientDeviceConfigurationHandle    The handle created by a call to the create function.
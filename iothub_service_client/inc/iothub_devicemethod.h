@@ -28,6 +28,20 @@ DEFINE_ENUM(IOTHUB_DEVICE_METHOD_RESULT, IOTHUB_DEVICE_METHOD_RESULT_VALUES);
 */
 typedef struct IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_TAG* IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE;
 
+/** @brief Default number of asynchronous invocations executed at the same time by one handle
+*/
+#define IOTHUB_DEVICE_METHOD_DEFAULT_MAX_CONCURRENT_INVOCATIONS 16
+
+/** @brief    Callback invoked by IoTHubDeviceMethod_DoWork when an asynchronous invocation completes.
+*
+* @param    context                 The context given to IoTHubDeviceMethod_InvokeAsync or IoTHubDeviceMethod_InvokeModuleAsync.
+* @param    result                  The result of the invocation, as IoTHubDeviceMethod_Invoke would have returned it.
+* @param    responseStatus          Response status code from invocation, valid if result is IOTHUB_DEVICE_METHOD_OK.
+* @param    responsePayload         Response payload, only valid during the callback.
+* @param    responsePayloadSize     String length of responsePayload.
+*/
+typedef void(*IOTHUB_DEVICE_METHOD_INVOKE_COMPLETE_CALLBACK)(void* context, IOTHUB_DEVICE_METHOD_RESULT result, int responseStatus, const unsigned char* responsePayload, size_t responsePayloadSize);
+
 /** @brief    Creates a IoT Hub Service Client DeviceMethod handle for use it in consequent APIs.
 *
 * @param    serviceClientHandle    Service client handle.
@@ -75,6 +89,57 @@ MOCKABLE_FUNCTION(, IOTHUB_DEVICE_METHOD_RESULT, IoTHubDeviceMethod_Invoke, IOTH
 */
 MOCKABLE_FUNCTION(, IOTHUB_DEVICE_METHOD_RESULT, IoTHubDeviceMethod_InvokeModule, IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE, serviceClientDeviceMethodHandle, const char*, deviceId, const char*, moduleId, const char*, methodName, const char*, methodPayload, unsigned int, timeout, int*, responseStatus, unsigned char**, responsePayload, size_t*, responsePayloadSize);
 
+/** @brief    Queue a method call on a device without waiting for the response.
+*
+* @param    serviceClientDeviceMethodHandle    The handle created by a call to the create function.
+* @param    deviceId                        The device name (id) to call a method on.
+* @param    methodName                      The method name to call.
+* @param    methodPayload                   The message payload to send.
+* @param    timeout                         Time before the invocation times out.
+* @param    invokeCompleteCallback          Callback invoked by IoTHubDeviceMethod_DoWork with the response.
+* @param    context                         User specified context passed to invokeCompleteCallback.
+*
+* @remarks  At most IoTHubDeviceMethod_SetMaxConcurrentInvocations invocations are executed at the
+*           same time, further ones stay queued. The callback of an invocation still queued or not
+*           yet dispatched when the handle is destroyed is called by IoTHubDeviceMethod_Destroy.
+*
+* @return    IOTHUB_DEVICE_METHOD_OK if the invocation has been queued.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_DEVICE_METHOD_RESULT, IoTHubDeviceMethod_InvokeAsync, IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE, serviceClientDeviceMethodHandle, const char*, deviceId, const char*, methodName, const char*, methodPayload, unsigned int, timeout, IOTHUB_DEVICE_METHOD_INVOKE_COMPLETE_CALLBACK, invokeCompleteCallback, void*, context);
+
+/** @brief    Queue a method call on a module without waiting for the response.
+*
+* @param    serviceClientDeviceMethodHandle    The handle created by a call to the create function.
+* @param    deviceId                        The device name (id) to call a method on.
+* @param    moduleId                        The module name (id) to call a method on.
+* @param    methodName                      The method name to call.
+* @param    methodPayload                   The message payload to send.
+* @param    timeout                         Time before the invocation times out.
+* @param    invokeCompleteCallback          Callback invoked by IoTHubDeviceMethod_DoWork with the response.
+* @param    context                         User specified context passed to invokeCompleteCallback.
+*
+* @return    IOTHUB_DEVICE_METHOD_OK if the invocation has been queued.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_DEVICE_METHOD_RESULT, IoTHubDeviceMethod_InvokeModuleAsync, IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE, serviceClientDeviceMethodHandle, const char*, deviceId, const char*, moduleId, const char*, methodName, const char*, methodPayload, unsigned int, timeout, IOTHUB_DEVICE_METHOD_INVOKE_COMPLETE_CALLBACK, invokeCompleteCallback, void*, context);
+
+/** @brief    Sets how many asynchronous invocations the handle executes at the same time.
+*
+* @param    serviceClientDeviceMethodHandle    The handle created by a call to the create function.
+* @param    maxConcurrentInvocations        Size of the window, IOTHUB_DEVICE_METHOD_DEFAULT_MAX_CONCURRENT_INVOCATIONS by default.
+*
+* @return    An IOTHUB_DEVICE_METHOD_RESULT containing the return status.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_DEVICE_METHOD_RESULT, IoTHubDeviceMethod_SetMaxConcurrentInvocations, IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE, serviceClientDeviceMethodHandle, size_t, maxConcurrentInvocations);
+
+/** @brief    Calls the completion callbacks of the asynchronous invocations that completed since the last call.
+*
+* @param    serviceClientDeviceMethodHandle    The handle created by a call to the create function.
+*
+* @remarks  IoTHubDeviceMethod_InvokeAsync, IoTHubDeviceMethod_InvokeModuleAsync, IoTHubDeviceMethod_DoWork
+*           and IoTHubDeviceMethod_Destroy shall be called from the same thread.
+*/
+MOCKABLE_FUNCTION(, void, IoTHubDeviceMethod_DoWork, IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE, serviceClientDeviceMethodHandle);
+
 
 #ifdef __cplusplus
 }
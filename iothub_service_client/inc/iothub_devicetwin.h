@@ -10,6 +10,7 @@
 #include "azure_c_shared_utility/singlylinkedlist.h"
 #include "azure_c_shared_utility/map.h"
 #include <time.h>
+#include <stdbool.h>
 #include "iothub_service_client_auth.h"
 
 #include "azure_c_shared_utility/umock_c_prod.h"
@@ -92,6 +93,64 @@ MOCKABLE_FUNCTION(, char*,  IoTHubDeviceTwin_GetModuleTwin, IOTHUB_SERVICE_CLIEN
 */
 MOCKABLE_FUNCTION(, char*,  IoTHubDeviceTwin_UpdateModuleTwin, IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE, serviceClientDeviceTwinHandle, const char*, deviceId, const char*, moduleId, const char*, moduleTwinJson);
 
+/** @brief  Default number of twin updates IoTHubDeviceTwin_UpdateTwins keeps in flight at the same time,
+*           one per idle keep-alive connection of the service client connection pool.
+*/
+#define IOTHUB_DEVICE_TWIN_DEFAULT_MAX_CONCURRENT_UPDATES 4
+
+/** @brief  One twin update of a batch submitted to IoTHubDeviceTwin_UpdateTwins.
+*           deviceId, moduleId, twinPatchJson and eTag are set by the caller, result and statusCode
+*           are set by IoTHubDeviceTwin_UpdateTwins once the update has been executed.
+*/
+typedef struct IOTHUB_DEVICE_TWIN_UPDATE_TAG
+{
+    const char* deviceId;                   /**< The device name (id) to update the twin of. */
+    const char* moduleId;                   /**< The module name (id) to update the twin of, NULL to update the device twin. */
+    const char* twinPatchJson;              /**< Twin JSon string containing the info (tags, desired properties) to update. */
+    const char* eTag;                       /**< The etag of the twin the patch was computed from, as returned in its "etag" member.
+                                                 The update fails with statusCode 412 if the twin changed since. NULL to update unconditionally. */
+    IOTHUB_DEVICE_TWIN_RESULT result;       /**< IOTHUB_DEVICE_TWIN_OK if the twin was updated. */
+    unsigned int statusCode;                /**< The HTTP status code returned by the IoTHub, 0 if the request could not be sent. */
+} IOTHUB_DEVICE_TWIN_UPDATE;
+
+/** @brief  Callback receiving the twins returned by IoTHubDeviceTwin_QueryTwins.
+*
+* @param    context     The context given to IoTHubDeviceTwin_QueryTwins.
+* @param    twinJson    The twin JSon, only valid during the call: copy what has to be kept.
+*
+* @return   true to continue the query, false to stop it.
+*/
+typedef bool(*IOTHUB_DEVICE_TWIN_QUERY_CALLBACK)(void* context, const char* twinJson);
+
+/** @brief  Runs a query (e.g. "SELECT * FROM devices WHERE tags.location = 'plant1'") on the device twins
+*           and streams the result, page by page, to a callback. Memory use is bounded by one page no matter
+*           how many twins match.
+*
+* @param    serviceClientDeviceTwinHandle   The handle created by a call to the create function.
+* @param    query                           The IoTHub query string.
+* @param    pageSize                        Number of twins requested per page, between 1 and 1000.
+* @param    twinCallback                    Called once per twin.
+* @param    context                         User context passed to twinCallback.
+*
+* @return   IOTHUB_DEVICE_TWIN_OK upon success or an error code upon failure.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_DEVICE_TWIN_RESULT, IoTHubDeviceTwin_QueryTwins, IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE, serviceClientDeviceTwinHandle, const char*, query, size_t, pageSize, IOTHUB_DEVICE_TWIN_QUERY_CALLBACK, twinCallback, void*, context);
+
+/** @brief  Executes a batch of (partial) twin updates, keeping up to maxConcurrentUpdates of them in flight at
+*           the same time on the connections of the service client connection pool. Returns once every update
+*           has been executed; the outcome of each one is stored in its result and statusCode members. The
+*           updated twins are not returned.
+*
+* @param    serviceClientDeviceTwinHandle   The handle created by a call to the create function.
+* @param    updates                         The updates to execute.
+* @param    updateCount                     Number of entries in updates.
+* @param    maxConcurrentUpdates            Number of updates executed at the same time, at least 1.
+*                                           IOTHUB_DEVICE_TWIN_DEFAULT_MAX_CONCURRENT_UPDATES fits the connection pool.
+*
+* @return   IOTHUB_DEVICE_TWIN_OK if every update succeeded, IOTHUB_DEVICE_TWIN_ERROR if any of them failed.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_DEVICE_TWIN_RESULT, IoTHubDeviceTwin_UpdateTwins, IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE, serviceClientDeviceTwinHandle, IOTHUB_DEVICE_TWIN_UPDATE*, updates, size_t, updateCount, size_t, maxConcurrentUpdates);
+
 #ifdef __cplusplus
 }
 #endif
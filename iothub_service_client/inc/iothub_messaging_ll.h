@@ -67,9 +67,14 @@ typedef struct IOTHUB_SERVICE_FEEDBACK_BATCH_TAG
 
 typedef struct IOTHUB_MESSAGING_TAG* IOTHUB_MESSAGING_HANDLE;
 
+/*upper bound of IoTHubMessaging_LL_SetSenderLinkCount*/
+#define IOTHUB_MESSAGING_MAX_SENDER_LINKS 16
+
 typedef void(*IOTHUB_OPEN_COMPLETE_CALLBACK)(void* context);
 typedef void(*IOTHUB_SEND_COMPLETE_CALLBACK)(void* context, IOTHUB_MESSAGING_RESULT messagingResult);
+typedef void(*IOTHUB_SEND_BATCH_COMPLETE_CALLBACK)(void* context, const char* deviceId, IOTHUB_MESSAGING_RESULT messagingResult);
 typedef void(*IOTHUB_FEEDBACK_MESSAGE_RECEIVED_CALLBACK)(void* context, IOTHUB_SERVICE_FEEDBACK_BATCH* feedbackBatch);
+typedef void(*IOTHUB_FEEDBACK_RECORD_RECEIVED_CALLBACK)(void* context, const IOTHUB_SERVICE_FEEDBACK_RECORD* feedbackRecord);
 
 /** @brief    Creates a IoT Hub Service Client Messaging handle for use it in consequent APIs.
 *
@@ -126,6 +131,33 @@ MOCKABLE_FUNCTION(, void, IoTHubMessaging_LL_Close, IOTHUB_MESSAGING_HANDLE, mes
 */
 MOCKABLE_FUNCTION(, IOTHUB_MESSAGING_RESULT, IoTHubMessaging_LL_Send, IOTHUB_MESSAGING_HANDLE, messagingHandle, const char*, deviceId, IOTHUB_MESSAGE_HANDLE, message, IOTHUB_SEND_COMPLETE_CALLBACK, sendCompleteCallback, void*, userContextCallback);
 
+/**
+* @brief    Asynchronous call to send the same message to many devices.
+*
+* @param    messagingClientHandle        The handle created by a call to the create function.
+* @param    deviceIds                         The names (Ids) of the devices to send the message to.
+*                                         They are copied, the array can be released on return.
+* @param    deviceIdCount                     The number of entries in deviceIds.
+* @param    message                           The message to send. Its body and properties are
+*                                         encoded once, only the destination differs per device.
+* @param    sendBatchCompleteCallback     The callback specified by the user for receiving
+*                                         confirmation of the delivery to each device.
+*                                         The user can specify a @c NULL value here to
+*                                         indicate that no callback is required.
+* @param    userContextCallback            User specified context that will be provided to the
+*                                         callback. This can be @c NULL.
+*
+*            Deliveries are handed to the AMQP link as it has room for them; the rest are
+*            queued by subsequent calls to ::IoTHubMessaging_LL_DoWork. Only one batch can be
+*            in progress at a time.
+*
+*            @b NOTE: The application behavior is undefined if the user calls
+*            the ::IoTHubMessaging_Destroy or IoTHubMessaging_Close function from within any callback.
+*
+* @return    IOTHUB_MESSAGING_OK upon success or an error code upon failure.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGING_RESULT, IoTHubMessaging_LL_SendBatch, IOTHUB_MESSAGING_HANDLE, messagingHandle, const char* const*, deviceIds, size_t, deviceIdCount, IOTHUB_MESSAGE_HANDLE, message, IOTHUB_SEND_BATCH_COMPLETE_CALLBACK, sendBatchCompleteCallback, void*, userContextCallback);
+
 /**
 * @brief    This API specifies a callback to be used when the device receives the message.
 *
@@ -143,6 +175,29 @@ MOCKABLE_FUNCTION(, IOTHUB_MESSAGING_RESULT, IoTHubMessaging_LL_Send, IOTHUB_MES
 */
 MOCKABLE_FUNCTION(, IOTHUB_MESSAGING_RESULT, IoTHubMessaging_LL_SetFeedbackMessageCallback, IOTHUB_MESSAGING_HANDLE, messagingHandle, IOTHUB_FEEDBACK_MESSAGE_RECEIVED_CALLBACK, feedbackMessageReceivedCallback, void*, userContextCallback);
 
+/**
+* @brief    This API specifies a callback to be called once per record of every received
+*           feedback message, instead of building an ::IOTHUB_SERVICE_FEEDBACK_BATCH.
+*           The records are parsed in place out of a buffer kept by the messaging
+*           instance, so no memory is allocated per record or per message once the
+*           buffer is large enough. While this callback is set the callback given to
+*           ::IoTHubMessaging_LL_SetFeedbackMessageCallback is not called.
+*
+* @param    messagingHandle                 The handle created by a call to the create function.
+* @param    feedbackRecordReceivedCallback  The callback specified by the user to be called for each
+*                                           feedback record. The record and the strings it points to
+*                                           are only valid for the duration of the call. Passing
+*                                           @c NULL goes back to ::IOTHUB_SERVICE_FEEDBACK_BATCH delivery.
+* @param    userContextCallback             User specified context that will be provided to the
+*                                           callback. This can be @c NULL.
+*
+*            @b NOTE: The application behavior is undefined if the user calls
+*            the ::IoTHubMessaging_Destroy or IoTHubMessaging_Close function from within any callback.
+*
+* @return    IOTHUB_MESSAGING_OK upon success or an error code upon failure.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGING_RESULT, IoTHubMessaging_LL_SetFeedbackRecordCallback, IOTHUB_MESSAGING_HANDLE, messagingHandle, IOTHUB_FEEDBACK_RECORD_RECEIVED_CALLBACK, feedbackRecordReceivedCallback, void*, userContextCallback);
+
 /**
 * @brief    This function is meant to be called by the user when work
 *             (sending/receiving) can be done by the IoTHubServiceClient.
@@ -155,6 +210,21 @@ MOCKABLE_FUNCTION(, IOTHUB_MESSAGING_RESULT, IoTHubMessaging_LL_SetFeedbackMessa
 */
 MOCKABLE_FUNCTION(, void, IoTHubMessaging_LL_DoWork, IOTHUB_MESSAGING_HANDLE, messagingHandle);
 
+/**
+* @brief    Sets how many AMQP sender links ::IoTHubMessaging_LL_Open creates for
+*           cloud-to-device messages. The first one is the regular sender link, every
+*           further one gets its own session on the same connection. Sends are then
+*           dispatched round-robin over the links that are open. Has to be called
+*           before ::IoTHubMessaging_LL_Open; the default is a single link.
+*
+* @param    messagingHandle     The handle created by a call to the create function.
+* @param    senderLinkCount     The number of sender links, between 1 and
+*                               IOTHUB_MESSAGING_MAX_SENDER_LINKS.
+*
+* @return   IOTHUB_MESSAGING_OK upon success or an error code upon failure.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGING_RESULT, IoTHubMessaging_LL_SetSenderLinkCount, IOTHUB_MESSAGING_HANDLE, messagingHandle, size_t, senderLinkCount);
+
 /**
 * @brief    This function is meant to be called by the user when to
 *           set the trusted certificate on the tls connection.
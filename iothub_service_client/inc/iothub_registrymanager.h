@@ -175,6 +175,9 @@ typedef struct IOTHUB_REGISTRYMANAGER_TAG
     char* sharedAccessKey;  //field can contain "SharedAccessSignature" if prefixed with "sas="; Otherwise, a "SharedAccessKey" is expected.
     char* keyName;
     char* deviceId;
+    struct IOTHUB_SC_HTTP_POOL_TAG* httpPool;
+    struct IOTHUB_REGISTRY_CACHE_TAG* cache;
+    struct IOTHUB_REGISTRY_ASYNC_TAG* async;
 } IOTHUB_REGISTRYMANAGER;
 
 /** @brief Handle to hide struct and use it in consequent APIs
@@ -211,6 +214,22 @@ extern void IoTHubRegistryManager_Destroy(IOTHUB_REGISTRYMANAGER_HANDLE registry
 */
 extern IOTHUB_REGISTRYMANAGER_RESULT IoTHubRegistryManager_CreateDevice_Ex(IOTHUB_REGISTRYMANAGER_HANDLE registryManagerHandle, const IOTHUB_REGISTRY_DEVICE_CREATE_EX* deviceCreate, IOTHUB_DEVICE_EX* device);
 
+/**
+* @brief    Creates many devices on IoT Hub through the bulk registry API, 100 devices per
+*           request, with up to 4 requests in flight on their own connections. The keys
+*           are optional: IoT Hub generates the missing ones, use IoTHubRegistryManager_GetDevice_Ex
+*           to read them back.
+*
+* @param    registryManagerHandle   The handle created by a call to the create function.
+* @param    deviceCreate            Array of deviceCount IOTHUB_REGISTRY_DEVICE_CREATE_EX structures.
+* @param    deviceCount             Number of devices to create.
+* @param    deviceResults           Array of deviceCount results, receiving the result of every
+*                                   device (IOTHUB_REGISTRYMANAGER_DEVICE_EXIST if it already exists).
+*
+* @return   IOTHUB_REGISTRYMANAGER_RESULT_OK if every device was created or an error code otherwise.
+*/
+extern IOTHUB_REGISTRYMANAGER_RESULT IoTHubRegistryManager_BulkCreateDevices(IOTHUB_REGISTRYMANAGER_HANDLE registryManagerHandle, const IOTHUB_REGISTRY_DEVICE_CREATE_EX* deviceCreate, size_t deviceCount, IOTHUB_REGISTRYMANAGER_RESULT* deviceResults);
+
 /**
 * @brief    Gets device info for a given device.
 *
@@ -313,6 +332,107 @@ extern IOTHUB_REGISTRYMANAGER_RESULT IoTHubRegistryManager_DeleteModule(IOTHUB_R
 */
 extern IOTHUB_REGISTRYMANAGER_RESULT IoTHubRegistryManager_GetModuleList(IOTHUB_REGISTRYMANAGER_HANDLE registryManagerHandle, const char* deviceId, SINGLYLINKEDLIST_HANDLE moduleList, int module_version);
 
+/**
+* @brief    Callback receiving the devices enumerated by IoTHubRegistryManager_EnumerateDevices.
+*           The structure and the strings it points to are only valid during the call, copy
+*           what has to be kept.
+*
+* @param    context         The context given to IoTHubRegistryManager_EnumerateDevices.
+* @param    deviceInfo      The enumerated device.
+*
+* @return   true to continue the enumeration, false to stop it.
+*/
+typedef bool(*IOTHUB_REGISTRYMANAGER_DEVICE_CALLBACK)(void* context, const IOTHUB_DEVICE_EX* deviceInfo);
+
+/**
+* @brief    Enumerates all the devices registered on the IoTHub, page by page, through the
+*           device query API. Memory use is bounded by the page size no matter how many devices
+*           the hub has: the next page is fetched while the devices of the current one are
+*           handed to the callback. The device query does not return the device keys, use
+*           IoTHubRegistryManager_GetDevice_Ex for them.
+*
+* @param    registryManagerHandle   The handle created by a call to the create function.
+* @param    pageSize                Number of devices requested per page, between 1 and 1000.
+* @param    deviceCallback          Called once per device.
+* @param    context                 User context passed to deviceCallback.
+*
+* @return   IOTHUB_REGISTRYMANAGER_RESULT_OK upon success or an error code upon failure.
+*/
+extern IOTHUB_REGISTRYMANAGER_RESULT IoTHubRegistryManager_EnumerateDevices(IOTHUB_REGISTRYMANAGER_HANDLE registryManagerHandle, size_t pageSize, IOTHUB_REGISTRYMANAGER_DEVICE_CALLBACK deviceCallback, void* context);
+
+/**
+* @brief    Enables, tunes or disables the read-through cache of IoTHubRegistryManager_GetDevice(_Ex)
+*           and IoTHubRegistryManager_GetStatistics. A device is served from the cache for
+*           timeToLiveInSeconds after it was fetched and then revalidated with its etag, so that
+*           an unchanged device costs an empty response. Creating, updating or deleting a device
+*           through the same handle drops it from the cache. The cache is disabled by default and
+*           should be enabled before the first asynchronous fetch.
+*
+* @param    registryManagerHandle   The handle created by a call to the create function.
+* @param    timeToLiveInSeconds     How long a fetched device or the statistics are reused;
+*                                   0 flushes the cache and disables it.
+* @param    maxDeviceCount          Maximum number of devices kept, the least recently used
+*                                   ones being dropped first.
+*
+* @return   IOTHUB_REGISTRYMANAGER_RESULT_OK upon success or an error code upon failure.
+*/
+extern IOTHUB_REGISTRYMANAGER_RESULT IoTHubRegistryManager_SetCache(IOTHUB_REGISTRYMANAGER_HANDLE registryManagerHandle, unsigned int timeToLiveInSeconds, size_t maxDeviceCount);
+
+/**
+* @brief    Callback receiving the result of IoTHubRegistryManager_GetDeviceAsync, called from
+*           IoTHubRegistryManager_DoWork. The structure and the strings it points to are only
+*           valid during the call.
+*
+* @param    context         The context given to IoTHubRegistryManager_GetDeviceAsync.
+* @param    result          The result of the fetch.
+* @param    deviceInfo      The device if result is IOTHUB_REGISTRYMANAGER_OK, NULL otherwise.
+*/
+typedef void(*IOTHUB_REGISTRYMANAGER_GET_DEVICE_CALLBACK)(void* context, IOTHUB_REGISTRYMANAGER_RESULT result, const IOTHUB_DEVICE_EX* deviceInfo);
+
+/**
+* @brief    Callback receiving the result of IoTHubRegistryManager_GetStatisticsAsync, called from
+*           IoTHubRegistryManager_DoWork.
+*
+* @param    context             The context given to IoTHubRegistryManager_GetStatisticsAsync.
+* @param    result              The result of the fetch.
+* @param    registryStatistics  The statistics if result is IOTHUB_REGISTRYMANAGER_OK, NULL otherwise.
+*/
+typedef void(*IOTHUB_REGISTRYMANAGER_GET_STATISTICS_CALLBACK)(void* context, IOTHUB_REGISTRYMANAGER_RESULT result, const IOTHUB_REGISTRY_STATISTICS* registryStatistics);
+
+/**
+* @brief    Queues the fetch of a device, executed in the background the way
+*           IoTHubRegistryManager_GetDevice_Ex does. The callback is called from
+*           IoTHubRegistryManager_DoWork.
+*
+* @param    registryManagerHandle   The handle created by a call to the create function.
+* @param    deviceId                The Id of the requested device.
+* @param    getDeviceCallback       Called once with the result.
+* @param    context                 User context passed to getDeviceCallback.
+*
+* @return   IOTHUB_REGISTRYMANAGER_RESULT_OK if the fetch was queued or an error code upon failure.
+*/
+extern IOTHUB_REGISTRYMANAGER_RESULT IoTHubRegistryManager_GetDeviceAsync(IOTHUB_REGISTRYMANAGER_HANDLE registryManagerHandle, const char* deviceId, IOTHUB_REGISTRYMANAGER_GET_DEVICE_CALLBACK getDeviceCallback, void* context);
+
+/**
+* @brief    Queues the fetch of the registry statistics, executed in the background the way
+*           IoTHubRegistryManager_GetStatistics does. The callback is called from
+*           IoTHubRegistryManager_DoWork.
+*
+* @param    registryManagerHandle   The handle created by a call to the create function.
+* @param    getStatisticsCallback   Called once with the result.
+* @param    context                 User context passed to getStatisticsCallback.
+*
+* @return   IOTHUB_REGISTRYMANAGER_RESULT_OK if the fetch was queued or an error code upon failure.
+*/
+extern IOTHUB_REGISTRYMANAGER_RESULT IoTHubRegistryManager_GetStatisticsAsync(IOTHUB_REGISTRYMANAGER_HANDLE registryManagerHandle, IOTHUB_REGISTRYMANAGER_GET_STATISTICS_CALLBACK getStatisticsCallback, void* context);
+
+/**
+* @brief    Calls the callbacks of the completed asynchronous fetches.
+*
+* @param    registryManagerHandle   The handle created by a call to the create function.
+*/
+extern void IoTHubRegistryManager_DoWork(IOTHUB_REGISTRYMANAGER_HANDLE registryManagerHandle);
+
 
 /* DEPRECATED: THE FOLLOWING APIS ARE DEPRECATED, AND ARE ONLY BEING KEPT FOR BACK COMPAT. PLEASE USE _EX EQUIVALENT ABOVE */
 /* DEPRECATED: THE FOLLOWING APIS ARE DEPRECATED, AND ARE ONLY BEING KEPT FOR BACK COMPAT. PLEASE USE _EX EQUIVALENT ABOVE */
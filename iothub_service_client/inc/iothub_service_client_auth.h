@@ -52,6 +52,7 @@ typedef struct IOTHUB_SERVICE_CLIENT_AUTH_TAG
     char* sharedAccessKey;  //field can contain "SharedAccessSignature" if prefixed with "sas="; Otherwise, a "SharedAccessKey" is expected.
     char* keyName;
     char* deviceId;
+    struct IOTHUB_SC_HTTP_POOL_TAG* httpPool;  //keep-alive connections and cached SAS token shared by the HTTP based service clients
 } IOTHUB_SERVICE_CLIENT_AUTH;
 
 /** @brief Handle to hide struct and use it in consequent APIs
@@ -19,6 +19,7 @@
 #include "parson.h"
 #include "iothub_deviceconfiguration.h"
 #include "iothub_sc_version.h"
+#include "internal/iothub_sc_http_pool.h"
 
 DEFINE_ENUM_STRINGS(IOTHUB_DEVICE_CONFIGURATION_RESULT, IOTHUB_DEVICE_CONFIGURATION_RESULT_VALUES);
 
@@ -75,6 +76,7 @@ typedef struct IOTHUB_SERVICE_CLIENT_DEVICE_CONFIGURATION_TAG
     char* hostname;
     char* sharedAccessKey;
     char* keyName;
+    IOTHUB_SC_HTTP_POOL_HANDLE httpPool;
 } IOTHUB_SERVICE_CLIENT_DEVICE_CONFIGURATION;
 
 static const char* generateGuid(void)
@@ -184,6 +186,22 @@ static HTTP_HEADERS_HANDLE createHttpHeader(IOTHUB_DEVICECONFIGURATION_REQUEST_M
     return httpHeader;
 }
 
+static HTTPAPIEX_RESULT executeHttpRequest(IOTHUB_SERVICE_CLIENT_DEVICE_CONFIGURATION_HANDLE serviceClientDeviceConfigurationHandle, HTTPAPIEX_SAS_HANDLE httpExApiSasHandle, HTTPAPIEX_HANDLE httpExApiHandle, HTTPAPI_REQUEST_TYPE httpApiRequestType, const char* relativePath, HTTP_HEADERS_HANDLE httpHeader, BUFFER_HANDLE requestBuffer, unsigned int* statusCode, BUFFER_HANDLE responseBuffer)
+{
+    HTTPAPIEX_RESULT result;
+
+    if (serviceClientDeviceConfigurationHandle->httpPool != NULL)
+    {
+        /*Codes_SRS_IOTHUBDEVICECONFIGURATION_41_003: [ If the handle shares an HTTP connection pool, the request shall be executed on a pooled keep-alive connection with the cached SAS token by calling IoTHubSCHttpPool_ExecuteRequest instead of creating an HTTPAPIEX_SAS_HANDLE and an HTTPAPIEX_HANDLE per request ]*/
+        result = IoTHubSCHttpPool_ExecuteRequest(serviceClientDeviceConfigurationHandle->httpPool, httpApiRequestType, relativePath, httpHeader, requestBuffer, statusCode, NULL, responseBuffer);
+    }
+    else
+    {
+        result = HTTPAPIEX_SAS_ExecuteRequest(httpExApiSasHandle, httpExApiHandle, httpApiRequestType, relativePath, httpHeader, requestBuffer, statusCode, NULL, responseBuffer);
+    }
+    return result;
+}
+
 static IOTHUB_DEVICE_CONFIGURATION_RESULT sendHttpRequestDeviceConfiguration(IOTHUB_SERVICE_CLIENT_DEVICE_CONFIGURATION_HANDLE serviceClientDeviceConfigurationHandle, IOTHUB_DEVICECONFIGURATION_REQUEST_MODE iotHubDeviceConfigurationRequestMode, const char* id, BUFFER_HANDLE json, size_t maxConfigurationsCount, BUFFER_HANDLE responseBuffer)
 {
     IOTHUB_DEVICE_CONFIGURATION_RESULT result;
@@ -191,24 +209,24 @@ static IOTHUB_DEVICE_CONFIGURATION_RESULT sendHttpRequestDeviceConfiguration(IOT
     STRING_HANDLE uriResource = NULL;
     STRING_HANDLE accessKey = NULL;
     STRING_HANDLE keyName = NULL;
-    HTTPAPIEX_SAS_HANDLE httpExApiSasHandle;
-    HTTPAPIEX_HANDLE httpExApiHandle;
+    HTTPAPIEX_SAS_HANDLE httpExApiSasHandle = NULL;
+    HTTPAPIEX_HANDLE httpExApiHandle = NULL;
     HTTP_HEADERS_HANDLE httpHeader;
 
-    if ((uriResource = STRING_construct(serviceClientDeviceConfigurationHandle->hostname)) == NULL)
+    if ((serviceClientDeviceConfigurationHandle->httpPool == NULL) && ((uriResource = STRING_construct(serviceClientDeviceConfigurationHandle->hostname)) == NULL))
     {
         /*Codes_SRS_IOTHUBDEVICECONFIGURATION_38_024: [ If any of the HTTPAPI call fails IoTHubDeviceConfiguration_GetConfiguration shall fail and return NULL ]*/
         LogError("STRING_construct failed for uriResource");
         result = IOTHUB_DEVICE_CONFIGURATION_ERROR;
     }
-    else if ((accessKey = STRING_construct(serviceClientDeviceConfigurationHandle->sharedAccessKey)) == NULL)
+    else if ((serviceClientDeviceConfigurationHandle->httpPool == NULL) && ((accessKey = STRING_construct(serviceClientDeviceConfigurationHandle->sharedAccessKey)) == NULL))
     {
         /*Codes_SRS_IOTHUBDEVICECONFIGURATION_38_024: [ If any of the call fails during the HTTP creation IoTHubDeviceConfiguration_GetConfiguration shall fail and return NULL ]*/
         LogError("STRING_construct failed for accessKey");
         STRING_delete(uriResource);
         result = IOTHUB_DEVICE_CONFIGURATION_ERROR;
     }
-    else if ((keyName = STRING_construct(serviceClientDeviceConfigurationHandle->keyName)) == NULL)
+    else if ((serviceClientDeviceConfigurationHandle->httpPool == NULL) && ((keyName = STRING_construct(serviceClientDeviceConfigurationHandle->keyName)) == NULL))
     {
         /*Codes_SRS_IOTHUBDEVICECONFIGURATION_38_024: [ If any of the call fails during the HTTP creation IoTHubDeviceConfiguration_GetConfiguration shall fail and return NULL ]*/
         LogError("STRING_construct failed for keyName");
@@ -227,7 +245,7 @@ static IOTHUB_DEVICE_CONFIGURATION_RESULT sendHttpRequestDeviceConfiguration(IOT
         result = IOTHUB_DEVICE_CONFIGURATION_ERROR;
     }
     /*Codes_SRS_IOTHUBDEVICECONFIGURATION_38_021: [ IoTHubDeviceConfiguration_GetConfiguration shall create an HTTPAPIEX_SAS_HANDLE handle by calling HTTPAPIEX_SAS_Create ]*/
-    else if ((httpExApiSasHandle = HTTPAPIEX_SAS_Create(accessKey, uriResource, keyName)) == NULL)
+    else if ((serviceClientDeviceConfigurationHandle->httpPool == NULL) && ((httpExApiSasHandle = HTTPAPIEX_SAS_Create(accessKey, uriResource, keyName)) == NULL))
     {
         /*Codes_SRS_IOTHUBDEVICECONFIGURATION_38_025: [ If any of the HTTPAPI call fails IoTHubDeviceConfiguration_GetConfiguration shall fail and return IOTHUB_DEVICE_CONFIGURATION_HTTPAPI_ERROR ]*/
         LogError("HTTPAPIEX_SAS_Create failed");
@@ -238,7 +256,7 @@ static IOTHUB_DEVICE_CONFIGURATION_RESULT sendHttpRequestDeviceConfiguration(IOT
         result = IOTHUB_DEVICE_CONFIGURATION_HTTPAPI_ERROR;
     }
     /*Codes_SRS_IOTHUBDEVICECONFIGURATION_38_022: [ IoTHubDeviceConfiguration_GetConfiguration shall create an HTTPAPIEX_HANDLE handle by calling HTTPAPIEX_Create ]*/
-    else if ((httpExApiHandle = HTTPAPIEX_Create(serviceClientDeviceConfigurationHandle->hostname)) == NULL)
+    else if ((serviceClientDeviceConfigurationHandle->httpPool == NULL) && ((httpExApiHandle = HTTPAPIEX_Create(serviceClientDeviceConfigurationHandle->hostname)) == NULL))
     {
         /*Codes_SRS_IOTHUBDEVICECONFIGURATION_38_025: [ If any of the HTTPAPI call fails IoTHubDeviceConfiguration_GetConfiguration shall fail and return NULL ]*/
         LogError("HTTPAPIEX_Create failed");
@@ -292,7 +310,7 @@ static IOTHUB_DEVICE_CONFIGURATION_RESULT sendHttpRequestDeviceConfiguration(IOT
                 result = IOTHUB_DEVICE_CONFIGURATION_ERROR;
             }
             /*Codes_SRS_IOTHUBDEVICECONFIGURATION_38_023: [ IoTHubDeviceConfiguration_GetConfiguration shall execute the HTTP GET request by calling HTTPAPIEX_ExecuteRequest ]*/
-            else if (HTTPAPIEX_SAS_ExecuteRequest(httpExApiSasHandle, httpExApiHandle, httpApiRequestType, STRING_c_str(relativePath), httpHeader, json, &statusCode, NULL, responseBuffer) != HTTPAPIEX_OK)
+            else if (executeHttpRequest(serviceClientDeviceConfigurationHandle, httpExApiSasHandle, httpExApiHandle, httpApiRequestType, STRING_c_str(relativePath), httpHeader, json, &statusCode, responseBuffer) != HTTPAPIEX_OK)
             {
                 /*Codes_SRS_IOTHUBDEVICECONFIGURATION_38_025: [ If any of the HTTPAPI call fails IoTHubDeviceConfiguration_GetConfiguration shall fail and return NULL ]*/
                 LogError("HTTPAPIEX_SAS_ExecuteRequest failed");
@@ -971,6 +989,11 @@ static IOTHUB_DEVICE_CONFIGURATION_RESULT parseDeviceConfigurationJson(BUFFER_HA
 
 static void free_deviceConfiguration_handle(IOTHUB_SERVICE_CLIENT_DEVICE_CONFIGURATION* deviceConfiguration)
 {
+    if (deviceConfiguration->httpPool != NULL)
+    {
+        /*Codes_SRS_IOTHUBDEVICECONFIGURATION_41_004: [ IoTHubDeviceConfiguration_Destroy shall release its reference to the HTTP connection pool by calling IoTHubSCHttpPool_Destroy ]*/
+        IoTHubSCHttpPool_Destroy(deviceConfiguration->httpPool);
+    }
     free(deviceConfiguration->hostname);
     free(deviceConfiguration->sharedAccessKey);
     free(deviceConfiguration->keyName);
@@ -1055,6 +1078,14 @@ IOTHUB_SERVICE_CLIENT_DEVICE_CONFIGURATION_HANDLE IoTHubDeviceConfiguration_Crea
                     free_deviceConfiguration_handle(result);
                     result = NULL;
                 }
+                /*Codes_SRS_IOTHUBDEVICECONFIGURATION_41_001: [ If serviceClientHandle has an HTTP connection pool, IoTHubDeviceConfiguration_Create shall share it by calling IoTHubSCHttpPool_Clone ]*/
+                else if ((serviceClientAuth->httpPool != NULL) && ((result->httpPool = IoTHubSCHttpPool_Clone(serviceClientAuth->httpPool)) == NULL))
+                {
+                    /*Codes_SRS_IOTHUBDEVICECONFIGURATION_41_002: [ If the IoTHubSCHttpPool_Clone fails, IoTHubDeviceConfiguration_Create shall do clean up and return NULL. ]*/
+                    LogError("IoTHubSCHttpPool_Clone failed");
+                    free_deviceConfiguration_handle(result);
+                    result = NULL;
+                }
             }
         }
     }
@@ -1482,6 +1513,362 @@ IOTHUB_DEVICE_CONFIGURATION_RESULT IoTHubDeviceConfiguration_GetConfigurations(I
     return result;
 }
 
+typedef struct CONFIGURATION_VIEW_NAME_VALUES_TAG
+{
+    size_t capacity;
+    const char** names;
+    const char** strings;
+    double* numbers;
+} CONFIGURATION_VIEW_NAME_VALUES;
+
+/*arrays and content buffers the read-only configuration views point into, grown as needed and reused for every configuration of the list*/
+typedef struct CONFIGURATION_VIEW_BUFFERS_TAG
+{
+    CONFIGURATION_VIEW_NAME_VALUES labels;
+    CONFIGURATION_VIEW_NAME_VALUES systemMetricsResults;
+    CONFIGURATION_VIEW_NAME_VALUES systemMetricsQueries;
+    CONFIGURATION_VIEW_NAME_VALUES customMetricsResults;
+    CONFIGURATION_VIEW_NAME_VALUES customMetricsQueries;
+    char* deviceContent;
+    size_t deviceContentSize;
+    char* modulesContent;
+    size_t modulesContentSize;
+} CONFIGURATION_VIEW_BUFFERS;
+
+static void freeConfigurationViewNameValues(CONFIGURATION_VIEW_NAME_VALUES* nameValues)
+{
+    free((void*)nameValues->names);
+    free((void*)nameValues->strings);
+    free(nameValues->numbers);
+}
+
+static void freeConfigurationViewBuffers(CONFIGURATION_VIEW_BUFFERS* viewBuffers)
+{
+    freeConfigurationViewNameValues(&viewBuffers->labels);
+    freeConfigurationViewNameValues(&viewBuffers->systemMetricsResults);
+    freeConfigurationViewNameValues(&viewBuffers->systemMetricsQueries);
+    freeConfigurationViewNameValues(&viewBuffers->customMetricsResults);
+    freeConfigurationViewNameValues(&viewBuffers->customMetricsQueries);
+    free(viewBuffers->deviceContent);
+    free(viewBuffers->modulesContent);
+}
+
+static IOTHUB_DEVICE_CONFIGURATION_RESULT viewNameValuesJsonObject(const JSON_Object* jsonObject, bool isNumeric, CONFIGURATION_VIEW_NAME_VALUES* nameValues, size_t* count)
+{
+    IOTHUB_DEVICE_CONFIGURATION_RESULT result = IOTHUB_DEVICE_CONFIGURATION_OK;
+    size_t valueCount = (jsonObject == NULL) ? 0 : json_object_get_count(jsonObject);
+
+    if (valueCount > nameValues->capacity)
+    {
+        const char** names;
+
+        if ((names = (const char**)realloc((void*)nameValues->names, valueCount * sizeof(const char*))) == NULL)
+        {
+            LogError("realloc failed for the view names");
+            result = IOTHUB_DEVICE_CONFIGURATION_OUT_OF_MEMORY_ERROR;
+        }
+        else
+        {
+            nameValues->names = names;
+
+            if (isNumeric)
+            {
+                double* numbers;
+                if ((numbers = (double*)realloc(nameValues->numbers, valueCount * sizeof(double))) == NULL)
+                {
+                    LogError("realloc failed for the view results");
+                    result = IOTHUB_DEVICE_CONFIGURATION_OUT_OF_MEMORY_ERROR;
+                }
+                else
+                {
+                    nameValues->numbers = numbers;
+                    nameValues->capacity = valueCount;
+                }
+            }
+            else
+            {
+                const char** strings;
+                if ((strings = (const char**)realloc((void*)nameValues->strings, valueCount * sizeof(const char*))) == NULL)
+                {
+                    LogError("realloc failed for the view values");
+                    result = IOTHUB_DEVICE_CONFIGURATION_OUT_OF_MEMORY_ERROR;
+                }
+                else
+                {
+                    nameValues->strings = strings;
+                    nameValues->capacity = valueCount;
+                }
+            }
+        }
+    }
+
+    if (result == IOTHUB_DEVICE_CONFIGURATION_OK)
+    {
+        size_t i;
+
+        for (i = 0; i < valueCount; i++)
+        {
+            JSON_Value* value;
+
+            if (((nameValues->names[i] = json_object_get_name(jsonObject, i)) == NULL) ||
+                ((value = json_object_get_value_at(jsonObject, i)) == NULL))
+            {
+                LogError("json_object_get_name or json_object_get_value_at failed");
+                result = IOTHUB_DEVICE_CONFIGURATION_JSON_ERROR;
+                break;
+            }
+            else if (isNumeric)
+            {
+                nameValues->numbers[i] = json_value_get_number(value);
+            }
+            else if ((nameValues->strings[i] = json_value_get_string(value)) == NULL)
+            {
+                LogError("missing value for %s", nameValues->names[i]);
+                result = IOTHUB_DEVICE_CONFIGURATION_JSON_ERROR;
+                break;
+            }
+        }
+    }
+
+    *count = (result == IOTHUB_DEVICE_CONFIGURATION_OK) ? valueCount : 0;
+    return result;
+}
+
+static IOTHUB_DEVICE_CONFIGURATION_RESULT viewContentJsonValue(const JSON_Value* contentValue, char** contentBuffer, size_t* contentBufferSize, const char** content)
+{
+    IOTHUB_DEVICE_CONFIGURATION_RESULT result;
+    size_t contentSize;
+
+    *content = NULL;
+
+    if (contentValue == NULL)
+    {
+        result = IOTHUB_DEVICE_CONFIGURATION_OK;
+    }
+    else if ((contentSize = json_serialization_size(contentValue)) == 0)
+    {
+        LogError("json_serialization_size failed");
+        result = IOTHUB_DEVICE_CONFIGURATION_JSON_ERROR;
+    }
+    else
+    {
+        result = IOTHUB_DEVICE_CONFIGURATION_OK;
+
+        if (contentSize > *contentBufferSize)
+        {
+            char* newContentBuffer;
+            if ((newContentBuffer = (char*)realloc(*contentBuffer, contentSize)) == NULL)
+            {
+                LogError("realloc failed for the view content");
+                result = IOTHUB_DEVICE_CONFIGURATION_OUT_OF_MEMORY_ERROR;
+            }
+            else
+            {
+                *contentBuffer = newContentBuffer;
+                *contentBufferSize = contentSize;
+            }
+        }
+
+        if (result == IOTHUB_DEVICE_CONFIGURATION_OK)
+        {
+            if (json_serialize_to_buffer(contentValue, *contentBuffer, *contentBufferSize) != JSONSuccess)
+            {
+                LogError("json_serialize_to_buffer failed");
+                result = IOTHUB_DEVICE_CONFIGURATION_JSON_ERROR;
+            }
+            else
+            {
+                *content = *contentBuffer;
+            }
+        }
+    }
+
+    return result;
+}
+
+/*fills configuration with pointers into root_object and viewBuffers instead of copies, the view is valid until the next configuration is viewed*/
+static IOTHUB_DEVICE_CONFIGURATION_RESULT viewDeviceConfigurationJsonObject(const JSON_Object* root_object, CONFIGURATION_VIEW_BUFFERS* viewBuffers, IOTHUB_DEVICE_CONFIGURATION* configuration)
+{
+    IOTHUB_DEVICE_CONFIGURATION_RESULT result;
+
+    initializeDeviceConfigurationMembers(configuration);
+
+    configuration->version = IOTHUB_DEVICE_CONFIGURATION_VERSION_1;
+    configuration->configurationId = json_object_get_string(root_object, CONFIGURATION_JSON_KEY_CONFIGURATION_ID);
+    configuration->schemaVersion = json_object_get_string(root_object, CONFIGURATION_JSON_KEY_SCHEMA_VERSION);
+    configuration->targetCondition = json_object_get_string(root_object, CONFIGURATION_JSON_KEY_TARGET_CONDITION);
+    configuration->createdTimeUtc = json_object_get_string(root_object, CONFIGURATION_JSON_KEY_CREATED_TIME);
+    configuration->lastUpdatedTimeUtc = json_object_get_string(root_object, CONFIGURATION_JSON_KEY_LAST_UPDATED_TIME);
+    configuration->eTag = json_object_get_string(root_object, CONFIGURATION_JSON_KEY_ETAG);
+    configuration->priority = (int)json_object_get_number(root_object, CONFIGURATION_JSON_KEY_PRIORITY);
+
+    if ((result = viewContentJsonValue(json_object_dotget_value(root_object, CONFIGURATION_DEVICE_CONTENT_NODE_NAME), &viewBuffers->deviceContent, &viewBuffers->deviceContentSize, &configuration->content.deviceContent)) != IOTHUB_DEVICE_CONFIGURATION_OK)
+    {
+        LogError("viewContentJsonValue failed for content.deviceContent");
+    }
+    else if ((result = viewContentJsonValue(json_object_dotget_value(root_object, CONFIGURATION_MODULES_CONTENT_NODE_NAME), &viewBuffers->modulesContent, &viewBuffers->modulesContentSize, &configuration->content.modulesContent)) != IOTHUB_DEVICE_CONFIGURATION_OK)
+    {
+        LogError("viewContentJsonValue failed for content.modulesContent");
+    }
+    else if ((result = viewNameValuesJsonObject(json_object_dotget_object(root_object, CONFIGURATION_JSON_KEY_LABELS), false, &viewBuffers->labels, &configuration->labels.numLabels)) != IOTHUB_DEVICE_CONFIGURATION_OK)
+    {
+        LogError("viewNameValuesJsonObject failed for labels");
+    }
+    else if ((result = viewNameValuesJsonObject(json_object_dotget_object(root_object, CONFIGURATION_SYSTEM_METRICS_RESULTS_NODE_NAME), true, &viewBuffers->systemMetricsResults, &configuration->systemMetricsResult.numQueries)) != IOTHUB_DEVICE_CONFIGURATION_OK)
+    {
+        LogError("viewNameValuesJsonObject failed for systemMetrics results");
+    }
+    else if ((result = viewNameValuesJsonObject(json_object_dotget_object(root_object, CONFIGURATION_SYSTEM_METRICS_QUERIES_NODE_NAME), false, &viewBuffers->systemMetricsQueries, &configuration->systemMetricsDefinition.numQueries)) != IOTHUB_DEVICE_CONFIGURATION_OK)
+    {
+        LogError("viewNameValuesJsonObject failed for systemMetrics queries");
+    }
+    else if ((result = viewNameValuesJsonObject(json_object_dotget_object(root_object, CONFIGURATION_CUSTOM_METRICS_RESULTS_NODE_NAME), true, &viewBuffers->customMetricsResults, &configuration->metricResult.numQueries)) != IOTHUB_DEVICE_CONFIGURATION_OK)
+    {
+        LogError("viewNameValuesJsonObject failed for metrics results");
+    }
+    else if ((result = viewNameValuesJsonObject(json_object_dotget_object(root_object, CONFIGURATION_CUSTOM_METRICS_QUERIES_NODE_NAME), false, &viewBuffers->customMetricsQueries, &configuration->metricsDefinition.numQueries)) != IOTHUB_DEVICE_CONFIGURATION_OK)
+    {
+        LogError("viewNameValuesJsonObject failed for metrics queries");
+    }
+    else
+    {
+        configuration->labels.labelNames = viewBuffers->labels.names;
+        configuration->labels.labelValues = viewBuffers->labels.strings;
+        configuration->systemMetricsResult.queryNames = viewBuffers->systemMetricsResults.names;
+        configuration->systemMetricsResult.results = viewBuffers->systemMetricsResults.numbers;
+        configuration->systemMetricsDefinition.queryNames = viewBuffers->systemMetricsQueries.names;
+        configuration->systemMetricsDefinition.queryStrings = viewBuffers->systemMetricsQueries.strings;
+        configuration->metricResult.queryNames = viewBuffers->customMetricsResults.names;
+        configuration->metricResult.results = viewBuffers->customMetricsResults.numbers;
+        configuration->metricsDefinition.queryNames = viewBuffers->customMetricsQueries.names;
+        configuration->metricsDefinition.queryStrings = viewBuffers->customMetricsQueries.strings;
+    }
+
+    return result;
+}
+
+static IOTHUB_DEVICE_CONFIGURATION_RESULT enumerateDeviceConfigurationListJson(BUFFER_HANDLE jsonBuffer, IOTHUB_DEVICE_CONFIGURATION_ENUMERATE_CALLBACK configurationCallback, void* context)
+{
+    IOTHUB_DEVICE_CONFIGURATION_RESULT result;
+    size_t jsonLength = BUFFER_length(jsonBuffer);
+    unsigned char* bufferStr;
+    JSON_Value* root_value = NULL;
+    JSON_Array* device_configuration_array;
+
+    /*the response isn't zero terminated, terminate it in place instead of copying it*/
+    if (BUFFER_enlarge(jsonBuffer, 1) != 0)
+    {
+        LogError("BUFFER_enlarge failed");
+        result = IOTHUB_DEVICE_CONFIGURATION_ERROR;
+    }
+    else if ((bufferStr = BUFFER_u_char(jsonBuffer)) == NULL)
+    {
+        LogError("BUFFER_u_char failed");
+        result = IOTHUB_DEVICE_CONFIGURATION_ERROR;
+    }
+    else
+    {
+        bufferStr[jsonLength] = '\0';
+
+        /*Codes_SRS_IOTHUBDEVICECONFIGURATION_41_004: [ If any of the parson API fails, IoTHubDeviceConfiguration_EnumerateConfigurations shall return IOTHUB_DEVICE_CONFIGURATION_JSON_ERROR ] */
+        if ((root_value = json_parse_string((const char*)bufferStr)) == NULL)
+        {
+            LogError("json_parse_string failed");
+            result = IOTHUB_DEVICE_CONFIGURATION_JSON_ERROR;
+        }
+        else if ((device_configuration_array = json_value_get_array(root_value)) == NULL)
+        {
+            LogError("json_value_get_array failed");
+            result = IOTHUB_DEVICE_CONFIGURATION_JSON_ERROR;
+        }
+        else
+        {
+            CONFIGURATION_VIEW_BUFFERS viewBuffers;
+            size_t array_count = json_array_get_count(device_configuration_array);
+            size_t i;
+
+            memset(&viewBuffers, 0, sizeof(viewBuffers));
+            result = IOTHUB_DEVICE_CONFIGURATION_OK;
+
+            for (i = 0; i < array_count; i++)
+            {
+                JSON_Object* device_configuration_object;
+                IOTHUB_DEVICE_CONFIGURATION configurationView;
+
+                if ((device_configuration_object = json_array_get_object(device_configuration_array, i)) == NULL)
+                {
+                    LogError("json_array_get_object failed");
+                    result = IOTHUB_DEVICE_CONFIGURATION_JSON_ERROR;
+                    break;
+                }
+                /*Codes_SRS_IOTHUBDEVICECONFIGURATION_41_005: [ IoTHubDeviceConfiguration_EnumerateConfigurations shall hand every configuration to configurationCallback as a read-only view pointing into the parsed response, without copying its members ] */
+                else if ((result = viewDeviceConfigurationJsonObject(device_configuration_object, &viewBuffers, &configurationView)) != IOTHUB_DEVICE_CONFIGURATION_OK)
+                {
+                    LogError("viewDeviceConfigurationJsonObject failed");
+                    break;
+                }
+                /*Codes_SRS_IOTHUBDEVICECONFIGURATION_41_006: [ If configurationCallback returns false IoTHubDeviceConfiguration_EnumerateConfigurations shall not call it again and shall return IOTHUB_DEVICE_CONFIGURATION_OK ] */
+                else if (!configurationCallback(context, &configurationView))
+                {
+                    break;
+                }
+            }
+
+            freeConfigurationViewBuffers(&viewBuffers);
+        }
+    }
+
+    if (root_value != NULL)
+    {
+        json_value_free(root_value);
+    }
+
+    return result;
+}
+
+IOTHUB_DEVICE_CONFIGURATION_RESULT IoTHubDeviceConfiguration_EnumerateConfigurations(IOTHUB_SERVICE_CLIENT_DEVICE_CONFIGURATION_HANDLE serviceClientDeviceConfigurationHandle, size_t maxConfigurationsCount, IOTHUB_DEVICE_CONFIGURATION_ENUMERATE_CALLBACK configurationCallback, void* context)
+{
+    IOTHUB_DEVICE_CONFIGURATION_RESULT result;
+
+    /*Codes_SRS_IOTHUBDEVICECONFIGURATION_41_001: [ If serviceClientDeviceConfigurationHandle or configurationCallback is NULL, or maxConfigurationsCount is not between 1 and 20, IoTHubDeviceConfiguration_EnumerateConfigurations shall return IOTHUB_DEVICE_CONFIGURATION_INVALID_ARG ] */
+    if ((serviceClientDeviceConfigurationHandle == NULL) || (configurationCallback == NULL))
+    {
+        LogError("Input parameter cannot be NULL");
+        result = IOTHUB_DEVICE_CONFIGURATION_INVALID_ARG;
+    }
+    else if ((maxConfigurationsCount == 0) || (maxConfigurationsCount > IOTHUB_DEVICE_CONFIGURATIONS_MAX_REQUEST))
+    {
+        LogError("maxConfigurationsCount has to be between 1 and %d", IOTHUB_DEVICE_CONFIGURATIONS_MAX_REQUEST);
+        result = IOTHUB_DEVICE_CONFIGURATION_INVALID_ARG;
+    }
+    else
+    {
+        BUFFER_HANDLE responseBuffer;
+
+        if ((responseBuffer = BUFFER_new()) == NULL)
+        {
+            LogError("BUFFER_new failed for responseBuffer");
+            result = IOTHUB_DEVICE_CONFIGURATION_ERROR;
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBDEVICECONFIGURATION_41_002: [ IoTHubDeviceConfiguration_EnumerateConfigurations shall send the HTTP GET request of IoTHubDeviceConfiguration_GetConfigurations ] */
+            /*Codes_SRS_IOTHUBDEVICECONFIGURATION_41_003: [ If the request fails or the received HTTP status code is not 200 IoTHubDeviceConfiguration_EnumerateConfigurations shall return the error of IoTHubDeviceConfiguration_GetConfigurations without calling configurationCallback ] */
+            if ((result = sendHttpRequestDeviceConfiguration(serviceClientDeviceConfigurationHandle, IOTHUB_DEVICECONFIGURATION_REQUEST_GET_LIST, NULL, NULL, maxConfigurationsCount, responseBuffer)) != IOTHUB_DEVICE_CONFIGURATION_OK)
+            {
+                LogError("Failure sending HTTP request for get configuration list");
+            }
+            else
+            {
+                result = enumerateDeviceConfigurationListJson(responseBuffer, configurationCallback, context);
+            }
+
+            BUFFER_delete(responseBuffer);
+        }
+    }
+    return result;
+}
+
 IOTHUB_DEVICE_CONFIGURATION_RESULT IoTHubDeviceConfiguration_GetConfiguration(IOTHUB_SERVICE_CLIENT_DEVICE_CONFIGURATION_HANDLE serviceClientDeviceConfigurationHandle, const char* configurationId, IOTHUB_DEVICE_CONFIGURATION* configuration)
 {
     IOTHUB_DEVICE_CONFIGURATION_RESULT result;
@@ -14,10 +14,14 @@
 #include "azure_c_shared_utility/base64.h"
 #include "azure_c_shared_utility/uniqueid.h"
 #include "azure_c_shared_utility/connection_string_parser.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+#include "azure_c_shared_utility/threadapi.h"
 
 #include "parson.h"
 #include "iothub_devicemethod.h"
 #include "iothub_sc_version.h"
+#include "internal/iothub_sc_http_pool.h"
 
 DEFINE_ENUM_STRINGS(IOTHUB_DEVICE_METHOD_RESULT, IOTHUB_DEVICE_METHOD_RESULT_VALUES);
 
@@ -43,6 +47,46 @@ static const char* const RELATIVE_PATH_FMT_DEVICEMETHOD = "/twins/%s/methods%s";
 static const char* const RELATIVE_PATH_FMT_DEVICEMETHOD_MODULE = "/twins/%s/modules/%s/methods%s";
 static const char* const RELATIVE_PATH_FMT_DEVIECMETHOD_PAYLOAD = "{\"methodName\":\"%s\",\"timeout\":%d,\"payload\":%s}";
 
+/** @brief An asynchronous invocation, queued on pending until a worker runs it and then on completed until DoWork dispatches it
+*/
+typedef struct DEVICE_METHOD_INVOCATION_TAG
+{
+    struct DEVICE_METHOD_INVOCATION_TAG* next;
+    char* deviceId;
+    char* moduleId;
+    char* methodName;
+    char* methodPayload;
+    unsigned int timeout;
+    IOTHUB_DEVICE_METHOD_INVOKE_COMPLETE_CALLBACK invokeCompleteCallback;
+    void* context;
+    IOTHUB_DEVICE_METHOD_RESULT result;
+    int responseStatus;
+    unsigned char* responsePayload;
+    size_t responsePayloadSize;
+} DEVICE_METHOD_INVOCATION;
+
+typedef struct DEVICE_METHOD_INVOCATION_QUEUE_TAG
+{
+    DEVICE_METHOD_INVOCATION* head;
+    DEVICE_METHOD_INVOCATION* tail;
+    size_t count;
+} DEVICE_METHOD_INVOCATION_QUEUE;
+
+/** @brief State of the asynchronous invocations, created by the first IoTHubDeviceMethod_Invoke(Module)Async
+*/
+typedef struct DEVICE_METHOD_ASYNC_TAG
+{
+    LOCK_HANDLE lock;
+    COND_HANDLE workAvailable;
+    DEVICE_METHOD_INVOCATION_QUEUE pending;
+    DEVICE_METHOD_INVOCATION_QUEUE completed;
+    THREAD_HANDLE* workers;
+    size_t workerCount;
+    size_t idleWorkerCount;
+    size_t inFlightCount;
+    bool stopWorkers;
+} DEVICE_METHOD_ASYNC;
+
 /** @brief Structure to store IoTHub authentication information
 */
 typedef struct IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_TAG
@@ -50,6 +94,9 @@ typedef struct IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_TAG
     char* hostname;
     char* sharedAccessKey;
     char* keyName;
+    IOTHUB_SC_HTTP_POOL_HANDLE httpPool;
+    size_t maxConcurrentInvocations;
+    DEVICE_METHOD_ASYNC* async;
 } IOTHUB_SERVICE_CLIENT_DEVICE_METHOD;
 
 static IOTHUB_DEVICE_METHOD_RESULT parseResponseJson(BUFFER_HANDLE responseJson, int* responseStatus, unsigned char** responsePayload, size_t* responsePayloadSize)
@@ -243,29 +290,45 @@ static HTTP_HEADERS_HANDLE createHttpHeader()
     return httpHeader;
 }
 
+static HTTPAPIEX_RESULT executeHttpRequest(IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE serviceClientDeviceMethodHandle, HTTPAPIEX_SAS_HANDLE httpExApiSasHandle, HTTPAPIEX_HANDLE httpExApiHandle, HTTPAPI_REQUEST_TYPE httpApiRequestType, const char* relativePath, HTTP_HEADERS_HANDLE httpHeader, BUFFER_HANDLE requestBuffer, unsigned int* statusCode, BUFFER_HANDLE responseBuffer)
+{
+    HTTPAPIEX_RESULT result;
+
+    if (serviceClientDeviceMethodHandle->httpPool != NULL)
+    {
+        /*Codes_SRS_IOTHUBDEVICEMETHOD_41_003: [ If the handle shares an HTTP connection pool, the request shall be executed on a pooled keep-alive connection with the cached SAS token by calling IoTHubSCHttpPool_ExecuteRequest instead of creating an HTTPAPIEX_SAS_HANDLE and an HTTPAPIEX_HANDLE per request ]*/
+        result = IoTHubSCHttpPool_ExecuteRequest(serviceClientDeviceMethodHandle->httpPool, httpApiRequestType, relativePath, httpHeader, requestBuffer, statusCode, NULL, responseBuffer);
+    }
+    else
+    {
+        result = HTTPAPIEX_SAS_ExecuteRequest(httpExApiSasHandle, httpExApiHandle, httpApiRequestType, relativePath, httpHeader, requestBuffer, statusCode, NULL, responseBuffer);
+    }
+    return result;
+}
+
 static IOTHUB_DEVICE_METHOD_RESULT sendHttpRequestDeviceMethod(IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE serviceClientDeviceMethodHandle, IOTHUB_DEVICEMETHOD_REQUEST_MODE iotHubDeviceMethodRequestMode, const char* deviceId, const char* moduleId, BUFFER_HANDLE deviceJsonBuffer, BUFFER_HANDLE responseBuffer)
 {
     IOTHUB_DEVICE_METHOD_RESULT result;
 
-    STRING_HANDLE uriResource;
-    STRING_HANDLE accessKey;
-    STRING_HANDLE keyName;
-    HTTPAPIEX_SAS_HANDLE httpExApiSasHandle;
-    HTTPAPIEX_HANDLE httpExApiHandle;
+    STRING_HANDLE uriResource = NULL;
+    STRING_HANDLE accessKey = NULL;
+    STRING_HANDLE keyName = NULL;
+    HTTPAPIEX_SAS_HANDLE httpExApiSasHandle = NULL;
+    HTTPAPIEX_HANDLE httpExApiHandle = NULL;
     HTTP_HEADERS_HANDLE httpHeader;
 
-    if ((uriResource = STRING_construct(serviceClientDeviceMethodHandle->hostname)) == NULL)
+    if ((serviceClientDeviceMethodHandle->httpPool == NULL) && ((uriResource = STRING_construct(serviceClientDeviceMethodHandle->hostname)) == NULL))
     {
         LogError("STRING_construct failed for uriResource");
         result = IOTHUB_DEVICE_METHOD_ERROR;
     }
-    else if ((accessKey = STRING_construct(serviceClientDeviceMethodHandle->sharedAccessKey)) == NULL)
+    else if ((serviceClientDeviceMethodHandle->httpPool == NULL) && ((accessKey = STRING_construct(serviceClientDeviceMethodHandle->sharedAccessKey)) == NULL))
     {
         LogError("STRING_construct failed for accessKey");
         STRING_delete(uriResource);
         result = IOTHUB_DEVICE_METHOD_ERROR;
     }
-    else if ((keyName = STRING_construct(serviceClientDeviceMethodHandle->keyName)) == NULL)
+    else if ((serviceClientDeviceMethodHandle->httpPool == NULL) && ((keyName = STRING_construct(serviceClientDeviceMethodHandle->keyName)) == NULL))
     {
         LogError("STRING_construct failed for keyName");
         STRING_delete(accessKey);
@@ -280,7 +343,7 @@ static IOTHUB_DEVICE_METHOD_RESULT sendHttpRequestDeviceMethod(IOTHUB_SERVICE_CL
         STRING_delete(uriResource);
         result = IOTHUB_DEVICE_METHOD_ERROR;
     }
-    else if ((httpExApiSasHandle = HTTPAPIEX_SAS_Create(accessKey, uriResource, keyName)) == NULL)
+    else if ((serviceClientDeviceMethodHandle->httpPool == NULL) && ((httpExApiSasHandle = HTTPAPIEX_SAS_Create(accessKey, uriResource, keyName)) == NULL))
     {
         LogError("HTTPAPIEX_SAS_Create failed");
         HTTPHeaders_Free(httpHeader);
@@ -289,7 +352,7 @@ static IOTHUB_DEVICE_METHOD_RESULT sendHttpRequestDeviceMethod(IOTHUB_SERVICE_CL
         STRING_delete(uriResource);
         result = IOTHUB_DEVICE_METHOD_HTTPAPI_ERROR;
     }
-    else if ((httpExApiHandle = HTTPAPIEX_Create(serviceClientDeviceMethodHandle->hostname)) == NULL)
+    else if ((serviceClientDeviceMethodHandle->httpPool == NULL) && ((httpExApiHandle = HTTPAPIEX_Create(serviceClientDeviceMethodHandle->hostname)) == NULL))
     {
         LogError("HTTPAPIEX_Create failed");
         HTTPAPIEX_SAS_Destroy(httpExApiSasHandle);
@@ -327,7 +390,7 @@ static IOTHUB_DEVICE_METHOD_RESULT sendHttpRequestDeviceMethod(IOTHUB_SERVICE_CL
                 LogError("Failure creating relative path");
                 result = IOTHUB_DEVICE_METHOD_ERROR;
             }
-            else if (HTTPAPIEX_SAS_ExecuteRequest(httpExApiSasHandle, httpExApiHandle, httpApiRequestType, STRING_c_str(relativePath), httpHeader, deviceJsonBuffer, &statusCode, NULL, responseBuffer) != HTTPAPIEX_OK)
+            else if (executeHttpRequest(serviceClientDeviceMethodHandle, httpExApiSasHandle, httpExApiHandle, httpApiRequestType, STRING_c_str(relativePath), httpHeader, deviceJsonBuffer, &statusCode, responseBuffer) != HTTPAPIEX_OK)
             {
                 LogError("HTTPAPIEX_SAS_ExecuteRequest failed");
                 STRING_delete(relativePath);
@@ -357,6 +420,60 @@ static IOTHUB_DEVICE_METHOD_RESULT sendHttpRequestDeviceMethod(IOTHUB_SERVICE_CL
     return result;
 }
 
+static void destroyDeviceMethodAsync(DEVICE_METHOD_ASYNC* async);
+
+static void pushInvocation(DEVICE_METHOD_INVOCATION_QUEUE* queue, DEVICE_METHOD_INVOCATION* invocation)
+{
+    invocation->next = NULL;
+    if (queue->tail == NULL)
+    {
+        queue->head = invocation;
+    }
+    else
+    {
+        queue->tail->next = invocation;
+    }
+    queue->tail = invocation;
+    queue->count++;
+}
+
+static DEVICE_METHOD_INVOCATION* popInvocation(DEVICE_METHOD_INVOCATION_QUEUE* queue)
+{
+    DEVICE_METHOD_INVOCATION* result = queue->head;
+    if (result != NULL)
+    {
+        queue->head = result->next;
+        if (queue->head == NULL)
+        {
+            queue->tail = NULL;
+        }
+        queue->count--;
+        result->next = NULL;
+    }
+    return result;
+}
+
+static void freeInvocation(DEVICE_METHOD_INVOCATION* invocation)
+{
+    free(invocation->responsePayload);
+    free(invocation->methodPayload);
+    free(invocation->methodName);
+    free(invocation->moduleId);
+    free(invocation->deviceId);
+    free(invocation);
+}
+
+static void completeInvocations(DEVICE_METHOD_INVOCATION* invocation)
+{
+    while (invocation != NULL)
+    {
+        DEVICE_METHOD_INVOCATION* next = invocation->next;
+        invocation->invokeCompleteCallback(invocation->context, invocation->result, invocation->responseStatus, invocation->responsePayload, invocation->responsePayloadSize);
+        freeInvocation(invocation);
+        invocation = next;
+    }
+}
+
 IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE IoTHubDeviceMethod_Create(IOTHUB_SERVICE_CLIENT_AUTH_HANDLE serviceClientHandle)
 {
     IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE result;
@@ -408,6 +525,9 @@ IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE IoTHubDeviceMethod_Create(IOTHUB_SERV
             }
             else
             {
+                memset(result, 0, sizeof(*result));
+                result->maxConcurrentInvocations = IOTHUB_DEVICE_METHOD_DEFAULT_MAX_CONCURRENT_INVOCATIONS;
+
                 /*Codes_SRS_IOTHUBDEVICEMETHOD_12_005: [ If the allocation successful, IoTHubDeviceMethod_Create shall create a IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE from the given IOTHUB_SERVICE_CLIENT_AUTH_HANDLE and return with it ]*/
                 /*Codes_SRS_IOTHUBDEVICEMETHOD_12_006: [ IoTHubDeviceMethod_Create shall allocate memory and copy hostName to result->hostName by calling mallocAndStrcpy_s. ]*/
                 if (mallocAndStrcpy_s(&result->hostname, serviceClientAuth->hostname) != 0)
@@ -436,6 +556,17 @@ IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE IoTHubDeviceMethod_Create(IOTHUB_SERV
                     free(result);
                     result = NULL;
                 }
+                /*Codes_SRS_IOTHUBDEVICEMETHOD_41_001: [ If serviceClientHandle has an HTTP connection pool, IoTHubDeviceMethod_Create shall share it by calling IoTHubSCHttpPool_Clone ]*/
+                else if ((serviceClientAuth->httpPool != NULL) && ((result->httpPool = IoTHubSCHttpPool_Clone(serviceClientAuth->httpPool)) == NULL))
+                {
+                    /*Codes_SRS_IOTHUBDEVICEMETHOD_41_002: [ If the IoTHubSCHttpPool_Clone fails, IoTHubDeviceMethod_Create shall do clean up and return NULL. ]*/
+                    LogError("IoTHubSCHttpPool_Clone failed");
+                    free(result->hostname);
+                    free(result->sharedAccessKey);
+                    free(result->keyName);
+                    free(result);
+                    result = NULL;
+                }
             }
         }
     }
@@ -450,6 +581,17 @@ void IoTHubDeviceMethod_Destroy(IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE servi
         /*Codes_SRS_IOTHUBDEVICEMETHOD_12_017: [ If the serviceClientDeviceMethodHandle input parameter is not NULL IoTHubDeviceMethod_Destroy shall free the memory of it and return ]*/
         IOTHUB_SERVICE_CLIENT_DEVICE_METHOD* serviceClientDeviceMethod = (IOTHUB_SERVICE_CLIENT_DEVICE_METHOD*)serviceClientDeviceMethodHandle;
 
+        if (serviceClientDeviceMethod->async != NULL)
+        {
+            destroyDeviceMethodAsync(serviceClientDeviceMethod->async);
+        }
+
+        if (serviceClientDeviceMethod->httpPool != NULL)
+        {
+            /*Codes_SRS_IOTHUBDEVICEMETHOD_41_004: [ IoTHubDeviceMethod_Destroy shall release its reference to the HTTP connection pool by calling IoTHubSCHttpPool_Destroy ]*/
+            IoTHubSCHttpPool_Destroy(serviceClientDeviceMethod->httpPool);
+        }
+
         free(serviceClientDeviceMethod->hostname);
         free(serviceClientDeviceMethod->sharedAccessKey);
         free(serviceClientDeviceMethod->keyName);
@@ -547,3 +689,299 @@ IOTHUB_DEVICE_METHOD_RESULT IoTHubDeviceMethod_InvokeModule(IOTHUB_SERVICE_CLIEN
     return result;
 }
 
+static int deviceMethodInvokeWorker(void* arg)
+{
+    IOTHUB_SERVICE_CLIENT_DEVICE_METHOD* serviceClientDeviceMethod = (IOTHUB_SERVICE_CLIENT_DEVICE_METHOD*)arg;
+    DEVICE_METHOD_ASYNC* async = serviceClientDeviceMethod->async;
+
+    if (Lock(async->lock) != LOCK_OK)
+    {
+        LogError("Lock failed, device method worker exiting");
+    }
+    else
+    {
+        while (!async->stopWorkers)
+        {
+            /*Codes_SRS_IOTHUBDEVICEMETHOD_41_012: [ A worker shall take the oldest queued invocation while fewer than maxConcurrentInvocations invocations are executing, and wait by calling Condition_Wait otherwise ]*/
+            if ((async->pending.head == NULL) || (async->inFlightCount >= serviceClientDeviceMethod->maxConcurrentInvocations))
+            {
+                async->idleWorkerCount++;
+                (void)Condition_Wait(async->workAvailable, async->lock, 0);
+                async->idleWorkerCount--;
+            }
+            else
+            {
+                DEVICE_METHOD_INVOCATION* invocation = popInvocation(&async->pending);
+                async->inFlightCount++;
+                (void)Unlock(async->lock);
+
+                /*Codes_SRS_IOTHUBDEVICEMETHOD_41_013: [ The worker shall execute the invocation the way IoTHubDeviceMethod_Invoke(Module) does, without holding the lock ]*/
+                invocation->result = IoTHubDeviceMethod_DeviceOrModuleInvoke(serviceClientDeviceMethod, invocation->deviceId, invocation->moduleId, invocation->methodName, invocation->methodPayload, invocation->timeout, &invocation->responseStatus, &invocation->responsePayload, &invocation->responsePayloadSize);
+
+                if (Lock(async->lock) != LOCK_OK)
+                {
+                    /*the invocation can't be handed back, report it from here rather than losing it*/
+                    LogError("Lock failed, device method worker exiting");
+                    completeInvocations(invocation);
+                    break;
+                }
+
+                /*Codes_SRS_IOTHUBDEVICEMETHOD_41_014: [ The worker shall queue the completed invocation for IoTHubDeviceMethod_DoWork ]*/
+                pushInvocation(&async->completed, invocation);
+                async->inFlightCount--;
+            }
+        }
+
+        /*wake up the next worker waiting so that it sees stopWorkers too*/
+        (void)Condition_Post(async->workAvailable);
+        (void)Unlock(async->lock);
+    }
+    return 0;
+}
+
+/*must be called with the async lock held*/
+static void startInvocations(IOTHUB_SERVICE_CLIENT_DEVICE_METHOD* serviceClientDeviceMethod)
+{
+    DEVICE_METHOD_ASYNC* async = serviceClientDeviceMethod->async;
+    size_t startableCount = (async->inFlightCount < serviceClientDeviceMethod->maxConcurrentInvocations) ? serviceClientDeviceMethod->maxConcurrentInvocations - async->inFlightCount : 0;
+    size_t i;
+
+    if (startableCount > async->pending.count)
+    {
+        startableCount = async->pending.count;
+    }
+
+    /*Codes_SRS_IOTHUBDEVICEMETHOD_41_009: [ Queued invocations shall be handed to idle workers, waking them by calling Condition_Post ]*/
+    for (i = 0; (i < startableCount) && (i < async->idleWorkerCount); i++)
+    {
+        (void)Condition_Post(async->workAvailable);
+    }
+
+    /*Codes_SRS_IOTHUBDEVICEMETHOD_41_010: [ If there are more queued invocations than idle workers, a new worker shall be started by calling ThreadAPI_Create as long as fewer workers than maxConcurrentInvocations exist ]*/
+    for (; (i < startableCount) && (async->workerCount < serviceClientDeviceMethod->maxConcurrentInvocations); i++)
+    {
+        THREAD_HANDLE* workers = (THREAD_HANDLE*)realloc(async->workers, (async->workerCount + 1) * sizeof(THREAD_HANDLE));
+        if (workers == NULL)
+        {
+            LogError("realloc failed for the device method workers");
+            break;
+        }
+        async->workers = workers;
+
+        if (ThreadAPI_Create(&async->workers[async->workerCount], deviceMethodInvokeWorker, serviceClientDeviceMethod) != THREADAPI_OK)
+        {
+            /*Codes_SRS_IOTHUBDEVICEMETHOD_41_011: [ If ThreadAPI_Create fails the invocations shall stay queued and starting a worker shall be retried by the next IoTHubDeviceMethod_Invoke(Module)Async or IoTHubDeviceMethod_DoWork ]*/
+            LogError("ThreadAPI_Create failed for a device method worker");
+            break;
+        }
+        async->workerCount++;
+    }
+}
+
+static DEVICE_METHOD_ASYNC* createDeviceMethodAsync(void)
+{
+    DEVICE_METHOD_ASYNC* result;
+
+    if ((result = (DEVICE_METHOD_ASYNC*)malloc(sizeof(DEVICE_METHOD_ASYNC))) == NULL)
+    {
+        LogError("malloc failed for DEVICE_METHOD_ASYNC");
+    }
+    else
+    {
+        memset(result, 0, sizeof(*result));
+
+        if ((result->lock = Lock_Init()) == NULL)
+        {
+            LogError("Lock_Init failed");
+            free(result);
+            result = NULL;
+        }
+        else if ((result->workAvailable = Condition_Init()) == NULL)
+        {
+            LogError("Condition_Init failed");
+            (void)Lock_Deinit(result->lock);
+            free(result);
+            result = NULL;
+        }
+    }
+    return result;
+}
+
+static void destroyDeviceMethodAsync(DEVICE_METHOD_ASYNC* async)
+{
+    DEVICE_METHOD_INVOCATION* invocation;
+    size_t i;
+
+    /*Codes_SRS_IOTHUBDEVICEMETHOD_41_019: [ IoTHubDeviceMethod_Destroy shall stop the workers and wait for the invocations they are executing by calling ThreadAPI_Join ]*/
+    if (Lock(async->lock) != LOCK_OK)
+    {
+        LogError("Lock failed, stopping the device method workers anyway");
+        async->stopWorkers = true;
+        (void)Condition_Post(async->workAvailable);
+    }
+    else
+    {
+        async->stopWorkers = true;
+        (void)Condition_Post(async->workAvailable);
+        (void)Unlock(async->lock);
+    }
+
+    for (i = 0; i < async->workerCount; i++)
+    {
+        int res;
+        if (ThreadAPI_Join(async->workers[i], &res) != THREADAPI_OK)
+        {
+            LogError("ThreadAPI_Join failed for a device method worker");
+        }
+    }
+
+    /*Codes_SRS_IOTHUBDEVICEMETHOD_41_020: [ IoTHubDeviceMethod_Destroy shall call the callbacks of the completed invocations with their result and of the queued ones with IOTHUB_DEVICE_METHOD_ERROR ]*/
+    completeInvocations(async->completed.head);
+    for (invocation = async->pending.head; invocation != NULL; invocation = invocation->next)
+    {
+        invocation->result = IOTHUB_DEVICE_METHOD_ERROR;
+    }
+    completeInvocations(async->pending.head);
+
+    free(async->workers);
+    Condition_Deinit(async->workAvailable);
+    (void)Lock_Deinit(async->lock);
+    free(async);
+}
+
+static IOTHUB_DEVICE_METHOD_RESULT IoTHubDeviceMethod_DeviceOrModuleInvokeAsync(IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE serviceClientDeviceMethodHandle, const char* deviceId, const char* moduleId, const char* methodName, const char* methodPayload, unsigned int timeout, IOTHUB_DEVICE_METHOD_INVOKE_COMPLETE_CALLBACK invokeCompleteCallback, void* context)
+{
+    IOTHUB_DEVICE_METHOD_RESULT result;
+    DEVICE_METHOD_INVOCATION* invocation;
+
+    /*Codes_SRS_IOTHUBDEVICEMETHOD_41_005: [ IoTHubDeviceMethod_Invoke(Module)Async shall verify the input parameters and if any of them (except the timeout and the context) are NULL then return IOTHUB_DEVICE_METHOD_INVALID_ARG ]*/
+    if ((serviceClientDeviceMethodHandle == NULL) || (deviceId == NULL) || (methodName == NULL) || (methodPayload == NULL) || (invokeCompleteCallback == NULL))
+    {
+        LogError("Input parameter cannot be NULL");
+        result = IOTHUB_DEVICE_METHOD_INVALID_ARG;
+    }
+    /*Codes_SRS_IOTHUBDEVICEMETHOD_41_006: [ The first call of IoTHubDeviceMethod_Invoke(Module)Async shall create the lock and the condition shared with the workers by calling Lock_Init and Condition_Init ]*/
+    else if ((serviceClientDeviceMethodHandle->async == NULL) && ((serviceClientDeviceMethodHandle->async = createDeviceMethodAsync()) == NULL))
+    {
+        /*Codes_SRS_IOTHUBDEVICEMETHOD_41_008: [ If any of the calls fail IoTHubDeviceMethod_Invoke(Module)Async shall do clean up and return IOTHUB_DEVICE_METHOD_ERROR ]*/
+        LogError("Failure creating the device method async state");
+        result = IOTHUB_DEVICE_METHOD_ERROR;
+    }
+    else if ((invocation = (DEVICE_METHOD_INVOCATION*)malloc(sizeof(DEVICE_METHOD_INVOCATION))) == NULL)
+    {
+        LogError("malloc failed for DEVICE_METHOD_INVOCATION");
+        result = IOTHUB_DEVICE_METHOD_ERROR;
+    }
+    else
+    {
+        memset(invocation, 0, sizeof(*invocation));
+        invocation->timeout = timeout;
+        invocation->invokeCompleteCallback = invokeCompleteCallback;
+        invocation->context = context;
+
+        /*Codes_SRS_IOTHUBDEVICEMETHOD_41_007: [ IoTHubDeviceMethod_Invoke(Module)Async shall copy deviceId, moduleId, methodName and methodPayload, queue the invocation and return IOTHUB_DEVICE_METHOD_OK ]*/
+        if ((mallocAndStrcpy_s(&invocation->deviceId, deviceId) != 0) ||
+            ((moduleId != NULL) && (mallocAndStrcpy_s(&invocation->moduleId, moduleId) != 0)) ||
+            (mallocAndStrcpy_s(&invocation->methodName, methodName) != 0) ||
+            (mallocAndStrcpy_s(&invocation->methodPayload, methodPayload) != 0))
+        {
+            LogError("mallocAndStrcpy_s failed for the invocation");
+            freeInvocation(invocation);
+            result = IOTHUB_DEVICE_METHOD_ERROR;
+        }
+        else if (Lock(serviceClientDeviceMethodHandle->async->lock) != LOCK_OK)
+        {
+            LogError("Lock failed");
+            freeInvocation(invocation);
+            result = IOTHUB_DEVICE_METHOD_ERROR;
+        }
+        else
+        {
+            pushInvocation(&serviceClientDeviceMethodHandle->async->pending, invocation);
+            startInvocations(serviceClientDeviceMethodHandle);
+            (void)Unlock(serviceClientDeviceMethodHandle->async->lock);
+            result = IOTHUB_DEVICE_METHOD_OK;
+        }
+    }
+    return result;
+}
+
+IOTHUB_DEVICE_METHOD_RESULT IoTHubDeviceMethod_InvokeAsync(IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE serviceClientDeviceMethodHandle, const char* deviceId, const char* methodName, const char* methodPayload, unsigned int timeout, IOTHUB_DEVICE_METHOD_INVOKE_COMPLETE_CALLBACK invokeCompleteCallback, void* context)
+{
+    return IoTHubDeviceMethod_DeviceOrModuleInvokeAsync(serviceClientDeviceMethodHandle, deviceId, NULL, methodName, methodPayload, timeout, invokeCompleteCallback, context);
+}
+
+IOTHUB_DEVICE_METHOD_RESULT IoTHubDeviceMethod_InvokeModuleAsync(IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE serviceClientDeviceMethodHandle, const char* deviceId, const char* moduleId, const char* methodName, const char* methodPayload, unsigned int timeout, IOTHUB_DEVICE_METHOD_INVOKE_COMPLETE_CALLBACK invokeCompleteCallback, void* context)
+{
+    IOTHUB_DEVICE_METHOD_RESULT result;
+
+    if (moduleId == NULL)
+    {
+        /*Codes_SRS_IOTHUBDEVICEMETHOD_41_015: [ IoTHubDeviceMethod_InvokeModuleAsync shall return IOTHUB_DEVICE_METHOD_INVALID_ARG if moduleId is NULL ]*/
+        LogError("moduleId input parameter cannot be NULL");
+        result = IOTHUB_DEVICE_METHOD_INVALID_ARG;
+    }
+    else
+    {
+        result = IoTHubDeviceMethod_DeviceOrModuleInvokeAsync(serviceClientDeviceMethodHandle, deviceId, moduleId, methodName, methodPayload, timeout, invokeCompleteCallback, context);
+    }
+
+    return result;
+}
+
+IOTHUB_DEVICE_METHOD_RESULT IoTHubDeviceMethod_SetMaxConcurrentInvocations(IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE serviceClientDeviceMethodHandle, size_t maxConcurrentInvocations)
+{
+    IOTHUB_DEVICE_METHOD_RESULT result;
+
+    /*Codes_SRS_IOTHUBDEVICEMETHOD_41_016: [ If serviceClientDeviceMethodHandle is NULL or maxConcurrentInvocations is 0 IoTHubDeviceMethod_SetMaxConcurrentInvocations shall return IOTHUB_DEVICE_METHOD_INVALID_ARG ]*/
+    if ((serviceClientDeviceMethodHandle == NULL) || (maxConcurrentInvocations == 0))
+    {
+        LogError("Invalid argument: serviceClientDeviceMethodHandle=%p, maxConcurrentInvocations=%lu", serviceClientDeviceMethodHandle, (unsigned long)maxConcurrentInvocations);
+        result = IOTHUB_DEVICE_METHOD_INVALID_ARG;
+    }
+    else if (serviceClientDeviceMethodHandle->async == NULL)
+    {
+        /*Codes_SRS_IOTHUBDEVICEMETHOD_41_017: [ IoTHubDeviceMethod_SetMaxConcurrentInvocations shall change the number of invocations executed at the same time, applying to the invocations that are not executing yet ]*/
+        serviceClientDeviceMethodHandle->maxConcurrentInvocations = maxConcurrentInvocations;
+        result = IOTHUB_DEVICE_METHOD_OK;
+    }
+    else if (Lock(serviceClientDeviceMethodHandle->async->lock) != LOCK_OK)
+    {
+        LogError("Lock failed");
+        result = IOTHUB_DEVICE_METHOD_ERROR;
+    }
+    else
+    {
+        serviceClientDeviceMethodHandle->maxConcurrentInvocations = maxConcurrentInvocations;
+        startInvocations(serviceClientDeviceMethodHandle);
+        (void)Unlock(serviceClientDeviceMethodHandle->async->lock);
+        result = IOTHUB_DEVICE_METHOD_OK;
+    }
+    return result;
+}
+
+void IoTHubDeviceMethod_DoWork(IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE serviceClientDeviceMethodHandle)
+{
+    /*Codes_SRS_IOTHUBDEVICEMETHOD_41_018: [ If serviceClientDeviceMethodHandle is NULL or no asynchronous invocation has been queued IoTHubDeviceMethod_DoWork shall return ]*/
+    if ((serviceClientDeviceMethodHandle != NULL) && (serviceClientDeviceMethodHandle->async != NULL))
+    {
+        DEVICE_METHOD_ASYNC* async = serviceClientDeviceMethodHandle->async;
+
+        if (Lock(async->lock) != LOCK_OK)
+        {
+            LogError("Lock failed");
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBDEVICEMETHOD_41_021: [ IoTHubDeviceMethod_DoWork shall take the completed invocations, retry starting workers for the queued ones, and call the callbacks after releasing the lock, freeing the response payload once the callback returns ]*/
+            DEVICE_METHOD_INVOCATION* completed = async->completed.head;
+            async->completed.head = NULL;
+            async->completed.tail = NULL;
+            async->completed.count = 0;
+            startInvocations(serviceClientDeviceMethodHandle);
+            (void)Unlock(async->lock);
+
+            completeInvocations(completed);
+        }
+    }
+}
@@ -15,17 +15,21 @@
 #include "azure_c_shared_utility/base64.h"
 #include "azure_c_shared_utility/uniqueid.h"
 #include "azure_c_shared_utility/connection_string_parser.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/threadapi.h"
 
 #include "parson.h"
 #include "iothub_devicetwin.h"
 #include "iothub_sc_version.h"
+#include "internal/iothub_sc_http_pool.h"
 
 #define IOTHUB_TWIN_REQUEST_MODE_VALUES    \
     IOTHUB_TWIN_REQUEST_GET,               \
     IOTHUB_TWIN_REQUEST_UPDATE,            \
     IOTHUB_TWIN_REQUEST_REPLACE_TAGS,      \
     IOTHUB_TWIN_REQUEST_REPLACE_DESIRED,   \
-    IOTHUB_TWIN_REQUEST_UPDATE_DESIRED
+    IOTHUB_TWIN_REQUEST_UPDATE_DESIRED,    \
+    IOTHUB_TWIN_REQUEST_QUERY
 
 DEFINE_ENUM(IOTHUB_TWIN_REQUEST_MODE, IOTHUB_TWIN_REQUEST_MODE_VALUES);
 DEFINE_ENUM_STRINGS(IOTHUB_DEVICE_TWIN_RESULT, IOTHUB_DEVICE_TWIN_RESULT_VALUES);
@@ -41,12 +45,20 @@ DEFINE_ENUM_STRINGS(IOTHUB_DEVICE_TWIN_RESULT, IOTHUB_DEVICE_TWIN_RESULT_VALUES)
 #define  HTTP_HEADER_VAL_CONTENT_TYPE  "application/json; charset=utf-8"
 #define  HTTP_HEADER_KEY_IFMATCH  "If-Match"
 #define  HTTP_HEADER_VAL_IFMATCH  "*"
+#define  HTTP_HEADER_KEY_MAX_ITEM_COUNT  "x-ms-max-item-count"
+#define  HTTP_HEADER_KEY_CONTINUATION  "x-ms-continuation"
 #define UID_LENGTH 37
 
 static const char* URL_API_VERSION = "?api-version=2017-11-08-preview";
 
 static const char* RELATIVE_PATH_FMT_TWIN = "/twins/%s%s";
 static const char* RELATIVE_PATH_FMT_TWIN_MODULE = "/twins/%s/modules/%s%s";
+static const char* RELATIVE_PATH_FMT_TWIN_QUERY = "/devices/query%s";
+static const char* HTTP_HEADER_FMT_IFMATCH_ETAG = "\"%s\"";
+
+static const char* TWIN_QUERY_JSON_KEY_QUERY = "query";
+
+static size_t IOTHUB_TWIN_QUERY_MAX_PAGE_SIZE = 1000;
 
 
 /** @brief Structure to store IoTHub authentication information
@@ -56,6 +68,7 @@ typedef struct IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_TAG
     char* hostname;
     char* sharedAccessKey;
     char* keyName;
+    IOTHUB_SC_HTTP_POOL_HANDLE httpPool;
 } IOTHUB_SERVICE_CLIENT_DEVICE_TWIN;
 
 static const char* generateGuid(void)
@@ -81,6 +94,7 @@ static STRING_HANDLE createRelativePath(IOTHUB_TWIN_REQUEST_MODE iotHubTwinReque
     //IOTHUB_TWIN_REQUEST_REPLACE_TAGS      PUT      {iot hub}/twins/{device id}/tags                // Replace update tags
     //IOTHUB_TWIN_REQUEST_REPLACE_DESIRED   PUT      {iot hub}/twins/{device id}/properties/desired  // Replace update desired properties
     //IOTHUB_TWIN_REQUEST_UPDATE_DESIRED    PATCH    {iot hub}/twins/{device id}/properties/desired  // Partially update desired properties
+    //IOTHUB_TWIN_REQUEST_QUERY             POST     {iot hub}/devices/query                         // Query device twins
 
     STRING_HANDLE result;
 
@@ -95,6 +109,10 @@ static STRING_HANDLE createRelativePath(IOTHUB_TWIN_REQUEST_MODE iotHubTwinReque
             result = STRING_construct_sprintf(RELATIVE_PATH_FMT_TWIN_MODULE, deviceId, moduleId, URL_API_VERSION);
         }
     }
+    else if (iotHubTwinRequestMode == IOTHUB_TWIN_REQUEST_QUERY)
+    {
+        result = STRING_construct_sprintf(RELATIVE_PATH_FMT_TWIN_QUERY, URL_API_VERSION);
+    }
     else
     {
         result = NULL;
@@ -142,7 +160,7 @@ static HTTP_HEADERS_HANDLE createHttpHeader(IOTHUB_TWIN_REQUEST_MODE iotHubTwinR
         HTTPHeaders_Free(httpHeader);
         httpHeader = NULL;
     }
-    else if (iotHubTwinRequestMode != IOTHUB_TWIN_REQUEST_GET)
+    else if ((iotHubTwinRequestMode != IOTHUB_TWIN_REQUEST_GET) && (iotHubTwinRequestMode != IOTHUB_TWIN_REQUEST_QUERY))
     {
         if (HTTPHeaders_AddHeaderNameValuePair(httpHeader, HTTP_HEADER_KEY_IFMATCH, HTTP_HEADER_VAL_IFMATCH) != HTTP_HEADERS_OK)
         {
@@ -156,6 +174,22 @@ static HTTP_HEADERS_HANDLE createHttpHeader(IOTHUB_TWIN_REQUEST_MODE iotHubTwinR
     return httpHeader;
 }
 
+static HTTPAPIEX_RESULT executeHttpRequest(IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE serviceClientDeviceTwinHandle, HTTPAPIEX_SAS_HANDLE httpExApiSasHandle, HTTPAPIEX_HANDLE httpExApiHandle, HTTPAPI_REQUEST_TYPE httpApiRequestType, const char* relativePath, HTTP_HEADERS_HANDLE httpHeader, BUFFER_HANDLE requestBuffer, unsigned int* statusCode, BUFFER_HANDLE responseBuffer)
+{
+    HTTPAPIEX_RESULT result;
+
+    if (serviceClientDeviceTwinHandle->httpPool != NULL)
+    {
+        /*Codes_SRS_IOTHUBDEVICETWIN_41_003: [ If the handle shares an HTTP connection pool, the request shall be executed on a pooled keep-alive connection with the cached SAS token by calling IoTHubSCHttpPool_ExecuteRequest instead of creating an HTTPAPIEX_SAS_HANDLE and an HTTPAPIEX_HANDLE per request ]*/
+        result = IoTHubSCHttpPool_ExecuteRequest(serviceClientDeviceTwinHandle->httpPool, httpApiRequestType, relativePath, httpHeader, requestBuffer, statusCode, NULL, responseBuffer);
+    }
+    else
+    {
+        result = HTTPAPIEX_SAS_ExecuteRequest(httpExApiSasHandle, httpExApiHandle, httpApiRequestType, relativePath, httpHeader, requestBuffer, statusCode, NULL, responseBuffer);
+    }
+    return result;
+}
+
 static IOTHUB_DEVICE_TWIN_RESULT sendHttpRequestTwin(IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE serviceClientDeviceTwinHandle, IOTHUB_TWIN_REQUEST_MODE iotHubTwinRequestMode, const char* deviceName, const char* moduleId, BUFFER_HANDLE deviceJsonBuffer, BUFFER_HANDLE responseBuffer)
 {
     IOTHUB_DEVICE_TWIN_RESULT result;
@@ -163,24 +197,24 @@ static IOTHUB_DEVICE_TWIN_RESULT sendHttpRequestTwin(IOTHUB_SERVICE_CLIENT_DEVIC
     STRING_HANDLE uriResource = NULL;
     STRING_HANDLE accessKey = NULL;
     STRING_HANDLE keyName = NULL;
-    HTTPAPIEX_SAS_HANDLE httpExApiSasHandle;
-    HTTPAPIEX_HANDLE httpExApiHandle;
+    HTTPAPIEX_SAS_HANDLE httpExApiSasHandle = NULL;
+    HTTPAPIEX_HANDLE httpExApiHandle = NULL;
     HTTP_HEADERS_HANDLE httpHeader;
 
-    if ((uriResource = STRING_construct(serviceClientDeviceTwinHandle->hostname)) == NULL)
+    if ((serviceClientDeviceTwinHandle->httpPool == NULL) && ((uriResource = STRING_construct(serviceClientDeviceTwinHandle->hostname)) == NULL))
     {
         /*Codes_SRS_IOTHUBDEVICETWIN_12_024: [ If any of the HTTPAPI call fails IoTHubDeviceTwin_GetTwin shall fail and return NULL ]*/
         LogError("STRING_construct failed for uriResource");
         result = IOTHUB_DEVICE_TWIN_ERROR;
     }
-    else if ((accessKey = STRING_construct(serviceClientDeviceTwinHandle->sharedAccessKey)) == NULL)
+    else if ((serviceClientDeviceTwinHandle->httpPool == NULL) && ((accessKey = STRING_construct(serviceClientDeviceTwinHandle->sharedAccessKey)) == NULL))
     {
         /*Codes_SRS_IOTHUBDEVICETWIN_12_024: [ If any of the call fails during the HTTP creation IoTHubDeviceTwin_GetTwin shall fail and return NULL ]*/
         LogError("STRING_construct failed for accessKey");
         STRING_delete(uriResource);
         result = IOTHUB_DEVICE_TWIN_ERROR;
     }
-    else if ((keyName = STRING_construct(serviceClientDeviceTwinHandle->keyName)) == NULL)
+    else if ((serviceClientDeviceTwinHandle->httpPool == NULL) && ((keyName = STRING_construct(serviceClientDeviceTwinHandle->keyName)) == NULL))
     {
         /*Codes_SRS_IOTHUBDEVICETWIN_12_024: [ If any of the call fails during the HTTP creation IoTHubDeviceTwin_GetTwin shall fail and return NULL ]*/
         LogError("STRING_construct failed for keyName");
@@ -199,7 +233,7 @@ static IOTHUB_DEVICE_TWIN_RESULT sendHttpRequestTwin(IOTHUB_SERVICE_CLIENT_DEVIC
         result = IOTHUB_DEVICE_TWIN_ERROR;
     }
     /*Codes_SRS_IOTHUBDEVICETWIN_12_021: [ IoTHubDeviceTwin_GetTwin shall create an HTTPAPIEX_SAS_HANDLE handle by calling HTTPAPIEX_SAS_Create ]*/
-    else if ((httpExApiSasHandle = HTTPAPIEX_SAS_Create(accessKey, uriResource, keyName)) == NULL)
+    else if ((serviceClientDeviceTwinHandle->httpPool == NULL) && ((httpExApiSasHandle = HTTPAPIEX_SAS_Create(accessKey, uriResource, keyName)) == NULL))
     {
         /*Codes_SRS_IOTHUBDEVICETWIN_12_025: [ If any of the HTTPAPI call fails IoTHubDeviceTwin_GetTwin shall fail and return IOTHUB_DEVICE_TWIN_HTTPAPI_ERROR ]*/
         LogError("HTTPAPIEX_SAS_Create failed");
@@ -210,7 +244,7 @@ static IOTHUB_DEVICE_TWIN_RESULT sendHttpRequestTwin(IOTHUB_SERVICE_CLIENT_DEVIC
         result = IOTHUB_DEVICE_TWIN_HTTPAPI_ERROR;
     }
     /*Codes_SRS_IOTHUBDEVICETWIN_12_022: [ IoTHubDeviceTwin_GetTwin shall create an HTTPAPIEX_HANDLE handle by calling HTTPAPIEX_Create ]*/
-    else if ((httpExApiHandle = HTTPAPIEX_Create(serviceClientDeviceTwinHandle->hostname)) == NULL)
+    else if ((serviceClientDeviceTwinHandle->httpPool == NULL) && ((httpExApiHandle = HTTPAPIEX_Create(serviceClientDeviceTwinHandle->hostname)) == NULL))
     {
         /*Codes_SRS_IOTHUBDEVICETWIN_12_025: [ If any of the HTTPAPI call fails IoTHubDeviceTwin_GetTwin shall fail and return NULL ]*/
         LogError("HTTPAPIEX_Create failed");
@@ -266,7 +300,7 @@ static IOTHUB_DEVICE_TWIN_RESULT sendHttpRequestTwin(IOTHUB_SERVICE_CLIENT_DEVIC
                 result = IOTHUB_DEVICE_TWIN_ERROR;
             }
             /*Codes_SRS_IOTHUBDEVICETWIN_12_023: [ IoTHubDeviceTwin_GetTwin shall execute the HTTP GET request by calling HTTPAPIEX_ExecuteRequest ]*/
-            else if (HTTPAPIEX_SAS_ExecuteRequest(httpExApiSasHandle, httpExApiHandle, httpApiRequestType, STRING_c_str(relativePath), httpHeader, deviceJsonBuffer, &statusCode, NULL, responseBuffer) != HTTPAPIEX_OK)
+            else if (executeHttpRequest(serviceClientDeviceTwinHandle, httpExApiSasHandle, httpExApiHandle, httpApiRequestType, STRING_c_str(relativePath), httpHeader, deviceJsonBuffer, &statusCode, responseBuffer) != HTTPAPIEX_OK)
             {
                 /*Codes_SRS_IOTHUBDEVICETWIN_12_025: [ If any of the HTTPAPI call fails IoTHubDeviceTwin_GetTwin shall fail and return NULL ]*/
                 LogError("HTTPAPIEX_SAS_ExecuteRequest failed");
@@ -301,6 +335,11 @@ static IOTHUB_DEVICE_TWIN_RESULT sendHttpRequestTwin(IOTHUB_SERVICE_CLIENT_DEVIC
 
 static void free_devicetwin_handle(IOTHUB_SERVICE_CLIENT_DEVICE_TWIN* deviceTwin)
 {
+    if (deviceTwin->httpPool != NULL)
+    {
+        /*Codes_SRS_IOTHUBDEVICETWIN_41_004: [ IoTHubDeviceTwin_Destroy shall release its reference to the HTTP connection pool by calling IoTHubSCHttpPool_Destroy ]*/
+        IoTHubSCHttpPool_Destroy(deviceTwin->httpPool);
+    }
     free(deviceTwin->hostname);
     free(deviceTwin->sharedAccessKey);
     free(deviceTwin->keyName);
@@ -385,6 +424,14 @@ IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE IoTHubDeviceTwin_Create(IOTHUB_SERVICE_
                     free_devicetwin_handle(result);
                     result = NULL;
                 }
+                /*Codes_SRS_IOTHUBDEVICETWIN_41_001: [ If serviceClientHandle has an HTTP connection pool, IoTHubDeviceTwin_Create shall share it by calling IoTHubSCHttpPool_Clone ]*/
+                else if ((serviceClientAuth->httpPool != NULL) && ((result->httpPool = IoTHubSCHttpPool_Clone(serviceClientAuth->httpPool)) == NULL))
+                {
+                    /*Codes_SRS_IOTHUBDEVICETWIN_41_002: [ If the IoTHubSCHttpPool_Clone fails, IoTHubDeviceTwin_Create shall do clean up and return NULL. ]*/
+                    LogError("IoTHubSCHttpPool_Clone failed");
+                    free_devicetwin_handle(result);
+                    result = NULL;
+                }
             }
         }
     }
@@ -580,6 +627,467 @@ char* IoTHubDeviceTwin_UpdateModuleTwin(IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE
     return result;
 }
 
+/*shares the connection pool of the handle, or creates one for the duration of the query or the batch if the handle has none*/
+static IOTHUB_SC_HTTP_POOL_HANDLE acquireHttpPool(IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE serviceClientDeviceTwinHandle)
+{
+    IOTHUB_SC_HTTP_POOL_HANDLE result;
 
+    if (serviceClientDeviceTwinHandle->httpPool != NULL)
+    {
+        result = IoTHubSCHttpPool_Clone(serviceClientDeviceTwinHandle->httpPool);
+    }
+    else
+    {
+        result = IoTHubSCHttpPool_Create(serviceClientDeviceTwinHandle->hostname, serviceClientDeviceTwinHandle->sharedAccessKey, serviceClientDeviceTwinHandle->keyName, NULL);
+    }
+    return result;
+}
 
+/*fetches the page continuing at *continuationToken (the first page if NULL) into responseBuffer and replaces the token with the one of the following page, NULL after the last page*/
+static IOTHUB_DEVICE_TWIN_RESULT fetchTwinQueryPage(IOTHUB_SC_HTTP_POOL_HANDLE httpPool, BUFFER_HANDLE queryBuffer, size_t pageSize, char** continuationToken, BUFFER_HANDLE responseBuffer)
+{
+    IOTHUB_DEVICE_TWIN_RESULT result;
+    HTTP_HEADERS_HANDLE httpHeader = NULL;
+    HTTP_HEADERS_HANDLE responseHeader = NULL;
+    STRING_HANDLE relativePath = NULL;
+    char pageSizeStr[32];
+    unsigned int statusCode = 0;
 
+    /*Codes_SRS_IOTHUBDEVICETWIN_41_008: [ IoTHubDeviceTwin_QueryTwins shall request every page with an HTTP POST of the query to url/devices/query, adding the x-ms-max-item-count header set to pageSize to the headers used by IoTHubDeviceTwin_GetTwin ]*/
+    if ((httpHeader = createHttpHeader(IOTHUB_TWIN_REQUEST_QUERY)) == NULL)
+    {
+        LogError("HttpHeader creation failed");
+        result = IOTHUB_DEVICE_TWIN_ERROR;
+    }
+    else if ((snprintf(pageSizeStr, sizeof(pageSizeStr), "%lu", (unsigned long)pageSize) <= 0) ||
+        (HTTPHeaders_AddHeaderNameValuePair(httpHeader, HTTP_HEADER_KEY_MAX_ITEM_COUNT, pageSizeStr) != HTTP_HEADERS_OK))
+    {
+        LogError("HTTPHeaders_AddHeaderNameValuePair failed for x-ms-max-item-count header");
+        result = IOTHUB_DEVICE_TWIN_ERROR;
+    }
+    /*Codes_SRS_IOTHUBDEVICETWIN_41_009: [ Every page after the first one shall be requested with the x-ms-continuation header set to the continuation token returned with the previous page, and the query shall end after the first page that comes back without one ]*/
+    else if ((*continuationToken != NULL) && (HTTPHeaders_AddHeaderNameValuePair(httpHeader, HTTP_HEADER_KEY_CONTINUATION, *continuationToken) != HTTP_HEADERS_OK))
+    {
+        LogError("HTTPHeaders_AddHeaderNameValuePair failed for x-ms-continuation header");
+        result = IOTHUB_DEVICE_TWIN_ERROR;
+    }
+    else if ((responseHeader = HTTPHeaders_Alloc()) == NULL)
+    {
+        LogError("HTTPHeaders_Alloc failed for the response headers");
+        result = IOTHUB_DEVICE_TWIN_ERROR;
+    }
+    else if ((relativePath = createRelativePath(IOTHUB_TWIN_REQUEST_QUERY, NULL, NULL)) == NULL)
+    {
+        LogError("Failure creating relative path");
+        result = IOTHUB_DEVICE_TWIN_ERROR;
+    }
+    else if (IoTHubSCHttpPool_ExecuteRequest(httpPool, HTTPAPI_REQUEST_POST, STRING_c_str(relativePath), httpHeader, queryBuffer, &statusCode, responseHeader, responseBuffer) != HTTPAPIEX_OK)
+    {
+        /*Codes_SRS_IOTHUBDEVICETWIN_41_011: [ If any of the HTTPAPI calls fails IoTHubDeviceTwin_QueryTwins shall stop and return IOTHUB_DEVICE_TWIN_HTTPAPI_ERROR ]*/
+        LogError("IoTHubSCHttpPool_ExecuteRequest failed");
+        result = IOTHUB_DEVICE_TWIN_HTTPAPI_ERROR;
+    }
+    else if (statusCode != 200)
+    {
+        /*Codes_SRS_IOTHUBDEVICETWIN_41_012: [ If the received HTTP status code is not 200, or a page is not a JSon array, IoTHubDeviceTwin_QueryTwins shall stop and return IOTHUB_DEVICE_TWIN_ERROR ]*/
+        LogError("Http Failure status code %d.", statusCode);
+        result = IOTHUB_DEVICE_TWIN_ERROR;
+    }
+    else
+    {
+        const char* nextContinuationToken = HTTPHeaders_FindHeaderValue(responseHeader, HTTP_HEADER_KEY_CONTINUATION);
+
+        free(*continuationToken);
+        *continuationToken = NULL;
+
+        if ((nextContinuationToken != NULL) && (*nextContinuationToken != '\0') && (mallocAndStrcpy_s(continuationToken, nextContinuationToken) != 0))
+        {
+            LogError("mallocAndStrcpy_s failed for the continuation token");
+            result = IOTHUB_DEVICE_TWIN_ERROR;
+        }
+        else
+        {
+            result = IOTHUB_DEVICE_TWIN_OK;
+        }
+    }
+
+    STRING_delete(relativePath);
+    HTTPHeaders_Free(responseHeader);
+    HTTPHeaders_Free(httpHeader);
+    return result;
+}
+
+static IOTHUB_DEVICE_TWIN_RESULT deliverTwinQueryPage(BUFFER_HANDLE responseBuffer, char** twinJson, size_t* twinJsonSize, IOTHUB_DEVICE_TWIN_QUERY_CALLBACK twinCallback, void* context, bool* isStopped)
+{
+    IOTHUB_DEVICE_TWIN_RESULT result;
+    size_t responseLength = BUFFER_length(responseBuffer);
+    unsigned char* bufferStr;
+    JSON_Value* root_value = NULL;
+    JSON_Array* twin_array;
+
+    /*the response isn't zero terminated, terminate it in place instead of copying it*/
+    if (BUFFER_enlarge(responseBuffer, 1) != 0)
+    {
+        LogError("BUFFER_enlarge failed");
+        result = IOTHUB_DEVICE_TWIN_ERROR;
+    }
+    else if ((bufferStr = BUFFER_u_char(responseBuffer)) == NULL)
+    {
+        LogError("BUFFER_u_char failed");
+        result = IOTHUB_DEVICE_TWIN_ERROR;
+    }
+    else
+    {
+        bufferStr[responseLength] = '\0';
+
+        if (((root_value = json_parse_string((const char*)bufferStr)) == NULL) ||
+            ((twin_array = json_value_get_array(root_value)) == NULL))
+        {
+            LogError("the query page is not a JSON array");
+            result = IOTHUB_DEVICE_TWIN_ERROR;
+        }
+        else
+        {
+            size_t array_count = json_array_get_count(twin_array);
+            size_t i;
+
+            result = IOTHUB_DEVICE_TWIN_OK;
+            for (i = 0; i < array_count; i++)
+            {
+                JSON_Value* twin_value = json_array_get_value(twin_array, i);
+                size_t twin_size;
+
+                if ((twin_value == NULL) || ((twin_size = json_serialization_size(twin_value)) == 0))
+                {
+                    LogError("json_serialization_size failed");
+                    result = IOTHUB_DEVICE_TWIN_ERROR;
+                    break;
+                }
+
+                /*Codes_SRS_IOTHUBDEVICETWIN_41_010: [ IoTHubDeviceTwin_QueryTwins shall call twinCallback once per twin of the page, serializing each twin into one buffer reused for the whole query ]*/
+                if (twin_size > *twinJsonSize)
+                {
+                    char* newTwinJson = (char*)realloc(*twinJson, twin_size);
+                    if (newTwinJson == NULL)
+                    {
+                        LogError("realloc failed for the twin");
+                        result = IOTHUB_DEVICE_TWIN_ERROR;
+                        break;
+                    }
+                    *twinJson = newTwinJson;
+                    *twinJsonSize = twin_size;
+                }
+
+                if (json_serialize_to_buffer(twin_value, *twinJson, *twinJsonSize) != JSONSuccess)
+                {
+                    LogError("json_serialize_to_buffer failed");
+                    result = IOTHUB_DEVICE_TWIN_ERROR;
+                    break;
+                }
+
+                if (!twinCallback(context, *twinJson))
+                {
+                    /*Codes_SRS_IOTHUBDEVICETWIN_41_013: [ If twinCallback returns false IoTHubDeviceTwin_QueryTwins shall not call it again, shall not request any further page and shall return IOTHUB_DEVICE_TWIN_OK ]*/
+                    *isStopped = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    if (root_value != NULL)
+    {
+        json_value_free(root_value);
+    }
+
+    return result;
+}
+
+IOTHUB_DEVICE_TWIN_RESULT IoTHubDeviceTwin_QueryTwins(IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE serviceClientDeviceTwinHandle, const char* query, size_t pageSize, IOTHUB_DEVICE_TWIN_QUERY_CALLBACK twinCallback, void* context)
+{
+    IOTHUB_DEVICE_TWIN_RESULT result;
+
+    /*Codes_SRS_IOTHUBDEVICETWIN_41_005: [ If serviceClientDeviceTwinHandle, query or twinCallback is NULL, or pageSize is not between 1 and 1000, IoTHubDeviceTwin_QueryTwins shall return IOTHUB_DEVICE_TWIN_INVALID_ARG ]*/
+    if ((serviceClientDeviceTwinHandle == NULL) || (query == NULL) || (twinCallback == NULL))
+    {
+        LogError("Input parameter cannot be NULL");
+        result = IOTHUB_DEVICE_TWIN_INVALID_ARG;
+    }
+    else if ((pageSize == 0) || (pageSize > IOTHUB_TWIN_QUERY_MAX_PAGE_SIZE))
+    {
+        LogError("pageSize has to be between 1 and 1000");
+        result = IOTHUB_DEVICE_TWIN_INVALID_ARG;
+    }
+    else
+    {
+        JSON_Value* query_value = NULL;
+        char* queryJson = NULL;
+        BUFFER_HANDLE queryBuffer = NULL;
+        BUFFER_HANDLE responseBuffer = NULL;
+        IOTHUB_SC_HTTP_POOL_HANDLE httpPool = NULL;
+        char* continuationToken = NULL;
+        char* twinJson = NULL;
+        size_t twinJsonSize = 0;
+
+        /*Codes_SRS_IOTHUBDEVICETWIN_41_006: [ IoTHubDeviceTwin_QueryTwins shall serialize the query once into a {"query":...} JSon body and allocate one response buffer by calling BUFFER_new, both reused for every page ]*/
+        if ((query_value = json_value_init_object()) == NULL)
+        {
+            LogError("json_value_init_object failed");
+            result = IOTHUB_DEVICE_TWIN_ERROR;
+        }
+        else if (json_object_set_string(json_value_get_object(query_value), TWIN_QUERY_JSON_KEY_QUERY, query) != JSONSuccess)
+        {
+            LogError("json_object_set_string failed");
+            result = IOTHUB_DEVICE_TWIN_ERROR;
+        }
+        else if ((queryJson = json_serialize_to_string(query_value)) == NULL)
+        {
+            LogError("json_serialize_to_string failed");
+            result = IOTHUB_DEVICE_TWIN_ERROR;
+        }
+        else if ((queryBuffer = BUFFER_create((const unsigned char*)queryJson, strlen(queryJson))) == NULL)
+        {
+            LogError("BUFFER_create failed for the query");
+            result = IOTHUB_DEVICE_TWIN_ERROR;
+        }
+        else if ((responseBuffer = BUFFER_new()) == NULL)
+        {
+            LogError("BUFFER_new failed for responseBuffer");
+            result = IOTHUB_DEVICE_TWIN_ERROR;
+        }
+        /*Codes_SRS_IOTHUBDEVICETWIN_41_007: [ IoTHubDeviceTwin_QueryTwins shall execute the pages on the HTTP connection pool of the handle, or on one created by calling IoTHubSCHttpPool_Create for the duration of the query if the handle has none ]*/
+        else if ((httpPool = acquireHttpPool(serviceClientDeviceTwinHandle)) == NULL)
+        {
+            LogError("Failure acquiring the HTTP connection pool");
+            result = IOTHUB_DEVICE_TWIN_HTTPAPI_ERROR;
+        }
+        else
+        {
+            bool isStopped = false;
+
+            do
+            {
+                if ((result = fetchTwinQueryPage(httpPool, queryBuffer, pageSize, &continuationToken, responseBuffer)) == IOTHUB_DEVICE_TWIN_OK)
+                {
+                    result = deliverTwinQueryPage(responseBuffer, &twinJson, &twinJsonSize, twinCallback, context, &isStopped);
+                }
+            } while ((result == IOTHUB_DEVICE_TWIN_OK) && !isStopped && (continuationToken != NULL));
+        }
+
+        if (httpPool != NULL)
+        {
+            IoTHubSCHttpPool_Destroy(httpPool);
+        }
+        free(twinJson);
+        free(continuationToken);
+        BUFFER_delete(responseBuffer);
+        BUFFER_delete(queryBuffer);
+        if (queryJson != NULL)
+        {
+            json_free_serialized_string(queryJson);
+        }
+        if (query_value != NULL)
+        {
+            json_value_free(query_value);
+        }
+    }
+    return result;
+}
+
+typedef struct TWIN_UPDATE_BATCH_TAG
+{
+    IOTHUB_SC_HTTP_POOL_HANDLE httpPool;
+    IOTHUB_DEVICE_TWIN_UPDATE* updates;
+    size_t updateCount;
+    LOCK_HANDLE lock;
+    size_t nextUpdate;
+} TWIN_UPDATE_BATCH;
+
+static void executeTwinUpdate(IOTHUB_SC_HTTP_POOL_HANDLE httpPool, IOTHUB_DEVICE_TWIN_UPDATE* update)
+{
+    HTTP_HEADERS_HANDLE httpHeader = NULL;
+    STRING_HANDLE eTag = NULL;
+    STRING_HANDLE relativePath = NULL;
+    BUFFER_HANDLE patchBuffer = NULL;
+
+    if ((update->deviceId == NULL) || (update->twinPatchJson == NULL))
+    {
+        /*Codes_SRS_IOTHUBDEVICETWIN_41_017: [ An update without deviceId or twinPatchJson shall not be sent and its result shall be IOTHUB_DEVICE_TWIN_INVALID_ARG ]*/
+        LogError("deviceId and twinPatchJson of a twin update cannot be NULL");
+        update->result = IOTHUB_DEVICE_TWIN_INVALID_ARG;
+    }
+    else if ((httpHeader = createHttpHeader(IOTHUB_TWIN_REQUEST_UPDATE)) == NULL)
+    {
+        LogError("HttpHeader creation failed");
+        update->result = IOTHUB_DEVICE_TWIN_ERROR;
+    }
+    /*Codes_SRS_IOTHUBDEVICETWIN_41_018: [ If the update has an eTag, the If-Match header shall be set to the quoted eTag instead of * by calling HTTPHeaders_ReplaceHeaderNameValuePair ]*/
+    else if ((update->eTag != NULL) &&
+        (((eTag = STRING_construct_sprintf(HTTP_HEADER_FMT_IFMATCH_ETAG, update->eTag)) == NULL) ||
+        (HTTPHeaders_ReplaceHeaderNameValuePair(httpHeader, HTTP_HEADER_KEY_IFMATCH, STRING_c_str(eTag)) != HTTP_HEADERS_OK)))
+    {
+        LogError("Failure setting the If-Match header");
+        update->result = IOTHUB_DEVICE_TWIN_ERROR;
+    }
+    else if ((relativePath = createRelativePath(IOTHUB_TWIN_REQUEST_UPDATE, update->deviceId, update->moduleId)) == NULL)
+    {
+        LogError("Failure creating relative path");
+        update->result = IOTHUB_DEVICE_TWIN_ERROR;
+    }
+    else if ((patchBuffer = BUFFER_create((const unsigned char*)update->twinPatchJson, strlen(update->twinPatchJson))) == NULL)
+    {
+        LogError("BUFFER_create failed for twinPatchJson");
+        update->result = IOTHUB_DEVICE_TWIN_ERROR;
+    }
+    /*Codes_SRS_IOTHUBDEVICETWIN_41_019: [ Every update shall be executed as the HTTP PATCH of IoTHubDeviceTwin_UpdateTwin by calling IoTHubSCHttpPool_ExecuteRequest without a response buffer, so the updated twin is not received into memory ]*/
+    else if (IoTHubSCHttpPool_ExecuteRequest(httpPool, HTTPAPI_REQUEST_PATCH, STRING_c_str(relativePath), httpHeader, patchBuffer, &update->statusCode, NULL, NULL) != HTTPAPIEX_OK)
+    {
+        LogError("IoTHubSCHttpPool_ExecuteRequest failed");
+        update->result = IOTHUB_DEVICE_TWIN_HTTPAPI_ERROR;
+    }
+    else if (update->statusCode != 200)
+    {
+        /*Codes_SRS_IOTHUBDEVICETWIN_41_020: [ The result of an update shall be IOTHUB_DEVICE_TWIN_OK if the received HTTP status code is 200, IOTHUB_DEVICE_TWIN_ERROR otherwise (412 if the eTag didn't match), and the status code shall be stored in its statusCode ]*/
+        LogError("Http Failure status code %d for the twin of %s.", update->statusCode, update->deviceId);
+        update->result = IOTHUB_DEVICE_TWIN_ERROR;
+    }
+    else
+    {
+        update->result = IOTHUB_DEVICE_TWIN_OK;
+    }
+
+    BUFFER_delete(patchBuffer);
+    STRING_delete(relativePath);
+    STRING_delete(eTag);
+    HTTPHeaders_Free(httpHeader);
+}
+
+static int twinUpdateWorker(void* arg)
+{
+    TWIN_UPDATE_BATCH* batch = (TWIN_UPDATE_BATCH*)arg;
+
+    /*Codes_SRS_IOTHUBDEVICETWIN_41_016: [ Every worker, the calling thread included, shall take the next update not taken yet under the lock until all of them are taken ]*/
+    while (1)
+    {
+        size_t index;
+
+        if (Lock(batch->lock) != LOCK_OK)
+        {
+            LogError("Lock failed");
+            break;
+        }
+        index = batch->nextUpdate;
+        if (index < batch->updateCount)
+        {
+            batch->nextUpdate++;
+        }
+        (void)Unlock(batch->lock);
+
+        if (index >= batch->updateCount)
+        {
+            break;
+        }
+        executeTwinUpdate(batch->httpPool, &batch->updates[index]);
+    }
+    return 0;
+}
+
+IOTHUB_DEVICE_TWIN_RESULT IoTHubDeviceTwin_UpdateTwins(IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE serviceClientDeviceTwinHandle, IOTHUB_DEVICE_TWIN_UPDATE* updates, size_t updateCount, size_t maxConcurrentUpdates)
+{
+    IOTHUB_DEVICE_TWIN_RESULT result;
+
+    /*Codes_SRS_IOTHUBDEVICETWIN_41_014: [ If serviceClientDeviceTwinHandle or updates is NULL, or maxConcurrentUpdates is 0, IoTHubDeviceTwin_UpdateTwins shall return IOTHUB_DEVICE_TWIN_INVALID_ARG ]*/
+    if ((serviceClientDeviceTwinHandle == NULL) || (updates == NULL) || (maxConcurrentUpdates == 0))
+    {
+        LogError("Invalid argument: serviceClientDeviceTwinHandle=%p, updates=%p, maxConcurrentUpdates=%lu", serviceClientDeviceTwinHandle, updates, (unsigned long)maxConcurrentUpdates);
+        result = IOTHUB_DEVICE_TWIN_INVALID_ARG;
+    }
+    else if (updateCount == 0)
+    {
+        result = IOTHUB_DEVICE_TWIN_OK;
+    }
+    else
+    {
+        TWIN_UPDATE_BATCH batch;
+        size_t i;
+
+        for (i = 0; i < updateCount; i++)
+        {
+            updates[i].result = IOTHUB_DEVICE_TWIN_ERROR;
+            updates[i].statusCode = 0;
+        }
+
+        memset(&batch, 0, sizeof(batch));
+        batch.updates = updates;
+        batch.updateCount = updateCount;
+
+        /*Codes_SRS_IOTHUBDEVICETWIN_41_015: [ IoTHubDeviceTwin_UpdateTwins shall execute the updates on the HTTP connection pool of the handle, or on one created by calling IoTHubSCHttpPool_Create for the duration of the batch if the handle has none ]*/
+        if ((batch.httpPool = acquireHttpPool(serviceClientDeviceTwinHandle)) == NULL)
+        {
+            LogError("Failure acquiring the HTTP connection pool");
+            result = IOTHUB_DEVICE_TWIN_HTTPAPI_ERROR;
+        }
+        else if ((batch.lock = Lock_Init()) == NULL)
+        {
+            LogError("Lock_Init failed");
+            result = IOTHUB_DEVICE_TWIN_ERROR;
+        }
+        else
+        {
+            size_t extraWorkerCount = ((maxConcurrentUpdates < updateCount) ? maxConcurrentUpdates : updateCount) - 1;
+            THREAD_HANDLE* workers = NULL;
+            size_t workerCount = 0;
+
+            /*Codes_SRS_IOTHUBDEVICETWIN_41_021: [ IoTHubDeviceTwin_UpdateTwins shall start one worker less than the smaller of maxConcurrentUpdates and updateCount by calling ThreadAPI_Create, and run one more on the calling thread ]*/
+            if ((extraWorkerCount > 0) && ((workers = (THREAD_HANDLE*)malloc(extraWorkerCount * sizeof(THREAD_HANDLE))) == NULL))
+            {
+                /*Codes_SRS_IOTHUBDEVICETWIN_41_022: [ If a worker cannot be started, the updates shall be executed by the workers that are running ]*/
+                LogError("malloc failed for the twin update workers, the updates are executed on the calling thread");
+            }
+            else
+            {
+                for (workerCount = 0; workerCount < extraWorkerCount; workerCount++)
+                {
+                    if (ThreadAPI_Create(&workers[workerCount], twinUpdateWorker, &batch) != THREADAPI_OK)
+                    {
+                        LogError("ThreadAPI_Create failed, the twin updates are executed by %lu workers", (unsigned long)(workerCount + 1));
+                        break;
+                    }
+                }
+            }
+
+            (void)twinUpdateWorker(&batch);
+
+            /*Codes_SRS_IOTHUBDEVICETWIN_41_023: [ IoTHubDeviceTwin_UpdateTwins shall wait for the workers by calling ThreadAPI_Join, and return IOTHUB_DEVICE_TWIN_OK if every update succeeded, IOTHUB_DEVICE_TWIN_ERROR otherwise ]*/
+            for (i = 0; i < workerCount; i++)
+            {
+                int threadResult;
+                if (ThreadAPI_Join(workers[i], &threadResult) != THREADAPI_OK)
+                {
+                    LogError("ThreadAPI_Join failed");
+                }
+            }
+            free(workers);
+
+            result = IOTHUB_DEVICE_TWIN_OK;
+            for (i = 0; i < updateCount; i++)
+            {
+                if (updates[i].result != IOTHUB_DEVICE_TWIN_OK)
+                {
+                    result = IOTHUB_DEVICE_TWIN_ERROR;
+                    break;
+                }
+            }
+        }
+
+        if (batch.lock != NULL)
+        {
+            (void)Lock_Deinit(batch.lock);
+        }
+        if (batch.httpPool != NULL)
+        {
+            IoTHubSCHttpPool_Destroy(batch.httpPool);
+        }
+    }
+    return result;
+}
@@ -3,6 +3,7 @@
 
 #include <stdlib.h>
 #include <ctype.h>
+#include <stdint.h>
 #include "azure_c_shared_utility/optimize_size.h"
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/crt_abstractions.h"
@@ -35,11 +36,50 @@ typedef struct CALLBACK_DATA_TAG
     IOTHUB_OPEN_COMPLETE_CALLBACK openCompleteCompleteCallback;
     IOTHUB_SEND_COMPLETE_CALLBACK sendCompleteCallback;
     IOTHUB_FEEDBACK_MESSAGE_RECEIVED_CALLBACK feedbackMessageCallback;
+    IOTHUB_FEEDBACK_RECORD_RECEIVED_CALLBACK feedbackRecordCallback;
     void* openUserContext;
     void* sendUserContext;
     void* feedbackUserContext;
+    void* feedbackRecordUserContext;
 } CALLBACK_DATA;
 
+/*at most this many deliveries of a batch are queued on the message sender at a time, the sender transfers them as the link credit allows*/
+#define IOTHUB_MESSAGING_BATCH_MAX_IN_FLIGHT 256
+
+typedef struct IOTHUB_MESSAGING_BATCH_DELIVERY_TAG
+{
+    struct IOTHUB_MESSAGING_BATCH_TAG* batch;
+    const char* deviceId;
+    int isComplete;
+} IOTHUB_MESSAGING_BATCH_DELIVERY;
+
+typedef struct IOTHUB_MESSAGING_BATCH_TAG
+{
+    struct IOTHUB_MESSAGING_TAG* messaging;
+    MESSAGE_HANDLE amqpMessage;
+    PROPERTIES_HANDLE properties;
+    char* deviceIds;
+    char* destination;
+    size_t destinationSize;
+    IOTHUB_MESSAGING_BATCH_DELIVERY* deliveries;
+    size_t deliveryCount;
+    size_t nextDelivery;
+    size_t inFlightCount;
+    size_t completeCount;
+    int isSending;
+    IOTHUB_SEND_BATCH_COMPLETE_CALLBACK sendBatchCompleteCallback;
+    void* userContext;
+} IOTHUB_MESSAGING_BATCH;
+
+/*a sender link beyond the primary one, on its own session so that it gets its own window next to its own link credit*/
+typedef struct IOTHUB_MESSAGING_POOLED_SENDER_TAG
+{
+    SESSION_HANDLE session;
+    LINK_HANDLE sender_link;
+    MESSAGE_SENDER_HANDLE message_sender;
+    MESSAGE_SENDER_STATE message_sender_state;
+} IOTHUB_MESSAGING_POOLED_SENDER;
+
 typedef struct IOTHUB_MESSAGING_TAG
 {
     int isOpened;
@@ -65,6 +105,14 @@ typedef struct IOTHUB_MESSAGING_TAG
     MESSAGE_RECEIVER_STATE message_receiver_state;
 
     CALLBACK_DATA* callback_data;
+    IOTHUB_MESSAGING_BATCH* batch;
+
+    IOTHUB_MESSAGING_POOLED_SENDER* pooled_senders;
+    size_t pooled_sender_count;
+    size_t next_sender;
+
+    char* feedback_buffer;
+    size_t feedback_buffer_size;
 
 } IOTHUB_MESSAGING;
 
@@ -586,89 +634,980 @@ static char* createDeviceDestinationString(const char* deviceId, const char* mod
                 result = buffer;
             }
         }
-    }
-    return result;
-}
-
-static void IoTHubMessaging_LL_SenderStateChanged(void* context, MESSAGE_SENDER_STATE new_state, MESSAGE_SENDER_STATE previous_state)
-{
-    (void)previous_state;
-    if (context != NULL)
-    {
-        /*Codes_SRS_IOTHUBMESSAGING_12_049: [ IoTHubMessaging_LL_SenderStateChanged shall save the new_state to local variable ] */
-        IOTHUB_MESSAGING* messagingData = (IOTHUB_MESSAGING*)context;
-        messagingData->message_sender_state = new_state;
+    }
+    return result;
+}
+
+static void IoTHubMessaging_LL_SenderStateChanged(void* context, MESSAGE_SENDER_STATE new_state, MESSAGE_SENDER_STATE previous_state)
+{
+    (void)previous_state;
+    if (context != NULL)
+    {
+        /*Codes_SRS_IOTHUBMESSAGING_12_049: [ IoTHubMessaging_LL_SenderStateChanged shall save the new_state to local variable ] */
+        IOTHUB_MESSAGING* messagingData = (IOTHUB_MESSAGING*)context;
+        messagingData->message_sender_state = new_state;
+
+        if ((messagingData->message_sender_state == MESSAGE_SENDER_STATE_OPEN) && (messagingData->message_receiver_state == MESSAGE_RECEIVER_STATE_OPEN))
+        {
+            /*Codes_SRS_IOTHUBMESSAGING_12_050: [ If both sender and receiver state is open IoTHubMessaging_LL_SenderStateChanged shall set the isOpened local variable to true ] */
+            messagingData->isOpened = true;
+            if (messagingData->callback_data->openCompleteCompleteCallback != NULL)
+            {
+                (messagingData->callback_data->openCompleteCompleteCallback)(messagingData->callback_data->openUserContext);
+            }
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBMESSAGING_12_051: [ If neither sender_state nor receiver_state is open IoTHubMessaging_LL_SenderStateChanged shall set the local isOpened variable to false ] */
+            messagingData->isOpened = false;
+        }
+    }
+}
+
+static void IoTHubMessaging_LL_ReceiverStateChanged(const void* context, MESSAGE_RECEIVER_STATE new_state, MESSAGE_RECEIVER_STATE previous_state)
+{
+    (void)previous_state;
+    if (context != NULL)
+    {
+        /*Codes_SRS_IOTHUBMESSAGING_12_052: [ IoTHubMessaging_LL_ReceiverStateChanged shall save the new_state to local variable ] */
+        IOTHUB_MESSAGING* messagingData = (IOTHUB_MESSAGING*)context;
+        messagingData->message_receiver_state = new_state;
+
+        if ((messagingData->message_sender_state == MESSAGE_SENDER_STATE_OPEN) && (messagingData->message_receiver_state == MESSAGE_RECEIVER_STATE_OPEN))
+        {
+            /*Codes_SRS_IOTHUBMESSAGING_12_053: [ If both sender and receiver state is open IoTHubMessaging_LL_ReceiverStateChanged shall set the isOpened local variable to true ] */
+            messagingData->isOpened = true;
+            if (messagingData->callback_data->openCompleteCompleteCallback != NULL)
+            {
+                (messagingData->callback_data->openCompleteCompleteCallback)(messagingData->callback_data->openUserContext);
+            }
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBMESSAGING_12_054: [ If neither sender_state nor receiver_state is open IoTHubMessaging_LL_ReceiverStateChanged shall set the local isOpened variable to false ] */
+            messagingData->isOpened = false;
+        }
+    }
+}
+
+static void IoTHubMessaging_LL_PooledSenderStateChanged(void* context, MESSAGE_SENDER_STATE new_state, MESSAGE_SENDER_STATE previous_state)
+{
+    (void)previous_state;
+    if (context != NULL)
+    {
+        /*Codes_SRS_IOTHUBMESSAGING_41_019: [ The state of a pooled sender shall only decide whether sends are dispatched to it, it shall not change the opened state of the messaging. ]*/
+        IOTHUB_MESSAGING_POOLED_SENDER* pooledSender = (IOTHUB_MESSAGING_POOLED_SENDER*)context;
+        pooledSender->message_sender_state = new_state;
+    }
+}
+
+/*returns the next message sender in round-robin order, pooled senders that are not open are skipped*/
+static MESSAGE_SENDER_HANDLE selectMessageSender(IOTHUB_MESSAGING* messagingData)
+{
+    MESSAGE_SENDER_HANDLE result = NULL;
+    size_t senderCount = (messagingData->pooled_senders == NULL) ? 1 : (messagingData->pooled_sender_count + 1);
+    size_t i;
+
+    for (i = 0; (i < senderCount) && (result == NULL); i++)
+    {
+        size_t index = (messagingData->next_sender + i) % senderCount;
+
+        if (index == 0)
+        {
+            result = messagingData->message_sender;
+        }
+        else if (messagingData->pooled_senders[index - 1].message_sender_state == MESSAGE_SENDER_STATE_OPEN)
+        {
+            result = messagingData->pooled_senders[index - 1].message_sender;
+        }
+
+        if (result != NULL)
+        {
+            messagingData->next_sender = (index + 1) % senderCount;
+        }
+    }
+
+    return result;
+}
+
+static void IoTHubMessaging_LL_SendMessageComplete(void* context, MESSAGE_SEND_RESULT send_result, AMQP_VALUE delivery_state)
+{
+    (void)delivery_state;
+    /*Codes_SRS_IOTHUBMESSAGING_12_056: [ If context is NULL IoTHubMessaging_LL_SendMessageComplete shall return ] */
+    if (context != NULL)
+    {
+        /*Codes_SRS_IOTHUBMESSAGING_12_055: [ If context is not NULL and IoTHubMessaging_LL_SendMessageComplete shall call user callback with user context and messaging result ] */
+        IOTHUB_MESSAGING* messagingData = (IOTHUB_MESSAGING*)context;
+        if (messagingData->callback_data->sendCompleteCallback != NULL)
+        {
+            // Convert a send result to an
+            IOTHUB_MESSAGING_RESULT msg_result;
+            switch (send_result)
+            {
+                case MESSAGE_SEND_OK:
+                    msg_result = IOTHUB_MESSAGING_OK;
+                    break;
+                case MESSAGE_SEND_ERROR:
+                case MESSAGE_SEND_TIMEOUT:
+                case MESSAGE_SEND_CANCELLED:
+                default:
+                    msg_result = IOTHUB_MESSAGING_ERROR;
+                    break;
+            }
+            (messagingData->callback_data->sendCompleteCallback)(messagingData->callback_data->sendUserContext, msg_result);
+        }
+    }
+}
+
+static void destroyBatch(IOTHUB_MESSAGING_BATCH* batch)
+{
+    if (batch->amqpMessage != NULL)
+    {
+        message_destroy(batch->amqpMessage);
+    }
+    if (batch->properties != NULL)
+    {
+        properties_destroy(batch->properties);
+    }
+    free(batch->deviceIds);
+    free(batch->destination);
+    free(batch->deliveries);
+    free(batch);
+}
+
+static void completeBatchDelivery(IOTHUB_MESSAGING_BATCH_DELIVERY* delivery, IOTHUB_MESSAGING_RESULT messagingResult)
+{
+    IOTHUB_MESSAGING_BATCH* batch = delivery->batch;
+
+    if (!delivery->isComplete)
+    {
+        delivery->isComplete = 1;
+        batch->completeCount++;
+        /*Codes_SRS_IOTHUBMESSAGING_41_009: [ When a delivery of the batch completes, sendBatchCompleteCallback shall be called with userContextCallback, the device id of the delivery and the messaging result. ]*/
+        if (batch->sendBatchCompleteCallback != NULL)
+        {
+            batch->sendBatchCompleteCallback(batch->userContext, delivery->deviceId, messagingResult);
+        }
+    }
+}
+
+static void releaseBatchIfComplete(IOTHUB_MESSAGING* messagingData)
+{
+    IOTHUB_MESSAGING_BATCH* batch = messagingData->batch;
+
+    /*Codes_SRS_IOTHUBMESSAGING_41_010: [ Once every delivery of the batch completed, the batch shall be released and a new batch can be sent. ]*/
+    if ((batch != NULL) && (!batch->isSending) && (batch->completeCount == batch->deliveryCount))
+    {
+        messagingData->batch = NULL;
+        destroyBatch(batch);
+    }
+}
+
+static void abandonBatch(IOTHUB_MESSAGING* messagingData)
+{
+    IOTHUB_MESSAGING_BATCH* batch = messagingData->batch;
+
+    if (batch != NULL)
+    {
+        size_t i;
+
+        /*Codes_SRS_IOTHUBMESSAGING_41_012: [ IoTHubMessaging_LL_Close and IoTHubMessaging_LL_Destroy shall complete every pending delivery of the batch with IOTHUB_MESSAGING_ERROR and release the batch. ]*/
+        batch->isSending = 1;
+        for (i = 0; i < batch->deliveryCount; i++)
+        {
+            completeBatchDelivery(&batch->deliveries[i], IOTHUB_MESSAGING_ERROR);
+        }
+        messagingData->batch = NULL;
+        destroyBatch(batch);
+    }
+}
+
+static void IoTHubMessaging_LL_SendBatchMessageComplete(void* context, MESSAGE_SEND_RESULT send_result, AMQP_VALUE delivery_state)
+{
+    (void)delivery_state;
+    if (context != NULL)
+    {
+        IOTHUB_MESSAGING_BATCH_DELIVERY* delivery = (IOTHUB_MESSAGING_BATCH_DELIVERY*)context;
+        IOTHUB_MESSAGING_BATCH* batch = delivery->batch;
+
+        if (!delivery->isComplete)
+        {
+            batch->inFlightCount--;
+            completeBatchDelivery(delivery, (send_result == MESSAGE_SEND_OK) ? IOTHUB_MESSAGING_OK : IOTHUB_MESSAGING_ERROR);
+            releaseBatchIfComplete(batch->messaging);
+        }
+    }
+}
+
+static void sendBatchDeliveries(IOTHUB_MESSAGING* messagingData)
+{
+    IOTHUB_MESSAGING_BATCH* batch = messagingData->batch;
+
+    if ((batch != NULL) && messagingData->isOpened)
+    {
+        batch->isSending = 1;
+
+        /*Codes_SRS_IOTHUBMESSAGING_41_006: [ No more than IOTHUB_MESSAGING_BATCH_MAX_IN_FLIGHT deliveries of the batch shall be queued on the message sender at a time. ]*/
+        /*Codes_SRS_IOTHUBMESSAGING_41_021: [ With pooled senders the deliveries of a batch shall be dispatched round-robin and up to IOTHUB_MESSAGING_BATCH_MAX_IN_FLIGHT deliveries shall be queued per sender link. ]*/
+        size_t maxInFlight = IOTHUB_MESSAGING_BATCH_MAX_IN_FLIGHT * ((messagingData->pooled_senders == NULL) ? 1 : (messagingData->pooled_sender_count + 1));
+
+        while ((batch->nextDelivery < batch->deliveryCount) && (batch->inFlightCount < maxInFlight))
+        {
+            IOTHUB_MESSAGING_BATCH_DELIVERY* delivery = &batch->deliveries[batch->nextDelivery];
+            AMQP_VALUE to_amqp_value;
+
+            batch->nextDelivery++;
+
+            /*Codes_SRS_IOTHUBMESSAGING_41_007: [ For each delivery only the TO property shall be rewritten by calling properties_set_to and message_set_properties, and the shared uAMQP message shall be sent by calling messagesender_send_async. ]*/
+            if (snprintf(batch->destination, batch->destinationSize, AMQP_ADDRESS_PATH_FMT, delivery->deviceId) < 0)
+            {
+                LogError("snprintf failed for the destination of device %s.", delivery->deviceId);
+                completeBatchDelivery(delivery, IOTHUB_MESSAGING_ERROR);
+            }
+            else if ((to_amqp_value = amqpvalue_create_string(batch->destination)) == NULL)
+            {
+                /*Codes_SRS_IOTHUBMESSAGING_41_008: [ If any of the uAMQP calls of a delivery fails, that delivery shall complete with IOTHUB_MESSAGING_ERROR and the batch shall continue with the next device. ]*/
+                LogError("Could not create the destination of device %s.", delivery->deviceId);
+                completeBatchDelivery(delivery, IOTHUB_MESSAGING_ERROR);
+            }
+            else
+            {
+                if (properties_set_to(batch->properties, to_amqp_value) != 0)
+                {
+                    /*Codes_SRS_IOTHUBMESSAGING_41_008: [ If any of the uAMQP calls of a delivery fails, that delivery shall complete with IOTHUB_MESSAGING_ERROR and the batch shall continue with the next device. ]*/
+                    LogError("properties_set_to failed for device %s.", delivery->deviceId);
+                    completeBatchDelivery(delivery, IOTHUB_MESSAGING_ERROR);
+                }
+                else if (message_set_properties(batch->amqpMessage, batch->properties) != 0)
+                {
+                    /*Codes_SRS_IOTHUBMESSAGING_41_008: [ If any of the uAMQP calls of a delivery fails, that delivery shall complete with IOTHUB_MESSAGING_ERROR and the batch shall continue with the next device. ]*/
+                    LogError("message_set_properties failed for device %s.", delivery->deviceId);
+                    completeBatchDelivery(delivery, IOTHUB_MESSAGING_ERROR);
+                }
+                else
+                {
+                    batch->inFlightCount++;
+                    if ((messagesender_send_async(selectMessageSender(messagingData), batch->amqpMessage, IoTHubMessaging_LL_SendBatchMessageComplete, delivery, 0) == NULL) &&
+                        (!delivery->isComplete))
+                    {
+                        /*Codes_SRS_IOTHUBMESSAGING_41_008: [ If any of the uAMQP calls of a delivery fails, that delivery shall complete with IOTHUB_MESSAGING_ERROR and the batch shall continue with the next device. ]*/
+                        LogError("messagesender_send_async failed for device %s.", delivery->deviceId);
+                        batch->inFlightCount--;
+                        completeBatchDelivery(delivery, IOTHUB_MESSAGING_ERROR);
+                    }
+                }
+                amqpvalue_destroy(to_amqp_value);
+            }
+        }
+
+        batch->isSending = 0;
+        releaseBatchIfComplete(messagingData);
+    }
+}
+
+static IOTHUB_MESSAGING_BATCH* createBatch(IOTHUB_MESSAGING* messagingData, const char* const* deviceIds, size_t deviceIdCount, IOTHUB_MESSAGE_HANDLE message)
+{
+    IOTHUB_MESSAGING_BATCH* result;
+    size_t deviceIdsSize = 0;
+    size_t longestDeviceId = 0;
+    size_t i;
+
+    for (i = 0; i < deviceIdCount; i++)
+    {
+        size_t length = strlen(deviceIds[i]);
+        deviceIdsSize += length + 1;
+        if (length > longestDeviceId)
+        {
+            longestDeviceId = length;
+        }
+    }
+
+    if (deviceIdCount > (SIZE_MAX / sizeof(IOTHUB_MESSAGING_BATCH_DELIVERY)))
+    {
+        LogError("Too many devices in the batch (%lu).", (unsigned long)deviceIdCount);
+        result = NULL;
+    }
+    else if ((result = (IOTHUB_MESSAGING_BATCH*)malloc(sizeof(IOTHUB_MESSAGING_BATCH))) == NULL)
+    {
+        LogError("Could not allocate the batch.");
+    }
+    else
+    {
+        unsigned const char* messageContent;
+        size_t messageContentSize;
+
+        memset(result, 0, sizeof(IOTHUB_MESSAGING_BATCH));
+        result->messaging = messagingData;
+        result->deliveryCount = deviceIdCount;
+        result->destinationSize = strlen(AMQP_ADDRESS_PATH_FMT) + longestDeviceId + 1;
+
+        /*Codes_SRS_IOTHUBMESSAGING_41_003: [ IoTHubMessaging_LL_SendBatch shall copy the device ids in a single allocation, so that deviceIds can be released on return. ]*/
+        if (((result->deviceIds = (char*)malloc(deviceIdsSize)) == NULL) ||
+            ((result->deliveries = (IOTHUB_MESSAGING_BATCH_DELIVERY*)malloc(deviceIdCount * sizeof(IOTHUB_MESSAGING_BATCH_DELIVERY))) == NULL) ||
+            ((result->destination = (char*)malloc(result->destinationSize)) == NULL))
+        {
+            /*Codes_SRS_IOTHUBMESSAGING_41_005: [ If any of the allocations or uAMQP calls preparing the batch fails, IoTHubMessaging_LL_SendBatch shall release what it created, send nothing and return IOTHUB_MESSAGING_ERROR. ]*/
+            LogError("Could not allocate the batch deliveries.");
+            destroyBatch(result);
+            result = NULL;
+        }
+        /*Codes_SRS_IOTHUBMESSAGING_41_004: [ IoTHubMessaging_LL_SendBatch shall encode the message body, application properties, message-id and correlation-id once in a single uAMQP message. ]*/
+        else if (getMessageContentAndSize(message, &messageContent, &messageContentSize) != 0)
+        {
+            /*Codes_SRS_IOTHUBMESSAGING_41_005: [ If any of the allocations or uAMQP calls preparing the batch fails, IoTHubMessaging_LL_SendBatch shall release what it created, send nothing and return IOTHUB_MESSAGING_ERROR. ]*/
+            LogError("Failed getting the message content and message size from IOTHUB_MESSAGE_HANDLE instance.");
+            destroyBatch(result);
+            result = NULL;
+        }
+        else if ((result->amqpMessage = message_create()) == NULL)
+        {
+            /*Codes_SRS_IOTHUBMESSAGING_41_005: [ If any of the allocations or uAMQP calls preparing the batch fails, IoTHubMessaging_LL_SendBatch shall release what it created, send nothing and return IOTHUB_MESSAGING_ERROR. ]*/
+            LogError("Could not create a message.");
+            destroyBatch(result);
+            result = NULL;
+        }
+        else
+        {
+            BINARY_DATA binary_data;
+
+            binary_data.bytes = messageContent;
+            binary_data.length = messageContentSize;
+
+            if (message_add_body_amqp_data(result->amqpMessage, binary_data) != 0)
+            {
+                /*Codes_SRS_IOTHUBMESSAGING_41_005: [ If any of the allocations or uAMQP calls preparing the batch fails, IoTHubMessaging_LL_SendBatch shall release what it created, send nothing and return IOTHUB_MESSAGING_ERROR. ]*/
+                LogError("Failed setting the body of the uAMQP message.");
+                destroyBatch(result);
+                result = NULL;
+            }
+            else if (addApplicationPropertiesToAMQPMessage(message, result->amqpMessage) != 0)
+            {
+                /*Codes_SRS_IOTHUBMESSAGING_41_005: [ If any of the allocations or uAMQP calls preparing the batch fails, IoTHubMessaging_LL_SendBatch shall release what it created, send nothing and return IOTHUB_MESSAGING_ERROR. ]*/
+                LogError("Failed setting application properties of the uAMQP message.");
+                destroyBatch(result);
+                result = NULL;
+            }
+            else if ((result->properties = properties_create()) == NULL)
+            {
+                /*Codes_SRS_IOTHUBMESSAGING_41_005: [ If any of the allocations or uAMQP calls preparing the batch fails, IoTHubMessaging_LL_SendBatch shall release what it created, send nothing and return IOTHUB_MESSAGING_ERROR. ]*/
+                LogError("Failed to create the properties of the uAMQP message.");
+                destroyBatch(result);
+                result = NULL;
+            }
+            else if ((setMessageId(message, result->properties) != 0) ||
+                (setCorrelationId(message, result->properties) != 0))
+            {
+                /*Codes_SRS_IOTHUBMESSAGING_41_005: [ If any of the allocations or uAMQP calls preparing the batch fails, IoTHubMessaging_LL_SendBatch shall release what it created, send nothing and return IOTHUB_MESSAGING_ERROR. ]*/
+                LogError("Failed to set the message-id or correlation-id of the uAMQP message.");
+                destroyBatch(result);
+                result = NULL;
+            }
+            else
+            {
+                char* deviceId = result->deviceIds;
+                for (i = 0; i < deviceIdCount; i++)
+                {
+                    size_t length = strlen(deviceIds[i]) + 1;
+                    (void)memcpy(deviceId, deviceIds[i], length);
+                    result->deliveries[i].batch = result;
+                    result->deliveries[i].deviceId = deviceId;
+                    result->deliveries[i].isComplete = 0;
+                    deviceId += length;
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+/*lower cases description in place and maps it to the feedback status code*/
+static IOTHUB_FEEDBACK_STATUS_CODE getFeedbackStatusCode(char* description)
+{
+    IOTHUB_FEEDBACK_STATUS_CODE result;
+
+    if (description == NULL)
+    {
+        result = IOTHUB_FEEDBACK_STATUS_CODE_UNKNOWN;
+    }
+    else
+    {
+        size_t j;
+        for (j = 0; description[j]; j++)
+        {
+            description[j] = (char)tolower(description[j]);
+        }
+
+        if (strcmp(description, "success") == 0)
+        {
+            result = IOTHUB_FEEDBACK_STATUS_CODE_SUCCESS;
+        }
+        else if (strcmp(description, "expired") == 0)
+        {
+            result = IOTHUB_FEEDBACK_STATUS_CODE_EXPIRED;
+        }
+        else if (strcmp(description, "deliverycountexceeded") == 0)
+        {
+            result = IOTHUB_FEEDBACK_STATUS_CODE_DELIVER_COUNT_EXCEEDED;
+        }
+        else if (strcmp(description, "rejected") == 0)
+        {
+            result = IOTHUB_FEEDBACK_STATUS_CODE_REJECTED;
+        }
+        else
+        {
+            result = IOTHUB_FEEDBACK_STATUS_CODE_UNKNOWN;
+        }
+    }
+
+    return result;
+}
+
+/*values nested deeper than this inside a feedback record are rejected*/
+#define FEEDBACK_PARSER_MAX_DEPTH 32
+
+/*the feedback record parser works in place on a private copy of the message body: strings are unescaped where they are and
+terminated by overwriting their closing quote, so the record fields point straight into the copy. A first pass with isDelivering
+set to 0 only validates, so that nothing is handed to the user for a message that is going to be rejected*/
+typedef struct FEEDBACK_PARSER_TAG
+{
+    char* position;
+    const char* end;
+    int isDelivering;
+} FEEDBACK_PARSER;
+
+static void skipFeedbackWhitespace(FEEDBACK_PARSER* parser)
+{
+    while ((parser->position < parser->end) &&
+        ((*parser->position == ' ') || (*parser->position == '\t') || (*parser->position == '\n') || (*parser->position == '\r')))
+    {
+        parser->position++;
+    }
+}
+
+static int readFeedbackHex4(const char* source, const char* end, unsigned long* value)
+{
+    int result;
+
+    if (end - source < 4)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        size_t i;
+
+        *value = 0;
+        result = 0;
+        for (i = 0; (i < 4) && (result == 0); i++)
+        {
+            char c = source[i];
+            if ((c >= '0') && (c <= '9'))
+            {
+                *value = (*value << 4) | (unsigned long)(c - '0');
+            }
+            else if ((c >= 'a') && (c <= 'f'))
+            {
+                *value = (*value << 4) | (unsigned long)(c - 'a' + 10);
+            }
+            else if ((c >= 'A') && (c <= 'F'))
+            {
+                *value = (*value << 4) | (unsigned long)(c - 'A' + 10);
+            }
+            else
+            {
+                result = __FAILURE__;
+            }
+        }
+    }
+
+    return result;
+}
+
+static char* writeFeedbackUtf8(char* destination, unsigned long codePoint)
+{
+    if (codePoint < 0x80)
+    {
+        *destination++ = (char)codePoint;
+    }
+    else if (codePoint < 0x800)
+    {
+        *destination++ = (char)(0xC0 | (codePoint >> 6));
+        *destination++ = (char)(0x80 | (codePoint & 0x3F));
+    }
+    else if (codePoint < 0x10000)
+    {
+        *destination++ = (char)(0xE0 | (codePoint >> 12));
+        *destination++ = (char)(0x80 | ((codePoint >> 6) & 0x3F));
+        *destination++ = (char)(0x80 | (codePoint & 0x3F));
+    }
+    else
+    {
+        *destination++ = (char)(0xF0 | (codePoint >> 18));
+        *destination++ = (char)(0x80 | ((codePoint >> 12) & 0x3F));
+        *destination++ = (char)(0x80 | ((codePoint >> 6) & 0x3F));
+        *destination++ = (char)(0x80 | (codePoint & 0x3F));
+    }
+    return destination;
+}
+
+/*parser->position is on the opening quote. The unescaped value is never longer than its escaped form, so it fits where it is*/
+static int parseFeedbackString(FEEDBACK_PARSER* parser, char** value)
+{
+    int result = 0;
+    char* source = parser->position + 1;
+    char* destination = source;
+
+    *value = source;
+
+    while ((result == 0) && (source < parser->end) && (*source != '"'))
+    {
+        if ((unsigned char)*source < 0x20)
+        {
+            result = __FAILURE__;
+        }
+        else if (*source != '\\')
+        {
+            if (parser->isDelivering)
+            {
+                *destination++ = *source;
+            }
+            source++;
+        }
+        else if (parser->end - source < 2)
+        {
+            result = __FAILURE__;
+        }
+        else if (source[1] == 'u')
+        {
+            unsigned long codePoint;
+            unsigned long lowSurrogate;
+
+            if (readFeedbackHex4(source + 2, parser->end, &codePoint) != 0)
+            {
+                result = __FAILURE__;
+            }
+            else if ((codePoint >= 0xDC00) && (codePoint <= 0xDFFF))
+            {
+                result = __FAILURE__;
+            }
+            else if ((codePoint >= 0xD800) && (codePoint <= 0xDBFF))
+            {
+                if ((parser->end - source < 12) || (source[6] != '\\') || (source[7] != 'u') ||
+                    (readFeedbackHex4(source + 8, parser->end, &lowSurrogate) != 0) ||
+                    (lowSurrogate < 0xDC00) || (lowSurrogate > 0xDFFF))
+                {
+                    result = __FAILURE__;
+                }
+                else
+                {
+                    if (parser->isDelivering)
+                    {
+                        destination = writeFeedbackUtf8(destination, 0x10000 + ((codePoint - 0xD800) << 10) + (lowSurrogate - 0xDC00));
+                    }
+                    source += 12;
+                }
+            }
+            else
+            {
+                if (parser->isDelivering)
+                {
+                    destination = writeFeedbackUtf8(destination, codePoint);
+                }
+                source += 6;
+            }
+        }
+        else
+        {
+            char unescaped;
+
+            switch (source[1])
+            {
+            case '"': unescaped = '"'; break;
+            case '\\': unescaped = '\\'; break;
+            case '/': unescaped = '/'; break;
+            case 'b': unescaped = '\b'; break;
+            case 'f': unescaped = '\f'; break;
+            case 'n': unescaped = '\n'; break;
+            case 'r': unescaped = '\r'; break;
+            case 't': unescaped = '\t'; break;
+            default: unescaped = '\0'; result = __FAILURE__; break;
+            }
+
+            if ((result == 0) && parser->isDelivering)
+            {
+                *destination++ = unescaped;
+            }
+            source += 2;
+        }
+    }
+
+    if ((result == 0) && (source >= parser->end))
+    {
+        result = __FAILURE__;
+    }
+
+    if (result == 0)
+    {
+        if (parser->isDelivering)
+        {
+            *destination = '\0';
+        }
+        parser->position = source + 1;
+    }
+
+    return result;
+}
+
+static int skipFeedbackValue(FEEDBACK_PARSER* parser, size_t depth);
+
+/*parses the members of an object (closeChar '}') or the elements of an array (closeChar ']'), parser->position is on the opening character*/
+static int skipFeedbackContainer(FEEDBACK_PARSER* parser, char closeChar, size_t depth)
+{
+    int result = 0;
+
+    parser->position++;
+    skipFeedbackWhitespace(parser);
+
+    if ((parser->position < parser->end) && (*parser->position == closeChar))
+    {
+        parser->position++;
+    }
+    else
+    {
+        int isDone = 0;
+
+        while ((result == 0) && !isDone)
+        {
+            char* name;
+
+            skipFeedbackWhitespace(parser);
+            if (closeChar == '}')
+            {
+                if ((parser->position >= parser->end) || (*parser->position != '"') || (parseFeedbackString(parser, &name) != 0))
+                {
+                    result = __FAILURE__;
+                }
+                else
+                {
+                    skipFeedbackWhitespace(parser);
+                    if ((parser->position >= parser->end) || (*parser->position != ':'))
+                    {
+                        result = __FAILURE__;
+                    }
+                    else
+                    {
+                        parser->position++;
+                    }
+                }
+            }
+
+            if ((result == 0) && (skipFeedbackValue(parser, depth + 1) != 0))
+            {
+                result = __FAILURE__;
+            }
+
+            if (result == 0)
+            {
+                skipFeedbackWhitespace(parser);
+                if (parser->position >= parser->end)
+                {
+                    result = __FAILURE__;
+                }
+                else if (*parser->position == ',')
+                {
+                    parser->position++;
+                }
+                else if (*parser->position == closeChar)
+                {
+                    parser->position++;
+                    isDone = 1;
+                }
+                else
+                {
+                    result = __FAILURE__;
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+static int skipFeedbackValue(FEEDBACK_PARSER* parser, size_t depth)
+{
+    int result;
+    char* value;
+
+    skipFeedbackWhitespace(parser);
+
+    if ((depth > FEEDBACK_PARSER_MAX_DEPTH) || (parser->position >= parser->end))
+    {
+        result = __FAILURE__;
+    }
+    else if (*parser->position == '"')
+    {
+        result = parseFeedbackString(parser, &value);
+    }
+    else if (*parser->position == '{')
+    {
+        result = skipFeedbackContainer(parser, '}', depth);
+    }
+    else if (*parser->position == '[')
+    {
+        result = skipFeedbackContainer(parser, ']', depth);
+    }
+    else
+    {
+        /*numbers, true, false and null*/
+        char* start = parser->position;
+        while ((parser->position < parser->end) &&
+            (isalnum((unsigned char)*parser->position) || (*parser->position == '-') || (*parser->position == '+') || (*parser->position == '.')))
+        {
+            parser->position++;
+        }
+        result = (parser->position == start) ? __FAILURE__ : 0;
+    }
+
+    return result;
+}
+
+static const char** getFeedbackRecordField(IOTHUB_SERVICE_FEEDBACK_RECORD* record, const char* name)
+{
+    const char** result;
+
+    if (strcmp(name, FEEDBACK_RECORD_KEY_DEVICE_ID) == 0)
+    {
+        result = &record->deviceId;
+    }
+    else if (strcmp(name, FEEDBACK_RECORD_KEY_DEVICE_GENERATION_ID) == 0)
+    {
+        result = &record->generationId;
+    }
+    else if (strcmp(name, FEEDBACK_RECORD_KEY_DESCRIPTION) == 0)
+    {
+        result = (const char**)&record->description;
+    }
+    else if (strcmp(name, FEEDBACK_RECORD_KEY_ENQUED_TIME_UTC) == 0)
+    {
+        result = &record->enqueuedTimeUtc;
+    }
+    else if (strcmp(name, FEEDBACK_RECORD_KEY_ORIGINAL_MESSAGE_ID) == 0)
+    {
+        result = &record->originalMessageId;
+    }
+    else
+    {
+        result = NULL;
+    }
+
+    return result;
+}
+
+/*parser->position is on the opening brace of a record*/
+static int parseFeedbackRecord(IOTHUB_MESSAGING* messagingData, FEEDBACK_PARSER* parser, IOTHUB_SERVICE_FEEDBACK_RECORD* record)
+{
+    int result;
+
+    if (!parser->isDelivering)
+    {
+        result = skipFeedbackContainer(parser, '}', 1);
+    }
+    else
+    {
+        int isDone = 0;
+
+        record->deviceId = NULL;
+        record->generationId = NULL;
+        record->description = NULL;
+        record->enqueuedTimeUtc = NULL;
+        record->originalMessageId = NULL;
+        record->correlationId = "";
+
+        result = 0;
+        parser->position++;
+        skipFeedbackWhitespace(parser);
+        if (*parser->position == '}')
+        {
+            parser->position++;
+            isDone = 1;
+        }
+
+        /*the validation pass has already checked the syntax, so only the names are of interest here*/
+        while (!isDone)
+        {
+            char* name;
+            const char** field;
+
+            skipFeedbackWhitespace(parser);
+            (void)parseFeedbackString(parser, &name);
+            skipFeedbackWhitespace(parser);
+            parser->position++;
+            skipFeedbackWhitespace(parser);
+
+            /*Codes_SRS_IOTHUBMESSAGING_41_029: [ Members other than deviceId, deviceGenerationId, description, enqueuedTimeUtc and originalMessageId shall be skipped, and a field whose value is not a string shall be NULL. ]*/
+            if (((field = getFeedbackRecordField(record, name)) != NULL) && (*parser->position == '"'))
+            {
+                char* value;
+                (void)parseFeedbackString(parser, &value);
+                *field = value;
+            }
+            else
+            {
+                (void)skipFeedbackValue(parser, 2);
+            }
+
+            skipFeedbackWhitespace(parser);
+            isDone = (*parser->position == '}');
+            parser->position++;
+        }
+
+        /*Codes_SRS_IOTHUBMESSAGING_41_030: [ The statusCode of the record shall be derived from the description the same way as for IOTHUB_SERVICE_FEEDBACK_BATCH records. ]*/
+        record->statusCode = getFeedbackStatusCode(record->description);
+
+        /*Codes_SRS_IOTHUBMESSAGING_41_028: [ IoTHubMessaging_LL_FeedbackMessageReceived shall call the feedback record callback once per record with the same IOTHUB_SERVICE_FEEDBACK_RECORD, whose fields point into the copied body and are only valid during the call. ]*/
+        messagingData->callback_data->feedbackRecordCallback(messagingData->callback_data->feedbackRecordUserContext, record);
+    }
+
+    return result;
+}
+
+static int parseFeedbackRecords(IOTHUB_MESSAGING* messagingData, FEEDBACK_PARSER* parser, size_t* recordCount)
+{
+    int result = 0;
+    IOTHUB_SERVICE_FEEDBACK_RECORD record;
+
+    *recordCount = 0;
+
+    skipFeedbackWhitespace(parser);
+    if ((parser->position >= parser->end) || (*parser->position != '['))
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        int isDone = 0;
+
+        parser->position++;
+        skipFeedbackWhitespace(parser);
+        if ((parser->position < parser->end) && (*parser->position == ']'))
+        {
+            parser->position++;
+            isDone = 1;
+        }
+
+        while ((result == 0) && !isDone)
+        {
+            skipFeedbackWhitespace(parser);
+            if ((parser->position >= parser->end) || (*parser->position != '{') ||
+                (parseFeedbackRecord(messagingData, parser, &record) != 0))
+            {
+                result = __FAILURE__;
+            }
+            else
+            {
+                (*recordCount)++;
+                skipFeedbackWhitespace(parser);
+                if (parser->position >= parser->end)
+                {
+                    result = __FAILURE__;
+                }
+                else if (*parser->position == ',')
+                {
+                    parser->position++;
+                }
+                else if (*parser->position == ']')
+                {
+                    parser->position++;
+                    isDone = 1;
+                }
+                else
+                {
+                    result = __FAILURE__;
+                }
+            }
+        }
 
-        if ((messagingData->message_sender_state == MESSAGE_SENDER_STATE_OPEN) && (messagingData->message_receiver_state == MESSAGE_RECEIVER_STATE_OPEN))
+        if (result == 0)
         {
-            /*Codes_SRS_IOTHUBMESSAGING_12_050: [ If both sender and receiver state is open IoTHubMessaging_LL_SenderStateChanged shall set the isOpened local variable to true ] */
-            messagingData->isOpened = true;
-            if (messagingData->callback_data->openCompleteCompleteCallback != NULL)
+            skipFeedbackWhitespace(parser);
+            if (parser->position != parser->end)
             {
-                (messagingData->callback_data->openCompleteCompleteCallback)(messagingData->callback_data->openUserContext);
+                result = __FAILURE__;
             }
         }
-        else
-        {
-            /*Codes_SRS_IOTHUBMESSAGING_12_051: [ If neither sender_state nor receiver_state is open IoTHubMessaging_LL_SenderStateChanged shall set the local isOpened variable to false ] */
-            messagingData->isOpened = false;
-        }
     }
+
+    return result;
 }
 
-static void IoTHubMessaging_LL_ReceiverStateChanged(const void* context, MESSAGE_RECEIVER_STATE new_state, MESSAGE_RECEIVER_STATE previous_state)
+static AMQP_VALUE receiveFeedbackRecords(IOTHUB_MESSAGING* messagingData, MESSAGE_HANDLE message)
 {
-    (void)previous_state;
-    if (context != NULL)
-    {
-        /*Codes_SRS_IOTHUBMESSAGING_12_052: [ IoTHubMessaging_LL_ReceiverStateChanged shall save the new_state to local variable ] */
-        IOTHUB_MESSAGING* messagingData = (IOTHUB_MESSAGING*)context;
-        messagingData->message_receiver_state = new_state;
+    AMQP_VALUE result;
+    BINARY_DATA binary_data;
 
-        if ((messagingData->message_sender_state == MESSAGE_SENDER_STATE_OPEN) && (messagingData->message_receiver_state == MESSAGE_RECEIVER_STATE_OPEN))
+    if ((message_get_body_amqp_data_in_place(message, 0, &binary_data) != 0) || (binary_data.bytes == NULL))
+    {
+        /*Codes_SRS_IOTHUBMESSAGING_41_032: [ If the message body cannot be read or the buffer cannot be allocated, IoTHubMessaging_LL_FeedbackMessageReceived shall return messaging_delivery_rejected. ]*/
+        LogError("Cannot get message data");
+        result = messaging_delivery_rejected("Rejected due to failure reading AMQP message", "Failed reading message body");
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBMESSAGING_41_027: [ If a feedback record callback is set, IoTHubMessaging_LL_FeedbackMessageReceived shall not use parson nor build an IOTHUB_SERVICE_FEEDBACK_BATCH, it shall copy the message body into a buffer kept by the messaging instance that only grows when a larger body arrives. ]*/
+        if (binary_data.length + 1 > messagingData->feedback_buffer_size)
         {
-            /*Codes_SRS_IOTHUBMESSAGING_12_053: [ If both sender and receiver state is open IoTHubMessaging_LL_ReceiverStateChanged shall set the isOpened local variable to true ] */
-            messagingData->isOpened = true;
-            if (messagingData->callback_data->openCompleteCompleteCallback != NULL)
+            if (messagingData->feedback_buffer != NULL)
             {
-                (messagingData->callback_data->openCompleteCompleteCallback)(messagingData->callback_data->openUserContext);
+                free(messagingData->feedback_buffer);
+            }
+            if ((messagingData->feedback_buffer = (char*)malloc(binary_data.length + 1)) == NULL)
+            {
+                messagingData->feedback_buffer_size = 0;
+            }
+            else
+            {
+                messagingData->feedback_buffer_size = binary_data.length + 1;
             }
         }
-        else
+
+        if (messagingData->feedback_buffer == NULL)
         {
-            /*Codes_SRS_IOTHUBMESSAGING_12_054: [ If neither sender_state nor receiver_state is open IoTHubMessaging_LL_ReceiverStateChanged shall set the local isOpened variable to false ] */
-            messagingData->isOpened = false;
+            /*Codes_SRS_IOTHUBMESSAGING_41_032: [ If the message body cannot be read or the buffer cannot be allocated, IoTHubMessaging_LL_FeedbackMessageReceived shall return messaging_delivery_rejected. ]*/
+            LogError("Failed to allocate memory for the feedback records");
+            result = messaging_delivery_rejected("Rejected due to failure reading AMQP message", "Failed to allocate memory for feedback records");
         }
-    }
-}
-
-static void IoTHubMessaging_LL_SendMessageComplete(void* context, MESSAGE_SEND_RESULT send_result, AMQP_VALUE delivery_state)
-{
-    (void)delivery_state;
-    /*Codes_SRS_IOTHUBMESSAGING_12_056: [ If context is NULL IoTHubMessaging_LL_SendMessageComplete shall return ] */
-    if (context != NULL)
-    {
-        /*Codes_SRS_IOTHUBMESSAGING_12_055: [ If context is not NULL and IoTHubMessaging_LL_SendMessageComplete shall call user callback with user context and messaging result ] */
-        IOTHUB_MESSAGING* messagingData = (IOTHUB_MESSAGING*)context;
-        if (messagingData->callback_data->sendCompleteCallback != NULL)
+        else
         {
-            // Convert a send result to an
-            IOTHUB_MESSAGING_RESULT msg_result;
-            switch (send_result)
+            FEEDBACK_PARSER parser;
+            size_t recordCount;
+
+            (void)memcpy(messagingData->feedback_buffer, binary_data.bytes, binary_data.length);
+            messagingData->feedback_buffer[binary_data.length] = '\0';
+
+            parser.position = messagingData->feedback_buffer;
+            parser.end = messagingData->feedback_buffer + strlen(messagingData->feedback_buffer);
+            parser.isDelivering = 0;
+
+            /*Codes_SRS_IOTHUBMESSAGING_41_031: [ If the body is not a non-empty JSON array of objects, IoTHubMessaging_LL_FeedbackMessageReceived shall call no callback and return messaging_delivery_rejected. ]*/
+            if ((parseFeedbackRecords(messagingData, &parser, &recordCount) != 0) || (recordCount == 0))
             {
-                case MESSAGE_SEND_OK:
-                    msg_result = IOTHUB_MESSAGING_OK;
-                    break;
-                case MESSAGE_SEND_ERROR:
-                case MESSAGE_SEND_TIMEOUT:
-                case MESSAGE_SEND_CANCELLED:
-                default:
-                    msg_result = IOTHUB_MESSAGING_ERROR;
-                    break;
+                LogError("Failed to parse the feedback records");
+                result = messaging_delivery_rejected("Rejected due to failure reading AMQP message", "Failed to read feedback records");
+            }
+            else
+            {
+                parser.position = messagingData->feedback_buffer;
+                parser.isDelivering = 1;
+                (void)parseFeedbackRecords(messagingData, &parser, &recordCount);
+
+                /*Codes_SRS_IOTHUBMESSAGING_41_034: [ Otherwise IoTHubMessaging_LL_FeedbackMessageReceived shall return messaging_delivery_accepted. ]*/
+                result = messaging_delivery_accepted();
             }
-            (messagingData->callback_data->sendCompleteCallback)(messagingData->callback_data->sendUserContext, msg_result);
         }
     }
+
+    return result;
 }
 
 static AMQP_VALUE IoTHubMessaging_LL_FeedbackMessageReceived(const void* context, MESSAGE_HANDLE message)
@@ -680,6 +1619,10 @@ static AMQP_VALUE IoTHubMessaging_LL_FeedbackMessageReceived(const void* context
     {
         result = messaging_delivery_accepted();
     }
+    else if (((IOTHUB_MESSAGING*)context)->callback_data->feedbackRecordCallback != NULL)
+    {
+        result = receiveFeedbackRecords((IOTHUB_MESSAGING*)context, message);
+    }
     else
     {
         IOTHUB_MESSAGING* messagingData = (IOTHUB_MESSAGING*)context;
@@ -770,39 +1713,7 @@ static AMQP_VALUE IoTHubMessaging_LL_FeedbackMessageReceived(const void* context
                                 feedbackRecord->originalMessageId = (char*)json_object_get_string(feedback_object, FEEDBACK_RECORD_KEY_ORIGINAL_MESSAGE_ID);
                                 feedbackRecord->correlationId = "";
 
-                                if (feedbackRecord->description == NULL)
-                                {
-                                    feedbackRecord->statusCode = IOTHUB_FEEDBACK_STATUS_CODE_UNKNOWN;
-                                }
-                                else
-                                {
-                                    size_t j;
-                                    for (j = 0; feedbackRecord->description[j]; j++)
-                                    {
-                                        feedbackRecord->description[j] = (char)tolower(feedbackRecord->description[j]);
-                                    }
-
-                                    if (strcmp(feedbackRecord->description, "success") == 0)
-                                    {
-                                        feedbackRecord->statusCode = IOTHUB_FEEDBACK_STATUS_CODE_SUCCESS;
-                                    }
-                                    else if (strcmp(feedbackRecord->description, "expired") == 0)
-                                    {
-                                        feedbackRecord->statusCode = IOTHUB_FEEDBACK_STATUS_CODE_EXPIRED;
-                                    }
-                                    else if (strcmp(feedbackRecord->description, "deliverycountexceeded") == 0)
-                                    {
-                                        feedbackRecord->statusCode = IOTHUB_FEEDBACK_STATUS_CODE_DELIVER_COUNT_EXCEEDED;
-                                    }
-                                    else if (strcmp(feedbackRecord->description, "rejected") == 0)
-                                    {
-                                        feedbackRecord->statusCode = IOTHUB_FEEDBACK_STATUS_CODE_REJECTED;
-                                    }
-                                    else
-                                    {
-                                        feedbackRecord->statusCode = IOTHUB_FEEDBACK_STATUS_CODE_UNKNOWN;
-                                    }
-                                }
+                                feedbackRecord->statusCode = getFeedbackStatusCode(feedbackRecord->description);
                                 if (singlylinkedlist_add(feedbackBatch->feedbackRecordList, feedbackRecord) == NULL)
                                 {
                                     LogError("singlylinkedlist_add failed");
@@ -969,9 +1880,11 @@ IOTHUB_MESSAGING_HANDLE IoTHubMessaging_LL_Create(IOTHUB_SERVICE_CLIENT_AUTH_HAN
                 callback_data->openCompleteCompleteCallback = NULL;
                 callback_data->sendCompleteCallback = NULL;
                 callback_data->feedbackMessageCallback = NULL;
+                callback_data->feedbackRecordCallback = NULL;
                 callback_data->openUserContext = NULL;
                 callback_data->sendUserContext = NULL;
                 callback_data->feedbackUserContext = NULL;
+                callback_data->feedbackRecordUserContext = NULL;
 
                 result->callback_data = callback_data;
             }
@@ -988,6 +1901,12 @@ void IoTHubMessaging_LL_Destroy(IOTHUB_MESSAGING_HANDLE messagingHandle)
         /*Codes_SRS_IOTHUBMESSAGING_12_006: [ If the messagingHandle input parameter is not NULL IoTHubMessaging_LL_Destroy shall free all resources (memory) allocated by IoTHubMessaging_LL_Create ] */
         IOTHUB_MESSAGING* messHandle = (IOTHUB_MESSAGING*)messagingHandle;
 
+        abandonBatch(messHandle);
+        /*Codes_SRS_IOTHUBMESSAGING_41_033: [ IoTHubMessaging_LL_Destroy shall free the buffer used for streaming feedback records. ]*/
+        if (messHandle->feedback_buffer != NULL)
+        {
+            free(messHandle->feedback_buffer);
+        }
         free(messHandle->callback_data);
         free(messHandle->hostname);
         free(messHandle->iothubName);
@@ -1051,6 +1970,154 @@ static int attachServiceClientTypeToLink(LINK_HANDLE link)
     return result;
 }
 
+static void closePooledSenders(IOTHUB_MESSAGING* messagingData)
+{
+    if (messagingData->pooled_senders != NULL)
+    {
+        size_t i;
+
+        for (i = 0; i < messagingData->pooled_sender_count; i++)
+        {
+            IOTHUB_MESSAGING_POOLED_SENDER* pooledSender = &messagingData->pooled_senders[i];
+
+            if (pooledSender->message_sender != NULL)
+            {
+                messagesender_destroy(pooledSender->message_sender);
+            }
+            if (pooledSender->sender_link != NULL)
+            {
+                link_destroy(pooledSender->sender_link);
+            }
+            if (pooledSender->session != NULL)
+            {
+                session_destroy(pooledSender->session);
+            }
+        }
+
+        free(messagingData->pooled_senders);
+        messagingData->pooled_senders = NULL;
+    }
+}
+
+static int openPooledSender(IOTHUB_MESSAGING* messagingData, IOTHUB_MESSAGING_POOLED_SENDER* pooledSender, size_t index, const char* send_target_address)
+{
+    int result;
+    char linkName[32];
+    AMQP_VALUE source = NULL;
+    AMQP_VALUE target = NULL;
+
+    /*Codes_SRS_IOTHUBMESSAGING_41_017: [ Each pooled sender shall get its own session on the connection, with the same windows as the primary session, and a sender link named sender-link-<n> created, attached, settled and opened the same way as the primary sender link. ]*/
+    if (snprintf(linkName, sizeof(linkName), "sender-link-%lu", (unsigned long)index) < 0)
+    {
+        LogError("Could not create the name of pooled sender link %lu.", (unsigned long)index);
+        result = __FAILURE__;
+    }
+    else if ((pooledSender->session = session_create(messagingData->connection, NULL, NULL)) == NULL)
+    {
+        LogError("Could not create the session of pooled sender link %lu.", (unsigned long)index);
+        result = __FAILURE__;
+    }
+    else if (session_set_incoming_window(pooledSender->session, 2147483647) != 0)
+    {
+        LogError("Could not set the incoming window of pooled sender link %lu.", (unsigned long)index);
+        result = __FAILURE__;
+    }
+    else if (session_set_outgoing_window(pooledSender->session, 255 * 1024) != 0)
+    {
+        LogError("Could not set the outgoing window of pooled sender link %lu.", (unsigned long)index);
+        result = __FAILURE__;
+    }
+    else if ((source = messaging_create_source("ingress")) == NULL)
+    {
+        LogError("Could not create the source of pooled sender link %lu.", (unsigned long)index);
+        result = __FAILURE__;
+    }
+    else if ((target = messaging_create_target(send_target_address)) == NULL)
+    {
+        LogError("Could not create the target of pooled sender link %lu.", (unsigned long)index);
+        result = __FAILURE__;
+    }
+    else if ((pooledSender->sender_link = link_create(pooledSender->session, linkName, role_sender, source, target)) == NULL)
+    {
+        LogError("Could not create pooled sender link %lu.", (unsigned long)index);
+        result = __FAILURE__;
+    }
+    else if (attachServiceClientTypeToLink(pooledSender->sender_link) != 0)
+    {
+        LogError("Could not set the attach properties of pooled sender link %lu.", (unsigned long)index);
+        result = __FAILURE__;
+    }
+    else if (link_set_snd_settle_mode(pooledSender->sender_link, sender_settle_mode_unsettled) != 0)
+    {
+        LogError("Could not set the settle mode of pooled sender link %lu.", (unsigned long)index);
+        result = __FAILURE__;
+    }
+    else if ((pooledSender->message_sender = messagesender_create(pooledSender->sender_link, IoTHubMessaging_LL_PooledSenderStateChanged, pooledSender)) == NULL)
+    {
+        LogError("Could not create the message sender of pooled sender link %lu.", (unsigned long)index);
+        result = __FAILURE__;
+    }
+    else if (messagesender_open(pooledSender->message_sender) != 0)
+    {
+        LogError("Could not open the message sender of pooled sender link %lu.", (unsigned long)index);
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = 0;
+    }
+
+    if (source != NULL)
+    {
+        amqpvalue_destroy(source);
+    }
+    if (target != NULL)
+    {
+        amqpvalue_destroy(target);
+    }
+
+    return result;
+}
+
+static int openPooledSenders(IOTHUB_MESSAGING* messagingData, const char* send_target_address)
+{
+    int result;
+
+    messagingData->next_sender = 0;
+
+    if (messagingData->pooled_sender_count == 0)
+    {
+        /*Codes_SRS_IOTHUBMESSAGING_41_016: [ If the sender link count is 1 IoTHubMessaging_LL_Open shall not create any session or link beyond the primary ones. ]*/
+        result = 0;
+    }
+    else if ((messagingData->pooled_senders = (IOTHUB_MESSAGING_POOLED_SENDER*)malloc(messagingData->pooled_sender_count * sizeof(IOTHUB_MESSAGING_POOLED_SENDER))) == NULL)
+    {
+        /*Codes_SRS_IOTHUBMESSAGING_41_018: [ If creating any of the pooled senders fails IoTHubMessaging_LL_Open shall destroy all of them and fail like any other uAMQP failure. ]*/
+        LogError("Could not allocate %lu pooled senders.", (unsigned long)messagingData->pooled_sender_count);
+        result = __FAILURE__;
+    }
+    else
+    {
+        size_t i;
+
+        (void)memset(messagingData->pooled_senders, 0, messagingData->pooled_sender_count * sizeof(IOTHUB_MESSAGING_POOLED_SENDER));
+
+        result = 0;
+        for (i = 0; (i < messagingData->pooled_sender_count) && (result == 0); i++)
+        {
+            result = openPooledSender(messagingData, &messagingData->pooled_senders[i], i + 1, send_target_address);
+        }
+
+        if (result != 0)
+        {
+            /*Codes_SRS_IOTHUBMESSAGING_41_018: [ If creating any of the pooled senders fails IoTHubMessaging_LL_Open shall destroy all of them and fail like any other uAMQP failure. ]*/
+            closePooledSenders(messagingData);
+        }
+    }
+
+    return result;
+}
+
 IOTHUB_MESSAGING_RESULT IoTHubMessaging_LL_Open(IOTHUB_MESSAGING_HANDLE messagingHandle, IOTHUB_OPEN_COMPLETE_CALLBACK openCompleteCallback, void* userContextCallback)
 {
     IOTHUB_MESSAGING_RESULT result;
@@ -1318,6 +2385,15 @@ IOTHUB_MESSAGING_RESULT IoTHubMessaging_LL_Open(IOTHUB_MESSAGING_HANDLE messagin
                         messagingHandle->message_receiver = NULL;
                         result = IOTHUB_MESSAGING_ERROR;
                     }
+                    /*Codes_SRS_IOTHUBMESSAGING_41_015: [ After the receiver IoTHubMessaging_LL_Open shall create the sender link count - 1 pooled senders on the same connection. ]*/
+                    else if (openPooledSenders(messagingHandle, send_target_address) != 0)
+                    {
+                        /*Codes_SRS_IOTHUBMESSAGING_12_030: [ If any of the uAMQP call fails IoTHubMessaging_LL_Open shall return IOTHUB_MESSAGING_ERROR ] */
+                        LogError("Could not open the pooled senders.");
+                        messagereceiver_destroy(messagingHandle->message_receiver);
+                        messagingHandle->message_receiver = NULL;
+                        result = IOTHUB_MESSAGING_ERROR;
+                    }
                     else
                     {
                         /*Codes_SRS_IOTHUBMESSAGING_12_031: [ If all of the uAMQP call return 0 (success) IoTHubMessaging_LL_Open shall return IOTHUB_MESSAGING_OK ] */
@@ -1401,6 +2477,9 @@ void IoTHubMessaging_LL_Close(IOTHUB_MESSAGING_HANDLE messagingHandle)
     else
     {
         messagesender_destroy(messagingHandle->message_sender);
+        /*Codes_SRS_IOTHUBMESSAGING_41_022: [ IoTHubMessaging_LL_Close shall destroy the message sender, link and session of every pooled sender. ]*/
+        closePooledSenders(messagingHandle);
+        abandonBatch(messagingHandle);
         messagereceiver_destroy(messagingHandle->message_receiver);
 
         link_destroy(messagingHandle->sender_link);
@@ -1450,6 +2529,26 @@ IOTHUB_MESSAGING_RESULT IoTHubMessaging_LL_SetFeedbackMessageCallback(IOTHUB_MES
 }
 
 
+IOTHUB_MESSAGING_RESULT IoTHubMessaging_LL_SetFeedbackRecordCallback(IOTHUB_MESSAGING_HANDLE messagingHandle, IOTHUB_FEEDBACK_RECORD_RECEIVED_CALLBACK feedbackRecordReceivedCallback, void* userContextCallback)
+{
+    IOTHUB_MESSAGING_RESULT result;
+
+    /*Codes_SRS_IOTHUBMESSAGING_41_025: [ If messagingHandle is NULL, IoTHubMessaging_LL_SetFeedbackRecordCallback shall return IOTHUB_MESSAGING_INVALID_ARG. ]*/
+    if (messagingHandle == NULL)
+    {
+        LogError("Input parameter cannot be NULL");
+        result = IOTHUB_MESSAGING_INVALID_ARG;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBMESSAGING_41_026: [ Otherwise IoTHubMessaging_LL_SetFeedbackRecordCallback shall save the callback and its context, a NULL callback turning the streaming back off, and return IOTHUB_MESSAGING_OK. ]*/
+        messagingHandle->callback_data->feedbackRecordCallback = feedbackRecordReceivedCallback;
+        messagingHandle->callback_data->feedbackRecordUserContext = userContextCallback;
+        result = IOTHUB_MESSAGING_OK;
+    }
+    return result;
+}
+
 IOTHUB_MESSAGING_RESULT IoTHubMessaging_LL_Send(IOTHUB_MESSAGING_HANDLE messagingHandle, const char* deviceId, IOTHUB_MESSAGE_HANDLE message, IOTHUB_SEND_COMPLETE_CALLBACK sendCompleteCallback, void* userContextCallback)
 {
     IOTHUB_MESSAGING_RESULT result;
@@ -1555,7 +2654,8 @@ IOTHUB_MESSAGING_RESULT IoTHubMessaging_LL_Send(IOTHUB_MESSAGING_HANDLE messagin
                     messagingHandle->callback_data->sendUserContext = userContextCallback;
 
                     /*Codes_SRS_IOTHUBMESSAGING_12_039: [ IoTHubMessaging_LL_SendMessage shall call uAMQP messagesender_send with the created message with IoTHubMessaging_LL_SendMessageComplete callback by which IoTHubMessaging is notified of completition of send ] */
-                    if (messagesender_send_async(messagingHandle->message_sender, amqpMessage, IoTHubMessaging_LL_SendMessageComplete, messagingHandle, 0) == NULL)
+                    /*Codes_SRS_IOTHUBMESSAGING_41_020: [ With pooled senders IoTHubMessaging_LL_Send shall dispatch messages round-robin over the primary sender and the pooled senders that are open. ]*/
+                    if (messagesender_send_async(selectMessageSender(messagingHandle), amqpMessage, IoTHubMessaging_LL_SendMessageComplete, messagingHandle, 0) == NULL)
                     {
                         /*Codes_SRS_IOTHUBMESSAGING_12_040: [ If any of the uAMQP call fails IoTHubMessaging_LL_SendMessage shall return IOTHUB_MESSAGING_ERROR ] */
                         LogError("Could not set outgoing window.");
@@ -1578,6 +2678,58 @@ IOTHUB_MESSAGING_RESULT IoTHubMessaging_LL_Send(IOTHUB_MESSAGING_HANDLE messagin
 }
 
 
+IOTHUB_MESSAGING_RESULT IoTHubMessaging_LL_SendBatch(IOTHUB_MESSAGING_HANDLE messagingHandle, const char* const* deviceIds, size_t deviceIdCount, IOTHUB_MESSAGE_HANDLE message, IOTHUB_SEND_BATCH_COMPLETE_CALLBACK sendBatchCompleteCallback, void* userContextCallback)
+{
+    IOTHUB_MESSAGING_RESULT result;
+    size_t i = 0;
+
+    if (deviceIds != NULL)
+    {
+        while ((i < deviceIdCount) && (deviceIds[i] != NULL))
+        {
+            i++;
+        }
+    }
+
+    /*Codes_SRS_IOTHUBMESSAGING_41_001: [ If messagingHandle, deviceIds or message is NULL, deviceIdCount is 0 or any of the device ids is NULL, IoTHubMessaging_LL_SendBatch shall return IOTHUB_MESSAGING_INVALID_ARG. ]*/
+    if ((messagingHandle == NULL) || (deviceIds == NULL) || (deviceIdCount == 0) || (message == NULL) || (i != deviceIdCount))
+    {
+        LogError("Invalid argument messagingHandle: %p, deviceIds: %p, deviceIdCount: %lu, message: %p", messagingHandle, deviceIds, (unsigned long)deviceIdCount, message);
+        result = IOTHUB_MESSAGING_INVALID_ARG;
+    }
+    /*Codes_SRS_IOTHUBMESSAGING_41_002: [ If the messaging is not opened or another batch is still in progress, IoTHubMessaging_LL_SendBatch shall return IOTHUB_MESSAGING_ERROR. ]*/
+    else if (messagingHandle->isOpened == 0)
+    {
+        LogError("Messaging is not opened - call IoTHubMessaging_LL_Open to open");
+        result = IOTHUB_MESSAGING_ERROR;
+    }
+    else if (messagingHandle->batch != NULL)
+    {
+        LogError("A batch is still in progress.");
+        result = IOTHUB_MESSAGING_ERROR;
+    }
+    else if ((messagingHandle->batch = createBatch(messagingHandle, deviceIds, deviceIdCount, message)) == NULL)
+    {
+        /*Codes_SRS_IOTHUBMESSAGING_41_005: [ If any of the allocations or uAMQP calls preparing the batch fails, IoTHubMessaging_LL_SendBatch shall release what it created, send nothing and return IOTHUB_MESSAGING_ERROR. ]*/
+        LogError("Could not create the batch.");
+        result = IOTHUB_MESSAGING_ERROR;
+    }
+    else
+    {
+        messagingHandle->batch->sendBatchCompleteCallback = sendBatchCompleteCallback;
+        messagingHandle->batch->userContext = userContextCallback;
+
+        /*Codes_SRS_IOTHUBMESSAGING_41_006: [ No more than IOTHUB_MESSAGING_BATCH_MAX_IN_FLIGHT deliveries of the batch shall be queued on the message sender at a time. ]*/
+        sendBatchDeliveries(messagingHandle);
+
+        /*Codes_SRS_IOTHUBMESSAGING_41_013: [ Otherwise IoTHubMessaging_LL_SendBatch shall return IOTHUB_MESSAGING_OK. ]*/
+        result = IOTHUB_MESSAGING_OK;
+    }
+
+    return result;
+}
+
+
 void IoTHubMessaging_LL_DoWork(IOTHUB_MESSAGING_HANDLE messagingHandle)
 {
     /*Codes_SRS_IOTHUBMESSAGING_12_045: [ IoTHubMessaging_LL_DoWork shall verify if uAMQP transport has been initialized and if it is not then return immediately ] */
@@ -1586,10 +2738,38 @@ void IoTHubMessaging_LL_DoWork(IOTHUB_MESSAGING_HANDLE messagingHandle)
         /*Codes_SRS_IOTHUBMESSAGING_12_046: [ IoTHubMessaging_LL_DoWork shall call uAMQP connection_dowork ] */
         /*Codes_SRS_IOTHUBMESSAGING_12_047: [ IoTHubMessaging_LL_SendMessageComplete callback given to messagesender_send will be called with MESSAGE_SEND_RESULT ] */
         /*Codes_SRS_IOTHUBMESSAGING_12_048: [ If message has been received the IoTHubMessaging_LL_FeedbackMessageReceived callback given to messagesender_receive will be called with the received MESSAGE_HANDLE ] */
+        /*Codes_SRS_IOTHUBMESSAGING_41_011: [ IoTHubMessaging_LL_DoWork shall queue more deliveries of the batch on the message sender, up to IOTHUB_MESSAGING_BATCH_MAX_IN_FLIGHT, before calling connection_dowork. ]*/
+        sendBatchDeliveries(messagingHandle);
         connection_dowork(messagingHandle->connection);
     }
 }
 
+IOTHUB_MESSAGING_RESULT IoTHubMessaging_LL_SetSenderLinkCount(IOTHUB_MESSAGING_HANDLE messagingHandle, size_t senderLinkCount)
+{
+    IOTHUB_MESSAGING_RESULT result;
+
+    /*Codes_SRS_IOTHUBMESSAGING_41_014: [ If messagingHandle is NULL or senderLinkCount is 0 or greater than IOTHUB_MESSAGING_MAX_SENDER_LINKS, IoTHubMessaging_LL_SetSenderLinkCount shall return IOTHUB_MESSAGING_INVALID_ARG. ]*/
+    if ((messagingHandle == NULL) || (senderLinkCount == 0) || (senderLinkCount > IOTHUB_MESSAGING_MAX_SENDER_LINKS))
+    {
+        LogError("Invalid argument messagingHandle: %p senderLinkCount: %lu", messagingHandle, (unsigned long)senderLinkCount);
+        result = IOTHUB_MESSAGING_INVALID_ARG;
+    }
+    /*Codes_SRS_IOTHUBMESSAGING_41_023: [ If the messaging is opened IoTHubMessaging_LL_SetSenderLinkCount shall return IOTHUB_MESSAGING_ERROR. ]*/
+    else if ((messagingHandle->isOpened != 0) || (messagingHandle->pooled_senders != NULL))
+    {
+        LogError("The sender link count cannot be changed while the messaging is opened");
+        result = IOTHUB_MESSAGING_ERROR;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBMESSAGING_41_024: [ Otherwise IoTHubMessaging_LL_SetSenderLinkCount shall save the count to be used by the next IoTHubMessaging_LL_Open and return IOTHUB_MESSAGING_OK. ]*/
+        messagingHandle->pooled_sender_count = senderLinkCount - 1;
+        result = IOTHUB_MESSAGING_OK;
+    }
+
+    return result;
+}
+
 IOTHUB_MESSAGING_RESULT IoTHubMessaging_LL_SetTrustedCert(IOTHUB_MESSAGING_HANDLE messagingHandle, const char* trusted_cert)
 {
     IOTHUB_MESSAGING_RESULT result;
@@ -11,11 +11,15 @@
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/httpapiex.h"
 #include "azure_c_shared_utility/httpapiexsas.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/agenttime.h"
 #include "azure_c_shared_utility/connection_string_parser.h"
 
 #include "parson.h"
 #include "iothub_registrymanager.h"
 #include "iothub_sc_version.h"
+#include "internal/iothub_sc_http_pool.h"
 
 #define IOTHUB_DEVICE_EX_VERSION_LATEST IOTHUB_DEVICE_EX_VERSION_1
 #define IOTHUB_REGISTRY_DEVICE_CREATE_EX_VERSION_LATEST IOTHUB_REGISTRY_DEVICE_CREATE_EX_VERSION_1
@@ -50,8 +54,15 @@ DEFINE_ENUM_STRINGS(IOTHUB_REGISTRYMANAGER_AUTH_METHOD, IOTHUB_REGISTRYMANAGER_A
 #define  HTTP_HEADER_VAL_CONTENT_TYPE  "application/json; charset=utf-8"
 #define  HTTP_HEADER_KEY_IFMATCH  "If-Match"
 #define  HTTP_HEADER_VAL_IFMATCH  "*"
+#define  HTTP_HEADER_KEY_IFNONEMATCH  "If-None-Match"
+#define  HTTP_HEADER_KEY_MAX_ITEM_COUNT  "x-ms-max-item-count"
+#define  HTTP_HEADER_KEY_CONTINUATION  "x-ms-continuation"
 
 static size_t IOTHUB_DEVICES_MAX_REQUEST = 1000;
+static size_t IOTHUB_DEVICES_MAX_BULK_REQUEST = 100;
+
+/*number of concurrent bulk requests, each of them on its own connection*/
+#define IOTHUB_DEVICES_BULK_WORKER_COUNT 4
 
 static const char* DEVICE_JSON_KEY_DEVICE_NAME = "deviceId";
 static const char* DEVICE_JSON_KEY_MODULE_NAME = "moduleId";
@@ -85,6 +96,19 @@ static const char* DEVICE_JSON_KEY_DEVICE_DEVICEROPERTIES = "deviceProperties";
 static const char* DEVICE_JSON_KEY_DEVICE_SERVICEPROPERTIES = "serviceProperties";
 static const char* DEVICE_JSON_KEY_MANAGED_BY = "managedBy";
 
+static const char* DEVICE_QUERY_JSON_KEY_DEVICE_ETAG = "deviceEtag";
+static const char* DEVICE_QUERY_JSON_KEY_DEVICE_STATUSUPDATETIME = "statusUpdateTime";
+static const char* DEVICE_QUERY_JSON_KEY_DEVICE_AUTH_TYPE = "authenticationType";
+static const char* DEVICE_QUERY_JSON_KEY_DEVICE_PRIMARY_THUMBPRINT = "x509Thumbprint.primaryThumbprint";
+static const char* DEVICE_QUERY_JSON_KEY_DEVICE_SECONDARY_THUMBPRINT = "x509Thumbprint.secondaryThumbprint";
+
+static const char* DEVICE_BULK_JSON_KEY_DEVICE_ID = "id";
+static const char* DEVICE_BULK_JSON_KEY_IMPORT_MODE = "importMode";
+static const char* DEVICE_BULK_JSON_KEY_ERRORS = "errors";
+static const char* DEVICE_BULK_JSON_KEY_ERROR_CODE = "errorCode";
+static const char* DEVICE_BULK_JSON_VALUE_IMPORT_MODE_CREATE = "create";
+static const char* DEVICE_BULK_JSON_VALUE_DEVICE_ALREADY_EXISTS = "DeviceAlreadyExists";
+
 static const char* DEVICE_JSON_KEY_TOTAL_DEVICECOUNT = "totalDeviceCount";
 static const char* DEVICE_JSON_KEY_ENABLED_DEVICECCOUNT = "enabledDeviceCount";
 static const char* DEVICE_JSON_KEY_DISABLED_DEVICECOUNT = "disabledDeviceCount";
@@ -101,6 +125,10 @@ static const char* RELATIVE_PATH_MODULE_FMT_CRUD = "/devices/%s/modules/%s?%s";
 static const char* RELATIVE_PATH_FMT_LIST = "/devices/?top=%s&%s";
 static const char* RELATIVE_PATH_FMT_STAT = "/statistics/devices?%s";
 static const char* RELATIVE_PATH_FMT_MODULE_LIST = "/devices/%s/modules?%s";
+static const char* RELATIVE_PATH_FMT_DEVICE_QUERY = "/devices/query?%s";
+static const char* RELATIVE_PATH_FMT_BULK = "/devices?%s";
+
+static const char* DEVICE_QUERY_ALL_DEVICES = "{\"query\":\"SELECT * FROM devices\"}";
 
 typedef enum {IOTHUB_REGISTRYMANAGER_MODEL_TYPE_DEVICE, IOTHUB_REGISTRYMANAGER_MODEL_TYPE_MODULE} IOTHUB_REGISTRYMANAGER_MODEL_TYPE;
 
@@ -1231,7 +1259,24 @@ static STRING_HANDLE createUriPath(IOTHUB_REGISTRYMANAGER_HANDLE registryManager
     }
 }
 
-static IOTHUB_REGISTRYMANAGER_RESULT sendHttpRequestCRUD(IOTHUB_REGISTRYMANAGER_HANDLE registryManagerHandle, IOTHUB_REQUEST_MODE iotHubRequestMode, const char* deviceName, const char* moduleId, BUFFER_HANDLE deviceJsonBuffer, size_t numberOfDevices, BUFFER_HANDLE responseBuffer)
+static HTTPAPIEX_RESULT executeHttpRequest(IOTHUB_REGISTRYMANAGER_HANDLE registryManagerHandle, HTTPAPIEX_SAS_HANDLE httpExApiSasHandle, HTTPAPIEX_HANDLE httpExApiHandle, HTTPAPI_REQUEST_TYPE httpApiRequestType, const char* relativePath, HTTP_HEADERS_HANDLE httpHeader, BUFFER_HANDLE requestBuffer, unsigned int* statusCode, BUFFER_HANDLE responseBuffer)
+{
+    HTTPAPIEX_RESULT result;
+
+    if (registryManagerHandle->httpPool != NULL)
+    {
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_032: [ If the handle shares an HTTP connection pool, the request shall be executed on a pooled keep-alive connection with the cached SAS token by calling IoTHubSCHttpPool_ExecuteRequest instead of creating an HTTPAPIEX_SAS_HANDLE and an HTTPAPIEX_HANDLE per request ] */
+        result = IoTHubSCHttpPool_ExecuteRequest(registryManagerHandle->httpPool, httpApiRequestType, relativePath, httpHeader, requestBuffer, statusCode, NULL, responseBuffer);
+    }
+    else
+    {
+        result = HTTPAPIEX_SAS_ExecuteRequest(httpExApiSasHandle, httpExApiHandle, httpApiRequestType, relativePath, httpHeader, requestBuffer, statusCode, NULL, responseBuffer);
+    }
+    return result;
+}
+
+/*sends the request, conditioned by an If-None-Match header when ifNoneMatch is not NULL; notModified is set if the hub answered 304*/
+static IOTHUB_REGISTRYMANAGER_RESULT sendConditionalHttpRequest(IOTHUB_REGISTRYMANAGER_HANDLE registryManagerHandle, IOTHUB_REQUEST_MODE iotHubRequestMode, const char* deviceName, const char* moduleId, BUFFER_HANDLE deviceJsonBuffer, size_t numberOfDevices, const char* ifNoneMatch, bool* notModified, BUFFER_HANDLE responseBuffer)
 {
     IOTHUB_REGISTRYMANAGER_RESULT result;
 
@@ -1242,21 +1287,21 @@ static IOTHUB_REGISTRYMANAGER_RESULT sendHttpRequestCRUD(IOTHUB_REGISTRYMANAGER_
     HTTPAPIEX_HANDLE httpExApiHandle = NULL;
     HTTP_HEADERS_HANDLE httpHeader = NULL;
 
-    if ((uriResource = createUriPath(registryManagerHandle)) == NULL)
+    if ((registryManagerHandle->httpPool == NULL) && ((uriResource = createUriPath(registryManagerHandle)) == NULL))
     {
         /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_099: [ If any of the call fails during the HTTP creation IoTHubRegistryManager_CreateDevice shall fail and return IOTHUB_REGISTRYMANAGER_ERROR ] */
         /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_103: [ If any of the call fails during the HTTP creation IoTHubRegistryManager_UpdateDevice shall fail and return IOTHUB_REGISTRYMANAGER_ERROR ] */
         LogError("STRING_construct failed for uriResource");
         result = IOTHUB_REGISTRYMANAGER_ERROR;
     }
-    else if ((accessKey = STRING_construct(registryManagerHandle->sharedAccessKey)) == NULL)
+    else if ((registryManagerHandle->httpPool == NULL) && ((accessKey = STRING_construct(registryManagerHandle->sharedAccessKey)) == NULL))
     {
         /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_099: [ If any of the call fails during the HTTP creation IoTHubRegistryManager_CreateDevice shall fail and return IOTHUB_REGISTRYMANAGER_ERROR ] */
         /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_103: [ If any of the call fails during the HTTP creation IoTHubRegistryManager_UpdateDevice shall fail and return IOTHUB_REGISTRYMANAGER_ERROR ] */
         LogError("STRING_construct failed for accessKey");
         result = IOTHUB_REGISTRYMANAGER_ERROR;
     }
-    else if ((registryManagerHandle->keyName != NULL) && ((keyName = STRING_construct(registryManagerHandle->keyName)) == NULL))
+    else if ((registryManagerHandle->httpPool == NULL) && (registryManagerHandle->keyName != NULL) && ((keyName = STRING_construct(registryManagerHandle->keyName)) == NULL))
     {
         /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_099: [ If any of the call fails during the HTTP creation IoTHubRegistryManager_CreateDevice shall fail and return IOTHUB_REGISTRYMANAGER_ERROR ] */
         /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_103: [ If any of the call fails during the HTTP creation IoTHubRegistryManager_UpdateDevice shall fail and return IOTHUB_REGISTRYMANAGER_ERROR ] */
@@ -1275,11 +1320,17 @@ static IOTHUB_REGISTRYMANAGER_RESULT sendHttpRequestCRUD(IOTHUB_REGISTRYMANAGER_
         LogError("HttpHeader creation failed");
         result = IOTHUB_REGISTRYMANAGER_HTTPAPI_ERROR;
     }
+    /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_042: [ A device entry older than the time to live that has an etag shall be revalidated with a GET request carrying an If-None-Match header set to the etag ] */
+    else if ((ifNoneMatch != NULL) && (HTTPHeaders_AddHeaderNameValuePair(httpHeader, HTTP_HEADER_KEY_IFNONEMATCH, ifNoneMatch) != HTTP_HEADERS_OK))
+    {
+        LogError("HTTPHeaders_AddHeaderNameValuePair failed for If-None-Match header");
+        result = IOTHUB_REGISTRYMANAGER_HTTPAPI_ERROR;
+    }
     /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_016: [ IoTHubRegistryManager_CreateDevice shall create an HTTPAPIEX_SAS_HANDLE handle by calling HTTPAPIEX_SAS_Create ] */
     /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_028: [ IoTHubRegistryManager_GetDevice shall create an HTTPAPIEX_SAS_HANDLE handle by calling HTTPAPIEX_SAS_Create ] */
     /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_045: [ IoTHubRegistryManager_UpdateDevice shall create an HTTPAPIEX_SAS_HANDLE handle by calling HTTPAPIEX_SAS_Create ] */
     /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_055: [ IoTHubRegistryManager_DeleteDevice shall create an HTTPAPIEX_SAS_HANDLE handle by calling HTTPAPIEX_SAS_Create ] */
-    else if ((httpExApiSasHandle = HTTPAPIEX_SAS_Create(accessKey, uriResource, keyName)) == NULL)
+    else if ((registryManagerHandle->httpPool == NULL) && ((httpExApiSasHandle = HTTPAPIEX_SAS_Create(accessKey, uriResource, keyName)) == NULL))
     {
         /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_019: [ If any of the HTTPAPI call fails IoTHubRegistryManager_CreateDevice shall fail and return IOTHUB_REGISTRYMANAGER_HTTPAPI_ERROR ] */
         /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_104: [ If any of the HTTPAPI call fails IoTHubRegistryManager_UpdateDevice shall fail and return IOTHUB_REGISTRYMANAGER_HTTPAPI_ERROR ] */
@@ -1290,7 +1341,7 @@ static IOTHUB_REGISTRYMANAGER_RESULT sendHttpRequestCRUD(IOTHUB_REGISTRYMANAGER_
     /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_029: [ IoTHubRegistryManager_GetDevice shall create an HTTPAPIEX_HANDLE handle by calling HTTPAPIEX_Create ] */
     /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_046: [ IoTHubRegistryManager_UpdateDevice shall create an HTTPAPIEX_HANDLE handle by calling HTTPAPIEX_Create ] */
     /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_056: [ IoTHubRegistryManager_DeleteDevice shall create an HTTPAPIEX_HANDLE handle by calling HTTPAPIEX_Create ] */
-    else if ((httpExApiHandle = HTTPAPIEX_Create(registryManagerHandle->hostname)) == NULL)
+    else if ((registryManagerHandle->httpPool == NULL) && ((httpExApiHandle = HTTPAPIEX_Create(registryManagerHandle->hostname)) == NULL))
     {
         /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_019: [ If any of the HTTPAPI call fails IoTHubRegistryManager_CreateDevice shall fail and return IOTHUB_REGISTRYMANAGER_HTTPAPI_ERROR ] */
         /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_104: [ If any of the HTTPAPI call fails IoTHubRegistryManager_UpdateDevice shall fail and return IOTHUB_REGISTRYMANAGER_HTTPAPI_ERROR ] */
@@ -1340,7 +1391,7 @@ static IOTHUB_REGISTRYMANAGER_RESULT sendHttpRequestCRUD(IOTHUB_REGISTRYMANAGER_
             /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_030: [ IoTHubRegistryManager_GetDevice shall execute the HTTP GET request by calling HTTPAPIEX_ExecuteRequest ] */
             /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_047: [ IoTHubRegistryManager_UpdateDevice shall execute the HTTP PUT request by calling HTTPAPIEX_ExecuteRequest ] */
             /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_057: [ IoTHubRegistryManager_DeleteDevice shall execute the HTTP DELETE request by calling HTTPAPIEX_ExecuteRequest ] */
-            else if (HTTPAPIEX_SAS_ExecuteRequest(httpExApiSasHandle, httpExApiHandle, httpApiRequestType, relativePath, httpHeader, deviceJsonBuffer, &statusCode, NULL, responseBuffer) != HTTPAPIEX_OK)
+            else if (executeHttpRequest(registryManagerHandle, httpExApiSasHandle, httpExApiHandle, httpApiRequestType, relativePath, httpHeader, deviceJsonBuffer, &statusCode, responseBuffer) != HTTPAPIEX_OK)
             {
                 /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_019: [ If any of the HTTPAPI call fails IoTHubRegistryManager_CreateDevice shall fail and return IOTHUB_REGISTRYMANAGER_HTTPAPI_ERROR ] */
                 LogError("HTTPAPIEX_SAS_ExecuteRequest failed");
@@ -1348,7 +1399,13 @@ static IOTHUB_REGISTRYMANAGER_RESULT sendHttpRequestCRUD(IOTHUB_REGISTRYMANAGER_
             }
             else
             {
-                if (statusCode > 300)
+                if ((ifNoneMatch != NULL) && (statusCode == 304))
+                {
+                    /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_043: [ If the hub answers 304 the cached response shall be used again and its time to live restarted ] */
+                    *notModified = true;
+                    result = IOTHUB_REGISTRYMANAGER_OK;
+                }
+                else if (statusCode > 300)
                 {
                     if ((iotHubRequestMode == IOTHUB_REQUEST_CREATE) && (statusCode == 409))
                     {
@@ -1390,144 +1447,1264 @@ static IOTHUB_REGISTRYMANAGER_RESULT sendHttpRequestCRUD(IOTHUB_REGISTRYMANAGER_
     return result;
 }
 
-static void free_registrymanager_handle(IOTHUB_REGISTRYMANAGER *registryManager)
+static IOTHUB_REGISTRYMANAGER_RESULT sendHttpRequestCRUD(IOTHUB_REGISTRYMANAGER_HANDLE registryManagerHandle, IOTHUB_REQUEST_MODE iotHubRequestMode, const char* deviceName, const char* moduleId, BUFFER_HANDLE deviceJsonBuffer, size_t numberOfDevices, BUFFER_HANDLE responseBuffer)
 {
-    free(registryManager->hostname);
-    free(registryManager->iothubName);
-    free(registryManager->iothubSuffix);
-    free(registryManager->sharedAccessKey);
-    free(registryManager->deviceId);
-    free(registryManager);
+    return sendConditionalHttpRequest(registryManagerHandle, iotHubRequestMode, deviceName, moduleId, deviceJsonBuffer, numberOfDevices, NULL, NULL, responseBuffer);
 }
 
-IOTHUB_REGISTRYMANAGER_HANDLE IoTHubRegistryManager_Create(IOTHUB_SERVICE_CLIENT_AUTH_HANDLE serviceClientHandle)
+typedef struct DEVICE_QUERY_PAGE_TAG
 {
-    IOTHUB_REGISTRYMANAGER_HANDLE result;
+    IOTHUB_REGISTRYMANAGER_HANDLE registryManagerHandle;
+    size_t pageSize;
+    char* continuationToken;
+    BUFFER_HANDLE responseBuffer;
+    IOTHUB_REGISTRYMANAGER_RESULT result;
+} DEVICE_QUERY_PAGE;
 
-    /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_001: [ If the serviceClientHandle input parameter is NULL IoTHubRegistryManager_Create shall return NULL ] */
-    if (serviceClientHandle == NULL)
+/*fetches the page continuing at page->continuationToken (the first page if NULL) into page->responseBuffer and replaces the token with the one of the following page, NULL after the last page*/
+static void fetchDeviceQueryPage(DEVICE_QUERY_PAGE* page)
+{
+    IOTHUB_REGISTRYMANAGER_HANDLE registryManagerHandle = page->registryManagerHandle;
+    STRING_HANDLE uriResource = NULL;
+    STRING_HANDLE accessKey = NULL;
+    STRING_HANDLE keyName = NULL;
+    HTTPAPIEX_SAS_HANDLE httpExApiSasHandle = NULL;
+    HTTPAPIEX_HANDLE httpExApiHandle = NULL;
+    HTTP_HEADERS_HANDLE httpHeader = NULL;
+    HTTP_HEADERS_HANDLE responseHeader = NULL;
+    BUFFER_HANDLE queryBuffer = NULL;
+    char pageSizeStr[32];
+    char relativePath[256];
+    unsigned int statusCode;
+
+    if ((uriResource = createUriPath(registryManagerHandle)) == NULL)
     {
-        LogError("serviceClientHandle input parameter cannot be NULL");
-        result = NULL;
+        LogError("STRING_construct failed for uriResource");
+        page->result = IOTHUB_REGISTRYMANAGER_ERROR;
+    }
+    else if ((accessKey = STRING_construct(registryManagerHandle->sharedAccessKey)) == NULL)
+    {
+        LogError("STRING_construct failed for accessKey");
+        page->result = IOTHUB_REGISTRYMANAGER_ERROR;
+    }
+    else if ((registryManagerHandle->keyName != NULL) && ((keyName = STRING_construct(registryManagerHandle->keyName)) == NULL))
+    {
+        LogError("STRING_construct failed for keyName");
+        page->result = IOTHUB_REGISTRYMANAGER_ERROR;
+    }
+    /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_004: [ IoTHubRegistryManager_EnumerateDevices shall request every page with an HTTP POST of the query SELECT * FROM devices to url/devices/query?api-version, adding the x-ms-max-item-count header set to pageSize to the headers used by IoTHubRegistryManager_GetDeviceList ] */
+    else if ((httpHeader = createHttpHeader(IOTHUB_REQUEST_GET_DEVICE_LIST)) == NULL)
+    {
+        LogError("HttpHeader creation failed");
+        page->result = IOTHUB_REGISTRYMANAGER_HTTPAPI_ERROR;
+    }
+    else if ((snprintf(pageSizeStr, sizeof(pageSizeStr), "%lu", (unsigned long)page->pageSize) <= 0) ||
+        (HTTPHeaders_AddHeaderNameValuePair(httpHeader, HTTP_HEADER_KEY_MAX_ITEM_COUNT, pageSizeStr) != HTTP_HEADERS_OK))
+    {
+        LogError("HTTPHeaders_AddHeaderNameValuePair failed for x-ms-max-item-count header");
+        page->result = IOTHUB_REGISTRYMANAGER_HTTPAPI_ERROR;
+    }
+    /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_005: [ Every page after the first one shall be requested with the x-ms-continuation header set to the continuation token returned with the previous page ] */
+    else if ((page->continuationToken != NULL) && (HTTPHeaders_AddHeaderNameValuePair(httpHeader, HTTP_HEADER_KEY_CONTINUATION, page->continuationToken) != HTTP_HEADERS_OK))
+    {
+        LogError("HTTPHeaders_AddHeaderNameValuePair failed for x-ms-continuation header");
+        page->result = IOTHUB_REGISTRYMANAGER_HTTPAPI_ERROR;
+    }
+    else if ((responseHeader = HTTPHeaders_Alloc()) == NULL)
+    {
+        LogError("HTTPHeaders_Alloc failed for the response headers");
+        page->result = IOTHUB_REGISTRYMANAGER_HTTPAPI_ERROR;
+    }
+    else if ((queryBuffer = BUFFER_create((const unsigned char*)DEVICE_QUERY_ALL_DEVICES, strlen(DEVICE_QUERY_ALL_DEVICES))) == NULL)
+    {
+        LogError("BUFFER_create failed for the query");
+        page->result = IOTHUB_REGISTRYMANAGER_ERROR;
+    }
+    else if ((httpExApiSasHandle = HTTPAPIEX_SAS_Create(accessKey, uriResource, keyName)) == NULL)
+    {
+        LogError("HTTPAPIEX_SAS_Create failed");
+        page->result = IOTHUB_REGISTRYMANAGER_HTTPAPI_ERROR;
+    }
+    else if ((httpExApiHandle = HTTPAPIEX_Create(registryManagerHandle->hostname)) == NULL)
+    {
+        LogError("HTTPAPIEX_Create failed");
+        page->result = IOTHUB_REGISTRYMANAGER_HTTPAPI_ERROR;
+    }
+    else if (snprintf(relativePath, sizeof(relativePath), RELATIVE_PATH_FMT_DEVICE_QUERY, URL_API_VERSION) <= 0)
+    {
+        LogError("Failure creating relative path");
+        page->result = IOTHUB_REGISTRYMANAGER_ERROR;
+    }
+    else if (HTTPAPIEX_SAS_ExecuteRequest(httpExApiSasHandle, httpExApiHandle, HTTPAPI_REQUEST_POST, relativePath, httpHeader, queryBuffer, &statusCode, responseHeader, page->responseBuffer) != HTTPAPIEX_OK)
+    {
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_010: [ If any of the HTTPAPI calls fails IoTHubRegistryManager_EnumerateDevices shall stop and return IOTHUB_REGISTRYMANAGER_HTTPAPI_ERROR ] */
+        LogError("HTTPAPIEX_SAS_ExecuteRequest failed");
+        page->result = IOTHUB_REGISTRYMANAGER_HTTPAPI_ERROR;
+    }
+    else if (statusCode > 300)
+    {
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_011: [ If the received HTTP status code is greater than 300 IoTHubRegistryManager_EnumerateDevices shall stop and return IOTHUB_REGISTRYMANAGER_HTTP_STATUS_ERROR ] */
+        LogError("Http Failure status code %d.", statusCode);
+        page->result = IOTHUB_REGISTRYMANAGER_HTTP_STATUS_ERROR;
     }
     else
     {
-        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_084: [ If any member of the serviceClientHandle input parameter is NULL IoTHubRegistryManager_Create shall return NULL ] */
-        IOTHUB_SERVICE_CLIENT_AUTH* serviceClientAuth = (IOTHUB_SERVICE_CLIENT_AUTH*)serviceClientHandle;
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_006: [ The enumeration shall end after the first page that comes back without a non-empty x-ms-continuation header ] */
+        const char* continuationToken = HTTPHeaders_FindHeaderValue(responseHeader, HTTP_HEADER_KEY_CONTINUATION);
 
-        if (serviceClientAuth->hostname == NULL)
+        if (page->continuationToken != NULL)
         {
-            LogError("authInfo->hostName input parameter cannot be NULL");
-            result = NULL;
+            free(page->continuationToken);
+            page->continuationToken = NULL;
         }
-        else if (serviceClientAuth->iothubName == NULL)
+
+        if ((continuationToken != NULL) && (*continuationToken != '\0') && (mallocAndStrcpy_s(&page->continuationToken, continuationToken) != 0))
         {
-            LogError("authInfo->iothubName input parameter cannot be NULL");
-            result = NULL;
+            LogError("mallocAndStrcpy_s failed for the continuation token");
+            page->result = IOTHUB_REGISTRYMANAGER_ERROR;
         }
-        else if (serviceClientAuth->iothubSuffix == NULL)
+        else
         {
-            LogError("authInfo->iothubSuffix input parameter cannot be NULL");
-            result = NULL;
+            page->result = IOTHUB_REGISTRYMANAGER_OK;
         }
-        else if ((serviceClientAuth->keyName == NULL) && (serviceClientAuth->deviceId == NULL))
+    }
+
+    HTTPAPIEX_Destroy(httpExApiHandle);
+    HTTPAPIEX_SAS_Destroy(httpExApiSasHandle);
+    BUFFER_delete(queryBuffer);
+    HTTPHeaders_Free(responseHeader);
+    HTTPHeaders_Free(httpHeader);
+    STRING_delete(keyName);
+    STRING_delete(accessKey);
+    STRING_delete(uriResource);
+}
+
+static int fetchDeviceQueryPageThread(void* arg)
+{
+    fetchDeviceQueryPage((DEVICE_QUERY_PAGE*)arg);
+    return 0;
+}
+
+static void parseDeviceQueryJsonObject(JSON_Object* device_object, IOTHUB_DEVICE_EX* deviceInfo)
+{
+    const char* authType = json_object_get_string(device_object, DEVICE_QUERY_JSON_KEY_DEVICE_AUTH_TYPE);
+    const char* connectionState = json_object_get_string(device_object, DEVICE_JSON_KEY_DEVICE_CONNECTIONSTATE);
+    const char* status = json_object_get_string(device_object, DEVICE_JSON_KEY_DEVICE_STATUS);
+    int iotEdge_capable = json_object_dotget_boolean(device_object, DEVICE_JSON_KEY_CAPABILITIES_IOTEDGE);
+
+    /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_008: [ The string members of the IOTHUB_DEVICE_EX shall point into the parsed page and shall only be valid during the callback; members the device query doesn't return, the keys included, shall be NULL ] */
+    memset(deviceInfo, 0, sizeof(IOTHUB_DEVICE_EX));
+    deviceInfo->version = IOTHUB_DEVICE_EX_VERSION_1;
+    deviceInfo->deviceId = json_object_get_string(device_object, DEVICE_JSON_KEY_DEVICE_NAME);
+    deviceInfo->eTag = json_object_get_string(device_object, DEVICE_QUERY_JSON_KEY_DEVICE_ETAG);
+    deviceInfo->statusReason = json_object_get_string(device_object, DEVICE_JSON_KEY_DEVICE_STATUSREASON);
+    deviceInfo->statusUpdatedTime = json_object_get_string(device_object, DEVICE_QUERY_JSON_KEY_DEVICE_STATUSUPDATETIME);
+    deviceInfo->lastActivityTime = json_object_get_string(device_object, DEVICE_JSON_KEY_DEVICE_LASTACTIVITYTIME);
+    deviceInfo->cloudToDeviceMessageCount = (size_t)json_object_get_number(device_object, DEVICE_JSON_KEY_DEVICE_CLOUDTODEVICEMESSAGECOUNT);
+
+    if ((connectionState != NULL) && (strcmp(connectionState, DEVICE_JSON_DEFAULT_VALUE_CONNECTED) == 0))
+    {
+        deviceInfo->connectionState = IOTHUB_DEVICE_CONNECTION_STATE_CONNECTED;
+    }
+    if ((status != NULL) && (strcmp(status, DEVICE_JSON_DEFAULT_VALUE_ENABLED) == 0))
+    {
+        deviceInfo->status = IOTHUB_DEVICE_STATUS_ENABLED;
+    }
+    deviceInfo->iotEdge_capable = (iotEdge_capable != -1) && (iotEdge_capable != 0);
+
+    if (authType == NULL)
+    {
+        deviceInfo->authMethod = IOTHUB_REGISTRYMANAGER_AUTH_UNKNOWN;
+    }
+    else if (strcmp(authType, DEVICE_JSON_KEY_DEVICE_AUTH_SAS) == 0)
+    {
+        deviceInfo->authMethod = IOTHUB_REGISTRYMANAGER_AUTH_SPK;
+    }
+    else if (strcmp(authType, DEVICE_JSON_KEY_DEVICE_AUTH_SELF_SIGNED) == 0)
+    {
+        deviceInfo->primaryKey = json_object_dotget_string(device_object, DEVICE_QUERY_JSON_KEY_DEVICE_PRIMARY_THUMBPRINT);
+        deviceInfo->secondaryKey = json_object_dotget_string(device_object, DEVICE_QUERY_JSON_KEY_DEVICE_SECONDARY_THUMBPRINT);
+        deviceInfo->authMethod = IOTHUB_REGISTRYMANAGER_AUTH_X509_THUMBPRINT;
+    }
+    else if (strcmp(authType, DEVICE_JSON_KEY_DEVICE_AUTH_CERTIFICATE_AUTHORITY) == 0)
+    {
+        deviceInfo->authMethod = IOTHUB_REGISTRYMANAGER_AUTH_X509_CERTIFICATE_AUTHORITY;
+    }
+    else if (strcmp(authType, DEVICE_JSON_KEY_DEVICE_AUTH_NONE) == 0)
+    {
+        deviceInfo->authMethod = IOTHUB_REGISTRYMANAGER_AUTH_NONE;
+    }
+    else
+    {
+        deviceInfo->authMethod = IOTHUB_REGISTRYMANAGER_AUTH_UNKNOWN;
+    }
+}
+
+/*the response isn't zero terminated, terminate it in place instead of copying it*/
+static const char* terminateResponseBuffer(BUFFER_HANDLE responseBuffer)
+{
+    const char* result;
+    size_t responseLength = BUFFER_length(responseBuffer);
+    unsigned char* bufferStr;
+
+    if (BUFFER_enlarge(responseBuffer, 1) != 0)
+    {
+        LogError("BUFFER_enlarge failed");
+        result = NULL;
+    }
+    else if ((bufferStr = BUFFER_u_char(responseBuffer)) == NULL)
+    {
+        LogError("BUFFER_u_char failed");
+        result = NULL;
+    }
+    else
+    {
+        bufferStr[responseLength] = '\0';
+        result = (const char*)bufferStr;
+    }
+
+    return result;
+}
+
+static IOTHUB_REGISTRYMANAGER_RESULT deliverDeviceQueryPage(BUFFER_HANDLE responseBuffer, IOTHUB_REGISTRYMANAGER_DEVICE_CALLBACK deviceCallback, void* context, bool* isStopped)
+{
+    IOTHUB_REGISTRYMANAGER_RESULT result;
+    const char* responseString;
+    JSON_Value* root_value = NULL;
+    JSON_Array* device_array;
+
+    if ((responseString = terminateResponseBuffer(responseBuffer)) == NULL)
+    {
+        result = IOTHUB_REGISTRYMANAGER_ERROR;
+    }
+    else
+    {
+        if ((root_value = json_parse_string(responseString)) == NULL)
         {
-            LogError("authInfo->keyName and authInfo->deviceId input parameter cannot both be NULL");
-            result = NULL;
+            /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_012: [ If a page is not a JSON array of objects IoTHubRegistryManager_EnumerateDevices shall stop and return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
+            LogError("json_parse_string failed");
+            result = IOTHUB_REGISTRYMANAGER_JSON_ERROR;
         }
-        else if (serviceClientAuth->sharedAccessKey == NULL)
+        else if ((device_array = json_value_get_array(root_value)) == NULL)
         {
-            LogError("authInfo->sharedAccessKey input parameter cannot be NULL");
-            result = NULL;
+            LogError("json_value_get_array failed");
+            result = IOTHUB_REGISTRYMANAGER_JSON_ERROR;
         }
         else
         {
-            /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_002: [ IoTHubRegistryManager_Create shall allocate memory for a new registry manager instance ] */
-            result = malloc(sizeof(IOTHUB_REGISTRYMANAGER));
-            if (result == NULL)
-            {
-                /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_003: [ If the allocation failed, IoTHubRegistryManager_Create shall return NULL ] */
-                LogError("Malloc failed for IOTHUB_REGISTRYMANAGER");
-            }
-            else
+            /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_007: [ IoTHubRegistryManager_EnumerateDevices shall call deviceCallback once per device of the page with the same IOTHUB_DEVICE_EX structure, kept on its stack, instead of allocating one per device ] */
+            IOTHUB_DEVICE_EX deviceInfo;
+            size_t array_count = json_array_get_count(device_array);
+            size_t i;
+
+            result = IOTHUB_REGISTRYMANAGER_OK;
+            for (i = 0; i < array_count; i++)
             {
-                memset(result, 0, sizeof(IOTHUB_REGISTRYMANAGER));
+                JSON_Object* device_object;
 
-                /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_004: [ If the allocation successful, IoTHubRegistryManager_Create shall create a IOTHUB_REGISTRYMANAGER_HANDLE from the given IOTHUB_REGISTRYMANAGER_AUTH_HANDLE and return with it ] */
-                /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_085: [ IoTHubRegistryManager_Create shall allocate memory and copy hostName to result->hostName by calling mallocAndStrcpy_s. ] */
-                if (mallocAndStrcpy_s(&result->hostname, serviceClientAuth->hostname) != 0)
-                {
-                    /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_086: [ If the mallocAndStrcpy_s fails, IoTHubRegistryManager_Create shall do clean up and return NULL. ] */
-                    LogError("mallocAndStrcpy_s failed for hostName");
-                    free_registrymanager_handle(result);
-                    result = NULL;
-                }
-                /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_087: [ IoTHubRegistryManager_Create shall allocate memory and copy iothubName to result->iothubName by calling mallocAndStrcpy_s. ] */
-                else if (mallocAndStrcpy_s(&result->iothubName, serviceClientAuth->iothubName) != 0)
-                {
-                    /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_088: [ If the mallocAndStrcpy_s fails, IoTHubRegistryManager_Create shall do clean up and return NULL. ] */
-                    LogError("mallocAndStrcpy_s failed for iothubName");
-                    free_registrymanager_handle(result);
-                    result = NULL;
-                }
-                /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_089: [ IoTHubRegistryManager_Create shall allocate memory and copy iothubSuffix to result->iothubSuffix by calling mallocAndStrcpy_s. ] */
-                else if (mallocAndStrcpy_s(&result->iothubSuffix, serviceClientAuth->iothubSuffix) != 0)
-                {
-                    /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_090: [ If the mallocAndStrcpy_s fails, IoTHubRegistryManager_Create shall do clean up and return NULL. ] */
-                    LogError("mallocAndStrcpy_s failed for iothubSuffix");
-                    free_registrymanager_handle(result);
-                    result = NULL;
-                }
-                /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_091: [ IoTHubRegistryManager_Create shall allocate memory and copy sharedAccessKey to result->sharedAccessKey by calling mallocAndStrcpy_s. ] */
-                else if (mallocAndStrcpy_s(&result->sharedAccessKey, serviceClientAuth->sharedAccessKey) != 0)
-                {
-                    /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_092: [ If the mallocAndStrcpy_s fails, IoTHubRegistryManager_Create shall do clean up and return NULL. ] */
-                    LogError("mallocAndStrcpy_s failed for sharedAccessKey");
-                    free_registrymanager_handle(result);
-                    result = NULL;
-                }
-                /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_093: [ IoTHubRegistryManager_Create shall allocate memory and copy keyName to result->keyName by calling mallocAndStrcpy_s. ] */
-                else if ((serviceClientAuth->keyName != NULL) && (mallocAndStrcpy_s(&result->keyName, serviceClientAuth->keyName) != 0))
+                if ((device_object = json_array_get_object(device_array, i)) == NULL)
                 {
-                    /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_094: [ If the mallocAndStrcpy_s fails, IoTHubRegistryManager_Create shall do clean up and return NULL. ] */
-                    LogError("mallocAndStrcpy_s failed for keyName");
-                    free_registrymanager_handle(result);
-                    result = NULL;
+                    LogError("json_array_get_object failed");
+                    result = IOTHUB_REGISTRYMANAGER_JSON_ERROR;
+                    break;
                 }
-                else if ((serviceClientAuth->deviceId != NULL) && (mallocAndStrcpy_s(&result->deviceId, serviceClientAuth->deviceId) != 0))
+
+                parseDeviceQueryJsonObject(device_object, &deviceInfo);
+                if (!deviceCallback(context, &deviceInfo))
                 {
-                    /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_094: [ If the mallocAndStrcpy_s fails, IoTHubRegistryManager_Create shall do clean up and return NULL. ] */
-                    LogError("mallocAndStrcpy_s failed for deviceId");
-                    free_registrymanager_handle(result);
-                    result = NULL;
+                    /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_009: [ If deviceCallback returns false IoTHubRegistryManager_EnumerateDevices shall not call it again, shall not request any further page and shall return IOTHUB_REGISTRYMANAGER_OK ] */
+                    *isStopped = true;
+                    break;
                 }
             }
         }
     }
+
+    if (root_value != NULL)
+    {
+        json_value_free(root_value);
+    }
+
     return result;
 }
 
-void IoTHubRegistryManager_Destroy(IOTHUB_REGISTRYMANAGER_HANDLE registryManagerHandle)
+typedef struct DEVICE_BULK_CREATE_WORKER_TAG
 {
-    /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_005: [ If the registryManagerHandle input parameter is NULL IoTHubRegistryManager_Destroy shall return ] */
-    if (registryManagerHandle != NULL)
-    {
-        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_006 : [ If the registryManagerHandle input parameter is not NULL IoTHubRegistryManager_Destroy shall free the memory of it and return ] */
-        IOTHUB_REGISTRYMANAGER* regManHandle = (IOTHUB_REGISTRYMANAGER*)registryManagerHandle;
+    IOTHUB_REGISTRYMANAGER_HANDLE registryManagerHandle;
+    const IOTHUB_REGISTRY_DEVICE_CREATE_EX* deviceCreateInfo;
+    IOTHUB_REGISTRYMANAGER_RESULT* deviceResults;
+    size_t deviceCount;
+    size_t firstBatch;
+    size_t batchStride;
+} DEVICE_BULK_CREATE_WORKER;
+
+/*devices that failed the validation already carry their result, only the ones still IOTHUB_REGISTRYMANAGER_OK are sent*/
+static bool hasBulkCreatePendingDevice(const DEVICE_BULK_CREATE_WORKER* worker, size_t first, size_t last)
+{
+    bool result = false;
+    size_t i;
 
-        free(regManHandle->hostname);
-        free(regManHandle->iothubName);
-        free(regManHandle->iothubSuffix);
-        free(regManHandle->sharedAccessKey);
-        free(regManHandle->keyName);
-        free(regManHandle->deviceId);
-        free(regManHandle);
+    for (i = first; i < last; i++)
+    {
+        if (worker->deviceResults[i] == IOTHUB_REGISTRYMANAGER_OK)
+        {
+            result = true;
+            break;
+        }
     }
+
+    return result;
 }
 
-static IOTHUB_REGISTRYMANAGER_RESULT IoTHubRegistryManager_CreateDeviceOrModule(IOTHUB_REGISTRYMANAGER_HANDLE registryManagerHandle, const IOTHUB_REGISTRY_DEVICE_OR_MODULE_CREATE* deviceOrModuleCreateInfo, IOTHUB_DEVICE_OR_MODULE* deviceOrModuleInfo)
+static void setBulkCreateBatchResult(DEVICE_BULK_CREATE_WORKER* worker, size_t first, size_t last, IOTHUB_REGISTRYMANAGER_RESULT batchResult)
 {
-    IOTHUB_REGISTRYMANAGER_RESULT result;
+    size_t i;
+
+    for (i = first; i < last; i++)
+    {
+        if (worker->deviceResults[i] == IOTHUB_REGISTRYMANAGER_OK)
+        {
+            worker->deviceResults[i] = batchResult;
+        }
+    }
+}
+
+static JSON_Value* constructBulkCreateDeviceJson(const IOTHUB_REGISTRY_DEVICE_CREATE_EX* deviceCreateInfo)
+{
+    JSON_Value* result;
+    JSON_Object* device_object;
+    const char* primaryKeyName = NULL;
+    const char* secondaryKeyName = NULL;
+
+    if (deviceCreateInfo->authMethod == IOTHUB_REGISTRYMANAGER_AUTH_SPK)
+    {
+        primaryKeyName = DEVICE_JSON_KEY_DEVICE_PRIMARY_KEY;
+        secondaryKeyName = DEVICE_JSON_KEY_DEVICE_SECONDARY_KEY;
+    }
+    else if (deviceCreateInfo->authMethod == IOTHUB_REGISTRYMANAGER_AUTH_X509_THUMBPRINT)
+    {
+        primaryKeyName = DEVICE_JSON_KEY_DEVICE_PRIMARY_THUMBPRINT;
+        secondaryKeyName = DEVICE_JSON_KEY_DEVICE_SECONDARY_THUMBPRINT;
+    }
+
+    /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_020: [ Every device of a batch shall be sent as an object with "id", "importMode" set to "create", "status" set to "enabled", "authentication.type", the keys or thumbprints that are not NULL and "capabilities.iotEdge" ] */
+    if ((result = json_value_init_object()) == NULL)
+    {
+        LogError("json_value_init_object failed");
+    }
+    else if ((device_object = json_value_get_object(result)) == NULL)
+    {
+        LogError("json_value_get_object failed");
+        json_value_free(result);
+        result = NULL;
+    }
+    else if ((json_object_set_string(device_object, DEVICE_BULK_JSON_KEY_DEVICE_ID, deviceCreateInfo->deviceId) != JSONSuccess) ||
+        (json_object_set_string(device_object, DEVICE_BULK_JSON_KEY_IMPORT_MODE, DEVICE_BULK_JSON_VALUE_IMPORT_MODE_CREATE) != JSONSuccess) ||
+        (json_object_set_string(device_object, DEVICE_JSON_KEY_DEVICE_STATUS, DEVICE_JSON_DEFAULT_VALUE_ENABLED) != JSONSuccess))
+    {
+        LogError("json_object_set_string failed for device %s", deviceCreateInfo->deviceId);
+        json_value_free(result);
+        result = NULL;
+    }
+    else if ((json_object_dotset_string(device_object, DEVICE_JSON_KEY_DEVICE_AUTH_TYPE, getAuthTypeStringForJson(deviceCreateInfo->authMethod)) != JSONSuccess) ||
+        ((primaryKeyName != NULL) && (deviceCreateInfo->primaryKey != NULL) && (json_object_dotset_string(device_object, primaryKeyName, deviceCreateInfo->primaryKey) != JSONSuccess)) ||
+        ((secondaryKeyName != NULL) && (deviceCreateInfo->secondaryKey != NULL) && (json_object_dotset_string(device_object, secondaryKeyName, deviceCreateInfo->secondaryKey) != JSONSuccess)))
+    {
+        LogError("json_object_dotset_string failed for the authentication of device %s", deviceCreateInfo->deviceId);
+        json_value_free(result);
+        result = NULL;
+    }
+    else if (json_object_dotset_boolean(device_object, DEVICE_JSON_KEY_CAPABILITIES_IOTEDGE, (deviceCreateInfo->iotEdge_capable == true) ? 1 : 0) != JSONSuccess)
+    {
+        LogError("json_object_dotset_boolean failed for iotEdge capable");
+        json_value_free(result);
+        result = NULL;
+    }
+
+    return result;
+}
+
+static BUFFER_HANDLE constructBulkCreateJson(const DEVICE_BULK_CREATE_WORKER* worker, size_t first, size_t last)
+{
+    BUFFER_HANDLE result = NULL;
+    JSON_Value* root_value;
+    JSON_Array* root_array;
+
+    /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_019: [ The body of every bulk request shall be a JSON array built with json_value_init_array and json_array_append_value ] */
+    if ((root_value = json_value_init_array()) == NULL)
+    {
+        LogError("json_value_init_array failed");
+    }
+    else
+    {
+        bool isFailed = false;
+
+        if ((root_array = json_value_get_array(root_value)) == NULL)
+        {
+            LogError("json_value_get_array failed");
+            isFailed = true;
+        }
+        else
+        {
+            size_t i;
+            for (i = first; i < last; i++)
+            {
+                JSON_Value* device_value;
+
+                if (worker->deviceResults[i] != IOTHUB_REGISTRYMANAGER_OK)
+                {
+                    continue;
+                }
+
+                if ((device_value = constructBulkCreateDeviceJson(&worker->deviceCreateInfo[i])) == NULL)
+                {
+                    isFailed = true;
+                    break;
+                }
+                else if (json_array_append_value(root_array, device_value) != JSONSuccess)
+                {
+                    LogError("json_array_append_value failed");
+                    json_value_free(device_value);
+                    isFailed = true;
+                    break;
+                }
+            }
+        }
+
+        if (!isFailed)
+        {
+            char* serialized_string;
+            if ((serialized_string = json_serialize_to_string(root_value)) == NULL)
+            {
+                LogError("json_serialize_to_string failed");
+            }
+            else
+            {
+                if ((result = BUFFER_create((const unsigned char*)serialized_string, strlen(serialized_string))) == NULL)
+                {
+                    LogError("BUFFER_create failed");
+                }
+                json_free_serialized_string(serialized_string);
+            }
+        }
+
+        json_value_free(root_value);
+    }
+
+    return result;
+}
+
+static void parseBulkCreateResponse(DEVICE_BULK_CREATE_WORKER* worker, size_t first, size_t last, BUFFER_HANDLE responseBuffer, unsigned int statusCode)
+{
+    const char* responseString;
+    JSON_Value* root_value = NULL;
+    JSON_Object* root_object;
+    JSON_Array* error_array = NULL;
+    size_t errorCount = 0;
+
+    if (((responseString = terminateResponseBuffer(responseBuffer)) != NULL) &&
+        ((root_value = json_parse_string(responseString)) != NULL) &&
+        ((root_object = json_value_get_object(root_value)) != NULL) &&
+        ((error_array = json_object_get_array(root_object, DEVICE_BULK_JSON_KEY_ERRORS)) != NULL))
+    {
+        errorCount = json_array_get_count(error_array);
+    }
+
+    if ((statusCode > 300) && (errorCount == 0))
+    {
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_024: [ If the HTTP status code of a batch is greater than 300 and its response has no "errors", every device of the batch shall get IOTHUB_REGISTRYMANAGER_HTTP_STATUS_ERROR ] */
+        LogError("Http Failure status code %d.", statusCode);
+        setBulkCreateBatchResult(worker, first, last, IOTHUB_REGISTRYMANAGER_HTTP_STATUS_ERROR);
+    }
+    else
+    {
+        size_t errorIndex;
+
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_022: [ Every entry of the "errors" array of the response shall set the result of the device of the batch with the same deviceId, to IOTHUB_REGISTRYMANAGER_DEVICE_EXIST for the "DeviceAlreadyExists" errorCode and to IOTHUB_REGISTRYMANAGER_ERROR otherwise ] */
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_023: [ The devices of a batch without an entry in "errors" shall keep IOTHUB_REGISTRYMANAGER_OK ] */
+        for (errorIndex = 0; errorIndex < errorCount; errorIndex++)
+        {
+            JSON_Object* error_object = json_array_get_object(error_array, errorIndex);
+            const char* deviceId = (error_object == NULL) ? NULL : json_object_get_string(error_object, DEVICE_JSON_KEY_DEVICE_NAME);
+
+            if (deviceId != NULL)
+            {
+                const char* errorCode = json_object_get_string(error_object, DEVICE_BULK_JSON_KEY_ERROR_CODE);
+                size_t i;
+
+                for (i = first; i < last; i++)
+                {
+                    if ((worker->deviceResults[i] == IOTHUB_REGISTRYMANAGER_OK) && (strcmp(worker->deviceCreateInfo[i].deviceId, deviceId) == 0))
+                    {
+                        LogError("Device %s could not be created: %s", deviceId, (errorCode == NULL) ? "unknown error" : errorCode);
+                        worker->deviceResults[i] = ((errorCode != NULL) && (strcmp(errorCode, DEVICE_BULK_JSON_VALUE_DEVICE_ALREADY_EXISTS) == 0)) ? IOTHUB_REGISTRYMANAGER_DEVICE_EXIST : IOTHUB_REGISTRYMANAGER_ERROR;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    if (root_value != NULL)
+    {
+        json_value_free(root_value);
+    }
+}
+
+/*sends the batches firstBatch, firstBatch + batchStride, ... one after the other over the same HTTPAPIEX handle, which keeps its connection open between the requests*/
+static int bulkCreateDevicesWorker(void* arg)
+{
+    DEVICE_BULK_CREATE_WORKER* worker = (DEVICE_BULK_CREATE_WORKER*)arg;
+    IOTHUB_REGISTRYMANAGER_HANDLE registryManagerHandle = worker->registryManagerHandle;
+    IOTHUB_REGISTRYMANAGER_RESULT connectionResult;
+    STRING_HANDLE uriResource = NULL;
+    STRING_HANDLE accessKey = NULL;
+    STRING_HANDLE keyName = NULL;
+    HTTPAPIEX_SAS_HANDLE httpExApiSasHandle = NULL;
+    HTTPAPIEX_HANDLE httpExApiHandle = NULL;
+    HTTP_HEADERS_HANDLE httpHeader = NULL;
+    BUFFER_HANDLE responseBuffer = NULL;
+    char relativePath[256];
+    size_t batch;
+
+    /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_021: [ Every worker shall create its HTTP headers, response buffer, HTTPAPIEX_SAS_HANDLE and HTTPAPIEX_HANDLE once and reuse them for all its batches ] */
+    if ((uriResource = createUriPath(registryManagerHandle)) == NULL)
+    {
+        LogError("STRING_construct failed for uriResource");
+        connectionResult = IOTHUB_REGISTRYMANAGER_ERROR;
+    }
+    else if ((accessKey = STRING_construct(registryManagerHandle->sharedAccessKey)) == NULL)
+    {
+        LogError("STRING_construct failed for accessKey");
+        connectionResult = IOTHUB_REGISTRYMANAGER_ERROR;
+    }
+    else if ((registryManagerHandle->keyName != NULL) && ((keyName = STRING_construct(registryManagerHandle->keyName)) == NULL))
+    {
+        LogError("STRING_construct failed for keyName");
+        connectionResult = IOTHUB_REGISTRYMANAGER_ERROR;
+    }
+    else if ((httpHeader = createHttpHeader(IOTHUB_REQUEST_CREATE)) == NULL)
+    {
+        LogError("HttpHeader creation failed");
+        connectionResult = IOTHUB_REGISTRYMANAGER_HTTPAPI_ERROR;
+    }
+    else if ((responseBuffer = BUFFER_new()) == NULL)
+    {
+        LogError("BUFFER_new failed for responseBuffer");
+        connectionResult = IOTHUB_REGISTRYMANAGER_ERROR;
+    }
+    else if ((httpExApiSasHandle = HTTPAPIEX_SAS_Create(accessKey, uriResource, keyName)) == NULL)
+    {
+        LogError("HTTPAPIEX_SAS_Create failed");
+        connectionResult = IOTHUB_REGISTRYMANAGER_HTTPAPI_ERROR;
+    }
+    else if ((httpExApiHandle = HTTPAPIEX_Create(registryManagerHandle->hostname)) == NULL)
+    {
+        LogError("HTTPAPIEX_Create failed");
+        connectionResult = IOTHUB_REGISTRYMANAGER_HTTPAPI_ERROR;
+    }
+    else if (snprintf(relativePath, sizeof(relativePath), RELATIVE_PATH_FMT_BULK, URL_API_VERSION) <= 0)
+    {
+        LogError("Failure creating relative path");
+        connectionResult = IOTHUB_REGISTRYMANAGER_ERROR;
+    }
+    else
+    {
+        connectionResult = IOTHUB_REGISTRYMANAGER_OK;
+    }
+
+    for (batch = worker->firstBatch; batch < (worker->deviceCount + IOTHUB_DEVICES_MAX_BULK_REQUEST - 1) / IOTHUB_DEVICES_MAX_BULK_REQUEST; batch += worker->batchStride)
+    {
+        size_t first = batch * IOTHUB_DEVICES_MAX_BULK_REQUEST;
+        size_t last = (worker->deviceCount - first < IOTHUB_DEVICES_MAX_BULK_REQUEST) ? worker->deviceCount : first + IOTHUB_DEVICES_MAX_BULK_REQUEST;
+        BUFFER_HANDLE bulkJsonBuffer;
+        unsigned int statusCode;
+
+        if (!hasBulkCreatePendingDevice(worker, first, last))
+        {
+            continue;
+        }
+
+        if (connectionResult != IOTHUB_REGISTRYMANAGER_OK)
+        {
+            setBulkCreateBatchResult(worker, first, last, connectionResult);
+        }
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_027: [ If the JSON of a batch cannot be created every device of the batch shall get IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
+        else if ((bulkJsonBuffer = constructBulkCreateJson(worker, first, last)) == NULL)
+        {
+            setBulkCreateBatchResult(worker, first, last, IOTHUB_REGISTRYMANAGER_JSON_ERROR);
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_018: [ IoTHubRegistryManager_BulkCreateDevices shall send the devices in batches of up to 100 with an HTTP POST to url/devices?api-version, using the headers used by IoTHubRegistryManager_CreateDevice ] */
+            if (HTTPAPIEX_SAS_ExecuteRequest(httpExApiSasHandle, httpExApiHandle, HTTPAPI_REQUEST_POST, relativePath, httpHeader, bulkJsonBuffer, &statusCode, NULL, responseBuffer) != HTTPAPIEX_OK)
+            {
+                /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_025: [ If the HTTPAPI calls of a batch fail every device of the batch shall get IOTHUB_REGISTRYMANAGER_HTTPAPI_ERROR ] */
+                LogError("HTTPAPIEX_SAS_ExecuteRequest failed");
+                setBulkCreateBatchResult(worker, first, last, IOTHUB_REGISTRYMANAGER_HTTPAPI_ERROR);
+            }
+            else
+            {
+                parseBulkCreateResponse(worker, first, last, responseBuffer, statusCode);
+            }
+            BUFFER_delete(bulkJsonBuffer);
+        }
+    }
+
+    HTTPAPIEX_Destroy(httpExApiHandle);
+    HTTPAPIEX_SAS_Destroy(httpExApiSasHandle);
+    BUFFER_delete(responseBuffer);
+    HTTPHeaders_Free(httpHeader);
+    STRING_delete(keyName);
+    STRING_delete(accessKey);
+    STRING_delete(uriResource);
+    return 0;
+}
+
+/** @brief A cached GET response: the JSON of a device, or NULL if the device doesn't exist, or the JSON of the statistics
+*/
+typedef struct REGISTRY_CACHE_ENTRY_TAG
+{
+    struct REGISTRY_CACHE_ENTRY_TAG* next;
+    char* deviceId;     /*NULL for the statistics, otherwise in the same allocation as the entry*/
+    BUFFER_HANDLE response;
+    char* ifNoneMatch;  /*the quoted etag of the device, NULL if it has none*/
+    time_t fetchTime;
+} REGISTRY_CACHE_ENTRY;
+
+/** @brief Read-through cache of IoTHubRegistryManager_GetDevice(_Ex) and IoTHubRegistryManager_GetStatistics, created by IoTHubRegistryManager_SetCache
+*/
+typedef struct IOTHUB_REGISTRY_CACHE_TAG
+{
+    LOCK_HANDLE lock;
+    unsigned int timeToLiveInSeconds;
+    size_t maxDeviceCount;
+    size_t deviceCount;
+    REGISTRY_CACHE_ENTRY* devices;      /*most recently used first*/
+    REGISTRY_CACHE_ENTRY* statistics;
+    unsigned int generation;            /*changed by every invalidation, a response fetched across one is not cached*/
+} IOTHUB_REGISTRY_CACHE;
+
+static REGISTRY_CACHE_ENTRY* createCacheEntry(const char* deviceId, BUFFER_HANDLE response, const char* eTag, time_t fetchTime)
+{
+    size_t deviceIdSize = (deviceId == NULL) ? 0 : strlen(deviceId) + 1;
+    REGISTRY_CACHE_ENTRY* result;
+
+    if ((result = (REGISTRY_CACHE_ENTRY*)malloc(sizeof(REGISTRY_CACHE_ENTRY) + deviceIdSize)) == NULL)
+    {
+        LogError("malloc failed for REGISTRY_CACHE_ENTRY");
+    }
+    else
+    {
+        result->next = NULL;
+        result->response = response;
+        result->fetchTime = fetchTime;
+        result->ifNoneMatch = NULL;
+
+        if (deviceId == NULL)
+        {
+            result->deviceId = NULL;
+        }
+        else
+        {
+            result->deviceId = (char*)(result + 1);
+            (void)memcpy(result->deviceId, deviceId, deviceIdSize);
+        }
+
+        if ((eTag != NULL) && ((result->ifNoneMatch = (char*)malloc(strlen(eTag) + 3)) != NULL))
+        {
+            (void)sprintf(result->ifNoneMatch, "\"%s\"", eTag);
+        }
+    }
+    return result;
+}
+
+static void freeCacheEntry(REGISTRY_CACHE_ENTRY* entry)
+{
+    if (entry->response != NULL)
+    {
+        BUFFER_delete(entry->response);
+    }
+    free(entry->ifNoneMatch);
+    free(entry);
+}
+
+/*the functions below must be called with the cache lock held*/
+static REGISTRY_CACHE_ENTRY* takeCachedDevice(IOTHUB_REGISTRY_CACHE* cache, const char* deviceId)
+{
+    REGISTRY_CACHE_ENTRY** link = &cache->devices;
+
+    while ((*link != NULL) && (strcmp((*link)->deviceId, deviceId) != 0))
+    {
+        link = &(*link)->next;
+    }
+
+    REGISTRY_CACHE_ENTRY* result = *link;
+    if (result != NULL)
+    {
+        *link = result->next;
+        result->next = NULL;
+        cache->deviceCount--;
+    }
+    return result;
+}
+
+static void trimCachedDevices(IOTHUB_REGISTRY_CACHE* cache, size_t maxDeviceCount)
+{
+    REGISTRY_CACHE_ENTRY** link = &cache->devices;
+    size_t kept = 0;
+
+    while ((*link != NULL) && (kept < maxDeviceCount))
+    {
+        link = &(*link)->next;
+        kept++;
+    }
+
+    while (*link != NULL)
+    {
+        REGISTRY_CACHE_ENTRY* entry = *link;
+        *link = entry->next;
+        freeCacheEntry(entry);
+        cache->deviceCount--;
+    }
+}
+
+static void storeCachedDevice(IOTHUB_REGISTRY_CACHE* cache, REGISTRY_CACHE_ENTRY* entry)
+{
+    REGISTRY_CACHE_ENTRY* replaced = takeCachedDevice(cache, entry->deviceId);
+    if (replaced != NULL)
+    {
+        freeCacheEntry(replaced);
+    }
+
+    entry->next = cache->devices;
+    cache->devices = entry;
+    cache->deviceCount++;
+    trimCachedDevices(cache, cache->maxDeviceCount);
+}
+
+static bool isCacheEntryFresh(const IOTHUB_REGISTRY_CACHE* cache, const REGISTRY_CACHE_ENTRY* entry, time_t now)
+{
+    double age = difftime(now, entry->fetchTime);
+    return (age >= 0) && (age < (double)cache->timeToLiveInSeconds);
+}
+
+static void destroyRegistryCache(IOTHUB_REGISTRY_CACHE* cache)
+{
+    trimCachedDevices(cache, 0);
+    if (cache->statistics != NULL)
+    {
+        freeCacheEntry(cache->statistics);
+    }
+    (void)Lock_Deinit(cache->lock);
+    free(cache);
+}
+
+/*drops what a change made through the handle makes stale: the device, or every device if deviceId is NULL, and the statistics*/
+static void invalidateRegistryCache(IOTHUB_REGISTRYMANAGER_HANDLE registryManagerHandle, const char* deviceId)
+{
+    IOTHUB_REGISTRY_CACHE* cache = registryManagerHandle->cache;
+
+    if (cache != NULL)
+    {
+        if (Lock(cache->lock) != LOCK_OK)
+        {
+            LogError("Lock failed, the registry cache may keep stale entries");
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_044: [ IoTHubRegistryManager_CreateDevice(_Ex), IoTHubRegistryManager_UpdateDevice(_Ex) and IoTHubRegistryManager_DeleteDevice shall drop the cached device and statistics, IoTHubRegistryManager_BulkCreateDevices every cached entry, and a response fetched before the drop shall not be cached ] */
+            if (deviceId == NULL)
+            {
+                trimCachedDevices(cache, 0);
+            }
+            else
+            {
+                REGISTRY_CACHE_ENTRY* entry = takeCachedDevice(cache, deviceId);
+                if (entry != NULL)
+                {
+                    freeCacheEntry(entry);
+                }
+            }
+
+            if (cache->statistics != NULL)
+            {
+                freeCacheEntry(cache->statistics);
+                cache->statistics = NULL;
+            }
+            cache->generation++;
+            (void)Unlock(cache->lock);
+        }
+    }
+}
+
+static IOTHUB_REGISTRYMANAGER_RESULT getDeviceThroughCache(IOTHUB_REGISTRYMANAGER_HANDLE registryManagerHandle, const char* deviceId, IOTHUB_DEVICE_OR_MODULE* deviceOrModuleInfo)
+{
+    IOTHUB_REGISTRYMANAGER_RESULT result;
+    IOTHUB_REGISTRY_CACHE* cache = registryManagerHandle->cache;
+    REGISTRY_CACHE_ENTRY* staleEntry = NULL;
+    time_t now = get_time(NULL);
+    unsigned int generation = 0;
+    bool fetch = true;
+
+    initializeDeviceOrModuleInfoMembers(deviceOrModuleInfo);
+
+    if (Lock(cache->lock) != LOCK_OK)
+    {
+        LogError("Lock failed");
+        result = IOTHUB_REGISTRYMANAGER_ERROR;
+        fetch = false;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_045: [ If get_time fails the cache shall be neither read nor updated ] */
+        REGISTRY_CACHE_ENTRY* entry = (now == (time_t)(-1)) ? NULL : takeCachedDevice(cache, deviceId);
+
+        generation = cache->generation;
+        result = IOTHUB_REGISTRYMANAGER_OK;
+
+        if (entry == NULL)
+        {
+            /*cache miss*/
+        }
+        else if (isCacheEntryFresh(cache, entry, now))
+        {
+            /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_039: [ If the cached device is younger than the time to live it shall be parsed from the cached response without any HTTP request, and a device cached as not existing shall return IOTHUB_REGISTRYMANAGER_DEVICE_NOT_EXIST ] */
+            result = (entry->response == NULL) ? IOTHUB_REGISTRYMANAGER_DEVICE_NOT_EXIST : parseDeviceOrModuleJson(entry->response, deviceOrModuleInfo);
+            if ((result == IOTHUB_REGISTRYMANAGER_OK) && (deviceOrModuleInfo->deviceId == NULL))
+            {
+                free_deviceOrModule_members(deviceOrModuleInfo);
+                result = IOTHUB_REGISTRYMANAGER_DEVICE_NOT_EXIST;
+            }
+            storeCachedDevice(cache, entry);
+            fetch = false;
+        }
+        else if (entry->ifNoneMatch != NULL)
+        {
+            /*kept out of the cache until it is revalidated*/
+            staleEntry = entry;
+        }
+        else
+        {
+            freeCacheEntry(entry);
+        }
+        (void)Unlock(cache->lock);
+    }
+
+    if (fetch)
+    {
+        BUFFER_HANDLE responseBuffer;
+        bool notModified = false;
+
+        if ((responseBuffer = BUFFER_new()) == NULL)
+        {
+            LogError("BUFFER_new failed for responseBuffer");
+            result = IOTHUB_REGISTRYMANAGER_ERROR;
+        }
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_040: [ Otherwise the device shall be requested as without the cache, and the response of a device found or not existing shall be cached with the time returned by get_time, dropping the least recently used device above maxDeviceCount ] */
+        else if (((result = sendConditionalHttpRequest(registryManagerHandle, IOTHUB_REQUEST_GET, deviceId, NULL, NULL, 0, (staleEntry == NULL) ? NULL : staleEntry->ifNoneMatch, &notModified, responseBuffer)) == IOTHUB_REGISTRYMANAGER_OK) && notModified)
+        {
+            BUFFER_delete(responseBuffer);
+            responseBuffer = NULL;
+            staleEntry->fetchTime = now;
+            result = parseDeviceOrModuleJson(staleEntry->response, deviceOrModuleInfo);
+        }
+        else if (result == IOTHUB_REGISTRYMANAGER_OK)
+        {
+            result = parseDeviceOrModuleJson(responseBuffer, deviceOrModuleInfo);
+            if (staleEntry != NULL)
+            {
+                freeCacheEntry(staleEntry);
+                staleEntry = NULL;
+            }
+        }
+        else if (staleEntry != NULL)
+        {
+            freeCacheEntry(staleEntry);
+            staleEntry = NULL;
+        }
+
+        if ((result == IOTHUB_REGISTRYMANAGER_OK) && (deviceOrModuleInfo->deviceId == NULL))
+        {
+            free_deviceOrModule_members(deviceOrModuleInfo);
+            result = IOTHUB_REGISTRYMANAGER_DEVICE_NOT_EXIST;
+        }
+
+        if (((result == IOTHUB_REGISTRYMANAGER_OK) || (result == IOTHUB_REGISTRYMANAGER_DEVICE_NOT_EXIST)) && (now != (time_t)(-1)))
+        {
+            REGISTRY_CACHE_ENTRY* entry = staleEntry;
+
+            if (entry == NULL)
+            {
+                if ((entry = createCacheEntry(deviceId, (result == IOTHUB_REGISTRYMANAGER_OK) ? responseBuffer : NULL, (result == IOTHUB_REGISTRYMANAGER_OK) ? deviceOrModuleInfo->eTag : NULL, now)) != NULL)
+                {
+                    if (result == IOTHUB_REGISTRYMANAGER_OK)
+                    {
+                        /*now owned by the entry*/
+                        responseBuffer = NULL;
+                    }
+                }
+            }
+            staleEntry = NULL;
+
+            if (entry == NULL)
+            {
+                /*not cached, nothing else to do*/
+            }
+            else if (Lock(cache->lock) != LOCK_OK)
+            {
+                LogError("Lock failed, the device is not cached");
+                freeCacheEntry(entry);
+            }
+            else
+            {
+                if ((cache->generation != generation) || (cache->timeToLiveInSeconds == 0) || (cache->maxDeviceCount == 0))
+                {
+                    freeCacheEntry(entry);
+                }
+                else
+                {
+                    storeCachedDevice(cache, entry);
+                }
+                (void)Unlock(cache->lock);
+            }
+        }
+
+        if (staleEntry != NULL)
+        {
+            freeCacheEntry(staleEntry);
+        }
+        if (responseBuffer != NULL)
+        {
+            BUFFER_delete(responseBuffer);
+        }
+    }
+
+    return result;
+}
+
+static IOTHUB_REGISTRYMANAGER_RESULT getStatisticsThroughCache(IOTHUB_REGISTRYMANAGER_HANDLE registryManagerHandle, IOTHUB_REGISTRY_STATISTICS* registryStatistics)
+{
+    IOTHUB_REGISTRYMANAGER_RESULT result;
+    IOTHUB_REGISTRY_CACHE* cache = registryManagerHandle->cache;
+    time_t now = get_time(NULL);
+    unsigned int generation = 0;
+    bool fetch = true;
+
+    if (Lock(cache->lock) != LOCK_OK)
+    {
+        LogError("Lock failed");
+        result = IOTHUB_REGISTRYMANAGER_ERROR;
+        fetch = false;
+    }
+    else
+    {
+        generation = cache->generation;
+        result = IOTHUB_REGISTRYMANAGER_OK;
+
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_041: [ While the cache is enabled IoTHubRegistryManager_GetStatistics shall be served from a single cached entry the same way, without revalidation since the statistics have no etag ] */
+        if ((now != (time_t)(-1)) && (cache->statistics != NULL) && isCacheEntryFresh(cache, cache->statistics, now))
+        {
+            result = parseStatisticsJson(cache->statistics->response, registryStatistics);
+            fetch = false;
+        }
+        (void)Unlock(cache->lock);
+    }
+
+    if (fetch)
+    {
+        BUFFER_HANDLE responseBuffer;
+
+        if ((responseBuffer = BUFFER_new()) == NULL)
+        {
+            LogError("BUFFER_new failed for responseBuffer");
+            result = IOTHUB_REGISTRYMANAGER_ERROR;
+        }
+        else
+        {
+            if (((result = sendHttpRequestCRUD(registryManagerHandle, IOTHUB_REQUEST_GET_STATISTICS, NULL, NULL, NULL, 0, responseBuffer)) == IOTHUB_REGISTRYMANAGER_OK) &&
+                ((result = parseStatisticsJson(responseBuffer, registryStatistics)) == IOTHUB_REGISTRYMANAGER_OK) &&
+                (now != (time_t)(-1)))
+            {
+                REGISTRY_CACHE_ENTRY* entry;
+
+                if ((entry = createCacheEntry(NULL, responseBuffer, NULL, now)) == NULL)
+                {
+                    /*not cached*/
+                }
+                else
+                {
+                    responseBuffer = NULL;
+
+                    if (Lock(cache->lock) != LOCK_OK)
+                    {
+                        LogError("Lock failed, the statistics are not cached");
+                        freeCacheEntry(entry);
+                    }
+                    else
+                    {
+                        if ((cache->generation != generation) || (cache->timeToLiveInSeconds == 0))
+                        {
+                            freeCacheEntry(entry);
+                        }
+                        else
+                        {
+                            if (cache->statistics != NULL)
+                            {
+                                freeCacheEntry(cache->statistics);
+                            }
+                            cache->statistics = entry;
+                        }
+                        (void)Unlock(cache->lock);
+                    }
+                }
+            }
+
+            if (responseBuffer != NULL)
+            {
+                BUFFER_delete(responseBuffer);
+            }
+        }
+    }
+
+    return result;
+}
+
+static void free_registrymanager_handle(IOTHUB_REGISTRYMANAGER *registryManager)
+{
+    free(registryManager->hostname);
+    free(registryManager->iothubName);
+    free(registryManager->iothubSuffix);
+    free(registryManager->sharedAccessKey);
+    free(registryManager->keyName);
+    free(registryManager->deviceId);
+    free(registryManager);
+}
+
+IOTHUB_REGISTRYMANAGER_HANDLE IoTHubRegistryManager_Create(IOTHUB_SERVICE_CLIENT_AUTH_HANDLE serviceClientHandle)
+{
+    IOTHUB_REGISTRYMANAGER_HANDLE result;
+
+    /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_001: [ If the serviceClientHandle input parameter is NULL IoTHubRegistryManager_Create shall return NULL ] */
+    if (serviceClientHandle == NULL)
+    {
+        LogError("serviceClientHandle input parameter cannot be NULL");
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_084: [ If any member of the serviceClientHandle input parameter is NULL IoTHubRegistryManager_Create shall return NULL ] */
+        IOTHUB_SERVICE_CLIENT_AUTH* serviceClientAuth = (IOTHUB_SERVICE_CLIENT_AUTH*)serviceClientHandle;
+
+        if (serviceClientAuth->hostname == NULL)
+        {
+            LogError("authInfo->hostName input parameter cannot be NULL");
+            result = NULL;
+        }
+        else if (serviceClientAuth->iothubName == NULL)
+        {
+            LogError("authInfo->iothubName input parameter cannot be NULL");
+            result = NULL;
+        }
+        else if (serviceClientAuth->iothubSuffix == NULL)
+        {
+            LogError("authInfo->iothubSuffix input parameter cannot be NULL");
+            result = NULL;
+        }
+        else if ((serviceClientAuth->keyName == NULL) && (serviceClientAuth->deviceId == NULL))
+        {
+            LogError("authInfo->keyName and authInfo->deviceId input parameter cannot both be NULL");
+            result = NULL;
+        }
+        else if (serviceClientAuth->sharedAccessKey == NULL)
+        {
+            LogError("authInfo->sharedAccessKey input parameter cannot be NULL");
+            result = NULL;
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_002: [ IoTHubRegistryManager_Create shall allocate memory for a new registry manager instance ] */
+            result = malloc(sizeof(IOTHUB_REGISTRYMANAGER));
+            if (result == NULL)
+            {
+                /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_003: [ If the allocation failed, IoTHubRegistryManager_Create shall return NULL ] */
+                LogError("Malloc failed for IOTHUB_REGISTRYMANAGER");
+            }
+            else
+            {
+                memset(result, 0, sizeof(IOTHUB_REGISTRYMANAGER));
+
+                /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_004: [ If the allocation successful, IoTHubRegistryManager_Create shall create a IOTHUB_REGISTRYMANAGER_HANDLE from the given IOTHUB_REGISTRYMANAGER_AUTH_HANDLE and return with it ] */
+                /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_085: [ IoTHubRegistryManager_Create shall allocate memory and copy hostName to result->hostName by calling mallocAndStrcpy_s. ] */
+                if (mallocAndStrcpy_s(&result->hostname, serviceClientAuth->hostname) != 0)
+                {
+                    /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_086: [ If the mallocAndStrcpy_s fails, IoTHubRegistryManager_Create shall do clean up and return NULL. ] */
+                    LogError("mallocAndStrcpy_s failed for hostName");
+                    free_registrymanager_handle(result);
+                    result = NULL;
+                }
+                /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_087: [ IoTHubRegistryManager_Create shall allocate memory and copy iothubName to result->iothubName by calling mallocAndStrcpy_s. ] */
+                else if (mallocAndStrcpy_s(&result->iothubName, serviceClientAuth->iothubName) != 0)
+                {
+                    /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_088: [ If the mallocAndStrcpy_s fails, IoTHubRegistryManager_Create shall do clean up and return NULL. ] */
+                    LogError("mallocAndStrcpy_s failed for iothubName");
+                    free_registrymanager_handle(result);
+                    result = NULL;
+                }
+                /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_089: [ IoTHubRegistryManager_Create shall allocate memory and copy iothubSuffix to result->iothubSuffix by calling mallocAndStrcpy_s. ] */
+                else if (mallocAndStrcpy_s(&result->iothubSuffix, serviceClientAuth->iothubSuffix) != 0)
+                {
+                    /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_090: [ If the mallocAndStrcpy_s fails, IoTHubRegistryManager_Create shall do clean up and return NULL. ] */
+                    LogError("mallocAndStrcpy_s failed for iothubSuffix");
+                    free_registrymanager_handle(result);
+                    result = NULL;
+                }
+                /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_091: [ IoTHubRegistryManager_Create shall allocate memory and copy sharedAccessKey to result->sharedAccessKey by calling mallocAndStrcpy_s. ] */
+                else if (mallocAndStrcpy_s(&result->sharedAccessKey, serviceClientAuth->sharedAccessKey) != 0)
+                {
+                    /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_092: [ If the mallocAndStrcpy_s fails, IoTHubRegistryManager_Create shall do clean up and return NULL. ] */
+                    LogError("mallocAndStrcpy_s failed for sharedAccessKey");
+                    free_registrymanager_handle(result);
+                    result = NULL;
+                }
+                /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_093: [ IoTHubRegistryManager_Create shall allocate memory and copy keyName to result->keyName by calling mallocAndStrcpy_s. ] */
+                else if ((serviceClientAuth->keyName != NULL) && (mallocAndStrcpy_s(&result->keyName, serviceClientAuth->keyName) != 0))
+                {
+                    /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_094: [ If the mallocAndStrcpy_s fails, IoTHubRegistryManager_Create shall do clean up and return NULL. ] */
+                    LogError("mallocAndStrcpy_s failed for keyName");
+                    free_registrymanager_handle(result);
+                    result = NULL;
+                }
+                else if ((serviceClientAuth->deviceId != NULL) && (mallocAndStrcpy_s(&result->deviceId, serviceClientAuth->deviceId) != 0))
+                {
+                    /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_094: [ If the mallocAndStrcpy_s fails, IoTHubRegistryManager_Create shall do clean up and return NULL. ] */
+                    LogError("mallocAndStrcpy_s failed for deviceId");
+                    free_registrymanager_handle(result);
+                    result = NULL;
+                }
+                /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_030: [ If serviceClientHandle has an HTTP connection pool, IoTHubRegistryManager_Create shall share it by calling IoTHubSCHttpPool_Clone ] */
+                else if ((serviceClientAuth->httpPool != NULL) && ((result->httpPool = IoTHubSCHttpPool_Clone(serviceClientAuth->httpPool)) == NULL))
+                {
+                    /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_031: [ If the IoTHubSCHttpPool_Clone fails, IoTHubRegistryManager_Create shall do clean up and return NULL. ] */
+                    LogError("IoTHubSCHttpPool_Clone failed");
+                    free_registrymanager_handle(result);
+                    result = NULL;
+                }
+            }
+        }
+    }
+    return result;
+}
+
+static void destroyRegistryAsync(struct IOTHUB_REGISTRY_ASYNC_TAG* async);
+
+void IoTHubRegistryManager_Destroy(IOTHUB_REGISTRYMANAGER_HANDLE registryManagerHandle)
+{
+    /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_005: [ If the registryManagerHandle input parameter is NULL IoTHubRegistryManager_Destroy shall return ] */
+    if (registryManagerHandle != NULL)
+    {
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_006 : [ If the registryManagerHandle input parameter is not NULL IoTHubRegistryManager_Destroy shall free the memory of it and return ] */
+        IOTHUB_REGISTRYMANAGER* regManHandle = (IOTHUB_REGISTRYMANAGER*)registryManagerHandle;
+
+        if (regManHandle->async != NULL)
+        {
+            destroyRegistryAsync(regManHandle->async);
+        }
+
+        if (regManHandle->cache != NULL)
+        {
+            destroyRegistryCache(regManHandle->cache);
+        }
+
+        if (regManHandle->httpPool != NULL)
+        {
+            /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_033: [ IoTHubRegistryManager_Destroy shall release its reference to the HTTP connection pool by calling IoTHubSCHttpPool_Destroy ] */
+            IoTHubSCHttpPool_Destroy(regManHandle->httpPool);
+        }
+
+        free(regManHandle->hostname);
+        free(regManHandle->iothubName);
+        free(regManHandle->iothubSuffix);
+        free(regManHandle->sharedAccessKey);
+        free(regManHandle->keyName);
+        free(regManHandle->deviceId);
+        free(regManHandle);
+    }
+}
+
+IOTHUB_REGISTRYMANAGER_RESULT IoTHubRegistryManager_SetCache(IOTHUB_REGISTRYMANAGER_HANDLE registryManagerHandle, unsigned int timeToLiveInSeconds, size_t maxDeviceCount)
+{
+    IOTHUB_REGISTRYMANAGER_RESULT result;
+
+    /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_034: [ If registryManagerHandle is NULL IoTHubRegistryManager_SetCache shall return IOTHUB_REGISTRYMANAGER_INVALID_ARG ] */
+    if (registryManagerHandle == NULL)
+    {
+        LogError("Input parameter cannot be NULL");
+        result = IOTHUB_REGISTRYMANAGER_INVALID_ARG;
+    }
+    else if (registryManagerHandle->cache == NULL)
+    {
+        IOTHUB_REGISTRY_CACHE* cache;
+
+        if (timeToLiveInSeconds == 0)
+        {
+            /*nothing cached yet*/
+            result = IOTHUB_REGISTRYMANAGER_OK;
+        }
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_035: [ The first call of IoTHubRegistryManager_SetCache with a non-zero timeToLiveInSeconds shall create the cache and its lock by calling Lock_Init, and return IOTHUB_REGISTRYMANAGER_ERROR if it fails ] */
+        else if ((cache = (IOTHUB_REGISTRY_CACHE*)malloc(sizeof(IOTHUB_REGISTRY_CACHE))) == NULL)
+        {
+            LogError("malloc failed for IOTHUB_REGISTRY_CACHE");
+            result = IOTHUB_REGISTRYMANAGER_ERROR;
+        }
+        else
+        {
+            memset(cache, 0, sizeof(*cache));
+
+            if ((cache->lock = Lock_Init()) == NULL)
+            {
+                LogError("Lock_Init failed");
+                free(cache);
+                result = IOTHUB_REGISTRYMANAGER_ERROR;
+            }
+            else
+            {
+                cache->timeToLiveInSeconds = timeToLiveInSeconds;
+                cache->maxDeviceCount = maxDeviceCount;
+                registryManagerHandle->cache = cache;
+                result = IOTHUB_REGISTRYMANAGER_OK;
+            }
+        }
+    }
+    else if (Lock(registryManagerHandle->cache->lock) != LOCK_OK)
+    {
+        LogError("Lock failed");
+        result = IOTHUB_REGISTRYMANAGER_ERROR;
+    }
+    else
+    {
+        IOTHUB_REGISTRY_CACHE* cache = registryManagerHandle->cache;
+
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_036: [ IoTHubRegistryManager_SetCache shall apply timeToLiveInSeconds and maxDeviceCount to the cache, dropping the least recently used devices above maxDeviceCount, and return IOTHUB_REGISTRYMANAGER_OK ] */
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_037: [ A timeToLiveInSeconds of 0 shall drop every cached entry and disable the cache ] */
+        cache->timeToLiveInSeconds = timeToLiveInSeconds;
+        cache->maxDeviceCount = (timeToLiveInSeconds == 0) ? 0 : maxDeviceCount;
+        trimCachedDevices(cache, cache->maxDeviceCount);
+        if ((timeToLiveInSeconds == 0) && (cache->statistics != NULL))
+        {
+            freeCacheEntry(cache->statistics);
+            cache->statistics = NULL;
+        }
+        cache->generation++;
+        (void)Unlock(cache->lock);
+        result = IOTHUB_REGISTRYMANAGER_OK;
+    }
+    return result;
+}
+
+static IOTHUB_REGISTRYMANAGER_RESULT IoTHubRegistryManager_CreateDeviceOrModule(IOTHUB_REGISTRYMANAGER_HANDLE registryManagerHandle, const IOTHUB_REGISTRY_DEVICE_OR_MODULE_CREATE* deviceOrModuleCreateInfo, IOTHUB_DEVICE_OR_MODULE* deviceOrModuleInfo)
+{
+    IOTHUB_REGISTRYMANAGER_RESULT result;
 
     /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_007: [ IoTHubRegistryManager_CreateDevice shall verify the input parameters and if any of them are NULL then return IOTHUB_REGISTRYMANAGER_INVALID_ARG ] */
     if ((registryManagerHandle == NULL) || (deviceOrModuleCreateInfo == NULL) || (deviceOrModuleInfo == NULL))
@@ -1622,6 +2799,11 @@ static IOTHUB_REGISTRYMANAGER_RESULT IoTHubRegistryManager_CreateDeviceOrModule(
                     /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_020: [ IoTHubRegistryManager_CreateDevice shall verify the received HTTP status code and if it is 409 then return IOTHUB_REGISTRYMANAGER_DEVICE_EXIST ] */
                 }
 
+                if (deviceOrModuleCreateInfo->moduleId == NULL)
+                {
+                    invalidateRegistryCache(registryManagerHandle, deviceOrModuleCreateInfo->deviceId);
+                }
+
                 /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_100: [ IoTHubRegistryManager_CreateDevice shall do clean up before return ] */
                 if (responseBuffer != NULL)
                 {
@@ -1723,6 +2905,109 @@ IOTHUB_REGISTRYMANAGER_RESULT IoTHubRegistryManager_CreateDevice_Ex(IOTHUB_REGIS
     return result;
 }
 
+IOTHUB_REGISTRYMANAGER_RESULT IoTHubRegistryManager_BulkCreateDevices(IOTHUB_REGISTRYMANAGER_HANDLE registryManagerHandle, const IOTHUB_REGISTRY_DEVICE_CREATE_EX* deviceCreateInfo, size_t deviceCount, IOTHUB_REGISTRYMANAGER_RESULT* deviceResults)
+{
+    IOTHUB_REGISTRYMANAGER_RESULT result;
+
+    /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_016: [ If registryManagerHandle, deviceCreateInfo or deviceResults is NULL or deviceCount is 0 IoTHubRegistryManager_BulkCreateDevices shall return IOTHUB_REGISTRYMANAGER_INVALID_ARG ] */
+    if ((registryManagerHandle == NULL) || (deviceCreateInfo == NULL) || (deviceResults == NULL) || (deviceCount == 0))
+    {
+        LogError("Input parameter cannot be NULL or empty");
+        result = IOTHUB_REGISTRYMANAGER_INVALID_ARG;
+    }
+    else
+    {
+        DEVICE_BULK_CREATE_WORKER workers[IOTHUB_DEVICES_BULK_WORKER_COUNT];
+        THREAD_HANDLE workerThreads[IOTHUB_DEVICES_BULK_WORKER_COUNT];
+        size_t batchCount = (deviceCount + IOTHUB_DEVICES_MAX_BULK_REQUEST - 1) / IOTHUB_DEVICES_MAX_BULK_REQUEST;
+        size_t workerCount = (batchCount < IOTHUB_DEVICES_BULK_WORKER_COUNT) ? batchCount : IOTHUB_DEVICES_BULK_WORKER_COUNT;
+        size_t pendingCount = 0;
+        size_t i;
+
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_017: [ IoTHubRegistryManager_BulkCreateDevices shall validate every device like IoTHubRegistryManager_CreateDevice_Ex, set the result of the invalid ones to IOTHUB_REGISTRYMANAGER_INVALID_VERSION or IOTHUB_REGISTRYMANAGER_INVALID_ARG and not send them ] */
+        for (i = 0; i < deviceCount; i++)
+        {
+            if ((deviceCreateInfo[i].version < IOTHUB_REGISTRY_DEVICE_CREATE_EX_VERSION_1) ||
+                (deviceCreateInfo[i].version > IOTHUB_REGISTRY_DEVICE_CREATE_EX_VERSION_LATEST))
+            {
+                LogError("deviceCreateInfo[%lu] must have a valid version", (unsigned long)i);
+                deviceResults[i] = IOTHUB_REGISTRYMANAGER_INVALID_VERSION;
+            }
+            else if ((deviceCreateInfo[i].deviceId == NULL) || (strHasNoWhitespace(deviceCreateInfo[i].deviceId) != 0))
+            {
+                LogError("deviceCreateInfo[%lu] has no valid deviceId", (unsigned long)i);
+                deviceResults[i] = IOTHUB_REGISTRYMANAGER_INVALID_ARG;
+            }
+            else if (isAuthTypeAllowed(deviceCreateInfo[i].authMethod) == false)
+            {
+                LogError("deviceCreateInfo[%lu] has an invalid authorization type", (unsigned long)i);
+                deviceResults[i] = IOTHUB_REGISTRYMANAGER_INVALID_ARG;
+            }
+            else
+            {
+                deviceResults[i] = IOTHUB_REGISTRYMANAGER_OK;
+                pendingCount++;
+            }
+        }
+
+        if (pendingCount == 0)
+        {
+            workerCount = 0;
+        }
+
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_026: [ IoTHubRegistryManager_BulkCreateDevices shall send up to 4 batches concurrently, running the first worker on the calling thread and the others on threads created by calling ThreadAPI_Create, each worker taking every 4th batch ] */
+        for (i = 0; i < workerCount; i++)
+        {
+            workers[i].registryManagerHandle = registryManagerHandle;
+            workers[i].deviceCreateInfo = deviceCreateInfo;
+            workers[i].deviceResults = deviceResults;
+            workers[i].deviceCount = deviceCount;
+            workers[i].firstBatch = i;
+            workers[i].batchStride = workerCount;
+            workerThreads[i] = NULL;
+
+            if ((i > 0) && (ThreadAPI_Create(&workerThreads[i], bulkCreateDevicesWorker, &workers[i]) != THREADAPI_OK))
+            {
+                /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_028: [ If ThreadAPI_Create fails the batches of that worker shall be sent on the calling thread ] */
+                LogError("ThreadAPI_Create failed, the batches of worker %lu are sent on the calling thread", (unsigned long)i);
+                workerThreads[i] = NULL;
+            }
+        }
+
+        result = IOTHUB_REGISTRYMANAGER_OK;
+        for (i = 0; i < workerCount; i++)
+        {
+            if (workerThreads[i] == NULL)
+            {
+                /*the first worker and those without a thread run here*/
+                (void)bulkCreateDevicesWorker(&workers[i]);
+            }
+            else
+            {
+                int threadResult;
+                if (ThreadAPI_Join(workerThreads[i], &threadResult) != THREADAPI_OK)
+                {
+                    LogError("ThreadAPI_Join failed");
+                    result = IOTHUB_REGISTRYMANAGER_ERROR;
+                }
+            }
+        }
+
+        invalidateRegistryCache(registryManagerHandle, NULL);
+
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_029: [ IoTHubRegistryManager_BulkCreateDevices shall return IOTHUB_REGISTRYMANAGER_OK if every device got IOTHUB_REGISTRYMANAGER_OK and IOTHUB_REGISTRYMANAGER_ERROR otherwise ] */
+        for (i = 0; (i < deviceCount) && (result == IOTHUB_REGISTRYMANAGER_OK); i++)
+        {
+            if (deviceResults[i] != IOTHUB_REGISTRYMANAGER_OK)
+            {
+                result = IOTHUB_REGISTRYMANAGER_ERROR;
+            }
+        }
+    }
+
+    return result;
+}
+
 IOTHUB_REGISTRYMANAGER_RESULT IoTHubRegistryManager_GetDeviceOrModule(IOTHUB_REGISTRYMANAGER_HANDLE registryManagerHandle, const char* deviceId, const char* moduleId, IOTHUB_DEVICE_OR_MODULE* deviceOrModuleInfo)
 {
     IOTHUB_REGISTRYMANAGER_RESULT result;
@@ -1733,6 +3018,11 @@ IOTHUB_REGISTRYMANAGER_RESULT IoTHubRegistryManager_GetDeviceOrModule(IOTHUB_REG
         LogError("Input parameter cannot be NULL");
         result = IOTHUB_REGISTRYMANAGER_INVALID_ARG;
     }
+    else if ((moduleId == NULL) && (registryManagerHandle->cache != NULL))
+    {
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_038: [ While the cache is enabled IoTHubRegistryManager_GetDevice(_Ex) shall look the device up in the cache; modules are never cached ] */
+        result = getDeviceThroughCache(registryManagerHandle, deviceId, deviceOrModuleInfo);
+    }
     else
     {
         BUFFER_HANDLE responseBuffer;
@@ -1911,6 +3201,11 @@ IOTHUB_REGISTRYMANAGER_RESULT IoTHubRegistryManager_UpdateDeviceOrModule(IOTHUB_
                     LogError("Failure sending HTTP request for update device");
                 }
 
+                if (deviceOrModuleUpdate->moduleId == NULL)
+                {
+                    invalidateRegistryCache(registryManagerHandle, deviceOrModuleUpdate->deviceId);
+                }
+
                 /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_105: [ IoTHubRegistryManager_UpdateDevice shall do clean up before return ] */
                 if (deviceJsonBuffer != NULL)
                 {
@@ -2015,6 +3310,7 @@ IOTHUB_REGISTRYMANAGER_RESULT IoTHubRegistryManager_DeleteDevice(IOTHUB_REGISTRY
         /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_058: [ IoTHubRegistryManager_DeleteDevice shall verify the received HTTP status code and if it is greater than 300 then return IOTHUB_REGISTRYMANAGER_HTTP_STATUS_ERROR ] */
         /*Codes_SRS_IOTHUBREGISTRYMANAGER_12_059: [ IoTHubRegistryManager_DeleteDevice shall verify the received HTTP status code and if it is less or equal than 300 then return IOTHUB_REGISTRYMANAGER_OK ] */
         result = sendHttpRequestCRUD(registryManagerHandle, IOTHUB_REQUEST_DELETE, deviceId, NULL, NULL, 0, NULL);
+        invalidateRegistryCache(registryManagerHandle, deviceId);
     }
     return result;
 }
@@ -2088,6 +3384,114 @@ IOTHUB_REGISTRYMANAGER_RESULT IoTHubRegistryManager_GetDeviceList(IOTHUB_REGISTR
     return IoTHubRegistryManager_GetModuleOrDeviceList(registryManagerHandle, NULL, numberOfDevices, deviceList, IOTHUB_REGISTRYMANAGER_MODEL_TYPE_DEVICE, 0);
 }
 
+IOTHUB_REGISTRYMANAGER_RESULT IoTHubRegistryManager_EnumerateDevices(IOTHUB_REGISTRYMANAGER_HANDLE registryManagerHandle, size_t pageSize, IOTHUB_REGISTRYMANAGER_DEVICE_CALLBACK deviceCallback, void* context)
+{
+    IOTHUB_REGISTRYMANAGER_RESULT result;
+
+    /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_001: [ If registryManagerHandle or deviceCallback is NULL IoTHubRegistryManager_EnumerateDevices shall return IOTHUB_REGISTRYMANAGER_INVALID_ARG ] */
+    if ((registryManagerHandle == NULL) || (deviceCallback == NULL))
+    {
+        LogError("Input parameter cannot be NULL");
+        result = IOTHUB_REGISTRYMANAGER_INVALID_ARG;
+    }
+    /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_002: [ If pageSize is not between 1 and 1000 IoTHubRegistryManager_EnumerateDevices shall return IOTHUB_REGISTRYMANAGER_INVALID_ARG ] */
+    else if ((pageSize == 0) || (pageSize > IOTHUB_DEVICES_MAX_REQUEST))
+    {
+        LogError("pageSize has to be between 1 and 1000");
+        result = IOTHUB_REGISTRYMANAGER_INVALID_ARG;
+    }
+    else
+    {
+        DEVICE_QUERY_PAGE pages[2];
+        size_t current = 0;
+        bool isStopped = false;
+
+        memset(pages, 0, sizeof(pages));
+        pages[0].registryManagerHandle = registryManagerHandle;
+        pages[0].pageSize = pageSize;
+        pages[1].registryManagerHandle = registryManagerHandle;
+        pages[1].pageSize = pageSize;
+
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_003: [ IoTHubRegistryManager_EnumerateDevices shall allocate two response buffers by calling BUFFER_new, which are reused for every page ] */
+        if (((pages[0].responseBuffer = BUFFER_new()) == NULL) ||
+            ((pages[1].responseBuffer = BUFFER_new()) == NULL))
+        {
+            LogError("BUFFER_new failed for the response buffers");
+            result = IOTHUB_REGISTRYMANAGER_ERROR;
+        }
+        else
+        {
+            fetchDeviceQueryPage(&pages[0]);
+            result = pages[0].result;
+
+            while (result == IOTHUB_REGISTRYMANAGER_OK)
+            {
+                DEVICE_QUERY_PAGE* page = &pages[current];
+                DEVICE_QUERY_PAGE* nextPage = &pages[1 - current];
+                bool hasNextPage = (page->continuationToken != NULL);
+                THREAD_HANDLE prefetchThread = NULL;
+
+                if (hasNextPage)
+                {
+                    nextPage->continuationToken = page->continuationToken;
+                    page->continuationToken = NULL;
+
+                    /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_013: [ While the devices of a page are handed to deviceCallback IoTHubRegistryManager_EnumerateDevices shall fetch the next page into the other buffer on a thread created by calling ThreadAPI_Create ] */
+                    if (ThreadAPI_Create(&prefetchThread, fetchDeviceQueryPageThread, nextPage) != THREADAPI_OK)
+                    {
+                        /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_014: [ If ThreadAPI_Create fails the next page shall be fetched after the current one has been handed out ] */
+                        LogError("ThreadAPI_Create failed, the next page is fetched after this one");
+                        prefetchThread = NULL;
+                    }
+                }
+
+                result = deliverDeviceQueryPage(page->responseBuffer, deviceCallback, context, &isStopped);
+
+                if (prefetchThread != NULL)
+                {
+                    int threadResult;
+                    if (ThreadAPI_Join(prefetchThread, &threadResult) != THREADAPI_OK)
+                    {
+                        LogError("ThreadAPI_Join failed");
+                        result = IOTHUB_REGISTRYMANAGER_ERROR;
+                    }
+                }
+                else if (hasNextPage && (result == IOTHUB_REGISTRYMANAGER_OK) && !isStopped)
+                {
+                    fetchDeviceQueryPage(nextPage);
+                }
+
+                if ((result != IOTHUB_REGISTRYMANAGER_OK) || isStopped || !hasNextPage)
+                {
+                    break;
+                }
+
+                result = nextPage->result;
+                current = 1 - current;
+            }
+        }
+
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_015: [ IoTHubRegistryManager_EnumerateDevices shall free the response buffers and the continuation token before returning ] */
+        if (pages[0].continuationToken != NULL)
+        {
+            free(pages[0].continuationToken);
+        }
+        if (pages[1].continuationToken != NULL)
+        {
+            free(pages[1].continuationToken);
+        }
+        if (pages[0].responseBuffer != NULL)
+        {
+            BUFFER_delete(pages[0].responseBuffer);
+        }
+        if (pages[1].responseBuffer != NULL)
+        {
+            BUFFER_delete(pages[1].responseBuffer);
+        }
+    }
+    return result;
+}
+
 IOTHUB_REGISTRYMANAGER_RESULT IoTHubRegistryManager_GetStatistics(IOTHUB_REGISTRYMANAGER_HANDLE registryManagerHandle, IOTHUB_REGISTRY_STATISTICS* registryStatistics)
 {
     IOTHUB_REGISTRYMANAGER_RESULT result;
@@ -2098,6 +3502,10 @@ IOTHUB_REGISTRYMANAGER_RESULT IoTHubRegistryManager_GetStatistics(IOTHUB_REGISTR
         LogError("Input parameter cannot be NULL");
         result = IOTHUB_REGISTRYMANAGER_INVALID_ARG;
     }
+    else if (registryManagerHandle->cache != NULL)
+    {
+        result = getStatisticsThroughCache(registryManagerHandle, registryStatistics);
+    }
     else
     {
         BUFFER_HANDLE responseBuffer;
@@ -2286,3 +3694,388 @@ IOTHUB_REGISTRYMANAGER_RESULT IoTHubRegistryManager_GetModuleList(IOTHUB_REGISTR
     return IoTHubRegistryManager_GetModuleOrDeviceList(registryManagerHandle, deviceId, IOTHUB_DEVICES_MAX_REQUEST, moduleList, IOTHUB_REGISTRYMANAGER_MODEL_TYPE_MODULE, module_version);
 }
 
+
+typedef struct REGISTRY_FETCH_TAG
+{
+    struct REGISTRY_FETCH_TAG* next;
+    char* deviceId;         /*NULL for the registry statistics*/
+    IOTHUB_REGISTRYMANAGER_GET_DEVICE_CALLBACK deviceCallback;
+    IOTHUB_REGISTRYMANAGER_GET_STATISTICS_CALLBACK statisticsCallback;
+    void* context;
+    IOTHUB_REGISTRYMANAGER_RESULT result;
+    IOTHUB_DEVICE_EX deviceInfo;
+    IOTHUB_REGISTRY_STATISTICS statistics;
+} REGISTRY_FETCH;
+
+typedef struct REGISTRY_FETCH_QUEUE_TAG
+{
+    REGISTRY_FETCH* head;
+    REGISTRY_FETCH* tail;
+} REGISTRY_FETCH_QUEUE;
+
+/** @brief State of the asynchronous fetches, created by the first IoTHubRegistryManager_GetDeviceAsync or IoTHubRegistryManager_GetStatisticsAsync
+*
+*   A single worker runs the queued fetches one after the other and exits once none is left,
+*   the next fetch queued starting it again.
+*/
+typedef struct IOTHUB_REGISTRY_ASYNC_TAG
+{
+    LOCK_HANDLE lock;
+    REGISTRY_FETCH_QUEUE pending;
+    REGISTRY_FETCH_QUEUE completed;
+    THREAD_HANDLE worker;
+    bool workerStarted;     /*a worker was claimed and has not been joined yet*/
+    bool workerCreated;     /*worker holds its handle*/
+    bool workerExited;      /*the worker found nothing left to fetch*/
+    bool stopWorker;
+} IOTHUB_REGISTRY_ASYNC;
+
+static void pushFetch(REGISTRY_FETCH_QUEUE* queue, REGISTRY_FETCH* fetch)
+{
+    fetch->next = NULL;
+    if (queue->tail == NULL)
+    {
+        queue->head = fetch;
+    }
+    else
+    {
+        queue->tail->next = fetch;
+    }
+    queue->tail = fetch;
+}
+
+static REGISTRY_FETCH* popFetch(REGISTRY_FETCH_QUEUE* queue)
+{
+    REGISTRY_FETCH* result = queue->head;
+    if (result != NULL)
+    {
+        queue->head = result->next;
+        if (queue->head == NULL)
+        {
+            queue->tail = NULL;
+        }
+        result->next = NULL;
+    }
+    return result;
+}
+
+/*calls the callbacks of fetches and frees them, must be called without the async lock held*/
+static void completeFetches(REGISTRY_FETCH* fetch)
+{
+    while (fetch != NULL)
+    {
+        REGISTRY_FETCH* next = fetch->next;
+
+        if (fetch->deviceId != NULL)
+        {
+            fetch->deviceCallback(fetch->context, fetch->result, (fetch->result == IOTHUB_REGISTRYMANAGER_OK) ? &fetch->deviceInfo : NULL);
+            if (fetch->result == IOTHUB_REGISTRYMANAGER_OK)
+            {
+                IoTHubRegistryManager_FreeDeviceExMembers(&fetch->deviceInfo);
+            }
+            free(fetch->deviceId);
+        }
+        else
+        {
+            fetch->statisticsCallback(fetch->context, fetch->result, (fetch->result == IOTHUB_REGISTRYMANAGER_OK) ? &fetch->statistics : NULL);
+        }
+        free(fetch);
+        fetch = next;
+    }
+}
+
+static int registryFetchWorker(void* arg)
+{
+    IOTHUB_REGISTRYMANAGER* registryManager = (IOTHUB_REGISTRYMANAGER*)arg;
+    IOTHUB_REGISTRY_ASYNC* async = registryManager->async;
+
+    if (Lock(async->lock) != LOCK_OK)
+    {
+        LogError("Lock failed, registry fetch worker exiting");
+    }
+    else
+    {
+        REGISTRY_FETCH* fetch;
+        bool locked = true;
+
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_048: [ The worker shall take the queued fetches in order and execute each the way IoTHubRegistryManager_GetDevice_Ex or IoTHubRegistryManager_GetStatistics does, through the cache if it is enabled, without holding the lock ] */
+        while ((!async->stopWorker) && ((fetch = popFetch(&async->pending)) != NULL))
+        {
+            (void)Unlock(async->lock);
+
+            if (fetch->deviceId != NULL)
+            {
+                fetch->deviceInfo.version = 1;
+                fetch->result = IoTHubRegistryManager_GetDevice_Ex(registryManager, fetch->deviceId, &fetch->deviceInfo);
+            }
+            else
+            {
+                fetch->result = IoTHubRegistryManager_GetStatistics(registryManager, &fetch->statistics);
+            }
+
+            if (Lock(async->lock) != LOCK_OK)
+            {
+                /*the fetch can't be handed back, report it from here rather than losing it*/
+                LogError("Lock failed, registry fetch worker exiting");
+                completeFetches(fetch);
+                locked = false;
+                break;
+            }
+
+            pushFetch(&async->completed, fetch);
+        }
+
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_049: [ The worker shall queue each completed fetch for IoTHubRegistryManager_DoWork and exit once no fetch is queued ] */
+        async->workerExited = true;
+        if (locked)
+        {
+            (void)Unlock(async->lock);
+        }
+    }
+    return 0;
+}
+
+/*must be called without the async lock held, the worker may run before ThreadAPI_Create returns*/
+static void startFetchWorker(IOTHUB_REGISTRYMANAGER* registryManager)
+{
+    IOTHUB_REGISTRY_ASYNC* async = registryManager->async;
+    THREAD_HANDLE exitedWorker = NULL;
+    bool startWorker = false;
+
+    if (Lock(async->lock) != LOCK_OK)
+    {
+        LogError("Lock failed, registry fetch worker not started");
+    }
+    else
+    {
+        if (async->workerStarted && async->workerCreated && async->workerExited)
+        {
+            exitedWorker = async->worker;
+            async->workerStarted = false;
+            async->workerCreated = false;
+        }
+
+        if ((!async->workerStarted) && (!async->stopWorker) && (async->pending.head != NULL))
+        {
+            async->workerStarted = true;
+            async->workerExited = false;
+            startWorker = true;
+        }
+        (void)Unlock(async->lock);
+    }
+
+    if (exitedWorker != NULL)
+    {
+        int res;
+        if (ThreadAPI_Join(exitedWorker, &res) != THREADAPI_OK)
+        {
+            LogError("ThreadAPI_Join failed for the registry fetch worker");
+        }
+    }
+
+    if (startWorker)
+    {
+        THREAD_HANDLE worker;
+        bool created = (ThreadAPI_Create(&worker, registryFetchWorker, registryManager) == THREADAPI_OK);
+
+        if (!created)
+        {
+            /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_050: [ If ThreadAPI_Create fails the fetches shall stay queued and starting the worker shall be retried by the next asynchronous fetch or IoTHubRegistryManager_DoWork ] */
+            LogError("ThreadAPI_Create failed for the registry fetch worker");
+        }
+
+        if (Lock(async->lock) != LOCK_OK)
+        {
+            LogError("Lock failed, recording the registry fetch worker anyway");
+        }
+
+        if (created)
+        {
+            async->worker = worker;
+            async->workerCreated = true;
+        }
+        else
+        {
+            async->workerStarted = false;
+        }
+        (void)Unlock(async->lock);
+    }
+}
+
+static IOTHUB_REGISTRY_ASYNC* createRegistryAsync(void)
+{
+    IOTHUB_REGISTRY_ASYNC* result;
+
+    if ((result = (IOTHUB_REGISTRY_ASYNC*)malloc(sizeof(IOTHUB_REGISTRY_ASYNC))) == NULL)
+    {
+        LogError("malloc failed for IOTHUB_REGISTRY_ASYNC");
+    }
+    else
+    {
+        memset(result, 0, sizeof(*result));
+
+        if ((result->lock = Lock_Init()) == NULL)
+        {
+            LogError("Lock_Init failed");
+            free(result);
+            result = NULL;
+        }
+    }
+    return result;
+}
+
+static void destroyRegistryAsync(IOTHUB_REGISTRY_ASYNC* async)
+{
+    REGISTRY_FETCH* fetch;
+    THREAD_HANDLE worker = NULL;
+
+    /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_053: [ IoTHubRegistryManager_Destroy shall stop the worker, wait for the fetch it is executing by calling ThreadAPI_Join, call the callbacks of the completed fetches with their result and of the queued ones with IOTHUB_REGISTRYMANAGER_ERROR, and then destroy the cache ] */
+    if (Lock(async->lock) != LOCK_OK)
+    {
+        LogError("Lock failed, stopping the registry fetch worker anyway");
+    }
+    async->stopWorker = true;
+    if (async->workerStarted && async->workerCreated)
+    {
+        worker = async->worker;
+    }
+    (void)Unlock(async->lock);
+
+    if (worker != NULL)
+    {
+        int res;
+        if (ThreadAPI_Join(worker, &res) != THREADAPI_OK)
+        {
+            LogError("ThreadAPI_Join failed for the registry fetch worker");
+        }
+    }
+
+    completeFetches(async->completed.head);
+    for (fetch = async->pending.head; fetch != NULL; fetch = fetch->next)
+    {
+        fetch->result = IOTHUB_REGISTRYMANAGER_ERROR;
+    }
+    completeFetches(async->pending.head);
+
+    (void)Lock_Deinit(async->lock);
+    free(async);
+}
+
+static IOTHUB_REGISTRYMANAGER_RESULT queueFetch(IOTHUB_REGISTRYMANAGER_HANDLE registryManagerHandle, REGISTRY_FETCH* fetch)
+{
+    IOTHUB_REGISTRYMANAGER_RESULT result;
+
+    /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_047: [ The first asynchronous fetch shall create the lock shared with the worker by calling Lock_Init; if any call fails the fetch shall do clean up and return IOTHUB_REGISTRYMANAGER_ERROR ] */
+    if ((registryManagerHandle->async == NULL) && ((registryManagerHandle->async = createRegistryAsync()) == NULL))
+    {
+        LogError("Failure creating the registry async state");
+        result = IOTHUB_REGISTRYMANAGER_ERROR;
+    }
+    else if (Lock(registryManagerHandle->async->lock) != LOCK_OK)
+    {
+        LogError("Lock failed");
+        result = IOTHUB_REGISTRYMANAGER_ERROR;
+    }
+    else
+    {
+        pushFetch(&registryManagerHandle->async->pending, fetch);
+        (void)Unlock(registryManagerHandle->async->lock);
+
+        startFetchWorker(registryManagerHandle);
+        result = IOTHUB_REGISTRYMANAGER_OK;
+    }
+    return result;
+}
+
+IOTHUB_REGISTRYMANAGER_RESULT IoTHubRegistryManager_GetDeviceAsync(IOTHUB_REGISTRYMANAGER_HANDLE registryManagerHandle, const char* deviceId, IOTHUB_REGISTRYMANAGER_GET_DEVICE_CALLBACK getDeviceCallback, void* context)
+{
+    IOTHUB_REGISTRYMANAGER_RESULT result;
+    REGISTRY_FETCH* fetch;
+
+    /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_046: [ IoTHubRegistryManager_GetDeviceAsync and IoTHubRegistryManager_GetStatisticsAsync shall verify the input parameters and if any of them (except the context) are NULL then return IOTHUB_REGISTRYMANAGER_INVALID_ARG ] */
+    if ((registryManagerHandle == NULL) || (deviceId == NULL) || (getDeviceCallback == NULL))
+    {
+        LogError("Input parameter cannot be NULL");
+        result = IOTHUB_REGISTRYMANAGER_INVALID_ARG;
+    }
+    else if ((fetch = (REGISTRY_FETCH*)malloc(sizeof(REGISTRY_FETCH))) == NULL)
+    {
+        LogError("malloc failed for REGISTRY_FETCH");
+        result = IOTHUB_REGISTRYMANAGER_ERROR;
+    }
+    else
+    {
+        memset(fetch, 0, sizeof(*fetch));
+        fetch->deviceCallback = getDeviceCallback;
+        fetch->context = context;
+
+        if (mallocAndStrcpy_s(&fetch->deviceId, deviceId) != 0)
+        {
+            LogError("mallocAndStrcpy_s failed for deviceId");
+            free(fetch);
+            result = IOTHUB_REGISTRYMANAGER_ERROR;
+        }
+        else if ((result = queueFetch(registryManagerHandle, fetch)) != IOTHUB_REGISTRYMANAGER_OK)
+        {
+            free(fetch->deviceId);
+            free(fetch);
+        }
+    }
+    return result;
+}
+
+IOTHUB_REGISTRYMANAGER_RESULT IoTHubRegistryManager_GetStatisticsAsync(IOTHUB_REGISTRYMANAGER_HANDLE registryManagerHandle, IOTHUB_REGISTRYMANAGER_GET_STATISTICS_CALLBACK getStatisticsCallback, void* context)
+{
+    IOTHUB_REGISTRYMANAGER_RESULT result;
+    REGISTRY_FETCH* fetch;
+
+    /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_046: [ IoTHubRegistryManager_GetDeviceAsync and IoTHubRegistryManager_GetStatisticsAsync shall verify the input parameters and if any of them (except the context) are NULL then return IOTHUB_REGISTRYMANAGER_INVALID_ARG ] */
+    if ((registryManagerHandle == NULL) || (getStatisticsCallback == NULL))
+    {
+        LogError("Input parameter cannot be NULL");
+        result = IOTHUB_REGISTRYMANAGER_INVALID_ARG;
+    }
+    else if ((fetch = (REGISTRY_FETCH*)malloc(sizeof(REGISTRY_FETCH))) == NULL)
+    {
+        LogError("malloc failed for REGISTRY_FETCH");
+        result = IOTHUB_REGISTRYMANAGER_ERROR;
+    }
+    else
+    {
+        memset(fetch, 0, sizeof(*fetch));
+        fetch->statisticsCallback = getStatisticsCallback;
+        fetch->context = context;
+
+        if ((result = queueFetch(registryManagerHandle, fetch)) != IOTHUB_REGISTRYMANAGER_OK)
+        {
+            free(fetch);
+        }
+    }
+    return result;
+}
+
+void IoTHubRegistryManager_DoWork(IOTHUB_REGISTRYMANAGER_HANDLE registryManagerHandle)
+{
+    /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_051: [ If registryManagerHandle is NULL or no asynchronous fetch has been queued IoTHubRegistryManager_DoWork shall return ] */
+    if ((registryManagerHandle != NULL) && (registryManagerHandle->async != NULL))
+    {
+        IOTHUB_REGISTRY_ASYNC* async = registryManagerHandle->async;
+
+        /*Codes_SRS_IOTHUBREGISTRYMANAGER_41_052: [ IoTHubRegistryManager_DoWork shall join an exited worker, retry starting it for the queued fetches, take the completed fetches and call their callbacks after releasing the lock, with the device or statistics only when the result is IOTHUB_REGISTRYMANAGER_OK, freeing the device members once the callback returns ] */
+        startFetchWorker(registryManagerHandle);
+
+        if (Lock(async->lock) != LOCK_OK)
+        {
+            LogError("Lock failed");
+        }
+        else
+        {
+            REGISTRY_FETCH* completed = async->completed.head;
+            async->completed.head = NULL;
+            async->completed.tail = NULL;
+            (void)Unlock(async->lock);
+
+            completeFetches(completed);
+        }
+    }
+}
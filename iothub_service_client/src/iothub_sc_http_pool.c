@@ -0,0 +1,311 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/crt_abstractions.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/strings.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/agenttime.h"
+#include "azure_c_shared_utility/sastoken.h"
+#include "azure_c_shared_utility/httpapiex.h"
+
+#include "internal/iothub_sc_http_pool.h"
+
+#define EPOCH_TIME_T_VALUE (time_t)0
+
+static const char* HTTP_HEADER_KEY_AUTHORIZATION = "Authorization";
+static const char* IOTHUB_SAS_PREFIX = "sas=";
+static const size_t IOTHUB_SAS_PREFIX_LENGTH = 4;
+
+typedef struct IOTHUB_SC_HTTP_POOL_TAG
+{
+    LOCK_HANDLE lock;
+    size_t refCount;
+    char* hostname;
+    char* sharedAccessKey;
+    char* keyName;
+    STRING_HANDLE sasScope;
+    bool isSharedAccessSignature;
+    STRING_HANDLE sasToken;
+    size_t sasTokenExpiry;
+    HTTPAPIEX_HANDLE idleConnections[IOTHUB_SC_HTTP_POOL_MAX_IDLE_CONNECTIONS];
+    size_t idleConnectionCount;
+} IOTHUB_SC_HTTP_POOL;
+
+static void free_http_pool(IOTHUB_SC_HTTP_POOL* httpPool)
+{
+    size_t i;
+
+    for (i = 0; i < httpPool->idleConnectionCount; i++)
+    {
+        HTTPAPIEX_Destroy(httpPool->idleConnections[i]);
+    }
+    if (httpPool->lock != NULL)
+    {
+        (void)Lock_Deinit(httpPool->lock);
+    }
+    STRING_delete(httpPool->sasToken);
+    STRING_delete(httpPool->sasScope);
+    free(httpPool->keyName);
+    free(httpPool->sharedAccessKey);
+    free(httpPool->hostname);
+    free(httpPool);
+}
+
+/*must be called with the pool lock held*/
+static int refreshSasToken(IOTHUB_SC_HTTP_POOL* httpPool)
+{
+    int result;
+
+    if (httpPool->isSharedAccessSignature)
+    {
+        /*Codes_SRS_IOTHUBSCHTTPPOOL_41_014: [ If the shared access key was given as a "sas=" prefixed signature, IoTHubSCHttpPool_ExecuteRequest shall use it as is and never regenerate it ]*/
+        result = 0;
+    }
+    else
+    {
+        time_t currentTime = get_time(NULL);
+        if (currentTime == (time_t)(-1))
+        {
+            LogError("get_time failed");
+            result = __FAILURE__;
+        }
+        else
+        {
+            size_t secSinceEpoch = (size_t)(difftime(currentTime, EPOCH_TIME_T_VALUE) + 0);
+
+            if ((httpPool->sasToken != NULL) && (secSinceEpoch + IOTHUB_SC_HTTP_POOL_SAS_TOKEN_REFRESH_MARGIN < httpPool->sasTokenExpiry))
+            {
+                /*Codes_SRS_IOTHUBSCHTTPPOOL_41_013: [ IoTHubSCHttpPool_ExecuteRequest shall reuse the cached SAS token while it is valid for more than IOTHUB_SC_HTTP_POOL_SAS_TOKEN_REFRESH_MARGIN seconds ]*/
+                result = 0;
+            }
+            else
+            {
+                /*Codes_SRS_IOTHUBSCHTTPPOOL_41_012: [ Otherwise IoTHubSCHttpPool_ExecuteRequest shall generate a new SAS token valid for IOTHUB_SC_HTTP_POOL_SAS_TOKEN_LIFETIME seconds by calling SASToken_CreateString and cache it ]*/
+                size_t expiry = secSinceEpoch + IOTHUB_SC_HTTP_POOL_SAS_TOKEN_LIFETIME;
+                STRING_HANDLE newSasToken = SASToken_CreateString(httpPool->sharedAccessKey, STRING_c_str(httpPool->sasScope), httpPool->keyName, expiry);
+                if (newSasToken == NULL)
+                {
+                    LogError("SASToken_CreateString failed");
+                    result = __FAILURE__;
+                }
+                else
+                {
+                    STRING_delete(httpPool->sasToken);
+                    httpPool->sasToken = newSasToken;
+                    httpPool->sasTokenExpiry = expiry;
+                    result = 0;
+                }
+            }
+        }
+    }
+    return result;
+}
+
+static void releaseConnection(IOTHUB_SC_HTTP_POOL* httpPool, HTTPAPIEX_HANDLE connection, bool isReusable, bool isUnauthorized)
+{
+    if (Lock(httpPool->lock) != LOCK_OK)
+    {
+        LogError("Lock failed, dropping the connection");
+    }
+    else
+    {
+        if (isUnauthorized && !httpPool->isSharedAccessSignature)
+        {
+            /*Codes_SRS_IOTHUBSCHTTPPOOL_41_018: [ If the service answered 401, IoTHubSCHttpPool_ExecuteRequest shall discard the cached SAS token so the next request generates a new one ]*/
+            httpPool->sasTokenExpiry = 0;
+        }
+
+        /*Codes_SRS_IOTHUBSCHTTPPOOL_41_016: [ After a successful request IoTHubSCHttpPool_ExecuteRequest shall return the connection to the pool if fewer than IOTHUB_SC_HTTP_POOL_MAX_IDLE_CONNECTIONS connections are idle ]*/
+        if (isReusable && (httpPool->idleConnectionCount < IOTHUB_SC_HTTP_POOL_MAX_IDLE_CONNECTIONS))
+        {
+            httpPool->idleConnections[httpPool->idleConnectionCount++] = connection;
+            connection = NULL;
+        }
+        (void)Unlock(httpPool->lock);
+    }
+
+    /*Codes_SRS_IOTHUBSCHTTPPOOL_41_017: [ Otherwise, or if the request failed, IoTHubSCHttpPool_ExecuteRequest shall destroy the connection by calling HTTPAPIEX_Destroy ]*/
+    if (connection != NULL)
+    {
+        HTTPAPIEX_Destroy(connection);
+    }
+}
+
+IOTHUB_SC_HTTP_POOL_HANDLE IoTHubSCHttpPool_Create(const char* hostname, const char* sharedAccessKey, const char* keyName, const char* deviceId)
+{
+    IOTHUB_SC_HTTP_POOL* result;
+
+    /*Codes_SRS_IOTHUBSCHTTPPOOL_41_001: [ If hostname or sharedAccessKey is NULL, IoTHubSCHttpPool_Create shall return NULL ]*/
+    if ((hostname == NULL) || (sharedAccessKey == NULL))
+    {
+        LogError("Invalid argument: hostname=%p, sharedAccessKey=%p", hostname, sharedAccessKey);
+        result = NULL;
+    }
+    /*Codes_SRS_IOTHUBSCHTTPPOOL_41_002: [ IoTHubSCHttpPool_Create shall allocate memory for a new pool ]*/
+    else if ((result = malloc(sizeof(IOTHUB_SC_HTTP_POOL))) == NULL)
+    {
+        /*Codes_SRS_IOTHUBSCHTTPPOOL_41_004: [ If any of the calls fail, IoTHubSCHttpPool_Create shall do clean up and return NULL ]*/
+        LogError("Malloc failed for IOTHUB_SC_HTTP_POOL");
+    }
+    else
+    {
+        memset(result, 0, sizeof(*result));
+        result->refCount = 1;
+        result->isSharedAccessSignature = (strncmp(sharedAccessKey, IOTHUB_SAS_PREFIX, IOTHUB_SAS_PREFIX_LENGTH) == 0);
+
+        /*Codes_SRS_IOTHUBSCHTTPPOOL_41_003: [ IoTHubSCHttpPool_Create shall copy hostname, sharedAccessKey and keyName, and build the SAS scope from hostname and, if given, deviceId ]*/
+        if (mallocAndStrcpy_s(&result->hostname, hostname) != 0)
+        {
+            /*Codes_SRS_IOTHUBSCHTTPPOOL_41_004: [ If any of the calls fail, IoTHubSCHttpPool_Create shall do clean up and return NULL ]*/
+            LogError("mallocAndStrcpy_s failed for hostname");
+            free_http_pool(result);
+            result = NULL;
+        }
+        else if (mallocAndStrcpy_s(&result->sharedAccessKey, sharedAccessKey) != 0)
+        {
+            LogError("mallocAndStrcpy_s failed for sharedAccessKey");
+            free_http_pool(result);
+            result = NULL;
+        }
+        else if ((keyName != NULL) && (mallocAndStrcpy_s(&result->keyName, keyName) != 0))
+        {
+            LogError("mallocAndStrcpy_s failed for keyName");
+            free_http_pool(result);
+            result = NULL;
+        }
+        else if ((result->sasScope = ((deviceId != NULL) ? STRING_construct_sprintf("%s%%2Fdevices%%2F%s", hostname, deviceId) : STRING_construct(hostname))) == NULL)
+        {
+            LogError("STRING_construct failed for sasScope");
+            free_http_pool(result);
+            result = NULL;
+        }
+        /*Codes_SRS_IOTHUBSCHTTPPOOL_41_005: [ If the shared access key is a "sas=" prefixed signature, IoTHubSCHttpPool_Create shall cache the signature as the SAS token ]*/
+        else if (result->isSharedAccessSignature && ((result->sasToken = STRING_construct(sharedAccessKey + IOTHUB_SAS_PREFIX_LENGTH)) == NULL))
+        {
+            LogError("STRING_construct failed for sasToken");
+            free_http_pool(result);
+            result = NULL;
+        }
+        else if ((result->lock = Lock_Init()) == NULL)
+        {
+            LogError("Lock_Init failed");
+            free_http_pool(result);
+            result = NULL;
+        }
+    }
+    return result;
+}
+
+IOTHUB_SC_HTTP_POOL_HANDLE IoTHubSCHttpPool_Clone(IOTHUB_SC_HTTP_POOL_HANDLE httpPoolHandle)
+{
+    IOTHUB_SC_HTTP_POOL_HANDLE result;
+
+    /*Codes_SRS_IOTHUBSCHTTPPOOL_41_006: [ If httpPoolHandle is NULL, IoTHubSCHttpPool_Clone shall return NULL ]*/
+    if (httpPoolHandle == NULL)
+    {
+        LogError("Invalid argument: httpPoolHandle is NULL");
+        result = NULL;
+    }
+    else if (Lock(httpPoolHandle->lock) != LOCK_OK)
+    {
+        /*Codes_SRS_IOTHUBSCHTTPPOOL_41_008: [ If Lock fails, IoTHubSCHttpPool_Clone shall return NULL ]*/
+        LogError("Lock failed");
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBSCHTTPPOOL_41_007: [ IoTHubSCHttpPool_Clone shall increment the reference count of the pool and return httpPoolHandle ]*/
+        httpPoolHandle->refCount++;
+        (void)Unlock(httpPoolHandle->lock);
+        result = httpPoolHandle;
+    }
+    return result;
+}
+
+void IoTHubSCHttpPool_Destroy(IOTHUB_SC_HTTP_POOL_HANDLE httpPoolHandle)
+{
+    /*Codes_SRS_IOTHUBSCHTTPPOOL_41_009: [ If httpPoolHandle is NULL, IoTHubSCHttpPool_Destroy shall return ]*/
+    if (httpPoolHandle != NULL)
+    {
+        if (Lock(httpPoolHandle->lock) != LOCK_OK)
+        {
+            LogError("Lock failed, the pool is leaked");
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBSCHTTPPOOL_41_010: [ IoTHubSCHttpPool_Destroy shall decrement the reference count and, when it reaches zero, destroy the idle connections and free the pool ]*/
+            bool isLastReference = (--httpPoolHandle->refCount == 0);
+            (void)Unlock(httpPoolHandle->lock);
+
+            if (isLastReference)
+            {
+                free_http_pool(httpPoolHandle);
+            }
+        }
+    }
+}
+
+HTTPAPIEX_RESULT IoTHubSCHttpPool_ExecuteRequest(IOTHUB_SC_HTTP_POOL_HANDLE httpPoolHandle, HTTPAPI_REQUEST_TYPE requestType, const char* relativePath, HTTP_HEADERS_HANDLE requestHttpHeadersHandle, BUFFER_HANDLE requestContent, unsigned int* statusCode, HTTP_HEADERS_HANDLE responseHttpHeadersHandle, BUFFER_HANDLE responseContent)
+{
+    HTTPAPIEX_RESULT result;
+
+    /*Codes_SRS_IOTHUBSCHTTPPOOL_41_011: [ If httpPoolHandle, relativePath, requestHttpHeadersHandle or statusCode is NULL, IoTHubSCHttpPool_ExecuteRequest shall return HTTPAPIEX_INVALID_ARG ]*/
+    if ((httpPoolHandle == NULL) || (relativePath == NULL) || (requestHttpHeadersHandle == NULL) || (statusCode == NULL))
+    {
+        LogError("Invalid argument: httpPoolHandle=%p, relativePath=%p, requestHttpHeadersHandle=%p, statusCode=%p", httpPoolHandle, relativePath, requestHttpHeadersHandle, statusCode);
+        result = HTTPAPIEX_INVALID_ARG;
+    }
+    else if (Lock(httpPoolHandle->lock) != LOCK_OK)
+    {
+        /*Codes_SRS_IOTHUBSCHTTPPOOL_41_019: [ If any of the calls fail, IoTHubSCHttpPool_ExecuteRequest shall return HTTPAPIEX_ERROR ]*/
+        LogError("Lock failed");
+        result = HTTPAPIEX_ERROR;
+    }
+    else
+    {
+        HTTPAPIEX_HANDLE connection = NULL;
+
+        if (refreshSasToken(httpPoolHandle) != 0)
+        {
+            LogError("Failure refreshing the SAS token");
+            result = HTTPAPIEX_ERROR;
+        }
+        /*Codes_SRS_IOTHUBSCHTTPPOOL_41_015: [ IoTHubSCHttpPool_ExecuteRequest shall set the Authorization header to the cached SAS token by calling HTTPHeaders_ReplaceHeaderNameValuePair ]*/
+        else if (HTTPHeaders_ReplaceHeaderNameValuePair(requestHttpHeadersHandle, HTTP_HEADER_KEY_AUTHORIZATION, STRING_c_str(httpPoolHandle->sasToken)) != HTTP_HEADERS_OK)
+        {
+            LogError("HTTPHeaders_ReplaceHeaderNameValuePair failed for Authorization");
+            result = HTTPAPIEX_ERROR;
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBSCHTTPPOOL_41_020: [ IoTHubSCHttpPool_ExecuteRequest shall take an idle connection from the pool, or create one by calling HTTPAPIEX_Create when none is idle ]*/
+            if (httpPoolHandle->idleConnectionCount > 0)
+            {
+                connection = httpPoolHandle->idleConnections[--httpPoolHandle->idleConnectionCount];
+            }
+            result = HTTPAPIEX_OK;
+        }
+        (void)Unlock(httpPoolHandle->lock);
+
+        if (result == HTTPAPIEX_OK)
+        {
+            if ((connection == NULL) && ((connection = HTTPAPIEX_Create(httpPoolHandle->hostname)) == NULL))
+            {
+                LogError("HTTPAPIEX_Create failed");
+                result = HTTPAPIEX_ERROR;
+            }
+            else
+            {
+                /*Codes_SRS_IOTHUBSCHTTPPOOL_41_021: [ IoTHubSCHttpPool_ExecuteRequest shall execute the request on the connection by calling HTTPAPIEX_ExecuteRequest and return its result ]*/
+                result = HTTPAPIEX_ExecuteRequest(connection, requestType, relativePath, requestHttpHeadersHandle, requestContent, statusCode, responseHttpHeadersHandle, responseContent);
+                releaseConnection(httpPoolHandle, connection, (result == HTTPAPIEX_OK), ((result == HTTPAPIEX_OK) && (*statusCode == 401)));
+            }
+        }
+    }
+    return result;
+}
@@ -10,6 +10,7 @@
 #include "azure_c_shared_utility/connection_string_parser.h"
 
 #include "iothub_service_client_auth.h"
+#include "internal/iothub_sc_http_pool.h"
 
 static const char* IOTHUBHOSTNAME = "HostName";
 static const char* IOTHUBSHAREDACESSKEYNAME = "SharedAccessKeyName";
@@ -20,6 +21,11 @@ static const char* IOTHUBSASPREFIX = "sas=";
 
 static void free_service_client_auth(IOTHUB_SERVICE_CLIENT_AUTH* authInfo)
 {
+    if (authInfo->httpPool != NULL)
+    {
+        /*Codes_SRS_IOTHUBSERVICECLIENT_41_002: [** IoTHubServiceClient_Destroy shall release the HTTP connection pool by calling IoTHubSCHttpPool_Destroy **]*/
+        IoTHubSCHttpPool_Destroy(authInfo->httpPool);
+    }
     free(authInfo->hostname);
     free(authInfo->iothubName);
     free(authInfo->iothubSuffix);
@@ -252,6 +258,14 @@ static IOTHUB_SERVICE_CLIENT_AUTH_HANDLE create_from_connection_string(const cha
                         free_service_client_auth(result);
                         result = NULL;
                     }
+                    /*Codes_SRS_IOTHUBSERVICECLIENT_41_001: [** IoTHubServiceClientAuth_CreateFromConnectionString shall create the HTTP connection pool shared by the service clients by calling IoTHubSCHttpPool_Create with hostName, sharedAccessKey, keyName and deviceId. **] */
+                    else if ((result->httpPool = IoTHubSCHttpPool_Create(result->hostname, result->sharedAccessKey, result->keyName, result->deviceId)) == NULL)
+                    {
+                        /*Codes_SRS_IOTHUBSERVICECLIENT_41_003: [** If the IoTHubSCHttpPool_Create fails, IoTHubServiceClientAuth_CreateFromConnectionString shall do clean up and return NULL. **] */
+                        LogError("IoTHubSCHttpPool_Create failed");
+                        free_service_client_auth(result);
+                        result = NULL;
+                    }
                     /*Codes_SRS_IOTHUBSERVICECLIENT_12_006: [** If the IOTHUB_SERVICE_CLIENT_AUTH has been populated IoTHubServiceClientAuth_CreateFromConnectionString shall do clean up and return with a IOTHUB_SERVICE_CLIENT_AUTH_HANDLE to it **] */
                     STRING_delete(token_key_string);
                     STRING_delete(token_value_string);
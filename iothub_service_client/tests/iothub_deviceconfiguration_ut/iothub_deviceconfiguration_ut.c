@@ -59,6 +59,7 @@ static int my_mallocAndStrcpy_s(char** destination, const char* source)
 #include "azure_c_shared_utility/httpheaders.h"
 #include "azure_c_shared_utility/httpapiex.h"
 #include "azure_c_shared_utility/httpapiexsas.h"
+#include "internal/iothub_sc_http_pool.h"
 #include "azure_c_shared_utility/uniqueid.h"
 #include "azure_c_shared_utility/singlylinkedlist.h"
 #include "parson.h"
@@ -93,6 +94,9 @@ MOCKABLE_FUNCTION(, const char *, json_object_get_name, const JSON_Object *, obj
 MOCKABLE_FUNCTION(, JSON_Value *, json_object_get_value_at, const JSON_Object *, object, size_t, index);
 MOCKABLE_FUNCTION(, int, json_object_has_value, const JSON_Object *, object, const char *, name);
 MOCKABLE_FUNCTION(, const char *, json_value_get_string, const JSON_Value *, value);
+MOCKABLE_FUNCTION(, double, json_value_get_number, const JSON_Value *, value);
+MOCKABLE_FUNCTION(, size_t, json_serialization_size, const JSON_Value*, value);
+MOCKABLE_FUNCTION(, JSON_Status, json_serialize_to_buffer, const JSON_Value*, value, char*, buf, size_t, buf_size_in_bytes);
 
 #undef ENABLE_MOCKS
 
@@ -155,6 +159,22 @@ void my_BUFFER_delete(BUFFER_HANDLE handle)
     my_gballoc_free(handle);
 }
 
+static unsigned char TEST_RESPONSE_BUFFER[16];
+
+unsigned char* my_BUFFER_u_char(BUFFER_HANDLE handle)
+{
+    (void)handle;
+    return TEST_RESPONSE_BUFFER;
+}
+
+JSON_Status my_json_serialize_to_buffer(const JSON_Value* value, char* buf, size_t buf_size_in_bytes)
+{
+    (void)value;
+    (void)buf_size_in_bytes;
+    strcpy(buf, "{}");
+    return JSONSuccess;
+}
+
 HTTPAPIEX_HANDLE my_HTTPAPIEX_Create(const char* hostName)
 {
     (void)hostName;
@@ -200,11 +220,14 @@ typedef struct IOTHUB_SERVICE_CLIENT_DEVICE_CONFIGURATION_TAG
     char* hostname;
     char* sharedAccessKey;
     char* keyName;
+    IOTHUB_SC_HTTP_POOL_HANDLE httpPool;
 } IOTHUB_SERVICE_CLIENT_DEVICE_CONFIGURATION;
 
 static IOTHUB_SERVICE_CLIENT_AUTH TEST_IOTHUB_SERVICE_CLIENT_AUTH;
 static IOTHUB_SERVICE_CLIENT_AUTH_HANDLE TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE = &TEST_IOTHUB_SERVICE_CLIENT_AUTH;
 
+static IOTHUB_SC_HTTP_POOL_HANDLE TEST_IOTHUB_SC_HTTP_POOL_HANDLE = (IOTHUB_SC_HTTP_POOL_HANDLE)0x4848;
+
 static IOTHUB_SERVICE_CLIENT_DEVICE_CONFIGURATION TEST_IOTHUB_SERVICE_CLIENT_DEVICE_CONFIGURATION;
 static IOTHUB_SERVICE_CLIENT_DEVICE_CONFIGURATION_HANDLE TEST_IOTHUB_SERVICE_CLIENT_DEVICE_CONFIGURATION_HANDLE = &TEST_IOTHUB_SERVICE_CLIENT_DEVICE_CONFIGURATION;
 
@@ -463,6 +486,7 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_UMOCK_ALIAS_TYPE(HTTP_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(HTTPAPIEX_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(HTTPAPIEX_SAS_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_SC_HTTP_POOL_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(JSON_Value_Type, int);
     REGISTER_UMOCK_ALIAS_TYPE(SINGLYLINKEDLIST_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(LIST_ITEM_HANDLE, void*);
@@ -494,6 +518,15 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
 
     REGISTER_GLOBAL_MOCK_HOOK(BUFFER_delete, my_BUFFER_delete);
 
+    REGISTER_GLOBAL_MOCK_RETURN(BUFFER_enlarge, 0);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(BUFFER_enlarge, __LINE__);
+
+    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_u_char, my_BUFFER_u_char);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(BUFFER_u_char, NULL);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_realloc, my_gballoc_realloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_realloc, NULL);
+
     REGISTER_GLOBAL_MOCK_HOOK(HTTPHeaders_Alloc, my_HTTPHeaders_Alloc);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(HTTPHeaders_Alloc, NULL);
 
@@ -514,6 +547,11 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_GLOBAL_MOCK_RETURN(HTTPAPIEX_SAS_ExecuteRequest, HTTPAPIEX_OK);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(HTTPAPIEX_SAS_ExecuteRequest, HTTPAPIEX_ERROR);
 
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubSCHttpPool_Clone, TEST_IOTHUB_SC_HTTP_POOL_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubSCHttpPool_Clone, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubSCHttpPool_ExecuteRequest, HTTPAPIEX_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubSCHttpPool_ExecuteRequest, HTTPAPIEX_ERROR);
+
     REGISTER_GLOBAL_MOCK_RETURN(json_value_init_object, TEST_JSON_VALUE);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(json_value_init_object, NULL);
 
@@ -574,6 +612,12 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_GLOBAL_MOCK_RETURN(json_object_set_value, JSONSuccess);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(json_object_set_value, JSONFailure);
 
+    REGISTER_GLOBAL_MOCK_RETURN(json_serialization_size, 3);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(json_serialization_size, 0);
+
+    REGISTER_GLOBAL_MOCK_HOOK(json_serialize_to_buffer, my_json_serialize_to_buffer);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(json_serialize_to_buffer, JSONFailure);
+
     REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_create, my_list_create);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(singlylinkedlist_create, NULL);
 
@@ -611,6 +655,8 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
     TEST_IOTHUB_SERVICE_CLIENT_AUTH.iothubSuffix = TEST_IOTHUBSUFFIX;
     TEST_IOTHUB_SERVICE_CLIENT_AUTH.sharedAccessKey = TEST_SHAREDACCESSKEY;
     TEST_IOTHUB_SERVICE_CLIENT_AUTH.keyName = TEST_SHAREDACCESSKEYNAME;
+    TEST_IOTHUB_SERVICE_CLIENT_AUTH.httpPool = NULL;
+    TEST_IOTHUB_SERVICE_CLIENT_DEVICE_CONFIGURATION.httpPool = NULL;
 }
 
 TEST_FUNCTION_CLEANUP(TestMethodCleanup)
@@ -805,6 +851,84 @@ TEST_FUNCTION(IoTHubDeviceConfiguration_Destroy_do_clean_up_and_return_if_input_
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 }
 
+/*Tests_SRS_IOTHUBDEVICECONFIGURATION_41_001: [ If serviceClientHandle has an HTTP connection pool, IoTHubDeviceConfiguration_Create shall share it by calling IoTHubSCHttpPool_Clone ]*/
+TEST_FUNCTION(IoTHubDeviceConfiguration_Create_shares_the_http_pool_of_the_service_client)
+{
+    ///arrange
+    TEST_IOTHUB_SERVICE_CLIENT_AUTH.httpPool = TEST_IOTHUB_SC_HTTP_POOL_HANDLE;
+
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubSCHttpPool_Clone(TEST_IOTHUB_SC_HTTP_POOL_HANDLE));
+
+    ///act
+    IOTHUB_SERVICE_CLIENT_DEVICE_CONFIGURATION_HANDLE result = IoTHubDeviceConfiguration_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(void_ptr, TEST_IOTHUB_SC_HTTP_POOL_HANDLE, result->httpPool);
+
+    ///cleanup
+    if (result != NULL)
+    {
+        free(result->hostname);
+        free(result->keyName);
+        free(result->sharedAccessKey);
+        free(result);
+    }
+}
+
+/*Tests_SRS_IOTHUBDEVICECONFIGURATION_41_002: [ If the IoTHubSCHttpPool_Clone fails, IoTHubDeviceConfiguration_Create shall do clean up and return NULL. ]*/
+TEST_FUNCTION(IoTHubDeviceConfiguration_Create_returns_NULL_if_IoTHubSCHttpPool_Clone_fails)
+{
+    ///arrange
+    TEST_IOTHUB_SERVICE_CLIENT_AUTH.httpPool = TEST_IOTHUB_SC_HTTP_POOL_HANDLE;
+
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubSCHttpPool_Clone(TEST_IOTHUB_SC_HTTP_POOL_HANDLE))
+        .SetReturn(NULL);
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    ///act
+    IOTHUB_SERVICE_CLIENT_DEVICE_CONFIGURATION_HANDLE result = IoTHubDeviceConfiguration_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBDEVICECONFIGURATION_41_004: [ IoTHubDeviceConfiguration_Destroy shall release its reference to the HTTP connection pool by calling IoTHubSCHttpPool_Destroy ]*/
+TEST_FUNCTION(IoTHubDeviceConfiguration_Destroy_releases_the_http_pool)
+{
+    ///arrange
+    TEST_IOTHUB_SERVICE_CLIENT_AUTH.httpPool = TEST_IOTHUB_SC_HTTP_POOL_HANDLE;
+    IOTHUB_SERVICE_CLIENT_DEVICE_CONFIGURATION_HANDLE handle = IoTHubDeviceConfiguration_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+    ASSERT_IS_NOT_NULL(handle);
+
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(IoTHubSCHttpPool_Destroy(TEST_IOTHUB_SC_HTTP_POOL_HANDLE));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    ///act
+    IoTHubDeviceConfiguration_Destroy(handle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
 
 /*Tests_SRS_IOTHUBDEVICECONFIGURATION_38_018: [ IoTHubDeviceConfiguration_AddConfiguration shall verify the input parameters and if any of them are NULL then return IOTHUB_DEVICE_CONFIGURATION_INVALID_ARG ]*/
 TEST_FUNCTION(IoTHubDeviceConfiguration_AddConfiguration_return_NULL_if_input_parameter_serviceClientDeviceConfigurationHandle_is_NULL)
@@ -1779,4 +1903,223 @@ TEST_FUNCTION(IoTHubDeviceConfiguration_DeleteConfiguration_non_happy_path)
     IoTHubDeviceConfiguration_Destroy(handle);
 }
 
+static size_t g_configuration_callback_count;
+
+static bool my_configuration_enumerate_callback(void* context, const IOTHUB_DEVICE_CONFIGURATION* configuration)
+{
+    ASSERT_ARE_EQUAL(char_ptr, TEST_CONFIGURATION_ID, configuration->configurationId);
+    ASSERT_ARE_EQUAL(char_ptr, "{}", configuration->content.deviceContent);
+    ASSERT_ARE_EQUAL(char_ptr, "{}", configuration->content.modulesContent);
+    ASSERT_ARE_EQUAL(int, 42, configuration->priority);
+    g_configuration_callback_count++;
+    return *(bool*)context;
+}
+
+static void set_expected_calls_for_viewDeviceConfigurationJsonObject(bool allocateContent)
+{
+    STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, TEST_CONFIGURATION_JSON_KEY_CONFIGURATION_ID))
+        .SetReturn(TEST_CONFIGURATION_ID);
+    STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, TEST_CONFIGURATION_JSON_KEY_SCHEMA_VERSION));
+    STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, TEST_CONFIGURATION_JSON_KEY_TARGET_CONDITION));
+    STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, TEST_CONFIGURATION_JSON_KEY_CREATED_TIME));
+    STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, TEST_CONFIGURATION_JSON_KEY_LAST_UPDATED_TIME));
+    STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, TEST_CONFIGURATION_JSON_KEY_ETAG));
+    STRICT_EXPECTED_CALL(json_object_get_number(TEST_JSON_OBJECT, TEST_CONFIGURATION_JSON_KEY_PRIORITY))
+        .SetReturn(42);
+
+    STRICT_EXPECTED_CALL(json_object_dotget_value(TEST_JSON_OBJECT, TEST_CONFIGURATION_DEVICE_CONTENT_NODE_NAME));
+    STRICT_EXPECTED_CALL(json_serialization_size(TEST_JSON_VALUE));
+    if (allocateContent)
+    {
+        EXPECTED_CALL(gballoc_realloc(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    }
+    STRICT_EXPECTED_CALL(json_serialize_to_buffer(TEST_JSON_VALUE, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .IgnoreArgument_buf()
+        .IgnoreArgument_buf_size_in_bytes();
+
+    STRICT_EXPECTED_CALL(json_object_dotget_value(TEST_JSON_OBJECT, TEST_CONFIGURATION_MODULES_CONTENT_NODE_NAME));
+    STRICT_EXPECTED_CALL(json_serialization_size(TEST_JSON_VALUE));
+    if (allocateContent)
+    {
+        EXPECTED_CALL(gballoc_realloc(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    }
+    STRICT_EXPECTED_CALL(json_serialize_to_buffer(TEST_JSON_VALUE, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .IgnoreArgument_buf()
+        .IgnoreArgument_buf_size_in_bytes();
+
+    STRICT_EXPECTED_CALL(json_object_dotget_object(TEST_JSON_OBJECT, TEST_CONFIGURATION_JSON_KEY_LABELS));
+    STRICT_EXPECTED_CALL(json_object_get_count(TEST_JSON_OBJECT));
+    STRICT_EXPECTED_CALL(json_object_dotget_object(TEST_JSON_OBJECT, TEST_CONFIGURATION_SYSTEM_METRICS_RESULTS_NODE_NAME));
+    STRICT_EXPECTED_CALL(json_object_get_count(TEST_JSON_OBJECT));
+    STRICT_EXPECTED_CALL(json_object_dotget_object(TEST_JSON_OBJECT, TEST_CONFIGURATION_SYSTEM_METRICS_QUERIES_NODE_NAME));
+    STRICT_EXPECTED_CALL(json_object_get_count(TEST_JSON_OBJECT));
+    STRICT_EXPECTED_CALL(json_object_dotget_object(TEST_JSON_OBJECT, TEST_CONFIGURATION_CUSTOM_METRICS_RESULTS_NODE_NAME));
+    STRICT_EXPECTED_CALL(json_object_get_count(TEST_JSON_OBJECT));
+    STRICT_EXPECTED_CALL(json_object_dotget_object(TEST_JSON_OBJECT, TEST_CONFIGURATION_CUSTOM_METRICS_QUERIES_NODE_NAME));
+    STRICT_EXPECTED_CALL(json_object_get_count(TEST_JSON_OBJECT));
+}
+
+static void set_expected_calls_for_EnumerateConfigurations_processing(size_t configurationCount, size_t viewedCount)
+{
+    size_t i;
+
+    EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_enlarge(IGNORED_PTR_ARG, 1))
+        .IgnoreArgument(1);
+    EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(json_parse_string(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(json_value_get_array(TEST_JSON_VALUE));
+    STRICT_EXPECTED_CALL(json_array_get_count(TEST_JSON_ARRAY))
+        .SetReturn(configurationCount);
+    for (i = 0; i < viewedCount; i++)
+    {
+        STRICT_EXPECTED_CALL(json_array_get_object(TEST_JSON_ARRAY, i));
+        set_expected_calls_for_viewDeviceConfigurationJsonObject(i == 0);
+    }
+
+    //names, values and results of the 5 name-value groups, then the 2 content buffers
+    for (i = 0; i < 17; i++)
+    {
+        EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    }
+    STRICT_EXPECTED_CALL(json_value_free(TEST_JSON_VALUE));
+    EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+}
+
+/*Tests_SRS_IOTHUBDEVICECONFIGURATION_41_001: [ If serviceClientDeviceConfigurationHandle or configurationCallback is NULL, or maxConfigurationsCount is not between 1 and 20, IoTHubDeviceConfiguration_EnumerateConfigurations shall return IOTHUB_DEVICE_CONFIGURATION_INVALID_ARG ] */
+TEST_FUNCTION(IoTHubDeviceConfiguration_EnumerateConfigurations_return_INVALID_ARG_if_input_parameter_is_invalid)
+{
+    ///arrange
+    bool isContinued = true;
+
+    ///act
+    IOTHUB_DEVICE_CONFIGURATION_RESULT result_null_handle = IoTHubDeviceConfiguration_EnumerateConfigurations(NULL, 20, my_configuration_enumerate_callback, &isContinued);
+    IOTHUB_DEVICE_CONFIGURATION_RESULT result_null_callback = IoTHubDeviceConfiguration_EnumerateConfigurations(TEST_IOTHUB_SERVICE_CLIENT_DEVICE_CONFIGURATION_HANDLE, 20, NULL, &isContinued);
+    IOTHUB_DEVICE_CONFIGURATION_RESULT result_zero_count = IoTHubDeviceConfiguration_EnumerateConfigurations(TEST_IOTHUB_SERVICE_CLIENT_DEVICE_CONFIGURATION_HANDLE, 0, my_configuration_enumerate_callback, &isContinued);
+    IOTHUB_DEVICE_CONFIGURATION_RESULT result_too_large_count = IoTHubDeviceConfiguration_EnumerateConfigurations(TEST_IOTHUB_SERVICE_CLIENT_DEVICE_CONFIGURATION_HANDLE, 21, my_configuration_enumerate_callback, &isContinued);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_CONFIGURATION_INVALID_ARG, result_null_handle);
+    ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_CONFIGURATION_INVALID_ARG, result_null_callback);
+    ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_CONFIGURATION_INVALID_ARG, result_zero_count);
+    ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_CONFIGURATION_INVALID_ARG, result_too_large_count);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBDEVICECONFIGURATION_41_002: [ IoTHubDeviceConfiguration_EnumerateConfigurations shall send the HTTP GET request of IoTHubDeviceConfiguration_GetConfigurations ] */
+/*Tests_SRS_IOTHUBDEVICECONFIGURATION_41_005: [ IoTHubDeviceConfiguration_EnumerateConfigurations shall hand every configuration to configurationCallback as a read-only view pointing into the parsed response, without copying its members ] */
+TEST_FUNCTION(IoTHubDeviceConfiguration_EnumerateConfigurations_happy_path_status_code_200)
+{
+    ///arrange
+    bool isContinued = true;
+    IOTHUB_SERVICE_CLIENT_DEVICE_CONFIGURATION_HANDLE handle = IoTHubDeviceConfiguration_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+    ASSERT_IS_NOT_NULL(handle);
+    g_configuration_callback_count = 0;
+
+    umock_c_reset_all_calls();
+
+    EXPECTED_CALL(BUFFER_new());
+    set_expected_calls_for_sendHttpRequestDeviceConfiguration(httpStatusCodeOk, HTTPAPI_REQUEST_GET, IOTHUB_DEVICECONFIGURATION_REQUEST_GET_LIST);
+    set_expected_calls_for_EnumerateConfigurations_processing(2, 2);
+
+    ///act
+    IOTHUB_DEVICE_CONFIGURATION_RESULT result = IoTHubDeviceConfiguration_EnumerateConfigurations(handle, 20, my_configuration_enumerate_callback, &isContinued);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_CONFIGURATION_OK, result);
+    ASSERT_ARE_EQUAL(size_t, 2, g_configuration_callback_count);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubDeviceConfiguration_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBDEVICECONFIGURATION_41_006: [ If configurationCallback returns false IoTHubDeviceConfiguration_EnumerateConfigurations shall not call it again and shall return IOTHUB_DEVICE_CONFIGURATION_OK ] */
+TEST_FUNCTION(IoTHubDeviceConfiguration_EnumerateConfigurations_stops_when_the_callback_returns_false)
+{
+    ///arrange
+    bool isContinued = false;
+    IOTHUB_SERVICE_CLIENT_DEVICE_CONFIGURATION_HANDLE handle = IoTHubDeviceConfiguration_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+    ASSERT_IS_NOT_NULL(handle);
+    g_configuration_callback_count = 0;
+
+    umock_c_reset_all_calls();
+
+    EXPECTED_CALL(BUFFER_new());
+    set_expected_calls_for_sendHttpRequestDeviceConfiguration(httpStatusCodeOk, HTTPAPI_REQUEST_GET, IOTHUB_DEVICECONFIGURATION_REQUEST_GET_LIST);
+    set_expected_calls_for_EnumerateConfigurations_processing(2, 1);
+
+    ///act
+    IOTHUB_DEVICE_CONFIGURATION_RESULT result = IoTHubDeviceConfiguration_EnumerateConfigurations(handle, 20, my_configuration_enumerate_callback, &isContinued);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_CONFIGURATION_OK, result);
+    ASSERT_ARE_EQUAL(size_t, 1, g_configuration_callback_count);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubDeviceConfiguration_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBDEVICECONFIGURATION_41_003: [ If the request fails or the received HTTP status code is not 200 IoTHubDeviceConfiguration_EnumerateConfigurations shall return the error of IoTHubDeviceConfiguration_GetConfigurations without calling configurationCallback ] */
+TEST_FUNCTION(IoTHubDeviceConfiguration_EnumerateConfigurations_return_ERROR_if_status_code_is_not_200)
+{
+    ///arrange
+    bool isContinued = true;
+    IOTHUB_SERVICE_CLIENT_DEVICE_CONFIGURATION_HANDLE handle = IoTHubDeviceConfiguration_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+    ASSERT_IS_NOT_NULL(handle);
+    g_configuration_callback_count = 0;
+
+    umock_c_reset_all_calls();
+
+    EXPECTED_CALL(BUFFER_new());
+    set_expected_calls_for_sendHttpRequestDeviceConfiguration(httpStatusCodeBadRequest, HTTPAPI_REQUEST_GET, IOTHUB_DEVICECONFIGURATION_REQUEST_GET_LIST);
+    EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+
+    ///act
+    IOTHUB_DEVICE_CONFIGURATION_RESULT result = IoTHubDeviceConfiguration_EnumerateConfigurations(handle, 20, my_configuration_enumerate_callback, &isContinued);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_CONFIGURATION_ERROR, result);
+    ASSERT_ARE_EQUAL(size_t, 0, g_configuration_callback_count);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubDeviceConfiguration_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBDEVICECONFIGURATION_41_004: [ If any of the parson API fails, IoTHubDeviceConfiguration_EnumerateConfigurations shall return IOTHUB_DEVICE_CONFIGURATION_JSON_ERROR ] */
+TEST_FUNCTION(IoTHubDeviceConfiguration_EnumerateConfigurations_return_JSON_ERROR_if_the_response_is_not_an_array)
+{
+    ///arrange
+    bool isContinued = true;
+    IOTHUB_SERVICE_CLIENT_DEVICE_CONFIGURATION_HANDLE handle = IoTHubDeviceConfiguration_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+    ASSERT_IS_NOT_NULL(handle);
+    g_configuration_callback_count = 0;
+
+    umock_c_reset_all_calls();
+
+    EXPECTED_CALL(BUFFER_new());
+    set_expected_calls_for_sendHttpRequestDeviceConfiguration(httpStatusCodeOk, HTTPAPI_REQUEST_GET, IOTHUB_DEVICECONFIGURATION_REQUEST_GET_LIST);
+    EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG));
+    EXPECTED_CALL(BUFFER_enlarge(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(json_parse_string(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(json_value_get_array(TEST_JSON_VALUE))
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(json_value_free(TEST_JSON_VALUE));
+    EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+
+    ///act
+    IOTHUB_DEVICE_CONFIGURATION_RESULT result = IoTHubDeviceConfiguration_EnumerateConfigurations(handle, 20, my_configuration_enumerate_callback, &isContinued);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_CONFIGURATION_JSON_ERROR, result);
+    ASSERT_ARE_EQUAL(size_t, 0, g_configuration_callback_count);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubDeviceConfiguration_Destroy(handle);
+}
+
 END_TEST_SUITE(iothub_deviceconfiguration_ut)
@@ -60,7 +60,11 @@ static int my_mallocAndStrcpy_s(char** destination, const char* source)
 #include "azure_c_shared_utility/httpheaders.h"
 #include "azure_c_shared_utility/httpapiex.h"
 #include "azure_c_shared_utility/httpapiexsas.h"
+#include "internal/iothub_sc_http_pool.h"
 #include "azure_c_shared_utility/uniqueid.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+#include "azure_c_shared_utility/threadapi.h"
 #include "parson.h"
 
 MOCKABLE_FUNCTION(, JSON_Value*, json_parse_string, const char *, string);
@@ -75,6 +79,7 @@ MOCKABLE_FUNCTION(, JSON_Status, json_object_clear, JSON_Object*, object);
 MOCKABLE_FUNCTION(, void, json_value_free, JSON_Value *, value);
 MOCKABLE_FUNCTION(, char*, json_serialize_to_string, const JSON_Value*, value);
 
+
 #undef ENABLE_MOCKS
 
 #include "azure_c_shared_utility/strings.h"
@@ -87,6 +92,12 @@ TEST_DEFINE_ENUM_TYPE(HTTP_HEADERS_RESULT, HTTP_HEADERS_RESULT_VALUES);
 IMPLEMENT_UMOCK_C_ENUM_TYPE(HTTP_HEADERS_RESULT, HTTP_HEADERS_RESULT_VALUES);
 TEST_DEFINE_ENUM_TYPE(HTTPAPI_REQUEST_TYPE, HTTPAPI_REQUEST_TYPE_VALUES);
 IMPLEMENT_UMOCK_C_ENUM_TYPE(HTTPAPI_REQUEST_TYPE, HTTPAPI_REQUEST_TYPE_VALUES);
+TEST_DEFINE_ENUM_TYPE(LOCK_RESULT, LOCK_RESULT_VALUES);
+IMPLEMENT_UMOCK_C_ENUM_TYPE(LOCK_RESULT, LOCK_RESULT_VALUES);
+TEST_DEFINE_ENUM_TYPE(COND_RESULT, COND_RESULT_VALUES);
+IMPLEMENT_UMOCK_C_ENUM_TYPE(COND_RESULT, COND_RESULT_VALUES);
+TEST_DEFINE_ENUM_TYPE(THREADAPI_RESULT, THREADAPI_RESULT_VALUES);
+IMPLEMENT_UMOCK_C_ENUM_TYPE(THREADAPI_RESULT, THREADAPI_RESULT_VALUES);
 
 static unsigned char* TEST_UNSIGNED_CHAR_PTR = (unsigned char*)"TestString";
 
@@ -197,16 +208,40 @@ void my_json_value_free(JSON_Value *value)
 #include "iothub_devicemethod.h"
 #include "iothub_service_client_auth.h"
 
+TEST_DEFINE_ENUM_TYPE(IOTHUB_DEVICE_METHOD_RESULT, IOTHUB_DEVICE_METHOD_RESULT_VALUES);
+IMPLEMENT_UMOCK_C_ENUM_TYPE(IOTHUB_DEVICE_METHOD_RESULT, IOTHUB_DEVICE_METHOD_RESULT_VALUES);
+
+#define ENABLE_MOCKS
+MOCKABLE_FUNCTION(, void, test_invoke_complete_callback, void*, context, IOTHUB_DEVICE_METHOD_RESULT, result, int, responseStatus, const unsigned char*, responsePayload, size_t, responsePayloadSize);
+#undef ENABLE_MOCKS
+
 typedef struct IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_TAG
 {
     char* hostname;
     char* sharedAccessKey;
     char* keyName;
+    IOTHUB_SC_HTTP_POOL_HANDLE httpPool;
+    size_t maxConcurrentInvocations;
+    void* async;
 } IOTHUB_SERVICE_CLIENT_DEVICE_METHOD;
 
+static LOCK_HANDLE TEST_LOCK_HANDLE = (LOCK_HANDLE)0x4949;
+static COND_HANDLE TEST_COND_HANDLE = (COND_HANDLE)0x4a4a;
+static THREAD_HANDLE TEST_THREAD_HANDLE = (THREAD_HANDLE)0x4b4b;
+
+static THREADAPI_RESULT my_ThreadAPI_Create(THREAD_HANDLE* threadHandle, THREAD_START_FUNC func, void* arg)
+{
+    (void)func;
+    (void)arg;
+    *threadHandle = TEST_THREAD_HANDLE;
+    return THREADAPI_OK;
+}
+
 static IOTHUB_SERVICE_CLIENT_AUTH TEST_IOTHUB_SERVICE_CLIENT_AUTH;
 static IOTHUB_SERVICE_CLIENT_AUTH_HANDLE TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE = &TEST_IOTHUB_SERVICE_CLIENT_AUTH;
 
+static IOTHUB_SC_HTTP_POOL_HANDLE TEST_IOTHUB_SC_HTTP_POOL_HANDLE = (IOTHUB_SC_HTTP_POOL_HANDLE)0x4848;
+
 static IOTHUB_SERVICE_CLIENT_DEVICE_METHOD TEST_IOTHUB_SERVICE_CLIENT_DEVICE_METHOD;
 static IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE TEST_IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE = &TEST_IOTHUB_SERVICE_CLIENT_DEVICE_METHOD;
 
@@ -286,6 +321,14 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_TYPE(HTTPAPIEX_RESULT, HTTPAPIEX_RESULT);
     REGISTER_TYPE(HTTP_HEADERS_RESULT, HTTP_HEADERS_RESULT);
     REGISTER_TYPE(HTTPAPI_REQUEST_TYPE, HTTPAPI_REQUEST_TYPE);
+    REGISTER_TYPE(IOTHUB_DEVICE_METHOD_RESULT, IOTHUB_DEVICE_METHOD_RESULT);
+    REGISTER_TYPE(LOCK_RESULT, LOCK_RESULT);
+    REGISTER_TYPE(COND_RESULT, COND_RESULT);
+    REGISTER_TYPE(THREADAPI_RESULT, THREADAPI_RESULT);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(COND_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(THREAD_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(THREAD_START_FUNC, void*);
     REGISTER_UMOCK_ALIAS_TYPE(VECTOR_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(const VECTOR_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(PREDICATE_FUNCTION, void*);
@@ -295,6 +338,7 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_UMOCK_ALIAS_TYPE(HTTP_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(HTTPAPIEX_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(HTTPAPIEX_SAS_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_SC_HTTP_POOL_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(JSON_Value_Type, int);
 
 
@@ -302,6 +346,8 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
 
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_realloc, my_gballoc_realloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_realloc, NULL);
 
     REGISTER_GLOBAL_MOCK_HOOK(mallocAndStrcpy_s, my_mallocAndStrcpy_s);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(mallocAndStrcpy_s, 42);
@@ -348,6 +394,11 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_GLOBAL_MOCK_RETURN(HTTPAPIEX_SAS_ExecuteRequest, HTTPAPIEX_OK);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(HTTPAPIEX_SAS_ExecuteRequest, HTTPAPIEX_ERROR);
 
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubSCHttpPool_Clone, TEST_IOTHUB_SC_HTTP_POOL_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubSCHttpPool_Clone, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubSCHttpPool_ExecuteRequest, HTTPAPIEX_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubSCHttpPool_ExecuteRequest, HTTPAPIEX_ERROR);
+
     REGISTER_GLOBAL_MOCK_HOOK(json_parse_string, my_json_parse_string);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(json_parse_string, NULL);
 
@@ -370,6 +421,19 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
 
     REGISTER_GLOBAL_MOCK_HOOK(json_serialize_to_string, my_json_serialize_to_string);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(json_serialize_to_string, NULL);
+
+    REGISTER_GLOBAL_MOCK_RETURN(Lock_Init, TEST_LOCK_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock_Init, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock, LOCK_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock_Deinit, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(Condition_Init, TEST_COND_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Condition_Init, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(Condition_Post, COND_OK);
+    REGISTER_GLOBAL_MOCK_HOOK(ThreadAPI_Create, my_ThreadAPI_Create);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(ThreadAPI_Create, THREADAPI_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(ThreadAPI_Join, THREADAPI_OK);
 }
 
 TEST_SUITE_CLEANUP(TestClassCleanup)
@@ -392,7 +456,8 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
     TEST_IOTHUB_SERVICE_CLIENT_AUTH.iothubSuffix = TEST_IOTHUBSUFFIX;
     TEST_IOTHUB_SERVICE_CLIENT_AUTH.keyName = TEST_SHAREDACCESSKEYNAME;
     TEST_IOTHUB_SERVICE_CLIENT_AUTH.sharedAccessKey = TEST_SHAREDACCESSKEY;
-
+    TEST_IOTHUB_SERVICE_CLIENT_AUTH.httpPool = NULL;
+    TEST_IOTHUB_SERVICE_CLIENT_DEVICE_METHOD.httpPool = NULL;
 }
 
 TEST_FUNCTION_CLEANUP(TestMethodCleanup)
@@ -606,6 +671,84 @@ TEST_FUNCTION(IoTHubDeviceMethod_Destroy_do_clean_up_and_return_if_input_paramet
     // assert
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 }
+
+/*Tests_SRS_IOTHUBDEVICEMETHOD_41_001: [ If serviceClientHandle has an HTTP connection pool, IoTHubDeviceMethod_Create shall share it by calling IoTHubSCHttpPool_Clone ]*/
+TEST_FUNCTION(IoTHubDeviceMethod_Create_shares_the_http_pool_of_the_service_client)
+{
+    ///arrange
+    TEST_IOTHUB_SERVICE_CLIENT_AUTH.httpPool = TEST_IOTHUB_SC_HTTP_POOL_HANDLE;
+
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubSCHttpPool_Clone(TEST_IOTHUB_SC_HTTP_POOL_HANDLE));
+
+    ///act
+    IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE result = IoTHubDeviceMethod_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(void_ptr, TEST_IOTHUB_SC_HTTP_POOL_HANDLE, result->httpPool);
+
+    ///cleanup
+    if (result != NULL)
+    {
+        free(result->hostname);
+        free(result->keyName);
+        free(result->sharedAccessKey);
+        free(result);
+    }
+}
+
+/*Tests_SRS_IOTHUBDEVICEMETHOD_41_002: [ If the IoTHubSCHttpPool_Clone fails, IoTHubDeviceMethod_Create shall do clean up and return NULL. ]*/
+TEST_FUNCTION(IoTHubDeviceMethod_Create_returns_NULL_if_IoTHubSCHttpPool_Clone_fails)
+{
+    ///arrange
+    TEST_IOTHUB_SERVICE_CLIENT_AUTH.httpPool = TEST_IOTHUB_SC_HTTP_POOL_HANDLE;
+
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubSCHttpPool_Clone(TEST_IOTHUB_SC_HTTP_POOL_HANDLE))
+        .SetReturn(NULL);
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    ///act
+    IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE result = IoTHubDeviceMethod_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBDEVICEMETHOD_41_004: [ IoTHubDeviceMethod_Destroy shall release its reference to the HTTP connection pool by calling IoTHubSCHttpPool_Destroy ]*/
+TEST_FUNCTION(IoTHubDeviceMethod_Destroy_releases_the_http_pool)
+{
+    ///arrange
+    TEST_IOTHUB_SERVICE_CLIENT_AUTH.httpPool = TEST_IOTHUB_SC_HTTP_POOL_HANDLE;
+    IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE handle = IoTHubDeviceMethod_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+    ASSERT_IS_NOT_NULL(handle);
+
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(IoTHubSCHttpPool_Destroy(TEST_IOTHUB_SC_HTTP_POOL_HANDLE));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    ///act
+    IoTHubDeviceMethod_Destroy(handle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
 //
 
 static void IoTHubDeviceMethod_InvokeDeviceOrModule_return_NULL_if_input_parameter_serviceClientdevicemethodHandle_is_NULL(bool testing_module)
@@ -1302,4 +1445,330 @@ TEST_FUNCTION(IoTHubDeviceMethod_InvokeModule_non_happy_path)
     IoTHubDeviceMethod_Invoke_non_happy_path_impl(true);
 }
 
+/*Tests_SRS_IOTHUBDEVICEMETHOD_41_005: [ IoTHubDeviceMethod_Invoke(Module)Async shall verify the input parameters and if any of them (except the timeout and the context) are NULL then return IOTHUB_DEVICE_METHOD_INVALID_ARG ]*/
+TEST_FUNCTION(IoTHubDeviceMethod_InvokeAsync_return_IOTHUB_DEVICE_METHOD_INVALID_ARG_if_input_parameter_serviceClientDeviceMethodHandle_is_NULL)
+{
+    ///act
+    IOTHUB_DEVICE_METHOD_RESULT result = IoTHubDeviceMethod_InvokeAsync(NULL, TEST_DEVICE_ID, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_TIMEOUT, test_invoke_complete_callback, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_METHOD_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBDEVICEMETHOD_41_005: [ IoTHubDeviceMethod_Invoke(Module)Async shall verify the input parameters and if any of them (except the timeout and the context) are NULL then return IOTHUB_DEVICE_METHOD_INVALID_ARG ]*/
+TEST_FUNCTION(IoTHubDeviceMethod_InvokeAsync_return_IOTHUB_DEVICE_METHOD_INVALID_ARG_if_input_parameter_invokeCompleteCallback_is_NULL)
+{
+    ///act
+    IOTHUB_DEVICE_METHOD_RESULT result = IoTHubDeviceMethod_InvokeAsync(TEST_IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE, TEST_DEVICE_ID, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_TIMEOUT, NULL, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_METHOD_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBDEVICEMETHOD_41_015: [ IoTHubDeviceMethod_InvokeModuleAsync shall return IOTHUB_DEVICE_METHOD_INVALID_ARG if moduleId is NULL ]*/
+TEST_FUNCTION(IoTHubDeviceMethod_InvokeModuleAsync_return_IOTHUB_DEVICE_METHOD_INVALID_ARG_if_input_parameter_moduleId_is_NULL)
+{
+    ///act
+    IOTHUB_DEVICE_METHOD_RESULT result = IoTHubDeviceMethod_InvokeModuleAsync(TEST_IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE, TEST_DEVICE_ID, NULL, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_TIMEOUT, test_invoke_complete_callback, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_METHOD_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBDEVICEMETHOD_41_006: [ The first call of IoTHubDeviceMethod_Invoke(Module)Async shall create the lock and the condition shared with the workers by calling Lock_Init and Condition_Init ]*/
+/*Tests_SRS_IOTHUBDEVICEMETHOD_41_007: [ IoTHubDeviceMethod_Invoke(Module)Async shall copy deviceId, moduleId, methodName and methodPayload, queue the invocation and return IOTHUB_DEVICE_METHOD_OK ]*/
+/*Tests_SRS_IOTHUBDEVICEMETHOD_41_010: [ If there are more queued invocations than idle workers, a new worker shall be started by calling ThreadAPI_Create as long as fewer workers than maxConcurrentInvocations exist ]*/
+TEST_FUNCTION(IoTHubDeviceMethod_InvokeAsync_queues_the_invocation_and_starts_a_worker)
+{
+    ///arrange
+    IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE handle = IoTHubDeviceMethod_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+    ASSERT_IS_NOT_NULL(handle);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(Condition_Init());
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(gballoc_realloc(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+
+    ///act
+    IOTHUB_DEVICE_METHOD_RESULT result = IoTHubDeviceMethod_InvokeAsync(handle, TEST_DEVICE_ID, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_TIMEOUT, test_invoke_complete_callback, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_METHOD_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubDeviceMethod_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBDEVICEMETHOD_41_007: [ IoTHubDeviceMethod_Invoke(Module)Async shall copy deviceId, moduleId, methodName and methodPayload, queue the invocation and return IOTHUB_DEVICE_METHOD_OK ]*/
+TEST_FUNCTION(IoTHubDeviceMethod_InvokeModuleAsync_queues_the_invocation_and_starts_a_worker)
+{
+    ///arrange
+    IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE handle = IoTHubDeviceMethod_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+    ASSERT_IS_NOT_NULL(handle);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(Condition_Init());
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(gballoc_realloc(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+
+    ///act
+    IOTHUB_DEVICE_METHOD_RESULT result = IoTHubDeviceMethod_InvokeModuleAsync(handle, TEST_DEVICE_ID, TEST_MODULE_ID, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_TIMEOUT, test_invoke_complete_callback, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_METHOD_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubDeviceMethod_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBDEVICEMETHOD_41_008: [ If any of the calls fail IoTHubDeviceMethod_Invoke(Module)Async shall do clean up and return IOTHUB_DEVICE_METHOD_ERROR ]*/
+TEST_FUNCTION(IoTHubDeviceMethod_InvokeAsync_non_happy_path)
+{
+    ///arrange
+    IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE handle = IoTHubDeviceMethod_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+    ASSERT_IS_NOT_NULL(handle);
+    umock_c_reset_all_calls();
+
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(Condition_Init());
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+
+    umock_c_negative_tests_snapshot();
+
+    ///act
+    for (size_t i = 0; i < umock_c_negative_tests_call_count(); i++)
+    {
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(i);
+
+        IOTHUB_DEVICE_METHOD_RESULT result = IoTHubDeviceMethod_InvokeAsync(handle, TEST_DEVICE_ID, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_TIMEOUT, test_invoke_complete_callback, NULL);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_METHOD_ERROR, result);
+
+        ///cleanup
+        /*the async state is kept once created and no worker was started, drop it so every iteration creates it again*/
+        if (handle->async != NULL)
+        {
+            free(handle->async);
+            handle->async = NULL;
+        }
+    }
+
+    ///cleanup
+    umock_c_negative_tests_deinit();
+    IoTHubDeviceMethod_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBDEVICEMETHOD_41_016: [ If serviceClientDeviceMethodHandle is NULL or maxConcurrentInvocations is 0 IoTHubDeviceMethod_SetMaxConcurrentInvocations shall return IOTHUB_DEVICE_METHOD_INVALID_ARG ]*/
+TEST_FUNCTION(IoTHubDeviceMethod_SetMaxConcurrentInvocations_return_IOTHUB_DEVICE_METHOD_INVALID_ARG_if_maxConcurrentInvocations_is_0)
+{
+    ///act
+    IOTHUB_DEVICE_METHOD_RESULT result = IoTHubDeviceMethod_SetMaxConcurrentInvocations(TEST_IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE, 0);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_METHOD_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBDEVICEMETHOD_41_017: [ IoTHubDeviceMethod_SetMaxConcurrentInvocations shall change the number of invocations executed at the same time, applying to the invocations that are not executing yet ]*/
+TEST_FUNCTION(IoTHubDeviceMethod_SetMaxConcurrentInvocations_limits_the_number_of_workers)
+{
+    ///arrange
+    IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE handle = IoTHubDeviceMethod_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+    ASSERT_IS_NOT_NULL(handle);
+    ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_METHOD_OK, IoTHubDeviceMethod_SetMaxConcurrentInvocations(handle, 1));
+    ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_METHOD_OK, IoTHubDeviceMethod_InvokeAsync(handle, TEST_DEVICE_ID, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_TIMEOUT, test_invoke_complete_callback, NULL));
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+
+    ///act
+    IOTHUB_DEVICE_METHOD_RESULT result = IoTHubDeviceMethod_InvokeAsync(handle, TEST_DEVICE_ID, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_TIMEOUT, test_invoke_complete_callback, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_METHOD_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubDeviceMethod_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBDEVICEMETHOD_41_011: [ If ThreadAPI_Create fails the invocations shall stay queued and starting a worker shall be retried by the next IoTHubDeviceMethod_Invoke(Module)Async or IoTHubDeviceMethod_DoWork ]*/
+/*Tests_SRS_IOTHUBDEVICEMETHOD_41_021: [ IoTHubDeviceMethod_DoWork shall take the completed invocations, retry starting workers for the queued ones, and call the callbacks after releasing the lock, freeing the response payload once the callback returns ]*/
+TEST_FUNCTION(IoTHubDeviceMethod_DoWork_retries_starting_a_worker)
+{
+    ///arrange
+    IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE handle = IoTHubDeviceMethod_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+    ASSERT_IS_NOT_NULL(handle);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(Condition_Init());
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(gballoc_realloc(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments()
+        .SetReturn(THREADAPI_ERROR);
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_METHOD_OK, IoTHubDeviceMethod_InvokeAsync(handle, TEST_DEVICE_ID, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_TIMEOUT, test_invoke_complete_callback, NULL));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(gballoc_realloc(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+
+    ///act
+    IoTHubDeviceMethod_DoWork(handle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubDeviceMethod_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBDEVICEMETHOD_41_018: [ If serviceClientDeviceMethodHandle is NULL or no asynchronous invocation has been queued IoTHubDeviceMethod_DoWork shall return ]*/
+TEST_FUNCTION(IoTHubDeviceMethod_DoWork_does_nothing_if_no_invocation_has_been_queued)
+{
+    ///arrange
+    IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE handle = IoTHubDeviceMethod_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+    ASSERT_IS_NOT_NULL(handle);
+    umock_c_reset_all_calls();
+
+    ///act
+    IoTHubDeviceMethod_DoWork(NULL);
+    IoTHubDeviceMethod_DoWork(handle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubDeviceMethod_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBDEVICEMETHOD_41_019: [ IoTHubDeviceMethod_Destroy shall stop the workers and wait for the invocations they are executing by calling ThreadAPI_Join ]*/
+/*Tests_SRS_IOTHUBDEVICEMETHOD_41_020: [ IoTHubDeviceMethod_Destroy shall call the callbacks of the completed invocations with their result and of the queued ones with IOTHUB_DEVICE_METHOD_ERROR ]*/
+TEST_FUNCTION(IoTHubDeviceMethod_Destroy_reports_the_queued_invocations)
+{
+    ///arrange
+    IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE handle = IoTHubDeviceMethod_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+    ASSERT_IS_NOT_NULL(handle);
+    ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_METHOD_OK, IoTHubDeviceMethod_InvokeAsync(handle, TEST_DEVICE_ID, TEST_METHOD_NAME, TEST_METHOD_PAYLOAD, TEST_TIMEOUT, test_invoke_complete_callback, (void*)0x4c4c));
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(ThreadAPI_Join(TEST_THREAD_HANDLE, IGNORED_PTR_ARG))
+        .IgnoreArgument_res();
+    STRICT_EXPECTED_CALL(test_invoke_complete_callback((void*)0x4c4c, IOTHUB_DEVICE_METHOD_ERROR, 0, NULL, 0));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Condition_Deinit(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Lock_Deinit(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    IoTHubDeviceMethod_Destroy(handle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
 END_TEST_SUITE(iothub_devicemethod_ut)
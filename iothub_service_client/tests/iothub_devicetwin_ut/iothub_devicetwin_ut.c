@@ -54,7 +54,24 @@ static int my_mallocAndStrcpy_s(char** destination, const char* source)
 #include "azure_c_shared_utility/httpheaders.h"
 #include "azure_c_shared_utility/httpapiex.h"
 #include "azure_c_shared_utility/httpapiexsas.h"
+#include "internal/iothub_sc_http_pool.h"
 #include "azure_c_shared_utility/uniqueid.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "parson.h"
+
+MOCKABLE_FUNCTION(, JSON_Value*, json_value_init_object);
+MOCKABLE_FUNCTION(, JSON_Object*, json_value_get_object, const JSON_Value *, value);
+MOCKABLE_FUNCTION(, JSON_Status, json_object_set_string, JSON_Object*, object, const char*, name, const char*, string);
+MOCKABLE_FUNCTION(, char*, json_serialize_to_string, const JSON_Value*, value);
+MOCKABLE_FUNCTION(, void, json_free_serialized_string, char*, string);
+MOCKABLE_FUNCTION(, JSON_Value*, json_parse_string, const char *, string);
+MOCKABLE_FUNCTION(, JSON_Array*, json_value_get_array, const JSON_Value*, value);
+MOCKABLE_FUNCTION(, size_t, json_array_get_count, const JSON_Array*, array);
+MOCKABLE_FUNCTION(, JSON_Value*, json_array_get_value, const JSON_Array*, array, size_t, index);
+MOCKABLE_FUNCTION(, size_t, json_serialization_size, const JSON_Value*, value);
+MOCKABLE_FUNCTION(, JSON_Status, json_serialize_to_buffer, const JSON_Value*, value, char*, buf, size_t, buf_size_in_bytes);
+MOCKABLE_FUNCTION(, void, json_value_free, JSON_Value *, value);
 
 #undef ENABLE_MOCKS
 
@@ -68,6 +85,10 @@ TEST_DEFINE_ENUM_TYPE(HTTP_HEADERS_RESULT, HTTP_HEADERS_RESULT_VALUES);
 IMPLEMENT_UMOCK_C_ENUM_TYPE(HTTP_HEADERS_RESULT, HTTP_HEADERS_RESULT_VALUES);
 TEST_DEFINE_ENUM_TYPE(HTTPAPI_REQUEST_TYPE, HTTPAPI_REQUEST_TYPE_VALUES);
 IMPLEMENT_UMOCK_C_ENUM_TYPE(HTTPAPI_REQUEST_TYPE, HTTPAPI_REQUEST_TYPE_VALUES);
+TEST_DEFINE_ENUM_TYPE(LOCK_RESULT, LOCK_RESULT_VALUES);
+IMPLEMENT_UMOCK_C_ENUM_TYPE(LOCK_RESULT, LOCK_RESULT_VALUES);
+TEST_DEFINE_ENUM_TYPE(THREADAPI_RESULT, THREADAPI_RESULT_VALUES);
+IMPLEMENT_UMOCK_C_ENUM_TYPE(THREADAPI_RESULT, THREADAPI_RESULT_VALUES);
 
 static unsigned char* TEST_UNSIGNED_CHAR_PTR = (unsigned char*)"TestString";
 
@@ -141,19 +162,74 @@ void my_HTTPAPIEX_SAS_Destroy(HTTPAPIEX_SAS_HANDLE handle)
     my_gballoc_free(handle);
 }
 
+static unsigned char TEST_RESPONSE_BUFFER[16];
+
+unsigned char* my_BUFFER_u_char(BUFFER_HANDLE handle)
+{
+    (void)handle;
+    return TEST_RESPONSE_BUFFER;
+}
+
+static char TEST_QUERY_JSON[] = "{\"query\":\"SELECT * FROM devices\"}";
+
+char* my_json_serialize_to_string(const JSON_Value *value)
+{
+    (void)value;
+    return TEST_QUERY_JSON;
+}
+
+JSON_Status my_json_serialize_to_buffer(const JSON_Value* value, char* buf, size_t buf_size_in_bytes)
+{
+    (void)value;
+    (void)buf_size_in_bytes;
+    strcpy(buf, "{}");
+    return JSONSuccess;
+}
+
 #include "iothub_devicetwin.h"
 #include "iothub_service_client_auth.h"
 
+TEST_DEFINE_ENUM_TYPE(IOTHUB_DEVICE_TWIN_RESULT, IOTHUB_DEVICE_TWIN_RESULT_VALUES);
+
 typedef struct IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_TAG
 {
     char* hostname;
     char* sharedAccessKey;
     char* keyName;
+    IOTHUB_SC_HTTP_POOL_HANDLE httpPool;
 } IOTHUB_SERVICE_CLIENT_DEVICE_TWIN;
 
 static IOTHUB_SERVICE_CLIENT_AUTH TEST_IOTHUB_SERVICE_CLIENT_AUTH;
 static IOTHUB_SERVICE_CLIENT_AUTH_HANDLE TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE = &TEST_IOTHUB_SERVICE_CLIENT_AUTH;
 
+static IOTHUB_SC_HTTP_POOL_HANDLE TEST_IOTHUB_SC_HTTP_POOL_HANDLE = (IOTHUB_SC_HTTP_POOL_HANDLE)0x4848;
+
+static LOCK_HANDLE TEST_LOCK_HANDLE = (LOCK_HANDLE)0x4949;
+static THREAD_HANDLE TEST_THREAD_HANDLE = (THREAD_HANDLE)0x4b4b;
+
+static JSON_Value* TEST_JSON_VALUE = (JSON_Value*)0x5050;
+static JSON_Object* TEST_JSON_OBJECT = (JSON_Object*)0x5151;
+static JSON_Array* TEST_JSON_ARRAY = (JSON_Array*)0x5252;
+
+static THREADAPI_RESULT my_ThreadAPI_Create(THREAD_HANDLE* threadHandle, THREAD_START_FUNC func, void* arg)
+{
+    (void)func;
+    (void)arg;
+    *threadHandle = TEST_THREAD_HANDLE;
+    return THREADAPI_OK;
+}
+
+static size_t g_twin_callback_count;
+static bool g_twin_callback_result;
+
+static bool my_twin_query_callback(void* context, const char* twinJson)
+{
+    (void)context;
+    ASSERT_ARE_EQUAL(char_ptr, "{}", twinJson);
+    g_twin_callback_count++;
+    return g_twin_callback_result;
+}
+
 static IOTHUB_SERVICE_CLIENT_DEVICE_TWIN TEST_IOTHUB_SERVICE_CLIENT_DEVICE_TWIN;
 static IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE TEST_IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE = &TEST_IOTHUB_SERVICE_CLIENT_DEVICE_TWIN;
 
@@ -237,12 +313,21 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_UMOCK_ALIAS_TYPE(HTTP_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(HTTPAPIEX_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(HTTPAPIEX_SAS_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_SC_HTTP_POOL_HANDLE, void*);
+    REGISTER_TYPE(LOCK_RESULT, LOCK_RESULT);
+    REGISTER_TYPE(THREADAPI_RESULT, THREADAPI_RESULT);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(THREAD_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(THREAD_START_FUNC, void*);
 
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
 
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
 
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_realloc, my_gballoc_realloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_realloc, NULL);
+
     REGISTER_GLOBAL_MOCK_HOOK(mallocAndStrcpy_s, my_mallocAndStrcpy_s);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(mallocAndStrcpy_s, 42);
 
@@ -259,12 +344,21 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
 
     REGISTER_GLOBAL_MOCK_HOOK(BUFFER_delete, my_BUFFER_delete);
 
+    REGISTER_GLOBAL_MOCK_RETURN(BUFFER_enlarge, 0);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(BUFFER_enlarge, __LINE__);
+
+    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_u_char, my_BUFFER_u_char);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(BUFFER_u_char, NULL);
+
     REGISTER_GLOBAL_MOCK_HOOK(HTTPHeaders_Alloc, my_HTTPHeaders_Alloc);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(HTTPHeaders_Alloc, NULL);
 
     REGISTER_GLOBAL_MOCK_HOOK(HTTPHeaders_Free, my_HTTPHeaders_Free);
     REGISTER_GLOBAL_MOCK_RETURN(HTTPHeaders_AddHeaderNameValuePair, HTTP_HEADERS_OK);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(HTTPHeaders_AddHeaderNameValuePair, HTTP_HEADERS_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(HTTPHeaders_ReplaceHeaderNameValuePair, HTTP_HEADERS_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(HTTPHeaders_ReplaceHeaderNameValuePair, HTTP_HEADERS_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(HTTPHeaders_FindHeaderValue, NULL);
 
     REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_Create, my_HTTPAPIEX_Create);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(HTTPAPIEX_Create, NULL);
@@ -279,8 +373,45 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_GLOBAL_MOCK_RETURN(HTTPAPIEX_SAS_ExecuteRequest, HTTPAPIEX_OK);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(HTTPAPIEX_SAS_ExecuteRequest, HTTPAPIEX_ERROR);
 
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubSCHttpPool_Create, TEST_IOTHUB_SC_HTTP_POOL_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubSCHttpPool_Create, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubSCHttpPool_Clone, TEST_IOTHUB_SC_HTTP_POOL_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubSCHttpPool_Clone, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubSCHttpPool_ExecuteRequest, HTTPAPIEX_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubSCHttpPool_ExecuteRequest, HTTPAPIEX_ERROR);
+
     REGISTER_GLOBAL_MOCK_RETURN(UniqueId_Generate, UNIQUEID_OK);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(UniqueId_Generate, UNIQUEID_ERROR);
+
+    REGISTER_GLOBAL_MOCK_RETURN(Lock_Init, TEST_LOCK_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock_Init, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock, LOCK_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock_Deinit, LOCK_OK);
+
+    REGISTER_GLOBAL_MOCK_HOOK(ThreadAPI_Create, my_ThreadAPI_Create);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(ThreadAPI_Create, THREADAPI_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(ThreadAPI_Join, THREADAPI_OK);
+
+    REGISTER_GLOBAL_MOCK_RETURN(json_value_init_object, TEST_JSON_VALUE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(json_value_init_object, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(json_value_get_object, TEST_JSON_OBJECT);
+    REGISTER_GLOBAL_MOCK_RETURN(json_object_set_string, JSONSuccess);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(json_object_set_string, JSONFailure);
+    REGISTER_GLOBAL_MOCK_HOOK(json_serialize_to_string, my_json_serialize_to_string);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(json_serialize_to_string, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(json_parse_string, TEST_JSON_VALUE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(json_parse_string, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(json_value_get_array, TEST_JSON_ARRAY);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(json_value_get_array, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(json_array_get_count, 1);
+    REGISTER_GLOBAL_MOCK_RETURN(json_array_get_value, TEST_JSON_VALUE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(json_array_get_value, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(json_serialization_size, 3);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(json_serialization_size, 0);
+    REGISTER_GLOBAL_MOCK_HOOK(json_serialize_to_buffer, my_json_serialize_to_buffer);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(json_serialize_to_buffer, JSONFailure);
 }
 
 TEST_SUITE_CLEANUP(TestClassCleanup)
@@ -303,7 +434,11 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
     TEST_IOTHUB_SERVICE_CLIENT_AUTH.iothubSuffix = TEST_IOTHUBSUFFIX;
     TEST_IOTHUB_SERVICE_CLIENT_AUTH.keyName = TEST_SHAREDACCESSKEYNAME;
     TEST_IOTHUB_SERVICE_CLIENT_AUTH.sharedAccessKey = TEST_SHAREDACCESSKEY;
+    TEST_IOTHUB_SERVICE_CLIENT_AUTH.httpPool = NULL;
+    TEST_IOTHUB_SERVICE_CLIENT_DEVICE_TWIN.httpPool = NULL;
 
+    g_twin_callback_count = 0;
+    g_twin_callback_result = true;
 }
 
 TEST_FUNCTION_CLEANUP(TestMethodCleanup)
@@ -517,6 +652,84 @@ TEST_FUNCTION(IoTHubDeviceTwin_Destroy_do_clean_up_and_return_if_input_parameter
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 }
 
+/*Tests_SRS_IOTHUBDEVICETWIN_41_001: [ If serviceClientHandle has an HTTP connection pool, IoTHubDeviceTwin_Create shall share it by calling IoTHubSCHttpPool_Clone ]*/
+TEST_FUNCTION(IoTHubDeviceTwin_Create_shares_the_http_pool_of_the_service_client)
+{
+    ///arrange
+    TEST_IOTHUB_SERVICE_CLIENT_AUTH.httpPool = TEST_IOTHUB_SC_HTTP_POOL_HANDLE;
+
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubSCHttpPool_Clone(TEST_IOTHUB_SC_HTTP_POOL_HANDLE));
+
+    ///act
+    IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE result = IoTHubDeviceTwin_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(void_ptr, TEST_IOTHUB_SC_HTTP_POOL_HANDLE, result->httpPool);
+
+    ///cleanup
+    if (result != NULL)
+    {
+        free(result->hostname);
+        free(result->keyName);
+        free(result->sharedAccessKey);
+        free(result);
+    }
+}
+
+/*Tests_SRS_IOTHUBDEVICETWIN_41_002: [ If the IoTHubSCHttpPool_Clone fails, IoTHubDeviceTwin_Create shall do clean up and return NULL. ]*/
+TEST_FUNCTION(IoTHubDeviceTwin_Create_returns_NULL_if_IoTHubSCHttpPool_Clone_fails)
+{
+    ///arrange
+    TEST_IOTHUB_SERVICE_CLIENT_AUTH.httpPool = TEST_IOTHUB_SC_HTTP_POOL_HANDLE;
+
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubSCHttpPool_Clone(TEST_IOTHUB_SC_HTTP_POOL_HANDLE))
+        .SetReturn(NULL);
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    ///act
+    IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE result = IoTHubDeviceTwin_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBDEVICETWIN_41_004: [ IoTHubDeviceTwin_Destroy shall release its reference to the HTTP connection pool by calling IoTHubSCHttpPool_Destroy ]*/
+TEST_FUNCTION(IoTHubDeviceTwin_Destroy_releases_the_http_pool)
+{
+    ///arrange
+    TEST_IOTHUB_SERVICE_CLIENT_AUTH.httpPool = TEST_IOTHUB_SC_HTTP_POOL_HANDLE;
+    IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE handle = IoTHubDeviceTwin_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+    ASSERT_IS_NOT_NULL(handle);
+
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(IoTHubSCHttpPool_Destroy(TEST_IOTHUB_SC_HTTP_POOL_HANDLE));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    ///act
+    IoTHubDeviceTwin_Destroy(handle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
 /*Tests_SRS_IOTHUBDEVICETWIN_12_018: [ IoTHubDeviceTwin_GetTwin shall verify the input parameters and if any of them are NULL then return NULL ]*/
 TEST_FUNCTION(IoTHubDeviceTwin_GetTwin_return_NULL_if_input_parameter_serviceClientDeviceTwinHandle_is_NULL)
 {
@@ -666,6 +879,60 @@ TEST_FUNCTION(IoTHubDeviceTwin_GetTwin_happy_path_status_code_400)
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 }
 
+/*Tests_SRS_IOTHUBDEVICETWIN_41_003: [ If the handle shares an HTTP connection pool, the request shall be executed on a pooled keep-alive connection with the cached SAS token by calling IoTHubSCHttpPool_ExecuteRequest instead of creating an HTTPAPIEX_SAS_HANDLE and an HTTPAPIEX_HANDLE per request ]*/
+TEST_FUNCTION(IoTHubDeviceTwin_GetTwin_executes_the_request_on_the_http_pool)
+{
+    // arrange
+    TEST_IOTHUB_SERVICE_CLIENT_DEVICE_TWIN.httpPool = TEST_IOTHUB_SC_HTTP_POOL_HANDLE;
+
+    EXPECTED_CALL(BUFFER_new());
+
+    EXPECTED_CALL(HTTPHeaders_Alloc());
+    EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_AUTHORIZATION, TEST_HTTP_HEADER_VAL_AUTHORIZATION))
+        .IgnoreArgument(1);
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    EXPECTED_CALL(UniqueId_Generate(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_REQUEST_ID, TEST_HTTP_HEADER_VAL_REQUEST_ID))
+        .IgnoreArgument(1);
+    EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_USER_AGENT, IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_ACCEPT, TEST_HTTP_HEADER_VAL_ACCEPT))
+        .IgnoreArgument(1);
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+
+    STRICT_EXPECTED_CALL(IoTHubSCHttpPool_ExecuteRequest(TEST_IOTHUB_SC_HTTP_POOL_HANDLE, HTTPAPI_REQUEST_GET, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG))
+        .IgnoreArgument_relativePath()
+        .IgnoreArgument_requestHttpHeadersHandle()
+        .IgnoreArgument_requestContent()
+        .IgnoreArgument_statusCode()
+        .IgnoreArgument_responseContent()
+        .CopyOutArgumentBuffer_statusCode(&httpStatusCodeOk, sizeof(httpStatusCodeOk))
+        .SetReturn(HTTPAPIEX_OK);
+
+    EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(NULL));
+    STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_Destroy(NULL));
+    EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(NULL));
+    STRICT_EXPECTED_CALL(STRING_delete(NULL));
+    STRICT_EXPECTED_CALL(STRING_delete(NULL));
+
+    set_expected_calls_for_GetDeviceOrModuleTwin_processing();
+
+    // act
+    const char* deviceId = " ";
+    char* result = IoTHubDeviceTwin_GetTwin(TEST_IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE, deviceId);
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    free((void*)result);
+}
+
 /*Tests_SRS_IOTHUBDEVICETWIN_12_024: [ If any of the call fails during the HTTP creation IoTHubDeviceTwin_GetTwin shall fail and return NULL ]*/
 /*Tests_SRS_IOTHUBDEVICETWIN_12_025: [ If any of the HTTPAPI call fails IoTHubDeviceTwin_GetTwin shall fail and return NULL ]*/
 /*Tests_SRS_IOTHUBDEVICETWIN_12_026: [ IoTHubDeviceTwin_GetTwin shall verify the received HTTP status code and if it is not equal to 200 then return NULL ]*/
@@ -1055,4 +1322,402 @@ TEST_FUNCTION(IoTHubDeviceTwin_UpdateModuleTwin_happy_path_status_code_200)
     free((void*)result);
 }
 
+static void set_expected_calls_for_createHttpHeader(bool update_twin)
+{
+    EXPECTED_CALL(HTTPHeaders_Alloc());
+    EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_AUTHORIZATION, TEST_HTTP_HEADER_VAL_AUTHORIZATION))
+        .IgnoreArgument(1);
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    EXPECTED_CALL(UniqueId_Generate(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_REQUEST_ID, TEST_HTTP_HEADER_VAL_REQUEST_ID))
+        .IgnoreArgument(1);
+    EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_USER_AGENT, IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_CONTENT_TYPE, TEST_HTTP_HEADER_VAL_CONTENT_TYPE))
+        .IgnoreArgument(1);
+    if (update_twin)
+    {
+        EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_IFMATCH, TEST_HTTP_HEADER_VAL_IFMATCH))
+            .IgnoreArgument(1);
+    }
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+}
+
+static void set_expected_calls_for_QueryTwins_page(const char* continuationToken, const char* nextContinuationToken, size_t twinCount)
+{
+    size_t i;
+
+    set_expected_calls_for_createHttpHeader(false);
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "x-ms-max-item-count", "100"))
+        .IgnoreArgument(1);
+    if (continuationToken != NULL)
+    {
+        STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "x-ms-continuation", continuationToken))
+            .IgnoreArgument(1);
+    }
+    EXPECTED_CALL(HTTPHeaders_Alloc());
+    EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubSCHttpPool_ExecuteRequest(TEST_IOTHUB_SC_HTTP_POOL_HANDLE, HTTPAPI_REQUEST_POST, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument_relativePath()
+        .IgnoreArgument_requestHttpHeadersHandle()
+        .IgnoreArgument_requestContent()
+        .IgnoreArgument_statusCode()
+        .IgnoreArgument_responseHttpHeadersHandle()
+        .IgnoreArgument_responseContent()
+        .CopyOutArgumentBuffer_statusCode(&httpStatusCodeOk, sizeof(httpStatusCodeOk))
+        .SetReturn(HTTPAPIEX_OK);
+    STRICT_EXPECTED_CALL(HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "x-ms-continuation"))
+        .IgnoreArgument(1)
+        .SetReturn(nextContinuationToken);
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    if (nextContinuationToken != NULL)
+    {
+        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, nextContinuationToken))
+            .IgnoreArgument(1);
+    }
+    EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG));
+    EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG));
+
+    EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_enlarge(IGNORED_PTR_ARG, 1))
+        .IgnoreArgument(1);
+    EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG));
+    EXPECTED_CALL(json_parse_string(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(json_value_get_array(TEST_JSON_VALUE));
+    STRICT_EXPECTED_CALL(json_array_get_count(TEST_JSON_ARRAY))
+        .SetReturn(twinCount);
+    for (i = 0; i < twinCount; i++)
+    {
+        STRICT_EXPECTED_CALL(json_array_get_value(TEST_JSON_ARRAY, i));
+        STRICT_EXPECTED_CALL(json_serialization_size(TEST_JSON_VALUE));
+        if (i == 0)
+        {
+            EXPECTED_CALL(gballoc_realloc(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+        }
+        STRICT_EXPECTED_CALL(json_serialize_to_buffer(TEST_JSON_VALUE, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+            .IgnoreArgument_buf()
+            .IgnoreArgument_buf_size_in_bytes();
+    }
+    STRICT_EXPECTED_CALL(json_value_free(TEST_JSON_VALUE));
+}
+
+static void set_expected_calls_for_QueryTwins_begin(void)
+{
+    EXPECTED_CALL(json_value_init_object());
+    STRICT_EXPECTED_CALL(json_value_get_object(TEST_JSON_VALUE));
+    STRICT_EXPECTED_CALL(json_object_set_string(TEST_JSON_OBJECT, "query", "SELECT * FROM devices"));
+    STRICT_EXPECTED_CALL(json_serialize_to_string(TEST_JSON_VALUE));
+    EXPECTED_CALL(BUFFER_create(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    EXPECTED_CALL(BUFFER_new());
+    STRICT_EXPECTED_CALL(IoTHubSCHttpPool_Clone(TEST_IOTHUB_SC_HTTP_POOL_HANDLE));
+}
+
+static void set_expected_calls_for_QueryTwins_end(void)
+{
+    STRICT_EXPECTED_CALL(IoTHubSCHttpPool_Destroy(TEST_IOTHUB_SC_HTTP_POOL_HANDLE));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+    EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(json_free_serialized_string(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(json_value_free(TEST_JSON_VALUE));
+}
+
+/*Tests_SRS_IOTHUBDEVICETWIN_41_005: [ If serviceClientDeviceTwinHandle, query or twinCallback is NULL, or pageSize is not between 1 and 1000, IoTHubDeviceTwin_QueryTwins shall return IOTHUB_DEVICE_TWIN_INVALID_ARG ]*/
+TEST_FUNCTION(IoTHubDeviceTwin_QueryTwins_return_INVALID_ARG_if_input_parameter_serviceClientDeviceTwinHandle_is_NULL)
+{
+    // act
+    IOTHUB_DEVICE_TWIN_RESULT result = IoTHubDeviceTwin_QueryTwins(NULL, "SELECT * FROM devices", 100, my_twin_query_callback, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_DEVICE_TWIN_RESULT, IOTHUB_DEVICE_TWIN_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBDEVICETWIN_41_005: [ If serviceClientDeviceTwinHandle, query or twinCallback is NULL, or pageSize is not between 1 and 1000, IoTHubDeviceTwin_QueryTwins shall return IOTHUB_DEVICE_TWIN_INVALID_ARG ]*/
+TEST_FUNCTION(IoTHubDeviceTwin_QueryTwins_return_INVALID_ARG_if_input_parameter_query_is_NULL)
+{
+    // act
+    IOTHUB_DEVICE_TWIN_RESULT result = IoTHubDeviceTwin_QueryTwins(TEST_IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE, NULL, 100, my_twin_query_callback, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_DEVICE_TWIN_RESULT, IOTHUB_DEVICE_TWIN_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBDEVICETWIN_41_005: [ If serviceClientDeviceTwinHandle, query or twinCallback is NULL, or pageSize is not between 1 and 1000, IoTHubDeviceTwin_QueryTwins shall return IOTHUB_DEVICE_TWIN_INVALID_ARG ]*/
+TEST_FUNCTION(IoTHubDeviceTwin_QueryTwins_return_INVALID_ARG_if_input_parameter_twinCallback_is_NULL)
+{
+    // act
+    IOTHUB_DEVICE_TWIN_RESULT result = IoTHubDeviceTwin_QueryTwins(TEST_IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE, "SELECT * FROM devices", 100, NULL, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_DEVICE_TWIN_RESULT, IOTHUB_DEVICE_TWIN_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBDEVICETWIN_41_005: [ If serviceClientDeviceTwinHandle, query or twinCallback is NULL, or pageSize is not between 1 and 1000, IoTHubDeviceTwin_QueryTwins shall return IOTHUB_DEVICE_TWIN_INVALID_ARG ]*/
+TEST_FUNCTION(IoTHubDeviceTwin_QueryTwins_return_INVALID_ARG_if_pageSize_is_out_of_range)
+{
+    // act
+    IOTHUB_DEVICE_TWIN_RESULT result_zero = IoTHubDeviceTwin_QueryTwins(TEST_IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE, "SELECT * FROM devices", 0, my_twin_query_callback, NULL);
+    IOTHUB_DEVICE_TWIN_RESULT result_too_large = IoTHubDeviceTwin_QueryTwins(TEST_IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE, "SELECT * FROM devices", 1001, my_twin_query_callback, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_DEVICE_TWIN_RESULT, IOTHUB_DEVICE_TWIN_INVALID_ARG, result_zero);
+    ASSERT_ARE_EQUAL(IOTHUB_DEVICE_TWIN_RESULT, IOTHUB_DEVICE_TWIN_INVALID_ARG, result_too_large);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBDEVICETWIN_41_006: [ IoTHubDeviceTwin_QueryTwins shall serialize the query once into a {"query":...} JSon body and allocate one response buffer by calling BUFFER_new, both reused for every page ]*/
+/*Tests_SRS_IOTHUBDEVICETWIN_41_007: [ IoTHubDeviceTwin_QueryTwins shall execute the pages on the HTTP connection pool of the handle, or on one created by calling IoTHubSCHttpPool_Create for the duration of the query if the handle has none ]*/
+/*Tests_SRS_IOTHUBDEVICETWIN_41_008: [ IoTHubDeviceTwin_QueryTwins shall request every page with an HTTP POST of the query to url/devices/query, adding the x-ms-max-item-count header set to pageSize to the headers used by IoTHubDeviceTwin_GetTwin ]*/
+/*Tests_SRS_IOTHUBDEVICETWIN_41_010: [ IoTHubDeviceTwin_QueryTwins shall call twinCallback once per twin of the page, serializing each twin into one buffer reused for the whole query ]*/
+TEST_FUNCTION(IoTHubDeviceTwin_QueryTwins_happy_path_single_page)
+{
+    // arrange
+    TEST_IOTHUB_SERVICE_CLIENT_DEVICE_TWIN.httpPool = TEST_IOTHUB_SC_HTTP_POOL_HANDLE;
+
+    set_expected_calls_for_QueryTwins_begin();
+    set_expected_calls_for_QueryTwins_page(NULL, NULL, 2);
+    set_expected_calls_for_QueryTwins_end();
+
+    // act
+    IOTHUB_DEVICE_TWIN_RESULT result = IoTHubDeviceTwin_QueryTwins(TEST_IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE, "SELECT * FROM devices", 100, my_twin_query_callback, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_DEVICE_TWIN_RESULT, IOTHUB_DEVICE_TWIN_OK, result);
+    ASSERT_ARE_EQUAL(size_t, 2, g_twin_callback_count);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBDEVICETWIN_41_009: [ Every page after the first one shall be requested with the x-ms-continuation header set to the continuation token returned with the previous page, and the query shall end after the first page that comes back without one ]*/
+TEST_FUNCTION(IoTHubDeviceTwin_QueryTwins_follows_the_continuation_token)
+{
+    // arrange
+    TEST_IOTHUB_SERVICE_CLIENT_DEVICE_TWIN.httpPool = TEST_IOTHUB_SC_HTTP_POOL_HANDLE;
+
+    set_expected_calls_for_QueryTwins_begin();
+    set_expected_calls_for_QueryTwins_page(NULL, "theContinuationToken", 1);
+    set_expected_calls_for_QueryTwins_page("theContinuationToken", NULL, 1);
+    set_expected_calls_for_QueryTwins_end();
+
+    // act
+    IOTHUB_DEVICE_TWIN_RESULT result = IoTHubDeviceTwin_QueryTwins(TEST_IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE, "SELECT * FROM devices", 100, my_twin_query_callback, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_DEVICE_TWIN_RESULT, IOTHUB_DEVICE_TWIN_OK, result);
+    ASSERT_ARE_EQUAL(size_t, 2, g_twin_callback_count);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBDEVICETWIN_41_013: [ If twinCallback returns false IoTHubDeviceTwin_QueryTwins shall not call it again, shall not request any further page and shall return IOTHUB_DEVICE_TWIN_OK ]*/
+TEST_FUNCTION(IoTHubDeviceTwin_QueryTwins_stops_when_the_callback_returns_false)
+{
+    // arrange
+    TEST_IOTHUB_SERVICE_CLIENT_DEVICE_TWIN.httpPool = TEST_IOTHUB_SC_HTTP_POOL_HANDLE;
+    g_twin_callback_result = false;
+
+    set_expected_calls_for_QueryTwins_begin();
+    set_expected_calls_for_QueryTwins_page(NULL, "theContinuationToken", 1);
+    set_expected_calls_for_QueryTwins_end();
+
+    // act
+    IOTHUB_DEVICE_TWIN_RESULT result = IoTHubDeviceTwin_QueryTwins(TEST_IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE, "SELECT * FROM devices", 100, my_twin_query_callback, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_DEVICE_TWIN_RESULT, IOTHUB_DEVICE_TWIN_OK, result);
+    ASSERT_ARE_EQUAL(size_t, 1, g_twin_callback_count);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBDEVICETWIN_41_012: [ If the received HTTP status code is not 200, or a page is not a JSon array, IoTHubDeviceTwin_QueryTwins shall stop and return IOTHUB_DEVICE_TWIN_ERROR ]*/
+TEST_FUNCTION(IoTHubDeviceTwin_QueryTwins_return_ERROR_if_status_code_is_not_200)
+{
+    // arrange
+    TEST_IOTHUB_SERVICE_CLIENT_DEVICE_TWIN.httpPool = TEST_IOTHUB_SC_HTTP_POOL_HANDLE;
+
+    set_expected_calls_for_QueryTwins_begin();
+    set_expected_calls_for_createHttpHeader(false);
+    EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(HTTPHeaders_Alloc());
+    EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    EXPECTED_CALL(IoTHubSCHttpPool_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_POST, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer_statusCode(&httpStatusCodeBadRequest, sizeof(httpStatusCodeBadRequest))
+        .SetReturn(HTTPAPIEX_OK);
+    EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG));
+    EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG));
+    set_expected_calls_for_QueryTwins_end();
+
+    // act
+    IOTHUB_DEVICE_TWIN_RESULT result = IoTHubDeviceTwin_QueryTwins(TEST_IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE, "SELECT * FROM devices", 100, my_twin_query_callback, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_DEVICE_TWIN_RESULT, IOTHUB_DEVICE_TWIN_ERROR, result);
+    ASSERT_ARE_EQUAL(size_t, 0, g_twin_callback_count);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+static void set_expected_calls_for_executeTwinUpdate(const char* eTag, const unsigned int* httpStatusCode)
+{
+    set_expected_calls_for_createHttpHeader(true);
+    if (eTag != NULL)
+    {
+        EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_IFMATCH, IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .IgnoreArgument(3);
+    }
+    EXPECTED_CALL(BUFFER_create(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubSCHttpPool_ExecuteRequest(TEST_IOTHUB_SC_HTTP_POOL_HANDLE, HTTPAPI_REQUEST_PATCH, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, NULL))
+        .IgnoreArgument_relativePath()
+        .IgnoreArgument_requestHttpHeadersHandle()
+        .IgnoreArgument_requestContent()
+        .IgnoreArgument_statusCode()
+        .CopyOutArgumentBuffer_statusCode(httpStatusCode, sizeof(*httpStatusCode))
+        .SetReturn(HTTPAPIEX_OK);
+    EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+    EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG));
+}
+
+static void set_expected_calls_for_twinUpdateWorker_take(void)
+{
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+}
+
+/*Tests_SRS_IOTHUBDEVICETWIN_41_014: [ If serviceClientDeviceTwinHandle or updates is NULL, or maxConcurrentUpdates is 0, IoTHubDeviceTwin_UpdateTwins shall return IOTHUB_DEVICE_TWIN_INVALID_ARG ]*/
+TEST_FUNCTION(IoTHubDeviceTwin_UpdateTwins_return_INVALID_ARG_if_input_parameter_is_invalid)
+{
+    // arrange
+    IOTHUB_DEVICE_TWIN_UPDATE update = { "theDeviceId", NULL, "{}", NULL, IOTHUB_DEVICE_TWIN_OK, 0 };
+
+    // act
+    IOTHUB_DEVICE_TWIN_RESULT result_null_handle = IoTHubDeviceTwin_UpdateTwins(NULL, &update, 1, 1);
+    IOTHUB_DEVICE_TWIN_RESULT result_null_updates = IoTHubDeviceTwin_UpdateTwins(TEST_IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE, NULL, 1, 1);
+    IOTHUB_DEVICE_TWIN_RESULT result_no_concurrency = IoTHubDeviceTwin_UpdateTwins(TEST_IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE, &update, 1, 0);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_DEVICE_TWIN_RESULT, IOTHUB_DEVICE_TWIN_INVALID_ARG, result_null_handle);
+    ASSERT_ARE_EQUAL(IOTHUB_DEVICE_TWIN_RESULT, IOTHUB_DEVICE_TWIN_INVALID_ARG, result_null_updates);
+    ASSERT_ARE_EQUAL(IOTHUB_DEVICE_TWIN_RESULT, IOTHUB_DEVICE_TWIN_INVALID_ARG, result_no_concurrency);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBDEVICETWIN_41_015: [ IoTHubDeviceTwin_UpdateTwins shall execute the updates on the HTTP connection pool of the handle, or on one created by calling IoTHubSCHttpPool_Create for the duration of the batch if the handle has none ]*/
+/*Tests_SRS_IOTHUBDEVICETWIN_41_019: [ Every update shall be executed as the HTTP PATCH of IoTHubDeviceTwin_UpdateTwin by calling IoTHubSCHttpPool_ExecuteRequest without a response buffer, so the updated twin is not received into memory ]*/
+/*Tests_SRS_IOTHUBDEVICETWIN_41_020: [ The result of an update shall be IOTHUB_DEVICE_TWIN_OK if the received HTTP status code is 200, IOTHUB_DEVICE_TWIN_ERROR otherwise (412 if the eTag didn't match), and the status code shall be stored in its statusCode ]*/
+TEST_FUNCTION(IoTHubDeviceTwin_UpdateTwins_happy_path_single_update_without_http_pool)
+{
+    // arrange
+    IOTHUB_DEVICE_TWIN_UPDATE update = { "theDeviceId", NULL, "{}", NULL, IOTHUB_DEVICE_TWIN_ERROR, 0 };
+    TEST_IOTHUB_SERVICE_CLIENT_DEVICE_TWIN.hostname = TEST_HOSTNAME;
+    TEST_IOTHUB_SERVICE_CLIENT_DEVICE_TWIN.sharedAccessKey = TEST_SHAREDACCESSKEY;
+    TEST_IOTHUB_SERVICE_CLIENT_DEVICE_TWIN.keyName = TEST_SHAREDACCESSKEYNAME;
+
+    STRICT_EXPECTED_CALL(IoTHubSCHttpPool_Create(TEST_HOSTNAME, TEST_SHAREDACCESSKEY, TEST_SHAREDACCESSKEYNAME, NULL));
+    EXPECTED_CALL(Lock_Init());
+    set_expected_calls_for_twinUpdateWorker_take();
+    set_expected_calls_for_executeTwinUpdate(NULL, &httpStatusCodeOk);
+    set_expected_calls_for_twinUpdateWorker_take();
+    STRICT_EXPECTED_CALL(Lock_Deinit(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubSCHttpPool_Destroy(TEST_IOTHUB_SC_HTTP_POOL_HANDLE));
+
+    // act
+    IOTHUB_DEVICE_TWIN_RESULT result = IoTHubDeviceTwin_UpdateTwins(TEST_IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE, &update, 1, IOTHUB_DEVICE_TWIN_DEFAULT_MAX_CONCURRENT_UPDATES);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_DEVICE_TWIN_RESULT, IOTHUB_DEVICE_TWIN_OK, result);
+    ASSERT_ARE_EQUAL(IOTHUB_DEVICE_TWIN_RESULT, IOTHUB_DEVICE_TWIN_OK, update.result);
+    ASSERT_ARE_EQUAL(int, 200, update.statusCode);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBDEVICETWIN_41_016: [ Every worker, the calling thread included, shall take the next update not taken yet under the lock until all of them are taken ]*/
+/*Tests_SRS_IOTHUBDEVICETWIN_41_018: [ If the update has an eTag, the If-Match header shall be set to the quoted eTag instead of * by calling HTTPHeaders_ReplaceHeaderNameValuePair ]*/
+/*Tests_SRS_IOTHUBDEVICETWIN_41_021: [ IoTHubDeviceTwin_UpdateTwins shall start one worker less than the smaller of maxConcurrentUpdates and updateCount by calling ThreadAPI_Create, and run one more on the calling thread ]*/
+/*Tests_SRS_IOTHUBDEVICETWIN_41_023: [ IoTHubDeviceTwin_UpdateTwins shall wait for the workers by calling ThreadAPI_Join, and return IOTHUB_DEVICE_TWIN_OK if every update succeeded, IOTHUB_DEVICE_TWIN_ERROR otherwise ]*/
+TEST_FUNCTION(IoTHubDeviceTwin_UpdateTwins_starts_workers_and_reports_every_result)
+{
+    // arrange
+    static const unsigned int httpStatusCodePreconditionFailed = 412;
+    IOTHUB_DEVICE_TWIN_UPDATE updates[2] =
+    {
+        { "theDeviceId1", NULL, "{}", "AAAAAAAAAAE=", IOTHUB_DEVICE_TWIN_OK, 0 },
+        { "theDeviceId2", "theModuleId", "{}", NULL, IOTHUB_DEVICE_TWIN_OK, 0 }
+    };
+    TEST_IOTHUB_SERVICE_CLIENT_DEVICE_TWIN.httpPool = TEST_IOTHUB_SC_HTTP_POOL_HANDLE;
+
+    STRICT_EXPECTED_CALL(IoTHubSCHttpPool_Clone(TEST_IOTHUB_SC_HTTP_POOL_HANDLE));
+    EXPECTED_CALL(Lock_Init());
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    set_expected_calls_for_twinUpdateWorker_take();
+    set_expected_calls_for_executeTwinUpdate("AAAAAAAAAAE=", &httpStatusCodePreconditionFailed);
+    set_expected_calls_for_twinUpdateWorker_take();
+    set_expected_calls_for_executeTwinUpdate(NULL, &httpStatusCodeOk);
+    set_expected_calls_for_twinUpdateWorker_take();
+    STRICT_EXPECTED_CALL(ThreadAPI_Join(TEST_THREAD_HANDLE, IGNORED_PTR_ARG))
+        .IgnoreArgument(2);
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock_Deinit(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubSCHttpPool_Destroy(TEST_IOTHUB_SC_HTTP_POOL_HANDLE));
+
+    // act
+    IOTHUB_DEVICE_TWIN_RESULT result = IoTHubDeviceTwin_UpdateTwins(TEST_IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE, updates, 2, 2);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_DEVICE_TWIN_RESULT, IOTHUB_DEVICE_TWIN_ERROR, result);
+    ASSERT_ARE_EQUAL(IOTHUB_DEVICE_TWIN_RESULT, IOTHUB_DEVICE_TWIN_ERROR, updates[0].result);
+    ASSERT_ARE_EQUAL(int, 412, updates[0].statusCode);
+    ASSERT_ARE_EQUAL(IOTHUB_DEVICE_TWIN_RESULT, IOTHUB_DEVICE_TWIN_OK, updates[1].result);
+    ASSERT_ARE_EQUAL(int, 200, updates[1].statusCode);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBDEVICETWIN_41_017: [ An update without deviceId or twinPatchJson shall not be sent and its result shall be IOTHUB_DEVICE_TWIN_INVALID_ARG ]*/
+/*Tests_SRS_IOTHUBDEVICETWIN_41_022: [ If a worker cannot be started, the updates shall be executed by the workers that are running ]*/
+TEST_FUNCTION(IoTHubDeviceTwin_UpdateTwins_executes_the_updates_on_the_calling_thread_if_no_worker_starts)
+{
+    // arrange
+    IOTHUB_DEVICE_TWIN_UPDATE updates[2] =
+    {
+        { NULL, NULL, "{}", NULL, IOTHUB_DEVICE_TWIN_OK, 0 },
+        { "theDeviceId2", NULL, "{}", NULL, IOTHUB_DEVICE_TWIN_OK, 0 }
+    };
+    TEST_IOTHUB_SERVICE_CLIENT_DEVICE_TWIN.httpPool = TEST_IOTHUB_SC_HTTP_POOL_HANDLE;
+
+    STRICT_EXPECTED_CALL(IoTHubSCHttpPool_Clone(TEST_IOTHUB_SC_HTTP_POOL_HANDLE));
+    EXPECTED_CALL(Lock_Init());
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .SetReturn(THREADAPI_ERROR);
+    set_expected_calls_for_twinUpdateWorker_take();
+    EXPECTED_CALL(BUFFER_delete(NULL));
+    EXPECTED_CALL(STRING_delete(NULL));
+    EXPECTED_CALL(STRING_delete(NULL));
+    EXPECTED_CALL(HTTPHeaders_Free(NULL));
+    set_expected_calls_for_twinUpdateWorker_take();
+    set_expected_calls_for_executeTwinUpdate(NULL, &httpStatusCodeOk);
+    set_expected_calls_for_twinUpdateWorker_take();
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock_Deinit(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubSCHttpPool_Destroy(TEST_IOTHUB_SC_HTTP_POOL_HANDLE));
+
+    // act
+    IOTHUB_DEVICE_TWIN_RESULT result = IoTHubDeviceTwin_UpdateTwins(TEST_IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE, updates, 2, 2);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_DEVICE_TWIN_RESULT, IOTHUB_DEVICE_TWIN_ERROR, result);
+    ASSERT_ARE_EQUAL(IOTHUB_DEVICE_TWIN_RESULT, IOTHUB_DEVICE_TWIN_INVALID_ARG, updates[0].result);
+    ASSERT_ARE_EQUAL(IOTHUB_DEVICE_TWIN_RESULT, IOTHUB_DEVICE_TWIN_OK, updates[1].result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
 END_TEST_SUITE(iothub_devicetwin_ut)
@@ -58,7 +58,9 @@ IMPLEMENT_UMOCK_C_ENUM_TYPE(IOTHUB_MESSAGING_RESULT, IOTHUB_MESSAGING_RESULT_VAL
 #include "azure_c_shared_utility/umock_c_prod.h"
 MOCKABLE_FUNCTION(, void, TEST_FUNC_IOTHUB_OPEN_COMPLETE_CALLBACK, void*, context);
 MOCKABLE_FUNCTION(, void, TEST_FUNC_IOTHUB_SEND_COMPLETE_CALLBACK, void*, context, IOTHUB_MESSAGING_RESULT, messagingResult);
+MOCKABLE_FUNCTION(, void, TEST_FUNC_IOTHUB_SEND_BATCH_COMPLETE_CALLBACK, void*, context, const char*, deviceId, IOTHUB_MESSAGING_RESULT, messagingResult);
 MOCKABLE_FUNCTION(, void, TEST_FUNC_IOTHUB_FEEDBACK_MESSAGE_RECEIVED_CALLBACK, void*, context, IOTHUB_SERVICE_FEEDBACK_BATCH*, feedbackBatch);
+MOCKABLE_FUNCTION(, void, TEST_FUNC_IOTHUB_FEEDBACK_RECORD_RECEIVED_CALLBACK, void*, context, const IOTHUB_SERVICE_FEEDBACK_RECORD*, feedbackRecord);
 #undef ENABLE_MOCKS
 
 
@@ -234,12 +236,21 @@ static const void* my_list_item_get_value(LIST_ITEM_HANDLE item_handle)
     return result;
 }
 
+static const char* feedbackMessageBody;
 static int my_message_get_body_amqp_data_in_place(MESSAGE_HANDLE message, size_t index, BINARY_DATA* binary_data)
 {
     (void)index;
     (void)message;
-    binary_data->bytes = NULL;
-    binary_data->length = 1;
+    if (feedbackMessageBody != NULL)
+    {
+        binary_data->bytes = (const unsigned char*)feedbackMessageBody;
+        binary_data->length = strlen(feedbackMessageBody);
+    }
+    else
+    {
+        binary_data->bytes = NULL;
+        binary_data->length = 1;
+    }
     return 0;
 }
 
@@ -294,13 +305,21 @@ void my_messagereceiver_destroy(MESSAGE_RECEIVER_HANDLE message_receiver)
 }
 
 static ON_MESSAGE_SEND_COMPLETE onMessageSendCompleteCallback;
+#define TEST_MAX_SEND_ASYNC_CONTEXTS 2
+static void* sendAsyncContexts[TEST_MAX_SEND_ASYNC_CONTEXTS];
+static MESSAGE_SENDER_HANDLE sendAsyncSenders[TEST_MAX_SEND_ASYNC_CONTEXTS];
+static size_t sendAsyncCount;
 static ASYNC_OPERATION_HANDLE my_messagesender_send_async(MESSAGE_SENDER_HANDLE message_sender, MESSAGE_HANDLE message, ON_MESSAGE_SEND_COMPLETE on_message_send_complete, void* callback_context, tickcounter_ms_t timeout)
 {
     (void)timeout;
     (void)message;
-    (void)message_sender;
-    (void)callback_context;
     onMessageSendCompleteCallback = on_message_send_complete;
+    if (sendAsyncCount < TEST_MAX_SEND_ASYNC_CONTEXTS)
+    {
+        sendAsyncContexts[sendAsyncCount] = callback_context;
+        sendAsyncSenders[sendAsyncCount] = message_sender;
+    }
+    sendAsyncCount++;
     return TEST_ASYNC_HANDLE;
 }
 
@@ -328,11 +347,28 @@ void my_on_feedback_message_received(void* context, IOTHUB_SERVICE_FEEDBACK_BATC
     }
 }
 
+#define TEST_MAX_FEEDBACK_RECORDS 2
+static size_t receivedFeedbackRecordCount;
+static char receivedFeedbackRecordDeviceIds[TEST_MAX_FEEDBACK_RECORDS][32];
+static IOTHUB_FEEDBACK_STATUS_CODE receivedFeedbackRecordStatusCodes[TEST_MAX_FEEDBACK_RECORDS];
+static void my_on_feedback_record_received(void* context, const IOTHUB_SERVICE_FEEDBACK_RECORD* feedbackRecord)
+{
+    (void)context;
+    if (receivedFeedbackRecordCount < TEST_MAX_FEEDBACK_RECORDS)
+    {
+        (void)strcpy(receivedFeedbackRecordDeviceIds[receivedFeedbackRecordCount], (feedbackRecord->deviceId == NULL) ? "" : feedbackRecord->deviceId);
+        receivedFeedbackRecordStatusCodes[receivedFeedbackRecordCount] = feedbackRecord->statusCode;
+    }
+    receivedFeedbackRecordCount++;
+}
+
 #define ENABLE_MOCKS
 #include "azure_c_shared_utility/gballoc.h"
 #undef ENABLE_MOCKS
 
 static const char* TEST_DEVICE_ID = "theDeviceId";
+static const char* TEST_DEVICE_ID_2 = "theOtherDeviceId";
+static const char* TEST_BATCH_DEVICE_IDS[] = { "theDeviceId", "theOtherDeviceId" };
 //static const char* TEST_MODULE_ID = "TestModuleId"; // Modules are not supported for sending messages.
 static const char* TEST_PRIMARYKEY = "thePrimaryKey";
 static const char* TEST_SECONDARYKEY = "theSecondaryKey";
@@ -647,6 +683,7 @@ BEGIN_TEST_SUITE(iothub_messaging_ll_ut)
         REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubMessage_GetCorrelationId, NULL);
 
         REGISTER_GLOBAL_MOCK_HOOK(TEST_FUNC_IOTHUB_FEEDBACK_MESSAGE_RECEIVED_CALLBACK, my_on_feedback_message_received);
+        REGISTER_GLOBAL_MOCK_HOOK(TEST_FUNC_IOTHUB_FEEDBACK_RECORD_RECEIVED_CALLBACK, my_on_feedback_record_received);
     }
 
     TEST_SUITE_CLEANUP(TestClassCleanup)
@@ -673,11 +710,14 @@ BEGIN_TEST_SUITE(iothub_messaging_ll_ut)
         onMessageSenderStateChangedCallback = NULL;
         onMessageReceiverStateChangedCallback = NULL;
         onMessageSendCompleteCallback = NULL;
+        sendAsyncCount = 0;
         onMessageReceivedCallback = NULL;
         messagereceiver_create_return = NULL;
         messagesender_create_return = NULL;
 
         receivedFeedbackStatusCode = IOTHUB_FEEDBACK_STATUS_CODE_UNKNOWN;
+        receivedFeedbackRecordCount = 0;
+        feedbackMessageBody = NULL;
     }
 
     TEST_FUNCTION_CLEANUP(TestMethodCleanup)
@@ -930,7 +970,7 @@ BEGIN_TEST_SUITE(iothub_messaging_ll_ut)
         EXPECTED_CALL(amqpvalue_destroy(IGNORED_PTR_ARG));
     }
 
-    static void callsForOpen(void)
+    static void callsForOpenUntilReceiver(void)
     {
         STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));    // Call #0
 
@@ -1012,7 +1052,10 @@ BEGIN_TEST_SUITE(iothub_messaging_ll_ut)
         STRICT_EXPECTED_CALL(messagereceiver_create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreAllArguments();
         STRICT_EXPECTED_CALL(messagereceiver_open(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    }
 
+    static void callsForOpenRelease(void)
+    {
         STRICT_EXPECTED_CALL(amqpvalue_destroy(IGNORED_PTR_ARG));     // Call #51
         STRICT_EXPECTED_CALL(amqpvalue_destroy(IGNORED_PTR_ARG));
         STRICT_EXPECTED_CALL(amqpvalue_destroy(IGNORED_PTR_ARG));
@@ -1022,6 +1065,12 @@ BEGIN_TEST_SUITE(iothub_messaging_ll_ut)
         STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
     }
 
+    static void callsForOpen(void)
+    {
+        callsForOpenUntilReceiver();
+        callsForOpenRelease();
+    }
+
     /*Tests_SRS_IOTHUBMESSAGING_12_010: [ IoTHubMessaging_LL_Open shall create uAMQP PLAIN SASL mechanism by calling saslmechanism_create with the sasl plain interface ] */
     /*Tests_SRS_IOTHUBMESSAGING_12_011: [ IoTHubMessaging_LL_Open shall create uAMQP TLSIO by calling the xio_create ] */
     /*Tests_SRS_IOTHUBMESSAGING_12_012: [ IoTHubMessaging_LL_Open shall create uAMQP SASL IO by calling the xio_create with the previously created SASL mechanism and TLSIO] */
@@ -1511,219 +1560,208 @@ BEGIN_TEST_SUITE(iothub_messaging_ll_ut)
         IoTHubMessaging_LL_Destroy(iothub_messaging_handle);
     }
 
-#if 0
-    // Module message support was removed from product.  If re-enabled, bring back in this code.
-    /*Tests_SRS_IOTHUBMESSAGING_12_034: [ IoTHubMessaging_LL_Send shall verify the messagingHandle, deviceId, message input parameters and if any of them are NULL then return NULL ] */
-    TEST_FUNCTION(IoTHubMessaging_LL_SendModule_return_IOTHUB_MESSAGING_INVALID_ARG_if_input_parameter_messagingHandle_is_NULL)
+    /*Tests_SRS_IOTHUBMESSAGING_41_001: [ If messagingHandle, deviceIds or message is NULL, deviceIdCount is 0 or any of the device ids is NULL, IoTHubMessaging_LL_SendBatch shall return IOTHUB_MESSAGING_INVALID_ARG. ]*/
+    TEST_FUNCTION(IoTHubMessaging_LL_SendBatch_return_IOTHUB_MESSAGING_INVALID_ARG_if_input_parameter_messagingHandle_is_NULL)
     {
         //arrange
 
         //act
-        IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_LL_SendModule(NULL, TEST_CONST_CHAR_PTR, TEST_MODULE_ID, TEST_IOTHUB_MESSAGE_HANDLE, TEST_IOTHUB_SEND_COMPLETE_CALLBACK, TEST_VOID_PTR);
+        IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_LL_SendBatch(NULL, TEST_BATCH_DEVICE_IDS, 2, TEST_IOTHUB_MESSAGE_HANDLE, TEST_FUNC_IOTHUB_SEND_BATCH_COMPLETE_CALLBACK, TEST_VOID_PTR);
 
         //assert
         ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGING_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
     }
 
-    /*Tests_SRS_IOTHUBMESSAGING_12_034: [ IoTHubMessaging_LL_Send shall verify the messagingHandle, deviceId, message input parameters and if any of them are NULL then return NULL ] */
-    TEST_FUNCTION(IoTHubMessaging_LL_SendModule_return_IOTHUB_MESSAGING_INVALID_ARG_if_input_parameter_deviceId_is_NULL)
+    /*Tests_SRS_IOTHUBMESSAGING_41_001: [ If messagingHandle, deviceIds or message is NULL, deviceIdCount is 0 or any of the device ids is NULL, IoTHubMessaging_LL_SendBatch shall return IOTHUB_MESSAGING_INVALID_ARG. ]*/
+    TEST_FUNCTION(IoTHubMessaging_LL_SendBatch_return_IOTHUB_MESSAGING_INVALID_ARG_if_input_parameter_deviceIds_is_NULL)
     {
         //arrange
+        IOTHUB_MESSAGING_HANDLE iothub_messaging_handle = IoTHubMessaging_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+        (void)IoTHubMessaging_LL_Open(iothub_messaging_handle, NULL, NULL);
+        umock_c_reset_all_calls();
 
         //act
-        IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_LL_SendModule(TEST_IOTHUB_MESSAGING_HANDLE, NULL, TEST_MODULE_ID, TEST_IOTHUB_MESSAGE_HANDLE, TEST_IOTHUB_SEND_COMPLETE_CALLBACK, TEST_VOID_PTR);
+        IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_LL_SendBatch(iothub_messaging_handle, NULL, 2, TEST_IOTHUB_MESSAGE_HANDLE, TEST_FUNC_IOTHUB_SEND_BATCH_COMPLETE_CALLBACK, TEST_VOID_PTR);
 
         //assert
         ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGING_INVALID_ARG, result);
-    }
-
-    /*Tests_SRS_IOTHUBMESSAGING_12_034: [ IoTHubMessaging_LL_Send shall verify the messagingHandle, deviceId, message input parameters and if any of them are NULL then return NULL ] */
-    TEST_FUNCTION(IoTHubMessaging_LL_SendModule_return_IOTHUB_MESSAGING_INVALID_ARG_if_input_parameter_moduleId_is_NULL)
-    {
-        //arrange
-
-        //act
-        IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_LL_SendModule(TEST_IOTHUB_MESSAGING_HANDLE, TEST_CONST_CHAR_PTR, NULL, TEST_IOTHUB_MESSAGE_HANDLE, TEST_IOTHUB_SEND_COMPLETE_CALLBACK, TEST_VOID_PTR);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-        //assert
-        ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGING_INVALID_ARG, result);
+        //cleanup
+        IoTHubMessaging_LL_Close(iothub_messaging_handle);
+        IoTHubMessaging_LL_Destroy(iothub_messaging_handle);
     }
 
-
-    /*Tests_SRS_IOTHUBMESSAGING_12_034: [ IoTHubMessaging_LL_Send shall verify the messagingHandle, deviceId, message input parameters and if any of them are NULL then return NULL ] */
-    TEST_FUNCTION(IoTHubMessaging_LL_SendModule_return_IOTHUB_MESSAGING_INVALID_ARG_if_input_parameter_message_is_NULL)
+    /*Tests_SRS_IOTHUBMESSAGING_41_001: [ If messagingHandle, deviceIds or message is NULL, deviceIdCount is 0 or any of the device ids is NULL, IoTHubMessaging_LL_SendBatch shall return IOTHUB_MESSAGING_INVALID_ARG. ]*/
+    TEST_FUNCTION(IoTHubMessaging_LL_SendBatch_return_IOTHUB_MESSAGING_INVALID_ARG_if_input_parameter_deviceIdCount_is_0)
     {
         //arrange
+        IOTHUB_MESSAGING_HANDLE iothub_messaging_handle = IoTHubMessaging_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+        (void)IoTHubMessaging_LL_Open(iothub_messaging_handle, NULL, NULL);
+        umock_c_reset_all_calls();
 
         //act
-        IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_LL_SendModule(TEST_IOTHUB_MESSAGING_HANDLE, TEST_CONST_CHAR_PTR, TEST_MODULE_ID, NULL, TEST_IOTHUB_SEND_COMPLETE_CALLBACK, TEST_VOID_PTR);
+        IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_LL_SendBatch(iothub_messaging_handle, TEST_BATCH_DEVICE_IDS, 0, TEST_IOTHUB_MESSAGE_HANDLE, TEST_FUNC_IOTHUB_SEND_BATCH_COMPLETE_CALLBACK, TEST_VOID_PTR);
 
         //assert
         ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGING_INVALID_ARG, result);
-    }
-
-    /*Tests_SRS_IOTHUBMESSAGING_12_035: [ IoTHubMessaging_LL_Send shall verify if the AMQP messaging has been established by a successfull call to _Open and if it is not then return IOTHUB_MESSAGING_ERROR ] */
-    TEST_FUNCTION(IoTHubMessaging_LL_SendModule_return_IOTHUB_MESSAGING_ERROR_if_messaging_is_not_opened)
-    {
-        //arrange
-        TEST_IOTHUB_MESSAGING_DATA.isOpened = false;
-
-        //act
-        IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_LL_SendModule(TEST_IOTHUB_MESSAGING_HANDLE, TEST_CONST_CHAR_PTR, TEST_MODULE_ID, TEST_IOTHUB_MESSAGE_HANDLE, TEST_IOTHUB_SEND_COMPLETE_CALLBACK, TEST_VOID_PTR);
-
-        //assert
-        ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGING_ERROR, result);
-    }
-
-    TEST_FUNCTION(IoTHubMessaging_LL_SendModule_happy_path)
-    {
-        IoTHubMessaging_LL_Send_happy_path(true);
-    }
-
-    TEST_FUNCTION(IoTHubMessaging_LL_SendModule_non_happy_path)
-    {
-        IoTHubMessaging_LL_Send_non_happy_path(true);
-    }
-#endif
-
-    /*Tests_SRS_IOTHUBMESSAGING_12_042: [ IoTHubMessaging_LL_SetCallbacks shall verify the messagingHandle input parameter and if it is NULL then return NULL ] */
-    TEST_FUNCTION(IoTHubMessaging_LL_SetFeedbackMessageCallback_return_IOTHUB_MESSAGING_INVALID_ARG_if_input_parameter_messagingHandle_is_NULL)
-    {
-        //arrange
-
-        //act
-        IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_LL_SetFeedbackMessageCallback(NULL, TEST_IOTHUB_FEEDBACK_MESSAGE_RECEIVED_CALLBACK, TEST_VOID_PTR);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-        //assert
-        ASSERT_ARE_EQUAL(IOTHUB_MESSAGING_RESULT, IOTHUB_MESSAGING_INVALID_ARG, result);
+        //cleanup
+        IoTHubMessaging_LL_Close(iothub_messaging_handle);
+        IoTHubMessaging_LL_Destroy(iothub_messaging_handle);
     }
 
-    /*Tests_SRS_IOTHUBMESSAGING_12_043: [ IoTHubMessaging_LL_SetCallbacks shall save the given feedbackMessageReceivedCallback to use them in local callbacks ] */
-    /*Tests_SRS_IOTHUBMESSAGING_12_044: [ IoTHubMessaging_LL_Open shall return IOTHUB_MESSAGING_OK after the callbacks have been set ] */
-    TEST_FUNCTION(IoTHubMessaging_LL_SetFeedbackMessageCallback_happy_path)
+    /*Tests_SRS_IOTHUBMESSAGING_41_001: [ If messagingHandle, deviceIds or message is NULL, deviceIdCount is 0 or any of the device ids is NULL, IoTHubMessaging_LL_SendBatch shall return IOTHUB_MESSAGING_INVALID_ARG. ]*/
+    TEST_FUNCTION(IoTHubMessaging_LL_SendBatch_return_IOTHUB_MESSAGING_INVALID_ARG_if_a_deviceId_is_NULL)
     {
         //arrange
+        const char* deviceIds[] = { TEST_DEVICE_ID, NULL };
         IOTHUB_MESSAGING_HANDLE iothub_messaging_handle = IoTHubMessaging_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
-        IoTHubMessaging_LL_Open(iothub_messaging_handle, NULL, NULL);
+        (void)IoTHubMessaging_LL_Open(iothub_messaging_handle, NULL, NULL);
         umock_c_reset_all_calls();
 
         //act
-        IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_LL_SetFeedbackMessageCallback(iothub_messaging_handle, TEST_IOTHUB_FEEDBACK_MESSAGE_RECEIVED_CALLBACK, TEST_VOID_PTR);
+        IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_LL_SendBatch(iothub_messaging_handle, deviceIds, 2, TEST_IOTHUB_MESSAGE_HANDLE, TEST_FUNC_IOTHUB_SEND_BATCH_COMPLETE_CALLBACK, TEST_VOID_PTR);
 
         //assert
-        //ASSERT_IS_TRUE(TEST_IOTHUB_FEEDBACK_MESSAGE_RECEIVED_CALLBACK == TEST_IOTHUB_MESSAGING_DATA.callback_data->feedbackMessageCallback);
-        //ASSERT_ARE_EQUAL(void_ptr, TEST_IOTHUB_MESSAGING_DATA.callback_data->feedbackUserContext, TEST_VOID_PTR);
-        ASSERT_ARE_EQUAL(IOTHUB_MESSAGING_RESULT, IOTHUB_MESSAGING_OK, result);
+        ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGING_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         //cleanup
         IoTHubMessaging_LL_Close(iothub_messaging_handle);
         IoTHubMessaging_LL_Destroy(iothub_messaging_handle);
     }
 
-    /*Tests_SRS_IOTHUBMESSAGING_12_045: [ IoTHubMessaging_LL_DoWork shall verify if uAMQP transport has been initialized and if it is not then return immediately ] */
-    TEST_FUNCTION(IoTHubMessaging_LL_DoWork_return_if_input_parameter_messagingHandle_is_NULL)
+    /*Tests_SRS_IOTHUBMESSAGING_41_001: [ If messagingHandle, deviceIds or message is NULL, deviceIdCount is 0 or any of the device ids is NULL, IoTHubMessaging_LL_SendBatch shall return IOTHUB_MESSAGING_INVALID_ARG. ]*/
+    TEST_FUNCTION(IoTHubMessaging_LL_SendBatch_return_IOTHUB_MESSAGING_INVALID_ARG_if_input_parameter_message_is_NULL)
     {
         //arrange
+        IOTHUB_MESSAGING_HANDLE iothub_messaging_handle = IoTHubMessaging_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+        (void)IoTHubMessaging_LL_Open(iothub_messaging_handle, NULL, NULL);
+        umock_c_reset_all_calls();
 
         //act
-        IoTHubMessaging_LL_DoWork(NULL);
+        IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_LL_SendBatch(iothub_messaging_handle, TEST_BATCH_DEVICE_IDS, 2, NULL, TEST_FUNC_IOTHUB_SEND_BATCH_COMPLETE_CALLBACK, TEST_VOID_PTR);
 
         //assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGING_INVALID_ARG, result);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        IoTHubMessaging_LL_Close(iothub_messaging_handle);
+        IoTHubMessaging_LL_Destroy(iothub_messaging_handle);
     }
 
-    /*Tests_SRS_IOTHUBMESSAGING_12_046: [ IoTHubMessaging_LL_DoWork shall call uAMQP connection_dowork ] */
-    /*Tests_SRS_IOTHUBMESSAGING_12_047: [ IoTHubMessaging_LL_SendMessageComplete callback given to messagesender_send will be called with MESSAGE_SEND_RESULT ] */
-    /*Tests_SRS_IOTHUBMESSAGING_12_048: [ If message has been received the IoTHubMessaging_LL_FeedbackMessageReceived callback given to messagesender_receive will be called with the received MESSAGE_HANDLE ] */
-    TEST_FUNCTION(IoTHubMessaging_LL_DoWork_happy_path)
+    /*Tests_SRS_IOTHUBMESSAGING_41_002: [ If the messaging is not opened or another batch is still in progress, IoTHubMessaging_LL_SendBatch shall return IOTHUB_MESSAGING_ERROR. ]*/
+    TEST_FUNCTION(IoTHubMessaging_LL_SendBatch_return_IOTHUB_MESSAGING_ERROR_if_messaging_is_not_opened)
     {
         //arrange
         IOTHUB_MESSAGING_HANDLE iothub_messaging_handle = IoTHubMessaging_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
-        (void)IoTHubMessaging_LL_Open(iothub_messaging_handle, NULL, NULL);
         umock_c_reset_all_calls();
 
-        STRICT_EXPECTED_CALL(connection_dowork(IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-
         //act
-        IoTHubMessaging_LL_DoWork(iothub_messaging_handle);
+        IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_LL_SendBatch(iothub_messaging_handle, TEST_BATCH_DEVICE_IDS, 2, TEST_IOTHUB_MESSAGE_HANDLE, TEST_FUNC_IOTHUB_SEND_BATCH_COMPLETE_CALLBACK, TEST_VOID_PTR);
 
         //assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGING_ERROR, result);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         //cleanup
-        IoTHubMessaging_LL_Close(iothub_messaging_handle);
         IoTHubMessaging_LL_Destroy(iothub_messaging_handle);
     }
 
-    /*Tests_SRS_IOTHUBMESSAGING_12_049: [ IoTHubMessaging_LL_SenderStateChanged shall save the new_state to local variable ] */
-    /*Tests_SRS_IOTHUBMESSAGING_12_050: [ If both sender and receiver state is open IoTHubMessaging_LL_SenderStateChanged shall set the isOpened local variable to true ] */
-    TEST_FUNCTION(IoTHubMessaging_LL_SenderStateChanged_call_user_callback)
+    static void set_expected_calls_for_SendBatch_prepare(void)
     {
-        //arrange
-        IOTHUB_MESSAGING_HANDLE iothub_messaging_handle = IoTHubMessaging_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
-        (void)IoTHubMessaging_LL_Open(iothub_messaging_handle, TEST_FUNC_IOTHUB_OPEN_COMPLETE_CALLBACK, (void*)1);
-        onMessageReceiverStateChangedCallback(msg_recv_ctx, MESSAGE_RECEIVER_STATE_OPEN, MESSAGE_RECEIVER_STATE_IDLE);
-        umock_c_reset_all_calls();
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
 
-        STRICT_EXPECTED_CALL(TEST_FUNC_IOTHUB_OPEN_COMPLETE_CALLBACK(IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE));
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(TEST_IOTHUB_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 
-        MESSAGE_SENDER_STATE new_state = MESSAGE_SENDER_STATE_OPEN;
-        MESSAGE_SENDER_STATE previous_state = MESSAGE_SENDER_STATE_IDLE;
+        STRICT_EXPECTED_CALL(message_create());
+        STRICT_EXPECTED_CALL(message_add_body_amqp_data(TEST_MESSAGE_HANDLE, TEST_BINARY_DATA_INST))
+            .IgnoreArgument(2);
 
-        //act
-        onMessageSenderStateChangedCallback(iothub_messaging_handle, new_state, previous_state);
+        STRICT_EXPECTED_CALL(IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE));
+        STRICT_EXPECTED_CALL(Map_GetInternals(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 
-        //assert
-        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        STRICT_EXPECTED_CALL(properties_create());
 
-        ///cleanup
-        IoTHubMessaging_LL_Close(iothub_messaging_handle);
-        IoTHubMessaging_LL_Destroy(iothub_messaging_handle);
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetMessageId(TEST_IOTHUB_MESSAGE_HANDLE));
+        STRICT_EXPECTED_CALL(amqpvalue_create_string(TEST_CONST_CHAR_PTR));
+        STRICT_EXPECTED_CALL(properties_set_message_id(TEST_PROPERTIES_HANDLE, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(amqpvalue_destroy(IGNORED_PTR_ARG));
+
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetCorrelationId(TEST_IOTHUB_MESSAGE_HANDLE));
+        STRICT_EXPECTED_CALL(amqpvalue_create_string(TEST_CONST_CHAR_PTR));
+        STRICT_EXPECTED_CALL(properties_set_correlation_id(TEST_PROPERTIES_HANDLE, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(amqpvalue_destroy(IGNORED_PTR_ARG));
     }
 
-    /*Tests_SRS_IOTHUBMESSAGING_12_049: [ IoTHubMessaging_LL_SenderStateChanged shall save the new_state to local variable ] */
-    /*Tests_SRS_IOTHUBMESSAGING_12_051: [ If neither sender_state nor receiver_state is open IoTHubMessaging_LL_SenderStateChanged shall set the local isOpened variable to false ] */
-    TEST_FUNCTION(IoTHubMessaging_LL_SenderStateChanged_messaging_is_not_opened)
+    static void set_expected_calls_for_SendBatch_delivery(const char* destination)
+    {
+        STRICT_EXPECTED_CALL(amqpvalue_create_string(destination));
+        STRICT_EXPECTED_CALL(properties_set_to(TEST_PROPERTIES_HANDLE, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(message_set_properties(TEST_MESSAGE_HANDLE, TEST_PROPERTIES_HANDLE));
+        STRICT_EXPECTED_CALL(messagesender_send_async(IGNORED_PTR_ARG, TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, 0));
+        STRICT_EXPECTED_CALL(amqpvalue_destroy(IGNORED_PTR_ARG));
+    }
+
+    static void set_expected_calls_for_SendBatch_release(void)
+    {
+        STRICT_EXPECTED_CALL(message_destroy(TEST_MESSAGE_HANDLE));
+        STRICT_EXPECTED_CALL(properties_destroy(TEST_PROPERTIES_HANDLE));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    }
+
+    /*Tests_SRS_IOTHUBMESSAGING_41_003: [ IoTHubMessaging_LL_SendBatch shall copy the device ids in a single allocation, so that deviceIds can be released on return. ]*/
+    /*Tests_SRS_IOTHUBMESSAGING_41_004: [ IoTHubMessaging_LL_SendBatch shall encode the message body, application properties, message-id and correlation-id once in a single uAMQP message. ]*/
+    /*Tests_SRS_IOTHUBMESSAGING_41_007: [ For each delivery only the TO property shall be rewritten by calling properties_set_to and message_set_properties, and the shared uAMQP message shall be sent by calling messagesender_send_async. ]*/
+    /*Tests_SRS_IOTHUBMESSAGING_41_013: [ Otherwise IoTHubMessaging_LL_SendBatch shall return IOTHUB_MESSAGING_OK. ]*/
+    TEST_FUNCTION(IoTHubMessaging_LL_SendBatch_happy_path)
     {
         //arrange
         IOTHUB_MESSAGING_HANDLE iothub_messaging_handle = IoTHubMessaging_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
-        (void)IoTHubMessaging_LL_Open(iothub_messaging_handle, TEST_FUNC_IOTHUB_OPEN_COMPLETE_CALLBACK, (void*)1);
-
+        (void)IoTHubMessaging_LL_Open(iothub_messaging_handle, NULL, NULL);
         umock_c_reset_all_calls();
 
-        MESSAGE_SENDER_STATE new_state = MESSAGE_SENDER_STATE_OPENING;
-        MESSAGE_SENDER_STATE previous_state = MESSAGE_SENDER_STATE_IDLE;
+        set_expected_calls_for_SendBatch_prepare();
+        set_expected_calls_for_SendBatch_delivery("/devices/theDeviceId/messages/deviceBound");
+        set_expected_calls_for_SendBatch_delivery("/devices/theOtherDeviceId/messages/deviceBound");
 
         //act
-        onMessageSenderStateChangedCallback(iothub_messaging_handle, new_state, previous_state);
+        IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_LL_SendBatch(iothub_messaging_handle, TEST_BATCH_DEVICE_IDS, 2, TEST_IOTHUB_MESSAGE_HANDLE, TEST_FUNC_IOTHUB_SEND_BATCH_COMPLETE_CALLBACK, TEST_VOID_PTR);
 
         //assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGING_OK, result);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-        ///cleanup
+        //cleanup
         IoTHubMessaging_LL_Close(iothub_messaging_handle);
         IoTHubMessaging_LL_Destroy(iothub_messaging_handle);
     }
 
-    /*Tests_SRS_IOTHUBMESSAGING_12_049: [ IoTHubMessaging_LL_SenderStateChanged shall save the new_state to local variable ] */
-    /*Tests_SRS_IOTHUBMESSAGING_12_051: [ If neither sender_state nor receiver_state is open IoTHubMessaging_LL_SenderStateChanged shall set the local isOpened variable to false ] */
-    TEST_FUNCTION(IoTHubMessaging_LL_SenderStateChanged_openCompleteCompleteCallback_is_null)
+    /*Tests_SRS_IOTHUBMESSAGING_41_002: [ If the messaging is not opened or another batch is still in progress, IoTHubMessaging_LL_SendBatch shall return IOTHUB_MESSAGING_ERROR. ]*/
+    TEST_FUNCTION(IoTHubMessaging_LL_SendBatch_return_IOTHUB_MESSAGING_ERROR_if_a_batch_is_in_progress)
     {
         //arrange
         IOTHUB_MESSAGING_HANDLE iothub_messaging_handle = IoTHubMessaging_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
         (void)IoTHubMessaging_LL_Open(iothub_messaging_handle, NULL, NULL);
-        onMessageReceiverStateChangedCallback(msg_recv_ctx, MESSAGE_RECEIVER_STATE_OPEN, MESSAGE_RECEIVER_STATE_IDLE);
+        (void)IoTHubMessaging_LL_SendBatch(iothub_messaging_handle, TEST_BATCH_DEVICE_IDS, 2, TEST_IOTHUB_MESSAGE_HANDLE, TEST_FUNC_IOTHUB_SEND_BATCH_COMPLETE_CALLBACK, TEST_VOID_PTR);
         umock_c_reset_all_calls();
 
-        MESSAGE_SENDER_STATE new_state = MESSAGE_SENDER_STATE_OPEN;
-        MESSAGE_SENDER_STATE previous_state = MESSAGE_SENDER_STATE_IDLE;
-
         //act
-        onMessageSenderStateChangedCallback(iothub_messaging_handle, new_state, previous_state);
+        IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_LL_SendBatch(iothub_messaging_handle, TEST_BATCH_DEVICE_IDS, 2, TEST_IOTHUB_MESSAGE_HANDLE, TEST_FUNC_IOTHUB_SEND_BATCH_COMPLETE_CALLBACK, TEST_VOID_PTR);
 
         //assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGING_ERROR, result);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         //cleanup
@@ -1731,113 +1769,505 @@ BEGIN_TEST_SUITE(iothub_messaging_ll_ut)
         IoTHubMessaging_LL_Destroy(iothub_messaging_handle);
     }
 
-    /*Tests_SRS_IOTHUBMESSAGING_12_052: [ IoTHubMessaging_LL_ReceiverStateChanged shall save the new_state to local variable ] */
-    /*Tests_SRS_IOTHUBMESSAGING_12_053: [ If both sender and receiver state is open IoTHubMessaging_LL_ReceiverStateChanged shall set the isOpened local variable to true ] */
-    TEST_FUNCTION(IoTHubMessaging_LL_ReceiverStateChanged_call_user_callback)
+    /*Tests_SRS_IOTHUBMESSAGING_41_005: [ If any of the allocations or uAMQP calls preparing the batch fails, IoTHubMessaging_LL_SendBatch shall release what it created, send nothing and return IOTHUB_MESSAGING_ERROR. ]*/
+    TEST_FUNCTION(IoTHubMessaging_LL_SendBatch_non_happy_path)
     {
         //arrange
         IOTHUB_MESSAGING_HANDLE iothub_messaging_handle = IoTHubMessaging_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
-        (void)IoTHubMessaging_LL_Open(iothub_messaging_handle, TEST_FUNC_IOTHUB_OPEN_COMPLETE_CALLBACK, (void*)1);
-        onMessageSenderStateChangedCallback(msg_send_ctx, MESSAGE_SENDER_STATE_OPEN, MESSAGE_SENDER_STATE_IDLE);
+        (void)IoTHubMessaging_LL_Open(iothub_messaging_handle, NULL, NULL);
         umock_c_reset_all_calls();
 
-        STRICT_EXPECTED_CALL(TEST_FUNC_IOTHUB_OPEN_COMPLETE_CALLBACK(IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
+        int umockc_result = umock_c_negative_tests_init();
+        ASSERT_ARE_EQUAL(int, 0, umockc_result);
 
-        MESSAGE_RECEIVER_STATE new_state = MESSAGE_RECEIVER_STATE_OPEN;
-        MESSAGE_RECEIVER_STATE previous_state = MESSAGE_RECEIVER_STATE_IDLE;
+        set_expected_calls_for_SendBatch_prepare();
+        umock_c_negative_tests_snapshot();
 
         //act
-        onMessageReceiverStateChangedCallback(iothub_messaging_handle, new_state, previous_state);
+        for (size_t i = 0; i < umock_c_negative_tests_call_count(); i++)
+        {
+            if ((i != 8) && /*IoTHubMessage_Properties*/
+                (i != 11) && /*IoTHubMessage_GetMessageId*/
+                (i != 13) && /*properties_set_message_id*/
+                (i != 14) && /*amqpvalue_destroy*/
+                (i != 15) && /*IoTHubMessage_GetCorrelationId*/
+                (i != 17) && /*properties_set_correlation_id*/
+                (i != 18)) /*amqpvalue_destroy*/
+            {
+                umock_c_negative_tests_reset();
+                umock_c_negative_tests_fail_call(i);
 
-        //assert
-        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+                IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_LL_SendBatch(iothub_messaging_handle, TEST_BATCH_DEVICE_IDS, 2, TEST_IOTHUB_MESSAGE_HANDLE, TEST_FUNC_IOTHUB_SEND_BATCH_COMPLETE_CALLBACK, TEST_VOID_PTR);
 
-        ///cleanup
+                //assert
+                ASSERT_ARE_EQUAL(IOTHUB_MESSAGING_RESULT, IOTHUB_MESSAGING_ERROR, result);
+            }
+        }
+        umock_c_negative_tests_deinit();
+
+        //cleanup
         IoTHubMessaging_LL_Close(iothub_messaging_handle);
         IoTHubMessaging_LL_Destroy(iothub_messaging_handle);
     }
 
-    /*Tests_SRS_IOTHUBMESSAGING_12_052: [ IoTHubMessaging_LL_ReceiverStateChanged shall save the new_state to local variable ] */
-    /*Tests_SRS_IOTHUBMESSAGING_12_054: [ If neither sender_state nor receiver_state is open IoTHubMessaging_LL_ReceiverStateChanged shall set the local isOpened variable to false ] */
-    TEST_FUNCTION(IoTHubMessaging_LL_ReceiverStateChanged_messaging_is_not_opened)
+    /*Tests_SRS_IOTHUBMESSAGING_41_008: [ If any of the uAMQP calls of a delivery fails, that delivery shall complete with IOTHUB_MESSAGING_ERROR and the batch shall continue with the next device. ]*/
+    TEST_FUNCTION(IoTHubMessaging_LL_SendBatch_a_failed_delivery_completes_with_error_and_the_batch_continues)
     {
         //arrange
         IOTHUB_MESSAGING_HANDLE iothub_messaging_handle = IoTHubMessaging_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
-        (void)IoTHubMessaging_LL_Open(iothub_messaging_handle, TEST_FUNC_IOTHUB_OPEN_COMPLETE_CALLBACK, (void*)1);
-        onMessageSenderStateChangedCallback(msg_send_ctx, MESSAGE_SENDER_STATE_OPEN, MESSAGE_SENDER_STATE_IDLE);
+        (void)IoTHubMessaging_LL_Open(iothub_messaging_handle, NULL, NULL);
         umock_c_reset_all_calls();
 
-        MESSAGE_RECEIVER_STATE new_state = MESSAGE_RECEIVER_STATE_OPENING;
-        MESSAGE_RECEIVER_STATE previous_state = MESSAGE_RECEIVER_STATE_IDLE;
+        set_expected_calls_for_SendBatch_prepare();
+        STRICT_EXPECTED_CALL(amqpvalue_create_string("/devices/theDeviceId/messages/deviceBound"));
+        STRICT_EXPECTED_CALL(properties_set_to(TEST_PROPERTIES_HANDLE, IGNORED_PTR_ARG))
+            .SetReturn(1);
+        STRICT_EXPECTED_CALL(TEST_FUNC_IOTHUB_SEND_BATCH_COMPLETE_CALLBACK(TEST_VOID_PTR, TEST_DEVICE_ID, IOTHUB_MESSAGING_ERROR));
+        STRICT_EXPECTED_CALL(amqpvalue_destroy(IGNORED_PTR_ARG));
+        set_expected_calls_for_SendBatch_delivery("/devices/theOtherDeviceId/messages/deviceBound");
 
         //act
-        onMessageReceiverStateChangedCallback(iothub_messaging_handle, new_state, previous_state);
+        IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_LL_SendBatch(iothub_messaging_handle, TEST_BATCH_DEVICE_IDS, 2, TEST_IOTHUB_MESSAGE_HANDLE, TEST_FUNC_IOTHUB_SEND_BATCH_COMPLETE_CALLBACK, TEST_VOID_PTR);
 
         //assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGING_OK, result);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, 1, sendAsyncCount);
 
-        ///cleanup
+        //cleanup
         IoTHubMessaging_LL_Close(iothub_messaging_handle);
         IoTHubMessaging_LL_Destroy(iothub_messaging_handle);
     }
 
-    /*Tests_SRS_IOTHUBMESSAGING_12_052: [ IoTHubMessaging_LL_ReceiverStateChanged shall save the new_state to local variable ] */
-    /*Tests_SRS_IOTHUBMESSAGING_12_054: [ If neither sender_state nor receiver_state is open IoTHubMessaging_LL_ReceiverStateChanged shall set the local isOpened variable to false ] */
-    TEST_FUNCTION(IoTHubMessaging_LL_ReceiverStateChanged_openCompleteCompleteCallback_is_null)
+    /*Tests_SRS_IOTHUBMESSAGING_41_009: [ When a delivery of the batch completes, sendBatchCompleteCallback shall be called with userContextCallback, the device id of the delivery and the messaging result. ]*/
+    /*Tests_SRS_IOTHUBMESSAGING_41_010: [ Once every delivery of the batch completed, the batch shall be released and a new batch can be sent. ]*/
+    TEST_FUNCTION(IoTHubMessaging_LL_SendBatchMessageComplete_calls_the_user_callback_per_device_and_releases_the_batch)
     {
         //arrange
         IOTHUB_MESSAGING_HANDLE iothub_messaging_handle = IoTHubMessaging_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
         (void)IoTHubMessaging_LL_Open(iothub_messaging_handle, NULL, NULL);
-        onMessageSenderStateChangedCallback(msg_send_ctx, MESSAGE_SENDER_STATE_OPEN, MESSAGE_SENDER_STATE_IDLE);
+        (void)IoTHubMessaging_LL_SendBatch(iothub_messaging_handle, TEST_BATCH_DEVICE_IDS, 2, TEST_IOTHUB_MESSAGE_HANDLE, TEST_FUNC_IOTHUB_SEND_BATCH_COMPLETE_CALLBACK, TEST_VOID_PTR);
         umock_c_reset_all_calls();
 
-        MESSAGE_RECEIVER_STATE new_state = MESSAGE_RECEIVER_STATE_OPEN;
-        MESSAGE_RECEIVER_STATE previous_state = MESSAGE_RECEIVER_STATE_IDLE;
+        STRICT_EXPECTED_CALL(TEST_FUNC_IOTHUB_SEND_BATCH_COMPLETE_CALLBACK(TEST_VOID_PTR, TEST_DEVICE_ID, IOTHUB_MESSAGING_OK));
+        STRICT_EXPECTED_CALL(TEST_FUNC_IOTHUB_SEND_BATCH_COMPLETE_CALLBACK(TEST_VOID_PTR, TEST_DEVICE_ID_2, IOTHUB_MESSAGING_ERROR));
+        set_expected_calls_for_SendBatch_release();
 
         //act
-        onMessageReceiverStateChangedCallback(iothub_messaging_handle, new_state, previous_state);
+        onMessageSendCompleteCallback(sendAsyncContexts[0], MESSAGE_SEND_OK, TEST_AMQP_VALUE);
+        onMessageSendCompleteCallback(sendAsyncContexts[1], MESSAGE_SEND_TIMEOUT, TEST_AMQP_VALUE);
 
         //assert
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
+        umock_c_reset_all_calls();
+        ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGING_OK, IoTHubMessaging_LL_SendBatch(iothub_messaging_handle, TEST_BATCH_DEVICE_IDS, 2, TEST_IOTHUB_MESSAGE_HANDLE, TEST_FUNC_IOTHUB_SEND_BATCH_COMPLETE_CALLBACK, TEST_VOID_PTR));
+
         //cleanup
         IoTHubMessaging_LL_Close(iothub_messaging_handle);
         IoTHubMessaging_LL_Destroy(iothub_messaging_handle);
     }
 
-    /*Tests_SRS_IOTHUBMESSAGING_12_056: [ If context is NULL IoTHubMessaging_LL_SendMessageComplete shall return ] */
-    /*Tests_SRS_IOTHUBMESSAGING_12_055: [ If context is not NULL and IoTHubMessaging_LL_SendMessageComplete shall call user callback with user context and messaging result ] */
-    TEST_FUNCTION(IoTHubMessaging_LL_SendMessageComplete_context_is_null)
+    /*Tests_SRS_IOTHUBMESSAGING_41_006: [ No more than IOTHUB_MESSAGING_BATCH_MAX_IN_FLIGHT deliveries of the batch shall be queued on the message sender at a time. ]*/
+    /*Tests_SRS_IOTHUBMESSAGING_41_011: [ IoTHubMessaging_LL_DoWork shall queue more deliveries of the batch on the message sender, up to IOTHUB_MESSAGING_BATCH_MAX_IN_FLIGHT, before calling connection_dowork. ]*/
+    TEST_FUNCTION(IoTHubMessaging_LL_SendBatch_queues_at_most_256_deliveries_and_DoWork_queues_the_rest)
     {
         //arrange
+        const char* deviceIds[300];
+        size_t i;
+        for (i = 0; i < sizeof(deviceIds) / sizeof(deviceIds[0]); i++)
+        {
+            deviceIds[i] = TEST_DEVICE_ID;
+        }
         IOTHUB_MESSAGING_HANDLE iothub_messaging_handle = IoTHubMessaging_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
-        (void)IoTHubMessaging_LL_Open(iothub_messaging_handle, TEST_FUNC_IOTHUB_OPEN_COMPLETE_CALLBACK, (void*)1);
-        (void)IoTHubMessaging_LL_Send(iothub_messaging_handle, TEST_DEVICE_ID, TEST_IOTHUB_MESSAGE_HANDLE, TEST_FUNC_IOTHUB_SEND_COMPLETE_CALLBACK, (void*)1);
+        (void)IoTHubMessaging_LL_Open(iothub_messaging_handle, NULL, NULL);
+
+        IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_LL_SendBatch(iothub_messaging_handle, deviceIds, sizeof(deviceIds) / sizeof(deviceIds[0]), TEST_IOTHUB_MESSAGE_HANDLE, TEST_FUNC_IOTHUB_SEND_BATCH_COMPLETE_CALLBACK, TEST_VOID_PTR);
+        ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGING_OK, result);
+        ASSERT_ARE_EQUAL(size_t, 256, sendAsyncCount);
 
+        onMessageSendCompleteCallback(sendAsyncContexts[0], MESSAGE_SEND_OK, TEST_AMQP_VALUE);
         umock_c_reset_all_calls();
 
-        MESSAGE_SEND_RESULT send_result = MESSAGE_SEND_OK;
+        set_expected_calls_for_SendBatch_delivery("/devices/theDeviceId/messages/deviceBound");
+        STRICT_EXPECTED_CALL(connection_dowork(IGNORED_PTR_ARG));
 
         //act
-        onMessageSendCompleteCallback((void*)NULL, send_result, TEST_AMQP_VALUE);
+        IoTHubMessaging_LL_DoWork(iothub_messaging_handle);
 
         //assert
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, 257, sendAsyncCount);
 
         //cleanup
         IoTHubMessaging_LL_Close(iothub_messaging_handle);
         IoTHubMessaging_LL_Destroy(iothub_messaging_handle);
     }
 
-    /*Tests_SRS_IOTHUBMESSAGING_12_056: [ If context is NULL IoTHubMessaging_LL_SendMessageComplete shall return ] */
-    /*Tests_SRS_IOTHUBMESSAGING_12_055: [ If context is not NULL and IoTHubMessaging_LL_SendMessageComplete shall call user callback with user context and messaging result ] */
-    TEST_FUNCTION(IoTHubMessaging_LL_SendMessageComplete_sendCompleteCallback_null)
+    /*Tests_SRS_IOTHUBMESSAGING_41_012: [ IoTHubMessaging_LL_Close and IoTHubMessaging_LL_Destroy shall complete every pending delivery of the batch with IOTHUB_MESSAGING_ERROR and release the batch. ]*/
+    TEST_FUNCTION(IoTHubMessaging_LL_Close_completes_the_pending_batch_deliveries_with_error)
     {
         //arrange
         IOTHUB_MESSAGING_HANDLE iothub_messaging_handle = IoTHubMessaging_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
-        (void)IoTHubMessaging_LL_Open(iothub_messaging_handle, TEST_FUNC_IOTHUB_OPEN_COMPLETE_CALLBACK, (void*)1);
-        (void)IoTHubMessaging_LL_Send(iothub_messaging_handle, TEST_DEVICE_ID, TEST_IOTHUB_MESSAGE_HANDLE, NULL, NULL);
+        (void)IoTHubMessaging_LL_Open(iothub_messaging_handle, NULL, NULL);
+        (void)IoTHubMessaging_LL_SendBatch(iothub_messaging_handle, TEST_BATCH_DEVICE_IDS, 2, TEST_IOTHUB_MESSAGE_HANDLE, TEST_FUNC_IOTHUB_SEND_BATCH_COMPLETE_CALLBACK, TEST_VOID_PTR);
+        onMessageSendCompleteCallback(sendAsyncContexts[0], MESSAGE_SEND_OK, TEST_AMQP_VALUE);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(messagesender_destroy(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(TEST_FUNC_IOTHUB_SEND_BATCH_COMPLETE_CALLBACK(TEST_VOID_PTR, TEST_DEVICE_ID_2, IOTHUB_MESSAGING_ERROR));
+        set_expected_calls_for_SendBatch_release();
+        STRICT_EXPECTED_CALL(messagereceiver_destroy(IGNORED_PTR_ARG));
+
+        STRICT_EXPECTED_CALL(link_destroy(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(link_destroy(IGNORED_PTR_ARG));
+
+        STRICT_EXPECTED_CALL(session_destroy(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(connection_destroy(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(xio_destroy(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(xio_destroy(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(saslmechanism_destroy(IGNORED_PTR_ARG));
+
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+        //act
+        IoTHubMessaging_LL_Close(iothub_messaging_handle);
+
+        //assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        IoTHubMessaging_LL_Destroy(iothub_messaging_handle);
+    }
+
+#if 0
+    // Module message support was removed from product.  If re-enabled, bring back in this code.
+    /*Tests_SRS_IOTHUBMESSAGING_12_034: [ IoTHubMessaging_LL_Send shall verify the messagingHandle, deviceId, message input parameters and if any of them are NULL then return NULL ] */
+    TEST_FUNCTION(IoTHubMessaging_LL_SendModule_return_IOTHUB_MESSAGING_INVALID_ARG_if_input_parameter_messagingHandle_is_NULL)
+    {
+        //arrange
+
+        //act
+        IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_LL_SendModule(NULL, TEST_CONST_CHAR_PTR, TEST_MODULE_ID, TEST_IOTHUB_MESSAGE_HANDLE, TEST_IOTHUB_SEND_COMPLETE_CALLBACK, TEST_VOID_PTR);
+
+        //assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGING_INVALID_ARG, result);
+    }
+
+    /*Tests_SRS_IOTHUBMESSAGING_12_034: [ IoTHubMessaging_LL_Send shall verify the messagingHandle, deviceId, message input parameters and if any of them are NULL then return NULL ] */
+    TEST_FUNCTION(IoTHubMessaging_LL_SendModule_return_IOTHUB_MESSAGING_INVALID_ARG_if_input_parameter_deviceId_is_NULL)
+    {
+        //arrange
+
+        //act
+        IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_LL_SendModule(TEST_IOTHUB_MESSAGING_HANDLE, NULL, TEST_MODULE_ID, TEST_IOTHUB_MESSAGE_HANDLE, TEST_IOTHUB_SEND_COMPLETE_CALLBACK, TEST_VOID_PTR);
+
+        //assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGING_INVALID_ARG, result);
+    }
+
+    /*Tests_SRS_IOTHUBMESSAGING_12_034: [ IoTHubMessaging_LL_Send shall verify the messagingHandle, deviceId, message input parameters and if any of them are NULL then return NULL ] */
+    TEST_FUNCTION(IoTHubMessaging_LL_SendModule_return_IOTHUB_MESSAGING_INVALID_ARG_if_input_parameter_moduleId_is_NULL)
+    {
+        //arrange
+
+        //act
+        IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_LL_SendModule(TEST_IOTHUB_MESSAGING_HANDLE, TEST_CONST_CHAR_PTR, NULL, TEST_IOTHUB_MESSAGE_HANDLE, TEST_IOTHUB_SEND_COMPLETE_CALLBACK, TEST_VOID_PTR);
+
+        //assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGING_INVALID_ARG, result);
+    }
+
+
+    /*Tests_SRS_IOTHUBMESSAGING_12_034: [ IoTHubMessaging_LL_Send shall verify the messagingHandle, deviceId, message input parameters and if any of them are NULL then return NULL ] */
+    TEST_FUNCTION(IoTHubMessaging_LL_SendModule_return_IOTHUB_MESSAGING_INVALID_ARG_if_input_parameter_message_is_NULL)
+    {
+        //arrange
+
+        //act
+        IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_LL_SendModule(TEST_IOTHUB_MESSAGING_HANDLE, TEST_CONST_CHAR_PTR, TEST_MODULE_ID, NULL, TEST_IOTHUB_SEND_COMPLETE_CALLBACK, TEST_VOID_PTR);
+
+        //assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGING_INVALID_ARG, result);
+    }
+
+    /*Tests_SRS_IOTHUBMESSAGING_12_035: [ IoTHubMessaging_LL_Send shall verify if the AMQP messaging has been established by a successfull call to _Open and if it is not then return IOTHUB_MESSAGING_ERROR ] */
+    TEST_FUNCTION(IoTHubMessaging_LL_SendModule_return_IOTHUB_MESSAGING_ERROR_if_messaging_is_not_opened)
+    {
+        //arrange
+        TEST_IOTHUB_MESSAGING_DATA.isOpened = false;
+
+        //act
+        IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_LL_SendModule(TEST_IOTHUB_MESSAGING_HANDLE, TEST_CONST_CHAR_PTR, TEST_MODULE_ID, TEST_IOTHUB_MESSAGE_HANDLE, TEST_IOTHUB_SEND_COMPLETE_CALLBACK, TEST_VOID_PTR);
+
+        //assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGING_ERROR, result);
+    }
+
+    TEST_FUNCTION(IoTHubMessaging_LL_SendModule_happy_path)
+    {
+        IoTHubMessaging_LL_Send_happy_path(true);
+    }
+
+    TEST_FUNCTION(IoTHubMessaging_LL_SendModule_non_happy_path)
+    {
+        IoTHubMessaging_LL_Send_non_happy_path(true);
+    }
+#endif
+
+    /*Tests_SRS_IOTHUBMESSAGING_12_042: [ IoTHubMessaging_LL_SetCallbacks shall verify the messagingHandle input parameter and if it is NULL then return NULL ] */
+    TEST_FUNCTION(IoTHubMessaging_LL_SetFeedbackMessageCallback_return_IOTHUB_MESSAGING_INVALID_ARG_if_input_parameter_messagingHandle_is_NULL)
+    {
+        //arrange
+
+        //act
+        IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_LL_SetFeedbackMessageCallback(NULL, TEST_IOTHUB_FEEDBACK_MESSAGE_RECEIVED_CALLBACK, TEST_VOID_PTR);
+
+        //assert
+        ASSERT_ARE_EQUAL(IOTHUB_MESSAGING_RESULT, IOTHUB_MESSAGING_INVALID_ARG, result);
+    }
+
+    /*Tests_SRS_IOTHUBMESSAGING_12_043: [ IoTHubMessaging_LL_SetCallbacks shall save the given feedbackMessageReceivedCallback to use them in local callbacks ] */
+    /*Tests_SRS_IOTHUBMESSAGING_12_044: [ IoTHubMessaging_LL_Open shall return IOTHUB_MESSAGING_OK after the callbacks have been set ] */
+    TEST_FUNCTION(IoTHubMessaging_LL_SetFeedbackMessageCallback_happy_path)
+    {
+        //arrange
+        IOTHUB_MESSAGING_HANDLE iothub_messaging_handle = IoTHubMessaging_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+        IoTHubMessaging_LL_Open(iothub_messaging_handle, NULL, NULL);
+        umock_c_reset_all_calls();
+
+        //act
+        IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_LL_SetFeedbackMessageCallback(iothub_messaging_handle, TEST_IOTHUB_FEEDBACK_MESSAGE_RECEIVED_CALLBACK, TEST_VOID_PTR);
+
+        //assert
+        //ASSERT_IS_TRUE(TEST_IOTHUB_FEEDBACK_MESSAGE_RECEIVED_CALLBACK == TEST_IOTHUB_MESSAGING_DATA.callback_data->feedbackMessageCallback);
+        //ASSERT_ARE_EQUAL(void_ptr, TEST_IOTHUB_MESSAGING_DATA.callback_data->feedbackUserContext, TEST_VOID_PTR);
+        ASSERT_ARE_EQUAL(IOTHUB_MESSAGING_RESULT, IOTHUB_MESSAGING_OK, result);
+
+        //cleanup
+        IoTHubMessaging_LL_Close(iothub_messaging_handle);
+        IoTHubMessaging_LL_Destroy(iothub_messaging_handle);
+    }
+
+    /*Tests_SRS_IOTHUBMESSAGING_12_045: [ IoTHubMessaging_LL_DoWork shall verify if uAMQP transport has been initialized and if it is not then return immediately ] */
+    TEST_FUNCTION(IoTHubMessaging_LL_DoWork_return_if_input_parameter_messagingHandle_is_NULL)
+    {
+        //arrange
+
+        //act
+        IoTHubMessaging_LL_DoWork(NULL);
+
+        //assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /*Tests_SRS_IOTHUBMESSAGING_12_046: [ IoTHubMessaging_LL_DoWork shall call uAMQP connection_dowork ] */
+    /*Tests_SRS_IOTHUBMESSAGING_12_047: [ IoTHubMessaging_LL_SendMessageComplete callback given to messagesender_send will be called with MESSAGE_SEND_RESULT ] */
+    /*Tests_SRS_IOTHUBMESSAGING_12_048: [ If message has been received the IoTHubMessaging_LL_FeedbackMessageReceived callback given to messagesender_receive will be called with the received MESSAGE_HANDLE ] */
+    TEST_FUNCTION(IoTHubMessaging_LL_DoWork_happy_path)
+    {
+        //arrange
+        IOTHUB_MESSAGING_HANDLE iothub_messaging_handle = IoTHubMessaging_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+        (void)IoTHubMessaging_LL_Open(iothub_messaging_handle, NULL, NULL);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(connection_dowork(IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+
+        //act
+        IoTHubMessaging_LL_DoWork(iothub_messaging_handle);
+
+        //assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        IoTHubMessaging_LL_Close(iothub_messaging_handle);
+        IoTHubMessaging_LL_Destroy(iothub_messaging_handle);
+    }
+
+    /*Tests_SRS_IOTHUBMESSAGING_12_049: [ IoTHubMessaging_LL_SenderStateChanged shall save the new_state to local variable ] */
+    /*Tests_SRS_IOTHUBMESSAGING_12_050: [ If both sender and receiver state is open IoTHubMessaging_LL_SenderStateChanged shall set the isOpened local variable to true ] */
+    TEST_FUNCTION(IoTHubMessaging_LL_SenderStateChanged_call_user_callback)
+    {
+        //arrange
+        IOTHUB_MESSAGING_HANDLE iothub_messaging_handle = IoTHubMessaging_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+        (void)IoTHubMessaging_LL_Open(iothub_messaging_handle, TEST_FUNC_IOTHUB_OPEN_COMPLETE_CALLBACK, (void*)1);
+        onMessageReceiverStateChangedCallback(msg_recv_ctx, MESSAGE_RECEIVER_STATE_OPEN, MESSAGE_RECEIVER_STATE_IDLE);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(TEST_FUNC_IOTHUB_OPEN_COMPLETE_CALLBACK(IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+
+        MESSAGE_SENDER_STATE new_state = MESSAGE_SENDER_STATE_OPEN;
+        MESSAGE_SENDER_STATE previous_state = MESSAGE_SENDER_STATE_IDLE;
+
+        //act
+        onMessageSenderStateChangedCallback(iothub_messaging_handle, new_state, previous_state);
+
+        //assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        IoTHubMessaging_LL_Close(iothub_messaging_handle);
+        IoTHubMessaging_LL_Destroy(iothub_messaging_handle);
+    }
+
+    /*Tests_SRS_IOTHUBMESSAGING_12_049: [ IoTHubMessaging_LL_SenderStateChanged shall save the new_state to local variable ] */
+    /*Tests_SRS_IOTHUBMESSAGING_12_051: [ If neither sender_state nor receiver_state is open IoTHubMessaging_LL_SenderStateChanged shall set the local isOpened variable to false ] */
+    TEST_FUNCTION(IoTHubMessaging_LL_SenderStateChanged_messaging_is_not_opened)
+    {
+        //arrange
+        IOTHUB_MESSAGING_HANDLE iothub_messaging_handle = IoTHubMessaging_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+        (void)IoTHubMessaging_LL_Open(iothub_messaging_handle, TEST_FUNC_IOTHUB_OPEN_COMPLETE_CALLBACK, (void*)1);
+
+        umock_c_reset_all_calls();
+
+        MESSAGE_SENDER_STATE new_state = MESSAGE_SENDER_STATE_OPENING;
+        MESSAGE_SENDER_STATE previous_state = MESSAGE_SENDER_STATE_IDLE;
+
+        //act
+        onMessageSenderStateChangedCallback(iothub_messaging_handle, new_state, previous_state);
+
+        //assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        IoTHubMessaging_LL_Close(iothub_messaging_handle);
+        IoTHubMessaging_LL_Destroy(iothub_messaging_handle);
+    }
+
+    /*Tests_SRS_IOTHUBMESSAGING_12_049: [ IoTHubMessaging_LL_SenderStateChanged shall save the new_state to local variable ] */
+    /*Tests_SRS_IOTHUBMESSAGING_12_051: [ If neither sender_state nor receiver_state is open IoTHubMessaging_LL_SenderStateChanged shall set the local isOpened variable to false ] */
+    TEST_FUNCTION(IoTHubMessaging_LL_SenderStateChanged_openCompleteCompleteCallback_is_null)
+    {
+        //arrange
+        IOTHUB_MESSAGING_HANDLE iothub_messaging_handle = IoTHubMessaging_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+        (void)IoTHubMessaging_LL_Open(iothub_messaging_handle, NULL, NULL);
+        onMessageReceiverStateChangedCallback(msg_recv_ctx, MESSAGE_RECEIVER_STATE_OPEN, MESSAGE_RECEIVER_STATE_IDLE);
+        umock_c_reset_all_calls();
+
+        MESSAGE_SENDER_STATE new_state = MESSAGE_SENDER_STATE_OPEN;
+        MESSAGE_SENDER_STATE previous_state = MESSAGE_SENDER_STATE_IDLE;
+
+        //act
+        onMessageSenderStateChangedCallback(iothub_messaging_handle, new_state, previous_state);
+
+        //assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        IoTHubMessaging_LL_Close(iothub_messaging_handle);
+        IoTHubMessaging_LL_Destroy(iothub_messaging_handle);
+    }
+
+    /*Tests_SRS_IOTHUBMESSAGING_12_052: [ IoTHubMessaging_LL_ReceiverStateChanged shall save the new_state to local variable ] */
+    /*Tests_SRS_IOTHUBMESSAGING_12_053: [ If both sender and receiver state is open IoTHubMessaging_LL_ReceiverStateChanged shall set the isOpened local variable to true ] */
+    TEST_FUNCTION(IoTHubMessaging_LL_ReceiverStateChanged_call_user_callback)
+    {
+        //arrange
+        IOTHUB_MESSAGING_HANDLE iothub_messaging_handle = IoTHubMessaging_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+        (void)IoTHubMessaging_LL_Open(iothub_messaging_handle, TEST_FUNC_IOTHUB_OPEN_COMPLETE_CALLBACK, (void*)1);
+        onMessageSenderStateChangedCallback(msg_send_ctx, MESSAGE_SENDER_STATE_OPEN, MESSAGE_SENDER_STATE_IDLE);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(TEST_FUNC_IOTHUB_OPEN_COMPLETE_CALLBACK(IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+
+        MESSAGE_RECEIVER_STATE new_state = MESSAGE_RECEIVER_STATE_OPEN;
+        MESSAGE_RECEIVER_STATE previous_state = MESSAGE_RECEIVER_STATE_IDLE;
+
+        //act
+        onMessageReceiverStateChangedCallback(iothub_messaging_handle, new_state, previous_state);
+
+        //assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        IoTHubMessaging_LL_Close(iothub_messaging_handle);
+        IoTHubMessaging_LL_Destroy(iothub_messaging_handle);
+    }
+
+    /*Tests_SRS_IOTHUBMESSAGING_12_052: [ IoTHubMessaging_LL_ReceiverStateChanged shall save the new_state to local variable ] */
+    /*Tests_SRS_IOTHUBMESSAGING_12_054: [ If neither sender_state nor receiver_state is open IoTHubMessaging_LL_ReceiverStateChanged shall set the local isOpened variable to false ] */
+    TEST_FUNCTION(IoTHubMessaging_LL_ReceiverStateChanged_messaging_is_not_opened)
+    {
+        //arrange
+        IOTHUB_MESSAGING_HANDLE iothub_messaging_handle = IoTHubMessaging_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+        (void)IoTHubMessaging_LL_Open(iothub_messaging_handle, TEST_FUNC_IOTHUB_OPEN_COMPLETE_CALLBACK, (void*)1);
+        onMessageSenderStateChangedCallback(msg_send_ctx, MESSAGE_SENDER_STATE_OPEN, MESSAGE_SENDER_STATE_IDLE);
+        umock_c_reset_all_calls();
+
+        MESSAGE_RECEIVER_STATE new_state = MESSAGE_RECEIVER_STATE_OPENING;
+        MESSAGE_RECEIVER_STATE previous_state = MESSAGE_RECEIVER_STATE_IDLE;
+
+        //act
+        onMessageReceiverStateChangedCallback(iothub_messaging_handle, new_state, previous_state);
+
+        //assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        IoTHubMessaging_LL_Close(iothub_messaging_handle);
+        IoTHubMessaging_LL_Destroy(iothub_messaging_handle);
+    }
+
+    /*Tests_SRS_IOTHUBMESSAGING_12_052: [ IoTHubMessaging_LL_ReceiverStateChanged shall save the new_state to local variable ] */
+    /*Tests_SRS_IOTHUBMESSAGING_12_054: [ If neither sender_state nor receiver_state is open IoTHubMessaging_LL_ReceiverStateChanged shall set the local isOpened variable to false ] */
+    TEST_FUNCTION(IoTHubMessaging_LL_ReceiverStateChanged_openCompleteCompleteCallback_is_null)
+    {
+        //arrange
+        IOTHUB_MESSAGING_HANDLE iothub_messaging_handle = IoTHubMessaging_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+        (void)IoTHubMessaging_LL_Open(iothub_messaging_handle, NULL, NULL);
+        onMessageSenderStateChangedCallback(msg_send_ctx, MESSAGE_SENDER_STATE_OPEN, MESSAGE_SENDER_STATE_IDLE);
+        umock_c_reset_all_calls();
+
+        MESSAGE_RECEIVER_STATE new_state = MESSAGE_RECEIVER_STATE_OPEN;
+        MESSAGE_RECEIVER_STATE previous_state = MESSAGE_RECEIVER_STATE_IDLE;
+
+        //act
+        onMessageReceiverStateChangedCallback(iothub_messaging_handle, new_state, previous_state);
+
+        //assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        IoTHubMessaging_LL_Close(iothub_messaging_handle);
+        IoTHubMessaging_LL_Destroy(iothub_messaging_handle);
+    }
+
+    /*Tests_SRS_IOTHUBMESSAGING_12_056: [ If context is NULL IoTHubMessaging_LL_SendMessageComplete shall return ] */
+    /*Tests_SRS_IOTHUBMESSAGING_12_055: [ If context is not NULL and IoTHubMessaging_LL_SendMessageComplete shall call user callback with user context and messaging result ] */
+    TEST_FUNCTION(IoTHubMessaging_LL_SendMessageComplete_context_is_null)
+    {
+        //arrange
+        IOTHUB_MESSAGING_HANDLE iothub_messaging_handle = IoTHubMessaging_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+        (void)IoTHubMessaging_LL_Open(iothub_messaging_handle, TEST_FUNC_IOTHUB_OPEN_COMPLETE_CALLBACK, (void*)1);
+        (void)IoTHubMessaging_LL_Send(iothub_messaging_handle, TEST_DEVICE_ID, TEST_IOTHUB_MESSAGE_HANDLE, TEST_FUNC_IOTHUB_SEND_COMPLETE_CALLBACK, (void*)1);
+
+        umock_c_reset_all_calls();
+
+        MESSAGE_SEND_RESULT send_result = MESSAGE_SEND_OK;
+
+        //act
+        onMessageSendCompleteCallback((void*)NULL, send_result, TEST_AMQP_VALUE);
+
+        //assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        IoTHubMessaging_LL_Close(iothub_messaging_handle);
+        IoTHubMessaging_LL_Destroy(iothub_messaging_handle);
+    }
+
+    /*Tests_SRS_IOTHUBMESSAGING_12_056: [ If context is NULL IoTHubMessaging_LL_SendMessageComplete shall return ] */
+    /*Tests_SRS_IOTHUBMESSAGING_12_055: [ If context is not NULL and IoTHubMessaging_LL_SendMessageComplete shall call user callback with user context and messaging result ] */
+    TEST_FUNCTION(IoTHubMessaging_LL_SendMessageComplete_sendCompleteCallback_null)
+    {
+        //arrange
+        IOTHUB_MESSAGING_HANDLE iothub_messaging_handle = IoTHubMessaging_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+        (void)IoTHubMessaging_LL_Open(iothub_messaging_handle, TEST_FUNC_IOTHUB_OPEN_COMPLETE_CALLBACK, (void*)1);
+        (void)IoTHubMessaging_LL_Send(iothub_messaging_handle, TEST_DEVICE_ID, TEST_IOTHUB_MESSAGE_HANDLE, NULL, NULL);
 
         umock_c_reset_all_calls();
 
@@ -2437,192 +2867,623 @@ BEGIN_TEST_SUITE(iothub_messaging_ll_ut)
         STRICT_EXPECTED_CALL(TEST_FUNC_IOTHUB_FEEDBACK_MESSAGE_RECEIVED_CALLBACK(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
         STRICT_EXPECTED_CALL(messaging_delivery_accepted());
 
-        STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
+        STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+
+        STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+
+        STRICT_EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        STRICT_EXPECTED_CALL(singlylinkedlist_destroy(IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        STRICT_EXPECTED_CALL(json_array_clear(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(json_value_free(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
+
+        //act
+        onMessageReceivedCallback(iothub_messaging_handle, TEST_MESSAGE_HANDLE);
+
+        //assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_FEEDBACK_STATUS_CODE_UNKNOWN, receivedFeedbackStatusCode);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        IoTHubMessaging_LL_Close(iothub_messaging_handle);
+        IoTHubMessaging_LL_Destroy(iothub_messaging_handle);
+    }
+
+    /*Tests_SRS_IOTHUBMESSAGING_12_061: [ If any of the parson API fails, IoTHubMessaging_LL_FeedbackMessageReceived shall return IOTHUB_MESSAGING_INVALID_JSON ] */
+    /*Tests_SRS_IOTHUBMESSAGING_12_078: [** IoTHubMessaging_LL_FeedbackMessageReceived shall do clean up before exits ] */
+    TEST_FUNCTION(IoTHubMessaging_LL_FeedbackMessageReceived_non_happy_path)
+    {
+        //arrange
+        int umockc_result = umock_c_negative_tests_init();
+        ASSERT_ARE_EQUAL(int, 0, umockc_result);
+
+        IOTHUB_MESSAGING_HANDLE iothub_messaging_handle = IoTHubMessaging_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+        (void)IoTHubMessaging_LL_Open(iothub_messaging_handle, TEST_FUNC_IOTHUB_OPEN_COMPLETE_CALLBACK, (void*)1);
+        (void)IoTHubMessaging_LL_SetFeedbackMessageCallback(iothub_messaging_handle, TEST_FUNC_IOTHUB_FEEDBACK_MESSAGE_RECEIVED_CALLBACK, (void*)1);
+
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(message_get_body_amqp_data_in_place(IGNORED_PTR_ARG, IGNORED_NUM_ARG, &TEST_BINARY_DATA_INST))
+            .IgnoreAllArguments();
+
+        STRICT_EXPECTED_CALL(json_parse_string(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        STRICT_EXPECTED_CALL(json_value_get_array(TEST_JSON_VALUE))
+            .IgnoreArgument(1);
+
+        STRICT_EXPECTED_CALL(json_array_get_count(TEST_JSON_ARRAY))
+            .SetReturn(1);
+
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
+
+        STRICT_EXPECTED_CALL(json_array_get_count(TEST_JSON_ARRAY))
+            .SetReturn(1);
+
+        STRICT_EXPECTED_CALL(singlylinkedlist_create());
+
+        STRICT_EXPECTED_CALL(json_array_get_object(TEST_JSON_ARRAY, 0))
+            .SetReturn(TEST_JSON_OBJECT);
+
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
+
+        STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, TEST_FEEDBACK_RECORD_KEY_DEVICE_ID))
+            .SetReturn("deviceId");
+        STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, TEST_FEEDBACK_RECORD_KEY_DEVICE_GENERATION_ID))
+            .SetReturn("generationId");
+        STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, TEST_FEEDBACK_RECORD_KEY_DESCRIPTION))
+            .SetReturn("success");
+        STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, TEST_FEEDBACK_RECORD_KEY_ENQUED_TIME_UTC))
+            .SetReturn("time");
+        STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, TEST_FEEDBACK_RECORD_KEY_ORIGINAL_MESSAGE_ID))
+            .SetReturn("originalMessageId");
+
+
+        STRICT_EXPECTED_CALL(singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+
+        STRICT_EXPECTED_CALL(messaging_delivery_accepted());
+
+        umock_c_negative_tests_snapshot();
+
+        for (size_t i = 0; i < umock_c_negative_tests_call_count(); i++)
+        {
+            /// arrange
+            umock_c_negative_tests_reset();
+            umock_c_negative_tests_fail_call(i);
+
+            if (i <= 9)
+            {
+                //act
+                AMQP_VALUE amqp_result = onMessageReceivedCallback(iothub_messaging_handle, TEST_MESSAGE_HANDLE);
+
+                //assert
+                if (i < 7)
+                {
+                    if (amqp_result != NULL)
+                    {
+                        ASSERT_ARE_EQUAL(int, 0, 1);
+                    }
+                }
+            }
+        }
+        umock_c_negative_tests_deinit();
+
+        ///cleanup
+        IoTHubMessaging_LL_Close(iothub_messaging_handle);
+        IoTHubMessaging_LL_Destroy(iothub_messaging_handle);
+    }
+
+    TEST_FUNCTION(IoTHubMessaging_LL_SetTrustedCert_success)
+    {
+        //arrange
+        IOTHUB_MESSAGING_HANDLE iothub_messaging_handle = IoTHubMessaging_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_TRUSTED_CERT));
+
+        //act
+        IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_LL_SetTrustedCert(iothub_messaging_handle, TEST_TRUSTED_CERT);
+
+        //assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGING_OK, result);
+
+        //cleanup
+        IoTHubMessaging_LL_Destroy(iothub_messaging_handle);
+    }
+
+    TEST_FUNCTION(IoTHubMessaging_LL_SetTrustedCert_2_calls_success)
+    {
+        //arrange
+        IOTHUB_MESSAGING_HANDLE iothub_messaging_handle = IoTHubMessaging_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+        IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_LL_SetTrustedCert(iothub_messaging_handle, TEST_TRUSTED_CERT);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_TRUSTED_CERT));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+        //act
+        result = IoTHubMessaging_LL_SetTrustedCert(iothub_messaging_handle, TEST_TRUSTED_CERT);
+
+        //assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGING_OK, result);
+
+        //cleanup
+        IoTHubMessaging_LL_Destroy(iothub_messaging_handle);
+    }
+
+    TEST_FUNCTION(IoTHubMessaging_LL_SetTrustedCert_handle_NULL_fail)
+    {
+        //arrange
+
+        //act
+        IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_LL_SetTrustedCert(NULL, TEST_TRUSTED_CERT);
+
+        //assert
+        ASSERT_ARE_NOT_EQUAL(int, IOTHUB_MESSAGING_OK, result);
+
+        //cleanup
+    }
+
+    TEST_FUNCTION(IoTHubMessaging_LL_SetTrustedCert_trusted_cert_NULL_fail)
+    {
+        //arrange
+        IOTHUB_MESSAGING_HANDLE iothub_messaging_handle = IoTHubMessaging_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+        umock_c_reset_all_calls();
+
+        //act
+        IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_LL_SetTrustedCert(iothub_messaging_handle, NULL);
+
+        //assert
+        ASSERT_ARE_NOT_EQUAL(int, IOTHUB_MESSAGING_OK, result);
+
+        //cleanup
+        IoTHubMessaging_LL_Destroy(iothub_messaging_handle);
+    }
+
+    /*Tests_SRS_IOTHUBMESSAGING_41_014: [ If messagingHandle is NULL or senderLinkCount is 0 or greater than IOTHUB_MESSAGING_MAX_SENDER_LINKS, IoTHubMessaging_LL_SetSenderLinkCount shall return IOTHUB_MESSAGING_INVALID_ARG. ]*/
+    TEST_FUNCTION(IoTHubMessaging_LL_SetSenderLinkCount_return_IOTHUB_MESSAGING_INVALID_ARG_if_input_parameter_messagingHandle_is_NULL)
+    {
+        //arrange
+
+        //act
+        IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_LL_SetSenderLinkCount(NULL, 2);
+
+        //assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGING_INVALID_ARG, result);
+    }
+
+    /*Tests_SRS_IOTHUBMESSAGING_41_014: [ If messagingHandle is NULL or senderLinkCount is 0 or greater than IOTHUB_MESSAGING_MAX_SENDER_LINKS, IoTHubMessaging_LL_SetSenderLinkCount shall return IOTHUB_MESSAGING_INVALID_ARG. ]*/
+    TEST_FUNCTION(IoTHubMessaging_LL_SetSenderLinkCount_return_IOTHUB_MESSAGING_INVALID_ARG_if_senderLinkCount_is_out_of_range)
+    {
+        //arrange
+        IOTHUB_MESSAGING_HANDLE iothub_messaging_handle = IoTHubMessaging_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+        umock_c_reset_all_calls();
+
+        //act
+        IOTHUB_MESSAGING_RESULT result1 = IoTHubMessaging_LL_SetSenderLinkCount(iothub_messaging_handle, 0);
+        IOTHUB_MESSAGING_RESULT result2 = IoTHubMessaging_LL_SetSenderLinkCount(iothub_messaging_handle, IOTHUB_MESSAGING_MAX_SENDER_LINKS + 1);
+
+        //assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGING_INVALID_ARG, result1);
+        ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGING_INVALID_ARG, result2);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        IoTHubMessaging_LL_Destroy(iothub_messaging_handle);
+    }
+
+    /*Tests_SRS_IOTHUBMESSAGING_41_023: [ If the messaging is opened IoTHubMessaging_LL_SetSenderLinkCount shall return IOTHUB_MESSAGING_ERROR. ]*/
+    TEST_FUNCTION(IoTHubMessaging_LL_SetSenderLinkCount_return_IOTHUB_MESSAGING_ERROR_if_messaging_is_opened)
+    {
+        //arrange
+        IOTHUB_MESSAGING_HANDLE iothub_messaging_handle = IoTHubMessaging_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+        (void)IoTHubMessaging_LL_Open(iothub_messaging_handle, NULL, NULL);
+        umock_c_reset_all_calls();
+
+        //act
+        IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_LL_SetSenderLinkCount(iothub_messaging_handle, 2);
+
+        //assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGING_ERROR, result);
+
+        //cleanup
+        IoTHubMessaging_LL_Close(iothub_messaging_handle);
+        IoTHubMessaging_LL_Destroy(iothub_messaging_handle);
+    }
+
+    /*Tests_SRS_IOTHUBMESSAGING_41_024: [ Otherwise IoTHubMessaging_LL_SetSenderLinkCount shall save the count to be used by the next IoTHubMessaging_LL_Open and return IOTHUB_MESSAGING_OK. ]*/
+    TEST_FUNCTION(IoTHubMessaging_LL_SetSenderLinkCount_success)
+    {
+        //arrange
+        IOTHUB_MESSAGING_HANDLE iothub_messaging_handle = IoTHubMessaging_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+        umock_c_reset_all_calls();
 
-        STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
+        //act
+        IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_LL_SetSenderLinkCount(iothub_messaging_handle, IOTHUB_MESSAGING_MAX_SENDER_LINKS);
 
-        STRICT_EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
+        //assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGING_OK, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
+        //cleanup
+        IoTHubMessaging_LL_Destroy(iothub_messaging_handle);
+    }
 
-        STRICT_EXPECTED_CALL(singlylinkedlist_destroy(IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
+    static void set_expected_calls_for_pooled_sender(const char* linkName)
+    {
+        STRICT_EXPECTED_CALL(session_create(TEST_CONNECTION_HANDLE, NULL, NULL));
+        STRICT_EXPECTED_CALL(session_set_incoming_window(TEST_SESSION_HANDLE, 2147483647));
+        STRICT_EXPECTED_CALL(session_set_outgoing_window(TEST_SESSION_HANDLE, 255 * 1024));
+        STRICT_EXPECTED_CALL(messaging_create_source("ingress"));
+        STRICT_EXPECTED_CALL(messaging_create_target(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(link_create(TEST_SESSION_HANDLE, linkName, role_sender, TEST_AMQP_VALUE, TEST_AMQP_VALUE));
+        addSetLinkCalls();
+        STRICT_EXPECTED_CALL(link_set_snd_settle_mode(TEST_LINK_HANDLE, sender_settle_mode_unsettled));
+        STRICT_EXPECTED_CALL(messagesender_create(TEST_LINK_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(messagesender_open(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
+        STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
+    }
 
-        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
+    /*Tests_SRS_IOTHUBMESSAGING_41_015: [ After the receiver IoTHubMessaging_LL_Open shall create the sender link count - 1 pooled senders on the same connection. ]*/
+    /*Tests_SRS_IOTHUBMESSAGING_41_017: [ Each pooled sender shall get its own session on the connection, with the same windows as the primary session, and a sender link named sender-link-<n> created, attached, settled and opened the same way as the primary sender link. ]*/
+    TEST_FUNCTION(IoTHubMessaging_LL_Open_creates_the_pooled_senders)
+    {
+        //arrange
+        IOTHUB_MESSAGING_HANDLE iothub_messaging_handle = IoTHubMessaging_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+        (void)IoTHubMessaging_LL_SetSenderLinkCount(iothub_messaging_handle, 3);
+        umock_c_reset_all_calls();
 
-        STRICT_EXPECTED_CALL(json_array_clear(IGNORED_NUM_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(json_value_free(IGNORED_NUM_ARG))
-            .IgnoreArgument(1);
+        callsForOpenUntilReceiver();
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+        set_expected_calls_for_pooled_sender("sender-link-1");
+        set_expected_calls_for_pooled_sender("sender-link-2");
+        callsForOpenRelease();
 
         //act
-        onMessageReceivedCallback(iothub_messaging_handle, TEST_MESSAGE_HANDLE);
+        IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_LL_Open(iothub_messaging_handle, TEST_IOTHUB_OPEN_COMPLETE_CALLBACK, (void*)0x4242);
 
         //assert
-        ASSERT_ARE_EQUAL(int, IOTHUB_FEEDBACK_STATUS_CODE_UNKNOWN, receivedFeedbackStatusCode);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGING_OK, result);
 
-        ///cleanup
+        //cleanup
         IoTHubMessaging_LL_Close(iothub_messaging_handle);
         IoTHubMessaging_LL_Destroy(iothub_messaging_handle);
     }
 
-    /*Tests_SRS_IOTHUBMESSAGING_12_061: [ If any of the parson API fails, IoTHubMessaging_LL_FeedbackMessageReceived shall return IOTHUB_MESSAGING_INVALID_JSON ] */
-    /*Tests_SRS_IOTHUBMESSAGING_12_078: [** IoTHubMessaging_LL_FeedbackMessageReceived shall do clean up before exits ] */
-    TEST_FUNCTION(IoTHubMessaging_LL_FeedbackMessageReceived_non_happy_path)
+    /*Tests_SRS_IOTHUBMESSAGING_41_018: [ If creating any of the pooled senders fails IoTHubMessaging_LL_Open shall destroy all of them and fail like any other uAMQP failure. ]*/
+    TEST_FUNCTION(IoTHubMessaging_LL_Open_return_IOTHUB_MESSAGING_ERROR_if_a_pooled_sender_fails)
     {
         //arrange
-        int umockc_result = umock_c_negative_tests_init();
-        ASSERT_ARE_EQUAL(int, 0, umockc_result);
+        IOTHUB_MESSAGING_HANDLE iothub_messaging_handle = IoTHubMessaging_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+        (void)IoTHubMessaging_LL_SetSenderLinkCount(iothub_messaging_handle, 3);
+        umock_c_reset_all_calls();
+
+        callsForOpenUntilReceiver();
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+        set_expected_calls_for_pooled_sender("sender-link-1");
+        STRICT_EXPECTED_CALL(session_create(TEST_CONNECTION_HANDLE, NULL, NULL))
+            .SetReturn(NULL);
+        STRICT_EXPECTED_CALL(messagesender_destroy(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(link_destroy(TEST_LINK_HANDLE));
+        STRICT_EXPECTED_CALL(session_destroy(TEST_SESSION_HANDLE));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(messagereceiver_destroy(IGNORED_PTR_ARG));
+
+        //act
+        IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_LL_Open(iothub_messaging_handle, TEST_IOTHUB_OPEN_COMPLETE_CALLBACK, (void*)0x4242);
+
+        //assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGING_ERROR, result);
+
+        //cleanup
+        IoTHubMessaging_LL_Destroy(iothub_messaging_handle);
+    }
 
+    /*Tests_SRS_IOTHUBMESSAGING_41_022: [ IoTHubMessaging_LL_Close shall destroy the message sender, link and session of every pooled sender. ]*/
+    TEST_FUNCTION(IoTHubMessaging_LL_Close_destroys_the_pooled_senders)
+    {
+        // arrange
         IOTHUB_MESSAGING_HANDLE iothub_messaging_handle = IoTHubMessaging_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+        (void)IoTHubMessaging_LL_SetSenderLinkCount(iothub_messaging_handle, 2);
         (void)IoTHubMessaging_LL_Open(iothub_messaging_handle, TEST_FUNC_IOTHUB_OPEN_COMPLETE_CALLBACK, (void*)1);
-        (void)IoTHubMessaging_LL_SetFeedbackMessageCallback(iothub_messaging_handle, TEST_FUNC_IOTHUB_FEEDBACK_MESSAGE_RECEIVED_CALLBACK, (void*)1);
-
         umock_c_reset_all_calls();
 
-        STRICT_EXPECTED_CALL(message_get_body_amqp_data_in_place(IGNORED_PTR_ARG, IGNORED_NUM_ARG, &TEST_BINARY_DATA_INST))
-            .IgnoreAllArguments();
+        STRICT_EXPECTED_CALL(messagesender_destroy(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(messagesender_destroy(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(link_destroy(TEST_LINK_HANDLE));
+        STRICT_EXPECTED_CALL(session_destroy(TEST_SESSION_HANDLE));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(messagereceiver_destroy(IGNORED_PTR_ARG));
 
-        STRICT_EXPECTED_CALL(json_parse_string(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(link_destroy(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(link_destroy(IGNORED_PTR_ARG));
 
-        STRICT_EXPECTED_CALL(json_value_get_array(TEST_JSON_VALUE))
-            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(session_destroy(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(connection_destroy(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(xio_destroy(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(xio_destroy(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(saslmechanism_destroy(IGNORED_PTR_ARG));
 
-        STRICT_EXPECTED_CALL(json_array_get_count(TEST_JSON_ARRAY))
-            .SetReturn(1);
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
 
-        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
-            .IgnoreArgument(1);
+        // act
+        IoTHubMessaging_LL_Close(iothub_messaging_handle);
 
-        STRICT_EXPECTED_CALL(json_array_get_count(TEST_JSON_ARRAY))
-            .SetReturn(1);
+        // assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-        STRICT_EXPECTED_CALL(singlylinkedlist_create());
+        //cleanup
+        IoTHubMessaging_LL_Destroy(iothub_messaging_handle);
+    }
 
-        STRICT_EXPECTED_CALL(json_array_get_object(TEST_JSON_ARRAY, 0))
-            .SetReturn(TEST_JSON_OBJECT);
+    /*Tests_SRS_IOTHUBMESSAGING_41_021: [ With pooled senders the deliveries of a batch shall be dispatched round-robin and up to IOTHUB_MESSAGING_BATCH_MAX_IN_FLIGHT deliveries shall be queued per sender link. ]*/
+    TEST_FUNCTION(IoTHubMessaging_LL_SendBatch_dispatches_round_robin_over_the_open_pooled_senders)
+    {
+        //arrange
+        IOTHUB_MESSAGING_HANDLE iothub_messaging_handle = IoTHubMessaging_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+        (void)IoTHubMessaging_LL_SetSenderLinkCount(iothub_messaging_handle, 2);
+        (void)IoTHubMessaging_LL_Open(iothub_messaging_handle, NULL, NULL);
+        MESSAGE_SENDER_HANDLE pooledSender = messagesender_create_return;
+        onMessageSenderStateChangedCallback(msg_send_ctx, MESSAGE_SENDER_STATE_OPEN, MESSAGE_SENDER_STATE_IDLE);
+        umock_c_reset_all_calls();
 
-        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
-            .IgnoreArgument(1);
+        //act
+        IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_LL_SendBatch(iothub_messaging_handle, TEST_BATCH_DEVICE_IDS, 2, TEST_IOTHUB_MESSAGE_HANDLE, TEST_FUNC_IOTHUB_SEND_BATCH_COMPLETE_CALLBACK, TEST_VOID_PTR);
 
-        STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, TEST_FEEDBACK_RECORD_KEY_DEVICE_ID))
-            .SetReturn("deviceId");
-        STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, TEST_FEEDBACK_RECORD_KEY_DEVICE_GENERATION_ID))
-            .SetReturn("generationId");
-        STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, TEST_FEEDBACK_RECORD_KEY_DESCRIPTION))
-            .SetReturn("success");
-        STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, TEST_FEEDBACK_RECORD_KEY_ENQUED_TIME_UTC))
-            .SetReturn("time");
-        STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, TEST_FEEDBACK_RECORD_KEY_ORIGINAL_MESSAGE_ID))
-            .SetReturn("originalMessageId");
+        //assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGING_OK, result);
+        ASSERT_ARE_EQUAL(size_t, 2, sendAsyncCount);
+        ASSERT_ARE_NOT_EQUAL(void_ptr, (void*)sendAsyncSenders[0], (void*)sendAsyncSenders[1]);
+        ASSERT_ARE_EQUAL(void_ptr, (void*)pooledSender, (void*)sendAsyncSenders[1]);
+
+        //cleanup
+        IoTHubMessaging_LL_Close(iothub_messaging_handle);
+        IoTHubMessaging_LL_Destroy(iothub_messaging_handle);
+    }
 
+    /*Tests_SRS_IOTHUBMESSAGING_41_019: [ The state of a pooled sender shall only decide whether sends are dispatched to it, it shall not change the opened state of the messaging. ]*/
+    /*Tests_SRS_IOTHUBMESSAGING_41_020: [ With pooled senders IoTHubMessaging_LL_Send shall dispatch messages round-robin over the primary sender and the pooled senders that are open. ]*/
+    TEST_FUNCTION(IoTHubMessaging_LL_SendBatch_skips_the_pooled_senders_that_are_not_open)
+    {
+        //arrange
+        IOTHUB_MESSAGING_HANDLE iothub_messaging_handle = IoTHubMessaging_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+        (void)IoTHubMessaging_LL_SetSenderLinkCount(iothub_messaging_handle, 2);
+        (void)IoTHubMessaging_LL_Open(iothub_messaging_handle, NULL, NULL);
+        onMessageSenderStateChangedCallback(msg_send_ctx, MESSAGE_SENDER_STATE_ERROR, MESSAGE_SENDER_STATE_OPENING);
+        umock_c_reset_all_calls();
 
-        STRICT_EXPECTED_CALL(singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
+        //act
+        IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_LL_SendBatch(iothub_messaging_handle, TEST_BATCH_DEVICE_IDS, 2, TEST_IOTHUB_MESSAGE_HANDLE, TEST_FUNC_IOTHUB_SEND_BATCH_COMPLETE_CALLBACK, TEST_VOID_PTR);
 
-        STRICT_EXPECTED_CALL(messaging_delivery_accepted());
+        //assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGING_OK, result);
+        ASSERT_ARE_EQUAL(size_t, 2, sendAsyncCount);
+        ASSERT_ARE_EQUAL(void_ptr, (void*)sendAsyncSenders[0], (void*)sendAsyncSenders[1]);
+        ASSERT_ARE_NOT_EQUAL(void_ptr, (void*)messagesender_create_return, (void*)sendAsyncSenders[0]);
 
-        umock_c_negative_tests_snapshot();
+        //cleanup
+        IoTHubMessaging_LL_Close(iothub_messaging_handle);
+        IoTHubMessaging_LL_Destroy(iothub_messaging_handle);
+    }
 
-        for (size_t i = 0; i < umock_c_negative_tests_call_count(); i++)
+    /*Tests_SRS_IOTHUBMESSAGING_41_021: [ With pooled senders the deliveries of a batch shall be dispatched round-robin and up to IOTHUB_MESSAGING_BATCH_MAX_IN_FLIGHT deliveries shall be queued per sender link. ]*/
+    TEST_FUNCTION(IoTHubMessaging_LL_SendBatch_queues_256_deliveries_per_sender_link)
+    {
+        //arrange
+        const char* deviceIds[600];
+        size_t i;
+        for (i = 0; i < sizeof(deviceIds) / sizeof(deviceIds[0]); i++)
         {
-            /// arrange
-            umock_c_negative_tests_reset();
-            umock_c_negative_tests_fail_call(i);
+            deviceIds[i] = TEST_DEVICE_ID;
+        }
+        IOTHUB_MESSAGING_HANDLE iothub_messaging_handle = IoTHubMessaging_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+        (void)IoTHubMessaging_LL_SetSenderLinkCount(iothub_messaging_handle, 2);
+        (void)IoTHubMessaging_LL_Open(iothub_messaging_handle, NULL, NULL);
+        onMessageSenderStateChangedCallback(msg_send_ctx, MESSAGE_SENDER_STATE_OPEN, MESSAGE_SENDER_STATE_IDLE);
+        umock_c_reset_all_calls();
 
-            if (i <= 9)
-            {
-                //act
-                AMQP_VALUE amqp_result = onMessageReceivedCallback(iothub_messaging_handle, TEST_MESSAGE_HANDLE);
+        //act
+        IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_LL_SendBatch(iothub_messaging_handle, deviceIds, sizeof(deviceIds) / sizeof(deviceIds[0]), TEST_IOTHUB_MESSAGE_HANDLE, TEST_FUNC_IOTHUB_SEND_BATCH_COMPLETE_CALLBACK, TEST_VOID_PTR);
 
-                //assert
-                if (i < 7)
-                {
-                    if (amqp_result != NULL)
-                    {
-                        ASSERT_ARE_EQUAL(int, 0, 1);
-                    }
-                }
-            }
-        }
-        umock_c_negative_tests_deinit();
+        //assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGING_OK, result);
+        ASSERT_ARE_EQUAL(size_t, 512, sendAsyncCount);
 
-        ///cleanup
+        //cleanup
         IoTHubMessaging_LL_Close(iothub_messaging_handle);
         IoTHubMessaging_LL_Destroy(iothub_messaging_handle);
     }
 
-    TEST_FUNCTION(IoTHubMessaging_LL_SetTrustedCert_success)
+    /*Tests_SRS_IOTHUBMESSAGING_41_025: [ If messagingHandle is NULL, IoTHubMessaging_LL_SetFeedbackRecordCallback shall return IOTHUB_MESSAGING_INVALID_ARG. ]*/
+    TEST_FUNCTION(IoTHubMessaging_LL_SetFeedbackRecordCallback_return_IOTHUB_MESSAGING_INVALID_ARG_if_input_parameter_messagingHandle_is_NULL)
+    {
+        //arrange
+
+        //act
+        IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_LL_SetFeedbackRecordCallback(NULL, TEST_FUNC_IOTHUB_FEEDBACK_RECORD_RECEIVED_CALLBACK, TEST_VOID_PTR);
+
+        //assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGING_INVALID_ARG, result);
+    }
+
+    /*Tests_SRS_IOTHUBMESSAGING_41_026: [ Otherwise IoTHubMessaging_LL_SetFeedbackRecordCallback shall save the callback and its context, a NULL callback turning the streaming back off, and return IOTHUB_MESSAGING_OK. ]*/
+    TEST_FUNCTION(IoTHubMessaging_LL_SetFeedbackRecordCallback_happy_path)
     {
         //arrange
         IOTHUB_MESSAGING_HANDLE iothub_messaging_handle = IoTHubMessaging_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
         umock_c_reset_all_calls();
 
-        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_TRUSTED_CERT));
-
         //act
-        IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_LL_SetTrustedCert(iothub_messaging_handle, TEST_TRUSTED_CERT);
+        IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_LL_SetFeedbackRecordCallback(iothub_messaging_handle, TEST_FUNC_IOTHUB_FEEDBACK_RECORD_RECEIVED_CALLBACK, TEST_VOID_PTR);
 
         //assert
         ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGING_OK, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         //cleanup
         IoTHubMessaging_LL_Destroy(iothub_messaging_handle);
     }
 
-    TEST_FUNCTION(IoTHubMessaging_LL_SetTrustedCert_2_calls_success)
+    /*Tests_SRS_IOTHUBMESSAGING_41_027: [ If a feedback record callback is set, IoTHubMessaging_LL_FeedbackMessageReceived shall not use parson nor build an IOTHUB_SERVICE_FEEDBACK_BATCH, it shall copy the message body into a buffer kept by the messaging instance that only grows when a larger body arrives. ]*/
+    /*Tests_SRS_IOTHUBMESSAGING_41_028: [ IoTHubMessaging_LL_FeedbackMessageReceived shall call the feedback record callback once per record with the same IOTHUB_SERVICE_FEEDBACK_RECORD, whose fields point into the copied body and are only valid during the call. ]*/
+    /*Tests_SRS_IOTHUBMESSAGING_41_029: [ Members other than deviceId, deviceGenerationId, description, enqueuedTimeUtc and originalMessageId shall be skipped, and a field whose value is not a string shall be NULL. ]*/
+    /*Tests_SRS_IOTHUBMESSAGING_41_030: [ The statusCode of the record shall be derived from the description the same way as for IOTHUB_SERVICE_FEEDBACK_BATCH records. ]*/
+    /*Tests_SRS_IOTHUBMESSAGING_41_034: [ Otherwise IoTHubMessaging_LL_FeedbackMessageReceived shall return messaging_delivery_accepted. ]*/
+    TEST_FUNCTION(IoTHubMessaging_LL_FeedbackMessageReceived_streams_the_feedback_records)
     {
         //arrange
         IOTHUB_MESSAGING_HANDLE iothub_messaging_handle = IoTHubMessaging_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
-        IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_LL_SetTrustedCert(iothub_messaging_handle, TEST_TRUSTED_CERT);
+        (void)IoTHubMessaging_LL_Open(iothub_messaging_handle, TEST_FUNC_IOTHUB_OPEN_COMPLETE_CALLBACK, (void*)1);
+        (void)IoTHubMessaging_LL_SetFeedbackMessageCallback(iothub_messaging_handle, TEST_FUNC_IOTHUB_FEEDBACK_MESSAGE_RECEIVED_CALLBACK, (void*)1);
+        (void)IoTHubMessaging_LL_SetFeedbackRecordCallback(iothub_messaging_handle, TEST_FUNC_IOTHUB_FEEDBACK_RECORD_RECEIVED_CALLBACK, TEST_VOID_PTR);
+        feedbackMessageBody = "[{\"originalMessageId\":\"m1\",\"description\":\"Success\",\"deviceGenerationId\":\"g1\",\"deviceId\":\"d\\u00e9v1\",\"enqueuedTimeUtc\":\"t1\"},"
+            "{\"deviceId\":\"dev2\",\"description\":\"DeliveryCountExceeded\",\"extra\":{\"n\":[1,true,null]}}]";
         umock_c_reset_all_calls();
 
-        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_TRUSTED_CERT));
-        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(message_get_body_amqp_data_in_place(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+        STRICT_EXPECTED_CALL(TEST_FUNC_IOTHUB_FEEDBACK_RECORD_RECEIVED_CALLBACK(TEST_VOID_PTR, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(TEST_FUNC_IOTHUB_FEEDBACK_RECORD_RECEIVED_CALLBACK(TEST_VOID_PTR, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(messaging_delivery_accepted());
 
         //act
-        result = IoTHubMessaging_LL_SetTrustedCert(iothub_messaging_handle, TEST_TRUSTED_CERT);
+        onMessageReceivedCallback(iothub_messaging_handle, TEST_MESSAGE_HANDLE);
 
         //assert
-        ASSERT_ARE_EQUAL(int, IOTHUB_MESSAGING_OK, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, 2, receivedFeedbackRecordCount);
+        ASSERT_ARE_EQUAL(char_ptr, "d\xc3\xa9v1", receivedFeedbackRecordDeviceIds[0]);
+        ASSERT_ARE_EQUAL(int, IOTHUB_FEEDBACK_STATUS_CODE_SUCCESS, receivedFeedbackRecordStatusCodes[0]);
+        ASSERT_ARE_EQUAL(char_ptr, "dev2", receivedFeedbackRecordDeviceIds[1]);
+        ASSERT_ARE_EQUAL(int, IOTHUB_FEEDBACK_STATUS_CODE_DELIVER_COUNT_EXCEEDED, receivedFeedbackRecordStatusCodes[1]);
 
-        //cleanup
+        ///cleanup
+        IoTHubMessaging_LL_Close(iothub_messaging_handle);
         IoTHubMessaging_LL_Destroy(iothub_messaging_handle);
     }
 
-    TEST_FUNCTION(IoTHubMessaging_LL_SetTrustedCert_handle_NULL_fail)
+    /*Tests_SRS_IOTHUBMESSAGING_41_027: [ If a feedback record callback is set, IoTHubMessaging_LL_FeedbackMessageReceived shall not use parson nor build an IOTHUB_SERVICE_FEEDBACK_BATCH, it shall copy the message body into a buffer kept by the messaging instance that only grows when a larger body arrives. ]*/
+    /*Tests_SRS_IOTHUBMESSAGING_41_033: [ IoTHubMessaging_LL_Destroy shall free the buffer used for streaming feedback records. ]*/
+    TEST_FUNCTION(IoTHubMessaging_LL_FeedbackMessageReceived_reuses_the_feedback_buffer)
     {
         //arrange
+        IOTHUB_MESSAGING_HANDLE iothub_messaging_handle = IoTHubMessaging_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+        (void)IoTHubMessaging_LL_Open(iothub_messaging_handle, TEST_FUNC_IOTHUB_OPEN_COMPLETE_CALLBACK, (void*)1);
+        (void)IoTHubMessaging_LL_SetFeedbackRecordCallback(iothub_messaging_handle, TEST_FUNC_IOTHUB_FEEDBACK_RECORD_RECEIVED_CALLBACK, TEST_VOID_PTR);
+        feedbackMessageBody = "[{\"deviceId\":\"aLongerDeviceId\",\"description\":\"expired\"}]";
+        (void)onMessageReceivedCallback(iothub_messaging_handle, TEST_MESSAGE_HANDLE);
+        feedbackMessageBody = "[{\"deviceId\":\"dev\",\"description\":\"rejected\"}]";
+        IoTHubMessaging_LL_Close(iothub_messaging_handle);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(message_get_body_amqp_data_in_place(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+        STRICT_EXPECTED_CALL(TEST_FUNC_IOTHUB_FEEDBACK_RECORD_RECEIVED_CALLBACK(TEST_VOID_PTR, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(messaging_delivery_accepted());
 
         //act
-        IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_LL_SetTrustedCert(NULL, TEST_TRUSTED_CERT);
+        onMessageReceivedCallback(iothub_messaging_handle, TEST_MESSAGE_HANDLE);
 
         //assert
-        ASSERT_ARE_NOT_EQUAL(int, IOTHUB_MESSAGING_OK, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, 2, receivedFeedbackRecordCount);
+        ASSERT_ARE_EQUAL(char_ptr, "dev", receivedFeedbackRecordDeviceIds[1]);
+        ASSERT_ARE_EQUAL(int, IOTHUB_FEEDBACK_STATUS_CODE_REJECTED, receivedFeedbackRecordStatusCodes[1]);
 
-        //cleanup
+        ///cleanup
+        umock_c_reset_all_calls();
+        IoTHubMessaging_LL_Destroy(iothub_messaging_handle);
     }
 
-    TEST_FUNCTION(IoTHubMessaging_LL_SetTrustedCert_trusted_cert_NULL_fail)
+    /*Tests_SRS_IOTHUBMESSAGING_41_031: [ If the body is not a non-empty JSON array of objects, IoTHubMessaging_LL_FeedbackMessageReceived shall call no callback and return messaging_delivery_rejected. ]*/
+    TEST_FUNCTION(IoTHubMessaging_LL_FeedbackMessageReceived_rejects_malformed_feedback_records_without_calling_back)
+    {
+        const char* malformedBodies[] =
+        {
+            "",
+            "[]",
+            "{}",
+            "[1]",
+            "[{\"deviceId\":\"dev1\"},{\"deviceId\":}]",
+            "[{\"deviceId\":\"dev1\"},]",
+            "[{\"deviceId\":\"dev1\"}] trailing",
+            "[{\"deviceId\":\"\\q\"}]",
+            "[{\"deviceId\":\"\\ud800\"}]",
+            "[{\"deviceId\":\"unterminated"
+        };
+        size_t i;
+
+        //arrange
+        IOTHUB_MESSAGING_HANDLE iothub_messaging_handle = IoTHubMessaging_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+        (void)IoTHubMessaging_LL_Open(iothub_messaging_handle, TEST_FUNC_IOTHUB_OPEN_COMPLETE_CALLBACK, (void*)1);
+        (void)IoTHubMessaging_LL_SetFeedbackRecordCallback(iothub_messaging_handle, TEST_FUNC_IOTHUB_FEEDBACK_RECORD_RECEIVED_CALLBACK, TEST_VOID_PTR);
+
+        for (i = 0; i < sizeof(malformedBodies) / sizeof(malformedBodies[0]); i++)
+        {
+            feedbackMessageBody = malformedBodies[i];
+            umock_c_reset_all_calls();
+
+            STRICT_EXPECTED_CALL(message_get_body_amqp_data_in_place(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG))
+                .IgnoreAllArguments();
+            STRICT_EXPECTED_CALL(messaging_delivery_rejected(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+            //act
+            onMessageReceivedCallback(iothub_messaging_handle, TEST_MESSAGE_HANDLE);
+
+            //assert
+            ASSERT_ARE_EQUAL(size_t, 0, receivedFeedbackRecordCount, malformedBodies[i]);
+        }
+
+        ///cleanup
+        IoTHubMessaging_LL_Close(iothub_messaging_handle);
+        IoTHubMessaging_LL_Destroy(iothub_messaging_handle);
+    }
+
+    /*Tests_SRS_IOTHUBMESSAGING_41_032: [ If the message body cannot be read or the buffer cannot be allocated, IoTHubMessaging_LL_FeedbackMessageReceived shall return messaging_delivery_rejected. ]*/
+    TEST_FUNCTION(IoTHubMessaging_LL_FeedbackMessageReceived_rejects_the_feedback_records_if_the_buffer_allocation_fails)
     {
         //arrange
         IOTHUB_MESSAGING_HANDLE iothub_messaging_handle = IoTHubMessaging_LL_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+        (void)IoTHubMessaging_LL_Open(iothub_messaging_handle, TEST_FUNC_IOTHUB_OPEN_COMPLETE_CALLBACK, (void*)1);
+        (void)IoTHubMessaging_LL_SetFeedbackRecordCallback(iothub_messaging_handle, TEST_FUNC_IOTHUB_FEEDBACK_RECORD_RECEIVED_CALLBACK, TEST_VOID_PTR);
+        feedbackMessageBody = "[{\"deviceId\":\"dev\"}]";
         umock_c_reset_all_calls();
 
+        STRICT_EXPECTED_CALL(message_get_body_amqp_data_in_place(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .SetReturn(NULL);
+        STRICT_EXPECTED_CALL(messaging_delivery_rejected(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
         //act
-        IOTHUB_MESSAGING_RESULT result = IoTHubMessaging_LL_SetTrustedCert(iothub_messaging_handle, NULL);
+        onMessageReceivedCallback(iothub_messaging_handle, TEST_MESSAGE_HANDLE);
 
         //assert
-        ASSERT_ARE_NOT_EQUAL(int, IOTHUB_MESSAGING_OK, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, 0, receivedFeedbackRecordCount);
 
-        //cleanup
+        ///cleanup
+        IoTHubMessaging_LL_Close(iothub_messaging_handle);
         IoTHubMessaging_LL_Destroy(iothub_messaging_handle);
     }
 
@@ -19,10 +19,14 @@
 #include "azure_c_shared_utility/httpheaders.h"
 #include "azure_c_shared_utility/httpapiex.h"
 #include "azure_c_shared_utility/httpapiexsas.h"
+#include "internal/iothub_sc_http_pool.h"
 #include "azure_c_shared_utility/strings.h"
 #include "azure_c_shared_utility/singlylinkedlist.h"
 #include "parson.h"
 #include "azure_c_shared_utility/crt_abstractions.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/agenttime.h"
 
 MOCKABLE_FUNCTION(, JSON_Value*, json_parse_string, const char *, string);
 MOCKABLE_FUNCTION(, const char*, json_object_get_string, const JSON_Object *, object, const char *, name);
@@ -43,6 +47,9 @@ MOCKABLE_FUNCTION(, JSON_Status, json_object_clear, JSON_Object*, object);
 MOCKABLE_FUNCTION(, void, json_value_free, JSON_Value *, value);
 MOCKABLE_FUNCTION(, JSON_Status, json_object_dotset_boolean, JSON_Object*, object, const char *, name, int, boolean);
 MOCKABLE_FUNCTION(, int, json_object_dotget_boolean, const JSON_Object *, object, const char *, name);
+MOCKABLE_FUNCTION(, JSON_Value*, json_value_init_array);
+MOCKABLE_FUNCTION(, JSON_Status, json_array_append_value, JSON_Array*, array, JSON_Value*, value);
+MOCKABLE_FUNCTION(, JSON_Array*, json_object_get_array, const JSON_Object*, object, const char*, name);
 
 
 #undef ENABLE_MOCKS
@@ -127,6 +134,14 @@ static void my_gballoc_free(void* ptr)
     free(ptr);
 }
 
+/*runs the prefetch synchronously so that the expected calls keep a deterministic order*/
+static THREADAPI_RESULT my_ThreadAPI_Create(THREAD_HANDLE* threadHandle, THREAD_START_FUNC func, void* arg)
+{
+    *threadHandle = (THREAD_HANDLE)0x4747;
+    (void)func(arg);
+    return THREADAPI_OK;
+}
+
 static int my_mallocAndStrcpy_s(char** destination, const char* source)
 {
     char* p = (char*)malloc(2);
@@ -368,6 +383,11 @@ TEST_DEFINE_ENUM_TYPE(HTTP_HEADERS_RESULT, HTTP_HEADERS_RESULT_VALUES);
 IMPLEMENT_UMOCK_C_ENUM_TYPE(HTTP_HEADERS_RESULT, HTTP_HEADERS_RESULT_VALUES);
 TEST_DEFINE_ENUM_TYPE(HTTPAPI_REQUEST_TYPE, HTTPAPI_REQUEST_TYPE_VALUES);
 IMPLEMENT_UMOCK_C_ENUM_TYPE(HTTPAPI_REQUEST_TYPE, HTTPAPI_REQUEST_TYPE_VALUES);
+TEST_DEFINE_ENUM_TYPE(THREADAPI_RESULT, THREADAPI_RESULT_VALUES);
+IMPLEMENT_UMOCK_C_ENUM_TYPE(THREADAPI_RESULT, THREADAPI_RESULT_VALUES);
+
+TEST_DEFINE_ENUM_TYPE(LOCK_RESULT, LOCK_RESULT_VALUES);
+IMPLEMENT_UMOCK_C_ENUM_TYPE(LOCK_RESULT, LOCK_RESULT_VALUES);
 
 #ifdef _MSC_VER
 #pragma warning(disable:4505)
@@ -402,6 +422,10 @@ static char* TEST_SHAREDACCESSKEYNAME = "theSharedAccessKeyName";
 static IOTHUB_SERVICE_CLIENT_AUTH TEST_IOTHUB_SERVICE_CLIENT_AUTH;
 static IOTHUB_SERVICE_CLIENT_AUTH_HANDLE TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE = &TEST_IOTHUB_SERVICE_CLIENT_AUTH;
 
+static IOTHUB_SC_HTTP_POOL_HANDLE TEST_IOTHUB_SC_HTTP_POOL_HANDLE = (IOTHUB_SC_HTTP_POOL_HANDLE)0x4848;
+static LOCK_HANDLE TEST_LOCK_HANDLE = (LOCK_HANDLE)0x4949;
+static time_t TEST_TIME_VALUE = (time_t)100000;
+
 static IOTHUB_REGISTRYMANAGER TEST_IOTHUB_REGISTRYMANAGER;
 static IOTHUB_REGISTRYMANAGER_HANDLE TEST_IOTHUB_REGISTRYMANAGER_HANDLE = &TEST_IOTHUB_REGISTRYMANAGER;
 
@@ -493,6 +517,32 @@ static const char* TEST_HTTP_HEADER_KEY_CONTENT_TYPE = "Content-Type";
 static const char* TEST_HTTP_HEADER_VAL_CONTENT_TYPE = "application/json; charset=utf-8";
 static const char* TEST_HTTP_HEADER_KEY_IFMATCH = "If-Match";
 static const char* TEST_HTTP_HEADER_VAL_IFMATCH = "*";
+static const char* TEST_HTTP_HEADER_KEY_MAX_ITEM_COUNT = "x-ms-max-item-count";
+static const char* TEST_HTTP_HEADER_KEY_CONTINUATION = "x-ms-continuation";
+
+static const char* TEST_CONTINUATION_TOKEN = "theContinuationToken";
+static unsigned char TEST_DEVICE_QUERY_PAGE[] = "[]";
+
+static unsigned char TEST_BULK_CREATE_RESPONSE[] = "{}";
+static const char* TEST_BULK_ERROR_CODE_DEVICE_EXISTS = "DeviceAlreadyExists";
+
+#define TEST_BULK_DEVICE_COUNT 150
+static IOTHUB_REGISTRY_DEVICE_CREATE_EX TEST_BULK_DEVICES[TEST_BULK_DEVICE_COUNT];
+static IOTHUB_REGISTRYMANAGER_RESULT TEST_BULK_RESULTS[TEST_BULK_DEVICE_COUNT];
+
+static size_t enumeratedDeviceCount;
+static size_t stopEnumerationAfter;
+static IOTHUB_REGISTRYMANAGER_AUTH_METHOD enumeratedAuthMethod;
+
+static bool my_on_device_enumerated(void* context, const IOTHUB_DEVICE_EX* deviceInfo)
+{
+    ASSERT_ARE_EQUAL(void_ptr, (void*)0x4848, context);
+    ASSERT_ARE_EQUAL(int, IOTHUB_DEVICE_EX_VERSION_1, deviceInfo->version);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_DEVICE_ID, deviceInfo->deviceId);
+    enumeratedAuthMethod = deviceInfo->authMethod;
+    enumeratedDeviceCount++;
+    return enumeratedDeviceCount != stopEnumerationAfter;
+}
 
 DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
 
@@ -821,6 +871,290 @@ static void setupJsonParseDeviceMockCalls(bool fromDeviceList, IOTHUB_REGISTRYMA
         .IgnoreArgument(1);
 }
 
+static void setupDeviceQueryFetchMockCalls(bool hasContinuationToken, const char* nextContinuationToken, const unsigned int httpStatusCode)
+{
+    STRICT_EXPECTED_CALL(STRING_construct(TEST_HOSTNAME));
+    STRICT_EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEY));
+    STRICT_EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEYNAME));
+
+    STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_AUTHORIZATION, TEST_HTTP_HEADER_VAL_AUTHORIZATION))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_REQUEST_ID, TEST_HTTP_HEADER_VAL_REQUEST_ID))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_USER_AGENT, TEST_HTTP_HEADER_VAL_USER_AGENT))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_ACCEPT, TEST_HTTP_HEADER_VAL_ACCEPT))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_CONTENT_TYPE, TEST_HTTP_HEADER_VAL_CONTENT_TYPE))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_MAX_ITEM_COUNT, "10"))
+        .IgnoreArgument(1);
+    if (hasContinuationToken)
+    {
+        STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_CONTINUATION, IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .IgnoreArgument(3);
+    }
+    STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
+    STRICT_EXPECTED_CALL(BUFFER_create(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .IgnoreAllArguments();
+
+    STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Create(TEST_HOSTNAME));
+
+    STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(IGNORED_PTR_ARG, IGNORED_PTR_ARG, HTTPAPI_REQUEST_POST, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .IgnoreArgument(4)
+        .IgnoreArgument(5)
+        .IgnoreArgument(6)
+        .IgnoreArgument(7)
+        .IgnoreArgument(8)
+        .IgnoreArgument(9)
+        .CopyOutArgumentBuffer_statusCode(&httpStatusCode, sizeof(httpStatusCode))
+        .SetReturn(HTTPAPIEX_OK);
+
+    if (httpStatusCode <= 300)
+    {
+        STRICT_EXPECTED_CALL(HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_CONTINUATION))
+            .IgnoreArgument(1)
+            .SetReturn(nextContinuationToken);
+        if (hasContinuationToken)
+        {
+            STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+        }
+        if (nextContinuationToken != NULL)
+        {
+            STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, nextContinuationToken))
+                .IgnoreArgument(1);
+        }
+    }
+
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+}
+
+static void setupDeviceQueryDeliverMockCalls(size_t deviceCount, size_t parsedDeviceCount)
+{
+    STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetReturn(sizeof(TEST_DEVICE_QUERY_PAGE) - 1);
+    STRICT_EXPECTED_CALL(BUFFER_enlarge(IGNORED_PTR_ARG, 1))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetReturn(TEST_DEVICE_QUERY_PAGE);
+    STRICT_EXPECTED_CALL(json_parse_string((const char*)TEST_DEVICE_QUERY_PAGE));
+    STRICT_EXPECTED_CALL(json_value_get_array(TEST_JSON_VALUE));
+    STRICT_EXPECTED_CALL(json_array_get_count(TEST_JSON_ARRAY))
+        .SetReturn(deviceCount);
+
+    for (size_t i = 0; i < parsedDeviceCount; i++)
+    {
+        STRICT_EXPECTED_CALL(json_array_get_object(TEST_JSON_ARRAY, i));
+        STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, "authenticationType"))
+            .SetReturn(TEST_AUTH_TYPE_SELF_SIGNED);
+        STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_CONNECTIONSTATE));
+        STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_STATUS));
+        STRICT_EXPECTED_CALL(json_object_dotget_boolean(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_CAPABILITIES_IOTEDGE));
+        STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_NAME))
+            .SetReturn(TEST_DEVICE_ID);
+        STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, "deviceEtag"));
+        STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_STATUSREASON));
+        STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, "statusUpdateTime"));
+        STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_LASTACTIVITYTIME));
+        STRICT_EXPECTED_CALL(json_object_get_number(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_CLOUDTODEVICEMESSAGECOUNT));
+        STRICT_EXPECTED_CALL(json_object_dotget_string(TEST_JSON_OBJECT, "x509Thumbprint.primaryThumbprint"));
+        STRICT_EXPECTED_CALL(json_object_dotget_string(TEST_JSON_OBJECT, "x509Thumbprint.secondaryThumbprint"));
+    }
+
+    STRICT_EXPECTED_CALL(json_value_free(TEST_JSON_VALUE));
+}
+
+static void setupBulkCreateBatchMockCalls(size_t batchDeviceCount, const unsigned int httpStatusCode, const char* errorCode)
+{
+    STRICT_EXPECTED_CALL(json_value_init_array());
+    STRICT_EXPECTED_CALL(json_value_get_array(TEST_JSON_VALUE));
+    for (size_t i = 0; i < batchDeviceCount; i++)
+    {
+        STRICT_EXPECTED_CALL(json_value_init_object());
+        STRICT_EXPECTED_CALL(json_value_get_object(TEST_JSON_VALUE));
+        STRICT_EXPECTED_CALL(json_object_set_string(TEST_JSON_OBJECT, "id", TEST_DEVICE_ID));
+        STRICT_EXPECTED_CALL(json_object_set_string(TEST_JSON_OBJECT, "importMode", "create"));
+        STRICT_EXPECTED_CALL(json_object_set_string(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_STATUS, TEST_DEVICE_JSON_DEFAULT_VALUE_ENABLED));
+        STRICT_EXPECTED_CALL(json_object_dotset_string(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_AUTH_TYPE, TEST_AUTH_TYPE_SAS));
+        STRICT_EXPECTED_CALL(json_object_dotset_string(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_PRIMARY_KEY, TEST_PRIMARYKEY));
+        STRICT_EXPECTED_CALL(json_object_dotset_string(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_SECONDARY_KEY, TEST_SECONDARYKEY));
+        STRICT_EXPECTED_CALL(json_object_dotset_boolean(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_CAPABILITIES_IOTEDGE, false));
+        STRICT_EXPECTED_CALL(json_array_append_value(TEST_JSON_ARRAY, TEST_JSON_VALUE));
+    }
+    STRICT_EXPECTED_CALL(json_serialize_to_string(TEST_JSON_VALUE))
+        .SetReturn(TEST_CHAR_PTR);
+    STRICT_EXPECTED_CALL(BUFFER_create(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(json_free_serialized_string(TEST_CHAR_PTR));
+    STRICT_EXPECTED_CALL(json_value_free(TEST_JSON_VALUE));
+
+    STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(IGNORED_PTR_ARG, IGNORED_PTR_ARG, HTTPAPI_REQUEST_POST, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .IgnoreArgument(4)
+        .IgnoreArgument(5)
+        .IgnoreArgument(6)
+        .IgnoreArgument(7)
+        .IgnoreArgument(9)
+        .CopyOutArgumentBuffer_statusCode(&httpStatusCode, sizeof(httpStatusCode))
+        .SetReturn(HTTPAPIEX_OK);
+
+    STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetReturn(sizeof(TEST_BULK_CREATE_RESPONSE) - 1);
+    STRICT_EXPECTED_CALL(BUFFER_enlarge(IGNORED_PTR_ARG, 1))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetReturn(TEST_BULK_CREATE_RESPONSE);
+    STRICT_EXPECTED_CALL(json_parse_string((const char*)TEST_BULK_CREATE_RESPONSE));
+    STRICT_EXPECTED_CALL(json_value_get_object(TEST_JSON_VALUE));
+    if (errorCode == NULL)
+    {
+        STRICT_EXPECTED_CALL(json_object_get_array(TEST_JSON_OBJECT, "errors"))
+            .SetReturn(NULL);
+    }
+    else
+    {
+        STRICT_EXPECTED_CALL(json_object_get_array(TEST_JSON_OBJECT, "errors"));
+        STRICT_EXPECTED_CALL(json_array_get_count(TEST_JSON_ARRAY))
+            .SetReturn(1);
+        STRICT_EXPECTED_CALL(json_array_get_object(TEST_JSON_ARRAY, 0));
+        STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DEVICE_NAME))
+            .SetReturn(TEST_DEVICE_ID);
+        STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, "errorCode"))
+            .SetReturn(errorCode);
+    }
+    STRICT_EXPECTED_CALL(json_value_free(TEST_JSON_VALUE));
+
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+}
+
+static void setupBulkCreateWorkerMockCalls(size_t batchCount, size_t batchDeviceCount, const unsigned int httpStatusCode, const char* errorCode)
+{
+    STRICT_EXPECTED_CALL(STRING_construct(TEST_HOSTNAME));
+    STRICT_EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEY));
+    STRICT_EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSKEYNAME));
+
+    STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_AUTHORIZATION, TEST_HTTP_HEADER_VAL_AUTHORIZATION))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_REQUEST_ID, TEST_HTTP_HEADER_VAL_REQUEST_ID))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_USER_AGENT, TEST_HTTP_HEADER_VAL_USER_AGENT))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_ACCEPT, TEST_HTTP_HEADER_VAL_ACCEPT))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, TEST_HTTP_HEADER_KEY_CONTENT_TYPE, TEST_HTTP_HEADER_VAL_CONTENT_TYPE))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(BUFFER_new());
+
+    STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Create(TEST_HOSTNAME));
+
+    for (size_t i = 0; i < batchCount; i++)
+    {
+        setupBulkCreateBatchMockCalls(batchDeviceCount, httpStatusCode, errorCode);
+    }
+
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+}
+
+static char* copy_test_string(const char* source)
+{
+    char* result = (char*)malloc(strlen(source) + 1);
+    (void)strcpy(result, source);
+    return result;
+}
+
+/*a heap allocated handle, since IoTHubRegistryManager_Destroy is needed to release the cache and the asynchronous fetches*/
+static IOTHUB_REGISTRYMANAGER_HANDLE create_test_registry_manager(unsigned int cacheTimeToLiveInSeconds)
+{
+    IOTHUB_REGISTRYMANAGER* result = (IOTHUB_REGISTRYMANAGER*)malloc(sizeof(IOTHUB_REGISTRYMANAGER));
+    memset(result, 0, sizeof(*result));
+    result->hostname = copy_test_string(TEST_HOSTNAME);
+    result->iothubName = copy_test_string(TEST_IOTHUBNAME);
+    result->iothubSuffix = copy_test_string(TEST_IOTHUBSUFFIX);
+    result->sharedAccessKey = copy_test_string(TEST_SHAREDACCESSKEY);
+    result->keyName = copy_test_string(TEST_SHAREDACCESSKEYNAME);
+    (void)IoTHubRegistryManager_SetCache(result, cacheTimeToLiveInSeconds, 10);
+    umock_c_reset_all_calls();
+    return result;
+}
+
+static void setupJsonParseStatisticsMockCalls(void)
+{
+    STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetReturn(TEST_UNSIGNED_CHAR_PTR);
+
+    STRICT_EXPECTED_CALL(json_parse_string(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetReturn(TEST_JSON_VALUE);
+
+    STRICT_EXPECTED_CALL(json_value_get_object(TEST_JSON_VALUE))
+        .SetReturn(TEST_JSON_OBJECT);
+
+    STRICT_EXPECTED_CALL(json_object_get_number(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_TOTAL_DEVICECOUNT));
+    STRICT_EXPECTED_CALL(json_object_get_number(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_ENABLED_DEVICECCOUNT));
+    STRICT_EXPECTED_CALL(json_object_get_number(TEST_JSON_OBJECT, TEST_DEVICE_JSON_KEY_DISABLED_DEVICECOUNT));
+
+    STRICT_EXPECTED_CALL(json_object_clear(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(json_value_free(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+}
+
+static size_t g_statistics_callback_count;
+static IOTHUB_REGISTRYMANAGER_RESULT g_statistics_callback_result;
+static bool g_statistics_callback_had_statistics;
+
+static void test_get_statistics_callback(void* context, IOTHUB_REGISTRYMANAGER_RESULT result, const IOTHUB_REGISTRY_STATISTICS* registryStatistics)
+{
+    (void)context;
+    g_statistics_callback_count++;
+    g_statistics_callback_result = result;
+    g_statistics_callback_had_statistics = (registryStatistics != NULL);
+}
+
 BEGIN_TEST_SUITE(iothub_registrymanager_ut)
 
     TEST_SUITE_INITIALIZE(TestClassInitialize)
@@ -846,12 +1180,32 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
         REGISTER_UMOCK_ALIAS_TYPE(HTTP_HANDLE, void*);
         REGISTER_UMOCK_ALIAS_TYPE(HTTPAPIEX_HANDLE, void*);
         REGISTER_UMOCK_ALIAS_TYPE(HTTPAPIEX_SAS_HANDLE, void*);
+        REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_SC_HTTP_POOL_HANDLE, void*);
 
         REGISTER_UMOCK_ALIAS_TYPE(JSON_Value, void*);
         REGISTER_UMOCK_ALIAS_TYPE(JSON_Object, void*);
         REGISTER_UMOCK_ALIAS_TYPE(JSON_Status, int);
         REGISTER_UMOCK_ALIAS_TYPE(SINGLYLINKEDLIST_HANDLE, void*);
         REGISTER_UMOCK_ALIAS_TYPE(LIST_ITEM_HANDLE, void*);
+        REGISTER_UMOCK_ALIAS_TYPE(THREAD_HANDLE, void*);
+        REGISTER_UMOCK_ALIAS_TYPE(THREAD_START_FUNC, void*);
+        REGISTER_TYPE(THREADAPI_RESULT, THREADAPI_RESULT);
+        REGISTER_TYPE(LOCK_RESULT, LOCK_RESULT);
+        REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+        REGISTER_UMOCK_ALIAS_TYPE(time_t, long);
+
+        REGISTER_GLOBAL_MOCK_RETURN(Lock_Init, TEST_LOCK_HANDLE);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock_Init, NULL);
+        REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock, LOCK_ERROR);
+        REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+        REGISTER_GLOBAL_MOCK_RETURN(Lock_Deinit, LOCK_OK);
+        REGISTER_GLOBAL_MOCK_RETURN(get_time, TEST_TIME_VALUE);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(get_time, (time_t)(-1));
+
+        REGISTER_GLOBAL_MOCK_HOOK(ThreadAPI_Create, my_ThreadAPI_Create);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(ThreadAPI_Create, THREADAPI_ERROR);
+        REGISTER_GLOBAL_MOCK_RETURN(ThreadAPI_Join, THREADAPI_OK);
 
         REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
         REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
@@ -873,6 +1227,7 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
         REGISTER_GLOBAL_MOCK_FAIL_RETURN(BUFFER_create, NULL);
 
         REGISTER_GLOBAL_MOCK_HOOK(BUFFER_delete, my_BUFFER_delete);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(BUFFER_enlarge, __FAILURE__);
 
         REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_create, my_list_create);
         REGISTER_GLOBAL_MOCK_FAIL_RETURN(singlylinkedlist_create, NULL);
@@ -916,6 +1271,11 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
         REGISTER_GLOBAL_MOCK_RETURN(HTTPAPIEX_SAS_ExecuteRequest, HTTPAPIEX_OK);
         REGISTER_GLOBAL_MOCK_FAIL_RETURN(HTTPAPIEX_SAS_ExecuteRequest, HTTPAPIEX_ERROR);
 
+        REGISTER_GLOBAL_MOCK_RETURN(IoTHubSCHttpPool_Clone, TEST_IOTHUB_SC_HTTP_POOL_HANDLE);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubSCHttpPool_Clone, NULL);
+        REGISTER_GLOBAL_MOCK_RETURN(IoTHubSCHttpPool_ExecuteRequest, HTTPAPIEX_OK);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubSCHttpPool_ExecuteRequest, HTTPAPIEX_ERROR);
+
         REGISTER_GLOBAL_MOCK_RETURN(json_value_init_object, TEST_JSON_VALUE);
         REGISTER_GLOBAL_MOCK_FAIL_RETURN(json_value_init_object, NULL);
 
@@ -963,6 +1323,15 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
 
         REGISTER_GLOBAL_MOCK_RETURN(json_object_dotget_boolean, JSONSuccess);
         REGISTER_GLOBAL_MOCK_FAIL_RETURN(json_object_dotget_boolean, -1);
+
+        REGISTER_GLOBAL_MOCK_RETURN(json_value_init_array, TEST_JSON_VALUE);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(json_value_init_array, NULL);
+
+        REGISTER_GLOBAL_MOCK_RETURN(json_array_append_value, JSONSuccess);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(json_array_append_value, JSONFailure);
+
+        REGISTER_GLOBAL_MOCK_RETURN(json_object_get_array, TEST_JSON_ARRAY);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(json_object_get_array, NULL);
     }
 
     TEST_SUITE_CLEANUP(TestClassCleanup)
@@ -980,17 +1349,36 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
 
         umock_c_reset_all_calls();
 
+        enumeratedDeviceCount = 0;
+        stopEnumerationAfter = 0;
+        enumeratedAuthMethod = IOTHUB_REGISTRYMANAGER_AUTH_UNKNOWN;
+
+        for (size_t i = 0; i < TEST_BULK_DEVICE_COUNT; i++)
+        {
+            TEST_BULK_DEVICES[i].version = IOTHUB_REGISTRY_DEVICE_CREATE_EX_VERSION_1;
+            TEST_BULK_DEVICES[i].deviceId = TEST_DEVICE_ID;
+            TEST_BULK_DEVICES[i].primaryKey = TEST_PRIMARYKEY;
+            TEST_BULK_DEVICES[i].secondaryKey = TEST_SECONDARYKEY;
+            TEST_BULK_DEVICES[i].authMethod = IOTHUB_REGISTRYMANAGER_AUTH_SPK;
+            TEST_BULK_DEVICES[i].iotEdge_capable = false;
+            TEST_BULK_RESULTS[i] = IOTHUB_REGISTRYMANAGER_ERROR;
+        }
+
         TEST_IOTHUB_SERVICE_CLIENT_AUTH.hostname = TEST_HOSTNAME;
         TEST_IOTHUB_SERVICE_CLIENT_AUTH.iothubName = TEST_IOTHUBNAME;
         TEST_IOTHUB_SERVICE_CLIENT_AUTH.iothubSuffix = TEST_IOTHUBSUFFIX;
         TEST_IOTHUB_SERVICE_CLIENT_AUTH.keyName = TEST_SHAREDACCESSKEYNAME;
         TEST_IOTHUB_SERVICE_CLIENT_AUTH.sharedAccessKey = TEST_SHAREDACCESSKEY;
+        TEST_IOTHUB_SERVICE_CLIENT_AUTH.httpPool = NULL;
 
         TEST_IOTHUB_REGISTRYMANAGER.hostname = TEST_HOSTNAME;
         TEST_IOTHUB_REGISTRYMANAGER.iothubName = TEST_IOTHUBNAME;
         TEST_IOTHUB_REGISTRYMANAGER.iothubSuffix = TEST_IOTHUBSUFFIX;
         TEST_IOTHUB_REGISTRYMANAGER.keyName = TEST_SHAREDACCESSKEYNAME;
         TEST_IOTHUB_REGISTRYMANAGER.sharedAccessKey = TEST_SHAREDACCESSKEY;
+        TEST_IOTHUB_REGISTRYMANAGER.httpPool = NULL;
+        TEST_IOTHUB_REGISTRYMANAGER.cache = NULL;
+        TEST_IOTHUB_REGISTRYMANAGER.async = NULL;
 
         TEST_IOTHUB_REGISTRY_DEVICE_CREATE.deviceId = TEST_DEVICE_ID;
         TEST_IOTHUB_REGISTRY_DEVICE_CREATE.primaryKey = TEST_PRIMARYKEY;
@@ -1281,51 +1669,167 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
     }
 
-    /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_007: [ IoTHubRegistryManager_CreateDevice shall verify the input parameters and if any of them are NULL then return IOTHUB_REGISTRYMANAGER_INVALID_ARG ]*/
-    TEST_FUNCTION(IoTHubRegistryManager_CreateModule_return_IOTHUB_REGISTRYMANAGER_INVALID_ARG_if_input_parameter_registryManagerHandle_is_NULL)
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_030: [ If serviceClientHandle has an HTTP connection pool, IoTHubRegistryManager_Create shall share it by calling IoTHubSCHttpPool_Clone ] */
+    TEST_FUNCTION(IoTHubRegistryManager_Create_shares_the_http_pool_of_the_service_client)
     {
         // arrange
+        TEST_IOTHUB_SERVICE_CLIENT_AUTH.httpPool = TEST_IOTHUB_SC_HTTP_POOL_HANDLE;
 
-        // act
-        IOTHUB_MODULE moduleInfo;
-        (void)memset(&moduleInfo, 0, sizeof(IOTHUB_MODULE));
-        moduleInfo.version = IOTHUB_MODULE_VERSION_1;
-        IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_CreateModule(NULL, &TEST_IOTHUB_REGISTRY_MODULE_CREATE, &moduleInfo);
-
-        // assert
-        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_INVALID_ARG, result);
-        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
-    }
-
-    /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_007: [ IoTHubRegistryManager_CreateDevice shall verify the input parameters and if any of them are NULL then return IOTHUB_REGISTRYMANAGER_INVALID_ARG ]*/
-    TEST_FUNCTION(IoTHubRegistryManager_CreateModule_return_IOTHUB_REGISTRYMANAGER_INVALID_ARG_if_input_parameter_moduleCreateInfo_is_NULL)
-    {
-        // arrange
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+        STRICT_EXPECTED_CALL(IoTHubSCHttpPool_Clone(TEST_IOTHUB_SC_HTTP_POOL_HANDLE));
 
         // act
-        IOTHUB_MODULE moduleInfo;
-        (void)memset(&moduleInfo, 0, sizeof(IOTHUB_MODULE));
-        moduleInfo.version = IOTHUB_MODULE_VERSION_1;
-        IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_CreateModule(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, NULL, &moduleInfo);
+        IOTHUB_REGISTRYMANAGER_HANDLE result = IoTHubRegistryManager_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
 
         // assert
-        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_INVALID_ARG, result);
+        ASSERT_IS_NOT_NULL(result);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(void_ptr, TEST_IOTHUB_SC_HTTP_POOL_HANDLE, result->httpPool);
+
+        ///cleanup
+        if (result != NULL)
+        {
+            free(result->hostname);
+            free(result->iothubName);
+            free(result->iothubSuffix);
+            free(result->keyName);
+            free(result->sharedAccessKey);
+            free(result);
+        }
     }
 
-    /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_007: [ IoTHubRegistryManager_CreateDevice shall verify the input parameters and if any of them are NULL then return IOTHUB_REGISTRYMANAGER_INVALID_ARG ]*/
-    TEST_FUNCTION(IoTHubRegistryManager_CreateModule_return_IOTHUB_REGISTRYMANAGER_INVALID_ARG_if_input_parameter_module_is_NULL)
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_031: [ If the IoTHubSCHttpPool_Clone fails, IoTHubRegistryManager_Create shall do clean up and return NULL. ] */
+    TEST_FUNCTION(IoTHubRegistryManager_Create_returns_NULL_if_IoTHubSCHttpPool_Clone_fails)
     {
         // arrange
+        TEST_IOTHUB_SERVICE_CLIENT_AUTH.httpPool = TEST_IOTHUB_SC_HTTP_POOL_HANDLE;
+
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+        STRICT_EXPECTED_CALL(IoTHubSCHttpPool_Clone(TEST_IOTHUB_SC_HTTP_POOL_HANDLE))
+            .SetReturn(NULL);
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        // act
+        IOTHUB_REGISTRYMANAGER_HANDLE result = IoTHubRegistryManager_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+
+        // assert
+        ASSERT_IS_NULL(result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_033: [ IoTHubRegistryManager_Destroy shall release its reference to the HTTP connection pool by calling IoTHubSCHttpPool_Destroy ] */
+    TEST_FUNCTION(IoTHubRegistryManager_Destroy_releases_the_http_pool)
+    {
+        // arrange
+        TEST_IOTHUB_SERVICE_CLIENT_AUTH.httpPool = TEST_IOTHUB_SC_HTTP_POOL_HANDLE;
+        IOTHUB_REGISTRYMANAGER_HANDLE handle = IoTHubRegistryManager_Create(TEST_IOTHUB_SERVICE_CLIENT_AUTH_HANDLE);
+        ASSERT_IS_NOT_NULL(handle);
+
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(IoTHubSCHttpPool_Destroy(TEST_IOTHUB_SC_HTTP_POOL_HANDLE));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        // act
+        IoTHubRegistryManager_Destroy(handle);
+
+        // assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_007: [ IoTHubRegistryManager_CreateDevice shall verify the input parameters and if any of them are NULL then return IOTHUB_REGISTRYMANAGER_INVALID_ARG ]*/
+    TEST_FUNCTION(IoTHubRegistryManager_CreateModule_return_IOTHUB_REGISTRYMANAGER_INVALID_ARG_if_input_parameter_registryManagerHandle_is_NULL)
+    {
+        // arrange
+
+        // act
+        IOTHUB_MODULE moduleInfo;
+        (void)memset(&moduleInfo, 0, sizeof(IOTHUB_MODULE));
+        moduleInfo.version = IOTHUB_MODULE_VERSION_1;
+        IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_CreateModule(NULL, &TEST_IOTHUB_REGISTRY_MODULE_CREATE, &moduleInfo);
+
+        // assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_007: [ IoTHubRegistryManager_CreateDevice shall verify the input parameters and if any of them are NULL then return IOTHUB_REGISTRYMANAGER_INVALID_ARG ]*/
+    TEST_FUNCTION(IoTHubRegistryManager_CreateModule_return_IOTHUB_REGISTRYMANAGER_INVALID_ARG_if_input_parameter_moduleCreateInfo_is_NULL)
+    {
+        // arrange
+
+        // act
+        IOTHUB_MODULE moduleInfo;
+        (void)memset(&moduleInfo, 0, sizeof(IOTHUB_MODULE));
+        moduleInfo.version = IOTHUB_MODULE_VERSION_1;
+        IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_CreateModule(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, NULL, &moduleInfo);
+
+        // assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_007: [ IoTHubRegistryManager_CreateDevice shall verify the input parameters and if any of them are NULL then return IOTHUB_REGISTRYMANAGER_INVALID_ARG ]*/
+    TEST_FUNCTION(IoTHubRegistryManager_CreateModule_return_IOTHUB_REGISTRYMANAGER_INVALID_ARG_if_input_parameter_module_is_NULL)
+    {
+        // arrange
+
+        // act
+        IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_CreateModule(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, &TEST_IOTHUB_REGISTRY_MODULE_CREATE, NULL);
+
+        // assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
 
-        // act
-        IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_CreateModule(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, &TEST_IOTHUB_REGISTRY_MODULE_CREATE, NULL);
-
-        // assert
-        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_INVALID_ARG, result);
-        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
-    }
-
     /* Tests_SRS_IOTHUBREGISTRYMANAGER_12_008: [ IoTHubRegistryManager_CreateDevice shall verify the deviceCreateInfo->deviceId input parameter and if it is NULL then return IOTHUB_REGISTRYMANAGER_INVALID_ARG ]*/
     TEST_FUNCTION(IoTHubRegistryManager_CreateModule_return_IOTHUB_REGISTRYMANAGER_INVALID_ARG_if_input_parameter_deviceCreateInfo_moduleId_is_NULL)
     {
@@ -4233,4 +4737,586 @@ BEGIN_TEST_SUITE(iothub_registrymanager_ut)
         umock_c_negative_tests_deinit();
     }
 
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_001: [ If registryManagerHandle or deviceCallback is NULL IoTHubRegistryManager_EnumerateDevices shall return IOTHUB_REGISTRYMANAGER_INVALID_ARG ] */
+    TEST_FUNCTION(IoTHubRegistryManager_EnumerateDevices_return_IOTHUB_REGISTRYMANAGER_INVALID_ARG_if_input_parameter_registryManagerHandle_is_NULL)
+    {
+        ///act
+        IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_EnumerateDevices(NULL, 10, my_on_device_enumerated, (void*)0x4848);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_001: [ If registryManagerHandle or deviceCallback is NULL IoTHubRegistryManager_EnumerateDevices shall return IOTHUB_REGISTRYMANAGER_INVALID_ARG ] */
+    TEST_FUNCTION(IoTHubRegistryManager_EnumerateDevices_return_IOTHUB_REGISTRYMANAGER_INVALID_ARG_if_input_parameter_deviceCallback_is_NULL)
+    {
+        ///act
+        IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_EnumerateDevices(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, 10, NULL, (void*)0x4848);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_002: [ If pageSize is not between 1 and 1000 IoTHubRegistryManager_EnumerateDevices shall return IOTHUB_REGISTRYMANAGER_INVALID_ARG ] */
+    TEST_FUNCTION(IoTHubRegistryManager_EnumerateDevices_return_IOTHUB_REGISTRYMANAGER_INVALID_ARG_if_pageSize_is_out_of_range)
+    {
+        ///act
+        IOTHUB_REGISTRYMANAGER_RESULT result1 = IoTHubRegistryManager_EnumerateDevices(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, 0, my_on_device_enumerated, (void*)0x4848);
+        IOTHUB_REGISTRYMANAGER_RESULT result2 = IoTHubRegistryManager_EnumerateDevices(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, 1001, my_on_device_enumerated, (void*)0x4848);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_INVALID_ARG, result1);
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_INVALID_ARG, result2);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_003: [ IoTHubRegistryManager_EnumerateDevices shall allocate two response buffers by calling BUFFER_new, which are reused for every page ] */
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_004: [ IoTHubRegistryManager_EnumerateDevices shall request every page with an HTTP POST of the query SELECT * FROM devices to url/devices/query?api-version, adding the x-ms-max-item-count header set to pageSize to the headers used by IoTHubRegistryManager_GetDeviceList ] */
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_006: [ The enumeration shall end after the first page that comes back without a non-empty x-ms-continuation header ] */
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_007: [ IoTHubRegistryManager_EnumerateDevices shall call deviceCallback once per device of the page with the same IOTHUB_DEVICE_EX structure, kept on its stack, instead of allocating one per device ] */
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_015: [ IoTHubRegistryManager_EnumerateDevices shall free the response buffers and the continuation token before returning ] */
+    TEST_FUNCTION(IoTHubRegistryManager_EnumerateDevices_single_page_happy_path)
+    {
+        ///arrange
+        STRICT_EXPECTED_CALL(BUFFER_new());
+        STRICT_EXPECTED_CALL(BUFFER_new());
+        setupDeviceQueryFetchMockCalls(false, NULL, httpStatusCodeOk);
+        setupDeviceQueryDeliverMockCalls(2, 2);
+        STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_EnumerateDevices(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, 10, my_on_device_enumerated, (void*)0x4848);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_OK, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, 2, enumeratedDeviceCount);
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_AUTH_X509_THUMBPRINT, enumeratedAuthMethod);
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_005: [ Every page after the first one shall be requested with the x-ms-continuation header set to the continuation token returned with the previous page ] */
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_013: [ While the devices of a page are handed to deviceCallback IoTHubRegistryManager_EnumerateDevices shall fetch the next page into the other buffer on a thread created by calling ThreadAPI_Create ] */
+    TEST_FUNCTION(IoTHubRegistryManager_EnumerateDevices_prefetches_the_next_page)
+    {
+        ///arrange
+        STRICT_EXPECTED_CALL(BUFFER_new());
+        STRICT_EXPECTED_CALL(BUFFER_new());
+        setupDeviceQueryFetchMockCalls(false, TEST_CONTINUATION_TOKEN, httpStatusCodeOk);
+        STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+        setupDeviceQueryFetchMockCalls(true, NULL, httpStatusCodeOk);
+        setupDeviceQueryDeliverMockCalls(1, 1);
+        STRICT_EXPECTED_CALL(ThreadAPI_Join((THREAD_HANDLE)0x4747, IGNORED_PTR_ARG))
+            .IgnoreArgument(2);
+        setupDeviceQueryDeliverMockCalls(1, 1);
+        STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_EnumerateDevices(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, 10, my_on_device_enumerated, (void*)0x4848);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_OK, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, 2, enumeratedDeviceCount);
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_014: [ If ThreadAPI_Create fails the next page shall be fetched after the current one has been handed out ] */
+    TEST_FUNCTION(IoTHubRegistryManager_EnumerateDevices_fetches_the_next_page_inline_if_ThreadAPI_Create_fails)
+    {
+        ///arrange
+        STRICT_EXPECTED_CALL(BUFFER_new());
+        STRICT_EXPECTED_CALL(BUFFER_new());
+        setupDeviceQueryFetchMockCalls(false, TEST_CONTINUATION_TOKEN, httpStatusCodeOk);
+        STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments()
+            .SetReturn(THREADAPI_ERROR);
+        setupDeviceQueryDeliverMockCalls(1, 1);
+        setupDeviceQueryFetchMockCalls(true, NULL, httpStatusCodeOk);
+        setupDeviceQueryDeliverMockCalls(1, 1);
+        STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_EnumerateDevices(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, 10, my_on_device_enumerated, (void*)0x4848);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_OK, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, 2, enumeratedDeviceCount);
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_009: [ If deviceCallback returns false IoTHubRegistryManager_EnumerateDevices shall not call it again, shall not request any further page and shall return IOTHUB_REGISTRYMANAGER_OK ] */
+    TEST_FUNCTION(IoTHubRegistryManager_EnumerateDevices_stops_when_the_callback_returns_false)
+    {
+        ///arrange
+        stopEnumerationAfter = 1;
+
+        STRICT_EXPECTED_CALL(BUFFER_new());
+        STRICT_EXPECTED_CALL(BUFFER_new());
+        setupDeviceQueryFetchMockCalls(false, TEST_CONTINUATION_TOKEN, httpStatusCodeOk);
+        STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments()
+            .SetReturn(THREADAPI_ERROR);
+        setupDeviceQueryDeliverMockCalls(3, 1);
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_EnumerateDevices(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, 10, my_on_device_enumerated, (void*)0x4848);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_OK, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, 1, enumeratedDeviceCount);
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_011: [ If the received HTTP status code is greater than 300 IoTHubRegistryManager_EnumerateDevices shall stop and return IOTHUB_REGISTRYMANAGER_HTTP_STATUS_ERROR ] */
+    TEST_FUNCTION(IoTHubRegistryManager_EnumerateDevices_return_IOTHUB_REGISTRYMANAGER_HTTP_STATUS_ERROR_on_http_failure)
+    {
+        ///arrange
+        STRICT_EXPECTED_CALL(BUFFER_new());
+        STRICT_EXPECTED_CALL(BUFFER_new());
+        setupDeviceQueryFetchMockCalls(false, NULL, httpStatusCodeBadRequest);
+        STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_EnumerateDevices(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, 10, my_on_device_enumerated, (void*)0x4848);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_HTTP_STATUS_ERROR, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, 0, enumeratedDeviceCount);
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_010: [ If any of the HTTPAPI calls fails IoTHubRegistryManager_EnumerateDevices shall stop and return IOTHUB_REGISTRYMANAGER_HTTPAPI_ERROR ] */
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_012: [ If a page is not a JSON array of objects IoTHubRegistryManager_EnumerateDevices shall stop and return IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
+    TEST_FUNCTION(IoTHubRegistryManager_EnumerateDevices_non_happy_path)
+    {
+        ///arrange
+        int umockc_result = umock_c_negative_tests_init();
+        ASSERT_ARE_EQUAL(int, 0, umockc_result);
+
+        STRICT_EXPECTED_CALL(BUFFER_new());
+        STRICT_EXPECTED_CALL(BUFFER_new());
+        setupDeviceQueryFetchMockCalls(false, NULL, httpStatusCodeOk);
+        setupDeviceQueryDeliverMockCalls(1, 1);
+        STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        umock_c_negative_tests_snapshot();
+
+        size_t negative_call_count = umock_c_negative_tests_call_count();
+        for (size_t i = 0; i < negative_call_count; i++)
+        {
+            /// arrange
+            umock_c_negative_tests_reset();
+            umock_c_negative_tests_fail_call(i);
+            enumeratedDeviceCount = 0;
+
+            /// act
+            if (
+                (i != 17) && /*HTTPHeaders_FindHeaderValue*/
+                (i != 18) && /*HTTPAPIEX_Destroy*/
+                (i != 19) && /*HTTPAPIEX_SAS_Destroy*/
+                (i != 20) && /*BUFFER_delete*/
+                (i != 21) && /*HTTPHeaders_Free*/
+                (i != 22) && /*HTTPHeaders_Free*/
+                (i != 23) && /*STRING_delete*/
+                (i != 24) && /*STRING_delete*/
+                (i != 25) && /*STRING_delete*/
+                (i != 26) && /*BUFFER_length*/
+                (i != 31) && /*json_array_get_count*/
+                ((i < 33) || (i > 44)) && /*device members*/
+                (i != 45) && /*json_value_free*/
+                (i != 46) && /*BUFFER_delete*/
+                (i != 47) /*BUFFER_delete*/
+                )
+            {
+                IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_EnumerateDevices(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, 10, my_on_device_enumerated, (void*)0x4848);
+                char message_on_error[64];
+                sprintf(message_on_error, "Got unexpected IOTHUB_REGISTRYMANAGER_OK on run %lu", (unsigned long)i);
+
+                /// assert
+                ASSERT_ARE_NOT_EQUAL(int, IOTHUB_REGISTRYMANAGER_OK, result, message_on_error);
+            }
+        }
+        umock_c_negative_tests_deinit();
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_016: [ If registryManagerHandle, deviceCreateInfo or deviceResults is NULL or deviceCount is 0 IoTHubRegistryManager_BulkCreateDevices shall return IOTHUB_REGISTRYMANAGER_INVALID_ARG ] */
+    TEST_FUNCTION(IoTHubRegistryManager_BulkCreateDevices_return_IOTHUB_REGISTRYMANAGER_INVALID_ARG_if_input_parameter_registryManagerHandle_is_NULL)
+    {
+        // arrange
+
+        // act
+        IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_BulkCreateDevices(NULL, TEST_BULK_DEVICES, 1, TEST_BULK_RESULTS);
+
+        // assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_INVALID_ARG, result);
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_016: [ If registryManagerHandle, deviceCreateInfo or deviceResults is NULL or deviceCount is 0 IoTHubRegistryManager_BulkCreateDevices shall return IOTHUB_REGISTRYMANAGER_INVALID_ARG ] */
+    TEST_FUNCTION(IoTHubRegistryManager_BulkCreateDevices_return_IOTHUB_REGISTRYMANAGER_INVALID_ARG_if_input_parameter_deviceCreateInfo_is_NULL)
+    {
+        // arrange
+
+        // act
+        IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_BulkCreateDevices(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, NULL, 1, TEST_BULK_RESULTS);
+
+        // assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_INVALID_ARG, result);
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_016: [ If registryManagerHandle, deviceCreateInfo or deviceResults is NULL or deviceCount is 0 IoTHubRegistryManager_BulkCreateDevices shall return IOTHUB_REGISTRYMANAGER_INVALID_ARG ] */
+    TEST_FUNCTION(IoTHubRegistryManager_BulkCreateDevices_return_IOTHUB_REGISTRYMANAGER_INVALID_ARG_if_input_parameter_deviceResults_is_NULL)
+    {
+        // arrange
+
+        // act
+        IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_BulkCreateDevices(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, TEST_BULK_DEVICES, 1, NULL);
+
+        // assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_INVALID_ARG, result);
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_016: [ If registryManagerHandle, deviceCreateInfo or deviceResults is NULL or deviceCount is 0 IoTHubRegistryManager_BulkCreateDevices shall return IOTHUB_REGISTRYMANAGER_INVALID_ARG ] */
+    TEST_FUNCTION(IoTHubRegistryManager_BulkCreateDevices_return_IOTHUB_REGISTRYMANAGER_INVALID_ARG_if_deviceCount_is_0)
+    {
+        // arrange
+
+        // act
+        IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_BulkCreateDevices(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, TEST_BULK_DEVICES, 0, TEST_BULK_RESULTS);
+
+        // assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_INVALID_ARG, result);
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_017: [ IoTHubRegistryManager_BulkCreateDevices shall validate every device like IoTHubRegistryManager_CreateDevice_Ex, set the result of the invalid ones to IOTHUB_REGISTRYMANAGER_INVALID_VERSION or IOTHUB_REGISTRYMANAGER_INVALID_ARG and not send them ] */
+    TEST_FUNCTION(IoTHubRegistryManager_BulkCreateDevices_sends_nothing_if_every_device_is_invalid)
+    {
+        // arrange
+        TEST_BULK_DEVICES[0].version = 999;
+        TEST_BULK_DEVICES[1].deviceId = NULL;
+        TEST_BULK_DEVICES[2].deviceId = "aaa bbb";
+        TEST_BULK_DEVICES[3].authMethod = IOTHUB_REGISTRYMANAGER_AUTH_UNKNOWN;
+
+        // act
+        IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_BulkCreateDevices(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, TEST_BULK_DEVICES, 4, TEST_BULK_RESULTS);
+
+        // assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_ERROR, result);
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_INVALID_VERSION, TEST_BULK_RESULTS[0]);
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_INVALID_ARG, TEST_BULK_RESULTS[1]);
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_INVALID_ARG, TEST_BULK_RESULTS[2]);
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_INVALID_ARG, TEST_BULK_RESULTS[3]);
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_018: [ IoTHubRegistryManager_BulkCreateDevices shall send the devices in batches of up to 100 with an HTTP POST to url/devices?api-version, using the headers used by IoTHubRegistryManager_CreateDevice ] */
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_019: [ The body of every bulk request shall be a JSON array built with json_value_init_array and json_array_append_value ] */
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_020: [ Every device of a batch shall be sent as an object with "id", "importMode" set to "create", "status" set to "enabled", "authentication.type", the keys or thumbprints that are not NULL and "capabilities.iotEdge" ] */
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_023: [ The devices of a batch without an entry in "errors" shall keep IOTHUB_REGISTRYMANAGER_OK ] */
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_029: [ IoTHubRegistryManager_BulkCreateDevices shall return IOTHUB_REGISTRYMANAGER_OK if every device got IOTHUB_REGISTRYMANAGER_OK and IOTHUB_REGISTRYMANAGER_ERROR otherwise ] */
+    TEST_FUNCTION(IoTHubRegistryManager_BulkCreateDevices_happy_path)
+    {
+        // arrange
+        setupBulkCreateWorkerMockCalls(1, 2, httpStatusCodeOk, NULL);
+
+        // act
+        IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_BulkCreateDevices(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, TEST_BULK_DEVICES, 2, TEST_BULK_RESULTS);
+
+        // assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_OK, result);
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_OK, TEST_BULK_RESULTS[0]);
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_OK, TEST_BULK_RESULTS[1]);
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_021: [ Every worker shall create its HTTP headers, response buffer, HTTPAPIEX_SAS_HANDLE and HTTPAPIEX_HANDLE once and reuse them for all its batches ] */
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_026: [ IoTHubRegistryManager_BulkCreateDevices shall send up to 4 batches concurrently, running the first worker on the calling thread and the others on threads created by calling ThreadAPI_Create, each worker taking every 4th batch ] */
+    TEST_FUNCTION(IoTHubRegistryManager_BulkCreateDevices_sends_the_batches_concurrently)
+    {
+        // arrange
+        STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+        setupBulkCreateWorkerMockCalls(1, TEST_BULK_DEVICE_COUNT - 100, httpStatusCodeOk, NULL);
+        setupBulkCreateWorkerMockCalls(1, 100, httpStatusCodeOk, NULL);
+        STRICT_EXPECTED_CALL(ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+
+        // act
+        IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_BulkCreateDevices(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, TEST_BULK_DEVICES, TEST_BULK_DEVICE_COUNT, TEST_BULK_RESULTS);
+
+        // assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_OK, result);
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_OK, TEST_BULK_RESULTS[0]);
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_OK, TEST_BULK_RESULTS[TEST_BULK_DEVICE_COUNT - 1]);
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_028: [ If ThreadAPI_Create fails the batches of that worker shall be sent on the calling thread ] */
+    TEST_FUNCTION(IoTHubRegistryManager_BulkCreateDevices_sends_the_batches_inline_if_ThreadAPI_Create_fails)
+    {
+        // arrange
+        STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments()
+            .SetReturn(THREADAPI_ERROR);
+        setupBulkCreateWorkerMockCalls(1, 100, httpStatusCodeOk, NULL);
+        setupBulkCreateWorkerMockCalls(1, TEST_BULK_DEVICE_COUNT - 100, httpStatusCodeOk, NULL);
+
+        // act
+        IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_BulkCreateDevices(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, TEST_BULK_DEVICES, TEST_BULK_DEVICE_COUNT, TEST_BULK_RESULTS);
+
+        // assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_OK, result);
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_022: [ Every entry of the "errors" array of the response shall set the result of the device of the batch with the same deviceId, to IOTHUB_REGISTRYMANAGER_DEVICE_EXIST for the "DeviceAlreadyExists" errorCode and to IOTHUB_REGISTRYMANAGER_ERROR otherwise ] */
+    TEST_FUNCTION(IoTHubRegistryManager_BulkCreateDevices_reports_the_existing_device)
+    {
+        // arrange
+        setupBulkCreateWorkerMockCalls(1, 1, httpStatusCodeBadRequest, TEST_BULK_ERROR_CODE_DEVICE_EXISTS);
+
+        // act
+        IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_BulkCreateDevices(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, TEST_BULK_DEVICES, 1, TEST_BULK_RESULTS);
+
+        // assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_ERROR, result);
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_DEVICE_EXIST, TEST_BULK_RESULTS[0]);
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_022: [ Every entry of the "errors" array of the response shall set the result of the device of the batch with the same deviceId, to IOTHUB_REGISTRYMANAGER_DEVICE_EXIST for the "DeviceAlreadyExists" errorCode and to IOTHUB_REGISTRYMANAGER_ERROR otherwise ] */
+    TEST_FUNCTION(IoTHubRegistryManager_BulkCreateDevices_reports_the_failed_device)
+    {
+        // arrange
+        setupBulkCreateWorkerMockCalls(1, 1, httpStatusCodeBadRequest, "ArgumentInvalid");
+
+        // act
+        IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_BulkCreateDevices(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, TEST_BULK_DEVICES, 1, TEST_BULK_RESULTS);
+
+        // assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_ERROR, result);
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_ERROR, TEST_BULK_RESULTS[0]);
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_024: [ If the HTTP status code of a batch is greater than 300 and its response has no "errors", every device of the batch shall get IOTHUB_REGISTRYMANAGER_HTTP_STATUS_ERROR ] */
+    TEST_FUNCTION(IoTHubRegistryManager_BulkCreateDevices_status_code_400_without_errors)
+    {
+        // arrange
+        setupBulkCreateWorkerMockCalls(1, 2, httpStatusCodeBadRequest, NULL);
+
+        // act
+        IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_BulkCreateDevices(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, TEST_BULK_DEVICES, 2, TEST_BULK_RESULTS);
+
+        // assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_ERROR, result);
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_HTTP_STATUS_ERROR, TEST_BULK_RESULTS[0]);
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_HTTP_STATUS_ERROR, TEST_BULK_RESULTS[1]);
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_025: [ If the HTTPAPI calls of a batch fail every device of the batch shall get IOTHUB_REGISTRYMANAGER_HTTPAPI_ERROR ] */
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_027: [ If the JSON of a batch cannot be created every device of the batch shall get IOTHUB_REGISTRYMANAGER_JSON_ERROR ] */
+    TEST_FUNCTION(IoTHubRegistryManager_BulkCreateDevices_non_happy_path)
+    {
+        ///arrange
+        int umockc_result = umock_c_negative_tests_init();
+        ASSERT_ARE_EQUAL(int, 0, umockc_result);
+
+        setupBulkCreateWorkerMockCalls(1, 1, httpStatusCodeOk, NULL);
+
+        umock_c_negative_tests_snapshot();
+
+        size_t negative_call_count = umock_c_negative_tests_call_count();
+        for (size_t i = 0; i < negative_call_count; i++)
+        {
+            /// arrange
+            umock_c_negative_tests_reset();
+            umock_c_negative_tests_fail_call(i);
+
+            /// act
+            if (
+                (i != 26) && /*json_free_serialized_string*/
+                (i != 27) && /*json_value_free*/
+                (i < 29) /*the response of a 200 is only read for errors, cleanup*/
+                )
+            {
+                IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_BulkCreateDevices(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, TEST_BULK_DEVICES, 1, TEST_BULK_RESULTS);
+                char message_on_error[64];
+                sprintf(message_on_error, "Got unexpected IOTHUB_REGISTRYMANAGER_OK on run %lu", (unsigned long)i);
+
+                /// assert
+                ASSERT_ARE_NOT_EQUAL(int, IOTHUB_REGISTRYMANAGER_OK, result, message_on_error);
+                ASSERT_ARE_NOT_EQUAL(int, IOTHUB_REGISTRYMANAGER_OK, TEST_BULK_RESULTS[0], message_on_error);
+            }
+        }
+        umock_c_negative_tests_deinit();
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_034: [ If registryManagerHandle is NULL IoTHubRegistryManager_SetCache shall return IOTHUB_REGISTRYMANAGER_INVALID_ARG ] */
+    TEST_FUNCTION(IoTHubRegistryManager_SetCache_return_IOTHUB_REGISTRYMANAGER_INVALID_ARG_if_input_parameter_registryManagerHandle_is_NULL)
+    {
+        ///act
+        IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_SetCache(NULL, 60, 10);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_035: [ The first call of IoTHubRegistryManager_SetCache with a non-zero timeToLiveInSeconds shall create the cache and its lock by calling Lock_Init, and return IOTHUB_REGISTRYMANAGER_ERROR if it fails ] */
+    TEST_FUNCTION(IoTHubRegistryManager_SetCache_return_IOTHUB_REGISTRYMANAGER_ERROR_if_Lock_Init_fails)
+    {
+        ///arrange
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(Lock_Init())
+            .SetReturn(NULL);
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_SetCache(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, 60, 10);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_ERROR, result);
+        ASSERT_IS_NULL(TEST_IOTHUB_REGISTRYMANAGER.cache);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_039: [ If the cached device is younger than the time to live it shall be parsed from the cached response without any HTTP request, and a device cached as not existing shall return IOTHUB_REGISTRYMANAGER_DEVICE_NOT_EXIST ] */
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_041: [ While the cache is enabled IoTHubRegistryManager_GetStatistics shall be served from a single cached entry the same way, without revalidation since the statistics have no etag ] */
+    TEST_FUNCTION(IoTHubRegistryManager_GetStatistics_is_served_from_the_cache_without_HTTP_request)
+    {
+        ///arrange
+        IOTHUB_REGISTRYMANAGER_HANDLE handle = create_test_registry_manager(60);
+        setupHttpMockCalls(false, httpStatusCodeOk, HTTPAPI_REQUEST_GET);
+        setupJsonParseStatisticsMockCalls();
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_OK, IoTHubRegistryManager_GetStatistics(handle, &TEST_IOTHUB_REGISTRY_STATISTICS));
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(get_time(NULL));
+        STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+        setupJsonParseStatisticsMockCalls();
+        STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+
+        ///act
+        IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_GetStatistics(handle, &TEST_IOTHUB_REGISTRY_STATISTICS);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_OK, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        IoTHubRegistryManager_Destroy(handle);
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_040: [ Otherwise the device shall be requested as without the cache, and the response of a device found or not existing shall be cached with the time returned by get_time, dropping the least recently used device above maxDeviceCount ] */
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_044: [ IoTHubRegistryManager_CreateDevice(_Ex), IoTHubRegistryManager_UpdateDevice(_Ex) and IoTHubRegistryManager_DeleteDevice shall drop the cached device and statistics, IoTHubRegistryManager_BulkCreateDevices every cached entry, and a response fetched before the drop shall not be cached ] */
+    TEST_FUNCTION(IoTHubRegistryManager_DeleteDevice_drops_the_cached_statistics)
+    {
+        ///arrange
+        IOTHUB_REGISTRYMANAGER_HANDLE handle = create_test_registry_manager(60);
+        setupHttpMockCalls(false, httpStatusCodeOk, HTTPAPI_REQUEST_GET);
+        setupJsonParseStatisticsMockCalls();
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_OK, IoTHubRegistryManager_GetStatistics(handle, &TEST_IOTHUB_REGISTRY_STATISTICS));
+        setupHttpMockCalls(true, httpStatusCodeOk, HTTPAPI_REQUEST_DELETE);
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_OK, IoTHubRegistryManager_DeleteDevice(handle, TEST_DEVICE_ID));
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(get_time(NULL));
+        STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+        setupHttpMockCalls(false, httpStatusCodeOk, HTTPAPI_REQUEST_GET);
+        setupJsonParseStatisticsMockCalls();
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+
+        ///act
+        IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_GetStatistics(handle, &TEST_IOTHUB_REGISTRY_STATISTICS);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_OK, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        IoTHubRegistryManager_Destroy(handle);
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_046: [ IoTHubRegistryManager_GetDeviceAsync and IoTHubRegistryManager_GetStatisticsAsync shall verify the input parameters and if any of them (except the context) are NULL then return IOTHUB_REGISTRYMANAGER_INVALID_ARG ] */
+    TEST_FUNCTION(IoTHubRegistryManager_GetDeviceAsync_return_IOTHUB_REGISTRYMANAGER_INVALID_ARG_if_input_parameter_deviceId_is_NULL)
+    {
+        ///act
+        IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_GetDeviceAsync(TEST_IOTHUB_REGISTRYMANAGER_HANDLE, NULL, NULL, NULL);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_048: [ The worker shall take the queued fetches in order and execute each the way IoTHubRegistryManager_GetDevice_Ex or IoTHubRegistryManager_GetStatistics does, through the cache if it is enabled, without holding the lock ] */
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_049: [ The worker shall queue each completed fetch for IoTHubRegistryManager_DoWork and exit once no fetch is queued ] */
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_052: [ IoTHubRegistryManager_DoWork shall join an exited worker, retry starting it for the queued fetches, take the completed fetches and call their callbacks after releasing the lock, with the device or statistics only when the result is IOTHUB_REGISTRYMANAGER_OK, freeing the device members once the callback returns ] */
+    TEST_FUNCTION(IoTHubRegistryManager_GetStatisticsAsync_calls_the_callback_from_DoWork)
+    {
+        ///arrange
+        IOTHUB_REGISTRYMANAGER_HANDLE handle = create_test_registry_manager(0);
+        g_statistics_callback_count = 0;
+        setupHttpMockCalls(false, httpStatusCodeOk, HTTPAPI_REQUEST_GET);
+        setupJsonParseStatisticsMockCalls();
+
+        ///act
+        IOTHUB_REGISTRYMANAGER_RESULT result = IoTHubRegistryManager_GetStatisticsAsync(handle, test_get_statistics_callback, NULL);
+        size_t countBeforeDoWork = g_statistics_callback_count;
+        IoTHubRegistryManager_DoWork(handle);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_OK, result);
+        ASSERT_ARE_EQUAL(size_t, 0, countBeforeDoWork);
+        ASSERT_ARE_EQUAL(size_t, 1, g_statistics_callback_count);
+        ASSERT_ARE_EQUAL(int, IOTHUB_REGISTRYMANAGER_OK, g_statistics_callback_result);
+        ASSERT_IS_TRUE(g_statistics_callback_had_statistics);
+
+        ///cleanup
+        IoTHubRegistryManager_Destroy(handle);
+    }
+
+    /* Tests_SRS_IOTHUBREGISTRYMANAGER_41_051: [ If registryManagerHandle is NULL or no asynchronous fetch has been queued IoTHubRegistryManager_DoWork shall return ] */
+    TEST_FUNCTION(IoTHubRegistryManager_DoWork_does_nothing_if_input_parameter_registryManagerHandle_is_NULL)
+    {
+        ///act
+        IoTHubRegistryManager_DoWork(NULL);
+        IoTHubRegistryManager_DoWork(TEST_IOTHUB_REGISTRYMANAGER_HANDLE);
+
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
     END_TEST_SUITE(iothub_registrymanager_ut)
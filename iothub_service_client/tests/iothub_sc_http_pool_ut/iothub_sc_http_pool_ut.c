@@ -0,0 +1,671 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstring>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdbool.h>
+#endif
+
+static const char* TEST_HOSTNAME = "theHostName";
+static const char* TEST_SHAREDACCESSKEY = "theSharedAccessKey";
+static const char* TEST_SHAREDACCESSKEYNAME = "theSharedAccessKeyName";
+static const char* TEST_SHAREDACCESSSIGNATURE = "sas=SharedAccessSignature sr=theHostName&sig=theSig&se=1234";
+static const char* TEST_RELATIVE_PATH = "/twins/theDeviceId";
+static unsigned char* TEST_SAS_TOKEN = (unsigned char*)"SharedAccessSignature sr=theHostName";
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+static int my_mallocAndStrcpy_s(char** destination, const char* source)
+{
+    size_t l = strlen(source);
+    *destination = (char*)my_gballoc_malloc(l + 1);
+    strcpy(*destination, source);
+    return 0;
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umock_c_negative_tests.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+
+#define ENABLE_MOCKS
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/crt_abstractions.h"
+#include "azure_c_shared_utility/strings.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/agenttime.h"
+#include "azure_c_shared_utility/sastoken.h"
+#include "azure_c_shared_utility/httpheaders.h"
+#include "azure_c_shared_utility/httpapiex.h"
+
+#undef ENABLE_MOCKS
+
+#include "internal/iothub_sc_http_pool.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    STRING_HANDLE STRING_construct_sprintf(const char* format, ...);
+
+    STRING_HANDLE STRING_construct_sprintf(const char* format, ...)
+    {
+        (void)format;
+        return (STRING_HANDLE)my_gballoc_malloc(1);
+    }
+
+#ifdef __cplusplus
+}
+#endif
+
+TEST_DEFINE_ENUM_TYPE(HTTPAPIEX_RESULT, HTTPAPIEX_RESULT_VALUES);
+IMPLEMENT_UMOCK_C_ENUM_TYPE(HTTPAPIEX_RESULT, HTTPAPIEX_RESULT_VALUES);
+TEST_DEFINE_ENUM_TYPE(HTTP_HEADERS_RESULT, HTTP_HEADERS_RESULT_VALUES);
+IMPLEMENT_UMOCK_C_ENUM_TYPE(HTTP_HEADERS_RESULT, HTTP_HEADERS_RESULT_VALUES);
+TEST_DEFINE_ENUM_TYPE(HTTPAPI_REQUEST_TYPE, HTTPAPI_REQUEST_TYPE_VALUES);
+IMPLEMENT_UMOCK_C_ENUM_TYPE(HTTPAPI_REQUEST_TYPE, HTTPAPI_REQUEST_TYPE_VALUES);
+TEST_DEFINE_ENUM_TYPE(LOCK_RESULT, LOCK_RESULT_VALUES);
+IMPLEMENT_UMOCK_C_ENUM_TYPE(LOCK_RESULT, LOCK_RESULT_VALUES);
+
+static TEST_MUTEX_HANDLE g_testByTest;
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    (void)error_code;
+    ASSERT_FAIL("umock_c reported error");
+}
+
+static LOCK_HANDLE TEST_LOCK_HANDLE = (LOCK_HANDLE)0x1212;
+static HTTP_HEADERS_HANDLE TEST_HTTP_HEADERS_HANDLE = (HTTP_HEADERS_HANDLE)0x4343;
+static BUFFER_HANDLE TEST_BUFFER_HANDLE = (BUFFER_HANDLE)0x4444;
+static time_t TEST_TIME_VALUE = (time_t)100000;
+static unsigned int TEST_STATUS_CODE = 200;
+
+static STRING_HANDLE my_STRING_construct(const char* psz)
+{
+    char* s = NULL;
+    (void)my_mallocAndStrcpy_s(&s, psz);
+    return (STRING_HANDLE)s;
+}
+
+static void my_STRING_delete(STRING_HANDLE handle)
+{
+    my_gballoc_free(handle);
+}
+
+static const char* my_STRING_c_str(STRING_HANDLE handle)
+{
+    return (const char*)handle;
+}
+
+static STRING_HANDLE my_SASToken_CreateString(const char* key, const char* scope, const char* keyName, size_t expiry)
+{
+    (void)key;
+    (void)scope;
+    (void)keyName;
+    (void)expiry;
+    return my_STRING_construct((const char*)TEST_SAS_TOKEN);
+}
+
+static HTTPAPIEX_HANDLE my_HTTPAPIEX_Create(const char* hostName)
+{
+    (void)hostName;
+    return (HTTPAPIEX_HANDLE)my_gballoc_malloc(1);
+}
+
+static void my_HTTPAPIEX_Destroy(HTTPAPIEX_HANDLE handle)
+{
+    my_gballoc_free(handle);
+}
+
+static HTTPAPIEX_RESULT my_HTTPAPIEX_ExecuteRequest(HTTPAPIEX_HANDLE handle, HTTPAPI_REQUEST_TYPE requestType, const char* relativePath, HTTP_HEADERS_HANDLE requestHttpHeadersHandle, BUFFER_HANDLE requestContent, unsigned int* statusCode, HTTP_HEADERS_HANDLE responseHttpHeadersHandle, BUFFER_HANDLE responseContent)
+{
+    (void)handle;
+    (void)requestType;
+    (void)relativePath;
+    (void)requestHttpHeadersHandle;
+    (void)requestContent;
+    (void)responseHttpHeadersHandle;
+    (void)responseContent;
+    *statusCode = TEST_STATUS_CODE;
+    return HTTPAPIEX_OK;
+}
+
+static IOTHUB_SC_HTTP_POOL_HANDLE create_pool(const char* sharedAccessKey)
+{
+    IOTHUB_SC_HTTP_POOL_HANDLE result = IoTHubSCHttpPool_Create(TEST_HOSTNAME, sharedAccessKey, TEST_SHAREDACCESSKEYNAME, NULL);
+    ASSERT_IS_NOT_NULL(result);
+    umock_c_reset_all_calls();
+    return result;
+}
+
+static HTTPAPIEX_RESULT execute_request(IOTHUB_SC_HTTP_POOL_HANDLE httpPool)
+{
+    unsigned int statusCode = 0;
+    return IoTHubSCHttpPool_ExecuteRequest(httpPool, HTTPAPI_REQUEST_GET, TEST_RELATIVE_PATH, TEST_HTTP_HEADERS_HANDLE, NULL, &statusCode, NULL, TEST_BUFFER_HANDLE);
+}
+
+static void setup_execute_request_mocks(time_t currentTime, bool generatesToken, bool createsConnection, HTTPAPIEX_RESULT executeResult)
+{
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(get_time(NULL))
+        .SetReturn(currentTime);
+    if (generatesToken)
+    {
+        STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(SASToken_CreateString(TEST_SHAREDACCESSKEY, TEST_HOSTNAME, TEST_SHAREDACCESSKEYNAME, (size_t)currentTime + IOTHUB_SC_HTTP_POOL_SAS_TOKEN_LIFETIME));
+        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    }
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_ReplaceHeaderNameValuePair(TEST_HTTP_HEADERS_HANDLE, "Authorization", (const char*)TEST_SAS_TOKEN));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    if (createsConnection)
+    {
+        STRICT_EXPECTED_CALL(HTTPAPIEX_Create(TEST_HOSTNAME));
+    }
+    STRICT_EXPECTED_CALL(HTTPAPIEX_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_GET, TEST_RELATIVE_PATH, TEST_HTTP_HEADERS_HANDLE, NULL, IGNORED_PTR_ARG, NULL, TEST_BUFFER_HANDLE))
+        .IgnoreArgument_handle()
+        .IgnoreArgument_statusCode()
+        .SetReturn(executeResult);
+    if (executeResult == HTTPAPIEX_OK)
+    {
+        STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    }
+    else
+    {
+        STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG));
+    }
+}
+
+BEGIN_TEST_SUITE(iothub_sc_http_pool_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    int result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_TYPE(HTTPAPIEX_RESULT, HTTPAPIEX_RESULT);
+    REGISTER_TYPE(HTTP_HEADERS_RESULT, HTTP_HEADERS_RESULT);
+    REGISTER_TYPE(HTTPAPI_REQUEST_TYPE, HTTPAPI_REQUEST_TYPE);
+    REGISTER_TYPE(LOCK_RESULT, LOCK_RESULT);
+    REGISTER_UMOCK_ALIAS_TYPE(BUFFER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(STRING_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(HTTP_HEADERS_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(HTTPAPIEX_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(time_t, long);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+    REGISTER_GLOBAL_MOCK_HOOK(mallocAndStrcpy_s, my_mallocAndStrcpy_s);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(mallocAndStrcpy_s, 42);
+
+    REGISTER_GLOBAL_MOCK_HOOK(STRING_construct, my_STRING_construct);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(STRING_construct, NULL);
+
+    REGISTER_GLOBAL_MOCK_HOOK(STRING_c_str, my_STRING_c_str);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(STRING_c_str, NULL);
+
+    REGISTER_GLOBAL_MOCK_HOOK(STRING_delete, my_STRING_delete);
+
+    REGISTER_GLOBAL_MOCK_RETURN(Lock_Init, TEST_LOCK_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock_Init, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock, LOCK_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock_Deinit, LOCK_OK);
+
+    REGISTER_GLOBAL_MOCK_RETURN(get_time, TEST_TIME_VALUE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(get_time, (time_t)(-1));
+
+    REGISTER_GLOBAL_MOCK_HOOK(SASToken_CreateString, my_SASToken_CreateString);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(SASToken_CreateString, NULL);
+
+    REGISTER_GLOBAL_MOCK_RETURN(HTTPHeaders_ReplaceHeaderNameValuePair, HTTP_HEADERS_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(HTTPHeaders_ReplaceHeaderNameValuePair, HTTP_HEADERS_ERROR);
+
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_Create, my_HTTPAPIEX_Create);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(HTTPAPIEX_Create, NULL);
+
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_Destroy, my_HTTPAPIEX_Destroy);
+
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPAPIEX_ExecuteRequest, my_HTTPAPIEX_ExecuteRequest);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(HTTPAPIEX_ExecuteRequest, HTTPAPIEX_ERROR);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+    TEST_MUTEX_DESTROY(g_testByTest);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+
+    TEST_STATUS_CODE = 200;
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    umock_c_negative_tests_deinit();
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+/*Tests_SRS_IOTHUBSCHTTPPOOL_41_001: [ If hostname or sharedAccessKey is NULL, IoTHubSCHttpPool_Create shall return NULL ]*/
+TEST_FUNCTION(IoTHubSCHttpPool_Create_returns_NULL_if_hostname_is_NULL)
+{
+    // act
+    IOTHUB_SC_HTTP_POOL_HANDLE result = IoTHubSCHttpPool_Create(NULL, TEST_SHAREDACCESSKEY, TEST_SHAREDACCESSKEYNAME, NULL);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBSCHTTPPOOL_41_001: [ If hostname or sharedAccessKey is NULL, IoTHubSCHttpPool_Create shall return NULL ]*/
+TEST_FUNCTION(IoTHubSCHttpPool_Create_returns_NULL_if_sharedAccessKey_is_NULL)
+{
+    // act
+    IOTHUB_SC_HTTP_POOL_HANDLE result = IoTHubSCHttpPool_Create(TEST_HOSTNAME, NULL, TEST_SHAREDACCESSKEYNAME, NULL);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBSCHTTPPOOL_41_002: [ IoTHubSCHttpPool_Create shall allocate memory for a new pool ]*/
+/*Tests_SRS_IOTHUBSCHTTPPOOL_41_003: [ IoTHubSCHttpPool_Create shall copy hostname, sharedAccessKey and keyName, and build the SAS scope from hostname and, if given, deviceId ]*/
+TEST_FUNCTION(IoTHubSCHttpPool_Create_happy_path)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_HOSTNAME))
+        .IgnoreArgument_destination();
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_SHAREDACCESSKEY))
+        .IgnoreArgument_destination();
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_SHAREDACCESSKEYNAME))
+        .IgnoreArgument_destination();
+    STRICT_EXPECTED_CALL(STRING_construct(TEST_HOSTNAME));
+    STRICT_EXPECTED_CALL(Lock_Init());
+
+    // act
+    IOTHUB_SC_HTTP_POOL_HANDLE result = IoTHubSCHttpPool_Create(TEST_HOSTNAME, TEST_SHAREDACCESSKEY, TEST_SHAREDACCESSKEYNAME, NULL);
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubSCHttpPool_Destroy(result);
+}
+
+/*Tests_SRS_IOTHUBSCHTTPPOOL_41_005: [ If the shared access key is a "sas=" prefixed signature, IoTHubSCHttpPool_Create shall cache the signature as the SAS token ]*/
+TEST_FUNCTION(IoTHubSCHttpPool_Create_caches_a_shared_access_signature)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_HOSTNAME))
+        .IgnoreArgument_destination();
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_SHAREDACCESSSIGNATURE))
+        .IgnoreArgument_destination();
+    STRICT_EXPECTED_CALL(STRING_construct(TEST_HOSTNAME));
+    STRICT_EXPECTED_CALL(STRING_construct(TEST_SHAREDACCESSSIGNATURE + 4));
+    STRICT_EXPECTED_CALL(Lock_Init());
+
+    // act
+    IOTHUB_SC_HTTP_POOL_HANDLE result = IoTHubSCHttpPool_Create(TEST_HOSTNAME, TEST_SHAREDACCESSSIGNATURE, NULL, NULL);
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubSCHttpPool_Destroy(result);
+}
+
+/*Tests_SRS_IOTHUBSCHTTPPOOL_41_004: [ If any of the calls fail, IoTHubSCHttpPool_Create shall do clean up and return NULL ]*/
+TEST_FUNCTION(IoTHubSCHttpPool_Create_non_happy_path)
+{
+    // arrange
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_HOSTNAME))
+        .IgnoreArgument_destination();
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_SHAREDACCESSKEY))
+        .IgnoreArgument_destination();
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_SHAREDACCESSKEYNAME))
+        .IgnoreArgument_destination();
+    STRICT_EXPECTED_CALL(STRING_construct(TEST_HOSTNAME));
+    STRICT_EXPECTED_CALL(Lock_Init());
+
+    umock_c_negative_tests_snapshot();
+
+    for (size_t i = 0; i < umock_c_negative_tests_call_count(); i++)
+    {
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(i);
+
+        // act
+        IOTHUB_SC_HTTP_POOL_HANDLE result = IoTHubSCHttpPool_Create(TEST_HOSTNAME, TEST_SHAREDACCESSKEY, TEST_SHAREDACCESSKEYNAME, NULL);
+
+        // assert
+        ASSERT_IS_NULL(result);
+    }
+}
+
+/*Tests_SRS_IOTHUBSCHTTPPOOL_41_006: [ If httpPoolHandle is NULL, IoTHubSCHttpPool_Clone shall return NULL ]*/
+TEST_FUNCTION(IoTHubSCHttpPool_Clone_returns_NULL_if_httpPoolHandle_is_NULL)
+{
+    // act
+    IOTHUB_SC_HTTP_POOL_HANDLE result = IoTHubSCHttpPool_Clone(NULL);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBSCHTTPPOOL_41_007: [ IoTHubSCHttpPool_Clone shall increment the reference count of the pool and return httpPoolHandle ]*/
+/*Tests_SRS_IOTHUBSCHTTPPOOL_41_010: [ IoTHubSCHttpPool_Destroy shall decrement the reference count and, when it reaches zero, destroy the idle connections and free the pool ]*/
+TEST_FUNCTION(IoTHubSCHttpPool_Clone_keeps_the_pool_alive_until_the_last_reference_is_released)
+{
+    // arrange
+    IOTHUB_SC_HTTP_POOL_HANDLE httpPool = create_pool(TEST_SHAREDACCESSKEY);
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+
+    // act
+    IOTHUB_SC_HTTP_POOL_HANDLE result = IoTHubSCHttpPool_Clone(httpPool);
+    IoTHubSCHttpPool_Destroy(httpPool);
+
+    // assert
+    ASSERT_ARE_EQUAL(void_ptr, httpPool, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubSCHttpPool_Destroy(result);
+}
+
+/*Tests_SRS_IOTHUBSCHTTPPOOL_41_008: [ If Lock fails, IoTHubSCHttpPool_Clone shall return NULL ]*/
+TEST_FUNCTION(IoTHubSCHttpPool_Clone_returns_NULL_if_Lock_fails)
+{
+    // arrange
+    IOTHUB_SC_HTTP_POOL_HANDLE httpPool = create_pool(TEST_SHAREDACCESSKEY);
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE))
+        .SetReturn(LOCK_ERROR);
+
+    // act
+    IOTHUB_SC_HTTP_POOL_HANDLE result = IoTHubSCHttpPool_Clone(httpPool);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubSCHttpPool_Destroy(httpPool);
+}
+
+/*Tests_SRS_IOTHUBSCHTTPPOOL_41_009: [ If httpPoolHandle is NULL, IoTHubSCHttpPool_Destroy shall return ]*/
+TEST_FUNCTION(IoTHubSCHttpPool_Destroy_returns_if_httpPoolHandle_is_NULL)
+{
+    // act
+    IoTHubSCHttpPool_Destroy(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBSCHTTPPOOL_41_010: [ IoTHubSCHttpPool_Destroy shall decrement the reference count and, when it reaches zero, destroy the idle connections and free the pool ]*/
+TEST_FUNCTION(IoTHubSCHttpPool_Destroy_destroys_the_idle_connections)
+{
+    // arrange
+    IOTHUB_SC_HTTP_POOL_HANDLE httpPool = create_pool(TEST_SHAREDACCESSKEY);
+    ASSERT_ARE_EQUAL(int, HTTPAPIEX_OK, execute_request(httpPool));
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock_Deinit(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    IoTHubSCHttpPool_Destroy(httpPool);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBSCHTTPPOOL_41_011: [ If httpPoolHandle, relativePath, requestHttpHeadersHandle or statusCode is NULL, IoTHubSCHttpPool_ExecuteRequest shall return HTTPAPIEX_INVALID_ARG ]*/
+TEST_FUNCTION(IoTHubSCHttpPool_ExecuteRequest_returns_HTTPAPIEX_INVALID_ARG_if_httpPoolHandle_is_NULL)
+{
+    // act
+    HTTPAPIEX_RESULT result = execute_request(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, HTTPAPIEX_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBSCHTTPPOOL_41_011: [ If httpPoolHandle, relativePath, requestHttpHeadersHandle or statusCode is NULL, IoTHubSCHttpPool_ExecuteRequest shall return HTTPAPIEX_INVALID_ARG ]*/
+TEST_FUNCTION(IoTHubSCHttpPool_ExecuteRequest_returns_HTTPAPIEX_INVALID_ARG_if_statusCode_is_NULL)
+{
+    // arrange
+    IOTHUB_SC_HTTP_POOL_HANDLE httpPool = create_pool(TEST_SHAREDACCESSKEY);
+
+    // act
+    HTTPAPIEX_RESULT result = IoTHubSCHttpPool_ExecuteRequest(httpPool, HTTPAPI_REQUEST_GET, TEST_RELATIVE_PATH, TEST_HTTP_HEADERS_HANDLE, NULL, NULL, NULL, TEST_BUFFER_HANDLE);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, HTTPAPIEX_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubSCHttpPool_Destroy(httpPool);
+}
+
+/*Tests_SRS_IOTHUBSCHTTPPOOL_41_012: [ Otherwise IoTHubSCHttpPool_ExecuteRequest shall generate a new SAS token valid for IOTHUB_SC_HTTP_POOL_SAS_TOKEN_LIFETIME seconds by calling SASToken_CreateString and cache it ]*/
+/*Tests_SRS_IOTHUBSCHTTPPOOL_41_015: [ IoTHubSCHttpPool_ExecuteRequest shall set the Authorization header to the cached SAS token by calling HTTPHeaders_ReplaceHeaderNameValuePair ]*/
+/*Tests_SRS_IOTHUBSCHTTPPOOL_41_020: [ IoTHubSCHttpPool_ExecuteRequest shall take an idle connection from the pool, or create one by calling HTTPAPIEX_Create when none is idle ]*/
+/*Tests_SRS_IOTHUBSCHTTPPOOL_41_021: [ IoTHubSCHttpPool_ExecuteRequest shall execute the request on the connection by calling HTTPAPIEX_ExecuteRequest and return its result ]*/
+/*Tests_SRS_IOTHUBSCHTTPPOOL_41_016: [ After a successful request IoTHubSCHttpPool_ExecuteRequest shall return the connection to the pool if fewer than IOTHUB_SC_HTTP_POOL_MAX_IDLE_CONNECTIONS connections are idle ]*/
+TEST_FUNCTION(IoTHubSCHttpPool_ExecuteRequest_first_request_creates_the_token_and_the_connection)
+{
+    // arrange
+    IOTHUB_SC_HTTP_POOL_HANDLE httpPool = create_pool(TEST_SHAREDACCESSKEY);
+
+    setup_execute_request_mocks(TEST_TIME_VALUE, true, true, HTTPAPIEX_OK);
+
+    // act
+    HTTPAPIEX_RESULT result = execute_request(httpPool);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, HTTPAPIEX_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubSCHttpPool_Destroy(httpPool);
+}
+
+/*Tests_SRS_IOTHUBSCHTTPPOOL_41_013: [ IoTHubSCHttpPool_ExecuteRequest shall reuse the cached SAS token while it is valid for more than IOTHUB_SC_HTTP_POOL_SAS_TOKEN_REFRESH_MARGIN seconds ]*/
+/*Tests_SRS_IOTHUBSCHTTPPOOL_41_020: [ IoTHubSCHttpPool_ExecuteRequest shall take an idle connection from the pool, or create one by calling HTTPAPIEX_Create when none is idle ]*/
+TEST_FUNCTION(IoTHubSCHttpPool_ExecuteRequest_second_request_reuses_the_token_and_the_connection)
+{
+    // arrange
+    IOTHUB_SC_HTTP_POOL_HANDLE httpPool = create_pool(TEST_SHAREDACCESSKEY);
+    ASSERT_ARE_EQUAL(int, HTTPAPIEX_OK, execute_request(httpPool));
+    umock_c_reset_all_calls();
+
+    setup_execute_request_mocks(TEST_TIME_VALUE, false, false, HTTPAPIEX_OK);
+
+    // act
+    HTTPAPIEX_RESULT result = execute_request(httpPool);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, HTTPAPIEX_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubSCHttpPool_Destroy(httpPool);
+}
+
+/*Tests_SRS_IOTHUBSCHTTPPOOL_41_012: [ Otherwise IoTHubSCHttpPool_ExecuteRequest shall generate a new SAS token valid for IOTHUB_SC_HTTP_POOL_SAS_TOKEN_LIFETIME seconds by calling SASToken_CreateString and cache it ]*/
+TEST_FUNCTION(IoTHubSCHttpPool_ExecuteRequest_regenerates_the_token_close_to_its_expiry)
+{
+    // arrange
+    IOTHUB_SC_HTTP_POOL_HANDLE httpPool = create_pool(TEST_SHAREDACCESSKEY);
+    ASSERT_ARE_EQUAL(int, HTTPAPIEX_OK, execute_request(httpPool));
+    umock_c_reset_all_calls();
+
+    setup_execute_request_mocks(TEST_TIME_VALUE + IOTHUB_SC_HTTP_POOL_SAS_TOKEN_LIFETIME - IOTHUB_SC_HTTP_POOL_SAS_TOKEN_REFRESH_MARGIN, true, false, HTTPAPIEX_OK);
+
+    // act
+    HTTPAPIEX_RESULT result = execute_request(httpPool);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, HTTPAPIEX_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubSCHttpPool_Destroy(httpPool);
+}
+
+/*Tests_SRS_IOTHUBSCHTTPPOOL_41_014: [ If the shared access key was given as a "sas=" prefixed signature, IoTHubSCHttpPool_ExecuteRequest shall use it as is and never regenerate it ]*/
+TEST_FUNCTION(IoTHubSCHttpPool_ExecuteRequest_uses_the_shared_access_signature_as_is)
+{
+    // arrange
+    IOTHUB_SC_HTTP_POOL_HANDLE httpPool = create_pool(TEST_SHAREDACCESSSIGNATURE);
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_ReplaceHeaderNameValuePair(TEST_HTTP_HEADERS_HANDLE, "Authorization", TEST_SHAREDACCESSSIGNATURE + 4));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(HTTPAPIEX_Create(TEST_HOSTNAME));
+    STRICT_EXPECTED_CALL(HTTPAPIEX_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_GET, TEST_RELATIVE_PATH, TEST_HTTP_HEADERS_HANDLE, NULL, IGNORED_PTR_ARG, NULL, TEST_BUFFER_HANDLE))
+        .IgnoreArgument_handle()
+        .IgnoreArgument_statusCode();
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+
+    // act
+    HTTPAPIEX_RESULT result = execute_request(httpPool);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, HTTPAPIEX_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubSCHttpPool_Destroy(httpPool);
+}
+
+/*Tests_SRS_IOTHUBSCHTTPPOOL_41_018: [ If the service answered 401, IoTHubSCHttpPool_ExecuteRequest shall discard the cached SAS token so the next request generates a new one ]*/
+TEST_FUNCTION(IoTHubSCHttpPool_ExecuteRequest_regenerates_the_token_after_a_401)
+{
+    // arrange
+    IOTHUB_SC_HTTP_POOL_HANDLE httpPool = create_pool(TEST_SHAREDACCESSKEY);
+    TEST_STATUS_CODE = 401;
+    ASSERT_ARE_EQUAL(int, HTTPAPIEX_OK, execute_request(httpPool));
+    TEST_STATUS_CODE = 200;
+    umock_c_reset_all_calls();
+
+    setup_execute_request_mocks(TEST_TIME_VALUE, true, false, HTTPAPIEX_OK);
+
+    // act
+    HTTPAPIEX_RESULT result = execute_request(httpPool);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, HTTPAPIEX_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubSCHttpPool_Destroy(httpPool);
+}
+
+/*Tests_SRS_IOTHUBSCHTTPPOOL_41_017: [ Otherwise, or if the request failed, IoTHubSCHttpPool_ExecuteRequest shall destroy the connection by calling HTTPAPIEX_Destroy ]*/
+TEST_FUNCTION(IoTHubSCHttpPool_ExecuteRequest_destroys_the_connection_if_the_request_fails)
+{
+    // arrange
+    IOTHUB_SC_HTTP_POOL_HANDLE httpPool = create_pool(TEST_SHAREDACCESSKEY);
+
+    setup_execute_request_mocks(TEST_TIME_VALUE, true, true, HTTPAPIEX_ERROR);
+
+    // act
+    HTTPAPIEX_RESULT result = execute_request(httpPool);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, HTTPAPIEX_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubSCHttpPool_Destroy(httpPool);
+}
+
+/*Tests_SRS_IOTHUBSCHTTPPOOL_41_019: [ If any of the calls fail, IoTHubSCHttpPool_ExecuteRequest shall return HTTPAPIEX_ERROR ]*/
+TEST_FUNCTION(IoTHubSCHttpPool_ExecuteRequest_returns_HTTPAPIEX_ERROR_if_SASToken_CreateString_fails)
+{
+    // arrange
+    IOTHUB_SC_HTTP_POOL_HANDLE httpPool = create_pool(TEST_SHAREDACCESSKEY);
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(SASToken_CreateString(TEST_SHAREDACCESSKEY, TEST_HOSTNAME, TEST_SHAREDACCESSKEYNAME, (size_t)TEST_TIME_VALUE + IOTHUB_SC_HTTP_POOL_SAS_TOKEN_LIFETIME))
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+
+    // act
+    HTTPAPIEX_RESULT result = execute_request(httpPool);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, HTTPAPIEX_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubSCHttpPool_Destroy(httpPool);
+}
+
+END_TEST_SUITE(iothub_sc_http_pool_ut)
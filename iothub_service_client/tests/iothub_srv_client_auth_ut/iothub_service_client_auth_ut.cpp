@@ -16,6 +16,7 @@
 #include "azure_c_shared_utility/connection_string_parser.h"
 
 #include "iothub_service_client_auth.h"
+#include "internal/iothub_sc_http_pool.h"
 
 extern "C" int gballoc_init(void);
 extern "C" void gballoc_deinit(void);
@@ -55,6 +56,9 @@ static STRING_TOKENIZER_HANDLE TEST_STRING_TOKENIZER_HANDLE_NULL = (STRING_TOKEN
 static STRING_HANDLE TEST_KEY_STRING_HANDLE = (STRING_HANDLE)0x4545;
 static STRING_HANDLE TEST_VALUE_STRING_HANDLE = (STRING_HANDLE)0x4646;
 
+static IOTHUB_SC_HTTP_POOL_HANDLE TEST_IOTHUB_SC_HTTP_POOL_HANDLE = (IOTHUB_SC_HTTP_POOL_HANDLE)0x4747;
+static IOTHUB_SC_HTTP_POOL_HANDLE TEST_IOTHUB_SC_HTTP_POOL_HANDLE_NULL = (IOTHUB_SC_HTTP_POOL_HANDLE)NULL;
+
 static const char* TEST_CHAR_PTR = "TestString";
 static const char* TEST_CONNECTION_STRING = "HostName=aaa.bbb.net;SharedAccessKeyName=xxx;SharedAccessKey=yyy";
 static const char* TEST_SAS_CONNECTION_STRING = "HostName=aaa.bbb.net;SharedAccessSignature=yyy";
@@ -132,6 +136,12 @@ public:
     /* Connection string parser mock */
     MOCK_STATIC_METHOD_1(, MAP_HANDLE, connectionstringparser_parse, STRING_HANDLE, connectionString)
     MOCK_METHOD_END(MAP_HANDLE, TEST_MAP_HANDLE);
+
+    /* HTTP pool mocks */
+    MOCK_STATIC_METHOD_4(, IOTHUB_SC_HTTP_POOL_HANDLE, IoTHubSCHttpPool_Create, const char*, hostname, const char*, sharedAccessKey, const char*, keyName, const char*, deviceId)
+    MOCK_METHOD_END(IOTHUB_SC_HTTP_POOL_HANDLE, TEST_IOTHUB_SC_HTTP_POOL_HANDLE);
+    MOCK_STATIC_METHOD_1(, void, IoTHubSCHttpPool_Destroy, IOTHUB_SC_HTTP_POOL_HANDLE, httpPoolHandle)
+    MOCK_VOID_METHOD_END();
 };
 
 
@@ -158,6 +168,9 @@ DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubServiceClientAuthMocks, , void, STRING_TOKEN
 
 DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubServiceClientAuthMocks, , MAP_HANDLE, connectionstringparser_parse, STRING_HANDLE, connectionString);
 
+DECLARE_GLOBAL_MOCK_METHOD_4(CIoTHubServiceClientAuthMocks, , IOTHUB_SC_HTTP_POOL_HANDLE, IoTHubSCHttpPool_Create, const char*, hostname, const char*, sharedAccessKey, const char*, keyName, const char*, deviceId);
+DECLARE_GLOBAL_MOCK_METHOD_1(CIoTHubServiceClientAuthMocks, , void, IoTHubSCHttpPool_Destroy, IOTHUB_SC_HTTP_POOL_HANDLE, httpPoolHandle);
+
 static void set_expected_calls_for_free_service_client_auth(CIoTHubServiceClientAuthMocks &mocks)
 {
     (void)mocks;
@@ -969,6 +982,9 @@ TEST_FUNCTION(IoTHubServiceClientAuth_CreateFromConnectionString_for_sharedAcces
     EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .SetReturn(0);
 
+    STRICT_EXPECTED_CALL(mocks, IoTHubSCHttpPool_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+
     set_expected_calls_for_CreateFromConnectionString_cleanup(mocks);
 
     STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
@@ -1356,6 +1372,7 @@ TEST_FUNCTION(IoTHubServiceClientAuth_CreateFromConnectionString_do_clean_up_if_
     mocks.AssertActualAndExpectedCalls();
 }
 
+/* Tests_SRS_IOTHUBSERVICECLIENT_41_001: [** IoTHubServiceClientAuth_CreateFromConnectionString shall create the HTTP connection pool shared by the service clients by calling IoTHubSCHttpPool_Create with hostName, sharedAccessKey, keyName and deviceId. **] */
 static void test_IoTHubServiceClientAuth_CreateFromConnectionString_impl(bool set_sharedaccesskeyname, bool set_deviceid)
 {
     // arrange
@@ -1419,7 +1436,10 @@ static void test_IoTHubServiceClientAuth_CreateFromConnectionString_impl(bool se
     
     EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .SetReturn(0);
-    
+
+    STRICT_EXPECTED_CALL(mocks, IoTHubSCHttpPool_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+
     set_expected_calls_for_CreateFromConnectionString_cleanup(mocks);
 
     // act
@@ -1448,6 +1468,86 @@ TEST_FUNCTION(IoTHubServiceClientAuth_CreateFromConnectionString_deviceid_set_su
     test_IoTHubServiceClientAuth_CreateFromConnectionString_impl(false, true);
 }
 
+/* Tests_SRS_IOTHUBSERVICECLIENT_41_003: [** If the IoTHubSCHttpPool_Create fails, IoTHubServiceClientAuth_CreateFromConnectionString shall do clean up and return NULL. **] */
+TEST_FUNCTION(IoTHubServiceClientAuth_CreateFromConnectionString_do_clean_up_if_IoTHubSCHttpPool_Create_fails)
+{
+    // arrange
+    CIoTHubServiceClientAuthMocks mocks;
+    
+    whenShallmalloc_fail = 0;
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    
+    STRICT_EXPECTED_CALL(mocks, STRING_construct(TEST_CHAR_PTR));
+    
+    STRICT_EXPECTED_CALL(mocks, connectionstringparser_parse(TEST_STRING_HANDLE))
+        .SetReturn(TEST_MAP_HANDLE);
+
+    STRICT_EXPECTED_CALL(mocks, Map_GetValueFromKey(TEST_MAP_HANDLE, (const char*)"SharedAccessKeyName"))
+        .SetReturn(TEST_CONST_CHAR_PTR);
+
+    STRICT_EXPECTED_CALL(mocks, Map_GetValueFromKey(TEST_MAP_HANDLE, (const char*)"DeviceId"))
+        .SetReturn(TEST_CONST_CHAR_PTR_NULL);
+    
+    STRICT_EXPECTED_CALL(mocks, Map_GetValueFromKey(TEST_MAP_HANDLE, (const char*)"HostName"))
+        .SetReturn(TEST_CONST_CHAR_PTR);
+   
+    STRICT_EXPECTED_CALL(mocks, Map_GetValueFromKey(TEST_MAP_HANDLE, (const char*)"SharedAccessKey"))
+        .SetReturn(TEST_CONST_CHAR_PTR);
+   
+    STRICT_EXPECTED_CALL(mocks, STRING_construct(TEST_CONST_CHAR_PTR));
+
+    STRICT_EXPECTED_CALL(mocks, STRING_TOKENIZER_create(TEST_STRING_HANDLE))
+        .SetReturn(TEST_STRING_TOKENIZER_HANDLE);
+    
+    STRICT_EXPECTED_CALL(mocks, STRING_new())
+        .SetReturn(TEST_STRING_HANDLE);
+    
+    STRICT_EXPECTED_CALL(mocks, STRING_new())
+        .SetReturn(TEST_STRING_HANDLE);
+    
+    STRICT_EXPECTED_CALL(mocks, STRING_TOKENIZER_get_next_token(TEST_STRING_TOKENIZER_HANDLE, TEST_STRING_HANDLE, "."))
+        .SetReturn(0);
+    
+    STRICT_EXPECTED_CALL(mocks, STRING_TOKENIZER_get_next_token(TEST_STRING_TOKENIZER_HANDLE, TEST_STRING_HANDLE, "0"))
+        .SetReturn(0);
+    
+    EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .SetReturn(0);
+    
+    EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .SetReturn(0);
+    
+    EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .SetReturn(0);
+    
+    EXPECTED_CALL(mocks, STRING_c_str(TEST_STRING_HANDLE))
+        .SetReturn(TEST_CHAR_PTR);
+    
+    EXPECTED_CALL(mocks, STRING_c_str(TEST_STRING_HANDLE))
+        .SetReturn(TEST_CHAR_PTR);
+    
+    EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .SetReturn(0);
+    
+    EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .SetReturn(0);
+
+    STRICT_EXPECTED_CALL(mocks, IoTHubSCHttpPool_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments()
+        .SetReturn(TEST_IOTHUB_SC_HTTP_POOL_HANDLE_NULL);
+
+    set_expected_calls_for_free_service_client_auth(mocks);
+    set_expected_calls_for_CreateFromConnectionString_cleanup(mocks);
+
+    // act
+    IOTHUB_SERVICE_CLIENT_AUTH_HANDLE result = IoTHubServiceClientAuth_CreateFromConnectionString(TEST_CHAR_PTR);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    mocks.AssertActualAndExpectedCalls();
+}
+
 /* Tests_SRS_IOTHUBSERVICECLIENT_12_006: [** If the IOTHUB_SERVICE_CLIENT_AUTH has been populated IoTHubServiceClientAuth_CreateFromConnectionString shall return with a IOTHUB_SERVICE_CLIENT_AUTH_HANDLE to it **]*/
 TEST_FUNCTION(IoTHubServiceClientAuth_CreateFromConnectionString_sharedaccesskeyname_and_deviceid_both_set_fails)
 {
@@ -1494,6 +1594,7 @@ TEST_FUNCTION(IoTHubServiceClient_Destroy_return_if_input_parameter_serviceClien
 }
 
 /* Tests_SRS_IOTHUBSERVICECLIENT_12_008 : [** If the serviceClientHandle input parameter is not NULL IoTHubServiceClient_Destroy shall free the memory of it and return **] */
+/* Tests_SRS_IOTHUBSERVICECLIENT_41_002: [** IoTHubServiceClient_Destroy shall release the HTTP connection pool by calling IoTHubSCHttpPool_Destroy **]*/
 TEST_FUNCTION(IoTHubServiceClient_Destroy_do_clean_up_and_return_if_input_parameter_serviceClientHandle_is_not_NULL)
 {
     // arrange
@@ -1580,6 +1681,10 @@ TEST_FUNCTION(IoTHubServiceClient_Destroy_do_clean_up_and_return_if_input_parame
         .IgnoreAllArguments()
         .SetReturn(0);
 
+    STRICT_EXPECTED_CALL(mocks, IoTHubSCHttpPool_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+
+    STRICT_EXPECTED_CALL(mocks, IoTHubSCHttpPool_Destroy(TEST_IOTHUB_SC_HTTP_POOL_HANDLE));
 
     set_expected_calls_for_free_service_client_auth(mocks);
     set_expected_calls_for_CreateFromConnectionString_cleanup(mocks);
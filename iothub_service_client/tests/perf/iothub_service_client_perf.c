@@ -0,0 +1,585 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+// Load generator for the service client: drives IoTHubRegistryManager_GetDevice_Ex, IoTHubDeviceTwin_GetTwin,
+// IoTHubDeviceTwin_UpdateTwin, IoTHubDeviceMethod_Invoke and IoTHubMessaging_LL_Send from several threads at once
+// and reports sustained ops/s, p50/p99/p999 latency and allocations per operation.
+//
+// usage: iothub_service_client_perf [-t threads[,threads...]] [-n operations_per_thread] [-d device_id]
+//                                   [-o operation[,operation...]] [results.json]
+//
+//   -t  concurrency levels to measure, every operation is run once per level (default 1,4,16)
+//   -n  measured operations per thread, each thread also runs a tenth of that as warm up (default 500, 50 against a hub)
+//   -d  device the operations target (default perf-device)
+//   -o  any of registry, twin_get, twin_update, method, messaging (default registry,twin_get,twin_update,method
+//       against the loopback, registry,twin_get against a hub since the others need a connected device)
+//
+// iothub_service_client_perf targets the hub of the IOTHUB_CONNECTION_STRING environment variable.
+// iothub_service_client_loopback_perf is the same program linked with loopback_httpapi.c, it never leaves the
+// process and is the one registered with ctest. The messaging operation runs over AMQP, which the loopback does
+// not intercept, so it is only available against a hub.
+//
+// The results are always printed as text; when a file name is given they are also written there as JSON,
+// so that two runs can be compared by CI.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/platform.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "iothub_service_client_auth.h"
+#include "iothub_registrymanager.h"
+#include "iothub_devicetwin.h"
+#include "iothub_devicemethod.h"
+#include "iothub_messaging_ll.h"
+#include "iothub_message.h"
+#include "common/perf_load.h"
+
+#define PERF_MAX_BENCHMARKS             64
+#define PERF_MAX_CONCURRENCY_LEVELS     8
+#define PERF_MAX_THREADS                256
+#define PERF_BENCHMARK_NAME_SIZE        96
+#define PERF_MESSAGING_TIMEOUT_MS       30000
+
+#ifdef PERF_LOOPBACK_HTTPAPI
+static const char* PERF_LOOPBACK_CONNECTION_STRING = "HostName=perf.azure-devices.net;SharedAccessKeyName=iothubowner;SharedAccessKey=cGVyZi1zZXJ2aWNlLWtleS1wZXJmLXNlcnZpY2Uta2V5";
+#define PERF_DEFAULT_OPERATIONS         "registry,twin_get,twin_update,method"
+#define PERF_DEFAULT_OPERATIONS_PER_THREAD 500
+#else
+#define PERF_DEFAULT_OPERATIONS         "registry,twin_get"
+#define PERF_DEFAULT_OPERATIONS_PER_THREAD 50
+#endif
+
+static const char* PERF_TWIN_PATCH = "{\"properties\":{\"desired\":{\"perfCounter\":1}}}";
+static const char* PERF_METHOD_NAME = "perf";
+static const char* PERF_METHOD_PAYLOAD = "{\"value\":1}";
+static const unsigned char PERF_MESSAGE_PAYLOAD[] = "{\"perf\":\"service client load\"}";
+
+typedef struct PERF_WORKER_CONTEXT_TAG
+{
+    const char* deviceId;
+    IOTHUB_REGISTRYMANAGER_HANDLE registryManager;
+    IOTHUB_SERVICE_CLIENT_DEVICE_TWIN_HANDLE deviceTwin;
+    IOTHUB_SERVICE_CLIENT_DEVICE_METHOD_HANDLE deviceMethod;
+    IOTHUB_MESSAGING_HANDLE messaging;
+    IOTHUB_MESSAGE_HANDLE message;
+    bool isOpened;
+    bool isSendPending;
+    IOTHUB_MESSAGING_RESULT sendResult;
+} PERF_WORKER_CONTEXT;
+
+/* creates the per thread client the benchmark needs, returns 0 on success */
+typedef int(*PERF_WORKER_SETUP)(PERF_WORKER_CONTEXT* context, IOTHUB_SERVICE_CLIENT_AUTH_HANDLE serviceClientAuth);
+
+typedef struct PERF_BENCHMARK_TAG
+{
+    const char* option;
+    const char* name;
+    PERF_WORKER_SETUP setup;
+    PERF_OPERATION operation;
+    bool needsHub;
+} PERF_BENCHMARK;
+
+typedef struct PERF_BENCHMARK_RESULT_TAG
+{
+    char name[PERF_BENCHMARK_NAME_SIZE];
+    PERF_LOAD_RESULT result;
+} PERF_BENCHMARK_RESULT;
+
+static PERF_BENCHMARK_RESULT g_results[PERF_MAX_BENCHMARKS];
+static size_t g_result_count = 0;
+
+static int setup_registry_manager(PERF_WORKER_CONTEXT* context, IOTHUB_SERVICE_CLIENT_AUTH_HANDLE serviceClientAuth)
+{
+    return ((context->registryManager = IoTHubRegistryManager_Create(serviceClientAuth)) == NULL) ? __FAILURE__ : 0;
+}
+
+static int setup_device_twin(PERF_WORKER_CONTEXT* context, IOTHUB_SERVICE_CLIENT_AUTH_HANDLE serviceClientAuth)
+{
+    return ((context->deviceTwin = IoTHubDeviceTwin_Create(serviceClientAuth)) == NULL) ? __FAILURE__ : 0;
+}
+
+static int setup_device_method(PERF_WORKER_CONTEXT* context, IOTHUB_SERVICE_CLIENT_AUTH_HANDLE serviceClientAuth)
+{
+    return ((context->deviceMethod = IoTHubDeviceMethod_Create(serviceClientAuth)) == NULL) ? __FAILURE__ : 0;
+}
+
+static void on_messaging_opened(void* userContextCallback)
+{
+    ((PERF_WORKER_CONTEXT*)userContextCallback)->isOpened = true;
+}
+
+static void on_message_sent(void* userContextCallback, IOTHUB_MESSAGING_RESULT messagingResult)
+{
+    PERF_WORKER_CONTEXT* context = (PERF_WORKER_CONTEXT*)userContextCallback;
+    context->sendResult = messagingResult;
+    context->isSendPending = false;
+}
+
+/* pumps the LL messaging handle until *flag matches expected or PERF_MESSAGING_TIMEOUT_MS elapses */
+static int wait_for_messaging(PERF_WORKER_CONTEXT* context, const bool* flag, bool expected)
+{
+    uint64_t deadline = perf_get_time_ns() + (uint64_t)PERF_MESSAGING_TIMEOUT_MS * 1000000;
+
+    IoTHubMessaging_LL_DoWork(context->messaging);
+    while ((*flag != expected) && (perf_get_time_ns() < deadline))
+    {
+        ThreadAPI_Sleep(1);
+        IoTHubMessaging_LL_DoWork(context->messaging);
+    }
+
+    return (*flag == expected) ? 0 : __FAILURE__;
+}
+
+static int setup_messaging(PERF_WORKER_CONTEXT* context, IOTHUB_SERVICE_CLIENT_AUTH_HANDLE serviceClientAuth)
+{
+    int result;
+
+    if ((context->message = IoTHubMessage_CreateFromByteArray(PERF_MESSAGE_PAYLOAD, sizeof(PERF_MESSAGE_PAYLOAD) - 1)) == NULL)
+    {
+        LogError("IoTHubMessage_CreateFromByteArray failed");
+        result = __FAILURE__;
+    }
+    else if ((context->messaging = IoTHubMessaging_LL_Create(serviceClientAuth)) == NULL)
+    {
+        LogError("IoTHubMessaging_LL_Create failed");
+        result = __FAILURE__;
+    }
+    else if (IoTHubMessaging_LL_Open(context->messaging, on_messaging_opened, context) != IOTHUB_MESSAGING_OK)
+    {
+        LogError("IoTHubMessaging_LL_Open failed");
+        result = __FAILURE__;
+    }
+    else if (wait_for_messaging(context, &context->isOpened, true) != 0)
+    {
+        LogError("timed out opening the messaging client");
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = 0;
+    }
+
+    return result;
+}
+
+static void teardown_worker(PERF_WORKER_CONTEXT* context)
+{
+    if (context->registryManager != NULL)
+    {
+        IoTHubRegistryManager_Destroy(context->registryManager);
+    }
+    if (context->deviceTwin != NULL)
+    {
+        IoTHubDeviceTwin_Destroy(context->deviceTwin);
+    }
+    if (context->deviceMethod != NULL)
+    {
+        IoTHubDeviceMethod_Destroy(context->deviceMethod);
+    }
+    if (context->messaging != NULL)
+    {
+        if (context->isOpened)
+        {
+            IoTHubMessaging_LL_Close(context->messaging);
+        }
+        IoTHubMessaging_LL_Destroy(context->messaging);
+    }
+    if (context->message != NULL)
+    {
+        IoTHubMessage_Destroy(context->message);
+    }
+    memset(context, 0, sizeof(PERF_WORKER_CONTEXT));
+}
+
+static int get_device(void* ctx)
+{
+    PERF_WORKER_CONTEXT* context = (PERF_WORKER_CONTEXT*)ctx;
+    IOTHUB_DEVICE_EX device;
+    int result;
+
+    memset(&device, 0, sizeof(device));
+    device.version = IOTHUB_DEVICE_EX_VERSION_1;
+
+    if (IoTHubRegistryManager_GetDevice_Ex(context->registryManager, context->deviceId, &device) != IOTHUB_REGISTRYMANAGER_OK)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        IoTHubRegistryManager_FreeDeviceExMembers(&device);
+        result = 0;
+    }
+
+    return result;
+}
+
+static int get_twin(void* ctx)
+{
+    PERF_WORKER_CONTEXT* context = (PERF_WORKER_CONTEXT*)ctx;
+    char* twin;
+    int result;
+
+    if ((twin = IoTHubDeviceTwin_GetTwin(context->deviceTwin, context->deviceId)) == NULL)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        free(twin);
+        result = 0;
+    }
+
+    return result;
+}
+
+static int update_twin(void* ctx)
+{
+    PERF_WORKER_CONTEXT* context = (PERF_WORKER_CONTEXT*)ctx;
+    char* twin;
+    int result;
+
+    if ((twin = IoTHubDeviceTwin_UpdateTwin(context->deviceTwin, context->deviceId, PERF_TWIN_PATCH)) == NULL)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        free(twin);
+        result = 0;
+    }
+
+    return result;
+}
+
+static int invoke_method(void* ctx)
+{
+    PERF_WORKER_CONTEXT* context = (PERF_WORKER_CONTEXT*)ctx;
+    int responseStatus;
+    unsigned char* responsePayload = NULL;
+    size_t responsePayloadSize;
+    int result;
+
+    if (IoTHubDeviceMethod_Invoke(context->deviceMethod, context->deviceId, PERF_METHOD_NAME, PERF_METHOD_PAYLOAD, 30, &responseStatus, &responsePayload, &responsePayloadSize) != IOTHUB_DEVICE_METHOD_OK)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = 0;
+    }
+
+    free(responsePayload);
+    return result;
+}
+
+static int send_message_and_confirm(void* ctx)
+{
+    PERF_WORKER_CONTEXT* context = (PERF_WORKER_CONTEXT*)ctx;
+    int result;
+
+    context->isSendPending = true;
+    if (IoTHubMessaging_LL_Send(context->messaging, context->deviceId, context->message, on_message_sent, context) != IOTHUB_MESSAGING_OK)
+    {
+        context->isSendPending = false;
+        result = __FAILURE__;
+    }
+    else if (wait_for_messaging(context, &context->isSendPending, false) != 0)
+    {
+        LogError("timed out waiting for the send confirmation");
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = (context->sendResult == IOTHUB_MESSAGING_OK) ? 0 : __FAILURE__;
+    }
+
+    return result;
+}
+
+static const PERF_BENCHMARK g_benchmarks[] =
+{
+    { "registry", "IoTHubRegistryManager_GetDevice_Ex", setup_registry_manager, get_device, false },
+    { "twin_get", "IoTHubDeviceTwin_GetTwin", setup_device_twin, get_twin, false },
+    { "twin_update", "IoTHubDeviceTwin_UpdateTwin", setup_device_twin, update_twin, false },
+    { "method", "IoTHubDeviceMethod_Invoke", setup_device_method, invoke_method, false },
+    { "messaging", "IoTHubMessaging_LL_Send + confirmation", setup_messaging, send_message_and_confirm, true }
+};
+
+static int run_benchmark(const PERF_BENCHMARK* benchmark, IOTHUB_SERVICE_CLIENT_AUTH_HANDLE serviceClientAuth, const char* deviceId, size_t threads, size_t operationsPerThread)
+{
+    int result;
+    PERF_WORKER_CONTEXT* contexts;
+    void** contextPointers;
+
+    if ((contexts = (PERF_WORKER_CONTEXT*)calloc(threads, sizeof(PERF_WORKER_CONTEXT))) == NULL)
+    {
+        LogError("Failed allocating %lu worker contexts", (unsigned long)threads);
+        result = __FAILURE__;
+    }
+    else
+    {
+        if ((contextPointers = (void**)malloc(threads * sizeof(void*))) == NULL)
+        {
+            LogError("Failed allocating %lu worker context pointers", (unsigned long)threads);
+            result = __FAILURE__;
+        }
+        else
+        {
+            size_t i;
+
+            result = 0;
+
+            /* the clients are created before the clock starts, only the operation itself is timed */
+            for (i = 0; i < threads && result == 0; i++)
+            {
+                contexts[i].deviceId = deviceId;
+                contextPointers[i] = &contexts[i];
+                if (benchmark->setup(&contexts[i], serviceClientAuth) != 0)
+                {
+                    LogError("%s: failed creating the client of worker %lu", benchmark->name, (unsigned long)i);
+                    result = __FAILURE__;
+                }
+            }
+
+            if (result == 0)
+            {
+                PERF_BENCHMARK_RESULT* benchmarkResult = (g_result_count < PERF_MAX_BENCHMARKS) ? &g_results[g_result_count] : NULL;
+                PERF_LOAD_RESULT measured;
+                char name[PERF_BENCHMARK_NAME_SIZE];
+
+                (void)snprintf(name, sizeof(name), "%s x%lu", benchmark->name, (unsigned long)threads);
+
+                /* the result is recorded even when some runs failed, throttling under load is a result too */
+                result = perf_run_load(name, threads, operationsPerThread, benchmark->operation, contextPointers, &measured);
+                if (benchmarkResult != NULL)
+                {
+                    (void)strcpy(benchmarkResult->name, name);
+                    benchmarkResult->result = measured;
+                    g_result_count++;
+                }
+            }
+
+            for (i = 0; i < threads; i++)
+            {
+                teardown_worker(&contexts[i]);
+            }
+
+            free(contextPointers);
+        }
+
+        free(contexts);
+    }
+
+    return result;
+}
+
+static int write_json_results(const char* fileName)
+{
+    int result;
+    FILE* file;
+
+    if ((file = fopen(fileName, "w")) == NULL)
+    {
+        LogError("Failed opening %s", fileName);
+        result = __FAILURE__;
+    }
+    else
+    {
+        size_t i;
+
+        (void)fprintf(file, "{\n    \"benchmarks\": [\n");
+        for (i = 0; i < g_result_count; i++)
+        {
+            const PERF_LOAD_RESULT* measured = &g_results[i].result;
+
+            (void)fprintf(file, "        { \"name\": \"%s\", \"threads\": %lu, \"operations\": %lu, \"failures\": %lu, \"ops_per_second\": %.1f, \"p50_ns\": %lu, \"p99_ns\": %lu, \"p999_ns\": %lu, \"max_ns\": %lu, ",
+                g_results[i].name, (unsigned long)measured->threads, (unsigned long)measured->operations, (unsigned long)measured->failures, measured->ops_per_second,
+                (unsigned long)measured->p50_ns, (unsigned long)measured->p99_ns, (unsigned long)measured->p999_ns, (unsigned long)measured->max_ns);
+            if (measured->allocations_per_op < 0)
+            {
+                (void)fprintf(file, "\"allocations_per_op\": null }");
+            }
+            else
+            {
+                (void)fprintf(file, "\"allocations_per_op\": %.2f }", measured->allocations_per_op);
+            }
+            (void)fprintf(file, "%s\n", (i + 1 < g_result_count) ? "," : "");
+        }
+        (void)fprintf(file, "    ]\n}\n");
+
+        result = (fclose(file) == 0) ? 0 : __FAILURE__;
+    }
+
+    return result;
+}
+
+/* parses "1,4,16" into levels, returns the number of levels or 0 if the list is invalid */
+static size_t parse_concurrency_levels(const char* list, size_t* levels)
+{
+    size_t count = 0;
+    const char* current = list;
+
+    while (*current != '\0')
+    {
+        char* end;
+        unsigned long value = strtoul(current, &end, 10);
+
+        if ((end == current) || (value == 0) || (value > PERF_MAX_THREADS) || (count == PERF_MAX_CONCURRENCY_LEVELS) || ((*end != ',') && (*end != '\0')))
+        {
+            count = 0;
+            break;
+        }
+
+        levels[count++] = (size_t)value;
+        current = (*end == ',') ? end + 1 : end;
+    }
+
+    return count;
+}
+
+/* true if option is one of the comma separated entries of list */
+static bool is_operation_selected(const char* list, const char* option)
+{
+    size_t optionLength = strlen(option);
+    const char* current = list;
+    bool result = false;
+
+    while (current != NULL && !result)
+    {
+        const char* end = strchr(current, ',');
+        size_t length = (end == NULL) ? strlen(current) : (size_t)(end - current);
+
+        result = (length == optionLength) && (strncmp(current, option, length) == 0);
+        current = (end == NULL) ? NULL : end + 1;
+    }
+
+    return result;
+}
+
+static void print_usage(const char* program)
+{
+    (void)printf("usage: %s [-t threads[,threads...]] [-n operations_per_thread] [-d device_id] [-o operation[,operation...]] [results.json]\r\n", program);
+    (void)printf("operations: registry, twin_get, twin_update, method, messaging\r\n");
+}
+
+int main(int argc, char** argv)
+{
+    int result;
+    size_t levels[PERF_MAX_CONCURRENCY_LEVELS] = { 1, 4, 16 };
+    size_t levelCount = 3;
+    size_t operationsPerThread = PERF_DEFAULT_OPERATIONS_PER_THREAD;
+    const char* deviceId = "perf-device";
+    const char* operations = PERF_DEFAULT_OPERATIONS;
+    const char* resultsFileName = NULL;
+    const char* connectionString;
+    int i;
+
+    result = 0;
+    for (i = 1; i < argc && result == 0; i++)
+    {
+        if ((argv[i][0] == '-') && (i + 1 < argc))
+        {
+            char option = argv[i][1];
+            const char* value = argv[++i];
+
+            switch (option)
+            {
+            case 't':
+                result = ((levelCount = parse_concurrency_levels(value, levels)) == 0) ? __FAILURE__ : 0;
+                break;
+            case 'n':
+                result = ((operationsPerThread = (size_t)strtoul(value, NULL, 10)) == 0) ? __FAILURE__ : 0;
+                break;
+            case 'd':
+                deviceId = value;
+                break;
+            case 'o':
+                operations = value;
+                break;
+            default:
+                result = __FAILURE__;
+                break;
+            }
+        }
+        else if ((argv[i][0] != '-') && (resultsFileName == NULL))
+        {
+            resultsFileName = argv[i];
+        }
+        else
+        {
+            result = __FAILURE__;
+        }
+    }
+
+#ifdef PERF_LOOPBACK_HTTPAPI
+    connectionString = PERF_LOOPBACK_CONNECTION_STRING;
+#else
+    connectionString = getenv("IOTHUB_CONNECTION_STRING");
+#endif
+
+    if (result != 0)
+    {
+        print_usage(argv[0]);
+    }
+    else if (connectionString == NULL)
+    {
+        LogError("IOTHUB_CONNECTION_STRING is not set");
+        result = __FAILURE__;
+    }
+    else if (platform_init() != 0)
+    {
+        LogError("platform_init failed");
+        result = __FAILURE__;
+    }
+    else
+    {
+        IOTHUB_SERVICE_CLIENT_AUTH_HANDLE serviceClientAuth;
+
+        if ((serviceClientAuth = IoTHubServiceClientAuth_CreateFromConnectionString(connectionString)) == NULL)
+        {
+            LogError("IoTHubServiceClientAuth_CreateFromConnectionString failed");
+            result = __FAILURE__;
+        }
+        else
+        {
+            size_t benchmark;
+            size_t level;
+
+            for (benchmark = 0; benchmark < sizeof(g_benchmarks) / sizeof(g_benchmarks[0]); benchmark++)
+            {
+                if (!is_operation_selected(operations, g_benchmarks[benchmark].option))
+                {
+                    /* not requested */
+                }
+#ifdef PERF_LOOPBACK_HTTPAPI
+                else if (g_benchmarks[benchmark].needsHub)
+                {
+                    (void)printf("%-40s skipped, needs a hub\r\n", g_benchmarks[benchmark].name);
+                }
+#endif
+                else
+                {
+                    for (level = 0; level < levelCount; level++)
+                    {
+                        result |= run_benchmark(&g_benchmarks[benchmark], serviceClientAuth, deviceId, levels[level], operationsPerThread);
+                    }
+                }
+            }
+
+            if ((resultsFileName != NULL) && (write_json_results(resultsFileName) != 0))
+            {
+                result = __FAILURE__;
+            }
+
+            IoTHubServiceClientAuth_Destroy(serviceClientAuth);
+        }
+
+        platform_deinit();
+    }
+
+    return result;
+}
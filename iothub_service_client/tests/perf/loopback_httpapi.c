@@ -0,0 +1,161 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+// HTTPAPI implementation that answers every request locally with a canned IoT Hub response.
+//
+// Linked into iothub_service_client_loopback_perf ahead of the static aziotsharedutil library, so
+// HTTPAPIEX resolves its HTTPAPI_* calls here instead of in the platform HTTP stack. This isolates the
+// cost of the service client (request building, SAS tokens, JSON parsing) from TLS, sockets and the hub.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "azure_c_shared_utility/httpapi.h"
+#include "azure_c_shared_utility/buffer_.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+static const char* LOOPBACK_DEVICE_JSON =
+    "{\"deviceId\":\"perf-device\",\"generationId\":\"636000000000000000\",\"etag\":\"MA==\","
+    "\"connectionState\":\"Disconnected\",\"status\":\"enabled\",\"statusReason\":null,"
+    "\"connectionStateUpdatedTime\":\"0001-01-01T00:00:00\",\"statusUpdatedTime\":\"0001-01-01T00:00:00\","
+    "\"lastActivityTime\":\"0001-01-01T00:00:00\",\"cloudToDeviceMessageCount\":0,"
+    "\"authentication\":{\"symmetricKey\":{\"primaryKey\":\"cGVyZi1wcmltYXJ5LWtleQ==\",\"secondaryKey\":\"cGVyZi1zZWNvbmRhcnkta2V5\"},"
+    "\"x509Thumbprint\":{\"primaryThumbprint\":null,\"secondaryThumbprint\":null},\"type\":\"sas\"},"
+    "\"capabilities\":{\"iotEdge\":false}}";
+
+static const char* LOOPBACK_TWIN_JSON =
+    "{\"deviceId\":\"perf-device\",\"etag\":\"AAAAAAAAAAE=\",\"version\":2,\"status\":\"enabled\","
+    "\"properties\":{\"desired\":{\"telemetryInterval\":30,\"$metadata\":{\"$lastUpdated\":\"0001-01-01T00:00:00Z\"},\"$version\":1},"
+    "\"reported\":{\"firmware\":\"1.0.0\",\"$metadata\":{\"$lastUpdated\":\"0001-01-01T00:00:00Z\"},\"$version\":1}}}";
+
+static const char* LOOPBACK_METHOD_RESPONSE_JSON = "{\"status\":200,\"payload\":{\"result\":\"ok\"}}";
+
+/* every connection is the same stateless responder, the handle only has to be non NULL */
+static int g_loopback_connection;
+
+HTTPAPI_RESULT HTTPAPI_Init(void)
+{
+    return HTTPAPI_OK;
+}
+
+void HTTPAPI_Deinit(void)
+{
+}
+
+HTTP_HANDLE HTTPAPI_CreateConnection(const char* hostName)
+{
+    HTTP_HANDLE result;
+
+    if (hostName == NULL)
+    {
+        LogError("Invalid argument hostName=NULL");
+        result = NULL;
+    }
+    else
+    {
+        result = (HTTP_HANDLE)&g_loopback_connection;
+    }
+
+    return result;
+}
+
+void HTTPAPI_CloseConnection(HTTP_HANDLE handle)
+{
+    (void)handle;
+}
+
+static const char* get_response_content(HTTPAPI_REQUEST_TYPE requestType, const char* relativePath, unsigned int* statusCode)
+{
+    const char* result;
+
+    if (strncmp(relativePath, "/twins/", 7) == 0)
+    {
+        if (strstr(relativePath, "/methods") != NULL)
+        {
+            *statusCode = 200;
+            result = LOOPBACK_METHOD_RESPONSE_JSON;
+        }
+        else
+        {
+            *statusCode = 200;
+            result = LOOPBACK_TWIN_JSON;
+        }
+    }
+    else if (strncmp(relativePath, "/devices/query", 14) == 0)
+    {
+        *statusCode = 200;
+        result = "[]";
+    }
+    else if (strncmp(relativePath, "/devices/", 9) == 0)
+    {
+        if (requestType == HTTPAPI_REQUEST_DELETE)
+        {
+            *statusCode = 204;
+            result = NULL;
+        }
+        else
+        {
+            *statusCode = 200;
+            result = LOOPBACK_DEVICE_JSON;
+        }
+    }
+    else
+    {
+        *statusCode = 404;
+        result = NULL;
+    }
+
+    return result;
+}
+
+HTTPAPI_RESULT HTTPAPI_ExecuteRequest(HTTP_HANDLE handle, HTTPAPI_REQUEST_TYPE requestType, const char* relativePath,
+    HTTP_HEADERS_HANDLE httpHeadersHandle, const unsigned char* content,
+    size_t contentLength, unsigned int* statusCode,
+    HTTP_HEADERS_HANDLE responseHeadersHandle, BUFFER_HANDLE responseContent)
+{
+    HTTPAPI_RESULT result;
+
+    (void)httpHeadersHandle;
+    (void)content;
+    (void)contentLength;
+    (void)responseHeadersHandle;
+
+    if (handle == NULL || relativePath == NULL || statusCode == NULL)
+    {
+        LogError("Invalid argument (handle=%p, relativePath=%p, statusCode=%p)", handle, relativePath, statusCode);
+        result = HTTPAPI_INVALID_ARG;
+    }
+    else
+    {
+        const char* response = get_response_content(requestType, relativePath, statusCode);
+
+        if ((response != NULL) && (responseContent != NULL) &&
+            (BUFFER_build(responseContent, (const unsigned char*)response, strlen(response)) != 0))
+        {
+            LogError("BUFFER_build failed");
+            result = HTTPAPI_ALLOC_FAILED;
+        }
+        else
+        {
+            result = HTTPAPI_OK;
+        }
+    }
+
+    return result;
+}
+
+HTTPAPI_RESULT HTTPAPI_SetOption(HTTP_HANDLE handle, const char* optionName, const void* value)
+{
+    (void)handle;
+    (void)optionName;
+    (void)value;
+    return HTTPAPI_OK;
+}
+
+HTTPAPI_RESULT HTTPAPI_CloneOption(const char* optionName, const void* value, const void** savedValue)
+{
+    (void)optionName;
+    (void)value;
+    (void)savedValue;
+    return HTTPAPI_INVALID_ARG;
+}
@@ -53,6 +53,8 @@ typedef struct HSM_CLIENT_HTTP_EDGE
     int   workload_portnumber;
     char* edge_module_generation_id;
     char* module_id;
+    HTTP_CLIENT_HANDLE http_handle;                 // workload connection kept open between requests, NULL until the first one
+    HSM_HTTP_WORKLOAD_CONTEXT workload_context;
 } HSM_CLIENT_HTTP_EDGE;
 
 static const char http_prefix[] = "http://";
@@ -200,6 +202,15 @@ static int initialize_http_edge_device(HSM_CLIENT_HTTP_EDGE* hsm_client_http_edg
     return result;
 }
 
+static void close_workload_connection(HSM_CLIENT_HTTP_EDGE* hsm_client_http_edge)
+{
+    if (hsm_client_http_edge->http_handle != NULL)
+    {
+        uhttp_client_close(hsm_client_http_edge->http_handle, NULL, NULL);
+        uhttp_client_destroy(hsm_client_http_edge->http_handle);
+        hsm_client_http_edge->http_handle = NULL;
+    }
+}
 
 HSM_CLIENT_HANDLE hsm_client_http_edge_create()
 {
@@ -228,6 +239,7 @@ void hsm_client_http_edge_destroy(HSM_CLIENT_HANDLE handle)
     if (handle != NULL)
     {
         HSM_CLIENT_HTTP_EDGE* hsm_client_http_edge = (HSM_CLIENT_HTTP_EDGE*)handle;
+        close_workload_connection(hsm_client_http_edge);
         free(hsm_client_http_edge->workload_hostname);
         free(hsm_client_http_edge->edge_module_generation_id);
         free(hsm_client_http_edge->module_id);
@@ -435,38 +447,57 @@ static int send_request_to_edge_workload(HTTP_CLIENT_HANDLE http_handle, HTTP_HE
     return (workload_context->http_response != NULL) ? 0 : __FAILURE__;
 }
 
-static BUFFER_HANDLE send_http_workload_request(HSM_CLIENT_HTTP_EDGE* hsm_client_http_edge, const char* uri_path, BUFFER_HANDLE json_to_send)
+static int open_workload_connection(HSM_CLIENT_HTTP_EDGE* hsm_client_http_edge)
 {
     int result;
-    HTTP_CLIENT_HANDLE http_handle = NULL;
-    HTTP_HEADERS_HANDLE http_headers_handle = NULL;
-
     HTTP_CLIENT_RESULT http_open_result;
-    HTTP_HEADERS_RESULT http_headers_result;
 
     SOCKETIO_CONFIG config;
     config.accepted_socket = NULL;
     config.hostname = hsm_client_http_edge->workload_hostname;
     config.port = hsm_client_http_edge->workload_portnumber;
 
-    HSM_HTTP_WORKLOAD_CONTEXT workload_context;
-    workload_context.continue_running = true;
-    workload_context.http_response = NULL;
-
-    if ((http_handle = uhttp_client_create(socketio_get_interface_description(), &config, on_edge_hsm_http_error, &workload_context)) == NULL)
+    if ((hsm_client_http_edge->http_handle = uhttp_client_create(socketio_get_interface_description(), &config, on_edge_hsm_http_error, &hsm_client_http_edge->workload_context)) == NULL)
     {
         LogError("uhttp_client_create failed");
         result = __FAILURE__;
     }
     else if ((hsm_client_http_edge->workload_protocol_type == WORKLOAD_PROTOCOL_TYPE_UNIX_DOMAIN_SOCKET) &&
-             (uhttp_client_set_option(http_handle, OPTION_ADDRESS_TYPE, OPTION_ADDRESS_TYPE_DOMAIN_SOCKET) != 0))
+             (uhttp_client_set_option(hsm_client_http_edge->http_handle, OPTION_ADDRESS_TYPE, OPTION_ADDRESS_TYPE_DOMAIN_SOCKET) != 0))
     {
         LogError("setting unix domain socket option failed");
+        uhttp_client_destroy(hsm_client_http_edge->http_handle);
+        hsm_client_http_edge->http_handle = NULL;
         result = __FAILURE__;
     }
-    else if ((http_open_result = uhttp_client_open(http_handle, hsm_client_http_edge->workload_hostname, hsm_client_http_edge->workload_portnumber, on_edge_hsm_http_connected, &workload_context) != HTTP_CLIENT_OK) != HTTP_CLIENT_OK)
+    else if ((http_open_result = uhttp_client_open(hsm_client_http_edge->http_handle, hsm_client_http_edge->workload_hostname, hsm_client_http_edge->workload_portnumber, on_edge_hsm_http_connected, &hsm_client_http_edge->workload_context)) != HTTP_CLIENT_OK)
     {
         LogError("uhttp_client_open failed, err=%d", http_open_result);
+        uhttp_client_destroy(hsm_client_http_edge->http_handle);
+        hsm_client_http_edge->http_handle = NULL;
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = 0;
+    }
+
+    return result;
+}
+
+static BUFFER_HANDLE send_workload_request_on_connection(HSM_CLIENT_HTTP_EDGE* hsm_client_http_edge, const char* uri_path, BUFFER_HANDLE json_to_send)
+{
+    int result;
+    HTTP_HEADERS_HANDLE http_headers_handle = NULL;
+    HTTP_HEADERS_RESULT http_headers_result;
+    HSM_HTTP_WORKLOAD_CONTEXT* workload_context = &hsm_client_http_edge->workload_context;
+
+    workload_context->continue_running = true;
+    workload_context->http_response = NULL;
+
+    if ((hsm_client_http_edge->http_handle == NULL) && (open_workload_connection(hsm_client_http_edge) != 0))
+    {
+        LogError("open_workload_connection failed");
         result = __FAILURE__;
     }
     else if ((json_to_send != NULL) && ((http_headers_handle = HTTPHeaders_Alloc()) == NULL))
@@ -479,7 +510,7 @@ static BUFFER_HANDLE send_http_workload_request(HSM_CLIENT_HTTP_EDGE* hsm_client
         LogError("HTTPHeaders_AddHeaderNameValuePair failed, error=%d", http_headers_result);
         result = __FAILURE__;
     }
-    else if (send_request_to_edge_workload(http_handle, http_headers_handle, uri_path, json_to_send, &workload_context) != 0)
+    else if (send_request_to_edge_workload(hsm_client_http_edge->http_handle, http_headers_handle, uri_path, json_to_send, workload_context) != 0)
     {
         LogError("send_request_to_edge_workload failed");
         result = __FAILURE__;
@@ -490,16 +521,33 @@ static BUFFER_HANDLE send_http_workload_request(HSM_CLIENT_HTTP_EDGE* hsm_client
     }
 
     HTTPHeaders_Free(http_headers_handle);
-    uhttp_client_close(http_handle, NULL, NULL);
-    uhttp_client_destroy(http_handle);
 
     if (result != 0)
     {
-        BUFFER_delete(workload_context.http_response);
-        workload_context.http_response = NULL;
+        BUFFER_delete(workload_context->http_response);
+        workload_context->http_response = NULL;
+        // A late reply would be read as the answer of the next request, so never reuse a failed connection
+        close_workload_connection(hsm_client_http_edge);
     }
 
-    return workload_context.http_response;
+    return workload_context->http_response;
+}
+
+// The connection to the workload API stays open so that token renewal does not pay
+// for a new connection to the security daemon every time
+static BUFFER_HANDLE send_http_workload_request(HSM_CLIENT_HTTP_EDGE* hsm_client_http_edge, const char* uri_path, BUFFER_HANDLE json_to_send)
+{
+    BUFFER_HANDLE result;
+    bool is_connection_reused = (hsm_client_http_edge->http_handle != NULL);
+
+    if (((result = send_workload_request_on_connection(hsm_client_http_edge, uri_path, json_to_send)) == NULL) && is_connection_reused)
+    {
+        // The daemon may have closed the connection since the previous request
+        LogInfo("Workload request failed on the open connection, retrying on a new one");
+        result = send_workload_request_on_connection(hsm_client_http_edge, uri_path, json_to_send);
+    }
+
+    return result;
 }
 
 
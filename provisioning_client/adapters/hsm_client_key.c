@@ -2,11 +2,16 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
 #include <stdlib.h>
+#include <string.h>
 #include "azure_c_shared_utility/umock_c_prod.h"
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/urlencode.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/crt_abstractions.h"
+#include "azure_c_shared_utility/base64.h"
+#include "azure_c_shared_utility/buffer_.h"
+#include "azure_c_shared_utility/strings.h"
+#include "azure_c_shared_utility/sha.h"
 
 #include "hsm_client_data.h"
 #include "hsm_client_key.h"
@@ -17,6 +22,108 @@ typedef struct HSM_CLIENT_KEY_INFO_TAG
     char* registration_name;
 } HSM_CLIENT_KEY_INFO;
 
+typedef struct DERIVED_KEY_ENTRY_TAG
+{
+    char* registration_id;      // followed in the same allocation by derived_key
+    char* derived_key;
+    struct DERIVED_KEY_ENTRY_TAG* next;
+} DERIVED_KEY_ENTRY;
+
+typedef struct HSM_CLIENT_KEY_GROUP_INFO_TAG
+{
+    HMACContext key_schedule;   // HMAC-SHA256 state once the decoded group key pads are hashed
+    size_t cache_size;
+    size_t cache_count;
+    DERIVED_KEY_ENTRY* cache;   // most recently used first
+} HSM_CLIENT_KEY_GROUP_INFO;
+
+static void free_derived_key_entry(DERIVED_KEY_ENTRY* entry)
+{
+    // Don't leave the device key behind in freed memory
+    (void)memset(entry->derived_key, 0, strlen(entry->derived_key));
+    free(entry);
+}
+
+static DERIVED_KEY_ENTRY* find_derived_key(HSM_CLIENT_KEY_GROUP_INFO* group_info, const char* registration_id)
+{
+    DERIVED_KEY_ENTRY* result = group_info->cache;
+    DERIVED_KEY_ENTRY* previous = NULL;
+    while (result != NULL && strcmp(result->registration_id, registration_id) != 0)
+    {
+        previous = result;
+        result = result->next;
+    }
+
+    if (result != NULL && previous != NULL)
+    {
+        previous->next = result->next;
+        result->next = group_info->cache;
+        group_info->cache = result;
+    }
+    return result;
+}
+
+static void add_derived_key(HSM_CLIENT_KEY_GROUP_INFO* group_info, DERIVED_KEY_ENTRY* entry)
+{
+    entry->next = group_info->cache;
+    group_info->cache = entry;
+    group_info->cache_count++;
+
+    if (group_info->cache_count > group_info->cache_size)
+    {
+        DERIVED_KEY_ENTRY* last = entry;
+        while (last->next->next != NULL)
+        {
+            last = last->next;
+        }
+        free_derived_key_entry(last->next);
+        last->next = NULL;
+        group_info->cache_count--;
+    }
+}
+
+static DERIVED_KEY_ENTRY* derive_key(HSM_CLIENT_KEY_GROUP_INFO* group_info, const char* registration_id)
+{
+    DERIVED_KEY_ENTRY* result;
+    HMACContext derive_context = group_info->key_schedule;
+    uint8_t derived_hash[USHAMaxHashSize];
+    STRING_HANDLE encoded_key;
+
+    if ((hmacInput(&derive_context, (const unsigned char*)registration_id, (int)strlen(registration_id)) != shaSuccess) ||
+        (hmacResult(&derive_context, derived_hash) != shaSuccess))
+    {
+        LogError("Failure computing the HMAC of %s", registration_id);
+        result = NULL;
+    }
+    else if ((encoded_key = Base64_Encode_Bytes(derived_hash, SHA256HashSize)) == NULL)
+    {
+        LogError("Failure encoding the key of %s", registration_id);
+        result = NULL;
+    }
+    else
+    {
+        size_t registration_id_size = strlen(registration_id) + 1;
+        const char* key_value = STRING_c_str(encoded_key);
+        size_t key_size = strlen(key_value) + 1;
+
+        if ((result = (DERIVED_KEY_ENTRY*)malloc(sizeof(DERIVED_KEY_ENTRY) + registration_id_size + key_size)) == NULL)
+        {
+            LogError("Failure allocating the key of %s", registration_id);
+        }
+        else
+        {
+            result->registration_id = (char*)(result + 1);
+            (void)memcpy(result->registration_id, registration_id, registration_id_size);
+            result->derived_key = result->registration_id + registration_id_size;
+            (void)memcpy(result->derived_key, key_value, key_size);
+            result->next = NULL;
+        }
+        STRING_delete(encoded_key);
+    }
+    (void)memset(derived_hash, 0, sizeof(derived_hash));
+    return result;
+}
+
 HSM_CLIENT_HANDLE hsm_client_key_create(void)
 {
     HSM_CLIENT_KEY_INFO* result;
@@ -136,6 +243,95 @@ int hsm_client_set_key_info(HSM_CLIENT_HANDLE handle, const char* reg_name, cons
     return result;
 }
 
+HSM_CLIENT_KEY_GROUP_HANDLE hsm_client_key_group_create(const char* group_key, size_t cache_size)
+{
+    HSM_CLIENT_KEY_GROUP_INFO* result;
+    BUFFER_HANDLE decoded_key;
+
+    if (group_key == NULL)
+    {
+        LogError("Invalid parameter specified group_key: %p", group_key);
+        result = NULL;
+    }
+    else if ((result = (HSM_CLIENT_KEY_GROUP_INFO*)malloc(sizeof(HSM_CLIENT_KEY_GROUP_INFO))) == NULL)
+    {
+        LogError("Failure: malloc HSM_CLIENT_KEY_GROUP_INFO.");
+    }
+    else if ((decoded_key = Base64_Decoder(group_key)) == NULL)
+    {
+        LogError("Failure decoding the group key");
+        free(result);
+        result = NULL;
+    }
+    else
+    {
+        memset(result, 0, sizeof(HSM_CLIENT_KEY_GROUP_INFO));
+        if (hmacReset(&result->key_schedule, SHA256, BUFFER_u_char(decoded_key), (int)BUFFER_length(decoded_key)) != shaSuccess)
+        {
+            LogError("Failure computing the group key pads");
+            free(result);
+            result = NULL;
+        }
+        else
+        {
+            result->cache_size = cache_size;
+        }
+        (void)memset(BUFFER_u_char(decoded_key), 0, BUFFER_length(decoded_key));
+        BUFFER_delete(decoded_key);
+    }
+    return result;
+}
+
+void hsm_client_key_group_destroy(HSM_CLIENT_KEY_GROUP_HANDLE handle)
+{
+    if (handle != NULL)
+    {
+        while (handle->cache != NULL)
+        {
+            DERIVED_KEY_ENTRY* entry = handle->cache;
+            handle->cache = entry->next;
+            free_derived_key_entry(entry);
+        }
+        (void)memset(&handle->key_schedule, 0, sizeof(handle->key_schedule));
+        free(handle);
+    }
+}
+
+char* hsm_client_key_group_derive_key(HSM_CLIENT_KEY_GROUP_HANDLE handle, const char* registration_id)
+{
+    char* result;
+    DERIVED_KEY_ENTRY* entry;
+
+    if (handle == NULL || registration_id == NULL)
+    {
+        LogError("Invalid parameter specified handle: %p, registration_id: %p", handle, registration_id);
+        result = NULL;
+    }
+    else if ((entry = find_derived_key(handle, registration_id)) == NULL && (entry = derive_key(handle, registration_id)) == NULL)
+    {
+        LogError("Failure deriving the key of %s", registration_id);
+        result = NULL;
+    }
+    else
+    {
+        if (mallocAndStrcpy_s(&result, entry->derived_key) != 0)
+        {
+            LogError("Failure allocating the key of %s", registration_id);
+            result = NULL;
+        }
+
+        if (handle->cache_size == 0)
+        {
+            free_derived_key_entry(entry);
+        }
+        else if (entry != handle->cache)
+        {
+            add_derived_key(handle, entry);
+        }
+    }
+    return result;
+}
+
 static const HSM_CLIENT_KEY_INTERFACE key_interface =
 {
     hsm_client_key_create,
@@ -20,6 +20,16 @@ MOCKABLE_FUNCTION(, char*, hsm_client_get_symmetric_key, HSM_CLIENT_HANDLE, hand
 MOCKABLE_FUNCTION(, char*, hsm_client_get_registration_name, HSM_CLIENT_HANDLE, handle);
 MOCKABLE_FUNCTION(, int, hsm_client_set_key_info, HSM_CLIENT_HANDLE, handle, const char*, reg_name, const char*, symm_key);
 
+// Derives the device keys of an enrollment group, each the base64 HMAC-SHA256 of the registration id keyed with
+// the group key.  The group key is decoded and its HMAC pads hashed once when the group is created, deriving a
+// device key then costs a single HMAC and the last cache_size derived keys are kept for devices registering again.
+typedef struct HSM_CLIENT_KEY_GROUP_INFO_TAG* HSM_CLIENT_KEY_GROUP_HANDLE;
+
+MOCKABLE_FUNCTION(, HSM_CLIENT_KEY_GROUP_HANDLE, hsm_client_key_group_create, const char*, group_key, size_t, cache_size);
+MOCKABLE_FUNCTION(, void, hsm_client_key_group_destroy, HSM_CLIENT_KEY_GROUP_HANDLE, handle);
+// Returns a copy of the device key that the caller frees, to be given to prov_dev_set_symmetric_key_info
+MOCKABLE_FUNCTION(, char*, hsm_client_key_group_derive_key, HSM_CLIENT_KEY_GROUP_HANDLE, handle, const char*, registration_id);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
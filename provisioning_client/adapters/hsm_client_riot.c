@@ -2,6 +2,8 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
 #include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
 #include "azure_c_shared_utility/umock_c_prod.h"
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/urlencode.h"
@@ -114,6 +116,9 @@ typedef enum CERTIFICATE_SIGNING_TYPE_TAG
 
 typedef struct HSM_CLIENT_X509_INFO_TAG
 {
+    // Digest of the CDI and FWID the keys below were derived from
+    uint8_t measurement[RIOT_DIGEST_LENGTH];
+
     // In Riot these are call the device Id pub and pri
     RIOT_ECC_PUBLIC     device_id_pub;
     RIOT_ECC_PRIVATE    device_id_priv;
@@ -124,8 +129,6 @@ typedef struct HSM_CLIENT_X509_INFO_TAG
     RIOT_ECC_PUBLIC     ca_root_pub;
     RIOT_ECC_PRIVATE    ca_root_priv;
 
-    char* certificate_common_name;
-
     uint32_t device_id_length;
     char device_id_public_pem[DER_MAX_PEM];
 
@@ -144,8 +147,14 @@ typedef struct HSM_CLIENT_X509_INFO_TAG
     uint32_t root_ca_priv_length;
     char root_ca_priv_pem[DER_MAX_PEM];
 
+    // Everything above is what goes into the key cache, keep this last
+    char* certificate_common_name;
 } HSM_CLIENT_X509_INFO;
 
+#define RIOT_KEY_INFO_CACHE_SIZE    offsetof(HSM_CLIENT_X509_INFO, certificate_common_name)
+
+static HSM_CLIENT_RIOT_KEY_CACHE g_key_cache = { 0 };
+
 static const HSM_CLIENT_X509_INTERFACE x509_interface =
 {
     hsm_client_riot_create,
@@ -386,43 +395,66 @@ static int produce_device_id_public(HSM_CLIENT_X509_INFO* riot_info)
     return result;
 }
 
-static int process_riot_key_info(HSM_CLIENT_X509_INFO* riot_info)
+static bool is_cached_key_info_valid(const HSM_CLIENT_X509_INFO* riot_info, const uint8_t* measurement)
 {
-    int result;
-    RIOT_STATUS status;
+    bool result;
+    if (memcmp(riot_info->measurement, measurement, RIOT_DIGEST_LENGTH) != 0)
+    {
+        LogInfo("Cached riot key info was derived from a different measurement, regenerating");
+        result = false;
+    }
+    else if (riot_info->device_id_length > DER_MAX_PEM || riot_info->device_signed_length > DER_MAX_PEM ||
+        riot_info->alias_key_length > DER_MAX_PEM || riot_info->alias_cert_length > DER_MAX_PEM ||
+        riot_info->root_ca_length > DER_MAX_PEM || riot_info->root_ca_priv_length > DER_MAX_PEM)
+    {
+        LogError("Cached riot key info is corrupt, regenerating");
+        result = false;
+    }
+    else
+    {
+        result = true;
+    }
+    return result;
+}
 
-    /* Codes_SRS_HSM_CLIENT_RIOT_07_002: [ hsm_client_riot_create shall call into the RIot code to sign the RIoT certificate. ] */
-    // Don't use CDI directly
-    if (g_digest_initialized == 0)
+static bool load_cached_key_info(HSM_CLIENT_X509_INFO* riot_info, const uint8_t* measurement)
+{
+    bool result;
+    if (g_key_cache.load_key_info == NULL)
     {
-        LogError("Failure: secure_device_init was not called.");
-        result = __FAILURE__;
+        result = false;
     }
-    else if (X509_ALIAS_TBS_DATA.SubjectCommon == NULL || strlen(X509_ALIAS_TBS_DATA.SubjectCommon) == 0)
+    else if (g_key_cache.load_key_info(measurement, RIOT_DIGEST_LENGTH, (unsigned char*)riot_info, RIOT_KEY_INFO_CACHE_SIZE, g_key_cache.user_context) != 0)
     {
-        LogError("Failure: The AX509_ALIAS_TBS_DATA.SubjectCommon is not entered");
-        result = __FAILURE__;
+        memset(riot_info, 0, RIOT_KEY_INFO_CACHE_SIZE);
+        result = false;
     }
-    else if ((status = RiotCrypt_Hash(g_digest, RIOT_DIGEST_LENGTH, g_CDI, DICE_DIGEST_LENGTH)) != RIOT_SUCCESS)
+    else if (!is_cached_key_info_valid(riot_info, measurement))
     {
-        LogError("Failure: RiotCrypt_Hash returned invalid status %d.", status);
-        result = __FAILURE__;
+        memset(riot_info, 0, RIOT_KEY_INFO_CACHE_SIZE);
+        result = false;
     }
-    else if ((status = RiotCrypt_DeriveEccKey(&riot_info->device_id_pub, &riot_info->device_id_priv,
-        g_digest, DICE_DIGEST_LENGTH, (const uint8_t*)RIOT_LABEL_IDENTITY, lblSize(RIOT_LABEL_IDENTITY))) != RIOT_SUCCESS)
+    else
     {
-        LogError("Failure: RiotCrypt_DeriveEccKey returned invalid status %d.", status);
-        result = __FAILURE__;
+        result = true;
     }
-    // Combine CDI and FWID, result in digest
-    else if ((status = RiotCrypt_Hash2(g_digest, DICE_DIGEST_LENGTH, g_digest, DICE_DIGEST_LENGTH, firmware_id, RIOT_DIGEST_LENGTH)) != RIOT_SUCCESS)
+    return result;
+}
+
+static int generate_riot_key_info(HSM_CLIENT_X509_INFO* riot_info)
+{
+    int result;
+    RIOT_STATUS status;
+
+    if ((status = RiotCrypt_DeriveEccKey(&riot_info->device_id_pub, &riot_info->device_id_priv,
+        g_digest, DICE_DIGEST_LENGTH, (const uint8_t*)RIOT_LABEL_IDENTITY, lblSize(RIOT_LABEL_IDENTITY))) != RIOT_SUCCESS)
     {
-        LogError("Failure: RiotCrypt_Hash2 returned invalid status %d.", status);
+        LogError("Failure: RiotCrypt_DeriveEccKey returned invalid status %d.", status);
         result = __FAILURE__;
     }
     // Derive Alias key pair from CDI and FWID
     else if ((status = RiotCrypt_DeriveEccKey(&riot_info->alias_key_pub, &riot_info->alias_key_priv,
-        g_digest, RIOT_DIGEST_LENGTH, (const uint8_t*)RIOT_LABEL_ALIAS, lblSize(RIOT_LABEL_ALIAS))) != RIOT_SUCCESS)
+        riot_info->measurement, RIOT_DIGEST_LENGTH, (const uint8_t*)RIOT_LABEL_ALIAS, lblSize(RIOT_LABEL_ALIAS))) != RIOT_SUCCESS)
     {
         LogError("Failure: RiotCrypt_DeriveEccKey returned invalid status %d.", status);
         result = __FAILURE__;
@@ -481,11 +513,6 @@ static int process_riot_key_info(HSM_CLIENT_X509_INFO* riot_info)
                 LogError("Failure: producing device certificate.");
                 result = __FAILURE__;
             }
-            else if (mallocAndStrcpy_s(&riot_info->certificate_common_name, X509_ALIAS_TBS_DATA.SubjectCommon) != 0)
-            {
-                LogError("Failure: attempting to get common name");
-                result = __FAILURE__;
-            }
             else
             {
                 result = 0;
@@ -495,6 +522,66 @@ static int process_riot_key_info(HSM_CLIENT_X509_INFO* riot_info)
     return result;
 }
 
+
+static int process_riot_key_info(HSM_CLIENT_X509_INFO* riot_info)
+{
+    int result;
+    RIOT_STATUS status;
+    uint8_t measurement[RIOT_DIGEST_LENGTH];
+
+    /* Codes_SRS_HSM_CLIENT_RIOT_07_002: [ hsm_client_riot_create shall call into the RIot code to sign the RIoT certificate. ] */
+    // Don't use CDI directly
+    if (g_digest_initialized == 0)
+    {
+        LogError("Failure: secure_device_init was not called.");
+        result = __FAILURE__;
+    }
+    else if (X509_ALIAS_TBS_DATA.SubjectCommon == NULL || strlen(X509_ALIAS_TBS_DATA.SubjectCommon) == 0)
+    {
+        LogError("Failure: The AX509_ALIAS_TBS_DATA.SubjectCommon is not entered");
+        result = __FAILURE__;
+    }
+    else if ((status = RiotCrypt_Hash(g_digest, RIOT_DIGEST_LENGTH, g_CDI, DICE_DIGEST_LENGTH)) != RIOT_SUCCESS)
+    {
+        LogError("Failure: RiotCrypt_Hash returned invalid status %d.", status);
+        result = __FAILURE__;
+    }
+    // Combine CDI and FWID, this is the measurement the alias key is derived from
+    else if ((status = RiotCrypt_Hash2(measurement, RIOT_DIGEST_LENGTH, g_digest, DICE_DIGEST_LENGTH, firmware_id, RIOT_DIGEST_LENGTH)) != RIOT_SUCCESS)
+    {
+        LogError("Failure: RiotCrypt_Hash2 returned invalid status %d.", status);
+        result = __FAILURE__;
+    }
+    else
+    {
+        /* Codes_SRS_HSM_CLIENT_RIOT_07_034: [ If a key cache is set and it holds key info for the current measurement, hsm_client_riot_create shall use it instead of deriving the keys and signing the certificates. ] */
+        if (load_cached_key_info(riot_info, measurement))
+        {
+            result = 0;
+        }
+        else
+        {
+            memcpy(riot_info->measurement, measurement, RIOT_DIGEST_LENGTH);
+            if ((result = generate_riot_key_info(riot_info)) == 0 && g_key_cache.store_key_info != NULL)
+            {
+                /* Codes_SRS_HSM_CLIENT_RIOT_07_035: [ After generating the key info hsm_client_riot_create shall pass it to the store_key_info function of the key cache. ] */
+                g_key_cache.store_key_info(measurement, RIOT_DIGEST_LENGTH, (const unsigned char*)riot_info, RIOT_KEY_INFO_CACHE_SIZE, g_key_cache.user_context);
+            }
+        }
+
+        if (result != 0)
+        {
+            LogError("Failure: generating the riot key info");
+        }
+        else if (mallocAndStrcpy_s(&riot_info->certificate_common_name, X509_ALIAS_TBS_DATA.SubjectCommon) != 0)
+        {
+            LogError("Failure: attempting to get common name");
+            result = __FAILURE__;
+        }
+    }
+    return result;
+}
+
 int hsm_client_x509_init(void)
 {
     // Only initialize one time
@@ -519,6 +606,19 @@ const HSM_CLIENT_X509_INTERFACE* hsm_client_x509_interface(void)
     return &x509_interface;
 }
 
+void hsm_client_riot_set_key_cache(const HSM_CLIENT_RIOT_KEY_CACHE* key_cache)
+{
+    /* Codes_SRS_HSM_CLIENT_RIOT_07_033: [ hsm_client_riot_set_key_cache shall copy key_cache, a NULL key_cache shall turn the cache off. ] */
+    if (key_cache == NULL)
+    {
+        memset(&g_key_cache, 0, sizeof(g_key_cache));
+    }
+    else
+    {
+        g_key_cache = *key_cache;
+    }
+}
+
 HSM_CLIENT_HANDLE hsm_client_riot_create(void)
 {
     HSM_CLIENT_X509_INFO* result;
@@ -17,6 +17,23 @@ extern "C" {
 #include "azure_c_shared_utility/macro_utils.h"
 #include "hsm_client_data.h"
 
+/* Copies the key info stored for measurement into key_info, returns 0 only when all key_info_len bytes were filled */
+typedef int(*HSM_CLIENT_RIOT_LOAD_KEY_INFO)(const unsigned char* measurement, size_t measurement_len, unsigned char* key_info, size_t key_info_len, void* user_context);
+typedef void(*HSM_CLIENT_RIOT_STORE_KEY_INFO)(const unsigned char* measurement, size_t measurement_len, const unsigned char* key_info, size_t key_info_len, void* user_context);
+
+// Lets hsm_client_riot_create skip key derivation and certificate signing when the firmware measurement has not
+// changed since the key info was stored. The key info holds the device id and alias private keys, so the store
+// must seal it to the device (encrypted or protected flash) and never hand it to anything but this module.
+typedef struct HSM_CLIENT_RIOT_KEY_CACHE_TAG
+{
+    HSM_CLIENT_RIOT_LOAD_KEY_INFO load_key_info;
+    HSM_CLIENT_RIOT_STORE_KEY_INFO store_key_info;
+    void* user_context;
+} HSM_CLIENT_RIOT_KEY_CACHE;
+
+// The structure is copied, pass NULL to stop using the cache
+MOCKABLE_FUNCTION(, void, hsm_client_riot_set_key_cache, const HSM_CLIENT_RIOT_KEY_CACHE*, key_cache);
+
 MOCKABLE_FUNCTION(, HSM_CLIENT_HANDLE, hsm_client_riot_create);
 MOCKABLE_FUNCTION(, void, hsm_client_riot_destroy, HSM_CLIENT_HANDLE, handle);
 MOCKABLE_FUNCTION(, char*, hsm_client_riot_get_certificate, HSM_CLIENT_HANDLE, handle);
@@ -60,12 +60,19 @@ typedef struct CREDENTIAL_RESULT_TAG
     } auth_cred_result;
 } CREDENTIAL_RESULT;
 
+typedef void(*IOTHUB_SECURITY_HSM_DESTROY)(void* hsm_client_handle);
 
 MOCKABLE_FUNCTION(, IOTHUB_SECURITY_HANDLE, iothub_device_auth_create);
 MOCKABLE_FUNCTION(, void, iothub_device_auth_destroy, IOTHUB_SECURITY_HANDLE, handle);
 MOCKABLE_FUNCTION(, DEVICE_AUTH_TYPE, iothub_device_auth_get_type, IOTHUB_SECURITY_HANDLE, handle);
 MOCKABLE_FUNCTION(, CREDENTIAL_RESULT*, iothub_device_auth_generate_credentials, IOTHUB_SECURITY_HANDLE, handle, const DEVICE_AUTH_CREDENTIAL_INFO*, dev_auth_cred);
 
+// Parks an HSM client already opened by the provisioning client so the next iothub_device_auth_create with the
+// same auth_type adopts it, together with the x509 certificate and alias key read during registration
+// (NULL for the other types), instead of opening the HSM again. Ownership of all of them moves on success.
+MOCKABLE_FUNCTION(, int, iothub_device_auth_handoff_hsm, DEVICE_AUTH_TYPE, auth_type, void*, hsm_client_handle, IOTHUB_SECURITY_HSM_DESTROY, hsm_client_destroy, char*, x509_certificate, char*, x509_alias_key);
+MOCKABLE_FUNCTION(, void, iothub_device_auth_clear_handoff);
+
 #ifdef USE_EDGE_MODULES
 MOCKABLE_FUNCTION(, char*, iothub_device_auth_get_trust_bundle, IOTHUB_SECURITY_HANDLE, handle);
 #endif
@@ -52,6 +52,10 @@ MOCKABLE_FUNCTION(, char*, prov_auth_construct_sas_token, PROV_AUTH_HANDLE, hand
 MOCKABLE_FUNCTION(, char*, prov_auth_get_certificate, PROV_AUTH_HANDLE, handle);
 MOCKABLE_FUNCTION(, char*, prov_auth_get_alias_key, PROV_AUTH_HANDLE, handle);
 
+// Moves the hsm client to the next iothub device auth created in this process, along with the x509 certificate
+// and alias key read for registration (NULL for the other types). On success handle can no longer reach the hsm.
+MOCKABLE_FUNCTION(, int, prov_auth_handoff_to_iothub, PROV_AUTH_HANDLE, handle, char*, x509_certificate, char*, x509_alias_key);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -0,0 +1,36 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef PROV_HSM_JOB_QUEUE_H
+#define PROV_HSM_JOB_QUEUE_H
+
+#ifdef __cplusplus
+extern "C" {
+#include <cstddef>
+#else
+#include <stddef.h>
+#endif /* __cplusplus */
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+typedef struct PROV_HSM_JOB_QUEUE_INFO_TAG* PROV_HSM_JOB_QUEUE_HANDLE;
+
+/* Runs on the queue's worker thread, returns 0 on success */
+typedef int(*PROV_HSM_JOB_FUNCTION)(void* job_context);
+/* Runs on the thread calling prov_hsm_job_queue_dowork, with the value returned by the job */
+typedef void(*PROV_HSM_JOB_COMPLETE_CALLBACK)(int job_result, void* user_context);
+
+// Runs hsm operations (key import, signing) on a worker thread so that slow hardware does not hold up the
+// thread pumping the transports. Jobs run one at a time in the order they were submitted.
+MOCKABLE_FUNCTION(, PROV_HSM_JOB_QUEUE_HANDLE, prov_hsm_job_queue_create);
+// Waits for the job that is running, if any. Jobs that have not completed are dropped without their callback.
+MOCKABLE_FUNCTION(, void, prov_hsm_job_queue_destroy, PROV_HSM_JOB_QUEUE_HANDLE, handle);
+MOCKABLE_FUNCTION(, int, prov_hsm_job_queue_submit, PROV_HSM_JOB_QUEUE_HANDLE, handle, PROV_HSM_JOB_FUNCTION, job, void*, job_context, PROV_HSM_JOB_COMPLETE_CALLBACK, on_complete, void*, user_context);
+// Calls the completion callback of every job that finished since the last call.
+MOCKABLE_FUNCTION(, void, prov_hsm_job_queue_dowork, PROV_HSM_JOB_QUEUE_HANDLE, handle);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif // PROV_HSM_JOB_QUEUE_H
@@ -0,0 +1,82 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef PROV_DEVICE_LL_BATCH_H
+#define PROV_DEVICE_LL_BATCH_H
+
+#ifdef __cplusplus
+extern "C" {
+#include <cstddef>
+#else
+#include <stddef.h>
+#endif /* __cplusplus */
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+#include "azure_prov_client/prov_device_ll_client.h"
+
+typedef struct PROV_DEVICE_LL_BATCH_INFO_TAG* PROV_DEVICE_LL_BATCH_HANDLE;
+
+/* Called with every provisioning handle the batch creates, before its registration starts, so that options such as TrustedCerts or the proxy can be set on it */
+typedef void(*PROV_DEVICE_BATCH_CONFIGURE_CALLBACK)(PROV_DEVICE_LL_HANDLE prov_handle, const char* registration_id, void* user_context);
+
+/**
+* @brief    Creates a batch that registers many symmetric key devices, typically the leaf devices of a gateway,
+*           from a single thread. At most max_concurrent_registrations devices hold a connection to the
+*           provisioning service at any time, the others waiting in the order they were queued; a registration
+*           closes its connection as soon as it completes.
+*
+* @param    uri                             The URI of the service
+* @param    scope_id                        The customer specific Id Scope
+* @param    protocol                        Function pointer for protocol implementation
+* @param    max_concurrent_registrations    The number of registrations in flight at once, at least 1
+*
+* @return   A non-NULL PROV_DEVICE_LL_BATCH_HANDLE value that is used when invoking other functions
+*           and NULL on Failure
+*/
+MOCKABLE_FUNCTION(, PROV_DEVICE_LL_BATCH_HANDLE, Prov_Device_LL_Batch_Create, const char*, uri, const char*, scope_id, PROV_DEVICE_TRANSPORT_PROVIDER_FUNCTION, protocol, size_t, max_concurrent_registrations);
+
+/**
+* @brief    Destroys the registrations in flight and drops the queued ones, without calling their callbacks.
+*
+* @param    handle  The handle created by a call to the create function
+*/
+MOCKABLE_FUNCTION(, void, Prov_Device_LL_Batch_Destroy, PROV_DEVICE_LL_BATCH_HANDLE, handle);
+
+/**
+* @brief    Sets the callback called with every provisioning handle the batch creates.
+*
+* @return PROV_DEVICE_RESULT_OK upon success or an error code upon failure
+*/
+MOCKABLE_FUNCTION(, PROV_DEVICE_RESULT, Prov_Device_LL_Batch_SetConfigureCallback, PROV_DEVICE_LL_BATCH_HANDLE, handle, PROV_DEVICE_BATCH_CONFIGURE_CALLBACK, configure_callback, void*, user_context);
+
+/**
+* @brief    Queues the registration of a device with its symmetric key, both copied.
+*
+* @param    handle              The handle created by a call to the create function.
+* @param    registration_id     The registration id of the device
+* @param    symmetric_key       The symmetric key of the device, derived from the group key for a group enrollment
+* @param    register_callback   Called from Prov_Device_LL_Batch_DoWork once the registration completes or fails
+* @param    user_context        User specified context that will be provided to the callback
+*
+* @return PROV_DEVICE_RESULT_OK upon success or an error code upon failure
+*/
+MOCKABLE_FUNCTION(, PROV_DEVICE_RESULT, Prov_Device_LL_Batch_Register_Device, PROV_DEVICE_LL_BATCH_HANDLE, handle, const char*, registration_id, const char*, symmetric_key, PROV_DEVICE_CLIENT_REGISTER_DEVICE_CALLBACK, register_callback, void*, user_context);
+
+/**
+* @brief    Starts queued registrations while fewer than max_concurrent_registrations are in flight, does the work
+*           of every registration in flight and releases the connections of the completed ones.
+*
+* @param    handle  The handle created by a call to the create function.
+*/
+MOCKABLE_FUNCTION(, void, Prov_Device_LL_Batch_DoWork, PROV_DEVICE_LL_BATCH_HANDLE, handle);
+
+/**
+* @brief    Gets the number of registrations queued or in flight, 0 once every registration has completed.
+*/
+MOCKABLE_FUNCTION(, size_t, Prov_Device_LL_Batch_GetPendingCount, PROV_DEVICE_LL_BATCH_HANDLE, handle);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif // PROV_DEVICE_LL_BATCH_H
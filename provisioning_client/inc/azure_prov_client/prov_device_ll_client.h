@@ -7,6 +7,7 @@
 #include "azure_c_shared_utility/umock_c_prod.h"
 #include "azure_c_shared_utility/macro_utils.h"
 #include "azure_prov_client/prov_transport.h"
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -45,12 +46,29 @@ DEFINE_ENUM(PROV_DEVICE_REG_STATUS, PROV_DEVICE_REG_STATUS_VALUES);
 static const char* const PROV_REGISTRATION_ID = "registration_id";
 static const char* const PROV_OPTION_LOG_TRACE = "logtrace";
 static const char* const PROV_OPTION_TIMEOUT = "provisioning_timeout";
+static const char* const PROV_OPTION_HANDOFF_TO_IOTHUB = "handoff_to_iothub";
+static const char* const PROV_OPTION_ASSIGNMENT_CACHE = "assignment_cache";
+static const char* const PROV_OPTION_SKIP_ASSIGNMENT_CACHE = "skip_assignment_cache";
+static const char* const PROV_OPTION_ASYNC_HSM = "async_hsm";
 
 typedef void(*PROV_DEVICE_CLIENT_REGISTER_DEVICE_CALLBACK)(PROV_DEVICE_RESULT register_result, const char* iothub_uri, const char* device_id, void* user_context);
 typedef void(*PROV_DEVICE_CLIENT_REGISTER_STATUS_CALLBACK)(PROV_DEVICE_REG_STATUS reg_status, void* user_context);
 
 typedef const PROV_DEVICE_TRANSPORT_PROVIDER*(*PROV_DEVICE_TRANSPORT_PROVIDER_FUNCTION)(void);
 
+/* Loads the assignment last stored for registration_id, the returned strings are owned by the application and must stay valid until Prov_Device_LL_Register_Device returns. Returns 0 when an assignment was found. */
+typedef int(*PROV_DEVICE_CLIENT_LOAD_ASSIGNMENT)(const char* registration_id, const char** iothub_uri, const char** device_id, void* user_context);
+/* Persists the assignment returned by the provisioning service for registration_id. */
+typedef void(*PROV_DEVICE_CLIENT_STORE_ASSIGNMENT)(const char* registration_id, const char* iothub_uri, const char* device_id, void* user_context);
+
+/* Value of PROV_OPTION_ASSIGNMENT_CACHE, the structure is copied so it does not need to outlive the SetOption call */
+typedef struct PROV_DEVICE_ASSIGNMENT_CACHE_TAG
+{
+    PROV_DEVICE_CLIENT_LOAD_ASSIGNMENT load_assignment;
+    PROV_DEVICE_CLIENT_STORE_ASSIGNMENT store_assignment;
+    void* user_context;
+} PROV_DEVICE_ASSIGNMENT_CACHE;
+
 /**
 * @brief    Creates a Provisioning Client for communications with the Device Provisioning Client Service
 *
@@ -103,6 +121,16 @@ MOCKABLE_FUNCTION(, void, Prov_Device_LL_DoWork, PROV_DEVICE_LL_HANDLE, handle);
 */
 MOCKABLE_FUNCTION(, PROV_DEVICE_RESULT, Prov_Device_LL_SetOption, PROV_DEVICE_LL_HANDLE, handle, const char*, optionName, const void*, value);
 
+/**
+* @brief    API to get how long the last registration took to be assigned, it can be called from the register_callback
+*
+* @param    handle              The handle created by a call to the create function.
+* @param    time_to_assigned    The milliseconds from the first registration request to the assignment, 0 when the assignment came from the assignment cache
+*
+* @return PROV_DEVICE_RESULT_OK upon success, PROV_DEVICE_RESULT_INVALID_STATE when no registration has been assigned
+*/
+MOCKABLE_FUNCTION(, PROV_DEVICE_RESULT, Prov_Device_LL_GetTimeToAssigned, PROV_DEVICE_LL_HANDLE, handle, uint32_t*, time_to_assigned);
+
 /**
 * @brief    API to get the version of the provisioning client
 *
@@ -0,0 +1,39 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef PROV_TLS_SESSION_CACHE_H
+#define PROV_TLS_SESSION_CACHE_H
+
+#ifdef __cplusplus
+extern "C" {
+#include <cstddef>
+#else
+#include <stddef.h>
+#endif /* __cplusplus */
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+#include "azure_c_shared_utility/xio.h"
+
+// PROV_TLS_SESSION_CACHE_HANDLE, AMQP and AMQP over WebSockets: the TLS options of the last provisioning connection,
+// kept by the application across provisioning handles so that a device provisioning again resumes the TLS session
+// of the previous registration instead of running a full handshake
+static const char* const PROV_OPTION_TLS_SESSION_CACHE = "tls_session_cache";
+
+typedef struct PROV_TLS_SESSION_CACHE_INFO_TAG* PROV_TLS_SESSION_CACHE_HANDLE;
+
+// The cache must outlive every provisioning handle it is set on and can be shared by handles running on
+// different threads.
+MOCKABLE_FUNCTION(, PROV_TLS_SESSION_CACHE_HANDLE, prov_tls_session_cache_create);
+MOCKABLE_FUNCTION(, void, prov_tls_session_cache_destroy, PROV_TLS_SESSION_CACHE_HANDLE, handle);
+
+// Called by the transports: asks a new TLS I/O to resume its session and feeds it the options saved for hostname,
+// returns 0 when saved options were fed
+MOCKABLE_FUNCTION(, int, prov_tls_session_cache_apply, PROV_TLS_SESSION_CACHE_HANDLE, handle, const char*, hostname, XIO_HANDLE, tls_io);
+// Called by the transports before a TLS I/O is destroyed, replaces the saved options with the ones of tls_io
+MOCKABLE_FUNCTION(, int, prov_tls_session_cache_store, PROV_TLS_SESSION_CACHE_HANDLE, handle, const char*, hostname, XIO_HANDLE, tls_io);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif // PROV_TLS_SESSION_CACHE_H
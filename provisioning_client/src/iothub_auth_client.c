@@ -40,8 +40,21 @@ typedef struct IOTHUB_SECURITY_INFO_TAG
     char* x509_alias_key;
     bool base64_encode_signature;
     bool urlencode_token_scope;
+    bool x509_from_handoff;
 } IOTHUB_SECURITY_INFO;
 
+typedef struct IOTHUB_SECURITY_HANDOFF_TAG
+{
+    DEVICE_AUTH_TYPE auth_type;
+    HSM_CLIENT_HANDLE hsm_client_handle;
+    IOTHUB_SECURITY_HSM_DESTROY hsm_client_destroy;
+    char* x509_certificate;
+    char* x509_alias_key;
+} IOTHUB_SECURITY_HANDOFF;
+
+// HSM client left behind by the provisioning client for the next iothub_device_auth_create
+static IOTHUB_SECURITY_HANDOFF g_hsm_handoff;
+
 #define HMAC_LENGTH                 32
 static const char* const SAS_TOKEN_FORMAT = "SharedAccessSignature sr=%s&sig=%s&se=%s%s%s";
 static const char* const SKN_SECTION_FORMAT = "&skn=";
@@ -116,6 +129,25 @@ static int sign_sas_data(IOTHUB_SECURITY_INFO* security_info, const char* payloa
     return result;
 }
 
+static HSM_CLIENT_HANDLE take_handoff_or_create(IOTHUB_SECURITY_INFO* security_info)
+{
+    HSM_CLIENT_HANDLE result;
+    if (g_hsm_handoff.hsm_client_handle != NULL && g_hsm_handoff.auth_type == security_info->cred_type)
+    {
+        // The provisioning client already opened the HSM and read the certificate, reuse both
+        result = g_hsm_handoff.hsm_client_handle;
+        security_info->x509_certificate = g_hsm_handoff.x509_certificate;
+        security_info->x509_alias_key = g_hsm_handoff.x509_alias_key;
+        security_info->x509_from_handoff = (security_info->x509_certificate != NULL && security_info->x509_alias_key != NULL);
+        memset(&g_hsm_handoff, 0, sizeof(IOTHUB_SECURITY_HANDOFF));
+    }
+    else
+    {
+        result = security_info->hsm_client_create();
+    }
+    return result;
+}
+
 IOTHUB_SECURITY_HANDLE iothub_device_auth_create()
 {
     IOTHUB_SECURITY_INFO* result;
@@ -225,7 +257,7 @@ IOTHUB_SECURITY_HANDLE iothub_device_auth_create()
         {
             /* Codes_IOTHUB_DEV_AUTH_07_025: [ iothub_device_auth_create shall call the concrete_iothub_device_auth_create function associated with the interface_desc. ] */
             /* Codes_IOTHUB_DEV_AUTH_07_026: [ if concrete_iothub_device_auth_create fails iothub_device_auth_create shall return NULL. ] */
-            if ((result->hsm_client_handle = result->hsm_client_create()) == NULL)
+            if ((result->hsm_client_handle = take_handoff_or_create(result)) == NULL)
             {
                 /* Codes_IOTHUB_DEV_AUTH_07_002: [ iothub_device_auth_create shall allocate the IOTHUB_SECURITY_INFO and shall fail if the allocation fails. ]*/
                 LogError("failed create device auth module.");
@@ -236,6 +268,8 @@ IOTHUB_SECURITY_HANDLE iothub_device_auth_create()
             {
                 LogError("Invalid x509 secure device interface was specified");
                 result->hsm_client_destroy(result->hsm_client_handle);
+                free(result->x509_certificate);
+                free(result->x509_alias_key);
                 free(result);
                 result = NULL;
             }
@@ -245,6 +279,42 @@ IOTHUB_SECURITY_HANDLE iothub_device_auth_create()
     return result;
 }
 
+int iothub_device_auth_handoff_hsm(DEVICE_AUTH_TYPE auth_type, void* hsm_client_handle, IOTHUB_SECURITY_HSM_DESTROY hsm_client_destroy, char* x509_certificate, char* x509_alias_key)
+{
+    int result;
+    if (hsm_client_handle == NULL || hsm_client_destroy == NULL || auth_type == AUTH_TYPE_UNKNOWN)
+    {
+        LogError("Invalid parameter specified hsm_client_handle: %p, hsm_client_destroy: %p, auth_type: %d", hsm_client_handle, hsm_client_destroy, auth_type);
+        result = __FAILURE__;
+    }
+    else if (g_hsm_handoff.hsm_client_handle != NULL)
+    {
+        LogError("An HSM client is already waiting to be used by an iothub device auth");
+        result = __FAILURE__;
+    }
+    else
+    {
+        g_hsm_handoff.auth_type = auth_type;
+        g_hsm_handoff.hsm_client_handle = hsm_client_handle;
+        g_hsm_handoff.hsm_client_destroy = hsm_client_destroy;
+        g_hsm_handoff.x509_certificate = x509_certificate;
+        g_hsm_handoff.x509_alias_key = x509_alias_key;
+        result = 0;
+    }
+    return result;
+}
+
+void iothub_device_auth_clear_handoff(void)
+{
+    if (g_hsm_handoff.hsm_client_handle != NULL)
+    {
+        g_hsm_handoff.hsm_client_destroy(g_hsm_handoff.hsm_client_handle);
+        free(g_hsm_handoff.x509_certificate);
+        free(g_hsm_handoff.x509_alias_key);
+        memset(&g_hsm_handoff, 0, sizeof(IOTHUB_SECURITY_HANDOFF));
+    }
+}
+
 void iothub_device_auth_destroy(IOTHUB_SECURITY_HANDLE handle)
 {
     /* Codes_IOTHUB_DEV_AUTH_07_006: [ If the argument handle is NULL, iothub_device_auth_destroy shall do nothing ] */
@@ -429,6 +499,20 @@ CREDENTIAL_RESULT* iothub_device_auth_generate_credentials(IOTHUB_SECURITY_HANDL
                 }
             }
         }
+        else if (handle->x509_from_handoff)
+        {
+            // The certificate handed off by the provisioning client is still current, skip reading it again
+            handle->x509_from_handoff = false;
+            if ((result = malloc(sizeof(CREDENTIAL_RESULT))) == NULL)
+            {
+                LogError("Failure allocating credential result.");
+            }
+            else
+            {
+                result->auth_cred_result.x509_result.x509_cert = handle->x509_certificate;
+                result->auth_cred_result.x509_result.x509_alias_key = handle->x509_alias_key;
+            }
+        }
         else
         {
             if (handle->x509_certificate != NULL)
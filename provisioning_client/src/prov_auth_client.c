@@ -15,6 +15,7 @@
 #include "azure_c_shared_utility/hmacsha256.h"
 
 #include "azure_prov_client/internal/prov_auth_client.h"
+#include "azure_prov_client/internal/iothub_auth_client.h"
 #include "hsm_client_data.h"
 
 #include "azure_prov_client/prov_security_factory.h"
@@ -313,7 +314,10 @@ void prov_auth_destroy(PROV_AUTH_HANDLE handle)
     {
         /* Codes_SRS_PROV_AUTH_CLIENT_07_007: [ prov_auth_destroy shall free all resources allocated in this module. ] */
         free(handle->registration_id);
-        handle->hsm_client_destroy(handle->hsm_client_handle);
+        if (handle->hsm_client_handle != NULL)
+        {
+            handle->hsm_client_destroy(handle->hsm_client_handle);
+        }
         /* Codes_SRS_PROV_AUTH_CLIENT_07_006: [ prov_auth_destroy shall free the PROV_AUTH_HANDLE instance. ] */
         free(handle);
     }
@@ -650,3 +654,53 @@ char* prov_auth_get_alias_key(PROV_AUTH_HANDLE handle)
     }
     return result;
 }
+
+static DEVICE_AUTH_TYPE get_iothub_auth_type(PROV_AUTH_TYPE sec_type)
+{
+    DEVICE_AUTH_TYPE result;
+    if (sec_type == PROV_AUTH_TYPE_TPM)
+    {
+        result = AUTH_TYPE_SAS;
+    }
+    else if (sec_type == PROV_AUTH_TYPE_X509)
+    {
+        result = AUTH_TYPE_X509;
+    }
+    else if (sec_type == PROV_AUTH_TYPE_KEY)
+    {
+        result = AUTH_TYPE_SYMM_KEY;
+    }
+    else
+    {
+        result = AUTH_TYPE_UNKNOWN;
+    }
+    return result;
+}
+
+int prov_auth_handoff_to_iothub(PROV_AUTH_HANDLE handle, char* x509_certificate, char* x509_alias_key)
+{
+    int result;
+    DEVICE_AUTH_TYPE auth_type;
+    if (handle == NULL || handle->hsm_client_handle == NULL)
+    {
+        LogError("Invalid handle parameter");
+        result = __FAILURE__;
+    }
+    else if ((auth_type = get_iothub_auth_type(handle->sec_type)) == AUTH_TYPE_UNKNOWN)
+    {
+        LogError("Invalid type for operation");
+        result = __FAILURE__;
+    }
+    else if (iothub_device_auth_handoff_hsm(auth_type, handle->hsm_client_handle, handle->hsm_client_destroy, x509_certificate, x509_alias_key) != 0)
+    {
+        LogError("Failure handing the hsm client off to the iothub device auth");
+        result = __FAILURE__;
+    }
+    else
+    {
+        // The iothub device auth owns the hsm client from now on
+        handle->hsm_client_handle = NULL;
+        result = 0;
+    }
+    return result;
+}
@@ -0,0 +1,287 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/crt_abstractions.h"
+
+#include "azure_prov_client/prov_device_ll_batch.h"
+#include "azure_prov_client/prov_security_factory.h"
+
+typedef struct PROV_BATCH_REGISTRATION_TAG
+{
+    char* registration_id;      // followed in the same allocation by symmetric_key
+    char* symmetric_key;
+    PROV_DEVICE_CLIENT_REGISTER_DEVICE_CALLBACK register_callback;
+    void* user_context;
+    PROV_DEVICE_LL_HANDLE prov_handle;
+    bool completed;
+    struct PROV_BATCH_REGISTRATION_TAG* next;
+} PROV_BATCH_REGISTRATION;
+
+typedef struct PROV_BATCH_REGISTRATION_LIST_TAG
+{
+    PROV_BATCH_REGISTRATION* head;
+    PROV_BATCH_REGISTRATION* tail;
+    size_t count;
+} PROV_BATCH_REGISTRATION_LIST;
+
+typedef struct PROV_DEVICE_LL_BATCH_INFO_TAG
+{
+    char* uri;
+    char* scope_id;
+    PROV_DEVICE_TRANSPORT_PROVIDER_FUNCTION protocol;
+    size_t max_concurrent_registrations;
+
+    PROV_DEVICE_BATCH_CONFIGURE_CALLBACK configure_callback;
+    void* configure_context;
+
+    PROV_BATCH_REGISTRATION_LIST queued;
+    PROV_BATCH_REGISTRATION_LIST in_flight;
+} PROV_DEVICE_LL_BATCH_INFO;
+
+static void registration_list_append(PROV_BATCH_REGISTRATION_LIST* list, PROV_BATCH_REGISTRATION* registration)
+{
+    registration->next = NULL;
+    if (list->tail == NULL)
+    {
+        list->head = registration;
+    }
+    else
+    {
+        list->tail->next = registration;
+    }
+    list->tail = registration;
+    list->count++;
+}
+
+static PROV_BATCH_REGISTRATION* registration_list_pop(PROV_BATCH_REGISTRATION_LIST* list)
+{
+    PROV_BATCH_REGISTRATION* result = list->head;
+    if (result != NULL)
+    {
+        list->head = result->next;
+        if (list->head == NULL)
+        {
+            list->tail = NULL;
+        }
+        list->count--;
+        result->next = NULL;
+    }
+    return result;
+}
+
+static void free_registration(PROV_BATCH_REGISTRATION* registration)
+{
+    if (registration->prov_handle != NULL)
+    {
+        Prov_Device_LL_Destroy(registration->prov_handle);
+    }
+    // Don't leave the device key behind in freed memory
+    (void)memset(registration->symmetric_key, 0, strlen(registration->symmetric_key));
+    free(registration);
+}
+
+static void free_registration_list(PROV_BATCH_REGISTRATION_LIST* list)
+{
+    PROV_BATCH_REGISTRATION* registration;
+    while ((registration = registration_list_pop(list)) != NULL)
+    {
+        free_registration(registration);
+    }
+}
+
+static void on_registration_complete(PROV_DEVICE_RESULT register_result, const char* iothub_uri, const char* device_id, void* user_context)
+{
+    PROV_BATCH_REGISTRATION* registration = (PROV_BATCH_REGISTRATION*)user_context;
+
+    // The provisioning handle is still running its DoWork, it is destroyed once that returns
+    registration->completed = true;
+    registration->register_callback(register_result, iothub_uri, device_id, registration->user_context);
+}
+
+static int start_registration(PROV_DEVICE_LL_BATCH_INFO* batch_info, PROV_BATCH_REGISTRATION* registration)
+{
+    int result;
+
+    // The hsm copies the key of the device when its provisioning handle is created, so setting
+    // them one device after the other is enough
+    if (prov_dev_set_symmetric_key_info(registration->registration_id, registration->symmetric_key) != 0)
+    {
+        LogError("Failure setting the symmetric key of %s", registration->registration_id);
+        result = __FAILURE__;
+    }
+    else if ((registration->prov_handle = Prov_Device_LL_Create(batch_info->uri, batch_info->scope_id, batch_info->protocol)) == NULL)
+    {
+        LogError("Failure creating the provisioning handle of %s", registration->registration_id);
+        result = __FAILURE__;
+    }
+    else
+    {
+        if (batch_info->configure_callback != NULL)
+        {
+            batch_info->configure_callback(registration->prov_handle, registration->registration_id, batch_info->configure_context);
+        }
+
+        if (Prov_Device_LL_Register_Device(registration->prov_handle, on_registration_complete, registration, NULL, NULL) != PROV_DEVICE_RESULT_OK)
+        {
+            LogError("Failure starting the registration of %s", registration->registration_id);
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = 0;
+        }
+    }
+    return result;
+}
+
+PROV_DEVICE_LL_BATCH_HANDLE Prov_Device_LL_Batch_Create(const char* uri, const char* scope_id, PROV_DEVICE_TRANSPORT_PROVIDER_FUNCTION protocol, size_t max_concurrent_registrations)
+{
+    PROV_DEVICE_LL_BATCH_INFO* result;
+
+    if (uri == NULL || scope_id == NULL || protocol == NULL || max_concurrent_registrations == 0)
+    {
+        LogError("Invalid parameter specified uri: %p, scope_id: %p, protocol: %p, max_concurrent_registrations: %lu", uri, scope_id, protocol, (unsigned long)max_concurrent_registrations);
+        result = NULL;
+    }
+    else if ((result = (PROV_DEVICE_LL_BATCH_INFO*)malloc(sizeof(PROV_DEVICE_LL_BATCH_INFO))) == NULL)
+    {
+        LogError("Failure allocating the provisioning batch");
+    }
+    else
+    {
+        memset(result, 0, sizeof(PROV_DEVICE_LL_BATCH_INFO));
+        if (mallocAndStrcpy_s(&result->uri, uri) != 0)
+        {
+            LogError("Failure copying the uri");
+            free(result);
+            result = NULL;
+        }
+        else if (mallocAndStrcpy_s(&result->scope_id, scope_id) != 0)
+        {
+            LogError("Failure copying the scope id");
+            free(result->uri);
+            free(result);
+            result = NULL;
+        }
+        else
+        {
+            result->protocol = protocol;
+            result->max_concurrent_registrations = max_concurrent_registrations;
+        }
+    }
+    return result;
+}
+
+void Prov_Device_LL_Batch_Destroy(PROV_DEVICE_LL_BATCH_HANDLE handle)
+{
+    if (handle != NULL)
+    {
+        free_registration_list(&handle->in_flight);
+        free_registration_list(&handle->queued);
+        free(handle->uri);
+        free(handle->scope_id);
+        free(handle);
+    }
+}
+
+PROV_DEVICE_RESULT Prov_Device_LL_Batch_SetConfigureCallback(PROV_DEVICE_LL_BATCH_HANDLE handle, PROV_DEVICE_BATCH_CONFIGURE_CALLBACK configure_callback, void* user_context)
+{
+    PROV_DEVICE_RESULT result;
+    if (handle == NULL)
+    {
+        LogError("Invalid parameter specified handle: %p", handle);
+        result = PROV_DEVICE_RESULT_INVALID_ARG;
+    }
+    else
+    {
+        handle->configure_callback = configure_callback;
+        handle->configure_context = user_context;
+        result = PROV_DEVICE_RESULT_OK;
+    }
+    return result;
+}
+
+PROV_DEVICE_RESULT Prov_Device_LL_Batch_Register_Device(PROV_DEVICE_LL_BATCH_HANDLE handle, const char* registration_id, const char* symmetric_key, PROV_DEVICE_CLIENT_REGISTER_DEVICE_CALLBACK register_callback, void* user_context)
+{
+    PROV_DEVICE_RESULT result;
+
+    if (handle == NULL || registration_id == NULL || symmetric_key == NULL || register_callback == NULL)
+    {
+        LogError("Invalid parameter specified handle: %p, registration_id: %p, symmetric_key: %p, register_callback: %p", handle, registration_id, symmetric_key, register_callback);
+        result = PROV_DEVICE_RESULT_INVALID_ARG;
+    }
+    else
+    {
+        size_t registration_id_size = strlen(registration_id) + 1;
+        size_t symmetric_key_size = strlen(symmetric_key) + 1;
+        PROV_BATCH_REGISTRATION* registration;
+
+        if ((registration = (PROV_BATCH_REGISTRATION*)malloc(sizeof(PROV_BATCH_REGISTRATION) + registration_id_size + symmetric_key_size)) == NULL)
+        {
+            LogError("Failure allocating the registration of %s", registration_id);
+            result = PROV_DEVICE_RESULT_MEMORY;
+        }
+        else
+        {
+            memset(registration, 0, sizeof(PROV_BATCH_REGISTRATION));
+            registration->registration_id = (char*)(registration + 1);
+            (void)memcpy(registration->registration_id, registration_id, registration_id_size);
+            registration->symmetric_key = registration->registration_id + registration_id_size;
+            (void)memcpy(registration->symmetric_key, symmetric_key, symmetric_key_size);
+            registration->register_callback = register_callback;
+            registration->user_context = user_context;
+
+            registration_list_append(&handle->queued, registration);
+            result = PROV_DEVICE_RESULT_OK;
+        }
+    }
+    return result;
+}
+
+void Prov_Device_LL_Batch_DoWork(PROV_DEVICE_LL_BATCH_HANDLE handle)
+{
+    if (handle != NULL)
+    {
+        PROV_BATCH_REGISTRATION_LIST still_in_flight = { NULL, NULL, 0 };
+        PROV_BATCH_REGISTRATION* registration;
+
+        while (handle->in_flight.count < handle->max_concurrent_registrations && (registration = registration_list_pop(&handle->queued)) != NULL)
+        {
+            if (start_registration(handle, registration) != 0)
+            {
+                registration->register_callback(PROV_DEVICE_RESULT_ERROR, NULL, NULL, registration->user_context);
+                free_registration(registration);
+            }
+            else
+            {
+                registration_list_append(&handle->in_flight, registration);
+            }
+        }
+
+        // The callbacks may queue more registrations, they start on the next call
+        while ((registration = registration_list_pop(&handle->in_flight)) != NULL)
+        {
+            Prov_Device_LL_DoWork(registration->prov_handle);
+            if (registration->completed)
+            {
+                free_registration(registration);
+            }
+            else
+            {
+                registration_list_append(&still_in_flight, registration);
+            }
+        }
+        handle->in_flight = still_in_flight;
+    }
+}
+
+size_t Prov_Device_LL_Batch_GetPendingCount(PROV_DEVICE_LL_BATCH_HANDLE handle)
+{
+    return (handle == NULL) ? 0 : handle->queued.count + handle->in_flight.count;
+}
@@ -20,6 +20,7 @@
 
 #include "azure_prov_client/internal/prov_auth_client.h"
 #include "azure_prov_client/internal/prov_transport_private.h"
+#include "azure_prov_client/internal/prov_hsm_job_queue.h"
 #include "azure_prov_client/prov_device_ll_client.h"
 #include "azure_prov_client/prov_client_const.h"
 
@@ -48,6 +49,7 @@ static const char* const SAS_TOKEN_SCOPE_FMT = "%s/registrations/%s";
 #define EPOCH_TIME_T_VALUE          (time_t)0
 #define MAX_AUTH_ATTEMPTS           3
 #define PROV_GET_THROTTLE_TIME      1
+#define PROV_MAX_THROTTLE_TIME      60
 #define PROV_DEFAULT_TIMEOUT        60
 
 typedef enum CLIENT_STATE_TAG
@@ -62,6 +64,9 @@ typedef enum CLIENT_STATE_TAG
     CLIENT_STATE_STATUS_SENT,
     CLIENT_STATE_STATUS_RECV,
 
+    CLIENT_STATE_CACHE_HIT,
+    CLIENT_STATE_HSM_PENDING,
+
     CLIENT_STATE_ERROR
 } CLIENT_STATE;
 
@@ -87,8 +92,16 @@ typedef struct PROV_INSTANCE_INFO_TAG
     TICK_COUNTER_HANDLE tick_counter;
 
     tickcounter_ms_t status_throttle;
+    tickcounter_ms_t status_poll_interval;
+    size_t status_polls_sent;
+    tickcounter_ms_t register_retry_interval;
     tickcounter_ms_t timeout_value;
 
+    bool registration_started;
+    tickcounter_ms_t registration_start;
+    bool is_time_to_assigned_set;
+    tickcounter_ms_t time_to_assigned;
+
     uint8_t prov_timeout;
 
     char* registration_id;
@@ -107,6 +120,18 @@ typedef struct PROV_INSTANCE_INFO_TAG
     size_t auth_attempts_made;
 
     char* scope_id;
+
+    bool handoff_to_iothub;
+    bool hsm_handed_off;
+    char* x509_certificate;
+    char* x509_alias_key;
+
+    PROV_DEVICE_ASSIGNMENT_CACHE assignment_cache;
+    bool skip_assignment_cache;
+
+    // Set with PROV_OPTION_ASYNC_HSM, the hsm is only used by the queue's worker while a job is pending
+    PROV_HSM_JOB_QUEUE_HANDLE hsm_job_queue;
+    BUFFER_HANDLE pending_iothub_key;
 } PROV_INSTANCE_INFO;
 
 static char* prov_transport_challenge_callback(const unsigned char* nonce, size_t nonce_len, const char* key_name, void* user_ctx)
@@ -509,9 +534,217 @@ static void cleanup_prov_info(PROV_INSTANCE_INFO* prov_info)
     prov_info->iothub_info.iothub_key = NULL;
     free(prov_info->iothub_info.iothub_url);
     prov_info->iothub_info.iothub_url = NULL;
+    if (prov_info->x509_certificate != NULL)
+    {
+        free(prov_info->x509_certificate);
+        prov_info->x509_certificate = NULL;
+    }
+    if (prov_info->x509_alias_key != NULL)
+    {
+        free(prov_info->x509_alias_key);
+        prov_info->x509_alias_key = NULL;
+    }
+    if (prov_info->pending_iothub_key != NULL)
+    {
+        BUFFER_delete(prov_info->pending_iothub_key);
+        prov_info->pending_iothub_key = NULL;
+    }
     prov_info->auth_attempts_made = 0;
 }
 
+static void handoff_hsm_to_iothub(PROV_INSTANCE_INFO* prov_info)
+{
+    // Pass the already open hsm on before the callback, which is where the iothub client gets created
+    if (prov_info->handoff_to_iothub)
+    {
+        if (prov_auth_handoff_to_iothub(prov_info->prov_auth_handle, prov_info->x509_certificate, prov_info->x509_alias_key) != 0)
+        {
+            LogError("Failure handing the hsm off, the iothub client will open its own");
+        }
+        else
+        {
+            prov_info->hsm_handed_off = true;
+            prov_info->x509_certificate = NULL;
+            prov_info->x509_alias_key = NULL;
+        }
+    }
+}
+
+static int load_cached_assignment(PROV_INSTANCE_INFO* prov_info)
+{
+    int result;
+    const char* iothub_uri = NULL;
+    const char* device_id = NULL;
+
+    if (prov_info->assignment_cache.load_assignment == NULL || prov_info->skip_assignment_cache)
+    {
+        result = __FAILURE__;
+    }
+    else if (prov_info->assignment_cache.load_assignment(prov_info->registration_id, &iothub_uri, &device_id, prov_info->assignment_cache.user_context) != 0 ||
+        iothub_uri == NULL || device_id == NULL)
+    {
+        LogInfo("No cached assignment for %s, registering with the provisioning service", prov_info->registration_id);
+        result = __FAILURE__;
+    }
+    else if (mallocAndStrcpy_s(&prov_info->iothub_info.iothub_url, iothub_uri) != 0)
+    {
+        LogError("Failure allocating cached iothub uri");
+        result = __FAILURE__;
+    }
+    else if (mallocAndStrcpy_s(&prov_info->iothub_info.device_id, device_id) != 0)
+    {
+        LogError("Failure allocating cached device id");
+        free(prov_info->iothub_info.iothub_url);
+        prov_info->iothub_info.iothub_url = NULL;
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = 0;
+    }
+    return result;
+}
+
+static tickcounter_ms_t get_retry_after_ms(uint32_t retry_interval)
+{
+    if (retry_interval > PROV_MAX_THROTTLE_TIME)
+    {
+        retry_interval = PROV_MAX_THROTTLE_TIME;
+    }
+    return (tickcounter_ms_t)retry_interval * 1000;
+}
+
+static void set_status_poll_interval(PROV_INSTANCE_INFO* prov_info, uint32_t retry_interval)
+{
+    if (retry_interval > 0)
+    {
+        // The service knows when the assignment should be done, follow its hint
+        prov_info->status_poll_interval = get_retry_after_ms(retry_interval);
+    }
+    else if (prov_info->status_polls_sent == 0)
+    {
+        prov_info->status_poll_interval = 0;
+    }
+    else
+    {
+        // Exponential backoff with jitter so devices that booted together do not poll in lock step
+        tickcounter_ms_t backoff = PROV_GET_THROTTLE_TIME * 1000;
+        size_t index;
+        for (index = 1; index < prov_info->status_polls_sent && backoff < PROV_MAX_THROTTLE_TIME * 1000; index++)
+        {
+            backoff *= 2;
+        }
+        if (backoff > PROV_MAX_THROTTLE_TIME * 1000)
+        {
+            backoff = PROV_MAX_THROTTLE_TIME * 1000;
+        }
+        prov_info->status_poll_interval = (backoff / 2) + (tickcounter_ms_t)(rand() % ((backoff / 2) + 1));
+    }
+}
+
+static bool is_register_retry_held(PROV_INSTANCE_INFO* prov_info)
+{
+    bool result;
+    tickcounter_ms_t current_time = 0;
+    if (prov_info->register_retry_interval == 0)
+    {
+        result = false;
+    }
+    else if (tickcounter_get_current_ms(prov_info->tick_counter, &current_time) != 0)
+    {
+        LogError("Failure getting the current time");
+        prov_info->register_retry_interval = 0;
+        result = false;
+    }
+    else if ((current_time - prov_info->timeout_value) < prov_info->register_retry_interval)
+    {
+        result = true;
+    }
+    else
+    {
+        prov_info->register_retry_interval = 0;
+        result = false;
+    }
+    return result;
+}
+
+static void record_time_to_assigned(PROV_INSTANCE_INFO* prov_info)
+{
+    tickcounter_ms_t current_time = 0;
+    if (prov_info->registration_started && tickcounter_get_current_ms(prov_info->tick_counter, &current_time) == 0)
+    {
+        prov_info->time_to_assigned = current_time - prov_info->registration_start;
+        prov_info->is_time_to_assigned_set = true;
+    }
+}
+
+static void complete_assignment(PROV_INSTANCE_INFO* prov_info, const char* assigned_hub, const char* device_id)
+{
+    record_time_to_assigned(prov_info);
+    if (prov_info->assignment_cache.store_assignment != NULL)
+    {
+        prov_info->assignment_cache.store_assignment(prov_info->registration_id, assigned_hub, device_id, prov_info->assignment_cache.user_context);
+    }
+    prov_info->skip_assignment_cache = false;
+    handoff_hsm_to_iothub(prov_info);
+    prov_info->register_callback(PROV_DEVICE_RESULT_OK, assigned_hub, device_id, prov_info->user_context);
+    prov_info->prov_state = CLIENT_STATE_READY;
+    cleanup_prov_info(prov_info);
+}
+
+static int import_iothub_key_job(void* job_context)
+{
+    // Runs on the hsm worker thread
+    PROV_INSTANCE_INFO* prov_info = (PROV_INSTANCE_INFO*)job_context;
+    return prov_auth_import_key(prov_info->prov_auth_handle, BUFFER_u_char(prov_info->pending_iothub_key), BUFFER_length(prov_info->pending_iothub_key));
+}
+
+static void on_import_iothub_key_complete(int job_result, void* user_context)
+{
+    PROV_INSTANCE_INFO* prov_info = (PROV_INSTANCE_INFO*)user_context;
+    if (job_result != 0)
+    {
+        prov_info->prov_state = CLIENT_STATE_ERROR;
+        prov_info->error_reason = PROV_DEVICE_RESULT_KEY_ERROR;
+        LogError("Failure to import the provisioning key");
+    }
+    else
+    {
+        complete_assignment(prov_info, prov_info->iothub_info.iothub_url, prov_info->iothub_info.device_id);
+    }
+}
+
+static int queue_iothub_key_import(PROV_INSTANCE_INFO* prov_info, BUFFER_HANDLE iothub_key, const char* assigned_hub, const char* device_id)
+{
+    int result;
+    // The assignment is kept until the import completes on a later DoWork
+    if ((prov_info->pending_iothub_key = BUFFER_clone(iothub_key)) == NULL)
+    {
+        LogError("Failure copying the iothub key");
+        result = __FAILURE__;
+    }
+    else if (mallocAndStrcpy_s(&prov_info->iothub_info.iothub_url, assigned_hub) != 0)
+    {
+        LogError("Failure copying the assigned hub");
+        result = __FAILURE__;
+    }
+    else if (mallocAndStrcpy_s(&prov_info->iothub_info.device_id, device_id) != 0)
+    {
+        LogError("Failure copying the device id");
+        result = __FAILURE__;
+    }
+    else if (prov_hsm_job_queue_submit(prov_info->hsm_job_queue, import_iothub_key_job, prov_info, on_import_iothub_key_complete, prov_info) != 0)
+    {
+        LogError("Failure queuing the key import");
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = 0;
+    }
+    return result;
+}
+
 static void on_transport_registration_data(PROV_DEVICE_TRANSPORT_RESULT transport_result, BUFFER_HANDLE iothub_key, const char* assigned_hub, const char* device_id, void* user_ctx)
 {
     if (user_ctx == NULL)
@@ -534,6 +767,18 @@ static void on_transport_registration_data(PROV_DEVICE_TRANSPORT_RESULT transpor
                     }
                     LogError("invalid iothub device key");
                 }
+                else if (prov_info->hsm_job_queue != NULL)
+                {
+                    if (queue_iothub_key_import(prov_info, iothub_key, assigned_hub, device_id) != 0)
+                    {
+                        prov_info->prov_state = CLIENT_STATE_ERROR;
+                        prov_info->error_reason = PROV_DEVICE_RESULT_KEY_ERROR;
+                    }
+                    else
+                    {
+                        prov_info->prov_state = CLIENT_STATE_HSM_PENDING;
+                    }
+                }
                 else
                 {
                     const unsigned char* key_value = BUFFER_u_char(iothub_key);
@@ -549,11 +794,9 @@ static void on_transport_registration_data(PROV_DEVICE_TRANSPORT_RESULT transpor
                 }
             }
 
-            if (prov_info->prov_state != CLIENT_STATE_ERROR)
+            if (prov_info->prov_state != CLIENT_STATE_ERROR && prov_info->prov_state != CLIENT_STATE_HSM_PENDING)
             {
-                prov_info->register_callback(PROV_DEVICE_RESULT_OK, assigned_hub, device_id, prov_info->user_context);
-                prov_info->prov_state = CLIENT_STATE_READY;
-                cleanup_prov_info(prov_info);
+                complete_assignment(prov_info, assigned_hub, device_id);
             }
         }
         else if (transport_result == PROV_DEVICE_TRANSPORT_RESULT_UNAUTHORIZED)
@@ -574,7 +817,7 @@ static void on_transport_registration_data(PROV_DEVICE_TRANSPORT_RESULT transpor
     }
 }
 
-static void on_transport_status(PROV_DEVICE_TRANSPORT_STATUS transport_status, void* user_ctx)
+static void on_transport_status(PROV_DEVICE_TRANSPORT_STATUS transport_status, uint32_t retry_interval, void* user_ctx)
 {
     if (user_ctx == NULL)
     {
@@ -596,6 +839,7 @@ static void on_transport_status(PROV_DEVICE_TRANSPORT_STATUS transport_status, v
             case PROV_DEVICE_TRANSPORT_STATUS_ASSIGNING:
             case PROV_DEVICE_TRANSPORT_STATUS_UNASSIGNED:
                 prov_info->prov_state = CLIENT_STATE_STATUS_SEND;
+                set_status_poll_interval(prov_info, retry_interval);
                 if (transport_status == PROV_DEVICE_TRANSPORT_STATUS_UNASSIGNED)
                 {
                     if (prov_info->register_status_cb != NULL)
@@ -615,10 +859,12 @@ static void on_transport_status(PROV_DEVICE_TRANSPORT_STATUS transport_status, v
                 if (prov_info->prov_state == CLIENT_STATE_REGISTER_SENT)
                 {
                     prov_info->prov_state = CLIENT_STATE_REGISTER_SEND;
+                    prov_info->register_retry_interval = get_retry_after_ms(retry_interval);
                 }
                 else if (prov_info->prov_state == CLIENT_STATE_STATUS_SENT)
                 {
                     prov_info->prov_state = CLIENT_STATE_STATUS_SEND;
+                    set_status_poll_interval(prov_info, retry_interval);
                 }
                 else
                 {
@@ -635,6 +881,11 @@ static void on_transport_status(PROV_DEVICE_TRANSPORT_STATUS transport_status, v
 
 static void destroy_instance(PROV_INSTANCE_INFO* prov_info)
 {
+    // Stop the worker before anything it may be using is released
+    if (prov_info->hsm_job_queue != NULL)
+    {
+        prov_hsm_job_queue_destroy(prov_info->hsm_job_queue);
+    }
     cleanup_prov_info(prov_info);
     prov_info->prov_transport_protocol->prov_transport_destroy(prov_info->transport_handle);
     prov_info->transport_handle = NULL;
@@ -715,9 +966,8 @@ PROV_DEVICE_LL_HANDLE Prov_Device_LL_Create(const char* uri, const char* id_scop
                 }
                 else
                 {
-                    // Ensure that we are passed the throttling time and send on the first send
+                    // The first status poll has no interval to wait for
                     (void)tickcounter_get_current_ms(result->tick_counter, &result->status_throttle);
-                    result->status_throttle += (PROV_GET_THROTTLE_TIME * 1000);
                 }
             }
         }
@@ -751,6 +1001,23 @@ PROV_DEVICE_RESULT Prov_Device_LL_Register_Device(PROV_DEVICE_LL_HANDLE handle,
         LogError("failure: Unable to retrieve registration Id from device auth.");
         result = PROV_DEVICE_RESULT_ERROR;
     }
+    else if (handle->hsm_handed_off)
+    {
+        LogError("the hsm was handed off to the iothub client, create a new provisioning client to register again");
+        result = PROV_DEVICE_RESULT_ERROR;
+    }
+    else if (handle->prov_state == CLIENT_STATE_READY && load_cached_assignment(handle) == 0)
+    {
+        // The device was assigned on an earlier boot, report that assignment on the next DoWork without contacting the service
+        handle->register_callback = register_callback;
+        handle->user_context = user_context;
+
+        handle->register_status_cb = reg_status_cb;
+        handle->status_user_ctx = status_ctx;
+
+        handle->prov_state = CLIENT_STATE_CACHE_HIT;
+        result = PROV_DEVICE_RESULT_OK;
+    }
     else
     {
         BUFFER_HANDLE ek_value = NULL;
@@ -837,8 +1104,20 @@ PROV_DEVICE_RESULT Prov_Device_LL_Register_Device(PROV_DEVICE_LL_HANDLE handle,
                     {
                         result = PROV_DEVICE_RESULT_OK;
                     }
-                    free(x509_cert);
-                    free(x509_private_key);
+
+                    if (result == PROV_DEVICE_RESULT_OK && handle->handoff_to_iothub)
+                    {
+                        // Kept for the iothub client so it does not read them from the hsm again
+                        free(handle->x509_certificate);
+                        free(handle->x509_alias_key);
+                        handle->x509_certificate = x509_cert;
+                        handle->x509_alias_key = x509_private_key;
+                    }
+                    else
+                    {
+                        free(x509_cert);
+                        free(x509_private_key);
+                    }
                 }
             }
             else
@@ -874,6 +1153,11 @@ PROV_DEVICE_RESULT Prov_Device_LL_Register_Device(PROV_DEVICE_LL_HANDLE handle,
             {
                 handle->transport_open = true;
                 handle->prov_state = CLIENT_STATE_REGISTER_SEND;
+                handle->status_poll_interval = 0;
+                handle->status_polls_sent = 0;
+                handle->register_retry_interval = 0;
+                handle->registration_started = false;
+                handle->is_time_to_assigned_set = false;
                 /* Codes_SRS_PROV_CLIENT_07_009: [ Upon success Prov_Device_LL_Register_Device shall return PROV_CLIENT_OK. ] */
                 result = PROV_DEVICE_RESULT_OK;
             }
@@ -891,29 +1175,38 @@ void Prov_Device_LL_DoWork(PROV_DEVICE_LL_HANDLE handle)
     {
         PROV_INSTANCE_INFO* prov_info = (PROV_INSTANCE_INFO*)handle;
         /* Codes_SRS_PROV_CLIENT_07_011: [ Prov_Device_LL_DoWork shall call the underlying http_client_dowork function ] */
-        if (prov_info->prov_state != CLIENT_STATE_ERROR)
+        if (prov_info->prov_state != CLIENT_STATE_ERROR && prov_info->prov_state != CLIENT_STATE_CACHE_HIT)
         {
             prov_info->prov_transport_protocol->prov_transport_dowork(prov_info->transport_handle);
         }
-        if (prov_info->is_connected || prov_info->prov_state == CLIENT_STATE_ERROR)
+        if (prov_info->is_connected || prov_info->prov_state == CLIENT_STATE_ERROR || prov_info->prov_state == CLIENT_STATE_CACHE_HIT)
         {
             switch (prov_info->prov_state)
             {
                 case CLIENT_STATE_REGISTER_SEND:
-                    /* Codes_SRS_PROV_CLIENT_07_013: [ CLIENT_STATE_REGISTER_SEND which shall construct an initial call to the service with endorsement information ] */
-                    if (prov_info->prov_transport_protocol->prov_transport_register(prov_info->transport_handle, prov_transport_process_json_reply, prov_info) != 0)
+                    // The service throttled the last request, hold the retry until its retry-after has passed
+                    if (!is_register_retry_held(prov_info))
                     {
-                        LogError("Failure registering device");
-                        if (prov_info->error_reason == PROV_DEVICE_RESULT_OK)
+                        /* Codes_SRS_PROV_CLIENT_07_013: [ CLIENT_STATE_REGISTER_SEND which shall construct an initial call to the service with endorsement information ] */
+                        if (prov_info->prov_transport_protocol->prov_transport_register(prov_info->transport_handle, prov_transport_process_json_reply, prov_info) != 0)
                         {
-                            prov_info->error_reason = PROV_DEVICE_RESULT_TRANSPORT;
+                            LogError("Failure registering device");
+                            if (prov_info->error_reason == PROV_DEVICE_RESULT_OK)
+                            {
+                                prov_info->error_reason = PROV_DEVICE_RESULT_TRANSPORT;
+                            }
+                            prov_info->prov_state = CLIENT_STATE_ERROR;
+                        }
+                        else
+                        {
+                            (void)tickcounter_get_current_ms(prov_info->tick_counter, &prov_info->timeout_value);
+                            if (!prov_info->registration_started)
+                            {
+                                prov_info->registration_start = prov_info->timeout_value;
+                                prov_info->registration_started = true;
+                            }
+                            prov_info->prov_state = CLIENT_STATE_REGISTER_SENT;
                         }
-                        prov_info->prov_state = CLIENT_STATE_ERROR;
-                    }
-                    else
-                    {
-                        (void)tickcounter_get_current_ms(prov_info->tick_counter, &prov_info->timeout_value);
-                        prov_info->prov_state = CLIENT_STATE_REGISTER_SENT;
                     }
                     break;
 
@@ -926,7 +1219,7 @@ void Prov_Device_LL_DoWork(PROV_DEVICE_LL_HANDLE handle)
                         prov_info->error_reason = PROV_DEVICE_RESULT_ERROR;
                         prov_info->prov_state = CLIENT_STATE_ERROR;
                     }
-                    else if ( (current_time - prov_info->status_throttle) / 1000 > PROV_GET_THROTTLE_TIME)
+                    else if (prov_info->status_poll_interval == 0 || (current_time - prov_info->status_throttle) >= prov_info->status_poll_interval)
                     {
                         /* Codes_SRS_PROV_CLIENT_07_026: [ Upon receiving the reply of the CLIENT_STATE_URL_REQ_SEND message from  iothub_client shall process the the reply of the CLIENT_STATE_URL_REQ_SEND state ] */
                         if (prov_info->prov_transport_protocol->prov_transport_get_op_status(prov_info->transport_handle) != 0)
@@ -940,6 +1233,7 @@ void Prov_Device_LL_DoWork(PROV_DEVICE_LL_HANDLE handle)
                         }
                         else
                         {
+                            prov_info->status_polls_sent++;
                             prov_info->prov_state = CLIENT_STATE_STATUS_SENT;
                             if (tickcounter_get_current_ms(prov_info->tick_counter, &prov_info->timeout_value) != 0)
                             {
@@ -973,6 +1267,20 @@ void Prov_Device_LL_DoWork(PROV_DEVICE_LL_HANDLE handle)
                 case CLIENT_STATE_READY:
                     break;
 
+                case CLIENT_STATE_HSM_PENDING:
+                    // The transport keeps being pumped above while the hsm works, the completion runs here
+                    prov_hsm_job_queue_dowork(prov_info->hsm_job_queue);
+                    break;
+
+                case CLIENT_STATE_CACHE_HIT:
+                    prov_info->time_to_assigned = 0;
+                    prov_info->is_time_to_assigned_set = true;
+                    handoff_hsm_to_iothub(prov_info);
+                    prov_info->register_callback(PROV_DEVICE_RESULT_OK, prov_info->iothub_info.iothub_url, prov_info->iothub_info.device_id, prov_info->user_context);
+                    prov_info->prov_state = CLIENT_STATE_READY;
+                    cleanup_prov_info(prov_info);
+                    break;
+
                 case CLIENT_STATE_ERROR:
                 default:
                     prov_info->register_callback(prov_info->error_reason, NULL, NULL, prov_info->user_context);
@@ -1063,6 +1371,90 @@ PROV_DEVICE_RESULT Prov_Device_LL_SetOption(PROV_DEVICE_LL_HANDLE handle, const
                 result = PROV_DEVICE_RESULT_OK;
             }
         }
+        else if (strcmp(PROV_OPTION_HANDOFF_TO_IOTHUB, option_name) == 0)
+        {
+            if (value == NULL)
+            {
+                LogError("value must be set to a bool");
+                result = PROV_DEVICE_RESULT_ERROR;
+            }
+            else if (handle->prov_state != CLIENT_STATE_READY)
+            {
+                LogError("hsm handoff cannot be set after registration has begun");
+                result = PROV_DEVICE_RESULT_ERROR;
+            }
+            else
+            {
+                handle->handoff_to_iothub = *((bool*)value);
+                result = PROV_DEVICE_RESULT_OK;
+            }
+        }
+        else if (strcmp(PROV_OPTION_ASYNC_HSM, option_name) == 0)
+        {
+            if (value == NULL)
+            {
+                LogError("value must be set to a bool");
+                result = PROV_DEVICE_RESULT_ERROR;
+            }
+            else if (handle->prov_state != CLIENT_STATE_READY)
+            {
+                LogError("async hsm cannot be set after registration has begun");
+                result = PROV_DEVICE_RESULT_ERROR;
+            }
+            else if (*((bool*)value))
+            {
+                if (handle->hsm_job_queue == NULL && (handle->hsm_job_queue = prov_hsm_job_queue_create()) == NULL)
+                {
+                    LogError("Failure creating the hsm job queue");
+                    result = PROV_DEVICE_RESULT_ERROR;
+                }
+                else
+                {
+                    result = PROV_DEVICE_RESULT_OK;
+                }
+            }
+            else
+            {
+                if (handle->hsm_job_queue != NULL)
+                {
+                    prov_hsm_job_queue_destroy(handle->hsm_job_queue);
+                    handle->hsm_job_queue = NULL;
+                }
+                result = PROV_DEVICE_RESULT_OK;
+            }
+        }
+        else if (strcmp(PROV_OPTION_ASSIGNMENT_CACHE, option_name) == 0)
+        {
+            if (handle->prov_state != CLIENT_STATE_READY)
+            {
+                LogError("assignment cache cannot be set after registration has begun");
+                result = PROV_DEVICE_RESULT_ERROR;
+            }
+            else if (value == NULL)
+            {
+                memset(&handle->assignment_cache, 0, sizeof(PROV_DEVICE_ASSIGNMENT_CACHE));
+                result = PROV_DEVICE_RESULT_OK;
+            }
+            else
+            {
+                handle->assignment_cache = *((const PROV_DEVICE_ASSIGNMENT_CACHE*)value);
+                result = PROV_DEVICE_RESULT_OK;
+            }
+        }
+        else if (strcmp(PROV_OPTION_SKIP_ASSIGNMENT_CACHE, option_name) == 0)
+        {
+            if (value == NULL)
+            {
+                LogError("value must be set to a bool");
+                result = PROV_DEVICE_RESULT_ERROR;
+            }
+            else
+            {
+                // Set after the iothub rejected the cached assignment, cleared once the service assigns the device again
+                handle->skip_assignment_cache = *((bool*)value);
+                result = PROV_DEVICE_RESULT_OK;
+            }
+        }
         else if (strcmp(PROV_REGISTRATION_ID, option_name) == 0)
         {
             if (handle->prov_state != CLIENT_STATE_READY)
@@ -1117,6 +1509,27 @@ PROV_DEVICE_RESULT Prov_Device_LL_SetOption(PROV_DEVICE_LL_HANDLE handle, const
     return result;
 }
 
+PROV_DEVICE_RESULT Prov_Device_LL_GetTimeToAssigned(PROV_DEVICE_LL_HANDLE handle, uint32_t* time_to_assigned)
+{
+    PROV_DEVICE_RESULT result;
+    if (handle == NULL || time_to_assigned == NULL)
+    {
+        LogError("Invalid parameter specified handle: %p time_to_assigned: %p", handle, time_to_assigned);
+        result = PROV_DEVICE_RESULT_INVALID_ARG;
+    }
+    else if (!handle->is_time_to_assigned_set)
+    {
+        LogError("The device has not been assigned");
+        result = PROV_DEVICE_RESULT_INVALID_STATE;
+    }
+    else
+    {
+        *time_to_assigned = (uint32_t)handle->time_to_assigned;
+        result = PROV_DEVICE_RESULT_OK;
+    }
+    return result;
+}
+
 const char* Prov_Device_LL_GetVersionString(void)
 {
     return PROV_DEVICE_CLIENT_VERSION;
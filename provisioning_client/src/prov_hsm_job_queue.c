@@ -0,0 +1,255 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+#include "azure_c_shared_utility/threadapi.h"
+
+#include "azure_prov_client/internal/prov_hsm_job_queue.h"
+
+typedef struct PROV_HSM_JOB_TAG
+{
+    PROV_HSM_JOB_FUNCTION job;
+    void* job_context;
+    PROV_HSM_JOB_COMPLETE_CALLBACK on_complete;
+    void* user_context;
+    int job_result;
+    struct PROV_HSM_JOB_TAG* next;
+} PROV_HSM_JOB;
+
+typedef struct PROV_HSM_JOB_LIST_TAG
+{
+    PROV_HSM_JOB* head;
+    PROV_HSM_JOB* tail;
+} PROV_HSM_JOB_LIST;
+
+typedef struct PROV_HSM_JOB_QUEUE_INFO_TAG
+{
+    LOCK_HANDLE lock;
+    COND_HANDLE job_available;
+    THREAD_HANDLE worker;
+    bool stop_worker;
+
+    // Both lists are only touched with lock held
+    PROV_HSM_JOB_LIST pending;
+    PROV_HSM_JOB_LIST completed;
+} PROV_HSM_JOB_QUEUE_INFO;
+
+static void job_list_append(PROV_HSM_JOB_LIST* list, PROV_HSM_JOB* job)
+{
+    job->next = NULL;
+    if (list->tail == NULL)
+    {
+        list->head = job;
+    }
+    else
+    {
+        list->tail->next = job;
+    }
+    list->tail = job;
+}
+
+static PROV_HSM_JOB* job_list_detach(PROV_HSM_JOB_LIST* list)
+{
+    PROV_HSM_JOB* result = list->head;
+    list->head = NULL;
+    list->tail = NULL;
+    return result;
+}
+
+static void job_list_free(PROV_HSM_JOB* job)
+{
+    while (job != NULL)
+    {
+        PROV_HSM_JOB* next = job->next;
+        free(job);
+        job = next;
+    }
+}
+
+static int hsm_job_worker(void* arg)
+{
+    PROV_HSM_JOB_QUEUE_INFO* queue_info = (PROV_HSM_JOB_QUEUE_INFO*)arg;
+
+    if (Lock(queue_info->lock) != LOCK_OK)
+    {
+        LogError("Failure locking the hsm job queue, the worker is stopping");
+    }
+    else
+    {
+        bool is_locked = true;
+        while (is_locked && !queue_info->stop_worker)
+        {
+            if (queue_info->pending.head == NULL)
+            {
+                (void)Condition_Wait(queue_info->job_available, queue_info->lock, 0);
+            }
+            else
+            {
+                PROV_HSM_JOB* job = queue_info->pending.head;
+                queue_info->pending.head = job->next;
+                if (queue_info->pending.head == NULL)
+                {
+                    queue_info->pending.tail = NULL;
+                }
+
+                // The hsm call is what may take long, it must not hold up submit or dowork
+                (void)Unlock(queue_info->lock);
+                job->job_result = job->job(job->job_context);
+                if (Lock(queue_info->lock) != LOCK_OK)
+                {
+                    LogError("Failure locking the hsm job queue, the worker is stopping");
+                    free(job);
+                    is_locked = false;
+                }
+                else
+                {
+                    job_list_append(&queue_info->completed, job);
+                }
+            }
+        }
+        if (is_locked)
+        {
+            (void)Unlock(queue_info->lock);
+        }
+    }
+    return 0;
+}
+
+PROV_HSM_JOB_QUEUE_HANDLE prov_hsm_job_queue_create(void)
+{
+    PROV_HSM_JOB_QUEUE_INFO* result;
+    if ((result = (PROV_HSM_JOB_QUEUE_INFO*)malloc(sizeof(PROV_HSM_JOB_QUEUE_INFO))) == NULL)
+    {
+        LogError("Failure allocating the hsm job queue");
+    }
+    else
+    {
+        memset(result, 0, sizeof(PROV_HSM_JOB_QUEUE_INFO));
+        if ((result->lock = Lock_Init()) == NULL)
+        {
+            LogError("Failure creating the hsm job queue lock");
+            free(result);
+            result = NULL;
+        }
+        else if ((result->job_available = Condition_Init()) == NULL)
+        {
+            LogError("Failure creating the hsm job queue condition");
+            Lock_Deinit(result->lock);
+            free(result);
+            result = NULL;
+        }
+        else if (ThreadAPI_Create(&result->worker, hsm_job_worker, result) != THREADAPI_OK)
+        {
+            LogError("Failure starting the hsm job queue worker");
+            Condition_Deinit(result->job_available);
+            Lock_Deinit(result->lock);
+            free(result);
+            result = NULL;
+        }
+    }
+    return result;
+}
+
+void prov_hsm_job_queue_destroy(PROV_HSM_JOB_QUEUE_HANDLE handle)
+{
+    if (handle != NULL)
+    {
+        int worker_result;
+        LOCK_RESULT lock_result = Lock(handle->lock);
+
+        // The worker has to be stopped either way, otherwise the join below never returns
+        if (lock_result != LOCK_OK)
+        {
+            LogError("Failure locking the hsm job queue");
+        }
+        handle->stop_worker = true;
+        (void)Condition_Post(handle->job_available);
+        if (lock_result == LOCK_OK)
+        {
+            (void)Unlock(handle->lock);
+        }
+
+        if (ThreadAPI_Join(handle->worker, &worker_result) != THREADAPI_OK)
+        {
+            LogError("Failure joining the hsm job queue worker");
+        }
+
+        job_list_free(job_list_detach(&handle->pending));
+        job_list_free(job_list_detach(&handle->completed));
+        Condition_Deinit(handle->job_available);
+        Lock_Deinit(handle->lock);
+        free(handle);
+    }
+}
+
+int prov_hsm_job_queue_submit(PROV_HSM_JOB_QUEUE_HANDLE handle, PROV_HSM_JOB_FUNCTION job, void* job_context, PROV_HSM_JOB_COMPLETE_CALLBACK on_complete, void* user_context)
+{
+    int result;
+    PROV_HSM_JOB* hsm_job;
+
+    if (handle == NULL || job == NULL || on_complete == NULL)
+    {
+        LogError("Invalid parameter specified handle: %p, job: %p, on_complete: %p", handle, job, on_complete);
+        result = __FAILURE__;
+    }
+    else if ((hsm_job = (PROV_HSM_JOB*)malloc(sizeof(PROV_HSM_JOB))) == NULL)
+    {
+        LogError("Failure allocating hsm job");
+        result = __FAILURE__;
+    }
+    else
+    {
+        memset(hsm_job, 0, sizeof(PROV_HSM_JOB));
+        hsm_job->job = job;
+        hsm_job->job_context = job_context;
+        hsm_job->on_complete = on_complete;
+        hsm_job->user_context = user_context;
+
+        if (Lock(handle->lock) != LOCK_OK)
+        {
+            LogError("Failure locking the hsm job queue");
+            free(hsm_job);
+            result = __FAILURE__;
+        }
+        else
+        {
+            job_list_append(&handle->pending, hsm_job);
+            (void)Condition_Post(handle->job_available);
+            (void)Unlock(handle->lock);
+            result = 0;
+        }
+    }
+    return result;
+}
+
+void prov_hsm_job_queue_dowork(PROV_HSM_JOB_QUEUE_HANDLE handle)
+{
+    if (handle != NULL)
+    {
+        if (Lock(handle->lock) != LOCK_OK)
+        {
+            LogError("Failure locking the hsm job queue");
+        }
+        else
+        {
+            // Callbacks run unlocked so they are free to submit the next job
+            PROV_HSM_JOB* job = job_list_detach(&handle->completed);
+            (void)Unlock(handle->lock);
+
+            while (job != NULL)
+            {
+                PROV_HSM_JOB* next = job->next;
+                job->on_complete(job->job_result, job->user_context);
+                free(job);
+                job = next;
+            }
+        }
+    }
+}
@@ -7,6 +7,7 @@
 #include "azure_c_shared_utility/crt_abstractions.h"
 #include "azure_prov_client/prov_security_factory.h"
 #include "azure_prov_client/iothub_security_factory.h"
+#include "azure_prov_client/internal/iothub_auth_client.h"
 
 #include "hsm_client_data.h"
 
@@ -102,6 +103,8 @@ void prov_dev_security_deinit(void)
         free(g_symm_key_reg_name);
         g_symm_key_reg_name = NULL;
     }
+    // An hsm client handed off by provisioning but never picked up by the iothub client is closed here
+    iothub_device_auth_clear_handoff();
     deinitialize_hsm_system();
     if (iothub_security_get_symmetric_key() != NULL || iothub_security_get_symm_registration_name() != NULL)
     {
@@ -0,0 +1,155 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/crt_abstractions.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/optionhandler.h"
+
+#include "azure_prov_client/prov_tls_session_cache.h"
+
+// Same name as the option of the IoT Hub transports, TLS adapters without session resumption reject it
+static const char* const TLS_SESSION_RESUMPTION_OPTION = "tls_session_resumption";
+
+typedef struct PROV_TLS_SESSION_CACHE_INFO_TAG
+{
+    LOCK_HANDLE lock;
+
+    // Both are only touched with lock held
+    char* hostname;
+    OPTIONHANDLER_HANDLE tls_options;
+} PROV_TLS_SESSION_CACHE_INFO;
+
+PROV_TLS_SESSION_CACHE_HANDLE prov_tls_session_cache_create(void)
+{
+    PROV_TLS_SESSION_CACHE_INFO* result;
+
+    if ((result = (PROV_TLS_SESSION_CACHE_INFO*)malloc(sizeof(PROV_TLS_SESSION_CACHE_INFO))) == NULL)
+    {
+        LogError("Failure allocating the tls session cache");
+    }
+    else
+    {
+        memset(result, 0, sizeof(PROV_TLS_SESSION_CACHE_INFO));
+        if ((result->lock = Lock_Init()) == NULL)
+        {
+            LogError("Failure creating the tls session cache lock");
+            free(result);
+            result = NULL;
+        }
+    }
+    return result;
+}
+
+void prov_tls_session_cache_destroy(PROV_TLS_SESSION_CACHE_HANDLE handle)
+{
+    if (handle != NULL)
+    {
+        if (handle->tls_options != NULL)
+        {
+            OptionHandler_Destroy(handle->tls_options);
+        }
+        free(handle->hostname);
+        (void)Lock_Deinit(handle->lock);
+        free(handle);
+    }
+}
+
+int prov_tls_session_cache_apply(PROV_TLS_SESSION_CACHE_HANDLE handle, const char* hostname, XIO_HANDLE tls_io)
+{
+    int result;
+
+    if (handle == NULL || hostname == NULL || tls_io == NULL)
+    {
+        LogError("Invalid parameter specified handle: %p, hostname: %p, tls_io: %p", handle, hostname, tls_io);
+        result = __FAILURE__;
+    }
+    else
+    {
+        bool resume_session = true;
+
+        // Asked even without saved options, so that the session of this connection is exported when it is stored
+        if (xio_setoption(tls_io, TLS_SESSION_RESUMPTION_OPTION, &resume_session) != 0)
+        {
+            LogInfo("The tls adapter does not resume sessions, the saved options are still applied");
+        }
+
+        if (Lock(handle->lock) != LOCK_OK)
+        {
+            LogError("Failure locking the tls session cache");
+            result = __FAILURE__;
+        }
+        else
+        {
+            if (handle->tls_options == NULL || strcmp(handle->hostname, hostname) != 0)
+            {
+                result = __FAILURE__;
+            }
+            else if (OptionHandler_FeedOptions(handle->tls_options, tls_io) != OPTIONHANDLER_OK)
+            {
+                LogError("Failure feeding the saved tls options");
+                result = __FAILURE__;
+            }
+            else
+            {
+                result = 0;
+            }
+            (void)Unlock(handle->lock);
+        }
+    }
+    return result;
+}
+
+int prov_tls_session_cache_store(PROV_TLS_SESSION_CACHE_HANDLE handle, const char* hostname, XIO_HANDLE tls_io)
+{
+    int result;
+    OPTIONHANDLER_HANDLE tls_options;
+    char* saved_hostname;
+
+    if (handle == NULL || hostname == NULL || tls_io == NULL)
+    {
+        LogError("Invalid parameter specified handle: %p, hostname: %p, tls_io: %p", handle, hostname, tls_io);
+        result = __FAILURE__;
+    }
+    else if ((tls_options = xio_retrieveoptions(tls_io)) == NULL)
+    {
+        LogError("Failure retrieving the tls options");
+        result = __FAILURE__;
+    }
+    else if (mallocAndStrcpy_s(&saved_hostname, hostname) != 0)
+    {
+        LogError("Failure copying the hostname");
+        OptionHandler_Destroy(tls_options);
+        result = __FAILURE__;
+    }
+    else if (Lock(handle->lock) != LOCK_OK)
+    {
+        LogError("Failure locking the tls session cache");
+        free(saved_hostname);
+        OptionHandler_Destroy(tls_options);
+        result = __FAILURE__;
+    }
+    else
+    {
+        OPTIONHANDLER_HANDLE previous_options = handle->tls_options;
+        char* previous_hostname = handle->hostname;
+
+        handle->tls_options = tls_options;
+        handle->hostname = saved_hostname;
+        (void)Unlock(handle->lock);
+
+        // Destroyed outside of the lock, other handles can apply the new options meanwhile
+        if (previous_options != NULL)
+        {
+            OptionHandler_Destroy(previous_options);
+        }
+        free(previous_hostname);
+        result = 0;
+    }
+    return result;
+}
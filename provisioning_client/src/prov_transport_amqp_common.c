@@ -4,6 +4,7 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/platform.h"
 #include "azure_c_shared_utility/xlogging.h"
@@ -21,6 +22,7 @@
 #include "azure_uamqp_c/saslclientio.h"
 #include "azure_uamqp_c/sasl_plain.h"
 #include "azure_prov_client/internal/prov_sasl_tpm.h"
+#include "azure_prov_client/prov_tls_session_cache.h"
 #include "azure_c_shared_utility/strings.h"
 
 #include "azure_prov_client/prov_client_const.h"
@@ -121,6 +123,8 @@ typedef struct PROV_TRANSPORT_AMQP_INFO_TAG
 
     PROV_TRANSPORT_ERROR_CALLBACK error_cb;
     void* error_ctx;
+
+    PROV_TLS_SESSION_CACHE_HANDLE tls_session_cache;
 } PROV_TRANSPORT_AMQP_INFO;
 
 static char* on_sasl_tpm_challenge_cb(BUFFER_HANDLE data_handle, void* user_ctx)
@@ -182,7 +186,7 @@ static void on_message_sender_state_changed_callback(void* context, MESSAGE_SEND
                         amqp_info->amqp_state = AMQP_STATE_CONNECTED;
                         if (amqp_info->status_cb != NULL)
                         {
-                            amqp_info->status_cb(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, amqp_info->status_ctx);
+                            amqp_info->status_cb(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, 0, amqp_info->status_ctx);
                         }
                     }
                     break;
@@ -220,7 +224,7 @@ static void on_message_receiver_state_changed_callback(const void* user_ctx, MES
                     amqp_info->amqp_state = AMQP_STATE_CONNECTED;
                     if (amqp_info->status_cb != NULL)
                     {
-                        amqp_info->status_cb(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, amqp_info->status_ctx);
+                        amqp_info->status_cb(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, 0, amqp_info->status_ctx);
                     }
                 }
                 break;
@@ -695,6 +699,12 @@ static int create_transport_io_object(PROV_TRANSPORT_AMQP_INFO* amqp_info)
     return result;
 }
 
+static XIO_HANDLE get_tls_io(PROV_TRANSPORT_AMQP_INFO* amqp_info)
+{
+    // With sasl the tls io sits under the sasl io
+    return (amqp_info->transport_io != NULL) ? amqp_info->transport_io : amqp_info->underlying_io;
+}
+
 static int create_amqp_connection(PROV_TRANSPORT_AMQP_INFO* amqp_info)
 {
     int result;
@@ -706,6 +716,13 @@ static int create_amqp_connection(PROV_TRANSPORT_AMQP_INFO* amqp_info)
     }
     else
     {
+        /* Codes_PROV_TRANSPORT_AMQP_COMMON_41_003: [ If a PROV_OPTION_TLS_SESSION_CACHE is set, the tls io shall be given the saved options with prov_tls_session_cache_apply before the certificates are set on it; a failure shall be ignored. ] */
+        // The saved options go first so that the certificates of this handle are set over them
+        if (amqp_info->tls_session_cache != NULL)
+        {
+            (void)prov_tls_session_cache_apply(amqp_info->tls_session_cache, amqp_info->hostname, get_tls_io(amqp_info));
+        }
+
         if (amqp_info->hsm_type == TRANSPORT_HSM_TYPE_X509)
         {
             if (amqp_info->x509_cert != NULL && amqp_info->private_key != NULL)
@@ -1172,6 +1189,12 @@ int prov_transport_common_amqp_close(PROV_DEVICE_TRANSPORT_HANDLE handle)
             connection_destroy(amqp_info->connection);
             amqp_info->connection = NULL;
         }
+        /* Codes_PROV_TRANSPORT_AMQP_COMMON_41_002: [ If a PROV_OPTION_TLS_SESSION_CACHE is set and the tls io exists, prov_transport_common_amqp_close shall save its options with prov_tls_session_cache_store before destroying it; a failure shall be logged and ignored. ] */
+        if (amqp_info->tls_session_cache != NULL && get_tls_io(amqp_info) != NULL &&
+            prov_tls_session_cache_store(amqp_info->tls_session_cache, amqp_info->hostname, get_tls_io(amqp_info)) != 0)
+        {
+            LogInfo("The tls options of the connection were not saved, the next one runs a full handshake");
+        }
         xio_destroy(amqp_info->transport_io);
         amqp_info->transport_io = NULL;
         xio_destroy(amqp_info->underlying_io);
@@ -1330,7 +1353,7 @@ void prov_transport_common_amqp_dowork(PROV_DEVICE_TRANSPORT_HANDLE handle)
                                 {
                                     if (amqp_info->status_cb != NULL)
                                     {
-                                        amqp_info->status_cb(parse_info->prov_status, amqp_info->status_ctx);
+                                        amqp_info->status_cb(parse_info->prov_status, 0, amqp_info->status_ctx);
                                     }
                                 }
                                 break;
@@ -1587,7 +1610,14 @@ int prov_transport_common_amqp_set_option(PROV_DEVICE_TRANSPORT_HANDLE handle, c
     else
     {
         PROV_TRANSPORT_AMQP_INFO* amqp_info = (PROV_TRANSPORT_AMQP_INFO*)handle;
-        if (amqp_info->underlying_io == NULL && create_transport_io_object(amqp_info) != 0)
+        if (strcmp(PROV_OPTION_TLS_SESSION_CACHE, option) == 0)
+        {
+            /* Codes_PROV_TRANSPORT_AMQP_COMMON_41_001: [ If option is PROV_OPTION_TLS_SESSION_CACHE, prov_transport_common_amqp_set_option shall keep value as the PROV_TLS_SESSION_CACHE_HANDLE of the transport, without creating the tls io, and return zero. ] */
+            // Owned by the application, used from the next connection on
+            amqp_info->tls_session_cache = (PROV_TLS_SESSION_CACHE_HANDLE)value;
+            result = 0;
+        }
+        else if (amqp_info->underlying_io == NULL && create_transport_io_object(amqp_info) != 0)
         {
             LogError("Failure creating transport io object");
             result = __FAILURE__;
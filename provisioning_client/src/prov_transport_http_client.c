@@ -31,6 +31,7 @@ static const char* const HEADER_USER_AGENT = "UserAgent";
 static const char* const HEADER_ACCEPT = "Accept";
 static const char* const HEADER_CONTENT_TYPE = "Content-Type";
 static const char* const HEADER_CONNECTION = "Connection";
+static const char* const HEADER_RETRY_AFTER = "retry-after";
 static const char* const USER_AGENT_VALUE = "prov_device_client/1.0";
 static const char* const ACCEPT_VALUE = "application/json";
 static const char* const CONTENT_TYPE_VALUE = "application/json; charset=utf-8";
@@ -93,6 +94,7 @@ typedef struct PROV_TRANSPORT_HTTP_INFO_TAG
 
     char* payload_data;
     unsigned int http_status_code;
+    uint32_t retry_interval;
 
     bool http_connected;
     bool log_trace;
@@ -120,9 +122,27 @@ static void on_http_error(void* callback_ctx, HTTP_CALLBACK_REASON error_result)
     }
 }
 
+static uint32_t get_retry_interval(HTTP_HEADERS_HANDLE response_headers)
+{
+    uint32_t result = 0;
+    if (response_headers != NULL)
+    {
+        // The service sends a retry-after header in seconds with the assigning and throttled replies
+        const char* retry_after = HTTPHeaders_FindHeaderValue(response_headers, HEADER_RETRY_AFTER);
+        if (retry_after != NULL)
+        {
+            long retry_interval = atol(retry_after);
+            if (retry_interval > 0)
+            {
+                result = (uint32_t)retry_interval;
+            }
+        }
+    }
+    return result;
+}
+
 static void on_http_reply_recv(void* callback_ctx, HTTP_CALLBACK_REASON request_result, const unsigned char* content, size_t content_len, unsigned int status_code, HTTP_HEADERS_HANDLE responseHeadersHandle)
 {
-    (void)responseHeadersHandle;
     if (callback_ctx != NULL)
     {
         PROV_TRANSPORT_HTTP_INFO* http_info = (PROV_TRANSPORT_HTTP_INFO*)callback_ctx;
@@ -134,6 +154,7 @@ static void on_http_reply_recv(void* callback_ctx, HTTP_CALLBACK_REASON request_
         }
         else if ((status_code >= HTTP_STATUS_CODE_OK && status_code <= HTTP_STATUS_CODE_OK_MAX) || status_code == HTTP_STATUS_CODE_UNAUTHORIZED)
         {
+            http_info->retry_interval = get_retry_interval(responseHeadersHandle);
             if (content != NULL && content_len > 0)
             {
                 /* Codes_PROV_TRANSPORT_HTTP_CLIENT_07_038: [ prov_transport_http_dowork shall free the payload_data ] */
@@ -176,6 +197,7 @@ static void on_http_reply_recv(void* callback_ctx, HTTP_CALLBACK_REASON request_
         else if (status_code >= PROV_STATUS_CODE_TRANSIENT_ERROR)
         {
             // On transient error reset the transport to send state
+            http_info->retry_interval = get_retry_interval(responseHeadersHandle);
             http_info->transport_state = TRANSPORT_CLIENT_STATE_TRANSIENT;
         }
         else
@@ -199,7 +221,7 @@ static void on_http_connected(void* callback_ctx, HTTP_CALLBACK_REASON open_resu
         {
             if (http_info->status_cb != NULL)
             {
-                http_info->status_cb(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, http_info->status_ctx);
+                http_info->status_cb(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, 0, http_info->status_ctx);
             }
             http_info->http_connected = true;
         }
@@ -984,7 +1006,7 @@ void prov_transport_http_dowork(PROV_DEVICE_TRANSPORT_HANDLE handle)
                             {
                                 if (http_info->status_cb != NULL)
                                 {
-                                    http_info->status_cb(parse_info->prov_status, http_info->status_ctx);
+                                    http_info->status_cb(parse_info->prov_status, http_info->retry_interval, http_info->status_ctx);
                                 }
                                 http_info->transport_state = TRANSPORT_CLIENT_STATE_IDLE;
                             }
@@ -1004,7 +1026,7 @@ void prov_transport_http_dowork(PROV_DEVICE_TRANSPORT_HANDLE handle)
             case TRANSPORT_CLIENT_STATE_TRANSIENT:
                 if (http_info->status_cb != NULL)
                 {
-                    http_info->status_cb(PROV_DEVICE_TRANSPORT_STATUS_TRANSIENT, http_info->status_ctx);
+                    http_info->status_cb(PROV_DEVICE_TRANSPORT_STATUS_TRANSIENT, http_info->retry_interval, http_info->status_ctx);
                 }
                 http_info->transport_state = TRANSPORT_CLIENT_STATE_IDLE;
                 break;
@@ -29,6 +29,7 @@ static const char* const MQTT_USERNAME_FMT = "%s/registrations/%s/api-version=%s
 static const char* const MQTT_REGISTER_MESSAGE_FMT = "$dps/registrations/PUT/iotdps-register/?$rid=%d";
 static const char* const MQTT_STATUS_MESSAGE_FMT = "$dps/registrations/GET/iotdps-get-operationstatus/?$rid=%d&operationId=%s";
 static const char* const MQTT_TOPIC_STATUS_PREFIX = "$dps/registrations/res/";
+static const char* const MQTT_TOPIC_RETRY_AFTER = "retry-after=";
 static const char* const KEY_NAME_VALUE = "registration";
 
 typedef enum MQTT_TRANSPORT_STATE_TAG
@@ -96,6 +97,7 @@ typedef struct PROV_TRANSPORT_MQTT_INFO_TAG
     bool log_trace;
 
     uint16_t packet_id;
+    uint32_t retry_interval;
 
     TRANSPORT_HSM_TYPE hsm_type;
 
@@ -286,6 +288,19 @@ static void mqtt_notification_callback(MQTT_MESSAGE_HANDLE handle, void* user_ct
             {
                 // If the status code is > 429 then this is a transient error
                 long status_code = atol(topic_resp + status_pos);
+                const char* retry_after = strstr(topic_resp + status_pos, MQTT_TOPIC_RETRY_AFTER);
+
+                // The service hints how long to wait before polling again
+                mqtt_info->retry_interval = 0;
+                if (retry_after != NULL)
+                {
+                    long retry_interval = atol(retry_after + strlen(MQTT_TOPIC_RETRY_AFTER));
+                    if (retry_interval > 0)
+                    {
+                        mqtt_info->retry_interval = (uint32_t)retry_interval;
+                    }
+                }
+
                 if (status_code >= PROV_STATUS_CODE_TRANSIENT_ERROR)
                 {
                     // On transient error reset the transport to send state
@@ -771,7 +786,7 @@ int prov_transport_common_mqtt_open(PROV_DEVICE_TRANSPORT_HANDLE handle, const c
         mqtt_info->status_ctx = status_ctx;
         mqtt_info->mqtt_state = MQTT_STATE_DISCONNECTED;
         // Must add a false connect here due to the protocol quirk
-        //mqtt_info->status_cb(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, mqtt_info->status_ctx);
+        //mqtt_info->status_cb(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, 0, mqtt_info->status_ctx);
         mqtt_info->challenge_cb = reg_challenge_cb;
         mqtt_info->challenge_ctx = challenge_ctx;
 
@@ -915,7 +930,7 @@ void prov_transport_common_mqtt_dowork(PROV_DEVICE_TRANSPORT_HANDLE handle)
             }
             else
             {
-                mqtt_info->status_cb(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, mqtt_info->status_ctx);
+                mqtt_info->status_cb(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, 0, mqtt_info->status_ctx);
                 mqtt_info->mqtt_state = MQTT_STATE_SUBSCRIBING;
             }
         }
@@ -990,7 +1005,7 @@ void prov_transport_common_mqtt_dowork(PROV_DEVICE_TRANSPORT_HANDLE handle)
                                     {
                                         if (mqtt_info->status_cb != NULL)
                                         {
-                                            mqtt_info->status_cb(parse_info->prov_status, mqtt_info->status_ctx);
+                                            mqtt_info->status_cb(parse_info->prov_status, mqtt_info->retry_interval, mqtt_info->status_ctx);
                                         }
                                         mqtt_info->transport_state = TRANSPORT_CLIENT_STATE_IDLE;
                                     }
@@ -1017,7 +1032,7 @@ void prov_transport_common_mqtt_dowork(PROV_DEVICE_TRANSPORT_HANDLE handle)
                     case TRANSPORT_CLIENT_STATE_TRANSIENT:
                         if (mqtt_info->status_cb != NULL)
                         {
-                            mqtt_info->status_cb(PROV_DEVICE_TRANSPORT_STATUS_TRANSIENT, mqtt_info->status_ctx);
+                            mqtt_info->status_cb(PROV_DEVICE_TRANSPORT_STATUS_TRANSIENT, mqtt_info->retry_interval, mqtt_info->status_ctx);
                         }
                         mqtt_info->transport_state = TRANSPORT_CLIENT_STATE_IDLE;
                         break;
@@ -251,6 +251,7 @@ HTTP_CALLBACK_REASON http_open_reason;
 HTTP_CALLBACK_REASON http_reply_recv_reason;
 static bool content_available;
 static bool timed_out;
+static bool g_fail_next_reply;
 
 static void my_uhttp_client_dowork(HTTP_CLIENT_HANDLE handle)
 {
@@ -258,13 +259,20 @@ static void my_uhttp_client_dowork(HTTP_CLIENT_HANDLE handle)
 
     const unsigned char* content = content_available ? TEST_REPLY_JSON : NULL;
 
-    if (g_uhttp_client_dowork_call_count == 0)
+    // A new connection reports its open first, a connection kept open goes straight to the reply
+    if (g_on_http_open != NULL)
     {
-        g_on_http_open(g_http_open_ctx, http_open_reason);
+        ON_HTTP_OPEN_COMPLETE_CALLBACK on_http_open = g_on_http_open;
+        g_on_http_open = NULL;
+        on_http_open(g_http_open_ctx, http_open_reason);
     }
-    else if (g_uhttp_client_dowork_call_count == 1)
+    else if (g_on_http_reply_recv != NULL)
     {
-        g_on_http_reply_recv(g_http_reply_recv_ctx, http_reply_recv_reason, content, 1, test_status_code_in_callback, TEST_HTTP_HEADERS_HANDLE);
+        ON_HTTP_REQUEST_CALLBACK on_http_reply_recv = g_on_http_reply_recv;
+        HTTP_CALLBACK_REASON reply_reason = g_fail_next_reply ? HTTP_CALLBACK_REASON_ERROR : http_reply_recv_reason;
+        g_on_http_reply_recv = NULL;
+        g_fail_next_reply = false;
+        on_http_reply_recv(g_http_reply_recv_ctx, reply_reason, content, 1, test_status_code_in_callback, TEST_HTTP_HEADERS_HANDLE);
     }
     else
     {
@@ -384,6 +392,7 @@ TEST_SUITE_CLEANUP(suite_cleanup)
 TEST_FUNCTION_INITIALIZE(method_init)
 {
     umock_c_reset_all_calls();
+    g_on_http_open = NULL;
     g_http_open_ctx = NULL;
     g_on_http_reply_recv = NULL;
     g_http_reply_recv_ctx = NULL;
@@ -394,6 +403,7 @@ TEST_FUNCTION_INITIALIZE(method_init)
     http_open_reason =  HTTP_CALLBACK_REASON_OK;
     content_available = true;
     timed_out = false;
+    g_fail_next_reply = false;
 }
 
 TEST_FUNCTION_CLEANUP(method_cleanup)
@@ -575,19 +585,25 @@ static void set_expected_calls_construct_json_signing_blob()
     STRICT_EXPECTED_CALL(STRING_delete(IGNORED_NUM_ARG));
 }
 
-static void set_expected_calls_send_and_poll_http_signing_request(bool post_data)
+static void set_expected_calls_send_and_poll_http_signing_request(bool post_data, bool connection_open, bool reply_ok)
 {
     STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_NUM_ARG)).SetReturn(post_data ? (unsigned char*)TEST_STRING_1 : NULL);
     STRICT_EXPECTED_CALL(get_time(IGNORED_NUM_ARG)).SetReturn(TEST_TIME_T);
     STRICT_EXPECTED_CALL(uhttp_client_execute_request(IGNORED_PTR_ARG, post_data ? HTTP_CLIENT_REQUEST_POST : HTTP_CLIENT_REQUEST_GET, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    if (!connection_open)
+    {
+        STRICT_EXPECTED_CALL(uhttp_client_dowork(IGNORED_NUM_ARG));
+        STRICT_EXPECTED_CALL(get_time(IGNORED_NUM_ARG)).SetReturn(timed_out ? TEST_TIME_FOR_TIMEOUT_T : TEST_TIME_T);
+    }
     STRICT_EXPECTED_CALL(uhttp_client_dowork(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(get_time(IGNORED_NUM_ARG)).SetReturn(timed_out ? TEST_TIME_FOR_TIMEOUT_T : TEST_TIME_T);
-    STRICT_EXPECTED_CALL(uhttp_client_dowork(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(BUFFER_create(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    if (reply_ok)
+    {
+        STRICT_EXPECTED_CALL(BUFFER_create(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    }
     STRICT_EXPECTED_CALL(get_time(IGNORED_NUM_ARG)).SetReturn(TEST_TIME_T);
 }
 
-static void set_expected_calls_send_http_workload_request(bool expect_success, bool post_data, TEST_PROTOCOL testProtocol)
+static void set_expected_calls_open_workload_connection(TEST_PROTOCOL testProtocol)
 {
     STRICT_EXPECTED_CALL(socketio_get_interface_description());
     STRICT_EXPECTED_CALL(uhttp_client_create(IGNORED_NUM_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
@@ -597,19 +613,27 @@ static void set_expected_calls_send_http_workload_request(bool expect_success, b
     }
 
     STRICT_EXPECTED_CALL(uhttp_client_open(IGNORED_NUM_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
+}
+
+static void set_expected_calls_send_http_workload_request(bool expect_success, bool post_data, TEST_PROTOCOL testProtocol, bool connection_open)
+{
+    if (!connection_open)
+    {
+        set_expected_calls_open_workload_connection(testProtocol);
+    }
     if (post_data)
     {
         STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
         STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_NUM_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     }
-    set_expected_calls_send_and_poll_http_signing_request(post_data);
+    set_expected_calls_send_and_poll_http_signing_request(post_data, connection_open, expect_success);
     STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(uhttp_client_close(IGNORED_NUM_ARG, NULL, NULL));
-    STRICT_EXPECTED_CALL(uhttp_client_destroy(IGNORED_NUM_ARG));
 
     if (expect_success == false)
     {
         STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_NUM_ARG));
+        STRICT_EXPECTED_CALL(uhttp_client_close(IGNORED_NUM_ARG, NULL, NULL));
+        STRICT_EXPECTED_CALL(uhttp_client_destroy(IGNORED_NUM_ARG));
     }
 }
 
@@ -624,11 +648,11 @@ static void set_expected_calls_parse_json_workload_response()
     STRICT_EXPECTED_CALL(json_value_free(IGNORED_NUM_ARG));
 }
 
-static void set_expected_calls_hsm_client_http_edge_sign_data(TEST_PROTOCOL testProtocol)
+static void set_expected_calls_hsm_client_http_edge_sign_data(TEST_PROTOCOL testProtocol, bool connection_open)
 {
     set_expected_calls_construct_json_signing_blob();
     STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)).SetReturn(TEST_STRING_1);
-    set_expected_calls_send_http_workload_request(true, true, testProtocol);
+    set_expected_calls_send_http_workload_request(true, true, testProtocol, connection_open);
     set_expected_calls_parse_json_workload_response();
     STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_NUM_ARG));
@@ -647,7 +671,7 @@ TEST_FUNCTION(hsm_client_http_edge_sign_data_succeed)
 
     umock_c_reset_all_calls();
 
-    set_expected_calls_hsm_client_http_edge_sign_data(TEST_HTTP_PROTOCOL);
+    set_expected_calls_hsm_client_http_edge_sign_data(TEST_HTTP_PROTOCOL, false);
 
     int result = hsm_client_http_edge_sign_data(sec_handle, TEST_SIGNING_DATA, TEST_SIGNING_DATA_LENGTH, &signed_value, &signed_len);
     ASSERT_ARE_EQUAL(int, result, 0);
@@ -670,7 +694,7 @@ TEST_FUNCTION(hsm_client_http_edge_sign_data_domain_socket_succeed)
 
     umock_c_reset_all_calls();
 
-    set_expected_calls_hsm_client_http_edge_sign_data(TEST_DOMAIN_SOCKET_PROTOCOL);
+    set_expected_calls_hsm_client_http_edge_sign_data(TEST_DOMAIN_SOCKET_PROTOCOL, false);
 
     int result = hsm_client_http_edge_sign_data(sec_handle, TEST_SIGNING_DATA, TEST_SIGNING_DATA_LENGTH, &signed_value, &signed_len);
     ASSERT_ARE_EQUAL(int, result, 0);
@@ -682,6 +706,94 @@ TEST_FUNCTION(hsm_client_http_edge_sign_data_domain_socket_succeed)
 }
 
 
+TEST_FUNCTION(hsm_client_http_edge_sign_data_reuses_workload_connection)
+{
+    setup_hsm_client_http_edge_create_http_mock(TEST_ENV_WORKLOADURI_HTTP, true);
+
+    HSM_CLIENT_HANDLE sec_handle = hsm_client_http_edge_create();
+    unsigned char* signed_value = NULL;
+    size_t signed_len;
+
+    ASSERT_IS_NOT_NULL(sec_handle);
+    ASSERT_ARE_EQUAL(int, 0, hsm_client_http_edge_sign_data(sec_handle, TEST_SIGNING_DATA, TEST_SIGNING_DATA_LENGTH, &signed_value, &signed_len));
+    free(signed_value);
+    signed_value = NULL;
+
+    umock_c_reset_all_calls();
+
+    set_expected_calls_hsm_client_http_edge_sign_data(TEST_HTTP_PROTOCOL, true);
+
+    int result = hsm_client_http_edge_sign_data(sec_handle, TEST_SIGNING_DATA, TEST_SIGNING_DATA_LENGTH, &signed_value, &signed_len);
+    ASSERT_ARE_EQUAL(int, result, 0);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+
+    hsm_client_http_edge_destroy(sec_handle);
+    free(signed_value);
+}
+
+TEST_FUNCTION(hsm_client_http_edge_sign_data_retries_on_new_connection_when_open_one_fails)
+{
+    setup_hsm_client_http_edge_create_http_mock(TEST_ENV_WORKLOADURI_HTTP, true);
+
+    HSM_CLIENT_HANDLE sec_handle = hsm_client_http_edge_create();
+    unsigned char* signed_value = NULL;
+    size_t signed_len;
+
+    ASSERT_IS_NOT_NULL(sec_handle);
+    ASSERT_ARE_EQUAL(int, 0, hsm_client_http_edge_sign_data(sec_handle, TEST_SIGNING_DATA, TEST_SIGNING_DATA_LENGTH, &signed_value, &signed_len));
+    free(signed_value);
+    signed_value = NULL;
+
+    umock_c_reset_all_calls();
+    g_fail_next_reply = true;
+
+    set_expected_calls_construct_json_signing_blob();
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)).SetReturn(TEST_STRING_1);
+    set_expected_calls_send_http_workload_request(false, true, TEST_HTTP_PROTOCOL, true);
+    set_expected_calls_send_http_workload_request(true, true, TEST_HTTP_PROTOCOL, false);
+    set_expected_calls_parse_json_workload_response();
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_NUM_ARG));
+
+    int result = hsm_client_http_edge_sign_data(sec_handle, TEST_SIGNING_DATA, TEST_SIGNING_DATA_LENGTH, &signed_value, &signed_len);
+    ASSERT_ARE_EQUAL(int, result, 0);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+
+    hsm_client_http_edge_destroy(sec_handle);
+    free(signed_value);
+}
+
+TEST_FUNCTION(hsm_client_http_edge_destroy_closes_workload_connection)
+{
+    setup_hsm_client_http_edge_create_http_mock(TEST_ENV_WORKLOADURI_HTTP, true);
+
+    HSM_CLIENT_HANDLE sec_handle = hsm_client_http_edge_create();
+    unsigned char* signed_value = NULL;
+    size_t signed_len;
+
+    ASSERT_IS_NOT_NULL(sec_handle);
+    ASSERT_ARE_EQUAL(int, 0, hsm_client_http_edge_sign_data(sec_handle, TEST_SIGNING_DATA, TEST_SIGNING_DATA_LENGTH, &signed_value, &signed_len));
+
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(uhttp_client_close(IGNORED_NUM_ARG, NULL, NULL));
+    STRICT_EXPECTED_CALL(uhttp_client_destroy(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    hsm_client_http_edge_destroy(sec_handle);
+
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    free(signed_value);
+}
+
+
 static void test_http_failure_impl()
 {
     setup_hsm_client_http_edge_create_http_mock(TEST_ENV_WORKLOADURI_HTTP, true);
@@ -692,7 +804,7 @@ static void test_http_failure_impl()
 
     ASSERT_IS_NOT_NULL(sec_handle);
 
-    set_expected_calls_hsm_client_http_edge_sign_data(TEST_HTTP_PROTOCOL);
+    set_expected_calls_hsm_client_http_edge_sign_data(TEST_HTTP_PROTOCOL, false);
 
     int result = hsm_client_http_edge_sign_data(sec_handle, TEST_SIGNING_DATA, TEST_SIGNING_DATA_LENGTH, &signed_value, &signed_len);
     ASSERT_ARE_NOT_EQUAL(int, result, 0);
@@ -746,7 +858,7 @@ TEST_FUNCTION(hsm_client_http_edge_sign_data_http_fail)
 
     umock_c_reset_all_calls();
 
-    set_expected_calls_hsm_client_http_edge_sign_data(TEST_HTTP_PROTOCOL);
+    set_expected_calls_hsm_client_http_edge_sign_data(TEST_HTTP_PROTOCOL, false);
 
     umock_c_negative_tests_snapshot();
 
@@ -769,13 +881,11 @@ TEST_FUNCTION(hsm_client_http_edge_sign_data_http_fail)
         31, // uhttp_client_dowork
         33, // get_time
         34, // HTTPHeaders_Free
-        35, // uhttp_client_close
-        36, // uhttp_client_destroy
-        42, // json_object_clear
-        43, // json_value_free
-        44, // BUFFER_delete
-        45, // BUFFER_delete
-        46 // STRING_delete
+        40, // json_object_clear
+        41, // json_value_free
+        42, // BUFFER_delete
+        43, // BUFFER_delete
+        44 // STRING_delete
     };
 
     // act
@@ -807,7 +917,7 @@ TEST_FUNCTION(hsm_client_http_edge_sign_data_http_fail)
 static void set_expected_calls_hsm_client_http_edge_get_trust_bundle(TEST_PROTOCOL testProtocol)
 {
     STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)).SetReturn(TEST_STRING_1);
-    set_expected_calls_send_http_workload_request(true, false, testProtocol);
+    set_expected_calls_send_http_workload_request(true, false, testProtocol, false);
     set_expected_calls_parse_json_workload_response();
     STRICT_EXPECTED_CALL(STRING_delete(IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_NUM_ARG));
@@ -897,12 +1007,10 @@ TEST_FUNCTION(hsm_client_http_edge_get_trust_bundle_fail)
         9, // uhttp_client_dowork
         11, // get_time
         12, // HTTPHeaders_Free
-        14, // uhttp_client_destroy
-        13, // uhttp_client_close
-        20, // json_object_clear
-        21, // json_value_free
-        22, // BUFFER_delete
-        23 // BUFFER_delete
+        18, // json_object_clear
+        19, // json_value_free
+        20, // BUFFER_delete
+        21 // BUFFER_delete
     };
 
     // act
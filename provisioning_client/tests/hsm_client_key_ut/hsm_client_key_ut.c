@@ -37,6 +37,9 @@ static void my_gballoc_free(void* ptr)
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/umock_c_prod.h"
 #include "azure_c_shared_utility/crt_abstractions.h"
+#include "azure_c_shared_utility/base64.h"
+#include "azure_c_shared_utility/buffer_.h"
+#include "azure_c_shared_utility/strings.h"
 #undef ENABLE_MOCKS
 
 #include "hsm_client_key.h"
@@ -44,6 +47,10 @@ static void my_gballoc_free(void* ptr)
 
 static const char* TEST_SYMM_KEY = "Test_symm_key";
 static const char* TEST_REG_NAME = "Test_registration_name";
+static const char* TEST_REG_NAME_2 = "Test_registration_name_2";
+static const char* TEST_GROUP_KEY = "Test_group_key";
+static const char* TEST_DERIVED_KEY = "Test_derived_key";
+static unsigned char TEST_DECODED_GROUP_KEY[] = { 0x01, 0x02, 0x03, 0x04 };
 
 #define TEST_BUFFER_SIZE    128
 #define TEST_KEY_SIZE       10
@@ -57,6 +64,29 @@ static int my_mallocAndStrcpy_s(char** destination, const char* source)
     return 0;
 }
 
+static BUFFER_HANDLE my_Base64_Decoder(const char* source)
+{
+    (void)source;
+    return (BUFFER_HANDLE)my_gballoc_malloc(1);
+}
+
+static void my_BUFFER_delete(BUFFER_HANDLE handle)
+{
+    my_gballoc_free(handle);
+}
+
+static STRING_HANDLE my_Base64_Encode_Bytes(const unsigned char* source, size_t size)
+{
+    (void)source;
+    (void)size;
+    return (STRING_HANDLE)my_gballoc_malloc(1);
+}
+
+static void my_STRING_delete(STRING_HANDLE handle)
+{
+    my_gballoc_free(handle);
+}
+
 DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
 
 static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
@@ -86,12 +116,23 @@ BEGIN_TEST_SUITE(hsm_client_key_ut)
 
         REGISTER_UMOCK_ALIAS_TYPE(HSM_CLIENT_HANDLE, void*);
         REGISTER_UMOCK_ALIAS_TYPE(SECURE_DEVICE_TYPE, int);
+        REGISTER_UMOCK_ALIAS_TYPE(BUFFER_HANDLE, void*);
+        REGISTER_UMOCK_ALIAS_TYPE(STRING_HANDLE, void*);
 
         REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
         REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
         REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
         REGISTER_GLOBAL_MOCK_HOOK(mallocAndStrcpy_s, my_mallocAndStrcpy_s);
         REGISTER_GLOBAL_MOCK_FAIL_RETURN(mallocAndStrcpy_s, __LINE__);
+        REGISTER_GLOBAL_MOCK_HOOK(Base64_Decoder, my_Base64_Decoder);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(Base64_Decoder, NULL);
+        REGISTER_GLOBAL_MOCK_RETURN(BUFFER_u_char, TEST_DECODED_GROUP_KEY);
+        REGISTER_GLOBAL_MOCK_RETURN(BUFFER_length, sizeof(TEST_DECODED_GROUP_KEY));
+        REGISTER_GLOBAL_MOCK_HOOK(BUFFER_delete, my_BUFFER_delete);
+        REGISTER_GLOBAL_MOCK_HOOK(Base64_Encode_Bytes, my_Base64_Encode_Bytes);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(Base64_Encode_Bytes, NULL);
+        REGISTER_GLOBAL_MOCK_RETURN(STRING_c_str, TEST_DERIVED_KEY);
+        REGISTER_GLOBAL_MOCK_HOOK(STRING_delete, my_STRING_delete);
     }
 
     TEST_SUITE_CLEANUP(suite_cleanup)
@@ -129,6 +170,25 @@ BEGIN_TEST_SUITE(hsm_client_key_ut)
         return result;
     }
 
+    static void setup_group_create_mocks(void)
+    {
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+        STRICT_EXPECTED_CALL(Base64_Decoder(TEST_GROUP_KEY));
+        STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+    }
+
+    static void setup_derive_key_mocks(void)
+    {
+        STRICT_EXPECTED_CALL(Base64_Encode_Bytes(IGNORED_PTR_ARG, 32));
+        STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    }
+
     TEST_FUNCTION(hsm_client_key_create_succeed)
     {
         //arrange
@@ -440,4 +500,274 @@ BEGIN_TEST_SUITE(hsm_client_key_ut)
         hsm_client_key_destroy(sec_handle);
     }
 
+    TEST_FUNCTION(hsm_client_key_group_create_group_key_NULL_fail)
+    {
+        //arrange
+
+        //act
+        HSM_CLIENT_KEY_GROUP_HANDLE group_handle = hsm_client_key_group_create(NULL, 1);
+
+        //assert
+        ASSERT_IS_NULL(group_handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+    }
+
+    TEST_FUNCTION(hsm_client_key_group_create_succeed)
+    {
+        //arrange
+        setup_group_create_mocks();
+
+        //act
+        HSM_CLIENT_KEY_GROUP_HANDLE group_handle = hsm_client_key_group_create(TEST_GROUP_KEY, 1);
+
+        //assert
+        ASSERT_IS_NOT_NULL(group_handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        hsm_client_key_group_destroy(group_handle);
+    }
+
+    TEST_FUNCTION(hsm_client_key_group_create_fail)
+    {
+        //arrange
+        int negativeTestsInitResult = umock_c_negative_tests_init();
+        ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+        setup_group_create_mocks();
+
+        umock_c_negative_tests_snapshot();
+
+        size_t calls_cannot_fail[] = { 2, 3, 4, 5, 6 };
+
+        //act
+        size_t count = umock_c_negative_tests_call_count();
+        for (size_t index = 0; index < count; index++)
+        {
+            if (should_skip_index(index, calls_cannot_fail, sizeof(calls_cannot_fail) / sizeof(calls_cannot_fail[0])) != 0)
+            {
+                continue;
+            }
+
+            umock_c_negative_tests_reset();
+            umock_c_negative_tests_fail_call(index);
+
+            char tmp_msg[64];
+            sprintf(tmp_msg, "hsm_client_key_group_create failure in test %zu/%zu", index, count);
+
+            HSM_CLIENT_KEY_GROUP_HANDLE group_handle = hsm_client_key_group_create(TEST_GROUP_KEY, 1);
+
+            //assert
+            ASSERT_IS_NULL(group_handle, tmp_msg);
+        }
+
+        //cleanup
+        umock_c_negative_tests_deinit();
+    }
+
+    TEST_FUNCTION(hsm_client_key_group_destroy_handle_NULL_succeed)
+    {
+        //arrange
+
+        //act
+        hsm_client_key_group_destroy(NULL);
+
+        //assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+    }
+
+    TEST_FUNCTION(hsm_client_key_group_destroy_frees_cached_keys_succeed)
+    {
+        //arrange
+        HSM_CLIENT_KEY_GROUP_HANDLE group_handle = hsm_client_key_group_create(TEST_GROUP_KEY, 2);
+        free(hsm_client_key_group_derive_key(group_handle, TEST_REG_NAME));
+        free(hsm_client_key_group_derive_key(group_handle, TEST_REG_NAME_2));
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+        //act
+        hsm_client_key_group_destroy(group_handle);
+
+        //assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+    }
+
+    TEST_FUNCTION(hsm_client_key_group_derive_key_handle_NULL_fail)
+    {
+        //arrange
+
+        //act
+        char* derived_key = hsm_client_key_group_derive_key(NULL, TEST_REG_NAME);
+
+        //assert
+        ASSERT_IS_NULL(derived_key);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+    }
+
+    TEST_FUNCTION(hsm_client_key_group_derive_key_registration_id_NULL_fail)
+    {
+        //arrange
+        HSM_CLIENT_KEY_GROUP_HANDLE group_handle = hsm_client_key_group_create(TEST_GROUP_KEY, 1);
+        umock_c_reset_all_calls();
+
+        //act
+        char* derived_key = hsm_client_key_group_derive_key(group_handle, NULL);
+
+        //assert
+        ASSERT_IS_NULL(derived_key);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        hsm_client_key_group_destroy(group_handle);
+    }
+
+    TEST_FUNCTION(hsm_client_key_group_derive_key_succeed)
+    {
+        //arrange
+        HSM_CLIENT_KEY_GROUP_HANDLE group_handle = hsm_client_key_group_create(TEST_GROUP_KEY, 1);
+        umock_c_reset_all_calls();
+
+        setup_derive_key_mocks();
+        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_DERIVED_KEY));
+
+        //act
+        char* derived_key = hsm_client_key_group_derive_key(group_handle, TEST_REG_NAME);
+
+        //assert
+        ASSERT_IS_NOT_NULL(derived_key);
+        ASSERT_ARE_EQUAL(char_ptr, TEST_DERIVED_KEY, derived_key);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        free(derived_key);
+        hsm_client_key_group_destroy(group_handle);
+    }
+
+    TEST_FUNCTION(hsm_client_key_group_derive_key_cached_succeed)
+    {
+        //arrange
+        HSM_CLIENT_KEY_GROUP_HANDLE group_handle = hsm_client_key_group_create(TEST_GROUP_KEY, 1);
+        free(hsm_client_key_group_derive_key(group_handle, TEST_REG_NAME));
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_DERIVED_KEY));
+
+        //act
+        char* derived_key = hsm_client_key_group_derive_key(group_handle, TEST_REG_NAME);
+
+        //assert
+        ASSERT_IS_NOT_NULL(derived_key);
+        ASSERT_ARE_EQUAL(char_ptr, TEST_DERIVED_KEY, derived_key);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        free(derived_key);
+        hsm_client_key_group_destroy(group_handle);
+    }
+
+    TEST_FUNCTION(hsm_client_key_group_derive_key_evicts_least_recent_succeed)
+    {
+        //arrange
+        HSM_CLIENT_KEY_GROUP_HANDLE group_handle = hsm_client_key_group_create(TEST_GROUP_KEY, 1);
+        free(hsm_client_key_group_derive_key(group_handle, TEST_REG_NAME));
+        umock_c_reset_all_calls();
+
+        setup_derive_key_mocks();
+        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_DERIVED_KEY));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+        setup_derive_key_mocks();
+        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_DERIVED_KEY));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+        //act
+        char* derived_key_2 = hsm_client_key_group_derive_key(group_handle, TEST_REG_NAME_2);
+        char* derived_key = hsm_client_key_group_derive_key(group_handle, TEST_REG_NAME);
+
+        //assert
+        ASSERT_IS_NOT_NULL(derived_key_2);
+        ASSERT_IS_NOT_NULL(derived_key);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        free(derived_key_2);
+        free(derived_key);
+        hsm_client_key_group_destroy(group_handle);
+    }
+
+    TEST_FUNCTION(hsm_client_key_group_derive_key_no_cache_succeed)
+    {
+        //arrange
+        HSM_CLIENT_KEY_GROUP_HANDLE group_handle = hsm_client_key_group_create(TEST_GROUP_KEY, 0);
+        umock_c_reset_all_calls();
+
+        setup_derive_key_mocks();
+        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_DERIVED_KEY));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+        //act
+        char* derived_key = hsm_client_key_group_derive_key(group_handle, TEST_REG_NAME);
+
+        //assert
+        ASSERT_IS_NOT_NULL(derived_key);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        free(derived_key);
+        hsm_client_key_group_destroy(group_handle);
+    }
+
+    TEST_FUNCTION(hsm_client_key_group_derive_key_fail)
+    {
+        //arrange
+        HSM_CLIENT_KEY_GROUP_HANDLE group_handle = hsm_client_key_group_create(TEST_GROUP_KEY, 0);
+        umock_c_reset_all_calls();
+
+        int negativeTestsInitResult = umock_c_negative_tests_init();
+        ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+        setup_derive_key_mocks();
+        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_DERIVED_KEY));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+        umock_c_negative_tests_snapshot();
+
+        size_t calls_cannot_fail[] = { 1, 3, 5 };
+
+        //act
+        size_t count = umock_c_negative_tests_call_count();
+        for (size_t index = 0; index < count; index++)
+        {
+            if (should_skip_index(index, calls_cannot_fail, sizeof(calls_cannot_fail) / sizeof(calls_cannot_fail[0])) != 0)
+            {
+                continue;
+            }
+
+            umock_c_negative_tests_reset();
+            umock_c_negative_tests_fail_call(index);
+
+            char tmp_msg[64];
+            sprintf(tmp_msg, "hsm_client_key_group_derive_key failure in test %zu/%zu", index, count);
+
+            char* derived_key = hsm_client_key_group_derive_key(group_handle, TEST_REG_NAME);
+
+            //assert
+            ASSERT_IS_NULL(derived_key, tmp_msg);
+        }
+
+        //cleanup
+        umock_c_negative_tests_deinit();
+        hsm_client_key_group_destroy(group_handle);
+    }
+
     END_TEST_SUITE(hsm_client_key_ut)
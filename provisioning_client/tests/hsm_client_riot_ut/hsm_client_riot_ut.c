@@ -64,6 +64,9 @@ MOCKABLE_FUNCTION(, int, X509GetAliasCertTBS, DERBuilderContext*, Tbs, RIOT_X509
 MOCKABLE_FUNCTION(, int, X509GetDERCsrTbs, DERBuilderContext*, Context, RIOT_X509_TBS_DATA*, TbsData, RIOT_ECC_PUBLIC*, DeviceIDPub);
 MOCKABLE_FUNCTION(, int, X509GetDERCsr, DERBuilderContext*, Context, RIOT_ECC_SIGNATURE*, Signature);
 
+MOCKABLE_FUNCTION(, int, test_load_key_info, const unsigned char*, measurement, size_t, measurement_len, unsigned char*, key_info, size_t, key_info_len, void*, user_context);
+MOCKABLE_FUNCTION(, void, test_store_key_info, const unsigned char*, measurement, size_t, measurement_len, const unsigned char*, key_info, size_t, key_info_len, void*, user_context);
+
 #undef ENABLE_MOCKS
 
 #include "hsm_client_riot.h"
@@ -240,6 +243,42 @@ static void my_DiceSHA256_2(const uint8_t *buf1, size_t bufSize1, const uint8_t
     }
 }
 
+#define TEST_MEASUREMENT_BYTE       0x42
+#define TEST_STALE_MEASUREMENT_BYTE 0x24
+#define TEST_KEY_CACHE_CONTEXT      (void*)0x11111111
+
+static unsigned char g_cached_measurement_byte;
+
+static RIOT_STATUS my_RiotCrypt_Hash2(uint8_t* hash_result, size_t resultSize, const void* data1, size_t data1Size, const void* data2, size_t data2Size)
+{
+    (void)data1;
+    (void)data1Size;
+    (void)data2;
+    (void)data2Size;
+    memset(hash_result, TEST_MEASUREMENT_BYTE, resultSize);
+    return RIOT_SUCCESS;
+}
+
+static int my_test_load_key_info(const unsigned char* measurement, size_t measurement_len, unsigned char* key_info, size_t key_info_len, void* user_context)
+{
+    (void)measurement;
+    (void)user_context;
+    // The cached measurement is the first member of the key info
+    memset(key_info, 0, key_info_len);
+    memset(key_info, g_cached_measurement_byte, measurement_len);
+    return 0;
+}
+
+static int my_test_load_key_info_not_found(const unsigned char* measurement, size_t measurement_len, unsigned char* key_info, size_t key_info_len, void* user_context)
+{
+    (void)measurement;
+    (void)measurement_len;
+    (void)key_info;
+    (void)key_info_len;
+    (void)user_context;
+    return __LINE__;
+}
+
 static int my_DERtoPEM(DERBuilderContext* Context, uint32_t Type, char* PEM, uint32_t* Length)
 {
     (void)Context;
@@ -288,7 +327,7 @@ BEGIN_TEST_SUITE(hsm_client_riot_ut)
         REGISTER_GLOBAL_MOCK_FAIL_RETURN(RiotCrypt_Hash, RIOT_FAILURE);
         REGISTER_GLOBAL_MOCK_RETURN(RiotCrypt_DeriveEccKey, RIOT_SUCCESS);
         REGISTER_GLOBAL_MOCK_FAIL_RETURN(RiotCrypt_DeriveEccKey, RIOT_FAILURE);
-        REGISTER_GLOBAL_MOCK_RETURN(RiotCrypt_Hash2, RIOT_SUCCESS);
+        REGISTER_GLOBAL_MOCK_HOOK(RiotCrypt_Hash2, my_RiotCrypt_Hash2);
         REGISTER_GLOBAL_MOCK_FAIL_RETURN(RiotCrypt_Hash2, RIOT_FAILURE);
         REGISTER_GLOBAL_MOCK_RETURN(X509GetDEREncodedTBS, 0);
         REGISTER_GLOBAL_MOCK_FAIL_RETURN(X509GetDEREncodedTBS, 1);
@@ -321,6 +360,7 @@ BEGIN_TEST_SUITE(hsm_client_riot_ut)
         REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
         REGISTER_GLOBAL_MOCK_HOOK(mallocAndStrcpy_s, my_mallocAndStrcpy_s);
         REGISTER_GLOBAL_MOCK_FAIL_RETURN(mallocAndStrcpy_s, __LINE__);
+        REGISTER_GLOBAL_MOCK_HOOK(test_load_key_info, my_test_load_key_info);
     }
 
     TEST_SUITE_CLEANUP(suite_cleanup)
@@ -337,10 +377,12 @@ BEGIN_TEST_SUITE(hsm_client_riot_ut)
             ASSERT_FAIL("Could not acquire test serialization mutex.");
         }
         umock_c_reset_all_calls();
+        g_cached_measurement_byte = TEST_MEASUREMENT_BYTE;
     }
 
     TEST_FUNCTION_CLEANUP(method_cleanup)
     {
+        hsm_client_riot_set_key_cache(NULL);
         TEST_MUTEX_RELEASE(g_testByTest);
     }
 
@@ -368,15 +410,19 @@ BEGIN_TEST_SUITE(hsm_client_riot_ut)
         STRICT_EXPECTED_CALL(DERtoPEM(IGNORED_PTR_ARG, CERT_TYPE, IGNORED_PTR_ARG, IGNORED_NUM_ARG)); //15
     }
 
-    static void hsm_client_riot_create_mock(bool device_signed)
+    static void hsm_client_riot_create_mock(bool device_signed, bool use_key_cache)
     {
         RIOT_ECC_PUBLIC pub = { 0 };
         RIOT_ECC_PRIVATE pri = { 0 };
 
         STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
         STRICT_EXPECTED_CALL(RiotCrypt_Hash(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG));
-        STRICT_EXPECTED_CALL(RiotCrypt_DeriveEccKey(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG));
         STRICT_EXPECTED_CALL(RiotCrypt_Hash2(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+        if (use_key_cache)
+        {
+            STRICT_EXPECTED_CALL(test_load_key_info(IGNORED_PTR_ARG, RIOT_DIGEST_LENGTH, IGNORED_PTR_ARG, IGNORED_NUM_ARG, TEST_KEY_CACHE_CONTEXT));
+        }
+        STRICT_EXPECTED_CALL(RiotCrypt_DeriveEccKey(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG));
         STRICT_EXPECTED_CALL(RiotCrypt_DeriveEccKey(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG));
         STRICT_EXPECTED_CALL(DERInitContext(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG));
         STRICT_EXPECTED_CALL(X509GetDEREccPub(IGNORED_PTR_ARG, pub))
@@ -432,9 +478,22 @@ BEGIN_TEST_SUITE(hsm_client_riot_ut)
             .IgnoreArgument_Priv();
         STRICT_EXPECTED_CALL(DERtoPEM(IGNORED_PTR_ARG, ECC_PRIVATEKEY_TYPE, IGNORED_PTR_ARG, IGNORED_NUM_ARG));*/
 
+        if (use_key_cache)
+        {
+            STRICT_EXPECTED_CALL(test_store_key_info(IGNORED_PTR_ARG, RIOT_DIGEST_LENGTH, IGNORED_PTR_ARG, IGNORED_NUM_ARG, TEST_KEY_CACHE_CONTEXT));
+        }
         STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     }
 
+    static void setup_key_cache(void)
+    {
+        HSM_CLIENT_RIOT_KEY_CACHE key_cache;
+        key_cache.load_key_info = test_load_key_info;
+        key_cache.store_key_info = test_store_key_info;
+        key_cache.user_context = TEST_KEY_CACHE_CONTEXT;
+        hsm_client_riot_set_key_cache(&key_cache);
+    }
+
     /* Tests_SRS_SECURE_DEVICE_RIOT_07_001: [ On success hsm_client_riot_create shall allocate a new instance of the device auth interface. ] */
     /* Tests_SRS_SECURE_DEVICE_RIOT_07_002: [ hsm_client_riot_create shall call into the RIot code to sign the RIoT certificate. ] */
     /* Tests_SRS_SECURE_DEVICE_RIOT_07_003: [ hsm_client_riot_create shall cache the device id public value from the RIoT module. ] */
@@ -446,7 +505,7 @@ BEGIN_TEST_SUITE(hsm_client_riot_ut)
         umock_c_reset_all_calls();
 
         //arrange
-        hsm_client_riot_create_mock(false);
+        hsm_client_riot_create_mock(false, false);
 
         //act
         HSM_CLIENT_HANDLE sec_handle = hsm_client_riot_create();
@@ -469,7 +528,7 @@ BEGIN_TEST_SUITE(hsm_client_riot_ut)
         ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
 
         //arrange
-        hsm_client_riot_create_mock(false);
+        hsm_client_riot_create_mock(false, false);
 
         umock_c_negative_tests_snapshot();
 
@@ -501,6 +560,76 @@ BEGIN_TEST_SUITE(hsm_client_riot_ut)
         umock_c_negative_tests_deinit();
     }
 
+    /* Tests_SRS_HSM_CLIENT_RIOT_07_034: [ If a key cache is set and it holds key info for the current measurement, hsm_client_riot_create shall use it instead of deriving the keys and signing the certificates. ] */
+    TEST_FUNCTION(hsm_client_riot_create_key_cache_hit_succeed)
+    {
+        hsm_client_x509_init();
+        setup_key_cache();
+        umock_c_reset_all_calls();
+
+        //arrange
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+        STRICT_EXPECTED_CALL(RiotCrypt_Hash(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+        STRICT_EXPECTED_CALL(RiotCrypt_Hash2(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+        STRICT_EXPECTED_CALL(test_load_key_info(IGNORED_PTR_ARG, RIOT_DIGEST_LENGTH, IGNORED_PTR_ARG, IGNORED_NUM_ARG, TEST_KEY_CACHE_CONTEXT));
+        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+        //act
+        HSM_CLIENT_HANDLE sec_handle = hsm_client_riot_create();
+
+        //assert
+        ASSERT_IS_NOT_NULL(sec_handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        hsm_client_riot_destroy(sec_handle);
+    }
+
+    /* Tests_SRS_HSM_CLIENT_RIOT_07_035: [ After generating the key info hsm_client_riot_create shall pass it to the store_key_info function of the key cache. ] */
+    TEST_FUNCTION(hsm_client_riot_create_key_cache_miss_stores_succeed)
+    {
+        hsm_client_x509_init();
+        setup_key_cache();
+        umock_c_reset_all_calls();
+
+        //arrange
+        hsm_client_riot_create_mock(false, true);
+        REGISTER_GLOBAL_MOCK_HOOK(test_load_key_info, my_test_load_key_info_not_found);
+
+        //act
+        HSM_CLIENT_HANDLE sec_handle = hsm_client_riot_create();
+
+        //assert
+        ASSERT_IS_NOT_NULL(sec_handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        REGISTER_GLOBAL_MOCK_HOOK(test_load_key_info, my_test_load_key_info);
+        hsm_client_riot_destroy(sec_handle);
+    }
+
+    /* Tests_SRS_HSM_CLIENT_RIOT_07_034: [ If a key cache is set and it holds key info for the current measurement, hsm_client_riot_create shall use it instead of deriving the keys and signing the certificates. ] */
+    TEST_FUNCTION(hsm_client_riot_create_key_cache_stale_measurement_regenerates_succeed)
+    {
+        hsm_client_x509_init();
+        setup_key_cache();
+        g_cached_measurement_byte = TEST_STALE_MEASUREMENT_BYTE;
+        umock_c_reset_all_calls();
+
+        //arrange
+        hsm_client_riot_create_mock(false, true);
+
+        //act
+        HSM_CLIENT_HANDLE sec_handle = hsm_client_riot_create();
+
+        //assert
+        ASSERT_IS_NOT_NULL(sec_handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        hsm_client_riot_destroy(sec_handle);
+    }
+
     /* Tests_SRS_SECURE_DEVICE_RIOT_07_008: [ hsm_client_riot_destroy shall free the HSM_CLIENT_HANDLE instance. ] */
     /* Tests_SRS_SECURE_DEVICE_RIOT_07_009: [ hsm_client_riot_destroy shall free all resources allocated in this module. ] */
     TEST_FUNCTION(hsm_client_riot_destroy_succeed)
@@ -924,6 +924,131 @@ BEGIN_TEST_SUITE(iothub_auth_client_ut)
         iothub_device_auth_destroy(xda_handle);
         umock_c_negative_tests_deinit();
     }
+
+    static char* alloc_test_string(const char* value)
+    {
+        char* result = (char*)my_gballoc_malloc(strlen(value) + 1);
+        (void)strcpy(result, value);
+        return result;
+    }
+
+    TEST_FUNCTION(iothub_device_auth_handoff_hsm_handle_NULL_fail)
+    {
+        //arrange
+
+        //act
+        int result = iothub_device_auth_handoff_hsm(AUTH_TYPE_X509, NULL, hsm_client_destroy, NULL, NULL);
+
+        //assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+    }
+
+    TEST_FUNCTION(iothub_device_auth_handoff_hsm_twice_fail)
+    {
+        //arrange
+        (void)iothub_device_auth_handoff_hsm(AUTH_TYPE_X509, TEST_PARAMETER_VALUE, hsm_client_destroy, NULL, NULL);
+        umock_c_reset_all_calls();
+
+        //act
+        int result = iothub_device_auth_handoff_hsm(AUTH_TYPE_X509, TEST_PARAMETER_VALUE, hsm_client_destroy, NULL, NULL);
+
+        //assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        iothub_device_auth_clear_handoff();
+    }
+
+    TEST_FUNCTION(iothub_device_auth_clear_handoff_succeed)
+    {
+        //arrange
+        (void)iothub_device_auth_handoff_hsm(AUTH_TYPE_X509, TEST_PARAMETER_VALUE, hsm_client_destroy, alloc_test_string(TEST_CERT_VALUE), alloc_test_string(TEST_STRING_VALUE));
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(hsm_client_destroy(TEST_PARAMETER_VALUE));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+        //act
+        iothub_device_auth_clear_handoff();
+
+        //assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+    }
+
+    TEST_FUNCTION(iothub_device_auth_create_x509_from_handoff_succeed)
+    {
+        //arrange
+        (void)iothub_device_auth_handoff_hsm(AUTH_TYPE_X509, TEST_PARAMETER_VALUE, hsm_client_destroy, alloc_test_string(TEST_CERT_VALUE), alloc_test_string(TEST_STRING_VALUE));
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(iothub_security_type()).SetReturn(IOTHUB_SECURITY_TYPE_X509);
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+        STRICT_EXPECTED_CALL(hsm_client_x509_interface()).SetReturn(&test_x509_interface);
+
+        //act
+        IOTHUB_SECURITY_HANDLE xda_handle = iothub_device_auth_create();
+
+        //assert
+        ASSERT_IS_NOT_NULL(xda_handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        iothub_device_auth_destroy(xda_handle);
+    }
+
+    TEST_FUNCTION(iothub_device_auth_create_handoff_type_mismatch_succeed)
+    {
+        //arrange
+        (void)iothub_device_auth_handoff_hsm(AUTH_TYPE_SAS, TEST_PARAMETER_VALUE, hsm_client_destroy, NULL, NULL);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(iothub_security_type()).SetReturn(IOTHUB_SECURITY_TYPE_X509);
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+        STRICT_EXPECTED_CALL(hsm_client_x509_interface()).SetReturn(&test_x509_interface);
+        STRICT_EXPECTED_CALL(hsm_client_create());
+
+        //act
+        IOTHUB_SECURITY_HANDLE xda_handle = iothub_device_auth_create();
+
+        //assert
+        ASSERT_IS_NOT_NULL(xda_handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        iothub_device_auth_destroy(xda_handle);
+        iothub_device_auth_clear_handoff();
+    }
+
+    TEST_FUNCTION(iothub_device_auth_generate_credentials_x509_from_handoff_succeed)
+    {
+        //arrange
+        (void)iothub_device_auth_handoff_hsm(AUTH_TYPE_X509, TEST_PARAMETER_VALUE, hsm_client_destroy, alloc_test_string(TEST_CERT_VALUE), alloc_test_string(TEST_STRING_VALUE));
+        STRICT_EXPECTED_CALL(iothub_security_type()).SetReturn(IOTHUB_SECURITY_TYPE_X509);
+        IOTHUB_SECURITY_HANDLE xda_handle = iothub_device_auth_create();
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+
+        //act
+        CREDENTIAL_RESULT* result = iothub_device_auth_generate_credentials(xda_handle, &g_test_x509_cred);
+
+        //assert
+        ASSERT_IS_NOT_NULL(result);
+        ASSERT_ARE_EQUAL(char_ptr, TEST_CERT_VALUE, result->auth_cred_result.x509_result.x509_cert);
+        ASSERT_ARE_EQUAL(char_ptr, TEST_STRING_VALUE, result->auth_cred_result.x509_result.x509_alias_key);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        my_gballoc_free(result);
+        iothub_device_auth_destroy(xda_handle);
+    }
 #endif
 
 #ifdef HSM_TYPE_HTTP_EDGE
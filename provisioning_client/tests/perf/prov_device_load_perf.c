@@ -0,0 +1,629 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+// Fleet load simulator for the provisioning device client: registers a large number of symmetric key devices
+// against one DPS instance from a single process and reports, per transport, the sustained registrations/s,
+// the p50/p90/p99/max latency from Prov_Device_LL_Register_Device to the registration callback, and how often
+// the service asked the devices to back off.
+//
+// usage: prov_device_load_perf [-c device_count] [-p transport[,transport...]] [-r devices_per_second]
+//                              [-m max_in_flight] [-x registration_id_prefix] [-w timeout_seconds] [results.json]
+//
+//   -c  devices registered per transport (default 10000)
+//   -p  any of mqtt, amqp, http that the SDK was built with (default all of them)
+//   -r  rate at which new registrations are started, 0 starts them as fast as -m allows (default 0)
+//   -m  registrations in flight at any time (default 1000)
+//   -x  registration ids are <prefix>-<transport>-<index> (default prov-load)
+//   -w  a registration that has not completed after this many seconds counts as failed (default 300)
+//
+// The devices belong to a symmetric key group enrollment: DPS_ID_SCOPE names the instance, DPS_GLOBAL_ENDPOINT
+// optionally overrides the global device endpoint and DPS_GROUP_SYMMETRIC_KEY is the enrollment group key. Every
+// device key is derived from the group key and the registration id the same way symm_key_provision does it, so
+// no per device enrollment is needed. All the handles are driven by one thread calling Prov_Device_LL_DoWork in
+// turn, which is how a gateway or a fleet simulator would host them.
+//
+// A registration is counted as throttled when its transport reported PROV_DEVICE_TRANSPORT_STATUS_TRANSIENT at
+// least once, i.e. the service answered 429 or a 5xx and the client had to retry.
+//
+// The results are always printed as text; when a file name is given they are also written there as JSON,
+// so that two runs can be compared by CI.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/platform.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/buffer_.h"
+#include "azure_c_shared_utility/strings.h"
+#include "azure_c_shared_utility/base64.h"
+#include "azure_c_shared_utility/hmacsha256.h"
+#include "azure_c_shared_utility/shared_util_options.h"
+
+#include "azure_prov_client/prov_device_ll_client.h"
+#include "azure_prov_client/prov_security_factory.h"
+#include "azure_prov_client/internal/prov_transport_private.h"
+#ifdef USE_MQTT
+#include "azure_prov_client/prov_transport_mqtt_client.h"
+#endif
+#ifdef USE_AMQP
+#include "azure_prov_client/prov_transport_amqp_client.h"
+#endif
+#ifdef USE_HTTP
+#include "azure_prov_client/prov_transport_http_client.h"
+#endif
+
+#include "common/perf_harness.h"
+
+#ifdef SET_TRUSTED_CERT_IN_SAMPLES
+#include "certs.h"
+#endif // SET_TRUSTED_CERT_IN_SAMPLES
+
+#define PERF_MAX_TRANSPORTS             3
+#define PERF_REGISTRATION_ID_SIZE       128
+
+static const char* PERF_DEFAULT_GLOBAL_ENDPOINT = "global.azure-devices-provisioning.net";
+
+typedef enum PERF_DEVICE_STATE_TAG
+{
+    PERF_DEVICE_STATE_IDLE,
+    PERF_DEVICE_STATE_REGISTERING,
+    PERF_DEVICE_STATE_COMPLETE
+} PERF_DEVICE_STATE;
+
+typedef struct PERF_DEVICE_TAG
+{
+    char registration_id[PERF_REGISTRATION_ID_SIZE];
+    PROV_DEVICE_LL_HANDLE handle;
+    PERF_DEVICE_STATE state;
+    PROV_DEVICE_RESULT register_result;
+    uint64_t register_start_ns;
+    uint64_t latency_ns;
+    size_t transient_count;
+
+    /* the LL client's transport status callback, forwarded to after counting */
+    PROV_DEVICE_TRANSPORT_STATUS_CALLBACK transport_status_cb;
+    void* transport_status_ctx;
+} PERF_DEVICE;
+
+typedef struct PERF_TRANSPORT_TAG
+{
+    const char* option;
+    PROV_DEVICE_TRANSPORT_PROVIDER_FUNCTION protocol;
+} PERF_TRANSPORT;
+
+typedef struct PERF_TRANSPORT_RESULT_TAG
+{
+    const char* transport;
+    size_t devices;
+    size_t assigned;
+    size_t failures;
+    size_t throttled_devices;
+    size_t transient_events;
+    double registrations_per_second;
+    uint64_t p50_ns;
+    uint64_t p90_ns;
+    uint64_t p99_ns;
+    uint64_t max_ns;
+} PERF_TRANSPORT_RESULT;
+
+typedef struct PERF_OPTIONS_TAG
+{
+    size_t device_count;
+    const char* transports;
+    size_t devices_per_second;
+    size_t max_in_flight;
+    const char* registration_id_prefix;
+    uint64_t timeout_ns;
+    const char* global_endpoint;
+    const char* id_scope;
+    const char* group_key;
+} PERF_OPTIONS;
+
+static const PERF_TRANSPORT g_transports[] =
+{
+#ifdef USE_MQTT
+    { "mqtt", Prov_Device_MQTT_Protocol },
+#endif
+#ifdef USE_AMQP
+    { "amqp", Prov_Device_AMQP_Protocol },
+#endif
+#ifdef USE_HTTP
+    { "http", Prov_Device_HTTP_Protocol },
+#endif
+    { NULL, NULL }
+};
+
+static PERF_TRANSPORT_RESULT g_results[PERF_MAX_TRANSPORTS];
+static size_t g_result_count = 0;
+
+/* The counting provider is a copy of the transport under test with only prov_transport_open replaced, so that
+   the status callback of every handle goes through on_counted_transport_status first. The transports are
+   measured one after the other, so a single copy is enough. */
+static const PROV_DEVICE_TRANSPORT_PROVIDER* g_inner_provider = NULL;
+static PROV_DEVICE_TRANSPORT_PROVIDER g_counting_provider;
+/* prov_transport_open is called from within Prov_Device_LL_Register_Device, this is the device it belongs to */
+static PERF_DEVICE* g_registering_device = NULL;
+
+static void on_counted_transport_status(PROV_DEVICE_TRANSPORT_STATUS transport_status, uint32_t retry_interval, void* user_ctx)
+{
+    PERF_DEVICE* device = (PERF_DEVICE*)user_ctx;
+
+    if (transport_status == PROV_DEVICE_TRANSPORT_STATUS_TRANSIENT)
+    {
+        device->transient_count++;
+    }
+    device->transport_status_cb(transport_status, retry_interval, device->transport_status_ctx);
+}
+
+static int counting_transport_open(PROV_DEVICE_TRANSPORT_HANDLE handle, const char* registration_id, BUFFER_HANDLE ek, BUFFER_HANDLE srk, PROV_DEVICE_TRANSPORT_REGISTER_CALLBACK data_callback, void* user_ctx, PROV_DEVICE_TRANSPORT_STATUS_CALLBACK status_cb, void* status_ctx, PROV_TRANSPORT_CHALLENGE_CALLBACK reg_challenge_cb, void* challenge_ctx)
+{
+    int result;
+
+    if (g_registering_device == NULL)
+    {
+        LogError("transport opened outside of Prov_Device_LL_Register_Device");
+        result = __FAILURE__;
+    }
+    else
+    {
+        g_registering_device->transport_status_cb = status_cb;
+        g_registering_device->transport_status_ctx = status_ctx;
+        result = g_inner_provider->prov_transport_open(handle, registration_id, ek, srk, data_callback, user_ctx, on_counted_transport_status, g_registering_device, reg_challenge_cb, challenge_ctx);
+    }
+
+    return result;
+}
+
+static const PROV_DEVICE_TRANSPORT_PROVIDER* Perf_Counting_Protocol(void)
+{
+    return &g_counting_provider;
+}
+
+static void on_register_device(PROV_DEVICE_RESULT register_result, const char* iothub_uri, const char* device_id, void* user_context)
+{
+    PERF_DEVICE* device = (PERF_DEVICE*)user_context;
+
+    (void)iothub_uri;
+    (void)device_id;
+
+    device->register_result = register_result;
+    device->latency_ns = perf_get_time_ns() - device->register_start_ns;
+    device->state = PERF_DEVICE_STATE_COMPLETE;
+}
+
+/* device_key = base64(hmacsha256(base64_decode(group_key), registration_id)), the caller frees the result */
+static STRING_HANDLE derive_device_key(const char* group_key, const char* registration_id)
+{
+    STRING_HANDLE result;
+    BUFFER_HANDLE decode_key;
+    BUFFER_HANDLE hash;
+
+    if ((decode_key = Base64_Decoder(group_key)) == NULL)
+    {
+        LogError("Failed decoding the group key");
+        result = NULL;
+    }
+    else
+    {
+        if ((hash = BUFFER_new()) == NULL)
+        {
+            LogError("Failed allocating the hash buffer");
+            result = NULL;
+        }
+        else
+        {
+            if (HMACSHA256_ComputeHash(BUFFER_u_char(decode_key), BUFFER_length(decode_key), (const unsigned char*)registration_id, strlen(registration_id), hash) != HMACSHA256_OK)
+            {
+                LogError("Failed computing the key of %s", registration_id);
+                result = NULL;
+            }
+            else if ((result = Base64_Encoder(hash)) == NULL)
+            {
+                LogError("Failed encoding the key of %s", registration_id);
+            }
+            BUFFER_delete(hash);
+        }
+        BUFFER_delete(decode_key);
+    }
+
+    return result;
+}
+
+static int start_device(PERF_DEVICE* device, const PERF_OPTIONS* options)
+{
+    int result;
+    STRING_HANDLE device_key;
+
+    if ((device_key = derive_device_key(options->group_key, device->registration_id)) == NULL)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        /* the symmetric key HSM takes a copy of the key info when the handle is created */
+        if (prov_dev_set_symmetric_key_info(device->registration_id, STRING_c_str(device_key)) != 0)
+        {
+            LogError("prov_dev_set_symmetric_key_info failed for %s", device->registration_id);
+            result = __FAILURE__;
+        }
+        else if ((device->handle = Prov_Device_LL_Create(options->global_endpoint, options->id_scope, Perf_Counting_Protocol)) == NULL)
+        {
+            LogError("Prov_Device_LL_Create failed for %s", device->registration_id);
+            result = __FAILURE__;
+        }
+        else
+        {
+#ifdef SET_TRUSTED_CERT_IN_SAMPLES
+            (void)Prov_Device_LL_SetOption(device->handle, OPTION_TRUSTED_CERT, certificates);
+#endif // SET_TRUSTED_CERT_IN_SAMPLES
+
+            device->state = PERF_DEVICE_STATE_REGISTERING;
+            device->register_start_ns = perf_get_time_ns();
+
+            g_registering_device = device;
+            if (Prov_Device_LL_Register_Device(device->handle, on_register_device, device, NULL, NULL) != PROV_DEVICE_RESULT_OK)
+            {
+                LogError("Prov_Device_LL_Register_Device failed for %s", device->registration_id);
+                Prov_Device_LL_Destroy(device->handle);
+                device->handle = NULL;
+                result = __FAILURE__;
+            }
+            else
+            {
+                result = 0;
+            }
+            g_registering_device = NULL;
+        }
+        STRING_delete(device_key);
+    }
+
+    return result;
+}
+
+static int compare_samples(const void* left, const void* right)
+{
+    uint64_t a = *(const uint64_t*)left;
+    uint64_t b = *(const uint64_t*)right;
+    return (a < b) ? -1 : ((a > b) ? 1 : 0);
+}
+
+static uint64_t get_permille(const uint64_t* sorted_samples, size_t count, size_t permille)
+{
+    size_t index = (count * permille) / 1000;
+    if (index >= count)
+    {
+        index = count - 1;
+    }
+    return sorted_samples[index];
+}
+
+static void summarize_devices(const PERF_DEVICE* devices, size_t count, uint64_t elapsed_ns, uint64_t* samples, PERF_TRANSPORT_RESULT* measured)
+{
+    size_t index;
+
+    measured->devices = count;
+    measured->assigned = 0;
+    measured->failures = 0;
+    measured->throttled_devices = 0;
+    measured->transient_events = 0;
+
+    for (index = 0; index < count; index++)
+    {
+        if ((devices[index].state == PERF_DEVICE_STATE_COMPLETE) && (devices[index].register_result == PROV_DEVICE_RESULT_OK))
+        {
+            samples[measured->assigned++] = devices[index].latency_ns;
+        }
+        else
+        {
+            measured->failures++;
+        }
+
+        if (devices[index].transient_count != 0)
+        {
+            measured->throttled_devices++;
+            measured->transient_events += devices[index].transient_count;
+        }
+    }
+
+    measured->registrations_per_second = (elapsed_ns == 0) ? 0.0 : ((double)measured->assigned * 1000000000.0 / (double)elapsed_ns);
+
+    if (measured->assigned == 0)
+    {
+        measured->p50_ns = measured->p90_ns = measured->p99_ns = measured->max_ns = 0;
+    }
+    else
+    {
+        qsort(samples, measured->assigned, sizeof(uint64_t), compare_samples);
+        measured->p50_ns = get_permille(samples, measured->assigned, 500);
+        measured->p90_ns = get_permille(samples, measured->assigned, 900);
+        measured->p99_ns = get_permille(samples, measured->assigned, 990);
+        measured->max_ns = samples[measured->assigned - 1];
+    }
+}
+
+static void print_transport_result(const PERF_TRANSPORT_RESULT* measured)
+{
+    (void)printf("%-6s %6lu devices %8.1f reg/s  p50 %8.2f s  p90 %8.2f s  p99 %8.2f s  max %8.2f s  failed %5lu  throttled %5lu (%5.1f%%)  transient %6lu\r\n",
+        measured->transport, (unsigned long)measured->devices, measured->registrations_per_second,
+        (double)measured->p50_ns / 1000000000.0, (double)measured->p90_ns / 1000000000.0, (double)measured->p99_ns / 1000000000.0, (double)measured->max_ns / 1000000000.0,
+        (unsigned long)measured->failures, (unsigned long)measured->throttled_devices,
+        (measured->devices == 0) ? 0.0 : (100.0 * (double)measured->throttled_devices / (double)measured->devices),
+        (unsigned long)measured->transient_events);
+}
+
+/* drives every registration of one transport to completion on the calling thread */
+static int run_transport(const PERF_TRANSPORT* transport, const PERF_OPTIONS* options, PERF_TRANSPORT_RESULT* measured)
+{
+    int result;
+    PERF_DEVICE* devices;
+    PERF_DEVICE** in_flight;
+    uint64_t* samples;
+
+    memset(measured, 0, sizeof(PERF_TRANSPORT_RESULT));
+    measured->transport = transport->option;
+
+    devices = (PERF_DEVICE*)calloc(options->device_count, sizeof(PERF_DEVICE));
+    in_flight = (PERF_DEVICE**)malloc(options->max_in_flight * sizeof(PERF_DEVICE*));
+    samples = (uint64_t*)malloc(options->device_count * sizeof(uint64_t));
+
+    if ((devices == NULL) || (in_flight == NULL) || (samples == NULL))
+    {
+        LogError("Failed allocating the state of %lu devices", (unsigned long)options->device_count);
+        result = __FAILURE__;
+    }
+    else
+    {
+        size_t started = 0;
+        size_t in_flight_count = 0;
+        uint64_t start_ns;
+        uint64_t end_ns;
+        size_t index;
+
+        for (index = 0; index < options->device_count; index++)
+        {
+            (void)snprintf(devices[index].registration_id, PERF_REGISTRATION_ID_SIZE, "%s-%s-%lu", options->registration_id_prefix, transport->option, (unsigned long)index);
+        }
+
+        g_inner_provider = transport->protocol();
+        g_counting_provider = *g_inner_provider;
+        g_counting_provider.prov_transport_open = counting_transport_open;
+
+        start_ns = perf_get_time_ns();
+        while ((started < options->device_count) || (in_flight_count > 0))
+        {
+            uint64_t now_ns = perf_get_time_ns();
+            size_t allowed = options->device_count;
+
+            if (options->devices_per_second != 0)
+            {
+                allowed = (size_t)(((now_ns - start_ns) / 1000000) * options->devices_per_second / 1000) + 1;
+            }
+
+            while ((started < options->device_count) && (started < allowed) && (in_flight_count < options->max_in_flight))
+            {
+                PERF_DEVICE* device = &devices[started++];
+
+                /* a device that could not be started stays idle and is counted as a failure */
+                if (start_device(device, options) == 0)
+                {
+                    in_flight[in_flight_count++] = device;
+                }
+            }
+
+            index = 0;
+            while (index < in_flight_count)
+            {
+                PERF_DEVICE* device = in_flight[index];
+
+                Prov_Device_LL_DoWork(device->handle);
+
+                if ((device->state == PERF_DEVICE_STATE_REGISTERING) && ((perf_get_time_ns() - device->register_start_ns) > options->timeout_ns))
+                {
+                    LogError("%s timed out", device->registration_id);
+                    device->state = PERF_DEVICE_STATE_IDLE;
+                }
+
+                if (device->state != PERF_DEVICE_STATE_REGISTERING)
+                {
+                    /* the handle cannot be destroyed from within its own callback, so it is done here */
+                    Prov_Device_LL_Destroy(device->handle);
+                    device->handle = NULL;
+                    in_flight[index] = in_flight[--in_flight_count];
+                }
+                else
+                {
+                    index++;
+                }
+            }
+
+            ThreadAPI_Sleep(1);
+        }
+        end_ns = perf_get_time_ns();
+
+        summarize_devices(devices, options->device_count, end_ns - start_ns, samples, measured);
+        print_transport_result(measured);
+
+        result = (measured->failures == 0) ? 0 : __FAILURE__;
+    }
+
+    free(samples);
+    free(in_flight);
+    free(devices);
+
+    return result;
+}
+
+static int write_json_results(const char* fileName)
+{
+    int result;
+    FILE* file;
+
+    if ((file = fopen(fileName, "w")) == NULL)
+    {
+        LogError("Failed opening %s", fileName);
+        result = __FAILURE__;
+    }
+    else
+    {
+        size_t i;
+
+        (void)fprintf(file, "{\n    \"transports\": [\n");
+        for (i = 0; i < g_result_count; i++)
+        {
+            const PERF_TRANSPORT_RESULT* measured = &g_results[i];
+
+            (void)fprintf(file, "        { \"name\": \"%s\", \"devices\": %lu, \"assigned\": %lu, \"failures\": %lu, \"registrations_per_second\": %.1f, \"p50_ns\": %lu, \"p90_ns\": %lu, \"p99_ns\": %lu, \"max_ns\": %lu, \"throttled_devices\": %lu, \"transient_events\": %lu }%s\n",
+                measured->transport, (unsigned long)measured->devices, (unsigned long)measured->assigned, (unsigned long)measured->failures, measured->registrations_per_second,
+                (unsigned long)measured->p50_ns, (unsigned long)measured->p90_ns, (unsigned long)measured->p99_ns, (unsigned long)measured->max_ns,
+                (unsigned long)measured->throttled_devices, (unsigned long)measured->transient_events, (i + 1 < g_result_count) ? "," : "");
+        }
+        (void)fprintf(file, "    ]\n}\n");
+
+        result = (fclose(file) == 0) ? 0 : __FAILURE__;
+    }
+
+    return result;
+}
+
+/* true if option is one of the comma separated entries of list */
+static bool is_transport_selected(const char* list, const char* option)
+{
+    size_t optionLength = strlen(option);
+    const char* current = list;
+    bool result = false;
+
+    while (current != NULL && !result)
+    {
+        const char* end = strchr(current, ',');
+        size_t length = (end == NULL) ? strlen(current) : (size_t)(end - current);
+
+        result = (length == optionLength) && (strncmp(current, option, length) == 0);
+        current = (end == NULL) ? NULL : end + 1;
+    }
+
+    return result;
+}
+
+static void print_usage(const char* program)
+{
+    (void)printf("usage: %s [-c device_count] [-p transport[,transport...]] [-r devices_per_second] [-m max_in_flight] [-x registration_id_prefix] [-w timeout_seconds] [results.json]\r\n", program);
+    (void)printf("transports: mqtt, amqp, http\r\n");
+}
+
+int main(int argc, char** argv)
+{
+    int result;
+    PERF_OPTIONS options;
+    const char* resultsFileName = NULL;
+    int i;
+
+    options.device_count = 10000;
+    options.transports = "mqtt,amqp,http";
+    options.devices_per_second = 0;
+    options.max_in_flight = 1000;
+    options.registration_id_prefix = "prov-load";
+    options.timeout_ns = (uint64_t)300 * 1000000000;
+    options.global_endpoint = getenv("DPS_GLOBAL_ENDPOINT");
+    options.id_scope = getenv("DPS_ID_SCOPE");
+    options.group_key = getenv("DPS_GROUP_SYMMETRIC_KEY");
+
+    if (options.global_endpoint == NULL)
+    {
+        options.global_endpoint = PERF_DEFAULT_GLOBAL_ENDPOINT;
+    }
+
+    result = 0;
+    for (i = 1; i < argc && result == 0; i++)
+    {
+        if ((argv[i][0] == '-') && (i + 1 < argc))
+        {
+            char option = argv[i][1];
+            const char* value = argv[++i];
+
+            switch (option)
+            {
+            case 'c':
+                result = ((options.device_count = (size_t)strtoul(value, NULL, 10)) == 0) ? __FAILURE__ : 0;
+                break;
+            case 'p':
+                options.transports = value;
+                break;
+            case 'r':
+                options.devices_per_second = (size_t)strtoul(value, NULL, 10);
+                break;
+            case 'm':
+                result = ((options.max_in_flight = (size_t)strtoul(value, NULL, 10)) == 0) ? __FAILURE__ : 0;
+                break;
+            case 'x':
+                options.registration_id_prefix = value;
+                break;
+            case 'w':
+                options.timeout_ns = (uint64_t)strtoul(value, NULL, 10) * 1000000000;
+                result = (options.timeout_ns == 0) ? __FAILURE__ : 0;
+                break;
+            default:
+                result = __FAILURE__;
+                break;
+            }
+        }
+        else if ((argv[i][0] != '-') && (resultsFileName == NULL))
+        {
+            resultsFileName = argv[i];
+        }
+        else
+        {
+            result = __FAILURE__;
+        }
+    }
+
+    if (result != 0)
+    {
+        print_usage(argv[0]);
+    }
+    else if ((options.id_scope == NULL) || (options.group_key == NULL))
+    {
+        LogError("DPS_ID_SCOPE and DPS_GROUP_SYMMETRIC_KEY must be set");
+        result = __FAILURE__;
+    }
+    else if (platform_init() != 0)
+    {
+        LogError("platform_init failed");
+        result = __FAILURE__;
+    }
+    else
+    {
+        if (prov_dev_security_init(SECURE_DEVICE_TYPE_SYMMETRIC_KEY) != 0)
+        {
+            LogError("prov_dev_security_init failed");
+            result = __FAILURE__;
+        }
+        else
+        {
+            size_t transport;
+
+            for (transport = 0; g_transports[transport].option != NULL; transport++)
+            {
+                if (is_transport_selected(options.transports, g_transports[transport].option))
+                {
+                    /* the result is recorded even when some registrations failed, throttling under load is a result too */
+                    result |= run_transport(&g_transports[transport], &options, &g_results[g_result_count]);
+                    g_result_count++;
+                }
+            }
+
+            if ((resultsFileName != NULL) && (write_json_results(resultsFileName) != 0))
+            {
+                result = __FAILURE__;
+            }
+
+            prov_dev_security_deinit();
+        }
+
+        platform_deinit();
+    }
+
+    return result;
+}
@@ -45,6 +45,7 @@ static void my_gballoc_free(void* ptr)
 #include "azure_c_shared_utility/strings.h"
 #include "azure_c_shared_utility/crt_abstractions.h"
 #include "azure_prov_client/prov_security_factory.h"
+#include "azure_prov_client/internal/iothub_auth_client.h"
 #include "azure_c_shared_utility/urlencode.h"
 #include "azure_c_shared_utility/sastoken.h"
 
@@ -339,6 +340,8 @@ BEGIN_TEST_SUITE(prov_auth_client_ut)
         REGISTER_UMOCK_ALIAS_TYPE(SECURE_DEVICE_TYPE, int);
         REGISTER_UMOCK_ALIAS_TYPE(STRING_HANDLE, void*);
         REGISTER_UMOCK_ALIAS_TYPE(BUFFER_HANDLE, void*);
+        REGISTER_UMOCK_ALIAS_TYPE(DEVICE_AUTH_TYPE, int);
+        REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_SECURITY_HSM_DESTROY, void*);
 
         REGISTER_GLOBAL_MOCK_HOOK(secure_device_create, my_secure_device_create);
         REGISTER_GLOBAL_MOCK_FAIL_RETURN(secure_device_create, NULL);
@@ -1367,4 +1370,119 @@ BEGIN_TEST_SUITE(prov_auth_client_ut)
         prov_auth_destroy(sec_handle);
     }
 
+    TEST_FUNCTION(prov_auth_handoff_to_iothub_handle_NULL_fail)
+    {
+        //arrange
+
+        //act
+        int result = prov_auth_handoff_to_iothub(NULL, NULL, NULL);
+
+        //assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+    }
+
+    TEST_FUNCTION(prov_auth_handoff_to_iothub_tpm_succeed)
+    {
+        PROV_AUTH_HANDLE sec_handle = prov_auth_create();
+        umock_c_reset_all_calls();
+
+        //arrange
+        STRICT_EXPECTED_CALL(iothub_device_auth_handoff_hsm(AUTH_TYPE_SAS, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, NULL));
+
+        //act
+        int result = prov_auth_handoff_to_iothub(sec_handle, NULL, NULL);
+
+        //assert
+        ASSERT_ARE_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        prov_auth_destroy(sec_handle);
+    }
+
+    TEST_FUNCTION(prov_auth_handoff_to_iothub_x509_succeed)
+    {
+        char* test_cert = (char*)TEST_STRING_VALUE;
+        char* test_key = (char*)TEST_STRING_VALUE;
+
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+        STRICT_EXPECTED_CALL(prov_dev_security_get_type()).SetReturn(SECURE_DEVICE_TYPE_X509);
+        STRICT_EXPECTED_CALL(hsm_client_x509_interface()).SetReturn(&test_x509_interface);
+        PROV_AUTH_HANDLE sec_handle = prov_auth_create();
+        umock_c_reset_all_calls();
+
+        //arrange
+        STRICT_EXPECTED_CALL(iothub_device_auth_handoff_hsm(AUTH_TYPE_X509, IGNORED_PTR_ARG, IGNORED_PTR_ARG, test_cert, test_key));
+
+        //act
+        int result = prov_auth_handoff_to_iothub(sec_handle, test_cert, test_key);
+
+        //assert
+        ASSERT_ARE_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        prov_auth_destroy(sec_handle);
+    }
+
+    TEST_FUNCTION(prov_auth_handoff_to_iothub_twice_fail)
+    {
+        PROV_AUTH_HANDLE sec_handle = prov_auth_create();
+        (void)prov_auth_handoff_to_iothub(sec_handle, NULL, NULL);
+        umock_c_reset_all_calls();
+
+        //arrange
+
+        //act
+        int result = prov_auth_handoff_to_iothub(sec_handle, NULL, NULL);
+
+        //assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        prov_auth_destroy(sec_handle);
+    }
+
+    TEST_FUNCTION(prov_auth_handoff_to_iothub_fail)
+    {
+        PROV_AUTH_HANDLE sec_handle = prov_auth_create();
+        umock_c_reset_all_calls();
+
+        //arrange
+        STRICT_EXPECTED_CALL(iothub_device_auth_handoff_hsm(AUTH_TYPE_SAS, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, NULL)).SetReturn(__LINE__);
+
+        //act
+        int result = prov_auth_handoff_to_iothub(sec_handle, NULL, NULL);
+
+        //assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        prov_auth_destroy(sec_handle);
+    }
+
+    TEST_FUNCTION(prov_auth_destroy_after_handoff_succeed)
+    {
+        PROV_AUTH_HANDLE sec_handle = prov_auth_create();
+        (void)prov_auth_handoff_to_iothub(sec_handle, NULL, NULL);
+        umock_c_reset_all_calls();
+
+        //arrange
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+        //act
+        prov_auth_destroy(sec_handle);
+
+        //assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+    }
+
     END_TEST_SUITE(prov_auth_client_ut)
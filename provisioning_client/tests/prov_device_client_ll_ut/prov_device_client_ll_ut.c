@@ -41,6 +41,7 @@ static void my_gballoc_free(void* ptr)
 #include "azure_prov_client/internal/iothub_auth_client.h"
 #include "azure_prov_client/internal/prov_auth_client.h"
 #include "azure_prov_client/internal/prov_transport_private.h"
+#include "azure_prov_client/internal/prov_hsm_job_queue.h"
 #include "parson.h"
 
 #undef ENABLE_MOCKS
@@ -51,6 +52,8 @@ static void my_gballoc_free(void* ptr)
 #include "azure_c_shared_utility/umock_c_prod.h"
 MOCKABLE_FUNCTION(, void, on_prov_register_device_callback, PROV_DEVICE_RESULT, register_result, const char*, iothub_uri, const char*, device_id, void*, user_context);
 MOCKABLE_FUNCTION(, void, on_prov_register_status_callback, PROV_DEVICE_REG_STATUS, reg_status, void*, user_context);
+MOCKABLE_FUNCTION(, int, on_prov_load_assignment, const char*, registration_id, const char**, iothub_uri, const char**, device_id, void*, user_context);
+MOCKABLE_FUNCTION(, void, on_prov_store_assignment, const char*, registration_id, const char*, iothub_uri, const char*, device_id, void*, user_context);
 MOCKABLE_FUNCTION(, char*, on_prov_transport_challenge_cb, const unsigned char*, nonce, size_t, nonce_len, const char*, key_name, void*, user_ctx);
 
 MOCKABLE_FUNCTION(, PROV_DEVICE_TRANSPORT_HANDLE, prov_transport_create, const char*, uri, TRANSPORT_HSM_TYPE, type, const char*, scope_id, const char*, prov_api_version, PROV_TRANSPORT_ERROR_CALLBACK, error_cb, void*, error_ctx);
@@ -88,6 +91,10 @@ static void* g_status_ctx;
 static void* g_http_error_ctx;
 PROV_TRANSPORT_JSON_PARSE g_json_parse_cb;
 void* g_json_ctx;
+static PROV_HSM_JOB_FUNCTION g_hsm_job;
+static void* g_hsm_job_ctx;
+static PROV_HSM_JOB_COMPLETE_CALLBACK g_hsm_job_complete;
+static void* g_hsm_job_user_ctx;
 
 #ifdef __cplusplus
 extern "C"
@@ -122,6 +129,7 @@ static const PROV_DEVICE_TRANSPORT_PROVIDER* trans_provider(void)
 }
 
 static const BUFFER_HANDLE TEST_BUFFER_HANDLE = (BUFFER_HANDLE)0x11111116;
+static const PROV_HSM_JOB_QUEUE_HANDLE TEST_HSM_JOB_QUEUE = (PROV_HSM_JOB_QUEUE_HANDLE)0x11111117;
 
 static const char* TEST_JSON_REPLY = "{ json_reply }";
 static const char* TEST_PROV_URI = "www.prov_uri.com";
@@ -230,6 +238,34 @@ static void my_BUFFER_delete(BUFFER_HANDLE handle)
     my_gballoc_free(handle);
 }
 
+static BUFFER_HANDLE my_BUFFER_clone(BUFFER_HANDLE handle)
+{
+    (void)handle;
+    return (BUFFER_HANDLE)my_gballoc_malloc(1);
+}
+
+static int my_prov_hsm_job_queue_submit(PROV_HSM_JOB_QUEUE_HANDLE handle, PROV_HSM_JOB_FUNCTION job, void* job_context, PROV_HSM_JOB_COMPLETE_CALLBACK on_complete, void* user_context)
+{
+    (void)handle;
+    g_hsm_job = job;
+    g_hsm_job_ctx = job_context;
+    g_hsm_job_complete = on_complete;
+    g_hsm_job_user_ctx = user_context;
+    return 0;
+}
+
+static void my_prov_hsm_job_queue_dowork(PROV_HSM_JOB_QUEUE_HANDLE handle)
+{
+    (void)handle;
+    // Completes the submitted job as the worker would, the tests set g_hsm_job to NULL to keep it pending
+    if (g_hsm_job != NULL)
+    {
+        int job_result = g_hsm_job(g_hsm_job_ctx);
+        g_hsm_job = NULL;
+        g_hsm_job_complete(job_result, g_hsm_job_user_ctx);
+    }
+}
+
 static PROV_DEVICE_TRANSPORT_HANDLE my_prov_transport_create(const char* uri, TRANSPORT_HSM_TYPE type, const char* scope_id, const char* prov_api_version, PROV_TRANSPORT_ERROR_CALLBACK error_cb, void* error_ctx)
 {
     (void)type;
@@ -351,6 +387,15 @@ static int my_mallocAndStrcpy_s(char** destination, const char* source)
     return 0;
 }
 
+static int my_on_prov_load_assignment(const char* registration_id, const char** iothub_uri, const char** device_id, void* user_context)
+{
+    (void)registration_id;
+    (void)user_context;
+    *iothub_uri = TEST_IOTHUB;
+    *device_id = TEST_DEVICE_ID;
+    return 0;
+}
+
 static STRING_HANDLE my_Base64_Encode_Bytes(const unsigned char* source, size_t size)
 {
     (void)source;(void)size;
@@ -412,6 +457,10 @@ BEGIN_TEST_SUITE(prov_device_client_ll_ut)
         REGISTER_UMOCK_ALIAS_TYPE(SEC_HANDLE, void*);
         REGISTER_UMOCK_ALIAS_TYPE(PROV_TRANSPORT_JSON_PARSE, void*);
         REGISTER_UMOCK_ALIAS_TYPE(PROV_TRANSPORT_ERROR_CALLBACK, void*);
+        REGISTER_UMOCK_ALIAS_TYPE(const char**, void*);
+        REGISTER_UMOCK_ALIAS_TYPE(PROV_HSM_JOB_QUEUE_HANDLE, void*);
+        REGISTER_UMOCK_ALIAS_TYPE(PROV_HSM_JOB_FUNCTION, void*);
+        REGISTER_UMOCK_ALIAS_TYPE(PROV_HSM_JOB_COMPLETE_CALLBACK, void*);
 
         REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
         REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
@@ -474,6 +523,14 @@ BEGIN_TEST_SUITE(prov_device_client_ll_ut)
         REGISTER_GLOBAL_MOCK_RETURN(BUFFER_create, TEST_BUFFER_HANDLE);
         REGISTER_GLOBAL_MOCK_FAIL_RETURN(BUFFER_create, NULL);
         REGISTER_GLOBAL_MOCK_HOOK(BUFFER_delete, my_BUFFER_delete);
+        REGISTER_GLOBAL_MOCK_HOOK(BUFFER_clone, my_BUFFER_clone);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(BUFFER_clone, NULL);
+
+        REGISTER_GLOBAL_MOCK_RETURN(prov_hsm_job_queue_create, TEST_HSM_JOB_QUEUE);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(prov_hsm_job_queue_create, NULL);
+        REGISTER_GLOBAL_MOCK_HOOK(prov_hsm_job_queue_submit, my_prov_hsm_job_queue_submit);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(prov_hsm_job_queue_submit, __LINE__);
+        REGISTER_GLOBAL_MOCK_HOOK(prov_hsm_job_queue_dowork, my_prov_hsm_job_queue_dowork);
 
         REGISTER_GLOBAL_MOCK_HOOK(URL_EncodeString, my_URL_EncodeString);
         REGISTER_GLOBAL_MOCK_FAIL_RETURN(URL_EncodeString, NULL);
@@ -483,6 +540,7 @@ BEGIN_TEST_SUITE(prov_device_client_ll_ut)
 
         REGISTER_GLOBAL_MOCK_HOOK(mallocAndStrcpy_s, my_mallocAndStrcpy_s);
         REGISTER_GLOBAL_MOCK_FAIL_RETURN(mallocAndStrcpy_s, __LINE__);
+        REGISTER_GLOBAL_MOCK_HOOK(on_prov_load_assignment, my_on_prov_load_assignment);
 
         REGISTER_GLOBAL_MOCK_HOOK(Base64_Encode_Bytes, my_Base64_Encode_Bytes);
         REGISTER_GLOBAL_MOCK_FAIL_RETURN(Base64_Encode_Bytes, NULL);
@@ -512,6 +570,10 @@ BEGIN_TEST_SUITE(prov_device_client_ll_ut)
         g_challenge_ctx = NULL;
         g_json_parse_cb = NULL;
         g_json_ctx = NULL;
+        g_hsm_job = NULL;
+        g_hsm_job_ctx = NULL;
+        g_hsm_job_complete = NULL;
+        g_hsm_job_user_ctx = NULL;
     }
 
     TEST_FUNCTION_CLEANUP(method_cleanup)
@@ -545,6 +607,7 @@ BEGIN_TEST_SUITE(prov_device_client_ll_ut)
         STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG));
         STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG));
         STRICT_EXPECTED_CALL(prov_auth_import_key(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+        STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
         STRICT_EXPECTED_CALL(on_prov_register_device_callback(PROV_DEVICE_RESULT_OK, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     }
 
@@ -985,7 +1048,7 @@ BEGIN_TEST_SUITE(prov_device_client_ll_ut)
         //arrange
         PROV_DEVICE_LL_HANDLE handle = Prov_Device_LL_Create(TEST_PROV_URI, TEST_SCOPE_ID, trans_provider);
         (void)Prov_Device_LL_Register_Device(handle, on_prov_register_device_callback, NULL, on_prov_register_status_callback, NULL);
-        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, g_status_ctx);
+        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, 0, g_status_ctx);
         umock_c_reset_all_calls();
 
         setup_Prov_Device_LL_DoWork_register_send_mocks();
@@ -1005,7 +1068,7 @@ BEGIN_TEST_SUITE(prov_device_client_ll_ut)
         //arrange
         PROV_DEVICE_LL_HANDLE handle = Prov_Device_LL_Create(TEST_PROV_URI, TEST_SCOPE_ID, trans_provider);
         (void)Prov_Device_LL_Register_Device(handle, on_prov_register_device_callback, NULL, on_prov_register_status_callback, NULL);
-        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, g_status_ctx);
+        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, 0, g_status_ctx);
         umock_c_reset_all_calls();
 
         int negativeTestsInitResult = umock_c_negative_tests_init();
@@ -1057,7 +1120,7 @@ BEGIN_TEST_SUITE(prov_device_client_ll_ut)
         //arrange
         PROV_DEVICE_LL_HANDLE handle = Prov_Device_LL_Create(TEST_PROV_URI, TEST_SCOPE_ID, trans_provider);
         (void)Prov_Device_LL_Register_Device(handle, on_prov_register_device_callback, NULL, on_prov_register_status_callback, NULL);
-        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, g_status_ctx);
+        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, 0, g_status_ctx);
         Prov_Device_LL_DoWork(handle);
         umock_c_reset_all_calls();
 
@@ -1100,7 +1163,7 @@ BEGIN_TEST_SUITE(prov_device_client_ll_ut)
         //arrange
         PROV_DEVICE_LL_HANDLE handle = Prov_Device_LL_Create(TEST_PROV_URI, TEST_SCOPE_ID, trans_provider);
         (void)Prov_Device_LL_Register_Device(handle, on_prov_register_device_callback, NULL, on_prov_register_status_callback, NULL);
-        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, g_status_ctx);
+        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, 0, g_status_ctx);
         Prov_Device_LL_DoWork(handle);
         umock_c_reset_all_calls();
 
@@ -1127,7 +1190,7 @@ BEGIN_TEST_SUITE(prov_device_client_ll_ut)
         //arrange
         PROV_DEVICE_LL_HANDLE handle = Prov_Device_LL_Create(TEST_PROV_URI, TEST_SCOPE_ID, trans_provider);
         (void)Prov_Device_LL_Register_Device(handle, on_prov_register_device_callback, NULL, on_prov_register_status_callback, NULL);
-        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, g_status_ctx);
+        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, 0, g_status_ctx);
         Prov_Device_LL_DoWork(handle);
         umock_c_reset_all_calls();
 
@@ -1150,7 +1213,7 @@ BEGIN_TEST_SUITE(prov_device_client_ll_ut)
         //arrange
         PROV_DEVICE_LL_HANDLE handle = Prov_Device_LL_Create(TEST_PROV_URI, TEST_SCOPE_ID, trans_provider);
         (void)Prov_Device_LL_Register_Device(handle, on_prov_register_device_callback, NULL, on_prov_register_status_callback, NULL);
-        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, g_status_ctx);
+        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, 0, g_status_ctx);
         Prov_Device_LL_DoWork(handle);
         umock_c_reset_all_calls();
 
@@ -1176,7 +1239,7 @@ BEGIN_TEST_SUITE(prov_device_client_ll_ut)
         //arrange
         PROV_DEVICE_LL_HANDLE handle = Prov_Device_LL_Create(TEST_PROV_URI, TEST_SCOPE_ID, trans_provider);
         (void)Prov_Device_LL_Register_Device(handle, on_prov_register_device_callback, NULL, on_prov_register_status_callback, NULL);
-        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, g_status_ctx);
+        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, 0, g_status_ctx);
         Prov_Device_LL_DoWork(handle);
         umock_c_reset_all_calls();
 
@@ -1219,7 +1282,7 @@ BEGIN_TEST_SUITE(prov_device_client_ll_ut)
         //arrange
         PROV_DEVICE_LL_HANDLE handle = Prov_Device_LL_Create(TEST_PROV_URI, TEST_SCOPE_ID, trans_provider);
         (void)Prov_Device_LL_Register_Device(handle, on_prov_register_device_callback, NULL, on_prov_register_status_callback, NULL);
-        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, g_status_ctx);
+        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, 0, g_status_ctx);
         Prov_Device_LL_DoWork(handle);
         umock_c_reset_all_calls();
 
@@ -1253,7 +1316,7 @@ BEGIN_TEST_SUITE(prov_device_client_ll_ut)
         //arrange
         PROV_DEVICE_LL_HANDLE handle = Prov_Device_LL_Create(TEST_PROV_URI, TEST_SCOPE_ID, trans_provider);
         (void)Prov_Device_LL_Register_Device(handle, on_prov_register_device_callback, NULL, on_prov_register_status_callback, NULL);
-        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, g_status_ctx);
+        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, 0, g_status_ctx);
         Prov_Device_LL_DoWork(handle);
         umock_c_reset_all_calls();
 
@@ -1313,9 +1376,9 @@ BEGIN_TEST_SUITE(prov_device_client_ll_ut)
         //arrange
         PROV_DEVICE_LL_HANDLE handle = Prov_Device_LL_Create(TEST_PROV_URI, TEST_SCOPE_ID, trans_provider);
         (void)Prov_Device_LL_Register_Device(handle, on_prov_register_device_callback, NULL, on_prov_register_status_callback, NULL);
-        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, g_status_ctx);
+        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, 0, g_status_ctx);
         Prov_Device_LL_DoWork(handle);
-        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_AUTHENTICATED, g_status_ctx);
+        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_AUTHENTICATED, 0, g_status_ctx);
         umock_c_reset_all_calls();
 
         STRICT_EXPECTED_CALL(prov_transport_dowork(IGNORED_PTR_ARG));
@@ -1338,9 +1401,9 @@ BEGIN_TEST_SUITE(prov_device_client_ll_ut)
         //arrange
         PROV_DEVICE_LL_HANDLE handle = Prov_Device_LL_Create(TEST_PROV_URI, TEST_SCOPE_ID, trans_provider);
         (void)Prov_Device_LL_Register_Device(handle, on_prov_register_device_callback, NULL, on_prov_register_status_callback, NULL);
-        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, g_status_ctx);
+        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, 0, g_status_ctx);
         Prov_Device_LL_DoWork(handle);
-        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_AUTHENTICATED, g_status_ctx);
+        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_AUTHENTICATED, 0, g_status_ctx);
         umock_c_reset_all_calls();
 
         STRICT_EXPECTED_CALL(prov_transport_dowork(IGNORED_PTR_ARG));
@@ -1361,12 +1424,105 @@ BEGIN_TEST_SUITE(prov_device_client_ll_ut)
         Prov_Device_LL_Destroy(handle);
     }
 
+    TEST_FUNCTION(Prov_Device_LL_DoWork_get_operation_status_retry_after_wait_succeed)
+    {
+        //arrange
+        PROV_DEVICE_LL_HANDLE handle = Prov_Device_LL_Create(TEST_PROV_URI, TEST_SCOPE_ID, trans_provider);
+        (void)Prov_Device_LL_Register_Device(handle, on_prov_register_device_callback, NULL, on_prov_register_status_callback, NULL);
+        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, 0, g_status_ctx);
+        Prov_Device_LL_DoWork(handle);
+        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_AUTHENTICATED, 5, g_status_ctx);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(prov_transport_dowork(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+        //act
+        Prov_Device_LL_DoWork(handle);
+
+        //assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        Prov_Device_LL_Destroy(handle);
+    }
+
+    TEST_FUNCTION(Prov_Device_LL_DoWork_get_operation_status_backoff_wait_succeed)
+    {
+        //arrange
+        PROV_DEVICE_LL_HANDLE handle = Prov_Device_LL_Create(TEST_PROV_URI, TEST_SCOPE_ID, trans_provider);
+        (void)Prov_Device_LL_Register_Device(handle, on_prov_register_device_callback, NULL, on_prov_register_status_callback, NULL);
+        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, 0, g_status_ctx);
+        Prov_Device_LL_DoWork(handle);
+        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_AUTHENTICATED, 0, g_status_ctx);
+        Prov_Device_LL_DoWork(handle);
+        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_ASSIGNING, 0, g_status_ctx);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(prov_transport_dowork(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+        //act
+        Prov_Device_LL_DoWork(handle);
+
+        //assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        Prov_Device_LL_Destroy(handle);
+    }
+
+    TEST_FUNCTION(Prov_Device_LL_DoWork_register_transient_retry_after_wait_succeed)
+    {
+        //arrange
+        PROV_DEVICE_LL_HANDLE handle = Prov_Device_LL_Create(TEST_PROV_URI, TEST_SCOPE_ID, trans_provider);
+        (void)Prov_Device_LL_Register_Device(handle, on_prov_register_device_callback, NULL, on_prov_register_status_callback, NULL);
+        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, 0, g_status_ctx);
+        Prov_Device_LL_DoWork(handle);
+        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_TRANSIENT, 2, g_status_ctx);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(prov_transport_dowork(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+        //act
+        Prov_Device_LL_DoWork(handle);
+
+        //assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        Prov_Device_LL_Destroy(handle);
+    }
+
+    TEST_FUNCTION(Prov_Device_LL_DoWork_register_transient_no_retry_after_succeed)
+    {
+        //arrange
+        PROV_DEVICE_LL_HANDLE handle = Prov_Device_LL_Create(TEST_PROV_URI, TEST_SCOPE_ID, trans_provider);
+        (void)Prov_Device_LL_Register_Device(handle, on_prov_register_device_callback, NULL, on_prov_register_status_callback, NULL);
+        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, 0, g_status_ctx);
+        Prov_Device_LL_DoWork(handle);
+        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_TRANSIENT, 0, g_status_ctx);
+        umock_c_reset_all_calls();
+
+        setup_Prov_Device_LL_DoWork_register_send_mocks();
+
+        //act
+        Prov_Device_LL_DoWork(handle);
+
+        //assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        Prov_Device_LL_Destroy(handle);
+    }
+
     TEST_FUNCTION(Prov_Device_LL_challenge_cb_nonce_NULL_fail)
     {
         //arrange
         PROV_DEVICE_LL_HANDLE handle = Prov_Device_LL_Create(TEST_PROV_URI, TEST_SCOPE_ID, trans_provider);
         (void)Prov_Device_LL_Register_Device(handle, on_prov_register_device_callback, NULL, on_prov_register_status_callback, NULL);
-        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, g_status_ctx);
+        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, 0, g_status_ctx);
         Prov_Device_LL_DoWork(handle);
         umock_c_reset_all_calls();
 
@@ -1386,7 +1542,7 @@ BEGIN_TEST_SUITE(prov_device_client_ll_ut)
         //arrange
         PROV_DEVICE_LL_HANDLE handle = Prov_Device_LL_Create(TEST_PROV_URI, TEST_SCOPE_ID, trans_provider);
         (void)Prov_Device_LL_Register_Device(handle, on_prov_register_device_callback, NULL, on_prov_register_status_callback, NULL);
-        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, g_status_ctx);
+        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, 0, g_status_ctx);
         Prov_Device_LL_DoWork(handle);
         umock_c_reset_all_calls();
 
@@ -1406,7 +1562,7 @@ BEGIN_TEST_SUITE(prov_device_client_ll_ut)
         //arrange
         PROV_DEVICE_LL_HANDLE handle = Prov_Device_LL_Create(TEST_PROV_URI, TEST_SCOPE_ID, trans_provider);
         (void)Prov_Device_LL_Register_Device(handle, on_prov_register_device_callback, NULL, on_prov_register_status_callback, NULL);
-        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, g_status_ctx);
+        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, 0, g_status_ctx);
         Prov_Device_LL_DoWork(handle);
         umock_c_reset_all_calls();
 
@@ -1428,7 +1584,7 @@ BEGIN_TEST_SUITE(prov_device_client_ll_ut)
         //arrange
         PROV_DEVICE_LL_HANDLE handle = Prov_Device_LL_Create(TEST_PROV_URI, TEST_SCOPE_ID, trans_provider);
         (void)Prov_Device_LL_Register_Device(handle, on_prov_register_device_callback, NULL, on_prov_register_status_callback, NULL);
-        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, g_status_ctx);
+        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, 0, g_status_ctx);
         Prov_Device_LL_DoWork(handle);
         umock_c_reset_all_calls();
 
@@ -1472,7 +1628,7 @@ BEGIN_TEST_SUITE(prov_device_client_ll_ut)
         //arrange
         PROV_DEVICE_LL_HANDLE handle = Prov_Device_LL_Create(TEST_PROV_URI, TEST_SCOPE_ID, trans_provider);
         (void)Prov_Device_LL_Register_Device(handle, on_prov_register_device_callback, NULL, on_prov_register_status_callback, NULL);
-        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, g_status_ctx);
+        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, 0, g_status_ctx);
         Prov_Device_LL_DoWork(handle);
         umock_c_reset_all_calls();
 
@@ -1495,7 +1651,7 @@ BEGIN_TEST_SUITE(prov_device_client_ll_ut)
         //arrange
         PROV_DEVICE_LL_HANDLE handle = Prov_Device_LL_Create(TEST_PROV_URI, TEST_SCOPE_ID, trans_provider);
         (void)Prov_Device_LL_Register_Device(handle, on_prov_register_device_callback, NULL, on_prov_register_status_callback, NULL);
-        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, g_status_ctx);
+        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, 0, g_status_ctx);
         Prov_Device_LL_DoWork(handle);
         umock_c_reset_all_calls();
 
@@ -1514,7 +1670,7 @@ BEGIN_TEST_SUITE(prov_device_client_ll_ut)
         //arrange
         PROV_DEVICE_LL_HANDLE handle = Prov_Device_LL_Create(TEST_PROV_URI, TEST_SCOPE_ID, trans_provider);
         (void)Prov_Device_LL_Register_Device(handle, on_prov_register_device_callback, NULL, on_prov_register_status_callback, NULL);
-        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, g_status_ctx);
+        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, 0, g_status_ctx);
         Prov_Device_LL_DoWork(handle);
         umock_c_reset_all_calls();
 
@@ -1533,7 +1689,7 @@ BEGIN_TEST_SUITE(prov_device_client_ll_ut)
         //arrange
         PROV_DEVICE_LL_HANDLE handle = Prov_Device_LL_Create(TEST_PROV_URI, TEST_SCOPE_ID, trans_provider);
         (void)Prov_Device_LL_Register_Device(handle, on_prov_register_device_callback, NULL, on_prov_register_status_callback, NULL);
-        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, g_status_ctx);
+        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, 0, g_status_ctx);
         Prov_Device_LL_DoWork(handle);
         umock_c_reset_all_calls();
 
@@ -1552,7 +1708,7 @@ BEGIN_TEST_SUITE(prov_device_client_ll_ut)
         //arrange
         PROV_DEVICE_LL_HANDLE handle = Prov_Device_LL_Create(TEST_PROV_URI, TEST_SCOPE_ID, trans_provider);
         (void)Prov_Device_LL_Register_Device(handle, on_prov_register_device_callback, NULL, on_prov_register_status_callback, NULL);
-        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, g_status_ctx);
+        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, 0, g_status_ctx);
         Prov_Device_LL_DoWork(handle);
         umock_c_reset_all_calls();
 
@@ -1596,7 +1752,7 @@ BEGIN_TEST_SUITE(prov_device_client_ll_ut)
         //arrange
         PROV_DEVICE_LL_HANDLE handle = Prov_Device_LL_Create(TEST_PROV_URI, TEST_SCOPE_ID, trans_provider);
         (void)Prov_Device_LL_Register_Device(handle, on_prov_register_device_callback, NULL, on_prov_register_status_callback, NULL);
-        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, g_status_ctx);
+        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, 0, g_status_ctx);
         Prov_Device_LL_DoWork(handle);
         umock_c_reset_all_calls();
 
@@ -1620,7 +1776,7 @@ BEGIN_TEST_SUITE(prov_device_client_ll_ut)
         //arrange
         PROV_DEVICE_LL_HANDLE handle = Prov_Device_LL_Create(TEST_PROV_URI, TEST_SCOPE_ID, trans_provider);
         (void)Prov_Device_LL_Register_Device(handle, on_prov_register_device_callback, NULL, on_prov_register_status_callback, NULL);
-        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, g_status_ctx);
+        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, 0, g_status_ctx);
         Prov_Device_LL_DoWork(handle);
         umock_c_reset_all_calls();
 
@@ -1745,7 +1901,7 @@ BEGIN_TEST_SUITE(prov_device_client_ll_ut)
         //arrange
         PROV_DEVICE_LL_HANDLE handle = Prov_Device_LL_Create(TEST_PROV_URI, TEST_SCOPE_ID, trans_provider);
         (void)Prov_Device_LL_Register_Device(handle, on_prov_register_device_callback, NULL, on_prov_register_status_callback, NULL);
-        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, g_status_ctx);
+        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, 0, g_status_ctx);
         umock_c_reset_all_calls();
 
         STRICT_EXPECTED_CALL(prov_transport_set_trace(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
@@ -1767,7 +1923,7 @@ BEGIN_TEST_SUITE(prov_device_client_ll_ut)
         //arrange
         PROV_DEVICE_LL_HANDLE handle = Prov_Device_LL_Create(TEST_PROV_URI, TEST_SCOPE_ID, trans_provider);
         (void)Prov_Device_LL_Register_Device(handle, on_prov_register_device_callback, NULL, on_prov_register_status_callback, NULL);
-        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, g_status_ctx);
+        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, 0, g_status_ctx);
         umock_c_reset_all_calls();
 
         STRICT_EXPECTED_CALL(prov_transport_set_trace(IGNORED_PTR_ARG, IGNORED_NUM_ARG)).SetReturn(__LINE__);
@@ -1885,7 +2041,7 @@ BEGIN_TEST_SUITE(prov_device_client_ll_ut)
         //arrange
         PROV_DEVICE_LL_HANDLE handle = Prov_Device_LL_Create(TEST_PROV_URI, TEST_SCOPE_ID, trans_provider);
         (void)Prov_Device_LL_Register_Device(handle, on_prov_register_device_callback, NULL, on_prov_register_status_callback, NULL);
-        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, g_status_ctx);
+        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, 0, g_status_ctx);
         umock_c_reset_all_calls();
 
         //act
@@ -1935,4 +2091,566 @@ BEGIN_TEST_SUITE(prov_device_client_ll_ut)
         Prov_Device_LL_Destroy(handle);
     }
 
+    TEST_FUNCTION(Prov_Device_LL_SetOption_handoff_to_iothub_NULL_fail)
+    {
+        //arrange
+        PROV_DEVICE_LL_HANDLE handle = Prov_Device_LL_Create(TEST_PROV_URI, TEST_SCOPE_ID, trans_provider);
+        umock_c_reset_all_calls();
+
+        //act
+        PROV_DEVICE_RESULT prov_result = Prov_Device_LL_SetOption(handle, PROV_OPTION_HANDOFF_TO_IOTHUB, NULL);
+
+        //assert
+        ASSERT_ARE_EQUAL(PROV_DEVICE_RESULT, PROV_DEVICE_RESULT_ERROR, prov_result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        Prov_Device_LL_Destroy(handle);
+    }
+
+    TEST_FUNCTION(Prov_Device_LL_SetOption_handoff_to_iothub_success)
+    {
+        //arrange
+        PROV_DEVICE_LL_HANDLE handle = Prov_Device_LL_Create(TEST_PROV_URI, TEST_SCOPE_ID, trans_provider);
+        umock_c_reset_all_calls();
+
+        bool handoff = true;
+
+        //act
+        PROV_DEVICE_RESULT prov_result = Prov_Device_LL_SetOption(handle, PROV_OPTION_HANDOFF_TO_IOTHUB, &handoff);
+
+        //assert
+        ASSERT_ARE_EQUAL(PROV_DEVICE_RESULT, PROV_DEVICE_RESULT_OK, prov_result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        Prov_Device_LL_Destroy(handle);
+    }
+
+    TEST_FUNCTION(Prov_Device_LL_SetOption_async_hsm_NULL_fail)
+    {
+        //arrange
+        PROV_DEVICE_LL_HANDLE handle = Prov_Device_LL_Create(TEST_PROV_URI, TEST_SCOPE_ID, trans_provider);
+        umock_c_reset_all_calls();
+
+        //act
+        PROV_DEVICE_RESULT prov_result = Prov_Device_LL_SetOption(handle, PROV_OPTION_ASYNC_HSM, NULL);
+
+        //assert
+        ASSERT_ARE_EQUAL(PROV_DEVICE_RESULT, PROV_DEVICE_RESULT_ERROR, prov_result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        Prov_Device_LL_Destroy(handle);
+    }
+
+    TEST_FUNCTION(Prov_Device_LL_SetOption_async_hsm_success)
+    {
+        //arrange
+        bool async_hsm = true;
+        PROV_DEVICE_LL_HANDLE handle = Prov_Device_LL_Create(TEST_PROV_URI, TEST_SCOPE_ID, trans_provider);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(prov_hsm_job_queue_create());
+
+        //act
+        PROV_DEVICE_RESULT prov_result = Prov_Device_LL_SetOption(handle, PROV_OPTION_ASYNC_HSM, &async_hsm);
+
+        //assert
+        ASSERT_ARE_EQUAL(PROV_DEVICE_RESULT, PROV_DEVICE_RESULT_OK, prov_result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        Prov_Device_LL_Destroy(handle);
+    }
+
+    TEST_FUNCTION(Prov_Device_LL_SetOption_async_hsm_create_fail)
+    {
+        //arrange
+        bool async_hsm = true;
+        PROV_DEVICE_LL_HANDLE handle = Prov_Device_LL_Create(TEST_PROV_URI, TEST_SCOPE_ID, trans_provider);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(prov_hsm_job_queue_create()).SetReturn(NULL);
+
+        //act
+        PROV_DEVICE_RESULT prov_result = Prov_Device_LL_SetOption(handle, PROV_OPTION_ASYNC_HSM, &async_hsm);
+
+        //assert
+        ASSERT_ARE_EQUAL(PROV_DEVICE_RESULT, PROV_DEVICE_RESULT_ERROR, prov_result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        Prov_Device_LL_Destroy(handle);
+    }
+
+    TEST_FUNCTION(Prov_Device_LL_Destroy_async_hsm_succeed)
+    {
+        //arrange
+        bool async_hsm = true;
+        PROV_DEVICE_LL_HANDLE handle = Prov_Device_LL_Create(TEST_PROV_URI, TEST_SCOPE_ID, trans_provider);
+        (void)Prov_Device_LL_SetOption(handle, PROV_OPTION_ASYNC_HSM, &async_hsm);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(prov_hsm_job_queue_destroy(TEST_HSM_JOB_QUEUE));
+        setup_destroy_prov_info_mocks();
+
+        //act
+        Prov_Device_LL_Destroy(handle);
+
+        //assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+    }
+
+    TEST_FUNCTION(Prov_Device_LL_on_registration_data_async_hsm_queues_import_succeed)
+    {
+        //arrange
+        bool async_hsm = true;
+        PROV_DEVICE_LL_HANDLE handle = Prov_Device_LL_Create(TEST_PROV_URI, TEST_SCOPE_ID, trans_provider);
+        (void)Prov_Device_LL_SetOption(handle, PROV_OPTION_ASYNC_HSM, &async_hsm);
+        (void)Prov_Device_LL_Register_Device(handle, on_prov_register_device_callback, NULL, on_prov_register_status_callback, NULL);
+        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, 0, g_status_ctx);
+        Prov_Device_LL_DoWork(handle);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(BUFFER_clone(TEST_BUFFER_HANDLE_VALUE));
+        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_IOTHUB));
+        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_DEVICE_ID));
+        STRICT_EXPECTED_CALL(prov_hsm_job_queue_submit(TEST_HSM_JOB_QUEUE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+        //act
+        g_registration_callback(PROV_DEVICE_TRANSPORT_RESULT_OK, TEST_BUFFER_HANDLE_VALUE, TEST_IOTHUB, TEST_DEVICE_ID, g_registration_ctx);
+
+        //assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_IS_NOT_NULL(g_hsm_job);
+
+        //cleanup
+        Prov_Device_LL_Destroy(handle);
+    }
+
+    TEST_FUNCTION(Prov_Device_LL_on_registration_data_async_hsm_submit_fail)
+    {
+        //arrange
+        bool async_hsm = true;
+        PROV_DEVICE_LL_HANDLE handle = Prov_Device_LL_Create(TEST_PROV_URI, TEST_SCOPE_ID, trans_provider);
+        (void)Prov_Device_LL_SetOption(handle, PROV_OPTION_ASYNC_HSM, &async_hsm);
+        (void)Prov_Device_LL_Register_Device(handle, on_prov_register_device_callback, NULL, on_prov_register_status_callback, NULL);
+        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, 0, g_status_ctx);
+        Prov_Device_LL_DoWork(handle);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(BUFFER_clone(TEST_BUFFER_HANDLE_VALUE));
+        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_IOTHUB));
+        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_DEVICE_ID));
+        STRICT_EXPECTED_CALL(prov_hsm_job_queue_submit(TEST_HSM_JOB_QUEUE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG)).SetReturn(__LINE__);
+        STRICT_EXPECTED_CALL(on_prov_register_device_callback(PROV_DEVICE_RESULT_KEY_ERROR, NULL, NULL, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(prov_transport_close(IGNORED_PTR_ARG));
+        setup_cleanup_prov_info_mocks();
+        STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+
+        //act
+        g_registration_callback(PROV_DEVICE_TRANSPORT_RESULT_OK, TEST_BUFFER_HANDLE_VALUE, TEST_IOTHUB, TEST_DEVICE_ID, g_registration_ctx);
+        Prov_Device_LL_DoWork(handle);
+
+        //assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        Prov_Device_LL_Destroy(handle);
+    }
+
+    TEST_FUNCTION(Prov_Device_LL_DoWork_async_hsm_pending_succeed)
+    {
+        //arrange
+        bool async_hsm = true;
+        PROV_DEVICE_LL_HANDLE handle = Prov_Device_LL_Create(TEST_PROV_URI, TEST_SCOPE_ID, trans_provider);
+        (void)Prov_Device_LL_SetOption(handle, PROV_OPTION_ASYNC_HSM, &async_hsm);
+        (void)Prov_Device_LL_Register_Device(handle, on_prov_register_device_callback, NULL, on_prov_register_status_callback, NULL);
+        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, 0, g_status_ctx);
+        Prov_Device_LL_DoWork(handle);
+        g_registration_callback(PROV_DEVICE_TRANSPORT_RESULT_OK, TEST_BUFFER_HANDLE_VALUE, TEST_IOTHUB, TEST_DEVICE_ID, g_registration_ctx);
+        umock_c_reset_all_calls();
+
+        // the worker has not run the import yet
+        g_hsm_job = NULL;
+
+        STRICT_EXPECTED_CALL(prov_transport_dowork(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(prov_hsm_job_queue_dowork(TEST_HSM_JOB_QUEUE));
+
+        //act
+        Prov_Device_LL_DoWork(handle);
+
+        //assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        Prov_Device_LL_Destroy(handle);
+    }
+
+    TEST_FUNCTION(Prov_Device_LL_DoWork_async_hsm_import_complete_succeed)
+    {
+        //arrange
+        bool async_hsm = true;
+        PROV_DEVICE_LL_HANDLE handle = Prov_Device_LL_Create(TEST_PROV_URI, TEST_SCOPE_ID, trans_provider);
+        (void)Prov_Device_LL_SetOption(handle, PROV_OPTION_ASYNC_HSM, &async_hsm);
+        (void)Prov_Device_LL_Register_Device(handle, on_prov_register_device_callback, NULL, on_prov_register_status_callback, NULL);
+        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, 0, g_status_ctx);
+        Prov_Device_LL_DoWork(handle);
+        g_registration_callback(PROV_DEVICE_TRANSPORT_RESULT_OK, TEST_BUFFER_HANDLE_VALUE, TEST_IOTHUB, TEST_DEVICE_ID, g_registration_ctx);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(prov_transport_dowork(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(prov_hsm_job_queue_dowork(TEST_HSM_JOB_QUEUE));
+        STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(prov_auth_import_key(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+        STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(on_prov_register_device_callback(PROV_DEVICE_RESULT_OK, TEST_IOTHUB, TEST_DEVICE_ID, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(prov_transport_close(IGNORED_PTR_ARG));
+        setup_cleanup_prov_info_mocks();
+        STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+
+        //act
+        Prov_Device_LL_DoWork(handle);
+
+        //assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        Prov_Device_LL_Destroy(handle);
+    }
+
+    TEST_FUNCTION(Prov_Device_LL_DoWork_async_hsm_import_fail)
+    {
+        //arrange
+        bool async_hsm = true;
+        PROV_DEVICE_LL_HANDLE handle = Prov_Device_LL_Create(TEST_PROV_URI, TEST_SCOPE_ID, trans_provider);
+        (void)Prov_Device_LL_SetOption(handle, PROV_OPTION_ASYNC_HSM, &async_hsm);
+        (void)Prov_Device_LL_Register_Device(handle, on_prov_register_device_callback, NULL, on_prov_register_status_callback, NULL);
+        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, 0, g_status_ctx);
+        Prov_Device_LL_DoWork(handle);
+        g_registration_callback(PROV_DEVICE_TRANSPORT_RESULT_OK, TEST_BUFFER_HANDLE_VALUE, TEST_IOTHUB, TEST_DEVICE_ID, g_registration_ctx);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(prov_transport_dowork(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(prov_hsm_job_queue_dowork(TEST_HSM_JOB_QUEUE));
+        STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(prov_auth_import_key(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG)).SetReturn(__LINE__);
+
+        //act
+        Prov_Device_LL_DoWork(handle);
+
+        //assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        Prov_Device_LL_Destroy(handle);
+    }
+
+    TEST_FUNCTION(Prov_Device_LL_on_registration_data_handoff_to_iothub_succeed)
+    {
+        //arrange
+        bool handoff = true;
+        PROV_DEVICE_LL_HANDLE handle = Prov_Device_LL_Create(TEST_PROV_URI, TEST_SCOPE_ID, trans_provider);
+        (void)Prov_Device_LL_SetOption(handle, PROV_OPTION_HANDOFF_TO_IOTHUB, &handoff);
+        (void)Prov_Device_LL_Register_Device(handle, on_prov_register_device_callback, NULL, on_prov_register_status_callback, NULL);
+        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, 0, g_status_ctx);
+        Prov_Device_LL_DoWork(handle);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(prov_auth_import_key(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+        STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(prov_auth_handoff_to_iothub(IGNORED_PTR_ARG, NULL, NULL));
+        STRICT_EXPECTED_CALL(on_prov_register_device_callback(PROV_DEVICE_RESULT_OK, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(prov_transport_close(IGNORED_PTR_ARG));
+        setup_cleanup_prov_info_mocks();
+
+        //act
+        g_registration_callback(PROV_DEVICE_TRANSPORT_RESULT_OK, TEST_BUFFER_HANDLE_VALUE, TEST_IOTHUB, TEST_DEVICE_ID, g_registration_ctx);
+
+        //assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        Prov_Device_LL_Destroy(handle);
+    }
+
+    TEST_FUNCTION(Prov_Device_LL_Register_Device_after_handoff_fail)
+    {
+        //arrange
+        bool handoff = true;
+        PROV_DEVICE_LL_HANDLE handle = Prov_Device_LL_Create(TEST_PROV_URI, TEST_SCOPE_ID, trans_provider);
+        (void)Prov_Device_LL_SetOption(handle, PROV_OPTION_HANDOFF_TO_IOTHUB, &handoff);
+        (void)Prov_Device_LL_Register_Device(handle, on_prov_register_device_callback, NULL, on_prov_register_status_callback, NULL);
+        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, 0, g_status_ctx);
+        Prov_Device_LL_DoWork(handle);
+        g_registration_callback(PROV_DEVICE_TRANSPORT_RESULT_OK, TEST_BUFFER_HANDLE_VALUE, TEST_IOTHUB, TEST_DEVICE_ID, g_registration_ctx);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(prov_auth_get_registration_id(IGNORED_PTR_ARG));
+
+        //act
+        PROV_DEVICE_RESULT prov_result = Prov_Device_LL_Register_Device(handle, on_prov_register_device_callback, NULL, on_prov_register_status_callback, NULL);
+
+        //assert
+        ASSERT_ARE_EQUAL(PROV_DEVICE_RESULT, PROV_DEVICE_RESULT_ERROR, prov_result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        Prov_Device_LL_Destroy(handle);
+    }
+
+    static void set_test_assignment_cache(PROV_DEVICE_LL_HANDLE handle)
+    {
+        PROV_DEVICE_ASSIGNMENT_CACHE cache;
+        cache.load_assignment = on_prov_load_assignment;
+        cache.store_assignment = on_prov_store_assignment;
+        cache.user_context = NULL;
+        (void)Prov_Device_LL_SetOption(handle, PROV_OPTION_ASSIGNMENT_CACHE, &cache);
+    }
+
+    TEST_FUNCTION(Prov_Device_LL_SetOption_assignment_cache_success)
+    {
+        //arrange
+        PROV_DEVICE_LL_HANDLE handle = Prov_Device_LL_Create(TEST_PROV_URI, TEST_SCOPE_ID, trans_provider);
+        umock_c_reset_all_calls();
+
+        PROV_DEVICE_ASSIGNMENT_CACHE cache;
+        cache.load_assignment = on_prov_load_assignment;
+        cache.store_assignment = on_prov_store_assignment;
+        cache.user_context = NULL;
+
+        //act
+        PROV_DEVICE_RESULT prov_result = Prov_Device_LL_SetOption(handle, PROV_OPTION_ASSIGNMENT_CACHE, &cache);
+
+        //assert
+        ASSERT_ARE_EQUAL(PROV_DEVICE_RESULT, PROV_DEVICE_RESULT_OK, prov_result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        Prov_Device_LL_Destroy(handle);
+    }
+
+    TEST_FUNCTION(Prov_Device_LL_SetOption_skip_assignment_cache_NULL_fail)
+    {
+        //arrange
+        PROV_DEVICE_LL_HANDLE handle = Prov_Device_LL_Create(TEST_PROV_URI, TEST_SCOPE_ID, trans_provider);
+        umock_c_reset_all_calls();
+
+        //act
+        PROV_DEVICE_RESULT prov_result = Prov_Device_LL_SetOption(handle, PROV_OPTION_SKIP_ASSIGNMENT_CACHE, NULL);
+
+        //assert
+        ASSERT_ARE_EQUAL(PROV_DEVICE_RESULT, PROV_DEVICE_RESULT_ERROR, prov_result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        Prov_Device_LL_Destroy(handle);
+    }
+
+    TEST_FUNCTION(Prov_Device_LL_Register_Device_cached_assignment_succeed)
+    {
+        //arrange
+        PROV_DEVICE_LL_HANDLE handle = Prov_Device_LL_Create(TEST_PROV_URI, TEST_SCOPE_ID, trans_provider);
+        set_test_assignment_cache(handle);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(prov_auth_get_registration_id(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(on_prov_load_assignment(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_IOTHUB));
+        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_DEVICE_ID));
+
+        //act
+        PROV_DEVICE_RESULT prov_result = Prov_Device_LL_Register_Device(handle, on_prov_register_device_callback, NULL, on_prov_register_status_callback, NULL);
+
+        //assert
+        ASSERT_ARE_EQUAL(PROV_DEVICE_RESULT, PROV_DEVICE_RESULT_OK, prov_result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        Prov_Device_LL_Destroy(handle);
+    }
+
+    TEST_FUNCTION(Prov_Device_LL_Register_Device_cache_miss_succeed)
+    {
+        //arrange
+        PROV_DEVICE_LL_HANDLE handle = Prov_Device_LL_Create(TEST_PROV_URI, TEST_SCOPE_ID, trans_provider);
+        set_test_assignment_cache(handle);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(prov_auth_get_registration_id(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(on_prov_load_assignment(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG)).SetReturn(__LINE__);
+        STRICT_EXPECTED_CALL(prov_auth_get_endorsement_key(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(prov_auth_get_storage_key(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(prov_transport_open(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+
+        //act
+        PROV_DEVICE_RESULT prov_result = Prov_Device_LL_Register_Device(handle, on_prov_register_device_callback, NULL, on_prov_register_status_callback, NULL);
+
+        //assert
+        ASSERT_ARE_EQUAL(PROV_DEVICE_RESULT, PROV_DEVICE_RESULT_OK, prov_result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        Prov_Device_LL_Destroy(handle);
+    }
+
+    TEST_FUNCTION(Prov_Device_LL_Register_Device_skip_assignment_cache_succeed)
+    {
+        //arrange
+        bool skip_cache = true;
+        PROV_DEVICE_LL_HANDLE handle = Prov_Device_LL_Create(TEST_PROV_URI, TEST_SCOPE_ID, trans_provider);
+        set_test_assignment_cache(handle);
+        (void)Prov_Device_LL_SetOption(handle, PROV_OPTION_SKIP_ASSIGNMENT_CACHE, &skip_cache);
+        umock_c_reset_all_calls();
+
+        setup_Prov_Device_LL_Register_Device_mocks(true);
+
+        //act
+        PROV_DEVICE_RESULT prov_result = Prov_Device_LL_Register_Device(handle, on_prov_register_device_callback, NULL, on_prov_register_status_callback, NULL);
+
+        //assert
+        ASSERT_ARE_EQUAL(PROV_DEVICE_RESULT, PROV_DEVICE_RESULT_OK, prov_result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        Prov_Device_LL_Destroy(handle);
+    }
+
+    TEST_FUNCTION(Prov_Device_LL_DoWork_cached_assignment_succeed)
+    {
+        //arrange
+        PROV_DEVICE_LL_HANDLE handle = Prov_Device_LL_Create(TEST_PROV_URI, TEST_SCOPE_ID, trans_provider);
+        set_test_assignment_cache(handle);
+        (void)Prov_Device_LL_Register_Device(handle, on_prov_register_device_callback, NULL, on_prov_register_status_callback, NULL);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(on_prov_register_device_callback(PROV_DEVICE_RESULT_OK, TEST_IOTHUB, TEST_DEVICE_ID, IGNORED_PTR_ARG));
+        setup_cleanup_prov_info_mocks();
+
+        //act
+        Prov_Device_LL_DoWork(handle);
+
+        //assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        Prov_Device_LL_Destroy(handle);
+    }
+
+    TEST_FUNCTION(Prov_Device_LL_on_registration_data_store_assignment_succeed)
+    {
+        //arrange
+        bool skip_cache = true;
+        PROV_DEVICE_LL_HANDLE handle = Prov_Device_LL_Create(TEST_PROV_URI, TEST_SCOPE_ID, trans_provider);
+        set_test_assignment_cache(handle);
+        (void)Prov_Device_LL_SetOption(handle, PROV_OPTION_SKIP_ASSIGNMENT_CACHE, &skip_cache);
+        (void)Prov_Device_LL_Register_Device(handle, on_prov_register_device_callback, NULL, on_prov_register_status_callback, NULL);
+        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, 0, g_status_ctx);
+        Prov_Device_LL_DoWork(handle);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(prov_auth_import_key(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+        STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(on_prov_store_assignment(IGNORED_PTR_ARG, TEST_IOTHUB, TEST_DEVICE_ID, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(on_prov_register_device_callback(PROV_DEVICE_RESULT_OK, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(prov_transport_close(IGNORED_PTR_ARG));
+        setup_cleanup_prov_info_mocks();
+
+        //act
+        g_registration_callback(PROV_DEVICE_TRANSPORT_RESULT_OK, TEST_BUFFER_HANDLE_VALUE, TEST_IOTHUB, TEST_DEVICE_ID, g_registration_ctx);
+
+        //assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        Prov_Device_LL_Destroy(handle);
+    }
+
+    TEST_FUNCTION(Prov_Device_LL_GetTimeToAssigned_handle_NULL_fail)
+    {
+        //arrange
+        uint32_t time_to_assigned;
+
+        //act
+        PROV_DEVICE_RESULT prov_result = Prov_Device_LL_GetTimeToAssigned(NULL, &time_to_assigned);
+
+        //assert
+        ASSERT_ARE_EQUAL(PROV_DEVICE_RESULT, PROV_DEVICE_RESULT_INVALID_ARG, prov_result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+    }
+
+    TEST_FUNCTION(Prov_Device_LL_GetTimeToAssigned_time_to_assigned_NULL_fail)
+    {
+        //arrange
+        PROV_DEVICE_LL_HANDLE handle = Prov_Device_LL_Create(TEST_PROV_URI, TEST_SCOPE_ID, trans_provider);
+        umock_c_reset_all_calls();
+
+        //act
+        PROV_DEVICE_RESULT prov_result = Prov_Device_LL_GetTimeToAssigned(handle, NULL);
+
+        //assert
+        ASSERT_ARE_EQUAL(PROV_DEVICE_RESULT, PROV_DEVICE_RESULT_INVALID_ARG, prov_result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        Prov_Device_LL_Destroy(handle);
+    }
+
+    TEST_FUNCTION(Prov_Device_LL_GetTimeToAssigned_not_assigned_fail)
+    {
+        //arrange
+        uint32_t time_to_assigned;
+        PROV_DEVICE_LL_HANDLE handle = Prov_Device_LL_Create(TEST_PROV_URI, TEST_SCOPE_ID, trans_provider);
+        (void)Prov_Device_LL_Register_Device(handle, on_prov_register_device_callback, NULL, on_prov_register_status_callback, NULL);
+        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, 0, g_status_ctx);
+        Prov_Device_LL_DoWork(handle);
+        umock_c_reset_all_calls();
+
+        //act
+        PROV_DEVICE_RESULT prov_result = Prov_Device_LL_GetTimeToAssigned(handle, &time_to_assigned);
+
+        //assert
+        ASSERT_ARE_EQUAL(PROV_DEVICE_RESULT, PROV_DEVICE_RESULT_INVALID_STATE, prov_result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        Prov_Device_LL_Destroy(handle);
+    }
+
+    TEST_FUNCTION(Prov_Device_LL_GetTimeToAssigned_succeed)
+    {
+        //arrange
+        uint32_t time_to_assigned = 1;
+        PROV_DEVICE_LL_HANDLE handle = Prov_Device_LL_Create(TEST_PROV_URI, TEST_SCOPE_ID, trans_provider);
+        (void)Prov_Device_LL_Register_Device(handle, on_prov_register_device_callback, NULL, on_prov_register_status_callback, NULL);
+        g_status_callback(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, 0, g_status_ctx);
+        Prov_Device_LL_DoWork(handle);
+        g_registration_callback(PROV_DEVICE_TRANSPORT_RESULT_OK, TEST_BUFFER_HANDLE_VALUE, TEST_IOTHUB, TEST_DEVICE_ID, g_registration_ctx);
+        umock_c_reset_all_calls();
+
+        //act
+        PROV_DEVICE_RESULT prov_result = Prov_Device_LL_GetTimeToAssigned(handle, &time_to_assigned);
+
+        //assert
+        ASSERT_ARE_EQUAL(PROV_DEVICE_RESULT, PROV_DEVICE_RESULT_OK, prov_result);
+        ASSERT_ARE_EQUAL(int, 0, (int)time_to_assigned);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        Prov_Device_LL_Destroy(handle);
+    }
+
     END_TEST_SUITE(prov_device_client_ll_ut)
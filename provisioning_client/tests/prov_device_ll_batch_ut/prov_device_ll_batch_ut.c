@@ -0,0 +1,633 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#else
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#endif
+
+#if defined _MSC_VER
+#pragma warning(disable: 4054) /* MSC incorrectly fires this */
+#endif
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+#include "umock_c_negative_tests.h"
+#include "azure_c_shared_utility/macro_utils.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/umock_c_prod.h"
+#include "azure_c_shared_utility/crt_abstractions.h"
+#include "azure_prov_client/prov_device_ll_client.h"
+#include "azure_prov_client/prov_security_factory.h"
+
+MOCKABLE_FUNCTION(, void, test_register_callback, PROV_DEVICE_RESULT, register_result, const char*, iothub_uri, const char*, device_id, void*, user_context);
+MOCKABLE_FUNCTION(, void, test_configure_callback, PROV_DEVICE_LL_HANDLE, prov_handle, const char*, registration_id, void*, user_context);
+#undef ENABLE_MOCKS
+
+#include "azure_prov_client/prov_device_ll_batch.h"
+
+#define TEST_URI                "global.azure-devices-provisioning.net"
+#define TEST_SCOPE_ID           "0ne00000001"
+#define TEST_REGISTRATION_ID    "leaf-device-1"
+#define TEST_REGISTRATION_ID_2  "leaf-device-2"
+#define TEST_REGISTRATION_ID_3  "leaf-device-3"
+#define TEST_SYMMETRIC_KEY      "dGVzdCBzeW1tZXRyaWMga2V5"
+#define TEST_IOTHUB_URI         "hub.azure-devices.net"
+#define TEST_USER_CONTEXT       (void*)0x11111111
+#define TEST_CONFIGURE_CONTEXT  (void*)0x11111112
+
+TEST_DEFINE_ENUM_TYPE(PROV_DEVICE_RESULT, PROV_DEVICE_RESULT_VALUE);
+IMPLEMENT_UMOCK_C_ENUM_TYPE(PROV_DEVICE_RESULT, PROV_DEVICE_RESULT_VALUE);
+
+static PROV_DEVICE_CLIENT_REGISTER_DEVICE_CALLBACK g_register_callback;
+static void* g_register_context;
+static bool g_complete_on_dowork;
+
+static const PROV_DEVICE_TRANSPORT_PROVIDER* test_protocol(void)
+{
+    return NULL;
+}
+
+static int my_mallocAndStrcpy_s(char** destination, const char* source)
+{
+    size_t size = strlen(source) + 1;
+    *destination = (char*)my_gballoc_malloc(size);
+    (void)memcpy(*destination, source, size);
+    return 0;
+}
+
+static PROV_DEVICE_LL_HANDLE my_Prov_Device_LL_Create(const char* uri, const char* scope_id, PROV_DEVICE_TRANSPORT_PROVIDER_FUNCTION protocol)
+{
+    (void)uri;
+    (void)scope_id;
+    (void)protocol;
+    return (PROV_DEVICE_LL_HANDLE)my_gballoc_malloc(1);
+}
+
+static void my_Prov_Device_LL_Destroy(PROV_DEVICE_LL_HANDLE handle)
+{
+    my_gballoc_free(handle);
+}
+
+static PROV_DEVICE_RESULT my_Prov_Device_LL_Register_Device(PROV_DEVICE_LL_HANDLE handle, PROV_DEVICE_CLIENT_REGISTER_DEVICE_CALLBACK register_callback, void* user_context, PROV_DEVICE_CLIENT_REGISTER_STATUS_CALLBACK reg_status_cb, void* status_user_ctext)
+{
+    (void)handle;
+    (void)reg_status_cb;
+    (void)status_user_ctext;
+    g_register_callback = register_callback;
+    g_register_context = user_context;
+    return PROV_DEVICE_RESULT_OK;
+}
+
+static void my_Prov_Device_LL_DoWork(PROV_DEVICE_LL_HANDLE handle)
+{
+    (void)handle;
+    if (g_complete_on_dowork && g_register_callback != NULL)
+    {
+        g_register_callback(PROV_DEVICE_RESULT_OK, TEST_IOTHUB_URI, TEST_REGISTRATION_ID, g_register_context);
+    }
+}
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+static TEST_MUTEX_HANDLE g_testByTest;
+
+BEGIN_TEST_SUITE(prov_device_ll_batch_ut)
+
+    TEST_SUITE_INITIALIZE(suite_init)
+    {
+        int result;
+
+        g_testByTest = TEST_MUTEX_CREATE();
+        ASSERT_IS_NOT_NULL(g_testByTest);
+
+        (void)umock_c_init(on_umock_c_error);
+
+        result = umocktypes_charptr_register_types();
+        ASSERT_ARE_EQUAL(int, 0, result);
+        result = umocktypes_stdint_register_types();
+        ASSERT_ARE_EQUAL(int, 0, result);
+
+        REGISTER_TYPE(PROV_DEVICE_RESULT, PROV_DEVICE_RESULT);
+        REGISTER_UMOCK_ALIAS_TYPE(PROV_DEVICE_LL_HANDLE, void*);
+        REGISTER_UMOCK_ALIAS_TYPE(PROV_DEVICE_TRANSPORT_PROVIDER_FUNCTION, void*);
+        REGISTER_UMOCK_ALIAS_TYPE(PROV_DEVICE_CLIENT_REGISTER_DEVICE_CALLBACK, void*);
+        REGISTER_UMOCK_ALIAS_TYPE(PROV_DEVICE_CLIENT_REGISTER_STATUS_CALLBACK, void*);
+
+        REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+        REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+        REGISTER_GLOBAL_MOCK_HOOK(mallocAndStrcpy_s, my_mallocAndStrcpy_s);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(mallocAndStrcpy_s, __LINE__);
+
+        REGISTER_GLOBAL_MOCK_RETURN(prov_dev_set_symmetric_key_info, 0);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(prov_dev_set_symmetric_key_info, __LINE__);
+        REGISTER_GLOBAL_MOCK_HOOK(Prov_Device_LL_Create, my_Prov_Device_LL_Create);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(Prov_Device_LL_Create, NULL);
+        REGISTER_GLOBAL_MOCK_HOOK(Prov_Device_LL_Destroy, my_Prov_Device_LL_Destroy);
+        REGISTER_GLOBAL_MOCK_HOOK(Prov_Device_LL_Register_Device, my_Prov_Device_LL_Register_Device);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(Prov_Device_LL_Register_Device, PROV_DEVICE_RESULT_ERROR);
+        REGISTER_GLOBAL_MOCK_HOOK(Prov_Device_LL_DoWork, my_Prov_Device_LL_DoWork);
+    }
+
+    TEST_SUITE_CLEANUP(suite_cleanup)
+    {
+        umock_c_deinit();
+
+        TEST_MUTEX_DESTROY(g_testByTest);
+    }
+
+    TEST_FUNCTION_INITIALIZE(method_init)
+    {
+        if (TEST_MUTEX_ACQUIRE(g_testByTest))
+        {
+            ASSERT_FAIL("Could not acquire test serialization mutex.");
+        }
+        umock_c_reset_all_calls();
+        g_register_callback = NULL;
+        g_register_context = NULL;
+        g_complete_on_dowork = false;
+    }
+
+    TEST_FUNCTION_CLEANUP(method_cleanup)
+    {
+        TEST_MUTEX_RELEASE(g_testByTest);
+    }
+
+    static void setup_start_registration_mocks(const char* registration_id)
+    {
+        STRICT_EXPECTED_CALL(prov_dev_set_symmetric_key_info(registration_id, TEST_SYMMETRIC_KEY));
+        STRICT_EXPECTED_CALL(Prov_Device_LL_Create(TEST_URI, TEST_SCOPE_ID, test_protocol));
+        STRICT_EXPECTED_CALL(Prov_Device_LL_Register_Device(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, NULL));
+    }
+
+    TEST_FUNCTION(Prov_Device_LL_Batch_Create_uri_NULL_fail)
+    {
+        //arrange
+
+        //act
+        PROV_DEVICE_LL_BATCH_HANDLE handle = Prov_Device_LL_Batch_Create(NULL, TEST_SCOPE_ID, test_protocol, 1);
+
+        //assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+    }
+
+    TEST_FUNCTION(Prov_Device_LL_Batch_Create_scope_id_NULL_fail)
+    {
+        //arrange
+
+        //act
+        PROV_DEVICE_LL_BATCH_HANDLE handle = Prov_Device_LL_Batch_Create(TEST_URI, NULL, test_protocol, 1);
+
+        //assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+    }
+
+    TEST_FUNCTION(Prov_Device_LL_Batch_Create_protocol_NULL_fail)
+    {
+        //arrange
+
+        //act
+        PROV_DEVICE_LL_BATCH_HANDLE handle = Prov_Device_LL_Batch_Create(TEST_URI, TEST_SCOPE_ID, NULL, 1);
+
+        //assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+    }
+
+    TEST_FUNCTION(Prov_Device_LL_Batch_Create_max_concurrent_zero_fail)
+    {
+        //arrange
+
+        //act
+        PROV_DEVICE_LL_BATCH_HANDLE handle = Prov_Device_LL_Batch_Create(TEST_URI, TEST_SCOPE_ID, test_protocol, 0);
+
+        //assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+    }
+
+    TEST_FUNCTION(Prov_Device_LL_Batch_Create_succeed)
+    {
+        //arrange
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_URI));
+        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_SCOPE_ID));
+
+        //act
+        PROV_DEVICE_LL_BATCH_HANDLE handle = Prov_Device_LL_Batch_Create(TEST_URI, TEST_SCOPE_ID, test_protocol, 1);
+
+        //assert
+        ASSERT_IS_NOT_NULL(handle);
+        ASSERT_ARE_EQUAL(size_t, 0, Prov_Device_LL_Batch_GetPendingCount(handle));
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        Prov_Device_LL_Batch_Destroy(handle);
+    }
+
+    TEST_FUNCTION(Prov_Device_LL_Batch_Create_fail)
+    {
+        //arrange
+        int negativeTestsInitResult = umock_c_negative_tests_init();
+        ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_URI));
+        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_SCOPE_ID));
+
+        umock_c_negative_tests_snapshot();
+
+        size_t count = umock_c_negative_tests_call_count();
+        for (size_t index = 0; index < count; index++)
+        {
+            umock_c_negative_tests_reset();
+            umock_c_negative_tests_fail_call(index);
+
+            char tmp_msg[64];
+            sprintf(tmp_msg, "Prov_Device_LL_Batch_Create failure in test %zu/%zu", index, count);
+
+            //act
+            PROV_DEVICE_LL_BATCH_HANDLE handle = Prov_Device_LL_Batch_Create(TEST_URI, TEST_SCOPE_ID, test_protocol, 1);
+
+            //assert
+            ASSERT_IS_NULL_WITH_MSG(handle, tmp_msg);
+        }
+
+        //cleanup
+        umock_c_negative_tests_deinit();
+    }
+
+    TEST_FUNCTION(Prov_Device_LL_Batch_Destroy_handle_NULL)
+    {
+        //arrange
+
+        //act
+        Prov_Device_LL_Batch_Destroy(NULL);
+
+        //assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+    }
+
+    TEST_FUNCTION(Prov_Device_LL_Batch_Destroy_drops_registrations_without_callbacks)
+    {
+        //arrange
+        PROV_DEVICE_LL_BATCH_HANDLE handle = Prov_Device_LL_Batch_Create(TEST_URI, TEST_SCOPE_ID, test_protocol, 1);
+        (void)Prov_Device_LL_Batch_Register_Device(handle, TEST_REGISTRATION_ID, TEST_SYMMETRIC_KEY, test_register_callback, TEST_USER_CONTEXT);
+        (void)Prov_Device_LL_Batch_Register_Device(handle, TEST_REGISTRATION_ID_2, TEST_SYMMETRIC_KEY, test_register_callback, TEST_USER_CONTEXT);
+        Prov_Device_LL_Batch_DoWork(handle);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(Prov_Device_LL_Destroy(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+        //act
+        Prov_Device_LL_Batch_Destroy(handle);
+
+        //assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+    }
+
+    TEST_FUNCTION(Prov_Device_LL_Batch_SetConfigureCallback_handle_NULL_fail)
+    {
+        //arrange
+
+        //act
+        PROV_DEVICE_RESULT result = Prov_Device_LL_Batch_SetConfigureCallback(NULL, test_configure_callback, TEST_CONFIGURE_CONTEXT);
+
+        //assert
+        ASSERT_ARE_EQUAL(PROV_DEVICE_RESULT, PROV_DEVICE_RESULT_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+    }
+
+    TEST_FUNCTION(Prov_Device_LL_Batch_Register_Device_handle_NULL_fail)
+    {
+        //arrange
+
+        //act
+        PROV_DEVICE_RESULT result = Prov_Device_LL_Batch_Register_Device(NULL, TEST_REGISTRATION_ID, TEST_SYMMETRIC_KEY, test_register_callback, TEST_USER_CONTEXT);
+
+        //assert
+        ASSERT_ARE_EQUAL(PROV_DEVICE_RESULT, PROV_DEVICE_RESULT_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+    }
+
+    TEST_FUNCTION(Prov_Device_LL_Batch_Register_Device_registration_id_NULL_fail)
+    {
+        //arrange
+        PROV_DEVICE_LL_BATCH_HANDLE handle = Prov_Device_LL_Batch_Create(TEST_URI, TEST_SCOPE_ID, test_protocol, 1);
+        umock_c_reset_all_calls();
+
+        //act
+        PROV_DEVICE_RESULT result = Prov_Device_LL_Batch_Register_Device(handle, NULL, TEST_SYMMETRIC_KEY, test_register_callback, TEST_USER_CONTEXT);
+
+        //assert
+        ASSERT_ARE_EQUAL(PROV_DEVICE_RESULT, PROV_DEVICE_RESULT_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        Prov_Device_LL_Batch_Destroy(handle);
+    }
+
+    TEST_FUNCTION(Prov_Device_LL_Batch_Register_Device_symmetric_key_NULL_fail)
+    {
+        //arrange
+        PROV_DEVICE_LL_BATCH_HANDLE handle = Prov_Device_LL_Batch_Create(TEST_URI, TEST_SCOPE_ID, test_protocol, 1);
+        umock_c_reset_all_calls();
+
+        //act
+        PROV_DEVICE_RESULT result = Prov_Device_LL_Batch_Register_Device(handle, TEST_REGISTRATION_ID, NULL, test_register_callback, TEST_USER_CONTEXT);
+
+        //assert
+        ASSERT_ARE_EQUAL(PROV_DEVICE_RESULT, PROV_DEVICE_RESULT_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        Prov_Device_LL_Batch_Destroy(handle);
+    }
+
+    TEST_FUNCTION(Prov_Device_LL_Batch_Register_Device_callback_NULL_fail)
+    {
+        //arrange
+        PROV_DEVICE_LL_BATCH_HANDLE handle = Prov_Device_LL_Batch_Create(TEST_URI, TEST_SCOPE_ID, test_protocol, 1);
+        umock_c_reset_all_calls();
+
+        //act
+        PROV_DEVICE_RESULT result = Prov_Device_LL_Batch_Register_Device(handle, TEST_REGISTRATION_ID, TEST_SYMMETRIC_KEY, NULL, TEST_USER_CONTEXT);
+
+        //assert
+        ASSERT_ARE_EQUAL(PROV_DEVICE_RESULT, PROV_DEVICE_RESULT_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        Prov_Device_LL_Batch_Destroy(handle);
+    }
+
+    TEST_FUNCTION(Prov_Device_LL_Batch_Register_Device_succeed)
+    {
+        //arrange
+        PROV_DEVICE_LL_BATCH_HANDLE handle = Prov_Device_LL_Batch_Create(TEST_URI, TEST_SCOPE_ID, test_protocol, 1);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+
+        //act
+        PROV_DEVICE_RESULT result = Prov_Device_LL_Batch_Register_Device(handle, TEST_REGISTRATION_ID, TEST_SYMMETRIC_KEY, test_register_callback, TEST_USER_CONTEXT);
+
+        //assert
+        ASSERT_ARE_EQUAL(PROV_DEVICE_RESULT, PROV_DEVICE_RESULT_OK, result);
+        ASSERT_ARE_EQUAL(size_t, 1, Prov_Device_LL_Batch_GetPendingCount(handle));
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        Prov_Device_LL_Batch_Destroy(handle);
+    }
+
+    TEST_FUNCTION(Prov_Device_LL_Batch_Register_Device_malloc_fail)
+    {
+        //arrange
+        PROV_DEVICE_LL_BATCH_HANDLE handle = Prov_Device_LL_Batch_Create(TEST_URI, TEST_SCOPE_ID, test_protocol, 1);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)).SetReturn(NULL);
+
+        //act
+        PROV_DEVICE_RESULT result = Prov_Device_LL_Batch_Register_Device(handle, TEST_REGISTRATION_ID, TEST_SYMMETRIC_KEY, test_register_callback, TEST_USER_CONTEXT);
+
+        //assert
+        ASSERT_ARE_EQUAL(PROV_DEVICE_RESULT, PROV_DEVICE_RESULT_MEMORY, result);
+        ASSERT_ARE_EQUAL(size_t, 0, Prov_Device_LL_Batch_GetPendingCount(handle));
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        Prov_Device_LL_Batch_Destroy(handle);
+    }
+
+    TEST_FUNCTION(Prov_Device_LL_Batch_DoWork_handle_NULL)
+    {
+        //arrange
+
+        //act
+        Prov_Device_LL_Batch_DoWork(NULL);
+
+        //assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+    }
+
+    TEST_FUNCTION(Prov_Device_LL_Batch_DoWork_starts_at_most_max_concurrent_registrations)
+    {
+        //arrange
+        PROV_DEVICE_LL_BATCH_HANDLE handle = Prov_Device_LL_Batch_Create(TEST_URI, TEST_SCOPE_ID, test_protocol, 2);
+        (void)Prov_Device_LL_Batch_Register_Device(handle, TEST_REGISTRATION_ID, TEST_SYMMETRIC_KEY, test_register_callback, TEST_USER_CONTEXT);
+        (void)Prov_Device_LL_Batch_Register_Device(handle, TEST_REGISTRATION_ID_2, TEST_SYMMETRIC_KEY, test_register_callback, TEST_USER_CONTEXT);
+        (void)Prov_Device_LL_Batch_Register_Device(handle, TEST_REGISTRATION_ID_3, TEST_SYMMETRIC_KEY, test_register_callback, TEST_USER_CONTEXT);
+        umock_c_reset_all_calls();
+
+        setup_start_registration_mocks(TEST_REGISTRATION_ID);
+        setup_start_registration_mocks(TEST_REGISTRATION_ID_2);
+        STRICT_EXPECTED_CALL(Prov_Device_LL_DoWork(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(Prov_Device_LL_DoWork(IGNORED_PTR_ARG));
+
+        //act
+        Prov_Device_LL_Batch_DoWork(handle);
+
+        //assert
+        ASSERT_ARE_EQUAL(size_t, 3, Prov_Device_LL_Batch_GetPendingCount(handle));
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        Prov_Device_LL_Batch_Destroy(handle);
+    }
+
+    TEST_FUNCTION(Prov_Device_LL_Batch_DoWork_calls_configure_callback)
+    {
+        //arrange
+        PROV_DEVICE_LL_BATCH_HANDLE handle = Prov_Device_LL_Batch_Create(TEST_URI, TEST_SCOPE_ID, test_protocol, 1);
+        (void)Prov_Device_LL_Batch_SetConfigureCallback(handle, test_configure_callback, TEST_CONFIGURE_CONTEXT);
+        (void)Prov_Device_LL_Batch_Register_Device(handle, TEST_REGISTRATION_ID, TEST_SYMMETRIC_KEY, test_register_callback, TEST_USER_CONTEXT);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(prov_dev_set_symmetric_key_info(TEST_REGISTRATION_ID, TEST_SYMMETRIC_KEY));
+        STRICT_EXPECTED_CALL(Prov_Device_LL_Create(TEST_URI, TEST_SCOPE_ID, test_protocol));
+        STRICT_EXPECTED_CALL(test_configure_callback(IGNORED_PTR_ARG, TEST_REGISTRATION_ID, TEST_CONFIGURE_CONTEXT));
+        STRICT_EXPECTED_CALL(Prov_Device_LL_Register_Device(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, NULL));
+        STRICT_EXPECTED_CALL(Prov_Device_LL_DoWork(IGNORED_PTR_ARG));
+
+        //act
+        Prov_Device_LL_Batch_DoWork(handle);
+
+        //assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        Prov_Device_LL_Batch_Destroy(handle);
+    }
+
+    TEST_FUNCTION(Prov_Device_LL_Batch_DoWork_completed_registration_releases_its_handle)
+    {
+        //arrange
+        PROV_DEVICE_LL_BATCH_HANDLE handle = Prov_Device_LL_Batch_Create(TEST_URI, TEST_SCOPE_ID, test_protocol, 1);
+        (void)Prov_Device_LL_Batch_Register_Device(handle, TEST_REGISTRATION_ID, TEST_SYMMETRIC_KEY, test_register_callback, TEST_USER_CONTEXT);
+        (void)Prov_Device_LL_Batch_Register_Device(handle, TEST_REGISTRATION_ID_2, TEST_SYMMETRIC_KEY, test_register_callback, TEST_USER_CONTEXT);
+        Prov_Device_LL_Batch_DoWork(handle);
+        umock_c_reset_all_calls();
+        g_complete_on_dowork = true;
+
+        STRICT_EXPECTED_CALL(Prov_Device_LL_DoWork(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(test_register_callback(PROV_DEVICE_RESULT_OK, TEST_IOTHUB_URI, TEST_REGISTRATION_ID, TEST_USER_CONTEXT));
+        STRICT_EXPECTED_CALL(Prov_Device_LL_Destroy(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+        //act
+        Prov_Device_LL_Batch_DoWork(handle);
+
+        //assert
+        ASSERT_ARE_EQUAL(size_t, 1, Prov_Device_LL_Batch_GetPendingCount(handle));
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        Prov_Device_LL_Batch_Destroy(handle);
+    }
+
+    TEST_FUNCTION(Prov_Device_LL_Batch_DoWork_starts_queued_registration_once_one_completes)
+    {
+        //arrange
+        PROV_DEVICE_LL_BATCH_HANDLE handle = Prov_Device_LL_Batch_Create(TEST_URI, TEST_SCOPE_ID, test_protocol, 1);
+        (void)Prov_Device_LL_Batch_Register_Device(handle, TEST_REGISTRATION_ID, TEST_SYMMETRIC_KEY, test_register_callback, TEST_USER_CONTEXT);
+        (void)Prov_Device_LL_Batch_Register_Device(handle, TEST_REGISTRATION_ID_2, TEST_SYMMETRIC_KEY, test_register_callback, TEST_USER_CONTEXT);
+        Prov_Device_LL_Batch_DoWork(handle);
+        g_complete_on_dowork = true;
+        Prov_Device_LL_Batch_DoWork(handle);
+        g_complete_on_dowork = false;
+        umock_c_reset_all_calls();
+
+        setup_start_registration_mocks(TEST_REGISTRATION_ID_2);
+        STRICT_EXPECTED_CALL(Prov_Device_LL_DoWork(IGNORED_PTR_ARG));
+
+        //act
+        Prov_Device_LL_Batch_DoWork(handle);
+
+        //assert
+        ASSERT_ARE_EQUAL(size_t, 1, Prov_Device_LL_Batch_GetPendingCount(handle));
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        Prov_Device_LL_Batch_Destroy(handle);
+    }
+
+    TEST_FUNCTION(Prov_Device_LL_Batch_DoWork_start_fail_reports_error)
+    {
+        //arrange
+        PROV_DEVICE_LL_BATCH_HANDLE handle = Prov_Device_LL_Batch_Create(TEST_URI, TEST_SCOPE_ID, test_protocol, 1);
+        (void)Prov_Device_LL_Batch_Register_Device(handle, TEST_REGISTRATION_ID, TEST_SYMMETRIC_KEY, test_register_callback, TEST_USER_CONTEXT);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(prov_dev_set_symmetric_key_info(TEST_REGISTRATION_ID, TEST_SYMMETRIC_KEY));
+        STRICT_EXPECTED_CALL(Prov_Device_LL_Create(TEST_URI, TEST_SCOPE_ID, test_protocol)).SetReturn(NULL);
+        STRICT_EXPECTED_CALL(test_register_callback(PROV_DEVICE_RESULT_ERROR, NULL, NULL, TEST_USER_CONTEXT));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+        //act
+        Prov_Device_LL_Batch_DoWork(handle);
+
+        //assert
+        ASSERT_ARE_EQUAL(size_t, 0, Prov_Device_LL_Batch_GetPendingCount(handle));
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        Prov_Device_LL_Batch_Destroy(handle);
+    }
+
+    TEST_FUNCTION(Prov_Device_LL_Batch_DoWork_register_fail_releases_handle)
+    {
+        //arrange
+        PROV_DEVICE_LL_BATCH_HANDLE handle = Prov_Device_LL_Batch_Create(TEST_URI, TEST_SCOPE_ID, test_protocol, 1);
+        (void)Prov_Device_LL_Batch_Register_Device(handle, TEST_REGISTRATION_ID, TEST_SYMMETRIC_KEY, test_register_callback, TEST_USER_CONTEXT);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(prov_dev_set_symmetric_key_info(TEST_REGISTRATION_ID, TEST_SYMMETRIC_KEY));
+        STRICT_EXPECTED_CALL(Prov_Device_LL_Create(TEST_URI, TEST_SCOPE_ID, test_protocol));
+        STRICT_EXPECTED_CALL(Prov_Device_LL_Register_Device(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, NULL)).SetReturn(PROV_DEVICE_RESULT_ERROR);
+        STRICT_EXPECTED_CALL(test_register_callback(PROV_DEVICE_RESULT_ERROR, NULL, NULL, TEST_USER_CONTEXT));
+        STRICT_EXPECTED_CALL(Prov_Device_LL_Destroy(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+        //act
+        Prov_Device_LL_Batch_DoWork(handle);
+
+        //assert
+        ASSERT_ARE_EQUAL(size_t, 0, Prov_Device_LL_Batch_GetPendingCount(handle));
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        Prov_Device_LL_Batch_Destroy(handle);
+    }
+
+    TEST_FUNCTION(Prov_Device_LL_Batch_GetPendingCount_handle_NULL)
+    {
+        //arrange
+
+        //act
+        size_t result = Prov_Device_LL_Batch_GetPendingCount(NULL);
+
+        //assert
+        ASSERT_ARE_EQUAL(size_t, 0, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+    }
+
+END_TEST_SUITE(prov_device_ll_batch_ut)
@@ -0,0 +1,525 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstdint>
+#include <cstddef>
+#else
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#endif
+
+#if defined _MSC_VER
+#pragma warning(disable: 4054) /* MSC incorrectly fires this */
+#endif
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+#include "umock_c_negative_tests.h"
+#include "azure_c_shared_utility/macro_utils.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/umock_c_prod.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+#include "azure_c_shared_utility/threadapi.h"
+
+MOCKABLE_FUNCTION(, int, test_hsm_job, void*, job_context);
+MOCKABLE_FUNCTION(, void, test_on_job_complete, int, job_result, void*, user_context);
+#undef ENABLE_MOCKS
+
+#include "azure_prov_client/internal/prov_hsm_job_queue.h"
+
+#define TEST_JOB_CONTEXT        (void*)0x11111111
+#define TEST_USER_CONTEXT       (void*)0x11111112
+#define TEST_JOB_CONTEXT_2      (void*)0x11111113
+#define TEST_USER_CONTEXT_2     (void*)0x11111114
+#define TEST_JOB_RESULT         0
+#define TEST_JOB_RESULT_2       42
+
+static THREAD_START_FUNC g_worker_func;
+static void* g_worker_arg;
+
+static LOCK_HANDLE my_Lock_Init(void)
+{
+    return (LOCK_HANDLE)my_gballoc_malloc(1);
+}
+
+static LOCK_RESULT my_Lock_Deinit(LOCK_HANDLE handle)
+{
+    my_gballoc_free(handle);
+    return LOCK_OK;
+}
+
+static COND_HANDLE my_Condition_Init(void)
+{
+    return (COND_HANDLE)my_gballoc_malloc(1);
+}
+
+static void my_Condition_Deinit(COND_HANDLE handle)
+{
+    my_gballoc_free(handle);
+}
+
+static THREADAPI_RESULT my_ThreadAPI_Create(THREAD_HANDLE* threadHandle, THREAD_START_FUNC func, void* arg)
+{
+    *threadHandle = (THREAD_HANDLE)0x4242;
+    g_worker_func = func;
+    g_worker_arg = arg;
+    return THREADAPI_OK;
+}
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+static TEST_MUTEX_HANDLE g_testByTest;
+
+BEGIN_TEST_SUITE(prov_hsm_job_queue_ut)
+
+    TEST_SUITE_INITIALIZE(suite_init)
+    {
+        int result;
+
+        g_testByTest = TEST_MUTEX_CREATE();
+        ASSERT_IS_NOT_NULL(g_testByTest);
+
+        (void)umock_c_init(on_umock_c_error);
+
+        result = umocktypes_charptr_register_types();
+        ASSERT_ARE_EQUAL(int, 0, result);
+        result = umocktypes_stdint_register_types();
+        ASSERT_ARE_EQUAL(int, 0, result);
+
+        REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+        REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+        REGISTER_UMOCK_ALIAS_TYPE(COND_HANDLE, void*);
+        REGISTER_UMOCK_ALIAS_TYPE(COND_RESULT, int);
+        REGISTER_UMOCK_ALIAS_TYPE(THREAD_HANDLE, void*);
+        REGISTER_UMOCK_ALIAS_TYPE(THREAD_START_FUNC, void*);
+        REGISTER_UMOCK_ALIAS_TYPE(THREADAPI_RESULT, int);
+
+        REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+        REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+        REGISTER_GLOBAL_MOCK_HOOK(Lock_Init, my_Lock_Init);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock_Init, NULL);
+        REGISTER_GLOBAL_MOCK_HOOK(Lock_Deinit, my_Lock_Deinit);
+        REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock, LOCK_ERROR);
+        REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(Unlock, LOCK_ERROR);
+
+        REGISTER_GLOBAL_MOCK_HOOK(Condition_Init, my_Condition_Init);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(Condition_Init, NULL);
+        REGISTER_GLOBAL_MOCK_HOOK(Condition_Deinit, my_Condition_Deinit);
+        REGISTER_GLOBAL_MOCK_RETURN(Condition_Post, COND_OK);
+        REGISTER_GLOBAL_MOCK_RETURN(Condition_Wait, COND_OK);
+
+        REGISTER_GLOBAL_MOCK_HOOK(ThreadAPI_Create, my_ThreadAPI_Create);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(ThreadAPI_Create, THREADAPI_ERROR);
+        REGISTER_GLOBAL_MOCK_RETURN(ThreadAPI_Join, THREADAPI_OK);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(ThreadAPI_Join, THREADAPI_ERROR);
+    }
+
+    TEST_SUITE_CLEANUP(suite_cleanup)
+    {
+        umock_c_deinit();
+
+        TEST_MUTEX_DESTROY(g_testByTest);
+    }
+
+    TEST_FUNCTION_INITIALIZE(method_init)
+    {
+        if (TEST_MUTEX_ACQUIRE(g_testByTest))
+        {
+            ASSERT_FAIL("Could not acquire test serialization mutex.");
+        }
+        umock_c_reset_all_calls();
+        g_worker_func = NULL;
+        g_worker_arg = NULL;
+    }
+
+    TEST_FUNCTION_CLEANUP(method_cleanup)
+    {
+        TEST_MUTEX_RELEASE(g_testByTest);
+    }
+
+    static int should_skip_index(size_t current_index, const size_t skip_array[], size_t length)
+    {
+        int result = 0;
+        for (size_t index = 0; index < length; index++)
+        {
+            if (current_index == skip_array[index])
+            {
+                result = __LINE__;
+                break;
+            }
+        }
+        return result;
+    }
+
+    static void setup_prov_hsm_job_queue_create_mocks(void)
+    {
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+        STRICT_EXPECTED_CALL(Lock_Init());
+        STRICT_EXPECTED_CALL(Condition_Init());
+        STRICT_EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    }
+
+    static void setup_prov_hsm_job_queue_destroy_mocks(void)
+    {
+        STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(Condition_Post(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(Condition_Deinit(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    }
+
+    TEST_FUNCTION(prov_hsm_job_queue_create_succeed)
+    {
+        //arrange
+        setup_prov_hsm_job_queue_create_mocks();
+
+        //act
+        PROV_HSM_JOB_QUEUE_HANDLE handle = prov_hsm_job_queue_create();
+
+        //assert
+        ASSERT_IS_NOT_NULL(handle);
+        ASSERT_IS_NOT_NULL(g_worker_func);
+        ASSERT_ARE_EQUAL(void_ptr, handle, g_worker_arg);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        prov_hsm_job_queue_destroy(handle);
+    }
+
+    TEST_FUNCTION(prov_hsm_job_queue_create_fail)
+    {
+        //arrange
+        int negativeTestsInitResult = umock_c_negative_tests_init();
+        ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+        setup_prov_hsm_job_queue_create_mocks();
+
+        umock_c_negative_tests_snapshot();
+
+        size_t count = umock_c_negative_tests_call_count();
+        for (size_t index = 0; index < count; index++)
+        {
+            umock_c_negative_tests_reset();
+            umock_c_negative_tests_fail_call(index);
+
+            char tmp_msg[64];
+            sprintf(tmp_msg, "prov_hsm_job_queue_create failure in test %zu/%zu", index, count);
+
+            //act
+            PROV_HSM_JOB_QUEUE_HANDLE handle = prov_hsm_job_queue_create();
+
+            //assert
+            ASSERT_IS_NULL_WITH_MSG(handle, tmp_msg);
+        }
+
+        //cleanup
+        umock_c_negative_tests_deinit();
+    }
+
+    TEST_FUNCTION(prov_hsm_job_queue_destroy_handle_NULL)
+    {
+        //arrange
+
+        //act
+        prov_hsm_job_queue_destroy(NULL);
+
+        //assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+    }
+
+    TEST_FUNCTION(prov_hsm_job_queue_destroy_succeed)
+    {
+        //arrange
+        PROV_HSM_JOB_QUEUE_HANDLE handle = prov_hsm_job_queue_create();
+        umock_c_reset_all_calls();
+
+        setup_prov_hsm_job_queue_destroy_mocks();
+
+        //act
+        prov_hsm_job_queue_destroy(handle);
+
+        //assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+    }
+
+    TEST_FUNCTION(prov_hsm_job_queue_destroy_lock_fail_still_joins)
+    {
+        //arrange
+        PROV_HSM_JOB_QUEUE_HANDLE handle = prov_hsm_job_queue_create();
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).SetReturn(LOCK_ERROR);
+        STRICT_EXPECTED_CALL(Condition_Post(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(Condition_Deinit(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+        //act
+        prov_hsm_job_queue_destroy(handle);
+
+        //assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+    }
+
+    TEST_FUNCTION(prov_hsm_job_queue_destroy_frees_pending_jobs_succeed)
+    {
+        //arrange
+        PROV_HSM_JOB_QUEUE_HANDLE handle = prov_hsm_job_queue_create();
+        (void)prov_hsm_job_queue_submit(handle, test_hsm_job, TEST_JOB_CONTEXT, test_on_job_complete, TEST_USER_CONTEXT);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(Condition_Post(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(Condition_Deinit(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+        //act
+        prov_hsm_job_queue_destroy(handle);
+
+        //assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+    }
+
+    TEST_FUNCTION(prov_hsm_job_queue_submit_handle_NULL_fail)
+    {
+        //arrange
+
+        //act
+        int result = prov_hsm_job_queue_submit(NULL, test_hsm_job, TEST_JOB_CONTEXT, test_on_job_complete, TEST_USER_CONTEXT);
+
+        //assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+    }
+
+    TEST_FUNCTION(prov_hsm_job_queue_submit_job_NULL_fail)
+    {
+        //arrange
+        PROV_HSM_JOB_QUEUE_HANDLE handle = prov_hsm_job_queue_create();
+        umock_c_reset_all_calls();
+
+        //act
+        int result = prov_hsm_job_queue_submit(handle, NULL, TEST_JOB_CONTEXT, test_on_job_complete, TEST_USER_CONTEXT);
+
+        //assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        prov_hsm_job_queue_destroy(handle);
+    }
+
+    TEST_FUNCTION(prov_hsm_job_queue_submit_on_complete_NULL_fail)
+    {
+        //arrange
+        PROV_HSM_JOB_QUEUE_HANDLE handle = prov_hsm_job_queue_create();
+        umock_c_reset_all_calls();
+
+        //act
+        int result = prov_hsm_job_queue_submit(handle, test_hsm_job, TEST_JOB_CONTEXT, NULL, TEST_USER_CONTEXT);
+
+        //assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        prov_hsm_job_queue_destroy(handle);
+    }
+
+    TEST_FUNCTION(prov_hsm_job_queue_submit_succeed)
+    {
+        //arrange
+        PROV_HSM_JOB_QUEUE_HANDLE handle = prov_hsm_job_queue_create();
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+        STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(Condition_Post(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+        //act
+        int result = prov_hsm_job_queue_submit(handle, test_hsm_job, TEST_JOB_CONTEXT, test_on_job_complete, TEST_USER_CONTEXT);
+
+        //assert
+        ASSERT_ARE_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        prov_hsm_job_queue_destroy(handle);
+    }
+
+    TEST_FUNCTION(prov_hsm_job_queue_submit_fail)
+    {
+        //arrange
+        PROV_HSM_JOB_QUEUE_HANDLE handle = prov_hsm_job_queue_create();
+        umock_c_reset_all_calls();
+
+        int negativeTestsInitResult = umock_c_negative_tests_init();
+        ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+        STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(Condition_Post(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+        umock_c_negative_tests_snapshot();
+
+        size_t calls_cannot_fail[] = { 2, 3 };
+
+        size_t count = umock_c_negative_tests_call_count();
+        for (size_t index = 0; index < count; index++)
+        {
+            if (should_skip_index(index, calls_cannot_fail, sizeof(calls_cannot_fail) / sizeof(calls_cannot_fail[0])) != 0)
+            {
+                continue;
+            }
+
+            umock_c_negative_tests_reset();
+            umock_c_negative_tests_fail_call(index);
+
+            char tmp_msg[64];
+            sprintf(tmp_msg, "prov_hsm_job_queue_submit failure in test %zu/%zu", index, count);
+
+            //act
+            int result = prov_hsm_job_queue_submit(handle, test_hsm_job, TEST_JOB_CONTEXT, test_on_job_complete, TEST_USER_CONTEXT);
+
+            //assert
+            ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, result, tmp_msg);
+        }
+
+        //cleanup
+        umock_c_negative_tests_deinit();
+        prov_hsm_job_queue_destroy(handle);
+    }
+
+    TEST_FUNCTION(prov_hsm_job_queue_worker_runs_jobs_in_order_succeed)
+    {
+        //arrange
+        PROV_HSM_JOB_QUEUE_HANDLE handle = prov_hsm_job_queue_create();
+        (void)prov_hsm_job_queue_submit(handle, test_hsm_job, TEST_JOB_CONTEXT, test_on_job_complete, TEST_USER_CONTEXT);
+        (void)prov_hsm_job_queue_submit(handle, test_hsm_job, TEST_JOB_CONTEXT_2, test_on_job_complete, TEST_USER_CONTEXT_2);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(test_hsm_job(TEST_JOB_CONTEXT)).SetReturn(TEST_JOB_RESULT);
+        STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(test_hsm_job(TEST_JOB_CONTEXT_2)).SetReturn(TEST_JOB_RESULT_2);
+        STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).SetReturn(LOCK_ERROR);
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+        STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(test_on_job_complete(TEST_JOB_RESULT, TEST_USER_CONTEXT));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+        //act
+        (void)g_worker_func(g_worker_arg);
+        prov_hsm_job_queue_dowork(handle);
+
+        //assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        prov_hsm_job_queue_destroy(handle);
+    }
+
+    TEST_FUNCTION(prov_hsm_job_queue_dowork_handle_NULL)
+    {
+        //arrange
+
+        //act
+        prov_hsm_job_queue_dowork(NULL);
+
+        //assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+    }
+
+    TEST_FUNCTION(prov_hsm_job_queue_dowork_no_completed_jobs_succeed)
+    {
+        //arrange
+        PROV_HSM_JOB_QUEUE_HANDLE handle = prov_hsm_job_queue_create();
+        (void)prov_hsm_job_queue_submit(handle, test_hsm_job, TEST_JOB_CONTEXT, test_on_job_complete, TEST_USER_CONTEXT);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+        //act
+        prov_hsm_job_queue_dowork(handle);
+
+        //assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        prov_hsm_job_queue_destroy(handle);
+    }
+
+    TEST_FUNCTION(prov_hsm_job_queue_dowork_lock_fail)
+    {
+        //arrange
+        PROV_HSM_JOB_QUEUE_HANDLE handle = prov_hsm_job_queue_create();
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).SetReturn(LOCK_ERROR);
+
+        //act
+        prov_hsm_job_queue_dowork(handle);
+
+        //assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        prov_hsm_job_queue_destroy(handle);
+    }
+
+    END_TEST_SUITE(prov_hsm_job_queue_ut)
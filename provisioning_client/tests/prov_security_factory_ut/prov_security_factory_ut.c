@@ -38,6 +38,7 @@ MOCKABLE_FUNCTION(, void, deinitialize_hsm_system);
 #define DPS_SECURITY_FACTORY_H
 #include "azure_prov_client/iothub_security_factory.h"
 #undef DPS_SECURITY_FACTORY_H
+#include "azure_prov_client/internal/iothub_auth_client.h"
 
 #undef ENABLE_MOCKS
 
@@ -211,6 +212,7 @@ TEST_FUNCTION(prov_dev_security_deinit_tpm_success)
     umock_c_reset_all_calls();
 
     //arrange
+    STRICT_EXPECTED_CALL(iothub_device_auth_clear_handoff());
     STRICT_EXPECTED_CALL(deinitialize_hsm_system());
     STRICT_EXPECTED_CALL(iothub_security_get_symmetric_key()).SetReturn(TEST_SYMM_KEY);
     STRICT_EXPECTED_CALL(iothub_security_deinit());
@@ -298,6 +300,7 @@ TEST_FUNCTION(prov_dev_security_deinit_x509_success)
     umock_c_reset_all_calls();
 
     //arrange
+    STRICT_EXPECTED_CALL(iothub_device_auth_clear_handoff());
     STRICT_EXPECTED_CALL(deinitialize_hsm_system());
     STRICT_EXPECTED_CALL(iothub_security_get_symmetric_key()).SetReturn(NULL);
     STRICT_EXPECTED_CALL(iothub_security_get_symm_registration_name()).SetReturn(NULL);
@@ -523,6 +526,7 @@ TEST_FUNCTION(prov_dev_security_deinit_http_edge_success)
     umock_c_reset_all_calls();
 
     //arrange
+    STRICT_EXPECTED_CALL(iothub_device_auth_clear_handoff());
     STRICT_EXPECTED_CALL(deinitialize_hsm_system());
     STRICT_EXPECTED_CALL(iothub_security_get_symmetric_key()).SetReturn(NULL);
     STRICT_EXPECTED_CALL(iothub_security_get_symm_registration_name()).SetReturn(NULL);
@@ -0,0 +1,514 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstdint>
+#include <cstddef>
+#else
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#endif
+
+#if defined _MSC_VER
+#pragma warning(disable: 4054) /* MSC incorrectly fires this */
+#endif
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+#include "umock_c_negative_tests.h"
+#include "azure_c_shared_utility/macro_utils.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/umock_c_prod.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/crt_abstractions.h"
+#include "azure_c_shared_utility/xio.h"
+#include "azure_c_shared_utility/optionhandler.h"
+#undef ENABLE_MOCKS
+
+#include "azure_prov_client/prov_tls_session_cache.h"
+
+#define TEST_XIO_HANDLE         (XIO_HANDLE)0x11111111
+
+static const char* TEST_HOSTNAME = "global.azure-devices-provisioning.net";
+static const char* TEST_OTHER_HOSTNAME = "other.azure-devices-provisioning.net";
+static const char* TEST_SESSION_RESUMPTION_OPTION = "tls_session_resumption";
+
+static LOCK_HANDLE my_Lock_Init(void)
+{
+    return (LOCK_HANDLE)my_gballoc_malloc(1);
+}
+
+static LOCK_RESULT my_Lock_Deinit(LOCK_HANDLE handle)
+{
+    my_gballoc_free(handle);
+    return LOCK_OK;
+}
+
+static int my_mallocAndStrcpy_s(char** destination, const char* source)
+{
+    size_t src_len = strlen(source);
+    *destination = (char*)my_gballoc_malloc(src_len + 1);
+    strcpy(*destination, source);
+    return 0;
+}
+
+static OPTIONHANDLER_HANDLE my_xio_retrieveoptions(XIO_HANDLE xio)
+{
+    (void)xio;
+    return (OPTIONHANDLER_HANDLE)my_gballoc_malloc(1);
+}
+
+static void my_OptionHandler_Destroy(OPTIONHANDLER_HANDLE handle)
+{
+    my_gballoc_free(handle);
+}
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+static TEST_MUTEX_HANDLE g_testByTest;
+
+BEGIN_TEST_SUITE(prov_tls_session_cache_ut)
+
+    TEST_SUITE_INITIALIZE(suite_init)
+    {
+        int result;
+
+        g_testByTest = TEST_MUTEX_CREATE();
+        ASSERT_IS_NOT_NULL(g_testByTest);
+
+        (void)umock_c_init(on_umock_c_error);
+
+        result = umocktypes_charptr_register_types();
+        ASSERT_ARE_EQUAL(int, 0, result);
+        result = umocktypes_stdint_register_types();
+        ASSERT_ARE_EQUAL(int, 0, result);
+
+        REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+        REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+        REGISTER_UMOCK_ALIAS_TYPE(XIO_HANDLE, void*);
+        REGISTER_UMOCK_ALIAS_TYPE(OPTIONHANDLER_HANDLE, void*);
+        REGISTER_UMOCK_ALIAS_TYPE(OPTIONHANDLER_RESULT, int);
+
+        REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+        REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+        REGISTER_GLOBAL_MOCK_HOOK(Lock_Init, my_Lock_Init);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock_Init, NULL);
+        REGISTER_GLOBAL_MOCK_HOOK(Lock_Deinit, my_Lock_Deinit);
+        REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock, LOCK_ERROR);
+        REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(Unlock, LOCK_ERROR);
+
+        REGISTER_GLOBAL_MOCK_HOOK(mallocAndStrcpy_s, my_mallocAndStrcpy_s);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(mallocAndStrcpy_s, __LINE__);
+
+        REGISTER_GLOBAL_MOCK_RETURN(xio_setoption, 0);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(xio_setoption, __LINE__);
+        REGISTER_GLOBAL_MOCK_HOOK(xio_retrieveoptions, my_xio_retrieveoptions);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(xio_retrieveoptions, NULL);
+        REGISTER_GLOBAL_MOCK_RETURN(OptionHandler_FeedOptions, OPTIONHANDLER_OK);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(OptionHandler_FeedOptions, OPTIONHANDLER_ERROR);
+        REGISTER_GLOBAL_MOCK_HOOK(OptionHandler_Destroy, my_OptionHandler_Destroy);
+    }
+
+    TEST_SUITE_CLEANUP(suite_cleanup)
+    {
+        umock_c_deinit();
+
+        TEST_MUTEX_DESTROY(g_testByTest);
+    }
+
+    TEST_FUNCTION_INITIALIZE(method_init)
+    {
+        if (TEST_MUTEX_ACQUIRE(g_testByTest))
+        {
+            ASSERT_FAIL("Could not acquire test serialization mutex.");
+        }
+        umock_c_reset_all_calls();
+    }
+
+    TEST_FUNCTION_CLEANUP(method_cleanup)
+    {
+        TEST_MUTEX_RELEASE(g_testByTest);
+    }
+
+    static int should_skip_index(size_t current_index, const size_t skip_array[], size_t length)
+    {
+        int result = 0;
+        for (size_t index = 0; index < length; index++)
+        {
+            if (current_index == skip_array[index])
+            {
+                result = __LINE__;
+                break;
+            }
+        }
+        return result;
+    }
+
+    static void setup_prov_tls_session_cache_store_mocks(const char* hostname)
+    {
+        STRICT_EXPECTED_CALL(xio_retrieveoptions(TEST_XIO_HANDLE));
+        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, hostname));
+        STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+    }
+
+    TEST_FUNCTION(prov_tls_session_cache_create_succeed)
+    {
+        //arrange
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+        STRICT_EXPECTED_CALL(Lock_Init());
+
+        //act
+        PROV_TLS_SESSION_CACHE_HANDLE handle = prov_tls_session_cache_create();
+
+        //assert
+        ASSERT_IS_NOT_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        prov_tls_session_cache_destroy(handle);
+    }
+
+    TEST_FUNCTION(prov_tls_session_cache_create_fail)
+    {
+        //arrange
+        int negativeTestsInitResult = umock_c_negative_tests_init();
+        ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+        STRICT_EXPECTED_CALL(Lock_Init());
+
+        umock_c_negative_tests_snapshot();
+
+        //act
+        size_t count = umock_c_negative_tests_call_count();
+        for (size_t index = 0; index < count; index++)
+        {
+            umock_c_negative_tests_reset();
+            umock_c_negative_tests_fail_call(index);
+
+            char tmp_msg[64];
+            sprintf(tmp_msg, "prov_tls_session_cache_create failure in test %zu/%zu", index, count);
+
+            PROV_TLS_SESSION_CACHE_HANDLE handle = prov_tls_session_cache_create();
+
+            //assert
+            ASSERT_IS_NULL(handle, tmp_msg);
+        }
+
+        //cleanup
+        umock_c_negative_tests_deinit();
+    }
+
+    TEST_FUNCTION(prov_tls_session_cache_destroy_handle_NULL_succeed)
+    {
+        //arrange
+
+        //act
+        prov_tls_session_cache_destroy(NULL);
+
+        //assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+    }
+
+    TEST_FUNCTION(prov_tls_session_cache_destroy_saved_options_succeed)
+    {
+        //arrange
+        PROV_TLS_SESSION_CACHE_HANDLE handle = prov_tls_session_cache_create();
+        (void)prov_tls_session_cache_store(handle, TEST_HOSTNAME, TEST_XIO_HANDLE);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(OptionHandler_Destroy(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+        //act
+        prov_tls_session_cache_destroy(handle);
+
+        //assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+    }
+
+    TEST_FUNCTION(prov_tls_session_cache_apply_handle_NULL_fail)
+    {
+        //arrange
+
+        //act
+        int result = prov_tls_session_cache_apply(NULL, TEST_HOSTNAME, TEST_XIO_HANDLE);
+
+        //assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+    }
+
+    TEST_FUNCTION(prov_tls_session_cache_apply_tls_io_NULL_fail)
+    {
+        //arrange
+        PROV_TLS_SESSION_CACHE_HANDLE handle = prov_tls_session_cache_create();
+        umock_c_reset_all_calls();
+
+        //act
+        int result = prov_tls_session_cache_apply(handle, TEST_HOSTNAME, NULL);
+
+        //assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        prov_tls_session_cache_destroy(handle);
+    }
+
+    TEST_FUNCTION(prov_tls_session_cache_apply_nothing_saved_asks_resumption)
+    {
+        //arrange
+        PROV_TLS_SESSION_CACHE_HANDLE handle = prov_tls_session_cache_create();
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(xio_setoption(TEST_XIO_HANDLE, TEST_SESSION_RESUMPTION_OPTION, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+        //act
+        int result = prov_tls_session_cache_apply(handle, TEST_HOSTNAME, TEST_XIO_HANDLE);
+
+        //assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        prov_tls_session_cache_destroy(handle);
+    }
+
+    TEST_FUNCTION(prov_tls_session_cache_apply_feeds_saved_options_succeed)
+    {
+        //arrange
+        PROV_TLS_SESSION_CACHE_HANDLE handle = prov_tls_session_cache_create();
+        (void)prov_tls_session_cache_store(handle, TEST_HOSTNAME, TEST_XIO_HANDLE);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(xio_setoption(TEST_XIO_HANDLE, TEST_SESSION_RESUMPTION_OPTION, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(OptionHandler_FeedOptions(IGNORED_PTR_ARG, TEST_XIO_HANDLE));
+        STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+        //act
+        int result = prov_tls_session_cache_apply(handle, TEST_HOSTNAME, TEST_XIO_HANDLE);
+
+        //assert
+        ASSERT_ARE_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        prov_tls_session_cache_destroy(handle);
+    }
+
+    TEST_FUNCTION(prov_tls_session_cache_apply_resumption_unsupported_feeds_saved_options_succeed)
+    {
+        //arrange
+        PROV_TLS_SESSION_CACHE_HANDLE handle = prov_tls_session_cache_create();
+        (void)prov_tls_session_cache_store(handle, TEST_HOSTNAME, TEST_XIO_HANDLE);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(xio_setoption(TEST_XIO_HANDLE, TEST_SESSION_RESUMPTION_OPTION, IGNORED_PTR_ARG)).SetReturn(__LINE__);
+        STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(OptionHandler_FeedOptions(IGNORED_PTR_ARG, TEST_XIO_HANDLE));
+        STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+        //act
+        int result = prov_tls_session_cache_apply(handle, TEST_HOSTNAME, TEST_XIO_HANDLE);
+
+        //assert
+        ASSERT_ARE_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        prov_tls_session_cache_destroy(handle);
+    }
+
+    TEST_FUNCTION(prov_tls_session_cache_apply_other_hostname_fail)
+    {
+        //arrange
+        PROV_TLS_SESSION_CACHE_HANDLE handle = prov_tls_session_cache_create();
+        (void)prov_tls_session_cache_store(handle, TEST_HOSTNAME, TEST_XIO_HANDLE);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(xio_setoption(TEST_XIO_HANDLE, TEST_SESSION_RESUMPTION_OPTION, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+        //act
+        int result = prov_tls_session_cache_apply(handle, TEST_OTHER_HOSTNAME, TEST_XIO_HANDLE);
+
+        //assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        prov_tls_session_cache_destroy(handle);
+    }
+
+    TEST_FUNCTION(prov_tls_session_cache_apply_feed_fail)
+    {
+        //arrange
+        PROV_TLS_SESSION_CACHE_HANDLE handle = prov_tls_session_cache_create();
+        (void)prov_tls_session_cache_store(handle, TEST_HOSTNAME, TEST_XIO_HANDLE);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(xio_setoption(TEST_XIO_HANDLE, TEST_SESSION_RESUMPTION_OPTION, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(OptionHandler_FeedOptions(IGNORED_PTR_ARG, TEST_XIO_HANDLE)).SetReturn(OPTIONHANDLER_ERROR);
+        STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+        //act
+        int result = prov_tls_session_cache_apply(handle, TEST_HOSTNAME, TEST_XIO_HANDLE);
+
+        //assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        prov_tls_session_cache_destroy(handle);
+    }
+
+    TEST_FUNCTION(prov_tls_session_cache_store_tls_io_NULL_fail)
+    {
+        //arrange
+        PROV_TLS_SESSION_CACHE_HANDLE handle = prov_tls_session_cache_create();
+        umock_c_reset_all_calls();
+
+        //act
+        int result = prov_tls_session_cache_store(handle, TEST_HOSTNAME, NULL);
+
+        //assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        prov_tls_session_cache_destroy(handle);
+    }
+
+    TEST_FUNCTION(prov_tls_session_cache_store_succeed)
+    {
+        //arrange
+        PROV_TLS_SESSION_CACHE_HANDLE handle = prov_tls_session_cache_create();
+        umock_c_reset_all_calls();
+
+        setup_prov_tls_session_cache_store_mocks(TEST_HOSTNAME);
+        STRICT_EXPECTED_CALL(gballoc_free(NULL));
+
+        //act
+        int result = prov_tls_session_cache_store(handle, TEST_HOSTNAME, TEST_XIO_HANDLE);
+
+        //assert
+        ASSERT_ARE_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        prov_tls_session_cache_destroy(handle);
+    }
+
+    TEST_FUNCTION(prov_tls_session_cache_store_replaces_saved_options_succeed)
+    {
+        //arrange
+        PROV_TLS_SESSION_CACHE_HANDLE handle = prov_tls_session_cache_create();
+        (void)prov_tls_session_cache_store(handle, TEST_HOSTNAME, TEST_XIO_HANDLE);
+        umock_c_reset_all_calls();
+
+        setup_prov_tls_session_cache_store_mocks(TEST_OTHER_HOSTNAME);
+        STRICT_EXPECTED_CALL(OptionHandler_Destroy(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(xio_setoption(TEST_XIO_HANDLE, TEST_SESSION_RESUMPTION_OPTION, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(OptionHandler_FeedOptions(IGNORED_PTR_ARG, TEST_XIO_HANDLE));
+        STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG));
+
+        //act
+        int result = prov_tls_session_cache_store(handle, TEST_OTHER_HOSTNAME, TEST_XIO_HANDLE);
+        int apply_result = prov_tls_session_cache_apply(handle, TEST_OTHER_HOSTNAME, TEST_XIO_HANDLE);
+
+        //assert
+        ASSERT_ARE_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(int, 0, apply_result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        prov_tls_session_cache_destroy(handle);
+    }
+
+    TEST_FUNCTION(prov_tls_session_cache_store_fail)
+    {
+        //arrange
+        PROV_TLS_SESSION_CACHE_HANDLE handle = prov_tls_session_cache_create();
+        umock_c_reset_all_calls();
+
+        int negativeTestsInitResult = umock_c_negative_tests_init();
+        ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+        setup_prov_tls_session_cache_store_mocks(TEST_HOSTNAME);
+
+        umock_c_negative_tests_snapshot();
+
+        size_t calls_cannot_fail[] = { 3 };
+
+        //act
+        size_t count = umock_c_negative_tests_call_count();
+        for (size_t index = 0; index < count; index++)
+        {
+            if (should_skip_index(index, calls_cannot_fail, sizeof(calls_cannot_fail) / sizeof(calls_cannot_fail[0])) != 0)
+            {
+                continue;
+            }
+
+            umock_c_negative_tests_reset();
+            umock_c_negative_tests_fail_call(index);
+
+            char tmp_msg[64];
+            sprintf(tmp_msg, "prov_tls_session_cache_store failure in test %zu/%zu", index, count);
+
+            int result = prov_tls_session_cache_store(handle, TEST_HOSTNAME, TEST_XIO_HANDLE);
+
+            //assert
+            ASSERT_ARE_NOT_EQUAL(int, 0, result, tmp_msg);
+        }
+
+        //cleanup
+        umock_c_negative_tests_deinit();
+        prov_tls_session_cache_destroy(handle);
+    }
+
+    END_TEST_SUITE(prov_tls_session_cache_ut)
@@ -56,13 +56,14 @@ static void my_gballoc_free(void* ptr)
 #include "azure_prov_client/internal/prov_sasl_tpm.h"
 #include "azure_uamqp_c/sasl_plain.h"
 #include "azure_c_shared_utility/buffer_.h"
+#include "azure_prov_client/prov_tls_session_cache.h"
 #undef ENABLE_MOCKS
 
 #define ENABLE_MOCKS
 
 #include "azure_c_shared_utility/umock_c_prod.h"
 MOCKABLE_FUNCTION(, void, on_transport_register_data_cb, PROV_DEVICE_TRANSPORT_RESULT, transport_result, BUFFER_HANDLE, iothub_key, const char*, assigned_hub, const char*, device_id, void*, user_ctx);
-MOCKABLE_FUNCTION(, void, on_transport_status_cb, PROV_DEVICE_TRANSPORT_STATUS, transport_status, void*, user_ctx);
+MOCKABLE_FUNCTION(, void, on_transport_status_cb, PROV_DEVICE_TRANSPORT_STATUS, transport_status, uint32_t, retry_interval, void*, user_ctx);
 MOCKABLE_FUNCTION(, char*, on_transport_challenge_callback, const unsigned char*, nonce, size_t, nonce_len, const char*, key_name, void*, user_ctx);
 MOCKABLE_FUNCTION(, PROV_TRANSPORT_IO_INFO*, on_transport_io, const char*, fqdn, SASL_MECHANISM_HANDLE*, sasl_mechanism, const HTTP_PROXY_OPTIONS*, proxy_info);
 MOCKABLE_FUNCTION(, PROV_JSON_INFO*, on_transport_json_parse, const char*, json_document, void*, user_ctx);
@@ -96,6 +97,7 @@ extern "C"
 #define TEST_ASSIGNED       (void*)0x11111119
 #define TEST_ASSIGNING      (void*)0x1111111A
 #define TEST_OPTION_VALUE   (void*)0x1111111B
+#define TEST_TLS_SESSION_CACHE  (PROV_TLS_SESSION_CACHE_HANDLE)0x1111111C
 
 static const char* TEST_OPERATION_ID_VALUE = "operation_id";
 static char* TEST_STRING_VALUE = "Test_String_Value";
@@ -470,6 +472,7 @@ BEGIN_TEST_SUITE(prov_transport_amqp_common_ut)
         REGISTER_UMOCK_ALIAS_TYPE(SESSION_HANDLE, void*);
         REGISTER_UMOCK_ALIAS_TYPE(CONNECTION_HANDLE, void*);
         REGISTER_UMOCK_ALIAS_TYPE(XIO_HANDLE, void*);
+        REGISTER_UMOCK_ALIAS_TYPE(PROV_TLS_SESSION_CACHE_HANDLE, void*);
         REGISTER_UMOCK_ALIAS_TYPE(ON_NEW_ENDPOINT, void*);
         REGISTER_UMOCK_ALIAS_TYPE(ON_LINK_ATTACHED, void*);
         REGISTER_UMOCK_ALIAS_TYPE(role, bool);
@@ -1055,7 +1058,7 @@ BEGIN_TEST_SUITE(prov_transport_amqp_common_ut)
         STRICT_EXPECTED_CALL(BUFFER_clone(IGNORED_PTR_ARG));
         STRICT_EXPECTED_CALL(BUFFER_clone(IGNORED_PTR_ARG));
         STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_REGISTRATION_ID_VALUE));
-        //STRICT_EXPECTED_CALL(on_transport_status_cb(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, IGNORED_PTR_ARG));
+        //STRICT_EXPECTED_CALL(on_transport_status_cb(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, IGNORED_NUM_ARG, IGNORED_PTR_ARG));
 
         //act
         int result = prov_transport_common_amqp_open(handle, TEST_REGISTRATION_ID_VALUE, TEST_BUFFER_VALUE, TEST_BUFFER_VALUE, on_transport_register_data_cb, NULL, on_transport_status_cb, NULL, on_transport_challenge_callback, NULL);
@@ -1081,7 +1084,7 @@ BEGIN_TEST_SUITE(prov_transport_amqp_common_ut)
         //arrange
         STRICT_EXPECTED_CALL(BUFFER_clone(IGNORED_PTR_ARG));
         STRICT_EXPECTED_CALL(BUFFER_clone(IGNORED_PTR_ARG));
-        STRICT_EXPECTED_CALL(on_transport_status_cb(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(on_transport_status_cb(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, IGNORED_NUM_ARG, IGNORED_PTR_ARG));
 
         umock_c_negative_tests_snapshot();
 
@@ -1122,7 +1125,7 @@ BEGIN_TEST_SUITE(prov_transport_amqp_common_ut)
 
         //arrange
         STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_REGISTRATION_ID_VALUE));
-        //STRICT_EXPECTED_CALL(on_transport_status_cb(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, IGNORED_PTR_ARG));
+        //STRICT_EXPECTED_CALL(on_transport_status_cb(PROV_DEVICE_TRANSPORT_STATUS_CONNECTED, IGNORED_NUM_ARG, IGNORED_PTR_ARG));
 
         //act
         int result = prov_transport_common_amqp_open(handle, TEST_REGISTRATION_ID_VALUE, NULL, NULL, on_transport_register_data_cb, NULL, on_transport_status_cb, NULL, on_transport_challenge_callback, NULL);
@@ -2389,4 +2392,74 @@ BEGIN_TEST_SUITE(prov_transport_amqp_common_ut)
         prov_transport_common_amqp_destroy(handle);
     }
 
+    /* Tests_PROV_TRANSPORT_AMQP_COMMON_41_001: [ If option is PROV_OPTION_TLS_SESSION_CACHE, prov_transport_common_amqp_set_option shall keep value as the PROV_TLS_SESSION_CACHE_HANDLE of the transport, without creating the tls io, and return zero. ] */
+    TEST_FUNCTION(prov_transport_common_amqp_set_option_tls_session_cache_succeed)
+    {
+        PROV_DEVICE_TRANSPORT_HANDLE handle = prov_transport_common_amqp_create(TEST_URI_VALUE, TRANSPORT_HSM_TYPE_TPM, TEST_SCOPE_ID_VALUE, TEST_DPS_API_VALUE, on_transport_io, on_transport_error, NULL);
+        umock_c_reset_all_calls();
+
+        //arrange
+
+        //act
+        int result = prov_transport_common_amqp_set_option(handle, PROV_OPTION_TLS_SESSION_CACHE, TEST_TLS_SESSION_CACHE);
+
+        //assert
+        ASSERT_ARE_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        prov_transport_common_amqp_destroy(handle);
+    }
+
+    /* Tests_PROV_TRANSPORT_AMQP_COMMON_41_002: [ If a PROV_OPTION_TLS_SESSION_CACHE is set and the tls io exists, prov_transport_common_amqp_close shall save its options with prov_tls_session_cache_store before destroying it; a failure shall be logged and ignored. ] */
+    TEST_FUNCTION(prov_transport_amqp_close_stores_tls_session_succeed)
+    {
+        PROV_DEVICE_TRANSPORT_HANDLE handle = prov_transport_common_amqp_create(TEST_URI_VALUE, TRANSPORT_HSM_TYPE_TPM, TEST_SCOPE_ID_VALUE, TEST_DPS_API_VALUE, on_transport_io, on_transport_error, NULL);
+        (void)prov_transport_common_amqp_set_option(handle, PROV_OPTION_TLS_SESSION_CACHE, TEST_TLS_SESSION_CACHE);
+        (void)prov_transport_common_amqp_set_option(handle, TEST_XIO_OPTION_NAME, TEST_OPTION_VALUE);
+        umock_c_reset_all_calls();
+
+        //arrange
+        STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(prov_tls_session_cache_store(TEST_TLS_SESSION_CACHE, TEST_URI_VALUE, IGNORED_PTR_ARG)).SetReturn(__LINE__);
+        STRICT_EXPECTED_CALL(xio_destroy(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(xio_destroy(IGNORED_PTR_ARG));
+
+        //act
+        int result = prov_transport_common_amqp_close(handle);
+
+        //assert
+        ASSERT_ARE_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        prov_transport_common_amqp_destroy(handle);
+    }
+
+    TEST_FUNCTION(prov_transport_amqp_close_without_tls_io_does_not_store_succeed)
+    {
+        PROV_DEVICE_TRANSPORT_HANDLE handle = prov_transport_common_amqp_create(TEST_URI_VALUE, TRANSPORT_HSM_TYPE_TPM, TEST_SCOPE_ID_VALUE, TEST_DPS_API_VALUE, on_transport_io, on_transport_error, NULL);
+        (void)prov_transport_common_amqp_set_option(handle, PROV_OPTION_TLS_SESSION_CACHE, TEST_TLS_SESSION_CACHE);
+        umock_c_reset_all_calls();
+
+        //arrange
+        STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(xio_destroy(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(xio_destroy(IGNORED_PTR_ARG));
+
+        //act
+        int result = prov_transport_common_amqp_close(handle);
+
+        //assert
+        ASSERT_ARE_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        //cleanup
+        prov_transport_common_amqp_destroy(handle);
+    }
+
     END_TEST_SUITE(prov_transport_amqp_common_ut)
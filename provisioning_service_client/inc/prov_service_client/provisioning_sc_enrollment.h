@@ -21,6 +21,7 @@ extern "C" {
 */
 typedef struct INDIVIDUAL_ENROLLMENT_TAG* INDIVIDUAL_ENROLLMENT_HANDLE;
 typedef struct ENROLLMENT_GROUP_TAG* ENROLLMENT_GROUP_HANDLE;
+typedef struct INDIVIDUAL_ENROLLMENT_VIEW_TAG* INDIVIDUAL_ENROLLMENT_VIEW_HANDLE;
 
 #define PROVISIONING_STATUS_VALUES \
         PROVISIONING_STATUS_NONE, \
@@ -72,6 +73,20 @@ MOCKABLE_FUNCTION(, ENROLLMENT_GROUP_HANDLE, enrollmentGroup_create, const char*
 */
 MOCKABLE_FUNCTION(, void, enrollmentGroup_destroy, ENROLLMENT_GROUP_HANDLE, enrollment);
 
+/** @brief  Destroys an Individual Enrollment View handle, freeing the parsed JSON it holds and any fields materialized from it.
+*
+* @param    view            A handle for the Individual Enrollment View to be destroyed.
+*/
+MOCKABLE_FUNCTION(, void, individualEnrollmentView_destroy, INDIVIDUAL_ENROLLMENT_VIEW_HANDLE, view);
+
+/** @brief  Creates a full Individual Enrollment from an Individual Enrollment View, e.g. in order to update it on the Provisioning Service.
+*
+* @param    view            A handle for the Individual Enrollment View.
+*
+* @return   A non-NULL handle representing an Individual Enrollment that is owned by the caller, and NULL on failure.
+*/
+MOCKABLE_FUNCTION(, INDIVIDUAL_ENROLLMENT_HANDLE, individualEnrollmentView_toEnrollment, INDIVIDUAL_ENROLLMENT_VIEW_HANDLE, view);
+
 
 /* ACCESSOR FUNCTIONS
 *
@@ -117,6 +132,23 @@ MOCKABLE_FUNCTION(, int, enrollmentGroup_setProvisioningStatus, ENROLLMENT_GROUP
 MOCKABLE_FUNCTION(, const char*, enrollmentGroup_getCreatedDateTime, ENROLLMENT_GROUP_HANDLE, enrollment);
 MOCKABLE_FUNCTION(, const char*, enrollmentGroup_getUpdatedDateTime, ENROLLMENT_GROUP_HANDLE, enrollment);
 
+/* Individual Enrollment View Accessor Functions
+*
+* A view is read only. String fields are read straight from the parsed JSON and structured fields are only deserialized
+* the first time they are accessed. All returned values are owned by the view and are valid until it is destroyed.
+*/
+MOCKABLE_FUNCTION(, ATTESTATION_MECHANISM_HANDLE, individualEnrollmentView_getAttestationMechanism, INDIVIDUAL_ENROLLMENT_VIEW_HANDLE, view);
+MOCKABLE_FUNCTION(, INITIAL_TWIN_HANDLE, individualEnrollmentView_getInitialTwin, INDIVIDUAL_ENROLLMENT_VIEW_HANDLE, view);
+MOCKABLE_FUNCTION(, DEVICE_CAPABILITIES_HANDLE, individualEnrollmentView_getDeviceCapabilities, INDIVIDUAL_ENROLLMENT_VIEW_HANDLE, view);
+MOCKABLE_FUNCTION(, DEVICE_REGISTRATION_STATE_HANDLE, individualEnrollmentView_getDeviceRegistrationState, INDIVIDUAL_ENROLLMENT_VIEW_HANDLE, view);
+MOCKABLE_FUNCTION(, const char*, individualEnrollmentView_getRegistrationId, INDIVIDUAL_ENROLLMENT_VIEW_HANDLE, view);
+MOCKABLE_FUNCTION(, const char*, individualEnrollmentView_getIotHubHostName, INDIVIDUAL_ENROLLMENT_VIEW_HANDLE, view);
+MOCKABLE_FUNCTION(, const char*, individualEnrollmentView_getDeviceId, INDIVIDUAL_ENROLLMENT_VIEW_HANDLE, view);
+MOCKABLE_FUNCTION(, const char*, individualEnrollmentView_getEtag, INDIVIDUAL_ENROLLMENT_VIEW_HANDLE, view);
+MOCKABLE_FUNCTION(, PROVISIONING_STATUS, individualEnrollmentView_getProvisioningStatus, INDIVIDUAL_ENROLLMENT_VIEW_HANDLE, view);
+MOCKABLE_FUNCTION(, const char*, individualEnrollmentView_getCreatedDateTime, INDIVIDUAL_ENROLLMENT_VIEW_HANDLE, view);
+MOCKABLE_FUNCTION(, const char*, individualEnrollmentView_getUpdatedDateTime, INDIVIDUAL_ENROLLMENT_VIEW_HANDLE, view);
+
 
 /* INTERNAL FUNCTIONS
 *
@@ -125,6 +157,7 @@ MOCKABLE_FUNCTION(, const char*, enrollmentGroup_getUpdatedDateTime, ENROLLMENT_
 MOCKABLE_FUNCTION(, JSON_Value*, individualEnrollment_toJson, INDIVIDUAL_ENROLLMENT_HANDLE, enrollment);
 MOCKABLE_FUNCTION(, INDIVIDUAL_ENROLLMENT_HANDLE, individualEnrollment_fromJson, JSON_Object*, root_object);
 MOCKABLE_FUNCTION(, ENROLLMENT_GROUP_HANDLE, enrollmentGroup_fromJson, JSON_Object*, root_object);
+MOCKABLE_FUNCTION(, INDIVIDUAL_ENROLLMENT_VIEW_HANDLE, individualEnrollmentView_fromJson, JSON_Object*, root_object);
 
 #ifdef __cplusplus
 }
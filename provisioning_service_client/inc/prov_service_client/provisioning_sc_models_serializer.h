@@ -30,6 +30,14 @@ MOCKABLE_FUNCTION(, char*, individualEnrollment_serializeToJson, const INDIVIDUA
 */
 MOCKABLE_FUNCTION(, INDIVIDUAL_ENROLLMENT_HANDLE, individualEnrollment_deserializeFromJson, const char*, json_string);
 
+/** @brief  Deserializes a JSON String representation of an Individual Enrollment into a read only view that keeps the parsed JSON.
+*
+* @param    json_string     A JSON String representing an Individual Enrollment.
+*
+* @return   A non-NULL handle representing an Individual Enrollment View, and NULL on failure.
+*/
+MOCKABLE_FUNCTION(, INDIVIDUAL_ENROLLMENT_VIEW_HANDLE, individualEnrollmentView_deserializeFromJson, const char*, json_string);
+
 /** @brief  Serializes an Enrollment Group into a JSON String.
 *
 * @param    enrollment      A handle for the Enrollment Group to be serialized.
@@ -46,10 +46,29 @@ typedef struct PROVISIONING_QUERY_RESPONSE_TAG
     PROVISIONING_QUERY_TYPE response_arr_type;
 } PROVISIONING_QUERY_RESPONSE;
 
+/* A single record of a query, as handed out while iterating over query results */
+typedef struct PROVISIONING_QUERY_RECORD_TAG
+{
+    union {
+        INDIVIDUAL_ENROLLMENT_HANDLE ie;
+        ENROLLMENT_GROUP_HANDLE eg;
+        DEVICE_REGISTRATION_STATE_HANDLE drs;
+    } record;
+    PROVISIONING_QUERY_TYPE record_type;
+} PROVISIONING_QUERY_RECORD;
+
+/* A page of query results kept as parsed JSON, its records are only deserialized on request */
+typedef struct PROVISIONING_QUERY_PAGE_TAG* PROVISIONING_QUERY_PAGE_HANDLE;
+
 MOCKABLE_FUNCTION(, void, queryResponse_free, PROVISIONING_QUERY_RESPONSE*, query_resp);
 
 /*---INTERNAL USAGE ONLY---*/
 MOCKABLE_FUNCTION(, PROVISIONING_QUERY_TYPE, queryType_stringToEnum, const char*, string);
+MOCKABLE_FUNCTION(, PROVISIONING_QUERY_PAGE_HANDLE, queryPage_deserializeFromJson, const char*, json_string, PROVISIONING_QUERY_TYPE, type);
+MOCKABLE_FUNCTION(, size_t, queryPage_getRecordCount, PROVISIONING_QUERY_PAGE_HANDLE, page);
+MOCKABLE_FUNCTION(, int, queryPage_getRecord, PROVISIONING_QUERY_PAGE_HANDLE, page, size_t, index, PROVISIONING_QUERY_RECORD*, record);
+MOCKABLE_FUNCTION(, void, queryPage_free, PROVISIONING_QUERY_PAGE_HANDLE, page);
+MOCKABLE_FUNCTION(, void, queryRecord_free, PROVISIONING_QUERY_RECORD*, record);
 
 #ifdef __cplusplus
 }
@@ -25,6 +25,27 @@ DEFINE_ENUM(TRACING_STATUS, TRACING_STATUS_VALUES);
 */
 typedef struct PROVISIONING_SERVICE_CLIENT_TAG* PROVISIONING_SERVICE_CLIENT_HANDLE;
 
+/** @brief  Number of enrollments the Provisioning Service accepts in a single bulk operation.
+*/
+#define PROVISIONING_BULK_IMPORT_MAX_BATCH_SIZE 10
+
+/** @brief  Called for every enrollment the Provisioning Service rejected during an import, as soon as the batch holding it is answered.
+*           The error is only valid for the duration of the call.
+*/
+typedef void(*PROV_SC_BULK_IMPORT_ERROR_CALLBACK)(const PROVISIONING_BULK_OPERATION_ERROR* error, void* user_context);
+
+/** @brief  Handle to a query that streams its records, see prov_sc_query_iterator_next
+*/
+typedef struct PROVISIONING_QUERY_ITERATOR_TAG* PROVISIONING_QUERY_ITERATOR_HANDLE;
+
+typedef struct PROVISIONING_BULK_IMPORT_OPTIONS_TAG
+{
+    size_t batch_size;                  /* Enrollments per bulk request, 0 uses PROVISIONING_BULK_IMPORT_MAX_BATCH_SIZE */
+    size_t max_concurrent_requests;     /* Connections kept open, each with one batch in flight, 0 uses 4 */
+    PROV_SC_BULK_IMPORT_ERROR_CALLBACK on_error;
+    void* user_context;
+} PROVISIONING_BULK_IMPORT_OPTIONS;
+
 /** @brief  Creates a Provisioning Service Client handle for use in consequent APIs.
 *
 * @param    conn_string     A connection string used to establish connection with the Provisioning Service.
@@ -47,6 +68,14 @@ MOCKABLE_FUNCTION(, void, prov_sc_destroy, PROVISIONING_SERVICE_CLIENT_HANDLE, p
 */
 MOCKABLE_FUNCTION(, void, prov_sc_set_trace, PROVISIONING_SERVICE_CLIENT_HANDLE, prov_client, TRACING_STATUS, status);
 
+/** @brief  Keeps the HTTPS connection and the SAS token of a Provisioning Service Client between calls, instead of setting up
+*           a new connection for every request. A connection dropped by the service is reopened on the next call.
+*
+* @param    prov_client     The handle used for connecting to the Provisioning Service.
+* @param    keep_alive      true to keep the connection open between calls, false to close it after every call (the default).
+*/
+MOCKABLE_FUNCTION(, void, prov_sc_set_keep_alive, PROVISIONING_SERVICE_CLIENT_HANDLE, prov_client, bool, keep_alive);
+
 /** @brief  Set the trusted certificate for HTTP communication with the Provisioning Service.
 *
 * @param    prov_client     The handle used for connecting to the Provisioning Service.
@@ -103,6 +132,17 @@ MOCKABLE_FUNCTION(, int, prov_sc_delete_individual_enrollment_by_param, PROVISIO
 */
 MOCKABLE_FUNCTION(, int, prov_sc_get_individual_enrollment, PROVISIONING_SERVICE_CLIENT_HANDLE, prov_client, const char*, reg_id, INDIVIDUAL_ENROLLMENT_HANDLE*, enrollment_ptr);
 
+/** @brief  Retreives an individual device enrollment record from the Provisioning Service as a read only view. The view keeps
+*           the received JSON and only deserializes fields when they are accessed, use it when only a few fields are needed.
+*
+* @param    prov_client     The handle used for connecting to the Provisioning Service.
+* @param    reg_id          The registration id of the target individual enrollment.
+* @param    view_ptr        Pointer to a handle for an individual enrollment view, to be filled with retreived data.
+*
+* @return   0 upon success, a non-zero number upon failure.
+*/
+MOCKABLE_FUNCTION(, int, prov_sc_get_individual_enrollment_view, PROVISIONING_SERVICE_CLIENT_HANDLE, prov_client, const char*, reg_id, INDIVIDUAL_ENROLLMENT_VIEW_HANDLE*, view_ptr);
+
 
 /** @brief  Queries individual device enrollment records from the Provisioning Service.
 *
@@ -115,6 +155,15 @@ MOCKABLE_FUNCTION(, int, prov_sc_get_individual_enrollment, PROVISIONING_SERVICE
 */
 MOCKABLE_FUNCTION(, int, prov_sc_query_individual_enrollment, PROVISIONING_SERVICE_CLIENT_HANDLE, prov_client, PROVISIONING_QUERY_SPECIFICATION*, query_spec, char**, cont_token_ptr, PROVISIONING_QUERY_RESPONSE**, query_resp_ptr);
 
+/** @brief  Starts a query of individual device enrollment records that is read one record at a time with prov_sc_query_iterator_next.
+*
+* @param    prov_client     The handle used for connecting to the Provisioning Service, it must outlive the iterator.
+* @param    query_spec      The query specification with query details and settings, it is only used during this call.
+*
+* @return   A non-NULL PROVISIONING_QUERY_ITERATOR_HANDLE upon success and NULL on failure.
+*/
+MOCKABLE_FUNCTION(, PROVISIONING_QUERY_ITERATOR_HANDLE, prov_sc_create_individual_enrollment_query_iterator, PROVISIONING_SERVICE_CLIENT_HANDLE, prov_client, PROVISIONING_QUERY_SPECIFICATION*, query_spec);
+
 /** @brief  Performs a bulk operation on individual device enrollment records from the provisioning service.
 *
 * @param    prov_client     The handle used for connecting to the Provisioning Service.
@@ -125,6 +174,19 @@ MOCKABLE_FUNCTION(, int, prov_sc_query_individual_enrollment, PROVISIONING_SERVI
 */
 MOCKABLE_FUNCTION(, int, prov_sc_run_individual_enrollment_bulk_operation, PROVISIONING_SERVICE_CLIENT_HANDLE, prov_client, PROVISIONING_BULK_OPERATION*, bulk_op, PROVISIONING_BULK_OPERATION_RESULT**, bulk_res_ptr);
 
+/** @brief  Runs a bulk operation of any size on individual device enrollment records, split into batches that are sent over
+*           several connections at once. The connections are reused from one batch to the next.
+*
+* @param    prov_client     The handle used for connecting to the Provisioning Service.
+* @param    bulk_op         A pointer to a bulk operation structure holding every enrollment to import.
+* @param    options         Batching and concurrency settings, NULL uses the defaults and does not report errors.
+* @param    num_failed      Filled with the number of enrollments the Provisioning Service rejected.
+*
+* @return   0 when every batch was answered, a non-zero number if a batch could not be sent or answered. Enrollments
+*           rejected by the service are reported through on_error and num_failed, they do not make the call fail.
+*/
+MOCKABLE_FUNCTION(, int, prov_sc_import_individual_enrollments, PROVISIONING_SERVICE_CLIENT_HANDLE, prov_client, PROVISIONING_BULK_OPERATION*, bulk_op, const PROVISIONING_BULK_IMPORT_OPTIONS*, options, size_t*, num_failed);
+
 /** @brief  Creates or updates a device enrollment group record on the Provisioning Service.
 *
 * @param    prov_client         The handle used for connecting to the Provisioning Service.
@@ -172,6 +234,15 @@ MOCKABLE_FUNCTION(, int, prov_sc_get_enrollment_group, PROVISIONING_SERVICE_CLIE
 */
 MOCKABLE_FUNCTION(, int, prov_sc_query_enrollment_group, PROVISIONING_SERVICE_CLIENT_HANDLE, prov_client, PROVISIONING_QUERY_SPECIFICATION*, query_spec, char**, cont_token_ptr, PROVISIONING_QUERY_RESPONSE**, query_resp_ptr);
 
+/** @brief  Starts a query of enrollment group records that is read one record at a time with prov_sc_query_iterator_next.
+*
+* @param    prov_client     The handle used for connecting to the Provisioning Service, it must outlive the iterator.
+* @param    query_spec      The query specification with query details and settings, it is only used during this call.
+*
+* @return   A non-NULL PROVISIONING_QUERY_ITERATOR_HANDLE upon success and NULL on failure.
+*/
+MOCKABLE_FUNCTION(, PROVISIONING_QUERY_ITERATOR_HANDLE, prov_sc_create_enrollment_group_query_iterator, PROVISIONING_SERVICE_CLIENT_HANDLE, prov_client, PROVISIONING_QUERY_SPECIFICATION*, query_spec);
+
 /** @brief  Deletes a device registration state on the Provisioning Service.
 *
 * @param    prov_client     The handle used for connecting to the Provisioning Service.
@@ -212,6 +283,32 @@ MOCKABLE_FUNCTION(, int, prov_sc_get_device_registration_state, PROVISIONING_SER
 */
 MOCKABLE_FUNCTION(, int, prov_sc_query_device_registration_state, PROVISIONING_SERVICE_CLIENT_HANDLE, prov_client, PROVISIONING_QUERY_SPECIFICATION*, query_spec, char**, cont_token_ptr, PROVISIONING_QUERY_RESPONSE**, query_resp_ptr);
 
+/** @brief  Starts a query of device registration state records that is read one record at a time with prov_sc_query_iterator_next.
+*
+* @param    prov_client     The handle used for connecting to the Provisioning Service, it must outlive the iterator.
+* @param    query_spec      The query specification with query details and settings, it is only used during this call.
+*
+* @return   A non-NULL PROVISIONING_QUERY_ITERATOR_HANDLE upon success and NULL on failure.
+*/
+MOCKABLE_FUNCTION(, PROVISIONING_QUERY_ITERATOR_HANDLE, prov_sc_create_device_registration_state_query_iterator, PROVISIONING_SERVICE_CLIENT_HANDLE, prov_client, PROVISIONING_QUERY_SPECIFICATION*, query_spec);
+
+/** @brief  Retrieves the next record of a query. The next page of results is requested as soon as the current page arrives,
+*           so it is usually available by the time the current page has been read.
+*
+* @param    iterator        The handle created by one of the query iterator create functions.
+* @param    record          Filled with the next record, its record_type is QUERY_TYPE_INVALID once every record has been read.
+*                           The record is owned by the iterator and only valid until the next call or until the iterator is destroyed.
+*
+* @return   0 upon success, a non-zero number upon failure
+*/
+MOCKABLE_FUNCTION(, int, prov_sc_query_iterator_next, PROVISIONING_QUERY_ITERATOR_HANDLE, iterator, PROVISIONING_QUERY_RECORD*, record);
+
+/** @brief  Disposes of resources allocated by creating a query iterator, including the last record handed out.
+*
+* @param    iterator        The handle created by one of the query iterator create functions.
+*/
+MOCKABLE_FUNCTION(, void, prov_sc_query_iterator_destroy, PROVISIONING_QUERY_ITERATOR_HANDLE, iterator);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -43,6 +43,18 @@ typedef struct ENROLLMENT_GROUP_TAG
     char* updated_date_time_utc; //read only
 } ENROLLMENT_GROUP;
 
+typedef struct INDIVIDUAL_ENROLLMENT_VIEW_TAG
+{
+    JSON_Value* root_value; //NULL when the JSON is owned by someone else (e.g. a query page)
+    JSON_Object* root_object;
+
+    //Materialized on first access
+    DEVICE_CAPABILITIES_HANDLE capabilities;
+    DEVICE_REGISTRATION_STATE_HANDLE registration_state;
+    ATTESTATION_MECHANISM_HANDLE attestation_mechanism;
+    INITIAL_TWIN_HANDLE initial_twin;
+} INDIVIDUAL_ENROLLMENT_VIEW;
+
 DEFINE_ENUM_STRINGS(PROVISIONING_STATUS, PROVISIONING_STATUS_VALUES)
 
 static const char* provisioningStatus_toJson(PROVISIONING_STATUS status)
@@ -1131,3 +1143,230 @@ const char* enrollmentGroup_getUpdatedDateTime(ENROLLMENT_GROUP_HANDLE enrollmen
 
     return result;
 }
+
+static void* individualEnrollmentView_materialize(void** cache, JSON_Object* root_object, const char* json_key, FROM_JSON_FUNCTION fromJson)
+{
+    JSON_Object* field_object;
+
+    if (*cache == NULL && (field_object = json_object_get_object(root_object, json_key)) != NULL)
+    {
+        if ((*cache = fromJson(field_object)) == NULL)
+        {
+            LogError("Failed to materialize '%s' in Individual Enrollment View", json_key);
+        }
+    }
+
+    return *cache;
+}
+
+INDIVIDUAL_ENROLLMENT_VIEW_HANDLE individualEnrollmentView_fromJson(JSON_Object* root_object)
+{
+    INDIVIDUAL_ENROLLMENT_VIEW_HANDLE new_view = NULL;
+
+    if (root_object == NULL)
+    {
+        LogError("No enrollment in JSON");
+    }
+    else if ((new_view = malloc(sizeof(INDIVIDUAL_ENROLLMENT_VIEW))) == NULL)
+    {
+        LogError("Allocation of Individual Enrollment View failed");
+    }
+    else
+    {
+        memset(new_view, 0, sizeof(INDIVIDUAL_ENROLLMENT_VIEW));
+        new_view->root_object = root_object;
+    }
+
+    return new_view;
+}
+
+INDIVIDUAL_ENROLLMENT_VIEW_HANDLE individualEnrollmentView_deserializeFromJson(const char* json_string)
+{
+    INDIVIDUAL_ENROLLMENT_VIEW_HANDLE new_view = NULL;
+    JSON_Value* root_value = NULL;
+    JSON_Object* root_object = NULL;
+
+    if (json_string == NULL)
+    {
+        LogError("Cannot deserialize NULL");
+    }
+    else if ((root_value = json_parse_string(json_string)) == NULL)
+    {
+        LogError("Parsing JSON string failed");
+    }
+    else if ((root_object = json_value_get_object(root_value)) == NULL)
+    {
+        LogError("Creating JSON object failed");
+        json_value_free(root_value);
+    }
+    else if ((new_view = individualEnrollmentView_fromJson(root_object)) == NULL)
+    {
+        LogError("Creating new Individual Enrollment View failed");
+        json_value_free(root_value);
+    }
+    else
+    {
+        //the parsed JSON is kept, fields are read from it on access
+        new_view->root_value = root_value;
+    }
+
+    return new_view;
+}
+
+void individualEnrollmentView_destroy(INDIVIDUAL_ENROLLMENT_VIEW_HANDLE view)
+{
+    if (view != NULL)
+    {
+        deviceCapabilities_destroy(view->capabilities);
+        deviceRegistrationState_destroy(view->registration_state);
+        attestationMechanism_destroy(view->attestation_mechanism);
+        initialTwin_destroy(view->initial_twin);
+        if (view->root_value != NULL)
+        {
+            json_value_free(view->root_value); //implicitly frees root_object
+        }
+        free(view);
+    }
+}
+
+INDIVIDUAL_ENROLLMENT_HANDLE individualEnrollmentView_toEnrollment(INDIVIDUAL_ENROLLMENT_VIEW_HANDLE view)
+{
+    INDIVIDUAL_ENROLLMENT_HANDLE result = NULL;
+
+    if (view == NULL)
+    {
+        LogError("view is NULL");
+    }
+    else if ((result = individualEnrollment_fromJson(view->root_object)) == NULL)
+    {
+        LogError("Creating new Individual Enrollment failed");
+    }
+
+    return result;
+}
+
+ATTESTATION_MECHANISM_HANDLE individualEnrollmentView_getAttestationMechanism(INDIVIDUAL_ENROLLMENT_VIEW_HANDLE view)
+{
+    ATTESTATION_MECHANISM_HANDLE result = NULL;
+
+    if (view == NULL)
+    {
+        LogError("view is NULL");
+    }
+    else
+    {
+        result = individualEnrollmentView_materialize((void**)&(view->attestation_mechanism), view->root_object, INDIVIDUAL_ENROLLMENT_JSON_KEY_ATTESTATION, (FROM_JSON_FUNCTION)attestationMechanism_fromJson);
+    }
+
+    return result;
+}
+
+INITIAL_TWIN_HANDLE individualEnrollmentView_getInitialTwin(INDIVIDUAL_ENROLLMENT_VIEW_HANDLE view)
+{
+    INITIAL_TWIN_HANDLE result = NULL;
+
+    if (view == NULL)
+    {
+        LogError("view is NULL");
+    }
+    else
+    {
+        result = individualEnrollmentView_materialize((void**)&(view->initial_twin), view->root_object, INDIVIDUAL_ENROLLMENT_JSON_KEY_INITIAL_TWIN, (FROM_JSON_FUNCTION)initialTwin_fromJson);
+    }
+
+    return result;
+}
+
+DEVICE_CAPABILITIES_HANDLE individualEnrollmentView_getDeviceCapabilities(INDIVIDUAL_ENROLLMENT_VIEW_HANDLE view)
+{
+    DEVICE_CAPABILITIES_HANDLE result = NULL;
+
+    if (view == NULL)
+    {
+        LogError("view is NULL");
+    }
+    else
+    {
+        result = individualEnrollmentView_materialize((void**)&(view->capabilities), view->root_object, INDIVIDUAL_ENROLLMENT_JSON_KEY_CAPABILITIES, (FROM_JSON_FUNCTION)deviceCapabilities_fromJson);
+    }
+
+    return result;
+}
+
+DEVICE_REGISTRATION_STATE_HANDLE individualEnrollmentView_getDeviceRegistrationState(INDIVIDUAL_ENROLLMENT_VIEW_HANDLE view)
+{
+    DEVICE_REGISTRATION_STATE_HANDLE result = NULL;
+
+    if (view == NULL)
+    {
+        LogError("view is NULL");
+    }
+    else
+    {
+        result = individualEnrollmentView_materialize((void**)&(view->registration_state), view->root_object, INDIVIDUAL_ENROLLMENT_JSON_KEY_REG_STATE, (FROM_JSON_FUNCTION)deviceRegistrationState_fromJson);
+    }
+
+    return result;
+}
+
+static const char* individualEnrollmentView_getString(INDIVIDUAL_ENROLLMENT_VIEW_HANDLE view, const char* json_key)
+{
+    const char* result = NULL;
+
+    if (view == NULL)
+    {
+        LogError("view is NULL");
+    }
+    else
+    {
+        result = json_object_get_string(view->root_object, json_key);
+    }
+
+    return result;
+}
+
+const char* individualEnrollmentView_getRegistrationId(INDIVIDUAL_ENROLLMENT_VIEW_HANDLE view)
+{
+    return individualEnrollmentView_getString(view, INDIVIDUAL_ENROLLMENT_JSON_KEY_REG_ID);
+}
+
+const char* individualEnrollmentView_getDeviceId(INDIVIDUAL_ENROLLMENT_VIEW_HANDLE view)
+{
+    return individualEnrollmentView_getString(view, INDIVIDUAL_ENROLLMENT_JSON_KEY_DEVICE_ID);
+}
+
+const char* individualEnrollmentView_getIotHubHostName(INDIVIDUAL_ENROLLMENT_VIEW_HANDLE view)
+{
+    return individualEnrollmentView_getString(view, INDIVIDUAL_ENROLLMENT_JSON_KEY_IOTHUB_HOSTNAME);
+}
+
+const char* individualEnrollmentView_getEtag(INDIVIDUAL_ENROLLMENT_VIEW_HANDLE view)
+{
+    return individualEnrollmentView_getString(view, INDIVIDUAL_ENROLLMENT_JSON_KEY_ETAG);
+}
+
+PROVISIONING_STATUS individualEnrollmentView_getProvisioningStatus(INDIVIDUAL_ENROLLMENT_VIEW_HANDLE view)
+{
+    PROVISIONING_STATUS result = PROVISIONING_STATUS_NONE;
+
+    if (view == NULL)
+    {
+        LogError("view is NULL");
+    }
+    else
+    {
+        result = provisioningStatus_fromJson(json_object_get_string(view->root_object, INDIVIDUAL_ENROLLMENT_JSON_KEY_PROV_STATUS));
+    }
+
+    return result;
+}
+
+const char* individualEnrollmentView_getCreatedDateTime(INDIVIDUAL_ENROLLMENT_VIEW_HANDLE view)
+{
+    return individualEnrollmentView_getString(view, INDIVIDUAL_ENROLLMENT_JSON_KEY_CREATED_TIME);
+}
+
+const char* individualEnrollmentView_getUpdatedDateTime(INDIVIDUAL_ENROLLMENT_VIEW_HANDLE view)
+{
+    return individualEnrollmentView_getString(view, INDIVIDUAL_ENROLLMENT_JSON_KEY_UPDATED_TIME);
+}
\ No newline at end of file
@@ -13,6 +13,14 @@
 #include "prov_service_client/provisioning_sc_models_serializer.h"
 #include "parson.h"
 
+typedef struct PROVISIONING_QUERY_PAGE_TAG
+{
+    JSON_Value* root_value;
+    JSON_Array* root_array;
+    size_t record_count;
+    PROVISIONING_QUERY_TYPE type;
+} PROVISIONING_QUERY_PAGE;
+
 void queryResponse_free(PROVISIONING_QUERY_RESPONSE* query_resp)
 {
     size_t i;
@@ -268,3 +276,142 @@ PROVISIONING_QUERY_TYPE queryType_stringToEnum(const char* string)
 
     return result;
 }
+
+PROVISIONING_QUERY_PAGE_HANDLE queryPage_deserializeFromJson(const char* json_string, PROVISIONING_QUERY_TYPE type)
+{
+    PROVISIONING_QUERY_PAGE* new_page = NULL;
+    JSON_Value* root_value = NULL;
+    JSON_Array* root_array = NULL;
+
+    if (json_string == NULL)
+    {
+        LogError("Cannot deserialize NULL");
+    }
+    else if (type == QUERY_TYPE_INVALID)
+    {
+        LogError("Invalid query type");
+    }
+    else if ((root_value = json_parse_string(json_string)) == NULL)
+    {
+        LogError("Parsing JSON string failed");
+    }
+    else if ((root_array = json_value_get_array(root_value)) == NULL)
+    {
+        LogError("Creating JSON array failed");
+        json_value_free(root_value);
+    }
+    else if ((new_page = malloc(sizeof(PROVISIONING_QUERY_PAGE))) == NULL)
+    {
+        LogError("Allocation of Query Page failed");
+        json_value_free(root_value);
+    }
+    else
+    {
+        //the parsed JSON is kept, records are deserialized one at a time by queryPage_getRecord
+        new_page->root_value = root_value;
+        new_page->root_array = root_array;
+        new_page->record_count = json_array_get_count(root_array);
+        new_page->type = type;
+    }
+
+    return new_page;
+}
+
+size_t queryPage_getRecordCount(PROVISIONING_QUERY_PAGE_HANDLE page)
+{
+    size_t result;
+
+    if (page == NULL)
+    {
+        LogError("Invalid query page");
+        result = 0;
+    }
+    else
+    {
+        result = page->record_count;
+    }
+
+    return result;
+}
+
+int queryPage_getRecord(PROVISIONING_QUERY_PAGE_HANDLE page, size_t index, PROVISIONING_QUERY_RECORD* record)
+{
+    int result;
+    JSON_Object* record_object;
+
+    if (page == NULL || record == NULL)
+    {
+        LogError("Invalid parameter specified page: %p, record: %p", page, record);
+        result = __FAILURE__;
+    }
+    else if (index >= page->record_count)
+    {
+        LogError("Record index %lu is out of range", (unsigned long)index);
+        result = __FAILURE__;
+    }
+    else if ((record_object = json_array_get_object(page->root_array, index)) == NULL)
+    {
+        LogError("Failed to retrieve object at index %lu from JSON Array", (unsigned long)index);
+        result = __FAILURE__;
+    }
+    else
+    {
+        record->record_type = page->type;
+        if (page->type == QUERY_TYPE_INDIVIDUAL_ENROLLMENT)
+        {
+            record->record.ie = individualEnrollment_fromJson(record_object);
+        }
+        else if (page->type == QUERY_TYPE_ENROLLMENT_GROUP)
+        {
+            record->record.eg = enrollmentGroup_fromJson(record_object);
+        }
+        else
+        {
+            record->record.drs = deviceRegistrationState_fromJson(record_object);
+        }
+
+        //all members of the union are pointers, checking one of them covers each type
+        if (record->record.ie == NULL)
+        {
+            LogError("Failed to deserialize object at index %lu from JSON Array", (unsigned long)index);
+            record->record_type = QUERY_TYPE_INVALID;
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+void queryPage_free(PROVISIONING_QUERY_PAGE_HANDLE page)
+{
+    if (page != NULL)
+    {
+        json_value_free(page->root_value); //implicitly frees root_array
+        free(page);
+    }
+}
+
+void queryRecord_free(PROVISIONING_QUERY_RECORD* record)
+{
+    if (record != NULL)
+    {
+        if (record->record_type == QUERY_TYPE_INDIVIDUAL_ENROLLMENT)
+        {
+            individualEnrollment_destroy(record->record.ie);
+        }
+        else if (record->record_type == QUERY_TYPE_ENROLLMENT_GROUP)
+        {
+            enrollmentGroup_destroy(record->record.eg);
+        }
+        else if (record->record_type == QUERY_TYPE_DEVICE_REGISTRATION_STATE)
+        {
+            deviceRegistrationState_destroy(record->record.drs);
+        }
+        record->record.ie = NULL;
+        record->record_type = QUERY_TYPE_INVALID;
+    }
+}
@@ -2,6 +2,7 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
 #include <stdlib.h>
+#include <stdbool.h>
 
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/xlogging.h"
@@ -50,6 +51,12 @@ typedef struct PROVISIONING_SERVICE_CLIENT_TAG
     HTTP_PROXY_OPTIONS* proxy_options;
     char* certificate;
 
+    //Kept between calls while keep_alive is set
+    bool keep_alive;
+    HTTP_CLIENT_HANDLE http_client;
+    STRING_HANDLE sas_token;
+    size_t sas_token_expiry;
+
 } PROV_SERVICE_CLIENT;
 
 typedef char*(*VECTOR_SERIALIZE_TO_JSON)(void*);
@@ -67,6 +74,39 @@ typedef struct HANDLE_FUNCTION_VECTOR_TAG
     VECTOR_DESTROY destroy;
 } HANDLE_FUNCTION_VECTOR;
 
+// One persistent connection of a bulk import, it carries one batch at a time
+typedef struct BULK_IMPORT_CONNECTION_TAG
+{
+    HTTP_CLIENT_HANDLE http_client;
+    HTTP_CONNECTION_STATE http_state;
+    char* response;
+
+    char* content;
+    HTTP_HEADERS_HANDLE request_headers;
+    size_t batch_start;
+    size_t batch_size;
+} BULK_IMPORT_CONNECTION;
+
+// Streams the records of a query, the next page is requested as soon as the current one has arrived
+typedef struct PROVISIONING_QUERY_ITERATOR_TAG
+{
+    PROV_SERVICE_CLIENT* prov_client;
+    HTTP_CLIENT_HANDLE http_client;
+    HTTP_CONNECTION_STATE http_state;
+    char* response;
+    HTTP_HEADERS_HANDLE response_headers;
+    HTTP_HEADERS_HANDLE request_headers;
+
+    STRING_HANDLE registration_path;
+    char* content;
+    size_t page_size;
+    char* cont_token;
+
+    PROVISIONING_QUERY_PAGE_HANDLE page;
+    size_t page_index;
+    PROVISIONING_QUERY_RECORD record;
+} PROVISIONING_QUERY_ITERATOR;
+
 static const char* const IOTHUBHOSTNAME =                       "HostName";
 static const char* const IOTHUBSHAREDACESSKEYNAME =             "SharedAccessKeyName";
 static const char* const IOTHUBSHAREDACESSKEY =                 "SharedAccessKey";
@@ -94,7 +134,9 @@ static const char* const HEADER_VALUE_CONTENT_TYPE =            "application/jso
 #define DEFAULT_HTTPS_PORT          443
 #define UID_LENGTH                  37
 #define SAS_TOKEN_DEFAULT_LIFETIME  3600
+#define SAS_TOKEN_REFRESH_MARGIN    300
 #define EPOCH_TIME_T_VALUE          (time_t)0
+#define BULK_IMPORT_DEFAULT_CONCURRENCY 4
 
 static HANDLE_FUNCTION_VECTOR getVector_individualEnrollment()
 {
@@ -108,6 +150,18 @@ static HANDLE_FUNCTION_VECTOR getVector_individualEnrollment()
     return vector;
 }
 
+static HANDLE_FUNCTION_VECTOR getVector_individualEnrollmentView()
+{
+    HANDLE_FUNCTION_VECTOR vector;
+    vector.serializeToJson = NULL;
+    vector.deserializeFromJson = (VECTOR_DESERIALIZE_FROM_JSON)individualEnrollmentView_deserializeFromJson;
+    vector.getId = (VECTOR_GET_ID)individualEnrollmentView_getRegistrationId;
+    vector.getEtag = (VECTOR_GET_ETAG)individualEnrollmentView_getEtag;
+    vector.destroy = (VECTOR_DESTROY)individualEnrollmentView_destroy;
+
+    return vector;
+}
+
 static HANDLE_FUNCTION_VECTOR getVector_enrollmentGroup()
 {
     HANDLE_FUNCTION_VECTOR vector;
@@ -219,7 +273,69 @@ static void on_http_reply_recv(void* callback_ctx, HTTP_CALLBACK_REASON request_
     }
 }
 
-static HTTP_HEADERS_HANDLE construct_http_headers(const PROV_SERVICE_CLIENT* prov_client, const char* etag, HTTP_CLIENT_REQUEST_TYPE request)
+static void on_bulk_import_connected(void* callback_ctx, HTTP_CALLBACK_REASON connect_result)
+{
+    if (callback_ctx != NULL)
+    {
+        BULK_IMPORT_CONNECTION* connection = (BULK_IMPORT_CONNECTION*)callback_ctx;
+        if (connect_result == HTTP_CALLBACK_REASON_OK)
+        {
+            connection->http_state = HTTP_STATE_CONNECTED;
+        }
+        else
+        {
+            connection->http_state = HTTP_STATE_ERROR;
+        }
+    }
+}
+
+static void on_bulk_import_error(void* callback_ctx, HTTP_CALLBACK_REASON error_result)
+{
+    LogError("Failure encountered in http %d", error_result);
+    if (callback_ctx != NULL)
+    {
+        BULK_IMPORT_CONNECTION* connection = (BULK_IMPORT_CONNECTION*)callback_ctx;
+        connection->http_state = HTTP_STATE_ERROR;
+    }
+}
+
+static void on_bulk_import_reply_recv(void* callback_ctx, HTTP_CALLBACK_REASON request_result, const unsigned char* content, size_t content_len, unsigned int status_code, HTTP_HEADERS_HANDLE responseHeadersHandle)
+{
+    (void)responseHeadersHandle;
+    if (callback_ctx != NULL)
+    {
+        BULK_IMPORT_CONNECTION* connection = (BULK_IMPORT_CONNECTION*)callback_ctx;
+
+        if (content != NULL)
+        {
+            if ((connection->response = malloc(content_len + 1)) == NULL)
+            {
+                LogError("Allocating response failed");
+            }
+            else
+            {
+                memcpy(connection->response, content, content_len);
+                connection->response[content_len] = '\0';
+            }
+        }
+
+        if (request_result == HTTP_CALLBACK_REASON_OK && status_code >= 200 && status_code <= 299)
+        {
+            connection->http_state = HTTP_STATE_REQUEST_RECV;
+        }
+        else
+        {
+            LogError("Bulk import request failed with status %u", status_code);
+            connection->http_state = HTTP_STATE_ERROR;
+        }
+    }
+    else
+    {
+        LogError("Invalid callback context");
+    }
+}
+
+static HTTP_HEADERS_HANDLE construct_http_headers(PROV_SERVICE_CLIENT* prov_client, const char* etag, HTTP_CLIENT_REQUEST_TYPE request)
 {
     HTTP_HEADERS_HANDLE result;
     if ((result = HTTPHeaders_Alloc()) == NULL)
@@ -230,8 +346,18 @@ static HTTP_HEADERS_HANDLE construct_http_headers(const PROV_SERVICE_CLIENT* pro
     {
         size_t secSinceEpoch = (size_t)(difftime(get_time(NULL), EPOCH_TIME_T_VALUE) + 0);
         size_t expiryTime = secSinceEpoch + SAS_TOKEN_DEFAULT_LIFETIME;
+        STRING_HANDLE sas_token;
+
+        //a kept alive client reuses its token until it gets close to expiring
+        if (prov_client->sas_token != NULL && secSinceEpoch + SAS_TOKEN_REFRESH_MARGIN < prov_client->sas_token_expiry)
+        {
+            sas_token = prov_client->sas_token;
+        }
+        else
+        {
+            sas_token = SASToken_CreateString(prov_client->access_key, prov_client->provisioning_service_uri, prov_client->key_name, expiryTime);
+        }
 
-        STRING_HANDLE sas_token = SASToken_CreateString(prov_client->access_key, prov_client->provisioning_service_uri, prov_client->key_name, expiryTime);
         if (sas_token == NULL)
         {
             HTTPHeaders_Free(result);
@@ -249,7 +375,21 @@ static HTTP_HEADERS_HANDLE construct_http_headers(const PROV_SERVICE_CLIENT* pro
                 HTTPHeaders_Free(result);
                 result = NULL;
             }
-            STRING_delete(sas_token);
+
+            if (sas_token == prov_client->sas_token)
+            {
+                //still cached
+            }
+            else if (prov_client->keep_alive)
+            {
+                STRING_delete(prov_client->sas_token);
+                prov_client->sas_token = sas_token;
+                prov_client->sas_token_expiry = expiryTime;
+            }
+            else
+            {
+                STRING_delete(sas_token);
+            }
         }
     }
     return result;
@@ -359,7 +499,7 @@ static int get_response_headers(PROV_SERVICE_CLIENT* prov_client, char** cont_to
     return result;
 }
 
-static HTTP_CLIENT_HANDLE connect_to_service(PROV_SERVICE_CLIENT* prov_client)
+static HTTP_CLIENT_HANDLE connect_to_service(PROV_SERVICE_CLIENT* prov_client, ON_HTTP_ERROR_CALLBACK on_error, ON_HTTP_OPEN_COMPLETE_CALLBACK on_connected, void* callback_ctx)
 {
     HTTP_CLIENT_HANDLE result;
 
@@ -391,7 +531,7 @@ static HTTP_CLIENT_HANDLE connect_to_service(PROV_SERVICE_CLIENT* prov_client)
         LogError("platform default tlsio is NULL");
         result = NULL;
     }
-    else if ((result = uhttp_client_create(interface_desc, &tls_io_config, on_http_error, prov_client)) == NULL)
+    else if ((result = uhttp_client_create(interface_desc, &tls_io_config, on_error, callback_ctx)) == NULL)
     {
         LogError("Failed creating http object");
     }
@@ -407,7 +547,7 @@ static HTTP_CLIENT_HANDLE connect_to_service(PROV_SERVICE_CLIENT* prov_client)
         uhttp_client_destroy(result);
         result = NULL;
     }
-    else if (uhttp_client_open(result, prov_client->provisioning_service_uri, DEFAULT_HTTPS_PORT, on_http_connected, prov_client) != HTTP_CLIENT_OK)
+    else if (uhttp_client_open(result, prov_client->provisioning_service_uri, DEFAULT_HTTPS_PORT, on_connected, callback_ctx) != HTTP_CLIENT_OK)
     {
         LogError("Failed opening http url %s", prov_client->provisioning_service_uri);
         uhttp_client_destroy(result);
@@ -416,11 +556,65 @@ static HTTP_CLIENT_HANDLE connect_to_service(PROV_SERVICE_CLIENT* prov_client)
     return result;
 }
 
+static void disconnect_from_service(PROV_SERVICE_CLIENT* prov_client)
+{
+    if (prov_client->http_client != NULL)
+    {
+        uhttp_client_close(prov_client->http_client, NULL, NULL);
+        uhttp_client_destroy(prov_client->http_client);
+        prov_client->http_client = NULL;
+    }
+}
+
+static void release_session(PROV_SERVICE_CLIENT* prov_client)
+{
+    disconnect_from_service(prov_client);
+    if (prov_client->sas_token != NULL)
+    {
+        STRING_delete(prov_client->sas_token);
+        prov_client->sas_token = NULL;
+    }
+}
+
+static int execute_rest_request(PROV_SERVICE_CLIENT* prov_client, HTTP_CLIENT_HANDLE http_client, HTTP_CLIENT_REQUEST_TYPE operation, const char* registration_path, HTTP_HEADERS_HANDLE request_headers, const char* content, size_t content_len)
+{
+    int result = 0;
+    do
+    {
+        uhttp_client_dowork(http_client);
+        if (prov_client->http_state == HTTP_STATE_CONNECTED)
+        {
+            if (uhttp_client_execute_request(http_client, operation, registration_path, request_headers, (unsigned char*)content, content_len, on_http_reply_recv, prov_client) != HTTP_CLIENT_OK)
+            {
+                LogError("Failure executing http request");
+                prov_client->http_state = HTTP_STATE_ERROR;
+                result = __FAILURE__;
+            }
+            else
+            {
+                prov_client->http_state = HTTP_STATE_REQUEST_SENT;
+            }
+        }
+        else if (prov_client->http_state == HTTP_STATE_REQUEST_RECV)
+        {
+            prov_client->http_state = HTTP_STATE_COMPLETE;
+        }
+        else if (prov_client->http_state == HTTP_STATE_ERROR)
+        {
+            result = __FAILURE__;
+            LogError("HTTP error");
+        }
+    } while (prov_client->http_state != HTTP_STATE_COMPLETE && prov_client->http_state != HTTP_STATE_ERROR);
+
+    return result;
+}
+
 static int rest_call(PROVISIONING_SERVICE_CLIENT_HANDLE prov_client, HTTP_CLIENT_REQUEST_TYPE operation, const char* registration_path, HTTP_HEADERS_HANDLE request_headers, const char* content)
 {
     int result;
     size_t content_len;
     HTTP_CLIENT_HANDLE http_client;
+    bool is_kept_alive;
 
     if (content == NULL)
     {
@@ -431,7 +625,19 @@ static int rest_call(PROVISIONING_SERVICE_CLIENT_HANDLE prov_client, HTTP_CLIENT
         content_len = strlen(content);
     }
 
-    http_client = connect_to_service(prov_client);
+    if (prov_client->http_client != NULL)
+    {
+        http_client = prov_client->http_client;
+        prov_client->http_client = NULL;
+        prov_client->http_state = HTTP_STATE_CONNECTED;
+        is_kept_alive = true;
+    }
+    else
+    {
+        http_client = connect_to_service(prov_client, on_http_error, on_http_connected, prov_client);
+        is_kept_alive = false;
+    }
+
     if (http_client == NULL)
     {
         LogError("Failed connecting to service");
@@ -439,36 +645,37 @@ static int rest_call(PROVISIONING_SERVICE_CLIENT_HANDLE prov_client, HTTP_CLIENT
     }
     else
     {
-        result = 0;
-        do
+        result = execute_rest_request(prov_client, http_client, operation, registration_path, request_headers, content, content_len);
+
+        //the service drops connections it considers idle, that only shows once the kept connection is used again
+        if (result != 0 && is_kept_alive && prov_client->response_headers == NULL)
         {
-            uhttp_client_dowork(http_client);
-            if (prov_client->http_state == HTTP_STATE_CONNECTED)
+            LogError("Kept alive connection failed, reconnecting");
+            uhttp_client_close(http_client, NULL, NULL);
+            uhttp_client_destroy(http_client);
+            prov_client->http_state = HTTP_STATE_DISCONNECTED;
+            if ((http_client = connect_to_service(prov_client, on_http_error, on_http_connected, prov_client)) == NULL)
             {
-                if (uhttp_client_execute_request(http_client, operation, registration_path, request_headers, (unsigned char*)content, content_len, on_http_reply_recv, prov_client) != HTTP_CLIENT_OK)
-                {
-                    LogError("Failure executing http request");
-                    prov_client->http_state = HTTP_STATE_ERROR;
-                    result = __FAILURE__;
-                }
-                else
-                {
-                    prov_client->http_state = HTTP_STATE_REQUEST_SENT;
-                }
+                LogError("Failed reconnecting to service");
             }
-            else if (prov_client->http_state == HTTP_STATE_REQUEST_RECV)
+            else
             {
-                prov_client->http_state = HTTP_STATE_COMPLETE;
+                result = execute_rest_request(prov_client, http_client, operation, registration_path, request_headers, content, content_len);
             }
-            else if (prov_client->http_state == HTTP_STATE_ERROR)
+        }
+
+        if (http_client != NULL)
+        {
+            if (result == 0 && prov_client->keep_alive)
             {
-                result = __FAILURE__;
-                LogError("HTTP error");
+                prov_client->http_client = http_client;
             }
-        } while (prov_client->http_state != HTTP_STATE_COMPLETE && prov_client->http_state != HTTP_STATE_ERROR);
-
-        uhttp_client_close(http_client, NULL, NULL);
-        uhttp_client_destroy(http_client);
+            else
+            {
+                uhttp_client_close(http_client, NULL, NULL);
+                uhttp_client_destroy(http_client);
+            }
+        }
     }
 
     prov_client->http_state = HTTP_STATE_DISCONNECTED;
@@ -739,6 +946,472 @@ static int prov_sc_run_bulk_operation(PROVISIONING_SERVICE_CLIENT_HANDLE prov_cl
     return result;
 }
 
+static void clear_bulk_import_batch(BULK_IMPORT_CONNECTION* connection)
+{
+    free(connection->content);
+    connection->content = NULL;
+    HTTPHeaders_Free(connection->request_headers);
+    connection->request_headers = NULL;
+    free(connection->response);
+    connection->response = NULL;
+    connection->batch_size = 0;
+}
+
+static void close_bulk_import_connection(BULK_IMPORT_CONNECTION* connection)
+{
+    clear_bulk_import_batch(connection);
+    uhttp_client_close(connection->http_client, NULL, NULL);
+    uhttp_client_destroy(connection->http_client);
+    connection->http_client = NULL;
+    connection->http_state = HTTP_STATE_DISCONNECTED;
+}
+
+static int send_bulk_import_batch(PROVISIONING_SERVICE_CLIENT_HANDLE prov_client, BULK_IMPORT_CONNECTION* connection, const PROVISIONING_BULK_OPERATION* bulk_op, size_t batch_start, size_t batch_size, const char* registration_path)
+{
+    int result;
+    PROVISIONING_BULK_OPERATION batch_op = *bulk_op;
+
+    batch_op.enrollments.ie = bulk_op->enrollments.ie + batch_start;
+    batch_op.num_enrollments = batch_size;
+
+    if ((connection->content = bulkOperation_serializeToJson(&batch_op)) == NULL)
+    {
+        LogError("Failure serializing bulk operation");
+        result = __FAILURE__;
+    }
+    // Built per batch so a long import never sends an expired SAS token
+    else if ((connection->request_headers = construct_http_headers(prov_client, NULL, HTTP_CLIENT_REQUEST_POST)) == NULL)
+    {
+        LogError("Failure constructing http headers");
+        result = __FAILURE__;
+    }
+    else if (uhttp_client_execute_request(connection->http_client, HTTP_CLIENT_REQUEST_POST, registration_path, connection->request_headers,
+        (const unsigned char*)connection->content, strlen(connection->content), on_bulk_import_reply_recv, connection) != HTTP_CLIENT_OK)
+    {
+        LogError("Failure executing http request");
+        result = __FAILURE__;
+    }
+    else
+    {
+        connection->batch_start = batch_start;
+        connection->batch_size = batch_size;
+        connection->http_state = HTTP_STATE_REQUEST_SENT;
+        result = 0;
+    }
+
+    if (result != 0)
+    {
+        clear_bulk_import_batch(connection);
+    }
+    return result;
+}
+
+static int process_bulk_import_reply(BULK_IMPORT_CONNECTION* connection, PROV_SC_BULK_IMPORT_ERROR_CALLBACK on_error, void* user_context, size_t* num_failed)
+{
+    int result;
+    PROVISIONING_BULK_OPERATION_RESULT* bulk_res;
+
+    if ((bulk_res = bulkOperationResult_deserializeFromJson(connection->response)) == NULL)
+    {
+        LogError("Failure deserializing bulk operation result for enrollments %lu to %lu",
+            (unsigned long)connection->batch_start, (unsigned long)(connection->batch_start + connection->batch_size - 1));
+        result = __FAILURE__;
+    }
+    else
+    {
+        size_t index;
+        for (index = 0; index < bulk_res->num_errors; index++)
+        {
+            if (on_error != NULL)
+            {
+                on_error(bulk_res->errors[index], user_context);
+            }
+        }
+        *num_failed += bulk_res->num_errors;
+        bulkOperationResult_free(bulk_res);
+        result = 0;
+    }
+    return result;
+}
+
+static int prov_sc_run_bulk_import(PROVISIONING_SERVICE_CLIENT_HANDLE prov_client, PROVISIONING_BULK_OPERATION* bulk_op, const PROVISIONING_BULK_IMPORT_OPTIONS* options, size_t* num_failed, const char* path_format)
+{
+    int result;
+
+    if (prov_client == NULL || bulk_op == NULL || num_failed == NULL)
+    {
+        LogError("Invalid parameter specified prov_client: %p, bulk_op: %p, num_failed: %p", prov_client, bulk_op, num_failed);
+        result = __FAILURE__;
+    }
+    else if (bulk_op->version != PROVISIONING_BULK_OPERATION_VERSION_1)
+    {
+        LogError("Invalid Bulk Op Version #");
+        result = __FAILURE__;
+    }
+    else if (bulk_op->num_enrollments > 0 && bulk_op->enrollments.ie == NULL)
+    {
+        LogError("Invalid Bulk Op enrollments");
+        result = __FAILURE__;
+    }
+    else
+    {
+        size_t batch_size = (options != NULL && options->batch_size != 0) ? options->batch_size : PROVISIONING_BULK_IMPORT_MAX_BATCH_SIZE;
+        size_t num_connections = (options != NULL && options->max_concurrent_requests != 0) ? options->max_concurrent_requests : BULK_IMPORT_DEFAULT_CONCURRENCY;
+        size_t num_batches = (bulk_op->num_enrollments + batch_size - 1) / batch_size;
+        BULK_IMPORT_CONNECTION* connections;
+        STRING_HANDLE registration_path;
+
+        *num_failed = 0;
+        if (num_connections > num_batches)
+        {
+            num_connections = num_batches;
+        }
+
+        if (num_batches == 0)
+        {
+            result = 0;
+        }
+        else if ((registration_path = create_registration_path(path_format, NULL)) == NULL)
+        {
+            LogError("Failed to construct a registration path");
+            result = __FAILURE__;
+        }
+        else
+        {
+            if ((connections = (BULK_IMPORT_CONNECTION*)malloc(num_connections * sizeof(BULK_IMPORT_CONNECTION))) == NULL)
+            {
+                LogError("Failure allocating bulk import connections");
+                result = __FAILURE__;
+            }
+            else
+            {
+                size_t index;
+                size_t next_enrollment = 0;
+                size_t open_connections = 0;
+
+                memset(connections, 0, num_connections * sizeof(BULK_IMPORT_CONNECTION));
+                result = 0;
+                for (index = 0; index < num_connections; index++)
+                {
+                    if ((connections[index].http_client = connect_to_service(prov_client, on_bulk_import_error, on_bulk_import_connected, &connections[index])) == NULL)
+                    {
+                        LogError("Failed connecting to service");
+                        result = __FAILURE__;
+                        break;
+                    }
+                    connections[index].http_state = HTTP_STATE_CONNECTING;
+                    open_connections++;
+                }
+
+                // Every connection keeps one batch in flight, a connection is reused until no batch is left for it.
+                // Once a batch fails no new ones go out, the ones in flight still complete and report their errors.
+                while (open_connections > 0)
+                {
+                    for (index = 0; index < num_connections; index++)
+                    {
+                        BULK_IMPORT_CONNECTION* connection = &connections[index];
+                        if (connection->http_client == NULL)
+                        {
+                            continue;
+                        }
+
+                        uhttp_client_dowork(connection->http_client);
+                        if (connection->http_state == HTTP_STATE_REQUEST_RECV)
+                        {
+                            if (process_bulk_import_reply(connection, options != NULL ? options->on_error : NULL, options != NULL ? options->user_context : NULL, num_failed) != 0)
+                            {
+                                result = __FAILURE__;
+                            }
+                            clear_bulk_import_batch(connection);
+                            connection->http_state = HTTP_STATE_CONNECTED;
+                        }
+
+                        if (connection->http_state == HTTP_STATE_CONNECTED)
+                        {
+                            if (result != 0 || next_enrollment >= bulk_op->num_enrollments)
+                            {
+                                close_bulk_import_connection(connection);
+                                open_connections--;
+                            }
+                            else
+                            {
+                                size_t current_size = bulk_op->num_enrollments - next_enrollment;
+                                if (current_size > batch_size)
+                                {
+                                    current_size = batch_size;
+                                }
+
+                                if (send_bulk_import_batch(prov_client, connection, bulk_op, next_enrollment, current_size, STRING_c_str(registration_path)) != 0)
+                                {
+                                    LogError("Failure sending bulk import batch");
+                                    result = __FAILURE__;
+                                    close_bulk_import_connection(connection);
+                                    open_connections--;
+                                }
+                                else
+                                {
+                                    next_enrollment += current_size;
+                                }
+                            }
+                        }
+                        else if (connection->http_state == HTTP_STATE_ERROR)
+                        {
+                            if (connection->batch_size > 0)
+                            {
+                                LogError("Bulk import failed for enrollments %lu to %lu", (unsigned long)connection->batch_start,
+                                    (unsigned long)(connection->batch_start + connection->batch_size - 1));
+                            }
+                            result = __FAILURE__;
+                            close_bulk_import_connection(connection);
+                            open_connections--;
+                        }
+                    }
+                }
+
+                for (index = 0; index < num_connections; index++)
+                {
+                    if (connections[index].http_client != NULL)
+                    {
+                        close_bulk_import_connection(&connections[index]);
+                    }
+                }
+                free(connections);
+            }
+            STRING_delete(registration_path);
+        }
+    }
+
+    return result;
+}
+
+static void on_query_iterator_connected(void* callback_ctx, HTTP_CALLBACK_REASON connect_result)
+{
+    if (callback_ctx != NULL)
+    {
+        PROVISIONING_QUERY_ITERATOR* iterator = (PROVISIONING_QUERY_ITERATOR*)callback_ctx;
+        if (connect_result == HTTP_CALLBACK_REASON_OK)
+        {
+            iterator->http_state = HTTP_STATE_CONNECTED;
+        }
+        else
+        {
+            iterator->http_state = HTTP_STATE_ERROR;
+        }
+    }
+}
+
+static void on_query_iterator_error(void* callback_ctx, HTTP_CALLBACK_REASON error_result)
+{
+    LogError("Failure encountered in http %d", error_result);
+    if (callback_ctx != NULL)
+    {
+        PROVISIONING_QUERY_ITERATOR* iterator = (PROVISIONING_QUERY_ITERATOR*)callback_ctx;
+        iterator->http_state = HTTP_STATE_ERROR;
+    }
+}
+
+static void on_query_iterator_reply_recv(void* callback_ctx, HTTP_CALLBACK_REASON request_result, const unsigned char* content, size_t content_len, unsigned int status_code, HTTP_HEADERS_HANDLE responseHeadersHandle)
+{
+    if (callback_ctx != NULL)
+    {
+        PROVISIONING_QUERY_ITERATOR* iterator = (PROVISIONING_QUERY_ITERATOR*)callback_ctx;
+
+        if (responseHeadersHandle != NULL)
+        {
+            if ((iterator->response_headers = HTTPHeaders_Clone(responseHeadersHandle)) == NULL)
+            {
+                LogError("Copying response headers failed");
+            }
+        }
+
+        if (content != NULL)
+        {
+            if ((iterator->response = malloc(content_len + 1)) == NULL)
+            {
+                LogError("Allocating response failed");
+            }
+            else
+            {
+                memcpy(iterator->response, content, content_len);
+                iterator->response[content_len] = '\0';
+            }
+        }
+
+        if (request_result == HTTP_CALLBACK_REASON_OK && status_code >= 200 && status_code <= 299)
+        {
+            iterator->http_state = HTTP_STATE_REQUEST_RECV;
+        }
+        else
+        {
+            LogError("Query request failed with status %u", status_code);
+            iterator->http_state = HTTP_STATE_ERROR;
+        }
+    }
+    else
+    {
+        LogError("Invalid callback context");
+    }
+}
+
+static void clear_query_iterator_reply(PROVISIONING_QUERY_ITERATOR* iterator)
+{
+    free(iterator->response);
+    iterator->response = NULL;
+    HTTPHeaders_Free(iterator->response_headers);
+    iterator->response_headers = NULL;
+    HTTPHeaders_Free(iterator->request_headers);
+    iterator->request_headers = NULL;
+}
+
+static void send_query_iterator_request(PROVISIONING_QUERY_ITERATOR* iterator)
+{
+    size_t content_len = (iterator->content == NULL) ? 0 : strlen(iterator->content);
+
+    if ((iterator->request_headers = construct_http_headers(iterator->prov_client, NULL, HTTP_CLIENT_REQUEST_POST)) == NULL)
+    {
+        LogError("Failure constructing http headers");
+        iterator->http_state = HTTP_STATE_ERROR;
+    }
+    else if (add_query_headers(iterator->request_headers, iterator->page_size, iterator->cont_token) != 0)
+    {
+        LogError("Failure adding query headers");
+        iterator->http_state = HTTP_STATE_ERROR;
+    }
+    else if (uhttp_client_execute_request(iterator->http_client, HTTP_CLIENT_REQUEST_POST, STRING_c_str(iterator->registration_path), iterator->request_headers,
+        (const unsigned char*)iterator->content, content_len, on_query_iterator_reply_recv, iterator) != HTTP_CLIENT_OK)
+    {
+        LogError("Failure executing http request");
+        iterator->http_state = HTTP_STATE_ERROR;
+    }
+    else
+    {
+        iterator->http_state = HTTP_STATE_REQUEST_SENT;
+    }
+}
+
+static void query_iterator_dowork(PROVISIONING_QUERY_ITERATOR* iterator)
+{
+    uhttp_client_dowork(iterator->http_client);
+    if (iterator->http_state == HTTP_STATE_CONNECTED)
+    {
+        send_query_iterator_request(iterator);
+    }
+}
+
+static int load_query_iterator_page(PROVISIONING_QUERY_ITERATOR* iterator)
+{
+    int result;
+    char* new_cont_token = NULL;
+    PROVISIONING_QUERY_TYPE type;
+
+    if (iterator->response_headers == NULL)
+    {
+        LogError("Unable to retrieve headers");
+        result = __FAILURE__;
+    }
+    else
+    {
+        const char* cont_token = HTTPHeaders_FindHeaderValue(iterator->response_headers, HEADER_KEY_CONTINUATION);
+        const char* resp_type = HTTPHeaders_FindHeaderValue(iterator->response_headers, HEADER_KEY_ITEM_TYPE);
+
+        if (cont_token != NULL && mallocAndStrcpy_s(&new_cont_token, cont_token) != 0)
+        {
+            LogError("Failed to copy continuation token");
+            result = __FAILURE__;
+        }
+        else if ((type = queryType_stringToEnum(resp_type)) == QUERY_TYPE_INVALID)
+        {
+            LogError("Failure to parse response type");
+            free(new_cont_token);
+            result = __FAILURE__;
+        }
+        else if ((iterator->page = queryPage_deserializeFromJson(iterator->response, type)) == NULL)
+        {
+            LogError("Failure deserializing query response");
+            free(new_cont_token);
+            result = __FAILURE__;
+        }
+        else
+        {
+            free(iterator->cont_token);
+            iterator->cont_token = new_cont_token;
+            iterator->page_index = 0;
+            result = 0;
+        }
+    }
+    clear_query_iterator_reply(iterator);
+
+    if (result != 0)
+    {
+        iterator->http_state = HTTP_STATE_ERROR;
+    }
+    else if (iterator->cont_token == NULL)
+    {
+        iterator->http_state = HTTP_STATE_COMPLETE;
+    }
+    else
+    {
+        //the next page goes out right away and arrives while the caller works through this one
+        iterator->http_state = HTTP_STATE_CONNECTED;
+    }
+    return result;
+}
+
+static PROVISIONING_QUERY_ITERATOR_HANDLE prov_sc_create_query_iterator(PROVISIONING_SERVICE_CLIENT_HANDLE prov_client, PROVISIONING_QUERY_SPECIFICATION* query_spec, const char* path_format)
+{
+    PROVISIONING_QUERY_ITERATOR* result;
+
+    if (prov_client == NULL)
+    {
+        LogError("Invalid Provisioning Client Handle");
+        result = NULL;
+    }
+    else if (query_spec == NULL || query_spec->version != PROVISIONING_QUERY_SPECIFICATION_VERSION_1)
+    {
+        LogError("Invalid Query details");
+        result = NULL;
+    }
+    else if ((result = malloc(sizeof(PROVISIONING_QUERY_ITERATOR))) == NULL)
+    {
+        LogError("Allocating query iterator failed");
+    }
+    else
+    {
+        memset(result, 0, sizeof(PROVISIONING_QUERY_ITERATOR));
+        result->prov_client = prov_client;
+        result->page_size = query_spec->page_size;
+
+        //do not serialize the query specification if there is no query_string (i.e. DRS query)
+        if ((query_spec->query_string != NULL) && ((result->content = querySpecification_serializeToJson(query_spec)) == NULL))
+        {
+            LogError("Failure serializing query specification");
+            free(result);
+            result = NULL;
+        }
+        else if ((result->registration_path = create_registration_path(path_format, query_spec->registration_id)) == NULL)
+        {
+            LogError("Failed to construct a registration path");
+            free(result->content);
+            free(result);
+            result = NULL;
+        }
+        else if ((result->http_client = connect_to_service(prov_client, on_query_iterator_error, on_query_iterator_connected, result)) == NULL)
+        {
+            LogError("Failed connecting to service");
+            STRING_delete(result->registration_path);
+            free(result->content);
+            free(result);
+            result = NULL;
+        }
+        else
+        {
+            result->http_state = HTTP_STATE_CONNECTING;
+        }
+    }
+
+    return result;
+}
+
 static int prov_sc_query_records(PROVISIONING_SERVICE_CLIENT_HANDLE prov_client, PROVISIONING_QUERY_SPECIFICATION* query_spec, char** cont_token_ptr, PROVISIONING_QUERY_RESPONSE** query_res_ptr, const char* path_format)
 {
     int result = 0;
@@ -850,6 +1523,7 @@ void prov_sc_destroy(PROVISIONING_SERVICE_CLIENT_HANDLE prov_client)
         free(prov_client->response);
         HTTPHeaders_Free(prov_client->response_headers);
         free(prov_client->certificate);
+        release_session(prov_client);
         free(prov_client);
     }
 }
@@ -949,6 +1623,20 @@ void prov_sc_set_trace(PROVISIONING_SERVICE_CLIENT_HANDLE prov_client, TRACING_S
     if (prov_client != NULL)
     {
         prov_client->tracing = status;
+        //takes effect on the next connection
+        disconnect_from_service(prov_client);
+    }
+}
+
+void prov_sc_set_keep_alive(PROVISIONING_SERVICE_CLIENT_HANDLE prov_client, bool keep_alive)
+{
+    if (prov_client != NULL)
+    {
+        prov_client->keep_alive = keep_alive;
+        if (!keep_alive)
+        {
+            release_session(prov_client);
+        }
     }
 }
 
@@ -965,12 +1653,17 @@ int prov_sc_set_certificate(PROVISIONING_SERVICE_CLIENT_HANDLE prov_client, cons
     {
         free(prov_client->certificate);
         prov_client->certificate = NULL;
+        disconnect_from_service(prov_client);
     }
     else if (mallocAndStrcpy_overwrite(&prov_client->certificate, (char*)certificate) != 0)
     {
         LogError("Failed allocating memory for certificate");
         result = __FAILURE__;
     }
+    else
+    {
+        disconnect_from_service(prov_client);
+    }
 
     return result;
 }
@@ -1005,6 +1698,7 @@ int prov_sc_set_proxy(PROVISIONING_SERVICE_CLIENT_HANDLE prov_client, HTTP_PROXY
         else
         {
             prov_client->proxy_options = proxy_options;
+            disconnect_from_service(prov_client);
         }
     }
 
@@ -1031,16 +1725,31 @@ int prov_sc_get_individual_enrollment(PROVISIONING_SERVICE_CLIENT_HANDLE prov_cl
     return prov_sc_get_record(prov_client, reg_id, (void**)enrollment_ptr, getVector_individualEnrollment(), INDV_ENROLL_PROVISION_PATH_FMT);
 }
 
+int prov_sc_get_individual_enrollment_view(PROVISIONING_SERVICE_CLIENT_HANDLE prov_client, const char* reg_id, INDIVIDUAL_ENROLLMENT_VIEW_HANDLE* view_ptr)
+{
+    return prov_sc_get_record(prov_client, reg_id, (void**)view_ptr, getVector_individualEnrollmentView(), INDV_ENROLL_PROVISION_PATH_FMT);
+}
+
 int prov_sc_query_individual_enrollment(PROVISIONING_SERVICE_CLIENT_HANDLE prov_client, PROVISIONING_QUERY_SPECIFICATION* query_spec, char** cont_token_ptr, PROVISIONING_QUERY_RESPONSE** query_resp_ptr)
 {
     return prov_sc_query_records(prov_client, query_spec, cont_token_ptr, query_resp_ptr, INDV_ENROLL_QUERY_PATH_FMT);
 }
 
+PROVISIONING_QUERY_ITERATOR_HANDLE prov_sc_create_individual_enrollment_query_iterator(PROVISIONING_SERVICE_CLIENT_HANDLE prov_client, PROVISIONING_QUERY_SPECIFICATION* query_spec)
+{
+    return prov_sc_create_query_iterator(prov_client, query_spec, INDV_ENROLL_QUERY_PATH_FMT);
+}
+
 int prov_sc_run_individual_enrollment_bulk_operation(PROVISIONING_SERVICE_CLIENT_HANDLE prov_client, PROVISIONING_BULK_OPERATION* bulk_op, PROVISIONING_BULK_OPERATION_RESULT** bulk_res_ptr)
 {
     return prov_sc_run_bulk_operation(prov_client, bulk_op, bulk_res_ptr, INDV_ENROLL_BULK_PATH_FMT);
 }
 
+int prov_sc_import_individual_enrollments(PROVISIONING_SERVICE_CLIENT_HANDLE prov_client, PROVISIONING_BULK_OPERATION* bulk_op, const PROVISIONING_BULK_IMPORT_OPTIONS* options, size_t* num_failed)
+{
+    return prov_sc_run_bulk_import(prov_client, bulk_op, options, num_failed, INDV_ENROLL_BULK_PATH_FMT);
+}
+
 int prov_sc_delete_device_registration_state(PROVISIONING_SERVICE_CLIENT_HANDLE prov_client, DEVICE_REGISTRATION_STATE_HANDLE reg_state)
 {
     return prov_sc_delete_record_by_param(prov_client, deviceRegistrationState_getRegistrationId(reg_state), deviceRegistrationState_getEtag(reg_state), REG_STATE_PROVISION_PATH_FMT);
@@ -1061,6 +1770,11 @@ int prov_sc_query_device_registration_state(PROVISIONING_SERVICE_CLIENT_HANDLE p
     return prov_sc_query_records(prov_client, query_spec, cont_token_ptr, query_resp_ptr, REG_STATE_QUERY_PATH_FMT);
 }
 
+PROVISIONING_QUERY_ITERATOR_HANDLE prov_sc_create_device_registration_state_query_iterator(PROVISIONING_SERVICE_CLIENT_HANDLE prov_client, PROVISIONING_QUERY_SPECIFICATION* query_spec)
+{
+    return prov_sc_create_query_iterator(prov_client, query_spec, REG_STATE_QUERY_PATH_FMT);
+}
+
 int prov_sc_create_or_update_enrollment_group(PROVISIONING_SERVICE_CLIENT_HANDLE prov_client, ENROLLMENT_GROUP_HANDLE* enrollment_ptr)
 {
     return prov_sc_create_or_update_record(prov_client, (void**)enrollment_ptr, getVector_enrollmentGroup(), ENROLL_GROUP_PROVISION_PATH_FMT);
@@ -1084,4 +1798,91 @@ int prov_sc_get_enrollment_group(PROVISIONING_SERVICE_CLIENT_HANDLE prov_client,
 int prov_sc_query_enrollment_group(PROVISIONING_SERVICE_CLIENT_HANDLE prov_client, PROVISIONING_QUERY_SPECIFICATION* query_spec, char** cont_token_ptr, PROVISIONING_QUERY_RESPONSE** query_resp_ptr)
 {
     return prov_sc_query_records(prov_client, query_spec, cont_token_ptr, query_resp_ptr, ENROLL_GROUP_QUERY_PATH_FMT);
+}
+
+PROVISIONING_QUERY_ITERATOR_HANDLE prov_sc_create_enrollment_group_query_iterator(PROVISIONING_SERVICE_CLIENT_HANDLE prov_client, PROVISIONING_QUERY_SPECIFICATION* query_spec)
+{
+    return prov_sc_create_query_iterator(prov_client, query_spec, ENROLL_GROUP_QUERY_PATH_FMT);
+}
+
+int prov_sc_query_iterator_next(PROVISIONING_QUERY_ITERATOR_HANDLE iterator, PROVISIONING_QUERY_RECORD* record)
+{
+    int result;
+
+    if (iterator == NULL || record == NULL)
+    {
+        LogError("Invalid parameter specified iterator: %p, record: %p", iterator, record);
+        result = __FAILURE__;
+    }
+    else
+    {
+        //only the record handed out last is kept alive
+        queryRecord_free(&iterator->record);
+
+        result = 0;
+        while (result == 0 && (iterator->page == NULL || iterator->page_index >= queryPage_getRecordCount(iterator->page)))
+        {
+            queryPage_free(iterator->page);
+            iterator->page = NULL;
+
+            if (iterator->http_state == HTTP_STATE_COMPLETE)
+            {
+                break;
+            }
+            else if (iterator->http_state == HTTP_STATE_ERROR)
+            {
+                LogError("Failure retrieving query page");
+                result = __FAILURE__;
+            }
+            else if (iterator->http_state == HTTP_STATE_REQUEST_RECV)
+            {
+                result = load_query_iterator_page(iterator);
+            }
+            else
+            {
+                //nothing left to hand out, wait for the page in flight
+                query_iterator_dowork(iterator);
+            }
+        }
+
+        if (result != 0 || iterator->page == NULL)
+        {
+            //end of the query, or nothing can be handed out
+            record->record.ie = NULL;
+            record->record_type = QUERY_TYPE_INVALID;
+        }
+        else if (queryPage_getRecord(iterator->page, iterator->page_index, &iterator->record) != 0)
+        {
+            LogError("Failure deserializing query record");
+            record->record.ie = NULL;
+            record->record_type = QUERY_TYPE_INVALID;
+            result = __FAILURE__;
+        }
+        else
+        {
+            iterator->page_index++;
+            *record = iterator->record;
+
+            //keep the next page moving while the caller works on this record
+            query_iterator_dowork(iterator);
+        }
+    }
+
+    return result;
+}
+
+void prov_sc_query_iterator_destroy(PROVISIONING_QUERY_ITERATOR_HANDLE iterator)
+{
+    if (iterator != NULL)
+    {
+        queryRecord_free(&iterator->record);
+        queryPage_free(iterator->page);
+        clear_query_iterator_reply(iterator);
+        uhttp_client_close(iterator->http_client, NULL, NULL);
+        uhttp_client_destroy(iterator->http_client);
+        free(iterator->cont_token);
+        free(iterator->content);
+        STRING_delete(iterator->registration_path);
+        free(iterator);
+    }
 }
\ No newline at end of file
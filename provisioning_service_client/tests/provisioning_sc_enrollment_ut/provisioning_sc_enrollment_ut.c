@@ -299,6 +299,13 @@ static ENROLLMENT_GROUP_HANDLE get_eg_from_json()
     return result;
 }
 
+static INDIVIDUAL_ENROLLMENT_VIEW_HANDLE get_ie_view_from_json()
+{
+    INDIVIDUAL_ENROLLMENT_VIEW_HANDLE result = individualEnrollmentView_deserializeFromJson(DUMMY_JSON);
+    umock_c_reset_all_calls();
+    return result;
+}
+
 static int should_skip_index(size_t current_index, const size_t skip_array[], size_t length)
 {
     int result = 0;
@@ -2909,4 +2916,187 @@ TEST_FUNCTION(enrollmentGroup_deserializeFromJson_max_error)
     //cleanup
 }
 
+/*Tests_ENROLLMENT_22_071: [ If json_string is NULL or cannot be parsed into a JSON object, individualEnrollmentView_deserializeFromJson shall fail and return NULL ]*/
+TEST_FUNCTION(individualEnrollmentView_deserializeFromJson_null)
+{
+    //arrange
+
+    //act
+    INDIVIDUAL_ENROLLMENT_VIEW_HANDLE view = individualEnrollmentView_deserializeFromJson(NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(view);
+
+    //cleanup
+}
+
+/*Tests_ENROLLMENT_22_072: [ Otherwise, individualEnrollmentView_deserializeFromJson shall keep the parsed JSON and return a handle for the new view without copying any of its fields ]*/
+TEST_FUNCTION(individualEnrollmentView_deserializeFromJson_success)
+{
+    //arrange
+    STRICT_EXPECTED_CALL(json_parse_string(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(json_value_get_object(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+
+    //act
+    INDIVIDUAL_ENROLLMENT_VIEW_HANDLE view = individualEnrollmentView_deserializeFromJson(DUMMY_JSON);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NOT_NULL(view);
+
+    //cleanup
+    individualEnrollmentView_destroy(view);
+}
+
+/*Tests_ENROLLMENT_22_071: [ If json_string is NULL or cannot be parsed into a JSON object, individualEnrollmentView_deserializeFromJson shall fail and return NULL ]*/
+TEST_FUNCTION(individualEnrollmentView_deserializeFromJson_error)
+{
+    //arrange
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(json_parse_string(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(json_value_get_object(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    umock_c_negative_tests_snapshot();
+
+    size_t count = umock_c_negative_tests_call_count();
+
+    for (size_t index = 0; index < count; index++)
+    {
+        char tmp_msg[128];
+        sprintf(tmp_msg, "individualEnrollmentView_deserializeFromJson_error failure in test %zu/%zu", index, count);
+
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(index);
+
+        //act
+        INDIVIDUAL_ENROLLMENT_VIEW_HANDLE view = individualEnrollmentView_deserializeFromJson(DUMMY_JSON);
+
+        //assert
+        ASSERT_IS_NULL(view, tmp_msg);
+    }
+
+    //cleanup
+    umock_c_negative_tests_deinit();
+}
+
+/*Tests_ENROLLMENT_22_073: [ individualEnrollmentView_destroy shall free the parsed JSON and every field materialized from it ]*/
+TEST_FUNCTION(individualEnrollmentView_destroy_success)
+{
+    //arrange
+    INDIVIDUAL_ENROLLMENT_VIEW_HANDLE view = get_ie_view_from_json();
+    (void)individualEnrollmentView_getAttestationMechanism(view);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(deviceCapabilities_destroy(NULL));
+    STRICT_EXPECTED_CALL(deviceRegistrationState_destroy(NULL));
+    STRICT_EXPECTED_CALL(attestationMechanism_destroy(TEST_ATTESTATION_MECHANISM));
+    STRICT_EXPECTED_CALL(initialTwin_destroy(NULL));
+    STRICT_EXPECTED_CALL(json_value_free(TEST_JSON_VALUE));
+    STRICT_EXPECTED_CALL(gballoc_free(view));
+
+    //act
+    individualEnrollmentView_destroy(view);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+}
+
+/*Tests_ENROLLMENT_22_076: [ If view is NULL, the view accessors shall fail and return NULL (or PROVISIONING_STATUS_NONE) ]*/
+TEST_FUNCTION(individualEnrollmentView_getEtag_null)
+{
+    //arrange
+
+    //act
+    const char* etag = individualEnrollmentView_getEtag(NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(etag);
+
+    //cleanup
+}
+
+/*Tests_ENROLLMENT_22_077: [ The string accessors shall return the value from the parsed JSON without copying it ]*/
+TEST_FUNCTION(individualEnrollmentView_getEtag_success)
+{
+    //arrange
+    INDIVIDUAL_ENROLLMENT_VIEW_HANDLE view = get_ie_view_from_json();
+
+    STRICT_EXPECTED_CALL(json_object_get_string(TEST_JSON_OBJECT, IGNORED_PTR_ARG)).SetReturn(DUMMY_ETAG);
+
+    //act
+    const char* etag = individualEnrollmentView_getEtag(view);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_TRUE(etag == DUMMY_ETAG);
+
+    //cleanup
+    individualEnrollmentView_destroy(view);
+}
+
+/*Tests_ENROLLMENT_22_078: [ The attestation mechanism, initial twin, device capabilities and registration state accessors shall deserialize their field on first access and return the same handle on later accesses ]*/
+TEST_FUNCTION(individualEnrollmentView_getAttestationMechanism_materializes_once)
+{
+    //arrange
+    INDIVIDUAL_ENROLLMENT_VIEW_HANDLE view = get_ie_view_from_json();
+
+    STRICT_EXPECTED_CALL(json_object_get_object(TEST_JSON_OBJECT, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(attestationMechanism_fromJson(IGNORED_PTR_ARG)).SetReturn(TEST_ATTESTATION_MECHANISM);
+
+    //act
+    ATTESTATION_MECHANISM_HANDLE first = individualEnrollmentView_getAttestationMechanism(view);
+    ATTESTATION_MECHANISM_HANDLE second = individualEnrollmentView_getAttestationMechanism(view);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_TRUE(first == TEST_ATTESTATION_MECHANISM);
+    ASSERT_IS_TRUE(second == TEST_ATTESTATION_MECHANISM);
+
+    //cleanup
+    individualEnrollmentView_destroy(view);
+}
+
+/*Tests_ENROLLMENT_22_078: [ The attestation mechanism, initial twin, device capabilities and registration state accessors shall deserialize their field on first access and return the same handle on later accesses ]*/
+TEST_FUNCTION(individualEnrollmentView_getInitialTwin_no_value)
+{
+    //arrange
+    INDIVIDUAL_ENROLLMENT_VIEW_HANDLE view = get_ie_view_from_json();
+
+    STRICT_EXPECTED_CALL(json_object_get_object(TEST_JSON_OBJECT, IGNORED_PTR_ARG)).SetReturn(NULL);
+
+    //act
+    INITIAL_TWIN_HANDLE twin = individualEnrollmentView_getInitialTwin(view);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(twin);
+
+    //cleanup
+    individualEnrollmentView_destroy(view);
+}
+
+/*Tests_ENROLLMENT_22_074: [ If view is NULL, individualEnrollmentView_toEnrollment shall fail and return NULL ]*/
+TEST_FUNCTION(individualEnrollmentView_toEnrollment_null)
+{
+    //arrange
+
+    //act
+    INDIVIDUAL_ENROLLMENT_HANDLE ie = individualEnrollmentView_toEnrollment(NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(ie);
+
+    //cleanup
+}
+
 END_TEST_SUITE(provisioning_sc_enrollment_ut);
@@ -183,6 +183,7 @@ static void register_global_mocks()
     REGISTER_UMOCK_ALIAS_TYPE(INDIVIDUAL_ENROLLMENT_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(ENROLLMENT_GROUP_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(DEVICE_REGISTRATION_STATE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(PROVISIONING_QUERY_TYPE, int);
 }
 
 BEGIN_TEST_SUITE(provisioning_sc_query_ut)
@@ -959,4 +960,149 @@ TEST_FUNCTION(queryResponse_free_drs_no_results)
     //cleanup
 }
 
+TEST_FUNCTION(queryPage_deserializeFromJson_null_json)
+{
+    //arrange
+
+    //act
+    PROVISIONING_QUERY_PAGE_HANDLE page = queryPage_deserializeFromJson(NULL, QUERY_TYPE_INDIVIDUAL_ENROLLMENT);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(page);
+
+    //cleanup
+}
+
+TEST_FUNCTION(queryPage_deserializeFromJson_golden)
+{
+    //arrange
+    STRICT_EXPECTED_CALL(json_parse_string(DUMMY_JSON));
+    STRICT_EXPECTED_CALL(json_value_get_array(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(json_array_get_count(IGNORED_PTR_ARG));
+
+    //act
+    PROVISIONING_QUERY_PAGE_HANDLE page = queryPage_deserializeFromJson(DUMMY_JSON, QUERY_TYPE_INDIVIDUAL_ENROLLMENT);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NOT_NULL(page);
+    ASSERT_ARE_EQUAL(size_t, QUERY_RESP_SIZE, queryPage_getRecordCount(page));
+
+    //cleanup
+    queryPage_free(page);
+}
+
+TEST_FUNCTION(queryPage_deserializeFromJson_error)
+{
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    STRICT_EXPECTED_CALL(json_parse_string(DUMMY_JSON));
+    STRICT_EXPECTED_CALL(json_value_get_array(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    umock_c_negative_tests_snapshot();
+
+    size_t count = umock_c_negative_tests_call_count();
+    for (size_t index = 0; index < count; index++)
+    {
+        char tmp_msg[128];
+        sprintf(tmp_msg, "queryPage_deserializeFromJson_error failure in test %zu/%zu", index + 1, count);
+
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(index);
+
+        //act
+        PROVISIONING_QUERY_PAGE_HANDLE page = queryPage_deserializeFromJson(DUMMY_JSON, QUERY_TYPE_INDIVIDUAL_ENROLLMENT);
+
+        //assert
+        ASSERT_IS_NULL(page, tmp_msg);
+    }
+}
+
+TEST_FUNCTION(queryPage_getRecord_golden_individualEnrollment)
+{
+    //arrange
+    PROVISIONING_QUERY_PAGE_HANDLE page = queryPage_deserializeFromJson(DUMMY_JSON, QUERY_TYPE_INDIVIDUAL_ENROLLMENT);
+    PROVISIONING_QUERY_RECORD record;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(json_array_get_object(IGNORED_PTR_ARG, 2)).SetReturn(TEST_JSON_OBJECT);
+    STRICT_EXPECTED_CALL(individualEnrollment_fromJson(TEST_JSON_OBJECT)).SetReturn((INDIVIDUAL_ENROLLMENT_HANDLE)real_malloc(1));
+
+    //act
+    int res = queryPage_getRecord(page, 2, &record);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, res);
+    ASSERT_IS_TRUE(record.record_type == QUERY_TYPE_INDIVIDUAL_ENROLLMENT);
+    ASSERT_IS_NOT_NULL(record.record.ie);
+
+    //cleanup
+    queryRecord_free(&record);
+    queryPage_free(page);
+}
+
+TEST_FUNCTION(queryPage_getRecord_index_out_of_range)
+{
+    //arrange
+    PROVISIONING_QUERY_PAGE_HANDLE page = queryPage_deserializeFromJson(DUMMY_JSON, QUERY_TYPE_ENROLLMENT_GROUP);
+    PROVISIONING_QUERY_RECORD record;
+    umock_c_reset_all_calls();
+
+    //act
+    int res = queryPage_getRecord(page, QUERY_RESP_SIZE, &record);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, res);
+
+    //cleanup
+    queryPage_free(page);
+}
+
+TEST_FUNCTION(queryPage_getRecord_deserialize_fail)
+{
+    //arrange
+    PROVISIONING_QUERY_PAGE_HANDLE page = queryPage_deserializeFromJson(DUMMY_JSON, QUERY_TYPE_DEVICE_REGISTRATION_STATE);
+    PROVISIONING_QUERY_RECORD record;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(json_array_get_object(IGNORED_PTR_ARG, 0)).SetReturn(TEST_JSON_OBJECT);
+    STRICT_EXPECTED_CALL(deviceRegistrationState_fromJson(TEST_JSON_OBJECT)).SetReturn(NULL);
+
+    //act
+    int res = queryPage_getRecord(page, 0, &record);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, res);
+    ASSERT_IS_TRUE(record.record_type == QUERY_TYPE_INVALID);
+
+    //cleanup
+    queryPage_free(page);
+}
+
+TEST_FUNCTION(queryRecord_free_eg)
+{
+    //arrange
+    PROVISIONING_QUERY_RECORD record;
+    record.record.eg = (ENROLLMENT_GROUP_HANDLE)real_malloc(1);
+    record.record_type = QUERY_TYPE_ENROLLMENT_GROUP;
+
+    STRICT_EXPECTED_CALL(enrollmentGroup_destroy(record.record.eg));
+
+    //act
+    queryRecord_free(&record);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(record.record.eg);
+    ASSERT_IS_TRUE(record.record_type == QUERY_TYPE_INVALID);
+
+    //cleanup
+}
+
 END_TEST_SUITE(provisioning_sc_query_ut);
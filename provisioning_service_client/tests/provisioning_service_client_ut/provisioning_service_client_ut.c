@@ -59,6 +59,8 @@ static TEST_MUTEX_HANDLE g_testByTest;
 static int g_uhttp_client_dowork_call_count;
 static ON_HTTP_OPEN_COMPLETE_CALLBACK g_on_http_open;
 static void* g_http_open_ctx;
+static ON_HTTP_ERROR_CALLBACK g_on_http_error;
+static void* g_http_error_ctx;
 static ON_HTTP_REQUEST_CALLBACK g_on_http_reply_recv;
 static void* g_http_reply_recv_ctx;
 
@@ -158,8 +160,8 @@ static HTTP_CLIENT_HANDLE my_uhttp_client_create(const IO_INTERFACE_DESCRIPTION*
 {
     (void)io_interface_desc;
     (void)xio_param;
-    (void)on_http_error;
-    (void)callback_ctx;
+    g_on_http_error = on_http_error;
+    g_http_error_ctx = callback_ctx;
 
     return (HTTP_CLIENT_HANDLE)real_malloc(1);
 }
@@ -225,6 +227,51 @@ static void my_uhttp_client_dowork(HTTP_CLIENT_HANDLE handle)
     g_uhttp_client_dowork_call_count++;
 }
 
+static bool g_persistent_connection_opened;
+static size_t g_bulk_import_error_count;
+
+static void my_uhttp_client_dowork_persistent(HTTP_CLIENT_HANDLE handle)
+{
+    (void)handle;
+
+    // Unlike my_uhttp_client_dowork this answers every request, so one connection can carry several of them
+    if (!g_persistent_connection_opened)
+    {
+        g_persistent_connection_opened = true;
+        g_on_http_open(g_http_open_ctx, HTTP_CALLBACK_REASON_OK);
+    }
+    else if (g_on_http_reply_recv != NULL)
+    {
+        ON_HTTP_REQUEST_CALLBACK on_reply = g_on_http_reply_recv;
+        g_on_http_reply_recv = NULL;
+        on_reply(g_http_reply_recv_ctx, HTTP_CALLBACK_REASON_OK, TEST_REPLY_JSON, 1, STATUS_CODE_SUCCESS, TEST_HTTP_HEADERS_HANDLE);
+    }
+}
+
+static bool g_idle_connection_dropped;
+
+static void my_uhttp_client_dowork_drop_idle(HTTP_CLIENT_HANDLE handle)
+{
+    if (!g_idle_connection_dropped)
+    {
+        //what the service does to a connection that was idle for too long
+        g_idle_connection_dropped = true;
+        g_persistent_connection_opened = false;
+        g_on_http_error(g_http_error_ctx, HTTP_CALLBACK_REASON_ERROR);
+    }
+    else
+    {
+        my_uhttp_client_dowork_persistent(handle);
+    }
+}
+
+static void test_on_bulk_import_error(const PROVISIONING_BULK_OPERATION_ERROR* error, void* user_context)
+{
+    (void)user_context;
+    ASSERT_ARE_EQUAL(void_ptr, g_bulk_errors[0], error);
+    g_bulk_import_error_count++;
+}
+
 static const char* my_Map_GetValueFromKey(MAP_HANDLE handle, const char* key)
 {
     char* result = NULL;
@@ -344,11 +391,19 @@ static DEVICE_REGISTRATION_STATE_HANDLE my_deviceRegistrationState_deserializeFr
     return result;
 }
 
+static PROVISIONING_BULK_OPERATION_ERROR* g_bulk_errors[1];
+static size_t g_bulk_num_errors;
+
 static PROVISIONING_BULK_OPERATION_RESULT* my_bulkOperationResult_deserializeFromJson(const char* json_string)
 {
     PROVISIONING_BULK_OPERATION_RESULT* result;
     if (json_string != NULL)
-        result = (PROVISIONING_BULK_OPERATION_RESULT*)real_malloc(1);
+    {
+        result = (PROVISIONING_BULK_OPERATION_RESULT*)real_malloc(sizeof(PROVISIONING_BULK_OPERATION_RESULT));
+        result->is_successful = (g_bulk_num_errors == 0);
+        result->errors = g_bulk_errors;
+        result->num_errors = g_bulk_num_errors;
+    }
     else
         result = NULL;
     return result;
@@ -365,11 +420,59 @@ static PROVISIONING_QUERY_RESPONSE* my_queryResponse_deserializeFromJson(const c
     return result;
 }
 
+static size_t g_query_page_record_count;
+
+static PROVISIONING_QUERY_PAGE_HANDLE my_queryPage_deserializeFromJson(const char* json_string, PROVISIONING_QUERY_TYPE type)
+{
+    (void)type;
+    PROVISIONING_QUERY_PAGE_HANDLE result;
+    if (json_string != NULL)
+        result = (PROVISIONING_QUERY_PAGE_HANDLE)real_malloc(1);
+    else
+        result = NULL;
+    return result;
+}
+
+static size_t my_queryPage_getRecordCount(PROVISIONING_QUERY_PAGE_HANDLE page)
+{
+    (void)page;
+    return g_query_page_record_count;
+}
+
+static int my_queryPage_getRecord(PROVISIONING_QUERY_PAGE_HANDLE page, size_t index, PROVISIONING_QUERY_RECORD* record)
+{
+    (void)page;
+    (void)index;
+    record->record.ie = TEST_INDIVIDUAL_ENROLLMENT_HANDLE;
+    record->record_type = QUERY_TYPE_INDIVIDUAL_ENROLLMENT;
+    return 0;
+}
+
+static void my_queryPage_free(PROVISIONING_QUERY_PAGE_HANDLE page)
+{
+    real_free(page);
+}
+
 static void my_individualEnrollment_destroy(INDIVIDUAL_ENROLLMENT_HANDLE handle)
 {
     real_free(handle);
 }
 
+static INDIVIDUAL_ENROLLMENT_VIEW_HANDLE my_individualEnrollmentView_deserializeFromJson(const char* json_string)
+{
+    INDIVIDUAL_ENROLLMENT_VIEW_HANDLE result;
+    if (json_string != NULL)
+        result = (INDIVIDUAL_ENROLLMENT_VIEW_HANDLE)real_malloc(1);
+    else
+        result = NULL;
+    return result;
+}
+
+static void my_individualEnrollmentView_destroy(INDIVIDUAL_ENROLLMENT_VIEW_HANDLE handle)
+{
+    real_free(handle);
+}
+
 static void my_enrollmentGroup_destroy(ENROLLMENT_GROUP_HANDLE handle)
 {
     real_free(handle);
@@ -572,6 +675,9 @@ static void register_global_mock_hooks()
 
     REGISTER_GLOBAL_MOCK_HOOK(individualEnrollment_deserializeFromJson, my_individualEnrollment_deserializeFromJson);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(individualEnrollment_deserializeFromJson, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(individualEnrollmentView_deserializeFromJson, my_individualEnrollmentView_deserializeFromJson);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(individualEnrollmentView_deserializeFromJson, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(individualEnrollmentView_destroy, my_individualEnrollmentView_destroy);
 
     REGISTER_GLOBAL_MOCK_HOOK(individualEnrollment_create, my_individualEnrollment_create);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(individualEnrollment_create, NULL);
@@ -630,6 +736,12 @@ static void register_global_mock_hooks()
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(queryResponse_deserializeFromJson, NULL);
 
     REGISTER_GLOBAL_MOCK_HOOK(queryResponse_free, my_queryResponse_free);
+    REGISTER_GLOBAL_MOCK_HOOK(queryPage_deserializeFromJson, my_queryPage_deserializeFromJson);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(queryPage_deserializeFromJson, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(queryPage_getRecordCount, my_queryPage_getRecordCount);
+    REGISTER_GLOBAL_MOCK_HOOK(queryPage_getRecord, my_queryPage_getRecord);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(queryPage_getRecord, __FAILURE__);
+    REGISTER_GLOBAL_MOCK_HOOK(queryPage_free, my_queryPage_free);
 
     REGISTER_GLOBAL_MOCK_HOOK(queryType_stringToEnum, my_queryType_stringToEnum);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(queryType_stringToEnum, QUERY_TYPE_INVALID);
@@ -666,6 +778,7 @@ static void register_global_mock_alias_types()
     REGISTER_UMOCK_ALIAS_TYPE(MAP_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(ATTESTATION_MECHANISM_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(INDIVIDUAL_ENROLLMENT_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(INDIVIDUAL_ENROLLMENT_VIEW_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(ENROLLMENT_GROUP_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(DEVICE_REGISTRATION_STATE_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(const INDIVIDUAL_ENROLLMENT_HANDLE, void*);
@@ -680,6 +793,7 @@ static void register_global_mock_alias_types()
     REGISTER_UMOCK_ALIAS_TYPE(HTTP_CLIENT_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(HTTP_CLIENT_REQUEST_TYPE, int);
     REGISTER_UMOCK_ALIAS_TYPE(PROVISIONING_QUERY_TYPE, int);
+    REGISTER_UMOCK_ALIAS_TYPE(PROVISIONING_QUERY_PAGE_HANDLE, void*);
 }
 
 BEGIN_TEST_SUITE(provisioning_service_client_ut)
@@ -716,8 +830,15 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
     g_http_open_ctx = NULL;
     g_on_http_reply_recv = NULL;
     g_http_reply_recv_ctx = NULL;
+    g_on_http_error = NULL;
+    g_http_error_ctx = NULL;
+    g_idle_connection_dropped = false;
     g_uhttp_client_dowork_call_count = 0;
     g_response_content_status = RESPONSE_ON;
+    g_bulk_num_errors = 0;
+    g_persistent_connection_opened = false;
+    g_bulk_import_error_count = 0;
+    g_query_page_record_count = 1;
 
     g_cert = NO_CERT;
     g_trace = NO_TRACE;
@@ -792,6 +913,20 @@ static void expected_calls_construct_http_headers(etag_flag etag_flag, HTTP_CLIE
     STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)); //does not fail
 }
 
+static void expected_calls_construct_http_headers_cached_sas(HTTP_CLIENT_REQUEST_TYPE request)
+{
+    STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
+    STRICT_EXPECTED_CALL(get_time(IGNORED_PTR_ARG)); //does not fail
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    if (request != HTTP_CLIENT_REQUEST_DELETE)
+    {
+        STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    }
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)); //does not fail
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+}
+
 static void expected_calls_add_query_headers(bool has_page_size, bool has_cont_token)
 {
     if (has_cont_token)
@@ -1001,6 +1136,115 @@ TEST_FUNCTION(prov_sc_trace_GOLDEN)
     prov_sc_destroy(sc);
 }
 
+/* Tests_PROVISIONING_SERVICE_CLIENT_22_116: [ If prov_client is NULL, prov_sc_set_keep_alive shall do nothing ] */
+TEST_FUNCTION(prov_sc_set_keep_alive_INPUT_NULL)
+{
+    //arrange
+
+    //act
+    prov_sc_set_keep_alive(NULL, true);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+}
+
+/* Tests_PROVISIONING_SERVICE_CLIENT_22_117: [ While keep_alive is set, a successful REST call shall leave its connection open and the next REST call shall reuse it ] */
+/* Tests_PROVISIONING_SERVICE_CLIENT_22_118: [ While keep_alive is set, the SAS token shall be reused until it is less than 5 minutes from expiring ] */
+TEST_FUNCTION(prov_sc_set_keep_alive_reuses_connection_and_sas_token)
+{
+    //arrange
+    PROVISIONING_SERVICE_CLIENT_HANDLE sc = prov_sc_create_from_connection_string(TEST_CONNECTION_STRING);
+    INDIVIDUAL_ENROLLMENT_HANDLE ie = NULL;
+    INDIVIDUAL_ENROLLMENT_HANDLE ie2 = NULL;
+    REGISTER_GLOBAL_MOCK_HOOK(uhttp_client_dowork, my_uhttp_client_dowork_persistent);
+    prov_sc_set_keep_alive(sc, true);
+    (void)prov_sc_get_individual_enrollment(sc, TEST_REGID, &ie);
+    umock_c_reset_all_calls();
+
+    expected_calls_construct_registration_path(true);
+    expected_calls_construct_http_headers_cached_sas(HTTP_CLIENT_REQUEST_GET);
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)); //does not fail
+    STRICT_EXPECTED_CALL(uhttp_client_dowork(IGNORED_PTR_ARG)); //does not fail
+    STRICT_EXPECTED_CALL(uhttp_client_execute_request(IGNORED_PTR_ARG, HTTP_CLIENT_REQUEST_GET, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(uhttp_client_dowork(IGNORED_PTR_ARG)); //does not fail
+    STRICT_EXPECTED_CALL(HTTPHeaders_Clone(IGNORED_PTR_ARG)); //this is in a callback for on_http_reply_recv
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));  //this is also in the callback
+    STRICT_EXPECTED_CALL(individualEnrollment_deserializeFromJson(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)); //does not fail
+    STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG)); //does not fail
+    STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG)); //does not fail
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)); //does not fail
+
+    //act
+    int res = prov_sc_get_individual_enrollment(sc, TEST_REGID, &ie2);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, res, 0);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NOT_NULL(ie2);
+
+    //cleanup
+    REGISTER_GLOBAL_MOCK_HOOK(uhttp_client_dowork, my_uhttp_client_dowork);
+    prov_sc_destroy(sc);
+    individualEnrollment_destroy(ie);
+    individualEnrollment_destroy(ie2);
+}
+
+/* Tests_PROVISIONING_SERVICE_CLIENT_22_119: [ If a REST call on a kept connection fails before any reply arrives, it shall be retried once on a new connection ] */
+TEST_FUNCTION(prov_sc_set_keep_alive_reconnects_dropped_connection)
+{
+    //arrange
+    PROVISIONING_SERVICE_CLIENT_HANDLE sc = prov_sc_create_from_connection_string(TEST_CONNECTION_STRING);
+    INDIVIDUAL_ENROLLMENT_HANDLE ie = NULL;
+    INDIVIDUAL_ENROLLMENT_HANDLE ie2 = NULL;
+    REGISTER_GLOBAL_MOCK_HOOK(uhttp_client_dowork, my_uhttp_client_dowork_persistent);
+    prov_sc_set_keep_alive(sc, true);
+    (void)prov_sc_get_individual_enrollment(sc, TEST_REGID, &ie);
+    REGISTER_GLOBAL_MOCK_HOOK(uhttp_client_dowork, my_uhttp_client_dowork_drop_idle);
+    umock_c_reset_all_calls();
+
+    //act
+    int res = prov_sc_get_individual_enrollment(sc, TEST_REGID, &ie2);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, res, 0);
+    ASSERT_IS_TRUE(g_idle_connection_dropped);
+    ASSERT_IS_NOT_NULL(ie2);
+
+    //cleanup
+    REGISTER_GLOBAL_MOCK_HOOK(uhttp_client_dowork, my_uhttp_client_dowork);
+    prov_sc_destroy(sc);
+    individualEnrollment_destroy(ie);
+    individualEnrollment_destroy(ie2);
+}
+
+/* Tests_PROVISIONING_SERVICE_CLIENT_22_120: [ If keep_alive is cleared, the kept connection and SAS token shall be released ] */
+TEST_FUNCTION(prov_sc_set_keep_alive_off_releases_session)
+{
+    //arrange
+    PROVISIONING_SERVICE_CLIENT_HANDLE sc = prov_sc_create_from_connection_string(TEST_CONNECTION_STRING);
+    INDIVIDUAL_ENROLLMENT_HANDLE ie = NULL;
+    prov_sc_set_keep_alive(sc, true);
+    (void)prov_sc_get_individual_enrollment(sc, TEST_REGID, &ie);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(uhttp_client_close(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG)); //does not fail
+    STRICT_EXPECTED_CALL(uhttp_client_destroy(IGNORED_PTR_ARG)); //does not fail
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)); //does not fail
+
+    //act
+    prov_sc_set_keep_alive(sc, false);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    prov_sc_destroy(sc);
+    individualEnrollment_destroy(ie);
+}
+
 /* Tests_PROVISIONING_SERVICE_CLIENT_22_058: [ If prov_client is NULL, prov_sc_set_certificate shall fail and return a non-zero value ] */
 TEST_FUNCTION(prov_sc_set_certificate_ERROR_NULL_HANDLE)
 {
@@ -2114,6 +2358,86 @@ TEST_FUNCTION(prov_sc_get_individual_enrollment_FAIL)
     umock_c_negative_tests_deinit();
 }
 
+/* Tests_PROVISIONING_SERVICE_CLIENT_22_121: [ If prov_client, reg_id or view_ptr are NULL, prov_sc_get_individual_enrollment_view shall fail and return a non-zero value ] */
+TEST_FUNCTION(prov_sc_get_individual_enrollment_view_ERROR_INPUT_NULL_VIEW)
+{
+    //arrange
+    PROVISIONING_SERVICE_CLIENT_HANDLE sc = prov_sc_create_from_connection_string(TEST_CONNECTION_STRING);
+    umock_c_reset_all_calls();
+
+    //act
+    int res = prov_sc_get_individual_enrollment_view(sc, TEST_REGID, NULL);
+
+    //assert
+    ASSERT_ARE_NOT_EQUAL(int, res, 0);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    prov_sc_destroy(sc);
+}
+
+/* Tests_PROVISIONING_SERVICE_CLIENT_22_122: [ A 'GET' REST call shall be issued to retrieve the enrollment record of a device with ID reg_id from the Provisioning Service ] */
+/* Tests_PROVISIONING_SERVICE_CLIENT_22_124: [ Upon success, view_ptr shall be populated with a view over the retrieved JSON and prov_sc_get_individual_enrollment_view shall return 0 ] */
+TEST_FUNCTION(prov_sc_get_individual_enrollment_view_GOLDEN)
+{
+    //arrange
+    PROVISIONING_SERVICE_CLIENT_HANDLE sc = prov_sc_create_from_connection_string(TEST_CONNECTION_STRING);
+    INDIVIDUAL_ENROLLMENT_VIEW_HANDLE view = NULL;
+    umock_c_reset_all_calls();
+
+    expected_calls_construct_registration_path(true);
+    expected_calls_construct_http_headers(NO_ETAG, HTTP_CLIENT_REQUEST_GET);
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)); //does not fail
+    expected_calls_rest_call(HTTP_CLIENT_REQUEST_GET, RESPONSE);
+    STRICT_EXPECTED_CALL(individualEnrollmentView_deserializeFromJson(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)); //does not fail
+    STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG)); //does not fail
+    STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG)); //does not fail
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)); //does not fail
+
+    //act
+    int res = prov_sc_get_individual_enrollment_view(sc, TEST_REGID, &view);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, res, 0);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NOT_NULL(view);
+
+    //cleanup
+    prov_sc_destroy(sc);
+    individualEnrollmentView_destroy(view);
+}
+
+/* Tests_PROVISIONING_SERVICE_CLIENT_22_123: [ If the 'GET' REST call fails or the response cannot be parsed, prov_sc_get_individual_enrollment_view shall fail and return a non-zero value ] */
+TEST_FUNCTION(prov_sc_get_individual_enrollment_view_parse_FAIL)
+{
+    //arrange
+    PROVISIONING_SERVICE_CLIENT_HANDLE sc = prov_sc_create_from_connection_string(TEST_CONNECTION_STRING);
+    INDIVIDUAL_ENROLLMENT_VIEW_HANDLE view = NULL;
+    umock_c_reset_all_calls();
+
+    expected_calls_construct_registration_path(true);
+    expected_calls_construct_http_headers(NO_ETAG, HTTP_CLIENT_REQUEST_GET);
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)); //does not fail
+    expected_calls_rest_call(HTTP_CLIENT_REQUEST_GET, RESPONSE);
+    STRICT_EXPECTED_CALL(individualEnrollmentView_deserializeFromJson(IGNORED_PTR_ARG)).SetReturn(NULL);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)); //does not fail
+    STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG)); //does not fail
+    STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG)); //does not fail
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)); //does not fail
+
+    //act
+    int res = prov_sc_get_individual_enrollment_view(sc, TEST_REGID, &view);
+
+    //assert
+    ASSERT_ARE_NOT_EQUAL(int, res, 0);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(view);
+
+    //cleanup
+    prov_sc_destroy(sc);
+}
+
 /* Tests_PROVISIONING_SERVICE_CLIENT_22_030: [ If prov_client or enrollment_ptr are NULL, prov_sc_create_or_update_enrollment_group shall fail and return a non-zero value ] */
 TEST_FUNCTION(prov_sc_create_or_update_enrollment_group_ERROR_INPUT_NULL_SC_HANDLE)
 {
@@ -3477,43 +3801,265 @@ TEST_FUNCTION(prov_sc_run_individual_enrollment_bulk_operation_ERROR)
     umock_c_negative_tests_deinit();
 }
 
-/*Tests_PROVISIONING_SERVICE_CLIENT_22_077: [ If prov_client, query_spec, cont_token_ptr or query_resp_ptr are NULL, prov_sc_query_individual_enrollment shall fail and return a non-zero value ]*/
-TEST_FUNCTION(prov_sc_query_individual_enrollment_NULL_prov_client)
+static void expected_calls_send_bulk_import_batch(void)
 {
-    //arrange
-    PROVISIONING_QUERY_SPECIFICATION qs = { 0 };
-    qs.page_size = NO_MAX_PAGE_SIZE;
-    qs.query_string = TEST_QUERY_STRING;
-    qs.version = PROVISIONING_QUERY_SPECIFICATION_VERSION_1;
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)); //does not fail
+    STRICT_EXPECTED_CALL(bulkOperation_serializeToJson(IGNORED_PTR_ARG));
+    expected_calls_construct_http_headers(NO_ETAG, HTTP_CLIENT_REQUEST_POST);
+    STRICT_EXPECTED_CALL(uhttp_client_execute_request(IGNORED_PTR_ARG, HTTP_CLIENT_REQUEST_POST, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+}
 
-    char* cont_token = NULL;
-    PROVISIONING_QUERY_RESPONSE* query_resp = NULL;
-    umock_c_reset_all_calls();
+static void expected_calls_clear_bulk_import_batch(void)
+{
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)); //content
+    STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)); //response
+}
+
+static void expected_calls_receive_bulk_import_batch(void)
+{
+    STRICT_EXPECTED_CALL(uhttp_client_dowork(IGNORED_PTR_ARG)); //does not fail
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)); //this is in the callback
+    STRICT_EXPECTED_CALL(bulkOperationResult_deserializeFromJson(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(bulkOperationResult_free(IGNORED_PTR_ARG));
+    expected_calls_clear_bulk_import_batch();
+}
+
+/*Tests_PROVISIONING_SERVICE_CLIENT_22_101: [ If prov_client, bulk_op or num_failed are NULL, or bulk_op has invalid values, prov_sc_import_individual_enrollments shall fail and return a non-zero value ]*/
+TEST_FUNCTION(prov_sc_import_individual_enrollments_NULL_prov)
+{
+    //arrange
+    INDIVIDUAL_ENROLLMENT_HANDLE ie_arr[2] = { TEST_INDIVIDUAL_ENROLLMENT_HANDLE, TEST_INDIVIDUAL_ENROLLMENT_HANDLE2 };
+    PROVISIONING_BULK_OPERATION bulkop;
+    bulkop.version = PROVISIONING_BULK_OPERATION_VERSION_1;
+    bulkop.enrollments.ie = ie_arr;
+    bulkop.num_enrollments = 2;
+    bulkop.mode = BULK_OP_CREATE;
+    bulkop.type = BULK_OP_INDIVIDUAL_ENROLLMENT;
+    size_t num_failed;
 
     //act
-    int res = prov_sc_query_individual_enrollment(NULL, &qs, &cont_token, &query_resp);
+    int res = prov_sc_import_individual_enrollments(NULL, &bulkop, NULL, &num_failed);
 
     //assert
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
     ASSERT_ARE_NOT_EQUAL(int, 0, res);
-    ASSERT_IS_NULL(cont_token);
-    ASSERT_IS_NULL(query_resp);
 
     //cleanup
 }
 
-/*Tests_PROVISIONING_SERVICE_CLIENT_22_077: [ If prov_client, query_spec, cont_token_ptr or query_resp_ptr are NULL, prov_sc_query_individual_enrollment shall fail and return a non-zero value ]*/
-TEST_FUNCTION(prov_sc_query_individual_enrollment_NULL_query_spec)
+/*Tests_PROVISIONING_SERVICE_CLIENT_22_101: [ If prov_client, bulk_op or num_failed are NULL, or bulk_op has invalid values, prov_sc_import_individual_enrollments shall fail and return a non-zero value ]*/
+TEST_FUNCTION(prov_sc_import_individual_enrollments_NULL_num_failed)
 {
     //arrange
     PROVISIONING_SERVICE_CLIENT_HANDLE sc = prov_sc_create_from_connection_string(TEST_CONNECTION_STRING);
-
-    char* cont_token = NULL;
-    PROVISIONING_QUERY_RESPONSE* query_resp = NULL;
+    INDIVIDUAL_ENROLLMENT_HANDLE ie_arr[2] = { TEST_INDIVIDUAL_ENROLLMENT_HANDLE, TEST_INDIVIDUAL_ENROLLMENT_HANDLE2 };
+    PROVISIONING_BULK_OPERATION bulkop;
+    bulkop.version = PROVISIONING_BULK_OPERATION_VERSION_1;
+    bulkop.enrollments.ie = ie_arr;
+    bulkop.num_enrollments = 2;
+    bulkop.mode = BULK_OP_CREATE;
+    bulkop.type = BULK_OP_INDIVIDUAL_ENROLLMENT;
     umock_c_reset_all_calls();
 
     //act
-    int res = prov_sc_query_individual_enrollment(sc, NULL, &cont_token, &query_resp);
+    int res = prov_sc_import_individual_enrollments(sc, &bulkop, NULL, NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, res);
+
+    //cleanup
+    prov_sc_destroy(sc);
+}
+
+/*Tests_PROVISIONING_SERVICE_CLIENT_22_101: [ If prov_client, bulk_op or num_failed are NULL, or bulk_op has invalid values, prov_sc_import_individual_enrollments shall fail and return a non-zero value ]*/
+TEST_FUNCTION(prov_sc_import_individual_enrollments_invalid_bulkop_version)
+{
+    //arrange
+    PROVISIONING_SERVICE_CLIENT_HANDLE sc = prov_sc_create_from_connection_string(TEST_CONNECTION_STRING);
+    INDIVIDUAL_ENROLLMENT_HANDLE ie_arr[2] = { TEST_INDIVIDUAL_ENROLLMENT_HANDLE, TEST_INDIVIDUAL_ENROLLMENT_HANDLE2 };
+    PROVISIONING_BULK_OPERATION bulkop;
+    bulkop.version = 47474747;
+    bulkop.enrollments.ie = ie_arr;
+    bulkop.num_enrollments = 2;
+    bulkop.mode = BULK_OP_CREATE;
+    bulkop.type = BULK_OP_INDIVIDUAL_ENROLLMENT;
+    size_t num_failed;
+    umock_c_reset_all_calls();
+
+    //act
+    int res = prov_sc_import_individual_enrollments(sc, &bulkop, NULL, &num_failed);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, res);
+
+    //cleanup
+    prov_sc_destroy(sc);
+}
+
+/*Tests_PROVISIONING_SERVICE_CLIENT_22_102: [ prov_sc_import_individual_enrollments shall split the enrollments of bulk_op into batches of batch_size enrollments, or PROVISIONING_BULK_IMPORT_MAX_BATCH_SIZE when options or its batch_size is 0 ]*/
+/*Tests_PROVISIONING_SERVICE_CLIENT_22_103: [ prov_sc_import_individual_enrollments shall open up to max_concurrent_requests connections and issue a 'POST' REST call per batch, reusing a connection for the next batch once its reply has arrived ]*/
+/*Tests_PROVISIONING_SERVICE_CLIENT_22_104: [ For every error in a batch result prov_sc_import_individual_enrollments shall call on_error and count it in num_failed ]*/
+/*Tests_PROVISIONING_SERVICE_CLIENT_22_106: [ Once every batch has been answered prov_sc_import_individual_enrollments shall return 0 ]*/
+TEST_FUNCTION(prov_sc_import_individual_enrollments_reuses_connection_SUCCESS)
+{
+    //arrange
+    PROVISIONING_SERVICE_CLIENT_HANDLE sc = prov_sc_create_from_connection_string(TEST_CONNECTION_STRING);
+    INDIVIDUAL_ENROLLMENT_HANDLE ie_arr[2] = { TEST_INDIVIDUAL_ENROLLMENT_HANDLE, TEST_INDIVIDUAL_ENROLLMENT_HANDLE2 };
+    PROVISIONING_BULK_OPERATION bulkop;
+    bulkop.version = PROVISIONING_BULK_OPERATION_VERSION_1;
+    bulkop.enrollments.ie = ie_arr;
+    bulkop.num_enrollments = 2;
+    bulkop.mode = BULK_OP_CREATE;
+    bulkop.type = BULK_OP_INDIVIDUAL_ENROLLMENT;
+    PROVISIONING_BULK_IMPORT_OPTIONS options;
+    options.batch_size = 1;
+    options.max_concurrent_requests = 1;
+    options.on_error = test_on_bulk_import_error;
+    options.user_context = NULL;
+    size_t num_failed = 0;
+    g_bulk_errors[0] = (PROVISIONING_BULK_OPERATION_ERROR*)0x4242;
+    g_bulk_num_errors = 1;
+    REGISTER_GLOBAL_MOCK_HOOK(uhttp_client_dowork, my_uhttp_client_dowork_persistent);
+    umock_c_reset_all_calls();
+
+    expected_calls_construct_registration_path(false);
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    expected_calls_connect_to_service();
+    STRICT_EXPECTED_CALL(uhttp_client_dowork(IGNORED_PTR_ARG)); //does not fail
+    expected_calls_send_bulk_import_batch();
+    expected_calls_receive_bulk_import_batch();
+    expected_calls_send_bulk_import_batch();
+    expected_calls_receive_bulk_import_batch();
+    expected_calls_clear_bulk_import_batch();
+    STRICT_EXPECTED_CALL(uhttp_client_close(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG)); //does not fail
+    STRICT_EXPECTED_CALL(uhttp_client_destroy(IGNORED_PTR_ARG)); //does not fail
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)); //cannot fail
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+
+    //act
+    int res = prov_sc_import_individual_enrollments(sc, &bulkop, &options, &num_failed);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, res);
+    ASSERT_ARE_EQUAL(size_t, 2, num_failed);
+    ASSERT_ARE_EQUAL(size_t, 2, g_bulk_import_error_count);
+
+    //cleanup
+    REGISTER_GLOBAL_MOCK_HOOK(uhttp_client_dowork, my_uhttp_client_dowork);
+    prov_sc_destroy(sc);
+}
+
+/*Tests_PROVISIONING_SERVICE_CLIENT_22_106: [ Once every batch has been answered prov_sc_import_individual_enrollments shall return 0 ]*/
+TEST_FUNCTION(prov_sc_import_individual_enrollments_no_enrollments_SUCCESS)
+{
+    //arrange
+    PROVISIONING_SERVICE_CLIENT_HANDLE sc = prov_sc_create_from_connection_string(TEST_CONNECTION_STRING);
+    PROVISIONING_BULK_OPERATION bulkop;
+    bulkop.version = PROVISIONING_BULK_OPERATION_VERSION_1;
+    bulkop.enrollments.ie = NULL;
+    bulkop.num_enrollments = 0;
+    bulkop.mode = BULK_OP_CREATE;
+    bulkop.type = BULK_OP_INDIVIDUAL_ENROLLMENT;
+    size_t num_failed = 47;
+    umock_c_reset_all_calls();
+
+    //act
+    int res = prov_sc_import_individual_enrollments(sc, &bulkop, NULL, &num_failed);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, res);
+    ASSERT_ARE_EQUAL(size_t, 0, num_failed);
+
+    //cleanup
+    prov_sc_destroy(sc);
+}
+
+/*Tests_PROVISIONING_SERVICE_CLIENT_22_105: [ If a batch cannot be sent or answered, prov_sc_import_individual_enrollments shall send no further batches, wait for the batches in flight and return a non-zero value ]*/
+TEST_FUNCTION(prov_sc_import_individual_enrollments_execute_request_fail)
+{
+    //arrange
+    PROVISIONING_SERVICE_CLIENT_HANDLE sc = prov_sc_create_from_connection_string(TEST_CONNECTION_STRING);
+    INDIVIDUAL_ENROLLMENT_HANDLE ie_arr[2] = { TEST_INDIVIDUAL_ENROLLMENT_HANDLE, TEST_INDIVIDUAL_ENROLLMENT_HANDLE2 };
+    PROVISIONING_BULK_OPERATION bulkop;
+    bulkop.version = PROVISIONING_BULK_OPERATION_VERSION_1;
+    bulkop.enrollments.ie = ie_arr;
+    bulkop.num_enrollments = 2;
+    bulkop.mode = BULK_OP_CREATE;
+    bulkop.type = BULK_OP_INDIVIDUAL_ENROLLMENT;
+    size_t num_failed = 0;
+    REGISTER_GLOBAL_MOCK_HOOK(uhttp_client_dowork, my_uhttp_client_dowork_persistent);
+    umock_c_reset_all_calls();
+
+    expected_calls_construct_registration_path(false);
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    expected_calls_connect_to_service();
+    STRICT_EXPECTED_CALL(uhttp_client_dowork(IGNORED_PTR_ARG)); //does not fail
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)); //does not fail
+    STRICT_EXPECTED_CALL(bulkOperation_serializeToJson(IGNORED_PTR_ARG));
+    expected_calls_construct_http_headers(NO_ETAG, HTTP_CLIENT_REQUEST_POST);
+    STRICT_EXPECTED_CALL(uhttp_client_execute_request(IGNORED_PTR_ARG, HTTP_CLIENT_REQUEST_POST, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .SetReturn(HTTP_CLIENT_ERROR);
+    expected_calls_clear_bulk_import_batch();
+    expected_calls_clear_bulk_import_batch();
+    STRICT_EXPECTED_CALL(uhttp_client_close(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG)); //does not fail
+    STRICT_EXPECTED_CALL(uhttp_client_destroy(IGNORED_PTR_ARG)); //does not fail
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)); //cannot fail
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+
+    //act
+    int res = prov_sc_import_individual_enrollments(sc, &bulkop, NULL, &num_failed);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, res);
+
+    //cleanup
+    REGISTER_GLOBAL_MOCK_HOOK(uhttp_client_dowork, my_uhttp_client_dowork);
+    prov_sc_destroy(sc);
+}
+
+/*Tests_PROVISIONING_SERVICE_CLIENT_22_077: [ If prov_client, query_spec, cont_token_ptr or query_resp_ptr are NULL, prov_sc_query_individual_enrollment shall fail and return a non-zero value ]*/
+TEST_FUNCTION(prov_sc_query_individual_enrollment_NULL_prov_client)
+{
+    //arrange
+    PROVISIONING_QUERY_SPECIFICATION qs = { 0 };
+    qs.page_size = NO_MAX_PAGE_SIZE;
+    qs.query_string = TEST_QUERY_STRING;
+    qs.version = PROVISIONING_QUERY_SPECIFICATION_VERSION_1;
+
+    char* cont_token = NULL;
+    PROVISIONING_QUERY_RESPONSE* query_resp = NULL;
+    umock_c_reset_all_calls();
+
+    //act
+    int res = prov_sc_query_individual_enrollment(NULL, &qs, &cont_token, &query_resp);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, res);
+    ASSERT_IS_NULL(cont_token);
+    ASSERT_IS_NULL(query_resp);
+
+    //cleanup
+}
+
+/*Tests_PROVISIONING_SERVICE_CLIENT_22_077: [ If prov_client, query_spec, cont_token_ptr or query_resp_ptr are NULL, prov_sc_query_individual_enrollment shall fail and return a non-zero value ]*/
+TEST_FUNCTION(prov_sc_query_individual_enrollment_NULL_query_spec)
+{
+    //arrange
+    PROVISIONING_SERVICE_CLIENT_HANDLE sc = prov_sc_create_from_connection_string(TEST_CONNECTION_STRING);
+
+    char* cont_token = NULL;
+    PROVISIONING_QUERY_RESPONSE* query_resp = NULL;
+    umock_c_reset_all_calls();
+
+    //act
+    int res = prov_sc_query_individual_enrollment(sc, NULL, &cont_token, &query_resp);
 
     //assert
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
@@ -4696,4 +5242,306 @@ TEST_FUNCTION(prov_sc_query_device_registration_state_success_paging_given_token
     prov_sc_destroy(sc);
 }
 
+static void expected_calls_send_query_iterator_request(bool has_cont_token)
+{
+    expected_calls_construct_http_headers(NO_ETAG, HTTP_CLIENT_REQUEST_POST);
+    expected_calls_add_query_headers(false, has_cont_token);
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)); //cannot fail
+    STRICT_EXPECTED_CALL(uhttp_client_execute_request(IGNORED_PTR_ARG, HTTP_CLIENT_REQUEST_POST, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+}
+
+static void expected_calls_load_query_iterator_page(const char* cont_token)
+{
+    STRICT_EXPECTED_CALL(queryPage_free(NULL)); //cannot fail
+    STRICT_EXPECTED_CALL(HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, IGNORED_PTR_ARG)).SetReturn(cont_token); //cannot fail
+    STRICT_EXPECTED_CALL(HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, IGNORED_PTR_ARG)).SetReturn(QUERY_RESPONSE_HEADER_ITEM_TYPE_VALUE_INDIVIDUAL_ENROLLMENT);
+    if (cont_token != NULL)
+    {
+        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, cont_token));
+    }
+    STRICT_EXPECTED_CALL(queryType_stringToEnum(QUERY_RESPONSE_HEADER_ITEM_TYPE_VALUE_INDIVIDUAL_ENROLLMENT)); //cannot fail
+    STRICT_EXPECTED_CALL(queryPage_deserializeFromJson(IGNORED_PTR_ARG, QUERY_TYPE_INDIVIDUAL_ENROLLMENT));
+    STRICT_EXPECTED_CALL(gballoc_free(NULL)); //previous continuation token
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)); //cannot fail
+    STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG)); //cannot fail
+    STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG)); //cannot fail
+}
+
+/*Tests_PROVISIONING_SERVICE_CLIENT_22_107: [ If prov_client or query_spec are NULL, or query_spec has invalid values, the query iterator create functions shall fail and return NULL ]*/
+TEST_FUNCTION(prov_sc_create_individual_enrollment_query_iterator_NULL_prov)
+{
+    //arrange
+    PROVISIONING_QUERY_SPECIFICATION qs = { 0 };
+    qs.page_size = NO_MAX_PAGE_SIZE;
+    qs.query_string = TEST_QUERY_STRING;
+    qs.version = PROVISIONING_QUERY_SPECIFICATION_VERSION_1;
+
+    //act
+    PROVISIONING_QUERY_ITERATOR_HANDLE iterator = prov_sc_create_individual_enrollment_query_iterator(NULL, &qs);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(iterator);
+
+    //cleanup
+}
+
+/*Tests_PROVISIONING_SERVICE_CLIENT_22_107: [ If prov_client or query_spec are NULL, or query_spec has invalid values, the query iterator create functions shall fail and return NULL ]*/
+TEST_FUNCTION(prov_sc_create_individual_enrollment_query_iterator_invalid_query_spec_version)
+{
+    //arrange
+    PROVISIONING_SERVICE_CLIENT_HANDLE sc = prov_sc_create_from_connection_string(TEST_CONNECTION_STRING);
+    PROVISIONING_QUERY_SPECIFICATION qs = { 0 };
+    qs.page_size = NO_MAX_PAGE_SIZE;
+    qs.query_string = TEST_QUERY_STRING;
+    qs.version = 47474747;
+    umock_c_reset_all_calls();
+
+    //act
+    PROVISIONING_QUERY_ITERATOR_HANDLE iterator = prov_sc_create_individual_enrollment_query_iterator(sc, &qs);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(iterator);
+
+    //cleanup
+    prov_sc_destroy(sc);
+}
+
+/*Tests_PROVISIONING_SERVICE_CLIENT_22_108: [ The query iterator create functions shall open a connection to the Provisioning Service that is kept for the lifetime of the iterator, and return NULL if it cannot be opened ]*/
+TEST_FUNCTION(prov_sc_create_individual_enrollment_query_iterator_success)
+{
+    //arrange
+    PROVISIONING_SERVICE_CLIENT_HANDLE sc = prov_sc_create_from_connection_string(TEST_CONNECTION_STRING);
+    PROVISIONING_QUERY_SPECIFICATION qs = { 0 };
+    qs.page_size = NO_MAX_PAGE_SIZE;
+    qs.query_string = TEST_QUERY_STRING;
+    qs.version = PROVISIONING_QUERY_SPECIFICATION_VERSION_1;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(querySpecification_serializeToJson(&qs));
+    expected_calls_construct_registration_path(false);
+    expected_calls_connect_to_service();
+
+    //act
+    PROVISIONING_QUERY_ITERATOR_HANDLE iterator = prov_sc_create_individual_enrollment_query_iterator(sc, &qs);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NOT_NULL(iterator);
+
+    //cleanup
+    prov_sc_query_iterator_destroy(iterator);
+    prov_sc_destroy(sc);
+}
+
+/*Tests_PROVISIONING_SERVICE_CLIENT_22_108: [ The query iterator create functions shall open a connection to the Provisioning Service that is kept for the lifetime of the iterator, and return NULL if it cannot be opened ]*/
+TEST_FUNCTION(prov_sc_create_individual_enrollment_query_iterator_connect_fail)
+{
+    //arrange
+    PROVISIONING_SERVICE_CLIENT_HANDLE sc = prov_sc_create_from_connection_string(TEST_CONNECTION_STRING);
+    PROVISIONING_QUERY_SPECIFICATION qs = { 0 };
+    qs.page_size = NO_MAX_PAGE_SIZE;
+    qs.query_string = TEST_QUERY_STRING;
+    qs.version = PROVISIONING_QUERY_SPECIFICATION_VERSION_1;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(querySpecification_serializeToJson(&qs));
+    expected_calls_construct_registration_path(false);
+    STRICT_EXPECTED_CALL(platform_get_default_tlsio());
+    STRICT_EXPECTED_CALL(uhttp_client_create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG)).SetReturn(NULL);
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)); //cannot fail
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)); //cannot fail
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)); //cannot fail
+
+    //act
+    PROVISIONING_QUERY_ITERATOR_HANDLE iterator = prov_sc_create_individual_enrollment_query_iterator(sc, &qs);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(iterator);
+
+    //cleanup
+    prov_sc_destroy(sc);
+}
+
+/*Tests_PROVISIONING_SERVICE_CLIENT_22_109: [ If iterator or record are NULL, prov_sc_query_iterator_next shall fail and return a non-zero value ]*/
+TEST_FUNCTION(prov_sc_query_iterator_next_NULL_iterator)
+{
+    //arrange
+    PROVISIONING_QUERY_RECORD record;
+
+    //act
+    int res = prov_sc_query_iterator_next(NULL, &record);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, res);
+
+    //cleanup
+}
+
+/*Tests_PROVISIONING_SERVICE_CLIENT_22_110: [ prov_sc_query_iterator_next shall free the record it handed out last ]*/
+/*Tests_PROVISIONING_SERVICE_CLIENT_22_111: [ prov_sc_query_iterator_next shall deserialize only the next record of the current page into record ]*/
+/*Tests_PROVISIONING_SERVICE_CLIENT_22_113: [ Once every record of the last page has been handed out, prov_sc_query_iterator_next shall set the record_type of record to QUERY_TYPE_INVALID and return 0 ]*/
+TEST_FUNCTION(prov_sc_query_iterator_next_single_page_success)
+{
+    //arrange
+    PROVISIONING_SERVICE_CLIENT_HANDLE sc = prov_sc_create_from_connection_string(TEST_CONNECTION_STRING);
+    PROVISIONING_QUERY_SPECIFICATION qs = { 0 };
+    qs.page_size = NO_MAX_PAGE_SIZE;
+    qs.query_string = TEST_QUERY_STRING;
+    qs.version = PROVISIONING_QUERY_SPECIFICATION_VERSION_1;
+    PROVISIONING_QUERY_ITERATOR_HANDLE iterator = prov_sc_create_individual_enrollment_query_iterator(sc, &qs);
+    PROVISIONING_QUERY_RECORD record;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(queryRecord_free(IGNORED_PTR_ARG)); //cannot fail
+    STRICT_EXPECTED_CALL(queryPage_free(NULL)); //cannot fail
+    STRICT_EXPECTED_CALL(uhttp_client_dowork(IGNORED_PTR_ARG)); //does not fail
+    expected_calls_send_query_iterator_request(false);
+    STRICT_EXPECTED_CALL(queryPage_free(NULL)); //cannot fail
+    STRICT_EXPECTED_CALL(uhttp_client_dowork(IGNORED_PTR_ARG)); //does not fail
+    STRICT_EXPECTED_CALL(HTTPHeaders_Clone(IGNORED_PTR_ARG)); //this is in a callback for on_query_iterator_reply_recv
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)); //this is also in the callback
+    expected_calls_load_query_iterator_page(NULL);
+    STRICT_EXPECTED_CALL(queryPage_getRecordCount(IGNORED_PTR_ARG)); //cannot fail
+    STRICT_EXPECTED_CALL(queryPage_getRecord(IGNORED_PTR_ARG, 0, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(uhttp_client_dowork(IGNORED_PTR_ARG)); //does not fail
+
+    //act
+    int res = prov_sc_query_iterator_next(iterator, &record);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, res);
+    ASSERT_IS_TRUE(record.record_type == QUERY_TYPE_INDIVIDUAL_ENROLLMENT);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_INDIVIDUAL_ENROLLMENT_HANDLE, record.record.ie);
+
+    //act
+    res = prov_sc_query_iterator_next(iterator, &record);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, 0, res);
+    ASSERT_IS_TRUE(record.record_type == QUERY_TYPE_INVALID);
+    ASSERT_IS_NULL(record.record.ie);
+
+    //cleanup
+    prov_sc_query_iterator_destroy(iterator);
+    prov_sc_destroy(sc);
+}
+
+/*Tests_PROVISIONING_SERVICE_CLIENT_22_112: [ Once a page has arrived and carries a continuation token, a 'POST' REST call for the following page shall be issued before any of its records is handed out ]*/
+TEST_FUNCTION(prov_sc_query_iterator_next_prefetches_next_page)
+{
+    //arrange
+    PROVISIONING_SERVICE_CLIENT_HANDLE sc = prov_sc_create_from_connection_string(TEST_CONNECTION_STRING);
+    PROVISIONING_QUERY_SPECIFICATION qs = { 0 };
+    qs.page_size = NO_MAX_PAGE_SIZE;
+    qs.query_string = TEST_QUERY_STRING;
+    qs.version = PROVISIONING_QUERY_SPECIFICATION_VERSION_1;
+    REGISTER_GLOBAL_MOCK_HOOK(uhttp_client_dowork, my_uhttp_client_dowork_persistent);
+    PROVISIONING_QUERY_ITERATOR_HANDLE iterator = prov_sc_create_individual_enrollment_query_iterator(sc, &qs);
+    PROVISIONING_QUERY_RECORD record;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(queryRecord_free(IGNORED_PTR_ARG)); //cannot fail
+    STRICT_EXPECTED_CALL(queryPage_free(NULL)); //cannot fail
+    STRICT_EXPECTED_CALL(uhttp_client_dowork(IGNORED_PTR_ARG)); //does not fail
+    expected_calls_send_query_iterator_request(false);
+    STRICT_EXPECTED_CALL(queryPage_free(NULL)); //cannot fail
+    STRICT_EXPECTED_CALL(uhttp_client_dowork(IGNORED_PTR_ARG)); //does not fail
+    STRICT_EXPECTED_CALL(HTTPHeaders_Clone(IGNORED_PTR_ARG)); //this is in a callback for on_query_iterator_reply_recv
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)); //this is also in the callback
+    expected_calls_load_query_iterator_page(TEST_CONT_TOKEN);
+    STRICT_EXPECTED_CALL(queryPage_getRecordCount(IGNORED_PTR_ARG)); //cannot fail
+    STRICT_EXPECTED_CALL(queryPage_getRecord(IGNORED_PTR_ARG, 0, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(uhttp_client_dowork(IGNORED_PTR_ARG)); //does not fail
+    expected_calls_send_query_iterator_request(true);
+
+    //act
+    int res = prov_sc_query_iterator_next(iterator, &record);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, res);
+    ASSERT_IS_TRUE(record.record_type == QUERY_TYPE_INDIVIDUAL_ENROLLMENT);
+
+    //cleanup
+    REGISTER_GLOBAL_MOCK_HOOK(uhttp_client_dowork, my_uhttp_client_dowork);
+    prov_sc_query_iterator_destroy(iterator);
+    prov_sc_destroy(sc);
+}
+
+/*Tests_PROVISIONING_SERVICE_CLIENT_22_114: [ If a page cannot be retrieved or a record cannot be deserialized, prov_sc_query_iterator_next shall fail and return a non-zero value ]*/
+TEST_FUNCTION(prov_sc_query_iterator_next_execute_request_fail)
+{
+    //arrange
+    PROVISIONING_SERVICE_CLIENT_HANDLE sc = prov_sc_create_from_connection_string(TEST_CONNECTION_STRING);
+    PROVISIONING_QUERY_SPECIFICATION qs = { 0 };
+    qs.page_size = NO_MAX_PAGE_SIZE;
+    qs.query_string = TEST_QUERY_STRING;
+    qs.version = PROVISIONING_QUERY_SPECIFICATION_VERSION_1;
+    PROVISIONING_QUERY_ITERATOR_HANDLE iterator = prov_sc_create_individual_enrollment_query_iterator(sc, &qs);
+    PROVISIONING_QUERY_RECORD record;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(queryRecord_free(IGNORED_PTR_ARG)); //cannot fail
+    STRICT_EXPECTED_CALL(queryPage_free(NULL)); //cannot fail
+    STRICT_EXPECTED_CALL(uhttp_client_dowork(IGNORED_PTR_ARG)); //does not fail
+    expected_calls_construct_http_headers(NO_ETAG, HTTP_CLIENT_REQUEST_POST);
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)); //cannot fail
+    STRICT_EXPECTED_CALL(uhttp_client_execute_request(IGNORED_PTR_ARG, HTTP_CLIENT_REQUEST_POST, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .SetReturn(HTTP_CLIENT_ERROR);
+    STRICT_EXPECTED_CALL(queryPage_free(NULL)); //cannot fail
+
+    //act
+    int res = prov_sc_query_iterator_next(iterator, &record);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, res);
+    ASSERT_IS_TRUE(record.record_type == QUERY_TYPE_INVALID);
+
+    //cleanup
+    prov_sc_query_iterator_destroy(iterator);
+    prov_sc_destroy(sc);
+}
+
+/*Tests_PROVISIONING_SERVICE_CLIENT_22_115: [ prov_sc_query_iterator_destroy shall free the last record, the current page, any reply in flight and close the connection ]*/
+TEST_FUNCTION(prov_sc_query_iterator_destroy_success)
+{
+    //arrange
+    PROVISIONING_SERVICE_CLIENT_HANDLE sc = prov_sc_create_from_connection_string(TEST_CONNECTION_STRING);
+    PROVISIONING_QUERY_SPECIFICATION qs = { 0 };
+    qs.page_size = NO_MAX_PAGE_SIZE;
+    qs.query_string = TEST_QUERY_STRING;
+    qs.version = PROVISIONING_QUERY_SPECIFICATION_VERSION_1;
+    PROVISIONING_QUERY_ITERATOR_HANDLE iterator = prov_sc_create_individual_enrollment_query_iterator(sc, &qs);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(queryRecord_free(IGNORED_PTR_ARG)); //cannot fail
+    STRICT_EXPECTED_CALL(queryPage_free(NULL)); //cannot fail
+    STRICT_EXPECTED_CALL(gballoc_free(NULL)); //cannot fail
+    STRICT_EXPECTED_CALL(HTTPHeaders_Free(NULL)); //cannot fail
+    STRICT_EXPECTED_CALL(HTTPHeaders_Free(NULL)); //cannot fail
+    STRICT_EXPECTED_CALL(uhttp_client_close(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG)); //does not fail
+    STRICT_EXPECTED_CALL(uhttp_client_destroy(IGNORED_PTR_ARG)); //does not fail
+    STRICT_EXPECTED_CALL(gballoc_free(NULL)); //cannot fail
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)); //cannot fail
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG)); //cannot fail
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)); //cannot fail
+
+    //act
+    prov_sc_query_iterator_destroy(iterator);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    prov_sc_destroy(sc);
+}
+
 END_TEST_SUITE(provisioning_service_client_ut);
\ No newline at end of file
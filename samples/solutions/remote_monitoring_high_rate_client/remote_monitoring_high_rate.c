@@ -0,0 +1,355 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+// This sample is the high-rate variant of remote_monitoring.c, for devices that send telemetry many times a second.
+// It simulates the same Chiller device and shows how to:
+// - Send each round of readings as one batch (IoTHubDeviceClient_SendEventBatchAsync) instead of one message at a time.
+// - Let the client worker sleep until there is work (OPTION_DO_WORK_MAX_IDLE_MS) instead of polling at a fixed frequency.
+// - Bound the telemetry in flight (OPTION_MAX_PENDING_BYTES), dropping readings rather than queuing without limit.
+// - Report only the properties that changed, merging close reports into one patch (OPTION_TWIN_COALESCE_WINDOW).
+// - Parse each desired properties update once, whether it is the whole twin or a patch.
+// - Print the messages confirmed per second and the send latency (OPTION_ENABLE_STATISTICS).
+
+// CAVEAT: This sample is to demonstrate azure IoT client concepts only and is not a guide design principles or style
+// Checking of return codes and error values are omitted for brevity.  Please practice sound engineering practices
+// when writing production code.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "iothub.h"
+#include "iothub_device_client.h"
+#include "iothub_client_options.h"
+#include "iothub_message.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/crt_abstractions.h"
+#include "azure_c_shared_utility/tickcounter.h"
+#include "iothubtransportmqtt.h"
+#include "parson.h"
+
+#define MESSAGERESPONSE(code, message) const char deviceMethodResponse[] = message; \
+	*response_size = sizeof(deviceMethodResponse) - 1;                              \
+	*response = malloc(*response_size);                                             \
+	(void)memcpy(*response, deviceMethodResponse, *response_size);                  \
+	result = code;                                                                  \
+
+/* Readings of one round: temperature, pressure and humidity */
+#define READINGS_PER_ROUND 3
+
+/* Paste in your device connection string  */
+static const char* connectionString = "<connectionstring>";
+
+/* Rounds of readings sent per second, until the TelemetryRate desired property changes it */
+static const unsigned int initialTelemetryRate = 20;
+/* Longest the client worker sleeps while it has nothing to do; it is woken as soon as there is */
+static const unsigned int maxIdleMs = 1000;
+/* Telemetry bytes allowed in flight before readings are dropped */
+static const size_t maxPendingBytes = 64 * 1024;
+/* Reported properties sent within this many ms of each other go in one patch */
+static const tickcounter_ms_t twinCoalesceWindowMs = 500;
+
+typedef struct CHILLER_TAG
+{
+	// Reported properties, only sent again when they change
+	const char* status;
+	unsigned int telemetryRate;
+
+	// Last values reported, to send deltas
+	const char* reportedStatus;
+	unsigned int reportedTelemetryRate;
+
+	// Readings dropped because too much telemetry was in flight
+	size_t dropped;
+} Chiller;
+
+static void connection_status_callback(IOTHUB_CLIENT_CONNECTION_STATUS result, IOTHUB_CLIENT_CONNECTION_STATUS_REASON reason, void* user_context)
+{
+	(void)reason;
+	(void)user_context;
+	if (result == IOTHUB_CLIENT_CONNECTION_AUTHENTICATED)
+	{
+		(void)printf("The device client is connected to iothub\r\n");
+	}
+	else
+	{
+		(void)printf("The device client has been disconnected\r\n");
+	}
+}
+
+static void send_confirm_callback(IOTHUB_CLIENT_CONFIRMATION_RESULT result, void* userContextCallback)
+{
+	(void)userContextCallback;
+	if (result != IOTHUB_CLIENT_CONFIRMATION_OK)
+	{
+		(void)printf("Batch confirmed with result %s\r\n", ENUM_TO_STRING(IOTHUB_CLIENT_CONFIRMATION_RESULT, result));
+	}
+}
+
+static void reported_state_callback(int status_code, void* userContextCallback)
+{
+	(void)userContextCallback;
+	if (status_code < 200 || status_code >= 300)
+	{
+		(void)printf("Device Twin reported properties update failed with result: %d\r\n", status_code);
+	}
+}
+
+// <reporteddelta>
+/* Sends the reported properties that changed since they were last sent, if any. The capabilities are sent once, at startup. */
+static void send_changed_reported_properties(IOTHUB_DEVICE_CLIENT_HANDLE device_handle, Chiller* chiller)
+{
+	JSON_Value* root_value = json_value_init_object();
+	JSON_Object* root_object = json_value_get_object(root_value);
+
+	if (chiller->reportedStatus != chiller->status)
+	{
+		(void)json_object_set_string(root_object, "Status", chiller->status);
+		chiller->reportedStatus = chiller->status;
+	}
+	if (chiller->reportedTelemetryRate != chiller->telemetryRate)
+	{
+		(void)json_object_set_number(root_object, "TelemetryRate", chiller->telemetryRate);
+		chiller->reportedTelemetryRate = chiller->telemetryRate;
+	}
+
+	if (json_object_get_count(root_object) != 0)
+	{
+		char* reportedProperties = json_serialize_to_string(root_value);
+		(void)IoTHubDeviceClient_SendReportedState(device_handle, (const unsigned char*)reportedProperties, strlen(reportedProperties), reported_state_callback, NULL);
+		json_free_serialized_string(reportedProperties);
+	}
+
+	json_value_free(root_value);
+}
+
+static void send_capabilities(IOTHUB_DEVICE_CLIENT_HANDLE device_handle)
+{
+	const char* capabilities =
+		"{\"Protocol\":\"MQTT\",\"SupportedMethods\":\"Reboot,EmergencyValveRelease,IncreasePressure\",\"Type\":\"Chiller\","
+		"\"Location\":\"Building 44\",\"Latitude\":47.638928,\"Longitude\":-122.13476,"
+		"\"Telemetry\":{\"ChillerSchema\":{\"MessageSchema\":{\"Name\":\"chiller-reading;v1\",\"Format\":\"JSON\",\"Fields\":\"{\\\"value\\\":\\\"Double\\\",\\\"unit\\\":\\\"Text\\\"}\"}}}}";
+
+	(void)IoTHubDeviceClient_SendReportedState(device_handle, (const unsigned char*)capabilities, strlen(capabilities), reported_state_callback, NULL);
+}
+// </reporteddelta>
+
+// <desiredproperties>
+/* The whole twin holds the desired properties under "desired", a patch holds them at its root. Either way the update is parsed once. */
+static void device_twin_callback(DEVICE_TWIN_UPDATE_STATE update_state, const unsigned char* payLoad, size_t size, void* userContextCallback)
+{
+	Chiller* chiller = (Chiller*)userContextCallback;
+	char* json = (char*)malloc(size + 1);
+
+	if (json != NULL)
+	{
+		(void)memcpy(json, payLoad, size);
+		json[size] = '\0';
+
+		JSON_Value* root_value = json_parse_string(json);
+		JSON_Object* root_object = json_value_get_object(root_value);
+		JSON_Object* desired_object = (update_state == DEVICE_TWIN_UPDATE_COMPLETE) ? json_object_get_object(root_object, "desired") : root_object;
+
+		if (desired_object != NULL && json_object_has_value_of_type(desired_object, "TelemetryRate", JSONNumber))
+		{
+			double rate = json_object_get_number(desired_object, "TelemetryRate");
+			if (rate >= 1 && rate <= 1000)
+			{
+				chiller->telemetryRate = (unsigned int)rate;
+				(void)printf("Telemetry rate set to %u rounds per second\r\n", chiller->telemetryRate);
+			}
+		}
+
+		json_value_free(root_value);
+		free(json);
+	}
+}
+// </desiredproperties>
+
+static int device_method_callback(const char* method_name, const unsigned char* payload, size_t size, unsigned char** response, size_t* response_size, void* userContextCallback)
+{
+	Chiller *chiller = (Chiller *)userContextCallback;
+	int result;
+
+	(void)payload;
+	(void)size;
+	(void)printf("Direct method name:    %s\r\n", method_name);
+
+	if (strcmp("Reboot", method_name) == 0)
+	{
+		MESSAGERESPONSE(201, "{ \"Response\": \"Rebooting\" }")
+	}
+	else if (strcmp("EmergencyValveRelease", method_name) == 0)
+	{
+		chiller->status = "ValveReleased";
+		MESSAGERESPONSE(201, "{ \"Response\": \"Releasing emergency valve\" }")
+	}
+	else if (strcmp("IncreasePressure", method_name) == 0)
+	{
+		chiller->status = "Running";
+		MESSAGERESPONSE(201, "{ \"Response\": \"Increasing pressure\" }")
+	}
+	else
+	{
+		(void)printf("Method not recognized\r\n");
+		MESSAGERESPONSE(400, "{ \"Response\": \"Method not recognized\" }")
+	}
+
+	return result;
+}
+
+// <sendbatch>
+static IOTHUB_MESSAGE_HANDLE create_reading(const char* name, double value, const char* unit)
+{
+	char msgText[128];
+	IOTHUB_MESSAGE_HANDLE message_handle;
+
+	(void)sprintf_s(msgText, sizeof(msgText), "{\"%s\":%.2f,\"%s_unit\":\"%s\"}", name, value, name, unit);
+	message_handle = IoTHubMessage_CreateFromString(msgText);
+
+	(void)IoTHubMessage_SetContentTypeSystemProperty(message_handle, "application%2fjson");
+	(void)IoTHubMessage_SetContentEncodingSystemProperty(message_handle, "utf-8");
+	(void)Map_AddOrUpdate(IoTHubMessage_Properties(message_handle), "$$MessageSchema", "chiller-reading;v1");
+
+	return message_handle;
+}
+
+/* Sends one round of readings as a single batch; the client copies the messages, so they are destroyed right away */
+static void send_readings(IOTHUB_DEVICE_CLIENT_HANDLE device_handle, Chiller* chiller)
+{
+	IOTHUB_MESSAGE_HANDLE readings[READINGS_PER_ROUND];
+	size_t index;
+
+	readings[0] = create_reading("temperature", 50.0 + (rand() % 10) + 5, "F");
+	readings[1] = create_reading("pressure", 55.0 + (rand() % 10) + 5, "psig");
+	readings[2] = create_reading("humidity", 30.0 + (rand() % 20) + 5, "%");
+
+	if (IoTHubDeviceClient_SendEventBatchAsync(device_handle, readings, READINGS_PER_ROUND, send_confirm_callback, NULL) != IOTHUB_CLIENT_OK)
+	{
+		// Past OPTION_MAX_PENDING_BYTES: the connection cannot keep up, drop this round instead of queuing it
+		chiller->dropped += READINGS_PER_ROUND;
+	}
+
+	for (index = 0; index < READINGS_PER_ROUND; index++)
+	{
+		IoTHubMessage_Destroy(readings[index]);
+	}
+}
+// </sendbatch>
+
+// <livestatistics>
+static double mean_ms(const IOTHUB_CLIENT_LATENCY_HISTOGRAM* histogram)
+{
+	return (histogram->count == 0) ? 0 : (double)histogram->sum_ms / (double)histogram->count;
+}
+
+static void print_statistics(IOTHUB_DEVICE_CLIENT_HANDLE device_handle, Chiller* chiller, uint64_t* last_confirmed, tickcounter_ms_t elapsed_ms)
+{
+	IOTHUB_CLIENT_STATISTICS statistics;
+
+	if (elapsed_ms != 0 && IoTHubDeviceClient_GetStatistics(device_handle, &statistics) == IOTHUB_CLIENT_OK)
+	{
+		(void)printf("%.1f msgs/s confirmed, queue to publish %.1f ms mean, publish to ack %.1f ms mean / %lu ms max, %lu waiting, %lu dropped\r\n",
+			(double)(statistics.events_confirmed - *last_confirmed) * 1000.0 / (double)elapsed_ms,
+			mean_ms(&statistics.enqueue_to_publish),
+			mean_ms(&statistics.publish_to_ack),
+			(unsigned long)statistics.publish_to_ack.max_ms,
+			(unsigned long)statistics.waiting_to_send,
+			(unsigned long)chiller->dropped);
+		*last_confirmed = statistics.events_confirmed;
+	}
+}
+// </livestatistics>
+
+// <main>
+int main(void)
+{
+	IOTHUB_DEVICE_CLIENT_HANDLE device_handle;
+	TICK_COUNTER_HANDLE tick_counter;
+
+	srand((unsigned int)time(NULL));
+
+	(void)printf("This sample simulates a high-rate Chiller device connected to the Remote Monitoring solution accelerator\r\n\r\n");
+
+	// Used to initialize sdk subsystem
+	(void)IoTHub_Init();
+
+	(void)printf("Creating IoTHub handle\r\n");
+	device_handle = IoTHubDeviceClient_CreateFromConnectionString(connectionString, MQTT_Protocol);
+	if (device_handle == NULL)
+	{
+		(void)printf("Failure creating Iothub device.  Hint: Check you connection string.\r\n");
+	}
+	else if ((tick_counter = tickcounter_create()) == NULL)
+	{
+		(void)printf("Failure creating the tick counter\r\n");
+		IoTHubDeviceClient_Destroy(device_handle);
+	}
+	else
+	{
+		bool enableStatistics = true;
+		Chiller chiller;
+		uint64_t last_confirmed = 0;
+		tickcounter_ms_t now;
+		tickcounter_ms_t last_statistics;
+		tickcounter_ms_t next_round;
+
+		memset(&chiller, 0, sizeof(Chiller));
+		chiller.status = "Running";
+		chiller.telemetryRate = initialTelemetryRate;
+
+		// Set the options before anything is queued
+		(void)IoTHubDeviceClient_SetOption(device_handle, OPTION_DO_WORK_MAX_IDLE_MS, &maxIdleMs);
+		(void)IoTHubDeviceClient_SetOption(device_handle, OPTION_MAX_PENDING_BYTES, &maxPendingBytes);
+		(void)IoTHubDeviceClient_SetOption(device_handle, OPTION_TWIN_COALESCE_WINDOW, &twinCoalesceWindowMs);
+		(void)IoTHubDeviceClient_SetOption(device_handle, OPTION_ENABLE_STATISTICS, &enableStatistics);
+
+		(void)IoTHubDeviceClient_SetConnectionStatusCallback(device_handle, connection_status_callback, NULL);
+		(void)IoTHubDeviceClient_SetDeviceTwinCallback(device_handle, device_twin_callback, &chiller);
+		(void)IoTHubDeviceClient_SetDeviceMethodCallback(device_handle, device_method_callback, &chiller);
+
+		send_capabilities(device_handle);
+
+		(void)tickcounter_get_current_ms(tick_counter, &now);
+		last_statistics = now;
+		next_round = now;
+
+		while (1)
+		{
+			unsigned int period_ms = 1000 / chiller.telemetryRate;
+
+			(void)tickcounter_get_current_ms(tick_counter, &now);
+			if (now >= next_round)
+			{
+				send_readings(device_handle, &chiller);
+				send_changed_reported_properties(device_handle, &chiller);
+				// Keep to the rate even when a round runs late, without bursting to catch up
+				next_round = (now - next_round >= period_ms) ? now + period_ms : next_round + period_ms;
+			}
+
+			if (now - last_statistics >= 1000)
+			{
+				print_statistics(device_handle, &chiller, &last_confirmed, now - last_statistics);
+				last_statistics = now;
+			}
+
+			// Nothing to do until the next round: the client worker runs on its own, woken by the batch just queued
+			(void)tickcounter_get_current_ms(tick_counter, &now);
+			if (next_round > now)
+			{
+				ThreadAPI_Sleep((unsigned int)(next_round - now));
+			}
+		}
+
+		(void)printf("\r\nShutting down\r\n");
+
+		// Clean up the iothub sdk handle and free resources
+		IoTHubDeviceClient_Destroy(device_handle);
+		tickcounter_destroy(tick_counter);
+	}
+	// Shutdown the sdk subsystem
+	IoTHub_Deinit();
+
+	return 0;
+}
+// </main>
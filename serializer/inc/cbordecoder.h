@@ -0,0 +1,37 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef CBORDECODER_H
+#define CBORDECODER_H
+
+#include "azure_c_shared_utility/macro_utils.h"
+#include "azure_c_shared_utility/strings.h"
+
+#ifdef __cplusplus
+#include <cstddef>
+extern "C" {
+#else
+#include <stddef.h>
+#endif
+
+/*maps and arrays nested deeper than this are rejected*/
+#define CBOR_DECODER_MAX_DEPTH 32
+
+#define CBOR_DECODER_RESULT_VALUES           \
+CBOR_DECODER_OK,                             \
+CBOR_DECODER_INVALID_ARG,                    \
+CBOR_DECODER_SYNTAX_ERROR,                   \
+CBOR_DECODER_UNSUPPORTED,                    \
+CBOR_DECODER_ERROR
+
+DEFINE_ENUM(CBOR_DECODER_RESULT, CBOR_DECODER_RESULT_VALUES);
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+MOCKABLE_FUNCTION(, CBOR_DECODER_RESULT, CBORDecoder_ToJSON, const unsigned char*, source, size_t, sourceSize, STRING_HANDLE, destination);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CBORDECODER_H */
@@ -0,0 +1,49 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef CBORENCODER_H
+#define CBORENCODER_H
+
+#include "azure_c_shared_utility/macro_utils.h"
+
+#ifdef __cplusplus
+#include <cstddef>
+#include <cstdint>
+extern "C" {
+#else
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#endif
+
+/*content type of the messages serialized with CBOR (RFC 7049)*/
+#define CBOR_CONTENT_TYPE "application/cbor"
+
+/*the longest item header: the initial byte followed by a 64 bit argument*/
+#define CBOR_ENCODER_MAX_HEADER_SIZE 9
+
+#define CBOR_ENCODER_RESULT_VALUES           \
+CBOR_ENCODER_OK,                             \
+CBOR_ENCODER_INVALID_ARG,                    \
+CBOR_ENCODER_BUFFER_TOO_SMALL
+
+DEFINE_ENUM(CBOR_ENCODER_RESULT, CBOR_ENCODER_RESULT_VALUES);
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+/*all the functions append an item at destination + *size and advance *size. Nothing is written when the item does not fit*/
+MOCKABLE_FUNCTION(, CBOR_ENCODER_RESULT, CBOREncoder_WriteMapHeader, unsigned char*, destination, size_t, destinationCapacity, size_t*, size, size_t, pairCount);
+MOCKABLE_FUNCTION(, CBOR_ENCODER_RESULT, CBOREncoder_WriteArrayHeader, unsigned char*, destination, size_t, destinationCapacity, size_t*, size, size_t, itemCount);
+MOCKABLE_FUNCTION(, CBOR_ENCODER_RESULT, CBOREncoder_WriteTextString, unsigned char*, destination, size_t, destinationCapacity, size_t*, size, const char*, text, size_t, length);
+MOCKABLE_FUNCTION(, CBOR_ENCODER_RESULT, CBOREncoder_WriteByteString, unsigned char*, destination, size_t, destinationCapacity, size_t*, size, const unsigned char*, bytes, size_t, length);
+MOCKABLE_FUNCTION(, CBOR_ENCODER_RESULT, CBOREncoder_WriteInt64, unsigned char*, destination, size_t, destinationCapacity, size_t*, size, int64_t, value);
+MOCKABLE_FUNCTION(, CBOR_ENCODER_RESULT, CBOREncoder_WriteBoolean, unsigned char*, destination, size_t, destinationCapacity, size_t*, size, bool, value);
+#ifndef NO_FLOATS
+MOCKABLE_FUNCTION(, CBOR_ENCODER_RESULT, CBOREncoder_WriteDouble, unsigned char*, destination, size_t, destinationCapacity, size_t*, size, double, value);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CBORENCODER_H */
@@ -157,7 +157,8 @@ CODEFIRST_AGENT_DATA_TYPE_ERROR,               \
 CODEFIRST_VALUES_FROM_DIFFERENT_DEVICES_ERROR, \
 CODEFIRST_DEVICE_FAILED,                       \
 CODEFIRST_DEVICE_PUBLISH_FAILED,               \
-CODEFIRST_NOT_A_PROPERTY
+CODEFIRST_NOT_A_PROPERTY,                      \
+CODEFIRST_BUFFER_TOO_SMALL
 
 DEFINE_ENUM(CODEFIRST_RESULT, CODEFIRST_RESULT_VALUES)
 
@@ -178,9 +179,17 @@ MOCKABLE_FUNCTION(, void*, CodeFirst_CreateDevice, SCHEMA_MODEL_TYPE_HANDLE, mod
 MOCKABLE_FUNCTION(, void, CodeFirst_DestroyDevice, void*, device);
 
 extern CODEFIRST_RESULT CodeFirst_SendAsync(unsigned char** destination, size_t* destinationSize, size_t numProperties, ...);
+extern CODEFIRST_RESULT CodeFirst_SendAsyncToBuffer(unsigned char* destination, size_t destinationCapacity, size_t* destinationSize, size_t numProperties, ...);
+extern CODEFIRST_RESULT CodeFirst_SendAsyncToBufferCbor(unsigned char* destination, size_t destinationCapacity, size_t* destinationSize, size_t numProperties, ...);
+MOCKABLE_FUNCTION(, CODEFIRST_RESULT, CodeFirst_SendBatchToBuffer, unsigned char*, destination, size_t, destinationCapacity, size_t*, destinationSize, void* const*, devices, size_t, deviceCount);
+MOCKABLE_FUNCTION(, CODEFIRST_RESULT, CodeFirst_SendBatchToBufferCbor, unsigned char*, destination, size_t, destinationCapacity, size_t*, destinationSize, void* const*, devices, size_t, deviceCount);
 extern CODEFIRST_RESULT CodeFirst_SendAsyncReported(unsigned char** destination, size_t* destinationSize, size_t numReportedProperties, ...);
+MOCKABLE_FUNCTION(, CODEFIRST_RESULT, CodeFirst_SendAsyncReportedChanges, unsigned char**, destination, size_t*, destinationSize, void*, device);
+MOCKABLE_FUNCTION(, void, CodeFirst_ResetReportedChanges, void*, device);
+MOCKABLE_FUNCTION(, CODEFIRST_RESULT, CodeFirst_SetReportedChangesDeadband, void*, device, double, deadband);
 
 MOCKABLE_FUNCTION(, CODEFIRST_RESULT, CodeFirst_IngestDesiredProperties, void*, device, const char*, jsonPayload, bool, parseDesiredNode);
+MOCKABLE_FUNCTION(, CODEFIRST_RESULT, CodeFirst_IngestDesiredPropertiesCbor, void*, device, const unsigned char*, cborPayload, size_t, cborPayloadSize, bool, parseDesiredNode);
 
 MOCKABLE_FUNCTION(, AGENT_DATA_TYPE_TYPE, CodeFirst_GetPrimitiveType, const char*, typeName);
 
@@ -25,7 +25,8 @@ DATA_MARSHALLER_JSON_ENCODER_ERROR,             \
 DATA_MARSHALLER_ERROR,                          \
 DATA_MARSHALLER_AGENT_DATA_TYPES_ERROR,         \
 DATA_MARSHALLER_MULTITREE_ERROR,                \
-DATA_MARSHALLER_ONLY_ONE_VALUE_ALLOWED          \
+DATA_MARSHALLER_ONLY_ONE_VALUE_ALLOWED,         \
+DATA_MARSHALLER_BUFFER_TOO_SMALL                \
 
 DEFINE_ENUM(DATA_MARSHALLER_RESULT, DATA_MARSHALLER_RESULT_VALUES);
 
@@ -36,11 +37,18 @@ typedef struct DATA_MARSHALLER_VALUE_TAG
 } DATA_MARSHALLER_VALUE;
 
 typedef struct DATA_MARSHALLER_HANDLE_DATA_TAG* DATA_MARSHALLER_HANDLE;
+typedef struct DATA_MARSHALLER_LAYOUT_TAG* DATA_MARSHALLER_LAYOUT_HANDLE;
 #include "azure_c_shared_utility/umock_c_prod.h"
 
 MOCKABLE_FUNCTION(,DATA_MARSHALLER_HANDLE, DataMarshaller_Create, SCHEMA_MODEL_TYPE_HANDLE, modelHandle, bool, includePropertyPath);
 MOCKABLE_FUNCTION(,void, DataMarshaller_Destroy, DATA_MARSHALLER_HANDLE, dataMarshallerHandle);
 MOCKABLE_FUNCTION(,DATA_MARSHALLER_RESULT, DataMarshaller_SendData, DATA_MARSHALLER_HANDLE, dataMarshallerHandle, size_t, valueCount, const DATA_MARSHALLER_VALUE*, values, unsigned char**, destination, size_t*, destinationSize);
+MOCKABLE_FUNCTION(,DATA_MARSHALLER_RESULT, DataMarshaller_SendDataToBuffer, DATA_MARSHALLER_HANDLE, dataMarshallerHandle, size_t, valueCount, const DATA_MARSHALLER_VALUE*, values, unsigned char*, destination, size_t, destinationCapacity, size_t*, destinationSize);
+
+/*a layout validates a set of property paths once, records are then values given in the order of the paths*/
+MOCKABLE_FUNCTION(,DATA_MARSHALLER_LAYOUT_HANDLE, DataMarshaller_CreateLayout, DATA_MARSHALLER_HANDLE, dataMarshallerHandle, size_t, valueCount, const char* const*, propertyPaths);
+MOCKABLE_FUNCTION(,void, DataMarshaller_DestroyLayout, DATA_MARSHALLER_LAYOUT_HANDLE, layoutHandle);
+MOCKABLE_FUNCTION(,DATA_MARSHALLER_RESULT, DataMarshaller_SendRecordToBuffer, DATA_MARSHALLER_LAYOUT_HANDLE, layoutHandle, const AGENT_DATA_TYPE*, values, unsigned char*, destination, size_t, destinationCapacity, size_t*, destinationSize);
 
 MOCKABLE_FUNCTION(, DATA_MARSHALLER_RESULT, DataMarshaller_SendData_ReportedProperties, DATA_MARSHALLER_HANDLE, dataMarshallerHandle, VECTOR_HANDLE, values, unsigned char**, destination, size_t*, destinationSize);
 
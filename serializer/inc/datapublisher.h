@@ -38,6 +38,8 @@ MOCKABLE_FUNCTION(,TRANSACTION_HANDLE, DataPublisher_StartTransaction, DATA_PUBL
 MOCKABLE_FUNCTION(,DATA_PUBLISHER_RESULT, DataPublisher_PublishTransacted, TRANSACTION_HANDLE, transactionHandle, const char*, propertyPath, const AGENT_DATA_TYPE*, data);
 MOCKABLE_FUNCTION(,DATA_PUBLISHER_RESULT, DataPublisher_EndTransaction, TRANSACTION_HANDLE, transactionHandle, unsigned char**, destination, size_t*, destinationSize);
 MOCKABLE_FUNCTION(,DATA_PUBLISHER_RESULT, DataPublisher_CancelTransaction, TRANSACTION_HANDLE, transactionHandle);
+MOCKABLE_FUNCTION(,DATA_PUBLISHER_RESULT, DataPublisher_EndTransactionToBuffer, TRANSACTION_HANDLE, transactionHandle, unsigned char*, destination, size_t, destinationCapacity, size_t*, destinationSize);
+MOCKABLE_FUNCTION(,DATA_PUBLISHER_RESULT, DataPublisher_ResetTransaction, TRANSACTION_HANDLE, transactionHandle);
 MOCKABLE_FUNCTION(,void, DataPublisher_SetMaxBufferSize, size_t, value);
 MOCKABLE_FUNCTION(,size_t, DataPublisher_GetMaxBufferSize);
 
@@ -22,8 +22,36 @@ typedef enum JSON_DECODER_RESULT_TAG
     JSON_DECODER_ERROR
 } JSON_DECODER_RESULT;
 
+/*containers nested deeper than this are reported as JSON_DECODER_PARSE_ERROR by JSONDecoder_Tokenize*/
+#define JSON_DECODER_MAX_DEPTH 64
+
+typedef enum JSON_DECODER_TOKEN_TAG
+{
+    JSON_DECODER_TOKEN_OBJECT_BEGIN,
+    JSON_DECODER_TOKEN_OBJECT_END,
+    JSON_DECODER_TOKEN_ARRAY_BEGIN,
+    JSON_DECODER_TOKEN_ARRAY_END,
+    JSON_DECODER_TOKEN_NAME,
+    JSON_DECODER_TOKEN_STRING,
+    JSON_DECODER_TOKEN_NUMBER,
+    JSON_DECODER_TOKEN_TRUE,
+    JSON_DECODER_TOKEN_FALSE,
+    JSON_DECODER_TOKEN_NULL
+} JSON_DECODER_TOKEN;
+
+/*a piece of the buffer given to JSONDecoder_Tokenize, it is not NUL terminated*/
+typedef struct JSON_DECODER_SLICE_TAG
+{
+    const char* value;
+    size_t length;
+} JSON_DECODER_SLICE;
+
+/*names and strings come without their quotes and with their escapes as they are in the buffer, returning non zero stops the tokenizer*/
+typedef int(*JSON_DECODER_TOKEN_CALLBACK)(void* context, JSON_DECODER_TOKEN token, const JSON_DECODER_SLICE* slice);
+
 #include "azure_c_shared_utility/umock_c_prod.h"
 MOCKABLE_FUNCTION(, JSON_DECODER_RESULT, JSONDecoder_JSON_To_MultiTree, char*, json, MULTITREE_HANDLE*, multiTreeHandle);
+MOCKABLE_FUNCTION(, JSON_DECODER_RESULT, JSONDecoder_Tokenize, const char*, json, size_t, length, JSON_DECODER_TOKEN_CALLBACK, tokenCallback, void*, context);
 
 #ifdef __cplusplus
 }
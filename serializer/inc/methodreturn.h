@@ -8,6 +8,12 @@ typedef struct METHODRETURN_HANDLE_DATA_TAG* METHODRETURN_HANDLE;
 
 #include "azure_c_shared_utility/macro_utils.h"
 
+#ifdef __cplusplus
+#include <cstddef>
+#else
+#include <stddef.h>
+#endif
+
 /*the following macro expands to "const" if X is defined. If X is not defined, then it expands to nothing*/
 #define CONST_BY_COMPILATION_UNIT(X) IF(COUNT_ARG(X),const,)
 
@@ -25,8 +31,12 @@ extern "C"
 #endif
 
 MOCKABLE_FUNCTION(, METHODRETURN_HANDLE, MethodReturn_Create, int, statusCode, const char*, jsonValue);
+/*same as MethodReturn_Create, for callers whose jsonValue comes from a trusted JSON encoder and need not be parsed again*/
+MOCKABLE_FUNCTION(, METHODRETURN_HANDLE, MethodReturn_CreateTrusted, int, statusCode, const char*, jsonValue);
 MOCKABLE_FUNCTION(, void, MethodReturn_Destroy, METHODRETURN_HANDLE, handle);
 MOCKABLE_FUNCTION(, const METHODRETURN_DATA*, MethodReturn_GetReturn, METHODRETURN_HANDLE, handle);
+/*hands over the JSON value to the caller (who frees it), the handle is left without a JSON value*/
+MOCKABLE_FUNCTION(, char*, MethodReturn_DetachJsonValue, METHODRETURN_HANDLE, handle, size_t*, jsonValueLength);
 
 #ifdef __cplusplus
 }
@@ -19,6 +19,7 @@ extern "C" {
 DEFINE_ENUM(SCHEMA_SERIALIZER_RESULT, SCHEMA_SERIALIZER_RESULT_VALUES)
 
 extern SCHEMA_SERIALIZER_RESULT SchemaSerializer_SerializeCommandMetadata(SCHEMA_MODEL_TYPE_HANDLE modelHandle, STRING_HANDLE schemaText);
+extern SCHEMA_SERIALIZER_RESULT SchemaSerializer_GetCommandMetadata(SCHEMA_MODEL_TYPE_HANDLE modelHandle, const char** commandMetadata);
 
 #ifdef __cplusplus
 }
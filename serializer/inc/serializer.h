@@ -55,6 +55,7 @@
 #include "methodreturn.h"
 #include "schemalib.h"
 #include "codefirst.h"
+#include "cborencoder.h"
 #include "agenttypesystem.h"
 #include "schema.h"
 
@@ -307,6 +308,68 @@ extern "C"
 /*Codes_SRS_SERIALIZER_99_114:[ If CodeFirst_SendAsync fails, SEND shall return IOT_AGENT_SERIALIZE_FAILED.] */
 #define SERIALIZE(destination, destinationSize,...) CodeFirst_SendAsync(destination, destinationSize, COUNT_ARG(__VA_ARGS__) FOR_EACH_1(ADDRESS_MACRO, __VA_ARGS__))
 
+/**
+ * @def      SERIALIZE_TO_BUFFER(destination, destinationCapacity, destinationSize,...)
+ * This macro writes the JSON serialized representation of the properties
+ * into a buffer owned by the caller. Only primitive properties of the root
+ * model (or the whole device, when it only has primitive properties) can be
+ * serialized this way; use SERIALIZE for anything else.
+ *
+ * @param   destination                  Pointer to the buffer that receives
+ *                                       the serialized data (not NUL terminated).
+ * @param   destinationCapacity          Size in bytes of @p destination.
+ * @param   destinationSize              Pointer to a @c size_t that gets
+ *                                       written with the size in bytes of the
+ *                                       serialized data
+ * @param    property1, property2...     A list of property values to send.
+ *
+ */
+#define SERIALIZE_TO_BUFFER(destination, destinationCapacity, destinationSize,...) CodeFirst_SendAsyncToBuffer(destination, destinationCapacity, destinationSize, COUNT_ARG(__VA_ARGS__) FOR_EACH_1(ADDRESS_MACRO, __VA_ARGS__))
+
+/**
+ * @def      SERIALIZE_TO_CBOR_BUFFER(destination, destinationCapacity, destinationSize,...)
+ * Same as SERIALIZE_TO_BUFFER, but the properties are written as a CBOR map.
+ * Set the content type of the message to CBOR_CONTENT_TYPE.
+ *
+ * @param   destination                  Pointer to the buffer that receives
+ *                                       the serialized data.
+ * @param   destinationCapacity          Size in bytes of @p destination.
+ * @param   destinationSize              Pointer to a @c size_t that gets
+ *                                       written with the size in bytes of the
+ *                                       serialized data
+ * @param    property1, property2...     A list of property values to send.
+ *
+ */
+#define SERIALIZE_TO_CBOR_BUFFER(destination, destinationCapacity, destinationSize,...) CodeFirst_SendAsyncToBufferCbor(destination, destinationCapacity, destinationSize, COUNT_ARG(__VA_ARGS__) FOR_EACH_1(ADDRESS_MACRO, __VA_ARGS__))
+
+/**
+ * @def      SERIALIZE_BATCH_TO_BUFFER(destination, destinationCapacity, destinationSize, devices, deviceCount)
+ * This macro writes several samples of the same model as one JSON object
+ * holding one array of values per property, e.g.
+ * {"temperature":[21.5,21.6], "humidity":[40,41]}. The model can only have
+ * primitive properties, as for SERIALIZE_TO_BUFFER.
+ *
+ * @param   destination                  Pointer to the buffer that receives
+ *                                       the serialized data (not NUL terminated).
+ * @param   destinationCapacity          Size in bytes of @p destination.
+ * @param   destinationSize              Pointer to a @c size_t that gets
+ *                                       written with the size in bytes of the
+ *                                       serialized data
+ * @param   devices                      Array of the devices (created with
+ *                                       CREATE_MODEL_INSTANCE) holding the samples,
+ *                                       in the order they are written.
+ * @param   deviceCount                  Number of elements of @p devices.
+ *
+ */
+#define SERIALIZE_BATCH_TO_BUFFER(destination, destinationCapacity, destinationSize, devices, deviceCount) CodeFirst_SendBatchToBuffer(destination, destinationCapacity, destinationSize, (void* const*)(devices), deviceCount)
+
+/**
+ * @def      SERIALIZE_BATCH_TO_CBOR_BUFFER(destination, destinationCapacity, destinationSize, devices, deviceCount)
+ * Same as SERIALIZE_BATCH_TO_BUFFER, but the properties are written as a CBOR
+ * map of CBOR arrays. Set the content type of the message to CBOR_CONTENT_TYPE.
+ */
+#define SERIALIZE_BATCH_TO_CBOR_BUFFER(destination, destinationCapacity, destinationSize, devices, deviceCount) CodeFirst_SendBatchToBufferCbor(destination, destinationCapacity, destinationSize, (void* const*)(devices), deviceCount)
+
 #define SERIALIZE_REPORTED_PROPERTIES(destination, destinationSize,...) CodeFirst_SendAsyncReported(destination, destinationSize, COUNT_ARG(__VA_ARGS__) FOR_EACH_1(ADDRESS_MACRO, __VA_ARGS__))
 
 
@@ -344,6 +407,16 @@ extern "C"
 */
 #define INGEST_DESIRED_PROPERTIES(device, jsonPayload, parseDesiredNode) (CodeFirst_IngestDesiredProperties(device, jsonPayload, parseDesiredNode))
 
+/**
+* @def   INGEST_DESIRED_PROPERTIES_CBOR(device, cborPayload, cborPayloadSize, parseDesiredNode)
+* Same as INGEST_DESIRED_PROPERTIES, for desired properties received as CBOR.
+*
+* @param   device                return of CodeFirst_CreateDevice.
+* @param   cborPayload           the desired properties as a CBOR map.
+* @param   cborPayloadSize       size in bytes of cborPayload.
+*/
+#define INGEST_DESIRED_PROPERTIES_CBOR(device, cborPayload, cborPayloadSize, parseDesiredNode) (CodeFirst_IngestDesiredPropertiesCbor(device, cborPayload, cborPayloadSize, parseDesiredNode))
+
 /* Helper macros */
 
 /* These macros remove a useless comma from the beginning of an argument list that looks like:
@@ -437,6 +510,8 @@ Actions are discarded, since no marshalling will be done for those when sending
 
 #define FIELD_AS_STRING(x,y) memberNames[iMember++] = #y;
 
+/*every reflected entry links to the entry emitted before it. DECLARE_MODEL and DECLARE_STRUCT emit the model (struct) entry right before the entries of its elements,
+so CodeFirst finds the elements of a model between the previous model or struct and the model itself without scanning the whole list*/
 #define REFLECTED_LIST_HEAD(name) \
     static const REFLECTED_DATA_FROM_DATAPROVIDER ALL_REFLECTED(name) = { &C2(REFLECTED_, C1(DEC(__COUNTER__))) };
 #define REFLECTED_STRUCT(name) \
@@ -78,7 +78,7 @@ static int deviceMethodCallback(const char* method_name, const unsigned char* pa
         }
         else
         {
-            /*Codes_SRS_SERIALIZERDEVICETWIN_02_023: [ deviceMethodCallback shall get the MethodReturn_Data and shall copy the response JSON value into a new byte array. ]*/
+            /*Codes_SRS_SERIALIZERDEVICETWIN_02_023: [ deviceMethodCallback shall get the MethodReturn_Data. ]*/
             const METHODRETURN_DATA* data = MethodReturn_GetReturn(mr);
 
             /*Codes_SRS_SERIALIZERDEVICETWIN_02_025: [ deviceMethodCallback returns the statusCode from the user. ]*/
@@ -91,11 +91,12 @@ static int deviceMethodCallback(const char* method_name, const unsigned char* pa
             }
             else
             {
-                *resp_size = strlen(data->jsonValue);
-                *response = (unsigned char*)malloc(*resp_size);
-                if (*response == NULL)
+                /*Codes_SRS_SERIALIZERDEVICETWIN_41_005: [ deviceMethodCallback shall take the response JSON value out of the METHODRETURN_HANDLE by calling MethodReturn_DetachJsonValue, without copying it. ]*/
+                size_t jsonValueLength;
+                char* jsonValue = MethodReturn_DetachJsonValue(mr, &jsonValueLength);
+                if (jsonValue == NULL)
                 {
-                    LogError("failure in malloc");
+                    LogError("failure in MethodReturn_DetachJsonValue");
                     /*Codes_SRS_SERIALIZERDEVICETWIN_02_026: [ If any failure occurs in the above operations, then deviceMethodCallback shall fail, return 500, set *response to NULL and '*resp_size` to 0. ]*/
                     *response = NULL;
                     *resp_size = 0;
@@ -103,8 +104,9 @@ static int deviceMethodCallback(const char* method_name, const unsigned char* pa
                 }
                 else
                 {
-                    /*Codes_SRS_SERIALIZERDEVICETWIN_02_024: [ deviceMethodCallback shall set *response to this new byte array, *resp_size to the size of the array. ]*/
-                    (void)memcpy(*response, data->jsonValue, *resp_size);
+                    /*Codes_SRS_SERIALIZERDEVICETWIN_02_024: [ deviceMethodCallback shall set *response to the JSON value and *resp_size to its length. The SDK frees *response. ]*/
+                    *response = (unsigned char*)jsonValue;
+                    *resp_size = jsonValueLength;
                 }
             }
             MethodReturn_Destroy(mr);
@@ -366,65 +368,103 @@ static void IoTHubDeviceTwin_Destroy_Impl(void* model)
     }
 }
 
-/*the below function sends the reported state of a model previously created by IoTHubDeviceTwin_Create*/
+/*the below function sends an already serialized reported state of a model previously created by IoTHubDeviceTwin_Create*/
 /*this function serves both the _LL and the convenience layer because of protohandles*/
-static IOTHUB_CLIENT_RESULT IoTHubDeviceTwin_SendReportedState_Impl(void* model, IOTHUB_CLIENT_REPORTED_STATE_CALLBACK deviceTwinCallback, void* context)
+static IOTHUB_CLIENT_RESULT IoTHubDeviceTwin_SendSerializedReportedState(void* model, const unsigned char* buffer, size_t bufferSize, IOTHUB_CLIENT_REPORTED_STATE_CALLBACK deviceTwinCallback, void* context)
 {
-    unsigned char*buffer;
-    size_t bufferSize;
-
     IOTHUB_CLIENT_RESULT result;
 
-    if (SERIALIZE_REPORTED_PROPERTIES_FROM_POINTERS(&buffer, &bufferSize, model) != CODEFIRST_OK)
+    SERIALIZER_DEVICETWIN_PROTOHANDLE* protoHandle = (SERIALIZER_DEVICETWIN_PROTOHANDLE*)VECTOR_find_if(g_allProtoHandles, protoHandleHasDeviceStartAddress, model);
+    if (protoHandle == NULL)
     {
-        LogError("Failed serializing reported state");
+        LogError("failure in VECTOR_find_if [not found]");
         result = IOTHUB_CLIENT_ERROR;
     }
     else
     {
-        SERIALIZER_DEVICETWIN_PROTOHANDLE* protoHandle = (SERIALIZER_DEVICETWIN_PROTOHANDLE*)VECTOR_find_if(g_allProtoHandles, protoHandleHasDeviceStartAddress, model);
-        if (protoHandle == NULL)
-        {
-            LogError("failure in VECTOR_find_if [not found]");
-            result = IOTHUB_CLIENT_ERROR;
-        }
-        else
+        switch (protoHandle->iothubClientHandleVariant.iothubClientHandleType)
         {
-            switch (protoHandle->iothubClientHandleVariant.iothubClientHandleType)
+            case IOTHUB_CLIENT_CONVENIENCE_HANDLE_TYPE:
             {
-                case IOTHUB_CLIENT_CONVENIENCE_HANDLE_TYPE:
+                if (IoTHubClient_SendReportedState(protoHandle->iothubClientHandleVariant.iothubClientHandleValue.iothubClientHandle, buffer, bufferSize, deviceTwinCallback, context) != IOTHUB_CLIENT_OK)
                 {
-                    if (IoTHubClient_SendReportedState(protoHandle->iothubClientHandleVariant.iothubClientHandleValue.iothubClientHandle, buffer, bufferSize, deviceTwinCallback, context) != IOTHUB_CLIENT_OK)
-                    {
-                        LogError("Failure sending data");
-                        result = IOTHUB_CLIENT_ERROR;
-                    }
-                    else
-                    {
-                        result = IOTHUB_CLIENT_OK;
-                    }
-                    break;
+                    LogError("Failure sending data");
+                    result = IOTHUB_CLIENT_ERROR;
                 }
-                case IOTHUB_CLIENT_LL_HANDLE_TYPE:
+                else
                 {
-                    if (IoTHubClient_LL_SendReportedState(protoHandle->iothubClientHandleVariant.iothubClientHandleValue.iothubClientLLHandle, buffer, bufferSize, deviceTwinCallback, context) != IOTHUB_CLIENT_OK)
-                    {
-                        LogError("Failure sending data");
-                        result = IOTHUB_CLIENT_ERROR;
-                    }
-                    else
-                    {
-                        result = IOTHUB_CLIENT_OK;
-                    }
-                    break;
+                    result = IOTHUB_CLIENT_OK;
                 }
-                default:
+                break;
+            }
+            case IOTHUB_CLIENT_LL_HANDLE_TYPE:
+            {
+                if (IoTHubClient_LL_SendReportedState(protoHandle->iothubClientHandleVariant.iothubClientHandleValue.iothubClientLLHandle, buffer, bufferSize, deviceTwinCallback, context) != IOTHUB_CLIENT_OK)
                 {
-                    LogError("INTERNAL ERROR: unexpected value for enum (%d)", (int)protoHandle->iothubClientHandleVariant.iothubClientHandleType);
+                    LogError("Failure sending data");
                     result = IOTHUB_CLIENT_ERROR;
-                    break;
                 }
+                else
+                {
+                    result = IOTHUB_CLIENT_OK;
+                }
+                break;
             }
+            default:
+            {
+                LogError("INTERNAL ERROR: unexpected value for enum (%d)", (int)protoHandle->iothubClientHandleVariant.iothubClientHandleType);
+                result = IOTHUB_CLIENT_ERROR;
+                break;
+            }
+        }
+    }
+    return result;
+}
+
+/*the below function sends the reported state of a model previously created by IoTHubDeviceTwin_Create*/
+static IOTHUB_CLIENT_RESULT IoTHubDeviceTwin_SendReportedState_Impl(void* model, IOTHUB_CLIENT_REPORTED_STATE_CALLBACK deviceTwinCallback, void* context)
+{
+    unsigned char*buffer;
+    size_t bufferSize;
+
+    IOTHUB_CLIENT_RESULT result;
+
+    if (SERIALIZE_REPORTED_PROPERTIES_FROM_POINTERS(&buffer, &bufferSize, model) != CODEFIRST_OK)
+    {
+        LogError("Failed serializing reported state");
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else
+    {
+        result = IoTHubDeviceTwin_SendSerializedReportedState(model, buffer, bufferSize, deviceTwinCallback, context);
+        free(buffer);
+    }
+    return result;
+}
+
+/*the below function sends only the reported properties of a model previously created by IoTHubDeviceTwin_Create that changed since the last time it succeeded*/
+static IOTHUB_CLIENT_RESULT IoTHubDeviceTwin_SendReportedStateChanges_Impl(void* model, IOTHUB_CLIENT_REPORTED_STATE_CALLBACK deviceTwinCallback, void* context)
+{
+    unsigned char*buffer;
+    size_t bufferSize;
+
+    IOTHUB_CLIENT_RESULT result;
+
+    /*Codes_SRS_SERIALIZERDEVICETWIN_41_001: [ IoTHubDeviceTwin_SendReportedStateChanges_Impl shall call CodeFirst_SendAsyncReportedChanges. ]*/
+    if (CodeFirst_SendAsyncReportedChanges(&buffer, &bufferSize, model) != CODEFIRST_OK)
+    {
+        /*Codes_SRS_SERIALIZERDEVICETWIN_41_003: [ Otherwise, IoTHubDeviceTwin_SendReportedStateChanges_Impl shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+        LogError("Failed serializing reported state changes");
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else
+    {
+        /*Codes_SRS_SERIALIZERDEVICETWIN_41_002: [ IoTHubDeviceTwin_SendReportedStateChanges_Impl shall send the serialized changes the same way IoTHubDeviceTwin_SendReportedState_Impl does. ]*/
+        result = IoTHubDeviceTwin_SendSerializedReportedState(model, buffer, bufferSize, deviceTwinCallback, context);
+        if (result != IOTHUB_CLIENT_OK)
+        {
+            /*Codes_SRS_SERIALIZERDEVICETWIN_41_004: [ If sending fails, IoTHubDeviceTwin_SendReportedStateChanges_Impl shall call CodeFirst_ResetReportedChanges so that the next call sends all the reported properties. ]*/
+            CodeFirst_ResetReportedChanges(model);
         }
         free(buffer);
     }
@@ -466,6 +506,14 @@ static IOTHUB_CLIENT_RESULT IoTHubDeviceTwin_SendReportedState_Impl(void* model,
     {                                                                                                                                                                               \
         return IoTHubDeviceTwin_SendReportedState_Impl(model, deviceTwinCallback, context);                                                                                         \
     }                                                                                                                                                                               \
+    static IOTHUB_CLIENT_RESULT C2(IoTHubDeviceTwin_LL_SendReportedStateChanges, name) (name* model, IOTHUB_CLIENT_REPORTED_STATE_CALLBACK deviceTwinCallback, void* context)       \
+    {                                                                                                                                                                               \
+        return IoTHubDeviceTwin_SendReportedStateChanges_Impl(model, deviceTwinCallback, context);                                                                                  \
+    }                                                                                                                                                                               \
+    static IOTHUB_CLIENT_RESULT C2(IoTHubDeviceTwin_SendReportedStateChanges, name) (name* model, IOTHUB_CLIENT_REPORTED_STATE_CALLBACK deviceTwinCallback, void* context)          \
+    {                                                                                                                                                                               \
+        return IoTHubDeviceTwin_SendReportedStateChanges_Impl(model, deviceTwinCallback, context);                                                                                  \
+    }                                                                                                                                                                               \
 
 #endif /*SERIALIZER_DEVICE_TWIN_H*/
 
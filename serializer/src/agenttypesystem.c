@@ -83,54 +83,60 @@ static void NoFreeFunction(void* value)
 
 
 #define IS_DIGIT(a) (('0'<=(a)) &&((a)<='9'))
-#define splitInt(intVal, bytePos)   (char)((intVal >> (bytePos << 3)) & 0xFF)
-#define joinChars(a, b, c, d) (uint32_t)( (uint32_t)a + ((uint32_t)b << 8) + ((uint32_t)c << 16) + ((uint32_t)d << 24))
-
-static char base64char(unsigned char val)
-{
-    char result;
+/*the URL safe base64 alphabet of EDM_BINARY, indexed by the 6 bit value of a base64char*/
+static const char base64Alphabet[64] = {
+    'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 'K', 'L', 'M', 'N', 'O', 'P',
+    'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X', 'Y', 'Z', 'a', 'b', 'c', 'd', 'e', 'f',
+    'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n', 'o', 'p', 'q', 'r', 's', 't', 'u', 'v',
+    'w', 'x', 'y', 'z', '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', '-', '_'
+};
 
-    if (val < 26)
-    {
-        result = 'A' + (char)val;
-    }
-    else if (val < 52)
-    {
-        result = 'a' + ((char)val - 26);
-    }
-    else if (val < 62)
-    {
-        result = '0' + ((char)val - 52);
-    }
-    else if (val == 62)
-    {
-        result = '-';
-    }
-    else
-    {
-        result = '_';
-    }
+/*the 6 bit value of every character, BASE64_INVALID_CHAR for the ones that are not a base64char*/
+#define BASE64_INVALID_CHAR 0xFF
+static const unsigned char base64Values[256] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x3E, 0xFF, 0xFF,
+    0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E,
+    0x0F, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0xFF, 0xFF, 0xFF, 0xFF, 0x3F,
+    0xFF, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F, 0x30, 0x31, 0x32, 0x33, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+};
 
-    return result;
-}
+/*EDM_BINARY values whose encoding fits in this many characters are encoded without malloc*/
+#define EDM_BINARY_STACK_BUFFER_SIZE 256
 
-static char base64b16(unsigned char val)
-{
-    const uint32_t base64b16values[4] = {
-        joinChars('A', 'E', 'I', 'M'),
-        joinChars('Q', 'U', 'Y', 'c'),
-        joinChars('g', 'k', 'o', 's'),
-        joinChars('w', '0', '4', '8')
-    };
-    return splitInt(base64b16values[val >> 2], (val & 0x03));
-}
+/*EDM_STRING values whose JSON encoding fits in this many characters are encoded without malloc*/
+#define EDM_STRING_STACK_BUFFER_SIZE 256
 
-static char base64b8(unsigned char val)
+/*how many characters an ASCII character grows by when escaped in JSON: control characters become \u00XX, " \ and / get a \ in front*/
+static const unsigned char jsonEscapeExtraLength[128] =
 {
-    const uint32_t base64b8values = joinChars('A', 'Q', 'g', 'w');
-    return splitInt(base64b8values, val);
+    5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,
+    5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,
+    0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
 };
 
+#define base64char(val) (base64Alphabet[(val) & 0x3F])
+/*base64b16 = base64char ( 'A' / 'E' / 'I' / 'M' / 'Q' / 'U' / 'Y' / 'c' / 'g' / 'k' / 'o' / 's' / 'w' / '0' / '4' / '8' ), that is every 4th base64char*/
+#define base64b16(val) (base64Alphabet[((val) & 0x0F) << 2])
+/*base64b8 = base64char ( 'A' / 'Q' / 'g' / 'w' ), that is every 16th base64char*/
+#define base64b8(val) (base64Alphabet[((val) & 0x03) << 4])
+
 /*creates an AGENT_DATA_TYPE containing a EDM_BOOLEAN from a int*/
 AGENT_DATA_TYPES_RESULT Create_EDM_BOOLEAN_from_int(AGENT_DATA_TYPE* agentData, int v)
 {
@@ -514,34 +520,15 @@ static int ValidateDecimal(const char* v, size_t vlen)
 static int base64toValue(char base64charSource, unsigned char* value)
 {
     int result;
-    if (('A' <= base64charSource) && (base64charSource <= 'Z'))
+    unsigned char v = base64Values[(unsigned char)base64charSource];
+    if (v == BASE64_INVALID_CHAR)
     {
-        *value = base64charSource - 'A';
-        result = 0;
-    }
-    else if (('a' <= base64charSource) && (base64charSource <= 'z'))
-    {
-        *value = ('Z' - 'A') +1+ (base64charSource - 'a');
-        result = 0;
-    }
-    else if (('0' <= base64charSource) && (base64charSource <= '9'))
-    {
-        *value = ('Z' - 'A') +1+('z'-'a')+1 +(base64charSource - '0');
-        result = 0;
-    }
-    else if ('-' == base64charSource)
-    {
-        *value = 62;
-        result = 0;
-    }
-    else if ('_' == base64charSource)
-    {
-        *value = 63;
-        result = 0;
+        result = 1;
     }
     else
     {
-        result = 1;
+        *value = v;
+        result = 0;
     }
     return result;
 }
@@ -557,17 +544,16 @@ static int scan4base64char(const char* source, size_t sourceSize, unsigned char
     }
     else
     {
-        unsigned char b0, b1, b2, b3;
-        if (
-            (base64toValue(source[0], &b0) == 0) &&
-            (base64toValue(source[1], &b1) == 0) &&
-            (base64toValue(source[2], &b2) == 0) &&
-            (base64toValue(source[3], &b3) == 0)
-            )
+        unsigned char b0 = base64Values[(unsigned char)source[0]];
+        unsigned char b1 = base64Values[(unsigned char)source[1]];
+        unsigned char b2 = base64Values[(unsigned char)source[2]];
+        unsigned char b3 = base64Values[(unsigned char)source[3]];
+        /*valid values are 6 bits wide, so a single test catches any BASE64_INVALID_CHAR of the group*/
+        if (((b0 | b1 | b2 | b3) & 0xC0) == 0)
         {
-            *destination0 = (b0 << 2) | ((b1 & 0x30) >> 4);
-            *destination1 = ((b1 & 0x0F)<<4) | ((b2 & 0x3C) >>2 );
-            *destination2 = ((b2 & 0x03) << 6) | (b3);
+            *destination0 = (unsigned char)((b0 << 2) | (b1 >> 4));
+            *destination1 = (unsigned char)((b1 << 4) | (b2 >> 2));
+            *destination2 = (unsigned char)((b2 << 6) | b3);
             result = 0;
         }
         else
@@ -581,31 +567,35 @@ static int scan4base64char(const char* source, size_t sourceSize, unsigned char
 /*return 0 if the character is one of ( 'A' / 'E' / 'I' / 'M' / 'Q' / 'U' / 'Y' / 'c' / 'g' / 'k' / 'o' / 's' / 'w' / '0' / '4' / '8' )*/
 static int base64b16toValue(unsigned char source, unsigned char* destination)
 {
-    unsigned char i;
-    for (i = 0; i <= 15; i++)
+    int result;
+    unsigned char v = base64Values[source];
+    if ((v == BASE64_INVALID_CHAR) || ((v & 0x03) != 0))
     {
-        if (base64b16(i) == source)
-        {
-            *destination = i;
-            return 0;
-        }
+        result = 1;
+    }
+    else
+    {
+        *destination = v >> 2;
+        result = 0;
     }
-    return 1;
+    return result;
 }
 
 /*return 0 if the character is one of ( 'A' / 'Q' / 'g' / 'w' )*/
 static int base64b8toValue(unsigned char source, unsigned char* destination)
 {
-    unsigned char i;
-    for (i = 0; i <= 3; i++)
+    int result;
+    unsigned char v = base64Values[source];
+    if ((v == BASE64_INVALID_CHAR) || ((v & 0x0F) != 0))
     {
-        if (base64b8(i) == source)
-        {
-            *destination = i;
-            return 0;
-        }
+        result = 1;
     }
-    return 1;
+    else
+    {
+        *destination = v >> 4;
+        result = 0;
+    }
+    return result;
 }
 
 
@@ -1260,16 +1250,14 @@ void Destroy_AGENT_DATA_TYPE(AGENT_DATA_TYPE* agentData)
             case (EDM_COMPLEX_TYPE_TYPE):
             {
                 /*Codes_SRS_AGENT_TYPE_SYSTEM_99_050:[Destroy_AGENT_DATA_TYPE shall deallocate all allocated resources used to represent the type.]*/
+                /*the fields, their values and their names are all in the block of fields (see allocateComplexTypeFields)*/
                 size_t i;
                 for (i = 0; i < agentData->value.edmComplexType.nMembers; i++)
                 {
-                    free((void*)(agentData->value.edmComplexType.fields[i].fieldName));
-                    agentData->value.edmComplexType.fields[i].fieldName = NULL;
                     Destroy_AGENT_DATA_TYPE(agentData->value.edmComplexType.fields[i].value);
-                    free(agentData->value.edmComplexType.fields[i].value);
-                    agentData->value.edmComplexType.fields[i].value = NULL;
                 }
                 free(agentData->value.edmComplexType.fields);
+                agentData->value.edmComplexType.fields = NULL;
                 break;
             }
         }
@@ -1283,6 +1271,103 @@ static char hexDigitToChar(uint8_t hexDigit)
     else return ('A' - 10) + hexDigit;
 }
 
+/*"00".."99", so integers are written two digits per division*/
+static const char twoDigits[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+/*writes the decimal digits of value right to left, ending just before end. Returns the first digit.*/
+static char* formatUnsignedBackwards(char* end, uint64_t value)
+{
+    while (value >= 100)
+    {
+        size_t pair = (size_t)(value % 100) * 2;
+        value /= 100;
+        *--end = twoDigits[pair + 1];
+        *--end = twoDigits[pair];
+    }
+
+    if (value >= 10)
+    {
+        size_t pair = (size_t)value * 2;
+        *--end = twoDigits[pair + 1];
+        *--end = twoDigits[pair];
+    }
+    else
+    {
+        *--end = (char)('0' + value);
+    }
+
+    return end;
+}
+
+/*formats value in buffer (MAX_ULONG_LONG_STRING_LENGTH + 1 characters) as a '\0' terminated string. Returns where the string starts.*/
+static char* formatInteger(char* buffer, int64_t value)
+{
+    char* result;
+    buffer[MAX_ULONG_LONG_STRING_LENGTH] = '\0';
+
+    if (value < 0)
+    {
+        result = formatUnsignedBackwards(buffer + MAX_ULONG_LONG_STRING_LENGTH, (uint64_t)0 - (uint64_t)value);
+        *--result = '-';
+    }
+    else
+    {
+        result = formatUnsignedBackwards(buffer + MAX_ULONG_LONG_STRING_LENGTH, (uint64_t)value);
+    }
+
+    return result;
+}
+
+/*writes what printf writes for %.<minDigits>llu. Returns the number of characters written.*/
+static size_t formatPaddedUnsigned(char* destination, uint64_t value, size_t minDigits)
+{
+    char digits[MAX_ULONG_LONG_STRING_LENGTH];
+    char* start = formatUnsignedBackwards(digits + sizeof(digits), value);
+    size_t nDigits = (size_t)((digits + sizeof(digits)) - start);
+    size_t result = 0;
+
+    while (nDigits + result < minDigits)
+    {
+        destination[result++] = '0';
+    }
+    (void)memcpy(destination + result, start, nDigits);
+
+    return result + nDigits;
+}
+
+/*writes what printf writes for %.<minDigits>d (%+.<minDigits>d when forceSign is true). Returns the number of characters written.*/
+static size_t formatPaddedInt(char* destination, int value, size_t minDigits, bool forceSign)
+{
+    size_t result = 0;
+    uint64_t magnitude;
+
+    if (value < 0)
+    {
+        destination[result++] = '-';
+        magnitude = (uint64_t)0 - (uint64_t)(int64_t)value;
+    }
+    else
+    {
+        if (forceSign)
+        {
+            destination[result++] = '+';
+        }
+        magnitude = (uint64_t)value;
+    }
+
+    return result + formatPaddedUnsigned(destination + result, magnitude, minDigits);
+}
+
 AGENT_DATA_TYPES_RESULT AgentDataTypes_ToString(STRING_HANDLE destination, const AGENT_DATA_TYPE* value)
 {
     AGENT_DATA_TYPES_RESULT result;
@@ -1370,14 +1455,9 @@ AGENT_DATA_TYPES_RESULT AgentDataTypes_ToString(STRING_HANDLE destination, const
             }
             case(EDM_BYTE_TYPE) :
             {
-                char tempbuffer2[4]; /*because bytes can at most be 255 and that is 3 characters + 1 for '\0'*/
-                size_t pos = 0;
-                if (value->value.edmByte.value >= 100) tempbuffer2[pos++] = '0' + (value->value.edmByte.value / 100);
-                if (value->value.edmByte.value >= 10) tempbuffer2[pos++] = '0' + (value->value.edmByte.value % 100) / 10;
-                tempbuffer2[pos++] = '0' + (value->value.edmByte.value % 10);
-                tempbuffer2[pos++] = '\0';
+                char tempbuffer2[MAX_ULONG_LONG_STRING_LENGTH + 1];
 
-                if (STRING_concat(destination, tempbuffer2) != 0)
+                if (STRING_concat(destination, formatInteger(tempbuffer2, value->value.edmByte.value)) != 0)
                 {
                     result = AGENT_DATA_TYPES_ERROR;
                     LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
@@ -1429,320 +1509,53 @@ AGENT_DATA_TYPES_RESULT AgentDataTypes_ToString(STRING_HANDLE destination, const
             {
                 /*Codes_SRS_AGENT_TYPE_SYSTEM_99_019:[ EDM_DATETIMEOFFSET: dateTimeOffsetValue = year "-" month "-" day "T" hour ":" minute [ ":" second [ "." fractionalSeconds ] ] ( "Z" / sign hour ":" minute )]*/
                 /*from ABNF seems like these numbers HAVE to be padded with zeroes*/
-                if (value->value.edmDateTimeOffset.hasTimeZone)
-                {
-                    if (value->value.edmDateTimeOffset.hasFractionalSecond)
-                    {
-                        size_t tempBufferSize = 1 + // \"
-                            MAX_LONG_STRING_LENGTH + // %.4d
-                            1 + // -
-                            MAX_LONG_STRING_LENGTH + // %.2d
-                            1 + // -
-                            MAX_LONG_STRING_LENGTH + // %.2d
-                            1 + // T
-                            MAX_LONG_STRING_LENGTH + // %.2d
-                            1 + // :
-                            MAX_LONG_STRING_LENGTH + // %.2d
-                            1 + // :
-                            MAX_LONG_STRING_LENGTH + // %.2d
-                            1 + // .
-                            MAX_ULONG_LONG_STRING_LENGTH + // %.12llu
-                            1 + MAX_LONG_STRING_LENGTH + // %+.2d
-                            1 + // :
-                            MAX_LONG_STRING_LENGTH + // %.2d
-                            1 + //\"
-                            1;  // " (terminating NULL);
-
-                        char* tempBuffer = (char*)malloc(tempBufferSize);
-                        if (tempBuffer == NULL)
-                        {
-                            result = AGENT_DATA_TYPES_ERROR;
-                            LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
-                        }
-                        else
-                        {
-                            if (sprintf_s(tempBuffer, tempBufferSize, "\"%.4d-%.2d-%.2dT%.2d:%.2d:%.2d.%.12llu%+.2d:%.2d\"", /*+ in printf forces the sign to appear*/
-                                value->value.edmDateTimeOffset.dateTime.tm_year+1900,
-                                value->value.edmDateTimeOffset.dateTime.tm_mon+1,
-                                value->value.edmDateTimeOffset.dateTime.tm_mday,
-                                value->value.edmDateTimeOffset.dateTime.tm_hour,
-                                value->value.edmDateTimeOffset.dateTime.tm_min,
-                                value->value.edmDateTimeOffset.dateTime.tm_sec,
-                                value->value.edmDateTimeOffset.fractionalSecond,
-                                value->value.edmDateTimeOffset.timeZoneHour,
-                                value->value.edmDateTimeOffset.timeZoneMinute) < 0)
-                            {
-                                result = AGENT_DATA_TYPES_ERROR;
-                                LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
-                            }
-                            else if (STRING_concat(destination, tempBuffer) != 0)
-                            {
-                                result = AGENT_DATA_TYPES_ERROR;
-                                LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
-                            }
-                            else
-                            {
-                                result = AGENT_DATA_TYPES_OK;
-                            }
-
-                            // Clean up temp buffer if allocated
-                            free(tempBuffer);
-                        }
-                    }
-                    else
-                    {
-                        size_t tempBufferSize = 1 + // \"
-                            MAX_LONG_STRING_LENGTH + // %.4d
-                            1 + // -
-                            MAX_LONG_STRING_LENGTH + // %.2d
-                            1 + // -
-                            MAX_LONG_STRING_LENGTH + // %.2d
-                            1 + // T
-                            MAX_LONG_STRING_LENGTH + // %.2d
-                            1 + // :
-                            MAX_LONG_STRING_LENGTH + // %.2d
-                            1 + // :
-                            MAX_LONG_STRING_LENGTH + // %.2d
-                            1 + MAX_LONG_STRING_LENGTH + // %+.2d
-                            1 + // :
-                            MAX_LONG_STRING_LENGTH + // %.2d
-                            1 + // \"
-                            1; // " terminating NULL
-                        char* tempBuffer = (char*)malloc(tempBufferSize);
-
-                        if (tempBuffer == NULL)
-                        {
-                            result = AGENT_DATA_TYPES_ERROR;
-                            LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
-                        }
-                        else
-                        {
-                            if (sprintf_s(tempBuffer, tempBufferSize, "\"%.4d-%.2d-%.2dT%.2d:%.2d:%.2d%+.2d:%.2d\"", /*+ in printf forces the sign to appear*/
-                                value->value.edmDateTimeOffset.dateTime.tm_year + 1900,
-                                value->value.edmDateTimeOffset.dateTime.tm_mon+1,
-                                value->value.edmDateTimeOffset.dateTime.tm_mday,
-                                value->value.edmDateTimeOffset.dateTime.tm_hour,
-                                value->value.edmDateTimeOffset.dateTime.tm_min,
-                                value->value.edmDateTimeOffset.dateTime.tm_sec,
-                                value->value.edmDateTimeOffset.timeZoneHour,
-                                value->value.edmDateTimeOffset.timeZoneMinute) < 0)
-                            {
-                                result = AGENT_DATA_TYPES_ERROR;
-                                LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
-                            }
-                            else if (STRING_concat(destination, tempBuffer) != 0)
-                            {
-                                result = AGENT_DATA_TYPES_ERROR;
-                                LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
-                            }
-                            else
-                            {
-                                result = AGENT_DATA_TYPES_OK;
-                            }
-
-                            // Clean up temp buffer if allocated
-                            free(tempBuffer);
-                        }
-                    }
-                }
-                else
-                {
-                    if (value->value.edmDateTimeOffset.hasFractionalSecond)
-                    {
-                        size_t tempBufferSize = 1 + //\"
-                            MAX_LONG_STRING_LENGTH + // %.4d
-                            1 + // -
-                            MAX_LONG_STRING_LENGTH + // %.2d
-                            1 + // -
-                            MAX_LONG_STRING_LENGTH + // %.2d
-                            1 + // T
-                            MAX_LONG_STRING_LENGTH + // %.2d
-                            1 + // :
-                            MAX_LONG_STRING_LENGTH + // %.2d
-                            1 + // :
-                            MAX_LONG_STRING_LENGTH + // %.2d
-                            1 + // .
-                            MAX_ULONG_LONG_STRING_LENGTH + // %.12llu
-                            1 + // Z
-                            1 + // \"
-                            1; // " (terminating NULL)
-                        char* tempBuffer = (char*)malloc(tempBufferSize);
-
-                        if (tempBuffer == NULL)
-                        {
-                            result = AGENT_DATA_TYPES_ERROR;
-                            LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
-                        }
-                        else
-                        {
-                            if (sprintf_s(tempBuffer, tempBufferSize, "\"%.4d-%.2d-%.2dT%.2d:%.2d:%.2d.%.12lluZ\"", /*+ in printf forces the sign to appear*/
-                                value->value.edmDateTimeOffset.dateTime.tm_year + 1900,
-                                value->value.edmDateTimeOffset.dateTime.tm_mon+1,
-                                value->value.edmDateTimeOffset.dateTime.tm_mday,
-                                value->value.edmDateTimeOffset.dateTime.tm_hour,
-                                value->value.edmDateTimeOffset.dateTime.tm_min,
-                                value->value.edmDateTimeOffset.dateTime.tm_sec,
-                                value->value.edmDateTimeOffset.fractionalSecond) < 0)
-                            {
-                                result = AGENT_DATA_TYPES_ERROR;
-                                LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
-                            }
-                            else if (STRING_concat(destination, tempBuffer) != 0)
-                            {
-                                result = AGENT_DATA_TYPES_ERROR;
-                                LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
-                            }
-                            else
-                            {
-                                result = AGENT_DATA_TYPES_OK;
-                            }
-
-                            free(tempBuffer);
-                        }
-                    }
-                    else
-                    {
-                        size_t tempBufferSize = 1 + // \"
-                            MAX_LONG_STRING_LENGTH + // %.4d
-                            1 + // -
-                            MAX_LONG_STRING_LENGTH + // %.2d
-                            1 + // -
-                            MAX_LONG_STRING_LENGTH + // %.2d
-                            1 + // T
-                            MAX_LONG_STRING_LENGTH + // %.2d
-                            1 + // :
-                            MAX_LONG_STRING_LENGTH + // %.2d
-                            1 + // :
-                            MAX_LONG_STRING_LENGTH + // %.2d
-                            1 + // Z
-                            1 + // \"
-                            1; // " (terminating null);
-
-                        char* tempBuffer = (char*)malloc(tempBufferSize);
-
-                        if (tempBuffer == NULL)
-                        {
-                            result = AGENT_DATA_TYPES_ERROR;
-                            LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
-                        }
-                        else
-                        {
-                            if (sprintf_s(tempBuffer, tempBufferSize, "\"%.4d-%.2d-%.2dT%.2d:%.2d:%.2dZ\"",
-                                value->value.edmDateTimeOffset.dateTime.tm_year + 1900,
-                                value->value.edmDateTimeOffset.dateTime.tm_mon+1,
-                                value->value.edmDateTimeOffset.dateTime.tm_mday,
-                                value->value.edmDateTimeOffset.dateTime.tm_hour,
-                                value->value.edmDateTimeOffset.dateTime.tm_min,
-                                value->value.edmDateTimeOffset.dateTime.tm_sec) < 0)
-                            {
-                                result = AGENT_DATA_TYPES_ERROR;
-                                LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
-                            }
-                            else if (STRING_concat(destination, tempBuffer) != 0)
-                            {
-                                result = AGENT_DATA_TYPES_ERROR;
-                                LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
-                            }
-                            else
-                            {
-                                result = AGENT_DATA_TYPES_OK;
-                            }
-
-                            free(tempBuffer);
-                        }
-                    }
-                }
-                break;
-            }
-            case(EDM_DECIMAL_TYPE) :
-            {
-                if (STRING_concat_with_STRING(destination, value->value.edmDecimal.value) != 0)
-                {
-                    result = AGENT_DATA_TYPES_ERROR;
-                    LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
-                }
-                else
-                {
-                    result = AGENT_DATA_TYPES_OK;
-                }
-                break;
-            }
-            case (EDM_INT16_TYPE) :
-            {
-                /*-32768 to +32767*/
-                char buffertemp2[7]; /*because 5 digits and sign and '\0'*/
-                uint16_t positiveValue;
+                /*the text is the same as "\"%.4d-%.2d-%.2dT%.2d:%.2d:%.2d[.%.12llu](Z|%+.2d:%.2d)\"" would produce, written without going through sprintf*/
+                char tempBuffer[
+                    1 + // \"
+                    6 * (MAX_LONG_STRING_LENGTH + 1) + // year, month, day, hour, minute, second and their separators
+                    MAX_ULONG_LONG_STRING_LENGTH + // fractional seconds
+                    1 + MAX_LONG_STRING_LENGTH + // sign and time zone hour
+                    1 + // :
+                    MAX_LONG_STRING_LENGTH + // time zone minute
+                    1 + // \"
+                    1]; // terminating NULL
+                const struct tm* dateTime = &value->value.edmDateTimeOffset.dateTime;
                 size_t pos = 0;
-                uint16_t rank = (uint16_t)10000;
-                bool foundFirstDigit = false;
-
-                if (value->value.edmInt16.value < 0)
-                {
-                    buffertemp2[pos++] = '-';
-                    positiveValue = -value->value.edmInt16.value;
-                }
-                else
-                {
-                    positiveValue = value->value.edmInt16.value;
-                }
 
-                while (rank >= 10)
-                {
-                    if ((foundFirstDigit == true) || (positiveValue / rank) > 0)
-                    {
-                        buffertemp2[pos++] = '0' + (char)(positiveValue / rank);
-                        foundFirstDigit = true;
-                    }
-                    positiveValue %= rank;
-                    rank /= 10;
-                }
-                buffertemp2[pos++] = '0' + (char)(positiveValue);
-                buffertemp2[pos++] = '\0';
+                tempBuffer[pos++] = '"';
+                pos += formatPaddedInt(tempBuffer + pos, dateTime->tm_year + 1900, 4, false);
+                tempBuffer[pos++] = '-';
+                pos += formatPaddedInt(tempBuffer + pos, dateTime->tm_mon + 1, 2, false);
+                tempBuffer[pos++] = '-';
+                pos += formatPaddedInt(tempBuffer + pos, dateTime->tm_mday, 2, false);
+                tempBuffer[pos++] = 'T';
+                pos += formatPaddedInt(tempBuffer + pos, dateTime->tm_hour, 2, false);
+                tempBuffer[pos++] = ':';
+                pos += formatPaddedInt(tempBuffer + pos, dateTime->tm_min, 2, false);
+                tempBuffer[pos++] = ':';
+                pos += formatPaddedInt(tempBuffer + pos, dateTime->tm_sec, 2, false);
 
-                if (STRING_concat(destination, buffertemp2) != 0)
+                if (value->value.edmDateTimeOffset.hasFractionalSecond)
                 {
-                    result = AGENT_DATA_TYPES_ERROR;
-                    LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
-                }
-                else
-                {
-                    result = AGENT_DATA_TYPES_OK;
+                    tempBuffer[pos++] = '.';
+                    pos += formatPaddedUnsigned(tempBuffer + pos, value->value.edmDateTimeOffset.fractionalSecond, 12);
                 }
-                break;
-            }
-            case (EDM_INT32_TYPE) :
-            {
-                /*-2147483648 to +2147483647*/
-                char buffertemp2[12]; /*because 10 digits and sign and '\0'*/
-                uint32_t positiveValue;
-                size_t pos = 0;
-                uint32_t rank = 1000000000UL;
-                bool foundFirstDigit = false;
 
-                if (value->value.edmInt32.value < 0)
+                if (value->value.edmDateTimeOffset.hasTimeZone)
                 {
-                    buffertemp2[pos++] = '-';
-                    positiveValue = - value->value.edmInt32.value;
+                    pos += formatPaddedInt(tempBuffer + pos, value->value.edmDateTimeOffset.timeZoneHour, 2, true); /*the sign always appears*/
+                    tempBuffer[pos++] = ':';
+                    pos += formatPaddedInt(tempBuffer + pos, value->value.edmDateTimeOffset.timeZoneMinute, 2, false);
                 }
                 else
                 {
-                    positiveValue = value->value.edmInt32.value;
+                    tempBuffer[pos++] = 'Z';
                 }
 
-                while (rank >= 10)
-                {
-                    if ((foundFirstDigit == true) || (positiveValue / rank) > 0)
-                    {
-                        buffertemp2[pos++] = '0' + (char)(positiveValue / rank);
-                        foundFirstDigit = true;
-                    }
-                    positiveValue %= rank;
-                    rank /= 10;
-                }
-                buffertemp2[pos++] = '0' + (char)(positiveValue);
-                buffertemp2[pos++] = '\0';
+                tempBuffer[pos++] = '"';
+                tempBuffer[pos] = '\0';
 
-                if (STRING_concat(destination, buffertemp2) != 0)
+                if (STRING_concat(destination, tempBuffer) != 0)
                 {
                     result = AGENT_DATA_TYPES_ERROR;
                     LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
@@ -1753,38 +1566,9 @@ AGENT_DATA_TYPES_RESULT AgentDataTypes_ToString(STRING_HANDLE destination, const
                 }
                 break;
             }
-            case (EDM_INT64_TYPE):
+            case(EDM_DECIMAL_TYPE) :
             {
-                char buffertemp2[21]; /*because 19 digits and sign and '\0'*/
-                uint64_t positiveValue;
-                size_t pos = 0;
-                uint64_t rank = 10000000000000000000ULL;
-                bool foundFirstDigit = false;
-
-                if (value->value.edmInt64.value < 0)
-                {
-                    buffertemp2[pos++] = '-';
-                    positiveValue = -value->value.edmInt64.value;
-                }
-                else
-                {
-                    positiveValue = value->value.edmInt64.value;
-                }
-
-                while (rank >= 10)
-                {
-                    if ((foundFirstDigit == true) || (positiveValue / rank) > 0)
-                    {
-                        buffertemp2[pos++] = '0' + (char)(positiveValue / rank);
-                        foundFirstDigit = true;
-                    }
-                    positiveValue %= rank;
-                    rank /= 10;
-                }
-                buffertemp2[pos++] = '0' + (char)(positiveValue);
-                buffertemp2[pos++] = '\0';
-
-                if (STRING_concat(destination, buffertemp2) != 0)
+                if (STRING_concat_with_STRING(destination, value->value.edmDecimal.value) != 0)
                 {
                     result = AGENT_DATA_TYPES_ERROR;
                     LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
@@ -1795,26 +1579,20 @@ AGENT_DATA_TYPES_RESULT AgentDataTypes_ToString(STRING_HANDLE destination, const
                 }
                 break;
             }
+            case (EDM_INT16_TYPE) :
+            case (EDM_INT32_TYPE) :
+            case (EDM_INT64_TYPE) :
+            /*Codes_SRS_AGENT_TYPE_SYSTEM_99_026:[ EDM_SBYTE: sbyteValue = [ sign ] 1*3DIGIT  ; numbers in the range from -128 to 127]*/
             case (EDM_SBYTE_TYPE) :
             {
-                char tempbuffer2[5]; /* because '-' and 3 characters for 127 let's say and '\0'*/
-                int absValue = value->value.edmSbyte.value;
-                size_t pos=0;
-                /*Codes_SRS_AGENT_TYPE_SYSTEM_99_026:[ EDM_SBYTE: sbyteValue = [ sign ] 1*3DIGIT  ; numbers in the range from -128 to 127]*/
-
-                if (value->value.edmSbyte.value < 0)
-                {
-                    tempbuffer2[pos++] = '-';
-                    absValue = -absValue;
-                }
-
-                if (absValue >= 100 ) tempbuffer2[pos++] = '0' + (char)(absValue / 100);
-                if (absValue >=10) tempbuffer2[pos++] = '0' + (absValue % 100) / 10;
-                tempbuffer2[pos++] = '0' + (absValue % 10);
-                tempbuffer2[pos++] = '\0';
-
+                char buffertemp2[MAX_ULONG_LONG_STRING_LENGTH + 1]; /*because 19 digits and sign and '\0'*/
+                int64_t integerValue =
+                    (value->type == EDM_INT16_TYPE) ? value->value.edmInt16.value :
+                    (value->type == EDM_INT32_TYPE) ? value->value.edmInt32.value :
+                    (value->type == EDM_INT64_TYPE) ? value->value.edmInt64.value :
+                    value->value.edmSbyte.value;
 
-                if (STRING_concat(destination, tempbuffer2) != 0)
+                if (STRING_concat(destination, formatInteger(buffertemp2, integerValue)) != 0)
                 {
                     result = AGENT_DATA_TYPES_ERROR;
                     LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
@@ -1828,31 +1606,19 @@ AGENT_DATA_TYPES_RESULT AgentDataTypes_ToString(STRING_HANDLE destination, const
             case (EDM_STRING_TYPE):
             {
                 size_t i;
-                size_t nControlCharacters = 0; /*counts how many characters are to be expanded from 1 character to \uxxxx (6 characters)*/
-                size_t nEscapeCharacters = 0;
+                size_t extraLength = 0; /*how many characters the escape sequences add to the string*/
                 size_t vlen = value->value.edmString.length;
-                char* v = value->value.edmString.chars;
+                const unsigned char* v = (const unsigned char*)value->value.edmString.chars;
 
                 for (i = 0; i < vlen; i++)
                 {
-                    if ((unsigned char)v[i] >= 128) /*this be a UNICODE character begin*/
+                    if (v[i] >= 128) /*this be a UNICODE character begin*/
                     {
                         break;
                     }
                     else
                     {
-                        if (v[i] <= 0x1F)
-                        {
-                            nControlCharacters++;
-                        }
-                        else if (
-                            (v[i] == '"') ||
-                            (v[i] == '\\') ||
-                            (v[i] == '/')
-                            )
-                        {
-                            nEscapeCharacters++;
-                        }
+                        extraLength += jsonEscapeExtraLength[v[i]];
                     }
                 }
 
@@ -1864,8 +1630,10 @@ AGENT_DATA_TYPES_RESULT AgentDataTypes_ToString(STRING_HANDLE destination, const
                 else
                 {
                     /*forward parse the string to scan for " and for \ that in JSON are \" respectively \\*/
-                    size_t tempBufferSize = vlen + 5 * nControlCharacters + nEscapeCharacters + 3 + 1;
-                    char* tempBuffer = (char*)malloc(tempBufferSize);
+                    size_t tempBufferSize = vlen + extraLength + 2 + 1;
+                    char stackBuffer[EDM_STRING_STACK_BUFFER_SIZE];
+                    /*short strings are encoded on the stack, only the longer ones need a heap buffer*/
+                    char* tempBuffer = (tempBufferSize <= sizeof(stackBuffer)) ? stackBuffer : (char*)malloc(tempBufferSize);
                     if (tempBuffer == NULL)
                     {
                         result = AGENT_DATA_TYPES_ERROR;
@@ -1875,44 +1643,52 @@ AGENT_DATA_TYPES_RESULT AgentDataTypes_ToString(STRING_HANDLE destination, const
                     {
                         size_t w = 0;
                         tempBuffer[w++] = '"';
-                        for (i = 0; i < vlen; i++)
+                        if (extraLength == 0)
                         {
-                            if (v[i] <= 0x1F)
-                            {
-                                tempBuffer[w++] = '\\';
-                                tempBuffer[w++] = 'u';
-                                tempBuffer[w++] = '0';
-                                tempBuffer[w++] = '0';
-                                tempBuffer[w++] = hexToASCII[(v[i] & 0xF0) >> 4]; /*high nibble*/
-                                tempBuffer[w++] = hexToASCII[v[i] & 0x0F]; /*lowNibble nibble*/
-                            }
-                            else if (v[i] == '"')
-                            {
-                                tempBuffer[w++] = '\\';
-                                tempBuffer[w++] = '"';
-                            }
-                            else if (v[i] == '\\')
-                            {
-                                tempBuffer[w++] = '\\';
-                                tempBuffer[w++] = '\\';
-                            }
-                            else if (v[i] == '/')
-                            {
-                                tempBuffer[w++] = '\\';
-                                tempBuffer[w++] = '/';
-                            }
-                            else
+                            /*nothing to escape, the string is copied in one go*/
+                            (void)memcpy(tempBuffer + w, v, vlen);
+                            w += vlen;
+                        }
+                        else
+                        {
+                            i = 0;
+                            while (i < vlen)
                             {
-                                tempBuffer[w++] = v[i];
+                                /*runs of characters that need no escaping are copied in one go*/
+                                size_t runStart = i;
+                                while ((i < vlen) && (jsonEscapeExtraLength[v[i]] == 0))
+                                {
+                                    i++;
+                                }
+                                (void)memcpy(tempBuffer + w, v + runStart, i - runStart);
+                                w += i - runStart;
+
+                                if (i < vlen)
+                                {
+                                    tempBuffer[w++] = '\\';
+                                    if (v[i] <= 0x1F)
+                                    {
+                                        tempBuffer[w++] = 'u';
+                                        tempBuffer[w++] = '0';
+                                        tempBuffer[w++] = '0';
+                                        tempBuffer[w++] = hexToASCII[(v[i] & 0xF0) >> 4]; /*high nibble*/
+                                        tempBuffer[w++] = hexToASCII[v[i] & 0x0F]; /*lowNibble nibble*/
+                                    }
+                                    else
+                                    {
+                                        tempBuffer[w++] = (char)v[i]; /*one of " \ /*/
+                                    }
+                                    i++;
+                                }
                             }
                         }
 
 #ifdef _MSC_VER
 #pragma warning(suppress: 6386) /* The test Create_AGENT_DATA_TYPE_from_charz_With_2_Slashes_Succeeds verifies that Code Analysis is wrong here */
 #endif
-                        tempBuffer[w] = '"';
+                        tempBuffer[w++] = '"';
                         /*zero terminating it*/
-                        tempBuffer[vlen + 5 * nControlCharacters + nEscapeCharacters + 3 - 1] = '\0';
+                        tempBuffer[w] = '\0';
 
                         if (STRING_concat(destination, tempBuffer) != 0)
                         {
@@ -1924,7 +1700,10 @@ AGENT_DATA_TYPES_RESULT AgentDataTypes_ToString(STRING_HANDLE destination, const
                             result = AGENT_DATA_TYPES_OK;
                         }
 
-                        free(tempBuffer);
+                        if (tempBuffer != stackBuffer)
+                        {
+                            free(tempBuffer);
+                        }
                     }
                 }
 
@@ -1995,31 +1774,20 @@ AGENT_DATA_TYPES_RESULT AgentDataTypes_ToString(STRING_HANDLE destination, const
                 }
                 else
                 {
-                    size_t tempBufferSize = MAX_FLOATING_POINT_STRING_LENGTH;
-                    char* tempBuffer = (char*)malloc(tempBufferSize);
-                    if (tempBuffer == NULL)
-                    {
-                        result = AGENT_DATA_TYPES_ERROR;
-                        LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
-                    }
-                    else
+                    char tempBuffer[MAX_FLOATING_POINT_STRING_LENGTH];
+                    if (sprintf_s(tempBuffer, sizeof(tempBuffer), "%.*f", FLT_DIG, (double)(value->value.edmSingle.value)) < 0)
                     {
-                        if (sprintf_s(tempBuffer, tempBufferSize, "%.*f", FLT_DIG, (double)(value->value.edmSingle.value)) < 0)
-                        {
-                            result = AGENT_DATA_TYPES_ERROR;
-                            LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
-                        }
-                        else if (STRING_concat(destination, tempBuffer) != 0)
-                        {
-                            result = AGENT_DATA_TYPES_ERROR;
-                            LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
-                        }
-                        else
-                        {
-                            result = AGENT_DATA_TYPES_OK;
-                        }
-
-                        free(tempBuffer);
+                        result = AGENT_DATA_TYPES_ERROR;
+                        LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
+                    }
+                    else if (STRING_concat(destination, tempBuffer) != 0)
+                    {
+                        result = AGENT_DATA_TYPES_ERROR;
+                        LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
+                    }
+                    else
+                    {
+                        result = AGENT_DATA_TYPES_OK;
                     }
                 }
                 break;
@@ -2073,31 +1841,20 @@ AGENT_DATA_TYPES_RESULT AgentDataTypes_ToString(STRING_HANDLE destination, const
                 /*Codes_SRS_AGENT_TYPE_SYSTEM_99_022:[ EDM_DOUBLE: doubleValue = decimalValue [ "e" [SIGN] 1*DIGIT ] / nanInfinity ; IEEE 754 binary64 floating-point number (15-17 decimal digits). The representation shall use DBL_DIG C #define*/
                 else
                 {
-                    size_t tempBufferSize = DECIMAL_DIG * 2;
-                    char* tempBuffer = (char*)malloc(tempBufferSize);
-                    if (tempBuffer == NULL)
+                    char tempBuffer[DECIMAL_DIG * 2];
+                    if (sprintf_s(tempBuffer, sizeof(tempBuffer), "%.*f", DBL_DIG, value->value.edmDouble.value) < 0)
+                    {
+                        result = AGENT_DATA_TYPES_ERROR;
+                        LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
+                    }
+                    else if (STRING_concat(destination, tempBuffer) != 0)
                     {
                         result = AGENT_DATA_TYPES_ERROR;
                         LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
                     }
                     else
                     {
-                        if (sprintf_s(tempBuffer, tempBufferSize, "%.*f", DBL_DIG, value->value.edmDouble.value) < 0)
-                        {
-                            result = AGENT_DATA_TYPES_ERROR;
-                            LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
-                        }
-                        else if (STRING_concat(destination, tempBuffer) != 0)
-                        {
-                            result = AGENT_DATA_TYPES_ERROR;
-                            LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
-                        }
-                        else
-                        {
-                            result = AGENT_DATA_TYPES_OK;
-                        }
-
-                        free(tempBuffer);
+                        result = AGENT_DATA_TYPES_OK;
                     }
                 }
                 break;
@@ -2218,6 +1975,7 @@ AGENT_DATA_TYPES_RESULT AgentDataTypes_ToString(STRING_HANDLE destination, const
             case EDM_BINARY_TYPE:
             {
                 size_t currentPosition = 0;
+                char stackBuffer[EDM_BINARY_STACK_BUFFER_SIZE];
                 char* temp;
                 /*binary types */
                 /*Codes_SRS_AGENT_TYPE_SYSTEM_99_099:[EDM_BINARY:= *(4base64char)[base64b16 / base64b8]]*/
@@ -2230,7 +1988,8 @@ AGENT_DATA_TYPES_RESULT AgentDataTypes_ToString(STRING_HANDLE destination, const
                 size_t neededSize = 2; /*2 because starting and ending quotes */
                 neededSize += (value->value.edmBinary.size == 0) ? (0) : ((((value->value.edmBinary.size-1) / 3) + 1) * 4);
                 neededSize += 1; /*+1 because \0 at the end of the string*/
-                if ((temp = (char*)malloc(neededSize))==NULL)
+                /*small binaries are encoded on the stack, only the larger ones need a heap buffer*/
+                if ((temp = (neededSize <= sizeof(stackBuffer)) ? stackBuffer : (char*)malloc(neededSize)) == NULL)
                 {
                     result = AGENT_DATA_TYPES_ERROR;
                 }
@@ -2241,48 +2000,30 @@ AGENT_DATA_TYPES_RESULT AgentDataTypes_ToString(STRING_HANDLE destination, const
                       |----c1---| |----c2---| |----c3---| |----c4---|
                     */
 
+                    const unsigned char* data = value->value.edmBinary.data;
+                    size_t size = value->value.edmBinary.size;
                     size_t destinationPointer = 0;
                     temp[destinationPointer++] = '"';
-                    while (value->value.edmBinary.size - currentPosition >= 3)
-                    {
-                        char c1 = base64char(value->value.edmBinary.data[currentPosition] >> 2);
-                        char c2 = base64char(
-                            ((value->value.edmBinary.data[currentPosition] & 3) << 4) |
-                                (value->value.edmBinary.data[currentPosition + 1] >> 4)
-                        );
-                        char c3 = base64char(
-                            ((value->value.edmBinary.data[currentPosition + 1] & 0x0F) << 2) |
-                                ((value->value.edmBinary.data[currentPosition + 2] >> 6) & 3)
-                        );
-                        char c4 = base64char(
-                            value->value.edmBinary.data[currentPosition + 2] & 0x3F
-                        );
+                    while (size - currentPosition >= 3)
+                    {
+                        uint32_t group = ((uint32_t)data[currentPosition] << 16) | ((uint32_t)data[currentPosition + 1] << 8) | data[currentPosition + 2];
+                        temp[destinationPointer++] = base64char(group >> 18);
+                        temp[destinationPointer++] = base64char(group >> 12);
+                        temp[destinationPointer++] = base64char(group >> 6);
+                        temp[destinationPointer++] = base64char(group);
                         currentPosition += 3;
-                        temp[destinationPointer++] = c1;
-                        temp[destinationPointer++] = c2;
-                        temp[destinationPointer++] = c3;
-                        temp[destinationPointer++] = c4;
-
-                    }
-                    if (value->value.edmBinary.size - currentPosition == 2)
-                    {
-                        char c1 = base64char(value->value.edmBinary.data[currentPosition] >> 2);
-                        char c2 = base64char(
-                            ((value->value.edmBinary.data[currentPosition] & 0x03) << 4) |
-                                (value->value.edmBinary.data[currentPosition + 1] >> 4)
-                        );
-                        char c3 = base64b16(value->value.edmBinary.data[currentPosition + 1] & 0x0F);
-                        temp[destinationPointer++] = c1;
-                        temp[destinationPointer++] = c2;
-                        temp[destinationPointer++] = c3;
+                    }
+                    if (size - currentPosition == 2)
+                    {
+                        temp[destinationPointer++] = base64char(data[currentPosition] >> 2);
+                        temp[destinationPointer++] = base64char(((data[currentPosition] & 0x03) << 4) | (data[currentPosition + 1] >> 4));
+                        temp[destinationPointer++] = base64b16(data[currentPosition + 1]);
                         temp[destinationPointer++] = '=';
                     }
-                    else if (value->value.edmBinary.size - currentPosition == 1)
+                    else if (size - currentPosition == 1)
                     {
-                        char c1 = base64char(value->value.edmBinary.data[currentPosition] >> 2);
-                        char c2 = base64b8(value->value.edmBinary.data[currentPosition] & 0x03);
-                        temp[destinationPointer++] = c1;
-                        temp[destinationPointer++] = c2;
+                        temp[destinationPointer++] = base64char(data[currentPosition] >> 2);
+                        temp[destinationPointer++] = base64b8(data[currentPosition]);
                         temp[destinationPointer++] = '=';
                         temp[destinationPointer++] = '=';
                     }
@@ -2301,7 +2042,10 @@ AGENT_DATA_TYPES_RESULT AgentDataTypes_ToString(STRING_HANDLE destination, const
                     {
                         result = AGENT_DATA_TYPES_OK;
                     }
-                    free(temp);
+                    if (temp != stackBuffer)
+                    {
+                        free(temp);
+                    }
                 }
                 break;
             }
@@ -2346,6 +2090,51 @@ out:
     return result;
 }
 
+/*allocates in a single block the nMembers fields of a complex type, followed by their values and by a copy of their names,
+taken from memberNames or else from the fields of srcFields. The values are set to EDM_NO_TYPE so the block can always be
+destroyed like a complete one. Returns NULL on failure.*/
+static COMPLEX_TYPE_FIELD_TYPE* allocateComplexTypeFields(size_t nMembers, const char* const * memberNames, const COMPLEX_TYPE_FIELD_TYPE* srcFields)
+{
+    COMPLEX_TYPE_FIELD_TYPE* result;
+    size_t namesSize = 0;
+    size_t i;
+
+    for (i = 0; i < nMembers; i++)
+    {
+        namesSize += strlen((memberNames != NULL) ? memberNames[i] : srcFields[i].fieldName) + 1;
+    }
+
+    if (nMembers > (SIZE_MAX - namesSize) / (sizeof(COMPLEX_TYPE_FIELD_TYPE) + sizeof(AGENT_DATA_TYPE)))
+    {
+        result = NULL;
+        LogError("the fields of %lu members do not fit in memory", (unsigned long)nMembers);
+    }
+    else if ((result = (COMPLEX_TYPE_FIELD_TYPE*)malloc(nMembers * (sizeof(COMPLEX_TYPE_FIELD_TYPE) + sizeof(AGENT_DATA_TYPE)) + namesSize)) == NULL)
+    {
+        LogError("unable to allocate the fields of %lu members", (unsigned long)nMembers);
+    }
+    else
+    {
+        AGENT_DATA_TYPE* values = (AGENT_DATA_TYPE*)(result + nMembers);
+        char* names = (char*)(values + nMembers);
+
+        for (i = 0; i < nMembers; i++)
+        {
+            const char* name = (memberNames != NULL) ? memberNames[i] : srcFields[i].fieldName;
+            size_t nameSize = strlen(name) + 1;
+
+            (void)memcpy(names, name, nameSize);
+            result[i].fieldName = names;
+            names += nameSize;
+
+            values[i].type = EDM_NO_TYPE;
+            result[i].value = &values[i];
+        }
+    }
+
+    return result;
+}
+
 static void DestroyHalfBakedComplexType(AGENT_DATA_TYPE* agentData)
 {
     size_t i;
@@ -2355,19 +2144,10 @@ static void DestroyHalfBakedComplexType(AGENT_DATA_TYPE* agentData)
         {
             if (agentData->value.edmComplexType.fields != NULL)
             {
+                /*the values not created yet are EDM_NO_TYPE*/
                 for (i = 0; i < agentData->value.edmComplexType.nMembers; i++)
                 {
-                    if (agentData->value.edmComplexType.fields[i].fieldName != NULL)
-                    {
-                        free((void*)(agentData->value.edmComplexType.fields[i].fieldName));
-                        agentData->value.edmComplexType.fields[i].fieldName = NULL;
-                    }
-                    if (agentData->value.edmComplexType.fields[i].value != NULL)
-                    {
-                        Destroy_AGENT_DATA_TYPE(agentData->value.edmComplexType.fields[i].value);
-                        free(agentData->value.edmComplexType.fields[i].value);
-                        agentData->value.edmComplexType.fields[i].value = NULL;
-                    }
+                    Destroy_AGENT_DATA_TYPE(agentData->value.edmComplexType.fields[i].value);
                 }
                 free(agentData->value.edmComplexType.fields);
                 agentData->value.edmComplexType.fields = NULL;
@@ -2697,7 +2477,8 @@ AGENT_DATA_TYPES_RESULT Create_AGENT_DATA_TYPE_from_AGENT_DATA_TYPE(AGENT_DATA_T
                 else
                 {
                     dest->value.edmComplexType.nMembers = src->value.edmComplexType.nMembers;
-                    dest->value.edmComplexType.fields = (COMPLEX_TYPE_FIELD_TYPE*)malloc(dest->value.edmComplexType.nMembers * sizeof(COMPLEX_TYPE_FIELD_TYPE));
+                    /*Codes_SRS_AGENT_TYPE_SYSTEM_41_002: [ Create_AGENT_DATA_TYPE_from_AGENT_DATA_TYPE shall copy the fields of a complex type, their values and their names in a single allocation. ]*/
+                    dest->value.edmComplexType.fields = allocateComplexTypeFields(dest->value.edmComplexType.nMembers, NULL, src->value.edmComplexType.fields);
                     if (dest->value.edmComplexType.fields == NULL)
                     {
                         result = AGENT_DATA_TYPES_ERROR;
@@ -2707,14 +2488,8 @@ AGENT_DATA_TYPES_RESULT Create_AGENT_DATA_TYPE_from_AGENT_DATA_TYPE(AGENT_DATA_T
                     {
                         for (i = 0; i < dest->value.edmComplexType.nMembers; i++)
                         {
-                            dest->value.edmComplexType.fields[i].fieldName = NULL;
-                            dest->value.edmComplexType.fields[i].value = NULL;
-                        }
-
-                        for (i = 0; i < dest->value.edmComplexType.nMembers; i++)
-                        {
-                            /*copy the name of this field*/
-                            if (mallocAndStrcpy_s((char**)(&(dest->value.edmComplexType.fields[i].fieldName)), src->value.edmComplexType.fields[i].fieldName) != 0)
+                            /*the names are already copied, the value copy follows*/
+                            if (Create_AGENT_DATA_TYPE_from_AGENT_DATA_TYPE(dest->value.edmComplexType.fields[i].value, src->value.edmComplexType.fields[i].value) != AGENT_DATA_TYPES_OK)
                             {
                                 result = AGENT_DATA_TYPES_ERROR;
                                 LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
@@ -2722,28 +2497,7 @@ AGENT_DATA_TYPES_RESULT Create_AGENT_DATA_TYPE_from_AGENT_DATA_TYPE(AGENT_DATA_T
                             }
                             else
                             {
-                                /*field name copied success*/
-                                /*field value copy follows*/
-                                dest->value.edmComplexType.fields[i].value = (AGENT_DATA_TYPE*)malloc(sizeof(AGENT_DATA_TYPE));
-                                if (dest->value.edmComplexType.fields[i].value == NULL)
-                                {
-                                    result = AGENT_DATA_TYPES_ERROR;
-                                    LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
-                                    break;
-                                }
-                                else
-                                {
-                                    if (Create_AGENT_DATA_TYPE_from_AGENT_DATA_TYPE(dest->value.edmComplexType.fields[i].value, src->value.edmComplexType.fields[i].value) != AGENT_DATA_TYPES_OK)
-                                    {
-                                        result = AGENT_DATA_TYPES_ERROR;
-                                        LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
-                                        break;
-                                    }
-                                    else
-                                    {
-                                        /*all is fine*/
-                                    }
-                                }
+                                /*all is fine*/
                             }
                         }
 
@@ -2874,7 +2628,8 @@ AGENT_DATA_TYPES_RESULT Create_AGENT_DATA_TYPE_from_Members(AGENT_DATA_TYPE* age
     else
     {
         agentData->value.edmComplexType.nMembers = nMembers;
-        agentData->value.edmComplexType.fields = (COMPLEX_TYPE_FIELD_TYPE*)malloc(nMembers *sizeof(COMPLEX_TYPE_FIELD_TYPE));
+        /*Codes_SRS_AGENT_TYPE_SYSTEM_41_001: [ Create_AGENT_DATA_TYPE_from_Members shall allocate the fields, their values and a copy of memberNames in a single allocation. ]*/
+        agentData->value.edmComplexType.fields = allocateComplexTypeFields(nMembers, memberNames, NULL);
         if (agentData->value.edmComplexType.fields == NULL)
         {
             result = AGENT_DATA_TYPES_ERROR;
@@ -2884,17 +2639,10 @@ AGENT_DATA_TYPES_RESULT Create_AGENT_DATA_TYPE_from_Members(AGENT_DATA_TYPE* age
         {
             result = AGENT_DATA_TYPES_OK; /*not liking this, solution might be to use a temp variable*/
 
-            /*initialize the fields*/
-            for (i = 0; i < nMembers; i++)
-            {
-                agentData->value.edmComplexType.fields[i].fieldName = NULL;
-                agentData->value.edmComplexType.fields[i].value = NULL;
-            }
-
             for (i = 0; i < nMembers; i++)
             {
-                /*copy the name*/
-                if (mallocAndStrcpy_s((char**)(&(agentData->value.edmComplexType.fields[i].fieldName)), memberNames[i]) != 0)
+                /*copy the values*/
+                if (Create_AGENT_DATA_TYPE_from_AGENT_DATA_TYPE(agentData->value.edmComplexType.fields[i].value, &(memberValues[i])) != AGENT_DATA_TYPES_OK)
                 {
                     result = AGENT_DATA_TYPES_ERROR;
                     LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
@@ -2902,40 +2650,15 @@ AGENT_DATA_TYPES_RESULT Create_AGENT_DATA_TYPE_from_Members(AGENT_DATA_TYPE* age
                 }
                 else
                 {
-                    /*field name was transferred successfully*/
-                    /*copy the rest*/
-                    agentData->value.edmComplexType.fields[i].value = (AGENT_DATA_TYPE*)malloc(sizeof(AGENT_DATA_TYPE));
-                    if (agentData->value.edmComplexType.fields[i].value == NULL)
-                    {
-                        /*deallocate the name*/
-                        free((void*)(agentData->value.edmComplexType.fields[i].fieldName));
-                        agentData->value.edmComplexType.fields[i].fieldName = NULL;
-                        result = AGENT_DATA_TYPES_ERROR;
-                        LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
-                        break;
-                    }
-                    else
-                    {
-                        /*copy the values*/
-                        if (Create_AGENT_DATA_TYPE_from_AGENT_DATA_TYPE(agentData->value.edmComplexType.fields[i].value, &(memberValues[i])) != AGENT_DATA_TYPES_OK)
-                        {
-                            result = AGENT_DATA_TYPES_ERROR;
-                            LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
-                            break;
-                        }
-                        else
-                        {
-                            /*all is fine*/
-                        }
-                    }
+                    /*all is fine*/
                 }
-
             }
         }
 
         if (result != AGENT_DATA_TYPES_OK)
         {
             /*dealloc, something went bad*/
+            agentData->type = EDM_COMPLEX_TYPE_TYPE;
             DestroyHalfBakedComplexType(agentData);
         }
         else
@@ -3042,20 +2765,32 @@ static int sscanfllu(const char** src, unsigned long long* dst)
     return result;
 }
 
-/*the following function does the same as  sscanf(src, ".%llu", &dst)*/
-static int sscanfdotllu(const char*src, unsigned long long* dst)
+/*reads ".digits" in one pass and returns the first character after the digits, or NULL when there are no digits.
+*dst saturates just above the largest value allowed for fractional seconds*/
+static const char* scanDotAndFractionalSeconds(const char* src, unsigned long long* dst)
 {
-    int result;
+    const char* result;
 
     if ((*src) != '.')
     {
         /*doesn't start with '.' error out*/
-        result = EOF;
+        result = NULL;
+    }
+    else if (!IS_DIGIT(src[1]))
+    {
+        result = NULL;
     }
     else
     {
-        src++;
-        result = sscanfllu(&src, dst);
+        unsigned long long value = 0;
+        for (result = src + 1; IS_DIGIT(*result); result++)
+        {
+            if (value <= 999999999999ULL)
+            {
+                value = value * 10 + (unsigned long long)(*result - '0');
+            }
+        }
+        (*dst) = value;
     }
 
     return result;
@@ -3079,6 +2814,185 @@ static int sscanfu(const char* src, uint32_t* dst)
     return result;
 }
 
+/*powers of ten up to 10^22 are exact in a double (and up to 10^10 in a float)*/
+static const double exactPowersOfTen[] =
+{
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/*scans the whole of src as [sign] [digits] [. digits] [e [sign] digits] in one pass, without looking at the locale.
+returns 0 when src is such a number with at most 19 significant digits, value being (-1)^isNegative * mantissa * 10^exponent10*/
+static int scanDecimalNumber(const char* src, uint64_t* mantissa, int* exponent10, bool* isNegative)
+{
+    int result;
+    uint64_t digits = 0;
+    int nSignificantDigits = 0;
+    int exponent = 0;
+    bool hasDigits = false;
+    bool tooManyDigits = false;
+
+    *isNegative = (*src == '-');
+    if ((*src == '-') || (*src == '+'))
+    {
+        src++;
+    }
+
+    for (; IS_DIGIT(*src); src++)
+    {
+        hasDigits = true;
+        if ((digits != 0) || (*src != '0'))
+        {
+            if (nSignificantDigits == 19)
+            {
+                tooManyDigits = true;
+            }
+            else
+            {
+                digits = digits * 10 + (uint64_t)(*src - '0');
+                nSignificantDigits++;
+            }
+        }
+    }
+
+    if (*src == '.')
+    {
+        for (src++; IS_DIGIT(*src); src++)
+        {
+            hasDigits = true;
+            if ((digits != 0) || (*src != '0'))
+            {
+                if (nSignificantDigits == 19)
+                {
+                    tooManyDigits = true;
+                }
+                else
+                {
+                    digits = digits * 10 + (uint64_t)(*src - '0');
+                    nSignificantDigits++;
+                    exponent--;
+                }
+            }
+            else
+            {
+                /*leading zeroes of the fractional part only move the decimal point*/
+                exponent--;
+            }
+        }
+    }
+
+    if (hasDigits && ((*src == 'e') || (*src == 'E')))
+    {
+        bool negativeExponent;
+        int explicitExponent = 0;
+
+        src++;
+        negativeExponent = (*src == '-');
+        if ((*src == '-') || (*src == '+'))
+        {
+            src++;
+        }
+
+        if (!IS_DIGIT(*src))
+        {
+            hasDigits = false;
+        }
+
+        for (; IS_DIGIT(*src); src++)
+        {
+            if (explicitExponent < 100000)
+            {
+                explicitExponent = explicitExponent * 10 + (*src - '0');
+            }
+        }
+
+        exponent += negativeExponent ? -explicitExponent : explicitExponent;
+    }
+
+    if (!hasDigits || tooManyDigits || (*src != '\0'))
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        *mantissa = digits;
+        *exponent10 = exponent;
+        result = 0;
+    }
+
+    return result;
+}
+
+/*when the mantissa and the power of ten are both exact, one multiplication or division is correctly rounded (Clinger's fast path).
+returns 0 when that is the case, otherwise the caller has to go through strtod*/
+static int fastParseDouble(const char* src, double* dst)
+{
+    int result;
+    uint64_t mantissa;
+    int exponent10;
+    bool isNegative;
+
+#if defined(FLT_EVAL_METHOD) && (FLT_EVAL_METHOD == 0)
+    if ((scanDecimalNumber(src, &mantissa, &exponent10, &isNegative) == 0) &&
+        (mantissa <= ((uint64_t)1 << 53)) &&
+        (exponent10 >= -22) &&
+        (exponent10 <= 22))
+    {
+        double value = (double)mantissa;
+        value = (exponent10 < 0) ? (value / exactPowersOfTen[-exponent10]) : (value * exactPowersOfTen[exponent10]);
+        *dst = isNegative ? -value : value;
+        result = 0;
+    }
+    else
+#else
+    (void)src;
+    (void)dst;
+    (void)mantissa;
+    (void)exponent10;
+    (void)isNegative;
+#endif
+    {
+        result = __FAILURE__;
+    }
+
+    return result;
+}
+
+/*same as fastParseDouble, in float arithmetic*/
+static int fastParseFloat(const char* src, float* dst)
+{
+    int result;
+    uint64_t mantissa;
+    int exponent10;
+    bool isNegative;
+
+#if defined(FLT_EVAL_METHOD) && (FLT_EVAL_METHOD == 0)
+    if ((scanDecimalNumber(src, &mantissa, &exponent10, &isNegative) == 0) &&
+        (mantissa <= ((uint64_t)1 << 24)) &&
+        (exponent10 >= -10) &&
+        (exponent10 <= 10))
+    {
+        float value = (float)mantissa;
+        float powerOfTen = (float)exactPowersOfTen[(exponent10 < 0) ? -exponent10 : exponent10];
+        value = (exponent10 < 0) ? (value / powerOfTen) : (value * powerOfTen);
+        *dst = isNegative ? -value : value;
+        result = 0;
+    }
+    else
+#else
+    (void)src;
+    (void)dst;
+    (void)mantissa;
+    (void)exponent10;
+    (void)isNegative;
+#endif
+    {
+        result = __FAILURE__;
+    }
+
+    return result;
+}
+
 /*the following function does the same as  sscanf(src, "%f", &dst)*/
 static int sscanff(const char*src, float* dst)
 {
@@ -3480,9 +3394,37 @@ AGENT_DATA_TYPES_RESULT CreateAgentDataType_From_String(const char* source, AGEN
                     }
                     else
                     {
-                        const char* pos2;
+                        /*the layout is fixed, so the optional parts start right after the minutes*/
+                        const char* pos2 = source + pos;
                         year = year*sign;
-                        if ((pos2 = strchr(source, ':')) == NULL)
+
+                        if (*pos2 == ':')
+                        {
+                            if (sscanf2d(pos2, &sec) != 1)
+                            {
+                                pos2 = NULL;
+                            }
+                            else
+                            {
+                                pos2 += 3;
+                            }
+                        }
+
+                        if ((pos2 != NULL) &&
+                            (*pos2 == '.'))
+                        {
+                            if ((pos2 = scanDotAndFractionalSeconds(pos2, &fractionalSeconds)) != NULL)
+                            {
+                                agentData->value.edmDateTimeOffset.hasFractionalSecond = 1;
+
+                                if (*pos2 == '\0')
+                                {
+                                    pos2 = NULL;
+                                }
+                            }
+                        }
+
+                        if (pos2 == NULL)
                         {
                             /* Codes_SRS_AGENT_TYPE_SYSTEM_99_087:[ CreateAgentDataType_From_String shall return AGENT_DATA_TYPES_INVALID_ARG if source is not a valid string for a value of type type.] */
                             result = AGENT_DATA_TYPES_INVALID_ARG;
@@ -3490,105 +3432,57 @@ AGENT_DATA_TYPES_RESULT CreateAgentDataType_From_String(const char* source, AGEN
                         }
                         else
                         {
-                            pos2 += 3;
-                            if (*pos2 == ':')
+                            hourOffset = 0;
+                            minOffset = 0;
+
+                            if (sscanf3d2d(pos2, &hourOffset, &minOffset) == 2)
                             {
-                                if (sscanf2d(pos2, &sec) != 1)
-                                {
-                                    pos2 = NULL;
-                                }
-                                else
-                                {
-                                    pos2 += 3;
-                                }
+                                agentData->value.edmDateTimeOffset.hasTimeZone = 1;
                             }
 
-                            if ((pos2 != NULL) &&
-                                (*pos2 == '.'))
+                            if ((strcmp(pos2, "Z\"") == 0) ||
+                                agentData->value.edmDateTimeOffset.hasTimeZone)
                             {
-                                if (sscanfdotllu(pos2, &fractionalSeconds) != 1)
+                                if ((ValidateDate(year, month, day) != 0) ||
+                                    (hour < 0) ||
+                                    (hour > 23) ||
+                                    (min < 0) ||
+                                    (min > 59) ||
+                                    (sec < 0) ||
+                                    (sec > 59) ||
+                                    (fractionalSeconds > 999999999999) ||
+                                    (hourOffset < -23) ||
+                                    (hourOffset > 23) ||
+                                    (minOffset < 0) ||
+                                    (minOffset > 59))
                                 {
-                                    pos2 = NULL;
+                                    /* Codes_SRS_AGENT_TYPE_SYSTEM_99_087:[ CreateAgentDataType_From_String shall return AGENT_DATA_TYPES_INVALID_ARG if source is not a valid string for a value of type type.] */
+                                    result = AGENT_DATA_TYPES_INVALID_ARG;
+                                    LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
                                 }
                                 else
                                 {
-                                    pos2++;
-
-                                    agentData->value.edmDateTimeOffset.hasFractionalSecond = 1;
-
-                                    while ((*pos2 != '\0') &&
-                                        (IS_DIGIT(*pos2)))
-                                    {
-                                        pos2++;
-                                    }
-
-                                    if (*pos2 == '\0')
-                                    {
-                                        pos2 = NULL;
-                                    }
+                                    agentData->type = EDM_DATE_TIME_OFFSET_TYPE;
+                                    agentData->value.edmDateTimeOffset.dateTime.tm_year= year-1900;
+                                    agentData->value.edmDateTimeOffset.dateTime.tm_mon = month-1;
+                                    agentData->value.edmDateTimeOffset.dateTime.tm_mday = day;
+                                    agentData->value.edmDateTimeOffset.dateTime.tm_hour = hour;
+                                    agentData->value.edmDateTimeOffset.dateTime.tm_min = min;
+                                    agentData->value.edmDateTimeOffset.dateTime.tm_sec = sec;
+                                    /*fill in tm_wday and tm_yday*/
+                                    fill_tm_yday_and_tm_wday(&agentData->value.edmDateTimeOffset.dateTime);
+                                    agentData->value.edmDateTimeOffset.fractionalSecond = (uint64_t)fractionalSeconds;
+                                    agentData->value.edmDateTimeOffset.timeZoneHour = (int8_t)hourOffset;
+                                    agentData->value.edmDateTimeOffset.timeZoneMinute = (uint8_t)minOffset;
+                                    result = AGENT_DATA_TYPES_OK;
                                 }
                             }
-
-                            if (pos2 == NULL)
+                            else
                             {
                                 /* Codes_SRS_AGENT_TYPE_SYSTEM_99_087:[ CreateAgentDataType_From_String shall return AGENT_DATA_TYPES_INVALID_ARG if source is not a valid string for a value of type type.] */
                                 result = AGENT_DATA_TYPES_INVALID_ARG;
                                 LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
                             }
-                            else
-                            {
-                                hourOffset = 0;
-                                minOffset = 0;
-
-                                if (sscanf3d2d(pos2, &hourOffset, &minOffset) == 2)
-                                {
-                                    agentData->value.edmDateTimeOffset.hasTimeZone = 1;
-                                }
-
-                                if ((strcmp(pos2, "Z\"") == 0) ||
-                                    agentData->value.edmDateTimeOffset.hasTimeZone)
-                                {
-                                    if ((ValidateDate(year, month, day) != 0) ||
-                                        (hour < 0) ||
-                                        (hour > 23) ||
-                                        (min < 0) ||
-                                        (min > 59) ||
-                                        (sec < 0) ||
-                                        (sec > 59) ||
-                                        (fractionalSeconds > 999999999999) ||
-                                        (hourOffset < -23) ||
-                                        (hourOffset > 23) ||
-                                        (minOffset < 0) ||
-                                        (minOffset > 59))
-                                    {
-                                        /* Codes_SRS_AGENT_TYPE_SYSTEM_99_087:[ CreateAgentDataType_From_String shall return AGENT_DATA_TYPES_INVALID_ARG if source is not a valid string for a value of type type.] */
-                                        result = AGENT_DATA_TYPES_INVALID_ARG;
-                                        LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
-                                    }
-                                    else
-                                    {
-                                        agentData->type = EDM_DATE_TIME_OFFSET_TYPE;
-                                        agentData->value.edmDateTimeOffset.dateTime.tm_year= year-1900;
-                                        agentData->value.edmDateTimeOffset.dateTime.tm_mon = month-1;
-                                        agentData->value.edmDateTimeOffset.dateTime.tm_mday = day;
-                                        agentData->value.edmDateTimeOffset.dateTime.tm_hour = hour;
-                                        agentData->value.edmDateTimeOffset.dateTime.tm_min = min;
-                                        agentData->value.edmDateTimeOffset.dateTime.tm_sec = sec;
-                                        /*fill in tm_wday and tm_yday*/
-                                        fill_tm_yday_and_tm_wday(&agentData->value.edmDateTimeOffset.dateTime);
-                                        agentData->value.edmDateTimeOffset.fractionalSecond = (uint64_t)fractionalSeconds;
-                                        agentData->value.edmDateTimeOffset.timeZoneHour = (int8_t)hourOffset;
-                                        agentData->value.edmDateTimeOffset.timeZoneMinute = (uint8_t)minOffset;
-                                        result = AGENT_DATA_TYPES_OK;
-                                    }
-                                }
-                                else
-                                {
-                                    /* Codes_SRS_AGENT_TYPE_SYSTEM_99_087:[ CreateAgentDataType_From_String shall return AGENT_DATA_TYPES_INVALID_ARG if source is not a valid string for a value of type type.] */
-                                    result = AGENT_DATA_TYPES_INVALID_ARG;
-                                    LogError("(result = %s)", ENUM_TO_STRING(AGENT_DATA_TYPES_RESULT, result));
-                                }
-                            }
                         }
                     }
                 }
@@ -3624,7 +3518,8 @@ AGENT_DATA_TYPES_RESULT CreateAgentDataType_From_String(const char* source, AGEN
 #endif
                     result = AGENT_DATA_TYPES_OK;
                 }
-                else if (sscanflf(source, &(agentData->value.edmDouble.value)) != 1)
+                else if ((fastParseDouble(source, &(agentData->value.edmDouble.value)) != 0) &&
+                    (sscanflf(source, &(agentData->value.edmDouble.value)) != 1))
                 {
                     /* Codes_SRS_AGENT_TYPE_SYSTEM_99_087:[ CreateAgentDataType_From_String shall return AGENT_DATA_TYPES_INVALID_ARG if source is not a valid string for a value of type type.] */
                     result = AGENT_DATA_TYPES_INVALID_ARG;
@@ -3665,7 +3560,8 @@ AGENT_DATA_TYPES_RESULT CreateAgentDataType_From_String(const char* source, AGEN
 #endif
 result = AGENT_DATA_TYPES_OK;
                 }
-                else if (sscanff(source, &agentData->value.edmSingle.value) != 1)
+                else if ((fastParseFloat(source, &agentData->value.edmSingle.value) != 0) &&
+                    (sscanff(source, &agentData->value.edmSingle.value) != 1))
                 {
                     /* Codes_SRS_AGENT_TYPE_SYSTEM_99_087:[ CreateAgentDataType_From_String shall return AGENT_DATA_TYPES_INVALID_ARG if source is not a valid string for a value of type type.] */
                     result = AGENT_DATA_TYPES_INVALID_ARG;
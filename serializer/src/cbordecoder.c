@@ -0,0 +1,547 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include "cbordecoder.h"
+#include "azure_c_shared_utility/crt_abstractions.h"
+#include "azure_c_shared_utility/base64.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+DEFINE_ENUM_STRINGS(CBOR_DECODER_RESULT, CBOR_DECODER_RESULT_VALUES);
+
+#define CBOR_MAJOR_UNSIGNED_INTEGER 0
+#define CBOR_MAJOR_NEGATIVE_INTEGER 1
+#define CBOR_MAJOR_BYTE_STRING      2
+#define CBOR_MAJOR_TEXT_STRING      3
+#define CBOR_MAJOR_ARRAY            4
+#define CBOR_MAJOR_MAP              5
+#define CBOR_MAJOR_TAG              6
+#define CBOR_MAJOR_SIMPLE           7
+
+#define CBOR_INFO_FALSE      20
+#define CBOR_INFO_TRUE       21
+#define CBOR_INFO_NULL       22
+#define CBOR_INFO_FLOAT16    25
+#define CBOR_INFO_FLOAT32    26
+#define CBOR_INFO_FLOAT64    27
+#define CBOR_INFO_INDEFINITE 31
+
+#define CBOR_BREAK 0xFF
+
+/*size of the chunks in which escaped text is appended to the JSON*/
+#define CBOR_DECODER_TEXT_CHUNK 64
+
+typedef struct CBOR_READER_TAG
+{
+    const unsigned char* source;
+    size_t size;
+    size_t position;
+} CBOR_READER;
+
+static CBOR_DECODER_RESULT DecodeItem(CBOR_READER* reader, STRING_HANDLE destination, size_t depth);
+
+static CBOR_DECODER_RESULT Concat(STRING_HANDLE destination, const char* text)
+{
+    CBOR_DECODER_RESULT result;
+
+    if (STRING_concat(destination, text) != 0)
+    {
+        LogError("failure in STRING_concat");
+        result = CBOR_DECODER_ERROR;
+    }
+    else
+    {
+        result = CBOR_DECODER_OK;
+    }
+
+    return result;
+}
+
+static CBOR_DECODER_RESULT ReadHeader(CBOR_READER* reader, unsigned char* major, unsigned char* info, uint64_t* argument)
+{
+    CBOR_DECODER_RESULT result;
+
+    if (reader->position >= reader->size)
+    {
+        LogError("the CBOR ends in the middle of an item");
+        result = CBOR_DECODER_SYNTAX_ERROR;
+    }
+    else
+    {
+        unsigned char initialByte = reader->source[reader->position++];
+        *major = (unsigned char)(initialByte >> 5);
+        *info = (unsigned char)(initialByte & 0x1F);
+
+        if (*info < 24)
+        {
+            *argument = *info;
+            result = CBOR_DECODER_OK;
+        }
+        else if (*info <= CBOR_INFO_FLOAT64)
+        {
+            size_t nArgumentBytes = (size_t)1 << (*info - 24);
+
+            if (reader->size - reader->position < nArgumentBytes)
+            {
+                LogError("the CBOR ends in the middle of an item header");
+                result = CBOR_DECODER_SYNTAX_ERROR;
+            }
+            else
+            {
+                size_t i;
+                *argument = 0;
+                for (i = 0; i < nArgumentBytes; i++)
+                {
+                    *argument = (*argument << 8) | reader->source[reader->position++];
+                }
+                result = CBOR_DECODER_OK;
+            }
+        }
+        else if (*info == CBOR_INFO_INDEFINITE)
+        {
+            *argument = 0;
+            result = CBOR_DECODER_OK;
+        }
+        else
+        {
+            LogError("reserved additional information %u", (unsigned int)*info);
+            result = CBOR_DECODER_SYNTAX_ERROR;
+        }
+    }
+
+    return result;
+}
+
+static CBOR_DECODER_RESULT WriteInteger(STRING_HANDLE destination, bool negative, uint64_t magnitude)
+{
+    char temp[22]; /*a 64 bit magnitude, its sign and the terminator*/
+    char digits[20];
+    size_t nDigits = 0;
+    size_t length = 0;
+
+    do
+    {
+        digits[nDigits++] = (char)('0' + (magnitude % 10));
+        magnitude /= 10;
+    } while (magnitude != 0);
+
+    if (negative)
+    {
+        temp[length++] = '-';
+    }
+
+    while (nDigits > 0)
+    {
+        temp[length++] = digits[--nDigits];
+    }
+    temp[length] = '\0';
+
+    return Concat(destination, temp);
+}
+
+#ifndef NO_FLOATS
+static CBOR_DECODER_RESULT WriteFloatingPoint(STRING_HANDLE destination, double value)
+{
+    CBOR_DECODER_RESULT result;
+
+    if (!((value >= -DBL_MAX) && (value <= DBL_MAX))) /*false for NaN too*/
+    {
+        /*Codes_SRS_CBOR_DECODER_41_010: [ If a value cannot be represented in JSON (NaN, infinities, the integer -2^64, simple values other than false, true and null) CBORDecoder_ToJSON shall return CBOR_DECODER_UNSUPPORTED. ]*/
+        LogError("NaN and infinities have no JSON representation");
+        result = CBOR_DECODER_UNSUPPORTED;
+    }
+    else
+    {
+        char temp[32];
+
+        /*the shortest of the two precisions that reads back as the same value*/
+        if ((sprintf_s(temp, sizeof(temp), "%.15g", value) < 0) ||
+            ((strtod(temp, NULL) != value) && (sprintf_s(temp, sizeof(temp), "%.17g", value) < 0)))
+        {
+            LogError("unable to format a floating point value");
+            result = CBOR_DECODER_ERROR;
+        }
+        else
+        {
+            result = Concat(destination, temp);
+        }
+    }
+
+    return result;
+}
+
+static double HalfToDouble(uint64_t bits)
+{
+    double result;
+    int exponent = (int)((bits >> 10) & 0x1F);
+    double mantissa = (double)(bits & 0x3FF);
+
+    if (exponent == 0)
+    {
+        result = ldexp(mantissa, -24);
+    }
+    else if (exponent == 31)
+    {
+        result = (mantissa == 0) ? HUGE_VAL : NAN;
+    }
+    else
+    {
+        result = ldexp(mantissa + 1024, exponent - 25);
+    }
+
+    return ((bits & 0x8000) != 0) ? -result : result;
+}
+#endif
+
+static CBOR_DECODER_RESULT WriteText(STRING_HANDLE destination, const unsigned char* text, size_t length)
+{
+    CBOR_DECODER_RESULT result = Concat(destination, "\"");
+    char chunk[CBOR_DECODER_TEXT_CHUNK + 8];
+    size_t chunkLength = 0;
+    size_t i;
+
+    /*Codes_SRS_CBOR_DECODER_41_005: [ A text string shall be written as a JSON string, escaping quotation marks, reverse solidi and control characters. ]*/
+    for (i = 0; (result == CBOR_DECODER_OK) && (i < length); i++)
+    {
+        unsigned char c = text[i];
+
+        if ((c == '"') || (c == '\\'))
+        {
+            chunk[chunkLength++] = '\\';
+            chunk[chunkLength++] = (char)c;
+        }
+        else if (c < 0x20)
+        {
+            static const char hexDigits[] = "0123456789abcdef";
+            chunk[chunkLength++] = '\\';
+            chunk[chunkLength++] = 'u';
+            chunk[chunkLength++] = '0';
+            chunk[chunkLength++] = '0';
+            chunk[chunkLength++] = hexDigits[c >> 4];
+            chunk[chunkLength++] = hexDigits[c & 0x0F];
+        }
+        else
+        {
+            chunk[chunkLength++] = (char)c;
+        }
+
+        if (chunkLength >= CBOR_DECODER_TEXT_CHUNK)
+        {
+            chunk[chunkLength] = '\0';
+            result = Concat(destination, chunk);
+            chunkLength = 0;
+        }
+    }
+
+    if (result == CBOR_DECODER_OK)
+    {
+        chunk[chunkLength++] = '"';
+        chunk[chunkLength] = '\0';
+        result = Concat(destination, chunk);
+    }
+
+    return result;
+}
+
+static CBOR_DECODER_RESULT WriteBytes(STRING_HANDLE destination, const unsigned char* bytes, size_t length)
+{
+    CBOR_DECODER_RESULT result;
+
+    /*Codes_SRS_CBOR_DECODER_41_006: [ A byte string shall be written as a JSON string holding its base64 encoding. ]*/
+    if (length == 0)
+    {
+        result = Concat(destination, "\"\"");
+    }
+    else
+    {
+        STRING_HANDLE base64 = Base64_Encode_Bytes(bytes, length);
+        if (base64 == NULL)
+        {
+            LogError("failure in Base64_Encode_Bytes");
+            result = CBOR_DECODER_ERROR;
+        }
+        else
+        {
+            if ((Concat(destination, "\"") != CBOR_DECODER_OK) ||
+                (STRING_concat_with_STRING(destination, base64) != 0) ||
+                (Concat(destination, "\"") != CBOR_DECODER_OK))
+            {
+                LogError("unable to append the base64 encoding of a byte string");
+                result = CBOR_DECODER_ERROR;
+            }
+            else
+            {
+                result = CBOR_DECODER_OK;
+            }
+            STRING_delete(base64);
+        }
+    }
+
+    return result;
+}
+
+static CBOR_DECODER_RESULT DecodeContainer(CBOR_READER* reader, STRING_HANDLE destination, size_t depth, bool isMap, bool indefinite, uint64_t count)
+{
+    CBOR_DECODER_RESULT result = Concat(destination, isMap ? "{" : "[");
+    uint64_t i = 0;
+
+    /*Codes_SRS_CBOR_DECODER_41_007: [ Arrays and maps, of definite or indefinite length, shall be written as JSON arrays and objects. ]*/
+    while (result == CBOR_DECODER_OK)
+    {
+        if (indefinite)
+        {
+            if (reader->position >= reader->size)
+            {
+                LogError("the CBOR ends before the break of an indefinite length container");
+                result = CBOR_DECODER_SYNTAX_ERROR;
+                break;
+            }
+            else if (reader->source[reader->position] == CBOR_BREAK)
+            {
+                reader->position++;
+                break;
+            }
+        }
+        else if (i == count)
+        {
+            break;
+        }
+
+        if ((i > 0) &&
+            ((result = Concat(destination, ",")) != CBOR_DECODER_OK))
+        {
+            break;
+        }
+
+        if (isMap)
+        {
+            if ((reader->position < reader->size) &&
+                ((reader->source[reader->position] >> 5) != CBOR_MAJOR_TEXT_STRING))
+            {
+                /*Codes_SRS_CBOR_DECODER_41_008: [ If a map key is not a text string, CBORDecoder_ToJSON shall return CBOR_DECODER_UNSUPPORTED. ]*/
+                LogError("only text string map keys have a JSON representation");
+                result = CBOR_DECODER_UNSUPPORTED;
+            }
+            else if (((result = DecodeItem(reader, destination, depth + 1)) == CBOR_DECODER_OK) &&
+                ((result = Concat(destination, ":")) == CBOR_DECODER_OK))
+            {
+                result = DecodeItem(reader, destination, depth + 1);
+            }
+        }
+        else
+        {
+            result = DecodeItem(reader, destination, depth + 1);
+        }
+
+        i++;
+    }
+
+    if (result == CBOR_DECODER_OK)
+    {
+        result = Concat(destination, isMap ? "}" : "]");
+    }
+
+    return result;
+}
+
+static CBOR_DECODER_RESULT DecodeSimple(STRING_HANDLE destination, unsigned char info, uint64_t argument)
+{
+    CBOR_DECODER_RESULT result;
+
+    switch (info)
+    {
+        case CBOR_INFO_FALSE:
+        {
+            result = Concat(destination, "false");
+            break;
+        }
+        case CBOR_INFO_TRUE:
+        {
+            result = Concat(destination, "true");
+            break;
+        }
+        case CBOR_INFO_NULL:
+        {
+            result = Concat(destination, "null");
+            break;
+        }
+#ifndef NO_FLOATS
+        case CBOR_INFO_FLOAT16:
+        {
+            result = WriteFloatingPoint(destination, HalfToDouble(argument));
+            break;
+        }
+        case CBOR_INFO_FLOAT32:
+        {
+            uint32_t bits = (uint32_t)argument;
+            float value;
+            (void)memcpy(&value, &bits, sizeof(value));
+            result = WriteFloatingPoint(destination, (double)value);
+            break;
+        }
+        case CBOR_INFO_FLOAT64:
+        {
+            double value;
+            (void)memcpy(&value, &argument, sizeof(value));
+            result = WriteFloatingPoint(destination, value);
+            break;
+        }
+#endif
+        case CBOR_INFO_INDEFINITE:
+        {
+            LogError("break outside of an indefinite length container");
+            result = CBOR_DECODER_SYNTAX_ERROR;
+            break;
+        }
+        default:
+        {
+            /*Codes_SRS_CBOR_DECODER_41_010: [ If a value cannot be represented in JSON (NaN, infinities, the integer -2^64, simple values other than false, true and null) CBORDecoder_ToJSON shall return CBOR_DECODER_UNSUPPORTED. ]*/
+            LogError("simple value %u has no JSON representation", (unsigned int)info);
+            result = CBOR_DECODER_UNSUPPORTED;
+            break;
+        }
+    }
+
+    return result;
+}
+
+static CBOR_DECODER_RESULT DecodeItem(CBOR_READER* reader, STRING_HANDLE destination, size_t depth)
+{
+    CBOR_DECODER_RESULT result;
+    unsigned char major;
+    unsigned char info;
+    uint64_t argument;
+
+    if (depth > CBOR_DECODER_MAX_DEPTH)
+    {
+        /*Codes_SRS_CBOR_DECODER_41_011: [ If items are nested deeper than CBOR_DECODER_MAX_DEPTH, CBORDecoder_ToJSON shall return CBOR_DECODER_UNSUPPORTED. ]*/
+        LogError("the CBOR is nested deeper than %d", CBOR_DECODER_MAX_DEPTH);
+        result = CBOR_DECODER_UNSUPPORTED;
+    }
+    else if ((result = ReadHeader(reader, &major, &info, &argument)) != CBOR_DECODER_OK)
+    {
+        /*Codes_SRS_CBOR_DECODER_41_009: [ If source is not well formed CBOR, CBORDecoder_ToJSON shall return CBOR_DECODER_SYNTAX_ERROR. ]*/
+        LogError("unable to read an item header");
+    }
+    else if ((info == CBOR_INFO_INDEFINITE) &&
+        ((major == CBOR_MAJOR_UNSIGNED_INTEGER) || (major == CBOR_MAJOR_NEGATIVE_INTEGER) || (major == CBOR_MAJOR_TAG)))
+    {
+        /*Codes_SRS_CBOR_DECODER_41_009: [ If source is not well formed CBOR, CBORDecoder_ToJSON shall return CBOR_DECODER_SYNTAX_ERROR. ]*/
+        LogError("major type %u cannot have an indefinite length", (unsigned int)major);
+        result = CBOR_DECODER_SYNTAX_ERROR;
+    }
+    else
+    {
+        switch (major)
+        {
+            case CBOR_MAJOR_UNSIGNED_INTEGER:
+            {
+                /*Codes_SRS_CBOR_DECODER_41_004: [ Integers, false, true, null and floating point numbers shall be written as the JSON literals with the same value. ]*/
+                result = WriteInteger(destination, false, argument);
+                break;
+            }
+            case CBOR_MAJOR_NEGATIVE_INTEGER:
+            {
+                if (argument == UINT64_MAX)
+                {
+                    /*Codes_SRS_CBOR_DECODER_41_010: [ If a value cannot be represented in JSON (NaN, infinities, the integer -2^64, simple values other than false, true and null) CBORDecoder_ToJSON shall return CBOR_DECODER_UNSUPPORTED. ]*/
+                    LogError("-2^64 has no JSON representation");
+                    result = CBOR_DECODER_UNSUPPORTED;
+                }
+                else
+                {
+                    result = WriteInteger(destination, true, argument + 1);
+                }
+                break;
+            }
+            case CBOR_MAJOR_BYTE_STRING:
+            case CBOR_MAJOR_TEXT_STRING:
+            {
+                if (info == CBOR_INFO_INDEFINITE)
+                {
+                    /*Codes_SRS_CBOR_DECODER_41_012: [ If a string has an indefinite length, CBORDecoder_ToJSON shall return CBOR_DECODER_UNSUPPORTED. ]*/
+                    LogError("indefinite length strings are not supported");
+                    result = CBOR_DECODER_UNSUPPORTED;
+                }
+                else if (argument > reader->size - reader->position)
+                {
+                    /*Codes_SRS_CBOR_DECODER_41_009: [ If source is not well formed CBOR, CBORDecoder_ToJSON shall return CBOR_DECODER_SYNTAX_ERROR. ]*/
+                    LogError("the CBOR ends in the middle of a string");
+                    result = CBOR_DECODER_SYNTAX_ERROR;
+                }
+                else
+                {
+                    const unsigned char* bytes = reader->source + reader->position;
+                    reader->position += (size_t)argument;
+                    result = (major == CBOR_MAJOR_TEXT_STRING) ?
+                        WriteText(destination, bytes, (size_t)argument) :
+                        WriteBytes(destination, bytes, (size_t)argument);
+                }
+                break;
+            }
+            case CBOR_MAJOR_ARRAY:
+            case CBOR_MAJOR_MAP:
+            {
+                result = DecodeContainer(reader, destination, depth, (major == CBOR_MAJOR_MAP), (info == CBOR_INFO_INDEFINITE), argument);
+                break;
+            }
+            case CBOR_MAJOR_TAG:
+            {
+                /*Codes_SRS_CBOR_DECODER_41_013: [ Tags shall be skipped and the tagged item written as if it was not tagged. ]*/
+                result = DecodeItem(reader, destination, depth + 1);
+                break;
+            }
+            default:
+            {
+                result = DecodeSimple(destination, info, argument);
+                break;
+            }
+        }
+    }
+
+    return result;
+}
+
+CBOR_DECODER_RESULT CBORDecoder_ToJSON(const unsigned char* source, size_t sourceSize, STRING_HANDLE destination)
+{
+    CBOR_DECODER_RESULT result;
+
+    /*Codes_SRS_CBOR_DECODER_41_001: [ If source or destination is NULL, or sourceSize is 0, CBORDecoder_ToJSON shall return CBOR_DECODER_INVALID_ARG. ]*/
+    if ((source == NULL) ||
+        (sourceSize == 0) ||
+        (destination == NULL))
+    {
+        LogError("invalid argument const unsigned char* source=%p, size_t sourceSize=%lu, STRING_HANDLE destination=%p", source, (unsigned long)sourceSize, destination);
+        result = CBOR_DECODER_INVALID_ARG;
+    }
+    else
+    {
+        CBOR_READER reader;
+        reader.source = source;
+        reader.size = sourceSize;
+        reader.position = 0;
+
+        /*Codes_SRS_CBOR_DECODER_41_002: [ CBORDecoder_ToJSON shall append to destination the JSON text of the single CBOR item in source. ]*/
+        if ((result = DecodeItem(&reader, destination, 0)) != CBOR_DECODER_OK)
+        {
+            LogError("unable to convert the CBOR to JSON, result = %s", ENUM_TO_STRING(CBOR_DECODER_RESULT, result));
+        }
+        else if (reader.position != reader.size)
+        {
+            /*Codes_SRS_CBOR_DECODER_41_003: [ If source has bytes after the first item, CBORDecoder_ToJSON shall return CBOR_DECODER_SYNTAX_ERROR. ]*/
+            LogError("%lu bytes follow the CBOR item", (unsigned long)(reader.size - reader.position));
+            result = CBOR_DECODER_SYNTAX_ERROR;
+        }
+        else
+        {
+            result = CBOR_DECODER_OK;
+        }
+    }
+
+    return result;
+}
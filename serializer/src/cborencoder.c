@@ -0,0 +1,249 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <string.h>
+#include <float.h>
+#include "cborencoder.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+DEFINE_ENUM_STRINGS(CBOR_ENCODER_RESULT, CBOR_ENCODER_RESULT_VALUES);
+
+#define CBOR_MAJOR_UNSIGNED_INTEGER 0
+#define CBOR_MAJOR_NEGATIVE_INTEGER 1
+#define CBOR_MAJOR_BYTE_STRING      2
+#define CBOR_MAJOR_TEXT_STRING      3
+#define CBOR_MAJOR_ARRAY            4
+#define CBOR_MAJOR_MAP              5
+
+#define CBOR_FALSE   0xF4
+#define CBOR_TRUE    0xF5
+#define CBOR_FLOAT32 0xFA
+#define CBOR_FLOAT64 0xFB
+
+/*writes the shortest header for argument, returns the number of bytes used (at most CBOR_ENCODER_MAX_HEADER_SIZE)*/
+static size_t EncodeHeader(unsigned char* header, unsigned char major, uint64_t argument)
+{
+    size_t result;
+    size_t nArgumentBytes;
+    size_t i;
+
+    if (argument < 24)
+    {
+        header[0] = (unsigned char)((major << 5) | (unsigned char)argument);
+        nArgumentBytes = 0;
+    }
+    else if (argument <= 0xFF)
+    {
+        header[0] = (unsigned char)((major << 5) | 24);
+        nArgumentBytes = 1;
+    }
+    else if (argument <= 0xFFFF)
+    {
+        header[0] = (unsigned char)((major << 5) | 25);
+        nArgumentBytes = 2;
+    }
+    else if (argument <= 0xFFFFFFFF)
+    {
+        header[0] = (unsigned char)((major << 5) | 26);
+        nArgumentBytes = 4;
+    }
+    else
+    {
+        header[0] = (unsigned char)((major << 5) | 27);
+        nArgumentBytes = 8;
+    }
+
+    /*arguments are big endian*/
+    for (i = 0; i < nArgumentBytes; i++)
+    {
+        header[nArgumentBytes - i] = (unsigned char)(argument >> (8 * i));
+    }
+
+    result = nArgumentBytes + 1;
+    return result;
+}
+
+static CBOR_ENCODER_RESULT WriteItem(unsigned char* destination, size_t destinationCapacity, size_t* size, const unsigned char* header, size_t headerLength, const unsigned char* payload, size_t payloadLength)
+{
+    CBOR_ENCODER_RESULT result;
+
+    if ((destinationCapacity < *size) ||
+        (destinationCapacity - *size < headerLength) ||
+        (destinationCapacity - *size - headerLength < payloadLength))
+    {
+        result = CBOR_ENCODER_BUFFER_TOO_SMALL;
+    }
+    else
+    {
+        (void)memcpy(destination + *size, header, headerLength);
+        if (payloadLength > 0)
+        {
+            (void)memcpy(destination + *size + headerLength, payload, payloadLength);
+        }
+        *size += headerLength + payloadLength;
+        result = CBOR_ENCODER_OK;
+    }
+
+    return result;
+}
+
+static CBOR_ENCODER_RESULT WriteHeaderAndPayload(unsigned char* destination, size_t destinationCapacity, size_t* size, unsigned char major, uint64_t argument, const unsigned char* payload, size_t payloadLength)
+{
+    CBOR_ENCODER_RESULT result;
+
+    /*Codes_SRS_CBOR_ENCODER_41_001: [ If destination or size is NULL, CBOREncoder_Write* shall return CBOR_ENCODER_INVALID_ARG. ]*/
+    if ((destination == NULL) || (size == NULL))
+    {
+        result = CBOR_ENCODER_INVALID_ARG;
+        LogError("invalid argument unsigned char* destination=%p, size_t* size=%p", destination, size);
+    }
+    else
+    {
+        unsigned char header[CBOR_ENCODER_MAX_HEADER_SIZE];
+        size_t headerLength = EncodeHeader(header, major, argument);
+
+        /*Codes_SRS_CBOR_ENCODER_41_002: [ If the item does not fit between destination + *size and destination + destinationCapacity, CBOREncoder_Write* shall write nothing and return CBOR_ENCODER_BUFFER_TOO_SMALL. ]*/
+        /*Codes_SRS_CBOR_ENCODER_41_003: [ Otherwise CBOREncoder_Write* shall append the item, add its size to *size and return CBOR_ENCODER_OK. ]*/
+        result = WriteItem(destination, destinationCapacity, size, header, headerLength, payload, payloadLength);
+    }
+
+    return result;
+}
+
+CBOR_ENCODER_RESULT CBOREncoder_WriteMapHeader(unsigned char* destination, size_t destinationCapacity, size_t* size, size_t pairCount)
+{
+    /*Codes_SRS_CBOR_ENCODER_41_004: [ CBOREncoder_WriteMapHeader shall write the shortest header of a map of pairCount pairs. ]*/
+    return WriteHeaderAndPayload(destination, destinationCapacity, size, CBOR_MAJOR_MAP, pairCount, NULL, 0);
+}
+
+CBOR_ENCODER_RESULT CBOREncoder_WriteArrayHeader(unsigned char* destination, size_t destinationCapacity, size_t* size, size_t itemCount)
+{
+    /*Codes_SRS_CBOR_ENCODER_41_014: [ CBOREncoder_WriteArrayHeader shall write the shortest header of an array of itemCount items. ]*/
+    return WriteHeaderAndPayload(destination, destinationCapacity, size, CBOR_MAJOR_ARRAY, itemCount, NULL, 0);
+}
+
+CBOR_ENCODER_RESULT CBOREncoder_WriteTextString(unsigned char* destination, size_t destinationCapacity, size_t* size, const char* text, size_t length)
+{
+    CBOR_ENCODER_RESULT result;
+
+    if ((text == NULL) && (length > 0))
+    {
+        /*Codes_SRS_CBOR_ENCODER_41_005: [ If text is NULL and length is not 0, CBOREncoder_WriteTextString shall return CBOR_ENCODER_INVALID_ARG. ]*/
+        result = CBOR_ENCODER_INVALID_ARG;
+        LogError("invalid argument const char* text=%p, size_t length=%lu", text, (unsigned long)length);
+    }
+    else
+    {
+        /*Codes_SRS_CBOR_ENCODER_41_006: [ CBOREncoder_WriteTextString shall write a text string header for length bytes followed by the bytes of text. ]*/
+        result = WriteHeaderAndPayload(destination, destinationCapacity, size, CBOR_MAJOR_TEXT_STRING, length, (const unsigned char*)text, length);
+    }
+
+    return result;
+}
+
+CBOR_ENCODER_RESULT CBOREncoder_WriteByteString(unsigned char* destination, size_t destinationCapacity, size_t* size, const unsigned char* bytes, size_t length)
+{
+    CBOR_ENCODER_RESULT result;
+
+    if ((bytes == NULL) && (length > 0))
+    {
+        /*Codes_SRS_CBOR_ENCODER_41_007: [ If bytes is NULL and length is not 0, CBOREncoder_WriteByteString shall return CBOR_ENCODER_INVALID_ARG. ]*/
+        result = CBOR_ENCODER_INVALID_ARG;
+        LogError("invalid argument const unsigned char* bytes=%p, size_t length=%lu", bytes, (unsigned long)length);
+    }
+    else
+    {
+        /*Codes_SRS_CBOR_ENCODER_41_008: [ CBOREncoder_WriteByteString shall write a byte string header for length bytes followed by bytes. ]*/
+        result = WriteHeaderAndPayload(destination, destinationCapacity, size, CBOR_MAJOR_BYTE_STRING, length, bytes, length);
+    }
+
+    return result;
+}
+
+CBOR_ENCODER_RESULT CBOREncoder_WriteInt64(unsigned char* destination, size_t destinationCapacity, size_t* size, int64_t value)
+{
+    CBOR_ENCODER_RESULT result;
+
+    if (value >= 0)
+    {
+        /*Codes_SRS_CBOR_ENCODER_41_009: [ If value is not negative, CBOREncoder_WriteInt64 shall write it as an unsigned integer with the shortest argument. ]*/
+        result = WriteHeaderAndPayload(destination, destinationCapacity, size, CBOR_MAJOR_UNSIGNED_INTEGER, (uint64_t)value, NULL, 0);
+    }
+    else
+    {
+        /*Codes_SRS_CBOR_ENCODER_41_010: [ If value is negative, CBOREncoder_WriteInt64 shall write it as a negative integer of argument -1 - value with the shortest argument. ]*/
+        result = WriteHeaderAndPayload(destination, destinationCapacity, size, CBOR_MAJOR_NEGATIVE_INTEGER, (uint64_t)(-1 - value), NULL, 0);
+    }
+
+    return result;
+}
+
+CBOR_ENCODER_RESULT CBOREncoder_WriteBoolean(unsigned char* destination, size_t destinationCapacity, size_t* size, bool value)
+{
+    CBOR_ENCODER_RESULT result;
+
+    if ((destination == NULL) || (size == NULL))
+    {
+        /*Codes_SRS_CBOR_ENCODER_41_001: [ If destination or size is NULL, CBOREncoder_Write* shall return CBOR_ENCODER_INVALID_ARG. ]*/
+        result = CBOR_ENCODER_INVALID_ARG;
+        LogError("invalid argument unsigned char* destination=%p, size_t* size=%p", destination, size);
+    }
+    else
+    {
+        /*Codes_SRS_CBOR_ENCODER_41_011: [ CBOREncoder_WriteBoolean shall write the simple value true (0xF5) or false (0xF4). ]*/
+        unsigned char item = value ? CBOR_TRUE : CBOR_FALSE;
+        result = WriteItem(destination, destinationCapacity, size, &item, 1, NULL, 0);
+    }
+
+    return result;
+}
+
+#ifndef NO_FLOATS
+CBOR_ENCODER_RESULT CBOREncoder_WriteDouble(unsigned char* destination, size_t destinationCapacity, size_t* size, double value)
+{
+    CBOR_ENCODER_RESULT result;
+
+    if ((destination == NULL) || (size == NULL))
+    {
+        /*Codes_SRS_CBOR_ENCODER_41_001: [ If destination or size is NULL, CBOREncoder_Write* shall return CBOR_ENCODER_INVALID_ARG. ]*/
+        result = CBOR_ENCODER_INVALID_ARG;
+        LogError("invalid argument unsigned char* destination=%p, size_t* size=%p", destination, size);
+    }
+    else
+    {
+        unsigned char item[9];
+        size_t itemLength;
+        size_t i;
+
+        if ((value >= -FLT_MAX) && (value <= FLT_MAX) && ((double)(float)value == value))
+        {
+            /*Codes_SRS_CBOR_ENCODER_41_012: [ If value can be represented exactly as a float, CBOREncoder_WriteDouble shall write it as a single precision float (0xFA). ]*/
+            float single = (float)value;
+            uint32_t bits;
+            (void)memcpy(&bits, &single, sizeof(bits));
+            item[0] = CBOR_FLOAT32;
+            for (i = 0; i < 4; i++)
+            {
+                item[4 - i] = (unsigned char)(bits >> (8 * i));
+            }
+            itemLength = 5;
+        }
+        else
+        {
+            /*Codes_SRS_CBOR_ENCODER_41_013: [ Otherwise CBOREncoder_WriteDouble shall write value as a double precision float (0xFB). ]*/
+            uint64_t bits;
+            (void)memcpy(&bits, &value, sizeof(bits));
+            item[0] = CBOR_FLOAT64;
+            for (i = 0; i < 8; i++)
+            {
+                item[8 - i] = (unsigned char)(bits >> (8 * i));
+            }
+            itemLength = 9;
+        }
+
+        result = WriteItem(destination, destinationCapacity, size, item, itemLength, NULL, 0);
+    }
+
+    return result;
+}
+#endif
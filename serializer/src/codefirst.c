@@ -3,15 +3,21 @@
 
 #include <stdlib.h>
 #include <stdarg.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
 #include "azure_c_shared_utility/gballoc.h"
 
 #include "codefirst.h"
 #include "azure_c_shared_utility/macro_utils.h"
 #include "azure_c_shared_utility/crt_abstractions.h"
 #include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/lock.h"
 #include <stddef.h>
 #include "azure_c_shared_utility/crt_abstractions.h"
 #include "iotdevice.h"
+#include "cborencoder.h"
+#include "cbordecoder.h"
 
 DEFINE_ENUM_STRINGS(CODEFIRST_RESULT, CODEFIRST_RESULT_VALUES)
 DEFINE_ENUM_STRINGS(EXECUTE_COMMAND_RESULT, EXECUTE_COMMAND_RESULT_VALUES)
@@ -26,8 +32,16 @@ typedef struct DEVICE_HEADER_DATA_TAG
     SCHEMA_MODEL_TYPE_HANDLE ModelHandle;
     size_t DataSize;
     unsigned char* data;
+    struct SEND_PLAN_TAG* SendPlan; /*built by the first CodeFirst_SendAsyncToBuffer*/
+    unsigned char* ReportedShadow; /*values of the reported properties last published by CodeFirst_SendAsyncReportedChanges*/
+    double ReportedDeadband; /*numeric reported properties within it of their value in ReportedShadow are not published, see CodeFirst_SetReportedChangesDeadband*/
+    struct PROPERTY_OFFSET_INDEX_TAG* PropertyIndex; /*built by the first CodeFirst_SendAsync of a single property*/
+    struct PROPERTY_OFFSET_INDEX_TAG* ReportedPropertyIndex; /*built by the first CodeFirst_SendAsyncReported of a single reported property*/
 } DEVICE_HEADER_DATA;
 
+static void DestroySendPlan(struct SEND_PLAN_TAG* plan);
+static void DestroyPropertyOffsetIndex(struct PROPERTY_OFFSET_INDEX_TAG* index);
+
 #define COUNT_OF(A) (sizeof(A) / sizeof((A)[0]))
 
 /*design considerations for lazy init of CodeFirst:
@@ -81,6 +95,9 @@ static CODEFIRST_STATE g_state = CODEFIRST_STATE_NOT_INIT;
 static const char* g_OverrideSchemaNamespace;
 static size_t g_DeviceCount = 0;
 static DEVICE_HEADER_DATA** g_Devices = NULL;
+/*only guards g_Devices and g_DeviceCount. It is held while a device is added, removed or looked up, never while a device is serialized,
+so different devices can be serialized from different threads. It exists while CodeFirst is initialized.*/
+static LOCK_HANDLE g_DevicesLock = NULL;
 
 static void deinitializeDesiredProperties(SCHEMA_MODEL_TYPE_HANDLE model, void* destination)
 {
@@ -159,15 +176,24 @@ static void DestroyDevice(DEVICE_HEADER_DATA* deviceHeader)
     /* Codes_SRS_CODEFIRST_99_087:[In order to release the device handle, CodeFirst_DestroyDevice shall call Device_Destroy.] */
 
     Device_Destroy(deviceHeader->DeviceHandle);
+    DestroySendPlan(deviceHeader->SendPlan);
+    DestroyPropertyOffsetIndex(deviceHeader->PropertyIndex);
+    DestroyPropertyOffsetIndex(deviceHeader->ReportedPropertyIndex);
+    free(deviceHeader->ReportedShadow);
     free(deviceHeader->data);
     free(deviceHeader);
 }
 
+/*serializer.h emits every model and struct right before its own elements and links each entry to the one emitted before it.
+In the reflected list the elements of a model or struct are therefore the entries between the previous model or struct and the model or struct itself.*/
+#define IS_ELEMENT_RUN_END(something) (((something)->type == REFLECTION_MODEL_TYPE) || ((something)->type == REFLECTION_STRUCT_TYPE))
+
 static CODEFIRST_RESULT buildStructTypes(SCHEMA_HANDLE schemaHandle, const REFLECTED_DATA_FROM_DATAPROVIDER* reflectedData)
 {
     CODEFIRST_RESULT result = CODEFIRST_OK;
 
     const REFLECTED_SOMETHING* something;
+    const REFLECTED_SOMETHING* firstElement = reflectedData->reflectedData;
     for (something = reflectedData->reflectedData; something != NULL; something = something->next)
     {
         if (something->type == REFLECTION_STRUCT_TYPE)
@@ -186,7 +212,7 @@ static CODEFIRST_RESULT buildStructTypes(SCHEMA_HANDLE schemaHandle, const REFLE
             {
                 const REFLECTED_SOMETHING* maybeField;
                 /*look for the field... */
-                for (maybeField = reflectedData->reflectedData; maybeField != NULL; maybeField = maybeField->next)
+                for (maybeField = firstElement; maybeField != something; maybeField = maybeField->next)
                 {
                     if (maybeField->type == REFLECTION_FIELD_TYPE)
                     {
@@ -204,12 +230,17 @@ static CODEFIRST_RESULT buildStructTypes(SCHEMA_HANDLE schemaHandle, const REFLE
                 }
             }
         }
+
+        if (IS_ELEMENT_RUN_END(something))
+        {
+            firstElement = something->next;
+        }
     }
 
     return result;
 }
 
-static CODEFIRST_RESULT buildModel(SCHEMA_HANDLE schemaHandle, const REFLECTED_DATA_FROM_DATAPROVIDER* reflectedData, const REFLECTED_SOMETHING* modelReflectedData)
+static CODEFIRST_RESULT buildModel(SCHEMA_HANDLE schemaHandle, const REFLECTED_SOMETHING* firstElement, const REFLECTED_SOMETHING* modelReflectedData)
 {
     CODEFIRST_RESULT result = CODEFIRST_OK;
     const REFLECTED_SOMETHING* something;
@@ -224,7 +255,7 @@ static CODEFIRST_RESULT buildModel(SCHEMA_HANDLE schemaHandle, const REFLECTED_D
         goto out;
     }
 
-    for (something = reflectedData->reflectedData; something != NULL; something = something->next)
+    for (something = firstElement; something != modelReflectedData; something = something->next)
     {
         /* looking for all elements that belong to a model: properties and actions */
         if ((something->type == REFLECTION_PROPERTY_TYPE) &&
@@ -379,6 +410,7 @@ static CODEFIRST_RESULT buildModelTypes(SCHEMA_HANDLE schemaHandle, const REFLEC
 {
     CODEFIRST_RESULT result = CODEFIRST_OK;
     const REFLECTED_SOMETHING* something;
+    const REFLECTED_SOMETHING* firstElement;
 
     /* first have a pass and add all the model types */
     for (something = reflectedData->reflectedData; something != NULL; something = something->next)
@@ -395,16 +427,22 @@ static CODEFIRST_RESULT buildModelTypes(SCHEMA_HANDLE schemaHandle, const REFLEC
         }
     }
 
+    firstElement = reflectedData->reflectedData;
     for (something = reflectedData->reflectedData; something != NULL; something = something->next)
     {
         if (something->type == REFLECTION_MODEL_TYPE)
         {
-            result = buildModel(schemaHandle, reflectedData, something);
+            result = buildModel(schemaHandle, firstElement, something);
             if (result != CODEFIRST_OK)
             {
                 break;
             }
         }
+
+        if (IS_ELEMENT_RUN_END(something))
+        {
+            firstElement = something->next;
+        }
     }
 
 out:
@@ -425,6 +463,13 @@ static CODEFIRST_RESULT CodeFirst_Init_impl(const char* overrideSchemaNamespace,
              LogError("CodeFirst was already init %s", ENUM_TO_STRING(CODEFIRST_RESULT, result));
         }
     }
+    /*Codes_SRS_CODEFIRST_41_019: [ CodeFirst_Init shall create the lock that guards the set of devices by calling Lock_Init. ]*/
+    else if ((g_DevicesLock = Lock_Init()) == NULL)
+    {
+        /*Codes_SRS_CODEFIRST_41_020: [ If Lock_Init fails, CodeFirst_Init shall fail and return CODEFIRST_ERROR. ]*/
+        result = CODEFIRST_ERROR;
+        LogError("failure in Lock_Init %s", ENUM_TO_STRING(CODEFIRST_RESULT, result));
+    }
     else
     {
         g_DeviceCount = 0;
@@ -465,14 +510,20 @@ void CodeFirst_Deinit(void)
         g_Devices = NULL;
         g_DeviceCount = 0;
 
+        /*Codes_SRS_CODEFIRST_41_021: [ CodeFirst_Deinit shall destroy the lock that guards the set of devices. ]*/
+        (void)Lock_Deinit(g_DevicesLock);
+        g_DevicesLock = NULL;
+
         g_state = CODEFIRST_STATE_NOT_INIT;
     }
 }
 
-static const REFLECTED_SOMETHING* FindModelInCodeFirstMetadata(const REFLECTED_SOMETHING* reflectedData, const char* modelName)
+/*the elements of the model are returned as the entries from *firstElement up to (and excluding) the model*/
+static const REFLECTED_SOMETHING* FindModelInCodeFirstMetadata(const REFLECTED_SOMETHING* reflectedData, const char* modelName, const REFLECTED_SOMETHING** firstElement)
 {
     const REFLECTED_SOMETHING* result;
 
+    *firstElement = reflectedData;
     for (result = reflectedData; result != NULL; result = result->next)
     {
         if ((result->type == REFLECTION_MODEL_TYPE) &&
@@ -481,12 +532,17 @@ static const REFLECTED_SOMETHING* FindModelInCodeFirstMetadata(const REFLECTED_S
             /* found model type */
             break;
         }
+
+        if (IS_ELEMENT_RUN_END(result))
+        {
+            *firstElement = result->next;
+        }
     }
 
     return result;
 }
 
-static const REFLECTED_SOMETHING* FindChildModelInCodeFirstMetadata(const REFLECTED_SOMETHING* reflectedData, const REFLECTED_SOMETHING* startModel, const char* relativePath, size_t* offset)
+static const REFLECTED_SOMETHING* FindChildModelInCodeFirstMetadata(const REFLECTED_SOMETHING* reflectedData, const REFLECTED_SOMETHING* startModel, const char* relativePath, size_t* offset, const REFLECTED_SOMETHING** firstElement)
 {
     const REFLECTED_SOMETHING* result = startModel;
     *offset = 0;
@@ -505,7 +561,7 @@ static const REFLECTED_SOMETHING* FindChildModelInCodeFirstMetadata(const REFLEC
 
         propertyNameLength = slashPos - relativePath;
 
-        for (childModelProperty = reflectedData; childModelProperty != NULL; childModelProperty = childModelProperty->next)
+        for (childModelProperty = *firstElement; childModelProperty != result; childModelProperty = childModelProperty->next)
         {
             if ((childModelProperty->type == REFLECTION_PROPERTY_TYPE) &&
                 (strcmp(childModelProperty->what.property.modelName, result->what.model.name) == 0) &&
@@ -519,14 +575,14 @@ static const REFLECTED_SOMETHING* FindChildModelInCodeFirstMetadata(const REFLEC
             }
         }
 
-        if (childModelProperty == NULL)
+        if (childModelProperty == result)
         {
             /* not found */
             result = NULL;
         }
         else
         {
-            result = FindModelInCodeFirstMetadata(reflectedData, childModelProperty->what.property.type);
+            result = FindModelInCodeFirstMetadata(reflectedData, childModelProperty->what.property.type, firstElement);
         }
 
         relativePath = slashPos;
@@ -564,14 +620,15 @@ EXECUTE_COMMAND_RESULT CodeFirst_InvokeAction(DEVICE_HANDLE deviceHandle, void*
     {
         const REFLECTED_SOMETHING* something;
         const REFLECTED_SOMETHING* childModel;
+        const REFLECTED_SOMETHING* firstElement;
         const char* modelName;
         size_t offset;
 
         modelName = Schema_GetModelName(deviceHeader->ModelHandle);
 
-        if (((childModel = FindModelInCodeFirstMetadata(deviceHeader->ReflectedData->reflectedData, modelName)) == NULL) ||
+        if (((childModel = FindModelInCodeFirstMetadata(deviceHeader->ReflectedData->reflectedData, modelName, &firstElement)) == NULL) ||
             /* Codes_SRS_CODEFIRST_99_138:[The relativeActionPath argument shall be used by CodeFirst_InvokeAction to find the child model where the action is declared.] */
-            ((childModel = FindChildModelInCodeFirstMetadata(deviceHeader->ReflectedData->reflectedData, childModel, relativeActionPath, &offset)) == NULL))
+            ((childModel = FindChildModelInCodeFirstMetadata(deviceHeader->ReflectedData->reflectedData, childModel, relativeActionPath, &offset, &firstElement)) == NULL))
         {
             /*Codes_SRS_CODEFIRST_99_141:[If a child model specified in the relativeActionPath argument cannot be found by CodeFirst_InvokeAction, it shall return EXECUTE_COMMAND_ERROR.] */
             result = EXECUTE_COMMAND_ERROR;
@@ -582,7 +639,7 @@ EXECUTE_COMMAND_RESULT CodeFirst_InvokeAction(DEVICE_HANDLE deviceHandle, void*
             /* Codes_SRS_CODEFIRST_99_062:[ When CodeFirst_InvokeAction is called it shall look through the codefirst metadata associated with a specific device for a previously declared action (function) named actionName.]*/
             /* Codes_SRS_CODEFIRST_99_078:[If such a function is not found then the function shall return EXECUTE_COMMAND_ERROR.]*/
             result = EXECUTE_COMMAND_ERROR;
-            for (something = deviceHeader->ReflectedData->reflectedData; something != NULL; something = something->next)
+            for (something = firstElement; something != childModel; something = something->next)
             {
                 if ((something->type == REFLECTION_ACTION_TYPE) &&
                     (strcmp(actionName, something->what.action.name) == 0) &&
@@ -634,13 +691,14 @@ METHODRETURN_HANDLE CodeFirst_InvokeMethod(DEVICE_HANDLE deviceHandle, void* cal
     {
         const REFLECTED_SOMETHING* something;
         const REFLECTED_SOMETHING* childModel;
+        const REFLECTED_SOMETHING* firstElement;
         const char* modelName;
         size_t offset;
 
         modelName = Schema_GetModelName(deviceHeader->ModelHandle);
 
-        if (((childModel = FindModelInCodeFirstMetadata(deviceHeader->ReflectedData->reflectedData, modelName)) == NULL) ||
-            ((childModel = FindChildModelInCodeFirstMetadata(deviceHeader->ReflectedData->reflectedData, childModel, relativeMethodPath, &offset)) == NULL))
+        if (((childModel = FindModelInCodeFirstMetadata(deviceHeader->ReflectedData->reflectedData, modelName, &firstElement)) == NULL) ||
+            ((childModel = FindChildModelInCodeFirstMetadata(deviceHeader->ReflectedData->reflectedData, childModel, relativeMethodPath, &offset, &firstElement)) == NULL))
         {
             result = NULL;
             LogError("method %s was not found", methodName);
@@ -648,7 +706,7 @@ METHODRETURN_HANDLE CodeFirst_InvokeMethod(DEVICE_HANDLE deviceHandle, void* cal
         else
         {
             result = NULL;
-            for (something = deviceHeader->ReflectedData->reflectedData; something != NULL; something = something->next)
+            for (something = firstElement; something != childModel; something = something->next)
             {
                 if ((something->type == REFLECTION_METHOD_TYPE) &&
                     (strcmp(methodName, something->what.method.name) == 0) &&
@@ -658,7 +716,7 @@ METHODRETURN_HANDLE CodeFirst_InvokeMethod(DEVICE_HANDLE deviceHandle, void* cal
                 }
             }
 
-            if (something == NULL)
+            if (something == childModel)
             {
                 LogError("method \"%s\" not found", methodName);
                 result = NULL;
@@ -876,6 +934,42 @@ static void initializeDesiredProperties(SCHEMA_MODEL_TYPE_HANDLE model, void* de
     }
 }
 
+/*g_Devices is kept ordered by the address of the device data, so the device owning an address is found by a binary search*/
+static size_t CountDevicesStartingAtOrBefore(const void* value)
+{
+    size_t low = 0;
+    size_t high = g_DeviceCount;
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+        if (g_Devices[middle]->data <= (const unsigned char*)value)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+/*returns g_DeviceCount when value does not belong to any device*/
+static size_t FindDeviceIndex(const void* value)
+{
+    size_t result = CountDevicesStartingAtOrBefore(value);
+    if ((result > 0) &&
+        (g_Devices[result - 1]->data + g_Devices[result - 1]->DataSize > (const unsigned char*)value))
+    {
+        result--;
+    }
+    else
+    {
+        result = g_DeviceCount;
+    }
+    return result;
+}
+
 /* Codes_SRS_CODEFIRST_99_079:[CodeFirst_CreateDevice shall create a device and allocate a memory block that should hold the device data.] */
 void* CodeFirst_CreateDevice(SCHEMA_MODEL_TYPE_HANDLE model, const REFLECTED_DATA_FROM_DATAPROVIDER* metadata, size_t dataSize, bool includePropertyPath)
 {
@@ -891,9 +985,12 @@ void* CodeFirst_CreateDevice(SCHEMA_MODEL_TYPE_HANDLE model, const REFLECTED_DAT
     else
     {
         /*Codes_SRS_CODEFIRST_02_037: [ CodeFirst_CreateDevice shall call CodeFirst_Init, passing NULL for overrideSchemaNamespace. ]*/
-        (void)CodeFirst_Init_impl(NULL, false); /*lazy init*/
-
-        if ((deviceHeader = (DEVICE_HEADER_DATA*)malloc(sizeof(DEVICE_HEADER_DATA))) == NULL)
+        if (CodeFirst_Init_impl(NULL, false) == CODEFIRST_ERROR) /*lazy init*/
+        {
+            result = NULL;
+            LogError(" %s ", ENUM_TO_STRING(CODEFIRST_RESULT, CODEFIRST_ERROR));
+        }
+        else if ((deviceHeader = (DEVICE_HEADER_DATA*)malloc(sizeof(DEVICE_HEADER_DATA))) == NULL)
         {
             /* Codes_SRS_CODEFIRST_99_102:[On any other errors, Device_Create shall return NULL.] */
             result = NULL;
@@ -912,8 +1009,11 @@ void* CodeFirst_CreateDevice(SCHEMA_MODEL_TYPE_HANDLE model, const REFLECTED_DAT
             }
             else
             {
-                DEVICE_HEADER_DATA** newDevices;
-
+                deviceHeader->SendPlan = NULL;
+                deviceHeader->ReportedShadow = NULL;
+                deviceHeader->ReportedDeadband = 0;
+                deviceHeader->PropertyIndex = NULL;
+                deviceHeader->ReportedPropertyIndex = NULL;
                 initializeDesiredProperties(model, deviceHeader->data);
 
                 if (Device_Create(model, CodeFirst_InvokeAction, deviceHeader, CodeFirst_InvokeMethod, deviceHeader,
@@ -926,7 +1026,8 @@ void* CodeFirst_CreateDevice(SCHEMA_MODEL_TYPE_HANDLE model, const REFLECTED_DAT
                     result = NULL;
                     LogError(" %s ", ENUM_TO_STRING(CODEFIRST_RESULT, CODEFIRST_DEVICE_FAILED));
                 }
-                else if ((newDevices = (DEVICE_HEADER_DATA**)realloc(g_Devices, sizeof(DEVICE_HEADER_DATA*) * (g_DeviceCount + 1))) == NULL)
+                /*Codes_SRS_CODEFIRST_41_022: [ CodeFirst_CreateDevice shall hold the lock that guards the set of devices while it adds the device to the set. ]*/
+                else if (Lock(g_DevicesLock) != LOCK_OK)
                 {
                     Device_Destroy(deviceHeader->DeviceHandle);
                     free(deviceHeader->data);
@@ -934,34 +1035,55 @@ void* CodeFirst_CreateDevice(SCHEMA_MODEL_TYPE_HANDLE model, const REFLECTED_DAT
 
                     /* Codes_SRS_CODEFIRST_99_102:[On any other errors, Device_Create shall return NULL.] */
                     result = NULL;
-                    LogError(" %s ", ENUM_TO_STRING(CODEFIRST_RESULT, CODEFIRST_ERROR));
+                    LogError("failure in Lock %s", ENUM_TO_STRING(CODEFIRST_RESULT, CODEFIRST_ERROR));
                 }
                 else
                 {
-                    SCHEMA_RESULT schemaResult;
-                    deviceHeader->ReflectedData = metadata;
-                    deviceHeader->DataSize = dataSize;
-                    deviceHeader->ModelHandle = model;
-                    schemaResult = Schema_AddDeviceRef(model);
-                    if (schemaResult != SCHEMA_OK)
+                    DEVICE_HEADER_DATA** newDevices;
+
+                    if ((newDevices = (DEVICE_HEADER_DATA**)realloc(g_Devices, sizeof(DEVICE_HEADER_DATA*) * (g_DeviceCount + 1))) == NULL)
                     {
                         Device_Destroy(deviceHeader->DeviceHandle);
-                        free(newDevices);
                         free(deviceHeader->data);
                         free(deviceHeader);
 
                         /* Codes_SRS_CODEFIRST_99_102:[On any other errors, Device_Create shall return NULL.] */
                         result = NULL;
+                        LogError(" %s ", ENUM_TO_STRING(CODEFIRST_RESULT, CODEFIRST_ERROR));
                     }
                     else
                     {
+                        SCHEMA_RESULT schemaResult;
+
+                        /*the set of devices now only has room for one more device, the devices in it are unchanged*/
                         g_Devices = newDevices;
-                        g_Devices[g_DeviceCount] = deviceHeader;
-                        g_DeviceCount++;
 
-                        /* Codes_SRS_CODEFIRST_99_101:[On success, CodeFirst_CreateDevice shall return a non NULL pointer to the device data.] */
-                        result = deviceHeader->data;
+                        deviceHeader->ReflectedData = metadata;
+                        deviceHeader->DataSize = dataSize;
+                        deviceHeader->ModelHandle = model;
+                        schemaResult = Schema_AddDeviceRef(model);
+                        if (schemaResult != SCHEMA_OK)
+                        {
+                            Device_Destroy(deviceHeader->DeviceHandle);
+                            free(deviceHeader->data);
+                            free(deviceHeader);
+
+                            /* Codes_SRS_CODEFIRST_99_102:[On any other errors, Device_Create shall return NULL.] */
+                            result = NULL;
+                        }
+                        else
+                        {
+                            size_t insertAt = CountDevicesStartingAtOrBefore(deviceHeader->data);
+                            (void)memmove(&g_Devices[insertAt + 1], &g_Devices[insertAt], (g_DeviceCount - insertAt) * sizeof(DEVICE_HEADER_DATA*));
+                            g_Devices[insertAt] = deviceHeader;
+                            g_DeviceCount++;
+
+                            /* Codes_SRS_CODEFIRST_99_101:[On success, CodeFirst_CreateDevice shall return a non NULL pointer to the device data.] */
+                            result = deviceHeader->data;
+                        }
                     }
+
+                    (void)Unlock(g_DevicesLock);
                 }
             }
         }
@@ -974,13 +1096,19 @@ void* CodeFirst_CreateDevice(SCHEMA_MODEL_TYPE_HANDLE model, const REFLECTED_DAT
 void CodeFirst_DestroyDevice(void* device)
 {
     /* Codes_SRS_CODEFIRST_99_086:[If the argument is NULL, CodeFirst_DestroyDevice shall do nothing.] */
-    if (device != NULL)
+    if ((device != NULL) && (g_DevicesLock != NULL))
     {
-        size_t i;
-
-        for (i = 0; i < g_DeviceCount; i++)
+        /*Codes_SRS_CODEFIRST_41_023: [ CodeFirst_DestroyDevice shall hold the lock that guards the set of devices while it removes the device from the set. ]*/
+        if (Lock(g_DevicesLock) != LOCK_OK)
         {
-            if (g_Devices[i]->data == device)
+            LogError("failure in Lock");
+        }
+        else
+        {
+            bool destroyLock = false;
+            size_t i = FindDeviceIndex(device);
+
+            if ((i < g_DeviceCount) && (g_Devices[i]->data == device))
             {
                 deinitializeDesiredProperties(g_Devices[i]->ModelHandle, g_Devices[i]->data);
                 Schema_ReleaseDeviceRef(g_Devices[i]->ModelHandle);
@@ -989,120 +1117,289 @@ void CodeFirst_DestroyDevice(void* device)
                 Schema_DestroyIfUnused(g_Devices[i]->ModelHandle);
 
                 DestroyDevice(g_Devices[i]);
-                (void)memcpy(&g_Devices[i], &g_Devices[i + 1], (g_DeviceCount - i - 1) * sizeof(DEVICE_HEADER_DATA*));
+                (void)memmove(&g_Devices[i], &g_Devices[i + 1], (g_DeviceCount - i - 1) * sizeof(DEVICE_HEADER_DATA*));
                 g_DeviceCount--;
-                break;
             }
-        }
 
-        /*Codes_SRS_CODEFIRST_02_039: [ If the current device count is zero then CodeFirst_DestroyDevice shall deallocate all other used resources. ]*/
-        if ((g_state == CODEFIRST_STATE_INIT_BY_API) && (g_DeviceCount == 0))
-        {
-            free(g_Devices);
-            g_Devices = NULL;
-            g_state = CODEFIRST_STATE_NOT_INIT;
+            /*Codes_SRS_CODEFIRST_02_039: [ If the current device count is zero then CodeFirst_DestroyDevice shall deallocate all other used resources. ]*/
+            if ((g_state == CODEFIRST_STATE_INIT_BY_API) && (g_DeviceCount == 0))
+            {
+                free(g_Devices);
+                g_Devices = NULL;
+                g_state = CODEFIRST_STATE_NOT_INIT;
+                destroyLock = true;
+            }
+
+            (void)Unlock(g_DevicesLock);
+
+            if (destroyLock)
+            {
+                (void)Lock_Deinit(g_DevicesLock);
+                g_DevicesLock = NULL;
+            }
         }
     }
 }
 
+/*Codes_SRS_CODEFIRST_41_024: [ Looking up the device of a value shall hold the lock that guards the set of devices only for the duration of the lookup. ]*/
 static DEVICE_HEADER_DATA* FindDevice(void* value)
 {
-    size_t i;
-    DEVICE_HEADER_DATA* result = NULL;
+    DEVICE_HEADER_DATA* result;
+    if (g_DevicesLock == NULL)
+    {
+        result = NULL;
+    }
+    else if (Lock(g_DevicesLock) != LOCK_OK)
+    {
+        LogError("failure in Lock");
+        result = NULL;
+    }
+    else
+    {
+        size_t i = FindDeviceIndex(value);
+        result = (i < g_DeviceCount) ? g_Devices[i] : NULL;
+        (void)Unlock(g_DevicesLock);
+    }
+    return result;
+}
+
+/*a property (or reported property) of a device, possibly one of a model in model, at its offset in the device data*/
+typedef struct PROPERTY_OFFSET_NODE_TAG
+{
+    size_t offset;
+    size_t parent; /*the node of the model in model that contains this property, NO_PARENT_NODE for the properties of the device model*/
+    const REFLECTED_SOMETHING* property;
+} PROPERTY_OFFSET_NODE;
+
+#define NO_PARENT_NODE ((size_t)-1)
+
+typedef struct PROPERTY_OFFSET_KEY_TAG
+{
+    size_t offset;
+    size_t node;
+} PROPERTY_OFFSET_KEY;
+
+typedef struct PROPERTY_OFFSET_INDEX_TAG
+{
+    PROPERTY_OFFSET_NODE* nodes; /*parents come before their children*/
+    size_t nNodes;
+    PROPERTY_OFFSET_KEY* byOffset; /*one per node, ordered by offset and then by node*/
+} PROPERTY_OFFSET_INDEX;
+
+static void DestroyPropertyOffsetIndex(PROPERTY_OFFSET_INDEX* index)
+{
+    if (index != NULL)
+    {
+        free(index->nodes);
+        free(index->byOffset);
+        free(index);
+    }
+}
+
+/*the offset, type and name of REFLECTION_PROPERTY_TYPE and REFLECTION_REPORTED_PROPERTY_TYPE are in different members*/
+static size_t GetPropertyOffset(const REFLECTED_SOMETHING* property)
+{
+    return (property->type == REFLECTION_PROPERTY_TYPE) ? property->what.property.offset : property->what.reportedProperty.offset;
+}
+
+static const char* GetPropertyType(const REFLECTED_SOMETHING* property)
+{
+    return (property->type == REFLECTION_PROPERTY_TYPE) ? property->what.property.type : property->what.reportedProperty.type;
+}
+
+static const char* GetPropertyName(const REFLECTED_SOMETHING* property)
+{
+    return (property->type == REFLECTION_PROPERTY_TYPE) ? property->what.property.name : property->what.reportedProperty.name;
+}
+
+static int AddPropertyOffsetNodes(PROPERTY_OFFSET_INDEX* index, const REFLECTED_SOMETHING* reflectedData, REFLECTION_TYPE propertyType, const char* modelName, size_t startOffset, size_t parent)
+{
+    int result = 0;
+    const REFLECTED_SOMETHING* firstElement;
+    const REFLECTED_SOMETHING* model = FindModelInCodeFirstMetadata(reflectedData, modelName, &firstElement);
 
-    for (i = 0; i < g_DeviceCount; i++)
+    if (model != NULL) /*properties whose type is not a model have no inner properties*/
     {
-        if ((g_Devices[i]->data <= (unsigned char*)value) &&
-            (g_Devices[i]->data + g_Devices[i]->DataSize > (unsigned char*)value))
+        const REFLECTED_SOMETHING* something;
+        for (something = firstElement; something != model; something = something->next)
         {
-            result = g_Devices[i];
-            break;
+            if (something->type == propertyType)
+            {
+                PROPERTY_OFFSET_NODE* newNodes = (PROPERTY_OFFSET_NODE*)realloc(index->nodes, sizeof(PROPERTY_OFFSET_NODE) * (index->nNodes + 1));
+                if (newNodes == NULL)
+                {
+                    LogError("failure allocating the property offset index");
+                    result = __FAILURE__;
+                    break;
+                }
+                else
+                {
+                    size_t node = index->nNodes++;
+                    index->nodes = newNodes;
+                    index->nodes[node].offset = startOffset + GetPropertyOffset(something);
+                    index->nodes[node].parent = parent;
+                    index->nodes[node].property = something;
+
+                    /* Codes_SRS_CODEFIRST_99_133:[CodeFirst_SendAsync shall allow sending of properties that are part of a child model.] */
+                    if (AddPropertyOffsetNodes(index, reflectedData, propertyType, GetPropertyType(something), index->nodes[node].offset, node) != 0)
+                    {
+                        result = __FAILURE__;
+                        break;
+                    }
+                }
+            }
         }
     }
 
     return result;
 }
 
-static const REFLECTED_SOMETHING* FindValue(DEVICE_HEADER_DATA* deviceHeader, void* value, const char* modelName, size_t startOffset, STRING_HANDLE valuePath)
+static int ComparePropertyOffsetKeys(const void* left, const void* right)
 {
-    const REFLECTED_SOMETHING* result;
-    size_t valueOffset = (size_t)((unsigned char*)value - (unsigned char*)deviceHeader->data) - startOffset;
+    const PROPERTY_OFFSET_KEY* leftKey = (const PROPERTY_OFFSET_KEY*)left;
+    const PROPERTY_OFFSET_KEY* rightKey = (const PROPERTY_OFFSET_KEY*)right;
+    int result;
+    if (leftKey->offset != rightKey->offset)
+    {
+        result = (leftKey->offset < rightKey->offset) ? -1 : 1;
+    }
+    else
+    {
+        /*a model in model and its first property share the offset, the model in model (the parent) is the one found*/
+        result = (leftKey->node < rightKey->node) ? -1 : ((leftKey->node > rightKey->node) ? 1 : 0);
+    }
+    return result;
+}
 
-    for (result = deviceHeader->ReflectedData->reflectedData; result != NULL; result = result->next)
+static PROPERTY_OFFSET_INDEX* CreatePropertyOffsetIndex(DEVICE_HEADER_DATA* deviceHeader, REFLECTION_TYPE propertyType, const char* modelName)
+{
+    PROPERTY_OFFSET_INDEX* result = (PROPERTY_OFFSET_INDEX*)malloc(sizeof(PROPERTY_OFFSET_INDEX));
+    if (result == NULL)
+    {
+        LogError("failure allocating the property offset index");
+    }
+    else
     {
-        if (result->type == REFLECTION_PROPERTY_TYPE &&
-            (strcmp(result->what.property.modelName, modelName) == 0) &&
-            (result->what.property.offset <= valueOffset) &&
-            (result->what.property.offset + result->what.property.size > valueOffset))
+        result->nodes = NULL;
+        result->nNodes = 0;
+        result->byOffset = NULL;
+
+        if (AddPropertyOffsetNodes(result, deviceHeader->ReflectedData->reflectedData, propertyType, modelName, 0, NO_PARENT_NODE) != 0)
+        {
+            DestroyPropertyOffsetIndex(result);
+            result = NULL;
+        }
+        else if ((result->nNodes > 0) &&
+            ((result->byOffset = (PROPERTY_OFFSET_KEY*)malloc(sizeof(PROPERTY_OFFSET_KEY) * result->nNodes)) == NULL))
+        {
+            LogError("failure allocating the property offset index");
+            DestroyPropertyOffsetIndex(result);
+            result = NULL;
+        }
+        else
         {
-            if (startOffset != 0)
+            size_t i;
+            for (i = 0; i < result->nNodes; i++)
             {
-                STRING_concat(valuePath, "/");
+                result->byOffset[i].offset = result->nodes[i].offset;
+                result->byOffset[i].node = i;
             }
-
-            STRING_concat(valuePath, result->what.property.name);
-            break;
+            qsort(result->byOffset, result->nNodes, sizeof(PROPERTY_OFFSET_KEY), ComparePropertyOffsetKeys);
         }
     }
+    return result;
+}
+
+/* Codes_SRS_CODEFIRST_99_136:[CodeFirst_SendAsync shall build the full path for each property and then pass it to Device_PublishTransacted.] */
+static int AppendPropertyPath(const PROPERTY_OFFSET_INDEX* index, size_t node, STRING_HANDLE valuePath)
+{
+    int result;
+    size_t parent = index->nodes[node].parent;
 
-    if (result != NULL)
+    if ((parent != NO_PARENT_NODE) &&
+        (AppendPropertyPath(index, parent, valuePath) != 0))
     {
-        /* Codes_SRS_CODEFIRST_99_133:[CodeFirst_SendAsync shall allow sending of properties that are part of a child model.] */
-        if (result->what.property.offset < valueOffset)
-        {
-            /* find recursively the property in the inner model, if there is one */
-            result = FindValue(deviceHeader, value, result->what.property.type, startOffset + result->what.property.offset, valuePath);
-        }
+        result = __FAILURE__;
+    }
+    /*the name of a property is separated from the one of its model in model, which never is the first member of a model*/
+    else if ((parent != NO_PARENT_NODE) && (index->nodes[parent].offset != 0) &&
+        (STRING_concat(valuePath, "/") != 0))
+    {
+        LogError("unable to STRING_concat");
+        result = __FAILURE__;
+    }
+    else if (STRING_concat(valuePath, GetPropertyName(index->nodes[node].property)) != 0)
+    {
+        LogError("unable to STRING_concat");
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = 0;
     }
 
     return result;
 }
 
-static const REFLECTED_SOMETHING* FindReportedProperty(DEVICE_HEADER_DATA* deviceHeader, void* value, const char* modelName, size_t startOffset, STRING_HANDLE valuePath)
+/*returns the property (or reported property) whose value starts at value and appends its path to valuePath*/
+static const REFLECTED_SOMETHING* FindPropertyByOffset(DEVICE_HEADER_DATA* deviceHeader, PROPERTY_OFFSET_INDEX** index, REFLECTION_TYPE propertyType, void* value, const char* modelName, STRING_HANDLE valuePath)
 {
     const REFLECTED_SOMETHING* result;
-    size_t valueOffset = (size_t)((unsigned char*)value - (unsigned char*)deviceHeader->data) - startOffset;
 
-    for (result = deviceHeader->ReflectedData->reflectedData; result != NULL; result = result->next)
+    if ((*index == NULL) &&
+        ((*index = CreatePropertyOffsetIndex(deviceHeader, propertyType, modelName)) == NULL))
     {
-        if (result->type == REFLECTION_REPORTED_PROPERTY_TYPE &&
-            (strcmp(result->what.reportedProperty.modelName, modelName) == 0) &&
-            (result->what.reportedProperty.offset <= valueOffset) &&
-            (result->what.reportedProperty.offset + result->what.reportedProperty.size > valueOffset))
+        result = NULL;
+    }
+    else
+    {
+        size_t valueOffset = (size_t)((unsigned char*)value - (unsigned char*)deviceHeader->data);
+        size_t low = 0;
+        size_t high = (*index)->nNodes;
+
+        /*first of the nodes at or after valueOffset*/
+        while (low < high)
         {
-            if (startOffset != 0)
+            size_t middle = low + (high - low) / 2;
+            if ((*index)->byOffset[middle].offset < valueOffset)
             {
-                if (STRING_concat(valuePath, "/") != 0)
-                {
-                    LogError("unable to STRING_concat");
-                    result = NULL;
-                    break;
-                }
+                low = middle + 1;
             }
-
-            if (STRING_concat(valuePath, result->what.reportedProperty.name) != 0)
+            else
             {
-                LogError("unable to STRING_concat");
-                result = NULL;
-                break;
+                high = middle;
             }
-            break;
         }
-    }
 
-    if (result != NULL)
-    {
-        /* Codes_SRS_CODEFIRST_99_133:[CodeFirst_SendAsync shall allow sending of properties that are part of a child model.] */
-        if (result->what.reportedProperty.offset < valueOffset)
+        if ((low == (*index)->nNodes) ||
+            ((*index)->byOffset[low].offset != valueOffset))
         {
-            /* find recursively the property in the inner model, if there is one */
-            result = FindReportedProperty(deviceHeader, value, result->what.reportedProperty.type, startOffset + result->what.reportedProperty.offset, valuePath);
+            /*value does not point to the beginning of a property*/
+            result = NULL;
+        }
+        else if (AppendPropertyPath(*index, (*index)->byOffset[low].node, valuePath) != 0)
+        {
+            result = NULL;
+        }
+        else
+        {
+            result = (*index)->nodes[(*index)->byOffset[low].node].property;
         }
     }
 
     return result;
 }
 
+static const REFLECTED_SOMETHING* FindValue(DEVICE_HEADER_DATA* deviceHeader, void* value, const char* modelName, STRING_HANDLE valuePath)
+{
+    return FindPropertyByOffset(deviceHeader, &deviceHeader->PropertyIndex, REFLECTION_PROPERTY_TYPE, value, modelName, valuePath);
+}
+
+static const REFLECTED_SOMETHING* FindReportedProperty(DEVICE_HEADER_DATA* deviceHeader, void* value, const char* modelName, STRING_HANDLE valuePath)
+{
+    return FindPropertyByOffset(deviceHeader, &deviceHeader->ReportedPropertyIndex, REFLECTION_REPORTED_PROPERTY_TYPE, value, modelName, valuePath);
+}
+
 /* Codes_SRS_CODEFIRST_99_130:[If a pointer to the beginning of a device block is passed to CodeFirst_SendAsync instead of a pointer to a property, CodeFirst_SendAsync shall send all the properties that belong to that device.] */
 /* Codes_SRS_CODEFIRST_99_131:[The properties shall be given to Device as one transaction, as if they were all passed as individual arguments to Code_First.] */
 static CODEFIRST_RESULT SendAllDeviceProperties(DEVICE_HEADER_DATA* deviceHeader, TRANSACTION_HANDLE transaction)
@@ -1149,7 +1446,127 @@ static CODEFIRST_RESULT SendAllDeviceProperties(DEVICE_HEADER_DATA* deviceHeader
     return result;
 }
 
-static CODEFIRST_RESULT SendAllDeviceReportedProperties(DEVICE_HEADER_DATA* deviceHeader, REPORTED_PROPERTIES_TRANSACTION_HANDLE transaction)
+/*a reported property can be compared byte by byte with its previous value only when its value is entirely stored in the model instance
+(ascii_char_ptr, EDM_BINARY, structs and so on point to memory outside of it)*/
+static bool IsReportedPropertyComparable(const REFLECTED_SOMETHING* reportedProperty)
+{
+    bool result;
+    switch (CodeFirst_GetPrimitiveType(reportedProperty->what.reportedProperty.type))
+    {
+        case EDM_NO_TYPE:
+        case EDM_STRING_TYPE:
+        case EDM_STRING_NO_QUOTES_TYPE:
+        case EDM_BINARY_TYPE:
+        {
+            result = false;
+            break;
+        }
+        default:
+        {
+            result = true;
+            break;
+        }
+    }
+    return result;
+}
+
+/*reads a reported property of a numeric type as a double, the width of int and long is the one the model was compiled with*/
+static bool GetReportedPropertyNumber(const REFLECTED_SOMETHING* reportedProperty, const unsigned char* address, double* value)
+{
+    bool result = true;
+    size_t size = reportedProperty->what.reportedProperty.size;
+    switch (CodeFirst_GetPrimitiveType(reportedProperty->what.reportedProperty.type))
+    {
+#ifndef NO_FLOATS
+        case EDM_DOUBLE_TYPE:
+        {
+            double number;
+            (void)memcpy(&number, address, sizeof(number));
+            *value = number;
+            break;
+        }
+        case EDM_SINGLE_TYPE:
+        {
+            float number;
+            (void)memcpy(&number, address, sizeof(number));
+            *value = number;
+            break;
+        }
+#endif
+        case EDM_BYTE_TYPE:
+        {
+            *value = *(const uint8_t*)address;
+            break;
+        }
+        case EDM_SBYTE_TYPE:
+        {
+            *value = *(const int8_t*)address;
+            break;
+        }
+        case EDM_INT16_TYPE:
+        case EDM_INT32_TYPE:
+        case EDM_INT64_TYPE:
+        {
+            if (size == sizeof(int16_t))
+            {
+                int16_t number;
+                (void)memcpy(&number, address, sizeof(number));
+                *value = number;
+            }
+            else if (size == sizeof(int32_t))
+            {
+                int32_t number;
+                (void)memcpy(&number, address, sizeof(number));
+                *value = number;
+            }
+            else if (size == sizeof(int64_t))
+            {
+                int64_t number;
+                (void)memcpy(&number, address, sizeof(number));
+                *value = (double)number;
+            }
+            else
+            {
+                result = false;
+            }
+            break;
+        }
+        default:
+        {
+            result = false;
+            break;
+        }
+    }
+    return result;
+}
+
+/*a reported property is unchanged when it has the bytes it has in previousData or, with a deadband set, is a number within the deadband of its value there*/
+static bool IsReportedPropertyUnchanged(const DEVICE_HEADER_DATA* deviceHeader, const REFLECTED_SOMETHING* reportedProperty, const unsigned char* previousData)
+{
+    bool result;
+    if ((previousData == NULL) || !IsReportedPropertyComparable(reportedProperty))
+    {
+        result = false;
+    }
+    else
+    {
+        const unsigned char* current = deviceHeader->data + reportedProperty->what.reportedProperty.offset;
+        const unsigned char* previous = previousData + reportedProperty->what.reportedProperty.offset;
+        double currentValue;
+        double previousValue;
+
+        result = (memcmp(current, previous, reportedProperty->what.reportedProperty.size) == 0) ||
+            ((deviceHeader->ReportedDeadband > 0) &&
+            GetReportedPropertyNumber(reportedProperty, current, &currentValue) &&
+            GetReportedPropertyNumber(reportedProperty, previous, &previousValue) &&
+            (currentValue - previousValue <= deviceHeader->ReportedDeadband) &&
+            (previousValue - currentValue <= deviceHeader->ReportedDeadband));
+    }
+    return result;
+}
+
+/*when previousData is not NULL, reported properties whose value has not changed since previousData was taken are not published*/
+static CODEFIRST_RESULT SendAllDeviceReportedProperties(DEVICE_HEADER_DATA* deviceHeader, REPORTED_PROPERTIES_TRANSACTION_HANDLE transaction, const unsigned char* previousData)
 {
     const char* modelName = Schema_GetModelName(deviceHeader->ModelHandle);
     const REFLECTED_SOMETHING* something;
@@ -1163,7 +1580,12 @@ static CODEFIRST_RESULT SendAllDeviceReportedProperties(DEVICE_HEADER_DATA* devi
         {
             AGENT_DATA_TYPE agentDataType;
 
-            if (something->what.reportedProperty.Create_AGENT_DATA_TYPE_from_Ptr(deviceAddress + something->what.reportedProperty.offset, &agentDataType) != AGENT_DATA_TYPES_OK)
+            if (IsReportedPropertyUnchanged(deviceHeader, something, previousData))
+            {
+                /*Codes_SRS_CODEFIRST_41_013: [ CodeFirst_SendAsyncReportedChanges shall not publish a reported property of type double, float, int, long, int8_t, uint8_t, int16_t, int32_t, int64_t, bool, EDM_DATE_TIME_OFFSET or EDM_GUID whose value is the same as in the previous successful call. ]*/
+                /*Codes_SRS_CODEFIRST_41_036: [ While a deadband is set, CodeFirst_SendAsyncReportedChanges shall not publish a reported property of type double, float, int, long, int8_t, uint8_t, int16_t, int32_t or int64_t whose value is within the deadband of the value it last published. ]*/
+            }
+            else if (something->what.reportedProperty.Create_AGENT_DATA_TYPE_from_Ptr(deviceAddress + something->what.reportedProperty.offset, &agentDataType) != AGENT_DATA_TYPES_OK)
             {
                 result = CODEFIRST_AGENT_DATA_TYPE_ERROR;
                 LOG_CODEFIRST_ERROR;
@@ -1187,6 +1609,29 @@ static CODEFIRST_RESULT SendAllDeviceReportedProperties(DEVICE_HEADER_DATA* devi
     return result;
 }
 
+/*with a deadband, only the reported properties just published take their new value, so that a value drifting inside the deadband is still compared with the last one published*/
+static void UpdateReportedShadow(DEVICE_HEADER_DATA* deviceHeader, const unsigned char* previousData)
+{
+    if ((previousData == NULL) || !(deviceHeader->ReportedDeadband > 0))
+    {
+        (void)memcpy(deviceHeader->ReportedShadow, deviceHeader->data, deviceHeader->DataSize);
+    }
+    else
+    {
+        const char* modelName = Schema_GetModelName(deviceHeader->ModelHandle);
+        const REFLECTED_SOMETHING* something;
+
+        for (something = deviceHeader->ReflectedData->reflectedData; something != NULL; something = something->next)
+        {
+            if ((something->type == REFLECTION_REPORTED_PROPERTY_TYPE) &&
+                (strcmp(something->what.reportedProperty.modelName, modelName) == 0) &&
+                !IsReportedPropertyUnchanged(deviceHeader, something, previousData))
+            {
+                (void)memcpy(deviceHeader->ReportedShadow + something->what.reportedProperty.offset, deviceHeader->data + something->what.reportedProperty.offset, something->what.reportedProperty.size);
+            }
+        }
+    }
+}
 
 /* Codes_SRS_CODEFIRST_99_088:[CodeFirst_SendAsync shall send to the Device module a set of properties, a destination and a destinationSize.]*/
 CODEFIRST_RESULT CodeFirst_SendAsync(unsigned char** destination, size_t* destinationSize, size_t numProperties, ...)
@@ -1287,7 +1732,7 @@ CODEFIRST_RESULT CodeFirst_SendAsync(unsigned char** destination, size_t* destin
                             STRING_delete(valuePath);
                             break;
                         }
-                        else if ((propertyReflectedData = FindValue(deviceHeader, value, modelName, 0, valuePath)) == NULL)
+                        else if ((propertyReflectedData = FindValue(deviceHeader, value, modelName, valuePath)) == NULL)
                         {
                             /* Codes_SRS_CODEFIRST_99_104:[If a property cannot be associated with a device, CodeFirst_SendAsync shall return CODEFIRST_INVALID_ARG.] */
                             result = CODEFIRST_INVALID_ARG;
@@ -1363,11 +1808,851 @@ CODEFIRST_RESULT CodeFirst_SendAsync(unsigned char** destination, size_t* destin
     return result;
 }
 
-CODEFIRST_RESULT CodeFirst_SendAsyncReported(unsigned char** destination, size_t* destinationSize, size_t numReportedProperties, ...)
+/*the plan lists the primitive properties of the root model of a device: SendAsyncToBuffer finds a value by its offset
+and writes it straight into the caller's buffer, without going through a transaction, a MultiTree and the JSON encoder*/
+typedef struct SEND_PLAN_ENTRY_TAG
 {
-    CODEFIRST_RESULT result;
-    if ((destination == NULL) || (destinationSize == NULL) || numReportedProperties == 0)
-    {
+    size_t offset;
+    const REFLECTED_SOMETHING* property;
+    AGENT_DATA_TYPE_TYPE type;
+    size_t nameLength;
+    size_t lastSend; /*value of sendCount when the entry was last written, catches properties passed twice*/
+} SEND_PLAN_ENTRY;
+
+typedef struct SEND_PLAN_TAG
+{
+    SEND_PLAN_ENTRY* entries;
+    size_t nEntries;
+    bool coversDevice; /*true when every property of the root model is primitive*/
+    size_t sendCount;
+    STRING_HANDLE scratch; /*only used for the types that are not formatted in place, created when first needed*/
+} SEND_PLAN;
+
+typedef struct SEND_BUFFER_TAG
+{
+    unsigned char* destination;
+    size_t capacity;
+    size_t size;
+    bool cbor; /*when true the properties are written as a CBOR map instead of a JSON object*/
+    size_t pairCount; /*number of properties written, only needed for the CBOR map header*/
+} SEND_BUFFER;
+
+static void DestroySendPlan(SEND_PLAN* plan)
+{
+    if (plan != NULL)
+    {
+        if (plan->scratch != NULL)
+        {
+            STRING_delete(plan->scratch);
+        }
+        free(plan->entries);
+        free(plan);
+    }
+}
+
+static SEND_PLAN* CreateSendPlan(DEVICE_HEADER_DATA* deviceHeader)
+{
+    SEND_PLAN* result;
+    const char* modelName;
+
+    if ((modelName = Schema_GetModelName(deviceHeader->ModelHandle)) == NULL)
+    {
+        LogError("unable to get the model name");
+        result = NULL;
+    }
+    else if ((result = (SEND_PLAN*)malloc(sizeof(SEND_PLAN))) == NULL)
+    {
+        LogError("unable to allocate the send plan");
+    }
+    else
+    {
+        const REFLECTED_SOMETHING* something;
+        size_t nProperties = 0;
+
+        result->entries = NULL;
+        result->nEntries = 0;
+        result->sendCount = 0;
+        result->scratch = NULL;
+
+        for (something = deviceHeader->ReflectedData->reflectedData; something != NULL; something = something->next)
+        {
+            if ((something->type == REFLECTION_PROPERTY_TYPE) &&
+                (strcmp(something->what.property.modelName, modelName) == 0))
+            {
+                nProperties++;
+            }
+        }
+
+        if ((nProperties > 0) &&
+            ((result->entries = (SEND_PLAN_ENTRY*)malloc(nProperties * sizeof(SEND_PLAN_ENTRY))) == NULL))
+        {
+            LogError("unable to allocate %lu send plan entries", (unsigned long)nProperties);
+            free(result);
+            result = NULL;
+        }
+        else
+        {
+            for (something = deviceHeader->ReflectedData->reflectedData; something != NULL; something = something->next)
+            {
+                if ((something->type == REFLECTION_PROPERTY_TYPE) &&
+                    (strcmp(something->what.property.modelName, modelName) == 0))
+                {
+                    AGENT_DATA_TYPE_TYPE type = CodeFirst_GetPrimitiveType(something->what.property.type);
+                    if (type != EDM_NO_TYPE)
+                    {
+                        SEND_PLAN_ENTRY* entry = &result->entries[result->nEntries++];
+                        entry->offset = something->what.property.offset;
+                        entry->property = something;
+                        entry->type = type;
+                        entry->nameLength = strlen(something->what.property.name);
+                        entry->lastSend = 0;
+                    }
+                }
+            }
+
+            result->coversDevice = (result->nEntries == nProperties);
+        }
+    }
+
+    return result;
+}
+
+static int AppendToSendBuffer(SEND_BUFFER* buffer, const char* source, size_t length)
+{
+    int result;
+
+    if (buffer->capacity - buffer->size < length)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        (void)memcpy(buffer->destination + buffer->size, source, length);
+        buffer->size += length;
+        result = 0;
+    }
+
+    return result;
+}
+
+static size_t FormatInt64(char* destination, int64_t value)
+{
+    char digits[20];
+    size_t nDigits = 0;
+    size_t result = 0;
+    uint64_t magnitude = (value < 0) ? ((uint64_t)0 - (uint64_t)value) : (uint64_t)value;
+
+    do
+    {
+        digits[nDigits++] = (char)('0' + (magnitude % 10));
+        magnitude /= 10;
+    } while (magnitude != 0);
+
+    if (value < 0)
+    {
+        destination[result++] = '-';
+    }
+
+    while (nDigits > 0)
+    {
+        destination[result++] = digits[--nDigits];
+    }
+
+    return result;
+}
+
+#ifndef NO_FLOATS
+/*same text as AgentDataTypes_ToString produces for EDM_DOUBLE and EDM_SINGLE*/
+static CODEFIRST_RESULT WriteFloatingPoint(SEND_BUFFER* buffer, double value, int precision)
+{
+    CODEFIRST_RESULT result;
+    char temp[DBL_MAX_10_EXP + DBL_DIG + 4];
+    const char* text = temp;
+    int length;
+
+    if (ISNAN(value))
+    {
+        text = "NaN";
+        length = 3;
+    }
+    else if (ISNEGATIVEINFINITY(value))
+    {
+        text = "-INF";
+        length = 4;
+    }
+    else if (ISPOSITIVEINFINITY(value))
+    {
+        text = "INF";
+        length = 3;
+    }
+    else
+    {
+        length = sprintf_s(temp, sizeof(temp), "%.*f", precision, value);
+    }
+
+    if (length < 0)
+    {
+        result = CODEFIRST_AGENT_DATA_TYPE_ERROR;
+    }
+    else if (AppendToSendBuffer(buffer, text, (size_t)length) != 0)
+    {
+        result = CODEFIRST_BUFFER_TOO_SMALL;
+    }
+    else
+    {
+        result = CODEFIRST_OK;
+    }
+
+    return result;
+}
+#endif
+
+static CODEFIRST_RESULT WriteAgentDataType(SEND_PLAN* plan, SEND_BUFFER* buffer, const AGENT_DATA_TYPE* agentData)
+{
+    CODEFIRST_RESULT result;
+    char temp[21]; /*an int64_t with its sign*/
+    size_t length;
+
+    switch (agentData->type)
+    {
+        case EDM_BOOLEAN_TYPE:
+        {
+            const char* text = (agentData->value.edmBoolean.value == EDM_TRUE) ? "true" : "false";
+            result = (AppendToSendBuffer(buffer, text, strlen(text)) == 0) ? CODEFIRST_OK : CODEFIRST_BUFFER_TOO_SMALL;
+            break;
+        }
+        case EDM_SBYTE_TYPE:
+        case EDM_BYTE_TYPE:
+        case EDM_INT16_TYPE:
+        case EDM_INT32_TYPE:
+        case EDM_INT64_TYPE:
+        {
+            int64_t value =
+                (agentData->type == EDM_SBYTE_TYPE) ? agentData->value.edmSbyte.value :
+                (agentData->type == EDM_BYTE_TYPE) ? agentData->value.edmByte.value :
+                (agentData->type == EDM_INT16_TYPE) ? agentData->value.edmInt16.value :
+                (agentData->type == EDM_INT32_TYPE) ? agentData->value.edmInt32.value :
+                agentData->value.edmInt64.value;
+            length = FormatInt64(temp, value);
+            result = (AppendToSendBuffer(buffer, temp, length) == 0) ? CODEFIRST_OK : CODEFIRST_BUFFER_TOO_SMALL;
+            break;
+        }
+#ifndef NO_FLOATS
+        case EDM_DOUBLE_TYPE:
+        {
+            result = WriteFloatingPoint(buffer, agentData->value.edmDouble.value, DBL_DIG);
+            break;
+        }
+        case EDM_SINGLE_TYPE:
+        {
+            result = WriteFloatingPoint(buffer, (double)agentData->value.edmSingle.value, FLT_DIG);
+            break;
+        }
+#endif
+        default:
+        {
+            /*strings need escaping and the remaining types are rare, AgentDataTypes_ToString already knows them*/
+            if ((plan->scratch == NULL) &&
+                ((plan->scratch = STRING_new()) == NULL))
+            {
+                result = CODEFIRST_ERROR;
+            }
+            else if (STRING_empty(plan->scratch) != 0)
+            {
+                result = CODEFIRST_ERROR;
+            }
+            else if (AgentDataTypes_ToString(plan->scratch, agentData) != AGENT_DATA_TYPES_OK)
+            {
+                result = CODEFIRST_AGENT_DATA_TYPE_ERROR;
+            }
+            else if (AppendToSendBuffer(buffer, STRING_c_str(plan->scratch), STRING_length(plan->scratch)) != 0)
+            {
+                result = CODEFIRST_BUFFER_TOO_SMALL;
+            }
+            else
+            {
+                result = CODEFIRST_OK;
+            }
+            break;
+        }
+    }
+
+    return result;
+}
+
+static CODEFIRST_RESULT WriteAgentDataTypeCbor(SEND_PLAN* plan, SEND_BUFFER* buffer, const AGENT_DATA_TYPE* agentData)
+{
+    CODEFIRST_RESULT result;
+    CBOR_ENCODER_RESULT encoderResult;
+
+    /*Codes_SRS_CODEFIRST_41_026: [ CodeFirst_SendAsyncToBufferCbor shall write the keys of the map as text strings holding the property names, booleans as CBOR simple values, integers as CBOR integers, floating point values as CBOR floats, strings as text strings and binary values as byte strings. ]*/
+    switch (agentData->type)
+    {
+        case EDM_BOOLEAN_TYPE:
+        {
+            encoderResult = CBOREncoder_WriteBoolean(buffer->destination, buffer->capacity, &buffer->size, (agentData->value.edmBoolean.value == EDM_TRUE));
+            result = CODEFIRST_OK;
+            break;
+        }
+        case EDM_SBYTE_TYPE:
+        case EDM_BYTE_TYPE:
+        case EDM_INT16_TYPE:
+        case EDM_INT32_TYPE:
+        case EDM_INT64_TYPE:
+        {
+            int64_t value =
+                (agentData->type == EDM_SBYTE_TYPE) ? agentData->value.edmSbyte.value :
+                (agentData->type == EDM_BYTE_TYPE) ? agentData->value.edmByte.value :
+                (agentData->type == EDM_INT16_TYPE) ? agentData->value.edmInt16.value :
+                (agentData->type == EDM_INT32_TYPE) ? agentData->value.edmInt32.value :
+                agentData->value.edmInt64.value;
+            encoderResult = CBOREncoder_WriteInt64(buffer->destination, buffer->capacity, &buffer->size, value);
+            result = CODEFIRST_OK;
+            break;
+        }
+#ifndef NO_FLOATS
+        case EDM_DOUBLE_TYPE:
+        {
+            encoderResult = CBOREncoder_WriteDouble(buffer->destination, buffer->capacity, &buffer->size, agentData->value.edmDouble.value);
+            result = CODEFIRST_OK;
+            break;
+        }
+        case EDM_SINGLE_TYPE:
+        {
+            encoderResult = CBOREncoder_WriteDouble(buffer->destination, buffer->capacity, &buffer->size, (double)agentData->value.edmSingle.value);
+            result = CODEFIRST_OK;
+            break;
+        }
+#endif
+        case EDM_STRING_TYPE:
+        {
+            encoderResult = CBOREncoder_WriteTextString(buffer->destination, buffer->capacity, &buffer->size, agentData->value.edmString.chars, agentData->value.edmString.length);
+            result = CODEFIRST_OK;
+            break;
+        }
+        case EDM_STRING_NO_QUOTES_TYPE:
+        {
+            encoderResult = CBOREncoder_WriteTextString(buffer->destination, buffer->capacity, &buffer->size, agentData->value.edmStringNoQuotes.chars, agentData->value.edmStringNoQuotes.length);
+            result = CODEFIRST_OK;
+            break;
+        }
+        case EDM_BINARY_TYPE:
+        {
+            encoderResult = CBOREncoder_WriteByteString(buffer->destination, buffer->capacity, &buffer->size, agentData->value.edmBinary.data, agentData->value.edmBinary.size);
+            result = CODEFIRST_OK;
+            break;
+        }
+        default:
+        {
+            /*Codes_SRS_CODEFIRST_41_027: [ CodeFirst_SendAsyncToBufferCbor shall write the values of any other type as the text string of their JSON representation, without the enclosing quotation marks. ]*/
+            encoderResult = CBOR_ENCODER_OK;
+            if ((plan->scratch == NULL) &&
+                ((plan->scratch = STRING_new()) == NULL))
+            {
+                result = CODEFIRST_ERROR;
+            }
+            else if (STRING_empty(plan->scratch) != 0)
+            {
+                result = CODEFIRST_ERROR;
+            }
+            else if (AgentDataTypes_ToString(plan->scratch, agentData) != AGENT_DATA_TYPES_OK)
+            {
+                result = CODEFIRST_AGENT_DATA_TYPE_ERROR;
+            }
+            else
+            {
+                const char* text = STRING_c_str(plan->scratch);
+                size_t length = STRING_length(plan->scratch);
+
+                if ((length >= 2) && (text[0] == '"') && (text[length - 1] == '"'))
+                {
+                    text++;
+                    length -= 2;
+                }
+
+                encoderResult = CBOREncoder_WriteTextString(buffer->destination, buffer->capacity, &buffer->size, text, length);
+                result = CODEFIRST_OK;
+            }
+            break;
+        }
+    }
+
+    if ((result == CODEFIRST_OK) &&
+        (encoderResult != CBOR_ENCODER_OK))
+    {
+        /*Codes_SRS_CODEFIRST_41_028: [ If the CBOR does not fit in destinationCapacity bytes, CodeFirst_SendAsyncToBufferCbor shall return CODEFIRST_BUFFER_TOO_SMALL. ]*/
+        result = CODEFIRST_BUFFER_TOO_SMALL;
+    }
+
+    return result;
+}
+
+static CODEFIRST_RESULT WriteSendPlanEntry(SEND_PLAN* plan, SEND_PLAN_ENTRY* entry, unsigned char* deviceData, SEND_BUFFER* buffer)
+{
+    CODEFIRST_RESULT result;
+    AGENT_DATA_TYPE agentDataType;
+
+    if (entry->lastSend == plan->sendCount)
+    {
+        /*Codes_SRS_CODEFIRST_41_005: [ If a property is passed more than once, CodeFirst_SendAsyncToBuffer shall return CODEFIRST_INVALID_ARG. ]*/
+        result = CODEFIRST_INVALID_ARG;
+        LogError("property %s is passed more than once", entry->property->what.property.name);
+    }
+    else if (buffer->cbor ?
+        /*Codes_SRS_CODEFIRST_41_026: [ CodeFirst_SendAsyncToBufferCbor shall write the keys of the map as text strings holding the property names, booleans as CBOR simple values, integers as CBOR integers, floating point values as CBOR floats, strings as text strings and binary values as byte strings. ]*/
+        (CBOREncoder_WriteTextString(buffer->destination, buffer->capacity, &buffer->size, entry->property->what.property.name, entry->nameLength) != CBOR_ENCODER_OK) :
+        (
+            ((buffer->size > 1) && (AppendToSendBuffer(buffer, ", ", 2) != 0)) ||
+            (AppendToSendBuffer(buffer, "\"", 1) != 0) ||
+            (AppendToSendBuffer(buffer, entry->property->what.property.name, entry->nameLength) != 0) ||
+            (AppendToSendBuffer(buffer, "\":", 2) != 0)
+        )
+        )
+    {
+        /*Codes_SRS_CODEFIRST_41_007: [ If the JSON does not fit in destinationCapacity bytes, CodeFirst_SendAsyncToBuffer shall return CODEFIRST_BUFFER_TOO_SMALL. ]*/
+        /*Codes_SRS_CODEFIRST_41_028: [ If the CBOR does not fit in destinationCapacity bytes, CodeFirst_SendAsyncToBufferCbor shall return CODEFIRST_BUFFER_TOO_SMALL. ]*/
+        result = CODEFIRST_BUFFER_TOO_SMALL;
+    }
+    /*Codes_SRS_CODEFIRST_41_006: [ CodeFirst_SendAsyncToBuffer shall marshal each value by calling the Create_AGENT_DATA_TYPE_from_Ptr function associated with the property and write the value in place. ]*/
+    else if (entry->property->what.property.Create_AGENT_DATA_TYPE_from_Ptr(deviceData + entry->offset, &agentDataType) != AGENT_DATA_TYPES_OK)
+    {
+        /*Codes_SRS_CODEFIRST_41_008: [ If Create_AGENT_DATA_TYPE_from_Ptr fails, CodeFirst_SendAsyncToBuffer shall return CODEFIRST_AGENT_DATA_TYPE_ERROR. ]*/
+        result = CODEFIRST_AGENT_DATA_TYPE_ERROR;
+        LOG_CODEFIRST_ERROR;
+    }
+    else
+    {
+        result = buffer->cbor ?
+            WriteAgentDataTypeCbor(plan, buffer, &agentDataType) :
+            WriteAgentDataType(plan, buffer, &agentDataType);
+        Destroy_AGENT_DATA_TYPE(&agentDataType);
+        entry->lastSend = plan->sendCount;
+        buffer->pairCount++;
+    }
+
+    return result;
+}
+
+/*the map header is only known once all the properties are written: one byte is reserved up front and the header is
+widened at the end when the map has more than 23 pairs*/
+static CODEFIRST_RESULT FinishCborMap(SEND_BUFFER* buffer)
+{
+    CODEFIRST_RESULT result;
+    unsigned char header[CBOR_ENCODER_MAX_HEADER_SIZE];
+    size_t headerLength = 0;
+
+    if (CBOREncoder_WriteMapHeader(header, sizeof(header), &headerLength, buffer->pairCount) != CBOR_ENCODER_OK)
+    {
+        result = CODEFIRST_ERROR;
+    }
+    else if (buffer->capacity - buffer->size < headerLength - 1)
+    {
+        result = CODEFIRST_BUFFER_TOO_SMALL;
+    }
+    else
+    {
+        (void)memmove(buffer->destination + headerLength, buffer->destination + 1, buffer->size - 1);
+        (void)memcpy(buffer->destination, header, headerLength);
+        buffer->size += headerLength - 1;
+        result = CODEFIRST_OK;
+    }
+
+    return result;
+}
+
+static CODEFIRST_RESULT SendToBuffer(bool cbor, unsigned char* destination, size_t destinationCapacity, size_t* destinationSize, size_t numProperties, va_list ap)
+{
+    CODEFIRST_RESULT result;
+
+    /*Codes_SRS_CODEFIRST_41_001: [ If destination or destinationSize is NULL, or numProperties is 0, CodeFirst_SendAsyncToBuffer shall return CODEFIRST_INVALID_ARG. ]*/
+    if (
+        (numProperties == 0) ||
+        (destination == NULL) ||
+        (destinationSize == NULL)
+        )
+    {
+        result = CODEFIRST_INVALID_ARG;
+        LOG_CODEFIRST_ERROR;
+    }
+    else
+    {
+        DEVICE_HEADER_DATA* deviceHeader = NULL;
+        SEND_BUFFER buffer;
+        size_t i;
+
+        (void)CodeFirst_Init_impl(NULL, false); /*lazy init*/
+
+        buffer.destination = destination;
+        buffer.capacity = destinationCapacity;
+        buffer.size = 0;
+        buffer.cbor = cbor;
+        buffer.pairCount = 0;
+        result = CODEFIRST_OK;
+
+        for (i = 0; i < numProperties; i++)
+        {
+            unsigned char* value = (unsigned char*)va_arg(ap, void*);
+            DEVICE_HEADER_DATA* currentValueDeviceHeader = FindDevice(value);
+
+            if (currentValueDeviceHeader == NULL)
+            {
+                /*Codes_SRS_CODEFIRST_41_003: [ If a value is not a primitive property of the root model of a device, CodeFirst_SendAsyncToBuffer shall return CODEFIRST_INVALID_ARG. ]*/
+                result = CODEFIRST_INVALID_ARG;
+                LOG_CODEFIRST_ERROR;
+                break;
+            }
+            else if ((deviceHeader != NULL) &&
+                (currentValueDeviceHeader != deviceHeader))
+            {
+                /*Codes_SRS_CODEFIRST_41_004: [ All values have to belong to the same device, otherwise CodeFirst_SendAsyncToBuffer shall return CODEFIRST_VALUES_FROM_DIFFERENT_DEVICES_ERROR. ]*/
+                result = CODEFIRST_VALUES_FROM_DIFFERENT_DEVICES_ERROR;
+                LOG_CODEFIRST_ERROR;
+                break;
+            }
+            else if ((deviceHeader == NULL) &&
+                (currentValueDeviceHeader->SendPlan == NULL) &&
+                /*Codes_SRS_CODEFIRST_41_002: [ The first time a device is sent, CodeFirst_SendAsyncToBuffer shall build the list of its root model primitive properties and keep it until the device is destroyed. ]*/
+                ((currentValueDeviceHeader->SendPlan = CreateSendPlan(currentValueDeviceHeader)) == NULL))
+            {
+                result = CODEFIRST_ERROR;
+                LOG_CODEFIRST_ERROR;
+                break;
+            }
+            else
+            {
+                SEND_PLAN* plan = currentValueDeviceHeader->SendPlan;
+
+                if (deviceHeader == NULL)
+                {
+                    deviceHeader = currentValueDeviceHeader;
+                    plan->sendCount++;
+                    if (cbor ?
+                        (CBOREncoder_WriteMapHeader(destination, destinationCapacity, &buffer.size, 0) != CBOR_ENCODER_OK) :
+                        (AppendToSendBuffer(&buffer, "{", 1) != 0))
+                    {
+                        /*Codes_SRS_CODEFIRST_41_007: [ If the JSON does not fit in destinationCapacity bytes, CodeFirst_SendAsyncToBuffer shall return CODEFIRST_BUFFER_TOO_SMALL. ]*/
+                        /*Codes_SRS_CODEFIRST_41_028: [ If the CBOR does not fit in destinationCapacity bytes, CodeFirst_SendAsyncToBufferCbor shall return CODEFIRST_BUFFER_TOO_SMALL. ]*/
+                        result = CODEFIRST_BUFFER_TOO_SMALL;
+                        LOG_CODEFIRST_ERROR;
+                        break;
+                    }
+                }
+
+                if (value == deviceHeader->data)
+                {
+                    if (!plan->coversDevice)
+                    {
+                        /*Codes_SRS_CODEFIRST_41_003: [ If a value is not a primitive property of the root model of a device, CodeFirst_SendAsyncToBuffer shall return CODEFIRST_INVALID_ARG. ]*/
+                        result = CODEFIRST_INVALID_ARG;
+                        LogError("the device has properties that are not primitive, use SERIALIZE");
+                        break;
+                    }
+                    else
+                    {
+                        /*Codes_SRS_CODEFIRST_41_009: [ If a pointer to the beginning of a device block is passed, CodeFirst_SendAsyncToBuffer shall write all the properties of the device. ]*/
+                        size_t j;
+                        for (j = 0; j < plan->nEntries; j++)
+                        {
+                            if ((result = WriteSendPlanEntry(plan, &plan->entries[j], deviceHeader->data, &buffer)) != CODEFIRST_OK)
+                            {
+                                break;
+                            }
+                        }
+                    }
+                }
+                else
+                {
+                    size_t valueOffset = (size_t)(value - deviceHeader->data);
+                    size_t j;
+
+                    for (j = 0; j < plan->nEntries; j++)
+                    {
+                        if (plan->entries[j].offset == valueOffset)
+                        {
+                            break;
+                        }
+                    }
+
+                    if (j == plan->nEntries)
+                    {
+                        /*Codes_SRS_CODEFIRST_41_003: [ If a value is not a primitive property of the root model of a device, CodeFirst_SendAsyncToBuffer shall return CODEFIRST_INVALID_ARG. ]*/
+                        result = CODEFIRST_INVALID_ARG;
+                        LogError("the value is not a primitive property of the root model, use SERIALIZE");
+                    }
+                    else
+                    {
+                        result = WriteSendPlanEntry(plan, &plan->entries[j], deviceHeader->data, &buffer);
+                    }
+                }
+
+                if (result != CODEFIRST_OK)
+                {
+                    LOG_CODEFIRST_ERROR;
+                    break;
+                }
+            }
+        }
+
+        if (result == CODEFIRST_OK)
+        {
+            if (cbor)
+            {
+                /*Codes_SRS_CODEFIRST_41_029: [ The map written by CodeFirst_SendAsyncToBufferCbor shall have a definite length. ]*/
+                if ((result = FinishCborMap(&buffer)) != CODEFIRST_OK)
+                {
+                    /*Codes_SRS_CODEFIRST_41_028: [ If the CBOR does not fit in destinationCapacity bytes, CodeFirst_SendAsyncToBufferCbor shall return CODEFIRST_BUFFER_TOO_SMALL. ]*/
+                    LOG_CODEFIRST_ERROR;
+                }
+            }
+            else if (AppendToSendBuffer(&buffer, "}", 1) != 0)
+            {
+                /*Codes_SRS_CODEFIRST_41_007: [ If the JSON does not fit in destinationCapacity bytes, CodeFirst_SendAsyncToBuffer shall return CODEFIRST_BUFFER_TOO_SMALL. ]*/
+                result = CODEFIRST_BUFFER_TOO_SMALL;
+                LOG_CODEFIRST_ERROR;
+            }
+
+            if (result == CODEFIRST_OK)
+            {
+                /*Codes_SRS_CODEFIRST_41_010: [ On success, CodeFirst_SendAsyncToBuffer shall write the size of the JSON (which is not NUL terminated) in destinationSize and return CODEFIRST_OK. ]*/
+                /*Codes_SRS_CODEFIRST_41_030: [ On success, CodeFirst_SendAsyncToBufferCbor shall write the size of the CBOR in destinationSize and return CODEFIRST_OK. ]*/
+                *destinationSize = buffer.size;
+            }
+        }
+    }
+
+    return result;
+}
+
+/*writes one property of every device as a JSON array or a CBOR array, the plan is the one of the first device*/
+static CODEFIRST_RESULT WriteSendPlanColumn(SEND_PLAN* plan, SEND_PLAN_ENTRY* entry, DEVICE_HEADER_DATA* const* deviceHeaders, size_t deviceCount, SEND_BUFFER* buffer)
+{
+    CODEFIRST_RESULT result;
+
+    if (buffer->cbor ?
+        (
+            (CBOREncoder_WriteTextString(buffer->destination, buffer->capacity, &buffer->size, entry->property->what.property.name, entry->nameLength) != CBOR_ENCODER_OK) ||
+            (CBOREncoder_WriteArrayHeader(buffer->destination, buffer->capacity, &buffer->size, deviceCount) != CBOR_ENCODER_OK)
+        ) :
+        (
+            ((buffer->size > 1) && (AppendToSendBuffer(buffer, ", ", 2) != 0)) ||
+            (AppendToSendBuffer(buffer, "\"", 1) != 0) ||
+            (AppendToSendBuffer(buffer, entry->property->what.property.name, entry->nameLength) != 0) ||
+            (AppendToSendBuffer(buffer, "\":[", 3) != 0)
+        )
+        )
+    {
+        /*Codes_SRS_CODEFIRST_41_044: [ If the JSON or the CBOR does not fit in destinationCapacity bytes, CodeFirst_SendBatchToBuffer shall return CODEFIRST_BUFFER_TOO_SMALL. ]*/
+        result = CODEFIRST_BUFFER_TOO_SMALL;
+    }
+    else
+    {
+        size_t i;
+
+        result = CODEFIRST_OK;
+        for (i = 0; i < deviceCount; i++)
+        {
+            AGENT_DATA_TYPE agentDataType;
+
+            if ((!buffer->cbor) &&
+                (i > 0) &&
+                (AppendToSendBuffer(buffer, ",", 1) != 0))
+            {
+                /*Codes_SRS_CODEFIRST_41_044: [ If the JSON or the CBOR does not fit in destinationCapacity bytes, CodeFirst_SendBatchToBuffer shall return CODEFIRST_BUFFER_TOO_SMALL. ]*/
+                result = CODEFIRST_BUFFER_TOO_SMALL;
+                break;
+            }
+            /*Codes_SRS_CODEFIRST_41_042: [ CodeFirst_SendBatchToBuffer shall marshal each value by calling the Create_AGENT_DATA_TYPE_from_Ptr function associated with the property and write it in place as CodeFirst_SendAsyncToBuffer does. ]*/
+            else if (entry->property->what.property.Create_AGENT_DATA_TYPE_from_Ptr(deviceHeaders[i]->data + entry->offset, &agentDataType) != AGENT_DATA_TYPES_OK)
+            {
+                /*Codes_SRS_CODEFIRST_41_043: [ If Create_AGENT_DATA_TYPE_from_Ptr fails, CodeFirst_SendBatchToBuffer shall return CODEFIRST_AGENT_DATA_TYPE_ERROR. ]*/
+                result = CODEFIRST_AGENT_DATA_TYPE_ERROR;
+                break;
+            }
+            else
+            {
+                result = buffer->cbor ?
+                    WriteAgentDataTypeCbor(plan, buffer, &agentDataType) :
+                    WriteAgentDataType(plan, buffer, &agentDataType);
+                Destroy_AGENT_DATA_TYPE(&agentDataType);
+                if (result != CODEFIRST_OK)
+                {
+                    break;
+                }
+            }
+        }
+
+        if ((result == CODEFIRST_OK) &&
+            (!buffer->cbor) &&
+            (AppendToSendBuffer(buffer, "]", 1) != 0))
+        {
+            /*Codes_SRS_CODEFIRST_41_044: [ If the JSON or the CBOR does not fit in destinationCapacity bytes, CodeFirst_SendBatchToBuffer shall return CODEFIRST_BUFFER_TOO_SMALL. ]*/
+            result = CODEFIRST_BUFFER_TOO_SMALL;
+        }
+    }
+
+    return result;
+}
+
+static CODEFIRST_RESULT SendBatchToBuffer(bool cbor, unsigned char* destination, size_t destinationCapacity, size_t* destinationSize, void* const* devices, size_t deviceCount)
+{
+    CODEFIRST_RESULT result;
+    DEVICE_HEADER_DATA** deviceHeaders;
+
+    /*Codes_SRS_CODEFIRST_41_039: [ If destination, destinationSize or devices is NULL, or deviceCount is 0, CodeFirst_SendBatchToBuffer shall return CODEFIRST_INVALID_ARG. ]*/
+    if (
+        (destination == NULL) ||
+        (destinationSize == NULL) ||
+        (devices == NULL) ||
+        (deviceCount == 0)
+        )
+    {
+        result = CODEFIRST_INVALID_ARG;
+        LOG_CODEFIRST_ERROR;
+    }
+    else if ((deviceHeaders = (DEVICE_HEADER_DATA**)malloc(deviceCount * sizeof(DEVICE_HEADER_DATA*))) == NULL)
+    {
+        result = CODEFIRST_ERROR;
+        LOG_CODEFIRST_ERROR;
+    }
+    else
+    {
+        size_t i;
+
+        (void)CodeFirst_Init_impl(NULL, false); /*lazy init*/
+
+        result = CODEFIRST_OK;
+        for (i = 0; i < deviceCount; i++)
+        {
+            if (((deviceHeaders[i] = FindDevice(devices[i])) == NULL) ||
+                (deviceHeaders[i]->data != (unsigned char*)devices[i]))
+            {
+                /*Codes_SRS_CODEFIRST_41_040: [ If an element of devices is not a device created by CodeFirst_CreateDevice, or the root model of the devices has properties that are not primitive, CodeFirst_SendBatchToBuffer shall return CODEFIRST_INVALID_ARG. ]*/
+                result = CODEFIRST_INVALID_ARG;
+                LogError("devices[%lu] is not a device", (unsigned long)i);
+                break;
+            }
+            else if (deviceHeaders[i]->ModelHandle != deviceHeaders[0]->ModelHandle)
+            {
+                /*Codes_SRS_CODEFIRST_41_041: [ If the devices are not all of the same model, CodeFirst_SendBatchToBuffer shall return CODEFIRST_VALUES_FROM_DIFFERENT_DEVICES_ERROR. ]*/
+                result = CODEFIRST_VALUES_FROM_DIFFERENT_DEVICES_ERROR;
+                LOG_CODEFIRST_ERROR;
+                break;
+            }
+        }
+
+        if (result == CODEFIRST_OK)
+        {
+            SEND_PLAN* plan;
+
+            if ((deviceHeaders[0]->SendPlan == NULL) &&
+                /*Codes_SRS_CODEFIRST_41_002: [ The first time a device is sent, CodeFirst_SendAsyncToBuffer shall build the list of its root model primitive properties and keep it until the device is destroyed. ]*/
+                ((deviceHeaders[0]->SendPlan = CreateSendPlan(deviceHeaders[0])) == NULL))
+            {
+                result = CODEFIRST_ERROR;
+                LOG_CODEFIRST_ERROR;
+            }
+            else if (!(plan = deviceHeaders[0]->SendPlan)->coversDevice)
+            {
+                /*Codes_SRS_CODEFIRST_41_040: [ If an element of devices is not a device created by CodeFirst_CreateDevice, or the root model of the devices has properties that are not primitive, CodeFirst_SendBatchToBuffer shall return CODEFIRST_INVALID_ARG. ]*/
+                result = CODEFIRST_INVALID_ARG;
+                LogError("the devices have properties that are not primitive, use SERIALIZE");
+            }
+            else
+            {
+                SEND_BUFFER buffer;
+
+                buffer.destination = destination;
+                buffer.capacity = destinationCapacity;
+                buffer.size = 0;
+                buffer.cbor = cbor;
+                buffer.pairCount = plan->nEntries;
+
+                /*Codes_SRS_CODEFIRST_41_045: [ CodeFirst_SendBatchToBuffer shall write an object with, for every primitive property of the model, the property name and an array of its value in each device, in the order of devices. ]*/
+                if (cbor ?
+                    (CBOREncoder_WriteMapHeader(destination, destinationCapacity, &buffer.size, plan->nEntries) != CBOR_ENCODER_OK) :
+                    (AppendToSendBuffer(&buffer, "{", 1) != 0))
+                {
+                    /*Codes_SRS_CODEFIRST_41_044: [ If the JSON or the CBOR does not fit in destinationCapacity bytes, CodeFirst_SendBatchToBuffer shall return CODEFIRST_BUFFER_TOO_SMALL. ]*/
+                    result = CODEFIRST_BUFFER_TOO_SMALL;
+                }
+                else
+                {
+                    for (i = 0; i < plan->nEntries; i++)
+                    {
+                        if ((result = WriteSendPlanColumn(plan, &plan->entries[i], deviceHeaders, deviceCount, &buffer)) != CODEFIRST_OK)
+                        {
+                            break;
+                        }
+                    }
+
+                    if ((result == CODEFIRST_OK) &&
+                        (!cbor) &&
+                        (AppendToSendBuffer(&buffer, "}", 1) != 0))
+                    {
+                        /*Codes_SRS_CODEFIRST_41_044: [ If the JSON or the CBOR does not fit in destinationCapacity bytes, CodeFirst_SendBatchToBuffer shall return CODEFIRST_BUFFER_TOO_SMALL. ]*/
+                        result = CODEFIRST_BUFFER_TOO_SMALL;
+                    }
+                }
+
+                if (result != CODEFIRST_OK)
+                {
+                    LOG_CODEFIRST_ERROR;
+                }
+                else
+                {
+                    /*Codes_SRS_CODEFIRST_41_046: [ On success, CodeFirst_SendBatchToBuffer shall write the size of the JSON (which is not NUL terminated) in destinationSize and return CODEFIRST_OK. ]*/
+                    *destinationSize = buffer.size;
+                }
+            }
+        }
+
+        free(deviceHeaders);
+    }
+
+    return result;
+}
+
+CODEFIRST_RESULT CodeFirst_SendAsyncToBuffer(unsigned char* destination, size_t destinationCapacity, size_t* destinationSize, size_t numProperties, ...)
+{
+    CODEFIRST_RESULT result;
+    va_list ap;
+
+    va_start(ap, numProperties);
+    result = SendToBuffer(false, destination, destinationCapacity, destinationSize, numProperties, ap);
+    va_end(ap);
+
+    return result;
+}
+
+CODEFIRST_RESULT CodeFirst_SendAsyncToBufferCbor(unsigned char* destination, size_t destinationCapacity, size_t* destinationSize, size_t numProperties, ...)
+{
+    CODEFIRST_RESULT result;
+    va_list ap;
+
+    /*Codes_SRS_CODEFIRST_41_025: [ CodeFirst_SendAsyncToBufferCbor shall validate its arguments, find the values and fail exactly as CodeFirst_SendAsyncToBuffer does, but write the properties as a CBOR (RFC 7049) map instead of a JSON object. ]*/
+    va_start(ap, numProperties);
+    result = SendToBuffer(true, destination, destinationCapacity, destinationSize, numProperties, ap);
+    va_end(ap);
+
+    return result;
+}
+
+CODEFIRST_RESULT CodeFirst_SendBatchToBuffer(unsigned char* destination, size_t destinationCapacity, size_t* destinationSize, void* const* devices, size_t deviceCount)
+{
+    return SendBatchToBuffer(false, destination, destinationCapacity, destinationSize, devices, deviceCount);
+}
+
+CODEFIRST_RESULT CodeFirst_SendBatchToBufferCbor(unsigned char* destination, size_t destinationCapacity, size_t* destinationSize, void* const* devices, size_t deviceCount)
+{
+    /*Codes_SRS_CODEFIRST_41_047: [ CodeFirst_SendBatchToBufferCbor shall validate its arguments and fail exactly as CodeFirst_SendBatchToBuffer does, but write a CBOR map of CBOR arrays, with the values encoded as CodeFirst_SendAsyncToBufferCbor does. ]*/
+    return SendBatchToBuffer(true, destination, destinationCapacity, destinationSize, devices, deviceCount);
+}
+
+CODEFIRST_RESULT CodeFirst_SendAsyncReported(unsigned char** destination, size_t* destinationSize, size_t numReportedProperties, ...)
+{
+    CODEFIRST_RESULT result;
+    if ((destination == NULL) || (destinationSize == NULL) || numReportedProperties == 0)
+    {
         /*Codes_SRS_CODEFIRST_02_018: [ If parameter destination, destinationSize or any of the values passed through va_args is NULL then CodeFirst_SendAsyncReported shall fail and return CODEFIRST_INVALID_ARG. ]*/
         LogError("invalid argument unsigned char** destination=%p, size_t* destinationSize=%p, size_t numReportedProperties=%lu", destination, destinationSize, (unsigned long)numReportedProperties);
         result = CODEFIRST_INVALID_ARG;
@@ -1426,7 +2711,7 @@ CODEFIRST_RESULT CodeFirst_SendAsyncReported(unsigned char** destination, size_t
                     if (value == ((unsigned char*)deviceHeader->data))
                     {
                         /*Codes_SRS_CODEFIRST_02_021: [ If the value passed through va_args is a complete model instance, then CodeFirst_SendAsyncReported shall send all the reported properties of that device. ]*/
-                        result = SendAllDeviceReportedProperties(deviceHeader, transaction);
+                        result = SendAllDeviceReportedProperties(deviceHeader, transaction, NULL);
                         if (result != CODEFIRST_OK)
                         {
                             LOG_CODEFIRST_ERROR;
@@ -1451,7 +2736,7 @@ CODEFIRST_RESULT CodeFirst_SendAsyncReported(unsigned char** destination, size_t
                             modelName = Schema_GetModelName(deviceHeader->ModelHandle);
 
                             /*Codes_SRS_CODEFIRST_02_025: [ CodeFirst_SendAsyncReported shall compute for every AGENT_DATA_TYPE the valuePath. ]*/
-                            if ((propertyReflectedData = FindReportedProperty(deviceHeader, value, modelName, 0, valuePath)) == NULL)
+                            if ((propertyReflectedData = FindReportedProperty(deviceHeader, value, modelName, valuePath)) == NULL)
                             {
                                 result = CODEFIRST_INVALID_ARG;
                                 LOG_CODEFIRST_ERROR;
@@ -1524,6 +2809,125 @@ CODEFIRST_RESULT CodeFirst_SendAsyncReported(unsigned char** destination, size_t
     return result;
 }
 
+CODEFIRST_RESULT CodeFirst_SendAsyncReportedChanges(unsigned char** destination, size_t* destinationSize, void* device)
+{
+    CODEFIRST_RESULT result;
+    if ((destination == NULL) || (destinationSize == NULL) || (device == NULL))
+    {
+        /*Codes_SRS_CODEFIRST_41_011: [ If parameter destination, destinationSize or device is NULL then CodeFirst_SendAsyncReportedChanges shall fail and return CODEFIRST_INVALID_ARG. ]*/
+        LogError("invalid argument unsigned char** destination=%p, size_t* destinationSize=%p, void* device=%p", destination, destinationSize, device);
+        result = CODEFIRST_INVALID_ARG;
+    }
+    else
+    {
+        DEVICE_HEADER_DATA* deviceHeader;
+
+        (void)CodeFirst_Init_impl(NULL, false);/*lazy init*/
+
+        deviceHeader = FindDevice(device);
+        if ((deviceHeader == NULL) || (device != deviceHeader->data))
+        {
+            /*Codes_SRS_CODEFIRST_41_012: [ If device is not a complete model instance created by CodeFirst_CreateDevice then CodeFirst_SendAsyncReportedChanges shall fail and return CODEFIRST_INVALID_ARG. ]*/
+            result = CODEFIRST_INVALID_ARG;
+            LOG_CODEFIRST_ERROR;
+        }
+        else
+        {
+            /*Codes_SRS_CODEFIRST_41_014: [ When there is no previous successful call, CodeFirst_SendAsyncReportedChanges shall publish all the reported properties of the device. ]*/
+            const unsigned char* previousData = deviceHeader->ReportedShadow;
+            bool isNewShadow = (previousData == NULL);
+
+            if (isNewShadow &&
+                ((deviceHeader->ReportedShadow = (unsigned char*)malloc(deviceHeader->DataSize)) == NULL))
+            {
+                /*Codes_SRS_CODEFIRST_41_017: [ If any error occurs, CodeFirst_SendAsyncReportedChanges shall fail and return CODEFIRST_ERROR, CODEFIRST_AGENT_DATA_TYPE_ERROR or CODEFIRST_DEVICE_PUBLISH_FAILED. ]*/
+                result = CODEFIRST_ERROR;
+                LOG_CODEFIRST_ERROR;
+            }
+            else
+            {
+                REPORTED_PROPERTIES_TRANSACTION_HANDLE transaction;
+                if ((transaction = Device_CreateTransaction_ReportedProperties(deviceHeader->DeviceHandle)) == NULL)
+                {
+                    result = CODEFIRST_DEVICE_PUBLISH_FAILED;
+                    LOG_CODEFIRST_ERROR;
+                }
+                else
+                {
+                    if ((result = SendAllDeviceReportedProperties(deviceHeader, transaction, previousData)) != CODEFIRST_OK)
+                    {
+                        LOG_CODEFIRST_ERROR;
+                    }
+                    else if (Device_CommitTransaction_ReportedProperties(transaction, destination, destinationSize) != DEVICE_OK)
+                    {
+                        result = CODEFIRST_DEVICE_PUBLISH_FAILED;
+                        LOG_CODEFIRST_ERROR;
+                    }
+                    else
+                    {
+                        /*Codes_SRS_CODEFIRST_41_015: [ On success, CodeFirst_SendAsyncReportedChanges shall remember the current values of the reported properties and return CODEFIRST_OK. ]*/
+                        UpdateReportedShadow(deviceHeader, previousData);
+                    }
+
+                    Device_DestroyTransaction_ReportedProperties(transaction);
+                }
+
+                if ((result != CODEFIRST_OK) && isNewShadow)
+                {
+                    free(deviceHeader->ReportedShadow);
+                    deviceHeader->ReportedShadow = NULL;
+                }
+            }
+        }
+    }
+    return result;
+}
+
+void CodeFirst_ResetReportedChanges(void* device)
+{
+    DEVICE_HEADER_DATA* deviceHeader;
+    if (device == NULL)
+    {
+        /*Codes_SRS_CODEFIRST_41_018: [ If parameter device is NULL then CodeFirst_ResetReportedChanges shall return. ]*/
+        LogError("invalid argument void* device=%p", device);
+    }
+    else if ((deviceHeader = FindDevice(device)) == NULL)
+    {
+        LogError("device %p does not belong to any device created by CodeFirst_CreateDevice", device);
+    }
+    else
+    {
+        /*Codes_SRS_CODEFIRST_41_016: [ CodeFirst_ResetReportedChanges shall forget the values remembered by CodeFirst_SendAsyncReportedChanges so that the next call publishes all the reported properties of the device. ]*/
+        free(deviceHeader->ReportedShadow);
+        deviceHeader->ReportedShadow = NULL;
+    }
+}
+
+CODEFIRST_RESULT CodeFirst_SetReportedChangesDeadband(void* device, double deadband)
+{
+    CODEFIRST_RESULT result;
+    DEVICE_HEADER_DATA* deviceHeader;
+    if ((device == NULL) || !(deadband >= 0))
+    {
+        /*Codes_SRS_CODEFIRST_41_035: [ If parameter device is NULL or deadband is negative or not a number then CodeFirst_SetReportedChangesDeadband shall fail and return CODEFIRST_INVALID_ARG. ]*/
+        LogError("invalid argument void* device=%p, double deadband=%f", device, deadband);
+        result = CODEFIRST_INVALID_ARG;
+    }
+    else if (((deviceHeader = FindDevice(device)) == NULL) || (device != deviceHeader->data))
+    {
+        /*Codes_SRS_CODEFIRST_41_037: [ If device is not a complete model instance created by CodeFirst_CreateDevice then CodeFirst_SetReportedChangesDeadband shall fail and return CODEFIRST_INVALID_ARG. ]*/
+        result = CODEFIRST_INVALID_ARG;
+        LOG_CODEFIRST_ERROR;
+    }
+    else
+    {
+        /*Codes_SRS_CODEFIRST_41_038: [ CodeFirst_SetReportedChangesDeadband shall set the deadband used by the next calls to CodeFirst_SendAsyncReportedChanges for device, 0 only skipping the values that did not change, and return CODEFIRST_OK. ]*/
+        deviceHeader->ReportedDeadband = deadband;
+        result = CODEFIRST_OK;
+    }
+    return result;
+}
+
 EXECUTE_COMMAND_RESULT CodeFirst_ExecuteCommand(void* device, const char* command)
 {
     EXECUTE_COMMAND_RESULT result;
@@ -1623,4 +3027,46 @@ CODEFIRST_RESULT CodeFirst_IngestDesiredProperties(void* device, const char* jso
     return result;
 }
 
+CODEFIRST_RESULT CodeFirst_IngestDesiredPropertiesCbor(void* device, const unsigned char* cborPayload, size_t cborPayloadSize, bool parseDesiredNode)
+{
+    CODEFIRST_RESULT result;
+    /*Codes_SRS_CODEFIRST_41_031: [ If device or cborPayload is NULL, or cborPayloadSize is 0, CodeFirst_IngestDesiredPropertiesCbor shall fail and return CODEFIRST_INVALID_ARG. ]*/
+    if (
+        (device == NULL) ||
+        (cborPayload == NULL) ||
+        (cborPayloadSize == 0)
+        )
+    {
+        LogError("invalid argument void* device=%p, const unsigned char* cborPayload=%p, size_t cborPayloadSize=%lu", device, cborPayload, (unsigned long)cborPayloadSize);
+        result = CODEFIRST_INVALID_ARG;
+    }
+    else
+    {
+        STRING_HANDLE jsonPayload = STRING_new();
+        if (jsonPayload == NULL)
+        {
+            /*Codes_SRS_CODEFIRST_41_034: [ If there is any failure, then CodeFirst_IngestDesiredPropertiesCbor shall fail and return CODEFIRST_ERROR. ]*/
+            LogError("failure in STRING_new");
+            result = CODEFIRST_ERROR;
+        }
+        else
+        {
+            /*Codes_SRS_CODEFIRST_41_032: [ CodeFirst_IngestDesiredPropertiesCbor shall convert cborPayload to JSON by calling CBORDecoder_ToJSON. ]*/
+            if (CBORDecoder_ToJSON(cborPayload, cborPayloadSize, jsonPayload) != CBOR_DECODER_OK)
+            {
+                /*Codes_SRS_CODEFIRST_41_034: [ If there is any failure, then CodeFirst_IngestDesiredPropertiesCbor shall fail and return CODEFIRST_ERROR. ]*/
+                LogError("failure in CBORDecoder_ToJSON");
+                result = CODEFIRST_ERROR;
+            }
+            else
+            {
+                /*Codes_SRS_CODEFIRST_41_033: [ CodeFirst_IngestDesiredPropertiesCbor shall ingest the JSON as CodeFirst_IngestDesiredProperties does and return its result. ]*/
+                result = CodeFirst_IngestDesiredProperties(device, STRING_c_str(jsonPayload), parseDesiredNode);
+            }
+            STRING_delete(jsonPayload);
+        }
+    }
+    return result;
+}
+
 
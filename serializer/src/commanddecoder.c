@@ -6,6 +6,8 @@
 #include "azure_c_shared_utility/gballoc.h"
 
 #include <stddef.h>
+#include <stdint.h>
+#include <string.h>
 
 #include "commanddecoder.h"
 #include "multitree.h"
@@ -17,6 +19,28 @@
 
 DEFINE_ENUM_STRINGS(COMMANDDECODER_RESULT, COMMANDDECODER_RESULT_VALUES);
 
+/*routes are chained in PathHash % COMMAND_DECODER_ROUTE_BUCKET_COUNT buckets*/
+#define COMMAND_DECODER_ROUTE_BUCKET_COUNT 16
+
+typedef struct COMMAND_DECODER_ROUTE_ARGUMENT_TAG
+{
+    const char* Name; /*owned by the schema*/
+    const char* Type; /*owned by the schema*/
+} COMMAND_DECODER_ROUTE_ARGUMENT;
+
+/*a route remembers where an action or method path that has been dispatched once leads, so dispatching it again needs neither splitting the path nor schema lookups*/
+typedef struct COMMAND_DECODER_ROUTE_TAG
+{
+    struct COMMAND_DECODER_ROUTE_TAG* NextInBucket;
+    uint32_t PathHash;
+    size_t PathLength;
+    const char* Path; /*"childModel1/.../childModelN/name", Name points to its last segment*/
+    const char* RelativePath; /*"childModel1/.../childModelN"*/
+    const char* Name;
+    size_t ArgCount;
+    COMMAND_DECODER_ROUTE_ARGUMENT* Arguments; /*in declaration order*/
+} COMMAND_DECODER_ROUTE;
+
 typedef struct COMMAND_DECODER_HANDLE_DATA_TAG
 {
     METHOD_CALLBACK_FUNC methodCallback;
@@ -24,8 +48,93 @@ typedef struct COMMAND_DECODER_HANDLE_DATA_TAG
     SCHEMA_MODEL_TYPE_HANDLE ModelHandle;
     ACTION_CALLBACK_FUNC ActionCallback;
     void* ActionCallbackContext;
+    /*routes are only added from the thread that dispatches commands and methods, which is also the only one reading them*/
+    COMMAND_DECODER_ROUTE* ActionRoutes[COMMAND_DECODER_ROUTE_BUCKET_COUNT];
+    COMMAND_DECODER_ROUTE* MethodRoutes[COMMAND_DECODER_ROUTE_BUCKET_COUNT];
 } COMMAND_DECODER_HANDLE_DATA;
 
+static uint32_t HashPath(const char* path, size_t pathLength)
+{
+    uint32_t result = 2166136261u;
+    size_t i;
+    for (i = 0; i < pathLength; i++)
+    {
+        result ^= (unsigned char)path[i];
+        result *= 16777619u;
+    }
+    return result;
+}
+
+static COMMAND_DECODER_ROUTE* FindRoute(COMMAND_DECODER_ROUTE* const* buckets, const char* path, size_t pathLength)
+{
+    uint32_t pathHash = HashPath(path, pathLength);
+    COMMAND_DECODER_ROUTE* result = buckets[pathHash % COMMAND_DECODER_ROUTE_BUCKET_COUNT];
+    while ((result != NULL) &&
+        ((result->PathHash != pathHash) || (result->PathLength != pathLength) || (memcmp(result->Path, path, pathLength) != 0)))
+    {
+        result = result->NextInBucket;
+    }
+    return result;
+}
+
+/*the route, its arguments and its strings are a single allocation, the arguments are left for the caller to fill*/
+static COMMAND_DECODER_ROUTE* CreateRoute(const char* relativePath, const char* name, size_t argCount)
+{
+    COMMAND_DECODER_ROUTE* result;
+    size_t relativePathLength = strlen(relativePath);
+    size_t nameLength = strlen(name);
+    size_t pathLength = (relativePathLength == 0) ? nameLength : (relativePathLength + 1 + nameLength);
+
+    if ((result = (COMMAND_DECODER_ROUTE*)malloc(sizeof(COMMAND_DECODER_ROUTE) + argCount * sizeof(COMMAND_DECODER_ROUTE_ARGUMENT) + pathLength + 1 + relativePathLength + 1)) == NULL)
+    {
+        LogError("failure in malloc");
+        /*return as is*/
+    }
+    else
+    {
+        char* path = (char*)(result + 1) + argCount * sizeof(COMMAND_DECODER_ROUTE_ARGUMENT);
+        char* relativePathCopy = path + pathLength + 1;
+
+        if (relativePathLength > 0)
+        {
+            (void)memcpy(path, relativePath, relativePathLength);
+            path[relativePathLength] = '/';
+        }
+        (void)memcpy(path + pathLength - nameLength, name, nameLength + 1);
+        (void)memcpy(relativePathCopy, relativePath, relativePathLength + 1);
+
+        result->NextInBucket = NULL;
+        result->PathHash = HashPath(path, pathLength);
+        result->PathLength = pathLength;
+        result->Path = path;
+        result->RelativePath = relativePathCopy;
+        result->Name = path + pathLength - nameLength;
+        result->ArgCount = argCount;
+        result->Arguments = (COMMAND_DECODER_ROUTE_ARGUMENT*)(result + 1);
+    }
+    return result;
+}
+
+static void InsertRoute(COMMAND_DECODER_ROUTE** buckets, COMMAND_DECODER_ROUTE* route)
+{
+    route->NextInBucket = buckets[route->PathHash % COMMAND_DECODER_ROUTE_BUCKET_COUNT];
+    buckets[route->PathHash % COMMAND_DECODER_ROUTE_BUCKET_COUNT] = route;
+}
+
+static void DestroyRoutes(COMMAND_DECODER_ROUTE** buckets)
+{
+    size_t i;
+    for (i = 0; i < COMMAND_DECODER_ROUTE_BUCKET_COUNT; i++)
+    {
+        while (buckets[i] != NULL)
+        {
+            COMMAND_DECODER_ROUTE* next = buckets[i]->NextInBucket;
+            free(buckets[i]);
+            buckets[i] = next;
+        }
+    }
+}
+
 static int DecodeValueFromNode(SCHEMA_HANDLE schemaHandle, AGENT_DATA_TYPE* agentDataType, MULTITREE_HANDLE node, const char* edmTypeName)
 {
     /* because "pottentially uninitialized variable on MS compiler" */
@@ -169,6 +278,78 @@ static int DecodeValueFromNode(SCHEMA_HANDLE schemaHandle, AGENT_DATA_TYPE* agen
     return result;
 }
 
+static void AddActionRoute(COMMAND_DECODER_HANDLE_DATA* commandDecoderInstance, SCHEMA_ACTION_HANDLE modelActionHandle, const char* relativeActionPath, const char* actionName, size_t argCount)
+{
+    /*Codes_SRS_COMMAND_DECODER_41_005: [ After an action or a method has been dispatched successfully for the first time, CommandDecoder shall remember its full path, relative path, name and the names and types of its arguments in declaration order. ]*/
+    COMMAND_DECODER_ROUTE* route = CreateRoute(relativeActionPath, actionName, argCount);
+    if (route == NULL)
+    {
+        /*Codes_SRS_COMMAND_DECODER_41_006: [ If remembering the route fails, the result of the dispatch shall not change and the path shall be resolved again the next time it is dispatched. ]*/
+        LogError("unable to remember the route of action %s", actionName);
+    }
+    else
+    {
+        size_t i;
+        for (i = 0; i < argCount; i++)
+        {
+            SCHEMA_ACTION_ARGUMENT_HANDLE actionArgumentHandle;
+            if (((actionArgumentHandle = Schema_GetModelActionArgumentByIndex(modelActionHandle, i)) == NULL) ||
+                ((route->Arguments[i].Name = Schema_GetActionArgumentName(actionArgumentHandle)) == NULL) ||
+                ((route->Arguments[i].Type = Schema_GetActionArgumentType(actionArgumentHandle)) == NULL))
+            {
+                break;
+            }
+        }
+
+        if (i < argCount)
+        {
+            /*Codes_SRS_COMMAND_DECODER_41_006: [ If remembering the route fails, the result of the dispatch shall not change and the path shall be resolved again the next time it is dispatched. ]*/
+            LogError("unable to remember the route of action %s", actionName);
+            free(route);
+        }
+        else
+        {
+            InsertRoute(commandDecoderInstance->ActionRoutes, route);
+        }
+    }
+}
+
+static void AddMethodRoute(COMMAND_DECODER_HANDLE_DATA* commandDecoderInstance, SCHEMA_METHOD_HANDLE modelMethodHandle, const char* relativeMethodPath, const char* methodName, size_t argCount)
+{
+    /*Codes_SRS_COMMAND_DECODER_41_005: [ After an action or a method has been dispatched successfully for the first time, CommandDecoder shall remember its full path, relative path, name and the names and types of its arguments in declaration order. ]*/
+    COMMAND_DECODER_ROUTE* route = CreateRoute(relativeMethodPath, methodName, argCount);
+    if (route == NULL)
+    {
+        /*Codes_SRS_COMMAND_DECODER_41_006: [ If remembering the route fails, the result of the dispatch shall not change and the path shall be resolved again the next time it is dispatched. ]*/
+        LogError("unable to remember the route of method %s", methodName);
+    }
+    else
+    {
+        size_t i;
+        for (i = 0; i < argCount; i++)
+        {
+            SCHEMA_METHOD_ARGUMENT_HANDLE methodArgumentHandle;
+            if (((methodArgumentHandle = Schema_GetModelMethodArgumentByIndex(modelMethodHandle, i)) == NULL) ||
+                ((route->Arguments[i].Name = Schema_GetMethodArgumentName(methodArgumentHandle)) == NULL) ||
+                ((route->Arguments[i].Type = Schema_GetMethodArgumentType(methodArgumentHandle)) == NULL))
+            {
+                break;
+            }
+        }
+
+        if (i < argCount)
+        {
+            /*Codes_SRS_COMMAND_DECODER_41_006: [ If remembering the route fails, the result of the dispatch shall not change and the path shall be resolved again the next time it is dispatched. ]*/
+            LogError("unable to remember the route of method %s", methodName);
+            free(route);
+        }
+        else
+        {
+            InsertRoute(commandDecoderInstance->MethodRoutes, route);
+        }
+    }
+}
+
 static EXECUTE_COMMAND_RESULT DecodeAndExecuteModelAction(COMMAND_DECODER_HANDLE_DATA* commandDecoderInstance, SCHEMA_HANDLE schemaHandle, SCHEMA_MODEL_TYPE_HANDLE modelHandle, const char* relativeActionPath, const char* actionName, MULTITREE_HANDLE commandNode)
 {
     EXECUTE_COMMAND_RESULT result;
@@ -276,6 +457,11 @@ static EXECUTE_COMMAND_RESULT DecodeAndExecuteModelAction(COMMAND_DECODER_HANDLE
                     {
                         /* Codes_SRS_COMMAND_DECODER_99_005:[ If an Invoke Action is decoded successfully then the callback actionCallback shall be called, passing to it the callback action context, decoded name and arguments.] */
                         result = commandDecoderInstance->ActionCallback(commandDecoderInstance->ActionCallbackContext, relativeActionPath, tempStr, argCount, arguments);
+
+                        if (result == EXECUTE_COMMAND_SUCCESS)
+                        {
+                            AddActionRoute(commandDecoderInstance, modelActionHandle, relativeActionPath, tempStr, argCount);
+                        }
                     }
 
                     for (j = 0; j < i; j++)
@@ -330,6 +516,11 @@ static METHODRETURN_HANDLE DecodeAndExecuteModelMethod(COMMAND_DECODER_HANDLE_DA
             {
                 /*no need for any parameters*/
                 result = commandDecoderInstance->methodCallback(commandDecoderInstance->methodCallbackContext, relativeMethodPath, methodName, 0, NULL);
+
+                if (result != NULL)
+                {
+                    AddMethodRoute(commandDecoderInstance, modelMethodHandle, relativeMethodPath, methodName, 0);
+                }
             }
             else
             {
@@ -383,6 +574,11 @@ static METHODRETURN_HANDLE DecodeAndExecuteModelMethod(COMMAND_DECODER_HANDLE_DA
                         /*Codes_SRS_COMMAND_DECODER_02_022: [ CommandDecoder_ExecuteMethod shall call methodCallback passing the context, the methodName, number of arguments and the AGENT_DATA_TYPE. ]*/
                         /*Codes_SRS_COMMAND_DECODER_02_024: [ Otherwise, CommandDecoder_ExecuteMethod shall return what methodCallback returns. ]*/
                         result = commandDecoderInstance->methodCallback(commandDecoderInstance->methodCallbackContext, relativeMethodPath, methodName, argCount, arguments);
+
+                        if (result != NULL)
+                        {
+                            AddMethodRoute(commandDecoderInstance, modelMethodHandle, relativeMethodPath, methodName, argCount);
+                        }
                     }
 
                     for (j = 0; j < i; j++)
@@ -401,6 +597,114 @@ static METHODRETURN_HANDLE DecodeAndExecuteModelMethod(COMMAND_DECODER_HANDLE_DA
 }
 
 
+/*decodes the arguments of route from the children of argumentsNode, returns how many have been decoded*/
+static size_t DecodeRouteArguments(SCHEMA_HANDLE schemaHandle, const COMMAND_DECODER_ROUTE* route, MULTITREE_HANDLE argumentsNode, AGENT_DATA_TYPE* arguments)
+{
+    size_t i;
+    for (i = 0; i < route->ArgCount; i++)
+    {
+        MULTITREE_HANDLE argumentNode;
+        if (MultiTree_GetChildByName(argumentsNode, route->Arguments[i].Name, &argumentNode) != MULTITREE_OK)
+        {
+            LogError("Missing argument %s", route->Arguments[i].Name);
+            break;
+        }
+        else if (DecodeValueFromNode(schemaHandle, &arguments[i], argumentNode, route->Arguments[i].Type) != 0)
+        {
+            LogError("failure in DecodeValueFromNode");
+            break;
+        }
+    }
+    return i;
+}
+
+static EXECUTE_COMMAND_RESULT ExecuteActionRoute(COMMAND_DECODER_HANDLE_DATA* commandDecoderInstance, SCHEMA_HANDLE schemaHandle, const COMMAND_DECODER_ROUTE* route, MULTITREE_HANDLE commandNode)
+{
+    EXECUTE_COMMAND_RESULT result;
+    MULTITREE_HANDLE parametersTreeNode;
+    AGENT_DATA_TYPE* arguments = NULL;
+
+    if (MultiTree_GetChildByName(commandNode, "Parameters", &parametersTreeNode) != MULTITREE_OK)
+    {
+        /* Codes_SRS_COMMAND_DECODER_01_015: [If any MultiTree API call fails then the processing shall stop and the command shall not be dispatched and it shall return EXECUTE_COMMAND_ERROR.] */
+        LogError("Error getting Parameters node.");
+        result = EXECUTE_COMMAND_ERROR;
+    }
+    else if ((route->ArgCount > 0) &&
+        ((arguments = (AGENT_DATA_TYPE*)malloc(sizeof(AGENT_DATA_TYPE) * route->ArgCount)) == NULL))
+    {
+        /* Codes_SRS_COMMAND_DECODER_99_021:[ If the parsing of the command fails for any other reason the command shall not be dispatched.] */
+        LogError("Failed allocating arguments array");
+        result = EXECUTE_COMMAND_ERROR;
+    }
+    else
+    {
+        size_t j;
+        size_t nDecoded = DecodeRouteArguments(schemaHandle, route, parametersTreeNode, arguments);
+        if (nDecoded == route->ArgCount)
+        {
+            /*Codes_SRS_COMMAND_DECODER_41_007: [ When a remembered path is dispatched again, CommandDecoder shall decode the arguments and call the callback using the remembered route, without splitting the path and without Schema lookups. ]*/
+            result = commandDecoderInstance->ActionCallback(commandDecoderInstance->ActionCallbackContext, route->RelativePath, route->Name, route->ArgCount, arguments);
+        }
+        else
+        {
+            /* Codes_SRS_COMMAND_DECODER_99_012:[ If any argument is missing in the command text then the command shall not be dispatched and it shall return EXECUTE_COMMAND_ERROR.] */
+            result = EXECUTE_COMMAND_ERROR;
+        }
+
+        for (j = 0; j < nDecoded; j++)
+        {
+            Destroy_AGENT_DATA_TYPE(&arguments[j]);
+        }
+
+        if (arguments != NULL)
+        {
+            free(arguments);
+        }
+    }
+    return result;
+}
+
+static METHODRETURN_HANDLE ExecuteMethodRoute(COMMAND_DECODER_HANDLE_DATA* commandDecoderInstance, SCHEMA_HANDLE schemaHandle, const COMMAND_DECODER_ROUTE* route, MULTITREE_HANDLE methodTree)
+{
+    METHODRETURN_HANDLE result;
+    AGENT_DATA_TYPE* arguments = NULL;
+
+    if ((route->ArgCount > 0) &&
+        ((arguments = (AGENT_DATA_TYPE*)malloc(sizeof(AGENT_DATA_TYPE) * route->ArgCount)) == NULL))
+    {
+        /*Codes_SRS_COMMAND_DECODER_02_023: [ If any of the previous operations fail, then CommandDecoder_ExecuteMethod shall return NULL. ]*/
+        LogError("Failed allocating arguments array");
+        result = NULL;
+    }
+    else
+    {
+        size_t j;
+        size_t nDecoded = DecodeRouteArguments(schemaHandle, route, methodTree, arguments);
+        if (nDecoded == route->ArgCount)
+        {
+            /*Codes_SRS_COMMAND_DECODER_41_007: [ When a remembered path is dispatched again, CommandDecoder shall decode the arguments and call the callback using the remembered route, without splitting the path and without Schema lookups. ]*/
+            result = commandDecoderInstance->methodCallback(commandDecoderInstance->methodCallbackContext, route->RelativePath, route->Name, route->ArgCount, arguments);
+        }
+        else
+        {
+            /*Codes_SRS_COMMAND_DECODER_02_023: [ If any of the previous operations fail, then CommandDecoder_ExecuteMethod shall return NULL. ]*/
+            result = NULL;
+        }
+
+        for (j = 0; j < nDecoded; j++)
+        {
+            Destroy_AGENT_DATA_TYPE(&arguments[j]);
+        }
+
+        if (arguments != NULL)
+        {
+            free(arguments);
+        }
+    }
+    return result;
+}
+
 static EXECUTE_COMMAND_RESULT ScanActionPathAndExecuteAction(COMMAND_DECODER_HANDLE_DATA* commandDecoderInstance, SCHEMA_HANDLE schemaHandle, const char* actionPath, MULTITREE_HANDLE commandNode)
 {
     EXECUTE_COMMAND_RESULT result;
@@ -605,8 +909,18 @@ static EXECUTE_COMMAND_RESULT DecodeCommand(COMMAND_DECODER_HANDLE_DATA* command
         }
         else
         {
+            const COMMAND_DECODER_ROUTE* route;
             actionName++;
-            result = ScanActionPathAndExecuteAction(commandDecoderInstance, schemaHandle, actionName, commandNode);
+            /*the action path is followed by the closing quote*/
+            if ((route = FindRoute(commandDecoderInstance->ActionRoutes, actionName, strlen(actionName) - 1)) != NULL)
+            {
+                /*Codes_SRS_COMMAND_DECODER_41_007: [ When a remembered path is dispatched again, CommandDecoder shall decode the arguments and call the callback using the remembered route, without splitting the path and without Schema lookups. ]*/
+                result = ExecuteActionRoute(commandDecoderInstance, schemaHandle, route, commandNode);
+            }
+            else
+            {
+                result = ScanActionPathAndExecuteAction(commandDecoderInstance, schemaHandle, actionName, commandNode);
+            }
         }
     }
     return result;
@@ -625,8 +939,16 @@ static METHODRETURN_HANDLE DecodeMethod(COMMAND_DECODER_HANDLE_DATA* commandDeco
     }
     else
     {
-        result = ScanMethodPathAndExecuteMethod(commandDecoderInstance, schemaHandle, fullMethodName, methodTree);
-
+        const COMMAND_DECODER_ROUTE* route;
+        if ((route = FindRoute(commandDecoderInstance->MethodRoutes, fullMethodName, strlen(fullMethodName))) != NULL)
+        {
+            /*Codes_SRS_COMMAND_DECODER_41_007: [ When a remembered path is dispatched again, CommandDecoder shall decode the arguments and call the callback using the remembered route, without splitting the path and without Schema lookups. ]*/
+            result = ExecuteMethodRoute(commandDecoderInstance, schemaHandle, route, methodTree);
+        }
+        else
+        {
+            result = ScanMethodPathAndExecuteMethod(commandDecoderInstance, schemaHandle, fullMethodName, methodTree);
+        }
     }
     return result;
 }
@@ -777,6 +1099,9 @@ COMMAND_DECODER_HANDLE CommandDecoder_Create(SCHEMA_MODEL_TYPE_HANDLE modelHandl
             result->ActionCallbackContext = actionCallbackContext;
             result->methodCallback = methodCallback;
             result->methodCallbackContext = methodCallbackContext;
+            /*Codes_SRS_COMMAND_DECODER_41_008: [ CommandDecoder_Create shall start with no remembered routes. ]*/
+            (void)memset(result->ActionRoutes, 0, sizeof(result->ActionRoutes));
+            (void)memset(result->MethodRoutes, 0, sizeof(result->MethodRoutes));
         }
     }
 
@@ -791,194 +1116,462 @@ void CommandDecoder_Destroy(COMMAND_DECODER_HANDLE commandDecoderHandle)
         COMMAND_DECODER_HANDLE_DATA* commandDecoderInstance = (COMMAND_DECODER_HANDLE_DATA*)commandDecoderHandle;
 
         /* Codes_SRS_COMMAND_DECODER_01_005: [CommandDecoder_Destroy shall free all resources associated with the commandDecoderHandle instance.] */
+        /*Codes_SRS_COMMAND_DECODER_41_009: [ CommandDecoder_Destroy shall free all the remembered routes. ]*/
+        DestroyRoutes(commandDecoderInstance->ActionRoutes);
+        DestroyRoutes(commandDecoderInstance->MethodRoutes);
         free(commandDecoderInstance);
     }
 }
 
 DEFINE_ENUM_STRINGS(AGENT_DATA_TYPE_TYPE, AGENT_DATA_TYPE_TYPE_VALUES);
 
-/*validates that the multitree (coming from a JSON) is actually a serialization of the model (complete or incomplete)*/
-/*if the serialization contains more than the model, then it fails.*/
-/*if the serialization does not contain mandatory items from the model, it fails*/
-static bool validateModel_vs_Multitree(void* startAddress, SCHEMA_MODEL_TYPE_HANDLE modelHandle, MULTITREE_HANDLE desiredPropertiesTree, size_t offset)
+/*names and short values are copied here to be NUL terminated, longer ones are allocated*/
+#define DESIRED_PROPERTIES_SCRATCH_SIZE 64
+
+typedef enum DESIRED_PROPERTIES_LEVEL_KIND_TAG
+{
+    DESIRED_PROPERTIES_LEVEL_TWIN, /*the whole twin, only its "desired" member is decoded*/
+    DESIRED_PROPERTIES_LEVEL_MODEL
+} DESIRED_PROPERTIES_LEVEL_KIND;
+
+/*one JSON object (or array) of the document, mapped to a model of the schema*/
+typedef struct DESIRED_PROPERTIES_LEVEL_TAG
+{
+    DESIRED_PROPERTIES_LEVEL_KIND kind;
+    SCHEMA_MODEL_TYPE_HANDLE modelHandle;
+    size_t offset; /*of the model in the device struct*/
+    bool hasVersion; /*$version is part of the document, not of the model*/
+    pfOnDesiredProperty onDesiredProperty; /*of a model in model, called once the whole model has been decoded*/
+    size_t onDesiredPropertyOffset;
+} DESIRED_PROPERTIES_LEVEL;
+
+typedef enum DESIRED_PROPERTIES_PENDING_TAG
+{
+    DESIRED_PROPERTIES_PENDING_NONE,
+    DESIRED_PROPERTIES_PENDING_SKIP,
+    DESIRED_PROPERTIES_PENDING_DESIRED_NODE,
+    DESIRED_PROPERTIES_PENDING_DESIRED_PROPERTY,
+    DESIRED_PROPERTIES_PENDING_MODEL_IN_MODEL
+} DESIRED_PROPERTIES_PENDING;
+
+/*decodes the desired properties while the JSON is tokenized, writing every value straight at its offset in the device struct*/
+typedef struct DESIRED_PROPERTIES_DECODER_TAG
+{
+    void* startAddress;
+    SCHEMA_MODEL_TYPE_HANDLE modelHandle;
+    bool parseDesiredNode;
+    bool foundDesiredNode;
+    bool failed;
+    size_t depth;
+    DESIRED_PROPERTIES_LEVEL levels[JSON_DECODER_MAX_DEPTH];
+
+    /*what the member whose name was just read maps to*/
+    DESIRED_PROPERTIES_PENDING pending;
+    SCHEMA_DESIRED_PROPERTY_HANDLE pendingDesiredProperty;
+    SCHEMA_MODEL_TYPE_HANDLE pendingModelHandle;
+    size_t pendingOffset;
+    pfOnDesiredProperty pendingOnDesiredProperty;
+
+    /*while skipping a value (or capturing a structure), the depth of its container*/
+    size_t skipDepth;
+    const char* captureBegin;
+} DESIRED_PROPERTIES_DECODER;
+
+/*returns scratch or an allocated copy that has to be freed, NULL on failure*/
+static char* CopySlice(const char* prefix, const JSON_DECODER_SLICE* slice, const char* suffix, char* scratch, size_t scratchSize)
+{
+    char* result;
+    size_t prefixLength = strlen(prefix);
+    size_t suffixLength = strlen(suffix);
+
+    if (slice->length > SIZE_MAX - prefixLength - suffixLength - 1)
+    {
+        LogError("value too long");
+        result = NULL;
+    }
+    else
+    {
+        size_t needed = prefixLength + slice->length + suffixLength + 1;
+        if (needed <= scratchSize)
+        {
+            result = scratch;
+        }
+        else if ((result = (char*)malloc(needed)) == NULL)
+        {
+            LogError("failure allocating %lu bytes", (unsigned long)needed);
+        }
+
+        if (result != NULL)
+        {
+            (void)memcpy(result, prefix, prefixLength);
+            (void)memcpy(result + prefixLength, slice->value, slice->length);
+            (void)memcpy(result + prefixLength + slice->length, suffix, suffixLength + 1);
+        }
+    }
+
+    return result;
+}
+
+static void FreeSliceCopy(char* copy, char* scratch)
+{
+    if (copy != scratch)
+    {
+        free(copy);
+    }
+}
+
+static bool SliceEquals(const JSON_DECODER_SLICE* slice, const char* text)
 {
+    size_t length = strlen(text);
+    return (slice->length == length) && (memcmp(slice->value, text, length) == 0);
+}
+
+static void PushDesiredPropertiesLevel(DESIRED_PROPERTIES_DECODER* decoder, DESIRED_PROPERTIES_LEVEL_KIND kind, SCHEMA_MODEL_TYPE_HANDLE modelHandle, size_t offset, bool hasVersion, pfOnDesiredProperty onDesiredProperty, size_t onDesiredPropertyOffset)
+{
+    /*the tokenizer does not nest deeper than JSON_DECODER_MAX_DEPTH*/
+    DESIRED_PROPERTIES_LEVEL* level = &decoder->levels[decoder->depth++];
+    level->kind = kind;
+    level->modelHandle = modelHandle;
+    level->offset = offset;
+    level->hasVersion = hasVersion;
+    level->onDesiredProperty = onDesiredProperty;
+    level->onDesiredPropertyOffset = onDesiredPropertyOffset;
+}
+
+static void StartSkippingValue(DESIRED_PROPERTIES_DECODER* decoder, const char* captureBegin)
+{
+    decoder->skipDepth = ++decoder->depth;
+    decoder->captureBegin = captureBegin;
+}
 
-    bool result;
-    size_t nChildren;
-    size_t nProcessedChildren = 0;
-    (void)MultiTree_GetChildCount(desiredPropertiesTree, &nChildren);
-    for (size_t i = 0;i < nChildren;i++)
+static void ApplyDesiredProperty(DESIRED_PROPERTIES_DECODER* decoder, const AGENT_DATA_TYPE* output)
+{
+    /*Codes_SRS_COMMAND_DECODER_02_008: [ The desired property shall be constructed in memory by calling pfDesiredPropertyFromAGENT_DATA_TYPE. ]*/
+    pfDesiredPropertyFromAGENT_DATA_TYPE leFunction = Schema_GetModelDesiredProperty_pfDesiredPropertyFromAGENT_DATA_TYPE(decoder->pendingDesiredProperty);
+    if (leFunction(output, (char*)decoder->startAddress + decoder->pendingOffset + Schema_GetModelDesiredProperty_offset(decoder->pendingDesiredProperty)) != 0)
+    {
+        /*the other desired properties are still ingested*/
+        LogError("failure in a function that converts from AGENT_DATA_TYPE to C data");
+        decoder->failed = true;
+    }
+    else
     {
-        MULTITREE_HANDLE child;
-        if (MultiTree_GetChild(desiredPropertiesTree, i, &child) != MULTITREE_OK)
+        /*Codes_SRS_COMMAND_DECODER_02_013: [ If the desired property has a non-NULL pfOnDesiredProperty then it shall be called. ]*/
+        pfOnDesiredProperty onDesiredProperty = Schema_GetModelDesiredProperty_pfOnDesiredProperty(decoder->pendingDesiredProperty);
+        if (onDesiredProperty != NULL)
         {
-            LogError("failure in MultiTree_GetChild");
-            i = nChildren;
+            onDesiredProperty((char*)decoder->startAddress + decoder->pendingOffset);
+        }
+    }
+}
+
+/*Codes_SRS_COMMAND_DECODER_41_003: [ A desired property of a primitive type shall be converted from the text of its value by CreateAgentDataType_From_String. ]*/
+static int DecodeDesiredPropertyValue(DESIRED_PROPERTIES_DECODER* decoder, JSON_DECODER_TOKEN token, const JSON_DECODER_SLICE* slice)
+{
+    int result;
+    AGENT_DATA_TYPE_TYPE primitiveType;
+
+    /*Codes_SRS_COMMAND_DECODER_02_007: [ If the child name corresponds to a desired property then an AGENT_DATA_TYPE shall be constructed from the MULTITREE node. ]*/
+    if ((primitiveType = CodeFirst_GetPrimitiveType(Schema_GetModelDesiredPropertyType(decoder->pendingDesiredProperty))) == EDM_NO_TYPE)
+    {
+        LogError("a structure cannot be decoded from a single value");
+        result = __FAILURE__;
+    }
+    else
+    {
+        /*AGENT_DATA_TYPEs are decoded from JSON text, where strings have their quotes*/
+        char scratch[DESIRED_PROPERTIES_SCRATCH_SIZE];
+        const char* quote = (token == JSON_DECODER_TOKEN_STRING) ? "\"" : "";
+        char* value = CopySlice(quote, slice, quote, scratch, sizeof(scratch));
+        if (value == NULL)
+        {
+            result = __FAILURE__;
         }
         else
         {
-            STRING_HANDLE childName = STRING_new();
-            if (childName == NULL)
+            AGENT_DATA_TYPE output;
+            if (CreateAgentDataType_From_String(value, primitiveType, &output) != AGENT_DATA_TYPES_OK)
             {
-                LogError("failure to STRING_new");
-                i = nChildren;
+                LogError("failure decoding %s", value);
+                result = __FAILURE__;
             }
             else
             {
-                if (MultiTree_GetName(child, childName) != MULTITREE_OK)
-                {
-                    LogError("failure to MultiTree_GetName");
-                    i = nChildren;
-                }
-                else
-                {
-                    const char *childName_str = STRING_c_str(childName);
-                    SCHEMA_MODEL_ELEMENT elementType = Schema_GetModelElementByName(modelHandle, childName_str);
-                    switch (elementType.elementType)
-                    {
-                        default:
-                        {
-                            LogError("INTERNAL ERROR: unexpected function return");
-                            i = nChildren;
-                            break;
-                        }
-                        case (SCHEMA_PROPERTY):
-                        {
-                            LogError("cannot ingest name (WITH_DATA instead of WITH_DESIRED_PROPERTY): %s", childName_str);
-                            i = nChildren;
-                            break;
-                        }
-                        case (SCHEMA_REPORTED_PROPERTY):
-                        {
-                            LogError("cannot ingest name (WITH_REPORTED_PROPERTY instead of WITH_DESIRED_PROPERTY): %s", childName_str);
-                            i = nChildren;
-                            break;
-                        }
-                        case (SCHEMA_DESIRED_PROPERTY):
-                        {
-                            /*Codes_SRS_COMMAND_DECODER_02_007: [ If the child name corresponds to a desired property then an AGENT_DATA_TYPE shall be constructed from the MULTITREE node. ]*/
-                            SCHEMA_DESIRED_PROPERTY_HANDLE desiredPropertyHandle = elementType.elementHandle.desiredPropertyHandle;
-
-                            const char* desiredPropertyType = Schema_GetModelDesiredPropertyType(desiredPropertyHandle);
-                            AGENT_DATA_TYPE output;
-                            if (DecodeValueFromNode(Schema_GetSchemaForModelType(modelHandle), &output, child, desiredPropertyType) != 0)
-                            {
-                                LogError("failure in DecodeValueFromNode");
-                                i = nChildren;
-                            }
-                            else
-                            {
-                                /*Codes_SRS_COMMAND_DECODER_02_008: [ The desired property shall be constructed in memory by calling pfDesiredPropertyFromAGENT_DATA_TYPE. ]*/
-                                pfDesiredPropertyFromAGENT_DATA_TYPE leFunction = Schema_GetModelDesiredProperty_pfDesiredPropertyFromAGENT_DATA_TYPE(desiredPropertyHandle);
-                                if (leFunction(&output, (char*)startAddress + offset + Schema_GetModelDesiredProperty_offset(desiredPropertyHandle)) != 0)
-                                {
-                                    LogError("failure in a function that converts from AGENT_DATA_TYPE to C data");
-                                }
-                                else
-                                {
-                                    /*Codes_SRS_COMMAND_DECODER_02_013: [ If the desired property has a non-NULL pfOnDesiredProperty then it shall be called. ]*/
-                                    pfOnDesiredProperty onDesiredProperty = Schema_GetModelDesiredProperty_pfOnDesiredProperty(desiredPropertyHandle);
-                                    if (onDesiredProperty != NULL)
-                                    {
-                                        onDesiredProperty((char*)startAddress + offset);
-                                    }
-                                    nProcessedChildren++;
-                                }
-                                Destroy_AGENT_DATA_TYPE(&output);
-                            }
-
-                            break;
-                        }
-                        case(SCHEMA_MODEL_IN_MODEL):
-                        {
-                            SCHEMA_MODEL_TYPE_HANDLE modelModel = elementType.elementHandle.modelHandle;
-
-                            /*Codes_SRS_COMMAND_DECODER_02_009: [ If the child name corresponds to a model in model then the function shall call itself recursively. ]*/
-                            if (!validateModel_vs_Multitree(startAddress, modelModel, child, offset + Schema_GetModelModelByName_Offset(modelHandle, childName_str)))
-                            {
-                                LogError("failure in validateModel_vs_Multitree");
-                                i = nChildren;
-                            }
-                            else
-                            {
-                                /*if the model in model so happened to be a WITH_DESIRED_PROPERTY... (only those has non_NULL pfOnDesiredProperty) */
-                                /*Codes_SRS_COMMAND_DECODER_02_012: [ If the child model in model has a non-NULL pfOnDesiredProperty then pfOnDesiredProperty shall be called. ]*/
-                                pfOnDesiredProperty onDesiredProperty = Schema_GetModelModelByName_OnDesiredProperty(modelHandle, childName_str);
-                                if (onDesiredProperty != NULL)
-                                {
-                                    onDesiredProperty((char*)startAddress + offset);
-                                }
+                ApplyDesiredProperty(decoder, &output);
+                Destroy_AGENT_DATA_TYPE(&output);
+                result = 0;
+            }
+            FreeSliceCopy(value, scratch);
+        }
+    }
 
-                                nProcessedChildren++;
-                            }
+    return result;
+}
 
-                            break;
-                        }
+/*Codes_SRS_COMMAND_DECODER_41_004: [ A desired property of a structure type shall be decoded from a MULTITREE built only for its value. ]*/
+static int DecodeCapturedStructure(DESIRED_PROPERTIES_DECODER* decoder, const char* captureEnd)
+{
+    int result;
+    JSON_DECODER_SLICE captured;
+    char* copy;
 
-                    } /*switch*/
-                }
-                STRING_delete(childName);
+    captured.value = decoder->captureBegin;
+    captured.length = (size_t)(captureEnd - decoder->captureBegin);
+    if ((copy = CopySlice("", &captured, "", NULL, 0)) == NULL)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        MULTITREE_HANDLE valueTree;
+        if (JSONDecoder_JSON_To_MultiTree(copy, &valueTree) != JSON_DECODER_OK)
+        {
+            LogError("Decoding JSON to a multi tree failed");
+            result = __FAILURE__;
+        }
+        else
+        {
+            AGENT_DATA_TYPE output;
+            if (DecodeValueFromNode(Schema_GetSchemaForModelType(decoder->pendingModelHandle), &output, valueTree, Schema_GetModelDesiredPropertyType(decoder->pendingDesiredProperty)) != 0)
+            {
+                LogError("failure in DecodeValueFromNode");
+                result = __FAILURE__;
+            }
+            else
+            {
+                ApplyDesiredProperty(decoder, &output);
+                Destroy_AGENT_DATA_TYPE(&output);
+                result = 0;
             }
+            MultiTree_Destroy(valueTree);
         }
+        free(copy);
     }
 
-    if(nProcessedChildren == nChildren)
+    return result;
+}
+
+static int DecodeDesiredPropertiesName(DESIRED_PROPERTIES_DECODER* decoder, const JSON_DECODER_SLICE* slice)
+{
+    int result;
+    DESIRED_PROPERTIES_LEVEL* level = &decoder->levels[decoder->depth - 1];
+
+    if (level->kind == DESIRED_PROPERTIES_LEVEL_TWIN)
+    {
+        /*Codes_SRS_COMMAND_DECODER_02_014: [ If parseDesiredNode is TRUE, parse only the `desired` part of JSON tree ]*/
+        decoder->pending = SliceEquals(slice, "desired") ? DESIRED_PROPERTIES_PENDING_DESIRED_NODE : DESIRED_PROPERTIES_PENDING_SKIP;
+        result = 0;
+    }
+    else if (level->hasVersion && SliceEquals(slice, "$version"))
     {
-        /*Codes_SRS_COMMAND_DECODER_02_010: [ If the complete MULTITREE has been parsed then CommandDecoder_IngestDesiredProperties shall succeed and return EXECUTE_COMMAND_SUCCESS. ]*/
-        result = true;
+        /*Codes_COMMAND_DECODER_02_015: [ Remove '$version' string from node, if it is present.  It not being present is not an error ]*/
+        decoder->pending = DESIRED_PROPERTIES_PENDING_SKIP;
+        result = 0;
     }
     else
     {
-        /*Codes_SRS_COMMAND_DECODER_02_011: [ Otherwise CommandDecoder_IngestDesiredProperties shall fail and return EXECUTE_COMMAND_FAILED. ]*/
-        LogError("not all constituents of the JSON have been ingested");
-        result = false;
+        char scratch[DESIRED_PROPERTIES_SCRATCH_SIZE];
+        char* name = CopySlice("", slice, "", scratch, sizeof(scratch));
+        if (name == NULL)
+        {
+            result = __FAILURE__;
+        }
+        else
+        {
+            SCHEMA_MODEL_ELEMENT elementType = Schema_GetModelElementByName(level->modelHandle, name);
+            switch (elementType.elementType)
+            {
+                default:
+                {
+                    LogError("INTERNAL ERROR: unexpected function return");
+                    result = __FAILURE__;
+                    break;
+                }
+                case (SCHEMA_PROPERTY):
+                {
+                    LogError("cannot ingest name (WITH_DATA instead of WITH_DESIRED_PROPERTY): %s", name);
+                    result = __FAILURE__;
+                    break;
+                }
+                case (SCHEMA_REPORTED_PROPERTY):
+                {
+                    LogError("cannot ingest name (WITH_REPORTED_PROPERTY instead of WITH_DESIRED_PROPERTY): %s", name);
+                    result = __FAILURE__;
+                    break;
+                }
+                case (SCHEMA_DESIRED_PROPERTY):
+                {
+                    decoder->pending = DESIRED_PROPERTIES_PENDING_DESIRED_PROPERTY;
+                    decoder->pendingDesiredProperty = elementType.elementHandle.desiredPropertyHandle;
+                    decoder->pendingModelHandle = level->modelHandle;
+                    decoder->pendingOffset = level->offset;
+                    result = 0;
+                    break;
+                }
+                case (SCHEMA_MODEL_IN_MODEL):
+                {
+                    /*Codes_SRS_COMMAND_DECODER_02_009: [ If the child name corresponds to a model in model then the function shall call itself recursively. ]*/
+                    decoder->pending = DESIRED_PROPERTIES_PENDING_MODEL_IN_MODEL;
+                    decoder->pendingModelHandle = elementType.elementHandle.modelHandle;
+                    decoder->pendingOffset = level->offset + Schema_GetModelModelByName_Offset(level->modelHandle, name);
+                    /*if the model in model so happened to be a WITH_DESIRED_PROPERTY... (only those has non_NULL pfOnDesiredProperty) */
+                    decoder->pendingOnDesiredProperty = Schema_GetModelModelByName_OnDesiredProperty(level->modelHandle, name);
+                    result = 0;
+                    break;
+                }
+            }
+            FreeSliceCopy(name, scratch);
+        }
     }
+
     return result;
 }
 
-static EXECUTE_COMMAND_RESULT DecodeDesiredProperties(void* startAddress, COMMAND_DECODER_HANDLE_DATA* handle, MULTITREE_HANDLE desiredPropertiesTree)
+static int DecodeDesiredPropertiesValue(DESIRED_PROPERTIES_DECODER* decoder, JSON_DECODER_TOKEN token, const JSON_DECODER_SLICE* slice)
 {
-    /*Codes_SRS_COMMAND_DECODER_02_006: [ CommandDecoder_IngestDesiredProperties shall parse the MULTITREEE recursively. ]*/
-    return validateModel_vs_Multitree(startAddress, handle->ModelHandle, desiredPropertiesTree, 0 )?EXECUTE_COMMAND_SUCCESS:EXECUTE_COMMAND_FAILED;
+    int result = 0;
+    bool isContainer = (token == JSON_DECODER_TOKEN_OBJECT_BEGIN) || (token == JSON_DECODER_TOKEN_ARRAY_BEGIN);
+    DESIRED_PROPERTIES_PENDING pending = decoder->pending;
+    decoder->pending = DESIRED_PROPERTIES_PENDING_NONE;
+
+    switch (pending)
+    {
+        default:
+        {
+            if (decoder->depth == 0)
+            {
+                /*the document itself*/
+                if (decoder->parseDesiredNode)
+                {
+                    PushDesiredPropertiesLevel(decoder, DESIRED_PROPERTIES_LEVEL_TWIN, NULL, 0, false, NULL, 0);
+                }
+                else
+                {
+                    PushDesiredPropertiesLevel(decoder, DESIRED_PROPERTIES_LEVEL_MODEL, decoder->modelHandle, 0, true, NULL, 0);
+                }
+            }
+            else if (decoder->levels[decoder->depth - 1].kind == DESIRED_PROPERTIES_LEVEL_TWIN)
+            {
+                if (isContainer)
+                {
+                    StartSkippingValue(decoder, NULL);
+                }
+            }
+            else
+            {
+                /*Codes_SRS_COMMAND_DECODER_02_011: [ Otherwise CommandDecoder_IngestDesiredProperties shall fail and return EXECUTE_COMMAND_FAILED. ]*/
+                LogError("array elements are not part of a model");
+                result = __FAILURE__;
+            }
+            break;
+        }
+        case DESIRED_PROPERTIES_PENDING_SKIP:
+        {
+            if (isContainer)
+            {
+                StartSkippingValue(decoder, NULL);
+            }
+            break;
+        }
+        case DESIRED_PROPERTIES_PENDING_DESIRED_NODE:
+        {
+            decoder->foundDesiredNode = true;
+            if (isContainer)
+            {
+                PushDesiredPropertiesLevel(decoder, DESIRED_PROPERTIES_LEVEL_MODEL, decoder->modelHandle, 0, true, NULL, 0);
+            }
+            break;
+        }
+        case DESIRED_PROPERTIES_PENDING_DESIRED_PROPERTY:
+        {
+            if (isContainer)
+            {
+                StartSkippingValue(decoder, slice->value);
+            }
+            else
+            {
+                result = DecodeDesiredPropertyValue(decoder, token, slice);
+            }
+            break;
+        }
+        case DESIRED_PROPERTIES_PENDING_MODEL_IN_MODEL:
+        {
+            if (token == JSON_DECODER_TOKEN_ARRAY_BEGIN)
+            {
+                LogError("a model cannot be decoded from an array");
+                result = __FAILURE__;
+            }
+            else if (token == JSON_DECODER_TOKEN_OBJECT_BEGIN)
+            {
+                PushDesiredPropertiesLevel(decoder, DESIRED_PROPERTIES_LEVEL_MODEL, decoder->pendingModelHandle, decoder->pendingOffset, false, decoder->pendingOnDesiredProperty, decoder->levels[decoder->depth - 1].offset);
+            }
+            /*Codes_SRS_COMMAND_DECODER_02_012: [ If the child model in model has a non-NULL pfOnDesiredProperty then pfOnDesiredProperty shall be called. ]*/
+            else if (decoder->pendingOnDesiredProperty != NULL)
+            {
+                /*a value that is not an object has no members, which makes it an empty model*/
+                decoder->pendingOnDesiredProperty((char*)decoder->startAddress + decoder->levels[decoder->depth - 1].offset);
+            }
+            break;
+        }
+    }
+
+    return result;
 }
 
-/* Raw JSON has properties we don't need; potentially nodes other than "desired" for full TWIN as well as a $version we don't pass to callees */
-static bool RemoveUnneededTwinProperties(MULTITREE_HANDLE initialParsedTree, bool parseDesiredNode, MULTITREE_HANDLE *desiredPropertiesTree)
+static int DecodeDesiredPropertiesToken(void* context, JSON_DECODER_TOKEN token, const JSON_DECODER_SLICE* slice)
 {
-    MULTITREE_HANDLE updateTree;
-    bool result;
+    int result;
+    DESIRED_PROPERTIES_DECODER* decoder = (DESIRED_PROPERTIES_DECODER*)context;
+    bool isContainerEnd = (token == JSON_DECODER_TOKEN_OBJECT_END) || (token == JSON_DECODER_TOKEN_ARRAY_END);
 
-    if (parseDesiredNode)
+    if (decoder->skipDepth != 0)
     {
-        /*Codes_SRS_COMMAND_DECODER_02_014: [ If parseDesiredNode is TRUE, parse only the `desired` part of JSON tree ]*/
-        if (MultiTree_GetChildByName(initialParsedTree, "desired", &updateTree) != MULTITREE_OK)
+        /*inside a value that is skipped, or captured to be decoded once it ends*/
+        result = 0;
+        if ((token == JSON_DECODER_TOKEN_OBJECT_BEGIN) || (token == JSON_DECODER_TOKEN_ARRAY_BEGIN))
         {
-            LogError("Unable to find 'desired' in tree");
-            return false;
+            decoder->depth++;
+        }
+        else if (isContainerEnd && (decoder->depth-- == decoder->skipDepth))
+        {
+            decoder->skipDepth = 0;
+            if (decoder->captureBegin != NULL)
+            {
+                result = DecodeCapturedStructure(decoder, slice->value + slice->length);
+                decoder->captureBegin = NULL;
+            }
         }
     }
-    else
+    else if (token == JSON_DECODER_TOKEN_NAME)
     {
-        // Tree already starts on node we want so just use it.
-        updateTree = initialParsedTree;
+        result = DecodeDesiredPropertiesName(decoder, slice);
     }
-
-    /*Codes_COMMAND_DECODER_02_015: [ Remove '$version' string from node, if it is present.  It not being present is not an error ]*/
-    MULTITREE_RESULT deleteChildResult = MultiTree_DeleteChild(updateTree, "$version");
-    if ((deleteChildResult == MULTITREE_OK) || (deleteChildResult == MULTITREE_CHILD_NOT_FOUND))
+    else if (isContainerEnd)
     {
-        *desiredPropertiesTree = updateTree;
-        result = true;
+        DESIRED_PROPERTIES_LEVEL* level = &decoder->levels[--decoder->depth];
+        /*Codes_SRS_COMMAND_DECODER_02_012: [ If the child model in model has a non-NULL pfOnDesiredProperty then pfOnDesiredProperty shall be called. ]*/
+        if (level->onDesiredProperty != NULL)
+        {
+            level->onDesiredProperty((char*)decoder->startAddress + level->onDesiredPropertyOffset);
+        }
+        result = 0;
     }
     else
     {
-        *desiredPropertiesTree = NULL;
-        result = false;
+        result = DecodeDesiredPropertiesValue(decoder, token, slice);
     }
 
     return result;
 }
 
+static int IgnoreToken(void* context, JSON_DECODER_TOKEN token, const JSON_DECODER_SLICE* slice)
+{
+    (void)context;
+    (void)token;
+    (void)slice;
+    return 0;
+}
+
 EXECUTE_COMMAND_RESULT CommandDecoder_IngestDesiredProperties(void* startAddress, COMMAND_DECODER_HANDLE handle, const char* jsonPayload, bool parseDesiredNode)
 {
     EXECUTE_COMMAND_RESULT result;
@@ -997,43 +1590,60 @@ EXECUTE_COMMAND_RESULT CommandDecoder_IngestDesiredProperties(void* startAddress
     }
     else
     {
-        /*Codes_SRS_COMMAND_DECODER_02_004: [ CommandDecoder_IngestDesiredProperties shall clone desiredProperties. ]*/
-        char* copy;
-        if (mallocAndStrcpy_s(&copy, jsonPayload) != 0)
+        size_t jsonLength = strlen(jsonPayload);
+
+        /*Codes_SRS_COMMAND_DECODER_41_001: [ CommandDecoder_IngestDesiredProperties shall check that jsonPayload is well formed by calling JSONDecoder_Tokenize before changing any desired property. ]*/
+        if (JSONDecoder_Tokenize(jsonPayload, jsonLength, IgnoreToken, NULL) != JSON_DECODER_OK)
         {
-            LogError("failure in mallocAndStrcpy_s");
-            result = EXECUTE_COMMAND_FAILED;
+            LogError("jsonPayload is not well formed JSON");
+            result = EXECUTE_COMMAND_ERROR;
         }
         else
         {
-            /*Codes_SRS_COMMAND_DECODER_02_005: [ CommandDecoder_IngestDesiredProperties shall create a MULTITREE_HANDLE ouf of the clone of desiredProperties. ]*/
-            MULTITREE_HANDLE initialParsedTree;
-            MULTITREE_HANDLE desiredPropertiesTree;
-
-            if (JSONDecoder_JSON_To_MultiTree(copy, &initialParsedTree) != JSON_DECODER_OK)
+            /*Codes_SRS_COMMAND_DECODER_41_002: [ CommandDecoder_IngestDesiredProperties shall decode jsonPayload with JSONDecoder_Tokenize, writing every desired property at its offset as soon as its value is read. ]*/
+            DESIRED_PROPERTIES_DECODER* decoder = (DESIRED_PROPERTIES_DECODER*)malloc(sizeof(DESIRED_PROPERTIES_DECODER));
+            if (decoder == NULL)
             {
-                LogError("Decoding JSON to a multi tree failed");
+                LogError("failure allocating the desired properties decoder");
                 result = EXECUTE_COMMAND_ERROR;
             }
             else
             {
-                if (RemoveUnneededTwinProperties(initialParsedTree, parseDesiredNode, &desiredPropertiesTree) == false)
+                decoder->startAddress = startAddress;
+                decoder->modelHandle = ((COMMAND_DECODER_HANDLE_DATA*)handle)->ModelHandle;
+                decoder->parseDesiredNode = parseDesiredNode;
+                decoder->foundDesiredNode = false;
+                decoder->failed = false;
+                decoder->depth = 0;
+                decoder->pending = DESIRED_PROPERTIES_PENDING_NONE;
+                decoder->skipDepth = 0;
+                decoder->captureBegin = NULL;
+
+                if (JSONDecoder_Tokenize(jsonPayload, jsonLength, DecodeDesiredPropertiesToken, decoder) != JSON_DECODER_OK)
                 {
-                    LogError("Removing unneeded twin properties failed");
+                    /*Codes_SRS_COMMAND_DECODER_02_011: [ Otherwise CommandDecoder_IngestDesiredProperties shall fail and return EXECUTE_COMMAND_FAILED. ]*/
+                    LogError("not all constituents of the JSON have been ingested");
+                    result = EXECUTE_COMMAND_FAILED;
+                }
+                else if (parseDesiredNode && !decoder->foundDesiredNode)
+                {
+                    /*Codes_SRS_COMMAND_DECODER_02_014: [ If parseDesiredNode is TRUE, parse only the `desired` part of JSON tree ]*/
+                    LogError("Unable to find 'desired' in JSON");
                     result = EXECUTE_COMMAND_ERROR;
                 }
+                else if (decoder->failed)
+                {
+                    /*Codes_SRS_COMMAND_DECODER_02_011: [ Otherwise CommandDecoder_IngestDesiredProperties shall fail and return EXECUTE_COMMAND_FAILED. ]*/
+                    LogError("not all constituents of the JSON have been ingested");
+                    result = EXECUTE_COMMAND_FAILED;
+                }
                 else
                 {
-                    COMMAND_DECODER_HANDLE_DATA* commandDecoderInstance = (COMMAND_DECODER_HANDLE_DATA*)handle;
-
-                    /*Codes_SRS_COMMAND_DECODER_02_006: [ CommandDecoder_IngestDesiredProperties shall parse the MULTITREEE recursively. ]*/
-                    result = DecodeDesiredProperties(startAddress, commandDecoderInstance, desiredPropertiesTree);
-
-                    // Do NOT free desiredPropertiesTree.  It is only a pointer into initialParsedTree.
-                    MultiTree_Destroy(initialParsedTree);
+                    /*Codes_SRS_COMMAND_DECODER_02_010: [ If the complete MULTITREE has been parsed then CommandDecoder_IngestDesiredProperties shall succeed and return EXECUTE_COMMAND_SUCCESS. ]*/
+                    result = EXECUTE_COMMAND_SUCCESS;
                 }
+                free(decoder);
             }
-            free(copy);
         }
     }
     return result;
@@ -2,6 +2,7 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
 #include <stdlib.h> /*for free*/
+#include <string.h>
 #include "azure_c_shared_utility/gballoc.h"
 
 #include <stdbool.h>
@@ -25,6 +26,22 @@ typedef struct DATA_MARSHALLER_HANDLE_DATA_TAG
     bool IncludePropertyPath;
 } DATA_MARSHALLER_HANDLE_DATA;
 
+/*a layout is the JSON of a record without its values: the value of a field goes right after the text ending at PrefixEnd*/
+typedef struct DATA_MARSHALLER_LAYOUT_FIELD_TAG
+{
+    size_t PrefixEnd;
+    size_t ValueIndex; /*index of the value in a record*/
+} DATA_MARSHALLER_LAYOUT_FIELD;
+
+typedef struct DATA_MARSHALLER_LAYOUT_TAG
+{
+    char* Text;
+    size_t TextLength;
+    DATA_MARSHALLER_LAYOUT_FIELD* Fields; /*in the order of the JSON*/
+    size_t FieldCount;
+    STRING_HANDLE Scratch; /*the value being encoded, reused by every record*/
+} DATA_MARSHALLER_LAYOUT;
+
 static int NoCloneFunction(void** destination, const void* source)
 {
     *destination = (void*)source;
@@ -73,144 +90,191 @@ void DataMarshaller_Destroy(DATA_MARSHALLER_HANDLE dataMarshallerHandle)
     }
 }
 
-DATA_MARSHALLER_RESULT DataMarshaller_SendData(DATA_MARSHALLER_HANDLE dataMarshallerHandle, size_t valueCount, const DATA_MARSHALLER_VALUE* values, unsigned char** destination, size_t* destinationSize)
+/*the encoded JSON goes either to a new buffer (*destination) or to the caller's buffer (when buffer is not NULL)*/
+static DATA_MARSHALLER_RESULT SendData(DATA_MARSHALLER_HANDLE_DATA* dataMarshallerInstance, size_t valueCount, const DATA_MARSHALLER_VALUE* values, unsigned char** destination, unsigned char* buffer, size_t bufferCapacity, size_t* destinationSize)
 {
-    DATA_MARSHALLER_HANDLE_DATA* dataMarshallerInstance = (DATA_MARSHALLER_HANDLE_DATA*)dataMarshallerHandle;
     DATA_MARSHALLER_RESULT result;
     MULTITREE_HANDLE treeHandle;
+    size_t i;
+    bool includePropertyPath = dataMarshallerInstance->IncludePropertyPath;
+    /* VS complains wrongly that result is not initialized */
+    result = DATA_MARSHALLER_ERROR;
 
-    /* Codes_SRS_DATA_MARSHALLER_99_034:[All argument checks shall be performed before calling any other modules.] */
-    /* Codes_SRS_DATA_MARSHALLER_99_004:[ DATA_MARSHALLER_INVALID_ARG shall be returned when the function has detected an invalid parameter (NULL) being passed to the function.] */
-    if ((values == NULL) ||
-        (dataMarshallerHandle == NULL) ||
-        (destination == NULL) ||
-        (destinationSize == NULL) ||
-        /* Codes_SRS_DATA_MARSHALLER_99_033:[ DATA_MARSHALLER_INVALID_ARG shall be returned if the valueCount is zero.] */
-        (valueCount == 0))
+    for (i = 0; i < valueCount; i++)
     {
-        result = DATA_MARSHALLER_INVALID_ARG;
-        LOG_DATA_MARSHALLER_ERROR
-    }
-    else
-    {
-        size_t i;
-        bool includePropertyPath = dataMarshallerInstance->IncludePropertyPath;
-        /* VS complains wrongly that result is not initialized */
-        result = DATA_MARSHALLER_ERROR;
-
-        for (i = 0; i < valueCount; i++)
+        if ((values[i].PropertyPath == NULL) ||
+            (values[i].Value == NULL))
         {
-            if ((values[i].PropertyPath == NULL) ||
-                (values[i].Value == NULL))
-            {
-                /*Codes_SRS_DATA_MARSHALLER_99_007:[ DATA_MARSHALLER_INVALID_MODEL_PROPERTY shall be returned when any of the items in values contain invalid data]*/
-                result = DATA_MARSHALLER_INVALID_MODEL_PROPERTY;
-                LOG_DATA_MARSHALLER_ERROR
-                break;
-            }
+            /*Codes_SRS_DATA_MARSHALLER_99_007:[ DATA_MARSHALLER_INVALID_MODEL_PROPERTY shall be returned when any of the items in values contain invalid data]*/
+            result = DATA_MARSHALLER_INVALID_MODEL_PROPERTY;
+            LOG_DATA_MARSHALLER_ERROR
+            break;
+        }
 
-            if ((!dataMarshallerInstance->IncludePropertyPath) &&
-                (values[i].Value->type == EDM_COMPLEX_TYPE_TYPE) &&
-                (valueCount > 1))
-            {
-                /* Codes_SRS_DATAMARSHALLER_01_002: [If the includePropertyPath argument passed to DataMarshaller_Create was false and the number of values passed to SendData is greater than 1 and at least one of them is a struct, DataMarshaller_SendData shall fallback to  including the complete property path in the output JSON.] */
-                includePropertyPath = true;
-            }
+        if ((!dataMarshallerInstance->IncludePropertyPath) &&
+            (values[i].Value->type == EDM_COMPLEX_TYPE_TYPE) &&
+            (valueCount > 1))
+        {
+            /* Codes_SRS_DATAMARSHALLER_01_002: [If the includePropertyPath argument passed to DataMarshaller_Create was false and the number of values passed to SendData is greater than 1 and at least one of them is a struct, DataMarshaller_SendData shall fallback to  including the complete property path in the output JSON.] */
+            includePropertyPath = true;
         }
+    }
 
-        if (i == valueCount)
+    if (i == valueCount)
+    {
+        /* Codes_SRS_DATA_MARSHALLER_99_037:[DataMarshaller shall store as MultiTree the data to be encoded by the JSONEncoder module.] */
+        if ((treeHandle = MultiTree_Create(NoCloneFunction, NoFreeFunction)) == NULL)
         {
-            /* Codes_SRS_DATA_MARSHALLER_99_037:[DataMarshaller shall store as MultiTree the data to be encoded by the JSONEncoder module.] */
-            if ((treeHandle = MultiTree_Create(NoCloneFunction, NoFreeFunction)) == NULL)
-            {
-                /* Codes_SRS_DATA_MARSHALLER_99_035:[DATA_MARSHALLER_MULTITREE_ERROR shall be returned in case any MultiTree API call fails.] */
-                result = DATA_MARSHALLER_MULTITREE_ERROR;
-                LOG_DATA_MARSHALLER_ERROR
-            }
-            else
+            /* Codes_SRS_DATA_MARSHALLER_99_035:[DATA_MARSHALLER_MULTITREE_ERROR shall be returned in case any MultiTree API call fails.] */
+            result = DATA_MARSHALLER_MULTITREE_ERROR;
+            LOG_DATA_MARSHALLER_ERROR
+        }
+        else
+        {
+            size_t j;
+            result = DATA_MARSHALLER_OK; /* addressing warning in VS compiler */
+            /* Codes_SRS_DATA_MARSHALLER_99_038:[For each pair in the values argument, a string : value pair shall exist in the JSON object in the form of propertyName : value.] */
+            for (j = 0; j < valueCount; j++)
             {
-                size_t j;
-                result = DATA_MARSHALLER_OK; /* addressing warning in VS compiler */
-                /* Codes_SRS_DATA_MARSHALLER_99_038:[For each pair in the values argument, a string : value pair shall exist in the JSON object in the form of propertyName : value.] */
-                for (j = 0; j < valueCount; j++)
+                if ((includePropertyPath == false) && (values[j].Value->type == EDM_COMPLEX_TYPE_TYPE))
                 {
-                    if ((includePropertyPath == false) && (values[j].Value->type == EDM_COMPLEX_TYPE_TYPE))
-                    {
-                        size_t k;
+                    size_t k;
 
-                        /* Codes_SRS_DATAMARSHALLER_01_001: [If the includePropertyPath argument passed to DataMarshaller_Create was false and only one struct is being sent, the relative path of the value passed to DataMarshaller_SendData - including property name - shall be ignored and the value shall be placed at JSON root.] */
-                        for (k = 0; k < values[j].Value->value.edmComplexType.nMembers; k++)
-                        {
-                            /* Codes_SRS_DATAMARSHALLER_01_004: [In this case the members of the struct shall be added as leafs into the MultiTree, each leaf having the name of the struct member.] */
-                            if (MultiTree_AddLeaf(treeHandle, values[j].Value->value.edmComplexType.fields[k].fieldName, (void*)values[j].Value->value.edmComplexType.fields[k].value) != MULTITREE_OK)
-                            {
-                                break;
-                            }
-                        }
-
-                        if (k < values[j].Value->value.edmComplexType.nMembers)
-                        {
-                            /* Codes_SRS_DATA_MARSHALLER_99_035:[DATA_MARSHALLER_MULTITREE_ERROR shall be returned in case any MultiTree API call fails.] */
-                            result = DATA_MARSHALLER_MULTITREE_ERROR;
-                            LOG_DATA_MARSHALLER_ERROR
-                            break;
-                        }
-                    }
-                    else
+                    /* Codes_SRS_DATAMARSHALLER_01_001: [If the includePropertyPath argument passed to DataMarshaller_Create was false and only one struct is being sent, the relative path of the value passed to DataMarshaller_SendData - including property name - shall be ignored and the value shall be placed at JSON root.] */
+                    for (k = 0; k < values[j].Value->value.edmComplexType.nMembers; k++)
                     {
-                        /* Codes_SRS_DATA_MARSHALLER_99_039:[ If the includePropertyPath argument passed to DataMarshaller_Create was true each property shall be placed in the appropriate position in the JSON according to its path in the model.] */
-                        if (MultiTree_AddLeaf(treeHandle, values[j].PropertyPath, (void*)values[j].Value) != MULTITREE_OK)
+                        /* Codes_SRS_DATAMARSHALLER_01_004: [In this case the members of the struct shall be added as leafs into the MultiTree, each leaf having the name of the struct member.] */
+                        if (MultiTree_AddLeaf(treeHandle, values[j].Value->value.edmComplexType.fields[k].fieldName, (void*)values[j].Value->value.edmComplexType.fields[k].value) != MULTITREE_OK)
                         {
-                            /* Codes_SRS_DATA_MARSHALLER_99_035:[DATA_MARSHALLER_MULTITREE_ERROR shall be returned in case any MultiTree API call fails.] */
-                            result = DATA_MARSHALLER_MULTITREE_ERROR;
-                            LOG_DATA_MARSHALLER_ERROR
                             break;
                         }
                     }
 
+                    if (k < values[j].Value->value.edmComplexType.nMembers)
+                    {
+                        /* Codes_SRS_DATA_MARSHALLER_99_035:[DATA_MARSHALLER_MULTITREE_ERROR shall be returned in case any MultiTree API call fails.] */
+                        result = DATA_MARSHALLER_MULTITREE_ERROR;
+                        LOG_DATA_MARSHALLER_ERROR
+                        break;
+                    }
+                }
+                else
+                {
+                    /* Codes_SRS_DATA_MARSHALLER_99_039:[ If the includePropertyPath argument passed to DataMarshaller_Create was true each property shall be placed in the appropriate position in the JSON according to its path in the model.] */
+                    if (MultiTree_AddLeaf(treeHandle, values[j].PropertyPath, (void*)values[j].Value) != MULTITREE_OK)
+                    {
+                        /* Codes_SRS_DATA_MARSHALLER_99_035:[DATA_MARSHALLER_MULTITREE_ERROR shall be returned in case any MultiTree API call fails.] */
+                        result = DATA_MARSHALLER_MULTITREE_ERROR;
+                        LOG_DATA_MARSHALLER_ERROR
+                        break;
+                    }
                 }
 
-                if (j == valueCount)
+            }
+
+            if (j == valueCount)
+            {
+                STRING_HANDLE payload = STRING_new();
+                if (payload == NULL)
+                {
+                    result = DATA_MARSHALLER_ERROR;
+                    LOG_DATA_MARSHALLER_ERROR
+                }
+                else
                 {
-                    STRING_HANDLE payload = STRING_new();
-                    if (payload == NULL)
+                    if (JSONEncoder_EncodeTree(treeHandle, payload, (JSON_ENCODER_TOSTRING_FUNC)AgentDataTypes_ToString) != JSON_ENCODER_OK)
                     {
-                        result = DATA_MARSHALLER_ERROR;
+                        /* Codes_SRS_DATA_MARSHALLER_99_027:[ DATA_MARSHALLER_JSON_ENCODER_ERROR shall be returned when JSONEncoder returns an error code.] */
+                        result = DATA_MARSHALLER_JSON_ENCODER_ERROR;
                         LOG_DATA_MARSHALLER_ERROR
                     }
                     else
                     {
-                        if (JSONEncoder_EncodeTree(treeHandle, payload, (JSON_ENCODER_TOSTRING_FUNC)AgentDataTypes_ToString) != JSON_ENCODER_OK)
+                        size_t resultSize = STRING_length(payload);
+                        unsigned char* temp;
+                        if (buffer != NULL)
                         {
-                            /* Codes_SRS_DATA_MARSHALLER_99_027:[ DATA_MARSHALLER_JSON_ENCODER_ERROR shall be returned when JSONEncoder returns an error code.] */
-                            result = DATA_MARSHALLER_JSON_ENCODER_ERROR;
-                            LOG_DATA_MARSHALLER_ERROR
-                        }
-                        else
-                        {
-                            /*Codes_SRS_DATAMARSHALLER_02_007: [DataMarshaller_SendData shall copy in the output parameters *destination, *destinationSize the content and the content length of the encoded JSON tree.] */
-                            size_t resultSize = STRING_length(payload);
-                            unsigned char* temp = malloc(resultSize);
-                            if (temp == NULL)
+                            if (resultSize > bufferCapacity)
                             {
-                                /*Codes_SRS_DATA_MARSHALLER_99_015:[ DATA_MARSHALLER_ERROR shall be returned in all the other error cases not explicitly defined here.]*/
-                                result = DATA_MARSHALLER_ERROR;
+                                /*Codes_SRS_DATA_MARSHALLER_41_002: [ If the encoded JSON is longer than destinationCapacity then DataMarshaller_SendDataToBuffer shall fail and return DATA_MARSHALLER_BUFFER_TOO_SMALL. ]*/
+                                result = DATA_MARSHALLER_BUFFER_TOO_SMALL;
                                 LOG_DATA_MARSHALLER_ERROR;
                             }
                             else
                             {
-                                (void)memcpy(temp, STRING_c_str(payload), resultSize);
-                                *destination = temp;
+                                /*Codes_SRS_DATA_MARSHALLER_41_003: [ DataMarshaller_SendDataToBuffer shall copy the encoded JSON to destination and its length to *destinationSize, and return DATA_MARSHALLER_OK. ]*/
+                                (void)memcpy(buffer, STRING_c_str(payload), resultSize);
                                 *destinationSize = resultSize;
                                 result = DATA_MARSHALLER_OK;
                             }
                         }
-                        STRING_delete(payload);
+                        /*Codes_SRS_DATAMARSHALLER_02_007: [DataMarshaller_SendData shall copy in the output parameters *destination, *destinationSize the content and the content length of the encoded JSON tree.] */
+                        else if ((temp = (unsigned char*)malloc(resultSize)) == NULL)
+                        {
+                            /*Codes_SRS_DATA_MARSHALLER_99_015:[ DATA_MARSHALLER_ERROR shall be returned in all the other error cases not explicitly defined here.]*/
+                            result = DATA_MARSHALLER_ERROR;
+                            LOG_DATA_MARSHALLER_ERROR;
+                        }
+                        else
+                        {
+                            (void)memcpy(temp, STRING_c_str(payload), resultSize);
+                            *destination = temp;
+                            *destinationSize = resultSize;
+                            result = DATA_MARSHALLER_OK;
+                        }
                     }
-                } /* if (j==valueCount)*/
-                MultiTree_Destroy(treeHandle);
-            } /* MultiTree_Create */
-        }
+                    STRING_delete(payload);
+                }
+            } /* if (j==valueCount)*/
+            MultiTree_Destroy(treeHandle);
+        } /* MultiTree_Create */
+    }
+
+    return result;
+}
+
+DATA_MARSHALLER_RESULT DataMarshaller_SendData(DATA_MARSHALLER_HANDLE dataMarshallerHandle, size_t valueCount, const DATA_MARSHALLER_VALUE* values, unsigned char** destination, size_t* destinationSize)
+{
+    DATA_MARSHALLER_RESULT result;
+
+    /* Codes_SRS_DATA_MARSHALLER_99_034:[All argument checks shall be performed before calling any other modules.] */
+    /* Codes_SRS_DATA_MARSHALLER_99_004:[ DATA_MARSHALLER_INVALID_ARG shall be returned when the function has detected an invalid parameter (NULL) being passed to the function.] */
+    if ((values == NULL) ||
+        (dataMarshallerHandle == NULL) ||
+        (destination == NULL) ||
+        (destinationSize == NULL) ||
+        /* Codes_SRS_DATA_MARSHALLER_99_033:[ DATA_MARSHALLER_INVALID_ARG shall be returned if the valueCount is zero.] */
+        (valueCount == 0))
+    {
+        result = DATA_MARSHALLER_INVALID_ARG;
+        LOG_DATA_MARSHALLER_ERROR
+    }
+    else
+    {
+        result = SendData((DATA_MARSHALLER_HANDLE_DATA*)dataMarshallerHandle, valueCount, values, destination, NULL, 0, destinationSize);
+    }
+
+    return result;
+}
+
+DATA_MARSHALLER_RESULT DataMarshaller_SendDataToBuffer(DATA_MARSHALLER_HANDLE dataMarshallerHandle, size_t valueCount, const DATA_MARSHALLER_VALUE* values, unsigned char* destination, size_t destinationCapacity, size_t* destinationSize)
+{
+    DATA_MARSHALLER_RESULT result;
+
+    /*Codes_SRS_DATA_MARSHALLER_41_001: [ If dataMarshallerHandle, values, destination or destinationSize is NULL, or valueCount is zero, DataMarshaller_SendDataToBuffer shall fail and return DATA_MARSHALLER_INVALID_ARG. ]*/
+    if ((values == NULL) ||
+        (dataMarshallerHandle == NULL) ||
+        (destination == NULL) ||
+        (destinationSize == NULL) ||
+        (valueCount == 0))
+    {
+        result = DATA_MARSHALLER_INVALID_ARG;
+        LOG_DATA_MARSHALLER_ERROR
+    }
+    else
+    {
+        /*Codes_SRS_DATA_MARSHALLER_41_004: [ Otherwise DataMarshaller_SendDataToBuffer shall encode the values the same way as DataMarshaller_SendData. ]*/
+        result = SendData((DATA_MARSHALLER_HANDLE_DATA*)dataMarshallerHandle, valueCount, values, NULL, destination, destinationCapacity, destinationSize);
     }
 
     return result;
@@ -363,3 +427,286 @@ DATA_MARSHALLER_RESULT DataMarshaller_SendData_ReportedProperties(DATA_MARSHALLE
     }
     return result;
 }
+
+static void AppendLayoutText(DATA_MARSHALLER_LAYOUT* layout, const char* text, size_t length)
+{
+    (void)memcpy(layout->Text + layout->TextLength, text, length);
+    layout->TextLength += length;
+}
+
+/*members are the indexes of the paths placed in this object, prefixLength is the length of the path of the object*/
+static int AddLayoutObject(DATA_MARSHALLER_LAYOUT* layout, const char* const* propertyPaths, size_t* members, size_t memberCount, size_t prefixLength)
+{
+    int result = 0;
+    size_t i = 0;
+
+    AppendLayoutText(layout, "{", 1);
+    while ((result == 0) && (i < memberCount))
+    {
+        const char* name = propertyPaths[members[i]] + prefixLength;
+        size_t nameLength = strcspn(name, "/");
+        size_t groupCount = 1;
+        bool hasLeaf = (name[nameLength] == '\0');
+        size_t j;
+
+        /*the paths going through the same member are moved right after the first one, keeping their order, as MultiTree keeps the children in insertion order*/
+        for (j = i + 1; j < memberCount; j++)
+        {
+            const char* otherName = propertyPaths[members[j]] + prefixLength;
+            if ((strncmp(otherName, name, nameLength) == 0) &&
+                ((otherName[nameLength] == '/') || (otherName[nameLength] == '\0')))
+            {
+                size_t member = members[j];
+                hasLeaf = hasLeaf || (otherName[nameLength] == '\0');
+                (void)memmove(&members[i + groupCount + 1], &members[i + groupCount], (j - i - groupCount) * sizeof(size_t));
+                members[i + groupCount] = member;
+                groupCount++;
+            }
+        }
+
+        /*Codes_SRS_DATA_MARSHALLER_41_007: [ If a path holds an empty name, or a path is given twice or is also the start of another path, DataMarshaller_CreateLayout shall fail and return NULL. ]*/
+        if ((nameLength == 0) ||
+            (hasLeaf && (groupCount > 1)))
+        {
+            LogError("invalid property path %s in the layout", propertyPaths[members[i]]);
+            result = __FAILURE__;
+        }
+        else
+        {
+            if (i > 0)
+            {
+                AppendLayoutText(layout, ", ", 2);
+            }
+            AppendLayoutText(layout, "\"", 1);
+            AppendLayoutText(layout, name, nameLength);
+            AppendLayoutText(layout, "\":", 2);
+
+            if (hasLeaf)
+            {
+                layout->Fields[layout->FieldCount].PrefixEnd = layout->TextLength;
+                layout->Fields[layout->FieldCount].ValueIndex = members[i];
+                layout->FieldCount++;
+            }
+            else
+            {
+                result = AddLayoutObject(layout, propertyPaths, &members[i], groupCount, prefixLength + nameLength + 1);
+            }
+        }
+
+        i += groupCount;
+    }
+
+    if (result == 0)
+    {
+        AppendLayoutText(layout, "}", 1);
+    }
+
+    return result;
+}
+
+static void FreeLayout(DATA_MARSHALLER_LAYOUT* layout)
+{
+    if (layout->Scratch != NULL)
+    {
+        STRING_delete(layout->Scratch);
+    }
+    free(layout->Fields);
+    free(layout->Text);
+    free(layout);
+}
+
+DATA_MARSHALLER_LAYOUT_HANDLE DataMarshaller_CreateLayout(DATA_MARSHALLER_HANDLE dataMarshallerHandle, size_t valueCount, const char* const* propertyPaths)
+{
+    DATA_MARSHALLER_LAYOUT* result;
+    size_t i;
+
+    /*Codes_SRS_DATA_MARSHALLER_41_005: [ If dataMarshallerHandle or propertyPaths is NULL, or valueCount is zero, DataMarshaller_CreateLayout shall fail and return NULL. ]*/
+    if ((dataMarshallerHandle == NULL) ||
+        (propertyPaths == NULL) ||
+        (valueCount == 0))
+    {
+        result = NULL;
+        LogError("invalid argument DATA_MARSHALLER_HANDLE dataMarshallerHandle=%p, size_t valueCount=%lu, const char* const* propertyPaths=%p", dataMarshallerHandle, (unsigned long)valueCount, propertyPaths);
+    }
+    else
+    {
+        size_t textCapacity = 2; /*the braces of the record*/
+
+        /*Codes_SRS_DATA_MARSHALLER_41_006: [ DataMarshaller_CreateLayout shall check that every path is the path of a property of the model by calling Schema_ModelPropertyByPathExists, and fail and return NULL if one is not. ]*/
+        for (i = 0; i < valueCount; i++)
+        {
+            const char* current;
+
+            if ((propertyPaths[i] == NULL) ||
+                (!Schema_ModelPropertyByPathExists(dataMarshallerHandle->ModelHandle, propertyPaths[i])))
+            {
+                LogError("%s is not a property of the model", (propertyPaths[i] == NULL) ? "NULL" : propertyPaths[i]);
+                break;
+            }
+
+            /*every name of the path is at most written once, with its quotes, separator and braces*/
+            textCapacity += strlen(propertyPaths[i]) + 7;
+            for (current = propertyPaths[i]; *current != '\0'; current++)
+            {
+                if (*current == '/')
+                {
+                    textCapacity += 7;
+                }
+            }
+        }
+
+        if (i < valueCount)
+        {
+            result = NULL;
+        }
+        else if ((result = (DATA_MARSHALLER_LAYOUT*)malloc(sizeof(DATA_MARSHALLER_LAYOUT))) == NULL)
+        {
+            /*Codes_SRS_DATA_MARSHALLER_41_009: [ If any other error occurs, DataMarshaller_CreateLayout shall fail and return NULL. ]*/
+            LogError("failure allocating the layout");
+        }
+        else
+        {
+            size_t* members;
+
+            result->TextLength = 0;
+            result->FieldCount = 0;
+            result->Scratch = NULL;
+            result->Fields = NULL;
+
+            if ((result->Text = (char*)malloc(textCapacity)) == NULL)
+            {
+                /*Codes_SRS_DATA_MARSHALLER_41_009: [ If any other error occurs, DataMarshaller_CreateLayout shall fail and return NULL. ]*/
+                LogError("failure allocating the layout text");
+                FreeLayout(result);
+                result = NULL;
+            }
+            else if ((result->Fields = (DATA_MARSHALLER_LAYOUT_FIELD*)malloc(valueCount * sizeof(DATA_MARSHALLER_LAYOUT_FIELD))) == NULL)
+            {
+                LogError("failure allocating the layout fields");
+                FreeLayout(result);
+                result = NULL;
+            }
+            else if ((result->Scratch = STRING_new()) == NULL)
+            {
+                LogError("failure creating the layout scratch string");
+                FreeLayout(result);
+                result = NULL;
+            }
+            else if ((members = (size_t*)malloc(valueCount * sizeof(size_t))) == NULL)
+            {
+                LogError("failure allocating the layout members");
+                FreeLayout(result);
+                result = NULL;
+            }
+            else
+            {
+                for (i = 0; i < valueCount; i++)
+                {
+                    members[i] = i;
+                }
+
+                /*Codes_SRS_DATA_MARSHALLER_41_008: [ DataMarshaller_CreateLayout shall lay out the record as DataMarshaller_SendData would with includePropertyPath set to true and the values given in the order of propertyPaths, and return a non-NULL handle. ]*/
+                if (AddLayoutObject(result, propertyPaths, members, valueCount, 0) != 0)
+                {
+                    FreeLayout(result);
+                    result = NULL;
+                }
+
+                free(members);
+            }
+        }
+    }
+
+    return result;
+}
+
+void DataMarshaller_DestroyLayout(DATA_MARSHALLER_LAYOUT_HANDLE layoutHandle)
+{
+    /*Codes_SRS_DATA_MARSHALLER_41_010: [ DataMarshaller_DestroyLayout shall free all resources of the layout; it shall do nothing if layoutHandle is NULL. ]*/
+    if (layoutHandle != NULL)
+    {
+        FreeLayout(layoutHandle);
+    }
+}
+
+DATA_MARSHALLER_RESULT DataMarshaller_SendRecordToBuffer(DATA_MARSHALLER_LAYOUT_HANDLE layoutHandle, const AGENT_DATA_TYPE* values, unsigned char* destination, size_t destinationCapacity, size_t* destinationSize)
+{
+    DATA_MARSHALLER_RESULT result;
+
+    /*Codes_SRS_DATA_MARSHALLER_41_011: [ If layoutHandle, values, destination or destinationSize is NULL, DataMarshaller_SendRecordToBuffer shall fail and return DATA_MARSHALLER_INVALID_ARG. ]*/
+    if ((layoutHandle == NULL) ||
+        (values == NULL) ||
+        (destination == NULL) ||
+        (destinationSize == NULL))
+    {
+        result = DATA_MARSHALLER_INVALID_ARG;
+        LOG_DATA_MARSHALLER_ERROR
+    }
+    else
+    {
+        size_t size = 0;
+        size_t textStart = 0;
+        size_t i;
+
+        result = DATA_MARSHALLER_OK;
+
+        /*Codes_SRS_DATA_MARSHALLER_41_012: [ DataMarshaller_SendRecordToBuffer shall copy the text of the layout to destination, each value being placed at its path as encoded by AgentDataTypes_ToString, without looking up the schema or building a MultiTree. ]*/
+        for (i = 0; (i < layoutHandle->FieldCount) && (result == DATA_MARSHALLER_OK); i++)
+        {
+            const DATA_MARSHALLER_LAYOUT_FIELD* field = &layoutHandle->Fields[i];
+
+            if (STRING_empty(layoutHandle->Scratch) != 0)
+            {
+                /*Codes_SRS_DATA_MARSHALLER_41_015: [ If any other error occurs, DataMarshaller_SendRecordToBuffer shall fail and return DATA_MARSHALLER_ERROR. ]*/
+                result = DATA_MARSHALLER_ERROR;
+                LOG_DATA_MARSHALLER_ERROR
+            }
+            else if (AgentDataTypes_ToString(layoutHandle->Scratch, &values[field->ValueIndex]) != AGENT_DATA_TYPES_OK)
+            {
+                /*Codes_SRS_DATA_MARSHALLER_41_014: [ If AgentDataTypes_ToString fails, DataMarshaller_SendRecordToBuffer shall fail and return DATA_MARSHALLER_AGENT_DATA_TYPES_ERROR. ]*/
+                result = DATA_MARSHALLER_AGENT_DATA_TYPES_ERROR;
+                LOG_DATA_MARSHALLER_ERROR
+            }
+            else
+            {
+                size_t prefixLength = field->PrefixEnd - textStart;
+                size_t valueLength = STRING_length(layoutHandle->Scratch);
+
+                if (destinationCapacity - size < prefixLength + valueLength)
+                {
+                    /*Codes_SRS_DATA_MARSHALLER_41_013: [ If the record is longer than destinationCapacity, DataMarshaller_SendRecordToBuffer shall fail and return DATA_MARSHALLER_BUFFER_TOO_SMALL. ]*/
+                    result = DATA_MARSHALLER_BUFFER_TOO_SMALL;
+                    LOG_DATA_MARSHALLER_ERROR
+                }
+                else
+                {
+                    (void)memcpy(destination + size, layoutHandle->Text + textStart, prefixLength);
+                    size += prefixLength;
+                    (void)memcpy(destination + size, STRING_c_str(layoutHandle->Scratch), valueLength);
+                    size += valueLength;
+                    textStart = field->PrefixEnd;
+                }
+            }
+        }
+
+        if (result == DATA_MARSHALLER_OK)
+        {
+            size_t suffixLength = layoutHandle->TextLength - textStart;
+
+            if (destinationCapacity - size < suffixLength)
+            {
+                /*Codes_SRS_DATA_MARSHALLER_41_013: [ If the record is longer than destinationCapacity, DataMarshaller_SendRecordToBuffer shall fail and return DATA_MARSHALLER_BUFFER_TOO_SMALL. ]*/
+                result = DATA_MARSHALLER_BUFFER_TOO_SMALL;
+                LOG_DATA_MARSHALLER_ERROR
+            }
+            else
+            {
+                /*Codes_SRS_DATA_MARSHALLER_41_016: [ On success DataMarshaller_SendRecordToBuffer shall set *destinationSize to the length of the record and return DATA_MARSHALLER_OK. ]*/
+                (void)memcpy(destination + size, layoutHandle->Text + textStart, suffixLength);
+                *destinationSize = size + suffixLength;
+            }
+        }
+    }
+
+    return result;
+}
@@ -34,6 +34,7 @@ typedef struct TRANSACTION_HANDLE_DATA_TAG
 {
     DATA_PUBLISHER_HANDLE_DATA* DataPublisherInstance;
     size_t ValueCount;
+    size_t SlotCount; /*Values[ValueCount..SlotCount) are kept by DataPublisher_ResetTransaction: a property path and an emptied AGENT_DATA_TYPE*/
     DATA_MARSHALLER_VALUE* Values;
 } TRANSACTION_HANDLE_DATA;
 
@@ -113,6 +114,7 @@ TRANSACTION_HANDLE DataPublisher_StartTransaction(DATA_PUBLISHER_HANDLE dataPubl
         else
         {
             transaction->ValueCount = 0;
+            transaction->SlotCount = 0;
             transaction->Values = NULL;
             transaction->DataPublisherInstance = (DATA_PUBLISHER_HANDLE_DATA*)dataPublisherHandle;
         }
@@ -123,10 +125,40 @@ TRANSACTION_HANDLE DataPublisher_StartTransaction(DATA_PUBLISHER_HANDLE dataPubl
     return transaction;
 }
 
+static DATA_MARSHALLER_VALUE* FindKeptSlot(TRANSACTION_HANDLE_DATA* transaction, const char* propertyPath)
+{
+    DATA_MARSHALLER_VALUE* result = NULL;
+    size_t i;
+    for (i = transaction->ValueCount; i < transaction->SlotCount; i++)
+    {
+        if (strcmp(transaction->Values[i].PropertyPath, propertyPath) == 0)
+        {
+            result = &transaction->Values[i];
+            break;
+        }
+    }
+    return result;
+}
+
+/*moves a slot to Values[ValueCount] (the first slot that is not in use) and returns it*/
+static DATA_MARSHALLER_VALUE* UseSlot(TRANSACTION_HANDLE_DATA* transaction, DATA_MARSHALLER_VALUE* slot)
+{
+    DATA_MARSHALLER_VALUE* result = &transaction->Values[transaction->ValueCount];
+    if (slot != result)
+    {
+        DATA_MARSHALLER_VALUE temp = *result;
+        *result = *slot;
+        *slot = temp;
+    }
+    transaction->ValueCount++;
+    return result;
+}
+
 DATA_PUBLISHER_RESULT DataPublisher_PublishTransacted(TRANSACTION_HANDLE transactionHandle, const char* propertyPath, const AGENT_DATA_TYPE* data)
 {
     DATA_PUBLISHER_RESULT result;
     char* propertyPathCopy;
+    DATA_MARSHALLER_VALUE* keptSlot;
 
     /* Codes_SRS_DATA_PUBLISHER_99_017:[ When one or more NULL parameter(s) are specified, DataPublisher_PublishTransacted is called with a NULL transactionHandle, it shall return DATA_PUBLISHER_INVALID_ARG.] */
     if ((transactionHandle == NULL) ||
@@ -136,6 +168,21 @@ DATA_PUBLISHER_RESULT DataPublisher_PublishTransacted(TRANSACTION_HANDLE transac
         result = DATA_PUBLISHER_INVALID_ARG;
         LOG_DATA_PUBLISHER_ERROR;
     }
+    /*Codes_SRS_DATA_PUBLISHER_41_003: [ If a slot for propertyPath was kept by DataPublisher_ResetTransaction, DataPublisher_PublishTransacted shall copy data into that slot without allocating memory. ]*/
+    else if ((keptSlot = FindKeptSlot((TRANSACTION_HANDLE_DATA*)transactionHandle, propertyPath)) != NULL)
+    {
+        if (Create_AGENT_DATA_TYPE_from_AGENT_DATA_TYPE((AGENT_DATA_TYPE*)keptSlot->Value, data) != AGENT_DATA_TYPES_OK)
+        {
+            /* Codes_SRS_DATA_PUBLISHER_99_028:[ If creating the copy fails then DATA_PUBLISHER_AGENT_DATA_TYPES_ERROR shall be returned.] */
+            result = DATA_PUBLISHER_AGENT_DATA_TYPES_ERROR;
+            LOG_DATA_PUBLISHER_ERROR;
+        }
+        else
+        {
+            (void)UseSlot((TRANSACTION_HANDLE_DATA*)transactionHandle, keptSlot);
+            result = DATA_PUBLISHER_OK;
+        }
+    }
     else if (mallocAndStrcpy_s(&propertyPathCopy, propertyPath) != 0)
     {
         /* Codes_SRS_DATA_PUBLISHER_99_020:[ For any errors not explicitly mentioned here the DataPublisher APIs shall return DATA_PUBLISHER_ERROR.] */
@@ -189,14 +236,14 @@ DATA_PUBLISHER_RESULT DataPublisher_PublishTransacted(TRANSACTION_HANDLE transac
 
             if (propertySlot == NULL)
             {
-                DATA_MARSHALLER_VALUE* newValues = (DATA_MARSHALLER_VALUE*)realloc(transaction->Values, sizeof(DATA_MARSHALLER_VALUE)* (transaction->ValueCount + 1));
+                DATA_MARSHALLER_VALUE* newValues = (DATA_MARSHALLER_VALUE*)realloc(transaction->Values, sizeof(DATA_MARSHALLER_VALUE)* (transaction->SlotCount + 1));
                 if (newValues != NULL)
                 {
                     transaction->Values = newValues;
-                    propertySlot = &transaction->Values[transaction->ValueCount];
-                    propertySlot->Value = NULL;
-                    propertySlot->PropertyPath = NULL;
-                    transaction->ValueCount++;
+                    transaction->Values[transaction->SlotCount].Value = NULL;
+                    transaction->Values[transaction->SlotCount].PropertyPath = NULL;
+                    propertySlot = UseSlot(transaction, &transaction->Values[transaction->SlotCount]);
+                    transaction->SlotCount++;
                 }
             }
 
@@ -305,6 +352,13 @@ DATA_PUBLISHER_RESULT DataPublisher_CancelTransaction(TRANSACTION_HANDLE transac
             free((AGENT_DATA_TYPE*)transaction->Values[i].Value);
         }
 
+        /*the values of the kept slots have already been destroyed by DataPublisher_ResetTransaction*/
+        for (; i < transaction->SlotCount; i++)
+        {
+            free((char*)transaction->Values[i].PropertyPath);
+            free((AGENT_DATA_TYPE*)transaction->Values[i].Value);
+        }
+
         /* Codes_SRS_DATA_PUBLISHER_99_015:[ DataPublisher_CancelTransaction shall dispose of any resources associated with the transaction.] */
         free(transaction->Values);
         free(transaction);
@@ -317,6 +371,85 @@ DATA_PUBLISHER_RESULT DataPublisher_CancelTransaction(TRANSACTION_HANDLE transac
     return result;
 }
 
+DATA_PUBLISHER_RESULT DataPublisher_EndTransactionToBuffer(TRANSACTION_HANDLE transactionHandle, unsigned char* destination, size_t destinationCapacity, size_t* destinationSize)
+{
+    DATA_PUBLISHER_RESULT result;
+
+    /*Codes_SRS_DATA_PUBLISHER_41_005: [ If transactionHandle, destination or destinationSize is NULL, DataPublisher_EndTransactionToBuffer shall return DATA_PUBLISHER_INVALID_ARG. ]*/
+    if (
+        (transactionHandle == NULL) ||
+        (destination == NULL) ||
+        (destinationSize == NULL)
+        )
+    {
+        result = DATA_PUBLISHER_INVALID_ARG;
+        LOG_DATA_PUBLISHER_ERROR;
+    }
+    else
+    {
+        TRANSACTION_HANDLE_DATA* transaction = (TRANSACTION_HANDLE_DATA*)transactionHandle;
+        DATA_MARSHALLER_RESULT marshallerResult;
+
+        if (transaction->ValueCount == 0)
+        {
+            /*Codes_SRS_DATA_PUBLISHER_41_006: [ If no values have been associated with the transaction, DataPublisher_EndTransactionToBuffer shall return DATA_PUBLISHER_EMPTY_TRANSACTION. ]*/
+            result = DATA_PUBLISHER_EMPTY_TRANSACTION;
+            LOG_DATA_PUBLISHER_ERROR;
+        }
+        /*Codes_SRS_DATA_PUBLISHER_41_007: [ DataPublisher_EndTransactionToBuffer shall call DataMarshaller_SendDataToBuffer passing as capacity the smaller of destinationCapacity and the max buffer size. ]*/
+        else if ((marshallerResult = DataMarshaller_SendDataToBuffer(transaction->DataPublisherInstance->DataMarshallerHandle, transaction->ValueCount, transaction->Values, destination,
+            (destinationCapacity < maxBufferSize_) ? destinationCapacity : maxBufferSize_, destinationSize)) == DATA_MARSHALLER_BUFFER_TOO_SMALL)
+        {
+            /*Codes_SRS_DATA_PUBLISHER_41_008: [ If DataMarshaller_SendDataToBuffer returns DATA_MARSHALLER_BUFFER_TOO_SMALL, DataPublisher_EndTransactionToBuffer shall return DATA_PUBLISHER_BUFFER_STORAGE_ERROR. ]*/
+            result = DATA_PUBLISHER_BUFFER_STORAGE_ERROR;
+            LOG_DATA_PUBLISHER_ERROR;
+        }
+        else if (marshallerResult != DATA_MARSHALLER_OK)
+        {
+            /*Codes_SRS_DATA_PUBLISHER_41_009: [ If DataMarshaller_SendDataToBuffer fails for any other reason, DataPublisher_EndTransactionToBuffer shall return DATA_PUBLISHER_MARSHALLER_ERROR. ]*/
+            result = DATA_PUBLISHER_MARSHALLER_ERROR;
+            LOG_DATA_PUBLISHER_ERROR;
+        }
+        else
+        {
+            /*Codes_SRS_DATA_PUBLISHER_41_010: [ On success, DataPublisher_EndTransactionToBuffer shall return DATA_PUBLISHER_OK. ]*/
+            result = DATA_PUBLISHER_OK;
+        }
+
+        /*Codes_SRS_DATA_PUBLISHER_41_011: [ DataPublisher_EndTransactionToBuffer shall not dispose of the transaction. ]*/
+    }
+
+    return result;
+}
+
+DATA_PUBLISHER_RESULT DataPublisher_ResetTransaction(TRANSACTION_HANDLE transactionHandle)
+{
+    DATA_PUBLISHER_RESULT result;
+
+    if (transactionHandle == NULL)
+    {
+        /*Codes_SRS_DATA_PUBLISHER_41_001: [ If the transactionHandle argument is NULL, DataPublisher_ResetTransaction shall return DATA_PUBLISHER_INVALID_ARG. ]*/
+        result = DATA_PUBLISHER_INVALID_ARG;
+        LOG_DATA_PUBLISHER_ERROR;
+    }
+    else
+    {
+        TRANSACTION_HANDLE_DATA* transaction = (TRANSACTION_HANDLE_DATA*)transactionHandle;
+        size_t i;
+
+        /*Codes_SRS_DATA_PUBLISHER_41_002: [ DataPublisher_ResetTransaction shall discard the values associated with the transaction, keep their memory and property paths for the next values and return DATA_PUBLISHER_OK. ]*/
+        for (i = 0; i < transaction->ValueCount; i++)
+        {
+            Destroy_AGENT_DATA_TYPE((AGENT_DATA_TYPE*)transaction->Values[i].Value);
+        }
+        transaction->ValueCount = 0;
+
+        result = DATA_PUBLISHER_OK;
+    }
+
+    return result;
+}
+
 /* Codes_SRS_DATA_PUBLISHER_99_065:[ DataPublisher_SetMaxBufferSize shall directly update the value used to limit how much data (in bytes) can be buffered in the BufferStorage instance.] */
 void DataPublisher_SetMaxBufferSize(size_t value)
 {
@@ -3,12 +3,14 @@
 
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/crt_abstractions.h"
+#include "azure_c_shared_utility/xlogging.h"
 
 #include "jsondecoder.h"
 #include <stdio.h>
 #include <string.h>
 #include <ctype.h>
 #include <stddef.h>
+#include <stdint.h>
 
 #define IsWhiteSpace(A) (((A) == 0x20) || ((A) == 0x09) || ((A) == 0x0A) || ((A) == 0x0D))
 
@@ -17,15 +19,34 @@ typedef struct PARSER_STATE_TAG
     char* json;
 } PARSER_STATE;
 
+/*SIMD instructions are not available on every target of the SDK, so strings are scanned a 64 bit word at a time*/
+#define SWAR_ONES 0x0101010101010101ULL
+#define SWAR_HIGH_BITS 0x8080808080808080ULL
+/*non zero if a byte of word might be below n (n <= 128), false positives only make the scan go byte by byte*/
+#define SWAR_HAS_LESS(word, n) (((word) - SWAR_ONES * (n)) & ~(word) & SWAR_HIGH_BITS)
+#define SWAR_HAS_BYTE(word, byte) SWAR_HAS_LESS((word) ^ (SWAR_ONES * (byte)), 1)
+
+typedef enum TOKENIZER_EXPECT_TAG
+{
+    TOKENIZER_EXPECT_VALUE,
+    TOKENIZER_EXPECT_NAME,
+    TOKENIZER_EXPECT_SEPARATOR
+} TOKENIZER_EXPECT;
+
+typedef struct TOKENIZER_STATE_TAG
+{
+    const char* current;
+    const char* end;
+    JSON_DECODER_TOKEN_CALLBACK tokenCallback;
+    void* context;
+    size_t depth;
+    unsigned char isObject[JSON_DECODER_MAX_DEPTH];
+} TOKENIZER_STATE;
+
 static JSON_DECODER_RESULT ParseArray(PARSER_STATE* parserState, MULTITREE_HANDLE currentNode);
 static JSON_DECODER_RESULT ParseObject(PARSER_STATE* parserState, MULTITREE_HANDLE currentNode);
 
 /* Codes_SRS_JSON_DECODER_99_049:[ JSONDecoder shall not allocate new string values for the leafs, but rather point to strings in the original JSON.] */
-static void NoFreeFunction(void* value)
-{
-    (void)value;
-}
-
 static int NOPCloneFunction(void** destination, const void* source)
 {
     *destination = (void**)source;
@@ -571,6 +592,22 @@ static JSON_DECODER_RESULT ParseJSON(char* json, MULTITREE_HANDLE currentNode)
     return ParseObjectOrArray(&parseState, currentNode);
 }
 
+/*every member and array element is a node and is announced by one of these characters, so this is an upper bound outside of strings*/
+static size_t EstimateNodeCount(const char* json, size_t* jsonLength)
+{
+    size_t result = 1;
+    const char* current;
+    for (current = json; *current != '\0'; current++)
+    {
+        if ((*current == ':') || (*current == ',') || (*current == '['))
+        {
+            result++;
+        }
+    }
+    *jsonLength = (size_t)(current - json);
+    return result;
+}
+
 JSON_DECODER_RESULT JSONDecoder_JSON_To_MultiTree(char* json, MULTITREE_HANDLE* multiTreeHandle)
 {
     JSON_DECODER_RESULT result;
@@ -591,7 +628,10 @@ JSON_DECODER_RESULT JSONDecoder_JSON_To_MultiTree(char* json, MULTITREE_HANDLE*
         /* Codes_SRS_JSON_DECODER_99_008:[ JSONDecoder_JSON_To_MultiTree shall create a multi tree based on the json string argument.] */
         /* Codes_SRS_JSON_DECODER_99_002:[ JSONDecoder_JSON_To_MultiTree shall use the MultiTree APIs to create the multi tree and add leafs to the multi tree.] */
         /* Codes_SRS_JSON_DECODER_99_009:[ On success, JSONDecoder_JSON_To_MultiTree shall return a handle to the multi tree it created in the multiTreeHandle argument and it shall return JSON_DECODER_OK.] */
-        *multiTreeHandle = MultiTree_Create(NOPCloneFunction, NoFreeFunction);
+        /* Codes_SRS_JSON_DECODER_41_001: [ JSONDecoder_JSON_To_MultiTree shall create the multi tree with MultiTree_CreateInArena, sized from the number of nodes and the length of the json string, so the whole tree is freed at once. ]*/
+        size_t jsonLength;
+        size_t expectedNodes = EstimateNodeCount(json, &jsonLength);
+        *multiTreeHandle = MultiTree_CreateInArena(NOPCloneFunction, expectedNodes, jsonLength);
         if (*multiTreeHandle == NULL)
         {
             /* Codes_SRS_JSON_DECODER_99_038:[ If any MultiTree API fails, JSONDecoder_JSON_To_MultiTree shall return JSON_DECODER_MULTITREE_FAILED.] */
@@ -609,3 +649,393 @@ JSON_DECODER_RESULT JSONDecoder_JSON_To_MultiTree(char* json, MULTITREE_HANDLE*
 
     return result;
 }
+
+static JSON_DECODER_RESULT EmitToken(TOKENIZER_STATE* tokenizer, JSON_DECODER_TOKEN token, const char* value, size_t length)
+{
+    JSON_DECODER_RESULT result;
+    JSON_DECODER_SLICE slice;
+    slice.value = value;
+    slice.length = length;
+
+    /* Codes_SRS_JSON_DECODER_41_006: [ If tokenCallback returns a non zero value, JSONDecoder_Tokenize shall stop and return JSON_DECODER_ERROR. ]*/
+    if (tokenizer->tokenCallback(tokenizer->context, token, &slice) != 0)
+    {
+        LogError("token callback stopped the tokenizer");
+        result = JSON_DECODER_ERROR;
+    }
+    else
+    {
+        result = JSON_DECODER_OK;
+    }
+
+    return result;
+}
+
+static void TokenizerSkipWhiteSpaces(TOKENIZER_STATE* tokenizer)
+{
+    while ((tokenizer->current < tokenizer->end) && IsWhiteSpace(*(tokenizer->current)))
+    {
+        tokenizer->current++;
+    }
+}
+
+static int IsHexDigit(char c)
+{
+    return ISDIGIT(c) || ((c >= 'a') && (c <= 'f')) || ((c >= 'A') && (c <= 'F'));
+}
+
+/*tokenizer->current is on the opening quote, on success it is left after the closing quote*/
+static JSON_DECODER_RESULT TokenizeString(TOKENIZER_STATE* tokenizer, JSON_DECODER_TOKEN token)
+{
+    JSON_DECODER_RESULT result = JSON_DECODER_PARSE_ERROR;
+    const char* stringBegin = tokenizer->current + 1;
+    const char* current = stringBegin;
+
+    while (current < tokenizer->end)
+    {
+        unsigned char c;
+
+        /*most of a large document is inside strings, skip the words without quotes, backslashes and control characters at once*/
+        while (tokenizer->end - current >= (ptrdiff_t)sizeof(uint64_t))
+        {
+            uint64_t word;
+            (void)memcpy(&word, current, sizeof(word));
+            if (SWAR_HAS_BYTE(word, '"') | SWAR_HAS_BYTE(word, '\\') | SWAR_HAS_LESS(word, 0x20))
+            {
+                break;
+            }
+            current += sizeof(word);
+        }
+
+        if (current == tokenizer->end)
+        {
+            break;
+        }
+
+        c = (unsigned char)*current;
+        if (c == '"')
+        {
+            tokenizer->current = current + 1;
+            result = EmitToken(tokenizer, token, stringBegin, (size_t)(current - stringBegin));
+            break;
+        }
+        else if (c < 0x20)
+        {
+            /*control characters have to be escaped*/
+            break;
+        }
+        else if (c == '\\')
+        {
+            current++;
+            if (current == tokenizer->end)
+            {
+                break;
+            }
+            else if ((*current == '"') || (*current == '\\') || (*current == '/') || (*current == 'b') ||
+                (*current == 'f') || (*current == 'n') || (*current == 'r') || (*current == 't'))
+            {
+                current++;
+            }
+            else if ((*current == 'u') && (tokenizer->end - current > 4) &&
+                IsHexDigit(current[1]) && IsHexDigit(current[2]) && IsHexDigit(current[3]) && IsHexDigit(current[4]))
+            {
+                current += 5;
+            }
+            else
+            {
+                break;
+            }
+        }
+        else
+        {
+            current++;
+        }
+    }
+
+    return result;
+}
+
+static const char* SkipDigits(const char* current, const char* end)
+{
+    while ((current < end) && ISDIGIT(*current))
+    {
+        current++;
+    }
+    return current;
+}
+
+static JSON_DECODER_RESULT TokenizeNumber(TOKENIZER_STATE* tokenizer)
+{
+    JSON_DECODER_RESULT result = JSON_DECODER_OK;
+    const char* numberBegin = tokenizer->current;
+    const char* current = numberBegin;
+    const char* digitsBegin;
+
+    if (*current == '-')
+    {
+        current++;
+    }
+
+    digitsBegin = current;
+    current = SkipDigits(current, tokenizer->end);
+    if ((current == digitsBegin) ||
+        ((current - digitsBegin > 1) && (*digitsBegin == '0')))
+    {
+        result = JSON_DECODER_PARSE_ERROR;
+    }
+    else
+    {
+        if ((current < tokenizer->end) && (*current == '.'))
+        {
+            digitsBegin = ++current;
+            current = SkipDigits(current, tokenizer->end);
+            if (current == digitsBegin)
+            {
+                result = JSON_DECODER_PARSE_ERROR;
+            }
+        }
+
+        if ((result == JSON_DECODER_OK) && (current < tokenizer->end) && ((*current == 'e') || (*current == 'E')))
+        {
+            current++;
+            if ((current < tokenizer->end) && ((*current == '-') || (*current == '+')))
+            {
+                current++;
+            }
+            digitsBegin = current;
+            current = SkipDigits(current, tokenizer->end);
+            if (current == digitsBegin)
+            {
+                result = JSON_DECODER_PARSE_ERROR;
+            }
+        }
+
+        if (result == JSON_DECODER_OK)
+        {
+            tokenizer->current = current;
+            result = EmitToken(tokenizer, JSON_DECODER_TOKEN_NUMBER, numberBegin, (size_t)(current - numberBegin));
+        }
+    }
+
+    return result;
+}
+
+static JSON_DECODER_RESULT TokenizeLiteral(TOKENIZER_STATE* tokenizer, const char* literal, size_t length, JSON_DECODER_TOKEN token)
+{
+    JSON_DECODER_RESULT result;
+
+    if (((size_t)(tokenizer->end - tokenizer->current) < length) ||
+        (memcmp(tokenizer->current, literal, length) != 0))
+    {
+        result = JSON_DECODER_PARSE_ERROR;
+    }
+    else
+    {
+        const char* literalBegin = tokenizer->current;
+        tokenizer->current += length;
+        result = EmitToken(tokenizer, token, literalBegin, length);
+    }
+
+    return result;
+}
+
+static JSON_DECODER_RESULT TokenizeContainerBegin(TOKENIZER_STATE* tokenizer, TOKENIZER_EXPECT* expect)
+{
+    JSON_DECODER_RESULT result;
+    unsigned char isObject = (*(tokenizer->current) == '{') ? 1 : 0;
+
+    if (tokenizer->depth == JSON_DECODER_MAX_DEPTH)
+    {
+        LogError("JSON nests more than %d containers", JSON_DECODER_MAX_DEPTH);
+        result = JSON_DECODER_PARSE_ERROR;
+    }
+    else
+    {
+        const char* containerBegin = tokenizer->current;
+        tokenizer->current++;
+        result = EmitToken(tokenizer, isObject ? JSON_DECODER_TOKEN_OBJECT_BEGIN : JSON_DECODER_TOKEN_ARRAY_BEGIN, containerBegin, 1);
+        if (result == JSON_DECODER_OK)
+        {
+            tokenizer->isObject[tokenizer->depth++] = isObject;
+
+            TokenizerSkipWhiteSpaces(tokenizer);
+            if ((tokenizer->current < tokenizer->end) && (*(tokenizer->current) == (isObject ? '}' : ']')))
+            {
+                /*empty container*/
+                *expect = TOKENIZER_EXPECT_SEPARATOR;
+            }
+            else
+            {
+                *expect = isObject ? TOKENIZER_EXPECT_NAME : TOKENIZER_EXPECT_VALUE;
+            }
+        }
+    }
+
+    return result;
+}
+
+static JSON_DECODER_RESULT TokenizeValue(TOKENIZER_STATE* tokenizer, TOKENIZER_EXPECT* expect)
+{
+    JSON_DECODER_RESULT result;
+    char c = *(tokenizer->current);
+
+    *expect = TOKENIZER_EXPECT_SEPARATOR;
+    if ((c == '{') || (c == '['))
+    {
+        result = TokenizeContainerBegin(tokenizer, expect);
+    }
+    else if (c == '"')
+    {
+        result = TokenizeString(tokenizer, JSON_DECODER_TOKEN_STRING);
+    }
+    else if ((c == '-') || ISDIGIT(c))
+    {
+        result = TokenizeNumber(tokenizer);
+    }
+    else if (c == 't')
+    {
+        result = TokenizeLiteral(tokenizer, "true", 4, JSON_DECODER_TOKEN_TRUE);
+    }
+    else if (c == 'f')
+    {
+        result = TokenizeLiteral(tokenizer, "false", 5, JSON_DECODER_TOKEN_FALSE);
+    }
+    else if (c == 'n')
+    {
+        result = TokenizeLiteral(tokenizer, "null", 4, JSON_DECODER_TOKEN_NULL);
+    }
+    else
+    {
+        result = JSON_DECODER_PARSE_ERROR;
+    }
+
+    return result;
+}
+
+/*after a value: a comma, or the end of the innermost container*/
+static JSON_DECODER_RESULT TokenizeSeparator(TOKENIZER_STATE* tokenizer, TOKENIZER_EXPECT* expect)
+{
+    JSON_DECODER_RESULT result;
+    unsigned char isObject = tokenizer->isObject[tokenizer->depth - 1];
+    char c = *(tokenizer->current);
+
+    if (c == ',')
+    {
+        tokenizer->current++;
+        *expect = isObject ? TOKENIZER_EXPECT_NAME : TOKENIZER_EXPECT_VALUE;
+        result = JSON_DECODER_OK;
+    }
+    else if (c == (isObject ? '}' : ']'))
+    {
+        const char* containerEnd = tokenizer->current;
+        tokenizer->current++;
+        tokenizer->depth--;
+        result = EmitToken(tokenizer, isObject ? JSON_DECODER_TOKEN_OBJECT_END : JSON_DECODER_TOKEN_ARRAY_END, containerEnd, 1);
+    }
+    else
+    {
+        result = JSON_DECODER_PARSE_ERROR;
+    }
+
+    return result;
+}
+
+static JSON_DECODER_RESULT TokenizeName(TOKENIZER_STATE* tokenizer, TOKENIZER_EXPECT* expect)
+{
+    JSON_DECODER_RESULT result;
+
+    if (*(tokenizer->current) != '"')
+    {
+        result = JSON_DECODER_PARSE_ERROR;
+    }
+    else if ((result = TokenizeString(tokenizer, JSON_DECODER_TOKEN_NAME)) == JSON_DECODER_OK)
+    {
+        TokenizerSkipWhiteSpaces(tokenizer);
+        if ((tokenizer->current == tokenizer->end) || (*(tokenizer->current) != ':'))
+        {
+            result = JSON_DECODER_PARSE_ERROR;
+        }
+        else
+        {
+            tokenizer->current++;
+            *expect = TOKENIZER_EXPECT_VALUE;
+        }
+    }
+
+    return result;
+}
+
+JSON_DECODER_RESULT JSONDecoder_Tokenize(const char* json, size_t length, JSON_DECODER_TOKEN_CALLBACK tokenCallback, void* context)
+{
+    JSON_DECODER_RESULT result;
+
+    /* Codes_SRS_JSON_DECODER_41_002: [ If json or tokenCallback is NULL, JSONDecoder_Tokenize shall return JSON_DECODER_INVALID_ARG. ]*/
+    if ((json == NULL) ||
+        (tokenCallback == NULL))
+    {
+        LogError("Invalid argument json=%p, tokenCallback=%p", json, tokenCallback);
+        result = JSON_DECODER_INVALID_ARG;
+    }
+    else
+    {
+        /* Codes_SRS_JSON_DECODER_41_003: [ JSONDecoder_Tokenize shall read exactly length bytes of json, which is not modified and does not have to be NUL terminated. ]*/
+        TOKENIZER_STATE tokenizer;
+        TOKENIZER_EXPECT expect = TOKENIZER_EXPECT_VALUE;
+
+        tokenizer.current = json;
+        tokenizer.end = json + length;
+        tokenizer.tokenCallback = tokenCallback;
+        tokenizer.context = context;
+        tokenizer.depth = 0;
+
+        TokenizerSkipWhiteSpaces(&tokenizer);
+
+        /* Codes_SRS_JSON_DECODER_41_005: [ If json is not one object or array, is malformed or nests more than JSON_DECODER_MAX_DEPTH containers, JSONDecoder_Tokenize shall return JSON_DECODER_PARSE_ERROR. ]*/
+        if ((tokenizer.current == tokenizer.end) ||
+            ((*(tokenizer.current) != '{') && (*(tokenizer.current) != '[')))
+        {
+            result = JSON_DECODER_PARSE_ERROR;
+        }
+        else
+        {
+            /* Codes_SRS_JSON_DECODER_41_004: [ JSONDecoder_Tokenize shall call tokenCallback for every token of json in document order, with names and strings sliced without their quotes and numbers and literals sliced as they are written. ]*/
+            do
+            {
+                TokenizerSkipWhiteSpaces(&tokenizer);
+                if (tokenizer.current == tokenizer.end)
+                {
+                    result = JSON_DECODER_PARSE_ERROR;
+                }
+                else if (expect == TOKENIZER_EXPECT_VALUE)
+                {
+                    result = TokenizeValue(&tokenizer, &expect);
+                }
+                else if (expect == TOKENIZER_EXPECT_NAME)
+                {
+                    result = TokenizeName(&tokenizer, &expect);
+                }
+                else
+                {
+                    result = TokenizeSeparator(&tokenizer, &expect);
+                }
+            } while ((result == JSON_DECODER_OK) && (tokenizer.depth > 0));
+
+            if (result == JSON_DECODER_OK)
+            {
+                TokenizerSkipWhiteSpaces(&tokenizer);
+                if (tokenizer.current != tokenizer.end)
+                {
+                    result = JSON_DECODER_PARSE_ERROR;
+                }
+            }
+        }
+
+        if (result == JSON_DECODER_PARSE_ERROR)
+        {
+            LogError("malformed JSON at offset %lu", (unsigned long)(tokenizer.current - json));
+        }
+    }
+
+    /* Codes_SRS_JSON_DECODER_41_007: [ On success JSONDecoder_Tokenize shall return JSON_DECODER_OK. ]*/
+    return result;
+}
@@ -2,6 +2,7 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
 #include <stdlib.h>
+#include <string.h>
 #include <limits.h>
 
 #include "azure_c_shared_utility/gballoc.h"
@@ -43,52 +44,64 @@ bool is_json_present_and_unparsable(const char* jsonValue)
     return is_present_and_unparsable;
 }
 
-METHODRETURN_HANDLE MethodReturn_Create(int statusCode, const char* jsonValue)
+static METHODRETURN_HANDLE CreateMethodReturn(int statusCode, const char* jsonValue)
 {
-    METHODRETURN_HANDLE result;
-    /*Codes_SRS_METHODRETURN_02_009: [ If jsonValue is not a JSON value then MethodReturn_Create shall fail and return NULL. ]*/
-    if (is_json_present_and_unparsable(jsonValue))
+    METHODRETURN_HANDLE result = (METHODRETURN_HANDLE_DATA*)malloc(sizeof(METHODRETURN_HANDLE_DATA));
+    if (result == NULL)
     {
-        LogError("%s is not JSON", jsonValue);
-        result = NULL;
+        /*Codes_SRS_METHODRETURN_02_002: [ If any failure is encountered then MethodReturn_Create shall return NULL ]*/
+        LogError("unable to malloc");
+        /*return as is*/
     }
     else
     {
-        result = (METHODRETURN_HANDLE_DATA*)malloc(sizeof(METHODRETURN_HANDLE_DATA));
-        if (result == NULL)
+        if (jsonValue == NULL)
         {
-            /*Codes_SRS_METHODRETURN_02_002: [ If any failure is encountered then MethodReturn_Create shall return NULL ]*/
-            LogError("unable to malloc");
-            /*return as is*/
+            /*Codes_SRS_METHODRETURN_02_001: [ MethodReturn_Create shall create a non-NULL handle containing statusCode and a clone of jsonValue. ]*/
+            result->data.jsonValue = NULL;
+            result->data.statusCode = statusCode;
         }
         else
         {
-            if (jsonValue == NULL)
+            if (mallocAndStrcpy_s(&(result->data.jsonValue), jsonValue) != 0)
             {
-                /*Codes_SRS_METHODRETURN_02_001: [ MethodReturn_Create shall create a non-NULL handle containing statusCode and a clone of jsonValue. ]*/
-                result->data.jsonValue = NULL;
-                result->data.statusCode = statusCode;
+                LogError("failure in mallocAndStrcpy_s");
+                free(result);
+                result = NULL;
             }
             else
             {
-                if (mallocAndStrcpy_s(&(result->data.jsonValue), jsonValue) != 0)
-                {
-                    LogError("failure in mallocAndStrcpy_s");
-                    free(result);
-                    result = NULL;
-                }
-                else
-                {
-                    /*Codes_SRS_METHODRETURN_02_001: [ MethodReturn_Create shall create a non-NULL handle containing statusCode and a clone of jsonValue. ]*/
-                    result->data.statusCode = statusCode;
-                }
+                /*Codes_SRS_METHODRETURN_02_001: [ MethodReturn_Create shall create a non-NULL handle containing statusCode and a clone of jsonValue. ]*/
+                result->data.statusCode = statusCode;
             }
         }
     }
+    return result;
+}
+
+METHODRETURN_HANDLE MethodReturn_Create(int statusCode, const char* jsonValue)
+{
+    METHODRETURN_HANDLE result;
+    /*Codes_SRS_METHODRETURN_02_009: [ If jsonValue is not a JSON value then MethodReturn_Create shall fail and return NULL. ]*/
+    if (is_json_present_and_unparsable(jsonValue))
+    {
+        LogError("%s is not JSON", jsonValue);
+        result = NULL;
+    }
+    else
+    {
+        result = CreateMethodReturn(statusCode, jsonValue);
+    }
 
     return result;
 }
 
+METHODRETURN_HANDLE MethodReturn_CreateTrusted(int statusCode, const char* jsonValue)
+{
+    /*Codes_SRS_METHODRETURN_41_001: [ MethodReturn_CreateTrusted shall create a METHODRETURN_HANDLE exactly as MethodReturn_Create does, except that it shall not check that jsonValue is a JSON value. ]*/
+    return CreateMethodReturn(statusCode, jsonValue);
+}
+
 void MethodReturn_Destroy(METHODRETURN_HANDLE handle)
 {
     if (handle == NULL)
@@ -123,3 +136,25 @@ const METHODRETURN_DATA* MethodReturn_GetReturn(METHODRETURN_HANDLE handle)
     }
     return result;
 }
+
+char* MethodReturn_DetachJsonValue(METHODRETURN_HANDLE handle, size_t* jsonValueLength)
+{
+    char* result;
+    if (
+        (handle == NULL) ||
+        (jsonValueLength == NULL)
+        )
+    {
+        /*Codes_SRS_METHODRETURN_41_002: [ If handle or jsonValueLength is NULL then MethodReturn_DetachJsonValue shall fail and return NULL. ]*/
+        LogError("invalid argument METHODRETURN_HANDLE handle=%p, size_t* jsonValueLength=%p", handle, jsonValueLength);
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_METHODRETURN_41_003: [ Otherwise MethodReturn_DetachJsonValue shall return the JSON value held by handle, write its length in *jsonValueLength and leave handle without a JSON value. The caller owns the returned string and shall free it. ]*/
+        result = handle->data.jsonValue;
+        *jsonValueLength = (result == NULL) ? 0 : strlen(result);
+        handle->data.jsonValue = NULL;
+    }
+    return result;
+}
@@ -2,6 +2,7 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
 #include <stdlib.h>
+#include <stdint.h>
 #include "azure_c_shared_utility/gballoc.h"
 
 #include "multitree.h"
@@ -14,16 +15,49 @@
 /*assume a name cannot be longer than 100 characters*/
 #define INNER_NODE_NAME_SIZE 128
 
+/*nodes with more children than this get a hash index of their children, built on the first lookup*/
+#define CHILD_INDEX_THRESHOLD 16
+
+#define FNV_OFFSET_BASIS 2166136261u
+#define FNV_PRIME 16777619u
+
+#define ARENA_ALIGNMENT 8
+#define ARENA_ALIGN(size) (((size) + (ARENA_ALIGNMENT - 1)) & ~(size_t)(ARENA_ALIGNMENT - 1))
+#define ARENA_CHILDREN_INITIAL_CAPACITY 4
+
 DEFINE_ENUM_STRINGS(MULTITREE_RESULT, MULTITREE_RESULT_VALUES);
 
+/*a block of the arena, the allocations follow the header*/
+typedef struct MULTITREE_ARENA_BLOCK_TAG
+{
+    struct MULTITREE_ARENA_BLOCK_TAG* next;
+    size_t size;
+    size_t used;
+}MULTITREE_ARENA_BLOCK;
+
+/*shared by all the nodes of a tree created by MultiTree_CreateInArena, lives in the same allocation as the root and the first block*/
+typedef struct MULTITREE_ARENA_TAG
+{
+    struct MULTITREE_HANDLE_DATA_TAG* root;
+    MULTITREE_ARENA_BLOCK* current; /*the block allocations are taken from*/
+    MULTITREE_ARENA_BLOCK* extraBlocks; /*the blocks allocated after the first one*/
+    size_t blockSize;
+}MULTITREE_ARENA;
+
 typedef struct MULTITREE_HANDLE_DATA_TAG
 {
+    MULTITREE_ARENA* arena; /*NULL when every node, name and children array is its own heap allocation*/
     char* name;
     void* value;
     MULTITREE_CLONE_FUNCTION cloneFunction;
     MULTITREE_FREE_FUNCTION freeFunction;
+    size_t nameLength;
+    uint32_t nameHash;
     size_t nChildren;
     struct MULTITREE_HANDLE_DATA_TAG** children; /*an array of nChildren count of MULTITREE_HANDLE_DATA*   */
+    size_t childrenCapacity; /*only used in an arena, heap nodes grow children one by one*/
+    size_t* childIndex; /*open addressing table of (position in children + 1), 0 is an empty slot. NULL until needed*/
+    size_t childIndexSize; /*a power of 2, at least twice nChildren*/
 }MULTITREE_HANDLE_DATA;
 
 
@@ -46,12 +80,18 @@ MULTITREE_HANDLE MultiTree_Create(MULTITREE_CLONE_FUNCTION cloneFunction, MULTIT
         result = (MULTITREE_HANDLE_DATA*)malloc(sizeof(MULTITREE_HANDLE_DATA));
         if (result != NULL)
         {
+            result->arena = NULL;
+            result->childrenCapacity = 0;
             result->name = NULL;
             result->value = NULL;
             result->cloneFunction = cloneFunction;
             result->freeFunction = freeFunction;
+            result->nameLength = 0;
+            result->nameHash = 0;
             result->nChildren = 0;
             result->children = NULL;
+            result->childIndex = NULL;
+            result->childIndexSize = 0;
         }
         else
         {
@@ -63,18 +103,291 @@ MULTITREE_HANDLE MultiTree_Create(MULTITREE_CLONE_FUNCTION cloneFunction, MULTIT
 }
 
 
-/*return NULL if a child with the name "name" doesn't exists*/
+static void NoFreeFunction(void* value)
+{
+    (void)value;
+}
+
+static MULTITREE_ARENA_BLOCK* getFirstArenaBlock(MULTITREE_ARENA* arena)
+{
+    return (MULTITREE_ARENA_BLOCK*)((unsigned char*)arena + ARENA_ALIGN(sizeof(MULTITREE_ARENA)) + ARENA_ALIGN(sizeof(MULTITREE_HANDLE_DATA)));
+}
+
+/*returns NULL if the arena cannot grow*/
+static void* arenaAlloc(MULTITREE_ARENA* arena, size_t size)
+{
+    void* result;
+    MULTITREE_ARENA_BLOCK* block = arena->current;
+    size = ARENA_ALIGN(size);
+
+    if (block->size - block->used < size)
+    {
+        size_t blockSize = (size > arena->blockSize) ? size : arena->blockSize;
+
+        if ((blockSize > SIZE_MAX - ARENA_ALIGN(sizeof(MULTITREE_ARENA_BLOCK))) ||
+            ((block = (MULTITREE_ARENA_BLOCK*)malloc(ARENA_ALIGN(sizeof(MULTITREE_ARENA_BLOCK)) + blockSize)) == NULL))
+        {
+            LogError("unable to grow the arena by %lu bytes", (unsigned long)blockSize);
+            block = NULL;
+        }
+        else
+        {
+            block->size = blockSize;
+            block->used = 0;
+            block->next = arena->extraBlocks;
+            arena->extraBlocks = block;
+            arena->current = block;
+        }
+    }
+
+    if (block == NULL)
+    {
+        result = NULL;
+    }
+    else
+    {
+        result = (unsigned char*)block + ARENA_ALIGN(sizeof(MULTITREE_ARENA_BLOCK)) + block->used;
+        block->used += size;
+    }
+    return result;
+}
+
+static void* treeAlloc(MULTITREE_HANDLE_DATA* node, size_t size)
+{
+    return (node->arena != NULL) ? arenaAlloc(node->arena, size) : malloc(size);
+}
+
+/*memory taken from an arena is only given back when the whole tree is destroyed*/
+static void treeFree(MULTITREE_HANDLE_DATA* node, void* memory)
+{
+    if (node->arena == NULL)
+    {
+        free(memory);
+    }
+}
+
+MULTITREE_HANDLE MultiTree_CreateInArena(MULTITREE_CLONE_FUNCTION cloneFunction, size_t expectedNodes, size_t expectedNameBytes)
+{
+    MULTITREE_HANDLE_DATA* result;
+
+    /*Codes_SRS_MULTITREE_41_003: [ If cloneFunction is NULL, MultiTree_CreateInArena shall return NULL. ]*/
+    if (cloneFunction == NULL)
+    {
+        LogError("CloneFunction is Null.");
+        result = NULL;
+    }
+    else
+    {
+        /*a node, its name with the terminator and room for its children array, which grows by doubling*/
+        size_t bytesPerNode = ARENA_ALIGN(sizeof(MULTITREE_HANDLE_DATA)) + ARENA_ALIGN(1) + 2 * sizeof(MULTITREE_HANDLE_DATA*);
+        size_t headerSize = ARENA_ALIGN(sizeof(MULTITREE_ARENA)) + ARENA_ALIGN(sizeof(MULTITREE_HANDLE_DATA)) + ARENA_ALIGN(sizeof(MULTITREE_ARENA_BLOCK));
+        size_t blockSize = 0;
+
+        if ((expectedNodes > (SIZE_MAX / 2 - headerSize) / bytesPerNode) || (expectedNameBytes > SIZE_MAX / 2 - headerSize - expectedNodes * bytesPerNode))
+        {
+            LogError("arena for %lu nodes is too large", (unsigned long)expectedNodes);
+            result = NULL;
+        }
+        /*Codes_SRS_MULTITREE_41_004: [ MultiTree_CreateInArena shall create a new tree whose nodes, names and children arrays are taken from an arena sized for expectedNodes nodes with expectedNameBytes bytes of names, allocated together with the root. ]*/
+        else if ((result = (MULTITREE_HANDLE_DATA*)malloc(headerSize + (blockSize = ARENA_ALIGN(expectedNodes * bytesPerNode + expectedNameBytes)))) == NULL)
+        {
+            LogError("MultiTree_CreateInArena failed because malloc failed");
+        }
+        else
+        {
+            /*the root lives in the same allocation, after the arena*/
+            MULTITREE_ARENA* arena = (MULTITREE_ARENA*)result;
+            MULTITREE_ARENA_BLOCK* firstBlock;
+
+            result = (MULTITREE_HANDLE_DATA*)((unsigned char*)arena + ARENA_ALIGN(sizeof(MULTITREE_ARENA)));
+            firstBlock = getFirstArenaBlock(arena);
+            firstBlock->next = NULL;
+            firstBlock->size = blockSize;
+            firstBlock->used = 0;
+
+            arena->root = result;
+            arena->current = firstBlock;
+            arena->extraBlocks = NULL;
+            /*blocks added later are at least as large as half the first, so a bad estimate costs few allocations*/
+            arena->blockSize = (blockSize / 2 > 1024) ? blockSize / 2 : 1024;
+
+            result->arena = arena;
+            result->name = NULL;
+            result->value = NULL;
+            result->cloneFunction = cloneFunction;
+            /*Codes_SRS_MULTITREE_41_005: [ The values of the nodes of a tree created by MultiTree_CreateInArena shall not be freed by MultiTree_Destroy. ]*/
+            result->freeFunction = NoFreeFunction;
+            result->nameLength = 0;
+            result->nameHash = 0;
+            result->nChildren = 0;
+            result->children = NULL;
+            result->childrenCapacity = 0;
+            result->childIndex = NULL;
+            result->childIndexSize = 0;
+        }
+    }
+
+    return (MULTITREE_HANDLE)result;
+}
+
+static uint32_t hashName(const char* name, size_t length)
+{
+    uint32_t hash = FNV_OFFSET_BASIS;
+    size_t i;
+    for (i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char)name[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+static void dropChildIndex(MULTITREE_HANDLE_DATA* node)
+{
+    if (node->childIndex != NULL)
+    {
+        treeFree(node, node->childIndex);
+        node->childIndex = NULL;
+        node->childIndexSize = 0;
+    }
+}
+
+static void insertInChildIndex(MULTITREE_HANDLE_DATA* node, size_t position)
+{
+    size_t mask = node->childIndexSize - 1;
+    size_t slot = node->children[position]->nameHash & mask;
+    while (node->childIndex[slot] != 0)
+    {
+        slot = (slot + 1) & mask;
+    }
+    node->childIndex[slot] = position + 1;
+}
+
+/*(re)builds the index for the current children, returns 0 on success. On failure the node keeps no index and lookups are linear*/
+static int buildChildIndex(MULTITREE_HANDLE_DATA* node)
+{
+    int result;
+    size_t size = CHILD_INDEX_THRESHOLD * 2;
+    size_t* newIndex;
+
+    while ((size < node->nChildren * 2) && (size <= SIZE_MAX / 2 / sizeof(size_t)))
+    {
+        size *= 2;
+    }
+
+    dropChildIndex(node);
+    if ((size < node->nChildren * 2) || ((newIndex = (size_t*)treeAlloc(node, size * sizeof(size_t))) == NULL))
+    {
+        LogError("unable to index %lu children, lookups fall back to a linear search", (unsigned long)node->nChildren);
+        result = __FAILURE__;
+    }
+    else
+    {
+        size_t i;
+        (void)memset(newIndex, 0, size * sizeof(size_t));
+        node->childIndex = newIndex;
+        node->childIndexSize = size;
+        for (i = 0; i < node->nChildren; i++)
+        {
+            insertInChildIndex(node, i);
+        }
+        result = 0;
+    }
+    return result;
+}
+
+/*return NULL if a child with the name "name" (length characters, not necessarily '\0' terminated) doesn't exists*/
 /*returns a pointer to the existing child (if any)*/
-static MULTITREE_HANDLE_DATA* getChildByName(MULTITREE_HANDLE_DATA* node, const char* name)
+static MULTITREE_HANDLE_DATA* getChildByName(MULTITREE_HANDLE_DATA* node, const char* name, size_t length)
 {
     MULTITREE_HANDLE_DATA* result = NULL;
-    size_t i;
-    for (i = 0; i < node->nChildren; i++)
+    uint32_t hash = hashName(name, length);
+
+    /*Codes_SRS_MULTITREE_41_001: [ Once a node has more than CHILD_INDEX_THRESHOLD children, its children shall be found through an index keyed by the hash of their names. ]*/
+    if ((node->nChildren > CHILD_INDEX_THRESHOLD) && (node->childIndex == NULL))
     {
-        if (strcmp(node->children[i]->name, name) == 0)
+        (void)buildChildIndex(node);
+    }
+
+    if (node->childIndex != NULL)
+    {
+        size_t mask = node->childIndexSize - 1;
+        size_t slot = hash & mask;
+        while (node->childIndex[slot] != 0)
         {
-            result = node->children[i];
-            break;
+            MULTITREE_HANDLE_DATA* child = node->children[node->childIndex[slot] - 1];
+            if ((child->nameHash == hash) && (child->nameLength == length) && (memcmp(child->name, name, length) == 0))
+            {
+                result = child;
+                break;
+            }
+            slot = (slot + 1) & mask;
+        }
+    }
+    else
+    {
+        size_t i;
+        for (i = 0; i < node->nChildren; i++)
+        {
+            MULTITREE_HANDLE_DATA* child = node->children[i];
+            if ((child->nameHash == hash) && (child->nameLength == length) && (memcmp(child->name, name, length) == 0))
+            {
+                result = child;
+                break;
+            }
+        }
+    }
+    return result;
+}
+
+/*newNode->nameLength has to be set, returns 0 on success*/
+static int copyName(MULTITREE_HANDLE_DATA* newNode, const char* name)
+{
+    int result;
+    if (newNode->arena == NULL)
+    {
+        result = mallocAndStrcpy_s(&(newNode->name), name);
+    }
+    else if ((newNode->name = (char*)arenaAlloc(newNode->arena, newNode->nameLength + 1)) == NULL)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        (void)memcpy(newNode->name, name, newNode->nameLength + 1);
+        result = 0;
+    }
+    return result;
+}
+
+/*returns the children array with room for one more child, NULL if it cannot grow*/
+static MULTITREE_HANDLE_DATA** growChildren(MULTITREE_HANDLE_DATA* node)
+{
+    MULTITREE_HANDLE_DATA** result;
+    if (node->arena == NULL)
+    {
+        result = (MULTITREE_HANDLE_DATA**)realloc(node->children, (node->nChildren + 1)*sizeof(MULTITREE_HANDLE_DATA*));
+    }
+    else if (node->nChildren < node->childrenCapacity)
+    {
+        result = node->children;
+    }
+    else
+    {
+        /*an arena cannot reallocate, so the array doubles to keep the copies linear*/
+        size_t newCapacity = (node->childrenCapacity == 0) ? ARENA_CHILDREN_INITIAL_CAPACITY : node->childrenCapacity * 2;
+        if ((newCapacity < node->childrenCapacity) || (newCapacity > SIZE_MAX / sizeof(MULTITREE_HANDLE_DATA*)) ||
+            ((result = (MULTITREE_HANDLE_DATA**)arenaAlloc(node->arena, newCapacity * sizeof(MULTITREE_HANDLE_DATA*))) == NULL))
+        {
+            result = NULL;
+        }
+        else
+        {
+            if (node->nChildren > 0)
+            {
+                (void)memcpy(result, node->children, node->nChildren * sizeof(MULTITREE_HANDLE_DATA*));
+            }
+            node->childrenCapacity = newCapacity;
         }
     }
     return result;
@@ -119,14 +432,14 @@ static CREATELEAF_RESULT createLeaf(MULTITREE_HANDLE_DATA* node, const char*name
         result = CREATELEAF_EMPTY_NAME;
         LogError("(result = %s)", CreateLeaf_ResultAsString[result]);
     }
-    else if (getChildByName(node, name) != NULL)
+    else if (getChildByName(node, name, strlen(name)) != NULL)
     {
         result = CREATELEAF_ALREADY_EXISTS;
         LogError("(result = %s)", CreateLeaf_ResultAsString[result]);
     }
     else
     {
-        MULTITREE_HANDLE_DATA* newNode = (MULTITREE_HANDLE_DATA*)malloc(sizeof(MULTITREE_HANDLE_DATA));
+        MULTITREE_HANDLE_DATA* newNode = (MULTITREE_HANDLE_DATA*)treeAlloc(node, sizeof(MULTITREE_HANDLE_DATA));
         if (newNode == NULL)
         {
             result = CREATELEAF_ERROR;
@@ -134,12 +447,18 @@ static CREATELEAF_RESULT createLeaf(MULTITREE_HANDLE_DATA* node, const char*name
         }
         else
         {
+            newNode->arena = node->arena;
             newNode->nChildren = 0;
             newNode->children = NULL;
-            if (mallocAndStrcpy_s(&(newNode->name), name) != 0)
+            newNode->childrenCapacity = 0;
+            newNode->childIndex = NULL;
+            newNode->childIndexSize = 0;
+            newNode->nameLength = strlen(name);
+            newNode->nameHash = hashName(name, newNode->nameLength);
+            if (copyName(newNode, name) != 0)
             {
                 /*not nice*/
-                free(newNode);
+                treeFree(node, newNode);
                 newNode = NULL;
                 result = CREATELEAF_ERROR;
                 LogError("(result = %s)", CreateLeaf_ResultAsString[result]);
@@ -155,9 +474,9 @@ static CREATELEAF_RESULT createLeaf(MULTITREE_HANDLE_DATA* node, const char*name
                 }
                 else if (node->cloneFunction(&(newNode->value), value) != 0)
                 {
-                    free(newNode->name);
+                    treeFree(node, newNode->name);
                     newNode->name = NULL;
-                    free(newNode);
+                    treeFree(node, newNode);
                     newNode = NULL;
                     result = CREATELEAF_ERROR;
                     LogError("(result = %s)", CreateLeaf_ResultAsString[result]);
@@ -172,14 +491,14 @@ static CREATELEAF_RESULT createLeaf(MULTITREE_HANDLE_DATA* node, const char*name
             if (newNode!=NULL)
             {
                 /*allocate space in the father node*/
-                MULTITREE_HANDLE_DATA** newChildren = (MULTITREE_HANDLE_DATA**)realloc(node->children, (node->nChildren + 1)*sizeof(MULTITREE_HANDLE_DATA*));
+                MULTITREE_HANDLE_DATA** newChildren = growChildren(node);
                 if (newChildren == NULL)
                 {
                     /*no space for the new node*/
                     newNode->value = NULL;
-                    free(newNode->name);
+                    treeFree(node, newNode->name);
                     newNode->name = NULL;
-                    free(newNode);
+                    treeFree(node, newNode);
                     newNode = NULL;
                     result = CREATELEAF_ERROR;
                     LogError("(result = %s)", CreateLeaf_ResultAsString[result]);
@@ -189,6 +508,18 @@ static CREATELEAF_RESULT createLeaf(MULTITREE_HANDLE_DATA* node, const char*name
                     node->children = newChildren;
                     node->children[node->nChildren] = newNode;
                     node->nChildren++;
+                    if (node->childIndex != NULL)
+                    {
+                        /*Codes_SRS_MULTITREE_41_002: [ Adding a child to an indexed node shall add it to the index, growing the index once it is half full; if the index cannot grow, lookups shall fall back to a linear search. ]*/
+                        if (node->nChildren * 2 > node->childIndexSize)
+                        {
+                            (void)buildChildIndex(node);
+                        }
+                        else
+                        {
+                            insertInChildIndex(node, node->nChildren - 1);
+                        }
+                    }
                     if (childNode != NULL)
                     {
                         *childNode = newNode;
@@ -304,12 +635,13 @@ MULTITREE_RESULT MultiTree_AddLeaf(MULTITREE_HANDLE treeHandle, const char* dest
             else
             {
                 firstInnerNodeName[whereIsDelimiter - destinationPath] = 0;
-                MULTITREE_HANDLE_DATA *child = getChildByName(node, firstInnerNodeName);
+                MULTITREE_HANDLE_DATA *child = getChildByName(node, firstInnerNodeName, whereIsDelimiter - destinationPath);
                 if (child == NULL)
                 {
+                    MULTITREE_HANDLE_DATA *createdChild;
                     /*Codes_SRS_MULTITREE_99_022:[ If a child along the path does not exist, it shall be created.] */
                     /*Codes_SRS_MULTITREE_99_023:[ The newly created children along the path shall have a NULL value by default.]*/
-                    CREATELEAF_RESULT res = createLeaf(node, firstInnerNodeName, NULL, NULL);
+                    CREATELEAF_RESULT res = createLeaf(node, firstInnerNodeName, NULL, &createdChild);
                     switch (res)
                     {
                         default:
@@ -327,7 +659,6 @@ MULTITREE_RESULT MultiTree_AddLeaf(MULTITREE_HANDLE treeHandle, const char* dest
                         }
                         case(CREATELEAF_OK):
                         {
-                            MULTITREE_HANDLE_DATA *createdChild = getChildByName(node, firstInnerNodeName);
                             result = MultiTree_AddLeaf(createdChild, whereIsDelimiter, value);
                             break;
                         }
@@ -514,18 +845,9 @@ MULTITREE_RESULT MultiTree_GetChildByName(MULTITREE_HANDLE treeHandle, const cha
     }
     else
     {
-        MULTITREE_HANDLE_DATA * node = (MULTITREE_HANDLE_DATA *)treeHandle;
-        size_t i;
+        MULTITREE_HANDLE_DATA * child = getChildByName((MULTITREE_HANDLE_DATA *)treeHandle, childName, strlen(childName));
 
-        for (i = 0; i < node->nChildren; i++)
-        {
-            if (strcmp(node->children[i]->name, childName) == 0)
-            {
-                break;
-            }
-        }
-
-        if (i == node->nChildren)
+        if (child == NULL)
         {
             /* Codes_SRS_MULTITREE_99_068:[ If the specified child is not found, MultiTree_GetChildByName shall return MULTITREE_CHILD_NOT_FOUND.] */
             result = MULTITREE_CHILD_NOT_FOUND;
@@ -534,7 +856,7 @@ MULTITREE_RESULT MultiTree_GetChildByName(MULTITREE_HANDLE treeHandle, const cha
         else
         {
             /* Codes_SRS_MULTITREE_99_067:[ The child node handle shall be returned in the childHandle argument.] */
-            *childHandle = node->children[i];
+            *childHandle = child;
 
             /* Codes_SRS_MULTITREE_99_064:[ On success, MultiTree_GetChildByName shall return MULTITREE_OK.] */
             result = MULTITREE_OK;
@@ -621,35 +943,54 @@ void MultiTree_Destroy(MULTITREE_HANDLE treeHandle)
     if (treeHandle != NULL)
     {
         MULTITREE_HANDLE_DATA* node = (MULTITREE_HANDLE_DATA*)treeHandle;
-        size_t i;
-        for (i = 0; i < node->nChildren;i++)
+        if (node->arena != NULL)
         {
-            /*Codes_SRS_MULTITREE_99_047:[ This function frees any system resource used by the tree designated by parameter treeHandle]*/
-            MultiTree_Destroy(node->children[i]);
+            /*Codes_SRS_MULTITREE_41_006: [ MultiTree_Destroy shall free the whole arena, without visiting its nodes, when called for the root of a tree created by MultiTree_CreateInArena, and do nothing for its other nodes. ]*/
+            if (node->arena->root == node)
+            {
+                MULTITREE_ARENA* arena = node->arena;
+                while (arena->extraBlocks != NULL)
+                {
+                    MULTITREE_ARENA_BLOCK* next = arena->extraBlocks->next;
+                    free(arena->extraBlocks);
+                    arena->extraBlocks = next;
+                }
+                free(arena);
+            }
         }
-        /*Codes_SRS_MULTITREE_99_047:[ This function frees any system resource used by the tree designated by parameter treeHandle]*/
-        if (node->children != NULL)
+        else
         {
-            free(node->children);
-            node->children = NULL;
-        }
+            size_t i;
+            for (i = 0; i < node->nChildren;i++)
+            {
+                /*Codes_SRS_MULTITREE_99_047:[ This function frees any system resource used by the tree designated by parameter treeHandle]*/
+                MultiTree_Destroy(node->children[i]);
+            }
+            /*Codes_SRS_MULTITREE_99_047:[ This function frees any system resource used by the tree designated by parameter treeHandle]*/
+            if (node->children != NULL)
+            {
+                free(node->children);
+                node->children = NULL;
+            }
+            dropChildIndex(node);
 
-        /*Codes_SRS_MULTITREE_99_047:[ This function frees any system resource used by the tree designated by parameter treeHandle]*/
-        if (node->name != NULL)
-        {
-            free(node->name);
-            node->name = NULL;
-        }
+            /*Codes_SRS_MULTITREE_99_047:[ This function frees any system resource used by the tree designated by parameter treeHandle]*/
+            if (node->name != NULL)
+            {
+                free(node->name);
+                node->name = NULL;
+            }
 
-        /*Codes_SRS_MULTITREE_99_047:[ This function frees any system resource used by the tree designated by parameter treeHandle]*/
-        if (node->value != NULL)
-        {
-            node->freeFunction(node->value);
-            node->value = NULL;
-        }
+            /*Codes_SRS_MULTITREE_99_047:[ This function frees any system resource used by the tree designated by parameter treeHandle]*/
+            if (node->value != NULL)
+            {
+                node->freeFunction(node->value);
+                node->value = NULL;
+            }
 
-        /*Codes_SRS_MULTITREE_99_047:[ This function frees any system resource used by the tree designated by parameter treeHandle]*/
-        free(node);
+            /*Codes_SRS_MULTITREE_99_047:[ This function frees any system resource used by the tree designated by parameter treeHandle]*/
+            free(node);
+        }
     }
 }
 
@@ -699,7 +1040,7 @@ MULTITREE_RESULT MultiTree_GetLeafValue(MULTITREE_HANDLE treeHandle, const char*
             /* Codes_SRS_MULTITREE_99_058:[ The last child designates the child that will receive the value.] */
             while (*pos != '\0')
             {
-                size_t i;
+                MULTITREE_HANDLE_DATA* child;
                 size_t childCount = node->nChildren;
 
                 whereIsDelimiter = pos;
@@ -725,17 +1066,10 @@ MULTITREE_RESULT MultiTree_GetLeafValue(MULTITREE_HANDLE treeHandle, const char*
                 }
                 else
                 {
-                    for (i = 0; i < childCount; i++)
-                    {
-                        if (strncmp(node->children[i]->name, pos, whereIsDelimiter - pos) == 0)
-                        {
-                            /* Codes_SRS_MULTITREE_99_057:[ Subsequent names designate hierarchical children in the tree.] */
-                            node = node->children[i];
-                            break;
-                        }
-                    }
+                    /* Codes_SRS_MULTITREE_99_057:[ Subsequent names designate hierarchical children in the tree.] */
+                    child = getChildByName(node, pos, whereIsDelimiter - pos);
 
-                    if (i == childCount)
+                    if (child == NULL)
                     {
                         /* Codes_SRS_MULTITREE_99_071:[ When the child node is not found, MultiTree_GetLeafValue shall return MULTITREE_CHILD_NOT_FOUND.] */
                         result = MULTITREE_CHILD_NOT_FOUND;
@@ -744,6 +1078,7 @@ MULTITREE_RESULT MultiTree_GetLeafValue(MULTITREE_HANDLE treeHandle, const char*
                     }
                     else
                     {
+                        node = child;
                         if (*whereIsDelimiter == '/')
                         {
                             pos = whereIsDelimiter + 1;
@@ -822,6 +1157,9 @@ MULTITREE_RESULT MultiTree_DeleteChild(MULTITREE_HANDLE treeHandle, const char*
             /* Codes_SRS_MULTITREE_99_077:[ MultiTree_DeleteChild shall remove the direct children node (no recursive search) set by childName  */
             MultiTree_Destroy(treeToRemove);
 
+            /*the positions of the children after it changed, the index is rebuilt by the next lookup*/
+            dropChildIndex(treeHandle);
+
             // Even though this isn't reachable anymore after decrementing count, NULL out for cleanliness
             treeHandle->children[treeHandle->nChildren - 1] = NULL;
             treeHandle->nChildren = treeHandle->nChildren - 1;
@@ -2,6 +2,7 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
 #include <stdlib.h>
+#include <stdint.h>
 #include "azure_c_shared_utility/gballoc.h"
 
 #include "schema.h"
@@ -12,10 +13,15 @@
 
 DEFINE_ENUM_STRINGS(SCHEMA_RESULT, SCHEMA_RESULT_VALUES);
 
+/*model properties and actions are also chained in NameHash % SCHEMA_NAME_BUCKET_COUNT buckets so that lookups by name do not scan the whole model*/
+#define SCHEMA_NAME_BUCKET_COUNT 16
+
 typedef struct SCHEMA_PROPERTY_HANDLE_DATA_TAG
 {
     const char* PropertyName;
     const char* PropertyType;
+    uint32_t NameHash;
+    struct SCHEMA_PROPERTY_HANDLE_DATA_TAG* NextInBucket; /*only used for model properties*/
 } SCHEMA_PROPERTY_HANDLE_DATA;
 
 typedef struct SCHEMA_REPORTED_PROPERTY_HANDLE_DATA_TAG
@@ -33,6 +39,8 @@ typedef struct SCHEMA_DESIRED_PROPERTY_HANDLE_DATA_TAG
     const char* desiredPropertyType;
     pfDesiredPropertyFromAGENT_DATA_TYPE desiredPropertyFromAGENT_DATA_TYPE;
     size_t offset;
+    uint32_t NameHash;
+    struct SCHEMA_DESIRED_PROPERTY_HANDLE_DATA_TAG* NextInBucket;
 } SCHEMA_DESIRED_PROPERTY_HANDLE_DATA;
 
 typedef struct SCHEMA_ACTION_ARGUMENT_HANDLE_DATA_TAG
@@ -52,6 +60,8 @@ typedef struct SCHEMA_ACTION_HANDLE_DATA_TAG
     const char* ActionName;
     size_t ArgumentCount;
     SCHEMA_ACTION_ARGUMENT_HANDLE* ArgumentHandles;
+    uint32_t NameHash;
+    struct SCHEMA_ACTION_HANDLE_DATA_TAG* NextInBucket;
 } SCHEMA_ACTION_HANDLE_DATA;
 
 typedef struct SCHEMA_METHOD_HANDLE_DATA_TAG
@@ -81,6 +91,10 @@ typedef struct SCHEMA_MODEL_TYPE_HANDLE_DATA_TAG
     size_t ActionCount;
     VECTOR_HANDLE models;
     size_t DeviceCount;
+    SCHEMA_PROPERTY_HANDLE_DATA* PropertyBuckets[SCHEMA_NAME_BUCKET_COUNT];
+    SCHEMA_ACTION_HANDLE_DATA* ActionBuckets[SCHEMA_NAME_BUCKET_COUNT];
+    SCHEMA_DESIRED_PROPERTY_HANDLE_DATA* DesiredPropertyBuckets[SCHEMA_NAME_BUCKET_COUNT]; /*every member of a desired properties patch is looked up here*/
+    char* CommandMetadata; /*serialized once by SchemaSerializer_GetCommandMetadata, NULL until then*/
 } SCHEMA_MODEL_TYPE_HANDLE_DATA;
 
 typedef struct SCHEMA_STRUCT_TYPE_HANDLE_DATA_TAG
@@ -102,6 +116,55 @@ typedef struct SCHEMA_HANDLE_DATA_TAG
 
 static VECTOR_HANDLE g_schemas = NULL;
 
+/*32 bit FNV-1a*/
+static uint32_t HashName(const char* name)
+{
+    uint32_t result = 2166136261u;
+    while (*name != '\0')
+    {
+        result ^= (unsigned char)*name;
+        result *= 16777619u;
+        name++;
+    }
+    return result;
+}
+
+static SCHEMA_PROPERTY_HANDLE_DATA* FindModelProperty(const SCHEMA_MODEL_TYPE_HANDLE_DATA* modelType, const char* propertyName)
+{
+    uint32_t nameHash = HashName(propertyName);
+    SCHEMA_PROPERTY_HANDLE_DATA* result = modelType->PropertyBuckets[nameHash % SCHEMA_NAME_BUCKET_COUNT];
+    while ((result != NULL) &&
+        ((result->NameHash != nameHash) || (strcmp(result->PropertyName, propertyName) != 0)))
+    {
+        result = result->NextInBucket;
+    }
+    return result;
+}
+
+static SCHEMA_ACTION_HANDLE_DATA* FindModelAction(const SCHEMA_MODEL_TYPE_HANDLE_DATA* modelType, const char* actionName)
+{
+    uint32_t nameHash = HashName(actionName);
+    SCHEMA_ACTION_HANDLE_DATA* result = modelType->ActionBuckets[nameHash % SCHEMA_NAME_BUCKET_COUNT];
+    while ((result != NULL) &&
+        ((result->NameHash != nameHash) || (strcmp(result->ActionName, actionName) != 0)))
+    {
+        result = result->NextInBucket;
+    }
+    return result;
+}
+
+static SCHEMA_DESIRED_PROPERTY_HANDLE_DATA* FindModelDesiredProperty(const SCHEMA_MODEL_TYPE_HANDLE_DATA* modelType, const char* desiredPropertyName)
+{
+    uint32_t nameHash = HashName(desiredPropertyName);
+    SCHEMA_DESIRED_PROPERTY_HANDLE_DATA* result = modelType->DesiredPropertyBuckets[nameHash % SCHEMA_NAME_BUCKET_COUNT];
+    while ((result != NULL) &&
+        ((result->NameHash != nameHash) || (strcmp(result->desiredPropertyName, desiredPropertyName) != 0)))
+    {
+        result = result->NextInBucket;
+    }
+    return result;
+}
+
 static void DestroyProperty(SCHEMA_PROPERTY_HANDLE propertyHandle)
 {
     SCHEMA_PROPERTY_HANDLE_DATA* propertyType = (SCHEMA_PROPERTY_HANDLE_DATA*)propertyHandle;
@@ -244,6 +307,10 @@ static void DestroyModel(SCHEMA_MODEL_TYPE_HANDLE modelTypeHandle)
     VECTOR_destroy(modelType->models);
 
     free(modelType->Actions);
+    if (modelType->CommandMetadata != NULL)
+    {
+        free(modelType->CommandMetadata);
+    }
     free(modelType);
 }
 
@@ -261,19 +328,8 @@ static SCHEMA_RESULT AddModelProperty(SCHEMA_MODEL_TYPE_HANDLE_DATA* modelType,
     }
     else
     {
-        size_t i;
-
         /* Codes_SRS_SCHEMA_99_015:[The property name shall be unique per model, if the same property name is added twice to a model, SCHEMA_DUPLICATE_ELEMENT shall be returned.] */
-        for (i = 0; i < modelType->PropertyCount; i++)
-        {
-            SCHEMA_PROPERTY_HANDLE_DATA* property = (SCHEMA_PROPERTY_HANDLE_DATA*)modelType->Properties[i];
-            if (strcmp(property->PropertyName, name) == 0)
-            {
-                break;
-            }
-        }
-
-        if (i < modelType->PropertyCount)
+        if (FindModelProperty(modelType, name) != NULL)
         {
             result = SCHEMA_DUPLICATE_ELEMENT;
             LogError("(result = %s)", ENUM_TO_STRING(SCHEMA_RESULT, result));
@@ -317,6 +373,12 @@ static SCHEMA_RESULT AddModelProperty(SCHEMA_MODEL_TYPE_HANDLE_DATA* modelType,
                     }
                     else
                     {
+                        size_t bucket;
+                        newProperty->NameHash = HashName(name);
+                        bucket = newProperty->NameHash % SCHEMA_NAME_BUCKET_COUNT;
+                        newProperty->NextInBucket = modelType->PropertyBuckets[bucket];
+                        modelType->PropertyBuckets[bucket] = newProperty;
+
                         modelType->Properties[modelType->PropertyCount] = (SCHEMA_PROPERTY_HANDLE)newProperty;
                         modelType->PropertyCount++;
 
@@ -712,6 +774,13 @@ SCHEMA_MODEL_TYPE_HANDLE Schema_CreateModelType(SCHEMA_HANDLE schemaHandle, cons
                                     modelType->Actions = NULL;
                                     modelType->SchemaHandle = schemaHandle;
                                     modelType->DeviceCount = 0;
+                                    modelType->CommandMetadata = NULL;
+                                    for (i = 0; i < SCHEMA_NAME_BUCKET_COUNT; i++)
+                                    {
+                                        modelType->PropertyBuckets[i] = NULL;
+                                        modelType->ActionBuckets[i] = NULL;
+                                        modelType->DesiredPropertyBuckets[i] = NULL;
+                                    }
 
                                     schema->ModelTypes[schema->ModelTypeCount] = modelType;
                                     schema->ModelTypeCount++;
@@ -864,19 +933,9 @@ SCHEMA_ACTION_HANDLE Schema_CreateModelAction(SCHEMA_MODEL_TYPE_HANDLE modelType
     else
     {
         SCHEMA_MODEL_TYPE_HANDLE_DATA* modelType = (SCHEMA_MODEL_TYPE_HANDLE_DATA*)modelTypeHandle;
-        size_t i;
 
         /* Codes_SRS_SCHEMA_99_105: [The action name shall be unique per model, if the same action name is added twice to a model, Schema_CreateModelAction shall return NULL.] */
-        for (i = 0; i < modelType->ActionCount; i++)
-        {
-            SCHEMA_ACTION_HANDLE_DATA* action = (SCHEMA_ACTION_HANDLE_DATA*)modelType->Actions[i];
-            if (strcmp(action->ActionName, actionName) == 0)
-            {
-                break;
-            }
-        }
-
-        if (i < modelType->ActionCount)
+        if (FindModelAction(modelType, actionName) != NULL)
         {
             result = NULL;
             LogError("(Error code:%s)", ENUM_TO_STRING(SCHEMA_RESULT, SCHEMA_DUPLICATE_ELEMENT));
@@ -914,8 +973,13 @@ SCHEMA_ACTION_HANDLE Schema_CreateModelAction(SCHEMA_MODEL_TYPE_HANDLE modelType
                     }
                     else
                     {
+                        size_t bucket;
                         newAction->ArgumentCount = 0;
                         newAction->ArgumentHandles = NULL;
+                        newAction->NameHash = HashName(actionName);
+                        bucket = newAction->NameHash % SCHEMA_NAME_BUCKET_COUNT;
+                        newAction->NextInBucket = modelType->ActionBuckets[bucket];
+                        modelType->ActionBuckets[bucket] = newAction;
 
                         modelType->Actions[modelType->ActionCount] = newAction;
                         modelType->ActionCount++;
@@ -1243,29 +1307,14 @@ SCHEMA_PROPERTY_HANDLE Schema_GetModelPropertyByName(SCHEMA_MODEL_TYPE_HANDLE mo
     }
     else
     {
-        size_t i;
         SCHEMA_MODEL_TYPE_HANDLE_DATA* modelType = (SCHEMA_MODEL_TYPE_HANDLE_DATA*)modelTypeHandle;
 
         /* Codes_SRS_SCHEMA_99_036:[Schema_GetModelPropertyByName shall return a non-NULL SCHEMA_PROPERTY_HANDLE corresponding to the model type identified by modelTypeHandle and matching the propertyName argument value.] */
-        for (i = 0; i < modelType->PropertyCount; i++)
-        {
-            SCHEMA_PROPERTY_HANDLE_DATA* modelProperty = (SCHEMA_PROPERTY_HANDLE_DATA*)modelType->Properties[i];
-            if (strcmp(modelProperty->PropertyName, propertyName) == 0)
-            {
-                break;
-            }
-        }
-
-        if (i == modelType->PropertyCount)
+        if ((result = (SCHEMA_PROPERTY_HANDLE)FindModelProperty(modelType, propertyName)) == NULL)
         {
             /* Codes_SRS_SCHEMA_99_038:[Schema_GetModelPropertyByName shall return NULL if unable to find a matching property or if any of the arguments are NULL.] */
-            result = NULL;
             LogError("(Error code:%s)", ENUM_TO_STRING(SCHEMA_RESULT, SCHEMA_ELEMENT_NOT_FOUND));
         }
-        else
-        {
-            result = (SCHEMA_PROPERTY_HANDLE)(modelType->Properties[i]);
-        }
     }
 
     return result;
@@ -1411,29 +1460,14 @@ SCHEMA_ACTION_HANDLE Schema_GetModelActionByName(SCHEMA_MODEL_TYPE_HANDLE modelT
     }
     else
     {
-        size_t i;
         SCHEMA_MODEL_TYPE_HANDLE_DATA* modelType = (SCHEMA_MODEL_TYPE_HANDLE_DATA*)modelTypeHandle;
 
         /* Codes_SRS_SCHEMA_99_040:[Schema_GetModelActionByName shall return a non-NULL SCHEMA_ACTION_HANDLE corresponding to the model type identified by modelTypeHandle and matching the actionName argument value.] */
-        for (i = 0; i < modelType->ActionCount; i++)
-        {
-            SCHEMA_ACTION_HANDLE_DATA* modelAction = (SCHEMA_ACTION_HANDLE_DATA*)modelType->Actions[i];
-            if (strcmp(modelAction->ActionName, actionName) == 0)
-            {
-                break;
-            }
-        }
-
-        if (i == modelType->ActionCount)
+        if ((result = (SCHEMA_ACTION_HANDLE)FindModelAction(modelType, actionName)) == NULL)
         {
             /* Codes_SRS_SCHEMA_99_041:[Schema_GetModelActionByName shall return NULL if unable to find a matching action, if any of the arguments are NULL.] */
-            result = NULL;
             LogError("(Error code:%s)", ENUM_TO_STRING(SCHEMA_RESULT, SCHEMA_ELEMENT_NOT_FOUND));
         }
-        else
-        {
-            result = modelType->Actions[i];
-        }
     }
 
     return result;
@@ -1504,6 +1538,48 @@ SCHEMA_RESULT Schema_GetModelActionCount(SCHEMA_MODEL_TYPE_HANDLE modelTypeHandl
     return result;
 }
 
+SCHEMA_RESULT Schema_SetModelCommandMetadata(SCHEMA_MODEL_TYPE_HANDLE modelTypeHandle, const char* commandMetadata)
+{
+    SCHEMA_RESULT result;
+
+    /* Codes_SRS_SCHEMA_41_001: [ If modelTypeHandle or commandMetadata is NULL, Schema_SetModelCommandMetadata shall return SCHEMA_INVALID_ARG. ]*/
+    if ((modelTypeHandle == NULL) ||
+        (commandMetadata == NULL))
+    {
+        result = SCHEMA_INVALID_ARG;
+        LogError("(result=%s)", ENUM_TO_STRING(SCHEMA_RESULT, result));
+    }
+    else
+    {
+        SCHEMA_MODEL_TYPE_HANDLE_DATA* modelType = (SCHEMA_MODEL_TYPE_HANDLE_DATA*)modelTypeHandle;
+        char* copy;
+
+        /* Codes_SRS_SCHEMA_41_002: [ Schema_SetModelCommandMetadata shall keep a copy of commandMetadata with the model, in place of the one kept before, and return SCHEMA_OK; if copying fails it shall keep the previous one and return SCHEMA_ERROR. ]*/
+        if (mallocAndStrcpy_s(&copy, commandMetadata) != 0)
+        {
+            result = SCHEMA_ERROR;
+            LogError("(result=%s)", ENUM_TO_STRING(SCHEMA_RESULT, result));
+        }
+        else
+        {
+            if (modelType->CommandMetadata != NULL)
+            {
+                free(modelType->CommandMetadata);
+            }
+            modelType->CommandMetadata = copy;
+            result = SCHEMA_OK;
+        }
+    }
+
+    return result;
+}
+
+const char* Schema_GetModelCommandMetadata(SCHEMA_MODEL_TYPE_HANDLE modelTypeHandle)
+{
+    /* Codes_SRS_SCHEMA_41_003: [ Schema_GetModelCommandMetadata shall return the command metadata kept with the model, or NULL if modelTypeHandle is NULL or none was kept. ]*/
+    return (modelTypeHandle == NULL) ? NULL : ((SCHEMA_MODEL_TYPE_HANDLE_DATA*)modelTypeHandle)->CommandMetadata;
+}
+
 SCHEMA_ACTION_HANDLE Schema_GetModelActionByIndex(SCHEMA_MODEL_TYPE_HANDLE modelTypeHandle, size_t index)
 {
     SCHEMA_ACTION_HANDLE result;
@@ -2811,6 +2887,9 @@ SCHEMA_RESULT Schema_AddModelDesiredProperty(SCHEMA_MODEL_TYPE_HANDLE modelTypeH
                             desiredProperty->desiredPropertDeinitialize = desiredPropertyDeinitialize;
                             desiredProperty->onDesiredProperty = onDesiredProperty; /*NULL is a perfectly fine value*/
                             desiredProperty->offset = offset;
+                            desiredProperty->NameHash = HashName(desiredPropertyName);
+                            desiredProperty->NextInBucket = handleData->DesiredPropertyBuckets[desiredProperty->NameHash % SCHEMA_NAME_BUCKET_COUNT];
+                            handleData->DesiredPropertyBuckets[desiredProperty->NameHash % SCHEMA_NAME_BUCKET_COUNT] = desiredProperty;
                             result = SCHEMA_OK;
                         }
                     }
@@ -3082,31 +3161,17 @@ SCHEMA_MODEL_ELEMENT Schema_GetModelElementByName(SCHEMA_MODEL_TYPE_HANDLE model
     {
         SCHEMA_MODEL_TYPE_HANDLE_DATA* handleData = (SCHEMA_MODEL_TYPE_HANDLE_DATA*)modelTypeHandle;
 
-        SCHEMA_DESIRED_PROPERTY_HANDLE* desiredPropertyHandle = VECTOR_find_if(handleData->desiredProperties, desiredPropertyExists, elementName);
-        if (desiredPropertyHandle != NULL)
+        SCHEMA_DESIRED_PROPERTY_HANDLE_DATA* desiredProperty = FindModelDesiredProperty(handleData, elementName);
+        if (desiredProperty != NULL)
         {
             /*Codes_SRS_SCHEMA_02_080: [ If elementName is a desired property then Schema_GetModelElementByName shall succeed and set SCHEMA_MODEL_ELEMENT.elementType to SCHEMA_DESIRED_PROPERTY and SCHEMA_MODEL_ELEMENT.elementHandle.desiredPropertyHandle to the handle of the desired property. ]*/
             result.elementType = SCHEMA_DESIRED_PROPERTY;
-            result.elementHandle.desiredPropertyHandle = *desiredPropertyHandle;
+            result.elementHandle.desiredPropertyHandle = desiredProperty;
         }
         else
         {
-            size_t nProcessedProperties = 0;
-            SCHEMA_PROPERTY_HANDLE_DATA* property = NULL;
-            for (size_t i = 0; i < handleData->PropertyCount;i++)
-            {
-                property = (SCHEMA_PROPERTY_HANDLE_DATA*)(handleData->Properties[i]);
-                if (strcmp(property->PropertyName, elementName) == 0)
-                {
-                    i = handleData->PropertyCount; /*found it*/
-                }
-                else
-                {
-                    nProcessedProperties++;
-                }
-            }
-
-            if (nProcessedProperties < handleData->PropertyCount)
+            SCHEMA_PROPERTY_HANDLE_DATA* property = FindModelProperty(handleData, elementName);
+            if (property != NULL)
             {
                 /*Codes_SRS_SCHEMA_02_078: [ If elementName is a property then Schema_GetModelElementByName shall succeed and set SCHEMA_MODEL_ELEMENT.elementType to SCHEMA_PROPERTY and SCHEMA_MODEL_ELEMENT.elementHandle.propertyHandle to the handle of the property. ]*/
                 result.elementType = SCHEMA_PROPERTY;
@@ -3124,23 +3189,8 @@ SCHEMA_MODEL_ELEMENT Schema_GetModelElementByName(SCHEMA_MODEL_TYPE_HANDLE model
                 }
                 else
                 {
-
-                    size_t nProcessedActions = 0;
-                    SCHEMA_ACTION_HANDLE_DATA* actionHandleData = NULL;
-                    for (size_t i = 0;i < handleData->ActionCount; i++)
-                    {
-                        actionHandleData = (SCHEMA_ACTION_HANDLE_DATA*)(handleData->Actions[i]);
-                        if (strcmp(actionHandleData->ActionName, elementName) == 0)
-                        {
-                            i = handleData->ActionCount; /*get out quickly*/
-                        }
-                        else
-                        {
-                            nProcessedActions++;
-                        }
-                    }
-
-                    if (nProcessedActions < handleData->ActionCount)
+                    SCHEMA_ACTION_HANDLE_DATA* actionHandleData = FindModelAction(handleData, elementName);
+                    if (actionHandleData != NULL)
                     {
                         /*Codes_SRS_SCHEMA_02_081: [ If elementName is a model action then Schema_GetModelElementByName shall succeed and set SCHEMA_MODEL_ELEMENT.elementType to SCHEMA_MODEL_ACTION and SCHEMA_MODEL_ELEMENT.elementHandle.actionHandle to the handle of the action. ]*/
                         result.elementType = SCHEMA_MODEL_ACTION;
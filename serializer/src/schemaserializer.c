@@ -172,3 +172,52 @@ SCHEMA_SERIALIZER_RESULT SchemaSerializer_SerializeCommandMetadata(SCHEMA_MODEL_
 
     return result;
 }
+
+SCHEMA_SERIALIZER_RESULT SchemaSerializer_GetCommandMetadata(SCHEMA_MODEL_TYPE_HANDLE modelHandle, const char** commandMetadata)
+{
+    SCHEMA_SERIALIZER_RESULT result;
+
+    /* Codes_SRS_SCHEMA_SERIALIZER_41_001: [If the modelHandle or commandMetadata argument is NULL, SchemaSerializer_GetCommandMetadata shall return SCHEMA_SERIALIZER_INVALID_ARG.] */
+    if ((modelHandle == NULL) ||
+        (commandMetadata == NULL))
+    {
+        result = SCHEMA_SERIALIZER_INVALID_ARG;
+        LogError("(result = %s), modelHandle = %p, commandMetadata = %p", ENUM_TO_STRING(SCHEMA_SERIALIZER_RESULT, result), modelHandle, commandMetadata);
+    }
+    /* Codes_SRS_SCHEMA_SERIALIZER_41_002: [If the metadata of the model was already serialized, SchemaSerializer_GetCommandMetadata shall set commandMetadata to it, without walking the model, and return SCHEMA_SERIALIZER_OK.] */
+    else if ((*commandMetadata = Schema_GetModelCommandMetadata(modelHandle)) != NULL)
+    {
+        result = SCHEMA_SERIALIZER_OK;
+    }
+    else
+    {
+        STRING_HANDLE schemaText;
+
+        /* Codes_SRS_SCHEMA_SERIALIZER_41_003: [Otherwise SchemaSerializer_GetCommandMetadata shall serialize the metadata as SchemaSerializer_SerializeCommandMetadata does, keep it with the model by calling Schema_SetModelCommandMetadata, and set commandMetadata to the kept text, which stays valid until the schema is destroyed.] */
+        if ((schemaText = STRING_new()) == NULL)
+        {
+            /* Codes_SRS_SCHEMA_SERIALIZER_41_004: [If any of the Schema or String APIs fail then SchemaSerializer_GetCommandMetadata shall return SCHEMA_SERIALIZER_ERROR.] */
+            result = SCHEMA_SERIALIZER_ERROR;
+            LOG_SCHEMA_SERIALIZER_ERROR(result);
+        }
+        else
+        {
+            if ((SchemaSerializer_SerializeCommandMetadata(modelHandle, schemaText) != SCHEMA_SERIALIZER_OK) ||
+                (Schema_SetModelCommandMetadata(modelHandle, STRING_c_str(schemaText)) != SCHEMA_OK) ||
+                ((*commandMetadata = Schema_GetModelCommandMetadata(modelHandle)) == NULL))
+            {
+                /* Codes_SRS_SCHEMA_SERIALIZER_41_004: [If any of the Schema or String APIs fail then SchemaSerializer_GetCommandMetadata shall return SCHEMA_SERIALIZER_ERROR.] */
+                result = SCHEMA_SERIALIZER_ERROR;
+                LOG_SCHEMA_SERIALIZER_ERROR(result);
+            }
+            else
+            {
+                result = SCHEMA_SERIALIZER_OK;
+            }
+
+            STRING_delete(schemaText);
+        }
+    }
+
+    return result;
+}
@@ -6212,6 +6212,50 @@ BEGIN_TEST_SUITE(AgentTypeSystem_ut)
             Destroy_AGENT_DATA_TYPE(&srcMember[1]);
         }
 
+        /*Tests_SRS_AGENT_TYPE_SYSTEM_41_001: [ Create_AGENT_DATA_TYPE_from_Members shall allocate the fields, their values and a copy of memberNames in a single allocation. ]*/
+        /*Tests_SRS_AGENT_TYPE_SYSTEM_41_002: [ Create_AGENT_DATA_TYPE_from_AGENT_DATA_TYPE shall copy the fields of a complex type, their values and their names in a single allocation. ]*/
+        TEST_FUNCTION(Create_AGENT_DATA_TYPE_From_AGENT_DATA_TYPE_With_nested_ComplexType_copies_names_and_values)
+        {
+            ///arrange
+            AGENT_DATA_TYPE innerMember[2];
+            AGENT_DATA_TYPE outerMember[2];
+            AGENT_DATA_TYPE srcStruct;
+            AGENT_DATA_TYPE dst;
+            char innerNames[2][10] = { "lat", "long" };
+            const char* innerMemberNames[] = { innerNames[0], innerNames[1] };
+            const char* outerMemberNames[] = { "where", "speed" };
+
+            (void)Create_AGENT_DATA_TYPE_from_DOUBLE(&innerMember[0], 47.64);
+            (void)Create_AGENT_DATA_TYPE_from_DOUBLE(&innerMember[1], -122.13);
+            (void)Create_AGENT_DATA_TYPE_from_Members(&outerMember[0], "Location", 2, innerMemberNames, innerMember);
+            (void)Create_AGENT_DATA_TYPE_from_SINT32(&outerMember[1], 42);
+            (void)Create_AGENT_DATA_TYPE_from_Members(&srcStruct, "Car", 2, outerMemberNames, outerMember);
+            innerNames[0][0] = 'X';
+
+            ///act
+            AGENT_DATA_TYPES_RESULT result = Create_AGENT_DATA_TYPE_from_AGENT_DATA_TYPE(&dst, &srcStruct);
+
+            ///assert
+            ASSERT_ARE_EQUAL(AGENT_DATA_TYPES_RESULT, AGENT_DATA_TYPES_OK, result);
+            ASSERT_ARE_EQUAL(char_ptr, "where", dst.value.edmComplexType.fields[0].fieldName);
+            ASSERT_IS_TRUE(srcStruct.value.edmComplexType.fields[0].fieldName != dst.value.edmComplexType.fields[0].fieldName);
+            ASSERT_IS_TRUE(srcStruct.value.edmComplexType.fields[0].value != dst.value.edmComplexType.fields[0].value);
+            ASSERT_ARE_EQUAL(AGENT_DATA_TYPE_TYPE, EDM_COMPLEX_TYPE_TYPE, dst.value.edmComplexType.fields[0].value->type);
+            ASSERT_ARE_EQUAL(char_ptr, "lat", dst.value.edmComplexType.fields[0].value->value.edmComplexType.fields[0].fieldName);
+            ASSERT_ARE_EQUAL(char_ptr, "long", dst.value.edmComplexType.fields[0].value->value.edmComplexType.fields[1].fieldName);
+            ASSERT_ARE_EQUAL(double, -122.13, dst.value.edmComplexType.fields[0].value->value.edmComplexType.fields[1].value->value.edmDouble.value);
+            ASSERT_ARE_EQUAL(char_ptr, "speed", dst.value.edmComplexType.fields[1].fieldName);
+            ASSERT_ARE_EQUAL(int32_t, 42, dst.value.edmComplexType.fields[1].value->value.edmInt32.value);
+
+            ///cleanup
+            Destroy_AGENT_DATA_TYPE(&srcStruct);
+            Destroy_AGENT_DATA_TYPE(&dst);
+            Destroy_AGENT_DATA_TYPE(&outerMember[0]);
+            Destroy_AGENT_DATA_TYPE(&outerMember[1]);
+            Destroy_AGENT_DATA_TYPE(&innerMember[0]);
+            Destroy_AGENT_DATA_TYPE(&innerMember[1]);
+        }
+
         /*Tests_SRS_AGENT_TYPE_SYSTEM_99_039:[ Creates an AGENT_DATA_TYPE containing an EDM_DECIMAL from a null-terminated string.]*/ /*this and the next few hundred lines of code*/
         TEST_FUNCTION(Create_EDM_DECIMAL_From_NULL_string_fails)
         {
@@ -12090,6 +12134,44 @@ BEGIN_TEST_SUITE(AgentTypeSystem_ut)
             Destroy_AGENT_DATA_TYPE(&agentData);
         }
 
+        /* Tests_SRS_AGENT_TYPE_SYSTEM_99_080:[ EDM_DOUBLE] */
+        TEST_FUNCTION(AgentTypeSystem_CreateAgentDataType_From_String_EDM_DOUBLE_With_Leading_Zeroes_And_Exponent_Succeeds)
+        {
+            // arrange
+            AGENT_DATA_TYPE agentData;
+            const char* source = "-0.0004242E+5";
+
+            // act
+            AGENT_DATA_TYPES_RESULT result = CreateAgentDataType_From_String(source, EDM_DOUBLE_TYPE, &agentData);
+
+            // assert
+            ASSERT_ARE_EQUAL(AGENT_DATA_TYPES_RESULT, AGENT_DATA_TYPES_OK, result);
+            ASSERT_ARE_EQUAL(AGENT_DATA_TYPE_TYPE, EDM_DOUBLE_TYPE, agentData.type);
+            ASSERT_ARE_EQUAL(double, (double)-42.42, agentData.value.edmDouble.value);
+
+            // cleanup
+            Destroy_AGENT_DATA_TYPE(&agentData);
+        }
+
+        /* Tests_SRS_AGENT_TYPE_SYSTEM_99_080:[ EDM_DOUBLE] */
+        TEST_FUNCTION(AgentTypeSystem_CreateAgentDataType_From_String_EDM_DOUBLE_With_More_Than_19_Digits_Succeeds)
+        {
+            // arrange
+            AGENT_DATA_TYPE agentData;
+            const char* source = "12345678901234567890123.5";
+
+            // act
+            AGENT_DATA_TYPES_RESULT result = CreateAgentDataType_From_String(source, EDM_DOUBLE_TYPE, &agentData);
+
+            // assert
+            ASSERT_ARE_EQUAL(AGENT_DATA_TYPES_RESULT, AGENT_DATA_TYPES_OK, result);
+            ASSERT_ARE_EQUAL(AGENT_DATA_TYPE_TYPE, EDM_DOUBLE_TYPE, agentData.type);
+            ASSERT_ARE_EQUAL(double, (double)12345678901234567890123.5, agentData.value.edmDouble.value);
+
+            // cleanup
+            Destroy_AGENT_DATA_TYPE(&agentData);
+        }
+
         /* Tests_SRS_AGENT_TYPE_SYSTEM_99_080:[ EDM_DOUBLE] */
         TEST_FUNCTION(AgentTypeSystem_CreateAgentDataType_From_String_EDM_DOUBLE_Negative_Value_Succeeds)
         {
@@ -13122,6 +13204,36 @@ BEGIN_TEST_SUITE(AgentTypeSystem_ut)
             }
         }
 
+        /*Tests_SRS_AGENT_TYPE_SYSTEM_99_099:[ EDM_BINARY: = *(4base64char) [ base64b16  / base64b8 ]]*/
+        TEST_FUNCTION(AgentDataTypes_ToString_large_BINARY_round_trips)
+        {
+            ///arrange
+            unsigned char data[1000];
+            EDM_BINARY binary = { sizeof(data), data };
+            AGENT_DATA_TYPE ag, parsed;
+            for (size_t i = 0; i < sizeof(data); i++)
+            {
+                data[i] = (unsigned char)(i * 7 + 3);
+            }
+            (void)Create_AGENT_DATA_TYPE_from_EDM_BINARY(&ag, binary);
+            STRING_empty(global_bufferTemp);
+
+            ///act
+            auto res1 = AgentDataTypes_ToString(global_bufferTemp, &ag);
+            auto res2 = CreateAgentDataType_From_String(STRING_c_str(global_bufferTemp), EDM_BINARY_TYPE, &parsed);
+
+            ///assert
+            ASSERT_ARE_EQUAL(AGENT_DATA_TYPES_RESULT, AGENT_DATA_TYPES_OK, res1);
+            ASSERT_ARE_EQUAL(AGENT_DATA_TYPES_RESULT, AGENT_DATA_TYPES_OK, res2);
+            ASSERT_ARE_EQUAL(size_t, (size_t)(2 + 1336), strlen(STRING_c_str(global_bufferTemp)));
+            ASSERT_ARE_EQUAL(size_t, sizeof(data), parsed.value.edmBinary.size);
+            ASSERT_ARE_EQUAL(int, 0, memcmp(data, parsed.value.edmBinary.data, sizeof(data)));
+
+            ///cleanup
+            Destroy_AGENT_DATA_TYPE(&ag);
+            Destroy_AGENT_DATA_TYPE(&parsed);
+        }
+
         /*Tests_SRS_AGENT_TYPE_SYSTEM_99_013:[ All the functions shall check their parameters for validity. When an invalid parameter is detected, the value AGENT_DATA_TYPES_INVALID_ARG shall be returned ]*/
         TEST_FUNCTION(AgentDataTypes_ToString_EDM_BINARY_with_insufficient_buffer_fails)
         {
@@ -0,0 +1,450 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstring>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#endif
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+
+#include "azure_c_shared_utility/macro_utils.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/strings.h"
+#include "azure_c_shared_utility/base64.h"
+#undef ENABLE_MOCKS
+
+#include "real_strings.h"
+
+#include "cbordecoder.h"
+
+TEST_DEFINE_ENUM_TYPE(CBOR_DECODER_RESULT, CBOR_DECODER_RESULT_VALUES);
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+static STRING_HANDLE my_Base64_Encode_Bytes(const unsigned char* source, size_t size)
+{
+    (void)source;
+    (void)size;
+    return real_STRING_construct("AQID");
+}
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+static STRING_HANDLE json;
+
+static CBOR_DECODER_RESULT test_ToJSON(const unsigned char* source, size_t sourceSize)
+{
+    return CBORDecoder_ToJSON(source, sourceSize, json);
+}
+
+BEGIN_TEST_SUITE(cbordecoder_ut)
+
+    TEST_SUITE_INITIALIZE(TestClassInitialize)
+    {
+        TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+        g_testByTest = TEST_MUTEX_CREATE();
+        ASSERT_IS_NOT_NULL(g_testByTest);
+
+        (void)umock_c_init(on_umock_c_error);
+        (void)umocktypes_charptr_register_types();
+        (void)umocktypes_stdint_register_types();
+
+        REGISTER_UMOCK_ALIAS_TYPE(STRING_HANDLE, void*);
+
+        REGISTER_STRING_GLOBAL_MOCK_HOOK;
+        REGISTER_GLOBAL_MOCK_HOOK(Base64_Encode_Bytes, my_Base64_Encode_Bytes);
+    }
+
+    TEST_SUITE_CLEANUP(TestClassCleanup)
+    {
+        umock_c_deinit();
+
+        TEST_MUTEX_DESTROY(g_testByTest);
+        TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    }
+
+    TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+    {
+        if (TEST_MUTEX_ACQUIRE(g_testByTest))
+        {
+            ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+        }
+
+        json = real_STRING_new();
+        umock_c_reset_all_calls();
+    }
+
+    TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+    {
+        real_STRING_delete(json);
+        TEST_MUTEX_RELEASE(g_testByTest);
+    }
+
+    /*Tests_SRS_CBOR_DECODER_41_001: [ If source or destination is NULL, or sourceSize is 0, CBORDecoder_ToJSON shall return CBOR_DECODER_INVALID_ARG. ]*/
+    TEST_FUNCTION(CBORDecoder_ToJSON_with_NULL_source_fails)
+    {
+        ///act
+        CBOR_DECODER_RESULT result = CBORDecoder_ToJSON(NULL, 1, json);
+
+        ///assert
+        ASSERT_ARE_EQUAL(CBOR_DECODER_RESULT, CBOR_DECODER_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /*Tests_SRS_CBOR_DECODER_41_001: [ If source or destination is NULL, or sourceSize is 0, CBORDecoder_ToJSON shall return CBOR_DECODER_INVALID_ARG. ]*/
+    TEST_FUNCTION(CBORDecoder_ToJSON_with_0_sourceSize_fails)
+    {
+        ///arrange
+        static const unsigned char source[] = { 0x01 };
+
+        ///act
+        CBOR_DECODER_RESULT result = CBORDecoder_ToJSON(source, 0, json);
+
+        ///assert
+        ASSERT_ARE_EQUAL(CBOR_DECODER_RESULT, CBOR_DECODER_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /*Tests_SRS_CBOR_DECODER_41_001: [ If source or destination is NULL, or sourceSize is 0, CBORDecoder_ToJSON shall return CBOR_DECODER_INVALID_ARG. ]*/
+    TEST_FUNCTION(CBORDecoder_ToJSON_with_NULL_destination_fails)
+    {
+        ///arrange
+        static const unsigned char source[] = { 0x01 };
+
+        ///act
+        CBOR_DECODER_RESULT result = CBORDecoder_ToJSON(source, sizeof(source), NULL);
+
+        ///assert
+        ASSERT_ARE_EQUAL(CBOR_DECODER_RESULT, CBOR_DECODER_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /*Tests_SRS_CBOR_DECODER_41_002: [ CBORDecoder_ToJSON shall append to destination the JSON text of the single CBOR item in source. ]*/
+    /*Tests_SRS_CBOR_DECODER_41_004: [ Integers, false, true, null and floating point numbers shall be written as the JSON literals with the same value. ]*/
+    /*Tests_SRS_CBOR_DECODER_41_007: [ Arrays and maps, of definite or indefinite length, shall be written as JSON arrays and objects. ]*/
+    TEST_FUNCTION(CBORDecoder_ToJSON_with_a_definite_map_succeeds)
+    {
+        ///arrange
+        /*{"a": 1, "b": [2, -300]}*/
+        static const unsigned char source[] = { 0xA2, 0x61, 'a', 0x01, 0x61, 'b', 0x82, 0x02, 0x39, 0x01, 0x2B };
+
+        ///act
+        CBOR_DECODER_RESULT result = test_ToJSON(source, sizeof(source));
+
+        ///assert
+        ASSERT_ARE_EQUAL(CBOR_DECODER_RESULT, CBOR_DECODER_OK, result);
+        ASSERT_ARE_EQUAL(char_ptr, "{\"a\":1,\"b\":[2,-300]}", real_STRING_c_str(json));
+    }
+
+    /*Tests_SRS_CBOR_DECODER_41_007: [ Arrays and maps, of definite or indefinite length, shall be written as JSON arrays and objects. ]*/
+    TEST_FUNCTION(CBORDecoder_ToJSON_with_an_indefinite_map_succeeds)
+    {
+        ///arrange
+        /*{_ "a": true, "b": false, "c": null}*/
+        static const unsigned char source[] = { 0xBF, 0x61, 'a', 0xF5, 0x61, 'b', 0xF4, 0x61, 'c', 0xF6, 0xFF };
+
+        ///act
+        CBOR_DECODER_RESULT result = test_ToJSON(source, sizeof(source));
+
+        ///assert
+        ASSERT_ARE_EQUAL(CBOR_DECODER_RESULT, CBOR_DECODER_OK, result);
+        ASSERT_ARE_EQUAL(char_ptr, "{\"a\":true,\"b\":false,\"c\":null}", real_STRING_c_str(json));
+    }
+
+    /*Tests_SRS_CBOR_DECODER_41_004: [ Integers, false, true, null and floating point numbers shall be written as the JSON literals with the same value. ]*/
+    TEST_FUNCTION(CBORDecoder_ToJSON_with_64_bit_integers_succeeds)
+    {
+        ///arrange
+        static const unsigned char source[] = { 0x82,
+            0x1B, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+            0x3B, 0x7F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+
+        ///act
+        CBOR_DECODER_RESULT result = test_ToJSON(source, sizeof(source));
+
+        ///assert
+        ASSERT_ARE_EQUAL(CBOR_DECODER_RESULT, CBOR_DECODER_OK, result);
+        ASSERT_ARE_EQUAL(char_ptr, "[18446744073709551615,-9223372036854775808]", real_STRING_c_str(json));
+    }
+
+#ifndef NO_FLOATS
+    /*Tests_SRS_CBOR_DECODER_41_004: [ Integers, false, true, null and floating point numbers shall be written as the JSON literals with the same value. ]*/
+    TEST_FUNCTION(CBORDecoder_ToJSON_with_floating_point_numbers_succeeds)
+    {
+        ///arrange
+        /*[1.5 (half), -4.0 (half), 1.5 (single), 0.1 (double)]*/
+        static const unsigned char source[] = { 0x84,
+            0xF9, 0x3E, 0x00,
+            0xF9, 0xC4, 0x00,
+            0xFA, 0x3F, 0xC0, 0x00, 0x00,
+            0xFB, 0x3F, 0xB9, 0x99, 0x99, 0x99, 0x99, 0x99, 0x9A };
+
+        ///act
+        CBOR_DECODER_RESULT result = test_ToJSON(source, sizeof(source));
+
+        ///assert
+        ASSERT_ARE_EQUAL(CBOR_DECODER_RESULT, CBOR_DECODER_OK, result);
+        ASSERT_ARE_EQUAL(char_ptr, "[1.5,-4,1.5,0.1]", real_STRING_c_str(json));
+    }
+
+    /*Tests_SRS_CBOR_DECODER_41_010: [ If a value cannot be represented in JSON (NaN, infinities, the integer -2^64, simple values other than false, true and null) CBORDecoder_ToJSON shall return CBOR_DECODER_UNSUPPORTED. ]*/
+    TEST_FUNCTION(CBORDecoder_ToJSON_with_NaN_fails)
+    {
+        ///arrange
+        static const unsigned char source[] = { 0xF9, 0x7E, 0x00 };
+
+        ///act
+        CBOR_DECODER_RESULT result = test_ToJSON(source, sizeof(source));
+
+        ///assert
+        ASSERT_ARE_EQUAL(CBOR_DECODER_RESULT, CBOR_DECODER_UNSUPPORTED, result);
+    }
+#endif
+
+    /*Tests_SRS_CBOR_DECODER_41_010: [ If a value cannot be represented in JSON (NaN, infinities, the integer -2^64, simple values other than false, true and null) CBORDecoder_ToJSON shall return CBOR_DECODER_UNSUPPORTED. ]*/
+    TEST_FUNCTION(CBORDecoder_ToJSON_with_minus_2_to_the_64_fails)
+    {
+        ///arrange
+        static const unsigned char source[] = { 0x3B, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+
+        ///act
+        CBOR_DECODER_RESULT result = test_ToJSON(source, sizeof(source));
+
+        ///assert
+        ASSERT_ARE_EQUAL(CBOR_DECODER_RESULT, CBOR_DECODER_UNSUPPORTED, result);
+    }
+
+    /*Tests_SRS_CBOR_DECODER_41_010: [ If a value cannot be represented in JSON (NaN, infinities, the integer -2^64, simple values other than false, true and null) CBORDecoder_ToJSON shall return CBOR_DECODER_UNSUPPORTED. ]*/
+    TEST_FUNCTION(CBORDecoder_ToJSON_with_undefined_fails)
+    {
+        ///arrange
+        static const unsigned char source[] = { 0xF7 };
+
+        ///act
+        CBOR_DECODER_RESULT result = test_ToJSON(source, sizeof(source));
+
+        ///assert
+        ASSERT_ARE_EQUAL(CBOR_DECODER_RESULT, CBOR_DECODER_UNSUPPORTED, result);
+    }
+
+    /*Tests_SRS_CBOR_DECODER_41_005: [ A text string shall be written as a JSON string, escaping quotation marks, reverse solidi and control characters. ]*/
+    TEST_FUNCTION(CBORDecoder_ToJSON_escapes_text_strings)
+    {
+        ///arrange
+        static const unsigned char source[] = { 0x65, '"', 'a', '\\', '\n', 0x01 };
+
+        ///act
+        CBOR_DECODER_RESULT result = test_ToJSON(source, sizeof(source));
+
+        ///assert
+        ASSERT_ARE_EQUAL(CBOR_DECODER_RESULT, CBOR_DECODER_OK, result);
+        ASSERT_ARE_EQUAL(char_ptr, "\"\\\"a\\\\\\u000a\\u0001\"", real_STRING_c_str(json));
+    }
+
+    /*Tests_SRS_CBOR_DECODER_41_006: [ A byte string shall be written as a JSON string holding its base64 encoding. ]*/
+    TEST_FUNCTION(CBORDecoder_ToJSON_writes_byte_strings_in_base64)
+    {
+        ///arrange
+        static const unsigned char source[] = { 0x43, 0x01, 0x02, 0x03 };
+        STRICT_EXPECTED_CALL(Base64_Encode_Bytes(source + 1, 3));
+        STRICT_EXPECTED_CALL(STRING_concat(json, "\""));
+        STRICT_EXPECTED_CALL(STRING_concat_with_STRING(json, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(STRING_concat(json, "\""));
+        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+
+        ///act
+        CBOR_DECODER_RESULT result = test_ToJSON(source, sizeof(source));
+
+        ///assert
+        ASSERT_ARE_EQUAL(CBOR_DECODER_RESULT, CBOR_DECODER_OK, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(char_ptr, "\"AQID\"", real_STRING_c_str(json));
+    }
+
+    /*Tests_SRS_CBOR_DECODER_41_006: [ A byte string shall be written as a JSON string holding its base64 encoding. ]*/
+    TEST_FUNCTION(CBORDecoder_ToJSON_when_Base64_Encode_Bytes_fails_fails)
+    {
+        ///arrange
+        static const unsigned char source[] = { 0x43, 0x01, 0x02, 0x03 };
+        STRICT_EXPECTED_CALL(Base64_Encode_Bytes(source + 1, 3))
+            .SetReturn(NULL);
+
+        ///act
+        CBOR_DECODER_RESULT result = test_ToJSON(source, sizeof(source));
+
+        ///assert
+        ASSERT_ARE_EQUAL(CBOR_DECODER_RESULT, CBOR_DECODER_ERROR, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /*Tests_SRS_CBOR_DECODER_41_008: [ If a map key is not a text string, CBORDecoder_ToJSON shall return CBOR_DECODER_UNSUPPORTED. ]*/
+    TEST_FUNCTION(CBORDecoder_ToJSON_with_an_integer_key_fails)
+    {
+        ///arrange
+        static const unsigned char source[] = { 0xA1, 0x01, 0x02 };
+
+        ///act
+        CBOR_DECODER_RESULT result = test_ToJSON(source, sizeof(source));
+
+        ///assert
+        ASSERT_ARE_EQUAL(CBOR_DECODER_RESULT, CBOR_DECODER_UNSUPPORTED, result);
+    }
+
+    /*Tests_SRS_CBOR_DECODER_41_003: [ If source has bytes after the first item, CBORDecoder_ToJSON shall return CBOR_DECODER_SYNTAX_ERROR. ]*/
+    TEST_FUNCTION(CBORDecoder_ToJSON_with_trailing_bytes_fails)
+    {
+        ///arrange
+        static const unsigned char source[] = { 0x01, 0x01 };
+
+        ///act
+        CBOR_DECODER_RESULT result = test_ToJSON(source, sizeof(source));
+
+        ///assert
+        ASSERT_ARE_EQUAL(CBOR_DECODER_RESULT, CBOR_DECODER_SYNTAX_ERROR, result);
+    }
+
+    /*Tests_SRS_CBOR_DECODER_41_009: [ If source is not well formed CBOR, CBORDecoder_ToJSON shall return CBOR_DECODER_SYNTAX_ERROR. ]*/
+    TEST_FUNCTION(CBORDecoder_ToJSON_with_a_truncated_string_fails)
+    {
+        ///arrange
+        static const unsigned char source[] = { 0x68, 'a', 'b' };
+
+        ///act
+        CBOR_DECODER_RESULT result = test_ToJSON(source, sizeof(source));
+
+        ///assert
+        ASSERT_ARE_EQUAL(CBOR_DECODER_RESULT, CBOR_DECODER_SYNTAX_ERROR, result);
+    }
+
+    /*Tests_SRS_CBOR_DECODER_41_009: [ If source is not well formed CBOR, CBORDecoder_ToJSON shall return CBOR_DECODER_SYNTAX_ERROR. ]*/
+    TEST_FUNCTION(CBORDecoder_ToJSON_with_an_unterminated_indefinite_array_fails)
+    {
+        ///arrange
+        static const unsigned char source[] = { 0x9F, 0x01 };
+
+        ///act
+        CBOR_DECODER_RESULT result = test_ToJSON(source, sizeof(source));
+
+        ///assert
+        ASSERT_ARE_EQUAL(CBOR_DECODER_RESULT, CBOR_DECODER_SYNTAX_ERROR, result);
+    }
+
+    /*Tests_SRS_CBOR_DECODER_41_009: [ If source is not well formed CBOR, CBORDecoder_ToJSON shall return CBOR_DECODER_SYNTAX_ERROR. ]*/
+    TEST_FUNCTION(CBORDecoder_ToJSON_with_a_count_larger_than_the_source_fails)
+    {
+        ///arrange
+        static const unsigned char source[] = { 0x9B, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+
+        ///act
+        CBOR_DECODER_RESULT result = test_ToJSON(source, sizeof(source));
+
+        ///assert
+        ASSERT_ARE_EQUAL(CBOR_DECODER_RESULT, CBOR_DECODER_SYNTAX_ERROR, result);
+    }
+
+    /*Tests_SRS_CBOR_DECODER_41_009: [ If source is not well formed CBOR, CBORDecoder_ToJSON shall return CBOR_DECODER_SYNTAX_ERROR. ]*/
+    TEST_FUNCTION(CBORDecoder_ToJSON_with_a_reserved_additional_information_fails)
+    {
+        ///arrange
+        static const unsigned char source[] = { 0x1C };
+
+        ///act
+        CBOR_DECODER_RESULT result = test_ToJSON(source, sizeof(source));
+
+        ///assert
+        ASSERT_ARE_EQUAL(CBOR_DECODER_RESULT, CBOR_DECODER_SYNTAX_ERROR, result);
+    }
+
+    /*Tests_SRS_CBOR_DECODER_41_011: [ If items are nested deeper than CBOR_DECODER_MAX_DEPTH, CBORDecoder_ToJSON shall return CBOR_DECODER_UNSUPPORTED. ]*/
+    TEST_FUNCTION(CBORDecoder_ToJSON_with_too_many_nested_arrays_fails)
+    {
+        ///arrange
+        unsigned char source[CBOR_DECODER_MAX_DEPTH + 2];
+        (void)memset(source, 0x81, sizeof(source));
+        source[sizeof(source) - 1] = 0x01;
+
+        ///act
+        CBOR_DECODER_RESULT result = test_ToJSON(source, sizeof(source));
+
+        ///assert
+        ASSERT_ARE_EQUAL(CBOR_DECODER_RESULT, CBOR_DECODER_UNSUPPORTED, result);
+    }
+
+    /*Tests_SRS_CBOR_DECODER_41_011: [ If items are nested deeper than CBOR_DECODER_MAX_DEPTH, CBORDecoder_ToJSON shall return CBOR_DECODER_UNSUPPORTED. ]*/
+    TEST_FUNCTION(CBORDecoder_ToJSON_with_nested_arrays_at_the_limit_succeeds)
+    {
+        ///arrange
+        unsigned char source[CBOR_DECODER_MAX_DEPTH + 1];
+        (void)memset(source, 0x81, sizeof(source));
+        source[sizeof(source) - 1] = 0x01;
+
+        ///act
+        CBOR_DECODER_RESULT result = test_ToJSON(source, sizeof(source));
+
+        ///assert
+        ASSERT_ARE_EQUAL(CBOR_DECODER_RESULT, CBOR_DECODER_OK, result);
+    }
+
+    /*Tests_SRS_CBOR_DECODER_41_012: [ If a string has an indefinite length, CBORDecoder_ToJSON shall return CBOR_DECODER_UNSUPPORTED. ]*/
+    TEST_FUNCTION(CBORDecoder_ToJSON_with_an_indefinite_string_fails)
+    {
+        ///arrange
+        static const unsigned char source[] = { 0x7F, 0x61, 'a', 0xFF };
+
+        ///act
+        CBOR_DECODER_RESULT result = test_ToJSON(source, sizeof(source));
+
+        ///assert
+        ASSERT_ARE_EQUAL(CBOR_DECODER_RESULT, CBOR_DECODER_UNSUPPORTED, result);
+    }
+
+    /*Tests_SRS_CBOR_DECODER_41_013: [ Tags shall be skipped and the tagged item written as if it was not tagged. ]*/
+    TEST_FUNCTION(CBORDecoder_ToJSON_skips_tags)
+    {
+        ///arrange
+        /*0("2017")*/
+        static const unsigned char source[] = { 0xC0, 0x64, '2', '0', '1', '7' };
+
+        ///act
+        CBOR_DECODER_RESULT result = test_ToJSON(source, sizeof(source));
+
+        ///assert
+        ASSERT_ARE_EQUAL(CBOR_DECODER_RESULT, CBOR_DECODER_OK, result);
+        ASSERT_ARE_EQUAL(char_ptr, "\"2017\"", real_STRING_c_str(json));
+    }
+
+    /*Tests_SRS_CBOR_DECODER_41_002: [ CBORDecoder_ToJSON shall append to destination the JSON text of the single CBOR item in source. ]*/
+    TEST_FUNCTION(CBORDecoder_ToJSON_when_STRING_concat_fails_fails)
+    {
+        ///arrange
+        static const unsigned char source[] = { 0x80 };
+        STRICT_EXPECTED_CALL(STRING_concat(json, "["))
+            .SetReturn(__LINE__);
+
+        ///act
+        CBOR_DECODER_RESULT result = test_ToJSON(source, sizeof(source));
+
+        ///assert
+        ASSERT_ARE_EQUAL(CBOR_DECODER_RESULT, CBOR_DECODER_ERROR, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+END_TEST_SUITE(cbordecoder_ut)
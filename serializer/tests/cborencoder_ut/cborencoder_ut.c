@@ -0,0 +1,273 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstring>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#endif
+
+#include "testrunnerswitcher.h"
+#include "cborencoder.h"
+
+TEST_DEFINE_ENUM_TYPE(CBOR_ENCODER_RESULT, CBOR_ENCODER_RESULT_VALUES);
+
+static unsigned char destination[32];
+
+static void ASSERT_BYTES(const unsigned char* expected, size_t expectedSize, size_t actualSize)
+{
+    size_t i;
+    ASSERT_ARE_EQUAL(size_t, expectedSize, actualSize);
+    for (i = 0; i < expectedSize; i++)
+    {
+        ASSERT_ARE_EQUAL(int, (int)expected[i], (int)destination[i]);
+    }
+}
+
+BEGIN_TEST_SUITE(cborencoder_ut)
+
+    TEST_SUITE_INITIALIZE(TestClassInitialize)
+    {
+    }
+
+    TEST_SUITE_CLEANUP(TestClassCleanup)
+    {
+    }
+
+    TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+    {
+        (void)memset(destination, 0xAA, sizeof(destination));
+    }
+
+    /*Tests_SRS_CBOR_ENCODER_41_001: [ If destination or size is NULL, CBOREncoder_Write* shall return CBOR_ENCODER_INVALID_ARG. ]*/
+    TEST_FUNCTION(CBOREncoder_WriteInt64_with_NULL_destination_fails)
+    {
+        ///arrange
+        size_t size = 0;
+
+        ///act
+        CBOR_ENCODER_RESULT result = CBOREncoder_WriteInt64(NULL, sizeof(destination), &size, 1);
+
+        ///assert
+        ASSERT_ARE_EQUAL(CBOR_ENCODER_RESULT, CBOR_ENCODER_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(size_t, 0, size);
+    }
+
+    /*Tests_SRS_CBOR_ENCODER_41_001: [ If destination or size is NULL, CBOREncoder_Write* shall return CBOR_ENCODER_INVALID_ARG. ]*/
+    TEST_FUNCTION(CBOREncoder_WriteBoolean_with_NULL_size_fails)
+    {
+        ///act
+        CBOR_ENCODER_RESULT result = CBOREncoder_WriteBoolean(destination, sizeof(destination), NULL, true);
+
+        ///assert
+        ASSERT_ARE_EQUAL(CBOR_ENCODER_RESULT, CBOR_ENCODER_INVALID_ARG, result);
+    }
+
+    /*Tests_SRS_CBOR_ENCODER_41_009: [ If value is not negative, CBOREncoder_WriteInt64 shall write it as an unsigned integer with the shortest argument. ]*/
+    /*Tests_SRS_CBOR_ENCODER_41_003: [ Otherwise CBOREncoder_Write* shall append the item, add its size to *size and return CBOR_ENCODER_OK. ]*/
+    TEST_FUNCTION(CBOREncoder_WriteInt64_writes_positive_values_with_the_shortest_argument)
+    {
+        ///arrange
+        static const unsigned char expected[] = { 0x17, 0x18, 0x18, 0x19, 0x01, 0x00, 0x1A, 0x00, 0x01, 0x00, 0x00, 0x1B, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00 };
+        size_t size = 0;
+
+        ///act
+        ASSERT_ARE_EQUAL(CBOR_ENCODER_RESULT, CBOR_ENCODER_OK, CBOREncoder_WriteInt64(destination, sizeof(destination), &size, 23));
+        ASSERT_ARE_EQUAL(CBOR_ENCODER_RESULT, CBOR_ENCODER_OK, CBOREncoder_WriteInt64(destination, sizeof(destination), &size, 24));
+        ASSERT_ARE_EQUAL(CBOR_ENCODER_RESULT, CBOR_ENCODER_OK, CBOREncoder_WriteInt64(destination, sizeof(destination), &size, 256));
+        ASSERT_ARE_EQUAL(CBOR_ENCODER_RESULT, CBOR_ENCODER_OK, CBOREncoder_WriteInt64(destination, sizeof(destination), &size, 65536));
+        ASSERT_ARE_EQUAL(CBOR_ENCODER_RESULT, CBOR_ENCODER_OK, CBOREncoder_WriteInt64(destination, sizeof(destination), &size, 4294967296LL));
+
+        ///assert
+        ASSERT_BYTES(expected, sizeof(expected), size);
+    }
+
+    /*Tests_SRS_CBOR_ENCODER_41_010: [ If value is negative, CBOREncoder_WriteInt64 shall write it as a negative integer of argument -1 - value with the shortest argument. ]*/
+    TEST_FUNCTION(CBOREncoder_WriteInt64_writes_negative_values)
+    {
+        ///arrange
+        static const unsigned char expected[] = { 0x20, 0x38, 0x63, 0x3B, 0x7F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+        size_t size = 0;
+
+        ///act
+        ASSERT_ARE_EQUAL(CBOR_ENCODER_RESULT, CBOR_ENCODER_OK, CBOREncoder_WriteInt64(destination, sizeof(destination), &size, -1));
+        ASSERT_ARE_EQUAL(CBOR_ENCODER_RESULT, CBOR_ENCODER_OK, CBOREncoder_WriteInt64(destination, sizeof(destination), &size, -100));
+        ASSERT_ARE_EQUAL(CBOR_ENCODER_RESULT, CBOR_ENCODER_OK, CBOREncoder_WriteInt64(destination, sizeof(destination), &size, INT64_MIN));
+
+        ///assert
+        ASSERT_BYTES(expected, sizeof(expected), size);
+    }
+
+    /*Tests_SRS_CBOR_ENCODER_41_002: [ If the item does not fit between destination + *size and destination + destinationCapacity, CBOREncoder_Write* shall write nothing and return CBOR_ENCODER_BUFFER_TOO_SMALL. ]*/
+    TEST_FUNCTION(CBOREncoder_WriteInt64_when_the_argument_does_not_fit_writes_nothing)
+    {
+        ///arrange
+        size_t size = 1;
+
+        ///act
+        CBOR_ENCODER_RESULT result = CBOREncoder_WriteInt64(destination, 3, &size, 256);
+
+        ///assert
+        ASSERT_ARE_EQUAL(CBOR_ENCODER_RESULT, CBOR_ENCODER_BUFFER_TOO_SMALL, result);
+        ASSERT_ARE_EQUAL(size_t, 1, size);
+        ASSERT_ARE_EQUAL(int, 0xAA, (int)destination[1]);
+    }
+
+    /*Tests_SRS_CBOR_ENCODER_41_004: [ CBOREncoder_WriteMapHeader shall write the shortest header of a map of pairCount pairs. ]*/
+    TEST_FUNCTION(CBOREncoder_WriteMapHeader_writes_the_shortest_header)
+    {
+        ///arrange
+        static const unsigned char expected[] = { 0xA0, 0xB7, 0xB8, 0x18 };
+        size_t size = 0;
+
+        ///act
+        ASSERT_ARE_EQUAL(CBOR_ENCODER_RESULT, CBOR_ENCODER_OK, CBOREncoder_WriteMapHeader(destination, sizeof(destination), &size, 0));
+        ASSERT_ARE_EQUAL(CBOR_ENCODER_RESULT, CBOR_ENCODER_OK, CBOREncoder_WriteMapHeader(destination, sizeof(destination), &size, 23));
+        ASSERT_ARE_EQUAL(CBOR_ENCODER_RESULT, CBOR_ENCODER_OK, CBOREncoder_WriteMapHeader(destination, sizeof(destination), &size, 24));
+
+        ///assert
+        ASSERT_BYTES(expected, sizeof(expected), size);
+    }
+
+    /*Tests_SRS_CBOR_ENCODER_41_014: [ CBOREncoder_WriteArrayHeader shall write the shortest header of an array of itemCount items. ]*/
+    TEST_FUNCTION(CBOREncoder_WriteArrayHeader_writes_the_shortest_header)
+    {
+        ///arrange
+        static const unsigned char expected[] = { 0x80, 0x97, 0x98, 0x18, 0x99, 0x01, 0x00 };
+        size_t size = 0;
+
+        ///act
+        ASSERT_ARE_EQUAL(CBOR_ENCODER_RESULT, CBOR_ENCODER_OK, CBOREncoder_WriteArrayHeader(destination, sizeof(destination), &size, 0));
+        ASSERT_ARE_EQUAL(CBOR_ENCODER_RESULT, CBOR_ENCODER_OK, CBOREncoder_WriteArrayHeader(destination, sizeof(destination), &size, 23));
+        ASSERT_ARE_EQUAL(CBOR_ENCODER_RESULT, CBOR_ENCODER_OK, CBOREncoder_WriteArrayHeader(destination, sizeof(destination), &size, 24));
+        ASSERT_ARE_EQUAL(CBOR_ENCODER_RESULT, CBOR_ENCODER_OK, CBOREncoder_WriteArrayHeader(destination, sizeof(destination), &size, 256));
+
+        ///assert
+        ASSERT_BYTES(expected, sizeof(expected), size);
+    }
+
+    /*Tests_SRS_CBOR_ENCODER_41_006: [ CBOREncoder_WriteTextString shall write a text string header for length bytes followed by the bytes of text. ]*/
+    TEST_FUNCTION(CBOREncoder_WriteTextString_succeeds)
+    {
+        ///arrange
+        static const unsigned char expected[] = { 0x64, 't', 'e', 'm', 'p', 0x60 };
+        size_t size = 0;
+
+        ///act
+        ASSERT_ARE_EQUAL(CBOR_ENCODER_RESULT, CBOR_ENCODER_OK, CBOREncoder_WriteTextString(destination, sizeof(destination), &size, "temperature", 4));
+        ASSERT_ARE_EQUAL(CBOR_ENCODER_RESULT, CBOR_ENCODER_OK, CBOREncoder_WriteTextString(destination, sizeof(destination), &size, NULL, 0));
+
+        ///assert
+        ASSERT_BYTES(expected, sizeof(expected), size);
+    }
+
+    /*Tests_SRS_CBOR_ENCODER_41_005: [ If text is NULL and length is not 0, CBOREncoder_WriteTextString shall return CBOR_ENCODER_INVALID_ARG. ]*/
+    TEST_FUNCTION(CBOREncoder_WriteTextString_with_NULL_text_fails)
+    {
+        ///arrange
+        size_t size = 0;
+
+        ///act
+        CBOR_ENCODER_RESULT result = CBOREncoder_WriteTextString(destination, sizeof(destination), &size, NULL, 1);
+
+        ///assert
+        ASSERT_ARE_EQUAL(CBOR_ENCODER_RESULT, CBOR_ENCODER_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(size_t, 0, size);
+    }
+
+    /*Tests_SRS_CBOR_ENCODER_41_002: [ If the item does not fit between destination + *size and destination + destinationCapacity, CBOREncoder_Write* shall write nothing and return CBOR_ENCODER_BUFFER_TOO_SMALL. ]*/
+    TEST_FUNCTION(CBOREncoder_WriteTextString_when_the_text_does_not_fit_writes_nothing)
+    {
+        ///arrange
+        size_t size = 0;
+
+        ///act
+        CBOR_ENCODER_RESULT result = CBOREncoder_WriteTextString(destination, 4, &size, "temp", 4);
+
+        ///assert
+        ASSERT_ARE_EQUAL(CBOR_ENCODER_RESULT, CBOR_ENCODER_BUFFER_TOO_SMALL, result);
+        ASSERT_ARE_EQUAL(size_t, 0, size);
+        ASSERT_ARE_EQUAL(int, 0xAA, (int)destination[0]);
+    }
+
+    /*Tests_SRS_CBOR_ENCODER_41_008: [ CBOREncoder_WriteByteString shall write a byte string header for length bytes followed by bytes. ]*/
+    TEST_FUNCTION(CBOREncoder_WriteByteString_succeeds)
+    {
+        ///arrange
+        static const unsigned char bytes[] = { 0x01, 0x02, 0x03 };
+        static const unsigned char expected[] = { 0x43, 0x01, 0x02, 0x03 };
+        size_t size = 0;
+
+        ///act
+        CBOR_ENCODER_RESULT result = CBOREncoder_WriteByteString(destination, sizeof(destination), &size, bytes, sizeof(bytes));
+
+        ///assert
+        ASSERT_ARE_EQUAL(CBOR_ENCODER_RESULT, CBOR_ENCODER_OK, result);
+        ASSERT_BYTES(expected, sizeof(expected), size);
+    }
+
+    /*Tests_SRS_CBOR_ENCODER_41_007: [ If bytes is NULL and length is not 0, CBOREncoder_WriteByteString shall return CBOR_ENCODER_INVALID_ARG. ]*/
+    TEST_FUNCTION(CBOREncoder_WriteByteString_with_NULL_bytes_fails)
+    {
+        ///arrange
+        size_t size = 0;
+
+        ///act
+        CBOR_ENCODER_RESULT result = CBOREncoder_WriteByteString(destination, sizeof(destination), &size, NULL, 1);
+
+        ///assert
+        ASSERT_ARE_EQUAL(CBOR_ENCODER_RESULT, CBOR_ENCODER_INVALID_ARG, result);
+    }
+
+    /*Tests_SRS_CBOR_ENCODER_41_011: [ CBOREncoder_WriteBoolean shall write the simple value true (0xF5) or false (0xF4). ]*/
+    TEST_FUNCTION(CBOREncoder_WriteBoolean_succeeds)
+    {
+        ///arrange
+        static const unsigned char expected[] = { 0xF5, 0xF4 };
+        size_t size = 0;
+
+        ///act
+        ASSERT_ARE_EQUAL(CBOR_ENCODER_RESULT, CBOR_ENCODER_OK, CBOREncoder_WriteBoolean(destination, sizeof(destination), &size, true));
+        ASSERT_ARE_EQUAL(CBOR_ENCODER_RESULT, CBOR_ENCODER_OK, CBOREncoder_WriteBoolean(destination, sizeof(destination), &size, false));
+
+        ///assert
+        ASSERT_BYTES(expected, sizeof(expected), size);
+    }
+
+#ifndef NO_FLOATS
+    /*Tests_SRS_CBOR_ENCODER_41_012: [ If value can be represented exactly as a float, CBOREncoder_WriteDouble shall write it as a single precision float (0xFA). ]*/
+    TEST_FUNCTION(CBOREncoder_WriteDouble_writes_exact_values_as_single_precision)
+    {
+        ///arrange
+        static const unsigned char expected[] = { 0xFA, 0x3F, 0xC0, 0x00, 0x00 };
+        size_t size = 0;
+
+        ///act
+        CBOR_ENCODER_RESULT result = CBOREncoder_WriteDouble(destination, sizeof(destination), &size, 1.5);
+
+        ///assert
+        ASSERT_ARE_EQUAL(CBOR_ENCODER_RESULT, CBOR_ENCODER_OK, result);
+        ASSERT_BYTES(expected, sizeof(expected), size);
+    }
+
+    /*Tests_SRS_CBOR_ENCODER_41_013: [ Otherwise CBOREncoder_WriteDouble shall write value as a double precision float (0xFB). ]*/
+    TEST_FUNCTION(CBOREncoder_WriteDouble_writes_other_values_as_double_precision)
+    {
+        ///arrange
+        static const unsigned char expected[] = { 0xFB, 0x3F, 0xB9, 0x99, 0x99, 0x99, 0x99, 0x99, 0x9A, 0xFB, 0x7E, 0x37, 0xE4, 0x3C, 0x88, 0x00, 0x75, 0x9C };
+        size_t size = 0;
+
+        ///act
+        ASSERT_ARE_EQUAL(CBOR_ENCODER_RESULT, CBOR_ENCODER_OK, CBOREncoder_WriteDouble(destination, sizeof(destination), &size, 0.1));
+        ASSERT_ARE_EQUAL(CBOR_ENCODER_RESULT, CBOR_ENCODER_OK, CBOREncoder_WriteDouble(destination, sizeof(destination), &size, 1e300));
+
+        ///assert
+        ASSERT_BYTES(expected, sizeof(expected), size);
+    }
+#endif
+
+END_TEST_SUITE(cborencoder_ut)
@@ -36,6 +36,7 @@ void my_gballoc_free(void * t)
 #include "agenttypesystem.h"
 #include "schema.h"
 #include "iotdevice.h"
+#include "cbordecoder.h"
 #include "azure_c_shared_utility/strings.h"
 #undef ENABLE_MOCKS
 
@@ -422,11 +423,20 @@ static int EDM_BINARY_Compare(EDM_BINARY e, EDM_BINARY fe)
 
 static AGENT_DATA_TYPES_RESULT my_Create_AGENT_DATA_TYPE_from_DOUBLE(AGENT_DATA_TYPE* agentData, double v)
 {
-    (void)v;
+    agentData->type = EDM_DOUBLE_TYPE;
+    agentData->value.edmDouble.value = v;
     Create_AGENT_DATA_TYPE_from_DOUBLE_agentData = agentData;
     return AGENT_DATA_TYPES_OK;
 }
 
+static CBOR_DECODER_RESULT my_CBORDecoder_ToJSON(const unsigned char* source, size_t sourceSize, STRING_HANDLE destination)
+{
+    (void)source;
+    (void)sourceSize;
+    (void)real_STRING_concat(destination, "{\"a\":3}");
+    return CBOR_DECODER_OK;
+}
+
 static DEVICE_RESULT my_Device_PublishTransacted(TRANSACTION_HANDLE transactionHandle, const char* propertyName, const AGENT_DATA_TYPE* data)
 {
     (void)transactionHandle;
@@ -496,7 +506,8 @@ static void my_Destroy_AGENT_DATA_TYPE(AGENT_DATA_TYPE* agentData)
 
 static AGENT_DATA_TYPES_RESULT my_Create_AGENT_DATA_TYPE_from_SINT32(AGENT_DATA_TYPE* agentData, int32_t v)
 {
-    (void)(v);
+    agentData->type = EDM_INT32_TYPE;
+    agentData->value.edmInt32.value = v;
     Create_AGENT_DATA_TYPE_from_SINT32_agentData = agentData;
     return AGENT_DATA_TYPES_OK;
 }
@@ -530,6 +541,7 @@ TEST_DEFINE_ENUM_TYPE(CODEFIRST_RESULT, CODEFIRST_RESULT_VALUES);
 IMPLEMENT_UMOCK_C_ENUM_TYPE(CODEFIRST_RESULT, CODEFIRST_RESULT_VALUES);
 TEST_DEFINE_ENUM_TYPE(DEVICE_RESULT, DEVICE_RESULT_VALUES);
 IMPLEMENT_UMOCK_C_ENUM_TYPE(DEVICE_RESULT, DEVICE_RESULT_VALUES);
+IMPLEMENT_UMOCK_C_ENUM_TYPE(CBOR_DECODER_RESULT, CBOR_DECODER_RESULT_VALUES);
 
 static TEST_MUTEX_HANDLE g_testByTest;
 
@@ -750,6 +762,7 @@ BEGIN_TEST_SUITE(CodeFirst_ut_Dummy_Data_Provider)
         REGISTER_GLOBAL_MOCK_RETURN(Schema_GetModelName, TEST_MODEL_NAME);
         REGISTER_GLOBAL_MOCK_HOOK(Create_AGENT_DATA_TYPE_from_DOUBLE, my_Create_AGENT_DATA_TYPE_from_DOUBLE);
         REGISTER_GLOBAL_MOCK_FAIL_RETURN(Create_AGENT_DATA_TYPE_from_DOUBLE, AGENT_DATA_TYPES_JSON_ENCODER_ERRROR);
+        REGISTER_GLOBAL_MOCK_HOOK(CBORDecoder_ToJSON, my_CBORDecoder_ToJSON);
 
         REGISTER_UMOCK_VALUE_TYPE(EDM_DATE_TIME_OFFSET,
             umockvalue_stringify_EDM_DATE_TIME_OFFSET,
@@ -1990,6 +2003,60 @@ BEGIN_TEST_SUITE(CodeFirst_ut_Dummy_Data_Provider)
         CodeFirst_Deinit();
     }
 
+    /* Tests_SRS_CODEFIRST_99_095:[For each value passed to it, CodeFirst_SendAsync shall look up to which device the value belongs.] */
+    TEST_FUNCTION(CodeFirst_SendAsync_With_One_Property_Of_One_Of_Many_Devices_Succeeds)
+    {
+        // arrange
+        size_t i;
+        SimpleDevice_Model* devices[5];
+        (void)CodeFirst_Init(NULL);
+        for (i = 0; i < sizeof(devices) / sizeof(devices[0]); i++)
+        {
+            devices[i] = (SimpleDevice_Model*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &ALL_REFLECTED(testReflectedData), sizeof(SimpleDevice_Model), false);
+        }
+        CodeFirst_DestroyDevice(devices[1]);
+        unsigned char* destination;
+        size_t destinationSize;
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(Device_StartTransaction(TEST_DEVICE_HANDLE));
+        STRICT_EXPECTED_CALL(STRING_new());
+        STRICT_EXPECTED_CALL(Schema_GetModelName(TEST_MODEL_HANDLE));
+        STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "this_is_double_Property"))
+            .IgnoreArgument_handle();
+        EXPECTED_CALL(Create_AGENT_DATA_TYPE_from_DOUBLE(IGNORED_PTR_ARG, 0.0));
+        STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle();
+        STRICT_EXPECTED_CALL(Device_PublishTransacted(IGNORED_PTR_ARG, "this_is_double_Property", IGNORED_PTR_ARG))
+            .IgnoreArgument_transactionHandle()
+            .IgnoreArgument(3);
+        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle();
+        EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(Device_EndTransaction(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_transactionHandle()
+            .IgnoreArgument(2)
+            .IgnoreArgument(3);
+        devices[3]->this_is_double_Property = 42.0;
+
+        // act
+        CODEFIRST_RESULT result = CodeFirst_SendAsync(&destination, &destinationSize, 1, &devices[3]->this_is_double_Property);
+
+        // assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_OK, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        // cleanup
+        for (i = 0; i < sizeof(devices) / sizeof(devices[0]); i++)
+        {
+            if (i != 1)
+            {
+                CodeFirst_DestroyDevice(devices[i]);
+            }
+        }
+        CodeFirst_Deinit();
+    }
+
     /* Tests_SRS_CODEFIRST_99_088:[CodeFirst_SendAsync shall send to the Device module a set of properties.] */
     /* Tests_SRS_CODEFIRST_99_105:[The properties are passed as pointers to the memory locations where the data exists in the device block allocated by CodeFirst_CreateDevice.] */
     /* Tests_SRS_CODEFIRST_99_089:[The numProperties argument shall indicate how many properties are to be sent.] */
@@ -2960,201 +3027,753 @@ BEGIN_TEST_SUITE(CodeFirst_ut_Dummy_Data_Provider)
         CodeFirst_Deinit();
     }
 
-    /* CodeFirst_RegisterSchema */
-    /* Tests_SRS_CODEFIRST_99_002:[ CodeFirst_RegisterSchema shall create the schema information and give it to the Schema module for one schema, identified by the metadata argument. On success, it shall return a handle to the model.] */
-    TEST_FUNCTION(CodeFirst_RegisterSchema_succeeds)
+    /* CodeFirst_SendAsyncToBuffer */
+    /* Tests_SRS_CODEFIRST_41_001: [ If destination or destinationSize is NULL, or numProperties is 0, CodeFirst_SendAsyncToBuffer shall return CODEFIRST_INVALID_ARG. ]*/
+    TEST_FUNCTION(CodeFirst_SendAsyncToBuffer_with_NULL_destination_fails)
     {
-        static const SCHEMA_STRUCT_TYPE_HANDLE TEST_CAR_BEHIND_VAN_HANDLE = (SCHEMA_STRUCT_TYPE_HANDLE)0x7001;
-
-        ///arrange
+        // arrange
         (void)CodeFirst_Init(NULL);
+        SimpleDevice_Model* device = (SimpleDevice_Model*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &ALL_REFLECTED(testReflectedData), sizeof(SimpleDevice_Model), false);
+        size_t destinationSize;
         umock_c_reset_all_calls();
-        STRICT_EXPECTED_CALL(Schema_GetSchemaByNamespace("TestSchema"));
-        STRICT_EXPECTED_CALL(Schema_Create("TestSchema", IGNORED_PTR_ARG))
-            .IgnoreArgument_metadata();
-        STRICT_EXPECTED_CALL(Schema_CreateStructType(TEST_SCHEMA_HANDLE, "theCarIsBehindTheVan_Struct"))
-            .SetReturn(TEST_CAR_BEHIND_VAN_HANDLE);
-        STRICT_EXPECTED_CALL(Schema_AddStructTypeProperty(TEST_CAR_BEHIND_VAN_HANDLE, "whereIsMyCar_Field", "whereIsMyDevice_Struct"));
-        STRICT_EXPECTED_CALL(Schema_AddStructTypeProperty(TEST_CAR_BEHIND_VAN_HANDLE, "Alt_Field", "int"));
-        STRICT_EXPECTED_CALL(Schema_CreateStructType(TEST_SCHEMA_HANDLE, "whereIsMyDevice_Struct"));
-        STRICT_EXPECTED_CALL(Schema_AddStructTypeProperty(TEST_STRUCT_TYPE_HANDLE, "Long_Field", "double"));
-        STRICT_EXPECTED_CALL(Schema_AddStructTypeProperty(TEST_STRUCT_TYPE_HANDLE, "Lat_Field", "double"));
-        STRICT_EXPECTED_CALL(Schema_CreateModelType(TEST_SCHEMA_HANDLE, "SimpleDevice_Model"))
-            .SetReturn(TEST_TRUCKTYPE_MODEL_HANDLE);
-        STRICT_EXPECTED_CALL(Schema_CreateModelType(TEST_SCHEMA_HANDLE, "truckType_Model"));
-        STRICT_EXPECTED_CALL(Schema_GetModelByName(TEST_SCHEMA_HANDLE, "SimpleDevice_Model")).SetReturn(TEST_TRUCKTYPE_MODEL_HANDLE);
-        STRICT_EXPECTED_CALL(Schema_GetModelByName(TEST_SCHEMA_HANDLE, "double")).SetReturn(NULL);
-        STRICT_EXPECTED_CALL(Schema_AddModelReportedProperty(TEST_TRUCKTYPE_MODEL_HANDLE, "new_reported_this_is_double", "double"));
-        STRICT_EXPECTED_CALL(Schema_GetModelByName(TEST_SCHEMA_HANDLE, "int")).SetReturn(NULL);
-        STRICT_EXPECTED_CALL(Schema_AddModelReportedProperty(TEST_TRUCKTYPE_MODEL_HANDLE, "new_reported_this_is_int", "int"));
-        STRICT_EXPECTED_CALL(Schema_GetModelByName(TEST_SCHEMA_HANDLE, "int")).SetReturn(NULL);
-        STRICT_EXPECTED_CALL(Schema_AddModelProperty(TEST_TRUCKTYPE_MODEL_HANDLE, "this_is_int_Property", "int"));
-        STRICT_EXPECTED_CALL(Schema_GetModelByName(TEST_SCHEMA_HANDLE, "double")).SetReturn(NULL);
-        STRICT_EXPECTED_CALL(Schema_AddModelProperty(TEST_TRUCKTYPE_MODEL_HANDLE, "this_is_double_Property", "double"));
-        STRICT_EXPECTED_CALL(Schema_GetModelByName(TEST_SCHEMA_HANDLE, "truckType_Model")).SetReturn(TEST_MODEL_HANDLE);
-        STRICT_EXPECTED_CALL(Schema_CreateModelAction(TEST_MODEL_HANDLE, "setSpeed_Action"))
-            .SetReturn(SETSPEED_ACTION_HANDLE);
-        STRICT_EXPECTED_CALL(Schema_AddModelActionArgument(SETSPEED_ACTION_HANDLE, "theSpeed", "double"));
-        STRICT_EXPECTED_CALL(Schema_CreateModelAction(TEST_MODEL_HANDLE, "reset_Action"))
-            .SetReturn(RESET_ACTION_HANDLE);
-
-        ///act
 
-        SCHEMA_HANDLE result = CodeFirst_RegisterSchema("TestSchema", &ALL_REFLECTED(testReflectedData));
+        // act
+        CODEFIRST_RESULT result = CodeFirst_SendAsyncToBuffer(NULL, 100, &destinationSize, 1, &device->this_is_int_Property);
 
-        ///assert
+        // assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_INVALID_ARG, result);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
-        ASSERT_ARE_EQUAL(void_ptr, TEST_SCHEMA_HANDLE, result);
 
-        ///cleanup
+        // cleanup
+        CodeFirst_DestroyDevice(device);
         CodeFirst_Deinit();
-
     }
 
-    /* Tests_SRS_CODEFIRST_99_002:[ CodeFirst_RegisterSchema shall create the schema information and give it to the Schema module for one schema, identified by the metadata argument. On success, it shall return a handle to the model.] */
-    TEST_FUNCTION(CodeFirst_RegisterSchema_With_Model_In_Model_succeeds)
+    /* Tests_SRS_CODEFIRST_41_001: [ If destination or destinationSize is NULL, or numProperties is 0, CodeFirst_SendAsyncToBuffer shall return CODEFIRST_INVALID_ARG. ]*/
+    TEST_FUNCTION(CodeFirst_SendAsyncToBuffer_with_NULL_destinationSize_fails)
     {
-        static const SCHEMA_STRUCT_TYPE_HANDLE TEST_CAR_BEHIND_VAN_HANDLE = (SCHEMA_STRUCT_TYPE_HANDLE)0x7001;
-
-        ///arrange
+        // arrange
         (void)CodeFirst_Init(NULL);
+        SimpleDevice_Model* device = (SimpleDevice_Model*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &ALL_REFLECTED(testReflectedData), sizeof(SimpleDevice_Model), false);
+        unsigned char destination[100];
         umock_c_reset_all_calls();
-        STRICT_EXPECTED_CALL(Schema_GetSchemaByNamespace("TestSchema"));
-        STRICT_EXPECTED_CALL(Schema_Create("TestSchema", TEST_SCHEMA_METADATA))
-            .IgnoreArgument_metadata();
-        STRICT_EXPECTED_CALL(Schema_CreateModelType(TEST_SCHEMA_HANDLE, "OuterType"))
-            .SetReturn(TEST_OUTERTYPE_MODEL_HANDLE);
-        STRICT_EXPECTED_CALL(Schema_CreateModelType(TEST_SCHEMA_HANDLE, "InnerType"))
-            .SetReturn(TEST_INNERTYPE_MODEL_HANDLE);
-        STRICT_EXPECTED_CALL(Schema_GetModelByName(TEST_SCHEMA_HANDLE, "OuterType"))
-            .SetReturn(TEST_OUTERTYPE_MODEL_HANDLE);
-        STRICT_EXPECTED_CALL(Schema_CreateModelAction(TEST_OUTERTYPE_MODEL_HANDLE, "OuterType_reset_Action"));
-        STRICT_EXPECTED_CALL(Schema_GetModelByName(TEST_SCHEMA_HANDLE, "InnerType"))
-            .SetReturn(TEST_INNERTYPE_MODEL_HANDLE);
-        STRICT_EXPECTED_CALL(Schema_AddModelModel(TEST_OUTERTYPE_MODEL_HANDLE, "Inner", TEST_INNERTYPE_MODEL_HANDLE, 8, NULL));
-        STRICT_EXPECTED_CALL(Schema_GetModelByName(TEST_SCHEMA_HANDLE, "InnerType"))
-            .SetReturn(TEST_INNERTYPE_MODEL_HANDLE);
-        STRICT_EXPECTED_CALL(Schema_GetModelByName(TEST_SCHEMA_HANDLE, "int"));
-        STRICT_EXPECTED_CALL(Schema_AddModelDesiredProperty(TEST_INNERTYPE_MODEL_HANDLE, "this_is_desired_int_Property_2", "int", IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, NULL))
-            .IgnoreArgument_desiredPropertyDeinitialize()
-            .IgnoreArgument_desiredPropertyInitialize()
-            .IgnoreArgument_desiredPropertyFromAGENT_DATA_TYPE()
-            .IgnoreArgument_offset();
-        STRICT_EXPECTED_CALL(Schema_GetModelByName(TEST_SCHEMA_HANDLE, "int"));
-        STRICT_EXPECTED_CALL(Schema_AddModelReportedProperty(TEST_INNERTYPE_MODEL_HANDLE, "this_is_reported_int_Property_2", "int"));
-        STRICT_EXPECTED_CALL(Schema_CreateModelAction(TEST_INNERTYPE_MODEL_HANDLE, "InnerType_reset_Action"));
-        STRICT_EXPECTED_CALL(Schema_GetModelByName(TEST_SCHEMA_HANDLE, "double"));
-        STRICT_EXPECTED_CALL(Schema_AddModelProperty(TEST_INNERTYPE_MODEL_HANDLE, "this_is_double2", "double"));
-        STRICT_EXPECTED_CALL(Schema_GetModelByName(TEST_SCHEMA_HANDLE, "int"));
-        STRICT_EXPECTED_CALL(Schema_AddModelProperty(TEST_INNERTYPE_MODEL_HANDLE, "this_is_int2", "int"));
 
-        ///act
-        SCHEMA_HANDLE result = CodeFirst_RegisterSchema("TestSchema", &ALL_REFLECTED(testModelInModelReflected));
+        // act
+        CODEFIRST_RESULT result = CodeFirst_SendAsyncToBuffer(destination, sizeof(destination), NULL, 1, &device->this_is_int_Property);
 
-        ///assert
+        // assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_INVALID_ARG, result);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
-        ASSERT_ARE_EQUAL(void_ptr, TEST_SCHEMA_HANDLE, result);
 
-        ///cleanup
+        // cleanup
+        CodeFirst_DestroyDevice(device);
         CodeFirst_Deinit();
-
     }
 
-    /* Tests_SRS_CODEFIRST_99_076:[If any Schema APIs fail, CodeFirst_RegisterSchema shall return NULL.] */
-    TEST_FUNCTION(When_Schema_Create_Fails_Then_CodeFirst_RegisterSchema_Fails)
+    /* Tests_SRS_CODEFIRST_41_001: [ If destination or destinationSize is NULL, or numProperties is 0, CodeFirst_SendAsyncToBuffer shall return CODEFIRST_INVALID_ARG. ]*/
+    TEST_FUNCTION(CodeFirst_SendAsyncToBuffer_with_0_numProperties_fails)
     {
-
-        ///arrange
+        // arrange
         (void)CodeFirst_Init(NULL);
+        SimpleDevice_Model* device = (SimpleDevice_Model*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &ALL_REFLECTED(testReflectedData), sizeof(SimpleDevice_Model), false);
+        unsigned char destination[100];
+        size_t destinationSize;
         umock_c_reset_all_calls();
-        STRICT_EXPECTED_CALL(Schema_GetSchemaByNamespace("TestSchema"));
-        STRICT_EXPECTED_CALL(Schema_Create("TestSchema", TEST_SCHEMA_METADATA))
-            .SetReturn((SCHEMA_HANDLE)NULL);
 
-        ///act
-        SCHEMA_HANDLE result = CodeFirst_RegisterSchema("TestSchema", &ALL_REFLECTED(testReflectedData));
+        // act
+        CODEFIRST_RESULT result = CodeFirst_SendAsyncToBuffer(destination, sizeof(destination), &destinationSize, 0, device);
 
-        ///assert
-        ASSERT_IS_NULL(result);
+        // assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-        ///cleanup
+        // cleanup
+        CodeFirst_DestroyDevice(device);
         CodeFirst_Deinit();
     }
 
-    /* Tests_SRS_CODEFIRST_99_076:[If any Schema APIs fail, CodeFirst_RegisterSchema shall return NULL.] */
-    TEST_FUNCTION(When_Schema_CreateModelType_Fails_Then_CodeFirst_RegisterSchema_Fails)
+    /* Tests_SRS_CODEFIRST_41_002: [ The first time a device is sent, CodeFirst_SendAsyncToBuffer shall build the list of its root model primitive properties and keep it until the device is destroyed. ]*/
+    /* Tests_SRS_CODEFIRST_41_006: [ CodeFirst_SendAsyncToBuffer shall marshal each value by calling the Create_AGENT_DATA_TYPE_from_Ptr function associated with the property and write the value in place. ]*/
+    /* Tests_SRS_CODEFIRST_41_010: [ On success, CodeFirst_SendAsyncToBuffer shall write the size of the JSON (which is not NUL terminated) in destinationSize and return CODEFIRST_OK. ]*/
+    TEST_FUNCTION(CodeFirst_SendAsyncToBuffer_with_2_properties_succeeds)
     {
-        ///arrange
+        // arrange
+        static const char expectedJSON[] = "{\"this_is_double_Property\":42.000000000000000, \"this_is_int_Property\":1}";
         (void)CodeFirst_Init(NULL);
+        SimpleDevice_Model* device = (SimpleDevice_Model*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &ALL_REFLECTED(testReflectedData), sizeof(SimpleDevice_Model), false);
+        unsigned char destination[100];
+        size_t destinationSize;
         umock_c_reset_all_calls();
-        STRICT_EXPECTED_CALL(Schema_Create("TestSchema", TEST_SCHEMA_METADATA));
-        STRICT_EXPECTED_CALL(Schema_CreateModelType(TEST_SCHEMA_HANDLE, TEST_DEFAULT_MODEL_NAME))
-            .SetReturn((SCHEMA_MODEL_TYPE_HANDLE)NULL);
-        STRICT_EXPECTED_CALL(Schema_Destroy(TEST_SCHEMA_HANDLE));
 
-        ///act
-        SCHEMA_HANDLE result = CodeFirst_RegisterSchema("TestSchema", &ALL_REFLECTED(testReflectedData));
+        STRICT_EXPECTED_CALL(Schema_GetModelName(TEST_MODEL_HANDLE));
+        EXPECTED_CALL(Create_AGENT_DATA_TYPE_from_DOUBLE(IGNORED_PTR_ARG, (double)(IGNORED_NUM_ARG)));
+        EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG));
+        EXPECTED_CALL(Create_AGENT_DATA_TYPE_from_SINT32(IGNORED_PTR_ARG, (int32_t)(IGNORED_NUM_ARG)));
+        EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG));
+        device->this_is_double_Property = 42.0;
+        device->this_is_int_Property = 1;
 
-        ///assert
-        ASSERT_IS_NULL(result);
+        // act
+        CODEFIRST_RESULT result = CodeFirst_SendAsyncToBuffer(destination, sizeof(destination), &destinationSize, 2, &device->this_is_double_Property, &device->this_is_int_Property);
 
-        //cleanup
+        // assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_OK, result);
+        ASSERT_ARE_EQUAL(size_t, sizeof(expectedJSON) - 1, destinationSize);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(expectedJSON, destination, destinationSize));
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        // cleanup
+        CodeFirst_DestroyDevice(device);
         CodeFirst_Deinit();
     }
 
-    /* Tests_SRS_CODEFIRST_99_076:[If any Schema APIs fail, CodeFirst_RegisterSchema shall return NULL.] */
-    TEST_FUNCTION(When_Schema_AddModelProperty_Fails_Then_CodeFirst_RegisterSchema_Fails)
+    /* Tests_SRS_CODEFIRST_41_002: [ The first time a device is sent, CodeFirst_SendAsyncToBuffer shall build the list of its root model primitive properties and keep it until the device is destroyed. ]*/
+    TEST_FUNCTION(CodeFirst_SendAsyncToBuffer_the_second_time_does_not_look_up_the_model)
     {
-        ///arrange
+        // arrange
+        static const char expectedJSON[] = "{\"this_is_int_Property\":-3}";
         (void)CodeFirst_Init(NULL);
+        SimpleDevice_Model* device = (SimpleDevice_Model*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &ALL_REFLECTED(testReflectedData), sizeof(SimpleDevice_Model), false);
+        unsigned char destination[100];
+        size_t destinationSize;
+        device->this_is_int_Property = 1;
+        (void)CodeFirst_SendAsyncToBuffer(destination, sizeof(destination), &destinationSize, 1, &device->this_is_int_Property);
         umock_c_reset_all_calls();
-        STRICT_EXPECTED_CALL(Schema_GetModelByName(TEST_SCHEMA_HANDLE, "TruckType")).SetReturn(TEST_MODEL_HANDLE);
-        STRICT_EXPECTED_CALL(Schema_GetModelByName(TEST_SCHEMA_HANDLE, "SimpleDevice_Model")).SetReturn(TEST_MODEL_HANDLE);
-        STRICT_EXPECTED_CALL(Schema_AddModelProperty(TEST_MODEL_HANDLE, "this_is_int", "int"))
-            .SetReturn(SCHEMA_ERROR);
-        STRICT_EXPECTED_CALL(Schema_Destroy(TEST_SCHEMA_HANDLE));
 
-        ///act
-        SCHEMA_HANDLE result = CodeFirst_RegisterSchema("TestSchema", &ALL_REFLECTED(testReflectedData));
+        EXPECTED_CALL(Create_AGENT_DATA_TYPE_from_SINT32(IGNORED_PTR_ARG, (int32_t)(IGNORED_NUM_ARG)));
+        EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG));
+        device->this_is_int_Property = -3;
 
-        ///assert
-        ASSERT_IS_NULL(result);
+        // act
+        CODEFIRST_RESULT result = CodeFirst_SendAsyncToBuffer(destination, sizeof(destination), &destinationSize, 1, &device->this_is_int_Property);
 
-        ///cleanup
+        // assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_OK, result);
+        ASSERT_ARE_EQUAL(size_t, sizeof(expectedJSON) - 1, destinationSize);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(expectedJSON, destination, destinationSize));
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        // cleanup
+        CodeFirst_DestroyDevice(device);
         CodeFirst_Deinit();
     }
 
-    /* Tests_SRS_CODEFIRST_99_076:[If any Schema APIs fail, CodeFirst_RegisterSchema shall return NULL.] */
-    TEST_FUNCTION(When_Schema_CreateModelAction_Fails_Then_CodeFirst_RegisterSchema_Fails)
+    /* Tests_SRS_CODEFIRST_41_009: [ If a pointer to the beginning of a device block is passed, CodeFirst_SendAsyncToBuffer shall write all the properties of the device. ]*/
+    TEST_FUNCTION(CodeFirst_SendAsyncToBuffer_the_entire_device_state_succeeds)
     {
-        ///arrange
+        // arrange
+        static const char expectedJSON[] = "{\"this_is_int_Property\":1, \"this_is_double_Property\":42.000000000000000}";
         (void)CodeFirst_Init(NULL);
+        SimpleDevice_Model* device = (SimpleDevice_Model*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &ALL_REFLECTED(testReflectedData), sizeof(SimpleDevice_Model), false);
+        unsigned char destination[100];
+        size_t destinationSize;
         umock_c_reset_all_calls();
-        STRICT_EXPECTED_CALL(Schema_GetModelByName(TEST_SCHEMA_HANDLE, "TruckType")).SetReturn(TEST_MODEL_HANDLE);
-        STRICT_EXPECTED_CALL(Schema_CreateModelAction(TEST_MODEL_HANDLE, "setSpeed"))
-            .SetReturn((SCHEMA_ACTION_HANDLE)NULL);
-        STRICT_EXPECTED_CALL(Schema_Destroy(TEST_SCHEMA_HANDLE));
 
-        ///act
-        SCHEMA_HANDLE result = CodeFirst_RegisterSchema("TestSchema", &ALL_REFLECTED(testReflectedData));
+        STRICT_EXPECTED_CALL(Schema_GetModelName(TEST_MODEL_HANDLE));
+        EXPECTED_CALL(Create_AGENT_DATA_TYPE_from_SINT32(IGNORED_PTR_ARG, (int32_t)(IGNORED_NUM_ARG)));
+        EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG));
+        EXPECTED_CALL(Create_AGENT_DATA_TYPE_from_DOUBLE(IGNORED_PTR_ARG, (double)(IGNORED_NUM_ARG)));
+        EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG));
+        device->this_is_double_Property = 42.0;
+        device->this_is_int_Property = 1;
 
-        ///assert
-        ASSERT_IS_NULL(result);
+        // act
+        CODEFIRST_RESULT result = CodeFirst_SendAsyncToBuffer(destination, sizeof(destination), &destinationSize, 1, device);
 
-        ///cleanup
+        // assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_OK, result);
+        ASSERT_ARE_EQUAL(size_t, sizeof(expectedJSON) - 1, destinationSize);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(expectedJSON, destination, destinationSize));
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        // cleanup
+        CodeFirst_DestroyDevice(device);
         CodeFirst_Deinit();
     }
 
-    /* Tests_SRS_CODEFIRST_99_076:[If any Schema APIs fail, CodeFirst_RegisterSchema shall return NULL.] */
-    TEST_FUNCTION(When_Schema_AddModelActionArgument_Fails_Then_CodeFirst_RegisterSchema_Fails)
+    /* Tests_SRS_CODEFIRST_41_007: [ If the JSON does not fit in destinationCapacity bytes, CodeFirst_SendAsyncToBuffer shall return CODEFIRST_BUFFER_TOO_SMALL. ]*/
+    TEST_FUNCTION(CodeFirst_SendAsyncToBuffer_with_a_too_small_buffer_fails)
     {
-        ///arrange
+        // arrange
+        static const char expectedJSON[] = "{\"this_is_int_Property\":1}";
         (void)CodeFirst_Init(NULL);
+        SimpleDevice_Model* device = (SimpleDevice_Model*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &ALL_REFLECTED(testReflectedData), sizeof(SimpleDevice_Model), false);
+        unsigned char destination[100];
+        size_t destinationSize = 0;
+        device->this_is_int_Property = 1;
         umock_c_reset_all_calls();
-        STRICT_EXPECTED_CALL(Schema_GetModelByName(TEST_SCHEMA_HANDLE, "TruckType")).SetReturn(TEST_MODEL_HANDLE);
-        STRICT_EXPECTED_CALL(Schema_CreateModelAction(TEST_MODEL_HANDLE, "setSpeed"))
-            .SetReturn(SETSPEED_ACTION_HANDLE);
-        STRICT_EXPECTED_CALL(Schema_AddModelActionArgument(SETSPEED_ACTION_HANDLE, "theSpeed", "double"))
+
+        // act
+        CODEFIRST_RESULT result = CodeFirst_SendAsyncToBuffer(destination, sizeof(expectedJSON) - 2, &destinationSize, 1, &device->this_is_int_Property);
+
+        // assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_BUFFER_TOO_SMALL, result);
+        ASSERT_ARE_EQUAL(size_t, 0, destinationSize);
+
+        // cleanup
+        CodeFirst_DestroyDevice(device);
+        CodeFirst_Deinit();
+    }
+
+    /* Tests_SRS_CODEFIRST_41_005: [ If a property is passed more than once, CodeFirst_SendAsyncToBuffer shall return CODEFIRST_INVALID_ARG. ]*/
+    TEST_FUNCTION(CodeFirst_SendAsyncToBuffer_with_the_same_property_twice_fails)
+    {
+        // arrange
+        (void)CodeFirst_Init(NULL);
+        SimpleDevice_Model* device = (SimpleDevice_Model*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &ALL_REFLECTED(testReflectedData), sizeof(SimpleDevice_Model), false);
+        unsigned char destination[100];
+        size_t destinationSize;
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(Schema_GetModelName(TEST_MODEL_HANDLE));
+        EXPECTED_CALL(Create_AGENT_DATA_TYPE_from_SINT32(IGNORED_PTR_ARG, (int32_t)(IGNORED_NUM_ARG)));
+        EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG));
+
+        // act
+        CODEFIRST_RESULT result = CodeFirst_SendAsyncToBuffer(destination, sizeof(destination), &destinationSize, 2, &device->this_is_int_Property, &device->this_is_int_Property);
+
+        // assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        // cleanup
+        CodeFirst_DestroyDevice(device);
+        CodeFirst_Deinit();
+    }
+
+    /* Tests_SRS_CODEFIRST_41_003: [ If a value is not a primitive property of the root model of a device, CodeFirst_SendAsyncToBuffer shall return CODEFIRST_INVALID_ARG. ]*/
+    TEST_FUNCTION(CodeFirst_SendAsyncToBuffer_with_a_property_from_a_child_model_fails)
+    {
+        // arrange
+        (void)CodeFirst_Init(NULL);
+        OuterType* device = (OuterType*)CodeFirst_CreateDevice(TEST_OUTERTYPE_MODEL_HANDLE, &ALL_REFLECTED(testModelInModelReflected), sizeof(OuterType), false);
+        unsigned char destination[100];
+        size_t destinationSize;
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(Schema_GetModelName(TEST_OUTERTYPE_MODEL_HANDLE)).SetReturn("OuterType");
+
+        // act
+        CODEFIRST_RESULT result = CodeFirst_SendAsyncToBuffer(destination, sizeof(destination), &destinationSize, 1, &device->Inner.this_is_double2);
+
+        // assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        // cleanup
+        CodeFirst_DestroyDevice(device);
+        CodeFirst_Deinit();
+    }
+
+    /* Tests_SRS_CODEFIRST_41_003: [ If a value is not a primitive property of the root model of a device, CodeFirst_SendAsyncToBuffer shall return CODEFIRST_INVALID_ARG. ]*/
+    TEST_FUNCTION(CodeFirst_SendAsyncToBuffer_with_a_value_outside_any_device_fails)
+    {
+        // arrange
+        int notAProperty = 0;
+        (void)CodeFirst_Init(NULL);
+        SimpleDevice_Model* device = (SimpleDevice_Model*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &ALL_REFLECTED(testReflectedData), sizeof(SimpleDevice_Model), false);
+        unsigned char destination[100];
+        size_t destinationSize;
+        umock_c_reset_all_calls();
+
+        // act
+        CODEFIRST_RESULT result = CodeFirst_SendAsyncToBuffer(destination, sizeof(destination), &destinationSize, 1, &notAProperty);
+
+        // assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        // cleanup
+        CodeFirst_DestroyDevice(device);
+        CodeFirst_Deinit();
+    }
+
+    /* Tests_SRS_CODEFIRST_41_008: [ If Create_AGENT_DATA_TYPE_from_Ptr fails, CodeFirst_SendAsyncToBuffer shall return CODEFIRST_AGENT_DATA_TYPE_ERROR. ]*/
+    TEST_FUNCTION(CodeFirst_SendAsyncToBuffer_when_Create_AGENT_DATA_TYPE_fails_fails)
+    {
+        // arrange
+        (void)CodeFirst_Init(NULL);
+        SimpleDevice_Model* device = (SimpleDevice_Model*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &ALL_REFLECTED(testReflectedData), sizeof(SimpleDevice_Model), false);
+        unsigned char destination[100];
+        size_t destinationSize;
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(Schema_GetModelName(TEST_MODEL_HANDLE));
+        EXPECTED_CALL(Create_AGENT_DATA_TYPE_from_SINT32(IGNORED_PTR_ARG, (int32_t)(IGNORED_NUM_ARG)))
+            .SetReturn(AGENT_DATA_TYPES_ERROR);
+
+        // act
+        CODEFIRST_RESULT result = CodeFirst_SendAsyncToBuffer(destination, sizeof(destination), &destinationSize, 1, &device->this_is_int_Property);
+
+        // assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_AGENT_DATA_TYPE_ERROR, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        // cleanup
+        CodeFirst_DestroyDevice(device);
+        CodeFirst_Deinit();
+    }
+
+    /*Tests_SRS_CODEFIRST_41_025: [ CodeFirst_SendAsyncToBufferCbor shall validate its arguments, find the values and fail exactly as CodeFirst_SendAsyncToBuffer does, but write the properties as a CBOR (RFC 7049) map instead of a JSON object. ]*/
+    TEST_FUNCTION(CodeFirst_SendAsyncToBufferCbor_with_NULL_destination_fails)
+    {
+        // arrange
+        (void)CodeFirst_Init(NULL);
+        SimpleDevice_Model* device = (SimpleDevice_Model*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &ALL_REFLECTED(testReflectedData), sizeof(SimpleDevice_Model), false);
+        size_t destinationSize;
+        umock_c_reset_all_calls();
+
+        // act
+        CODEFIRST_RESULT result = CodeFirst_SendAsyncToBufferCbor(NULL, 100, &destinationSize, 1, &device->this_is_int_Property);
+
+        // assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        // cleanup
+        CodeFirst_DestroyDevice(device);
+        CodeFirst_Deinit();
+    }
+
+    /*Tests_SRS_CODEFIRST_41_026: [ CodeFirst_SendAsyncToBufferCbor shall write the keys of the map as text strings holding the property names, booleans as CBOR simple values, integers as CBOR integers, floating point values as CBOR floats, strings as text strings and binary values as byte strings. ]*/
+    /*Tests_SRS_CODEFIRST_41_029: [ The map written by CodeFirst_SendAsyncToBufferCbor shall have a definite length. ]*/
+    /*Tests_SRS_CODEFIRST_41_030: [ On success, CodeFirst_SendAsyncToBufferCbor shall write the size of the CBOR in destinationSize and return CODEFIRST_OK. ]*/
+    TEST_FUNCTION(CodeFirst_SendAsyncToBufferCbor_with_1_property_succeeds)
+    {
+        // arrange
+        (void)CodeFirst_Init(NULL);
+        SimpleDevice_Model* device = (SimpleDevice_Model*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &ALL_REFLECTED(testReflectedData), sizeof(SimpleDevice_Model), false);
+        unsigned char destination[100];
+        size_t destinationSize;
+        static const unsigned char expected[] = { 0xA1, 0x74, 't', 'h', 'i', 's', '_', 'i', 's', '_', 'i', 'n', 't', '_', 'P', 'r', 'o', 'p', 'e', 'r', 't', 'y', 0x01 };
+        device->this_is_int_Property = 1;
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(Schema_GetModelName(TEST_MODEL_HANDLE));
+        EXPECTED_CALL(Create_AGENT_DATA_TYPE_from_SINT32(IGNORED_PTR_ARG, (int32_t)(IGNORED_NUM_ARG)));
+        EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG));
+
+        // act
+        CODEFIRST_RESULT result = CodeFirst_SendAsyncToBufferCbor(destination, sizeof(destination), &destinationSize, 1, &device->this_is_int_Property);
+
+        // assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_OK, result);
+        ASSERT_ARE_EQUAL(size_t, sizeof(expected), destinationSize);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(expected, destination, sizeof(expected)));
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        // cleanup
+        CodeFirst_DestroyDevice(device);
+        CodeFirst_Deinit();
+    }
+
+    /*Tests_SRS_CODEFIRST_41_028: [ If the CBOR does not fit in destinationCapacity bytes, CodeFirst_SendAsyncToBufferCbor shall return CODEFIRST_BUFFER_TOO_SMALL. ]*/
+    TEST_FUNCTION(CodeFirst_SendAsyncToBufferCbor_with_too_small_buffer_fails)
+    {
+        // arrange
+        (void)CodeFirst_Init(NULL);
+        SimpleDevice_Model* device = (SimpleDevice_Model*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &ALL_REFLECTED(testReflectedData), sizeof(SimpleDevice_Model), false);
+        unsigned char destination[100];
+        size_t destinationSize = 0;
+        device->this_is_int_Property = 1;
+        umock_c_reset_all_calls();
+
+        // act
+        CODEFIRST_RESULT result = CodeFirst_SendAsyncToBufferCbor(destination, 22, &destinationSize, 1, &device->this_is_int_Property); /*the map needs 23 bytes*/
+
+        // assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_BUFFER_TOO_SMALL, result);
+        ASSERT_ARE_EQUAL(size_t, 0, destinationSize);
+
+        // cleanup
+        CodeFirst_DestroyDevice(device);
+        CodeFirst_Deinit();
+    }
+
+    /* CodeFirst_SendBatchToBuffer */
+    /*Tests_SRS_CODEFIRST_41_039: [ If destination, destinationSize or devices is NULL, or deviceCount is 0, CodeFirst_SendBatchToBuffer shall return CODEFIRST_INVALID_ARG. ]*/
+    TEST_FUNCTION(CodeFirst_SendBatchToBuffer_with_NULL_devices_fails)
+    {
+        // arrange
+        unsigned char destination[100];
+        size_t destinationSize;
+
+        // act
+        CODEFIRST_RESULT result = CodeFirst_SendBatchToBuffer(destination, sizeof(destination), &destinationSize, NULL, 1);
+
+        // assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_INVALID_ARG, result);
+    }
+
+    /*Tests_SRS_CODEFIRST_41_039: [ If destination, destinationSize or devices is NULL, or deviceCount is 0, CodeFirst_SendBatchToBuffer shall return CODEFIRST_INVALID_ARG. ]*/
+    TEST_FUNCTION(CodeFirst_SendBatchToBuffer_with_0_deviceCount_fails)
+    {
+        // arrange
+        (void)CodeFirst_Init(NULL);
+        void* device = CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &ALL_REFLECTED(testReflectedData), sizeof(SimpleDevice_Model), false);
+        unsigned char destination[100];
+        size_t destinationSize;
+
+        // act
+        CODEFIRST_RESULT result = CodeFirst_SendBatchToBuffer(destination, sizeof(destination), &destinationSize, &device, 0);
+
+        // assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_INVALID_ARG, result);
+
+        // cleanup
+        CodeFirst_DestroyDevice(device);
+        CodeFirst_Deinit();
+    }
+
+    /*Tests_SRS_CODEFIRST_41_040: [ If an element of devices is not a device created by CodeFirst_CreateDevice, or the root model of the devices has properties that are not primitive, CodeFirst_SendBatchToBuffer shall return CODEFIRST_INVALID_ARG. ]*/
+    TEST_FUNCTION(CodeFirst_SendBatchToBuffer_with_a_property_instead_of_a_device_fails)
+    {
+        // arrange
+        (void)CodeFirst_Init(NULL);
+        SimpleDevice_Model* device = (SimpleDevice_Model*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &ALL_REFLECTED(testReflectedData), sizeof(SimpleDevice_Model), false);
+        void* devices[2];
+        unsigned char destination[100];
+        size_t destinationSize;
+        devices[0] = device;
+        devices[1] = &device->this_is_double_Property;
+
+        // act
+        CODEFIRST_RESULT result = CodeFirst_SendBatchToBuffer(destination, sizeof(destination), &destinationSize, devices, 2);
+
+        // assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_INVALID_ARG, result);
+
+        // cleanup
+        CodeFirst_DestroyDevice(device);
+        CodeFirst_Deinit();
+    }
+
+    /*Tests_SRS_CODEFIRST_41_041: [ If the devices are not all of the same model, CodeFirst_SendBatchToBuffer shall return CODEFIRST_VALUES_FROM_DIFFERENT_DEVICES_ERROR. ]*/
+    TEST_FUNCTION(CodeFirst_SendBatchToBuffer_with_devices_of_different_models_fails)
+    {
+        // arrange
+        (void)CodeFirst_Init(NULL);
+        void* devices[2];
+        unsigned char destination[100];
+        size_t destinationSize;
+        devices[0] = CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &ALL_REFLECTED(testReflectedData), sizeof(SimpleDevice_Model), false);
+        devices[1] = CodeFirst_CreateDevice(TEST_TRUCKTYPE_MODEL_HANDLE, &ALL_REFLECTED(testReflectedData), sizeof(SimpleDevice_Model), false);
+
+        // act
+        CODEFIRST_RESULT result = CodeFirst_SendBatchToBuffer(destination, sizeof(destination), &destinationSize, devices, 2);
+
+        // assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_VALUES_FROM_DIFFERENT_DEVICES_ERROR, result);
+
+        // cleanup
+        CodeFirst_DestroyDevice(devices[0]);
+        CodeFirst_DestroyDevice(devices[1]);
+        CodeFirst_Deinit();
+    }
+
+    /*Tests_SRS_CODEFIRST_41_042: [ CodeFirst_SendBatchToBuffer shall marshal each value by calling the Create_AGENT_DATA_TYPE_from_Ptr function associated with the property and write it in place as CodeFirst_SendAsyncToBuffer does. ]*/
+    /*Tests_SRS_CODEFIRST_41_045: [ CodeFirst_SendBatchToBuffer shall write an object with, for every primitive property of the model, the property name and an array of its value in each device, in the order of devices. ]*/
+    /*Tests_SRS_CODEFIRST_41_046: [ On success, CodeFirst_SendBatchToBuffer shall write the size of the JSON (which is not NUL terminated) in destinationSize and return CODEFIRST_OK. ]*/
+    TEST_FUNCTION(CodeFirst_SendBatchToBuffer_with_2_devices_succeeds)
+    {
+        // arrange
+        static const char expectedJSON[] = "{\"this_is_int_Property\":[1,2], \"this_is_double_Property\":[42.000000000000000,43.000000000000000]}";
+        (void)CodeFirst_Init(NULL);
+        SimpleDevice_Model* devices[2];
+        unsigned char destination[200];
+        size_t destinationSize;
+        devices[0] = (SimpleDevice_Model*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &ALL_REFLECTED(testReflectedData), sizeof(SimpleDevice_Model), false);
+        devices[1] = (SimpleDevice_Model*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &ALL_REFLECTED(testReflectedData), sizeof(SimpleDevice_Model), false);
+        devices[0]->this_is_int_Property = 1;
+        devices[0]->this_is_double_Property = 42.0;
+        devices[1]->this_is_int_Property = 2;
+        devices[1]->this_is_double_Property = 43.0;
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(Schema_GetModelName(TEST_MODEL_HANDLE));
+        EXPECTED_CALL(Create_AGENT_DATA_TYPE_from_SINT32(IGNORED_PTR_ARG, (int32_t)(IGNORED_NUM_ARG)));
+        EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG));
+        EXPECTED_CALL(Create_AGENT_DATA_TYPE_from_SINT32(IGNORED_PTR_ARG, (int32_t)(IGNORED_NUM_ARG)));
+        EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG));
+        EXPECTED_CALL(Create_AGENT_DATA_TYPE_from_DOUBLE(IGNORED_PTR_ARG, (double)(IGNORED_NUM_ARG)));
+        EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG));
+        EXPECTED_CALL(Create_AGENT_DATA_TYPE_from_DOUBLE(IGNORED_PTR_ARG, (double)(IGNORED_NUM_ARG)));
+        EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG));
+
+        // act
+        CODEFIRST_RESULT result = SERIALIZE_BATCH_TO_BUFFER(destination, sizeof(destination), &destinationSize, devices, 2);
+
+        // assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_OK, result);
+        ASSERT_ARE_EQUAL(size_t, sizeof(expectedJSON) - 1, destinationSize);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(expectedJSON, destination, destinationSize));
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        // cleanup
+        CodeFirst_DestroyDevice(devices[0]);
+        CodeFirst_DestroyDevice(devices[1]);
+        CodeFirst_Deinit();
+    }
+
+    /*Tests_SRS_CODEFIRST_41_044: [ If the JSON or the CBOR does not fit in destinationCapacity bytes, CodeFirst_SendBatchToBuffer shall return CODEFIRST_BUFFER_TOO_SMALL. ]*/
+    TEST_FUNCTION(CodeFirst_SendBatchToBuffer_with_a_too_small_buffer_fails)
+    {
+        // arrange
+        static const char expectedJSON[] = "{\"this_is_int_Property\":[1,2], \"this_is_double_Property\":[42.000000000000000,43.000000000000000]}";
+        (void)CodeFirst_Init(NULL);
+        SimpleDevice_Model* devices[2];
+        unsigned char destination[200];
+        size_t destinationSize = 0;
+        devices[0] = (SimpleDevice_Model*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &ALL_REFLECTED(testReflectedData), sizeof(SimpleDevice_Model), false);
+        devices[1] = (SimpleDevice_Model*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &ALL_REFLECTED(testReflectedData), sizeof(SimpleDevice_Model), false);
+        devices[0]->this_is_int_Property = 1;
+        devices[0]->this_is_double_Property = 42.0;
+        devices[1]->this_is_int_Property = 2;
+        devices[1]->this_is_double_Property = 43.0;
+
+        // act
+        CODEFIRST_RESULT result = SERIALIZE_BATCH_TO_BUFFER(destination, sizeof(expectedJSON) - 2, &destinationSize, devices, 2);
+
+        // assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_BUFFER_TOO_SMALL, result);
+        ASSERT_ARE_EQUAL(size_t, 0, destinationSize);
+
+        // cleanup
+        CodeFirst_DestroyDevice(devices[0]);
+        CodeFirst_DestroyDevice(devices[1]);
+        CodeFirst_Deinit();
+    }
+
+    /*Tests_SRS_CODEFIRST_41_047: [ CodeFirst_SendBatchToBufferCbor shall validate its arguments and fail exactly as CodeFirst_SendBatchToBuffer does, but write a CBOR map of CBOR arrays, with the values encoded as CodeFirst_SendAsyncToBufferCbor does. ]*/
+    TEST_FUNCTION(CodeFirst_SendBatchToBufferCbor_with_2_devices_succeeds)
+    {
+        // arrange
+        static const unsigned char expected[] = {
+            0xA2,
+            0x74, 't', 'h', 'i', 's', '_', 'i', 's', '_', 'i', 'n', 't', '_', 'P', 'r', 'o', 'p', 'e', 'r', 't', 'y',
+            0x82, 0x01, 0x02,
+            0x77, 't', 'h', 'i', 's', '_', 'i', 's', '_', 'd', 'o', 'u', 'b', 'l', 'e', '_', 'P', 'r', 'o', 'p', 'e', 'r', 't', 'y',
+            0x82, 0xFA, 0x42, 0x28, 0x00, 0x00, 0xFA, 0x42, 0x2C, 0x00, 0x00 };
+        (void)CodeFirst_Init(NULL);
+        SimpleDevice_Model* devices[2];
+        unsigned char destination[200];
+        size_t destinationSize;
+        devices[0] = (SimpleDevice_Model*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &ALL_REFLECTED(testReflectedData), sizeof(SimpleDevice_Model), false);
+        devices[1] = (SimpleDevice_Model*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &ALL_REFLECTED(testReflectedData), sizeof(SimpleDevice_Model), false);
+        devices[0]->this_is_int_Property = 1;
+        devices[0]->this_is_double_Property = 42.0;
+        devices[1]->this_is_int_Property = 2;
+        devices[1]->this_is_double_Property = 43.0;
+
+        // act
+        CODEFIRST_RESULT result = SERIALIZE_BATCH_TO_CBOR_BUFFER(destination, sizeof(destination), &destinationSize, devices, 2);
+
+        // assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_OK, result);
+        ASSERT_ARE_EQUAL(size_t, sizeof(expected), destinationSize);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(expected, destination, sizeof(expected)));
+
+        // cleanup
+        CodeFirst_DestroyDevice(devices[0]);
+        CodeFirst_DestroyDevice(devices[1]);
+        CodeFirst_Deinit();
+    }
+
+    /* CodeFirst_RegisterSchema */
+    /* Tests_SRS_CODEFIRST_99_002:[ CodeFirst_RegisterSchema shall create the schema information and give it to the Schema module for one schema, identified by the metadata argument. On success, it shall return a handle to the model.] */
+    TEST_FUNCTION(CodeFirst_RegisterSchema_succeeds)
+    {
+        static const SCHEMA_STRUCT_TYPE_HANDLE TEST_CAR_BEHIND_VAN_HANDLE = (SCHEMA_STRUCT_TYPE_HANDLE)0x7001;
+
+        ///arrange
+        (void)CodeFirst_Init(NULL);
+        umock_c_reset_all_calls();
+        STRICT_EXPECTED_CALL(Schema_GetSchemaByNamespace("TestSchema"));
+        STRICT_EXPECTED_CALL(Schema_Create("TestSchema", IGNORED_PTR_ARG))
+            .IgnoreArgument_metadata();
+        STRICT_EXPECTED_CALL(Schema_CreateStructType(TEST_SCHEMA_HANDLE, "theCarIsBehindTheVan_Struct"))
+            .SetReturn(TEST_CAR_BEHIND_VAN_HANDLE);
+        STRICT_EXPECTED_CALL(Schema_AddStructTypeProperty(TEST_CAR_BEHIND_VAN_HANDLE, "whereIsMyCar_Field", "whereIsMyDevice_Struct"));
+        STRICT_EXPECTED_CALL(Schema_AddStructTypeProperty(TEST_CAR_BEHIND_VAN_HANDLE, "Alt_Field", "int"));
+        STRICT_EXPECTED_CALL(Schema_CreateStructType(TEST_SCHEMA_HANDLE, "whereIsMyDevice_Struct"));
+        STRICT_EXPECTED_CALL(Schema_AddStructTypeProperty(TEST_STRUCT_TYPE_HANDLE, "Long_Field", "double"));
+        STRICT_EXPECTED_CALL(Schema_AddStructTypeProperty(TEST_STRUCT_TYPE_HANDLE, "Lat_Field", "double"));
+        STRICT_EXPECTED_CALL(Schema_CreateModelType(TEST_SCHEMA_HANDLE, "SimpleDevice_Model"))
+            .SetReturn(TEST_TRUCKTYPE_MODEL_HANDLE);
+        STRICT_EXPECTED_CALL(Schema_CreateModelType(TEST_SCHEMA_HANDLE, "truckType_Model"));
+        STRICT_EXPECTED_CALL(Schema_GetModelByName(TEST_SCHEMA_HANDLE, "SimpleDevice_Model")).SetReturn(TEST_TRUCKTYPE_MODEL_HANDLE);
+        STRICT_EXPECTED_CALL(Schema_GetModelByName(TEST_SCHEMA_HANDLE, "double")).SetReturn(NULL);
+        STRICT_EXPECTED_CALL(Schema_AddModelReportedProperty(TEST_TRUCKTYPE_MODEL_HANDLE, "new_reported_this_is_double", "double"));
+        STRICT_EXPECTED_CALL(Schema_GetModelByName(TEST_SCHEMA_HANDLE, "int")).SetReturn(NULL);
+        STRICT_EXPECTED_CALL(Schema_AddModelReportedProperty(TEST_TRUCKTYPE_MODEL_HANDLE, "new_reported_this_is_int", "int"));
+        STRICT_EXPECTED_CALL(Schema_GetModelByName(TEST_SCHEMA_HANDLE, "int")).SetReturn(NULL);
+        STRICT_EXPECTED_CALL(Schema_AddModelProperty(TEST_TRUCKTYPE_MODEL_HANDLE, "this_is_int_Property", "int"));
+        STRICT_EXPECTED_CALL(Schema_GetModelByName(TEST_SCHEMA_HANDLE, "double")).SetReturn(NULL);
+        STRICT_EXPECTED_CALL(Schema_AddModelProperty(TEST_TRUCKTYPE_MODEL_HANDLE, "this_is_double_Property", "double"));
+        STRICT_EXPECTED_CALL(Schema_GetModelByName(TEST_SCHEMA_HANDLE, "truckType_Model")).SetReturn(TEST_MODEL_HANDLE);
+        STRICT_EXPECTED_CALL(Schema_CreateModelAction(TEST_MODEL_HANDLE, "setSpeed_Action"))
+            .SetReturn(SETSPEED_ACTION_HANDLE);
+        STRICT_EXPECTED_CALL(Schema_AddModelActionArgument(SETSPEED_ACTION_HANDLE, "theSpeed", "double"));
+        STRICT_EXPECTED_CALL(Schema_CreateModelAction(TEST_MODEL_HANDLE, "reset_Action"))
+            .SetReturn(RESET_ACTION_HANDLE);
+
+        ///act
+
+        SCHEMA_HANDLE result = CodeFirst_RegisterSchema("TestSchema", &ALL_REFLECTED(testReflectedData));
+
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(void_ptr, TEST_SCHEMA_HANDLE, result);
+
+        ///cleanup
+        CodeFirst_Deinit();
+
+    }
+
+    /* Tests_SRS_CODEFIRST_99_002:[ CodeFirst_RegisterSchema shall create the schema information and give it to the Schema module for one schema, identified by the metadata argument. On success, it shall return a handle to the model.] */
+    TEST_FUNCTION(CodeFirst_RegisterSchema_With_Model_In_Model_succeeds)
+    {
+        static const SCHEMA_STRUCT_TYPE_HANDLE TEST_CAR_BEHIND_VAN_HANDLE = (SCHEMA_STRUCT_TYPE_HANDLE)0x7001;
+
+        ///arrange
+        (void)CodeFirst_Init(NULL);
+        umock_c_reset_all_calls();
+        STRICT_EXPECTED_CALL(Schema_GetSchemaByNamespace("TestSchema"));
+        STRICT_EXPECTED_CALL(Schema_Create("TestSchema", TEST_SCHEMA_METADATA))
+            .IgnoreArgument_metadata();
+        STRICT_EXPECTED_CALL(Schema_CreateModelType(TEST_SCHEMA_HANDLE, "OuterType"))
+            .SetReturn(TEST_OUTERTYPE_MODEL_HANDLE);
+        STRICT_EXPECTED_CALL(Schema_CreateModelType(TEST_SCHEMA_HANDLE, "InnerType"))
+            .SetReturn(TEST_INNERTYPE_MODEL_HANDLE);
+        STRICT_EXPECTED_CALL(Schema_GetModelByName(TEST_SCHEMA_HANDLE, "OuterType"))
+            .SetReturn(TEST_OUTERTYPE_MODEL_HANDLE);
+        STRICT_EXPECTED_CALL(Schema_CreateModelAction(TEST_OUTERTYPE_MODEL_HANDLE, "OuterType_reset_Action"));
+        STRICT_EXPECTED_CALL(Schema_GetModelByName(TEST_SCHEMA_HANDLE, "InnerType"))
+            .SetReturn(TEST_INNERTYPE_MODEL_HANDLE);
+        STRICT_EXPECTED_CALL(Schema_AddModelModel(TEST_OUTERTYPE_MODEL_HANDLE, "Inner", TEST_INNERTYPE_MODEL_HANDLE, 8, NULL));
+        STRICT_EXPECTED_CALL(Schema_GetModelByName(TEST_SCHEMA_HANDLE, "InnerType"))
+            .SetReturn(TEST_INNERTYPE_MODEL_HANDLE);
+        STRICT_EXPECTED_CALL(Schema_GetModelByName(TEST_SCHEMA_HANDLE, "int"));
+        STRICT_EXPECTED_CALL(Schema_AddModelDesiredProperty(TEST_INNERTYPE_MODEL_HANDLE, "this_is_desired_int_Property_2", "int", IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, NULL))
+            .IgnoreArgument_desiredPropertyDeinitialize()
+            .IgnoreArgument_desiredPropertyInitialize()
+            .IgnoreArgument_desiredPropertyFromAGENT_DATA_TYPE()
+            .IgnoreArgument_offset();
+        STRICT_EXPECTED_CALL(Schema_GetModelByName(TEST_SCHEMA_HANDLE, "int"));
+        STRICT_EXPECTED_CALL(Schema_AddModelReportedProperty(TEST_INNERTYPE_MODEL_HANDLE, "this_is_reported_int_Property_2", "int"));
+        STRICT_EXPECTED_CALL(Schema_CreateModelAction(TEST_INNERTYPE_MODEL_HANDLE, "InnerType_reset_Action"));
+        STRICT_EXPECTED_CALL(Schema_GetModelByName(TEST_SCHEMA_HANDLE, "double"));
+        STRICT_EXPECTED_CALL(Schema_AddModelProperty(TEST_INNERTYPE_MODEL_HANDLE, "this_is_double2", "double"));
+        STRICT_EXPECTED_CALL(Schema_GetModelByName(TEST_SCHEMA_HANDLE, "int"));
+        STRICT_EXPECTED_CALL(Schema_AddModelProperty(TEST_INNERTYPE_MODEL_HANDLE, "this_is_int2", "int"));
+
+        ///act
+        SCHEMA_HANDLE result = CodeFirst_RegisterSchema("TestSchema", &ALL_REFLECTED(testModelInModelReflected));
+
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(void_ptr, TEST_SCHEMA_HANDLE, result);
+
+        ///cleanup
+        CodeFirst_Deinit();
+
+    }
+
+    /* Tests_SRS_CODEFIRST_99_076:[If any Schema APIs fail, CodeFirst_RegisterSchema shall return NULL.] */
+    TEST_FUNCTION(When_Schema_Create_Fails_Then_CodeFirst_RegisterSchema_Fails)
+    {
+
+        ///arrange
+        (void)CodeFirst_Init(NULL);
+        umock_c_reset_all_calls();
+        STRICT_EXPECTED_CALL(Schema_GetSchemaByNamespace("TestSchema"));
+        STRICT_EXPECTED_CALL(Schema_Create("TestSchema", TEST_SCHEMA_METADATA))
+            .SetReturn((SCHEMA_HANDLE)NULL);
+
+        ///act
+        SCHEMA_HANDLE result = CodeFirst_RegisterSchema("TestSchema", &ALL_REFLECTED(testReflectedData));
+
+        ///assert
+        ASSERT_IS_NULL(result);
+
+        ///cleanup
+        CodeFirst_Deinit();
+    }
+
+    /* Tests_SRS_CODEFIRST_99_076:[If any Schema APIs fail, CodeFirst_RegisterSchema shall return NULL.] */
+    TEST_FUNCTION(When_Schema_CreateModelType_Fails_Then_CodeFirst_RegisterSchema_Fails)
+    {
+        ///arrange
+        (void)CodeFirst_Init(NULL);
+        umock_c_reset_all_calls();
+        STRICT_EXPECTED_CALL(Schema_Create("TestSchema", TEST_SCHEMA_METADATA));
+        STRICT_EXPECTED_CALL(Schema_CreateModelType(TEST_SCHEMA_HANDLE, TEST_DEFAULT_MODEL_NAME))
+            .SetReturn((SCHEMA_MODEL_TYPE_HANDLE)NULL);
+        STRICT_EXPECTED_CALL(Schema_Destroy(TEST_SCHEMA_HANDLE));
+
+        ///act
+        SCHEMA_HANDLE result = CodeFirst_RegisterSchema("TestSchema", &ALL_REFLECTED(testReflectedData));
+
+        ///assert
+        ASSERT_IS_NULL(result);
+
+        //cleanup
+        CodeFirst_Deinit();
+    }
+
+    /* Tests_SRS_CODEFIRST_99_076:[If any Schema APIs fail, CodeFirst_RegisterSchema shall return NULL.] */
+    TEST_FUNCTION(When_Schema_AddModelProperty_Fails_Then_CodeFirst_RegisterSchema_Fails)
+    {
+        ///arrange
+        (void)CodeFirst_Init(NULL);
+        umock_c_reset_all_calls();
+        STRICT_EXPECTED_CALL(Schema_GetModelByName(TEST_SCHEMA_HANDLE, "TruckType")).SetReturn(TEST_MODEL_HANDLE);
+        STRICT_EXPECTED_CALL(Schema_GetModelByName(TEST_SCHEMA_HANDLE, "SimpleDevice_Model")).SetReturn(TEST_MODEL_HANDLE);
+        STRICT_EXPECTED_CALL(Schema_AddModelProperty(TEST_MODEL_HANDLE, "this_is_int", "int"))
+            .SetReturn(SCHEMA_ERROR);
+        STRICT_EXPECTED_CALL(Schema_Destroy(TEST_SCHEMA_HANDLE));
+
+        ///act
+        SCHEMA_HANDLE result = CodeFirst_RegisterSchema("TestSchema", &ALL_REFLECTED(testReflectedData));
+
+        ///assert
+        ASSERT_IS_NULL(result);
+
+        ///cleanup
+        CodeFirst_Deinit();
+    }
+
+    /* Tests_SRS_CODEFIRST_99_076:[If any Schema APIs fail, CodeFirst_RegisterSchema shall return NULL.] */
+    TEST_FUNCTION(When_Schema_CreateModelAction_Fails_Then_CodeFirst_RegisterSchema_Fails)
+    {
+        ///arrange
+        (void)CodeFirst_Init(NULL);
+        umock_c_reset_all_calls();
+        STRICT_EXPECTED_CALL(Schema_GetModelByName(TEST_SCHEMA_HANDLE, "TruckType")).SetReturn(TEST_MODEL_HANDLE);
+        STRICT_EXPECTED_CALL(Schema_CreateModelAction(TEST_MODEL_HANDLE, "setSpeed"))
+            .SetReturn((SCHEMA_ACTION_HANDLE)NULL);
+        STRICT_EXPECTED_CALL(Schema_Destroy(TEST_SCHEMA_HANDLE));
+
+        ///act
+        SCHEMA_HANDLE result = CodeFirst_RegisterSchema("TestSchema", &ALL_REFLECTED(testReflectedData));
+
+        ///assert
+        ASSERT_IS_NULL(result);
+
+        ///cleanup
+        CodeFirst_Deinit();
+    }
+
+    /* Tests_SRS_CODEFIRST_99_076:[If any Schema APIs fail, CodeFirst_RegisterSchema shall return NULL.] */
+    TEST_FUNCTION(When_Schema_AddModelActionArgument_Fails_Then_CodeFirst_RegisterSchema_Fails)
+    {
+        ///arrange
+        (void)CodeFirst_Init(NULL);
+        umock_c_reset_all_calls();
+        STRICT_EXPECTED_CALL(Schema_GetModelByName(TEST_SCHEMA_HANDLE, "TruckType")).SetReturn(TEST_MODEL_HANDLE);
+        STRICT_EXPECTED_CALL(Schema_CreateModelAction(TEST_MODEL_HANDLE, "setSpeed"))
+            .SetReturn(SETSPEED_ACTION_HANDLE);
+        STRICT_EXPECTED_CALL(Schema_AddModelActionArgument(SETSPEED_ACTION_HANDLE, "theSpeed", "double"))
             .SetReturn(SCHEMA_ERROR);
         STRICT_EXPECTED_CALL(Schema_Destroy(TEST_SCHEMA_HANDLE));
 
@@ -3258,374 +3877,692 @@ BEGIN_TEST_SUITE(CodeFirst_ut_Dummy_Data_Provider)
         umock_c_reset_all_calls();
 
         ///act
-        EXECUTE_COMMAND_RESULT result = CodeFirst_ExecuteCommand(NULL, TEST_COMMAND);
+        EXECUTE_COMMAND_RESULT result = CodeFirst_ExecuteCommand(NULL, TEST_COMMAND);
+
+        ///assert
+        ASSERT_ARE_EQUAL(EXECUTE_COMMAND_RESULT, EXECUTE_COMMAND_ERROR, result);
+
+        ///cleanup
+        CodeFirst_Deinit();
+    }
+
+    /*Tests_SRS_CODEFIRST_02_014: [If parameter device or command is NULL then CodeFirst_ExecuteCommand shall return EXECUTE_COMMAND_ERROR.] */
+    TEST_FUNCTION(CodeFirst_ExecuteCommand_With_NULL_command_fails)
+    {
+        ///arrange
+        (void)CodeFirst_Init(NULL);
+        void* device = CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &DummyDataProvider_allReflected, sizeof(TruckType), false);
+        umock_c_reset_all_calls();
+
+        ///act
+        EXECUTE_COMMAND_RESULT result = CodeFirst_ExecuteCommand(device, NULL);
+
+        ///assert
+        ASSERT_ARE_EQUAL(EXECUTE_COMMAND_RESULT, EXECUTE_COMMAND_ERROR, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        CodeFirst_DestroyDevice(device);
+        CodeFirst_Deinit();
+    }
+
+    /*Tests_SRS_CODEFIRST_02_015: [CodeFirst_ExecuteCommand shall find the device.]*/
+    /*Tests_SRS_CODEFIRST_02_016: [If finding the device fails, then CodeFirst_ExecuteCommand shall return EXECUTE_COMMAND_ERROR.] */
+    TEST_FUNCTION(CodeFirst_ExecuteCommand_fails_when_it_does_not_find_the_device)
+    {
+        ///arrange
+        (void)CodeFirst_Init(NULL);
+        umock_c_reset_all_calls();
+
+        ///act
+        EXECUTE_COMMAND_RESULT result = CodeFirst_ExecuteCommand((unsigned char*)NULL +1, TEST_COMMAND);
+
+        ///assert
+        ASSERT_ARE_EQUAL(EXECUTE_COMMAND_RESULT, EXECUTE_COMMAND_ERROR, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        CodeFirst_Deinit();
+    }
+
+    /*Tests_SRS_CODEFIRST_02_017: [Otherwise CodeFirst_ExecuteCommand shall call Device_ExecuteCommand and return what Device_ExecuteCommand is returning.] */
+    TEST_FUNCTION(CodeFirst_ExecuteCommand_calls_Device_ExecuteCommand)
+    {
+        ///arrange
+        (void)CodeFirst_Init(NULL);
+        void* device = CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &DummyDataProvider_allReflected, sizeof(TruckType), false);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(Device_ExecuteCommand(IGNORED_PTR_ARG, TEST_COMMAND))
+            .IgnoreArgument(1);
+
+        ///act
+        EXECUTE_COMMAND_RESULT result = CodeFirst_ExecuteCommand(device, TEST_COMMAND);
+
+        ///assert
+        ASSERT_ARE_EQUAL(EXECUTE_COMMAND_RESULT, EXECUTE_COMMAND_SUCCESS, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        CodeFirst_DestroyDevice(device);
+        CodeFirst_Deinit();
+    }
+
+    /*Tests_SRS_CODEFIRST_02_017: [Otherwise CodeFirst_ExecuteCommand shall call Device_ExecuteCommand and return what Device_ExecuteCommand is returning.] */
+    TEST_FUNCTION(CodeFirst_ExecuteCommand_calls_Device_ExecuteCommand_can_returns_EXECUTE_COMMAND_FAILED)
+    {
+        ///arrange
+        (void)CodeFirst_Init(NULL);
+        void* device = CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &DummyDataProvider_allReflected, sizeof(TruckType), false);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(Device_ExecuteCommand(IGNORED_PTR_ARG, TEST_COMMAND))
+            .IgnoreArgument(1)
+            .SetReturn(EXECUTE_COMMAND_FAILED);
+
+        ///act
+        EXECUTE_COMMAND_RESULT result = CodeFirst_ExecuteCommand(device, TEST_COMMAND);
+
+        ///assert
+        ASSERT_ARE_EQUAL(EXECUTE_COMMAND_RESULT, EXECUTE_COMMAND_FAILED, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        CodeFirst_DestroyDevice(device);
+        CodeFirst_Deinit();
+    }
+
+    /*Tests_SRS_CODEFIRST_02_017: [Otherwise CodeFirst_ExecuteCommand shall call Device_ExecuteCommand and return what Device_ExecuteCommand is returning.] */
+    TEST_FUNCTION(CodeFirst_ExecuteCommand_calls_Device_ExecuteCommand_can_returns_EXECUTE_COMMAND_ERROR)
+    {
+        ///arrange
+        (void)CodeFirst_Init(NULL);
+        void* device = CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &DummyDataProvider_allReflected, sizeof(TruckType), false);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(Device_ExecuteCommand(IGNORED_PTR_ARG, TEST_COMMAND))
+            .IgnoreArgument(1)
+            .SetReturn(EXECUTE_COMMAND_ERROR);
+
+        ///act
+        EXECUTE_COMMAND_RESULT result = CodeFirst_ExecuteCommand(device, TEST_COMMAND);
+
+        ///assert
+        ASSERT_ARE_EQUAL(EXECUTE_COMMAND_RESULT, EXECUTE_COMMAND_ERROR, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        CodeFirst_DestroyDevice(device);
+        CodeFirst_Deinit();
+    }
+
+    /*Tests_SRS_CODEFIRST_02_018: [ If parameter destination, destinationSize or any of the values passed through va_args is NULL then CodeFirst_SendAsyncReported shall fail and return CODEFIRST_INVALID_ARG. ]*/
+    TEST_FUNCTION(CodeFirst_SendAsyncReported_with_NULL_destination_fails)
+    {
+        ///arrange
+        (void)CodeFirst_Init(NULL);
+        size_t destinationSize = 10;
+        void* device = CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &DummyDataProvider_allReflected, sizeof(TruckType), false);
+        umock_c_reset_all_calls();
+
+        ///act
+        CODEFIRST_RESULT result = CodeFirst_SendAsyncReported(NULL, &destinationSize, 1, (void*)1);
+
+        ///assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        CodeFirst_DestroyDevice(device);
+        CodeFirst_Deinit();
+    }
+
+    /*Tests_SRS_CODEFIRST_02_018: [ If parameter destination, destinationSize or any of the values passed through va_args is NULL then CodeFirst_SendAsyncReported shall fail and return CODEFIRST_INVALID_ARG. ]*/
+    TEST_FUNCTION(CodeFirst_SendAsyncReported_with_NULL_destinationSize_fails)
+    {
+        ///arrange
+        (void)CodeFirst_Init(NULL);
+        unsigned char *destination = (unsigned char*)my_gballoc_malloc(10);
+        void* device = CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &DummyDataProvider_allReflected, sizeof(TruckType), false);
+        umock_c_reset_all_calls();
+
+        ///act
+        CODEFIRST_RESULT result = CodeFirst_SendAsyncReported(&destination, NULL, 1, (void*)1);
+
+        ///assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        CodeFirst_DestroyDevice(device);
+        my_gballoc_free(destination);
+        CodeFirst_Deinit();
+    }
+
+    /*Tests_SRS_CODEFIRST_02_018: [ If parameter destination, destinationSize or any of the values passed through va_args is NULL then CodeFirst_SendAsyncReported shall fail and return CODEFIRST_INVALID_ARG. ]*/
+    TEST_FUNCTION(CodeFirst_SendAsyncReported_with_zero_reportedProperties_fails)
+    {
+        ///arrange
+        (void)CodeFirst_Init(NULL);
+        unsigned char *destination = (unsigned char*)my_gballoc_malloc(10);
+        size_t destinationSize = 10;
+        void* device = CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &DummyDataProvider_allReflected, sizeof(TruckType), false);
+        umock_c_reset_all_calls();
+
+        ///act
+        CODEFIRST_RESULT result = CodeFirst_SendAsyncReported(&destination, &destinationSize, 0);
+
+        ///assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        CodeFirst_DestroyDevice(device);
+        my_gballoc_free(destination);
+        CodeFirst_Deinit();
+    }
+
+    /*Tests_SRS_CODEFIRST_02_018: [ If parameter destination, destinationSize or any of the values passed through va_args is NULL then CodeFirst_SendAsyncReported shall fail and return CODEFIRST_INVALID_ARG. ]*/
+    TEST_FUNCTION(CodeFirst_SendAsyncReported_with_one_NULL_reportedProperties_fails)
+    {
+        ///arrange
+        (void)CodeFirst_Init(NULL);
+        unsigned char *destination = (unsigned char*)my_gballoc_malloc(10);
+        size_t destinationSize = 10;
+        void* device = CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &DummyDataProvider_allReflected, sizeof(TruckType), false);
+        umock_c_reset_all_calls();
+
+        ///act
+        CODEFIRST_RESULT result = CodeFirst_SendAsyncReported(&destination, &destinationSize, 1, NULL);
+
+        ///assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        CodeFirst_DestroyDevice(device);
+        my_gballoc_free(destination);
+        CodeFirst_Deinit();
+    }
+
+    /*Tests_SRS_CODEFIRST_02_019: [ If values passed through va_args do not belong to the same device then CodeFirst_SendAsyncReported shall fail and return CODEFIRST_VALUES_FROM_DIFFERENT_DEVICES_ERROR. ]*/
+    TEST_FUNCTION(CodeFirst_SendAsyncReported_with_reportedProperties_from_different_devices_fails)
+    {
+        ///arrange
+        (void)CodeFirst_Init(NULL);
+        size_t destinationSize = 1000;
+        unsigned char *destination = (unsigned char*)my_gballoc_malloc(destinationSize);
+
+        TruckType* device1 = (TruckType*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &DummyDataProvider_allReflected, sizeof(TruckType), false);
+        TruckType* device2 = (TruckType*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &DummyDataProvider_allReflected, sizeof(TruckType), false);
+        device1->reported_this_is_int = 1;
+        device2->reported_this_is_int = 2;
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(Device_CreateTransaction_ReportedProperties(IGNORED_PTR_ARG))
+            .IgnoreArgument_deviceHandle();
+        STRICT_EXPECTED_CALL(STRING_new());
+        STRICT_EXPECTED_CALL(Schema_GetModelName(IGNORED_PTR_ARG))
+            .IgnoreArgument_modelTypeHandle()
+            .SetReturn("TruckType");
+        STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "reported_this_is_int"))
+            .IgnoreArgument_handle();
+        STRICT_EXPECTED_CALL(Create_AGENT_DATA_TYPE_from_SINT32(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+            .IgnoreArgument_agentData()
+            .IgnoreArgument_v();
+        STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle();
+        STRICT_EXPECTED_CALL(Device_PublishTransacted_ReportedProperty(IGNORED_PTR_ARG, "reported_this_is_int", IGNORED_PTR_ARG))
+            .IgnoreArgument_transactionHandle()
+            .IgnoreArgument_data();
+        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle();
+        STRICT_EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG))
+            .IgnoreArgument_agentData();
+        STRICT_EXPECTED_CALL(Device_DestroyTransaction_ReportedProperties(IGNORED_PTR_ARG))
+            .IgnoreArgument_transactionHandle();
+
+        ///act
+        CODEFIRST_RESULT result = CodeFirst_SendAsyncReported(&destination, &destinationSize, 2, &device1->reported_this_is_int, &device2->reported_this_is_int);
 
         ///assert
-        ASSERT_ARE_EQUAL(EXECUTE_COMMAND_RESULT, EXECUTE_COMMAND_ERROR, result);
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_VALUES_FROM_DIFFERENT_DEVICES_ERROR, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         ///cleanup
+        CodeFirst_DestroyDevice(device2);
+        CodeFirst_DestroyDevice(device1);
+        my_gballoc_free(destination);
         CodeFirst_Deinit();
     }
 
-    /*Tests_SRS_CODEFIRST_02_014: [If parameter device or command is NULL then CodeFirst_ExecuteCommand shall return EXECUTE_COMMAND_ERROR.] */
-    TEST_FUNCTION(CodeFirst_ExecuteCommand_With_NULL_command_fails)
+    /*Tests_SRS_CODEFIRST_02_020: [ If values passed through va_args are not all of type REFLECTED_REPORTED_PROPERTY then CodeFirst_SendAsyncReported shall fail and return CODEFIRST_INVALID_ARG. ]*/
+    TEST_FUNCTION(CodeFirst_SendAsyncReported_WITH_DATA_fails)
     {
         ///arrange
         (void)CodeFirst_Init(NULL);
-        void* device = CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &DummyDataProvider_allReflected, sizeof(TruckType), false);
+        size_t destinationSize = 1000;
+        unsigned char *destination = (unsigned char*)my_gballoc_malloc(destinationSize);
+        TruckType* device = (TruckType*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &DummyDataProvider_allReflected, sizeof(TruckType), false);
+        device->reported_this_is_int = 3;
         umock_c_reset_all_calls();
 
+        STRICT_EXPECTED_CALL(Device_CreateTransaction_ReportedProperties(IGNORED_PTR_ARG))
+            .IgnoreArgument_deviceHandle();
+        STRICT_EXPECTED_CALL(STRING_new());
+        STRICT_EXPECTED_CALL(Schema_GetModelName(IGNORED_PTR_ARG))
+            .IgnoreArgument_modelTypeHandle();
+        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle();
+        STRICT_EXPECTED_CALL(Device_DestroyTransaction_ReportedProperties(IGNORED_PTR_ARG))
+            .IgnoreArgument_transactionHandle();
+
         ///act
-        EXECUTE_COMMAND_RESULT result = CodeFirst_ExecuteCommand(device, NULL);
+        CODEFIRST_RESULT result = CodeFirst_SendAsyncReported(&destination, &destinationSize, 1, &device->this_is_int); /*note: this_is_int is defined with WITH_DATA*/
 
         ///assert
-        ASSERT_ARE_EQUAL(EXECUTE_COMMAND_RESULT, EXECUTE_COMMAND_ERROR, result);
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_INVALID_ARG, result);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         ///cleanup
         CodeFirst_DestroyDevice(device);
+        my_gballoc_free(destination);
         CodeFirst_Deinit();
     }
 
-    /*Tests_SRS_CODEFIRST_02_015: [CodeFirst_ExecuteCommand shall find the device.]*/
-    /*Tests_SRS_CODEFIRST_02_016: [If finding the device fails, then CodeFirst_ExecuteCommand shall return EXECUTE_COMMAND_ERROR.] */
-    TEST_FUNCTION(CodeFirst_ExecuteCommand_fails_when_it_does_not_find_the_device)
+    /*Tests_SRS_CODEFIRST_02_020: [ If values passed through va_args are not all of type REFLECTED_REPORTED_PROPERTY then CodeFirst_SendAsyncReported shall fail and return CODEFIRST_INVALID_ARG. ]*/
+    TEST_FUNCTION(CodeFirst_SendAsyncReported_with_reportedProperty_outside_any_device_fails)
     {
         ///arrange
         (void)CodeFirst_Init(NULL);
+        size_t destinationSize = 1000;
+        unsigned char *destination = (unsigned char*)my_gballoc_malloc(destinationSize);
+        TruckType* device = (TruckType*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &DummyDataProvider_allReflected, sizeof(TruckType), false);
+        device->reported_this_is_int = 3;
         umock_c_reset_all_calls();
 
         ///act
-        EXECUTE_COMMAND_RESULT result = CodeFirst_ExecuteCommand((unsigned char*)NULL +1, TEST_COMMAND);
+        CODEFIRST_RESULT result = CodeFirst_SendAsyncReported(&destination, &destinationSize, 1, &(device+1)->reported_this_is_int); /*note: this is out of the memory of the device*/
 
         ///assert
-        ASSERT_ARE_EQUAL(EXECUTE_COMMAND_RESULT, EXECUTE_COMMAND_ERROR, result);
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_INVALID_ARG, result);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
         ///cleanup
+        CodeFirst_DestroyDevice(device);
+        my_gballoc_free(destination);
         CodeFirst_Deinit();
     }
 
-    /*Tests_SRS_CODEFIRST_02_017: [Otherwise CodeFirst_ExecuteCommand shall call Device_ExecuteCommand and return what Device_ExecuteCommand is returning.] */
-    TEST_FUNCTION(CodeFirst_ExecuteCommand_calls_Device_ExecuteCommand)
+    static void CodeFirst_SendReportedAsync_all_inert_path(void)
     {
-        ///arrange
-        (void)CodeFirst_Init(NULL);
-        void* device = CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &DummyDataProvider_allReflected, sizeof(TruckType), false);
-        umock_c_reset_all_calls();
+        STRICT_EXPECTED_CALL(Device_CreateTransaction_ReportedProperties(TEST_DEVICE_HANDLE));
+        STRICT_EXPECTED_CALL(Schema_GetModelName(TEST_MODEL_HANDLE));
 
-        STRICT_EXPECTED_CALL(Device_ExecuteCommand(IGNORED_PTR_ARG, TEST_COMMAND))
-            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(Create_AGENT_DATA_TYPE_from_DOUBLE(IGNORED_PTR_ARG, 5.5))
+            .IgnoreArgument_agentData();
+        STRICT_EXPECTED_CALL(Device_PublishTransacted_ReportedProperty(IGNORED_PTR_ARG, "new_reported_this_is_double", IGNORED_PTR_ARG))
+            .IgnoreArgument_transactionHandle()
+            .IgnoreArgument_data();
+        EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG));
 
-        ///act
-        EXECUTE_COMMAND_RESULT result = CodeFirst_ExecuteCommand(device, TEST_COMMAND);
+        STRICT_EXPECTED_CALL(Create_AGENT_DATA_TYPE_from_SINT32(IGNORED_PTR_ARG, -5))
+            .IgnoreArgument_agentData();
+        STRICT_EXPECTED_CALL(Device_PublishTransacted_ReportedProperty(IGNORED_PTR_ARG, "new_reported_this_is_int", IGNORED_PTR_ARG))
+            .IgnoreArgument_transactionHandle()
+            .IgnoreArgument_data();
+        EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG));
 
-        ///assert
-        ASSERT_ARE_EQUAL(EXECUTE_COMMAND_RESULT, EXECUTE_COMMAND_SUCCESS, result);
-        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        STRICT_EXPECTED_CALL(Device_CommitTransaction_ReportedProperties(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_transactionHandle()
+            .IgnoreArgument(2)
+            .IgnoreArgument(3);
 
-        ///cleanup
-        CodeFirst_DestroyDevice(device);
-        CodeFirst_Deinit();
+        STRICT_EXPECTED_CALL(Device_DestroyTransaction_ReportedProperties(IGNORED_PTR_ARG))
+            .IgnoreArgument_transactionHandle();
     }
 
-    /*Tests_SRS_CODEFIRST_02_017: [Otherwise CodeFirst_ExecuteCommand shall call Device_ExecuteCommand and return what Device_ExecuteCommand is returning.] */
-    TEST_FUNCTION(CodeFirst_ExecuteCommand_calls_Device_ExecuteCommand_can_returns_EXECUTE_COMMAND_FAILED)
+    /*Tests_SRS_CODEFIRST_02_021: [ If the value passed through va_args is a complete model instance, then CodeFirst_SendAsyncReported shall send all the reported properties of that device. ]*/
+    /*Tests_SRS_CODEFIRST_02_022: [ CodeFirst_SendAsyncReported shall start a transaction by calling Device_CreateTransaction_ReportedProperties. ]*/
+    /*Tests_SRS_CODEFIRST_02_023: [ CodeFirst_SendAsyncReported shall convert all REPORTED_PROPERTY model components to AGENT_DATA_TYPE. ]*/
+    /*Tests_SRS_CODEFIRST_02_024: [ CodeFirst_SendAsyncReported shall call Device_PublishTransacted_ReportedProperty for every AGENT_DATA_TYPE converted from REPORTED_PROPERTY. ]*/
+    /*Tests_SRS_CODEFIRST_02_026: [ CodeFirst_SendAsyncReported shall call Device_CommitTransaction_ReportedProperties to commit the transaction. ]*/
+    /*Tests_SRS_CODEFIRST_02_028: [ CodeFirst_SendAsyncReported shall return CODEFIRST_OK when it succeeds. ]*/
+    /*Tests_SRS_CODEFIRST_02_029: [ CodeFirst_SendAsyncReported shall call Device_DestroyTransaction_ReportedProperties to destroy the transaction. ]*/
+    TEST_FUNCTION(CodeFirst_SendReportedAsync_all_happy_path)
     {
-        ///arrange
+        /// arrange
         (void)CodeFirst_Init(NULL);
-        void* device = CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &DummyDataProvider_allReflected, sizeof(TruckType), false);
+        size_t destinationSize = 1000;
+        unsigned char *destination = (unsigned char*)my_gballoc_malloc(destinationSize);
+        SimpleDevice_Model* device = (SimpleDevice_Model*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &ALL_REFLECTED(testReflectedData), sizeof(SimpleDevice_Model), false);
         umock_c_reset_all_calls();
 
-        STRICT_EXPECTED_CALL(Device_ExecuteCommand(IGNORED_PTR_ARG, TEST_COMMAND))
-            .IgnoreArgument(1)
-            .SetReturn(EXECUTE_COMMAND_FAILED);
+        device->new_reported_this_is_double = 5.5; /*the only reported properties*/
+        device->new_reported_this_is_int = -5; /*the only reported properties*/
 
-        ///act
-        EXECUTE_COMMAND_RESULT result = CodeFirst_ExecuteCommand(device, TEST_COMMAND);
+        CodeFirst_SendReportedAsync_all_inert_path();
 
-        ///assert
-        ASSERT_ARE_EQUAL(EXECUTE_COMMAND_RESULT, EXECUTE_COMMAND_FAILED, result);
+        /// act
+        CODEFIRST_RESULT result = CodeFirst_SendAsyncReported(&destination, &destinationSize, 1, device);
+
+        /// assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_OK, result);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-        ///cleanup
+        /// cleanup
         CodeFirst_DestroyDevice(device);
+        my_gballoc_free(destination);
         CodeFirst_Deinit();
     }
 
-    /*Tests_SRS_CODEFIRST_02_017: [Otherwise CodeFirst_ExecuteCommand shall call Device_ExecuteCommand and return what Device_ExecuteCommand is returning.] */
-    TEST_FUNCTION(CodeFirst_ExecuteCommand_calls_Device_ExecuteCommand_can_returns_EXECUTE_COMMAND_ERROR)
+    /*Tests_SRS_CODEFIRST_02_027: [ If any error occurs, CodeFirst_SendAsyncReported shall fail and return CODEFIRST_ERROR. ]*/
+    TEST_FUNCTION(CodeFirst_SendReportedAsync_all_unhappy_path)
     {
         ///arrange
         (void)CodeFirst_Init(NULL);
-        void* device = CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &DummyDataProvider_allReflected, sizeof(TruckType), false);
+        size_t destinationSize = 1000;
+        unsigned char *destination = (unsigned char*)my_gballoc_malloc(destinationSize);
+        SimpleDevice_Model* device = (SimpleDevice_Model*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &ALL_REFLECTED(testReflectedData), sizeof(SimpleDevice_Model), false);
+        (void)umock_c_negative_tests_init();
         umock_c_reset_all_calls();
 
-        STRICT_EXPECTED_CALL(Device_ExecuteCommand(IGNORED_PTR_ARG, TEST_COMMAND))
-            .IgnoreArgument(1)
-            .SetReturn(EXECUTE_COMMAND_ERROR);
+        device->new_reported_this_is_double = 5.5; /*the only reported properties*/
+        device->new_reported_this_is_int = -5; /*the only reported properties*/
 
-        ///act
-        EXECUTE_COMMAND_RESULT result = CodeFirst_ExecuteCommand(device, TEST_COMMAND);
+        CodeFirst_SendReportedAsync_all_inert_path();
 
-        ///assert
-        ASSERT_ARE_EQUAL(EXECUTE_COMMAND_RESULT, EXECUTE_COMMAND_ERROR, result);
-        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        umock_c_negative_tests_snapshot();
 
-        ///cleanup
-        CodeFirst_DestroyDevice(device);
-        CodeFirst_Deinit();
-    }
+        size_t calls_that_cannot_fail[] =
+        {
+            1,/*Schema_GetModelName*/
+            4,/*Destroy_AGENT_DATA_TYPE*/
+            7,/*Destroy_AGENT_DATA_TYPE*/
+            9,/*Device_DestroyTransaction_ReportedProperties*/
+        };
 
-    /*Tests_SRS_CODEFIRST_02_018: [ If parameter destination, destinationSize or any of the values passed through va_args is NULL then CodeFirst_SendAsyncReported shall fail and return CODEFIRST_INVALID_ARG. ]*/
-    TEST_FUNCTION(CodeFirst_SendAsyncReported_with_NULL_destination_fails)
-    {
-        ///arrange
-        (void)CodeFirst_Init(NULL);
-        size_t destinationSize = 10;
-        void* device = CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &DummyDataProvider_allReflected, sizeof(TruckType), false);
-        umock_c_reset_all_calls();
+        for (size_t i = 0; i < umock_c_negative_tests_call_count(); i++)
+        {
+            size_t j;
+            for (j = 0;j < sizeof(calls_that_cannot_fail) / sizeof(calls_that_cannot_fail[0]);j++) /*not running the tests that cannot fail*/
+            {
+                if (calls_that_cannot_fail[j] == i)
+                    break;
+            }
 
-        ///act
-        CODEFIRST_RESULT result = CodeFirst_SendAsyncReported(NULL, &destinationSize, 1, (void*)1);
+            if (j == sizeof(calls_that_cannot_fail) / sizeof(calls_that_cannot_fail[0]))
+            {
+                umock_c_negative_tests_reset();
+                umock_c_negative_tests_fail_call(i);
+                char temp_str[128];
+                sprintf(temp_str, "On failed call %lu", (unsigned long)i);
+                ///act
+                CODEFIRST_RESULT result = CodeFirst_SendAsyncReported(&destination, &destinationSize, 1, device);
 
-        ///assert
-        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_INVALID_ARG, result);
-        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+                ///assert
+                ASSERT_ARE_NOT_EQUAL(CODEFIRST_RESULT, CODEFIRST_OK, result, temp_str);
+            }
+        }
 
         ///cleanup
         CodeFirst_DestroyDevice(device);
+        umock_c_negative_tests_deinit();
+        my_gballoc_free(destination);
         CodeFirst_Deinit();
     }
 
-    /*Tests_SRS_CODEFIRST_02_018: [ If parameter destination, destinationSize or any of the values passed through va_args is NULL then CodeFirst_SendAsyncReported shall fail and return CODEFIRST_INVALID_ARG. ]*/
-    TEST_FUNCTION(CodeFirst_SendAsyncReported_with_NULL_destinationSize_fails)
+    /*Tests_SRS_CODEFIRST_41_011: [ If parameter destination, destinationSize or device is NULL then CodeFirst_SendAsyncReportedChanges shall fail and return CODEFIRST_INVALID_ARG. ]*/
+    TEST_FUNCTION(CodeFirst_SendAsyncReportedChanges_with_NULL_device_fails)
     {
-        ///arrange
-        (void)CodeFirst_Init(NULL);
-        unsigned char *destination = (unsigned char*)my_gballoc_malloc(10);
-        void* device = CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &DummyDataProvider_allReflected, sizeof(TruckType), false);
+        /// arrange
+        size_t destinationSize = 1000;
+        unsigned char *destination = (unsigned char*)my_gballoc_malloc(destinationSize);
         umock_c_reset_all_calls();
 
-        ///act
-        CODEFIRST_RESULT result = CodeFirst_SendAsyncReported(&destination, NULL, 1, (void*)1);
+        /// act
+        CODEFIRST_RESULT result = CodeFirst_SendAsyncReportedChanges(&destination, &destinationSize, NULL);
 
-        ///assert
+        /// assert
         ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_INVALID_ARG, result);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-        ///cleanup
-        CodeFirst_DestroyDevice(device);
+        /// cleanup
         my_gballoc_free(destination);
-        CodeFirst_Deinit();
     }
 
-    /*Tests_SRS_CODEFIRST_02_018: [ If parameter destination, destinationSize or any of the values passed through va_args is NULL then CodeFirst_SendAsyncReported shall fail and return CODEFIRST_INVALID_ARG. ]*/
-    TEST_FUNCTION(CodeFirst_SendAsyncReported_with_zero_reportedProperties_fails)
+    /*Tests_SRS_CODEFIRST_41_012: [ If device is not a complete model instance created by CodeFirst_CreateDevice then CodeFirst_SendAsyncReportedChanges shall fail and return CODEFIRST_INVALID_ARG. ]*/
+    TEST_FUNCTION(CodeFirst_SendAsyncReportedChanges_with_a_property_of_the_device_fails)
     {
-        ///arrange
+        /// arrange
         (void)CodeFirst_Init(NULL);
-        unsigned char *destination = (unsigned char*)my_gballoc_malloc(10);
-        size_t destinationSize = 10;
-        void* device = CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &DummyDataProvider_allReflected, sizeof(TruckType), false);
+        size_t destinationSize = 1000;
+        unsigned char *destination = (unsigned char*)my_gballoc_malloc(destinationSize);
+        SimpleDevice_Model* device = (SimpleDevice_Model*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &ALL_REFLECTED(testReflectedData), sizeof(SimpleDevice_Model), false);
         umock_c_reset_all_calls();
 
-        ///act
-        CODEFIRST_RESULT result = CodeFirst_SendAsyncReported(&destination, &destinationSize, 0);
+        /// act
+        CODEFIRST_RESULT result = CodeFirst_SendAsyncReportedChanges(&destination, &destinationSize, &device->new_reported_this_is_int);
 
-        ///assert
+        /// assert
         ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_INVALID_ARG, result);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-        ///cleanup
+        /// cleanup
         CodeFirst_DestroyDevice(device);
         my_gballoc_free(destination);
         CodeFirst_Deinit();
     }
 
-    /*Tests_SRS_CODEFIRST_02_018: [ If parameter destination, destinationSize or any of the values passed through va_args is NULL then CodeFirst_SendAsyncReported shall fail and return CODEFIRST_INVALID_ARG. ]*/
-    TEST_FUNCTION(CodeFirst_SendAsyncReported_with_one_NULL_reportedProperties_fails)
+    /*Tests_SRS_CODEFIRST_41_014: [ When there is no previous successful call, CodeFirst_SendAsyncReportedChanges shall publish all the reported properties of the device. ]*/
+    /*Tests_SRS_CODEFIRST_41_015: [ On success, CodeFirst_SendAsyncReportedChanges shall remember the current values of the reported properties and return CODEFIRST_OK. ]*/
+    TEST_FUNCTION(CodeFirst_SendAsyncReportedChanges_first_call_sends_all)
     {
-        ///arrange
+        /// arrange
         (void)CodeFirst_Init(NULL);
-        unsigned char *destination = (unsigned char*)my_gballoc_malloc(10);
-        size_t destinationSize = 10;
-        void* device = CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &DummyDataProvider_allReflected, sizeof(TruckType), false);
+        size_t destinationSize = 1000;
+        unsigned char *destination = (unsigned char*)my_gballoc_malloc(destinationSize);
+        SimpleDevice_Model* device = (SimpleDevice_Model*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &ALL_REFLECTED(testReflectedData), sizeof(SimpleDevice_Model), false);
         umock_c_reset_all_calls();
 
-        ///act
-        CODEFIRST_RESULT result = CodeFirst_SendAsyncReported(&destination, &destinationSize, 1, NULL);
+        device->new_reported_this_is_double = 5.5; /*the only reported properties*/
+        device->new_reported_this_is_int = -5; /*the only reported properties*/
 
-        ///assert
-        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_INVALID_ARG, result);
+        CodeFirst_SendReportedAsync_all_inert_path();
+
+        /// act
+        CODEFIRST_RESULT result = CodeFirst_SendAsyncReportedChanges(&destination, &destinationSize, device);
+
+        /// assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_OK, result);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-        ///cleanup
+        /// cleanup
         CodeFirst_DestroyDevice(device);
         my_gballoc_free(destination);
         CodeFirst_Deinit();
     }
 
-    /*Tests_SRS_CODEFIRST_02_019: [ If values passed through va_args do not belong to the same device then CodeFirst_SendAsyncReported shall fail and return CODEFIRST_VALUES_FROM_DIFFERENT_DEVICES_ERROR. ]*/
-    TEST_FUNCTION(CodeFirst_SendAsyncReported_with_reportedProperties_from_different_devices_fails)
+    /*Tests_SRS_CODEFIRST_41_013: [ CodeFirst_SendAsyncReportedChanges shall not publish a reported property of type double, float, int, long, int8_t, uint8_t, int16_t, int32_t, int64_t, bool, EDM_DATE_TIME_OFFSET or EDM_GUID whose value is the same as in the previous successful call. ]*/
+    TEST_FUNCTION(CodeFirst_SendAsyncReportedChanges_second_call_sends_only_the_changed_property)
     {
-        ///arrange
+        /// arrange
         (void)CodeFirst_Init(NULL);
         size_t destinationSize = 1000;
-        unsigned char *destination = (unsigned char*)my_gballoc_malloc(destinationSize);
-
-        TruckType* device1 = (TruckType*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &DummyDataProvider_allReflected, sizeof(TruckType), false);
-        TruckType* device2 = (TruckType*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &DummyDataProvider_allReflected, sizeof(TruckType), false);
-        device1->reported_this_is_int = 1;
-        device2->reported_this_is_int = 2;
+        unsigned char *destination = (unsigned char*)my_gballoc_malloc(destinationSize);
+        SimpleDevice_Model* device = (SimpleDevice_Model*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &ALL_REFLECTED(testReflectedData), sizeof(SimpleDevice_Model), false);
+        device->new_reported_this_is_double = 5.5;
+        device->new_reported_this_is_int = -5;
+        (void)CodeFirst_SendAsyncReportedChanges(&destination, &destinationSize, device);
         umock_c_reset_all_calls();
 
-        STRICT_EXPECTED_CALL(Device_CreateTransaction_ReportedProperties(IGNORED_PTR_ARG))
-            .IgnoreArgument_deviceHandle();
-        STRICT_EXPECTED_CALL(STRING_new());
-        STRICT_EXPECTED_CALL(Schema_GetModelName(IGNORED_PTR_ARG))
-            .IgnoreArgument_modelTypeHandle()
-            .SetReturn("TruckType");
-        STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "reported_this_is_int"))
-            .IgnoreArgument_handle();
-        STRICT_EXPECTED_CALL(Create_AGENT_DATA_TYPE_from_SINT32(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-            .IgnoreArgument_agentData()
-            .IgnoreArgument_v();
-        STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG))
-            .IgnoreArgument_handle();
-        STRICT_EXPECTED_CALL(Device_PublishTransacted_ReportedProperty(IGNORED_PTR_ARG, "reported_this_is_int", IGNORED_PTR_ARG))
+        device->new_reported_this_is_int = -6;
+
+        STRICT_EXPECTED_CALL(Device_CreateTransaction_ReportedProperties(TEST_DEVICE_HANDLE));
+        STRICT_EXPECTED_CALL(Schema_GetModelName(TEST_MODEL_HANDLE));
+        STRICT_EXPECTED_CALL(Create_AGENT_DATA_TYPE_from_SINT32(IGNORED_PTR_ARG, -6))
+            .IgnoreArgument_agentData();
+        STRICT_EXPECTED_CALL(Device_PublishTransacted_ReportedProperty(IGNORED_PTR_ARG, "new_reported_this_is_int", IGNORED_PTR_ARG))
             .IgnoreArgument_transactionHandle()
             .IgnoreArgument_data();
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument_handle();
-        STRICT_EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG))
-            .IgnoreArgument_agentData();
+        EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(Device_CommitTransaction_ReportedProperties(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_transactionHandle()
+            .IgnoreArgument(2)
+            .IgnoreArgument(3);
         STRICT_EXPECTED_CALL(Device_DestroyTransaction_ReportedProperties(IGNORED_PTR_ARG))
             .IgnoreArgument_transactionHandle();
 
-        ///act
-        CODEFIRST_RESULT result = CodeFirst_SendAsyncReported(&destination, &destinationSize, 2, &device1->reported_this_is_int, &device2->reported_this_is_int);
+        /// act
+        CODEFIRST_RESULT result = CodeFirst_SendAsyncReportedChanges(&destination, &destinationSize, device);
 
-        ///assert
-        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_VALUES_FROM_DIFFERENT_DEVICES_ERROR, result);
+        /// assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_OK, result);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-        ///cleanup
-        CodeFirst_DestroyDevice(device2);
-        CodeFirst_DestroyDevice(device1);
+        /// cleanup
+        CodeFirst_DestroyDevice(device);
         my_gballoc_free(destination);
         CodeFirst_Deinit();
     }
 
-    /*Tests_SRS_CODEFIRST_02_020: [ If values passed through va_args are not all of type REFLECTED_REPORTED_PROPERTY then CodeFirst_SendAsyncReported shall fail and return CODEFIRST_INVALID_ARG. ]*/
-    TEST_FUNCTION(CodeFirst_SendAsyncReported_WITH_DATA_fails)
+    /*Tests_SRS_CODEFIRST_41_017: [ If any error occurs, CodeFirst_SendAsyncReportedChanges shall fail and return CODEFIRST_ERROR, CODEFIRST_AGENT_DATA_TYPE_ERROR or CODEFIRST_DEVICE_PUBLISH_FAILED. ]*/
+    TEST_FUNCTION(CodeFirst_SendAsyncReportedChanges_after_a_failed_call_sends_all)
     {
-        ///arrange
+        /// arrange
         (void)CodeFirst_Init(NULL);
         size_t destinationSize = 1000;
         unsigned char *destination = (unsigned char*)my_gballoc_malloc(destinationSize);
-        TruckType* device = (TruckType*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &DummyDataProvider_allReflected, sizeof(TruckType), false);
-        device->reported_this_is_int = 3;
+        SimpleDevice_Model* device = (SimpleDevice_Model*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &ALL_REFLECTED(testReflectedData), sizeof(SimpleDevice_Model), false);
+        device->new_reported_this_is_double = 5.5;
+        device->new_reported_this_is_int = -5;
+        STRICT_EXPECTED_CALL(Device_CommitTransaction_ReportedProperties(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments()
+            .SetReturn(DEVICE_ERROR);
+        CODEFIRST_RESULT failedResult = CodeFirst_SendAsyncReportedChanges(&destination, &destinationSize, device);
         umock_c_reset_all_calls();
 
-        STRICT_EXPECTED_CALL(Device_CreateTransaction_ReportedProperties(IGNORED_PTR_ARG))
-            .IgnoreArgument_deviceHandle();
-        STRICT_EXPECTED_CALL(STRING_new());
-        STRICT_EXPECTED_CALL(Schema_GetModelName(IGNORED_PTR_ARG))
-            .IgnoreArgument_modelTypeHandle();
-        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
-            .IgnoreArgument_handle();
-        STRICT_EXPECTED_CALL(Device_DestroyTransaction_ReportedProperties(IGNORED_PTR_ARG))
-            .IgnoreArgument_transactionHandle();
+        CodeFirst_SendReportedAsync_all_inert_path();
 
-        ///act
-        CODEFIRST_RESULT result = CodeFirst_SendAsyncReported(&destination, &destinationSize, 1, &device->this_is_int); /*note: this_is_int is defined with WITH_DATA*/
+        /// act
+        CODEFIRST_RESULT result = CodeFirst_SendAsyncReportedChanges(&destination, &destinationSize, device);
 
-        ///assert
-        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_INVALID_ARG, result);
+        /// assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_DEVICE_PUBLISH_FAILED, failedResult);
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_OK, result);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-        ///cleanup
+        /// cleanup
         CodeFirst_DestroyDevice(device);
         my_gballoc_free(destination);
         CodeFirst_Deinit();
     }
 
-    /*Tests_SRS_CODEFIRST_02_020: [ If values passed through va_args are not all of type REFLECTED_REPORTED_PROPERTY then CodeFirst_SendAsyncReported shall fail and return CODEFIRST_INVALID_ARG. ]*/
-    TEST_FUNCTION(CodeFirst_SendAsyncReported_with_reportedProperty_outside_any_device_fails)
+    /*Tests_SRS_CODEFIRST_41_035: [ If parameter device is NULL or deadband is negative or not a number then CodeFirst_SetReportedChangesDeadband shall fail and return CODEFIRST_INVALID_ARG. ]*/
+    TEST_FUNCTION(CodeFirst_SetReportedChangesDeadband_with_negative_deadband_fails)
     {
-        ///arrange
+        /// arrange
         (void)CodeFirst_Init(NULL);
-        size_t destinationSize = 1000;
-        unsigned char *destination = (unsigned char*)my_gballoc_malloc(destinationSize);
-        TruckType* device = (TruckType*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &DummyDataProvider_allReflected, sizeof(TruckType), false);
-        device->reported_this_is_int = 3;
+        SimpleDevice_Model* device = (SimpleDevice_Model*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &ALL_REFLECTED(testReflectedData), sizeof(SimpleDevice_Model), false);
         umock_c_reset_all_calls();
 
-        ///act
-        CODEFIRST_RESULT result = CodeFirst_SendAsyncReported(&destination, &destinationSize, 1, &(device+1)->reported_this_is_int); /*note: this is out of the memory of the device*/
+        /// act
+        CODEFIRST_RESULT result = CodeFirst_SetReportedChangesDeadband(device, -1.0);
 
-        ///assert
+        /// assert
         ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_INVALID_ARG, result);
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-        ///cleanup
+        /// cleanup
         CodeFirst_DestroyDevice(device);
-        my_gballoc_free(destination);
         CodeFirst_Deinit();
     }
 
-    static void CodeFirst_SendReportedAsync_all_inert_path(void)
+    /*Tests_SRS_CODEFIRST_41_036: [ While a deadband is set, CodeFirst_SendAsyncReportedChanges shall not publish a reported property of type double, float, int, long, int8_t, uint8_t, int16_t, int32_t or int64_t whose value is within the deadband of the value it last published. ]*/
+    /*Tests_SRS_CODEFIRST_41_038: [ CodeFirst_SetReportedChangesDeadband shall set the deadband used by the next calls to CodeFirst_SendAsyncReportedChanges for device, 0 only skipping the values that did not change, and return CODEFIRST_OK. ]*/
+    TEST_FUNCTION(CodeFirst_SendAsyncReportedChanges_with_deadband_sends_only_the_property_beyond_it)
     {
-        STRICT_EXPECTED_CALL(Device_CreateTransaction_ReportedProperties(TEST_DEVICE_HANDLE));
-        STRICT_EXPECTED_CALL(Schema_GetModelName(TEST_MODEL_HANDLE));
+        /// arrange
+        (void)CodeFirst_Init(NULL);
+        size_t destinationSize = 1000;
+        unsigned char *destination = (unsigned char*)my_gballoc_malloc(destinationSize);
+        SimpleDevice_Model* device = (SimpleDevice_Model*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &ALL_REFLECTED(testReflectedData), sizeof(SimpleDevice_Model), false);
+        CODEFIRST_RESULT deadbandResult = CodeFirst_SetReportedChangesDeadband(device, 1.0);
+        device->new_reported_this_is_double = 5.5;
+        device->new_reported_this_is_int = -5;
+        (void)CodeFirst_SendAsyncReportedChanges(&destination, &destinationSize, device);
+        umock_c_reset_all_calls();
 
-        STRICT_EXPECTED_CALL(Create_AGENT_DATA_TYPE_from_DOUBLE(IGNORED_PTR_ARG, 5.5))
-            .IgnoreArgument_agentData();
-        STRICT_EXPECTED_CALL(Device_PublishTransacted_ReportedProperty(IGNORED_PTR_ARG, "new_reported_this_is_double", IGNORED_PTR_ARG))
-            .IgnoreArgument_transactionHandle()
-            .IgnoreArgument_data();
-        EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG));
+        device->new_reported_this_is_double = 6.0;
+        device->new_reported_this_is_int = -7;
 
-        STRICT_EXPECTED_CALL(Create_AGENT_DATA_TYPE_from_SINT32(IGNORED_PTR_ARG, -5))
+        STRICT_EXPECTED_CALL(Device_CreateTransaction_ReportedProperties(TEST_DEVICE_HANDLE));
+        STRICT_EXPECTED_CALL(Schema_GetModelName(TEST_MODEL_HANDLE));
+        STRICT_EXPECTED_CALL(Create_AGENT_DATA_TYPE_from_SINT32(IGNORED_PTR_ARG, -7))
             .IgnoreArgument_agentData();
         STRICT_EXPECTED_CALL(Device_PublishTransacted_ReportedProperty(IGNORED_PTR_ARG, "new_reported_this_is_int", IGNORED_PTR_ARG))
             .IgnoreArgument_transactionHandle()
             .IgnoreArgument_data();
         EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG));
-
         STRICT_EXPECTED_CALL(Device_CommitTransaction_ReportedProperties(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument_transactionHandle()
             .IgnoreArgument(2)
             .IgnoreArgument(3);
-
+        STRICT_EXPECTED_CALL(Schema_GetModelName(TEST_MODEL_HANDLE));
         STRICT_EXPECTED_CALL(Device_DestroyTransaction_ReportedProperties(IGNORED_PTR_ARG))
             .IgnoreArgument_transactionHandle();
+
+        /// act
+        CODEFIRST_RESULT result = CodeFirst_SendAsyncReportedChanges(&destination, &destinationSize, device);
+
+        /// assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_OK, deadbandResult);
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_OK, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        /// cleanup
+        CodeFirst_DestroyDevice(device);
+        my_gballoc_free(destination);
+        CodeFirst_Deinit();
     }
 
-    /*Tests_SRS_CODEFIRST_02_021: [ If the value passed through va_args is a complete model instance, then CodeFirst_SendAsyncReported shall send all the reported properties of that device. ]*/
-    /*Tests_SRS_CODEFIRST_02_022: [ CodeFirst_SendAsyncReported shall start a transaction by calling Device_CreateTransaction_ReportedProperties. ]*/
-    /*Tests_SRS_CODEFIRST_02_023: [ CodeFirst_SendAsyncReported shall convert all REPORTED_PROPERTY model components to AGENT_DATA_TYPE. ]*/
-    /*Tests_SRS_CODEFIRST_02_024: [ CodeFirst_SendAsyncReported shall call Device_PublishTransacted_ReportedProperty for every AGENT_DATA_TYPE converted from REPORTED_PROPERTY. ]*/
-    /*Tests_SRS_CODEFIRST_02_026: [ CodeFirst_SendAsyncReported shall call Device_CommitTransaction_ReportedProperties to commit the transaction. ]*/
-    /*Tests_SRS_CODEFIRST_02_028: [ CodeFirst_SendAsyncReported shall return CODEFIRST_OK when it succeeds. ]*/
-    /*Tests_SRS_CODEFIRST_02_029: [ CodeFirst_SendAsyncReported shall call Device_DestroyTransaction_ReportedProperties to destroy the transaction. ]*/
-    TEST_FUNCTION(CodeFirst_SendReportedAsync_all_happy_path)
+    /*Tests_SRS_CODEFIRST_41_036: [ While a deadband is set, CodeFirst_SendAsyncReportedChanges shall not publish a reported property of type double, float, int, long, int8_t, uint8_t, int16_t, int32_t or int64_t whose value is within the deadband of the value it last published. ]*/
+    TEST_FUNCTION(CodeFirst_SendAsyncReportedChanges_with_deadband_compares_with_the_value_last_published)
     {
         /// arrange
         (void)CodeFirst_Init(NULL);
         size_t destinationSize = 1000;
         unsigned char *destination = (unsigned char*)my_gballoc_malloc(destinationSize);
         SimpleDevice_Model* device = (SimpleDevice_Model*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &ALL_REFLECTED(testReflectedData), sizeof(SimpleDevice_Model), false);
+        (void)CodeFirst_SetReportedChangesDeadband(device, 1.0);
+        device->new_reported_this_is_double = 5.5;
+        device->new_reported_this_is_int = -5;
+        (void)CodeFirst_SendAsyncReportedChanges(&destination, &destinationSize, device);
+        device->new_reported_this_is_double = 6.0;
+        device->new_reported_this_is_int = -7;
+        (void)CodeFirst_SendAsyncReportedChanges(&destination, &destinationSize, device);
         umock_c_reset_all_calls();
 
-        device->new_reported_this_is_double = 5.5; /*the only reported properties*/
-        device->new_reported_this_is_int = -5; /*the only reported properties*/
+        device->new_reported_this_is_double = 6.6; /*more than 1.0 away from 5.5, the value last published, though not from 6.0*/
 
-        CodeFirst_SendReportedAsync_all_inert_path();
+        STRICT_EXPECTED_CALL(Device_CreateTransaction_ReportedProperties(TEST_DEVICE_HANDLE));
+        STRICT_EXPECTED_CALL(Schema_GetModelName(TEST_MODEL_HANDLE));
+        STRICT_EXPECTED_CALL(Create_AGENT_DATA_TYPE_from_DOUBLE(IGNORED_PTR_ARG, 6.6))
+            .IgnoreArgument_agentData();
+        STRICT_EXPECTED_CALL(Device_PublishTransacted_ReportedProperty(IGNORED_PTR_ARG, "new_reported_this_is_double", IGNORED_PTR_ARG))
+            .IgnoreArgument_transactionHandle()
+            .IgnoreArgument_data();
+        EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(Device_CommitTransaction_ReportedProperties(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_transactionHandle()
+            .IgnoreArgument(2)
+            .IgnoreArgument(3);
+        STRICT_EXPECTED_CALL(Schema_GetModelName(TEST_MODEL_HANDLE));
+        STRICT_EXPECTED_CALL(Device_DestroyTransaction_ReportedProperties(IGNORED_PTR_ARG))
+            .IgnoreArgument_transactionHandle();
 
         /// act
-        CODEFIRST_RESULT result = CodeFirst_SendAsyncReported(&destination, &destinationSize, 1, device);
+        CODEFIRST_RESULT result = CodeFirst_SendAsyncReportedChanges(&destination, &destinationSize, device);
 
         /// assert
         ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_OK, result);
@@ -3637,58 +4574,31 @@ BEGIN_TEST_SUITE(CodeFirst_ut_Dummy_Data_Provider)
         CodeFirst_Deinit();
     }
 
-    /*Tests_SRS_CODEFIRST_02_027: [ If any error occurs, CodeFirst_SendAsyncReported shall fail and return CODEFIRST_ERROR. ]*/
-    TEST_FUNCTION(CodeFirst_SendReportedAsync_all_unhappy_path)
+    /*Tests_SRS_CODEFIRST_41_016: [ CodeFirst_ResetReportedChanges shall forget the values remembered by CodeFirst_SendAsyncReportedChanges so that the next call publishes all the reported properties of the device. ]*/
+    TEST_FUNCTION(CodeFirst_ResetReportedChanges_makes_the_next_call_send_all)
     {
-        ///arrange
+        /// arrange
         (void)CodeFirst_Init(NULL);
         size_t destinationSize = 1000;
         unsigned char *destination = (unsigned char*)my_gballoc_malloc(destinationSize);
         SimpleDevice_Model* device = (SimpleDevice_Model*)CodeFirst_CreateDevice(TEST_MODEL_HANDLE, &ALL_REFLECTED(testReflectedData), sizeof(SimpleDevice_Model), false);
-        (void)umock_c_negative_tests_init();
+        device->new_reported_this_is_double = 5.5;
+        device->new_reported_this_is_int = -5;
+        (void)CodeFirst_SendAsyncReportedChanges(&destination, &destinationSize, device);
+        CodeFirst_ResetReportedChanges(device);
         umock_c_reset_all_calls();
 
-        device->new_reported_this_is_double = 5.5; /*the only reported properties*/
-        device->new_reported_this_is_int = -5; /*the only reported properties*/
-
         CodeFirst_SendReportedAsync_all_inert_path();
 
-        umock_c_negative_tests_snapshot();
-
-        size_t calls_that_cannot_fail[] =
-        {
-            1,/*Schema_GetModelName*/
-            4,/*Destroy_AGENT_DATA_TYPE*/
-            7,/*Destroy_AGENT_DATA_TYPE*/
-            9,/*Device_DestroyTransaction_ReportedProperties*/
-        };
-
-        for (size_t i = 0; i < umock_c_negative_tests_call_count(); i++)
-        {
-            size_t j;
-            for (j = 0;j < sizeof(calls_that_cannot_fail) / sizeof(calls_that_cannot_fail[0]);j++) /*not running the tests that cannot fail*/
-            {
-                if (calls_that_cannot_fail[j] == i)
-                    break;
-            }
-
-            if (j == sizeof(calls_that_cannot_fail) / sizeof(calls_that_cannot_fail[0]))
-            {
-                umock_c_negative_tests_reset();
-                umock_c_negative_tests_fail_call(i);
-                char temp_str[128];
-                sprintf(temp_str, "On failed call %lu", (unsigned long)i);
-                ///act
-                CODEFIRST_RESULT result = CodeFirst_SendAsyncReported(&destination, &destinationSize, 1, device);
+        /// act
+        CODEFIRST_RESULT result = CodeFirst_SendAsyncReportedChanges(&destination, &destinationSize, device);
 
-                ///assert
-                ASSERT_ARE_NOT_EQUAL(CODEFIRST_RESULT, CODEFIRST_OK, result, temp_str);
-            }
-        }
+        /// assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_OK, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
-        ///cleanup
+        /// cleanup
         CodeFirst_DestroyDevice(device);
-        umock_c_negative_tests_deinit();
         my_gballoc_free(destination);
         CodeFirst_Deinit();
     }
@@ -3932,6 +4842,95 @@ BEGIN_TEST_SUITE(CodeFirst_ut_Dummy_Data_Provider)
         CodeFirst_Deinit();
     }
 
+    /*Tests_SRS_CODEFIRST_41_031: [ If device or cborPayload is NULL, or cborPayloadSize is 0, CodeFirst_IngestDesiredPropertiesCbor shall fail and return CODEFIRST_INVALID_ARG. ]*/
+    TEST_FUNCTION(CodeFirst_IngestDesiredPropertiesCbor_with_NULL_device_fails)
+    {
+        ///arrange
+        static const unsigned char cbor[] = { 0xA1, 0x61, 'a', 0x03 };
+
+        ///act
+        CODEFIRST_RESULT result = CodeFirst_IngestDesiredPropertiesCbor(NULL, cbor, sizeof(cbor), false);
+
+        ///assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_INVALID_ARG, result);
+    }
+
+    /*Tests_SRS_CODEFIRST_41_031: [ If device or cborPayload is NULL, or cborPayloadSize is 0, CodeFirst_IngestDesiredPropertiesCbor shall fail and return CODEFIRST_INVALID_ARG. ]*/
+    TEST_FUNCTION(CodeFirst_IngestDesiredPropertiesCbor_with_zero_size_fails)
+    {
+        ///arrange
+        static const unsigned char cbor[] = { 0xA1, 0x61, 'a', 0x03 };
+        (void)CodeFirst_Init(NULL);
+        OuterType* device = (OuterType*)CodeFirst_CreateDevice(TEST_OUTERTYPE_MODEL_HANDLE, &ALL_REFLECTED(testModelInModelReflected), sizeof(OuterType), false);
+        umock_c_reset_all_calls();
+
+        ///act
+        CODEFIRST_RESULT result = CodeFirst_IngestDesiredPropertiesCbor(device, cbor, 0, false);
+
+        ///assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///clean
+        CodeFirst_DestroyDevice(device);
+        CodeFirst_Deinit();
+    }
+
+    /*Tests_SRS_CODEFIRST_41_032: [ CodeFirst_IngestDesiredPropertiesCbor shall convert cborPayload to JSON by calling CBORDecoder_ToJSON. ]*/
+    /*Tests_SRS_CODEFIRST_41_033: [ CodeFirst_IngestDesiredPropertiesCbor shall ingest the JSON as CodeFirst_IngestDesiredProperties does and return its result. ]*/
+    TEST_FUNCTION(CodeFirst_IngestDesiredPropertiesCbor_succeeds)
+    {
+        ///arrange
+        static const unsigned char cbor[] = { 0xA1, 0x61, 'a', 0x03 };
+        (void)CodeFirst_Init(NULL);
+        OuterType* device = (OuterType*)CodeFirst_CreateDevice(TEST_OUTERTYPE_MODEL_HANDLE, &ALL_REFLECTED(testModelInModelReflected), sizeof(OuterType), false);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(STRING_new());
+        STRICT_EXPECTED_CALL(CBORDecoder_ToJSON(cbor, sizeof(cbor), IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(Device_IngestDesiredProperties(device, IGNORED_PTR_ARG, "{\"a\":3}", false))
+            .IgnoreArgument_deviceHandle();
+        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+
+        ///act
+        CODEFIRST_RESULT result = CodeFirst_IngestDesiredPropertiesCbor(device, cbor, sizeof(cbor), false);
+
+        ///assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_OK, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///clean
+        CodeFirst_DestroyDevice(device);
+        CodeFirst_Deinit();
+    }
+
+    /*Tests_SRS_CODEFIRST_41_034: [ If there is any failure, then CodeFirst_IngestDesiredPropertiesCbor shall fail and return CODEFIRST_ERROR. ]*/
+    TEST_FUNCTION(CodeFirst_IngestDesiredPropertiesCbor_when_CBORDecoder_ToJSON_fails_fails)
+    {
+        ///arrange
+        static const unsigned char cbor[] = { 0xA1, 0x61, 'a', 0x03 };
+        (void)CodeFirst_Init(NULL);
+        OuterType* device = (OuterType*)CodeFirst_CreateDevice(TEST_OUTERTYPE_MODEL_HANDLE, &ALL_REFLECTED(testModelInModelReflected), sizeof(OuterType), false);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(STRING_new());
+        STRICT_EXPECTED_CALL(CBORDecoder_ToJSON(cbor, sizeof(cbor), IGNORED_PTR_ARG))
+            .SetReturn(CBOR_DECODER_SYNTAX_ERROR);
+        STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+
+        ///act
+        CODEFIRST_RESULT result = CodeFirst_IngestDesiredPropertiesCbor(device, cbor, sizeof(cbor), false);
+
+        ///assert
+        ASSERT_ARE_EQUAL(CODEFIRST_RESULT, CODEFIRST_ERROR, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///clean
+        CodeFirst_DestroyDevice(device);
+        CodeFirst_Deinit();
+    }
+
     /* Tests_SRS_CODEFIRST_99_002:[ CodeFirst_RegisterSchema shall create the schema information and give it to the Schema module for one schema, identified by the metadata argument. On success, it shall return a handle to the model.] */
     TEST_FUNCTION(CodeFirst_CreateDevice_passes_onDesiredProperty_callbacks)
     {
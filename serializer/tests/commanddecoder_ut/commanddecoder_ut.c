@@ -197,6 +197,81 @@ static JSON_DECODER_RESULT my_JSONDecoder_JSON_To_MultiTree(char* json, MULTITRE
     return JSON_DECODER_OK;
 }
 
+typedef struct TEST_TOKEN_TAG
+{
+    JSON_DECODER_TOKEN token;
+    const char* text;
+} TEST_TOKEN;
+
+static const TEST_TOKEN intFieldTokens[] =
+{
+    { JSON_DECODER_TOKEN_OBJECT_BEGIN, "{" },
+    { JSON_DECODER_TOKEN_NAME, "int_field" },
+    { JSON_DECODER_TOKEN_NUMBER, "3" },
+    { JSON_DECODER_TOKEN_OBJECT_END, "}" }
+};
+
+static const TEST_TOKEN modelInModelTokens[] =
+{
+    { JSON_DECODER_TOKEN_OBJECT_BEGIN, "{" },
+    { JSON_DECODER_TOKEN_NAME, "modelInModel" },
+    { JSON_DECODER_TOKEN_OBJECT_BEGIN, "{" },
+    { JSON_DECODER_TOKEN_NAME, "int_field" },
+    { JSON_DECODER_TOKEN_NUMBER, "3" },
+    { JSON_DECODER_TOKEN_OBJECT_END, "}" },
+    { JSON_DECODER_TOKEN_OBJECT_END, "}" }
+};
+
+static const TEST_TOKEN desiredNodeTokens[] =
+{
+    { JSON_DECODER_TOKEN_OBJECT_BEGIN, "{" },
+    { JSON_DECODER_TOKEN_NAME, "desired" },
+    { JSON_DECODER_TOKEN_OBJECT_BEGIN, "{" },
+    { JSON_DECODER_TOKEN_NAME, "int_field" },
+    { JSON_DECODER_TOKEN_NUMBER, "3" },
+    { JSON_DECODER_TOKEN_NAME, "$version" },
+    { JSON_DECODER_TOKEN_NUMBER, "2" },
+    { JSON_DECODER_TOKEN_OBJECT_END, "}" },
+    { JSON_DECODER_TOKEN_NAME, "reported" },
+    { JSON_DECODER_TOKEN_OBJECT_BEGIN, "{" },
+    { JSON_DECODER_TOKEN_NAME, "int_field" },
+    { JSON_DECODER_TOKEN_ARRAY_BEGIN, "[" },
+    { JSON_DECODER_TOKEN_NUMBER, "1" },
+    { JSON_DECODER_TOKEN_ARRAY_END, "]" },
+    { JSON_DECODER_TOKEN_OBJECT_END, "}" },
+    { JSON_DECODER_TOKEN_OBJECT_END, "}" }
+};
+
+/*the tokens my_JSONDecoder_Tokenize hands to the token callback*/
+static const TEST_TOKEN* g_tokens;
+static size_t g_tokenCount;
+
+static void SetupTokens(const TEST_TOKEN* tokens, size_t tokenCount)
+{
+    g_tokens = tokens;
+    g_tokenCount = tokenCount;
+}
+
+static JSON_DECODER_RESULT my_JSONDecoder_Tokenize(const char* json, size_t length, JSON_DECODER_TOKEN_CALLBACK tokenCallback, void* context)
+{
+    JSON_DECODER_RESULT result = JSON_DECODER_OK;
+    size_t i;
+    (void)json;
+    (void)length;
+    for (i = 0; i < g_tokenCount; i++)
+    {
+        JSON_DECODER_SLICE slice;
+        slice.value = g_tokens[i].text;
+        slice.length = strlen(g_tokens[i].text);
+        if (tokenCallback(context, g_tokens[i].token, &slice) != 0)
+        {
+            result = JSON_DECODER_ERROR;
+            break;
+        }
+    }
+    return result;
+}
+
 static void my_MultiTree_Destroy(MULTITREE_HANDLE treeHandle)
 {
     (void)(treeHandle);
@@ -321,6 +396,7 @@ BEGIN_TEST_SUITE(CommandDecoder_ut)
         REGISTER_UMOCK_ALIAS_TYPE(pfOnDesiredProperty, void*);
         REGISTER_UMOCK_ALIAS_TYPE(SCHEMA_METHOD_HANDLE, void*);
         REGISTER_UMOCK_ALIAS_TYPE(SCHEMA_METHOD_ARGUMENT_HANDLE, void*);
+        REGISTER_UMOCK_ALIAS_TYPE(JSON_DECODER_TOKEN_CALLBACK, void*);
 
 
         REGISTER_UMOCK_ALIAS_TYPE(JSON_DECODER_RESULT, int);
@@ -341,6 +417,8 @@ BEGIN_TEST_SUITE(CommandDecoder_ut)
         REGISTER_GLOBAL_MOCK_HOOK(JSONDecoder_JSON_To_MultiTree, my_JSONDecoder_JSON_To_MultiTree);
         REGISTER_GLOBAL_MOCK_FAIL_RETURN(JSONDecoder_JSON_To_MultiTree, JSON_DECODER_ERROR);
         REGISTER_GLOBAL_MOCK_HOOK(MultiTree_Destroy, my_MultiTree_Destroy);
+        REGISTER_GLOBAL_MOCK_HOOK(JSONDecoder_Tokenize, my_JSONDecoder_Tokenize);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(JSONDecoder_Tokenize, JSON_DECODER_ERROR);
 
         REGISTER_GLOBAL_MOCK_HOOK(Create_AGENT_DATA_TYPE_from_Members, my_Create_AGENT_DATA_TYPE_from_Members);
 
@@ -1022,6 +1100,138 @@ BEGIN_TEST_SUITE(CommandDecoder_ut)
             .CopyOutArgumentBuffer(3, &StateAgentDataType, sizeof(StateAgentDataType));
         STRICT_EXPECTED_CALL(ActionCallbackMock(TEST_CALLBACK_CONTEXT_VALUE, "", "SetACState", 1, IGNORED_PTR_ARG))
             .IgnoreArgument(5);
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is the route remembered for the action*/
+            .IgnoreArgument(1);
+        SetupArgumentCalls(SetACStateActionHandle, 0, StateActionArgument, StateActionArgument_Name, StateActionArgument_Type);
+        EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(MultiTree_Destroy(IGNORED_PTR_ARG)).IgnoreArgument_treeHandle();
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*free-ing the copy of the buffer*/
+            .IgnoreArgument(1);
+
+        // act
+        EXECUTE_COMMAND_RESULT result = CommandDecoder_ExecuteCommand(commandDecoderHandle, TEST_COMMAND);
+
+        // assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(EXECUTE_COMMAND_RESULT, EXECUTE_COMMAND_SUCCESS, result);
+
+        // cleanup
+        CommandDecoder_Destroy(commandDecoderHandle);
+    }
+
+    /* Tests_SRS_COMMAND_DECODER_41_005: [ After an action or a method has been dispatched successfully for the first time, CommandDecoder shall remember its full path, relative path, name and the names and types of its arguments in declaration order. ]*/
+    /* Tests_SRS_COMMAND_DECODER_41_007: [ When a remembered path is dispatched again, CommandDecoder shall decode the arguments and call the callback using the remembered route, without splitting the path and without Schema lookups. ]*/
+    TEST_FUNCTION(CommandDecoder_ExecuteCommand_the_second_time_uses_the_remembered_route)
+    {
+        // arrange
+        COMMAND_DECODER_HANDLE commandDecoderHandle = CommandDecoder_Create(TEST_MODEL_HANDLE, ActionCallbackMock, TEST_CALLBACK_CONTEXT_VALUE, methodCallbackMock, TEST_CALLBACK_CONTEXT_VALUE);
+        umock_c_reset_all_calls();
+
+        size_t argCount = 1;
+        const char* stateValue = "true";
+        STRICT_EXPECTED_CALL(gballoc_malloc(strlen(TEST_COMMAND) + 1)); /*this creates a copy of the command that is given to JSON decoder*/
+        SetupCommand(quotedSetACStateName, setACStateName);
+        STRICT_EXPECTED_CALL(Schema_GetModelActionArgumentCount(SetACStateActionHandle, IGNORED_PTR_ARG))
+            .CopyOutArgumentBuffer(2, &argCount, sizeof(argCount));
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is allocating memory for the argument array*/
+            .IgnoreArgument(1);
+        SetupArgumentCalls(SetACStateActionHandle, 0, StateActionArgument, StateActionArgument_Name, StateActionArgument_Type);
+        STRICT_EXPECTED_CALL(MultiTree_GetChildByName(TEST_COMMAND_ARGS_NODE, "State", IGNORED_PTR_ARG))
+            .CopyOutArgumentBuffer(3, &TEST_ARG1_NODE, sizeof(TEST_ARG1_NODE));
+        STRICT_EXPECTED_CALL(CodeFirst_GetPrimitiveType("bool"))
+            .SetReturn(EDM_BOOLEAN_TYPE);
+        STRICT_EXPECTED_CALL(MultiTree_GetValue(TEST_ARG1_NODE, IGNORED_PTR_ARG))
+            .CopyOutArgumentBuffer(2, &stateValue, sizeof(stateValue));
+        STRICT_EXPECTED_CALL(CreateAgentDataType_From_String(stateValue, EDM_BOOLEAN_TYPE, IGNORED_PTR_ARG))
+            .CopyOutArgumentBuffer(3, &StateAgentDataType, sizeof(StateAgentDataType));
+        STRICT_EXPECTED_CALL(ActionCallbackMock(TEST_CALLBACK_CONTEXT_VALUE, "", "SetACState", 1, IGNORED_PTR_ARG))
+            .IgnoreArgument(5);
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is the route remembered for the action*/
+            .IgnoreArgument(1);
+        SetupArgumentCalls(SetACStateActionHandle, 0, StateActionArgument, StateActionArgument_Name, StateActionArgument_Type);
+        EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(MultiTree_Destroy(IGNORED_PTR_ARG)).IgnoreArgument_treeHandle();
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*free-ing the copy of the buffer*/
+            .IgnoreArgument(1);
+        (void)CommandDecoder_ExecuteCommand(commandDecoderHandle, TEST_COMMAND);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(gballoc_malloc(strlen(TEST_COMMAND) + 1)); /*this creates a copy of the command that is given to JSON decoder*/
+        STRICT_EXPECTED_CALL(JSONDecoder_JSON_To_MultiTree(TestCommand, IGNORED_PTR_ARG)).IgnoreArgument(2);
+        STRICT_EXPECTED_CALL(Schema_GetSchemaForModelType(TEST_MODEL_HANDLE));
+        STRICT_EXPECTED_CALL(MultiTree_GetChildByName(TEST_COMMAND_ROOT_NODE, "Name", IGNORED_PTR_ARG))
+            .CopyOutArgumentBuffer(3, &TEST_COMMAND_NAME_NODE, sizeof(TEST_COMMAND_NAME_NODE));
+        STRICT_EXPECTED_CALL(MultiTree_GetValue(TEST_COMMAND_NAME_NODE, IGNORED_PTR_ARG))
+            .CopyOutArgumentBuffer(2, &quotedSetACStateName, sizeof(quotedSetACStateName));
+        STRICT_EXPECTED_CALL(MultiTree_GetChildByName(TEST_COMMAND_ROOT_NODE, "Parameters", IGNORED_PTR_ARG))
+            .CopyOutArgumentBuffer(3, &TEST_COMMAND_ARGS_NODE, sizeof(TEST_COMMAND_ARGS_NODE));
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is allocating memory for the argument array*/
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(MultiTree_GetChildByName(TEST_COMMAND_ARGS_NODE, "State", IGNORED_PTR_ARG))
+            .CopyOutArgumentBuffer(3, &TEST_ARG1_NODE, sizeof(TEST_ARG1_NODE));
+        STRICT_EXPECTED_CALL(CodeFirst_GetPrimitiveType("bool"))
+            .SetReturn(EDM_BOOLEAN_TYPE);
+        STRICT_EXPECTED_CALL(MultiTree_GetValue(TEST_ARG1_NODE, IGNORED_PTR_ARG))
+            .CopyOutArgumentBuffer(2, &stateValue, sizeof(stateValue));
+        STRICT_EXPECTED_CALL(CreateAgentDataType_From_String(stateValue, EDM_BOOLEAN_TYPE, IGNORED_PTR_ARG))
+            .CopyOutArgumentBuffer(3, &StateAgentDataType, sizeof(StateAgentDataType));
+        STRICT_EXPECTED_CALL(ActionCallbackMock(TEST_CALLBACK_CONTEXT_VALUE, "", "SetACState", 1, IGNORED_PTR_ARG))
+            .IgnoreArgument(5);
+        EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(MultiTree_Destroy(IGNORED_PTR_ARG)).IgnoreArgument_treeHandle();
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*free-ing the copy of the buffer*/
+            .IgnoreArgument(1);
+
+        // act
+        EXECUTE_COMMAND_RESULT result = CommandDecoder_ExecuteCommand(commandDecoderHandle, TEST_COMMAND);
+
+        // assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(EXECUTE_COMMAND_RESULT, EXECUTE_COMMAND_SUCCESS, result);
+
+        // cleanup
+        CommandDecoder_Destroy(commandDecoderHandle);
+    }
+
+    /* Tests_SRS_COMMAND_DECODER_41_006: [ If remembering the route fails, the result of the dispatch shall not change and the path shall be resolved again the next time it is dispatched. ]*/
+    TEST_FUNCTION(CommandDecoder_ExecuteCommand_when_remembering_the_route_fails_it_still_succeeds)
+    {
+        // arrange
+        COMMAND_DECODER_HANDLE commandDecoderHandle = CommandDecoder_Create(TEST_MODEL_HANDLE, ActionCallbackMock, TEST_CALLBACK_CONTEXT_VALUE, methodCallbackMock, TEST_CALLBACK_CONTEXT_VALUE);
+        umock_c_reset_all_calls();
+
+        size_t argCount = 1;
+        const char* stateValue = "true";
+        STRICT_EXPECTED_CALL(gballoc_malloc(strlen(TEST_COMMAND) + 1)); /*this creates a copy of the command that is given to JSON decoder*/
+        SetupCommand(quotedSetACStateName, setACStateName);
+        STRICT_EXPECTED_CALL(Schema_GetModelActionArgumentCount(SetACStateActionHandle, IGNORED_PTR_ARG))
+            .CopyOutArgumentBuffer(2, &argCount, sizeof(argCount));
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is allocating memory for the argument array*/
+            .IgnoreArgument(1);
+        SetupArgumentCalls(SetACStateActionHandle, 0, StateActionArgument, StateActionArgument_Name, StateActionArgument_Type);
+        STRICT_EXPECTED_CALL(MultiTree_GetChildByName(TEST_COMMAND_ARGS_NODE, "State", IGNORED_PTR_ARG))
+            .CopyOutArgumentBuffer(3, &TEST_ARG1_NODE, sizeof(TEST_ARG1_NODE));
+        STRICT_EXPECTED_CALL(CodeFirst_GetPrimitiveType("bool"))
+            .SetReturn(EDM_BOOLEAN_TYPE);
+        STRICT_EXPECTED_CALL(MultiTree_GetValue(TEST_ARG1_NODE, IGNORED_PTR_ARG))
+            .CopyOutArgumentBuffer(2, &stateValue, sizeof(stateValue));
+        STRICT_EXPECTED_CALL(CreateAgentDataType_From_String(stateValue, EDM_BOOLEAN_TYPE, IGNORED_PTR_ARG))
+            .CopyOutArgumentBuffer(3, &StateAgentDataType, sizeof(StateAgentDataType));
+        STRICT_EXPECTED_CALL(ActionCallbackMock(TEST_CALLBACK_CONTEXT_VALUE, "", "SetACState", 1, IGNORED_PTR_ARG))
+            .IgnoreArgument(5);
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is the route remembered for the action*/
+            .IgnoreArgument(1)
+            .SetReturn(NULL);
         EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG));
         STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
@@ -1319,6 +1529,10 @@ BEGIN_TEST_SUITE(CommandDecoder_ut)
 
         STRICT_EXPECTED_CALL(ActionCallbackMock(TEST_CALLBACK_CONTEXT_VALUE, "", "SetACState", 2, IGNORED_PTR_ARG))
             .IgnoreArgument(5);
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is the route remembered for the action*/
+            .IgnoreArgument(1);
+        SetupArgumentCalls(SetACStateActionHandle, 0, StateActionArgument, StateActionArgument_Name, StateActionArgument_Type);
+        SetupArgumentCalls(SetACStateActionHandle, 1, OtherArgActionArgument, OtherArgActionArgument_Name, OtherArgActionArgument_Type);
 
         EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG));
         EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG));
@@ -1766,6 +1980,9 @@ BEGIN_TEST_SUITE(CommandDecoder_ut)
             .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(ActionCallbackMock(TEST_CALLBACK_CONTEXT_VALUE, "", "SetLocation", 1, IGNORED_PTR_ARG))
             .IgnoreArgument(5);
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is the route remembered for the action*/
+            .IgnoreArgument(1);
+        SetupArgumentCalls(SetACStateActionHandle, 0, LocationActionArgument, LocationActionArgument_Name, LocationActionArgument_Type);
         EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG));
         STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
@@ -2673,6 +2890,9 @@ BEGIN_TEST_SUITE(CommandDecoder_ut)
             .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(ActionCallbackMock(TEST_CALLBACK_CONTEXT_VALUE, "", "SetLocation", 1, IGNORED_PTR_ARG))
             .IgnoreArgument(5);
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is the route remembered for the action*/
+            .IgnoreArgument(1);
+        SetupArgumentCalls(SetACStateActionHandle, 0, LocationActionArgument, LocationActionArgument_Name, LocationActionArgument_Type);
 
         EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG));
 
@@ -2733,6 +2953,8 @@ BEGIN_TEST_SUITE(CommandDecoder_ut)
         STRICT_EXPECTED_CALL(Schema_GetModelActionArgumentCount(SetACStateActionHandle, IGNORED_PTR_ARG))
             .CopyOutArgumentBuffer(2, &argCount, sizeof(argCount));
         STRICT_EXPECTED_CALL(ActionCallbackMock(TEST_CALLBACK_CONTEXT_VALUE, "ChildModel", "SetACState", 0, NULL));
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is the route remembered for the action*/
+            .IgnoreArgument(1);
 
         STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
@@ -2990,34 +3212,20 @@ BEGIN_TEST_SUITE(CommandDecoder_ut)
         CommandDecoder_Destroy(commandDecoderHandle);
     }
 
-    void CommandDecoder_IngestDesiredProperties_with_1_simple_desired_property_succeeds_inert_path(unsigned char* deviceMemoryArea, const char* desiredPropertiesJSON, const char* three, size_t one, MULTITREE_HANDLE childHandle, bool desiredPropertyHasCallback)
+    void CommandDecoder_IngestDesiredProperties_with_1_simple_desired_property_succeeds_inert_path(unsigned char* deviceMemoryArea, const char* desiredPropertiesJSON, bool desiredPropertyHasCallback)
     {
-        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, desiredPropertiesJSON))
-            .IgnoreArgument_destination();
-
-        STRICT_EXPECTED_CALL(JSONDecoder_JSON_To_MultiTree(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument_json()
-            .IgnoreArgument_multiTreeHandle();
-
-        STRICT_EXPECTED_CALL(MultiTree_DeleteChild(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument_treeHandle()
-            .IgnoreArgument_childName();
-
-        STRICT_EXPECTED_CALL(MultiTree_GetChildCount(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*2*/
-            .IgnoreArgument_treeHandle()
-            .CopyOutArgumentBuffer_count(&one, sizeof(one));
-
-        STRICT_EXPECTED_CALL(MultiTree_GetChild(IGNORED_PTR_ARG, 0, IGNORED_PTR_ARG))
-            .IgnoreArgument_treeHandle()
-            .CopyOutArgumentBuffer_childHandle(&childHandle, sizeof(childHandle));
+        SetupTokens(intFieldTokens, COUNT_OF(intFieldTokens));
 
-        STRICT_EXPECTED_CALL(STRING_new())
-            .SetReturn(TEST_STRING_HANDLE_CHILD_NAME);
+        STRICT_EXPECTED_CALL(JSONDecoder_Tokenize(desiredPropertiesJSON, strlen(desiredPropertiesJSON), IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*validation*/
+            .IgnoreArgument_tokenCallback()
+            .IgnoreArgument_context();
 
-        STRICT_EXPECTED_CALL(MultiTree_GetName(childHandle, TEST_STRING_HANDLE_CHILD_NAME)); /*this fills in TEST_STRING_HANDLE_CHILD_NAME with "int_field"*/
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument_size();
 
-        STRICT_EXPECTED_CALL(STRING_c_str(TEST_STRING_HANDLE_CHILD_NAME)) /*6*/
-            .SetReturn("int_field");
+        STRICT_EXPECTED_CALL(JSONDecoder_Tokenize(desiredPropertiesJSON, strlen(desiredPropertiesJSON), IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_tokenCallback()
+            .IgnoreArgument_context();
 
         STRICT_EXPECTED_CALL(Schema_GetModelElementByName(TEST_MODEL_HANDLE, "int_field"))
             .SetReturn(Schema_GetModelElementByName_desiredProperty_int_field);
@@ -3025,20 +3233,10 @@ BEGIN_TEST_SUITE(CommandDecoder_ut)
         STRICT_EXPECTED_CALL(Schema_GetModelDesiredPropertyType(TEST_DESIRED_PROPERTY_HANDLE_INT_FIELD))
             .SetReturn("int");
 
-        STRICT_EXPECTED_CALL(Schema_GetSchemaForModelType(TEST_MODEL_HANDLE))
-            .SetReturn(TEST_SCHEMA);
-
-        /*this is DecodeValueFromNode expected calls*/
-
         STRICT_EXPECTED_CALL(CodeFirst_GetPrimitiveType("int"))
             .SetReturn(EDM_INT32_TYPE);
 
-        STRICT_EXPECTED_CALL(MultiTree_GetValue(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument_treeHandle()
-            .CopyOutArgumentBuffer_destination(&three, sizeof(three));
-
-        STRICT_EXPECTED_CALL(CreateAgentDataType_From_String(IGNORED_PTR_ARG, EDM_INT32_TYPE, IGNORED_PTR_ARG))
-            .IgnoreArgument_source()
+        STRICT_EXPECTED_CALL(CreateAgentDataType_From_String("3", EDM_INT32_TYPE, IGNORED_PTR_ARG))
             .IgnoreArgument_agentData()
             .SetReturn(AGENT_DATA_TYPES_OK);
 
@@ -3064,19 +3262,16 @@ BEGIN_TEST_SUITE(CommandDecoder_ut)
         STRICT_EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG))
             .IgnoreArgument_agentData();
 
-        STRICT_EXPECTED_CALL(STRING_delete(TEST_STRING_HANDLE_CHILD_NAME));
-
-        STRICT_EXPECTED_CALL(MultiTree_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument_treeHandle();
-
         STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
             .IgnoreArgument_ptr();
     }
 
     /*case1: a simple property (non-recursive) is ingested*/
     /*the property is called "int_field" and shall have the value 3*/
-    /*Tests_SRS_COMMAND_DECODER_02_005: [ CommandDecoder_IngestDesiredProperties shall create a MULTITREE_HANDLE ouf of the clone of desiredProperties. ]*/
+    /*Tests_SRS_COMMAND_DECODER_41_001: [ CommandDecoder_IngestDesiredProperties shall check that jsonPayload is well formed by calling JSONDecoder_Tokenize before changing any desired property. ]*/
+    /*Tests_SRS_COMMAND_DECODER_41_002: [ CommandDecoder_IngestDesiredProperties shall decode jsonPayload with JSONDecoder_Tokenize, writing every desired property at its offset as soon as its value is read. ]*/
     /*Tests_SRS_COMMAND_DECODER_02_007: [ If the child name corresponds to a desired property then an AGENT_DATA_TYPE shall be constructed from the MULTITREE node. ]*/
+    /*Tests_SRS_COMMAND_DECODER_41_003: [ A desired property of a primitive type shall be converted from the text of its value by CreateAgentDataType_From_String. ]*/
     /*Tests_SRS_COMMAND_DECODER_02_008: [ The desired property shall be constructed in memory by calling pfDesiredPropertyFromAGENT_DATA_TYPE. ]*/
     /*Tests_SRS_COMMAND_DECODER_02_010: [ If the complete MULTITREE has been parsed then CommandDecoder_IngestDesiredProperties shall succeed and return EXECUTE_COMMAND_SUCCESS. ]*/
     TEST_FUNCTION(CommandDecoder_IngestDesiredProperties_with_1_simple_desired_property_happy_path)
@@ -3086,11 +3281,8 @@ BEGIN_TEST_SUITE(CommandDecoder_ut)
         umock_c_reset_all_calls();
         unsigned char deviceMemoryArea[100];
         const char* desiredPropertiesJSON = "{\"int_field\":3}";
-        const char* three = "3";
-        size_t one = 1;
-        MULTITREE_HANDLE childHandle = (MULTITREE_HANDLE)0x11;
 
-        CommandDecoder_IngestDesiredProperties_with_1_simple_desired_property_succeeds_inert_path(deviceMemoryArea, desiredPropertiesJSON, three, one, childHandle, false);
+        CommandDecoder_IngestDesiredProperties_with_1_simple_desired_property_succeeds_inert_path(deviceMemoryArea, desiredPropertiesJSON, false);
 
         ///act
         EXECUTE_COMMAND_RESULT result = CommandDecoder_IngestDesiredProperties(deviceMemoryArea, commandDecoderHandle, desiredPropertiesJSON, false);
@@ -3111,33 +3303,22 @@ BEGIN_TEST_SUITE(CommandDecoder_ut)
         COMMAND_DECODER_HANDLE commandDecoderHandle = CommandDecoder_Create(TEST_MODEL_HANDLE, ActionCallbackMock, TEST_CALLBACK_CONTEXT_VALUE, methodCallbackMock, TEST_CALLBACK_CONTEXT_VALUE);
         unsigned char deviceMemoryArea[100];
         const char* desiredPropertiesJSON = "{\"int_field\":3}";
-        const char* three = "3";
-        size_t one = 1;
-        MULTITREE_HANDLE childHandle = (MULTITREE_HANDLE)0x11;
         (void)umock_c_negative_tests_init();
         umock_c_reset_all_calls();
 
-        CommandDecoder_IngestDesiredProperties_with_1_simple_desired_property_succeeds_inert_path(deviceMemoryArea, desiredPropertiesJSON, three, one, childHandle, false);
+        CommandDecoder_IngestDesiredProperties_with_1_simple_desired_property_succeeds_inert_path(deviceMemoryArea, desiredPropertiesJSON, false);
 
         umock_c_negative_tests_snapshot();
 
         size_t calls_that_cannot_fail[] =
         {
-            2, /*MultiTree_DeleteChild*/
-
-            3,/*MultiTree_GetChildCount*/
-            7, /*STRING_c_str*/
-
-            9, /*Schema_GetModelDesiredPropertyType*/
-            10, /*Schema_GetSchemaForModelType*/
-            11, /*CodeFirst_GetPrimitiveType*/
-            14, /*Schema_GetModelDesiredProperty_pfDesiredPropertyFromAGENT_DATA_TYPE*/
-            15, /*Schema_GetModelDesiredProperty_offset*/
-            17, /*Schema_GetModelDesiredProperty_pfOnDesiredProperty*/
-            18, /*Destroy_AGENT_DATA_TYPE*/
-            19, /*STRING_delete*/
-            20, /*MultiTree_Destroy*/
-            21 /*gballoc_free*/
+            4, /*Schema_GetModelDesiredPropertyType*/
+            5, /*CodeFirst_GetPrimitiveType*/
+            7, /*Schema_GetModelDesiredProperty_pfDesiredPropertyFromAGENT_DATA_TYPE*/
+            8, /*Schema_GetModelDesiredProperty_offset*/
+            10, /*Schema_GetModelDesiredProperty_pfOnDesiredProperty*/
+            11, /*Destroy_AGENT_DATA_TYPE*/
+            12 /*gballoc_free*/
         };
 
         for (size_t i = 0; i < umock_c_negative_tests_call_count(); i++)
@@ -3172,93 +3353,138 @@ BEGIN_TEST_SUITE(CommandDecoder_ut)
         CommandDecoder_Destroy(commandDecoderHandle);
     }
 
-    void CommandDecoder_IngestDesiredProperties_with_1_simple_model_in_model_desired_property_inert_path(unsigned char* deviceMemoryArea, const char* desiredPropertiesJSON, const char* three, size_t one, MULTITREE_HANDLE childHandle, bool desiredPropertiesHaveCallbacks)
+    /*Tests_SRS_COMMAND_DECODER_41_001: [ CommandDecoder_IngestDesiredProperties shall check that jsonPayload is well formed by calling JSONDecoder_Tokenize before changing any desired property. ]*/
+    TEST_FUNCTION(CommandDecoder_IngestDesiredProperties_with_malformed_JSON_does_not_change_any_desired_property)
     {
-        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, desiredPropertiesJSON))
-            .IgnoreArgument_destination();
+        ///arrange
+        COMMAND_DECODER_HANDLE commandDecoderHandle = CommandDecoder_Create(TEST_MODEL_HANDLE, ActionCallbackMock, TEST_CALLBACK_CONTEXT_VALUE, methodCallbackMock, TEST_CALLBACK_CONTEXT_VALUE);
+        umock_c_reset_all_calls();
+        unsigned char deviceMemoryArea[100];
+        const char* desiredPropertiesJSON = "{\"int_field\":3,";
 
-        STRICT_EXPECTED_CALL(JSONDecoder_JSON_To_MultiTree(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument_json()
-            .IgnoreArgument_multiTreeHandle();
+        STRICT_EXPECTED_CALL(JSONDecoder_Tokenize(desiredPropertiesJSON, strlen(desiredPropertiesJSON), IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_tokenCallback()
+            .IgnoreArgument_context()
+            .SetReturn(JSON_DECODER_PARSE_ERROR);
 
-        STRICT_EXPECTED_CALL(MultiTree_DeleteChild(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreArgument_treeHandle()
-            .IgnoreArgument_childName();
+        ///act
+        EXECUTE_COMMAND_RESULT result = CommandDecoder_IngestDesiredProperties(deviceMemoryArea, commandDecoderHandle, desiredPropertiesJSON, false);
 
-        STRICT_EXPECTED_CALL(MultiTree_GetChildCount(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*2*/
-            .IgnoreArgument_treeHandle()
-            .CopyOutArgumentBuffer_count(&one, sizeof(one));
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(EXECUTE_COMMAND_RESULT, EXECUTE_COMMAND_ERROR, result);
 
-        STRICT_EXPECTED_CALL(MultiTree_GetChild(IGNORED_PTR_ARG, 0, IGNORED_PTR_ARG))
-            .IgnoreArgument_treeHandle()
-            .CopyOutArgumentBuffer_childHandle(&childHandle, sizeof(childHandle));
+        ///clean
+        CommandDecoder_Destroy(commandDecoderHandle);
+    }
 
-        STRICT_EXPECTED_CALL(STRING_new())
-            .SetReturn(TEST_STRING_HANDLE_CHILD_NAME);
+    /*Tests_SRS_COMMAND_DECODER_02_014: [ If parseDesiredNode is TRUE, parse only the `desired` part of JSON tree ]*/
+    /*Tests_SRS_COMMAND_DECODER_02_015: [ Remove '$version' string from node, if it is present.  It not being present is not an error ]*/
+    TEST_FUNCTION(CommandDecoder_IngestDesiredProperties_with_desired_node_skips_version_and_reported)
+    {
+        ///arrange
+        COMMAND_DECODER_HANDLE commandDecoderHandle = CommandDecoder_Create(TEST_MODEL_HANDLE, ActionCallbackMock, TEST_CALLBACK_CONTEXT_VALUE, methodCallbackMock, TEST_CALLBACK_CONTEXT_VALUE);
+        umock_c_reset_all_calls();
+        unsigned char deviceMemoryArea[100];
+        const char* desiredPropertiesJSON = "{\"desired\":{\"int_field\":3,\"$version\":2},\"reported\":{\"int_field\":[1]}}";
 
-        STRICT_EXPECTED_CALL(MultiTree_GetName(childHandle, TEST_STRING_HANDLE_CHILD_NAME)); /*this fills in TEST_STRING_HANDLE_CHILD_NAME with "modelInModel"*/
+        CommandDecoder_IngestDesiredProperties_with_1_simple_desired_property_succeeds_inert_path(deviceMemoryArea, desiredPropertiesJSON, false);
+        SetupTokens(desiredNodeTokens, COUNT_OF(desiredNodeTokens));
 
-        STRICT_EXPECTED_CALL(STRING_c_str(TEST_STRING_HANDLE_CHILD_NAME)) /*6*/
-            .SetReturn("modelInModel");
+        ///act
+        EXECUTE_COMMAND_RESULT result = CommandDecoder_IngestDesiredProperties(deviceMemoryArea, commandDecoderHandle, desiredPropertiesJSON, true);
 
-        STRICT_EXPECTED_CALL(Schema_GetModelElementByName(TEST_MODEL_HANDLE, "modelInModel"))
-            .SetReturn(Schema_GetModelElementByName_modelInModel);
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(EXECUTE_COMMAND_RESULT, EXECUTE_COMMAND_SUCCESS, result);
 
-        STRICT_EXPECTED_CALL(Schema_GetModelModelByName_Offset(TEST_MODEL_HANDLE, "modelInModel")) /*9*/
-            .SetReturn(10);
+        ///clean
+        CommandDecoder_Destroy(commandDecoderHandle);
+    }
 
-        /*here recursion happens*/
+    /*Tests_SRS_COMMAND_DECODER_02_014: [ If parseDesiredNode is TRUE, parse only the `desired` part of JSON tree ]*/
+    TEST_FUNCTION(CommandDecoder_IngestDesiredProperties_without_desired_node_fails)
+    {
+        ///arrange
+        COMMAND_DECODER_HANDLE commandDecoderHandle = CommandDecoder_Create(TEST_MODEL_HANDLE, ActionCallbackMock, TEST_CALLBACK_CONTEXT_VALUE, methodCallbackMock, TEST_CALLBACK_CONTEXT_VALUE);
+        umock_c_reset_all_calls();
+        unsigned char deviceMemoryArea[100];
+        const char* desiredPropertiesJSON = "{\"int_field\":3}";
 
-        {
-            STRICT_EXPECTED_CALL(MultiTree_GetChildCount(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*10*/
-                .IgnoreArgument_treeHandle()
-                .CopyOutArgumentBuffer_count(&one, sizeof(one));
+        SetupTokens(intFieldTokens, COUNT_OF(intFieldTokens));
 
-            STRICT_EXPECTED_CALL(MultiTree_GetChild(IGNORED_PTR_ARG, 0, IGNORED_PTR_ARG))
-                .IgnoreArgument_treeHandle()
-                .CopyOutArgumentBuffer_childHandle(&childHandle, sizeof(childHandle));
+        STRICT_EXPECTED_CALL(JSONDecoder_Tokenize(desiredPropertiesJSON, strlen(desiredPropertiesJSON), IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_tokenCallback()
+            .IgnoreArgument_context();
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument_size();
+        STRICT_EXPECTED_CALL(JSONDecoder_Tokenize(desiredPropertiesJSON, strlen(desiredPropertiesJSON), IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_tokenCallback()
+            .IgnoreArgument_context();
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument_ptr();
 
-            STRICT_EXPECTED_CALL(STRING_new())
-                .SetReturn(TEST_STRING_HANDLE_CHILD_NAME);
+        ///act
+        EXECUTE_COMMAND_RESULT result = CommandDecoder_IngestDesiredProperties(deviceMemoryArea, commandDecoderHandle, desiredPropertiesJSON, true);
 
-            STRICT_EXPECTED_CALL(MultiTree_GetName(childHandle, TEST_STRING_HANDLE_CHILD_NAME)); /*13*/ /*this fills in TEST_STRING_HANDLE_CHILD_NAME with "int_field"*/
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(EXECUTE_COMMAND_RESULT, EXECUTE_COMMAND_ERROR, result);
+
+        ///clean
+        CommandDecoder_Destroy(commandDecoderHandle);
+    }
+
+    void CommandDecoder_IngestDesiredProperties_with_1_simple_model_in_model_desired_property_inert_path(unsigned char* deviceMemoryArea, const char* desiredPropertiesJSON, bool desiredPropertiesHaveCallbacks)
+    {
+        SetupTokens(modelInModelTokens, COUNT_OF(modelInModelTokens));
+
+        STRICT_EXPECTED_CALL(JSONDecoder_Tokenize(desiredPropertiesJSON, strlen(desiredPropertiesJSON), IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*validation*/
+            .IgnoreArgument_tokenCallback()
+            .IgnoreArgument_context();
+
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument_size();
 
-            STRICT_EXPECTED_CALL(STRING_c_str(TEST_STRING_HANDLE_CHILD_NAME)) /*14*/
-                .SetReturn("int_field");
+        STRICT_EXPECTED_CALL(JSONDecoder_Tokenize(desiredPropertiesJSON, strlen(desiredPropertiesJSON), IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_tokenCallback()
+            .IgnoreArgument_context();
 
+        STRICT_EXPECTED_CALL(Schema_GetModelElementByName(TEST_MODEL_HANDLE, "modelInModel"))
+            .SetReturn(Schema_GetModelElementByName_modelInModel);
+
+        STRICT_EXPECTED_CALL(Schema_GetModelModelByName_Offset(TEST_MODEL_HANDLE, "modelInModel")) /*4*/
+            .SetReturn(10);
+
+        STRICT_EXPECTED_CALL(Schema_GetModelModelByName_OnDesiredProperty(TEST_MODEL_HANDLE, "modelInModel")) /*5*/
+            .SetReturn(desiredPropertiesHaveCallbacks ? onDesiredPropertyModelInModel : NULL);
+
+        /*here the members of the model in model are read*/
+
+        {
             STRICT_EXPECTED_CALL(Schema_GetModelElementByName(SCHEMA_MODEL_TYPE_HANDLE_MODEL_IN_MODEL, "int_field"))
                 .SetReturn(Schema_GetModelElementByName_desiredProperty_int_field);
 
-            STRICT_EXPECTED_CALL(Schema_GetModelDesiredPropertyType(TEST_DESIRED_PROPERTY_HANDLE_INT_FIELD)) /*17*/
+            STRICT_EXPECTED_CALL(Schema_GetModelDesiredPropertyType(TEST_DESIRED_PROPERTY_HANDLE_INT_FIELD)) /*7*/
                 .SetReturn("int");
 
-            STRICT_EXPECTED_CALL(Schema_GetSchemaForModelType(SCHEMA_MODEL_TYPE_HANDLE_MODEL_IN_MODEL)) /*18*/
-                .SetReturn(TEST_SCHEMA);
-
-            /*this is DecodeValueFromNodea expected calls*/
-
-            STRICT_EXPECTED_CALL(CodeFirst_GetPrimitiveType("int")) /*19*/
+            STRICT_EXPECTED_CALL(CodeFirst_GetPrimitiveType("int")) /*8*/
                 .SetReturn(EDM_INT32_TYPE);
 
-            STRICT_EXPECTED_CALL(MultiTree_GetValue(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-                .IgnoreArgument_treeHandle()
-                .CopyOutArgumentBuffer_destination(&three, sizeof(three));
-
-            STRICT_EXPECTED_CALL(CreateAgentDataType_From_String(IGNORED_PTR_ARG, EDM_INT32_TYPE, IGNORED_PTR_ARG))
-                .IgnoreArgument_source()
+            STRICT_EXPECTED_CALL(CreateAgentDataType_From_String("3", EDM_INT32_TYPE, IGNORED_PTR_ARG))
                 .IgnoreArgument_agentData()
                 .SetReturn(AGENT_DATA_TYPES_OK);
 
-            STRICT_EXPECTED_CALL(Schema_GetModelDesiredProperty_pfDesiredPropertyFromAGENT_DATA_TYPE(TEST_DESIRED_PROPERTY_HANDLE_INT_FIELD)) /*22*/
+            STRICT_EXPECTED_CALL(Schema_GetModelDesiredProperty_pfDesiredPropertyFromAGENT_DATA_TYPE(TEST_DESIRED_PROPERTY_HANDLE_INT_FIELD)) /*10*/
                 .SetReturn(int_pfDesiredPropertyFromAGENT_DATA_TYPE);
 
-            STRICT_EXPECTED_CALL(Schema_GetModelDesiredProperty_offset(TEST_DESIRED_PROPERTY_HANDLE_INT_FIELD)) /*23*/
+            STRICT_EXPECTED_CALL(Schema_GetModelDesiredProperty_offset(TEST_DESIRED_PROPERTY_HANDLE_INT_FIELD)) /*11*/
                 .SetReturn(2);
 
             STRICT_EXPECTED_CALL(int_pfDesiredPropertyFromAGENT_DATA_TYPE(IGNORED_PTR_ARG, (unsigned char*)deviceMemoryArea + 12))  /*notice here the new offset (2+10)*/
                 .IgnoreArgument_source();
 
-            STRICT_EXPECTED_CALL(Schema_GetModelDesiredProperty_pfOnDesiredProperty(IGNORED_PTR_ARG)) /*24*/
+            STRICT_EXPECTED_CALL(Schema_GetModelDesiredProperty_pfOnDesiredProperty(IGNORED_PTR_ARG)) /*13*/
                 .IgnoreArgument_desiredPropertyHandle()
                 .SetReturn(desiredPropertiesHaveCallbacks ? onDesiredPropertySimpleProperty : NULL);
 
@@ -3268,28 +3494,15 @@ BEGIN_TEST_SUITE(CommandDecoder_ut)
                     .IgnoreArgument_v();
             }
 
-
             STRICT_EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG))
                 .IgnoreArgument_agentData();
-
-            STRICT_EXPECTED_CALL(STRING_delete(TEST_STRING_HANDLE_CHILD_NAME));
         }
 
-        STRICT_EXPECTED_CALL(Schema_GetModelModelByName_OnDesiredProperty(IGNORED_PTR_ARG, "modelInModel")) /*27*/
-            .IgnoreArgument_modelTypeHandle()
-            .SetReturn(desiredPropertiesHaveCallbacks ? onDesiredPropertyModelInModel : NULL);
-
         if (desiredPropertiesHaveCallbacks)
         {
-            STRICT_EXPECTED_CALL(onDesiredPropertyModelInModel(IGNORED_PTR_ARG))
-                .IgnoreArgument_v();
+            STRICT_EXPECTED_CALL(onDesiredPropertyModelInModel(deviceMemoryArea));
         }
 
-        STRICT_EXPECTED_CALL(STRING_delete(TEST_STRING_HANDLE_CHILD_NAME));
-
-        STRICT_EXPECTED_CALL(MultiTree_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument_treeHandle();
-
         STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
             .IgnoreArgument_ptr();
     }
@@ -3302,11 +3515,8 @@ BEGIN_TEST_SUITE(CommandDecoder_ut)
         umock_c_reset_all_calls();
         unsigned char deviceMemoryArea[100];
         const char* desiredPropertiesJSON = "{\"modelInModel\":{\"int_field\":3}}";
-        const char* three = "3";
-        size_t one = 1;
-        MULTITREE_HANDLE childHandle = (MULTITREE_HANDLE)0x11;
 
-        CommandDecoder_IngestDesiredProperties_with_1_simple_model_in_model_desired_property_inert_path(deviceMemoryArea, desiredPropertiesJSON, three, one, childHandle, false);
+        CommandDecoder_IngestDesiredProperties_with_1_simple_model_in_model_desired_property_inert_path(deviceMemoryArea, desiredPropertiesJSON, false);
 
         ///act
         EXECUTE_COMMAND_RESULT result = CommandDecoder_IngestDesiredProperties(deviceMemoryArea, commandDecoderHandle, desiredPropertiesJSON, false);
@@ -3327,37 +3537,24 @@ BEGIN_TEST_SUITE(CommandDecoder_ut)
         COMMAND_DECODER_HANDLE commandDecoderHandle = CommandDecoder_Create(TEST_MODEL_HANDLE, ActionCallbackMock, TEST_CALLBACK_CONTEXT_VALUE, methodCallbackMock, TEST_CALLBACK_CONTEXT_VALUE);
         unsigned char deviceMemoryArea[100];
         const char* desiredPropertiesJSON = "{\"modelInModel\":{\"int_field\":3}}";
-        const char* three = "3";
-        size_t one = 1;
-        MULTITREE_HANDLE childHandle = (MULTITREE_HANDLE)0x11;
         (void)umock_c_negative_tests_init();
         umock_c_reset_all_calls();
 
-        CommandDecoder_IngestDesiredProperties_with_1_simple_model_in_model_desired_property_inert_path(deviceMemoryArea, desiredPropertiesJSON, three, one, childHandle, false);
+        CommandDecoder_IngestDesiredProperties_with_1_simple_model_in_model_desired_property_inert_path(deviceMemoryArea, desiredPropertiesJSON, false);
 
         umock_c_negative_tests_snapshot();
 
         size_t calls_that_cannot_fail[] =
         {
-            2, /*MultiTree_DeleteChild*/
-            3, /*MultiTree_GetChildCount*/
-            7, /*STRING_c_str*/
-            9, /*Schema_GetModelModelByName_Offset*/
-            10, /*MultiTree_GetChildCount*/
-            13, /*MultiTree_GetName*/
-            14, /*STRING_c_str*/
-            16, /*Schema_GetModelDesiredPropertyType*/
-            17, /*Schema_GetSchemaForModelType*/
-            18, /*CodeFirst_GetPrimitiveType*/
-            21, /*Schema_GetModelDesiredProperty_pfDesiredPropertyFromAGENT_DATA_TYPE*/
-            22, /*Schema_GetModelDesiredProperty_offset*/
-            24, /*Destroy_AGENT_DATA_TYPE*/
-            25, /*Schema_GetModelDesiredProperty_pfOnDesiredProperty*/
-            26, /*STRING_delete*/
-            27, /*STRING_delete*/
-            28, /*Schema_GetModelModelByName_OnDesiredProperty*/
-            29, /*MultiTree_Destroy*/
-            30, /*gballoc_free*/
+            4, /*Schema_GetModelModelByName_Offset*/
+            5, /*Schema_GetModelModelByName_OnDesiredProperty*/
+            7, /*Schema_GetModelDesiredPropertyType*/
+            8, /*CodeFirst_GetPrimitiveType*/
+            10, /*Schema_GetModelDesiredProperty_pfDesiredPropertyFromAGENT_DATA_TYPE*/
+            11, /*Schema_GetModelDesiredProperty_offset*/
+            13, /*Schema_GetModelDesiredProperty_pfOnDesiredProperty*/
+            14, /*Destroy_AGENT_DATA_TYPE*/
+            15, /*gballoc_free*/
         };
 
         for (size_t i = 0; i < umock_c_negative_tests_call_count(); i++)
@@ -3401,11 +3598,8 @@ BEGIN_TEST_SUITE(CommandDecoder_ut)
         umock_c_reset_all_calls();
         unsigned char deviceMemoryArea[100];
         const char* desiredPropertiesJSON = "{\"int_field\":3}";
-        const char* three = "3";
-        size_t one = 1;
-        MULTITREE_HANDLE childHandle = (MULTITREE_HANDLE)0x11;
 
-        CommandDecoder_IngestDesiredProperties_with_1_simple_desired_property_succeeds_inert_path(deviceMemoryArea, desiredPropertiesJSON, three, one, childHandle, true);
+        CommandDecoder_IngestDesiredProperties_with_1_simple_desired_property_succeeds_inert_path(deviceMemoryArea, desiredPropertiesJSON, true);
 
         ///act
         EXECUTE_COMMAND_RESULT result = CommandDecoder_IngestDesiredProperties(deviceMemoryArea, commandDecoderHandle, desiredPropertiesJSON, false);
@@ -3428,11 +3622,8 @@ BEGIN_TEST_SUITE(CommandDecoder_ut)
         umock_c_reset_all_calls();
         unsigned char deviceMemoryArea[100];
         const char* desiredPropertiesJSON = "{\"modelInModel\":{\"int_field\":3}}";
-        const char* three = "3";
-        size_t one = 1;
-        MULTITREE_HANDLE childHandle = (MULTITREE_HANDLE)0x11;
 
-        CommandDecoder_IngestDesiredProperties_with_1_simple_model_in_model_desired_property_inert_path(deviceMemoryArea, desiredPropertiesJSON, three, one, childHandle, true);
+        CommandDecoder_IngestDesiredProperties_with_1_simple_model_in_model_desired_property_inert_path(deviceMemoryArea, desiredPropertiesJSON, true);
 
         ///act
         EXECUTE_COMMAND_RESULT result = CommandDecoder_IngestDesiredProperties(deviceMemoryArea, commandDecoderHandle, desiredPropertiesJSON, false);
@@ -3519,6 +3710,8 @@ BEGIN_TEST_SUITE(CommandDecoder_ut)
             .CopyOutArgumentBuffer_argumentCount(zero, sizeof(*zero));
 
         STRICT_EXPECTED_CALL(methodCallbackMock(TEST_CALLBACK_CONTEXT_VALUE, "", "methodA", 0, NULL));
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is the route remembered for the method*/
+            .IgnoreArgument_size();
         STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)) /*this is freeing the relativeMethodPath*/
             .IgnoreArgument_ptr();
     }
@@ -3553,6 +3746,32 @@ BEGIN_TEST_SUITE(CommandDecoder_ut)
         CommandDecoder_Destroy(commandDecoderHandle);
     }
 
+    /*Tests_SRS_COMMAND_DECODER_41_005: [ After an action or a method has been dispatched successfully for the first time, CommandDecoder shall remember its full path, relative path, name and the names and types of its arguments in declaration order. ]*/
+    /*Tests_SRS_COMMAND_DECODER_41_007: [ When a remembered path is dispatched again, CommandDecoder shall decode the arguments and call the callback using the remembered route, without splitting the path and without Schema lookups. ]*/
+    TEST_FUNCTION(CommandDecoder_ExecuteMethod_with_NULL_payload_the_second_time_uses_the_remembered_route)
+    {
+        ///arrange
+        size_t zero = 0;
+        COMMAND_DECODER_HANDLE commandDecoderHandle = CommandDecoder_Create(TEST_MODEL_HANDLE, ActionCallbackMock, TEST_CALLBACK_CONTEXT_VALUE, methodCallbackMock, TEST_CALLBACK_CONTEXT_VALUE);
+        umock_c_reset_all_calls();
+        CommandDecoder_ExecuteMethod_with_NULL_payload_inert_path(&zero);
+        (void)CommandDecoder_ExecuteMethod(commandDecoderHandle, "methodA", NULL);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(Schema_GetSchemaForModelType(TEST_MODEL_HANDLE));
+        STRICT_EXPECTED_CALL(methodCallbackMock(TEST_CALLBACK_CONTEXT_VALUE, "", "methodA", 0, NULL));
+
+        ///act
+        METHODRETURN_HANDLE methodReturn = CommandDecoder_ExecuteMethod(commandDecoderHandle, "methodA", NULL);
+
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(void_ptr, g_methodReturnValue, methodReturn);
+
+        ///cleanup
+        CommandDecoder_Destroy(commandDecoderHandle);
+    }
+
     /*Tests_SRS_COMMAND_DECODER_02_023: [ If any of the previous operations fail, then CommandDecoder_ExecuteMethod shall return NULL. ]*/
     TEST_FUNCTION(CommandDecoder_ExecuteMethod_with_NULL_payload_unhapy_paths)
     {
@@ -3570,7 +3789,8 @@ BEGIN_TEST_SUITE(CommandDecoder_ut)
         for (size_t i = 0; i < umock_c_negative_tests_call_count(); i++)
         {
             if (
-                (i!=5) /*gballoc_free*/
+                (i != 5) && /*gballoc_malloc*/
+                (i != 6) /*gballoc_free*/
                 )
             {
                 umock_c_negative_tests_reset();
@@ -3631,6 +3851,14 @@ BEGIN_TEST_SUITE(CommandDecoder_ut)
 
         STRICT_EXPECTED_CALL(methodCallbackMock(TEST_CALLBACK_CONTEXT_VALUE, "", "methodA", 1, IGNORED_PTR_ARG))
             .IgnoreArgument_parameterValues();
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is the route remembered for the method*/
+            .IgnoreArgument_size();
+        STRICT_EXPECTED_CALL(Schema_GetModelMethodArgumentByIndex(TEST_MODEL_METHOD_HANDLE, 0))
+            .SetReturn(TEST_METHOD_ARGUMENT_HANDLE_0);
+        STRICT_EXPECTED_CALL(Schema_GetMethodArgumentName(TEST_METHOD_ARGUMENT_HANDLE_0))
+            .SetReturn("a");
+        STRICT_EXPECTED_CALL(Schema_GetMethodArgumentType(TEST_METHOD_ARGUMENT_HANDLE_0))
+            .SetReturn("int");
 
         STRICT_EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG))
             .IgnoreArgument_agentData();
@@ -3680,6 +3908,60 @@ BEGIN_TEST_SUITE(CommandDecoder_ut)
     }
 
 
+    /*Tests_SRS_COMMAND_DECODER_41_007: [ When a remembered path is dispatched again, CommandDecoder shall decode the arguments and call the callback using the remembered route, without splitting the path and without Schema lookups. ]*/
+    TEST_FUNCTION(CommandDecoder_ExecuteMethod_with_1_arg_payload_the_second_time_uses_the_remembered_route)
+    {
+        ///arrange
+        size_t one = 1;
+        const char* aValue = "2";
+        const char* methodPayload = "{\"a\":2}";
+        COMMAND_DECODER_HANDLE commandDecoderHandle = CommandDecoder_Create(TEST_MODEL_HANDLE, ActionCallbackMock, TEST_CALLBACK_CONTEXT_VALUE, methodCallbackMock, TEST_CALLBACK_CONTEXT_VALUE);
+        umock_c_reset_all_calls();
+        CommandDecoder_ExecuteMethod_with_1_arg_payload_inert_path(&one, methodPayload, &aValue);
+        (void)CommandDecoder_ExecuteMethod(commandDecoderHandle, "methodA", methodPayload);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, methodPayload))
+            .IgnoreArgument_destination();
+        STRICT_EXPECTED_CALL(JSONDecoder_JSON_To_MultiTree(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_json()
+            .IgnoreArgument_multiTreeHandle();
+        STRICT_EXPECTED_CALL(Schema_GetSchemaForModelType(TEST_MODEL_HANDLE));
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is the array holding 1 x AGENT_DATA_TYPE */
+            .IgnoreArgument_size();
+        STRICT_EXPECTED_CALL(MultiTree_GetChildByName(IGNORED_PTR_ARG, "a", IGNORED_PTR_ARG))
+            .IgnoreArgument_treeHandle()
+            .IgnoreArgument_childHandle();
+        STRICT_EXPECTED_CALL(CodeFirst_GetPrimitiveType("int"))
+            .SetReturn(EDM_INT32_TYPE);
+        STRICT_EXPECTED_CALL(MultiTree_GetValue(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_treeHandle()
+            .IgnoreArgument_destination()
+            .CopyOutArgumentBuffer_destination(&aValue, sizeof(aValue));
+        STRICT_EXPECTED_CALL(CreateAgentDataType_From_String("2", EDM_INT32_TYPE, IGNORED_PTR_ARG))
+            .IgnoreArgument_agentData();
+        STRICT_EXPECTED_CALL(methodCallbackMock(TEST_CALLBACK_CONTEXT_VALUE, "", "methodA", 1, IGNORED_PTR_ARG))
+            .IgnoreArgument_parameterValues();
+        STRICT_EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG))
+            .IgnoreArgument_agentData();
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument_ptr();
+        STRICT_EXPECTED_CALL(MultiTree_Destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument_treeHandle();
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument_ptr();
+
+        ///act
+        METHODRETURN_HANDLE methodReturn = CommandDecoder_ExecuteMethod(commandDecoderHandle, "methodA", methodPayload);
+
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(void_ptr, g_methodReturnValue, methodReturn);
+
+        ///cleanup
+        CommandDecoder_Destroy(commandDecoderHandle);
+    }
+
     /*Tests_SRS_COMMAND_DECODER_02_023: [ If any of the previous operations fail, then CommandDecoder_ExecuteMethod shall return NULL. ]*/
     TEST_FUNCTION(CommandDecoder_ExecuteMethod_with_1_arg_payload_unhapy_paths)
     {
@@ -3699,12 +3981,16 @@ BEGIN_TEST_SUITE(CommandDecoder_ut)
         for (size_t i = 0; i < umock_c_negative_tests_call_count(); i++)
         {
             if (
-                (i != 11)&& /*gballoc_free*/
-                (i != 15) && /*Destroy_AGENT_DATA_TYPE*/
-                (i != 16) && /*gballoc_free*/
-                (i != 17) && /*gballoc_free*/
-                (i != 18) && /*MultiTree_Destroy*/
-                (i != 19)  /*gballoc_free*/
+                (i != 11) && /*CodeFirst_GetPrimitiveType*/
+                (i != 15) && /*gballoc_malloc*/
+                (i != 16) && /*Schema_GetModelMethodArgumentByIndex*/
+                (i != 17) && /*Schema_GetMethodArgumentName*/
+                (i != 18) && /*Schema_GetMethodArgumentType*/
+                (i != 19) && /*Destroy_AGENT_DATA_TYPE*/
+                (i != 20) && /*gballoc_free*/
+                (i != 21) && /*gballoc_free*/
+                (i != 22) && /*MultiTree_Destroy*/
+                (i != 23) /*gballoc_free*/
                 )
             {
                 umock_c_negative_tests_reset();
@@ -3790,6 +4076,20 @@ BEGIN_TEST_SUITE(CommandDecoder_ut)
 
         STRICT_EXPECTED_CALL(methodCallbackMock(TEST_CALLBACK_CONTEXT_VALUE, "", "methodA", 2, IGNORED_PTR_ARG))
             .IgnoreArgument_parameterValues();
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is the route remembered for the method*/
+            .IgnoreArgument_size();
+        STRICT_EXPECTED_CALL(Schema_GetModelMethodArgumentByIndex(TEST_MODEL_METHOD_HANDLE, 0))
+            .SetReturn(TEST_METHOD_ARGUMENT_HANDLE_0);
+        STRICT_EXPECTED_CALL(Schema_GetMethodArgumentName(TEST_METHOD_ARGUMENT_HANDLE_0))
+            .SetReturn("a");
+        STRICT_EXPECTED_CALL(Schema_GetMethodArgumentType(TEST_METHOD_ARGUMENT_HANDLE_0))
+            .SetReturn("int");
+        STRICT_EXPECTED_CALL(Schema_GetModelMethodArgumentByIndex(TEST_MODEL_METHOD_HANDLE, 1))
+            .SetReturn(TEST_METHOD_ARGUMENT_HANDLE_1);
+        STRICT_EXPECTED_CALL(Schema_GetMethodArgumentName(TEST_METHOD_ARGUMENT_HANDLE_1))
+            .SetReturn("b");
+        STRICT_EXPECTED_CALL(Schema_GetMethodArgumentType(TEST_METHOD_ARGUMENT_HANDLE_1))
+            .SetReturn("int");
 
         STRICT_EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG))
             .IgnoreArgument_agentData();
@@ -3863,12 +4163,19 @@ BEGIN_TEST_SUITE(CommandDecoder_ut)
         {
             if (
                 (i != 11) && /*CodeFirst_GetPrimitiveType*/
-                (i != 22) && /*Destroy_AGENT_DATA_TYPE*/
-                (i != 23) && /*gballoc_free*/
-                (i != 24) && /*gballoc_free*/
-                (i != 25) && /*MultiTree_Destroy*/
-                (i != 26) && /*MultiTree_Destroy*/
-                (i != 27)  /*gballoc_free*/
+                (i != 22) && /*gballoc_malloc*/
+                (i != 23) && /*Schema_GetModelMethodArgumentByIndex*/
+                (i != 24) && /*Schema_GetMethodArgumentName*/
+                (i != 25) && /*Schema_GetMethodArgumentType*/
+                (i != 26) && /*Schema_GetModelMethodArgumentByIndex*/
+                (i != 27) && /*Schema_GetMethodArgumentName*/
+                (i != 28) && /*Schema_GetMethodArgumentType*/
+                (i != 29) && /*Destroy_AGENT_DATA_TYPE*/
+                (i != 30) && /*Destroy_AGENT_DATA_TYPE*/
+                (i != 31) && /*gballoc_free*/
+                (i != 32) && /*gballoc_free*/
+                (i != 33) && /*MultiTree_Destroy*/
+                (i != 34) /*gballoc_free*/
                 )
             {
                 umock_c_negative_tests_reset();
@@ -3959,6 +4266,20 @@ BEGIN_TEST_SUITE(CommandDecoder_ut)
 
         STRICT_EXPECTED_CALL(methodCallbackMock(TEST_CALLBACK_CONTEXT_VALUE, "innermodel", "methodA", 2, IGNORED_PTR_ARG))
             .IgnoreArgument_parameterValues();
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)) /*this is the route remembered for the method*/
+            .IgnoreArgument_size();
+        STRICT_EXPECTED_CALL(Schema_GetModelMethodArgumentByIndex(TEST_MODEL_METHOD_HANDLE, 0))
+            .SetReturn(TEST_METHOD_ARGUMENT_HANDLE_0);
+        STRICT_EXPECTED_CALL(Schema_GetMethodArgumentName(TEST_METHOD_ARGUMENT_HANDLE_0))
+            .SetReturn("a");
+        STRICT_EXPECTED_CALL(Schema_GetMethodArgumentType(TEST_METHOD_ARGUMENT_HANDLE_0))
+            .SetReturn("int");
+        STRICT_EXPECTED_CALL(Schema_GetModelMethodArgumentByIndex(TEST_MODEL_METHOD_HANDLE, 1))
+            .SetReturn(TEST_METHOD_ARGUMENT_HANDLE_1);
+        STRICT_EXPECTED_CALL(Schema_GetMethodArgumentName(TEST_METHOD_ARGUMENT_HANDLE_1))
+            .SetReturn("b");
+        STRICT_EXPECTED_CALL(Schema_GetMethodArgumentType(TEST_METHOD_ARGUMENT_HANDLE_1))
+            .SetReturn("int");
 
         STRICT_EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG))
             .IgnoreArgument_agentData();
@@ -4031,15 +4352,21 @@ BEGIN_TEST_SUITE(CommandDecoder_ut)
         for (size_t i = 0; i < umock_c_negative_tests_call_count(); i++)
         {
             if (
-                (i!=5)  && /*gballoc_free*/
-                (i != 15) && /*CodeFirst_GetPrimitiveType*/
-                (i != 25) && /*CodeFirst_GetPrimitiveType*/
-                (i != 26) && /*Destroy_AGENT_DATA_TYPE*/
-                (i != 27) && /*gballoc_free*/
-                (i != 28) && /*gballoc_free*/
-                (i != 29) && /*MultiTree_Destroy*/
-                (i != 30) && /*MultiTree_Destroy*/
-                (i != 31)  /*gballoc_free*/
+                (i != 5) && /*gballoc_free*/
+                (i != 15) && /*MultiTree_GetValue*/
+                (i != 25) && /*gballoc_malloc*/
+                (i != 26) && /*Schema_GetModelMethodArgumentByIndex*/
+                (i != 27) && /*Schema_GetMethodArgumentName*/
+                (i != 28) && /*Schema_GetMethodArgumentType*/
+                (i != 29) && /*Schema_GetModelMethodArgumentByIndex*/
+                (i != 30) && /*Schema_GetMethodArgumentName*/
+                (i != 31) && /*Schema_GetMethodArgumentType*/
+                (i != 32) && /*Destroy_AGENT_DATA_TYPE*/
+                (i != 33) && /*Destroy_AGENT_DATA_TYPE*/
+                (i != 34) && /*gballoc_free*/
+                (i != 35) && /*gballoc_free*/
+                (i != 36) && /*MultiTree_Destroy*/
+                (i != 37) /*gballoc_free*/
                 )
             {
                 umock_c_negative_tests_reset();
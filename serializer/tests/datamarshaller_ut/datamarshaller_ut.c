@@ -162,6 +162,12 @@ static AGENT_DATA_TYPES_RESULT my_AgentDataTypes_ToString(STRING_HANDLE destinat
     return AGENT_DATA_TYPES_OK;
 }
 
+static AGENT_DATA_TYPES_RESULT my_AgentDataTypes_ToString_by_type(STRING_HANDLE destination, const AGENT_DATA_TYPE* value)
+{
+    (void)real_STRING_concat(destination, (value->type == EDM_INT32_TYPE) ? "10" : "2.4");
+    return AGENT_DATA_TYPES_OK;
+}
+
 static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
 {
     char temp_str[256];
@@ -200,6 +206,7 @@ BEGIN_TEST_SUITE(DataMarshaller_ut)
         REGISTER_UMOCK_ALIAS_TYPE(JSON_ENCODER_TOSTRING_FUNC, void*);
         REGISTER_UMOCK_ALIAS_TYPE(VECTOR_HANDLE, void*);
         REGISTER_UMOCK_ALIAS_TYPE(const VECTOR_HANDLE, void*);
+        REGISTER_UMOCK_ALIAS_TYPE(SCHEMA_MODEL_TYPE_HANDLE, void*);
 
         REGISTER_UMOCK_ALIAS_TYPE(MULTITREE_RESULT, int);
         REGISTER_UMOCK_ALIAS_TYPE(DATA_MARSHALLER_RESULT, int);
@@ -213,6 +220,8 @@ BEGIN_TEST_SUITE(DataMarshaller_ut)
         REGISTER_GLOBAL_MOCK_HOOK(AgentDataTypes_ToString, my_AgentDataTypes_ToString);
         REGISTER_GLOBAL_MOCK_FAIL_RETURN(AgentDataTypes_ToString, AGENT_DATA_TYPES_ERROR);
 
+        REGISTER_GLOBAL_MOCK_RETURN(Schema_ModelPropertyByPathExists, true);
+
         REGISTER_GLOBAL_MOCK_HOOK(VECTOR_create, real_VECTOR_create);
         REGISTER_GLOBAL_MOCK_HOOK(VECTOR_destroy, real_VECTOR_destroy);
         REGISTER_GLOBAL_MOCK_HOOK(VECTOR_push_back, real_VECTOR_push_back);
@@ -1017,6 +1026,353 @@ BEGIN_TEST_SUITE(DataMarshaller_ut)
         DataMarshaller_Destroy(handle);
     }
 
+    /*Tests_SRS_DATA_MARSHALLER_41_001: [ If dataMarshallerHandle, values, destination or destinationSize is NULL, or valueCount is zero, DataMarshaller_SendDataToBuffer shall fail and return DATA_MARSHALLER_INVALID_ARG. ]*/
+    TEST_FUNCTION(DataMarshaller_SendDataToBuffer_with_NULL_destination_fails)
+    {
+        ///arrange
+        DATA_MARSHALLER_HANDLE handle = DataMarshaller_Create(TEST_MODEL_HANDLE, true);
+        size_t destinationSize;
+        DATA_MARSHALLER_VALUE value = { DEFAULT_PROPERTY_NAME, &floatValid };
+        umock_c_reset_all_calls();
+
+        ///act
+        DATA_MARSHALLER_RESULT result = DataMarshaller_SendDataToBuffer(handle, 1, &value, NULL, 10, &destinationSize);
+
+        ///assert
+        ASSERT_ARE_EQUAL(DATA_MARSHALLER_RESULT, DATA_MARSHALLER_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        DataMarshaller_Destroy(handle);
+    }
+
+    /*Tests_SRS_DATA_MARSHALLER_41_003: [ DataMarshaller_SendDataToBuffer shall copy the encoded JSON to destination and its length to *destinationSize, and return DATA_MARSHALLER_OK. ]*/
+    /*Tests_SRS_DATA_MARSHALLER_41_004: [ Otherwise DataMarshaller_SendDataToBuffer shall encode the values the same way as DataMarshaller_SendData. ]*/
+    TEST_FUNCTION(DataMarshaller_SendDataToBuffer_copies_the_JSON_to_destination)
+    {
+        ///arrange
+        DATA_MARSHALLER_HANDLE handle = DataMarshaller_Create(TEST_MODEL_HANDLE, true);
+        unsigned char destination[10];
+        size_t destinationSize;
+        DATA_MARSHALLER_VALUE value = { DEFAULT_PROPERTY_NAME, &floatValid };
+        char json_payload[] = "Test";
+        umock_c_reset_all_calls();
+
+        EXPECTED_CALL(MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(MultiTree_AddLeaf(IGNORED_PTR_ARG, DEFAULT_PROPERTY_NAME, &floatValid))
+            .IgnoreArgument_treeHandle();
+        EXPECTED_CALL(STRING_new());
+        EXPECTED_CALL(JSONEncoder_EncodeTree(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_treeHandle()
+            .IgnoreArgument_destination()
+            .IgnoreArgument_toStringFunc();
+        EXPECTED_CALL(STRING_length(IGNORED_PTR_ARG))
+            .SetReturn(strlen(json_payload));
+        EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG))
+            .SetReturn(json_payload);
+        EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(MultiTree_Destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument_treeHandle();
+
+        ///act
+        DATA_MARSHALLER_RESULT result = DataMarshaller_SendDataToBuffer(handle, 1, &value, destination, sizeof(destination), &destinationSize);
+
+        ///assert
+        ASSERT_ARE_EQUAL(DATA_MARSHALLER_RESULT, DATA_MARSHALLER_OK, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(size_t, strlen(json_payload), destinationSize);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(destination, json_payload, destinationSize));
+
+        ///cleanup
+        DataMarshaller_Destroy(handle);
+    }
+
+    /*Tests_SRS_DATA_MARSHALLER_41_002: [ If the encoded JSON is longer than destinationCapacity then DataMarshaller_SendDataToBuffer shall fail and return DATA_MARSHALLER_BUFFER_TOO_SMALL. ]*/
+    TEST_FUNCTION(DataMarshaller_SendDataToBuffer_when_the_JSON_does_not_fit_fails)
+    {
+        ///arrange
+        DATA_MARSHALLER_HANDLE handle = DataMarshaller_Create(TEST_MODEL_HANDLE, true);
+        unsigned char destination[3];
+        size_t destinationSize;
+        DATA_MARSHALLER_VALUE value = { DEFAULT_PROPERTY_NAME, &floatValid };
+        char json_payload[] = "Test";
+        umock_c_reset_all_calls();
+
+        EXPECTED_CALL(MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(MultiTree_AddLeaf(IGNORED_PTR_ARG, DEFAULT_PROPERTY_NAME, &floatValid))
+            .IgnoreArgument_treeHandle();
+        EXPECTED_CALL(STRING_new());
+        EXPECTED_CALL(JSONEncoder_EncodeTree(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_treeHandle()
+            .IgnoreArgument_destination()
+            .IgnoreArgument_toStringFunc();
+        EXPECTED_CALL(STRING_length(IGNORED_PTR_ARG))
+            .SetReturn(strlen(json_payload));
+        EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(MultiTree_Destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument_treeHandle();
+
+        ///act
+        DATA_MARSHALLER_RESULT result = DataMarshaller_SendDataToBuffer(handle, 1, &value, destination, sizeof(destination), &destinationSize);
+
+        ///assert
+        ASSERT_ARE_EQUAL(DATA_MARSHALLER_RESULT, DATA_MARSHALLER_BUFFER_TOO_SMALL, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        DataMarshaller_Destroy(handle);
+    }
+
+    /*Tests_SRS_DATA_MARSHALLER_41_005: [ If dataMarshallerHandle or propertyPaths is NULL, or valueCount is zero, DataMarshaller_CreateLayout shall fail and return NULL. ]*/
+    TEST_FUNCTION(DataMarshaller_CreateLayout_with_NULL_dataMarshallerHandle_fails)
+    {
+        ///arrange
+        const char* paths[] = { DEFAULT_PROPERTY_NAME };
+
+        ///act
+        DATA_MARSHALLER_LAYOUT_HANDLE layout = DataMarshaller_CreateLayout(NULL, COUNT_OF(paths), paths);
+
+        ///assert
+        ASSERT_IS_NULL(layout);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /*Tests_SRS_DATA_MARSHALLER_41_005: [ If dataMarshallerHandle or propertyPaths is NULL, or valueCount is zero, DataMarshaller_CreateLayout shall fail and return NULL. ]*/
+    TEST_FUNCTION(DataMarshaller_CreateLayout_with_zero_valueCount_fails)
+    {
+        ///arrange
+        DATA_MARSHALLER_HANDLE handle = DataMarshaller_Create(TEST_MODEL_HANDLE, true);
+        const char* paths[] = { DEFAULT_PROPERTY_NAME };
+        umock_c_reset_all_calls();
+
+        ///act
+        DATA_MARSHALLER_LAYOUT_HANDLE layout = DataMarshaller_CreateLayout(handle, 0, paths);
+
+        ///assert
+        ASSERT_IS_NULL(layout);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        DataMarshaller_Destroy(handle);
+    }
+
+    /*Tests_SRS_DATA_MARSHALLER_41_006: [ DataMarshaller_CreateLayout shall check that every path is the path of a property of the model by calling Schema_ModelPropertyByPathExists, and fail and return NULL if one is not. ]*/
+    TEST_FUNCTION(DataMarshaller_CreateLayout_when_a_path_is_not_a_property_of_the_model_fails)
+    {
+        ///arrange
+        DATA_MARSHALLER_HANDLE handle = DataMarshaller_Create(TEST_MODEL_HANDLE, true);
+        const char* paths[] = { DEFAULT_PROPERTY_NAME, DEFAULT_PROPERTY_NAME_2 };
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(Schema_ModelPropertyByPathExists(TEST_MODEL_HANDLE, DEFAULT_PROPERTY_NAME));
+        STRICT_EXPECTED_CALL(Schema_ModelPropertyByPathExists(TEST_MODEL_HANDLE, DEFAULT_PROPERTY_NAME_2))
+            .SetReturn(false);
+
+        ///act
+        DATA_MARSHALLER_LAYOUT_HANDLE layout = DataMarshaller_CreateLayout(handle, COUNT_OF(paths), paths);
+
+        ///assert
+        ASSERT_IS_NULL(layout);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        DataMarshaller_Destroy(handle);
+    }
+
+    /*Tests_SRS_DATA_MARSHALLER_41_007: [ If a path holds an empty name, or a path is given twice or is also the start of another path, DataMarshaller_CreateLayout shall fail and return NULL. ]*/
+    TEST_FUNCTION(DataMarshaller_CreateLayout_with_a_path_given_twice_fails)
+    {
+        ///arrange
+        DATA_MARSHALLER_HANDLE handle = DataMarshaller_Create(TEST_MODEL_HANDLE, true);
+        const char* paths[] = { DEFAULT_PROPERTY_NAME, DEFAULT_PROPERTY_NAME_2, DEFAULT_PROPERTY_NAME };
+
+        ///act
+        DATA_MARSHALLER_LAYOUT_HANDLE layout = DataMarshaller_CreateLayout(handle, COUNT_OF(paths), paths);
+
+        ///assert
+        ASSERT_IS_NULL(layout);
+
+        ///cleanup
+        DataMarshaller_Destroy(handle);
+    }
+
+    /*Tests_SRS_DATA_MARSHALLER_41_007: [ If a path holds an empty name, or a path is given twice or is also the start of another path, DataMarshaller_CreateLayout shall fail and return NULL. ]*/
+    TEST_FUNCTION(DataMarshaller_CreateLayout_with_a_path_that_starts_another_path_fails)
+    {
+        ///arrange
+        DATA_MARSHALLER_HANDLE handle = DataMarshaller_Create(TEST_MODEL_HANDLE, true);
+        const char* paths[] = { DEFAULT_PROPERTY_NAME_LEVEL2, "a" };
+
+        ///act
+        DATA_MARSHALLER_LAYOUT_HANDLE layout = DataMarshaller_CreateLayout(handle, COUNT_OF(paths), paths);
+
+        ///assert
+        ASSERT_IS_NULL(layout);
+
+        ///cleanup
+        DataMarshaller_Destroy(handle);
+    }
+
+    /*Tests_SRS_DATA_MARSHALLER_41_007: [ If a path holds an empty name, or a path is given twice or is also the start of another path, DataMarshaller_CreateLayout shall fail and return NULL. ]*/
+    TEST_FUNCTION(DataMarshaller_CreateLayout_with_an_empty_name_fails)
+    {
+        ///arrange
+        DATA_MARSHALLER_HANDLE handle = DataMarshaller_Create(TEST_MODEL_HANDLE, true);
+        const char* paths[] = { "a/" };
+
+        ///act
+        DATA_MARSHALLER_LAYOUT_HANDLE layout = DataMarshaller_CreateLayout(handle, COUNT_OF(paths), paths);
+
+        ///assert
+        ASSERT_IS_NULL(layout);
+
+        ///cleanup
+        DataMarshaller_Destroy(handle);
+    }
+
+    /*Tests_SRS_DATA_MARSHALLER_41_008: [ DataMarshaller_CreateLayout shall lay out the record as DataMarshaller_SendData would with includePropertyPath set to true and the values given in the order of propertyPaths, and return a non-NULL handle. ]*/
+    /*Tests_SRS_DATA_MARSHALLER_41_012: [ DataMarshaller_SendRecordToBuffer shall copy the text of the layout to destination, each value being placed at its path as encoded by AgentDataTypes_ToString, without looking up the schema or building a MultiTree. ]*/
+    /*Tests_SRS_DATA_MARSHALLER_41_016: [ On success DataMarshaller_SendRecordToBuffer shall set *destinationSize to the length of the record and return DATA_MARSHALLER_OK. ]*/
+    TEST_FUNCTION(DataMarshaller_SendRecordToBuffer_places_every_value_at_its_path)
+    {
+        ///arrange
+        static const char expectedRecord[] = "{\"a\":{\"b\":2.4, \"c\":2.4}, \"" DEFAULT_PROPERTY_NAME "\":10}";
+        DATA_MARSHALLER_HANDLE handle = DataMarshaller_Create(TEST_MODEL_HANDLE, false);
+        const char* paths[] = { DEFAULT_PROPERTY_NAME_LEVEL2, DEFAULT_PROPERTY_NAME, "a/c" };
+        AGENT_DATA_TYPE values[3];
+        unsigned char destination[64];
+        size_t destinationSize = 0;
+        DATA_MARSHALLER_LAYOUT_HANDLE layout = DataMarshaller_CreateLayout(handle, COUNT_OF(paths), paths);
+        values[0] = floatValid;
+        values[1] = intValid;
+        values[2] = floatValid;
+        REGISTER_GLOBAL_MOCK_HOOK(AgentDataTypes_ToString, my_AgentDataTypes_ToString_by_type);
+        umock_c_reset_all_calls();
+
+        ///act
+        DATA_MARSHALLER_RESULT result = DataMarshaller_SendRecordToBuffer(layout, values, destination, sizeof(destination), &destinationSize);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(layout);
+        ASSERT_ARE_EQUAL(DATA_MARSHALLER_RESULT, DATA_MARSHALLER_OK, result);
+        ASSERT_ARE_EQUAL(size_t, sizeof(expectedRecord) - 1, destinationSize);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(destination, expectedRecord, destinationSize));
+
+        ///cleanup
+        REGISTER_GLOBAL_MOCK_HOOK(AgentDataTypes_ToString, my_AgentDataTypes_ToString);
+        DataMarshaller_DestroyLayout(layout);
+        DataMarshaller_Destroy(handle);
+    }
+
+    /*Tests_SRS_DATA_MARSHALLER_41_012: [ DataMarshaller_SendRecordToBuffer shall copy the text of the layout to destination, each value being placed at its path as encoded by AgentDataTypes_ToString, without looking up the schema or building a MultiTree. ]*/
+    TEST_FUNCTION(DataMarshaller_SendRecordToBuffer_reuses_the_layout_for_every_record)
+    {
+        ///arrange
+        static const char expectedRecord[] = "{\"" DEFAULT_PROPERTY_NAME "\":2.4}";
+        DATA_MARSHALLER_HANDLE handle = DataMarshaller_Create(TEST_MODEL_HANDLE, true);
+        const char* paths[] = { DEFAULT_PROPERTY_NAME };
+        unsigned char destination[64];
+        size_t destinationSize = 0;
+        DATA_MARSHALLER_LAYOUT_HANDLE layout = DataMarshaller_CreateLayout(handle, COUNT_OF(paths), paths);
+        DATA_MARSHALLER_RESULT result;
+        umock_c_reset_all_calls();
+
+        ///act
+        (void)DataMarshaller_SendRecordToBuffer(layout, &floatValid, destination, sizeof(destination), &destinationSize);
+        result = DataMarshaller_SendRecordToBuffer(layout, &intValid, destination, sizeof(destination), &destinationSize);
+
+        ///assert
+        ASSERT_ARE_EQUAL(DATA_MARSHALLER_RESULT, DATA_MARSHALLER_OK, result);
+        ASSERT_ARE_EQUAL(size_t, sizeof(expectedRecord) - 1, destinationSize);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(destination, expectedRecord, destinationSize));
+
+        ///cleanup
+        DataMarshaller_DestroyLayout(layout);
+        DataMarshaller_Destroy(handle);
+    }
+
+    /*Tests_SRS_DATA_MARSHALLER_41_011: [ If layoutHandle, values, destination or destinationSize is NULL, DataMarshaller_SendRecordToBuffer shall fail and return DATA_MARSHALLER_INVALID_ARG. ]*/
+    TEST_FUNCTION(DataMarshaller_SendRecordToBuffer_with_NULL_values_fails)
+    {
+        ///arrange
+        DATA_MARSHALLER_HANDLE handle = DataMarshaller_Create(TEST_MODEL_HANDLE, true);
+        const char* paths[] = { DEFAULT_PROPERTY_NAME };
+        unsigned char destination[64];
+        size_t destinationSize;
+        DATA_MARSHALLER_LAYOUT_HANDLE layout = DataMarshaller_CreateLayout(handle, COUNT_OF(paths), paths);
+        umock_c_reset_all_calls();
+
+        ///act
+        DATA_MARSHALLER_RESULT result = DataMarshaller_SendRecordToBuffer(layout, NULL, destination, sizeof(destination), &destinationSize);
+
+        ///assert
+        ASSERT_ARE_EQUAL(DATA_MARSHALLER_RESULT, DATA_MARSHALLER_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        DataMarshaller_DestroyLayout(layout);
+        DataMarshaller_Destroy(handle);
+    }
+
+    /*Tests_SRS_DATA_MARSHALLER_41_013: [ If the record is longer than destinationCapacity, DataMarshaller_SendRecordToBuffer shall fail and return DATA_MARSHALLER_BUFFER_TOO_SMALL. ]*/
+    TEST_FUNCTION(DataMarshaller_SendRecordToBuffer_when_the_record_does_not_fit_fails)
+    {
+        ///arrange
+        DATA_MARSHALLER_HANDLE handle = DataMarshaller_Create(TEST_MODEL_HANDLE, true);
+        const char* paths[] = { DEFAULT_PROPERTY_NAME };
+        unsigned char destination[sizeof("{\"" DEFAULT_PROPERTY_NAME "\":2.4}") - 2];
+        size_t destinationSize;
+        DATA_MARSHALLER_LAYOUT_HANDLE layout = DataMarshaller_CreateLayout(handle, COUNT_OF(paths), paths);
+        umock_c_reset_all_calls();
+
+        ///act
+        DATA_MARSHALLER_RESULT result = DataMarshaller_SendRecordToBuffer(layout, &floatValid, destination, sizeof(destination), &destinationSize);
+
+        ///assert
+        ASSERT_ARE_EQUAL(DATA_MARSHALLER_RESULT, DATA_MARSHALLER_BUFFER_TOO_SMALL, result);
+
+        ///cleanup
+        DataMarshaller_DestroyLayout(layout);
+        DataMarshaller_Destroy(handle);
+    }
+
+    /*Tests_SRS_DATA_MARSHALLER_41_014: [ If AgentDataTypes_ToString fails, DataMarshaller_SendRecordToBuffer shall fail and return DATA_MARSHALLER_AGENT_DATA_TYPES_ERROR. ]*/
+    TEST_FUNCTION(DataMarshaller_SendRecordToBuffer_when_AgentDataTypes_ToString_fails_fails)
+    {
+        ///arrange
+        DATA_MARSHALLER_HANDLE handle = DataMarshaller_Create(TEST_MODEL_HANDLE, true);
+        const char* paths[] = { DEFAULT_PROPERTY_NAME };
+        unsigned char destination[64];
+        size_t destinationSize;
+        DATA_MARSHALLER_LAYOUT_HANDLE layout = DataMarshaller_CreateLayout(handle, COUNT_OF(paths), paths);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(AgentDataTypes_ToString(IGNORED_PTR_ARG, &floatValid))
+            .SetReturn(AGENT_DATA_TYPES_ERROR);
+
+        ///act
+        DATA_MARSHALLER_RESULT result = DataMarshaller_SendRecordToBuffer(layout, &floatValid, destination, sizeof(destination), &destinationSize);
+
+        ///assert
+        ASSERT_ARE_EQUAL(DATA_MARSHALLER_RESULT, DATA_MARSHALLER_AGENT_DATA_TYPES_ERROR, result);
+
+        ///cleanup
+        DataMarshaller_DestroyLayout(layout);
+        DataMarshaller_Destroy(handle);
+    }
+
+    /*Tests_SRS_DATA_MARSHALLER_41_010: [ DataMarshaller_DestroyLayout shall free all resources of the layout; it shall do nothing if layoutHandle is NULL. ]*/
+    TEST_FUNCTION(DataMarshaller_DestroyLayout_with_NULL_does_nothing)
+    {
+        ///arrange
+
+        ///act
+        DataMarshaller_DestroyLayout(NULL);
+
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
     /*Tests_SRS_DATA_MARSHALLER_02_021: [ If argument dataMarshallerHandle is NULL then DataMarshaller_SendData_ReportedProperties shall fail and return DATA_MARSHALLER_INVALID_ARG. ]*/
     TEST_FUNCTION(DataMarshaller_SendData_ReportedProperties_with_NULL_dataMarshallerHandle_fails)
     {
@@ -176,6 +176,7 @@ BEGIN_TEST_SUITE(DataPublisher_ut)
         REGISTER_GLOBAL_MOCK_HOOK(DataMarshaller_Create, my_DataMarshaller_Create);
         REGISTER_GLOBAL_MOCK_HOOK(DataMarshaller_SendData, my_DataMarshaller_SendData);
         REGISTER_GLOBAL_MOCK_RETURN(DataMarshaller_SendData_ReportedProperties, DATA_MARSHALLER_OK);
+        REGISTER_GLOBAL_MOCK_RETURN(DataMarshaller_SendDataToBuffer, DATA_MARSHALLER_OK);
         REGISTER_GLOBAL_MOCK_HOOK(DataMarshaller_Destroy, my_DataMarshaller_Destroy);
 
         REGISTER_GLOBAL_MOCK_RETURN(Schema_ModelPropertyByPathExists, true);
@@ -1044,6 +1045,259 @@ BEGIN_TEST_SUITE(DataPublisher_ut)
         DataPublisher_Destroy(handle);
     }
 
+    /* DataPublisher_ResetTransaction */
+
+    /* Tests_SRS_DATA_PUBLISHER_41_001: [ If the transactionHandle argument is NULL, DataPublisher_ResetTransaction shall return DATA_PUBLISHER_INVALID_ARG. ]*/
+    TEST_FUNCTION(DataPublisher_ResetTransaction_With_A_NULL_Transaction_Fails)
+    {
+        // arrange
+
+        // act
+        DATA_PUBLISHER_RESULT result = DataPublisher_ResetTransaction(NULL);
+
+        // assert
+        ASSERT_ARE_EQUAL(DATA_PUBLISHER_RESULT, DATA_PUBLISHER_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /* Tests_SRS_DATA_PUBLISHER_41_002: [ DataPublisher_ResetTransaction shall discard the values associated with the transaction, keep their memory and property paths for the next values and return DATA_PUBLISHER_OK. ]*/
+    TEST_FUNCTION(DataPublisher_ResetTransaction_Destroys_The_Values_And_Keeps_Their_Memory)
+    {
+        // arrange
+        DATA_PUBLISHER_HANDLE handle = DataPublisher_Create(TEST_SCHEMA_MODEL_TYPE_HANDLE, true);
+        TRANSACTION_HANDLE transaction = DataPublisher_StartTransaction(handle);
+        (void)DataPublisher_PublishTransacted(transaction, PropertyPath, &data);
+        umock_c_reset_all_calls();
+
+        EXPECTED_CALL(Destroy_AGENT_DATA_TYPE(IGNORED_PTR_ARG));
+
+        // act
+        DATA_PUBLISHER_RESULT result = DataPublisher_ResetTransaction(transaction);
+
+        // assert
+        ASSERT_ARE_EQUAL(DATA_PUBLISHER_RESULT, DATA_PUBLISHER_OK, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        // cleanup
+        (void)DataPublisher_CancelTransaction(transaction);
+        DataPublisher_Destroy(handle);
+    }
+
+    /* Tests_SRS_DATA_PUBLISHER_41_003: [ If a slot for propertyPath was kept by DataPublisher_ResetTransaction, DataPublisher_PublishTransacted shall copy data into that slot without allocating memory. ]*/
+    TEST_FUNCTION(DataPublisher_PublishTransacted_After_ResetTransaction_Does_Not_Allocate)
+    {
+        // arrange
+        DATA_PUBLISHER_HANDLE handle = DataPublisher_Create(TEST_SCHEMA_MODEL_TYPE_HANDLE, true);
+        TRANSACTION_HANDLE transaction = DataPublisher_StartTransaction(handle);
+        (void)DataPublisher_PublishTransacted(transaction, PropertyPath, &data);
+        (void)DataPublisher_ResetTransaction(transaction);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(Create_AGENT_DATA_TYPE_from_AGENT_DATA_TYPE(IGNORED_PTR_ARG, &data))
+            .IgnoreArgument(1);
+
+        // act
+        DATA_PUBLISHER_RESULT result = DataPublisher_PublishTransacted(transaction, PropertyPath, &data);
+
+        // assert
+        ASSERT_ARE_EQUAL(DATA_PUBLISHER_RESULT, DATA_PUBLISHER_OK, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        // cleanup
+        (void)DataPublisher_CancelTransaction(transaction);
+        DataPublisher_Destroy(handle);
+    }
+
+    /* Tests_SRS_DATA_PUBLISHER_99_015:[ DataPublisher_CancelTransaction shall dispose of any resources associated with the transaction.] */
+    TEST_FUNCTION(DataPublisher_CancelTransaction_After_ResetTransaction_Frees_The_Kept_Slots)
+    {
+        // arrange
+        DATA_PUBLISHER_HANDLE handle = DataPublisher_Create(TEST_SCHEMA_MODEL_TYPE_HANDLE, true);
+        TRANSACTION_HANDLE transaction = DataPublisher_StartTransaction(handle);
+        (void)DataPublisher_PublishTransacted(transaction, PropertyPath, &data);
+        (void)DataPublisher_ResetTransaction(transaction);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument_ptr();
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument_ptr();
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument_ptr();
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument_ptr();
+
+        // act
+        DATA_PUBLISHER_RESULT result = DataPublisher_CancelTransaction(transaction);
+
+        // assert
+        ASSERT_ARE_EQUAL(DATA_PUBLISHER_RESULT, DATA_PUBLISHER_OK, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        // cleanup
+        DataPublisher_Destroy(handle);
+    }
+
+    /* DataPublisher_EndTransactionToBuffer */
+
+    /* Tests_SRS_DATA_PUBLISHER_41_005: [ If transactionHandle, destination or destinationSize is NULL, DataPublisher_EndTransactionToBuffer shall return DATA_PUBLISHER_INVALID_ARG. ]*/
+    TEST_FUNCTION(DataPublisher_EndTransactionToBuffer_With_NULL_destination_Fails)
+    {
+        // arrange
+        DATA_PUBLISHER_HANDLE handle = DataPublisher_Create(TEST_SCHEMA_MODEL_TYPE_HANDLE, true);
+        TRANSACTION_HANDLE transaction = DataPublisher_StartTransaction(handle);
+        size_t destinationSize;
+        (void)DataPublisher_PublishTransacted(transaction, PropertyPath, &data);
+        umock_c_reset_all_calls();
+
+        // act
+        DATA_PUBLISHER_RESULT result = DataPublisher_EndTransactionToBuffer(transaction, NULL, 10, &destinationSize);
+
+        // assert
+        ASSERT_ARE_EQUAL(DATA_PUBLISHER_RESULT, DATA_PUBLISHER_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        // cleanup
+        (void)DataPublisher_CancelTransaction(transaction);
+        DataPublisher_Destroy(handle);
+    }
+
+    /* Tests_SRS_DATA_PUBLISHER_41_006: [ If no values have been associated with the transaction, DataPublisher_EndTransactionToBuffer shall return DATA_PUBLISHER_EMPTY_TRANSACTION. ]*/
+    TEST_FUNCTION(DataPublisher_EndTransactionToBuffer_With_An_Empty_Transaction_Fails)
+    {
+        // arrange
+        DATA_PUBLISHER_HANDLE handle = DataPublisher_Create(TEST_SCHEMA_MODEL_TYPE_HANDLE, true);
+        TRANSACTION_HANDLE transaction = DataPublisher_StartTransaction(handle);
+        unsigned char destination[10];
+        size_t destinationSize;
+        umock_c_reset_all_calls();
+
+        // act
+        DATA_PUBLISHER_RESULT result = DataPublisher_EndTransactionToBuffer(transaction, destination, sizeof(destination), &destinationSize);
+
+        // assert
+        ASSERT_ARE_EQUAL(DATA_PUBLISHER_RESULT, DATA_PUBLISHER_EMPTY_TRANSACTION, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        // cleanup
+        (void)DataPublisher_CancelTransaction(transaction);
+        DataPublisher_Destroy(handle);
+    }
+
+    /* Tests_SRS_DATA_PUBLISHER_41_007: [ DataPublisher_EndTransactionToBuffer shall call DataMarshaller_SendDataToBuffer passing as capacity the smaller of destinationCapacity and the max buffer size. ]*/
+    /* Tests_SRS_DATA_PUBLISHER_41_010: [ On success, DataPublisher_EndTransactionToBuffer shall return DATA_PUBLISHER_OK. ]*/
+    /* Tests_SRS_DATA_PUBLISHER_41_011: [ DataPublisher_EndTransactionToBuffer shall not dispose of the transaction. ]*/
+    TEST_FUNCTION(DataPublisher_EndTransactionToBuffer_With_One_Value_Dispatches_The_Value)
+    {
+        // arrange
+        DATA_PUBLISHER_HANDLE handle = DataPublisher_Create(TEST_SCHEMA_MODEL_TYPE_HANDLE, true);
+        TRANSACTION_HANDLE transaction = DataPublisher_StartTransaction(handle);
+        unsigned char destination[10];
+        size_t destinationSize;
+        (void)DataPublisher_PublishTransacted(transaction, PropertyPath, &data);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(DataMarshaller_SendDataToBuffer(IGNORED_PTR_ARG, 1, IGNORED_PTR_ARG, destination, sizeof(destination), &destinationSize))
+            .IgnoreArgument_dataMarshallerHandle()
+            .IgnoreArgument_values();
+
+        // act
+        DATA_PUBLISHER_RESULT result = DataPublisher_EndTransactionToBuffer(transaction, destination, sizeof(destination), &destinationSize);
+
+        // assert
+        ASSERT_ARE_EQUAL(DATA_PUBLISHER_RESULT, DATA_PUBLISHER_OK, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        // cleanup
+        (void)DataPublisher_CancelTransaction(transaction);
+        DataPublisher_Destroy(handle);
+    }
+
+    /* Tests_SRS_DATA_PUBLISHER_41_007: [ DataPublisher_EndTransactionToBuffer shall call DataMarshaller_SendDataToBuffer passing as capacity the smaller of destinationCapacity and the max buffer size. ]*/
+    TEST_FUNCTION(DataPublisher_EndTransactionToBuffer_Caps_The_Capacity_At_The_Max_Buffer_Size)
+    {
+        // arrange
+        DATA_PUBLISHER_HANDLE handle = DataPublisher_Create(TEST_SCHEMA_MODEL_TYPE_HANDLE, true);
+        TRANSACTION_HANDLE transaction = DataPublisher_StartTransaction(handle);
+        unsigned char destination[10];
+        size_t destinationSize;
+        (void)DataPublisher_PublishTransacted(transaction, PropertyPath, &data);
+        DataPublisher_SetMaxBufferSize(4);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(DataMarshaller_SendDataToBuffer(IGNORED_PTR_ARG, 1, IGNORED_PTR_ARG, destination, 4, &destinationSize))
+            .IgnoreArgument_dataMarshallerHandle()
+            .IgnoreArgument_values();
+
+        // act
+        DATA_PUBLISHER_RESULT result = DataPublisher_EndTransactionToBuffer(transaction, destination, sizeof(destination), &destinationSize);
+
+        // assert
+        ASSERT_ARE_EQUAL(DATA_PUBLISHER_RESULT, DATA_PUBLISHER_OK, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        // cleanup
+        DataPublisher_SetMaxBufferSize(10 * 1024);
+        (void)DataPublisher_CancelTransaction(transaction);
+        DataPublisher_Destroy(handle);
+    }
+
+    /* Tests_SRS_DATA_PUBLISHER_41_008: [ If DataMarshaller_SendDataToBuffer returns DATA_MARSHALLER_BUFFER_TOO_SMALL, DataPublisher_EndTransactionToBuffer shall return DATA_PUBLISHER_BUFFER_STORAGE_ERROR. ]*/
+    TEST_FUNCTION(DataPublisher_When_DataMarshaller_SendDataToBuffer_Runs_Out_Of_Space_Then_EndTransactionToBuffer_Fails)
+    {
+        // arrange
+        DATA_PUBLISHER_HANDLE handle = DataPublisher_Create(TEST_SCHEMA_MODEL_TYPE_HANDLE, true);
+        TRANSACTION_HANDLE transaction = DataPublisher_StartTransaction(handle);
+        unsigned char destination[10];
+        size_t destinationSize;
+        (void)DataPublisher_PublishTransacted(transaction, PropertyPath, &data);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(DataMarshaller_SendDataToBuffer(IGNORED_PTR_ARG, 1, IGNORED_PTR_ARG, destination, sizeof(destination), &destinationSize))
+            .IgnoreArgument_dataMarshallerHandle()
+            .IgnoreArgument_values()
+            .SetReturn(DATA_MARSHALLER_BUFFER_TOO_SMALL);
+
+        // act
+        DATA_PUBLISHER_RESULT result = DataPublisher_EndTransactionToBuffer(transaction, destination, sizeof(destination), &destinationSize);
+
+        // assert
+        ASSERT_ARE_EQUAL(DATA_PUBLISHER_RESULT, DATA_PUBLISHER_BUFFER_STORAGE_ERROR, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        // cleanup
+        (void)DataPublisher_CancelTransaction(transaction);
+        DataPublisher_Destroy(handle);
+    }
+
+    /* Tests_SRS_DATA_PUBLISHER_41_009: [ If DataMarshaller_SendDataToBuffer fails for any other reason, DataPublisher_EndTransactionToBuffer shall return DATA_PUBLISHER_MARSHALLER_ERROR. ]*/
+    TEST_FUNCTION(DataPublisher_When_DataMarshaller_SendDataToBuffer_Fails_Then_EndTransactionToBuffer_Fails)
+    {
+        // arrange
+        DATA_PUBLISHER_HANDLE handle = DataPublisher_Create(TEST_SCHEMA_MODEL_TYPE_HANDLE, true);
+        TRANSACTION_HANDLE transaction = DataPublisher_StartTransaction(handle);
+        unsigned char destination[10];
+        size_t destinationSize;
+        (void)DataPublisher_PublishTransacted(transaction, PropertyPath, &data);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(DataMarshaller_SendDataToBuffer(IGNORED_PTR_ARG, 1, IGNORED_PTR_ARG, destination, sizeof(destination), &destinationSize))
+            .IgnoreArgument_dataMarshallerHandle()
+            .IgnoreArgument_values()
+            .SetReturn(DATA_MARSHALLER_ERROR);
+
+        // act
+        DATA_PUBLISHER_RESULT result = DataPublisher_EndTransactionToBuffer(transaction, destination, sizeof(destination), &destinationSize);
+
+        // assert
+        ASSERT_ARE_EQUAL(DATA_PUBLISHER_RESULT, DATA_PUBLISHER_MARSHALLER_ERROR, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        // cleanup
+        (void)DataPublisher_CancelTransaction(transaction);
+        DataPublisher_Destroy(handle);
+    }
+
     /* Tests_SRS_DATA_PUBLISHER_99_067:[ Before any call to DataPublisher_SetMaxBufferSize, the default max buffer size shall be equal to 10KB.] */
     TEST_FUNCTION(DataPublisher_default_max_buffer_size_should_be_10KB)
     {
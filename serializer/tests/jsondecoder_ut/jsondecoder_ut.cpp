@@ -20,7 +20,7 @@ TYPED_MOCK_CLASS(CJSONDecoderMocks, CGlobalMock)
 {
 public:
     /* MultiTree mocks */
-    MOCK_STATIC_METHOD_2(, MULTITREE_HANDLE, MultiTree_Create, MULTITREE_CLONE_FUNCTION, cloneFunction, MULTITREE_FREE_FUNCTION, freeFunction)
+    MOCK_STATIC_METHOD_3(, MULTITREE_HANDLE, MultiTree_CreateInArena, MULTITREE_CLONE_FUNCTION, cloneFunction, size_t, expectedNodes, size_t, expectedNameBytes)
     MOCK_METHOD_END(MULTITREE_HANDLE, TestMultiTreeHandle)
     MOCK_STATIC_METHOD_1(, void, MultiTree_Destroy, MULTITREE_HANDLE, treeHandle)
     MOCK_VOID_METHOD_END()
@@ -30,7 +30,7 @@ public:
     MOCK_METHOD_END(MULTITREE_RESULT, MULTITREE_OK)
 };
 
-DECLARE_GLOBAL_MOCK_METHOD_2(CJSONDecoderMocks, , MULTITREE_HANDLE, MultiTree_Create, MULTITREE_CLONE_FUNCTION, cloneFunction, MULTITREE_FREE_FUNCTION, freeFunction);
+DECLARE_GLOBAL_MOCK_METHOD_3(CJSONDecoderMocks, , MULTITREE_HANDLE, MultiTree_CreateInArena, MULTITREE_CLONE_FUNCTION, cloneFunction, size_t, expectedNodes, size_t, expectedNameBytes);
 DECLARE_GLOBAL_MOCK_METHOD_1(CJSONDecoderMocks, , void, MultiTree_Destroy, MULTITREE_HANDLE, treeHandle);
 DECLARE_GLOBAL_MOCK_METHOD_3(CJSONDecoderMocks, , MULTITREE_RESULT, MultiTree_AddChild, MULTITREE_HANDLE, treeHandle, const char*, childName, MULTITREE_HANDLE*, childHandle);
 DECLARE_GLOBAL_MOCK_METHOD_2(CJSONDecoderMocks, , MULTITREE_RESULT, MultiTree_SetValue, MULTITREE_HANDLE, treeHandle, void*, value);
@@ -46,6 +46,24 @@ MICROMOCK_ENUM_TO_STRING(JSON_DECODER_RESULT_TAG,
 
 static MICROMOCK_MUTEX_HANDLE g_testByTest;
 
+/*every token is recorded as "<token>:<slice>|"*/
+static char recordedTokens[1024];
+static size_t tokensBeforeFailure;
+
+static int RecordToken(void* context, JSON_DECODER_TOKEN token, const JSON_DECODER_SLICE* slice)
+{
+    size_t used = strlen(recordedTokens);
+    (void)context;
+    (void)sprintf(recordedTokens + used, "%d:%.*s|", (int)token, (int)slice->length, slice->value);
+    return (tokensBeforeFailure-- == 0) ? 1 : 0;
+}
+
+static JSON_DECODER_RESULT TokenizeText(const char* json)
+{
+    recordedTokens[0] = '\0';
+    return JSONDecoder_Tokenize(json, strlen(json), RecordToken, NULL);
+}
+
 BEGIN_TEST_SUITE(JSONDecoder_ut)
 
 TEST_SUITE_INITIALIZE(BeforeSuite)
@@ -95,7 +113,7 @@ TEST_FUNCTION(JSONDecoder_With_A_Space_As_json_argument_Fails)
     CJSONDecoderMocks mocks;
     MULTITREE_HANDLE multiTree;
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_Destroy(TestMultiTreeHandle));
 
     char jsonString[] = " ";
@@ -106,6 +124,31 @@ TEST_FUNCTION(JSONDecoder_With_A_Space_As_json_argument_Fails)
     ASSERT_ARE_EQUAL(JSON_DECODER_RESULT_TAG, JSON_DECODER_PARSE_ERROR, result);
 }
 
+/* Tests_SRS_JSON_DECODER_41_001: [ JSONDecoder_JSON_To_MultiTree shall create the multi tree with MultiTree_CreateInArena, sized from the number of nodes and the length of the json string, so the whole tree is freed at once. ]*/
+TEST_FUNCTION(JSONDecoder_Creates_The_MultiTree_In_An_Arena_Sized_From_The_JSON)
+{
+    ///arrange
+    CJSONDecoderMocks mocks;
+    MULTITREE_HANDLE multiTree;
+    char json[] = "{\"member1\":\"a\",\"member2\":\"b\"}";
+    void* member1Value = strstr(json, "\"a\"");
+    void* member2Value = strstr(json, "\"b\"");
+
+    STRICT_EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, 4, sizeof(json) - 1))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "member1", IGNORED_PTR_ARG)).CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
+    STRICT_EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, member1Value));
+    STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "member2", IGNORED_PTR_ARG)).CopyOutArgumentBuffer(3, &TestChildHandle2, sizeof(TestChildHandle2));
+    STRICT_EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle2, member2Value));
+
+    ///act
+    JSON_DECODER_RESULT result = JSONDecoder_JSON_To_MultiTree(json, &multiTree);
+
+    ///assert
+    ASSERT_ARE_EQUAL(JSON_DECODER_RESULT_TAG, JSON_DECODER_OK, result);
+    mocks.AssertActualAndExpectedCalls();
+}
+
 /* Tests_SRS_JSON_DECODER_99_007:[ If parsing the JSON fails due to the JSON string being malformed, JSONDecoder_JSON_To_MultiTree shall return JSON_DECODER_PARSE_ERROR.] */
 /* Tests_SRS_JSON_DECODER_99_012:[ A JSON text is a serialized object or array.] */
 TEST_FUNCTION(JSONDecoder_With_An_Empty_String_JSON_Fails)
@@ -130,7 +173,7 @@ TEST_FUNCTION(JSONDecoder_When_The_JSON_Starts_With_An_Unexpected_Character_Fail
     CJSONDecoderMocks mocks;
     MULTITREE_HANDLE multiTree;
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_Destroy(TestMultiTreeHandle));
 
     char jsonString[] = "a";
@@ -149,7 +192,7 @@ TEST_FUNCTION(JSONDecoder_When_The_JSON_Is_Made_Of_Only_A_Left_Square_Bracket_De
     CJSONDecoderMocks mocks;
     MULTITREE_HANDLE multiTree;
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_Destroy(TestMultiTreeHandle));
 
     char jsonString[] = "[";
@@ -168,7 +211,7 @@ TEST_FUNCTION(JSONDecoder_When_The_JSON_Is_Made_Of_Only_A_Left_Curly_Brace_Decod
     CJSONDecoderMocks mocks;
     MULTITREE_HANDLE multiTree;
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_Destroy(TestMultiTreeHandle));
     char jsonString[] = "{";
 
@@ -187,7 +230,7 @@ TEST_FUNCTION(JSONDecoder_When_The_JSON_Is_Made_Of_Only_A_Right_Square_Bracket_D
     CJSONDecoderMocks mocks;
     MULTITREE_HANDLE multiTree;
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_Destroy(TestMultiTreeHandle));
     char jsonString[] = "]";
     ///act
@@ -205,7 +248,7 @@ TEST_FUNCTION(JSONDecoder_When_The_JSON_Is_Made_Of_Only_A_Right_Curly_Brace_Deco
     CJSONDecoderMocks mocks;
     MULTITREE_HANDLE multiTree;
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_Destroy(TestMultiTreeHandle));
     char jsonString[] = "}";
     ///act
@@ -223,7 +266,7 @@ TEST_FUNCTION(JSONDecoder_When_The_JSON_Is_Made_Of_Only_A_Colon_Decoding_Fails)
     CJSONDecoderMocks mocks;
     MULTITREE_HANDLE multiTree;
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_Destroy(TestMultiTreeHandle));
     char jsonString[] = ":";
     ///act
@@ -241,7 +284,7 @@ TEST_FUNCTION(JSONDecoder_When_The_JSON_Is_Made_Of_Only_A_Comma_Decoding_Fails)
     CJSONDecoderMocks mocks;
     MULTITREE_HANDLE multiTree;
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_Destroy(TestMultiTreeHandle));
     char jsonString[] = ",";
     ///act
@@ -259,7 +302,7 @@ TEST_FUNCTION(JSONDecoder_When_The_JSON_Is_An_Empty_Object_Decoding_Succeeds)
     CJSONDecoderMocks mocks;
     MULTITREE_HANDLE multiTree;
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     char jsonString[] = "{}";
     ///act
     JSON_DECODER_RESULT result = JSONDecoder_JSON_To_MultiTree(jsonString, &multiTree);
@@ -277,7 +320,7 @@ TEST_FUNCTION(JSONDecoder_When_The_JSON_Is_An_Empty_Object_Followed_By_Another_O
     CJSONDecoderMocks mocks;
     MULTITREE_HANDLE multiTree;
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_Destroy(TestMultiTreeHandle));
     char jsonString[] = "{}{";
     ///act
@@ -296,7 +339,7 @@ TEST_FUNCTION(JSONDecoder_When_The_JSON_Is_Made_Of_2_Empty_Objects_At_Root_Decod
     CJSONDecoderMocks mocks;
     MULTITREE_HANDLE multiTree;
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_Destroy(TestMultiTreeHandle));
     char jsonString[] = "{}{}";
     ///act
@@ -319,7 +362,7 @@ TEST_FUNCTION(JSONDecoder_When_The_JSON_Is_Made_Of_An_Object_With_One_Element_De
     char json[] = "{\"member1\":\"a\"}";
     void* memberValue = strstr(json, "\"a\"");
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "member1", IGNORED_PTR_ARG)).CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, memberValue));
 
@@ -351,7 +394,7 @@ TEST_FUNCTION(JSONDecoder_When_The_JSON_Is_Made_Of_An_Object_With_2_Elements_Dec
     void* member1Value = strstr(json, "\"a\"");
     void* member2Value = strstr(json, "\"b\"");
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "member1", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, member1Value));
@@ -375,7 +418,7 @@ TEST_FUNCTION(JSONDecoder_When_The_JSON_Ends_After_The_Member_Name_Quote_Decodin
     MULTITREE_HANDLE multiTree;
     char json[] = "{\"";
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_Destroy(TestMultiTreeHandle));
 
     ///act
@@ -394,7 +437,7 @@ TEST_FUNCTION(JSONDecoder_When_The_JSON_Ends_After_The_First_Char_Of_The_Member_
     MULTITREE_HANDLE multiTree;
     char json[] = "{\"m";
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_Destroy(TestMultiTreeHandle));
 
     ///act
@@ -413,7 +456,7 @@ TEST_FUNCTION(JSONDecoder_When_The_JSON_Ends_After_The_Ending_Quote_Of_The_Membe
     MULTITREE_HANDLE multiTree;
     char json[] = "{\"m\"";
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_Destroy(TestMultiTreeHandle));
 
     ///act
@@ -432,7 +475,7 @@ TEST_FUNCTION(JSONDecoder_When_The_JSON_Ends_After_The_Colon_Decoding_Fails)
     MULTITREE_HANDLE multiTree;
     char json[] = "{\"m\":";
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_Destroy(TestMultiTreeHandle));
@@ -453,7 +496,7 @@ TEST_FUNCTION(JSONDecoder_When_The_JSON_Ends_After_The_Begining_Value_Quote_Deco
     MULTITREE_HANDLE multiTree;
     char json[] = "{\"member1\":\"";
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_Destroy(TestMultiTreeHandle));
@@ -474,7 +517,7 @@ TEST_FUNCTION(JSONDecoder_When_The_JSON_Ends_In_The_Middle_Of_A_String_Value_Dec
     MULTITREE_HANDLE multiTree;
     char json[] = "{\"member1\":\"a";
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG)).CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_Destroy(TestMultiTreeHandle));
 
@@ -494,7 +537,7 @@ TEST_FUNCTION(JSONDecoder_When_The_JSON_Ends_After_The_Ending_Quote_Of_A_Value_D
     MULTITREE_HANDLE multiTree;
     char json[] = "{\"member1\":\"a\"";
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG)).CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_Destroy(TestMultiTreeHandle));
@@ -515,7 +558,7 @@ TEST_FUNCTION(JSONDecoder_When_The_JSON_Ends_After_A_Comma_Decoding_Fails)
     MULTITREE_HANDLE multiTree;
     char json[] = "{\"member1\":\"a\",";
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG)).CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_Destroy(TestMultiTreeHandle));
@@ -536,7 +579,7 @@ TEST_FUNCTION(JSONDecoder_When_The_Starting_Quote_Of_The_Name_Is_Missing_Decodin
     MULTITREE_HANDLE multiTree;
     char json[] = "{member1\":\"a\"}";
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_Destroy(TestMultiTreeHandle));
 
     ///act
@@ -555,7 +598,7 @@ TEST_FUNCTION(JSONDecoder_When_The_Ending_Quote_Of_The_Name_Is_Missing_Decoding_
     MULTITREE_HANDLE multiTree;
     char json[] = "{\"member1:\"a\"}";
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_Destroy(TestMultiTreeHandle));
 
     ///act
@@ -574,7 +617,7 @@ TEST_FUNCTION(JSONDecoder_When_The_Colon_Is_Missing_In_A_Name_Value_Pair_Decodin
     MULTITREE_HANDLE multiTree;
     char json[] = "{\"member1\"\"a\"}";
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_Destroy(TestMultiTreeHandle));
 
     ///act
@@ -593,7 +636,7 @@ TEST_FUNCTION(JSONDecoder_When_The_Starting_Quote_Of_A_String_Value_Is_Missing_D
     MULTITREE_HANDLE multiTree;
     char json[] = "{\"member1\":a\"}";
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG)).CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_Destroy(TestMultiTreeHandle));
 
@@ -613,7 +656,7 @@ TEST_FUNCTION(JSONDecoder_When_The_Ending_Quote_Of_A_String_Value_Is_Missing_Dec
     MULTITREE_HANDLE multiTree;
     char json[] = "{\"member1\":a\"}";
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG)).CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_Destroy(TestMultiTreeHandle));
 
@@ -633,7 +676,7 @@ TEST_FUNCTION(JSONDecoder_When_The_Comma_Separator_Is_Missing_Decoding_Fails)
     MULTITREE_HANDLE multiTree;
     char json[] = "{\"member1\":\"a\"\"member2\":\"b\"}";
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG)).CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_Destroy(TestMultiTreeHandle));
@@ -654,7 +697,7 @@ TEST_FUNCTION(JSONDecoder_When_The_AddChild_Fails_Decoding_Fails)
     MULTITREE_HANDLE multiTree;
     char json[] = "{\"member1\":\"a\",\"member1\":\"b\"}";
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG)).SetReturn(MULTITREE_INVALID_ARG);
     STRICT_EXPECTED_CALL(mocks, MultiTree_Destroy(TestMultiTreeHandle));
 
@@ -673,7 +716,7 @@ TEST_FUNCTION(JSONDecoder_When_The_JSON_Contains_An_Empty_Array_Decoding_Succeed
     MULTITREE_HANDLE multiTree;
     char json[] = "[]";
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
 
     ///act
     JSON_DECODER_RESULT result = JSONDecoder_JSON_To_MultiTree(json, &multiTree);
@@ -691,7 +734,7 @@ TEST_FUNCTION(JSONDecoder_When_The_JSON_Contains_Only_The_Opening_Array_Square_B
     MULTITREE_HANDLE multiTree;
     char json[] = "[";
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_Destroy(TestMultiTreeHandle));
 
     ///act
@@ -710,7 +753,7 @@ TEST_FUNCTION(JSONDecoder_When_The_JSON_Contains_Only_The_Closing_Array_Square_B
     MULTITREE_HANDLE multiTree;
     char json[] = "]";
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_Destroy(TestMultiTreeHandle));
 
     ///act
@@ -730,7 +773,7 @@ TEST_FUNCTION(JSONDecoder_When_The_JSON_Contains_One_String_Value_Decoding_Succe
     char json[] = "[\"a\"]";
     void* value1Ptr = &json[1];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, value1Ptr));
@@ -754,7 +797,7 @@ TEST_FUNCTION(JSONDecoder_When_The_JSON_Contains_An_Array_With_2_String_Values_D
     void* value1Ptr = &json[1];
     void* value2Ptr = &json[5];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, value1Ptr));
@@ -778,7 +821,7 @@ TEST_FUNCTION(JSONDecoder_When_The_JSON_Ends_After_The_Begginning_Quote_Of_The_A
     MULTITREE_HANDLE multiTree;
     char json[] = "[\"";
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_Destroy(TestMultiTreeHandle));
@@ -799,7 +842,7 @@ TEST_FUNCTION(JSONDecoder_When_The_JSON_Ends_In_The_Middle_Of_The_Array_First_St
     MULTITREE_HANDLE multiTree;
     char json[] = "[\"a";
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_Destroy(TestMultiTreeHandle));
@@ -821,7 +864,7 @@ TEST_FUNCTION(JSONDecoder_When_The_JSON_Ends_After_The_Ending_Quote_Of_The_Array
     char json[] = "[\"a\"";
     void* value1Ptr = &json[1];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, value1Ptr));
@@ -844,7 +887,7 @@ TEST_FUNCTION(JSONDecoder_When_The_JSON_Ends_After_The_Comma_Of_The_Array_Decodi
     char json[] = "[\"a\",";
     void* value1Ptr = &json[1];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, value1Ptr));
@@ -868,7 +911,7 @@ TEST_FUNCTION(JSONDecoder_When_The_JSON_Contains_An_Array_With_A_false_value_Dec
     char json[] = "[false]";
     void* value1Ptr = &json[1];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, value1Ptr));
@@ -889,7 +932,7 @@ TEST_FUNCTION(JSONDecoder_When_The_JSON_Contains_An_Array_With_A_true_value_Deco
     char json[] = "[true]";
     void* value1Ptr = &json[1];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, value1Ptr));
@@ -910,7 +953,7 @@ TEST_FUNCTION(JSONDecoder_When_The_JSON_Contains_An_Array_With_A_null_value_Deco
     char json[] = "[null]";
     void* value1Ptr = &json[1];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, value1Ptr));
@@ -931,7 +974,7 @@ TEST_FUNCTION(JSONDecoder_When_The_JSON_Contains_An_Array_With_A_false_But_Not_A
     MULTITREE_HANDLE multiTree;
     char json[] = "[fAlse]";
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_Destroy(TestMultiTreeHandle));
@@ -952,7 +995,7 @@ TEST_FUNCTION(JSONDecoder_When_The_JSON_Contains_An_Array_With_A_true_But_Not_Al
     MULTITREE_HANDLE multiTree;
     char json[] = "[trUe]";
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_Destroy(TestMultiTreeHandle));
@@ -973,7 +1016,7 @@ TEST_FUNCTION(JSONDecoder_When_The_JSON_Contains_An_Array_With_A_null_But_Not_Al
     MULTITREE_HANDLE multiTree;
     char json[] = "[Null]";
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_Destroy(TestMultiTreeHandle));
@@ -994,7 +1037,7 @@ TEST_FUNCTION(JSONDecoder_When_The_JSON_Contains_An_Array_With_A_Literal_Name_Th
     MULTITREE_HANDLE multiTree;
     char json[] = "[hagauaga]";
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_Destroy(TestMultiTreeHandle));
@@ -1017,7 +1060,7 @@ TEST_FUNCTION(JSONDecoder_Space_Before_Array_Begin_Is_Allowed_And_Decoding_Succe
     char json[] = " [true]";
     void* value1Ptr = &json[2];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, value1Ptr));
@@ -1040,7 +1083,7 @@ TEST_FUNCTION(JSONDecoder_CR_Before_Array_Begin_Is_Allowed_And_Decoding_Succeeds
     char json[] = "\r[true]";
     void* value1Ptr = &json[2];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, value1Ptr));
@@ -1063,7 +1106,7 @@ TEST_FUNCTION(JSONDecoder_NL_Before_Array_Begin_Is_Allowed_And_Decoding_Succeeds
     char json[] = "\n[true]";
     void* value1Ptr = &json[2];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, value1Ptr));
@@ -1086,7 +1129,7 @@ TEST_FUNCTION(JSONDecoder_Tab_Before_Array_Begin_Is_Allowed_And_Decoding_Succeed
     char json[] = "\t[true]";
     void* value1Ptr = &json[2];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, value1Ptr));
@@ -1108,7 +1151,7 @@ TEST_FUNCTION(JSONDecoder_Multiple_Whitespaces_Before_Array_Begin_Is_Allowed_And
     char json[] = " \t\r\n[true]";
     void* value1Ptr = &json[5];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, value1Ptr));
@@ -1131,7 +1174,7 @@ TEST_FUNCTION(JSONDecoder_Space_After_Array_Begin_Is_Allowed_And_Decoding_Succee
     char json[] = "[ true]";
     void* value1Ptr = &json[2];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, value1Ptr));
@@ -1154,7 +1197,7 @@ TEST_FUNCTION(JSONDecoder_CR_After_Array_Begin_Is_Allowed_And_Decoding_Succeeds)
     char json[] = "[\rtrue]";
     void* value1Ptr = &json[2];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, value1Ptr));
@@ -1177,7 +1220,7 @@ TEST_FUNCTION(JSONDecoder_NL_After_Array_Begin_Is_Allowed_And_Decoding_Succeeds)
     char json[] = "[\ntrue]";
     void* value1Ptr = &json[2];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, value1Ptr));
@@ -1200,7 +1243,7 @@ TEST_FUNCTION(JSONDecoder_Tab_After_Array_Begin_Is_Allowed_And_Decoding_Succeeds
     char json[] = "[\ttrue]";
     void* value1Ptr = &json[2];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, value1Ptr));
@@ -1222,7 +1265,7 @@ TEST_FUNCTION(JSONDecoder_Multiple_Whitespaces_After_Array_Begin_Is_Allowed_And_
     char json[] = "[ \t\r\ntrue]";
     void* value1Ptr = &json[5];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, value1Ptr));
@@ -1244,7 +1287,7 @@ TEST_FUNCTION(JSONDecoder_Multiple_Whitespaces_Before_Array_End_Is_Allowed_And_D
     char json[] = "[true \t\r\n]";
     void* value1Ptr = &json[1];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, value1Ptr));
@@ -1266,7 +1309,7 @@ TEST_FUNCTION(JSONDecoder_Multiple_Whitespaces_After_Array_End_Is_Allowed_And_De
     char json[] = "[true] \t\r\n";
     void* value1Ptr = &json[1];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, value1Ptr));
@@ -1289,7 +1332,7 @@ TEST_FUNCTION(JSONDecoder_Multiple_Whitespaces_Before_Comma_In_Array_Is_Allowed_
     void* value1Ptr = &json[1];
     void* value2Ptr = &json[10];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, value1Ptr));
@@ -1315,7 +1358,7 @@ TEST_FUNCTION(JSONDecoder_Multiple_Whitespaces_After_Comma_In_Array_Is_Allowed_A
     void* value1Ptr = &json[1];
     void* value2Ptr = &json[10];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, value1Ptr));
@@ -1340,7 +1383,7 @@ TEST_FUNCTION(JSONDecoder_Multiple_Whitespaces_Before_Object_Begin_Is_Allowed_An
     char json[] = " \t\r\n{\"a\":true}";
     void* value1Ptr = &json[9];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "a", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, value1Ptr));
@@ -1362,7 +1405,7 @@ TEST_FUNCTION(JSONDecoder_Multiple_Whitespaces_After_Object_Begin_Is_Allowed_And
     char json[] = "{ \t\r\n\"a\":true}";
     void* value1Ptr = &json[9];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "a", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, value1Ptr));
@@ -1384,7 +1427,7 @@ TEST_FUNCTION(JSONDecoder_Multiple_Whitespaces_Before_Object_End_Is_Allowed_And_
     char json[] = "{\"a\":true \t\r\n}";
     void* value1Ptr = &json[5];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "a", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, value1Ptr));
@@ -1406,7 +1449,7 @@ TEST_FUNCTION(JSONDecoder_Multiple_Whitespaces_After_Object_End_Is_Allowed_And_D
     char json[] = "{\"a\":true} \t\r\n";
     void* value1Ptr = &json[5];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "a", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, value1Ptr));
@@ -1428,7 +1471,7 @@ TEST_FUNCTION(JSONDecoder_Multiple_Whitespaces_Before_Colon_Is_Allowed_And_Decod
     char json[] = "{\"a\" \t\r\n:true}";
     void* value1Ptr = &json[9];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "a", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, value1Ptr));
@@ -1450,7 +1493,7 @@ TEST_FUNCTION(JSONDecoder_Multiple_Whitespaces_After_Colon_Is_Allowed_And_Decodi
     char json[] = "{\"a\": \t\r\ntrue}";
     void* value1Ptr = &json[9];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "a", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, value1Ptr));
@@ -1473,7 +1516,7 @@ TEST_FUNCTION(JSONDecoder_Multiple_Whitespaces_Before_Comma_In_Object_Is_Allowed
     void* value1Ptr = &json[5];
     void* value2Ptr = &json[18];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "a", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, value1Ptr));
@@ -1499,7 +1542,7 @@ TEST_FUNCTION(JSONDecoder_Multiple_Whitespaces_After_Comma_In_Object_Is_Allowed_
     void* value1Ptr = &json[5];
     void* value2Ptr = &json[18];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "a", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, value1Ptr));
@@ -1522,7 +1565,7 @@ TEST_FUNCTION(JSONDecoder_Nested_Array_Are_Allowed_And_Decoding_Succeeds)
     MULTITREE_HANDLE multiTree;
     char json[] = "[[]]";
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
 
@@ -1541,7 +1584,7 @@ TEST_FUNCTION(JSONDecoder_Spaces_Before_Nested_Array_Are_Allowed_And_Decoding_Su
     MULTITREE_HANDLE multiTree;
     char json[] = "[ \t\r\n[]]";
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
 
@@ -1560,7 +1603,7 @@ TEST_FUNCTION(JSONDecoder_Spaces_In_Nested_Array_Are_Allowed_And_Decoding_Succee
     MULTITREE_HANDLE multiTree;
     char json[] = "[[ \t\r\n]]";
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
 
@@ -1579,7 +1622,7 @@ TEST_FUNCTION(JSONDecoder_Spaces_After_Nested_Array_Are_Allowed_And_Decoding_Suc
     MULTITREE_HANDLE multiTree;
     char json[] = "[[ \t\r\n]]";
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
 
@@ -1598,7 +1641,7 @@ TEST_FUNCTION(JSONDecoder_Object_In_Array_Is_Allowed_And_Decoding_Succeeds)
     MULTITREE_HANDLE multiTree;
     char json[] = "[{}]";
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
 
@@ -1617,7 +1660,7 @@ TEST_FUNCTION(JSONDecoder_Spaces_Before_Object_In_Array_Are_Allowed_And_Decoding
     MULTITREE_HANDLE multiTree;
     char json[] = "[ \t\r\n{}]";
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
 
@@ -1636,7 +1679,7 @@ TEST_FUNCTION(JSONDecoder_Spaces_In_Object_In_Array_Are_Allowed_And_Decoding_Suc
     MULTITREE_HANDLE multiTree;
     char json[] = "[{ \t\r\n}]";
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
 
@@ -1655,7 +1698,7 @@ TEST_FUNCTION(JSONDecoder_Spaces_After_Object_In_Array_Are_Allowed_And_Decoding_
     MULTITREE_HANDLE multiTree;
     char json[] = "[{} \t\r\n]";
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
 
@@ -1675,7 +1718,7 @@ TEST_FUNCTION(JSONDecoder_Value_In_Object_In_Array_Are_Allowed_And_Decoding_Succ
     char json[] = "[{\"member1\":\"a\"}]";
     void* value1Ptr = &json[12];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestChildHandle1, "member1", IGNORED_PTR_ARG))
@@ -1698,7 +1741,7 @@ TEST_FUNCTION(JSONDecoder_Spaces_Before_Member_Name_In_Object_In_Array_Are_Allow
     char json[] = "[{ \r\n\t\"member1\":\"a\"}]";
     void* value1Ptr = &json[16];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestChildHandle1, "member1", IGNORED_PTR_ARG))
@@ -1721,7 +1764,7 @@ TEST_FUNCTION(JSONDecoder_Spaces_Before_Colon_In_Object_In_Array_Are_Allowed_And
     char json[] = "[{\"member1\" \r\n\t:\"a\"}]";
     void* value1Ptr = &json[16];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestChildHandle1, "member1", IGNORED_PTR_ARG))
@@ -1744,7 +1787,7 @@ TEST_FUNCTION(JSONDecoder_Spaces_After_Colon_In_Object_In_Array_Are_Allowed_And_
     char json[] = "[{\"member1\": \r\n\t\"a\"}]";
     void* value1Ptr = &json[16];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestChildHandle1, "member1", IGNORED_PTR_ARG))
@@ -1767,7 +1810,7 @@ TEST_FUNCTION(JSONDecoder_Spaces_After_Value_In_Object_In_Array_Are_Allowed_And_
     char json[] = "[{\"member1\":\"a\" \r\n\t}]";
     void* value1Ptr = &json[12];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestChildHandle1, "member1", IGNORED_PTR_ARG))
@@ -1791,7 +1834,7 @@ TEST_FUNCTION(JSONDecoder_Spaces_Before_Comma_In_Object_In_Array_Are_Allowed_And
     void* value1Ptr = &json[12];
     void* value2Ptr = &json[30];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestChildHandle1, "member1", IGNORED_PTR_ARG))
@@ -1818,7 +1861,7 @@ TEST_FUNCTION(JSONDecoder_Spaces_After_Comma_In_Object_In_Array_Are_Allowed_And_
     void* value1Ptr = &json[12];
     void* value2Ptr = &json[30];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestChildHandle1, "member1", IGNORED_PTR_ARG))
@@ -1844,7 +1887,7 @@ TEST_FUNCTION(JSONDecoder_Spaces_Before_Value_In_Array_In_Array_Are_Allowed_And_
     char json[] = "[[ \r\n\t\"a\"]]";
     void* value1Ptr = &json[6];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestChildHandle1, "0", IGNORED_PTR_ARG))
@@ -1867,7 +1910,7 @@ TEST_FUNCTION(JSONDecoder_Spaces_After_Value_In_Array_In_Array_Are_Allowed_And_D
     char json[] = "[[\"a\" \r\n\t]]";
     void* value1Ptr = &json[2];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestChildHandle1, "0", IGNORED_PTR_ARG))
@@ -1891,7 +1934,7 @@ TEST_FUNCTION(JSONDecoder_Spaces_Before_Comma_In_Array_In_Array_Are_Allowed_And_
     void* value1Ptr = &json[2];
     void* value2Ptr = &json[10];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestChildHandle1, "0", IGNORED_PTR_ARG))
@@ -1917,7 +1960,7 @@ TEST_FUNCTION(JSONDecoder_Number_Without_Sign_Is_Decoded_Succesfully)
     char json[] = "[1]";
     void* value1Ptr = &json[1];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, value1Ptr));
@@ -1938,7 +1981,7 @@ TEST_FUNCTION(JSONDecoder_Number_Made_Out_Of_Several_Digits_Without_Sign_Is_Deco
     char json[] = "[4242]";
     void* value1Ptr = &json[1];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, value1Ptr));
@@ -1959,7 +2002,7 @@ TEST_FUNCTION(JSONDecoder_Number_With_Minus_Sign_Is_Decoded_Succesfully)
     char json[] = "[-4242]";
     void* value1Ptr = &json[1];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, value1Ptr));
@@ -1979,7 +2022,7 @@ TEST_FUNCTION(JSONDecoder_Number_With_2_Minus_Sign_Fails)
     MULTITREE_HANDLE multiTree;
     char json[] = "[--4242]";
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     EXPECTED_CALL(mocks, MultiTree_Destroy(TestMultiTreeHandle));
@@ -2000,7 +2043,7 @@ TEST_FUNCTION(JSONDecoder_Minus_In_The_Middle_Of_Number_Fails)
     char json[] = "[42-42]";
     void* value1Ptr = &json[1];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, value1Ptr));
@@ -2022,7 +2065,7 @@ TEST_FUNCTION(JSONDecoder_Fraction_Part_Without_Integer_Fails)
     MULTITREE_HANDLE multiTree;
     char json[] = "[.1]";
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     EXPECTED_CALL(mocks, MultiTree_Destroy(TestMultiTreeHandle));
@@ -2043,7 +2086,7 @@ TEST_FUNCTION(JSONDecoder_No_Fraction_Part_Digits_Fails)
     MULTITREE_HANDLE multiTree;
     char json[] = "[1.]";
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     EXPECTED_CALL(mocks, MultiTree_Destroy(TestMultiTreeHandle));
@@ -2065,7 +2108,7 @@ TEST_FUNCTION(JSONDecoder_Integer_With_Fraction_Part_Succeeds)
     char json[] = "[1.1]";
     void* value1Ptr = &json[1];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, value1Ptr));
@@ -2088,7 +2131,7 @@ TEST_FUNCTION(JSONDecoder_Integer_With_e_And_Following_Digits_Succeeds)
     char json[] = "[1e1]";
     void* value1Ptr = &json[1];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, value1Ptr));
@@ -2111,7 +2154,7 @@ TEST_FUNCTION(JSONDecoder_Integer_With_e_And_2_Digits_Succeeds)
     char json[] = "[1e42]";
     void* value1Ptr = &json[1];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, value1Ptr));
@@ -2134,7 +2177,7 @@ TEST_FUNCTION(JSONDecoder_Integer_With_e_And_Minus_And_2_Digits_Succeeds)
     char json[] = "[1e-42]";
     void* value1Ptr = &json[1];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, value1Ptr));
@@ -2157,7 +2200,7 @@ TEST_FUNCTION(JSONDecoder_Integer_With_e_And_Plux_And_2_Digits_Succeeds)
     char json[] = "[1e+42]";
     void* value1Ptr = &json[1];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, value1Ptr));
@@ -2180,7 +2223,7 @@ TEST_FUNCTION(JSONDecoder_Integer_With_E_And_Following_Digits_Succeeds)
     char json[] = "[1E1]";
     void* value1Ptr = &json[1];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, value1Ptr));
@@ -2203,7 +2246,7 @@ TEST_FUNCTION(JSONDecoder_Integer_With_E_And_2_Digits_Succeeds)
     char json[] = "[1E42]";
     void* value1Ptr = &json[1];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, value1Ptr));
@@ -2226,7 +2269,7 @@ TEST_FUNCTION(JSONDecoder_Integer_With_E_And_Minus_And_2_Digits_Succeeds)
     char json[] = "[1E-42]";
     void* value1Ptr = &json[1];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, value1Ptr));
@@ -2249,7 +2292,7 @@ TEST_FUNCTION(JSONDecoder_Integer_With_E_And_Plux_And_2_Digits_Succeeds)
     char json[] = "[1E+42]";
     void* value1Ptr = &json[1];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, value1Ptr));
@@ -2271,7 +2314,7 @@ TEST_FUNCTION(JSONDecoder_Integer_With_e_With_No_Digits_Fails)
     MULTITREE_HANDLE multiTree;
     char json[] = "[1e]";
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     EXPECTED_CALL(mocks, MultiTree_Destroy(TestMultiTreeHandle));
@@ -2293,7 +2336,7 @@ TEST_FUNCTION(JSONDecoder_Integer_With_E_With_No_Digits_Fails)
     MULTITREE_HANDLE multiTree;
     char json[] = "[1E]";
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     EXPECTED_CALL(mocks, MultiTree_Destroy(TestMultiTreeHandle));
@@ -2315,7 +2358,7 @@ TEST_FUNCTION(JSONDecoder_Integer_With_e_Sign_And_With_No_Digits_Fails)
     MULTITREE_HANDLE multiTree;
     char json[] = "[1e-]";
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     EXPECTED_CALL(mocks, MultiTree_Destroy(TestMultiTreeHandle));
@@ -2337,7 +2380,7 @@ TEST_FUNCTION(JSONDecoder_Integer_With_E_Sign_And_With_No_Digits_Fails)
     MULTITREE_HANDLE multiTree;
     char json[] = "[1E-]";
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     EXPECTED_CALL(mocks, MultiTree_Destroy(TestMultiTreeHandle));
@@ -2357,7 +2400,7 @@ TEST_FUNCTION(JSONDecoder_Integer_With_A_Leading_Zero_Fails)
     MULTITREE_HANDLE multiTree;
     char json[] = "[01]";
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     EXPECTED_CALL(mocks, MultiTree_Destroy(TestMultiTreeHandle));
@@ -2377,7 +2420,7 @@ TEST_FUNCTION(JSONDecoder_Integer_With_2_Leading_Zero_Fails)
     MULTITREE_HANDLE multiTree;
     char json[] = "[001]";
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     EXPECTED_CALL(mocks, MultiTree_Destroy(TestMultiTreeHandle));
@@ -2398,7 +2441,7 @@ TEST_FUNCTION(JSONDecoder_Integer_With_The_Value_0_Succeeds)
     char json[] = "[0]";
     void* value1Ptr = &json[1];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, value1Ptr));
@@ -2419,7 +2462,7 @@ TEST_FUNCTION(JSONDecoder_Integer_With_The_Value_101_Succeeds)
     char json[] = "[101]";
     void* value1Ptr = &json[1];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, value1Ptr));
@@ -2439,7 +2482,7 @@ TEST_FUNCTION(JSONDecoder_Integer_With_A_Hex_Number_Fails)
     MULTITREE_HANDLE multiTree;
     char json[] = "[FF]";
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     EXPECTED_CALL(mocks, MultiTree_Destroy(TestMultiTreeHandle));
@@ -2459,7 +2502,7 @@ TEST_FUNCTION(JSONDecoder_Decoding_falseahbjkfsdhjkfhks_Fails)
     MULTITREE_HANDLE multiTree;
     char json[] = "[falseahbjkfsdhjkfhks]";
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, IGNORED_PTR_ARG));
@@ -2480,7 +2523,7 @@ TEST_FUNCTION(JSONDecoder_Decoding_falsetrue_Fails)
     MULTITREE_HANDLE multiTree;
     char json[] = "[falsetrue]";
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, IGNORED_PTR_ARG));
@@ -2500,7 +2543,7 @@ void TestSpecialCharacter_Success(char* json)
     MULTITREE_HANDLE multiTree;
     void* value1Ptr = &json[1];
 
-    EXPECTED_CALL(mocks, MultiTree_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, MultiTree_CreateInArena(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(mocks, MultiTree_AddChild(TestMultiTreeHandle, "0", IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(3, &TestChildHandle1, sizeof(TestChildHandle1));
     STRICT_EXPECTED_CALL(mocks, MultiTree_SetValue(TestChildHandle1, value1Ptr));
@@ -2583,4 +2626,126 @@ TEST_FUNCTION(JSONDecoder_When_String_Has_Several_Escaped_Chars_Decoding_Succeed
     TestSpecialCharacter_Success(json);
 }
 
+/* Tests_SRS_JSON_DECODER_41_002: [ If json or tokenCallback is NULL, JSONDecoder_Tokenize shall return JSON_DECODER_INVALID_ARG. ]*/
+TEST_FUNCTION(JSONDecoder_Tokenize_With_NULL_json_Fails)
+{
+    ///act
+    JSON_DECODER_RESULT result = JSONDecoder_Tokenize(NULL, 2, RecordToken, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(JSON_DECODER_RESULT_TAG, JSON_DECODER_INVALID_ARG, result);
+}
+
+/* Tests_SRS_JSON_DECODER_41_002: [ If json or tokenCallback is NULL, JSONDecoder_Tokenize shall return JSON_DECODER_INVALID_ARG. ]*/
+TEST_FUNCTION(JSONDecoder_Tokenize_With_NULL_tokenCallback_Fails)
+{
+    ///act
+    JSON_DECODER_RESULT result = JSONDecoder_Tokenize("{}", 2, NULL, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(JSON_DECODER_RESULT_TAG, JSON_DECODER_INVALID_ARG, result);
+}
+
+/* Tests_SRS_JSON_DECODER_41_004: [ JSONDecoder_Tokenize shall call tokenCallback for every token of json in document order, with names and strings sliced without their quotes and numbers and literals sliced as they are written. ]*/
+/* Tests_SRS_JSON_DECODER_41_007: [ On success JSONDecoder_Tokenize shall return JSON_DECODER_OK. ]*/
+TEST_FUNCTION(JSONDecoder_Tokenize_Reports_All_Tokens_In_Order)
+{
+    ///arrange
+    tokensBeforeFailure = (size_t)-1;
+
+    ///act
+    JSON_DECODER_RESULT result = TokenizeText(" { \"a\" : 1 , \"b\":[true,false,null,-0.5e+3,\"x\\\"y\\u00e9\"], \"c\":{} } ");
+
+    ///assert
+    ASSERT_ARE_EQUAL(JSON_DECODER_RESULT_TAG, JSON_DECODER_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, "0:{|4:a|6:1|4:b|2:[|7:true|8:false|9:null|6:-0.5e+3|5:x\\\"y\\u00e9|3:]|4:c|0:{|1:}|1:}|", recordedTokens);
+}
+
+/* Tests_SRS_JSON_DECODER_41_004: [ JSONDecoder_Tokenize shall call tokenCallback for every token of json in document order, with names and strings sliced without their quotes and numbers and literals sliced as they are written. ]*/
+TEST_FUNCTION(JSONDecoder_Tokenize_Slices_Long_Strings)
+{
+    ///arrange
+    tokensBeforeFailure = (size_t)-1;
+
+    ///act
+    JSON_DECODER_RESULT result = TokenizeText("{\"a name longer than one word\":\"a value with an \\\\ escape after the first words\"}");
+
+    ///assert
+    ASSERT_ARE_EQUAL(JSON_DECODER_RESULT_TAG, JSON_DECODER_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, "0:{|4:a name longer than one word|5:a value with an \\\\ escape after the first words|1:}|", recordedTokens);
+}
+
+/* Tests_SRS_JSON_DECODER_41_003: [ JSONDecoder_Tokenize shall read exactly length bytes of json, which is not modified and does not have to be NUL terminated. ]*/
+TEST_FUNCTION(JSONDecoder_Tokenize_Reads_Only_length_Bytes)
+{
+    ///arrange
+    const char json[] = "[\"abc\"]garbage";
+    tokensBeforeFailure = (size_t)-1;
+    recordedTokens[0] = '\0';
+
+    ///act
+    JSON_DECODER_RESULT result = JSONDecoder_Tokenize(json, 7, RecordToken, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(JSON_DECODER_RESULT_TAG, JSON_DECODER_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, "2:[|5:abc|3:]|", recordedTokens);
+    ASSERT_ARE_EQUAL(char_ptr, "[\"abc\"]garbage", json);
+}
+
+/* Tests_SRS_JSON_DECODER_41_005: [ If json is not one object or array, is malformed or nests more than JSON_DECODER_MAX_DEPTH containers, JSONDecoder_Tokenize shall return JSON_DECODER_PARSE_ERROR. ]*/
+TEST_FUNCTION(JSONDecoder_Tokenize_With_Malformed_JSON_Fails)
+{
+    ///arrange
+    const char* malformed[] =
+    {
+        "", " ", "1", "\"a\"", "{", "{\"a\"}", "{\"a\":}", "{\"a\":1,}", "[1,]", "[01]", "[1.]", "[1e]", "[tru]",
+        "{\"a\":1 \"b\":2}", "[\"a\tb\"]", "[\"\\x\"]", "[\"\\u12\"]", "{} x", "{\"a\":1}}", "[\"an unterminated string"
+    };
+    size_t i;
+    tokensBeforeFailure = (size_t)-1;
+
+    for (i = 0; i < sizeof(malformed) / sizeof(malformed[0]); i++)
+    {
+        ///act
+        JSON_DECODER_RESULT result = TokenizeText(malformed[i]);
+
+        ///assert
+        ASSERT_ARE_EQUAL(JSON_DECODER_RESULT_TAG, JSON_DECODER_PARSE_ERROR, result);
+    }
+}
+
+/* Tests_SRS_JSON_DECODER_41_005: [ If json is not one object or array, is malformed or nests more than JSON_DECODER_MAX_DEPTH containers, JSONDecoder_Tokenize shall return JSON_DECODER_PARSE_ERROR. ]*/
+TEST_FUNCTION(JSONDecoder_Tokenize_Nesting_More_Than_The_Max_Depth_Fails)
+{
+    ///arrange
+    char json[2 * (JSON_DECODER_MAX_DEPTH + 1) + 1];
+    tokensBeforeFailure = (size_t)-1;
+    (void)memset(json, '[', JSON_DECODER_MAX_DEPTH);
+    (void)memset(json + JSON_DECODER_MAX_DEPTH, ']', JSON_DECODER_MAX_DEPTH);
+    json[2 * JSON_DECODER_MAX_DEPTH] = '\0';
+    ASSERT_ARE_EQUAL(JSON_DECODER_RESULT_TAG, JSON_DECODER_OK, JSONDecoder_Tokenize(json, 2 * JSON_DECODER_MAX_DEPTH, RecordToken, NULL));
+    (void)memset(json, '[', JSON_DECODER_MAX_DEPTH + 1);
+    (void)memset(json + JSON_DECODER_MAX_DEPTH + 1, ']', JSON_DECODER_MAX_DEPTH + 1);
+
+    ///act
+    JSON_DECODER_RESULT result = JSONDecoder_Tokenize(json, 2 * (JSON_DECODER_MAX_DEPTH + 1), RecordToken, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(JSON_DECODER_RESULT_TAG, JSON_DECODER_PARSE_ERROR, result);
+}
+
+/* Tests_SRS_JSON_DECODER_41_006: [ If tokenCallback returns a non zero value, JSONDecoder_Tokenize shall stop and return JSON_DECODER_ERROR. ]*/
+TEST_FUNCTION(JSONDecoder_Tokenize_Stops_When_The_Callback_Fails)
+{
+    ///arrange
+    tokensBeforeFailure = 2;
+
+    ///act
+    JSON_DECODER_RESULT result = TokenizeText("[1,2,3]");
+
+    ///assert
+    ASSERT_ARE_EQUAL(JSON_DECODER_RESULT_TAG, JSON_DECODER_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, "2:[|6:1|6:2|", recordedTokens);
+}
+
 END_TEST_SUITE(JSONDecoder_ut)
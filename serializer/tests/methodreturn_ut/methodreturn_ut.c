@@ -248,6 +248,61 @@ TEST_FUNCTION(MethodReturn_Create_with_NULL_jsonValue_unhappy_paths)
     umock_c_negative_tests_deinit();
 }
 
+/*Tests_SRS_METHODRETURN_41_001: [ MethodReturn_CreateTrusted shall create a METHODRETURN_HANDLE exactly as MethodReturn_Create does, except that it shall not check that jsonValue is a JSON value. ]*/
+TEST_FUNCTION(MethodReturn_CreateTrusted_does_not_parse_jsonValue)
+{
+    ///arrange
+    const char* jsonValue = "1";
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument_size();
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, jsonValue))
+        .IgnoreArgument_destination();
+
+    ///act
+    METHODRETURN_HANDLE h = MethodReturn_CreateTrusted(1, jsonValue);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NOT_NULL(h);
+    ASSERT_ARE_EQUAL(int, 1, MethodReturn_GetReturn(h)->statusCode);
+    ASSERT_ARE_EQUAL(char_ptr, "1", MethodReturn_GetReturn(h)->jsonValue);
+
+    ///cleanup
+    MethodReturn_Destroy(h);
+}
+
+/*Tests_SRS_METHODRETURN_41_001: [ MethodReturn_CreateTrusted shall create a METHODRETURN_HANDLE exactly as MethodReturn_Create does, except that it shall not check that jsonValue is a JSON value. ]*/
+TEST_FUNCTION(MethodReturn_CreateTrusted_unhappy_paths)
+{
+    ///arrange
+    const char* jsonValue = "1";
+    umock_c_negative_tests_init();
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument_size();
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, jsonValue))
+        .IgnoreArgument_destination();
+    umock_c_negative_tests_snapshot();
+
+    for (size_t i = 0; i < umock_c_negative_tests_call_count(); i++)
+    {
+        umock_c_negative_tests_reset();
+
+        umock_c_negative_tests_fail_call(i);
+        char temp_str[128];
+        sprintf(temp_str, "On failed call %lu", (unsigned long)i);
+
+        ///act
+        METHODRETURN_HANDLE h = MethodReturn_CreateTrusted(1, jsonValue);
+
+        ///assert
+        ASSERT_IS_NULL(h, temp_str);
+    }
+
+    ///cleanup
+    umock_c_negative_tests_deinit();
+}
+
 /*Tests_SRS_METHODRETURN_02_003: [ If handle is NULL then MethodReturn_Destroy shall return. ]*/
 TEST_FUNCTION(MethodReturn_Destroy_with_NULL_handle_returns)
 {
@@ -316,4 +371,77 @@ TEST_FUNCTION(MethodReturn_GetReturn_with_non_NULL_handle_succeeds)
     MethodReturn_Destroy(h);
 }
 
+/*Tests_SRS_METHODRETURN_41_002: [ If handle or jsonValueLength is NULL then MethodReturn_DetachJsonValue shall fail and return NULL. ]*/
+TEST_FUNCTION(MethodReturn_DetachJsonValue_with_NULL_handle_fails)
+{
+    ///arrange
+    size_t jsonValueLength;
+
+    ///act
+    char* jsonValue = MethodReturn_DetachJsonValue(NULL, &jsonValueLength);
+
+    ///assert
+    ASSERT_IS_NULL(jsonValue);
+}
+
+/*Tests_SRS_METHODRETURN_41_002: [ If handle or jsonValueLength is NULL then MethodReturn_DetachJsonValue shall fail and return NULL. ]*/
+TEST_FUNCTION(MethodReturn_DetachJsonValue_with_NULL_jsonValueLength_fails)
+{
+    ///arrange
+    METHODRETURN_HANDLE h = MethodReturn_Create(1, "1");
+    umock_c_reset_all_calls();
+
+    ///act
+    char* jsonValue = MethodReturn_DetachJsonValue(h, NULL);
+
+    ///assert
+    ASSERT_IS_NULL(jsonValue);
+    ASSERT_ARE_EQUAL(char_ptr, "1", MethodReturn_GetReturn(h)->jsonValue);
+
+    ///clean
+    MethodReturn_Destroy(h);
+}
+
+/*Tests_SRS_METHODRETURN_41_003: [ Otherwise MethodReturn_DetachJsonValue shall return the JSON value held by handle, write its length in *jsonValueLength and leave handle without a JSON value. The caller owns the returned string and shall free it. ]*/
+TEST_FUNCTION(MethodReturn_DetachJsonValue_succeeds)
+{
+    ///arrange
+    size_t jsonValueLength;
+    METHODRETURN_HANDLE h = MethodReturn_Create(1, "\"abc\"");
+    umock_c_reset_all_calls();
+
+    ///act
+    char* jsonValue = MethodReturn_DetachJsonValue(h, &jsonValueLength);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, "\"abc\"", jsonValue);
+    ASSERT_ARE_EQUAL(size_t, 5, jsonValueLength);
+    ASSERT_IS_NULL(MethodReturn_GetReturn(h)->jsonValue);
+    ASSERT_ARE_EQUAL(int, 1, MethodReturn_GetReturn(h)->statusCode);
+
+    ///clean
+    MethodReturn_Destroy(h); /*only frees the handle*/
+    my_gballoc_free(jsonValue);
+}
+
+/*Tests_SRS_METHODRETURN_41_003: [ Otherwise MethodReturn_DetachJsonValue shall return the JSON value held by handle, write its length in *jsonValueLength and leave handle without a JSON value. The caller owns the returned string and shall free it. ]*/
+TEST_FUNCTION(MethodReturn_DetachJsonValue_with_NULL_jsonValue_returns_NULL)
+{
+    ///arrange
+    size_t jsonValueLength = 1;
+    METHODRETURN_HANDLE h = MethodReturn_Create(1, NULL);
+    umock_c_reset_all_calls();
+
+    ///act
+    char* jsonValue = MethodReturn_DetachJsonValue(h, &jsonValueLength);
+
+    ///assert
+    ASSERT_IS_NULL(jsonValue);
+    ASSERT_ARE_EQUAL(size_t, 0, jsonValueLength);
+
+    ///clean
+    MethodReturn_Destroy(h);
+}
+
 END_TEST_SUITE(methodreturn_ut);
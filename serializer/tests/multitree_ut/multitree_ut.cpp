@@ -56,6 +56,12 @@ static void StringFree(void* string)
     gballoc_free(string);
 }
 
+static int PointerClone(void** destination, const void* source)
+{
+    *destination = (void*)source;
+    return 0;
+}
+
 #if defined _MSC_VER
 #define snprintf _snprintf
 #endif
@@ -2159,6 +2165,77 @@ TEST_FUNCTION(MultiTree_GetLeafValue_On_A_Child_Node_With_No_Value_Fails)
     mocks.ResetAllCalls();
 }
 
+/* Tests_SRS_MULTITREE_41_001: [ Once a node has more than CHILD_INDEX_THRESHOLD children, its children shall be found through an index keyed by the hash of their names. ]*/
+/* Tests_SRS_MULTITREE_41_002: [ Adding a child to an indexed node shall add it to the index, growing the index once it is half full; if the index cannot grow, lookups shall fall back to a linear search. ]*/
+TEST_FUNCTION(MultiTree_GetLeafValue_On_A_Node_With_Many_Children_Succeeds)
+{
+    ///arrange
+    CMultiTreeMocks mocks;
+    MULTITREE_HANDLE treeHandle = MultiTree_Create(StringClone, StringFree);
+    char leafPath[32];
+    char leafValue[32];
+    int i;
+
+    for (i = 0; i < 200; i++)
+    {
+        (void)sprintf(leafPath, "/node/child%d", i);
+        (void)sprintf(leafValue, "v%d", i);
+        ASSERT_ARE_EQUAL(MULTITREE_RESULT, MULTITREE_OK, MultiTree_AddLeaf(treeHandle, leafPath, leafValue));
+        if (i == 20)
+        {
+            /*the first lookup above the threshold builds the index, the children added after it go in the index*/
+            const void* value;
+            ASSERT_ARE_EQUAL(MULTITREE_RESULT, MULTITREE_OK, MultiTree_GetLeafValue(treeHandle, "node/child3", &value));
+        }
+    }
+
+    ///act
+    for (i = 0; i < 200; i++)
+    {
+        const void* value;
+        (void)sprintf(leafPath, "node/child%d", i);
+        (void)sprintf(leafValue, "v%d", i);
+
+        ///assert
+        ASSERT_ARE_EQUAL(MULTITREE_RESULT, MULTITREE_OK, MultiTree_GetLeafValue(treeHandle, leafPath, &value));
+        ASSERT_ARE_EQUAL(char_ptr, leafValue, (const char*)value);
+    }
+
+    MultiTree_Destroy(treeHandle);
+    mocks.ResetAllCalls();
+}
+
+/* Tests_SRS_MULTITREE_41_001: [ Once a node has more than CHILD_INDEX_THRESHOLD children, its children shall be found through an index keyed by the hash of their names. ]*/
+TEST_FUNCTION(MultiTree_GetChildByName_After_DeleteChild_On_A_Node_With_Many_Children_Succeeds)
+{
+    ///arrange
+    CMultiTreeMocks mocks;
+    MULTITREE_HANDLE treeHandle = MultiTree_Create(StringClone, StringFree);
+    MULTITREE_HANDLE childHandle;
+    char childName[32];
+    int i;
+
+    for (i = 0; i < 40; i++)
+    {
+        (void)sprintf(childName, "child%d", i);
+        (void)MultiTree_AddChild(treeHandle, childName, &childHandle);
+    }
+    (void)MultiTree_GetChildByName(treeHandle, "child1", &childHandle);
+
+    ///act
+    MULTITREE_RESULT deleteResult = MultiTree_DeleteChild(treeHandle, "child5");
+    MULTITREE_RESULT deletedResult = MultiTree_GetChildByName(treeHandle, "child5", &childHandle);
+    MULTITREE_RESULT lastResult = MultiTree_GetChildByName(treeHandle, "child39", &childHandle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(MULTITREE_RESULT, MULTITREE_OK, deleteResult);
+    ASSERT_ARE_EQUAL(MULTITREE_RESULT, MULTITREE_CHILD_NOT_FOUND, deletedResult);
+    ASSERT_ARE_EQUAL(MULTITREE_RESULT, MULTITREE_OK, lastResult);
+
+    MultiTree_Destroy(treeHandle);
+    mocks.ResetAllCalls();
+}
+
 /* MultiTree_SetValue */
 
 /* Tests_SRS_MULTITREE_99_074:[ If any argument is NULL, MultiTree_SetValue shall return MULTITREE_INVALID_ARG.] */
@@ -2444,5 +2521,85 @@ TEST_FUNCTION(MultiTree_DeleteChild_With_Only_Node_Succeeds)
 }
 
 
+/* Tests_SRS_MULTITREE_41_003: [ If cloneFunction is NULL, MultiTree_CreateInArena shall return NULL. ]*/
+TEST_FUNCTION(MultiTree_CreateInArena_With_NULL_CloneFunction_Fails)
+{
+    ///arrange
+    CMultiTreeMocks mocks;
+
+    ///act
+    MULTITREE_HANDLE treeHandle = MultiTree_CreateInArena(NULL, 1, 1);
+
+    ///assert
+    ASSERT_IS_NULL(treeHandle);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/* Tests_SRS_MULTITREE_41_004: [ MultiTree_CreateInArena shall create a new tree whose nodes, names and children arrays are taken from an arena sized for expectedNodes nodes with expectedNameBytes bytes of names, allocated together with the root. ]*/
+TEST_FUNCTION(MultiTree_CreateInArena_Allocates_Once_For_The_Expected_Nodes)
+{
+    ///arrange
+    CMultiTreeMocks mocks;
+    MULTITREE_HANDLE treeHandle;
+    MULTITREE_HANDLE childHandle;
+    char childName[32];
+    int i;
+
+    EXPECTED_CALL(mocks, gballoc_malloc(0))
+        .IgnoreArgument(1);
+
+    ///act
+    treeHandle = MultiTree_CreateInArena(PointerClone, 10, 100);
+    for (i = 0; i < 10; i++)
+    {
+        (void)sprintf(childName, "child%d", i);
+        ASSERT_ARE_EQUAL(MULTITREE_RESULT, MULTITREE_OK, MultiTree_AddChild(treeHandle, childName, &childHandle));
+    }
+
+    ///assert
+    ASSERT_IS_NOT_NULL(treeHandle);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    MultiTree_Destroy(treeHandle);
+}
+
+/* Tests_SRS_MULTITREE_41_005: [ The values of the nodes of a tree created by MultiTree_CreateInArena shall not be freed by MultiTree_Destroy. ]*/
+/* Tests_SRS_MULTITREE_41_006: [ MultiTree_Destroy shall free the whole arena, without visiting its nodes, when called for the root of a tree created by MultiTree_CreateInArena, and do nothing for its other nodes. ]*/
+TEST_FUNCTION(MultiTree_Destroy_Of_A_Tree_In_An_Arena_Frees_Everything_But_The_Values)
+{
+    ///arrange
+    CMultiTreeMocks mocks;
+    MULTITREE_HANDLE treeHandle = MultiTree_CreateInArena(PointerClone, 1, 1);
+    MULTITREE_HANDLE childHandle;
+    static char leafValues[200][32];
+    char leafPath[32];
+    int i;
+
+    /*the estimate is far too small, so the arena has to grow*/
+    for (i = 0; i < 200; i++)
+    {
+        (void)sprintf(leafPath, "/node%d/child%d", i % 3, i);
+        (void)sprintf(leafValues[i], "v%d", i);
+        ASSERT_ARE_EQUAL(MULTITREE_RESULT, MULTITREE_OK, MultiTree_AddLeaf(treeHandle, leafPath, leafValues[i]));
+    }
+    for (i = 0; i < 200; i++)
+    {
+        const void* value;
+        (void)sprintf(leafPath, "node%d/child%d", i % 3, i);
+        ASSERT_ARE_EQUAL(MULTITREE_RESULT, MULTITREE_OK, MultiTree_GetLeafValue(treeHandle, leafPath, &value));
+        ASSERT_ARE_EQUAL(void_ptr, (void*)leafValues[i], (void*)value);
+    }
+    ASSERT_ARE_EQUAL(MULTITREE_RESULT, MULTITREE_OK, MultiTree_GetChildByName(treeHandle, "node1", &childHandle));
+    mocks.ResetAllCalls();
+
+    ///act
+    MultiTree_Destroy(childHandle);
+    MultiTree_Destroy(treeHandle);
+
+    ///assert
+    /*the values are owned by the caller and the arena blocks are all freed, which the leak check at the end of the test verifies*/
+    ASSERT_ARE_EQUAL(char_ptr, "v0", leafValues[0]);
+}
 
 END_TEST_SUITE(MultiTree_ut)
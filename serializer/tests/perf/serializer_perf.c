@@ -0,0 +1,671 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+// Measures the serializer hot paths on models of increasing width (10, 100 and 1000 fields):
+// SERIALIZE, SERIALIZE_REPORTED_PROPERTIES, INGEST_DESIRED_PROPERTIES (full twin and patch),
+// EXECUTE_COMMAND and the MultiTree operations underneath them.
+//
+// usage: serializer_perf [results.json]
+// The results are always printed as text; when a file name is given they are also written there as JSON,
+// so that two runs can be compared by CI.
+//
+// A model declaration cannot have more than 124 macro arguments, so the 1000 wide models nest ten 100 wide models.
+// Sending a complete model instance only covers the properties of its root model, which is why SERIALIZE and
+// SERIALIZE_REPORTED_PROPERTIES are measured at 10 and 100 fields.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "azure_c_shared_utility/xlogging.h"
+#include "serializer.h"
+#include "multitree.h"
+#include "jsonencoder.h"
+#include "common/perf_harness.h"
+
+#define PERF_MAX_BENCHMARKS         32
+#define PERF_PAYLOAD_SIZE           (64 * 1024)
+
+BEGIN_NAMESPACE(SerializerPerf);
+
+DECLARE_MODEL(PerfTelemetry10,
+    WITH_DATA(int, f0), WITH_DATA(int, f1), WITH_DATA(int, f2), WITH_DATA(int, f3), WITH_DATA(int, f4),
+    WITH_DATA(int, f5), WITH_DATA(int, f6), WITH_DATA(int, f7), WITH_DATA(int, f8), WITH_DATA(int, f9),
+    WITH_ACTION(PerfAction10, int, value)
+);
+
+DECLARE_MODEL(PerfTelemetry100,
+    WITH_DATA(int, f0), WITH_DATA(int, f1), WITH_DATA(int, f2), WITH_DATA(int, f3), WITH_DATA(int, f4),
+    WITH_DATA(int, f5), WITH_DATA(int, f6), WITH_DATA(int, f7), WITH_DATA(int, f8), WITH_DATA(int, f9),
+    WITH_DATA(int, f10), WITH_DATA(int, f11), WITH_DATA(int, f12), WITH_DATA(int, f13), WITH_DATA(int, f14),
+    WITH_DATA(int, f15), WITH_DATA(int, f16), WITH_DATA(int, f17), WITH_DATA(int, f18), WITH_DATA(int, f19),
+    WITH_DATA(int, f20), WITH_DATA(int, f21), WITH_DATA(int, f22), WITH_DATA(int, f23), WITH_DATA(int, f24),
+    WITH_DATA(int, f25), WITH_DATA(int, f26), WITH_DATA(int, f27), WITH_DATA(int, f28), WITH_DATA(int, f29),
+    WITH_DATA(int, f30), WITH_DATA(int, f31), WITH_DATA(int, f32), WITH_DATA(int, f33), WITH_DATA(int, f34),
+    WITH_DATA(int, f35), WITH_DATA(int, f36), WITH_DATA(int, f37), WITH_DATA(int, f38), WITH_DATA(int, f39),
+    WITH_DATA(int, f40), WITH_DATA(int, f41), WITH_DATA(int, f42), WITH_DATA(int, f43), WITH_DATA(int, f44),
+    WITH_DATA(int, f45), WITH_DATA(int, f46), WITH_DATA(int, f47), WITH_DATA(int, f48), WITH_DATA(int, f49),
+    WITH_DATA(int, f50), WITH_DATA(int, f51), WITH_DATA(int, f52), WITH_DATA(int, f53), WITH_DATA(int, f54),
+    WITH_DATA(int, f55), WITH_DATA(int, f56), WITH_DATA(int, f57), WITH_DATA(int, f58), WITH_DATA(int, f59),
+    WITH_DATA(int, f60), WITH_DATA(int, f61), WITH_DATA(int, f62), WITH_DATA(int, f63), WITH_DATA(int, f64),
+    WITH_DATA(int, f65), WITH_DATA(int, f66), WITH_DATA(int, f67), WITH_DATA(int, f68), WITH_DATA(int, f69),
+    WITH_DATA(int, f70), WITH_DATA(int, f71), WITH_DATA(int, f72), WITH_DATA(int, f73), WITH_DATA(int, f74),
+    WITH_DATA(int, f75), WITH_DATA(int, f76), WITH_DATA(int, f77), WITH_DATA(int, f78), WITH_DATA(int, f79),
+    WITH_DATA(int, f80), WITH_DATA(int, f81), WITH_DATA(int, f82), WITH_DATA(int, f83), WITH_DATA(int, f84),
+    WITH_DATA(int, f85), WITH_DATA(int, f86), WITH_DATA(int, f87), WITH_DATA(int, f88), WITH_DATA(int, f89),
+    WITH_DATA(int, f90), WITH_DATA(int, f91), WITH_DATA(int, f92), WITH_DATA(int, f93), WITH_DATA(int, f94),
+    WITH_DATA(int, f95), WITH_DATA(int, f96), WITH_DATA(int, f97), WITH_DATA(int, f98), WITH_DATA(int, f99),
+    WITH_ACTION(PerfAction100, int, value)
+);
+
+DECLARE_MODEL(PerfTelemetry1000,
+    WITH_DATA(PerfTelemetry100, m0), WITH_DATA(PerfTelemetry100, m1), WITH_DATA(PerfTelemetry100, m2), WITH_DATA(PerfTelemetry100, m3), WITH_DATA(PerfTelemetry100, m4),
+    WITH_DATA(PerfTelemetry100, m5), WITH_DATA(PerfTelemetry100, m6), WITH_DATA(PerfTelemetry100, m7), WITH_DATA(PerfTelemetry100, m8), WITH_DATA(PerfTelemetry100, m9)
+);
+
+DECLARE_MODEL(PerfReported10,
+    WITH_REPORTED_PROPERTY(int, r0), WITH_REPORTED_PROPERTY(int, r1), WITH_REPORTED_PROPERTY(int, r2), WITH_REPORTED_PROPERTY(int, r3), WITH_REPORTED_PROPERTY(int, r4),
+    WITH_REPORTED_PROPERTY(int, r5), WITH_REPORTED_PROPERTY(int, r6), WITH_REPORTED_PROPERTY(int, r7), WITH_REPORTED_PROPERTY(int, r8), WITH_REPORTED_PROPERTY(int, r9)
+);
+
+DECLARE_MODEL(PerfReported100,
+    WITH_REPORTED_PROPERTY(int, r0), WITH_REPORTED_PROPERTY(int, r1), WITH_REPORTED_PROPERTY(int, r2), WITH_REPORTED_PROPERTY(int, r3), WITH_REPORTED_PROPERTY(int, r4),
+    WITH_REPORTED_PROPERTY(int, r5), WITH_REPORTED_PROPERTY(int, r6), WITH_REPORTED_PROPERTY(int, r7), WITH_REPORTED_PROPERTY(int, r8), WITH_REPORTED_PROPERTY(int, r9),
+    WITH_REPORTED_PROPERTY(int, r10), WITH_REPORTED_PROPERTY(int, r11), WITH_REPORTED_PROPERTY(int, r12), WITH_REPORTED_PROPERTY(int, r13), WITH_REPORTED_PROPERTY(int, r14),
+    WITH_REPORTED_PROPERTY(int, r15), WITH_REPORTED_PROPERTY(int, r16), WITH_REPORTED_PROPERTY(int, r17), WITH_REPORTED_PROPERTY(int, r18), WITH_REPORTED_PROPERTY(int, r19),
+    WITH_REPORTED_PROPERTY(int, r20), WITH_REPORTED_PROPERTY(int, r21), WITH_REPORTED_PROPERTY(int, r22), WITH_REPORTED_PROPERTY(int, r23), WITH_REPORTED_PROPERTY(int, r24),
+    WITH_REPORTED_PROPERTY(int, r25), WITH_REPORTED_PROPERTY(int, r26), WITH_REPORTED_PROPERTY(int, r27), WITH_REPORTED_PROPERTY(int, r28), WITH_REPORTED_PROPERTY(int, r29),
+    WITH_REPORTED_PROPERTY(int, r30), WITH_REPORTED_PROPERTY(int, r31), WITH_REPORTED_PROPERTY(int, r32), WITH_REPORTED_PROPERTY(int, r33), WITH_REPORTED_PROPERTY(int, r34),
+    WITH_REPORTED_PROPERTY(int, r35), WITH_REPORTED_PROPERTY(int, r36), WITH_REPORTED_PROPERTY(int, r37), WITH_REPORTED_PROPERTY(int, r38), WITH_REPORTED_PROPERTY(int, r39),
+    WITH_REPORTED_PROPERTY(int, r40), WITH_REPORTED_PROPERTY(int, r41), WITH_REPORTED_PROPERTY(int, r42), WITH_REPORTED_PROPERTY(int, r43), WITH_REPORTED_PROPERTY(int, r44),
+    WITH_REPORTED_PROPERTY(int, r45), WITH_REPORTED_PROPERTY(int, r46), WITH_REPORTED_PROPERTY(int, r47), WITH_REPORTED_PROPERTY(int, r48), WITH_REPORTED_PROPERTY(int, r49),
+    WITH_REPORTED_PROPERTY(int, r50), WITH_REPORTED_PROPERTY(int, r51), WITH_REPORTED_PROPERTY(int, r52), WITH_REPORTED_PROPERTY(int, r53), WITH_REPORTED_PROPERTY(int, r54),
+    WITH_REPORTED_PROPERTY(int, r55), WITH_REPORTED_PROPERTY(int, r56), WITH_REPORTED_PROPERTY(int, r57), WITH_REPORTED_PROPERTY(int, r58), WITH_REPORTED_PROPERTY(int, r59),
+    WITH_REPORTED_PROPERTY(int, r60), WITH_REPORTED_PROPERTY(int, r61), WITH_REPORTED_PROPERTY(int, r62), WITH_REPORTED_PROPERTY(int, r63), WITH_REPORTED_PROPERTY(int, r64),
+    WITH_REPORTED_PROPERTY(int, r65), WITH_REPORTED_PROPERTY(int, r66), WITH_REPORTED_PROPERTY(int, r67), WITH_REPORTED_PROPERTY(int, r68), WITH_REPORTED_PROPERTY(int, r69),
+    WITH_REPORTED_PROPERTY(int, r70), WITH_REPORTED_PROPERTY(int, r71), WITH_REPORTED_PROPERTY(int, r72), WITH_REPORTED_PROPERTY(int, r73), WITH_REPORTED_PROPERTY(int, r74),
+    WITH_REPORTED_PROPERTY(int, r75), WITH_REPORTED_PROPERTY(int, r76), WITH_REPORTED_PROPERTY(int, r77), WITH_REPORTED_PROPERTY(int, r78), WITH_REPORTED_PROPERTY(int, r79),
+    WITH_REPORTED_PROPERTY(int, r80), WITH_REPORTED_PROPERTY(int, r81), WITH_REPORTED_PROPERTY(int, r82), WITH_REPORTED_PROPERTY(int, r83), WITH_REPORTED_PROPERTY(int, r84),
+    WITH_REPORTED_PROPERTY(int, r85), WITH_REPORTED_PROPERTY(int, r86), WITH_REPORTED_PROPERTY(int, r87), WITH_REPORTED_PROPERTY(int, r88), WITH_REPORTED_PROPERTY(int, r89),
+    WITH_REPORTED_PROPERTY(int, r90), WITH_REPORTED_PROPERTY(int, r91), WITH_REPORTED_PROPERTY(int, r92), WITH_REPORTED_PROPERTY(int, r93), WITH_REPORTED_PROPERTY(int, r94),
+    WITH_REPORTED_PROPERTY(int, r95), WITH_REPORTED_PROPERTY(int, r96), WITH_REPORTED_PROPERTY(int, r97), WITH_REPORTED_PROPERTY(int, r98), WITH_REPORTED_PROPERTY(int, r99)
+);
+
+DECLARE_MODEL(PerfDesired10,
+    WITH_DESIRED_PROPERTY(int, d0), WITH_DESIRED_PROPERTY(int, d1), WITH_DESIRED_PROPERTY(int, d2), WITH_DESIRED_PROPERTY(int, d3), WITH_DESIRED_PROPERTY(int, d4),
+    WITH_DESIRED_PROPERTY(int, d5), WITH_DESIRED_PROPERTY(int, d6), WITH_DESIRED_PROPERTY(int, d7), WITH_DESIRED_PROPERTY(int, d8), WITH_DESIRED_PROPERTY(int, d9)
+);
+
+DECLARE_MODEL(PerfDesired100,
+    WITH_DESIRED_PROPERTY(int, d0), WITH_DESIRED_PROPERTY(int, d1), WITH_DESIRED_PROPERTY(int, d2), WITH_DESIRED_PROPERTY(int, d3), WITH_DESIRED_PROPERTY(int, d4),
+    WITH_DESIRED_PROPERTY(int, d5), WITH_DESIRED_PROPERTY(int, d6), WITH_DESIRED_PROPERTY(int, d7), WITH_DESIRED_PROPERTY(int, d8), WITH_DESIRED_PROPERTY(int, d9),
+    WITH_DESIRED_PROPERTY(int, d10), WITH_DESIRED_PROPERTY(int, d11), WITH_DESIRED_PROPERTY(int, d12), WITH_DESIRED_PROPERTY(int, d13), WITH_DESIRED_PROPERTY(int, d14),
+    WITH_DESIRED_PROPERTY(int, d15), WITH_DESIRED_PROPERTY(int, d16), WITH_DESIRED_PROPERTY(int, d17), WITH_DESIRED_PROPERTY(int, d18), WITH_DESIRED_PROPERTY(int, d19),
+    WITH_DESIRED_PROPERTY(int, d20), WITH_DESIRED_PROPERTY(int, d21), WITH_DESIRED_PROPERTY(int, d22), WITH_DESIRED_PROPERTY(int, d23), WITH_DESIRED_PROPERTY(int, d24),
+    WITH_DESIRED_PROPERTY(int, d25), WITH_DESIRED_PROPERTY(int, d26), WITH_DESIRED_PROPERTY(int, d27), WITH_DESIRED_PROPERTY(int, d28), WITH_DESIRED_PROPERTY(int, d29),
+    WITH_DESIRED_PROPERTY(int, d30), WITH_DESIRED_PROPERTY(int, d31), WITH_DESIRED_PROPERTY(int, d32), WITH_DESIRED_PROPERTY(int, d33), WITH_DESIRED_PROPERTY(int, d34),
+    WITH_DESIRED_PROPERTY(int, d35), WITH_DESIRED_PROPERTY(int, d36), WITH_DESIRED_PROPERTY(int, d37), WITH_DESIRED_PROPERTY(int, d38), WITH_DESIRED_PROPERTY(int, d39),
+    WITH_DESIRED_PROPERTY(int, d40), WITH_DESIRED_PROPERTY(int, d41), WITH_DESIRED_PROPERTY(int, d42), WITH_DESIRED_PROPERTY(int, d43), WITH_DESIRED_PROPERTY(int, d44),
+    WITH_DESIRED_PROPERTY(int, d45), WITH_DESIRED_PROPERTY(int, d46), WITH_DESIRED_PROPERTY(int, d47), WITH_DESIRED_PROPERTY(int, d48), WITH_DESIRED_PROPERTY(int, d49),
+    WITH_DESIRED_PROPERTY(int, d50), WITH_DESIRED_PROPERTY(int, d51), WITH_DESIRED_PROPERTY(int, d52), WITH_DESIRED_PROPERTY(int, d53), WITH_DESIRED_PROPERTY(int, d54),
+    WITH_DESIRED_PROPERTY(int, d55), WITH_DESIRED_PROPERTY(int, d56), WITH_DESIRED_PROPERTY(int, d57), WITH_DESIRED_PROPERTY(int, d58), WITH_DESIRED_PROPERTY(int, d59),
+    WITH_DESIRED_PROPERTY(int, d60), WITH_DESIRED_PROPERTY(int, d61), WITH_DESIRED_PROPERTY(int, d62), WITH_DESIRED_PROPERTY(int, d63), WITH_DESIRED_PROPERTY(int, d64),
+    WITH_DESIRED_PROPERTY(int, d65), WITH_DESIRED_PROPERTY(int, d66), WITH_DESIRED_PROPERTY(int, d67), WITH_DESIRED_PROPERTY(int, d68), WITH_DESIRED_PROPERTY(int, d69),
+    WITH_DESIRED_PROPERTY(int, d70), WITH_DESIRED_PROPERTY(int, d71), WITH_DESIRED_PROPERTY(int, d72), WITH_DESIRED_PROPERTY(int, d73), WITH_DESIRED_PROPERTY(int, d74),
+    WITH_DESIRED_PROPERTY(int, d75), WITH_DESIRED_PROPERTY(int, d76), WITH_DESIRED_PROPERTY(int, d77), WITH_DESIRED_PROPERTY(int, d78), WITH_DESIRED_PROPERTY(int, d79),
+    WITH_DESIRED_PROPERTY(int, d80), WITH_DESIRED_PROPERTY(int, d81), WITH_DESIRED_PROPERTY(int, d82), WITH_DESIRED_PROPERTY(int, d83), WITH_DESIRED_PROPERTY(int, d84),
+    WITH_DESIRED_PROPERTY(int, d85), WITH_DESIRED_PROPERTY(int, d86), WITH_DESIRED_PROPERTY(int, d87), WITH_DESIRED_PROPERTY(int, d88), WITH_DESIRED_PROPERTY(int, d89),
+    WITH_DESIRED_PROPERTY(int, d90), WITH_DESIRED_PROPERTY(int, d91), WITH_DESIRED_PROPERTY(int, d92), WITH_DESIRED_PROPERTY(int, d93), WITH_DESIRED_PROPERTY(int, d94),
+    WITH_DESIRED_PROPERTY(int, d95), WITH_DESIRED_PROPERTY(int, d96), WITH_DESIRED_PROPERTY(int, d97), WITH_DESIRED_PROPERTY(int, d98), WITH_DESIRED_PROPERTY(int, d99)
+);
+
+DECLARE_MODEL(PerfDesired1000,
+    WITH_DESIRED_PROPERTY(PerfDesired100, m0), WITH_DESIRED_PROPERTY(PerfDesired100, m1), WITH_DESIRED_PROPERTY(PerfDesired100, m2), WITH_DESIRED_PROPERTY(PerfDesired100, m3), WITH_DESIRED_PROPERTY(PerfDesired100, m4),
+    WITH_DESIRED_PROPERTY(PerfDesired100, m5), WITH_DESIRED_PROPERTY(PerfDesired100, m6), WITH_DESIRED_PROPERTY(PerfDesired100, m7), WITH_DESIRED_PROPERTY(PerfDesired100, m8), WITH_DESIRED_PROPERTY(PerfDesired100, m9)
+);
+
+END_NAMESPACE(SerializerPerf);
+
+EXECUTE_COMMAND_RESULT PerfAction10(PerfTelemetry10* device, int value)
+{
+    device->f0 = value;
+    return EXECUTE_COMMAND_SUCCESS;
+}
+
+EXECUTE_COMMAND_RESULT PerfAction100(PerfTelemetry100* device, int value)
+{
+    device->f0 = value;
+    return EXECUTE_COMMAND_SUCCESS;
+}
+
+typedef struct PERF_BENCHMARK_RESULT_TAG
+{
+    const char* name;
+    PERF_RESULT result;
+} PERF_BENCHMARK_RESULT;
+
+static PERF_BENCHMARK_RESULT g_results[PERF_MAX_BENCHMARKS];
+static size_t g_result_count = 0;
+
+/* dispatches to the type specific SERIALIZE / SERIALIZE_REPORTED_PROPERTIES call */
+typedef int(*PERF_SEND_FUNCTION)(void* device, unsigned char** destination, size_t* destinationSize);
+
+typedef struct SEND_CONTEXT_TAG
+{
+    void* device;
+    PERF_SEND_FUNCTION send;
+} SEND_CONTEXT;
+
+typedef struct INGEST_CONTEXT_TAG
+{
+    void* device;
+    const char* payload;
+    bool parseDesiredNode;
+} INGEST_CONTEXT;
+
+typedef struct COMMAND_CONTEXT_TAG
+{
+    void* device;
+    const char* command;
+} COMMAND_CONTEXT;
+
+typedef struct MULTITREE_CONTEXT_TAG
+{
+    size_t nLeaves;
+    char (*names)[8];
+    MULTITREE_HANDLE tree;
+    STRING_HANDLE json;
+} MULTITREE_CONTEXT;
+
+static int record(const char* name, size_t iterations, PERF_OPERATION operation, void* context)
+{
+    int result;
+    PERF_RESULT measured;
+
+    if ((result = perf_run(name, iterations, operation, context, &measured)) == 0)
+    {
+        if (g_result_count < PERF_MAX_BENCHMARKS)
+        {
+            g_results[g_result_count].name = name;
+            g_results[g_result_count].result = measured;
+            g_result_count++;
+        }
+    }
+
+    return result;
+}
+
+static int write_json_results(const char* fileName)
+{
+    int result;
+    FILE* file;
+
+    if ((file = fopen(fileName, "w")) == NULL)
+    {
+        LogError("Failed opening %s", fileName);
+        result = __FAILURE__;
+    }
+    else
+    {
+        size_t i;
+
+        (void)fprintf(file, "{\n    \"benchmarks\": [\n");
+        for (i = 0; i < g_result_count; i++)
+        {
+            const PERF_RESULT* measured = &g_results[i].result;
+            double ns_per_op = (measured->ops_per_second == 0.0) ? 0.0 : (1000000000.0 / measured->ops_per_second);
+
+            (void)fprintf(file, "        { \"name\": \"%s\", \"iterations\": %lu, \"ns_per_op\": %.1f, \"p50_ns\": %lu, \"p99_ns\": %lu, ",
+                g_results[i].name, (unsigned long)measured->iterations, ns_per_op, (unsigned long)measured->p50_ns, (unsigned long)measured->p99_ns);
+            if (measured->allocations_per_op < 0)
+            {
+                (void)fprintf(file, "\"allocations_per_op\": null }");
+            }
+            else
+            {
+                (void)fprintf(file, "\"allocations_per_op\": %.2f }", measured->allocations_per_op);
+            }
+            (void)fprintf(file, "%s\n", (i + 1 < g_result_count) ? "," : "");
+        }
+        (void)fprintf(file, "    ]\n}\n");
+
+        result = (fclose(file) == 0) ? 0 : __FAILURE__;
+    }
+
+    return result;
+}
+
+/* writes {"<prefix>0":<value>,...,"<prefix>n-1":<value>} at destination, returns the number of characters written */
+static size_t write_flat_object(char* destination, const char* prefix, size_t nFields, int value)
+{
+    size_t written = 0;
+    size_t i;
+
+    destination[written++] = '{';
+    for (i = 0; i < nFields; i++)
+    {
+        written += sprintf(destination + written, "%s\"%s%lu\":%d", (i == 0) ? "" : ",", prefix, (unsigned long)i, value);
+    }
+    destination[written++] = '}';
+    destination[written] = '\0';
+    return written;
+}
+
+/* writes the desired properties of a model of nFields fields, nesting ten 100 wide models when nFields is 1000 */
+static size_t write_desired_object(char* destination, size_t nFields, int value)
+{
+    size_t written;
+
+    if (nFields <= 100)
+    {
+        written = write_flat_object(destination, "d", nFields, value);
+    }
+    else
+    {
+        size_t i;
+        written = 0;
+        destination[written++] = '{';
+        for (i = 0; i < nFields / 100; i++)
+        {
+            written += sprintf(destination + written, "%s\"m%lu\":", (i == 0) ? "" : ",", (unsigned long)i);
+            written += write_flat_object(destination + written, "d", 100, value);
+        }
+        destination[written++] = '}';
+        destination[written] = '\0';
+    }
+
+    return written;
+}
+
+static int send_telemetry10(void* device, unsigned char** destination, size_t* destinationSize)
+{
+    return (SERIALIZE(destination, destinationSize, *(PerfTelemetry10*)device) == CODEFIRST_OK) ? 0 : __FAILURE__;
+}
+
+static int send_telemetry100(void* device, unsigned char** destination, size_t* destinationSize)
+{
+    return (SERIALIZE(destination, destinationSize, *(PerfTelemetry100*)device) == CODEFIRST_OK) ? 0 : __FAILURE__;
+}
+
+static int send_reported10(void* device, unsigned char** destination, size_t* destinationSize)
+{
+    return (SERIALIZE_REPORTED_PROPERTIES(destination, destinationSize, *(PerfReported10*)device) == CODEFIRST_OK) ? 0 : __FAILURE__;
+}
+
+static int send_reported100(void* device, unsigned char** destination, size_t* destinationSize)
+{
+    return (SERIALIZE_REPORTED_PROPERTIES(destination, destinationSize, *(PerfReported100*)device) == CODEFIRST_OK) ? 0 : __FAILURE__;
+}
+
+static int send_and_free(void* ctx)
+{
+    int result;
+    SEND_CONTEXT* context = (SEND_CONTEXT*)ctx;
+    unsigned char* destination;
+    size_t destinationSize;
+
+    if ((result = context->send(context->device, &destination, &destinationSize)) == 0)
+    {
+        free(destination);
+    }
+
+    return result;
+}
+
+static int ingest_desired(void* ctx)
+{
+    INGEST_CONTEXT* context = (INGEST_CONTEXT*)ctx;
+    return (INGEST_DESIRED_PROPERTIES(context->device, context->payload, context->parseDesiredNode) == CODEFIRST_OK) ? 0 : __FAILURE__;
+}
+
+static int execute_command(void* ctx)
+{
+    COMMAND_CONTEXT* context = (COMMAND_CONTEXT*)ctx;
+    return (EXECUTE_COMMAND(context->device, context->command) == EXECUTE_COMMAND_SUCCESS) ? 0 : __FAILURE__;
+}
+
+static int clone_pointer(void** destination, const void* source)
+{
+    *destination = (void*)source;
+    return 0;
+}
+
+static void free_nothing(void* value)
+{
+    (void)value;
+}
+
+static MULTITREE_HANDLE build_tree(const MULTITREE_CONTEXT* context)
+{
+    MULTITREE_HANDLE result;
+
+    if ((result = MultiTree_Create(clone_pointer, free_nothing)) == NULL)
+    {
+        LogError("MultiTree_Create failed");
+    }
+    else
+    {
+        size_t i;
+        for (i = 0; i < context->nLeaves; i++)
+        {
+            if (MultiTree_AddLeaf(result, context->names[i], "42") != MULTITREE_OK)
+            {
+                LogError("MultiTree_AddLeaf failed");
+                break;
+            }
+        }
+
+        if (i < context->nLeaves)
+        {
+            MultiTree_Destroy(result);
+            result = NULL;
+        }
+    }
+
+    return result;
+}
+
+static int build_and_destroy_tree(void* ctx)
+{
+    int result;
+    MULTITREE_HANDLE tree;
+
+    if ((tree = build_tree((MULTITREE_CONTEXT*)ctx)) == NULL)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        MultiTree_Destroy(tree);
+        result = 0;
+    }
+
+    return result;
+}
+
+static int get_every_leaf(void* ctx)
+{
+    int result = 0;
+    MULTITREE_CONTEXT* context = (MULTITREE_CONTEXT*)ctx;
+    size_t i;
+
+    for (i = 0; i < context->nLeaves; i++)
+    {
+        const void* value;
+        if (MultiTree_GetLeafValue(context->tree, context->names[i], &value) != MULTITREE_OK)
+        {
+            result = __FAILURE__;
+            break;
+        }
+    }
+
+    return result;
+}
+
+static int encode_tree(void* ctx)
+{
+    MULTITREE_CONTEXT* context = (MULTITREE_CONTEXT*)ctx;
+    STRING_empty(context->json);
+    return (JSONEncoder_EncodeTree(context->tree, context->json, JSONEncoder_CharPtr_ToString) == JSON_ENCODER_OK) ? 0 : __FAILURE__;
+}
+
+static int run_send_benchmarks(void)
+{
+    int result = 0;
+    PerfTelemetry10* telemetry10 = CREATE_MODEL_INSTANCE(SerializerPerf, PerfTelemetry10);
+    PerfTelemetry100* telemetry100 = CREATE_MODEL_INSTANCE(SerializerPerf, PerfTelemetry100);
+    PerfReported10* reported10 = CREATE_MODEL_INSTANCE(SerializerPerf, PerfReported10);
+    PerfReported100* reported100 = CREATE_MODEL_INSTANCE(SerializerPerf, PerfReported100);
+
+    if ((telemetry10 == NULL) || (telemetry100 == NULL) || (reported10 == NULL) || (reported100 == NULL))
+    {
+        LogError("Failed creating the model instances");
+        result = __FAILURE__;
+    }
+    else
+    {
+        SEND_CONTEXT context;
+
+        context.device = telemetry10;
+        context.send = send_telemetry10;
+        result |= record("CodeFirst_SendAsync (10 fields)", 20000, send_and_free, &context);
+        context.device = telemetry100;
+        context.send = send_telemetry100;
+        result |= record("CodeFirst_SendAsync (100 fields)", 2000, send_and_free, &context);
+        context.device = reported10;
+        context.send = send_reported10;
+        result |= record("CodeFirst_SendAsyncReported (10 fields)", 20000, send_and_free, &context);
+        context.device = reported100;
+        context.send = send_reported100;
+        result |= record("CodeFirst_SendAsyncReported (100 fields)", 2000, send_and_free, &context);
+    }
+
+    if (telemetry10 != NULL)
+    {
+        DESTROY_MODEL_INSTANCE(telemetry10);
+    }
+    if (telemetry100 != NULL)
+    {
+        DESTROY_MODEL_INSTANCE(telemetry100);
+    }
+    if (reported10 != NULL)
+    {
+        DESTROY_MODEL_INSTANCE(reported10);
+    }
+    if (reported100 != NULL)
+    {
+        DESTROY_MODEL_INSTANCE(reported100);
+    }
+
+    return result;
+}
+
+static int run_ingest_benchmark(const char* fullName, const char* patchName, void* device, size_t nFields, size_t iterations)
+{
+    int result;
+    char* full;
+    char* patch;
+
+    if ((full = (char*)malloc(PERF_PAYLOAD_SIZE)) == NULL)
+    {
+        LogError("Failed allocating the full twin payload");
+        result = __FAILURE__;
+    }
+    else
+    {
+        if ((patch = (char*)malloc(PERF_PAYLOAD_SIZE)) == NULL)
+        {
+            LogError("Failed allocating the patch payload");
+            result = __FAILURE__;
+        }
+        else
+        {
+            INGEST_CONTEXT context;
+            size_t written;
+
+            /* the full twin: every desired property, the version and a reported section that is skipped */
+            written = (size_t)sprintf(full, "{\"desired\":");
+            written += write_desired_object(full + written, nFields, 7);
+            written -= 1; /*reopens the desired object to add the version*/
+            written += (size_t)sprintf(full + written, ",\"$version\":3},\"reported\":");
+            written += write_flat_object(full + written, "r", 10, 1);
+            (void)sprintf(full + written, "}");
+
+            /* a patch: a single changed desired property and the version */
+            if (nFields <= 100)
+            {
+                (void)sprintf(patch, "{\"d%lu\":8,\"$version\":4}", (unsigned long)(nFields - 1));
+            }
+            else
+            {
+                (void)sprintf(patch, "{\"m%lu\":{\"d99\":8},\"$version\":4}", (unsigned long)(nFields / 100 - 1));
+            }
+
+            context.device = device;
+            context.payload = full;
+            context.parseDesiredNode = true;
+            result = record(fullName, iterations, ingest_desired, &context);
+
+            context.payload = patch;
+            context.parseDesiredNode = false;
+            result |= record(patchName, iterations * 10, ingest_desired, &context);
+
+            free(patch);
+        }
+        free(full);
+    }
+
+    return result;
+}
+
+static int run_desired_benchmarks(void)
+{
+    int result = 0;
+    PerfDesired10* desired10 = CREATE_MODEL_INSTANCE(SerializerPerf, PerfDesired10);
+    PerfDesired100* desired100 = CREATE_MODEL_INSTANCE(SerializerPerf, PerfDesired100);
+    PerfDesired1000* desired1000 = CREATE_MODEL_INSTANCE(SerializerPerf, PerfDesired1000);
+
+    if ((desired10 == NULL) || (desired100 == NULL) || (desired1000 == NULL))
+    {
+        LogError("Failed creating the model instances");
+        result = __FAILURE__;
+    }
+    else
+    {
+        result |= run_ingest_benchmark("CodeFirst_IngestDesiredProperties full (10 fields)", "CodeFirst_IngestDesiredProperties patch (10 fields)", desired10, 10, 20000);
+        result |= run_ingest_benchmark("CodeFirst_IngestDesiredProperties full (100 fields)", "CodeFirst_IngestDesiredProperties patch (100 fields)", desired100, 100, 2000);
+        result |= run_ingest_benchmark("CodeFirst_IngestDesiredProperties full (1000 fields)", "CodeFirst_IngestDesiredProperties patch (1000 fields)", desired1000, 1000, 200);
+    }
+
+    if (desired10 != NULL)
+    {
+        DESTROY_MODEL_INSTANCE(desired10);
+    }
+    if (desired100 != NULL)
+    {
+        DESTROY_MODEL_INSTANCE(desired100);
+    }
+    if (desired1000 != NULL)
+    {
+        DESTROY_MODEL_INSTANCE(desired1000);
+    }
+
+    return result;
+}
+
+static int run_command_benchmarks(void)
+{
+    int result = 0;
+    PerfTelemetry10* telemetry10 = CREATE_MODEL_INSTANCE(SerializerPerf, PerfTelemetry10);
+    PerfTelemetry100* telemetry100 = CREATE_MODEL_INSTANCE(SerializerPerf, PerfTelemetry100);
+    PerfTelemetry1000* telemetry1000 = CREATE_MODEL_INSTANCE(SerializerPerf, PerfTelemetry1000);
+
+    if ((telemetry10 == NULL) || (telemetry100 == NULL) || (telemetry1000 == NULL))
+    {
+        LogError("Failed creating the model instances");
+        result = __FAILURE__;
+    }
+    else
+    {
+        COMMAND_CONTEXT context;
+
+        context.device = telemetry10;
+        context.command = "{\"Name\":\"PerfAction10\",\"Parameters\":{\"value\":5}}";
+        result |= record("CodeFirst_ExecuteCommand (10 fields)", 20000, execute_command, &context);
+        context.device = telemetry100;
+        context.command = "{\"Name\":\"PerfAction100\",\"Parameters\":{\"value\":5}}";
+        result |= record("CodeFirst_ExecuteCommand (100 fields)", 20000, execute_command, &context);
+        context.device = telemetry1000;
+        context.command = "{\"Name\":\"m9/PerfAction100\",\"Parameters\":{\"value\":5}}";
+        result |= record("CodeFirst_ExecuteCommand (1000 fields, nested)", 20000, execute_command, &context);
+    }
+
+    if (telemetry10 != NULL)
+    {
+        DESTROY_MODEL_INSTANCE(telemetry10);
+    }
+    if (telemetry100 != NULL)
+    {
+        DESTROY_MODEL_INSTANCE(telemetry100);
+    }
+    if (telemetry1000 != NULL)
+    {
+        DESTROY_MODEL_INSTANCE(telemetry1000);
+    }
+
+    return result;
+}
+
+static int run_multitree_benchmark(size_t nLeaves, const char* buildName, const char* getName, const char* encodeName, size_t iterations)
+{
+    int result;
+    MULTITREE_CONTEXT context;
+
+    context.nLeaves = nLeaves;
+    if ((context.names = (char(*)[8])malloc(nLeaves * sizeof(context.names[0]))) == NULL)
+    {
+        LogError("Failed allocating the leaf names");
+        result = __FAILURE__;
+    }
+    else
+    {
+        size_t i;
+        for (i = 0; i < nLeaves; i++)
+        {
+            (void)sprintf(context.names[i], "f%lu", (unsigned long)i);
+        }
+
+        if ((context.tree = build_tree(&context)) == NULL)
+        {
+            result = __FAILURE__;
+        }
+        else
+        {
+            if ((context.json = STRING_new()) == NULL)
+            {
+                LogError("STRING_new failed");
+                result = __FAILURE__;
+            }
+            else
+            {
+                result = record(buildName, iterations, build_and_destroy_tree, &context);
+                result |= record(getName, iterations, get_every_leaf, &context);
+                result |= record(encodeName, iterations, encode_tree, &context);
+                STRING_delete(context.json);
+            }
+            MultiTree_Destroy(context.tree);
+        }
+        free(context.names);
+    }
+
+    return result;
+}
+
+int main(int argc, char** argv)
+{
+    int result;
+
+    if (serializer_init(NULL) != SERIALIZER_OK)
+    {
+        LogError("serializer_init failed");
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = run_send_benchmarks();
+        result |= run_desired_benchmarks();
+        result |= run_command_benchmarks();
+        result |= run_multitree_benchmark(10, "MultiTree_AddLeaf + Destroy (10 leaves)", "MultiTree_GetLeafValue x10 (10 leaves)", "JSONEncoder_EncodeTree (10 leaves)", 20000);
+        result |= run_multitree_benchmark(100, "MultiTree_AddLeaf + Destroy (100 leaves)", "MultiTree_GetLeafValue x100 (100 leaves)", "JSONEncoder_EncodeTree (100 leaves)", 2000);
+        result |= run_multitree_benchmark(1000, "MultiTree_AddLeaf + Destroy (1000 leaves)", "MultiTree_GetLeafValue x1000 (1000 leaves)", "JSONEncoder_EncodeTree (1000 leaves)", 200);
+
+        if ((argc > 1) && (write_json_results(argv[1]) != 0))
+        {
+            result = __FAILURE__;
+        }
+
+        serializer_deinit();
+    }
+
+    return result;
+}
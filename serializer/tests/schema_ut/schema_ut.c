@@ -1385,6 +1385,35 @@ BEGIN_TEST_SUITE(Schema_ut)
         Schema_Destroy(schemaHandle);
     }
 
+    /* Tests_SRS_SCHEMA_99_036:[Schema_GetModelPropertyByName shall return a non-NULL SCHEMA_PROPERTY_HANDLE corresponding to the model type identified by modelTypeHandle and matching the propertyName argument value.] */
+    TEST_FUNCTION(Schema_GetModelPropertyByName_With_Many_Properties_Returns_The_Matching_Property_Handle)
+    {
+        // arrange
+        char propertyName[16];
+        size_t i;
+        SCHEMA_HANDLE schemaHandle = Schema_Create(SCHEMA_NAMESPACE, TEST_SCHEMA_METADATA);
+        SCHEMA_MODEL_TYPE_HANDLE modelType = Schema_CreateModelType(schemaHandle, "Model");
+        for (i = 0; i < 100; i++)
+        {
+            (void)sprintf(propertyName, "p%u", (unsigned int)i);
+            (void)Schema_AddModelProperty(modelType, propertyName, "SomeType");
+        }
+
+        for (i = 0; i < 100; i++)
+        {
+            (void)sprintf(propertyName, "p%u", (unsigned int)i);
+
+            // act
+            SCHEMA_PROPERTY_HANDLE result = Schema_GetModelPropertyByName(modelType, propertyName);
+
+            // assert
+            ASSERT_ARE_EQUAL(void_ptr, Schema_GetModelPropertyByIndex(modelType, i), result);
+        }
+
+        // cleanup
+        Schema_Destroy(schemaHandle);
+    }
+
     /* Schema_GetModelPropertyCount */
     /* Tests_SRS_SCHEMA_99_092: [Schema_GetModelPropertyCount shall return SCHEMA_INVALID_ARG if any of the arguments is NULL.] */
     TEST_FUNCTION(Schema_GetModelPropertyCount_With_NULL_modelTypeHandle_Fails)
@@ -1653,6 +1682,167 @@ BEGIN_TEST_SUITE(Schema_ut)
         Schema_Destroy(schemaHandle);
     }
 
+    /* Tests_SRS_SCHEMA_99_040:[Schema_GetModelActionByName shall return a non-NULL SCHEMA_ACTION_HANDLE corresponding to the model type identified by modelTypeHandle and matching the actionName argument value.] */
+    TEST_FUNCTION(Schema_GetModelActionByName_With_Many_Actions_Returns_The_Matching_Action_Handle)
+    {
+        // arrange
+        char actionName[16];
+        size_t i;
+        SCHEMA_HANDLE schemaHandle = Schema_Create(SCHEMA_NAMESPACE, TEST_SCHEMA_METADATA);
+        SCHEMA_MODEL_TYPE_HANDLE modelType = Schema_CreateModelType(schemaHandle, "Model");
+        for (i = 0; i < 100; i++)
+        {
+            (void)sprintf(actionName, "a%u", (unsigned int)i);
+            (void)Schema_CreateModelAction(modelType, actionName);
+        }
+
+        for (i = 0; i < 100; i++)
+        {
+            (void)sprintf(actionName, "a%u", (unsigned int)i);
+
+            // act
+            SCHEMA_ACTION_HANDLE result = Schema_GetModelActionByName(modelType, actionName);
+
+            // assert
+            ASSERT_ARE_EQUAL(void_ptr, Schema_GetModelActionByIndex(modelType, i), result);
+        }
+
+        // cleanup
+        Schema_Destroy(schemaHandle);
+    }
+
+    /* Schema_SetModelCommandMetadata */
+
+    /* Tests_SRS_SCHEMA_41_001: [ If modelTypeHandle or commandMetadata is NULL, Schema_SetModelCommandMetadata shall return SCHEMA_INVALID_ARG. ]*/
+    TEST_FUNCTION(Schema_SetModelCommandMetadata_With_A_NULL_ModelType_Handle_Fails)
+    {
+        // arrange
+
+        // act
+        SCHEMA_RESULT result = Schema_SetModelCommandMetadata(NULL, "[]");
+
+        // assert
+        ASSERT_ARE_EQUAL(SCHEMA_RESULT, SCHEMA_INVALID_ARG, result);
+    }
+
+    /* Tests_SRS_SCHEMA_41_001: [ If modelTypeHandle or commandMetadata is NULL, Schema_SetModelCommandMetadata shall return SCHEMA_INVALID_ARG. ]*/
+    TEST_FUNCTION(Schema_SetModelCommandMetadata_With_NULL_CommandMetadata_Fails)
+    {
+        // arrange
+        SCHEMA_HANDLE schemaHandle = Schema_Create(SCHEMA_NAMESPACE, TEST_SCHEMA_METADATA);
+        SCHEMA_MODEL_TYPE_HANDLE modelType = Schema_CreateModelType(schemaHandle, "Model");
+        umock_c_reset_all_calls();
+
+        // act
+        SCHEMA_RESULT result = Schema_SetModelCommandMetadata(modelType, NULL);
+
+        // assert
+        ASSERT_ARE_EQUAL(SCHEMA_RESULT, SCHEMA_INVALID_ARG, result);
+        ASSERT_IS_NULL(Schema_GetModelCommandMetadata(modelType));
+
+        // cleanup
+        Schema_Destroy(schemaHandle);
+    }
+
+    /* Tests_SRS_SCHEMA_41_002: [ Schema_SetModelCommandMetadata shall keep a copy of commandMetadata with the model, in place of the one kept before, and return SCHEMA_OK; if copying fails it shall keep the previous one and return SCHEMA_ERROR. ]*/
+    /* Tests_SRS_SCHEMA_41_003: [ Schema_GetModelCommandMetadata shall return the command metadata kept with the model, or NULL if modelTypeHandle is NULL or none was kept. ]*/
+    TEST_FUNCTION(Schema_SetModelCommandMetadata_Keeps_A_Copy_With_The_Model)
+    {
+        // arrange
+        SCHEMA_HANDLE schemaHandle = Schema_Create(SCHEMA_NAMESPACE, TEST_SCHEMA_METADATA);
+        SCHEMA_MODEL_TYPE_HANDLE modelType = Schema_CreateModelType(schemaHandle, "Model");
+        char commandMetadata[] = "[]";
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, commandMetadata));
+
+        // act
+        SCHEMA_RESULT result = Schema_SetModelCommandMetadata(modelType, commandMetadata);
+        commandMetadata[0] = '{';
+
+        // assert
+        ASSERT_ARE_EQUAL(SCHEMA_RESULT, SCHEMA_OK, result);
+        ASSERT_ARE_EQUAL(char_ptr, "[]", Schema_GetModelCommandMetadata(modelType));
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        // cleanup
+        Schema_Destroy(schemaHandle);
+    }
+
+    /* Tests_SRS_SCHEMA_41_002: [ Schema_SetModelCommandMetadata shall keep a copy of commandMetadata with the model, in place of the one kept before, and return SCHEMA_OK; if copying fails it shall keep the previous one and return SCHEMA_ERROR. ]*/
+    TEST_FUNCTION(Schema_SetModelCommandMetadata_Replaces_The_Kept_Metadata)
+    {
+        // arrange
+        SCHEMA_HANDLE schemaHandle = Schema_Create(SCHEMA_NAMESPACE, TEST_SCHEMA_METADATA);
+        SCHEMA_MODEL_TYPE_HANDLE modelType = Schema_CreateModelType(schemaHandle, "Model");
+        (void)Schema_SetModelCommandMetadata(modelType, "[]");
+        umock_c_reset_all_calls();
+
+        // act
+        SCHEMA_RESULT result = Schema_SetModelCommandMetadata(modelType, "[{\"Name\":\"Reset\",\"Parameters\":[]}]");
+
+        // assert
+        ASSERT_ARE_EQUAL(SCHEMA_RESULT, SCHEMA_OK, result);
+        ASSERT_ARE_EQUAL(char_ptr, "[{\"Name\":\"Reset\",\"Parameters\":[]}]", Schema_GetModelCommandMetadata(modelType));
+
+        // cleanup
+        Schema_Destroy(schemaHandle);
+    }
+
+    /* Tests_SRS_SCHEMA_41_002: [ Schema_SetModelCommandMetadata shall keep a copy of commandMetadata with the model, in place of the one kept before, and return SCHEMA_OK; if copying fails it shall keep the previous one and return SCHEMA_ERROR. ]*/
+    TEST_FUNCTION(Schema_SetModelCommandMetadata_When_Copying_Fails_Keeps_The_Previous_Metadata)
+    {
+        // arrange
+        SCHEMA_HANDLE schemaHandle = Schema_Create(SCHEMA_NAMESPACE, TEST_SCHEMA_METADATA);
+        SCHEMA_MODEL_TYPE_HANDLE modelType = Schema_CreateModelType(schemaHandle, "Model");
+        (void)Schema_SetModelCommandMetadata(modelType, "[]");
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, "[{}]"))
+            .SetReturn(__FAILURE__);
+
+        // act
+        SCHEMA_RESULT result = Schema_SetModelCommandMetadata(modelType, "[{}]");
+
+        // assert
+        ASSERT_ARE_EQUAL(SCHEMA_RESULT, SCHEMA_ERROR, result);
+        ASSERT_ARE_EQUAL(char_ptr, "[]", Schema_GetModelCommandMetadata(modelType));
+
+        // cleanup
+        Schema_Destroy(schemaHandle);
+    }
+
+    /* Schema_GetModelCommandMetadata */
+
+    /* Tests_SRS_SCHEMA_41_003: [ Schema_GetModelCommandMetadata shall return the command metadata kept with the model, or NULL if modelTypeHandle is NULL or none was kept. ]*/
+    TEST_FUNCTION(Schema_GetModelCommandMetadata_With_A_NULL_ModelType_Handle_Returns_NULL)
+    {
+        // arrange
+
+        // act
+        const char* result = Schema_GetModelCommandMetadata(NULL);
+
+        // assert
+        ASSERT_IS_NULL(result);
+    }
+
+    /* Tests_SRS_SCHEMA_41_003: [ Schema_GetModelCommandMetadata shall return the command metadata kept with the model, or NULL if modelTypeHandle is NULL or none was kept. ]*/
+    TEST_FUNCTION(Schema_GetModelCommandMetadata_When_None_Was_Kept_Returns_NULL)
+    {
+        // arrange
+        SCHEMA_HANDLE schemaHandle = Schema_Create(SCHEMA_NAMESPACE, TEST_SCHEMA_METADATA);
+        SCHEMA_MODEL_TYPE_HANDLE modelType = Schema_CreateModelType(schemaHandle, "Model");
+
+        // act
+        const char* result = Schema_GetModelCommandMetadata(modelType);
+
+        // assert
+        ASSERT_IS_NULL(result);
+
+        // cleanup
+        Schema_Destroy(schemaHandle);
+    }
+
     /* Schema_GetModelActionCount */
 
     /* Tests_SRS_SCHEMA_99_045:[If any of the modelTypeHandle or actionCount arguments is NULL, Schema_GetModelActionCount shall return SCHEMA_INVALID_ARG.] */
@@ -5639,6 +5829,36 @@ BEGIN_TEST_SUITE(Schema_ut)
         Schema_Destroy(schemaHandle);
     }
 
+    /*Tests_SRS_SCHEMA_02_080: [ If elementName is a desired property then Schema_GetModelElementByName shall succeed and set SCHEMA_MODEL_ELEMENT.elementType to SCHEMA_DESIRED_PROPERTY and SCHEMA_MODEL_ELEMENT.elementHandle.desiredPropertyHandle to the handle of the desired property. ]*/
+    TEST_FUNCTION(Schema_GetModelElementByName_With_Many_Desired_Properties_Returns_The_Matching_Desired_Property_Handle)
+    {
+        ///arrange
+        char desiredPropertyName[16];
+        size_t i;
+        SCHEMA_HANDLE schemaHandle = Schema_Create(SCHEMA_NAMESPACE, TEST_SCHEMA_METADATA);
+        SCHEMA_MODEL_TYPE_HANDLE modelType = Schema_CreateModelType(schemaHandle, "Model");
+        for (i = 0; i < 100; i++)
+        {
+            (void)sprintf(desiredPropertyName, "d%u", (unsigned int)i);
+            (void)Schema_AddModelDesiredProperty(modelType, desiredPropertyName, "int", g_pfDesiredPropertyFromAGENT_DATA_TYPE, g_pfDesiredPropertyInitialize, g_pfDesiredPropertyDeinitialize, i, NULL);
+        }
+
+        for (i = 0; i < 100; i++)
+        {
+            (void)sprintf(desiredPropertyName, "d%u", (unsigned int)i);
+
+            ///act
+            SCHEMA_MODEL_ELEMENT result = Schema_GetModelElementByName(modelType, desiredPropertyName);
+
+            ///assert
+            ASSERT_ARE_EQUAL(SCHEMA_ELEMENT_TYPE, SCHEMA_DESIRED_PROPERTY, result.elementType);
+            ASSERT_ARE_EQUAL(void_ptr, Schema_GetModelDesiredPropertyByIndex(modelType, i), result.elementHandle.desiredPropertyHandle);
+        }
+
+        ///clean
+        Schema_Destroy(schemaHandle);
+    }
+
     /*Tests_SRS_SCHEMA_02_084: [ If desiredPropertyHandle is NULL then Schema_GetModelDesiredProperty_pfOnDesiredProperty shall return NULL. ]*/
     TEST_FUNCTION(Schema_GetModelDesiredProperty_pfOnDesiredProperty_with_NULL_desiredPropertyHandle_returns_NULL)
     {
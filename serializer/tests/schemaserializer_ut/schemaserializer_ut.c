@@ -90,6 +90,10 @@ BEGIN_TEST_SUITE(SchemaSerializer_ut)
         REGISTER_GLOBAL_MOCK_FAIL_RETURN(Schema_GetModelActionArgumentByIndex, NULL);
         REGISTER_GLOBAL_MOCK_FAIL_RETURN(Schema_GetActionArgumentName, NULL);
         REGISTER_GLOBAL_MOCK_FAIL_RETURN(Schema_GetActionArgumentType, NULL);
+        REGISTER_GLOBAL_MOCK_RETURN(Schema_SetModelCommandMetadata, SCHEMA_OK);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(Schema_SetModelCommandMetadata, SCHEMA_ERROR);
+        REGISTER_GLOBAL_MOCK_RETURN(STRING_new, TEST_STRING_HANDLE);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(STRING_new, NULL);
 
     }
 
@@ -642,5 +646,119 @@ BEGIN_TEST_SUITE(SchemaSerializer_ut)
         /// cleanup
         umock_c_negative_tests_deinit();
     }
+
+    /* SchemaSerializer_GetCommandMetadata */
+
+    /* Tests_SRS_SCHEMA_SERIALIZER_41_001: [ If the modelHandle or commandMetadata argument is NULL, SchemaSerializer_GetCommandMetadata shall return SCHEMA_SERIALIZER_INVALID_ARG. ]*/
+    TEST_FUNCTION(SchemaSerializer_GetCommandMetadata_With_NULL_model_handle_fails)
+    {
+        // arrange
+        const char* commandMetadata;
+
+        // act
+        SCHEMA_SERIALIZER_RESULT result = SchemaSerializer_GetCommandMetadata(NULL, &commandMetadata);
+
+        // assert
+        ASSERT_ARE_EQUAL(SCHEMA_SERIALIZER_RESULT, SCHEMA_SERIALIZER_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /* Tests_SRS_SCHEMA_SERIALIZER_41_001: [ If the modelHandle or commandMetadata argument is NULL, SchemaSerializer_GetCommandMetadata shall return SCHEMA_SERIALIZER_INVALID_ARG. ]*/
+    TEST_FUNCTION(SchemaSerializer_GetCommandMetadata_With_NULL_commandMetadata_fails)
+    {
+        // arrange
+
+        // act
+        SCHEMA_SERIALIZER_RESULT result = SchemaSerializer_GetCommandMetadata(TEST_MODEL_HANDLE, NULL);
+
+        // assert
+        ASSERT_ARE_EQUAL(SCHEMA_SERIALIZER_RESULT, SCHEMA_SERIALIZER_INVALID_ARG, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /* Tests_SRS_SCHEMA_SERIALIZER_41_002: [ If the metadata of the model was already serialized, SchemaSerializer_GetCommandMetadata shall set commandMetadata to it, without walking the model, and return SCHEMA_SERIALIZER_OK. ]*/
+    TEST_FUNCTION(SchemaSerializer_GetCommandMetadata_When_Already_Serialized_Does_Not_Walk_The_Model)
+    {
+        // arrange
+        static const char* keptMetadata = "[{\"Name\":\"Reset\",\"Parameters\":[]}]";
+        const char* commandMetadata = NULL;
+
+        STRICT_EXPECTED_CALL(Schema_GetModelCommandMetadata(TEST_MODEL_HANDLE))
+            .SetReturn(keptMetadata);
+
+        // act
+        SCHEMA_SERIALIZER_RESULT result = SchemaSerializer_GetCommandMetadata(TEST_MODEL_HANDLE, &commandMetadata);
+
+        // assert
+        ASSERT_ARE_EQUAL(SCHEMA_SERIALIZER_RESULT, SCHEMA_SERIALIZER_OK, result);
+        ASSERT_ARE_EQUAL(void_ptr, (void*)keptMetadata, (void*)commandMetadata);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    static void SchemaSerializer_GetCommandMetadata_First_Call_inert_path(const size_t* commandCount, const char* keptMetadata)
+    {
+        STRICT_EXPECTED_CALL(Schema_GetModelCommandMetadata(TEST_MODEL_HANDLE))
+            .SetReturn(NULL);
+        STRICT_EXPECTED_CALL(STRING_new());
+        SchemaSerializer_SerializeCommandMetadata_When_Command_Count_Is_0_Should_Yield_An_Empty_Commands_Array_inert_path(commandCount);
+        STRICT_EXPECTED_CALL(STRING_c_str(TEST_STRING_HANDLE))
+            .SetReturn("[]");
+        STRICT_EXPECTED_CALL(Schema_SetModelCommandMetadata(TEST_MODEL_HANDLE, "[]"));
+        STRICT_EXPECTED_CALL(Schema_GetModelCommandMetadata(TEST_MODEL_HANDLE))
+            .SetReturn(keptMetadata)
+            .SetFailReturn(NULL);
+        STRICT_EXPECTED_CALL(STRING_delete(TEST_STRING_HANDLE));
+    }
+
+    /* Tests_SRS_SCHEMA_SERIALIZER_41_003: [ Otherwise SchemaSerializer_GetCommandMetadata shall serialize the metadata as SchemaSerializer_SerializeCommandMetadata does, keep it with the model by calling Schema_SetModelCommandMetadata, and set commandMetadata to the kept text, which stays valid until the schema is destroyed. ]*/
+    TEST_FUNCTION(SchemaSerializer_GetCommandMetadata_First_Call_Serializes_And_Keeps_The_Metadata)
+    {
+        // arrange
+        static const char* keptMetadata = "[]";
+        size_t commandCount = 0;
+        const char* commandMetadata = NULL;
+
+        SchemaSerializer_GetCommandMetadata_First_Call_inert_path(&commandCount, keptMetadata);
+
+        // act
+        SCHEMA_SERIALIZER_RESULT result = SchemaSerializer_GetCommandMetadata(TEST_MODEL_HANDLE, &commandMetadata);
+
+        // assert
+        ASSERT_ARE_EQUAL(SCHEMA_SERIALIZER_RESULT, SCHEMA_SERIALIZER_OK, result);
+        ASSERT_ARE_EQUAL(void_ptr, (void*)keptMetadata, (void*)commandMetadata);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /* Tests_SRS_SCHEMA_SERIALIZER_41_004: [ If any of the Schema or String APIs fail then SchemaSerializer_GetCommandMetadata shall return SCHEMA_SERIALIZER_ERROR. ]*/
+    TEST_FUNCTION(SchemaSerializer_GetCommandMetadata_First_Call_unhappy_paths)
+    {
+        // arrange
+        size_t commandCount = 0;
+        umock_c_negative_tests_init();
+        SchemaSerializer_GetCommandMetadata_First_Call_inert_path(&commandCount, "[]");
+        umock_c_negative_tests_snapshot();
+
+        for (size_t i = 0; i < umock_c_negative_tests_call_count(); i++)
+        {
+            if (umock_c_negative_tests_can_call_fail(i))
+            {
+                const char* commandMetadata = NULL;
+                char temp_str[128];
+
+                umock_c_negative_tests_reset();
+                umock_c_negative_tests_fail_call(i);
+                sprintf(temp_str, "On failed call %lu", (unsigned long)i);
+
+                ///act
+                SCHEMA_SERIALIZER_RESULT result = SchemaSerializer_GetCommandMetadata(TEST_MODEL_HANDLE, &commandMetadata);
+
+                /// assert
+                ASSERT_ARE_EQUAL(SCHEMA_SERIALIZER_RESULT, SCHEMA_SERIALIZER_ERROR, result, temp_str);
+            }
+        }
+
+        /// cleanup
+        umock_c_negative_tests_deinit();
+    }
 END_TEST_SUITE(SchemaSerializer_ut)
 
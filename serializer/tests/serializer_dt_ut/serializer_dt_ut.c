@@ -5,11 +5,13 @@
 #include <cstdlib>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #else
 #include <stdlib.h>
 #include <stddef.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 #endif
 
 static void* my_gballoc_malloc(size_t size)
@@ -184,6 +186,33 @@ CODEFIRST_RESULT CodeFirst_SendAsyncReported(unsigned char** destination, size_t
     }
     return result;
 }
+static char* my_MethodReturn_DetachJsonValue(METHODRETURN_HANDLE handle, size_t* jsonValueLength)
+{
+    (void)handle;
+    char* result = (char*)my_gballoc_malloc(4);
+    (void)memcpy(result, "1234", 4); /*the SDK does not need the '\0'*/
+    *jsonValueLength = 4;
+    return result;
+}
+
+static CODEFIRST_RESULT my_CodeFirst_SendAsyncReportedChanges(unsigned char** destination, size_t* destinationSize, void* device)
+{
+    (void)device;
+    CODEFIRST_RESULT result;
+    *destination = (unsigned char*)gballoc_malloc(2);
+    if (*destination == NULL)
+    {
+        result = CODEFIRST_ERROR;
+    }
+    else
+    {
+        (*destination)[0] = '\0';
+        *destinationSize = 2;
+        result = CODEFIRST_OK;
+    }
+    return result;
+}
+
 static IOTHUB_CLIENT_RESULT my_IoTHubClient_SetDeviceTwinCallback(IOTHUB_CLIENT_HANDLE iotHubClientHandle, IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK deviceTwinCallback, void* userContextCallback)
 {
     (void)iotHubClientHandle;
@@ -245,6 +274,8 @@ BEGIN_TEST_SUITE(serializer_dt_ut)
         REGISTER_UMOCK_ALIAS_TYPE(METHODRETURN_HANDLE, void*);
         REGISTER_UMOCK_ALIAS_TYPE(const METHODRETURN_DATA*, void*);
         REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_REPORTED_STATE_CALLBACK, void*);
+        REGISTER_UMOCK_ALIAS_TYPE(unsigned char**, void*);
+        REGISTER_UMOCK_ALIAS_TYPE(size_t*, void*);
 
         REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK, void*);
 
@@ -257,6 +288,10 @@ BEGIN_TEST_SUITE(serializer_dt_ut)
         REGISTER_GLOBAL_MOCK_RETURNS(CodeFirst_CreateDevice, TEST_DEVICE_HANDLE, NULL);
         REGISTER_GLOBAL_MOCK_RETURNS(CodeFirst_IngestDesiredProperties, CODEFIRST_OK, CODEFIRST_ERROR);
         REGISTER_GLOBAL_MOCK_RETURNS(CodeFirst_ExecuteMethod, TEST_METHODRETURN_HANDLE, NULL);
+        REGISTER_GLOBAL_MOCK_HOOK(MethodReturn_DetachJsonValue, my_MethodReturn_DetachJsonValue);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(MethodReturn_DetachJsonValue, NULL);
+        REGISTER_GLOBAL_MOCK_HOOK(CodeFirst_SendAsyncReportedChanges, my_CodeFirst_SendAsyncReportedChanges);
+        REGISTER_GLOBAL_MOCK_FAIL_RETURN(CodeFirst_SendAsyncReportedChanges, CODEFIRST_ERROR);
         REGISTER_GLOBAL_MOCK_RETURNS(IoTHubClient_SendReportedState, IOTHUB_CLIENT_OK, IOTHUB_CLIENT_ERROR);
         REGISTER_GLOBAL_MOCK_RETURNS(IoTHubClient_LL_SendReportedState, IOTHUB_CLIENT_OK, IOTHUB_CLIENT_ERROR);
 
@@ -696,7 +731,7 @@ BEGIN_TEST_SUITE(serializer_dt_ut)
         STRICT_EXPECTED_CALL(CodeFirst_ExecuteMethod(TEST_METHOD_CALLBACK_CONTEXT, "methodA", "3")); /*0x33 is the character '3'*/
         STRICT_EXPECTED_CALL(MethodReturn_GetReturn(TEST_METHODRETURN_HANDLE))
             .SetReturn(&data2);
-        STRICT_EXPECTED_CALL(gballoc_malloc(4)); /*answer is "1234"*/
+        STRICT_EXPECTED_CALL(MethodReturn_DetachJsonValue(TEST_METHODRETURN_HANDLE, IGNORED_PTR_ARG)); /*answer is "1234"*/
         STRICT_EXPECTED_CALL(MethodReturn_Destroy(IGNORED_PTR_ARG))
             .IgnoreArgument_handle();
         STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
@@ -705,8 +740,9 @@ BEGIN_TEST_SUITE(serializer_dt_ut)
 
     /*Tests_SRS_SERIALIZERDEVICETWIN_02_021: [ deviceMethodCallback shall transform payload and size into a null terminated string. ]*/
     /*Tests_SRS_SERIALIZERDEVICETWIN_02_022: [ deviceMethodCallback shall call EXECUTE_METHOD passing the userContextCallback, method_name and the null terminated string build before. ]*/
-    /*Tests_SRS_SERIALIZERDEVICETWIN_02_023: [ deviceMethodCallback shall get the MethodReturn_Data and shall copy the response JSON value into a new byte array. ]*/
-    /*Tests_SRS_SERIALIZERDEVICETWIN_02_024: [ deviceMethodCallback shall set *response to this new byte array, *resp_size to the size of the array. ]*/
+    /*Tests_SRS_SERIALIZERDEVICETWIN_02_023: [ deviceMethodCallback shall get the MethodReturn_Data. ]*/
+    /*Tests_SRS_SERIALIZERDEVICETWIN_41_005: [ deviceMethodCallback shall take the response JSON value out of the METHODRETURN_HANDLE by calling MethodReturn_DetachJsonValue, without copying it. ]*/
+    /*Tests_SRS_SERIALIZERDEVICETWIN_02_024: [ deviceMethodCallback shall set *response to the JSON value and *resp_size to its length. The SDK frees *response. ]*/
     /*Tests_SRS_SERIALIZERDEVICETWIN_02_025: [ deviceMethodCallback returns the statusCode from the user. ]*/
     TEST_FUNCTION(deviceMethodCallback_happy_path)
     {
@@ -983,4 +1019,92 @@ BEGIN_TEST_SUITE(serializer_dt_ut)
 
 
 
+    /*Tests_SRS_SERIALIZERDEVICETWIN_41_001: [ IoTHubDeviceTwin_SendReportedStateChanges_Impl shall call CodeFirst_SendAsyncReportedChanges. ]*/
+    /*Tests_SRS_SERIALIZERDEVICETWIN_41_002: [ IoTHubDeviceTwin_SendReportedStateChanges_Impl shall send the serialized changes the same way IoTHubDeviceTwin_SendReportedState_Impl does. ]*/
+    TEST_FUNCTION(IoTHubDeviceTwin_SendReportedStateChanges_Impl_happy_path)
+    {
+        ///arrange
+        (void)SERIALIZER_REGISTER_NAMESPACE(basic15);
+        IoTHubDeviceTwin_CreatebasicModel_WithData15_inertPath();
+        basicModel_WithData15* model = IoTHubDeviceTwin_CreatebasicModel_WithData15(TEST_IOTHUB_CLIENT_HANDLE);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(CodeFirst_SendAsyncReportedChanges(IGNORED_PTR_ARG, IGNORED_PTR_ARG, model))
+            .IgnoreArgument_destination()
+            .IgnoreArgument_destinationSize();
+        STRICT_EXPECTED_CALL(gballoc_malloc(2));
+        STRICT_EXPECTED_CALL(VECTOR_find_if(g_allProtoHandles, protoHandleHasDeviceStartAddress, model));
+        STRICT_EXPECTED_CALL(IoTHubClient_SendReportedState(TEST_IOTHUB_CLIENT_HANDLE, IGNORED_PTR_ARG, 2, reportedStateCallback, (void*)1))
+            .IgnoreArgument_reportedState();
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument_ptr();
+
+        ///act
+        IOTHUB_CLIENT_RESULT r = IoTHubDeviceTwin_SendReportedStateChanges_Impl(model, reportedStateCallback, (void*)1);
+
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, r);
+
+        ///clean
+        IoTHubDeviceTwin_DestroybasicModel_WithData15(model);
+    }
+
+    /*Tests_SRS_SERIALIZERDEVICETWIN_41_003: [ Otherwise, IoTHubDeviceTwin_SendReportedStateChanges_Impl shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+    TEST_FUNCTION(IoTHubDeviceTwin_SendReportedStateChanges_Impl_fails_when_CodeFirst_SendAsyncReportedChanges_fails)
+    {
+        ///arrange
+        (void)SERIALIZER_REGISTER_NAMESPACE(basic15);
+        IoTHubDeviceTwin_CreatebasicModel_WithData15_inertPath();
+        basicModel_WithData15* model = IoTHubDeviceTwin_CreatebasicModel_WithData15(TEST_IOTHUB_CLIENT_HANDLE);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(CodeFirst_SendAsyncReportedChanges(IGNORED_PTR_ARG, IGNORED_PTR_ARG, model))
+            .IgnoreArgument_destination()
+            .IgnoreArgument_destinationSize()
+            .SetReturn(CODEFIRST_ERROR);
+
+        ///act
+        IOTHUB_CLIENT_RESULT r = IoTHubDeviceTwin_SendReportedStateChanges_Impl(model, reportedStateCallback, (void*)1);
+
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, r);
+
+        ///clean
+        IoTHubDeviceTwin_DestroybasicModel_WithData15(model);
+    }
+
+    /*Tests_SRS_SERIALIZERDEVICETWIN_41_004: [ If sending fails, IoTHubDeviceTwin_SendReportedStateChanges_Impl shall call CodeFirst_ResetReportedChanges so that the next call sends all the reported properties. ]*/
+    TEST_FUNCTION(IoTHubDeviceTwin_LL_SendReportedStateChanges_Impl_resets_the_changes_when_sending_fails)
+    {
+        ///arrange
+        (void)SERIALIZER_REGISTER_NAMESPACE(basic15);
+        IoTHubDeviceTwin_LL_CreatebasicModel_WithData15_inertPath();
+        basicModel_WithData15* model = IoTHubDeviceTwin_LL_CreatebasicModel_WithData15(TEST_IOTHUB_CLIENT_LL_HANDLE);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(CodeFirst_SendAsyncReportedChanges(IGNORED_PTR_ARG, IGNORED_PTR_ARG, model))
+            .IgnoreArgument_destination()
+            .IgnoreArgument_destinationSize();
+        STRICT_EXPECTED_CALL(gballoc_malloc(2));
+        STRICT_EXPECTED_CALL(VECTOR_find_if(g_allProtoHandles, protoHandleHasDeviceStartAddress, model));
+        STRICT_EXPECTED_CALL(IoTHubClient_LL_SendReportedState(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG, 2, reportedStateCallback, (void*)1))
+            .IgnoreArgument_reportedState()
+            .SetReturn(IOTHUB_CLIENT_ERROR);
+        STRICT_EXPECTED_CALL(CodeFirst_ResetReportedChanges(model));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument_ptr();
+
+        ///act
+        IOTHUB_CLIENT_RESULT r = IoTHubDeviceTwin_SendReportedStateChanges_Impl(model, reportedStateCallback, (void*)1);
+
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, r);
+
+        ///clean
+        IoTHubDeviceTwin_LL_DestroybasicModel_WithData15(model);
+    }
+
 END_TEST_SUITE(serializer_dt_ut)